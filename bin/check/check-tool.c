@@ -20,8 +20,10 @@
 #include <isc/buffer.h>
 #include <isc/log.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
 #include <isc/net.h>
 #include <isc/netdb.h>
+#include <isc/once.h>
 #include <isc/print.h>
 #include <isc/region.h>
 #include <isc/result.h>
@@ -79,6 +81,7 @@ static const char *dbtype[] = { "rbt" };
 int debug = 0;
 const char *journal = NULL;
 bool nomerge = true;
+unsigned int loadthreads = 1;
 #if CHECK_LOCAL
 bool docheckmx = true;
 bool dochecksrv = true;
@@ -104,8 +107,20 @@ static isc_logcategory_t categories[] = { { "", 0 },
 					  { "unmatched", 0 },
 					  { NULL, 0 } };
 
+/*
+ * The check callbacks below may be called from several threads at once
+ * when 'loadthreads' is greater than one, so the table of errors already
+ * logged is protected by 'symlock'.
+ */
 static isc_symtab_t *symtab = NULL;
 static isc_mem_t *sym_mctx;
+static isc_mutex_t symlock;
+static isc_once_t symlock_once = ISC_ONCE_INIT;
+
+static void
+symlock_init(void) {
+	isc_mutex_init(&symlock);
+}
 
 static void
 freekey(char *key, unsigned int type, isc_symvalue_t value, void *userarg) {
@@ -119,6 +134,10 @@ add(char *key, int value) {
 	isc_result_t result;
 	isc_symvalue_t symvalue;
 
+	RUNTIME_CHECK(isc_once_do(&symlock_once, symlock_init) ==
+		      ISC_R_SUCCESS);
+	LOCK(&symlock);
+
 	if (sym_mctx == NULL) {
 		isc_mem_create(&sym_mctx);
 	}
@@ -127,7 +146,7 @@ add(char *key, int value) {
 		result = isc_symtab_create(sym_mctx, 100, freekey, sym_mctx,
 					   false, &symtab);
 		if (result != ISC_R_SUCCESS) {
-			return;
+			goto unlock;
 		}
 	}
 
@@ -139,21 +158,24 @@ add(char *key, int value) {
 	if (result != ISC_R_SUCCESS) {
 		isc_mem_free(sym_mctx, key);
 	}
+
+unlock:
+	UNLOCK(&symlock);
 }
 
 static bool
 logged(char *key, int value) {
-	isc_result_t result;
+	isc_result_t result = ISC_R_NOTFOUND;
 
-	if (symtab == NULL) {
-		return (false);
+	RUNTIME_CHECK(isc_once_do(&symlock_once, symlock_init) ==
+		      ISC_R_SUCCESS);
+	LOCK(&symlock);
+	if (symtab != NULL) {
+		result = isc_symtab_lookup(symtab, key, value, NULL);
 	}
+	UNLOCK(&symlock);
 
-	result = isc_symtab_lookup(symtab, key, value, NULL);
-	if (result == ISC_R_SUCCESS) {
-		return (true);
-	}
-	return (false);
+	return (result == ISC_R_SUCCESS);
 }
 
 static bool
@@ -623,6 +645,7 @@ load_zone(isc_mem_t *mctx, const char *zonename, const char *filename,
 	dns_zone_setoption(zone, DNS_ZONEOPT_NOMERGE, nomerge);
 
 	dns_zone_setmaxttl(zone, maxttl);
+	dns_zone_setloadthreads(zone, loadthreads);
 
 	if (docheckmx) {
 		dns_zone_setcheckmx(zone, checkmx);
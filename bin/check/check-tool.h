@@ -44,6 +44,7 @@ dump_zone(const char *zonename, dns_zone_t *zone, const char *filename,
 extern int debug;
 extern const char *journal;
 extern bool nomerge;
+extern unsigned int loadthreads;
 extern bool docheckmx;
 extern bool docheckns;
 extern bool dochecksrv;
@@ -24,6 +24,7 @@
 #include <isc/hash.h>
 #include <isc/log.h>
 #include <isc/mem.h>
+#include <isc/os.h>
 #include <isc/print.h>
 #include <isc/result.h>
 #include <isc/string.h>
@@ -77,7 +78,7 @@ usage(void) {
 		"[-n (ignore|warn|fail)] [-r (ignore|warn|fail)] "
 		"[-i (full|full-sibling|local|local-sibling|none)] "
 		"[-M (ignore|warn|fail)] [-S (ignore|warn|fail)] "
-		"[-W (ignore|warn)] "
+		"[-W (ignore|warn)] [-N nthreads] "
 		"%s zonename [ (filename|-) ]\n",
 		prog_name,
 		progmode == progmode_check ? "[-o filename]" : "-o filename");
@@ -107,7 +108,7 @@ main(int argc, char **argv) {
 	dns_masterformat_t inputformat = dns_masterformat_text;
 	dns_masterformat_t outputformat = dns_masterformat_text;
 	dns_masterrawheader_t header;
-	uint32_t rawversion = 1, serialnum = 0;
+	uint32_t rawversion = 2, serialnum = 0;
 	dns_ttl_t maxttl = 0;
 	bool snset = false;
 	bool logdump = false;
@@ -120,6 +121,7 @@ main(int argc, char **argv) {
 	 */
 
 	outputstyle = &dns_master_style_full;
+	loadthreads = isc_os_ncpus();
 
 	prog_name = strrchr(argv[0], '/');
 	if (prog_name == NULL) {
@@ -166,7 +168,7 @@ main(int argc, char **argv) {
 
 	while ((c = isc_commandline_parse(argc, argv,
 					  "c:df:hi:jJ:k:L:l:m:n:qr:s:t:o:vw:DF:"
-					  "M:S:T:W:")) != EOF)
+					  "M:N:S:T:W:")) != EOF)
 	{
 		switch (c) {
 		case 'c':
@@ -382,6 +384,18 @@ main(int argc, char **argv) {
 			}
 			break;
 
+		case 'N':
+			endp = NULL;
+			loadthreads = strtoul(isc_commandline_argument, &endp,
+					      10);
+			if (*endp != '\0' || loadthreads < 1 ||
+			    loadthreads > 512) {
+				fprintf(stderr, "number of threads "
+						"must be between 1 and 512\n");
+				exit(1);
+			}
+			break;
+
 		case 'S':
 			if (ARGCMP("fail")) {
 				zone_options &= ~DNS_ZONEOPT_WARNSRVCNAME;
@@ -471,7 +485,7 @@ main(int argc, char **argv) {
 			outputformat = dns_masterformat_raw;
 			rawversion = strtol(outputformatstr + 4, &end, 10);
 			if (end == outputformatstr + 4 || *end != '\0' ||
-			    rawversion > 1U) {
+			    rawversion > 2U) {
 				fprintf(stderr, "unknown raw format version\n");
 				exit(1);
 			}
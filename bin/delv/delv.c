@@ -38,10 +38,13 @@
 #include <isc/print.h>
 #include <isc/result.h>
 #include <isc/sockaddr.h>
+#include <isc/stdio.h>
 #include <isc/string.h>
 #include <isc/task.h>
 #include <isc/timer.h>
+#include <isc/time.h>
 #include <isc/util.h>
+#include <isc/work.h>
 
 #include <dns/byaddr.h>
 #include <dns/client.h>
@@ -75,6 +78,11 @@
 
 #define MAXNAME (DNS_NAME_MAXTEXT + 1)
 
+/*
+ * Maximum number of batch queries being resolved at once.
+ */
+#define MAXINFLIGHT 100
+
 /* Variables used internally by delv. */
 char *progname;
 static isc_mem_t *mctx = NULL;
@@ -121,6 +129,30 @@ static dns_name_t *anchor_name = NULL;
 static dns_master_style_t *style = NULL;
 static dns_fixedname_t qfn;
 
+/* Batch mode */
+static char *batchname = NULL;
+static FILE *batchfp = NULL;
+static dns_client_t *batchclient = NULL;
+static char batchline[MAXNAME + 64];
+static bool batchgotline = false, batchreading = false, batcheof = false;
+static bool batchfirst = true;
+static unsigned int inflight = 0;
+
+/* State of the answer being printed */
+static dns_trust_t printtrust;
+static bool printfirst = true;
+
+/*
+ * A query being resolved.  The list of answers comes first, so that the
+ * query can be found from the list passed to resolve_cb().
+ */
+typedef struct delv_query {
+	dns_namelist_t namelist;
+	dns_fixedname_t fname;
+	dns_rdatatype_t qtype;
+	isc_time_t start;
+} delv_query_t;
+
 /* Default bind.keys contents */
 static char anchortext[] = TRUST_ANCHORS;
 
@@ -157,6 +189,10 @@ usage(void) {
 		"                 -c class            (option included for "
 		"compatibility;\n"
 		"                 -d level            (set debugging level)\n"
+		"                 -f filename         (batch mode: resolve the "
+		"names in\n"
+		"                                      filename, or - for "
+		"stdin)\n"
 		"                 -h                  (print help and exit)\n"
 		"                 -i                  (disable DNSSEC "
 		"validation)\n"
@@ -426,8 +462,6 @@ print_status(dns_rdataset_t *rdataset) {
 static isc_result_t
 printdata(dns_rdataset_t *rdataset, dns_name_t *owner) {
 	isc_result_t result = ISC_R_SUCCESS;
-	static dns_trust_t trust;
-	static bool first = true;
 	isc_buffer_t target;
 	isc_region_t r;
 	char *t = NULL;
@@ -444,13 +478,13 @@ printdata(dns_rdataset_t *rdataset, dns_name_t *owner) {
 		return (ISC_R_SUCCESS);
 	}
 
-	if (first || rdataset->trust != trust) {
-		if (!first && showtrust && !short_form && !yaml) {
+	if (printfirst || rdataset->trust != printtrust) {
+		if (!printfirst && showtrust && !short_form && !yaml) {
 			putchar('\n');
 		}
 		print_status(rdataset);
-		trust = rdataset->trust;
-		first = false;
+		printtrust = rdataset->trust;
+		printfirst = false;
 	}
 
 	do {
@@ -1277,10 +1311,10 @@ plus_option(char *option) {
 }
 
 /*
- * options: "46a:b:c:d:himp:q:t:vx:";
+ * options: "46a:b:c:d:f:himp:q:t:vx:";
  */
 static const char *single_dash_opts = "46himv";
-static const char *dash_opts = "46abcdhimpqtvx";
+static const char *dash_opts = "46abcdfhimpqtvx";
 
 static bool
 dash_option(char *option, char *next, bool *open_type_class) {
@@ -1422,6 +1456,13 @@ dash_option(char *option, char *next, bool *open_type_class) {
 		}
 		loglevel = num;
 		return (value_from_next);
+	case 'f':
+		if (batchname != NULL) {
+			warn("extra batch file");
+			isc_mem_free(mctx, batchname);
+		}
+		batchname = isc_mem_strdup(mctx, value);
+		return (value_from_next);
 	case 'p':
 		port = value;
 		return (value_from_next);
@@ -1623,7 +1664,7 @@ parse_args(int argc, char **argv) {
 	if (curqname == NULL) {
 		qname = isc_mem_strdup(mctx, ".");
 
-		if (!typeset) {
+		if (!typeset && batchname == NULL) {
 			qtype = dns_rdatatype_ns;
 		}
 	} else {
@@ -1709,11 +1750,27 @@ get_reverse(char *reverse, size_t len, char *value, bool strict) {
 	}
 }
 
+static void
+batch_read(void);
+
+static void
+batch_done(void);
+
 static void
 resolve_cb(dns_client_t *client, const dns_name_t *query_name,
 	   dns_namelist_t *namelist, isc_result_t result) {
+	/* The list of answers is the first member of the query. */
+	delv_query_t *query = (delv_query_t *)namelist;
 	char namestr[DNS_NAME_FORMATSIZE];
+	char typestr[DNS_RDATATYPE_FORMATSIZE];
 	dns_rdataset_t *rdataset;
+	isc_time_t now;
+	uint64_t msecs;
+
+	isc_time_now(&now);
+	msecs = isc_time_microdiff(&now, &query->start) / 1000;
+	dns_name_format(query_name, namestr, sizeof(namestr));
+	dns_rdatatype_format(query->qtype, typestr, sizeof(typestr));
 
 	if (result != ISC_R_SUCCESS && !yaml) {
 		delv_log(ISC_LOG_ERROR, "resolution failed: %s",
@@ -1721,13 +1778,25 @@ resolve_cb(dns_client_t *client, const dns_name_t *query_name,
 	}
 
 	if (yaml) {
+		if (batchfp != NULL) {
+			printf("---\n");
+		}
 		printf("type: DELV_RESULT\n");
-		dns_name_format(query_name, namestr, sizeof(namestr));
 		printf("query_name: %s\n", namestr);
+		if (batchfp != NULL) {
+			printf("query_type: %s\n", typestr);
+			printf("query_time_ms: %" PRIu64 "\n", msecs);
+		}
 		printf("status: %s\n", isc_result_totext(result));
 		printf("records:\n");
+	} else if (batchfp != NULL && showcomments) {
+		printf("%s;; %s/%s: %s (%" PRIu64 " ms)\n",
+		       batchfirst ? "" : "\n", namestr, typestr,
+		       isc_result_totext(result), msecs);
+		batchfirst = false;
 	}
 
+	printfirst = true;
 	for (dns_name_t *response_name = ISC_LIST_HEAD(*namelist);
 	     response_name != NULL;
 	     response_name = ISC_LIST_NEXT(response_name, link))
@@ -1743,26 +1812,37 @@ resolve_cb(dns_client_t *client, const dns_name_t *query_name,
 	}
 
 	dns_client_freeresanswer(client, namelist);
-	isc_mem_put(mctx, namelist, sizeof(*namelist));
+	isc_mem_put(mctx, query, sizeof(*query));
+
+	if (batchfp != NULL) {
+		/*
+		 * The reference held for this query is released by
+		 * the client once we return.
+		 */
+		inflight--;
+		batch_read();
+		batch_done();
+		return;
+	}
 
 	dns_client_detach(&client);
 
 	isc_loopmgr_shutdown(loopmgr);
 }
 
-static void
-resolve(void *arg) {
-	dns_client_t *client = arg;
-	dns_namelist_t *namelist;
+static isc_result_t
+start_query(dns_client_t *client, const char *text, dns_rdatatype_t type) {
+	delv_query_t *query = NULL;
 	unsigned int resopt;
 	isc_result_t result;
 	dns_name_t *query_name;
 
-	namelist = isc_mem_get(mctx, sizeof(*namelist));
-	ISC_LIST_INIT(*namelist);
+	query = isc_mem_get(mctx, sizeof(*query));
+	*query = (delv_query_t){ .qtype = type };
+	ISC_LIST_INIT(query->namelist);
 
 	/* Construct QNAME */
-	CHECK(convert_name(&qfn, &query_name, qname));
+	CHECK(convert_name(&query->fname, &query_name, text));
 
 	/* Set up resolution options */
 	resopt = DNS_CLIENTRESOPT_NOCDFLAG;
@@ -1780,26 +1860,134 @@ resolve(void *arg) {
 	}
 
 	/* Perform resolution */
+	isc_time_now(&query->start);
 	result = dns_client_resolve(client, query_name, dns_rdataclass_in,
-				    qtype, resopt, namelist, resolve_cb);
+				    type, resopt, &query->namelist,
+				    resolve_cb);
 
+cleanup:
 	if (result != ISC_R_SUCCESS) {
-		goto cleanup;
+		isc_mem_put(mctx, query, sizeof(*query));
+	}
+
+	return (result);
+}
+
+static void
+resolve(void *arg) {
+	dns_client_t *client = arg;
+	isc_result_t result;
+
+	result = start_query(client, qname, qtype);
+	if (result == ISC_R_SUCCESS) {
+		return;
 	}
 
-	return;
-cleanup:
 	if (!yaml) {
 		delv_log(ISC_LOG_ERROR, "resolution failed: %s",
 			 isc_result_totext(result));
 	}
 
-	isc_mem_put(mctx, namelist, sizeof(*namelist));
 	isc_loopmgr_shutdown(loopmgr);
 
 	dns_client_detach(&client);
 }
 
+/*
+ * Batch mode: each line of the batch file holds a name and optionally a
+ * type, and up to MAXINFLIGHT of them are resolved at once by the same
+ * client, sharing its cache and validated trust anchors.  Lines are read
+ * in the thread pool so that a slow writer on stdin doesn't hold up the
+ * resolutions in progress.
+ */
+static void
+batch_query(char *line) {
+	char *name, *type, *last = NULL;
+	dns_rdatatype_t rdtype = qtype;
+	isc_textregion_t tr;
+	isc_result_t result;
+
+	name = strtok_r(line, " \t\r\n", &last);
+	if (name == NULL || name[0] == '#' || name[0] == ';') {
+		return;
+	}
+
+	type = strtok_r(NULL, " \t\r\n", &last);
+	if (type != NULL) {
+		tr.base = type;
+		tr.length = strlen(type);
+		result = dns_rdatatype_fromtext(&rdtype, &tr);
+		if (result != ISC_R_SUCCESS || rdtype == dns_rdatatype_ixfr ||
+		    rdtype == dns_rdatatype_axfr)
+		{
+			warn("ignoring %s: invalid query type %s", name, type);
+			return;
+		}
+	}
+
+	/*
+	 * Each resolution holds its own reference to the client, which
+	 * is released when it completes.
+	 */
+	result = start_query(batchclient, name, rdtype);
+	if (result == ISC_R_SUCCESS) {
+		inflight++;
+	} else if (!yaml) {
+		delv_log(ISC_LOG_ERROR, "resolution of %s failed: %s", name,
+			 isc_result_totext(result));
+	}
+}
+
+static void
+batch_readline(void *arg) {
+	UNUSED(arg);
+
+	batchgotline = (fgets(batchline, sizeof(batchline), batchfp) != NULL);
+}
+
+static void
+batch_gotline(void *arg) {
+	UNUSED(arg);
+
+	batchreading = false;
+	if (batchgotline) {
+		batch_query(batchline);
+	} else {
+		batcheof = true;
+	}
+
+	batch_read();
+	batch_done();
+}
+
+static void
+batch_read(void) {
+	if (batchreading || batcheof || inflight >= MAXINFLIGHT) {
+		return;
+	}
+
+	batchreading = true;
+	isc_work_enqueue(isc_loop_main(loopmgr), batch_readline, batch_gotline,
+			 NULL);
+}
+
+static void
+batch_done(void) {
+	if (batchclient == NULL || !batcheof || inflight > 0) {
+		return;
+	}
+
+	dns_client_detach(&batchclient);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static void
+batch_start(void *arg) {
+	batchclient = arg;
+
+	batch_read();
+}
+
 int
 main(int argc, char *argv[]) {
 	dns_client_t *client = NULL;
@@ -1842,7 +2030,20 @@ main(int argc, char *argv[]) {
 
 	CHECK(setup_dnsseckeys(client));
 
-	isc_loop_setup(isc_loop_main(loopmgr), resolve, client);
+	if (batchname != NULL) {
+		if (strcmp(batchname, "-") == 0) {
+			batchfp = stdin;
+		} else {
+			result = isc_stdio_open(batchname, "r", &batchfp);
+			if (result != ISC_R_SUCCESS) {
+				fatal("couldn't open batch file '%s': %s",
+				      batchname, isc_result_totext(result));
+			}
+		}
+		isc_loop_setup(isc_loop_main(loopmgr), batch_start, client);
+	} else {
+		isc_loop_setup(isc_loop_main(loopmgr), resolve, client);
+	}
 
 	isc_loopmgr_run(loopmgr);
 
@@ -1856,6 +2057,12 @@ cleanup:
 	if (qname != NULL) {
 		isc_mem_free(mctx, qname);
 	}
+	if (batchfp != NULL && batchfp != stdin) {
+		(void)isc_stdio_close(batchfp);
+	}
+	if (batchname != NULL) {
+		isc_mem_free(mctx, batchname);
+	}
 	if (style != NULL) {
 		dns_master_styledestroy(&style, mctx);
 	}
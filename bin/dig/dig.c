@@ -56,11 +56,13 @@
 	}
 
 #define DIG_MAX_ADDRESSES 20
+#define DIG_MAX_PARALLEL  1000
 
 dig_lookup_t *default_lookup = NULL;
 
 static char *batchname = NULL;
 static FILE *batchfp = NULL;
+static isc_time_t batchstart, batchfinish;
 static char *argv0;
 static int addresscount = 0;
 
@@ -255,8 +257,12 @@ help(void) {
 	       "record)\n"
 	       "                 +[no]opcode=###     (Set the opcode of the "
 	       "request)\n"
+	       "                 +[no]ordered        (Print +parallel results "
+	       "in batch order)\n"
 	       "                 +padding=###        (Set padding block size "
 	       "[0])\n"
+	       "                 +parallel=###       (Run up to ### batch "
+	       "lookups at once)\n"
 	       "                 +qid=###            (Specify the query ID to "
 	       "use when sending queries)\n"
 	       "                 +[no]qr             (Print question before "
@@ -1787,24 +1793,49 @@ plus_option(char *option, bool is_batchfile, bool *need_clone,
 			}
 			lookup->opcode = (dns_opcode_t)num;
 			break;
+		case 'r':
+			FULLCHECK("ordered");
+			parallel_ordered = state;
+			break;
 		default:
 			goto invalid_option;
 		}
 		break;
 	case 'p':
-		FULLCHECK("padding");
-		if (state && lookup->edns == -1) {
-			lookup->edns = DEFAULT_EDNS_VERSION;
-		}
-		if (value == NULL) {
-			goto need_value;
-		}
-		result = parse_uint(&num, value, 512, "padding");
-		if (result != ISC_R_SUCCESS) {
-			warn("Couldn't parse padding");
-			goto exit_or_usage;
+		switch (cmd[2]) {
+		case 'r':
+			FULLCHECK("parallel");
+			if (!state) {
+				parallel = 0;
+				break;
+			}
+			if (value == NULL) {
+				goto need_value;
+			}
+			result = parse_uint(&num, value, DIG_MAX_PARALLEL,
+					    "parallel");
+			if (result != ISC_R_SUCCESS) {
+				warn("Couldn't parse parallel");
+				goto exit_or_usage;
+			}
+			parallel = num;
+			break;
+		default:
+			FULLCHECK("padding");
+			if (state && lookup->edns == -1) {
+				lookup->edns = DEFAULT_EDNS_VERSION;
+			}
+			if (value == NULL) {
+				goto need_value;
+			}
+			result = parse_uint(&num, value, 512, "padding");
+			if (result != ISC_R_SUCCESS) {
+				warn("Couldn't parse padding");
+				goto exit_or_usage;
+			}
+			lookup->padding = (uint16_t)num;
+			break;
 		}
-		lookup->padding = (uint16_t)num;
 		break;
 	case 'q':
 		switch (cmd[1]) {
@@ -2887,6 +2918,31 @@ parse_args(bool is_batchfile, bool config_only, int argc, char **argv) {
 	}
 }
 
+/*
+ * Read the next line of the batch file, if any, and queue its lookups.
+ * This is also the callback from dighost.c that keeps the lookup list
+ * filled when running batch lookups in parallel.
+ */
+static bool
+next_batchline(void) {
+	char batchline[MXNAME];
+	int bargc;
+	char *bargv[16];
+
+	if (batchname == NULL || feof(batchfp) ||
+	    fgets(batchline, sizeof(batchline), batchfp) == NULL)
+	{
+		return (false);
+	}
+
+	debug("batch line %s", batchline);
+	bargc = split_batchline(batchline, bargv, 14, "batch argv");
+	bargv[0] = argv0;
+	parse_args(true, false, bargc, (char **)bargv);
+
+	return (true);
+}
+
 /*
  * Callback from dighost.c to allow program-specific shutdown code.
  * Here, we're possibly reading from a batch file, then shutting down
@@ -2894,25 +2950,19 @@ parse_args(bool is_batchfile, bool config_only, int argc, char **argv) {
  */
 static void
 query_finished(void) {
-	char batchline[MXNAME];
-
 	fflush(stdout);
 
-	if (batchname != NULL && !feof(batchfp) &&
-	    fgets(batchline, sizeof(batchline), batchfp) != NULL)
-	{
-		int bargc;
-		char *bargv[16];
-		debug("batch line %s", batchline);
-		bargc = split_batchline(batchline, bargv, 14, "batch argv");
-		bargv[0] = argv0;
-		parse_args(true, false, bargc, (char **)bargv);
+	if (next_batchline()) {
 		start_lookup();
 		return;
 	}
 
 	debug("shutdown");
 
+	if (parallel > 0) {
+		isc_time_now(&batchfinish);
+	}
+
 	/* We are done */
 	if (batchname != NULL) {
 		if (batchfp != stdin) {
@@ -2995,6 +3045,7 @@ dig_setup(int argc, char **argv) {
 	dighost_received = received;
 	dighost_trying = trying;
 	dighost_shutdown = query_finished;
+	dighost_nextbatch = next_batchline;
 	dighost_error = dig_error;
 	dighost_warning = dig_warning;
 	dighost_comments = dig_comments;
@@ -3026,6 +3077,8 @@ void
 dig_startup(void) {
 	debug("dig_startup()");
 
+	isc_time_now(&batchstart);
+
 	isc_loopmgr_setup(loopmgr, run_loop, NULL);
 	isc_loopmgr_run(loopmgr);
 }
@@ -3035,8 +3088,26 @@ dig_query_start(void) {
 	start_lookup();
 }
 
+/*
+ * With +parallel, print how long all the lookups took in total.
+ */
+static void
+print_summary(void) {
+	uint64_t usecs = isc_time_microdiff(&batchfinish, &batchstart);
+	double secs = (double)usecs / 1000000;
+
+	printf(";; %u lookups in %.3f seconds", started_lookups, secs);
+	if (usecs > 0) {
+		printf(" (%.1f lookups/s)", started_lookups / secs);
+	}
+	printf(", up to %u in parallel\n", parallel);
+}
+
 void
 dig_shutdown(void) {
+	if (parallel > 0 && !isc_time_isepoch(&batchfinish)) {
+		print_summary();
+	}
 	destroy_lookup(default_lookup);
 	cancel_all();
 	destroy_libs();
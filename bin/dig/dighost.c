@@ -95,6 +95,9 @@ bool check_ra = false, have_ipv4 = false, have_ipv6 = false,
      specified_source = false, free_now = false, usesearch = false,
      showsearch = false, is_dst_up = false, keep_open = false, verbose = false,
      yaml = false;
+unsigned int parallel = 0;
+bool parallel_ordered = true;
+unsigned int started_lookups = 0;
 in_port_t port = 53;
 bool port_set = false;
 unsigned int timeout = 0;
@@ -150,6 +153,40 @@ bool memdebugging = false;
 char *progname = NULL;
 dig_lookup_t *current_lookup = NULL;
 
+/*%
+ * Lookups that have been started and not yet destroyed.  Without
+ * +parallel there is at most one, which is also 'current_lookup'.
+ */
+static dig_lookuplist_t running_lookups;
+static unsigned int nrunning = 0;
+
+/*%
+ * With +parallel, everything printed for a lookup given on the command
+ * line or in the batch file (including its requeued and search list
+ * successors) is captured in a temporary file, and copied to the real
+ * standard output once the lookup is done.  Unless +noordered is set,
+ * the captured outputs are copied in the order the lookups were started.
+ */
+struct dig_output {
+	FILE *fp;
+	isc_refcount_t references;
+	bool done;
+	ISC_LINK(dig_output_t) link;
+};
+
+static ISC_LIST(dig_output_t) outputs;
+static dig_output_t *current_output = NULL;
+static int stdout_fd = -1;
+
+/*%
+ * The lookup and output that were current before a callback switched
+ * to the lookup it was called for.
+ */
+typedef struct dig_context {
+	dig_lookup_t *lookup;
+	dig_output_t *output;
+} dig_context_t;
+
 #define DIG_MAX_ADDRESSES 20
 
 static void
@@ -196,6 +233,8 @@ void (*dighost_trying)(char *frm, dig_lookup_t *lookup);
 
 void (*dighost_shutdown)(void);
 
+bool (*dighost_nextbatch)(void) = NULL;
+
 /* forward declarations */
 
 #define cancel_lookup(l) _cancel_lookup(l, __FILE__, __LINE__)
@@ -203,8 +242,17 @@ static void
 _cancel_lookup(dig_lookup_t *lookup, const char *file, unsigned int line);
 
 static void
-recv_done(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
-	  void *arg);
+recv_done_cb(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
+	     void *arg);
+
+static void
+send_done_cb(isc_nmhandle_t *handle, isc_result_t eresult, void *arg);
+
+static void
+udp_ready_cb(isc_nmhandle_t *handle, isc_result_t eresult, void *arg);
+
+static void
+tcp_connected_cb(isc_nmhandle_t *handle, isc_result_t eresult, void *arg);
 
 static void
 start_udp(dig_query_t *query);
@@ -578,6 +626,130 @@ clone_server_list(dig_serverlist_t src, dig_serverlist_t *dest) {
  * linked lists: the server list (servers to query) and the query list
  * (outstanding queries which have been made to the listed servers).
  */
+/*%
+ * Create the captured output for a lookup started with +parallel.
+ */
+static dig_output_t *
+output_create(void) {
+	dig_output_t *output = isc_mem_get(mctx, sizeof(*output));
+
+	*output = (dig_output_t){ .fp = tmpfile() };
+	if (output->fp == NULL) {
+		fatal("couldn't create a temporary file: %s", strerror(errno));
+	}
+	isc_refcount_init(&output->references, 1);
+	ISC_LINK_INIT(output, link);
+	ISC_LIST_APPEND(outputs, output, link);
+
+	return (output);
+}
+
+/*%
+ * When the last lookup sharing an output is gone, the output is
+ * complete and can be copied to standard output.
+ */
+static void
+output_detach(dig_output_t **outputp) {
+	dig_output_t *output = *outputp;
+
+	*outputp = NULL;
+	if (isc_refcount_decrement(&output->references) == 1) {
+		output->done = true;
+	}
+}
+
+/*%
+ * Point file descriptor 1 at 'output', or back at the real standard
+ * output if 'output' is NULL.
+ */
+static void
+output_switch(dig_output_t *output) {
+	if (output == current_output) {
+		return;
+	}
+
+	fflush(stdout);
+	if (stdout_fd == -1) {
+		stdout_fd = dup(STDOUT_FILENO);
+		if (stdout_fd == -1) {
+			fatal("couldn't duplicate standard output: %s",
+			      strerror(errno));
+		}
+	}
+	if (dup2(output != NULL ? fileno(output->fp) : stdout_fd,
+		 STDOUT_FILENO) == -1)
+	{
+		fatal("couldn't redirect standard output: %s",
+		      strerror(errno));
+	}
+	current_output = output;
+}
+
+/*%
+ * Copy the completed outputs to standard output and free them.
+ */
+static void
+output_flush(void) {
+	dig_output_t *output = NULL, *next = NULL;
+	char buf[BUFSIZE];
+	size_t n;
+
+	INSIST(current_output == NULL);
+
+	for (output = ISC_LIST_HEAD(outputs); output != NULL; output = next) {
+		next = ISC_LIST_NEXT(output, link);
+		if (!output->done) {
+			if (parallel_ordered) {
+				break;
+			}
+			continue;
+		}
+
+		rewind(output->fp);
+		while ((n = fread(buf, 1, sizeof(buf), output->fp)) > 0) {
+			fwrite(buf, 1, n, stdout);
+		}
+		fclose(output->fp);
+		isc_refcount_destroy(&output->references);
+		ISC_LIST_UNLINK(outputs, output, link);
+		isc_mem_put(mctx, output, sizeof(*output));
+	}
+	fflush(stdout);
+}
+
+/*%
+ * Make 'lookup' the current lookup while a callback for one of its
+ * queries runs, capturing what is printed in its output.  Without
+ * +parallel there is only one lookup running, and nothing changes.
+ */
+static void
+context_enter(dig_lookup_t *lookup, dig_context_t *saved) {
+	*saved = (dig_context_t){
+		.lookup = current_lookup,
+		.output = current_output,
+	};
+
+	if (parallel <= 1) {
+		return;
+	}
+
+	current_lookup = lookup;
+	output_switch(lookup->output);
+}
+
+static void
+context_leave(dig_context_t *saved) {
+	if (parallel <= 1) {
+		return;
+	}
+
+	current_lookup = saved->lookup;
+	output_switch(saved->output);
+	if (current_output == NULL) {
+		output_flush();
+	}
+}
+
 dig_lookup_t *
 make_empty_lookup(void) {
 	dig_lookup_t *looknew;
@@ -795,6 +967,11 @@ clone_lookup(dig_lookup_t *lookold, bool servers) {
 	looknew->dscp = lookold->dscp;
 	looknew->rrcomments = lookold->rrcomments;
 
+	if (lookold->output != NULL) {
+		(void)isc_refcount_increment(&lookold->output->references);
+		looknew->output = lookold->output;
+	}
+
 	if (lookold->ecs_addr != NULL) {
 		size_t len = sizeof(isc_sockaddr_t);
 		looknew->ecs_addr = isc_mem_allocate(mctx, len);
@@ -1519,14 +1696,14 @@ check_if_done(void) {
 		lookup = next;
 	}
 
-	if (ISC_LIST_EMPTY(lookup_list) && current_lookup == NULL &&
+	if (ISC_LIST_EMPTY(lookup_list) && nrunning == 0 &&
 	    isc_refcount_current(&sendcount) == 0)
 	{
 		INSIST(isc_refcount_current(&recvcount) == 0);
 		debug("shutting down");
 		dighost_shutdown();
 
-		if (current_lookup == NULL && keep != NULL) {
+		if (nrunning == 0 && keep != NULL) {
 			isc_nmhandle_detach(&keep);
 		}
 	}
@@ -1568,6 +1745,10 @@ _destroy_lookup(dig_lookup_t *lookup) {
 
 	isc_refcount_destroy(&lookup->references);
 
+	if (lookup->output != NULL) {
+		output_detach(&lookup->output);
+	}
+
 	s = ISC_LIST_HEAD(lookup->my_server_list);
 	while (s != NULL) {
 		debug("freeing server %p belonging to %p", s, lookup);
@@ -1660,9 +1841,17 @@ _lookup_detach(dig_lookup_t **lookupp, const char *file, unsigned int line) {
 	      isc_refcount_current(&lookup->references) - 1);
 
 	if (isc_refcount_decrement(&lookup->references) == 1) {
+		bool running = lookup->running;
+
+		if (running) {
+			ISC_LIST_UNLINK(running_lookups, lookup, link);
+			nrunning--;
+		}
 		_destroy_lookup(lookup);
 		if (lookup == current_lookup) {
 			current_lookup = NULL;
+		}
+		if (running) {
 			start_lookup();
 		}
 	}
@@ -1747,44 +1936,119 @@ _query_detach(dig_query_t **queryp, const char *file, unsigned int line) {
 }
 
 /*%
- * If we can, start the next lookup in the queue running.
- * This assumes that the lookup on the head of the queue hasn't been
- * started yet.  It also removes the lookup from the head of the queue,
- * setting the current_lookup pointer pointing to it.
+ * Return true if 'lookup' has to run on its own: +trace and +nssearch
+ * queue their followup lookups while they are running.
+ */
+static bool
+lookup_exclusive(const dig_lookup_t *lookup) {
+	return (lookup->trace || lookup->ns_search_only);
+}
+
+/*%
+ * The number of lookups that may be running at the same time.
+ */
+static unsigned int
+lookup_slots(void) {
+	dig_lookup_t *lookup = ISC_LIST_HEAD(running_lookups);
+
+	if (parallel <= 1 || keep_open ||
+	    (lookup != NULL && lookup_exclusive(lookup)))
+	{
+		return (1);
+	}
+
+	return (parallel);
+}
+
+/*%
+ * Ask for more lookups from the batch file.  Whatever is printed while
+ * parsing goes straight to standard output.
+ */
+static bool
+next_batch(void) {
+	dig_output_t *output = current_output;
+	bool queued;
+
+	output_switch(NULL);
+	queued = dighost_nextbatch();
+	output_switch(output);
+
+	return (queued);
+}
+
+/*%
+ * Move 'lookup' to the list of running lookups and start it, with
+ * current_lookup pointing to it.
+ */
+static void
+run_lookup(dig_lookup_t *lookup) {
+	dig_context_t saved;
+
+	/*
+	 * Formally, we should attach the lookup to the running list
+	 * and detach it from the lookup_list, but it would be one
+	 * attach and one detach.
+	 */
+	lookup->running = true;
+	ISC_LIST_APPEND(running_lookups, lookup, link);
+	nrunning++;
+
+	if (lookup->new_search) {
+		started_lookups++;
+	}
+	if (parallel > 1 && lookup->output == NULL) {
+		lookup->output = output_create();
+	}
+
+	context_enter(lookup, &saved);
+	current_lookup = lookup;
+	if (setup_lookup(lookup)) {
+		do_lookup(lookup);
+	} else if (next_origin(lookup)) {
+		lookup_detach(&lookup);
+	}
+	context_leave(&saved);
+}
+
+/*%
+ * If we can, start the next lookups in the queue running, as many as
+ * +parallel allows.  This assumes that the lookups on the queue haven't
+ * been started yet.  When there is room for more lookups and the queue
+ * is empty, more are read from the batch file via dighost_nextbatch().
+ *
+ * Starting a lookup may finish another one, which calls us again; that
+ * inner call does nothing and leaves the work to the loop below.
  */
 void
 start_lookup(void) {
+	static bool starting = false;
+	dig_lookup_t *lookup = NULL;
+
 	debug("start_lookup()");
 
-	if (cancel_now) {
+	if (cancel_now || starting) {
 		return;
 	}
 
-	/*
-	 * If there's a current lookup running, we really shouldn't get
-	 * here.
-	 */
-	INSIST(current_lookup == NULL);
+	starting = true;
+	while (!cancel_now && nrunning < lookup_slots()) {
+		lookup = ISC_LIST_HEAD(lookup_list);
+		if (lookup == NULL && nrunning > 0 &&
+		    dighost_nextbatch != NULL && next_batch())
+		{
+			lookup = ISC_LIST_HEAD(lookup_list);
+		}
+		if (lookup == NULL ||
+		    (nrunning > 0 && lookup_exclusive(lookup))) {
+			break;
+		}
 
-	current_lookup = ISC_LIST_HEAD(lookup_list);
+		ISC_LIST_DEQUEUE(lookup_list, lookup, link);
+		run_lookup(lookup);
+	}
+	starting = false;
 
-	/*
-	 * Put the current lookup somewhere so cancel_all can find it
-	 */
-	if (current_lookup != NULL) {
-		/*
-		 * Formally, we should attach the lookup to the current_lookup
-		 * and detach it from the lookup_list, but it would be one
-		 * attach and one detach.
-		 */
-		ISC_LIST_DEQUEUE(lookup_list, current_lookup, link);
-		if (setup_lookup(current_lookup)) {
-			do_lookup(current_lookup);
-		} else if (next_origin(current_lookup)) {
-			lookup_detach(&current_lookup);
-			start_lookup();
-		}
-	} else {
+	if (!cancel_now && nrunning == 0 && ISC_LIST_EMPTY(lookup_list)) {
 		check_if_done();
 	}
 }
@@ -2740,6 +3004,16 @@ send_done(isc_nmhandle_t *handle, isc_result_t eresult, void *arg) {
 	check_if_done();
 }
 
+static void
+send_done_cb(isc_nmhandle_t *handle, isc_result_t eresult, void *arg) {
+	dig_query_t *query = arg;
+	dig_context_t saved;
+
+	context_enter(query->lookup, &saved);
+	send_done(handle, eresult, arg);
+	context_leave(&saved);
+}
+
 /*%
  * Cancel a lookup, sending canceling reads on all existing sockets.
  */
@@ -2892,9 +3166,6 @@ failure:
 	return (NULL);
 }
 
-static void
-tcp_connected(isc_nmhandle_t *handle, isc_result_t eresult, void *arg);
-
 /*%
  * Unlike start_udp, this can't be called multiple times with the same
  * query.  When we retry TCP, we requeue the whole lookup, which should
@@ -3010,8 +3281,8 @@ start_tcp(dig_query_t *query) {
 			goto failure_tls;
 		}
 		isc_nm_tlsdnsconnect(netmgr, &localaddr, &query->sockaddr,
-				     tcp_connected, connectquery, local_timeout,
-				     tlsctx, sess_cache);
+				     tcp_connected_cb, connectquery,
+				     local_timeout, tlsctx, sess_cache);
 #if HAVE_LIBNGHTTP2
 	} else if (query->lookup->https_mode) {
 		char uri[4096] = { 0 };
@@ -3029,13 +3300,13 @@ start_tcp(dig_query_t *query) {
 		}
 
 		isc_nm_httpconnect(netmgr, &localaddr, &query->sockaddr, uri,
-				   !query->lookup->https_get, tcp_connected,
+				   !query->lookup->https_get, tcp_connected_cb,
 				   connectquery, tlsctx, sess_cache,
 				   local_timeout);
 #endif
 	} else {
 		isc_nm_tcpdnsconnect(netmgr, &localaddr, &query->sockaddr,
-				     tcp_connected, connectquery,
+				     tcp_connected_cb, connectquery,
 				     local_timeout);
 	}
 
@@ -3092,7 +3363,7 @@ send_udp(dig_query_t *query) {
 
 	isc_nmhandle_attach(query->handle, &query->sendhandle);
 
-	isc_nm_send(query->handle, &r, send_done, sendquery);
+	isc_nm_send(query->handle, &r, send_done_cb, sendquery);
 	isc_refcount_increment0(&sendcount);
 	debug("sendcount=%" PRIuFAST32, isc_refcount_current(&sendcount));
 
@@ -3219,13 +3490,23 @@ udp_ready(isc_nmhandle_t *handle, isc_result_t eresult, void *arg) {
 	debug("have local timeout of %d", local_timeout);
 	isc_nmhandle_settimeout(handle, local_timeout);
 
-	isc_nm_read(handle, recv_done, readquery);
+	isc_nm_read(handle, recv_done_cb, readquery);
 	send_udp(readquery);
 
 	query_detach(&query);
 	lookup_detach(&l);
 }
 
+static void
+udp_ready_cb(isc_nmhandle_t *handle, isc_result_t eresult, void *arg) {
+	dig_query_t *query = arg;
+	dig_context_t saved;
+
+	context_enter(query->lookup, &saved);
+	udp_ready(handle, eresult, arg);
+	context_leave(&saved);
+}
+
 /*%
  * Send a UDP packet to the remote nameserver, possible starting the
  * recv action as well.  Also make sure that the timer is running and
@@ -3287,7 +3568,7 @@ start_udp(dig_query_t *query) {
 	}
 
 	query_attach(query, &connectquery);
-	isc_nm_udpconnect(netmgr, &localaddr, &query->sockaddr, udp_ready,
+	isc_nm_udpconnect(netmgr, &localaddr, &query->sockaddr, udp_ready_cb,
 			  connectquery,
 			  (timeout ? timeout : UDP_TIMEOUT) * 1000);
 }
@@ -3444,7 +3725,7 @@ launch_next_query(dig_query_t *query) {
 
 	query_attach(query, &readquery);
 
-	isc_nm_read(query->handle, recv_done, readquery);
+	isc_nm_read(query->handle, recv_done_cb, readquery);
 
 	if (!query->first_soa_rcvd) {
 		dig_query_t *sendquery = NULL;
@@ -3462,7 +3743,7 @@ launch_next_query(dig_query_t *query) {
 		}
 
 		isc_nmhandle_attach(query->handle, &query->sendhandle);
-		isc_nm_send(query->handle, &r, send_done, sendquery);
+		isc_nm_send(query->handle, &r, send_done_cb, sendquery);
 		isc_refcount_increment0(&sendcount);
 		debug("sendcount=%" PRIuFAST32,
 		      isc_refcount_current(&sendcount));
@@ -3612,6 +3893,16 @@ tcp_connected(isc_nmhandle_t *handle, isc_result_t eresult, void *arg) {
 	lookup_detach(&l);
 }
 
+static void
+tcp_connected_cb(isc_nmhandle_t *handle, isc_result_t eresult, void *arg) {
+	dig_query_t *query = arg;
+	dig_context_t saved;
+
+	context_enter(query->lookup, &saved);
+	tcp_connected(handle, eresult, arg);
+	context_leave(&saved);
+}
+
 /*%
  * Check if the ongoing XFR needs more data before it's complete, using
  * the semantics of IXFR and AXFR protocols.  Much of the complexity of
@@ -4104,7 +4395,7 @@ recv_done(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
 		isc_refcount_increment0(&recvcount);
 		debug("recvcount=%" PRIuFAST32,
 		      isc_refcount_current(&recvcount));
-		isc_nm_read(handle, recv_done, query);
+		isc_nm_read(handle, recv_done_cb, query);
 		goto keep_query;
 	}
 
@@ -4165,7 +4456,7 @@ recv_done(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
 		isc_refcount_increment0(&recvcount);
 		debug("recvcount=%" PRIuFAST32,
 		      isc_refcount_current(&recvcount));
-		isc_nm_read(handle, recv_done, query);
+		isc_nm_read(handle, recv_done_cb, query);
 		goto keep_query;
 	}
 
@@ -4221,7 +4512,7 @@ recv_done(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
 			isc_refcount_increment0(&recvcount);
 			debug("recvcount=%" PRIuFAST32,
 			      isc_refcount_current(&recvcount));
-			isc_nm_read(handle, recv_done, query);
+			isc_nm_read(handle, recv_done_cb, query);
 			goto keep_query;
 		}
 	}
@@ -4490,6 +4781,17 @@ keep_query:
 	}
 }
 
+static void
+recv_done_cb(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
+	     void *arg) {
+	dig_query_t *query = arg;
+	dig_context_t saved;
+
+	context_enter(query->lookup, &saved);
+	recv_done(handle, eresult, region, arg);
+	context_leave(&saved);
+}
+
 /*%
  * Turn a name into an address, using system-supplied routines.  This is
  * used in looking up server names, etc... and needs to use system-supplied
@@ -4602,11 +4904,23 @@ cancel_all(void) {
 
 	cancel_now = true;
 
-	while (current_lookup != NULL) {
-		for (q = ISC_LIST_HEAD(current_lookup->q); q != NULL; q = nq) {
+	while ((l = ISC_LIST_HEAD(running_lookups)) != NULL) {
+		dig_lookup_t *hold = NULL;
+
+		/*
+		 * Hold on to the lookup while its queries are canceled, and
+		 * take it off the running list, so that destroying it does
+		 * not start another one.
+		 */
+		lookup_attach(l, &hold);
+		ISC_LIST_UNLINK(running_lookups, l, link);
+		l->running = false;
+		nrunning--;
+
+		for (q = ISC_LIST_HEAD(l->q); q != NULL; q = nq) {
 			nq = ISC_LIST_NEXT(q, link);
 			debug("canceling pending query %p, belonging to %p", q,
-			      current_lookup);
+			      l);
 			q->canceled = true;
 			if (q->readhandle != NULL &&
 			    !isc_nm_is_http_handle(q->readhandle)) {
@@ -4615,13 +4929,13 @@ cancel_all(void) {
 			query_detach(&q);
 		}
 
-		/*
-		 * current_lookup could have been detached via query_detach().
-		 */
-		if (current_lookup != NULL) {
-			lookup_detach(&current_lookup);
+		if (!l->cleared) {
+			l->cleared = true;
+			lookup_detach(&l);
 		}
+		lookup_detach(&hold);
 	}
+	current_lookup = NULL;
 	l = ISC_LIST_HEAD(lookup_list);
 	while (l != NULL) {
 		n = ISC_LIST_NEXT(l, link);
@@ -4643,9 +4957,15 @@ destroy_libs(void) {
 	isc_refcount_destroy(&sendcount);
 
 	INSIST(ISC_LIST_HEAD(lookup_list) == NULL);
+	INSIST(ISC_LIST_EMPTY(running_lookups));
 	INSIST(current_lookup == NULL);
 	INSIST(!free_now);
 
+	if (!ISC_LIST_EMPTY(outputs)) {
+		output_switch(NULL);
+		output_flush();
+	}
+
 	free_now = true;
 
 	flush_server_list();
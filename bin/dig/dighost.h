@@ -93,6 +93,7 @@ typedef struct dig_query dig_query_t;
 typedef struct dig_server dig_server_t;
 typedef ISC_LIST(dig_server_t) dig_serverlist_t;
 typedef struct dig_searchlist dig_searchlist_t;
+typedef struct dig_output dig_output_t;
 
 #define DIG_LOOKUP_MAGIC ISC_MAGIC('D', 'i', 'g', 'l')
 
@@ -117,7 +118,9 @@ struct dig_lookup {
 							     host -C */
 		ns_search_success, nsid, /*% Name Server ID (RFC 5001) */
 		onesoa, pending,	 /*%< Pending a successful answer */
-		print_unknown_format, qr, raflag, recurse, section_additional,
+		print_unknown_format, qr, raflag, recurse,
+		running, /*%< On the list of running lookups */
+		section_additional,
 		section_answer, section_authority, section_question,
 		seenbadcookie, sendcookie, servfail_stops,
 		setqid, /*% use a speciied query ID */
@@ -149,6 +152,7 @@ struct dig_lookup {
 	dig_query_t *current_query;
 	dig_serverlist_t my_server_list;
 	dig_searchlist_t *origin;
+	dig_output_t *output; /*%< Captured output with +parallel */
 	dig_query_t *xfr_q;
 	uint32_t retries;
 	int nsfound;
@@ -269,6 +273,9 @@ extern isc_loop_t *mainloop;
 extern bool free_now;
 extern bool debugging, debugtiming, memdebugging;
 extern bool keep_open;
+extern unsigned int parallel;
+extern bool parallel_ordered;
+extern unsigned int started_lookups;
 
 extern char *progname;
 extern int tries;
@@ -410,6 +417,14 @@ extern void (*dighost_trying)(char *frm, dig_lookup_t *lookup);
 
 extern void (*dighost_shutdown)(void);
 
+extern bool (*dighost_nextbatch)(void);
+/*%<
+ * Queue more lookups from the batch file, if any.  Called when there
+ * is room for another lookup to run in parallel (see +parallel) and
+ * the lookup list is empty.  Returns false when there is nothing more
+ * to queue.
+ */
+
 extern void (*dighost_pre_exit_hook)(void);
 
 void
@@ -62,6 +62,7 @@
 #include <isc/time.h>
 #include <isc/util.h>
 
+#include <dns/callbacks.h>
 #include <dns/db.h>
 #include <dns/dbiterator.h>
 #include <dns/diff.h>
@@ -140,7 +141,7 @@ static char *tempfile = NULL;
 static const dns_master_style_t *masterstyle;
 static dns_masterformat_t inputformat = dns_masterformat_text;
 static dns_masterformat_t outputformat = dns_masterformat_text;
-static uint32_t rawversion = 1, serialnum = 0;
+static uint32_t rawversion = 2, serialnum = 0;
 static bool snset = false;
 static unsigned int nsigned = 0, nretained = 0, ndropped = 0;
 static unsigned int nverified = 0, nverifyfailed = 0;
@@ -184,6 +185,10 @@ static bool output_stdout = false;
 static bool set_maxttl = false;
 static dns_ttl_t maxttl = 0;
 static bool no_max_check = false;
+static unsigned int streamwindow = 0;
+static bool streamapex = false;
+static bool incremental = false;
+static dns_dbversion_t *baseversion = NULL; /* The version as loaded */
 
 #define INCSTAT(counter)            \
 	if (printstats) {           \
@@ -482,6 +487,76 @@ setverifies(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 	}
 }
 
+/*%
+ * Returns true if 'type'/'covers' at 'node' holds the same records with
+ * the same TTL in 'gversion' as it did in 'baseversion'.
+ */
+static bool
+unchangedset(dns_dbnode_t *node, dns_rdatatype_t type,
+	     dns_rdatatype_t covers) {
+	dns_rdataset_t cur, old;
+	isc_result_t cresult, oresult;
+	bool same = false;
+
+	dns_rdataset_init(&cur);
+	dns_rdataset_init(&old);
+	cresult = dns_db_findrdataset(gdb, node, gversion, type, covers, 0,
+				      &cur, NULL);
+	oresult = dns_db_findrdataset(gdb, node, baseversion, type, covers, 0,
+				      &old, NULL);
+	if (cresult != ISC_R_SUCCESS || oresult != ISC_R_SUCCESS) {
+		same = (cresult == ISC_R_NOTFOUND && oresult == ISC_R_NOTFOUND);
+		goto cleanup;
+	}
+
+	if (cur.ttl != old.ttl ||
+	    dns_rdataset_count(&cur) != dns_rdataset_count(&old))
+	{
+		goto cleanup;
+	}
+
+	cresult = dns_rdataset_first(&cur);
+	oresult = dns_rdataset_first(&old);
+	while (cresult == ISC_R_SUCCESS && oresult == ISC_R_SUCCESS) {
+		dns_rdata_t crdata = DNS_RDATA_INIT;
+		dns_rdata_t ordata = DNS_RDATA_INIT;
+
+		dns_rdataset_current(&cur, &crdata);
+		dns_rdataset_current(&old, &ordata);
+		if (dns_rdata_compare(&crdata, &ordata) != 0) {
+			goto cleanup;
+		}
+		cresult = dns_rdataset_next(&cur);
+		oresult = dns_rdataset_next(&old);
+	}
+	same = (cresult == ISC_R_NOMORE && oresult == ISC_R_NOMORE);
+
+cleanup:
+	if (dns_rdataset_isassociated(&cur)) {
+		dns_rdataset_disassociate(&cur);
+	}
+	if (dns_rdataset_isassociated(&old)) {
+		dns_rdataset_disassociate(&old);
+	}
+	return (same);
+}
+
+/*%
+ * In incremental mode (-Y), the signatures of a set can be kept without
+ * verifying them if neither the set nor its signatures have changed
+ * since the zone was loaded: they were verified when the input zone
+ * was signed.  Anything the journal, the NSEC/NSEC3 chain rebuild or
+ * the apex updates touched is compared unequal and verified as usual.
+ */
+static bool
+settrusted(dns_dbnode_t *node, dns_rdataset_t *set) {
+	if (baseversion == NULL) {
+		return (false);
+	}
+	return (unchangedset(node, set->type, 0) &&
+		unchangedset(node, dns_rdatatype_rrsig, set->type));
+}
+
 /*%
  * Signs a set.  Goes through contortions to decide if each RRSIG should
  * be dropped or retained, and then determines if any new SIGs need to
@@ -496,6 +571,7 @@ signset(dns_diff_t *del, dns_diff_t *add, dns_dbnode_t *node, dns_name_t *name,
 	dns_dnsseckey_t *key;
 	isc_result_t result;
 	bool nosigs = false;
+	bool trusted;
 	bool *wassignedby, *nowsignedby;
 	int arraysize;
 	dns_difftuple_t *tuple;
@@ -526,6 +602,11 @@ signset(dns_diff_t *del, dns_diff_t *add, dns_dbnode_t *node, dns_name_t *name,
 
 	vbprintf(1, "%s/%s:\n", namestr, typestr);
 
+	trusted = !nosigs && settrusted(node, set);
+	if (trusted) {
+		vbprintf(2, "\tunchanged since the zone was signed\n");
+	}
+
 	arraysize = keycount;
 	if (!nosigs) {
 		arraysize += dns_rdataset_count(&sigset);
@@ -584,7 +665,8 @@ signset(dns_diff_t *del, dns_diff_t *add, dns_dbnode_t *node, dns_name_t *name,
 			wassignedby[key->index] = true;
 
 			if (!expired && rrsig.originalttl == set->ttl &&
-			    setverifies(name, set, key->key, &sigrdata))
+			    (trusted ||
+			     setverifies(name, set, key->key, &sigrdata)))
 			{
 				vbprintf(2, "\trrsig by %s retained\n", sigstr);
 				keep = true;
@@ -605,7 +687,8 @@ signset(dns_diff_t *del, dns_diff_t *add, dns_dbnode_t *node, dns_name_t *name,
 			wassignedby[key->index] = true;
 
 			if (!expired && rrsig.originalttl == set->ttl &&
-			    setverifies(name, set, key->key, &sigrdata))
+			    (trusted ||
+			     setverifies(name, set, key->key, &sigrdata)))
 			{
 				vbprintf(2, "\trrsig by %s retained\n", sigstr);
 				keep = true;
@@ -781,17 +864,32 @@ signset(dns_diff_t *del, dns_diff_t *add, dns_dbnode_t *node, dns_name_t *name,
 	isc_mem_put(mctx, nowsignedby, arraysize * sizeof(bool));
 }
 
+/*
+ * Names waiting to be hashed by isc_iterated_hash_many().
+ */
+typedef struct hashpending {
+	dns_fixedname_t fname;
+	bool speculative;
+} hashpending_t;
+
 struct hashlist {
 	unsigned char *hashbuf;
 	size_t entries;
 	size_t size;
 	size_t length;
+	unsigned int hashalg;
+	unsigned int iterations;
+	const unsigned char *salt;
+	size_t salt_len;
+	unsigned int npending;
+	hashpending_t pending[ISC_ITERATED_HASH_LANES];
 };
 
 static void
 hashlist_init(hashlist_t *l, unsigned int nodes, unsigned int length) {
 	l->entries = 0;
 	l->length = length + 1;
+	l->npending = 0;
 
 	if (nodes != 0) {
 		l->size = nodes;
@@ -833,26 +931,80 @@ hashlist_add(hashlist_t *l, const unsigned char *hash, size_t len) {
 }
 
 static void
-hashlist_add_dns_name(hashlist_t *l,
-		      /*const*/ dns_name_t *name, unsigned int hashalg,
-		      unsigned int iterations, const unsigned char *salt,
-		      size_t salt_len, bool speculative) {
+hashlist_flush(hashlist_t *l) {
 	char nametext[DNS_NAME_FORMATSIZE];
-	unsigned char hash[NSEC3_MAX_HASH_LENGTH + 1];
+	unsigned char hashes[ISC_ITERATED_HASH_LANES][NSEC3_MAX_HASH_LENGTH + 1];
+	unsigned char *out[ISC_ITERATED_HASH_LANES];
+	const unsigned char *in[ISC_ITERATED_HASH_LANES];
+	int inlength[ISC_ITERATED_HASH_LANES];
 	unsigned int len;
 	size_t i;
 
-	len = isc_iterated_hash(hash, hashalg, iterations, salt, (int)salt_len,
-				name->ndata, name->length);
-	if (verbose) {
-		dns_name_format(name, nametext, sizeof nametext);
-		for (i = 0; i < len; i++) {
-			fprintf(stderr, "%02x", hash[i]);
+	if (l->npending == 0) {
+		return;
+	}
+
+	for (i = 0; i < l->npending; i++) {
+		dns_name_t *name = dns_fixedname_name(&l->pending[i].fname);
+		out[i] = hashes[i];
+		in[i] = name->ndata;
+		inlength[i] = name->length;
+	}
+
+	len = isc_iterated_hash_many(out, l->hashalg, l->iterations, l->salt,
+				     (int)l->salt_len, in, inlength,
+				     l->npending);
+	if (len == 0) {
+		fatal("isc_iterated_hash_many failed");
+	}
+
+	for (i = 0; i < l->npending; i++) {
+		if (verbose) {
+			size_t j;
+
+			dns_name_format(dns_fixedname_name(&l->pending[i].fname),
+					nametext, sizeof nametext);
+			for (j = 0; j < len; j++) {
+				fprintf(stderr, "%02x", hashes[i][j]);
+			}
+			fprintf(stderr, " %s\n", nametext);
 		}
-		fprintf(stderr, " %s\n", nametext);
+		hashes[i][len] = l->pending[i].speculative ? 1 : 0;
+		hashlist_add(l, hashes[i], len + 1);
+	}
+	l->npending = 0;
+}
+
+/*
+ * Queue 'name' to be hashed; the pending names are hashed in parallel
+ * when the queue is full or the list is sorted.
+ */
+static void
+hashlist_add_dns_name(hashlist_t *l,
+		      /*const*/ dns_name_t *name, unsigned int hashalg,
+		      unsigned int iterations, const unsigned char *salt,
+		      size_t salt_len, bool speculative) {
+	hashpending_t *pending;
+
+	if (l->npending > 0 &&
+	    (hashalg != l->hashalg || iterations != l->iterations ||
+	     salt != l->salt || salt_len != l->salt_len))
+	{
+		hashlist_flush(l);
+	}
+
+	l->hashalg = hashalg;
+	l->iterations = iterations;
+	l->salt = salt;
+	l->salt_len = salt_len;
+
+	pending = &l->pending[l->npending++];
+	dns_name_copy(name, dns_fixedname_initname(&pending->fname));
+	pending->speculative = speculative;
+
+	if (l->npending == ISC_ITERATED_HASH_LANES) {
+		hashlist_flush(l);
 	}
-	hash[len++] = speculative ? 1 : 0;
-	hashlist_add(l, hash, len);
 }
 
 static int
@@ -862,6 +1014,7 @@ hashlist_comp(const void *a, const void *b) {
 
 static void
 hashlist_sort(hashlist_t *l) {
+	hashlist_flush(l);
 	INSIST(l->hashbuf != NULL || l->length == 0);
 	if (l->length > 0) {
 		qsort(l->hashbuf, l->entries, l->length, hashlist_comp);
@@ -2371,6 +2524,309 @@ cleanup_zone(void) {
 	dns_dbiterator_destroy(&dbiter);
 }
 
+/*
+ * Streaming mode (-B): the zone file is read in DNSSEC canonical order
+ * and only a window of names is held in the database.  A name is signed
+ * and written out as soon as the next name of the NSEC chain has been
+ * read, and is then removed from the database.
+ */
+typedef struct streamnode {
+	dns_dbnode_t *node;
+	dns_fixedname_t fname;
+	bool obscured;
+} streamnode_t;
+
+static dns_fixedname_t fstreamnext; /* The next name to sign */
+static dns_name_t *streamnext = NULL;
+static dns_fixedname_t fstreamlast; /* The last owner name read */
+static dns_name_t *streamlast = NULL;
+static dns_fixedname_t fstreamcut; /* The last zone cut signed */
+static dns_name_t *streamcut = NULL;
+static unsigned int streamloaded = 0;
+static streamnode_t *streamnodes = NULL;
+static unsigned int streamnodes_size = 0;
+
+/*%
+ * Delete all the rdatasets of 'node' once it has been written out.
+ */
+static void
+releasenode(dns_dbnode_t *node) {
+	dns_rdatasetiter_t *rdsiter = NULL;
+	dns_rdataset_t rdataset;
+	dns_rdatatype_t type, covers;
+	isc_result_t result;
+
+	dns_rdataset_init(&rdataset);
+	result = dns_db_allrdatasets(gdb, node, gversion, 0, &rdsiter);
+	check_result(result, "dns_db_allrdatasets()");
+	for (result = dns_rdatasetiter_first(rdsiter); result == ISC_R_SUCCESS;
+	     result = dns_rdatasetiter_next(rdsiter))
+	{
+		dns_rdatasetiter_current(rdsiter, &rdataset);
+		type = rdataset.type;
+		covers = rdataset.covers;
+		dns_rdataset_disassociate(&rdataset);
+		result = dns_db_deleterdataset(gdb, node, gversion, type,
+					       covers);
+		check_result(result, "dns_db_deleterdataset()");
+	}
+	if (result != ISC_R_NOMORE) {
+		fatal("rdataset iteration failed: %s",
+		      isc_result_totext(result));
+	}
+	dns_rdatasetiter_destroy(&rdsiter);
+}
+
+/*%
+ * Sign and write out 'streamnext' and the names that follow it up to the
+ * next name of the NSEC chain, which becomes the new 'streamnext'.  Only
+ * the names before 'bound' are complete; if 'bound' is NULL the whole
+ * zone has been read and the last name's NSEC points to the apex.
+ *
+ * Returns false if nothing could be written.
+ */
+static bool
+stream_step(const dns_name_t *bound) {
+	dns_dbiterator_t *dbiter = NULL;
+	dns_dbnode_t *node = NULL, *nextnode = NULL;
+	dns_fixedname_t fname, fnextname;
+	dns_name_t *name, *nextname, *zonecut;
+	bool delegation = false, dname = false, found = false;
+	unsigned int i, count = 0;
+	uint32_t nsttl = 0;
+	isc_result_t result;
+
+	if (bound != NULL && dns_name_compare(streamnext, bound) >= 0) {
+		return (false);
+	}
+
+	name = dns_fixedname_initname(&fname);
+	nextname = dns_fixedname_initname(&fnextname);
+
+	result = dns_db_createiterator(gdb, DNS_DB_NONSEC3, &dbiter);
+	check_result(result, "dns_db_createiterator()");
+	result = dns_dbiterator_seek(dbiter, streamnext);
+	check_result(result, "dns_dbiterator_seek()");
+	result = dns_dbiterator_current(dbiter, &node, name);
+	check_dns_dbiterator_current(result);
+
+	zonecut = streamcut;
+	if (is_delegation(gdb, gversion, gorigin, name, node, &nsttl)) {
+		delegation = true;
+		zonecut = name;
+	} else if (has_dname(gdb, gversion, node)) {
+		dname = true;
+		zonecut = name;
+	}
+
+	/*
+	 * Find the next name of the NSEC chain, remembering the inactive
+	 * and obscured names before it.
+	 */
+	for (result = dns_dbiterator_next(dbiter); result == ISC_R_SUCCESS;
+	     result = dns_dbiterator_next(dbiter))
+	{
+		bool active;
+
+		result = dns_dbiterator_current(dbiter, &nextnode, nextname);
+		check_dns_dbiterator_current(result);
+		if (bound != NULL && dns_name_compare(nextname, bound) >= 0) {
+			dns_db_detachnode(gdb, &nextnode);
+			break;
+		}
+		active = active_node(nextnode);
+		if (active && dns_name_issubdomain(nextname, gorigin) &&
+		    (zonecut == NULL || !dns_name_issubdomain(nextname, zonecut)))
+		{
+			dns_db_detachnode(gdb, &nextnode);
+			found = true;
+			break;
+		}
+		if (count == streamnodes_size) {
+			unsigned int newsize = streamnodes_size * 2 + 64;
+			streamnode_t *newnodes =
+				isc_mem_get(mctx, newsize * sizeof(*newnodes));
+			if (streamnodes != NULL) {
+				memmove(newnodes, streamnodes,
+					count * sizeof(*newnodes));
+				isc_mem_put(mctx, streamnodes,
+					    streamnodes_size *
+						    sizeof(*streamnodes));
+			}
+			streamnodes = newnodes;
+			streamnodes_size = newsize;
+		}
+		streamnodes[count].node = nextnode;
+		streamnodes[count].obscured = active;
+		dns_name_copy(nextname, dns_fixedname_initname(
+						&streamnodes[count].fname));
+		nextnode = NULL;
+		count++;
+	}
+	if (result != ISC_R_SUCCESS && result != ISC_R_NOMORE) {
+		fatal("iterating through the database failed: %s",
+		      isc_result_totext(result));
+	}
+	dns_dbiterator_destroy(&dbiter);
+
+	if (!found && bound != NULL) {
+		for (i = 0; i < count; i++) {
+			dns_db_detachnode(gdb, &streamnodes[i].node);
+		}
+		dns_db_detachnode(gdb, &node);
+		return (false);
+	}
+	if (!found) {
+		dns_name_copy(gorigin, nextname);
+	}
+
+	if (dns_name_equal(name, gorigin)) {
+		remove_records(node, dns_rdatatype_nsec3param, true);
+		/* Clean old rrsigs at apex. */
+		(void)active_node(node);
+	}
+	if (delegation) {
+		streamcut = savezonecut(&fstreamcut, name);
+		remove_sigs(node, true, 0);
+		if (generateds) {
+			add_ds(name, node, nsttl);
+		}
+	} else if (dname) {
+		streamcut = savezonecut(&fstreamcut, name);
+	}
+	result = dns_nsec_build(gdb, gversion, node, nextname,
+				zone_soa_min_ttl);
+	check_result(result, "dns_nsec_build()");
+	signname(node, name);
+	dumpnode(name, node);
+	releasenode(node);
+	dns_db_detachnode(gdb, &node);
+
+	/*
+	 * The names between this one and the next are not signed.
+	 */
+	for (i = 0; i < count; i++) {
+		streamnode_t *snode = &streamnodes[i];
+		dns_name_t *sname = dns_fixedname_name(&snode->fname);
+
+		if (snode->obscured) {
+			remove_sigs(snode->node, false, 0);
+			remove_records(snode->node, dns_rdatatype_nsec, false);
+		}
+		dumpnode(sname, snode->node);
+		releasenode(snode->node);
+		dns_db_detachnode(gdb, &snode->node);
+	}
+
+	dns_name_copy(nextname, streamnext);
+	return (found);
+}
+
+/*%
+ * Write out the names of the window that can be completed, and commit
+ * their removal so that their memory is freed.
+ */
+static void
+stream_flush(const dns_name_t *bound) {
+	isc_result_t result;
+
+	cleanup_zone();
+	while (stream_step(bound)) {
+		/* empty */
+	}
+
+	dns_db_closeversion(gdb, &gversion, true);
+	result = dns_db_newversion(gdb, &gversion);
+	check_result(result, "dns_db_newversion()");
+}
+
+static isc_result_t
+stream_add(void *arg, const dns_name_t *owner, dns_rdataset_t *rdataset) {
+	dns_dbnode_t *node = NULL;
+	isc_result_t result;
+
+	UNUSED(arg);
+
+	if (!dns_name_equal(owner, streamlast)) {
+		/*
+		 * The loader commits glue before the delegation it
+		 * belongs to, so a name may be followed by one of its
+		 * ancestors.
+		 */
+		if (dns_name_compare(owner, streamlast) < 0 &&
+		    !dns_name_issubdomain(streamlast, owner))
+		{
+			char namestr[DNS_NAME_FORMATSIZE];
+			dns_name_format(owner, namestr, sizeof(namestr));
+			fatal("'%s' is not in DNSSEC canonical order; "
+			      "option -B requires a sorted zone file",
+			      namestr);
+		}
+		dns_name_copy(owner, streamlast);
+		if (++streamloaded >= streamwindow) {
+			stream_flush(owner);
+			streamloaded = 0;
+		}
+	}
+
+	/*
+	 * The apex was read by loadapex().  NSEC3 chains are not kept.
+	 */
+	if (dns_name_equal(owner, gorigin) ||
+	    rdataset->type == dns_rdatatype_nsec3 ||
+	    (rdataset->type == dns_rdatatype_rrsig &&
+	     rdataset->covers == dns_rdatatype_nsec3))
+	{
+		return (ISC_R_SUCCESS);
+	}
+
+	result = dns_db_findnode(gdb, owner, true, &node);
+	check_result(result, "dns_db_findnode()");
+	result = dns_db_addrdataset(gdb, node, gversion, 0, rdataset,
+				    DNS_DBADD_MERGE, NULL);
+	dns_db_detachnode(gdb, &node);
+	if (result == DNS_R_UNCHANGED) {
+		result = ISC_R_SUCCESS;
+	}
+	return (result);
+}
+
+/*%
+ * Read and sign the zone in streaming mode.
+ */
+static void
+streamzone(const char *file) {
+	dns_rdatacallbacks_t callbacks;
+	isc_result_t result;
+
+	streamnext = dns_fixedname_initname(&fstreamnext);
+	dns_name_copy(gorigin, streamnext);
+	streamlast = dns_fixedname_initname(&fstreamlast);
+	dns_name_copy(gorigin, streamlast);
+	streamcut = NULL;
+	streamloaded = 0;
+
+	dns_rdatacallbacks_init(&callbacks);
+	callbacks.add = stream_add;
+
+	result = dns_master_loadfile(file, gorigin, gorigin, gclass, 0, 0,
+				     &callbacks, NULL, NULL, mctx,
+				     dns_masterformat_text, 0);
+	if (result != ISC_R_SUCCESS && result != DNS_R_SEENINCLUDE) {
+		fatal("failed loading zone from '%s': %s", file,
+		      isc_result_totext(result));
+	}
+
+	stream_flush(NULL);
+
+	if (streamnodes != NULL) {
+		isc_mem_put(mctx, streamnodes,
+			    streamnodes_size * sizeof(*streamnodes));
+		streamnodes = NULL;
+		streamnodes_size = 0;
+	}
+}
+
 /*
  * Generate NSEC3 records for the zone.
  */
@@ -2669,6 +3125,80 @@ loadzone(char *file, char *origin, dns_rdataclass_t rdclass, dns_db_t **db) {
 	}
 }
 
+/*%
+ * Pass the records of the zone apex on to the database callbacks in 'arg'
+ * and stop the load at the first name after the apex.
+ */
+static isc_result_t
+loadapex_add(void *arg, const dns_name_t *owner, dns_rdataset_t *rdataset) {
+	dns_rdatacallbacks_t *callbacks = arg;
+
+	if (dns_name_equal(owner, dns_db_origin(gdb))) {
+		streamapex = true;
+		return ((callbacks->add)(callbacks->add_private, owner,
+					 rdataset));
+	}
+
+	/*
+	 * Glue may be committed before the apex; streamzone() reads it.
+	 */
+	if (streamapex) {
+		return (ISC_R_CANCELED);
+	}
+	return (ISC_R_SUCCESS);
+}
+
+/*%
+ * Load only the apex of the zone, for streaming mode.
+ */
+static void
+loadapex(char *file, char *origin, dns_rdataclass_t rdclass) {
+	isc_buffer_t b;
+	int len;
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	dns_rdatacallbacks_t callbacks, dbcallbacks;
+	isc_result_t result, eresult;
+
+	len = strlen(origin);
+	isc_buffer_init(&b, origin, len);
+	isc_buffer_add(&b, len);
+
+	name = dns_fixedname_initname(&fname);
+	result = dns_name_fromtext(name, &b, dns_rootname, 0, NULL);
+	if (result != ISC_R_SUCCESS) {
+		fatal("failed converting name '%s' to dns format: %s", origin,
+		      isc_result_totext(result));
+	}
+
+	result = dns_db_create(mctx, "rbt", name, dns_dbtype_zone, rdclass, 0,
+			       NULL, &gdb);
+	check_result(result, "dns_db_create()");
+
+	dns_rdatacallbacks_init(&dbcallbacks);
+	result = dns_db_beginload(gdb, &dbcallbacks);
+	check_result(result, "dns_db_beginload()");
+
+	dns_rdatacallbacks_init(&callbacks);
+	callbacks.add = loadapex_add;
+	callbacks.add_private = &dbcallbacks;
+
+	result = dns_master_loadfile(file, name, name, rdclass, 0, 0,
+				     &callbacks, NULL, NULL, mctx,
+				     dns_masterformat_text, 0);
+	eresult = dns_db_endload(gdb, &dbcallbacks);
+	if (result == ISC_R_CANCELED || result == DNS_R_SEENINCLUDE) {
+		result = ISC_R_SUCCESS;
+	}
+	if (result == ISC_R_SUCCESS) {
+		result = eresult;
+	}
+	if (result != ISC_R_SUCCESS) {
+		fatal("failed loading zone from '%s': %s", file,
+		      isc_result_totext(result));
+	}
+}
+
 /*%
  * Finds all public zone keys in the zone, and attempts to load the
  * private keys from disk.
@@ -3272,6 +3802,9 @@ usage(void) {
 	fprintf(stderr, "\t\toutput only DNSSEC-related records\n");
 	fprintf(stderr, "\t-a:\t");
 	fprintf(stderr, "verify generated signatures\n");
+	fprintf(stderr, "\t-B window:\n");
+	fprintf(stderr, "\t\tsign a sorted zone file holding only window "
+			"names in memory\n");
 	fprintf(stderr, "\t-c class (IN)\n");
 	fprintf(stderr, "\t-E engine:\n");
 	fprintf(stderr, "\t\tname of an OpenSSL engine to use\n");
@@ -3288,6 +3821,9 @@ usage(void) {
 	fprintf(stderr, "\t-u:\t");
 	fprintf(stderr, "update or replace an existing NSEC/NSEC3 chain\n");
 	fprintf(stderr, "\t-x:\tsign DNSKEY record with KSKs only, not ZSKs\n");
+	fprintf(stderr, "\t-Y:\tincremental: keep signatures of data unchanged "
+			"since the\n\t\tinput zone was signed without "
+			"verifying them\n");
 	fprintf(stderr, "\t-z:\tsign all records with KSKs\n");
 	fprintf(stderr, "\t-C:\tgenerate a keyset file, for compatibility\n"
 			"\t\twith older versions of dnssec-signzone -g\n");
@@ -3378,10 +3914,10 @@ main(int argc, char *argv[]) {
 	atomic_init(&shuttingdown, false);
 	atomic_init(&finished, false);
 
-	/* Unused letters: Bb G J q Yy (and F is reserved). */
-#define CMDLINE_FLAGS                                                        \
-	"3:AaCc:Dd:E:e:f:FghH:i:I:j:J:K:k:L:l:m:M:n:N:o:O:PpQqRr:s:ST:tuUv:" \
-	"VX:xzZ:"
+	/* Unused letters: b G y (and F is reserved). */
+#define CMDLINE_FLAGS                                                          \
+	"3:AaB:Cc:Dd:E:e:f:FghH:i:I:j:J:K:k:L:l:m:M:n:N:o:O:PpQqRr:s:ST:tuUv:" \
+	"VX:xYzZ:"
 
 	/*
 	 * Process memory debugging argument first.
@@ -3443,6 +3979,16 @@ main(int argc, char *argv[]) {
 			tryverify = true;
 			break;
 
+		case 'B':
+			endp = NULL;
+			streamwindow = strtoul(isc_commandline_argument, &endp,
+					       0);
+			if (*endp != '\0' || streamwindow == 0) {
+				fatal("window size must be numeric and "
+				      "positive");
+			}
+			break;
+
 		case 'C':
 			make_keyset = true;
 			break;
@@ -3654,6 +4200,10 @@ main(int argc, char *argv[]) {
 			keyset_kskonly = true;
 			break;
 
+		case 'Y':
+			incremental = true;
+			break;
+
 		case 'z':
 			ignore_kskflag = true;
 			break;
@@ -3791,7 +4341,7 @@ main(int argc, char *argv[]) {
 			outputformat = dns_masterformat_raw;
 			rawversion = strtol(outputformatstr + 4, &end, 10);
 			if (end == outputformatstr + 4 || *end != '\0' ||
-			    rawversion > 1U) {
+			    rawversion > 2U) {
 				fprintf(stderr, "unknown raw format version\n");
 				exit(1);
 			}
@@ -3828,13 +4378,42 @@ main(int argc, char *argv[]) {
 		fatal("option -D cannot be used with -M");
 	}
 
+	if (streamwindow != 0) {
+		if (inputformat != dns_masterformat_text ||
+		    outputformat != dns_masterformat_text)
+		{
+			fatal("option -B can only be used with \"-I text\" "
+			      "and \"-O text\"");
+		}
+		if (journal != NULL) {
+			fatal("option -B cannot be used with -J");
+		}
+		if (nonsecify) {
+			fatal("option -B cannot be used with -Z nonsecify");
+		}
+		if (!disable_zone_check) {
+			fatal("option -B requires -P; the signed zone can be "
+			      "verified with dnssec-verify");
+		}
+		if (incremental) {
+			fatal("option -B cannot be used with -Y");
+		}
+	}
+
 	result = dns_master_stylecreate(&dsstyle, DNS_STYLEFLAG_NO_TTL, 0, 24,
 					0, 0, 0, 8, 0xffffffff, mctx);
 	check_result(result, "dns_master_stylecreate");
 
 	gdb = NULL;
 	TIME_NOW(&timer_start);
-	loadzone(file, origin, rdclass, &gdb);
+	if (streamwindow != 0) {
+		loadapex(file, origin, rdclass);
+	} else {
+		loadzone(file, origin, rdclass, &gdb);
+	}
+	if (incremental) {
+		dns_db_currentversion(gdb, &baseversion);
+	}
 	if (journal != NULL) {
 		loadjournal(mctx, gdb, journal);
 	}
@@ -3864,6 +4443,10 @@ main(int argc, char *argv[]) {
 		set_nsec3params(update_chain, set_salt, set_optout, set_iter);
 	}
 
+	if (streamwindow != 0 && IS_NSEC3) {
+		fatal("option -B cannot be used with NSEC3");
+	}
+
 	/*
 	 * We need to do this early on, as we start messing with the list
 	 * of keys rather early.
@@ -3975,7 +4558,7 @@ main(int argc, char *argv[]) {
 	/* Remove duplicates and cap TTLs at maxttl */
 	cleanup_zone();
 
-	if (!nonsecify) {
+	if (!nonsecify && streamwindow == 0) {
 		if (IS_NSEC3) {
 			nsec3ify(dns_hash_sha1, nsec3iter, gsalt, salt_length,
 				 &hashlist);
@@ -4025,10 +4608,18 @@ main(int argc, char *argv[]) {
 		isc_mutex_init(&statslock);
 	}
 
-	presign();
 	TIME_NOW(&sign_start);
-	signapex();
-	if (!atomic_load(&finished)) {
+	if (streamwindow != 0) {
+		/*
+		 * The zone is read, signed and written out a window of
+		 * names at a time.
+		 */
+		streamzone(file);
+	} else {
+		presign();
+		signapex();
+	}
+	if (streamwindow == 0 && !atomic_load(&finished)) {
 		/*
 		 * There is more work to do.  Spread it out over multiple
 		 * processors if possible.
@@ -4048,7 +4639,9 @@ main(int argc, char *argv[]) {
 		isc_mem_put(mctx, tasks, ntasks * sizeof(isc_task_t *));
 	}
 	atomic_store(&shuttingdown, true);
-	postsign();
+	if (streamwindow == 0) {
+		postsign();
+	}
 	TIME_NOW(&sign_finish);
 
 	if (disable_zone_check) {
@@ -4056,7 +4649,7 @@ main(int argc, char *argv[]) {
 	} else {
 		vresult = dns_zoneverify_dnssec(NULL, gdb, gversion, gorigin,
 						NULL, mctx, ignore_kskflag,
-						keyset_kskonly, report);
+						keyset_kskonly, ntasks, report);
 		if (vresult != ISC_R_SUCCESS) {
 			fprintf(output_stdout ? stderr : stdout,
 				"Zone verification failed (%s)\n",
@@ -4073,6 +4666,9 @@ main(int argc, char *argv[]) {
 			header.flags = DNS_MASTERRAW_SOURCESERIALSET;
 			header.sourceserial = serialnum;
 		}
+		if (rawversion == 1U) {
+			header.flags |= DNS_MASTERRAW_COMPAT1;
+		}
 		result = dns_master_dumptostream(mctx, gdb, gversion,
 						 masterstyle, outputformat,
 						 &header, outfp);
@@ -4097,6 +4693,9 @@ main(int argc, char *argv[]) {
 	}
 
 	dns_db_closeversion(gdb, &gversion, false);
+	if (baseversion != NULL) {
+		dns_db_closeversion(gdb, &baseversion, false);
+	}
 	dns_db_detach(&gdb);
 
 	hashlist_free(&hashlist);
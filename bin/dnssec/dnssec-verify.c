@@ -75,6 +75,7 @@ static dns_rdataclass_t gclass;		 /* The class */
 static dns_name_t *gorigin = NULL;	 /* The database origin */
 static bool ignore_kskflag = false;
 static bool keyset_kskonly = false;
+static unsigned int nthreads = 0;
 
 static void
 report(const char *format, ...) {
@@ -161,6 +162,7 @@ usage(void) {
 	fprintf(stderr, "\t-c class (IN)\n");
 	fprintf(stderr, "\t-E engine:\n");
 	fprintf(stderr, "\t\tname of an OpenSSL engine to use\n");
+	fprintf(stderr, "\t-n ncpus (number of cpus present)\n");
 	fprintf(stderr, "\t-x:\tDNSKEY record signed with KSKs only, "
 			"not ZSKs\n");
 	fprintf(stderr, "\t-z:\tAll records signed with KSKs\n");
@@ -179,7 +181,7 @@ main(int argc, char *argv[]) {
 	char *endp;
 	int ch;
 
-#define CMDLINE_FLAGS "c:E:hJ:m:o:I:qv:Vxz"
+#define CMDLINE_FLAGS "c:E:hJ:m:n:o:I:qv:Vxz"
 
 	/*
 	 * Process memory debugging argument first.
@@ -231,6 +233,14 @@ main(int argc, char *argv[]) {
 		case 'm':
 			break;
 
+		case 'n':
+			endp = NULL;
+			nthreads = strtol(isc_commandline_argument, &endp, 0);
+			if (*endp != '\0' || nthreads > INT32_MAX) {
+				fatal("number of cpus must be numeric");
+			}
+			break;
+
 		case 'o':
 			origin = isc_commandline_argument;
 			break;
@@ -285,6 +295,10 @@ main(int argc, char *argv[]) {
 
 	isc_stdtime_get(&now);
 
+	if (nthreads == 0) {
+		nthreads = isc_os_ncpus();
+	}
+
 	rdclass = strtoclass(classname);
 
 	setup_logging(mctx, &log);
@@ -332,7 +346,8 @@ main(int argc, char *argv[]) {
 	check_result(result, "dns_db_newversion()");
 
 	result = dns_zoneverify_dnssec(NULL, gdb, gversion, gorigin, NULL, mctx,
-				       ignore_kskflag, keyset_kskonly, report);
+				       ignore_kskflag, keyset_kskonly, nthreads,
+				       report);
 
 	dns_db_closeversion(gdb, &gversion, false);
 	dns_db_detach(&gdb);
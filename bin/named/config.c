@@ -47,15 +47,20 @@
 /*% default configuration */
 static char defaultconf[] = "\
 options {\n\
+	adb-save-interval 0;\n\
+	allow-proxy {none;};\n\
 	answer-cookie true;\n\
 	automatic-interface-scan yes;\n\
 	bindkeys-file \"" NAMED_SYSCONFDIR "/bind.keys\";\n\
-#	blackhole {none;};\n"
+#	blackhole {none;};\n\
+	concurrent-zone-dumps 4;\n\
+	concurrent-zone-loads 8;\n"
 			    "	cookie-algorithm siphash24;\n"
 			    "	coresize default;\n\
 	datasize default;\n"
 			    "\
 #	directory <none>\n\
+	dnssec-key-pool-depth 0;\n\
 	dnssec-policy \"none\";\n\
 	dump-file \"named_dump.db\";\n\
 	edns-udp-size 1232;\n\
@@ -70,18 +75,24 @@ options {\n\
 			    "\
 	heartbeat-interval 60;\n\
 	interface-interval 60;\n\
+	io-uring no;\n\
+	kernel-tls no;\n\
 	listen-on {any;};\n\
 	listen-on-v6 {any;};\n\
 #	lock-file \"" NAMED_LOCALSTATEDIR "/run/named/named.lock\";\n\
+	loop-stall-threshold 500;\n\
 	match-mapped-addresses no;\n\
 	max-ixfr-ratio 100%;\n\
 	max-rsa-exponent-size 0; /* no limit */\n\
 	max-udp-size 1232;\n\
+	memprof-file \"named.memprof\";\n\
 	memstatistics-file \"named.memstats\";\n\
 	nocookie-udp-size 4096;\n\
 	notify-rate 20;\n\
 	nta-lifetime 3600;\n\
 	nta-recheck 300;\n\
+	outgoing-tcp-idle-timeout 100;\n\
+	outgoing-tcp-pool-size 0;\n\
 #	pid-file \"" NAMED_LOCALSTATEDIR "/run/named/named.pid\"; \n\
 	port 53;\n"
 #if HAVE_SO_REUSEPORT_LB
@@ -102,6 +113,8 @@ options {\n\
 #endif
 			    "\
 	prefetch 2 9;\n\
+	prefetch-popular 0;\n\
+	prefetch-popular-rate 20;\n\
 	recursing-file \"named.recursing\";\n\
 	recursive-clients 1000;\n\
 	request-nsid false;\n\
@@ -129,12 +142,14 @@ options {\n\
 #	tkey-dhkey <none>\n\
 #	tkey-domain <none>\n\
 #	tkey-gssapi-credential <none>\n\
+	transfer-cache-size 32M;\n\
 	transfer-message-size 20480;\n\
 	transfers-in 10;\n\
 	transfers-out 10;\n\
 	transfers-per-ns 2;\n\
 	trust-anchor-telemetry yes;\n\
 	udp-receive-buffer 0;\n\
+	udp-send-batching no;\n\
 	udp-send-buffer 0;\n\
 \n\
 	/* view */\n\
@@ -146,6 +161,8 @@ options {\n\
 	allow-recursion-on { any; };\n\
 	allow-update-forwarding {none;};\n\
 	auth-nxdomain false;\n\
+	cache-cold-tier-size 1G;\n\
+	cache-eviction-policy lru;\n\
 	check-dup-records warn;\n\
 	check-mx warn;\n\
 	check-names primary fail;\n\
@@ -154,6 +171,7 @@ options {\n\
 	check-spf warn;\n\
 	clients-per-query 10;\n\
 	dnssec-accept-expired no;\n\
+	dnssec-offload-threshold 50;\n\
 	dnssec-validation " VALIDATION_DEFAULT "; \n"
 #ifdef HAVE_DNSTAP
 			    "	dnstap-identity hostname;\n"
@@ -170,6 +188,7 @@ options {\n\
 	max-cache-ttl 604800; /* 1 week */\n\
 	max-clients-per-query 100;\n\
 	max-ncache-ttl 10800; /* 3 hours */\n\
+	max-queries-per-forwarder 0;\n\
 	max-recursion-depth 7;\n\
 	max-recursion-queries 100;\n\
 	max-stale-ttl 86400; /* 1 day */\n\
@@ -191,15 +210,18 @@ options {\n\
 	request-expire true;\n\
 	request-ixfr true;\n\
 	require-server-cookie no;\n\
+	resolver-hedge-queries 0;\n\
 	resolver-nonbackoff-tries 3;\n\
 	resolver-retry-interval 800; /* in milliseconds */\n\
 	root-key-sentinel yes;\n\
 	servfail-ttl 1;\n\
+	share-fetches no;\n\
 #	sortlist <none>\n\
 	stale-answer-client-timeout off;\n\
 	stale-answer-enable false;\n\
 	stale-answer-ttl 30; /* 30 seconds */\n\
 	stale-cache-enable false;\n\
+	stale-refresh-rate 0;\n\
 	stale-refresh-time 30; /* 30 seconds */\n\
 	synth-from-dnssec yes;\n\
 #	topology <none>\n\
@@ -214,6 +236,7 @@ options {\n\
 #	also-notify <none>\n\
 	alt-transfer-source *;\n\
 	alt-transfer-source-v6 *;\n\
+	answer-cache no;\n\
 	check-integrity yes;\n\
 	check-mx-cname warn;\n\
 	check-sibling yes;\n\
@@ -228,6 +251,7 @@ options {\n\
 #	forwarders <none>\n\
 #	inline-signing no;\n\
 	ixfr-from-differences false;\n\
+	journal-group-commit no;\n\
 	max-journal-size default;\n\
 	max-records 0;\n\
 	max-refresh-time 2419200; /* 4 weeks */\n\
@@ -242,9 +266,13 @@ options {\n\
 	notify yes;\n\
 	notify-delay 5;\n\
 	notify-to-soa no;\n\
+	on-demand-idle-time 0;\n\
+	reload-in-place no;\n\
 	serial-update-method increment;\n\
+	share-zone-data no;\n\
 	sig-signing-nodes 100;\n\
 	sig-signing-signatures 10;\n\
+	sig-signing-threads 1;\n\
 	sig-signing-type 65534;\n\
 	sig-validity-interval 30; /* days */\n\
 	dnskey-sig-validity 0; /* default: sig-validity-interval */\n\
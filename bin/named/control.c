@@ -203,6 +203,8 @@ named_control_docommand(isccc_sexpr_t *message, bool readonly,
 		   command_compare(command, NAMED_COMMAND_MODZONE))
 	{
 		result = named_server_changezone(named_g_server, cmdline, text);
+	} else if (command_compare(command, NAMED_COMMAND_ADDZONES)) {
+		result = named_server_addzones(named_g_server, lex, text);
 	} else if (command_compare(command, NAMED_COMMAND_DELZONE)) {
 		result = named_server_delzone(named_g_server, lex, text);
 	} else if (command_compare(command, NAMED_COMMAND_DNSSEC)) {
@@ -230,6 +232,10 @@ named_control_docommand(isccc_sexpr_t *message, bool readonly,
 		   command_compare(command, NAMED_COMMAND_SIGN))
 	{
 		result = named_server_rekey(named_g_server, lex, text);
+	} else if (command_compare(command, NAMED_COMMAND_LOCKPROFILE)) {
+		result = named_server_lockprofile(named_g_server, lex, text);
+	} else if (command_compare(command, NAMED_COMMAND_MEMPROF)) {
+		result = named_server_memprof(named_g_server, lex, text);
 	} else if (command_compare(command, NAMED_COMMAND_MKEYS)) {
 		result = named_server_mkeys(named_g_server, lex, text);
 	} else if (command_compare(command, NAMED_COMMAND_NOTIFY)) {
@@ -266,6 +272,8 @@ named_control_docommand(isccc_sexpr_t *message, bool readonly,
 		result = named_server_showzone(named_g_server, lex, text);
 	} else if (command_compare(command, NAMED_COMMAND_SIGNING)) {
 		result = named_server_signing(named_g_server, lex, text);
+	} else if (command_compare(command, NAMED_COMMAND_SNAPCACHE)) {
+		result = named_server_snapshotcache(named_g_server, lex, text);
 	} else if (command_compare(command, NAMED_COMMAND_STATUS)) {
 		result = named_server_status(named_g_server, text);
 	} else if (command_compare(command, NAMED_COMMAND_SYNC)) {
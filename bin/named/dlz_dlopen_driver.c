@@ -48,6 +48,7 @@ typedef struct dlopen_data {
 	dlz_dlopen_lookup_t *dlz_lookup;
 	dlz_dlopen_authority_t *dlz_authority;
 	dlz_dlopen_allnodes_t *dlz_allnodes;
+	dlz_dlopen_allnodes_from_t *dlz_allnodes_from;
 	dlz_dlopen_allowzonexfr_t *dlz_allowzonexfr;
 	dlz_dlopen_newversion_t *dlz_newversion;
 	dlz_dlopen_closeversion_t *dlz_closeversion;
@@ -108,6 +109,26 @@ dlopen_dlz_allnodes(const char *zone, void *driverarg, void *dbdata,
 	return (result);
 }
 
+static isc_result_t
+dlopen_dlz_allnodesfrom(const char *zone, const char *start,
+			unsigned int maxnodes, void *driverarg, void *dbdata,
+			dns_sdlzallnodes_t *allnodes) {
+	dlopen_data_t *cd = (dlopen_data_t *)dbdata;
+	isc_result_t result;
+
+	UNUSED(driverarg);
+
+	if (cd->dlz_allnodes_from == NULL) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	MAYBE_LOCK(cd);
+	result = cd->dlz_allnodes_from(zone, start, maxnodes, cd->dbdata,
+				       allnodes);
+	MAYBE_UNLOCK(cd);
+	return (result);
+}
+
 static isc_result_t
 dlopen_dlz_allowzonexfr(void *driverarg, void *dbdata, const char *name,
 			const char *client) {
@@ -268,8 +289,11 @@ dlopen_dlz_create(const char *dlzname, unsigned int argc, char *argv[],
 
 	cd->dlz_allowzonexfr = (dlz_dlopen_allowzonexfr_t *)dl_load_symbol(
 		cd, "dlz_allowzonexfr", false);
+	cd->dlz_allnodes_from = (dlz_dlopen_allnodes_from_t *)dl_load_symbol(
+		cd, "dlz_allnodes_from", false);
 	cd->dlz_allnodes = (dlz_dlopen_allnodes_t *)dl_load_symbol(
-		cd, "dlz_allnodes", (cd->dlz_allowzonexfr != NULL));
+		cd, "dlz_allnodes",
+		(cd->dlz_allowzonexfr != NULL && cd->dlz_allnodes_from == NULL));
 	cd->dlz_authority = (dlz_dlopen_authority_t *)dl_load_symbol(
 		cd, "dlz_authority", false);
 	cd->dlz_newversion = (dlz_dlopen_newversion_t *)dl_load_symbol(
@@ -513,7 +537,7 @@ static dns_sdlzmethods_t dlz_dlopen_methods = {
 	dlopen_dlz_lookup,	 dlopen_dlz_authority,	dlopen_dlz_allnodes,
 	dlopen_dlz_allowzonexfr, dlopen_dlz_newversion, dlopen_dlz_closeversion,
 	dlopen_dlz_configure,	 dlopen_dlz_ssumatch,	dlopen_dlz_addrdataset,
-	dlopen_dlz_subrdataset,	 dlopen_dlz_delrdataset
+	dlopen_dlz_subrdataset,	 dlopen_dlz_delrdataset, dlopen_dlz_allnodesfrom
 };
 
 /*
@@ -56,6 +56,7 @@
 #define NAMED_COMMAND_SIGN	   "sign"
 #define NAMED_COMMAND_LOADKEYS	   "loadkeys"
 #define NAMED_COMMAND_ADDZONE	   "addzone"
+#define NAMED_COMMAND_ADDZONES	   "addzones"
 #define NAMED_COMMAND_MODZONE	   "modzone"
 #define NAMED_COMMAND_DELZONE	   "delzone"
 #define NAMED_COMMAND_SHOWZONE	   "showzone"
@@ -71,6 +72,9 @@
 #define NAMED_COMMAND_TCPTIMEOUTS  "tcp-timeouts"
 #define NAMED_COMMAND_SERVESTALE   "serve-stale"
 #define NAMED_COMMAND_FETCHLIMIT   "fetchlimit"
+#define NAMED_COMMAND_SNAPCACHE	   "snapshot-cache"
+#define NAMED_COMMAND_LOCKPROFILE  "lock-profile"
+#define NAMED_COMMAND_MEMPROF	   "memprof"
 
 isc_result_t
 named_controls_create(named_server_t *server, named_controls_t **ctrlsp);
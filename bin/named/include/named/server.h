@@ -20,6 +20,7 @@
 
 #include <isc/log.h>
 #include <isc/magic.h>
+#include <isc/mutex.h>
 #include <isc/quota.h>
 #include <isc/signal.h>
 #include <isc/sockaddr.h>
@@ -63,6 +64,7 @@ struct named_server {
 	char *bindkeysfile; /*%< bind.keys file name
 			     * */
 	char *recfile;	    /*%< Recursive file name */
+	char *memproffile;  /*%< Heap profile file name */
 	bool  version_set;  /*%< User has set version
 			     * */
 	char *version;	    /*%< User-specified version */
@@ -75,6 +77,10 @@ struct named_server {
 	dns_loadmgr_t	  *loadmgr;
 	dns_zonemgr_t	  *zonemgr;
 	dns_viewlist_t	   viewlist;
+	dns_aclindex_t	  *matchclients; /*%< Index of the views'
+					  * match-clients ACLs */
+	dns_aclindex_t	  *matchdestinations; /*%< ... and of their
+					       * match-destinations */
 	dns_kasplist_t	   kasplist;
 	ns_interfacemgr_t *interfacemgr;
 	dns_db_t	  *in_roothints;
@@ -83,9 +89,11 @@ struct named_server {
 	isc_timer_t *heartbeat_timer;
 	isc_timer_t *pps_timer;
 	isc_timer_t *tat_timer;
+	isc_timer_t *adb_timer;
 
 	uint32_t interface_interval;
 	uint32_t heartbeat_interval;
+	uint32_t adb_save_interval;
 
 	atomic_int reload_status;
 
@@ -101,6 +109,15 @@ struct named_server {
 	unsigned int	     dispatchgen;
 	named_dispatchlist_t dispatches;
 
+	uint64_t zonecfg_context; /*%< Fingerprint of the configuration
+				   * around the zones being configured;
+				   * 0 outside of configure_view() */
+	struct zonecfg_batch *zonecfg_batch; /*%< Zones being configured
+					      * in parallel; NULL outside
+					      * of configure_view() */
+	isc_mutex_t zonecfg_lock; /*%< Serializes the zone configuration
+				   * steps that touch shared state */
+
 	named_statschannellist_t statschannels;
 
 	dns_tsigkey_t *sessionkey;
@@ -220,6 +237,19 @@ named_server_saventa(named_server_t *server);
 isc_result_t
 named_server_loadnta(named_server_t *server);
 
+/*%
+ * Save what the ADB of each view knows about remote servers to files.
+ */
+isc_result_t
+named_server_saveadb(named_server_t *server);
+
+/*%
+ * Seed the ADB of each view from the files written by
+ * named_server_saveadb().
+ */
+isc_result_t
+named_server_loadadb(named_server_t *server);
+
 /*%
  * Dump the current statistics to the statistics file.
  */
@@ -252,6 +282,14 @@ named_server_setdebuglevel(named_server_t *server, isc_lex_t *lex);
 isc_result_t
 named_server_flushcache(named_server_t *server, isc_lex_t *lex);
 
+/*%
+ * Write a snapshot of the server's cache(s), or of the cache of the
+ * given view, to the configured cache-snapshot-file.
+ */
+isc_result_t
+named_server_snapshotcache(named_server_t *server, isc_lex_t *lex,
+			   isc_buffer_t **text);
+
 /*%
  * Flush a particular name from the server's cache.  If 'tree' is false,
  * also flush the name from the ADB and badcache.  If 'tree' is true, also
@@ -328,6 +366,14 @@ isc_result_t
 named_server_changezone(named_server_t *server, char *command,
 			isc_buffer_t **text);
 
+/*%
+ * Adds all the zones defined in a file to a running process, in a
+ * single exclusive section and a single NZD transaction
+ */
+isc_result_t
+named_server_addzones(named_server_t *server, isc_lex_t *lex,
+		      isc_buffer_t **text);
+
 /*%
  * Deletes a zone from a running process
  */
@@ -412,3 +458,18 @@ named_server_servestale(named_server_t *server, isc_lex_t *lex,
 isc_result_t
 named_server_fetchlimit(named_server_t *server, isc_lex_t *lex,
 			isc_buffer_t **text);
+
+/*%
+ * Report the lock contention profile, or reset it.
+ */
+isc_result_t
+named_server_lockprofile(named_server_t *server, isc_lex_t *lex,
+			 isc_buffer_t **text);
+
+/*%
+ * Start, stop or reset the sampling heap profiler, or dump the heap
+ * profile.
+ */
+isc_result_t
+named_server_memprof(named_server_t *server, isc_lex_t *lex,
+		     isc_buffer_t **text);
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file
+ * \brief
+ * The startup timeline: the wall clock time, CPU time and memory taken
+ * by each phase of the startup of named, and the zones that were the
+ * slowest to configure and to load.
+ *
+ * Phases nest: the time spent in a phase started while another is in
+ * progress is only charged to the inner phase.  Once the startup is
+ * complete (named_startup_done()), the timeline no longer changes.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/lang.h>
+
+#include <dns/name.h>
+
+/*%
+ * Number of slowest zones kept for each of the zone phases.
+ */
+#define NAMED_STARTUP_TOPZONES 10
+
+typedef enum {
+	named_startup_configure = 0, /*%< load_configuration() */
+	named_startup_parse,	     /*%< parsing the configuration files */
+	named_startup_views,	     /*%< configuring views */
+	named_startup_zones,	     /*%< configuring zones */
+	named_startup_keys,	     /*%< loading trust anchors */
+	named_startup_interfaces,    /*%< scanning the interfaces */
+	named_startup_load,	     /*%< loading zones */
+	named_startup_max
+} named_startup_phase_t;
+
+typedef struct named_startup_stats {
+	uint64_t wall;	 /*%< wall clock time, in microseconds */
+	uint64_t cpu;	 /*%< CPU time of the process, in microseconds */
+	int64_t	 memory; /*%< change in memory in use, in bytes */
+} named_startup_stats_t;
+
+typedef struct named_startup_zone {
+	char	 name[DNS_NAME_FORMATSIZE];
+	uint64_t usecs;
+} named_startup_zone_t;
+
+ISC_LANG_BEGINDECLS
+
+void
+named_startup_begin(named_startup_phase_t phase);
+/*%<
+ * Start 'phase', suspending the phase in progress, if any.
+ */
+
+void
+named_startup_end(named_startup_phase_t phase);
+/*%<
+ * End 'phase', along with any phase started since and not yet ended,
+ * and resume the phase that was in progress when it started.  Nothing
+ * is done if 'phase' is not in progress.
+ */
+
+void
+named_startup_zone(named_startup_phase_t phase, const char *name,
+		   uint64_t usecs);
+/*%<
+ * Record that it took 'usecs' microseconds to configure (when 'phase' is
+ * named_startup_zones) or to load (named_startup_load) the zone 'name',
+ * keeping it if it is one of the slowest NAMED_STARTUP_TOPZONES.
+ */
+
+void
+named_startup_done(void);
+/*%<
+ * End the startup timeline and log it.
+ */
+
+bool
+named_startup_isdone(void);
+/*%<
+ * Return true once named_startup_done() has been called; the functions
+ * below may only be called after that.
+ */
+
+uint64_t
+named_startup_gettotal(void);
+/*%<
+ * Return the wall clock time from the boot of named to the end of the
+ * startup, in microseconds.
+ */
+
+const char *
+named_startup_phasename(named_startup_phase_t phase);
+
+void
+named_startup_getstats(named_startup_phase_t phase,
+		       named_startup_stats_t *stats);
+/*%<
+ * Return the name of 'phase' and what it took.
+ */
+
+unsigned int
+named_startup_getzones(named_startup_phase_t phase,
+		       const named_startup_zone_t **zonesp);
+/*%<
+ * Point '*zonesp' at the slowest zones of 'phase', slowest first, and
+ * return their number.
+ */
+
+ISC_LANG_ENDDECLS
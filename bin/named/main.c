@@ -126,6 +126,8 @@ static int maxudp = 0;
 /*
  * -T options:
  */
+static bool asynclog = false;
+static bool cpuaffinity = false;
 static bool dropedns = false;
 static bool ednsformerr = false;
 static bool ednsnotimp = false;
@@ -315,7 +317,7 @@ usage(void) {
 			"username] [-U listeners]\n"
 			"             [-X lockfile] [-m "
 			"{usage|trace|record|size|mctx}]\n"
-			"             [-M fill|nofill]\n"
+			"             [-M fill|nofill|hugepages|nohugepages]\n"
 			"usage: named [-v|-V|-C]\n");
 }
 
@@ -421,6 +423,8 @@ static struct flag_def {
 			{ NULL, 0, false } },
   mem_context_flags[] = { { "fill", ISC_MEMFLAG_FILL, false },
 			  { "nofill", ISC_MEMFLAG_FILL, true },
+			  { "hugepages", ISC_MEMFLAG_HUGEPAGES, false },
+			  { "nohugepages", ISC_MEMFLAG_HUGEPAGES, true },
 			  { NULL, 0, false } };
 
 static void
@@ -611,7 +615,11 @@ parse_T_opt(char *option) {
 	 * dscp=x:     check that dscp values are as
 	 * 	       expected and assert otherwise.
 	 */
-	if (!strcmp(option, "dropedns")) {
+	if (!strcmp(option, "asynclog")) {
+		asynclog = true;
+	} else if (!strcmp(option, "cpuaffinity")) {
+		cpuaffinity = true;
+	} else if (!strcmp(option, "dropedns")) {
 		dropedns = true;
 	} else if (!strncmp(option, "dscp=", 5)) {
 		isc_dscp_check_value = atoi(option + 5);
@@ -926,6 +934,14 @@ create_managers(void) {
 	isc_managers_create(&named_g_mctx, named_g_cpus, &named_g_loopmgr,
 			    &named_g_netmgr, &named_g_taskmgr);
 
+	if (cpuaffinity) {
+		isc_loopmgr_setaffinity(named_g_loopmgr, true);
+	}
+
+	if (asynclog) {
+		isc_log_setasync(named_g_lctx, true);
+	}
+
 	isc_nm_maxudp(named_g_netmgr, maxudp);
 
 	return (ISC_R_SUCCESS);
@@ -190,6 +190,22 @@ linux_initialprivs(void) {
 	 */
 	SET_CAP(CAP_CHOWN);
 
+#if HAVE_AF_XDP
+	/*
+	 * We need to load and attach the XDP program and to create the
+	 * AF_XDP sockets for "af-xdp-interface" when loading the
+	 * configuration for the first time.
+	 */
+	SET_CAP(CAP_NET_ADMIN);
+	SET_CAP(CAP_NET_RAW);
+	SET_CAP(CAP_IPC_LOCK);
+#ifdef CAP_BPF
+	SET_CAP(CAP_BPF);
+#else  /* ifdef CAP_BPF */
+	SET_CAP(CAP_SYS_ADMIN);
+#endif /* ifdef CAP_BPF */
+#endif /* HAVE_AF_XDP */
+
 	linux_setcaps(caps);
 
 	FREE_CAP;
@@ -32,16 +32,21 @@
 #include <isc/attributes.h>
 #include <isc/base64.h>
 #include <isc/commandline.h>
+#include <isc/condition.h>
 #include <isc/dir.h>
 #include <isc/file.h>
 #include <isc/hash.h>
 #include <isc/hex.h>
+#include <isc/histo.h>
 #include <isc/hmac.h>
+#include <isc/ht.h>
 #include <isc/httpd.h>
+#include <isc/lockprof.h>
 #include <isc/job.h>
 #include <isc/lex.h>
 #include <isc/loop.h>
 #include <isc/meminfo.h>
+#include <isc/memprof.h>
 #include <isc/netmgr.h>
 #include <isc/nonce.h>
 #include <isc/parseint.h>
@@ -58,7 +63,9 @@
 #include <isc/string.h>
 #include <isc/task.h>
 #include <isc/timer.h>
+#include <isc/tls.h>
 #include <isc/util.h>
+#include <isc/work.h>
 
 #include <dns/adb.h>
 #include <dns/badcache.h>
@@ -86,8 +93,10 @@
 #include <dns/nta.h>
 #include <dns/order.h>
 #include <dns/peer.h>
+#include <dns/prefetch.h>
 #include <dns/private.h>
 #include <dns/rbt.h>
+#include <dns/rcode.h>
 #include <dns/rdataclass.h>
 #include <dns/rdatalist.h>
 #include <dns/rdataset.h>
@@ -95,8 +104,10 @@
 #include <dns/resolver.h>
 #include <dns/rootns.h>
 #include <dns/rriterator.h>
+#include <dns/sdlz.h>
 #include <dns/secalg.h>
 #include <dns/soa.h>
+#include <dns/stalerefresh.h>
 #include <dns/stats.h>
 #include <dns/time.h>
 #include <dns/tkey.h>
@@ -116,6 +127,7 @@
 #include <ns/hooks.h>
 #include <ns/interfacemgr.h>
 #include <ns/listenlist.h>
+#include <ns/xfrcache.h>
 
 #include <bind9/check.h>
 
@@ -129,6 +141,7 @@
 #include <named/main.h>
 #include <named/os.h>
 #include <named/server.h>
+#include <named/startup.h>
 #include <named/statschannel.h>
 #include <named/tkeyconf.h>
 #include <named/transportconf.h>
@@ -241,6 +254,7 @@ struct named_cache {
 	dns_view_t *primaryview;
 	bool needflush;
 	bool adbsizeadjusted;
+	bool sharefetches;
 	dns_rdataclass_t rdclass;
 	ISC_LINK(named_cache_t) link;
 };
@@ -435,6 +449,15 @@ configure_zone(const cfg_obj_t *config, const cfg_obj_t *zconfig,
 	       cfg_aclconfctx_t *aclconf, bool added, bool old_rpz_ok,
 	       bool modify);
 
+static uint64_t
+view_cfghash(const cfg_obj_t *config, const cfg_obj_t *vconfig);
+
+static void
+zonecfg_batch_create(void);
+
+static isc_result_t
+zonecfg_batch_finish(dns_view_t *view, bool mount);
+
 static void
 configure_zone_setviewcommit(isc_result_t result, const cfg_obj_t *zconfig,
 			     dns_view_t *view);
@@ -449,6 +472,9 @@ add_keydata_zone(dns_view_t *view, const char *directory, isc_mem_t *mctx);
 static void
 end_reserved_dispatches(named_server_t *server, bool all);
 
+static void
+index_views(named_server_t *server);
+
 static void
 newzone_cfgctx_destroy(void **cfgp);
 
@@ -1868,7 +1894,12 @@ cache_reusable(dns_view_t *originview, dns_view_t *view,
 static bool
 cache_sharable(dns_view_t *originview, dns_view_t *view,
 	       bool new_zero_no_soattl, uint64_t new_max_cache_size,
-	       uint32_t new_stale_ttl, uint32_t new_stale_refresh_time) {
+	       uint32_t new_stale_ttl, uint32_t new_stale_refresh_time,
+	       dns_evictionpolicy_t new_eviction_policy,
+	       const char *new_snapshot_file, const char *new_coldtier_file,
+	       uint64_t new_coldtier_size) {
+	const char *snapshot_file = NULL, *coldtier_file = NULL;
+
 	/*
 	 * If the cache cannot even reused for the same view, it cannot be
 	 * shared with other views.
@@ -1884,7 +1915,51 @@ cache_sharable(dns_view_t *originview, dns_view_t *view,
 	if (dns_cache_getservestalettl(originview->cache) != new_stale_ttl ||
 	    dns_cache_getservestalerefresh(originview->cache) !=
 		    new_stale_refresh_time ||
-	    dns_cache_getcachesize(originview->cache) != new_max_cache_size)
+	    dns_cache_getcachesize(originview->cache) != new_max_cache_size ||
+	    dns_cache_getevictionpolicy(originview->cache) !=
+		    new_eviction_policy)
+	{
+		return (false);
+	}
+
+	snapshot_file = dns_cache_getsnapshotfile(originview->cache);
+	if ((snapshot_file == NULL) != (new_snapshot_file == NULL) ||
+	    (snapshot_file != NULL &&
+	     strcmp(snapshot_file, new_snapshot_file) != 0))
+	{
+		return (false);
+	}
+
+	coldtier_file = dns_cache_getcoldtierfile(originview->cache);
+	if ((coldtier_file == NULL) != (new_coldtier_file == NULL) ||
+	    (coldtier_file != NULL &&
+	     (strcmp(coldtier_file, new_coldtier_file) != 0 ||
+	      dns_cache_getcoldtiersize(originview->cache) !=
+		      new_coldtier_size)))
+	{
+		return (false);
+	}
+
+	return (true);
+}
+
+/*
+ * Check whether 'view' can join the fetches of 'originview', with which
+ * it shares its cache.  As for the cache itself, the forwarders and
+ * trust anchors of the views are not compared; it is the
+ * administrator's responsibility to keep them consistent.
+ */
+static bool
+fetches_sharable(dns_view_t *originview, dns_view_t *view) {
+	dns_resolver_t *ores = originview->resolver;
+	dns_resolver_t *res = view->resolver;
+
+	if (!originview->recursion || !view->recursion ||
+	    originview->qminimization != view->qminimization ||
+	    originview->qmin_strict != view->qmin_strict ||
+	    dns_resolver_getoptions(ores) != dns_resolver_getoptions(res) ||
+	    dns_resolver_getudpsize(ores) != dns_resolver_getudpsize(res) ||
+	    dns_resolver_gettimeout(ores) != dns_resolver_gettimeout(res))
 	{
 		return (false);
 	}
@@ -3712,7 +3787,115 @@ cleanup:
 
 #ifdef HAVE_DNSTAP
 static isc_result_t
-configure_dnstap(const cfg_obj_t **maps, dns_view_t *view) {
+configure_dnstap_filter(const cfg_obj_t **maps, const cfg_obj_t *config,
+			cfg_aclconfctx_t *actx, isc_mem_t *mctx,
+			dns_view_t *view) {
+	isc_result_t result;
+	const cfg_obj_t *obj = NULL;
+	const cfg_obj_t *clients = NULL, *names = NULL, *rcodes = NULL;
+	const cfg_obj_t *types = NULL, *sample = NULL;
+	const cfg_listelt_t *element = NULL;
+	dns_dtfilter_t *filter = NULL;
+	dns_acl_t *acl = NULL;
+
+	(void)named_config_get(maps, "dnstap-filter-clients", &clients);
+	(void)named_config_get(maps, "dnstap-filter-names", &names);
+	(void)named_config_get(maps, "dnstap-filter-rcodes", &rcodes);
+	(void)named_config_get(maps, "dnstap-filter-types", &types);
+	(void)named_config_get(maps, "dnstap-sample", &sample);
+
+	if (clients == NULL && names == NULL && rcodes == NULL &&
+	    types == NULL && sample == NULL)
+	{
+		return (ISC_R_SUCCESS);
+	}
+
+	dns_dtfilter_create(mctx, &filter);
+
+	if (sample != NULL) {
+		bool byclient = false;
+
+		if (cfg_obj_asuint32(sample) == 0) {
+			CHECKM(ISC_R_RANGE, "'dnstap-sample' must be nonzero");
+		}
+		if (named_config_get(maps, "dnstap-sample-by-client", &obj) ==
+		    ISC_R_SUCCESS)
+		{
+			byclient = cfg_obj_asboolean(obj);
+		}
+		dns_dtfilter_setsample(filter, cfg_obj_asuint32(sample),
+				       byclient);
+	}
+
+	if (clients != NULL) {
+		CHECK(cfg_acl_fromconfig(clients, config, named_g_lctx, actx,
+					 mctx, 0, &acl));
+		dns_dtfilter_setclients(filter, acl);
+	}
+
+	for (element = cfg_list_first(names); element != NULL;
+	     element = cfg_list_next(element))
+	{
+		dns_fixedname_t fixed;
+		dns_name_t *name = dns_fixedname_initname(&fixed);
+
+		obj = cfg_listelt_value(element);
+		CHECKM(dns_name_fromstring(name, cfg_obj_asstring(obj), 0,
+					   NULL),
+		       "'dnstap-filter-names'");
+		dns_dtfilter_addname(filter, name);
+	}
+
+	for (element = cfg_list_first(types); element != NULL;
+	     element = cfg_list_next(element))
+	{
+		isc_textregion_t r;
+		dns_rdatatype_t type;
+
+		obj = cfg_listelt_value(element);
+		DE_CONST(cfg_obj_asstring(obj), r.base);
+		r.length = strlen(r.base);
+		CHECKM(dns_rdatatype_fromtext(&type, &r),
+		       "'dnstap-filter-types'");
+		dns_dtfilter_addtype(filter, type);
+	}
+
+	for (element = cfg_list_first(rcodes); element != NULL;
+	     element = cfg_list_next(element))
+	{
+		isc_textregion_t r;
+		dns_rcode_t rcode;
+
+		obj = cfg_listelt_value(element);
+		DE_CONST(cfg_obj_asstring(obj), r.base);
+		r.length = strlen(r.base);
+		CHECKM(dns_rcode_fromtext(&rcode, &r),
+		       "'dnstap-filter-rcodes'");
+		if (rcode >= 16) {
+			CHECKM(ISC_R_RANGE, "'dnstap-filter-rcodes' only "
+					    "matches header rcodes");
+		}
+		dns_dtfilter_addrcode(filter, rcode);
+	}
+
+	view->dtfilter = filter;
+	filter = NULL;
+	result = ISC_R_SUCCESS;
+
+cleanup:
+	if (acl != NULL) {
+		dns_acl_detach(&acl);
+	}
+	if (filter != NULL) {
+		dns_dtfilter_destroy(&filter);
+	}
+
+	return (result);
+}
+
+static isc_result_t
+configure_dnstap(const cfg_obj_t **maps, const cfg_obj_t *config,
+		 cfg_aclconfctx_t *actx, isc_mem_t *mctx, dns_view_t *view) {
 	isc_result_t result;
 	const cfg_obj_t *obj, *obj2;
 	const cfg_listelt_t *element;
@@ -3931,6 +4114,8 @@ configure_dnstap(const cfg_obj_t **maps, dns_view_t *view) {
 				   cfg_obj_asstring(obj));
 	}
 
+	CHECK(configure_dnstap_filter(maps, config, actx, mctx, view));
+
 	dns_dt_attach(named_g_server->dtenv, &view->dtenv);
 	view->dttypes = dttypes;
 
@@ -4081,6 +4266,11 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	uint32_t lame_ttl, fail_ttl;
 	uint32_t max_stale_ttl = 0;
 	uint32_t stale_refresh_time = 0;
+	dns_evictionpolicy_t eviction_policy = dns_evictionpolicy_lru;
+	const char *snapshot_file = NULL;
+	bool load_snapshot = false;
+	const char *coldtier_file = NULL;
+	uint64_t coldtier_size = 0;
 	dns_tsig_keyring_t *ring = NULL;
 	dns_transport_list_t *transports = NULL;
 	dns_view_t *pview = NULL; /* Production view */
@@ -4100,6 +4290,8 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	unsigned int resopts = 0;
 	dns_zone_t *zone = NULL;
 	uint32_t max_clients_per_query;
+	uint32_t prefetch_popular, prefetch_rate;
+	uint32_t stale_refresh_rate;
 	bool empty_zones_enable;
 	const cfg_obj_t *disablelist = NULL;
 	isc_stats_t *resstats = NULL;
@@ -4118,6 +4310,8 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 
 	REQUIRE(DNS_VIEW_VALID(view));
 
+	named_startup_begin(named_startup_views);
+
 	if (config != NULL) {
 		(void)cfg_map_get(config, "options", &options);
 	}
@@ -4192,8 +4386,12 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	}
 
 	/*
-	 * Load zone configuration
+	 * Load zone configuration; the zones whose configuration is
+	 * unchanged since the last time will be carried over as they are.
 	 */
+	named_g_server->zonecfg_context = view_cfghash(config, vconfig);
+	named_startup_begin(named_startup_zones);
+	zonecfg_batch_create();
 	for (element = cfg_list_first(zonelist); element != NULL;
 	     element = cfg_list_next(element))
 	{
@@ -4201,6 +4399,8 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 		CHECK(configure_zone(config, zconfig, vconfig, view, viewlist,
 				     kasplist, actx, false, old_rpz_ok, false));
 	}
+	CHECK(zonecfg_batch_finish(view, true));
+	named_startup_end(named_startup_zones);
 	zones_configured = true;
 
 	/*
@@ -4236,6 +4436,7 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	 * runs.
 	 */
 	CHECK(configure_newzones(view, config, vconfig, actx));
+	named_g_server->zonecfg_context = 0;
 
 	/*
 	 * Create Dynamically Loadable Zone driver.
@@ -4257,6 +4458,7 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 		if (obj != NULL) {
 			dns_dlzdb_t *dlzdb = NULL;
 			const cfg_obj_t *name, *search = NULL;
+			const cfg_obj_t *maxttl = NULL, *maxnttl = NULL;
 			char *s = isc_mem_strdup(mctx, cfg_obj_asstring(obj));
 
 			if (s == NULL) {
@@ -4281,6 +4483,28 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 				goto cleanup;
 			}
 
+			(void)cfg_map_get(dlz, "max-lookup-ttl", &maxttl);
+			(void)cfg_map_get(dlz, "max-negative-lookup-ttl",
+					  &maxnttl);
+			if (maxttl != NULL || maxnttl != NULL) {
+				result = dns_sdlz_setcache(
+					dlzdb,
+					maxttl != NULL
+						? cfg_obj_asduration(maxttl)
+						: 0,
+					maxnttl != NULL
+						? cfg_obj_asduration(maxnttl)
+						: 0);
+				if (result != ISC_R_SUCCESS) {
+					cfg_obj_log(dlz, named_g_lctx,
+						    ISC_LOG_WARNING,
+						    "dlz '%s': lookups cannot "
+						    "be cached: %s",
+						    cfg_obj_asstring(name),
+						    isc_result_totext(result));
+				}
+			}
+
 			/*
 			 * If the DLZ backend supports configuration,
 			 * and is searchable, then call its configure
@@ -4522,6 +4746,11 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	INSIST(result == ISC_R_SUCCESS);
 	view->acceptexpired = cfg_obj_asboolean(obj);
 
+	obj = NULL;
+	result = named_config_get(maps, "dnssec-offload-threshold", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	view->offloadthreshold = cfg_obj_asuint32(obj);
+
 	obj = NULL;
 	/* 'optionmaps', not 'maps': don't check named_g_defaults yet */
 	(void)named_config_get(optionmaps, "dnssec-validation", &obj);
@@ -4620,6 +4849,34 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	INSIST(result == ISC_R_SUCCESS);
 	stale_refresh_time = cfg_obj_asduration(obj);
 
+	obj = NULL;
+	result = named_config_get(maps, "cache-eviction-policy", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (strcasecmp(cfg_obj_asstring(obj), "sieve") == 0) {
+		eviction_policy = dns_evictionpolicy_sieve;
+	}
+
+	/*
+	 * Only IN views have a cache worth keeping; this also keeps the
+	 * built-in CHAOS view from writing over the file.
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "cache-snapshot-file", &obj);
+	if (result == ISC_R_SUCCESS && view->rdclass == dns_rdataclass_in) {
+		snapshot_file = cfg_obj_asstring(obj);
+	}
+
+	obj = NULL;
+	result = named_config_get(maps, "cache-cold-tier-file", &obj);
+	if (result == ISC_R_SUCCESS && view->rdclass == dns_rdataclass_in) {
+		coldtier_file = cfg_obj_asstring(obj);
+
+		obj = NULL;
+		result = named_config_get(maps, "cache-cold-tier-size", &obj);
+		INSIST(result == ISC_R_SUCCESS);
+		coldtier_size = cfg_obj_asuint64(obj);
+	}
+
 	/*
 	 * Configure the view's cache.
 	 *
@@ -4655,7 +4912,9 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	if (nsc != NULL) {
 		if (!cache_sharable(nsc->primaryview, view, zero_no_soattl,
 				    max_cache_size, max_stale_ttl,
-				    stale_refresh_time))
+				    stale_refresh_time, eviction_policy,
+				    snapshot_file, coldtier_file,
+				    coldtier_size))
 		{
 			isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
 				      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
@@ -4717,15 +4976,45 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 			 * cache, for the main cache memory and the heap
 			 * memory.
 			 */
-			isc_mem_create(&cmctx);
+			isc_mem_create_arena(&cmctx);
 			isc_mem_setname(cmctx, "cache");
-			isc_mem_create(&hmctx);
+			isc_mem_create_arena(&hmctx);
 			isc_mem_setname(hmctx, "cache_heap");
 			CHECK(dns_cache_create(cmctx, hmctx, named_g_taskmgr,
 					       view->rdclass, cachename, "rbt",
 					       0, NULL, &cache));
 			isc_mem_detach(&cmctx);
 			isc_mem_detach(&hmctx);
+			load_snapshot = (snapshot_file != NULL);
+		}
+		if (snapshot_file != NULL) {
+			named_cache_t *other = NULL;
+
+			for (other = ISC_LIST_HEAD(*cachelist); other != NULL;
+			     other = ISC_LIST_NEXT(other, link))
+			{
+				const char *file =
+					dns_cache_getsnapshotfile(other->cache);
+
+				if (file != NULL &&
+				    strcmp(file, snapshot_file) == 0)
+				{
+					break;
+				}
+			}
+			if (other != NULL) {
+				isc_log_write(named_g_lctx,
+					      NAMED_LOGCATEGORY_GENERAL,
+					      NAMED_LOGMODULE_SERVER,
+					      ISC_LOG_ERROR,
+					      "views %s and %s have separate "
+					      "caches but the same "
+					      "cache-snapshot-file",
+					      other->primaryview->name,
+					      view->name);
+				result = ISC_R_FAILURE;
+				goto cleanup;
+			}
 		}
 		nsc = isc_mem_get(mctx, sizeof(*nsc));
 		nsc->cache = NULL;
@@ -4733,15 +5022,40 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 		nsc->primaryview = view;
 		nsc->needflush = false;
 		nsc->adbsizeadjusted = false;
+		nsc->sharefetches = false;
 		nsc->rdclass = view->rdclass;
 		ISC_LINK_INIT(nsc, link);
 		ISC_LIST_APPEND(*cachelist, nsc, link);
 	}
 	dns_view_setcache(view, cache, shared_cache);
 
+	dns_cache_setloop(cache, named_g_mainloop);
 	dns_cache_setcachesize(cache, max_cache_size);
 	dns_cache_setservestalettl(cache, max_stale_ttl);
 	dns_cache_setservestalerefresh(cache, stale_refresh_time);
+	dns_cache_setevictionpolicy(cache, eviction_policy);
+	dns_cache_setsnapshotfile(cache, snapshot_file);
+
+	result = dns_cache_setcoldtier(cache, coldtier_file, coldtier_size);
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+			      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
+			      "view %s: could not create the cache cold "
+			      "tier '%s': %s",
+			      view->name, coldtier_file,
+			      isc_result_totext(result));
+		dns_cache_detach(&cache);
+		goto cleanup;
+	}
+
+	/*
+	 * Warm up a new cache from the snapshot written when the previous
+	 * one was shut down; this is read in the background, while the
+	 * cache is already in use.
+	 */
+	if (load_snapshot) {
+		dns_cache_loadsnapshot(cache, named_g_mainloop, NULL, NULL);
+	}
 
 	dns_cache_detach(&cache);
 
@@ -4782,6 +5096,33 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	}
 	dns_resolver_setquerystats(view->resolver, resquerystats);
 
+	/*
+	 * Query latency histograms; keep those of the view being
+	 * replaced, if any, so that reconfiguring doesn't reset them.
+	 */
+	result = dns_viewlist_find(&named_g_server->viewlist, view->name,
+				   view->rdclass, &pview);
+	if (result != ISC_R_NOTFOUND && result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+	for (int t = 0; t < dns_latency_transport_max; t++) {
+		for (int s = 0; s < dns_latency_source_max; s++) {
+			if (pview != NULL && pview->latencystats[t][s] != NULL)
+			{
+				isc_histo_attach(pview->latencystats[t][s],
+						 &view->latencystats[t][s]);
+			} else {
+				isc_histo_create(
+					mctx, DNS_LATENCY_SIGBITS,
+					isc_loopmgr_nloops(named_g_loopmgr),
+					&view->latencystats[t][s]);
+			}
+		}
+	}
+	if (pview != NULL) {
+		dns_view_detach(&pview);
+	}
+
 	if (dscp4 == -1) {
 		dscp4 = named_g_dscp;
 	}
@@ -4990,6 +5331,15 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 		dns_resolver_setnonbackofftries(view->resolver, resolver_param);
 	}
 
+	obj = NULL;
+	CHECK(named_config_get(maps, "resolver-hedge-queries", &obj));
+	dns_resolver_setmaxhedges(view->resolver, cfg_obj_asuint32(obj));
+
+	obj = NULL;
+	CHECK(named_config_get(maps, "max-queries-per-forwarder", &obj));
+	dns_resolver_setmaxforwarderqueries(view->resolver,
+					    cfg_obj_asuint32(obj));
+
 	/*
 	 * Set supported DNSSEC algorithms.
 	 */
@@ -5206,6 +5556,31 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 		view->qmin_strict = false;
 	}
 
+	/*
+	 * Let the resolvers of the views sharing a cache join each
+	 * other's fetches, if both this view and the one that owns the
+	 * cache allow it.
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "share-fetches", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (nsc->primaryview == view) {
+		nsc->sharefetches = cfg_obj_asboolean(obj);
+	} else if (shared_cache && nsc->sharefetches &&
+		   cfg_obj_asboolean(obj))
+	{
+		if (fetches_sharable(nsc->primaryview, view)) {
+			dns_resolver_sharefetches(view->resolver,
+						  nsc->primaryview->resolver);
+		} else {
+			isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+				      NAMED_LOGMODULE_SERVER, ISC_LOG_WARNING,
+				      "views %s and %s can't share fetches "
+				      "due to configuration parameter mismatch",
+				      nsc->primaryview->name, view->name);
+		}
+	}
+
 	obj = NULL;
 	result = named_config_get(maps, "auth-nxdomain", &obj);
 	INSIST(result == ISC_R_SUCCESS);
@@ -5595,12 +5970,42 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 		}
 	}
 
+	obj = NULL;
+	result = named_config_get(maps, "prefetch-popular", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	prefetch_popular = cfg_obj_asuint32(obj);
+
+	obj = NULL;
+	result = named_config_get(maps, "prefetch-popular-rate", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	prefetch_rate = cfg_obj_asuint32(obj);
+
+	if (view->recursion && prefetch_popular > 0 && prefetch_rate > 0) {
+		dns_prefetch_create(view, named_g_loopmgr, named_g_taskmgr,
+				    prefetch_popular, prefetch_rate,
+				    &view->prefetch);
+	}
+
+	obj = NULL;
+	result = named_config_get(maps, "stale-refresh-rate", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	stale_refresh_rate = cfg_obj_asuint32(obj);
+
+	if (view->recursion && stale_refresh_rate > 0) {
+		dns_stalerefresh_create(view, named_g_loopmgr, named_g_taskmgr,
+					stale_refresh_rate,
+					&view->stalerefresh);
+	}
+
 	/*
 	 * For now, there is only one kind of trusted keys, the
 	 * "security roots".
 	 */
-	CHECK(configure_view_dnsseckeys(view, vconfig, config, bindkeys,
-					auto_root, mctx));
+	named_startup_begin(named_startup_keys);
+	result = configure_view_dnsseckeys(view, vconfig, config, bindkeys,
+					   auto_root, mctx);
+	named_startup_end(named_startup_keys);
+	CHECK(result);
 	dns_resolver_resetmustbesecure(view->resolver);
 	obj = NULL;
 	result = named_config_get(maps, "dnssec-must-be-secure", &obj);
@@ -6001,12 +6406,18 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	 * Set up the dnstap environment and configure message
 	 * types to log.
 	 */
-	CHECK(configure_dnstap(maps, view));
+	CHECK(configure_dnstap(maps, config, actx, mctx, view));
 #endif /* HAVE_DNSTAP */
 
 	result = ISC_R_SUCCESS;
 
 cleanup:
+	named_g_server->zonecfg_context = 0;
+	if (named_g_server->zonecfg_batch != NULL) {
+		(void)zonecfg_batch_finish(view, false);
+	}
+	named_startup_end(named_startup_views);
+
 	/*
 	 * Revert to the old view if there was an error.
 	 */
@@ -6467,85 +6878,403 @@ create_view(const cfg_obj_t *vconfig, dns_viewlist_t *viewlist,
 }
 
 /*
- * Configure or reconfigure a zone.
+ * Configuration fingerprints.  A zone remembers the fingerprint of the
+ * configuration it was configured with (its zone statement, plus
+ * everything outside of the zone statements in its view and in the
+ * global configuration), so that a reconfiguration can carry an
+ * unchanged zone over without running named_zone_configure() again.
  */
-static isc_result_t
-configure_zone(const cfg_obj_t *config, const cfg_obj_t *zconfig,
-	       const cfg_obj_t *vconfig, dns_view_t *view,
-	       dns_viewlist_t *viewlist, dns_kasplist_t *kasplist,
-	       cfg_aclconfctx_t *aclconf, bool added, bool old_rpz_ok,
-	       bool modify) {
-	dns_view_t *pview = NULL; /* Production view */
-	dns_zone_t *zone = NULL;  /* New or reused zone */
-	dns_zone_t *raw = NULL;	  /* New or reused raw zone */
-	dns_zone_t *dupzone = NULL;
-	const cfg_obj_t *options = NULL;
-	const cfg_obj_t *zoptions = NULL;
-	const cfg_obj_t *typeobj = NULL;
-	const cfg_obj_t *forwarders = NULL;
-	const cfg_obj_t *forwardtype = NULL;
-	const cfg_obj_t *ixfrfromdiffs = NULL;
-	const cfg_obj_t *only = NULL;
-	const cfg_obj_t *viewobj = NULL;
-	isc_result_t result = ISC_R_SUCCESS;
-	isc_result_t tresult;
-	isc_buffer_t buffer;
-	dns_fixedname_t fixorigin;
-	dns_name_t *origin;
-	const char *zname;
-	dns_rdataclass_t zclass;
-	const char *ztypestr;
-	dns_rpz_num_t rpz_num;
-	bool zone_is_catz = false;
-	bool zone_maybe_inline = false;
-	bool inline_signing = false;
+static void
+cfghash_print(void *closure, const char *text, int textlen) {
+	isc_buffer_putmem((isc_buffer_t *)closure, (const unsigned char *)text,
+			  (unsigned int)textlen);
+}
 
-	options = NULL;
-	(void)cfg_map_get(config, "options", &options);
+static void
+cfghash_map(isc_buffer_t *buffer, const cfg_obj_t *map) {
+	const void *clauses = NULL;
+	unsigned int idx = 0;
+	const char *name = NULL;
 
-	zoptions = cfg_tuple_get(zconfig, "options");
+	if (map == NULL) {
+		return;
+	}
 
-	/*
-	 * Get the zone origin as a dns_name_t.
-	 */
-	zname = cfg_obj_asstring(cfg_tuple_get(zconfig, "name"));
-	isc_buffer_constinit(&buffer, zname, strlen(zname));
-	isc_buffer_add(&buffer, strlen(zname));
-	dns_fixedname_init(&fixorigin);
-	CHECK(dns_name_fromtext(dns_fixedname_name(&fixorigin), &buffer,
-				dns_rootname, 0, NULL));
-	origin = dns_fixedname_name(&fixorigin);
+	for (name = cfg_map_firstclause(map->type, &clauses, &idx);
+	     name != NULL; name = cfg_map_nextclause(map->type, &clauses, &idx))
+	{
+		const cfg_obj_t *obj = NULL;
 
-	CHECK(named_config_getclass(cfg_tuple_get(zconfig, "class"),
-				    view->rdclass, &zclass));
-	if (zclass != view->rdclass) {
-		const char *vname = NULL;
-		if (vconfig != NULL) {
-			vname = cfg_obj_asstring(
-				cfg_tuple_get(vconfig, "name"));
-		} else {
-			vname = "<default view>";
+		if (strcasecmp(name, "zone") == 0 ||
+		    strcasecmp(name, "view") == 0 ||
+		    cfg_map_get(map, name, &obj) != ISC_R_SUCCESS)
+		{
+			continue;
 		}
 
-		isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
-			      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
-			      "zone '%s': wrong class for view '%s'", zname,
-			      vname);
-		result = ISC_R_FAILURE;
-		goto cleanup;
+		isc_buffer_putstr(buffer, name);
+		cfg_print(obj, cfghash_print, buffer);
+		isc_buffer_putuint8(buffer, ';');
 	}
+}
 
-	(void)cfg_map_get(zoptions, "in-view", &viewobj);
-	if (viewobj != NULL) {
-		const char *inview = cfg_obj_asstring(viewobj);
-		dns_view_t *otherview = NULL;
+static uint64_t
+view_cfghash(const cfg_obj_t *config, const cfg_obj_t *vconfig) {
+	isc_buffer_t *buffer = NULL;
+	uint64_t hash;
 
-		if (viewlist == NULL) {
-			cfg_obj_log(zconfig, named_g_lctx, ISC_LOG_ERROR,
-				    "'in-view' option is not permitted in "
-				    "dynamically added zones");
-			result = ISC_R_FAILURE;
-			goto cleanup;
+	isc_buffer_allocate(named_g_mctx, &buffer, 4096);
+	isc_buffer_setautorealloc(buffer, true);
+
+	cfghash_map(buffer, config);
+	if (vconfig != NULL) {
+		cfg_print(cfg_tuple_get(vconfig, "name"), cfghash_print,
+			  buffer);
+		cfg_print(cfg_tuple_get(vconfig, "class"), cfghash_print,
+			  buffer);
+		cfghash_map(buffer, cfg_tuple_get(vconfig, "options"));
+	}
+
+	hash = isc_hash64(isc_buffer_base(buffer),
+			  isc_buffer_usedlength(buffer), true);
+	isc_buffer_free(&buffer);
+
+	return (hash);
+}
+
+static uint64_t
+zone_cfghash(uint64_t context, const cfg_obj_t *zconfig) {
+	isc_buffer_t *buffer = NULL;
+	uint64_t hash;
+
+	isc_buffer_allocate(named_g_mctx, &buffer, 512);
+	isc_buffer_setautorealloc(buffer, true);
+
+	isc_buffer_putuint32(buffer, (uint32_t)(context >> 32));
+	isc_buffer_putuint32(buffer, (uint32_t)context);
+	cfg_print(zconfig, cfghash_print, buffer);
+
+	hash = isc_hash64(isc_buffer_base(buffer),
+			  isc_buffer_usedlength(buffer), true);
+	isc_buffer_free(&buffer);
+
+	/* 0 means "unknown" */
+	return (hash != 0 ? hash : 1);
+}
+
+/*
+ * Redo the parts of named_zone_configure() that don't live in the zone
+ * itself, for a zone that is carried over unchanged.
+ */
+static void
+keep_zone_configuration(dns_zone_t *zone, dns_kasplist_t *kasplist) {
+	dns_zone_t *raw = NULL;
+	dns_zone_t *mayberaw = zone;
+	dns_kasp_t *kasp = dns_zone_getkasp(zone);
+
+	/*
+	 * The reserved dispatches are collected anew on every
+	 * reconfiguration.
+	 */
+	named_add_reserved_dispatch(named_g_server,
+				    dns_zone_getnotifysrc4(zone));
+	named_add_reserved_dispatch(named_g_server,
+				    dns_zone_getnotifysrc6(zone));
+	named_add_reserved_dispatch(named_g_server,
+				    dns_zone_getparentalsrc4(zone));
+	named_add_reserved_dispatch(named_g_server,
+				    dns_zone_getparentalsrc6(zone));
+
+	dns_zone_getraw(zone, &raw);
+	if (raw != NULL) {
+		mayberaw = raw;
+	}
+	named_add_reserved_dispatch(named_g_server,
+				    dns_zone_getxfrsource4(mayberaw));
+	named_add_reserved_dispatch(named_g_server,
+				    dns_zone_getxfrsource6(mayberaw));
+	named_add_reserved_dispatch(named_g_server,
+				    dns_zone_getaltxfrsource4(mayberaw));
+	named_add_reserved_dispatch(named_g_server,
+				    dns_zone_getaltxfrsource6(mayberaw));
+	if (raw != NULL) {
+		dns_zone_detach(&raw);
+	}
+
+	/*
+	 * The key and signing policies are recreated on every
+	 * reconfiguration; switch to the new instance of the same policy.
+	 */
+	if (kasp != NULL) {
+		dns_kasp_t *newkasp = NULL;
+
+		if (dns_kasplist_find(kasplist, dns_kasp_getname(kasp),
+				      &newkasp) == ISC_R_SUCCESS)
+		{
+			dns_zone_setkasp(zone, newkasp);
+			dns_kasp_detach(&newkasp);
+		}
+	}
+}
+
+/*
+ * Parallel zone configuration.  While the zones of a view are being
+ * configured, configure_zone() only creates (or finds) the zone and
+ * leaves the translation of its configuration, named_zone_configure(),
+ * to the threads of the work pool.  Once all the zones have been seen,
+ * zonecfg_batch_finish() waits for the workers and adds the configured
+ * zones to the view, in the order of the configuration.
+ */
+typedef struct zonecfg_job zonecfg_job_t;
+
+struct zonecfg_job {
+	struct zonecfg_batch *batch;
+	const cfg_obj_t	     *config;
+	const cfg_obj_t	     *vconfig;
+	const cfg_obj_t	     *zconfig;
+	cfg_aclconfctx_t     *aclconf;
+	dns_kasplist_t	     *kasplist;
+	dns_zone_t	     *zone;
+	dns_zone_t	     *raw;
+	uint64_t	      cfghash;
+	uint64_t	      usecs;
+	isc_result_t	      result;
+	ISC_LINK(zonecfg_job_t) link;
+};
+
+struct zonecfg_batch {
+	isc_mutex_t	lock;
+	isc_condition_t done;
+	unsigned int	pending;
+	ISC_LIST(zonecfg_job_t) jobs;
+};
+
+static void
+zonecfg_work(void *arg) {
+	zonecfg_job_t *job = arg;
+	struct zonecfg_batch *batch = job->batch;
+	isc_time_t start, end;
+
+	isc_time_now(&start);
+	job->result = named_zone_configure(job->config, job->vconfig,
+					   job->zconfig, job->aclconf,
+					   job->kasplist, job->zone, job->raw);
+	isc_time_now(&end);
+	job->usecs = isc_time_microdiff(&end, &start);
+
+	LOCK(&batch->lock);
+	INSIST(batch->pending > 0);
+	if (--batch->pending == 0) {
+		SIGNAL(&batch->done);
+	}
+	UNLOCK(&batch->lock);
+}
+
+static void
+zonecfg_work_done(void *arg) {
+	zonecfg_job_t *job = arg;
+
+	/*
+	 * The batch is gone by now; the job was only kept around for
+	 * the work pool.
+	 */
+	isc_mem_put(named_g_mctx, job, sizeof(*job));
+}
+
+static void
+zonecfg_batch_create(void) {
+	struct zonecfg_batch *batch = NULL;
+
+	REQUIRE(named_g_server->zonecfg_batch == NULL);
+
+	batch = isc_mem_get(named_g_mctx, sizeof(*batch));
+	*batch = (struct zonecfg_batch){ .pending = 0 };
+	isc_mutex_init(&batch->lock);
+	isc_condition_init(&batch->done);
+	ISC_LIST_INIT(batch->jobs);
+
+	named_g_server->zonecfg_batch = batch;
+}
+
+static void
+zonecfg_batch_add(const cfg_obj_t *config, const cfg_obj_t *vconfig,
+		  const cfg_obj_t *zconfig, cfg_aclconfctx_t *aclconf,
+		  dns_kasplist_t *kasplist, dns_zone_t *zone, dns_zone_t *raw,
+		  uint64_t cfghash) {
+	struct zonecfg_batch *batch = named_g_server->zonecfg_batch;
+	zonecfg_job_t *job = NULL;
+
+	REQUIRE(batch != NULL);
+
+	job = isc_mem_get(named_g_mctx, sizeof(*job));
+	*job = (zonecfg_job_t){
+		.batch = batch,
+		.config = config,
+		.vconfig = vconfig,
+		.zconfig = zconfig,
+		.aclconf = aclconf,
+		.kasplist = kasplist,
+		.cfghash = cfghash,
+		.result = ISC_R_UNSET,
+	};
+	ISC_LINK_INIT(job, link);
+	dns_zone_attach(zone, &job->zone);
+	if (raw != NULL) {
+		dns_zone_attach(raw, &job->raw);
+	}
+	ISC_LIST_APPEND(batch->jobs, job, link);
+
+	LOCK(&batch->lock);
+	batch->pending++;
+	UNLOCK(&batch->lock);
+
+	isc_work_enqueue(isc_loop_current(named_g_loopmgr), zonecfg_work,
+			 zonecfg_work_done, job);
+}
+
+/*
+ * Wait for the zones of the batch to be configured and, if 'mount' is
+ * true, add them to 'view'.  Returns the first failure.
+ */
+static isc_result_t
+zonecfg_batch_finish(dns_view_t *view, bool mount) {
+	struct zonecfg_batch *batch = named_g_server->zonecfg_batch;
+	zonecfg_job_t *job = NULL;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	REQUIRE(batch != NULL);
+
+	named_g_server->zonecfg_batch = NULL;
+
+	LOCK(&batch->lock);
+	while (batch->pending > 0) {
+		WAIT(&batch->done, &batch->lock);
+	}
+	UNLOCK(&batch->lock);
+
+	while ((job = ISC_LIST_HEAD(batch->jobs)) != NULL) {
+		ISC_LIST_UNLINK(batch->jobs, job, link);
+
+		if (!named_startup_isdone()) {
+			char zname[DNS_NAME_FORMATSIZE];
+
+			dns_zone_name(job->zone, zname, sizeof(zname));
+			named_startup_zone(named_startup_zones, zname,
+					   job->usecs);
+		}
+
+		if (result == ISC_R_SUCCESS) {
+			result = job->result;
+		}
+		if (mount && result == ISC_R_SUCCESS) {
+			dns_zone_setcfghash(job->zone, job->cfghash);
+			result = dns_view_addzone(view, job->zone);
+		}
+		if (mount && result == ISC_R_SUCCESS) {
+			/*
+			 * Ensure that zone keys are reloaded on reconfig
+			 */
+			unsigned int keyopts = dns_zone_getkeyopts(job->zone);
+			if ((keyopts & DNS_ZONEKEY_MAINTAIN) != 0) {
+				dns_zone_rekey(job->zone, false);
+			}
+		}
+
+		dns_zone_detach(&job->zone);
+		if (job->raw != NULL) {
+			dns_zone_detach(&job->raw);
+		}
+	}
+
+	isc_condition_destroy(&batch->done);
+	isc_mutex_destroy(&batch->lock);
+	isc_mem_put(named_g_mctx, batch, sizeof(*batch));
+
+	return (result);
+}
+
+/*
+ * Configure or reconfigure a zone.
+ */
+static isc_result_t
+configure_zone(const cfg_obj_t *config, const cfg_obj_t *zconfig,
+	       const cfg_obj_t *vconfig, dns_view_t *view,
+	       dns_viewlist_t *viewlist, dns_kasplist_t *kasplist,
+	       cfg_aclconfctx_t *aclconf, bool added, bool old_rpz_ok,
+	       bool modify) {
+	dns_view_t *pview = NULL; /* Production view */
+	dns_zone_t *zone = NULL;  /* New or reused zone */
+	dns_zone_t *raw = NULL;	  /* New or reused raw zone */
+	dns_zone_t *dupzone = NULL;
+	const cfg_obj_t *options = NULL;
+	const cfg_obj_t *zoptions = NULL;
+	const cfg_obj_t *typeobj = NULL;
+	const cfg_obj_t *forwarders = NULL;
+	const cfg_obj_t *forwardtype = NULL;
+	const cfg_obj_t *ixfrfromdiffs = NULL;
+	const cfg_obj_t *only = NULL;
+	const cfg_obj_t *viewobj = NULL;
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_result_t tresult;
+	isc_buffer_t buffer;
+	dns_fixedname_t fixorigin;
+	dns_name_t *origin;
+	const char *zname;
+	dns_rdataclass_t zclass;
+	const char *ztypestr;
+	dns_rpz_num_t rpz_num;
+	bool zone_is_catz = false;
+	bool reused = false;
+	uint64_t cfghash = 0;
+	bool zone_maybe_inline = false;
+	bool inline_signing = false;
+
+	options = NULL;
+	(void)cfg_map_get(config, "options", &options);
+
+	zoptions = cfg_tuple_get(zconfig, "options");
+
+	/*
+	 * Get the zone origin as a dns_name_t.
+	 */
+	zname = cfg_obj_asstring(cfg_tuple_get(zconfig, "name"));
+	isc_buffer_constinit(&buffer, zname, strlen(zname));
+	isc_buffer_add(&buffer, strlen(zname));
+	dns_fixedname_init(&fixorigin);
+	CHECK(dns_name_fromtext(dns_fixedname_name(&fixorigin), &buffer,
+				dns_rootname, 0, NULL));
+	origin = dns_fixedname_name(&fixorigin);
+
+	CHECK(named_config_getclass(cfg_tuple_get(zconfig, "class"),
+				    view->rdclass, &zclass));
+	if (zclass != view->rdclass) {
+		const char *vname = NULL;
+		if (vconfig != NULL) {
+			vname = cfg_obj_asstring(
+				cfg_tuple_get(vconfig, "name"));
+		} else {
+			vname = "<default view>";
+		}
+
+		isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+			      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
+			      "zone '%s': wrong class for view '%s'", zname,
+			      vname);
+		result = ISC_R_FAILURE;
+		goto cleanup;
+	}
+
+	(void)cfg_map_get(zoptions, "in-view", &viewobj);
+	if (viewobj != NULL) {
+		const char *inview = cfg_obj_asstring(viewobj);
+		dns_view_t *otherview = NULL;
+
+		if (viewlist == NULL) {
+			cfg_obj_log(zconfig, named_g_lctx, ISC_LOG_ERROR,
+				    "'in-view' option is not permitted in "
+				    "dynamically added zones");
+			result = ISC_R_FAILURE;
+			goto cleanup;
 		}
 
 		result = dns_viewlist_find(viewlist, inview, view->rdclass,
@@ -6781,6 +7510,7 @@ configure_zone(const cfg_obj_t *config, const cfg_obj_t *zconfig,
 		 * new view.
 		 */
 		dns_zone_setview(zone, view);
+		reused = true;
 	} else {
 		/*
 		 * We cannot reuse an existing zone, we have
@@ -6871,10 +7601,38 @@ configure_zone(const cfg_obj_t *config, const cfg_obj_t *zconfig,
 	}
 
 	/*
-	 * Configure the zone.
+	 * Configure the zone, unless it is a reused zone whose
+	 * configuration hasn't changed.  The response policy and catalog
+	 * zones are always reconfigured, as are the zones modified at
+	 * runtime.
 	 */
-	CHECK(named_zone_configure(config, vconfig, zconfig, aclconf, kasplist,
-				   zone, raw));
+	if (named_g_server->zonecfg_context != 0 && !modify &&
+	    rpz_num == DNS_RPZ_INVALID_NUM && !zone_is_catz)
+	{
+		cfghash = zone_cfghash(named_g_server->zonecfg_context,
+				       zconfig);
+	}
+	if (reused && cfghash != 0 && dns_zone_getcfghash(zone) == cfghash) {
+		dns_zone_log(zone, ISC_LOG_DEBUG(1),
+			     "configuration unchanged");
+		keep_zone_configuration(zone, kasplist);
+	} else if (named_g_server->zonecfg_batch != NULL && !modify &&
+		   rpz_num == DNS_RPZ_INVALID_NUM && !zone_is_catz)
+	{
+		/*
+		 * The rest is done by zonecfg_batch_finish().
+		 */
+		dns_zone_setcfghash(zone, 0);
+		zonecfg_batch_add(config, vconfig, zconfig, aclconf, kasplist,
+				  zone, raw, cfghash);
+		result = ISC_R_SUCCESS;
+		goto cleanup;
+	} else {
+		dns_zone_setcfghash(zone, 0);
+		CHECK(named_zone_configure(config, vconfig, zconfig, aclconf,
+					   kasplist, zone, raw));
+		dns_zone_setcfghash(zone, cfghash);
+	}
 
 	/*
 	 * Add the zone to its view in the new view list.
@@ -7381,6 +8139,13 @@ tat_timer_tick(void *arg) {
 	}
 }
 
+static void
+adb_timer_tick(void *arg) {
+	named_server_t *server = (named_server_t *)arg;
+
+	(void)named_server_saveadb(server);
+}
+
 static void
 pps_timer_tick(void *arg) {
 	static unsigned int oldrequests = 0;
@@ -8142,78 +8907,273 @@ configure_newzone(const cfg_obj_t *zconfig, cfg_obj_t *config,
 }
 
 /*%
- * Revert new view assignment for a zone found in NZD.
+ * When loading the NZD, the zone configurations are parsed in chunks of
+ * NZD_PARSE_CHUNK zones, each with its own parser on the work pool.
  */
-static isc_result_t
-configure_newzone_revert(const cfg_obj_t *zconfig, cfg_obj_t *config,
-			 cfg_obj_t *vconfig, dns_view_t *view,
-			 cfg_aclconfctx_t *actx) {
-	UNUSED(config);
-	UNUSED(vconfig);
-	UNUSED(actx);
+#define NZD_PARSE_CHUNK 1024
+
+typedef struct nzd_chunk nzd_chunk_t;
+typedef struct nzd_parse nzd_parse_t;
+
+struct nzd_chunk {
+	nzd_parse_t  *parse;
+	isc_buffer_t *text;
+	unsigned int  count;
+	cfg_parser_t *parser;
+	cfg_obj_t    *zoneconf;
+	isc_result_t  result;
+	ISC_LINK(nzd_chunk_t) link;
+};
 
-	configure_zone_setviewcommit(ISC_R_FAILURE, zconfig, view);
+struct nzd_parse {
+	const char     *dbname;
+	isc_mutex_t	lock;
+	isc_condition_t done;
+	unsigned int	pending;
+	ISC_LIST(nzd_chunk_t) chunks;
+};
 
-	return (ISC_R_SUCCESS);
-}
+static void
+nzd_parse_work(void *arg) {
+	nzd_chunk_t *chunk = arg;
+	nzd_parse_t *parse = chunk->parse;
 
-static isc_result_t
-configure_newzones(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
-		   cfg_aclconfctx_t *actx) {
-	isc_result_t result;
-	MDB_txn *txn = NULL;
-	MDB_dbi dbi;
+	chunk->result = cfg_parser_create(named_g_mctx, named_g_lctx,
+					  &chunk->parser);
+	if (chunk->result == ISC_R_SUCCESS) {
+		chunk->result = cfg_parse_buffer(
+			chunk->parser, chunk->text, parse->dbname, 0,
+			&cfg_type_addzoneconf, 0, &chunk->zoneconf);
+	}
 
-	if (view->new_zone_config == NULL) {
-		return (ISC_R_SUCCESS);
+	LOCK(&parse->lock);
+	INSIST(parse->pending > 0);
+	if (--parse->pending == 0) {
+		SIGNAL(&parse->done);
 	}
+	UNLOCK(&parse->lock);
+}
 
-	LOCK(&view->new_zone_lock);
+static void
+nzd_parse_done(void *arg) {
+	nzd_chunk_t *chunk = arg;
 
-	result = nzd_open(view, MDB_RDONLY, &txn, &dbi);
-	if (result != ISC_R_SUCCESS) {
-		UNLOCK(&view->new_zone_lock);
-		return (ISC_R_SUCCESS);
-	}
+	isc_mem_put(named_g_mctx, chunk, sizeof(*chunk));
+}
 
-	isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
-		      NAMED_LOGMODULE_SERVER, ISC_LOG_INFO,
-		      "loading NZD configs from '%s' "
-		      "for view '%s'",
-		      view->new_zone_db, view->name);
+static void
+nzd_parse_chunk(nzd_parse_t *parse, nzd_chunk_t **chunkp) {
+	nzd_chunk_t *chunk = *chunkp;
 
-	result = for_all_newzone_cfgs(configure_newzone, config, vconfig, view,
-				      actx, txn, dbi);
-	if (result != ISC_R_SUCCESS) {
-		/*
-		 * An error was encountered while attempting to configure zones
-		 * found in NZD.  As this error may have been caused by a
-		 * configure_zone() failure, try restoring a sane configuration
-		 * by reattaching all zones found in NZD to the old view.  If
-		 * this also fails, too bad, there is nothing more we can do in
-		 * terms of trying to make things right.
-		 */
-		(void)for_all_newzone_cfgs(configure_newzone_revert, config,
-					   vconfig, view, actx, txn, dbi);
-	}
+	*chunkp = NULL;
 
-	(void)nzd_close(&txn, false);
+	ISC_LIST_APPEND(parse->chunks, chunk, link);
 
-	UNLOCK(&view->new_zone_lock);
+	LOCK(&parse->lock);
+	parse->pending++;
+	UNLOCK(&parse->lock);
 
-	return (result);
+	isc_work_enqueue(isc_loop_current(named_g_loopmgr), nzd_parse_work,
+			 nzd_parse_done, chunk);
 }
 
+/*%
+ * Configure all the zones found in a NZD opened by the caller, parsing
+ * their configuration in parallel.
+ *
+ * Caller must hold 'view->new_zone_lock'.
+ */
 static isc_result_t
-get_newzone_config(dns_view_t *view, const char *zonename,
-		   cfg_obj_t **zoneconfig) {
-	isc_result_t result;
+configure_nzd_zones(cfg_obj_t *config, cfg_obj_t *vconfig, dns_view_t *view,
+		    cfg_aclconfctx_t *actx, MDB_txn *txn, MDB_dbi dbi) {
+	isc_result_t result = ISC_R_SUCCESS;
+	nzd_parse_t parse = { .dbname = view->new_zone_db };
+	nzd_chunk_t *chunk = NULL;
+	MDB_cursor *cursor = NULL;
+	MDB_val data, key;
 	int status;
-	cfg_obj_t *zoneconf = NULL;
-	isc_buffer_t *text = NULL;
-	MDB_txn *txn = NULL;
-	MDB_dbi dbi;
-	MDB_val key, data;
+
+	status = mdb_cursor_open(txn, dbi, &cursor);
+	if (status != MDB_SUCCESS) {
+		return (ISC_R_FAILURE);
+	}
+
+	isc_mutex_init(&parse.lock);
+	isc_condition_init(&parse.done);
+	ISC_LIST_INIT(parse.chunks);
+
+	for (status = mdb_cursor_get(cursor, &key, &data, MDB_FIRST);
+	     status == MDB_SUCCESS;
+	     status = mdb_cursor_get(cursor, &key, &data, MDB_NEXT))
+	{
+		INSIST(key.mv_data != NULL && key.mv_size > 0);
+		INSIST(data.mv_data != NULL && data.mv_size > 0);
+
+		if (chunk == NULL) {
+			chunk = isc_mem_get(named_g_mctx, sizeof(*chunk));
+			*chunk = (nzd_chunk_t){
+				.parse = &parse,
+				.result = ISC_R_UNSET,
+			};
+			ISC_LINK_INIT(chunk, link);
+			isc_buffer_allocate(named_g_mctx, &chunk->text, 4096);
+			isc_buffer_setautorealloc(chunk->text, true);
+		}
+
+		/* zone zonename { config; }; */
+		isc_buffer_putstr(chunk->text, "zone \"");
+		isc_buffer_putmem(chunk->text, key.mv_data, key.mv_size);
+		isc_buffer_putstr(chunk->text, "\" ");
+		isc_buffer_putmem(chunk->text, data.mv_data, data.mv_size);
+		isc_buffer_putstr(chunk->text, ";\n");
+
+		if (++chunk->count == NZD_PARSE_CHUNK) {
+			nzd_parse_chunk(&parse, &chunk);
+		}
+	}
+	if (chunk != NULL) {
+		nzd_parse_chunk(&parse, &chunk);
+	}
+
+	mdb_cursor_close(cursor);
+
+	LOCK(&parse.lock);
+	while (parse.pending > 0) {
+		WAIT(&parse.done, &parse.lock);
+	}
+	UNLOCK(&parse.lock);
+
+	/*
+	 * Configure the zones in the order of the database.
+	 */
+	for (chunk = ISC_LIST_HEAD(parse.chunks); chunk != NULL;
+	     chunk = ISC_LIST_NEXT(chunk, link))
+	{
+		const cfg_obj_t *zlist = NULL;
+		const cfg_listelt_t *elt = NULL;
+
+		if (chunk->result != ISC_R_SUCCESS) {
+			isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+				      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
+				      "parsing configs in NZD database '%s' "
+				      "failed",
+				      view->new_zone_db);
+			result = chunk->result;
+			break;
+		}
+
+		result = cfg_map_get(chunk->zoneconf, "zone", &zlist);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		} else if (!cfg_obj_islist(zlist)) {
+			result = ISC_R_FAILURE;
+			break;
+		}
+
+		for (elt = cfg_list_first(zlist); elt != NULL;
+		     elt = cfg_list_next(elt))
+		{
+			result = configure_newzone(cfg_listelt_value(elt),
+						   config, vconfig, view, actx);
+			if (result != ISC_R_SUCCESS) {
+				break;
+			}
+		}
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+	}
+
+	while ((chunk = ISC_LIST_HEAD(parse.chunks)) != NULL) {
+		ISC_LIST_UNLINK(parse.chunks, chunk, link);
+
+		if (chunk->zoneconf != NULL) {
+			cfg_obj_destroy(chunk->parser, &chunk->zoneconf);
+		}
+		if (chunk->parser != NULL) {
+			cfg_parser_destroy(&chunk->parser);
+		}
+		isc_buffer_free(&chunk->text);
+	}
+
+	isc_condition_destroy(&parse.done);
+	isc_mutex_destroy(&parse.lock);
+
+	return (result);
+}
+
+/*%
+ * Revert new view assignment for a zone found in NZD.
+ */
+static isc_result_t
+configure_newzone_revert(const cfg_obj_t *zconfig, cfg_obj_t *config,
+			 cfg_obj_t *vconfig, dns_view_t *view,
+			 cfg_aclconfctx_t *actx) {
+	UNUSED(config);
+	UNUSED(vconfig);
+	UNUSED(actx);
+
+	configure_zone_setviewcommit(ISC_R_FAILURE, zconfig, view);
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+configure_newzones(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
+		   cfg_aclconfctx_t *actx) {
+	isc_result_t result;
+	MDB_txn *txn = NULL;
+	MDB_dbi dbi;
+
+	if (view->new_zone_config == NULL) {
+		return (ISC_R_SUCCESS);
+	}
+
+	LOCK(&view->new_zone_lock);
+
+	result = nzd_open(view, MDB_RDONLY, &txn, &dbi);
+	if (result != ISC_R_SUCCESS) {
+		UNLOCK(&view->new_zone_lock);
+		return (ISC_R_SUCCESS);
+	}
+
+	isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+		      NAMED_LOGMODULE_SERVER, ISC_LOG_INFO,
+		      "loading NZD configs from '%s' "
+		      "for view '%s'",
+		      view->new_zone_db, view->name);
+
+	result = configure_nzd_zones(config, vconfig, view, actx, txn, dbi);
+	if (result != ISC_R_SUCCESS) {
+		/*
+		 * An error was encountered while attempting to configure zones
+		 * found in NZD.  As this error may have been caused by a
+		 * configure_zone() failure, try restoring a sane configuration
+		 * by reattaching all zones found in NZD to the old view.  If
+		 * this also fails, too bad, there is nothing more we can do in
+		 * terms of trying to make things right.
+		 */
+		(void)for_all_newzone_cfgs(configure_newzone_revert, config,
+					   vconfig, view, actx, txn, dbi);
+	}
+
+	(void)nzd_close(&txn, false);
+
+	UNLOCK(&view->new_zone_lock);
+
+	return (result);
+}
+
+static isc_result_t
+get_newzone_config(dns_view_t *view, const char *zonename,
+		   cfg_obj_t **zoneconfig) {
+	isc_result_t result;
+	int status;
+	cfg_obj_t *zoneconf = NULL;
+	isc_buffer_t *text = NULL;
+	MDB_txn *txn = NULL;
+	MDB_dbi dbi;
+	MDB_val key, data;
 	char zname[DNS_NAME_FORMATSIZE];
 	dns_fixedname_t fname;
 	dns_name_t *name;
@@ -8353,6 +9313,68 @@ check_lockfile(named_server_t *server, const cfg_obj_t *config,
 	return (ISC_R_FAILURE);
 }
 
+/*
+ * An ACL that matches all the clients or none of them does not make
+ * the answers depend on who is asking.
+ */
+static bool
+acl_isshared(dns_acl_t *acl) {
+	return (acl == NULL || dns_acl_isany(acl) || dns_acl_isnone(acl));
+}
+
+static isc_result_t
+zone_aclsshared(dns_zone_t *zone, void *uap) {
+	UNUSED(uap);
+
+	if (!acl_isshared(dns_zone_getqueryacl(zone)) ||
+	    !acl_isshared(dns_zone_getqueryonacl(zone)))
+	{
+		return (ISC_R_FAILURE);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Return true if every client gets the same answer to the same
+ * question, which is what the DoH response cache needs: a cached
+ * response is sent back without looking at the client.  Rate limiting
+ * does not matter here, as it never applies to TCP, and so to DoH.
+ */
+static bool
+http_cache_allowed(named_server_t *server) {
+	if (!acl_isshared(server->sctx->blackholeacl)) {
+		return (false);
+	}
+
+	for (dns_view_t *view = ISC_LIST_HEAD(server->viewlist); view != NULL;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		if (!acl_isshared(view->matchclients) ||
+		    !acl_isshared(view->matchdestinations) ||
+		    view->matchrecursiveonly || view->sortlist != NULL ||
+		    !acl_isshared(view->queryacl) ||
+		    !acl_isshared(view->queryonacl) ||
+		    !acl_isshared(view->cacheacl) ||
+		    !acl_isshared(view->cacheonacl))
+		{
+			return (false);
+		}
+		if (view->recursion && (!acl_isshared(view->recursionacl) ||
+					!acl_isshared(view->recursiononacl)))
+		{
+			return (false);
+		}
+		if (dns_zt_apply(view->zonetable, true, NULL, zone_aclsshared,
+				 NULL) != ISC_R_SUCCESS)
+		{
+			return (false);
+		}
+	}
+
+	return (true);
+}
+
 static isc_result_t
 load_configuration(const char *filename, named_server_t *server,
 		   bool first_time) {
@@ -8382,6 +9404,7 @@ load_configuration(const char *filename, named_server_t *server,
 	isc_portset_t *v6portset = NULL;
 	isc_result_t result, tresult;
 	uint32_t heartbeat_interval;
+	uint32_t adb_save_interval;
 	uint32_t interface_interval;
 	uint32_t udpsize;
 	uint32_t transfer_message_size;
@@ -8396,6 +9419,7 @@ load_configuration(const char *filename, named_server_t *server,
 	uint32_t softquota = 0;
 	uint32_t max;
 	uint64_t initial, idle, keepalive, advertised;
+	uint32_t tcppool, tcppoolidle;
 	bool loadbalancesockets;
 	bool exclusive = true;
 	dns_aclenv_t *env =
@@ -8452,8 +9476,10 @@ load_configuration(const char *filename, named_server_t *server,
 	}
 
 	cfg_parser_setcallback(conf_parser, directory_callback, NULL);
+	named_startup_begin(named_startup_parse);
 	result = cfg_parse_file(conf_parser, filename, &cfg_type_namedconf,
 				&config);
+	named_startup_end(named_startup_parse);
 	if (result != ISC_R_SUCCESS) {
 		goto cleanup_conf_parser;
 	}
@@ -8545,8 +9571,10 @@ load_configuration(const char *filename, named_server_t *server,
 			goto cleanup_config;
 		}
 
+		named_startup_begin(named_startup_parse);
 		result = cfg_parse_file(bindkeys_parser, server->bindkeysfile,
 					&cfg_type_bindkeys, &bindkeys);
+		named_startup_end(named_startup_parse);
 		if (result != ISC_R_SUCCESS) {
 			isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
 				      NAMED_LOGMODULE_SERVER, ISC_LOG_INFO,
@@ -8644,6 +9672,16 @@ load_configuration(const char *filename, named_server_t *server,
 					     server->sctx->blackholeacl);
 	}
 
+	/*
+	 * Set "allow-proxy". Only legal at options level.
+	 */
+	result = configure_view_acl(NULL, config, named_g_config,
+				    "allow-proxy", NULL, named_g_aclconfctx,
+				    named_g_mctx, &server->sctx->proxyacl);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup_bindkeys_parser;
+	}
+
 	obj = NULL;
 	result = named_config_get(maps, "match-mapped-addresses", &obj);
 	INSIST(result == ISC_R_SUCCESS);
@@ -8721,6 +9759,34 @@ load_configuration(const char *filename, named_server_t *server,
 	isc_nm_settimeouts(named_g_netmgr, initial, idle, keepalive,
 			   advertised);
 
+	/*
+	 * Set the pool of idle outgoing TCP connections.
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "outgoing-tcp-pool-size", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	tcppool = cfg_obj_asuint32(obj);
+
+	obj = NULL;
+	result = named_config_get(maps, "outgoing-tcp-idle-timeout", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	tcppoolidle = cfg_obj_asuint32(obj) * 100;
+	if (tcppoolidle > MAX_KEEPALIVE_TIMEOUT) {
+		cfg_obj_log(obj, named_g_lctx, ISC_LOG_WARNING,
+			    "outgoing-tcp-idle-timeout value is out of range: "
+			    "lowering to %" PRIu32,
+			    MAX_KEEPALIVE_TIMEOUT / 100);
+		tcppoolidle = MAX_KEEPALIVE_TIMEOUT;
+	} else if (tcppoolidle < MIN_KEEPALIVE_TIMEOUT) {
+		cfg_obj_log(obj, named_g_lctx, ISC_LOG_WARNING,
+			    "outgoing-tcp-idle-timeout value is out of range: "
+			    "raising to %" PRIu32,
+			    MIN_KEEPALIVE_TIMEOUT / 100);
+		tcppoolidle = MIN_KEEPALIVE_TIMEOUT;
+	}
+
+	dns_dispatchmgr_setidle(named_g_dispatchmgr, tcppool, tcppoolidle);
+
 #define CAP_IF_NOT_ZERO(v, min, max) \
 	if (v > 0 && v < min) {      \
 		v = min;             \
@@ -8759,6 +9825,32 @@ load_configuration(const char *filename, named_server_t *server,
 
 #undef CAP_IF_NOT_ZERO
 
+	obj = NULL;
+	result = named_config_get(maps, "udp-send-batching", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+#if HAVE_SENDMMSG
+	isc_nm_setudpsendbatching(named_g_netmgr, cfg_obj_asboolean(obj));
+#else
+	if (cfg_obj_asboolean(obj)) {
+		cfg_obj_log(obj, named_g_lctx, ISC_LOG_WARNING,
+			    "udp-send-batching has no effect on this system");
+	}
+#endif
+
+	obj = NULL;
+	result = named_config_get(maps, "kernel-tls", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (cfg_obj_asboolean(obj) && !isc_tls_ktls_supported()) {
+		cfg_obj_log(obj, named_g_lctx, ISC_LOG_WARNING,
+			    "kernel-tls has no effect on this system");
+	}
+	isc_nm_setkerneltls(named_g_netmgr, cfg_obj_asboolean(obj));
+
+	obj = NULL;
+	result = named_config_get(maps, "loop-stall-threshold", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	isc_loopmgr_setstallthreshold(named_g_loopmgr, cfg_obj_asuint32(obj));
+
 	/*
 	 * Configure sets of UDP query source ports.
 	 */
@@ -8880,9 +9972,32 @@ load_configuration(const char *filename, named_server_t *server,
 	server->sctx->transfer_tcp_message_size =
 		(uint16_t)transfer_message_size;
 
+	/* Set the size of the rendered transfer stream cache */
+	obj = NULL;
+	result = named_config_get(maps, "transfer-cache-size", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	ns_xfrcache_setmaxsize(server->sctx->xfrcache,
+			       (size_t)cfg_obj_asuint64(obj));
+
 	/*
 	 * Configure the zone manager.
 	 */
+	obj = NULL;
+	result = named_config_get(maps, "concurrent-zone-loads", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	dns_zonemgr_setloadlimit(server->zonemgr, cfg_obj_asuint32(obj));
+	dns_zonemgr_setiolimit(server->zonemgr, cfg_obj_asuint32(obj));
+
+	obj = NULL;
+	result = named_config_get(maps, "concurrent-zone-dumps", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	dns_zonemgr_setdumplimit(server->zonemgr, cfg_obj_asuint32(obj));
+
+	obj = NULL;
+	result = named_config_get(maps, "dnssec-key-pool-depth", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	dns_zonemgr_setkeypooldepth(server->zonemgr, cfg_obj_asuint32(obj));
+
 	obj = NULL;
 	result = named_config_get(maps, "transfers-in", &obj);
 	INSIST(result == ISC_R_SUCCESS);
@@ -8964,6 +10079,52 @@ load_configuration(const char *filename, named_server_t *server,
 	}
 #endif
 
+	obj = NULL;
+	result = named_config_get(maps, "io-uring", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+#if HAVE_IO_URING
+	if (first_time) {
+		isc_nm_setiouring(named_g_netmgr, cfg_obj_asboolean(obj));
+	} else if (cfg_obj_asboolean(obj) != isc_nm_getiouring(named_g_netmgr))
+	{
+		cfg_obj_log(obj, named_g_lctx, ISC_LOG_WARNING,
+			    "changing io-uring value requires server restart");
+	}
+#else
+	if (cfg_obj_asboolean(obj)) {
+		cfg_obj_log(obj, named_g_lctx, ISC_LOG_WARNING,
+			    "io-uring has no effect on this system");
+	}
+#endif
+
+	obj = NULL;
+	result = named_config_get(maps, "af-xdp-interface", &obj);
+	if (result == ISC_R_SUCCESS) {
+#if HAVE_AF_XDP
+		const char *xdpiface = isc_nm_getxdp(named_g_netmgr);
+
+		if (first_time) {
+			result = isc_nm_setxdp(named_g_netmgr,
+					       cfg_obj_asstring(obj));
+			if (result != ISC_R_SUCCESS) {
+				cfg_obj_log(obj, named_g_lctx, ISC_LOG_WARNING,
+					    "AF_XDP not available on '%s': %s",
+					    cfg_obj_asstring(obj),
+					    isc_result_totext(result));
+			}
+		} else if (xdpiface == NULL ||
+			   strcmp(xdpiface, cfg_obj_asstring(obj)) != 0)
+		{
+			cfg_obj_log(obj, named_g_lctx, ISC_LOG_WARNING,
+				    "changing af-xdp-interface value requires "
+				    "server restart");
+		}
+#else
+		cfg_obj_log(obj, named_g_lctx, ISC_LOG_WARNING,
+			    "af-xdp-interface has no effect on this system");
+#endif
+	}
+
 	/*
 	 * Configure the interface manager according to the "listen-on"
 	 * statement.
@@ -9079,6 +10240,22 @@ load_configuration(const char *filename, named_server_t *server,
 	}
 	server->heartbeat_interval = heartbeat_interval;
 
+	/*
+	 * Configure the timer for saving the ADB state.
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "adb-save-interval", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	adb_save_interval = cfg_obj_asduration(obj);
+	if (adb_save_interval == 0) {
+		isc_timer_stop(server->adb_timer);
+	} else if (server->adb_save_interval != adb_save_interval) {
+		isc_interval_set(&interval, adb_save_interval, 0);
+		isc_timer_start(server->adb_timer, isc_timertype_ticker,
+				&interval);
+	}
+	server->adb_save_interval = adb_save_interval;
+
 	isc_interval_set(&interval, 1200, 0);
 	isc_timer_start(server->pps_timer, isc_timertype_ticker, &interval);
 
@@ -9331,6 +10508,8 @@ load_configuration(const char *filename, named_server_t *server,
 		view->viewlist = &server->viewlist;
 	}
 
+	index_views(server);
+
 	/* Swap our new cache list with the production one. */
 	tmpcachelist = server->cachelist;
 	server->cachelist = cachelist;
@@ -9564,6 +10743,11 @@ load_configuration(const char *filename, named_server_t *server,
 	INSIST(result == ISC_R_SUCCESS);
 	setstring(server, &server->recfile, cfg_obj_asstring(obj));
 
+	obj = NULL;
+	result = named_config_get(maps, "memprof-file", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	setstring(server, &server->memproffile, cfg_obj_asstring(obj));
+
 	obj = NULL;
 	result = named_config_get(maps, "version", &obj);
 	if (result == ISC_R_SUCCESS) {
@@ -9713,6 +10897,14 @@ load_configuration(const char *filename, named_server_t *server,
 
 	(void)named_server_loadnta(server);
 
+	/*
+	 * The ADBs are created anew with the views, so they are seeded
+	 * on every load, not only at startup.
+	 */
+	if (server->adb_save_interval != 0) {
+		(void)named_server_loadadb(server);
+	}
+
 #ifdef USE_DNSRPS
 	/*
 	 * Start and connect to the DNS Response Policy Service
@@ -9765,13 +10957,22 @@ load_configuration(const char *filename, named_server_t *server,
 		goto cleanup_altsecrets;
 	}
 
+	/*
+	 * The DoH response cache bypasses the access controls, so it is
+	 * only used when they do not depend on the client.
+	 */
+	ns_server_setoption(server->sctx, NS_SERVER_NOHTTPCACHE,
+			    !http_cache_allowed(server));
+
 	/*
 	 * Rescan the interface list to pick up changes in the
 	 * listen-on option.  It's important that we do this before we try
 	 * to configure the query source, since the dispatcher we use might
 	 * be shared with an interface.
 	 */
+	named_startup_begin(named_startup_interfaces);
 	result = ns_interfacemgr_scan(server->interfacemgr, true, true);
+	named_startup_end(named_startup_interfaces);
 
 	/*
 	 * Check that named is able to TCP listen on at least one
@@ -9865,6 +11066,21 @@ cleanup_exclusive:
 	return (result);
 }
 
+static isc_result_t
+startup_zoneloaded(dns_zone_t *zone, void *arg) {
+	char zname[DNS_NAME_FORMATSIZE];
+	uint64_t usecs = dns_zone_getloadduration(zone);
+
+	UNUSED(arg);
+
+	if (usecs > 0) {
+		dns_zone_name(zone, zname, sizeof(zname));
+		named_startup_zone(named_startup_load, zname, usecs);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
 static isc_result_t
 view_loaded(void *arg) {
 	isc_result_t result;
@@ -9901,6 +11117,17 @@ view_loaded(void *arg) {
 				      "all zones loaded");
 		}
 
+		if (!named_startup_isdone()) {
+			for (dns_view_t *view = ISC_LIST_HEAD(server->viewlist);
+			     view != NULL; view = ISC_LIST_NEXT(view, link))
+			{
+				(void)dns_zt_apply(view->zonetable, false, NULL,
+						   startup_zoneloaded, NULL);
+			}
+			named_startup_end(named_startup_load);
+			named_startup_done();
+		}
+
 		CHECKFATAL(dns_zonemgr_forcemaint(server->zonemgr),
 			   "forcing zone maintenance");
 
@@ -10040,6 +11267,9 @@ run_server(isc_task_t *task, isc_event_t *event) {
 	isc_timer_create(named_g_mainloop, pps_timer_tick, server,
 			 &server->pps_timer);
 
+	isc_timer_create(named_g_mainloop, adb_timer_tick, server,
+			 &server->adb_timer);
+
 	CHECKFATAL(
 		cfg_parser_create(named_g_mctx, named_g_lctx, &named_g_parser),
 		"creating default configuration parser");
@@ -10048,9 +11278,16 @@ run_server(isc_task_t *task, isc_event_t *event) {
 				     &named_g_addparser),
 		   "creating additional configuration parser");
 
+	named_startup_begin(named_startup_configure);
 	CHECKFATAL(load_configuration(named_g_conffile, server, true),
 		   "loading configuration");
+	named_startup_end(named_startup_configure);
 
+	/*
+	 * The load phase ends when the last view is loaded, in
+	 * view_loaded().
+	 */
+	named_startup_begin(named_startup_load);
 	CHECKFATAL(load_zones(server, false), "loading zones");
 #ifdef ENABLE_AFL
 	named_g_run_done = true;
@@ -10114,6 +11351,18 @@ shutdown_server(isc_task_t *task, isc_event_t *event) {
 
 	(void)named_server_saventa(server);
 
+	if (server->adb_save_interval != 0) {
+		(void)named_server_saveadb(server);
+	}
+
+	for (nsc = ISC_LIST_HEAD(server->cachelist); nsc != NULL;
+	     nsc = ISC_LIST_NEXT(nsc, link))
+	{
+		if (dns_cache_getsnapshotfile(nsc->cache) != NULL) {
+			(void)dns_cache_dumpsnapshot(nsc->cache);
+		}
+	}
+
 	for (kasp = ISC_LIST_HEAD(server->kasplist); kasp != NULL;
 	     kasp = kasp_next) {
 		kasp_next = ISC_LIST_NEXT(kasp, link);
@@ -10128,6 +11377,7 @@ shutdown_server(isc_task_t *task, isc_event_t *event) {
 		dns_view_flushonshutdown(view, flush);
 		dns_view_detach(&view);
 	}
+	index_views(server);
 
 	/*
 	 * Shut down all dyndb instances.
@@ -10146,9 +11396,11 @@ shutdown_server(isc_task_t *task, isc_event_t *event) {
 	isc_timer_destroy(&server->heartbeat_timer);
 	isc_timer_destroy(&server->pps_timer);
 	isc_timer_destroy(&server->tat_timer);
+	isc_timer_destroy(&server->adb_timer);
 
 	ns_interfacemgr_detach(&server->interfacemgr);
 
+	dns_dispatchmgr_setidle(named_g_dispatchmgr, 0, 0);
 	dns_dispatchmgr_detach(&named_g_dispatchmgr);
 
 	dns_zonemgr_shutdown(server->zonemgr);
@@ -10193,22 +11445,94 @@ named_server_shutdown(named_server_t *server) {
 	isc_task_send(server->task, &event);
 }
 
+/*%
+ * (Re)build the indexes of the match-clients and match-destinations ACLs
+ * of the views in server->viewlist, in view order.  Must be called with
+ * the server in exclusive mode whenever the view list changes.
+ */
+static void
+index_views(named_server_t *server) {
+	dns_acl_t *clients[DNS_ACLINDEX_MAX];
+	dns_acl_t *destinations[DNS_ACLINDEX_MAX];
+	unsigned int count = 0;
+
+	if (server->matchclients != NULL) {
+		dns_aclindex_destroy(&server->matchclients);
+		dns_aclindex_destroy(&server->matchdestinations);
+	}
+
+	for (dns_view_t *view = ISC_LIST_HEAD(server->viewlist);
+	     view != NULL && count < DNS_ACLINDEX_MAX;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		clients[count] = view->matchclients;
+		destinations[count] = view->matchdestinations;
+		count++;
+	}
+
+	if (count == 0) {
+		return;
+	}
+
+	dns_aclindex_create(server->mctx, clients, count,
+			    &server->matchclients);
+	dns_aclindex_create(server->mctx, destinations, count,
+			    &server->matchdestinations);
+}
+
 /*%
  * Find a view that matches the source and destination addresses of a query.
+ *
+ * Views whose match-clients and match-destinations are plain address
+ * lists are looked up in the indexes built by index_views(), so the
+ * TSIG signature only has to be rechecked for the view that is chosen;
+ * other views (and any after the first DNS_ACLINDEX_MAX) are evaluated
+ * one ACL at a time.
  */
 static isc_result_t
 get_matching_view(isc_netaddr_t *srcaddr, isc_netaddr_t *destaddr,
 		  dns_message_t *message, dns_aclenv_t *env,
 		  isc_result_t *sigresult, dns_view_t **viewp) {
+	named_server_t *server = named_g_server;
 	dns_view_t *view;
+	uint64_t indexed = 0, allowed = 0;
+	unsigned int i = 0;
 
 	REQUIRE(message != NULL);
 	REQUIRE(sigresult != NULL);
 	REQUIRE(viewp != NULL && *viewp == NULL);
 
-	for (view = ISC_LIST_HEAD(named_g_server->viewlist); view != NULL;
-	     view = ISC_LIST_NEXT(view, link))
+	if (server->matchclients != NULL &&
+	    (srcaddr->family == AF_INET || srcaddr->family == AF_INET6) &&
+	    (destaddr->family == AF_INET || destaddr->family == AF_INET6))
 	{
+		indexed = dns_aclindex_indexed(server->matchclients) &
+			  dns_aclindex_indexed(server->matchdestinations);
+		allowed = dns_aclindex_match(server->matchclients, srcaddr,
+					     env) &
+			  dns_aclindex_match(server->matchdestinations,
+					     destaddr, env);
+	}
+
+	for (view = ISC_LIST_HEAD(server->viewlist); view != NULL;
+	     view = ISC_LIST_NEXT(view, link), i++)
+	{
+		if (i < DNS_ACLINDEX_MAX && (indexed & ((uint64_t)1 << i)) != 0)
+		{
+			if ((message->rdclass == view->rdclass ||
+			     message->rdclass == dns_rdataclass_any) &&
+			    (allowed & ((uint64_t)1 << i)) != 0 &&
+			    !(view->matchrecursiveonly &&
+			      (message->flags & DNS_MESSAGEFLAG_RD) == 0))
+			{
+				*sigresult = dns_message_rechecksig(message,
+								    view);
+				dns_view_attach(view, viewp);
+				return (ISC_R_SUCCESS);
+			}
+			continue;
+		}
+
 		if (message->rdclass == view->rdclass ||
 		    message->rdclass == dns_rdataclass_any) {
 			const dns_name_t *tsig = NULL;
@@ -10249,6 +11573,7 @@ named_server_create(isc_mem_t *mctx, named_server_t **serverp) {
 		.dumpfile = isc_mem_strdup(mctx, "named_dump.db"),
 		.secrootsfile = isc_mem_strdup(mctx, "named.secroots"),
 		.recfile = isc_mem_strdup(mctx, "named.recursing"),
+		.memproffile = isc_mem_strdup(mctx, "named.memprof"),
 	};
 
 #ifdef USE_DNSRPS
@@ -10311,9 +11636,9 @@ named_server_create(isc_mem_t *mctx, named_server_t **serverp) {
 				      &server->zonemgr),
 		   "dns_zonemgr_create");
 
-	CHECKFATAL(isc_stats_create(server->mctx, &server->sockstats,
-				    isc_sockstatscounter_max),
-		   "isc_stats_create");
+	CHECKFATAL(isc_stats_createsharded(server->mctx, &server->sockstats,
+					   isc_sockstatscounter_max),
+		   "isc_stats_createsharded");
 	isc_nm_setstats(named_g_netmgr, server->sockstats);
 
 	CHECKFATAL(isc_stats_create(named_g_mctx, &server->zonestats,
@@ -10328,6 +11653,7 @@ named_server_create(isc_mem_t *mctx, named_server_t **serverp) {
 		   "named_controls_create");
 
 	ISC_LIST_INIT(server->dispatches);
+	isc_mutex_init(&server->zonecfg_lock);
 
 	ISC_LIST_INIT(server->statschannels);
 
@@ -10368,6 +11694,7 @@ named_server_destroy(named_server_t **serverp) {
 	isc_mem_free(server->mctx, server->dumpfile);
 	isc_mem_free(server->mctx, server->secrootsfile);
 	isc_mem_free(server->mctx, server->recfile);
+	isc_mem_free(server->mctx, server->memproffile);
 
 	if (server->version != NULL) {
 		isc_mem_free(server->mctx, server->version);
@@ -10388,6 +11715,9 @@ named_server_destroy(named_server_t **serverp) {
 	INSIST(ISC_LIST_EMPTY(server->kasplist));
 	INSIST(ISC_LIST_EMPTY(server->viewlist));
 	INSIST(ISC_LIST_EMPTY(server->cachelist));
+	INSIST(server->zonecfg_batch == NULL);
+
+	isc_mutex_destroy(&server->zonecfg_lock);
 
 	if (server->tlsctx_server_cache != NULL) {
 		isc_tlsctx_cache_detach(&server->tlsctx_server_cache);
@@ -10463,6 +11793,11 @@ named_add_reserved_dispatch(named_server_t *server,
 		return;
 	}
 
+	/*
+	 * The zones can be configured in parallel.
+	 */
+	LOCK(&server->zonecfg_lock);
+
 	for (dispatch = ISC_LIST_HEAD(server->dispatches); dispatch != NULL;
 	     dispatch = ISC_LIST_NEXT(dispatch, link))
 	{
@@ -10472,6 +11807,7 @@ named_add_reserved_dispatch(named_server_t *server,
 	}
 	if (dispatch != NULL) {
 		dispatch->dispatchgen = server->dispatchgen;
+		UNLOCK(&server->zonecfg_lock);
 		return;
 	}
 
@@ -10488,10 +11824,12 @@ named_add_reserved_dispatch(named_server_t *server,
 	}
 
 	ISC_LIST_INITANDPREPEND(server->dispatches, dispatch, link);
+	UNLOCK(&server->zonecfg_lock);
 
 	return;
 
 cleanup:
+	UNLOCK(&server->zonecfg_lock);
 	isc_mem_put(server->mctx, dispatch, sizeof(*dispatch));
 	isc_sockaddr_format(addr, addrbuf, sizeof(addrbuf));
 	isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
@@ -11110,12 +12448,13 @@ listenelt_fromconfig(const cfg_obj_t *listener, const cfg_obj_t *config,
 	isc_result_t result;
 	const cfg_obj_t *ltup = NULL;
 	const cfg_obj_t *tlsobj = NULL, *httpobj = NULL;
-	const cfg_obj_t *portobj = NULL, *dscpobj = NULL;
+	const cfg_obj_t *portobj = NULL, *dscpobj = NULL, *proxyobj = NULL;
 	const cfg_obj_t *http_server = NULL;
 	in_port_t port = 0;
 	isc_dscp_t dscp = -1;
 	const char *key = NULL, *cert = NULL, *ca_file = NULL,
-		   *dhparam_file = NULL, *ciphers = NULL;
+		   *dhparam_file = NULL, *ciphers = NULL,
+		   *ticket_key_file = NULL;
 	bool tls_prefer_server_ciphers = false,
 	     tls_prefer_server_ciphers_set = false;
 	bool tls_session_tickets = false, tls_session_tickets_set = false;
@@ -11146,6 +12485,7 @@ listenelt_fromconfig(const cfg_obj_t *listener, const cfg_obj_t *config,
 			const cfg_obj_t *ciphers_obj = NULL;
 			const cfg_obj_t *prefer_server_ciphers_obj = NULL;
 			const cfg_obj_t *session_tickets_obj = NULL;
+			const cfg_obj_t *ticket_key_obj = NULL;
 
 			do_tls = true;
 
@@ -11216,6 +12556,13 @@ listenelt_fromconfig(const cfg_obj_t *listener, const cfg_obj_t *config,
 					cfg_obj_asboolean(session_tickets_obj);
 				tls_session_tickets_set = true;
 			}
+
+			if (cfg_map_get(tlsmap, "ticket-key-file",
+					&ticket_key_obj) == ISC_R_SUCCESS)
+			{
+				ticket_key_file =
+					cfg_obj_asstring(ticket_key_obj);
+			}
 		}
 	}
 
@@ -11230,7 +12577,8 @@ listenelt_fromconfig(const cfg_obj_t *listener, const cfg_obj_t *config,
 		.prefer_server_ciphers = tls_prefer_server_ciphers,
 		.prefer_server_ciphers_set = tls_prefer_server_ciphers_set,
 		.session_tickets = tls_session_tickets,
-		.session_tickets_set = tls_session_tickets_set
+		.session_tickets_set = tls_session_tickets_set,
+		.ticket_key_file = ticket_key_file
 	};
 
 	httpobj = cfg_tuple_get(ltup, "http");
@@ -11333,6 +12681,12 @@ listenelt_fromconfig(const cfg_obj_t *listener, const cfg_obj_t *config,
 		ns_listenelt_destroy(delt);
 		return (result);
 	}
+
+	proxyobj = cfg_tuple_get(ltup, "proxy");
+	if (proxyobj != NULL && cfg_obj_isboolean(proxyobj)) {
+		delt->proxy = cfg_obj_asboolean(proxyobj);
+	}
+
 	*target = delt;
 
 cleanup:
@@ -11353,6 +12707,8 @@ listenelt_http(const cfg_obj_t *http, const uint16_t family, bool tls,
 	size_t len = 1, i = 0;
 	uint32_t max_clients = named_g_http_listener_clients;
 	uint32_t max_streams = named_g_http_streams_per_conn;
+	uint32_t cache_size = 0;
+	ns_listen_http2_settings_t http2_settings = { 0 };
 
 	REQUIRE(target != NULL && *target == NULL);
 
@@ -11372,6 +12728,8 @@ listenelt_http(const cfg_obj_t *http, const uint16_t family, bool tls,
 	if (http != NULL) {
 		const cfg_obj_t *cfg_max_clients = NULL;
 		const cfg_obj_t *cfg_max_streams = NULL;
+		const cfg_obj_t *cfg_cache_size = NULL;
+		const cfg_obj_t *obj = NULL;
 
 		if (cfg_map_get(http, "endpoints", &eplist) == ISC_R_SUCCESS) {
 			INSIST(eplist != NULL);
@@ -11390,6 +12748,35 @@ listenelt_http(const cfg_obj_t *http, const uint16_t family, bool tls,
 			INSIST(cfg_max_streams != NULL);
 			max_streams = cfg_obj_asuint32(cfg_max_streams);
 		}
+
+		if (cfg_map_get(http, "response-cache-size",
+				&cfg_cache_size) == ISC_R_SUCCESS)
+		{
+			INSIST(cfg_cache_size != NULL);
+			cache_size = cfg_obj_asuint32(cfg_cache_size);
+		}
+
+		obj = NULL;
+		if (cfg_map_get(http, "initial-window-size", &obj) ==
+		    ISC_R_SUCCESS)
+		{
+			http2_settings.initial_window_size =
+				cfg_obj_asuint32(obj);
+		}
+
+		obj = NULL;
+		if (cfg_map_get(http, "max-frame-size", &obj) == ISC_R_SUCCESS)
+		{
+			http2_settings.max_frame_size = cfg_obj_asuint32(obj);
+		}
+
+		obj = NULL;
+		if (cfg_map_get(http, "header-table-size", &obj) ==
+		    ISC_R_SUCCESS)
+		{
+			http2_settings.header_table_size =
+				cfg_obj_asuint32(obj);
+		}
 	}
 
 	endpoints = isc_mem_allocate(mctx, sizeof(endpoints[0]) * len);
@@ -11409,7 +12796,8 @@ listenelt_http(const cfg_obj_t *http, const uint16_t family, bool tls,
 
 	result = ns_listenelt_create_http(
 		mctx, port, named_g_dscp, NULL, family, tls, tls_params,
-		tlsctx_cache, endpoints, len, max_clients, max_streams, &delt);
+		tlsctx_cache, endpoints, len, max_clients, max_streams,
+		cache_size, &http2_settings, &delt);
 	if (result != ISC_R_SUCCESS) {
 		goto error;
 	}
@@ -12222,6 +13610,85 @@ named_server_flushcache(named_server_t *server, isc_lex_t *lex) {
 	return (result);
 }
 
+isc_result_t
+named_server_snapshotcache(named_server_t *server, isc_lex_t *lex,
+			   isc_buffer_t **text) {
+	isc_result_t result = ISC_R_SUCCESS, tresult;
+	dns_view_t *view = NULL;
+	named_cache_t *nsc = NULL;
+	char *ptr = NULL, *viewname = NULL;
+	bool found = false;
+	char tbuf[100];
+
+	REQUIRE(text != NULL);
+
+	/* Skip the command name. */
+	ptr = next_token(lex, text);
+	if (ptr == NULL) {
+		return (ISC_R_UNEXPECTEDEND);
+	}
+
+	/* Look for the view name. */
+	viewname = next_token(lex, text);
+
+	/*
+	 * Walk the cache list rather than the views so that a cache
+	 * shared by several views is only written once.
+	 */
+	for (nsc = ISC_LIST_HEAD(server->cachelist); nsc != NULL;
+	     nsc = ISC_LIST_NEXT(nsc, link))
+	{
+		const char *filename = dns_cache_getsnapshotfile(nsc->cache);
+
+		if (viewname != NULL) {
+			for (view = ISC_LIST_HEAD(server->viewlist);
+			     view != NULL; view = ISC_LIST_NEXT(view, link))
+			{
+				if (view->cache == nsc->cache &&
+				    strcasecmp(view->name, viewname) == 0)
+				{
+					break;
+				}
+			}
+			if (view == NULL) {
+				continue;
+			}
+		}
+
+		found = true;
+		if (filename == NULL) {
+			if (viewname != NULL) {
+				snprintf(tbuf, sizeof(tbuf),
+					 "view '%s': no cache-snapshot-file",
+					 viewname);
+				(void)putstr(text, tbuf);
+				result = ISC_R_FAILURE;
+			}
+			continue;
+		}
+
+		tresult = dns_cache_dumpsnapshot(nsc->cache);
+		if (tresult != ISC_R_SUCCESS) {
+			snprintf(tbuf, sizeof(tbuf),
+				 "view '%s': writing snapshot failed: %s",
+				 nsc->primaryview->name,
+				 isc_result_totext(tresult));
+			if (isc_buffer_usedlength(*text) > 0) {
+				(void)putstr(text, "\n");
+			}
+			(void)putstr(text, tbuf);
+			result = tresult;
+		}
+	}
+
+	if (!found) {
+		(void)putstr(text, "view not found");
+		result = ISC_R_NOTFOUND;
+	}
+
+	return (result);
+}
+
 isc_result_t
 named_server_flushnode(named_server_t *server, isc_lex_t *lex, bool tree) {
 	char *ptr, *viewname;
@@ -12436,6 +13903,30 @@ named_server_status(named_server_t *server, isc_buffer_t **text) {
 		CHECK(putstr(text, line));
 	}
 
+	if (named_startup_isdone()) {
+		uint64_t total = named_startup_gettotal();
+
+		snprintf(line, sizeof(line),
+			 "startup time: %" PRIu64 ".%03" PRIu64 "s (",
+			 total / 1000000, total % 1000000 / 1000);
+		CHECK(putstr(text, line));
+		for (named_startup_phase_t phase = 0;
+		     phase < named_startup_max; phase++)
+		{
+			named_startup_stats_t stats;
+
+			named_startup_getstats(phase, &stats);
+			snprintf(line, sizeof(line),
+				 "%s%s %" PRIu64 ".%03" PRIu64 "s",
+				 phase > 0 ? ", " : "",
+				 named_startup_phasename(phase),
+				 stats.wall / 1000000,
+				 stats.wall % 1000000 / 1000);
+			CHECK(putstr(text, line));
+		}
+		CHECK(putstr(text, ")\n"));
+	}
+
 	CHECK(putstr(text, "server is up and running"));
 	CHECK(putnull(text));
 
@@ -12483,57 +13974,38 @@ delete_keynames(dns_tsig_keyring_t *ring, char *target,
 		unsigned int *foundkeys) {
 	char namestr[DNS_NAME_FORMATSIZE];
 	isc_result_t result;
-	dns_rbtnodechain_t chain;
-	dns_name_t foundname;
-	dns_fixedname_t fixedorigin;
-	dns_name_t *origin;
-	dns_rbtnode_t *node;
-	dns_tsigkey_t *tkey;
+	isc_ht_iter_t *it = NULL;
+	dns_tsigkey_t *found = NULL;
 
-	dns_name_init(&foundname, NULL);
-	origin = dns_fixedname_initname(&fixedorigin);
-
-again:
-	dns_rbtnodechain_init(&chain);
-	result = dns_rbtnodechain_first(&chain, ring->keys, &foundname, origin);
-	if (result == ISC_R_NOTFOUND) {
-		dns_rbtnodechain_invalidate(&chain);
-		return (ISC_R_SUCCESS);
-	}
-	if (result != ISC_R_SUCCESS && result != DNS_R_NEWORIGIN) {
-		dns_rbtnodechain_invalidate(&chain);
-		return (result);
-	}
-
-	for (;;) {
-		node = NULL;
-		dns_rbtnodechain_current(&chain, &foundname, origin, &node);
-		tkey = node->data;
-
-		if (tkey != NULL) {
-			if (!tkey->generated) {
-				goto nextkey;
-			}
+	/*
+	 * Key names are unique within a ring, so at most one
+	 * generated key can match.
+	 */
+	RWLOCK(&ring->lock, isc_rwlocktype_read);
+	isc_ht_iter_create(ring->keys, &it);
+	for (result = isc_ht_iter_first(it); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_next(it))
+	{
+		dns_tsigkey_t *tkey = NULL;
 
-			dns_name_format(&tkey->name, namestr, sizeof(namestr));
-			if (strcmp(namestr, target) == 0) {
-				(*foundkeys)++;
-				dns_rbtnodechain_invalidate(&chain);
-				(void)dns_rbt_deletename(ring->keys,
-							 &tkey->name, false);
-				goto again;
-			}
+		isc_ht_iter_current(it, (void **)&tkey);
+		if (!tkey->generated) {
+			continue;
 		}
 
-	nextkey:
-		result = dns_rbtnodechain_next(&chain, &foundname, origin);
-		if (result == ISC_R_NOMORE) {
+		dns_name_format(&tkey->name, namestr, sizeof(namestr));
+		if (strcmp(namestr, target) == 0) {
+			dns_tsigkey_attach(tkey, &found);
 			break;
 		}
-		if (result != ISC_R_SUCCESS && result != DNS_R_NEWORIGIN) {
-			dns_rbtnodechain_invalidate(&chain);
-			return (result);
-		}
+	}
+	isc_ht_iter_destroy(&it);
+	RWUNLOCK(&ring->lock, isc_rwlocktype_read);
+
+	if (found != NULL) {
+		(*foundkeys)++;
+		dns_tsigkey_setdeleted(found);
+		dns_tsigkey_detach(&found);
 	}
 
 	return (ISC_R_SUCCESS);
@@ -12566,11 +14038,8 @@ named_server_tsigdelete(named_server_t *server, isc_lex_t *lex,
 	     view = ISC_LIST_NEXT(view, link))
 	{
 		if (viewname == NULL || strcmp(view->name, viewname) == 0) {
-			RWLOCK(&view->dynamickeys->lock, isc_rwlocktype_write);
 			result = delete_keynames(view->dynamickeys, target,
 						 &foundkeys);
-			RWUNLOCK(&view->dynamickeys->lock,
-				 isc_rwlocktype_write);
 			if (result != ISC_R_SUCCESS) {
 				isc_task_endexclusive(server->task);
 				return (result);
@@ -12595,12 +14064,7 @@ list_keynames(dns_view_t *view, dns_tsig_keyring_t *ring, isc_buffer_t **text,
 	char namestr[DNS_NAME_FORMATSIZE];
 	char creatorstr[DNS_NAME_FORMATSIZE];
 	isc_result_t result;
-	dns_rbtnodechain_t chain;
-	dns_name_t foundname;
-	dns_fixedname_t fixedorigin;
-	dns_name_t *origin;
-	dns_rbtnode_t *node;
-	dns_tsigkey_t *tkey;
+	isc_ht_iter_t *it = NULL;
 	const char *viewname;
 
 	if (view != NULL) {
@@ -12609,62 +14073,43 @@ list_keynames(dns_view_t *view, dns_tsig_keyring_t *ring, isc_buffer_t **text,
 		viewname = "(global)";
 	}
 
-	dns_name_init(&foundname, NULL);
-	origin = dns_fixedname_initname(&fixedorigin);
-	dns_rbtnodechain_init(&chain);
-	result = dns_rbtnodechain_first(&chain, ring->keys, &foundname, origin);
-	if (result == ISC_R_NOTFOUND) {
-		dns_rbtnodechain_invalidate(&chain);
-		return (ISC_R_SUCCESS);
-	}
-	if (result != ISC_R_SUCCESS && result != DNS_R_NEWORIGIN) {
-		dns_rbtnodechain_invalidate(&chain);
-		return (result);
-	}
-
-	for (;;) {
-		node = NULL;
-		dns_rbtnodechain_current(&chain, &foundname, origin, &node);
-		tkey = node->data;
-
-		if (tkey != NULL) {
-			dns_name_format(&tkey->name, namestr, sizeof(namestr));
-			if (tkey->generated) {
-				dns_name_format(tkey->creator, creatorstr,
-						sizeof(creatorstr));
-				if (*foundkeys != 0) {
-					CHECK(putstr(text, "\n"));
-				}
-				CHECK(putstr(text, "view \""));
-				CHECK(putstr(text, viewname));
-				CHECK(putstr(text, "\"; type \"dynamic\"; key "
-						   "\""));
-				CHECK(putstr(text, namestr));
-				CHECK(putstr(text, "\"; creator \""));
-				CHECK(putstr(text, creatorstr));
-				CHECK(putstr(text, "\";"));
-			} else {
-				if (*foundkeys != 0) {
-					CHECK(putstr(text, "\n"));
-				}
-				CHECK(putstr(text, "view \""));
-				CHECK(putstr(text, viewname));
-				CHECK(putstr(text, "\"; type \"static\"; key "
-						   "\""));
-				CHECK(putstr(text, namestr));
-				CHECK(putstr(text, "\";"));
+	isc_ht_iter_create(ring->keys, &it);
+	for (result = isc_ht_iter_first(it); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_next(it))
+	{
+		dns_tsigkey_t *tkey = NULL;
+
+		isc_ht_iter_current(it, (void **)&tkey);
+		dns_name_format(&tkey->name, namestr, sizeof(namestr));
+		if (tkey->generated) {
+			dns_name_format(tkey->creator, creatorstr,
+					sizeof(creatorstr));
+			if (*foundkeys != 0) {
+				CHECK(putstr(text, "\n"));
 			}
-			(*foundkeys)++;
-		}
-		result = dns_rbtnodechain_next(&chain, &foundname, origin);
-		if (result == ISC_R_NOMORE || result == DNS_R_NEWORIGIN) {
-			break;
+			CHECK(putstr(text, "view \""));
+			CHECK(putstr(text, viewname));
+			CHECK(putstr(text, "\"; type \"dynamic\"; key \""));
+			CHECK(putstr(text, namestr));
+			CHECK(putstr(text, "\"; creator \""));
+			CHECK(putstr(text, creatorstr));
+			CHECK(putstr(text, "\";"));
+		} else {
+			if (*foundkeys != 0) {
+				CHECK(putstr(text, "\n"));
+			}
+			CHECK(putstr(text, "view \""));
+			CHECK(putstr(text, viewname));
+			CHECK(putstr(text, "\"; type \"static\"; key \""));
+			CHECK(putstr(text, namestr));
+			CHECK(putstr(text, "\";"));
 		}
+		(*foundkeys)++;
 	}
+	result = ISC_R_SUCCESS;
 
-	return (ISC_R_SUCCESS);
 cleanup:
-	dns_rbtnodechain_invalidate(&chain);
+	isc_ht_iter_destroy(&it);
 	return (result);
 }
 
@@ -13192,13 +14637,17 @@ dumpzone(void *arg, const char *buf, int len) {
 	}
 }
 
+/*
+ * Store the configuration of 'zone' in the NZD, or delete it if 'zconfig'
+ * is NULL, without committing the transaction.  Returns ISC_R_NOTFOUND
+ * if there was nothing to delete.
+ */
 static isc_result_t
-nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
-	 const cfg_obj_t *zconfig) {
+nzd_put(MDB_txn *txn, MDB_dbi dbi, dns_zone_t *zone,
+	const cfg_obj_t *zconfig) {
 	isc_result_t result;
 	int status;
 	dns_view_t *view;
-	bool commit = false;
 	isc_buffer_t *text = NULL;
 	char namebuf[1024];
 	MDB_val key, data;
@@ -13210,8 +14659,11 @@ nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
 
 	if (zconfig == NULL) {
 		/* We're deleting the zone from the database */
-		status = mdb_del(*txnp, dbi, &key, NULL);
-		if (status != MDB_SUCCESS && status != MDB_NOTFOUND) {
+		status = mdb_del(txn, dbi, &key, NULL);
+		if (status == MDB_NOTFOUND) {
+			result = ISC_R_NOTFOUND;
+			goto cleanup;
+		} else if (status != MDB_SUCCESS) {
 			isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
 				      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
 				      "Error deleting zone %s "
@@ -13219,8 +14671,6 @@ nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
 				      namebuf, mdb_strerror(status));
 			result = ISC_R_FAILURE;
 			goto cleanup;
-		} else if (status != MDB_NOTFOUND) {
-			commit = true;
 		}
 	} else {
 		/* We're creating or overwriting the zone */
@@ -13233,7 +14683,7 @@ nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
 			isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
 				      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
 				      "Unable to get options from config in "
-				      "nzd_save()");
+				      "nzd_put()");
 			result = ISC_R_FAILURE;
 			goto cleanup;
 		}
@@ -13246,7 +14696,7 @@ nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
 			isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
 				      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
 				      "Error writing zone config to "
-				      "buffer in nzd_save(): %s",
+				      "buffer in nzd_put(): %s",
 				      isc_result_totext(dzarg.result));
 			result = dzarg.result;
 			goto cleanup;
@@ -13255,7 +14705,7 @@ nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
 		data.mv_data = isc_buffer_base(text);
 		data.mv_size = isc_buffer_usedlength(text);
 
-		status = mdb_put(*txnp, dbi, &key, &data, 0);
+		status = mdb_put(txn, dbi, &key, &data, 0);
 		if (status != MDB_SUCCESS) {
 			isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
 				      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
@@ -13265,13 +14715,32 @@ nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
 			result = ISC_R_FAILURE;
 			goto cleanup;
 		}
-
-		commit = true;
 	}
 
 	result = ISC_R_SUCCESS;
 
 cleanup:
+	if (text != NULL) {
+		isc_buffer_free(&text);
+	}
+
+	return (result);
+}
+
+static isc_result_t
+nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
+	 const cfg_obj_t *zconfig) {
+	isc_result_t result;
+	int status;
+	bool commit = false;
+
+	result = nzd_put(*txnp, dbi, zone, zconfig);
+	if (result == ISC_R_SUCCESS) {
+		commit = true;
+	} else if (result == ISC_R_NOTFOUND) {
+		result = ISC_R_SUCCESS;
+	}
+
 	if (!commit || result != ISC_R_SUCCESS) {
 		(void)mdb_txn_abort(*txnp);
 	} else {
@@ -13287,10 +14756,6 @@ cleanup:
 	}
 	*txnp = NULL;
 
-	if (text != NULL) {
-		isc_buffer_free(&text);
-	}
-
 	return (result);
 }
 
@@ -13653,6 +15118,81 @@ cleanup:
 }
 #endif /* HAVE_LMDB */
 
+/*
+ * Check that the type of the zone 'zoneobj' can be added or modified
+ * at runtime by the 'bn' command.
+ */
+static isc_result_t
+newzone_checktype(const cfg_obj_t *zoneobj, const char *bn, bool *redirectp,
+		  isc_buffer_t **text) {
+	const cfg_obj_t *zoptions = NULL;
+	const cfg_obj_t *obj = NULL;
+
+	zoptions = cfg_tuple_get(zoneobj, "options");
+
+	(void)cfg_map_get(zoptions, "type", &obj);
+	if (obj == NULL) {
+		(void)cfg_map_get(zoptions, "in-view", &obj);
+		if (obj != NULL) {
+			(void)putstr(text, "'in-view' zones not supported by ");
+			(void)putstr(text, bn);
+		} else {
+			(void)putstr(text, "zone type not specified");
+		}
+		return (ISC_R_FAILURE);
+	}
+
+	if (strcasecmp(cfg_obj_asstring(obj), "hint") == 0 ||
+	    strcasecmp(cfg_obj_asstring(obj), "forward") == 0 ||
+	    strcasecmp(cfg_obj_asstring(obj), "delegation-only") == 0)
+	{
+		(void)putstr(text, "'");
+		(void)putstr(text, cfg_obj_asstring(obj));
+		(void)putstr(text, "' zones not supported by ");
+		(void)putstr(text, bn);
+		return (ISC_R_FAILURE);
+	}
+
+	*redirectp = (strcasecmp(cfg_obj_asstring(obj), "redirect") == 0);
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Find the view named by the optional class and view arguments of the
+ * zone 'zoneobj'.
+ */
+static isc_result_t
+newzone_findview(named_server_t *server, const cfg_obj_t *zoneobj,
+		 dns_view_t **viewp, isc_buffer_t **text) {
+	isc_result_t result;
+	const cfg_obj_t *obj = NULL;
+	const char *viewname = NULL;
+	dns_rdataclass_t rdclass;
+
+	/* Make sense of optional class argument */
+	obj = cfg_tuple_get(zoneobj, "class");
+	CHECK(named_config_getclass(obj, dns_rdataclass_in, &rdclass));
+
+	/* Make sense of optional view argument */
+	obj = cfg_tuple_get(zoneobj, "view");
+	if (obj && cfg_obj_isstring(obj)) {
+		viewname = cfg_obj_asstring(obj);
+	}
+	if (viewname == NULL || *viewname == '\0') {
+		viewname = "_default";
+	}
+	result = dns_viewlist_find(&server->viewlist, viewname, rdclass, viewp);
+	if (result == ISC_R_NOTFOUND) {
+		(void)putstr(text, "no matching view found for '");
+		(void)putstr(text, viewname);
+		(void)putstr(text, "'");
+	}
+
+cleanup:
+	return (result);
+}
+
 static isc_result_t
 newzone_parse(named_server_t *server, char *command, dns_view_t **viewp,
 	      cfg_obj_t **zoneconfp, const cfg_obj_t **zoneobjp,
@@ -13663,10 +15203,6 @@ newzone_parse(named_server_t *server, char *command, dns_view_t **viewp,
 	cfg_obj_t *zoneconf = NULL;
 	const cfg_obj_t *zlist = NULL;
 	const cfg_obj_t *zoneobj = NULL;
-	const cfg_obj_t *zoptions = NULL;
-	const cfg_obj_t *obj = NULL;
-	const char *viewname = NULL;
-	dns_rdataclass_t rdclass;
 	dns_view_t *view = NULL;
 	const char *bn = NULL;
 
@@ -13705,57 +15241,9 @@ newzone_parse(named_server_t *server, char *command, dns_view_t **viewp,
 	zoneobj = cfg_listelt_value(cfg_list_first(zlist));
 
 	/* Check the zone type for ones that are not supported by addzone. */
-	zoptions = cfg_tuple_get(zoneobj, "options");
+	CHECK(newzone_checktype(zoneobj, bn, &redirect, text));
 
-	obj = NULL;
-	(void)cfg_map_get(zoptions, "type", &obj);
-	if (obj == NULL) {
-		(void)cfg_map_get(zoptions, "in-view", &obj);
-		if (obj != NULL) {
-			(void)putstr(text, "'in-view' zones not supported by ");
-			(void)putstr(text, bn);
-		} else {
-			(void)putstr(text, "zone type not specified");
-		}
-		CHECK(ISC_R_FAILURE);
-	}
-
-	if (strcasecmp(cfg_obj_asstring(obj), "hint") == 0 ||
-	    strcasecmp(cfg_obj_asstring(obj), "forward") == 0 ||
-	    strcasecmp(cfg_obj_asstring(obj), "delegation-only") == 0)
-	{
-		(void)putstr(text, "'");
-		(void)putstr(text, cfg_obj_asstring(obj));
-		(void)putstr(text, "' zones not supported by ");
-		(void)putstr(text, bn);
-		CHECK(ISC_R_FAILURE);
-	}
-
-	if (strcasecmp(cfg_obj_asstring(obj), "redirect") == 0) {
-		redirect = true;
-	}
-
-	/* Make sense of optional class argument */
-	obj = cfg_tuple_get(zoneobj, "class");
-	CHECK(named_config_getclass(obj, dns_rdataclass_in, &rdclass));
-
-	/* Make sense of optional view argument */
-	obj = cfg_tuple_get(zoneobj, "view");
-	if (obj && cfg_obj_isstring(obj)) {
-		viewname = cfg_obj_asstring(obj);
-	}
-	if (viewname == NULL || *viewname == '\0') {
-		viewname = "_default";
-	}
-	result = dns_viewlist_find(&server->viewlist, viewname, rdclass, &view);
-	if (result == ISC_R_NOTFOUND) {
-		(void)putstr(text, "no matching view found for '");
-		(void)putstr(text, viewname);
-		(void)putstr(text, "'");
-		goto cleanup;
-	} else if (result != ISC_R_SUCCESS) {
-		goto cleanup;
-	}
+	CHECK(newzone_findview(server, zoneobj, &view, text));
 
 	*viewp = view;
 	*zoneobjp = zoneobj;
@@ -14256,69 +15744,357 @@ named_server_changezone(named_server_t *server, char *command,
 
 	REQUIRE(text != NULL);
 
-	if (strncasecmp(command, "add", 3) == 0) {
-		addzone = true;
-	} else {
-		INSIST(strncasecmp(command, "mod", 3) == 0);
-		addzone = false;
+	if (strncasecmp(command, "add", 3) == 0) {
+		addzone = true;
+	} else {
+		INSIST(strncasecmp(command, "mod", 3) == 0);
+		addzone = false;
+	}
+
+	CHECK(newzone_parse(server, command, &view, &zoneconf, &zoneobj,
+			    &redirect, text));
+
+	/* Are we accepting new zones in this view? */
+#ifdef HAVE_LMDB
+	if (view->new_zone_db == NULL)
+#else  /* ifdef HAVE_LMDB */
+	if (view->new_zone_file == NULL)
+#endif /* HAVE_LMDB */
+	{
+		(void)putstr(text, "Not allowing new zones in view '");
+		(void)putstr(text, view->name);
+		(void)putstr(text, "'");
+		result = ISC_R_NOPERM;
+		goto cleanup;
+	}
+
+	cfg = (ns_cfgctx_t *)view->new_zone_config;
+	if (cfg == NULL) {
+		result = ISC_R_FAILURE;
+		goto cleanup;
+	}
+
+	zonename = cfg_obj_asstring(cfg_tuple_get(zoneobj, "name"));
+	isc_buffer_constinit(&buf, zonename, strlen(zonename));
+	isc_buffer_add(&buf, strlen(zonename));
+
+	dnsname = dns_fixedname_initname(&fname);
+	CHECK(dns_name_fromtext(dnsname, &buf, dns_rootname, 0, NULL));
+
+	if (redirect) {
+		if (!dns_name_equal(dnsname, dns_rootname)) {
+			(void)putstr(text, "redirect zones must be called "
+					   "\".\"");
+			CHECK(ISC_R_FAILURE);
+		}
+	}
+
+	if (addzone) {
+		CHECK(do_addzone(server, cfg, view, dnsname, zoneconf, zoneobj,
+				 redirect, text));
+	} else {
+		CHECK(do_modzone(server, cfg, view, dnsname, zonename, zoneobj,
+				 redirect, text));
+	}
+
+	isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+		      NAMED_LOGMODULE_SERVER, ISC_LOG_INFO,
+		      "%s zone %s in view %s via %s",
+		      addzone ? "added" : "updated", zonename, view->name,
+		      addzone ? NAMED_COMMAND_ADDZONE : NAMED_COMMAND_MODZONE);
+
+	/* Changing a zone counts as reconfiguration */
+	CHECK(isc_time_now(&named_g_configtime));
+
+cleanup:
+	if (isc_buffer_usedlength(*text) > 0) {
+		(void)putnull(text);
+	}
+	if (zoneconf != NULL) {
+		cfg_obj_destroy(named_g_addparser, &zoneconf);
+	}
+	if (view != NULL) {
+		dns_view_detach(&view);
+	}
+
+	return (result);
+}
+
+#ifdef HAVE_LMDB
+/*
+ * Check a zone of an "addzones" batch, and the view it belongs to:
+ * all the zones of a batch must belong to the same view.
+ */
+static isc_result_t
+addzones_check(named_server_t *server, const cfg_obj_t *zoneobj,
+	       dns_view_t **viewp, isc_buffer_t **text) {
+	isc_result_t result;
+	const char *zonename = NULL;
+	dns_fixedname_t fname;
+	dns_name_t *dnsname = NULL;
+	dns_view_t *view = NULL;
+	dns_zone_t *zone = NULL;
+	bool redirect = false;
+
+	zonename = cfg_obj_asstring(cfg_tuple_get(zoneobj, "name"));
+
+	CHECK(newzone_checktype(zoneobj, NAMED_COMMAND_ADDZONES, &redirect,
+				text));
+	if (redirect) {
+		(void)putstr(text, "redirect zones not supported by ");
+		(void)putstr(text, NAMED_COMMAND_ADDZONES);
+		CHECK(ISC_R_FAILURE);
+	}
+
+	CHECK(newzone_findview(server, zoneobj, &view, text));
+	if (*viewp == NULL) {
+		dns_view_attach(view, viewp);
+	} else if (view != *viewp) {
+		(void)putstr(text, "all the zones must be in the same view");
+		CHECK(ISC_R_FAILURE);
+	}
+
+	/* Zone shouldn't already exist */
+	dnsname = dns_fixedname_initname(&fname);
+	CHECK(dns_name_fromstring(dnsname, zonename, 0, NULL));
+	result = dns_zt_find(view->zonetable, dnsname, 0, NULL, &zone);
+	if (result == ISC_R_SUCCESS) {
+		CHECK(ISC_R_EXISTS);
+	} else if (result == DNS_R_PARTIALMATCH) {
+		result = ISC_R_SUCCESS;
+	}
+
+cleanup:
+	if (result != ISC_R_SUCCESS) {
+		if (isc_buffer_usedlength(*text) > 0) {
+			(void)putstr(text, ": ");
+		}
+		(void)putstr(text, "zone '");
+		(void)putstr(text, zonename);
+		(void)putstr(text, "': ");
+		(void)putstr(text, isc_result_totext(result));
+	}
+	if (zone != NULL) {
+		dns_zone_detach(&zone);
+	}
+	if (view != NULL) {
+		dns_view_detach(&view);
+	}
+
+	return (result);
+}
+#endif /* HAVE_LMDB */
+
+isc_result_t
+named_server_addzones(named_server_t *server, isc_lex_t *lex,
+		      isc_buffer_t **text) {
+#ifndef HAVE_LMDB
+	UNUSED(server);
+	UNUSED(lex);
+
+	(void)putstr(text, "addzones requires the new zone database (LMDB)");
+	(void)putnull(text);
+
+	return (ISC_R_NOTIMPLEMENTED);
+#else  /* HAVE_LMDB */
+	isc_result_t result;
+	const char *filename = NULL;
+	cfg_obj_t *zoneconf = NULL;
+	const cfg_obj_t *zlist = NULL;
+	const cfg_listelt_t *elt = NULL;
+	dns_view_t *view = NULL;
+	ns_cfgctx_t *cfg = NULL;
+	dns_zone_t **zones = NULL;
+	unsigned int nzones = 0, nconfigured = 0, nadded = 0, i;
+	MDB_txn *txn = NULL;
+	MDB_dbi dbi;
+	bool locked = false;
+	char buf[128];
+
+	REQUIRE(text != NULL);
+
+	/* Skip the command name. */
+	if (next_token(lex, text) == NULL) {
+		return (ISC_R_UNEXPECTEDEND);
 	}
 
-	CHECK(newzone_parse(server, command, &view, &zoneconf, &zoneobj,
-			    &redirect, text));
+	filename = next_token(lex, text);
+	if (filename == NULL) {
+		return (ISC_R_UNEXPECTEDEND);
+	}
 
-	/* Are we accepting new zones in this view? */
-#ifdef HAVE_LMDB
-	if (view->new_zone_db == NULL)
-#else  /* ifdef HAVE_LMDB */
-	if (view->new_zone_file == NULL)
-#endif /* HAVE_LMDB */
+	cfg_parser_reset(named_g_addparser);
+	result = cfg_parse_file(named_g_addparser, filename,
+				&cfg_type_addzoneconf, &zoneconf);
+	if (result != ISC_R_SUCCESS) {
+		(void)putstr(text, "unable to parse '");
+		(void)putstr(text, filename);
+		(void)putstr(text, "': ");
+		(void)putstr(text, isc_result_totext(result));
+		goto cleanup;
+	}
+
+	result = cfg_map_get(zoneconf, "zone", &zlist);
+	if (result != ISC_R_SUCCESS || !cfg_obj_islist(zlist)) {
+		(void)putstr(text, "no zones found in '");
+		(void)putstr(text, filename);
+		(void)putstr(text, "'");
+		CHECK(ISC_R_NOTFOUND);
+	}
+
+	for (elt = cfg_list_first(zlist); elt != NULL; elt = cfg_list_next(elt))
 	{
+		CHECK(addzones_check(server, cfg_listelt_value(elt), &view,
+				     text));
+		nzones++;
+	}
+
+	/* Are we accepting new zones in this view? */
+	if (view->new_zone_db == NULL) {
 		(void)putstr(text, "Not allowing new zones in view '");
 		(void)putstr(text, view->name);
 		(void)putstr(text, "'");
-		result = ISC_R_NOPERM;
-		goto cleanup;
+		CHECK(ISC_R_NOPERM);
 	}
 
 	cfg = (ns_cfgctx_t *)view->new_zone_config;
 	if (cfg == NULL) {
-		result = ISC_R_FAILURE;
+		CHECK(ISC_R_FAILURE);
+	}
+
+	zones = isc_mem_get(server->mctx, nzones * sizeof(zones[0]));
+	memset(zones, 0, nzones * sizeof(zones[0]));
+
+	LOCK(&view->new_zone_lock);
+	locked = true;
+
+	/* Make sure we can open the NZD database */
+	result = nzd_writable(view);
+	if (result != ISC_R_SUCCESS) {
+		(void)putstr(text, "unable to open NZD database for '");
+		(void)putstr(text, view->new_zone_db);
+		(void)putstr(text, "'");
+		CHECK(ISC_R_FAILURE);
+	}
+
+	/*
+	 * Configure all the zones in one go; if any of them fails, none
+	 * of them is added.
+	 */
+	isc_task_beginexclusive(server->task);
+	dns_view_thaw(view);
+	for (elt = cfg_list_first(zlist); elt != NULL; elt = cfg_list_next(elt))
+	{
+		const cfg_obj_t *zoneobj = cfg_listelt_value(elt);
+		const char *zonename = NULL;
+		dns_fixedname_t fname;
+		dns_name_t *dnsname = dns_fixedname_initname(&fname);
+
+		zonename = cfg_obj_asstring(cfg_tuple_get(zoneobj, "name"));
+		result = configure_zone(cfg->config, zoneobj, cfg->vconfig,
+					view, &server->viewlist,
+					&server->kasplist, cfg->actx, true,
+					false, false);
+		if (result == ISC_R_SUCCESS) {
+			result = dns_name_fromstring(dnsname, zonename, 0,
+						     NULL);
+		}
+		if (result == ISC_R_SUCCESS) {
+			result = dns_zt_find(view->zonetable, dnsname, 0, NULL,
+					     &zones[nconfigured]);
+		}
+		if (result != ISC_R_SUCCESS) {
+			(void)putstr(text, "configure_zone failed for zone '");
+			(void)putstr(text, zonename);
+			(void)putstr(text, "': ");
+			(void)putstr(text, isc_result_totext(result));
+			break;
+		}
+		nconfigured++;
+	}
+	if (result != ISC_R_SUCCESS) {
+		for (i = 0; i < nconfigured; i++) {
+			dns_zt_unmount(view->zonetable, zones[i]);
+			dns_zone_detach(&zones[i]);
+		}
+	}
+	dns_view_freeze(view);
+	isc_task_endexclusive(server->task);
+
+	if (result != ISC_R_SUCCESS) {
 		goto cleanup;
 	}
 
-	zonename = cfg_obj_asstring(cfg_tuple_get(zoneobj, "name"));
-	isc_buffer_constinit(&buf, zonename, strlen(zonename));
-	isc_buffer_add(&buf, strlen(zonename));
+	/*
+	 * Load the zones from their master files; the ones that fail
+	 * to load are dropped from the batch.
+	 */
+	for (i = 0; i < nzones; i++) {
+		dns_db_t *dbp = NULL;
 
-	dnsname = dns_fixedname_initname(&fname);
-	CHECK(dns_name_fromtext(dnsname, &buf, dns_rootname, 0, NULL));
+		result = dns_zone_load(zones[i], true);
+		if (result == ISC_R_SUCCESS) {
+			dns_zone_setadded(zones[i], true);
+			nadded++;
+			continue;
+		}
 
-	if (redirect) {
-		if (!dns_name_equal(dnsname, dns_rootname)) {
-			(void)putstr(text, "redirect zones must be called "
-					   "\".\"");
-			CHECK(ISC_R_FAILURE);
+		dns_name_format(dns_zone_getorigin(zones[i]), buf, sizeof(buf));
+		(void)putstr(text, "zone '");
+		(void)putstr(text, buf);
+		(void)putstr(text, "': dns_zone_loadnew failed: ");
+		(void)putstr(text, isc_result_totext(result));
+		(void)putstr(text, "\n");
+
+		/* If the zone loaded partially, unload it */
+		if (dns_zone_getdb(zones[i], &dbp) == ISC_R_SUCCESS) {
+			dns_db_detach(&dbp);
+			dns_zone_unload(zones[i]);
 		}
+
+		/* Remove the zone from the zone table */
+		dns_zt_unmount(view->zonetable, zones[i]);
+		dns_zone_detach(&zones[i]);
 	}
 
-	if (addzone) {
-		CHECK(do_addzone(server, cfg, view, dnsname, zoneconf, zoneobj,
-				 redirect, text));
-	} else {
-		CHECK(do_modzone(server, cfg, view, dnsname, zonename, zoneobj,
-				 redirect, text));
+	/* Save the new zone configurations into the NZD, all at once */
+	CHECK(nzd_open(view, 0, &txn, &dbi));
+	for (elt = cfg_list_first(zlist), i = 0; elt != NULL;
+	     elt = cfg_list_next(elt), i++)
+	{
+		if (zones[i] != NULL) {
+			CHECK(nzd_put(txn, dbi, zones[i],
+				      cfg_listelt_value(elt)));
+		}
 	}
+	CHECK(nzd_close(&txn, true));
 
 	isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
 		      NAMED_LOGMODULE_SERVER, ISC_LOG_INFO,
-		      "%s zone %s in view %s via %s",
-		      addzone ? "added" : "updated", zonename, view->name,
-		      addzone ? NAMED_COMMAND_ADDZONE : NAMED_COMMAND_MODZONE);
+		      "added %u of %u zones in view %s via %s", nadded, nzones,
+		      view->name, NAMED_COMMAND_ADDZONES);
+
+	snprintf(buf, sizeof(buf), "%u of %u zones added", nadded, nzones);
+	(void)putstr(text, buf);
 
 	/* Changing a zone counts as reconfiguration */
 	CHECK(isc_time_now(&named_g_configtime));
 
 cleanup:
+	if (txn != NULL) {
+		(void)nzd_close(&txn, false);
+	}
+	if (locked) {
+		UNLOCK(&view->new_zone_lock);
+	}
+	if (zones != NULL) {
+		for (i = 0; i < nzones; i++) {
+			if (zones[i] != NULL) {
+				dns_zone_detach(&zones[i]);
+			}
+		}
+		isc_mem_put(server->mctx, zones, nzones * sizeof(zones[0]));
+	}
 	if (isc_buffer_usedlength(*text) > 0) {
 		(void)putnull(text);
 	}
@@ -14330,6 +16106,7 @@ cleanup:
 	}
 
 	return (result);
+#endif /* HAVE_LMDB */
 }
 
 static bool
@@ -15453,6 +17230,8 @@ named_server_zonestatus(named_server_t *server, isc_lex_t *lex,
 	char rbuf[ISC_FORMATHTTPTIMESTAMP_SIZE];
 	char kbuf[ISC_FORMATHTTPTIMESTAMP_SIZE];
 	char rtbuf[ISC_FORMATHTTPTIMESTAMP_SIZE];
+	char cbuf[64] = { 0 };
+	char membuf[128] = { 0 };
 	isc_time_t loadtime, expiretime, refreshtime;
 	isc_time_t refreshkeytime, resigntime;
 	dns_zonetype_t zonetype;
@@ -15513,6 +17292,31 @@ named_server_zonestatus(named_server_t *server, isc_lex_t *lex,
 	nodes = dns_db_nodecount(hasraw ? rawdb : db, dns_dbtree_main);
 	snprintf(nodebuf, sizeof(nodebuf), "%u", nodes);
 
+	/* Database memory, including the raw zone if inline signing */
+	{
+		dns_dbmemory_t memory, rawmemory = { 0 };
+		size_t journal, rawjournal = 0;
+
+		result = dns_zone_getmemory(zone, &memory, &journal);
+		if (result == ISC_R_SUCCESS && hasraw) {
+			result = dns_zone_getmemory(raw, &rawmemory,
+						    &rawjournal);
+		}
+		if (result == ISC_R_SUCCESS) {
+			snprintf(membuf, sizeof(membuf),
+				 "%zu (nodes %zu, rdata %zu, glue %zu, "
+				 "journal %zu)",
+				 memory.nodes + memory.rdata + memory.glue +
+					 journal + rawmemory.nodes +
+					 rawmemory.rdata + rawmemory.glue +
+					 rawjournal,
+				 memory.nodes + rawmemory.nodes,
+				 memory.rdata + rawmemory.rdata,
+				 memory.glue + rawmemory.glue,
+				 journal + rawjournal);
+		}
+	}
+
 	/* Security */
 	secure = dns_db_issecure(db);
 	allow = ((dns_zone_getkeyopts(zone) & DNS_ZONEKEY_ALLOW) != 0);
@@ -15550,6 +17354,19 @@ named_server_zonestatus(named_server_t *server, isc_lex_t *lex,
 		frozen = dynamic && !dns_zone_isdynamic(mayberaw, false);
 	}
 
+	/* Journal compaction in progress? */
+	if (zonetype == dns_zone_primary || zonetype == dns_zone_secondary) {
+		uint64_t copied, total;
+
+		if (dns_zone_getcompactprogress(mayberaw, &copied, &total) ==
+		    ISC_R_SUCCESS)
+		{
+			snprintf(cbuf, sizeof(cbuf),
+				 "%" PRIu64 " of %" PRIu64 " bytes copied",
+				 copied, total);
+		}
+	}
+
 	/* Next resign event */
 	if (secure &&
 	    (zonetype == dns_zone_primary ||
@@ -15615,6 +17432,11 @@ named_server_zonestatus(named_server_t *server, isc_lex_t *lex,
 	CHECK(putstr(text, "\nnodes: "));
 	CHECK(putstr(text, nodebuf));
 
+	if (membuf[0] != '\0') {
+		CHECK(putstr(text, "\nmemory: "));
+		CHECK(putstr(text, membuf));
+	}
+
 	if (!isc_time_isepoch(&loadtime)) {
 		CHECK(putstr(text, "\nlast loaded: "));
 		CHECK(putstr(text, lbuf));
@@ -15671,6 +17493,11 @@ named_server_zonestatus(named_server_t *server, isc_lex_t *lex,
 		CHECK(putstr(text, "\ndynamic: no"));
 	}
 
+	if (cbuf[0] != '\0') {
+		CHECK(putstr(text, "\njournal compaction: "));
+		CHECK(putstr(text, cbuf));
+	}
+
 	CHECK(putstr(text, "\nreconfigurable via modzone: "));
 	CHECK(putstr(text, dns_zone_getadded(zone) ? "yes" : "no"));
 
@@ -16043,6 +17870,51 @@ named_server_loadnta(named_server_t *server) {
 	return (ISC_R_SUCCESS);
 }
 
+isc_result_t
+named_server_saveadb(named_server_t *server) {
+	dns_view_t *view;
+
+	for (view = ISC_LIST_HEAD(server->viewlist); view != NULL;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		isc_result_t result = dns_view_saveadb(view);
+
+		if (result != ISC_R_SUCCESS) {
+			isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+				      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
+				      "error writing ADB file "
+				      "for view '%s': %s",
+				      view->name, isc_result_totext(result));
+		}
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+named_server_loadadb(named_server_t *server) {
+	dns_view_t *view;
+
+	for (view = ISC_LIST_HEAD(server->viewlist); view != NULL;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		isc_result_t result = dns_view_loadadb(view);
+
+		if ((result != ISC_R_SUCCESS) &&
+		    (result != ISC_R_FILENOTFOUND) &&
+		    (result != ISC_R_NOTFOUND))
+		{
+			isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+				      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
+				      "error loading ADB file "
+				      "for view '%s': %s",
+				      view->name, isc_result_totext(result));
+		}
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
 static isc_result_t
 mkey_refresh(dns_view_t *view, isc_buffer_t **text) {
 	isc_result_t result;
@@ -16789,3 +18661,161 @@ cleanup:
 
 	return (result);
 }
+
+/*
+ * Report at most this many lock initialization sites.
+ */
+#define LOCKPROFILE_MAX 50
+
+isc_result_t
+named_server_lockprofile(named_server_t *server, isc_lex_t *lex,
+			 isc_buffer_t **text) {
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_lockprof_t *sites = NULL;
+	size_t count = 0;
+	char *ptr = NULL;
+	char tbuf[PATH_MAX + 100];
+
+	REQUIRE(text != NULL);
+
+	/* Skip the command name. */
+	ptr = next_token(lex, text);
+	if (ptr == NULL) {
+		return (ISC_R_UNEXPECTEDEND);
+	}
+
+	if (!isc_lockprof_enabled()) {
+		CHECK(putstr(text, "lock profiling is not available; "
+				   "build with --enable-lock-profile"));
+		CHECK(ISC_R_NOTIMPLEMENTED);
+	}
+
+	ptr = next_token(lex, text);
+	if (ptr != NULL && strcasecmp(ptr, "reset") == 0) {
+		isc_lockprof_reset();
+		CHECK(putstr(text, "lock profile reset"));
+		goto cleanup;
+	} else if (ptr != NULL) {
+		CHECK(DNS_R_SYNTAX);
+	}
+
+	isc_lockprof_sites(server->mctx, &sites, &count);
+
+	CHECK(putstr(text, "    wait ms  max us   contended       locks "
+			   "type   site"));
+	for (size_t i = 0; i < count && i < LOCKPROFILE_MAX; i++) {
+		isc_lockprof_t *s = &sites[i];
+
+		if (s->contended == 0) {
+			break;
+		}
+		snprintf(tbuf, sizeof(tbuf),
+			 "\n%11.3f %7" PRIu64 " %11" PRIu64 " %11" PRIu64
+			 " %-6s %s:%u",
+			 (double)s->waited / 1000000, s->maxwait / 1000,
+			 s->contended, s->locks, s->type, s->file, s->line);
+		CHECK(putstr(text, tbuf));
+	}
+	snprintf(tbuf, sizeof(tbuf), "\n%zu lock initialization sites", count);
+	CHECK(putstr(text, tbuf));
+
+cleanup:
+	if (sites != NULL) {
+		isc_mem_put(server->mctx, sites, count * sizeof(sites[0]));
+	}
+	if (isc_buffer_usedlength(*text) > 0) {
+		(void)putnull(text);
+	}
+
+	return (result);
+}
+
+isc_result_t
+named_server_memprof(named_server_t *server, isc_lex_t *lex,
+		     isc_buffer_t **text) {
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_memprofstatus_t status;
+	FILE *fp = NULL;
+	char *ptr = NULL;
+	char tbuf[PATH_MAX + 100];
+
+	REQUIRE(text != NULL);
+
+	/* Skip the command name. */
+	ptr = next_token(lex, text);
+	if (ptr == NULL) {
+		return (ISC_R_UNEXPECTEDEND);
+	}
+
+	ptr = next_token(lex, text);
+	if (ptr == NULL || strcasecmp(ptr, "status") == 0) {
+		/* Just report the status */
+	} else if (strcasecmp(ptr, "on") == 0) {
+		size_t rate = 0;
+
+		ptr = next_token(lex, text);
+		if (ptr != NULL) {
+			char *end = NULL;
+			unsigned long val = strtoul(ptr, &end, 10);
+
+			if (*end != '\0' || val == 0) {
+				CHECK(DNS_R_SYNTAX);
+			}
+			rate = val;
+		}
+
+		result = isc_memprof_start(rate);
+		if (result == ISC_R_NOTIMPLEMENTED) {
+			CHECK(putstr(text, "heap profiling is not available; "
+					   "call stacks can't be collected "
+					   "on this system"));
+			CHECK(ISC_R_NOTIMPLEMENTED);
+		}
+		CHECK(result);
+	} else if (strcasecmp(ptr, "off") == 0) {
+		isc_memprof_stop();
+	} else if (strcasecmp(ptr, "reset") == 0) {
+		isc_memprof_reset();
+	} else if (strcasecmp(ptr, "dump") == 0) {
+		CHECKMF(isc_stdio_open(server->memproffile, "w", &fp),
+			"could not open heap profile file",
+			server->memproffile);
+		result = isc_memprof_dump(fp);
+		if (result == ISC_R_SUCCESS) {
+			result = isc_stdio_close(fp);
+		} else {
+			(void)isc_stdio_close(fp);
+		}
+		fp = NULL;
+		CHECKMF(result, "could not write heap profile file",
+			server->memproffile);
+
+		snprintf(tbuf, sizeof(tbuf), "heap profile written to %s\n",
+			 server->memproffile);
+		CHECK(putstr(text, tbuf));
+	} else {
+		CHECK(DNS_R_SYNTAX);
+	}
+
+	isc_memprof_status(&status);
+	if (status.rate > 0) {
+		snprintf(tbuf, sizeof(tbuf),
+			 "heap profiler is running, sampling every %zu bytes",
+			 status.rate);
+	} else {
+		snprintf(tbuf, sizeof(tbuf), "heap profiler is stopped");
+	}
+	CHECK(putstr(text, tbuf));
+	snprintf(tbuf, sizeof(tbuf),
+		 "\n%" PRIu64 " live samples (%" PRIu64 " bytes), %" PRIu64
+		 " allocations sampled",
+		 status.samples, status.bytes, status.allocations);
+	CHECK(putstr(text, tbuf));
+
+cleanup:
+	if (isc_buffer_usedlength(*text) > 0) {
+		(void)putnull(text);
+	}
+
+	return (result);
+}
@@ -0,0 +1,270 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <sys/resource.h>
+
+#include <isc/atomic.h>
+#include <isc/log.h>
+#include <isc/mem.h>
+#include <isc/string.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <named/globals.h>
+#include <named/log.h>
+#include <named/startup.h>
+
+#define MAXDEPTH 8
+#define US_PER_S 1000000 /*%< Microseconds per second. */
+
+/*
+ * The timeline is only changed by the server task, or by the last view
+ * to finish loading, one after the other; it is only read once 'done'
+ * is set.
+ */
+static struct {
+	named_startup_stats_t phases[named_startup_max];
+	named_startup_phase_t stack[MAXDEPTH];
+	unsigned int depth;
+	isc_time_t wall;
+	uint64_t cpu;
+	size_t memory;
+	named_startup_zone_t zones[2][NAMED_STARTUP_TOPZONES];
+	unsigned int nzones[2];
+	uint64_t total;
+	atomic_bool done;
+} timeline;
+
+static const char *phasenames[named_startup_max] = {
+	[named_startup_configure] = "configure",
+	[named_startup_parse] = "parse",
+	[named_startup_views] = "views",
+	[named_startup_zones] = "zones",
+	[named_startup_keys] = "keys",
+	[named_startup_interfaces] = "interfaces",
+	[named_startup_load] = "load",
+};
+
+static uint64_t
+cputime(void) {
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_SELF, &ru) != 0) {
+		return (0);
+	}
+
+	return ((uint64_t)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) *
+			US_PER_S +
+		ru.ru_utime.tv_usec + ru.ru_stime.tv_usec);
+}
+
+/*
+ * Charge what was taken since the last call to the phase in progress.
+ */
+static void
+charge(void) {
+	isc_time_t now;
+	uint64_t cpu;
+	size_t memory;
+
+	isc_time_now(&now);
+	cpu = cputime();
+	memory = isc_mem_totalinuse();
+
+	if (timeline.depth > 0) {
+		named_startup_stats_t *stats =
+			&timeline.phases[timeline.stack[timeline.depth - 1]];
+
+		stats->wall += isc_time_microdiff(&now, &timeline.wall);
+		stats->cpu += (cpu > timeline.cpu) ? cpu - timeline.cpu : 0;
+		stats->memory += (int64_t)memory - (int64_t)timeline.memory;
+	}
+
+	timeline.wall = now;
+	timeline.cpu = cpu;
+	timeline.memory = memory;
+}
+
+void
+named_startup_begin(named_startup_phase_t phase) {
+	REQUIRE(phase < named_startup_max);
+
+	if (atomic_load_acquire(&timeline.done)) {
+		return;
+	}
+
+	charge();
+	INSIST(timeline.depth < MAXDEPTH);
+	timeline.stack[timeline.depth++] = phase;
+}
+
+void
+named_startup_end(named_startup_phase_t phase) {
+	unsigned int depth;
+
+	REQUIRE(phase < named_startup_max);
+
+	if (atomic_load_acquire(&timeline.done)) {
+		return;
+	}
+
+	for (depth = timeline.depth; depth > 0; depth--) {
+		if (timeline.stack[depth - 1] == phase) {
+			break;
+		}
+	}
+	if (depth == 0) {
+		return;
+	}
+
+	charge();
+	timeline.depth = depth - 1;
+}
+
+static unsigned int
+zoneindex(named_startup_phase_t phase) {
+	REQUIRE(phase == named_startup_zones || phase == named_startup_load);
+
+	return (phase == named_startup_zones ? 0 : 1);
+}
+
+void
+named_startup_zone(named_startup_phase_t phase, const char *name,
+		   uint64_t usecs) {
+	named_startup_zone_t *zones = NULL;
+	unsigned int i, n;
+
+	REQUIRE(name != NULL);
+
+	if (atomic_load_acquire(&timeline.done)) {
+		return;
+	}
+
+	zones = timeline.zones[zoneindex(phase)];
+	n = timeline.nzones[zoneindex(phase)];
+
+	/*
+	 * Insert the zone in order, dropping the fastest one if the
+	 * list is full.
+	 */
+	for (i = n; i > 0 && zones[i - 1].usecs < usecs; i--) {
+		if (i < NAMED_STARTUP_TOPZONES) {
+			zones[i] = zones[i - 1];
+		}
+	}
+	if (i == NAMED_STARTUP_TOPZONES) {
+		return;
+	}
+
+	strlcpy(zones[i].name, name, sizeof(zones[i].name));
+	zones[i].usecs = usecs;
+	if (n < NAMED_STARTUP_TOPZONES) {
+		timeline.nzones[zoneindex(phase)]++;
+	}
+}
+
+void
+named_startup_done(void) {
+	isc_time_t now;
+
+	if (atomic_load_acquire(&timeline.done)) {
+		return;
+	}
+
+	charge();
+	timeline.depth = 0;
+
+	isc_time_now(&now);
+	timeline.total = isc_time_microdiff(&now, &named_g_boottime);
+
+	atomic_store_release(&timeline.done, true);
+
+	isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+		      NAMED_LOGMODULE_SERVER, ISC_LOG_INFO,
+		      "startup took %" PRIu64 ".%03" PRIu64 "s",
+		      timeline.total / US_PER_S,
+		      timeline.total % US_PER_S / 1000);
+
+	for (named_startup_phase_t phase = 0; phase < named_startup_max;
+	     phase++)
+	{
+		named_startup_stats_t *stats = &timeline.phases[phase];
+
+		isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+			      NAMED_LOGMODULE_SERVER, ISC_LOG_INFO,
+			      "startup phase %s: %" PRIu64 ".%03" PRIu64
+			      "s wall, %" PRIu64 ".%03" PRIu64
+			      "s cpu, %+" PRId64 " bytes",
+			      phasenames[phase], stats->wall / US_PER_S,
+			      stats->wall % US_PER_S / 1000,
+			      stats->cpu / US_PER_S,
+			      stats->cpu % US_PER_S / 1000, stats->memory);
+	}
+
+	for (unsigned int i = 0; i < 2; i++) {
+		for (unsigned int j = 0; j < timeline.nzones[i]; j++) {
+			named_startup_zone_t *zone = &timeline.zones[i][j];
+
+			isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+				      NAMED_LOGMODULE_SERVER, ISC_LOG_INFO,
+				      "startup: zone %s took %" PRIu64
+				      ".%03" PRIu64 "s to %s",
+				      zone->name, zone->usecs / US_PER_S,
+				      zone->usecs % US_PER_S / 1000,
+				      i == 0 ? "configure" : "load");
+		}
+	}
+}
+
+bool
+named_startup_isdone(void) {
+	return (atomic_load_acquire(&timeline.done));
+}
+
+uint64_t
+named_startup_gettotal(void) {
+	REQUIRE(named_startup_isdone());
+
+	return (timeline.total);
+}
+
+const char *
+named_startup_phasename(named_startup_phase_t phase) {
+	REQUIRE(phase < named_startup_max);
+
+	return (phasenames[phase]);
+}
+
+void
+named_startup_getstats(named_startup_phase_t phase,
+		       named_startup_stats_t *stats) {
+	REQUIRE(phase < named_startup_max);
+	REQUIRE(stats != NULL);
+	REQUIRE(named_startup_isdone());
+
+	*stats = timeline.phases[phase];
+}
+
+unsigned int
+named_startup_getzones(named_startup_phase_t phase,
+		       const named_startup_zone_t **zonesp) {
+	REQUIRE(zonesp != NULL);
+	REQUIRE(named_startup_isdone());
+
+	*zonesp = timeline.zones[zoneindex(phase)];
+	return (timeline.nzones[zoneindex(phase)]);
+}
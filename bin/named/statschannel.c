@@ -13,11 +13,17 @@
 
 /*! \file */
 
+#include <ctype.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <stdbool.h>
 
 #include <isc/buffer.h>
+#include <isc/heap.h>
+#include <isc/histo.h>
 #include <isc/httpd.h>
+#include <isc/lockprof.h>
+#include <isc/loop.h>
 #include <isc/mem.h>
 #include <isc/once.h>
 #include <isc/print.h>
@@ -33,14 +39,17 @@
 #include <dns/rdataclass.h>
 #include <dns/rdatatype.h>
 #include <dns/resolver.h>
+#include <dns/secalg.h>
 #include <dns/stats.h>
 #include <dns/view.h>
+#include <dns/zone.h>
 #include <dns/zt.h>
 
 #include <ns/stats.h>
 
 #include <named/log.h>
 #include <named/server.h>
+#include <named/startup.h>
 #include <named/statschannel.h>
 
 #if HAVE_JSON_C
@@ -56,13 +65,15 @@
 #include "xsl_p.h"
 
 #define STATS_XML_VERSION_MAJOR "3"
-#define STATS_XML_VERSION_MINOR "12"
+#define STATS_XML_VERSION_MINOR "13"
 #define STATS_XML_VERSION	STATS_XML_VERSION_MAJOR "." STATS_XML_VERSION_MINOR
 
 #define STATS_JSON_VERSION_MAJOR "1"
-#define STATS_JSON_VERSION_MINOR "6"
+#define STATS_JSON_VERSION_MINOR "7"
 #define STATS_JSON_VERSION	 STATS_JSON_VERSION_MAJOR "." STATS_JSON_VERSION_MINOR
 
+#define US_PER_S 1000000
+
 #define CHECK(m)                               \
 	do {                                   \
 		result = (m);                  \
@@ -352,6 +363,13 @@ init_desc(void) {
 	SET_NSSTATDESC(reclimitdropped,
 		       "queries dropped due to recursive client limit",
 		       "RecLimitDropped");
+	SET_NSSTATDESC(clients, "client objects allocated", "ClientPoolSize");
+	SET_NSSTATDESC(freeclients, "client objects pooled for reuse",
+		       "ClientPoolFree");
+	SET_NSSTATDESC(anscachehit, "answers sent from the answer cache",
+		       "AnsCacheHit");
+	SET_NSSTATDESC(anscachemiss, "answers not found in the answer cache",
+		       "AnsCacheMiss");
 
 	INSIST(i == ns_statscounter_max);
 
@@ -443,6 +461,29 @@ init_desc(void) {
 			"ServerQuota");
 	SET_RESSTATDESC(nextitem, "waited for next item", "NextItem");
 	SET_RESSTATDESC(priming, "priming queries", "Priming");
+	SET_RESSTATDESC(sigcachehit, "signature verifications cached",
+			"SigCacheHit");
+	SET_RESSTATDESC(sigcachemiss, "signature verifications not cached",
+			"SigCacheMiss");
+	SET_RESSTATDESC(sigcachesaved,
+			"verification time saved by signature cache (us)",
+			"SigCacheSavedUsec");
+	SET_RESSTATDESC(prefetchpopular, "popular names prefetched",
+			"PrefetchPopular");
+	SET_RESSTATDESC(hedgesent, "hedged queries sent", "HedgeSent");
+	SET_RESSTATDESC(hedgewon, "hedged queries answered first",
+			"HedgeWon");
+	SET_RESSTATDESC(tcpreuse, "TCP connections reused", "TCPReuse");
+	SET_RESSTATDESC(stalerefresh, "stale RRsets refreshed in background",
+			"StaleRefresh");
+	SET_RESSTATDESC(stalerefreshfail,
+			"background refreshes of stale RRsets failed",
+			"StaleRefreshFail");
+	SET_RESSTATDESC(forwarderquota, "spilled due to forwarder quota",
+			"ForwarderQuota");
+	SET_RESSTATDESC(qmincached,
+			"QNAME minimization steps answered from cache",
+			"QminCached");
 
 	INSIST(i == dns_resstatscounter_max);
 
@@ -624,6 +665,33 @@ init_desc(void) {
 	SET_SOCKSTATDESC(unixactive, "Unix domain sockets active",
 			 "UnixActive");
 	SET_SOCKSTATDESC(rawactive, "Raw sockets active", "RawActive");
+	SET_SOCKSTATDESC(udpsendbatch, "UDP send batches",
+			 "UDPSendBatch");
+	SET_SOCKSTATDESC(udpsendbatched, "UDP datagrams sent in batches",
+			 "UDPSendBatched");
+	SET_SOCKSTATDESC(udpsendgso, "UDP datagrams sent as GSO segments",
+			 "UDPSendGSO");
+	SET_SOCKSTATDESC(udpsendbatchmax, "UDP send batch highwater",
+			 "UDPSendBatchMax");
+	SET_SOCKSTATDESC(httpcachehit, "DoH GET responses from cache",
+			 "HTTPCacheHit");
+	SET_SOCKSTATDESC(httpcachemiss, "DoH GET response cache misses",
+			 "HTTPCacheMiss");
+	SET_SOCKSTATDESC(tlshandshake, "TLS handshakes completed",
+			 "TLSHandshake");
+	SET_SOCKSTATDESC(tlsresumed, "TLS sessions resumed", "TLSResumed");
+	SET_SOCKSTATDESC(httpstreamsmax,
+			 "HTTP/2 concurrent streams per connection highwater",
+			 "HTTPStreamsMax");
+	SET_SOCKSTATDESC(httpflowstall,
+			 "HTTP/2 response frames limited by flow control",
+			 "HTTPFlowStall");
+	SET_SOCKSTATDESC(tcpdnsbufbytes,
+			 "DNS over TCP receive buffer bytes in use",
+			 "TCPDNSBufBytes");
+	SET_SOCKSTATDESC(tlsdnsbufbytes,
+			 "DNS over TLS receive buffer bytes in use",
+			 "TLSDNSBufBytes");
 	INSIST(i == isc_sockstatscounter_max);
 
 	/* Initialize DNSSEC statistics */
@@ -678,6 +746,8 @@ init_desc(void) {
 	i = 0;
 	SET_DNSTAPSTATDESC(success, "dnstap messages written", "DNSTAPsuccess");
 	SET_DNSTAPSTATDESC(drop, "dnstap messages dropped", "DNSTAPdropped");
+	SET_DNSTAPSTATDESC(nobuffer, "dnstap messages dropped: no buffer space",
+			   "DNSTAPnobuffer");
 	INSIST(i == dns_dnstapcounter_max);
 
 #define SET_GLUECACHESTATDESC(counterid, desc, xmldesc)         \
@@ -1449,6 +1519,295 @@ cleanup:
 #endif /* ifdef HAVE_LIBXML2 */
 }
 
+typedef struct zmgrstat {
+	const char *name;
+	const char *desc;
+	uint64_t value;
+} zmgrstat_t;
+
+static void
+zmgrstat_dump(const zmgrstat_t *values, size_t count,
+	      stats_dumparg_t *dumparg) {
+	FILE *fp;
+#ifdef HAVE_LIBXML2
+	void *writer;
+	int xmlrc;
+#endif /* ifdef HAVE_LIBXML2 */
+#ifdef HAVE_JSON_C
+	json_object *counters, *obj;
+#endif /* ifdef HAVE_JSON_C */
+
+	for (size_t i = 0; i < count; i++) {
+		switch (dumparg->type) {
+		case isc_statsformat_file:
+			fp = dumparg->arg;
+			fprintf(fp, "%20" PRIu64 " %s\n", values[i].value,
+				values[i].desc);
+			break;
+		case isc_statsformat_xml:
+#ifdef HAVE_LIBXML2
+			writer = dumparg->arg;
+
+			TRY0(xmlTextWriterStartElement(writer,
+						       ISC_XMLCHAR "counter"));
+			TRY0(xmlTextWriterWriteAttribute(
+				writer, ISC_XMLCHAR "name",
+				ISC_XMLCHAR values[i].name));
+			TRY0(xmlTextWriterWriteFormatString(
+				writer, "%" PRIu64, values[i].value));
+			TRY0(xmlTextWriterEndElement(writer)); /* counter */
+#endif /* ifdef HAVE_LIBXML2 */
+			break;
+		case isc_statsformat_json:
+#ifdef HAVE_JSON_C
+			counters = (json_object *)dumparg->arg;
+			obj = json_object_new_int64(values[i].value);
+			if (obj == NULL) {
+				dumparg->result = ISC_R_NOMEMORY;
+				return;
+			}
+			json_object_object_add(counters, values[i].name, obj);
+#endif /* ifdef HAVE_JSON_C */
+			break;
+		}
+	}
+	return;
+#ifdef HAVE_LIBXML2
+cleanup:
+	isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+		      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
+		      "failed at zmgrstat_dump()");
+	dumparg->result = ISC_R_FAILURE;
+	return;
+#endif /* ifdef HAVE_LIBXML2 */
+}
+
+static void
+zoneloadstat_dump(dns_zonemgr_t *zmgr, stats_dumparg_t *dumparg) {
+	dns_zonemgr_loadstats_t stats;
+
+	dns_zonemgr_getloadstats(zmgr, &stats);
+
+	const zmgrstat_t values[] = {
+		{ "Active", "zone loads in progress", stats.active },
+		{ "Pending", "zone loads waiting", stats.pending },
+		{ "Completed", "zone loads completed", stats.completed },
+		{ "Bytes", "zone file bytes loaded", stats.bytes },
+		{ "BytesPerSecond", "zone file bytes loaded per second",
+		  stats.rate },
+	};
+
+	zmgrstat_dump(values, ARRAY_SIZE(values), dumparg);
+}
+
+static void
+zonedumpstat_dump(dns_zonemgr_t *zmgr, stats_dumparg_t *dumparg) {
+	dns_zonemgr_dumpstats_t stats;
+
+	dns_zonemgr_getdumpstats(zmgr, &stats);
+
+	const zmgrstat_t values[] = {
+		{ "Active", "zone dumps in progress", stats.active },
+		{ "Queued", "zone dumps waiting", stats.queued },
+		{ "Completed", "zone dumps completed", stats.completed },
+		{ "Coalesced", "zone dumps coalesced", stats.coalesced },
+		{ "Bytes", "zone file bytes written", stats.bytes },
+	};
+
+	zmgrstat_dump(values, ARRAY_SIZE(values), dumparg);
+}
+
+static void
+zonepeer_dump(const dns_zonemgr_peerstats_t *stats, void *arg) {
+	stats_dumparg_t *dumparg = arg;
+	char addrbuf[ISC_SOCKADDR_FORMATSIZE];
+	FILE *fp;
+#ifdef HAVE_LIBXML2
+	void *writer;
+	int xmlrc;
+#endif /* ifdef HAVE_LIBXML2 */
+#ifdef HAVE_JSON_C
+	json_object *peers, *peer, *obj;
+#endif /* ifdef HAVE_JSON_C */
+
+	if (dumparg->result != ISC_R_SUCCESS) {
+		return;
+	}
+
+	isc_sockaddr_format(&stats->addr, addrbuf, sizeof(addrbuf));
+
+	const struct {
+		const char *name;
+		const char *desc;
+		uint64_t value;
+	} values[] = {
+		{ "SOAQueued", "SOA queries queued", stats->queued },
+		{ "SOAQueries", "SOA queries sent", stats->soaqueries },
+		{ "Notifies", "notifies sent", stats->notifies },
+	};
+
+	switch (dumparg->type) {
+	case isc_statsformat_file:
+		fp = dumparg->arg;
+		fprintf(fp, "[%s]\n", addrbuf);
+		for (size_t i = 0; i < ARRAY_SIZE(values); i++) {
+			fprintf(fp, "%20" PRIu64 " %s\n", values[i].value,
+				values[i].desc);
+		}
+		break;
+	case isc_statsformat_xml:
+#ifdef HAVE_LIBXML2
+		writer = dumparg->arg;
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "peer"));
+		TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "address",
+						 ISC_XMLCHAR addrbuf));
+		for (size_t i = 0; i < ARRAY_SIZE(values); i++) {
+			TRY0(xmlTextWriterStartElement(writer,
+						       ISC_XMLCHAR "counter"));
+			TRY0(xmlTextWriterWriteAttribute(
+				writer, ISC_XMLCHAR "name",
+				ISC_XMLCHAR values[i].name));
+			TRY0(xmlTextWriterWriteFormatString(
+				writer, "%" PRIu64, values[i].value));
+			TRY0(xmlTextWriterEndElement(writer)); /* counter */
+		}
+		TRY0(xmlTextWriterEndElement(writer)); /* peer */
+#endif /* ifdef HAVE_LIBXML2 */
+		break;
+	case isc_statsformat_json:
+#ifdef HAVE_JSON_C
+		peers = (json_object *)dumparg->arg;
+		peer = json_object_new_object();
+		if (peer == NULL) {
+			dumparg->result = ISC_R_NOMEMORY;
+			return;
+		}
+		for (size_t i = 0; i < ARRAY_SIZE(values); i++) {
+			obj = json_object_new_int64(values[i].value);
+			if (obj == NULL) {
+				json_object_put(peer);
+				dumparg->result = ISC_R_NOMEMORY;
+				return;
+			}
+			json_object_object_add(peer, values[i].name, obj);
+		}
+		json_object_object_add(peers, addrbuf, peer);
+#endif /* ifdef HAVE_JSON_C */
+		break;
+	}
+	return;
+#ifdef HAVE_LIBXML2
+cleanup:
+	isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+		      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
+		      "failed at zonepeer_dump()");
+	dumparg->result = ISC_R_FAILURE;
+	return;
+#endif /* ifdef HAVE_LIBXML2 */
+}
+
+static void
+keypool_dump(const dns_keypool_stats_t *stats, void *arg) {
+	stats_dumparg_t *dumparg = arg;
+	char algbuf[DNS_SECALG_FORMATSIZE];
+	char namebuf[DNS_SECALG_FORMATSIZE + 16];
+	uint64_t rate = 0;
+	FILE *fp;
+#ifdef HAVE_LIBXML2
+	void *writer;
+	int xmlrc;
+#endif /* ifdef HAVE_LIBXML2 */
+#ifdef HAVE_JSON_C
+	json_object *pools, *pool, *obj;
+#endif /* ifdef HAVE_JSON_C */
+
+	if (dumparg->result != ISC_R_SUCCESS) {
+		return;
+	}
+
+	dns_secalg_format(stats->algorithm, algbuf, sizeof(algbuf));
+	snprintf(namebuf, sizeof(namebuf), "%s/%u", algbuf, stats->size);
+
+	/* Keys one work thread generates per minute. */
+	if (stats->usecs > 0) {
+		rate = stats->generated * 60 * US_PER_S / stats->usecs;
+	}
+
+	const struct {
+		const char *name;
+		const char *desc;
+		uint64_t value;
+	} values[] = {
+		{ "Depth", "keys kept", stats->depth },
+		{ "Available", "keys available", stats->available },
+		{ "Generated", "keys generated", stats->generated },
+		{ "Taken", "keys taken", stats->taken },
+		{ "Missed", "keys missed", stats->missed },
+		{ "GeneratedPerMinute", "keys generated per minute", rate },
+	};
+
+	switch (dumparg->type) {
+	case isc_statsformat_file:
+		fp = dumparg->arg;
+		fprintf(fp, "[%s]\n", namebuf);
+		for (size_t i = 0; i < ARRAY_SIZE(values); i++) {
+			fprintf(fp, "%20" PRIu64 " %s\n", values[i].value,
+				values[i].desc);
+		}
+		break;
+	case isc_statsformat_xml:
+#ifdef HAVE_LIBXML2
+		writer = dumparg->arg;
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "pool"));
+		TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "name",
+						 ISC_XMLCHAR namebuf));
+		for (size_t i = 0; i < ARRAY_SIZE(values); i++) {
+			TRY0(xmlTextWriterStartElement(writer,
+						       ISC_XMLCHAR "counter"));
+			TRY0(xmlTextWriterWriteAttribute(
+				writer, ISC_XMLCHAR "name",
+				ISC_XMLCHAR values[i].name));
+			TRY0(xmlTextWriterWriteFormatString(
+				writer, "%" PRIu64, values[i].value));
+			TRY0(xmlTextWriterEndElement(writer)); /* counter */
+		}
+		TRY0(xmlTextWriterEndElement(writer)); /* pool */
+#endif /* ifdef HAVE_LIBXML2 */
+		break;
+	case isc_statsformat_json:
+#ifdef HAVE_JSON_C
+		pools = (json_object *)dumparg->arg;
+		pool = json_object_new_object();
+		if (pool == NULL) {
+			dumparg->result = ISC_R_NOMEMORY;
+			return;
+		}
+		for (size_t i = 0; i < ARRAY_SIZE(values); i++) {
+			obj = json_object_new_int64(values[i].value);
+			if (obj == NULL) {
+				json_object_put(pool);
+				dumparg->result = ISC_R_NOMEMORY;
+				return;
+			}
+			json_object_object_add(pool, values[i].name, obj);
+		}
+		json_object_object_add(pools, namebuf, pool);
+#endif /* ifdef HAVE_JSON_C */
+		break;
+	}
+	return;
+#ifdef HAVE_LIBXML2
+cleanup:
+	isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+		      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
+		      "failed at keypool_dump()");
+	dumparg->result = ISC_R_FAILURE;
+	return;
+#endif /* ifdef HAVE_LIBXML2 */
+}
+
 static void
 rdtypestat_dump(dns_rdatastatstype_t type, uint64_t val, void *arg) {
 	char typebuf[64];
@@ -1763,6 +2122,70 @@ cleanup:
 	return;
 #endif /* ifdef HAVE_LIBXML2 */
 }
+
+/*
+ * Names of the query latency histograms, by transport and answer source.
+ */
+static const char *latency_transports[dns_latency_transport_max] = {
+	[dns_latency_udp] = "udp",
+	[dns_latency_tcp] = "tcp",
+	[dns_latency_tls] = "tls",
+	[dns_latency_https] = "https",
+};
+
+static const char *latency_sources[dns_latency_source_max] = {
+	[dns_latency_auth] = "auth",
+	[dns_latency_cache] = "cache",
+	[dns_latency_recursion] = "recursion",
+};
+
+/*
+ * Names of the per-server counters of the upstream servers, and of the
+ * buckets of their RTT histograms, which match the resolver's QryRTT*
+ * counters.  At most STATS_UPSTREAMS servers are rendered per view.
+ */
+#define STATS_UPSTREAMS 100
+
+static const char *upstream_counters[dns_adbserver_max] = {
+	[dns_adbserver_queries] = "Queries",
+	[dns_adbserver_responses] = "Responses",
+	[dns_adbserver_timeouts] = "Timeouts",
+	[dns_adbserver_ednsfallbacks] = "EDNSFallbacks",
+	[dns_adbserver_tcpretries] = "TCPRetries",
+};
+
+static const char *upstream_rtt[DNS_ADB_RTTBUCKETS] = {
+	"QryRTT" DNS_RESOLVER_QRYRTTCLASS0STR,
+	"QryRTT" DNS_RESOLVER_QRYRTTCLASS1STR,
+	"QryRTT" DNS_RESOLVER_QRYRTTCLASS2STR,
+	"QryRTT" DNS_RESOLVER_QRYRTTCLASS3STR,
+	"QryRTT" DNS_RESOLVER_QRYRTTCLASS4STR,
+	"QryRTT" DNS_RESOLVER_QRYRTTCLASS4STR "+",
+};
+
+/*
+ * The memory used by a zone, or by all the zones of a view.
+ */
+typedef struct {
+	dns_dbmemory_t db;
+	size_t journal;
+} zonememory_t;
+
+static isc_result_t
+zone_memsum(dns_zone_t *zone, void *arg) {
+	zonememory_t *total = arg;
+	dns_dbmemory_t memory;
+	size_t journal;
+
+	if (dns_zone_getmemory(zone, &memory, &journal) == ISC_R_SUCCESS) {
+		total->db.nodes += memory.nodes;
+		total->db.rdata += memory.rdata;
+		total->db.glue += memory.glue;
+		total->journal += journal;
+	}
+
+	return (ISC_R_SUCCESS);
+}
 #endif /* defined(EXTENDED_STATS) */
 
 #ifdef HAVE_LIBXML2
@@ -1776,8 +2199,38 @@ cleanup:
 #define STATS_XML_NET	  0x08
 #define STATS_XML_MEM	  0x10
 #define STATS_XML_TRAFFIC 0x20
+#define STATS_XML_LOCKS	  0x40
+#define STATS_XML_LOOPS	  0x80
 #define STATS_XML_ALL	  0xff
 
+static int
+memory_xmlrender(xmlTextWriterPtr writer, const zonememory_t *memory) {
+	int xmlrc;
+
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "memory"));
+
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "nodes"));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%zu", memory->db.nodes));
+	TRY0(xmlTextWriterEndElement(writer)); /* nodes */
+
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "rdata"));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%zu", memory->db.rdata));
+	TRY0(xmlTextWriterEndElement(writer)); /* rdata */
+
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "glue"));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%zu", memory->db.glue));
+	TRY0(xmlTextWriterEndElement(writer)); /* glue */
+
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "journal"));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%zu", memory->journal));
+	TRY0(xmlTextWriterEndElement(writer)); /* journal */
+
+	TRY0(xmlTextWriterEndElement(writer)); /* memory */
+
+cleanup:
+	return (xmlrc);
+}
+
 static isc_result_t
 zone_xmlrender(dns_zone_t *zone, void *arg) {
 	isc_result_t result;
@@ -1790,6 +2243,7 @@ zone_xmlrender(dns_zone_t *zone, void *arg) {
 	stats_dumparg_t dumparg;
 	const char *ztype;
 	isc_time_t timestamp;
+	zonememory_t memory = { 0 };
 
 	statlevel = dns_zone_getstatlevel(zone);
 	if (statlevel == dns_zonestat_none) {
@@ -1853,6 +2307,12 @@ zone_xmlrender(dns_zone_t *zone, void *arg) {
 		TRY0(xmlTextWriterEndElement(writer));
 	}
 
+	if (dns_zone_getmemory(zone, &memory.db, &memory.journal) ==
+	    ISC_R_SUCCESS)
+	{
+		TRY0(memory_xmlrender(writer, &memory));
+	}
+
 	if (statlevel == dns_zonestat_full) {
 		isc_stats_t *zonestats;
 		isc_stats_t *gluecachestats;
@@ -1959,71 +2419,496 @@ cleanup:
 	return (ISC_R_FAILURE);
 }
 
+/*
+ * Render the non-empty buckets of the query latency histograms of
+ * 'view', with their bounds in microseconds.
+ */
 static isc_result_t
-generatexml(named_server_t *server, uint32_t flags, int *buflen,
-	    xmlChar **buf) {
-	char boottime[sizeof "yyyy-mm-ddThh:mm:ss.sssZ"];
-	char configtime[sizeof "yyyy-mm-ddThh:mm:ss.sssZ"];
-	char nowstr[sizeof "yyyy-mm-ddThh:mm:ss.sssZ"];
-	isc_time_t now;
-	xmlTextWriterPtr writer = NULL;
-	xmlDocPtr doc = NULL;
+latency_xmlrender(dns_view_t *view, xmlTextWriterPtr writer) {
 	int xmlrc;
-	dns_view_t *view;
-	stats_dumparg_t dumparg;
-	dns_stats_t *cacherrstats;
-	uint64_t nsstat_values[ns_statscounter_max];
-	uint64_t resstat_values[dns_resstatscounter_max];
-	uint64_t adbstat_values[dns_adbstats_max];
-	uint64_t zonestat_values[dns_zonestatscounter_max];
-	uint64_t sockstat_values[isc_sockstatscounter_max];
-	uint64_t udpinsizestat_values[dns_sizecounter_in_max];
-	uint64_t udpoutsizestat_values[dns_sizecounter_out_max];
-	uint64_t tcpinsizestat_values[dns_sizecounter_in_max];
-	uint64_t tcpoutsizestat_values[dns_sizecounter_out_max];
-#ifdef HAVE_DNSTAP
-	uint64_t dnstapstat_values[dns_dnstapcounter_max];
-#endif /* ifdef HAVE_DNSTAP */
-	isc_result_t result;
 
-	isc_time_now(&now);
-	isc_time_formatISO8601ms(&named_g_boottime, boottime, sizeof boottime);
-	isc_time_formatISO8601ms(&named_g_configtime, configtime,
-				 sizeof configtime);
-	isc_time_formatISO8601ms(&now, nowstr, sizeof nowstr);
+	for (int t = 0; t < dns_latency_transport_max; t++) {
+		for (int s = 0; s < dns_latency_source_max; s++) {
+			isc_histo_t *hg = view->latencystats[t][s];
+			uint64_t min, max, count;
+			unsigned int key;
 
-	writer = xmlNewTextWriterDoc(&doc, 0);
-	if (writer == NULL) {
-		goto cleanup;
+			if (hg == NULL) {
+				continue;
+			}
+
+			TRY0(xmlTextWriterStartElement(writer,
+						       ISC_XMLCHAR "latency"));
+			TRY0(xmlTextWriterWriteAttribute(
+				writer, ISC_XMLCHAR "transport",
+				ISC_XMLCHAR latency_transports[t]));
+			TRY0(xmlTextWriterWriteAttribute(
+				writer, ISC_XMLCHAR "source",
+				ISC_XMLCHAR latency_sources[s]));
+			for (key = 0; isc_histo_get(hg, key, &min, &max,
+						    &count) == ISC_R_SUCCESS;
+			     isc_histo_next(hg, &key))
+			{
+				if (count == 0) {
+					continue;
+				}
+				TRY0(xmlTextWriterStartElement(
+					writer, ISC_XMLCHAR "bucket"));
+				TRY0(xmlTextWriterWriteFormatAttribute(
+					writer, ISC_XMLCHAR "min", "%" PRIu64,
+					min));
+				TRY0(xmlTextWriterWriteFormatAttribute(
+					writer, ISC_XMLCHAR "max", "%" PRIu64,
+					max));
+				TRY0(xmlTextWriterWriteFormatString(
+					writer, "%" PRIu64, count));
+				/* bucket */
+				TRY0(xmlTextWriterEndElement(writer));
+			}
+			TRY0(xmlTextWriterEndElement(writer)); /* latency */
+		}
 	}
-	TRY0(xmlTextWriterStartDocument(writer, NULL, "UTF-8", NULL));
-	TRY0(xmlTextWriterWritePI(writer, ISC_XMLCHAR "xml-stylesheet",
-				  ISC_XMLCHAR "type=\"text/xsl\" "
-					      "href=\"/bind9.xsl\""));
-	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "statistics"));
-	TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "version",
-					 ISC_XMLCHAR STATS_XML_VERSION));
 
-	/* Set common fields for statistics dump */
-	dumparg.type = isc_statsformat_xml;
-	dumparg.arg = writer;
+	return (ISC_R_SUCCESS);
 
-	/* Render server information */
-	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "server"));
-	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "boot-time"));
-	TRY0(xmlTextWriterWriteString(writer, ISC_XMLCHAR boottime));
-	TRY0(xmlTextWriterEndElement(writer)); /* boot-time */
-	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "config-time"));
-	TRY0(xmlTextWriterWriteString(writer, ISC_XMLCHAR configtime));
-	TRY0(xmlTextWriterEndElement(writer)); /* config-time */
-	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "current-time"));
-	TRY0(xmlTextWriterWriteString(writer, ISC_XMLCHAR nowstr));
-	TRY0(xmlTextWriterEndElement(writer)); /* current-time */
+cleanup:
+	return (ISC_R_FAILURE);
+}
+
+/*
+ * Render the counters of the upstream servers which have been sent the
+ * most queries, and the delegations with the most cumulative fetch time.
+ */
+static int
+upstreams_xmlrender(dns_view_t *view, xmlTextWriterPtr writer) {
+	dns_adbserverstats_t *servers = NULL;
+	dns_resslowzone_t *zones = NULL;
+	size_t nservers = 0, nzones = 0;
+	int xmlrc = 0;
+
+	if (view->adb != NULL) {
+		dns_adb_serverstats(view->adb, named_g_mctx, STATS_UPSTREAMS,
+				    &servers, &nservers);
+	}
+	if (view->resolver != NULL) {
+		dns_resolver_slowzones(view->resolver, named_g_mctx, &zones,
+				       &nzones);
+	}
+
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "upstreams"));
+	for (size_t i = 0; i < nservers; i++) {
+		dns_adbserverstats_t *server = &servers[i];
+		char addrbuf[ISC_SOCKADDR_FORMATSIZE];
+
+		isc_sockaddr_format(&server->sockaddr, addrbuf,
+				    sizeof(addrbuf));
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "server"));
+		TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "address",
+						 ISC_XMLCHAR addrbuf));
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "srtt"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%u",
+						    server->srtt));
+		TRY0(xmlTextWriterEndElement(writer)); /* srtt */
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "rttvar"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%u",
+						    server->rttvar));
+		TRY0(xmlTextWriterEndElement(writer)); /* rttvar */
+
+		TRY0(xmlTextWriterStartElement(writer,
+					       ISC_XMLCHAR "failrate"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%u",
+						    server->failrate));
+		TRY0(xmlTextWriterEndElement(writer)); /* failrate */
+
+		TRY0(xmlTextWriterStartElement(writer,
+					       ISC_XMLCHAR "inflight"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%u",
+						    server->inflight));
+		TRY0(xmlTextWriterEndElement(writer)); /* inflight */
+
+		for (size_t j = 0; j < dns_adbserver_max; j++) {
+			TRY0(xmlTextWriterStartElement(writer,
+						       ISC_XMLCHAR "counter"));
+			TRY0(xmlTextWriterWriteAttribute(
+				writer, ISC_XMLCHAR "name",
+				ISC_XMLCHAR upstream_counters[j]));
+			TRY0(xmlTextWriterWriteFormatString(
+				writer, "%" PRIu64, server->counters[j]));
+			TRY0(xmlTextWriterEndElement(writer)); /* counter */
+		}
+
+		for (size_t j = 0; j < DNS_ADB_RTTBUCKETS; j++) {
+			TRY0(xmlTextWriterStartElement(writer,
+						       ISC_XMLCHAR "counter"));
+			TRY0(xmlTextWriterWriteAttribute(
+				writer, ISC_XMLCHAR "name",
+				ISC_XMLCHAR upstream_rtt[j]));
+			TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+							    server->rtt[j]));
+			TRY0(xmlTextWriterEndElement(writer)); /* counter */
+		}
+
+		TRY0(xmlTextWriterEndElement(writer)); /* server */
+	}
+	TRY0(xmlTextWriterEndElement(writer)); /* upstreams */
+
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "slowzones"));
+	for (size_t i = 0; i < nzones; i++) {
+		dns_resslowzone_t *zone = &zones[i];
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "zone"));
+		TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "name",
+						 ISC_XMLCHAR zone->name));
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "fetches"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    zone->fetches));
+		TRY0(xmlTextWriterEndElement(writer)); /* fetches */
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "waited"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    zone->waited));
+		TRY0(xmlTextWriterEndElement(writer)); /* waited */
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "maxwait"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    zone->maxwait));
+		TRY0(xmlTextWriterEndElement(writer)); /* maxwait */
+
+		TRY0(xmlTextWriterEndElement(writer)); /* zone */
+	}
+	TRY0(xmlTextWriterEndElement(writer)); /* slowzones */
+
+cleanup:
+	if (servers != NULL) {
+		isc_mem_put(named_g_mctx, servers,
+			    nservers * sizeof(servers[0]));
+	}
+	if (zones != NULL) {
+		isc_mem_put(named_g_mctx, zones, nzones * sizeof(zones[0]));
+	}
+	return (xmlrc);
+}
+
+/*
+ * Render the lock contention profile; only the lock initialization
+ * sites that have been acquired are listed.
+ */
+static int
+lockprof_xmlrender(xmlTextWriterPtr writer) {
+	isc_lockprof_t *sites = NULL;
+	size_t count = 0;
+	int xmlrc = 0;
+
+	isc_lockprof_sites(named_g_mctx, &sites, &count);
+
+	for (size_t i = 0; i < count; i++) {
+		isc_lockprof_t *s = &sites[i];
+
+		if (s->locks == 0) {
+			continue;
+		}
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "lock"));
+		TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "type",
+						 ISC_XMLCHAR s->type));
+		TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "file",
+						 ISC_XMLCHAR s->file));
+		TRY0(xmlTextWriterWriteFormatAttribute(
+			writer, ISC_XMLCHAR "line", "%u", s->line));
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "locks"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    s->locks));
+		TRY0(xmlTextWriterEndElement(writer)); /* locks */
+
+		TRY0(xmlTextWriterStartElement(writer,
+					       ISC_XMLCHAR "contended"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    s->contended));
+		TRY0(xmlTextWriterEndElement(writer)); /* contended */
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "waited"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    s->waited));
+		TRY0(xmlTextWriterEndElement(writer)); /* waited */
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "maxwait"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    s->maxwait));
+		TRY0(xmlTextWriterEndElement(writer)); /* maxwait */
+
+		TRY0(xmlTextWriterEndElement(writer)); /* lock */
+	}
+
+cleanup:
+	if (sites != NULL) {
+		isc_mem_put(named_g_mctx, sites, count * sizeof(sites[0]));
+	}
+	return (xmlrc);
+}
+
+/*
+ * Render the health statistics of the event loops: the counters, the
+ * non-empty buckets of the iteration time histogram, and the callbacks
+ * which ran for a millisecond or more.
+ */
+static int
+loops_xmlrender(xmlTextWriterPtr writer) {
+	uint32_t nloops = isc_loopmgr_nloops(named_g_loopmgr);
+	isc_loopcallback_t callbacks[ISC_LOOP_CALLBACKS];
+	int xmlrc = 0;
+
+	for (uint32_t i = 0; i < nloops; i++) {
+		isc_loop_t *loop = isc_loop_get(named_g_loopmgr, i);
+		isc_histo_t *hg = isc_loop_gethistogram(loop);
+		isc_loopstats_t stats;
+		uint64_t min, max, count;
+		unsigned int key;
+		size_t ncallbacks;
+
+		isc_loop_getstats(loop, &stats);
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "loop"));
+		TRY0(xmlTextWriterWriteFormatAttribute(writer, ISC_XMLCHAR "id",
+						       "%" PRIu32, i));
+
+		TRY0(xmlTextWriterStartElement(writer,
+					       ISC_XMLCHAR "iterations"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    stats.iterations));
+		TRY0(xmlTextWriterEndElement(writer)); /* iterations */
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "jobs"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    stats.jobs));
+		TRY0(xmlTextWriterEndElement(writer)); /* jobs */
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "maxjobs"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    stats.maxjobs));
+		TRY0(xmlTextWriterEndElement(writer)); /* maxjobs */
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "maxtime"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    stats.maxtime));
+		TRY0(xmlTextWriterEndElement(writer)); /* maxtime */
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "stalls"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    stats.stalls));
+		TRY0(xmlTextWriterEndElement(writer)); /* stalls */
+
+		TRY0(xmlTextWriterStartElement(writer,
+					       ISC_XMLCHAR "histogram"));
+		for (key = 0; isc_histo_get(hg, key, &min, &max, &count) ==
+			      ISC_R_SUCCESS;
+		     isc_histo_next(hg, &key))
+		{
+			if (count == 0) {
+				continue;
+			}
+			TRY0(xmlTextWriterStartElement(writer,
+						       ISC_XMLCHAR "bucket"));
+			TRY0(xmlTextWriterWriteFormatAttribute(
+				writer, ISC_XMLCHAR "min", "%" PRIu64, min));
+			TRY0(xmlTextWriterWriteFormatAttribute(
+				writer, ISC_XMLCHAR "max", "%" PRIu64, max));
+			TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+							    count));
+			TRY0(xmlTextWriterEndElement(writer)); /* bucket */
+		}
+		TRY0(xmlTextWriterEndElement(writer)); /* histogram */
+
+		ncallbacks = isc_loop_getcallbacks(loop, callbacks,
+						   ARRAY_SIZE(callbacks));
+		TRY0(xmlTextWriterStartElement(writer,
+					       ISC_XMLCHAR "callbacks"));
+		for (size_t j = 0; j < ncallbacks; j++) {
+			isc_loopcallback_t *cb = &callbacks[j];
+
+			TRY0(xmlTextWriterStartElement(writer,
+						       ISC_XMLCHAR "callback"));
+			TRY0(xmlTextWriterWriteAttribute(
+				writer, ISC_XMLCHAR "name",
+				ISC_XMLCHAR cb->name));
+
+			TRY0(xmlTextWriterStartElement(writer,
+						       ISC_XMLCHAR "count"));
+			TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+							    cb->count));
+			TRY0(xmlTextWriterEndElement(writer)); /* count */
+
+			TRY0(xmlTextWriterStartElement(writer,
+						       ISC_XMLCHAR "time"));
+			TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+							    cb->time));
+			TRY0(xmlTextWriterEndElement(writer)); /* time */
+
+			TRY0(xmlTextWriterStartElement(writer,
+						       ISC_XMLCHAR "maxtime"));
+			TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+							    cb->maxtime));
+			TRY0(xmlTextWriterEndElement(writer)); /* maxtime */
+
+			TRY0(xmlTextWriterEndElement(writer)); /* callback */
+		}
+		TRY0(xmlTextWriterEndElement(writer)); /* callbacks */
+
+		TRY0(xmlTextWriterEndElement(writer)); /* loop */
+	}
+
+cleanup:
+	return (xmlrc);
+}
+
+/*
+ * Render the startup timeline; times are in microseconds, and memory is
+ * the change in bytes in use.
+ */
+static int
+startup_xmlrender(xmlTextWriterPtr writer) {
+	static const named_startup_phase_t zonephases[] = {
+		named_startup_zones, named_startup_load
+	};
+	int xmlrc = 0;
+
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "startup"));
+
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "total"));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+					    named_startup_gettotal()));
+	TRY0(xmlTextWriterEndElement(writer)); /* total */
+
+	for (named_startup_phase_t phase = 0; phase < named_startup_max;
+	     phase++)
+	{
+		named_startup_stats_t stats;
+
+		named_startup_getstats(phase, &stats);
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "phase"));
+		TRY0(xmlTextWriterWriteAttribute(
+			writer, ISC_XMLCHAR "name",
+			ISC_XMLCHAR named_startup_phasename(phase)));
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "wall"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    stats.wall));
+		TRY0(xmlTextWriterEndElement(writer)); /* wall */
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "cpu"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    stats.cpu));
+		TRY0(xmlTextWriterEndElement(writer)); /* cpu */
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "memory"));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRId64,
+						    stats.memory));
+		TRY0(xmlTextWriterEndElement(writer)); /* memory */
+
+		TRY0(xmlTextWriterEndElement(writer)); /* phase */
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(zonephases); i++) {
+		const named_startup_zone_t *zones = NULL;
+		unsigned int n = named_startup_getzones(zonephases[i], &zones);
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "zones"));
+		TRY0(xmlTextWriterWriteAttribute(
+			writer, ISC_XMLCHAR "phase",
+			ISC_XMLCHAR named_startup_phasename(zonephases[i])));
+		for (unsigned int j = 0; j < n; j++) {
+			TRY0(xmlTextWriterStartElement(writer,
+						       ISC_XMLCHAR "zone"));
+			TRY0(xmlTextWriterWriteAttribute(
+				writer, ISC_XMLCHAR "name",
+				ISC_XMLCHAR zones[j].name));
+			TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+							    zones[j].usecs));
+			TRY0(xmlTextWriterEndElement(writer)); /* zone */
+		}
+		TRY0(xmlTextWriterEndElement(writer)); /* zones */
+	}
+
+	TRY0(xmlTextWriterEndElement(writer)); /* startup */
+
+cleanup:
+	return (xmlrc);
+}
+
+static isc_result_t
+generatexml(named_server_t *server, uint32_t flags, int *buflen,
+	    xmlChar **buf) {
+	char boottime[sizeof "yyyy-mm-ddThh:mm:ss.sssZ"];
+	char configtime[sizeof "yyyy-mm-ddThh:mm:ss.sssZ"];
+	char nowstr[sizeof "yyyy-mm-ddThh:mm:ss.sssZ"];
+	isc_time_t now;
+	xmlTextWriterPtr writer = NULL;
+	xmlDocPtr doc = NULL;
+	int xmlrc;
+	dns_view_t *view;
+	stats_dumparg_t dumparg;
+	dns_stats_t *cacherrstats;
+	uint64_t nsstat_values[ns_statscounter_max];
+	uint64_t resstat_values[dns_resstatscounter_max];
+	uint64_t adbstat_values[dns_adbstats_max];
+	uint64_t zonestat_values[dns_zonestatscounter_max];
+	uint64_t sockstat_values[isc_sockstatscounter_max];
+	uint64_t udpinsizestat_values[dns_sizecounter_in_max];
+	uint64_t udpoutsizestat_values[dns_sizecounter_out_max];
+	uint64_t tcpinsizestat_values[dns_sizecounter_in_max];
+	uint64_t tcpoutsizestat_values[dns_sizecounter_out_max];
+#ifdef HAVE_DNSTAP
+	uint64_t dnstapstat_values[dns_dnstapcounter_max];
+#endif /* ifdef HAVE_DNSTAP */
+	isc_result_t result;
+
+	isc_time_now(&now);
+	isc_time_formatISO8601ms(&named_g_boottime, boottime, sizeof boottime);
+	isc_time_formatISO8601ms(&named_g_configtime, configtime,
+				 sizeof configtime);
+	isc_time_formatISO8601ms(&now, nowstr, sizeof nowstr);
+
+	writer = xmlNewTextWriterDoc(&doc, 0);
+	if (writer == NULL) {
+		goto cleanup;
+	}
+	TRY0(xmlTextWriterStartDocument(writer, NULL, "UTF-8", NULL));
+	TRY0(xmlTextWriterWritePI(writer, ISC_XMLCHAR "xml-stylesheet",
+				  ISC_XMLCHAR "type=\"text/xsl\" "
+					      "href=\"/bind9.xsl\""));
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "statistics"));
+	TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "version",
+					 ISC_XMLCHAR STATS_XML_VERSION));
+
+	/* Set common fields for statistics dump */
+	dumparg.type = isc_statsformat_xml;
+	dumparg.arg = writer;
+
+	/* Render server information */
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "server"));
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "boot-time"));
+	TRY0(xmlTextWriterWriteString(writer, ISC_XMLCHAR boottime));
+	TRY0(xmlTextWriterEndElement(writer)); /* boot-time */
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "config-time"));
+	TRY0(xmlTextWriterWriteString(writer, ISC_XMLCHAR configtime));
+	TRY0(xmlTextWriterEndElement(writer)); /* config-time */
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "current-time"));
+	TRY0(xmlTextWriterWriteString(writer, ISC_XMLCHAR nowstr));
+	TRY0(xmlTextWriterEndElement(writer)); /* current-time */
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "version"));
 	TRY0(xmlTextWriterWriteString(writer, ISC_XMLCHAR PACKAGE_VERSION));
 	TRY0(xmlTextWriterEndElement(writer)); /* version */
 
 	if ((flags & STATS_XML_SERVER) != 0) {
+		if (named_startup_isdone()) {
+			TRY0(startup_xmlrender(writer));
+		}
+
 		dumparg.result = ISC_R_SUCCESS;
 
 		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "counters"));
@@ -2080,6 +2965,54 @@ generatexml(named_server_t *server, uint32_t flags, int *buflen,
 
 		TRY0(xmlTextWriterEndElement(writer)); /* /zonestat */
 
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "counters"));
+		TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "type",
+						 ISC_XMLCHAR "zoneload"));
+
+		dumparg.result = ISC_R_SUCCESS;
+		zoneloadstat_dump(server->zonemgr, &dumparg);
+		CHECK(dumparg.result);
+
+		TRY0(xmlTextWriterEndElement(writer)); /* /zoneload */
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "counters"));
+		TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "type",
+						 ISC_XMLCHAR "zonedump"));
+
+		dumparg.result = ISC_R_SUCCESS;
+		zonedumpstat_dump(server->zonemgr, &dumparg);
+		CHECK(dumparg.result);
+
+		TRY0(xmlTextWriterEndElement(writer)); /* /zonedump */
+
+		TRY0(xmlTextWriterStartElement(writer,
+					       ISC_XMLCHAR "zonepeers"));
+		TRY0(xmlTextWriterWriteFormatAttribute(
+			writer, ISC_XMLCHAR "serial-query-rate", "%u",
+			dns_zonemgr_getserialqueryrate(server->zonemgr)));
+		TRY0(xmlTextWriterWriteFormatAttribute(
+			writer, ISC_XMLCHAR "notify-rate", "%u",
+			dns_zonemgr_getnotifyrate(server->zonemgr)));
+
+		dumparg.result = ISC_R_SUCCESS;
+		dns_zonemgr_dumppeers(server->zonemgr, zonepeer_dump,
+				      &dumparg);
+		CHECK(dumparg.result);
+
+		TRY0(xmlTextWriterEndElement(writer)); /* /zonepeers */
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "keypool"));
+		TRY0(xmlTextWriterWriteFormatAttribute(
+			writer, ISC_XMLCHAR "depth", "%u",
+			dns_zonemgr_getkeypooldepth(server->zonemgr)));
+
+		dumparg.result = ISC_R_SUCCESS;
+		dns_zonemgr_dumpkeypool(server->zonemgr, keypool_dump,
+					&dumparg);
+		CHECK(dumparg.result);
+
+		TRY0(xmlTextWriterEndElement(writer)); /* /keypool */
+
 		/*
 		 * Most of the common resolver statistics entries are 0, so
 		 * we don't use the verbose dump here.
@@ -2248,11 +3181,17 @@ generatexml(named_server_t *server, uint32_t flags, int *buflen,
 						 ISC_XMLCHAR view->name));
 
 		if ((flags & STATS_XML_ZONES) != 0) {
+			zonememory_t memory = { 0 };
+
 			TRY0(xmlTextWriterStartElement(writer,
 						       ISC_XMLCHAR "zones"));
 			CHECK(dns_zt_apply(view->zonetable, true, NULL,
 					   zone_xmlrender, writer));
 			TRY0(xmlTextWriterEndElement(writer)); /* /zones */
+
+			(void)dns_zt_apply(view->zonetable, false, NULL,
+					   zone_memsum, &memory);
+			TRY0(memory_xmlrender(writer, &memory));
 		}
 
 		if ((flags & STATS_XML_SERVER) == 0) {
@@ -2314,6 +3253,8 @@ generatexml(named_server_t *server, uint32_t flags, int *buflen,
 			adbstats_index, adbstat_values, ISC_STATSDUMP_VERBOSE));
 		TRY0(xmlTextWriterEndElement(writer)); /* </adbstats> */
 
+		TRY0(upstreams_xmlrender(view, writer));
+
 		/* <cachestats> */
 		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "counters"));
 		TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "type",
@@ -2321,6 +3262,8 @@ generatexml(named_server_t *server, uint32_t flags, int *buflen,
 		TRY0(dns_cache_renderxml(view->cache, writer));
 		TRY0(xmlTextWriterEndElement(writer)); /* </cachestats> */
 
+		CHECK(latency_xmlrender(view, writer));
+
 		TRY0(xmlTextWriterEndElement(writer)); /* view */
 
 		view = ISC_LIST_NEXT(view, link);
@@ -2339,6 +3282,18 @@ generatexml(named_server_t *server, uint32_t flags, int *buflen,
 		TRY0(xmlTextWriterEndElement(writer)); /* /memory */
 	}
 
+	if ((flags & STATS_XML_LOCKS) != 0 && isc_lockprof_enabled()) {
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "locks"));
+		TRY0(lockprof_xmlrender(writer));
+		TRY0(xmlTextWriterEndElement(writer)); /* /locks */
+	}
+
+	if ((flags & STATS_XML_LOOPS) != 0) {
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "loops"));
+		TRY0(loops_xmlrender(writer));
+		TRY0(xmlTextWriterEndElement(writer)); /* /loops */
+	}
+
 	TRY0(xmlTextWriterEndElement(writer)); /* /statistics */
 	TRY0(xmlTextWriterEndDocument(writer));
 
@@ -2493,6 +3448,28 @@ render_xml_traffic(const char *url, isc_httpdurl_t *urlinfo,
 			   freecb_args));
 }
 
+static isc_result_t
+render_xml_locks(const char *url, isc_httpdurl_t *urlinfo,
+		 const char *querystring, const char *headers, void *arg,
+		 unsigned int *retcode, const char **retmsg,
+		 const char **mimetype, isc_buffer_t *b,
+		 isc_httpdfree_t **freecb, void **freecb_args) {
+	return (render_xml(STATS_XML_LOCKS, url, urlinfo, querystring,
+			   headers, arg, retcode, retmsg, mimetype, b, freecb,
+			   freecb_args));
+}
+
+static isc_result_t
+render_xml_loops(const char *url, isc_httpdurl_t *urlinfo,
+		 const char *querystring, const char *headers, void *arg,
+		 unsigned int *retcode, const char **retmsg,
+		 const char **mimetype, isc_buffer_t *b,
+		 isc_httpdfree_t **freecb, void **freecb_args) {
+	return (render_xml(STATS_XML_LOOPS, url, urlinfo, querystring,
+			   headers, arg, retcode, retmsg, mimetype, b, freecb,
+			   freecb_args));
+}
+
 #endif /* HAVE_LIBXML2 */
 
 #ifdef HAVE_JSON_C
@@ -2506,6 +3483,8 @@ render_xml_traffic(const char *url, isc_httpdurl_t *urlinfo,
 #define STATS_JSON_NET	   0x08
 #define STATS_JSON_MEM	   0x10
 #define STATS_JSON_TRAFFIC 0x20
+#define STATS_JSON_LOCKS   0x40
+#define STATS_JSON_LOOPS   0x80
 #define STATS_JSON_ALL	   0xff
 
 #define CHECKMEM(m)                              \
@@ -2547,6 +3526,26 @@ addzone(char *name, char *classname, const char *ztype, uint32_t serial,
 	return (node);
 }
 
+static json_object *
+memory_jsonrender(const zonememory_t *memory) {
+	json_object *obj = json_object_new_object();
+
+	if (obj == NULL) {
+		return (NULL);
+	}
+
+	json_object_object_add(obj, "nodes",
+			       json_object_new_int64(memory->db.nodes));
+	json_object_object_add(obj, "rdata",
+			       json_object_new_int64(memory->db.rdata));
+	json_object_object_add(obj, "glue",
+			       json_object_new_int64(memory->db.glue));
+	json_object_object_add(obj, "journal",
+			       json_object_new_int64(memory->journal));
+
+	return (obj);
+}
+
 static isc_result_t
 zone_jsonrender(dns_zone_t *zone, void *arg) {
 	isc_result_t result = ISC_R_SUCCESS;
@@ -2560,6 +3559,7 @@ zone_jsonrender(dns_zone_t *zone, void *arg) {
 	json_object *zoneobj = NULL;
 	dns_zonestat_level_t statlevel;
 	isc_time_t timestamp;
+	zonememory_t memory = { 0 };
 
 	statlevel = dns_zone_getstatlevel(zone);
 	if (statlevel == dns_zonestat_none) {
@@ -2608,6 +3608,14 @@ zone_jsonrender(dns_zone_t *zone, void *arg) {
 				       json_object_new_string(buf));
 	}
 
+	if (dns_zone_getmemory(zone, &memory.db, &memory.journal) ==
+	    ISC_R_SUCCESS)
+	{
+		json_object *mem = memory_jsonrender(&memory);
+		CHECKMEM(mem);
+		json_object_object_add(zoneobj, "memory", mem);
+	}
+
 	if (statlevel == dns_zonestat_full) {
 		isc_stats_t *zonestats;
 		isc_stats_t *gluecachestats;
@@ -2752,43 +3760,471 @@ cleanup:
 	return (result);
 }
 
+/*
+ * Add the non-empty buckets of the query latency histograms of 'view' to
+ * 'v', as [min, max, count] arrays with the bounds in microseconds.
+ */
 static isc_result_t
-generatejson(named_server_t *server, size_t *msglen, const char **msg,
-	     json_object **rootp, uint32_t flags) {
-	dns_view_t *view;
+latency_jsonrender(dns_view_t *view, json_object *v) {
 	isc_result_t result = ISC_R_SUCCESS;
-	json_object *bindstats, *viewlist, *counters, *obj;
-	json_object *traffic = NULL;
-	json_object *udpreq4 = NULL, *udpresp4 = NULL;
-	json_object *tcpreq4 = NULL, *tcpresp4 = NULL;
-	json_object *udpreq6 = NULL, *udpresp6 = NULL;
-	json_object *tcpreq6 = NULL, *tcpresp6 = NULL;
-	uint64_t nsstat_values[ns_statscounter_max];
-	uint64_t resstat_values[dns_resstatscounter_max];
-	uint64_t adbstat_values[dns_adbstats_max];
-	uint64_t zonestat_values[dns_zonestatscounter_max];
-	uint64_t sockstat_values[isc_sockstatscounter_max];
-	uint64_t udpinsizestat_values[dns_sizecounter_in_max];
-	uint64_t udpoutsizestat_values[dns_sizecounter_out_max];
-	uint64_t tcpinsizestat_values[dns_sizecounter_in_max];
-	uint64_t tcpoutsizestat_values[dns_sizecounter_out_max];
-#ifdef HAVE_DNSTAP
-	uint64_t dnstapstat_values[dns_dnstapcounter_max];
-#endif /* ifdef HAVE_DNSTAP */
-	stats_dumparg_t dumparg;
-	char boottime[sizeof "yyyy-mm-ddThh:mm:ss.sssZ"];
-	char configtime[sizeof "yyyy-mm-ddThh:mm:ss.sssZ"];
-	char nowstr[sizeof "yyyy-mm-ddThh:mm:ss.sssZ"];
-	isc_time_t now;
+	json_object *latency = json_object_new_object();
 
-	REQUIRE(msglen != NULL);
-	REQUIRE(msg != NULL && *msg == NULL);
-	REQUIRE(rootp == NULL || *rootp == NULL);
+	CHECKMEM(latency);
+	json_object_object_add(v, "latency", latency);
 
-	bindstats = json_object_new_object();
-	if (bindstats == NULL) {
-		return (ISC_R_NOMEMORY);
-	}
+	for (int t = 0; t < dns_latency_transport_max; t++) {
+		json_object *transport = json_object_new_object();
+
+		CHECKMEM(transport);
+		json_object_object_add(latency, latency_transports[t],
+				       transport);
+
+		for (int s = 0; s < dns_latency_source_max; s++) {
+			isc_histo_t *hg = view->latencystats[t][s];
+			json_object *buckets = NULL;
+			uint64_t min, max, count;
+			unsigned int key;
+
+			if (hg == NULL) {
+				continue;
+			}
+
+			buckets = json_object_new_array();
+			CHECKMEM(buckets);
+			json_object_object_add(transport, latency_sources[s],
+					       buckets);
+
+			for (key = 0; isc_histo_get(hg, key, &min, &max,
+						    &count) == ISC_R_SUCCESS;
+			     isc_histo_next(hg, &key))
+			{
+				json_object *bucket = NULL;
+
+				if (count == 0) {
+					continue;
+				}
+
+				bucket = json_object_new_array();
+				CHECKMEM(bucket);
+				json_object_array_add(buckets, bucket);
+				json_object_array_add(
+					bucket, json_object_new_int64(min));
+				json_object_array_add(
+					bucket, json_object_new_int64(max));
+				json_object_array_add(
+					bucket, json_object_new_int64(count));
+			}
+		}
+	}
+
+cleanup:
+	return (result);
+}
+
+/*
+ * Render the counters of the upstream servers which have been sent the
+ * most queries, and the delegations with the most cumulative fetch time.
+ */
+static isc_result_t
+upstreams_jsonrender(dns_view_t *view, json_object *res) {
+	isc_result_t result = ISC_R_SUCCESS;
+	dns_adbserverstats_t *servers = NULL;
+	dns_resslowzone_t *zones = NULL;
+	size_t nservers = 0, nzones = 0;
+	json_object *upstreams = NULL, *slowzones = NULL;
+	json_object *entry = NULL, *obj = NULL;
+
+	if (view->adb != NULL) {
+		dns_adb_serverstats(view->adb, named_g_mctx, STATS_UPSTREAMS,
+				    &servers, &nservers);
+	}
+	if (view->resolver != NULL) {
+		dns_resolver_slowzones(view->resolver, named_g_mctx, &zones,
+				       &nzones);
+	}
+
+	upstreams = json_object_new_array();
+	CHECKMEM(upstreams);
+	json_object_object_add(res, "upstreams", upstreams);
+
+	for (size_t i = 0; i < nservers; i++) {
+		dns_adbserverstats_t *server = &servers[i];
+		char addrbuf[ISC_SOCKADDR_FORMATSIZE];
+
+		isc_sockaddr_format(&server->sockaddr, addrbuf,
+				    sizeof(addrbuf));
+
+		entry = json_object_new_object();
+		CHECKMEM(entry);
+
+		obj = json_object_new_string(addrbuf);
+		CHECKMEM(obj);
+		json_object_object_add(entry, "address", obj);
+
+		obj = json_object_new_int64(server->srtt);
+		CHECKMEM(obj);
+		json_object_object_add(entry, "srtt", obj);
+
+		obj = json_object_new_int64(server->rttvar);
+		CHECKMEM(obj);
+		json_object_object_add(entry, "rttvar", obj);
+
+		obj = json_object_new_int64(server->failrate);
+		CHECKMEM(obj);
+		json_object_object_add(entry, "failrate", obj);
+
+		obj = json_object_new_int64(server->inflight);
+		CHECKMEM(obj);
+		json_object_object_add(entry, "inflight", obj);
+
+		for (size_t j = 0; j < dns_adbserver_max; j++) {
+			obj = json_object_new_int64(server->counters[j]);
+			CHECKMEM(obj);
+			json_object_object_add(entry, upstream_counters[j],
+					       obj);
+		}
+
+		for (size_t j = 0; j < DNS_ADB_RTTBUCKETS; j++) {
+			obj = json_object_new_int64(server->rtt[j]);
+			CHECKMEM(obj);
+			json_object_object_add(entry, upstream_rtt[j], obj);
+		}
+
+		json_object_array_add(upstreams, entry);
+		entry = NULL;
+	}
+
+	slowzones = json_object_new_array();
+	CHECKMEM(slowzones);
+	json_object_object_add(res, "slowzones", slowzones);
+
+	for (size_t i = 0; i < nzones; i++) {
+		dns_resslowzone_t *zone = &zones[i];
+
+		entry = json_object_new_object();
+		CHECKMEM(entry);
+
+		obj = json_object_new_string(zone->name);
+		CHECKMEM(obj);
+		json_object_object_add(entry, "name", obj);
+
+		obj = json_object_new_int64(zone->fetches);
+		CHECKMEM(obj);
+		json_object_object_add(entry, "fetches", obj);
+
+		obj = json_object_new_int64(zone->waited);
+		CHECKMEM(obj);
+		json_object_object_add(entry, "waited", obj);
+
+		obj = json_object_new_int64(zone->maxwait);
+		CHECKMEM(obj);
+		json_object_object_add(entry, "maxwait", obj);
+
+		json_object_array_add(slowzones, entry);
+		entry = NULL;
+	}
+
+cleanup:
+	if (entry != NULL) {
+		json_object_put(entry);
+	}
+	if (servers != NULL) {
+		isc_mem_put(named_g_mctx, servers,
+			    nservers * sizeof(servers[0]));
+	}
+	if (zones != NULL) {
+		isc_mem_put(named_g_mctx, zones, nzones * sizeof(zones[0]));
+	}
+	return (result);
+}
+
+/*
+ * Render the lock contention profile; only the lock initialization
+ * sites that have been acquired are listed.
+ */
+static isc_result_t
+lockprof_jsonrender(json_object *array) {
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_lockprof_t *sites = NULL;
+	size_t count = 0;
+	json_object *lock = NULL, *obj = NULL;
+
+	isc_lockprof_sites(named_g_mctx, &sites, &count);
+
+	for (size_t i = 0; i < count; i++) {
+		isc_lockprof_t *s = &sites[i];
+
+		if (s->locks == 0) {
+			continue;
+		}
+
+		lock = json_object_new_object();
+		CHECKMEM(lock);
+
+		obj = json_object_new_string(s->type);
+		CHECKMEM(obj);
+		json_object_object_add(lock, "type", obj);
+
+		obj = json_object_new_string(s->file);
+		CHECKMEM(obj);
+		json_object_object_add(lock, "file", obj);
+
+		obj = json_object_new_int64(s->line);
+		CHECKMEM(obj);
+		json_object_object_add(lock, "line", obj);
+
+		obj = json_object_new_int64(s->locks);
+		CHECKMEM(obj);
+		json_object_object_add(lock, "locks", obj);
+
+		obj = json_object_new_int64(s->contended);
+		CHECKMEM(obj);
+		json_object_object_add(lock, "contended", obj);
+
+		obj = json_object_new_int64(s->waited);
+		CHECKMEM(obj);
+		json_object_object_add(lock, "waited", obj);
+
+		obj = json_object_new_int64(s->maxwait);
+		CHECKMEM(obj);
+		json_object_object_add(lock, "maxwait", obj);
+
+		json_object_array_add(array, lock);
+		lock = NULL;
+	}
+
+cleanup:
+	if (lock != NULL) {
+		json_object_put(lock);
+	}
+	if (sites != NULL) {
+		isc_mem_put(named_g_mctx, sites, count * sizeof(sites[0]));
+	}
+	return (result);
+}
+
+/*
+ * Add the health statistics of the event loops to 'array'; the histogram
+ * buckets are [min, max, count] arrays, like the latency histograms.
+ */
+static isc_result_t
+loops_jsonrender(json_object *array) {
+	isc_result_t result = ISC_R_SUCCESS;
+	uint32_t nloops = isc_loopmgr_nloops(named_g_loopmgr);
+	isc_loopcallback_t callbacks[ISC_LOOP_CALLBACKS];
+	json_object *jloop = NULL, *obj = NULL;
+
+	for (uint32_t i = 0; i < nloops; i++) {
+		isc_loop_t *loop = isc_loop_get(named_g_loopmgr, i);
+		isc_histo_t *hg = isc_loop_gethistogram(loop);
+		json_object *buckets = NULL, *jcallbacks = NULL;
+		isc_loopstats_t stats;
+		uint64_t min, max, count;
+		unsigned int key;
+		size_t ncallbacks;
+
+		isc_loop_getstats(loop, &stats);
+
+		jloop = json_object_new_object();
+		CHECKMEM(jloop);
+
+		obj = json_object_new_int64(i);
+		CHECKMEM(obj);
+		json_object_object_add(jloop, "id", obj);
+
+		obj = json_object_new_int64(stats.iterations);
+		CHECKMEM(obj);
+		json_object_object_add(jloop, "iterations", obj);
+
+		obj = json_object_new_int64(stats.jobs);
+		CHECKMEM(obj);
+		json_object_object_add(jloop, "jobs", obj);
+
+		obj = json_object_new_int64(stats.maxjobs);
+		CHECKMEM(obj);
+		json_object_object_add(jloop, "maxjobs", obj);
+
+		obj = json_object_new_int64(stats.maxtime);
+		CHECKMEM(obj);
+		json_object_object_add(jloop, "maxtime", obj);
+
+		obj = json_object_new_int64(stats.stalls);
+		CHECKMEM(obj);
+		json_object_object_add(jloop, "stalls", obj);
+
+		buckets = json_object_new_array();
+		CHECKMEM(buckets);
+		json_object_object_add(jloop, "histogram", buckets);
+
+		for (key = 0; isc_histo_get(hg, key, &min, &max, &count) ==
+			      ISC_R_SUCCESS;
+		     isc_histo_next(hg, &key))
+		{
+			json_object *bucket = NULL;
+
+			if (count == 0) {
+				continue;
+			}
+
+			bucket = json_object_new_array();
+			CHECKMEM(bucket);
+			json_object_array_add(buckets, bucket);
+			json_object_array_add(bucket,
+					      json_object_new_int64(min));
+			json_object_array_add(bucket,
+					      json_object_new_int64(max));
+			json_object_array_add(bucket,
+					      json_object_new_int64(count));
+		}
+
+		jcallbacks = json_object_new_object();
+		CHECKMEM(jcallbacks);
+		json_object_object_add(jloop, "callbacks", jcallbacks);
+
+		ncallbacks = isc_loop_getcallbacks(loop, callbacks,
+						   ARRAY_SIZE(callbacks));
+		for (size_t j = 0; j < ncallbacks; j++) {
+			isc_loopcallback_t *cb = &callbacks[j];
+			json_object *jcb = json_object_new_object();
+
+			CHECKMEM(jcb);
+			json_object_object_add(jcallbacks, cb->name, jcb);
+
+			obj = json_object_new_int64(cb->count);
+			CHECKMEM(obj);
+			json_object_object_add(jcb, "count", obj);
+
+			obj = json_object_new_int64(cb->time);
+			CHECKMEM(obj);
+			json_object_object_add(jcb, "time", obj);
+
+			obj = json_object_new_int64(cb->maxtime);
+			CHECKMEM(obj);
+			json_object_object_add(jcb, "maxtime", obj);
+		}
+
+		json_object_array_add(array, jloop);
+		jloop = NULL;
+	}
+
+cleanup:
+	if (jloop != NULL) {
+		json_object_put(jloop);
+	}
+	return (result);
+}
+
+/*
+ * Add the startup timeline to 'startup'; see startup_xmlrender().
+ */
+static isc_result_t
+startup_jsonrender(json_object *startup) {
+	static const named_startup_phase_t zonephases[] = {
+		named_startup_zones, named_startup_load
+	};
+	isc_result_t result = ISC_R_SUCCESS;
+	json_object *phases = NULL, *obj = NULL;
+
+	obj = json_object_new_int64(named_startup_gettotal());
+	CHECKMEM(obj);
+	json_object_object_add(startup, "total", obj);
+
+	phases = json_object_new_object();
+	CHECKMEM(phases);
+	json_object_object_add(startup, "phases", phases);
+
+	for (named_startup_phase_t phase = 0; phase < named_startup_max;
+	     phase++)
+	{
+		named_startup_stats_t stats;
+		json_object *jphase = json_object_new_object();
+
+		CHECKMEM(jphase);
+		json_object_object_add(phases, named_startup_phasename(phase),
+				       jphase);
+
+		named_startup_getstats(phase, &stats);
+
+		obj = json_object_new_int64(stats.wall);
+		CHECKMEM(obj);
+		json_object_object_add(jphase, "wall", obj);
+
+		obj = json_object_new_int64(stats.cpu);
+		CHECKMEM(obj);
+		json_object_object_add(jphase, "cpu", obj);
+
+		obj = json_object_new_int64(stats.memory);
+		CHECKMEM(obj);
+		json_object_object_add(jphase, "memory", obj);
+
+		if (phase != zonephases[0] && phase != zonephases[1]) {
+			continue;
+		}
+
+		const named_startup_zone_t *zones = NULL;
+		unsigned int n = named_startup_getzones(phase, &zones);
+		json_object *jzones = json_object_new_array();
+
+		CHECKMEM(jzones);
+		json_object_object_add(jphase, "slowest", jzones);
+
+		for (unsigned int j = 0; j < n; j++) {
+			json_object *jzone = json_object_new_object();
+
+			CHECKMEM(jzone);
+			json_object_array_add(jzones, jzone);
+
+			obj = json_object_new_string(zones[j].name);
+			CHECKMEM(obj);
+			json_object_object_add(jzone, "name", obj);
+
+			obj = json_object_new_int64(zones[j].usecs);
+			CHECKMEM(obj);
+			json_object_object_add(jzone, "time", obj);
+		}
+	}
+
+cleanup:
+	return (result);
+}
+
+static isc_result_t
+generatejson(named_server_t *server, size_t *msglen, const char **msg,
+	     json_object **rootp, uint32_t flags) {
+	dns_view_t *view;
+	isc_result_t result = ISC_R_SUCCESS;
+	json_object *bindstats, *viewlist, *counters, *obj;
+	json_object *traffic = NULL;
+	json_object *udpreq4 = NULL, *udpresp4 = NULL;
+	json_object *tcpreq4 = NULL, *tcpresp4 = NULL;
+	json_object *udpreq6 = NULL, *udpresp6 = NULL;
+	json_object *tcpreq6 = NULL, *tcpresp6 = NULL;
+	uint64_t nsstat_values[ns_statscounter_max];
+	uint64_t resstat_values[dns_resstatscounter_max];
+	uint64_t adbstat_values[dns_adbstats_max];
+	uint64_t zonestat_values[dns_zonestatscounter_max];
+	uint64_t sockstat_values[isc_sockstatscounter_max];
+	uint64_t udpinsizestat_values[dns_sizecounter_in_max];
+	uint64_t udpoutsizestat_values[dns_sizecounter_out_max];
+	uint64_t tcpinsizestat_values[dns_sizecounter_in_max];
+	uint64_t tcpoutsizestat_values[dns_sizecounter_out_max];
+#ifdef HAVE_DNSTAP
+	uint64_t dnstapstat_values[dns_dnstapcounter_max];
+#endif /* ifdef HAVE_DNSTAP */
+	stats_dumparg_t dumparg;
+	char boottime[sizeof "yyyy-mm-ddThh:mm:ss.sssZ"];
+	char configtime[sizeof "yyyy-mm-ddThh:mm:ss.sssZ"];
+	char nowstr[sizeof "yyyy-mm-ddThh:mm:ss.sssZ"];
+	isc_time_t now;
+
+	REQUIRE(msglen != NULL);
+	REQUIRE(msg != NULL && *msg == NULL);
+	REQUIRE(rootp == NULL || *rootp == NULL);
+
+	bindstats = json_object_new_object();
+	if (bindstats == NULL) {
+		return (ISC_R_NOMEMORY);
+	}
 
 	/*
 	 * These statistics are included no matter which URL we use.
@@ -2819,6 +4255,14 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 	json_object_object_add(bindstats, "version", obj);
 
 	if ((flags & STATS_JSON_SERVER) != 0) {
+		if (named_startup_isdone()) {
+			json_object *startup = json_object_new_object();
+
+			CHECKMEM(startup);
+			json_object_object_add(bindstats, "startup", startup);
+			CHECK(startup_jsonrender(startup));
+		}
+
 		/* OPCODE counters */
 		counters = json_object_new_object();
 
@@ -2920,6 +4364,87 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 			json_object_put(counters);
 		}
 
+		/* zone load counters */
+		counters = json_object_new_object();
+
+		dumparg.result = ISC_R_SUCCESS;
+		dumparg.arg = counters;
+
+		zoneloadstat_dump(server->zonemgr, &dumparg);
+		if (dumparg.result != ISC_R_SUCCESS) {
+			json_object_put(counters);
+			goto cleanup;
+		}
+
+		json_object_object_add(bindstats, "zoneloads", counters);
+
+		/* zone dump counters */
+		counters = json_object_new_object();
+
+		dumparg.result = ISC_R_SUCCESS;
+		dumparg.arg = counters;
+
+		zonedumpstat_dump(server->zonemgr, &dumparg);
+		if (dumparg.result != ISC_R_SUCCESS) {
+			json_object_put(counters);
+			goto cleanup;
+		}
+
+		json_object_object_add(bindstats, "zonedumps", counters);
+
+		/* zone manager peers */
+		counters = json_object_new_object();
+		CHECKMEM(counters);
+		json_object_object_add(bindstats, "zonepeers", counters);
+
+		obj = json_object_new_int64(
+			dns_zonemgr_getserialqueryrate(server->zonemgr));
+		CHECKMEM(obj);
+		json_object_object_add(counters, "serial-query-rate", obj);
+
+		obj = json_object_new_int64(
+			dns_zonemgr_getnotifyrate(server->zonemgr));
+		CHECKMEM(obj);
+		json_object_object_add(counters, "notify-rate", obj);
+
+		obj = json_object_new_object();
+		CHECKMEM(obj);
+		json_object_object_add(counters, "peers", obj);
+
+		dumparg.result = ISC_R_SUCCESS;
+		dumparg.arg = obj;
+
+		dns_zonemgr_dumppeers(server->zonemgr, zonepeer_dump,
+				      &dumparg);
+		if (dumparg.result != ISC_R_SUCCESS) {
+			result = dumparg.result;
+			goto cleanup;
+		}
+
+		/* DNSSEC key pool */
+		counters = json_object_new_object();
+		CHECKMEM(counters);
+		json_object_object_add(bindstats, "keypool", counters);
+
+		obj = json_object_new_int64(
+			dns_zonemgr_getkeypooldepth(server->zonemgr));
+		CHECKMEM(obj);
+		json_object_object_add(counters, "depth", obj);
+
+		obj = json_object_new_object();
+		CHECKMEM(obj);
+		json_object_object_add(counters, "pools", obj);
+
+		dumparg.result = ISC_R_SUCCESS;
+		dumparg.arg = obj;
+
+		dns_zonemgr_dumpkeypool(server->zonemgr, keypool_dump,
+					&dumparg);
+		if (dumparg.result != ISC_R_SUCCESS) {
+			result = dumparg.result;
+			goto cleanup;
+		}
+
 		/* resolver stat counters */
 		counters = json_object_new_object();
 
@@ -2987,8 +4512,17 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 			CHECKMEM(za);
 
 			if ((flags & STATS_JSON_ZONES) != 0) {
+				zonememory_t memory = { 0 };
+				json_object *mem = NULL;
+
 				CHECK(dns_zt_apply(view->zonetable, true, NULL,
 						   zone_jsonrender, za));
+
+				(void)dns_zt_apply(view->zonetable, false,
+						   NULL, zone_memsum, &memory);
+				mem = memory_jsonrender(&memory);
+				CHECKMEM(mem);
+				json_object_object_add(v, "memory", mem);
 			}
 
 			if (json_object_array_length(za) != 0) {
@@ -3105,6 +4639,16 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 					json_object_object_add(res, "adb",
 							       counters);
 				}
+
+				result = upstreams_jsonrender(view, res);
+				if (result != ISC_R_SUCCESS) {
+					goto cleanup;
+				}
+
+				result = latency_jsonrender(view, v);
+				if (result != ISC_R_SUCCESS) {
+					goto cleanup;
+				}
 			}
 
 			view = ISC_LIST_NEXT(view, link);
@@ -3161,6 +4705,32 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 		json_object_object_add(bindstats, "memory", memory);
 	}
 
+	if ((flags & STATS_JSON_LOCKS) != 0 && isc_lockprof_enabled()) {
+		json_object *locks = json_object_new_array();
+		CHECKMEM(locks);
+
+		result = lockprof_jsonrender(locks);
+		if (result != ISC_R_SUCCESS) {
+			json_object_put(locks);
+			goto cleanup;
+		}
+
+		json_object_object_add(bindstats, "locks", locks);
+	}
+
+	if ((flags & STATS_JSON_LOOPS) != 0) {
+		json_object *loops = json_object_new_array();
+		CHECKMEM(loops);
+
+		result = loops_jsonrender(loops);
+		if (result != ISC_R_SUCCESS) {
+			json_object_put(loops);
+			goto cleanup;
+		}
+
+		json_object_object_add(bindstats, "loops", loops);
+	}
+
 	if ((flags & STATS_JSON_TRAFFIC) != 0) {
 		traffic = json_object_new_object();
 		CHECKMEM(traffic);
@@ -3439,11 +5009,650 @@ render_json_traffic(const char *url, isc_httpdurl_t *urlinfo,
 			    freecb_args));
 }
 
-#endif /* HAVE_JSON_C */
+static isc_result_t
+render_json_locks(const char *url, isc_httpdurl_t *urlinfo,
+		  const char *querystring, const char *headers, void *arg,
+		  unsigned int *retcode, const char **retmsg,
+		  const char **mimetype, isc_buffer_t *b,
+		  isc_httpdfree_t **freecb, void **freecb_args) {
+	return (render_json(STATS_JSON_LOCKS, url, urlinfo, querystring,
+			    headers, arg, retcode, retmsg, mimetype, b, freecb,
+			    freecb_args));
+}
 
 static isc_result_t
-render_xsl(const char *url, isc_httpdurl_t *urlinfo, const char *querystring,
-	   const char *headers, void *args, unsigned int *retcode,
+render_json_loops(const char *url, isc_httpdurl_t *urlinfo,
+		  const char *querystring, const char *headers, void *arg,
+		  unsigned int *retcode, const char **retmsg,
+		  const char **mimetype, isc_buffer_t *b,
+		  isc_httpdfree_t **freecb, void **freecb_args) {
+	return (render_json(STATS_JSON_LOOPS, url, urlinfo, querystring,
+			    headers, arg, retcode, retmsg, mimetype, b, freecb,
+			    freecb_args));
+}
+
+#endif /* HAVE_JSON_C */
+
+#if defined(EXTENDED_STATS)
+/*
+ * OpenMetrics text exposition.  The samples are printed straight from
+ * the counters into the response buffer, without building a document
+ * tree first, so that a scrape costs little more than its output.
+ *
+ * Per-zone metrics dominate the output on servers with many zones, so
+ * they can be limited with the "zones" query parameter: "zones=none"
+ * leaves them out, "zones=topN" only includes the N zones that received
+ * the most requests, and "zones=all" (the default) includes every zone.
+ */
+#define METRICS_ZONES_ALL  UINT_MAX
+#define METRICS_ZONES_NONE 0
+#define METRICS_ZONES_MAX  (1024 * 1024)
+
+typedef struct metrics_zone {
+	dns_zone_t *zone;
+	uint64_t requests;
+	unsigned int index;
+} metrics_zone_t;
+
+typedef struct metrics {
+	named_server_t *server;
+	isc_buffer_t *b;
+	unsigned int maxzones;
+	isc_heap_t *topzones;
+	metrics_zone_t *zones;
+	unsigned int nzones;
+	const char *family;	/* metric family of the dumped counters */
+	const char *label;	/* name of the label set by the dumpers */
+	const char **desc;	/* counter names for isc_stats_dump() */
+	char context[1024 * 2]; /* labels common to the dumped counters */
+	isc_result_t result;
+} metrics_t;
+
+/*
+ * Copy 'value' to 'buf' as an OpenMetrics label value, escaping
+ * backslashes, double quotes and line feeds.
+ */
+static const char *
+metrics_escape(const char *value, char *buf, size_t size) {
+	size_t i = 0;
+
+	INSIST(size > 0);
+
+	for (const char *p = value; *p != '\0' && i + 2 < size; p++) {
+		switch (*p) {
+		case '\\':
+		case '"':
+			buf[i++] = '\\';
+			buf[i++] = *p;
+			break;
+		case '\n':
+			buf[i++] = '\\';
+			buf[i++] = 'n';
+			break;
+		default:
+			buf[i++] = *p;
+			break;
+		}
+	}
+	buf[i] = '\0';
+
+	return (buf);
+}
+
+static void
+metrics_family(metrics_t *m, const char *family, const char *type,
+	       const char *help) {
+	if (m->result != ISC_R_SUCCESS) {
+		return;
+	}
+	m->result = isc_buffer_printf(m->b,
+				      "# TYPE bind_%s %s\n"
+				      "# HELP bind_%s %s\n",
+				      family, type, family, help);
+}
+
+/*
+ * Print a sample of the current metric family, with the context labels
+ * and, if 'value' is not NULL, the label named m->label set to 'value'.
+ */
+static void
+metrics_sample(metrics_t *m, const char *suffix, const char *value,
+	       uint64_t val) {
+	char buf[1024 * 2];
+	const char *sep = (m->context[0] != '\0') ? "," : "";
+
+	if (m->result != ISC_R_SUCCESS) {
+		return;
+	}
+
+	if (value != NULL) {
+		m->result = isc_buffer_printf(
+			m->b, "bind_%s%s{%s%s%s=\"%s\"} %" PRIu64 "\n",
+			m->family, suffix, m->context, sep, m->label,
+			metrics_escape(value, buf, sizeof(buf)), val);
+	} else if (m->context[0] != '\0') {
+		m->result = isc_buffer_printf(m->b,
+					      "bind_%s%s{%s} %" PRIu64 "\n",
+					      m->family, suffix, m->context,
+					      val);
+	} else {
+		m->result = isc_buffer_printf(m->b, "bind_%s%s %" PRIu64 "\n",
+					      m->family, suffix, val);
+	}
+}
+
+static void
+metrics_counter_dump(isc_statscounter_t counter, uint64_t val, void *arg) {
+	metrics_t *m = arg;
+
+	metrics_sample(m, "_total", m->desc[counter], val);
+}
+
+static void
+metrics_rdtype_dump(dns_rdatastatstype_t type, uint64_t val, void *arg) {
+	metrics_t *m = arg;
+	char typebuf[64];
+	const char *typestr = "Others";
+
+	if ((DNS_RDATASTATSTYPE_ATTR(type) &
+	     DNS_RDATASTATSTYPE_ATTR_OTHERTYPE) == 0)
+	{
+		dns_rdatatype_format(DNS_RDATASTATSTYPE_BASE(type), typebuf,
+				     sizeof(typebuf));
+		typestr = typebuf;
+	}
+
+	metrics_sample(m, "_total", typestr, val);
+}
+
+static void
+metrics_opcode_dump(dns_opcode_t code, uint64_t val, void *arg) {
+	metrics_t *m = arg;
+	isc_buffer_t b;
+	char codebuf[64];
+
+	isc_buffer_init(&b, codebuf, sizeof(codebuf) - 1);
+	dns_opcode_totext(code, &b);
+	codebuf[isc_buffer_usedlength(&b)] = '\0';
+
+	metrics_sample(m, "_total", codebuf, val);
+}
+
+static void
+metrics_rcode_dump(dns_rcode_t code, uint64_t val, void *arg) {
+	metrics_t *m = arg;
+	isc_buffer_t b;
+	char codebuf[64];
+
+	isc_buffer_init(&b, codebuf, sizeof(codebuf) - 1);
+	dns_rcode_totext(code, &b);
+	codebuf[isc_buffer_usedlength(&b)] = '\0';
+
+	metrics_sample(m, "_total", codebuf, val);
+}
+
+static void
+metrics_setcontext(metrics_t *m, const char *view, dns_zone_t *zone) {
+	char vbuf[512], zbuf[1024], namebuf[DNS_NAME_FORMATSIZE];
+
+	if (zone != NULL) {
+		dns_zone_nameonly(zone, namebuf, sizeof(namebuf));
+		snprintf(m->context, sizeof(m->context),
+			 "view=\"%s\",zone=\"%s\"",
+			 metrics_escape(view, vbuf, sizeof(vbuf)),
+			 metrics_escape(namebuf, zbuf, sizeof(zbuf)));
+	} else if (view != NULL) {
+		snprintf(m->context, sizeof(m->context), "view=\"%s\"",
+			 metrics_escape(view, vbuf, sizeof(vbuf)));
+	} else {
+		m->context[0] = '\0';
+	}
+}
+
+static void
+metrics_counters(metrics_t *m, isc_stats_t *stats, const char *label,
+		 const char **desc) {
+	m->label = label;
+	m->desc = desc;
+	isc_stats_dump(stats, metrics_counter_dump, m, 0);
+}
+
+static void
+metrics_server(metrics_t *m) {
+	named_server_t *server = m->server;
+
+	metrics_setcontext(m, NULL, NULL);
+
+	m->family = "opcode";
+	m->label = "opcode";
+	metrics_family(m, m->family, "counter", "Requests received by opcode");
+	dns_opcodestats_dump(server->sctx->opcodestats, metrics_opcode_dump,
+			     m, 0);
+
+	m->family = "rcode";
+	m->label = "rcode";
+	metrics_family(m, m->family, "counter", "Responses sent by rcode");
+	dns_rcodestats_dump(server->sctx->rcodestats, metrics_rcode_dump, m,
+			    0);
+
+	m->family = "qtype";
+	m->label = "type";
+	metrics_family(m, m->family, "counter", "Queries received by type");
+	dns_rdatatypestats_dump(server->sctx->rcvquerystats,
+				metrics_rdtype_dump, m, 0);
+
+	m->family = "nsstat";
+	metrics_family(m, m->family, "counter", "Name server statistics");
+	metrics_counters(m, ns_stats_get(server->sctx->nsstats), "name",
+			 nsstats_xmldesc);
+
+	m->family = "zonestat";
+	metrics_family(m, m->family, "counter", "Zone maintenance statistics");
+	metrics_counters(m, server->zonestats, "name", zonestats_xmldesc);
+
+	m->family = "sockstat";
+	metrics_family(m, m->family, "counter", "Socket I/O statistics");
+	metrics_counters(m, server->sockstats, "name", sockstats_xmldesc);
+}
+
+static void
+metrics_views(metrics_t *m) {
+	dns_view_t *view = NULL;
+
+	m->family = "resqtype";
+	m->label = "type";
+	metrics_family(m, m->family, "counter", "Queries sent by type");
+	for (view = ISC_LIST_HEAD(m->server->viewlist); view != NULL;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		dns_stats_t *dstats = NULL;
+
+		dns_resolver_getquerystats(view->resolver, &dstats);
+		if (dstats != NULL) {
+			metrics_setcontext(m, view->name, NULL);
+			dns_rdatatypestats_dump(dstats, metrics_rdtype_dump, m,
+						0);
+			dns_stats_detach(&dstats);
+		}
+	}
+
+	m->family = "resstat";
+	metrics_family(m, m->family, "counter", "Resolver statistics");
+	for (view = ISC_LIST_HEAD(m->server->viewlist); view != NULL;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		isc_stats_t *istats = NULL;
+
+		dns_resolver_getstats(view->resolver, &istats);
+		if (istats != NULL) {
+			metrics_setcontext(m, view->name, NULL);
+			metrics_counters(m, istats, "name", resstats_xmldesc);
+			isc_stats_detach(&istats);
+		}
+	}
+
+	/*
+	 * The latency histograms count microseconds; the bucket bounds
+	 * are printed in seconds.
+	 */
+	m->family = "query_latency_seconds";
+	m->label = "le";
+	metrics_family(m, m->family, "histogram",
+		       "Time from receiving a query to sending the response");
+	for (view = ISC_LIST_HEAD(m->server->viewlist); view != NULL;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		for (int t = 0; t < dns_latency_transport_max; t++) {
+			for (int s = 0; s < dns_latency_source_max; s++) {
+				isc_histo_t *hg = view->latencystats[t][s];
+				uint64_t min, max, count, total = 0;
+				unsigned int key;
+				char vbuf[512], le[64];
+
+				if (hg == NULL) {
+					continue;
+				}
+
+				snprintf(m->context, sizeof(m->context),
+					 "view=\"%s\",transport=\"%s\","
+					 "source=\"%s\"",
+					 metrics_escape(view->name, vbuf,
+							sizeof(vbuf)),
+					 latency_transports[t],
+					 latency_sources[s]);
+
+				for (key = 0;
+				     isc_histo_get(hg, key, &min, &max,
+						   &count) == ISC_R_SUCCESS;
+				     isc_histo_next(hg, &key))
+				{
+					total += count;
+					if (count == 0 || max == UINT64_MAX) {
+						continue;
+					}
+					max++;
+					snprintf(le, sizeof(le),
+						 "%" PRIu64 ".%06" PRIu64,
+						 max / US_PER_S,
+						 max % US_PER_S);
+					metrics_sample(m, "_bucket", le,
+						       total);
+				}
+				metrics_sample(m, "_bucket", "+Inf", total);
+				metrics_sample(m, "_count", NULL, total);
+			}
+		}
+	}
+}
+
+static bool
+metrics_zone_higher(void *v1, void *v2) {
+	metrics_zone_t *z1 = v1, *z2 = v2;
+
+	/* The zone with the fewest requests is at the top of the heap. */
+	return (z1->requests < z2->requests);
+}
+
+static void
+metrics_zone_index(void *what, unsigned int index) {
+	metrics_zone_t *z = what;
+
+	z->index = index;
+}
+
+static uint64_t
+metrics_zone_requests(dns_zone_t *zone) {
+	isc_stats_t *zonestats = dns_zone_getrequeststats(zone);
+
+	if (zonestats == NULL) {
+		return (0);
+	}
+	return (isc_stats_get_counter(zonestats, ns_statscounter_requestv4) +
+		isc_stats_get_counter(zonestats, ns_statscounter_requestv6));
+}
+
+/*
+ * Keep the m->maxzones zones with the most requests in a heap ordered
+ * by the number of requests, evicting the zone with the fewest requests
+ * when a busier zone is found.
+ */
+static isc_result_t
+metrics_zone_select(dns_zone_t *zone, void *arg) {
+	metrics_t *m = arg;
+	metrics_zone_t *z = NULL;
+	uint64_t requests;
+
+	if (dns_zone_getstatlevel(zone) == dns_zonestat_none) {
+		return (ISC_R_SUCCESS);
+	}
+
+	requests = metrics_zone_requests(zone);
+	if (m->nzones < m->maxzones) {
+		z = &m->zones[m->nzones++];
+		z->requests = requests;
+		dns_zone_attach(zone, &z->zone);
+		isc_heap_insert(m->topzones, z);
+		return (ISC_R_SUCCESS);
+	}
+
+	z = isc_heap_element(m->topzones, 1);
+	if (requests > z->requests) {
+		dns_zone_detach(&z->zone);
+		dns_zone_attach(zone, &z->zone);
+		z->requests = requests;
+		isc_heap_decreased(m->topzones, 1);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+typedef void(metrics_zonefn_t)(metrics_t *, dns_zone_t *);
+
+static void
+metrics_zone_serial(metrics_t *m, dns_zone_t *zone) {
+	uint32_t serial;
+
+	if (dns_zone_getserial(zone, &serial) == ISC_R_SUCCESS) {
+		metrics_sample(m, "", NULL, serial);
+	}
+}
+
+static void
+metrics_zone_nsstat(metrics_t *m, dns_zone_t *zone) {
+	isc_stats_t *zonestats = dns_zone_getrequeststats(zone);
+
+	if (zonestats != NULL &&
+	    dns_zone_getstatlevel(zone) == dns_zonestat_full)
+	{
+		metrics_counters(m, zonestats, "name", nsstats_xmldesc);
+	}
+}
+
+static void
+metrics_zone_qtype(metrics_t *m, dns_zone_t *zone) {
+	dns_stats_t *rcvquerystats = dns_zone_getrcvquerystats(zone);
+
+	if (rcvquerystats != NULL &&
+	    dns_zone_getstatlevel(zone) == dns_zonestat_full)
+	{
+		m->label = "type";
+		dns_rdatatypestats_dump(rcvquerystats, metrics_rdtype_dump, m,
+					0);
+	}
+}
+
+typedef struct metrics_zonearg {
+	metrics_t *m;
+	metrics_zonefn_t *fn;
+} metrics_zonearg_t;
+
+static isc_result_t
+metrics_zone_apply(dns_zone_t *zone, void *arg) {
+	metrics_zonearg_t *za = arg;
+	dns_view_t *view = dns_zone_getview(zone);
+
+	if (dns_zone_getstatlevel(zone) == dns_zonestat_none) {
+		return (ISC_R_SUCCESS);
+	}
+
+	metrics_setcontext(za->m, view != NULL ? view->name : "", zone);
+	za->fn(za->m, zone);
+
+	return (za->m->result);
+}
+
+static void
+metrics_zone_foreach(void *elt, void *arg) {
+	metrics_zone_t *z = elt;
+
+	(void)metrics_zone_apply(z->zone, arg);
+}
+
+/*
+ * Call 'fn' for each of the zones to render, so that all the samples
+ * of a metric family are printed together as OpenMetrics requires.
+ */
+static void
+metrics_zones_apply(metrics_t *m, metrics_zonefn_t *fn) {
+	metrics_zonearg_t za = { .m = m, .fn = fn };
+
+	if (m->topzones != NULL) {
+		isc_heap_foreach(m->topzones, metrics_zone_foreach, &za);
+		return;
+	}
+
+	for (dns_view_t *view = ISC_LIST_HEAD(m->server->viewlist);
+	     view != NULL && m->result == ISC_R_SUCCESS;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		(void)dns_zt_apply(view->zonetable, true, NULL,
+				   metrics_zone_apply, &za);
+	}
+}
+
+static void
+metrics_zones(metrics_t *m) {
+	isc_mem_t *mctx = m->server->mctx;
+
+	if (m->maxzones == METRICS_ZONES_NONE) {
+		return;
+	}
+
+	if (m->maxzones != METRICS_ZONES_ALL) {
+		m->zones = isc_mem_get(mctx,
+				       m->maxzones * sizeof(m->zones[0]));
+		isc_heap_create(mctx, metrics_zone_higher, metrics_zone_index,
+				m->maxzones, &m->topzones);
+		for (dns_view_t *view = ISC_LIST_HEAD(m->server->viewlist);
+		     view != NULL; view = ISC_LIST_NEXT(view, link))
+		{
+			(void)dns_zt_apply(view->zonetable, false, NULL,
+					   metrics_zone_select, m);
+		}
+	}
+
+	m->family = "zone_serial";
+	metrics_family(m, m->family, "gauge", "Zone serial number");
+	metrics_zones_apply(m, metrics_zone_serial);
+
+	m->family = "zone_nsstat";
+	metrics_family(m, m->family, "counter",
+		       "Name server statistics per zone");
+	metrics_zones_apply(m, metrics_zone_nsstat);
+
+	m->family = "zone_qtype";
+	metrics_family(m, m->family, "counter",
+		       "Queries received per zone by type");
+	metrics_zones_apply(m, metrics_zone_qtype);
+
+	if (m->topzones != NULL) {
+		for (unsigned int i = 0; i < m->nzones; i++) {
+			dns_zone_detach(&m->zones[i].zone);
+		}
+		isc_heap_destroy(&m->topzones);
+		isc_mem_put(mctx, m->zones,
+			    m->maxzones * sizeof(m->zones[0]));
+	}
+}
+
+/*
+ * Parse the "zones" parameter from 'querystring'.
+ */
+static isc_result_t
+metrics_parsequery(const char *querystring, unsigned int *maxzonesp) {
+	const char *p = querystring;
+
+	*maxzonesp = METRICS_ZONES_ALL;
+
+	while (p != NULL && *p != '\0') {
+		size_t len = strcspn(p, "&");
+
+		if (len > 6 && strncmp(p, "zones=", 6) == 0) {
+			const char *v = p + 6;
+			size_t vlen = len - 6;
+			char *end = NULL;
+			unsigned long n;
+
+			if (vlen == 3 && strncmp(v, "all", 3) == 0) {
+				*maxzonesp = METRICS_ZONES_ALL;
+			} else if (vlen == 4 && strncmp(v, "none", 4) == 0) {
+				*maxzonesp = METRICS_ZONES_NONE;
+			} else if (vlen > 3 && strncmp(v, "top", 3) == 0 &&
+				   isdigit((unsigned char)v[3]))
+			{
+				n = strtoul(v + 3, &end, 10);
+				if (end != v + vlen || n == 0 ||
+				    n > METRICS_ZONES_MAX)
+				{
+					return (ISC_R_BADNUMBER);
+				}
+				*maxzonesp = (unsigned int)n;
+			} else {
+				return (DNS_R_SYNTAX);
+			}
+		}
+
+		p += len;
+		if (*p == '&') {
+			p++;
+		}
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+metrics_free(isc_buffer_t *b, void *arg) {
+	isc_buffer_t *dynbuf = arg;
+
+	UNUSED(b);
+
+	isc_buffer_free(&dynbuf);
+}
+
+static isc_result_t
+render_metrics(const char *url, isc_httpdurl_t *urlinfo,
+	       const char *querystring, const char *headers, void *arg,
+	       unsigned int *retcode, const char **retmsg,
+	       const char **mimetype, isc_buffer_t *b,
+	       isc_httpdfree_t **freecb, void **freecb_args) {
+	named_server_t *server = arg;
+	metrics_t m = { .server = server, .result = ISC_R_SUCCESS };
+	isc_result_t result;
+
+	UNUSED(url);
+	UNUSED(urlinfo);
+	UNUSED(headers);
+
+	result = metrics_parsequery(querystring, &m.maxzones);
+	if (result != ISC_R_SUCCESS) {
+		static char msg[] = "Bad query parameters.\r\n";
+
+		*retcode = 400;
+		*retmsg = "Bad Request";
+		*mimetype = "text/plain";
+		isc_buffer_reinit(b, msg, strlen(msg));
+		isc_buffer_add(b, strlen(msg));
+		*freecb = NULL;
+		*freecb_args = NULL;
+		return (ISC_R_SUCCESS);
+	}
+
+	isc_buffer_allocate(server->mctx, &m.b, 64 * 1024);
+	isc_buffer_setautorealloc(m.b, true);
+
+	metrics_server(&m);
+	metrics_views(&m);
+	metrics_zones(&m);
+	if (m.result == ISC_R_SUCCESS) {
+		m.result = isc_buffer_printf(m.b, "# EOF\n");
+	}
+
+	if (m.result != ISC_R_SUCCESS) {
+		isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+			      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
+			      "failed at rendering metrics: %s",
+			      isc_result_totext(m.result));
+		isc_buffer_free(&m.b);
+		return (m.result);
+	}
+
+	*retcode = 200;
+	*retmsg = "OK";
+	*mimetype = "application/openmetrics-text; version=1.0.0; "
+		    "charset=utf-8";
+	isc_buffer_reinit(b, isc_buffer_base(m.b), isc_buffer_usedlength(m.b));
+	isc_buffer_add(b, isc_buffer_usedlength(m.b));
+	*freecb = metrics_free;
+	*freecb_args = m.b;
+
+	return (ISC_R_SUCCESS);
+}
+#endif /* defined(EXTENDED_STATS) */
+
+static isc_result_t
+render_xsl(const char *url, isc_httpdurl_t *urlinfo, const char *querystring,
+	   const char *headers, void *args, unsigned int *retcode,
 	   const char **retmsg, const char **mimetype, isc_buffer_t *b,
 	   isc_httpdfree_t **freecb, void **freecb_args) {
 	isc_result_t result;
@@ -3641,6 +5850,12 @@ add_listener(named_server_t *server, named_statschannel_t **listenerp,
 	isc_httpdmgr_addurl(listener->httpdmgr,
 			    "/xml/v" STATS_XML_VERSION_MAJOR "/traffic", false,
 			    render_xml_traffic, server);
+	isc_httpdmgr_addurl(listener->httpdmgr,
+			    "/xml/v" STATS_XML_VERSION_MAJOR "/locks", false,
+			    render_xml_locks, server);
+	isc_httpdmgr_addurl(listener->httpdmgr,
+			    "/xml/v" STATS_XML_VERSION_MAJOR "/loops", false,
+			    render_xml_loops, server);
 #endif /* ifdef HAVE_LIBXML2 */
 #ifdef HAVE_JSON_C
 	isc_httpdmgr_addurl(listener->httpdmgr, "/json", false, render_json_all,
@@ -3669,7 +5884,17 @@ add_listener(named_server_t *server, named_statschannel_t **listenerp,
 	isc_httpdmgr_addurl(listener->httpdmgr,
 			    "/json/v" STATS_JSON_VERSION_MAJOR "/traffic",
 			    false, render_json_traffic, server);
+	isc_httpdmgr_addurl(listener->httpdmgr,
+			    "/json/v" STATS_JSON_VERSION_MAJOR "/locks", false,
+			    render_json_locks, server);
+	isc_httpdmgr_addurl(listener->httpdmgr,
+			    "/json/v" STATS_JSON_VERSION_MAJOR "/loops", false,
+			    render_json_loops, server);
 #endif /* ifdef HAVE_JSON_C */
+#if defined(EXTENDED_STATS)
+	isc_httpdmgr_addurl(listener->httpdmgr, "/metrics", false,
+			    render_metrics, server);
+#endif /* if defined(EXTENDED_STATS) */
 	isc_httpdmgr_addurl(listener->httpdmgr, "/bind9.xsl", true, render_xsl,
 			    server);
 
@@ -3959,6 +6184,28 @@ named_stats_dump(named_server_t *server, FILE *fp) {
 			    zonestats_desc, dns_zonestatscounter_max,
 			    zonestats_index, zonestat_values, 0);
 
+	fprintf(fp, "++ Zone Load Statistics ++\n");
+	dumparg.type = isc_statsformat_file;
+	dumparg.arg = fp;
+	zoneloadstat_dump(server->zonemgr, &dumparg);
+
+	fprintf(fp, "++ Zone Dump Statistics ++\n");
+	zonedumpstat_dump(server->zonemgr, &dumparg);
+
+	fprintf(fp, "++ Zone Manager Peers ++\n");
+	fprintf(fp, "%20u serial-query-rate\n",
+		dns_zonemgr_getserialqueryrate(server->zonemgr));
+	fprintf(fp, "%20u notify-rate\n",
+		dns_zonemgr_getnotifyrate(server->zonemgr));
+	dumparg.result = ISC_R_SUCCESS;
+	dns_zonemgr_dumppeers(server->zonemgr, zonepeer_dump, &dumparg);
+
+	fprintf(fp, "++ DNSSEC Key Pool ++\n");
+	fprintf(fp, "%20u depth\n",
+		dns_zonemgr_getkeypooldepth(server->zonemgr));
+	dumparg.result = ISC_R_SUCCESS;
+	dns_zonemgr_dumpkeypool(server->zonemgr, keypool_dump, &dumparg);
+
 	fprintf(fp, "++ Resolver Statistics ++\n");
 	fprintf(fp, "[Common]\n");
 	(void)dump_counters(server->resolverstats, isc_statsformat_file, fp,
@@ -80,11 +80,11 @@ typedef enum {
  * Convenience function for configuring a single zone ACL.
  */
 static isc_result_t
-configure_zone_acl(const cfg_obj_t *zconfig, const cfg_obj_t *vconfig,
-		   const cfg_obj_t *config, acl_type_t acltype,
-		   cfg_aclconfctx_t *actx, dns_zone_t *zone,
-		   void (*setzacl)(dns_zone_t *, dns_acl_t *),
-		   void (*clearzacl)(dns_zone_t *)) {
+configure_zone_acl_locked(const cfg_obj_t *zconfig, const cfg_obj_t *vconfig,
+			  const cfg_obj_t *config, acl_type_t acltype,
+			  cfg_aclconfctx_t *actx, dns_zone_t *zone,
+			  void (*setzacl)(dns_zone_t *, dns_acl_t *),
+			  void (*clearzacl)(dns_zone_t *)) {
 	isc_result_t result;
 	const cfg_obj_t *maps[5] = { NULL, NULL, NULL, NULL, NULL };
 	const cfg_obj_t *aclobj = NULL;
@@ -192,6 +192,26 @@ parse_acl:
 	return (ISC_R_SUCCESS);
 }
 
+/*%
+ * The ACL configuration context and the view default ACLs are shared by
+ * all the zones of the view, which can be configured in parallel.
+ */
+static isc_result_t
+configure_zone_acl(const cfg_obj_t *zconfig, const cfg_obj_t *vconfig,
+		   const cfg_obj_t *config, acl_type_t acltype,
+		   cfg_aclconfctx_t *actx, dns_zone_t *zone,
+		   void (*setzacl)(dns_zone_t *, dns_acl_t *),
+		   void (*clearzacl)(dns_zone_t *)) {
+	isc_result_t result;
+
+	LOCK(&named_g_server->zonecfg_lock);
+	result = configure_zone_acl_locked(zconfig, vconfig, config, acltype,
+					   actx, zone, setzacl, clearzacl);
+	UNLOCK(&named_g_server->zonecfg_lock);
+
+	return (result);
+}
+
 /*%
  * Parse the zone update-policy statement.
  */
@@ -1550,6 +1570,24 @@ named_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 		}
 
 		RETERR(configure_zone_ssutable(zoptions, mayberaw, zname));
+
+		obj = NULL;
+		result = named_config_get(maps, "journal-group-commit", &obj);
+		INSIST(result == ISC_R_SUCCESS && obj != NULL);
+		dns_zone_setoption(mayberaw, DNS_ZONEOPT_JOURNALGROUPCOMMIT,
+				   cfg_obj_asboolean(obj));
+
+		obj = NULL;
+		result = named_config_get(maps, "share-zone-data", &obj);
+		INSIST(result == ISC_R_SUCCESS && obj != NULL);
+		dns_zone_setoption(zone, DNS_ZONEOPT_SHAREDATA,
+				   cfg_obj_asboolean(obj));
+
+		obj = NULL;
+		result = named_config_get(maps, "reload-in-place", &obj);
+		INSIST(result == ISC_R_SUCCESS && obj != NULL);
+		dns_zone_setoption(zone, DNS_ZONEOPT_RELOADINPLACE,
+				   cfg_obj_asboolean(obj));
 	}
 
 	/*
@@ -1639,6 +1677,11 @@ named_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 		INSIST(result == ISC_R_SUCCESS && obj != NULL);
 		dns_zone_setnodes(zone, cfg_obj_asuint32(obj));
 
+		obj = NULL;
+		result = named_config_get(maps, "sig-signing-threads", &obj);
+		INSIST(result == ISC_R_SUCCESS && obj != NULL);
+		dns_zone_setsigningthreads(zone, cfg_obj_asuint32(obj));
+
 		obj = NULL;
 		result = named_config_get(maps, "sig-signing-type", &obj);
 		INSIST(result == ISC_R_SUCCESS && obj != NULL);
@@ -1722,6 +1765,17 @@ named_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 		}
 	}
 
+	/*%
+	 * Configure the rendered answer cache; the signed zone is the
+	 * one answering queries when inline signing is in use.
+	 */
+	if (ztype == dns_zone_primary || ztype == dns_zone_secondary) {
+		obj = NULL;
+		result = named_config_get(maps, "answer-cache", &obj);
+		INSIST(result == ISC_R_SUCCESS && obj != NULL);
+		dns_zone_setanswercache(zone, cfg_obj_asboolean(obj));
+	}
+
 	/*%
 	 * Configure primary zone functionality.
 	 */
@@ -1916,6 +1970,11 @@ named_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 		INSIST(result == ISC_R_SUCCESS && obj != NULL);
 		dns_zone_setidlein(mayberaw, cfg_obj_asuint32(obj) * 60);
 
+		obj = NULL;
+		result = named_config_get(maps, "on-demand-idle-time", &obj);
+		INSIST(result == ISC_R_SUCCESS && obj != NULL);
+		dns_zone_setidletime(mayberaw, cfg_obj_asduration(obj));
+
 		obj = NULL;
 		result = named_config_get(maps, "max-refresh-time", &obj);
 		INSIST(result == ISC_R_SUCCESS && obj != NULL);
@@ -46,6 +46,7 @@
 #include <isc/stdio.h>
 #include <isc/string.h>
 #include <isc/task.h>
+#include <isc/time.h>
 #include <isc/types.h>
 #include <isc/util.h>
 
@@ -103,6 +104,7 @@
 #define MAXTEXT	     (128 * 1024)
 #define FIND_TIMEOUT 5
 #define TTL_MAX	     2147483647U /* Maximum signed 32 bit integer. */
+#define BULK_MAXSIZE (32 * 1024) /* Changes per bulk UPDATE, in bytes. */
 
 #define DNSDEFAULTPORT 53
 
@@ -177,6 +179,16 @@ static bool default_ttl_set = false;
 static bool checknames = true;
 static const char *resolvconf = RESOLV_CONF;
 
+/* Bulk mode (-B) */
+static unsigned int bulkinflight = 0;
+static dns_fixedname_t fbulkzone;
+static dns_name_t *bulkzone = NULL;
+static isc_sockaddr_t bulkprimary;
+static bool bulkreading = false, bulkeof = false;
+static unsigned int bulkpending = 0, bulksize = 0;
+static uint64_t bulkrecords = 0, bulkmessages = 0, bulkfailed = 0;
+static isc_time_t bulkstart;
+
 bool done = false;
 
 typedef struct nsu_requestinfo {
@@ -364,6 +376,8 @@ reset_system(void) {
 		dns_message_create(gmctx, DNS_MESSAGE_INTENTRENDER, &updatemsg);
 	}
 	updatemsg->opcode = dns_opcode_update;
+	bulkpending = 0;
+	bulksize = 0;
 	if (usegsstsig) {
 		if (tsigkey != NULL) {
 			dns_tsigkey_detach(&tsigkey);
@@ -972,7 +986,7 @@ get_addresses(char *host, in_port_t port, isc_sockaddr_t *sockaddr,
 	return (count);
 }
 
-#define PARSE_ARGS_FMT "46C:dDghilL:Mok:p:Pr:R:t:Tu:vVy:"
+#define PARSE_ARGS_FMT "46B:C:dDghilL:Mok:p:Pr:R:t:Tu:vVy:"
 
 static void
 pre_parse_args(int argc, char **argv) {
@@ -1015,8 +1029,8 @@ pre_parse_args(int argc, char **argv) {
 			fprintf(stderr, "usage: nsupdate [-CdDi] [-L level] "
 					"[-l] [-g | -o | -y keyname:secret "
 					"| -k keyfile] [-p port] "
-					"[-v] [-V] [-P] [-T] [-4 | -6] "
-					"[filename]\n");
+					"[-B inflight] [-v] [-V] [-P] [-T] "
+					"[-4 | -6] [filename]\n");
 			exit(1);
 
 		case 'P':
@@ -1087,6 +1101,16 @@ parse_args(int argc, char **argv) {
 				fatal("can't find IPv6 networking");
 			}
 			break;
+		case 'B':
+			result = isc_parse_uint32(&bulkinflight,
+						  isc_commandline_argument, 10);
+			if (result != ISC_R_SUCCESS || bulkinflight == 0) {
+				fprintf(stderr, "bad bulk inflight '%s'\n",
+					isc_commandline_argument);
+				exit(1);
+			}
+			usevc = true;
+			break;
 		case 'C':
 			resolvconf = isc_commandline_argument;
 			break;
@@ -1195,6 +1219,12 @@ parse_args(int argc, char **argv) {
 		exit(1);
 	}
 
+	if (bulkinflight > 0 && usegsstsig) {
+		fprintf(stderr, "%s: cannot specify -B with -g or -o\n",
+			argv[0]);
+		exit(1);
+	}
+
 #if HAVE_GSSAPI
 	if (usegsstsig && (keyfile != NULL || keystr != NULL)) {
 		fprintf(stderr, "%s: cannot specify -g with -k or -y\n",
@@ -1324,6 +1354,12 @@ make_prereq(char *cmdline, bool ispositive, bool isrrset) {
 
 	ddebug("make_prereq()");
 
+	if (bulkinflight > 0) {
+		fprintf(stderr, "prerequisites are not supported in bulk "
+				"mode\n");
+		return (STATUS_SYNTAX);
+	}
+
 	/*
 	 * Read the owner name
 	 */
@@ -1502,6 +1538,8 @@ evaluate_server(char *cmdline) {
 		return (STATUS_SYNTAX);
 	}
 
+	bulkzone = NULL;
+
 	return (STATUS_MORE);
 }
 
@@ -1651,6 +1689,8 @@ evaluate_zone(char *cmdline) {
 		return (STATUS_SYNTAX);
 	}
 
+	bulkzone = NULL;
+
 	return (STATUS_MORE);
 }
 
@@ -1948,6 +1988,16 @@ doneparsing:
 	ISC_LIST_INIT(name->list);
 	ISC_LIST_APPEND(name->list, rdataset, link);
 	dns_message_addname(updatemsg, name, DNS_SECTION_UPDATE);
+
+	/*
+	 * In bulk mode, send the message once it holds about as many
+	 * changes as fit in one, before compression.
+	 */
+	bulkpending++;
+	bulksize += name->length + 10 + rdata->length;
+	if (bulkinflight > 0 && bulksize >= BULK_MAXSIZE) {
+		return (STATUS_SEND);
+	}
 	return (STATUS_MORE);
 
 failure:
@@ -2083,7 +2133,7 @@ do_next_command(char *cmdline) {
 	word = nsu_strsep(&cmdline, " \t\r\n");
 
 	if (word == NULL || *word == 0) {
-		return (STATUS_SEND);
+		return (bulkinflight > 0 ? STATUS_MORE : STATUS_SEND);
 	}
 	if (word[0] == ';') {
 		return (STATUS_MORE);
@@ -2131,7 +2181,7 @@ do_next_command(char *cmdline) {
 		return (evaluate_class(cmdline));
 	}
 	if (strcasecmp(word, "send") == 0) {
-		return (STATUS_SEND);
+		return (bulkinflight > 0 ? STATUS_MORE : STATUS_SEND);
 	}
 	if (strcasecmp(word, "debug") == 0) {
 		if (debugging) {
@@ -2167,6 +2217,12 @@ do_next_command(char *cmdline) {
 	    strcasecmp(word, "checknames") == 0) {
 		return (evaluate_checknames(cmdline));
 	}
+	if (bulkinflight > 0 && (strcasecmp(word, "gsstsig") == 0 ||
+				 strcasecmp(word, "oldgsstsig") == 0))
+	{
+		fprintf(stderr, "%s is not supported in bulk mode\n", word);
+		return (STATUS_SYNTAX);
+	}
 	if (strcasecmp(word, "gsstsig") == 0) {
 #if HAVE_GSSAPI
 		usegsstsig = true;
@@ -2284,10 +2340,60 @@ user_interaction(void) {
 	return (false);
 }
 
+static void
+bulk_finish(void) {
+	isc_time_t now;
+	uint64_t usecs;
+
+	isc_time_now(&now);
+	usecs = (bulkmessages > 0) ? isc_time_microdiff(&now, &bulkstart) : 0;
+	fprintf(stdout,
+		"; bulk update: %" PRIu64 " changes in %" PRIu64
+		" messages, %" PRIu64 " failed, %" PRIu64 ".%03u seconds",
+		bulkrecords, bulkmessages, bulkfailed, usecs / 1000000,
+		(unsigned int)(usecs % 1000000) / 1000);
+	if (usecs > 0) {
+		fprintf(stdout, ", %" PRIu64 " changes/s",
+			bulkrecords * 1000000 / usecs);
+	}
+	fprintf(stdout, "\n");
+
+	isc_task_detach(&global_task);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/*
+ * In bulk mode, keep reading the input while fewer than 'bulkinflight'
+ * updates are waiting for an answer, once the zone and its primary
+ * server are known, and finish when the input is exhausted and the
+ * last update has been answered.
+ */
+static void
+bulk_next(void) {
+	if (bulkeof) {
+		if (requests == 0) {
+			bulk_finish();
+		}
+		return;
+	}
+
+	if (!bulkreading && (unsigned int)requests < bulkinflight &&
+	    (bulkzone != NULL || requests == 0))
+	{
+		bulkreading = true;
+		isc_job_run(loopmgr, getinput, NULL);
+	}
+}
+
 static void
 done_update(void) {
 	ddebug("done_update()");
 
+	if (bulkinflight > 0) {
+		bulk_next();
+		return;
+	}
+
 	isc_job_run(loopmgr, getinput, NULL);
 }
 
@@ -2337,12 +2443,14 @@ update_completed(isc_task_t *task, isc_event_t *event) {
 	dns_requestevent_t *reqev = NULL;
 	isc_result_t result;
 	dns_request_t *request;
+	unsigned int changes;
 
 	UNUSED(task);
 
 	ddebug("update_completed()");
 
 	requests--;
+	changes = (uintptr_t)event->ev_arg;
 
 	REQUIRE(event->ev_type == DNS_EVENT_REQUESTDONE);
 	reqev = (dns_requestevent_t *)event;
@@ -2355,6 +2463,18 @@ update_completed(isc_task_t *task, isc_event_t *event) {
 		return;
 	}
 
+	if (reqev->result != ISC_R_SUCCESS && bulkinflight > 0) {
+		/*
+		 * The update message has been reused for the next
+		 * changes, so it can't be resent.
+		 */
+		fprintf(stderr, "; update of %u changes failed: %s\n", changes,
+			isc_result_totext(reqev->result));
+		bulkfailed += changes;
+		seenerror = true;
+		goto done;
+	}
+
 	if (reqev->result != ISC_R_SUCCESS) {
 		if (!next_primary("update_completed",
 				  &primary_servers[primary_inuse],
@@ -2374,6 +2494,9 @@ update_completed(isc_task_t *task, isc_event_t *event) {
 	}
 
 	LOCK(&answer_lock);
+	if (answer != NULL) {
+		dns_message_detach(&answer);
+	}
 	dns_message_create(gmctx, DNS_MESSAGE_INTENTPARSE, &answer);
 	result = dns_request_getresponse(request, answer,
 					 DNS_MESSAGEPARSE_PRESERVEORDER);
@@ -2400,6 +2523,7 @@ update_completed(isc_task_t *task, isc_event_t *event) {
 		fprintf(stderr, "; TSIG error with server: %s\n",
 			isc_result_totext(result));
 		seenerror = true;
+		bulkfailed += changes;
 		break;
 	default:
 		check_result(result, "dns_request_getresponse");
@@ -2411,6 +2535,7 @@ update_completed(isc_task_t *task, isc_event_t *event) {
 
 	if (answer->rcode != dns_rcode_noerror) {
 		seenerror = true;
+		bulkfailed += changes;
 		if (!debugging) {
 			char buf[64];
 			isc_buffer_t b;
@@ -2480,10 +2605,10 @@ send_update(dns_name_t *zone, isc_sockaddr_t *primary) {
 		updatemsg->tsigname->attributes |= DNS_NAMEATTR_NOCOMPRESS;
 	}
 
-	result = dns_request_createvia(requestmgr, updatemsg, srcaddr, primary,
-				       -1, options, tsigkey, timeout,
-				       udp_timeout, udp_retries, global_task,
-				       update_completed, NULL, &request);
+	result = dns_request_createvia(
+		requestmgr, updatemsg, srcaddr, primary, -1, options, tsigkey,
+		timeout, udp_timeout, udp_retries, global_task,
+		update_completed, (void *)(uintptr_t)bulkpending, &request);
 	check_result(result, "dns_request_createvia");
 
 	if (debugging) {
@@ -2491,6 +2616,18 @@ send_update(dns_name_t *zone, isc_sockaddr_t *primary) {
 	}
 
 	requests++;
+
+	if (bulkinflight > 0) {
+		if (bulkmessages++ == 0) {
+			isc_time_now(&bulkstart);
+		}
+		bulkrecords += bulkpending;
+		if (zone != bulkzone) {
+			bulkzone = dns_fixedname_initname(&fbulkzone);
+			dns_name_copy(zone, bulkzone);
+			bulkprimary = *primary;
+		}
+	}
 }
 
 static void
@@ -3199,6 +3336,16 @@ start_update(void) {
 	}
 	UNLOCK(&answer_lock);
 
+	/*
+	 * In bulk mode, the zone and primary server found for the first
+	 * update are used until the zone or server is changed.
+	 */
+	if (bulkinflight > 0 && bulkzone != NULL) {
+		send_update(bulkzone, &bulkprimary);
+		setzoneclass(dns_rdataclass_none);
+		return;
+	}
+
 	/*
 	 * If we have both the zone and the servers we have enough information
 	 * to send the update straight away otherwise we need to discover
@@ -3343,11 +3490,23 @@ getinput(void *arg) {
 		return;
 	}
 
+	bulkreading = false;
 	reset_system();
 	isc_loopmgr_blocking(loopmgr);
 	more = user_interaction();
 	isc_loopmgr_nonblocking(loopmgr);
+	if (bulkinflight > 0 && !more) {
+		/*
+		 * Send the changes read since the last update.
+		 */
+		bulkeof = true;
+		more = (bulkpending > 0);
+	}
 	if (!more) {
+		if (bulkinflight > 0) {
+			bulk_next();
+			return;
+		}
 		isc_task_detach(&global_task);
 		isc_loopmgr_shutdown(loopmgr);
 		return;
@@ -3355,6 +3514,10 @@ getinput(void *arg) {
 
 	done = false;
 	start_update();
+
+	if (bulkinflight > 0) {
+		bulk_next();
+	}
 }
 
 int
@@ -78,8 +78,12 @@ typedef struct filter_instance {
 	isc_mem_t *mctx;
 
 	/*
-	 * Hash table associating a client object with its persistent data.
+	 * Where the persistent data of a client is kept: in the 'slot'
+	 * hook slot of the client if 'hasslot' is set, or else in a hash
+	 * table keyed by the client object.
 	 */
+	bool hasslot;
+	unsigned int slot;
 	isc_ht_t *ht;
 	isc_mutex_t hlock;
 
@@ -350,6 +354,7 @@ plugin_register(const char *parameters, const void *cfg, const char *cfg_file,
 				       cfg_line, mctx, lctx, actx));
 	}
 
+	inst->hasslot = (ns_hook_allocslot(&inst->slot) == ISC_R_SUCCESS);
 	isc_ht_init(&inst->ht, mctx, 1, ISC_HT_CASE_SENSITIVE);
 	isc_mutex_init(&inst->hlock);
 
@@ -404,6 +409,9 @@ void
 plugin_destroy(void **instp) {
 	filter_instance_t *inst = (filter_instance_t *)*instp;
 
+	if (inst->hasslot) {
+		ns_hook_freeslot(inst->slot);
+	}
 	if (inst->ht != NULL) {
 		isc_ht_destroy(&inst->ht);
 		isc_mutex_destroy(&inst->hlock);
@@ -476,6 +484,10 @@ client_state_get(const query_ctx_t *qctx, filter_instance_t *inst) {
 	filter_data_t *client_state = NULL;
 	isc_result_t result;
 
+	if (inst->hasslot) {
+		return (qctx->client->query.hookslots[inst->slot]);
+	}
+
 	LOCK(&inst->hlock);
 	result = isc_ht_find(inst->ht, (const unsigned char *)&qctx->client,
 			     sizeof(qctx->client), (void **)&client_state);
@@ -494,6 +506,12 @@ client_state_create(const query_ctx_t *qctx, filter_instance_t *inst) {
 	client_state->mode = NONE;
 	client_state->flags = 0;
 
+	if (inst->hasslot) {
+		INSIST(qctx->client->query.hookslots[inst->slot] == NULL);
+		qctx->client->query.hookslots[inst->slot] = client_state;
+		return;
+	}
+
 	LOCK(&inst->hlock);
 	result = isc_ht_add(inst->ht, (const unsigned char *)&qctx->client,
 			    sizeof(qctx->client), client_state);
@@ -510,6 +528,12 @@ client_state_destroy(const query_ctx_t *qctx, filter_instance_t *inst) {
 		return;
 	}
 
+	if (inst->hasslot) {
+		qctx->client->query.hookslots[inst->slot] = NULL;
+		isc_mem_put(inst->mctx, client_state, sizeof(*client_state));
+		return;
+	}
+
 	LOCK(&inst->hlock);
 	result = isc_ht_delete(inst->ht, (const unsigned char *)&qctx->client,
 			       sizeof(qctx->client));
@@ -13,6 +13,8 @@
 
 /*! \file */
 
+#include <ctype.h>
+#include <errno.h>
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -56,6 +58,12 @@
 
 #define SERVERADDRS 10
 
+/*
+ * The longest command read from a batch file, which is also the
+ * largest message the server accepts.
+ */
+#define BATCHLINE 32768
+
 const char *progname = NULL;
 bool verbose;
 
@@ -93,10 +101,17 @@ static bool showresult = false;
 static bool shuttingdown = false;
 static isc_nmhandle_t *recvdone_handle = NULL;
 static isc_nmhandle_t *recvnonce_handle = NULL;
+static uint32_t ccnonce = 0;
+static const char *batchfile = NULL;
+static FILE *batchfp = NULL;
+static char batchcmd[BATCHLINE];
 
 static void
 rndc_startconnect(isc_sockaddr_t *addr);
 
+static void
+rndc_sendcommand(isc_nmhandle_t *handle, isccc_ccmsg_t *ccmsg);
+
 noreturn static void
 usage(int status);
 
@@ -105,11 +120,19 @@ usage(int status) {
 	fprintf(stderr, "\
 Usage: %s [-b address] [-c config] [-s server] [-p port]\n\
 	[-k key-file ] [-y key] [-r] [-V] [-4 | -6] command\n\
+       %s [options] -f file\n\
+\n\
+With -f, the commands are read from file (\"-\" for the standard\n\
+input), one per line, and sent over a single connection.\n\
 \n\
 command is one of the following:\n\
 \n\
   addzone zone [class [view]] { zone-options }\n\
 		Add zone to given view. Requires allow-new-zones option.\n\
+  addzones file\n\
+		Add all the zones defined in a file on the server, in a\n\
+		single operation. Requires allow-new-zones option and\n\
+		the new zone database (LMDB).\n\
   delzone [-clean] zone [class [view]]\n\
 		Removes zone from given view.\n\
   dnssec -checkds [-key id [-alg algorithm]] [-when time] (published|withdrawn) zone [class [view]]\n\
@@ -144,12 +167,18 @@ command is one of the following:\n\
 		process id.\n\
   loadkeys zone [class [view]]\n\
 		Update keys without signing immediately.\n\
+  lock-profile [reset]\n\
+		Display or reset the lock contention profile\n\
+		(requires named built with --enable-lock-profile).\n\
   managed-keys refresh [class [view]]\n\
 		Check trust anchor for RFC 5011 key changes\n\
   managed-keys status [class [view]]\n\
 		Display RFC 5011 managed keys information\n\
   managed-keys sync [class [view]]\n\
 		Write RFC 5011 managed keys to disk\n\
+  memprof [on [rate] | off | dump | reset | status]\n\
+		Control the sampling heap profiler, or write the heap\n\
+		profile to the memprof-file in the pprof format.\n\
   modzone zone [class [view]] { zone-options }\n\
 		Modify a zone's configuration.\n\
 		Requires allow-new-zones option.\n\
@@ -204,6 +233,8 @@ command is one of the following:\n\
 		Remove NSEC3 chains from zone.\n\
   signing -serial <value> zone [class [view]]\n\
 		Set the zones's serial to <value>.\n\
+  snapshot-cache [view]\n\
+		Write the server's cache(s) to the cache snapshot file(s).\n\
   stats		Write server statistics to the statistics file.\n\
   status	Display status of the server.\n\
   stop		Save pending updates to master files and stop the server.\n\
@@ -232,12 +263,12 @@ command is one of the following:\n\
 		Display the current status of a zone.\n\
 \n\
 Version: %s\n",
-		progname, version);
+		progname, progname, version);
 
 	exit(status);
 }
 
-#define CMDLINE_FLAGS "46b:c:hk:Mmp:qrs:Vy:"
+#define CMDLINE_FLAGS "46b:c:f:hk:Mmp:qrs:Vy:"
 
 static void
 preparse_args(int argc, char **argv) {
@@ -293,6 +324,47 @@ get_addresses(const char *host, in_port_t port) {
 	INSIST(nserveraddrs > 0);
 }
 
+/*
+ * Read the next command from the batch file into 'batchcmd' and point
+ * 'command' and 'args' to it, skipping empty lines and comments.
+ * Return false at the end of the file.
+ */
+static bool
+batch_next(void) {
+	while (fgets(batchcmd, sizeof(batchcmd), batchfp) != NULL) {
+		size_t len = strlen(batchcmd);
+		char *p = batchcmd;
+
+		if (len > 0 && batchcmd[len - 1] != '\n' && !feof(batchfp)) {
+			fatal("%s: line too long", batchfile);
+		}
+		while (len > 0 && isspace((unsigned char)batchcmd[len - 1])) {
+			batchcmd[--len] = '\0';
+		}
+		while (isspace((unsigned char)*p)) {
+			p++;
+		}
+		if (*p == '\0' || *p == '#') {
+			continue;
+		}
+		if (strncmp(p, "restart", 7) == 0 &&
+		    (p[7] == '\0' || isspace((unsigned char)p[7])))
+		{
+			fatal("'restart' is not implemented");
+		}
+
+		command = args = p;
+		notify("%s", command);
+		return (true);
+	}
+
+	if (ferror(batchfp)) {
+		fatal("%s: read failed", batchfile);
+	}
+
+	return (false);
+}
+
 static void
 rndc_senddone(isc_nmhandle_t *handle, isc_result_t result, void *arg) {
 	isc_nmhandle_t *sendhandle = (isc_nmhandle_t *)arg;
@@ -321,6 +393,7 @@ rndc_recvdone(isc_nmhandle_t *handle, isc_result_t result, void *arg) {
 	isccc_region_t source;
 	char *errormsg = NULL;
 	char *textmsg = NULL;
+	bool cmdfailed = false;
 
 	REQUIRE(ccmsg != NULL);
 
@@ -356,7 +429,7 @@ rndc_recvdone(isc_nmhandle_t *handle, isc_result_t result, void *arg) {
 	}
 	result = isccc_cc_lookupstring(data, "err", &errormsg);
 	if (result == ISC_R_SUCCESS) {
-		failed = true;
+		failed = cmdfailed = true;
 		fprintf(stderr, "%s: '%s' failed: %s\n", progname, command,
 			errormsg);
 	} else if (result != ISC_R_NOTFOUND) {
@@ -366,8 +439,8 @@ rndc_recvdone(isc_nmhandle_t *handle, isc_result_t result, void *arg) {
 
 	result = isccc_cc_lookupstring(data, "text", &textmsg);
 	if (result == ISC_R_SUCCESS) {
-		if ((!quiet || failed) && strlen(textmsg) != 0U) {
-			fprintf(failed ? stderr : stdout, "%s\n", textmsg);
+		if ((!quiet || cmdfailed) && strlen(textmsg) != 0U) {
+			fprintf(cmdfailed ? stderr : stdout, "%s\n", textmsg);
 		}
 	} else if (result != ISC_R_NOTFOUND) {
 		fprintf(stderr, "%s: parsing response failed: %s\n", progname,
@@ -390,6 +463,13 @@ rndc_recvdone(isc_nmhandle_t *handle, isc_result_t result, void *arg) {
 	REQUIRE(recvdone_handle == handle);
 	isc_nmhandle_detach(&recvdone_handle);
 
+	/*
+	 * In batch mode, send the next command over the same connection.
+	 */
+	if (batchfp != NULL && batch_next()) {
+		rndc_sendcommand(handle, ccmsg);
+	}
+
 	if (atomic_fetch_sub_release(&recvs, 1) == 1 &&
 	    atomic_load_acquire(&sends) == 0)
 	{
@@ -403,15 +483,8 @@ static void
 rndc_recvnonce(isc_nmhandle_t *handle, isc_result_t result, void *arg) {
 	isccc_ccmsg_t *ccmsg = (isccc_ccmsg_t *)arg;
 	isccc_sexpr_t *response = NULL;
-	isc_nmhandle_t *sendhandle = NULL;
 	isccc_sexpr_t *_ctrl = NULL;
 	isccc_region_t source;
-	uint32_t nonce;
-	isccc_sexpr_t *request = NULL;
-	isccc_time_t now;
-	isc_region_t r;
-	isccc_sexpr_t *data = NULL;
-	isc_buffer_t b;
 
 	REQUIRE(ccmsg != NULL);
 
@@ -445,11 +518,35 @@ rndc_recvnonce(isc_nmhandle_t *handle, isc_result_t result, void *arg) {
 	if (!isccc_alist_alistp(_ctrl)) {
 		fatal("bad or missing ctrl section in response");
 	}
-	nonce = 0;
-	if (isccc_cc_lookupuint32(_ctrl, "_nonce", &nonce) != ISC_R_SUCCESS) {
-		nonce = 0;
+	if (isccc_cc_lookupuint32(_ctrl, "_nonce", &ccnonce) != ISC_R_SUCCESS) {
+		ccnonce = 0;
 	}
 
+	rndc_sendcommand(handle, ccmsg);
+
+	REQUIRE(recvnonce_handle == handle);
+	isc_nmhandle_detach(&recvnonce_handle);
+	atomic_fetch_sub_release(&recvs, 1);
+
+	isccc_sexpr_free(&response);
+	return;
+}
+
+/*
+ * Send the command in 'args' over the connection 'handle', which has
+ * been given a nonce, and read the response.
+ */
+static void
+rndc_sendcommand(isc_nmhandle_t *handle, isccc_ccmsg_t *ccmsg) {
+	isc_nmhandle_t *sendhandle = NULL;
+	isccc_sexpr_t *_ctrl = NULL;
+	isccc_sexpr_t *request = NULL;
+	isccc_sexpr_t *data = NULL;
+	isccc_time_t now;
+	isc_region_t r;
+	isc_buffer_t b;
+	isc_result_t result;
+
 	isc_stdtime_get(&now);
 
 	DO("create message", isccc_cc_createmessage(1, NULL, NULL, ++serial,
@@ -461,12 +558,12 @@ rndc_recvnonce(isc_nmhandle_t *handle, isc_result_t result, void *arg) {
 	if (isccc_cc_definestring(data, "type", args) == NULL) {
 		fatal("out of memory");
 	}
-	if (nonce != 0) {
+	if (ccnonce != 0) {
 		_ctrl = isccc_alist_lookup(request, "_ctrl");
 		if (_ctrl == NULL) {
 			fatal("_ctrl section missing");
 		}
-		if (isccc_cc_defineuint32(_ctrl, "_nonce", nonce) == NULL) {
+		if (isccc_cc_defineuint32(_ctrl, "_nonce", ccnonce) == NULL) {
 			fatal("out of memory");
 		}
 	}
@@ -492,13 +589,7 @@ rndc_recvnonce(isc_nmhandle_t *handle, isc_result_t result, void *arg) {
 	atomic_fetch_add_relaxed(&sends, 1);
 	isc_nm_send(handle, &r, rndc_senddone, sendhandle);
 
-	REQUIRE(recvnonce_handle == handle);
-	isc_nmhandle_detach(&recvnonce_handle);
-	atomic_fetch_sub_release(&recvs, 1);
-
-	isccc_sexpr_free(&response);
 	isccc_sexpr_free(&request);
-	return;
 }
 
 static void
@@ -950,6 +1041,10 @@ main(int argc, char **argv) {
 			c_flag = true;
 			break;
 
+		case 'f':
+			batchfile = isc_commandline_argument;
+			break;
+
 		case 'k':
 			admin_keyfile = isc_commandline_argument;
 			break;
@@ -1010,7 +1105,23 @@ main(int argc, char **argv) {
 	argc -= isc_commandline_index;
 	argv += isc_commandline_index;
 
-	if (argv[0] == NULL) {
+	if (batchfile != NULL) {
+		if (argv[0] != NULL) {
+			fatal("a command can't be given with -f");
+		}
+		if (strcmp(batchfile, "-") == 0) {
+			batchfp = stdin;
+		} else {
+			batchfp = fopen(batchfile, "r");
+			if (batchfp == NULL) {
+				fatal("can't open %s: %s", batchfile,
+				      strerror(errno));
+			}
+		}
+		if (!batch_next()) {
+			fatal("no commands in %s", batchfile);
+		}
+	} else if (argv[0] == NULL) {
 		usage(1);
 	} else {
 		command = argv[0];
@@ -1046,26 +1157,29 @@ main(int argc, char **argv) {
 	/*
 	 * Convert argc/argv into a space-delimited command string
 	 * similar to what the user might enter in interactive mode
-	 * (if that were implemented).
+	 * (if that were implemented).  In batch mode the commands are
+	 * already strings.
 	 */
 	argslen = 0;
-	for (i = 0; i < argc; i++) {
-		argslen += strlen(argv[i]) + 1;
-	}
+	if (batchfp == NULL) {
+		for (i = 0; i < argc; i++) {
+			argslen += strlen(argv[i]) + 1;
+		}
 
-	args = isc_mem_get(rndc_mctx, argslen);
+		args = isc_mem_get(rndc_mctx, argslen);
 
-	p = args;
-	for (i = 0; i < argc; i++) {
-		size_t len = strlen(argv[i]);
-		memmove(p, argv[i], len);
-		p += len;
-		*p++ = ' ';
-	}
+		p = args;
+		for (i = 0; i < argc; i++) {
+			size_t len = strlen(argv[i]);
+			memmove(p, argv[i], len);
+			p += len;
+			*p++ = ' ';
+		}
 
-	p--;
-	*p++ = '\0';
-	INSIST(p == args + argslen);
+		p--;
+		*p++ = '\0';
+		INSIST(p == args + argslen);
+	}
 
 	if (nserveraddrs == 0 && servername != NULL) {
 		get_addresses(servername, (in_port_t)remoteport);
@@ -1087,7 +1201,11 @@ main(int argc, char **argv) {
 	cfg_obj_destroy(pctx, &config);
 	cfg_parser_destroy(&pctx);
 
-	isc_mem_put(rndc_mctx, args, argslen);
+	if (batchfp == NULL) {
+		isc_mem_put(rndc_mctx, args, argslen);
+	} else if (batchfp != stdin) {
+		fclose(batchfp);
+	}
 
 	isc_buffer_free(&databuf);
 
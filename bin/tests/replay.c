@@ -0,0 +1,849 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Replay the DNS queries recorded in a pcap or dnstap file against a
+ * running server, over UDP, keeping the original spacing between the
+ * queries divided by a speed multiplier (or as fast as possible), and
+ * report the latency percentiles and the response codes.
+ *
+ * If the server has a statistics channel, the counters of authoritative
+ * answers, answers from the cache and answers that needed recursion,
+ * and of the queries the resolver sent upstream, are read before and
+ * after the run, which gives the answer sources and the upstream query
+ * amplification of the replayed traffic.
+ *
+ * For resolver benchmarks that do not depend on the Internet, run
+ * test_server in authoritative mode ("test_server -A -a 127.0.0.1")
+ * and point the root hints of the resolver at it:
+ *
+ *	.		NS	ns.fake.
+ *	ns.fake.	A	127.0.0.1
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <isc/atomic.h>
+#include <isc/attributes.h>
+#include <isc/mem.h>
+#include <isc/netaddr.h>
+#include <isc/result.h>
+#include <isc/sockaddr.h>
+#include <isc/string.h>
+#include <isc/thread.h>
+#include <isc/util.h>
+
+#ifdef HAVE_DNSTAP
+#include <dns/dnstap.h>
+#endif /* HAVE_DNSTAP */
+
+#define MAX_SOCKETS 64
+#define DNS_HDRLEN  12
+
+/*
+ * The queries are kept in wire format, packed one after the other,
+ * with the time at which each was recorded, relative to the first.
+ */
+typedef struct query {
+	uint64_t when;
+	size_t offset;
+	uint16_t length;
+} query_t;
+
+static unsigned char *wires = NULL;
+static size_t wiresize = 0, wireused = 0;
+static query_t *queries = NULL;
+static size_t nqueries = 0, queryalloc = 0;
+static uint64_t firsttime = 0;
+
+static isc_mem_t *mctx = NULL;
+static isc_sockaddr_t server;
+static isc_sockaddr_t statsserver;
+static bool statsenabled = false;
+static double speed = 1.0;
+static unsigned int nsockets = 8;
+static uint64_t timeout = 2000000000; /* nanoseconds */
+static int fds[MAX_SOCKETS];
+
+/*
+ * One slot per socket and query ID holds the time the outstanding query
+ * was sent, or zero.
+ */
+static atomic_uint_fast64_t *sent = NULL;
+static atomic_uint_fast64_t outstanding = 0;
+static atomic_bool done = false;
+
+/* Only written by the receiving thread. */
+static uint32_t *latencies = NULL; /* microseconds */
+static uint64_t received = 0, late = 0, unexpected = 0;
+static uint64_t rcodes[16];
+static uint64_t authoritative = 0, truncated = 0, referrals = 0;
+
+static uint64_t lost = 0, senderrors = 0;
+
+static uint64_t
+now_ns(void) {
+	struct timespec ts;
+
+	RUNTIME_CHECK(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+noreturn static void
+fatal(const char *format, ...) ISC_FORMAT_PRINTF(1, 2);
+
+static void
+fatal(const char *format, ...) {
+	va_list args;
+
+	fprintf(stderr, "replay: ");
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	va_end(args);
+	fprintf(stderr, "\n");
+	exit(EXIT_FAILURE);
+}
+
+static void
+add_query(uint64_t timestamp, const unsigned char *msg, size_t length) {
+	query_t *q = NULL;
+
+	/* Skip anything that is not a query. */
+	if (length < DNS_HDRLEN || length > UINT16_MAX || (msg[2] & 0x80) != 0)
+	{
+		return;
+	}
+
+	if (nqueries == 0) {
+		firsttime = timestamp;
+	}
+
+	if (nqueries == queryalloc) {
+		queryalloc = ISC_MAX(queryalloc * 2, 1024);
+		queries = realloc(queries, queryalloc * sizeof(queries[0]));
+		RUNTIME_CHECK(queries != NULL);
+	}
+	while (wireused + length > wiresize) {
+		wiresize = ISC_MAX(wiresize * 2, 65536);
+		wires = realloc(wires, wiresize);
+		RUNTIME_CHECK(wires != NULL);
+	}
+
+	q = &queries[nqueries++];
+	q->when = timestamp > firsttime ? timestamp - firsttime : 0;
+	q->offset = wireused;
+	q->length = length;
+	memmove(wires + wireused, msg, length);
+	wireused += length;
+}
+
+/*
+ * pcap files: only UDP over IPv4 or IPv6, on Ethernet (with or without
+ * a VLAN tag), Linux "cooked" captures, BSD loopback and raw IP.
+ */
+
+static uint32_t
+get32(const unsigned char *p, bool swap) {
+	if (swap) {
+		return ((uint32_t)p[3] << 24 | (uint32_t)p[2] << 16 |
+			(uint32_t)p[1] << 8 | p[0]);
+	}
+	return ((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+		(uint32_t)p[2] << 8 | p[3]);
+}
+
+static void
+pcap_packet(uint32_t linktype, uint64_t timestamp, const unsigned char *p,
+	    size_t length) {
+	unsigned int ethertype = 0;
+	unsigned int proto;
+	size_t hlen;
+
+	switch (linktype) {
+	case 0: /* BSD loopback */
+		if (length < 4) {
+			return;
+		}
+		ethertype = (p[0] == 2 || p[3] == 2) ? 0x0800 : 0x86dd;
+		p += 4;
+		length -= 4;
+		break;
+	case 1: /* Ethernet */
+		if (length < 14) {
+			return;
+		}
+		ethertype = p[12] << 8 | p[13];
+		p += 14;
+		length -= 14;
+		if (ethertype == 0x8100 && length >= 4) {
+			ethertype = p[2] << 8 | p[3];
+			p += 4;
+			length -= 4;
+		}
+		break;
+	case 12:
+	case 101: /* raw IP */
+		if (length < 1) {
+			return;
+		}
+		ethertype = (p[0] >> 4) == 4 ? 0x0800 : 0x86dd;
+		break;
+	case 113: /* Linux cooked */
+		if (length < 16) {
+			return;
+		}
+		ethertype = p[14] << 8 | p[15];
+		p += 16;
+		length -= 16;
+		break;
+	case 276: /* Linux cooked v2 */
+		if (length < 20) {
+			return;
+		}
+		ethertype = p[0] << 8 | p[1];
+		p += 20;
+		length -= 20;
+		break;
+	default:
+		return;
+	}
+
+	switch (ethertype) {
+	case 0x0800:
+		if (length < 20 || (p[0] >> 4) != 4) {
+			return;
+		}
+		hlen = (p[0] & 0x0f) * 4;
+		proto = p[9];
+		/* Skip fragments. */
+		if ((p[6] & 0x3f) != 0 || p[7] != 0) {
+			return;
+		}
+		break;
+	case 0x86dd:
+		if (length < 40 || (p[0] >> 4) != 6) {
+			return;
+		}
+		hlen = 40;
+		proto = p[6];
+		break;
+	default:
+		return;
+	}
+	if (proto != 17 || length < hlen + 8) {
+		return;
+	}
+	p += hlen + 8;
+	length -= hlen + 8;
+
+	add_query(timestamp, p, length);
+}
+
+static void
+read_pcap(const char *filename) {
+	unsigned char header[24], record[16];
+	unsigned char *packet = NULL;
+	uint32_t magic, linktype, snaplen;
+	bool swap, nanoseconds;
+	FILE *fp = NULL;
+
+	fp = fopen(filename, "r");
+	if (fp == NULL) {
+		fatal("%s: %s", filename, strerror(errno));
+	}
+	if (fread(header, sizeof(header), 1, fp) != 1) {
+		fatal("%s: short file", filename);
+	}
+
+	magic = get32(header, false);
+	switch (magic) {
+	case 0xa1b2c3d4:
+	case 0xd4c3b2a1:
+		nanoseconds = false;
+		break;
+	case 0xa1b23c4d:
+	case 0x4d3cb2a1:
+		nanoseconds = true;
+		break;
+	default:
+		fatal("%s: not a pcap file", filename);
+	}
+	swap = (magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1);
+	snaplen = ISC_MAX(get32(header + 16, swap), 65536);
+	linktype = get32(header + 20, swap) & 0xffff;
+
+	packet = malloc(snaplen);
+	RUNTIME_CHECK(packet != NULL);
+
+	while (fread(record, sizeof(record), 1, fp) == 1) {
+		uint64_t seconds = get32(record, swap);
+		uint64_t fraction = get32(record + 4, swap);
+		uint32_t caplen = get32(record + 8, swap);
+
+		if (caplen > snaplen) {
+			fatal("%s: corrupt packet record", filename);
+		}
+		if (fread(packet, caplen, 1, fp) != 1) {
+			break;
+		}
+
+		pcap_packet(linktype,
+			    seconds * 1000000000 +
+				    (nanoseconds ? fraction : fraction * 1000),
+			    packet, caplen);
+	}
+
+	free(packet);
+	fclose(fp);
+}
+
+#ifdef HAVE_DNSTAP
+static void
+read_dnstap(const char *filename) {
+	dns_dthandle_t *handle = NULL;
+	isc_result_t result;
+
+	result = dns_dt_open(filename, dns_dtmode_file, mctx, &handle);
+	if (result != ISC_R_SUCCESS) {
+		fatal("%s: %s", filename, isc_result_totext(result));
+	}
+
+	for (;;) {
+		dns_dtdata_t *dt = NULL;
+		isc_region_t input;
+		uint8_t *data = NULL;
+		size_t datalen;
+
+		result = dns_dt_getframe(handle, &data, &datalen);
+		if (result == ISC_R_NOMORE) {
+			break;
+		} else if (result != ISC_R_SUCCESS) {
+			fatal("%s: %s", filename, isc_result_totext(result));
+		}
+
+		input.base = data;
+		input.length = datalen;
+		result = dns_dt_parse(mctx, &input, &dt);
+		if (result != ISC_R_SUCCESS) {
+			continue;
+		}
+
+		/*
+		 * Replay the queries the server received, from clients
+		 * or, for an authoritative server, from resolvers.
+		 */
+		if (dt->query && !dt->tcp && dt->msgdata.base != NULL &&
+		    (dt->type & (DNS_DTTYPE_CQ | DNS_DTTYPE_AQ)) != 0)
+		{
+			add_query(isc_time_seconds(&dt->qtime) * 1000000000ULL +
+					  isc_time_nanoseconds(&dt->qtime),
+				  dt->msgdata.base, dt->msgdata.length);
+		}
+
+		dns_dtdata_free(&dt);
+	}
+
+	dns_dt_close(&handle);
+}
+#endif /* HAVE_DNSTAP */
+
+static void
+read_queries(const char *filename) {
+	unsigned char magic[4];
+	FILE *fp = fopen(filename, "r");
+
+	if (fp == NULL) {
+		fatal("%s: %s", filename, strerror(errno));
+	}
+	if (fread(magic, sizeof(magic), 1, fp) != 1) {
+		fatal("%s: short file", filename);
+	}
+	fclose(fp);
+
+	switch (get32(magic, false)) {
+	case 0xa1b2c3d4:
+	case 0xd4c3b2a1:
+	case 0xa1b23c4d:
+	case 0x4d3cb2a1:
+		read_pcap(filename);
+		break;
+	default:
+#ifdef HAVE_DNSTAP
+		read_dnstap(filename);
+#else  /* HAVE_DNSTAP */
+		fatal("%s: not a pcap file, and dnstap is not supported",
+		      filename);
+#endif /* HAVE_DNSTAP */
+	}
+
+	if (nqueries == 0) {
+		fatal("%s: no queries found", filename);
+	}
+}
+
+/*
+ * Sending and receiving.
+ */
+
+static void
+open_sockets(void) {
+	for (unsigned int i = 0; i < nsockets; i++) {
+		int bufsize = 4 * 1024 * 1024;
+
+		fds[i] = socket(isc_sockaddr_pf(&server), SOCK_DGRAM, 0);
+		if (fds[i] < 0) {
+			fatal("socket: %s", strerror(errno));
+		}
+		(void)setsockopt(fds[i], SOL_SOCKET, SO_RCVBUF, &bufsize,
+				 sizeof(bufsize));
+		(void)setsockopt(fds[i], SOL_SOCKET, SO_SNDBUF, &bufsize,
+				 sizeof(bufsize));
+		if (connect(fds[i], &server.type.sa, server.length) < 0) {
+			fatal("connect: %s", strerror(errno));
+		}
+	}
+}
+
+static void
+response(unsigned int s, const unsigned char *msg, size_t length,
+	 uint64_t now) {
+	unsigned int id, slot;
+	uint64_t then, latency;
+
+	if (length < DNS_HDRLEN) {
+		unexpected++;
+		return;
+	}
+
+	id = msg[0] << 8 | msg[1];
+	slot = s * 65536 + id;
+	then = atomic_exchange(&sent[slot], 0);
+	if (then == 0) {
+		unexpected++;
+		return;
+	}
+	atomic_fetch_sub(&outstanding, 1);
+
+	latency = now > then ? now - then : 0;
+	if (latency > timeout) {
+		late++;
+		return;
+	}
+
+	latencies[received++] = (uint32_t)ISC_MIN(latency / 1000, UINT32_MAX);
+	rcodes[msg[3] & 0x0f]++;
+	if ((msg[2] & 0x04) != 0) {
+		authoritative++;
+	} else if ((msg[3] & 0x0f) == 0 && msg[6] == 0 && msg[7] == 0 &&
+		   (msg[8] != 0 || msg[9] != 0))
+	{
+		referrals++;
+	}
+	if ((msg[2] & 0x02) != 0) {
+		truncated++;
+	}
+}
+
+static isc_threadresult_t
+receiver(isc_threadarg_t arg) {
+	struct pollfd pfds[MAX_SOCKETS];
+	unsigned char buf[65536];
+
+	UNUSED(arg);
+
+	for (unsigned int i = 0; i < nsockets; i++) {
+		pfds[i] = (struct pollfd){ .fd = fds[i], .events = POLLIN };
+	}
+
+	while (!atomic_load(&done)) {
+		if (poll(pfds, nsockets, 100) <= 0) {
+			continue;
+		}
+		for (unsigned int i = 0; i < nsockets; i++) {
+			ssize_t n;
+
+			if ((pfds[i].revents & POLLIN) == 0) {
+				continue;
+			}
+			n = recv(fds[i], buf, sizeof(buf), MSG_DONTWAIT);
+			while (n >= 0) {
+				response(i, buf, n, now_ns());
+				n = recv(fds[i], buf, sizeof(buf),
+					 MSG_DONTWAIT);
+			}
+		}
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+static void
+wait_until(uint64_t when) {
+	uint64_t now = now_ns();
+
+	/*
+	 * Sleep for all but the last 50 microseconds, which are spent
+	 * spinning, to keep the spacing of the queries.
+	 */
+	if (when > now + 50000) {
+		uint64_t ns = when - now - 50000;
+		struct timespec ts = { .tv_sec = ns / 1000000000,
+				       .tv_nsec = ns % 1000000000 };
+
+		nanosleep(&ts, NULL);
+	}
+	while (now_ns() < when) {
+		/* spin */;
+	}
+}
+
+static uint64_t
+replay(void) {
+	unsigned char buf[65536];
+	uint64_t start = now_ns(), last;
+
+	for (size_t i = 0; i < nqueries; i++) {
+		query_t *q = &queries[i];
+		unsigned int s = i % nsockets;
+		unsigned int id = (i / nsockets) & 0xffff;
+
+		if (speed > 0) {
+			wait_until(start + (uint64_t)(q->when / speed));
+		}
+
+		memmove(buf, wires + q->offset, q->length);
+		buf[0] = id >> 8;
+		buf[1] = id & 0xff;
+
+		/*
+		 * A query whose ID is about to be reused has not been
+		 * answered for as long as it took to send 65536 more
+		 * queries on the same socket; consider it lost.
+		 */
+		if (atomic_exchange(&sent[s * 65536 + id], now_ns()) != 0) {
+			lost++;
+		} else {
+			atomic_fetch_add(&outstanding, 1);
+		}
+
+		if (send(fds[s], buf, q->length, 0) < 0) {
+			senderrors++;
+		}
+	}
+
+	/* Wait for the last responses. */
+	last = now_ns();
+	while (atomic_load(&outstanding) > 0 && now_ns() - last < timeout) {
+		struct timespec ts = { .tv_nsec = 10000000 };
+		nanosleep(&ts, NULL);
+	}
+
+	return (ISC_MAX(last - start, 1));
+}
+
+/*
+ * Statistics channel.
+ */
+
+typedef struct counters {
+	uint64_t authans;
+	uint64_t nonauthans;
+	uint64_t recursion;
+	uint64_t upstream;
+} counters_t;
+
+/*
+ * Add up every occurrence of the counter 'key' in the JSON document;
+ * resolver counters appear once per view.
+ */
+static uint64_t
+json_counter(const char *json, const char *key) {
+	char pattern[64];
+	uint64_t total = 0;
+
+	snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+	for (const char *p = strstr(json, pattern); p != NULL;
+	     p = strstr(p, pattern))
+	{
+		p += strlen(pattern);
+		while (*p == ' ') {
+			p++;
+		}
+		total += strtoull(p, NULL, 10);
+	}
+
+	return (total);
+}
+
+static void
+get_counters(counters_t *counters) {
+	const char *request = "GET /json/v1/server HTTP/1.0\r\n"
+			      "Connection: close\r\n\r\n";
+	char *body = NULL;
+	size_t size = 65536, used = 0;
+	ssize_t n;
+	int fd;
+
+	*counters = (counters_t){ 0 };
+
+	fd = socket(isc_sockaddr_pf(&statsserver), SOCK_STREAM, 0);
+	if (fd < 0 ||
+	    connect(fd, &statsserver.type.sa, statsserver.length) < 0 ||
+	    send(fd, request, strlen(request), 0) < 0)
+	{
+		fatal("statistics channel: %s", strerror(errno));
+	}
+
+	body = malloc(size);
+	RUNTIME_CHECK(body != NULL);
+	while ((n = recv(fd, body + used, size - used - 1, 0)) > 0) {
+		used += n;
+		if (size - used == 1) {
+			size *= 2;
+			body = realloc(body, size);
+			RUNTIME_CHECK(body != NULL);
+		}
+	}
+	body[used] = '\0';
+	close(fd);
+
+	counters->authans = json_counter(body, "QryAuthAns");
+	counters->nonauthans = json_counter(body, "QryNoauthAns");
+	counters->recursion = json_counter(body, "QryRecursion");
+	counters->upstream = json_counter(body, "Queryv4") +
+			     json_counter(body, "Queryv6");
+
+	free(body);
+}
+
+/*
+ * Reporting.
+ */
+
+static int
+compare_latency(const void *a, const void *b) {
+	uint32_t la = *(const uint32_t *)a, lb = *(const uint32_t *)b;
+
+	return (la < lb ? -1 : (la > lb ? 1 : 0));
+}
+
+static double
+percentile(double p) {
+	size_t i = (size_t)(p / 100.0 * (received - 1));
+
+	return (latencies[i] / 1000.0);
+}
+
+static void
+report(uint64_t elapsed, counters_t *before, counters_t *after) {
+	static const char *rcodenames[] = { "NOERROR", "FORMERR", "SERVFAIL",
+					    "NXDOMAIN", "NOTIMP", "REFUSED" };
+	uint64_t sentcount = nqueries - senderrors;
+
+	lost += atomic_load(&outstanding) + late;
+
+	printf("Queries sent:         %" PRIu64 "\n", sentcount);
+	printf("Responses received:   %" PRIu64 "\n", received);
+	printf("Queries lost:         %" PRIu64 " (%.2f%%)\n", lost,
+	       100.0 * lost / ISC_MAX(sentcount, 1));
+	if (senderrors != 0) {
+		printf("Send errors:          %" PRIu64 "\n", senderrors);
+	}
+	if (unexpected != 0) {
+		printf("Unexpected responses: %" PRIu64 "\n", unexpected);
+	}
+	printf("Run time (s):         %.3f\n", elapsed / 1e9);
+	printf("Queries per second:   %.1f\n", sentcount * 1e9 / elapsed);
+
+	if (received > 0) {
+		qsort(latencies, received, sizeof(latencies[0]),
+		      compare_latency);
+		printf("Latency (ms):         p50 %.3f, p90 %.3f, p99 %.3f, "
+		       "p99.9 %.3f, max %.3f\n",
+		       percentile(50), percentile(90), percentile(99),
+		       percentile(99.9), latencies[received - 1] / 1000.0);
+	}
+
+	printf("Response codes:      ");
+	for (size_t i = 0; i < ARRAY_SIZE(rcodes); i++) {
+		if (rcodes[i] == 0) {
+			continue;
+		}
+		if (i < ARRAY_SIZE(rcodenames)) {
+			printf(" %s %" PRIu64, rcodenames[i], rcodes[i]);
+		} else {
+			printf(" RCODE%zu %" PRIu64, i, rcodes[i]);
+		}
+	}
+	printf("\n");
+	printf("Authoritative (AA):   %" PRIu64 "\n", authoritative);
+	printf("Referrals:            %" PRIu64 "\n", referrals);
+	printf("Truncated (TC):       %" PRIu64 "\n", truncated);
+
+	if (statsenabled) {
+		uint64_t recursion = after->recursion - before->recursion;
+		uint64_t nonauth = after->nonauthans - before->nonauthans;
+		uint64_t upstream = after->upstream - before->upstream;
+
+		printf("Answer sources (from the statistics channel):\n");
+		printf("  authoritative:      %" PRIu64 "\n",
+		       after->authans - before->authans);
+		printf("  cache:              %" PRIu64 "\n",
+		       nonauth > recursion ? nonauth - recursion : 0);
+		printf("  recursion:          %" PRIu64 "\n", recursion);
+		printf("Upstream queries:     %" PRIu64
+		       " (%.3f per query replayed)\n",
+		       upstream, (double)upstream / ISC_MAX(sentcount, 1));
+	}
+}
+
+static void
+parse_sockaddr(const char *input, in_port_t port, isc_sockaddr_t *sa) {
+	struct in6_addr in6;
+	struct in_addr in;
+
+	if (inet_pton(AF_INET6, input, &in6) == 1) {
+		isc_sockaddr_fromin6(sa, &in6, port);
+	} else if (inet_pton(AF_INET, input, &in) == 1) {
+		isc_sockaddr_fromin(sa, &in, port);
+	} else {
+		fatal("bad address '%s'", input);
+	}
+}
+
+static void
+usage(void) {
+	fprintf(stderr,
+		"usage: replay [-a address] [-p port] [-s speed] [-c sockets]\n"
+		"              [-t timeout] [-S statsport] file\n"
+		"  -s 0 sends the queries as fast as possible\n");
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char **argv) {
+	const char *address = "127.0.0.1";
+	in_port_t port = 53, statsport = 0;
+	counters_t before = { 0 }, after = { 0 };
+	isc_thread_t thread;
+	uint64_t elapsed;
+	int c;
+
+	while (true) {
+		static struct option long_options[] = {
+			{ "address", required_argument, NULL, 'a' },
+			{ "port", required_argument, NULL, 'p' },
+			{ "speed", required_argument, NULL, 's' },
+			{ "sockets", required_argument, NULL, 'c' },
+			{ "timeout", required_argument, NULL, 't' },
+			{ "stats-port", required_argument, NULL, 'S' },
+			{ 0, 0, NULL, 0 }
+		};
+		int option_index = 0;
+
+		c = getopt_long(argc, argv, "a:c:p:s:S:t:", long_options,
+				&option_index);
+		if (c == -1) {
+			break;
+		}
+
+		switch (c) {
+		case 'a':
+			address = optarg;
+			break;
+		case 'c':
+			nsockets = strtoul(optarg, NULL, 10);
+			if (nsockets == 0 || nsockets > MAX_SOCKETS) {
+				usage();
+			}
+			break;
+		case 'p':
+			port = strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			speed = strtod(optarg, NULL);
+			if (speed < 0) {
+				usage();
+			}
+			break;
+		case 'S':
+			statsport = strtoul(optarg, NULL, 10);
+			break;
+		case 't':
+			timeout = strtod(optarg, NULL) * 1e9;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc - 1) {
+		usage();
+	}
+
+	parse_sockaddr(address, port, &server);
+	if (statsport != 0) {
+		parse_sockaddr(address, statsport, &statsserver);
+		statsenabled = true;
+	}
+
+	isc_mem_create(&mctx);
+
+	read_queries(argv[optind]);
+	fprintf(stderr, "Replaying %zu queries at %gx speed\n", nqueries,
+		speed);
+
+	sent = calloc(nsockets * 65536, sizeof(sent[0]));
+	latencies = calloc(nqueries, sizeof(latencies[0]));
+	RUNTIME_CHECK(sent != NULL && latencies != NULL);
+
+	open_sockets();
+	if (statsenabled) {
+		get_counters(&before);
+	}
+
+	isc_thread_create(receiver, NULL, &thread);
+	elapsed = replay();
+	atomic_store(&done, true);
+	isc_thread_join(thread, NULL);
+
+	if (statsenabled) {
+		get_counters(&after);
+	}
+
+	report(elapsed, &before, &after);
+
+	for (unsigned int i = 0; i < nsockets; i++) {
+		close(fds[i]);
+	}
+	free(sent);
+	free(latencies);
+	free(queries);
+	free(wires);
+	isc_mem_destroy(&mctx);
+
+	return (EXIT_SUCCESS);
+}
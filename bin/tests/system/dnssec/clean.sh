@@ -110,6 +110,7 @@ rm -f ./signer/*.signed.post*
 rm -f ./signer/*.signed.pre*
 rm -f ./signer/example.db.after ./signer/example.db.before
 rm -f ./signer/example.db.changed
+rm -f ./signer/example.db.sorted ./signer/verify.out.* ./signer/example.db.resigned
 rm -f ./signer/general/dsset*
 rm -f ./signer/general/signed.zone
 rm -f ./signer/general/*.jnl
@@ -1725,6 +1725,25 @@ n=$((n+1))
 test "$ret" -eq 0 || echo_i "failed"
 status=$((status+ret))
 
+echo_i "checking dnssec-signzone -Y keeps unchanged signatures without verifying ($n)"
+ret=0
+(
+cd signer || exit 1
+$SIGNER -Sxt -o example -f example.db.signed example.db > signer.out.3
+$SIGNER -SxtY -o example -f example.db.resigned example.db.signed > signer.out.4
+$VERIFY -o example example.db.resigned > verify.out.$n 2>&1
+) || ret=1
+gen3=$(awk '/generated/ {print $3}' signer/signer.out.3)
+retain4=$(awk '/retained/ {print $3}' signer/signer.out.4)
+gen4=$(awk '/generated/ {print $3}' signer/signer.out.4)
+verified4=$(awk '/ successfully verified/ {print $4}' signer/signer.out.4)
+[ "$retain4" -eq "$gen3" ] || ret=1
+[ "$gen4" -eq 0 ] || ret=1
+[ "$verified4" -eq 0 ] || ret=1
+n=$((n+1))
+test "$ret" -eq 0 || echo_i "failed"
+status=$((status+ret))
+
 echo_i "checking dnssec-signzone purges RRSIGs from formerly-owned glue (nsec) ($n)"
 ret=0
 (
@@ -1828,6 +1847,26 @@ n=$((n+1))
 test "$ret" -eq 0 || echo_i "failed"
 status=$((status+ret))
 
+echo_i "checking dnssec-signzone -B signs a sorted zone in windows ($n)"
+ret=0
+(
+cd signer || exit 1
+$CHECKZONE -D -q -o example.db.sorted example example.db
+$SIGNER -P -n 1 -O full -f signer.out.10 -S -o example example.db.sorted > /dev/null
+$SIGNER -P -B 2 -O full -f signer.out.11 -S -o example example.db.sorted > /dev/null
+$VERIFY -o example signer.out.11 > verify.out.$n 2>&1 || exit 1
+# NSEC3 chains cannot be streamed
+$SIGNER -P -B 2 -3 - -S -o example -f signer.out.12 example.db.sorted > /dev/null 2>&1 && exit 1
+exit 0
+) || ret=1
+awk '/^;/ { next; } $4 != "RRSIG" { print; }' signer/signer.out.10 > signer/signer.out.10.records
+awk '/^;/ { next; } $4 != "RRSIG" { print; }' signer/signer.out.11 > signer/signer.out.11.records
+diff signer/signer.out.10.records signer/signer.out.11.records > /dev/null || ret=1
+[ "$(grep -c RRSIG signer/signer.out.10)" -eq "$(grep -c RRSIG signer/signer.out.11)" ] || ret=1
+n=$((n+1))
+test "$ret" -eq 0 || echo_i "failed"
+status=$((status+ret))
+
 echo_i "checking dnssec-signzone -N date ($n)"
 ret=0
 (
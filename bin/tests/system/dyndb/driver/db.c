@@ -582,6 +582,8 @@ static dns_dbmethods_t sampledb_methods = {
 	NULL,		      /* setservestalerefresh */
 	NULL,		      /* getservestalerefresh */
 	NULL,		      /* setgluecachestats */
+	NULL,		      /* setevictionpolicy */
+	NULL,		      /* getmemory */
 };
 
 /* Auxiliary driver functions. */
@@ -32,6 +32,11 @@ do
 	esac
 	$VERIFY ${only} -o $zone $file > verify.out.$n 2>&1 || ret=1
 	[ $ret = 0 ] || failed
+	n=$((n+1))
+	echo_i "checking supposedly good zone using one thread: $zone ($n)"
+	ret=0
+	$VERIFY -n 1 ${only} -o $zone $file > verify.out.$n 2>&1 || ret=1
+	[ $ret = 0 ] || failed
 done
 
 for file in zones/*.bad
@@ -12,6 +12,7 @@
  */
 
 #include <getopt.h>
+#include <inttypes.h>
 #include <netinet/in.h>
 #include <signal.h>
 #include <stdbool.h>
@@ -19,6 +20,7 @@
 #include <stdlib.h>
 #include <strings.h>
 
+#include <isc/atomic.h>
 #include <isc/managers.h>
 #include <isc/mem.h>
 #include <isc/netaddr.h>
@@ -42,6 +44,8 @@ static in_port_t port;
 static isc_netaddr_t netaddr;
 static isc_sockaddr_t sockaddr __attribute__((unused));
 static int workers;
+static bool authoritative = false;
+static atomic_uint_fast64_t answered = 0;
 
 static isc_tlsctx_t *tls_ctx = NULL;
 
@@ -127,16 +131,21 @@ parse_options(int argc, char **argv) {
 			{ "address", required_argument, NULL, 'a' },
 			{ "protocol", required_argument, NULL, 'P' },
 			{ "workers", required_argument, NULL, 'w' },
+			{ "authoritative", no_argument, NULL, 'A' },
 			{ 0, 0, NULL, 0 }
 		};
 
-		c = getopt_long(argc, argv, "a:p:P:w:", long_options,
+		c = getopt_long(argc, argv, "Aa:p:P:w:", long_options,
 				&option_index);
 		if (c == -1) {
 			break;
 		}
 
 		switch (c) {
+		case 'A':
+			authoritative = true;
+			break;
+
 		case 'a':
 			RUNTIME_CHECK(parse_address(optarg) == ISC_R_SUCCESS);
 			break;
@@ -162,8 +171,8 @@ parse_options(int argc, char **argv) {
 
 	isc_sockaddr_format(&sockaddr, buf, sizeof(buf));
 
-	printf("Will listen at %s://%s, %d workers\n", protocols[protocol], buf,
-	       workers);
+	printf("Will listen at %s://%s, %d workers%s\n", protocols[protocol],
+	       buf, workers, authoritative ? ", authoritative" : "");
 }
 
 static void
@@ -194,6 +203,115 @@ test_server_yield(void) {
 	fprintf(stderr, "Shutting down...\n");
 }
 
+static void
+put16(unsigned char *p, unsigned int value) {
+	p[0] = value >> 8;
+	p[1] = value & 0xff;
+}
+
+/*
+ * Append a resource record owned by the name at offset 'owner' of the
+ * message, with a TTL of one hour.
+ */
+static unsigned char *
+add_rr(unsigned char *p, unsigned int owner, unsigned int type,
+       const unsigned char *rdata, unsigned int rdlen) {
+	put16(p, 0xc000 | owner);
+	put16(p + 2, type);
+	put16(p + 4, 1); /* IN */
+	put16(p + 6, 0);
+	put16(p + 8, 3600);
+	put16(p + 10, rdlen);
+	memmove(p + 12, rdata, rdlen);
+
+	return (p + 12 + rdlen);
+}
+
+/*
+ * In authoritative mode, answer every query as if this server were
+ * authoritative for all names: A and AAAA queries get an address from
+ * the documentation prefixes, NS queries get "ns.fake." with the
+ * listening address as glue, and other types get an empty answer.
+ * That is enough for a resolver which has this server as its only
+ * root server to resolve any name without network access.
+ */
+static isc_region_t *
+make_answer(isc_region_t *query) {
+	static const unsigned char a[] = { 192, 0, 2, 1 };
+	static const unsigned char aaaa[] = {
+		0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1
+	};
+	static const unsigned char ns[] = { 2, 'n', 's', 4, 'f', 'a', 'k', 'e',
+					    0 };
+	const unsigned char *msg = query->base;
+	unsigned char buf[1024];
+	unsigned char *p = NULL;
+	isc_region_t *reply = NULL;
+	unsigned int qend = 12, qtype, ancount = 0, arcount = 0;
+
+	if (query->length < 12 || (msg[2] & 0x80) != 0 || msg[4] != 0 ||
+	    msg[5] != 1)
+	{
+		return (NULL);
+	}
+	while (qend < query->length && msg[qend] != 0) {
+		if (msg[qend] > 63) {
+			return (NULL);
+		}
+		qend += msg[qend] + 1;
+	}
+	qend += 5;
+	if (qend > query->length) {
+		return (NULL);
+	}
+	qtype = msg[qend - 4] << 8 | msg[qend - 3];
+
+	memmove(buf, msg, qend);
+	p = buf + qend;
+	switch (qtype) {
+	case 1: /* A */
+		p = add_rr(p, 12, qtype, a, sizeof(a));
+		ancount++;
+		break;
+	case 28: /* AAAA */
+		p = add_rr(p, 12, qtype, aaaa, sizeof(aaaa));
+		ancount++;
+		break;
+	case 2: { /* NS */
+		unsigned int target = p - buf + 12;
+
+		p = add_rr(p, 12, qtype, ns, sizeof(ns));
+		ancount++;
+		if (netaddr.family == AF_INET) {
+			p = add_rr(p, target, 1,
+				   (const unsigned char *)&netaddr.type.in, 4);
+		} else {
+			p = add_rr(p, target, 28,
+				   (const unsigned char *)&netaddr.type.in6,
+				   16);
+		}
+		arcount++;
+		break;
+	}
+	default:
+		break;
+	}
+
+	/* QR, the opcode, AA and RD; no RA, NOERROR. */
+	buf[2] = 0x80 | (msg[2] & 0x79) | 0x04;
+	buf[3] = 0;
+	put16(buf + 6, ancount);
+	put16(buf + 8, 0);
+	put16(buf + 10, arcount);
+
+	reply = isc_mem_get(mctx, sizeof(isc_region_t) + (p - buf));
+	reply->length = p - buf;
+	reply->base = (uint8_t *)reply + sizeof(isc_region_t);
+	memmove(reply->base, buf, reply->length);
+
+	return (reply);
+}
+
 static void
 read_cb(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
 	void *cbarg) {
@@ -203,6 +321,15 @@ read_cb(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
 	REQUIRE(eresult == ISC_R_SUCCESS);
 	UNUSED(cbarg);
 
+	if (authoritative) {
+		reply = make_answer(region);
+		if (reply != NULL) {
+			atomic_fetch_add_relaxed(&answered, 1);
+			isc_nm_send(handle, reply, send_cb, reply);
+		}
+		return;
+	}
+
 	fprintf(stderr, "RECEIVED %u bytes\n", region->length);
 
 	if (region->length >= 12) {
@@ -288,6 +415,11 @@ run(void) {
 
 	test_server_yield();
 
+	if (authoritative) {
+		fprintf(stderr, "Answered %" PRIuFAST64 " queries\n",
+			atomic_load_relaxed(&answered));
+	}
+
 	isc_nm_stoplistening(sock);
 	isc_nmsocket_close(&sock);
 }
@@ -14,16 +14,21 @@
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <time.h>
 
+#include <isc/atomic.h>
 #include <isc/buffer.h>
 #include <isc/commandline.h>
+#include <isc/dir.h>
 #include <isc/file.h>
 #include <isc/mem.h>
 #include <isc/print.h>
 #include <isc/result.h>
 #include <isc/string.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 
+#include <dns/compress.h>
 #include <dns/message.h>
 
 int parseflags = 0;
@@ -31,6 +36,31 @@ isc_mem_t *mctx = NULL;
 bool printmemstats = false;
 bool dorender = false;
 
+/*
+ * Throughput mode: every message of the input is parsed, converted to
+ * text and rendered and parsed again, 'iterations' times over, by
+ * 'nthreads' threads.  The time spent in each operation is summed over
+ * all threads and reported per message.
+ */
+typedef struct {
+	unsigned char *base;
+	unsigned int length;
+} wiremsg_t;
+
+typedef struct {
+	uint64_t parse;
+	uint64_t totext;
+	uint64_t render;
+	uint64_t messages;
+	uint64_t errors;
+} benchstats_t;
+
+static wiremsg_t *messages = NULL;
+static size_t nmessages = 0;
+static size_t messagesalloc = 0;
+static unsigned int iterations = 1;
+static atomic_size_t nextmessage = 0;
+
 static void
 process_message(isc_buffer_t *source);
 
@@ -64,15 +94,394 @@ static void
 usage(void) {
 	fprintf(stderr, "wire_test [-b] [-d] [-p] [-r] [-s]\n");
 	fprintf(stderr, "          [-m {usage|trace|record|size|mctx}]\n");
-	fprintf(stderr, "          [filename]\n\n");
+	fprintf(stderr, "          [filename]\n");
+	fprintf(stderr, "wire_test -B [-b] [-d] [-p] [-t] [-n iterations]\n");
+	fprintf(stderr, "          [-T threads] {file|directory} ...\n\n");
+	fprintf(stderr, "\t-B\tThroughput mode: time parsing, rendering "
+			"and\n\t\tconversion to text of all messages\n");
 	fprintf(stderr, "\t-b\tBest-effort parsing (ignore some errors)\n");
 	fprintf(stderr, "\t-d\tRead input as raw binary data\n");
+	fprintf(stderr, "\t-n\tNumber of passes over the messages (-B)\n");
 	fprintf(stderr, "\t-p\tPreserve order of the records in messages\n");
 	fprintf(stderr, "\t-r\tAfter parsing, re-render the message\n");
 	fprintf(stderr, "\t-s\tPrint memory statistics\n");
+	fprintf(stderr, "\t-T\tNumber of threads (-B)\n");
 	fprintf(stderr, "\t-t\tTCP mode - ignore the first 2 bytes\n");
 }
 
+static void
+read_input(FILE *f, bool rawdata, isc_buffer_t **inputp) {
+	isc_result_t result;
+	uint8_t c;
+
+	if (rawdata) {
+		while (fread(&c, 1, 1, f) != 0) {
+			result = isc_buffer_reserve(inputp, 1);
+			RUNTIME_CHECK(result == ISC_R_SUCCESS);
+			isc_buffer_putuint8(*inputp, (uint8_t)c);
+		}
+	} else {
+		char s[BUFSIZ];
+
+		while (fgets(s, sizeof(s), f) != NULL) {
+			char *rp = s, *wp = s;
+			size_t i, len = 0;
+
+			while (*rp != '\0') {
+				if (*rp == '#') {
+					break;
+				}
+				if (*rp != ' ' && *rp != '\t' && *rp != '\r' &&
+				    *rp != '\n') {
+					*wp++ = *rp;
+					len++;
+				}
+				rp++;
+			}
+			if (len == 0U) {
+				continue;
+			}
+			if (len % 2 != 0U) {
+				fprintf(stderr, "bad input format: %lu\n",
+					(unsigned long)len);
+				exit(1);
+			}
+
+			rp = s;
+			for (i = 0; i < len; i += 2) {
+				c = fromhex(*rp++);
+				c *= 16;
+				c += fromhex(*rp++);
+				result = isc_buffer_reserve(inputp, 1);
+				RUNTIME_CHECK(result == ISC_R_SUCCESS);
+				isc_buffer_putuint8(*inputp, (uint8_t)c);
+			}
+		}
+	}
+}
+
+static isc_result_t
+render_message(dns_message_t *message, isc_buffer_t *buffer) {
+	isc_result_t result;
+	dns_compress_t cctx;
+	int i;
+
+	/*
+	 * XXXMLG
+	 * Changing this here is a hack, and should not be done in
+	 * reasonable application code, ever.
+	 */
+	message->from_to_wire = DNS_MESSAGE_INTENTRENDER;
+
+	for (i = 0; i < DNS_SECTION_MAX; i++) {
+		message->counts[i] = 0; /* Another hack XXX */
+	}
+
+	result = dns_compress_init(&cctx, mctx);
+	if (result != ISC_R_SUCCESS) {
+		goto done;
+	}
+
+	result = dns_message_renderbegin(message, &cctx, buffer);
+	for (i = DNS_SECTION_QUESTION;
+	     result == ISC_R_SUCCESS && i < DNS_SECTION_MAX; i++)
+	{
+		result = dns_message_rendersection(message, i, 0);
+	}
+	if (result == ISC_R_SUCCESS) {
+		result = dns_message_renderend(message);
+	}
+
+	dns_compress_invalidate(&cctx);
+
+done:
+	message->from_to_wire = DNS_MESSAGE_INTENTPARSE;
+	return (result);
+}
+
+static void
+add_message(unsigned char *base, unsigned int length) {
+	if (nmessages == messagesalloc) {
+		size_t newalloc = messagesalloc == 0 ? 1024
+						     : messagesalloc * 2;
+		wiremsg_t *newmessages =
+			isc_mem_get(mctx, newalloc * sizeof(newmessages[0]));
+
+		if (messages != NULL) {
+			memmove(newmessages, messages,
+				nmessages * sizeof(messages[0]));
+			isc_mem_put(mctx, messages,
+				    messagesalloc * sizeof(messages[0]));
+		}
+		messages = newmessages;
+		messagesalloc = newalloc;
+	}
+
+	messages[nmessages].base = isc_mem_get(mctx, length);
+	memmove(messages[nmessages].base, base, length);
+	messages[nmessages].length = length;
+	nmessages++;
+}
+
+/*
+ * Split the contents of one input file into messages: a stream of
+ * length-prefixed messages in TCP mode, a single message otherwise.
+ */
+static void
+load_file(const char *filename, bool rawdata, bool tcp) {
+	isc_buffer_t *input = NULL;
+	FILE *f;
+
+	f = fopen(filename, "r");
+	if (f == NULL) {
+		fprintf(stderr, "%s: fopen failed\n", filename);
+		exit(1);
+	}
+
+	isc_buffer_allocate(mctx, &input, 64 * 1024);
+	read_input(f, rawdata, &input);
+	fclose(f);
+
+	if (!tcp) {
+		if (isc_buffer_remaininglength(input) != 0) {
+			add_message(isc_buffer_current(input),
+				    isc_buffer_remaininglength(input));
+		}
+		isc_buffer_free(&input);
+		return;
+	}
+
+	while (isc_buffer_remaininglength(input) != 0) {
+		unsigned int tcplen;
+
+		if (isc_buffer_remaininglength(input) < 2) {
+			fprintf(stderr, "%s: premature end of packet\n",
+				filename);
+			exit(1);
+		}
+		tcplen = isc_buffer_getuint16(input);
+
+		if (isc_buffer_remaininglength(input) < tcplen) {
+			fprintf(stderr, "%s: premature end of packet\n",
+				filename);
+			exit(1);
+		}
+		add_message(isc_buffer_current(input), tcplen);
+		isc_buffer_forward(input, tcplen);
+	}
+	isc_buffer_free(&input);
+}
+
+/*
+ * Load a file, or every file in a directory such as a fuzzing corpus.
+ */
+static void
+load_path(const char *path, bool rawdata, bool tcp) {
+	isc_dir_t dir;
+	isc_result_t result;
+	char filename[PATH_MAX];
+
+	if (isc_file_isdirectory(path) != ISC_R_SUCCESS) {
+		load_file(path, rawdata, tcp);
+		return;
+	}
+
+	isc_dir_init(&dir);
+	result = isc_dir_open(&dir, path);
+	if (result != ISC_R_SUCCESS) {
+		fprintf(stderr, "%s: %s\n", path, isc_result_totext(result));
+		exit(1);
+	}
+	while (isc_dir_read(&dir) == ISC_R_SUCCESS) {
+		int n;
+
+		if (dir.entry.name[0] == '.') {
+			continue;
+		}
+		n = snprintf(filename, sizeof(filename), "%s/%s", path,
+			     dir.entry.name);
+		if (n < 0 || (size_t)n >= sizeof(filename)) {
+			fprintf(stderr, "%s/%s: name too long\n", path,
+				dir.entry.name);
+			exit(1);
+		}
+		if (isc_file_isplainfile(filename) == ISC_R_SUCCESS) {
+			load_file(filename, rawdata, tcp);
+		}
+	}
+	isc_dir_close(&dir);
+}
+
+static uint64_t
+now(void) {
+	struct timespec ts;
+
+	RUNTIME_CHECK(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+static isc_result_t
+parse_wire(isc_buffer_t *source, dns_message_t **messagep) {
+	isc_result_t result;
+
+	dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE, messagep);
+	result = dns_message_parse(*messagep, source, parseflags);
+	if (result == DNS_R_RECOVERABLE) {
+		result = ISC_R_SUCCESS;
+	}
+	if (result != ISC_R_SUCCESS) {
+		dns_message_detach(messagep);
+	}
+
+	return (result);
+}
+
+static isc_threadresult_t
+bench_worker(isc_threadarg_t arg) {
+	benchstats_t *stats = (benchstats_t *)arg;
+	size_t total = nmessages * iterations;
+	size_t textlen = 64 * 1024;
+	unsigned char *text = isc_mem_get(mctx, textlen);
+	unsigned char *wire = isc_mem_get(mctx, 64 * 1024);
+
+	for (;;) {
+		size_t i = atomic_fetch_add_relaxed(&nextmessage, 1);
+		dns_message_t *message = NULL;
+		isc_buffer_t source, target;
+		isc_result_t result;
+		uint64_t t0, t1, t2, t3;
+
+		if (i >= total) {
+			break;
+		}
+		i %= nmessages;
+
+		/*
+		 * Parse.
+		 */
+		isc_buffer_init(&source, messages[i].base, messages[i].length);
+		isc_buffer_add(&source, messages[i].length);
+		t0 = now();
+		result = parse_wire(&source, &message);
+		t1 = now();
+		if (result != ISC_R_SUCCESS) {
+			stats->errors++;
+			continue;
+		}
+
+		/*
+		 * Convert to text.
+		 */
+		do {
+			isc_buffer_init(&target, text, textlen);
+			result = dns_message_totext(
+				message, &dns_master_style_debug, 0, &target);
+			if (result == ISC_R_NOSPACE) {
+				isc_mem_put(mctx, text, textlen);
+				textlen *= 2;
+				text = isc_mem_get(mctx, textlen);
+			}
+		} while (result == ISC_R_NOSPACE);
+		t2 = now();
+		if (result != ISC_R_SUCCESS) {
+			dns_message_detach(&message);
+			stats->errors++;
+			continue;
+		}
+
+		/*
+		 * Render and parse the rendered message again.
+		 */
+		isc_buffer_init(&target, wire, 64 * 1024);
+		result = render_message(message, &target);
+		dns_message_detach(&message);
+		if (result == ISC_R_SUCCESS) {
+			result = parse_wire(&target, &message);
+		}
+		if (message != NULL) {
+			dns_message_detach(&message);
+		}
+		t3 = now();
+		if (result != ISC_R_SUCCESS) {
+			stats->errors++;
+			continue;
+		}
+
+		stats->parse += t1 - t0;
+		stats->totext += t2 - t1;
+		stats->render += t3 - t2;
+		stats->messages++;
+	}
+
+	isc_mem_put(mctx, text, textlen);
+	isc_mem_put(mctx, wire, 64 * 1024);
+
+	return ((isc_threadresult_t)0);
+}
+
+static void
+benchmark(unsigned int nthreads) {
+	isc_thread_t *threads = NULL;
+	benchstats_t *stats = NULL;
+	benchstats_t sum = { 0 };
+	uint64_t start, elapsed;
+	double n;
+
+	if (nmessages == 0) {
+		fprintf(stderr, "no messages to process\n");
+		exit(1);
+	}
+
+	threads = isc_mem_get(mctx, nthreads * sizeof(threads[0]));
+	stats = isc_mem_get(mctx, nthreads * sizeof(stats[0]));
+	memset(stats, 0, nthreads * sizeof(stats[0]));
+
+	atomic_init(&nextmessage, 0);
+	start = now();
+	for (unsigned int i = 1; i < nthreads; i++) {
+		isc_thread_create(bench_worker, &stats[i], &threads[i]);
+	}
+	bench_worker(&stats[0]);
+	for (unsigned int i = 1; i < nthreads; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+	elapsed = now() - start;
+
+	for (unsigned int i = 0; i < nthreads; i++) {
+		sum.parse += stats[i].parse;
+		sum.totext += stats[i].totext;
+		sum.render += stats[i].render;
+		sum.messages += stats[i].messages;
+		sum.errors += stats[i].errors;
+	}
+
+	printf("messages:     %zu x %u iterations, %u threads\n", nmessages,
+	       iterations, nthreads);
+	printf("processed:    %" PRIu64 " (%" PRIu64 " failed)\n",
+	       sum.messages, sum.errors);
+	if (sum.messages != 0) {
+		n = (double)sum.messages;
+		printf("parse:        %10.1f ns/msg\n", sum.parse / n);
+		printf("totext:       %10.1f ns/msg\n", sum.totext / n);
+		printf("render+parse: %10.1f ns/msg\n", sum.render / n);
+	}
+	printf("wall time:    %10.3f s (%.0f msg/s)\n", elapsed / 1e9,
+	       elapsed != 0 ? (sum.messages + sum.errors) * 1e9 / elapsed
+			    : 0.0);
+
+	isc_mem_put(mctx, stats, nthreads * sizeof(stats[0]));
+	isc_mem_put(mctx, threads, nthreads * sizeof(threads[0]));
+
+	for (size_t i = 0; i < nmessages; i++) {
+		isc_mem_put(mctx, messages[i].base, messages[i].length);
+	}
+	if (messages != NULL) {
+		isc_mem_put(mctx, messages,
+			    messagesalloc * sizeof(messages[0]));
+	}
+}
+
 static isc_result_t
 printmessage(dns_message_t *msg) {
 	isc_buffer_t b;
@@ -107,12 +516,13 @@ main(int argc, char *argv[]) {
 	bool need_close = false;
 	bool tcp = false;
 	bool rawdata = false;
-	isc_result_t result;
-	uint8_t c;
+	bool bench = false;
+	unsigned int nthreads = 1;
+	char *endp = NULL;
 	FILE *f;
 	int ch;
 
-#define CMDLINE_FLAGS "bdm:prst"
+#define CMDLINE_FLAGS "Bbdm:n:prsT:t"
 	/*
 	 * Process memory debugging argument first.
 	 */
@@ -142,6 +552,9 @@ main(int argc, char *argv[]) {
 
 	while ((ch = isc_commandline_parse(argc, argv, CMDLINE_FLAGS)) != -1) {
 		switch (ch) {
+		case 'B':
+			bench = true;
+			break;
 		case 'b':
 			parseflags |= DNS_MESSAGEPARSE_BESTEFFORT;
 			break;
@@ -150,6 +563,15 @@ main(int argc, char *argv[]) {
 			break;
 		case 'm':
 			break;
+		case 'n':
+			iterations = strtoul(isc_commandline_argument, &endp,
+					     10);
+			if (*endp != '\0' || iterations == 0) {
+				fprintf(stderr, "bad iterations: %s\n",
+					isc_commandline_argument);
+				exit(1);
+			}
+			break;
 		case 'p':
 			parseflags |= DNS_MESSAGEPARSE_PRESERVEORDER;
 			break;
@@ -159,6 +581,15 @@ main(int argc, char *argv[]) {
 		case 's':
 			printmemstats = true;
 			break;
+		case 'T':
+			nthreads = strtoul(isc_commandline_argument, &endp,
+					   10);
+			if (*endp != '\0' || nthreads < 1 || nthreads > 512) {
+				fprintf(stderr, "bad number of threads: %s\n",
+					isc_commandline_argument);
+				exit(1);
+			}
+			break;
 		case 't':
 			tcp = true;
 			break;
@@ -171,6 +602,22 @@ main(int argc, char *argv[]) {
 	argc -= isc_commandline_index;
 	argv += isc_commandline_index;
 
+	if (bench) {
+		if (argc < 1) {
+			usage();
+			exit(1);
+		}
+		for (int i = 0; i < argc; i++) {
+			load_path(argv[i], rawdata, tcp);
+		}
+		benchmark(nthreads);
+		if (printmemstats) {
+			isc_mem_stats(mctx, stdout);
+		}
+		isc_mem_destroy(&mctx);
+		return (0);
+	}
+
 	if (argc >= 1) {
 		f = fopen(argv[0], "r");
 		if (f == NULL) {
@@ -184,50 +631,7 @@ main(int argc, char *argv[]) {
 
 	isc_buffer_allocate(mctx, &input, 64 * 1024);
 
-	if (rawdata) {
-		while (fread(&c, 1, 1, f) != 0) {
-			result = isc_buffer_reserve(&input, 1);
-			RUNTIME_CHECK(result == ISC_R_SUCCESS);
-			isc_buffer_putuint8(input, (uint8_t)c);
-		}
-	} else {
-		char s[BUFSIZ];
-
-		while (fgets(s, sizeof(s), f) != NULL) {
-			char *rp = s, *wp = s;
-			size_t i, len = 0;
-
-			while (*rp != '\0') {
-				if (*rp == '#') {
-					break;
-				}
-				if (*rp != ' ' && *rp != '\t' && *rp != '\r' &&
-				    *rp != '\n') {
-					*wp++ = *rp;
-					len++;
-				}
-				rp++;
-			}
-			if (len == 0U) {
-				continue;
-			}
-			if (len % 2 != 0U) {
-				fprintf(stderr, "bad input format: %lu\n",
-					(unsigned long)len);
-				exit(1);
-			}
-
-			rp = s;
-			for (i = 0; i < len; i += 2) {
-				c = fromhex(*rp++);
-				c *= 16;
-				c += fromhex(*rp++);
-				result = isc_buffer_reserve(&input, 1);
-				RUNTIME_CHECK(result == ISC_R_SUCCESS);
-				isc_buffer_putuint8(input, (uint8_t)c);
-			}
-		}
-	}
+	read_input(f, rawdata, &input);
 
 	if (need_close) {
 		fclose(f);
@@ -267,7 +671,6 @@ static void
 process_message(isc_buffer_t *source) {
 	dns_message_t *message;
 	isc_result_t result;
-	int i;
 
 	message = NULL;
 	dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE, &message);
@@ -288,51 +691,12 @@ process_message(isc_buffer_t *source) {
 	if (dorender) {
 		unsigned char b2[64 * 1024];
 		isc_buffer_t buffer;
-		dns_compress_t cctx;
 
 		isc_buffer_init(&buffer, b2, sizeof(b2));
 
-		/*
-		 * XXXMLG
-		 * Changing this here is a hack, and should not be done in
-		 * reasonable application code, ever.
-		 */
-		message->from_to_wire = DNS_MESSAGE_INTENTRENDER;
-
-		for (i = 0; i < DNS_SECTION_MAX; i++) {
-			message->counts[i] = 0; /* Another hack XXX */
-		}
-
-		result = dns_compress_init(&cctx, mctx);
-		CHECKRESULT(result, "dns_compress_init() failed");
-
-		result = dns_message_renderbegin(message, &cctx, &buffer);
-		CHECKRESULT(result, "dns_message_renderbegin() failed");
-
-		result = dns_message_rendersection(message,
-						   DNS_SECTION_QUESTION, 0);
-		CHECKRESULT(result, "dns_message_rendersection(QUESTION) "
-				    "failed");
-
-		result = dns_message_rendersection(message, DNS_SECTION_ANSWER,
-						   0);
-		CHECKRESULT(result, "dns_message_rendersection(ANSWER) failed");
-
-		result = dns_message_rendersection(message,
-						   DNS_SECTION_AUTHORITY, 0);
-		CHECKRESULT(result, "dns_message_rendersection(AUTHORITY) "
-				    "failed");
-
-		result = dns_message_rendersection(message,
-						   DNS_SECTION_ADDITIONAL, 0);
-		CHECKRESULT(result, "dns_message_rendersection(ADDITIONAL) "
-				    "failed");
-
-		dns_message_renderend(message);
-
-		dns_compress_invalidate(&cctx);
+		result = render_message(message, &buffer);
+		CHECKRESULT(result, "render_message() failed");
 
-		message->from_to_wire = DNS_MESSAGE_INTENTPARSE;
 		dns_message_detach(&message);
 
 		printf("Message rendered.\n");
@@ -35,14 +35,19 @@
 
 #include <protobuf-c/protobuf-c.h>
 
+#include <isc/atomic.h>
 #include <isc/attributes.h>
 #include <isc/buffer.h>
 #include <isc/commandline.h>
 #include <isc/hex.h>
 #include <isc/mem.h>
+#include <isc/net.h>
+#include <isc/netaddr.h>
+#include <isc/os.h>
 #include <isc/print.h>
 #include <isc/result.h>
 #include <isc/string.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 
 #include <dns/dnstap.h>
@@ -50,6 +55,10 @@
 #include <dns/masterdump.h>
 #include <dns/message.h>
 #include <dns/name.h>
+#include <dns/rcode.h>
+#include <dns/rdataclass.h>
+#include <dns/rdatatype.h>
+#include <dns/time.h>
 
 #include "dnstap.pb-c.h"
 
@@ -61,6 +70,82 @@ bool yaml = false;
 
 const char *program = "dnstap-read";
 
+/*
+ * Frame filters.  All of the filters given must match for a frame to be
+ * printed.
+ */
+static dns_fixedname_t fsuffix;
+static dns_name_t *filter_suffix = NULL;
+static bool filter_hastype = false;
+static dns_rdatatype_t filter_type;
+static bool filter_hasrcode = false;
+static dns_rcode_t filter_rcode;
+static bool filter_hasclient = false;
+static isc_netaddr_t filter_client;
+static unsigned int filter_clientlen;
+static int64_t filter_begin = -1;
+static int64_t filter_end = -1;
+
+/*
+ * Output.  With -o, only the fields listed with -f are printed, one
+ * frame per line, and the DNS message is never fully parsed.
+ */
+typedef enum { output_text, output_csv, output_json } output_t;
+static output_t output = output_text;
+
+typedef enum {
+	field_time,
+	field_type,
+	field_protocol,
+	field_client,
+	field_clientport,
+	field_server,
+	field_serverport,
+	field_size,
+	field_id,
+	field_rcode,
+	field_qname,
+	field_qclass,
+	field_qtype,
+	field_max
+} field_t;
+
+static const char *fieldnames[field_max] = {
+	[field_time] = "time",		 [field_type] = "type",
+	[field_protocol] = "protocol",	 [field_client] = "client",
+	[field_clientport] = "cport",	 [field_server] = "server",
+	[field_serverport] = "sport",	 [field_size] = "size",
+	[field_id] = "id",		 [field_rcode] = "rcode",
+	[field_qname] = "qname",	 [field_qclass] = "qclass",
+	[field_qtype] = "qtype",
+};
+
+#define DEFAULT_FIELDS "time,type,client,qname,qtype,rcode"
+
+static field_t fields[field_max];
+static unsigned int nfields = 0;
+
+/*
+ * Frames are decoded in blocks of up to FRAME_BLOCK frames by up to
+ * 'nthreads' threads, and printed in file order once each block is
+ * done.
+ */
+#define FRAME_BLOCK 4096
+#define MAX_THREADS 512
+
+static unsigned int nthreads = 1;
+
+typedef struct frame {
+	isc_region_t input;
+	isc_buffer_t *text; /*%< NULL if the frame is not printed */
+} frame_t;
+
+typedef struct frameblock {
+	frame_t *frames;
+	size_t count;
+	atomic_size_t next;
+} frameblock_t;
+
 #define CHECKM(op, msg)                                               \
 	do {                                                          \
 		result = (op);                                        \
@@ -88,36 +173,42 @@ fatal(const char *format, ...) {
 
 static void
 usage(void) {
-	fprintf(stderr, "dnstap-read [-mpxy] [filename]\n");
+	fprintf(stderr, "dnstap-read [-mpxy] [-b time] [-c prefix] [-e time] "
+			"[-n suffix] [-r rcode] [-t type]\n"
+			"\t[-o csv|json] [-f fields] [-T nthreads] "
+			"[filename]\n");
 	fprintf(stderr, "\t-m\ttrace memory allocations\n");
 	fprintf(stderr, "\t-p\tprint the full DNS message\n");
 	fprintf(stderr, "\t-x\tuse hex format to print DNS message\n");
 	fprintf(stderr, "\t-y\tprint YAML format (implies -p)\n");
+	fprintf(stderr, "\t-b\tonly print frames from this time on\n");
+	fprintf(stderr, "\t-c\tonly print frames from clients in this "
+			"prefix\n");
+	fprintf(stderr, "\t-e\tonly print frames before this time\n");
+	fprintf(stderr, "\t-n\tonly print frames with a QNAME at or below "
+			"this name\n");
+	fprintf(stderr, "\t-r\tonly print responses with this RCODE\n");
+	fprintf(stderr, "\t-t\tonly print frames with this QTYPE\n");
+	fprintf(stderr, "\t-o\tprint selected fields in CSV or JSON lines "
+			"format\n");
+	fprintf(stderr, "\t-f\tcomma-separated fields to print with -o "
+			"(default " DEFAULT_FIELDS ")\n");
+	fprintf(stderr, "\t-T\tnumber of decoding threads\n");
 }
 
 static void
-print_dtdata(dns_dtdata_t *dt) {
+print_dtdata(dns_dtdata_t *dt, isc_buffer_t **bp) {
 	isc_result_t result;
-	isc_buffer_t *b = NULL;
-
-	isc_buffer_allocate(mctx, &b, 2048);
-	if (b == NULL) {
-		fatal("out of memory");
-	}
 
-	CHECKM(dns_dt_datatotext(dt, &b), "dns_dt_datatotext");
-	printf("%.*s\n", (int)isc_buffer_usedlength(b),
-	       (char *)isc_buffer_base(b));
+	CHECKM(dns_dt_datatotext(dt, bp), "dns_dt_datatotext");
+	isc_buffer_printf(*bp, "\n");
 
 cleanup:
-	if (b != NULL) {
-		isc_buffer_free(&b);
-	}
+	return;
 }
 
 static void
-print_hex(dns_dtdata_t *dt) {
-	isc_buffer_t *b = NULL;
+print_hex(dns_dtdata_t *dt, isc_buffer_t **bp) {
 	isc_result_t result;
 	size_t textlen;
 
@@ -126,71 +217,52 @@ print_hex(dns_dtdata_t *dt) {
 	}
 
 	textlen = (dt->msgdata.length * 2) + 1;
-	isc_buffer_allocate(mctx, &b, textlen);
-	if (b == NULL) {
-		fatal("out of memory");
-	}
+	CHECKM(isc_buffer_reserve(bp, textlen), "isc_buffer_reserve");
 
-	result = isc_hex_totext(&dt->msgdata, 0, "", b);
+	result = isc_hex_totext(&dt->msgdata, 0, "", *bp);
 	CHECKM(result, "isc_hex_totext");
 
-	printf("%.*s\n", (int)isc_buffer_usedlength(b),
-	       (char *)isc_buffer_base(b));
+	isc_buffer_printf(*bp, "\n");
 
 cleanup:
-	if (b != NULL) {
-		isc_buffer_free(&b);
-	}
+	return;
 }
 
 static void
-print_packet(dns_dtdata_t *dt, const dns_master_style_t *style) {
-	isc_buffer_t *b = NULL;
+print_packet(dns_dtdata_t *dt, const dns_master_style_t *style,
+	     isc_buffer_t **bp) {
 	isc_result_t result;
+	unsigned int used = isc_buffer_usedlength(*bp);
+	size_t textlen = 2048;
 
-	if (dt->msg != NULL) {
-		size_t textlen = 2048;
-
-		isc_buffer_allocate(mctx, &b, textlen);
-		if (b == NULL) {
-			fatal("out of memory");
-		}
+	if (dt->msg == NULL) {
+		return;
+	}
 
-		for (;;) {
-			isc_buffer_reserve(&b, textlen);
-			if (b == NULL) {
-				fatal("out of memory");
-			}
+	for (;;) {
+		CHECKM(isc_buffer_reserve(bp, textlen), "isc_buffer_reserve");
 
-			result = dns_message_totext(dt->msg, style, 0, b);
-			if (result == ISC_R_NOSPACE) {
-				isc_buffer_clear(b);
-				textlen *= 2;
-				continue;
-			} else if (result == ISC_R_SUCCESS) {
-				printf("%.*s", (int)isc_buffer_usedlength(b),
-				       (char *)isc_buffer_base(b));
-				isc_buffer_free(&b);
-			} else {
-				isc_buffer_free(&b);
-				CHECKM(result, "dns_message_totext");
-			}
-			break;
+		result = dns_message_totext(dt->msg, style, 0, *bp);
+		if (result == ISC_R_NOSPACE) {
+			isc_buffer_subtract(*bp,
+					    isc_buffer_usedlength(*bp) - used);
+			textlen *= 2;
+			continue;
 		}
+		CHECKM(result, "dns_message_totext");
+		break;
 	}
 
 cleanup:
-	if (b != NULL) {
-		isc_buffer_free(&b);
-	}
+	return;
 }
 
 static void
-print_yaml(dns_dtdata_t *dt) {
+print_yaml(dns_dtdata_t *dt, isc_buffer_t **bp) {
 	Dnstap__Dnstap *frame = dt->frame;
 	Dnstap__Message *m = frame->message;
 	const ProtobufCEnumValue *ftype, *mtype;
-	static bool first = true;
+	isc_buffer_t *b = *bp;
 
 	ftype = protobuf_c_enum_descriptor_get_value(
 		&dnstap__dnstap__type__descriptor, frame->type);
@@ -198,29 +270,25 @@ print_yaml(dns_dtdata_t *dt) {
 		return;
 	}
 
-	if (!first) {
-		printf("---\n");
-	} else {
-		first = false;
-	}
-
-	printf("type: %s\n", ftype->name);
+	isc_buffer_printf(b, "type: %s\n", ftype->name);
 
 	if (frame->has_identity) {
-		printf("identity: %.*s\n", (int)frame->identity.len,
-		       frame->identity.data);
+		isc_buffer_printf(b, "identity: %.*s\n",
+				  (int)frame->identity.len,
+				  frame->identity.data);
 	}
 
 	if (frame->has_version) {
-		printf("version: %.*s\n", (int)frame->version.len,
-		       frame->version.data);
+		isc_buffer_printf(b, "version: %.*s\n",
+				  (int)frame->version.len,
+				  frame->version.data);
 	}
 
 	if (frame->type != DNSTAP__DNSTAP__TYPE__MESSAGE) {
 		return;
 	}
 
-	printf("message:\n");
+	isc_buffer_printf(b, "message:\n");
 
 	mtype = protobuf_c_enum_descriptor_get_value(
 		&dnstap__message__type__descriptor, m->type);
@@ -228,24 +296,25 @@ print_yaml(dns_dtdata_t *dt) {
 		return;
 	}
 
-	printf("  type: %s\n", mtype->name);
+	isc_buffer_printf(b, "  type: %s\n", mtype->name);
 
 	if (!isc_time_isepoch(&dt->qtime)) {
 		char buf[100];
 		isc_time_formatISO8601(&dt->qtime, buf, sizeof(buf));
-		printf("  query_time: !!timestamp %s\n", buf);
+		isc_buffer_printf(b, "  query_time: !!timestamp %s\n", buf);
 	}
 
 	if (!isc_time_isepoch(&dt->rtime)) {
 		char buf[100];
 		isc_time_formatISO8601(&dt->rtime, buf, sizeof(buf));
-		printf("  response_time: !!timestamp %s\n", buf);
+		isc_buffer_printf(b, "  response_time: !!timestamp %s\n", buf);
 	}
 
 	if (dt->msgdata.base != NULL) {
-		printf("  message_size: %zub\n", (size_t)dt->msgdata.length);
+		isc_buffer_printf(b, "  message_size: %zub\n",
+				  (size_t)dt->msgdata.length);
 	} else {
-		printf("  message_size: 0b\n");
+		isc_buffer_printf(b, "  message_size: 0b\n");
 	}
 
 	if (m->has_socket_family) {
@@ -254,11 +323,13 @@ print_yaml(dns_dtdata_t *dt) {
 				&dnstap__socket_family__descriptor,
 				m->socket_family);
 		if (type != NULL) {
-			printf("  socket_family: %s\n", type->name);
+			isc_buffer_printf(b, "  socket_family: %s\n",
+					  type->name);
 		}
 	}
 
-	printf("  socket_protocol: %s\n", dt->tcp ? "TCP" : "UDP");
+	isc_buffer_printf(b, "  socket_protocol: %s\n",
+			  dt->tcp ? "TCP" : "UDP");
 
 	if (m->has_query_address) {
 		ProtobufCBinaryData *ip = &m->query_address;
@@ -266,7 +337,7 @@ print_yaml(dns_dtdata_t *dt) {
 
 		(void)inet_ntop(ip->len == 4 ? AF_INET : AF_INET6, ip->data,
 				buf, sizeof(buf));
-		printf("  query_address: \"%s\"\n", buf);
+		isc_buffer_printf(b, "  query_address: \"%s\"\n", buf);
 	}
 
 	if (m->has_response_address) {
@@ -275,71 +346,649 @@ print_yaml(dns_dtdata_t *dt) {
 
 		(void)inet_ntop(ip->len == 4 ? AF_INET : AF_INET6, ip->data,
 				buf, sizeof(buf));
-		printf("  response_address: \"%s\"\n", buf);
+		isc_buffer_printf(b, "  response_address: \"%s\"\n", buf);
 	}
 
 	if (m->has_query_port) {
-		printf("  query_port: %u\n", m->query_port);
+		isc_buffer_printf(b, "  query_port: %u\n", m->query_port);
 	}
 
 	if (m->has_response_port) {
-		printf("  response_port: %u\n", m->response_port);
+		isc_buffer_printf(b, "  response_port: %u\n",
+				  m->response_port);
 	}
 
 	if (m->has_query_zone) {
 		isc_result_t result;
 		dns_fixedname_t fn;
 		dns_name_t *name;
-		isc_buffer_t b;
+		isc_buffer_t zb;
 
 		name = dns_fixedname_initname(&fn);
 
-		isc_buffer_init(&b, m->query_zone.data, m->query_zone.len);
-		isc_buffer_add(&b, m->query_zone.len);
+		isc_buffer_init(&zb, m->query_zone.data, m->query_zone.len);
+		isc_buffer_add(&zb, m->query_zone.len);
 
-		result = dns_name_fromwire(name, &b, DNS_DECOMPRESS_NEVER, 0,
+		result = dns_name_fromwire(name, &zb, DNS_DECOMPRESS_NEVER, 0,
 					   NULL);
 		if (result == ISC_R_SUCCESS) {
-			printf("  query_zone: ");
-			dns_name_print(name, stdout);
-			printf("\n");
+			char namebuf[DNS_NAME_FORMATSIZE];
+
+			dns_name_format(name, namebuf, sizeof(namebuf));
+			isc_buffer_printf(b, "  query_zone: %s\n", namebuf);
 		}
 	}
 
 	if (dt->msg != NULL) {
 		dt->msg->indent.count = 2;
 		dt->msg->indent.string = "  ";
-		printf("  %s:\n", ((dt->type & DNS_DTTYPE_QUERY) != 0)
+		isc_buffer_printf(b, "  %s:\n",
+				  ((dt->type & DNS_DTTYPE_QUERY) != 0)
 					  ? "query_message_data"
 					  : "response_message_data");
 
-		print_packet(dt, &dns_master_style_yaml);
+		print_packet(dt, &dns_master_style_yaml, bp);
+
+		isc_buffer_printf(*bp, "  %s: |\n",
+				  ((dt->type & DNS_DTTYPE_QUERY) != 0)
+					  ? "query_message"
+					  : "response_message");
+		print_packet(dt, &dns_master_style_indent, bp);
+	}
+}
+
+/*
+ * Decode the question of the DNS message in 'dt' straight from the
+ * wire, without parsing the rest of the message.
+ */
+static bool
+get_question(dns_dtdata_t *dt, dns_name_t *name, dns_rdatatype_t *typep,
+	     dns_rdataclass_t *classp) {
+	isc_buffer_t b;
+	isc_result_t result;
+
+	if (dt->msgdata.length < DNS_MESSAGE_HEADERLEN) {
+		return (false);
+	}
+
+	/* QDCOUNT */
+	if (dt->msgdata.base[4] == 0 && dt->msgdata.base[5] == 0) {
+		return (false);
+	}
+
+	isc_buffer_init(&b, dt->msgdata.base, dt->msgdata.length);
+	isc_buffer_add(&b, dt->msgdata.length);
+	isc_buffer_forward(&b, DNS_MESSAGE_HEADERLEN);
+
+	result = dns_name_fromwire(name, &b, DNS_DECOMPRESS_NEVER, 0, NULL);
+	if (result != ISC_R_SUCCESS || isc_buffer_remaininglength(&b) < 4) {
+		return (false);
+	}
+
+	*typep = isc_buffer_getuint16(&b);
+	*classp = isc_buffer_getuint16(&b);
+	return (true);
+}
+
+static isc_time_t *
+frame_time(dns_dtdata_t *dt) {
+	return (dt->query ? &dt->qtime : &dt->rtime);
+}
+
+static bool
+frame_match(dns_dtdata_t *dt) {
+	if (filter_begin != -1 || filter_end != -1) {
+		isc_time_t *t = frame_time(dt);
+		int64_t when = isc_time_seconds(t);
+
+		if (isc_time_isepoch(t) ||
+		    (filter_begin != -1 && when < filter_begin) ||
+		    (filter_end != -1 && when >= filter_end))
+		{
+			return (false);
+		}
+	}
+
+	if (filter_hasclient) {
+		isc_netaddr_t na;
+
+		if (dt->qaddr.length == 4) {
+			struct in_addr in;
+
+			memmove(&in, dt->qaddr.base, sizeof(in));
+			isc_netaddr_fromin(&na, &in);
+		} else if (dt->qaddr.length == 16) {
+			struct in6_addr in6;
+
+			memmove(&in6, dt->qaddr.base, sizeof(in6));
+			isc_netaddr_fromin6(&na, &in6);
+		} else {
+			return (false);
+		}
+
+		if (!isc_netaddr_eqprefix(&na, &filter_client,
+					  filter_clientlen)) {
+			return (false);
+		}
+	}
+
+	if (filter_hasrcode) {
+		if (dt->query || dt->msgdata.length < DNS_MESSAGE_HEADERLEN ||
+		    (dt->msgdata.base[3] & 0x0f) != filter_rcode)
+		{
+			return (false);
+		}
+	}
+
+	if (filter_suffix != NULL || filter_hastype) {
+		dns_fixedname_t fn;
+		dns_name_t *name = dns_fixedname_initname(&fn);
+		dns_rdatatype_t type;
+		dns_rdataclass_t rdclass;
+
+		if (!get_question(dt, name, &type, &rdclass)) {
+			return (false);
+		}
+		if (filter_suffix != NULL &&
+		    !dns_name_issubdomain(name, filter_suffix)) {
+			return (false);
+		}
+		if (filter_hastype && type != filter_type) {
+			return (false);
+		}
+	}
+
+	return (true);
+}
+
+static const char *
+dttype_totext(dns_dtmsgtype_t type) {
+	switch (type) {
+	case DNS_DTTYPE_AQ:
+		return ("AQ");
+	case DNS_DTTYPE_AR:
+		return ("AR");
+	case DNS_DTTYPE_CQ:
+		return ("CQ");
+	case DNS_DTTYPE_CR:
+		return ("CR");
+	case DNS_DTTYPE_RQ:
+		return ("RQ");
+	case DNS_DTTYPE_RR:
+		return ("RR");
+	case DNS_DTTYPE_FQ:
+		return ("FQ");
+	case DNS_DTTYPE_FR:
+		return ("FR");
+	case DNS_DTTYPE_SQ:
+		return ("SQ");
+	case DNS_DTTYPE_SR:
+		return ("SR");
+	case DNS_DTTYPE_TQ:
+		return ("TQ");
+	case DNS_DTTYPE_TR:
+		return ("TR");
+	case DNS_DTTYPE_UQ:
+		return ("UQ");
+	case DNS_DTTYPE_UR:
+		return ("UR");
+	default:
+		return ("??");
+	}
+}
+
+static void
+put_address(isc_region_t *addr, char *buf, size_t len) {
+	buf[0] = '\0';
+	if (addr->length == 4 || addr->length == 16) {
+		(void)inet_ntop(addr->length == 4 ? AF_INET : AF_INET6,
+				addr->base, buf, len);
+	}
+}
+
+/*
+ * Format field 'f' of 'dt' into 'buf'.  Returns false if the frame has
+ * no value for it; '*quote' is set for string values.
+ */
+static bool
+format_field(dns_dtdata_t *dt, field_t f, char *buf, size_t len,
+	     bool *quote) {
+	dns_fixedname_t fn;
+	dns_name_t *name = NULL;
+	dns_rdatatype_t type;
+	dns_rdataclass_t rdclass;
+	isc_buffer_t b;
+
+	*quote = true;
+
+	switch (f) {
+	case field_time:
+		if (isc_time_isepoch(frame_time(dt))) {
+			return (false);
+		}
+		isc_time_formatISO8601us(frame_time(dt), buf, len);
+		return (true);
+	case field_type:
+		strlcpy(buf, dttype_totext(dt->type), len);
+		return (true);
+	case field_protocol:
+		strlcpy(buf, dt->tcp ? "TCP" : "UDP", len);
+		return (true);
+	case field_client:
+		put_address(&dt->qaddr, buf, len);
+		return (buf[0] != '\0');
+	case field_server:
+		put_address(&dt->raddr, buf, len);
+		return (buf[0] != '\0');
+	case field_clientport:
+		*quote = false;
+		snprintf(buf, len, "%u", dt->qport);
+		return (dt->qaddr.length != 0);
+	case field_serverport:
+		*quote = false;
+		snprintf(buf, len, "%u", dt->rport);
+		return (dt->raddr.length != 0);
+	case field_size:
+		*quote = false;
+		snprintf(buf, len, "%u", dt->msgdata.length);
+		return (true);
+	case field_id:
+		*quote = false;
+		if (dt->msgdata.length < DNS_MESSAGE_HEADERLEN) {
+			return (false);
+		}
+		snprintf(buf, len, "%u",
+			 (dt->msgdata.base[0] << 8) | dt->msgdata.base[1]);
+		return (true);
+	case field_rcode:
+		if (dt->msgdata.length < DNS_MESSAGE_HEADERLEN) {
+			return (false);
+		}
+		isc_buffer_init(&b, buf, len - 1);
+		if (dns_rcode_totext(dt->msgdata.base[3] & 0x0f, &b) !=
+		    ISC_R_SUCCESS)
+		{
+			return (false);
+		}
+		buf[isc_buffer_usedlength(&b)] = '\0';
+		return (true);
+	case field_qname:
+	case field_qclass:
+	case field_qtype:
+		name = dns_fixedname_initname(&fn);
+		if (!get_question(dt, name, &type, &rdclass)) {
+			return (false);
+		}
+		if (f == field_qname) {
+			dns_name_format(name, buf, len);
+		} else if (f == field_qclass) {
+			dns_rdataclass_format(rdclass, buf, len);
+		} else {
+			dns_rdatatype_format(type, buf, len);
+		}
+		return (true);
+	default:
+		UNREACHABLE();
+	}
+}
+
+static void
+print_csv(dns_dtdata_t *dt, isc_buffer_t *b) {
+	for (unsigned int i = 0; i < nfields; i++) {
+		char buf[DNS_NAME_FORMATSIZE];
+		bool quote;
+
+		if (i > 0) {
+			isc_buffer_printf(b, ",");
+		}
+		if (!format_field(dt, fields[i], buf, sizeof(buf), &quote)) {
+			continue;
+		}
+		if (strpbrk(buf, ",\"\r\n") == NULL) {
+			isc_buffer_printf(b, "%s", buf);
+			continue;
+		}
+		isc_buffer_printf(b, "\"");
+		for (const char *p = buf; *p != '\0'; p++) {
+			if (*p == '"') {
+				isc_buffer_printf(b, "\"\"");
+			} else {
+				isc_buffer_printf(b, "%c", *p);
+			}
+		}
+		isc_buffer_printf(b, "\"");
+	}
+	isc_buffer_printf(b, "\n");
+}
+
+static void
+print_json(dns_dtdata_t *dt, isc_buffer_t *b) {
+	isc_buffer_printf(b, "{");
+	for (unsigned int i = 0; i < nfields; i++) {
+		char buf[DNS_NAME_FORMATSIZE];
+		bool quote;
+
+		isc_buffer_printf(b, "%s\"%s\":", (i > 0) ? "," : "",
+				  fieldnames[fields[i]]);
+		if (!format_field(dt, fields[i], buf, sizeof(buf), &quote)) {
+			isc_buffer_printf(b, "null");
+			continue;
+		}
+		if (!quote) {
+			isc_buffer_printf(b, "%s", buf);
+			continue;
+		}
+		isc_buffer_printf(b, "\"");
+		for (const unsigned char *p = (unsigned char *)buf; *p != '\0';
+		     p++)
+		{
+			if (*p == '"' || *p == '\\') {
+				isc_buffer_printf(b, "\\%c", *p);
+			} else if (*p < 0x20) {
+				isc_buffer_printf(b, "\\u%04x", *p);
+			} else {
+				isc_buffer_printf(b, "%c", *p);
+			}
+		}
+		isc_buffer_printf(b, "\"");
+	}
+	isc_buffer_printf(b, "}\n");
+}
+
+/*
+ * Decode one frame and, if it passes the filters, format it into
+ * '*textp'.  The DNS message is only parsed for the output formats
+ * that print it.
+ */
+static void
+process_frame(isc_region_t *input, isc_buffer_t **textp) {
+	isc_result_t result;
+	dns_dtdata_t *dt = NULL;
+	isc_buffer_t *b = NULL;
+
+	result = dns_dt_parseframe(mctx, input, DNS_DTPARSE_NOMESSAGE, &dt);
+	if (result != ISC_R_SUCCESS) {
+		return;
+	}
+
+	if (!frame_match(dt)) {
+		goto cleanup;
+	}
+
+	if (output == output_text) {
+		result = dns_dt_parsemessage(dt);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+	}
+
+	isc_buffer_allocate(mctx, &b, 2048);
+	if (b == NULL) {
+		fatal("out of memory");
+	}
+	isc_buffer_setautorealloc(b, true);
+
+	if (output == output_csv) {
+		print_csv(dt, b);
+	} else if (output == output_json) {
+		print_json(dt, b);
+	} else if (yaml) {
+		print_yaml(dt, &b);
+	} else if (hexmessage) {
+		print_dtdata(dt, &b);
+		print_hex(dt, &b);
+	} else if (printmessage) {
+		print_dtdata(dt, &b);
+		print_packet(dt, &dns_master_style_debug, &b);
+	} else {
+		print_dtdata(dt, &b);
+	}
+
+	if (isc_buffer_usedlength(b) == 0) {
+		isc_buffer_free(&b);
+	}
+	*textp = b;
+
+cleanup:
+	dns_dtdata_free(&dt);
+}
+
+static void
+emit_frame(frame_t *frame) {
+	static bool first = true;
+
+	if (frame->text == NULL) {
+		return;
+	}
+
+	if (yaml && output == output_text) {
+		if (!first) {
+			printf("---\n");
+		}
+		first = false;
+	}
+
+	fwrite(isc_buffer_base(frame->text), 1,
+	       isc_buffer_usedlength(frame->text), stdout);
+	isc_buffer_free(&frame->text);
+}
+
+static isc_threadresult_t
+block_worker(isc_threadarg_t arg) {
+	frameblock_t *block = arg;
+	size_t i;
+
+	while ((i = atomic_fetch_add_relaxed(&block->next, 1)) < block->count)
+	{
+		frame_t *frame = &block->frames[i];
+
+		process_frame(&frame->input, &frame->text);
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+static void
+block_flush(frameblock_t *block, isc_thread_t *threads) {
+	unsigned int n = ISC_MIN(nthreads, block->count);
+
+	atomic_init(&block->next, 0);
+	for (unsigned int i = 0; i + 1 < n; i++) {
+		isc_thread_create(block_worker, block, &threads[i]);
+	}
+	(void)block_worker(block);
+	for (unsigned int i = 0; i + 1 < n; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+
+	for (size_t i = 0; i < block->count; i++) {
+		frame_t *frame = &block->frames[i];
+
+		emit_frame(frame);
+		isc_mem_put(mctx, frame->input.base, frame->input.length);
+	}
+	block->count = 0;
+}
+
+static void
+parse_fields(const char *arg) {
+	char *list = isc_mem_strdup(mctx, arg);
+	char *last = NULL;
+
+	nfields = 0;
+	for (char *tok = strtok_r(list, ",", &last); tok != NULL;
+	     tok = strtok_r(NULL, ",", &last))
+	{
+		field_t f;
+
+		for (f = 0; f < field_max; f++) {
+			if (strcasecmp(tok, fieldnames[f]) == 0) {
+				break;
+			}
+		}
+		if (f == field_max) {
+			fatal("unknown field '%s'", tok);
+		}
+		if (nfields == field_max) {
+			fatal("too many fields");
+		}
+		fields[nfields++] = f;
+	}
+	isc_mem_free(mctx, list);
+
+	if (nfields == 0) {
+		fatal("no fields specified");
+	}
+}
+
+static int64_t
+parse_time(const char *arg) {
+	int64_t when;
+	char *end = NULL;
+
+	if (strlen(arg) == 14 && dns_time64_fromtext(arg, &when) ==
+					 ISC_R_SUCCESS)
+	{
+		return (when);
+	}
+
+	when = strtoll(arg, &end, 10);
+	if (*arg == '\0' || *end != '\0' || when < 0) {
+		fatal("invalid time '%s'", arg);
+	}
+	return (when);
+}
+
+static void
+parse_client(const char *arg) {
+	char buf[ISC_NETADDR_FORMATSIZE];
+	char *slash = NULL;
+	struct in_addr in;
+	struct in6_addr in6;
+	unsigned int maxlen;
+
+	if (strlcpy(buf, arg, sizeof(buf)) >= sizeof(buf)) {
+		fatal("invalid client prefix '%s'", arg);
+	}
+	slash = strchr(buf, '/');
+	if (slash != NULL) {
+		*slash++ = '\0';
+	}
+
+	if (inet_pton(AF_INET, buf, &in) == 1) {
+		isc_netaddr_fromin(&filter_client, &in);
+		maxlen = 32;
+	} else if (inet_pton(AF_INET6, buf, &in6) == 1) {
+		isc_netaddr_fromin6(&filter_client, &in6);
+		maxlen = 128;
+	} else {
+		fatal("invalid client prefix '%s'", arg);
+	}
+
+	filter_clientlen = maxlen;
+	if (slash != NULL) {
+		char *end = NULL;
+		unsigned long len = strtoul(slash, &end, 10);
 
-		printf("  %s: |\n", ((dt->type & DNS_DTTYPE_QUERY) != 0)
-					    ? "query_message"
-					    : "response_message");
-		print_packet(dt, &dns_master_style_indent);
+		if (*slash == '\0' || *end != '\0' || len > maxlen) {
+			fatal("invalid client prefix '%s'", arg);
+		}
+		filter_clientlen = len;
 	}
+	filter_hasclient = true;
 }
 
 int
 main(int argc, char *argv[]) {
 	isc_result_t result;
-	dns_message_t *message = NULL;
-	isc_buffer_t *b = NULL;
-	dns_dtdata_t *dt = NULL;
 	dns_dthandle_t *handle = NULL;
+	frameblock_t block = { .frames = NULL };
+	isc_thread_t *threads = NULL;
+	isc_textregion_t tr;
+	const char *fieldlist = DEFAULT_FIELDS;
+	char *end = NULL;
 	int rv = 0, ch;
 
-	while ((ch = isc_commandline_parse(argc, argv, "mpxy")) != -1) {
+	nthreads = isc_os_ncpus();
+
+	isc_mem_create(&mctx);
+
+	while ((ch = isc_commandline_parse(argc, argv,
+					   "b:c:e:f:mn:o:pr:t:T:xy")) != -1)
+	{
 		switch (ch) {
+		case 'b':
+			filter_begin = parse_time(isc_commandline_argument);
+			break;
+		case 'c':
+			parse_client(isc_commandline_argument);
+			break;
+		case 'e':
+			filter_end = parse_time(isc_commandline_argument);
+			break;
+		case 'f':
+			fieldlist = isc_commandline_argument;
+			break;
 		case 'm':
 			isc_mem_debugging |= ISC_MEM_DEBUGRECORD;
 			memrecord = true;
 			break;
+		case 'n':
+			filter_suffix = dns_fixedname_initname(&fsuffix);
+			result = dns_name_fromstring(filter_suffix,
+						     isc_commandline_argument,
+						     0, NULL);
+			if (result != ISC_R_SUCCESS) {
+				fatal("invalid name '%s': %s",
+				      isc_commandline_argument,
+				      isc_result_totext(result));
+			}
+			break;
+		case 'o':
+			if (strcasecmp(isc_commandline_argument, "csv") == 0) {
+				output = output_csv;
+			} else if (strcasecmp(isc_commandline_argument,
+					      "json") == 0) {
+				output = output_json;
+			} else {
+				fatal("unknown output format '%s'",
+				      isc_commandline_argument);
+			}
+			break;
 		case 'p':
 			printmessage = true;
 			break;
+		case 'r':
+			tr.base = isc_commandline_argument;
+			tr.length = strlen(isc_commandline_argument);
+			if (dns_rcode_fromtext(&filter_rcode, &tr) !=
+				    ISC_R_SUCCESS ||
+			    filter_rcode > 15)
+			{
+				fatal("invalid rcode '%s'",
+				      isc_commandline_argument);
+			}
+			filter_hasrcode = true;
+			break;
+		case 't':
+			tr.base = isc_commandline_argument;
+			tr.length = strlen(isc_commandline_argument);
+			if (dns_rdatatype_fromtext(&filter_type, &tr) !=
+			    ISC_R_SUCCESS) {
+				fatal("invalid type '%s'",
+				      isc_commandline_argument);
+			}
+			filter_hastype = true;
+			break;
+		case 'T':
+			nthreads = strtoul(isc_commandline_argument, &end, 10);
+			if (*end != '\0' || nthreads < 1 ||
+			    nthreads > MAX_THREADS) {
+				fatal("number of threads must be between 1 "
+				      "and %u",
+				      MAX_THREADS);
+			}
+			break;
 		case 'x':
 			hexmessage = true;
 			break;
@@ -359,11 +1008,27 @@ main(int argc, char *argv[]) {
 		fatal("no file specified");
 	}
 
-	isc_mem_create(&mctx);
+	if (output != output_text) {
+		parse_fields(fieldlist);
+		if (output == output_csv) {
+			for (unsigned int i = 0; i < nfields; i++) {
+				printf("%s%s", (i > 0) ? "," : "",
+				       fieldnames[fields[i]]);
+			}
+			printf("\n");
+		}
+	}
 
 	CHECKM(dns_dt_open(argv[0], dns_dtmode_file, mctx, &handle),
 	       "dns_dt_openfile");
 
+	if (nthreads > 1) {
+		block.frames = isc_mem_get(
+			mctx, FRAME_BLOCK * sizeof(block.frames[0]));
+		threads = isc_mem_get(mctx,
+				      (nthreads - 1) * sizeof(threads[0]));
+	}
+
 	for (;;) {
 		isc_region_t input;
 		uint8_t *data;
@@ -379,48 +1044,47 @@ main(int argc, char *argv[]) {
 		input.base = data;
 		input.length = datalen;
 
-		if (b != NULL) {
-			isc_buffer_free(&b);
-		}
-		isc_buffer_allocate(mctx, &b, 2048);
-		if (b == NULL) {
-			fatal("out of memory");
-		}
+		if (nthreads <= 1) {
+			frame_t frame = { .text = NULL };
 
-		result = dns_dt_parse(mctx, &input, &dt);
-		if (result != ISC_R_SUCCESS) {
-			isc_buffer_free(&b);
+			process_frame(&input, &frame.text);
+			emit_frame(&frame);
 			continue;
 		}
 
-		if (yaml) {
-			print_yaml(dt);
-		} else if (hexmessage) {
-			print_dtdata(dt);
-			print_hex(dt);
-		} else if (printmessage) {
-			print_dtdata(dt);
-			print_packet(dt, &dns_master_style_debug);
-		} else {
-			print_dtdata(dt);
+		/*
+		 * The reader reuses its buffer for the next frame, so the
+		 * frames of a block are copied.
+		 */
+		block.frames[block.count] = (frame_t){
+			.input.base = isc_mem_get(mctx, datalen),
+			.input.length = datalen,
+		};
+		memmove(block.frames[block.count].input.base, data, datalen);
+		if (++block.count == FRAME_BLOCK) {
+			block_flush(&block, threads);
 		}
+	}
 
-		dns_dtdata_free(&dt);
+	if (block.count > 0) {
+		block_flush(&block, threads);
 	}
 
 cleanup:
-	if (dt != NULL) {
-		dns_dtdata_free(&dt);
+	if (block.frames != NULL) {
+		for (size_t i = 0; i < block.count; i++) {
+			isc_mem_put(mctx, block.frames[i].input.base,
+				    block.frames[i].input.length);
+		}
+		isc_mem_put(mctx, block.frames,
+			    FRAME_BLOCK * sizeof(block.frames[0]));
+	}
+	if (threads != NULL) {
+		isc_mem_put(mctx, threads, (nthreads - 1) * sizeof(threads[0]));
 	}
 	if (handle != NULL) {
 		dns_dt_close(&handle);
 	}
-	if (message != NULL) {
-		dns_message_detach(&message);
-	}
-	if (b != NULL) {
-		isc_buffer_free(&b);
-	}
 	isc_mem_destroy(&mctx);
 
 	exit(rv);
@@ -15,12 +15,15 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
+#include <isc/atomic.h>
 #include <isc/attributes.h>
 #include <isc/base64.h>
 #include <isc/hash.h>
 #include <isc/hex.h>
+#include <isc/histo.h>
 #include <isc/log.h>
 #include <isc/loop.h>
 #include <isc/managers.h>
@@ -36,9 +39,13 @@
 #include <isc/sockaddr.h>
 #include <isc/string.h>
 #include <isc/task.h>
+#include <isc/tid.h>
+#include <isc/timer.h>
+#include <isc/tls.h>
 #include <isc/util.h>
 
 #include <dns/byaddr.h>
+#include <dns/compress.h>
 #include <dns/dispatch.h>
 #include <dns/events.h>
 #include <dns/fixedname.h>
@@ -84,13 +91,16 @@
 #define UDPTIMEOUT 5
 #define MAXTRIES   0xffffffff
 
-#define NS_PER_US  1000	   /*%< Nanoseconds per microsecond. */
-#define US_PER_SEC 1000000 /*%< Microseconds per second. */
-#define US_PER_MS  1000	   /*%< Microseconds per millisecond. */
+#define NS_PER_US  1000	      /*%< Nanoseconds per microsecond. */
+#define NS_PER_MS  1000000    /*%< Nanoseconds per millisecond. */
+#define NS_PER_SEC 1000000000 /*%< Nanoseconds per second. */
+#define US_PER_SEC 1000000    /*%< Microseconds per second. */
+#define US_PER_MS  1000	      /*%< Microseconds per millisecond. */
 
 static isc_mem_t *mctx = NULL;
 static isc_task_t *global_task = NULL;
 static isc_loopmgr_t *loopmgr = NULL;
+static isc_nm_t *netmgr = NULL;
 static dns_requestmgr_t *requestmgr = NULL;
 static const char *batchname = NULL;
 static FILE *batchfp = NULL;
@@ -99,6 +109,11 @@ static bool have_ipv4 = false;
 static bool have_ipv6 = false;
 static bool have_src = false;
 static bool tcp_mode = false;
+static bool tls_mode = false;
+static bool https_mode = false;
+static bool https_get = false;
+static bool http_plain = false;
+static const char *https_path = NULL;
 static bool besteffort = true;
 static bool display_short_form = false;
 static bool display_headers = true;
@@ -121,10 +136,16 @@ static isc_sockaddr_t srcaddr;
 static char *server = NULL;
 static isc_sockaddr_t dstaddr;
 static in_port_t port = 53;
+static bool port_set = false;
 static isc_dscp_t dscp = -1;
 static unsigned char cookie_secret[33];
 static int onfly = 0;
 static char hexcookie[81];
+static bool load_mode = false;
+static uint32_t load_duration = 10;
+static uint32_t load_inflight = 100;
+static uint32_t load_qps = 0;
+static uint32_t nloops = 1;
 
 struct query {
 	char textname[MXNAME]; /*% Name we're going to be
@@ -580,18 +601,17 @@ compute_cookie(unsigned char *cookie, size_t len) {
 	memmove(cookie, cookie_secret, 8);
 }
 
-static isc_result_t
-sendquery(struct query *query) {
-	dns_request_t *request = NULL;
+/*%
+ * Build the query message for 'query'.
+ */
+static void
+buildquery(struct query *query, dns_message_t **messagep) {
 	dns_message_t *message = NULL;
 	dns_name_t *qname = NULL;
 	dns_rdataset_t *qrdataset = NULL;
 	isc_result_t result;
 	dns_fixedname_t queryname;
 	isc_buffer_t buf;
-	unsigned int options = 0;
-
-	onfly++;
 
 	dns_fixedname_init(&queryname);
 	isc_buffer_init(&buf, query->textname, strlen(query->textname));
@@ -750,6 +770,20 @@ sendquery(struct query *query) {
 		add_opt(message, query->udpsize, query->edns, flags, opts, i);
 	}
 
+	*messagep = message;
+}
+
+static isc_result_t
+sendquery(struct query *query) {
+	dns_request_t *request = NULL;
+	dns_message_t *message = NULL;
+	isc_result_t result;
+	unsigned int options = 0;
+
+	onfly++;
+
+	buildquery(query, &message);
+
 	if (tcp_mode) {
 		options |= DNS_REQUESTOPT_TCP;
 	}
@@ -781,6 +815,636 @@ sendqueries(void *arg) {
 	}
 }
 
+/*%
+ * Load mode: rather than printing the responses, send the queries to the
+ * server over and over again, round robin, for a fixed time, and report
+ * the throughput and the distribution of the response times.  Each query
+ * in flight has a connection ("slot") of its own on one of the loops,
+ * which carries one query at a time; when a target rate is set, the
+ * slots of a loop share a budget of queries that is refilled on every
+ * tick of the loop's timer.
+ */
+#define LOAD_HISTO_SIGBITS 3
+#define LOAD_TICK_MS	   1   /*%< Pacing interval. */
+#define LOAD_RETRY_MS	   100 /*%< Reconnection interval. */
+
+typedef struct loadloop loadloop_t;
+typedef struct loadslot loadslot_t;
+
+struct loadslot {
+	loadloop_t *ll;
+	isc_nmhandle_t *handle;
+	uint64_t sent;
+	uint16_t id;
+	isc_region_t region;
+	ISC_LINK(loadslot_t) link;
+};
+
+struct loadloop {
+	isc_timer_t *timer;
+	loadslot_t *slots;
+	uint32_t nslots;
+	uint32_t active;
+	ISC_LIST(loadslot_t) idle;   /*%< Connected, waiting for budget */
+	ISC_LIST(loadslot_t) broken; /*%< Waiting to reconnect */
+	double rate;
+	double budget;
+	uint64_t next;
+	uint64_t last;
+	uint64_t lastretry;
+	uint64_t started;
+	uint64_t stopped;
+	bool stopping;
+
+	uint64_t sent;
+	uint64_t received;
+	uint64_t timeouts;
+	uint64_t errors;
+	uint64_t mismatched;
+	uint64_t connects;
+	uint64_t connfailed;
+	uint64_t rcodes[16];
+};
+
+static isc_region_t *load_queries = NULL;
+static size_t load_nqueries = 0;
+static unsigned int load_maxlen = 0;
+static unsigned int load_timeout = 0;
+static loadloop_t *load_loops = NULL;
+static atomic_uint_fast32_t load_running;
+static isc_histo_t *load_histo = NULL;
+static isc_tlsctx_t *load_tlsctx = NULL;
+static isc_tlsctx_client_session_cache_t *load_sesscache = NULL;
+#if HAVE_LIBNGHTTP2
+static char load_uri[4096];
+#endif /* HAVE_LIBNGHTTP2 */
+
+noreturn static void
+fatal(const char *format, ...) ISC_FORMAT_PRINTF(1, 2);
+
+static void
+load_connect(loadslot_t *slot);
+static void
+load_response(isc_nmhandle_t *handle, isc_result_t eresult,
+	      isc_region_t *region, void *arg);
+
+static uint64_t
+load_now(void) {
+	struct timespec ts;
+
+	RUNTIME_CHECK(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+
+	return ((uint64_t)ts.tv_sec * NS_PER_SEC + ts.tv_nsec);
+}
+
+static const char *
+load_transport(void) {
+	if (tls_mode) {
+		return ("TLS");
+	} else if (https_mode) {
+		if (http_plain) {
+			return (https_get ? "HTTP-GET" : "HTTP");
+		}
+		return (https_get ? "HTTPS-GET" : "HTTPS");
+	} else if (tcp_mode) {
+		return ("TCP");
+	}
+	return ("UDP");
+}
+
+static void
+load_done(loadslot_t *slot) {
+	loadloop_t *ll = slot->ll;
+
+	if (slot->handle != NULL) {
+		isc_nmhandle_detach(&slot->handle);
+	}
+
+	INSIST(ll->active > 0);
+	if (--ll->active > 0) {
+		return;
+	}
+
+	if (ll->timer != NULL) {
+		isc_timer_stop(ll->timer);
+		isc_timer_destroy(&ll->timer);
+	}
+
+	if (atomic_fetch_sub_release(&load_running, 1) == 1) {
+		isc_task_detach(&global_task);
+		isc_loopmgr_shutdown(loopmgr);
+	}
+}
+
+static void
+load_broken(loadslot_t *slot) {
+	loadloop_t *ll = slot->ll;
+
+	if (slot->handle != NULL) {
+		isc_nmhandle_detach(&slot->handle);
+	}
+
+	if (ll->stopping) {
+		load_done(slot);
+		return;
+	}
+
+	ISC_LIST_APPEND(ll->broken, slot, link);
+}
+
+static void
+load_sent(isc_nmhandle_t *handle, isc_result_t eresult, void *arg) {
+	UNUSED(handle);
+	UNUSED(eresult);
+	UNUSED(arg);
+
+	/* A failed send is accounted for when the read fails. */
+}
+
+static void
+load_send(loadslot_t *slot) {
+	loadloop_t *ll = slot->ll;
+	isc_region_t *query = &load_queries[ll->next++ % load_nqueries];
+
+	memmove(slot->region.base, query->base, query->length);
+	slot->region.length = query->length;
+	slot->id = isc_random16();
+	slot->region.base[0] = slot->id >> 8;
+	slot->region.base[1] = slot->id & 0xff;
+
+	ll->sent++;
+	slot->sent = load_now();
+	isc_nm_read(slot->handle, load_response, slot);
+	isc_nm_send(slot->handle, &slot->region, load_sent, slot);
+}
+
+static void
+load_next(loadslot_t *slot) {
+	loadloop_t *ll = slot->ll;
+
+	if (ll->stopping) {
+		load_done(slot);
+		return;
+	}
+
+	if (ll->rate > 0) {
+		if (ll->budget < 1) {
+			ISC_LIST_APPEND(ll->idle, slot, link);
+			return;
+		}
+		ll->budget -= 1;
+	}
+
+	load_send(slot);
+}
+
+static void
+load_response(isc_nmhandle_t *handle, isc_result_t eresult,
+	      isc_region_t *region, void *arg) {
+	loadslot_t *slot = (loadslot_t *)arg;
+	loadloop_t *ll = slot->ll;
+	uint16_t id;
+
+	UNUSED(handle);
+
+	switch (eresult) {
+	case ISC_R_SUCCESS:
+		break;
+	case ISC_R_TIMEDOUT:
+		ll->timeouts++;
+		load_broken(slot);
+		return;
+	default:
+		ll->errors++;
+		load_broken(slot);
+		return;
+	}
+
+	if (region->length < DNS_MESSAGE_HEADERLEN) {
+		ll->errors++;
+		load_next(slot);
+		return;
+	}
+
+	/*
+	 * A response with the wrong ID is a late answer to an earlier
+	 * query; keep waiting for the right one, except over HTTP, where
+	 * each query has a stream of its own.
+	 */
+	id = (region->base[0] << 8) | region->base[1];
+	if (id != slot->id) {
+		ll->mismatched++;
+		if (https_mode) {
+			load_next(slot);
+		} else {
+			isc_nm_read(slot->handle, load_response, slot);
+		}
+		return;
+	}
+
+	isc_histo_inc(load_histo, (load_now() - slot->sent) / NS_PER_US);
+	ll->received++;
+	ll->rcodes[region->base[3] & 0x0f]++;
+
+	load_next(slot);
+}
+
+static void
+load_connected(isc_nmhandle_t *handle, isc_result_t eresult, void *arg) {
+	loadslot_t *slot = (loadslot_t *)arg;
+
+	if (eresult != ISC_R_SUCCESS) {
+		slot->ll->connfailed++;
+		load_broken(slot);
+		return;
+	}
+
+	isc_nmhandle_attach(handle, &slot->handle);
+	isc_nmhandle_settimeout(slot->handle, load_timeout);
+
+	load_next(slot);
+}
+
+static void
+load_connect(loadslot_t *slot) {
+	isc_sockaddr_t local;
+
+	if (have_src) {
+		local = srcaddr;
+		isc_sockaddr_setport(&local, 0);
+	} else if (have_ipv4) {
+		isc_sockaddr_any(&local);
+	} else {
+		isc_sockaddr_any6(&local);
+	}
+
+	slot->ll->connects++;
+
+	if (tls_mode) {
+		isc_nm_tlsdnsconnect(netmgr, &local, &dstaddr, load_connected,
+				     slot, load_timeout, load_tlsctx,
+				     load_sesscache);
+#if HAVE_LIBNGHTTP2
+	} else if (https_mode) {
+		isc_nm_httpconnect(netmgr, &local, &dstaddr, load_uri,
+				   !https_get, load_connected, slot,
+				   load_tlsctx, load_sesscache, load_timeout);
+#endif /* HAVE_LIBNGHTTP2 */
+	} else if (tcp_mode) {
+		isc_nm_tcpdnsconnect(netmgr, &local, &dstaddr, load_connected,
+				     slot, load_timeout);
+	} else {
+		isc_nm_udpconnect(netmgr, &local, &dstaddr, load_connected,
+				  slot, load_timeout);
+	}
+}
+
+static void
+load_stop(loadloop_t *ll) {
+	loadslot_t *slot = NULL;
+
+	if (ll->stopping) {
+		return;
+	}
+
+	ll->stopping = true;
+	ll->stopped = load_now();
+
+	/*
+	 * The slots with a query in flight are finished when it is
+	 * answered or times out.
+	 */
+	while ((slot = ISC_LIST_HEAD(ll->idle)) != NULL) {
+		ISC_LIST_UNLINK(ll->idle, slot, link);
+		load_done(slot);
+	}
+	while ((slot = ISC_LIST_HEAD(ll->broken)) != NULL) {
+		ISC_LIST_UNLINK(ll->broken, slot, link);
+		load_done(slot);
+	}
+}
+
+static void
+load_tick(void *arg) {
+	loadloop_t *ll = (loadloop_t *)arg;
+	loadslot_t *slot = NULL;
+	uint64_t now = load_now();
+
+	if (now - ll->started >= (uint64_t)load_duration * NS_PER_SEC) {
+		load_stop(ll);
+		return;
+	}
+
+	if (now - ll->lastretry >= LOAD_RETRY_MS * NS_PER_MS) {
+		ll->lastretry = now;
+		while ((slot = ISC_LIST_HEAD(ll->broken)) != NULL) {
+			ISC_LIST_UNLINK(ll->broken, slot, link);
+			load_connect(slot);
+		}
+	}
+
+	if (ll->rate == 0) {
+		return;
+	}
+
+	/*
+	 * Do not let the budget grow beyond what the slots can use at
+	 * once, so that a stall is not followed by a burst.
+	 */
+	ll->budget += ll->rate * (now - ll->last) / NS_PER_SEC;
+	ll->last = now;
+	if (ll->budget > ll->nslots) {
+		ll->budget = ll->nslots;
+	}
+
+	while (ll->budget >= 1 && (slot = ISC_LIST_HEAD(ll->idle)) != NULL) {
+		ISC_LIST_UNLINK(ll->idle, slot, link);
+		ll->budget -= 1;
+		load_send(slot);
+	}
+}
+
+static void
+load_start(void *arg) {
+	loadloop_t *ll = &load_loops[isc_tid()];
+	isc_interval_t interval;
+
+	UNUSED(arg);
+
+	ll->started = ll->last = ll->lastretry = load_now();
+	ll->active = ll->nslots;
+
+	isc_timer_create(isc_loop_current(loopmgr), load_tick, ll, &ll->timer);
+	isc_interval_set(&interval, 0, LOAD_TICK_MS * NS_PER_MS);
+	isc_timer_start(ll->timer, isc_timertype_ticker, &interval);
+
+	for (uint32_t i = 0; i < ll->nslots; i++) {
+		load_connect(&ll->slots[i]);
+	}
+}
+
+static void
+load_teardown(void *arg) {
+	loadloop_t *ll = &load_loops[isc_tid()];
+
+	UNUSED(arg);
+
+	load_stop(ll);
+	if (ll->timer != NULL) {
+		isc_timer_stop(ll->timer);
+		isc_timer_destroy(&ll->timer);
+	}
+}
+
+/*%
+ * Render the queries to wire format, and set up the loops and their
+ * slots.
+ */
+static void
+load_prepare(void) {
+	unsigned char wire[COMMSIZE];
+	size_t n = 0;
+
+	for (struct query *query = ISC_LIST_HEAD(queries); query != NULL;
+	     query = ISC_LIST_NEXT(query, link))
+	{
+		load_nqueries++;
+	}
+	if (load_nqueries == 0) {
+		fatal("no queries to send");
+	}
+	if (load_inflight < nloops) {
+		fatal("+inflight must be at least +loops");
+	}
+
+	load_queries = isc_mem_get(mctx,
+				   load_nqueries * sizeof(load_queries[0]));
+	for (struct query *query = ISC_LIST_HEAD(queries); query != NULL;
+	     query = ISC_LIST_NEXT(query, link))
+	{
+		dns_message_t *message = NULL;
+		dns_compress_t cctx;
+		isc_buffer_t buf;
+		isc_result_t result;
+
+		buildquery(query, &message);
+
+		isc_buffer_init(&buf, wire, sizeof(wire));
+		result = dns_compress_init(&cctx, mctx);
+		CHECK("dns_compress_init", result);
+		result = dns_message_renderbegin(message, &cctx, &buf);
+		CHECK("dns_message_renderbegin", result);
+		result = dns_message_rendersection(message,
+						   DNS_SECTION_QUESTION, 0);
+		CHECK("dns_message_rendersection", result);
+		result = dns_message_rendersection(message,
+						   DNS_SECTION_ADDITIONAL, 0);
+		CHECK("dns_message_rendersection", result);
+		result = dns_message_renderend(message);
+		CHECK("dns_message_renderend", result);
+		dns_compress_invalidate(&cctx);
+		dns_message_detach(&message);
+
+		load_queries[n].length = isc_buffer_usedlength(&buf);
+		load_queries[n].base = isc_mem_get(mctx,
+						   load_queries[n].length);
+		memmove(load_queries[n].base, wire, load_queries[n].length);
+		if (load_queries[n].length > load_maxlen) {
+			load_maxlen = load_queries[n].length;
+		}
+
+		if (n == 0) {
+			load_timeout = query->timeout * 1000;
+		}
+		n++;
+	}
+
+	load_loops = isc_mem_get(mctx, nloops * sizeof(load_loops[0]));
+	for (uint32_t i = 0; i < nloops; i++) {
+		loadloop_t *ll = &load_loops[i];
+
+		*ll = (loadloop_t){
+			.nslots = load_inflight / nloops +
+				  (i < load_inflight % nloops ? 1 : 0),
+			.rate = (double)load_qps / nloops,
+			.next = i,
+		};
+		ISC_LIST_INIT(ll->idle);
+		ISC_LIST_INIT(ll->broken);
+
+		ll->slots = isc_mem_get(mctx,
+					ll->nslots * sizeof(ll->slots[0]));
+		for (uint32_t j = 0; j < ll->nslots; j++) {
+			ll->slots[j] = (loadslot_t){
+				.ll = ll,
+				.region.base = isc_mem_get(mctx, load_maxlen),
+			};
+			ISC_LINK_INIT(&ll->slots[j], link);
+		}
+	}
+	atomic_init(&load_running, nloops);
+
+	isc_histo_create(mctx, LOAD_HISTO_SIGBITS, nloops, &load_histo);
+
+	if (tls_mode || (https_mode && !http_plain)) {
+		RUNCHECK(isc_tlsctx_createclient(&load_tlsctx));
+		if (tls_mode) {
+			isc_tlsctx_enable_dot_client_alpn(load_tlsctx);
+		}
+#if HAVE_LIBNGHTTP2
+		if (https_mode) {
+			isc_tlsctx_enable_http2client_alpn(load_tlsctx);
+		}
+#endif /* HAVE_LIBNGHTTP2 */
+		load_sesscache = isc_tlsctx_client_session_cache_new(
+			mctx, load_tlsctx,
+			ISC_TLSCTX_CLIENT_SESSION_CACHE_DEFAULT_SIZE);
+	}
+
+#if HAVE_LIBNGHTTP2
+	if (https_mode) {
+		isc_nm_http_makeuri(!http_plain, &dstaddr, NULL, 0, https_path,
+				    load_uri, sizeof(load_uri));
+	}
+#endif /* HAVE_LIBNGHTTP2 */
+}
+
+static void
+load_report(void) {
+	static const double percentiles[] = { 50, 90, 99, 99.9 };
+	uint64_t sent = 0, received = 0, timeouts = 0, errors = 0;
+	uint64_t mismatched = 0, connects = 0, connfailed = 0;
+	uint64_t rcodes[16] = { 0 };
+	uint64_t started = UINT64_MAX, stopped = 0;
+	uint64_t min = 0, max = 0, count = 0, total = 0, seen = 0;
+	unsigned int key;
+	size_t p = 0;
+	double elapsed;
+
+	for (uint32_t i = 0; i < nloops; i++) {
+		loadloop_t *ll = &load_loops[i];
+
+		sent += ll->sent;
+		received += ll->received;
+		timeouts += ll->timeouts;
+		errors += ll->errors;
+		mismatched += ll->mismatched;
+		connects += ll->connects;
+		connfailed += ll->connfailed;
+		for (size_t r = 0; r < ARRAY_SIZE(rcodes); r++) {
+			rcodes[r] += ll->rcodes[r];
+		}
+		started = ISC_MIN(started, ll->started);
+		stopped = ISC_MAX(stopped, ll->stopped);
+	}
+	elapsed = stopped > started ? (double)(stopped - started) / NS_PER_SEC
+				    : 0;
+
+	printf(";; Load: %s, %" PRIu32 " loops, %" PRIu32
+	       " queries in flight",
+	       load_transport(), nloops, load_inflight);
+	if (load_qps > 0) {
+		printf(", target %" PRIu32 " queries/s", load_qps);
+	}
+	printf("\n");
+	printf(";; Duration: %.3f s\n", elapsed);
+	printf(";; Queries sent: %" PRIu64 ", answered: %" PRIu64
+	       " (%.2f%%)\n",
+	       sent, received, sent > 0 ? 100.0 * received / sent : 0);
+	printf(";; Timed out: %" PRIu64 ", errors: %" PRIu64
+	       ", mismatched IDs: %" PRIu64 "\n",
+	       timeouts, errors, mismatched);
+	printf(";; Connections: %" PRIu64 ", failed: %" PRIu64 "\n", connects,
+	       connfailed);
+	printf(";; Throughput: %.0f queries/s\n",
+	       elapsed > 0 ? received / elapsed : 0);
+
+	printf(";; Response codes:");
+	for (size_t r = 0; r < ARRAY_SIZE(rcodes); r++) {
+		if (rcodes[r] > 0) {
+			printf(" %s %" PRIu64, rcode_totext(r), rcodes[r]);
+		}
+	}
+	printf("\n");
+
+	for (key = 0; isc_histo_get(load_histo, key, NULL, NULL, &count) ==
+		      ISC_R_SUCCESS;
+	     isc_histo_next(load_histo, &key))
+	{
+		total += count;
+	}
+	if (total == 0) {
+		return;
+	}
+
+	printf(";; Latency (us):");
+	for (key = 0; isc_histo_get(load_histo, key, &min, &max, &count) ==
+		      ISC_R_SUCCESS;
+	     isc_histo_next(load_histo, &key))
+	{
+		if (count == 0) {
+			continue;
+		}
+		if (seen == 0) {
+			printf(" min %" PRIu64 ",", min);
+		}
+		seen += count;
+		while (p < ARRAY_SIZE(percentiles) &&
+		       seen >= total * percentiles[p] / 100)
+		{
+			printf(" p%g %" PRIu64 ",", percentiles[p], max);
+			p++;
+		}
+	}
+	printf(" max %" PRIu64 "\n", max);
+
+	printf(";; Latency histogram (us):\n");
+	seen = 0;
+	for (key = 0; isc_histo_get(load_histo, key, &min, &max, &count) ==
+		      ISC_R_SUCCESS;
+	     isc_histo_next(load_histo, &key))
+	{
+		if (count == 0) {
+			continue;
+		}
+		seen += count;
+		printf(";; %10" PRIu64 " - %-10" PRIu64 " %10" PRIu64
+		       " %6.2f%% %6.2f%%\n",
+		       min, max, count, 100.0 * count / total,
+		       100.0 * seen / total);
+	}
+}
+
+static void
+load_cleanup(void) {
+	for (uint32_t i = 0; i < nloops; i++) {
+		loadloop_t *ll = &load_loops[i];
+
+		for (uint32_t j = 0; j < ll->nslots; j++) {
+			isc_mem_put(mctx, ll->slots[j].region.base,
+				    load_maxlen);
+		}
+		isc_mem_put(mctx, ll->slots, ll->nslots * sizeof(ll->slots[0]));
+	}
+	isc_mem_put(mctx, load_loops, nloops * sizeof(load_loops[0]));
+
+	for (size_t i = 0; i < load_nqueries; i++) {
+		isc_mem_put(mctx, load_queries[i].base,
+			    load_queries[i].length);
+	}
+	isc_mem_put(mctx, load_queries,
+		    load_nqueries * sizeof(load_queries[0]));
+
+	isc_histo_detach(&load_histo);
+
+	if (load_sesscache != NULL) {
+		isc_tlsctx_client_session_cache_detach(&load_sesscache);
+	}
+	if (load_tlsctx != NULL) {
+		isc_tlsctx_free(&load_tlsctx);
+	}
+}
+
 noreturn static void
 usage(void);
 
@@ -819,6 +1483,28 @@ help(void) {
 	       "                 +[no]vc             (TCP mode)\n"
 	       "                 +[no]tcp            (TCP mode, alternate "
 	       "syntax)\n"
+	       "                 +[no]tls            (DNS-over-TLS mode, "
+	       "+load only)\n"
+	       "                 +[no]https[=###]    (DNS-over-HTTPS mode, "
+	       "+load only) [/dns-query]\n"
+	       "                 +[no]https-get      (Use GET instead of "
+	       "POST with HTTPS)\n"
+	       "                 +[no]http-plain[=###] (DNS over plain HTTP "
+	       "mode, +load only)\n"
+	       "                 +[no]http-plain-get (Use GET instead of "
+	       "POST with plain HTTP)\n"
+	       "                 +[no]load           (Send the queries "
+	       "repeatedly and report\n"
+	       "                                      throughput and "
+	       "latency)\n"
+	       "                 +duration=###       (Duration of +load in "
+	       "seconds) [10]\n"
+	       "                 +inflight=###       (Queries in flight with "
+	       "+load) [100]\n"
+	       "                 +loops=###          (Loops sending queries "
+	       "with +load) [1]\n"
+	       "                 +qps=###            (Target queries per "
+	       "second with +load)\n"
 	       "                 +[no]besteffort     (Try to parse even "
 	       "illegal "
 	       "messages)\n"
@@ -892,9 +1578,6 @@ help(void) {
 	       "Server ID)\n");
 }
 
-noreturn static void
-fatal(const char *format, ...) ISC_FORMAT_PRINTF(1, 2);
-
 static void
 fatal(const char *format, ...) {
 	va_list args;
@@ -1333,6 +2016,22 @@ plus_option(char *option, struct query *query, bool global) {
 			CHECK("parse_uint(DSCP)", result);
 			dscp = num;
 			break;
+		case 'u': /* duration */
+			FULLCHECK("duration");
+			GLOBAL();
+			if (value == NULL) {
+				goto need_value;
+			}
+			if (!state) {
+				goto invalid_option;
+			}
+			result = parse_uint(&load_duration, value, MAXTIMEOUT,
+					    "duration");
+			CHECK("parse_uint(duration)", result);
+			if (load_duration == 0) {
+				load_duration = 1;
+			}
+			break;
 		default:
 			goto invalid_option;
 		}
@@ -1420,6 +2119,86 @@ plus_option(char *option, struct query *query, bool global) {
 			goto invalid_option;
 		}
 		break;
+	case 'h': /* https, https-get, http-plain, http-plain-get */
+		GLOBAL();
+#if HAVE_LIBNGHTTP2
+		if (strcasecmp(cmd, "https") == 0) {
+			https_get = false;
+			http_plain = false;
+		} else if (strcasecmp(cmd, "https-get") == 0) {
+			https_get = state;
+			http_plain = false;
+		} else if (strcasecmp(cmd, "http-plain") == 0) {
+			https_get = false;
+			http_plain = state;
+		} else if (strcasecmp(cmd, "http-plain-get") == 0) {
+			https_get = state;
+			http_plain = state;
+		} else {
+			goto invalid_option;
+		}
+		https_mode = state;
+		if (!state) {
+			break;
+		}
+		if (value == NULL) {
+			https_path = ISC_NM_HTTP_DEFAULT_PATH;
+		} else if (isc_nm_http_path_isvalid(value)) {
+			https_path = value;
+		} else {
+			fprintf(stderr,
+				";; The given HTTP path \"%s\" is not "
+				"a valid absolute path\n",
+				value);
+			goto invalid_option;
+		}
+#else  /* HAVE_LIBNGHTTP2 */
+		fatal("DoH support not enabled");
+#endif /* HAVE_LIBNGHTTP2 */
+		break;
+	case 'i': /* inflight */
+		FULLCHECK("inflight");
+		GLOBAL();
+		if (value == NULL) {
+			goto need_value;
+		}
+		if (!state) {
+			goto invalid_option;
+		}
+		result = parse_uint(&load_inflight, value, MAXPORT,
+				    "inflight");
+		CHECK("parse_uint(inflight)", result);
+		if (load_inflight == 0) {
+			load_inflight = 1;
+		}
+		break;
+	case 'l':
+		switch (cmd[1]) {
+		case 'o':
+			switch (cmd[2]) {
+			case 'a': /* load */
+				FULLCHECK("load");
+				GLOBAL();
+				load_mode = state;
+				break;
+			case 'o': /* loops, set by preparse_args() */
+				FULLCHECK("loops");
+				GLOBAL();
+				if (value == NULL) {
+					goto need_value;
+				}
+				if (!state) {
+					goto invalid_option;
+				}
+				break;
+			default:
+				goto invalid_option;
+			}
+			break;
+		default:
+			goto invalid_option;
+		}
+		break;
 	case 'm': /* multiline */
 		FULLCHECK("multiline");
 		GLOBAL();
@@ -1433,9 +2212,29 @@ plus_option(char *option, struct query *query, bool global) {
 		query->nsid = state;
 		break;
 	case 'q':
-		FULLCHECK("question");
-		GLOBAL();
-		display_question = state;
+		switch (cmd[1]) {
+		case 'p': /* qps */
+			FULLCHECK("qps");
+			GLOBAL();
+			if (!state) {
+				load_qps = 0;
+				break;
+			}
+			if (value == NULL) {
+				goto need_value;
+			}
+			result = parse_uint(&load_qps, value, UINT32_MAX,
+					    "qps");
+			CHECK("parse_uint(qps)", result);
+			break;
+		case 'u': /* question */
+			FULLCHECK("question");
+			GLOBAL();
+			display_question = state;
+			break;
+		default:
+			goto invalid_option;
+		}
 		break;
 	case 'r':
 		switch (cmd[1]) {
@@ -1550,6 +2349,11 @@ plus_option(char *option, struct query *query, bool global) {
 			GLOBAL();
 			tcp_mode = state;
 			break;
+		case 'l': /* tls */
+			FULLCHECK("tls");
+			GLOBAL();
+			tls_mode = state;
+			break;
 		case 'i': /* timeout */
 			FULLCHECK("timeout");
 			if (value == NULL) {
@@ -1790,6 +2594,7 @@ dash_option(const char *option, char *next, struct query *query, bool global,
 		result = parse_uint(&num, value, MAXPORT, "port number");
 		CHECK("parse_uint(port)", result);
 		port = num;
+		port_set = true;
 		return (value_from_next);
 	case 't':
 		tr.base = value;
@@ -1832,7 +2637,9 @@ clone_default_query(void) {
 	}
 
 	if (query->timeout == 0) {
-		query->timeout = tcp_mode ? TCPTIMEOUT : UDPTIMEOUT;
+		query->timeout = (tcp_mode || tls_mode || https_mode)
+					 ? TCPTIMEOUT
+					 : UDPTIMEOUT;
 	}
 
 	return (query);
@@ -1857,6 +2664,28 @@ preparse_args(int argc, char **argv) {
 	rc = argc;
 	rv = argv;
 	for (rc--, rv++; rc > 0; rc--, rv++) {
+		/*
+		 * The number of loops has to be known before the loop
+		 * manager is created.
+		 */
+		if (rv[0][0] == '+' && (option = strchr(rv[0], '=')) != NULL)
+		{
+			size_t len = option - &rv[0][1];
+
+			if (len >= 3 && len < sizeof("loops") &&
+			    strncasecmp(&rv[0][1], "loops", len) == 0)
+			{
+				isc_result_t result;
+
+				result = parse_uint(&nloops, option + 1, 1024,
+						    "loops");
+				CHECK("parse_uint(loops)", result);
+				if (nloops == 0) {
+					nloops = 1;
+				}
+			}
+			continue;
+		}
 		if (rv[0][0] != '-') {
 			continue;
 		}
@@ -2103,7 +2932,6 @@ main(int argc, char *argv[]) {
 	isc_sockaddr_t bind_any;
 	isc_log_t *lctx = NULL;
 	isc_logconfig_t *lcfg = NULL;
-	isc_nm_t *netmgr = NULL;
 	isc_taskmgr_t *taskmgr = NULL;
 	dns_dispatchmgr_t *dispatchmgr = NULL;
 	dns_dispatch_t *dispatchvx = NULL;
@@ -2123,7 +2951,7 @@ main(int argc, char *argv[]) {
 
 	preparse_args(argc, argv);
 
-	isc_managers_create(&mctx, 1, &loopmgr, &netmgr, &taskmgr);
+	isc_managers_create(&mctx, nloops, &loopmgr, &netmgr, &taskmgr);
 	isc_log_create(mctx, &lctx, &lcfg);
 
 	RUNCHECK(dst_lib_init(mctx, NULL));
@@ -2134,6 +2962,16 @@ main(int argc, char *argv[]) {
 	if (server == NULL) {
 		fatal("a server '@xxx' is required");
 	}
+	if ((tls_mode || https_mode) && !load_mode) {
+		fatal("+tls and +https are only supported with +load");
+	}
+	if (!port_set) {
+		if (tls_mode) {
+			port = 853;
+		} else if (https_mode) {
+			port = http_plain ? 80 : 443;
+		}
+	}
 
 	ns = 0;
 	result = bind9_getaddresses(server, port, &dstaddr, 1, &ns);
@@ -2172,8 +3010,14 @@ main(int argc, char *argv[]) {
 
 	RUNCHECK(dns_view_create(mctx, 0, "_test", &view));
 
-	query = ISC_LIST_HEAD(queries);
-	isc_loopmgr_setup(loopmgr, sendqueries, query);
+	if (load_mode) {
+		load_prepare();
+		isc_loopmgr_setup(loopmgr, load_start, NULL);
+		isc_loopmgr_teardown(loopmgr, load_teardown, NULL);
+	} else {
+		query = ISC_LIST_HEAD(queries);
+		isc_loopmgr_setup(loopmgr, sendqueries, query);
+	}
 
 	/*
 	 * Stall to the start of a new second.
@@ -2203,6 +3047,15 @@ main(int argc, char *argv[]) {
 
 	isc_loopmgr_run(loopmgr);
 
+	if (global_task != NULL) {
+		isc_task_detach(&global_task);
+	}
+
+	if (load_mode) {
+		load_report();
+		load_cleanup();
+	}
+
 	dns_view_detach(&view);
 
 	dns_requestmgr_shutdown(requestmgr);
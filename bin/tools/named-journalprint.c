@@ -22,15 +22,32 @@
 #include <isc/result.h>
 #include <isc/util.h>
 
+#include <dns/fixedname.h>
 #include <dns/journal.h>
 #include <dns/log.h>
+#include <dns/name.h>
 #include <dns/types.h>
 
 const char *progname = NULL;
 
+static uint32_t
+parse_serial(const char *arg) {
+	char *endp = NULL;
+	unsigned long serial = strtoul(arg, &endp, 0);
+
+	if (endp == arg || *endp != 0 || serial > UINT32_MAX) {
+		fprintf(stderr, "invalid serial: %s\n", arg);
+		exit(1);
+	}
+	return ((uint32_t)serial);
+}
+
 static void
 usage(void) {
-	fprintf(stderr, "Usage: %s [-dux] journal\n", progname);
+	fprintf(stderr,
+		"Usage: %s [-dux] [-s serial] [-e serial] [-n name] journal\n"
+		"       %s -i journal\n",
+		progname, progname);
 	exit(1);
 }
 
@@ -73,24 +90,39 @@ main(int argc, char **argv) {
 	bool compact = false;
 	bool downgrade = false;
 	bool upgrade = false;
+	bool writeindex = false;
 	unsigned int serial = 0;
-	char *endp = NULL;
+	uint32_t begin = 0, end = 0;
+	bool hasbegin = false, hasend = false;
+	const char *select = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *name = NULL;
 
 	progname = argv[0];
-	while ((ch = isc_commandline_parse(argc, argv, "c:dux")) != -1) {
+	while ((ch = isc_commandline_parse(argc, argv, "c:de:in:s:ux")) != -1)
+	{
 		switch (ch) {
 		case 'c':
 			compact = true;
-			serial = strtoul(isc_commandline_argument, &endp, 0);
-			if (endp == isc_commandline_argument || *endp != 0) {
-				fprintf(stderr, "invalid serial: %s\n",
-					isc_commandline_argument);
-				exit(1);
-			}
+			serial = parse_serial(isc_commandline_argument);
 			break;
 		case 'd':
 			downgrade = true;
 			break;
+		case 'e':
+			end = parse_serial(isc_commandline_argument);
+			hasend = true;
+			break;
+		case 'i':
+			writeindex = true;
+			break;
+		case 'n':
+			select = isc_commandline_argument;
+			break;
+		case 's':
+			begin = parse_serial(isc_commandline_argument);
+			hasbegin = true;
+			break;
 		case 'u':
 			upgrade = true;
 			break;
@@ -110,6 +142,16 @@ main(int argc, char **argv) {
 	}
 	file = argv[0];
 
+	if (select != NULL) {
+		name = dns_fixedname_initname(&fixed);
+		result = dns_name_fromstring(name, select, 0, NULL);
+		if (result != ISC_R_SUCCESS) {
+			fprintf(stderr, "invalid name: %s: %s\n", select,
+				isc_result_totext(result));
+			exit(1);
+		}
+	}
+
 	isc_mem_create(&mctx);
 	RUNTIME_CHECK(setup_logging(mctx, stderr, &lctx) == ISC_R_SUCCESS);
 
@@ -122,8 +164,15 @@ main(int argc, char **argv) {
 	} else if (compact) {
 		flags = 0;
 		result = dns_journal_compact(mctx, file, serial, flags, 0);
+	} else if (writeindex) {
+		result = dns_journal_writeindex(mctx, file);
+		if (result == DNS_R_NOJOURNAL) {
+			fprintf(stderr, "%s\n", isc_result_totext(result));
+		}
 	} else {
-		result = dns_journal_print(mctx, flags, file, stdout);
+		result = dns_journal_printselect(
+			mctx, flags, file, hasbegin ? &begin : NULL,
+			hasend ? &end : NULL, name, stdout);
 		if (result == DNS_R_NOJOURNAL) {
 			fprintf(stderr, "%s\n", isc_result_totext(result));
 		}
@@ -267,6 +267,17 @@ dlz_allowzonexfr(void *dbdata, const char *name, const char *client);
 isc_result_t
 dlz_allnodes(const char *zone, void *dbdata, dns_sdlzallnodes_t *allnodes);
 
+/*
+ * dlz_allnodes_from() is optional.  It can be supplied instead of
+ * dlz_allnodes() to return the nodes of a zone in chunks of 'maxnodes'
+ * names, in DNSSEC canonical order, starting at 'start' (or at the zone
+ * apex if 'start' is NULL), so that the whole zone is never held in
+ * memory at once
+ */
+isc_result_t
+dlz_allnodes_from(const char *zone, const char *start, unsigned int maxnodes,
+		  void *dbdata, dns_sdlzallnodes_t *allnodes);
+
 /*
  * dlz_newversion() is optional. It should be supplied if you want to
  * support dynamic updates.
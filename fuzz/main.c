@@ -18,6 +18,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "fuzz.h"
@@ -26,6 +27,146 @@
 
 #include <dirent.h>
 
+/*
+ * Performance mode (-p): instead of running every input once, run each
+ * one in a timed loop and report the inputs whose cost per byte is far
+ * above that of the rest of the corpus.  Such inputs usually trigger
+ * algorithmic complexity problems (quadratic compression pointer
+ * chasing, lexer backtracking, ...) which are also denial of service
+ * vectors.
+ *
+ * The fixed per-call cost of a target is estimated as the cost of the
+ * fastest input, and only the remainder is divided by the input size;
+ * otherwise the smallest inputs would always look the most expensive.
+ */
+typedef struct {
+	char *filename;
+	size_t size;
+	double ns;	/* per call */
+	double perbyte; /* per byte, above the fixed cost */
+} perf_t;
+
+static bool perf = false;
+static double perf_factor = 10.0;
+static uint64_t perf_mintime = 10 * 1000000; /* ns per input */
+static perf_t *perf_results = NULL;
+static size_t perf_count = 0;
+static size_t perf_alloc = 0;
+
+static uint64_t
+perf_now(void) {
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+		perror("clock_gettime");
+		exit(1);
+	}
+
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+static void
+perf_one_input(const char *filename, const uint8_t *data, size_t size) {
+	uint64_t runs = 1, elapsed;
+
+	/*
+	 * Warm up, then double the number of runs until the loop takes
+	 * long enough to be measured reliably.
+	 */
+	LLVMFuzzerTestOneInput(data, size);
+	for (;;) {
+		uint64_t start = perf_now();
+
+		for (uint64_t i = 0; i < runs; i++) {
+			LLVMFuzzerTestOneInput(data, size);
+		}
+		elapsed = perf_now() - start;
+		if (elapsed >= perf_mintime) {
+			break;
+		}
+		runs *= 2;
+	}
+
+	if (perf_count == perf_alloc) {
+		perf_alloc = (perf_alloc == 0) ? 256 : perf_alloc * 2;
+		perf_results = realloc(perf_results,
+				       perf_alloc * sizeof(perf_results[0]));
+		if (perf_results == NULL) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	perf_results[perf_count++] = (perf_t){
+		.filename = strdup(filename),
+		.size = size,
+		.ns = (double)elapsed / runs,
+	};
+}
+
+static int
+perf_compare(const void *a, const void *b) {
+	const perf_t *pa = a, *pb = b;
+
+	if (pa->perbyte != pb->perbyte) {
+		return (pa->perbyte < pb->perbyte ? 1 : -1);
+	}
+	return (strcmp(pa->filename, pb->filename));
+}
+
+/*
+ * Print the results and return the number of pathological inputs.
+ */
+static int
+perf_report(void) {
+	double fixed, median;
+	int slow = 0;
+
+	if (perf_count == 0) {
+		fprintf(stderr, "no inputs\n");
+		return (0);
+	}
+
+	fixed = perf_results[0].ns;
+	for (size_t i = 1; i < perf_count; i++) {
+		if (perf_results[i].ns < fixed) {
+			fixed = perf_results[i].ns;
+		}
+	}
+	for (size_t i = 0; i < perf_count; i++) {
+		perf_t *r = &perf_results[i];
+		size_t size = (r->size > 0) ? r->size : 1;
+
+		r->perbyte = (r->ns - fixed) / size;
+	}
+
+	qsort(perf_results, perf_count, sizeof(perf_results[0]),
+	      perf_compare);
+	median = perf_results[perf_count / 2].perbyte;
+
+	printf("%zu inputs, fixed cost %.1f ns/call, "
+	       "median %.2f ns/byte\n",
+	       perf_count, fixed, median);
+	for (size_t i = 0; i < perf_count; i++) {
+		perf_t *r = &perf_results[i];
+		bool pathological = (r->perbyte > median * perf_factor &&
+				     r->perbyte > 1.0);
+
+		if (pathological) {
+			slow++;
+		}
+		if (pathological || debug) {
+			printf("%s %12.1f ns/call %10.2f ns/byte %8zu bytes "
+			       "%s\n",
+			       pathological ? "SLOW" : "    ", r->ns,
+			       r->perbyte, r->size, r->filename);
+		}
+		free(r->filename);
+	}
+	free(perf_results);
+
+	return (slow);
+}
+
 static void
 test_one_file(const char *filename) {
 	int fd;
@@ -47,7 +188,9 @@ test_one_file(const char *filename) {
 
 	data = malloc(st.st_size);
 	n = read(fd, data, st.st_size);
-	if (n == st.st_size) {
+	if (n == st.st_size && perf) {
+		perf_one_input(filename, (const uint8_t *)data, n);
+	} else if (n == st.st_size) {
 		printf("testing %zd bytes from %s\n", n, filename);
 		fflush(stdout);
 		LLVMFuzzerTestOneInput((const uint8_t *)data, n);
@@ -95,24 +238,49 @@ test_all_from(const char *dirname) {
 int
 main(int argc, char **argv) {
 	char corpusdir[PATH_MAX];
+	const char *progname = argv[0];
 	const char *target = strrchr(argv[0], '/');
 
 	(void)LLVMFuzzerInitialize(&argc, &argv);
 
-	if (argv[1] != NULL && strcmp(argv[1], "-d") == 0) {
-		debug = true;
+	while (argv[1] != NULL && argv[1][0] == '-') {
+		if (strcmp(argv[1], "-d") == 0) {
+			debug = true;
+		} else if (strcmp(argv[1], "-p") == 0) {
+			perf = true;
+		} else if (strcmp(argv[1], "-f") == 0 && argv[2] != NULL) {
+			perf_factor = strtod(argv[2], NULL);
+			argv++;
+			argc--;
+		} else if (strcmp(argv[1], "-t") == 0 && argv[2] != NULL) {
+			perf_mintime = strtoull(argv[2], NULL, 10) * 1000000;
+			argv++;
+			argc--;
+		} else {
+			fprintf(stderr,
+				"usage: %s [-d] [-p [-f factor] [-t msec]] "
+				"[file|directory ...]\n",
+				progname);
+			return (1);
+		}
 		argv++;
 		argc--;
 	}
 
 	if (argv[1] != NULL) {
 		while (argv[1] != NULL) {
-			test_one_file(argv[1]);
+			struct stat st;
+
+			if (stat(argv[1], &st) == 0 && S_ISDIR(st.st_mode)) {
+				test_all_from(argv[1]);
+			} else {
+				test_one_file(argv[1]);
+			}
 			argv++;
 			argc--;
 		}
 		POST(argc);
-		return (0);
+		return (perf && perf_report() != 0 ? 1 : 0);
 	}
 
 	target = (target != NULL) ? target + 1 : argv[0];
@@ -124,7 +292,7 @@ main(int argc, char **argv) {
 
 	test_all_from(corpusdir);
 
-	return (0);
+	return (perf && perf_report() != 0 ? 1 : 0);
 }
 
 #elif __AFL_COMPILER
@@ -2717,8 +2717,9 @@ check_nonzero(const cfg_obj_t *options, isc_log_t *logctx) {
 	unsigned int i;
 
 	static const char *nonzero[] = { "max-retry-time", "min-retry-time",
-					 "max-refresh-time",
-					 "min-refresh-time" };
+					 "max-refresh-time", "min-refresh-time",
+					 "concurrent-zone-loads",
+					 "concurrent-zone-dumps" };
 	/*
 	 * Check if value is zero.
 	 */
@@ -3771,6 +3772,42 @@ check_zoneconf(const cfg_obj_t *zconfig, const cfg_obj_t *voptions,
 		result = tresult;
 	}
 
+	/*
+	 * The "qp" database does not keep track of when records need to be
+	 * re-signed, so it cannot be used for zones that are signed
+	 * automatically.
+	 */
+	obj = NULL;
+	tresult = cfg_map_get(zoptions, "database", &obj);
+	if (tresult == ISC_R_SUCCESS &&
+	    strcmp("qp", cfg_obj_asstring(obj)) == 0)
+	{
+		const cfg_obj_t *signobj = NULL;
+		const char *autodnssec = "off";
+		bool inlinesigning = false;
+
+		(void)cfg_map_get(zoptions, "inline-signing", &signobj);
+		if (signobj != NULL) {
+			inlinesigning = cfg_obj_asboolean(signobj);
+		}
+		signobj = NULL;
+		(void)cfg_map_get(zoptions, "auto-dnssec", &signobj);
+		if (signobj != NULL) {
+			autodnssec = cfg_obj_asstring(signobj);
+		}
+
+		if (has_dnssecpolicy || inlinesigning ||
+		    strcasecmp(autodnssec, "off") != 0)
+		{
+			cfg_obj_log(obj, logctx, ISC_LOG_ERROR,
+				    "zone '%s': 'database \"qp\"' cannot be "
+				    "used with 'dnssec-policy', "
+				    "'inline-signing' or 'auto-dnssec'",
+				    znamestr);
+			result = ISC_R_FAILURE;
+		}
+	}
+
 	/*
 	 * If the zone type is rbt then primary/hint zones require file
 	 * clauses. If inline-signing is used, then secondary zones require a
@@ -3793,7 +3830,8 @@ check_zoneconf(const cfg_obj_t *zconfig, const cfg_obj_t *voptions,
 		result = ISC_R_FAILURE;
 	} else if (!dlz && (tresult == ISC_R_NOTFOUND ||
 			    (tresult == ISC_R_SUCCESS &&
-			     strcmp("rbt", cfg_obj_asstring(obj)) == 0)))
+			     (strcmp("rbt", cfg_obj_asstring(obj)) == 0 ||
+			      strcmp("qp", cfg_obj_asstring(obj)) == 0))))
 	{
 		isc_result_t res1;
 		const cfg_obj_t *fileobj = NULL;
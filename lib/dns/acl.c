@@ -206,7 +206,7 @@ dns_acl_match(const isc_netaddr_t *reqaddr, const dns_name_t *reqsigner,
 	*match = 0;
 
 	/* Search radix. */
-	result = isc_radix_search(acl->iptable->radix, &node, &pfx);
+	result = dns_iptable_search(acl->iptable, &pfx, &node);
 
 	/* Found a match. */
 	if (result == ISC_R_SUCCESS && node != NULL) {
@@ -861,3 +861,308 @@ dns_acl_merge_ports_transports(dns_acl_t *dest, dns_acl_t *source, bool pos) {
 					    next->encrypted, add_negative);
 	}
 }
+
+/*
+ * The index splits each address family into the elementary ranges
+ * delimited by the first and last address of every prefix of every
+ * indexed ACL.  Within one range every prefix either covers all the
+ * addresses or none, so each ACL gives the same answer for all of them;
+ * the index stores the first address of each range together with the
+ * set of ACLs that allow it, and a lookup is a binary search.
+ */
+#define ACLINDEX_MAGIC	  ISC_MAGIC('D', 'a', 'c', 'x')
+#define ACLINDEX_VALID(a) ISC_MAGIC_VALID(a, ACLINDEX_MAGIC)
+
+struct dns_aclindex {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	uint64_t indexed;
+	size_t alloc4, count4;
+	uint32_t *start4;
+	uint64_t *match4;
+	size_t alloc6, count6;
+	struct in6_addr *start6;
+	uint64_t *match6;
+};
+
+typedef struct {
+	isc_mem_t *mctx;
+	size_t count;
+	size_t alloc;
+	size_t size;
+	unsigned char *base;
+} aclindex_array_t;
+
+static void *
+array_push(aclindex_array_t *array) {
+	if (array->count == array->alloc) {
+		size_t alloc = ISC_MAX(array->alloc * 2, 16);
+		array->base = isc_mem_reget(array->mctx, array->base,
+					    array->alloc * array->size,
+					    alloc * array->size);
+		array->alloc = alloc;
+	}
+	return (array->base + array->count++ * array->size);
+}
+
+static int
+cmp_start4(const void *a, const void *b) {
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return ((x > y) - (x < y));
+}
+
+static int
+cmp_start6(const void *a, const void *b) {
+	return (memcmp(a, b, sizeof(struct in6_addr)));
+}
+
+/*
+ * Set 'end' to the first address after the IPv6 prefix 'start'/'bitlen'.
+ * Returns false if the prefix reaches the end of the address space.
+ */
+static bool
+prefix_end6(const struct in6_addr *start, unsigned int bitlen,
+	    struct in6_addr *end) {
+	unsigned int i = (bitlen - 1) / 8;
+	unsigned int carry = 0x80 >> ((bitlen - 1) % 8);
+
+	*end = *start;
+	while (carry != 0) {
+		carry += end->s6_addr[i];
+		end->s6_addr[i] = carry & 0xff;
+		carry >>= 8;
+		if (i-- == 0) {
+			return (carry == 0);
+		}
+	}
+
+	return (true);
+}
+
+static uint64_t
+aclindex_allowed(dns_acl_t *const *acls, uint64_t indexed,
+		 isc_netaddr_t *addr) {
+	uint64_t match = 0;
+
+	for (unsigned int i = 0; i < DNS_ACLINDEX_MAX; i++) {
+		uint64_t bit = (uint64_t)1 << i;
+
+		if ((indexed & bit) != 0 &&
+		    dns_acl_allowed(addr, NULL, acls[i], NULL))
+		{
+			match |= bit;
+		}
+	}
+
+	return (match);
+}
+
+void
+dns_aclindex_create(isc_mem_t *mctx, dns_acl_t *const *acls,
+		    unsigned int count, dns_aclindex_t **indexp) {
+	dns_aclindex_t *index = NULL;
+	aclindex_array_t v4 = { .mctx = mctx, .size = sizeof(uint32_t) };
+	aclindex_array_t v6 = { .mctx = mctx,
+				.size = sizeof(struct in6_addr) };
+	isc_radix_node_t *node = NULL;
+	isc_netaddr_t addr;
+	uint64_t indexed = 0;
+	size_t n;
+
+	REQUIRE(indexp != NULL && *indexp == NULL);
+
+	count = ISC_MIN(count, DNS_ACLINDEX_MAX);
+	for (unsigned int i = 0; i < count; i++) {
+		if (acls[i] == NULL || acls[i]->length == 0) {
+			indexed |= (uint64_t)1 << i;
+		}
+	}
+
+	/*
+	 * Collect the range boundaries.
+	 */
+	*(uint32_t *)array_push(&v4) = 0;
+	*(struct in6_addr *)array_push(&v6) = in6addr_any;
+	for (unsigned int i = 0; i < count; i++) {
+		if ((indexed & ((uint64_t)1 << i)) == 0 || acls[i] == NULL) {
+			continue;
+		}
+
+		RADIX_WALK(acls[i]->iptable->radix->head, node) {
+			isc_prefix_t *prefix = node->prefix;
+
+			if (prefix->family == AF_INET && prefix->bitlen > 0) {
+				uint32_t start = ntohl(prefix->add.sin.s_addr);
+				uint64_t end;
+
+				start &= 0xffffffffU << (32 - prefix->bitlen);
+				end = (uint64_t)start +
+				      ((uint64_t)1 << (32 - prefix->bitlen));
+				*(uint32_t *)array_push(&v4) = start;
+				if (end <= 0xffffffffU) {
+					*(uint32_t *)array_push(&v4) = end;
+				}
+			} else if (prefix->family == AF_INET6 &&
+				   prefix->bitlen > 0)
+			{
+				struct in6_addr start = prefix->add.sin6;
+				struct in6_addr end;
+				unsigned int bits = prefix->bitlen;
+
+				for (unsigned int b = 0; b < 16; b++) {
+					unsigned int keep = ISC_MIN(bits, 8);
+					start.s6_addr[b] &= 0xff00 >> keep;
+					bits -= keep;
+				}
+				*(struct in6_addr *)array_push(&v6) = start;
+				if (prefix_end6(&start, prefix->bitlen, &end)) {
+					*(struct in6_addr *)array_push(&v6) =
+						end;
+				}
+			}
+		}
+		RADIX_WALK_END;
+	}
+
+	qsort(v4.base, v4.count, v4.size, cmp_start4);
+	qsort(v6.base, v6.count, v6.size, cmp_start6);
+
+	index = isc_mem_get(mctx, sizeof(*index));
+	*index = (dns_aclindex_t){
+		.indexed = indexed,
+		.alloc4 = v4.count,
+		.start4 = isc_mem_get(mctx, v4.count * sizeof(uint32_t)),
+		.match4 = isc_mem_get(mctx, v4.count * sizeof(uint64_t)),
+		.alloc6 = v6.count,
+		.start6 = isc_mem_get(mctx,
+				      v6.count * sizeof(struct in6_addr)),
+		.match6 = isc_mem_get(mctx, v6.count * sizeof(uint64_t)),
+	};
+
+	/*
+	 * Evaluate the ACLs once per range, merging adjacent ranges
+	 * that are allowed by the same ACLs.
+	 */
+	n = 0;
+	for (size_t i = 0; i < v4.count; i++) {
+		uint32_t start = ((uint32_t *)v4.base)[i];
+		struct in_addr in = { .s_addr = htonl(start) };
+		uint64_t match;
+
+		if (n > 0 && index->start4[n - 1] == start) {
+			continue;
+		}
+		isc_netaddr_fromin(&addr, &in);
+		match = aclindex_allowed(acls, indexed, &addr);
+		if (n > 0 && index->match4[n - 1] == match) {
+			continue;
+		}
+		index->start4[n] = start;
+		index->match4[n] = match;
+		n++;
+	}
+	index->count4 = n;
+
+	n = 0;
+	for (size_t i = 0; i < v6.count; i++) {
+		struct in6_addr *start = &((struct in6_addr *)v6.base)[i];
+		uint64_t match;
+
+		if (n > 0 && cmp_start6(&index->start6[n - 1], start) == 0) {
+			continue;
+		}
+		isc_netaddr_fromin6(&addr, start);
+		match = aclindex_allowed(acls, indexed, &addr);
+		if (n > 0 && index->match6[n - 1] == match) {
+			continue;
+		}
+		index->start6[n] = *start;
+		index->match6[n] = match;
+		n++;
+	}
+	index->count6 = n;
+
+	isc_mem_put(mctx, v4.base, v4.alloc * v4.size);
+	isc_mem_put(mctx, v6.base, v6.alloc * v6.size);
+
+	isc_mem_attach(mctx, &index->mctx);
+	index->magic = ACLINDEX_MAGIC;
+	*indexp = index;
+}
+
+uint64_t
+dns_aclindex_indexed(const dns_aclindex_t *index) {
+	REQUIRE(ACLINDEX_VALID(index));
+
+	return (index->indexed);
+}
+
+uint64_t
+dns_aclindex_match(const dns_aclindex_t *index, const isc_netaddr_t *addr,
+		   const dns_aclenv_t *env) {
+	isc_netaddr_t v4addr;
+	size_t lo = 0, hi;
+
+	REQUIRE(ACLINDEX_VALID(index));
+	REQUIRE(addr != NULL);
+	REQUIRE(addr->family == AF_INET || addr->family == AF_INET6);
+
+	if (env != NULL && env->match_mapped && addr->family == AF_INET6 &&
+	    IN6_IS_ADDR_V4MAPPED(&addr->type.in6))
+	{
+		isc_netaddr_fromv4mapped(&v4addr, addr);
+		addr = &v4addr;
+	}
+
+	/*
+	 * Find the last range starting at or before the address; the
+	 * first range of each family starts at the lowest address.
+	 */
+	if (addr->family == AF_INET) {
+		uint32_t a = ntohl(addr->type.in.s_addr);
+
+		hi = index->count4;
+		while (hi - lo > 1) {
+			size_t mid = lo + (hi - lo) / 2;
+			if (index->start4[mid] <= a) {
+				lo = mid;
+			} else {
+				hi = mid;
+			}
+		}
+		return (index->match4[lo]);
+	}
+
+	hi = index->count6;
+	while (hi - lo > 1) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (cmp_start6(&index->start6[mid], &addr->type.in6) <= 0) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+	return (index->match6[lo]);
+}
+
+void
+dns_aclindex_destroy(dns_aclindex_t **indexp) {
+	dns_aclindex_t *index = NULL;
+
+	REQUIRE(indexp != NULL && ACLINDEX_VALID(*indexp));
+
+	index = *indexp;
+	*indexp = NULL;
+
+	index->magic = 0;
+	isc_mem_put(index->mctx, index->start4,
+		    index->alloc4 * sizeof(index->start4[0]));
+	isc_mem_put(index->mctx, index->match4,
+		    index->alloc4 * sizeof(index->match4[0]));
+	isc_mem_put(index->mctx, index->start6,
+		    index->alloc6 * sizeof(index->start6[0]));
+	isc_mem_put(index->mctx, index->match6,
+		    index->alloc6 * sizeof(index->match6[0]));
+	isc_mem_putanddetach(&index->mctx, index, sizeof(*index));
+}
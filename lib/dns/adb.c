@@ -23,8 +23,11 @@
 #include <inttypes.h>
 #include <limits.h>
 #include <stdbool.h>
+#include <stdlib.h>
 
 #include <isc/atomic.h>
+#include <isc/buffer.h>
+#include <isc/hashmap.h>
 #include <isc/ht.h>
 #include <isc/mutexblock.h>
 #include <isc/netaddr.h>
@@ -32,6 +35,7 @@
 #include <isc/random.h>
 #include <isc/result.h>
 #include <isc/stats.h>
+#include <isc/sockaddr.h>
 #include <isc/string.h>
 #include <isc/task.h>
 #include <isc/util.h>
@@ -46,6 +50,7 @@
 #include <dns/rdatatype.h>
 #include <dns/resolver.h>
 #include <dns/stats.h>
+#include <dns/time.h>
 
 /* Detailed logging of attach/detach */
 #ifndef ADB_TRACE
@@ -113,7 +118,7 @@ struct dns_adb {
 	isc_ht_t *namebuckets;
 	isc_rwlock_t names_lock;
 
-	isc_ht_t *entrybuckets;
+	isc_hashmap_t *entrybuckets;
 	isc_rwlock_t entries_lock;
 
 	isc_stats_t *stats;
@@ -233,16 +238,27 @@ struct dns_adbentry {
 	dns_adbentrybucket_t *bucket;
 
 	unsigned int nh;
-	unsigned int flags;
-	unsigned int srtt;
+
+	/*
+	 * These are updated after every response from the server;
+	 * they are atomic so that that doesn't need the bucket lock.
+	 * 'ednsstats' holds the four 8-bit counters of EDNS and
+	 * plain DNS responses and timeouts, ENTRY_EDNS_* below.
+	 */
+	atomic_uint_fast32_t flags;
+	atomic_uint_fast32_t srtt;
+	atomic_uint_fast32_t rttvar;
+	atomic_uint_fast32_t failrate;
+	atomic_uint_fast32_t ednsstats;
+	atomic_uint_fast32_t udpsize;
+
+	/* Per-server statistics, see dns_adb_serverstats() */
+	atomic_uint_fast64_t counters[dns_adbserver_max];
+	atomic_uint_fast64_t rtt[DNS_ADB_RTTBUCKETS];
+
+	/* Only used when fetches-per-server is set; see adjust_quota() */
 	unsigned int completed;
 	unsigned int timeouts;
-	unsigned char plain;
-	unsigned char plainto;
-	unsigned char edns;
-	unsigned char ednsto;
-	uint16_t udpsize;
-
 	uint8_t mode;
 	atomic_uint_fast32_t quota;
 	atomic_uint_fast32_t active;
@@ -252,8 +268,8 @@ struct dns_adbentry {
 	unsigned char *cookie;
 	uint16_t cookielen;
 
-	isc_stdtime_t expires;
-	isc_stdtime_t lastage;
+	atomic_uint_fast32_t expires;
+	atomic_uint_fast32_t lastage;
 	/*%<
 	 * A nonzero 'expires' field indicates that the entry should
 	 * persist until that time.  This allows entries found
@@ -271,6 +287,7 @@ struct dns_adbentry {
  * Hash bucket for dns_adbentry objects.
  */
 struct dns_adbentrybucket {
+	isc_sockaddr_t sockaddr; /* the hash table key */
 	dns_adbentrylist_t entries;
 	dns_adbentrylist_t deadentries;
 	isc_mutex_t lock;
@@ -299,7 +316,7 @@ new_adbentry(dns_adb_t *);
 static void
 free_adbentry(dns_adbentry_t **);
 static dns_adbentrybucket_t *
-new_adbentrybucket(dns_adb_t *adb);
+new_adbentrybucket(dns_adb_t *adb, const isc_sockaddr_t *addr);
 static dns_adbfind_t *
 new_adbfind(dns_adb_t *, in_port_t);
 static void
@@ -366,6 +383,8 @@ static void
 adjustsrtt(dns_adbaddrinfo_t *addr, unsigned int rtt, unsigned int factor,
 	   isc_stdtime_t now);
 static void
+setexpires(dns_adbentry_t *entry, isc_stdtime_t now);
+static void
 log_quota(dns_adbentry_t *entry, const char *fmt, ...) ISC_FORMAT_PRINTF(2, 3);
 
 /*
@@ -390,6 +409,15 @@ log_quota(dns_adbentry_t *entry, const char *fmt, ...) ISC_FORMAT_PRINTF(2, 3);
  */
 #define ENTRY_IS_DEAD 0x00400000
 
+/*
+ * Shifts of the counters in entry->ednsstats.
+ */
+#define ENTRY_EDNS_EDNS	   0
+#define ENTRY_EDNS_EDNSTO  8
+#define ENTRY_EDNS_PLAIN   16
+#define ENTRY_EDNS_PLAINTO 24
+#define EDNSSTAT(v, shift) ((unsigned int)((v) >> (shift)) & 0xff)
+
 /*
  * To the name, address classes are all that really exist.  If it has a
  * V6 address it doesn't care if it came from a AAAA query.
@@ -897,6 +925,8 @@ link_entry(dns_adbentrybucket_t *ebucket, dns_adbentry_t *entry) {
 
 		for (i = 0; i < 2; i++) {
 			dns_adbentry_t *e = ISC_LIST_TAIL(ebucket->entries);
+			uint_fast32_t flags;
+
 			if (e == NULL) {
 				break;
 			}
@@ -912,8 +942,9 @@ link_entry(dns_adbentrybucket_t *ebucket, dns_adbentry_t *entry) {
 				continue;
 			}
 
-			INSIST((e->flags & ENTRY_IS_DEAD) == 0);
-			e->flags |= ENTRY_IS_DEAD;
+			flags = atomic_fetch_or_relaxed(&e->flags,
+							ENTRY_IS_DEAD);
+			INSIST((flags & ENTRY_IS_DEAD) == 0);
 			ISC_LIST_UNLINK(ebucket->entries, e, plink);
 			ISC_LIST_PREPEND(ebucket->deadentries, e, plink);
 		}
@@ -941,7 +972,7 @@ unlink_entry(dns_adbentry_t *entry) {
 
 	DP(DEF_LEVEL, "unlink ADB entry %p from bucket %p", entry, ebucket);
 
-	if ((entry->flags & ENTRY_IS_DEAD) != 0) {
+	if ((atomic_load_relaxed(&entry->flags) & ENTRY_IS_DEAD) != 0) {
 		ISC_LIST_UNLINK(ebucket->deadentries, entry, plink);
 	} else {
 		ISC_LIST_UNLINK(ebucket->entries, entry, plink);
@@ -991,18 +1022,18 @@ shutdown_names(dns_adb_t *adb) {
 static void
 shutdown_entries(dns_adb_t *adb) {
 	isc_result_t result;
-	isc_ht_iter_t *iter = NULL;
+	isc_hashmap_iter_t *iter = NULL;
 
 	RWLOCK(&adb->entries_lock, isc_rwlocktype_read);
-	isc_ht_iter_create(adb->entrybuckets, &iter);
-	for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
-	     result = isc_ht_iter_next(iter))
+	isc_hashmap_iter_create(adb->entrybuckets, &iter);
+	for (result = isc_hashmap_iter_first(iter); result == ISC_R_SUCCESS;
+	     result = isc_hashmap_iter_next(iter))
 	{
 		dns_adbentrybucket_t *ebucket = NULL;
 		dns_adbentry_t *entry = NULL;
 		dns_adbentry_t *next_entry = NULL;
 
-		isc_ht_iter_current(iter, (void **)&ebucket);
+		isc_hashmap_iter_current(iter, (void **)&ebucket);
 		INSIST(ebucket != NULL);
 
 		LOCK(&ebucket->lock);
@@ -1014,7 +1045,8 @@ shutdown_entries(dns_adb_t *adb) {
 			 */
 			next_entry = ISC_LIST_NEXT(entry, plink);
 			if (isc_refcount_current(&entry->references) == 1 &&
-			    entry->expires == 0) {
+			    atomic_load_relaxed(&entry->expires) == 0)
+			{
 				unlink_entry(entry);
 			}
 			entry_detach(&entry);
@@ -1025,7 +1057,7 @@ shutdown_entries(dns_adb_t *adb) {
 	}
 	RWUNLOCK(&adb->entries_lock, isc_rwlocktype_read);
 
-	isc_ht_iter_destroy(&iter);
+	isc_hashmap_iter_destroy(&iter);
 }
 
 /*
@@ -1401,15 +1433,27 @@ new_adbentry(dns_adb_t *adb) {
 	dns_adbentry_t *entry = NULL;
 
 	entry = isc_mem_get(adb->mctx, sizeof(*entry));
-	*entry = (dns_adbentry_t){
-		.srtt = isc_random_uniform(0x1f) + 1,
-	};
+	*entry = (dns_adbentry_t){ 0 };
 
 	dns_adb_attach(adb, &entry->adb);
 
 	isc_refcount_init(&entry->references, 1);
+	atomic_init(&entry->flags, 0);
+	atomic_init(&entry->srtt, isc_random_uniform(0x1f) + 1);
+	atomic_init(&entry->rttvar, 0);
+	atomic_init(&entry->failrate, 0);
+	atomic_init(&entry->ednsstats, 0);
+	atomic_init(&entry->udpsize, 0);
+	atomic_init(&entry->expires, 0);
+	atomic_init(&entry->lastage, 0);
 	atomic_init(&entry->active, 0);
 	atomic_init(&entry->quota, adb->quota);
+	for (size_t i = 0; i < ARRAY_SIZE(entry->counters); i++) {
+		atomic_init(&entry->counters[i], 0);
+	}
+	for (size_t i = 0; i < ARRAY_SIZE(entry->rtt); i++) {
+		atomic_init(&entry->rtt[i], 0);
+	}
 
 	ISC_LIST_INIT(entry->lameinfo);
 	ISC_LINK_INIT(entry, plink);
@@ -1457,11 +1501,12 @@ free_adbentry(dns_adbentry_t **entryp) {
 }
 
 static dns_adbentrybucket_t *
-new_adbentrybucket(dns_adb_t *adb) {
+new_adbentrybucket(dns_adb_t *adb, const isc_sockaddr_t *addr) {
 	dns_adbentrybucket_t *ebucket = NULL;
 
 	ebucket = isc_mem_get(adb->mctx, sizeof(*ebucket));
 	*ebucket = (dns_adbentrybucket_t){
+		.sockaddr = *addr,
 		.references = 0, /* workaround for old gcc */
 	};
 
@@ -1562,9 +1607,13 @@ new_adbaddrinfo(dns_adb_t *adb, dns_adbentry_t *entry, in_port_t port) {
 	dns_adbaddrinfo_t *ai = NULL;
 
 	ai = isc_mem_get(adb->mctx, sizeof(*ai));
-	*ai = (dns_adbaddrinfo_t){ .srtt = entry->srtt,
-				   .flags = entry->flags,
-				   .dscp = -1 };
+	*ai = (dns_adbaddrinfo_t){
+		.srtt = atomic_load_relaxed(&entry->srtt),
+		.rttvar = atomic_load_relaxed(&entry->rttvar),
+		.failrate = atomic_load_relaxed(&entry->failrate),
+		.flags = atomic_load_relaxed(&entry->flags),
+		.dscp = -1,
+	};
 
 	ISC_LINK_INIT(ai, publink);
 	entry_attach(entry, &ai->entry);
@@ -1656,16 +1705,17 @@ get_entrybucket(dns_adb_t *adb, const isc_sockaddr_t *addr,
 	REQUIRE(ebucketp != NULL && *ebucketp == NULL);
 
 	RWLOCK(&adb->entries_lock, isc_rwlocktype_write);
-	result = isc_ht_find(adb->entrybuckets, (const unsigned char *)addr,
-			     sizeof(*addr), (void **)&ebucket);
+	result = isc_hashmap_find(adb->entrybuckets, (const uint8_t *)addr,
+				  sizeof(*addr), (void **)&ebucket);
 	if (result == ISC_R_NOTFOUND) {
 		/*
-		 * Allocate a new bucket and add it to the hash table.
+		 * Allocate a new bucket and add it to the hash table,
+		 * keyed by the copy of the address in the bucket.
 		 */
-		ebucket = new_adbentrybucket(adb);
-		result = isc_ht_add(adb->entrybuckets,
-				    (const unsigned char *)addr, sizeof(*addr),
-				    ebucket);
+		ebucket = new_adbentrybucket(adb, addr);
+		result = isc_hashmap_add(adb->entrybuckets,
+					 (const uint8_t *)&ebucket->sockaddr,
+					 sizeof(ebucket->sockaddr), ebucket);
 	}
 	RWUNLOCK(&adb->entries_lock, isc_rwlocktype_write);
 	INSIST(result == ISC_R_SUCCESS);
@@ -1942,6 +1992,7 @@ purge_stale_names(dns_adb_t *adb, dns_adbnamebucket_t *nbucket,
 static void
 maybe_expire_entry(dns_adbentry_t **entryp, isc_stdtime_t now) {
 	dns_adbentry_t *entry = NULL;
+	isc_stdtime_t expires;
 
 	REQUIRE(entryp != NULL && DNS_ADBENTRY_VALID(*entryp));
 
@@ -1951,7 +2002,8 @@ maybe_expire_entry(dns_adbentry_t **entryp, isc_stdtime_t now) {
 		return;
 	}
 
-	if (entry->expires == 0 || entry->expires > now) {
+	expires = atomic_load_relaxed(&entry->expires);
+	if (expires == 0 || expires > now) {
 		return;
 	}
 
@@ -2016,6 +2068,7 @@ static void
 clean_hashes(dns_adb_t *adb, isc_stdtime_t now) {
 	isc_result_t result;
 	isc_ht_iter_t *it = NULL;
+	isc_hashmap_iter_t *eit = NULL;
 
 	RWLOCK(&adb->names_lock, isc_rwlocktype_read);
 	isc_ht_iter_create(adb->namebuckets, &it);
@@ -2030,15 +2083,15 @@ clean_hashes(dns_adb_t *adb, isc_stdtime_t now) {
 	RWUNLOCK(&adb->names_lock, isc_rwlocktype_read);
 
 	RWLOCK(&adb->entries_lock, isc_rwlocktype_read);
-	isc_ht_iter_create(adb->entrybuckets, &it);
-	for (result = isc_ht_iter_first(it); result == ISC_R_SUCCESS;
-	     result = isc_ht_iter_next(it))
+	isc_hashmap_iter_create(adb->entrybuckets, &eit);
+	for (result = isc_hashmap_iter_first(eit); result == ISC_R_SUCCESS;
+	     result = isc_hashmap_iter_next(eit))
 	{
 		dns_adbentrybucket_t *ebucket = NULL;
-		isc_ht_iter_current(it, (void **)&ebucket);
+		isc_hashmap_iter_current(eit, (void **)&ebucket);
 		cleanup_entries(ebucket, now);
 	}
-	isc_ht_iter_destroy(&it);
+	isc_hashmap_iter_destroy(&eit);
 	RWUNLOCK(&adb->entries_lock, isc_rwlocktype_read);
 }
 
@@ -2046,6 +2099,7 @@ static void
 destroy(dns_adb_t *adb) {
 	isc_result_t result;
 	isc_ht_iter_t *it = NULL;
+	isc_hashmap_iter_t *eit = NULL;
 
 	DP(DEF_LEVEL, "destroying ADB %p", adb);
 
@@ -2069,19 +2123,19 @@ destroy(dns_adb_t *adb) {
 	isc_rwlock_destroy(&adb->names_lock);
 
 	RWLOCK(&adb->entries_lock, isc_rwlocktype_write);
-	isc_ht_iter_create(adb->entrybuckets, &it);
-	for (result = isc_ht_iter_first(it); result == ISC_R_SUCCESS;
-	     result = isc_ht_iter_delcurrent_next(it))
+	isc_hashmap_iter_create(adb->entrybuckets, &eit);
+	for (result = isc_hashmap_iter_first(eit); result == ISC_R_SUCCESS;
+	     result = isc_hashmap_iter_delcurrent_next(eit))
 	{
 		dns_adbentrybucket_t *ebucket = NULL;
-		isc_ht_iter_current(it, (void **)&ebucket);
+		isc_hashmap_iter_current(eit, (void **)&ebucket);
 		cleanup_entries(ebucket, INT_MAX);
 		isc_mutex_destroy(&ebucket->lock);
 		isc_refcount_destroy(&ebucket->references);
 		isc_mem_put(adb->mctx, ebucket, sizeof(*ebucket));
 	}
-	isc_ht_iter_destroy(&it);
-	isc_ht_destroy(&adb->entrybuckets);
+	isc_hashmap_iter_destroy(&eit);
+	isc_hashmap_destroy(&adb->entrybuckets);
 	RWUNLOCK(&adb->entries_lock, isc_rwlocktype_write);
 	isc_rwlock_destroy(&adb->entries_lock);
 
@@ -2127,7 +2181,8 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_taskmgr_t *taskmgr,
 	isc_ht_init(&adb->namebuckets, adb->mctx, 1, ISC_HT_CASE_INSENSITIVE);
 	isc_rwlock_init(&adb->names_lock, 0, 0);
 
-	isc_ht_init(&adb->entrybuckets, adb->mctx, 1, ISC_HT_CASE_SENSITIVE);
+	isc_hashmap_create(adb->mctx, 1, ISC_HASHMAP_CASE_SENSITIVE,
+			   &adb->entrybuckets);
 	isc_rwlock_init(&adb->entries_lock, 0, 0);
 
 	isc_mutex_init(&adb->lock);
@@ -2148,7 +2203,7 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_taskmgr_t *taskmgr,
 	}
 
 	set_adbstat(adb, isc_ht_count(adb->namebuckets), dns_adbstats_nnames);
-	set_adbstat(adb, isc_ht_count(adb->entrybuckets),
+	set_adbstat(adb, isc_hashmap_count(adb->entrybuckets),
 		    dns_adbstats_nentries);
 
 	/*
@@ -2165,7 +2220,7 @@ free_lock:
 	isc_mutex_destroy(&adb->lock);
 
 	isc_rwlock_destroy(&adb->entries_lock);
-	isc_ht_destroy(&adb->entrybuckets);
+	isc_hashmap_destroy(&adb->entrybuckets);
 
 	isc_rwlock_destroy(&adb->names_lock);
 	isc_ht_destroy(&adb->namebuckets);
@@ -2728,6 +2783,7 @@ static void
 dump_adb(dns_adb_t *adb, FILE *f, bool debug, isc_stdtime_t now) {
 	isc_result_t result;
 	isc_ht_iter_t *it = NULL;
+	isc_hashmap_iter_t *eit = NULL;
 
 	fprintf(f, ";\n; Address database dump\n;\n");
 	fprintf(f, "; [edns success/timeout]\n");
@@ -2802,14 +2858,14 @@ dump_adb(dns_adb_t *adb, FILE *f, bool debug, isc_stdtime_t now) {
 	fprintf(f, ";\n; Unassociated entries\n;\n");
 
 	RWLOCK(&adb->entries_lock, isc_rwlocktype_read);
-	isc_ht_iter_create(adb->entrybuckets, &it);
-	for (result = isc_ht_iter_first(it); result == ISC_R_SUCCESS;
-	     result = isc_ht_iter_next(it))
+	isc_hashmap_iter_create(adb->entrybuckets, &eit);
+	for (result = isc_hashmap_iter_first(eit); result == ISC_R_SUCCESS;
+	     result = isc_hashmap_iter_next(eit))
 	{
 		dns_adbentrybucket_t *ebucket = NULL;
 		dns_adbentry_t *entry = NULL;
 
-		isc_ht_iter_current(it, (void **)&ebucket);
+		isc_hashmap_iter_current(eit, (void **)&ebucket);
 		LOCK(&ebucket->lock);
 
 		for (entry = ISC_LIST_HEAD(ebucket->entries); entry != NULL;
@@ -2821,7 +2877,7 @@ dump_adb(dns_adb_t *adb, FILE *f, bool debug, isc_stdtime_t now) {
 		}
 		UNLOCK(&ebucket->lock);
 	}
-	isc_ht_iter_destroy(&it);
+	isc_hashmap_iter_destroy(&eit);
 
 	RWUNLOCK(&adb->entries_lock, isc_rwlocktype_read);
 }
@@ -2833,6 +2889,8 @@ dump_entry(FILE *f, dns_adb_t *adb, dns_adbentry_t *entry, bool debug,
 	char typebuf[DNS_RDATATYPE_FORMATSIZE];
 	isc_netaddr_t netaddr;
 	dns_adblameinfo_t *li = NULL;
+	uint_fast32_t ednsstats, udpsize;
+	isc_stdtime_t expires;
 
 	isc_netaddr_fromsockaddr(&netaddr, &entry->sockaddr);
 	isc_netaddr_format(&netaddr, addrbuf, sizeof(addrbuf));
@@ -2842,13 +2900,19 @@ dump_entry(FILE *f, dns_adb_t *adb, dns_adbentry_t *entry, bool debug,
 			isc_refcount_current(&entry->references));
 	}
 
+	ednsstats = atomic_load_relaxed(&entry->ednsstats);
 	fprintf(f,
-		";\t%s [srtt %u] [flags %08x] [edns %u/%u] "
-		"[plain %u/%u]",
-		addrbuf, entry->srtt, entry->flags, entry->edns, entry->ednsto,
-		entry->plain, entry->plainto);
-	if (entry->udpsize != 0U) {
-		fprintf(f, " [udpsize %u]", entry->udpsize);
+		";\t%s [srtt %" PRIuFAST32 "] [flags %08" PRIxFAST32
+		"] [edns %u/%u] [plain %u/%u]",
+		addrbuf, atomic_load_relaxed(&entry->srtt),
+		atomic_load_relaxed(&entry->flags),
+		EDNSSTAT(ednsstats, ENTRY_EDNS_EDNS),
+		EDNSSTAT(ednsstats, ENTRY_EDNS_EDNSTO),
+		EDNSSTAT(ednsstats, ENTRY_EDNS_PLAIN),
+		EDNSSTAT(ednsstats, ENTRY_EDNS_PLAINTO));
+	udpsize = atomic_load_relaxed(&entry->udpsize);
+	if (udpsize != 0U) {
+		fprintf(f, " [udpsize %" PRIuFAST32 "]", udpsize);
 	}
 	if (entry->cookie != NULL) {
 		unsigned int i;
@@ -2858,8 +2922,9 @@ dump_entry(FILE *f, dns_adb_t *adb, dns_adbentry_t *entry, bool debug,
 		}
 		fprintf(f, "]");
 	}
-	if (entry->expires != 0) {
-		fprintf(f, " [ttl %d]", (int)(entry->expires - now));
+	expires = atomic_load_relaxed(&entry->expires);
+	if (expires != 0) {
+		fprintf(f, " [ttl %d]", (int)(expires - now));
 	}
 
 	if (adb != NULL && adb->quota != 0 && adb->atr_freq != 0) {
@@ -2994,19 +3059,19 @@ putstr(isc_buffer_t **b, const char *str) {
 isc_result_t
 dns_adb_dumpquota(dns_adb_t *adb, isc_buffer_t **buf) {
 	isc_result_t result;
-	isc_ht_iter_t *it = NULL;
+	isc_hashmap_iter_t *it = NULL;
 
 	REQUIRE(DNS_ADB_VALID(adb));
 
 	RWLOCK(&adb->entries_lock, isc_rwlocktype_read);
-	isc_ht_iter_create(adb->entrybuckets, &it);
-	for (result = isc_ht_iter_first(it); result == ISC_R_SUCCESS;
-	     result = isc_ht_iter_next(it))
+	isc_hashmap_iter_create(adb->entrybuckets, &it);
+	for (result = isc_hashmap_iter_first(it); result == ISC_R_SUCCESS;
+	     result = isc_hashmap_iter_next(it))
 	{
 		dns_adbentrybucket_t *ebucket = NULL;
 		dns_adbentry_t *entry = NULL;
 
-		isc_ht_iter_current(it, (void **)&ebucket);
+		isc_hashmap_iter_current(it, (void **)&ebucket);
 		LOCK(&ebucket->lock);
 		for (entry = ISC_LIST_HEAD(ebucket->entries); entry != NULL;
 		     entry = ISC_LIST_NEXT(entry, plink))
@@ -3031,7 +3096,7 @@ dns_adb_dumpquota(dns_adb_t *adb, isc_buffer_t **buf) {
 		UNLOCK(&ebucket->lock);
 	}
 	RWUNLOCK(&adb->entries_lock, isc_rwlocktype_read);
-	isc_ht_iter_destroy(&it);
+	isc_hashmap_iter_destroy(&it);
 
 	if (result == ISC_R_NOMORE) {
 		result = ISC_R_SUCCESS;
@@ -3039,6 +3104,211 @@ dns_adb_dumpquota(dns_adb_t *adb, isc_buffer_t **buf) {
 	return (result);
 }
 
+/*
+ * Like the SRTT, the mean deviation of the RTTs and the failure rate
+ * are moving averages updated with compare-and-swap loops.  Each
+ * response or timeout weighs 1/4 in the deviation, as for TCP
+ * retransmission timers (RFC 6298), and 1/16 in the failure rate.
+ */
+static unsigned int
+adjustrttvar(dns_adbentry_t *entry, unsigned int rtt) {
+	uint_fast32_t srtt = atomic_load_relaxed(&entry->srtt);
+	uint_fast32_t delta = (srtt > rtt) ? srtt - rtt : rtt - srtt;
+	uint_fast32_t old_rttvar, new_rttvar;
+
+	old_rttvar = atomic_load_relaxed(&entry->rttvar);
+	do {
+		new_rttvar = old_rttvar - old_rttvar / 4 + delta / 4;
+	} while (!atomic_compare_exchange_weak_relaxed(
+		&entry->rttvar, &old_rttvar, new_rttvar));
+
+	return ((unsigned int)new_rttvar);
+}
+
+static unsigned int
+adjustfailrate(dns_adbentry_t *entry, bool failed) {
+	uint_fast32_t old_rate, new_rate;
+
+	old_rate = atomic_load_relaxed(&entry->failrate);
+	do {
+		new_rate = old_rate - old_rate / 16;
+		if (failed) {
+			new_rate += DNS_ADB_FAILRATE_ONE / 16;
+		}
+	} while (!atomic_compare_exchange_weak_relaxed(
+		&entry->failrate, &old_rate, new_rate));
+
+	return ((unsigned int)new_rate);
+}
+
+void
+dns_adb_servercount(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
+		    dns_adbservercounter_t counter) {
+	REQUIRE(DNS_ADB_VALID(adb));
+	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
+	REQUIRE(counter < dns_adbserver_max);
+
+	atomic_fetch_add_relaxed(&addr->entry->counters[counter], 1);
+	if (counter == dns_adbserver_timeouts) {
+		addr->failrate = adjustfailrate(addr->entry, true);
+	}
+}
+
+void
+dns_adb_serverrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr, unsigned int rtt) {
+	unsigned int rttms = rtt / 1000;
+	size_t bucket;
+
+	REQUIRE(DNS_ADB_VALID(adb));
+	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
+
+	if (rttms < DNS_RESOLVER_QRYRTTCLASS0) {
+		bucket = 0;
+	} else if (rttms < DNS_RESOLVER_QRYRTTCLASS1) {
+		bucket = 1;
+	} else if (rttms < DNS_RESOLVER_QRYRTTCLASS2) {
+		bucket = 2;
+	} else if (rttms < DNS_RESOLVER_QRYRTTCLASS3) {
+		bucket = 3;
+	} else if (rttms < DNS_RESOLVER_QRYRTTCLASS4) {
+		bucket = 4;
+	} else {
+		bucket = 5;
+	}
+
+	atomic_fetch_add_relaxed(
+		&addr->entry->counters[dns_adbserver_responses], 1);
+	atomic_fetch_add_relaxed(&addr->entry->rtt[bucket], 1);
+
+	addr->rttvar = adjustrttvar(addr->entry, rtt);
+	addr->failrate = adjustfailrate(addr->entry, false);
+}
+
+static int
+serverstats_compare(const void *a, const void *b) {
+	const dns_adbserverstats_t *sa = a, *sb = b;
+	uint64_t qa = sa->counters[dns_adbserver_queries];
+	uint64_t qb = sb->counters[dns_adbserver_queries];
+
+	return (qa < qb ? 1 : (qa > qb ? -1 : 0));
+}
+
+/*
+ * Keep the 'max' busiest servers in 'stats', ordered as a min-heap on
+ * the number of queries, so that the least busy one can be replaced.
+ */
+static void
+serverstats_sift(dns_adbserverstats_t *stats, size_t count, size_t i) {
+	dns_adbserverstats_t tmp;
+
+	for (;;) {
+		size_t least = i, l = 2 * i + 1, r = 2 * i + 2;
+
+		if (l < count && serverstats_compare(&stats[l],
+						     &stats[least]) > 0)
+		{
+			least = l;
+		}
+		if (r < count && serverstats_compare(&stats[r],
+						     &stats[least]) > 0)
+		{
+			least = r;
+		}
+		if (least == i) {
+			return;
+		}
+
+		tmp = stats[i];
+		stats[i] = stats[least];
+		stats[least] = tmp;
+		i = least;
+	}
+}
+
+void
+dns_adb_serverstats(dns_adb_t *adb, isc_mem_t *mctx, size_t max,
+		    dns_adbserverstats_t **statsp, size_t *countp) {
+	isc_result_t result;
+	isc_hashmap_iter_t *it = NULL;
+	dns_adbserverstats_t *stats = NULL;
+	size_t count = 0;
+
+	REQUIRE(DNS_ADB_VALID(adb));
+	REQUIRE(max > 0);
+	REQUIRE(statsp != NULL && *statsp == NULL);
+	REQUIRE(countp != NULL);
+
+	stats = isc_mem_get(mctx, max * sizeof(stats[0]));
+
+	RWLOCK(&adb->entries_lock, isc_rwlocktype_read);
+	isc_hashmap_iter_create(adb->entrybuckets, &it);
+	for (result = isc_hashmap_iter_first(it); result == ISC_R_SUCCESS;
+	     result = isc_hashmap_iter_next(it))
+	{
+		dns_adbentrybucket_t *ebucket = NULL;
+		dns_adbentry_t *entry = NULL;
+
+		isc_hashmap_iter_current(it, (void **)&ebucket);
+		LOCK(&ebucket->lock);
+		for (entry = ISC_LIST_HEAD(ebucket->entries); entry != NULL;
+		     entry = ISC_LIST_NEXT(entry, plink))
+		{
+			dns_adbserverstats_t s = {
+				.sockaddr = entry->sockaddr,
+				.srtt = atomic_load_relaxed(&entry->srtt),
+				.rttvar = atomic_load_relaxed(&entry->rttvar),
+				.failrate = atomic_load_relaxed(
+					&entry->failrate),
+				.inflight = atomic_load_relaxed(&entry->active),
+			};
+
+			for (size_t i = 0; i < dns_adbserver_max; i++) {
+				s.counters[i] = atomic_load_relaxed(
+					&entry->counters[i]);
+			}
+			if (s.counters[dns_adbserver_queries] == 0) {
+				continue;
+			}
+			for (size_t i = 0; i < DNS_ADB_RTTBUCKETS; i++) {
+				s.rtt[i] = atomic_load_relaxed(&entry->rtt[i]);
+			}
+
+			if (count < max) {
+				stats[count++] = s;
+				if (count == max) {
+					for (size_t i = max / 2; i-- > 0;) {
+						serverstats_sift(stats, max, i);
+					}
+				}
+			} else if (serverstats_compare(&s, &stats[0]) < 0) {
+				stats[0] = s;
+				serverstats_sift(stats, max, 0);
+			}
+		}
+		UNLOCK(&ebucket->lock);
+	}
+	RWUNLOCK(&adb->entries_lock, isc_rwlocktype_read);
+	isc_hashmap_iter_destroy(&it);
+
+	if (count > 1) {
+		qsort(stats, count, sizeof(stats[0]), serverstats_compare);
+	}
+
+	if (count < max) {
+		dns_adbserverstats_t *resized = NULL;
+
+		if (count > 0) {
+			resized = isc_mem_get(mctx, count * sizeof(stats[0]));
+			memmove(resized, stats, count * sizeof(stats[0]));
+		}
+		isc_mem_put(mctx, stats, max * sizeof(stats[0]));
+		stats = resized;
+	}
+
+	*statsp = stats;
+	*countp = count;
+}
+
 static isc_result_t
 dbfind_name(dns_adbname_t *adbname, isc_stdtime_t now, dns_rdatatype_t rdtype) {
 	isc_result_t result;
@@ -3448,6 +3718,131 @@ cleanup:
 	return (result);
 }
 
+/*
+ * Write one line for an entry that the resolver has learned something
+ * about.  The entry's bucket must be locked.
+ */
+static bool
+save_entry(FILE *fp, dns_adbentry_t *entry, isc_stdtime_t now) {
+	char addrbuf[ISC_NETADDR_FORMATSIZE];
+	char tbuf[80];
+	isc_netaddr_t netaddr;
+	isc_buffer_t b;
+	isc_stdtime_t expires;
+	uint_fast32_t flags, udpsize;
+
+	flags = atomic_load_relaxed(&entry->flags) & ~ENTRY_IS_DEAD;
+	udpsize = atomic_load_relaxed(&entry->udpsize);
+	if (atomic_load_relaxed(&entry->ednsstats) == 0 && flags == 0 &&
+	    udpsize == 0)
+	{
+		return (false);
+	}
+
+	/* Entries that are in use have no expiry time yet */
+	expires = atomic_load_relaxed(&entry->expires);
+	if (expires == 0) {
+		expires = now + ADB_ENTRY_WINDOW;
+	} else if (expires <= now) {
+		return (false);
+	}
+
+	isc_netaddr_fromsockaddr(&netaddr, &entry->sockaddr);
+	isc_netaddr_format(&netaddr, addrbuf, sizeof(addrbuf));
+
+	isc_buffer_init(&b, tbuf, sizeof(tbuf));
+	dns_time32_totext(expires, &b);
+	isc_buffer_putuint8(&b, 0);
+
+	fprintf(fp,
+		"%s %u %" PRIuFAST32 " %08" PRIxFAST32 " %" PRIuFAST32 " %s\n",
+		addrbuf, isc_sockaddr_getport(&entry->sockaddr),
+		atomic_load_relaxed(&entry->srtt), flags, udpsize, tbuf);
+
+	return (true);
+}
+
+isc_result_t
+dns_adb_save(dns_adb_t *adb, FILE *fp) {
+	isc_result_t result;
+	isc_hashmap_iter_t *it = NULL;
+	isc_stdtime_t now;
+	bool written = false;
+
+	REQUIRE(DNS_ADB_VALID(adb));
+	REQUIRE(fp != NULL);
+
+	if (atomic_load(&adb->exiting)) {
+		return (ISC_R_SHUTTINGDOWN);
+	}
+
+	isc_stdtime_get(&now);
+
+	RWLOCK(&adb->entries_lock, isc_rwlocktype_read);
+	isc_hashmap_iter_create(adb->entrybuckets, &it);
+	for (result = isc_hashmap_iter_first(it); result == ISC_R_SUCCESS;
+	     result = isc_hashmap_iter_next(it))
+	{
+		dns_adbentrybucket_t *ebucket = NULL;
+		dns_adbentry_t *entry = NULL;
+
+		isc_hashmap_iter_current(it, (void **)&ebucket);
+		LOCK(&ebucket->lock);
+		for (entry = ISC_LIST_HEAD(ebucket->entries); entry != NULL;
+		     entry = ISC_LIST_NEXT(entry, plink))
+		{
+			if (save_entry(fp, entry, now)) {
+				written = true;
+			}
+		}
+		UNLOCK(&ebucket->lock);
+	}
+	isc_hashmap_iter_destroy(&it);
+	RWUNLOCK(&adb->entries_lock, isc_rwlocktype_read);
+
+	return (written ? ISC_R_SUCCESS : ISC_R_NOTFOUND);
+}
+
+void
+dns_adb_seed(dns_adb_t *adb, const isc_sockaddr_t *sa, unsigned int srtt,
+	     unsigned int flags, unsigned int udpsize, isc_stdtime_t expires) {
+	dns_adbentrybucket_t *ebucket = NULL;
+	dns_adbentry_t *entry = NULL;
+	isc_stdtime_t now;
+
+	REQUIRE(DNS_ADB_VALID(adb));
+	REQUIRE(sa != NULL);
+
+	if (atomic_load(&adb->exiting)) {
+		return;
+	}
+
+	isc_stdtime_get(&now);
+	if (expires <= now) {
+		return;
+	}
+
+	get_entrybucket(adb, sa, &ebucket);
+	INSIST(ebucket != NULL);
+	LOCK(&ebucket->lock);
+
+	/* Whatever has been learned since start-up is more accurate */
+	entry = get_entry(ebucket, sa, now);
+	if (entry == NULL) {
+		entry = new_adbentry(adb);
+		entry->sockaddr = *sa;
+		atomic_store_relaxed(&entry->srtt, srtt);
+		atomic_store_relaxed(&entry->flags, flags & ~ENTRY_IS_DEAD);
+		atomic_store_relaxed(&entry->udpsize, udpsize);
+		atomic_store_relaxed(&entry->expires,
+				     ISC_MIN(expires, now + ADB_ENTRY_WINDOW));
+		link_entry(ebucket, entry);
+		DP(ENTER_LEVEL, "seed: new entry %p", entry);
+	}
+
+	UNLOCK(&ebucket->lock);
+}
+
 isc_result_t
 dns_adb_marklame(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
 		 const dns_name_t *qname, dns_rdatatype_t qtype,
@@ -3486,71 +3881,87 @@ unlock:
 void
 dns_adb_adjustsrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr, unsigned int rtt,
 		   unsigned int factor) {
-	dns_adbentrybucket_t *ebucket = NULL;
 	isc_stdtime_t now = 0;
 
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
 	REQUIRE(factor <= 10);
 
-	ebucket = addr->entry->bucket;
-	LOCK(&ebucket->lock);
-
-	if (addr->entry->expires == 0 || factor == DNS_ADB_RTTADJAGE) {
+	if (atomic_load_relaxed(&addr->entry->expires) == 0 ||
+	    factor == DNS_ADB_RTTADJAGE)
+	{
 		isc_stdtime_get(&now);
 	}
 	adjustsrtt(addr, rtt, factor, now);
-
-	UNLOCK(&ebucket->lock);
 }
 
 void
 dns_adb_agesrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr, isc_stdtime_t now) {
-	dns_adbentrybucket_t *ebucket = NULL;
-
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
 
-	ebucket = addr->entry->bucket;
-	LOCK(&ebucket->lock);
-
 	adjustsrtt(addr, 0, DNS_ADB_RTTADJAGE, now);
+}
 
-	UNLOCK(&ebucket->lock);
+/*
+ * Make sure the entry lives for a while after it was last used,
+ * unless some other thread got there first.
+ */
+static void
+setexpires(dns_adbentry_t *entry, isc_stdtime_t now) {
+	uint_fast32_t expires = 0;
+
+	(void)atomic_compare_exchange_strong_relaxed(&entry->expires, &expires,
+						     now + ADB_ENTRY_WINDOW);
 }
 
+/*
+ * The entry's SRTT is updated with a compare-and-swap loop, so that
+ * concurrent responses from a busy server don't need a lock, and no
+ * update is lost.
+ */
 static void
 adjustsrtt(dns_adbaddrinfo_t *addr, unsigned int rtt, unsigned int factor,
 	   isc_stdtime_t now) {
-	uint64_t new_srtt;
+	dns_adbentry_t *entry = addr->entry;
+	uint_fast32_t old_srtt, new_srtt;
 
+	old_srtt = atomic_load_relaxed(&entry->srtt);
 	if (factor == DNS_ADB_RTTADJAGE) {
-		if (addr->entry->lastage != now) {
-			new_srtt = addr->entry->srtt;
-			new_srtt <<= 9;
-			new_srtt -= addr->entry->srtt;
-			new_srtt >>= 9;
-			addr->entry->lastage = now;
-		} else {
-			new_srtt = addr->entry->srtt;
+		uint_fast32_t lastage = atomic_load_relaxed(&entry->lastage);
+
+		/* Only the first caller each second ages the SRTT */
+		new_srtt = old_srtt;
+		if (lastage != now &&
+		    atomic_compare_exchange_strong_relaxed(&entry->lastage,
+							   &lastage, now))
+		{
+			do {
+				new_srtt = ((uint64_t)old_srtt << 9) - old_srtt;
+				new_srtt >>= 9;
+			} while (!atomic_compare_exchange_weak_relaxed(
+				&entry->srtt, &old_srtt, new_srtt));
 		}
 	} else {
-		new_srtt = ((uint64_t)addr->entry->srtt / 10 * factor) +
-			   ((uint64_t)rtt / 10 * (10 - factor));
+		do {
+			new_srtt = ((uint64_t)old_srtt / 10 * factor) +
+				   ((uint64_t)rtt / 10 * (10 - factor));
+		} while (!atomic_compare_exchange_weak_relaxed(
+			&entry->srtt, &old_srtt, new_srtt));
 	}
 
-	addr->entry->srtt = (unsigned int)new_srtt;
 	addr->srtt = (unsigned int)new_srtt;
 
-	if (addr->entry->expires == 0) {
-		addr->entry->expires = now + ADB_ENTRY_WINDOW;
+	if (atomic_load_relaxed(&entry->expires) == 0) {
+		setexpires(entry, now);
 	}
 }
 
 void
 dns_adb_changeflags(dns_adb_t *adb, dns_adbaddrinfo_t *addr, unsigned int bits,
 		    unsigned int mask) {
-	dns_adbentrybucket_t *ebucket = NULL;
+	dns_adbentry_t *entry = NULL;
+	uint_fast32_t flags;
 	isc_stdtime_t now;
 
 	REQUIRE(DNS_ADB_VALID(adb));
@@ -3559,13 +3970,17 @@ dns_adb_changeflags(dns_adb_t *adb, dns_adbaddrinfo_t *addr, unsigned int bits,
 	REQUIRE((bits & ENTRY_IS_DEAD) == 0);
 	REQUIRE((mask & ENTRY_IS_DEAD) == 0);
 
-	ebucket = addr->entry->bucket;
-	LOCK(&ebucket->lock);
+	entry = addr->entry;
+	flags = atomic_load_relaxed(&entry->flags);
+	while (!atomic_compare_exchange_weak_relaxed(
+		&entry->flags, &flags, (flags & ~mask) | (bits & mask)))
+	{
+		/* 'flags' has been reloaded; try again */
+	}
 
-	addr->entry->flags = (addr->entry->flags & ~mask) | (bits & mask);
-	if (addr->entry->expires == 0) {
+	if (atomic_load_relaxed(&entry->expires) == 0) {
 		isc_stdtime_get(&now);
-		addr->entry->expires = now + ADB_ENTRY_WINDOW;
+		setexpires(entry, now);
 	}
 
 	/*
@@ -3573,8 +3988,6 @@ dns_adb_changeflags(dns_adb_t *adb, dns_adbaddrinfo_t *addr, unsigned int bits,
 	 * the most recent values from addr->entry->flags.
 	 */
 	addr->flags = (addr->flags & ~mask) | (bits & mask);
-
-	UNLOCK(&ebucket->lock);
 }
 
 /*
@@ -3656,114 +4069,98 @@ maybe_adjust_quota(dns_adb_t *adb, dns_adbaddrinfo_t *addr, bool timeout) {
 
 #define EDNSTOS 3U
 
-void
-dns_adb_plainresponse(dns_adb_t *adb, dns_adbaddrinfo_t *addr) {
+/*
+ * Quota adjustment is rarely configured and needs a consistent view of
+ * several counters, so unlike the rest of the statistics it is done
+ * under the bucket lock.
+ */
+static void
+adjust_quota(dns_adb_t *adb, dns_adbaddrinfo_t *addr, bool timeout) {
 	dns_adbentrybucket_t *ebucket = NULL;
 
-	REQUIRE(DNS_ADB_VALID(adb));
-	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
+	if (adb->quota == 0 || adb->atr_freq == 0) {
+		return;
+	}
 
 	ebucket = addr->entry->bucket;
 	LOCK(&ebucket->lock);
-
-	maybe_adjust_quota(adb, addr, false);
-
-	addr->entry->plain++;
-	if (addr->entry->plain == 0xff) {
-		addr->entry->edns >>= 1;
-		addr->entry->ednsto >>= 1;
-		addr->entry->plain >>= 1;
-		addr->entry->plainto >>= 1;
-	}
+	maybe_adjust_quota(adb, addr, timeout);
 	UNLOCK(&ebucket->lock);
 }
 
-void
-dns_adb_timeout(dns_adb_t *adb, dns_adbaddrinfo_t *addr) {
-	dns_adbentrybucket_t *ebucket = NULL;
+/*
+ * Count a response or timeout in one of the 8-bit counters; when one
+ * of them fills up, all four are halved so they keep their ratios.
+ */
+static void
+count_edns(dns_adbentry_t *entry, unsigned int shift) {
+	uint_fast32_t old_stats, new_stats;
+
+	old_stats = atomic_load_relaxed(&entry->ednsstats);
+	do {
+		new_stats = old_stats + ((uint_fast32_t)1 << shift);
+		if (EDNSSTAT(new_stats, shift) == 0xff) {
+			new_stats = (new_stats >> 1) & 0x7f7f7f7f;
+		}
+	} while (!atomic_compare_exchange_weak_relaxed(
+		&entry->ednsstats, &old_stats, new_stats));
+}
 
+void
+dns_adb_plainresponse(dns_adb_t *adb, dns_adbaddrinfo_t *addr) {
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
 
-	ebucket = addr->entry->bucket;
-	LOCK(&ebucket->lock);
+	adjust_quota(adb, addr, false);
+	count_edns(addr->entry, ENTRY_EDNS_PLAIN);
+}
 
-	maybe_adjust_quota(adb, addr, true);
+void
+dns_adb_timeout(dns_adb_t *adb, dns_adbaddrinfo_t *addr) {
+	REQUIRE(DNS_ADB_VALID(adb));
+	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
 
-	addr->entry->plainto++;
-	if (addr->entry->plainto == 0xff) {
-		addr->entry->edns >>= 1;
-		addr->entry->ednsto >>= 1;
-		addr->entry->plain >>= 1;
-		addr->entry->plainto >>= 1;
-	}
-	UNLOCK(&ebucket->lock);
+	adjust_quota(adb, addr, true);
+	count_edns(addr->entry, ENTRY_EDNS_PLAINTO);
 }
 
 void
 dns_adb_ednsto(dns_adb_t *adb, dns_adbaddrinfo_t *addr) {
-	dns_adbentrybucket_t *ebucket = NULL;
-
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
 
-	ebucket = addr->entry->bucket;
-	LOCK(&ebucket->lock);
-
-	maybe_adjust_quota(adb, addr, true);
-
-	addr->entry->ednsto++;
-	if (addr->entry->ednsto == 0xff) {
-		addr->entry->edns >>= 1;
-		addr->entry->ednsto >>= 1;
-		addr->entry->plain >>= 1;
-		addr->entry->plainto >>= 1;
-	}
-	UNLOCK(&ebucket->lock);
+	adjust_quota(adb, addr, true);
+	count_edns(addr->entry, ENTRY_EDNS_EDNSTO);
 }
 
 void
 dns_adb_setudpsize(dns_adb_t *adb, dns_adbaddrinfo_t *addr, unsigned int size) {
-	dns_adbentrybucket_t *ebucket = NULL;
+	uint_fast32_t udpsize;
 
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
 
-	ebucket = addr->entry->bucket;
-	LOCK(&ebucket->lock);
 	if (size < 512U) {
 		size = 512U;
 	}
-	if (size > addr->entry->udpsize) {
-		addr->entry->udpsize = size;
+	udpsize = atomic_load_relaxed(&addr->entry->udpsize);
+	while (size > udpsize &&
+	       !atomic_compare_exchange_weak_relaxed(&addr->entry->udpsize,
+						     &udpsize, size))
+	{
+		/* 'udpsize' has been reloaded; try again */
 	}
 
-	maybe_adjust_quota(adb, addr, false);
-
-	addr->entry->edns++;
-	if (addr->entry->edns == 0xff) {
-		addr->entry->edns >>= 1;
-		addr->entry->ednsto >>= 1;
-		addr->entry->plain >>= 1;
-		addr->entry->plainto >>= 1;
-	}
-	UNLOCK(&ebucket->lock);
+	adjust_quota(adb, addr, false);
+	count_edns(addr->entry, ENTRY_EDNS_EDNS);
 }
 
 unsigned int
 dns_adb_getudpsize(dns_adb_t *adb, dns_adbaddrinfo_t *addr) {
-	dns_adbentrybucket_t *ebucket = NULL;
-	unsigned int size;
-
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
 
-	ebucket = addr->entry->bucket;
-	LOCK(&ebucket->lock);
-	size = addr->entry->udpsize;
-	UNLOCK(&ebucket->lock);
-
-	return (size);
+	return ((unsigned int)atomic_load_relaxed(&addr->entry->udpsize));
 }
 
 void
@@ -3882,9 +4279,9 @@ dns_adb_freeaddrinfo(dns_adb_t *adb, dns_adbaddrinfo_t **addrp) {
 
 	REQUIRE(DNS_ADBENTRY_VALID(entry));
 
-	if (entry->expires == 0) {
+	if (atomic_load_relaxed(&entry->expires) == 0) {
 		isc_stdtime_get(&now);
-		entry->expires = now + ADB_ENTRY_WINDOW;
+		setexpires(entry, now);
 	}
 
 	free_adbaddrinfo(adb, &addr);
@@ -4066,6 +4463,13 @@ dns_adbentry_overquota(dns_adbentry_t *entry) {
 	return (quota != 0 && active >= quota);
 }
 
+unsigned int
+dns_adbentry_inflight(dns_adbentry_t *entry) {
+	REQUIRE(DNS_ADBENTRY_VALID(entry));
+
+	return ((unsigned int)atomic_load_acquire(&entry->active));
+}
+
 void
 dns_adb_beginudpfetch(dns_adb_t *adb, dns_adbaddrinfo_t *addr) {
 	uint_fast32_t active;
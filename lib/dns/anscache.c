@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/ht.h>
+#include <isc/mem.h>
+#include <isc/refcount.h>
+#include <isc/rwlock.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/anscache.h>
+#include <dns/db.h>
+
+struct dns_anscache {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	isc_rwlock_t lock;
+
+	/* Locked by 'lock'. */
+	dns_db_t *db;
+	dns_dbversion_t *version;
+	isc_ht_t *ht;
+	unsigned int count;
+};
+
+#define ANSCACHE_MAGIC	  ISC_MAGIC('A', 'n', 's', 'C')
+#define VALID_ANSCACHE(c) ISC_MAGIC_VALID(c, ANSCACHE_MAGIC)
+
+#define ANSCACHEENTRY_MAGIC    ISC_MAGIC('A', 'n', 's', 'E')
+#define VALID_ANSCACHEENTRY(e) ISC_MAGIC_VALID(e, ANSCACHEENTRY_MAGIC)
+
+void
+dns_anscache_create(isc_mem_t *mctx, dns_anscache_t **cachep) {
+	dns_anscache_t *cache = NULL;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	cache = isc_mem_get(mctx, sizeof(*cache));
+	*cache = (dns_anscache_t){ .magic = 0 };
+
+	isc_mem_attach(mctx, &cache->mctx);
+	isc_rwlock_init(&cache->lock, 0, 0);
+	isc_ht_init(&cache->ht, cache->mctx, 10, ISC_HT_CASE_SENSITIVE);
+
+	cache->magic = ANSCACHE_MAGIC;
+
+	*cachep = cache;
+}
+
+/*
+ * Discard all entries and the version they belong to.  Must be called
+ * with the cache write-locked.
+ */
+static void
+anscache_flush(dns_anscache_t *cache) {
+	isc_ht_iter_t *it = NULL;
+	isc_result_t result;
+
+	isc_ht_iter_create(cache->ht, &it);
+	result = isc_ht_iter_first(it);
+	while (result == ISC_R_SUCCESS) {
+		dns_anscacheentry_t *entry = NULL;
+
+		isc_ht_iter_current(it, (void **)&entry);
+		dns_anscacheentry_detach(&entry);
+		result = isc_ht_iter_delcurrent_next(it);
+	}
+	isc_ht_iter_destroy(&it);
+	cache->count = 0;
+
+	if (cache->version != NULL) {
+		dns_db_closeversion(cache->db, &cache->version, false);
+	}
+	if (cache->db != NULL) {
+		dns_db_detach(&cache->db);
+	}
+}
+
+void
+dns_anscache_destroy(dns_anscache_t **cachep) {
+	dns_anscache_t *cache = NULL;
+
+	REQUIRE(cachep != NULL && VALID_ANSCACHE(*cachep));
+
+	cache = *cachep;
+	*cachep = NULL;
+
+	anscache_flush(cache);
+
+	cache->magic = 0;
+	isc_ht_destroy(&cache->ht);
+	isc_rwlock_destroy(&cache->lock);
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+void
+dns_anscache_flush(dns_anscache_t *cache) {
+	REQUIRE(VALID_ANSCACHE(cache));
+
+	RWLOCK(&cache->lock, isc_rwlocktype_write);
+	anscache_flush(cache);
+	RWUNLOCK(&cache->lock, isc_rwlocktype_write);
+}
+
+isc_result_t
+dns_anscache_find(dns_anscache_t *cache, dns_db_t *db,
+		  dns_dbversion_t *version, const isc_region_t *key,
+		  dns_anscacheentry_t **entryp) {
+	isc_result_t result = ISC_R_NOTFOUND;
+	dns_anscacheentry_t *entry = NULL;
+
+	REQUIRE(VALID_ANSCACHE(cache));
+	REQUIRE(db != NULL && version != NULL);
+	REQUIRE(key != NULL);
+	REQUIRE(entryp != NULL && *entryp == NULL);
+
+	RWLOCK(&cache->lock, isc_rwlocktype_read);
+	if (cache->db == db && cache->version == version) {
+		result = isc_ht_find(cache->ht, key->base, key->length,
+				     (void **)&entry);
+	}
+	if (result == ISC_R_SUCCESS) {
+		isc_refcount_increment(&entry->references);
+		*entryp = entry;
+	}
+	RWUNLOCK(&cache->lock, isc_rwlocktype_read);
+
+	return (result);
+}
+
+/*
+ * Check whether 'version' is the current version of 'db'.
+ */
+static bool
+anscache_iscurrent(dns_db_t *db, dns_dbversion_t *version) {
+	dns_dbversion_t *current = NULL;
+	bool match;
+
+	dns_db_currentversion(db, &current);
+	match = (current == version);
+	dns_db_closeversion(db, &current, false);
+
+	return (match);
+}
+
+void
+dns_anscache_add(dns_anscache_t *cache, dns_db_t *db, dns_dbversion_t *version,
+		 const isc_region_t *key, uint16_t flags, dns_rcode_t rcode,
+		 bool referral, const unsigned int *counts,
+		 const isc_region_t *wire) {
+	dns_anscacheentry_t *entry = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_ANSCACHE(cache));
+	REQUIRE(db != NULL && version != NULL);
+	REQUIRE(key != NULL && key->length > 0);
+	REQUIRE(counts != NULL);
+	REQUIRE(wire != NULL);
+
+	entry = isc_mem_get(cache->mctx, sizeof(*entry) + wire->length);
+	*entry = (dns_anscacheentry_t){
+		.flags = flags,
+		.rcode = rcode,
+		.referral = referral,
+		.wire.base = (unsigned char *)(entry + 1),
+		.wire.length = wire->length,
+	};
+	memmove(entry->counts, counts, sizeof(entry->counts));
+	memmove(entry->wire.base, wire->base, wire->length);
+	isc_refcount_init(&entry->references, 1);
+	isc_mem_attach(cache->mctx, &entry->mctx);
+	entry->magic = ANSCACHEENTRY_MAGIC;
+
+	RWLOCK(&cache->lock, isc_rwlocktype_write);
+	if (cache->db != db || cache->version != version) {
+		/*
+		 * Switch to the new version only when it is the current
+		 * one; a lookup that started before the latest commit
+		 * must not throw away the answers for the newer version.
+		 */
+		if (!anscache_iscurrent(db, version)) {
+			goto unlock;
+		}
+		anscache_flush(cache);
+		dns_db_attach(db, &cache->db);
+		dns_db_attachversion(db, version, &cache->version);
+	} else if (cache->count >= DNS_ANSCACHE_MAXENTRIES) {
+		anscache_flush(cache);
+		dns_db_attach(db, &cache->db);
+		dns_db_attachversion(db, version, &cache->version);
+	}
+
+	result = isc_ht_add(cache->ht, key->base, key->length, entry);
+	if (result == ISC_R_SUCCESS) {
+		cache->count++;
+		entry = NULL;
+	}
+
+unlock:
+	RWUNLOCK(&cache->lock, isc_rwlocktype_write);
+
+	if (entry != NULL) {
+		dns_anscacheentry_detach(&entry);
+	}
+}
+
+void
+dns_anscacheentry_detach(dns_anscacheentry_t **entryp) {
+	dns_anscacheentry_t *entry = NULL;
+
+	REQUIRE(entryp != NULL && VALID_ANSCACHEENTRY(*entryp));
+
+	entry = *entryp;
+	*entryp = NULL;
+
+	if (isc_refcount_decrement(&entry->references) == 1) {
+		isc_refcount_destroy(&entry->references);
+		entry->magic = 0;
+		isc_mem_putanddetach(&entry->mctx, entry,
+				     sizeof(*entry) + entry->wire.length);
+	}
+}
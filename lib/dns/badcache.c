@@ -16,13 +16,14 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
-#include <isc/buffer.h>
+#include <isc/atomic.h>
 #include <isc/hash.h>
+#include <isc/list.h>
 #include <isc/log.h>
 #include <isc/mem.h>
 #include <isc/mutex.h>
 #include <isc/print.h>
-#include <isc/rwlock.h>
+#include <isc/rcu.h>
 #include <isc/string.h>
 #include <isc/time.h>
 #include <isc/util.h>
@@ -33,63 +34,309 @@
 #include <dns/rdatatype.h>
 #include <dns/types.h>
 
+/*
+ * Locking
+ *
+ * The entries are spread over BADCACHE_SHARDS shards by name hash.  Each
+ * shard has a lock held by everything that changes it, and a hash table
+ * of its own that is resized independently of the others, so that a
+ * resize only holds up the writers of one shard.
+ *
+ * Lookups on a loop thread don't take any lock; they run in an isc_rcu
+ * read-side critical section instead.  Writers never change a chain that
+ * such a lookup can be walking except by storing single pointers, an
+ * entry's expiry time and flags are atomic, and a resize builds a new
+ * table and replaces the old one with a single pointer store.  Unlinked
+ * entries and tables are retired rather than freed, and are freed once
+ * isc_rcu_expired() says no lookup can still see them.  Other threads
+ * take the shard lock to look up.
+ *
+ * A lookup only notes the expired entries it walks past; it removes them
+ * afterwards if it can get the shard lock without waiting.
+ */
+
+#define BADCACHE_SHARDS 16
+
+#define NS_PER_SEC 1000000000U
+
 typedef struct dns_bcentry dns_bcentry_t;
 
+struct dns_bcentry {
+	atomic_uintptr_t next;
+	dns_rdatatype_t type;
+	atomic_uint_fast64_t expire;
+	atomic_uint_fast32_t flags;
+	unsigned int hashval;
+	uint64_t tag;
+	ISC_LINK(dns_bcentry_t) link;
+	dns_fixedname_t fname;
+	dns_name_t *name;
+};
+
+typedef struct bctable bctable_t;
+
+struct bctable {
+	unsigned int size;
+	uint64_t tag;
+	ISC_LINK(bctable_t) link;
+	atomic_uintptr_t buckets[];
+};
+
+#define TABLE_SIZE(n) (sizeof(bctable_t) + (n) * sizeof(atomic_uintptr_t))
+
+typedef struct bcshard {
+	isc_mutex_t lock;
+	atomic_uintptr_t table;
+	unsigned int count;
+	unsigned int sweep;
+	ISC_LIST(dns_bcentry_t) retired;
+	ISC_LIST(bctable_t) retiredtables;
+} bcshard_t;
+
 struct dns_badcache {
 	unsigned int magic;
-	isc_rwlock_t lock;
 	isc_mem_t *mctx;
 
-	isc_mutex_t *tlocks;
-	dns_bcentry_t **table;
-
 	atomic_uint_fast32_t count;
-	atomic_uint_fast32_t sweep;
 
 	unsigned int minsize;
-	unsigned int size;
+	bcshard_t shards[BADCACHE_SHARDS];
 };
 
 #define BADCACHE_MAGIC	  ISC_MAGIC('B', 'd', 'C', 'a')
 #define VALID_BADCACHE(m) ISC_MAGIC_VALID(m, BADCACHE_MAGIC)
 
-struct dns_bcentry {
-	dns_bcentry_t *next;
-	dns_rdatatype_t type;
-	isc_time_t expire;
-	uint32_t flags;
-	unsigned int hashval;
-	dns_fixedname_t fname;
-	dns_name_t *name;
-};
+static uint64_t
+time_tons(const isc_time_t *t) {
+	return ((uint64_t)isc_time_seconds(t) * NS_PER_SEC +
+		isc_time_nanoseconds(t));
+}
+
+static uint64_t
+now_tons(void) {
+	isc_time_t now;
+
+	if (isc_time_now(&now) != ISC_R_SUCCESS) {
+		return (0);
+	}
+	return (time_tons(&now));
+}
+
+static dns_bcentry_t *
+entry_next(dns_bcentry_t *bad) {
+	return ((dns_bcentry_t *)atomic_load_acquire(&bad->next));
+}
+
+static bool
+entry_expired(dns_bcentry_t *bad, uint64_t now) {
+	return (atomic_load_relaxed(&bad->expire) < now);
+}
+
+static dns_bcentry_t *
+entry_new(dns_badcache_t *bc, const dns_name_t *name, dns_rdatatype_t type,
+	  unsigned int hashval, uint64_t expire, uint32_t flags) {
+	dns_bcentry_t *bad = isc_mem_get(bc->mctx, sizeof(*bad));
+
+	*bad = (dns_bcentry_t){ .type = type, .hashval = hashval };
+	atomic_init(&bad->next, 0);
+	atomic_init(&bad->expire, expire);
+	atomic_init(&bad->flags, flags);
+	ISC_LINK_INIT(bad, link);
+	bad->name = dns_fixedname_initname(&bad->fname);
+	dns_name_copy(name, bad->name);
+
+	return (bad);
+}
+
+static bctable_t *
+table_new(dns_badcache_t *bc, unsigned int size) {
+	bctable_t *table = isc_mem_get(bc->mctx, TABLE_SIZE(size));
+
+	*table = (bctable_t){ .size = size };
+	ISC_LINK_INIT(table, link);
+	for (unsigned int i = 0; i < size; i++) {
+		atomic_init(&table->buckets[i], 0);
+	}
+
+	return (table);
+}
 
 static void
-badcache_resize(dns_badcache_t *bc, isc_time_t *now);
+table_free(dns_badcache_t *bc, bctable_t *table) {
+	isc_mem_put(bc->mctx, table, TABLE_SIZE(table->size));
+}
+
+static bctable_t *
+shard_table(bcshard_t *shard) {
+	return ((bctable_t *)atomic_load_acquire(&shard->table));
+}
+
+static atomic_uintptr_t *
+table_bucket(bctable_t *table, unsigned int hashval) {
+	return (&table->buckets[(hashval / BADCACHE_SHARDS) % table->size]);
+}
+
+static bcshard_t *
+badcache_shard(dns_badcache_t *bc, unsigned int hashval) {
+	return (&bc->shards[hashval % BADCACHE_SHARDS]);
+}
+
+/*
+ * Unlink the entry '*linkp' points to and retire it.  The shard must be
+ * locked.
+ */
+static void
+shard_unlink(dns_badcache_t *bc, bcshard_t *shard, atomic_uintptr_t *linkp,
+	     dns_bcentry_t *bad) {
+	atomic_store_release(linkp, atomic_load_relaxed(&bad->next));
+	bad->tag = isc_rcu_retire();
+	ISC_LIST_APPEND(shard->retired, bad, link);
+	shard->count--;
+	atomic_fetch_sub_relaxed(&bc->count, 1);
+}
+
+/*
+ * Unlink the expired entries in the chain starting at 'linkp'.  The
+ * shard must be locked.
+ */
+static void
+shard_expire(dns_badcache_t *bc, bcshard_t *shard, atomic_uintptr_t *linkp,
+	     uint64_t now) {
+	dns_bcentry_t *bad = NULL;
+
+	while ((bad = (dns_bcentry_t *)atomic_load_relaxed(linkp)) != NULL) {
+		if (entry_expired(bad, now)) {
+			shard_unlink(bc, shard, linkp, bad);
+		} else {
+			linkp = &bad->next;
+		}
+	}
+}
+
+/*
+ * Replace the table of 'shard' with one of 'size' buckets, holding copies
+ * of the entries that have not expired, and retire the old table and its
+ * entries.  The shard must be locked.
+ */
+static void
+shard_rebuild(dns_badcache_t *bc, bcshard_t *shard, unsigned int size,
+	      uint64_t now) {
+	bctable_t *old = shard_table(shard);
+	bctable_t *table = table_new(bc, size);
+	unsigned int count = 0;
+	uint64_t tag;
+
+	for (unsigned int i = 0; i < old->size; i++) {
+		dns_bcentry_t *bad = NULL;
+
+		bad = (dns_bcentry_t *)atomic_load_relaxed(&old->buckets[i]);
+		for (; bad != NULL; bad = entry_next(bad)) {
+			dns_bcentry_t *copy = NULL;
+			atomic_uintptr_t *bucket = NULL;
+
+			if (entry_expired(bad, now)) {
+				continue;
+			}
+			copy = entry_new(bc, bad->name, bad->type, bad->hashval,
+					 atomic_load_relaxed(&bad->expire),
+					 atomic_load_relaxed(&bad->flags));
+			bucket = table_bucket(table, bad->hashval);
+			atomic_init(&copy->next, atomic_load_relaxed(bucket));
+			atomic_init(bucket, (uintptr_t)copy);
+			count++;
+		}
+	}
+
+	atomic_store_release(&shard->table, (uintptr_t)table);
+
+	tag = isc_rcu_retire();
+	for (unsigned int i = 0; i < old->size; i++) {
+		dns_bcentry_t *bad = NULL;
+
+		bad = (dns_bcentry_t *)atomic_load_relaxed(&old->buckets[i]);
+		for (; bad != NULL; bad = entry_next(bad)) {
+			bad->tag = tag;
+			ISC_LIST_APPEND(shard->retired, bad, link);
+		}
+	}
+	old->tag = tag;
+	ISC_LIST_APPEND(shard->retiredtables, old, link);
+
+	INSIST(shard->count >= count);
+	atomic_fetch_sub_relaxed(&bc->count, shard->count - count);
+	shard->count = count;
+	shard->sweep = 0;
+}
+
+/*
+ * Resize the table of 'shard' if it has become too crowded or too
+ * sparse.  The shard must be locked.
+ */
+static void
+shard_resize(dns_badcache_t *bc, bcshard_t *shard, uint64_t now) {
+	unsigned int size = shard_table(shard)->size;
+
+	if (shard->count > size * 8) {
+		shard_rebuild(bc, shard, size * 2 + 1, now);
+	} else if (shard->count < size * 2 && size > bc->minsize) {
+		shard_rebuild(bc, shard, ISC_MAX((size - 1) / 2, bc->minsize),
+			      now);
+	}
+}
+
+static void
+shard_lock(bcshard_t *shard) {
+	LOCK(&shard->lock);
+}
+
+/*
+ * Unlock 'shard', freeing whatever was retired by earlier writers and
+ * can no longer be seen by any lookup.
+ */
+static void
+shard_unlock(dns_badcache_t *bc, bcshard_t *shard) {
+	dns_bcentry_t *bad = NULL;
+	bctable_t *table = NULL;
+
+	while ((bad = ISC_LIST_HEAD(shard->retired)) != NULL &&
+	       isc_rcu_expired(bad->tag))
+	{
+		ISC_LIST_UNLINK(shard->retired, bad, link);
+		isc_mem_put(bc->mctx, bad, sizeof(*bad));
+	}
+	while ((table = ISC_LIST_HEAD(shard->retiredtables)) != NULL &&
+	       isc_rcu_expired(table->tag))
+	{
+		ISC_LIST_UNLINK(shard->retiredtables, table, link);
+		table_free(bc, table);
+	}
+	UNLOCK(&shard->lock);
+}
 
 isc_result_t
 dns_badcache_init(isc_mem_t *mctx, unsigned int size, dns_badcache_t **bcp) {
 	dns_badcache_t *bc = NULL;
-	unsigned int i;
 
 	REQUIRE(bcp != NULL && *bcp == NULL);
 	REQUIRE(mctx != NULL);
 
 	bc = isc_mem_get(mctx, sizeof(dns_badcache_t));
-	memset(bc, 0, sizeof(dns_badcache_t));
+	*bc = (dns_badcache_t){
+		.minsize = ISC_MAX(size / BADCACHE_SHARDS, 1),
+	};
 
 	isc_mem_attach(mctx, &bc->mctx);
-	isc_rwlock_init(&bc->lock, 0, 0);
-
-	bc->table = isc_mem_get(bc->mctx, sizeof(*bc->table) * size);
-	bc->tlocks = isc_mem_get(bc->mctx, sizeof(isc_mutex_t) * size);
-	for (i = 0; i < size; i++) {
-		isc_mutex_init(&bc->tlocks[i]);
+	for (size_t i = 0; i < BADCACHE_SHARDS; i++) {
+		bcshard_t *shard = &bc->shards[i];
+
+		isc_mutex_init(&shard->lock);
+		atomic_init(&shard->table,
+			    (uintptr_t)table_new(bc, bc->minsize));
+		ISC_LIST_INIT(shard->retired);
+		ISC_LIST_INIT(shard->retiredtables);
 	}
-	bc->size = bc->minsize = size;
-	memset(bc->table, 0, bc->size * sizeof(dns_bcentry_t *));
 
 	atomic_init(&bc->count, 0);
-	atomic_init(&bc->sweep, 0);
 	bc->magic = BADCACHE_MAGIC;
 
 	*bcp = bc;
@@ -99,423 +346,315 @@ dns_badcache_init(isc_mem_t *mctx, unsigned int size, dns_badcache_t **bcp) {
 void
 dns_badcache_destroy(dns_badcache_t **bcp) {
 	dns_badcache_t *bc;
-	unsigned int i;
 
 	REQUIRE(bcp != NULL && *bcp != NULL);
 	bc = *bcp;
 	*bcp = NULL;
 
-	dns_badcache_flush(bc);
-
 	bc->magic = 0;
-	isc_rwlock_destroy(&bc->lock);
-	for (i = 0; i < bc->size; i++) {
-		isc_mutex_destroy(&bc->tlocks[i]);
-	}
-	isc_mem_put(bc->mctx, bc->table, sizeof(dns_bcentry_t *) * bc->size);
-	isc_mem_put(bc->mctx, bc->tlocks, sizeof(isc_mutex_t) * bc->size);
-	isc_mem_putanddetach(&bc->mctx, bc, sizeof(dns_badcache_t));
-}
-
-static void
-badcache_resize(dns_badcache_t *bc, isc_time_t *now) {
-	dns_bcentry_t **newtable, *bad, *next;
-	isc_mutex_t *newlocks;
-	unsigned int newsize, i;
-	bool grow;
-
-	RWLOCK(&bc->lock, isc_rwlocktype_write);
 
 	/*
-	 * XXXWPK we will have a thundering herd problem here,
-	 * as all threads will wait on the RWLOCK when there's
-	 * a need to resize badcache.
-	 * However, it happens so rarely it should not be a
-	 * performance issue. This is because we double the
-	 * size every time we grow it, and we don't shrink
-	 * unless the number of entries really shrunk. In a
-	 * high load situation, the number of badcache entries
-	 * will eventually stabilize.
+	 * Nothing can be looking the cache up any more, so everything is
+	 * freed at once.
 	 */
-	if (atomic_load_relaxed(&bc->count) > bc->size * 8) {
-		grow = true;
-	} else if (atomic_load_relaxed(&bc->count) < bc->size * 2 &&
-		   bc->size > bc->minsize)
-	{
-		grow = false;
-	} else {
-		/* Someone resized it already, bail. */
-		RWUNLOCK(&bc->lock, isc_rwlocktype_write);
-		return;
-	}
-
-	if (grow) {
-		newsize = bc->size * 2 + 1;
-	} else {
-		newsize = (bc->size - 1) / 2;
-#ifdef __clang_analyzer__
-		/*
-		 * XXXWPK there's a bug in clang static analyzer -
-		 * `value % newsize` is considered undefined even though
-		 * we check if newsize is larger than 0. This helps.
-		 */
-		newsize += 1;
-#endif
-	}
-	RUNTIME_CHECK(newsize > 0);
-
-	newtable = isc_mem_get(bc->mctx, sizeof(dns_bcentry_t *) * newsize);
-	memset(newtable, 0, sizeof(dns_bcentry_t *) * newsize);
-
-	newlocks = isc_mem_get(bc->mctx, sizeof(isc_mutex_t) * newsize);
-
-	/* Copy existing mutexes */
-	for (i = 0; i < newsize && i < bc->size; i++) {
-		newlocks[i] = bc->tlocks[i];
-	}
-	/* Initialize additional mutexes if we're growing */
-	for (i = bc->size; i < newsize; i++) {
-		isc_mutex_init(&newlocks[i]);
-	}
-	/* Destroy extra mutexes if we're shrinking */
-	for (i = newsize; i < bc->size; i++) {
-		isc_mutex_destroy(&bc->tlocks[i]);
-	}
-
-	for (i = 0; atomic_load_relaxed(&bc->count) > 0 && i < bc->size; i++) {
-		for (bad = bc->table[i]; bad != NULL; bad = next) {
-			next = bad->next;
-			if (isc_time_compare(&bad->expire, now) < 0) {
+	for (size_t i = 0; i < BADCACHE_SHARDS; i++) {
+		bcshard_t *shard = &bc->shards[i];
+		bctable_t *table = shard_table(shard);
+		dns_bcentry_t *bad = NULL;
+
+		for (unsigned int j = 0; j < table->size; j++) {
+			dns_bcentry_t *next = NULL;
+
+			bad = (dns_bcentry_t *)atomic_load_relaxed(
+				&table->buckets[j]);
+			for (; bad != NULL; bad = next) {
+				next = entry_next(bad);
 				isc_mem_put(bc->mctx, bad, sizeof(*bad));
-				atomic_fetch_sub_relaxed(&bc->count, 1);
-			} else {
-				bad->next = newtable[bad->hashval % newsize];
-				newtable[bad->hashval % newsize] = bad;
 			}
 		}
-		bc->table[i] = NULL;
-	}
-
-	isc_mem_put(bc->mctx, bc->tlocks, sizeof(isc_mutex_t) * bc->size);
-	bc->tlocks = newlocks;
+		table_free(bc, table);
 
-	isc_mem_put(bc->mctx, bc->table, sizeof(*bc->table) * bc->size);
-	bc->size = newsize;
-	bc->table = newtable;
+		while ((bad = ISC_LIST_HEAD(shard->retired)) != NULL) {
+			ISC_LIST_UNLINK(shard->retired, bad, link);
+			isc_mem_put(bc->mctx, bad, sizeof(*bad));
+		}
+		while ((table = ISC_LIST_HEAD(shard->retiredtables)) != NULL) {
+			ISC_LIST_UNLINK(shard->retiredtables, table, link);
+			table_free(bc, table);
+		}
+		isc_mutex_destroy(&shard->lock);
+	}
 
-	RWUNLOCK(&bc->lock, isc_rwlocktype_write);
+	isc_mem_putanddetach(&bc->mctx, bc, sizeof(dns_badcache_t));
 }
 
 void
 dns_badcache_add(dns_badcache_t *bc, const dns_name_t *name,
 		 dns_rdatatype_t type, bool update, uint32_t flags,
 		 isc_time_t *expire) {
-	isc_result_t result;
-	unsigned int hashval, hash;
-	dns_bcentry_t *bad, *prev, *next;
-	isc_time_t now;
-	bool resize = false;
+	unsigned int hashval;
+	bcshard_t *shard = NULL;
+	bctable_t *table = NULL;
+	atomic_uintptr_t *bucket = NULL, *linkp = NULL;
+	dns_bcentry_t *bad = NULL;
+	uint64_t now, exp;
 
 	REQUIRE(VALID_BADCACHE(bc));
 	REQUIRE(name != NULL);
 	REQUIRE(expire != NULL);
 
-	RWLOCK(&bc->lock, isc_rwlocktype_read);
+	now = now_tons();
+	exp = time_tons(expire);
 
-	result = isc_time_now(&now);
-	if (result != ISC_R_SUCCESS) {
-		isc_time_settoepoch(&now);
-	}
+	hashval = dns_name_fullhash(name, false);
+	shard = badcache_shard(bc, hashval);
+
+	shard_lock(shard);
 
-	hashval = dns_name_hash(name, false);
-	hash = hashval % bc->size;
-	LOCK(&bc->tlocks[hash]);
-	prev = NULL;
-	for (bad = bc->table[hash]; bad != NULL; bad = next) {
-		next = bad->next;
+	table = shard_table(shard);
+	bucket = table_bucket(table, hashval);
+	linkp = bucket;
+	while ((bad = (dns_bcentry_t *)atomic_load_relaxed(linkp)) != NULL) {
 		if (bad->type == type && dns_name_equal(name, bad->name)) {
 			if (update) {
-				bad->expire = *expire;
-				bad->flags = flags;
+				atomic_store_relaxed(&bad->flags, flags);
+				atomic_store_relaxed(&bad->expire, exp);
 			}
 			break;
 		}
-		if (isc_time_compare(&bad->expire, &now) < 0) {
-			if (prev == NULL) {
-				bc->table[hash] = bad->next;
-			} else {
-				prev->next = bad->next;
-			}
-			isc_mem_put(bc->mctx, bad, sizeof(*bad));
-			atomic_fetch_sub_relaxed(&bc->count, 1);
+		if (entry_expired(bad, now)) {
+			shard_unlink(bc, shard, linkp, bad);
 		} else {
-			prev = bad;
+			linkp = &bad->next;
 		}
 	}
 
 	if (bad == NULL) {
-		unsigned count;
-		isc_buffer_t buffer;
-
-		bad = isc_mem_get(bc->mctx, sizeof(*bad));
-		*bad = (dns_bcentry_t){ .type = type,
-					.hashval = hashval,
-					.expire = *expire,
-					.flags = flags,
-					.next = bc->table[hash] };
-
-		isc_buffer_init(&buffer, bad + 1, name->length);
-		bad->name = dns_fixedname_initname(&bad->fname);
-		dns_name_copy(name, bad->name);
-		bc->table[hash] = bad;
-
-		count = atomic_fetch_add_relaxed(&bc->count, 1);
-		if ((count > bc->size * 8) ||
-		    (count < bc->size * 2 && bc->size > bc->minsize)) {
-			resize = true;
-		}
-	} else {
-		bad->expire = *expire;
+		bad = entry_new(bc, name, type, hashval, exp, flags);
+		atomic_init(&bad->next, atomic_load_relaxed(bucket));
+		atomic_store_release(bucket, (uintptr_t)bad);
+		shard->count++;
+		atomic_fetch_add_relaxed(&bc->count, 1);
 	}
 
-	UNLOCK(&bc->tlocks[hash]);
-	RWUNLOCK(&bc->lock, isc_rwlocktype_read);
-	if (resize) {
-		badcache_resize(bc, &now);
-	}
+	/*
+	 * Slow sweep to clean out stale records.
+	 */
+	shard_expire(bc, shard, &table->buckets[shard->sweep++ % table->size],
+		     now);
+	shard_resize(bc, shard, now);
+
+	shard_unlock(bc, shard);
 }
 
 bool
 dns_badcache_find(dns_badcache_t *bc, const dns_name_t *name,
 		  dns_rdatatype_t type, uint32_t *flagp, isc_time_t *now) {
-	dns_bcentry_t *bad, *prev, *next;
-	bool answer = false;
-	unsigned int i;
-	unsigned int hash;
+	unsigned int hashval;
+	bcshard_t *shard = NULL;
+	dns_bcentry_t *bad = NULL;
+	bool answer = false, stale = false, lockless;
+	uint64_t t;
 
 	REQUIRE(VALID_BADCACHE(bc));
 	REQUIRE(name != NULL);
 	REQUIRE(now != NULL);
 
-	RWLOCK(&bc->lock, isc_rwlocktype_read);
-
-	/*
-	 * XXXMUKS: dns_name_equal() is expensive as it does a
-	 * octet-by-octet comparison, and it can be made better in two
-	 * ways here. First, lowercase the names (use
-	 * dns_name_downcase() instead of dns_name_copy() in
-	 * dns_badcache_add()) so that dns_name_caseequal() can be used
-	 * which the compiler will emit as SIMD instructions. Second,
-	 * don't put multiple copies of the same name in the chain (or
-	 * multiple names will have to be matched for equality), but use
-	 * name->link to store the type specific part.
-	 */
-
 	if (atomic_load_relaxed(&bc->count) == 0) {
-		goto skip;
+		return (false);
 	}
 
-	hash = dns_name_hash(name, false) % bc->size;
-	prev = NULL;
-	LOCK(&bc->tlocks[hash]);
-	for (bad = bc->table[hash]; bad != NULL; bad = next) {
-		next = bad->next;
-		/*
-		 * Search the hash list. Clean out expired records as we go.
-		 */
-		if (isc_time_compare(&bad->expire, now) < 0) {
-			if (prev != NULL) {
-				prev->next = bad->next;
-			} else {
-				bc->table[hash] = bad->next;
-			}
+	t = time_tons(now);
+	hashval = dns_name_fullhash(name, false);
+	shard = badcache_shard(bc, hashval);
 
-			isc_mem_put(bc->mctx, bad, sizeof(*bad));
-			atomic_fetch_sub(&bc->count, 1);
+	lockless = isc_rcu_available();
+	if (lockless) {
+		isc_rcu_read_lock();
+	} else {
+		shard_lock(shard);
+	}
+
+	bad = (dns_bcentry_t *)atomic_load_acquire(
+		table_bucket(shard_table(shard), hashval));
+	for (; bad != NULL; bad = entry_next(bad)) {
+		if (entry_expired(bad, t)) {
+			stale = true;
 			continue;
 		}
 		if (bad->type == type && dns_name_equal(name, bad->name)) {
 			if (flagp != NULL) {
-				*flagp = bad->flags;
+				*flagp = atomic_load_relaxed(&bad->flags);
 			}
 			answer = true;
 			break;
 		}
-		prev = bad;
 	}
-	UNLOCK(&bc->tlocks[hash]);
-skip:
+
+	if (lockless) {
+		isc_rcu_read_unlock();
+		if (!stale || isc_mutex_trylock(&shard->lock) != ISC_R_SUCCESS)
+		{
+			return (answer);
+		}
+	}
 
 	/*
-	 * Slow sweep to clean out stale records.
+	 * Clean out the expired records that were seen; the table may
+	 * have been replaced since, so it is looked up again.
 	 */
-	i = atomic_fetch_add(&bc->sweep, 1) % bc->size;
-	if (isc_mutex_trylock(&bc->tlocks[i]) == ISC_R_SUCCESS) {
-		bad = bc->table[i];
-		if (bad != NULL && isc_time_compare(&bad->expire, now) < 0) {
-			bc->table[i] = bad->next;
-			isc_mem_put(bc->mctx, bad, sizeof(*bad));
-			atomic_fetch_sub_relaxed(&bc->count, 1);
-		}
-		UNLOCK(&bc->tlocks[i]);
+	if (stale) {
+		shard_expire(bc, shard,
+			     table_bucket(shard_table(shard), hashval), t);
 	}
+	shard_unlock(bc, shard);
 
-	RWUNLOCK(&bc->lock, isc_rwlocktype_read);
 	return (answer);
 }
 
+/*
+ * Unlink the entries of every bucket of 'shard' for which 'match'
+ * returns true.  The shard must be locked.
+ */
+static void
+shard_flush(dns_badcache_t *bc, bcshard_t *shard,
+	    bool (*match)(dns_bcentry_t *, const dns_name_t *, uint64_t),
+	    const dns_name_t *name, uint64_t now) {
+	bctable_t *table = shard_table(shard);
+
+	for (unsigned int i = 0; shard->count > 0 && i < table->size; i++) {
+		atomic_uintptr_t *linkp = &table->buckets[i];
+		dns_bcentry_t *bad = NULL;
+
+		while ((bad = (dns_bcentry_t *)atomic_load_relaxed(linkp)) !=
+		       NULL)
+		{
+			if (match(bad, name, now)) {
+				shard_unlink(bc, shard, linkp, bad);
+			} else {
+				linkp = &bad->next;
+			}
+		}
+	}
+}
+
 void
 dns_badcache_flush(dns_badcache_t *bc) {
-	dns_bcentry_t *entry, *next;
-	unsigned int i;
-
-	RWLOCK(&bc->lock, isc_rwlocktype_write);
 	REQUIRE(VALID_BADCACHE(bc));
 
-	for (i = 0; atomic_load_relaxed(&bc->count) > 0 && i < bc->size; i++) {
-		for (entry = bc->table[i]; entry != NULL; entry = next) {
-			next = entry->next;
-			isc_mem_put(bc->mctx, entry, sizeof(*entry));
-			atomic_fetch_sub_relaxed(&bc->count, 1);
+	for (size_t i = 0; i < BADCACHE_SHARDS; i++) {
+		bcshard_t *shard = &bc->shards[i];
+
+		shard_lock(shard);
+		if (shard->count > 0) {
+			shard_rebuild(bc, shard, bc->minsize, UINT64_MAX);
 		}
-		bc->table[i] = NULL;
+		shard_unlock(bc, shard);
 	}
-	RWUNLOCK(&bc->lock, isc_rwlocktype_write);
+}
+
+static bool
+match_name(dns_bcentry_t *bad, const dns_name_t *name, uint64_t now) {
+	return (entry_expired(bad, now) || dns_name_equal(name, bad->name));
 }
 
 void
 dns_badcache_flushname(dns_badcache_t *bc, const dns_name_t *name) {
-	dns_bcentry_t *bad, *prev, *next;
-	isc_result_t result;
-	isc_time_t now;
-	unsigned int hash;
+	unsigned int hashval;
+	bcshard_t *shard = NULL;
+	atomic_uintptr_t *linkp = NULL;
+	dns_bcentry_t *bad = NULL;
+	uint64_t now;
 
 	REQUIRE(VALID_BADCACHE(bc));
 	REQUIRE(name != NULL);
 
-	RWLOCK(&bc->lock, isc_rwlocktype_read);
+	now = now_tons();
+	hashval = dns_name_fullhash(name, false);
+	shard = badcache_shard(bc, hashval);
 
-	result = isc_time_now(&now);
-	if (result != ISC_R_SUCCESS) {
-		isc_time_settoepoch(&now);
-	}
-	hash = dns_name_hash(name, false) % bc->size;
-	LOCK(&bc->tlocks[hash]);
-	prev = NULL;
-	for (bad = bc->table[hash]; bad != NULL; bad = next) {
-		int n;
-		next = bad->next;
-		n = isc_time_compare(&bad->expire, &now);
-		if (n < 0 || dns_name_equal(name, bad->name)) {
-			if (prev == NULL) {
-				bc->table[hash] = bad->next;
-			} else {
-				prev->next = bad->next;
-			}
-
-			isc_mem_put(bc->mctx, bad, sizeof(*bad));
-			atomic_fetch_sub_relaxed(&bc->count, 1);
+	shard_lock(shard);
+	linkp = table_bucket(shard_table(shard), hashval);
+	while ((bad = (dns_bcentry_t *)atomic_load_relaxed(linkp)) != NULL) {
+		if (match_name(bad, name, now)) {
+			shard_unlink(bc, shard, linkp, bad);
 		} else {
-			prev = bad;
+			linkp = &bad->next;
 		}
 	}
-	UNLOCK(&bc->tlocks[hash]);
+	shard_unlock(bc, shard);
+}
 
-	RWUNLOCK(&bc->lock, isc_rwlocktype_read);
+static bool
+match_tree(dns_bcentry_t *bad, const dns_name_t *name, uint64_t now) {
+	return (entry_expired(bad, now) ||
+		dns_name_issubdomain(bad->name, name));
 }
 
 void
 dns_badcache_flushtree(dns_badcache_t *bc, const dns_name_t *name) {
-	dns_bcentry_t *bad, *prev, *next;
-	unsigned int i;
-	int n;
-	isc_time_t now;
-	isc_result_t result;
+	uint64_t now;
 
 	REQUIRE(VALID_BADCACHE(bc));
 	REQUIRE(name != NULL);
 
-	/*
-	 * We write lock the tree to avoid relocking every node
-	 * individually.
-	 */
-	RWLOCK(&bc->lock, isc_rwlocktype_write);
+	now = now_tons();
+	for (size_t i = 0; i < BADCACHE_SHARDS; i++) {
+		bcshard_t *shard = &bc->shards[i];
 
-	result = isc_time_now(&now);
-	if (result != ISC_R_SUCCESS) {
-		isc_time_settoepoch(&now);
+		shard_lock(shard);
+		shard_flush(bc, shard, match_tree, name, now);
+		shard_unlock(bc, shard);
 	}
+}
 
-	for (i = 0; atomic_load_relaxed(&bc->count) > 0 && i < bc->size; i++) {
-		prev = NULL;
-		for (bad = bc->table[i]; bad != NULL; bad = next) {
-			next = bad->next;
-			n = isc_time_compare(&bad->expire, &now);
-			if (n < 0 || dns_name_issubdomain(bad->name, name)) {
-				if (prev == NULL) {
-					bc->table[i] = bad->next;
-				} else {
-					prev->next = bad->next;
-				}
+static bool
+match_expired(dns_bcentry_t *bad, const dns_name_t *name, uint64_t now) {
+	UNUSED(name);
 
-				isc_mem_put(bc->mctx, bad, sizeof(*bad));
-				atomic_fetch_sub_relaxed(&bc->count, 1);
-			} else {
-				prev = bad;
-			}
-		}
-	}
-
-	RWUNLOCK(&bc->lock, isc_rwlocktype_write);
+	return (entry_expired(bad, now));
 }
 
 void
 dns_badcache_print(dns_badcache_t *bc, const char *cachename, FILE *fp) {
 	char namebuf[DNS_NAME_FORMATSIZE];
 	char typebuf[DNS_RDATATYPE_FORMATSIZE];
-	dns_bcentry_t *bad, *next, *prev;
-	isc_time_t now;
-	unsigned int i;
-	uint64_t t;
+	uint64_t now;
 
 	REQUIRE(VALID_BADCACHE(bc));
 	REQUIRE(cachename != NULL);
 	REQUIRE(fp != NULL);
 
-	/*
-	 * We write lock the tree to avoid relocking every node
-	 * individually.
-	 */
-	RWLOCK(&bc->lock, isc_rwlocktype_write);
 	fprintf(fp, ";\n; %s\n;\n", cachename);
 
-	TIME_NOW(&now);
-	for (i = 0; atomic_load_relaxed(&bc->count) > 0 && i < bc->size; i++) {
-		prev = NULL;
-		for (bad = bc->table[i]; bad != NULL; bad = next) {
-			next = bad->next;
-			if (isc_time_compare(&bad->expire, &now) < 0) {
-				if (prev != NULL) {
-					prev->next = bad->next;
-				} else {
-					bc->table[i] = bad->next;
-				}
-
-				isc_mem_put(bc->mctx, bad, sizeof(*bad));
-				atomic_fetch_sub_relaxed(&bc->count, 1);
-				continue;
+	now = now_tons();
+	for (size_t i = 0; i < BADCACHE_SHARDS; i++) {
+		bcshard_t *shard = &bc->shards[i];
+		bctable_t *table = NULL;
+
+		shard_lock(shard);
+		shard_flush(bc, shard, match_expired, NULL, now);
+		table = shard_table(shard);
+		for (unsigned int j = 0; shard->count > 0 && j < table->size;
+		     j++)
+		{
+			dns_bcentry_t *bad = NULL;
+
+			bad = (dns_bcentry_t *)atomic_load_relaxed(
+				&table->buckets[j]);
+			for (; bad != NULL; bad = entry_next(bad)) {
+				uint64_t t = atomic_load_relaxed(&bad->expire);
+
+				dns_name_format(bad->name, namebuf,
+						sizeof(namebuf));
+				dns_rdatatype_format(bad->type, typebuf,
+						     sizeof(typebuf));
+				fprintf(fp,
+					"; %s/%s [ttl "
+					"%" PRIu64 "]\n",
+					namebuf, typebuf, (t - now) / 1000000);
 			}
-			prev = bad;
-			dns_name_format(bad->name, namebuf, sizeof(namebuf));
-			dns_rdatatype_format(bad->type, typebuf,
-					     sizeof(typebuf));
-			t = isc_time_microdiff(&bad->expire, &now);
-			t /= 1000;
-			fprintf(fp,
-				"; %s/%s [ttl "
-				"%" PRIu64 "]\n",
-				namebuf, typebuf, t);
 		}
+		shard_unlock(bc, shard);
 	}
-	RWUNLOCK(&bc->lock, isc_rwlocktype_write);
 }
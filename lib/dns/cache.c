@@ -16,7 +16,9 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/async.h>
 #include <isc/event.h>
+#include <isc/loop.h>
 #include <isc/mem.h>
 #include <isc/print.h>
 #include <isc/refcount.h>
@@ -27,16 +29,22 @@
 #include <isc/time.h>
 #include <isc/timer.h>
 #include <isc/util.h>
+#include <isc/work.h>
 
 #include <dns/cache.h>
+#include <dns/callbacks.h>
+#include <dns/coldcache.h>
 #include <dns/db.h>
 #include <dns/dbiterator.h>
 #include <dns/events.h>
+#include <dns/keycache.h>
 #include <dns/log.h>
+#include <dns/master.h>
 #include <dns/masterdump.h>
 #include <dns/rdata.h>
 #include <dns/rdataset.h>
 #include <dns/rdatasetiter.h>
+#include <dns/sigcache.h>
 #include <dns/stats.h>
 
 #ifdef HAVE_JSON_C
@@ -65,6 +73,14 @@
  * See also DNS_CACHE_MINSIZE
  */
 #define DNS_CACHE_CLEANERINCREMENT 1000U /*%< Number of nodes. */
+/*!
+ * Control background cleaning.
+ * CLEANERBUDGET is how long a worker thread spends cleaning before it
+ * gives the thread back and queues the next run, in microseconds.
+ * Each dns_db_expire() call in a run removes up to
+ * DNS_CACHE_CLEANERINCREMENT entries.
+ */
+#define DNS_CACHE_CLEANERBUDGET 10000U /*%< Microseconds. */
 
 /***
  ***	Types
@@ -119,6 +135,17 @@ struct cache_cleaner {
 	bool overmem;		/*% The cache is in an overmem state.
 				 * */
 	bool replaceiterator;
+
+	/*
+	 * Background cleaning, on a worker thread, for databases that
+	 * support dns_db_expire().  'bgrunning' and 'exiting' are locked
+	 * by 'lock'; 'bgremoved' is only used by the run in progress.
+	 */
+	isc_loop_t *loop;
+	bool bgrunning;
+	bool exiting;
+	unsigned int bgremoved;
+	isc_result_t bgresult;
 };
 
 /*%
@@ -145,9 +172,29 @@ struct dns_cache {
 	size_t size;
 	dns_ttl_t serve_stale_ttl;
 	dns_ttl_t serve_stale_refresh;
+	dns_evictionpolicy_t evictionpolicy;
+	char *snapshotfile;
+	dns_coldcache_t *coldtier;
 	isc_stats_t *stats;
+	dns_sigcache_t *sigcache;
+	dns_keycache_t *keycache;
 };
 
+/*%
+ * State of a snapshot being loaded by a worker thread.
+ */
+typedef struct cache_snapshot {
+	isc_mem_t *mctx;
+	dns_cache_t *cache;
+	dns_db_t *db;
+	char *filename;
+	isc_stdtime_t now;
+	unsigned int count;
+	isc_result_t result;
+	dns_cache_loaddone_t done;
+	void *arg;
+} cache_snapshot_t;
+
 /***
  ***	Functions
  ***/
@@ -168,6 +215,15 @@ overmem_cleaning_action(isc_task_t *task, isc_event_t *event);
 static void
 water(void *arg, int mark);
 
+static void
+cache_release(dns_cache_t *cache);
+
+static void
+bgclean_work(void *arg);
+
+static void
+bgclean_done(void *arg);
+
 static isc_result_t
 cache_create_db(dns_cache_t *cache, dns_db_t **db) {
 	isc_result_t result;
@@ -176,6 +232,10 @@ cache_create_db(dns_cache_t *cache, dns_db_t **db) {
 			       cache->db_argv, db);
 	if (result == ISC_R_SUCCESS) {
 		dns_db_setservestalettl(*db, cache->serve_stale_ttl);
+		(void)dns_db_setevictionpolicy(*db, cache->evictionpolicy);
+		if (cache->coldtier != NULL) {
+			(void)dns_db_setcoldtier(*db, cache->coldtier);
+		}
 	}
 	return (result);
 }
@@ -213,6 +273,11 @@ dns_cache_create(isc_mem_t *cmctx, isc_mem_t *hmctx, isc_taskmgr_t *taskmgr,
 	isc_refcount_init(&cache->live_tasks, 1);
 	cache->rdclass = rdclass;
 	cache->serve_stale_ttl = 0;
+	cache->evictionpolicy = dns_evictionpolicy_lru;
+	cache->snapshotfile = NULL;
+	cache->coldtier = NULL;
+	cache->sigcache = NULL;
+	cache->keycache = NULL;
 
 	cache->stats = NULL;
 	result = isc_stats_create(cmctx, &cache->stats,
@@ -221,6 +286,9 @@ dns_cache_create(isc_mem_t *cmctx, isc_mem_t *hmctx, isc_taskmgr_t *taskmgr,
 		goto cleanup_lock;
 	}
 
+	dns_sigcache_create(cmctx, DNS_SIGCACHE_DEFAULTSIZE, &cache->sigcache);
+	dns_keycache_create(cmctx, DNS_KEYCACHE_DEFAULTSIZE, &cache->keycache);
+
 	cache->db_type = isc_mem_strdup(cmctx, db_type);
 
 	/*
@@ -306,6 +374,8 @@ cleanup_dbargv:
 			    cache->db_argc * sizeof(char *));
 	}
 	isc_mem_free(cmctx, cache->db_type);
+	dns_sigcache_destroy(&cache->sigcache);
+	dns_keycache_destroy(&cache->keycache);
 	isc_stats_detach(&cache->stats);
 cleanup_lock:
 	isc_mutex_destroy(&cache->lock);
@@ -378,10 +448,26 @@ cache_free(dns_cache_t *cache) {
 		isc_mem_free(cache->mctx, cache->name);
 	}
 
+	if (cache->snapshotfile != NULL) {
+		isc_mem_free(cache->mctx, cache->snapshotfile);
+	}
+
+	if (cache->coldtier != NULL) {
+		dns_coldcache_detach(&cache->coldtier);
+	}
+
 	if (cache->stats != NULL) {
 		isc_stats_detach(&cache->stats);
 	}
 
+	if (cache->sigcache != NULL) {
+		dns_sigcache_destroy(&cache->sigcache);
+	}
+
+	if (cache->keycache != NULL) {
+		dns_keycache_destroy(&cache->keycache);
+	}
+
 	isc_mutex_destroy(&cache->lock);
 
 	cache->magic = 0;
@@ -409,17 +495,42 @@ dns_cache_detach(dns_cache_t **cachep) {
 	REQUIRE(VALID_CACHE(cache));
 
 	if (isc_refcount_decrement(&cache->references) == 1) {
+		LOCK(&cache->cleaner.lock);
 		cache->cleaner.overmem = false;
+		cache->cleaner.exiting = true;
+		UNLOCK(&cache->cleaner.lock);
 
-		if (isc_refcount_decrement(&cache->live_tasks) > 1) {
+		if (cache->cleaner.task != NULL) {
 			isc_task_send(cache->cleaner.task,
 				      &cache->cleaner.shutdown_event);
-		} else {
-			cache_free(cache);
 		}
+		cache_release(cache);
 	}
 }
 
+/*
+ * Drop one of the holds on 'cache' counted by live_tasks: the cache's own
+ * (given up when its last reference goes), that of the cleaner task, and
+ * that of the background cleaner while it runs.  The last one frees the
+ * cache.
+ */
+static void
+cache_release(dns_cache_t *cache) {
+	if (isc_refcount_decrement(&cache->live_tasks) == 1) {
+		cache_free(cache);
+	}
+}
+
+void
+dns_cache_setloop(dns_cache_t *cache, isc_loop_t *loop) {
+	REQUIRE(VALID_CACHE(cache));
+	REQUIRE(loop != NULL);
+
+	LOCK(&cache->cleaner.lock);
+	cache->cleaner.loop = loop;
+	UNLOCK(&cache->cleaner.lock);
+}
+
 void
 dns_cache_attachdb(dns_cache_t *cache, dns_db_t **dbp) {
 	REQUIRE(VALID_CACHE(cache));
@@ -456,6 +567,11 @@ cache_cleaner_init(dns_cache_t *cache, isc_taskmgr_t *taskmgr,
 	cleaner->iterator = NULL;
 	cleaner->overmem = false;
 	cleaner->replaceiterator = false;
+	cleaner->loop = NULL;
+	cleaner->bgrunning = false;
+	cleaner->exiting = false;
+	cleaner->bgremoved = 0;
+	cleaner->bgresult = ISC_R_SUCCESS;
 
 	cleaner->task = NULL;
 	cleaner->shutdown_event = NULL;
@@ -805,10 +921,93 @@ dns_cache_clean(dns_cache_t *cache, isc_stdtime_t now) {
 	return (result);
 }
 
+/*
+ * Run on a worker thread: remove expired entries from the cache and, if
+ * it is still overmem, the entries the eviction policy picks, until
+ * memory use is back below the low water mark, nothing more can be
+ * removed, or the CPU budget of the run is used up.
+ */
+static void
+bgclean_work(void *arg) {
+	dns_cache_t *cache = arg;
+	cache_cleaner_t *cleaner = &cache->cleaner;
+	dns_db_t *db = NULL;
+	isc_stdtime_t now;
+	isc_time_t start, end;
+	unsigned int removed;
+	bool overmem;
+
+	dns_cache_attachdb(cache, &db);
+	isc_stdtime_get(&now);
+	isc_time_now(&start);
+
+	cleaner->bgremoved = 0;
+	do {
+		LOCK(&cleaner->lock);
+		overmem = cleaner->overmem;
+		UNLOCK(&cleaner->lock);
+
+		removed = 0;
+		cleaner->bgresult = dns_db_expire(db, now, overmem,
+						  DNS_CACHE_CLEANERINCREMENT,
+						  &removed);
+		cleaner->bgremoved += removed;
+		isc_time_now(&end);
+	} while (cleaner->bgresult == ISC_R_SUCCESS && overmem &&
+		 removed > 0 &&
+		 isc_time_microdiff(&end, &start) < DNS_CACHE_CLEANERBUDGET);
+
+	dns_db_detach(&db);
+}
+
+/*
+ * Back on the loop: queue another run while the cache stays overmem and
+ * the last one made progress, or let the cleaner go.  Once it has
+ * stopped, the next crossing of the high water mark starts it again.
+ */
+static void
+bgclean_done(void *arg) {
+	dns_cache_t *cache = arg;
+	cache_cleaner_t *cleaner = &cache->cleaner;
+	bool again;
+
+	LOCK(&cleaner->lock);
+	again = cleaner->overmem && !cleaner->exiting &&
+		cleaner->bgresult == ISC_R_SUCCESS && cleaner->bgremoved > 0;
+	if (!again) {
+		cleaner->bgrunning = false;
+	}
+	UNLOCK(&cleaner->lock);
+
+	isc_log_write(dns_lctx, DNS_LOGCATEGORY_DATABASE, DNS_LOGMODULE_CACHE,
+		      ISC_LOG_DEBUG(1),
+		      "cache cleaner: removed %u entries, mem inuse %lu%s",
+		      cleaner->bgremoved,
+		      (unsigned long)isc_mem_inuse(cache->mctx),
+		      again ? ", continuing" : "");
+
+	if (again) {
+		isc_work_enqueue(cleaner->loop, bgclean_work, bgclean_done,
+				 cache);
+		return;
+	}
+
+	cache_release(cache);
+}
+
+static void
+bgclean_start(void *arg) {
+	dns_cache_t *cache = arg;
+
+	isc_work_enqueue(cache->cleaner.loop, bgclean_work, bgclean_done,
+			 cache);
+}
+
 static void
 water(void *arg, int mark) {
 	dns_cache_t *cache = arg;
 	bool overmem = (mark == ISC_MEM_HIWATER);
+	bool bgstart = false;
 
 	REQUIRE(VALID_CACHE(cache));
 
@@ -823,9 +1022,29 @@ water(void *arg, int mark) {
 	if (cache->cleaner.overmem_event != NULL) {
 		isc_task_send(cache->cleaner.task,
 			      &cache->cleaner.overmem_event);
+	} else if (overmem && cache->cleaner.task == NULL &&
+		   cache->cleaner.loop != NULL && !cache->cleaner.bgrunning &&
+		   !cache->cleaner.exiting)
+	{
+		/*
+		 * The background cleaner holds the cache until it has
+		 * finished; see cache_release().
+		 */
+		cache->cleaner.bgrunning = true;
+		isc_refcount_increment(&cache->live_tasks);
+		bgstart = true;
 	}
 
 	UNLOCK(&cache->cleaner.lock);
+
+	/*
+	 * The work is queued from the loop, as isc_work_enqueue() must
+	 * be, and water() is called from whichever thread allocated the
+	 * memory.
+	 */
+	if (bgstart) {
+		isc_async_run(cache->cleaner.loop, bgclean_start, cache);
+	}
 }
 
 void
@@ -931,6 +1150,254 @@ dns_cache_getservestalerefresh(dns_cache_t *cache) {
 	return (result == ISC_R_SUCCESS ? interval : 0);
 }
 
+void
+dns_cache_setevictionpolicy(dns_cache_t *cache, dns_evictionpolicy_t policy) {
+	REQUIRE(VALID_CACHE(cache));
+
+	LOCK(&cache->lock);
+	cache->evictionpolicy = policy;
+	UNLOCK(&cache->lock);
+
+	(void)dns_db_setevictionpolicy(cache->db, policy);
+}
+
+dns_evictionpolicy_t
+dns_cache_getevictionpolicy(dns_cache_t *cache) {
+	dns_evictionpolicy_t policy;
+
+	REQUIRE(VALID_CACHE(cache));
+
+	LOCK(&cache->lock);
+	policy = cache->evictionpolicy;
+	UNLOCK(&cache->lock);
+
+	return (policy);
+}
+
+void
+dns_cache_setsnapshotfile(dns_cache_t *cache, const char *filename) {
+	REQUIRE(VALID_CACHE(cache));
+
+	LOCK(&cache->lock);
+	if (cache->snapshotfile != NULL) {
+		isc_mem_free(cache->mctx, cache->snapshotfile);
+	}
+	if (filename != NULL) {
+		cache->snapshotfile = isc_mem_strdup(cache->mctx, filename);
+	}
+	UNLOCK(&cache->lock);
+}
+
+const char *
+dns_cache_getsnapshotfile(dns_cache_t *cache) {
+	REQUIRE(VALID_CACHE(cache));
+
+	return (cache->snapshotfile);
+}
+
+isc_result_t
+dns_cache_setcoldtier(dns_cache_t *cache, const char *filename,
+		      uint64_t size) {
+	dns_coldcache_t *coldtier = NULL, *old = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_CACHE(cache));
+
+	if (filename == NULL && cache->coldtier == NULL) {
+		return (ISC_R_SUCCESS);
+	}
+	if (filename != NULL && cache->coldtier != NULL &&
+	    strcmp(dns_coldcache_getfilename(cache->coldtier), filename) == 0 &&
+	    dns_coldcache_getsize(cache->coldtier) == size)
+	{
+		return (ISC_R_SUCCESS);
+	}
+
+	if (filename != NULL) {
+		result = dns_coldcache_create(cache->mctx, filename, size,
+					      &coldtier);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
+
+	LOCK(&cache->lock);
+	old = cache->coldtier;
+	cache->coldtier = coldtier;
+	UNLOCK(&cache->lock);
+
+	if (old != NULL) {
+		dns_coldcache_detach(&old);
+	}
+
+	/*
+	 * A cache database takes its cold tier when it is created.
+	 */
+	return (dns_cache_flush(cache));
+}
+
+const char *
+dns_cache_getcoldtierfile(dns_cache_t *cache) {
+	REQUIRE(VALID_CACHE(cache));
+
+	if (cache->coldtier == NULL) {
+		return (NULL);
+	}
+	return (dns_coldcache_getfilename(cache->coldtier));
+}
+
+uint64_t
+dns_cache_getcoldtiersize(dns_cache_t *cache) {
+	REQUIRE(VALID_CACHE(cache));
+
+	if (cache->coldtier == NULL) {
+		return (0);
+	}
+	return (dns_coldcache_getsize(cache->coldtier));
+}
+
+dns_sigcache_t *
+dns_cache_getsigcache(dns_cache_t *cache) {
+	REQUIRE(VALID_CACHE(cache));
+
+	return (cache->sigcache);
+}
+
+dns_keycache_t *
+dns_cache_getkeycache(dns_cache_t *cache) {
+	REQUIRE(VALID_CACHE(cache));
+
+	return (cache->keycache);
+}
+
+isc_result_t
+dns_cache_dumpsnapshot(dns_cache_t *cache) {
+	dns_db_t *db = NULL;
+	char *filename = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_CACHE(cache));
+
+	LOCK(&cache->lock);
+	REQUIRE(cache->snapshotfile != NULL);
+	filename = isc_mem_strdup(cache->mctx, cache->snapshotfile);
+	dns_db_attach(cache->db, &db);
+	UNLOCK(&cache->lock);
+
+	result = dns_master_dump(cache->mctx, db, NULL, &dns_master_style_cache,
+				 filename, dns_masterformat_raw, NULL);
+
+	isc_log_write(dns_lctx, DNS_LOGCATEGORY_DATABASE, DNS_LOGMODULE_CACHE,
+		      result == ISC_R_SUCCESS ? ISC_LOG_INFO : ISC_LOG_ERROR,
+		      "writing cache '%s' snapshot to '%s': %s", cache->name,
+		      filename, isc_result_totext(result));
+
+	dns_db_detach(&db);
+	isc_mem_free(cache->mctx, filename);
+
+	return (result);
+}
+
+static isc_result_t
+snapshot_add(void *arg, const dns_name_t *owner, dns_rdataset_t *rdataset) {
+	cache_snapshot_t *snapshot = arg;
+	dns_dbnode_t *node = NULL;
+	isc_result_t result;
+
+	/*
+	 * Only a cache dump records the trust of each RRset; anything
+	 * else would be loaded as authoritative data.
+	 */
+	if (rdataset->trust >= dns_trust_ultimate) {
+		return (DNS_R_BADDB);
+	}
+
+	result = dns_db_findnode(snapshot->db, owner, true, &node);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	result = dns_db_addrdataset(snapshot->db, node, NULL, snapshot->now,
+				    rdataset, 0, NULL);
+	dns_db_detachnode(snapshot->db, &node);
+
+	if (result == ISC_R_SUCCESS) {
+		snapshot->count++;
+	} else if (result == DNS_R_UNCHANGED) {
+		/* There is newer or better data in the cache already. */
+		result = ISC_R_SUCCESS;
+	}
+
+	return (result);
+}
+
+static void
+snapshot_load_cb(void *arg) {
+	cache_snapshot_t *snapshot = arg;
+	dns_rdatacallbacks_t callbacks;
+
+	dns_rdatacallbacks_init(&callbacks);
+	callbacks.add = snapshot_add;
+	callbacks.add_private = snapshot;
+
+	isc_stdtime_get(&snapshot->now);
+	snapshot->result = dns_master_loadfile(
+		snapshot->filename, dns_db_origin(snapshot->db),
+		dns_db_origin(snapshot->db), dns_db_class(snapshot->db),
+		DNS_MASTER_AGETTL, 0, &callbacks, NULL, NULL, snapshot->mctx,
+		dns_masterformat_raw, 0);
+}
+
+static void
+snapshot_done_cb(void *arg) {
+	cache_snapshot_t *snapshot = arg;
+
+	isc_log_write(dns_lctx, DNS_LOGCATEGORY_DATABASE, DNS_LOGMODULE_CACHE,
+		      snapshot->result == ISC_R_SUCCESS ||
+				      snapshot->result == ISC_R_FILENOTFOUND
+			      ? ISC_LOG_INFO
+			      : ISC_LOG_ERROR,
+		      "loading cache '%s' snapshot from '%s': %s; "
+		      "%u RRsets added",
+		      snapshot->cache->name, snapshot->filename,
+		      isc_result_totext(snapshot->result), snapshot->count);
+
+	if (snapshot->done != NULL) {
+		snapshot->done(snapshot->arg, snapshot->result,
+			       snapshot->count);
+	}
+
+	dns_db_detach(&snapshot->db);
+	isc_mem_free(snapshot->mctx, snapshot->filename);
+	dns_cache_detach(&snapshot->cache);
+	isc_mem_putanddetach(&snapshot->mctx, snapshot, sizeof(*snapshot));
+}
+
+void
+dns_cache_loadsnapshot(dns_cache_t *cache, isc_loop_t *loop,
+		       dns_cache_loaddone_t done, void *arg) {
+	cache_snapshot_t *snapshot = NULL;
+
+	REQUIRE(VALID_CACHE(cache));
+	REQUIRE(loop != NULL);
+
+	snapshot = isc_mem_get(cache->mctx, sizeof(*snapshot));
+	*snapshot = (cache_snapshot_t){
+		.result = ISC_R_UNSET,
+		.done = done,
+		.arg = arg,
+	};
+	isc_mem_attach(cache->mctx, &snapshot->mctx);
+	dns_cache_attach(cache, &snapshot->cache);
+
+	LOCK(&cache->lock);
+	REQUIRE(cache->snapshotfile != NULL);
+	snapshot->filename = isc_mem_strdup(cache->mctx, cache->snapshotfile);
+	dns_db_attach(cache->db, &snapshot->db);
+	UNLOCK(&cache->lock);
+
+	isc_work_enqueue(loop, snapshot_load_cb, snapshot_done_cb, snapshot);
+}
+
 /*
  * The cleaner task is shutting down; do the necessary cleanup.
  */
@@ -952,9 +1419,7 @@ cleaner_shutdown_action(isc_task_t *task, isc_event_t *event) {
 	/* FIXME: Make sure we don't reschedule anymore. */
 	/* (void)isc_task_purgeevent(task, cache->cleaner.resched_event); */
 
-	isc_refcount_decrementz(&cache->live_tasks);
-
-	cache_free(cache);
+	cache_release(cache);
 }
 
 isc_result_t
@@ -992,6 +1457,12 @@ dns_cache_flush(dns_cache_t *cache) {
 	UNLOCK(&cache->cleaner.lock);
 	UNLOCK(&cache->lock);
 
+	dns_sigcache_flush(cache->sigcache);
+	dns_keycache_flush(cache->keycache);
+	if (cache->coldtier != NULL) {
+		dns_coldcache_flush(cache->coldtier);
+	}
+
 	if (dbiterator != NULL) {
 		dns_dbiterator_destroy(&dbiterator);
 	}
@@ -1135,8 +1606,23 @@ dns_cache_flushnode(dns_cache_t *cache, const dns_name_t *name, bool tree) {
 		return (ISC_R_SUCCESS);
 	}
 
+	/*
+	 * The cold tier can't be searched by name; rather than leave
+	 * copies of the flushed names there, forget all of it.
+	 */
+	if (cache->coldtier != NULL) {
+		dns_coldcache_flush(cache->coldtier);
+	}
+
 	if (tree) {
-		result = cleartree(cache->db, name);
+		/*
+		 * Flush the tree in constant time if the database can,
+		 * and walk it otherwise.
+		 */
+		result = dns_db_flushtree(cache->db, name);
+		if (result == ISC_R_NOTIMPLEMENTED || result == ISC_R_QUOTA) {
+			result = cleartree(cache->db, name);
+		}
 	} else {
 		result = dns_db_findnode(cache->db, name, false, &node);
 		if (result == ISC_R_NOTFOUND) {
@@ -1252,6 +1738,12 @@ dns_cache_dumpstats(dns_cache_t *cache, FILE *fp) {
 	fprintf(fp, "%20" PRIu64 " %s\n",
 		values[dns_cachestatscounter_coveringnsec],
 		"covering nsec returned");
+	fprintf(fp, "%20" PRIu64 " %s\n",
+		values[dns_cachestatscounter_colddemoted],
+		"cache records moved to the cold tier");
+	fprintf(fp, "%20" PRIu64 " %s\n",
+		values[dns_cachestatscounter_coldpromoted],
+		"cache records moved back from the cold tier");
 	fprintf(fp, "%20u %s\n", dns_db_nodecount(cache->db, dns_dbtree_main),
 		"cache database nodes");
 	fprintf(fp, "%20u %s\n", dns_db_nodecount(cache->db, dns_dbtree_nsec),
@@ -1322,6 +1814,10 @@ dns_cache_renderxml(dns_cache_t *cache, void *writer0) {
 			writer));
 	TRY0(renderstat("CoveringNSEC",
 			values[dns_cachestatscounter_coveringnsec], writer));
+	TRY0(renderstat("ColdDemoted",
+			values[dns_cachestatscounter_colddemoted], writer));
+	TRY0(renderstat("ColdPromoted",
+			values[dns_cachestatscounter_coldpromoted], writer));
 
 	TRY0(renderstat("CacheNodes",
 			dns_db_nodecount(cache->db, dns_dbtree_main), writer));
@@ -1391,6 +1887,15 @@ dns_cache_renderjson(dns_cache_t *cache, void *cstats0) {
 	CHECKMEM(obj);
 	json_object_object_add(cstats, "CoveringNSEC", obj);
 
+	obj = json_object_new_int64(values[dns_cachestatscounter_colddemoted]);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "ColdDemoted", obj);
+
+	obj = json_object_new_int64(
+		values[dns_cachestatscounter_coldpromoted]);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "ColdPromoted", obj);
+
 	obj = json_object_new_int64(
 		dns_db_nodecount(cache->db, dns_dbtree_main));
 	CHECKMEM(obj);
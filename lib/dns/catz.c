@@ -29,6 +29,7 @@
 #include <dns/catz.h>
 #include <dns/dbiterator.h>
 #include <dns/events.h>
+#include <dns/journal.h>
 #include <dns/rdatasetiter.h>
 #include <dns/view.h>
 #include <dns/zone.h>
@@ -45,6 +46,13 @@
 
 #define DNS_CATZ_VERSION_UNDEFINED ((uint32_t)(-1))
 
+#define CHECK(op)                            \
+	do {                                 \
+		result = (op);               \
+		if (result != ISC_R_SUCCESS) \
+			goto cleanup;        \
+	} while (0)
+
 /*%
  * Change of ownership permissions
  */
@@ -90,6 +98,14 @@ struct dns_catz_zone {
 	dns_db_t *db;
 	dns_dbversion_t *dbversion;
 
+	/*
+	 * Serial of the version the entries were last built from, valid
+	 * if 'processed' is set; the changes made after it are read from
+	 * the zone's journal so that only the affected members are redone.
+	 */
+	uint32_t processed_serial;
+	bool processed;
+
 	isc_timer_t *updatetimer;
 
 	bool active;
@@ -106,10 +122,10 @@ static isc_result_t
 catz_process_zones_suboption(dns_catz_zone_t *zone, dns_rdataset_t *value,
 			     dns_label_t *mhash, dns_name_t *name);
 static void
-catz_entry_add_or_mod(dns_catz_zone_t *target, isc_ht_t *ht, unsigned char *key,
-		      size_t keysize, dns_catz_entry_t *nentry,
-		      dns_catz_entry_t *oentry, const char *msg,
-		      const char *zname, const char *czname);
+catz_entry_add_or_mod(dns_catz_zone_t *target, isc_ht_t *oldentries,
+		      isc_ht_t *ht, unsigned char *key, size_t keysize,
+		      dns_catz_entry_t *nentry, dns_catz_entry_t *oentry,
+		      const char *msg, const char *zname, const char *czname);
 
 /*%
  * Collection of catalog zones for a view
@@ -413,10 +429,20 @@ dns_catz_zone_resetdefoptions(dns_catz_zone_t *zone) {
 
 	dns_catz_options_free(&zone->defoptions, zone->catzs->mctx);
 	dns_catz_options_init(&zone->defoptions);
+
+	/* The defaults apply to every member: rebuild them all. */
+	zone->processed = false;
 }
 
-isc_result_t
-dns_catz_zones_merge(dns_catz_zone_t *target, dns_catz_zone_t *newzone) {
+/*
+ * Walk the entries of 'newzone' against 'oldentries', the entries of
+ * 'target' they replace, and call the zone modification methods for the
+ * member zones which were added, modified or removed.  On return
+ * 'oldentries' is empty and the current entries are left in 'newzone'.
+ */
+static void
+catz_merge_entries(dns_catz_zone_t *target, dns_catz_zone_t *newzone,
+		   isc_ht_t *oldentries) {
 	isc_result_t result;
 	isc_ht_iter_t *iter1 = NULL, *iter2 = NULL;
 	isc_ht_iter_t *iteradd = NULL, *itermod = NULL;
@@ -426,23 +452,10 @@ dns_catz_zones_merge(dns_catz_zone_t *target, dns_catz_zone_t *newzone) {
 	char zname[DNS_NAME_FORMATSIZE];
 	dns_catz_zoneop_fn_t addzone, modzone, delzone;
 
-	REQUIRE(DNS_CATZ_ZONE_VALID(newzone));
-	REQUIRE(DNS_CATZ_ZONE_VALID(target));
-
-	/* TODO verify the new zone first! */
-
 	addzone = target->catzs->zmm->addzone;
 	modzone = target->catzs->zmm->modzone;
 	delzone = target->catzs->zmm->delzone;
 
-	/* Copy zoneoptions from newzone into target. */
-
-	dns_catz_options_free(&target->zoneoptions, target->catzs->mctx);
-	dns_catz_options_copy(target->catzs->mctx, &newzone->zoneoptions,
-			      &target->zoneoptions);
-	dns_catz_options_setdefault(target->catzs->mctx, &target->defoptions,
-				    &target->zoneoptions);
-
 	dns_name_format(&target->name, czname, DNS_NAME_FORMATSIZE);
 
 	isc_ht_init(&toadd, target->catzs->mctx, 1, ISC_HT_CASE_SENSITIVE);
@@ -451,7 +464,7 @@ dns_catz_zones_merge(dns_catz_zone_t *target, dns_catz_zone_t *newzone) {
 
 	isc_ht_iter_create(newzone->entries, &iter1);
 
-	isc_ht_iter_create(target->entries, &iter2);
+	isc_ht_iter_create(oldentries, &iter2);
 
 	/*
 	 * We can create those iterators now, even though toadd and tomod are
@@ -548,7 +561,7 @@ dns_catz_zones_merge(dns_catz_zone_t *target, dns_catz_zone_t *newzone) {
 		}
 
 		/* Try to find the zone in the old catalog zone */
-		result = isc_ht_find(target->entries, key, (uint32_t)keysize,
+		result = isc_ht_find(oldentries, key, (uint32_t)keysize,
 				     (void **)&oentry);
 		if (result != ISC_R_SUCCESS) {
 			if (zt_find_result == ISC_R_SUCCESS &&
@@ -573,9 +586,9 @@ dns_catz_zones_merge(dns_catz_zone_t *target, dns_catz_zone_t *newzone) {
 					      zname);
 			}
 
-			catz_entry_add_or_mod(target, toadd, key, keysize,
-					      nentry, NULL, "adding", zname,
-					      czname);
+			catz_entry_add_or_mod(target, oldentries, toadd, key,
+					      keysize, nentry, NULL, "adding",
+					      zname, czname);
 			continue;
 		}
 
@@ -585,16 +598,16 @@ dns_catz_zones_merge(dns_catz_zone_t *target, dns_catz_zone_t *newzone) {
 				      "catz: zone '%s' was expected to exist "
 				      "but can not be found, will be restored",
 				      zname);
-			catz_entry_add_or_mod(target, toadd, key, keysize,
-					      nentry, oentry, "adding", zname,
-					      czname);
+			catz_entry_add_or_mod(target, oldentries, toadd, key,
+					      keysize, nentry, oentry, "adding",
+					      zname, czname);
 			continue;
 		}
 
 		if (dns_catz_entry_cmp(oentry, nentry) != true) {
-			catz_entry_add_or_mod(target, tomod, key, keysize,
-					      nentry, oentry, "modifying",
-					      zname, czname);
+			catz_entry_add_or_mod(target, oldentries, tomod, key,
+					      keysize, nentry, oentry,
+					      "modifying", zname, czname);
 			continue;
 		}
 
@@ -603,7 +616,7 @@ dns_catz_zones_merge(dns_catz_zone_t *target, dns_catz_zone_t *newzone) {
 		 * removed as a non-existing entry below.
 		 */
 		dns_catz_entry_detach(target, &oentry);
-		result = isc_ht_delete(target->entries, key, (uint32_t)keysize);
+		result = isc_ht_delete(oldentries, key, (uint32_t)keysize);
 		RUNTIME_CHECK(result == ISC_R_SUCCESS);
 	}
 	RUNTIME_CHECK(result == ISC_R_NOMORE);
@@ -630,9 +643,8 @@ dns_catz_zones_merge(dns_catz_zone_t *target, dns_catz_zone_t *newzone) {
 	}
 	RUNTIME_CHECK(result == ISC_R_NOMORE);
 	isc_ht_iter_destroy(&iter2);
-	/* At this moment target->entries has to be be empty. */
-	INSIST(isc_ht_count(target->entries) == 0);
-	isc_ht_destroy(&target->entries);
+	/* At this moment oldentries has to be be empty. */
+	INSIST(isc_ht_count(oldentries) == 0);
 
 	for (result = isc_ht_iter_first(iteradd); result == ISC_R_SUCCESS;
 	     result = isc_ht_iter_delcurrent_next(iteradd))
@@ -668,6 +680,31 @@ dns_catz_zones_merge(dns_catz_zone_t *target, dns_catz_zone_t *newzone) {
 			      zname, czname, isc_result_totext(result));
 	}
 
+	isc_ht_iter_destroy(&iteradd);
+	isc_ht_iter_destroy(&itermod);
+	isc_ht_destroy(&toadd);
+	isc_ht_destroy(&tomod);
+}
+
+isc_result_t
+dns_catz_zones_merge(dns_catz_zone_t *target, dns_catz_zone_t *newzone) {
+	isc_result_t result;
+
+	REQUIRE(DNS_CATZ_ZONE_VALID(newzone));
+	REQUIRE(DNS_CATZ_ZONE_VALID(target));
+
+	/* TODO verify the new zone first! */
+
+	/* Copy zoneoptions from newzone into target. */
+
+	dns_catz_options_free(&target->zoneoptions, target->catzs->mctx);
+	dns_catz_options_copy(target->catzs->mctx, &newzone->zoneoptions,
+			      &target->zoneoptions);
+	dns_catz_options_setdefault(target->catzs->mctx, &target->defoptions,
+				    &target->zoneoptions);
+
+	catz_merge_entries(target, newzone, target->entries);
+	isc_ht_destroy(&target->entries);
 	target->entries = newzone->entries;
 	newzone->entries = NULL;
 
@@ -698,14 +735,67 @@ dns_catz_zones_merge(dns_catz_zone_t *target, dns_catz_zone_t *newzone) {
 		newzone->coos = NULL;
 	}
 
-	result = ISC_R_SUCCESS;
+	return (ISC_R_SUCCESS);
+}
 
-	isc_ht_iter_destroy(&iteradd);
-	isc_ht_iter_destroy(&itermod);
-	isc_ht_destroy(&toadd);
-	isc_ht_destroy(&tomod);
+/*
+ * Merge 'newzone', built only from the records of the member zones whose
+ * unique labels are the keys of 'members', into 'target'.  The entries of
+ * all other member zones, the catalog-wide options and the change of
+ * ownership records of 'target' are kept as they are.
+ */
+static void
+catz_merge_members(dns_catz_zone_t *target, dns_catz_zone_t *newzone,
+		   isc_ht_t *members) {
+	isc_result_t result;
+	isc_ht_iter_t *iter = NULL;
+	isc_ht_t *oldentries = NULL;
 
-	return (result);
+	isc_ht_init(&oldentries, target->catzs->mctx, 4,
+		    ISC_HT_CASE_INSENSITIVE);
+
+	isc_ht_iter_create(members, &iter);
+	for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_next(iter))
+	{
+		dns_catz_entry_t *entry = NULL;
+		unsigned char *key = NULL;
+		size_t keysize;
+
+		isc_ht_iter_currentkey(iter, &key, &keysize);
+		if (isc_ht_find(target->entries, key, (uint32_t)keysize,
+				(void **)&entry) != ISC_R_SUCCESS)
+		{
+			continue;
+		}
+		result = isc_ht_add(oldentries, key, (uint32_t)keysize, entry);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		result = isc_ht_delete(target->entries, key, (uint32_t)keysize);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+	RUNTIME_CHECK(result == ISC_R_NOMORE);
+	isc_ht_iter_destroy(&iter);
+
+	catz_merge_entries(target, newzone, oldentries);
+	isc_ht_destroy(&oldentries);
+
+	/* Move the current entries of the members into 'target'. */
+	isc_ht_iter_create(newzone->entries, &iter);
+	for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_delcurrent_next(iter))
+	{
+		dns_catz_entry_t *entry = NULL;
+		unsigned char *key = NULL;
+		size_t keysize;
+
+		isc_ht_iter_current(iter, (void **)&entry);
+		isc_ht_iter_currentkey(iter, &key, &keysize);
+		result = isc_ht_add(target->entries, key, (uint32_t)keysize,
+				    entry);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+	RUNTIME_CHECK(result == ISC_R_NOMORE);
+	isc_ht_iter_destroy(&iter);
 }
 
 isc_result_t
@@ -776,7 +866,8 @@ dns_catz_new_zone(dns_catz_zones_t *catzs, dns_catz_zone_t **zonep,
 	dns_name_init(&new_zone->name, NULL);
 	dns_name_dup(name, catzs->mctx, &new_zone->name);
 
-	isc_ht_init(&new_zone->entries, catzs->mctx, 4, ISC_HT_CASE_SENSITIVE);
+	isc_ht_init(&new_zone->entries, catzs->mctx, 4,
+		    ISC_HT_CASE_INSENSITIVE);
 	isc_ht_init(&new_zone->coos, catzs->mctx, 4, ISC_HT_CASE_INSENSITIVE);
 
 	new_zone->updatetimer = NULL;
@@ -1620,10 +1711,10 @@ catz_process_zones_suboption(dns_catz_zone_t *zone, dns_rdataset_t *value,
 }
 
 static void
-catz_entry_add_or_mod(dns_catz_zone_t *target, isc_ht_t *ht, unsigned char *key,
-		      size_t keysize, dns_catz_entry_t *nentry,
-		      dns_catz_entry_t *oentry, const char *msg,
-		      const char *zname, const char *czname) {
+catz_entry_add_or_mod(dns_catz_zone_t *target, isc_ht_t *oldentries,
+		      isc_ht_t *ht, unsigned char *key, size_t keysize,
+		      dns_catz_entry_t *nentry, dns_catz_entry_t *oentry,
+		      const char *msg, const char *zname, const char *czname) {
 	isc_result_t result = isc_ht_add(ht, key, (uint32_t)keysize, nentry);
 
 	if (result != ISC_R_SUCCESS) {
@@ -1634,7 +1725,7 @@ catz_entry_add_or_mod(dns_catz_zone_t *target, isc_ht_t *ht, unsigned char *key,
 	}
 	if (oentry != NULL) {
 		dns_catz_entry_detach(target, &oentry);
-		result = isc_ht_delete(target->entries, key, (uint32_t)keysize);
+		result = isc_ht_delete(oldentries, key, (uint32_t)keysize);
 		RUNTIME_CHECK(result == ISC_R_SUCCESS);
 	}
 }
@@ -2028,6 +2119,7 @@ dns_catz_dbupdate_callback(dns_db_t *db, void *fn_arg) {
 		 * registered at the end of update_from_db
 		 */
 		zone->db_registered = false;
+		zone->processed = false;
 	}
 	if (zone->db == NULL) {
 		dns_db_attach(db, &zone->db);
@@ -2075,6 +2167,307 @@ catz_rdatatype_is_processable(const dns_rdatatype_t type) {
 		type != dns_rdatatype_cdnskey && type != dns_rdatatype_zonemd);
 }
 
+/*
+ * Process all the records of 'node' in 'version' of 'db' into 'newzone'.
+ */
+static isc_result_t
+catz_process_node(dns_catz_zone_t *newzone, dns_db_t *db,
+		  dns_dbversion_t *version, dns_dbnode_t *node,
+		  dns_name_t *name) {
+	isc_result_t result;
+	dns_rdatasetiter_t *rdsiter = NULL;
+	dns_rdataset_t rdataset;
+	char cname[DNS_NAME_FORMATSIZE];
+
+	result = dns_db_allrdatasets(db, node, version, 0, &rdsiter);
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+			      DNS_LOGMODULE_MASTER, ISC_LOG_ERROR,
+			      "catz: failed to fetch rrdatasets - %s",
+			      isc_result_totext(result));
+		return (result);
+	}
+
+	dns_rdataset_init(&rdataset);
+	result = dns_rdatasetiter_first(rdsiter);
+	while (result == ISC_R_SUCCESS) {
+		dns_rdatasetiter_current(rdsiter, &rdataset);
+
+		/*
+		 * Skip processing DNSSEC-related and ZONEMD types,
+		 * because we are not interested in them in the context
+		 * of a catalog zone, and processing them will fail
+		 * and produce an unnecessary warning message.
+		 */
+		if (!catz_rdatatype_is_processable(rdataset.type)) {
+			goto next;
+		}
+
+		result = dns_catz_update_process(newzone->catzs, newzone, name,
+						 &rdataset);
+		if (result != ISC_R_SUCCESS) {
+			char typebuf[DNS_RDATATYPE_FORMATSIZE];
+			char classbuf[DNS_RDATACLASS_FORMATSIZE];
+
+			dns_name_format(name, cname, DNS_NAME_FORMATSIZE);
+			dns_rdataclass_format(rdataset.rdclass, classbuf,
+					      sizeof(classbuf));
+			dns_rdatatype_format(rdataset.type, typebuf,
+					     sizeof(typebuf));
+			isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+				      DNS_LOGMODULE_MASTER, ISC_LOG_WARNING,
+				      "catz: invalid record in catalog "
+				      "zone - %s %s %s (%s) - ignoring",
+				      cname, classbuf, typebuf,
+				      isc_result_totext(result));
+		}
+	next:
+		dns_rdataset_disassociate(&rdataset);
+		result = dns_rdatasetiter_next(rdsiter);
+	}
+
+	dns_rdatasetiter_destroy(&rdsiter);
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * If 'name' belongs to a member zone of 'catz', that is it is
+ * '<unique-label>.zones.<catalog>' or one of its member properties,
+ * store the unique label in 'mhash'.  The change of ownership property
+ * is not treated as belonging to the member, as it is kept per catalog.
+ */
+static bool
+catz_member_label(dns_catz_zone_t *catz, const dns_name_t *name,
+		  dns_label_t *mhash) {
+	dns_label_t label;
+	unsigned int nlabels;
+
+	if (!dns_name_issubdomain(name, &catz->name)) {
+		return (false);
+	}
+
+	nlabels = dns_name_countlabels(name) -
+		  dns_name_countlabels(&catz->name);
+	if (nlabels < 2) {
+		return (false);
+	}
+
+	dns_name_getlabel(name, nlabels - 1, &label);
+	if (catz_get_option(&label) != CATZ_OPT_ZONES) {
+		return (false);
+	}
+
+	if (nlabels > 2) {
+		dns_name_getlabel(name, nlabels - 3, &label);
+		if (catz_get_option(&label) == CATZ_OPT_COO) {
+			return (false);
+		}
+	}
+
+	dns_name_getlabel(name, nlabels - 2, mhash);
+	return (true);
+}
+
+/*
+ * Collect into '*membersp' the unique labels of the member zones of
+ * 'catz' changed between its last processed serial and 'serial', reading
+ * the changes from the journal of the catalog zone.  Fails if the changes
+ * are not available, or if anything else than member zones changed.
+ */
+static isc_result_t
+catz_journal_members(dns_catz_zone_t *catz, uint32_t serial,
+		     isc_ht_t **membersp) {
+	isc_result_t result;
+	isc_mem_t *mctx = catz->catzs->mctx;
+	dns_zone_t *zone = NULL;
+	dns_journal_t *journal = NULL;
+	const char *journalfile = NULL;
+	isc_ht_t *members = NULL;
+
+	REQUIRE(membersp != NULL && *membersp == NULL);
+
+	result = dns_view_findzone(catz->catzs->view, &catz->name, &zone);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	journalfile = dns_zone_getjournal(zone);
+	if (journalfile == NULL) {
+		CHECK(ISC_R_NOTFOUND);
+	}
+
+	CHECK(dns_journal_open(mctx, journalfile, DNS_JOURNAL_READ, &journal));
+	CHECK(dns_journal_iter_init(journal, catz->processed_serial, serial,
+				    NULL));
+
+	isc_ht_init(&members, mctx, 4, ISC_HT_CASE_INSENSITIVE);
+	for (result = dns_journal_first_rr(journal); result == ISC_R_SUCCESS;
+	     result = dns_journal_next_rr(journal))
+	{
+		dns_name_t *name = NULL;
+		dns_rdata_t *rdata = NULL;
+		dns_label_t mhash;
+		uint32_t ttl;
+
+		dns_journal_current_rr(journal, &name, &ttl, &rdata);
+
+		if (!catz_rdatatype_is_processable(rdata->type)) {
+			continue;
+		}
+		if (dns_name_equal(name, &catz->name) &&
+		    (rdata->type == dns_rdatatype_soa ||
+		     rdata->type == dns_rdatatype_ns))
+		{
+			continue;
+		}
+		if (!catz_member_label(catz, name, &mhash)) {
+			CHECK(ISC_R_NOTFOUND);
+		}
+
+		result = isc_ht_add(members, mhash.base, mhash.length, NULL);
+		if (result != ISC_R_SUCCESS && result != ISC_R_EXISTS) {
+			goto cleanup;
+		}
+	}
+	if (result == ISC_R_NOMORE) {
+		*membersp = members;
+		members = NULL;
+		result = ISC_R_SUCCESS;
+	}
+
+cleanup:
+	if (members != NULL) {
+		isc_ht_destroy(&members);
+	}
+	if (journal != NULL) {
+		dns_journal_destroy(&journal);
+	}
+	dns_zone_detach(&zone);
+
+	return (result);
+}
+
+/*
+ * Process into 'newzone' all the nodes at and below 'member' in the
+ * current version of 'db'.
+ */
+static isc_result_t
+catz_process_member(dns_catz_zone_t *newzone, dns_db_t *db,
+		    dns_dbversion_t *version, dns_dbiterator_t *it,
+		    const dns_name_t *member) {
+	isc_result_t result;
+	dns_fixedname_t fixname;
+	dns_name_t *name = dns_fixedname_initname(&fixname);
+
+	result = dns_dbiterator_seek(it, member);
+	if (result == ISC_R_NOTFOUND || result == DNS_R_PARTIALMATCH) {
+		/* The member is gone, and so are its properties. */
+		return (ISC_R_SUCCESS);
+	}
+
+	while (result == ISC_R_SUCCESS) {
+		dns_dbnode_t *node = NULL;
+
+		result = dns_dbiterator_current(it, &node, name);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+
+		if (!dns_name_issubdomain(name, member)) {
+			dns_db_detachnode(db, &node);
+			break;
+		}
+
+		result = catz_process_node(newzone, db, version, node, name);
+		dns_db_detachnode(db, &node);
+		if (result == ISC_R_SUCCESS) {
+			result = dns_dbiterator_next(it);
+		}
+	}
+
+	if (result == ISC_R_NOMORE) {
+		result = ISC_R_SUCCESS;
+	}
+
+	return (result);
+}
+
+/*
+ * Apply the changes made to the catalog zone since the version that
+ * 'catz' was last built from, processing and merging only the member
+ * zones that were touched.  On failure nothing has been changed, and
+ * the caller is expected to rebuild the whole catalog.
+ */
+static isc_result_t
+catz_update_incremental(dns_catz_zone_t *catz, dns_db_t *db,
+			uint32_t serial) {
+	isc_result_t result;
+	isc_ht_t *members = NULL;
+	isc_ht_iter_t *iter = NULL;
+	dns_catz_zone_t *newzone = NULL;
+	dns_dbiterator_t *it = NULL;
+	dns_fixedname_t fzones, fmember;
+	dns_name_t *zones = NULL, *member = NULL;
+
+	CHECK(catz_journal_members(catz, serial, &members));
+	CHECK(dns_catz_new_zone(catz->catzs, &newzone, &catz->name));
+	newzone->version = catz->version;
+
+	zones = dns_fixedname_initname(&fzones);
+	CHECK(dns_name_fromstring2(zones, "zones", &catz->name, 0, NULL));
+	member = dns_fixedname_initname(&fmember);
+
+	CHECK(dns_db_createiterator(db, DNS_DB_NONSEC3, &it));
+	isc_ht_iter_create(members, &iter);
+	for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_next(iter))
+	{
+		unsigned char *key = NULL;
+		size_t keysize;
+		isc_region_t r;
+		dns_name_t mhash;
+
+		isc_ht_iter_currentkey(iter, &key, &keysize);
+		r.base = key;
+		r.length = (unsigned int)keysize;
+		dns_name_init(&mhash, NULL);
+		dns_name_fromregion(&mhash, &r);
+		CHECK(dns_name_concatenate(&mhash, zones, member, NULL));
+		CHECK(catz_process_member(newzone, db, catz->dbversion, it,
+					  member));
+	}
+	INSIST(result == ISC_R_NOMORE);
+	dns_dbiterator_destroy(&it);
+
+	if (newzone->broken) {
+		CHECK(DNS_R_BADZONE);
+	}
+
+	isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_MASTER,
+		      ISC_LOG_DEBUG(3),
+		      "catz: applying changes to %zu member zone(s)",
+		      isc_ht_count(members));
+	catz_merge_members(catz, newzone, members);
+	result = ISC_R_SUCCESS;
+
+cleanup:
+	if (iter != NULL) {
+		isc_ht_iter_destroy(&iter);
+	}
+	if (it != NULL) {
+		dns_dbiterator_destroy(&it);
+	}
+	if (newzone != NULL) {
+		dns_catz_zone_detach(&newzone);
+	}
+	if (members != NULL) {
+		isc_ht_destroy(&members);
+	}
+
+	return (result);
+}
+
 void
 dns_catz_update_from_db(dns_db_t *db, dns_catz_zones_t *catzs) {
 	dns_catz_zone_t *oldzone = NULL, *newzone = NULL;
@@ -2085,8 +2478,6 @@ dns_catz_update_from_db(dns_db_t *db, dns_catz_zones_t *catzs) {
 	dns_dbiterator_t *it = NULL;
 	dns_fixedname_t fixname;
 	dns_name_t *name;
-	dns_rdatasetiter_t *rdsiter = NULL;
-	dns_rdataset_t rdataset;
 	char bname[DNS_NAME_FORMATSIZE];
 	char cname[DNS_NAME_FORMATSIZE];
 	bool is_vers_processed = false;
@@ -2126,6 +2517,25 @@ dns_catz_update_from_db(dns_db_t *db, dns_catz_zones_t *catzs) {
 		      "catz: updating catalog zone '%s' with serial %d", bname,
 		      vers);
 
+	/*
+	 * If only member zones changed since the last processed version,
+	 * apply just those changes instead of walking the whole zone.
+	 */
+	if (oldzone->processed && oldzone->processed_serial != vers) {
+		result = catz_update_incremental(oldzone, db, vers);
+		if (result == ISC_R_SUCCESS) {
+			dns_db_closeversion(db, &oldzone->dbversion, false);
+			oldzone->processed_serial = vers;
+			goto register_update;
+		}
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+			      DNS_LOGMODULE_MASTER, ISC_LOG_DEBUG(3),
+			      "catz: catalog zone '%s' can not be updated "
+			      "incrementally (%s), processing all records",
+			      bname, isc_result_totext(result));
+	}
+	oldzone->processed = false;
+
 	result = dns_catz_new_zone(catzs, &newzone, &db->origin);
 	if (result != ISC_R_SUCCESS) {
 		dns_db_closeversion(db, &oldzone->dbversion, false);
@@ -2202,62 +2612,13 @@ dns_catz_update_from_db(dns_db_t *db, dns_catz_zones_t *catzs) {
 			continue;
 		}
 
-		result = dns_db_allrdatasets(db, node, oldzone->dbversion, 0,
-					     &rdsiter);
+		result = catz_process_node(newzone, db, oldzone->dbversion,
+					   node, name);
+		dns_db_detachnode(db, &node);
 		if (result != ISC_R_SUCCESS) {
-			isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
-				      DNS_LOGMODULE_MASTER, ISC_LOG_ERROR,
-				      "catz: failed to fetch rrdatasets - %s",
-				      isc_result_totext(result));
-			dns_db_detachnode(db, &node);
 			break;
 		}
 
-		dns_rdataset_init(&rdataset);
-		result = dns_rdatasetiter_first(rdsiter);
-		while (result == ISC_R_SUCCESS) {
-			dns_rdatasetiter_current(rdsiter, &rdataset);
-
-			/*
-			 * Skip processing DNSSEC-related and ZONEMD types,
-			 * because we are not interested in them in the context
-			 * of a catalog zone, and processing them will fail
-			 * and produce an unnecessary warning message.
-			 */
-			if (!catz_rdatatype_is_processable(rdataset.type)) {
-				goto next;
-			}
-
-			result = dns_catz_update_process(catzs, newzone, name,
-							 &rdataset);
-			if (result != ISC_R_SUCCESS) {
-				char typebuf[DNS_RDATATYPE_FORMATSIZE];
-				char classbuf[DNS_RDATACLASS_FORMATSIZE];
-
-				dns_name_format(name, cname,
-						DNS_NAME_FORMATSIZE);
-				dns_rdataclass_format(rdataset.rdclass,
-						      classbuf,
-						      sizeof(classbuf));
-				dns_rdatatype_format(rdataset.type, typebuf,
-						     sizeof(typebuf));
-				isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
-					      DNS_LOGMODULE_MASTER,
-					      ISC_LOG_WARNING,
-					      "catz: invalid record in catalog "
-					      "zone - %s %s %s (%s) - ignoring",
-					      cname, classbuf, typebuf,
-					      isc_result_totext(result));
-			}
-		next:
-			dns_rdataset_disassociate(&rdataset);
-			result = dns_rdatasetiter_next(rdsiter);
-		}
-
-		dns_rdatasetiter_destroy(&rdsiter);
-
-		dns_db_detachnode(db, &node);
-
 		if (!is_vers_processed) {
 			is_vers_processed = true;
 			result = dns_dbiterator_first(it);
@@ -2324,6 +2685,10 @@ final:
 		      ISC_LOG_DEBUG(3),
 		      "catz: update_from_db: new zone merged");
 
+	oldzone->processed = true;
+	oldzone->processed_serial = vers;
+
+register_update:
 	/*
 	 * When we're doing reconfig and setting a new catalog zone
 	 * from an existing zone we won't have a chance to set up
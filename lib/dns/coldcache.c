@@ -0,0 +1,365 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <isc/atomic.h>
+#include <isc/errno.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/refcount.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/coldcache.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+
+#define COLDCACHE_MAGIC	   ISC_MAGIC('C', 'o', 'l', 'd')
+#define VALID_COLDCACHE(c) ISC_MAGIC_VALID(c, COLDCACHE_MAGIC)
+
+/*
+ * Number of locks protecting the buckets; bucket 'i' is protected by
+ * lock 'i % COLDCACHE_NLOCKS'.
+ */
+#define COLDCACHE_NLOCKS 64
+
+#define BUCKETSIZE (DNS_COLDCACHE_SLOTSIZE * DNS_COLDCACHE_WAYS)
+
+/*
+ * The header of a slot in the file, followed by the owner name in
+ * lower case wire format and the slab.  A slot is empty unless its
+ * generation is the current generation of the cold tier, which starts
+ * at one, so a new (zero filled) file is empty and flushing it only
+ * takes moving to the next generation.
+ */
+typedef struct coldslot {
+	uint32_t generation;
+	isc_stdtime_t expire;
+	uint32_t hashval;
+	uint16_t type;
+	uint16_t covers;
+	uint16_t slablen;
+	uint8_t namelen;
+	uint8_t trust;
+	unsigned char data[];
+} coldslot_t;
+
+STATIC_ASSERT(sizeof(coldslot_t) + DNS_NAME_MAXWIRE < DNS_COLDCACHE_SLOTSIZE,
+	      "DNS_COLDCACHE_SLOTSIZE is too small");
+
+struct dns_coldcache {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	isc_refcount_t references;
+	char *filename;
+	uint64_t size;
+	unsigned char *base;
+	size_t length;
+	unsigned int nbuckets;
+	atomic_uint_fast32_t generation;
+	isc_mutex_t locks[COLDCACHE_NLOCKS];
+};
+
+isc_result_t
+dns_coldcache_create(isc_mem_t *mctx, const char *filename, uint64_t size,
+		     dns_coldcache_t **cachep) {
+	dns_coldcache_t *cache = NULL;
+	uint64_t nbuckets = size / BUCKETSIZE;
+	size_t length;
+	void *base = NULL;
+	int fd;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(filename != NULL);
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	if (nbuckets == 0 || nbuckets > UINT32_MAX ||
+	    nbuckets > SIZE_MAX / BUCKETSIZE)
+	{
+		return (ISC_R_RANGE);
+	}
+	length = (size_t)nbuckets * BUCKETSIZE;
+
+	/*
+	 * Never reuse an existing file: another cache may still have it
+	 * mapped, and shrinking it would pull pages from under it.
+	 */
+	(void)unlink(filename);
+	fd = open(filename, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0) {
+		return (isc_errno_toresult(errno));
+	}
+	if (ftruncate(fd, (off_t)length) < 0) {
+		isc_result_t result = isc_errno_toresult(errno);
+		(void)close(fd);
+		(void)unlink(filename);
+		return (result);
+	}
+	base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED) {
+		isc_result_t result = isc_errno_toresult(errno);
+		(void)close(fd);
+		(void)unlink(filename);
+		return (result);
+	}
+	(void)close(fd);
+	(void)unlink(filename);
+#ifdef MADV_RANDOM
+	(void)madvise(base, length, MADV_RANDOM);
+#endif /* ifdef MADV_RANDOM */
+
+	cache = isc_mem_get(mctx, sizeof(*cache));
+	*cache = (dns_coldcache_t){
+		.size = size,
+		.base = base,
+		.length = length,
+		.nbuckets = (unsigned int)nbuckets,
+	};
+
+	isc_mem_attach(mctx, &cache->mctx);
+	isc_refcount_init(&cache->references, 1);
+	cache->filename = isc_mem_strdup(mctx, filename);
+	atomic_init(&cache->generation, 1);
+	for (size_t i = 0; i < COLDCACHE_NLOCKS; i++) {
+		isc_mutex_init(&cache->locks[i]);
+	}
+
+	cache->magic = COLDCACHE_MAGIC;
+
+	*cachep = cache;
+	return (ISC_R_SUCCESS);
+}
+
+void
+dns_coldcache_attach(dns_coldcache_t *source, dns_coldcache_t **targetp) {
+	REQUIRE(VALID_COLDCACHE(source));
+	REQUIRE(targetp != NULL && *targetp == NULL);
+
+	isc_refcount_increment(&source->references);
+	*targetp = source;
+}
+
+void
+dns_coldcache_detach(dns_coldcache_t **cachep) {
+	dns_coldcache_t *cache = NULL;
+
+	REQUIRE(cachep != NULL && VALID_COLDCACHE(*cachep));
+
+	cache = *cachep;
+	*cachep = NULL;
+
+	if (isc_refcount_decrement(&cache->references) > 1) {
+		return;
+	}
+
+	isc_refcount_destroy(&cache->references);
+	cache->magic = 0;
+	(void)munmap(cache->base, cache->length);
+	for (size_t i = 0; i < COLDCACHE_NLOCKS; i++) {
+		isc_mutex_destroy(&cache->locks[i]);
+	}
+	isc_mem_free(cache->mctx, cache->filename);
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+const char *
+dns_coldcache_getfilename(dns_coldcache_t *cache) {
+	REQUIRE(VALID_COLDCACHE(cache));
+
+	return (cache->filename);
+}
+
+uint64_t
+dns_coldcache_getsize(dns_coldcache_t *cache) {
+	REQUIRE(VALID_COLDCACHE(cache));
+
+	return (cache->size);
+}
+
+static coldslot_t *
+getslot(dns_coldcache_t *cache, unsigned int bucket, unsigned int way) {
+	return ((coldslot_t *)(cache->base + (size_t)bucket * BUCKETSIZE +
+			       way * DNS_COLDCACHE_SLOTSIZE));
+}
+
+/*
+ * Downcase 'name' into 'lname' and return the hash of the RRset, from
+ * which its bucket is chosen.
+ */
+static uint32_t
+hashrrset(const dns_name_t *name, dns_rdatatype_t type,
+	  dns_rdatatype_t covers, dns_name_t *lname) {
+	uint32_t hashval;
+
+	(void)dns_name_downcase(name, lname, NULL);
+	hashval = dns_name_fullhash(lname, true);
+	hashval ^= ((uint32_t)type << 16 | covers) * 0x9e3779b1U;
+
+	return (hashval);
+}
+
+/*
+ * Find the slot of the RRset in 'bucket', or NULL.  The bucket lock
+ * must be held.
+ */
+static coldslot_t *
+findslot(dns_coldcache_t *cache, unsigned int bucket, uint32_t generation,
+	 uint32_t hashval, const dns_name_t *lname, dns_rdatatype_t type,
+	 dns_rdatatype_t covers) {
+	for (unsigned int way = 0; way < DNS_COLDCACHE_WAYS; way++) {
+		coldslot_t *slot = getslot(cache, bucket, way);
+
+		if (slot->generation == generation &&
+		    slot->hashval == hashval && slot->type == type &&
+		    slot->covers == covers &&
+		    slot->namelen == lname->length &&
+		    memcmp(slot->data, lname->ndata, lname->length) == 0)
+		{
+			return (slot);
+		}
+	}
+
+	return (NULL);
+}
+
+bool
+dns_coldcache_put(dns_coldcache_t *cache, const dns_name_t *name,
+		  dns_rdatatype_t type, dns_rdatatype_t covers,
+		  dns_trust_t trust, isc_stdtime_t expire,
+		  const unsigned char *slab, unsigned int length) {
+	dns_fixedname_t fixed;
+	dns_name_t *lname = dns_fixedname_initname(&fixed);
+	coldslot_t *slot = NULL;
+	uint32_t hashval, generation;
+	unsigned int bucket;
+	isc_mutex_t *lock = NULL;
+
+	REQUIRE(VALID_COLDCACHE(cache));
+	REQUIRE(dns_name_isabsolute(name));
+
+	if (sizeof(*slot) + name->length + length > DNS_COLDCACHE_SLOTSIZE) {
+		return (false);
+	}
+
+	hashval = hashrrset(name, type, covers, lname);
+	bucket = hashval % cache->nbuckets;
+	lock = &cache->locks[bucket % COLDCACHE_NLOCKS];
+
+	LOCK(lock);
+	generation = atomic_load_relaxed(&cache->generation);
+	slot = findslot(cache, bucket, generation, hashval, lname, type,
+			covers);
+	for (unsigned int way = 0; slot == NULL && way < DNS_COLDCACHE_WAYS;
+	     way++)
+	{
+		/*
+		 * Take an empty slot, or else the one expiring first.
+		 */
+		coldslot_t *victim = getslot(cache, bucket, way);
+		if (victim->generation != generation) {
+			slot = victim;
+		} else if (way == DNS_COLDCACHE_WAYS - 1) {
+			slot = getslot(cache, bucket, 0);
+			for (unsigned int i = 1; i < DNS_COLDCACHE_WAYS; i++) {
+				victim = getslot(cache, bucket, i);
+				if (victim->expire < slot->expire) {
+					slot = victim;
+				}
+			}
+		}
+	}
+
+	slot->generation = generation;
+	slot->expire = expire;
+	slot->hashval = hashval;
+	slot->type = type;
+	slot->covers = covers;
+	slot->slablen = length;
+	slot->namelen = lname->length;
+	slot->trust = trust;
+	memmove(slot->data, lname->ndata, lname->length);
+	memmove(slot->data + lname->length, slab, length);
+	UNLOCK(lock);
+
+	return (true);
+}
+
+isc_result_t
+dns_coldcache_take(dns_coldcache_t *cache, const dns_name_t *name,
+		   dns_rdatatype_t type, dns_rdatatype_t covers,
+		   isc_stdtime_t now, isc_mem_t *mctx, isc_region_t *slab,
+		   dns_trust_t *trustp, isc_stdtime_t *expirep) {
+	dns_fixedname_t fixed;
+	dns_name_t *lname = dns_fixedname_initname(&fixed);
+	coldslot_t *slot = NULL;
+	uint32_t hashval, generation;
+	unsigned int bucket;
+	isc_mutex_t *lock = NULL;
+	isc_result_t result = ISC_R_NOTFOUND;
+
+	REQUIRE(VALID_COLDCACHE(cache));
+	REQUIRE(dns_name_isabsolute(name));
+	REQUIRE(slab != NULL && trustp != NULL && expirep != NULL);
+
+	hashval = hashrrset(name, type, covers, lname);
+	bucket = hashval % cache->nbuckets;
+	lock = &cache->locks[bucket % COLDCACHE_NLOCKS];
+
+	LOCK(lock);
+	generation = atomic_load_relaxed(&cache->generation);
+	slot = findslot(cache, bucket, generation, hashval, lname, type,
+			covers);
+	if (slot != NULL) {
+		if (slot->expire > now) {
+			slab->length = slot->slablen;
+			slab->base = isc_mem_get(mctx, slab->length);
+			memmove(slab->base, slot->data + slot->namelen,
+				slab->length);
+			*trustp = slot->trust;
+			*expirep = slot->expire;
+			result = ISC_R_SUCCESS;
+		}
+		slot->generation = 0;
+	}
+	UNLOCK(lock);
+
+	return (result);
+}
+
+void
+dns_coldcache_flush(dns_coldcache_t *cache) {
+	REQUIRE(VALID_COLDCACHE(cache));
+
+	/*
+	 * Take every lock so that nothing is stored with the old
+	 * generation once this returns.  Generation zero marks empty
+	 * slots and is skipped when the counter wraps.
+	 */
+	for (size_t i = 0; i < COLDCACHE_NLOCKS; i++) {
+		LOCK(&cache->locks[i]);
+	}
+	if (atomic_fetch_add_relaxed(&cache->generation, 1) == UINT32_MAX) {
+		atomic_store_relaxed(&cache->generation, 1);
+	}
+	for (size_t i = 0; i < COLDCACHE_NLOCKS; i++) {
+		UNLOCK(&cache->locks[i]);
+	}
+}
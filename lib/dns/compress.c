@@ -19,77 +19,183 @@
 #include <stdbool.h>
 
 #include <isc/ascii.h>
+#include <isc/buffer.h>
+#include <isc/hash.h>
 #include <isc/mem.h>
 #include <isc/result.h>
 #include <isc/string.h>
 #include <isc/util.h>
 
 #include <dns/compress.h>
-#include <dns/fixedname.h>
-#include <dns/rbt.h>
 
 #define CCTX_MAGIC    ISC_MAGIC('C', 'C', 'T', 'X')
 #define VALID_CCTX(x) ISC_MAGIC_VALID(x, CCTX_MAGIC)
 
 /*
- * The tableindex array below is of size 256, one entry for each
- * unsigned char value. The tableindex array elements are dependent on
- * DNS_COMPRESS_TABLESIZE. The table was created using the following
- * function.
+ * The compression table maps each suffix already in the message to its
+ * offset.  A suffix is identified by its first label and the offset of
+ * the rest of it, so a name is looked up one label at a time, starting
+ * from the root, and each step is a single probe sequence in the table.
+ * Candidates are checked against the message itself, so the table does
+ * not keep copies of the names.
  *
- * static void
- * gentable(unsigned char *table) {
- *         unsigned int i;
- *         const unsigned int left = DNS_COMPRESS_TABLESIZE - 38;
- *         long r;
- *
- *         for (i = 0; i < 26; i++) {
- *                 table['A' + i] = i;
- *                 table['a' + i] = i;
- *         }
- *
- *         for (i = 0; i <= 9; i++)
- *                 table['0' + i] = i + 26;
- *
- *         table['-'] = 36;
- *         table['_'] = 37;
- *
- *         for (i = 0; i < 256; i++) {
- *                 if ((i >= 'a' && i <= 'z') ||
- *                     (i >= 'A' && i <= 'Z') ||
- *                     (i >= '0' && i <= '9') ||
- *                     (i == '-') ||
- *                     (i == '_'))
- *                         continue;
- *                 r = random() % left;
- *                 table[i] = 38 + r;
- *         }
- * }
+ * The table uses linear probing and is kept at most 3/4 full.  It starts
+ * in the context itself and only moves to a larger allocated table for
+ * messages with many names.  Offsets that do not fit in a compression
+ * pointer are never added, which bounds the size of the table.
+ */
+#define EMPTY_SLOT(cctx, i) ((cctx)->table[i].coff == DNS_COMPRESS_NOOFFSET)
+
+static uint16_t
+hash_label(uint16_t parent, const unsigned char *label) {
+	unsigned char key[2 + 1 + 63];
+	unsigned int len = label[0] + 1;
+
+	/* no bitstring support */
+	INSIST(len <= 64);
+
+	key[0] = parent >> 8;
+	key[1] = parent & 0xff;
+	memmove(key + 2, label, len);
+	return ((uint16_t)isc_hash32(key, len + 2, false));
+}
+
+static void
+set_offsets(const dns_name_t *name, unsigned char *offsets) {
+	unsigned int n = dns_name_countlabels(name);
+	unsigned int offset = 0;
+
+	for (unsigned int i = 0; i < n; i++) {
+		offsets[i] = offset;
+		offset += name->ndata[offset] + 1;
+	}
+}
+
+/*
+ * Does the suffix at 'coff' in the message consist of 'label' followed
+ * by the suffix at 'parent'?
+ */
+static bool
+match_label(dns_compress_t *cctx, const isc_buffer_t *buffer, uint16_t coff,
+	    const unsigned char *label, uint16_t parent) {
+	const unsigned char *msg = isc_buffer_base(buffer);
+	unsigned int len = label[0];
+	unsigned int next = coff + 1 + len;
+
+	if (next >= buffer->used || msg[coff] != len) {
+		return (false);
+	}
+	if (cctx->sensitive) {
+		if (memcmp(msg + coff + 1, label + 1, len) != 0) {
+			return (false);
+		}
+	} else if (!isc_ascii_lowerequal(msg + coff + 1, label + 1, len)) {
+		return (false);
+	}
+
+	if (parent == DNS_COMPRESS_NOOFFSET) {
+		return (msg[next] == 0);
+	}
+	if (next == parent) {
+		return (true);
+	}
+	return ((msg[next] & 0xc0) == 0xc0 && next + 1 < buffer->used &&
+		(((msg[next] & 0x3f) << 8) | msg[next + 1]) == parent);
+}
+
+static uint16_t
+find_label(dns_compress_t *cctx, const isc_buffer_t *buffer,
+	   const unsigned char *label, uint16_t parent) {
+	uint16_t hash = hash_label(parent, label);
+
+	for (unsigned int i = hash & cctx->mask; !EMPTY_SLOT(cctx, i);
+	     i = (i + 1) & cctx->mask)
+	{
+		if (cctx->table[i].hash == hash &&
+		    match_label(cctx, buffer, cctx->table[i].coff, label,
+				parent))
+		{
+			return (cctx->table[i].coff);
+		}
+	}
+	return (DNS_COMPRESS_NOOFFSET);
+}
+
+static void
+insert_slot(dns_compress_t *cctx, uint16_t hash, uint16_t coff) {
+	unsigned int i;
+
+	for (i = hash & cctx->mask; !EMPTY_SLOT(cctx, i);
+	     i = (i + 1) & cctx->mask)
+	{
+		/* empty */
+	}
+	cctx->table[i].hash = hash;
+	cctx->table[i].coff = coff;
+	cctx->count++;
+}
+
+static void
+clear_table(dns_compress_slot_t *table, unsigned int size) {
+	for (unsigned int i = 0; i < size; i++) {
+		table[i].coff = DNS_COMPRESS_NOOFFSET;
+	}
+}
+
+/*
+ * Double the size of the table, unless it is as large as it can be.
  */
-static unsigned char tableindex[256] = {
-	0x3e, 0x3e, 0x33, 0x2d, 0x30, 0x38, 0x31, 0x3c, 0x2b, 0x33, 0x30, 0x3f,
-	0x2d, 0x3c, 0x36, 0x3a, 0x28, 0x2c, 0x2a, 0x37, 0x3d, 0x34, 0x35, 0x2d,
-	0x39, 0x2b, 0x2f, 0x2c, 0x3b, 0x32, 0x2b, 0x39, 0x30, 0x38, 0x28, 0x3c,
-	0x32, 0x33, 0x39, 0x38, 0x27, 0x2b, 0x39, 0x30, 0x27, 0x24, 0x2f, 0x2b,
-	0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x3a, 0x29, 0x36,
-	0x31, 0x3c, 0x35, 0x26, 0x31, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
-	0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12,
-	0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x3e, 0x3b, 0x39, 0x2f, 0x25,
-	0x27, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a,
-	0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
-	0x17, 0x18, 0x19, 0x36, 0x3b, 0x2f, 0x2f, 0x2e, 0x29, 0x33, 0x2a, 0x36,
-	0x28, 0x3f, 0x2e, 0x29, 0x2c, 0x29, 0x36, 0x2d, 0x32, 0x3d, 0x33, 0x2a,
-	0x2e, 0x2f, 0x3b, 0x30, 0x3d, 0x39, 0x2b, 0x36, 0x2a, 0x2f, 0x2c, 0x26,
-	0x3a, 0x37, 0x30, 0x3d, 0x2a, 0x36, 0x33, 0x2c, 0x38, 0x3d, 0x32, 0x3e,
-	0x26, 0x2a, 0x2c, 0x35, 0x27, 0x39, 0x3b, 0x31, 0x2a, 0x37, 0x3c, 0x27,
-	0x32, 0x29, 0x39, 0x37, 0x34, 0x3f, 0x39, 0x2e, 0x38, 0x2b, 0x2c, 0x3e,
-	0x3b, 0x3b, 0x2d, 0x33, 0x3b, 0x3b, 0x32, 0x3d, 0x3f, 0x3a, 0x34, 0x26,
-	0x35, 0x30, 0x31, 0x39, 0x27, 0x2f, 0x3d, 0x35, 0x35, 0x36, 0x2e, 0x29,
-	0x38, 0x27, 0x34, 0x32, 0x2c, 0x3c, 0x31, 0x28, 0x37, 0x38, 0x37, 0x34,
-	0x33, 0x29, 0x32, 0x34, 0x3f, 0x26, 0x34, 0x34, 0x32, 0x27, 0x30, 0x33,
-	0x33, 0x2d, 0x2b, 0x28, 0x3f, 0x33, 0x2b, 0x39, 0x37, 0x39, 0x2c, 0x3d,
-	0x35, 0x39, 0x27, 0x2f
-};
+static bool
+grow_table(dns_compress_t *cctx) {
+	dns_compress_slot_t *old = cctx->table;
+	unsigned int oldsize = cctx->mask + 1;
+	unsigned int size = oldsize * 2;
+
+	if (size > DNS_COMPRESS_MAXSIZE) {
+		return (false);
+	}
+
+	cctx->table = isc_mem_get(cctx->mctx, size * sizeof(cctx->table[0]));
+	clear_table(cctx->table, size);
+	cctx->mask = size - 1;
+	cctx->count = 0;
+	for (unsigned int i = 0; i < oldsize; i++) {
+		if (old[i].coff != DNS_COMPRESS_NOOFFSET) {
+			insert_slot(cctx, old[i].hash, old[i].coff);
+		}
+	}
+
+	if (old != cctx->initialtable) {
+		isc_mem_put(cctx->mctx, old, oldsize * sizeof(old[0]));
+	}
+	return (true);
+}
+
+/*
+ * Remove the entry in slot 'i', moving later entries of the same probe
+ * sequence back so that they can still be found.
+ */
+static void
+delete_slot(dns_compress_t *cctx, unsigned int i) {
+	unsigned int j = i;
+
+	for (;;) {
+		unsigned int k;
+
+		j = (j + 1) & cctx->mask;
+		if (EMPTY_SLOT(cctx, j)) {
+			break;
+		}
+		k = cctx->table[j].hash & cctx->mask;
+		if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j)) {
+			continue;
+		}
+		cctx->table[i] = cctx->table[j];
+		i = j;
+	}
+	cctx->table[i].coff = DNS_COMPRESS_NOOFFSET;
+	cctx->count--;
+}
 
 /***
  ***	Compression
@@ -108,9 +214,10 @@ dns_compress_init(dns_compress_t *cctx, isc_mem_t *mctx) {
 	cctx->permitted = true;
 	cctx->disabled = false;
 	cctx->sensitive = false;
-	cctx->arena_off = 0;
+	cctx->table = cctx->initialtable;
+	cctx->mask = DNS_COMPRESS_INITIALSIZE - 1;
 
-	memset(&cctx->table[0], 0, sizeof(cctx->table));
+	clear_table(cctx->table, DNS_COMPRESS_INITIALSIZE);
 
 	cctx->magic = CCTX_MAGIC;
 
@@ -119,25 +226,15 @@ dns_compress_init(dns_compress_t *cctx, isc_mem_t *mctx) {
 
 void
 dns_compress_invalidate(dns_compress_t *cctx) {
-	dns_compressnode_t *node;
-	unsigned int i;
-
 	REQUIRE(VALID_CCTX(cctx));
 
-	for (i = 0; i < DNS_COMPRESS_TABLESIZE; i++) {
-		while (cctx->table[i] != NULL) {
-			node = cctx->table[i];
-			cctx->table[i] = cctx->table[i]->next;
-			if ((node->offset & 0x8000) != 0) {
-				isc_mem_put(cctx->mctx, node->r.base,
-					    node->r.length);
-			}
-			if (node->count < DNS_COMPRESS_INITIALNODES) {
-				continue;
-			}
-			isc_mem_put(cctx->mctx, node, sizeof(*node));
-		}
+	if (cctx->table != cctx->initialtable) {
+		isc_mem_put(cctx->mctx, cctx->table,
+			    (cctx->mask + 1) * sizeof(cctx->table[0]));
+		cctx->table = cctx->initialtable;
+		cctx->mask = DNS_COMPRESS_INITIALSIZE - 1;
 	}
+	cctx->count = 0;
 
 	cctx->magic = 0;
 	cctx->permitted = false;
@@ -176,20 +273,20 @@ dns_compress_getsensitive(dns_compress_t *cctx) {
 }
 
 /*
- * Find the longest match of name in the table.
- * If match is found return true. prefix, suffix and offset are updated.
+ * Find the longest suffix of name in the message.
+ * If match is found return true. prefix and offset are updated.
  * If no match is found return false.
  */
 bool
-dns_compress_find(dns_compress_t *cctx, const dns_name_t *name,
-		  dns_name_t *prefix, uint16_t *offset) {
-	dns_name_t tname;
-	dns_compressnode_t *node = NULL;
-	unsigned int labels, i, n;
-	unsigned int numlabels;
-	unsigned char *p;
+dns_compress_find(dns_compress_t *cctx, const isc_buffer_t *buffer,
+		  const dns_name_t *name, dns_name_t *prefix,
+		  uint16_t *offset) {
+	dns_offsets_t offsets;
+	unsigned int labels, n;
+	uint16_t parent = DNS_COMPRESS_NOOFFSET;
 
 	REQUIRE(VALID_CCTX(cctx));
+	REQUIRE(ISC_BUFFER_VALID(buffer));
 	REQUIRE(dns_name_isabsolute(name));
 	REQUIRE(offset != NULL);
 
@@ -203,88 +300,24 @@ dns_compress_find(dns_compress_t *cctx, const dns_name_t *name,
 
 	labels = dns_name_countlabels(name);
 	INSIST(labels > 0);
+	set_offsets(name, offsets);
 
-	dns_name_init(&tname, NULL);
-
-	numlabels = labels > 3U ? 3U : labels;
-	p = name->ndata;
-
-	for (n = 0; n < numlabels - 1; n++) {
-		unsigned char ch, llen;
-		unsigned int firstoffset, length;
-
-		firstoffset = (unsigned int)(p - name->ndata);
-		length = name->length - firstoffset;
-
-		/*
-		 * We calculate the table index using the first
-		 * character in the first label of the suffix name.
-		 */
-		ch = p[1];
-		i = tableindex[ch];
-		if (cctx->sensitive) {
-			for (node = cctx->table[i]; node != NULL;
-			     node = node->next) {
-				if (node->name.length != length) {
-					continue;
-				}
-
-				if (memcmp(node->name.ndata, p, length) == 0) {
-					goto found;
-				}
-			}
-		} else {
-			for (node = cctx->table[i]; node != NULL;
-			     node = node->next) {
-				unsigned int l, count;
-				unsigned char *p1, *p2;
-
-				if (node->name.length != length) {
-					continue;
-				}
-
-				l = labels - n;
-				if (node->name.labels != l) {
-					continue;
-				}
-
-				p1 = node->name.ndata;
-				p2 = p;
-				while (l-- > 0) {
-					count = *p1++;
-					if (count != *p2++) {
-						goto cont1;
-					}
-
-					/* no bitstring support */
-					INSIST(count <= 63);
-
-					if (!isc_ascii_lowerequal(p1, p2,
-								  count)) {
-						goto cont1;
-					}
-					p1 += count;
-					p2 += count;
-				}
-				break;
-			cont1:
-				continue;
-			}
-		}
-
-		if (node != NULL) {
+	/*
+	 * Extend the match one label at a time, skipping the root label.
+	 */
+	for (n = labels - 1; n > 0; n--) {
+		uint16_t coff = find_label(cctx, buffer,
+					   name->ndata + offsets[n - 1], parent);
+		if (coff == DNS_COMPRESS_NOOFFSET) {
 			break;
 		}
-
-		llen = *p;
-		p += llen + 1;
+		parent = coff;
 	}
 
-found:
 	/*
-	 * If node == NULL, we found no match at all.
+	 * If parent is still unset, we found no match at all.
 	 */
-	if (node == NULL) {
+	if (parent == DNS_COMPRESS_NOOFFSET) {
 		return (false);
 	}
 
@@ -294,32 +327,16 @@ found:
 		dns_name_getlabelsequence(name, 0, n, prefix);
 	}
 
-	*offset = (node->offset & 0x7fff);
+	*offset = parent;
 	return (true);
 }
 
-static unsigned int
-name_length(const dns_name_t *name) {
-	isc_region_t r;
-	dns_name_toregion(name, &r);
-	return (r.length);
-}
-
 void
 dns_compress_add(dns_compress_t *cctx, const dns_name_t *name,
-		 const dns_name_t *prefix, uint16_t offset) {
-	dns_name_t tname, xname;
-	unsigned int start;
-	unsigned int n;
+		 const dns_name_t *prefix, uint16_t offset, uint16_t suffix) {
+	dns_offsets_t offsets;
 	unsigned int count;
-	unsigned int i;
-	dns_compressnode_t *node;
-	unsigned int length;
-	unsigned int tlength;
-	uint16_t toffset;
-	unsigned char *tmp;
-	isc_region_t r;
-	bool allocated = false;
+	uint16_t parent = suffix;
 
 	REQUIRE(VALID_CCTX(cctx));
 	REQUIRE(dns_name_isabsolute(name));
@@ -328,13 +345,6 @@ dns_compress_add(dns_compress_t *cctx, const dns_name_t *name,
 		return;
 	}
 
-	if (offset >= 0x4000) {
-		return;
-	}
-	dns_name_init(&tname, NULL);
-	dns_name_init(&xname, NULL);
-
-	n = dns_name_countlabels(name);
 	count = dns_name_countlabels(prefix);
 	if (dns_name_isabsolute(prefix)) {
 		count--;
@@ -342,112 +352,56 @@ dns_compress_add(dns_compress_t *cctx, const dns_name_t *name,
 	if (count == 0) {
 		return;
 	}
-	start = 0;
-	dns_name_toregion(name, &r);
-	length = r.length;
-	if (cctx->arena_off + length < DNS_COMPRESS_ARENA_SIZE) {
-		tmp = &cctx->arena[cctx->arena_off];
-		cctx->arena_off += length;
-	} else {
-		allocated = true;
-		tmp = isc_mem_get(cctx->mctx, length);
-	}
-	/*
-	 * Copy name data to 'tmp' and make 'r' use 'tmp'.
-	 */
-	memmove(tmp, r.base, r.length);
-	r.base = tmp;
-	dns_name_fromregion(&xname, &r);
 
-	if (count > 2U) {
-		count = 2U;
-	}
+	set_offsets(name, offsets);
 
-	while (count > 0) {
-		unsigned char ch;
-
-		dns_name_getlabelsequence(&xname, start, n, &tname);
-		/*
-		 * We calculate the table index using the first
-		 * character in the first label of tname.
-		 */
-		ch = tname.ndata[1];
-		i = tableindex[ch];
-		tlength = name_length(&tname);
-		toffset = (uint16_t)(offset + (length - tlength));
-		if (toffset >= 0x4000) {
-			break;
-		}
-		/*
-		 * Create a new node and add it.
-		 */
-		if (cctx->count < DNS_COMPRESS_INITIALNODES) {
-			node = &cctx->initialnodes[cctx->count];
-		} else {
-			node = isc_mem_get(cctx->mctx,
-					   sizeof(dns_compressnode_t));
-		}
-		node->count = cctx->count++;
-		/*
-		 * 'node->r.base' becomes 'tmp' when start == 0.
-		 * Record this by setting 0x8000 so it can be freed later.
-		 */
-		if (start == 0 && allocated) {
-			toffset |= 0x8000;
-		}
-		node->offset = toffset;
-		dns_name_toregion(&tname, &node->r);
-		dns_name_init(&node->name, NULL);
-		node->name.length = node->r.length;
-		node->name.ndata = node->r.base;
-		node->name.labels = tname.labels;
-		node->name.attributes = DNS_NAMEATTR_ABSOLUTE;
-		node->next = cctx->table[i];
-		cctx->table[i] = node;
-		start++;
-		n--;
-		count--;
+	/*
+	 * Add the suffixes from the shortest one, which has the highest
+	 * offset; if it cannot be pointed to, neither can the longer
+	 * suffixes be found.
+	 */
+	if (offset + offsets[count - 1] >= 0x4000) {
+		return;
 	}
-
-	if (start == 0) {
-		if (!allocated) {
-			cctx->arena_off -= length;
-		} else {
-			isc_mem_put(cctx->mctx, tmp, length);
+	while (count-- > 0) {
+		const unsigned char *label = name->ndata + offsets[count];
+		uint16_t coff = offset + offsets[count];
+
+		if (cctx->count + 1 > (cctx->mask + 1) / 4 * 3 &&
+		    !grow_table(cctx))
+		{
+			return;
 		}
+		insert_slot(cctx, hash_label(parent, label), coff);
+		parent = coff;
 	}
 }
 
 void
 dns_compress_rollback(dns_compress_t *cctx, uint16_t offset) {
 	unsigned int i;
-	dns_compressnode_t *node;
 
 	REQUIRE(VALID_CCTX(cctx));
 
-	if (cctx->disabled) {
+	if (cctx->disabled || cctx->count == 0) {
 		return;
 	}
 
-	for (i = 0; i < DNS_COMPRESS_TABLESIZE; i++) {
-		node = cctx->table[i];
-		/*
-		 * This relies on nodes with greater offsets being
-		 * closer to the beginning of the list, and the
-		 * items with the greatest offsets being at the end
-		 * of the initialnodes[] array.
-		 */
-		while (node != NULL && (node->offset & 0x7fff) >= offset) {
-			cctx->table[i] = node->next;
-			if ((node->offset & 0x8000) != 0) {
-				isc_mem_put(cctx->mctx, node->r.base,
-					    node->r.length);
-			}
-			if (node->count >= DNS_COMPRESS_INITIALNODES) {
-				isc_mem_put(cctx->mctx, node, sizeof(*node));
-			}
-			cctx->count--;
-			node = cctx->table[i];
+	if (offset == 0) {
+		clear_table(cctx->table, cctx->mask + 1);
+		cctx->count = 0;
+		return;
+	}
+
+	/*
+	 * A slot is examined again after a deletion, as another entry
+	 * may have been moved into it.
+	 */
+	for (i = 0; i <= cctx->mask;) {
+		if (!EMPTY_SLOT(cctx, i) && cctx->table[i].coff >= offset) {
+			delete_slot(cctx, i);
+		} else {
+			i++;
 		}
 	}
 }
@@ -34,6 +34,7 @@
 #include <dns/dbiterator.h>
 #include <dns/log.h>
 #include <dns/master.h>
+#include <dns/nsec3.h>
 #include <dns/rdata.h>
 #include <dns/rdataset.h>
 #include <dns/rdatasetiter.h>
@@ -58,6 +59,7 @@ struct dns_dbimplementation {
  * Built in database implementations are registered here.
  */
 
+#include "qpdb.h"
 #include "rbtdb.h"
 
 unsigned int dns_pps = 0U;
@@ -67,6 +69,7 @@ static isc_rwlock_t implock;
 static isc_once_t once = ISC_ONCE_INIT;
 
 static dns_dbimplementation_t rbtimp;
+static dns_dbimplementation_t qpimp;
 
 static void
 initialize(void) {
@@ -78,8 +81,15 @@ initialize(void) {
 	rbtimp.driverarg = NULL;
 	ISC_LINK_INIT(&rbtimp, link);
 
+	qpimp.name = "qp";
+	qpimp.create = dns_qpdb_create;
+	qpimp.mctx = NULL;
+	qpimp.driverarg = NULL;
+	ISC_LINK_INIT(&qpimp, link);
+
 	ISC_LIST_INIT(implementations);
 	ISC_LIST_APPEND(implementations, &rbtimp, link);
+	ISC_LIST_APPEND(implementations, &qpimp, link);
 }
 
 static dns_dbimplementation_t *
@@ -1106,3 +1116,81 @@ dns_db_setgluecachestats(dns_db_t *db, isc_stats_t *stats) {
 
 	return (ISC_R_NOTIMPLEMENTED);
 }
+
+isc_result_t
+dns_db_setevictionpolicy(dns_db_t *db, dns_evictionpolicy_t policy) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE((db->attributes & DNS_DBATTR_CACHE) != 0);
+
+	if (db->methods->setevictionpolicy != NULL) {
+		return ((db->methods->setevictionpolicy)(db, policy));
+	}
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+isc_result_t
+dns_db_getmemory(dns_db_t *db, dns_dbmemory_t *memory) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE(memory != NULL);
+
+	if (db->methods->getmemory != NULL) {
+		return ((db->methods->getmemory)(db, memory));
+	}
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+isc_result_t
+dns_db_expire(dns_db_t *db, isc_stdtime_t now, bool overmem,
+	      unsigned int budget, unsigned int *removedp) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE((db->attributes & DNS_DBATTR_CACHE) != 0);
+	REQUIRE(removedp != NULL);
+
+	if (db->methods->expire != NULL) {
+		*removedp = (db->methods->expire)(db, now, overmem, budget);
+		return (ISC_R_SUCCESS);
+	}
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+isc_result_t
+dns_db_setcoldtier(dns_db_t *db, dns_coldcache_t *coldtier) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE((db->attributes & DNS_DBATTR_CACHE) != 0);
+	REQUIRE(coldtier != NULL);
+
+	if (db->methods->setcoldtier != NULL) {
+		return ((db->methods->setcoldtier)(db, coldtier));
+	}
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+isc_result_t
+dns_db_flushtree(dns_db_t *db, const dns_name_t *name) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE((db->attributes & DNS_DBATTR_CACHE) != 0);
+	REQUIRE(dns_name_isabsolute(name));
+
+	if (db->methods->flushtree != NULL) {
+		return ((db->methods->flushtree)(db, name));
+	}
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+isc_result_t
+dns_db_nsec3hashname(dns_db_t *db, dns_fixedname_t *result,
+		     const dns_name_t *name, dns_hash_t hashalg,
+		     unsigned int iterations, const unsigned char *salt,
+		     size_t saltlength) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE(dns_db_iszone(db));
+	REQUIRE(result != NULL);
+
+	if (db->methods->nsec3hashname != NULL) {
+		return ((db->methods->nsec3hashname)(db, result, name, hashalg,
+						     iterations, salt,
+						     saltlength));
+	}
+	return (dns_nsec3_hashname(result, NULL, NULL, name, &db->origin,
+				   hashalg, iterations, salt, saltlength));
+}
@@ -17,6 +17,7 @@
 
 #include <isc/util.h>
 
+#include <dns/db.h>
 #include <dns/dbiterator.h>
 #include <dns/name.h>
 
@@ -127,6 +128,72 @@ dns_dbiterator_origin(dns_dbiterator_t *iterator, dns_name_t *name) {
 	return (iterator->methods->origin(iterator, name));
 }
 
+isc_result_t
+dns_dbiterator_currentbatch(dns_dbiterator_t *iterator,
+			    dns_dbiteratorbatch_t *batch) {
+	isc_result_t result, tresult;
+
+	/*
+	 * Return the current node and the nodes following it.
+	 */
+
+	REQUIRE(DNS_DBITERATOR_VALID(iterator));
+	REQUIRE(batch != NULL);
+
+	if (iterator->methods->currentbatch != NULL) {
+		return (iterator->methods->currentbatch(iterator, batch));
+	}
+
+	batch->count = 0;
+	do {
+		unsigned int i = batch->count;
+		dns_name_t *name = dns_fixedname_initname(&batch->names[i]);
+
+		batch->nodes[i] = NULL;
+		batch->neworigin[i] = false;
+		result = iterator->methods->current(iterator, &batch->nodes[i],
+						    name);
+		if (result != ISC_R_SUCCESS && result != DNS_R_NEWORIGIN) {
+			break;
+		}
+		batch->count++;
+		if (result == DNS_R_NEWORIGIN) {
+			batch->neworigin[i] = true;
+			result = iterator->methods->origin(
+				iterator,
+				dns_fixedname_initname(&batch->origins[i]));
+			if (result != ISC_R_SUCCESS) {
+				break;
+			}
+		}
+		result = iterator->methods->next(iterator);
+	} while (result == ISC_R_SUCCESS &&
+		 batch->count < DNS_DBITERATOR_BATCHSIZE);
+
+	tresult = iterator->methods->pause(iterator);
+	if (tresult != ISC_R_SUCCESS &&
+	    (result == ISC_R_SUCCESS || result == ISC_R_NOMORE))
+	{
+		result = tresult;
+	}
+
+	return (result);
+}
+
+void
+dns_dbiterator_releasebatch(dns_dbiterator_t *iterator,
+			    dns_dbiteratorbatch_t *batch) {
+	REQUIRE(DNS_DBITERATOR_VALID(iterator));
+	REQUIRE(batch != NULL);
+
+	for (unsigned int i = 0; i < batch->count; i++) {
+		if (batch->nodes[i] != NULL) {
+			dns_db_detachnode(iterator->db, &batch->nodes[i]);
+		}
+	}
+	batch->count = 0;
+}
+
 void
 dns_dbiterator_setcleanmode(dns_dbiterator_t *iterator, bool mode) {
 	REQUIRE(DNS_DBITERATOR_VALID(iterator));
@@ -19,6 +19,7 @@
 
 #include <isc/buffer.h>
 #include <isc/file.h>
+#include <isc/ht.h>
 #include <isc/mem.h>
 #include <isc/print.h>
 #include <isc/result.h>
@@ -27,6 +28,7 @@
 
 #include <dns/db.h>
 #include <dns/diff.h>
+#include <dns/fixedname.h>
 #include <dns/log.h>
 #include <dns/rdataclass.h>
 #include <dns/rdatalist.h>
@@ -242,216 +244,334 @@ setownercase(dns_rdataset_t *rdataset, const dns_name_t *name) {
 	}
 }
 
+/*
+ * Subtract the rdata of 'rdl' from, or merge them into, the 'name' RRset
+ * of 'db', as 'op' says.
+ */
 static isc_result_t
-diff_apply(dns_diff_t *diff, dns_db_t *db, dns_dbversion_t *ver, bool warn) {
-	dns_difftuple_t *t;
+diff_applyrrset(dns_db_t *db, dns_dbversion_t *ver, dns_name_t *name,
+		dns_diffop_t op, dns_rdatalist_t *rdl, bool warn) {
 	dns_dbnode_t *node = NULL;
+	dns_rdataset_t rds;
+	dns_rdataset_t ardataset;
+	unsigned int options;
 	isc_result_t result;
 	char namebuf[DNS_NAME_FORMATSIZE];
-	char typebuf[DNS_RDATATYPE_FORMATSIZE];
 	char classbuf[DNS_RDATACLASS_FORMATSIZE];
 
-	REQUIRE(DNS_DIFF_VALID(diff));
-	REQUIRE(DNS_DB_VALID(db));
+	/*
+	 * Find the node.
+	 * We create the node if it does not exist.
+	 * This will cause an empty node to be created if the diff
+	 * contains a deletion of an RR at a nonexistent name,
+	 * but such diffs should never be created in the first
+	 * place.
+	 */
+	if (rdl->type != dns_rdatatype_nsec3 &&
+	    rdl->covers != dns_rdatatype_nsec3)
+	{
+		CHECK(dns_db_findnode(db, name, true, &node));
+	} else {
+		CHECK(dns_db_findnsec3node(db, name, true, &node));
+	}
 
-	t = ISC_LIST_HEAD(diff->tuples);
-	while (t != NULL) {
-		dns_name_t *name;
+	/*
+	 * Convert the rdatalist into a rdataset.
+	 */
+	dns_rdataset_init(&rds);
+	dns_rdataset_init(&ardataset);
+	dns_rdatalist_tordataset(rdl, &rds);
+	rds.trust = dns_trust_ultimate;
 
-		INSIST(node == NULL);
-		name = &t->name;
+	/*
+	 * Merge the rdataset into the database.
+	 */
+	switch (op) {
+	case DNS_DIFFOP_ADD:
+	case DNS_DIFFOP_ADDRESIGN:
+		options = DNS_DBADD_MERGE | DNS_DBADD_EXACT |
+			  DNS_DBADD_EXACTTTL;
+		result = dns_db_addrdataset(db, node, ver, 0, &rds, options,
+					    &ardataset);
+		break;
+	case DNS_DIFFOP_DEL:
+	case DNS_DIFFOP_DELRESIGN:
+		options = DNS_DBSUB_EXACT | DNS_DBSUB_WANTOLD;
+		result = dns_db_subtractrdataset(db, node, ver, &rds, options,
+						 &ardataset);
+		break;
+	default:
+		UNREACHABLE();
+	}
+
+	if (result == ISC_R_SUCCESS) {
+		if (rds.type == dns_rdatatype_rrsig &&
+		    (op == DNS_DIFFOP_DELRESIGN || op == DNS_DIFFOP_ADDRESIGN))
+		{
+			isc_stdtime_t resign;
+			resign = setresign(&ardataset);
+			dns_db_setsigningtime(db, &ardataset, resign);
+		}
+		if (op == DNS_DIFFOP_ADD || op == DNS_DIFFOP_ADDRESIGN) {
+			setownercase(&ardataset, name);
+		}
+		if (op == DNS_DIFFOP_DEL || op == DNS_DIFFOP_DELRESIGN) {
+			getownercase(&ardataset, name);
+		}
+	} else if (result == DNS_R_UNCHANGED) {
+		/*
+		 * This will not happen when executing a
+		 * dynamic update, because that code will
+		 * generate strictly minimal diffs.
+		 * It may happen when receiving an IXFR
+		 * from a server that is not as careful.
+		 * Issue a warning and continue.
+		 */
+		if (warn) {
+			dns_name_format(dns_db_origin(db), namebuf,
+					sizeof(namebuf));
+			dns_rdataclass_format(dns_db_class(db), classbuf,
+					      sizeof(classbuf));
+			isc_log_write(DIFF_COMMON_LOGARGS, ISC_LOG_WARNING,
+				      "%s/%s: dns_diff_apply: "
+				      "update with no effect",
+				      namebuf, classbuf);
+		}
+		if (op == DNS_DIFFOP_ADD || op == DNS_DIFFOP_ADDRESIGN) {
+			setownercase(&ardataset, name);
+		}
+		if (op == DNS_DIFFOP_DEL || op == DNS_DIFFOP_DELRESIGN) {
+			getownercase(&ardataset, name);
+		}
+	} else if (result == DNS_R_NXRRSET) {
 		/*
-		 * Find the node.
-		 * We create the node if it does not exist.
-		 * This will cause an empty node to be created if the diff
-		 * contains a deletion of an RR at a nonexistent name,
-		 * but such diffs should never be created in the first
-		 * place.
+		 * OK.
 		 */
+		if (op == DNS_DIFFOP_DEL || op == DNS_DIFFOP_DELRESIGN) {
+			getownercase(&ardataset, name);
+		}
+	}
+	if (dns_rdataset_isassociated(&ardataset)) {
+		dns_rdataset_disassociate(&ardataset);
+	}
+	if (result == DNS_R_UNCHANGED || result == DNS_R_NXRRSET) {
+		result = ISC_R_SUCCESS;
+	}
 
-		while (t != NULL && dns_name_equal(&t->name, name)) {
-			dns_rdatatype_t type, covers;
-			dns_diffop_t op;
-			dns_rdatalist_t rdl;
-			dns_rdataset_t rds;
-			dns_rdataset_t ardataset;
-			unsigned int options;
+failure:
+	if (node != NULL) {
+		dns_db_detachnode(db, &node);
+	}
+	return (result);
+}
 
-			op = t->op;
-			type = t->rdata.type;
-			covers = rdata_covers(&t->rdata);
+/*
+ * Add the rdata of tuple 't' to 'rdl', which holds the rdata of the
+ * tuples for the same RRset found before it.
+ */
+static void
+diff_appendrdata(dns_rdatalist_t *rdl, dns_difftuple_t *t, bool warn) {
+	char namebuf[DNS_NAME_FORMATSIZE];
+	char typebuf[DNS_RDATATYPE_FORMATSIZE];
+	char classbuf[DNS_RDATACLASS_FORMATSIZE];
 
-			/*
-			 * Collect a contiguous set of updates with
-			 * the same operation (add/delete) and RR type
-			 * into a single rdatalist so that the
-			 * database rrset merging/subtraction code
-			 * can work more efficiently than if each
-			 * RR were merged into / subtracted from
-			 * the database separately.
-			 *
-			 * This is done by linking rdata structures from the
-			 * diff into "rdatalist".  This uses the rdata link
-			 * field, not the diff link field, so the structure
-			 * of the diff itself is not affected.
-			 */
+	if (t->ttl != rdl->ttl && warn) {
+		dns_name_format(&t->name, namebuf, sizeof(namebuf));
+		dns_rdatatype_format(t->rdata.type, typebuf, sizeof(typebuf));
+		dns_rdataclass_format(t->rdata.rdclass, classbuf,
+				      sizeof(classbuf));
+		isc_log_write(DIFF_COMMON_LOGARGS, ISC_LOG_WARNING,
+			      "'%s/%s/%s': TTL differs in rdataset, "
+			      "adjusting %lu -> %lu",
+			      namebuf, typebuf, classbuf,
+			      (unsigned long)t->ttl, (unsigned long)rdl->ttl);
+	}
+	ISC_LIST_APPEND(rdl->rdata, &t->rdata, link);
+}
 
-			dns_rdatalist_init(&rdl);
-			rdl.type = type;
-			rdl.covers = covers;
-			rdl.rdclass = t->rdata.rdclass;
-			rdl.ttl = t->ttl;
+/*
+ * An RRset changed by a diff: the rdata of all the tuples with the same
+ * operation, owner name, type and covered type, wherever they are in
+ * the diff.
+ */
+typedef struct diff_rrset {
+	dns_name_t *name;
+	dns_diffop_t op;
+	dns_rdatalist_t rdl;
+} diff_rrset_t;
 
-			node = NULL;
-			if (type != dns_rdatatype_nsec3 &&
-			    covers != dns_rdatatype_nsec3) {
-				CHECK(dns_db_findnode(db, name, true, &node));
-			} else {
-				CHECK(dns_db_findnsec3node(db, name, true,
-							   &node));
+/*
+ * Return true if every deletion in 'diff' comes before every addition,
+ * as in an IXFR or journal transaction, and count its tuples.
+ */
+static bool
+diff_delsfirst(dns_diff_t *diff, unsigned int *countp) {
+	bool adding = false;
+	unsigned int count = 0;
+
+	for (dns_difftuple_t *t = ISC_LIST_HEAD(diff->tuples); t != NULL;
+	     t = ISC_LIST_NEXT(t, link))
+	{
+		switch (t->op) {
+		case DNS_DIFFOP_ADD:
+		case DNS_DIFFOP_ADDRESIGN:
+			adding = true;
+			break;
+		case DNS_DIFFOP_DEL:
+		case DNS_DIFFOP_DELRESIGN:
+			if (adding) {
+				return (false);
 			}
+			break;
+		default:
+			return (false);
+		}
+		count++;
+	}
+	*countp = count;
+	return (true);
+}
 
-			while (t != NULL && dns_name_equal(&t->name, name) &&
-			       t->op == op && t->rdata.type == type &&
-			       rdata_covers(&t->rdata) == covers)
-			{
-				/*
-				 * Remember the add name for
-				 * dns_rdataset_setownercase.
-				 */
-				name = &t->name;
-				if (t->ttl != rdl.ttl && warn) {
-					dns_name_format(name, namebuf,
-							sizeof(namebuf));
-					dns_rdatatype_format(t->rdata.type,
-							     typebuf,
-							     sizeof(typebuf));
-					dns_rdataclass_format(t->rdata.rdclass,
-							      classbuf,
-							      sizeof(classbuf));
-					isc_log_write(DIFF_COMMON_LOGARGS,
-						      ISC_LOG_WARNING,
-						      "'%s/%s/%s': TTL differs "
-						      "in "
-						      "rdataset, adjusting "
-						      "%lu -> %lu",
-						      namebuf, typebuf,
-						      classbuf,
-						      (unsigned long)t->ttl,
-						      (unsigned long)rdl.ttl);
-				}
-				ISC_LIST_APPEND(rdl.rdata, &t->rdata, link);
-				t = ISC_LIST_NEXT(t, link);
-			}
+/*
+ * Apply a diff whose deletions all come before its additions.
+ *
+ * The rdata of the tuples for each RRset are collected into a single
+ * rdatalist however the tuples are interleaved with those of other
+ * RRsets, so that each RRset is rewritten at most once for the deletions
+ * and once for the additions.  The RRsets are changed in the order they
+ * first appear in the diff, without sorting it.
+ *
+ * Reordering is safe because the deletions only remove RRs, and every
+ * state reached while adding is a subset of the final one.
+ */
+static isc_result_t
+diff_apply_grouped(dns_diff_t *diff, dns_db_t *db, dns_dbversion_t *ver,
+		   unsigned int count, bool warn) {
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_ht_t *ht = NULL;
+	diff_rrset_t *rrsets = NULL;
+	unsigned int nrrsets = 0;
+	unsigned char key[DNS_NAME_MAXWIRE + 5];
+	dns_fixedname_t fixed;
+	dns_name_t *lower = dns_fixedname_initname(&fixed);
+
+	rrsets = isc_mem_get(diff->mctx, count * sizeof(rrsets[0]));
+	isc_ht_init(&ht, diff->mctx, 8, ISC_HT_CASE_SENSITIVE);
+
+	for (dns_difftuple_t *t = ISC_LIST_HEAD(diff->tuples); t != NULL;
+	     t = ISC_LIST_NEXT(t, link))
+	{
+		dns_rdatatype_t covers = rdata_covers(&t->rdata);
+		diff_rrset_t *rrset = NULL;
+		isc_region_t r;
+		void *value = NULL;
 
-			/*
-			 * Convert the rdatalist into a rdataset.
-			 */
-			dns_rdataset_init(&rds);
-			dns_rdataset_init(&ardataset);
-			dns_rdatalist_tordataset(&rdl, &rds);
-			rds.trust = dns_trust_ultimate;
+		/*
+		 * The key is the operation, the types and the owner name
+		 * in lower case.
+		 */
+		(void)dns_name_downcase(&t->name, lower, NULL);
+		dns_name_toregion(lower, &r);
+		key[0] = (unsigned char)t->op;
+		key[1] = (unsigned char)(t->rdata.type >> 8);
+		key[2] = (unsigned char)t->rdata.type;
+		key[3] = (unsigned char)(covers >> 8);
+		key[4] = (unsigned char)covers;
+		memmove(key + 5, r.base, r.length);
+
+		if (isc_ht_find(ht, key, r.length + 5, &value) ==
+		    ISC_R_SUCCESS)
+		{
+			rrset = value;
+		} else {
+			rrset = &rrsets[nrrsets++];
+			rrset->op = t->op;
+			dns_rdatalist_init(&rrset->rdl);
+			rrset->rdl.type = t->rdata.type;
+			rrset->rdl.covers = covers;
+			rrset->rdl.rdclass = t->rdata.rdclass;
+			rrset->rdl.ttl = t->ttl;
+			RUNTIME_CHECK(isc_ht_add(ht, key, r.length + 5,
+						 rrset) == ISC_R_SUCCESS);
+		}
+
+		/*
+		 * Remember the last name for dns_rdataset_setownercase.
+		 */
+		rrset->name = &t->name;
+		diff_appendrdata(&rrset->rdl, t, warn);
+	}
+
+	for (unsigned int i = 0; i < nrrsets; i++) {
+		CHECK(diff_applyrrset(db, ver, rrsets[i].name, rrsets[i].op,
+				      &rrsets[i].rdl, warn));
+	}
 
+failure:
+	isc_ht_destroy(&ht);
+	isc_mem_put(diff->mctx, rrsets, count * sizeof(rrsets[0]));
+	return (result);
+}
+
+static isc_result_t
+diff_apply(dns_diff_t *diff, dns_db_t *db, dns_dbversion_t *ver, bool warn) {
+	dns_difftuple_t *t;
+	isc_result_t result;
+	unsigned int count = 0;
+
+	REQUIRE(DNS_DIFF_VALID(diff));
+	REQUIRE(DNS_DB_VALID(db));
+
+	if (diff_delsfirst(diff, &count) && count > 1) {
+		return (diff_apply_grouped(diff, db, ver, count, warn));
+	}
+
+	t = ISC_LIST_HEAD(diff->tuples);
+	while (t != NULL) {
+		dns_name_t *name = &t->name;
+		dns_diffop_t op = t->op;
+		dns_rdatatype_t type = t->rdata.type;
+		dns_rdatatype_t covers = rdata_covers(&t->rdata);
+		dns_rdatalist_t rdl;
+
+		/*
+		 * Collect a contiguous set of updates with
+		 * the same operation (add/delete) and RR type
+		 * into a single rdatalist so that the
+		 * database rrset merging/subtraction code
+		 * can work more efficiently than if each
+		 * RR were merged into / subtracted from
+		 * the database separately.
+		 *
+		 * This is done by linking rdata structures from the
+		 * diff into "rdatalist".  This uses the rdata link
+		 * field, not the diff link field, so the structure
+		 * of the diff itself is not affected.
+		 */
+		dns_rdatalist_init(&rdl);
+		rdl.type = type;
+		rdl.covers = covers;
+		rdl.rdclass = t->rdata.rdclass;
+		rdl.ttl = t->ttl;
+
+		while (t != NULL && dns_name_equal(&t->name, name) &&
+		       t->op == op && t->rdata.type == type &&
+		       rdata_covers(&t->rdata) == covers)
+		{
 			/*
-			 * Merge the rdataset into the database.
+			 * Remember the add name for
+			 * dns_rdataset_setownercase.
 			 */
-			switch (op) {
-			case DNS_DIFFOP_ADD:
-			case DNS_DIFFOP_ADDRESIGN:
-				options = DNS_DBADD_MERGE | DNS_DBADD_EXACT |
-					  DNS_DBADD_EXACTTTL;
-				result = dns_db_addrdataset(db, node, ver, 0,
-							    &rds, options,
-							    &ardataset);
-				break;
-			case DNS_DIFFOP_DEL:
-			case DNS_DIFFOP_DELRESIGN:
-				options = DNS_DBSUB_EXACT | DNS_DBSUB_WANTOLD;
-				result = dns_db_subtractrdataset(db, node, ver,
-								 &rds, options,
-								 &ardataset);
-				break;
-			default:
-				UNREACHABLE();
-			}
-
-			if (result == ISC_R_SUCCESS) {
-				if (rds.type == dns_rdatatype_rrsig &&
-				    (op == DNS_DIFFOP_DELRESIGN ||
-				     op == DNS_DIFFOP_ADDRESIGN))
-				{
-					isc_stdtime_t resign;
-					resign = setresign(&ardataset);
-					dns_db_setsigningtime(db, &ardataset,
-							      resign);
-				}
-				if (op == DNS_DIFFOP_ADD ||
-				    op == DNS_DIFFOP_ADDRESIGN) {
-					setownercase(&ardataset, name);
-				}
-				if (op == DNS_DIFFOP_DEL ||
-				    op == DNS_DIFFOP_DELRESIGN) {
-					getownercase(&ardataset, name);
-				}
-			} else if (result == DNS_R_UNCHANGED) {
-				/*
-				 * This will not happen when executing a
-				 * dynamic update, because that code will
-				 * generate strictly minimal diffs.
-				 * It may happen when receiving an IXFR
-				 * from a server that is not as careful.
-				 * Issue a warning and continue.
-				 */
-				if (warn) {
-					dns_name_format(dns_db_origin(db),
-							namebuf,
-							sizeof(namebuf));
-					dns_rdataclass_format(dns_db_class(db),
-							      classbuf,
-							      sizeof(classbuf));
-					isc_log_write(DIFF_COMMON_LOGARGS,
-						      ISC_LOG_WARNING,
-						      "%s/%s: dns_diff_apply: "
-						      "update with no effect",
-						      namebuf, classbuf);
-				}
-				if (op == DNS_DIFFOP_ADD ||
-				    op == DNS_DIFFOP_ADDRESIGN) {
-					setownercase(&ardataset, name);
-				}
-				if (op == DNS_DIFFOP_DEL ||
-				    op == DNS_DIFFOP_DELRESIGN) {
-					getownercase(&ardataset, name);
-				}
-			} else if (result == DNS_R_NXRRSET) {
-				/*
-				 * OK.
-				 */
-				if (op == DNS_DIFFOP_DEL ||
-				    op == DNS_DIFFOP_DELRESIGN) {
-					getownercase(&ardataset, name);
-				}
-				if (dns_rdataset_isassociated(&ardataset)) {
-					dns_rdataset_disassociate(&ardataset);
-				}
-			} else {
-				if (dns_rdataset_isassociated(&ardataset)) {
-					dns_rdataset_disassociate(&ardataset);
-				}
-				CHECK(result);
-			}
-			dns_db_detachnode(db, &node);
-			if (dns_rdataset_isassociated(&ardataset)) {
-				dns_rdataset_disassociate(&ardataset);
-			}
+			name = &t->name;
+			diff_appendrdata(&rdl, t, warn);
+			t = ISC_LIST_NEXT(t, link);
 		}
+
+		CHECK(diff_applyrrset(db, ver, name, op, &rdl, warn));
 	}
 	return (ISC_R_SUCCESS);
 
 failure:
-	if (node != NULL) {
-		dns_db_detachnode(db, &node);
-	}
 	return (result);
 }
 
@@ -29,6 +29,7 @@
 #include <isc/random.h>
 #include <isc/stats.h>
 #include <isc/string.h>
+#include <isc/tid.h>
 #include <isc/time.h>
 #include <isc/util.h>
 
@@ -44,7 +45,9 @@ typedef ISC_LIST(dns_dispentry_t) dns_displist_t;
 typedef struct dns_qid {
 	unsigned int magic;
 	isc_mutex_t lock;
+	unsigned int qid_bits;	    /*%< log2 of the hash table size */
 	unsigned int qid_nbuckets;  /*%< hash table size */
+	unsigned int qid_count;	    /*%< number of entries */
 	unsigned int qid_increment; /*%< id increment on collision */
 	dns_displist_t *qid_table;  /*%< the table itself */
 } dns_qid_t;
@@ -61,8 +64,13 @@ struct dns_dispatchmgr {
 	/* Locked by "lock". */
 	isc_mutex_t lock;
 	ISC_LIST(dns_dispatch_t) list;
+	ISC_LIST(dns_dispatch_t) idle; /*%< pooled idle TCP dispatches */
+	unsigned int nidle;
+	unsigned int idle_max;	   /*%< max # of pooled TCP dispatches */
+	unsigned int idle_timeout; /*%< idle TCP timeout (ms) */
 
-	dns_qid_t *qid;
+	dns_qid_t **qids; /*%< per-loop QID tables for UDP */
+	uint32_t nqids;
 
 	in_port_t *v4ports;    /*%< available ports for IPv4 */
 	unsigned int nv4ports; /*%< # of available ports for IPv4 */
@@ -75,6 +83,7 @@ struct dns_dispentry {
 	isc_refcount_t references;
 	dns_dispatch_t *disp;
 	isc_nmhandle_t *handle; /*%< netmgr handle for UDP connection */
+	dns_qid_t *qid;
 	unsigned int bucket;
 	unsigned int retries;
 	unsigned int timeout;
@@ -115,9 +124,11 @@ struct dns_dispatch {
 	isc_sockaddr_t local;	/*%< local address */
 	in_port_t localport;	/*%< local UDP port */
 	isc_sockaddr_t peer;	/*%< peer address (TCP) */
+	dns_qid_t *qid;		/*%< QID table (TCP) */
 
 	/*% Locked by mgr->lock. */
 	ISC_LINK(dns_dispatch_t) link;
+	ISC_LINK(dns_dispatch_t) ilink;
 
 	/* Locked by "lock". */
 	isc_mutex_t lock; /*%< locks all below */
@@ -126,6 +137,7 @@ struct dns_dispatch {
 	atomic_bool tcpreading;
 	isc_refcount_t references;
 	unsigned int shutdown_out : 1;
+	unsigned int timeout; /*%< TCP read timeout (ms) */
 
 	dns_displist_t pending;
 	dns_displist_t active;
@@ -173,14 +185,22 @@ struct dns_dispatch {
 #endif /* ifndef DNS_DISPATCH_MAXREQUESTS */
 
 /*%
- * Number of buckets in the QID hash table, and the value to
- * increment the QID by when attempting to avoid collisions.
- * The number of buckets should be prime, and the increment
- * should be the next higher prime number.
+ * The QID hash tables start with 2^DNS_QID_MINBITS buckets and double
+ * in size whenever they hold more than DNS_QID_LOAD entries per bucket
+ * on average, up to 2^DNS_QID_MAXBITS buckets.
+ */
+#ifndef DNS_QID_MINBITS
+#define DNS_QID_MINBITS 6
+#endif /* ifndef DNS_QID_MINBITS */
+#ifndef DNS_QID_MAXBITS
+#define DNS_QID_MAXBITS 16
+#endif /* ifndef DNS_QID_MAXBITS */
+#define DNS_QID_LOAD 2
+
+/*%
+ * The value to increment the QID by when attempting to avoid
+ * collisions; it should be a prime number.
  */
-#ifndef DNS_QID_BUCKETS
-#define DNS_QID_BUCKETS 16411
-#endif /* ifndef DNS_QID_BUCKETS */
 #ifndef DNS_QID_INCREMENT
 #define DNS_QID_INCREMENT 16433
 #endif /* ifndef DNS_QID_INCREMENT */
@@ -208,13 +228,19 @@ static isc_result_t
 dispatch_createudp(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *localaddr,
 		   dns_dispatch_t **dispp);
 static void
-qid_allocate(dns_dispatchmgr_t *mgr, dns_qid_t **qidp);
+qid_allocate(isc_mem_t *mctx, dns_qid_t **qidp);
 static void
 qid_destroy(isc_mem_t *mctx, dns_qid_t **qidp);
 static void
 startrecv(isc_nmhandle_t *handle, dns_dispatch_t *disp, dns_dispentry_t *resp);
 void
 dispatch_getnext(dns_dispatch_t *disp, dns_dispentry_t *resp, int32_t timeout);
+static void
+dispatch_park(dns_dispatch_t *disp);
+static void
+dispatch_unpark(dns_dispatch_t *disp);
+static void
+dispatch_close(dns_dispatch_t *disp);
 
 #define LVL(x) ISC_LOG_DEBUG(x)
 
@@ -286,7 +312,9 @@ dns_hash(dns_qid_t *qid, const isc_sockaddr_t *dest, dns_messageid_t id,
 
 	ret = isc_sockaddr_hash(dest, true);
 	ret ^= ((uint32_t)id << 16) | port;
-	ret %= qid->qid_nbuckets;
+
+	/* Fibonacci hashing, so that all the bits affect the bucket */
+	ret = (ret * UINT32_C(0x9e3779b1)) >> (32 - qid->qid_bits);
 
 	INSIST(ret < qid->qid_nbuckets);
 
@@ -749,12 +777,13 @@ tcp_recv(isc_nmhandle_t *handle, isc_result_t result, isc_region_t *region,
 	char buf[ISC_SOCKADDR_FORMATSIZE];
 	isc_sockaddr_t peer;
 	dns_displist_t resps;
+	bool reading;
 
 	REQUIRE(VALID_DISPATCH(disp));
 
 	atomic_store(&disp->tcpreading, false);
 
-	qid = disp->mgr->qid;
+	qid = disp->qid;
 
 	ISC_LIST_INIT(resps);
 
@@ -774,6 +803,7 @@ tcp_recv(isc_nmhandle_t *handle, isc_result_t result, isc_region_t *region,
 		isc_sockaddr_format(&peer, buf, sizeof(buf));
 		dispatch_log(disp, LVL(90), "shutting down TCP: %s: %s", buf,
 			     isc_result_totext(result));
+		disp->shutdown_out = 1;
 		tcp_recv_shutdown(disp, &resps);
 		break;
 
@@ -808,12 +838,23 @@ tcp_recv(isc_nmhandle_t *handle, isc_result_t result, isc_region_t *region,
 			     "shutting down due to TCP "
 			     "receive error: %s: %s",
 			     buf, isc_result_totext(result));
+		disp->shutdown_out = 1;
 		tcp_recv_shutdown(disp, &resps);
 		break;
 	}
 
+	reading = atomic_load(&disp->tcpreading);
+
 	UNLOCK(&disp->lock);
 
+	/*
+	 * If nothing is reading from the connection anymore, it has
+	 * either been closed or timed out; it can't stay in the pool.
+	 */
+	if (!reading) {
+		dispatch_unpark(disp);
+	}
+
 	switch (result) {
 	case ISC_R_SUCCESS:
 	case ISC_R_TIMEDOUT:
@@ -926,6 +967,7 @@ dns_dispatchmgr_create(isc_mem_t *mctx, isc_nm_t *nm,
 	isc_mutex_init(&mgr->lock);
 
 	ISC_LIST_INIT(mgr->list);
+	ISC_LIST_INIT(mgr->idle);
 
 	create_default_portset(mctx, AF_INET, &v4portset);
 	create_default_portset(mctx, AF_INET6, &v6portset);
@@ -935,7 +977,12 @@ dns_dispatchmgr_create(isc_mem_t *mctx, isc_nm_t *nm,
 	isc_portset_destroy(mctx, &v4portset);
 	isc_portset_destroy(mctx, &v6portset);
 
-	qid_allocate(mgr, &mgr->qid);
+	mgr->nqids = isc_nm_getnloops(nm);
+	mgr->qids = isc_mem_get(mctx, mgr->nqids * sizeof(mgr->qids[0]));
+	for (uint32_t i = 0; i < mgr->nqids; i++) {
+		mgr->qids[i] = NULL;
+		qid_allocate(mctx, &mgr->qids[i]);
+	}
 	mgr->magic = DNS_DISPATCHMGR_MAGIC;
 
 	*mgrp = mgr;
@@ -996,10 +1043,15 @@ dispatchmgr_destroy(dns_dispatchmgr_t *mgr) {
 
 	isc_refcount_destroy(&mgr->references);
 
+	INSIST(ISC_LIST_EMPTY(mgr->idle));
+
 	mgr->magic = 0;
 	isc_mutex_destroy(&mgr->lock);
 
-	qid_destroy(mgr->mctx, &mgr->qid);
+	for (uint32_t i = 0; i < mgr->nqids; i++) {
+		qid_destroy(mgr->mctx, &mgr->qids[i]);
+	}
+	isc_mem_put(mgr->mctx, mgr->qids, mgr->nqids * sizeof(mgr->qids[0]));
 
 	if (mgr->blackhole != NULL) {
 		dns_acl_detach(&mgr->blackhole);
@@ -1032,19 +1084,48 @@ dns_dispatchmgr_setstats(dns_dispatchmgr_t *mgr, isc_stats_t *stats) {
 	isc_stats_attach(stats, &mgr->stats);
 }
 
+void
+dns_dispatchmgr_setidle(dns_dispatchmgr_t *mgr, unsigned int max,
+			unsigned int timeout) {
+	dns_dispatch_t *disp = NULL;
+	ISC_LIST(dns_dispatch_t) evict;
+
+	REQUIRE(VALID_DISPATCHMGR(mgr));
+	REQUIRE(max == 0 || timeout > 0);
+
+	ISC_LIST_INIT(evict);
+
+	LOCK(&mgr->lock);
+	mgr->idle_max = max;
+	mgr->idle_timeout = timeout;
+	while (mgr->nidle > max) {
+		disp = ISC_LIST_HEAD(mgr->idle);
+		ISC_LIST_UNLINK(mgr->idle, disp, ilink);
+		ISC_LIST_APPEND(evict, disp, ilink);
+		mgr->nidle--;
+	}
+	UNLOCK(&mgr->lock);
+
+	while ((disp = ISC_LIST_HEAD(evict)) != NULL) {
+		ISC_LIST_UNLINK(evict, disp, ilink);
+		dispatch_close(disp);
+	}
+}
+
 static void
-qid_allocate(dns_dispatchmgr_t *mgr, dns_qid_t **qidp) {
+qid_allocate(isc_mem_t *mctx, dns_qid_t **qidp) {
 	dns_qid_t *qid = NULL;
 	unsigned int i;
 
 	REQUIRE(qidp != NULL && *qidp == NULL);
 
-	qid = isc_mem_get(mgr->mctx, sizeof(*qid));
-	*qid = (dns_qid_t){ .qid_nbuckets = DNS_QID_BUCKETS,
+	qid = isc_mem_get(mctx, sizeof(*qid));
+	*qid = (dns_qid_t){ .qid_bits = DNS_QID_MINBITS,
+			    .qid_nbuckets = 1U << DNS_QID_MINBITS,
 			    .qid_increment = DNS_QID_INCREMENT };
 
-	qid->qid_table = isc_mem_get(mgr->mctx,
-				     DNS_QID_BUCKETS * sizeof(dns_displist_t));
+	qid->qid_table = isc_mem_get(mctx, qid->qid_nbuckets *
+						   sizeof(dns_displist_t));
 	for (i = 0; i < qid->qid_nbuckets; i++) {
 		ISC_LIST_INIT(qid->qid_table[i]);
 	}
@@ -1063,6 +1144,7 @@ qid_destroy(isc_mem_t *mctx, dns_qid_t **qidp) {
 	*qidp = NULL;
 
 	REQUIRE(VALID_QID(qid));
+	INSIST(qid->qid_count == 0);
 
 	qid->magic = 0;
 	isc_mem_put(mctx, qid->qid_table,
@@ -1071,6 +1153,58 @@ qid_destroy(isc_mem_t *mctx, dns_qid_t **qidp) {
 	isc_mem_put(mctx, qid, sizeof(*qid));
 }
 
+/*
+ * Double the size of the QID hash table and rehash its entries.
+ * Must be called with qid->lock held.
+ */
+static void
+qid_grow(isc_mem_t *mctx, dns_qid_t *qid) {
+	dns_displist_t *oldtable = qid->qid_table;
+	unsigned int oldnbuckets = qid->qid_nbuckets;
+
+	REQUIRE(VALID_QID(qid));
+	REQUIRE(qid->qid_bits < DNS_QID_MAXBITS);
+
+	qid->qid_bits++;
+	qid->qid_nbuckets = 1U << qid->qid_bits;
+	qid->qid_table = isc_mem_get(mctx, qid->qid_nbuckets *
+						   sizeof(dns_displist_t));
+	for (unsigned int i = 0; i < qid->qid_nbuckets; i++) {
+		ISC_LIST_INIT(qid->qid_table[i]);
+	}
+
+	for (unsigned int i = 0; i < oldnbuckets; i++) {
+		dns_dispentry_t *res = NULL;
+
+		while ((res = ISC_LIST_HEAD(oldtable[i])) != NULL) {
+			ISC_LIST_UNLINK(oldtable[i], res, link);
+			res->bucket = dns_hash(qid, &res->peer, res->id,
+					       res->port);
+			ISC_LIST_APPEND(qid->qid_table[res->bucket], res,
+					link);
+		}
+	}
+
+	isc_mem_put(mctx, oldtable, oldnbuckets * sizeof(dns_displist_t));
+}
+
+/*
+ * Return the QID table for new entries on 'disp': TCP dispatches have
+ * their own, while UDP queries use the table of the current loop, as
+ * their responses are read on the loop that sent them.
+ */
+static dns_qid_t *
+dispatch_qid(dns_dispatch_t *disp) {
+	dns_dispatchmgr_t *mgr = disp->mgr;
+	uint32_t tid = isc_tid();
+
+	if (disp->socktype == isc_socktype_tcp) {
+		return (disp->qid);
+	}
+
+	return (mgr->qids[tid < mgr->nqids ? tid : 0]);
+}
+
 /*
  * Allocate and set important limits.
  */
@@ -1093,6 +1227,7 @@ dispatch_allocate(dns_dispatchmgr_t *mgr, isc_socktype_t type,
 	dns_dispatchmgr_attach(mgr, &disp->mgr);
 	isc_refcount_init(&disp->references, 1);
 	ISC_LINK_INIT(disp, link);
+	ISC_LINK_INIT(disp, ilink);
 	ISC_LIST_INIT(disp->active);
 	ISC_LIST_INIT(disp->pending);
 
@@ -1122,12 +1257,123 @@ dispatch_free(dns_dispatch_t **dispp) {
 
 	INSIST(disp->requests == 0);
 	INSIST(ISC_LIST_EMPTY(disp->active));
+	INSIST(!ISC_LINK_LINKED(disp, ilink));
+
+	if (disp->qid != NULL) {
+		qid_destroy(mgr->mctx, &disp->qid);
+	}
 
 	isc_mutex_destroy(&disp->lock);
 
 	isc_mem_put(mgr->mctx, disp, sizeof(*disp));
 }
 
+/*
+ * Take 'disp' out of the idle pool if it is there, and restore the
+ * read timeout used for queries.  Returns true if it was pooled, in
+ * which case the caller takes over the pool's reference.
+ *
+ * Requires mgr->lock to be held.
+ */
+static bool
+dispatch_unpark_locked(dns_dispatch_t *disp) {
+	dns_dispatchmgr_t *mgr = disp->mgr;
+
+	if (!ISC_LINK_LINKED(disp, ilink)) {
+		return (false);
+	}
+
+	ISC_LIST_UNLINK(mgr->idle, disp, ilink);
+	mgr->nidle--;
+
+	if (disp->timeout > 0) {
+		isc_nmhandle_settimeout(disp->handle, disp->timeout);
+	}
+
+	return (true);
+}
+
+static void
+dispatch_unpark(dns_dispatch_t *disp) {
+	dns_dispatchmgr_t *mgr = disp->mgr;
+	bool pooled;
+
+	LOCK(&mgr->lock);
+	pooled = dispatch_unpark_locked(disp);
+	UNLOCK(&mgr->lock);
+
+	if (pooled) {
+		dispatch_log(disp, LVL(90), "removed from the idle pool");
+		dns_dispatch_detach(&disp);
+	}
+}
+
+/*
+ * Close a connection that has been taken out of the idle pool and
+ * release the pool's reference to it; the pending read is canceled,
+ * which lets tcp_recv() release its own reference.
+ */
+static void
+dispatch_close(dns_dispatch_t *disp) {
+	dispatch_log(disp, LVL(90), "closing idle connection");
+	isc_nm_cancelread(disp->handle);
+	dns_dispatch_detach(&disp);
+}
+
+/*
+ * Keep a connected TCP dispatch that has no more queries open, so that
+ * dns_dispatch_gettcp() can reuse it instead of connecting again.  The
+ * connection is read with the idle timeout while it is in the pool, so
+ * that it's released when it times out or the peer closes it.  If the
+ * pool is full, the connection that has been idle longest is closed.
+ */
+static void
+dispatch_park(dns_dispatch_t *disp) {
+	dns_dispatchmgr_t *mgr = disp->mgr;
+	dns_dispatch_t *oldest = NULL;
+	bool usable;
+
+	LOCK(&mgr->lock);
+	if (mgr->idle_max == 0 || ISC_LINK_LINKED(disp, ilink)) {
+		UNLOCK(&mgr->lock);
+		return;
+	}
+
+	LOCK(&disp->lock);
+	usable = (disp->requests == 0 && disp->handle != NULL &&
+		  !disp->shutdown_out &&
+		  atomic_load(&disp->tcpstate) == DNS_DISPATCHSTATE_CONNECTED);
+	UNLOCK(&disp->lock);
+
+	if (!usable) {
+		UNLOCK(&mgr->lock);
+		return;
+	}
+
+	if (mgr->nidle >= mgr->idle_max) {
+		oldest = ISC_LIST_HEAD(mgr->idle);
+		ISC_LIST_UNLINK(mgr->idle, oldest, ilink);
+		mgr->nidle--;
+	}
+
+	dns_dispatch_attach(disp, &(dns_dispatch_t *){ NULL });
+	ISC_LIST_APPEND(mgr->idle, disp, ilink);
+	mgr->nidle++;
+
+	isc_nmhandle_settimeout(disp->handle, mgr->idle_timeout);
+	UNLOCK(&mgr->lock);
+
+	dispatch_log(disp, LVL(90), "added to the idle pool");
+
+	LOCK(&disp->lock);
+	dispatch_getnext(disp, NULL, -1);
+	UNLOCK(&disp->lock);
+
+	if (oldest != NULL) {
+		dispatch_close(oldest);
+	}
+}
+
 isc_result_t
 dns_dispatch_createtcp(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *localaddr,
 		       const isc_sockaddr_t *destaddr, isc_dscp_t dscp,
@@ -1142,6 +1388,7 @@ dns_dispatch_createtcp(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *localaddr,
 	LOCK(&mgr->lock);
 
 	dispatch_allocate(mgr, isc_socktype_tcp, &disp);
+	qid_allocate(mgr->mctx, &disp->qid);
 
 	disp->peer = *destaddr;
 
@@ -1206,7 +1453,7 @@ dns_dispatch_gettcp(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *destaddr,
 		 * 2. destination address is same
 		 * 3. local address is either NULL or same
 		 */
-		if (disp->socktype == isc_socktype_tcp &&
+		if (disp->socktype == isc_socktype_tcp && !disp->shutdown_out &&
 		    isc_sockaddr_equal(destaddr, &peeraddr) &&
 		    (localaddr == NULL ||
 		     isc_sockaddr_eqaddr(localaddr, &sockname)))
@@ -1236,7 +1483,13 @@ dns_dispatch_gettcp(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *destaddr,
 		INSIST(disp_connected->handle != NULL);
 
 		*connected = true;
-		dns_dispatch_attach(disp_connected, dispp);
+		if (dispatch_unpark_locked(disp_connected)) {
+			/* Take over the idle pool's reference */
+			*dispp = disp_connected;
+		} else {
+			dns_dispatch_attach(disp_connected, dispp);
+		}
+		inc_stats(mgr, dns_resstatscounter_tcpreuse);
 
 		result = ISC_R_SUCCESS;
 	} else if (disp_fallback != NULL) {
@@ -1403,6 +1656,10 @@ dns_dispatch_add(dns_dispatch_t *disp, unsigned int options,
 	REQUIRE(disp->socktype == isc_socktype_tcp ||
 		disp->socktype == isc_socktype_udp);
 
+	if (disp->socktype == isc_socktype_tcp) {
+		dispatch_unpark(disp);
+	}
+
 	LOCK(&disp->lock);
 
 	if (disp->requests >= DNS_DISPATCH_MAXREQUESTS) {
@@ -1410,7 +1667,7 @@ dns_dispatch_add(dns_dispatch_t *disp, unsigned int options,
 		return (ISC_R_QUOTA);
 	}
 
-	qid = disp->mgr->qid;
+	qid = dispatch_qid(disp);
 
 	if (disp->socktype == isc_socktype_udp &&
 	    disp->nsockets > DNS_DISPATCH_SOCKSQUOTA)
@@ -1478,26 +1735,36 @@ dns_dispatch_add(dns_dispatch_t *disp, unsigned int options,
 		id += qid->qid_increment;
 		id &= 0x0000ffff;
 	} while (i++ < 64);
-	UNLOCK(&qid->lock);
 
 	if (!ok) {
+		UNLOCK(&qid->lock);
 		isc_mem_put(disp->mgr->mctx, res, sizeof(*res));
 		UNLOCK(&disp->lock);
 		return (ISC_R_NOMORE);
 	}
 
-	dns_dispatch_attach(disp, &res->disp);
-
+	/*
+	 * Insert the entry in the same critical section as the search,
+	 * so that the ID stays unique.
+	 */
 	res->id = id;
 	res->bucket = bucket;
+	res->qid = qid;
+	ISC_LIST_APPEND(qid->qid_table[bucket], res, link);
+	qid->qid_count++;
+	if (qid->qid_count > qid->qid_nbuckets * DNS_QID_LOAD &&
+	    qid->qid_bits < DNS_QID_MAXBITS)
+	{
+		qid_grow(disp->mgr->mctx, qid);
+	}
+	UNLOCK(&qid->lock);
+
+	dns_dispatch_attach(disp, &res->disp);
+
 	res->magic = RESPONSE_MAGIC;
 
 	disp->requests++;
 
-	LOCK(&qid->lock);
-	ISC_LIST_APPEND(qid->qid_table[bucket], res, link);
-	UNLOCK(&qid->lock);
-
 	inc_stats(disp->mgr, (disp->socktype == isc_socktype_udp)
 				     ? dns_resstatscounter_disprequdp
 				     : dns_resstatscounter_dispreqtcp);
@@ -1642,6 +1909,7 @@ dns_dispatch_done(dns_dispentry_t **respp) {
 	dns_dispatch_t *disp = NULL;
 	dns_dispentry_t *resp = NULL;
 	dns_qid_t *qid = NULL;
+	bool idle;
 
 	REQUIRE(respp != NULL);
 
@@ -1657,7 +1925,7 @@ dns_dispatch_done(dns_dispentry_t **respp) {
 
 	REQUIRE(VALID_DISPATCHMGR(mgr));
 
-	qid = mgr->qid;
+	qid = resp->qid;
 
 	LOCK(&disp->lock);
 	INSIST(disp->requests > 0);
@@ -1671,9 +1939,17 @@ dns_dispatch_done(dns_dispentry_t **respp) {
 
 	LOCK(&qid->lock);
 	ISC_LIST_UNLINK(qid->qid_table[resp->bucket], resp, link);
+	INSIST(qid->qid_count > 0);
+	qid->qid_count--;
 	UNLOCK(&qid->lock);
+
+	idle = (disp->socktype == isc_socktype_tcp && disp->requests == 0);
 	UNLOCK(&disp->lock);
 
+	if (idle) {
+		dispatch_park(disp);
+	}
+
 	dispentry_detach(respp);
 }
 
@@ -1813,6 +2089,7 @@ dns_dispatch_connect(dns_dispentry_t *resp) {
 			/* First connection, continue with connecting */
 			LOCK(&disp->lock);
 			ISC_LIST_APPEND(disp->pending, resp, plink);
+			disp->timeout = resp->timeout;
 			UNLOCK(&disp->lock);
 			dns_dispatch_attach(disp, &(dns_dispatch_t *){ NULL });
 			isc_nm_tcpdnsconnect(disp->mgr->nm, &disp->local,
@@ -1952,13 +2229,8 @@ dns_dispatchset_get(dns_dispatchset_t *dset) {
 		return (NULL);
 	}
 
-	LOCK(&dset->lock);
-	disp = dset->dispatches[dset->cur];
-	dset->cur++;
-	if (dset->cur == dset->ndisp) {
-		dset->cur = 0;
-	}
-	UNLOCK(&dset->lock);
+	disp = dset->dispatches[atomic_fetch_add_relaxed(&dset->cur, 1) %
+				(uint32_t)dset->ndisp];
 
 	return (disp);
 }
@@ -1979,8 +2251,7 @@ dns_dispatchset_create(isc_mem_t *mctx, dns_dispatch_t *source,
 
 	dset = isc_mem_get(mctx, sizeof(dns_dispatchset_t));
 	*dset = (dns_dispatchset_t){ .ndisp = n };
-
-	isc_mutex_init(&dset->lock);
+	atomic_init(&dset->cur, 0);
 
 	dset->dispatches = isc_mem_get(mctx, sizeof(dns_dispatch_t *) * n);
 
@@ -2015,7 +2286,6 @@ fail:
 		isc_mem_detach(&dset->mctx);
 	}
 
-	isc_mutex_destroy(&dset->lock);
 	isc_mem_put(mctx, dset, sizeof(dns_dispatchset_t));
 	return (result);
 }
@@ -2034,6 +2304,5 @@ dns_dispatchset_destroy(dns_dispatchset_t **dsetp) {
 	}
 	isc_mem_put(dset->mctx, dset->dispatches,
 		    sizeof(dns_dispatch_t *) * dset->ndisp);
-	isc_mutex_destroy(&dset->lock);
 	isc_mem_putanddetach(&dset->mctx, dset, sizeof(dns_dispatchset_t));
 }
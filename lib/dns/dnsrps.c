@@ -971,6 +971,12 @@ static dns_dbmethods_t rpsdb_db_methods = {
 	NULL, /* setservestalerefresh */
 	NULL, /* getservestalerefresh */
 	NULL, /* setgluecachestats */
+	NULL, /* setevictionpolicy */
+	NULL, /* getmemory */
+	NULL, /* expire */
+	NULL, /* setcoldtier */
+	NULL, /* flushtree */
+	NULL, /* nsec3hashname */
 };
 
 static dns_rdatasetmethods_t rpsdb_rdataset_methods = {
@@ -370,40 +370,21 @@ cleanup_databuf:
 	return (ret);
 }
 
-isc_result_t
-dns_dnssec_verify(const dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
-		  bool ignoretime, unsigned int maxbits, isc_mem_t *mctx,
-		  dns_rdata_t *sigrdata, dns_name_t *wild) {
-	dns_rdata_rrsig_t sig;
-	dns_fixedname_t fnewname;
-	isc_region_t r;
-	isc_buffer_t envbuf;
-	dns_rdata_t *rdatas;
-	int nrdatas, i;
+/*
+ * Check everything about 'sig' that does not need the signature to be
+ * verified.
+ */
+static isc_result_t
+verify_check(const dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
+	     bool ignoretime, dns_rdata_rrsig_t *sig) {
 	isc_stdtime_t now;
-	isc_result_t ret;
-	unsigned char data[300];
-	dst_context_t *ctx = NULL;
-	int labels = 0;
 	uint32_t flags;
-	bool downcase = false;
-
-	REQUIRE(name != NULL);
-	REQUIRE(set != NULL);
-	REQUIRE(key != NULL);
-	REQUIRE(mctx != NULL);
-	REQUIRE(sigrdata != NULL && sigrdata->type == dns_rdatatype_rrsig);
-
-	ret = dns_rdata_tostruct(sigrdata, &sig, NULL);
-	if (ret != ISC_R_SUCCESS) {
-		return (ret);
-	}
 
-	if (set->type != sig.covered) {
+	if (set->type != sig->covered) {
 		return (DNS_R_SIGINVALID);
 	}
 
-	if (isc_serial_lt(sig.timeexpire, sig.timesigned)) {
+	if (isc_serial_lt(sig->timeexpire, sig->timesigned)) {
 		inc_stat(dns_dnssecstats_fail);
 		return (DNS_R_SIGINVALID);
 	}
@@ -414,10 +395,10 @@ dns_dnssec_verify(const dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 		/*
 		 * Is SIG temporally valid?
 		 */
-		if (isc_serial_lt((uint32_t)now, sig.timesigned)) {
+		if (isc_serial_lt((uint32_t)now, sig->timesigned)) {
 			inc_stat(dns_dnssecstats_fail);
 			return (DNS_R_SIGFUTURE);
-		} else if (isc_serial_lt(sig.timeexpire, (uint32_t)now)) {
+		} else if (isc_serial_lt(sig->timeexpire, (uint32_t)now)) {
 			inc_stat(dns_dnssecstats_fail);
 			return (DNS_R_SIGEXPIRED);
 		}
@@ -431,19 +412,19 @@ dns_dnssec_verify(const dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 	case dns_rdatatype_ns:
 	case dns_rdatatype_soa:
 	case dns_rdatatype_dnskey:
-		if (!dns_name_equal(name, &sig.signer)) {
+		if (!dns_name_equal(name, &sig->signer)) {
 			inc_stat(dns_dnssecstats_fail);
 			return (DNS_R_SIGINVALID);
 		}
 		break;
 	case dns_rdatatype_ds:
-		if (dns_name_equal(name, &sig.signer)) {
+		if (dns_name_equal(name, &sig->signer)) {
 			inc_stat(dns_dnssecstats_fail);
 			return (DNS_R_SIGINVALID);
 		}
 		FALLTHROUGH;
 	default:
-		if (!dns_name_issubdomain(name, &sig.signer)) {
+		if (!dns_name_issubdomain(name, &sig->signer)) {
 			inc_stat(dns_dnssecstats_fail);
 			return (DNS_R_SIGINVALID);
 		}
@@ -463,17 +444,39 @@ dns_dnssec_verify(const dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 		return (DNS_R_KEYUNAUTHORIZED);
 	}
 
-again:
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Create a verification context for 'sig' with 'key' and add the data
+ * covered by the signature to it.  'newname' is set to the owner name
+ * the signature was made over, which is the wildcard that was expanded
+ * to 'name', if any.
+ */
+static isc_result_t
+verify_context(const dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
+	       unsigned int maxbits, isc_mem_t *mctx, dns_rdata_t *sigrdata,
+	       dns_rdata_rrsig_t *sig, bool downcase, dns_name_t *newname,
+	       dst_context_t **ctxp) {
+	isc_region_t r;
+	isc_buffer_t envbuf;
+	dns_rdata_t *rdatas;
+	int nrdatas, i;
+	isc_result_t ret;
+	unsigned char data[300];
+	dst_context_t *ctx = NULL;
+	int labels = 0;
+
 	ret = dst_context_create(key, mctx, DNS_LOGCATEGORY_DNSSEC, false,
 				 maxbits, &ctx);
 	if (ret != ISC_R_SUCCESS) {
-		goto cleanup_struct;
+		return (ret);
 	}
 
 	/*
 	 * Digest the SIG rdata (not including the signature).
 	 */
-	ret = digest_sig(ctx, downcase, sigrdata, &sig);
+	ret = digest_sig(ctx, downcase, sigrdata, sig);
 	if (ret != ISC_R_SUCCESS) {
 		goto cleanup_context;
 	}
@@ -481,22 +484,19 @@ again:
 	/*
 	 * If the name is an expanded wildcard, use the wildcard name.
 	 */
-	dns_fixedname_init(&fnewname);
 	labels = dns_name_countlabels(name) - 1;
-	RUNTIME_CHECK(dns_name_downcase(name, dns_fixedname_name(&fnewname),
-					NULL) == ISC_R_SUCCESS);
-	if (labels - sig.labels > 0) {
-		dns_name_split(dns_fixedname_name(&fnewname), sig.labels + 1,
-			       NULL, dns_fixedname_name(&fnewname));
+	RUNTIME_CHECK(dns_name_downcase(name, newname, NULL) == ISC_R_SUCCESS);
+	if (labels - sig->labels > 0) {
+		dns_name_split(newname, sig->labels + 1, NULL, newname);
 	}
 
-	dns_name_toregion(dns_fixedname_name(&fnewname), &r);
+	dns_name_toregion(newname, &r);
 
 	/*
 	 * Create an envelope for each rdata: <name|type|class|ttl>.
 	 */
 	isc_buffer_init(&envbuf, data, sizeof(data));
-	if (labels - sig.labels > 0) {
+	if (labels - sig->labels > 0) {
 		isc_buffer_putuint8(&envbuf, 1);
 		isc_buffer_putuint8(&envbuf, '*');
 		memmove(data + 2, r.base, r.length);
@@ -506,7 +506,7 @@ again:
 	isc_buffer_add(&envbuf, r.length);
 	isc_buffer_putuint16(&envbuf, set->type);
 	isc_buffer_putuint16(&envbuf, set->rdclass);
-	isc_buffer_putuint32(&envbuf, sig.originalttl);
+	isc_buffer_putuint32(&envbuf, sig->originalttl);
 
 	ret = rdataset_to_sortedarray(set, mctx, &rdatas, &nrdatas);
 	if (ret != ISC_R_SUCCESS) {
@@ -557,12 +557,27 @@ again:
 		}
 	}
 
-	r.base = sig.signature;
-	r.length = sig.siglen;
-	ret = dst_context_verify2(ctx, maxbits, &r);
+cleanup_array:
+	isc_mem_put(mctx, rdatas, nrdatas * sizeof(dns_rdata_t));
+cleanup_context:
+	if (ret == ISC_R_SUCCESS) {
+		*ctxp = ctx;
+	} else {
+		dst_context_destroy(&ctx);
+	}
+	return (ret);
+}
+
+/*
+ * Account for the outcome 'ret' of the verification of 'sig' and
+ * translate it to what dns_dnssec_verify() returns.
+ */
+static isc_result_t
+verify_done(const dns_name_t *name, isc_result_t ret, bool downcase,
+	    dns_rdata_rrsig_t *sig) {
 	if (ret == ISC_R_SUCCESS && downcase) {
 		char namebuf[DNS_NAME_FORMATSIZE];
-		dns_name_format(&sig.signer, namebuf, sizeof(namebuf));
+		dns_name_format(&sig->signer, namebuf, sizeof(namebuf));
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_DNSSEC,
 			      DNS_LOGMODULE_DNSSEC, ISC_LOG_DEBUG(1),
 			      "successfully validated after lower casing "
@@ -573,36 +588,176 @@ again:
 		inc_stat(dns_dnssecstats_asis);
 	}
 
-cleanup_array:
-	isc_mem_put(mctx, rdatas, nrdatas * sizeof(dns_rdata_t));
-cleanup_context:
+	if (ret == DST_R_VERIFYFAILURE) {
+		ret = DNS_R_SIGINVALID;
+	}
+
+	if (ret != ISC_R_SUCCESS) {
+		inc_stat(dns_dnssecstats_fail);
+	}
+
+	if (ret == ISC_R_SUCCESS &&
+	    (int)dns_name_countlabels(name) - 1 - sig->labels > 0)
+	{
+		inc_stat(dns_dnssecstats_wildcard);
+		ret = DNS_R_FROMWILDCARD;
+	}
+	return (ret);
+}
+
+isc_result_t
+dns_dnssec_verify(const dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
+		  bool ignoretime, unsigned int maxbits, isc_mem_t *mctx,
+		  dns_rdata_t *sigrdata, dns_name_t *wild) {
+	dns_rdata_rrsig_t sig;
+	dns_fixedname_t fnewname;
+	dns_name_t *newname = dns_fixedname_initname(&fnewname);
+	isc_region_t r;
+	isc_result_t ret;
+	dst_context_t *ctx = NULL;
+	bool downcase = false;
+
+	REQUIRE(name != NULL);
+	REQUIRE(set != NULL);
+	REQUIRE(key != NULL);
+	REQUIRE(mctx != NULL);
+	REQUIRE(sigrdata != NULL && sigrdata->type == dns_rdatatype_rrsig);
+
+	ret = dns_rdata_tostruct(sigrdata, &sig, NULL);
+	if (ret != ISC_R_SUCCESS) {
+		return (ret);
+	}
+
+	ret = verify_check(name, set, key, ignoretime, &sig);
+	if (ret != ISC_R_SUCCESS) {
+		return (ret);
+	}
+
+again:
+	ret = verify_context(name, set, key, maxbits, mctx, sigrdata, &sig,
+			     downcase, newname, &ctx);
+	if (ret != ISC_R_SUCCESS) {
+		goto cleanup_struct;
+	}
+
+	r.base = sig.signature;
+	r.length = sig.siglen;
+	ret = dst_context_verify2(ctx, maxbits, &r);
 	dst_context_destroy(&ctx);
 	if (ret == DST_R_VERIFYFAILURE && !downcase) {
 		downcase = true;
 		goto again;
 	}
+
 cleanup_struct:
 	dns_rdata_freestruct(&sig);
 
-	if (ret == DST_R_VERIFYFAILURE) {
-		ret = DNS_R_SIGINVALID;
+	ret = verify_done(name, ret, downcase, &sig);
+	if (ret == DNS_R_FROMWILDCARD && wild != NULL) {
+		RUNTIME_CHECK(dns_name_concatenate(dns_wildcardname, newname,
+						   wild, NULL) ==
+			      ISC_R_SUCCESS);
 	}
+	return (ret);
+}
 
-	if (ret != ISC_R_SUCCESS) {
-		inc_stat(dns_dnssecstats_fail);
+void
+dns_dnssec_verifybatch(const dns_name_t *name, dns_rdataset_t *set,
+		       dst_key_t **keys, dns_rdata_t *sigrdatas, unsigned int n,
+		       bool ignoretime, unsigned int maxbits, isc_mem_t *mctx,
+		       isc_result_t *results) {
+	dns_rdata_rrsig_t *sigs = NULL;
+	unsigned int *index = NULL;
+	dns_fixedname_t fnewname;
+	dns_name_t *newname = dns_fixedname_initname(&fnewname);
+	dst_batchverify_t *batch = NULL;
+	unsigned int count;
+
+	REQUIRE(name != NULL);
+	REQUIRE(set != NULL);
+	REQUIRE(keys != NULL);
+	REQUIRE(sigrdatas != NULL);
+	REQUIRE(mctx != NULL);
+	REQUIRE(results != NULL);
+
+	if (n == 0) {
+		return;
+	}
+
+	sigs = isc_mem_get(mctx, n * sizeof(sigs[0]));
+	index = isc_mem_get(mctx, n * sizeof(index[0]));
+	dst_batchverify_create(mctx, n, maxbits, &batch);
+
+	for (unsigned int i = 0; i < n; i++) {
+		dst_context_t *ctx = NULL;
+		isc_result_t ret;
+
+		REQUIRE(keys[i] != NULL);
+		REQUIRE(sigrdatas[i].type == dns_rdatatype_rrsig);
+
+		ret = dns_rdata_tostruct(&sigrdatas[i], &sigs[i], NULL);
+		if (ret != ISC_R_SUCCESS) {
+			results[i] = ret;
+			continue;
+		}
+
+		ret = verify_check(name, set, keys[i], ignoretime, &sigs[i]);
+		if (ret == ISC_R_SUCCESS) {
+			ret = verify_context(name, set, keys[i], maxbits, mctx,
+					     &sigrdatas[i], &sigs[i], false,
+					     newname, &ctx);
+			if (ret != ISC_R_SUCCESS) {
+				ret = verify_done(name, ret, false, &sigs[i]);
+			}
+		}
+		if (ret != ISC_R_SUCCESS) {
+			results[i] = ret;
+			dns_rdata_freestruct(&sigs[i]);
+			continue;
+		}
+
+		index[dst_batchverify_count(batch)] = i;
+		dst_batchverify_add(batch, &ctx,
+				    &(isc_region_t){ sigs[i].signature,
+						     sigs[i].siglen });
 	}
 
-	if (ret == ISC_R_SUCCESS && labels - sig.labels > 0) {
-		if (wild != NULL) {
-			RUNTIME_CHECK(dns_name_concatenate(
-					      dns_wildcardname,
-					      dns_fixedname_name(&fnewname),
-					      wild, NULL) == ISC_R_SUCCESS);
+	dst_batchverify_run(batch);
+
+	count = dst_batchverify_count(batch);
+	for (unsigned int j = 0; j < count; j++) {
+		unsigned int i = index[j];
+		isc_result_t ret = dst_batchverify_result(batch, j);
+		bool downcase = false;
+
+		/*
+		 * Like dns_dnssec_verify(), try again with the signer
+		 * name in lower case if the signature did not verify as
+		 * it was.
+		 */
+		if (ret == DST_R_VERIFYFAILURE) {
+			dst_context_t *ctx = NULL;
+
+			downcase = true;
+			ret = verify_context(name, set, keys[i], maxbits, mctx,
+					     &sigrdatas[i], &sigs[i], true,
+					     newname, &ctx);
+			if (ret == ISC_R_SUCCESS) {
+				ret = dst_context_verify2(
+					ctx, maxbits,
+					&(isc_region_t){ sigs[i].signature,
+							 sigs[i].siglen });
+				dst_context_destroy(&ctx);
+			}
 		}
-		inc_stat(dns_dnssecstats_wildcard);
-		ret = DNS_R_FROMWILDCARD;
+
+		results[i] = verify_done(name, ret, downcase, &sigs[i]);
+		dns_rdata_freestruct(&sigs[i]);
 	}
-	return (ret);
+
+	dst_batchverify_destroy(&batch);
+	isc_mem_put(mctx, index, n * sizeof(index[0]));
+	isc_mem_put(mctx, sigs, n * sizeof(sigs[0]));
 }
 
 bool
@@ -59,8 +59,10 @@
 #include <isc/log.h>
 #include <isc/mem.h>
 #include <isc/mutex.h>
+#include <isc/netaddr.h>
 #include <isc/once.h>
 #include <isc/print.h>
+#include <isc/random.h>
 #include <isc/result.h>
 #include <isc/sockaddr.h>
 #include <isc/task.h>
@@ -69,6 +71,7 @@
 #include <isc/types.h>
 #include <isc/util.h>
 
+#include <dns/acl.h>
 #include <dns/dnstap.h>
 #include <dns/events.h>
 #include <dns/log.h>
@@ -84,12 +87,19 @@
 #define DTENV_MAGIC	 ISC_MAGIC('D', 't', 'n', 'v')
 #define VALID_DTENV(env) ISC_MAGIC_VALID(env, DTENV_MAGIC)
 
-#define DNSTAP_CONTENT_TYPE	"protobuf:dnstap.Dnstap"
-#define DNSTAP_INITIAL_BUF_SIZE 256
+#define DTFILTER_MAGIC	       ISC_MAGIC('D', 't', 'f', 'l')
+#define VALID_DTFILTER(filter) ISC_MAGIC_VALID(filter, DTFILTER_MAGIC)
+
+#define DNSTAP_CONTENT_TYPE "protobuf:dnstap.Dnstap"
+
+/*
+ * Size of the per-thread frame buffers, and the largest frame that is
+ * serialized into them; larger frames are allocated separately.
+ */
+#define DNSTAP_RING_SIZE (256 * 1024)
+#define DNSTAP_FRAME_MAX (DNSTAP_RING_SIZE / 4)
 
 struct dns_dtmsg {
-	void *buf;
-	size_t len;
 	Dnstap__Dnstap d;
 	Dnstap__Message m;
 };
@@ -122,6 +132,25 @@ struct dns_dtenv {
 	int rolls;
 	isc_log_rollsuffix_t suffix;
 	isc_stats_t *stats;
+
+	isc_mutex_t rings_lock; /* locks 'rings' */
+	ISC_LIST(struct dt_ring) rings;
+};
+
+typedef struct dt_filtername {
+	dns_name_t name;
+	ISC_LINK(struct dt_filtername) link;
+} dt_filtername_t;
+
+struct dns_dtfilter {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	uint32_t sample;
+	bool byclient;
+	dns_acl_t *clients;
+	ISC_LIST(dt_filtername_t) names;
+	uint8_t *types;	 /* bitmap of question types, if any */
+	uint16_t rcodes; /* bitmap of header rcodes, if any */
 };
 
 #define CHECK(x)                             \
@@ -138,6 +167,29 @@ typedef struct ioq {
 
 static thread_local dt__ioq_t dt_ioq = { 0 };
 
+/*
+ * Each thread serializes its frames into a ring buffer of its own.  The
+ * fstrm I/O thread releases the frames of an input queue in the order
+ * in which they were submitted, so releasing a frame only has to move
+ * the tail of the ring forward.  'head' and 'tail' count the bytes that
+ * have been allocated and released since the ring was created.
+ */
+typedef struct dt_ring {
+	dns_dtenv_t *env;
+	void *owner; /* 'dt_thread' of the thread that fills the ring */
+	uint8_t *base;
+	uint_fast64_t head;
+	atomic_uint_fast64_t tail;
+	ISC_LINK(struct dt_ring) link;
+} dt_ring_t;
+
+typedef struct dt_thread {
+	unsigned int generation;
+	dt_ring_t *ring;
+} dt__thread_t;
+
+static thread_local dt__thread_t dt_thread = { 0 };
+
 static atomic_uint_fast32_t global_generation;
 
 isc_result_t
@@ -168,6 +220,8 @@ dns_dt_create(isc_mem_t *mctx, dns_dtmode_t mode, const char *path,
 	env->reopen_task = reopen_task;
 	isc_mutex_init(&env->reopen_lock);
 	env->reopen_queued = false;
+	isc_mutex_init(&env->rings_lock);
+	ISC_LIST_INIT(env->rings);
 	env->path = isc_mem_strdup(env->mctx, path);
 	isc_refcount_init(&env->refcount, 1);
 	CHECK(isc_stats_create(env->mctx, &env->stats, dns_dnstapcounter_max));
@@ -236,6 +290,7 @@ cleanup:
 
 	if (result != ISC_R_SUCCESS) {
 		isc_mutex_destroy(&env->reopen_lock);
+		isc_mutex_destroy(&env->rings_lock);
 		isc_mem_free(env->mctx, env->path);
 		if (env->stats != NULL) {
 			isc_stats_detach(&env->stats);
@@ -475,6 +530,19 @@ dns_dt_getstats(dns_dtenv_t *env, isc_stats_t **statsp) {
 	return (ISC_R_SUCCESS);
 }
 
+static void
+free_rings(dns_dtenv_t *env) {
+	dt_ring_t *ring = NULL;
+
+	while ((ring = ISC_LIST_HEAD(env->rings)) != NULL) {
+		ISC_LIST_UNLINK(env->rings, ring, link);
+		INSIST(atomic_load_acquire(&ring->tail) == ring->head);
+		isc_mem_put(env->mctx, ring->base, DNSTAP_RING_SIZE);
+		isc_mem_put(env->mctx, ring, sizeof(*ring));
+	}
+	isc_mutex_destroy(&env->rings_lock);
+}
+
 static void
 destroy(dns_dtenv_t *env) {
 	isc_log_write(dns_lctx, DNS_LOGCATEGORY_DNSTAP, DNS_LOGMODULE_DNSTAP,
@@ -490,6 +558,9 @@ destroy(dns_dtenv_t *env) {
 		fstrm_iothr_options_destroy(&env->fopt);
 	}
 
+	/* All the frames have been released by the I/O thread now. */
+	free_rings(env);
+
 	if (env->identity.base != NULL) {
 		isc_mem_free(env->mctx, env->identity.base);
 		env->identity.length = 0;
@@ -520,58 +591,274 @@ dns_dt_detach(dns_dtenv_t **envp) {
 	}
 }
 
-static isc_result_t
-pack_dt(const Dnstap__Dnstap *d, void **buf, size_t *sz) {
-	ProtobufCBufferSimple sbuf;
+/*
+ * Protocol buffer encoding of the dnstap frames.  The messages are
+ * encoded straight into the frame buffer, without the allocations that
+ * protobuf-c makes when packing.  Each function returns the number of
+ * bytes that it encodes, and only writes them if '*pp' is not NULL, so
+ * that the size of a frame can be computed before it is encoded.
+ */
+#define PB_VARINT  0
+#define PB_BYTES   2
+#define PB_FIXED32 5
 
-	REQUIRE(d != NULL);
-	REQUIRE(sz != NULL);
+static size_t
+pb_varint(uint8_t **pp, uint64_t value) {
+	size_t len = 0;
 
-	memset(&sbuf, 0, sizeof(sbuf));
-	sbuf.base.append = protobuf_c_buffer_simple_append;
-	sbuf.len = 0;
-	sbuf.alloced = DNSTAP_INITIAL_BUF_SIZE;
+	do {
+		uint8_t byte = value & 0x7f;
 
-	/* Need to use malloc() here because protobuf uses free() */
-	sbuf.data = malloc(sbuf.alloced);
-	if (sbuf.data == NULL) {
-		return (ISC_R_NOMEMORY);
+		value >>= 7;
+		if (value != 0) {
+			byte |= 0x80;
+		}
+		if (*pp != NULL) {
+			*(*pp)++ = byte;
+		}
+		len++;
+	} while (value != 0);
+
+	return (len);
+}
+
+static size_t
+pb_tag(uint8_t **pp, unsigned int field, unsigned int wiretype) {
+	return (pb_varint(pp, (field << 3) | wiretype));
+}
+
+static size_t
+pb_uint(uint8_t **pp, unsigned int field, uint64_t value) {
+	return (pb_tag(pp, field, PB_VARINT) + pb_varint(pp, value));
+}
+
+static size_t
+pb_fixed32(uint8_t **pp, unsigned int field, uint32_t value) {
+	size_t len = pb_tag(pp, field, PB_FIXED32);
+
+	if (*pp != NULL) {
+		for (size_t i = 0; i < 4; i++) {
+			*(*pp)++ = (value >> (8 * i)) & 0xff;
+		}
 	}
-	sbuf.must_free_data = 1;
 
-	*sz = dnstap__dnstap__pack_to_buffer(d, (ProtobufCBuffer *)&sbuf);
-	if (sbuf.data == NULL) {
-		return (ISC_R_FAILURE);
+	return (len + 4);
+}
+
+static size_t
+pb_bytes(uint8_t **pp, unsigned int field, const ProtobufCBinaryData *data) {
+	size_t len = pb_tag(pp, field, PB_BYTES) + pb_varint(pp, data->len);
+
+	if (*pp != NULL && data->len != 0) {
+		memmove(*pp, data->data, data->len);
+		*pp += data->len;
 	}
-	*buf = sbuf.data;
 
-	return (ISC_R_SUCCESS);
+	return (len + data->len);
+}
+
+static size_t
+encode_message(uint8_t **pp, const Dnstap__Message *m) {
+	size_t len = pb_uint(pp, 1, m->type);
+
+	if (m->has_socket_family) {
+		len += pb_uint(pp, 2, m->socket_family);
+	}
+	if (m->has_socket_protocol) {
+		len += pb_uint(pp, 3, m->socket_protocol);
+	}
+	if (m->has_query_address) {
+		len += pb_bytes(pp, 4, &m->query_address);
+	}
+	if (m->has_response_address) {
+		len += pb_bytes(pp, 5, &m->response_address);
+	}
+	if (m->has_query_port) {
+		len += pb_uint(pp, 6, m->query_port);
+	}
+	if (m->has_response_port) {
+		len += pb_uint(pp, 7, m->response_port);
+	}
+	if (m->has_query_time_sec) {
+		len += pb_uint(pp, 8, m->query_time_sec);
+	}
+	if (m->has_query_time_nsec) {
+		len += pb_fixed32(pp, 9, m->query_time_nsec);
+	}
+	if (m->has_query_message) {
+		len += pb_bytes(pp, 10, &m->query_message);
+	}
+	if (m->has_query_zone) {
+		len += pb_bytes(pp, 11, &m->query_zone);
+	}
+	if (m->has_response_time_sec) {
+		len += pb_uint(pp, 12, m->response_time_sec);
+	}
+	if (m->has_response_time_nsec) {
+		len += pb_fixed32(pp, 13, m->response_time_nsec);
+	}
+	if (m->has_response_message) {
+		len += pb_bytes(pp, 14, &m->response_message);
+	}
+
+	return (len);
+}
+
+static size_t
+encode_dt(uint8_t **pp, const Dnstap__Dnstap *d) {
+	size_t len = 0;
+
+	if (d->has_identity) {
+		len += pb_bytes(pp, 1, &d->identity);
+	}
+	if (d->has_version) {
+		len += pb_bytes(pp, 2, &d->version);
+	}
+	if (d->message != NULL) {
+		uint8_t *nop = NULL;
+		size_t mlen = encode_message(&nop, d->message);
+
+		len += pb_tag(pp, 14, PB_BYTES) + pb_varint(pp, mlen);
+		len += encode_message(pp, d->message);
+	}
+	len += pb_uint(pp, 15, d->type);
+
+	return (len);
+}
+
+/*
+ * Find or create the frame ring of the calling thread in 'env'.
+ */
+static dt_ring_t *
+dt_ring(dns_dtenv_t *env) {
+	unsigned int generation = atomic_load_acquire(&global_generation);
+	dt_ring_t *ring = dt_thread.ring;
+
+	if (ring != NULL && dt_thread.generation == generation &&
+	    ring->env == env)
+	{
+		return (ring);
+	}
+
+	LOCK(&env->rings_lock);
+	for (ring = ISC_LIST_HEAD(env->rings); ring != NULL;
+	     ring = ISC_LIST_NEXT(ring, link))
+	{
+		if (ring->owner == &dt_thread) {
+			break;
+		}
+	}
+	if (ring == NULL) {
+		ring = isc_mem_get(env->mctx, sizeof(*ring));
+		*ring = (dt_ring_t){
+			.env = env,
+			.owner = &dt_thread,
+			.base = isc_mem_get(env->mctx, DNSTAP_RING_SIZE),
+		};
+		atomic_init(&ring->tail, 0);
+		ISC_LINK_INIT(ring, link);
+		ISC_LIST_APPEND(env->rings, ring, link);
+	}
+	UNLOCK(&env->rings_lock);
+
+	dt_thread.generation = generation;
+	dt_thread.ring = ring;
+
+	return (ring);
+}
+
+/*
+ * Allocate a frame of 'len' bytes from 'ring'.  The frame is preceded
+ * by the number of bytes it takes up in the ring, including any space
+ * that was skipped at the end of the ring to keep the frame contiguous.
+ */
+static uint8_t *
+ring_alloc(dt_ring_t *ring, size_t len, size_t *usedp) {
+	size_t pos = ring->head % DNSTAP_RING_SIZE;
+	size_t used = ISC_ALIGN(sizeof(size_t) + len, sizeof(size_t));
+	uint_fast64_t tail = atomic_load_acquire(&ring->tail);
+
+	if (pos + used > DNSTAP_RING_SIZE) {
+		used += DNSTAP_RING_SIZE - pos;
+		pos = 0;
+	}
+	if (ring->head + used - tail > DNSTAP_RING_SIZE) {
+		return (NULL);
+	}
+
+	ring->head += used;
+	memmove(ring->base + pos, &used, sizeof(used));
+	*usedp = used;
+
+	return (ring->base + pos + sizeof(size_t));
+}
+
+/*
+ * Called by the fstrm I/O thread when it is done with a frame.
+ */
+static void
+ring_release(void *buf, void *arg) {
+	dt_ring_t *ring = arg;
+	size_t used;
+
+	memmove(&used, (uint8_t *)buf - sizeof(size_t), sizeof(used));
+	atomic_fetch_add_release(&ring->tail, used);
 }
 
 static void
-send_dt(dns_dtenv_t *env, void *buf, size_t len) {
+send_dt(dns_dtenv_t *env, const Dnstap__Dnstap *d) {
 	struct fstrm_iothr_queue *ioq;
+	dt_ring_t *ring = NULL;
+	uint8_t *buf = NULL, *p = NULL;
+	size_t len, used = 0;
 	fstrm_res res;
 
 	REQUIRE(env != NULL);
 
-	if (buf == NULL) {
-		return;
-	}
-
 	ioq = dt_queue(env);
 	if (ioq == NULL) {
-		free(buf);
 		return;
 	}
 
-	res = fstrm_iothr_submit(env->iothr, ioq, buf, len, fstrm_free_wrapper,
-				 NULL);
+	len = encode_dt(&p, d);
+	if (len <= DNSTAP_FRAME_MAX) {
+		ring = dt_ring(env);
+		buf = ring_alloc(ring, len, &used);
+		if (buf == NULL) {
+			if (env->stats != NULL) {
+				isc_stats_increment(env->stats,
+						    dns_dnstapcounter_nobuffer);
+			}
+			return;
+		}
+	} else {
+		/* Need to use malloc() here because fstrm uses free() */
+		buf = malloc(len);
+		if (buf == NULL) {
+			return;
+		}
+	}
+
+	p = buf;
+	RUNTIME_CHECK(encode_dt(&p, d) == len);
+
+	if (ring != NULL) {
+		res = fstrm_iothr_submit(env->iothr, ioq, buf, len,
+					 ring_release, ring);
+	} else {
+		res = fstrm_iothr_submit(env->iothr, ioq, buf, len,
+					 fstrm_free_wrapper, NULL);
+	}
 	if (res != fstrm_res_success) {
 		if (env->stats != NULL) {
 			isc_stats_increment(env->stats, dns_dnstapcounter_drop);
 		}
-		free(buf);
+		if (ring != NULL) {
+			/* This was the most recent frame in the ring. */
+			ring->head -= used;
+		} else {
+			free(buf);
+		}
 	} else {
 		if (env->stats != NULL) {
 			isc_stats_increment(env->stats,
@@ -761,6 +1048,209 @@ unlock_and_return:
 	UNLOCK(&env->reopen_lock);
 }
 
+void
+dns_dtfilter_create(isc_mem_t *mctx, dns_dtfilter_t **filterp) {
+	dns_dtfilter_t *filter = NULL;
+
+	REQUIRE(filterp != NULL && *filterp == NULL);
+
+	filter = isc_mem_get(mctx, sizeof(*filter));
+	*filter = (dns_dtfilter_t){ .sample = 1, .magic = DTFILTER_MAGIC };
+	isc_mem_attach(mctx, &filter->mctx);
+	ISC_LIST_INIT(filter->names);
+
+	*filterp = filter;
+}
+
+void
+dns_dtfilter_destroy(dns_dtfilter_t **filterp) {
+	dns_dtfilter_t *filter = NULL;
+	dt_filtername_t *fname = NULL;
+
+	REQUIRE(filterp != NULL && VALID_DTFILTER(*filterp));
+
+	filter = *filterp;
+	*filterp = NULL;
+	filter->magic = 0;
+
+	if (filter->clients != NULL) {
+		dns_acl_detach(&filter->clients);
+	}
+	while ((fname = ISC_LIST_HEAD(filter->names)) != NULL) {
+		ISC_LIST_UNLINK(filter->names, fname, link);
+		dns_name_free(&fname->name, filter->mctx);
+		isc_mem_put(filter->mctx, fname, sizeof(*fname));
+	}
+	if (filter->types != NULL) {
+		isc_mem_put(filter->mctx, filter->types, 65536 / 8);
+	}
+
+	isc_mem_putanddetach(&filter->mctx, filter, sizeof(*filter));
+}
+
+void
+dns_dtfilter_setsample(dns_dtfilter_t *filter, uint32_t rate, bool byclient) {
+	REQUIRE(VALID_DTFILTER(filter));
+	REQUIRE(rate > 0);
+
+	filter->sample = rate;
+	filter->byclient = byclient;
+}
+
+void
+dns_dtfilter_setclients(dns_dtfilter_t *filter, dns_acl_t *acl) {
+	REQUIRE(VALID_DTFILTER(filter));
+	REQUIRE(DNS_ACL_VALID(acl));
+
+	if (filter->clients != NULL) {
+		dns_acl_detach(&filter->clients);
+	}
+	dns_acl_attach(acl, &filter->clients);
+}
+
+void
+dns_dtfilter_addname(dns_dtfilter_t *filter, const dns_name_t *name) {
+	dt_filtername_t *fname = NULL;
+
+	REQUIRE(VALID_DTFILTER(filter));
+	REQUIRE(dns_name_isabsolute(name));
+
+	fname = isc_mem_get(filter->mctx, sizeof(*fname));
+	dns_name_init(&fname->name, NULL);
+	dns_name_dup(name, filter->mctx, &fname->name);
+	ISC_LINK_INIT(fname, link);
+	ISC_LIST_APPEND(filter->names, fname, link);
+}
+
+void
+dns_dtfilter_addtype(dns_dtfilter_t *filter, dns_rdatatype_t type) {
+	REQUIRE(VALID_DTFILTER(filter));
+
+	if (filter->types == NULL) {
+		filter->types = isc_mem_get(filter->mctx, 65536 / 8);
+		memset(filter->types, 0, 65536 / 8);
+	}
+	filter->types[type / 8] |= 1 << (type % 8);
+}
+
+void
+dns_dtfilter_addrcode(dns_dtfilter_t *filter, dns_rcode_t rcode) {
+	REQUIRE(VALID_DTFILTER(filter));
+	REQUIRE(rcode < 16);
+
+	filter->rcodes |= 1 << rcode;
+}
+
+/*
+ * Check the question of the wire format message in 'r' against the
+ * names and types of 'filter'.
+ */
+static bool
+dtfilter_question(dns_dtfilter_t *filter, isc_region_t *r) {
+	isc_buffer_t source;
+	dns_fixedname_t fixed;
+	dns_name_t *qname = dns_fixedname_initname(&fixed);
+	dns_rdatatype_t qtype;
+	isc_result_t result;
+
+	/* QDCOUNT */
+	if (r->length < DNS_MESSAGE_HEADERLEN ||
+	    (r->base[4] == 0 && r->base[5] == 0))
+	{
+		return (false);
+	}
+
+	isc_buffer_init(&source, r->base, r->length);
+	isc_buffer_add(&source, r->length);
+	isc_buffer_forward(&source, DNS_MESSAGE_HEADERLEN);
+	isc_buffer_setactive(&source, r->length - DNS_MESSAGE_HEADERLEN);
+
+	result = dns_name_fromwire(qname, &source, DNS_DECOMPRESS_NEVER, 0,
+				   NULL);
+	if (result != ISC_R_SUCCESS || isc_buffer_remaininglength(&source) < 4)
+	{
+		return (false);
+	}
+	qtype = isc_buffer_getuint16(&source);
+
+	if (filter->types != NULL &&
+	    (filter->types[qtype / 8] & (1 << (qtype % 8))) == 0)
+	{
+		return (false);
+	}
+
+	if (!ISC_LIST_EMPTY(filter->names)) {
+		dt_filtername_t *fname = NULL;
+
+		for (fname = ISC_LIST_HEAD(filter->names); fname != NULL;
+		     fname = ISC_LIST_NEXT(fname, link))
+		{
+			if (dns_name_issubdomain(qname, &fname->name)) {
+				break;
+			}
+		}
+		if (fname == NULL) {
+			return (false);
+		}
+	}
+
+	return (true);
+}
+
+/*
+ * Decide whether to send a message, from its type, the query initiator
+ * address and the wire format message, before any work is done to
+ * serialize it.  The cheapest checks are made first.
+ */
+static bool
+dtfilter_match(dns_dtfilter_t *filter, dns_view_t *view,
+	       dns_dtmsgtype_t msgtype, isc_sockaddr_t *qaddr,
+	       isc_buffer_t *buf) {
+	isc_region_t r;
+
+	isc_buffer_usedregion(buf, &r);
+
+	if (filter->rcodes != 0 && (msgtype & DNS_DTTYPE_RESPONSE) != 0) {
+		if (r.length < DNS_MESSAGE_HEADERLEN ||
+		    (filter->rcodes & (1 << (r.base[3] & 0x0f))) == 0)
+		{
+			return (false);
+		}
+	}
+
+	if (filter->clients != NULL) {
+		isc_netaddr_t netaddr;
+
+		if (qaddr == NULL) {
+			return (false);
+		}
+		isc_netaddr_fromsockaddr(&netaddr, qaddr);
+		if (!dns_acl_allowed(&netaddr, NULL, filter->clients,
+				     view->aclenv))
+		{
+			return (false);
+		}
+	}
+
+	if ((filter->types != NULL || !ISC_LIST_EMPTY(filter->names)) &&
+	    !dtfilter_question(filter, &r))
+	{
+		return (false);
+	}
+
+	if (filter->sample > 1) {
+		if (filter->byclient) {
+			return (qaddr != NULL &&
+				isc_sockaddr_hash(qaddr, true) %
+						filter->sample ==
+					0);
+		}
+		return (isc_random_uniform(filter->sample) == 0);
+	}
+
+	return (true);
+}
+
 void
 dns_dt_send(dns_view_t *view, dns_dtmsgtype_t msgtype, isc_sockaddr_t *qaddr,
 	    isc_sockaddr_t *raddr, bool tcp, isc_region_t *zone,
@@ -780,6 +1270,12 @@ dns_dt_send(dns_view_t *view, dns_dtmsgtype_t msgtype, isc_sockaddr_t *qaddr,
 
 	REQUIRE(VALID_DTENV(view->dtenv));
 
+	if (view->dtfilter != NULL &&
+	    !dtfilter_match(view->dtfilter, view, msgtype, qaddr, buf))
+	{
+		return;
+	}
+
 	if (view->dtenv->max_size != 0) {
 		check_file_size_and_maybe_reopen(view->dtenv);
 	}
@@ -874,9 +1370,7 @@ dns_dt_send(dns_view_t *view, dns_dtmsgtype_t msgtype, isc_sockaddr_t *qaddr,
 			&dm.m.has_response_port);
 	}
 
-	if (pack_dt(&dm.d, &dm.buf, &dm.len) == ISC_R_SUCCESS) {
-		send_dt(view->dtenv, dm.buf, dm.len);
-	}
+	send_dt(view->dtenv, &dm.d);
 }
 
 static isc_result_t
@@ -1055,11 +1549,16 @@ dns_dt_close(dns_dthandle_t **handlep) {
 
 isc_result_t
 dns_dt_parse(isc_mem_t *mctx, isc_region_t *src, dns_dtdata_t **destp) {
+	return (dns_dt_parseframe(mctx, src, 0, destp));
+}
+
+isc_result_t
+dns_dt_parseframe(isc_mem_t *mctx, isc_region_t *src, unsigned int options,
+		  dns_dtdata_t **destp) {
 	isc_result_t result;
 	Dnstap__Dnstap *frame;
 	Dnstap__Message *m;
 	dns_dtdata_t *d = NULL;
-	isc_buffer_t b;
 
 	REQUIRE(src != NULL);
 	REQUIRE(destp != NULL && *destp == NULL);
@@ -1146,17 +1645,6 @@ dns_dt_parse(isc_mem_t *mctx, isc_region_t *src, dns_dtdata_t **destp) {
 		d->msgdata.length = m->response_message.len;
 	}
 
-	isc_buffer_init(&b, d->msgdata.base, d->msgdata.length);
-	isc_buffer_add(&b, d->msgdata.length);
-	dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE, &d->msg);
-	result = dns_message_parse(d->msg, &b, 0);
-	if (result != ISC_R_SUCCESS) {
-		if (result != DNS_R_RECOVERABLE) {
-			dns_message_detach(&d->msg);
-		}
-		result = ISC_R_SUCCESS;
-	}
-
 	/* Timestamp */
 	if (d->query) {
 		if (m->has_query_time_sec && m->has_query_time_nsec) {
@@ -1201,6 +1689,44 @@ dns_dt_parse(isc_mem_t *mctx, isc_region_t *src, dns_dtdata_t **destp) {
 		}
 	}
 
+	if ((options & DNS_DTPARSE_NOMESSAGE) == 0) {
+		CHECK(dns_dt_parsemessage(d));
+	}
+
+	*destp = d;
+
+cleanup:
+	if (result != ISC_R_SUCCESS) {
+		dns_dtdata_free(&d);
+	}
+
+	return (result);
+}
+
+isc_result_t
+dns_dt_parsemessage(dns_dtdata_t *d) {
+	isc_result_t result;
+	isc_buffer_t b;
+
+	REQUIRE(d != NULL);
+
+	if (d->msgparsed) {
+		return (ISC_R_SUCCESS);
+	}
+	d->msgparsed = true;
+
+	/* Parse DNS message */
+	isc_buffer_init(&b, d->msgdata.base, d->msgdata.length);
+	isc_buffer_add(&b, d->msgdata.length);
+	dns_message_create(d->mctx, DNS_MESSAGE_INTENTPARSE, &d->msg);
+	result = dns_message_parse(d->msg, &b, 0);
+	if (result != ISC_R_SUCCESS) {
+		if (result != DNS_R_RECOVERABLE) {
+			dns_message_detach(&d->msg);
+		}
+		result = ISC_R_SUCCESS;
+	}
+
 	/* Query tuple */
 	if (d->msg != NULL) {
 		dns_name_t *name = NULL;
@@ -1217,13 +1743,7 @@ dns_dt_parse(isc_mem_t *mctx, isc_region_t *src, dns_dtdata_t **destp) {
 				      sizeof(d->classbuf));
 	}
 
-	*destp = d;
-
 cleanup:
-	if (result != ISC_R_SUCCESS) {
-		dns_dtdata_free(&d);
-	}
-
 	return (result);
 }
 
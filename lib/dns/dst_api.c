@@ -395,6 +395,173 @@ dst_context_verify2(dst_context_t *dctx, unsigned int maxbits,
 			: dctx->key->func->verify(dctx, sig));
 }
 
+typedef struct batchitem {
+	dst_context_t *dctx;
+	isc_region_t sig;
+	isc_result_t result;
+	bool done;
+} batchitem_t;
+
+struct dst_batchverify {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	unsigned int maxbits;
+	unsigned int size;
+	unsigned int count;
+	bool run;
+	batchitem_t *items;
+};
+
+void
+dst_batchverify_create(isc_mem_t *mctx, unsigned int size,
+		       unsigned int maxbits, dst_batchverify_t **batchp) {
+	dst_batchverify_t *batch = NULL;
+
+	REQUIRE(dst_initialized);
+	REQUIRE(mctx != NULL);
+	REQUIRE(size > 0);
+	REQUIRE(batchp != NULL && *batchp == NULL);
+
+	batch = isc_mem_get(mctx, sizeof(*batch));
+	*batch = (dst_batchverify_t){ .maxbits = maxbits, .size = size };
+	isc_mem_attach(mctx, &batch->mctx);
+	batch->items = isc_mem_get(mctx, size * sizeof(batch->items[0]));
+	batch->magic = BATCH_MAGIC;
+
+	*batchp = batch;
+}
+
+void
+dst_batchverify_add(dst_batchverify_t *batch, dst_context_t **dctxp,
+		    const isc_region_t *sig) {
+	batchitem_t *item = NULL;
+
+	REQUIRE(VALID_BATCH(batch));
+	REQUIRE(!batch->run && batch->count < batch->size);
+	REQUIRE(dctxp != NULL && VALID_CTX(*dctxp));
+	REQUIRE((*dctxp)->use == DO_VERIFY);
+	REQUIRE(sig != NULL);
+
+	item = &batch->items[batch->count++];
+	*item = (batchitem_t){ .dctx = *dctxp, .result = ISC_R_UNSET };
+	*dctxp = NULL;
+
+	if (sig->length > 0) {
+		item->sig.base = isc_mem_get(batch->mctx, sig->length);
+		item->sig.length = sig->length;
+		memmove(item->sig.base, sig->base, sig->length);
+	}
+}
+
+void
+dst_batchverify_run(dst_batchverify_t *batch) {
+	dst_context_t **dctxs = NULL;
+	isc_region_t *sigs = NULL;
+	isc_result_t *results = NULL;
+	unsigned int *index = NULL;
+	unsigned int count;
+
+	REQUIRE(VALID_BATCH(batch));
+	REQUIRE(!batch->run);
+
+	batch->run = true;
+	count = batch->count;
+
+	for (unsigned int i = 0; i < count; i++) {
+		batchitem_t *item = &batch->items[i];
+		dst_func_t *func = NULL;
+		unsigned int n = 0;
+
+		if (item->done) {
+			continue;
+		}
+
+		func = item->dctx->key->func;
+		if (func->verifybatch == NULL) {
+			item->result = dst_context_verify2(
+				item->dctx, batch->maxbits, &item->sig);
+			item->done = true;
+			continue;
+		}
+
+		if (dctxs == NULL) {
+			isc_mem_t *mctx = batch->mctx;
+
+			dctxs = isc_mem_get(mctx, count * sizeof(*dctxs));
+			sigs = isc_mem_get(mctx, count * sizeof(*sigs));
+			results = isc_mem_get(mctx, count * sizeof(*results));
+			index = isc_mem_get(mctx, count * sizeof(*index));
+		}
+
+		/*
+		 * Hand all the remaining items using the same algorithm
+		 * implementation to it at once.
+		 */
+		for (unsigned int j = i; j < count; j++) {
+			batchitem_t *other = &batch->items[j];
+
+			if (!other->done && other->dctx->key->func == func) {
+				dctxs[n] = other->dctx;
+				sigs[n] = other->sig;
+				index[n++] = j;
+			}
+		}
+
+		func->verifybatch(dctxs, sigs, results, n);
+
+		for (unsigned int j = 0; j < n; j++) {
+			batch->items[index[j]].result = results[j];
+			batch->items[index[j]].done = true;
+		}
+	}
+
+	if (dctxs != NULL) {
+		isc_mem_put(batch->mctx, dctxs, count * sizeof(*dctxs));
+		isc_mem_put(batch->mctx, sigs, count * sizeof(*sigs));
+		isc_mem_put(batch->mctx, results, count * sizeof(*results));
+		isc_mem_put(batch->mctx, index, count * sizeof(*index));
+	}
+}
+
+unsigned int
+dst_batchverify_count(const dst_batchverify_t *batch) {
+	REQUIRE(VALID_BATCH(batch));
+
+	return (batch->count);
+}
+
+isc_result_t
+dst_batchverify_result(const dst_batchverify_t *batch, unsigned int i) {
+	REQUIRE(VALID_BATCH(batch));
+	REQUIRE(batch->run && i < batch->count);
+
+	return (batch->items[i].result);
+}
+
+void
+dst_batchverify_destroy(dst_batchverify_t **batchp) {
+	dst_batchverify_t *batch = NULL;
+
+	REQUIRE(batchp != NULL && VALID_BATCH(*batchp));
+
+	batch = *batchp;
+	*batchp = NULL;
+
+	batch->magic = 0;
+	for (unsigned int i = 0; i < batch->count; i++) {
+		batchitem_t *item = &batch->items[i];
+
+		dst_context_destroy(&item->dctx);
+		if (item->sig.base != NULL) {
+			isc_mem_put(batch->mctx, item->sig.base,
+				    item->sig.length);
+		}
+	}
+	isc_mem_put(batch->mctx, batch->items,
+		    batch->size * sizeof(batch->items[0]));
+	isc_mem_putanddetach(&batch->mctx, batch, sizeof(*batch));
+}
+
 isc_result_t
 dst_key_computesecret(const dst_key_t *pub, const dst_key_t *priv,
 		      isc_buffer_t *secret) {
@@ -1454,6 +1621,17 @@ dst_key_setflags(dst_key_t *key, uint32_t flags) {
 	return (computeid(key));
 }
 
+void
+dst_key_setowner(dst_key_t *key, const dns_name_t *name,
+		 dns_rdataclass_t rdclass) {
+	REQUIRE(VALID_KEY(key));
+	REQUIRE(dns_name_isabsolute(name));
+
+	dns_name_free(key->key_name, key->mctx);
+	dns_name_dup(name, key->mctx, key->key_name);
+	key->key_class = rdclass;
+}
+
 void
 dst_key_format(const dst_key_t *key, char *cp, unsigned int size) {
 	char namestr[DNS_NAME_FORMATSIZE];
@@ -54,11 +54,13 @@
 
 ISC_LANG_BEGINDECLS
 
-#define KEY_MAGIC ISC_MAGIC('D', 'S', 'T', 'K')
-#define CTX_MAGIC ISC_MAGIC('D', 'S', 'T', 'C')
+#define KEY_MAGIC   ISC_MAGIC('D', 'S', 'T', 'K')
+#define CTX_MAGIC   ISC_MAGIC('D', 'S', 'T', 'C')
+#define BATCH_MAGIC ISC_MAGIC('D', 'S', 'T', 'B')
 
-#define VALID_KEY(x) ISC_MAGIC_VALID(x, KEY_MAGIC)
-#define VALID_CTX(x) ISC_MAGIC_VALID(x, CTX_MAGIC)
+#define VALID_KEY(x)   ISC_MAGIC_VALID(x, KEY_MAGIC)
+#define VALID_CTX(x)   ISC_MAGIC_VALID(x, CTX_MAGIC)
+#define VALID_BATCH(x) ISC_MAGIC_VALID(x, BATCH_MAGIC)
 
 /***
  *** Types
@@ -188,6 +190,13 @@ struct dst_func {
 	isc_result_t (*dump)(dst_key_t *key, isc_mem_t *mctx, char **buffer,
 			     int *length);
 	isc_result_t (*restore)(dst_key_t *key, const char *keystr);
+
+	/*
+	 * Verify 'n' signatures, each in its own context, storing the
+	 * outcome of each in 'results'.
+	 */
+	void (*verifybatch)(dst_context_t **dctxs, const isc_region_t *sigs,
+			    isc_result_t *results, unsigned int n);
 };
 
 /*%
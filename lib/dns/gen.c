@@ -170,6 +170,10 @@ funname(const char *, char *);
 static void
 doswitch(const char *, const char *, const char *, const char *, const char *,
 	 const char *);
+static char *
+wiremacro(struct tt *, char *, size_t);
+static void
+dowireswitch(const char *);
 static void
 add(unsigned int, const char *, int, const char *, const char *);
 static void
@@ -263,6 +267,78 @@ funname(const char *s, char *buf) {
 	return (buf);
 }
 
+/*
+ * The name of the macro giving the wire format properties of a type,
+ * RRTYPE_<TYPE>_WIRE, or RRTYPE_<CLASS>_<TYPE>_WIRE for class-specific
+ * types.
+ */
+static char *
+wiremacro(struct tt *tt, char *buf, size_t size) {
+	char buf1[TYPECLASSBUF], buf2[TYPECLASSBUF];
+	int n;
+
+	if (tt->rdclass == 0) {
+		n = snprintf(buf, size, "RRTYPE_%s_WIRE",
+			     upper(funname(tt->typebuf, buf1)));
+	} else {
+		n = snprintf(buf, size, "RRTYPE_%s_%s_WIRE",
+			     upper(funname(tt->classbuf, buf1)),
+			     upper(funname(tt->typebuf, buf2)));
+	}
+	INSIST(n > 0 && (unsigned)n < size);
+
+	return (buf);
+}
+
+/*
+ * Emit a default of zero (nothing known) for the wire format properties
+ * of the types whose source does not define them, and a switch
+ * returning them by class and type.
+ */
+static void
+dowireswitch(const char *name) {
+	struct tt *tt;
+	int lasttype = 0;
+	int subswitch = 0;
+	char buf[TYPECLASSBUF * 2 + 20];
+
+	for (tt = types; tt != NULL; tt = tt->next) {
+		wiremacro(tt, buf, sizeof(buf));
+		printf("#ifndef %s\n#define %s 0\n#endif\n", buf, buf);
+	}
+
+	printf("\n#define %s \\\n", name);
+	printf("\tswitch (type) { \\\n" /*}*/);
+	for (tt = types; tt != NULL; tt = tt->next) {
+		if (tt->type != lasttype && subswitch) {
+			printf("\t\tdefault: break; \\\n");
+			printf("\t\t} \\\n");
+			printf("\t\tbreak; \\\n");
+			subswitch = 0;
+		}
+		if (tt->rdclass && tt->type != lasttype) {
+			printf("\tcase %d: switch (rdclass) { \\\n" /*}*/,
+			       tt->type);
+			subswitch = 1;
+		}
+		if (tt->rdclass == 0) {
+			printf("\tcase %d: return (%s); \\\n", tt->type,
+			       wiremacro(tt, buf, sizeof(buf)));
+		} else {
+			printf("\t\tcase %d: return (%s); \\\n", tt->rdclass,
+			       wiremacro(tt, buf, sizeof(buf)));
+		}
+		lasttype = tt->type;
+	}
+	if (subswitch) {
+		printf("\t\tdefault: break; \\\n");
+		printf("\t\t} \\\n");
+		printf("\t\tbreak; \\\n");
+	}
+	printf("\tdefault: break; \\\n");
+	printf("\t}\n");
+}
+
 static void
 doswitch(const char *name, const char *function, const char *args,
 	 const char *tsw, const char *csw, const char *res) {
@@ -810,6 +886,7 @@ main(int argc, char **argv) {
 			 CHECKOWNERTYPE, CHECKOWNERCLASS, CHECKOWNERDEF);
 		doswitch("CHECKNAMESSWITCH", "checknames", CHECKNAMESARGS,
 			 CHECKNAMESTYPE, CHECKNAMESCLASS, CHECKNAMESDEF);
+		dowireswitch("RDATAWIRESWITCH");
 
 		/*
 		 * From here down, we are processing the rdata names and
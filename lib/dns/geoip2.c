@@ -24,6 +24,8 @@
 #include <maxminddb.h>
 #include <netinet/in.h>
 
+#include <isc/atomic.h>
+#include <isc/hash.h>
 #include <isc/mem.h>
 #include <isc/once.h>
 #include <isc/sockaddr.h>
@@ -36,55 +38,73 @@
 #include <dns/log.h>
 
 /*
- * This structure preserves state from the previous GeoIP lookup,
- * so that successive lookups for the same data from the same IP
- * address will not require repeated database lookups.
- * This should improve performance somewhat.
+ * Each thread keeps a small cache of recent GeoIP lookups, so that
+ * evaluating several geoip ACL elements for one query, or for queries
+ * from nearby clients, does not require repeated database lookups and
+ * entry decoding.
  *
- * For all lookups we preserve pointers to the MMDB_lookup_result_s
- * and MMDB_entry_s structures, a pointer to the database from which
- * the lookup was answered, and a copy of the request address.
+ * A cached lookup is valid for every address in the network the
+ * database reported for it (the MMDB netmask), and it keeps the values
+ * decoded from the entry so far, one per subtype.  The slot is chosen by
+ * the database and the address truncated to a /24 (IPv4) or /48 (IPv6),
+ * so clients in the same network normally share a slot.
  *
- * If the next geoip ACL lookup is for the same database and from the
- * same address, we can reuse the MMDB entry without repeating the lookup.
- * This is for the case when a single query has to process multiple
- * geoip ACLs: for example, when there are multiple views with
- * match-clients statements that search for different countries.
- *
- * (XXX: Currently the persistent state is stored in thread specific
- * memory, but it could more simply be stored in the client object.
- * Also multiple entries could be stored in case the ACLs require
- * searching in more than one GeoIP database.)
+ * The entries point into the memory-mapped databases, so they must be
+ * dropped with dns_geoip_flush() before the databases are closed.
  */
+#define GEOIP_CACHE_SIZE 32
+#define GEOIP_SLOT_V4	 24
+#define GEOIP_SLOT_V6	 48
 
 typedef struct geoip_state {
-	uint16_t subtype;
 	const MMDB_s *db;
+	unsigned int generation;
 	isc_netaddr_t addr;
-	MMDB_lookup_result_s mmresult;
+	unsigned int prefixlen;
 	MMDB_entry_s entry;
+	uint64_t decoded; /* subtypes looked up in 'values' */
+	uint64_t found;	  /* subtypes present in 'values' */
+	MMDB_entry_data_s values[dns_geoip_netspeed_id + 1];
 } geoip_state_t;
 
-static thread_local geoip_state_t geoip_state = { 0 };
+static atomic_uint_fast32_t geoip_generation = 1;
+static thread_local geoip_state_t geoip_cache[GEOIP_CACHE_SIZE];
+
+void
+dns_geoip_flush(void) {
+	atomic_fetch_add_release(&geoip_generation, 1);
+}
+
+static geoip_state_t *
+get_slot(const MMDB_s *db, const isc_netaddr_t *addr) {
+	struct {
+		const MMDB_s *db;
+		unsigned char addr[GEOIP_SLOT_V6 / 8];
+	} key = { .db = db };
+
+	if (addr->family == AF_INET) {
+		memmove(key.addr, &addr->type.in, GEOIP_SLOT_V4 / 8);
+	} else {
+		memmove(key.addr, &addr->type.in6, GEOIP_SLOT_V6 / 8);
+	}
 
-static void
-set_state(const MMDB_s *db, const isc_netaddr_t *addr,
-	  MMDB_lookup_result_s mmresult, MMDB_entry_s entry) {
-	geoip_state.db = db;
-	geoip_state.addr = *addr;
-	geoip_state.mmresult = mmresult;
-	geoip_state.entry = entry;
+	return (&geoip_cache[isc_hash32(&key, sizeof(key), true) %
+			     GEOIP_CACHE_SIZE]);
 }
 
 static geoip_state_t *
 get_entry_for(MMDB_s *const db, const isc_netaddr_t *addr) {
+	geoip_state_t *state = get_slot(db, addr);
+	unsigned int generation = atomic_load_acquire(&geoip_generation);
+	unsigned int prefixlen;
 	isc_sockaddr_t sa;
 	MMDB_lookup_result_s match;
 	int err;
 
-	if (db == geoip_state.db && isc_netaddr_equal(addr, &geoip_state.addr))
+	if (state->db == db && state->generation == generation &&
+	    isc_netaddr_eqprefix(addr, &state->addr, state->prefixlen))
 	{
-		return (&geoip_state);
+		return (state);
 	}
 
 	isc_sockaddr_fromnetaddr(&sa, addr, 0);
@@ -93,9 +113,26 @@ get_entry_for(MMDB_s *const db, const isc_netaddr_t *addr) {
 		return (NULL);
 	}
 
-	set_state(db, addr, match, match.entry);
+	/*
+	 * For an IPv4 address in an IPv6 database the netmask counts
+	 * the 96 bits of the IPv4-mapped prefix.  When the network is
+	 * wider than that, only the address itself is known to share
+	 * the entry.
+	 */
+	prefixlen = match.netmask;
+	if (addr->family == AF_INET && prefixlen > 32) {
+		prefixlen = (prefixlen >= 96) ? prefixlen - 96 : 32;
+	}
 
-	return (&geoip_state);
+	*state = (geoip_state_t){
+		.db = db,
+		.generation = generation,
+		.addr = *addr,
+		.prefixlen = prefixlen,
+		.entry = match.entry,
+	};
+
+	return (state);
 }
 
 static dns_geoip_subtype_t
@@ -214,169 +251,159 @@ match_int(MMDB_entry_data_s *value, const uint32_t ui32) {
 	return (value->uint32 == ui32);
 }
 
-bool
-dns_geoip_match(const isc_netaddr_t *reqaddr,
-		const dns_geoip_databases_t *geoip,
-		const dns_geoip_elem_t *elt) {
-	MMDB_s *db = NULL;
-	MMDB_entry_data_s value;
-	geoip_state_t *state = NULL;
-	dns_geoip_subtype_t subtype;
-	const char *s = NULL;
+/*
+ * Decode the value of the entry in 'state' that 'subtype' refers to,
+ * or return the value decoded by an earlier lookup.
+ */
+static MMDB_entry_data_s *
+get_value(geoip_state_t *state, dns_geoip_subtype_t subtype) {
+	MMDB_entry_data_s *value = &state->values[subtype];
+	uint64_t bit = (uint64_t)1 << subtype;
 	int ret;
 
-	REQUIRE(reqaddr != NULL);
-	REQUIRE(elt != NULL);
-	REQUIRE(geoip != NULL);
-
-	subtype = fix_subtype(geoip, elt->subtype);
-	db = geoip2_database(geoip, subtype);
-	if (db == NULL) {
-		return (false);
-	}
-
-	state = get_entry_for(db, reqaddr);
-	if (state == NULL) {
-		return (false);
+	if ((state->decoded & bit) != 0) {
+		return (((state->found & bit) != 0) ? value : NULL);
 	}
 
 	switch (subtype) {
 	case dns_geoip_country_code:
 	case dns_geoip_city_countrycode:
-		ret = MMDB_get_value(&state->entry, &value, "country",
+		ret = MMDB_get_value(&state->entry, value, "country",
 				     "iso_code", (char *)0);
-		if (ret == MMDB_SUCCESS) {
-			return (match_string(&value, elt->as_string));
-		}
 		break;
 
 	case dns_geoip_country_name:
 	case dns_geoip_city_countryname:
-		ret = MMDB_get_value(&state->entry, &value, "country", "names",
+		ret = MMDB_get_value(&state->entry, value, "country", "names",
 				     "en", (char *)0);
-		if (ret == MMDB_SUCCESS) {
-			return (match_string(&value, elt->as_string));
-		}
 		break;
 
 	case dns_geoip_country_continentcode:
 	case dns_geoip_city_continentcode:
-		ret = MMDB_get_value(&state->entry, &value, "continent", "code",
+		ret = MMDB_get_value(&state->entry, value, "continent", "code",
 				     (char *)0);
-		if (ret == MMDB_SUCCESS) {
-			return (match_string(&value, elt->as_string));
-		}
 		break;
 
 	case dns_geoip_country_continent:
 	case dns_geoip_city_continent:
-		ret = MMDB_get_value(&state->entry, &value, "continent",
+		ret = MMDB_get_value(&state->entry, value, "continent",
 				     "names", "en", (char *)0);
-		if (ret == MMDB_SUCCESS) {
-			return (match_string(&value, elt->as_string));
-		}
 		break;
 
 	case dns_geoip_region:
 	case dns_geoip_city_region:
-		ret = MMDB_get_value(&state->entry, &value, "subdivisions", "0",
+		ret = MMDB_get_value(&state->entry, value, "subdivisions", "0",
 				     "iso_code", (char *)0);
-		if (ret == MMDB_SUCCESS) {
-			return (match_string(&value, elt->as_string));
-		}
 		break;
 
 	case dns_geoip_regionname:
 	case dns_geoip_city_regionname:
-		ret = MMDB_get_value(&state->entry, &value, "subdivisions", "0",
+		ret = MMDB_get_value(&state->entry, value, "subdivisions", "0",
 				     "names", "en", (char *)0);
-		if (ret == MMDB_SUCCESS) {
-			return (match_string(&value, elt->as_string));
-		}
 		break;
 
 	case dns_geoip_city_name:
-		ret = MMDB_get_value(&state->entry, &value, "city", "names",
+		ret = MMDB_get_value(&state->entry, value, "city", "names",
 				     "en", (char *)0);
-		if (ret == MMDB_SUCCESS) {
-			return (match_string(&value, elt->as_string));
-		}
 		break;
 
 	case dns_geoip_city_postalcode:
-		ret = MMDB_get_value(&state->entry, &value, "postal", "code",
+		ret = MMDB_get_value(&state->entry, value, "postal", "code",
 				     (char *)0);
-		if (ret == MMDB_SUCCESS) {
-			return (match_string(&value, elt->as_string));
-		}
 		break;
 
 	case dns_geoip_city_timezonecode:
-		ret = MMDB_get_value(&state->entry, &value, "location",
+		ret = MMDB_get_value(&state->entry, value, "location",
 				     "time_zone", (char *)0);
-		if (ret == MMDB_SUCCESS) {
-			return (match_string(&value, elt->as_string));
-		}
 		break;
 
 	case dns_geoip_city_metrocode:
-		ret = MMDB_get_value(&state->entry, &value, "location",
+		ret = MMDB_get_value(&state->entry, value, "location",
 				     "metro_code", (char *)0);
-		if (ret == MMDB_SUCCESS) {
-			return (match_string(&value, elt->as_string));
-		}
 		break;
 
 	case dns_geoip_isp_name:
-		ret = MMDB_get_value(&state->entry, &value, "isp", (char *)0);
-		if (ret == MMDB_SUCCESS) {
-			return (match_string(&value, elt->as_string));
-		}
+		ret = MMDB_get_value(&state->entry, value, "isp", (char *)0);
 		break;
 
 	case dns_geoip_as_asnum:
-		INSIST(elt->as_string != NULL);
-
-		ret = MMDB_get_value(&state->entry, &value,
+		ret = MMDB_get_value(&state->entry, value,
 				     "autonomous_system_number", (char *)0);
-		if (ret == MMDB_SUCCESS) {
-			int i;
-			s = elt->as_string;
-			if (strncasecmp(s, "AS", 2) == 0) {
-				s += 2;
-			}
-			i = strtol(s, NULL, 10);
-			return (match_int(&value, i));
-		}
 		break;
 
 	case dns_geoip_org_name:
-		ret = MMDB_get_value(&state->entry, &value,
+		ret = MMDB_get_value(&state->entry, value,
 				     "autonomous_system_organization",
 				     (char *)0);
-		if (ret == MMDB_SUCCESS) {
-			return (match_string(&value, elt->as_string));
-		}
 		break;
 
 	case dns_geoip_domain_name:
-		ret = MMDB_get_value(&state->entry, &value, "domain",
+		ret = MMDB_get_value(&state->entry, value, "domain",
 				     (char *)0);
-		if (ret == MMDB_SUCCESS) {
-			return (match_string(&value, elt->as_string));
-		}
 		break;
 
 	default:
 		/*
 		 * For any other subtype, we assume the database was
-		 * unavailable and return false.
+		 * unavailable.
 		 */
+		return (NULL);
+	}
+
+	state->decoded |= bit;
+	if (ret != MMDB_SUCCESS) {
+		return (NULL);
+	}
+	state->found |= bit;
+
+	return (value);
+}
+
+bool
+dns_geoip_match(const isc_netaddr_t *reqaddr,
+		const dns_geoip_databases_t *geoip,
+		const dns_geoip_elem_t *elt) {
+	MMDB_s *db = NULL;
+	MMDB_entry_data_s *value = NULL;
+	geoip_state_t *state = NULL;
+	dns_geoip_subtype_t subtype;
+	const char *s = NULL;
+
+	REQUIRE(reqaddr != NULL);
+	REQUIRE(elt != NULL);
+	REQUIRE(geoip != NULL);
+
+	subtype = fix_subtype(geoip, elt->subtype);
+	db = geoip2_database(geoip, subtype);
+	if (db == NULL) {
 		return (false);
 	}
 
-	/*
-	 * No database matched: return false.
-	 */
-	return (false);
+	state = get_entry_for(db, reqaddr);
+	if (state == NULL) {
+		return (false);
+	}
+
+	value = get_value(state, subtype);
+	if (value == NULL) {
+		/*
+		 * No database matched: return false.
+		 */
+		return (false);
+	}
+
+	if (subtype == dns_geoip_as_asnum) {
+		int i;
+
+		INSIST(elt->as_string != NULL);
+
+		s = elt->as_string;
+		if (strncasecmp(s, "AS", 2) == 0) {
+			s += 2;
+		}
+		i = strtol(s, NULL, 10);
+		return (match_int(value, i));
+	}
+
+	return (match_string(value, elt->as_string));
 }
@@ -352,6 +352,7 @@ static dst_func_t gssapi_functions = {
 	NULL, /*%< fromlabel */
 	gssapi_dump,
 	gssapi_restore,
+	NULL, /*%< verifybatch */
 };
 
 isc_result_t
@@ -652,6 +652,92 @@ out:
 	return (result);
 }
 
+/*
+ * Make 'gssapi_keytab' the keytab the acceptor credentials are taken
+ * from.
+ */
+static isc_result_t
+register_keytab(const char *gssapi_keytab) {
+#if HAVE_GSSAPI_GSSAPI_KRB5_H || HAVE_GSSAPI_KRB5_H
+	OM_uint32 gret;
+	char buf[1024];
+
+	gret = gsskrb5_register_acceptor_identity(gssapi_keytab);
+	if (gret != GSS_S_COMPLETE) {
+		gss_log(3,
+			"failed "
+			"gsskrb5_register_acceptor_identity(%s): %s",
+			gssapi_keytab,
+			gss_error_tostring(gret, 0, buf, sizeof(buf)));
+		return (DNS_R_INVALIDTKEY);
+	}
+#else
+	/*
+	 * Minimize memory leakage by only setting KRB5_KTNAME
+	 * if it needs to change.
+	 */
+	const char *old = getenv("KRB5_KTNAME");
+	if (old == NULL || strcmp(old, gssapi_keytab) != 0) {
+		size_t size;
+		char *kt;
+
+		size = strlen(gssapi_keytab) + 13;
+		kt = malloc(size);
+		if (kt == NULL) {
+			return (ISC_R_NOMEMORY);
+		}
+		snprintf(kt, size, "KRB5_KTNAME=%s", gssapi_keytab);
+		if (putenv(kt) != 0) {
+			return (ISC_R_NOMEMORY);
+		}
+	}
+#endif
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+dst_gssapi_acquirekeytab(const char *gssapi_keytab, dns_gss_cred_id_t *cred,
+			 uint32_t *lifetimep) {
+	isc_result_t result;
+	OM_uint32 gret, minor;
+	OM_uint32 lifetime;
+	char buf[1024];
+	gss_OID_set mech_oid_set;
+
+	REQUIRE(gssapi_keytab != NULL);
+	REQUIRE(cred != NULL && *cred == NULL);
+	REQUIRE(lifetimep != NULL);
+
+	result = register_keytab(gssapi_keytab);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	gret = mech_oid_set_create(&minor, &mech_oid_set);
+	if (gret != GSS_S_COMPLETE) {
+		gss_log(3, "failed to create OID_set: %s",
+			gss_error_tostring(gret, minor, buf, sizeof(buf)));
+		return (ISC_R_FAILURE);
+	}
+
+	gret = gss_acquire_cred(&minor, GSS_C_NO_NAME, GSS_C_INDEFINITE,
+				mech_oid_set, GSS_C_ACCEPT,
+				(gss_cred_id_t *)cred, NULL, &lifetime);
+	mech_oid_set_release(&mech_oid_set);
+	if (gret != GSS_S_COMPLETE) {
+		gss_log(3, "failed to acquire accept credentials from %s: %s",
+			gssapi_keytab,
+			gss_error_tostring(gret, minor, buf, sizeof(buf)));
+		return (ISC_R_FAILURE);
+	}
+
+	gss_log(4, "acquired accept credentials from %s", gssapi_keytab);
+	log_cred(*cred);
+
+	*lifetimep = lifetime;
+	return (ISC_R_SUCCESS);
+}
+
 isc_result_t
 dst_gssapi_acceptctx(dns_gss_cred_id_t cred, const char *gssapi_keytab,
 		     isc_region_t *intoken, isc_buffer_t **outtoken,
@@ -678,37 +764,10 @@ dst_gssapi_acceptctx(dns_gss_cred_id_t cred, const char *gssapi_keytab,
 	}
 
 	if (gssapi_keytab != NULL) {
-#if HAVE_GSSAPI_GSSAPI_KRB5_H || HAVE_GSSAPI_KRB5_H
-		gret = gsskrb5_register_acceptor_identity(gssapi_keytab);
-		if (gret != GSS_S_COMPLETE) {
-			gss_log(3,
-				"failed "
-				"gsskrb5_register_acceptor_identity(%s): %s",
-				gssapi_keytab,
-				gss_error_tostring(gret, 0, buf, sizeof(buf)));
-			return (DNS_R_INVALIDTKEY);
-		}
-#else
-		/*
-		 * Minimize memory leakage by only setting KRB5_KTNAME
-		 * if it needs to change.
-		 */
-		const char *old = getenv("KRB5_KTNAME");
-		if (old == NULL || strcmp(old, gssapi_keytab) != 0) {
-			size_t size;
-			char *kt;
-
-			size = strlen(gssapi_keytab) + 13;
-			kt = malloc(size);
-			if (kt == NULL) {
-				return (ISC_R_NOMEMORY);
-			}
-			snprintf(kt, size, "KRB5_KTNAME=%s", gssapi_keytab);
-			if (putenv(kt) != 0) {
-				return (ISC_R_NOMEMORY);
-			}
+		result = register_keytab(gssapi_keytab);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
 		}
-#endif
 	}
 
 	log_cred(cred);
@@ -873,6 +932,16 @@ dst_gssapi_acquirecred(const dns_name_t *name, bool initiate,
 	return (ISC_R_NOTIMPLEMENTED);
 }
 
+isc_result_t
+dst_gssapi_acquirekeytab(const char *gssapi_keytab, dns_gss_cred_id_t *cred,
+			 uint32_t *lifetimep) {
+	REQUIRE(gssapi_keytab != NULL);
+	REQUIRE(cred != NULL && *cred == NULL);
+	REQUIRE(lifetimep != NULL);
+
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
 bool
 dst_gssapi_identitymatchesrealmkrb5(const dns_name_t *signer,
 				    const dns_name_t *name,
@@ -126,6 +126,7 @@
 		NULL, /*%< fromlabel */                                        \
 		NULL, /*%< dump */                                             \
 		NULL, /*%< restore */                                          \
+		NULL, /*%< verifybatch */                                      \
 	};                                                                     \
 	isc_result_t dst__hmac##alg##_init(dst_func_t **funcp) {               \
 		REQUIRE(funcp != NULL);                                        \
@@ -140,6 +141,7 @@ hmac_fromdns(const isc_md_type_t *type, dst_key_t *key, isc_buffer_t *data);
 
 struct dst_hmac_key {
 	uint8_t key[ISC_MAX_BLOCK_SIZE];
+	isc_hmac_t *ctx; /*%< keyed once, copied for each dst context */
 };
 
 static isc_result_t
@@ -162,9 +164,11 @@ hmac_createctx(const isc_md_type_t *type, const dst_key_t *key,
 	const dst_hmac_key_t *hkey = key->keydata.hmac_key;
 	isc_hmac_t *ctx = isc_hmac_new(); /* Either returns or abort()s */
 
-	result = isc_hmac_init(ctx, hkey->key, isc_md_type_get_block_size(type),
-			       type);
+	UNUSED(type);
+
+	result = isc_hmac_copy(ctx, hkey->ctx);
 	if (result != ISC_R_SUCCESS) {
+		isc_hmac_free(ctx);
 		return (DST_R_UNSUPPORTEDALG);
 	}
 
@@ -300,6 +304,7 @@ hmac_isprivate(const dst_key_t *key) {
 static void
 hmac_destroy(dst_key_t *key) {
 	dst_hmac_key_t *hkey = key->keydata.hmac_key;
+	isc_hmac_free(hkey->ctx);
 	isc_safe_memwipe(hkey, sizeof(*hkey));
 	isc_mem_put(key->mctx, hkey, sizeof(*hkey));
 	key->keydata.hmac_key = NULL;
@@ -347,6 +352,21 @@ hmac_fromdns(const isc_md_type_t *type, dst_key_t *key, isc_buffer_t *data) {
 		keylen = r.length;
 	}
 
+	/*
+	 * Set up the key schedule once; each context created for this
+	 * key starts from a copy of it.
+	 */
+	hkey->ctx = isc_hmac_new();
+	if (isc_hmac_init(hkey->ctx, hkey->key,
+			  isc_md_type_get_block_size(type),
+			  type) != ISC_R_SUCCESS)
+	{
+		isc_hmac_free(hkey->ctx);
+		isc_safe_memwipe(hkey, sizeof(*hkey));
+		isc_mem_put(key->mctx, hkey, sizeof(dst_hmac_key_t));
+		return (DST_R_UNSUPPORTEDALG);
+	}
+
 	key->key_size = keylen * 8;
 	key->keydata.hmac_key = hkey;
 
@@ -220,6 +220,8 @@ struct dns_adbaddrinfo {
 
 	isc_sockaddr_t sockaddr; /*%< [rw] */
 	unsigned int   srtt;	 /*%< [rw] microsecs */
+	unsigned int   rttvar;	 /*%< [rw] microsecs */
+	unsigned int   failrate; /*%< [rw] see DNS_ADB_FAILRATE_ONE */
 	isc_dscp_t     dscp;
 
 	unsigned int	flags; /*%< [rw] */
@@ -250,6 +252,46 @@ struct dns_adbaddrinfo {
  * to dns_adb_createfind() can still be used until they are no longer needed.
  */
 
+/*%
+ * Per-server counters, kept for every ADB entry; see
+ * dns_adb_servercount() and dns_adb_serverstats().
+ */
+typedef enum {
+	dns_adbserver_queries = 0,   /*%< queries sent */
+	dns_adbserver_responses,     /*%< responses received */
+	dns_adbserver_timeouts,	     /*%< queries which timed out */
+	dns_adbserver_ednsfallbacks, /*%< retries without EDNS */
+	dns_adbserver_tcpretries,    /*%< retries over TCP after truncation */
+	dns_adbserver_max
+} dns_adbservercounter_t;
+
+/*%
+ * The number of buckets of the per-server RTT histogram; their upper
+ * bounds are DNS_RESOLVER_QRYRTTCLASS0 to DNS_RESOLVER_QRYRTTCLASS4
+ * milliseconds, and the last bucket has no upper bound.
+ */
+#define DNS_ADB_RTTBUCKETS 6
+
+/*%
+ * The failure rate of a server is the moving average of the share of
+ * its recent queries which timed out, where DNS_ADB_FAILRATE_ONE means
+ * all of them.
+ */
+#define DNS_ADB_FAILRATE_ONE 65536
+
+/*%
+ * A snapshot of the counters of one server.
+ */
+typedef struct dns_adbserverstats {
+	isc_sockaddr_t sockaddr;
+	unsigned int   srtt;	 /*%< microseconds */
+	unsigned int   rttvar;	 /*%< microseconds */
+	unsigned int   failrate; /*%< see DNS_ADB_FAILRATE_ONE */
+	unsigned int   inflight;
+	uint64_t       counters[dns_adbserver_max];
+	uint64_t       rtt[DNS_ADB_RTTBUCKETS];
+} dns_adbserverstats_t;
+
 /****
 **** FUNCTIONS
 ****/
@@ -463,6 +505,43 @@ dns_adb_dump(dns_adb_t *adb, FILE *f);
  *\li	f != NULL, and is a file open for writing.
  */
 
+isc_result_t
+dns_adb_save(dns_adb_t *adb, FILE *fp);
+/*%<
+ * Write what is known about the servers in the ADB -- their SRTT,
+ * EDNS and cookie flags, and UDP size -- to 'fp', one server per line,
+ * so that they can be restored with dns_adb_seed() after a restart.
+ *
+ * Requires:
+ *
+ *\li	adb is valid.
+ *
+ *\li	fp != NULL, and is a file open for writing.
+ *
+ * Returns:
+ *
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTFOUND		there was nothing to write.
+ *\li	#ISC_R_SHUTTINGDOWN	the ADB is being shut down.
+ */
+
+void
+dns_adb_seed(dns_adb_t *adb, const isc_sockaddr_t *sa, unsigned int srtt,
+	     unsigned int flags, unsigned int udpsize, isc_stdtime_t expires);
+/*%<
+ * Add an entry for the server at 'sa' with what was known about it
+ * before a restart, unless the ADB already has one.  The entry is
+ * forgotten at 'expires' (or after the usual 30 minutes, if that is
+ * sooner) unless it has been used by then; nothing is added if
+ * 'expires' is in the past.
+ *
+ * Requires:
+ *
+ *\li	adb is valid.
+ *
+ *\li	sa != NULL.
+ */
+
 isc_result_t
 dns_adb_marklame(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
 		 const dns_name_t *qname, dns_rdatatype_t type,
@@ -771,6 +850,16 @@ dns_adbentry_overquota(dns_adbentry_t *entry);
  *\li	'entry' is valid.
  */
 
+unsigned int
+dns_adbentry_inflight(dns_adbentry_t *entry);
+/*%<
+ * Returns the number of UDP queries in flight to the specified ADB
+ * entry; see dns_adb_beginudpfetch().
+ *
+ * Requires:
+ *\li	'entry' is valid.
+ */
+
 void
 dns_adb_beginudpfetch(dns_adb_t *adb, dns_adbaddrinfo_t *addr);
 void
@@ -797,6 +886,50 @@ dns_adb_getstats(dns_adb_t *adb);
  * \li 'adb' is valid.
  */
 
+void
+dns_adb_servercount(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
+		    dns_adbservercounter_t counter);
+/*%<
+ * Increment the per-server counter 'counter' of 'addr'.  Counting a
+ * timeout also raises the failure rate of the server.
+ *
+ * Requires:
+ *\li	'adb' is valid.
+ *\li	'addr' is valid.
+ *\li	'counter' is less than dns_adbserver_max.
+ */
+
+void
+dns_adb_serverrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr, unsigned int rtt);
+/*%<
+ * Count a response from 'addr' which arrived 'rtt' microseconds after
+ * the query was sent, update the mean deviation of its RTTs from its
+ * smoothed RTT, and lower its failure rate.  The smoothed RTT itself is
+ * updated by dns_adb_adjustsrtt().
+ *
+ * Requires:
+ *\li	'adb' is valid.
+ *\li	'addr' is valid.
+ */
+
+void
+dns_adb_serverstats(dns_adb_t *adb, isc_mem_t *mctx, size_t max,
+		    dns_adbserverstats_t **statsp, size_t *countp);
+/*%<
+ * Take a snapshot of the counters of at most 'max' servers which have
+ * been sent queries, choosing the servers which have been sent the most
+ * queries and sorting them in that order.  The array is allocated from
+ * 'mctx' and must be freed by the caller with
+ * isc_mem_put(mctx, *statsp, *countp * sizeof(**statsp)) when '*countp'
+ * is not zero.
+ *
+ * Requires:
+ *\li	'adb' is valid.
+ *\li	'max' is greater than zero.
+ *\li	'statsp' is not NULL and '*statsp' is NULL.
+ *\li	'countp' is not NULL.
+ */
+
 isc_result_t
 dns_adb_dumpquota(dns_adb_t *adb, isc_buffer_t **buf);
 /*%
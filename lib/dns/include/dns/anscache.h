@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*****
+***** Module Info
+*****/
+
+/*! \file dns/anscache.h
+ * \brief
+ * Defines dns_anscache_t, the rendered answer cache.
+ *
+ * Notes:
+ *\li	An answer cache holds fully rendered responses for one zone,
+ *	keyed by an opaque byte string chosen by the caller (normally
+ *	the query name, type and class plus whatever request properties
+ *	change the content of the response).  Each entry stores the
+ *	wire format of the sections following the message header,
+ *	together with the section counts and the header bits that
+ *	depend on the answer.
+ *
+ *\li	All entries belong to a single database version.  Looking up
+ *	or adding an answer for any other version misses; adding one
+ *	for a newer current version discards everything cached for
+ *	the previous one.
+ *
+ * MP:
+ *\li	All functions are thread-safe.  Entries are reference counted
+ *	and immutable, so they may be used after the cache has been
+ *	flushed.
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/refcount.h>
+
+#include <dns/message.h>
+#include <dns/types.h>
+
+/*%
+ * Upper bound on the number of answers held by one cache.  When it is
+ * reached the cache is flushed.
+ */
+#define DNS_ANSCACHE_MAXENTRIES 65536
+
+/*% Rendered answer */
+struct dns_anscacheentry {
+	unsigned int   magic;
+	isc_refcount_t references;
+	isc_mem_t     *mctx;
+	uint16_t       flags;	 /*%< Header flags set by the answer */
+	dns_rcode_t    rcode;	 /*%< Response code */
+	bool	       referral; /*%< Answer is a delegation */
+	unsigned int   counts[DNS_SECTION_MAX];
+	isc_region_t   wire; /*%< Sections following the header */
+};
+
+ISC_LANG_BEGINDECLS
+
+/***
+ ***	Functions
+ ***/
+
+void
+dns_anscache_create(isc_mem_t *mctx, dns_anscache_t **cachep);
+/*%<
+ * Allocate an empty answer cache and store it in '*cachep'.
+ *
+ * Requires:
+ * \li	'mctx' is a valid memory context.
+ * \li	'cachep' != NULL && '*cachep' == NULL.
+ */
+
+void
+dns_anscache_destroy(dns_anscache_t **cachep);
+/*%<
+ * Flush and free the answer cache in '*cachep'.  '*cachep' is set to
+ * NULL on return.
+ */
+
+void
+dns_anscache_flush(dns_anscache_t *cache);
+/*%<
+ * Discard all answers and release the database version they belong to.
+ */
+
+isc_result_t
+dns_anscache_find(dns_anscache_t *cache, dns_db_t *db,
+		  dns_dbversion_t *version, const isc_region_t *key,
+		  dns_anscacheentry_t **entryp);
+/*%<
+ * Look up the answer stored under 'key' for 'version' of 'db'.
+ *
+ * Requires:
+ * \li	'cache' is a valid answer cache.
+ * \li	'db' and 'version' are valid.
+ * \li	'entryp' != NULL && '*entryp' == NULL.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS	'*entryp' is attached to the answer.
+ * \li	#ISC_R_NOTFOUND	no answer is cached for 'key' and 'version'.
+ */
+
+void
+dns_anscache_add(dns_anscache_t *cache, dns_db_t *db, dns_dbversion_t *version,
+		 const isc_region_t *key, uint16_t flags, dns_rcode_t rcode,
+		 bool referral, const unsigned int *counts,
+		 const isc_region_t *wire);
+/*%<
+ * Store a copy of the rendered sections in 'wire' under 'key'.
+ * 'counts' holds the number of records in each of the #DNS_SECTION_MAX
+ * sections.
+ *
+ * If the cache holds answers for a different version, they are
+ * discarded first, but only when 'version' is the current version of
+ * 'db'; otherwise the answer is silently dropped.  Answers already in
+ * the cache are not replaced.
+ *
+ * Requires:
+ * \li	'cache' is a valid answer cache.
+ * \li	'db' and 'version' are valid.
+ */
+
+void
+dns_anscacheentry_detach(dns_anscacheentry_t **entryp);
+/*%<
+ * Detach from an answer returned by dns_anscache_find().
+ */
+
+ISC_LANG_ENDDECLS
@@ -29,6 +29,11 @@
  *	cache" in the resolver and for the "servfail cache" in
  *	the view.
  *
+ * MP:
+ *\li	All functions may be called from any thread.  On loop threads
+ *	dns_badcache_find() does not take any lock, and so never waits
+ *	for dns_badcache_add() or a flush.
+ *
  * Reliability:
  *
  * Resources:
@@ -173,6 +173,21 @@ dns_cache_setcachesize(dns_cache_t *cache, size_t size);
  * Set the maximum cache size.  0 means unlimited.
  */
 
+void
+dns_cache_setloop(dns_cache_t *cache, isc_loop_t *loop);
+/*%<
+ * Sets the loop from which the cache is cleaned in the background.
+ * When the cache goes over its high water mark (7/8 of the maximum
+ * size), a worker thread removes the expired entries, then the entries
+ * picked by the eviction policy, in runs of bounded length, until the
+ * cache is below its low water mark (3/4 of the maximum size).  Without
+ * a loop, the cache is only cleaned as data is added to it.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ *\li	'loop' to be a valid loop.
+ */
+
 size_t
 dns_cache_getcachesize(dns_cache_t *cache);
 /*%<
@@ -222,6 +237,138 @@ dns_cache_getservestalerefresh(dns_cache_t *cache);
  *\li	'cache' to be valid.
  */
 
+void
+dns_cache_setevictionpolicy(dns_cache_t *cache, dns_evictionpolicy_t policy);
+/*%<
+ * Sets the policy used to choose which entries to purge when the cache
+ * is over its size limit.  The setting is kept when the cache is flushed.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ */
+
+dns_evictionpolicy_t
+dns_cache_getevictionpolicy(dns_cache_t *cache);
+/*%<
+ * Gets the eviction policy set by a previous call to
+ * dns_cache_setevictionpolicy().
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ */
+
+void
+dns_cache_setsnapshotfile(dns_cache_t *cache, const char *filename);
+/*%<
+ * Sets the file that dns_cache_dumpsnapshot() writes and
+ * dns_cache_loadsnapshot() reads; NULL means there is none.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ */
+
+const char *
+dns_cache_getsnapshotfile(dns_cache_t *cache);
+/*%<
+ * Gets the snapshot file set by dns_cache_setsnapshotfile(), or NULL.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ */
+
+isc_result_t
+dns_cache_setcoldtier(dns_cache_t *cache, const char *filename,
+		      uint64_t size);
+/*%<
+ * Gives the cache a cold tier of 'size' bytes in 'filename' (see
+ * dns/coldcache.h), to which RRsets purged when the cache is over its
+ * memory limit are moved; NULL means there is none.  If this changes
+ * the cold tier, the cache is flushed.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	any error from dns_coldcache_create(), in which case the cache is
+ *	left unchanged.
+ */
+
+const char *
+dns_cache_getcoldtierfile(dns_cache_t *cache);
+
+uint64_t
+dns_cache_getcoldtiersize(dns_cache_t *cache);
+/*%<
+ * Gets the file and size of the cold tier set by
+ * dns_cache_setcoldtier(), or NULL and 0.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ */
+
+dns_sigcache_t *
+dns_cache_getsigcache(dns_cache_t *cache);
+/*%<
+ * Returns the cache of signature verification outcomes associated with
+ * 'cache'.  It is flushed along with the cache by dns_cache_flush().
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ */
+
+dns_keycache_t *
+dns_cache_getkeycache(dns_cache_t *cache);
+/*%<
+ * Returns the cache of parsed DNSKEY records associated with 'cache'.
+ * It is flushed along with the cache by dns_cache_flush().
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ */
+
+isc_result_t
+dns_cache_dumpsnapshot(dns_cache_t *cache);
+/*%<
+ * Writes the current contents of the cache, including negative
+ * entries but not stale ones, to the snapshot file in the "raw"
+ * master file format.  TTLs are stored relative to the time of the
+ * dump together with the trust level of each RRset, so the snapshot
+ * can be loaded back into a cache with dns_cache_loadsnapshot().
+ *
+ * The cache remains usable while it is being written.
+ *
+ * Requires:
+ *\li	'cache' to be valid and to have a snapshot file.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	Any error from dns_master_dump().
+ */
+
+typedef void (*dns_cache_loaddone_t)(void *arg, isc_result_t result,
+				     unsigned int count);
+
+void
+dns_cache_loadsnapshot(dns_cache_t *cache, isc_loop_t *loop,
+		       dns_cache_loaddone_t done, void *arg);
+/*%<
+ * Loads the snapshot file written by dns_cache_dumpsnapshot() into the
+ * cache.  The file is read by a worker thread while the cache is in
+ * use; data that is already in the cache is only replaced under the
+ * usual rules for adding data to a cache, and entries whose TTL has
+ * run out since the snapshot was written are dropped.
+ *
+ * When the load is complete, the outcome is logged and, unless 'done'
+ * is NULL, 'done' is called from 'loop' with 'arg', the result, and the
+ * number of RRsets that were added.  A missing snapshot file is
+ * reported as #ISC_R_FILENOTFOUND.
+ *
+ * Requires:
+ *\li	'cache' to be valid and to have a snapshot file.
+ *\li	'loop' to be a valid loop.
+ */
+
 isc_result_t
 dns_cache_flush(dns_cache_t *cache);
 /*%<
@@ -236,7 +383,8 @@ isc_result_t
 dns_cache_flushnode(dns_cache_t *cache, const dns_name_t *name, bool tree);
 /*
  * Flush a given name from the cache.  If 'tree' is true, then
- * also flush all names under 'name'.
+ * also flush all names under 'name'; with a cache database that
+ * supports dns_db_flushtree(), this takes constant time.
  *
  * Requires:
  *\li	'cache' to be valid.
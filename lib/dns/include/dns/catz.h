@@ -427,7 +427,10 @@ void
 dns_catz_update_from_db(dns_db_t *db, dns_catz_zones_t *catzs);
 /*%<
  * Process an updated database for a catalog zone.
- * It creates a new catz, iterates over database to fill it with content, and
+ * If the catalog was processed before and the zone's journal holds the
+ * changes since then, and only member zones were changed, only the nodes
+ * of those members are read and merged into the old catz.  Otherwise it
+ * creates a new catz, iterates over database to fill it with content, and
  * then merges new catz into old catz.
  *
  * Requires:
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*****
+***** Module Info
+*****/
+
+/*! \file dns/coldcache.h
+ * \brief
+ * Defines dns_coldcache_t, a second tier for a cache database, holding
+ * the RRsets purged from memory in a memory-mapped file.
+ *
+ * Notes:
+ *\li	When a cache is over its memory limit, the RRsets chosen for
+ *	purging are copied here, in their slab form, and moved back into
+ *	the cache the next time they are looked up, until their TTL runs
+ *	out.  The file is left to the operating system to page in and out,
+ *	so the tier can be much larger than the memory given to the cache.
+ *
+ *\li	The file is divided into buckets of #DNS_COLDCACHE_WAYS slots of
+ *	#DNS_COLDCACHE_SLOTSIZE bytes each.  An RRset that doesn't fit in
+ *	a slot with its owner name is not kept, and a new RRset replaces
+ *	the one of its bucket that expires first.
+ *
+ *\li	The contents are only meaningful to the process that wrote them:
+ *	the file is created empty and removed as soon as it is mapped.
+ *
+ * MP:
+ *\li	All functions are thread-safe.
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/lang.h>
+#include <isc/region.h>
+#include <isc/stdtime.h>
+
+#include <dns/types.h>
+
+/*%
+ * Size of a slot, which holds one RRset with its owner name.
+ */
+#ifndef DNS_COLDCACHE_SLOTSIZE
+#define DNS_COLDCACHE_SLOTSIZE 512
+#endif
+
+/*%
+ * Number of slots in a bucket.
+ */
+#ifndef DNS_COLDCACHE_WAYS
+#define DNS_COLDCACHE_WAYS 4
+#endif
+
+ISC_LANG_BEGINDECLS
+
+/***
+ ***	Functions
+ ***/
+
+isc_result_t
+dns_coldcache_create(isc_mem_t *mctx, const char *filename, uint64_t size,
+		     dns_coldcache_t **cachep);
+/*%<
+ * Create an empty cold tier of 'size' bytes, rounded down to a whole
+ * number of buckets, in a new file 'filename', replacing any file of
+ * that name.
+ *
+ * Requires:
+ * \li	'mctx' is a valid memory context.
+ * \li	'filename' != NULL.
+ * \li	'cachep' != NULL && '*cachep' == NULL.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_RANGE - 'size' is less than a bucket, or too large.
+ * \li	any error in creating, sizing or mapping the file.
+ */
+
+void
+dns_coldcache_attach(dns_coldcache_t *source, dns_coldcache_t **targetp);
+
+void
+dns_coldcache_detach(dns_coldcache_t **cachep);
+/*%<
+ * Attach to and detach from a cold tier.  The file is unmapped when the
+ * last reference is gone.
+ */
+
+const char *
+dns_coldcache_getfilename(dns_coldcache_t *cache);
+
+uint64_t
+dns_coldcache_getsize(dns_coldcache_t *cache);
+/*%<
+ * Return the file name and size the cold tier was created with.
+ */
+
+bool
+dns_coldcache_put(dns_coldcache_t *cache, const dns_name_t *name,
+		  dns_rdatatype_t type, dns_rdatatype_t covers,
+		  dns_trust_t trust, isc_stdtime_t expire,
+		  const unsigned char *slab, unsigned int length);
+/*%<
+ * Store a copy of the 'length' bytes of 'slab', the records of the
+ * 'name'/'type'/'covers' RRset, with its trust level and the time it
+ * expires.  A previous copy of the RRset is replaced.
+ *
+ * Returns true if the RRset was stored, false if it was too large.
+ *
+ * Requires:
+ * \li	'cache' is a valid cold tier.
+ * \li	'name' is a valid absolute name.
+ */
+
+isc_result_t
+dns_coldcache_take(dns_coldcache_t *cache, const dns_name_t *name,
+		   dns_rdatatype_t type, dns_rdatatype_t covers,
+		   isc_stdtime_t now, isc_mem_t *mctx, isc_region_t *slab,
+		   dns_trust_t *trustp, isc_stdtime_t *expirep);
+/*%<
+ * Remove the 'name'/'type'/'covers' RRset from the cold tier and, if it
+ * has not expired at 'now', copy its records into a new block of 'mctx'
+ * memory described by 'slab', to be freed by the caller, and return its
+ * trust level and expiry time.
+ *
+ * Requires:
+ * \li	'cache' is a valid cold tier.
+ * \li	'name' is a valid absolute name.
+ * \li	'slab', 'trustp' and 'expirep' are not NULL.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTFOUND
+ */
+
+void
+dns_coldcache_flush(dns_coldcache_t *cache);
+/*%<
+ * Forget every RRset in the cold tier.
+ *
+ * Requires:
+ * \li	'cache' is a valid cold tier.
+ */
+
+ISC_LANG_ENDDECLS
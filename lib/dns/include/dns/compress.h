@@ -16,6 +16,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/buffer.h>
 #include <isc/lang.h>
 #include <isc/region.h>
 
@@ -37,39 +38,36 @@ ISC_LANG_BEGINDECLS
  */
 
 /*
- * DNS_COMPRESS_TABLESIZE must be a power of 2. The compress code
- * utilizes this assumption.
- */
-#define DNS_COMPRESS_TABLEBITS	  6
-#define DNS_COMPRESS_TABLESIZE	  (1U << DNS_COMPRESS_TABLEBITS)
-#define DNS_COMPRESS_TABLEMASK	  (DNS_COMPRESS_TABLESIZE - 1)
-#define DNS_COMPRESS_INITIALNODES 24
-#define DNS_COMPRESS_ARENA_SIZE	  640
-
-typedef struct dns_compressnode dns_compressnode_t;
-
-struct dns_compressnode {
-	dns_compressnode_t *next;
-	uint16_t	    offset;
-	uint16_t	    count;
-	isc_region_t	    r;
-	dns_name_t	    name;
-};
+ * The compression table starts with DNS_COMPRESS_INITIALSIZE slots held
+ * in the context, and grows for large messages up to DNS_COMPRESS_MAXSIZE
+ * slots, which is enough for every offset a compression pointer can
+ * reach.  Both must be powers of 2.
+ */
+#define DNS_COMPRESS_INITIALSIZE 512
+#define DNS_COMPRESS_MAXSIZE	 16384
+
+/*%
+ * An offset that is not in the message.
+ */
+#define DNS_COMPRESS_NOOFFSET 0xffff
+
+typedef struct dns_compress_slot {
+	uint16_t hash;
+	uint16_t coff; /*%< offset of the suffix in the message */
+} dns_compress_slot_t;
 
 struct dns_compress {
 	unsigned int magic; /*%< Magic number. */
 	bool	     permitted;
 	bool	     disabled;
 	bool	     sensitive;
-	/*% Compression pointer table. */
-	dns_compressnode_t *table[DNS_COMPRESS_TABLESIZE];
-	/*% Preallocated arena for names. */
-	unsigned char arena[DNS_COMPRESS_ARENA_SIZE];
-	off_t	      arena_off;
-	/*% Preallocated nodes for the table. */
-	dns_compressnode_t initialnodes[DNS_COMPRESS_INITIALNODES];
-	uint16_t	   count; /*%< Number of nodes. */
-	isc_mem_t	  *mctx;  /*%< Memory context. */
+	/*% Compression table, indexed by suffix hash. */
+	dns_compress_slot_t *table;
+	unsigned int	     mask;  /*%< Number of slots - 1. */
+	unsigned int	     count; /*%< Number of slots in use. */
+	/*% Preallocated table. */
+	dns_compress_slot_t initialtable[DNS_COMPRESS_INITIALSIZE];
+	isc_mem_t	   *mctx; /*%< Memory context. */
 };
 
 enum dns_decompress {
@@ -163,13 +161,17 @@ dns_compress_getsensitive(dns_compress_t *cctx);
  */
 
 bool
-dns_compress_find(dns_compress_t *cctx, const dns_name_t *name,
-		  dns_name_t *prefix, uint16_t *offset);
+dns_compress_find(dns_compress_t *cctx, const isc_buffer_t *buffer,
+		  const dns_name_t *name, dns_name_t *prefix,
+		  uint16_t *offset);
 /*%<
- *	Finds longest possible match of 'name' in the compression table.
+ *	Finds the longest suffix of 'name' already rendered in 'buffer',
+ *	which is the message being compressed.  The time taken depends
+ *	on the number of labels in 'name', not on the size of the message.
  *
  *	Requires:
  *\li		'cctx' to be initialized.
+ *\li		'buffer' to be a valid buffer.
  *\li		'name' to be a absolute name.
  *\li		'prefix' to be initialized.
  *\li		'offset' to point to an uint16_t.
@@ -183,16 +185,18 @@ dns_compress_find(dns_compress_t *cctx, const dns_name_t *name,
 
 void
 dns_compress_add(dns_compress_t *cctx, const dns_name_t *name,
-		 const dns_name_t *prefix, uint16_t offset);
+		 const dns_name_t *prefix, uint16_t offset, uint16_t suffix);
 /*%<
- *	Add compression pointers for 'name' to the compression table,
- *	not replacing existing pointers.
+ *	Add the suffixes of 'name' that begin in 'prefix' to the
+ *	compression table, 'prefix' having been rendered at 'offset'.
+ *	'suffix' is the offset that the compression pointer written
+ *	after 'prefix' points to, or #DNS_COMPRESS_NOOFFSET if the
+ *	whole name was rendered.
  *
  *	Requires:
  *\li		'cctx' initialized
  *
- *\li		'name' must be initialized and absolute, and must remain
- *		valid until the message compression is complete.
+ *\li		'name' must be initialized and absolute.
  *
  *\li		'prefix' must be a prefix returned by
  *		dns_compress_find(), or the same as 'name'.
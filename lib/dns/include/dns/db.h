@@ -185,6 +185,19 @@ typedef struct dns_dbmethods {
 	isc_result_t (*setservestalerefresh)(dns_db_t *db, uint32_t interval);
 	isc_result_t (*getservestalerefresh)(dns_db_t *db, uint32_t *interval);
 	isc_result_t (*setgluecachestats)(dns_db_t *db, isc_stats_t *stats);
+	isc_result_t (*setevictionpolicy)(dns_db_t	       *db,
+					  dns_evictionpolicy_t policy);
+	isc_result_t (*getmemory)(dns_db_t *db, dns_dbmemory_t *memory);
+	unsigned int (*expire)(dns_db_t *db, isc_stdtime_t now, bool overmem,
+			       unsigned int budget);
+	isc_result_t (*setcoldtier)(dns_db_t *db, dns_coldcache_t *coldtier);
+	isc_result_t (*flushtree)(dns_db_t *db, const dns_name_t *name);
+	isc_result_t (*nsec3hashname)(dns_db_t *db, dns_fixedname_t *result,
+				      const dns_name_t *name,
+				      dns_hash_t hashalg,
+				      unsigned int iterations,
+				      const unsigned char *salt,
+				      size_t saltlength);
 } dns_dbmethods_t;
 
 typedef isc_result_t (*dns_dbcreatefunc_t)(isc_mem_t	    *mctx,
@@ -229,6 +242,15 @@ struct dns_dbonupdatelistener {
 };
 
 /*@{*/
+/*%
+ * The memory used by a database, in bytes (see dns_db_getmemory()).
+ */
+struct dns_dbmemory {
+	size_t nodes; /*%< tree nodes, owner names and hash tables */
+	size_t rdata; /*%< rdataset headers and rdata slabs */
+	size_t glue;  /*%< precomputed delegation glue */
+};
+
 /*%
  * Options that can be specified for dns_db_find().
  */
@@ -1746,4 +1768,116 @@ dns_db_setgluecachestats(dns_db_t *db, isc_stats_t *stats);
  *	dns_rdatasetstats_create(); otherwise NULL.
  */
 
+isc_result_t
+dns_db_setevictionpolicy(dns_db_t *db, dns_evictionpolicy_t policy);
+/*%<
+ * Sets the policy used to choose which entries to purge when the cache
+ * is over its memory limit.  The default is #dns_evictionpolicy_lru.
+ *
+ * Requires:
+ * \li	'db' is a valid cache database.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTIMPLEMENTED - Not supported by this DB implementation.
+ */
+
+isc_result_t
+dns_db_getmemory(dns_db_t *db, dns_dbmemory_t *memory);
+/*%<
+ * Get the number of bytes currently allocated for the data in 'db',
+ * split into the categories of #dns_dbmemory_t.  The counters are kept
+ * by the database as it allocates and frees memory, so this is cheap
+ * to call for many databases; unlike isc_mem_inuse(), the result does
+ * not include memory from other databases sharing the memory context.
+ *
+ * Requires:
+ * \li	'db' is a valid database.
+ * \li	'memory' is not NULL.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTIMPLEMENTED - Not supported by this DB implementation.
+ */
+
+isc_result_t
+dns_db_expire(dns_db_t *db, isc_stdtime_t now, bool overmem,
+	      unsigned int budget, unsigned int *removedp);
+/*%<
+ * Remove up to 'budget' entries from the cache database 'db': those
+ * that have expired at 'now' and, if 'overmem' is true, as many others
+ * as needed, chosen by the eviction policy of the cache.  The number of
+ * entries removed is stored in '*removedp'.
+ *
+ * Unlike dns_db_expirenode(), this works from the index the database
+ * keeps of the entries by expiry time, so it doesn't have to go through
+ * all of the nodes, and can be called from any thread.
+ *
+ * Requires:
+ * \li	'db' is a valid cache database.
+ * \li	'removedp' is not NULL.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTIMPLEMENTED - Not supported by this DB implementation.
+ */
+
+isc_result_t
+dns_db_setcoldtier(dns_db_t *db, dns_coldcache_t *coldtier);
+/*%<
+ * Sets the cold tier (see dns/coldcache.h) to which the cache database
+ * 'db' moves the entries it purges when it is over its memory limit,
+ * and from which it takes them back when they are looked up.  This can
+ * only be done once, before the database is used.
+ *
+ * Requires:
+ * \li	'db' is a valid cache database.
+ * \li	'coldtier' is a valid cold tier.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTIMPLEMENTED - Not supported by this DB implementation.
+ */
+
+isc_result_t
+dns_db_flushtree(dns_db_t *db, const dns_name_t *name);
+/*%<
+ * Flush 'name' and all the names below it from the cache database 'db'
+ * in constant time: the RRsets cached so far at and below 'name' are
+ * no longer found, and are reclaimed as they are next looked at, added
+ * to or expired.
+ *
+ * Requires:
+ * \li	'db' is a valid cache database.
+ * \li	'name' is a valid absolute name.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_QUOTA - Too many flushes are still in effect.
+ * \li	#ISC_R_NOTIMPLEMENTED - Not supported by this DB implementation.
+ */
+
+isc_result_t
+dns_db_nsec3hashname(dns_db_t *db, dns_fixedname_t *result,
+		     const dns_name_t *name, dns_hash_t hashalg,
+		     unsigned int iterations, const unsigned char *salt,
+		     size_t saltlength);
+/*%<
+ * Make the NSEC3 owner name of 'name' in the zone database 'db', as
+ * dns_nsec3_hashname() does with the origin of 'db'.  The database may
+ * keep the hashes it made (see dns/nsec3cache.h), so that the names
+ * needed again and again to prove that names do not exist, such as
+ * their closest enclosers, are not hashed again every time.
+ *
+ * Requires:
+ * \li	'db' is a valid zone database.
+ * \li	'result' != NULL.
+ * \li	'name' is a valid name.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#DNS_R_BADALG - 'hashalg' is not supported.
+ * \li	any error in making the name.
+ */
+
 ISC_LANG_ENDDECLS
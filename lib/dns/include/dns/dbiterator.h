@@ -59,6 +59,7 @@
 #include <isc/lang.h>
 #include <isc/magic.h>
 
+#include <dns/fixedname.h>
 #include <dns/types.h>
 
 ISC_LANG_BEGINDECLS
@@ -79,6 +80,8 @@ typedef struct dns_dbiteratormethods {
 				dns_dbnode_t **nodep, dns_name_t *name);
 	isc_result_t (*pause)(dns_dbiterator_t *iterator);
 	isc_result_t (*origin)(dns_dbiterator_t *iterator, dns_name_t *name);
+	isc_result_t (*currentbatch)(dns_dbiterator_t	  *iterator,
+				     dns_dbiteratorbatch_t *batch);
 } dns_dbiteratormethods_t;
 
 #define DNS_DBITERATOR_MAGIC	  ISC_MAGIC('D', 'N', 'S', 'I')
@@ -102,6 +105,31 @@ struct dns_dbiterator {
 	bool			 cleaning;
 };
 
+/*%
+ * The number of nodes returned at most by dns_dbiterator_currentbatch().
+ */
+#ifndef DNS_DBITERATOR_BATCHSIZE
+#define DNS_DBITERATOR_BATCHSIZE 64
+#endif
+
+/*%
+ * A run of consecutive nodes, filled in by dns_dbiterator_currentbatch().
+ *
+ * 'nodes[i]' and 'names[i]' are the i-th node and its name, for 'i' less
+ * than 'count'.  If the iterator was created with 'relative_names' set to
+ * true, 'neworigin[i]' is true when the origin 'names[i]' is relative to
+ * has changed, and the new origin is then in 'origins[i]'.
+ *
+ * The structure is large; callers should not allocate it on the stack.
+ */
+struct dns_dbiteratorbatch {
+	unsigned int	count;
+	dns_dbnode_t   *nodes[DNS_DBITERATOR_BATCHSIZE];
+	dns_fixedname_t names[DNS_DBITERATOR_BATCHSIZE];
+	bool		neworigin[DNS_DBITERATOR_BATCHSIZE];
+	dns_fixedname_t origins[DNS_DBITERATOR_BATCHSIZE];
+};
+
 void
 dns_dbiterator_destroy(dns_dbiterator_t **iteratorp);
 /*%<
@@ -275,6 +303,55 @@ dns_dbiterator_origin(dns_dbiterator_t *iterator, dns_name_t *name);
  *\li	Other results are possible, depending on the DB implementation.
  */
 
+isc_result_t
+dns_dbiterator_currentbatch(dns_dbiterator_t	  *iterator,
+			    dns_dbiteratorbatch_t *batch);
+/*%<
+ * Return the current node and up to #DNS_DBITERATOR_BATCHSIZE - 1 nodes
+ * following it in 'batch', move the node cursor to the first node not
+ * returned, and pause the iterator.
+ *
+ * This is equivalent to as many calls to dns_dbiterator_current() and
+ * dns_dbiterator_next() followed by dns_dbiterator_pause(), but lets the
+ * DB implementation take its locks once for the whole batch instead of
+ * once for each node.
+ *
+ * Notes:
+ *\li	The caller must call dns_db_detachnode() on the 'batch->count'
+ *	nodes returned, or dns_dbiterator_releasebatch(), whatever the
+ *	result.
+ *
+ * Requires:
+ *\li	'iterator' is a valid iterator.
+ *
+ *\li	'batch' != NULL.
+ *
+ *\li	The node cursor of 'iterator' is at a valid location (i.e. the
+ *	result of last call to a cursor movement command was ISC_R_SUCCESS).
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS			The node cursor is at the
+ *					node following the batch.
+ *\li	#ISC_R_NOMORE			The batch holds the last nodes
+ *					of the database.
+ *
+ *\li	Other results are possible, depending on the DB implementation.
+ */
+
+void
+dns_dbiterator_releasebatch(dns_dbiterator_t	  *iterator,
+			    dns_dbiteratorbatch_t *batch);
+/*%<
+ * Detach the nodes of 'batch' that the caller has not already detached,
+ * and empty it.
+ *
+ * Requires:
+ *\li	'iterator' is a valid iterator.
+ *
+ *\li	'batch' was filled in by dns_dbiterator_currentbatch() on
+ *	'iterator'.
+ */
+
 void
 dns_dbiterator_setcleanmode(dns_dbiterator_t *iterator, bool mode);
 /*%<
@@ -49,6 +49,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/atomic.h>
 #include <isc/buffer.h>
 #include <isc/lang.h>
 #include <isc/mutex.h>
@@ -64,11 +65,10 @@ ISC_LANG_BEGINDECLS
  * round-robin fashion.
  */
 struct dns_dispatchset {
-	isc_mem_t	*mctx;
-	dns_dispatch_t **dispatches;
-	int		 ndisp;
-	int		 cur;
-	isc_mutex_t	 lock;
+	isc_mem_t	    *mctx;
+	dns_dispatch_t	   **dispatches;
+	int		     ndisp;
+	atomic_uint_fast32_t cur;
 };
 
 /*
@@ -165,6 +165,23 @@ dns_dispatchmgr_setstats(dns_dispatchmgr_t *mgr, isc_stats_t *stats);
  *	(see dns/stats.h).
  */
 
+void
+dns_dispatchmgr_setidle(dns_dispatchmgr_t *mgr, unsigned int max,
+			unsigned int timeout);
+/*%<
+ * Configure the pool of idle outgoing TCP connections.  When the last
+ * query on a connected TCP dispatch is done, up to 'max' such
+ * dispatches are kept open for 'timeout' milliseconds so that
+ * dns_dispatch_gettcp() can reuse them instead of connecting again;
+ * the connection that has been idle longest is closed when the pool
+ * is full.  A 'max' of zero disables the pool and closes the idle
+ * connections in it.
+ *
+ * Requires:
+ *\li	mgr is a valid dispatchmgr.
+ *\li	timeout is non-zero if max is non-zero.
+ */
+
 isc_result_t
 dns_dispatch_createudp(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *localaddr,
 		       dns_dispatch_t **dispp);
@@ -257,7 +274,8 @@ dns_dispatch_gettcp(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *destaddr,
 		    dns_dispatch_t **dispp);
 /*
  * Attempt to connect to a existing TCP connection (connection completed
- * if connected == NULL).
+ * if connected == NULL).  Connections in the idle pool (see
+ * dns_dispatchmgr_setidle()) are taken out of it.
  */
 
 typedef void (*dispatch_cb_t)(isc_result_t eresult, isc_region_t *region,
@@ -90,6 +90,16 @@ typedef isc_result_t
 dlz_dlopen_allnodes_t(const char *zone, void *dbdata,
 		      dns_sdlzallnodes_t *allnodes);
 
+/*
+ * dlz_dlopen_allnodes_from() is optional.  It can be supplied instead
+ * of dlz_dlopen_allnodes() to return the nodes of a zone in chunks of
+ * 'maxnodes' names, in DNSSEC canonical order, starting at 'start'
+ */
+typedef isc_result_t
+dlz_dlopen_allnodes_from_t(const char *zone, const char *start,
+			   unsigned int maxnodes, void *dbdata,
+			   dns_sdlzallnodes_t *allnodes);
+
 /*
  * dlz_dlopen_newversion() is optional. It should be supplied if you
  * want to support dynamic updates.
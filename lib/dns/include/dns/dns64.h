@@ -127,6 +127,43 @@ dns_dns64_aaaafroma(const dns_dns64_t *dns64, const isc_netaddr_t *reqaddr,
  *	DNS_R_DISALLOWED	if there is no match.
  */
 
+bool
+dns_dns64_clientok(const dns_dns64_t *dns64, const isc_netaddr_t *reqaddr,
+		   const dns_name_t *reqsigner, dns_aclenv_t *env,
+		   unsigned int flags);
+/*
+ * Return true if 'dns64' applies to queries from 'reqaddr' and
+ * 'reqsigner' with 'flags', i.e. the checks of dns_dns64_aaaafroma()
+ * that do not depend on the A record pass.  This only needs to be
+ * called once per query, before dns_dns64_synthesize() is called for
+ * each A record.
+ *
+ * Requires:
+ *	'dns64'		to be valid.
+ *	'reqaddr'	to be valid.
+ *	'reqsigner'	to be NULL or valid.
+ *	'env'		to be valid.
+ */
+
+isc_result_t
+dns_dns64_synthesize(const dns_dns64_t *dns64, dns_aclenv_t *env,
+		     const unsigned char *a, unsigned char *aaaa);
+/*
+ * Perform the address synthesis of dns_dns64_aaaafroma() for a query
+ * dns_dns64_clientok() accepted: write the AAAA address made from 'a'
+ * to '*aaaa', unless 'a' is not one of the mapped addresses of 'dns64'.
+ *
+ * Requires:
+ *	'dns64'		to be valid.
+ *	'env'		to be valid.
+ *	'a'		to point to a IPv4 address in network order.
+ *	'aaaa'		to point to a IPv6 address buffer in network order.
+ *
+ * Returns:
+ *	ISC_R_SUCCESS		if synthesis was performed.
+ *	DNS_R_DISALLOWED	if 'a' is not mapped.
+ */
+
 dns_dns64_t *
 dns_dns64_next(dns_dns64_t *dns64);
 /*
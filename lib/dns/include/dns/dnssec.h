@@ -159,6 +159,27 @@ dns_dnssec_verify(const dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
  *\li		DST_R_*
  */
 
+void
+dns_dnssec_verifybatch(const dns_name_t *name, dns_rdataset_t *set,
+		       dst_key_t **keys, dns_rdata_t *sigrdatas, unsigned int n,
+		       bool ignoretime, unsigned int maxbits, isc_mem_t *mctx,
+		       isc_result_t *results);
+/*%<
+ *	Verifies 'n' RRSIG records covering this rdataset, 'sigrdatas[i]'
+ *	with 'keys[i]', and stores in 'results[i]' what dns_dnssec_verify()
+ *	would have returned for it.  The signatures are verified together
+ *	with dst_batchverify_run(), which is cheaper than verifying them
+ *	one at a time for some algorithms.
+ *
+ *	Requires:
+ *\li		'name' (the owner name of the record) is a valid name
+ *\li		'set' is a valid rdataset
+ *\li		'keys' and 'sigrdatas' are arrays of 'n' valid keys and
+ *			RRSIG records
+ *\li		'mctx' is not NULL
+ *\li		'results' is an array of 'n' results
+ */
+
 /*@{*/
 isc_result_t
 dns_dnssec_findzonekeys(dns_db_t *db, dns_dbversion_t *ver, dns_dbnode_t *node,
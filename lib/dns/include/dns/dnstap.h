@@ -79,6 +79,11 @@ struct fstrm_iothr_options;
 	 DNS_DTTYPE_FR | DNS_DTTYPE_TR | DNS_DTTYPE_UR)
 #define DNS_DTTYPE_ALL (DNS_DTTYPE_QUERY | DNS_DTTYPE_RESPONSE)
 
+/*%
+ * Options for dns_dt_parseframe().
+ */
+#define DNS_DTPARSE_NOMESSAGE 0x0001 /*%< don't parse the DNS message */
+
 typedef enum {
 	dns_dtmode_none = 0,
 	dns_dtmode_file,
@@ -108,6 +113,7 @@ struct dns_dtdata {
 
 	isc_region_t   msgdata;
 	dns_message_t *msg;
+	bool	       msgparsed;
 
 	char namebuf[DNS_NAME_FORMATSIZE];
 	char typebuf[DNS_RDATATYPE_FORMATSIZE];
@@ -260,13 +266,104 @@ dns_dt_getstats(dns_dtenv_t *env, isc_stats_t **statsp);
  *\li	ISC_R_NOTFOUND
  */
 
+void
+dns_dtfilter_create(isc_mem_t *mctx, dns_dtfilter_t **filterp);
+/*%<
+ * Create a filter that selects which of the dnstap messages of a view
+ * are sent.  A new filter passes all messages.
+ *
+ * Requires:
+ *
+ *\li	'mctx' is a valid memory context.
+ *
+ *\li	'filterp' is not NULL and '*filterp' is NULL.
+ */
+
+void
+dns_dtfilter_destroy(dns_dtfilter_t **filterp);
+/*%<
+ * Destroy a filter.
+ *
+ * Requires:
+ *
+ *\li	'filterp' is not NULL and '*filterp' is a valid filter.
+ */
+
+void
+dns_dtfilter_setsample(dns_dtfilter_t *filter, uint32_t rate, bool byclient);
+/*%<
+ * Only send one in 'rate' of the messages that pass the other criteria.
+ * If 'byclient' is true, the messages are selected by a hash of the
+ * query initiator's address, so that either all or none of the messages
+ * of a client are sent; otherwise they are selected at random.
+ *
+ * Requires:
+ *
+ *\li	'filter' is a valid filter.
+ *
+ *\li	'rate' is greater than zero.
+ */
+
+void
+dns_dtfilter_setclients(dns_dtfilter_t *filter, dns_acl_t *acl);
+/*%<
+ * Only send messages whose query initiator address is allowed by 'acl'.
+ *
+ * Requires:
+ *
+ *\li	'filter' is a valid filter.
+ *
+ *\li	'acl' is a valid ACL.
+ */
+
+void
+dns_dtfilter_addname(dns_dtfilter_t *filter, const dns_name_t *name);
+/*%<
+ * Send messages whose question name is at or below 'name'.  Once a name
+ * has been added, messages for names below none of the added names are
+ * not sent.
+ *
+ * Requires:
+ *
+ *\li	'filter' is a valid filter.
+ *
+ *\li	'name' is a valid absolute name.
+ */
+
+void
+dns_dtfilter_addtype(dns_dtfilter_t *filter, dns_rdatatype_t type);
+/*%<
+ * Send messages whose question type is 'type'.  Once a type has been
+ * added, messages for other types are not sent.
+ *
+ * Requires:
+ *
+ *\li	'filter' is a valid filter.
+ */
+
+void
+dns_dtfilter_addrcode(dns_dtfilter_t *filter, dns_rcode_t rcode);
+/*%<
+ * Send responses with the rcode 'rcode' in their header.  Once an rcode
+ * has been added, responses with other rcodes are not sent; queries are
+ * not affected.
+ *
+ * Requires:
+ *
+ *\li	'filter' is a valid filter.
+ *
+ *\li	'rcode' fits in the four bits of the message header.
+ */
+
 void
 dns_dt_send(dns_view_t *view, dns_dtmsgtype_t msgtype, isc_sockaddr_t *qaddr,
 	    isc_sockaddr_t *dstaddr, bool tcp, isc_region_t *zone,
 	    isc_time_t *qtime, isc_time_t *rtime, isc_buffer_t *buf);
 /*%<
  * Sends a dnstap message to the log, if 'msgtype' is one of the message
- * types represented in 'view->dttypes'.
+ * types represented in 'view->dttypes' and the message passes the
+ * view's filter, 'view->dtfilter', if it has one.  The filter is applied
+ * before the message is serialized.
  *
  * Parameters are: 'qaddr' (query address, i.e, the address of the
  * query initiator); 'raddr' (response address, i.e., the address of
@@ -299,6 +396,46 @@ dns_dt_parse(isc_mem_t *mctx, isc_region_t *src, dns_dtdata_t **destp);
  *\li	Other errors are possible.
  */
 
+isc_result_t
+dns_dt_parseframe(isc_mem_t *mctx, isc_region_t *src, unsigned int options,
+		  dns_dtdata_t **destp);
+/*%<
+ * Like dns_dt_parse(), but if 'options' includes DNS_DTPARSE_NOMESSAGE,
+ * the DNS message in the frame is not parsed: '(*destp)->msg' is left
+ * NULL and the query tuple buffers empty until dns_dt_parsemessage() is
+ * called.  This saves most of the cost of decoding frames that are
+ * only inspected through their dnstap fields.
+ *
+ * Requires:
+ *\li	'src' is not NULL
+ *
+ *\li	'destp' is not NULL and '*destp' is NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS on success
+ *
+ *\li	Other errors are possible.
+ */
+
+isc_result_t
+dns_dt_parsemessage(dns_dtdata_t *d);
+/*%<
+ * Parse the DNS message of a frame decoded by dns_dt_parseframe()
+ * with DNS_DTPARSE_NOMESSAGE, setting 'd->msg' and the query tuple
+ * buffers.  Does nothing if the message has already been parsed.
+ *
+ * As with dns_dt_parse(), a message that cannot be parsed leaves
+ * 'd->msg' NULL without failing.
+ *
+ * Requires:
+ *\li	'd' is not NULL
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS on success
+ *
+ *\li	Other errors are possible.
+ */
+
 isc_result_t
 dns_dt_datatotext(dns_dtdata_t *d, isc_buffer_t **dest);
 /*%<
@@ -83,3 +83,4 @@
 #define DNS_EVENT_ZONEFLUSH	    (ISC_EVENTCLASS_DNS + 60)
 #define DNS_EVENT_CHECKDSSENDTOADDR (ISC_EVENTCLASS_DNS + 61)
 #define DNS_EVENT_CACHESHUTDOWN	    (ISC_EVENTCLASS_DNS + 62)
+#define DNS_EVENT_ZONEJOURNALSYNC   (ISC_EVENTCLASS_DNS + 63)
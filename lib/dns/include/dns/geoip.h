@@ -106,6 +106,13 @@ dns_geoip_match(const isc_netaddr_t	    *reqaddr,
 		const dns_geoip_databases_t *geoip,
 		const dns_geoip_elem_t	    *elt);
 
+void
+dns_geoip_flush(void);
+/*%<
+ * Invalidate the lookup results cached by dns_geoip_match() in all
+ * threads.  Must be called before the GeoIP2 databases are closed.
+ */
+
 ISC_LANG_ENDDECLS
 
 #endif /* HAVE_GEOIP2 */
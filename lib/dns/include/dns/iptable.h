@@ -23,10 +23,11 @@
 #include <dns/types.h>
 
 struct dns_iptable {
-	unsigned int	  magic;
-	isc_mem_t	 *mctx;
-	isc_refcount_t	  refcount;
-	isc_radix_tree_t *radix;
+	unsigned int	      magic;
+	isc_mem_t	     *mctx;
+	isc_refcount_t	      refcount;
+	isc_radix_tree_t     *radix;
+	isc_radix_compiled_t *compiled;
 	ISC_LINK(dns_iptable_t) nextincache;
 };
 
@@ -58,6 +59,22 @@ dns_iptable_merge(dns_iptable_t *tab, dns_iptable_t *source, bool pos);
  * Merge one IP table into another one.
  */
 
+void
+dns_iptable_compile(dns_iptable_t *tab);
+/*
+ * Compile the radix tree of an IP table into an immutable trie that
+ * is used for matching addresses until the table is changed again;
+ * adding or merging prefixes discards it.
+ */
+
+isc_result_t
+dns_iptable_search(dns_iptable_t *tab, const isc_prefix_t *prefix,
+		   isc_radix_node_t **target);
+/*
+ * Find the first match for the host address 'prefix' in an IP table,
+ * in the compiled trie if there is one or else in the radix tree.
+ */
+
 void
 dns_iptable_attach(dns_iptable_t *source, dns_iptable_t **target);
 
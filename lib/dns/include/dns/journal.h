@@ -42,9 +42,10 @@
  ***/
 #define DNS_JOURNALOPT_RESIGN 0x00000001
 
-#define DNS_JOURNAL_READ   0x00000000 /* false */
-#define DNS_JOURNAL_CREATE 0x00000001 /* true */
-#define DNS_JOURNAL_WRITE  0x00000002
+#define DNS_JOURNAL_READ      0x00000000 /* false */
+#define DNS_JOURNAL_CREATE    0x00000001 /* true */
+#define DNS_JOURNAL_WRITE     0x00000002
+#define DNS_JOURNAL_DEFERSYNC 0x00000004
 
 #define DNS_JOURNAL_SIZE_MAX INT32_MAX
 #define DNS_JOURNAL_SIZE_MIN 4096
@@ -71,6 +72,12 @@
  */
 typedef struct dns_journal dns_journal_t;
 
+/*%
+ * A dns_journalcompact_t compacts a journal in the background: see
+ * dns_journal_compact_create().  This is an opaque type.
+ */
+typedef struct dns_journalcompact dns_journalcompact_t;
+
 /***
  *** Functions
  ***/
@@ -112,6 +119,10 @@ dns_journal_open(isc_mem_t *mctx, const char *filename, unsigned int mode,
  * the journal if it does not exist.
  * DNS_JOURNAL_WRITE open the journal for reading and writing.
  * DNS_JOURNAL_READ open the journal for reading only.
+ *
+ * If DNS_JOURNAL_DEFERSYNC is also set, committed transactions are
+ * not written to stable storage, and the journal header on disk does
+ * not cover them, until dns_journal_sync() is called.
  */
 
 void
@@ -161,6 +172,19 @@ dns_journal_commit(dns_journal_t *j);
  *      sequence.
  */
 
+isc_result_t
+dns_journal_sync(dns_journal_t *j);
+/*%<
+ * Write the transactions committed to the journal file 'j' since it
+ * was opened with DNS_JOURNAL_DEFERSYNC, or since the last call, to
+ * stable storage, followed by a journal header covering them.  Until
+ * then, those transactions are invisible to other readers of the file
+ * and are lost if 'j' is destroyed.
+ *
+ * Requires:
+ * \li     'j' is open for writing.
+ */
+
 isc_result_t
 dns_journal_write_transaction(dns_journal_t *j, dns_diff_t *diff);
 /*%
@@ -202,6 +226,13 @@ dns_journal_last_serial(dns_journal_t *j);
  * Get the first and last addressable serial number in the journal.
  */
 
+size_t
+dns_journal_inuse(dns_journal_t *j);
+/*%<
+ * Get the number of bytes of memory used by the open journal 'j',
+ * including its in-memory transaction index.
+ */
+
 isc_result_t
 dns_journal_iter_init(dns_journal_t *j, uint32_t begin_serial,
 		      uint32_t end_serial, size_t *xfrsizep);
@@ -281,6 +312,47 @@ dns_journal_print(isc_mem_t *mctx, uint32_t flags, const char *filename,
 		  FILE *file);
 /* For debugging not general use */
 
+isc_result_t
+dns_journal_printselect(isc_mem_t *mctx, uint32_t flags, const char *filename,
+			const uint32_t *beginp, const uint32_t *endp,
+			const dns_name_t *name, FILE *file);
+/*%<
+ * Like dns_journal_print(), but only print the transactions from serial
+ * '*beginp' to serial '*endp' (the first and last serials of the journal
+ * if NULL), and if 'name' is not NULL, only the changes to that owner
+ * name.
+ *
+ * When selecting by name, transactions known from the sidecar index
+ * written by dns_journal_writeindex() not to change 'name' are skipped
+ * without being read.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS
+ *\li	DNS_R_NOJOURNAL if the journal does not exist
+ *\li	ISC_R_RANGE if the serials are not in the journal
+ *\li	Other errors are possible.
+ */
+
+isc_result_t
+dns_journal_writeindex(isc_mem_t *mctx, const char *filename);
+/*%<
+ * Write or update the sidecar index of the journal 'filename', a file
+ * of the same name with ".jnx" appended.  It records the position of
+ * every transaction and a Bloom filter of the owner names each of them
+ * changes.  Readers of the journal use it, while it matches the start
+ * of the journal, to locate transactions without reading every
+ * transaction header, and dns_journal_printselect() uses the filters.
+ *
+ * Only the transactions added since the sidecar was last written are
+ * read.  The sidecar is not maintained as the journal grows, and is
+ * removed when the journal is compacted.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS
+ *\li	DNS_R_NOJOURNAL if the journal does not exist
+ *\li	Other errors are possible.
+ */
+
 isc_result_t
 dns_db_diff(isc_mem_t *mctx, dns_db_t *dba, dns_dbversion_t *dbvera,
 	    dns_db_t *dbb, dns_dbversion_t *dbverb,
@@ -324,6 +396,79 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
  * Other errors may be returned from file operations.
  */
 
+void
+dns_journal_compact_create(isc_mem_t *mctx, const char *filename,
+			   uint32_t serial, uint32_t target_size,
+			   dns_journalcompact_t **compactp);
+/*%<
+ * Prepare to compact the journal 'filename' as dns_journal_compact()
+ * would without flags, in two stages, so that writers do not have to
+ * wait for the journal to be copied:
+ *
+ *\li	dns_journal_compact_copy() copies the transactions to retain
+ *	into a new file.  Transactions may be appended to the journal
+ *	while it runs.
+ *
+ *\li	dns_journal_compact_commit() copies the transactions appended
+ *	meanwhile and replaces the journal with the new file.  No
+ *	transaction may be appended to the journal while it runs.
+ *
+ * No file is accessed until dns_journal_compact_copy() is called.
+ *
+ * Requires:
+ *\li	'filename' is not NULL.
+ *\li	'compactp' is not NULL and '*compactp' is NULL.
+ */
+
+isc_result_t
+dns_journal_compact_copy(dns_journalcompact_t *compact);
+/*%<
+ * Copy the transactions of the journal from the serial given to
+ * dns_journal_compact_create() onwards, and any older ones needed to
+ * keep it close to half its target size, into a new file.  This may
+ * run in any thread, while the journal is being appended to.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS	the copy is ready, or the journal doesn't need
+ *			compacting
+ *\li	ISC_R_RANGE	serial is outside the range existing in the journal
+ *
+ * Other errors may be returned from file operations.
+ */
+
+isc_result_t
+dns_journal_compact_commit(dns_journalcompact_t *compact);
+/*%<
+ * Complete a successful dns_journal_compact_copy(): add the
+ * transactions appended to the journal since, write the new file to
+ * stable storage, and rename it over the journal.  If there is no
+ * copy, this does nothing; a journal in the format used prior to
+ * BIND 9.16.12 is compacted by calling dns_journal_compact() instead.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS
+ *\li	ISC_R_CANCELED	the journal was replaced or rewritten since it
+ *			was copied, and has been left alone
+ *
+ * Other errors may be returned from file operations.
+ */
+
+void
+dns_journal_compact_progress(dns_journalcompact_t *compact, uint64_t *copiedp,
+			     uint64_t *totalp);
+/*%<
+ * Set '*copiedp' and '*totalp' to the number of bytes of transactions
+ * copied so far and to be copied in all.  '*totalp' is zero until
+ * dns_journal_compact_copy() has found where to start.  May be
+ * called from any thread.
+ */
+
+void
+dns_journal_compact_destroy(dns_journalcompact_t **compactp);
+/*%<
+ * Free '*compactp', removing any copy that has not been committed.
+ */
+
 bool
 dns_journal_get_sourceserial(dns_journal_t *j, uint32_t *sourceserial);
 void
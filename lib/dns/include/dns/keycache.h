@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+
+#pragma once
+
+/*****
+***** Module Info
+*****/
+
+/*! \file dns/keycache.h
+ * \brief
+ * Defines dns_keycache_t, a cache of DNSKEY records parsed into keys.
+ *
+ * Notes:
+ *\li	Turning a DNSKEY record into a dst_key_t means decoding the key
+ *	and building the cryptographic library's public key from it.
+ *	The validator does this for every signature it checks, and the
+ *	DNSKEY RRsets of popular zones are checked over and over; a key
+ *	cache lets the parsed keys be shared instead.
+ *
+ *\li	Entries are keyed by a digest of the owner name, the class and
+ *	the DNSKEY rdata, and are kept until the DNSKEY RRset they came
+ *	from expires at the latest.  The cache has a fixed number of
+ *	slots; a new entry replaces whatever was in its slot.
+ *
+ * MP:
+ *\li	All functions are thread-safe.  The keys returned are shared and
+ *	must not be modified.
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/stdtime.h>
+
+#include <dns/types.h>
+
+#include <dst/dst.h>
+
+/*%
+ * Default number of slots in a key cache.
+ */
+#define DNS_KEYCACHE_DEFAULTSIZE 4096
+
+ISC_LANG_BEGINDECLS
+
+/***
+ ***	Functions
+ ***/
+
+void
+dns_keycache_create(isc_mem_t *mctx, unsigned int size,
+		    dns_keycache_t **cachep);
+/*%<
+ * Allocate an empty key cache with at least 'size' slots (the number
+ * is rounded up to a power of two) and store it in '*cachep'.
+ *
+ * Requires:
+ * \li	'mctx' is a valid memory context.
+ * \li	'size' > 0.
+ * \li	'cachep' != NULL && '*cachep' == NULL.
+ */
+
+void
+dns_keycache_destroy(dns_keycache_t **cachep);
+/*%<
+ * Free the key cache in '*cachep' and detach the keys it holds.
+ * '*cachep' is set to NULL on return.
+ */
+
+void
+dns_keycache_flush(dns_keycache_t *cache);
+/*%<
+ * Discard all entries.
+ */
+
+isc_result_t
+dns_keycache_get(dns_keycache_t *cache, const dns_name_t *name,
+		 dns_rdata_t *rdata, isc_stdtime_t now, isc_stdtime_t expire,
+		 dst_key_t **keyp);
+/*%<
+ * Set '*keyp' to the key of the DNSKEY 'rdata' owned by 'name'.  If it
+ * is not in the cache, it is parsed and remembered until 'expire',
+ * which is compared with 'now' using serial number arithmetic.
+ *
+ * The caller must free '*keyp' with dst_key_free() when done.
+ *
+ * Requires:
+ * \li	'cache' is a valid key cache.
+ * \li	'rdata' is a DNSKEY.
+ * \li	'keyp' != NULL && '*keyp' == NULL.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	Errors from dst_key_fromdns() or the message digest functions.
+ */
+
+ISC_LANG_ENDDECLS
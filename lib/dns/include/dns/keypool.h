@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*****
+***** Module Info
+*****/
+
+/*! \file dns/keypool.h
+ * \brief
+ * Defines dns_keypool_t, a pool of DNSSEC keys generated ahead of time,
+ * so that the key manager does not have to generate the keys of a
+ * rollover while it maintains the zone.
+ *
+ * Notes:
+ *\li	The pool keeps up to 'depth' spare keys for each algorithm and
+ *	size it was asked for; the first request for an algorithm and
+ *	size fails and starts filling its pool.  Keys are generated on
+ *	the work threads, a few at a time, whenever a pool is below its
+ *	depth.  A pool with a depth of zero keeps no keys.
+ *
+ *\li	The keys are generated for the root name with the zone key flag
+ *	only; a key taken from the pool is given the name, class and flags
+ *	it is wanted for, so one pool serves every zone and both key roles.
+ *
+ * MP:
+ *\li	All functions are thread-safe.
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/lang.h>
+#include <isc/loop.h>
+#include <isc/refcount.h>
+
+#include <dns/types.h>
+
+#include <dst/dst.h>
+
+/*%
+ * Largest number of keys of one algorithm and size that are generated
+ * at the same time.
+ */
+#ifndef DNS_KEYPOOL_MAXPENDING
+#define DNS_KEYPOOL_MAXPENDING 4
+#endif
+
+typedef struct dns_keypool_stats {
+	unsigned int algorithm;
+	unsigned int size;
+	unsigned int depth;	/*%< number of keys the pool is filled to */
+	unsigned int available; /*%< number of keys in the pool */
+	uint64_t     generated; /*%< keys generated */
+	uint64_t     taken;	/*%< keys taken from the pool */
+	uint64_t     missed;	/*%< keys asked for when it was empty */
+	uint64_t     usecs;	/*%< time spent generating the keys */
+} dns_keypool_stats_t;
+
+typedef void (*dns_keypool_dump_t)(const dns_keypool_stats_t *stats,
+				   void *arg);
+
+ISC_LANG_BEGINDECLS
+
+/***
+ ***	Functions
+ ***/
+
+void
+dns_keypool_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr,
+		   unsigned int depth, dns_keypool_t **poolp);
+/*%<
+ * Create an empty key pool that keeps up to 'depth' keys of each
+ * algorithm and size.
+ *
+ * Requires:
+ * \li	'mctx' is a valid memory context.
+ * \li	'loopmgr' is a valid loop manager.
+ * \li	'poolp' != NULL && '*poolp' == NULL.
+ */
+
+ISC_REFCOUNT_DECL(dns_keypool);
+/*%<
+ * Attach to and detach from a key pool.  The pool is destroyed when the
+ * last reference is gone, which is not before the keys being generated
+ * are done.
+ */
+
+void
+dns_keypool_shutdown(dns_keypool_t *pool);
+/*%<
+ * Free the keys in the pool and stop generating new ones; the keys
+ * being generated are thrown away when they are done.
+ *
+ * Requires:
+ * \li	'pool' is a valid key pool.
+ */
+
+void
+dns_keypool_setdepth(dns_keypool_t *pool, unsigned int depth);
+/*%<
+ * Set the number of keys of each algorithm and size the pool is filled
+ * to.  Spare keys above the new depth are freed.
+ *
+ * Requires:
+ * \li	'pool' is a valid key pool.
+ */
+
+unsigned int
+dns_keypool_getdepth(dns_keypool_t *pool);
+/*%<
+ * Return the number of keys of each algorithm and size the pool is
+ * filled to.
+ *
+ * Requires:
+ * \li	'pool' is a valid key pool.
+ */
+
+isc_result_t
+dns_keypool_get(dns_keypool_t *pool, const dns_name_t *name,
+		unsigned int alg, unsigned int size, unsigned int flags,
+		dns_rdataclass_t rdclass, dst_key_t **keyp);
+/*%<
+ * Take a key of algorithm 'alg' and size 'size' from the pool, owned by
+ * 'name' in class 'rdclass' and with the DNSKEY flags 'flags', and start
+ * generating another one to replace it.
+ *
+ * Requires:
+ * \li	'pool' is a valid key pool.
+ * \li	'name' is an absolute name.
+ * \li	'keyp' != NULL && '*keyp' == NULL.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTFOUND		there was no such key in the pool, or
+ *				its depth is zero
+ * \li	any error returned by dst_key_setflags()
+ */
+
+void
+dns_keypool_dump(dns_keypool_t *pool, dns_keypool_dump_t dump, void *arg);
+/*%<
+ * Call 'dump' with the statistics of the keys of each algorithm and
+ * size the pool was asked for.
+ *
+ * Requires:
+ * \li	'pool' is a valid key pool.
+ * \li	'dump' is not NULL.
+ */
+
+ISC_LANG_ENDDECLS
@@ -59,6 +59,10 @@
 #define DNS_MASTER_KEY	    0x00004000 /*%< Loading a key zone master file. */
 #define DNS_MASTER_NOTTL    0x00008000 /*%< Don't require ttl. */
 #define DNS_MASTER_CHECKTTL 0x00010000 /*%< Check max-zone-ttl */
+#define DNS_MASTER_PARALLEL                                           \
+	0x00020000 /*%< Let dns_master_loadfile() parse large text    \
+		    * files in parallel, like dns_master_loadfileinc(). \
+		    */
 
 ISC_LANG_BEGINDECLS
 
@@ -68,7 +72,7 @@ ISC_LANG_BEGINDECLS
  * encoding, we directly read/write each field so that the encoded data
  * is always "packed", regardless of the hardware architecture.
  */
-#define DNS_RAWFORMAT_VERSION 1
+#define DNS_RAWFORMAT_VERSION 2
 
 /*
  * Flags to indicate the status of the data in the raw file header
@@ -76,6 +80,17 @@ ISC_LANG_BEGINDECLS
 #define DNS_MASTERRAW_COMPAT	      0x01
 #define DNS_MASTERRAW_SOURCESERIALSET 0x02
 #define DNS_MASTERRAW_LASTXFRINSET    0x04
+#define DNS_MASTERRAW_CACHE	      0x08 /*%< Dumped from a cache */
+#define DNS_MASTERRAW_COMPAT1	      0x10 /*%< Dump in version 1 */
+#define DNS_MASTERRAW_SLABFIXED	      0x20 /*%< Slabs have a load order */
+#define DNS_MASTERRAW_SIGTIMES	      0x40 /*%< RRSIG sets carry times */
+
+/*
+ * Flags in the 'attributes' field of RRsets dumped from a cache
+ */
+#define DNS_MASTERRAW_ATTR_NEGATIVE 0x0001
+#define DNS_MASTERRAW_ATTR_NXDOMAIN 0x0002
+#define DNS_MASTERRAW_ATTR_OPTOUT   0x0004
 
 /* Common header */
 struct dns_masterrawheader {
@@ -84,7 +99,7 @@ struct dns_masterrawheader {
 	uint32_t version;      /* compatibility for future
 				* extensions */
 	uint32_t dumptime;     /* timestamp on creation
-				* (currently unused) */
+				* (used to age cache TTLs) */
 	uint32_t flags;	       /* Flags */
 	uint32_t sourceserial; /* Source serial number (used
 				* by inline-signing zones) */
@@ -102,9 +117,29 @@ typedef struct {
 	dns_rdatatype_t	 covers;  /* same as type */
 	dns_ttl_t	 ttl;	  /* 32-bit TTL */
 	uint32_t	 nrdata;  /* number of RRs in this set */
+	/* only for RRSIG sets if the header has DNS_MASTERRAW_SIGTIMES set: */
+	uint32_t sigexpire;    /* earliest signature expiration */
+	uint32_t siginception; /* latest signature inception */
+	/* only if the header has DNS_MASTERRAW_CACHE set: */
+	dns_trust_t trust;	/* 16-bit trust level */
+	uint16_t    attributes; /* DNS_MASTERRAW_ATTR_* */
 	/* followed by encoded owner name, and then rdata */
 } dns_masterrawrdataset_t;
 
+/*
+ * In version 2, which is not used for caches, the owner name of each
+ * RRset is followed by its records in the rdataslab format instead of
+ * the length and data of each rdata, so that the file can be mapped
+ * into memory and the slabs added to the database as they are.
+ * DNS_MASTERRAW_SLABFIXED is set in the header when the slabs include
+ * the load order table.
+ *
+ * When DNS_MASTERRAW_SIGTIMES is set, 'nrdata' of each RRSIG RRset is
+ * followed by the earliest expiration time and the latest inception
+ * time of its signatures (both 32-bit), so the re-signing time of the
+ * RRset is known without parsing the signatures again on load.
+ */
+
 /*
  * Method prototype: a callback to register each include file as
  * it is encountered.
@@ -187,6 +222,13 @@ dns_master_loadlexerinc(isc_lex_t *lex, dns_name_t *top, dns_name_t *origin,
  * is completed or has failed.  If the initial setup fails 'done' is
  * not called.
  *
+ * dns_master_loadfileinc() parses large text files in chunks on worker
+ * threads when it can split them safely.  'callbacks' are still called
+ * in file order from 'task', with the same arguments as when loading
+ * the file with dns_master_loadfile().  dns_master_loadfile() does the
+ * same with threads of its own, in the calling thread, when 'options'
+ * include DNS_MASTER_PARALLEL.
+ *
  * 'resign' the number of seconds before a RRSIG expires that it should
  * be re-signed.  0 is used if not provided.
  *
@@ -219,6 +219,10 @@ typedef int dns_messagetextflag_t;
 #define DNS_MESSAGEPARSE_IGNORETRUNCATION \
 	0x0008 /*%< truncation errors are \
 		* not fatal. */
+#define DNS_MESSAGEPARSE_LAZY  \
+	0x0010 /*%< defer parsing the \
+		* answer and authority \
+		* sections of a query */
 
 /*
  * Control behavior of rendering
@@ -281,6 +285,11 @@ struct dns_message {
 	unsigned int cc_bad	      : 1;
 	unsigned int tkey	      : 1;
 	unsigned int rdclass_set      : 1;
+	unsigned int lazy	      : 1;
+
+	unsigned int lazystart;
+	unsigned int lazyoptions;
+	isc_result_t lazyresult;
 
 	unsigned int opt_reserved;
 	unsigned int sig_reserved;
@@ -292,20 +301,25 @@ struct dns_message {
 	isc_buffer_t   *buffer;
 	dns_compress_t *cctx;
 
-	isc_mem_t     *mctx;
-	isc_mempool_t *namepool;
-	isc_mempool_t *rdspool;
+	isc_mem_t *mctx;
 
 	isc_bufferlist_t scratchpad;
 	isc_bufferlist_t cleanup;
 
+	ISC_LIST(dns_msgblock_t) names;
 	ISC_LIST(dns_msgblock_t) rdatas;
+	ISC_LIST(dns_msgblock_t) rdatasets;
 	ISC_LIST(dns_msgblock_t) rdatalists;
 	ISC_LIST(dns_msgblock_t) offsets;
 
+	ISC_LIST(dns_name_t) freename;
 	ISC_LIST(dns_rdata_t) freerdata;
+	ISC_LIST(dns_rdataset_t) freerdataset;
 	ISC_LIST(dns_rdatalist_t) freerdatalist;
 
+	unsigned int tempnames;	    /* names handed out */
+	unsigned int temprdatasets; /* rdatasets handed out */
+
 	dns_rcode_t tsigstatus;
 	dns_rcode_t querytsigstatus;
 	dns_name_t *tsigname; /* Owner name of TSIG, if any
@@ -549,6 +563,15 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
  * If #DNS_MESSAGEPARSE_IGNORETRUNCATION is set then return as many complete
  * RR's as possible, DNS_R_RECOVERABLE will be returned.
  *
+ * If #DNS_MESSAGEPARSE_LAZY is set and the opcode of the message is QUERY,
+ * the records in the answer and authority sections are only checked for
+ * well-formed framing; the sections are parsed when they are first accessed
+ * with dns_message_firstname(), dns_message_findname() or
+ * dns_message_sectiontotext(), and any error in them is reported by those
+ * functions instead.  The section data must then remain valid until that
+ * happens, dns_message_reply() is called, or the message is reset.  OPT,
+ * TSIG and SIG(0) records are always parsed immediately.
+ *
  * OPT and TSIG records are always handled specially, regardless of the
  * 'preserve_order' setting.
  *
@@ -684,6 +707,31 @@ dns_message_rendersection(dns_message_t *msg, dns_section_t section,
  *				   are records remaining for this section.
  */
 
+isc_result_t
+dns_message_renderwire(dns_message_t *msg, const isc_region_t *wire,
+		       const unsigned int *counts);
+/*%<
+ * Append sections that have already been rendered to wire format,
+ * instead of rendering them from the message, and set the section
+ * counts from 'counts'.  'wire' must have been rendered right after a
+ * #DNS_MESSAGE_HEADERLEN byte header so that its compression pointers
+ * stay valid.  OPT, TSIG and SIG(0) are still added by
+ * dns_message_renderend().
+ *
+ * Requires:
+ *\li	'msg' be valid.
+ *
+ *\li	dns_message_renderbegin() was called and nothing has been
+ *	rendered yet.
+ *
+ *\li	'counts' has #DNS_SECTION_MAX elements.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS		-- the sections were copied.
+ *\li	#ISC_R_NOSPACE		-- not enough room in the buffer; nothing
+ *				   was written.
+ */
+
 void
 dns_message_renderheader(dns_message_t *msg, isc_buffer_t *target);
 /*%<
@@ -748,6 +796,8 @@ dns_message_firstname(dns_message_t *msg, dns_section_t section);
  * Returns:
  *\li	#ISC_R_SUCCESS		-- All is well.
  *\li	#ISC_R_NOMORE		-- No names on given section.
+ *\li	Any error from parsing a section deferred by
+ *	#DNS_MESSAGEPARSE_LAZY.
  */
 
 isc_result_t
@@ -827,6 +877,8 @@ dns_message_findname(dns_message_t *msg, dns_section_t section,
  *\li	#DNS_R_NXDOMAIN		-- name does not exist in that section.
  *\li	#DNS_R_NXRRSET		-- The name does exist, but the desired
  *				   type does not.
+ *\li	Any error from parsing a section deferred by
+ *	#DNS_MESSAGEPARSE_LAZY.
  */
 
 isc_result_t
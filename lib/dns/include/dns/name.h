@@ -111,6 +111,7 @@ struct dns_name {
 	isc_buffer_t  *buffer;
 	ISC_LINK(dns_name_t) link;
 	ISC_LIST(dns_rdataset_t) list;
+	unsigned int hashval; /*%< valid if DNS_NAMEATTR_HASHED */
 };
 
 #define DNS_NAME_MAGIC ISC_MAGIC('D', 'N', 'S', 'n')
@@ -120,6 +121,7 @@ struct dns_name {
 #define DNS_NAMEATTR_DYNAMIC	0x00000004
 #define DNS_NAMEATTR_DYNOFFSETS 0x00000008
 #define DNS_NAMEATTR_NOCOMPRESS 0x00000010
+#define DNS_NAMEATTR_HASHED	0x00000020
 /*
  * Attributes below 0x0100 reserved for name.c usage.
  */
@@ -142,6 +144,7 @@ struct dns_name {
 #define DNS_NAME_CHECKREVERSE	0x0008 /*%< Used by rdata. */
 #define DNS_NAME_CHECKMX	0x0010 /*%< Used by rdata. */
 #define DNS_NAME_CHECKMXFAIL	0x0020 /*%< Used by rdata. */
+#define DNS_NAME_CACHEHASH	0x0040
 
 extern const dns_name_t *dns_rootname;
 extern const dns_name_t *dns_wildcardname;
@@ -374,6 +377,10 @@ dns_name_fullhash(const dns_name_t *name, bool case_sensitive);
  * Note: if 'case_sensitive' is false, then names which differ only in
  * case will have the same hash value.
  *
+ * Note: the case-insensitive hash value is not recomputed if it was
+ * cached in 'name' with DNS_NAME_CACHEHASH, or copied along with the
+ * name by dns_name_clone(), dns_name_copy() or dns_name_dup().
+ *
  * Requires:
  *\li	'name' is a valid name
  *
@@ -703,6 +710,10 @@ dns_name_fromwire(dns_name_t *name, isc_buffer_t *source, dns_decompress_t dctx,
  * \li	If DNS_NAME_DOWNCASE is set, any uppercase letters in 'source' will be
  *	downcased when they are copied into 'target'.
  *
+ * \li	If DNS_NAME_CACHEHASH is set, the case-insensitive value of
+ *	dns_name_fullhash() is computed now and kept in 'name', for names
+ *	that will be hashed repeatedly.
+ *
  * Security:
  *
  * \li	*** WARNING ***
@@ -797,6 +808,9 @@ dns_name_fromtext(dns_name_t *name, isc_buffer_t *source,
  * \li	If DNS_NAME_DOWNCASE is set in 'options', any uppercase letters
  *	in 'source' will be downcased when they are copied into 'target'.
  *
+ * \li	If DNS_NAME_CACHEHASH is set in 'options', the case-insensitive
+ *	value of dns_name_fullhash() is computed now and kept in 'name'.
+ *
  * Requires:
  *
  * \li	'name' is a valid name.
@@ -1334,14 +1348,15 @@ ISC_LANG_ENDDECLS
 		ISC_LIST_INIT(_n->list);          \
 	} while (0)
 
-#define DNS_NAME_RESET(n)                                  \
-	do {                                               \
-		(n)->ndata = NULL;                         \
-		(n)->length = 0;                           \
-		(n)->labels = 0;                           \
-		(n)->attributes &= ~DNS_NAMEATTR_ABSOLUTE; \
-		if ((n)->buffer != NULL)                   \
-			isc_buffer_clear((n)->buffer);     \
+#define DNS_NAME_RESET(n)                                    \
+	do {                                                 \
+		(n)->ndata = NULL;                           \
+		(n)->length = 0;                             \
+		(n)->labels = 0;                             \
+		(n)->attributes &= ~(DNS_NAMEATTR_ABSOLUTE | \
+				     DNS_NAMEATTR_HASHED);   \
+		if ((n)->buffer != NULL)                     \
+			isc_buffer_clear((n)->buffer);       \
 	} while (0)
 
 #define DNS_NAME_SETBUFFER(n, b) (n)->buffer = (b)
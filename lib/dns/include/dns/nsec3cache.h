@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*****
+***** Module Info
+*****/
+
+/*! \file dns/nsec3cache.h
+ * \brief
+ * Defines dns_nsec3cache_t, a cache of the NSEC3 hashes of the names of
+ * a zone, so that the names proving the nonexistence of a name are not
+ * hashed again for every negative answer.
+ *
+ * Notes:
+ *\li	The cache holds the hashes for one set of NSEC3 parameters at a
+ *	time; asking for a hash with other parameters forgets the others.
+ *
+ *\li	The cache is divided into buckets of #DNS_NSEC3CACHE_WAYS entries,
+ *	replaced in CLOCK order: an entry that was looked up since the
+ *	last time the hand passed it is kept, so the names shared by many
+ *	queries, such as the ancestors of the query names, are not pushed
+ *	out by names that are only asked for once.
+ *
+ * MP:
+ *\li	All functions but dns_nsec3cache_destroy() are thread-safe.
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/lang.h>
+
+#include <dns/nsec3.h>
+#include <dns/types.h>
+
+/*%
+ * Default number of entries of a cache.
+ */
+#ifndef DNS_NSEC3CACHE_SIZE
+#define DNS_NSEC3CACHE_SIZE 256
+#endif
+
+/*%
+ * Number of entries in a bucket.
+ */
+#ifndef DNS_NSEC3CACHE_WAYS
+#define DNS_NSEC3CACHE_WAYS 4
+#endif
+
+ISC_LANG_BEGINDECLS
+
+/***
+ ***	Functions
+ ***/
+
+void
+dns_nsec3cache_create(isc_mem_t *mctx, unsigned int size,
+		      dns_nsec3cache_t **cachep);
+/*%<
+ * Create an empty cache of 'size' entries, rounded up to a whole number
+ * of buckets.
+ *
+ * Requires:
+ * \li	'mctx' is a valid memory context.
+ * \li	'size' > 0.
+ * \li	'cachep' != NULL && '*cachep' == NULL.
+ */
+
+void
+dns_nsec3cache_destroy(dns_nsec3cache_t **cachep);
+/*%<
+ * Destroy a cache.
+ *
+ * Requires:
+ * \li	'cachep' points to a valid cache.
+ */
+
+isc_result_t
+dns_nsec3cache_hashname(dns_nsec3cache_t *cache, dns_fixedname_t *result,
+			unsigned char rethash[NSEC3_MAX_HASH_LENGTH],
+			size_t *hash_length, const dns_name_t *name,
+			const dns_name_t *origin, dns_hash_t hashalg,
+			unsigned int iterations, const unsigned char *salt,
+			size_t saltlength);
+/*%<
+ * Like dns_nsec3_hashname(), but the hash of 'name' is taken from
+ * 'cache' when it is there, and put there when it is not.
+ *
+ * Requires:
+ * \li	'cache' is a valid cache.
+ * \li	'name' is a valid name.
+ */
+
+void
+dns_nsec3cache_getstats(dns_nsec3cache_t *cache, uint64_t *hitsp,
+			uint64_t *missesp);
+/*%<
+ * Return the number of hashes found in the cache and the number of
+ * hashes computed since it was created.
+ *
+ * Requires:
+ * \li	'cache' is a valid cache.
+ * \li	'hitsp' and 'missesp' are not NULL.
+ */
+
+ISC_LANG_ENDDECLS
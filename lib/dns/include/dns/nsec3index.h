@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*****
+***** Module Info
+*****/
+
+/*! \file dns/nsec3index.h
+ * \brief
+ * Defines dns_nsec3index_t, an index of the validated NSEC3 records
+ * learned by the resolver.
+ *
+ * Notes:
+ *\li	For each zone signed with NSEC3, the index keeps the hash ranges
+ *	of the NSEC3 records that were validated as part of a negative
+ *	response, sorted by owner hash, together with the NSEC3 parameters
+ *	of the zone.  This allows dns_nsec3index_nxdomain() to tell, in
+ *	O(log n) per hash, whether a name is proven not to exist by the
+ *	records already seen, the way the cache does for NSEC with its
+ *	auxiliary NSEC tree.  It is used to answer queries for random
+ *	names under such a zone without sending them to its servers.
+ *
+ *\li	Only the ranges are kept, not the records themselves.
+ *
+ * MP:
+ *\li	All functions may be called from any thread.
+ *
+ * Resources:
+ *\li	The number of ranges in an index is bounded; see
+ *	DNS_NSEC3INDEX_MAXRANGES.
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <stdbool.h>
+
+#include <isc/stdtime.h>
+
+#include <dns/types.h>
+
+/*%
+ * The maximum number of NSEC3 ranges kept by an index, over all zones.
+ */
+#ifndef DNS_NSEC3INDEX_MAXRANGES
+#define DNS_NSEC3INDEX_MAXRANGES 100000
+#endif
+
+ISC_LANG_BEGINDECLS
+
+/***
+ ***	Functions
+ ***/
+
+void
+dns_nsec3index_create(isc_mem_t *mctx, dns_nsec3index_t **indexp);
+/*%<
+ * Create an empty NSEC3 index and store it in '*indexp'.
+ *
+ * Requires:
+ * \li	'mctx' is a valid memory context.
+ * \li	'indexp' is not NULL and '*indexp' is NULL.
+ */
+
+void
+dns_nsec3index_destroy(dns_nsec3index_t **indexp);
+/*%<
+ * Free the NSEC3 index in '*indexp', and set '*indexp' to NULL.
+ *
+ * Requires:
+ * \li	'*indexp' is a valid NSEC3 index.
+ */
+
+isc_result_t
+dns_nsec3index_add(dns_nsec3index_t *index, const dns_name_t *owner,
+		   dns_rdataset_t *rdataset, isc_stdtime_t now);
+/*%<
+ * Add the range of the NSEC3 RRset 'rdataset' at 'owner', which must
+ * have been validated, to the index.  The range is used until the TTL
+ * of 'rdataset' runs out.
+ *
+ * If the NSEC3 parameters differ from those of the ranges already
+ * known for the zone, the zone has been re-signed with a new chain: the
+ * old ranges are dropped.  Records with an unsupported hash algorithm
+ * or more iterations than dns_nsec3_maxiterations() are ignored.
+ *
+ * Requires:
+ * \li	'index' is a valid NSEC3 index.
+ * \li	'rdataset' is an NSEC3 rdataset.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_IGNORE		the record can't be used
+ * \li	#ISC_R_NOSPACE		the index is full
+ */
+
+isc_result_t
+dns_nsec3index_nxdomain(dns_nsec3index_t *index, const dns_name_t *name,
+			isc_stdtime_t now, dns_name_t *zone);
+/*%<
+ * Check whether the ranges in the index prove that 'name' doesn't exist,
+ * as an NSEC3 closest encloser proof (RFC 5155 section 8.4) would: a
+ * range matching the closest encloser, which is neither a delegation
+ * nor a DNAME, a range covering the next closer name that doesn't have
+ * the opt-out flag, and a range covering the wildcard at the closest
+ * encloser.
+ *
+ * If it does, the name of the zone is copied into 'zone'.
+ *
+ * Requires:
+ * \li	'index' is a valid NSEC3 index.
+ * \li	'name' and 'zone' are valid names; 'zone' has a dedicated buffer.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS		'name' is proven not to exist
+ * \li	#ISC_R_NOTFOUND		it isn't
+ */
+
+void
+dns_nsec3index_flush(dns_nsec3index_t *index);
+/*%<
+ * Remove all the ranges from the index.
+ *
+ * Requires:
+ * \li	'index' is a valid NSEC3 index.
+ */
+
+void
+dns_nsec3index_flushname(dns_nsec3index_t *index, const dns_name_t *name,
+			 bool tree);
+/*%<
+ * Remove the ranges of the zones that could say anything about 'name',
+ * that is, the zones at or above 'name', and if 'tree' is true, also
+ * the zones below it.
+ *
+ * Requires:
+ * \li	'index' is a valid NSEC3 index.
+ * \li	'name' is a valid name.
+ */
+
+unsigned int
+dns_nsec3index_count(dns_nsec3index_t *index);
+/*%<
+ * Return the number of ranges in the index.
+ *
+ * Requires:
+ * \li	'index' is a valid NSEC3 index.
+ */
+
+ISC_LANG_ENDDECLS
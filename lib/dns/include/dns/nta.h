@@ -56,6 +56,8 @@ struct dns_ntatable {
 	/* Locked by rwlock. */
 	dns_rbt_t *table;
 	bool	   shuttingdown;
+	/* Updated under the write lock, read without it on loop threads. */
+	struct dns__namesnaps *snaps;
 };
 
 #define NTATABLE_MAGIC	   ISC_MAGIC('N', 'T', 'A', 't')
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*****
+***** Module Info
+*****/
+
+/*! \file dns/prefetch.h
+ * \brief
+ * Defines dns_prefetch_t, a scheduler refreshing the most popular cached
+ * RRsets of a view before they expire.
+ *
+ * Notes:
+ *\li	Every answer given from the cache is counted in a count-min
+ *	sketch, whose counters are halved periodically so that the
+ *	counts follow the current popularity of the names.  The names
+ *	with the highest counts are kept in a table of fixed size.
+ *
+ *\li	Each RRset in the table is refreshed shortly before it expires,
+ *	at a time chosen at random in a window so that RRsets cached
+ *	together are not all refreshed together.  The refresh queries
+ *	are sent at no more than a configured rate; those that are due
+ *	while the budget is exhausted wait for the following ticks.
+ *
+ *\li	This complements the "prefetch" option, which only refreshes an
+ *	RRset when a client asks for it within the last seconds of its
+ *	TTL.
+ *
+ * MP:
+ *\li	dns_prefetch_record() may be called from any thread.
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <isc/lang.h>
+#include <isc/loop.h>
+#include <isc/stdtime.h>
+#include <isc/task.h>
+
+#include <dns/types.h>
+
+ISC_LANG_BEGINDECLS
+
+/***
+ ***	Functions
+ ***/
+
+void
+dns_prefetch_create(dns_view_t *view, isc_loopmgr_t *loopmgr,
+		    isc_taskmgr_t *taskmgr, unsigned int size,
+		    unsigned int rate, dns_prefetch_t **prefetchp);
+/*%<
+ * Create a prefetch scheduler for 'view' tracking up to 'size' popular
+ * RRsets and refreshing at most 'rate' of them per second, and start
+ * it on the main loop of 'loopmgr'.
+ *
+ * The scheduler does not hold a reference to 'view', which must call
+ * dns_prefetch_shutdown() before shutting down its resolver.
+ *
+ * Requires:
+ * \li	'view' is a valid view with a resolver.
+ * \li	'size' > 0 and 'rate' > 0.
+ * \li	'prefetchp' != NULL && '*prefetchp' == NULL.
+ */
+
+void
+dns_prefetch_record(dns_prefetch_t *prefetch, const dns_name_t *name,
+		    dns_rdatatype_t type, dns_ttl_t ttl, isc_stdtime_t now);
+/*%<
+ * Count an answer for 'name'/'type' given from the cache at 'now', with
+ * 'ttl' seconds left before it expires.
+ *
+ * Requires:
+ * \li	'prefetch' is a valid prefetch scheduler.
+ * \li	'name' is a valid absolute name.
+ */
+
+void
+dns_prefetch_shutdown(dns_prefetch_t *prefetch);
+/*%<
+ * Stop refreshing RRsets and cancel the refreshes in progress.
+ *
+ * Requires:
+ * \li	'prefetch' is a valid prefetch scheduler.
+ */
+
+void
+dns_prefetch_detach(dns_prefetch_t **prefetchp);
+/*%<
+ * Detach '*prefetchp', freeing the scheduler when the last reference
+ * is gone.
+ */
+
+ISC_LANG_ENDDECLS
@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*****
+***** Module Info
+*****/
+
+/*! \file dns/qp.h
+ * \brief
+ * A qp-trie indexed by domain names.
+ *
+ * Notes:
+ *\li	A qp-trie is a radix tree in which each branch holds a bitmap of
+ *	the key element values present at one offset, followed by a
+ *	packed array of child nodes ("twigs"), one for each bit that is
+ *	set.  Leaves hold a pointer to a value owned by the caller.  Keys
+ *	are not stored in the trie: whenever a leaf key is needed, it is
+ *	recomputed from the value by the 'makekey' callback.
+ *
+ *\li	Keys are made from domain names by dns_qpkey_fromname().  The
+ *	labels are taken from the root downwards, each byte is folded to
+ *	lower case and split into two elements, and each label is
+ *	terminated by a separator that sorts below any byte.  Comparing
+ *	two keys element by element therefore yields the DNSSEC canonical
+ *	order of the names, so the trie can be walked in order and
+ *	searched for the predecessor of a name that is not present.
+ *
+ * MP:
+ *\li	The trie is not locked; callers must serialize modifications
+ *	against any other access, unless a retire callback has been set
+ *	with dns_qp_setretire().  In that case a modification never
+ *	changes memory that a reader may be using: it copies the path
+ *	from the root to the point of change and then publishes the new
+ *	root, so a single writer can run alongside any number of readers
+ *	of dns_qp_getkey(), dns_qp_lookup() and iterators, each of which
+ *	sees the trie either before or after the change.  The memory
+ *	replaced is passed to the callback, which must not free it until
+ *	every reader that might have seen it has finished.
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/lang.h>
+
+#include <dns/name.h>
+#include <dns/types.h>
+
+/*%
+ * Longest possible key: two elements for every byte of a name in wire
+ * format, which also covers the label separators.
+ */
+#define DNS_QPKEY_MAXLEN (DNS_NAME_MAXWIRE * 2)
+
+typedef uint8_t dns_qpkey_t[DNS_QPKEY_MAXLEN];
+
+/*%
+ * Convert the value 'pval' stored in a leaf back into its key, and
+ * return the length of the key.
+ */
+typedef size_t (*dns_qpmakekey_t)(dns_qpkey_t key, void *uctx, void *pval);
+
+/*%
+ * Take over 'size' bytes at 'ptr', allocated from the trie's memory
+ * context, that a copy-on-write modification has replaced.
+ */
+typedef void (*dns_qpretire_t)(void *uctx, void *ptr, size_t size);
+
+/*%
+ * A trie node; the layout is private to qp.c.
+ */
+typedef struct dns_qpnode {
+	uint32_t bitmap; /*%< Zero in leaves */
+	uint32_t offset;
+	void	*ptr;
+} dns_qpnode_t;
+
+/*%
+ * Position in a trie: the path from the root to the current leaf.
+ * An iterator is invalidated by any modification of the trie.
+ */
+typedef struct dns_qpiter {
+	dns_qp_t     *qp;
+	unsigned int  sp;
+	dns_qpnode_t *stack[DNS_QPKEY_MAXLEN + 1];
+} dns_qpiter_t;
+
+/*%
+ * The values found above the search key by dns_qp_lookup(), from the
+ * shallowest to the deepest.  A name has at most 128 labels.
+ */
+#define DNS_QPCHAIN_MAX 128
+
+typedef struct dns_qpchain {
+	unsigned int len;
+	void	    *chain[DNS_QPCHAIN_MAX];
+} dns_qpchain_t;
+
+ISC_LANG_BEGINDECLS
+
+/***
+ ***	Functions
+ ***/
+
+size_t
+dns_qpkey_fromname(dns_qpkey_t key, const dns_name_t *name);
+/*%<
+ * Convert 'name' into a trie key stored in 'key', returning its length.
+ * The root name has an empty key.
+ *
+ * Requires:
+ * \li	'name' is a valid absolute name.
+ */
+
+void
+dns_qp_create(isc_mem_t *mctx, dns_qpmakekey_t makekey, void *uctx,
+	      dns_qp_t **qpp);
+/*%<
+ * Create an empty trie.  'makekey' is called with 'uctx' to recover the
+ * key of a stored value.
+ *
+ * Requires:
+ * \li	'mctx' is a valid memory context.
+ * \li	'makekey' != NULL.
+ * \li	'qpp' != NULL && '*qpp' == NULL.
+ */
+
+void
+dns_qp_destroy(dns_qp_t **qpp);
+/*%<
+ * Free the trie in '*qpp'.  The values stored in it are not touched;
+ * the caller is responsible for them.
+ */
+
+unsigned int
+dns_qp_count(dns_qp_t *qp);
+/*%<
+ * Return the number of values in the trie.
+ */
+
+void
+dns_qp_setretire(dns_qp_t *qp, dns_qpretire_t retire);
+/*%<
+ * Make modifications of 'qp' copy-on-write, passing replaced memory to
+ * 'retire' (called with the trie's 'uctx'), or change the trie in place
+ * again if 'retire' is NULL.
+ */
+
+isc_result_t
+dns_qp_insert(dns_qp_t *qp, void *pval);
+/*%<
+ * Add 'pval' to the trie under the key computed by 'makekey'.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_EXISTS	a value with an equal key is already present.
+ */
+
+isc_result_t
+dns_qp_deletekey(dns_qp_t *qp, const dns_qpkey_t key, size_t keylen);
+/*%<
+ * Remove the value stored under 'key' from the trie.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTFOUND
+ */
+
+isc_result_t
+dns_qp_getkey(dns_qp_t *qp, const dns_qpkey_t key, size_t keylen,
+	      void **pvalp);
+/*%<
+ * Find the value stored under 'key' and store it in '*pvalp'.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTFOUND
+ */
+
+isc_result_t
+dns_qp_lookup(dns_qp_t *qp, const dns_qpkey_t key, size_t keylen,
+	      dns_qpiter_t *iter, dns_qpchain_t *chain, void **pvalp);
+/*%<
+ * Search for 'key', which must have been made by dns_qpkey_fromname().
+ *
+ * If 'chain' is not NULL, it is filled with the values whose keys are
+ * those of proper ancestors of the name being searched for.
+ *
+ * If 'iter' is not NULL, it is positioned at the value found on an exact
+ * match, and otherwise at the greatest value whose key sorts before
+ * 'key'; when there is no such value, the iterator is left unpositioned
+ * and dns_qpiter_prev() will return the last value.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS		exact match; '*pvalp' is the value.
+ * \li	#DNS_R_PARTIALMATCH	'*pvalp' is the deepest ancestor.
+ * \li	#ISC_R_NOTFOUND		neither the name nor any ancestor is
+ *				present.
+ */
+
+void
+dns_qpiter_init(dns_qp_t *qp, dns_qpiter_t *iter);
+/*%<
+ * Initialize an unpositioned iterator over 'qp'.
+ */
+
+isc_result_t
+dns_qpiter_next(dns_qpiter_t *iter, void **pvalp);
+isc_result_t
+dns_qpiter_prev(dns_qpiter_t *iter, void **pvalp);
+/*%<
+ * Move to the next (or previous) value in key order and store it in
+ * '*pvalp'.  An unpositioned iterator moves to the first (or last)
+ * value.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOMORE	no more values; the iterator is left
+ *			unpositioned.
+ */
+
+isc_result_t
+dns_qpiter_current(dns_qpiter_t *iter, void **pvalp);
+/*%<
+ * Store the value at the iterator position in '*pvalp'.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOMORE	the iterator is unpositioned.
+ */
+
+ISC_LANG_ENDDECLS
@@ -141,9 +141,10 @@ struct dns_rbtnode {
 	 */
 	void *data;
 	uint8_t	      : 0; /* start of bitfields c/o node lock */
-	uint8_t dirty : 1;
-	uint8_t wild  : 1;
-	uint8_t	      : 0;	/* end of bitfields c/o node lock */
+	uint8_t dirty	: 1;
+	uint8_t wild	: 1;
+	uint8_t zonecut : 1; /*%< in the cache's zone cut index */
+	uint8_t		: 0; /* end of bitfields c/o node lock */
 	uint16_t       locknum; /* note that this is not in the bitfield */
 	isc_refcount_t references;
 	/*@}*/
@@ -659,6 +660,17 @@ dns_rbt_nodecount(dns_rbt_t *rbt);
  * \li  rbt is a valid rbt manager.
  */
 
+size_t
+dns_rbt_inuse(dns_rbt_t *rbt);
+/*%<
+ * Obtain the number of bytes allocated for the tree of trees: the nodes,
+ * including their names, and the hash table.  The node data is not
+ * included.
+ *
+ * Requires:
+ * \li  rbt is a valid rbt manager.
+ */
+
 size_t
 dns_rbt_hashsize(dns_rbt_t *rbt);
 /*%<
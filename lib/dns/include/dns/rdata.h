@@ -746,6 +746,26 @@ dns_rdatatype_attributes(dns_rdatatype_t rdtype);
 /*% Follow additional */
 #define DNS_RDATATYPEATTR_FOLLOWADDITIONAL 0x00000800U
 
+unsigned int
+dns_rdata_wireinfo(dns_rdataclass_t rdclass, dns_rdatatype_t type);
+/*%<
+ * Return what is known of the wire format of rdata of class 'rdclass' and
+ * type 'type', from the RRTYPE_<TYPE>_WIRE definition in the source of the
+ * type.
+ *
+ * Returns:
+ *\li	zero if nothing is known, or else the fixed length of the rdata
+ *	(DNS_RDATAWIRE_LENGTH, zero if it varies) and the following flags.
+ */
+
+/*% Fixed length of the rdata, or zero */
+#define DNS_RDATAWIRE_LENGTH 0x0000ffffU
+/*%
+ * Holds no domain name: rendered as it is stored, and ordered bytewise
+ * by both dns_rdata_compare() and dns_rdata_casecompare()
+ */
+#define DNS_RDATAWIRE_PLAIN 0x00010000U
+
 dns_rdatatype_t
 dns_rdata_covers(dns_rdata_t *rdata);
 /*%<
@@ -54,6 +54,15 @@ ISC_LANG_BEGINDECLS
 
 #define DNS_RDATASLAB_OFFLINE 0x01 /* RRSIG is for offline DNSKEY */
 
+/*%
+ * Reference counting of the owner of a slab, for rdatasets made with
+ * dns_rdataslab_tordatasetref().
+ */
+typedef struct dns_rdataslabowner {
+	void (*attach)(void *owner);
+	void (*detach)(void *owner);
+} dns_rdataslabowner_t;
+
 /***
  *** Functions
  ***/
@@ -79,6 +88,48 @@ dns_rdataslab_fromrdataset(dns_rdataset_t *rdataset, isc_mem_t *mctx,
  *\li	XXX others
  */
 
+void
+dns_rdataslab_tordataset(unsigned char *slab, unsigned int reservelen,
+			 dns_rdataclass_t rdclass, dns_rdatatype_t type,
+			 dns_rdatatype_t covers, dns_ttl_t ttl,
+			 dns_rdataset_t *rdataset);
+/*%<
+ * Make 'rdataset' refer to the records of 'slab', which begins at
+ * slab + reservelen, without copying them.  The records are returned
+ * in DNSSEC order, and dns_rdataslab_fromrdataset() copies 'rdataset'
+ * as a single block.
+ *
+ * Requires:
+ *\li	'slab' points to a slab which outlives 'rdataset'.
+ *
+ *\li	'rdataset' is a valid, disassociated rdataset.
+ */
+
+void
+dns_rdataslab_tordatasetref(unsigned char *slab, unsigned int reservelen,
+			    dns_rdataclass_t rdclass, dns_rdatatype_t type,
+			    dns_rdatatype_t covers, dns_ttl_t ttl,
+			    const dns_rdataslabowner_t *methods, void *owner,
+			    dns_rdataset_t *rdataset);
+/*%<
+ * Like dns_rdataslab_tordataset(), but 'rdataset' and its clones each
+ * hold a reference to 'owner', the object the slab belongs to, taken
+ * with 'methods->attach' and released with 'methods->detach' when they
+ * are disassociated.
+ *
+ * This lets a database that keeps its records in wire format, such as
+ * one of an external engine loaded with "dyndb", return them from
+ * findrdataset() and the like without copying them into rdatalists:
+ * the records are rendered straight from the slab.
+ *
+ * Requires:
+ *\li	'slab' points to a slab which outlives 'owner'.
+ *
+ *\li	'methods' != NULL, and 'owner' is valid.
+ *
+ *\li	'rdataset' is a valid, disassociated rdataset.
+ */
+
 unsigned int
 dns_rdataslab_size(unsigned char *slab, unsigned int reservelen);
 /*%<
@@ -151,6 +151,17 @@ typedef enum { dns_quotatype_zone = 0, dns_quotatype_server } dns_quotatype_t;
 #define DNS_RESOLVER_QRYRTTCLASS4    1600
 #define DNS_RESOLVER_QRYRTTCLASS4STR "1600"
 
+/*%
+ * A snapshot of the cumulative fetch time of one delegation; see
+ * dns_resolver_slowzones().
+ */
+typedef struct dns_resslowzone {
+	char	 name[DNS_NAME_FORMATSIZE];
+	uint64_t fetches;
+	uint64_t waited;  /*%< total fetch time, in microseconds */
+	uint64_t maxwait; /*%< longest fetch, in microseconds */
+} dns_resslowzone_t;
+
 /*
  * XXXRTH  Should this API be made semi-private?  (I.e.
  * _dns_resolver_create()).
@@ -222,6 +233,27 @@ dns_resolver_freeze(dns_resolver_t *res);
  *\li	'res' is frozen.
  */
 
+void
+dns_resolver_sharefetches(dns_resolver_t *res, dns_resolver_t *source);
+/*%<
+ * Make 'res' share the table of fetch contexts of 'source', so that a
+ * fetch created by either resolver joins a matching fetch in progress
+ * in the other instead of starting a new one.
+ *
+ * Notes:
+ *
+ *\li	The fetch is carried out by the resolver that started it, with
+ *	the settings and forwarders of its view, and its answer is added
+ *	to the cache of that view.  This is only meant for the resolvers
+ *	of views sharing the same cache and the same resolution settings.
+ *
+ * Requires:
+ *
+ *\li	'res' is a valid resolver that is not frozen.
+ *
+ *\li	'source' is a valid resolver of the same class as 'res'.
+ */
+
 void
 dns_resolver_prime(dns_resolver_t *res);
 /*%<
@@ -578,6 +610,40 @@ dns_resolver_setnonbackofftries(dns_resolver_t *resolver, unsigned int tries);
  * \li  tries > 0.
  */
 
+unsigned int
+dns_resolver_getmaxhedges(dns_resolver_t *resolver);
+
+void
+dns_resolver_setmaxhedges(dns_resolver_t *resolver, unsigned int hedges);
+/*%<
+ * Sets the number of hedged queries a fetch may send.  When a server
+ * has not answered within the time nearly all of its answers take (its
+ * smoothed RTT plus four times the mean deviation of its RTTs), a
+ * hedged query is sent to the next best server, without waiting for
+ * the retry interval to expire, and the first answer received is used.
+ * Defaults to 0, which disables hedged queries.
+ *
+ * Requires:
+ * \li	resolver to be valid.
+ */
+
+unsigned int
+dns_resolver_getmaxforwarderqueries(dns_resolver_t *resolver);
+
+void
+dns_resolver_setmaxforwarderqueries(dns_resolver_t *resolver,
+				    unsigned int queries);
+/*%<
+ * Sets the number of queries the resolver may have outstanding to a
+ * single forwarder.  A forwarder that has reached the limit is skipped
+ * in favour of the next one, and the query is sent to the servers of
+ * the zone when all the forwarders are skipped and forwarding is not
+ * "only".  Defaults to 0, which means no limit.
+ *
+ * Requires:
+ * \li	resolver to be valid.
+ */
+
 unsigned int
 dns_resolver_getoptions(dns_resolver_t *resolver);
 /*%<
@@ -775,4 +841,24 @@ dns_resolver_getquerystats(dns_resolver_t *res, dns_stats_t **statsp);
  *
  *\li	'statsp' != NULL && '*statsp' != NULL
  */
+
+void
+dns_resolver_slowzones(dns_resolver_t *res, isc_mem_t *mctx,
+		       dns_resslowzone_t **zonesp, size_t *countp);
+/*%<
+ * Take a snapshot of the delegations with the most cumulative fetch
+ * time, sorted by decreasing time.  A bounded number of delegations is
+ * tracked, so the counters of a delegation are reset when it drops out
+ * of the table and comes back.  The array is allocated from 'mctx' and
+ * must be freed by the caller with
+ * isc_mem_put(mctx, *zonesp, *countp * sizeof(**zonesp)) when '*countp'
+ * is not zero.
+ *
+ * Requires:
+ * \li	'res' is valid.
+ *
+ *\li	'zonesp' != NULL && '*zonesp' == NULL
+ *
+ *\li	'countp' != NULL
+ */
 ISC_LANG_ENDDECLS
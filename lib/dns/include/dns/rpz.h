@@ -16,6 +16,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/atomic.h>
 #include <isc/deprecated.h>
 #include <isc/event.h>
 #include <isc/ht.h>
@@ -161,6 +162,10 @@ struct dns_rpz_zone {
 					 * on */
 	bool	     addsoa;		/* add soa to the additional section */
 	isc_timer_t *updatetimer;
+	char	    *journal;		/* zone's journal file */
+	uint32_t     serial;		/* serial the summary was built from */
+	bool	     serialvalid;	/* 'serial' can start a journal diff */
+	char	    *updjournal;	/* journal the update is reading */
 };
 
 /*
@@ -265,6 +270,16 @@ struct dns_rpz_zones {
 	dns_rpz_cidr_node_t *cidr;
 	dns_rbt_t	    *rbt;
 
+	/*
+	 * The generation of 'cidr' and 'rbt' is bumped under the write
+	 * lock whenever a trigger is added or deleted.  Each loop thread
+	 * keeps a cache of recent search results that are only valid for
+	 * the generation they were found in.
+	 */
+	atomic_uint_fast32_t generation;
+	uint32_t	     ncaches;
+	struct dns_rpz_cache **caches;
+
 	/*
 	 * DNSRPZ librpz configuration string and handle on librpz connection
 	 */
@@ -398,6 +413,9 @@ dns_rpz_new_zone(dns_rpz_zones_t *rpzs, dns_rpz_zone_t **rpzp);
 isc_result_t
 dns_rpz_dbupdate_callback(dns_db_t *db, void *fn_arg);
 
+void
+dns_rpz_setjournal(dns_rpz_zone_t *rpz, const char *journal);
+
 void
 dns_rpz_attach_rpzs(dns_rpz_zones_t *source, dns_rpz_zones_t **target);
 
@@ -20,7 +20,9 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/atomic.h>
 #include <isc/lang.h>
+#include <isc/mutex.h>
 
 #include <dns/fixedname.h>
 #include <dns/rdata.h>
@@ -188,16 +190,51 @@ struct dns_rrl_qname_buf {
 typedef struct dns_rrl_rate dns_rrl_rate_t;
 struct dns_rrl_rate {
 	int	    r;
-	int	    scaled;
+	atomic_int  scaled;
 	const char *str;
 };
 
+/*
+ * A shard of the rate-limit database.  Clients are spread over the
+ * shards by their (masked) address, so all the entries of a client
+ * are in the same shard and each shard has a lock of its own.
+ */
+typedef struct dns_rrl	      dns_rrl_t;
+typedef struct dns_rrl_shard dns_rrl_shard_t;
+struct dns_rrl_shard {
+	isc_mutex_t lock;
+	dns_rrl_t  *rrl;
+
+	int num_entries;
+
+	unsigned int probes;
+	unsigned int searches;
+
+	ISC_LIST(dns_rrl_block_t) blocks;
+	ISC_LIST(dns_rrl_entry_t) lru;
+
+	dns_rrl_hash_t *hash;
+	dns_rrl_hash_t *old_hash;
+	unsigned int	hash_gen;
+
+	unsigned int ts_gen;
+#define DNS_RRL_TS_BASES (1 << DNS_RRL_TS_GEN_BITS)
+	isc_stdtime_t ts_bases[DNS_RRL_TS_BASES];
+
+	isc_stdtime_t	 log_stops_time;
+	dns_rrl_entry_t *last_logged;
+	int		 num_logged;
+	int		 num_qnames;
+	ISC_LIST(dns_rrl_qname_buf_t) qname_free;
+#define DNS_RRL_QNAMES (1 << DNS_RRL_QNAMES_BITS)
+	dns_rrl_qname_buf_t *qnames[DNS_RRL_QNAMES];
+};
+
 /*
  * Per-view query rate limit parameters and a pointer to database.
  */
-typedef struct dns_rrl dns_rrl_t;
 struct dns_rrl {
-	isc_mutex_t lock;
+	isc_mutex_t lock; /* protects the qps estimate */
 	isc_mem_t  *mctx;
 
 	bool	       log_only;
@@ -214,38 +251,17 @@ struct dns_rrl {
 
 	dns_acl_t *exempt;
 
-	int num_entries;
-
 	int	      qps_responses;
 	isc_stdtime_t qps_time;
 	double	      qps;
 
-	unsigned int probes;
-	unsigned int searches;
-
-	ISC_LIST(dns_rrl_block_t) blocks;
-	ISC_LIST(dns_rrl_entry_t) lru;
-
-	dns_rrl_hash_t *hash;
-	dns_rrl_hash_t *old_hash;
-	unsigned int	hash_gen;
-
-	unsigned int ts_gen;
-#define DNS_RRL_TS_BASES (1 << DNS_RRL_TS_GEN_BITS)
-	isc_stdtime_t ts_bases[DNS_RRL_TS_BASES];
-
 	int	 ipv4_prefixlen;
 	uint32_t ipv4_mask;
 	int	 ipv6_prefixlen;
 	uint32_t ipv6_mask[4];
 
-	isc_stdtime_t	 log_stops_time;
-	dns_rrl_entry_t *last_logged;
-	int		 num_logged;
-	int		 num_qnames;
-	ISC_LIST(dns_rrl_qname_buf_t) qname_free;
-#define DNS_RRL_QNAMES (1 << DNS_RRL_QNAMES_BITS)
-	dns_rrl_qname_buf_t *qnames[DNS_RRL_QNAMES];
+	unsigned int	 nshards;
+	dns_rrl_shard_t *shards;
 };
 
 typedef enum {
@@ -53,6 +53,9 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/job.h>
+#include <isc/loop.h>
+
 #include <dns/clientinfo.h>
 #include <dns/dlz.h>
 
@@ -87,6 +90,26 @@ typedef isc_result_t (*dns_sdlzallnodesfunc_t)(const char *zone,
  * does not have to implement an all nodes method.
  */
 
+typedef isc_result_t (*dns_sdlzallnodesfromfunc_t)(
+	const char *zone, const char *start, unsigned int maxnodes,
+	void *driverarg, void *dbdata, dns_sdlzallnodes_t *allnodes);
+/*%<
+ * Method prototype.  Drivers implementing the SDLZ interface may
+ * supply an all nodes from method, which is used instead of the all
+ * nodes method to traverse a zone in chunks, so that a zone transfer
+ * does not need the whole zone in memory at once.
+ *
+ * The method adds the records of the names of 'zone' in DNSSEC
+ * canonical order, starting with 'start' if it exists or else the
+ * next name after it, or with the apex of the zone if 'start' is NULL.
+ * It should stop after 'maxnodes' names; adding fewer names means
+ * that the end of the zone has been reached.  All the records of a name
+ * must be added in the same call.
+ *
+ * The method should return ISC_R_NOTIMPLEMENTED to have the all nodes
+ * method used instead.
+ */
+
 typedef isc_result_t (*dns_sdlzallowzonexfr_t)(void *driverarg, void *dbdata,
 					       const char *name,
 					       const char *client);
@@ -287,6 +310,7 @@ typedef struct dns_sdlzmethods {
 	dns_sdlzmodrdataset_t	addrdataset;
 	dns_sdlzmodrdataset_t	subtractrdataset;
 	dns_sdlzdelrdataset_t	delrdataset;
+	dns_sdlzallnodesfromfunc_t allnodesfrom;
 } dns_sdlzmethods_t;
 
 isc_result_t
@@ -312,6 +336,63 @@ dns_sdlzunregister(dns_sdlzimplementation_t **sdlzimp);
  * function is called.
  */
 
+isc_result_t
+dns_sdlz_setcache(dns_dlzdb_t *dlzdatabase, dns_ttl_t maxttl,
+		  dns_ttl_t maxncachettl);
+/*%<
+ * Cache the results of the lookups made in 'dlzdatabase': the names
+ * found for the smallest TTL of their records, at most 'maxttl'
+ * seconds, and the names not found for 'maxncachettl' seconds.  A limit
+ * of 0 disables caching of that kind of result.
+ *
+ * Concurrent lookups of the same name wait for the first one instead
+ * of all being sent to the driver.  The cache is flushed whenever an
+ * update to a writeable zone is committed.
+ *
+ * The client is not part of the cache key, so a cache must not be set
+ * up for a driver whose answers depend on the client.
+ *
+ * Requires:
+ *\li	'dlzdatabase' is a valid DLZ database, not yet searched, without
+ *	a cache.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTIMPLEMENTED	'dlzdatabase' does not use an SDLZ
+ *				driver.
+ */
+
+bool
+dns_sdlz_wouldblock(dns_db_t *db, const dns_name_t *name,
+		    unsigned int options);
+/*%<
+ * Return true if finding 'name' in 'db' with 'options' would wait for
+ * the driver: 'db' is a database of an SDLZ driver with a lookup cache
+ * (see dns_sdlz_setcache()) which has no answer for 'name' yet.
+ *
+ * Requires:
+ *\li	'db' is a valid database.
+ */
+
+void
+dns_sdlz_prefetch(dns_db_t *db, const dns_name_t *name, dns_rdatatype_t type,
+		  unsigned int options, isc_loop_t *loop, isc_job_cb cb,
+		  void *cbarg);
+/*%<
+ * Find 'name' and 'type' in 'db' with 'options' in a worker thread,
+ * which leaves the answers of the driver in the lookup cache, then call
+ * 'cb' with 'cbarg' on 'loop'.  A lookup made after that does not wait
+ * for the driver unless the answers were not cacheable.
+ *
+ * The lookup is made without client information, as the cache does
+ * not depend on the client.
+ *
+ * Requires:
+ *\li	'db' is a database of an SDLZ driver.
+ *\li	'name' is a valid absolute name.
+ *\li	'loop' is a valid loop and 'cb' is not NULL.
+ */
+
 typedef isc_result_t
 dns_sdlz_putnamedrr_t(dns_sdlzallnodes_t *allnodes, const char *name,
 		      const char *type, dns_ttl_t ttl, const char *data);
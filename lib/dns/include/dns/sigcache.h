@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*****
+***** Module Info
+*****/
+
+/*! \file dns/sigcache.h
+ * \brief
+ * Defines dns_sigcache_t, a cache of signature verification outcomes.
+ *
+ * Notes:
+ *\li	A signature cache remembers whether an RRSIG was found to be
+ *	valid or invalid for a given RRset and DNSKEY, so that the same
+ *	signature does not have to be verified again when the RRset is
+ *	revalidated, e.g. after it expired from the cache or when it is
+ *	looked up through another view sharing the same cache.
+ *
+ *\li	Entries are keyed by a digest of the owner name, the RRset in
+ *	canonical order, the RRSIG rdata and the DNSKEY, and are kept
+ *	until the signature expires at the latest.  The cache has a
+ *	fixed number of slots; a new entry replaces whatever was in its
+ *	slot.
+ *
+ * MP:
+ *\li	All functions are thread-safe.
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/stdtime.h>
+
+#include <dns/types.h>
+
+#include <dst/dst.h>
+
+/*%
+ * Length of the digest identifying a signature.
+ */
+#define DNS_SIGCACHE_DIGESTLENGTH 32
+
+/*%
+ * Default number of slots in a signature cache.
+ */
+#define DNS_SIGCACHE_DEFAULTSIZE 16384
+
+ISC_LANG_BEGINDECLS
+
+/***
+ ***	Functions
+ ***/
+
+void
+dns_sigcache_create(isc_mem_t *mctx, unsigned int size,
+		    dns_sigcache_t **cachep);
+/*%<
+ * Allocate an empty signature cache with at least 'size' slots (the
+ * number is rounded up to a power of two) and store it in '*cachep'.
+ *
+ * Requires:
+ * \li	'mctx' is a valid memory context.
+ * \li	'size' > 0.
+ * \li	'cachep' != NULL && '*cachep' == NULL.
+ */
+
+void
+dns_sigcache_destroy(dns_sigcache_t **cachep);
+/*%<
+ * Free the signature cache in '*cachep'.  '*cachep' is set to NULL on
+ * return.
+ */
+
+void
+dns_sigcache_flush(dns_sigcache_t *cache);
+/*%<
+ * Discard all entries.
+ */
+
+isc_result_t
+dns_sigcache_digest(const dns_name_t *name, dns_rdataset_t *rdataset,
+		    dst_key_t *key, dns_rdata_t *sigrdata,
+		    unsigned int maxbits, isc_mem_t *mctx,
+		    unsigned char *digest);
+/*%<
+ * Compute the digest identifying the verification of 'sigrdata' over
+ * 'rdataset' at 'name' with 'key', using at most 'maxbits' of RSA
+ * exponent, and store it in 'digest', which must have room for
+ * #DNS_SIGCACHE_DIGESTLENGTH bytes.  The order of the records in
+ * 'rdataset' and the case of the names do not change the digest.
+ *
+ * Requires:
+ * \li	'rdataset' is a valid rdataset.
+ * \li	'key' is a valid key.
+ * \li	'sigrdata' is an RRSIG.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	Errors from the message digest or rdata functions.
+ */
+
+isc_result_t
+dns_sigcache_find(dns_sigcache_t *cache, const unsigned char *digest,
+		  isc_stdtime_t now, isc_result_t *resultp, uint32_t *costp);
+/*%<
+ * Look up the outcome of the verification identified by 'digest'.
+ *
+ * If found, '*resultp' is set to the result of the verification, and
+ * '*costp' (if not NULL) to the time it took, in microseconds.
+ *
+ * Requires:
+ * \li	'cache' is a valid signature cache.
+ * \li	'digest' != NULL and 'resultp' != NULL.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTFOUND	nothing is cached for 'digest', or the entry
+ *			has expired.
+ */
+
+void
+dns_sigcache_add(dns_sigcache_t *cache, const unsigned char *digest,
+		 isc_stdtime_t expire, isc_result_t result, uint32_t cost);
+/*%<
+ * Remember that the verification identified by 'digest' gave 'result'
+ * and took 'cost' microseconds.  The entry is not returned by
+ * dns_sigcache_find() after 'expire', which is compared using serial
+ * number arithmetic like RRSIG times.
+ *
+ * Requires:
+ * \li	'cache' is a valid signature cache.
+ * \li	'digest' != NULL.
+ */
+
+ISC_LANG_ENDDECLS
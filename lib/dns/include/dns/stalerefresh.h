@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*****
+***** Module Info
+*****/
+
+/*! \file dns/stalerefresh.h
+ * \brief
+ * Defines dns_stalerefresh_t, a queue of the stale RRsets of a view
+ * waiting to be refreshed in the background.
+ *
+ * Notes:
+ *\li	When a client is answered with a stale RRset right away
+ *	("stale-answer-client-timeout 0"), the RRset is queued here
+ *	instead of being refreshed by a fetch tied to the client.  Each
+ *	RRset is queued once however many clients are answered with it,
+ *	and the refresh queries are sent at no more than a configured
+ *	rate.
+ *
+ *\li	When a refresh fails, the RRset is not queued again until a
+ *	delay has passed, which doubles with each consecutive failure, so
+ *	that an unreachable zone costs a few queries per minute rather than
+ *	one per client.
+ *
+ * MP:
+ *\li	dns_stalerefresh_add() may be called from any thread.
+ *
+ * Resources:
+ *\li	The number of RRsets tracked by a queue is bounded; see
+ *	DNS_STALEREFRESH_MAXENTRIES.
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <isc/lang.h>
+#include <isc/loop.h>
+#include <isc/stdtime.h>
+#include <isc/task.h>
+
+#include <dns/types.h>
+
+/*%
+ * The maximum number of RRsets a queue tracks, queued, being refreshed
+ * or waiting for a retry.
+ */
+#ifndef DNS_STALEREFRESH_MAXENTRIES
+#define DNS_STALEREFRESH_MAXENTRIES 10000
+#endif
+
+ISC_LANG_BEGINDECLS
+
+/***
+ ***	Functions
+ ***/
+
+void
+dns_stalerefresh_create(dns_view_t *view, isc_loopmgr_t *loopmgr,
+			isc_taskmgr_t *taskmgr, unsigned int rate,
+			dns_stalerefresh_t **queuep);
+/*%<
+ * Create a refresh queue for 'view' sending at most 'rate' refresh
+ * queries per second, and start it on the main loop of 'loopmgr'.
+ *
+ * The queue does not hold a reference to 'view', which must call
+ * dns_stalerefresh_shutdown() before shutting down its resolver.
+ *
+ * Requires:
+ * \li	'view' is a valid view with a resolver.
+ * \li	'rate' > 0.
+ * \li	'queuep' != NULL && '*queuep' == NULL.
+ */
+
+void
+dns_stalerefresh_add(dns_stalerefresh_t *queue, const dns_name_t *name,
+		     dns_rdatatype_t type, isc_stdtime_t now);
+/*%<
+ * Queue a refresh of 'name'/'type', a stale RRset a client was answered
+ * with at 'now', unless it is already queued or being refreshed, or
+ * the last attempt failed too recently.
+ *
+ * Requires:
+ * \li	'queue' is a valid refresh queue.
+ * \li	'name' is a valid absolute name.
+ */
+
+void
+dns_stalerefresh_shutdown(dns_stalerefresh_t *queue);
+/*%<
+ * Stop refreshing RRsets and cancel the refreshes in progress.
+ *
+ * Requires:
+ * \li	'queue' is a valid refresh queue.
+ */
+
+void
+dns_stalerefresh_detach(dns_stalerefresh_t **queuep);
+/*%<
+ * Detach '*queuep', freeing the queue when the last reference is gone.
+ */
+
+ISC_LANG_ENDDECLS
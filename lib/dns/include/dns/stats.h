@@ -71,7 +71,18 @@ enum {
 	dns_resstatscounter_serverquota = 42,
 	dns_resstatscounter_nextitem = 43,
 	dns_resstatscounter_priming = 44,
-	dns_resstatscounter_max = 45,
+	dns_resstatscounter_sigcachehit = 45,
+	dns_resstatscounter_sigcachemiss = 46,
+	dns_resstatscounter_sigcachesaved = 47,
+	dns_resstatscounter_prefetchpopular = 48,
+	dns_resstatscounter_hedgesent = 49,
+	dns_resstatscounter_hedgewon = 50,
+	dns_resstatscounter_tcpreuse = 51,
+	dns_resstatscounter_stalerefresh = 52,
+	dns_resstatscounter_stalerefreshfail = 53,
+	dns_resstatscounter_forwarderquota = 54,
+	dns_resstatscounter_qmincached = 55,
+	dns_resstatscounter_max = 56,
 
 	/*
 	 * DNSSEC stats.
@@ -122,8 +133,10 @@ enum {
 	dns_cachestatscounter_deletelru = 5,
 	dns_cachestatscounter_deletettl = 6,
 	dns_cachestatscounter_coveringnsec = 7,
+	dns_cachestatscounter_colddemoted = 8,
+	dns_cachestatscounter_coldpromoted = 9,
 
-	dns_cachestatscounter_max = 8,
+	dns_cachestatscounter_max = 10,
 
 	/*%
 	 * Query statistics counters (obsolete).
@@ -142,7 +155,8 @@ enum {
 	 */
 	dns_dnstapcounter_success = 0,
 	dns_dnstapcounter_drop = 1,
-	dns_dnstapcounter_max = 2,
+	dns_dnstapcounter_nobuffer = 2,
+	dns_dnstapcounter_max = 3,
 
 	/*
 	 * Glue cache statistics counters.
@@ -444,6 +458,30 @@ enum {
 	dns_sizecounter_out_max = 257
 };
 
+/*%
+ * Query latency histograms (see isc/histo.h), one for each transport the
+ * query was received over and each source of the answer.  The values
+ * are in microseconds.
+ */
+enum {
+	dns_latency_udp = 0,
+	dns_latency_tcp = 1,
+	dns_latency_tls = 2,
+	dns_latency_https = 3,
+
+	dns_latency_transport_max = 4
+};
+
+enum {
+	dns_latency_auth = 0,	   /*%< answered from a zone */
+	dns_latency_cache = 1,	   /*%< answered from the cache */
+	dns_latency_recursion = 2, /*%< answered after recursion */
+
+	dns_latency_source_max = 3
+};
+
+#define DNS_LATENCY_SIGBITS 3
+
 #define DNS_STATS_NCOUNTERS 8
 
 #if 0
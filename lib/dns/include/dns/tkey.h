@@ -19,6 +19,8 @@
 #include <stdbool.h>
 
 #include <isc/lang.h>
+#include <isc/rwlock.h>
+#include <isc/stdtime.h>
 
 #include <dns/types.h>
 
@@ -27,6 +29,15 @@
 
 ISC_LANG_BEGINDECLS
 
+/*%
+ * Longest time, in seconds, the acceptor credentials taken from
+ * tkey-gssapi-keytab are used before they are acquired again, so that a
+ * rotated keytab is picked up.
+ */
+#ifndef DNS_TKEY_GSSCREDREFRESH
+#define DNS_TKEY_GSSCREDREFRESH 3600
+#endif
+
 /* Key agreement modes */
 #define DNS_TKEYMODE_SERVERASSIGNED   1
 #define DNS_TKEYMODE_DIFFIEHELLMAN    2
@@ -40,6 +51,9 @@ struct dns_tkeyctx {
 	dns_gss_cred_id_t gsscred;
 	isc_mem_t	 *mctx;
 	char		 *gssapi_keytab;
+	isc_rwlock_t	  keytablock;	  /*%< Locks the fields below */
+	dns_gss_cred_id_t keytabcred;	  /*%< from 'gssapi_keytab' */
+	isc_stdtime_t	  keytabrefresh;  /*%< when to acquire them again */
 };
 
 isc_result_t
@@ -17,6 +17,8 @@
 
 #include <stdbool.h>
 
+#include <isc/heap.h>
+#include <isc/ht.h>
 #include <isc/lang.h>
 #include <isc/refcount.h>
 #include <isc/rwlock.h>
@@ -54,10 +56,10 @@ extern const dns_name_t *dns_tsig_hmacsha512_name;
 #define DNS_TSIG_FUDGE 300
 
 struct dns_tsig_keyring {
-	dns_rbt_t   *keys;
-	unsigned int writecount;
-	isc_rwlock_t lock;
-	isc_mem_t   *mctx;
+	isc_ht_t     *keys;	/*%< keys by name */
+	isc_heap_t   *expiring; /*%< generated keys by expiry time */
+	isc_rwlock_t  lock;
+	isc_mem_t    *mctx;
 	/*
 	 * LRU list of generated key along with a count of the keys on the
 	 * list and a maximum size.
@@ -81,6 +83,7 @@ struct dns_tsigkey {
 	isc_stdtime_t	    expire;    /*%< end of validity period */
 	dns_tsig_keyring_t *ring;      /*%< the enclosing keyring */
 	isc_refcount_t	    refs;      /*%< reference counter */
+	unsigned int	    heapindex; /*%< position on the expiry heap */
 	ISC_LINK(dns_tsigkey_t) link;
 };
 
@@ -37,6 +37,8 @@ typedef ISC_LIST(dns_adbaddrinfo_t) dns_adbaddrinfolist_t;
 typedef struct dns_adbentry dns_adbentry_t;
 typedef struct dns_adbfind  dns_adbfind_t;
 typedef ISC_LIST(dns_adbfind_t) dns_adbfindlist_t;
+typedef struct dns_anscache	       dns_anscache_t;
+typedef struct dns_anscacheentry       dns_anscacheentry_t;
 typedef struct dns_badcache	       dns_badcache_t;
 typedef struct dns_byaddr	       dns_byaddr_t;
 typedef struct dns_catz_zonemodmethods dns_catz_zonemodmethods_t;
@@ -51,12 +53,15 @@ typedef void			       dns_clientrestrans_t;
 typedef void			       dns_clientreqtrans_t;
 typedef void			       dns_clientupdatetrans_t;
 typedef struct dns_cache	       dns_cache_t;
+typedef struct dns_coldcache	       dns_coldcache_t;
 typedef uint16_t		       dns_cert_t;
 typedef struct dns_compress	       dns_compress_t;
 typedef struct dns_db		       dns_db_t;
 typedef struct dns_dbimplementation    dns_dbimplementation_t;
 typedef struct dns_dbiterator	       dns_dbiterator_t;
+typedef struct dns_dbiteratorbatch     dns_dbiteratorbatch_t;
 typedef void			       dns_dbload_t;
+typedef struct dns_dbmemory	       dns_dbmemory_t;
 typedef void			       dns_dbnode_t;
 typedef struct dns_dbonupdatelistener  dns_dbonupdatelistener_t;
 typedef void			       dns_dbversion_t;
@@ -78,6 +83,7 @@ typedef ISC_LIST(dns_dnsseckey_t) dns_dnsseckeylist_t;
 typedef uint8_t			   dns_dsdigest_t;
 typedef struct dns_dtdata	   dns_dtdata_t;
 typedef struct dns_dtenv	   dns_dtenv_t;
+typedef struct dns_dtfilter	   dns_dtfilter_t;
 typedef struct dns_dtmsg	   dns_dtmsg_t;
 typedef uint16_t		   dns_dtmsgtype_t;
 typedef struct dns_dumpctx	   dns_dumpctx_t;
@@ -97,7 +103,9 @@ typedef struct dns_kasp_key dns_kasp_key_t;
 typedef ISC_LIST(dns_kasp_key_t) dns_kasp_keylist_t;
 typedef struct dns_kasp_nsec3param dns_kasp_nsec3param_t;
 typedef uint16_t		   dns_keyflags_t;
+typedef struct dns_keycache	   dns_keycache_t;
 typedef struct dns_keynode	   dns_keynode_t;
+typedef struct dns_keypool	   dns_keypool_t;
 typedef ISC_LIST(dns_keynode_t) dns_keynodelist_t;
 typedef struct dns_keytable	   dns_keytable_t;
 typedef uint16_t		   dns_keytag_t;
@@ -110,6 +118,8 @@ typedef uint16_t		   dns_messageid_t;
 typedef isc_region_t		   dns_label_t;
 typedef struct dns_name		   dns_name_t;
 typedef ISC_LIST(dns_name_t) dns_namelist_t;
+typedef struct dns_nsec3cache	  dns_nsec3cache_t;
+typedef struct dns_nsec3index	  dns_nsec3index_t;
 typedef struct dns_nta		  dns_nta_t;
 typedef struct dns_ntatable	  dns_ntatable_t;
 typedef uint16_t		  dns_opcode_t;
@@ -117,6 +127,8 @@ typedef unsigned char		  dns_offsets_t[128];
 typedef struct dns_order	  dns_order_t;
 typedef struct dns_peer		  dns_peer_t;
 typedef struct dns_peerlist	  dns_peerlist_t;
+typedef struct dns_prefetch	  dns_prefetch_t;
+typedef struct dns_qp		  dns_qp_t;
 typedef struct dns_rbt		  dns_rbt_t;
 typedef uint16_t		  dns_rcode_t;
 typedef struct dns_rdata	  dns_rdata_t;
@@ -133,10 +145,12 @@ typedef struct dns_resolver	     dns_resolver_t;
 typedef struct dns_sdbimplementation dns_sdbimplementation_t;
 typedef uint8_t			     dns_secalg_t;
 typedef uint8_t			     dns_secproto_t;
+typedef struct dns_sigcache	     dns_sigcache_t;
 typedef struct dns_signature	     dns_signature_t;
 typedef struct dns_sortlist_arg	     dns_sortlist_arg_t;
 typedef struct dns_ssurule	     dns_ssurule_t;
 typedef struct dns_ssutable	     dns_ssutable_t;
+typedef struct dns_stalerefresh     dns_stalerefresh_t;
 typedef struct dns_stats	     dns_stats_t;
 typedef uint32_t		     dns_rdatastatstype_t;
 typedef struct dns_tkeyctx	     dns_tkeyctx_t;
@@ -187,6 +201,11 @@ typedef enum {
 	dns_dbtree_nsec3 = 2
 } dns_dbtree_t;
 
+typedef enum {
+	dns_evictionpolicy_lru = 0,
+	dns_evictionpolicy_sieve = 1
+} dns_evictionpolicy_t;
+
 typedef enum {
 	dns_notifytype_no = 0,
 	dns_notifytype_yes = 1,
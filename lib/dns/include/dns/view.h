@@ -74,6 +74,7 @@
 #include <dns/rdatastruct.h>
 #include <dns/rpz.h>
 #include <dns/rrl.h>
+#include <dns/stats.h>
 #include <dns/transport.h>
 #include <dns/types.h>
 #include <dns/zt.h>
@@ -156,8 +157,10 @@ struct dns_view {
 	uint32_t	      nta_lifetime;
 	uint32_t	      nta_recheck;
 	char		     *nta_file;
+	char		     *adb_file;
 	dns_ttl_t	      prefetch_trigger;
 	dns_ttl_t	      prefetch_eligible;
+	dns_prefetch_t	     *prefetch;
 	in_port_t	      dstport;
 	dns_aclenv_t	     *aclenv;
 	dns_rdatatype_t	      preferred_glue;
@@ -172,10 +175,12 @@ struct dns_view {
 	bool		      staleanswersenable; /* named.conf setting
 						   * */
 	uint32_t	  staleanswerclienttimeout;
+	dns_stalerefresh_t *stalerefresh;
 	uint16_t	  nocookieudp;
 	uint16_t	  padding;
 	dns_acl_t	 *pad_acl;
 	unsigned int	  maxbits;
+	unsigned int	  offloadthreshold;
 	dns_dns64list_t	  dns64;
 	unsigned int	  dns64cnt;
 	dns_rpz_zones_t	 *rpzs;
@@ -184,6 +189,7 @@ struct dns_view {
 	dns_dlzdblist_t	  dlz_unsearched;
 	uint32_t	  fail_ttl;
 	dns_badcache_t	 *failcache;
+	dns_nsec3index_t *nsec3index;
 
 	/*
 	 * Configurable data for server use only,
@@ -227,9 +233,10 @@ struct dns_view {
 	unsigned char secret[32]; /* Client secret */
 	unsigned int  v6bias;
 
-	dns_dtenv_t    *dtenv;	 /* Dnstap environment */
-	dns_dtmsgtype_t dttypes; /* Dnstap message types
-				  * to log */
+	dns_dtenv_t    *dtenv;	  /* Dnstap environment */
+	dns_dtmsgtype_t dttypes;  /* Dnstap message types
+				   * to log */
+	dns_dtfilter_t *dtfilter; /* Dnstap message filter */
 
 	/* Registered module instances */
 	void *plugins;
@@ -238,6 +245,13 @@ struct dns_view {
 	/* Hook table */
 	void *hooktable; /* ns_hooktable */
 	void (*hooktable_free)(isc_mem_t *, void **);
+
+	/*
+	 * Query latency histograms, by transport and answer source.
+	 * Set up by the server; NULL if not configured.
+	 */
+	isc_histo_t *latencystats[dns_latency_transport_max]
+				 [dns_latency_source_max];
 };
 
 #define DNS_VIEW_MAGIC	     ISC_MAGIC('V', 'i', 'e', 'w')
@@ -1223,6 +1237,26 @@ dns_view_loadnta(dns_view_t *view);
  *\li	'view' to be valid.
  */
 
+isc_result_t
+dns_view_saveadb(dns_view_t *view);
+/*%<
+ * Save what the view's ADB knows about remote servers to a file
+ * (see dns_adb_save()).
+ *
+ * Requires:
+ *\li	'view' to be valid.
+ */
+
+isc_result_t
+dns_view_loadadb(dns_view_t *view);
+/*%<
+ * Seed the view's ADB from the file written by dns_view_saveadb();
+ * entries that have expired since are skipped.
+ *
+ * Requires:
+ *\li	'view' to be valid.
+ */
+
 void
 dns_view_setviewcommit(dns_view_t *view);
 /*%<
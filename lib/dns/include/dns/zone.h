@@ -26,10 +26,12 @@
 #include <isc/formatcheck.h>
 #include <isc/lang.h>
 #include <isc/rwlock.h>
+#include <isc/sockaddr.h>
 #include <isc/tls.h>
 
 #include <dns/catz.h>
 #include <dns/diff.h>
+#include <dns/keypool.h>
 #include <dns/master.h>
 #include <dns/masterdump.h>
 #include <dns/rdatastruct.h>
@@ -99,6 +101,10 @@ typedef enum {
 	DNS_ZONEOPT_CHECKSPF = 1 << 27,		/*%< check SPF records */
 	DNS_ZONEOPT_CHECKTTL = 1 << 28,		/*%< check max-zone-ttl */
 	DNS_ZONEOPT_AUTOEMPTY = 1 << 29,	/*%< automatic empty zone */
+	DNS_ZONEOPT_ANSWERCACHE = 1 << 30,	/*%< answer-cache */
+	DNS_ZONEOPT_JOURNALGROUPCOMMIT = 1ULL << 31, /*%< group commit */
+	DNS_ZONEOPT_SHAREDATA = 1ULL << 32, /*%< share-zone-data */
+	DNS_ZONEOPT_RELOADINPLACE = 1ULL << 33, /*%< reload-in-place */
 	DNS_ZONEOPT___MAX = UINT64_MAX, /* trick to make the ENUM 64-bit wide */
 } dns_zoneopt_t;
 
@@ -141,6 +147,41 @@ typedef enum {
 #define DNS_ZONESTATE_ANY	   4
 #define DNS_ZONESTATE_AUTOMATIC	   5
 
+/*%
+ * Progress of the zone loads scheduled by the zone manager
+ */
+typedef struct dns_zonemgr_loadstats {
+	uint32_t active;    /*%< loads in progress */
+	uint32_t pending;   /*%< loads waiting for a slot */
+	uint64_t completed; /*%< loads finished since startup */
+	uint64_t bytes;	    /*%< zone file bytes loaded since startup */
+	uint64_t rate;	    /*%< bytes per second of the latest run */
+} dns_zonemgr_loadstats_t;
+
+/*%
+ * Progress of the zone dumps scheduled by the zone manager
+ */
+typedef struct dns_zonemgr_dumpstats {
+	uint32_t active;    /*%< dumps in progress */
+	uint32_t queued;    /*%< dumps waiting for a slot */
+	uint64_t completed; /*%< dumps finished since startup */
+	uint64_t coalesced; /*%< dumps saved by a queued dump */
+	uint64_t bytes;	    /*%< zone file bytes written since startup */
+} dns_zonemgr_dumpstats_t;
+
+/*%
+ * Traffic of the zone manager with a primary server or NOTIFY target
+ */
+typedef struct dns_zonemgr_peerstats {
+	isc_sockaddr_t addr; /*%< address of the peer */
+	uint32_t queued;     /*%< SOA queries waiting to be sent */
+	uint64_t soaqueries; /*%< SOA queries sent */
+	uint64_t notifies;   /*%< NOTIFY messages sent */
+} dns_zonemgr_peerstats_t;
+
+typedef void (*dns_zonemgr_peerdump_t)(const dns_zonemgr_peerstats_t *stats,
+				       void *arg);
+
 ISC_LANG_BEGINDECLS
 
 /***
@@ -350,6 +391,28 @@ dns_zone_getmaxrecords(dns_zone_t *zone);
  *\li	uint32_t maxrecords.
  */
 
+void
+dns_zone_setidletime(dns_zone_t *zone, uint32_t idletime);
+/*%<
+ *	Sets the number of seconds after which the database of a
+ *	secondary zone that has not been used is evicted from memory,
+ *	to be loaded back from the zone file when it is next needed.
+ *	0 implies never.
+ *
+ * Requires:
+ *\li	'zone' to be valid initialised zone.
+ */
+
+uint32_t
+dns_zone_getidletime(dns_zone_t *zone);
+/*%<
+ *	Gets the number of seconds after which the database of an
+ *	unused secondary zone is evicted from memory.  0 implies never.
+ *
+ * Requires:
+ *\li	'zone' to be valid initialised zone.
+ */
+
 void
 dns_zone_setmaxttl(dns_zone_t *zone, uint32_t maxttl);
 /*%<
@@ -503,6 +566,10 @@ dns_zone_getdb(dns_zone_t *zone, dns_db_t **dbp);
  * 	Attach '*dbp' to the database to if it exists otherwise
  *	return DNS_R_NOTLOADED.
  *
+ *	The database of a secondary zone that was evicted from memory
+ *	for being idle (see dns_zone_setidletime()) is loaded back from
+ *	the zone file first, before this returns.
+ *
  * Require:
  *\li	'zone' to be a valid zone.
  *\li	'dbp' to be != NULL && '*dbp' == NULL.
@@ -1321,6 +1388,27 @@ dns_zone_setzeronosoattl(dns_zone_t *zone, bool state);
  * Set zero-no-soa-ttl status.
  */
 
+void
+dns_zone_setanswercache(dns_zone_t *zone, bool state);
+/*%<
+ * Enable or disable caching of rendered answers for 'zone'.  Answers
+ * already cached are discarded either way.
+ *
+ * Require:
+ * \li	'zone' to be a valid zone.
+ */
+
+dns_anscache_t *
+dns_zone_getanswercache(dns_zone_t *zone);
+/*%<
+ * Return the rendered answer cache of 'zone', or NULL if answer
+ * caching is disabled.  The cache remains valid for as long as the
+ * caller holds a reference to 'zone'.
+ *
+ * Require:
+ * \li	'zone' to be a valid zone.
+ */
+
 void
 dns_zone_setchecknames(dns_zone_t *zone, dns_severity_t severity);
 /*%<
@@ -1446,6 +1534,53 @@ dns_zone_getjournal(dns_zone_t *zone);
  *\li	'zone' to be valid initialised zone.
  */
 
+isc_result_t
+dns_zone_writejournal(dns_zone_t *zone, dns_diff_t *diff);
+/*%<
+ * Write the transaction in 'diff' to the journal of 'zone', if it has
+ * one.  With DNS_ZONEOPT_JOURNALGROUPCOMMIT set, the transaction is
+ * committed to stable storage together with the others written before
+ * the zone task gets to sync the journal; until then, the result of
+ * the transaction must only be reported through
+ * dns_zone_sendafterjournal().
+ *
+ * Requires:
+ *\li	'zone' to be a valid zone.
+ *\li	'diff' to hold a complete transaction.
+ */
+
+void
+dns_zone_sendafterjournal(dns_zone_t *zone, isc_task_t *task,
+			  isc_event_t **eventp, isc_result_t *resultp);
+/*%<
+ * Send '*eventp' to 'task' once all the transactions written with
+ * dns_zone_writejournal() are on stable storage, or right away if
+ * there are none pending.  If they cannot be synced, '*resultp' is
+ * set to the error unless it already holds one.
+ *
+ * Requires:
+ *\li	'zone' to be a valid zone.
+ *\li	'eventp' != NULL && '*eventp' != NULL.
+ *\li	'resultp' to remain valid until the event is sent.
+ */
+
+isc_result_t
+dns_zone_getcompactprogress(dns_zone_t *zone, uint64_t *copiedp,
+			    uint64_t *totalp);
+/*%<
+ * If the journal of 'zone' is being compacted in the background, set
+ * '*copiedp' and '*totalp' to the number of bytes of transactions
+ * copied so far and to be copied in all.
+ *
+ * Requires:
+ *\li	'zone' to be a valid zone.
+ *\li	'copiedp' and 'totalp' to be non NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTFOUND	no compaction is in progress.
+ */
+
 dns_zonetype_t
 dns_zone_gettype(dns_zone_t *zone);
 /*%<
@@ -1927,6 +2062,127 @@ dns_zonemgr_getiolimit(dns_zonemgr_t *zmgr);
  *\li	'zmgr' to be a valid zone manager.
  */
 
+void
+dns_zonemgr_setloadlimit(dns_zonemgr_t *zmgr, uint32_t loadlimit);
+/*%<
+ *	Set the number of zone loads started by dns_zone_asyncload()
+ *	that may be in progress at the same time.  The others wait in
+ *	the zone manager, without a database, until a slot is free:
+ *	first loads of primary zones are started first, then first loads
+ *	of the other zones, then reloads of zones that are already
+ *	serving.
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager.
+ *\li	'loadlimit' to be positive.
+ */
+
+uint32_t
+dns_zonemgr_getloadlimit(dns_zonemgr_t *zmgr);
+/*%<
+ *	Get the number of zone loads that may be in progress at the same
+ *	time.
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager.
+ */
+
+void
+dns_zonemgr_setdumplimit(dns_zonemgr_t *zmgr, uint32_t dumplimit);
+/*%<
+ *	Set the number of zone dumps that may be in progress at the same
+ *	time.  The others wait in the zone manager until a slot is free:
+ *	dumps of zones being flushed are started first, then those of
+ *	primary and key zones, then the others.  Changes made to a zone
+ *	while its dump waits are written by that same dump.
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager.
+ *\li	'dumplimit' to be positive.
+ */
+
+uint32_t
+dns_zonemgr_getdumplimit(dns_zonemgr_t *zmgr);
+/*%<
+ *	Get the number of zone dumps that may be in progress at the same
+ *	time.
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager.
+ */
+
+void
+dns_zonemgr_dumppeers(dns_zonemgr_t *zmgr, dns_zonemgr_peerdump_t dump,
+		      void *arg);
+/*%<
+ *	Call 'dump' with the traffic to each peer the zone manager has
+ *	sent SOA queries or NOTIFY messages to.  SOA queries wait in the
+ *	zone manager to be sent at the "serial-query-rate", and those to
+ *	the same peer are sent in a row.  'dump' must not call back into
+ *	the zone manager.
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager.
+ *\li	'dump' is not NULL.
+ */
+
+void
+dns_zonemgr_setkeypooldepth(dns_zonemgr_t *zmgr, uint32_t depth);
+/*%<
+ *	Set the number of spare keys of each algorithm and size that are
+ *	generated ahead of time for the key rollovers of the zones with a
+ *	DNSSEC policy (see dns/keypool.h).  Zero, the default, keeps none,
+ *	and the keys are generated when they are needed.
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager.
+ */
+
+uint32_t
+dns_zonemgr_getkeypooldepth(dns_zonemgr_t *zmgr);
+/*%<
+ *	Get the number of spare keys of each algorithm and size that are
+ *	generated ahead of time.
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager.
+ */
+
+void
+dns_zonemgr_dumpkeypool(dns_zonemgr_t *zmgr, dns_keypool_dump_t dump,
+			void *arg);
+/*%<
+ *	Call 'dump' with the spare keys of each algorithm and size that
+ *	were asked for.  'dump' must not call back into the zone manager.
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager.
+ *\li	'dump' is not NULL.
+ */
+
+void
+dns_zonemgr_getloadstats(dns_zonemgr_t *zmgr, dns_zonemgr_loadstats_t *stats);
+/*%<
+ *	Fill in '*stats' with the progress of the scheduled zone loads.
+ *	The rate is that of the latest run of loads, from the time the
+ *	first of them was queued to now, or to the time the last of
+ *	them finished.
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager.
+ *\li	'stats' is not NULL.
+ */
+
+void
+dns_zonemgr_getdumpstats(dns_zonemgr_t *zmgr, dns_zonemgr_dumpstats_t *stats);
+/*%<
+ *	Fill in '*stats' with the progress of the scheduled zone dumps.
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager.
+ *\li	'stats' is not NULL.
+ */
+
 void
 dns_zonemgr_setcheckdsrate(dns_zonemgr_t *zmgr, unsigned int value);
 /*%<
@@ -2243,6 +2499,24 @@ dns_zone_setcheckns(dns_zone_t *zone, dns_checknsfunc_t checkns);
  *	'zone' to be a valid zone.
  */
 
+void
+dns_zone_setloadthreads(dns_zone_t *zone, unsigned int nthreads);
+/*%<
+ *	Let a zone loaded without a zone manager, as by named-checkzone,
+ *	use up to 'nthreads' threads: a large text zone file is then
+ *	parsed in parallel (see DNS_MASTER_PARALLEL), and the duplicate
+ *	record and integrity checks run on batches of names in parallel.
+ *	Messages logged by the checks are written in zone order, as if
+ *	the checks had run serially.  The check callbacks ('checkmx',
+ *	'checksrv' and 'checkns') must then be thread-safe.
+ *
+ *	The default, 0, and 1 mean that everything is done in the
+ *	calling thread.
+ *
+ * Require:
+ *	'zone' to be a valid zone.
+ */
+
 void
 dns_zone_setnotifydelay(dns_zone_t *zone, uint32_t delay);
 /*%<
@@ -2294,6 +2568,19 @@ dns_zone_getsignatures(dns_zone_t *zone);
  * Get the number of signatures that will be generated per quantum.
  */
 
+void
+dns_zone_setsigningthreads(dns_zone_t *zone, uint32_t threads);
+/*%<
+ * Set the number of threads that generate the signatures of a quantum.
+ * A value of zero is treated as one.
+ */
+
+uint32_t
+dns_zone_getsigningthreads(dns_zone_t *zone);
+/*%<
+ * Get the number of threads that generate the signatures of a quantum.
+ */
+
 isc_result_t
 dns_zone_signwithkey(dns_zone_t *zone, dns_secalg_t algorithm, uint16_t keyid,
 		     bool deleteit);
@@ -2383,6 +2670,26 @@ dns_zone_getadded(dns_zone_t *zone);
  * \li	'zone' to be valid.
  */
 
+void
+dns_zone_setcfghash(dns_zone_t *zone, uint64_t cfghash);
+/*%
+ * Record a fingerprint of the configuration the zone has been
+ * configured with, so that the reconfiguration of an unchanged zone
+ * can be skipped.  0 means that the configuration is unknown.
+ *
+ * Requires:
+ * \li	'zone' to be valid.
+ */
+
+uint64_t
+dns_zone_getcfghash(dns_zone_t *zone);
+/*%
+ * Returns the fingerprint set by dns_zone_setcfghash().
+ *
+ * Requires:
+ * \li	'zone' to be valid.
+ */
+
 void
 dns_zone_setautomatic(dns_zone_t *zone, bool automatic);
 /*%
@@ -2561,6 +2868,31 @@ dns_zone_getloadtime(dns_zone_t *zone, isc_time_t *loadtime);
  * Return the time when the zone was last loaded.
  */
 
+uint64_t
+dns_zone_getloadduration(dns_zone_t *zone);
+/*%
+ * Return how long, in microseconds, the last successful load of the
+ * zone from its file or database took, or 0 if it has not been loaded.
+ */
+
+isc_result_t
+dns_zone_getmemory(dns_zone_t *zone, dns_dbmemory_t *memory,
+		   size_t *journalp);
+/*%
+ * Return the memory used by the zone's database in '*memory' (see
+ * dns_db_getmemory()), and the memory used by the journal the zone keeps
+ * open between group commits in '*journalp'.
+ *
+ * Requires:
+ * \li	'zone' to be a valid zone.
+ * \li	'memory' and 'journalp' to be non NULL.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#DNS_R_NOTLOADED - the zone has no database.
+ * \li	#ISC_R_NOTIMPLEMENTED - the database does not count its memory.
+ */
+
 isc_result_t
 dns_zone_getrefreshtime(dns_zone_t *zone, isc_time_t *refreshtime);
 /*%
@@ -40,11 +40,15 @@ ISC_LANG_BEGINDECLS
  *
  * If 'secroots' is not NULL, mark the DNSKEY RRset as secure if it is
  * correctly signed by at least one key present in 'secroots'.
+ *
+ * If 'nthreads' is greater than 1, the signatures are verified in
+ * batches by up to 'nthreads' threads; the zone walk and the NSEC and
+ * NSEC3 chain checks stay in the calling thread.
  */
 isc_result_t
 dns_zoneverify_dnssec(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *ver,
 		      dns_name_t *origin, dns_keytable_t *secroots,
 		      isc_mem_t *mctx, bool ignore_kskflag, bool keyset_kskonly,
-		      void (*report)(const char *, ...));
+		      unsigned int nthreads, void (*report)(const char *, ...));
 
 ISC_LANG_ENDDECLS
@@ -72,7 +72,8 @@ dns_zt_mount(dns_zt_t *zt, dns_zone_t *zone);
 isc_result_t
 dns_zt_unmount(dns_zt_t *zt, dns_zone_t *zone);
 /*%<
- * Unmount the given zone from the table.
+ * Unmount the given zone from the table.  This waits until no lookup
+ * that runs without the table lock can still be using the zone.
  *
  * Requires:
  * 	'zt' to be valid
@@ -95,6 +96,9 @@ dns_zt_find(dns_zt_t *zt, const dns_name_t *name, unsigned int options,
  * \li	If the DNS_ZTFIND_NOEXACT is set, the best partial match (if any)
  *	to 'name' will be returned.
  *
+ * \li	On a loop thread an absolute 'name' is looked up without taking
+ *	the table lock, by hashing each of its suffixes, longest first.
+ *
  * Requires:
  * \li	'zt' to be valid
  * \li	'name' to be valid
@@ -42,8 +42,9 @@ ISC_LANG_BEGINDECLS
  * to set attributes, new accessor functions will be written.
  */
 
-typedef struct dst_key	   dst_key_t;
-typedef struct dst_context dst_context_t;
+typedef struct dst_key	       dst_key_t;
+typedef struct dst_context     dst_context_t;
+typedef struct dst_batchverify dst_batchverify_t;
 
 /*%
  * Key states for the DNSSEC records related to a key: DNSKEY, RRSIG (ksk),
@@ -317,6 +318,81 @@ dst_context_verify2(dst_context_t *dctx, unsigned int maxbits,
  * \li	"sig" will contain the signature
  */
 
+void
+dst_batchverify_create(isc_mem_t *mctx, unsigned int size,
+		       unsigned int maxbits, dst_batchverify_t **batchp);
+/*%<
+ * Creates a batch that can hold up to 'size' signature verifications.
+ * 'maxbits' is passed to dst_context_verify2() for algorithms that
+ * have no batch implementation.
+ *
+ * Algorithms providing a batch implementation (currently ECDSA and
+ * EdDSA) verify all of their items in one call, sharing the per call
+ * setup; the outcome of each item is reported separately, so a bad
+ * signature does not affect the others.
+ *
+ * Requires:
+ * \li	"mctx" is a valid memory context.
+ * \li	"size" > 0.
+ * \li	batchp != NULL && *batchp == NULL
+ */
+
+void
+dst_batchverify_add(dst_batchverify_t *batch, dst_context_t **dctxp,
+		    const isc_region_t *sig);
+/*%<
+ * Adds the verification of 'sig' against the data already added to
+ * '*dctxp' to the batch.  The batch takes over the context, which is
+ * destroyed with the batch, and copies the signature.  Items are
+ * numbered in the order they were added, starting with 0.
+ *
+ * Requires:
+ * \li	"batch" is a valid batch which has not been run and is not full.
+ * \li	"*dctxp" is a valid verification context.
+ * \li	"sig" is a valid region.
+ *
+ * Ensures:
+ * \li	*dctxp == NULL
+ */
+
+void
+dst_batchverify_run(dst_batchverify_t *batch);
+/*%<
+ * Verifies all the signatures in the batch.
+ *
+ * Requires:
+ * \li	"batch" is a valid batch which has not been run.
+ */
+
+unsigned int
+dst_batchverify_count(const dst_batchverify_t *batch);
+/*%<
+ * Returns the number of items in the batch.
+ */
+
+isc_result_t
+dst_batchverify_result(const dst_batchverify_t *batch, unsigned int i);
+/*%<
+ * Returns the outcome of the verification of item 'i', as
+ * dst_context_verify2() would have returned it.
+ *
+ * Requires:
+ * \li	"batch" is a valid batch which has been run.
+ * \li	"i" < dst_batchverify_count(batch).
+ */
+
+void
+dst_batchverify_destroy(dst_batchverify_t **batchp);
+/*%<
+ * Destroys the batch, including the contexts and signatures it holds.
+ *
+ * Requires:
+ * \li	batchp != NULL && *batchp is a valid batch.
+ *
+ * Ensures:
+ * \li	*batchp == NULL
+ */
+
 isc_result_t
 dst_key_computesecret(const dst_key_t *pub, const dst_key_t *priv,
 		      isc_buffer_t *secret);
@@ -879,6 +955,18 @@ dst_key_setflags(dst_key_t *key, uint32_t flags);
  *	"key" is a valid key.
  */
 
+void
+dst_key_setowner(dst_key_t *key, const dns_name_t *name,
+		 dns_rdataclass_t rdclass);
+/*%<
+ * Give a newly generated key to 'name' in class 'rdclass'.  The key ID
+ * does not change.
+ *
+ * Requires:
+ *	"key" is a valid key.
+ *	"name" is an absolute name.
+ */
+
 isc_result_t
 dst_key_getbool(const dst_key_t *key, int type, bool *valuep);
 /*%<
@@ -57,6 +57,26 @@ dst_gssapi_acquirecred(const dns_name_t *name, bool initiate,
  *		other		  an error occurred while building the message
  */
 
+isc_result_t
+dst_gssapi_acquirekeytab(const char *gssapi_keytab, dns_gss_cred_id_t *cred,
+			 uint32_t *lifetimep);
+/*
+ *	Acquires the GSS credentials of every principal of a keytab, for
+ *	accepting contexts.
+ *
+ *	Requires:
+ *	'gssapi_keytab'	is the path of the keytab
+ *      'cred'          is a pointer to NULL, which will be allocated with
+ *			the credential handle.  Call dst_gssapi_releasecred
+ *			to free the memory.
+ *	'lifetimep'	is a pointer to receive the number of seconds the
+ *			credentials remain valid
+ *
+ *	Returns:
+ *		ISC_R_SUCCESS	the credentials were acquired
+ *		other		an error occurred while acquiring them
+ */
+
 isc_result_t
 dst_gssapi_releasecred(dns_gss_cred_id_t *cred);
 /*
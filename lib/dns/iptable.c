@@ -23,6 +23,13 @@
 static void
 destroy_iptable(dns_iptable_t *dtab);
 
+static void
+discard_compiled(dns_iptable_t *tab) {
+	if (tab->compiled != NULL) {
+		isc_radix_compiled_destroy(&tab->compiled);
+	}
+}
+
 /*
  * Create a new IP table and the underlying radix structure
  */
@@ -36,6 +43,7 @@ dns_iptable_create(isc_mem_t *mctx, dns_iptable_t **target) {
 	isc_mem_attach(mctx, &tab->mctx);
 	isc_refcount_init(&tab->refcount, 1);
 	tab->radix = NULL;
+	tab->compiled = NULL;
 	tab->magic = DNS_IPTABLE_MAGIC;
 
 	result = isc_radix_create(mctx, &tab->radix, RADIX_MAXBITS);
@@ -68,6 +76,8 @@ dns_iptable_addprefix(dns_iptable_t *tab, const isc_netaddr_t *addr,
 	INSIST(DNS_IPTABLE_VALID(tab));
 	INSIST(tab->radix != NULL);
 
+	discard_compiled(tab);
+
 	NETADDR_TO_PREFIX_T(addr, pfx, bitlen);
 
 	result = isc_radix_insert(tab->radix, &node, NULL, &pfx);
@@ -108,6 +118,8 @@ dns_iptable_merge(dns_iptable_t *tab, dns_iptable_t *source, bool pos) {
 	isc_radix_node_t *node, *new_node;
 	int i, max_node = 0;
 
+	discard_compiled(tab);
+
 	RADIX_WALK(source->radix->head, node) {
 		new_node = NULL;
 		result = isc_radix_insert(tab->radix, &new_node, node, NULL);
@@ -141,6 +153,29 @@ dns_iptable_merge(dns_iptable_t *tab, dns_iptable_t *source, bool pos) {
 	return (ISC_R_SUCCESS);
 }
 
+void
+dns_iptable_compile(dns_iptable_t *tab) {
+	REQUIRE(DNS_IPTABLE_VALID(tab));
+
+	discard_compiled(tab);
+	isc_radix_compile(tab->radix, &tab->compiled);
+}
+
+isc_result_t
+dns_iptable_search(dns_iptable_t *tab, const isc_prefix_t *prefix,
+		   isc_radix_node_t **target) {
+	REQUIRE(DNS_IPTABLE_VALID(tab));
+
+	if (tab->compiled != NULL &&
+	    (prefix->family == AF_INET || prefix->family == AF_INET6))
+	{
+		return (isc_radix_compiled_search(tab->compiled, target,
+						  prefix));
+	}
+
+	return (isc_radix_search(tab->radix, target, (isc_prefix_t *)prefix));
+}
+
 void
 dns_iptable_attach(dns_iptable_t *source, dns_iptable_t **target) {
 	REQUIRE(DNS_IPTABLE_VALID(source));
@@ -164,6 +199,8 @@ static void
 destroy_iptable(dns_iptable_t *dtab) {
 	REQUIRE(DNS_IPTABLE_VALID(dtab));
 
+	discard_compiled(dtab);
+
 	if (dtab->radix != NULL) {
 		isc_radix_destroy(dtab->radix, NULL);
 		dtab->radix = NULL;
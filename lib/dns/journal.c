@@ -17,6 +17,8 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#include <isc/ascii.h>
+#include <isc/atomic.h>
 #include <isc/dir.h>
 #include <isc/file.h>
 #include <isc/mem.h>
@@ -110,6 +112,9 @@
 static isc_result_t
 index_to_disk(dns_journal_t *);
 
+static isc_result_t
+journal_write_header(dns_journal_t *);
+
 static uint32_t
 decode_uint32(unsigned char *p) {
 	return (((uint32_t)p[0] << 24) + ((uint32_t)p[1] << 16) +
@@ -336,6 +341,18 @@ struct dns_journal {
 	unsigned char *rawindex;     /*%< In-core buffer for journal index
 				      * in on-disk format */
 	journal_pos_t *index;	     /*%< In-core journal index */
+	journal_pos_t *xindex;	     /*%< Position of every transaction,
+				      *   built on the first lookup */
+	unsigned int xindexlen;	     /*%< Entries used in 'xindex' */
+	unsigned int xindexsize;     /*%< Entries allocated in 'xindex' */
+	unsigned char *xbloom;	     /*%< Owner name filters of the first
+				      *   'xbloomlen' transactions in
+				      *   'xindex', from the sidecar index */
+	unsigned int xbloomlen;	     /*%< Entries used in 'xbloom' */
+	unsigned int xbloomsize;     /*%< Entries allocated in 'xbloom' */
+	bool defersync;		     /*%< Commits wait for
+				      *   dns_journal_sync() */
+	bool unsynced;		     /*%< Commits since the last sync */
 
 	/*% Current transaction state (when writing). */
 	struct {
@@ -367,6 +384,30 @@ struct dns_journal {
 #define DNS_JOURNAL_MAGIC    ISC_MAGIC('J', 'O', 'U', 'R')
 #define DNS_JOURNAL_VALID(t) ISC_MAGIC_VALID(t, DNS_JOURNAL_MAGIC)
 
+/*%
+ * State of a compaction run in stages by dns_journal_compact_copy()
+ * and dns_journal_compact_commit().
+ */
+struct dns_journalcompact {
+	unsigned int magic; /*%< JCMP */
+	isc_mem_t *mctx;
+	char *filename;
+	char newname[PATH_MAX];
+	char backup[PATH_MAX];
+	bool is_backup;
+	bool rewrite; /*%< Left to dns_journal_compact() */
+	uint32_t serial;
+	uint32_t target_size;
+	dns_journal_t *j2;   /*%< Compacted copy, if there is one */
+	journal_pos_t begin; /*%< First transaction of the journal, */
+	journal_pos_t end;   /*%< and end of the part copied so far */
+	atomic_uint_fast64_t copied;
+	atomic_uint_fast64_t total;
+};
+
+#define DNS_JOURNALCOMPACT_MAGIC    ISC_MAGIC('J', 'C', 'M', 'P')
+#define DNS_JOURNALCOMPACT_VALID(c) ISC_MAGIC_VALID(c, DNS_JOURNALCOMPACT_MAGIC)
+
 static void
 journal_pos_decode(journal_rawpos_t *raw, journal_pos_t *cooked) {
 	cooked->serial = decode_uint32(raw->serial);
@@ -791,6 +832,9 @@ dns_journal_open(isc_mem_t *mctx, const char *filename, unsigned int mode,
 		result = journal_open(mctx, backup, writable, writable, false,
 				      journalp);
 	}
+	if (result == ISC_R_SUCCESS && writable) {
+		(*journalp)->defersync = ((mode & DNS_JOURNAL_DEFERSYNC) != 0);
+	}
 	return (result);
 }
 
@@ -1090,6 +1134,304 @@ index_invalidate(dns_journal_t *j, uint32_t serial) {
 	}
 }
 
+/*
+ * The sidecar index "<journal>.jnx" is written by
+ * dns_journal_writeindex().  It lists the position of every
+ * transaction in the journal, so that the full index can be loaded
+ * without reading every transaction header, and a Bloom filter of the
+ * owner names changed by each transaction, so that transactions which
+ * do not touch a given name can be skipped without reading them.
+ *
+ * The journal is not updated with its sidecar: the sidecar stays usable
+ * while it describes a prefix of the journal starting at the first
+ * transaction, and transactions appended since it was written are
+ * simply not covered by it.  Compacting the journal removes it.
+ *
+ * All numbers are stored in network byte order.
+ */
+#define JNX_SUFFIX	 ".jnx"
+#define JNX_BLOOMSIZE	 128 /*%< Bytes of Bloom filter per transaction */
+#define JNX_BLOOMHASHES 3
+
+typedef struct {
+	unsigned char format[16];     /*%< ";BIND JNX V1\n" */
+	journal_rawpos_t begin;	      /*%< First transaction indexed */
+	journal_rawpos_t end;	      /*%< End of the last one */
+	unsigned char count[4];	      /*%< Number of entries */
+	unsigned char bloomsize[4];   /*%< JNX_BLOOMSIZE */
+	unsigned char reserved[24];   /*%< Zero */
+} jnx_rawheader_t;
+
+typedef struct {
+	journal_rawpos_t pos; /*%< Start of the transaction */
+	unsigned char bloom[JNX_BLOOMSIZE];
+} jnx_rawentry_t;
+
+static const char jnx_format[16] = ";BIND JNX V1\n";
+
+/*
+ * Append the position of a new transaction to the full index, if it
+ * has been built.
+ */
+static void
+xindex_add(dns_journal_t *j, journal_pos_t *pos) {
+	if (j->xindex == NULL) {
+		return;
+	}
+
+	if (j->xindexlen == j->xindexsize) {
+		unsigned int newsize = j->xindexsize * 2;
+
+		j->xindex = isc_mem_reget(j->mctx, j->xindex,
+					  j->xindexsize * sizeof(journal_pos_t),
+					  newsize * sizeof(journal_pos_t));
+		j->xindexsize = newsize;
+	}
+	j->xindex[j->xindexlen++] = *pos;
+}
+
+/*
+ * Remove the transactions before the beginning of the journal 'j'
+ * from the full index.
+ */
+static void
+xindex_purge(dns_journal_t *j) {
+	unsigned int i;
+
+	if (j->xindex == NULL) {
+		return;
+	}
+
+	for (i = 0; i < j->xindexlen; i++) {
+		if (j->xindex[i].offset >= j->header.begin.offset) {
+			break;
+		}
+	}
+	if (i > 0) {
+		memmove(j->xindex, j->xindex + i,
+			(j->xindexlen - i) * sizeof(journal_pos_t));
+		j->xindexlen -= i;
+	}
+	if (i > 0 && j->xbloom != NULL) {
+		unsigned int n = ISC_MIN(i, j->xbloomlen);
+
+		memmove(j->xbloom, j->xbloom + n * JNX_BLOOMSIZE,
+			(j->xbloomlen - n) * JNX_BLOOMSIZE);
+		j->xbloomlen -= n;
+	}
+}
+
+static void
+xbloom_free(dns_journal_t *j) {
+	if (j->xbloom != NULL) {
+		isc_mem_put(j->mctx, j->xbloom,
+			    j->xbloomsize * JNX_BLOOMSIZE);
+		j->xbloom = NULL;
+	}
+	j->xbloomlen = 0;
+	j->xbloomsize = 0;
+}
+
+static void
+xindex_free(dns_journal_t *j) {
+	if (j->xindex != NULL) {
+		isc_mem_put(j->mctx, j->xindex,
+			    j->xindexsize * sizeof(journal_pos_t));
+		j->xindex = NULL;
+	}
+	j->xindexlen = 0;
+	j->xindexsize = 0;
+	xbloom_free(j);
+}
+
+static isc_result_t
+jnx_filename(const char *filename, char *buf, size_t size) {
+	int n = snprintf(buf, size, "%s" JNX_SUFFIX, filename);
+
+	if (n < 0 || (size_t)n >= size) {
+		return (ISC_R_NOSPACE);
+	}
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Set or test the JNX_BLOOMHASHES bits of 'name' in the Bloom filter
+ * 'bloom'.  The hash must not change between runs, so FNV-1a over the
+ * lower-cased wire format is used rather than isc_hash.
+ */
+static bool
+jnx_bloom(unsigned char *bloom, const dns_name_t *name, bool add) {
+	uint64_t hash = 14695981039346656037ULL;
+	uint32_t h1, h2;
+	isc_region_t r;
+
+	dns_name_toregion(name, &r);
+	for (unsigned int i = 0; i < r.length; i++) {
+		hash ^= isc_ascii_tolower(r.base[i]);
+		hash *= 1099511628211ULL;
+	}
+
+	h1 = (uint32_t)hash;
+	h2 = (uint32_t)(hash >> 32) | 1;
+	for (unsigned int i = 0; i < JNX_BLOOMHASHES; i++) {
+		uint32_t bit = (h1 + i * h2) % (JNX_BLOOMSIZE * 8);
+
+		if (add) {
+			bloom[bit / 8] |= 1 << (bit % 8);
+		} else if ((bloom[bit / 8] & (1 << (bit % 8))) == 0) {
+			return (false);
+		}
+	}
+
+	return (true);
+}
+
+/*
+ * Load the transaction positions (and the Bloom filters if 'bloom')
+ * from the sidecar index of 'j' into its empty full index, and set
+ * '*endp' to the end of the last transaction it covers.
+ */
+static isc_result_t
+jnx_load(dns_journal_t *j, bool bloom, journal_pos_t *endp) {
+	isc_result_t result;
+	char name[PATH_MAX];
+	FILE *fp = NULL;
+	jnx_rawheader_t rawheader;
+	jnx_rawentry_t rawentry;
+	journal_pos_t begin, end, pos;
+	uint32_t count;
+
+	INSIST(j->xindexlen == 0 && j->xbloom == NULL);
+
+	CHECK(jnx_filename(j->filename, name, sizeof(name)));
+	CHECK(isc_stdio_open(name, "rb", &fp));
+	CHECK(isc_stdio_read(&rawheader, 1, sizeof(rawheader), fp, NULL));
+
+	journal_pos_decode(&rawheader.begin, &begin);
+	journal_pos_decode(&rawheader.end, &end);
+	count = decode_uint32(rawheader.count);
+
+	if (memcmp(rawheader.format, jnx_format, sizeof(jnx_format)) != 0 ||
+	    decode_uint32(rawheader.bloomsize) != JNX_BLOOMSIZE ||
+	    count == 0 || begin.serial != j->header.begin.serial ||
+	    begin.offset != j->header.begin.offset ||
+	    end.offset > j->header.end.offset)
+	{
+		FAIL(ISC_R_FAILURE);
+	}
+
+	if (bloom) {
+		j->xbloomsize = count;
+		j->xbloom = isc_mem_get(j->mctx, count * JNX_BLOOMSIZE);
+	}
+
+	for (uint32_t i = 0; i < count; i++) {
+		CHECK(isc_stdio_read(&rawentry, 1, sizeof(rawentry), fp,
+				     NULL));
+		journal_pos_decode(&rawentry.pos, &pos);
+		if (i == 0 ? (pos.offset != begin.offset ||
+			      pos.serial != begin.serial)
+			   : (pos.offset <= j->xindex[i - 1].offset ||
+			      pos.offset >= end.offset))
+		{
+			FAIL(ISC_R_FAILURE);
+		}
+		xindex_add(j, &pos);
+		if (bloom) {
+			memmove(j->xbloom + i * JNX_BLOOMSIZE, rawentry.bloom,
+				JNX_BLOOMSIZE);
+			j->xbloomlen++;
+		}
+	}
+
+	/*
+	 * Check that the sidecar still matches the journal where it ends.
+	 */
+	pos = j->xindex[count - 1];
+	CHECK(journal_next(j, &pos));
+	if (pos.serial != end.serial || pos.offset != end.offset) {
+		FAIL(ISC_R_FAILURE);
+	}
+
+	*endp = end;
+
+failure:
+	if (fp != NULL) {
+		(void)isc_stdio_close(fp);
+	}
+	return (result);
+}
+
+/*
+ * Read the header of every transaction in the journal 'j' once and
+ * record where each of them starts, so that later lookups do not have
+ * to walk the file from the closest entry of the sparse on-disk index.
+ * The part of the journal covered by a valid sidecar index is taken
+ * from it instead, along with its Bloom filters if 'bloom' is true.
+ */
+static isc_result_t
+xindex_build(dns_journal_t *j, bool bloom) {
+	isc_result_t result = ISC_R_SUCCESS;
+	journal_pos_t pos;
+
+	INSIST(j->xindex == NULL);
+
+	j->xindexsize = 64;
+	j->xindex = isc_mem_get(j->mctx,
+				j->xindexsize * sizeof(journal_pos_t));
+
+	if (JOURNAL_EMPTY(&j->header)) {
+		return (ISC_R_SUCCESS);
+	}
+
+	if (jnx_load(j, bloom, &pos) != ISC_R_SUCCESS) {
+		j->xindexlen = 0;
+		xbloom_free(j);
+		pos = j->header.begin;
+	}
+
+	while (pos.serial != j->header.end.serial) {
+		xindex_add(j, &pos);
+		CHECK(journal_next(j, &pos));
+	}
+
+	return (ISC_R_SUCCESS);
+
+failure:
+	xindex_free(j);
+	return (result);
+}
+
+/*
+ * Look up the transaction with initial serial number 'serial' in the
+ * full index, and store its entry number at '*nump' if not NULL.  The
+ * transactions are stored in serial number order.
+ */
+static isc_result_t
+xindex_find(dns_journal_t *j, uint32_t serial, journal_pos_t *pos,
+	    unsigned int *nump) {
+	unsigned int lo = 0, hi = j->xindexlen;
+
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+
+		if (j->xindex[mid].serial == serial) {
+			*pos = j->xindex[mid];
+			if (nump != NULL) {
+				*nump = mid;
+			}
+			return (ISC_R_SUCCESS);
+		}
+		if (DNS_SERIAL_GT(serial, j->xindex[mid].serial)) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return (ISC_R_NOTFOUND);
+}
+
 /*
  * Try to find a transaction with initial serial number 'serial'
  * in the journal 'j'.
@@ -1127,6 +1469,17 @@ journal_find(dns_journal_t *j, uint32_t serial, journal_pos_t *pos) {
 		return (ISC_R_SUCCESS);
 	}
 
+	/*
+	 * Use the full index unless it cannot be built, in which case
+	 * the walk below reports the problem.
+	 */
+	if (j->xindex == NULL) {
+		(void)xindex_build(j, false);
+	}
+	if (j->xindex != NULL) {
+		return (xindex_find(j, serial, pos, NULL));
+	}
+
 	current_pos = j->header.begin;
 	index_find(j, serial, &current_pos);
 
@@ -1349,6 +1702,7 @@ dns_journal_commit(dns_journal_t *j) {
 			CHECK(journal_next(j, &j->header.begin));
 		}
 		index_invalidate(j, j->x.pos[1].serial);
+		xindex_purge(j);
 	}
 #ifdef notyet
 	if (DNS_SERIAL_GT(last_dumped_serial, j->x.pos[1].serial)) {
@@ -1357,9 +1711,12 @@ dns_journal_commit(dns_journal_t *j) {
 #endif /* ifdef notyet */
 
 	/*
-	 * Commit the transaction data to stable storage.
+	 * Commit the transaction data to stable storage, unless that
+	 * is left to dns_journal_sync().
 	 */
-	CHECK(journal_fsync(j));
+	if (!j->defersync) {
+		CHECK(journal_fsync(j));
+	}
 
 	if (j->state == JOURNAL_STATE_TRANSACTION) {
 		isc_offset_t offset;
@@ -1382,30 +1739,54 @@ dns_journal_commit(dns_journal_t *j) {
 		j->header.begin = j->x.pos[0];
 	}
 	j->header.end = j->x.pos[1];
-	journal_header_encode(&j->header, &rawheader);
-	CHECK(journal_seek(j, 0));
-	CHECK(journal_write(j, &rawheader, sizeof(rawheader)));
 
 	/*
 	 * Update the index.
 	 */
 	index_add(j, &j->x.pos[0]);
+	xindex_add(j, &j->x.pos[0]);
 
 	/*
-	 * Convert the index into on-disk format and write
-	 * it to disk.
+	 * We no longer have a transaction open.
 	 */
-	CHECK(index_to_disk(j));
+	j->state = JOURNAL_STATE_WRITE;
 
 	/*
-	 * Commit the header to stable storage.
+	 * The header on disk must not cover transactions which are
+	 * not on stable storage yet; write it when they are.
 	 */
-	CHECK(journal_fsync(j));
+	if (j->defersync) {
+		j->unsynced = true;
+		return (ISC_R_SUCCESS);
+	}
+
+	CHECK(journal_write_header(j));
+
+	result = ISC_R_SUCCESS;
+
+failure:
+	return (result);
+}
+
+isc_result_t
+dns_journal_sync(dns_journal_t *j) {
+	isc_result_t result;
+
+	REQUIRE(DNS_JOURNAL_VALID(j));
+	REQUIRE(j->state == JOURNAL_STATE_WRITE ||
+		j->state == JOURNAL_STATE_TRANSACTION);
+
+	if (!j->unsynced) {
+		return (ISC_R_SUCCESS);
+	}
 
 	/*
-	 * We no longer have a transaction open.
+	 * Commit the transaction data, then the header covering it,
+	 * to stable storage.
 	 */
-	j->state = JOURNAL_STATE_WRITE;
+	CHECK(journal_fsync(j));
+	CHECK(journal_write_header(j));
+	j->unsynced = false;
 
 	result = ISC_R_SUCCESS;
 
@@ -1446,6 +1827,7 @@ dns_journal_destroy(dns_journal_t **journalp) {
 		isc_mem_put(j->mctx, j->index,
 			    j->header.index_size * sizeof(journal_pos_t));
 	}
+	xindex_free(j);
 	if (j->it.target.base != NULL) {
 		isc_mem_put(j->mctx, j->it.target.base, j->it.target.length);
 	}
@@ -1553,6 +1935,23 @@ dns_journal_rollforward(dns_journal_t *j, dns_db_t *db, unsigned int options) {
 
 		if (n_soa == 3) {
 			n_soa = 1;
+
+			/*
+			 * Apply the pending changes before the next
+			 * transaction, so that the deletions in each diff
+			 * applied come before its additions and
+			 * dns_diff_apply() changes each RRset only once.
+			 */
+			if (n_put != 0) {
+				isc_log_write(JOURNAL_DEBUG_LOGARGS(3),
+					      "%s: applying diff to "
+					      "database (%u)",
+					      j->filename, db_serial);
+				(void)dns_diff_print(&diff, NULL);
+				CHECK(dns_diff_apply(&diff, db, ver));
+				dns_diff_clear(&diff);
+				n_put = 0;
+			}
 		}
 		if (n_soa == 0) {
 			isc_log_write(JOURNAL_COMMON_LOGARGS, ISC_LOG_ERROR,
@@ -1616,65 +2015,29 @@ failure:
 	return (result);
 }
 
-isc_result_t
-dns_journal_print(isc_mem_t *mctx, uint32_t flags, const char *filename,
-		  FILE *file) {
-	dns_journal_t *j = NULL;
-	isc_buffer_t source;   /* Transaction data from disk */
-	isc_buffer_t target;   /* Ditto after _fromwire check */
-	uint32_t start_serial; /* Database SOA serial */
-	uint32_t end_serial;   /* Last journal SOA serial */
-	isc_result_t result;
+/*
+ * State of dns_journal_printselect() across the transactions it prints.
+ */
+typedef struct {
+	FILE *file;
+	bool printxhdr;
+	bool checkindex; /*%< Check offsets against the on-disk index */
+	const dns_name_t *select;
 	dns_diff_t diff;
-	unsigned int n_soa = 0;
-	unsigned int n_put = 0;
-	bool printxhdr = ((flags & DNS_JOURNAL_PRINTXHDR) != 0);
-
-	REQUIRE(filename != NULL);
-
-	result = dns_journal_open(mctx, filename, DNS_JOURNAL_READ, &j);
-	if (result == ISC_R_NOTFOUND) {
-		isc_log_write(JOURNAL_DEBUG_LOGARGS(3), "no journal file");
-		return (DNS_R_NOJOURNAL);
-	} else if (result != ISC_R_SUCCESS) {
-		isc_log_write(JOURNAL_COMMON_LOGARGS, ISC_LOG_ERROR,
-			      "journal open failure: %s: %s",
-			      isc_result_totext(result), filename);
-		return (result);
-	}
-
-	if (printxhdr) {
-		fprintf(file, "Journal format = %sHeader version = %d\n",
-			j->header.format + 1, j->header_ver1 ? 1 : 2);
-		fprintf(file, "Start serial = %u\n", j->header.begin.serial);
-		fprintf(file, "End serial = %u\n", j->header.end.serial);
-		fprintf(file, "Index (size = %u):\n", j->header.index_size);
-		for (uint32_t i = 0; i < j->header.index_size; i++) {
-			if (j->index[i].offset == 0) {
-				fputc('\n', file);
-				break;
-			}
-			fprintf(file, "%lld", (long long)j->index[i].offset);
-			fputc((i + 1) % 8 == 0 ? '\n' : ' ', file);
-		}
-	}
-	if (j->header.serialset) {
-		fprintf(file, "Source serial = %u\n", j->header.sourceserial);
-	}
-	dns_diff_init(j->mctx, &diff);
-
-	/*
-	 * Set up empty initial buffers for unchecked and checked
-	 * wire format transaction data.  They will be reallocated
-	 * later.
-	 */
-	isc_buffer_init(&source, NULL, 0);
-	isc_buffer_init(&target, NULL, 0);
+	unsigned int n_soa;
+	unsigned int n_put;
+	uint32_t i;
+} journal_print_t;
 
-	start_serial = dns_journal_first_serial(j);
-	end_serial = dns_journal_last_serial(j);
+/*
+ * Print the transactions of 'j' from 'begin_serial' to 'end_serial'.
+ */
+static isc_result_t
+journal_print_range(dns_journal_t *j, journal_print_t *jp,
+		    uint32_t begin_serial, uint32_t end_serial) {
+	isc_result_t result;
 
-	CHECK(dns_journal_iter_init(j, start_serial, end_serial, NULL));
+	CHECK(dns_journal_iter_init(j, begin_serial, end_serial, NULL));
 
 	for (result = dns_journal_first_rr(j); result == ISC_R_SUCCESS;
 	     result = dns_journal_next_rr(j))
@@ -1682,22 +2045,21 @@ dns_journal_print(isc_mem_t *mctx, uint32_t flags, const char *filename,
 		dns_name_t *name = NULL;
 		dns_rdata_t *rdata = NULL;
 		dns_difftuple_t *tuple = NULL;
-		static uint32_t i = 0;
 		bool print = false;
 		uint32_t ttl;
 
 		dns_journal_current_rr(j, &name, &ttl, &rdata);
 
 		if (rdata->type == dns_rdatatype_soa) {
-			n_soa++;
-			if (n_soa == 3) {
-				n_soa = 1;
+			jp->n_soa++;
+			if (jp->n_soa == 3) {
+				jp->n_soa = 1;
 			}
-			if (n_soa == 1) {
-				print = printxhdr;
+			if (jp->n_soa == 1) {
+				print = jp->printxhdr;
 			}
 		}
-		if (n_soa == 0) {
+		if (jp->n_soa == 0) {
 			isc_log_write(JOURNAL_COMMON_LOGARGS, ISC_LOG_ERROR,
 				      "%s: journal file corrupt: missing "
 				      "initial SOA",
@@ -1706,30 +2068,41 @@ dns_journal_print(isc_mem_t *mctx, uint32_t flags, const char *filename,
 		}
 
 		if (print) {
-			fprintf(file,
+			fprintf(jp->file,
 				"Transaction: version %d offset %lld size %u "
 				"rrcount %u start %u end %u\n",
 				j->xhdr_version, (long long)j->it.cpos.offset,
 				j->curxhdr.size, j->curxhdr.count,
 				j->curxhdr.serial0, j->curxhdr.serial1);
-			if (j->it.cpos.offset > j->index[i].offset) {
-				fprintf(file,
+			if (!jp->checkindex || j->index == NULL ||
+			    jp->i >= j->header.index_size)
+			{
+				/* nothing to check */;
+			} else if (j->it.cpos.offset > j->index[jp->i].offset) {
+				fprintf(jp->file,
 					"ERROR: Offset mismatch, "
 					"expected %lld\n",
-					(long long)j->index[i].offset);
-			} else if (j->it.cpos.offset == j->index[i].offset) {
-				i++;
+					(long long)j->index[jp->i].offset);
+			} else if (j->it.cpos.offset ==
+				   j->index[jp->i].offset) {
+				jp->i++;
 			}
 		}
-		CHECK(dns_difftuple_create(
-			diff.mctx, n_soa == 1 ? DNS_DIFFOP_DEL : DNS_DIFFOP_ADD,
-			name, ttl, rdata, &tuple));
-		dns_diff_append(&diff, &tuple);
 
-		if (++n_put > 100 || printxhdr) {
-			result = dns_diff_print(&diff, file);
-			dns_diff_clear(&diff);
-			n_put = 0;
+		if (jp->select != NULL && !dns_name_equal(name, jp->select)) {
+			continue;
+		}
+
+		CHECK(dns_difftuple_create(
+			jp->diff.mctx,
+			jp->n_soa == 1 ? DNS_DIFFOP_DEL : DNS_DIFFOP_ADD, name,
+			ttl, rdata, &tuple));
+		dns_diff_append(&jp->diff, &tuple);
+
+		if (++jp->n_put > 100 || jp->printxhdr) {
+			result = dns_diff_print(&jp->diff, jp->file);
+			dns_diff_clear(&jp->diff);
+			jp->n_put = 0;
 			if (result != ISC_R_SUCCESS) {
 				break;
 			}
@@ -1738,11 +2111,139 @@ dns_journal_print(isc_mem_t *mctx, uint32_t flags, const char *filename,
 	if (result == ISC_R_NOMORE) {
 		result = ISC_R_SUCCESS;
 	}
-	CHECK(result);
 
-	if (n_put != 0) {
-		result = dns_diff_print(&diff, file);
-		dns_diff_clear(&diff);
+failure:
+	return (result);
+}
+
+/*
+ * Print the changes to 'jp->select' from 'begin_serial' to 'end_serial',
+ * skipping the transactions whose Bloom filter in the sidecar index
+ * shows they do not change it.
+ */
+static isc_result_t
+journal_print_name(dns_journal_t *j, journal_print_t *jp,
+		   uint32_t begin_serial, uint32_t end_serial) {
+	isc_result_t result;
+	journal_pos_t pos;
+	unsigned int i;
+
+	if (begin_serial == end_serial) {
+		return (ISC_R_SUCCESS);
+	}
+
+	if (j->xbloom == NULL) {
+		xindex_free(j);
+		CHECK(xindex_build(j, true));
+	}
+	CHECK(xindex_find(j, begin_serial, &pos, &i));
+
+	for (; i < j->xindexlen && j->xindex[i].serial != end_serial; i++) {
+		uint32_t next = (i + 1 < j->xindexlen)
+					? j->xindex[i + 1].serial
+					: j->header.end.serial;
+
+		if (i < j->xbloomlen &&
+		    !jnx_bloom(j->xbloom + i * JNX_BLOOMSIZE, jp->select,
+			       false))
+		{
+			continue;
+		}
+		CHECK(journal_print_range(j, jp, j->xindex[i].serial, next));
+	}
+
+failure:
+	return (result);
+}
+
+isc_result_t
+dns_journal_print(isc_mem_t *mctx, uint32_t flags, const char *filename,
+		  FILE *file) {
+	return (dns_journal_printselect(mctx, flags, filename, NULL, NULL,
+					NULL, file));
+}
+
+isc_result_t
+dns_journal_printselect(isc_mem_t *mctx, uint32_t flags, const char *filename,
+			const uint32_t *beginp, const uint32_t *endp,
+			const dns_name_t *name, FILE *file) {
+	dns_journal_t *j = NULL;
+	uint32_t start_serial; /* Database SOA serial */
+	uint32_t end_serial;   /* Last journal SOA serial */
+	journal_pos_t pos;
+	isc_result_t result;
+	journal_print_t jp = {
+		.file = file,
+		.printxhdr = ((flags & DNS_JOURNAL_PRINTXHDR) != 0),
+		.checkindex = (beginp == NULL && endp == NULL && name == NULL),
+		.select = name,
+	};
+
+	REQUIRE(filename != NULL);
+
+	result = dns_journal_open(mctx, filename, DNS_JOURNAL_READ, &j);
+	if (result == ISC_R_NOTFOUND) {
+		isc_log_write(JOURNAL_DEBUG_LOGARGS(3), "no journal file");
+		return (DNS_R_NOJOURNAL);
+	} else if (result != ISC_R_SUCCESS) {
+		isc_log_write(JOURNAL_COMMON_LOGARGS, ISC_LOG_ERROR,
+			      "journal open failure: %s: %s",
+			      isc_result_totext(result), filename);
+		return (result);
+	}
+
+	if (jp.printxhdr) {
+		fprintf(file, "Journal format = %sHeader version = %d\n",
+			j->header.format + 1, j->header_ver1 ? 1 : 2);
+		fprintf(file, "Start serial = %u\n", j->header.begin.serial);
+		fprintf(file, "End serial = %u\n", j->header.end.serial);
+		fprintf(file, "Index (size = %u):\n", j->header.index_size);
+		for (uint32_t i = 0; i < j->header.index_size; i++) {
+			if (j->index[i].offset == 0) {
+				fputc('\n', file);
+				break;
+			}
+			fprintf(file, "%lld", (long long)j->index[i].offset);
+			fputc((i + 1) % 8 == 0 ? '\n' : ' ', file);
+		}
+	}
+	if (j->header.serialset) {
+		fprintf(file, "Source serial = %u\n", j->header.sourceserial);
+	}
+	dns_diff_init(j->mctx, &jp.diff);
+
+	start_serial = dns_journal_first_serial(j);
+	end_serial = dns_journal_last_serial(j);
+
+	if (beginp != NULL) {
+		start_serial = *beginp;
+	}
+	if (endp != NULL) {
+		end_serial = *endp;
+	}
+	if (beginp != NULL || endp != NULL) {
+		if (DNS_SERIAL_GT(start_serial, end_serial) ||
+		    journal_find(j, start_serial, &pos) != ISC_R_SUCCESS ||
+		    journal_find(j, end_serial, &pos) != ISC_R_SUCCESS)
+		{
+			isc_log_write(JOURNAL_COMMON_LOGARGS, ISC_LOG_ERROR,
+				      "%s: serials %u to %u are not in the "
+				      "journal",
+				      j->filename, start_serial, end_serial);
+			result = ISC_R_RANGE;
+			goto cleanup;
+		}
+	}
+
+	if (name != NULL) {
+		CHECK(journal_print_name(j, &jp, start_serial, end_serial));
+	} else {
+		CHECK(journal_print_range(j, &jp, start_serial, end_serial));
+	}
+
+	if (jp.n_put != 0) {
+		result = dns_diff_print(&jp.diff, file);
+		dns_diff_clear(&jp.diff);
 	}
 	goto cleanup;
 
@@ -1751,16 +2252,109 @@ failure:
 		      "%s: cannot print: journal file corrupt", j->filename);
 
 cleanup:
-	if (source.base != NULL) {
-		isc_mem_put(j->mctx, source.base, source.length);
+	dns_diff_clear(&jp.diff);
+	dns_journal_destroy(&j);
+
+	return (result);
+}
+
+isc_result_t
+dns_journal_writeindex(isc_mem_t *mctx, const char *filename) {
+	dns_journal_t *j = NULL;
+	char name[PATH_MAX], tmpname[PATH_MAX];
+	FILE *fp = NULL;
+	jnx_rawheader_t rawheader;
+	jnx_rawentry_t rawentry;
+	isc_result_t result;
+
+	REQUIRE(filename != NULL);
+
+	CHECK(jnx_filename(filename, name, sizeof(name)));
+	CHECK(jnx_filename(name, tmpname, sizeof(tmpname)));
+
+	result = dns_journal_open(mctx, filename, DNS_JOURNAL_READ, &j);
+	if (result == ISC_R_NOTFOUND) {
+		return (DNS_R_NOJOURNAL);
 	}
-	if (target.base != NULL) {
-		isc_mem_put(j->mctx, target.base, target.length);
+	CHECK(result);
+
+	if (JOURNAL_EMPTY(&j->header)) {
+		(void)isc_file_remove(name);
+		goto failure;
 	}
 
-	dns_diff_clear(&diff);
-	dns_journal_destroy(&j);
+	/*
+	 * Reuse the filters of the transactions the current sidecar
+	 * covers, and read the transactions added since to build theirs.
+	 */
+	CHECK(xindex_build(j, true));
+	if (j->xbloomsize < j->xindexlen) {
+		j->xbloom = isc_mem_reget(j->mctx, j->xbloom,
+					  j->xbloomsize * JNX_BLOOMSIZE,
+					  j->xindexlen * JNX_BLOOMSIZE);
+		j->xbloomsize = j->xindexlen;
+	}
+	for (unsigned int i = j->xbloomlen; i < j->xindexlen; i++) {
+		unsigned char *bloom = j->xbloom + i * JNX_BLOOMSIZE;
+		uint32_t next = (i + 1 < j->xindexlen)
+					? j->xindex[i + 1].serial
+					: j->header.end.serial;
+
+		memset(bloom, 0, JNX_BLOOMSIZE);
+		CHECK(dns_journal_iter_init(j, j->xindex[i].serial, next,
+					    NULL));
+		for (result = dns_journal_first_rr(j); result == ISC_R_SUCCESS;
+		     result = dns_journal_next_rr(j))
+		{
+			dns_name_t *owner = NULL;
+			dns_rdata_t *rdata = NULL;
+			uint32_t ttl;
+
+			dns_journal_current_rr(j, &owner, &ttl, &rdata);
+			(void)jnx_bloom(bloom, owner, true);
+		}
+		if (result != ISC_R_NOMORE) {
+			goto failure;
+		}
+		j->xbloomlen = i + 1;
+	}
+
+	memset(&rawheader, 0, sizeof(rawheader));
+	memmove(rawheader.format, jnx_format, sizeof(rawheader.format));
+	journal_pos_encode(&rawheader.begin, &j->header.begin);
+	journal_pos_encode(&rawheader.end, &j->header.end);
+	encode_uint32(j->xindexlen, rawheader.count);
+	encode_uint32(JNX_BLOOMSIZE, rawheader.bloomsize);
+
+	CHECK(isc_stdio_open(tmpname, "wb", &fp));
+	CHECK(isc_stdio_write(&rawheader, 1, sizeof(rawheader), fp, NULL));
+	for (unsigned int i = 0; i < j->xindexlen; i++) {
+		journal_pos_encode(&rawentry.pos, &j->xindex[i]);
+		memmove(rawentry.bloom, j->xbloom + i * JNX_BLOOMSIZE,
+			JNX_BLOOMSIZE);
+		CHECK(isc_stdio_write(&rawentry, 1, sizeof(rawentry), fp,
+				      NULL));
+	}
+	CHECK(isc_stdio_flush(fp));
+	CHECK(isc_stdio_sync(fp));
+	result = isc_stdio_close(fp);
+	fp = NULL;
+	CHECK(result);
+	CHECK(isc_file_rename(tmpname, name));
 
+failure:
+	if (fp != NULL) {
+		(void)isc_stdio_close(fp);
+		(void)isc_file_remove(tmpname);
+	}
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(JOURNAL_COMMON_LOGARGS, ISC_LOG_ERROR,
+			      "%s: cannot write index: %s", filename,
+			      isc_result_totext(result));
+	}
+	if (j != NULL) {
+		dns_journal_destroy(&j);
+	}
 	return (result);
 }
 
@@ -1788,6 +2382,26 @@ dns_journal_last_serial(dns_journal_t *j) {
 	return (j->header.end.serial);
 }
 
+size_t
+dns_journal_inuse(dns_journal_t *j) {
+	size_t inuse = sizeof(*j) + strlen(j->filename) + 1;
+
+	if (j->rawindex != NULL) {
+		inuse += j->header.index_size * sizeof(journal_rawpos_t);
+	}
+	if (j->index != NULL) {
+		inuse += j->header.index_size * sizeof(journal_pos_t);
+	}
+	if (j->xindex != NULL) {
+		inuse += j->xindexsize * sizeof(journal_pos_t);
+	}
+	if (j->xbloom != NULL) {
+		inuse += j->xbloomsize * JNX_BLOOMSIZE;
+	}
+
+	return (inuse);
+}
+
 void
 dns_journal_set_sourceserial(dns_journal_t *j, uint32_t sourceserial) {
 	REQUIRE(j->state == JOURNAL_STATE_WRITE ||
@@ -2097,31 +2711,21 @@ dns_journal_current_rr(dns_journal_t *j, dns_name_t **name, uint32_t *ttl,
  */
 
 /*
- * Construct a diff containing all the RRs at the current name of the
- * database iterator 'dbit' in database 'db', version 'ver'.
- * Set '*name' to the current name, and append the diff to 'diff'.
- * All new tuples will have the operation 'op'.
- *
- * Requires: 'name' must have buffer large enough to hold the name.
- * Typically, a dns_fixedname_t would be used.
+ * Construct a diff containing all the RRs at 'node', named 'name', in
+ * database 'db', version 'ver', and append it to 'diff'.  All new
+ * tuples will have the operation 'op'.
  */
 static isc_result_t
 get_name_diff(dns_db_t *db, dns_dbversion_t *ver, isc_stdtime_t now,
-	      dns_dbiterator_t *dbit, dns_name_t *name, dns_diffop_t op,
+	      dns_dbnode_t *node, dns_name_t *name, dns_diffop_t op,
 	      dns_diff_t *diff) {
 	isc_result_t result;
-	dns_dbnode_t *node = NULL;
 	dns_rdatasetiter_t *rdsiter = NULL;
 	dns_difftuple_t *tuple = NULL;
 
-	result = dns_dbiterator_current(dbit, &node, name);
-	if (result != ISC_R_SUCCESS) {
-		return (result);
-	}
-
 	result = dns_db_allrdatasets(db, node, ver, now, &rdsiter);
 	if (result != ISC_R_SUCCESS) {
-		goto cleanup_node;
+		return (result);
 	}
 
 	for (result = dns_rdatasetiter_first(rdsiter); result == ISC_R_SUCCESS;
@@ -2161,12 +2765,121 @@ get_name_diff(dns_db_t *db, dns_dbversion_t *ver, isc_stdtime_t now,
 cleanup_iterator:
 	dns_rdatasetiter_destroy(&rdsiter);
 
-cleanup_node:
-	dns_db_detachnode(db, &node);
-
 	return (result);
 }
 
+/*%
+ * Most RRsets a name may have for name_equal() to compare it.
+ */
+#define NAME_EQUAL_RDATASETS 16
+
+/*
+ * Return true if the rdatasets of 'node[0]' and 'node[1]' are known to
+ * hold the same RRs with the same TTLs, so that the name needs no
+ * diff.  This avoids creating, sorting and discarding a tuple for
+ * every RR of the names that are the same in both databases, which
+ * are most of them.  False negatives are fine: the name is then
+ * diffed RR by RR.
+ */
+static bool
+name_equal(dns_db_t *db[2], dns_dbversion_t *ver[2], dns_dbnode_t *node[2]) {
+	dns_rdatasetiter_t *rdsiter[2] = { NULL, NULL };
+	dns_rdataset_t rdatasets[NAME_EQUAL_RDATASETS];
+	dns_rdataset_t rdataset;
+	unsigned int count = 0, matched = 0;
+	isc_result_t result;
+	bool equal = false;
+
+	dns_rdataset_init(&rdataset);
+
+	for (int i = 0; i < 2; i++) {
+		result = dns_db_allrdatasets(db[i], node[i], ver[i], 0,
+					     &rdsiter[i]);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+	}
+
+	for (result = dns_rdatasetiter_first(rdsiter[0]);
+	     result == ISC_R_SUCCESS;
+	     result = dns_rdatasetiter_next(rdsiter[0]))
+	{
+		if (count == NAME_EQUAL_RDATASETS) {
+			goto cleanup;
+		}
+		dns_rdataset_init(&rdatasets[count]);
+		dns_rdatasetiter_current(rdsiter[0], &rdatasets[count]);
+		count++;
+	}
+	if (result != ISC_R_NOMORE) {
+		goto cleanup;
+	}
+
+	for (result = dns_rdatasetiter_first(rdsiter[1]);
+	     result == ISC_R_SUCCESS;
+	     result = dns_rdatasetiter_next(rdsiter[1]))
+	{
+		dns_rdataset_t *match = NULL;
+		isc_result_t ra, rb;
+
+		dns_rdatasetiter_current(rdsiter[1], &rdataset);
+		for (unsigned int i = 0; i < count; i++) {
+			if (rdatasets[i].type == rdataset.type &&
+			    rdatasets[i].covers == rdataset.covers)
+			{
+				match = &rdatasets[i];
+				break;
+			}
+		}
+		if (match == NULL || match->ttl != rdataset.ttl ||
+		    dns_rdataset_count(match) != dns_rdataset_count(&rdataset))
+		{
+			goto cleanup;
+		}
+
+		/*
+		 * Both rdatasets are usually in the same order, so only
+		 * compare them RR by RR.
+		 */
+		for (ra = dns_rdataset_first(match),
+		    rb = dns_rdataset_first(&rdataset);
+		     ra == ISC_R_SUCCESS && rb == ISC_R_SUCCESS;
+		     ra = dns_rdataset_next(match),
+		    rb = dns_rdataset_next(&rdataset))
+		{
+			dns_rdata_t a = DNS_RDATA_INIT;
+			dns_rdata_t b = DNS_RDATA_INIT;
+
+			dns_rdataset_current(match, &a);
+			dns_rdataset_current(&rdataset, &b);
+			if (dns_rdata_compare(&a, &b) != 0) {
+				goto cleanup;
+			}
+		}
+		if (ra != ISC_R_NOMORE || rb != ISC_R_NOMORE) {
+			goto cleanup;
+		}
+		dns_rdataset_disassociate(&rdataset);
+		matched++;
+	}
+	equal = (result == ISC_R_NOMORE && matched == count);
+
+cleanup:
+	if (dns_rdataset_isassociated(&rdataset)) {
+		dns_rdataset_disassociate(&rdataset);
+	}
+	for (unsigned int i = 0; i < count; i++) {
+		dns_rdataset_disassociate(&rdatasets[i]);
+	}
+	for (int i = 0; i < 2; i++) {
+		if (rdsiter[i] != NULL) {
+			dns_rdatasetiter_destroy(&rdsiter[i]);
+		}
+	}
+
+	return (equal);
+}
+
 /*
  * Comparison function for use by dns_diff_subtract when sorting
  * the diffs to be subtracted.  The sort keys are the rdata type
@@ -2258,8 +2971,9 @@ diff_namespace(dns_db_t *dba, dns_dbversion_t *dbvera, dns_db_t *dbb,
 	dns_db_t *db[2];
 	dns_dbversion_t *ver[2];
 	dns_dbiterator_t *dbit[2] = { NULL, NULL };
-	bool have[2] = { false, false };
+	dns_dbnode_t *node[2] = { NULL, NULL };
 	dns_fixedname_t fixname[2];
+	dns_name_t *name[2];
 	isc_result_t result, itresult[2];
 	dns_diff_t diff[2];
 	int i, t;
@@ -2270,8 +2984,8 @@ diff_namespace(dns_db_t *dba, dns_dbversion_t *dbvera, dns_db_t *dbb,
 	dns_diff_init(resultdiff->mctx, &diff[0]);
 	dns_diff_init(resultdiff->mctx, &diff[1]);
 
-	dns_fixedname_init(&fixname[0]);
-	dns_fixedname_init(&fixname[1]);
+	name[0] = dns_fixedname_initname(&fixname[0]);
+	name[1] = dns_fixedname_initname(&fixname[1]);
 
 	result = dns_db_createiterator(db[0], options, &dbit[0]);
 	if (result != ISC_R_SUCCESS) {
@@ -2287,56 +3001,50 @@ diff_namespace(dns_db_t *dba, dns_dbversion_t *dbvera, dns_db_t *dbb,
 
 	for (;;) {
 		for (i = 0; i < 2; i++) {
-			if (!have[i] && itresult[i] == ISC_R_SUCCESS) {
-				CHECK(get_name_diff(
-					db[i], ver[i], 0, dbit[i],
-					dns_fixedname_name(&fixname[i]),
-					i == 0 ? DNS_DIFFOP_ADD
-					       : DNS_DIFFOP_DEL,
-					&diff[i]));
+			if (node[i] == NULL && itresult[i] == ISC_R_SUCCESS) {
+				CHECK(dns_dbiterator_current(dbit[i], &node[i],
+							     name[i]));
 				itresult[i] = dns_dbiterator_next(dbit[i]);
-				have[i] = true;
 			}
 		}
 
-		if (!have[0] && !have[1]) {
-			INSIST(ISC_LIST_EMPTY(diff[0].tuples));
-			INSIST(ISC_LIST_EMPTY(diff[1].tuples));
+		if (node[0] == NULL && node[1] == NULL) {
 			break;
 		}
 
-		for (i = 0; i < 2; i++) {
-			if (!have[!i]) {
-				ISC_LIST_APPENDLIST(resultdiff->tuples,
-						    diff[i].tuples, link);
-				INSIST(ISC_LIST_EMPTY(diff[i].tuples));
-				have[i] = false;
-				goto next;
-			}
+		if (node[1] == NULL) {
+			t = -1;
+		} else if (node[0] == NULL) {
+			t = 1;
+		} else {
+			t = dns_name_compare(name[0], name[1]);
 		}
 
-		t = dns_name_compare(dns_fixedname_name(&fixname[0]),
-				     dns_fixedname_name(&fixname[1]));
-		if (t < 0) {
-			ISC_LIST_APPENDLIST(resultdiff->tuples, diff[0].tuples,
-					    link);
-			INSIST(ISC_LIST_EMPTY(diff[0].tuples));
-			have[0] = false;
+		/*
+		 * A name only found in one of the databases is added or
+		 * deleted as a whole.
+		 */
+		if (t != 0) {
+			i = (t < 0) ? 0 : 1;
+			CHECK(get_name_diff(db[i], ver[i], 0, node[i], name[i],
+					    i == 0 ? DNS_DIFFOP_ADD
+						   : DNS_DIFFOP_DEL,
+					    resultdiff));
+			dns_db_detachnode(db[i], &node[i]);
 			continue;
 		}
-		if (t > 0) {
-			ISC_LIST_APPENDLIST(resultdiff->tuples, diff[1].tuples,
-					    link);
+
+		if (!name_equal(db, ver, node)) {
+			CHECK(get_name_diff(db[0], ver[0], 0, node[0], name[0],
+					    DNS_DIFFOP_ADD, &diff[0]));
+			CHECK(get_name_diff(db[1], ver[1], 0, node[1], name[1],
+					    DNS_DIFFOP_DEL, &diff[1]));
+			CHECK(dns_diff_subtract(diff, resultdiff));
+			INSIST(ISC_LIST_EMPTY(diff[0].tuples));
 			INSIST(ISC_LIST_EMPTY(diff[1].tuples));
-			have[1] = false;
-			continue;
 		}
-		INSIST(t == 0);
-		CHECK(dns_diff_subtract(diff, resultdiff));
-		INSIST(ISC_LIST_EMPTY(diff[0].tuples));
-		INSIST(ISC_LIST_EMPTY(diff[1].tuples));
-		have[0] = have[1] = false;
-	next:;
+		dns_db_detachnode(db[0], &node[0]);
+		dns_db_detachnode(db[1], &node[1]);
 	}
 	if (itresult[0] != ISC_R_NOMORE) {
 		FAIL(itresult[0]);
@@ -2349,6 +3057,11 @@ diff_namespace(dns_db_t *dba, dns_dbversion_t *dbvera, dns_db_t *dbb,
 	INSIST(ISC_LIST_EMPTY(diff[1].tuples));
 
 failure:
+	for (i = 0; i < 2; i++) {
+		if (node[i] != NULL) {
+			dns_db_detachnode(db[i], &node[i]);
+		}
+	}
 	dns_dbiterator_destroy(&dbit[1]);
 
 cleanup_iterator:
@@ -2450,52 +3163,236 @@ check_delta(unsigned char *buf, size_t size) {
 	return (true);
 }
 
-isc_result_t
-dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
-		    uint32_t flags, uint32_t target_size) {
-	unsigned int i;
-	journal_pos_t best_guess;
-	journal_pos_t current_pos;
-	dns_journal_t *j1 = NULL;
-	dns_journal_t *j2 = NULL;
-	journal_rawheader_t rawheader;
-	unsigned int len;
+/*
+ * Derive the names of the temporary and backup files used to compact
+ * the journal 'filename'.
+ */
+static void
+compact_names(const char *filename, char *newname, size_t newsize,
+	      char *backup, size_t backupsize) {
 	size_t namelen;
-	unsigned char *buf = NULL;
-	unsigned int size = 0;
-	isc_result_t result;
-	unsigned int indexend;
-	char newname[PATH_MAX];
-	char backup[PATH_MAX];
-	bool is_backup = false;
-	bool rewrite = false;
-	bool downgrade = false;
-
-	REQUIRE(filename != NULL);
+	int n;
 
 	namelen = strlen(filename);
 	if (namelen > 4U && strcmp(filename + namelen - 4, ".jnl") == 0) {
 		namelen -= 4;
 	}
 
-	result = snprintf(newname, sizeof(newname), "%.*s.jnw", (int)namelen,
-			  filename);
-	RUNTIME_CHECK(result < sizeof(newname));
+	n = snprintf(newname, newsize, "%.*s.jnw", (int)namelen, filename);
+	RUNTIME_CHECK(n > 0 && (size_t)n < newsize);
 
-	result = snprintf(backup, sizeof(backup), "%.*s.jbk", (int)namelen,
-			  filename);
-	RUNTIME_CHECK(result < sizeof(backup));
+	n = snprintf(backup, backupsize, "%.*s.jbk", (int)namelen, filename);
+	RUNTIME_CHECK(n > 0 && (size_t)n < backupsize);
+}
 
-	result = journal_open(mctx, filename, false, false, false, &j1);
-	if (result == ISC_R_NOTFOUND) {
-		is_backup = true;
-		result = journal_open(mctx, backup, false, false, false, &j1);
-	}
-	if (result != ISC_R_SUCCESS) {
-		return (result);
-	}
+/*
+ * Find the transaction of 'j1' from which a compacted copy should
+ * start for it to hold roughly half of 'target_size' bytes, without
+ * dropping the changes from 'serial' onwards.
+ */
+static isc_result_t
+compact_start(dns_journal_t *j1, uint32_t serial, uint32_t target_size,
+	      journal_pos_t *startp) {
+	journal_pos_t best_guess;
+	journal_pos_t current_pos;
+	isc_result_t result;
+	unsigned int i;
 
-	/*
+	best_guess = j1->header.begin;
+	for (i = 0; i < j1->header.index_size; i++) {
+		if (POS_VALID(j1->index[i]) &&
+		    DNS_SERIAL_GE(serial, j1->index[i].serial) &&
+		    ((uint32_t)(j1->header.end.offset - j1->index[i].offset) >=
+		     target_size / 2) &&
+		    j1->index[i].offset > best_guess.offset)
+		{
+			best_guess = j1->index[i];
+		}
+	}
+
+	current_pos = best_guess;
+	while (current_pos.serial != serial) {
+		CHECK(journal_next(j1, &current_pos));
+		if (current_pos.serial == j1->header.end.serial) {
+			break;
+		}
+
+		if (DNS_SERIAL_GE(serial, current_pos.serial) &&
+		    ((uint32_t)(j1->header.end.offset - current_pos.offset) >=
+		     (target_size / 2)) &&
+		    current_pos.offset > best_guess.offset)
+		{
+			best_guess = current_pos;
+		} else {
+			break;
+		}
+	}
+
+	INSIST(best_guess.serial != j1->header.end.serial);
+	if (best_guess.serial != serial) {
+		CHECK(journal_next(j1, &best_guess));
+	}
+
+	*startp = best_guess;
+	result = ISC_R_SUCCESS;
+
+failure:
+	return (result);
+}
+
+/*
+ * Copy the 'len' bytes at the current offset of 'j1' to the current
+ * offset of 'j2', counting them in '*copied' if it is not NULL.
+ */
+static isc_result_t
+compact_copy(isc_mem_t *mctx, dns_journal_t *j1, dns_journal_t *j2,
+	     uint32_t len, atomic_uint_fast64_t *copied) {
+	unsigned char *buf = NULL;
+	unsigned int size;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	if (len == 0) {
+		return (ISC_R_SUCCESS);
+	}
+
+	size = ISC_MIN(64 * 1024, len);
+	buf = isc_mem_get(mctx, size);
+	for (uint32_t i = 0; i < len; i += size) {
+		unsigned int blob = ISC_MIN(size, len - i);
+		CHECK(journal_read(j1, buf, blob));
+		CHECK(journal_write(j2, buf, blob));
+		if (copied != NULL) {
+			atomic_fetch_add_relaxed(copied, blob);
+		}
+	}
+
+failure:
+	isc_mem_put(mctx, buf, size);
+	return (result);
+}
+
+/*
+ * Commit the transactions copied into 'j2' to stable storage, then
+ * write its header and a new index.
+ */
+static isc_result_t
+compact_finish(dns_journal_t *j2) {
+	journal_rawheader_t rawheader;
+	journal_pos_t current_pos;
+	isc_result_t result;
+
+	CHECK(journal_fsync(j2));
+
+	/*
+	 * Update the journal header.
+	 */
+	journal_header_encode(&j2->header, &rawheader);
+	CHECK(journal_seek(j2, 0));
+	CHECK(journal_write(j2, &rawheader, sizeof(rawheader)));
+	CHECK(journal_fsync(j2));
+
+	/*
+	 * Build new index.
+	 */
+	current_pos = j2->header.begin;
+	while (current_pos.serial != j2->header.end.serial) {
+		index_add(j2, &current_pos);
+		CHECK(journal_next(j2, &current_pos));
+	}
+
+	/*
+	 * Write index.
+	 */
+	CHECK(index_to_disk(j2));
+	CHECK(journal_fsync(j2));
+
+failure:
+	return (result);
+}
+
+/*
+ * Replace the journal 'filename' (or its 'backup' if 'is_backup')
+ * with the compacted copy 'newname'.
+ */
+static isc_result_t
+compact_rename(const char *newname, const char *filename, const char *backup,
+	       bool is_backup) {
+	isc_result_t result;
+	char jnxname[PATH_MAX];
+
+	/*
+	 * With a UFS file system this should just succeed and be atomic.
+	 * Any IXFR outs will just continue and the old journal will be
+	 * removed on final close.
+	 *
+	 * With MSDOS / NTFS we need to do a two stage rename, triggered
+	 * by EEXIST.  (If any IXFR's are running in other threads, however,
+	 * this will fail, and the journal will not be compacted.  But
+	 * if so, hopefully they'll be finished by the next time we
+	 * compact.)
+	 */
+	if (rename(newname, filename) == -1) {
+		if (errno == EEXIST && !is_backup) {
+			result = isc_file_remove(backup);
+			if (result != ISC_R_SUCCESS &&
+			    result != ISC_R_FILENOTFOUND) {
+				return (result);
+			}
+			if (rename(filename, backup) == -1) {
+				return (ISC_R_FAILURE);
+			}
+			if (rename(newname, filename) == -1) {
+				return (ISC_R_FAILURE);
+			}
+			(void)isc_file_remove(backup);
+		} else {
+			return (ISC_R_FAILURE);
+		}
+	}
+
+	/*
+	 * The sidecar index describes the old journal.
+	 */
+	if (jnx_filename(filename, jnxname, sizeof(jnxname)) == ISC_R_SUCCESS)
+	{
+		(void)isc_file_remove(jnxname);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
+		    uint32_t flags, uint32_t target_size) {
+	journal_pos_t best_guess;
+	dns_journal_t *j1 = NULL;
+	dns_journal_t *j2 = NULL;
+	unsigned int len;
+	unsigned char *buf = NULL;
+	unsigned int size = 0;
+	isc_result_t result;
+	unsigned int indexend;
+	char newname[PATH_MAX];
+	char backup[PATH_MAX];
+	bool is_backup = false;
+	bool rewrite = false;
+	bool downgrade = false;
+
+	REQUIRE(filename != NULL);
+
+	compact_names(filename, newname, sizeof(newname), backup,
+		      sizeof(backup));
+
+	result = journal_open(mctx, filename, false, false, false, &j1);
+	if (result == ISC_R_NOTFOUND) {
+		is_backup = true;
+		result = journal_open(mctx, backup, false, false, false, &j1);
+	}
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	/*
 	 * Always perform a re-write when processing a version 1 journal.
 	 */
 	rewrite = j1->header_ver1;
@@ -2555,41 +3452,8 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
 	/*
 	 * Find if we can create enough free space.
 	 */
-	best_guess = j1->header.begin;
-	for (i = 0; i < j1->header.index_size; i++) {
-		if (POS_VALID(j1->index[i]) &&
-		    DNS_SERIAL_GE(serial, j1->index[i].serial) &&
-		    ((uint32_t)(j1->header.end.offset - j1->index[i].offset) >=
-		     target_size / 2) &&
-		    j1->index[i].offset > best_guess.offset)
-		{
-			best_guess = j1->index[i];
-		}
-	}
-
-	current_pos = best_guess;
-	while (current_pos.serial != serial) {
-		CHECK(journal_next(j1, &current_pos));
-		if (current_pos.serial == j1->header.end.serial) {
-			break;
-		}
-
-		if (DNS_SERIAL_GE(serial, current_pos.serial) &&
-		    ((uint32_t)(j1->header.end.offset - current_pos.offset) >=
-		     (target_size / 2)) &&
-		    current_pos.offset > best_guess.offset)
-		{
-			best_guess = current_pos;
-		} else {
-			break;
-		}
-	}
-
-	INSIST(best_guess.serial != j1->header.end.serial);
-	if (best_guess.serial != serial) {
-		CHECK(journal_next(j1, &best_guess));
-		serial = best_guess.serial;
-	}
+	CHECK(compact_start(j1, serial, target_size, &best_guess));
+	serial = best_guess.serial;
 
 	/*
 	 * We should now be roughly half target_size provided
@@ -2723,91 +3587,238 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
 		 * this faster method instead.
 		 */
 		if (!rewrite) {
-			size = ISC_MIN(64 * 1024, len);
-			buf = isc_mem_get(mctx, size);
-			for (i = 0; i < len; i += size) {
-				unsigned int blob = ISC_MIN(size, len - i);
-				CHECK(journal_read(j1, buf, blob));
-				CHECK(journal_write(j2, buf, blob));
-			}
-
+			CHECK(compact_copy(mctx, j1, j2, len, NULL));
 			j2->header.end.offset = indexend + len;
 		}
 
-		CHECK(journal_fsync(j2));
+		CHECK(compact_finish(j2));
+	}
 
-		/*
-		 * Update the journal header.
-		 */
-		journal_header_encode(&j2->header, &rawheader);
-		CHECK(journal_seek(j2, 0));
-		CHECK(journal_write(j2, &rawheader, sizeof(rawheader)));
-		CHECK(journal_fsync(j2));
+	/*
+	 * Close both journals before trying to rename files.
+	 */
+	dns_journal_destroy(&j1);
+	dns_journal_destroy(&j2);
 
-		/*
-		 * Build new index.
-		 */
-		current_pos = j2->header.begin;
-		while (current_pos.serial != j2->header.end.serial) {
-			index_add(j2, &current_pos);
-			CHECK(journal_next(j2, &current_pos));
-		}
+	result = compact_rename(newname, filename, backup, is_backup);
 
-		/*
-		 * Write index.
-		 */
-		CHECK(index_to_disk(j2));
-		CHECK(journal_fsync(j2));
+failure:
+	(void)isc_file_remove(newname);
+	if (buf != NULL) {
+		isc_mem_put(mctx, buf, size);
+	}
+	if (j1 != NULL) {
+		dns_journal_destroy(&j1);
+	}
+	if (j2 != NULL) {
+		dns_journal_destroy(&j2);
+	}
+	return (result);
+}
+
+void
+dns_journal_compact_create(isc_mem_t *mctx, const char *filename,
+			   uint32_t serial, uint32_t target_size,
+			   dns_journalcompact_t **compactp) {
+	dns_journalcompact_t *compact = NULL;
+
+	REQUIRE(filename != NULL);
+	REQUIRE(compactp != NULL && *compactp == NULL);
+
+	compact = isc_mem_get(mctx, sizeof(*compact));
+	*compact = (dns_journalcompact_t){
+		.serial = serial,
+		.target_size = target_size,
+	};
+	isc_mem_attach(mctx, &compact->mctx);
+	compact->filename = isc_mem_strdup(mctx, filename);
+	compact_names(filename, compact->newname, sizeof(compact->newname),
+		      compact->backup, sizeof(compact->backup));
+	atomic_init(&compact->copied, 0);
+	atomic_init(&compact->total, 0);
+	compact->magic = DNS_JOURNALCOMPACT_MAGIC;
+
+	*compactp = compact;
+}
+
+isc_result_t
+dns_journal_compact_copy(dns_journalcompact_t *compact) {
+	isc_mem_t *mctx = NULL;
+	dns_journal_t *j1 = NULL;
+	dns_journal_t *j2 = NULL;
+	journal_pos_t start;
+	uint32_t target_size;
+	unsigned int indexend;
+	uint32_t len;
+	isc_result_t result;
+
+	REQUIRE(DNS_JOURNALCOMPACT_VALID(compact));
+	REQUIRE(compact->j2 == NULL);
+
+	mctx = compact->mctx;
+	target_size = compact->target_size;
+
+	result = journal_open(mctx, compact->filename, false, false, false,
+			      &j1);
+	if (result == ISC_R_NOTFOUND) {
+		compact->is_backup = true;
+		result = journal_open(mctx, compact->backup, false, false,
+				      false, &j1);
+	}
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
 
-		indexend = j2->header.end.offset;
-		POST(indexend);
+	if (JOURNAL_EMPTY(&j1->header)) {
+		dns_journal_destroy(&j1);
+		return (ISC_R_SUCCESS);
 	}
 
 	/*
-	 * Close both journals before trying to rename files.
+	 * A version 1 journal has to be rewritten transaction by
+	 * transaction.
 	 */
-	dns_journal_destroy(&j1);
-	dns_journal_destroy(&j2);
+	if (j1->header_ver1) {
+		compact->rewrite = true;
+		dns_journal_destroy(&j1);
+		return (ISC_R_SUCCESS);
+	}
+
+	if (DNS_SERIAL_GT(j1->header.begin.serial, compact->serial) ||
+	    DNS_SERIAL_GT(compact->serial, j1->header.end.serial))
+	{
+		dns_journal_destroy(&j1);
+		return (ISC_R_RANGE);
+	}
 
 	/*
-	 * With a UFS file system this should just succeed and be atomic.
-	 * Any IXFR outs will just continue and the old journal will be
-	 * removed on final close.
-	 *
-	 * With MSDOS / NTFS we need to do a two stage rename, triggered
-	 * by EEXIST.  (If any IXFR's are running in other threads, however,
-	 * this will fail, and the journal will not be compacted.  But
-	 * if so, hopefully they'll be finished by the next time we
-	 * compact.)
+	 * Size the copy as dns_journal_compact() does.
 	 */
-	if (rename(newname, filename) == -1) {
-		if (errno == EEXIST && !is_backup) {
-			result = isc_file_remove(backup);
-			if (result != ISC_R_SUCCESS &&
-			    result != ISC_R_FILENOTFOUND) {
-				goto failure;
-			}
-			if (rename(filename, backup) == -1) {
-				goto maperrno;
-			}
-			if (rename(newname, filename) == -1) {
-				goto maperrno;
-			}
-			(void)isc_file_remove(backup);
-		} else {
-		maperrno:
-			result = ISC_R_FAILURE;
-			goto failure;
-		}
+	indexend = sizeof(journal_rawheader_t) +
+		   j1->header.index_size * sizeof(journal_rawpos_t);
+	if (target_size < DNS_JOURNAL_SIZE_MIN) {
+		target_size = DNS_JOURNAL_SIZE_MIN;
 	}
+	if (target_size < indexend * 2) {
+		target_size = target_size / 2 + indexend;
+	}
+	if ((uint32_t)j1->header.end.offset < target_size) {
+		dns_journal_destroy(&j1);
+		return (ISC_R_SUCCESS);
+	}
+	target_size -= indexend;
 
-	result = ISC_R_SUCCESS;
+	CHECK(journal_open(mctx, compact->newname, true, true, false, &j2));
+	CHECK(journal_seek(j2, indexend));
+
+	CHECK(compact_start(j1, compact->serial, target_size, &start));
+
+	len = j1->header.end.offset - start.offset;
+	atomic_store_relaxed(&compact->total, len);
+	CHECK(journal_seek(j1, start.offset));
+	CHECK(compact_copy(mctx, j1, j2, len, &compact->copied));
+
+	j2->header.begin.serial = start.serial;
+	j2->header.begin.offset = indexend;
+	j2->header.end.serial = j1->header.end.serial;
+	j2->header.end.offset = indexend + len;
+
+	/*
+	 * Get the bulk of the copy to stable storage now, so that
+	 * dns_journal_compact_commit() only has to sync the catch-up.
+	 */
+	CHECK(journal_fsync(j2));
+
+	compact->begin = j1->header.begin;
+	compact->end = j1->header.end;
+	compact->j2 = j2;
+	j2 = NULL;
 
 failure:
-	(void)isc_file_remove(newname);
-	if (buf != NULL) {
-		isc_mem_put(mctx, buf, size);
+	if (j1 != NULL) {
+		dns_journal_destroy(&j1);
+	}
+	if (j2 != NULL) {
+		dns_journal_destroy(&j2);
+	}
+	return (result);
+}
+
+isc_result_t
+dns_journal_compact_commit(dns_journalcompact_t *compact) {
+	dns_journal_t *j1 = NULL;
+	dns_journal_t *j2 = NULL;
+	const char *filename = NULL;
+	journal_xhdr_t xhdr;
+	uint32_t len;
+	isc_result_t result;
+
+	REQUIRE(DNS_JOURNALCOMPACT_VALID(compact));
+
+	if (compact->rewrite) {
+		compact->rewrite = false;
+		return (dns_journal_compact(compact->mctx, compact->filename,
+					    compact->serial, 0,
+					    compact->target_size));
 	}
+	if (compact->j2 == NULL) {
+		return (ISC_R_SUCCESS);
+	}
+
+	j2 = compact->j2;
+	compact->j2 = NULL;
+
+	filename = compact->is_backup ? compact->backup : compact->filename;
+	CHECK(journal_open(compact->mctx, filename, false, false, false,
+			   &j1));
+
+	/*
+	 * The journal may only have grown since it was copied; if it
+	 * was replaced or compacted meanwhile, the copy is useless.
+	 */
+	if (j1->header.begin.serial != compact->begin.serial ||
+	    j1->header.begin.offset != compact->begin.offset ||
+	    j1->header.end.offset < compact->end.offset)
+	{
+		CHECK(ISC_R_CANCELED);
+	}
+	len = j1->header.end.offset - compact->end.offset;
+	if (len != 0) {
+		CHECK(journal_seek(j1, compact->end.offset));
+		CHECK(journal_read_xhdr(j1, &xhdr));
+		if (xhdr.serial0 != compact->end.serial) {
+			CHECK(ISC_R_CANCELED);
+		}
+	} else if (j1->header.end.serial != compact->end.serial) {
+		CHECK(ISC_R_CANCELED);
+	}
+
+	/*
+	 * Catch up with the transactions appended since the copy.
+	 */
+	atomic_fetch_add_relaxed(&compact->total, len);
+	CHECK(journal_seek(j1, compact->end.offset));
+	CHECK(journal_seek(j2, j2->header.end.offset));
+	CHECK(compact_copy(compact->mctx, j1, j2, len, &compact->copied));
+
+	j2->header.end.serial = j1->header.end.serial;
+	j2->header.end.offset += len;
+	j2->header.sourceserial = j1->header.sourceserial;
+	j2->header.serialset = j1->header.serialset;
+
+	CHECK(compact_finish(j2));
+
+	/*
+	 * Close both journals before trying to rename files.
+	 */
+	dns_journal_destroy(&j1);
+	dns_journal_destroy(&j2);
+
+	result = compact_rename(compact->newname, compact->filename,
+				compact->backup, compact->is_backup);
+
+failure:
+	(void)isc_file_remove(compact->newname);
 	if (j1 != NULL) {
 		dns_journal_destroy(&j1);
 	}
@@ -2817,6 +3828,62 @@ failure:
 	return (result);
 }
 
+void
+dns_journal_compact_progress(dns_journalcompact_t *compact, uint64_t *copiedp,
+			     uint64_t *totalp) {
+	REQUIRE(DNS_JOURNALCOMPACT_VALID(compact));
+	REQUIRE(copiedp != NULL && totalp != NULL);
+
+	*copiedp = atomic_load_relaxed(&compact->copied);
+	*totalp = atomic_load_relaxed(&compact->total);
+}
+
+void
+dns_journal_compact_destroy(dns_journalcompact_t **compactp) {
+	dns_journalcompact_t *compact = NULL;
+
+	REQUIRE(compactp != NULL && DNS_JOURNALCOMPACT_VALID(*compactp));
+
+	compact = *compactp;
+	*compactp = NULL;
+
+	if (compact->j2 != NULL) {
+		dns_journal_destroy(&compact->j2);
+		(void)isc_file_remove(compact->newname);
+	}
+	compact->magic = 0;
+	isc_mem_free(compact->mctx, compact->filename);
+	isc_mem_putanddetach(&compact->mctx, compact, sizeof(*compact));
+}
+
+/*
+ * Write the journal header and index, and commit them to stable
+ * storage.
+ */
+static isc_result_t
+journal_write_header(dns_journal_t *j) {
+	journal_rawheader_t rawheader;
+	isc_result_t result;
+
+	journal_header_encode(&j->header, &rawheader);
+	CHECK(journal_seek(j, 0));
+	CHECK(journal_write(j, &rawheader, sizeof(rawheader)));
+
+	/*
+	 * Convert the index into on-disk format and write
+	 * it to disk.
+	 */
+	CHECK(index_to_disk(j));
+
+	/*
+	 * Commit the header to stable storage.
+	 */
+	CHECK(journal_fsync(j));
+
+failure:
+	return (result);
+}
+
 static isc_result_t
 index_to_disk(dns_journal_t *j) {
 	isc_result_t result = ISC_R_SUCCESS;
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <isc/buffer.h>
+#include <isc/md.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/serial.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/keycache.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+
+#define KEYCACHE_MAGIC	  ISC_MAGIC('K', 'e', 'y', 'C')
+#define VALID_KEYCACHE(c) ISC_MAGIC_VALID(c, KEYCACHE_MAGIC)
+
+/*
+ * Number of locks protecting the slots; slot 'i' is protected by
+ * lock 'i % KEYCACHE_NLOCKS'.
+ */
+#define KEYCACHE_NLOCKS 64
+
+/*
+ * Length of the digest identifying a key.
+ */
+#define KEYCACHE_DIGESTLENGTH 32
+
+#define CHECK(x)                             \
+	do {                                 \
+		result = (x);                \
+		if (result != ISC_R_SUCCESS) \
+			goto cleanup;        \
+	} while (0)
+
+typedef struct keyentry {
+	unsigned char digest[KEYCACHE_DIGESTLENGTH];
+	isc_stdtime_t expire;
+	dst_key_t *key;
+} keyentry_t;
+
+struct dns_keycache {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	unsigned int size;
+	isc_mutex_t locks[KEYCACHE_NLOCKS];
+	keyentry_t *entries;
+};
+
+void
+dns_keycache_create(isc_mem_t *mctx, unsigned int size,
+		    dns_keycache_t **cachep) {
+	dns_keycache_t *cache = NULL;
+	unsigned int slots = KEYCACHE_NLOCKS;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(size > 0);
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	while (slots < size && slots < (1U << 30)) {
+		slots <<= 1;
+	}
+
+	cache = isc_mem_get(mctx, sizeof(*cache));
+	*cache = (dns_keycache_t){ .size = slots };
+
+	isc_mem_attach(mctx, &cache->mctx);
+	for (size_t i = 0; i < KEYCACHE_NLOCKS; i++) {
+		isc_mutex_init(&cache->locks[i]);
+	}
+	cache->entries = isc_mem_get(mctx, slots * sizeof(cache->entries[0]));
+	memset(cache->entries, 0, slots * sizeof(cache->entries[0]));
+
+	cache->magic = KEYCACHE_MAGIC;
+
+	*cachep = cache;
+}
+
+void
+dns_keycache_destroy(dns_keycache_t **cachep) {
+	dns_keycache_t *cache = NULL;
+
+	REQUIRE(cachep != NULL && VALID_KEYCACHE(*cachep));
+
+	cache = *cachep;
+	*cachep = NULL;
+
+	cache->magic = 0;
+	for (size_t i = 0; i < cache->size; i++) {
+		if (cache->entries[i].key != NULL) {
+			dst_key_free(&cache->entries[i].key);
+		}
+	}
+	isc_mem_put(cache->mctx, cache->entries,
+		    cache->size * sizeof(cache->entries[0]));
+	for (size_t i = 0; i < KEYCACHE_NLOCKS; i++) {
+		isc_mutex_destroy(&cache->locks[i]);
+	}
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+void
+dns_keycache_flush(dns_keycache_t *cache) {
+	REQUIRE(VALID_KEYCACHE(cache));
+
+	for (size_t i = 0; i < cache->size; i++) {
+		isc_mutex_t *lock = &cache->locks[i % KEYCACHE_NLOCKS];
+		dst_key_t *key = NULL;
+
+		LOCK(lock);
+		key = cache->entries[i].key;
+		cache->entries[i].key = NULL;
+		UNLOCK(lock);
+
+		if (key != NULL) {
+			dst_key_free(&key);
+		}
+	}
+}
+
+static isc_result_t
+key_digest(const dns_name_t *name, dns_rdata_t *rdata, unsigned char *digest) {
+	dns_fixedname_t fixed;
+	dns_name_t *lname = dns_fixedname_initname(&fixed);
+	unsigned char header[2];
+	unsigned int digestlen;
+	isc_buffer_t b;
+	isc_region_t r;
+	isc_md_t *md = NULL;
+	isc_result_t result;
+
+	md = isc_md_new();
+	if (md == NULL) {
+		return (ISC_R_NOMEMORY);
+	}
+	CHECK(isc_md_init(md, ISC_MD_SHA256));
+
+	(void)dns_name_downcase(name, lname, NULL);
+	dns_name_toregion(lname, &r);
+	CHECK(isc_md_update(md, r.base, r.length));
+
+	isc_buffer_init(&b, header, sizeof(header));
+	isc_buffer_putuint16(&b, rdata->rdclass);
+	CHECK(isc_md_update(md, header, sizeof(header)));
+
+	dns_rdata_toregion(rdata, &r);
+	CHECK(isc_md_update(md, r.base, r.length));
+
+	CHECK(isc_md_final(md, digest, &digestlen));
+	INSIST(digestlen == KEYCACHE_DIGESTLENGTH);
+
+cleanup:
+	isc_md_free(md);
+	return (result);
+}
+
+isc_result_t
+dns_keycache_get(dns_keycache_t *cache, const dns_name_t *name,
+		 dns_rdata_t *rdata, isc_stdtime_t now, isc_stdtime_t expire,
+		 dst_key_t **keyp) {
+	unsigned char digest[KEYCACHE_DIGESTLENGTH];
+	unsigned int slot;
+	uint32_t hash;
+	keyentry_t *entry = NULL;
+	isc_mutex_t *lock = NULL;
+	dst_key_t *key = NULL, *old = NULL;
+	isc_buffer_t b;
+	isc_result_t result;
+
+	REQUIRE(VALID_KEYCACHE(cache));
+	REQUIRE(rdata != NULL && rdata->type == dns_rdatatype_dnskey);
+	REQUIRE(keyp != NULL && *keyp == NULL);
+
+	result = key_digest(name, rdata, digest);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	memmove(&hash, digest, sizeof(hash));
+	slot = hash & (cache->size - 1);
+	entry = &cache->entries[slot];
+	lock = &cache->locks[slot % KEYCACHE_NLOCKS];
+
+	LOCK(lock);
+	if (entry->key != NULL &&
+	    memcmp(entry->digest, digest, KEYCACHE_DIGESTLENGTH) == 0)
+	{
+		if (isc_serial_le(now, entry->expire)) {
+			dst_key_attach(entry->key, keyp);
+			UNLOCK(lock);
+			return (ISC_R_SUCCESS);
+		}
+		old = entry->key;
+		entry->key = NULL;
+	}
+	UNLOCK(lock);
+
+	if (old != NULL) {
+		dst_key_free(&old);
+	}
+
+	/*
+	 * Parse the key without holding the lock; if another thread
+	 * stored the same key meanwhile, its copy will simply be replaced.
+	 */
+	isc_buffer_init(&b, rdata->data, rdata->length);
+	isc_buffer_add(&b, rdata->length);
+	result = dst_key_fromdns(name, rdata->rdclass, &b, cache->mctx, &key);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	dst_key_attach(key, keyp);
+
+	LOCK(lock);
+	old = entry->key;
+	memmove(entry->digest, digest, KEYCACHE_DIGESTLENGTH);
+	entry->expire = expire;
+	entry->key = key;
+	UNLOCK(lock);
+
+	if (old != NULL) {
+		dst_key_free(&old);
+	}
+
+	return (ISC_R_SUCCESS);
+}
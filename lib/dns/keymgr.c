@@ -29,6 +29,7 @@
 #include <dns/dnssec.h>
 #include <dns/kasp.h>
 #include <dns/keymgr.h>
+#include <dns/keypool.h>
 #include <dns/keyvalues.h>
 #include <dns/log.h>
 
@@ -418,15 +419,16 @@ keymgr_keyid_conflict(dst_key_t *newkey, dns_dnsseckeylist_t *keys) {
 
 /*
  * Create a new key for 'origin' given the kasp key configuration 'kkey'.
- * This will check for key id collisions with keys in 'keylist'.
+ * The key is taken from 'keypool' if there is one there, and generated
+ * otherwise.  This will check for key id collisions with keys in 'keylist'.
  * The created key will be stored in 'dst_key'.
  *
  */
 static isc_result_t
 keymgr_createkey(dns_kasp_key_t *kkey, const dns_name_t *origin,
 		 dns_rdataclass_t rdclass, isc_mem_t *mctx,
-		 dns_dnsseckeylist_t *keylist, dns_dnsseckeylist_t *newkeys,
-		 dst_key_t **dst_key) {
+		 dns_keypool_t *keypool, dns_dnsseckeylist_t *keylist,
+		 dns_dnsseckeylist_t *newkeys, dst_key_t **dst_key) {
 	bool conflict = false;
 	int keyflags = DNS_KEYOWNER_ZONE;
 	isc_result_t result = ISC_R_SUCCESS;
@@ -439,9 +441,16 @@ keymgr_createkey(dns_kasp_key_t *kkey, const dns_name_t *origin,
 		if (dns_kasp_key_ksk(kkey)) {
 			keyflags |= DNS_KEYFLAG_KSK;
 		}
-		RETERR(dst_key_generate(origin, algo, size, 0, keyflags,
-					DNS_KEYPROTO_DNSSEC, rdclass, mctx,
-					&newkey, NULL));
+		result = ISC_R_NOTFOUND;
+		if (keypool != NULL) {
+			result = dns_keypool_get(keypool, origin, algo, size,
+						 keyflags, rdclass, &newkey);
+		}
+		if (result != ISC_R_SUCCESS) {
+			RETERR(dst_key_generate(origin, algo, size, 0,
+						keyflags, DNS_KEYPROTO_DNSSEC,
+						rdclass, mctx, &newkey, NULL));
+		}
 
 		/* Key collision? */
 		conflict = keymgr_keyid_conflict(newkey, keylist);
@@ -1644,7 +1653,7 @@ keymgr_key_rollover(dns_kasp_key_t *kaspkey, dns_dnsseckey_t *active_key,
 		    const dns_name_t *origin, dns_rdataclass_t rdclass,
 		    dns_kasp_t *kasp, uint32_t lifetime, bool rollover,
 		    isc_stdtime_t now, isc_stdtime_t *nexttime,
-		    isc_mem_t *mctx) {
+		    isc_mem_t *mctx, dns_keypool_t *keypool) {
 	char keystr[DST_KEY_FORMATSIZE];
 	isc_stdtime_t retire = 0, active = 0, prepub = 0;
 	dns_dnsseckey_t *new_key = NULL;
@@ -1761,9 +1770,9 @@ keymgr_key_rollover(dns_kasp_key_t *kaspkey, dns_dnsseckey_t *active_key,
 		bool csk = (dns_kasp_key_ksk(kaspkey) &&
 			    dns_kasp_key_zsk(kaspkey));
 
-		isc_result_t result = keymgr_createkey(kaspkey, origin, rdclass,
-						       mctx, keyring, newkeys,
-						       &dst_key);
+		isc_result_t result = keymgr_createkey(
+			kaspkey, origin, rdclass, mctx, keypool, keyring,
+			newkeys, &dst_key);
 		if (result != ISC_R_SUCCESS) {
 			return (result);
 		}
@@ -1948,7 +1957,8 @@ isc_result_t
 dns_keymgr_run(const dns_name_t *origin, dns_rdataclass_t rdclass,
 	       const char *directory, isc_mem_t *mctx,
 	       dns_dnsseckeylist_t *keyring, dns_dnsseckeylist_t *dnskeys,
-	       dns_kasp_t *kasp, isc_stdtime_t now, isc_stdtime_t *nexttime) {
+	       dns_kasp_t *kasp, dns_keypool_t *keypool, isc_stdtime_t now,
+	       isc_stdtime_t *nexttime) {
 	isc_result_t result = ISC_R_SUCCESS;
 	dns_dnsseckeylist_t newkeys;
 	dns_kasp_key_t *kkey;
@@ -2160,7 +2170,8 @@ dns_keymgr_run(const dns_name_t *origin, dns_rdataclass_t rdclass,
 		/* See if this key requires a rollover. */
 		RETERR(keymgr_key_rollover(
 			kkey, active_key, keyring, &newkeys, origin, rdclass,
-			kasp, lifetime, rollover_allowed, now, nexttime, mctx));
+			kasp, lifetime, rollover_allowed, now, nexttime, mctx,
+			keypool));
 	}
 
 	/* Walked all kasp key configurations.  Append new keys. */
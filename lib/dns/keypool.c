@@ -0,0 +1,383 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/list.h>
+#include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/refcount.h>
+#include <isc/result.h>
+#include <isc/time.h>
+#include <isc/util.h>
+#include <isc/work.h>
+
+#include <dns/keypool.h>
+#include <dns/keyvalues.h>
+#include <dns/log.h>
+#include <dns/name.h>
+#include <dns/rdataclass.h>
+#include <dns/secalg.h>
+
+#include <dst/dst.h>
+
+#define KEYPOOL_MAGIC	 ISC_MAGIC('K', 'e', 'y', 'P')
+#define VALID_KEYPOOL(p) ISC_MAGIC_VALID(p, KEYPOOL_MAGIC)
+
+/*
+ * The spare keys of one algorithm and size.  Buckets are only freed
+ * with the pool.
+ */
+typedef struct keybucket keybucket_t;
+struct keybucket {
+	dns_keypool_t *pool;
+	unsigned int alg;
+	unsigned int size;
+	unsigned int pending; /*%< keys being generated */
+	unsigned int count;
+	dst_key_t **keys;     /*%< 'count' keys, room for 'pool->depth' */
+	bool failed;	      /*%< stop generating after an error */
+	uint64_t generated;
+	uint64_t taken;
+	uint64_t missed;
+	uint64_t usecs;
+	ISC_LINK(keybucket_t) link;
+};
+
+/*
+ * One key being generated on a work thread.
+ */
+typedef struct keyjob {
+	keybucket_t *bucket;
+	dst_key_t *key;
+	isc_result_t result;
+	uint64_t usecs;
+} keyjob_t;
+
+struct dns_keypool {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	isc_loopmgr_t *loopmgr;
+	isc_refcount_t references;
+	isc_mutex_t lock;
+
+	/* Locked by lock. */
+	unsigned int depth;
+	bool shuttingdown;
+	ISC_LIST(keybucket_t) buckets;
+};
+
+static void
+refill(keybucket_t *bucket);
+
+void
+dns_keypool_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr,
+		   unsigned int depth, dns_keypool_t **poolp) {
+	dns_keypool_t *pool = NULL;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(loopmgr != NULL);
+	REQUIRE(poolp != NULL && *poolp == NULL);
+
+	pool = isc_mem_get(mctx, sizeof(*pool));
+	*pool = (dns_keypool_t){
+		.loopmgr = loopmgr,
+		.depth = depth,
+	};
+
+	isc_mem_attach(mctx, &pool->mctx);
+	isc_refcount_init(&pool->references, 1);
+	isc_mutex_init(&pool->lock);
+	ISC_LIST_INIT(pool->buckets);
+
+	pool->magic = KEYPOOL_MAGIC;
+
+	*poolp = pool;
+}
+
+/*
+ * Free the keys of 'bucket' above 'depth'.  The pool must be locked.
+ */
+static void
+trim(keybucket_t *bucket, unsigned int depth) {
+	while (bucket->count > depth) {
+		dst_key_free(&bucket->keys[--bucket->count]);
+	}
+}
+
+static dst_key_t **
+getkeys(dns_keypool_t *pool, unsigned int depth) {
+	if (depth == 0) {
+		return (NULL);
+	}
+	return (isc_mem_get(pool->mctx, depth * sizeof(dst_key_t *)));
+}
+
+static void
+putkeys(dns_keypool_t *pool, dst_key_t **keys, unsigned int depth) {
+	if (keys != NULL) {
+		isc_mem_put(pool->mctx, keys, depth * sizeof(keys[0]));
+	}
+}
+
+static void
+keypool_destroy(dns_keypool_t *pool) {
+	keybucket_t *bucket = NULL;
+
+	REQUIRE(VALID_KEYPOOL(pool));
+
+	pool->magic = 0;
+
+	while ((bucket = ISC_LIST_HEAD(pool->buckets)) != NULL) {
+		INSIST(bucket->pending == 0);
+		ISC_LIST_UNLINK(pool->buckets, bucket, link);
+		trim(bucket, 0);
+		putkeys(pool, bucket->keys, pool->depth);
+		isc_mem_put(pool->mctx, bucket, sizeof(*bucket));
+	}
+
+	isc_refcount_destroy(&pool->references);
+	isc_mutex_destroy(&pool->lock);
+	isc_mem_putanddetach(&pool->mctx, pool, sizeof(*pool));
+}
+
+ISC_REFCOUNT_IMPL(dns_keypool, keypool_destroy);
+
+void
+dns_keypool_shutdown(dns_keypool_t *pool) {
+	REQUIRE(VALID_KEYPOOL(pool));
+
+	LOCK(&pool->lock);
+	pool->shuttingdown = true;
+	for (keybucket_t *bucket = ISC_LIST_HEAD(pool->buckets);
+	     bucket != NULL; bucket = ISC_LIST_NEXT(bucket, link))
+	{
+		trim(bucket, 0);
+	}
+	UNLOCK(&pool->lock);
+}
+
+void
+dns_keypool_setdepth(dns_keypool_t *pool, unsigned int depth) {
+	REQUIRE(VALID_KEYPOOL(pool));
+
+	LOCK(&pool->lock);
+	for (keybucket_t *bucket = ISC_LIST_HEAD(pool->buckets);
+	     bucket != NULL; bucket = ISC_LIST_NEXT(bucket, link))
+	{
+		dst_key_t **keys = getkeys(pool, depth);
+
+		trim(bucket, depth);
+		if (bucket->count > 0) {
+			memmove(keys, bucket->keys,
+				bucket->count * sizeof(keys[0]));
+		}
+		putkeys(pool, bucket->keys, pool->depth);
+		bucket->keys = keys;
+	}
+	pool->depth = depth;
+	UNLOCK(&pool->lock);
+}
+
+unsigned int
+dns_keypool_getdepth(dns_keypool_t *pool) {
+	unsigned int depth;
+
+	REQUIRE(VALID_KEYPOOL(pool));
+
+	LOCK(&pool->lock);
+	depth = pool->depth;
+	UNLOCK(&pool->lock);
+
+	return (depth);
+}
+
+static void
+generate_work(void *arg) {
+	keyjob_t *job = arg;
+	keybucket_t *bucket = job->bucket;
+	isc_time_t start, end;
+
+	isc_time_now(&start);
+	job->result = dst_key_generate(
+		dns_rootname, bucket->alg, bucket->size, 0, DNS_KEYOWNER_ZONE,
+		DNS_KEYPROTO_DNSSEC, dns_rdataclass_in, bucket->pool->mctx,
+		&job->key, NULL);
+	isc_time_now(&end);
+	job->usecs = isc_time_microdiff(&end, &start);
+}
+
+static void
+generate_done(void *arg) {
+	keyjob_t *job = arg;
+	keybucket_t *bucket = job->bucket;
+	dns_keypool_t *pool = bucket->pool;
+
+	LOCK(&pool->lock);
+	INSIST(bucket->pending > 0);
+	bucket->pending--;
+	if (job->result == ISC_R_SUCCESS) {
+		bucket->generated++;
+		bucket->usecs += job->usecs;
+		if (!pool->shuttingdown && bucket->count < pool->depth) {
+			bucket->keys[bucket->count++] = job->key;
+			job->key = NULL;
+		}
+		refill(bucket);
+	} else if (!bucket->failed) {
+		char algbuf[DNS_SECALG_FORMATSIZE];
+
+		bucket->failed = true;
+		dns_secalg_format(bucket->alg, algbuf, sizeof(algbuf));
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_DNSSEC,
+			      DNS_LOGMODULE_DNSSEC, ISC_LOG_ERROR,
+			      "key pool: generating %s/%u keys failed: %s",
+			      algbuf, bucket->size,
+			      isc_result_totext(job->result));
+	}
+	UNLOCK(&pool->lock);
+
+	if (job->key != NULL) {
+		dst_key_free(&job->key);
+	}
+	isc_mem_put(pool->mctx, job, sizeof(*job));
+	dns_keypool_detach(&pool);
+}
+
+/*
+ * Start generating keys until the keys in 'bucket' and those being
+ * generated fill it.  The pool must be locked.
+ */
+static void
+refill(keybucket_t *bucket) {
+	dns_keypool_t *pool = bucket->pool;
+
+	if (pool->shuttingdown || bucket->failed) {
+		return;
+	}
+
+	while (bucket->pending < DNS_KEYPOOL_MAXPENDING &&
+	       bucket->count + bucket->pending < pool->depth)
+	{
+		keyjob_t *job = isc_mem_get(pool->mctx, sizeof(*job));
+
+		*job = (keyjob_t){
+			.bucket = bucket,
+		};
+
+		bucket->pending++;
+		dns_keypool_ref(pool);
+		isc_work_enqueue(isc_loop_current(pool->loopmgr),
+				 generate_work, generate_done, job);
+	}
+}
+
+/*
+ * Find the bucket of 'alg' and 'size', creating it if there is none.
+ * The pool must be locked.
+ */
+static keybucket_t *
+getbucket(dns_keypool_t *pool, unsigned int alg, unsigned int size) {
+	keybucket_t *bucket = NULL;
+
+	for (bucket = ISC_LIST_HEAD(pool->buckets); bucket != NULL;
+	     bucket = ISC_LIST_NEXT(bucket, link))
+	{
+		if (bucket->alg == alg && bucket->size == size) {
+			return (bucket);
+		}
+	}
+
+	bucket = isc_mem_get(pool->mctx, sizeof(*bucket));
+	*bucket = (keybucket_t){
+		.pool = pool,
+		.alg = alg,
+		.size = size,
+	};
+	ISC_LINK_INIT(bucket, link);
+	bucket->keys = getkeys(pool, pool->depth);
+	ISC_LIST_APPEND(pool->buckets, bucket, link);
+
+	return (bucket);
+}
+
+isc_result_t
+dns_keypool_get(dns_keypool_t *pool, const dns_name_t *name,
+		unsigned int alg, unsigned int size, unsigned int flags,
+		dns_rdataclass_t rdclass, dst_key_t **keyp) {
+	keybucket_t *bucket = NULL;
+	dst_key_t *key = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_KEYPOOL(pool));
+	REQUIRE(dns_name_isabsolute(name));
+	REQUIRE(keyp != NULL && *keyp == NULL);
+
+	LOCK(&pool->lock);
+	if (pool->shuttingdown || pool->depth == 0) {
+		UNLOCK(&pool->lock);
+		return (ISC_R_NOTFOUND);
+	}
+	bucket = getbucket(pool, alg, size);
+	if (bucket->count > 0) {
+		key = bucket->keys[--bucket->count];
+		bucket->taken++;
+	} else {
+		bucket->missed++;
+	}
+	refill(bucket);
+	UNLOCK(&pool->lock);
+
+	if (key == NULL) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	dst_key_setowner(key, name, rdclass);
+	result = dst_key_setflags(key, flags);
+	if (result != ISC_R_SUCCESS) {
+		dst_key_free(&key);
+		return (result);
+	}
+
+	*keyp = key;
+	return (ISC_R_SUCCESS);
+}
+
+void
+dns_keypool_dump(dns_keypool_t *pool, dns_keypool_dump_t dump, void *arg) {
+	REQUIRE(VALID_KEYPOOL(pool));
+	REQUIRE(dump != NULL);
+
+	LOCK(&pool->lock);
+	for (keybucket_t *bucket = ISC_LIST_HEAD(pool->buckets);
+	     bucket != NULL; bucket = ISC_LIST_NEXT(bucket, link))
+	{
+		dns_keypool_stats_t stats = {
+			.algorithm = bucket->alg,
+			.size = bucket->size,
+			.depth = pool->depth,
+			.available = bucket->count,
+			.generated = bucket->generated,
+			.taken = bucket->taken,
+			.missed = bucket->missed,
+			.usecs = bucket->usecs,
+		};
+
+		dump(&stats, arg);
+	}
+	UNLOCK(&pool->lock);
+}
@@ -17,6 +17,7 @@
 
 #include <isc/mem.h>
 #include <isc/print.h>
+#include <isc/rcu.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
 #include <isc/rwlock.h>
@@ -32,6 +33,8 @@
 #include <dns/rdataset.h>
 #include <dns/rdatastruct.h>
 
+#include "namesnap_p.h"
+
 #define KEYTABLE_MAGIC	   ISC_MAGIC('K', 'T', 'b', 'l')
 #define VALID_KEYTABLE(kt) ISC_MAGIC_VALID(kt, KEYTABLE_MAGIC)
 
@@ -46,6 +49,8 @@ struct dns_keytable {
 	isc_rwlock_t rwlock;
 	/* Locked by rwlock. */
 	dns_rbt_t *table;
+	/* Updated under the write lock, read without it on loop threads. */
+	dns__namesnaps_t *snaps;
 };
 
 struct dns_keynode {
@@ -161,6 +166,9 @@ dns_keytable_create(isc_mem_t *mctx, dns_keytable_t **keytablep) {
 	isc_rwlock_init(&keytable->rwlock, 0, 0);
 	isc_refcount_init(&keytable->references, 1);
 
+	keytable->snaps = NULL;
+	dns__namesnaps_create(mctx, &keytable->snaps);
+
 	keytable->mctx = NULL;
 	isc_mem_attach(mctx, &keytable->mctx);
 	keytable->magic = KEYTABLE_MAGIC;
@@ -193,6 +201,7 @@ dns_keytable_detach(dns_keytable_t **keytablep) {
 	if (isc_refcount_decrement(&keytable->references) == 1) {
 		isc_refcount_destroy(&keytable->references);
 		dns_rbt_destroy(&keytable->table);
+		dns__namesnaps_destroy(&keytable->snaps);
 		isc_rwlock_destroy(&keytable->rwlock);
 		keytable->magic = 0;
 		isc_mem_putanddetach(&keytable->mctx, keytable,
@@ -385,6 +394,7 @@ insert(dns_keytable_t *keytable, bool managed, bool initial,
 		 * and attach it to the created node.
 		 */
 		node->data = new_keynode(ds, keytable, managed, initial);
+		dns__namesnaps_update(keytable->snaps, keytable->table, NULL);
 		if (callback != NULL) {
 			(*callback)(keyname, callback_arg);
 		}
@@ -397,6 +407,8 @@ insert(dns_keytable_t *keytable, bool managed, bool initial,
 			if (knode == NULL) {
 				node->data = new_keynode(ds, keytable, managed,
 							 initial);
+				dns__namesnaps_update(keytable->snaps,
+						      keytable->table, NULL);
 				if (callback != NULL) {
 					(*callback)(keyname, callback_arg);
 				}
@@ -444,6 +456,8 @@ dns_keytable_delete(dns_keytable_t *keytable, const dns_name_t *keyname,
 		if (node->data != NULL) {
 			result = dns_rbt_deletenode(keytable->table, node,
 						    false);
+			dns__namesnaps_update(keytable->snaps, keytable->table,
+					      NULL);
 			if (callback != NULL) {
 				(*callback)(keyname, callback_arg);
 			}
@@ -556,6 +570,15 @@ dns_keytable_finddeepestmatch(dns_keytable_t *keytable, const dns_name_t *name,
 	REQUIRE(dns_name_isabsolute(name));
 	REQUIRE(foundname != NULL);
 
+	if (isc_rcu_available()) {
+		if (dns__namesnaps_find(keytable->snaps, name, foundname,
+					NULL))
+		{
+			return (ISC_R_SUCCESS);
+		}
+		return (ISC_R_NOTFOUND);
+	}
+
 	RWLOCK(&keytable->rwlock, isc_rwlocktype_read);
 
 	data = NULL;
@@ -596,6 +619,16 @@ dns_keytable_issecuredomain(dns_keytable_t *keytable, const dns_name_t *name,
 	REQUIRE(dns_name_isabsolute(name));
 	REQUIRE(wantdnssecp != NULL);
 
+	/*
+	 * Loop threads look in the copy of the trust anchor names rather
+	 * than in the rbt, without locking.
+	 */
+	if (isc_rcu_available()) {
+		*wantdnssecp = dns__namesnaps_find(keytable->snaps, name,
+						   foundname, NULL);
+		return (ISC_R_SUCCESS);
+	}
+
 	RWLOCK(&keytable->rwlock, isc_rwlocktype_read);
 
 	result = dns_rbt_findnode(keytable->table, name, foundname, &node, NULL,
@@ -15,12 +15,18 @@
 
 #include <inttypes.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <isc/atomic.h>
 #include <isc/event.h>
+#include <isc/file.h>
 #include <isc/lex.h>
+#include <isc/loop.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/os.h>
 #include <isc/print.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
@@ -29,7 +35,9 @@
 #include <isc/stdtime.h>
 #include <isc/string.h>
 #include <isc/task.h>
+#include <isc/thread.h>
 #include <isc/util.h>
+#include <isc/work.h>
 
 #include <dns/callbacks.h>
 #include <dns/events.h>
@@ -40,6 +48,7 @@
 #include <dns/rdataclass.h>
 #include <dns/rdatalist.h>
 #include <dns/rdataset.h>
+#include <dns/rdataslab.h>
 #include <dns/rdatastruct.h>
 #include <dns/rdatatype.h>
 #include <dns/soa.h>
@@ -88,11 +97,36 @@
 #define DNS_MASTER_LHS 2048
 #define DNS_MASTER_RHS MINTSIZ
 
+/*%
+ * Text files of at least twice CHUNKSIZ bytes loaded asynchronously are
+ * split into chunks of about CHUNKSIZ bytes parsed in parallel.  What
+ * the parsers find is recorded in blocks of at least CHUNKMEMSIZ bytes.
+ */
+#define CHUNKSIZ    (1024 * 1024)
+#define CHUNKMEMSIZ (64 * 1024)
+
+/*%
+ * Number of bytes at the start of each line looked at by the pre-pass
+ * finding the chunk boundaries, and size of the warning and error
+ * messages recorded.
+ */
+#define CHUNKPEEK   1024
+#define CHUNKMSGSIZ 8192
+
+/*%
+ * One-time warnings, which are checked again when chunks are replayed.
+ */
+#define CHUNK_WARN1035	     0x01
+#define CHUNK_WARNTCR	     0x02
+#define CHUNK_WARNSIGEXPIRED 0x04
+
 #define CHECKNAMESFAIL(x) (((x)&DNS_MASTER_CHECKNAMESFAIL) != 0)
 
 typedef ISC_LIST(dns_rdatalist_t) rdatalist_head_t;
 
 typedef struct dns_incctx dns_incctx_t;
+typedef struct chunk chunk_t;
+typedef struct loadchunks loadchunks_t;
 
 /*%
  * Master file load state.
@@ -135,6 +169,11 @@ struct dns_loadctx {
 	FILE *f;
 	bool first;
 	dns_masterrawheader_t header;
+	dns_trust_t trust;	 /*%< of the RRset being committed */
+	unsigned int attributes; /*%< likewise */
+	unsigned char *map;	 /*%< the file mapped into memory */
+	size_t maplen;
+	size_t mappos; /*%< offset of the next RRset in 'map' */
 
 	/* Which fixed buffers we are using? */
 	unsigned int loop_cnt; /*% records per quantum,
@@ -149,9 +188,16 @@ struct dns_loadctx {
 	dns_incctx_t *inc;
 	uint32_t resign;
 	isc_stdtime_t now;
+	bool havesigtimes;    /*%< the next RRSIG set's times are known */
+	uint32_t sigexpire;   /*%< its earliest expiration */
+	uint32_t siginception; /*%< its latest inception */
 
 	dns_masterincludecb_t include_cb;
 	void *include_arg;
+
+	/* Members used for parallel loading: */
+	loadchunks_t *chunks; /*%< chunks of the file, if split */
+	chunk_t *chunk;	      /*%< chunk parsed by this context */
 };
 
 struct dns_incctx {
@@ -194,6 +240,10 @@ static isc_result_t
 commit(dns_rdatacallbacks_t *, dns_loadctx_t *, rdatalist_head_t *,
        dns_name_t *, const char *, unsigned int);
 
+static isc_result_t
+add_rdataset(dns_rdatacallbacks_t *, dns_loadctx_t *, dns_rdataset_t *,
+	     dns_name_t *, const char *, unsigned int);
+
 static bool
 is_glue(rdatalist_head_t *, dns_name_t *);
 
@@ -211,6 +261,29 @@ load_quantum(isc_task_t *task, isc_event_t *event);
 static isc_result_t
 task_send(dns_loadctx_t *lctx);
 
+static isc_result_t
+load_chunks(dns_loadctx_t *lctx);
+
+static isc_result_t
+load_chunks_sync(dns_loadctx_t *lctx);
+
+static void
+loadchunks_create(dns_loadctx_t *lctx, const char *master_file);
+
+static void
+loadchunks_destroy(dns_loadctx_t *lctx);
+
+static isc_result_t
+chunk_commit(dns_loadctx_t *lctx, rdatalist_head_t *head, dns_name_t *owner,
+	     unsigned int line);
+
+static void
+chunk_warnonce(dns_loadctx_t *lctx, unsigned int warn);
+
+static void
+chunk_finish(dns_loadctx_t *lctx, rdatalist_head_t *current_list,
+	     rdatalist_head_t *glue_list, bool delegation, const char *source);
+
 static void
 loadctx_destroy(dns_loadctx_t *lctx);
 
@@ -268,7 +341,7 @@ loadctx_destroy(dns_loadctx_t *lctx);
 
 #define WARNUNEXPECTEDEOF(lexer)                                         \
 	do {                                                             \
-		if (isc_lex_isfile(lexer))                               \
+		if (isc_lex_isfile(lexer) || lctx->chunk != NULL)        \
 			(*callbacks->warn)(callbacks,                    \
 					   "%s: file does not end with " \
 					   "newline",                    \
@@ -442,6 +515,14 @@ loadctx_destroy(dns_loadctx_t *lctx) {
 		incctx_destroy(lctx->mctx, lctx->inc);
 	}
 
+	if (lctx->chunks != NULL) {
+		loadchunks_destroy(lctx);
+	}
+
+	if (lctx->map != NULL) {
+		(void)munmap(lctx->map, lctx->maplen);
+	}
+
 	if (lctx->f != NULL) {
 		isc_result_t result = isc_stdio_close(lctx->f);
 		if (result != ISC_R_SUCCESS) {
@@ -577,9 +658,12 @@ loadctx_create(dns_masterformat_t format, isc_mem_t *mctx, unsigned int options,
 	lctx->seen_include = false;
 	lctx->zclass = zclass;
 	lctx->resign = resign;
+	lctx->havesigtimes = false;
 	lctx->result = ISC_R_SUCCESS;
 	lctx->include_cb = include_cb;
 	lctx->include_arg = include_arg;
+	lctx->chunks = NULL;
+	lctx->chunk = NULL;
 	isc_stdtime_get(&lctx->now);
 
 	lctx->top = dns_fixedname_initname(&lctx->fixed_top);
@@ -588,6 +672,11 @@ loadctx_create(dns_masterformat_t format, isc_mem_t *mctx, unsigned int options,
 
 	lctx->f = NULL;
 	lctx->first = true;
+	lctx->map = NULL;
+	lctx->maplen = 0;
+	lctx->mappos = 0;
+	lctx->trust = dns_trust_ultimate;
+	lctx->attributes = 0;
 	dns_master_initrawheader(&lctx->header);
 
 	lctx->loop_cnt = (done != NULL) ? 100 : 0;
@@ -1973,6 +2062,7 @@ load_text(dns_loadctx_t *lctx) {
 					   "%s:%lu: "
 					   "using RFC1035 TTL semantics",
 					   source, line);
+			chunk_warnonce(lctx, CHUNK_WARN1035);
 			lctx->warn_1035 = false;
 		}
 
@@ -1986,6 +2076,7 @@ load_text(dns_loadctx_t *lctx) {
 						   "%s:%lu: "
 						   "signature has expired",
 						   source, line);
+				chunk_warnonce(lctx, CHUNK_WARNSIGEXPIRED);
 				lctx->warn_sigexpired = false;
 			}
 		}
@@ -1997,6 +2088,7 @@ load_text(dns_loadctx_t *lctx) {
 					   "%s:%lu: old style DNSSEC "
 					   " zone detected",
 					   source, line);
+			chunk_warnonce(lctx, CHUNK_WARNTCR);
 			lctx->warn_tcr = false;
 		}
 
@@ -2098,6 +2190,15 @@ load_text(dns_loadctx_t *lctx) {
 	next_line:;
 	} while (!done && (lctx->loop_cnt == 0 || loop_cnt++ < lctx->loop_cnt));
 
+	/*
+	 * When parsing a chunk of a file, check that the serial loader
+	 * would not carry anything over into the next chunk.
+	 */
+	if (lctx->chunk != NULL && done) {
+		chunk_finish(lctx, &current_list, &glue_list,
+			     current_has_delegation, source);
+	}
+
 	/*
 	 * Commit what has not yet been committed.
 	 */
@@ -2249,6 +2350,39 @@ read_and_check(bool do_read, isc_buffer_t *buffer, size_t len, FILE *f,
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Map the rest of a version 2 raw file into memory, so that its slabs
+ * can be added to the database without being read and parsed.  If the
+ * file cannot be mapped it is read instead.
+ */
+static void
+map_raw(dns_loadctx_t *lctx) {
+	struct stat sb;
+	off_t pos;
+	void *map;
+
+	if (fstat(fileno(lctx->f), &sb) != 0 || !S_ISREG(sb.st_mode) ||
+	    sb.st_size <= 0 || (uintmax_t)sb.st_size > SIZE_MAX ||
+	    isc_stdio_tell(lctx->f, &pos) != ISC_R_SUCCESS ||
+	    pos > sb.st_size)
+	{
+		return;
+	}
+
+	map = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE,
+		   fileno(lctx->f), 0);
+	if (map == MAP_FAILED) {
+		return;
+	}
+#ifdef MADV_SEQUENTIAL
+	(void)madvise(map, (size_t)sb.st_size, MADV_SEQUENTIAL);
+#endif /* ifdef MADV_SEQUENTIAL */
+
+	lctx->map = map;
+	lctx->maplen = (size_t)sb.st_size;
+	lctx->mappos = (size_t)pos;
+}
+
 static isc_result_t
 load_header(dns_loadctx_t *lctx) {
 	isc_result_t result = ISC_R_SUCCESS;
@@ -2294,6 +2428,7 @@ load_header(dns_loadctx_t *lctx) {
 	case 0:
 		remainder = sizeof(header.dumptime);
 		break;
+	case 1:
 	case DNS_RAWFORMAT_VERSION:
 		remainder = sizeof(header) - commonlen;
 		break;
@@ -2314,7 +2449,7 @@ load_header(dns_loadctx_t *lctx) {
 
 	isc_buffer_add(&target, (unsigned int)remainder);
 	header.dumptime = isc_buffer_getuint32(&target);
-	if (header.version == DNS_RAWFORMAT_VERSION) {
+	if (header.version != 0) {
 		header.flags = isc_buffer_getuint32(&target);
 		header.sourceserial = isc_buffer_getuint32(&target);
 		header.lastxfrin = isc_buffer_getuint32(&target);
@@ -2323,6 +2458,10 @@ load_header(dns_loadctx_t *lctx) {
 	lctx->first = false;
 	lctx->header = header;
 
+	if (header.version == 2) {
+		map_raw(lctx);
+	}
+
 	return (ISC_R_SUCCESS);
 }
 
@@ -2340,6 +2479,396 @@ openfile_raw(dns_loadctx_t *lctx, const char *master_file) {
 	return (result);
 }
 
+/*
+ * Get the next RRset of a version 2 raw file, without its length, into
+ * 'r'.  It points into the mapped file, or else into '*bufp', which is
+ * grown as the data is read so that a forged length cannot make us
+ * allocate more than twice the size of the file.
+ */
+static isc_result_t
+read_rawslab(dns_loadctx_t *lctx, unsigned char **bufp, size_t *sizep,
+	     size_t minlen, isc_region_t *r) {
+	isc_result_t result;
+	unsigned char data[sizeof(uint32_t)];
+	isc_buffer_t b;
+	uint32_t totallen;
+	size_t have = 0;
+
+	if (lctx->map != NULL) {
+		size_t avail = lctx->maplen - lctx->mappos;
+
+		if (avail == 0) {
+			return (ISC_R_NOMORE);
+		}
+		if (avail < sizeof(totallen)) {
+			return (ISC_R_RANGE);
+		}
+		isc_buffer_init(&b, lctx->map + lctx->mappos, sizeof(totallen));
+		isc_buffer_add(&b, sizeof(totallen));
+		totallen = isc_buffer_getuint32(&b);
+		if (totallen < minlen || totallen > avail) {
+			return (ISC_R_RANGE);
+		}
+		r->base = lctx->map + lctx->mappos + sizeof(totallen);
+		r->length = totallen - sizeof(totallen);
+		lctx->mappos += totallen;
+		return (ISC_R_SUCCESS);
+	}
+
+	result = isc_stdio_read(data, 1, sizeof(data), lctx->f, NULL);
+	if (result == ISC_R_EOF) {
+		return (ISC_R_NOMORE);
+	}
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	isc_buffer_init(&b, data, sizeof(data));
+	isc_buffer_add(&b, sizeof(data));
+	totallen = isc_buffer_getuint32(&b);
+	if (totallen < minlen) {
+		return (ISC_R_RANGE);
+	}
+	totallen -= sizeof(totallen);
+
+	while (have < totallen) {
+		size_t len;
+
+		if (have == *sizep) {
+			size_t size = ISC_MIN(totallen, ISC_MAX(2 * *sizep,
+								TSIZ));
+			unsigned char *buf = isc_mem_get(lctx->mctx, size);
+
+			if (*bufp != NULL) {
+				memmove(buf, *bufp, have);
+				isc_mem_put(lctx->mctx, *bufp, *sizep);
+			}
+			*bufp = buf;
+			*sizep = size;
+		}
+		len = ISC_MIN(*sizep, totallen) - have;
+		result = isc_stdio_read(*bufp + have, 1, len, lctx->f, NULL);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+		have += len;
+	}
+
+	r->base = *bufp;
+	r->length = totallen;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Check that 'r' holds a well formed slab of 'count' records of type
+ * 'type', laid out with a load order table if 'fixed' is set.  If
+ * 'rdata' is not NULL, make its elements refer to the records, in load
+ * order if it is known.  'scratch' must have room for any rdata.
+ */
+static isc_result_t
+check_rawslab(isc_region_t *r, dns_rdataclass_t rdclass,
+	      dns_rdatatype_t type, unsigned int count, bool fixed,
+	      dns_rdata_t *rdata, unsigned char *scratch) {
+	unsigned char *base = r->base;
+	size_t pos = 2, table = 2;
+
+	if (r->length < 2 || base[0] * 256U + base[1] != count) {
+		return (ISC_R_RANGE);
+	}
+	if (fixed) {
+		if (r->length - pos < 4 * (size_t)count) {
+			return (ISC_R_RANGE);
+		}
+		pos += 4 * (size_t)count;
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		dns_rdata_t tmp = DNS_RDATA_INIT;
+		unsigned int length, order = i;
+		bool offline = false;
+		isc_buffer_t source, target;
+		isc_result_t result;
+		size_t start = pos;
+
+		if (r->length - pos < (fixed ? 4 : 2)) {
+			return (ISC_R_RANGE);
+		}
+		length = base[pos] * 256U + base[pos + 1];
+		pos += 2;
+		if (fixed) {
+			unsigned char *offset;
+
+			/*
+			 * The load order table must refer to this record
+			 * by its order, so that it can be walked safely.
+			 */
+			order = base[pos] * 256U + base[pos + 1];
+			pos += 2;
+			if (order >= count) {
+				return (ISC_R_RANGE);
+			}
+			offset = base + table + 4 * order;
+			if (((size_t)offset[0] << 24 | offset[1] << 16 |
+			     offset[2] << 8 | offset[3]) != start)
+			{
+				return (ISC_R_RANGE);
+			}
+		}
+		if (type == dns_rdatatype_rrsig) {
+			if (length == 0 || r->length - pos < 1) {
+				return (ISC_R_RANGE);
+			}
+			offline = (base[pos] & DNS_RDATASLAB_OFFLINE) != 0;
+			pos++;
+			length--;
+		}
+		if (r->length - pos < length) {
+			return (ISC_R_RANGE);
+		}
+
+		/*
+		 * The records are added to the database as they are, but
+		 * they must still be valid wire format data.
+		 */
+		isc_buffer_init(&source, base + pos, length);
+		isc_buffer_add(&source, length);
+		isc_buffer_setactive(&source, length);
+		isc_buffer_init(&target, scratch, DNS_RDATA_MAXLENGTH);
+		result = dns_rdata_fromwire(&tmp, rdclass, type, &source,
+					    DNS_DECOMPRESS_NEVER, 0, &target);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+		if (isc_buffer_remaininglength(&source) != 0) {
+			return (ISC_R_RANGE);
+		}
+
+		if (rdata != NULL) {
+			dns_rdata_init(&rdata[order]);
+			dns_rdata_fromregion(&rdata[order], rdclass, type,
+					     &(isc_region_t){ base + pos,
+							      length });
+			if (offline) {
+				rdata[order].flags |= DNS_RDATA_OFFLINE;
+			}
+		}
+		pos += length;
+	}
+
+	if (pos != r->length) {
+		return (ISC_R_RANGE);
+	}
+	if (count > 1 && dns_rdatatype_issingleton(type)) {
+		return (DNS_R_SINGLETON);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Load a version 2 raw file, whose RRsets are rdataslabs.  When their
+ * layout is the one of this build they are added to the database as
+ * slab rdatasets, which it copies without sorting them again; else
+ * their records are added as a list.
+ */
+static isc_result_t
+load_rawslab(dns_loadctx_t *lctx) {
+	isc_result_t result = ISC_R_SUCCESS;
+	bool done = false;
+	unsigned int loop_cnt;
+	dns_rdatacallbacks_t *callbacks = lctx->callbacks;
+	isc_mem_t *mctx = lctx->mctx;
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	unsigned char *buf = NULL, *scratch = NULL;
+	size_t bufsize = 0;
+	dns_rdata_t *rdata = NULL;
+	unsigned int rdata_size = 0;
+	rdatalist_head_t head, dummy;
+	bool slabfixed = (lctx->header.flags & DNS_MASTERRAW_SLABFIXED) != 0;
+	bool sigtimes = (lctx->header.flags & DNS_MASTERRAW_SIGTIMES) != 0;
+	bool native;
+	size_t minlen;
+
+#if DNS_RDATASET_FIXED
+	native = slabfixed;
+#else  /* if DNS_RDATASET_FIXED */
+	native = !slabfixed;
+#endif /* if DNS_RDATASET_FIXED */
+
+	if ((lctx->header.flags & DNS_MASTERRAW_CACHE) != 0) {
+		result = ISC_R_NOTIMPLEMENTED;
+		goto cleanup;
+	}
+
+	ISC_LIST_INIT(head);
+	ISC_LIST_INIT(dummy);
+	scratch = isc_mem_get(mctx, DNS_RDATA_MAXLENGTH);
+
+	minlen = sizeof(uint32_t) + sizeof(uint16_t) + sizeof(uint16_t) +
+		 sizeof(uint16_t) + sizeof(uint32_t) + sizeof(uint32_t) +
+		 sizeof(uint16_t);
+
+	/*
+	 * As in load_raw(), any error is fatal.
+	 */
+	for (loop_cnt = 0; (lctx->loop_cnt == 0 || loop_cnt < lctx->loop_cnt);
+	     loop_cnt++)
+	{
+		dns_rdataset_t rdataset;
+		dns_rdataclass_t rdclass;
+		dns_rdatatype_t type, covers;
+		dns_ttl_t ttl;
+		unsigned int rdcount;
+		uint16_t namelen;
+		isc_buffer_t target;
+		isc_region_t r;
+
+		result = read_rawslab(lctx, &buf, &bufsize, minlen, &r);
+		if (result == ISC_R_NOMORE) {
+			result = ISC_R_SUCCESS;
+			done = true;
+			break;
+		}
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+
+		isc_buffer_init(&target, r.base, r.length);
+		isc_buffer_add(&target, r.length);
+		rdclass = isc_buffer_getuint16(&target);
+		if (lctx->zclass != rdclass) {
+			result = DNS_R_BADCLASS;
+			goto cleanup;
+		}
+		type = isc_buffer_getuint16(&target);
+		covers = isc_buffer_getuint16(&target);
+		ttl = isc_buffer_getuint32(&target);
+		rdcount = isc_buffer_getuint32(&target);
+		if (rdcount == 0 || rdcount > 0xffff) {
+			result = ISC_R_RANGE;
+			goto cleanup;
+		}
+
+		if (sigtimes && type == dns_rdatatype_rrsig) {
+			if (isc_buffer_remaininglength(&target) <
+			    2 * sizeof(uint32_t) + sizeof(uint16_t))
+			{
+				result = ISC_R_RANGE;
+				goto cleanup;
+			}
+			lctx->sigexpire = isc_buffer_getuint32(&target);
+			lctx->siginception = isc_buffer_getuint32(&target);
+			lctx->havesigtimes = true;
+		}
+
+		namelen = isc_buffer_getuint16(&target);
+		if (namelen > DNS_NAME_MAXWIRE ||
+		    isc_buffer_remaininglength(&target) < namelen)
+		{
+			result = ISC_R_RANGE;
+			goto cleanup;
+		}
+		isc_buffer_setactive(&target, namelen);
+		result = dns_name_fromwire(name, &target, DNS_DECOMPRESS_NEVER,
+					   0, NULL);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+
+		if ((lctx->options & DNS_MASTER_CHECKTTL) != 0 &&
+		    ttl > lctx->maxttl) {
+			(callbacks->error)(callbacks,
+					   "dns_master_load: "
+					   "TTL %d exceeds configured "
+					   "max-zone-ttl %d",
+					   ttl, lctx->maxttl);
+			result = ISC_R_RANGE;
+			goto cleanup;
+		}
+
+		if (!native && rdcount > rdata_size) {
+			dns_rdata_t *new_rdata = NULL;
+
+			new_rdata = grow_rdata(rdcount + RDSZ, rdata,
+					       rdata_size, &head, &dummy, mctx);
+			if (new_rdata == NULL) {
+				result = ISC_R_NOMEMORY;
+				goto cleanup;
+			}
+			rdata_size = rdcount + RDSZ;
+			rdata = new_rdata;
+		}
+
+		isc_buffer_remainingregion(&target, &r);
+		result = check_rawslab(&r, rdclass, type, rdcount, slabfixed,
+				       native ? NULL : rdata, scratch);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+
+		if (native) {
+			dns_rdataset_init(&rdataset);
+			dns_rdataslab_tordataset(r.base, 0, rdclass, type,
+						 covers, ttl, &rdataset);
+			result = add_rdataset(callbacks, lctx, &rdataset, name,
+					      NULL, 0);
+			dns_rdataset_disassociate(&rdataset);
+		} else {
+			dns_rdatalist_t rdatalist;
+
+			dns_rdatalist_init(&rdatalist);
+			rdatalist.rdclass = rdclass;
+			rdatalist.type = type;
+			rdatalist.covers = covers;
+			rdatalist.ttl = ttl;
+			for (unsigned int i = 0; i < rdcount; i++) {
+				ISC_LIST_APPEND(rdatalist.rdata, &rdata[i],
+						link);
+			}
+			ISC_LIST_APPEND(head, &rdatalist, link);
+			result = commit(callbacks, lctx, &head, name, NULL, 0);
+			for (unsigned int i = 0; i < rdcount; i++) {
+				ISC_LIST_UNLINK(rdatalist.rdata, &rdata[i],
+						link);
+				dns_rdata_reset(&rdata[i]);
+			}
+		}
+		lctx->havesigtimes = false;
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+	}
+
+	if (!done) {
+		INSIST(lctx->done != NULL && lctx->task != NULL);
+		result = DNS_R_CONTINUE;
+	} else if (result == ISC_R_SUCCESS && lctx->result != ISC_R_SUCCESS) {
+		result = lctx->result;
+	}
+
+	if (result == ISC_R_SUCCESS && callbacks->rawdata != NULL) {
+		(*callbacks->rawdata)(callbacks->zone, &lctx->header);
+	}
+
+cleanup:
+	lctx->havesigtimes = false;
+	if (rdata != NULL) {
+		isc_mem_put(mctx, rdata, rdata_size * sizeof(*rdata));
+	}
+	if (buf != NULL) {
+		isc_mem_put(mctx, buf, bufsize);
+	}
+	if (scratch != NULL) {
+		isc_mem_put(mctx, scratch, DNS_RDATA_MAXLENGTH);
+	}
+	if (result != ISC_R_SUCCESS && result != DNS_R_CONTINUE) {
+		(*callbacks->error)(callbacks, "dns_master_load: %s",
+				    isc_result_totext(result));
+	}
+
+	return (result);
+}
+
 static isc_result_t
 load_raw(dns_loadctx_t *lctx) {
 	isc_result_t result = ISC_R_SUCCESS;
@@ -2358,6 +2887,8 @@ load_raw(dns_loadctx_t *lctx) {
 	isc_buffer_t target, buf;
 	unsigned char *target_mem = NULL;
 	dns_decompress_t dctx;
+	bool cache;
+	uint32_t ttl_offset = 0;
 
 	callbacks = lctx->callbacks;
 	dctx = DNS_DECOMPRESS_NEVER;
@@ -2369,6 +2900,17 @@ load_raw(dns_loadctx_t *lctx) {
 		}
 	}
 
+	if (lctx->header.version == 2) {
+		return (load_rawslab(lctx));
+	}
+
+	cache = (lctx->header.flags & DNS_MASTERRAW_CACHE) != 0;
+	if ((lctx->options & DNS_MASTER_AGETTL) != 0 &&
+	    isc_serial_gt(lctx->now, lctx->header.dumptime))
+	{
+		ttl_offset = lctx->now - lctx->header.dumptime;
+	}
+
 	ISC_LIST_INIT(head);
 	ISC_LIST_INIT(dummy);
 
@@ -2397,6 +2939,7 @@ load_raw(dns_loadctx_t *lctx) {
 		uint32_t totallen;
 		size_t minlen, readlen;
 		bool sequential_read = false;
+		bool expired = false;
 
 		/* Read the data length */
 		isc_buffer_clear(&target);
@@ -2421,6 +2964,9 @@ load_raw(dns_loadctx_t *lctx) {
 		minlen = sizeof(totallen) + sizeof(uint16_t) +
 			 sizeof(uint16_t) + sizeof(uint16_t) +
 			 sizeof(uint32_t) + sizeof(uint32_t);
+		if (cache) {
+			minlen += sizeof(uint16_t) + sizeof(uint16_t);
+		}
 		if (totallen < minlen) {
 			result = ISC_R_RANGE;
 			goto cleanup;
@@ -2472,12 +3018,38 @@ load_raw(dns_loadctx_t *lctx) {
 			result = ISC_R_RANGE;
 			goto cleanup;
 		}
+		if (cache) {
+			uint16_t attributes;
+
+			lctx->trust = isc_buffer_getuint16(&target);
+			attributes = isc_buffer_getuint16(&target);
+			lctx->attributes = 0;
+			if ((attributes & DNS_MASTERRAW_ATTR_NEGATIVE) != 0) {
+				lctx->attributes |= DNS_RDATASETATTR_NEGATIVE;
+			}
+			if ((attributes & DNS_MASTERRAW_ATTR_NXDOMAIN) != 0) {
+				lctx->attributes |= DNS_RDATASETATTR_NXDOMAIN;
+			}
+			if ((attributes & DNS_MASTERRAW_ATTR_OPTOUT) != 0) {
+				lctx->attributes |= DNS_RDATASETATTR_OPTOUT;
+			}
+		}
 		INSIST(isc_buffer_consumedlength(&target) <= readlen);
 
-		/* Owner name: length followed by name */
-		result = read_and_check(sequential_read, &target,
-					sizeof(namelen), lctx->f, &totallen);
-		if (result != ISC_R_SUCCESS) {
+		/*
+		 * Age the TTL by the time since the file was dumped;
+		 * RRsets that have run out are read but not loaded.
+		 */
+		if (rdatalist.ttl <= ttl_offset && ttl_offset != 0) {
+			expired = true;
+		} else {
+			rdatalist.ttl -= ttl_offset;
+		}
+
+		/* Owner name: length followed by name */
+		result = read_and_check(sequential_read, &target,
+					sizeof(namelen), lctx->f, &totallen);
+		if (result != ISC_R_SUCCESS) {
 			goto cleanup;
 		}
 		namelen = isc_buffer_getuint16(&target);
@@ -2536,9 +3108,12 @@ load_raw(dns_loadctx_t *lctx) {
 				INSIST(i > 0); /* detect an infinite loop */
 
 				/* Partial Commit. */
-				ISC_LIST_APPEND(head, &rdatalist, link);
-				result = commit(callbacks, lctx, &head, name,
-						NULL, 0);
+				result = ISC_R_SUCCESS;
+				if (!expired) {
+					ISC_LIST_APPEND(head, &rdatalist, link);
+					result = commit(callbacks, lctx, &head,
+							name, NULL, 0);
+				}
 				for (j = 0; j < i; j++) {
 					ISC_LIST_UNLINK(rdatalist.rdata,
 							&rdata[j], link);
@@ -2572,6 +3147,24 @@ load_raw(dns_loadctx_t *lctx) {
 				goto cleanup;
 			}
 			isc_buffer_setactive(&target, (unsigned int)rdlen);
+			if ((lctx->attributes & DNS_RDATASETATTR_NEGATIVE) !=
+			    0)
+			{
+				isc_region_t r;
+
+				/*
+				 * Negative cache entries are stored in the
+				 * ncache's own encoding, not as wire format.
+				 */
+				isc_buffer_activeregion(&target, &r);
+				dns_rdata_fromregion(&rdata[i],
+						     rdatalist.rdclass,
+						     rdatalist.type, &r);
+				isc_buffer_forward(&target, rdlen);
+				ISC_LIST_APPEND(rdatalist.rdata, &rdata[i],
+						link);
+				continue;
+			}
 			/*
 			 * It is safe to have the source active region and
 			 * the target available region be the same if
@@ -2599,10 +3192,11 @@ load_raw(dns_loadctx_t *lctx) {
 			goto cleanup;
 		}
 
-		ISC_LIST_APPEND(head, &rdatalist, link);
-
 		/* Commit this RRset.  rdatalist will be unlinked. */
-		result = commit(callbacks, lctx, &head, name, NULL, 0);
+		if (!expired) {
+			ISC_LIST_APPEND(head, &rdatalist, link);
+			result = commit(callbacks, lctx, &head, name, NULL, 0);
+		}
 
 		for (i = 0; i < rdcount; i++) {
 			ISC_LIST_UNLINK(rdatalist.rdata, &rdata[i], link);
@@ -2665,6 +3259,12 @@ dns_master_loadfile(const char *master_file, dns_name_t *top,
 		goto cleanup;
 	}
 
+	if (format == dns_masterformat_text &&
+	    (options & DNS_MASTER_PARALLEL) != 0)
+	{
+		loadchunks_create(lctx, master_file);
+	}
+
 	result = (lctx->load)(lctx);
 	INSIST(result != DNS_R_CONTINUE);
 
@@ -2702,6 +3302,10 @@ dns_master_loadfileinc(const char *master_file, dns_name_t *top,
 		goto cleanup;
 	}
 
+	if (format == dns_masterformat_text) {
+		loadchunks_create(lctx, master_file);
+	}
+
 	result = task_send(lctx);
 	if (result == ISC_R_SUCCESS) {
 		dns_loadctx_attach(lctx, lctxp);
@@ -3017,34 +3621,97 @@ grow_rdata(int new_len, dns_rdata_t *oldlist, int old_len,
 	return (newlist);
 }
 
+/*
+ * Compute the re-signing time from the signature times recorded in a
+ * raw file: an RRset signed in the future is re-signed now.
+ */
 static uint32_t
-resign_fromlist(dns_rdatalist_t *this, dns_loadctx_t *lctx) {
-	dns_rdata_t *rdata;
-	dns_rdata_rrsig_t sig;
-	uint32_t when;
+resign_fromsigtimes(dns_loadctx_t *lctx) {
+	uint32_t when = lctx->sigexpire - lctx->resign;
 
-	rdata = ISC_LIST_HEAD(this->rdata);
-	INSIST(rdata != NULL);
-	(void)dns_rdata_tostruct(rdata, &sig, NULL);
-	if (isc_serial_gt(sig.timesigned, lctx->now)) {
+	if (isc_serial_gt(lctx->siginception, lctx->now) &&
+	    isc_serial_gt(when, lctx->now))
+	{
 		when = lctx->now;
-	} else {
-		when = sig.timeexpire - lctx->resign;
 	}
+	return (when);
+}
 
-	rdata = ISC_LIST_NEXT(rdata, link);
-	while (rdata != NULL) {
-		(void)dns_rdata_tostruct(rdata, &sig, NULL);
+static uint32_t
+resign_fromrdataset(dns_rdataset_t *rdataset, dns_loadctx_t *lctx) {
+	dns_rdata_rrsig_t sig;
+	isc_result_t result;
+	uint32_t when = 0;
+	bool first = true;
+
+	for (result = dns_rdataset_first(rdataset); result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(rdataset))
+	{
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+
+		dns_rdataset_current(rdataset, &rdata);
+		(void)dns_rdata_tostruct(&rdata, &sig, NULL);
 		if (isc_serial_gt(sig.timesigned, lctx->now)) {
 			when = lctx->now;
-		} else if (sig.timeexpire - lctx->resign < when) {
+		} else if (first || sig.timeexpire - lctx->resign < when) {
 			when = sig.timeexpire - lctx->resign;
 		}
-		rdata = ISC_LIST_NEXT(rdata, link);
+		first = false;
 	}
+	INSIST(!first);
 	return (when);
 }
 
+/*
+ * Add 'dataset' to the database, reporting any error.
+ */
+static isc_result_t
+add_rdataset(dns_rdatacallbacks_t *callbacks, dns_loadctx_t *lctx,
+	     dns_rdataset_t *dataset, dns_name_t *owner, const char *source,
+	     unsigned int line) {
+	isc_result_t result;
+	char namebuf[DNS_NAME_FORMATSIZE];
+	void (*error)(struct dns_rdatacallbacks *, const char *, ...);
+
+	error = callbacks->error;
+
+	dataset->trust = lctx->trust;
+	dataset->attributes |= lctx->attributes;
+	/*
+	 * If this is a secure dynamic zone set the re-signing time.
+	 */
+	if (dataset->type == dns_rdatatype_rrsig &&
+	    (lctx->options & DNS_MASTER_RESIGN) != 0)
+	{
+		dataset->attributes |= DNS_RDATASETATTR_RESIGN;
+		if (lctx->havesigtimes) {
+			dataset->resign = resign_fromsigtimes(lctx);
+		} else {
+			dataset->resign = resign_fromrdataset(dataset, lctx);
+		}
+	}
+	result = ((*callbacks->add)(callbacks->add_private, owner, dataset));
+	if (result == ISC_R_NOMEMORY) {
+		(*error)(callbacks, "dns_master_load: %s",
+			 isc_result_totext(result));
+	} else if (result != ISC_R_SUCCESS) {
+		dns_name_format(owner, namebuf, sizeof(namebuf));
+		if (source != NULL) {
+			(*error)(callbacks, "%s: %s:%lu: %s: %s",
+				 "dns_master_load", source, line, namebuf,
+				 isc_result_totext(result));
+		} else {
+			(*error)(callbacks, "%s: %s: %s", "dns_master_load",
+				 namebuf, isc_result_totext(result));
+		}
+	}
+	if (MANYERRS(lctx, result)) {
+		SETRESULT(lctx, result);
+		result = ISC_R_SUCCESS;
+	}
+	return (result);
+}
+
 /*
  * Convert each element from a rdatalist_t to rdataset then call commit.
  * Unlink each element as we go.
@@ -3057,48 +3724,21 @@ commit(dns_rdatacallbacks_t *callbacks, dns_loadctx_t *lctx,
 	dns_rdatalist_t *this;
 	dns_rdataset_t dataset;
 	isc_result_t result;
-	char namebuf[DNS_NAME_FORMATSIZE];
-	void (*error)(struct dns_rdatacallbacks *, const char *, ...);
 
 	this = ISC_LIST_HEAD(*head);
-	error = callbacks->error;
 
 	if (this == NULL) {
 		return (ISC_R_SUCCESS);
 	}
+	if (lctx->chunk != NULL) {
+		return (chunk_commit(lctx, head, owner, line));
+	}
 	do {
 		dns_rdataset_init(&dataset);
 		dns_rdatalist_tordataset(this, &dataset);
-		dataset.trust = dns_trust_ultimate;
-		/*
-		 * If this is a secure dynamic zone set the re-signing time.
-		 */
-		if (dataset.type == dns_rdatatype_rrsig &&
-		    (lctx->options & DNS_MASTER_RESIGN) != 0)
-		{
-			dataset.attributes |= DNS_RDATASETATTR_RESIGN;
-			dataset.resign = resign_fromlist(this, lctx);
-		}
-		result = ((*callbacks->add)(callbacks->add_private, owner,
-					    &dataset));
-		if (result == ISC_R_NOMEMORY) {
-			(*error)(callbacks, "dns_master_load: %s",
-				 isc_result_totext(result));
-		} else if (result != ISC_R_SUCCESS) {
-			dns_name_format(owner, namebuf, sizeof(namebuf));
-			if (source != NULL) {
-				(*error)(callbacks, "%s: %s:%lu: %s: %s",
-					 "dns_master_load", source, line,
-					 namebuf, isc_result_totext(result));
-			} else {
-				(*error)(callbacks, "%s: %s: %s",
-					 "dns_master_load", namebuf,
-					 isc_result_totext(result));
-			}
-		}
-		if (MANYERRS(lctx, result)) {
-			SETRESULT(lctx, result);
-		} else if (result != ISC_R_SUCCESS) {
+		result = add_rdataset(callbacks, lctx, &dataset, owner, source,
+				      line);
+		if (result != ISC_R_SUCCESS) {
 			return (result);
 		}
 		ISC_LIST_UNLINK(*head, this, link);
@@ -3145,6 +3785,1108 @@ is_glue(rdatalist_head_t *head, dns_name_t *owner) {
 	return (false);
 }
 
+/*
+ * Parallel loading of large text files.
+ *
+ * dns_master_loadfileinc() splits text files of at least 2 * CHUNKSIZ
+ * bytes into chunks of about CHUNKSIZ bytes, which are parsed by
+ * load_text() in worker threads.  The chunk boundaries are found by a
+ * pre-pass, itself run in a worker thread, which follows $ORIGIN and
+ * $TTL and puts each boundary at the start of a record with an explicit
+ * owner name.  Files using $INCLUDE, $DATE, or $GENERATE without a TTL
+ * are loaded serially, as those carry state the pre-pass cannot follow.
+ *
+ * The workers do not add anything to the database: commit() and the
+ * warning and error callbacks record what would have been done, and the
+ * recordings are replayed in file order on the loading task, so that the
+ * callbacks see exactly the calls made by the serial loader.  At the end
+ * of a chunk the worker checks that nothing would have been carried over
+ * into the next one: that the first owner name of the next chunk is
+ * neither one of the pending names nor their glue, and that $ORIGIN and
+ * $TTL are what the pre-pass expected.  When this does not hold, or when
+ * the chunk cannot be parsed, it is joined to the next one and parsed
+ * again.
+ */
+
+typedef enum {
+	chunkevent_commit,
+	chunkevent_warn,
+	chunkevent_error
+} chunkevent_type_t;
+
+typedef struct chunkevent chunkevent_t;
+struct chunkevent {
+	chunkevent_type_t type;
+	unsigned int warnonce; /*%< CHUNK_WARN* flag, if any */
+	unsigned int line;
+	dns_name_t owner;
+	rdatalist_head_t head;
+	char *text;
+	ISC_LINK(chunkevent_t) link;
+};
+
+typedef struct chunkmem chunkmem_t;
+struct chunkmem {
+	chunkmem_t *next;
+	size_t size;
+	size_t used;
+	max_align_t data[];
+};
+
+typedef enum { chunk_idle, chunk_running, chunk_done } chunk_state_t;
+
+struct chunk {
+	dns_loadctx_t *lctx;
+	chunk_state_t state;
+	bool dropped; /*%< joined to the previous chunk while running */
+	bool last;
+	off_t offset;
+	size_t length;
+	unsigned long line;
+
+	/* State at the start of the chunk */
+	dns_fixedname_t forigin;
+	dns_name_t *origin;
+	bool default_ttl_known;
+	uint32_t default_ttl;
+
+	/* State expected at the start of the next chunk */
+	dns_fixedname_t fnextowner;
+	dns_name_t *nextowner;
+	dns_fixedname_t fnextorigin;
+	dns_name_t *nextorigin;
+	bool next_default_ttl_known;
+	uint32_t next_default_ttl;
+
+	/* What the worker found */
+	dns_rdatacallbacks_t callbacks;
+	isc_result_t result;
+	isc_result_t softresult;
+	bool safe;
+	chunkmem_t *mem;
+	ISC_LIST(chunkevent_t) events;
+
+	/* Replay */
+	bool replaying;
+	chunkevent_t *cursor;
+
+	ISC_LINK(chunk_t) link;
+};
+
+struct loadchunks {
+	char *file;
+	isc_loop_t *loop;
+	ISC_LIST(chunk_t) chunks;
+	unsigned int outstanding; /*%< chunks parsed or being parsed */
+	unsigned int maxoutstanding;
+	bool started;
+	bool waiting; /*%< for a worker to send an event */
+	bool finished;
+	isc_result_t result; /*%< of the pre-pass */
+};
+
+typedef struct chunksplit {
+	dns_loadctx_t *lctx;
+	chunk_t *chunk;
+	dns_fixedname_t forigin;
+	dns_name_t *origin;
+	bool origin_known;
+	bool default_ttl_known;
+	uint32_t default_ttl;
+	bool ns; /*%< the current owner may have NS records */
+	char owner[CHUNKPEEK];
+	size_t ownerlen;
+} chunksplit_t;
+
+static void
+chunks_fill(dns_loadctx_t *lctx);
+
+static chunk_t *
+chunk_new(dns_loadctx_t *lctx, off_t offset, unsigned long line,
+	  dns_name_t *origin, bool default_ttl_known, uint32_t default_ttl) {
+	chunk_t *chunk = isc_mem_get(lctx->mctx, sizeof(*chunk));
+
+	*chunk = (chunk_t){
+		.lctx = lctx,
+		.state = chunk_idle,
+		.offset = offset,
+		.line = line,
+		.default_ttl_known = default_ttl_known,
+		.default_ttl = default_ttl,
+		.result = ISC_R_SUCCESS,
+		.softresult = ISC_R_SUCCESS,
+	};
+	chunk->origin = dns_fixedname_initname(&chunk->forigin);
+	chunk->nextowner = dns_fixedname_initname(&chunk->fnextowner);
+	chunk->nextorigin = dns_fixedname_initname(&chunk->fnextorigin);
+	dns_name_copy(origin, chunk->origin);
+	ISC_LIST_INIT(chunk->events);
+	ISC_LINK_INIT(chunk, link);
+
+	return (chunk);
+}
+
+static void
+chunk_reset(dns_loadctx_t *lctx, chunk_t *chunk) {
+	chunkmem_t *mem = NULL;
+
+	while ((mem = chunk->mem) != NULL) {
+		chunk->mem = mem->next;
+		isc_mem_put(lctx->mctx, mem, sizeof(*mem) + mem->size);
+	}
+	ISC_LIST_INIT(chunk->events);
+	chunk->result = ISC_R_SUCCESS;
+	chunk->softresult = ISC_R_SUCCESS;
+	chunk->safe = false;
+	chunk->replaying = false;
+	chunk->cursor = NULL;
+}
+
+static void
+chunk_free(dns_loadctx_t *lctx, chunk_t *chunk) {
+	chunk_reset(lctx, chunk);
+	isc_mem_put(lctx->mctx, chunk, sizeof(*chunk));
+}
+
+static void *
+chunk_alloc(chunk_t *chunk, size_t size) {
+	chunkmem_t *mem = chunk->mem;
+	void *p = NULL;
+
+	size = ISC_ALIGN(size, sizeof(max_align_t));
+	if (mem == NULL || mem->size - mem->used < size) {
+		size_t msize = ISC_MAX(size, CHUNKMEMSIZ);
+
+		mem = isc_mem_get(chunk->lctx->mctx, sizeof(*mem) + msize);
+		mem->next = chunk->mem;
+		mem->size = msize;
+		mem->used = 0;
+		chunk->mem = mem;
+	}
+	p = (unsigned char *)mem->data + mem->used;
+	mem->used += size;
+
+	return (p);
+}
+
+static void *
+chunk_copy(chunk_t *chunk, const void *data, size_t size) {
+	void *p = chunk_alloc(chunk, size);
+
+	if (size > 0) {
+		memmove(p, data, size);
+	}
+	return (p);
+}
+
+static chunkevent_t *
+chunk_event(chunk_t *chunk, chunkevent_type_t type) {
+	chunkevent_t *ev = chunk_alloc(chunk, sizeof(*ev));
+
+	*ev = (chunkevent_t){ .type = type };
+	ISC_LIST_INIT(ev->head);
+	ISC_LINK_INIT(ev, link);
+	ISC_LIST_APPEND(chunk->events, ev, link);
+
+	return (ev);
+}
+
+/*
+ * Record the RRsets in 'head', which commit() would have added, and
+ * unlink them.
+ */
+static isc_result_t
+chunk_commit(dns_loadctx_t *lctx, rdatalist_head_t *head, dns_name_t *owner,
+	     unsigned int line) {
+	chunk_t *chunk = lctx->chunk;
+	chunkevent_t *ev = chunk_event(chunk, chunkevent_commit);
+	dns_rdatalist_t *this = NULL;
+	isc_region_t r;
+
+	ev->line = line;
+	dns_name_toregion(owner, &r);
+	r.base = chunk_copy(chunk, r.base, r.length);
+	dns_name_init(&ev->owner, NULL);
+	dns_name_fromregion(&ev->owner, &r);
+
+	while ((this = ISC_LIST_HEAD(*head)) != NULL) {
+		dns_rdatalist_t *copy = chunk_alloc(chunk, sizeof(*copy));
+		dns_rdata_t *rdata = NULL;
+
+		dns_rdatalist_init(copy);
+		copy->rdclass = this->rdclass;
+		copy->type = this->type;
+		copy->covers = this->covers;
+		copy->ttl = this->ttl;
+		for (rdata = ISC_LIST_HEAD(this->rdata); rdata != NULL;
+		     rdata = ISC_LIST_NEXT(rdata, link))
+		{
+			dns_rdata_t *rcopy = chunk_alloc(chunk, sizeof(*rcopy));
+
+			dns_rdata_init(rcopy);
+			dns_rdata_toregion(rdata, &r);
+			r.base = chunk_copy(chunk, r.base, r.length);
+			dns_rdata_fromregion(rcopy, rdata->rdclass, rdata->type,
+					     &r);
+			rcopy->flags = rdata->flags;
+			ISC_LIST_APPEND(copy->rdata, rcopy, link);
+		}
+		ISC_LIST_APPEND(ev->head, copy, link);
+		ISC_LIST_UNLINK(*head, this, link);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+chunk_message(dns_rdatacallbacks_t *callbacks, chunkevent_type_t type,
+	      const char *fmt, va_list ap) {
+	chunk_t *chunk = callbacks->error_private;
+	chunkevent_t *ev = NULL;
+	char buf[CHUNKMSGSIZ];
+
+	vsnprintf(buf, sizeof(buf), fmt, ap);
+	ev = chunk_event(chunk, type);
+	ev->text = chunk_copy(chunk, buf, strlen(buf) + 1);
+}
+
+static void
+chunk_error(dns_rdatacallbacks_t *callbacks, const char *fmt, ...)
+	ISC_FORMAT_PRINTF(2, 3);
+
+static void
+chunk_error(dns_rdatacallbacks_t *callbacks, const char *fmt, ...) {
+	va_list ap;
+
+	va_start(ap, fmt);
+	chunk_message(callbacks, chunkevent_error, fmt, ap);
+	va_end(ap);
+}
+
+static void
+chunk_warn(dns_rdatacallbacks_t *callbacks, const char *fmt, ...)
+	ISC_FORMAT_PRINTF(2, 3);
+
+static void
+chunk_warn(dns_rdatacallbacks_t *callbacks, const char *fmt, ...) {
+	va_list ap;
+
+	va_start(ap, fmt);
+	chunk_message(callbacks, chunkevent_warn, fmt, ap);
+	va_end(ap);
+}
+
+static isc_result_t
+chunk_add(void *arg, const dns_name_t *owner, dns_rdataset_t *dataset) {
+	UNUSED(arg);
+	UNUSED(owner);
+	UNUSED(dataset);
+
+	/* commit() records the RRsets instead */
+	UNREACHABLE();
+}
+
+/*
+ * Mark the warning just recorded as one given only once per file.
+ */
+static void
+chunk_warnonce(dns_loadctx_t *lctx, unsigned int warn) {
+	chunkevent_t *ev = NULL;
+
+	if (lctx->chunk == NULL) {
+		return;
+	}
+
+	ev = ISC_LIST_TAIL(lctx->chunk->events);
+	INSIST(ev != NULL && ev->type == chunkevent_warn);
+	ev->warnonce = warn;
+}
+
+/*
+ * Called by load_text() at the end of a chunk, before committing the
+ * pending RRsets.
+ */
+static void
+chunk_finish(dns_loadctx_t *lctx, rdatalist_head_t *current_list,
+	     rdatalist_head_t *glue_list, bool delegation, const char *source) {
+	chunk_t *chunk = lctx->chunk;
+	dns_incctx_t *ictx = lctx->inc;
+
+	if (chunk->last) {
+		return;
+	}
+
+	chunk->safe =
+		ictx->parent == NULL && ictx->current != NULL &&
+		!dns_name_caseequal(ictx->current, chunk->nextowner) &&
+		(ictx->glue == NULL ||
+		 !dns_name_caseequal(ictx->glue, chunk->nextowner)) &&
+		!(delegation && is_glue(current_list, chunk->nextowner)) &&
+		dns_name_caseequal(ictx->origin, chunk->nextorigin) &&
+		lctx->default_ttl_known == chunk->next_default_ttl_known &&
+		lctx->default_ttl == chunk->next_default_ttl;
+
+	/*
+	 * The first owner name of the next chunk commits the glue before
+	 * the current name.
+	 */
+	if (chunk->safe) {
+		(void)commit(lctx->callbacks, lctx, glue_list, ictx->glue,
+			     source, ictx->glue_line);
+	}
+}
+
+/*
+ * Parse a chunk in a worker thread.
+ */
+static void
+chunk_parse(void *arg) {
+	chunk_t *chunk = arg;
+	dns_loadctx_t *lctx = chunk->lctx;
+	dns_loadctx_t *child = NULL;
+	unsigned char *text = NULL;
+	isc_buffer_t buffer;
+	FILE *f = NULL;
+	isc_result_t result;
+
+	dns_rdatacallbacks_init(&chunk->callbacks);
+	chunk->callbacks.add = chunk_add;
+	chunk->callbacks.error = chunk_error;
+	chunk->callbacks.warn = chunk_warn;
+	chunk->callbacks.error_private = chunk;
+	chunk->callbacks.warn_private = chunk;
+
+	text = isc_mem_get(lctx->mctx, chunk->length);
+	result = isc_stdio_open(lctx->chunks->file, "r", &f);
+	if (result == ISC_R_SUCCESS) {
+		result = isc_stdio_seek(f, chunk->offset, SEEK_SET);
+	}
+	if (result == ISC_R_SUCCESS) {
+		result = isc_stdio_read(text, 1, chunk->length, f, NULL);
+	}
+	if (f != NULL) {
+		(void)isc_stdio_close(f);
+	}
+	if (result != ISC_R_SUCCESS) {
+		chunk_error(&chunk->callbacks, "dns_master_load: %s: %s",
+			    lctx->chunks->file, isc_result_totext(result));
+		goto cleanup;
+	}
+
+	result = loadctx_create(dns_masterformat_text, lctx->mctx,
+				lctx->options, lctx->resign, lctx->top,
+				lctx->zclass, chunk->origin, &chunk->callbacks,
+				NULL, NULL, NULL, NULL, NULL, NULL, &child);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	child->maxttl = lctx->maxttl;
+	child->now = lctx->now;
+	child->ttl_known = chunk->default_ttl_known;
+	child->ttl = chunk->default_ttl;
+	child->default_ttl_known = chunk->default_ttl_known;
+	child->default_ttl = chunk->default_ttl;
+	child->chunk = chunk;
+
+	isc_buffer_init(&buffer, text, (unsigned int)chunk->length);
+	isc_buffer_add(&buffer, (unsigned int)chunk->length);
+	result = isc_lex_openbuffer(child->lex, &buffer);
+	if (result == ISC_R_SUCCESS) {
+		result = isc_lex_setsourcename(child->lex, lctx->chunks->file);
+	}
+	if (result == ISC_R_SUCCESS) {
+		result = isc_lex_setsourceline(child->lex, chunk->line);
+	}
+	if (result == ISC_R_SUCCESS) {
+		result = load_text(child);
+		chunk->softresult = child->result;
+	}
+	dns_loadctx_detach(&child);
+
+cleanup:
+	chunk->result = result;
+	if (result != ISC_R_SUCCESS || chunk->softresult != ISC_R_SUCCESS) {
+		chunk->safe = false;
+	}
+	isc_mem_put(lctx->mctx, text, chunk->length);
+}
+
+static void
+chunk_parsed(void *arg) {
+	chunk_t *chunk = arg;
+	dns_loadctx_t *lctx = chunk->lctx;
+	loadchunks_t *chunks = lctx->chunks;
+
+	chunk->state = chunk_done;
+	if (chunk->dropped) {
+		chunks->outstanding--;
+		chunk_free(lctx, chunk);
+		chunks_fill(lctx);
+	} else if (chunks->waiting && ISC_LIST_HEAD(chunks->chunks) == chunk) {
+		chunks->waiting = false;
+		(void)task_send(lctx);
+	}
+
+	dns_loadctx_detach(&lctx);
+}
+
+/*
+ * Start parsing the chunks following the one being replayed.
+ */
+static void
+chunks_fill(dns_loadctx_t *lctx) {
+	loadchunks_t *chunks = lctx->chunks;
+	chunk_t *chunk = NULL;
+
+	if (chunks->loop == NULL) {
+		/* load_chunks_sync() parses the chunks itself */
+		return;
+	}
+
+	for (chunk = ISC_LIST_HEAD(chunks->chunks);
+	     chunk != NULL && !chunks->finished &&
+	     chunks->outstanding < chunks->maxoutstanding;
+	     chunk = ISC_LIST_NEXT(chunk, link))
+	{
+		if (chunk->state != chunk_idle) {
+			continue;
+		}
+		chunk->state = chunk_running;
+		chunks->outstanding++;
+		isc_refcount_increment(&lctx->references);
+		isc_work_enqueue(chunks->loop, chunk_parse, chunk_parsed,
+				 chunk);
+	}
+}
+
+/*
+ * Join 'chunk' and the next one, which the serial loader would have
+ * carried state over to, and parse them again.
+ */
+static isc_result_t
+chunks_join(dns_loadctx_t *lctx, chunk_t *chunk) {
+	loadchunks_t *chunks = lctx->chunks;
+	chunk_t *next = ISC_LIST_NEXT(chunk, link);
+
+	INSIST(next != NULL);
+
+	if (chunk->length + next->length > UINT_MAX) {
+		(*lctx->callbacks->error)(lctx->callbacks,
+					  "dns_master_load: %s: %s",
+					  chunks->file,
+					  isc_result_totext(ISC_R_RANGE));
+		return (ISC_R_RANGE);
+	}
+
+	ISC_LIST_UNLINK(chunks->chunks, next, link);
+	chunk->length += next->length;
+	chunk->last = next->last;
+	if (!next->last) {
+		dns_name_copy(next->nextowner, chunk->nextowner);
+		dns_name_copy(next->nextorigin, chunk->nextorigin);
+		chunk->next_default_ttl_known = next->next_default_ttl_known;
+		chunk->next_default_ttl = next->next_default_ttl;
+	}
+
+	switch (next->state) {
+	case chunk_running:
+		next->dropped = true;
+		break;
+	case chunk_done:
+		chunks->outstanding--;
+		chunk_free(lctx, next);
+		break;
+	case chunk_idle:
+		chunk_free(lctx, next);
+		break;
+	}
+
+	chunk_reset(lctx, chunk);
+	chunk->state = chunk_idle;
+	chunks->outstanding--;
+	chunks_fill(lctx);
+
+	return (ISC_R_SUCCESS);
+}
+
+static bool
+warnonce(dns_loadctx_t *lctx, unsigned int warn) {
+	bool *flag = NULL;
+
+	switch (warn) {
+	case CHUNK_WARN1035:
+		flag = &lctx->warn_1035;
+		break;
+	case CHUNK_WARNTCR:
+		flag = &lctx->warn_tcr;
+		break;
+	case CHUNK_WARNSIGEXPIRED:
+		flag = &lctx->warn_sigexpired;
+		break;
+	default:
+		UNREACHABLE();
+	}
+
+	if (!*flag) {
+		return (false);
+	}
+	*flag = false;
+	return (true);
+}
+
+static isc_result_t
+chunk_replay(dns_loadctx_t *lctx, chunkevent_t *ev) {
+	dns_rdatacallbacks_t *callbacks = lctx->callbacks;
+
+	switch (ev->type) {
+	case chunkevent_commit:
+		return (commit(callbacks, lctx, &ev->head, &ev->owner,
+			       lctx->chunks->file, ev->line));
+	case chunkevent_warn:
+		if (ev->warnonce == 0 || warnonce(lctx, ev->warnonce)) {
+			(*callbacks->warn)(callbacks, "%s", ev->text);
+		}
+		break;
+	case chunkevent_error:
+		(*callbacks->error)(callbacks, "%s", ev->text);
+		break;
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Find the next token of a line looked at by the pre-pass, failing if
+ * there is none or if it is not a plain string.
+ */
+static bool
+split_token(const unsigned char **pp, const unsigned char *end,
+	    isc_textregion_t *token) {
+	const unsigned char *p = *pp;
+
+	while (p < end && (*p == ' ' || *p == '\t')) {
+		p++;
+	}
+	token->base = (char *)p;
+	while (p < end && strchr(" \t\r\n()\";\\", *p) == NULL) {
+		p++;
+	}
+	token->length = (unsigned int)(p - (const unsigned char *)token->base);
+	*pp = p;
+
+	return (token->length > 0 && p < end && strchr(" \t\r\n", *p) != NULL);
+}
+
+static bool
+split_match(const isc_textregion_t *token, const char *str) {
+	return (token->length == strlen(str) &&
+		strncasecmp(token->base, str, token->length) == 0);
+}
+
+/*
+ * Whether the rest of a record, after its owner name, may be an NS
+ * record.
+ */
+static bool
+split_maybens(const unsigned char *p, const unsigned char *end) {
+	isc_textregion_t token;
+	dns_rdataclass_t rdclass;
+	uint32_t ttl;
+
+	for (int i = 0; i < 3; i++) {
+		if (!split_token(&p, end, &token)) {
+			return (true);
+		}
+		if (dns_ttl_fromtext(&token, &ttl) != ISC_R_SUCCESS &&
+		    dns_rdataclass_fromtext(&rdclass, &token) != ISC_R_SUCCESS)
+		{
+			return (split_match(&token, "NS"));
+		}
+	}
+
+	return (true);
+}
+
+static void
+split_at(chunksplit_t *split, dns_name_t *owner, off_t offset,
+	 unsigned long line) {
+	dns_loadctx_t *lctx = split->lctx;
+	chunk_t *prev = split->chunk;
+	chunk_t *next = NULL;
+
+	next = chunk_new(lctx, offset, line, split->origin,
+			 split->default_ttl_known, split->default_ttl);
+	prev->length = offset - prev->offset;
+	dns_name_copy(owner, prev->nextowner);
+	dns_name_copy(split->origin, prev->nextorigin);
+	prev->next_default_ttl_known = split->default_ttl_known;
+	prev->next_default_ttl = split->default_ttl;
+
+	ISC_LIST_APPEND(lctx->chunks->chunks, next, link);
+	split->chunk = next;
+}
+
+/*
+ * Look at the start of a line, which begins a new record if 'start' is
+ * true, and split the file there if it can be.
+ */
+static isc_result_t
+split_line(chunksplit_t *split, const unsigned char *text, size_t len,
+	   bool start, off_t offset, unsigned long line) {
+	const unsigned char *p = text, *end = text + len;
+	isc_textregion_t token;
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	isc_buffer_t b;
+	uint32_t ttl;
+
+	if (len == 0) {
+		return (ISC_R_SUCCESS);
+	}
+
+	if (text[0] == '$') {
+		(void)split_token(&p, end, &token);
+		if (split_match(&token, "$INCLUDE") ||
+		    split_match(&token, "$DATE"))
+		{
+			return (ISC_R_NOTIMPLEMENTED);
+		}
+		if (!start) {
+			return (ISC_R_SUCCESS);
+		}
+		if (split_match(&token, "$ORIGIN")) {
+			if (split_token(&p, end, &token) && split->origin_known)
+			{
+				isc_buffer_init(&b, token.base, token.length);
+				isc_buffer_add(&b, token.length);
+				if (dns_name_fromtext(name, &b, split->origin,
+						      0, NULL) == ISC_R_SUCCESS)
+				{
+					dns_name_copy(name, split->origin);
+					return (ISC_R_SUCCESS);
+				}
+			}
+			split->origin_known = false;
+		} else if (split_match(&token, "$TTL")) {
+			if (split_token(&p, end, &token) &&
+			    dns_ttl_fromtext(&token, &ttl) == ISC_R_SUCCESS)
+			{
+				split->default_ttl = (ttl > 0x7fffffffUL) ? 0
+									  : ttl;
+				split->default_ttl_known = true;
+				return (ISC_R_SUCCESS);
+			}
+			split->default_ttl_known = false;
+		} else if (split_match(&token, "$GENERATE")) {
+			/*
+			 * Without a TTL, the generated records use the TTL
+			 * of the record before them.
+			 */
+			if (!split_token(&p, end, &token) ||
+			    !split_token(&p, end, &token) ||
+			    !split_token(&p, end, &token) ||
+			    dns_ttl_fromtext(&token, &ttl) != ISC_R_SUCCESS)
+			{
+				return (ISC_R_NOTIMPLEMENTED);
+			}
+			split->ns = true;
+		}
+		return (ISC_R_SUCCESS);
+	}
+
+	if (!start || text[0] == ';' || text[0] == '\r' || text[0] == '\n') {
+		return (ISC_R_SUCCESS);
+	}
+
+	if (text[0] == ' ' || text[0] == '\t') {
+		if (!split->ns) {
+			split->ns = split_maybens(p, end);
+		}
+		return (ISC_R_SUCCESS);
+	}
+
+	if (!split_token(&p, end, &token)) {
+		split->ownerlen = 0;
+		split->ns = true;
+		return (ISC_R_SUCCESS);
+	}
+
+	if (split->ownerlen != token.length ||
+	    memcmp(split->owner, token.base, token.length) != 0)
+	{
+		if (offset - split->chunk->offset >= CHUNKSIZ && !split->ns &&
+		    split->origin_known && split->default_ttl_known)
+		{
+			isc_buffer_init(&b, token.base, token.length);
+			isc_buffer_add(&b, token.length);
+			if (dns_name_fromtext(name, &b, split->origin, 0,
+					      NULL) == ISC_R_SUCCESS)
+			{
+				split_at(split, name, offset, line);
+			}
+		}
+		memmove(split->owner, token.base, token.length);
+		split->ownerlen = token.length;
+		split->ns = false;
+	}
+	if (!split->ns) {
+		split->ns = split_maybens(p, end);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Find the chunk boundaries, following the lexer well enough to tell
+ * which lines begin a new record.
+ */
+static isc_result_t
+split_file(dns_loadctx_t *lctx) {
+	loadchunks_t *chunks = lctx->chunks;
+	chunksplit_t split = {
+		.lctx = lctx,
+		.origin_known = true,
+		.default_ttl_known = lctx->default_ttl_known,
+		.default_ttl = lctx->default_ttl,
+	};
+	unsigned char peek[CHUNKPEEK];
+	unsigned char *buf = NULL;
+	size_t peeklen = 0, n = 0;
+	off_t offset = 0, linestart = 0;
+	unsigned long line = 1;
+	unsigned int depth = 0;
+	bool start = true, quote = false, escape = false, comment = false;
+	FILE *f = NULL;
+	isc_result_t result;
+
+	split.origin = dns_fixedname_initname(&split.forigin);
+	dns_name_copy(lctx->inc->origin, split.origin);
+	split.chunk = chunk_new(lctx, 0, 1, split.origin,
+				split.default_ttl_known, split.default_ttl);
+	ISC_LIST_APPEND(chunks->chunks, split.chunk, link);
+
+	result = isc_stdio_open(chunks->file, "r", &f);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	buf = isc_mem_get(lctx->mctx, CHUNKMEMSIZ);
+	do {
+		result = isc_stdio_read(buf, 1, CHUNKMEMSIZ, f, &n);
+		if (result != ISC_R_SUCCESS && result != ISC_R_EOF) {
+			goto cleanup;
+		}
+		for (size_t i = 0; i < n; i++) {
+			unsigned char c = buf[i];
+
+			if (peeklen < sizeof(peek)) {
+				peek[peeklen++] = c;
+			}
+			if (c == '\n') {
+				result = split_line(&split, peek, peeklen,
+						    start, linestart, line);
+				if (result != ISC_R_SUCCESS) {
+					goto cleanup;
+				}
+				start = (depth == 0 && !quote && !escape);
+				quote = escape = comment = false;
+				linestart = offset + i + 1;
+				peeklen = 0;
+				line++;
+			} else if (comment) {
+				continue;
+			} else if (escape) {
+				escape = false;
+			} else if (c == '\\') {
+				escape = true;
+			} else if (quote) {
+				quote = (c != '"');
+			} else if (c == '"') {
+				quote = true;
+			} else if (c == '(') {
+				depth++;
+			} else if (c == ')' && depth > 0) {
+				depth--;
+			} else if (c == ';') {
+				comment = true;
+			}
+		}
+		offset += n;
+	} while (n == CHUNKMEMSIZ);
+
+	result = split_line(&split, peek, peeklen, start, linestart, line);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+	split.chunk->length = offset - split.chunk->offset;
+	split.chunk->last = true;
+
+	for (chunk_t *chunk = ISC_LIST_HEAD(chunks->chunks); chunk != NULL;
+	     chunk = ISC_LIST_NEXT(chunk, link))
+	{
+		if (chunk->length > UINT_MAX) {
+			result = ISC_R_RANGE;
+			goto cleanup;
+		}
+	}
+
+cleanup:
+	isc_mem_put(lctx->mctx, buf, CHUNKMEMSIZ);
+	(void)isc_stdio_close(f);
+	return (result);
+}
+
+static void
+chunks_split(void *arg) {
+	dns_loadctx_t *lctx = arg;
+
+	lctx->chunks->result = split_file(lctx);
+}
+
+/*
+ * If the pre-pass failed or found a single chunk, the file cannot be
+ * split: prepare to load it serially and return true.
+ */
+static bool
+chunks_unsplit(dns_loadctx_t *lctx) {
+	loadchunks_t *chunks = lctx->chunks;
+	chunk_t *chunk = NULL;
+
+	if (chunks->result == ISC_R_SUCCESS &&
+	    ISC_LIST_HEAD(chunks->chunks) != ISC_LIST_TAIL(chunks->chunks))
+	{
+		return (false);
+	}
+
+	while ((chunk = ISC_LIST_HEAD(chunks->chunks)) != NULL) {
+		ISC_LIST_UNLINK(chunks->chunks, chunk, link);
+		chunk_free(lctx, chunk);
+	}
+	lctx->load = load_text;
+	return (true);
+}
+
+static void
+chunks_splitdone(void *arg) {
+	dns_loadctx_t *lctx = arg;
+	loadchunks_t *chunks = lctx->chunks;
+
+	if (chunks_unsplit(lctx)) {
+		chunks->waiting = false;
+		(void)task_send(lctx);
+	} else {
+		chunks_fill(lctx);
+	}
+
+	dns_loadctx_detach(&lctx);
+}
+
+static isc_result_t
+load_chunks(dns_loadctx_t *lctx) {
+	loadchunks_t *chunks = lctx->chunks;
+	chunk_t *chunk = NULL;
+	unsigned int count = 0;
+	isc_result_t result;
+
+	REQUIRE(DNS_LCTX_VALID(lctx));
+
+	if (!chunks->started) {
+		chunks->started = true;
+		chunks->waiting = true;
+		chunks->loop =
+			isc_loop_current(isc_task_getloopmgr(lctx->task));
+		isc_refcount_increment(&lctx->references);
+		isc_work_enqueue(chunks->loop, chunks_split, chunks_splitdone,
+				 lctx);
+		return (DNS_R_WAIT);
+	}
+
+	while ((chunk = ISC_LIST_HEAD(chunks->chunks)) != NULL) {
+		if (chunk->state != chunk_done) {
+			chunks->waiting = true;
+			return (DNS_R_WAIT);
+		}
+
+		if (!chunk->replaying) {
+			if (!chunk->last && !chunk->safe) {
+				result = chunks_join(lctx, chunk);
+				if (result != ISC_R_SUCCESS) {
+					goto done;
+				}
+				continue;
+			}
+			chunk->replaying = true;
+			chunk->cursor = ISC_LIST_HEAD(chunk->events);
+		}
+
+		while (chunk->cursor != NULL) {
+			if (lctx->loop_cnt != 0 && count++ == lctx->loop_cnt) {
+				return (DNS_R_CONTINUE);
+			}
+			result = chunk_replay(lctx, chunk->cursor);
+			if (result != ISC_R_SUCCESS) {
+				goto done;
+			}
+			chunk->cursor = ISC_LIST_NEXT(chunk->cursor, link);
+		}
+
+		if (chunk->result != ISC_R_SUCCESS &&
+		    ((lctx->options & DNS_MASTER_MANYERRORS) == 0 ||
+		     chunk->result != chunk->softresult))
+		{
+			result = chunk->result;
+			goto done;
+		}
+		SETRESULT(lctx, chunk->softresult);
+
+		ISC_LIST_UNLINK(chunks->chunks, chunk, link);
+		chunks->outstanding--;
+		chunk_free(lctx, chunk);
+		chunks_fill(lctx);
+	}
+	result = lctx->result;
+
+done:
+	chunks->finished = true;
+	return (result);
+}
+
+typedef struct chunkwork {
+	chunk_t **chunks;
+	size_t count;
+	atomic_size_t next;
+} chunkwork_t;
+
+static isc_threadresult_t
+chunks_worker(isc_threadarg_t arg) {
+	chunkwork_t *work = arg;
+	size_t i;
+
+	while ((i = atomic_fetch_add_relaxed(&work->next, 1)) < work->count) {
+		chunk_parse(work->chunks[i]);
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+/*
+ * Without a task there is no loop to hand the chunks to: parse the
+ * idle ones among the next 'maxoutstanding' in threads of our own, and
+ * wait for them.
+ */
+static void
+chunks_parse(dns_loadctx_t *lctx) {
+	loadchunks_t *chunks = lctx->chunks;
+	chunkwork_t work = { .count = 0 };
+	isc_thread_t *threads = NULL;
+	unsigned int nthreads;
+	chunk_t *chunk = NULL;
+
+	work.chunks = isc_mem_get(lctx->mctx,
+				  chunks->maxoutstanding * sizeof(chunk_t *));
+	for (chunk = ISC_LIST_HEAD(chunks->chunks);
+	     chunk != NULL && chunks->outstanding < chunks->maxoutstanding;
+	     chunk = ISC_LIST_NEXT(chunk, link))
+	{
+		if (chunk->state != chunk_idle) {
+			continue;
+		}
+		chunk->state = chunk_running;
+		chunks->outstanding++;
+		work.chunks[work.count++] = chunk;
+	}
+	atomic_init(&work.next, 0);
+
+	nthreads = ISC_MIN(isc_os_ncpus(), work.count);
+	if (nthreads > 1) {
+		threads = isc_mem_get(lctx->mctx,
+				      (nthreads - 1) * sizeof(threads[0]));
+		for (unsigned int i = 0; i < nthreads - 1; i++) {
+			isc_thread_create(chunks_worker, &work, &threads[i]);
+		}
+	}
+	(void)chunks_worker(&work);
+	if (threads != NULL) {
+		for (unsigned int i = 0; i < nthreads - 1; i++) {
+			isc_thread_join(threads[i], NULL);
+		}
+		isc_mem_put(lctx->mctx, threads,
+			    (nthreads - 1) * sizeof(threads[0]));
+	}
+
+	for (size_t i = 0; i < work.count; i++) {
+		work.chunks[i]->state = chunk_done;
+	}
+	isc_mem_put(lctx->mctx, work.chunks,
+		    chunks->maxoutstanding * sizeof(chunk_t *));
+}
+
+/*
+ * The synchronous counterpart of load_chunks(), used by
+ * dns_master_loadfile() with DNS_MASTER_PARALLEL: the chunks are
+ * parsed in batches, and each batch is replayed before the next one
+ * is parsed.
+ */
+static isc_result_t
+load_chunks_sync(dns_loadctx_t *lctx) {
+	loadchunks_t *chunks = lctx->chunks;
+	isc_result_t result;
+
+	REQUIRE(DNS_LCTX_VALID(lctx));
+
+	chunks->started = true;
+	chunks->result = split_file(lctx);
+	if (chunks_unsplit(lctx)) {
+		return (load_text(lctx));
+	}
+
+	do {
+		chunks_parse(lctx);
+		result = load_chunks(lctx);
+	} while (result == DNS_R_WAIT);
+
+	return (result);
+}
+
+static void
+loadchunks_create(dns_loadctx_t *lctx, const char *master_file) {
+	loadchunks_t *chunks = NULL;
+	off_t size;
+
+	if (isc_os_ncpus() < 2 ||
+	    isc_file_getsize(master_file, &size) != ISC_R_SUCCESS ||
+	    size < 2 * CHUNKSIZ)
+	{
+		return;
+	}
+
+	chunks = isc_mem_get(lctx->mctx, sizeof(*chunks));
+	*chunks = (loadchunks_t){
+		.file = isc_mem_strdup(lctx->mctx, master_file),
+		.maxoutstanding = 2 * isc_os_ncpus(),
+		.result = ISC_R_SUCCESS,
+	};
+	ISC_LIST_INIT(chunks->chunks);
+
+	lctx->chunks = chunks;
+	lctx->load = (lctx->task != NULL) ? load_chunks : load_chunks_sync;
+}
+
+static void
+loadchunks_destroy(dns_loadctx_t *lctx) {
+	loadchunks_t *chunks = lctx->chunks;
+	chunk_t *chunk = NULL;
+
+	while ((chunk = ISC_LIST_HEAD(chunks->chunks)) != NULL) {
+		ISC_LIST_UNLINK(chunks->chunks, chunk, link);
+		chunk_free(lctx, chunk);
+	}
+	isc_mem_free(lctx->mctx, chunks->file);
+	isc_mem_put(lctx->mctx, chunks, sizeof(*chunks));
+	lctx->chunks = NULL;
+}
+
 static void
 load_quantum(isc_task_t *task, isc_event_t *event) {
 	isc_result_t result;
@@ -3162,6 +4904,12 @@ load_quantum(isc_task_t *task, isc_event_t *event) {
 	if (result == DNS_R_CONTINUE) {
 		event->ev_arg = lctx;
 		isc_task_send(task, &event);
+	} else if (result == DNS_R_WAIT) {
+		/*
+		 * The load is waiting for a worker thread, which will
+		 * send a new event when it is done.
+		 */
+		isc_event_free(&event);
 	} else {
 		(lctx->done)(lctx->done_arg, result);
 		isc_event_free(&event);
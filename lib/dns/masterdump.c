@@ -13,6 +13,7 @@
 
 /*! \file */
 
+#include <arpa/inet.h>
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -26,6 +27,7 @@
 #include <isc/print.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
+#include <isc/serial.h>
 #include <isc/stdio.h>
 #include <isc/string.h>
 #include <isc/task.h>
@@ -46,6 +48,8 @@
 #include <dns/rdataclass.h>
 #include <dns/rdataset.h>
 #include <dns/rdatasetiter.h>
+#include <dns/rdataslab.h>
+#include <dns/rdatastruct.h>
 #include <dns/rdatatype.h>
 #include <dns/time.h>
 #include <dns/ttl.h>
@@ -105,6 +109,7 @@ typedef struct dns_totext_ctx {
 	bool current_ttl_valid;
 	dns_ttl_t serve_stale_ttl;
 	dns_indent_t indent;
+	uint32_t rawflags; /* header flags of a raw dump */
 } dns_totext_ctx_t;
 
 const dns_master_style_t dns_master_style_keyzone = {
@@ -443,6 +448,7 @@ totext_ctx_init(const dns_master_style_t *style, const dns_indent_t *indentctx,
 	ctx->current_ttl_valid = false;
 	ctx->serve_stale_ttl = 0;
 	ctx->indent = *indentctx;
+	ctx->rawflags = 0;
 
 	return (ISC_R_SUCCESS);
 }
@@ -539,6 +545,52 @@ cleanup:
 	return (result);
 }
 
+/*
+ * A and AAAA records make up the bulk of a cache dump and their
+ * presentation format does not depend on the origin or the line
+ * layout, so they are converted directly rather than through the
+ * generic rdata type dispatch.  The styles that change how AAAA
+ * records are written (see totext_in_aaaa()) use the generic path.
+ */
+static bool
+address_fastpath(const dns_rdata_t *rdata, const dns_totext_ctx_t *ctx) {
+	if (rdata->rdclass != dns_rdataclass_in ||
+	    (rdata->flags & DNS_RDATA_UPDATE) != 0 ||
+	    (ctx->style.flags & (DNS_STYLEFLAG_UNKNOWNFORMAT |
+				 DNS_STYLEFLAG_EXPANDAAAA |
+				 DNS_STYLEFLAG_YAML)) != 0)
+	{
+		return (false);
+	}
+
+	switch (rdata->type) {
+	case dns_rdatatype_a:
+		return (rdata->length == 4);
+	case dns_rdatatype_aaaa:
+		return (rdata->length == 16);
+	default:
+		return (false);
+	}
+}
+
+static isc_result_t
+address_totext(const dns_rdata_t *rdata, isc_buffer_t *target) {
+	char tmpbuf[sizeof("ffff:ffff:ffff:ffff:ffff:ffff:255.255.255.255")];
+	int af = (rdata->type == dns_rdatatype_a) ? AF_INET : AF_INET6;
+	unsigned int length;
+
+	if (inet_ntop(af, rdata->data, tmpbuf, sizeof(tmpbuf)) == NULL) {
+		return (ISC_R_NOSPACE);
+	}
+	length = strlen(tmpbuf);
+	if (isc_buffer_availablelength(target) < length) {
+		return (ISC_R_NOSPACE);
+	}
+	isc_buffer_putmem(target, (unsigned char *)tmpbuf, length);
+
+	return (ISC_R_SUCCESS);
+}
+
 /*
  * Convert 'rdataset' to master file text format according to 'ctx',
  * storing the result in 'target'.  If 'owner_name' is NULL, it
@@ -742,12 +794,16 @@ rdataset_totext(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 
 			dns_rdataset_current(rdataset, &rdata);
 
-			RETERR(dns_rdata_tofmttext(
-				&rdata, ctx->origin, ctx->style.flags,
-				ctx->style.line_length -
-					ctx->style.rdata_column,
-				ctx->style.split_width, ctx->linebreak,
-				target));
+			if (address_fastpath(&rdata, ctx)) {
+				RETERR(address_totext(&rdata, target));
+			} else {
+				RETERR(dns_rdata_tofmttext(
+					&rdata, ctx->origin, ctx->style.flags,
+					ctx->style.line_length -
+						ctx->style.rdata_column,
+					ctx->style.split_width, ctx->linebreak,
+					target));
+			}
 
 			isc_buffer_availableregion(target, &r);
 			if (r.length < 1) {
@@ -1168,21 +1224,75 @@ again:
 	return (itresult);
 }
 
+/*
+ * Return the version of the raw format written with header 'flags'.
+ */
+static uint32_t
+raw_version(uint32_t flags) {
+	if ((flags & DNS_MASTERRAW_COMPAT) != 0) {
+		return (0);
+	}
+	if ((flags & (DNS_MASTERRAW_COMPAT1 | DNS_MASTERRAW_CACHE)) != 0) {
+		return (1);
+	}
+	return (DNS_RAWFORMAT_VERSION);
+}
+
+/*
+ * Find the earliest expiration and the latest inception time of the
+ * signatures in 'rdataset'.
+ */
+static void
+sigtimes(dns_rdataset_t *rdataset, uint32_t *expirep, uint32_t *inceptionp) {
+	isc_result_t result;
+	bool first = true;
+
+	*expirep = *inceptionp = 0;
+	for (result = dns_rdataset_first(rdataset); result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(rdataset))
+	{
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		dns_rdata_rrsig_t sig;
+
+		dns_rdataset_current(rdataset, &rdata);
+		(void)dns_rdata_tostruct(&rdata, &sig, NULL);
+		if (first || isc_serial_lt(sig.timeexpire, *expirep)) {
+			*expirep = sig.timeexpire;
+		}
+		if (first || isc_serial_gt(sig.timesigned, *inceptionp)) {
+			*inceptionp = sig.timesigned;
+		}
+		first = false;
+	}
+}
+
 /*
  * Dump given RRsets in the "raw" format.
  */
 static isc_result_t
 dump_rdataset_raw(isc_mem_t *mctx, const dns_name_t *name,
-		  dns_rdataset_t *rdataset, isc_buffer_t *buffer, FILE *f) {
+		  dns_rdataset_t *rdataset, dns_totext_ctx_t *ctx,
+		  isc_buffer_t *buffer, FILE *f) {
 	isc_result_t result;
 	uint32_t totallen;
 	uint16_t dlen;
 	isc_region_t r, r_hdr;
+	isc_region_t slab = { NULL, 0 };
 
 	REQUIRE(buffer->length > 0);
 	REQUIRE(DNS_RDATASET_VALID(rdataset));
 
 	rdataset->attributes |= DNS_RDATASETATTR_LOADORDER;
+
+	/*
+	 * Version 2 stores the records as the database does, in a slab.
+	 */
+	if (raw_version(ctx->rawflags) == 2) {
+		result = dns_rdataslab_fromrdataset(rdataset, mctx, &slab, 0);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
 restart:
 	totallen = 0;
 	result = dns_rdataset_first(rdataset);
@@ -1202,7 +1312,33 @@ restart:
 	isc_buffer_putuint16(buffer, rdataset->type);	 /* 16-bit type */
 	isc_buffer_putuint16(buffer, rdataset->covers);	 /* same as type */
 	isc_buffer_putuint32(buffer, rdataset->ttl);	 /* 32-bit TTL */
-	isc_buffer_putuint32(buffer, dns_rdataset_count(rdataset));
+	isc_buffer_putuint32(buffer, slab.base != NULL
+					     ? dns_rdataslab_count(slab.base, 0)
+					     : dns_rdataset_count(rdataset));
+	if ((ctx->rawflags & DNS_MASTERRAW_SIGTIMES) != 0 &&
+	    rdataset->type == dns_rdatatype_rrsig)
+	{
+		uint32_t expire, inception;
+
+		sigtimes(rdataset, &expire, &inception);
+		isc_buffer_putuint32(buffer, expire);
+		isc_buffer_putuint32(buffer, inception);
+	}
+	if ((ctx->rawflags & DNS_MASTERRAW_CACHE) != 0) {
+		uint16_t attributes = 0;
+
+		if ((rdataset->attributes & DNS_RDATASETATTR_NEGATIVE) != 0) {
+			attributes |= DNS_MASTERRAW_ATTR_NEGATIVE;
+		}
+		if ((rdataset->attributes & DNS_RDATASETATTR_NXDOMAIN) != 0) {
+			attributes |= DNS_MASTERRAW_ATTR_NXDOMAIN;
+		}
+		if ((rdataset->attributes & DNS_RDATASETATTR_OPTOUT) != 0) {
+			attributes |= DNS_MASTERRAW_ATTR_OPTOUT;
+		}
+		isc_buffer_putuint16(buffer, rdataset->trust);
+		isc_buffer_putuint16(buffer, attributes);
+	}
 	totallen = isc_buffer_usedlength(buffer);
 	INSIST(totallen <= sizeof(dns_masterrawrdataset_t));
 
@@ -1213,6 +1349,15 @@ restart:
 	isc_buffer_copyregion(buffer, &r);
 	totallen += sizeof(dlen) + r.length;
 
+	if (slab.base != NULL) {
+		if (slab.length > UINT32_MAX - totallen) {
+			result = ISC_R_RANGE;
+			goto cleanup;
+		}
+		totallen += slab.length;
+		goto write;
+	}
+
 	do {
 		dns_rdata_t rdata = DNS_RDATA_INIT;
 
@@ -1249,6 +1394,7 @@ restart:
 		return (result);
 	}
 
+write:
 	/*
 	 * Fill in the total length field.
 	 * XXX: this is a bit tricky.  Since we have already "used" the space
@@ -1264,14 +1410,21 @@ restart:
 	 * Write the buffer contents to the raw master file.
 	 */
 	result = isc_stdio_write(r.base, 1, (size_t)r.length, f, NULL);
+	if (result == ISC_R_SUCCESS && slab.base != NULL) {
+		result = isc_stdio_write(slab.base, 1, (size_t)slab.length, f,
+					 NULL);
+	}
 
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
 				 "raw master file write failed: %s",
 				 isc_result_totext(result));
-		return (result);
 	}
 
+cleanup:
+	if (slab.base != NULL) {
+		isc_mem_put(mctx, slab.base, slab.length);
+	}
 	return (result);
 }
 
@@ -1298,8 +1451,12 @@ dump_rdatasets_raw(isc_mem_t *mctx, const dns_name_t *owner_name,
 		    (ctx->style.flags & DNS_STYLEFLAG_NCACHE) == 0)
 		{
 			/* Omit negative cache entries */
+		} else if ((ctx->rawflags & DNS_MASTERRAW_CACHE) != 0 &&
+			   (ANCIENT(&rdataset) || STALE(&rdataset)))
+		{
+			/* Omit entries that can't be reloaded as current */
 		} else {
-			result = dump_rdataset_raw(mctx, name, &rdataset,
+			result = dump_rdataset_raw(mctx, name, &rdataset, ctx,
 						   buffer, f);
 		}
 		dns_rdataset_disassociate(&rdataset);
@@ -1594,7 +1751,23 @@ dumpctx_create(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 	if (dctx->do_date) {
 		(void)dns_db_getservestalettl(dctx->db,
 					      &dctx->tctx.serve_stale_ttl);
+		if (format == dns_masterformat_raw) {
+			dctx->header.flags |= DNS_MASTERRAW_CACHE;
+		}
+	}
+	if (format == dns_masterformat_raw &&
+	    raw_version(dctx->header.flags) == 2)
+	{
+#if DNS_RDATASET_FIXED
+		dctx->header.flags |= DNS_MASTERRAW_SLABFIXED;
+#else  /* if DNS_RDATASET_FIXED */
+		dctx->header.flags &= ~DNS_MASTERRAW_SLABFIXED;
+#endif /* if DNS_RDATASET_FIXED */
+		dctx->header.flags |= DNS_MASTERRAW_SIGTIMES;
+	} else {
+		dctx->header.flags &= ~DNS_MASTERRAW_SIGTIMES;
 	}
+	dctx->tctx.rawflags = dctx->header.flags;
 
 	if (dctx->format == dns_masterformat_text &&
 	    (dctx->tctx.style.flags & DNS_STYLEFLAG_REL_OWNER) != 0)
@@ -1671,16 +1844,13 @@ writeheader(dns_dumpctx_t *dctx) {
 		r.length = sizeof(rawheader);
 		isc_buffer_region(&buffer, &r);
 		now32 = dctx->now;
-		rawversion = 1;
-		if ((dctx->header.flags & DNS_MASTERRAW_COMPAT) != 0) {
-			rawversion = 0;
-		}
+		rawversion = raw_version(dctx->header.flags);
 
 		isc_buffer_putuint32(&buffer, dctx->format);
 		isc_buffer_putuint32(&buffer, rawversion);
 		isc_buffer_putuint32(&buffer, now32);
 
-		if (rawversion == 1) {
+		if (rawversion != 0) {
 			isc_buffer_putuint32(&buffer, dctx->header.flags);
 			isc_buffer_putuint32(&buffer,
 					     dctx->header.sourceserial);
@@ -1709,14 +1879,14 @@ dumptostream(dns_dumpctx_t *dctx) {
 	isc_result_t result = ISC_R_SUCCESS;
 	isc_buffer_t buffer;
 	char *bufmem;
-	dns_name_t *name;
-	dns_fixedname_t fixname;
+	dns_dbiteratorbatch_t *batch;
 
 	bufmem = isc_mem_get(dctx->mctx, initial_buffer_length);
 
 	isc_buffer_init(&buffer, bufmem, initial_buffer_length);
 
-	name = dns_fixedname_initname(&fixname);
+	batch = isc_mem_get(dctx->mctx, sizeof(*batch));
+	batch->count = 0;
 
 	CHECK(writeheader(dctx));
 
@@ -1726,49 +1896,56 @@ dumptostream(dns_dumpctx_t *dctx) {
 	}
 
 	while (result == ISC_R_SUCCESS) {
-		dns_rdatasetiter_t *rdsiter = NULL;
-		dns_dbnode_t *node = NULL;
+		isc_result_t more;
 
-		result = dns_dbiterator_current(dctx->dbiter, &node, name);
-		if (result != ISC_R_SUCCESS && result != DNS_R_NEWORIGIN) {
-			break;
-		}
-		if (result == DNS_R_NEWORIGIN) {
-			dns_name_t *origin =
-				dns_fixedname_name(&dctx->tctx.origin_fixname);
-			result = dns_dbiterator_origin(dctx->dbiter, origin);
-			RUNTIME_CHECK(result == ISC_R_SUCCESS);
-			if ((dctx->tctx.style.flags & DNS_STYLEFLAG_REL_DATA) !=
-			    0) {
-				dctx->tctx.origin = origin;
-			}
-			dctx->tctx.neworigin = origin;
+		/*
+		 * The iterator is left paused after each batch, so that
+		 * the database is not locked while the nodes are dumped.
+		 */
+		more = dns_dbiterator_currentbatch(dctx->dbiter, batch);
+		if (more != ISC_R_SUCCESS && more != ISC_R_NOMORE) {
+			result = more;
+			goto cleanup;
 		}
 
-		result = dns_dbiterator_pause(dctx->dbiter);
-		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		for (unsigned int i = 0; i < batch->count; i++) {
+			dns_rdatasetiter_t *rdsiter = NULL;
+			dns_name_t *name = dns_fixedname_name(&batch->names[i]);
+
+			if (batch->neworigin[i]) {
+				dns_name_t *origin = dns_fixedname_name(
+					&dctx->tctx.origin_fixname);
+				dns_name_copy(
+					dns_fixedname_name(&batch->origins[i]),
+					origin);
+				if ((dctx->tctx.style.flags &
+				     DNS_STYLEFLAG_REL_DATA) != 0)
+				{
+					dctx->tctx.origin = origin;
+				}
+				dctx->tctx.neworigin = origin;
+			}
 
-		result = dns_db_allrdatasets(dctx->db, node, dctx->version,
-					     dctx->now, &rdsiter);
-		if (result != ISC_R_SUCCESS) {
-			dns_db_detachnode(dctx->db, &node);
-			goto cleanup;
-		}
-		result = (dctx->dumpsets)(dctx->mctx, name, rdsiter,
-					  &dctx->tctx, &buffer, dctx->f);
-		dns_rdatasetiter_destroy(&rdsiter);
-		if (result != ISC_R_SUCCESS) {
-			dns_db_detachnode(dctx->db, &node);
-			goto cleanup;
+			CHECK(dns_db_allrdatasets(dctx->db, batch->nodes[i],
+						  dctx->version, dctx->now,
+						  &rdsiter));
+			result = (dctx->dumpsets)(dctx->mctx, name, rdsiter,
+						  &dctx->tctx, &buffer,
+						  dctx->f);
+			dns_rdatasetiter_destroy(&rdsiter);
+			CHECK(result);
+			dns_db_detachnode(dctx->db, &batch->nodes[i]);
 		}
-		dns_db_detachnode(dctx->db, &node);
-		result = dns_dbiterator_next(dctx->dbiter);
+		batch->count = 0;
+		result = more;
 	}
 
 	if (result == ISC_R_NOMORE) {
 		result = ISC_R_SUCCESS;
 	}
 cleanup:
+	dns_dbiterator_releasebatch(dctx->dbiter, batch);
+	isc_mem_put(dctx->mctx, batch, sizeof(*batch));
 	RUNTIME_CHECK(dns_dbiterator_pause(dctx->dbiter) == ISC_R_SUCCESS);
 	isc_mem_put(dctx->mctx, buffer.base, buffer.length);
 	return (result);
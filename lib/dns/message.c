@@ -110,13 +110,11 @@ hexdump(const char *msg, const char *msg2, void *base, size_t len) {
  * XXXMLG These should come from a config setting.
  */
 #define SCRATCHPAD_SIZE	   1232
-#define NAME_FILLCOUNT	   4
-#define NAME_FREEMAX	   8 * NAME_FILLCOUNT
-#define OFFSET_COUNT	   4
-#define RDATA_COUNT	   8
-#define RDATALIST_COUNT	   8
-#define RDATASET_FILLCOUNT 4
-#define RDATASET_FREEMAX   8 * RDATASET_FILLCOUNT
+#define NAME_COUNT	16
+#define OFFSET_COUNT	4
+#define RDATA_COUNT	8
+#define RDATALIST_COUNT 8
+#define RDATASET_COUNT	16
 
 /*%
  * Text representation of the different items, for message_totext
@@ -309,6 +307,79 @@ newrdata(dns_message_t *msg) {
 	return (rdata);
 }
 
+static void
+releasename(dns_message_t *msg, dns_name_t *name) {
+	INSIST(msg->tempnames > 0);
+	msg->tempnames--;
+	ISC_LIST_PREPEND(msg->freename, name, link);
+}
+
+static dns_name_t *
+newname(dns_message_t *msg) {
+	dns_msgblock_t *msgblock;
+	dns_fixedname_t *fn;
+	dns_name_t *name;
+
+	msg->tempnames++;
+
+	/*
+	 * 'name' is the first field in dns_fixedname_t, so the address
+	 * of a released name is the address of its fixedname.
+	 */
+	name = ISC_LIST_HEAD(msg->freename);
+	if (name != NULL) {
+		ISC_LIST_UNLINK(msg->freename, name, link);
+		fn = (dns_fixedname_t *)name;
+		goto out;
+	}
+
+	msgblock = ISC_LIST_TAIL(msg->names);
+	fn = msgblock_get(msgblock, dns_fixedname_t);
+	if (fn == NULL) {
+		msgblock = msgblock_allocate(msg->mctx, sizeof(dns_fixedname_t),
+					     NAME_COUNT);
+		ISC_LIST_APPEND(msg->names, msgblock, link);
+
+		fn = msgblock_get(msgblock, dns_fixedname_t);
+	}
+out:
+	return (dns_fixedname_initname(fn));
+}
+
+static void
+releaserdataset(dns_message_t *msg, dns_rdataset_t *rdataset) {
+	INSIST(msg->temprdatasets > 0);
+	msg->temprdatasets--;
+	ISC_LIST_PREPEND(msg->freerdataset, rdataset, link);
+}
+
+static dns_rdataset_t *
+newrdataset(dns_message_t *msg) {
+	dns_msgblock_t *msgblock;
+	dns_rdataset_t *rdataset;
+
+	msg->temprdatasets++;
+
+	rdataset = ISC_LIST_HEAD(msg->freerdataset);
+	if (rdataset != NULL) {
+		ISC_LIST_UNLINK(msg->freerdataset, rdataset, link);
+		goto out;
+	}
+
+	msgblock = ISC_LIST_TAIL(msg->rdatasets);
+	rdataset = msgblock_get(msgblock, dns_rdataset_t);
+	if (rdataset == NULL) {
+		msgblock = msgblock_allocate(msg->mctx, sizeof(dns_rdataset_t),
+					     RDATASET_COUNT);
+		ISC_LIST_APPEND(msg->rdatasets, msgblock, link);
+
+		rdataset = msgblock_get(msgblock, dns_rdataset_t);
+	}
+out:
+	dns_rdataset_init(rdataset);
+	return (rdataset);
+}
+
 static void
 releaserdatalist(dns_message_t *msg, dns_rdatalist_t *rdatalist) {
 	ISC_LIST_PREPEND(msg->freerdatalist, rdatalist, link);
@@ -428,6 +499,10 @@ msginit(dns_message_t *m) {
 	m->cc_bad = 0;
 	m->tkey = 0;
 	m->rdclass_set = 0;
+	m->lazy = 0;
+	m->lazystart = 0;
+	m->lazyoptions = 0;
+	m->lazyresult = ISC_R_SUCCESS;
 	m->querytsig = NULL;
 	m->indent.string = "\t";
 	m->indent.count = 0;
@@ -455,7 +530,7 @@ msgresetnames(dns_message_t *msg, unsigned int first_section) {
 
 				INSIST(dns_rdataset_isassociated(rds));
 				dns_rdataset_disassociate(rds);
-				isc_mempool_put(msg->rdspool, rds);
+				releaserdataset(msg, rds);
 				rds = next_rds;
 			}
 			dns_message_puttempname(msg, &name);
@@ -473,7 +548,7 @@ msgresetopt(dns_message_t *msg) {
 		}
 		INSIST(dns_rdataset_isassociated(msg->opt));
 		dns_rdataset_disassociate(msg->opt);
-		isc_mempool_put(msg->rdspool, msg->opt);
+		releaserdataset(msg, msg->opt);
 		msg->opt = NULL;
 		msg->cc_ok = 0;
 		msg->cc_bad = 0;
@@ -488,29 +563,28 @@ msgresetsigs(dns_message_t *msg, bool replying) {
 	}
 	if (msg->tsig != NULL) {
 		INSIST(dns_rdataset_isassociated(msg->tsig));
-		INSIST(msg->namepool != NULL);
 		if (replying) {
 			INSIST(msg->querytsig == NULL);
 			msg->querytsig = msg->tsig;
 		} else {
 			dns_rdataset_disassociate(msg->tsig);
-			isc_mempool_put(msg->rdspool, msg->tsig);
+			releaserdataset(msg, msg->tsig);
 			if (msg->querytsig != NULL) {
 				dns_rdataset_disassociate(msg->querytsig);
-				isc_mempool_put(msg->rdspool, msg->querytsig);
+				releaserdataset(msg, msg->querytsig);
 			}
 		}
 		dns_message_puttempname(msg, &msg->tsigname);
 		msg->tsig = NULL;
 	} else if (msg->querytsig != NULL && !replying) {
 		dns_rdataset_disassociate(msg->querytsig);
-		isc_mempool_put(msg->rdspool, msg->querytsig);
+		releaserdataset(msg, msg->querytsig);
 		msg->querytsig = NULL;
 	}
 	if (msg->sig0 != NULL) {
 		INSIST(dns_rdataset_isassociated(msg->sig0));
 		dns_rdataset_disassociate(msg->sig0);
-		isc_mempool_put(msg->rdspool, msg->sig0);
+		releaserdataset(msg, msg->sig0);
 		msg->sig0 = NULL;
 	}
 	if (msg->sig0name != NULL) {
@@ -526,13 +600,22 @@ static void
 msgreset(dns_message_t *msg, bool everything) {
 	dns_msgblock_t *msgblock, *next_msgblock;
 	isc_buffer_t *dynbuf, *next_dynbuf;
+	dns_name_t *name;
 	dns_rdata_t *rdata;
+	dns_rdataset_t *rdataset;
 	dns_rdatalist_t *rdatalist;
 
 	msgresetnames(msg, 0);
 	msgresetopt(msg);
 	msgresetsigs(msg, false);
 
+	/*
+	 * Every temporary name and rdataset must have been returned,
+	 * as the blocks holding them are about to be reused.
+	 */
+	INSIST(msg->tempnames == 0);
+	INSIST(msg->temprdatasets == 0);
+
 	/*
 	 * Clean up linked lists.
 	 */
@@ -542,11 +625,21 @@ msgreset(dns_message_t *msg, bool everything) {
 	 * The memory isn't lost since these are part of message blocks we
 	 * have allocated.
 	 */
+	name = ISC_LIST_HEAD(msg->freename);
+	while (name != NULL) {
+		ISC_LIST_UNLINK(msg->freename, name, link);
+		name = ISC_LIST_HEAD(msg->freename);
+	}
 	rdata = ISC_LIST_HEAD(msg->freerdata);
 	while (rdata != NULL) {
 		ISC_LIST_UNLINK(msg->freerdata, rdata, link);
 		rdata = ISC_LIST_HEAD(msg->freerdata);
 	}
+	rdataset = ISC_LIST_HEAD(msg->freerdataset);
+	while (rdataset != NULL) {
+		ISC_LIST_UNLINK(msg->freerdataset, rdataset, link);
+		rdataset = ISC_LIST_HEAD(msg->freerdataset);
+	}
 	rdatalist = ISC_LIST_HEAD(msg->freerdatalist);
 	while (rdatalist != NULL) {
 		ISC_LIST_UNLINK(msg->freerdatalist, rdatalist, link);
@@ -566,6 +659,18 @@ msgreset(dns_message_t *msg, bool everything) {
 		dynbuf = next_dynbuf;
 	}
 
+	msgblock = ISC_LIST_HEAD(msg->names);
+	if (!everything && msgblock != NULL) {
+		msgblock_reset(msgblock);
+		msgblock = ISC_LIST_NEXT(msgblock, link);
+	}
+	while (msgblock != NULL) {
+		next_msgblock = ISC_LIST_NEXT(msgblock, link);
+		ISC_LIST_UNLINK(msg->names, msgblock, link);
+		msgblock_free(msg->mctx, msgblock, sizeof(dns_fixedname_t));
+		msgblock = next_msgblock;
+	}
+
 	msgblock = ISC_LIST_HEAD(msg->rdatas);
 	if (!everything && msgblock != NULL) {
 		msgblock_reset(msgblock);
@@ -578,6 +683,18 @@ msgreset(dns_message_t *msg, bool everything) {
 		msgblock = next_msgblock;
 	}
 
+	msgblock = ISC_LIST_HEAD(msg->rdatasets);
+	if (!everything && msgblock != NULL) {
+		msgblock_reset(msgblock);
+		msgblock = ISC_LIST_NEXT(msgblock, link);
+	}
+	while (msgblock != NULL) {
+		next_msgblock = ISC_LIST_NEXT(msgblock, link);
+		ISC_LIST_UNLINK(msg->rdatasets, msgblock, link);
+		msgblock_free(msg->mctx, msgblock, sizeof(dns_rdataset_t));
+		msgblock = next_msgblock;
+	}
+
 	/*
 	 * rdatalists could be empty.
 	 */
@@ -658,8 +775,6 @@ msgreset(dns_message_t *msg, bool everything) {
 		msginit(msg);
 	}
 
-	ENSURE(isc_mempool_getallocated(msg->namepool) == 0);
-	ENSURE(isc_mempool_getallocated(msg->rdspool) == 0);
 }
 
 static unsigned int
@@ -725,22 +840,16 @@ dns_message_create(isc_mem_t *mctx, unsigned int intent, dns_message_t **msgp) {
 
 	ISC_LIST_INIT(m->scratchpad);
 	ISC_LIST_INIT(m->cleanup);
+	ISC_LIST_INIT(m->names);
 	ISC_LIST_INIT(m->rdatas);
+	ISC_LIST_INIT(m->rdatasets);
 	ISC_LIST_INIT(m->rdatalists);
 	ISC_LIST_INIT(m->offsets);
+	ISC_LIST_INIT(m->freename);
 	ISC_LIST_INIT(m->freerdata);
+	ISC_LIST_INIT(m->freerdataset);
 	ISC_LIST_INIT(m->freerdatalist);
 
-	isc_mempool_create(m->mctx, sizeof(dns_fixedname_t), &m->namepool);
-	isc_mempool_setfillcount(m->namepool, NAME_FILLCOUNT);
-	isc_mempool_setfreemax(m->namepool, NAME_FREEMAX);
-	isc_mempool_setname(m->namepool, "msg:names");
-
-	isc_mempool_create(m->mctx, sizeof(dns_rdataset_t), &m->rdspool);
-	isc_mempool_setfillcount(m->rdspool, RDATASET_FILLCOUNT);
-	isc_mempool_setfreemax(m->rdspool, RDATASET_FREEMAX);
-	isc_mempool_setname(m->rdspool, "msg:rdataset");
-
 	isc_buffer_allocate(mctx, &dynbuf, SCRATCHPAD_SIZE);
 	ISC_LIST_APPEND(m->scratchpad, dynbuf, link);
 
@@ -766,8 +875,6 @@ dns__message_destroy(dns_message_t *msg) {
 	REQUIRE(DNS_MESSAGE_VALID(msg));
 
 	msgreset(msg, true);
-	isc_mempool_destroy(&msg->namepool);
-	isc_mempool_destroy(&msg->rdspool);
 	isc_refcount_destroy(&msg->refcount);
 	msg->magic = 0;
 	isc_mem_putanddetach(&msg->mctx, msg, sizeof(dns_message_t));
@@ -862,7 +969,7 @@ dns_message_findtype(const dns_name_t *name, dns_rdatatype_t type,
  */
 static isc_result_t
 getname(dns_name_t *name, isc_buffer_t *source, dns_message_t *msg,
-	dns_decompress_t dctx) {
+	dns_decompress_t dctx, unsigned int options) {
 	isc_buffer_t *scratch;
 	isc_result_t result;
 	unsigned int tries;
@@ -875,7 +982,8 @@ getname(dns_name_t *name, isc_buffer_t *source, dns_message_t *msg,
 	 */
 	tries = 0;
 	while (tries < 2) {
-		result = dns_name_fromwire(name, source, dctx, 0, scratch);
+		result = dns_name_fromwire(name, source, dctx, options,
+					   scratch);
 
 		if (result == ISC_R_NOSPACE) {
 			tries++;
@@ -983,11 +1091,13 @@ getquestions(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t dctx,
 		free_name = true;
 
 		/*
-		 * Parse the name out of this packet.
+		 * Parse the name out of this packet.  The question name
+		 * is hashed repeatedly while the message is handled, so
+		 * keep its hash with it.
 		 */
 		isc_buffer_remainingregion(source, &r);
 		isc_buffer_setactive(source, r.length);
-		result = getname(name, source, msg, dctx);
+		result = getname(name, source, msg, dctx, DNS_NAME_CACHEHASH);
 		if (result != ISC_R_SUCCESS) {
 			goto cleanup;
 		}
@@ -1068,7 +1178,7 @@ getquestions(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t dctx,
 			result = ISC_R_NOMEMORY;
 			goto cleanup;
 		}
-		rdataset = isc_mempool_get(msg->rdspool);
+		rdataset = newrdataset(msg);
 
 		/*
 		 * Convert rdatalist to rdataset, and attach the latter to
@@ -1094,7 +1204,7 @@ getquestions(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t dctx,
 cleanup:
 	if (rdataset != NULL) {
 		INSIST(!dns_rdataset_isassociated(rdataset));
-		isc_mempool_put(msg->rdspool, rdataset);
+		releaserdataset(msg, rdataset);
 	}
 	if (free_name) {
 		dns_message_puttempname(msg, &name);
@@ -1212,7 +1322,7 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t dctx,
 		 */
 		isc_buffer_remainingregion(source, &r);
 		isc_buffer_setactive(source, r.length);
-		result = getname(name, source, msg, dctx);
+		result = getname(name, source, msg, dctx, 0);
 		if (result != ISC_R_SUCCESS) {
 			goto cleanup;
 		}
@@ -1498,7 +1608,7 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t dctx,
 		}
 
 		if (result == ISC_R_NOTFOUND) {
-			rdataset = isc_mempool_get(msg->rdspool);
+			rdataset = newrdataset(msg);
 			free_rdataset = true;
 
 			rdatalist = newrdatalist(msg);
@@ -1586,7 +1696,7 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t dctx,
 				dns_message_puttempname(msg, &name);
 			}
 			if (free_rdataset) {
-				isc_mempool_put(msg->rdspool, rdataset);
+				releaserdataset(msg, rdataset);
 			}
 			free_name = free_rdataset = false;
 		}
@@ -1618,12 +1728,133 @@ cleanup:
 		dns_message_puttempname(msg, &name);
 	}
 	if (free_rdataset) {
-		isc_mempool_put(msg->rdspool, rdataset);
+		releaserdataset(msg, rdataset);
 	}
 
 	return (result);
 }
 
+/*
+ * Step over the records of a section without parsing them, checking only
+ * that each record is complete.  DNS_R_CONTINUE is returned if the section
+ * holds a record that has to be parsed immediately.
+ */
+static isc_result_t
+skipsection(isc_buffer_t *source, dns_message_t *msg, dns_section_t sectionid) {
+	isc_region_t r;
+	unsigned int count, rdatalen, labellen;
+	dns_rdatatype_t rdtype, covers;
+	dns_rdataclass_t rdclass;
+
+	for (count = 0; count < msg->counts[sectionid]; count++) {
+		/*
+		 * Step over the owner name.
+		 */
+		do {
+			if (isc_buffer_remaininglength(source) < 1) {
+				return (ISC_R_UNEXPECTEDEND);
+			}
+			labellen = isc_buffer_getuint8(source);
+			if (labellen >= 192) {
+				if (isc_buffer_remaininglength(source) < 1) {
+					return (ISC_R_UNEXPECTEDEND);
+				}
+				isc_buffer_forward(source, 1);
+				break;
+			} else if (labellen >= 64) {
+				return (DNS_R_BADLABELTYPE);
+			}
+			if (isc_buffer_remaininglength(source) < labellen) {
+				return (ISC_R_UNEXPECTEDEND);
+			}
+			isc_buffer_forward(source, labellen);
+		} while (labellen != 0);
+
+		isc_buffer_remainingregion(source, &r);
+		if (r.length < 2 + 2 + 4 + 2) {
+			return (ISC_R_UNEXPECTEDEND);
+		}
+		rdtype = isc_buffer_getuint16(source);
+		rdclass = isc_buffer_getuint16(source);
+		isc_buffer_forward(source, 4);
+		rdatalen = isc_buffer_getuint16(source);
+		if (r.length - (2 + 2 + 4 + 2) < rdatalen) {
+			return (ISC_R_UNEXPECTEDEND);
+		}
+
+		/*
+		 * Meta records are checked against the section they
+		 * appear in when parsed, so leave them to getsection().
+		 */
+		if (rdtype == dns_rdatatype_opt ||
+		    rdtype == dns_rdatatype_tsig ||
+		    rdtype == dns_rdatatype_tkey)
+		{
+			return (DNS_R_CONTINUE);
+		}
+		if (rdtype == dns_rdatatype_sig) {
+			covers = 0;
+			if (rdatalen >= 2) {
+				isc_buffer_remainingregion(source, &r);
+				covers = (r.base[0] << 8) | r.base[1];
+			}
+			if (covers == 0) {
+				return (DNS_R_CONTINUE);
+			}
+		}
+
+		/*
+		 * Establish the class as getsection() would.
+		 */
+		if (msg->rdclass_set == 0) {
+			msg->rdclass = rdclass;
+			msg->rdclass_set = 1;
+		}
+
+		isc_buffer_forward(source, rdatalen);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Parse the answer and authority sections of a message whose parsing
+ * was deferred by DNS_MESSAGEPARSE_LAZY.
+ */
+static isc_result_t
+parselazy(dns_message_t *msg) {
+	isc_buffer_t source;
+	isc_result_t result;
+	bool ignore_tc;
+
+	if (!msg->lazy) {
+		return (msg->lazyresult);
+	}
+
+	msg->lazy = 0;
+	ignore_tc = ((msg->lazyoptions & DNS_MESSAGEPARSE_IGNORETRUNCATION) !=
+		     0);
+
+	isc_buffer_init(&source, msg->saved.base, msg->saved.length);
+	isc_buffer_add(&source, msg->saved.length);
+	isc_buffer_forward(&source, msg->lazystart);
+
+	result = getsection(&source, msg, DNS_DECOMPRESS_ALWAYS,
+			    DNS_SECTION_ANSWER, msg->lazyoptions);
+	if (result == ISC_R_SUCCESS || result == DNS_R_RECOVERABLE) {
+		result = getsection(&source, msg, DNS_DECOMPRESS_ALWAYS,
+				    DNS_SECTION_AUTHORITY, msg->lazyoptions);
+	}
+	if (result == DNS_R_RECOVERABLE ||
+	    (result == ISC_R_UNEXPECTEDEND && ignore_tc))
+	{
+		result = ISC_R_SUCCESS;
+	}
+
+	msg->lazyresult = result;
+	return (result);
+}
+
 isc_result_t
 dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
 		  unsigned int options) {
@@ -1691,28 +1922,56 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
 	}
 	msg->question_ok = 1;
 
-	ret = getsection(source, msg, dctx, DNS_SECTION_ANSWER, options);
-	if (ret == ISC_R_UNEXPECTEDEND && ignore_tc) {
-		goto truncated;
-	}
-	if (ret == DNS_R_RECOVERABLE) {
-		seen_problem = true;
-		ret = ISC_R_SUCCESS;
-	}
-	if (ret != ISC_R_SUCCESS) {
-		return (ret);
-	}
+	/*
+	 * When asked to, step over the answer and authority sections of
+	 * a query and leave them to be parsed on first access.  If they
+	 * are not well formed, or hold a record that needs to be seen
+	 * now, fall back to parsing them here so the errors are the same.
+	 */
+	if ((options & DNS_MESSAGEPARSE_LAZY) != 0 &&
+	    msg->opcode == dns_opcode_query)
+	{
+		unsigned int start = source->current;
 
-	ret = getsection(source, msg, dctx, DNS_SECTION_AUTHORITY, options);
-	if (ret == ISC_R_UNEXPECTEDEND && ignore_tc) {
-		goto truncated;
-	}
-	if (ret == DNS_R_RECOVERABLE) {
-		seen_problem = true;
-		ret = ISC_R_SUCCESS;
+		ret = skipsection(source, msg, DNS_SECTION_ANSWER);
+		if (ret == ISC_R_SUCCESS) {
+			ret = skipsection(source, msg, DNS_SECTION_AUTHORITY);
+		}
+		if (ret == ISC_R_SUCCESS) {
+			msg->lazy = 1;
+			msg->lazystart = start;
+			msg->lazyoptions = options;
+		} else {
+			source->current = start;
+		}
 	}
-	if (ret != ISC_R_SUCCESS) {
-		return (ret);
+
+	if (!msg->lazy) {
+		ret = getsection(source, msg, dctx, DNS_SECTION_ANSWER,
+				 options);
+		if (ret == ISC_R_UNEXPECTEDEND && ignore_tc) {
+			goto truncated;
+		}
+		if (ret == DNS_R_RECOVERABLE) {
+			seen_problem = true;
+			ret = ISC_R_SUCCESS;
+		}
+		if (ret != ISC_R_SUCCESS) {
+			return (ret);
+		}
+
+		ret = getsection(source, msg, dctx, DNS_SECTION_AUTHORITY,
+				 options);
+		if (ret == ISC_R_UNEXPECTEDEND && ignore_tc) {
+			goto truncated;
+		}
+		if (ret == DNS_R_RECOVERABLE) {
+			seen_problem = true;
+			ret = ISC_R_SUCCESS;
+		}
+		if (ret != ISC_R_SUCCESS) {
+			return (ret);
+		}
 	}
 
 	ret = getsection(source, msg, dctx, DNS_SECTION_ADDITIONAL, options);
@@ -2137,6 +2396,32 @@ dns_message_rendersection(dns_message_t *msg, dns_section_t sectionid,
 	return (ISC_R_SUCCESS);
 }
 
+isc_result_t
+dns_message_renderwire(dns_message_t *msg, const isc_region_t *wire,
+		       const unsigned int *counts) {
+	dns_section_t section;
+
+	REQUIRE(DNS_MESSAGE_VALID(msg));
+	REQUIRE(msg->buffer != NULL);
+	REQUIRE(isc_buffer_usedlength(msg->buffer) == DNS_MESSAGE_HEADERLEN);
+	REQUIRE(wire != NULL && counts != NULL);
+
+	if (isc_buffer_availablelength(msg->buffer) <
+	    wire->length + msg->reserved)
+	{
+		return (ISC_R_NOSPACE);
+	}
+
+	isc_buffer_putmem(msg->buffer, wire->base, wire->length);
+	for (section = DNS_SECTION_QUESTION; section < DNS_SECTION_MAX;
+	     section++)
+	{
+		msg->counts[section] = counts[section];
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
 void
 dns_message_renderheader(dns_message_t *msg, isc_buffer_t *target) {
 	uint16_t tmp;
@@ -2385,9 +2670,19 @@ dns_message_renderreset(dns_message_t *msg) {
 
 isc_result_t
 dns_message_firstname(dns_message_t *msg, dns_section_t section) {
+	isc_result_t result;
+
 	REQUIRE(DNS_MESSAGE_VALID(msg));
 	REQUIRE(VALID_NAMED_SECTION(section));
 
+	if (section == DNS_SECTION_ANSWER || section == DNS_SECTION_AUTHORITY) {
+		result = parselazy(msg);
+		if (result != ISC_R_SUCCESS) {
+			msg->cursors[section] = NULL;
+			return (result);
+		}
+	}
+
 	msg->cursors[section] = ISC_LIST_HEAD(msg->sections[section]);
 
 	if (msg->cursors[section] == NULL) {
@@ -2448,6 +2743,13 @@ dns_message_findname(dns_message_t *msg, dns_section_t section,
 		REQUIRE(rdataset == NULL || *rdataset == NULL);
 	}
 
+	if (section == DNS_SECTION_ANSWER || section == DNS_SECTION_AUTHORITY) {
+		result = parselazy(msg);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
+
 	result = findname(&foundname, target, &msg->sections[section]);
 
 	if (result == ISC_R_NOTFOUND) {
@@ -2515,13 +2817,10 @@ dns_message_removename(dns_message_t *msg, dns_name_t *name,
 
 void
 dns_message_gettempname(dns_message_t *msg, dns_name_t **item) {
-	dns_fixedname_t *fn = NULL;
-
 	REQUIRE(DNS_MESSAGE_VALID(msg));
 	REQUIRE(item != NULL && *item == NULL);
 
-	fn = isc_mempool_get(msg->namepool);
-	*item = dns_fixedname_initname(fn);
+	*item = newname(msg);
 }
 
 void
@@ -2537,8 +2836,7 @@ dns_message_gettemprdataset(dns_message_t *msg, dns_rdataset_t **item) {
 	REQUIRE(DNS_MESSAGE_VALID(msg));
 	REQUIRE(item != NULL && *item == NULL);
 
-	*item = isc_mempool_get(msg->rdspool);
-	dns_rdataset_init(*item);
+	*item = newrdataset(msg);
 }
 
 void
@@ -2569,12 +2867,7 @@ dns_message_puttempname(dns_message_t *msg, dns_name_t **itemp) {
 		dns_name_free(item, msg->mctx);
 	}
 
-	/*
-	 * 'name' is the first field in dns_fixedname_t, so putting
-	 * back the address of name is the same as putting back
-	 * the fixedname.
-	 */
-	isc_mempool_put(msg->namepool, item);
+	releasename(msg, item);
 }
 
 void
@@ -2592,7 +2885,7 @@ dns_message_puttemprdataset(dns_message_t *msg, dns_rdataset_t **item) {
 	REQUIRE(item != NULL && *item != NULL);
 
 	REQUIRE(!dns_rdataset_isassociated(*item));
-	isc_mempool_put(msg->rdspool, *item);
+	releaserdataset(msg, *item);
 	*item = NULL;
 }
 
@@ -2662,6 +2955,8 @@ dns_message_reply(dns_message_t *msg, bool want_question_section) {
 		clear_from = DNS_SECTION_QUESTION;
 	}
 	msg->from_to_wire = DNS_MESSAGE_INTENTRENDER;
+	msg->lazy = 0;
+	msg->lazyresult = ISC_R_SUCCESS;
 	msgresetnames(msg, clear_from);
 	msgresetopt(msg);
 	msgresetsigs(msg, true);
@@ -3260,6 +3555,13 @@ dns_message_sectiontotext(dns_message_t *msg, dns_section_t section,
 
 	saved_count = msg->indent.count;
 
+	if (section == DNS_SECTION_ANSWER || section == DNS_SECTION_AUTHORITY) {
+		result = parselazy(msg);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
+
 	if (ISC_LIST_EMPTY(msg->sections[section])) {
 		goto cleanup;
 	}
@@ -47,8 +47,6 @@ typedef enum {
 	ft_at
 } ft_state;
 
-typedef enum { fw_start = 0, fw_ordinary, fw_newcurrent } fw_state;
-
 #define INIT_OFFSETS(name, var, default_offsets) \
 	if ((name)->offsets != NULL)             \
 		var = (name)->offsets;           \
@@ -67,12 +65,13 @@ typedef enum { fw_start = 0, fw_ordinary, fw_newcurrent } fw_state;
  * Note:  If additional attributes are added that should not be set for
  *	  empty names, MAKE_EMPTY() must be changed so it clears them.
  */
-#define MAKE_EMPTY(name)                                    \
-	do {                                                \
-		name->ndata = NULL;                         \
-		name->length = 0;                           \
-		name->labels = 0;                           \
-		name->attributes &= ~DNS_NAMEATTR_ABSOLUTE; \
+#define MAKE_EMPTY(name)                                      \
+	do {                                                  \
+		name->ndata = NULL;                           \
+		name->length = 0;                             \
+		name->labels = 0;                             \
+		name->attributes &= ~(DNS_NAMEATTR_ABSOLUTE | \
+				      DNS_NAMEATTR_HASHED);   \
 	} while (0);
 
 /*%
@@ -435,9 +434,35 @@ dns_name_fullhash(const dns_name_t *name, bool case_sensitive) {
 		return (0);
 	}
 
+	if (!case_sensitive && (name->attributes & DNS_NAMEATTR_HASHED) != 0) {
+		return (name->hashval);
+	}
+
 	return (isc_hash32(name->ndata, name->length, case_sensitive));
 }
 
+/*
+ * Compute the case-insensitive full hash of 'name' and keep it there.
+ */
+static void
+cache_hash(dns_name_t *name) {
+	name->hashval = dns_name_fullhash(name, false);
+	name->attributes |= DNS_NAMEATTR_HASHED;
+}
+
+/*
+ * Make 'target' carry the cached hash of 'source', if it has one.
+ */
+static void
+copy_hash(const dns_name_t *source, dns_name_t *target) {
+	if ((source->attributes & DNS_NAMEATTR_HASHED) != 0) {
+		target->hashval = source->hashval;
+		target->attributes |= DNS_NAMEATTR_HASHED;
+	} else {
+		target->attributes &= ~DNS_NAMEATTR_HASHED;
+	}
+}
+
 dns_namereln_t
 dns_name_fullcompare(const dns_name_t *name1, const dns_name_t *name2,
 		     int *orderp, unsigned int *nlabelsp) {
@@ -778,6 +803,12 @@ dns_name_getlabelsequence(const dns_name_t *source, unsigned int first,
 
 	target->labels = n;
 
+	if (first == 0 && n == source->labels) {
+		copy_hash(source, target);
+	} else {
+		target->attributes &= ~DNS_NAMEATTR_HASHED;
+	}
+
 	/*
 	 * If source and target are the same, and we're making target
 	 * a prefix of source, the offsets table is correct already
@@ -805,6 +836,7 @@ dns_name_clone(const dns_name_t *source, dns_name_t *target) {
 			     (unsigned int)~(DNS_NAMEATTR_READONLY |
 					     DNS_NAMEATTR_DYNAMIC |
 					     DNS_NAMEATTR_DYNOFFSETS);
+	target->hashval = source->hashval;
 	if (target->offsets != NULL && source->labels > 0) {
 		if (source->offsets != NULL) {
 			memmove(target->offsets, source->offsets,
@@ -832,6 +864,8 @@ dns_name_fromregion(dns_name_t *name, const isc_region_t *r) {
 
 	INIT_OFFSETS(name, offsets, odata);
 
+	name->attributes &= ~DNS_NAMEATTR_HASHED;
+
 	if (name->buffer != NULL) {
 		isc_buffer_clear(name->buffer);
 		isc_buffer_availableregion(name->buffer, &r2);
@@ -1129,6 +1163,10 @@ dns_name_fromtext(dns_name_t *name, isc_buffer_t *source,
 	name->labels = labels;
 	name->length = nused;
 
+	if ((options & DNS_NAME_CACHEHASH) != 0) {
+		cache_hash(name);
+	}
+
 	isc_buffer_forward(source, tused);
 	isc_buffer_add(target, name->length);
 
@@ -1542,10 +1580,9 @@ dns_name_fromwire(dns_name_t *name, isc_buffer_t *source, dns_decompress_t dctx,
 		  unsigned int options, isc_buffer_t *target) {
 	unsigned char *cdata, *ndata;
 	unsigned int cused; /* Bytes of compressed name data used */
-	unsigned int nused, labels, n, nmax;
+	unsigned int nused, labels, nmax;
 	unsigned int current, new_current, biggest_pointer;
 	bool done;
-	fw_state state = fw_start;
 	unsigned int c;
 	unsigned char *offsets;
 	dns_offsets_t odata;
@@ -1578,12 +1615,6 @@ dns_name_fromwire(dns_name_t *name, isc_buffer_t *source, dns_decompress_t dctx,
 	 */
 	MAKE_EMPTY(name);
 
-	/*
-	 * Initialize things to make the compiler happy; they're not required.
-	 */
-	n = 0;
-	new_current = 0;
-
 	/*
 	 * Set up.
 	 */
@@ -1612,10 +1643,9 @@ dns_name_fromwire(dns_name_t *name, isc_buffer_t *source, dns_decompress_t dctx,
 	biggest_pointer = current;
 
 	/*
-	 * Note:  The following code is not optimized for speed, but
-	 * rather for correctness.  Speed will be addressed in the future.
+	 * Each label is validated and copied as a whole, so that the
+	 * copy can be done a word at a time rather than byte by byte.
 	 */
-
 	while (current < source->active && !done) {
 		c = *cdata++;
 		current++;
@@ -1623,47 +1653,46 @@ dns_name_fromwire(dns_name_t *name, isc_buffer_t *source, dns_decompress_t dctx,
 			cused++;
 		}
 
-		switch (state) {
-		case fw_start:
-			if (c < 64) {
-				offsets[labels] = nused;
-				labels++;
-				if (nused + c + 1 > nmax) {
-					goto full;
-				}
-				nused += c + 1;
-				*ndata++ = c;
-				if (c == 0) {
-					done = true;
-				}
-				n = c;
-				state = fw_ordinary;
-			} else if (c >= 192) {
-				/*
-				 * 14-bit compression pointer
-				 */
-				if (!dns_decompress_getpermitted(dctx)) {
-					return (DNS_R_DISALLOWED);
-				}
-				new_current = c & 0x3F;
-				state = fw_newcurrent;
-			} else {
-				return (DNS_R_BADLABELTYPE);
+		if (c < 64) {
+			offsets[labels] = nused;
+			labels++;
+			if (nused + c + 1 > nmax) {
+				goto full;
 			}
-			break;
-		case fw_ordinary:
-			if (downcase) {
-				c = isc_ascii_tolower(c);
+			if (c > source->active - current) {
+				return (ISC_R_UNEXPECTEDEND);
 			}
 			*ndata++ = c;
-			n--;
-			if (n == 0) {
-				state = fw_start;
+			if (downcase) {
+				isc_ascii_lowercopy(ndata, cdata, c);
+			} else {
+				memmove(ndata, cdata, c);
+			}
+			ndata += c;
+			cdata += c;
+			nused += c + 1;
+			current += c;
+			if (!seen_pointer) {
+				cused += c;
+			}
+			if (c == 0) {
+				done = true;
+			}
+		} else if (c >= 192) {
+			/*
+			 * 14-bit compression pointer
+			 */
+			if (!dns_decompress_getpermitted(dctx)) {
+				return (DNS_R_DISALLOWED);
+			}
+			if (current == source->active) {
+				return (ISC_R_UNEXPECTEDEND);
+			}
+			new_current = (c & 0x3F) * 256 + *cdata;
+			current++;
+			if (!seen_pointer) {
+				cused++;
 			}
-			break;
-		case fw_newcurrent:
-			new_current *= 256;
-			new_current += c;
 			if (new_current >= biggest_pointer) {
 				return (DNS_R_BADPOINTER);
 			}
@@ -1671,12 +1700,8 @@ dns_name_fromwire(dns_name_t *name, isc_buffer_t *source, dns_decompress_t dctx,
 			current = new_current;
 			cdata = (unsigned char *)source->base + current;
 			seen_pointer = true;
-			state = fw_start;
-			break;
-		default:
-			FATAL_ERROR(__FILE__, __LINE__, "Unknown state %d",
-				    state);
-			/* Does not return. */
+		} else {
+			return (DNS_R_BADLABELTYPE);
 		}
 	}
 
@@ -1689,6 +1714,10 @@ dns_name_fromwire(dns_name_t *name, isc_buffer_t *source, dns_decompress_t dctx,
 	name->length = nused;
 	name->attributes |= DNS_NAMEATTR_ABSOLUTE;
 
+	if ((options & DNS_NAME_CACHEHASH) != 0) {
+		cache_hash(name);
+	}
+
 	isc_buffer_forward(source, cused);
 	isc_buffer_add(target, name->length);
 
@@ -1773,7 +1802,8 @@ dns_name_towire2(const dns_name_t *name, dns_compress_t *cctx,
 		found = false;
 		compress = false;
 	} else {
-		found = dns_compress_find(cctx, name, &prefix, &there);
+		found = dns_compress_find(cctx, target, name, &prefix,
+					  &there);
 	}
 
 	/*
@@ -1817,7 +1847,7 @@ dns_name_towire2(const dns_name_t *name, dns_compress_t *cctx,
 		isc_buffer_add(target, name->length);
 	}
 
-	if (found && prefix.length == 0) {
+	if (found && compress && prefix.length == 0) {
 		here = there;
 	}
 
@@ -1825,10 +1855,11 @@ dns_name_towire2(const dns_name_t *name, dns_compress_t *cctx,
 		return (ISC_R_SUCCESS);
 	}
 
-	if (found) {
-		dns_compress_add(cctx, name, &prefix, here);
+	if (found && compress) {
+		dns_compress_add(cctx, name, &prefix, here, there);
 	} else {
-		dns_compress_add(cctx, name, name, here);
+		dns_compress_add(cctx, name, name, here,
+				 DNS_COMPRESS_NOOFFSET);
 	}
 
 	/*
@@ -2003,6 +2034,7 @@ dns_name_dup(const dns_name_t *source, isc_mem_t *mctx, dns_name_t *target) {
 	if ((source->attributes & DNS_NAMEATTR_ABSOLUTE) != 0) {
 		target->attributes |= DNS_NAMEATTR_ABSOLUTE;
 	}
+	copy_hash(source, target);
 	if (target->offsets != NULL) {
 		if (source->offsets != NULL) {
 			memmove(target->offsets, source->offsets,
@@ -2043,6 +2075,7 @@ dns_name_dupwithoffsets(const dns_name_t *source, isc_mem_t *mctx,
 	if ((source->attributes & DNS_NAMEATTR_ABSOLUTE) != 0) {
 		target->attributes |= DNS_NAMEATTR_ABSOLUTE;
 	}
+	copy_hash(source, target);
 	target->offsets = target->ndata + source->length;
 	if (source->offsets != NULL) {
 		memmove(target->offsets, source->offsets, source->labels);
@@ -2275,6 +2308,7 @@ dns_name_copy(const dns_name_t *source, dns_name_t *dest) {
 	} else {
 		dest->attributes = 0;
 	}
+	copy_hash(source, dest);
 
 	if (dest->labels > 0 && dest->offsets != NULL) {
 		if (source->offsets != NULL && source->labels != 0) {
@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/atomic.h>
+#include <isc/mem.h>
+#include <isc/rcu.h>
+#include <isc/result.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rbt.h>
+
+#include "namesnap_p.h"
+
+typedef struct namesnap_entry namesnap_entry_t;
+
+struct namesnap_entry {
+	namesnap_entry_t *next;
+	unsigned int hashval;
+	uint32_t value;
+	dns_fixedname_t fname;
+	dns_name_t *name;
+};
+
+typedef struct namesnap namesnap_t;
+
+struct namesnap {
+	unsigned int count;
+	unsigned int size;
+	unsigned int maxlabels;
+	namesnap_entry_t *entries;
+	namesnap_entry_t **buckets;
+};
+
+struct dns__namesnaps {
+	isc_mem_t *mctx;
+	/* Replaced by dns__namesnaps_update(), read without locks. */
+	atomic_uintptr_t current;
+};
+
+static void
+snap_free(isc_mem_t *mctx, namesnap_t *snap) {
+	if (snap->count > 0) {
+		isc_mem_put(mctx, snap->entries,
+			    snap->count * sizeof(snap->entries[0]));
+	}
+	isc_mem_put(mctx, snap->buckets, snap->size * sizeof(snap->buckets[0]));
+	isc_mem_put(mctx, snap, sizeof(*snap));
+}
+
+static namesnap_entry_t *
+snap_find(namesnap_t *snap, const dns_name_t *name) {
+	unsigned int hashval = dns_name_fullhash(name, false);
+	namesnap_entry_t *entry = snap->buckets[hashval % snap->size];
+
+	for (; entry != NULL; entry = entry->next) {
+		if (entry->hashval == hashval &&
+		    dns_name_equal(entry->name, name))
+		{
+			return (entry);
+		}
+	}
+
+	return (NULL);
+}
+
+void
+dns__namesnaps_create(isc_mem_t *mctx, dns__namesnaps_t **snapsp) {
+	dns__namesnaps_t *snaps = NULL;
+
+	REQUIRE(snapsp != NULL && *snapsp == NULL);
+
+	snaps = isc_mem_get(mctx, sizeof(*snaps));
+	*snaps = (dns__namesnaps_t){ .mctx = NULL };
+	isc_mem_attach(mctx, &snaps->mctx);
+	atomic_init(&snaps->current, 0);
+
+	*snapsp = snaps;
+}
+
+void
+dns__namesnaps_destroy(dns__namesnaps_t **snapsp) {
+	dns__namesnaps_t *snaps = NULL;
+	namesnap_t *snap = NULL;
+
+	REQUIRE(snapsp != NULL && *snapsp != NULL);
+
+	snaps = *snapsp;
+	*snapsp = NULL;
+
+	snap = (namesnap_t *)atomic_load_acquire(&snaps->current);
+	if (snap != NULL) {
+		snap_free(snaps->mctx, snap);
+	}
+
+	isc_mem_putanddetach(&snaps->mctx, snaps, sizeof(*snaps));
+}
+
+void
+dns__namesnaps_update(dns__namesnaps_t *snaps, dns_rbt_t *rbt,
+		      dns__namesnap_valuefn_t valuefn) {
+	isc_result_t result;
+	dns_rbtnodechain_t chain;
+	dns_rbtnode_t *node = NULL;
+	dns_fixedname_t fixedfound, fixedorigin;
+	dns_name_t *foundname = NULL, *origin = NULL;
+	namesnap_t *snap = NULL, *old = NULL;
+	unsigned int n = 0;
+
+	REQUIRE(snaps != NULL);
+
+	/*
+	 * Size the copy for every node, including the empty ones that
+	 * are skipped; the hash table is kept at most half full.
+	 */
+	snap = isc_mem_get(snaps->mctx, sizeof(*snap));
+	*snap = (namesnap_t){ .count = dns_rbt_nodecount(rbt) };
+	snap->size = snap->count * 2 + 1;
+	if (snap->count > 0) {
+		snap->entries = isc_mem_get(
+			snaps->mctx, snap->count * sizeof(snap->entries[0]));
+	}
+	snap->buckets = isc_mem_get(snaps->mctx,
+				    snap->size * sizeof(snap->buckets[0]));
+	memset(snap->buckets, 0, snap->size * sizeof(snap->buckets[0]));
+
+	foundname = dns_fixedname_initname(&fixedfound);
+	origin = dns_fixedname_initname(&fixedorigin);
+
+	dns_rbtnodechain_init(&chain);
+	result = dns_rbtnodechain_first(&chain, rbt, NULL, NULL);
+	while (result == ISC_R_SUCCESS || result == DNS_R_NEWORIGIN) {
+		dns_rbtnodechain_current(&chain, foundname, origin, &node);
+		if (node->data != NULL) {
+			namesnap_entry_t *entry = &snap->entries[n++];
+			unsigned int b;
+
+			INSIST(n <= snap->count);
+			entry->name = dns_fixedname_initname(&entry->fname);
+			result = dns_name_concatenate(foundname, origin,
+						      entry->name, NULL);
+			RUNTIME_CHECK(result == ISC_R_SUCCESS);
+			entry->hashval = dns_name_fullhash(entry->name, false);
+			entry->value = (valuefn != NULL) ? valuefn(node->data)
+							 : 0;
+			snap->maxlabels = ISC_MAX(
+				snap->maxlabels,
+				dns_name_countlabels(entry->name));
+
+			b = entry->hashval % snap->size;
+			entry->next = snap->buckets[b];
+			snap->buckets[b] = entry;
+		}
+		result = dns_rbtnodechain_next(&chain, NULL, NULL);
+	}
+	dns_rbtnodechain_invalidate(&chain);
+
+	old = (namesnap_t *)atomic_load_relaxed(&snaps->current);
+	atomic_store_release(&snaps->current, (uintptr_t)snap);
+
+	/*
+	 * Updates are rare and lookups short, so wait for the readers
+	 * of the old copy to finish and free it now, rather than keeping
+	 * it until the next update.
+	 */
+	if (old != NULL) {
+		isc_rcu_synchronize();
+		snap_free(snaps->mctx, old);
+	}
+}
+
+bool
+dns__namesnaps_find(dns__namesnaps_t *snaps, const dns_name_t *name,
+		    dns_name_t *foundname, uint32_t *valuep) {
+	namesnap_t *snap = NULL;
+	namesnap_entry_t *entry = NULL;
+	unsigned int labels;
+
+	REQUIRE(snaps != NULL);
+	REQUIRE(dns_name_isabsolute(name));
+
+	isc_rcu_read_lock();
+
+	snap = (namesnap_t *)atomic_load_acquire(&snaps->current);
+	if (snap == NULL || snap->maxlabels == 0) {
+		goto unlock;
+	}
+
+	/*
+	 * Try each suffix of 'name', longest first, skipping those with
+	 * more labels than any name in the copy.
+	 */
+	labels = dns_name_countlabels(name);
+	for (unsigned int i = labels - ISC_MIN(labels, snap->maxlabels);
+	     entry == NULL && i < labels; i++)
+	{
+		dns_name_t suffix;
+
+		dns_name_init(&suffix, NULL);
+		dns_name_getlabelsequence(name, i, labels - i, &suffix);
+		entry = snap_find(snap, &suffix);
+	}
+
+	if (entry != NULL) {
+		if (foundname != NULL) {
+			dns_name_copy(entry->name, foundname);
+		}
+		if (valuep != NULL) {
+			*valuep = entry->value;
+		}
+	}
+
+unlock:
+	isc_rcu_read_unlock();
+
+	return (entry != NULL);
+}
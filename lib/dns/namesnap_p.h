@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/lang.h>
+#include <isc/mem.h>
+
+#include <dns/rbt.h>
+#include <dns/types.h>
+
+/*%
+ *     These functions must not be used outside this module and
+ *     its associated unit tests.
+ *
+ * A dns__namesnaps_t holds an immutable copy of the names of an rbt
+ * that have data, each with a 32-bit value, in a hash table.  Loop
+ * threads find the deepest name at or above a given name in the copy
+ * without taking any lock, in an isc_rcu read-side critical section.
+ * The owner of the rbt replaces the copy after each change, while it
+ * holds the lock that serializes its changes, and the old copy is
+ * freed as soon as no reader can still see it.
+ */
+
+typedef struct dns__namesnaps dns__namesnaps_t;
+
+/*%
+ * Return the value to keep for the rbt node data 'data'.
+ */
+typedef uint32_t (*dns__namesnap_valuefn_t)(void *data);
+
+ISC_LANG_BEGINDECLS
+
+void
+dns__namesnaps_create(isc_mem_t *mctx, dns__namesnaps_t **snapsp);
+void
+dns__namesnaps_destroy(dns__namesnaps_t **snapsp);
+/*%<
+ * Create an empty set of copies, and destroy it with every copy left.
+ * No reader may be using it when it is destroyed.
+ */
+
+void
+dns__namesnaps_update(dns__namesnaps_t *snaps, dns_rbt_t *rbt,
+		      dns__namesnap_valuefn_t valuefn);
+/*%<
+ * Replace the current copy with one of the names of 'rbt' that have
+ * data, with the values 'valuefn' returns for the data ('valuefn' may
+ * be NULL, making all values zero).
+ *
+ * The caller must keep 'rbt' from changing during the call, and calls
+ * for the same 'snaps' must not run at the same time.  The call waits
+ * for the lookups still using the old copy, so it must not be made in
+ * an isc_rcu read-side critical section.
+ */
+
+bool
+dns__namesnaps_find(dns__namesnaps_t *snaps, const dns_name_t *name,
+		    dns_name_t *foundname, uint32_t *valuep);
+/*%<
+ * Find the deepest name at or above 'name' in the current copy.  If
+ * there is one, return true, copying it into 'foundname' and its value
+ * into '*valuep' when these are not NULL.
+ *
+ * Requires:
+ *\li	isc_rcu_available() is true.
+ */
+
+ISC_LANG_ENDDECLS
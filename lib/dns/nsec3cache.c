@@ -0,0 +1,334 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/atomic.h>
+#include <isc/base32.h>
+#include <isc/buffer.h>
+#include <isc/iterated_hash.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/nsec3cache.h>
+
+#define NSEC3CACHE_MAGIC    ISC_MAGIC('N', '3', 'H', 'c')
+#define VALID_NSEC3CACHE(c) ISC_MAGIC_VALID(c, NSEC3CACHE_MAGIC)
+
+/*
+ * Number of locks protecting the buckets; bucket 'i' is protected by
+ * lock 'i % NSEC3CACHE_NLOCKS'.  The parameters are only changed with
+ * every lock held, so holding any of them is enough to read them.
+ */
+#define NSEC3CACHE_NLOCKS 16
+
+/*
+ * Longest hash kept; longer ones are computed every time.  This is the
+ * length of a SHA-1 hash, the only algorithm defined for NSEC3.
+ */
+#define NSEC3CACHE_HASHLEN 20
+
+#define ENTRIESSIZE(nbuckets) \
+	((size_t)(nbuckets) * DNS_NSEC3CACHE_WAYS * sizeof(nsec3entry_t))
+
+/*
+ * An entry is empty unless its generation is the current generation of
+ * the cache, which starts at one.
+ */
+typedef struct nsec3entry {
+	uint32_t generation;
+	uint32_t hashval;
+	bool referenced;
+	uint8_t hashlen;
+	uint8_t namelen;
+	unsigned char hash[NSEC3CACHE_HASHLEN];
+	unsigned char name[DNS_NAME_MAXWIRE];
+} nsec3entry_t;
+
+struct dns_nsec3cache {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	unsigned int nbuckets;
+	nsec3entry_t *entries;
+	unsigned int *hands;
+	uint32_t generation;
+	dns_hash_t hashalg;
+	unsigned int iterations;
+	size_t saltlength;
+	unsigned char salt[255];
+	atomic_uint_fast64_t hits;
+	atomic_uint_fast64_t misses;
+	isc_mutex_t locks[NSEC3CACHE_NLOCKS];
+};
+
+void
+dns_nsec3cache_create(isc_mem_t *mctx, unsigned int size,
+		      dns_nsec3cache_t **cachep) {
+	dns_nsec3cache_t *cache = NULL;
+	unsigned int nbuckets;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(size > 0);
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	nbuckets = (size + DNS_NSEC3CACHE_WAYS - 1) / DNS_NSEC3CACHE_WAYS;
+
+	cache = isc_mem_get(mctx, sizeof(*cache));
+	*cache = (dns_nsec3cache_t){
+		.nbuckets = nbuckets,
+		.generation = 1,
+	};
+
+	isc_mem_attach(mctx, &cache->mctx);
+	cache->entries = isc_mem_get(mctx, ENTRIESSIZE(nbuckets));
+	memset(cache->entries, 0, ENTRIESSIZE(nbuckets));
+	cache->hands = isc_mem_get(mctx, nbuckets * sizeof(cache->hands[0]));
+	memset(cache->hands, 0, nbuckets * sizeof(cache->hands[0]));
+	atomic_init(&cache->hits, 0);
+	atomic_init(&cache->misses, 0);
+	for (size_t i = 0; i < NSEC3CACHE_NLOCKS; i++) {
+		isc_mutex_init(&cache->locks[i]);
+	}
+
+	cache->magic = NSEC3CACHE_MAGIC;
+
+	*cachep = cache;
+}
+
+void
+dns_nsec3cache_destroy(dns_nsec3cache_t **cachep) {
+	dns_nsec3cache_t *cache = NULL;
+
+	REQUIRE(cachep != NULL && VALID_NSEC3CACHE(*cachep));
+
+	cache = *cachep;
+	*cachep = NULL;
+
+	cache->magic = 0;
+	for (size_t i = 0; i < NSEC3CACHE_NLOCKS; i++) {
+		isc_mutex_destroy(&cache->locks[i]);
+	}
+	isc_mem_put(cache->mctx, cache->entries, ENTRIESSIZE(cache->nbuckets));
+	isc_mem_put(cache->mctx, cache->hands,
+		    cache->nbuckets * sizeof(cache->hands[0]));
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+/*
+ * Return whether the cache holds the hashes made with these parameters.
+ * One of the locks must be held.
+ */
+static bool
+sameparams(dns_nsec3cache_t *cache, dns_hash_t hashalg,
+	   unsigned int iterations, const unsigned char *salt,
+	   size_t saltlength) {
+	return (cache->hashalg == hashalg && cache->iterations == iterations &&
+		cache->saltlength == saltlength &&
+		(saltlength == 0 ||
+		 memcmp(cache->salt, salt, saltlength) == 0));
+}
+
+/*
+ * Forget every hash and keep the ones made with these parameters from
+ * now on.  Generation zero marks empty entries and is skipped when the
+ * counter wraps.
+ */
+static void
+setparams(dns_nsec3cache_t *cache, dns_hash_t hashalg,
+	  unsigned int iterations, const unsigned char *salt,
+	  size_t saltlength) {
+	for (size_t i = 0; i < NSEC3CACHE_NLOCKS; i++) {
+		LOCK(&cache->locks[i]);
+	}
+	if (!sameparams(cache, hashalg, iterations, salt, saltlength)) {
+		cache->hashalg = hashalg;
+		cache->iterations = iterations;
+		cache->saltlength = saltlength;
+		if (saltlength != 0) {
+			memmove(cache->salt, salt, saltlength);
+		}
+		if (++cache->generation == 0) {
+			cache->generation = 1;
+		}
+	}
+	for (size_t i = 0; i < NSEC3CACHE_NLOCKS; i++) {
+		UNLOCK(&cache->locks[i]);
+	}
+}
+
+/*
+ * Find the entry of 'lname' in 'bucket', or NULL.  The bucket lock must
+ * be held.
+ */
+static nsec3entry_t *
+findentry(dns_nsec3cache_t *cache, unsigned int bucket, uint32_t hashval,
+	  const dns_name_t *lname) {
+	nsec3entry_t *entries = &cache->entries[bucket * DNS_NSEC3CACHE_WAYS];
+
+	for (unsigned int way = 0; way < DNS_NSEC3CACHE_WAYS; way++) {
+		nsec3entry_t *entry = &entries[way];
+
+		if (entry->generation == cache->generation &&
+		    entry->hashval == hashval &&
+		    entry->namelen == lname->length &&
+		    memcmp(entry->name, lname->ndata, lname->length) == 0)
+		{
+			return (entry);
+		}
+	}
+
+	return (NULL);
+}
+
+/*
+ * Choose the entry of 'bucket' to replace: an empty one, or else the
+ * first one the hand reaches that was not looked up since it last
+ * passed.  The bucket lock must be held.
+ */
+static nsec3entry_t *
+victim(dns_nsec3cache_t *cache, unsigned int bucket) {
+	nsec3entry_t *entries = &cache->entries[bucket * DNS_NSEC3CACHE_WAYS];
+	unsigned int *hand = &cache->hands[bucket];
+
+	for (unsigned int way = 0; way < DNS_NSEC3CACHE_WAYS; way++) {
+		if (entries[way].generation != cache->generation) {
+			return (&entries[way]);
+		}
+	}
+
+	for (;;) {
+		nsec3entry_t *entry = &entries[*hand];
+
+		*hand = (*hand + 1) % DNS_NSEC3CACHE_WAYS;
+		if (!entry->referenced) {
+			return (entry);
+		}
+		entry->referenced = false;
+	}
+}
+
+isc_result_t
+dns_nsec3cache_hashname(dns_nsec3cache_t *cache, dns_fixedname_t *result,
+			unsigned char rethash[NSEC3_MAX_HASH_LENGTH],
+			size_t *hash_length, const dns_name_t *name,
+			const dns_name_t *origin, dns_hash_t hashalg,
+			unsigned int iterations, const unsigned char *salt,
+			size_t saltlength) {
+	unsigned char hash[NSEC3_MAX_HASH_LENGTH];
+	unsigned char nametext[DNS_NAME_FORMATSIZE];
+	dns_fixedname_t fixed;
+	dns_name_t *lname = NULL;
+	nsec3entry_t *entry = NULL;
+	isc_buffer_t namebuffer;
+	isc_region_t region;
+	isc_mutex_t *lock = NULL;
+	uint32_t hashval, generation;
+	unsigned int bucket;
+	size_t len = 0;
+
+	REQUIRE(VALID_NSEC3CACHE(cache));
+	REQUIRE(name != NULL);
+
+	if (rethash == NULL) {
+		rethash = hash;
+	}
+
+	memset(rethash, 0, NSEC3_MAX_HASH_LENGTH);
+
+	lname = dns_fixedname_initname(&fixed);
+	(void)dns_name_downcase(name, lname, NULL);
+	hashval = dns_name_fullhash(lname, true);
+	bucket = hashval % cache->nbuckets;
+	lock = &cache->locks[bucket % NSEC3CACHE_NLOCKS];
+
+	LOCK(lock);
+	if (!sameparams(cache, hashalg, iterations, salt, saltlength)) {
+		UNLOCK(lock);
+		setparams(cache, hashalg, iterations, salt, saltlength);
+		LOCK(lock);
+	}
+	generation = cache->generation;
+	entry = findentry(cache, bucket, hashval, lname);
+	if (entry != NULL) {
+		entry->referenced = true;
+		len = entry->hashlen;
+		memmove(rethash, entry->hash, len);
+	}
+	UNLOCK(lock);
+
+	if (entry != NULL) {
+		atomic_fetch_add_relaxed(&cache->hits, 1);
+	} else {
+		atomic_fetch_add_relaxed(&cache->misses, 1);
+
+		/* hash the node name */
+		len = isc_iterated_hash(rethash, hashalg, iterations, salt,
+					(int)saltlength, lname->ndata,
+					lname->length);
+		if (len == 0U) {
+			return (DNS_R_BADALG);
+		}
+
+		/*
+		 * The hash is only kept if the parameters did not change
+		 * while it was computed.
+		 */
+		LOCK(lock);
+		if (len <= NSEC3CACHE_HASHLEN &&
+		    cache->generation == generation &&
+		    findentry(cache, bucket, hashval, lname) == NULL)
+		{
+			entry = victim(cache, bucket);
+			entry->generation = generation;
+			entry->hashval = hashval;
+			entry->referenced = false;
+			entry->hashlen = (uint8_t)len;
+			entry->namelen = (uint8_t)lname->length;
+			memmove(entry->hash, rethash, len);
+			memmove(entry->name, lname->ndata, lname->length);
+		}
+		UNLOCK(lock);
+	}
+
+	if (hash_length != NULL) {
+		*hash_length = len;
+	}
+
+	/* convert the hash to base32hex non-padded */
+	region.base = rethash;
+	region.length = (unsigned int)len;
+	isc_buffer_init(&namebuffer, nametext, sizeof nametext);
+	isc_base32hexnp_totext(&region, 1, "", &namebuffer);
+
+	/* convert the hex to a domain name */
+	dns_fixedname_init(result);
+	return (dns_name_fromtext(dns_fixedname_name(result), &namebuffer,
+				  origin, 0, NULL));
+}
+
+void
+dns_nsec3cache_getstats(dns_nsec3cache_t *cache, uint64_t *hitsp,
+			uint64_t *missesp) {
+	REQUIRE(VALID_NSEC3CACHE(cache));
+	REQUIRE(hitsp != NULL && missesp != NULL);
+
+	*hitsp = atomic_load_relaxed(&cache->hits);
+	*missesp = atomic_load_relaxed(&cache->misses);
+}
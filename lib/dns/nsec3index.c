@@ -0,0 +1,586 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include <isc/base32.h>
+#include <isc/buffer.h>
+#include <isc/ht.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/rwlock.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/nsec3.h>
+#include <dns/nsec3index.h>
+#include <dns/rdata.h>
+#include <dns/rdataset.h>
+#include <dns/rdatastruct.h>
+
+#define NSEC3INDEX_MAGIC    ISC_MAGIC('N', '3', 'I', 'x')
+#define VALID_NSEC3INDEX(x) ISC_MAGIC_VALID(x, NSEC3INDEX_MAGIC)
+
+/*
+ * Only SHA-1, with 20 byte hashes, is defined for NSEC3 (see
+ * dns_nsec3_supportedhash()).
+ */
+#define NSEC3INDEX_HASHLEN 20
+
+/*
+ * The range from 'owner' to 'next' of one NSEC3 record, and whether its
+ * type bitmap has the types that matter for a closest encloser.
+ */
+typedef struct nsec3range {
+	unsigned char owner[NSEC3INDEX_HASHLEN];
+	unsigned char next[NSEC3INDEX_HASHLEN];
+	isc_stdtime_t expire;
+	bool optout;
+	bool ns;
+	bool soa;
+	bool ds;
+	bool dname;
+} nsec3range_t;
+
+/*
+ * The ranges known for one zone, sorted by owner hash, and the NSEC3
+ * parameters they were made with.
+ */
+typedef struct nsec3zone {
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	dns_hash_t hash;
+	dns_iterations_t iterations;
+	unsigned char saltlen;
+	unsigned char salt[255];
+	nsec3range_t *ranges;
+	unsigned int count;
+	unsigned int size;
+} nsec3zone_t;
+
+/*
+ * Locking
+ *
+ * 'lock' protects the table of zones and everything in it.  Lookups
+ * take it for reading, including while they hash the names they look
+ * for: the number of iterations is bounded by dns_nsec3_maxiterations().
+ */
+struct dns_nsec3index {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	isc_rwlock_t lock;
+	isc_ht_t *zones;
+	unsigned int count;
+};
+
+void
+dns_nsec3index_create(isc_mem_t *mctx, dns_nsec3index_t **indexp) {
+	dns_nsec3index_t *index = NULL;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(indexp != NULL && *indexp == NULL);
+
+	index = isc_mem_get(mctx, sizeof(*index));
+	*index = (dns_nsec3index_t){ .magic = NSEC3INDEX_MAGIC };
+	isc_mem_attach(mctx, &index->mctx);
+	isc_rwlock_init(&index->lock, 0, 0);
+	isc_ht_init(&index->zones, mctx, 4, ISC_HT_CASE_INSENSITIVE);
+
+	*indexp = index;
+}
+
+static void
+zone_free(dns_nsec3index_t *index, nsec3zone_t *zone) {
+	INSIST(index->count >= zone->count);
+	index->count -= zone->count;
+	if (zone->ranges != NULL) {
+		isc_mem_put(index->mctx, zone->ranges,
+			    zone->size * sizeof(zone->ranges[0]));
+	}
+	isc_mem_put(index->mctx, zone, sizeof(*zone));
+}
+
+/*
+ * Remove the zones that could say anything about 'name', or all of them
+ * if 'name' is NULL.  The write lock must be held.
+ */
+static void
+flush(dns_nsec3index_t *index, const dns_name_t *name, bool tree) {
+	isc_ht_iter_t *it = NULL;
+	isc_result_t result;
+
+	isc_ht_iter_create(index->zones, &it);
+	result = isc_ht_iter_first(it);
+	while (result == ISC_R_SUCCESS) {
+		nsec3zone_t *zone = NULL;
+
+		isc_ht_iter_current(it, (void **)&zone);
+		if (name == NULL || dns_name_issubdomain(name, zone->name) ||
+		    (tree && dns_name_issubdomain(zone->name, name)))
+		{
+			zone_free(index, zone);
+			result = isc_ht_iter_delcurrent_next(it);
+		} else {
+			result = isc_ht_iter_next(it);
+		}
+	}
+	isc_ht_iter_destroy(&it);
+}
+
+void
+dns_nsec3index_destroy(dns_nsec3index_t **indexp) {
+	dns_nsec3index_t *index = NULL;
+
+	REQUIRE(indexp != NULL && VALID_NSEC3INDEX(*indexp));
+
+	index = *indexp;
+	*indexp = NULL;
+
+	flush(index, NULL, false);
+	INSIST(index->count == 0);
+	isc_ht_destroy(&index->zones);
+	isc_rwlock_destroy(&index->lock);
+	index->magic = 0;
+	isc_mem_putanddetach(&index->mctx, index, sizeof(*index));
+}
+
+/*
+ * Find the position of the last range of 'zone' whose owner hash is
+ * lower than or equal to 'hash'; -1 if there is none.
+ */
+static int
+zone_search(const nsec3zone_t *zone, const unsigned char *hash) {
+	int lo = 0, hi = (int)zone->count - 1, found = -1;
+
+	while (lo <= hi) {
+		int mid = lo + (hi - lo) / 2;
+		int order = memcmp(zone->ranges[mid].owner, hash,
+				   NSEC3INDEX_HASHLEN);
+		if (order <= 0) {
+			found = mid;
+			lo = mid + 1;
+		} else {
+			hi = mid - 1;
+		}
+	}
+
+	return (found);
+}
+
+/*
+ * Drop the expired ranges of 'zone'.  The write lock must be held.
+ */
+static void
+zone_expire(dns_nsec3index_t *index, nsec3zone_t *zone, isc_stdtime_t now) {
+	unsigned int i, j;
+
+	for (i = 0, j = 0; i < zone->count; i++) {
+		if (zone->ranges[i].expire > now) {
+			zone->ranges[j++] = zone->ranges[i];
+		}
+	}
+	index->count -= zone->count - j;
+	zone->count = j;
+}
+
+isc_result_t
+dns_nsec3index_add(dns_nsec3index_t *index, const dns_name_t *owner,
+		   dns_rdataset_t *rdataset, isc_stdtime_t now) {
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdata_nsec3_t nsec3;
+	dns_fixedname_t fzone;
+	dns_name_t *zonename = NULL;
+	dns_label_t hashlabel;
+	isc_buffer_t buffer;
+	unsigned char hash[NSEC3_MAX_HASH_LENGTH];
+	nsec3zone_t *zone = NULL;
+	nsec3range_t range;
+	isc_result_t result;
+	int pos;
+
+	REQUIRE(VALID_NSEC3INDEX(index));
+	REQUIRE(rdataset != NULL && rdataset->type == dns_rdatatype_nsec3);
+
+	/*
+	 * An NSEC3 RRset has a single record; its owner is the hash of
+	 * a name in the zone, prepended to the zone name.
+	 */
+	if (dns_name_countlabels(owner) < 2 || rdataset->ttl == 0 ||
+	    dns_rdataset_count(rdataset) != 1)
+	{
+		return (ISC_R_IGNORE);
+	}
+	result = dns_rdataset_first(rdataset);
+	if (result != ISC_R_SUCCESS) {
+		return (ISC_R_IGNORE);
+	}
+	dns_rdataset_current(rdataset, &rdata);
+	result = dns_rdata_tostruct(&rdata, &nsec3, NULL);
+	if (result != ISC_R_SUCCESS) {
+		return (ISC_R_IGNORE);
+	}
+	if (!dns_nsec3_supportedhash(nsec3.hash) ||
+	    dns_nsec3_hashlength(nsec3.hash) != NSEC3INDEX_HASHLEN ||
+	    nsec3.next_length != NSEC3INDEX_HASHLEN ||
+	    nsec3.iterations > dns_nsec3_maxiterations() ||
+	    (nsec3.flags & ~DNS_NSEC3FLAG_OPTOUT) != 0)
+	{
+		return (ISC_R_IGNORE);
+	}
+
+	dns_name_getlabel(owner, 0, &hashlabel);
+	isc_region_consume(&hashlabel, 1);
+	isc_buffer_init(&buffer, hash, sizeof(hash));
+	result = isc_base32hex_decoderegion(&hashlabel, &buffer);
+	if (result != ISC_R_SUCCESS ||
+	    isc_buffer_usedlength(&buffer) != NSEC3INDEX_HASHLEN)
+	{
+		return (ISC_R_IGNORE);
+	}
+
+	zonename = dns_fixedname_initname(&fzone);
+	dns_name_split(owner, dns_name_countlabels(owner) - 1, NULL,
+		       zonename);
+
+	range = (nsec3range_t){
+		.expire = now + rdataset->ttl,
+		.optout = (nsec3.flags & DNS_NSEC3FLAG_OPTOUT) != 0,
+		.ns = dns_nsec3_typepresent(&rdata, dns_rdatatype_ns),
+		.soa = dns_nsec3_typepresent(&rdata, dns_rdatatype_soa),
+		.ds = dns_nsec3_typepresent(&rdata, dns_rdatatype_ds),
+		.dname = dns_nsec3_typepresent(&rdata, dns_rdatatype_dname),
+	};
+	memmove(range.owner, hash, NSEC3INDEX_HASHLEN);
+	memmove(range.next, nsec3.next, NSEC3INDEX_HASHLEN);
+
+	RWLOCK(&index->lock, isc_rwlocktype_write);
+
+	result = isc_ht_find(index->zones, zonename->ndata, zonename->length,
+			     (void **)&zone);
+	if (result == ISC_R_SUCCESS &&
+	    (zone->hash != nsec3.hash || zone->iterations != nsec3.iterations ||
+	     zone->saltlen != nsec3.salt_length ||
+	     memcmp(zone->salt, nsec3.salt, nsec3.salt_length) != 0))
+	{
+		/*
+		 * A new NSEC3 chain: the old ranges are of no use.
+		 */
+		index->count -= zone->count;
+		zone->count = 0;
+		zone->hash = nsec3.hash;
+		zone->iterations = nsec3.iterations;
+		zone->saltlen = nsec3.salt_length;
+		memmove(zone->salt, nsec3.salt, nsec3.salt_length);
+	} else if (result != ISC_R_SUCCESS) {
+		zone = isc_mem_get(index->mctx, sizeof(*zone));
+		*zone = (nsec3zone_t){
+			.hash = nsec3.hash,
+			.iterations = nsec3.iterations,
+			.saltlen = nsec3.salt_length,
+		};
+		zone->name = dns_fixedname_initname(&zone->fname);
+		dns_name_copy(zonename, zone->name);
+		memmove(zone->salt, nsec3.salt, nsec3.salt_length);
+		result = isc_ht_add(index->zones, zone->name->ndata,
+				    zone->name->length, zone);
+		INSIST(result == ISC_R_SUCCESS);
+	}
+
+	pos = zone_search(zone, range.owner);
+	if (pos >= 0 && memcmp(zone->ranges[pos].owner, range.owner,
+			       NSEC3INDEX_HASHLEN) == 0)
+	{
+		zone->ranges[pos] = range;
+		result = ISC_R_SUCCESS;
+		goto unlock;
+	}
+
+	if (index->count >= DNS_NSEC3INDEX_MAXRANGES) {
+		zone_expire(index, zone, now);
+		if (index->count >= DNS_NSEC3INDEX_MAXRANGES) {
+			result = ISC_R_NOSPACE;
+			goto unlock;
+		}
+		pos = zone_search(zone, range.owner);
+	}
+
+	if (zone->count == zone->size) {
+		unsigned int newsize = ISC_MAX(zone->size * 2, 8U);
+		nsec3range_t *ranges =
+			isc_mem_get(index->mctx, newsize * sizeof(ranges[0]));
+		if (zone->ranges != NULL) {
+			memmove(ranges, zone->ranges,
+				zone->count * sizeof(ranges[0]));
+			isc_mem_put(index->mctx, zone->ranges,
+				    zone->size * sizeof(ranges[0]));
+		}
+		zone->ranges = ranges;
+		zone->size = newsize;
+	}
+
+	memmove(&zone->ranges[pos + 2], &zone->ranges[pos + 1],
+		(zone->count - (pos + 1)) * sizeof(zone->ranges[0]));
+	zone->ranges[pos + 1] = range;
+	zone->count++;
+	index->count++;
+	result = ISC_R_SUCCESS;
+
+unlock:
+	RWUNLOCK(&index->lock, isc_rwlocktype_write);
+	return (result);
+}
+
+/*
+ * Hash 'name' with the NSEC3 parameters of 'zone'.
+ */
+static bool
+zone_hash(const nsec3zone_t *zone, const dns_name_t *name,
+	  unsigned char hash[NSEC3_MAX_HASH_LENGTH]) {
+	dns_fixedname_t fhashed;
+	size_t hashlen = 0;
+	isc_result_t result;
+
+	result = dns_nsec3_hashname(&fhashed, hash, &hashlen, name, zone->name,
+				    zone->hash, zone->iterations, zone->salt,
+				    zone->saltlen);
+	return (result == ISC_R_SUCCESS && hashlen == NSEC3INDEX_HASHLEN);
+}
+
+/*
+ * Find the live range in 'zone' whose owner is 'hash'; NULL if there
+ * is none.
+ */
+static const nsec3range_t *
+zone_match(const nsec3zone_t *zone, const unsigned char *hash,
+	   isc_stdtime_t now) {
+	int pos = zone_search(zone, hash);
+
+	if (pos < 0 ||
+	    memcmp(zone->ranges[pos].owner, hash, NSEC3INDEX_HASHLEN) != 0 ||
+	    zone->ranges[pos].expire <= now)
+	{
+		return (NULL);
+	}
+
+	return (&zone->ranges[pos]);
+}
+
+/*
+ * Can the name that 'range' matches be a closest encloser?  Not if it
+ * is a delegation or has a DNAME, as in dns_nsec3_noexistnodata(): the
+ * names below it are not in the zone.
+ */
+static bool
+range_encloses(const nsec3range_t *range) {
+	return (!range->ds && !range->dname && (range->soa || !range->ns));
+}
+
+/*
+ * Is there a live range in 'zone' that covers 'hash'?  If 'optout' is
+ * not NULL, set it to whether that range has the opt-out flag.
+ */
+static bool
+zone_covers(const nsec3zone_t *zone, const unsigned char *hash,
+	    isc_stdtime_t now, bool *optout) {
+	const nsec3range_t *range = NULL;
+	int pos;
+
+	if (zone->count == 0) {
+		return (false);
+	}
+
+	/*
+	 * The range that covers 'hash' is the one with the closest
+	 * owner below it, or if there is none, the last range, which
+	 * wraps around from the end of the chain to its start.
+	 */
+	pos = zone_search(zone, hash);
+	range = &zone->ranges[pos >= 0 ? pos : (int)zone->count - 1];
+	if (range->expire <= now) {
+		return (false);
+	}
+
+	if (memcmp(range->owner, range->next, NSEC3INDEX_HASHLEN) < 0) {
+		if (memcmp(range->owner, hash, NSEC3INDEX_HASHLEN) >= 0 ||
+		    memcmp(hash, range->next, NSEC3INDEX_HASHLEN) >= 0)
+		{
+			return (false);
+		}
+	} else if (memcmp(range->owner, hash, NSEC3INDEX_HASHLEN) >= 0 &&
+		   memcmp(hash, range->next, NSEC3INDEX_HASHLEN) >= 0)
+	{
+		return (false);
+	}
+
+	if (optout != NULL) {
+		*optout = range->optout;
+	}
+	return (true);
+}
+
+/*
+ * Look for a closest encloser proof for 'name' in 'zone'.
+ */
+static bool
+zone_nxdomain(const nsec3zone_t *zone, const dns_name_t *name,
+	      isc_stdtime_t now) {
+	unsigned char hash[NSEC3_MAX_HASH_LENGTH];
+	dns_fixedname_t fencloser, fnextcloser, fwild;
+	dns_name_t *encloser = NULL, *nextcloser = NULL, *wild = NULL;
+	unsigned int labels, zlabels;
+	bool optout = false;
+
+	if (!zone_hash(zone, name, hash) || zone_match(zone, hash, now) != NULL)
+	{
+		return (false);
+	}
+
+	/*
+	 * Walk up from the name to find the closest encloser: the first
+	 * ancestor that has a matching range, which must not be a
+	 * delegation or a DNAME.
+	 */
+	encloser = dns_fixedname_initname(&fencloser);
+	nextcloser = dns_fixedname_initname(&fnextcloser);
+	labels = dns_name_countlabels(name);
+	zlabels = dns_name_countlabels(zone->name);
+	dns_name_copy(name, nextcloser);
+	for (unsigned int n = labels - 1; n >= zlabels; n--) {
+		const nsec3range_t *range = NULL;
+
+		dns_name_split(name, n, NULL, encloser);
+		if (!zone_hash(zone, encloser, hash)) {
+			return (false);
+		}
+		range = zone_match(zone, hash, now);
+		if (range != NULL) {
+			if (!range_encloses(range)) {
+				return (false);
+			}
+			break;
+		}
+		if (n == zlabels) {
+			return (false);
+		}
+		dns_name_copy(encloser, nextcloser);
+	}
+
+	/*
+	 * The next closer name must be covered by a range without the
+	 * opt-out flag, or there might be an insecure delegation.
+	 */
+	if (!zone_hash(zone, nextcloser, hash) ||
+	    !zone_covers(zone, hash, now, &optout) || optout)
+	{
+		return (false);
+	}
+
+	/*
+	 * And there must be no wildcard at the closest encloser.
+	 */
+	wild = dns_fixedname_initname(&fwild);
+	if (dns_name_concatenate(dns_wildcardname, encloser, wild, NULL) !=
+		    ISC_R_SUCCESS ||
+	    !zone_hash(zone, wild, hash) || !zone_covers(zone, hash, now, NULL))
+	{
+		return (false);
+	}
+
+	return (true);
+}
+
+isc_result_t
+dns_nsec3index_nxdomain(dns_nsec3index_t *index, const dns_name_t *name,
+			isc_stdtime_t now, dns_name_t *zonename) {
+	dns_fixedname_t fsuffix;
+	dns_name_t *suffix = NULL;
+	nsec3zone_t *zone = NULL;
+	isc_result_t result = ISC_R_NOTFOUND;
+	unsigned int labels;
+
+	REQUIRE(VALID_NSEC3INDEX(index));
+	REQUIRE(ISC_MAGIC_VALID(name, DNS_NAME_MAGIC));
+	REQUIRE(zonename != NULL);
+
+	labels = dns_name_countlabels(name);
+	if (labels < 2) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	suffix = dns_fixedname_initname(&fsuffix);
+
+	RWLOCK(&index->lock, isc_rwlocktype_read);
+	if (index->count == 0) {
+		goto unlock;
+	}
+
+	/*
+	 * Find the deepest zone enclosing the name that we know ranges
+	 * for; the name itself may be a zone apex, which exists.
+	 */
+	for (unsigned int n = labels - 1; n > 0; n--) {
+		dns_name_split(name, n, NULL, suffix);
+		if (isc_ht_find(index->zones, suffix->ndata, suffix->length,
+				(void **)&zone) == ISC_R_SUCCESS)
+		{
+			break;
+		}
+		zone = NULL;
+	}
+
+	if (zone != NULL && zone_nxdomain(zone, name, now)) {
+		dns_name_copy(zone->name, zonename);
+		result = ISC_R_SUCCESS;
+	}
+
+unlock:
+	RWUNLOCK(&index->lock, isc_rwlocktype_read);
+	return (result);
+}
+
+void
+dns_nsec3index_flush(dns_nsec3index_t *index) {
+	REQUIRE(VALID_NSEC3INDEX(index));
+
+	RWLOCK(&index->lock, isc_rwlocktype_write);
+	flush(index, NULL, false);
+	RWUNLOCK(&index->lock, isc_rwlocktype_write);
+}
+
+void
+dns_nsec3index_flushname(dns_nsec3index_t *index, const dns_name_t *name,
+			 bool tree) {
+	REQUIRE(VALID_NSEC3INDEX(index));
+	REQUIRE(ISC_MAGIC_VALID(name, DNS_NAME_MAGIC));
+
+	RWLOCK(&index->lock, isc_rwlocktype_write);
+	flush(index, name, tree);
+	RWUNLOCK(&index->lock, isc_rwlocktype_write);
+}
+
+unsigned int
+dns_nsec3index_count(dns_nsec3index_t *index) {
+	unsigned int count;
+
+	REQUIRE(VALID_NSEC3INDEX(index));
+
+	RWLOCK(&index->lock, isc_rwlocktype_read);
+	count = index->count;
+	RWUNLOCK(&index->lock, isc_rwlocktype_read);
+
+	return (count);
+}
@@ -22,6 +22,7 @@
 #include <isc/loop.h>
 #include <isc/mem.h>
 #include <isc/print.h>
+#include <isc/rcu.h>
 #include <isc/result.h>
 #include <isc/rwlock.h>
 #include <isc/string.h>
@@ -40,6 +41,8 @@
 #include <dns/resolver.h>
 #include <dns/time.h>
 
+#include "namesnap_p.h"
+
 struct dns_nta {
 	unsigned int magic;
 	isc_refcount_t refcount;
@@ -101,6 +104,20 @@ free_nta(void *data, void *arg) {
 	nta_detach(mctx, &nta);
 }
 
+static uint32_t
+nta_expiry(void *data) {
+	return (((dns_nta_t *)data)->expiry);
+}
+
+/*
+ * Copy the names and expiry times of the NTAs for lookups from loop
+ * threads.  Caller must hold a write lock on rwlock.
+ */
+static void
+updatesnaps(dns_ntatable_t *ntatable) {
+	dns__namesnaps_update(ntatable->snaps, ntatable->table, nta_expiry);
+}
+
 isc_result_t
 dns_ntatable_create(dns_view_t *view, isc_taskmgr_t *taskmgr,
 		    isc_loopmgr_t *loopmgr, dns_ntatable_t **ntatablep) {
@@ -127,6 +144,9 @@ dns_ntatable_create(dns_view_t *view, isc_taskmgr_t *taskmgr,
 
 	isc_rwlock_init(&ntatable->rwlock, 0, 0);
 
+	ntatable->snaps = NULL;
+	dns__namesnaps_create(view->mctx, &ntatable->snaps);
+
 	ntatable->shuttingdown = false;
 	ntatable->loopmgr = loopmgr;
 	ntatable->taskmgr = taskmgr;
@@ -169,6 +189,7 @@ dns_ntatable_detach(dns_ntatable_t **ntatablep) {
 
 	if (isc_refcount_decrement(&ntatable->references) == 1) {
 		dns_rbt_destroy(&ntatable->table);
+		dns__namesnaps_destroy(&ntatable->snaps);
 		isc_rwlock_destroy(&ntatable->rwlock);
 		isc_refcount_destroy(&ntatable->references);
 		if (ntatable->task != NULL) {
@@ -222,6 +243,7 @@ fetch_done(isc_task_t *task, isc_event_t *event) {
 		RWLOCK(&ntatable->rwlock, isc_rwlocktype_write);
 		if (nta->expiry > now) {
 			nta->expiry = now;
+			updatesnaps(ntatable);
 		}
 		RWUNLOCK(&ntatable->rwlock, isc_rwlocktype_write);
 		break;
@@ -378,6 +400,9 @@ dns_ntatable_add(dns_ntatable_t *ntatable, const dns_name_t *name, bool force,
 		}
 		result = ISC_R_SUCCESS;
 	}
+	if (result == ISC_R_SUCCESS) {
+		updatesnaps(ntatable);
+	}
 
 unlock:
 	RWUNLOCK(&ntatable->rwlock, isc_rwlocktype_write);
@@ -406,6 +431,7 @@ deletenode(dns_ntatable_t *ntatable, const dns_name_t *name) {
 		if (node->data != NULL) {
 			result = dns_rbt_deletenode(ntatable->table, node,
 						    false);
+			updatesnaps(ntatable);
 		} else {
 			result = ISC_R_NOTFOUND;
 		}
@@ -447,6 +473,29 @@ dns_ntatable_covered(dns_ntatable_t *ntatable, isc_stdtime_t now,
 
 	foundname = dns_fixedname_initname(&fn);
 
+	/*
+	 * Loop threads look in the copy of the NTAs rather than in the
+	 * rbt, without locking.  An expired NTA is left for the locked
+	 * lookup below to delete.
+	 */
+	if (isc_rcu_available()) {
+		isc_stdtime_t expiry = 0;
+
+		if (!dns__namesnaps_find(ntatable->snaps, name, foundname,
+					 &expiry))
+		{
+			return (false);
+		}
+		if (!dns_name_equal(foundname, name) &&
+		    !dns_name_issubdomain(foundname, anchor))
+		{
+			return (false);
+		}
+		if (expiry > now) {
+			return (true);
+		}
+	}
+
 relock:
 	RWLOCK(&ntatable->rwlock, locktype);
 again:
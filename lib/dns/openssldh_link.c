@@ -1279,6 +1279,7 @@ static dst_func_t openssldh_functions = {
 	NULL, /*%< fromlabel */
 	NULL, /*%< dump */
 	NULL, /*%< restore */
+	NULL, /*%< verifybatch */
 };
 
 isc_result_t
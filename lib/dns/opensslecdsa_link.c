@@ -406,6 +406,86 @@ err:
 	return (ret);
 }
 
+/*
+ * Append the DER encoding of the unsigned big-endian integer 'len'
+ * bytes long at 'bytes' to 'der', and return the end of the encoding.
+ */
+static unsigned char *
+ecdsa_derinteger(unsigned char *der, const unsigned char *bytes, size_t len) {
+	while (len > 1 && bytes[0] == 0) {
+		bytes++;
+		len--;
+	}
+
+	*der++ = 0x02;
+	if ((bytes[0] & 0x80) != 0) {
+		*der++ = (unsigned char)(len + 1);
+		*der++ = 0;
+	} else {
+		*der++ = (unsigned char)len;
+	}
+	memmove(der, bytes, len);
+
+	return (der + len);
+}
+
+/*
+ * OpenSSL has no batch verification for ECDSA, so the signatures are
+ * checked one by one, but they are converted to DER in place instead
+ * of going through an ECDSA_SIG and two bignums for each of them.
+ */
+static void
+opensslecdsa_verifybatch(dst_context_t **dctxs, const isc_region_t *sigs,
+			 isc_result_t *results, unsigned int n) {
+	/* SEQUENCE of two INTEGERs, each possibly with a leading zero */
+	unsigned char der[2 + 2 * (3 + DNS_SIG_ECDSA384SIZE / 2)];
+
+	for (unsigned int i = 0; i < n; i++) {
+		dst_context_t *dctx = dctxs[i];
+		dst_key_t *key = dctx->key;
+		unsigned char *cp = NULL;
+		size_t siglen;
+		int status;
+
+		REQUIRE(key->key_alg == DST_ALG_ECDSA256 ||
+			key->key_alg == DST_ALG_ECDSA384);
+		REQUIRE(dctx->use == DO_VERIFY);
+
+		if (key->key_alg == DST_ALG_ECDSA256) {
+			siglen = DNS_SIG_ECDSA256SIZE;
+		} else {
+			siglen = DNS_SIG_ECDSA384SIZE;
+		}
+
+		if (sigs[i].length != siglen) {
+			results[i] = DST_R_VERIFYFAILURE;
+			continue;
+		}
+
+		cp = ecdsa_derinteger(der + 2, sigs[i].base, siglen / 2);
+		cp = ecdsa_derinteger(cp, sigs[i].base + siglen / 2,
+				      siglen / 2);
+		der[0] = 0x30;
+		der[1] = (unsigned char)(cp - der - 2);
+
+		status = EVP_DigestVerifyFinal(dctx->ctxdata.evp_md_ctx, der,
+					       cp - der);
+		switch (status) {
+		case 1:
+			results[i] = ISC_R_SUCCESS;
+			break;
+		case 0:
+			results[i] = dst__openssl_toresult(DST_R_VERIFYFAILURE);
+			break;
+		default:
+			results[i] = dst__openssl_toresult3(
+				dctx->category, "EVP_DigestVerifyFinal",
+				DST_R_VERIFYFAILURE);
+			break;
+		}
+	}
+}
+
 static bool
 opensslecdsa_compare(const dst_key_t *key1, const dst_key_t *key2) {
 	bool ret;
@@ -1482,6 +1562,7 @@ static dst_func_t opensslecdsa_functions = {
 	opensslecdsa_fromlabel, /*%< fromlabel */
 	NULL,			/*%< dump */
 	NULL,			/*%< restore */
+	opensslecdsa_verifybatch,
 };
 
 isc_result_t
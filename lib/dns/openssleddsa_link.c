@@ -272,6 +272,88 @@ err:
 	return (ret);
 }
 
+/*
+ * OpenSSL has no batch verification for EdDSA, so the signatures are
+ * checked one by one, but with a single message digest context that is
+ * reset between them instead of being allocated for each signature.
+ */
+static void
+openssleddsa_verifybatch(dst_context_t **dctxs, const isc_region_t *sigs,
+			 isc_result_t *results, unsigned int n) {
+	EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+
+	for (unsigned int i = 0; i < n; i++) {
+		dst_context_t *dctx = dctxs[i];
+		dst_key_t *key = dctx->key;
+		isc_buffer_t *buf = (isc_buffer_t *)dctx->ctxdata.generic;
+		unsigned int siglen = 0;
+		isc_region_t tbsreg;
+		int status;
+
+		REQUIRE(key->key_alg == DST_ALG_ED25519 ||
+			key->key_alg == DST_ALG_ED448);
+
+		if (ctx == NULL) {
+			results[i] = ISC_R_NOMEMORY;
+			continue;
+		}
+
+#if HAVE_OPENSSL_ED25519
+		if (key->key_alg == DST_ALG_ED25519) {
+			siglen = DNS_SIG_ED25519SIZE;
+		}
+#endif /* if HAVE_OPENSSL_ED25519 */
+#if HAVE_OPENSSL_ED448
+		if (key->key_alg == DST_ALG_ED448) {
+			siglen = DNS_SIG_ED448SIZE;
+		}
+#endif /* if HAVE_OPENSSL_ED448 */
+		if (siglen == 0) {
+			results[i] = ISC_R_NOTIMPLEMENTED;
+			continue;
+		}
+
+		if (sigs[i].length != siglen) {
+			results[i] = DST_R_VERIFYFAILURE;
+			continue;
+		}
+
+		isc_buffer_usedregion(buf, &tbsreg);
+
+		if (EVP_DigestVerifyInit(ctx, NULL, NULL, NULL,
+					 key->keydata.pkey) != 1)
+		{
+			results[i] = dst__openssl_toresult3(
+				dctx->category, "EVP_DigestVerifyInit",
+				ISC_R_FAILURE);
+			EVP_MD_CTX_reset(ctx);
+			continue;
+		}
+
+		status = EVP_DigestVerify(ctx, sigs[i].base, siglen,
+					  tbsreg.base, tbsreg.length);
+		switch (status) {
+		case 1:
+			results[i] = ISC_R_SUCCESS;
+			break;
+		case 0:
+			results[i] = dst__openssl_toresult(DST_R_VERIFYFAILURE);
+			break;
+		default:
+			results[i] = dst__openssl_toresult3(
+				dctx->category, "EVP_DigestVerify",
+				DST_R_VERIFYFAILURE);
+			break;
+		}
+
+		EVP_MD_CTX_reset(ctx);
+	}
+
+	if (ctx != NULL) {
+		EVP_MD_CTX_free(ctx);
+	}
+}
+
 static bool
 openssleddsa_compare(const dst_key_t *key1, const dst_key_t *key2) {
 	int status;
@@ -686,6 +768,7 @@ static dst_func_t openssleddsa_functions = {
 	openssleddsa_fromlabel,
 	NULL, /*%< dump */
 	NULL, /*%< restore */
+	openssleddsa_verifybatch,
 };
 
 isc_result_t
@@ -1560,6 +1560,7 @@ static dst_func_t opensslrsa_functions = {
 	opensslrsa_fromlabel,
 	NULL, /*%< dump */
 	NULL, /*%< restore */
+	NULL, /*%< verifybatch */
 };
 
 /*
@@ -14,7 +14,9 @@
 /*! \file */
 
 #include <stdbool.h>
+#include <string.h>
 
+#include <isc/ht.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
 #include <isc/refcount.h>
@@ -33,16 +35,33 @@ struct dns_order_ent {
 	dns_rdataclass_t rdclass;
 	dns_rdatatype_t rdtype;
 	unsigned int mode;
+	unsigned int position;
+	dns_order_ent_t *next; /*%< Next entry with the same index key */
 	ISC_LINK(dns_order_ent_t) link;
 };
 
+/*
+ * The entries are also indexed by name, so that a lookup costs one hash
+ * lookup per label of the name looked up rather than a comparison per
+ * entry.
+ */
 struct dns_order {
 	unsigned int magic;
 	isc_refcount_t references;
 	ISC_LIST(dns_order_ent_t) ents;
+	unsigned int nents;
+	isc_ht_t *index;
 	isc_mem_t *mctx;
 };
 
+/*%
+ * Up to this many entries, a linear search is cheaper than the index.
+ */
+#define ORDER_LINEAR 4
+
+#define KEY_EXACT    0
+#define KEY_WILDCARD 1
+
 #define DNS_ORDER_MAGIC	       ISC_MAGIC('O', 'r', 'd', 'r')
 #define DNS_ORDER_VALID(order) ISC_MAGIC_VALID(order, DNS_ORDER_MAGIC)
 
@@ -59,6 +78,10 @@ dns_order_create(isc_mem_t *mctx, dns_order_t **orderp) {
 	/* Implicit attach. */
 	isc_refcount_init(&order->references, 1);
 
+	order->nents = 0;
+	order->index = NULL;
+	isc_ht_init(&order->index, mctx, 4, ISC_HT_CASE_SENSITIVE);
+
 	order->mctx = NULL;
 	isc_mem_attach(mctx, &order->mctx);
 	order->magic = DNS_ORDER_MAGIC;
@@ -66,11 +89,32 @@ dns_order_create(isc_mem_t *mctx, dns_order_t **orderp) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Make an index key in 'key': 'kind', followed by 'name' in lower case.
+ * Return the length of the key.
+ */
+static unsigned int
+order_key(const dns_name_t *name, unsigned char kind, unsigned char *key) {
+	dns_fixedname_t fixed;
+	dns_name_t *lower = dns_fixedname_initname(&fixed);
+	isc_region_t r;
+
+	key[0] = kind;
+	(void)dns_name_downcase(name, lower, NULL);
+	dns_name_toregion(lower, &r);
+	memmove(key + 1, r.base, r.length);
+	return (r.length + 1);
+}
+
 isc_result_t
 dns_order_add(dns_order_t *order, const dns_name_t *name,
 	      dns_rdatatype_t rdtype, dns_rdataclass_t rdclass,
 	      unsigned int mode) {
 	dns_order_ent_t *ent;
+	unsigned char key[DNS_NAME_MAXWIRE + 1];
+	unsigned int keysize;
+	void *value = NULL;
+	dns_name_t suffix;
 
 	REQUIRE(DNS_ORDER_VALID(order));
 	REQUIRE(mode == DNS_RDATASETATTR_RANDOMIZE ||
@@ -85,8 +129,33 @@ dns_order_add(dns_order_t *order, const dns_name_t *name,
 	ent->rdtype = rdtype;
 	ent->rdclass = rdclass;
 	ent->mode = mode;
+	ent->position = order->nents++;
+	ent->next = NULL;
 	ISC_LINK_INIT(ent, link);
 	ISC_LIST_INITANDAPPEND(order->ents, ent, link);
+
+	/*
+	 * A wildcard entry is indexed by the name it is the wildcard of.
+	 */
+	if (dns_name_iswildcard(name)) {
+		dns_name_init(&suffix, NULL);
+		dns_name_getlabelsequence(name, 1,
+					  dns_name_countlabels(name) - 1,
+					  &suffix);
+		keysize = order_key(&suffix, KEY_WILDCARD, key);
+	} else {
+		keysize = order_key(name, KEY_EXACT, key);
+	}
+	if (isc_ht_find(order->index, key, keysize, &value) == ISC_R_SUCCESS) {
+		dns_order_ent_t *last = value;
+		while (last->next != NULL) {
+			last = last->next;
+		}
+		last->next = ent;
+	} else {
+		RUNTIME_CHECK(isc_ht_add(order->index, key, keysize, ent) ==
+			      ISC_R_SUCCESS);
+	}
 	return (ISC_R_SUCCESS);
 }
 
@@ -98,27 +167,84 @@ match(const dns_name_t *name1, const dns_name_t *name2) {
 	return (dns_name_equal(name1, name2));
 }
 
+static bool
+typematch(const dns_order_ent_t *ent, dns_rdatatype_t rdtype,
+	  dns_rdataclass_t rdclass) {
+	if (ent->rdtype != rdtype && ent->rdtype != dns_rdatatype_any) {
+		return (false);
+	}
+	if (ent->rdclass != rdclass && ent->rdclass != dns_rdataclass_any) {
+		return (false);
+	}
+	return (true);
+}
+
+/*
+ * Return the first entry indexed under 'key' that applies to 'rdtype'
+ * and 'rdclass'.
+ */
+static dns_order_ent_t *
+index_find(dns_order_t *order, const unsigned char *key,
+	   unsigned int keysize, dns_rdatatype_t rdtype,
+	   dns_rdataclass_t rdclass) {
+	void *value = NULL;
+
+	if (isc_ht_find(order->index, key, keysize, &value) != ISC_R_SUCCESS) {
+		return (NULL);
+	}
+	for (dns_order_ent_t *ent = value; ent != NULL; ent = ent->next) {
+		if (typematch(ent, rdtype, rdclass)) {
+			return (ent);
+		}
+	}
+	return (NULL);
+}
+
 unsigned int
 dns_order_find(dns_order_t *order, const dns_name_t *name,
 	       dns_rdatatype_t rdtype, dns_rdataclass_t rdclass) {
-	dns_order_ent_t *ent;
+	dns_order_ent_t *ent, *best;
+	unsigned char key[DNS_NAME_MAXWIRE + 1];
+	unsigned int keysize;
+
 	REQUIRE(DNS_ORDER_VALID(order));
 
-	for (ent = ISC_LIST_HEAD(order->ents); ent != NULL;
-	     ent = ISC_LIST_NEXT(ent, link))
-	{
-		if (ent->rdtype != rdtype && ent->rdtype != dns_rdatatype_any) {
-			continue;
+	if (order->nents <= ORDER_LINEAR) {
+		for (ent = ISC_LIST_HEAD(order->ents); ent != NULL;
+		     ent = ISC_LIST_NEXT(ent, link))
+		{
+			if (typematch(ent, rdtype, rdclass) &&
+			    match(name, dns_fixedname_name(&ent->name)))
+			{
+				return (ent->mode);
+			}
 		}
-		if (ent->rdclass != rdclass &&
-		    ent->rdclass != dns_rdataclass_any) {
-			continue;
-		}
-		if (match(name, dns_fixedname_name(&ent->name))) {
-			return (ent->mode);
+		return (DNS_RDATASETATTR_NONE);
+	}
+
+	/*
+	 * The entries that can match are those for 'name' itself and
+	 * the wildcards of its ancestors; the first one added wins.
+	 */
+	keysize = order_key(name, KEY_EXACT, key);
+	best = index_find(order, key, keysize, rdtype, rdclass);
+
+	for (unsigned int pos = 1; pos < keysize && key[pos] != 0;) {
+		unsigned char wkey[DNS_NAME_MAXWIRE + 1];
+
+		pos += key[pos] + 1;
+		wkey[0] = KEY_WILDCARD;
+		memmove(wkey + 1, key + pos, keysize - pos);
+		ent = index_find(order, wkey, keysize - pos + 1, rdtype,
+				 rdclass);
+		if (ent != NULL &&
+		    (best == NULL || ent->position < best->position))
+		{
+			best = ent;
 		}
 	}
-	return (DNS_RDATASETATTR_NONE);
+
+	return (best != NULL ? best->mode : DNS_RDATASETATTR_NONE);
 }
 
 void
@@ -139,6 +265,7 @@ dns_order_detach(dns_order_t **orderp) {
 	if (isc_refcount_decrement(&order->references) == 1) {
 		isc_refcount_destroy(&order->references);
 		order->magic = 0;
+		isc_ht_destroy(&order->index);
 		dns_order_ent_t *ent;
 		while ((ent = ISC_LIST_HEAD(order->ents)) != NULL) {
 			ISC_LIST_UNLINK(order->ents, ent, link);
@@ -0,0 +1,503 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/atomic.h>
+#include <isc/hash.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/random.h>
+#include <isc/refcount.h>
+#include <isc/serial.h>
+#include <isc/timer.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/prefetch.h>
+#include <dns/rdataset.h>
+#include <dns/resolver.h>
+#include <dns/stats.h>
+#include <dns/view.h>
+
+#define PREFETCH_MAGIC	  ISC_MAGIC('P', 'f', 'c', 'h')
+#define VALID_PREFETCH(p) ISC_MAGIC_VALID(p, PREFETCH_MAGIC)
+
+/*%
+ * Number of rows of the count-min sketch, and minimum number of
+ * counters in each row.
+ */
+#define PREFETCH_DEPTH	  4
+#define PREFETCH_MINWIDTH 1024
+
+/*%
+ * Minimum number of answers before a name enters the table, and the
+ * table is only updated every PREFETCH_SAMPLE answers for a given name
+ * so that the most popular names do not contend for its lock.
+ */
+#define PREFETCH_MINHITS 8
+#define PREFETCH_SAMPLE	 8
+
+/*%
+ * The scheduler runs PREFETCH_TICKS times a second, and halves all
+ * the counts every PREFETCH_DECAY seconds.
+ */
+#define PREFETCH_TICKS 10
+#define PREFETCH_DECAY 60
+
+typedef struct entry {
+	dns_prefetch_t *prefetch;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_rdatatype_t type;
+	uint64_t hash;
+	uint32_t hits;
+	isc_stdtime_t expire;
+	isc_stdtime_t refresh;
+	dns_fetch_t *fetch;
+	dns_rdataset_t rdataset;
+} entry_t;
+
+struct dns_prefetch {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	isc_refcount_t references;
+	dns_view_t *view;
+	isc_task_t *task;
+	isc_timer_t *timer;
+	unsigned int rate;
+	dns_ttl_t lead;
+	dns_ttl_t eligible;
+
+	/* Lock-free. */
+	unsigned int width;
+	atomic_uint_fast32_t *sketch;
+	atomic_uint_fast32_t threshold;
+	atomic_bool shuttingdown;
+
+	/* Locked by lock. */
+	isc_mutex_t lock;
+	unsigned int size;
+	unsigned int count;
+	unsigned int cursor;
+	unsigned int tokens;
+	isc_stdtime_t lastdecay;
+	entry_t *entries;
+};
+
+static void
+prefetch_tick(void *arg);
+
+void
+dns_prefetch_create(dns_view_t *view, isc_loopmgr_t *loopmgr,
+		    isc_taskmgr_t *taskmgr, unsigned int size,
+		    unsigned int rate, dns_prefetch_t **prefetchp) {
+	dns_prefetch_t *prefetch = NULL;
+	unsigned int width = PREFETCH_MINWIDTH;
+	isc_interval_t interval;
+	isc_result_t result;
+
+	REQUIRE(DNS_VIEW_VALID(view) && view->resolver != NULL);
+	REQUIRE(size > 0 && rate > 0);
+	REQUIRE(prefetchp != NULL && *prefetchp == NULL);
+
+	/*
+	 * With about 16 counters per tracked name, the estimates of the
+	 * names worth tracking are seldom inflated by collisions.
+	 */
+	while (width < size * 16 && width < (1U << 24)) {
+		width <<= 1;
+	}
+
+	prefetch = isc_mem_get(view->mctx, sizeof(*prefetch));
+	*prefetch = (dns_prefetch_t){
+		.view = view,
+		.rate = rate,
+		.lead = ISC_MAX(view->prefetch_trigger, 2),
+		.width = width,
+		.size = size,
+	};
+	prefetch->eligible = ISC_MAX(view->prefetch_eligible,
+				     2 * prefetch->lead);
+
+	isc_mem_attach(view->mctx, &prefetch->mctx);
+	isc_refcount_init(&prefetch->references, 1);
+	isc_mutex_init(&prefetch->lock);
+	atomic_init(&prefetch->threshold, PREFETCH_MINHITS);
+	atomic_init(&prefetch->shuttingdown, false);
+	isc_stdtime_get(&prefetch->lastdecay);
+
+	prefetch->sketch = isc_mem_get(prefetch->mctx,
+				       PREFETCH_DEPTH * width *
+					       sizeof(prefetch->sketch[0]));
+	for (size_t i = 0; i < PREFETCH_DEPTH * width; i++) {
+		atomic_init(&prefetch->sketch[i], 0);
+	}
+
+	prefetch->entries = isc_mem_get(prefetch->mctx,
+					size * sizeof(prefetch->entries[0]));
+	for (size_t i = 0; i < size; i++) {
+		entry_t *entry = &prefetch->entries[i];
+
+		*entry = (entry_t){ .prefetch = prefetch };
+		entry->name = dns_fixedname_initname(&entry->fixed);
+		dns_rdataset_init(&entry->rdataset);
+	}
+
+	result = isc_task_create(taskmgr, &prefetch->task, 0);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	isc_task_setname(prefetch->task, "prefetch", prefetch);
+
+	isc_timer_create(isc_loop_main(loopmgr), prefetch_tick, prefetch,
+			 &prefetch->timer);
+	isc_interval_set(&interval, 0, 1000000000 / PREFETCH_TICKS);
+	isc_timer_start(prefetch->timer, isc_timertype_ticker, &interval);
+
+	prefetch->magic = PREFETCH_MAGIC;
+	*prefetchp = prefetch;
+}
+
+static void
+prefetch_destroy(dns_prefetch_t *prefetch) {
+	prefetch->magic = 0;
+
+	INSIST(prefetch->timer == NULL);
+	for (size_t i = 0; i < prefetch->count; i++) {
+		INSIST(prefetch->entries[i].fetch == NULL);
+	}
+
+	isc_task_detach(&prefetch->task);
+	isc_mem_put(prefetch->mctx, prefetch->entries,
+		    prefetch->size * sizeof(prefetch->entries[0]));
+	isc_mem_put(prefetch->mctx, prefetch->sketch,
+		    PREFETCH_DEPTH * prefetch->width *
+			    sizeof(prefetch->sketch[0]));
+	isc_mutex_destroy(&prefetch->lock);
+	isc_refcount_destroy(&prefetch->references);
+	isc_mem_putanddetach(&prefetch->mctx, prefetch, sizeof(*prefetch));
+}
+
+void
+dns_prefetch_detach(dns_prefetch_t **prefetchp) {
+	dns_prefetch_t *prefetch = NULL;
+
+	REQUIRE(prefetchp != NULL && VALID_PREFETCH(*prefetchp));
+
+	prefetch = *prefetchp;
+	*prefetchp = NULL;
+
+	if (isc_refcount_decrement(&prefetch->references) == 1) {
+		prefetch_destroy(prefetch);
+	}
+}
+
+void
+dns_prefetch_shutdown(dns_prefetch_t *prefetch) {
+	REQUIRE(VALID_PREFETCH(prefetch));
+
+	if (atomic_exchange(&prefetch->shuttingdown, true)) {
+		return;
+	}
+
+	LOCK(&prefetch->lock);
+	for (size_t i = 0; i < prefetch->count; i++) {
+		if (prefetch->entries[i].fetch != NULL) {
+			dns_resolver_cancelfetch(prefetch->entries[i].fetch);
+		}
+	}
+	UNLOCK(&prefetch->lock);
+
+	isc_timer_stop(prefetch->timer);
+	isc_timer_destroy(&prefetch->timer);
+}
+
+static uint64_t
+prefetch_hash(const dns_name_t *name, dns_rdatatype_t type) {
+	uint64_t hash = isc_hash64(name->ndata, name->length, false);
+
+	return (hash ^ ((uint64_t)type * 0x9e3779b97f4a7c15ULL));
+}
+
+/*
+ * Choose when to refresh an RRset expiring 'ttl' seconds after 'now':
+ * a random time between 'lead' and four times 'lead' seconds before it
+ * expires, not earlier than half its TTL.  RRsets whose TTL is too
+ * short to be worth it are left to the reactive prefetch.
+ */
+static void
+entry_setexpire(dns_prefetch_t *prefetch, entry_t *entry, dns_ttl_t ttl,
+		isc_stdtime_t now) {
+	dns_ttl_t lead = prefetch->lead;
+	dns_ttl_t window;
+
+	entry->expire = now + ttl;
+	if (ttl < prefetch->eligible) {
+		entry->refresh = 0;
+		return;
+	}
+
+	window = ISC_MIN(ttl / 2, 4 * lead) - lead;
+	entry->refresh = entry->expire - lead - isc_random_uniform(window + 1);
+}
+
+void
+dns_prefetch_record(dns_prefetch_t *prefetch, const dns_name_t *name,
+		    dns_rdatatype_t type, dns_ttl_t ttl, isc_stdtime_t now) {
+	uint64_t hash;
+	uint32_t h1, h2, estimate = UINT32_MAX;
+	entry_t *entry = NULL, *victim = NULL;
+	uint32_t minhits = UINT32_MAX;
+
+	REQUIRE(VALID_PREFETCH(prefetch));
+	REQUIRE(dns_name_isabsolute(name));
+
+	if (atomic_load_relaxed(&prefetch->shuttingdown)) {
+		return;
+	}
+
+	/*
+	 * Count the answer in each row of the sketch; the smallest of
+	 * the counters is the closest to the actual count.
+	 */
+	hash = prefetch_hash(name, type);
+	h1 = (uint32_t)hash;
+	h2 = (uint32_t)(hash >> 32) | 1;
+	for (uint32_t d = 0; d < PREFETCH_DEPTH; d++) {
+		uint32_t i = (h1 + d * h2) & (prefetch->width - 1);
+		uint32_t c = atomic_fetch_add_relaxed(
+				     &prefetch->sketch[d * prefetch->width + i],
+				     1) +
+			     1;
+		estimate = ISC_MIN(estimate, c);
+	}
+
+	if (estimate < atomic_load_relaxed(&prefetch->threshold) ||
+	    (estimate % PREFETCH_SAMPLE) != 0)
+	{
+		return;
+	}
+
+	LOCK(&prefetch->lock);
+	for (size_t i = 0; i < prefetch->count; i++) {
+		entry_t *e = &prefetch->entries[i];
+
+		if (e->hash == hash && e->type == type &&
+		    dns_name_equal(e->name, name))
+		{
+			entry = e;
+			break;
+		}
+		if (e->fetch == NULL && e->hits < minhits) {
+			victim = e;
+			minhits = e->hits;
+		}
+	}
+
+	if (entry == NULL) {
+		if (prefetch->count < prefetch->size) {
+			entry = &prefetch->entries[prefetch->count++];
+		} else if (victim != NULL && minhits < estimate) {
+			entry = victim;
+		} else {
+			goto unlock;
+		}
+		dns_name_copy(name, entry->name);
+		entry->type = type;
+		entry->hash = hash;
+		entry_setexpire(prefetch, entry, ttl, now);
+	} else if (entry->fetch == NULL &&
+		   isc_serial_gt(now + ttl, entry->expire))
+	{
+		/* The RRset was refreshed by other means. */
+		entry_setexpire(prefetch, entry, ttl, now);
+	}
+	entry->hits = estimate;
+
+	/*
+	 * Once the table is full, a name has to be more popular than
+	 * the least popular one to be added.
+	 */
+	if (prefetch->count == prefetch->size) {
+		minhits = UINT32_MAX;
+		for (size_t i = 0; i < prefetch->count; i++) {
+			minhits = ISC_MIN(minhits, prefetch->entries[i].hits);
+		}
+		atomic_store_relaxed(&prefetch->threshold,
+				     ISC_MAX(minhits, PREFETCH_MINHITS));
+	}
+
+unlock:
+	UNLOCK(&prefetch->lock);
+}
+
+/*
+ * Halve all the counts, so that names which are no longer asked for
+ * eventually make room for new ones.
+ */
+static void
+prefetch_decay(dns_prefetch_t *prefetch) {
+	uint32_t threshold;
+
+	for (size_t i = 0; i < PREFETCH_DEPTH * prefetch->width; i++) {
+		uint32_t c = atomic_load_relaxed(&prefetch->sketch[i]);
+		if (c != 0) {
+			atomic_store_relaxed(&prefetch->sketch[i], c / 2);
+		}
+	}
+	for (size_t i = 0; i < prefetch->count; i++) {
+		prefetch->entries[i].hits /= 2;
+	}
+
+	threshold = atomic_load_relaxed(&prefetch->threshold) / 2;
+	atomic_store_relaxed(&prefetch->threshold,
+			     ISC_MAX(threshold, PREFETCH_MINHITS));
+}
+
+static void
+fetch_done(isc_task_t *task, isc_event_t *event) {
+	dns_fetchevent_t *devent = (dns_fetchevent_t *)event;
+	entry_t *entry = devent->ev_arg;
+	dns_prefetch_t *prefetch = entry->prefetch;
+	dns_view_t *view = prefetch->view;
+	isc_stdtime_t now;
+
+	UNUSED(task);
+
+	isc_stdtime_get(&now);
+
+	LOCK(&prefetch->lock);
+	if (devent->result == ISC_R_SUCCESS &&
+	    dns_rdataset_isassociated(&entry->rdataset))
+	{
+		entry_setexpire(prefetch, entry, entry->rdataset.ttl, now);
+	}
+	if (dns_rdataset_isassociated(&entry->rdataset)) {
+		dns_rdataset_disassociate(&entry->rdataset);
+	}
+	INSIST(entry->fetch == devent->fetch);
+	entry->fetch = NULL;
+	UNLOCK(&prefetch->lock);
+
+	dns_resolver_destroyfetch(&devent->fetch);
+	if (devent->node != NULL) {
+		dns_db_detachnode(devent->db, &devent->node);
+	}
+	if (devent->db != NULL) {
+		dns_db_detach(&devent->db);
+	}
+	isc_event_free(&event);
+
+	dns_prefetch_detach(&prefetch);
+	dns_view_weakdetach(&view);
+}
+
+static isc_result_t
+entry_fetch(dns_prefetch_t *prefetch, entry_t *entry) {
+	dns_view_t *view = NULL;
+	isc_result_t result;
+
+	isc_refcount_increment(&prefetch->references);
+	dns_view_weakattach(prefetch->view, &view);
+
+	result = dns_resolver_createfetch(
+		view->resolver, entry->name, entry->type, NULL, NULL, NULL,
+		NULL, 0, DNS_FETCHOPT_PREFETCH, 0, NULL, prefetch->task,
+		fetch_done, entry, &entry->rdataset, NULL, &entry->fetch);
+	if (result != ISC_R_SUCCESS) {
+		dns_view_weakdetach(&view);
+		INSIST(isc_refcount_decrement(&prefetch->references) > 1);
+		return (result);
+	}
+
+	dns_resolver_incstats(view->resolver,
+			      dns_resstatscounter_prefetchpopular);
+	return (ISC_R_SUCCESS);
+}
+
+static void
+prefetch_tick(void *arg) {
+	dns_prefetch_t *prefetch = arg;
+	isc_stdtime_t now;
+	unsigned int n;
+
+	REQUIRE(VALID_PREFETCH(prefetch));
+
+	if (atomic_load_relaxed(&prefetch->shuttingdown)) {
+		return;
+	}
+
+	isc_stdtime_get(&now);
+
+	LOCK(&prefetch->lock);
+	if (atomic_load_relaxed(&prefetch->shuttingdown)) {
+		goto unlock;
+	}
+
+	if (now - prefetch->lastdecay >= PREFETCH_DECAY) {
+		prefetch_decay(prefetch);
+		prefetch->lastdecay = now;
+	}
+
+	/*
+	 * The budget is counted in tenths of a refresh; it grows by
+	 * 'rate' every tick and can hold a single tick's worth, so that
+	 * refreshes are spread over the ticks rather than sent in bursts.
+	 */
+	prefetch->tokens = ISC_MIN(prefetch->tokens + prefetch->rate,
+				   prefetch->rate + PREFETCH_TICKS);
+
+	/*
+	 * Go round the table, so that refreshes which had to wait are
+	 * the first to be sent on the next tick.
+	 */
+	for (n = 0; n < prefetch->count && prefetch->tokens >= PREFETCH_TICKS;
+	     n++)
+	{
+		unsigned int i = (prefetch->cursor + n) % prefetch->count;
+		entry_t *entry = &prefetch->entries[i];
+
+		/*
+		 * Names that are no longer asked for stop being
+		 * refreshed once their count has decayed.
+		 */
+		if (entry->fetch != NULL || entry->refresh == 0 ||
+		    entry->hits < PREFETCH_MINHITS ||
+		    isc_serial_gt(entry->refresh, now))
+		{
+			continue;
+		}
+
+		/*
+		 * Whatever happens, a new expiration time has to be
+		 * learned before the RRset is refreshed again.
+		 */
+		entry->refresh = 0;
+		if (isc_serial_le(entry->expire, now)) {
+			continue;
+		}
+		if (entry_fetch(prefetch, entry) == ISC_R_SUCCESS) {
+			prefetch->tokens -= PREFETCH_TICKS;
+		}
+	}
+	if (prefetch->count > 0) {
+		prefetch->cursor = (prefetch->cursor + n) % prefetch->count;
+	}
+
+unlock:
+	UNLOCK(&prefetch->lock);
+}
@@ -0,0 +1,730 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <isc/ascii.h>
+#include <isc/atomic.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/result.h>
+#include <isc/util.h>
+
+#include <dns/name.h>
+#include <dns/qp.h>
+
+#define QP_MAGIC    ISC_MAGIC('Q', 'P', 'T', 'r')
+#define VALID_QP(q) ISC_MAGIC_VALID(q, QP_MAGIC)
+
+/*
+ * Key elements.  Past the end of a key every element reads as NOBYTE,
+ * so a key sorts before any longer key it is a prefix of; SEPARATOR ends
+ * each label, so a label sorts before any longer label it is a prefix
+ * of; each byte of a label becomes two elements, high nibble first.
+ */
+#define NOBYTE	  0
+#define SEPARATOR 1
+#define NIBBLE(n) ((n) + 2)
+
+/*
+ * Returned by keydiff() when the keys are equal.
+ */
+#define NODIFF SIZE_MAX
+
+/*
+ * The root node is kept in an array of its own, so that a writer can
+ * replace it with a single pointer store; it is NULL when the trie is
+ * empty.
+ */
+struct dns_qp {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	dns_qpmakekey_t makekey;
+	dns_qpretire_t retire;
+	void *uctx;
+	unsigned int count;
+	atomic_uintptr_t root;
+};
+
+static inline bool
+isbranch(const dns_qpnode_t *n) {
+	return (n->bitmap != 0);
+}
+
+static inline dns_qpnode_t *
+getroot(dns_qp_t *qp) {
+	return ((dns_qpnode_t *)atomic_load_acquire(&qp->root));
+}
+
+static inline unsigned int
+popcount(uint32_t x) {
+	x = x - ((x >> 1) & 0x55555555);
+	x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+	x = (x + (x >> 4)) & 0x0f0f0f0f;
+	return ((x * 0x01010101) >> 24);
+}
+
+static inline uint8_t
+keyelem(const uint8_t *key, size_t keylen, size_t offset) {
+	return (offset < keylen ? key[offset] : NOBYTE);
+}
+
+static inline uint32_t
+twigbit(const dns_qpnode_t *n, const uint8_t *key, size_t keylen) {
+	return (1U << keyelem(key, keylen, n->offset));
+}
+
+static inline unsigned int
+twigcount(const dns_qpnode_t *n) {
+	return (popcount(n->bitmap));
+}
+
+static inline unsigned int
+twigpos(const dns_qpnode_t *n, uint32_t bit) {
+	return (popcount(n->bitmap & (bit - 1)));
+}
+
+static inline dns_qpnode_t *
+twigs(const dns_qpnode_t *n) {
+	return (n->ptr);
+}
+
+static inline size_t
+leafkey(dns_qp_t *qp, const dns_qpnode_t *n, dns_qpkey_t key) {
+	return (qp->makekey(key, qp->uctx, n->ptr));
+}
+
+/*
+ * Return the offset of the first element that differs between the two
+ * keys, or NODIFF if they are equal.
+ */
+static size_t
+keydiff(const uint8_t *a, size_t alen, const uint8_t *b, size_t blen) {
+	size_t len = ISC_MAX(alen, blen);
+
+	for (size_t i = 0; i < len; i++) {
+		if (keyelem(a, alen, i) != keyelem(b, blen, i)) {
+			return (i);
+		}
+	}
+	return (NODIFF);
+}
+
+/*
+ * Follow 'key' down to some leaf.  Where the key's element is missing
+ * from a branch, any twig will do: the leaf is only used to find the
+ * first element at which the key differs from those in the trie.
+ */
+static dns_qpnode_t *
+anyleaf(dns_qpnode_t *n, const uint8_t *key, size_t keylen) {
+	while (isbranch(n)) {
+		uint32_t bit = twigbit(n, key, keylen);
+		unsigned int pos = (n->bitmap & bit) != 0 ? twigpos(n, bit)
+							  : 0;
+		n = twigs(n) + pos;
+	}
+	return (n);
+}
+
+static dns_qpnode_t *
+newtwigs(dns_qp_t *qp, unsigned int count) {
+	return (isc_mem_get(qp->mctx, count * sizeof(dns_qpnode_t)));
+}
+
+static void
+puttwigs(dns_qp_t *qp, dns_qpnode_t *twig, unsigned int count) {
+	isc_mem_put(qp->mctx, twig, count * sizeof(dns_qpnode_t));
+}
+
+/*
+ * Give up a twig array that readers may still be looking at.
+ */
+static void
+retiretwigs(dns_qp_t *qp, dns_qpnode_t *twig, unsigned int count) {
+	if (qp->retire != NULL) {
+		qp->retire(qp->uctx, twig, count * sizeof(dns_qpnode_t));
+	} else {
+		puttwigs(qp, twig, count);
+	}
+}
+
+static void
+freetwigs(dns_qp_t *qp, dns_qpnode_t *n) {
+	retiretwigs(qp, twigs(n), twigcount(n));
+}
+
+/*
+ * Copy-on-write helpers.  When a retire callback is set, a writer never
+ * changes a node that readers can reach: it works on a copy of the root
+ * and of every twig array on the way down to the node being changed,
+ * and publish() swaps the new root in.  Without one, the trie is changed
+ * in place and these do nothing but allocate the root.
+ */
+static dns_qpnode_t *
+writeroot(dns_qp_t *qp) {
+	dns_qpnode_t *root = getroot(qp);
+
+	if (root == NULL) {
+		root = newtwigs(qp, 1);
+		*root = (dns_qpnode_t){ .bitmap = 0 };
+	} else if (qp->retire != NULL) {
+		dns_qpnode_t *copy = newtwigs(qp, 1);
+		*copy = *root;
+		root = copy;
+	}
+	return (root);
+}
+
+static dns_qpnode_t *
+writetwigs(dns_qp_t *qp, dns_qpnode_t *n) {
+	if (qp->retire != NULL) {
+		unsigned int count = twigcount(n);
+		dns_qpnode_t *t = newtwigs(qp, count);
+
+		memmove(t, twigs(n), count * sizeof(*t));
+		freetwigs(qp, n);
+		n->ptr = t;
+	}
+	return (twigs(n));
+}
+
+static void
+publish(dns_qp_t *qp, dns_qpnode_t *root) {
+	dns_qpnode_t *old = getroot(qp);
+
+	if (root == old) {
+		return;
+	}
+	atomic_store_release(&qp->root, (uintptr_t)root);
+	if (old != NULL) {
+		retiretwigs(qp, old, 1);
+	}
+}
+
+static void
+freebranches(dns_qp_t *qp, dns_qpnode_t *n) {
+	if (isbranch(n)) {
+		unsigned int count = twigcount(n);
+		for (unsigned int i = 0; i < count; i++) {
+			freebranches(qp, twigs(n) + i);
+		}
+		puttwigs(qp, twigs(n), twigcount(n));
+	}
+}
+
+size_t
+dns_qpkey_fromname(dns_qpkey_t key, const dns_name_t *name) {
+	unsigned int labels;
+	size_t len = 0;
+
+	REQUIRE(ISC_MAGIC_VALID(name, DNS_NAME_MAGIC));
+	REQUIRE(dns_name_isabsolute(name));
+
+	labels = dns_name_countlabels(name);
+	for (unsigned int i = labels - 1; i-- > 0;) {
+		dns_label_t label;
+
+		dns_name_getlabel(name, i, &label);
+		for (unsigned int j = 1; j < label.length; j++) {
+			uint8_t c = isc_ascii_tolower(label.base[j]);
+			key[len++] = NIBBLE(c >> 4);
+			key[len++] = NIBBLE(c & 0x0f);
+		}
+		key[len++] = SEPARATOR;
+	}
+	INSIST(len <= DNS_QPKEY_MAXLEN);
+
+	return (len);
+}
+
+void
+dns_qp_create(isc_mem_t *mctx, dns_qpmakekey_t makekey, void *uctx,
+	      dns_qp_t **qpp) {
+	dns_qp_t *qp = NULL;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(makekey != NULL);
+	REQUIRE(qpp != NULL && *qpp == NULL);
+
+	qp = isc_mem_get(mctx, sizeof(*qp));
+	*qp = (dns_qp_t){
+		.makekey = makekey,
+		.uctx = uctx,
+	};
+	isc_mem_attach(mctx, &qp->mctx);
+	qp->magic = QP_MAGIC;
+
+	*qpp = qp;
+}
+
+void
+dns_qp_destroy(dns_qp_t **qpp) {
+	dns_qp_t *qp = NULL;
+
+	REQUIRE(qpp != NULL && VALID_QP(*qpp));
+
+	qp = *qpp;
+	*qpp = NULL;
+
+	if (getroot(qp) != NULL) {
+		freebranches(qp, getroot(qp));
+		puttwigs(qp, getroot(qp), 1);
+	}
+	qp->magic = 0;
+	isc_mem_putanddetach(&qp->mctx, qp, sizeof(*qp));
+}
+
+unsigned int
+dns_qp_count(dns_qp_t *qp) {
+	REQUIRE(VALID_QP(qp));
+
+	return (qp->count);
+}
+
+void
+dns_qp_setretire(dns_qp_t *qp, dns_qpretire_t retire) {
+	REQUIRE(VALID_QP(qp));
+
+	qp->retire = retire;
+}
+
+isc_result_t
+dns_qp_insert(dns_qp_t *qp, void *pval) {
+	dns_qpkey_t newkey, oldkey;
+	size_t newlen, oldlen, offset;
+	uint32_t newbit, oldbit;
+	dns_qpnode_t *root = NULL, *n = NULL, *t = NULL;
+	dns_qpnode_t leaf = { .bitmap = 0, .ptr = pval };
+
+	REQUIRE(VALID_QP(qp));
+	REQUIRE(pval != NULL);
+
+	newlen = qp->makekey(newkey, qp->uctx, pval);
+
+	if (getroot(qp) == NULL) {
+		root = writeroot(qp);
+		*root = leaf;
+		publish(qp, root);
+		qp->count++;
+		return (ISC_R_SUCCESS);
+	}
+
+	n = anyleaf(getroot(qp), newkey, newlen);
+	oldlen = leafkey(qp, n, oldkey);
+	offset = keydiff(newkey, newlen, oldkey, oldlen);
+	if (offset == NODIFF) {
+		return (ISC_R_EXISTS);
+	}
+	newbit = 1U << keyelem(newkey, newlen, offset);
+	oldbit = 1U << keyelem(oldkey, oldlen, offset);
+
+	/*
+	 * Every key in the subtrees passed over here agrees with the
+	 * new key up to 'offset', so the twigs being followed exist.
+	 */
+	root = writeroot(qp);
+	n = root;
+	while (isbranch(n) && n->offset < offset) {
+		n = writetwigs(qp, n) + twigpos(n, twigbit(n, newkey, newlen));
+	}
+
+	if (isbranch(n) && n->offset == offset) {
+		unsigned int count = twigcount(n);
+		unsigned int pos = twigpos(n, newbit);
+
+		INSIST((n->bitmap & newbit) == 0);
+		t = newtwigs(qp, count + 1);
+		memmove(t, twigs(n), pos * sizeof(*t));
+		t[pos] = leaf;
+		memmove(t + pos + 1, twigs(n) + pos,
+			(count - pos) * sizeof(*t));
+		freetwigs(qp, n);
+		n->bitmap |= newbit;
+		n->ptr = t;
+	} else {
+		t = newtwigs(qp, 2);
+		if (newbit < oldbit) {
+			t[0] = leaf;
+			t[1] = *n;
+		} else {
+			t[0] = *n;
+			t[1] = leaf;
+		}
+		*n = (dns_qpnode_t){
+			.bitmap = newbit | oldbit,
+			.offset = offset,
+			.ptr = t,
+		};
+	}
+
+	publish(qp, root);
+	qp->count++;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Find the leaf for 'key' in the trie below 'n'.
+ */
+static dns_qpnode_t *
+findleaf(dns_qp_t *qp, dns_qpnode_t *n, const uint8_t *key, size_t keylen) {
+	dns_qpkey_t found;
+	size_t foundlen;
+
+	if (n == NULL) {
+		return (NULL);
+	}
+
+	while (isbranch(n)) {
+		uint32_t bit = twigbit(n, key, keylen);
+		if ((n->bitmap & bit) == 0) {
+			return (NULL);
+		}
+		n = twigs(n) + twigpos(n, bit);
+	}
+
+	foundlen = leafkey(qp, n, found);
+	if (keydiff(key, keylen, found, foundlen) != NODIFF) {
+		return (NULL);
+	}
+
+	return (n);
+}
+
+isc_result_t
+dns_qp_deletekey(dns_qp_t *qp, const dns_qpkey_t key, size_t keylen) {
+	dns_qpnode_t *root = NULL, *n = NULL, *parent = NULL, *t = NULL;
+	uint32_t bit = 0;
+	unsigned int count, pos;
+
+	REQUIRE(VALID_QP(qp));
+
+	if (findleaf(qp, getroot(qp), key, keylen) == NULL) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	qp->count--;
+
+	root = getroot(qp);
+	if (!isbranch(root)) {
+		publish(qp, NULL);
+		return (ISC_R_SUCCESS);
+	}
+
+	/*
+	 * Copy the path down to the leaf's parent, which is changed below.
+	 */
+	root = writeroot(qp);
+	n = root;
+	while (isbranch(n)) {
+		bit = twigbit(n, key, keylen);
+		parent = n;
+		n = twigs(n) + twigpos(n, bit);
+		if (isbranch(n)) {
+			n = writetwigs(qp, parent) + twigpos(parent, bit);
+		}
+	}
+
+	count = twigcount(parent);
+	pos = n - twigs(parent);
+	if (count == 2) {
+		/*
+		 * The remaining twig takes the place of its parent.
+		 */
+		dns_qpnode_t other = twigs(parent)[1 - pos];
+		freetwigs(qp, parent);
+		*parent = other;
+	} else {
+		t = newtwigs(qp, count - 1);
+		memmove(t, twigs(parent), pos * sizeof(*t));
+		memmove(t + pos, twigs(parent) + pos + 1,
+			(count - pos - 1) * sizeof(*t));
+		freetwigs(qp, parent);
+		parent->bitmap &= ~bit;
+		parent->ptr = t;
+	}
+
+	publish(qp, root);
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+dns_qp_getkey(dns_qp_t *qp, const dns_qpkey_t key, size_t keylen,
+	      void **pvalp) {
+	dns_qpnode_t *n = NULL;
+
+	REQUIRE(VALID_QP(qp));
+	REQUIRE(pvalp != NULL);
+
+	n = findleaf(qp, getroot(qp), key, keylen);
+	if (n == NULL) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	*pvalp = n->ptr;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Iterator helpers.  The stack holds the path from the root; the top
+ * is the current leaf, or a subtree that the caller is about to descend
+ * into or step over.
+ */
+static inline void
+iter_push(dns_qpiter_t *iter, dns_qpnode_t *n) {
+	INSIST(iter->sp < ARRAY_SIZE(iter->stack));
+	iter->stack[iter->sp++] = n;
+}
+
+static inline dns_qpnode_t *
+iter_top(dns_qpiter_t *iter) {
+	return (iter->stack[iter->sp - 1]);
+}
+
+static void
+iter_descend(dns_qpiter_t *iter, bool last) {
+	dns_qpnode_t *n = iter_top(iter);
+
+	while (isbranch(n)) {
+		n = twigs(n) + (last ? twigcount(n) - 1 : 0);
+		iter_push(iter, n);
+	}
+}
+
+/*
+ * Replace the subtree on top of the stack with the last leaf before it
+ * (or the first leaf after it).
+ */
+static isc_result_t
+iter_step(dns_qpiter_t *iter, bool forward) {
+	while (iter->sp > 1) {
+		dns_qpnode_t *n = iter_top(iter);
+		dns_qpnode_t *parent = iter->stack[iter->sp - 2];
+		dns_qpnode_t *first = twigs(parent);
+		dns_qpnode_t *last = first + twigcount(parent) - 1;
+
+		if (forward && n < last) {
+			iter->stack[iter->sp - 1] = n + 1;
+			iter_descend(iter, false);
+			return (ISC_R_SUCCESS);
+		}
+		if (!forward && n > first) {
+			iter->stack[iter->sp - 1] = n - 1;
+			iter_descend(iter, true);
+			return (ISC_R_SUCCESS);
+		}
+		iter->sp--;
+	}
+
+	iter->sp = 0;
+	return (ISC_R_NOMORE);
+}
+
+static isc_result_t
+iter_move(dns_qpiter_t *iter, bool forward, void **pvalp) {
+	isc_result_t result;
+
+	if (iter->sp == 0) {
+		dns_qpnode_t *root = getroot(iter->qp);
+		if (root == NULL) {
+			return (ISC_R_NOMORE);
+		}
+		iter_push(iter, root);
+		iter_descend(iter, !forward);
+		result = ISC_R_SUCCESS;
+	} else {
+		result = iter_step(iter, forward);
+	}
+
+	if (result == ISC_R_SUCCESS && pvalp != NULL) {
+		*pvalp = iter_top(iter)->ptr;
+	}
+	return (result);
+}
+
+/*
+ * Check whether the NOBYTE twig of branch 'n' is a leaf whose key is
+ * that of a proper ancestor of the name with 'key'.  Because the trie
+ * skips the elements between branch offsets, this has to be confirmed
+ * from the leaf's own key.
+ */
+static bool
+isancestor(dns_qp_t *qp, const dns_qpnode_t *n, const uint8_t *key,
+	   size_t keylen) {
+	dns_qpkey_t akey;
+	size_t alen;
+
+	if ((n->bitmap & (1U << NOBYTE)) == 0 || isbranch(twigs(n)) ||
+	    n->offset >= keylen ||
+	    (n->offset > 0 && key[n->offset - 1] != SEPARATOR))
+	{
+		return (false);
+	}
+
+	alen = leafkey(qp, twigs(n), akey);
+	return (alen == n->offset && memcmp(akey, key, alen) == 0);
+}
+
+isc_result_t
+dns_qp_lookup(dns_qp_t *qp, const dns_qpkey_t key, size_t keylen,
+	      dns_qpiter_t *iter, dns_qpchain_t *chain, void **pvalp) {
+	dns_qpiter_t localiter;
+	dns_qpkey_t found;
+	size_t foundlen, offset;
+	dns_qpnode_t *root = NULL, *n = NULL;
+	unsigned int depth = 0;
+	void *ancestor = NULL;
+
+	REQUIRE(VALID_QP(qp));
+	REQUIRE(pvalp != NULL);
+
+	if (iter == NULL) {
+		iter = &localiter;
+	}
+	dns_qpiter_init(qp, iter);
+	if (chain != NULL) {
+		chain->len = 0;
+	}
+
+	root = getroot(qp);
+	if (root == NULL) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	n = anyleaf(root, key, keylen);
+	foundlen = leafkey(qp, n, found);
+	offset = keydiff(key, keylen, found, foundlen);
+
+	/*
+	 * Follow the key for as long as it agrees with the trie.  The
+	 * ancestors of the name are the leaves hanging from the NOBYTE
+	 * twig of a branch at a label boundary; they only need to be
+	 * checked when they might be, as the trie skips elements.
+	 */
+	n = root;
+	while (isbranch(n) && n->offset < offset) {
+		iter_push(iter, n);
+		if (isancestor(qp, n, key, keylen)) {
+			ancestor = twigs(n)->ptr;
+			if (chain != NULL) {
+				chain->chain[depth] = ancestor;
+			}
+			depth++;
+		}
+		n = twigs(n) + twigpos(n, twigbit(n, key, keylen));
+	}
+
+	if (offset == NODIFF) {
+		iter_push(iter, n);
+		if (chain != NULL) {
+			chain->len = depth;
+		}
+		*pvalp = n->ptr;
+		return (ISC_R_SUCCESS);
+	}
+
+	if (isbranch(n) && n->offset == offset) {
+		uint32_t below = n->bitmap &
+				 ((1U << keyelem(key, keylen, offset)) - 1);
+
+		/*
+		 * The deepest ancestor may hang from this branch.
+		 */
+		if (isancestor(qp, n, key, keylen)) {
+			ancestor = twigs(n)->ptr;
+			if (chain != NULL) {
+				chain->chain[depth] = ancestor;
+			}
+			depth++;
+		}
+
+		iter_push(iter, n);
+		if (below != 0) {
+			iter_push(iter, twigs(n) + popcount(below) - 1);
+			iter_descend(iter, true);
+		} else {
+			(void)iter_step(iter, false);
+		}
+	} else {
+		/*
+		 * Every key below 'n' agrees with 'found' up to and
+		 * including 'offset'.  If 'n' is itself a leaf whose key
+		 * is a prefix of the search key, it is the deepest
+		 * ancestor.
+		 */
+		if (!isbranch(n) && foundlen == offset && offset < keylen) {
+			ancestor = n->ptr;
+			if (chain != NULL) {
+				chain->chain[depth] = ancestor;
+			}
+			depth++;
+		}
+
+		iter_push(iter, n);
+		if (keyelem(found, foundlen, offset) <
+		    keyelem(key, keylen, offset))
+		{
+			iter_descend(iter, true);
+		} else {
+			(void)iter_step(iter, false);
+		}
+	}
+
+	if (chain != NULL) {
+		chain->len = depth;
+	}
+	if (ancestor == NULL) {
+		return (ISC_R_NOTFOUND);
+	}
+	*pvalp = ancestor;
+	return (DNS_R_PARTIALMATCH);
+}
+
+void
+dns_qpiter_init(dns_qp_t *qp, dns_qpiter_t *iter) {
+	REQUIRE(VALID_QP(qp));
+	REQUIRE(iter != NULL);
+
+	iter->qp = qp;
+	iter->sp = 0;
+}
+
+isc_result_t
+dns_qpiter_next(dns_qpiter_t *iter, void **pvalp) {
+	REQUIRE(iter != NULL && VALID_QP(iter->qp));
+
+	return (iter_move(iter, true, pvalp));
+}
+
+isc_result_t
+dns_qpiter_prev(dns_qpiter_t *iter, void **pvalp) {
+	REQUIRE(iter != NULL && VALID_QP(iter->qp));
+
+	return (iter_move(iter, false, pvalp));
+}
+
+isc_result_t
+dns_qpiter_current(dns_qpiter_t *iter, void **pvalp) {
+	REQUIRE(iter != NULL && VALID_QP(iter->qp));
+	REQUIRE(pvalp != NULL);
+
+	if (iter->sp == 0) {
+		return (ISC_R_NOMORE);
+	}
+
+	*pvalp = iter_top(iter)->ptr;
+	return (ISC_R_SUCCESS);
+}
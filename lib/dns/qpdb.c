@@ -0,0 +1,4366 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/atomic.h>
+#include <isc/mem.h>
+#include <isc/print.h>
+#include <isc/rcu.h>
+#include <isc/refcount.h>
+#include <isc/result.h>
+#include <isc/rwlock.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/callbacks.h>
+#include <dns/db.h>
+#include <dns/dbiterator.h>
+#include <dns/fixedname.h>
+#include <dns/masterdump.h>
+#include <dns/nsec3.h>
+#include <dns/qp.h>
+#include <dns/rdata.h>
+#include <dns/rdataset.h>
+#include <dns/rdatasetiter.h>
+#include <dns/rdataslab.h>
+#include <dns/rdatastruct.h>
+#include <dns/zonekey.h>
+
+#include "qpdb.h"
+
+#define QPDB_MAGIC     ISC_MAGIC('Q', 'P', 'D', 'B')
+#define VALID_QPDB(db) ((db) != NULL && (db)->common.impmagic == QPDB_MAGIC)
+
+typedef uint32_t qpdb_serial_t;
+typedef uint32_t qpdb_rdatatype_t;
+
+#define QPDB_RDATATYPE_BASE(type) ((dns_rdatatype_t)((type)&0xFFFF))
+#define QPDB_RDATATYPE_EXT(type)  ((dns_rdatatype_t)((type) >> 16))
+#define QPDB_RDATATYPE_VALUE(base, ext)              \
+	((qpdb_rdatatype_t)(((uint32_t)ext) << 16) | \
+	 (((uint32_t)base) & 0xffff))
+
+#define QPDB_RDATATYPE_SIGNSEC \
+	QPDB_RDATATYPE_VALUE(dns_rdatatype_rrsig, dns_rdatatype_nsec)
+#define QPDB_RDATATYPE_SIGNSEC3 \
+	QPDB_RDATATYPE_VALUE(dns_rdatatype_rrsig, dns_rdatatype_nsec3)
+#define QPDB_RDATATYPE_SIGCNAME \
+	QPDB_RDATATYPE_VALUE(dns_rdatatype_rrsig, dns_rdatatype_cname)
+#define QPDB_RDATATYPE_SIGDNAME \
+	QPDB_RDATATYPE_VALUE(dns_rdatatype_rrsig, dns_rdatatype_dname)
+
+/* Fixed RRSet helper macros */
+
+#define DNS_RDATASET_LENGTH 2;
+
+#if DNS_RDATASET_FIXED
+#define DNS_RDATASET_ORDER 2
+#define DNS_RDATASET_COUNT (count * 4)
+#else /* !DNS_RDATASET_FIXED */
+#define DNS_RDATASET_ORDER 0
+#define DNS_RDATASET_COUNT 0
+#endif /* DNS_RDATASET_FIXED */
+
+typedef enum { dns_db_insecure, dns_db_partial, dns_db_secure } dns_db_secure_t;
+
+typedef struct dns_qpdb dns_qpdb_t;
+
+/*
+ * An rdataset header, followed by the rdata slab.  The headers of a
+ * node are linked by 'next', one for each type; older versions of each
+ * type hang off 'down'.
+ */
+typedef struct qpdb_header {
+	qpdb_serial_t serial;
+	dns_ttl_t ttl;
+	qpdb_rdatatype_t type;
+	uint16_t attributes;
+	dns_trust_t trust;
+	atomic_uint_fast32_t count;
+	atomic_uintptr_t next;
+	atomic_uintptr_t down;
+} qpdb_header_t;
+
+#define QPDB_HEADER_NONEXISTENT 0x0001
+#define QPDB_HEADER_IGNORE	0x0002
+
+#define NONEXISTENT(header) \
+	(((header)->attributes & QPDB_HEADER_NONEXISTENT) != 0)
+#define EXISTS(header) (!NONEXISTENT(header))
+#define IGNORE(header) (((header)->attributes & QPDB_HEADER_IGNORE) != 0)
+
+/*
+ * A node of the database, followed by its owner name in wire format.
+ */
+typedef struct qpdb_node {
+	isc_refcount_t references;
+	atomic_uintptr_t data;
+	atomic_bool dirty;
+	atomic_bool wild;
+	atomic_bool delegating;
+	bool nsec3;
+	bool deleted;
+	uint8_t namelen;
+} qpdb_node_t;
+
+#define WILD(node)	 atomic_load_relaxed(&(node)->wild)
+#define DELEGATING(node) atomic_load_relaxed(&(node)->delegating)
+
+/*
+ * The links between nodes and headers can be followed by lookups that
+ * don't take the database lock (see below), so writers publish them
+ * with release semantics, after the headers they point to are complete.
+ */
+static inline qpdb_header_t *
+node_data(qpdb_node_t *node) {
+	return ((qpdb_header_t *)atomic_load_acquire(&node->data));
+}
+
+static inline qpdb_header_t *
+header_next(qpdb_header_t *header) {
+	return ((qpdb_header_t *)atomic_load_acquire(&header->next));
+}
+
+static inline qpdb_header_t *
+header_down(qpdb_header_t *header) {
+	return ((qpdb_header_t *)atomic_load_acquire(&header->down));
+}
+
+static inline void
+set_data(qpdb_node_t *node, qpdb_header_t *header) {
+	atomic_store_release(&node->data, (uintptr_t)header);
+}
+
+static inline void
+set_next(qpdb_header_t *header, qpdb_header_t *next) {
+	atomic_store_release(&header->next, (uintptr_t)next);
+}
+
+static inline void
+set_down(qpdb_header_t *header, qpdb_header_t *down) {
+	atomic_store_release(&header->down, (uintptr_t)down);
+}
+
+typedef struct qpdb_changed {
+	qpdb_node_t *node;
+	bool dirty;
+	ISC_LINK(struct qpdb_changed) link;
+} qpdb_changed_t;
+
+typedef ISC_LIST(qpdb_changed_t) qpdb_changedlist_t;
+
+typedef struct qpdb_version {
+	/* Not locked */
+	qpdb_serial_t serial;
+	dns_qpdb_t *qpdb;
+	/*
+	 * Protected in the refcount routines.
+	 */
+	isc_refcount_t references;
+	/* Locked by database lock. */
+	bool writer;
+	bool commit_ok;
+	qpdb_changedlist_t changed_list;
+	ISC_LINK(struct qpdb_version) link;
+	dns_db_secure_t secure;
+	bool havensec3;
+	/* NSEC3 parameters */
+	dns_hash_t hash;
+	uint8_t flags;
+	uint16_t iterations;
+	uint8_t salt_length;
+	unsigned char salt[DNS_NSEC3_SALTSIZE];
+	uint64_t records;
+	uint64_t xfrsize;
+} qpdb_version_t;
+
+typedef ISC_LIST(qpdb_version_t) qpdb_versionlist_t;
+
+/*
+ * Memory that lock-free lookups may still be using, waiting to be freed.
+ * An item with a zero size is a node taken out of its trie.
+ */
+typedef struct qpdb_retired {
+	uint64_t tag;
+	unsigned int count;
+	unsigned int length;
+	struct {
+		void *ptr;
+		size_t size;
+	} *items;
+	ISC_LINK(struct qpdb_retired) link;
+} qpdb_retired_t;
+
+typedef ISC_LIST(qpdb_retired_t) qpdb_retiredlist_t;
+
+/*
+ * Locking
+ *
+ * A single reader/writer lock protects the tries, the nodes and their
+ * rdatasets, and the version lists.  Updates, loading and version
+ * cleanup take it for writing.
+ *
+ * Lookups on a loop thread don't take it at all once the database has
+ * been loaded: they run in an isc_rcu read-side critical section
+ * instead.  This works because writers never change anything such a
+ * lookup can reach in place.  The tries are copy-on-write, new headers
+ * are linked in front of the ones they supersede, and the current
+ * version is replaced with a single pointer store.  Whatever a writer
+ * unlinks is retired rather than freed, and the retired memory is freed
+ * later, once isc_rcu_expired() says no lookup can still see it.  Other
+ * threads, and every lookup while loading, take the lock for reading.
+ *
+ * Node reference counts are atomic, and every node reference also holds
+ * a reference to the database.  A lock-free lookup can take a reference
+ * to a node at the moment a writer takes the node out of its trie; a
+ * retired node is therefore only freed once its reference count is zero
+ * as well.
+ */
+struct dns_qpdb {
+	/* Unlocked. */
+	dns_db_t common;
+	isc_rwlock_t lock;
+	isc_refcount_t references;
+	qpdb_node_t *origin_node;
+	qpdb_node_t *nsec3_origin_node;
+	atomic_bool lockless;
+	atomic_uintptr_t current_version;
+	/* Locked by lock. */
+	dns_qp_t *tree;
+	dns_qp_t *nsec3;
+	uint64_t generation;
+	qpdb_serial_t current_serial;
+	qpdb_serial_t least_serial;
+	qpdb_serial_t next_serial;
+	qpdb_version_t *future_version;
+	qpdb_versionlist_t open_versions;
+	qpdb_retired_t *retiring;
+	qpdb_retiredlist_t retired;
+	qpdb_retired_t *zombies;
+};
+
+#define CURRENT_VERSION(qpdb) \
+	((qpdb_version_t *)atomic_load_acquire(&(qpdb)->current_version))
+
+#define IS_STUB(qpdb) (((qpdb)->common.attributes & DNS_DBATTR_STUB) != 0)
+
+/*%
+ * Search Context
+ */
+typedef struct {
+	dns_qpdb_t *qpdb;
+	qpdb_version_t *version;
+	qpdb_serial_t serial;
+	unsigned int options;
+	dns_qpiter_t iter;
+	dns_qpchain_t chain;
+	bool wild;
+	qpdb_node_t *zonecut;
+	qpdb_header_t *zonecut_header;
+	qpdb_header_t *zonecut_sigheader;
+} qpdb_search_t;
+
+/*%
+ * Load Context
+ */
+typedef struct {
+	dns_qpdb_t *qpdb;
+} qpdb_load_t;
+
+static void
+rdataset_disassociate(dns_rdataset_t *rdataset);
+static isc_result_t
+rdataset_first(dns_rdataset_t *rdataset);
+static isc_result_t
+rdataset_next(dns_rdataset_t *rdataset);
+static void
+rdataset_current(dns_rdataset_t *rdataset, dns_rdata_t *rdata);
+static void
+rdataset_clone(dns_rdataset_t *source, dns_rdataset_t *target);
+static unsigned int
+rdataset_count(dns_rdataset_t *rdataset);
+
+static dns_rdatasetmethods_t rdataset_methods = {
+	rdataset_disassociate,
+	rdataset_first,
+	rdataset_next,
+	rdataset_current,
+	rdataset_clone,
+	rdataset_count,
+	NULL, /* addnoqname */
+	NULL, /* getnoqname */
+	NULL, /* addclosest */
+	NULL, /* getclosest */
+	NULL, /* settrust */
+	NULL, /* expire */
+	NULL, /* clearprefetch */
+	NULL, /* setownercase */
+	NULL, /* getownercase */
+	NULL  /* addglue */
+};
+
+static void
+rdatasetiter_destroy(dns_rdatasetiter_t **iteratorp);
+static isc_result_t
+rdatasetiter_first(dns_rdatasetiter_t *iterator);
+static isc_result_t
+rdatasetiter_next(dns_rdatasetiter_t *iterator);
+static void
+rdatasetiter_current(dns_rdatasetiter_t *iterator, dns_rdataset_t *rdataset);
+
+static dns_rdatasetitermethods_t rdatasetiter_methods = {
+	rdatasetiter_destroy, rdatasetiter_first, rdatasetiter_next,
+	rdatasetiter_current
+};
+
+/*
+ * 'top' is the header at the top of the type chain being visited, and
+ * 'current' the version of it that is visible to the iterator.
+ */
+typedef struct qpdb_rdatasetiter {
+	dns_rdatasetiter_t common;
+	qpdb_header_t *top;
+	qpdb_header_t *current;
+} qpdb_rdatasetiter_t;
+
+static void
+dbiterator_destroy(dns_dbiterator_t **iteratorp);
+static isc_result_t
+dbiterator_first(dns_dbiterator_t *iterator);
+static isc_result_t
+dbiterator_last(dns_dbiterator_t *iterator);
+static isc_result_t
+dbiterator_seek(dns_dbiterator_t *iterator, const dns_name_t *name);
+static isc_result_t
+dbiterator_prev(dns_dbiterator_t *iterator);
+static isc_result_t
+dbiterator_next(dns_dbiterator_t *iterator);
+static isc_result_t
+dbiterator_current(dns_dbiterator_t *iterator, dns_dbnode_t **nodep,
+		   dns_name_t *name);
+static isc_result_t
+dbiterator_pause(dns_dbiterator_t *iterator);
+static isc_result_t
+dbiterator_origin(dns_dbiterator_t *iterator, dns_name_t *name);
+
+static dns_dbiteratormethods_t dbiterator_methods = {
+	dbiterator_destroy, dbiterator_first, dbiterator_last,
+	dbiterator_seek,    dbiterator_prev,  dbiterator_next,
+	dbiterator_current, dbiterator_pause, dbiterator_origin,
+	NULL /* currentbatch */
+};
+
+/*
+ * The iterator holds no lock between calls; instead it keeps a reference
+ * to the current node, and finds its place in the trie again whenever
+ * the trie has been modified since the last call ('generation').  The
+ * NSEC3 trie is visited after the main one as if it followed it in
+ * lexical order.
+ */
+typedef struct qpdb_dbiterator {
+	dns_dbiterator_t common;
+	isc_result_t result;
+	bool new_origin;
+	bool nsec3only;
+	bool nonsec3;
+	uint64_t generation;
+	dns_qp_t *current;
+	qpdb_node_t *node;
+	dns_qpiter_t iter;
+} qpdb_dbiterator_t;
+
+static void
+detachnode(dns_db_t *db, dns_dbnode_t **targetp);
+static void
+currentversion(dns_db_t *db, dns_dbversion_t **versionp);
+static void
+closeversion(dns_db_t *db, dns_dbversion_t **versionp, bool commit);
+static void
+setnsec3parameters(dns_db_t *db, qpdb_version_t *version);
+
+/*%
+ * 'init_count' is used to initialize 'newheader->count' which in turn
+ * is used to determine where in the cycle rrset-order cyclic starts.
+ * We don't lock this as we don't care about simultaneous updates.
+ */
+static atomic_uint_fast32_t init_count = 0;
+
+/*
+ * Nodes
+ */
+
+static void
+nodename(const qpdb_node_t *node, dns_name_t *name) {
+	isc_region_t r = { .base = (unsigned char *)(node + 1),
+			   .length = node->namelen };
+
+	dns_name_fromregion(name, &r);
+}
+
+static size_t
+qpdb_makekey(dns_qpkey_t key, void *uctx, void *pval) {
+	qpdb_node_t *node = pval;
+	dns_name_t name;
+
+	UNUSED(uctx);
+
+	dns_name_init(&name, NULL);
+	nodename(node, &name);
+	return (dns_qpkey_fromname(key, &name));
+}
+
+static qpdb_node_t *
+new_node(dns_qpdb_t *qpdb, const dns_name_t *name, bool nsec3) {
+	qpdb_node_t *node = NULL;
+
+	node = isc_mem_get(qpdb->common.mctx, sizeof(*node) + name->length);
+	*node = (qpdb_node_t){ .nsec3 = nsec3, .namelen = name->length };
+	isc_refcount_init(&node->references, 0);
+	atomic_init(&node->dirty, false);
+	memmove(node + 1, name->ndata, name->length);
+
+	return (node);
+}
+
+static unsigned int
+header_size(qpdb_header_t *header) {
+	if (NONEXISTENT(header)) {
+		return (sizeof(*header));
+	}
+	return (dns_rdataslab_size((unsigned char *)header, sizeof(*header)));
+}
+
+static void
+free_header(dns_qpdb_t *qpdb, qpdb_header_t *header) {
+	isc_mem_put(qpdb->common.mctx, header, header_size(header));
+}
+
+static void
+free_node(dns_qpdb_t *qpdb, qpdb_node_t *node) {
+	qpdb_header_t *current = NULL, *top_next = NULL;
+	qpdb_header_t *dcurrent = NULL, *down_next = NULL;
+
+	for (current = node_data(node); current != NULL; current = top_next) {
+		top_next = header_next(current);
+		for (dcurrent = header_down(current); dcurrent != NULL;
+		     dcurrent = down_next)
+		{
+			down_next = header_down(dcurrent);
+			free_header(qpdb, dcurrent);
+		}
+		free_header(qpdb, current);
+	}
+	isc_refcount_destroy(&node->references);
+	isc_mem_put(qpdb->common.mctx, node, sizeof(*node) + node->namelen);
+}
+
+/*
+ * Retired memory.  The database must be write locked.
+ */
+
+static void
+retired_add(dns_qpdb_t *qpdb, qpdb_retired_t **rp, void *ptr, size_t size) {
+	qpdb_retired_t *r = *rp;
+
+	if (r == NULL) {
+		r = isc_mem_get(qpdb->common.mctx, sizeof(*r));
+		*r = (qpdb_retired_t){ .tag = 0 };
+		ISC_LINK_INIT(r, link);
+		*rp = r;
+	}
+	if (r->count == r->length) {
+		unsigned int length = ISC_MAX(16, r->length * 2);
+		void *items = isc_mem_get(qpdb->common.mctx,
+					  length * sizeof(r->items[0]));
+		if (r->items != NULL) {
+			memmove(items, r->items,
+				r->count * sizeof(r->items[0]));
+			isc_mem_put(qpdb->common.mctx, r->items,
+				    r->length * sizeof(r->items[0]));
+		}
+		r->items = items;
+		r->length = length;
+	}
+	r->items[r->count].ptr = ptr;
+	r->items[r->count].size = size;
+	r->count++;
+}
+
+static void
+retired_free(dns_qpdb_t *qpdb, qpdb_retired_t *r) {
+	if (r->items != NULL) {
+		isc_mem_put(qpdb->common.mctx, r->items,
+			    r->length * sizeof(r->items[0]));
+	}
+	isc_mem_put(qpdb->common.mctx, r, sizeof(*r));
+}
+
+/*
+ * Free the memory in 'r'.  Nodes that are still referenced become
+ * zombies, to be freed by a later call to reap_zombies().
+ */
+static void
+reclaim(dns_qpdb_t *qpdb, qpdb_retired_t *r) {
+	for (unsigned int i = 0; i < r->count; i++) {
+		qpdb_node_t *node = r->items[i].ptr;
+
+		if (r->items[i].size != 0) {
+			isc_mem_put(qpdb->common.mctx, r->items[i].ptr,
+				    r->items[i].size);
+		} else if (isc_refcount_current(&node->references) == 0) {
+			free_node(qpdb, node);
+		} else {
+			retired_add(qpdb, &qpdb->zombies, node, 0);
+		}
+	}
+	retired_free(qpdb, r);
+}
+
+static void
+reap_zombies(dns_qpdb_t *qpdb) {
+	qpdb_retired_t *r = qpdb->zombies;
+	unsigned int count = 0;
+
+	for (unsigned int i = 0; i < r->count; i++) {
+		qpdb_node_t *node = r->items[i].ptr;
+
+		if (isc_refcount_current(&node->references) == 0) {
+			free_node(qpdb, node);
+		} else {
+			r->items[count++] = r->items[i];
+		}
+	}
+	r->count = count;
+	if (count == 0) {
+		retired_free(qpdb, r);
+		qpdb->zombies = NULL;
+	}
+}
+
+/*
+ * Free 'size' bytes at 'ptr' now, or once lock-free lookups that may
+ * be using them are done.  A zero size retires a node.
+ */
+static void
+retire(dns_qpdb_t *qpdb, void *ptr, size_t size) {
+	if (atomic_load_relaxed(&qpdb->lockless)) {
+		retired_add(qpdb, &qpdb->retiring, ptr, size);
+	} else if (size == 0) {
+		free_node(qpdb, ptr);
+	} else {
+		isc_mem_put(qpdb->common.mctx, ptr, size);
+	}
+}
+
+static void
+retire_header(dns_qpdb_t *qpdb, qpdb_header_t *header) {
+	retire(qpdb, header, header_size(header));
+}
+
+static void
+qpdb_retire(void *uctx, void *ptr, size_t size) {
+	retire(uctx, ptr, size);
+}
+
+/*
+ * Release the write lock.  What was retired while it was held is tagged
+ * first, and whatever has expired since earlier calls is freed.
+ */
+static void
+write_unlock(dns_qpdb_t *qpdb) {
+	qpdb_retired_t *r = NULL;
+
+	if (qpdb->retiring != NULL) {
+		qpdb->retiring->tag = isc_rcu_retire();
+		ISC_LIST_APPEND(qpdb->retired, qpdb->retiring, link);
+		qpdb->retiring = NULL;
+	}
+	while ((r = ISC_LIST_HEAD(qpdb->retired)) != NULL &&
+	       isc_rcu_expired(r->tag))
+	{
+		ISC_LIST_UNLINK(qpdb->retired, r, link);
+		reclaim(qpdb, r);
+	}
+	if (qpdb->zombies != NULL) {
+		reap_zombies(qpdb);
+	}
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_write);
+}
+
+/*
+ * Start a lookup; returns true if it runs without the lock, which must be
+ * passed to read_end().
+ */
+static bool
+read_begin(dns_qpdb_t *qpdb) {
+	if (atomic_load_acquire(&qpdb->lockless) && isc_rcu_available()) {
+		isc_rcu_read_lock();
+		return (true);
+	}
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	return (false);
+}
+
+static void
+read_end(dns_qpdb_t *qpdb, bool lockless) {
+	if (lockless) {
+		isc_rcu_read_unlock();
+	} else {
+		RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+	}
+}
+
+/*
+ * Find the node for 'name' in 'tree', creating it if needed.  The
+ * database must be write locked.
+ */
+static qpdb_node_t *
+get_node(dns_qpdb_t *qpdb, dns_qp_t *tree, const dns_name_t *name) {
+	qpdb_node_t *node = NULL;
+	dns_qpkey_t key;
+	size_t keylen;
+	isc_result_t result;
+
+	keylen = dns_qpkey_fromname(key, name);
+	result = dns_qp_getkey(tree, key, keylen, (void **)&node);
+	if (result == ISC_R_SUCCESS) {
+		return (node);
+	}
+
+	node = new_node(qpdb, name, tree == qpdb->nsec3);
+	result = dns_qp_insert(tree, node);
+	INSIST(result == ISC_R_SUCCESS);
+	qpdb->generation++;
+
+	return (node);
+}
+
+/*
+ * Remove 'node' from its trie if nothing refers to it any longer.  The
+ * database must be write locked.
+ */
+static void
+maybe_delete_node(dns_qpdb_t *qpdb, qpdb_node_t *node) {
+	dns_qp_t *tree = node->nsec3 ? qpdb->nsec3 : qpdb->tree;
+	dns_qpkey_t key;
+	size_t keylen;
+	isc_result_t result;
+
+	if (node->deleted || node_data(node) != NULL || WILD(node) ||
+	    node == qpdb->origin_node || node == qpdb->nsec3_origin_node ||
+	    isc_refcount_current(&node->references) != 0)
+	{
+		return;
+	}
+
+	keylen = qpdb_makekey(key, NULL, node);
+	result = dns_qp_deletekey(tree, key, keylen);
+	INSIST(result == ISC_R_SUCCESS);
+	qpdb->generation++;
+
+	node->deleted = true;
+	retire(qpdb, node, 0);
+}
+
+/*
+ * Free the rdatasets of 'node' that are no longer visible to any open
+ * version.  The database must be write locked.
+ */
+static void
+clean_zone_node(dns_qpdb_t *qpdb, qpdb_node_t *node,
+		qpdb_serial_t least_serial) {
+	qpdb_header_t *current = NULL, *dcurrent = NULL, *down_next = NULL;
+	qpdb_header_t *dparent = NULL, *top_prev = NULL, *top_next = NULL;
+	bool still_dirty = false;
+
+	REQUIRE(least_serial != 0);
+
+	for (current = node_data(node); current != NULL; current = top_next) {
+		top_next = header_next(current);
+
+		/*
+		 * First, we clean up any instances of multiple rdatasets
+		 * with the same serial number, or that have the IGNORE
+		 * attribute.
+		 */
+		dparent = current;
+		for (dcurrent = header_down(current); dcurrent != NULL;
+		     dcurrent = down_next)
+		{
+			down_next = header_down(dcurrent);
+			INSIST(dcurrent->serial <= dparent->serial);
+			if (dcurrent->serial == dparent->serial ||
+			    IGNORE(dcurrent)) {
+				set_down(dparent, down_next);
+				retire_header(qpdb, dcurrent);
+			} else {
+				dparent = dcurrent;
+			}
+		}
+
+		/*
+		 * We've now eliminated all IGNORE datasets with the possible
+		 * exception of current, which we now check.
+		 */
+		if (IGNORE(current)) {
+			down_next = header_down(current);
+			if (down_next != NULL) {
+				set_next(down_next, top_next);
+			}
+			if (top_prev != NULL) {
+				set_next(top_prev,
+					 (down_next != NULL) ? down_next
+							     : top_next);
+			} else {
+				set_data(node, (down_next != NULL) ? down_next
+								   : top_next);
+			}
+			retire_header(qpdb, current);
+			if (down_next == NULL) {
+				continue;
+			}
+			current = down_next;
+		}
+
+		/*
+		 * Every version at or above 'least_serial' sees the newest
+		 * header whose serial is not greater than it; anything
+		 * below that header can go.
+		 */
+		for (dparent = current; dparent->serial > least_serial &&
+					header_down(dparent) != NULL;
+		     dparent = header_down(dparent))
+		{
+		}
+		dcurrent = header_down(dparent);
+		set_down(dparent, NULL);
+		for (; dcurrent != NULL; dcurrent = down_next) {
+			down_next = header_down(dcurrent);
+			retire_header(qpdb, dcurrent);
+		}
+
+		if (header_down(current) != NULL) {
+			still_dirty = true;
+			top_prev = current;
+		} else if (NONEXISTENT(current) &&
+			   current->serial <= least_serial) {
+			/*
+			 * A "this rdataset doesn't exist" header with
+			 * nothing below it hides nothing; delete it.
+			 */
+			if (top_prev != NULL) {
+				set_next(top_prev, header_next(current));
+			} else {
+				set_data(node, header_next(current));
+			}
+			retire_header(qpdb, current);
+		} else {
+			top_prev = current;
+		}
+	}
+
+	if (!still_dirty) {
+		atomic_store_release(&node->dirty, false);
+	}
+}
+
+static void
+db_unref(dns_qpdb_t *qpdb);
+
+static void
+new_reference(dns_qpdb_t *qpdb, qpdb_node_t *node) {
+	isc_refcount_increment0(&node->references);
+	isc_refcount_increment(&qpdb->references);
+}
+
+/*
+ * Drop a node reference while holding the database write lock.  The
+ * matching database reference is left to the caller, which must drop it
+ * after unlocking.
+ */
+static void
+release_node(dns_qpdb_t *qpdb, qpdb_node_t *node) {
+	if (isc_refcount_decrement(&node->references) > 1) {
+		return;
+	}
+	if (atomic_load_acquire(&node->dirty)) {
+		clean_zone_node(qpdb, node, qpdb->least_serial);
+	}
+	maybe_delete_node(qpdb, node);
+}
+
+/*
+ * Rdatasets
+ */
+
+/*
+ * Return the version of the rdataset at the top of 'header' that is
+ * visible at 'serial', or NULL if there is none.
+ */
+static qpdb_header_t *
+visible(qpdb_header_t *header, qpdb_serial_t serial) {
+	do {
+		if (header->serial <= serial && !IGNORE(header)) {
+			/*
+			 * Is this a "this rdataset doesn't exist" record?
+			 */
+			if (NONEXISTENT(header)) {
+				header = NULL;
+			}
+			break;
+		}
+		header = header_down(header);
+	} while (header != NULL);
+
+	return (header);
+}
+
+static bool
+node_active(qpdb_node_t *node, qpdb_serial_t serial) {
+	qpdb_header_t *header = NULL;
+
+	for (header = node_data(node); header != NULL;
+	     header = header_next(header)) {
+		if (visible(header, serial) != NULL) {
+			return (true);
+		}
+	}
+
+	return (false);
+}
+
+static void
+bind_rdataset(dns_qpdb_t *qpdb, qpdb_node_t *node, qpdb_header_t *header,
+	      dns_rdataset_t *rdataset) {
+	/*
+	 * Caller must be holding the database lock.
+	 */
+
+	if (rdataset == NULL) {
+		return;
+	}
+
+	new_reference(qpdb, node);
+
+	INSIST(rdataset->methods == NULL); /* We must be disassociated. */
+
+	rdataset->methods = &rdataset_methods;
+	rdataset->rdclass = qpdb->common.rdclass;
+	rdataset->type = QPDB_RDATATYPE_BASE(header->type);
+	rdataset->covers = QPDB_RDATATYPE_EXT(header->type);
+	rdataset->ttl = header->ttl;
+	rdataset->trust = header->trust;
+	rdataset->attributes = 0;
+	rdataset->private1 = qpdb;
+	rdataset->private2 = node;
+	rdataset->private3 = header + 1;
+	rdataset->privateuint4 = 0;
+	rdataset->private5 = NULL;
+	rdataset->private6 = NULL;
+	rdataset->private7 = NULL;
+	rdataset->resign = 0;
+
+	/*
+	 * Reset iterator state.
+	 */
+	rdataset->count = atomic_fetch_add_relaxed(&header->count, 1);
+	if (rdataset->count == UINT32_MAX) {
+		rdataset->count = 0;
+	}
+}
+
+static qpdb_header_t *
+new_header(dns_qpdb_t *qpdb, dns_rdataset_t *rdataset,
+	   qpdb_serial_t serial) {
+	qpdb_header_t *header = NULL;
+	isc_region_t region;
+	isc_result_t result;
+
+	result = dns_rdataslab_fromrdataset(rdataset, qpdb->common.mctx,
+					    &region, sizeof(qpdb_header_t));
+	if (result != ISC_R_SUCCESS) {
+		return (NULL);
+	}
+
+	header = (qpdb_header_t *)region.base;
+	*header = (qpdb_header_t){
+		.serial = serial,
+		.ttl = rdataset->ttl,
+		.type = QPDB_RDATATYPE_VALUE(rdataset->type, rdataset->covers),
+		.trust = rdataset->trust,
+	};
+	atomic_init(&header->count, atomic_fetch_add_relaxed(&init_count, 1));
+
+	return (header);
+}
+
+static qpdb_header_t *
+new_nxheader(dns_qpdb_t *qpdb, qpdb_rdatatype_t type, qpdb_serial_t serial) {
+	qpdb_header_t *header = NULL;
+
+	header = isc_mem_get(qpdb->common.mctx, sizeof(*header));
+	*header = (qpdb_header_t){
+		.serial = serial,
+		.type = type,
+		.attributes = QPDB_HEADER_NONEXISTENT,
+	};
+	atomic_init(&header->count, 0);
+
+	return (header);
+}
+
+static uint64_t
+recordsize(qpdb_header_t *header, unsigned int namelen) {
+	return (dns_rdataslab_rdatasize((unsigned char *)header,
+					sizeof(*header)) +
+		sizeof(dns_ttl_t) + sizeof(dns_rdatatype_t) +
+		sizeof(dns_rdataclass_t) + namelen);
+}
+
+static void
+update_recordsandxfrsize(bool add, qpdb_version_t *version,
+			 qpdb_header_t *header, unsigned int namelen) {
+	unsigned char *hdr = (unsigned char *)header;
+	size_t hdrsize = sizeof(*header);
+
+	if (NONEXISTENT(header)) {
+		return;
+	}
+
+	if (add) {
+		version->records += dns_rdataslab_count(hdr, hdrsize);
+		version->xfrsize += recordsize(header, namelen);
+	} else {
+		version->records -= dns_rdataslab_count(hdr, hdrsize);
+		version->xfrsize -= recordsize(header, namelen);
+	}
+}
+
+static bool
+cname_and_other_data(qpdb_node_t *node, qpdb_serial_t serial) {
+	qpdb_header_t *header = NULL;
+	bool cname = false, other_data = false;
+	dns_rdatatype_t rdtype;
+
+	/*
+	 * Look for CNAME and "other data" rdatasets active in our version.
+	 * "Other data" is any rdataset whose type is not KEY, NSEC, SIG
+	 * or RRSIG.
+	 */
+	for (header = node_data(node); header != NULL;
+	     header = header_next(header)) {
+		rdtype = QPDB_RDATATYPE_BASE(header->type);
+		if (rdtype == dns_rdatatype_key ||
+		    rdtype == dns_rdatatype_sig ||
+		    rdtype == dns_rdatatype_nsec ||
+		    rdtype == dns_rdatatype_rrsig)
+		{
+			continue;
+		}
+		if (visible(header, serial) == NULL) {
+			continue;
+		}
+		if (header->type == dns_rdatatype_cname) {
+			cname = true;
+		} else {
+			other_data = true;
+		}
+		if (cname && other_data) {
+			return (true);
+		}
+	}
+
+	return (false);
+}
+
+static bool
+delegating_type(dns_qpdb_t *qpdb, qpdb_node_t *node, qpdb_rdatatype_t type) {
+	return (type == dns_rdatatype_dname ||
+		(type == dns_rdatatype_ns &&
+		 (node != qpdb->origin_node || IS_STUB(qpdb))));
+}
+
+/*
+ * Versions
+ */
+
+static qpdb_version_t *
+allocate_version(isc_mem_t *mctx, qpdb_serial_t serial,
+		 unsigned int references, bool writer) {
+	qpdb_version_t *version = isc_mem_get(mctx, sizeof(*version));
+
+	*version = (qpdb_version_t){
+		.serial = serial,
+		.writer = writer,
+		.secure = dns_db_insecure,
+	};
+	isc_refcount_init(&version->references, references);
+	ISC_LIST_INIT(version->changed_list);
+	ISC_LINK_INIT(version, link);
+
+	return (version);
+}
+
+static void
+free_version(dns_qpdb_t *qpdb, qpdb_version_t *version) {
+	INSIST(ISC_LIST_EMPTY(version->changed_list));
+	isc_refcount_destroy(&version->references);
+	retire(qpdb, version, sizeof(*version));
+}
+
+static qpdb_changed_t *
+add_changed(dns_qpdb_t *qpdb, qpdb_version_t *version, qpdb_node_t *node) {
+	qpdb_changed_t *changed = NULL;
+
+	/*
+	 * Caller must be holding the database write lock.
+	 */
+
+	REQUIRE(version->writer);
+
+	changed = isc_mem_get(qpdb->common.mctx, sizeof(*changed));
+	*changed = (qpdb_changed_t){ .node = node };
+	ISC_LINK_INIT(changed, link);
+	new_reference(qpdb, node);
+	ISC_LIST_APPEND(version->changed_list, changed, link);
+
+	return (changed);
+}
+
+static void
+rollback_node(qpdb_node_t *node, qpdb_serial_t serial) {
+	qpdb_header_t *header = NULL, *dcurrent = NULL;
+	bool make_dirty = false;
+
+	/*
+	 * We set the IGNORE attribute on rdatasets with serial number
+	 * 'serial'.  When the reference count goes to zero, these rdatasets
+	 * will be cleaned up; until that time, they will be ignored.
+	 */
+	for (header = node_data(node); header != NULL;
+	     header = header_next(header)) {
+		if (header->serial == serial) {
+			header->attributes |= QPDB_HEADER_IGNORE;
+			make_dirty = true;
+		}
+		for (dcurrent = header_down(header); dcurrent != NULL;
+		     dcurrent = header_down(dcurrent))
+		{
+			if (dcurrent->serial == serial) {
+				dcurrent->attributes |= QPDB_HEADER_IGNORE;
+				make_dirty = true;
+			}
+		}
+	}
+	if (make_dirty) {
+		atomic_store_release(&node->dirty, true);
+	}
+}
+
+static void
+make_least_version(dns_qpdb_t *qpdb, qpdb_version_t *version,
+		   qpdb_changedlist_t *cleanup_list) {
+	/*
+	 * Caller must be holding the database lock.
+	 */
+
+	qpdb->least_serial = version->serial;
+	*cleanup_list = version->changed_list;
+	ISC_LIST_INIT(version->changed_list);
+}
+
+static void
+cleanup_nondirty(qpdb_version_t *version, qpdb_changedlist_t *cleanup_list) {
+	qpdb_changed_t *changed = NULL, *next_changed = NULL;
+
+	/*
+	 * If the changed record is dirty, then an update created multiple
+	 * versions of a given rdataset.  We keep this list until we're the
+	 * least open version, at which point it's safe to get rid of any
+	 * older versions.
+	 *
+	 * If the changed record isn't dirty, then we don't need it anymore
+	 * since we're committing and not rolling back.
+	 *
+	 * The caller must be holding the database lock.
+	 */
+	for (changed = ISC_LIST_HEAD(version->changed_list); changed != NULL;
+	     changed = next_changed)
+	{
+		next_changed = ISC_LIST_NEXT(changed, link);
+		if (!changed->dirty) {
+			ISC_LIST_UNLINK(version->changed_list, changed, link);
+			ISC_LIST_APPEND(*cleanup_list, changed, link);
+		}
+	}
+}
+
+static void
+iszonesecure(dns_db_t *db, qpdb_version_t *version, dns_dbnode_t *origin) {
+	dns_rdataset_t keyset;
+	dns_rdataset_t nsecset, signsecset;
+	bool haszonekey = false;
+	bool hasnsec = false;
+	isc_result_t result;
+
+	dns_rdataset_init(&keyset);
+	result = dns_db_findrdataset(db, origin, version, dns_rdatatype_dnskey,
+				     0, 0, &keyset, NULL);
+	if (result == ISC_R_SUCCESS) {
+		result = dns_rdataset_first(&keyset);
+		while (result == ISC_R_SUCCESS) {
+			dns_rdata_t keyrdata = DNS_RDATA_INIT;
+			dns_rdataset_current(&keyset, &keyrdata);
+			if (dns_zonekey_iszonekey(&keyrdata)) {
+				haszonekey = true;
+				break;
+			}
+			result = dns_rdataset_next(&keyset);
+		}
+		dns_rdataset_disassociate(&keyset);
+	}
+	if (!haszonekey) {
+		version->secure = dns_db_insecure;
+		version->havensec3 = false;
+		return;
+	}
+
+	dns_rdataset_init(&nsecset);
+	dns_rdataset_init(&signsecset);
+	result = dns_db_findrdataset(db, origin, version, dns_rdatatype_nsec, 0,
+				     0, &nsecset, &signsecset);
+	if (result == ISC_R_SUCCESS) {
+		if (dns_rdataset_isassociated(&signsecset)) {
+			hasnsec = true;
+			dns_rdataset_disassociate(&signsecset);
+		}
+		dns_rdataset_disassociate(&nsecset);
+	}
+
+	setnsec3parameters(db, version);
+
+	/*
+	 * Do we have a valid NSEC/NSEC3 chain?
+	 */
+	if (version->havensec3 || hasnsec) {
+		version->secure = dns_db_secure;
+	} else {
+		version->secure = dns_db_insecure;
+	}
+}
+
+/*%<
+ * Walk the origin node looking for NSEC3PARAM records.
+ * Cache the nsec3 parameters.
+ */
+static void
+setnsec3parameters(dns_db_t *db, qpdb_version_t *version) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)db;
+	dns_rdata_nsec3param_t nsec3param;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	isc_region_t region;
+	isc_result_t result;
+	qpdb_header_t *top = NULL, *header = NULL;
+	unsigned char *raw; /* RDATASLAB */
+	unsigned int count, length;
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	version->havensec3 = false;
+	for (top = node_data(qpdb->origin_node); top != NULL;
+	     top = header_next(top)) {
+		if (top->type != dns_rdatatype_nsec3param) {
+			continue;
+		}
+		header = visible(top, version->serial);
+		if (header == NULL) {
+			break;
+		}
+
+		/*
+		 * Find A NSEC3PARAM with a supported algorithm.
+		 */
+		raw = (unsigned char *)header + sizeof(*header);
+		count = raw[0] * 256 + raw[1]; /* count */
+		raw += DNS_RDATASET_COUNT + DNS_RDATASET_LENGTH;
+		while (count-- > 0U) {
+			length = raw[0] * 256 + raw[1];
+			raw += DNS_RDATASET_ORDER + DNS_RDATASET_LENGTH;
+			region.base = raw;
+			region.length = length;
+			raw += length;
+			dns_rdata_fromregion(&rdata, qpdb->common.rdclass,
+					     dns_rdatatype_nsec3param, &region);
+			result = dns_rdata_tostruct(&rdata, &nsec3param, NULL);
+			INSIST(result == ISC_R_SUCCESS);
+			dns_rdata_reset(&rdata);
+
+			if (nsec3param.hash != DNS_NSEC3_UNKNOWNALG &&
+			    !dns_nsec3_supportedhash(nsec3param.hash))
+			{
+				continue;
+			}
+
+			if (nsec3param.flags != 0) {
+				continue;
+			}
+
+			memmove(version->salt, nsec3param.salt,
+				nsec3param.salt_length);
+			version->hash = nsec3param.hash;
+			version->salt_length = nsec3param.salt_length;
+			version->iterations = nsec3param.iterations;
+			version->flags = nsec3param.flags;
+			version->havensec3 = true;
+			/*
+			 * Look for a better algorithm than the
+			 * unknown test algorithm.
+			 */
+			if (nsec3param.hash != DNS_NSEC3_UNKNOWNALG) {
+				goto unlock;
+			}
+		}
+		break;
+	}
+unlock:
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+}
+
+/*
+ * DB Routines
+ */
+
+static void
+free_qpdb(dns_qpdb_t *qpdb) {
+	dns_qp_t *trees[2] = { qpdb->tree, qpdb->nsec3 };
+	dns_qpiter_t iter;
+	qpdb_node_t *node = NULL;
+	qpdb_version_t *version = CURRENT_VERSION(qpdb);
+	qpdb_retired_t *r = NULL;
+
+	/*
+	 * Nothing can be looking at the database any more, so retired
+	 * memory can go at once.
+	 */
+	atomic_store_relaxed(&qpdb->lockless, false);
+	if (qpdb->retiring != NULL) {
+		reclaim(qpdb, qpdb->retiring);
+		qpdb->retiring = NULL;
+	}
+	while ((r = ISC_LIST_HEAD(qpdb->retired)) != NULL) {
+		ISC_LIST_UNLINK(qpdb->retired, r, link);
+		reclaim(qpdb, r);
+	}
+	if (qpdb->zombies != NULL) {
+		reap_zombies(qpdb);
+	}
+	INSIST(qpdb->zombies == NULL);
+
+	for (size_t i = 0; i < ARRAY_SIZE(trees); i++) {
+		if (trees[i] == NULL) {
+			continue;
+		}
+		dns_qpiter_init(trees[i], &iter);
+		while (dns_qpiter_next(&iter, (void **)&node) == ISC_R_SUCCESS)
+		{
+			free_node(qpdb, node);
+		}
+		dns_qp_destroy(&trees[i]);
+	}
+
+	if (version != NULL) {
+		ISC_LIST_UNLINK(qpdb->open_versions, version, link);
+		isc_refcount_decrement(&version->references);
+		free_version(qpdb, version);
+	}
+	INSIST(qpdb->future_version == NULL);
+	INSIST(ISC_LIST_EMPTY(qpdb->open_versions));
+
+	if (dns_name_dynamic(&qpdb->common.origin)) {
+		dns_name_free(&qpdb->common.origin, qpdb->common.mctx);
+	}
+
+	isc_refcount_destroy(&qpdb->references);
+	isc_rwlock_destroy(&qpdb->lock);
+	qpdb->common.magic = 0;
+	qpdb->common.impmagic = 0;
+	isc_mem_putanddetach(&qpdb->common.mctx, qpdb, sizeof(*qpdb));
+}
+
+static void
+db_unref(dns_qpdb_t *qpdb) {
+	if (isc_refcount_decrement(&qpdb->references) == 1) {
+		free_qpdb(qpdb);
+	}
+}
+
+static void
+attach(dns_db_t *source, dns_db_t **targetp) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)source;
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	isc_refcount_increment(&qpdb->references);
+
+	*targetp = source;
+}
+
+static void
+detach(dns_db_t **dbp) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)(*dbp);
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	*dbp = NULL;
+	db_unref(qpdb);
+}
+
+static void
+currentversion(dns_db_t *db, dns_dbversion_t **versionp) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)db;
+	qpdb_version_t *version = NULL;
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	if (read_begin(qpdb)) {
+		/*
+		 * The version may be losing its last reference to a
+		 * commit; only take one if it still has some.  Otherwise
+		 * the lock is held until the new current version is set.
+		 */
+		uint_fast32_t refs;
+
+		version = CURRENT_VERSION(qpdb);
+		refs = isc_refcount_current(&version->references);
+		while (refs > 0 &&
+		       !atomic_compare_exchange_weak_acq_rel(
+			       &version->references, &refs, refs + 1))
+		{
+		}
+		read_end(qpdb, true);
+		if (refs > 0) {
+			*versionp = (dns_dbversion_t *)version;
+			return;
+		}
+		RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	}
+	version = CURRENT_VERSION(qpdb);
+	isc_refcount_increment(&version->references);
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	*versionp = (dns_dbversion_t *)version;
+}
+
+static isc_result_t
+newversion(dns_db_t *db, dns_dbversion_t **versionp) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)db;
+	qpdb_version_t *version = NULL, *current = NULL;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	REQUIRE(versionp != NULL && *versionp == NULL);
+	REQUIRE(qpdb->future_version == NULL);
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
+	RUNTIME_CHECK(qpdb->next_serial != 0); /* XXX Error? */
+	version = allocate_version(qpdb->common.mctx, qpdb->next_serial, 1,
+				   true);
+	version->qpdb = qpdb;
+	version->commit_ok = true;
+	current = CURRENT_VERSION(qpdb);
+	version->secure = current->secure;
+	version->havensec3 = current->havensec3;
+	if (version->havensec3) {
+		version->flags = current->flags;
+		version->iterations = current->iterations;
+		version->hash = current->hash;
+		version->salt_length = current->salt_length;
+		memmove(version->salt, current->salt, version->salt_length);
+	}
+	version->records = current->records;
+	version->xfrsize = current->xfrsize;
+	qpdb->next_serial++;
+	qpdb->future_version = version;
+	write_unlock(qpdb);
+
+	*versionp = version;
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+attachversion(dns_db_t *db, dns_dbversion_t *source,
+	      dns_dbversion_t **targetp) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)db;
+	qpdb_version_t *version = source;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	INSIST(version != NULL && version->qpdb == qpdb);
+
+	isc_refcount_increment(&version->references);
+
+	*targetp = version;
+}
+
+static void
+closeversion(dns_db_t *db, dns_dbversion_t **versionp, bool commit) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)db;
+	qpdb_version_t *version = NULL, *cleanup_version = NULL;
+	qpdb_version_t *least_greater = NULL;
+	qpdb_changedlist_t cleanup_list;
+	qpdb_changed_t *changed = NULL, *next_changed = NULL;
+	qpdb_serial_t serial;
+	bool rollback = false;
+	unsigned int released = 0;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	version = (qpdb_version_t *)*versionp;
+	INSIST(version->qpdb == qpdb);
+
+	ISC_LIST_INIT(cleanup_list);
+
+	if (isc_refcount_decrement(&version->references) > 1) {
+		/* typical and easy case first */
+		if (commit) {
+			RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+			INSIST(!version->writer);
+			RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+		}
+		goto end;
+	}
+
+	/*
+	 * Update the zone's secure status in version before making
+	 * it the current version.
+	 */
+	if (version->writer && commit) {
+		iszonesecure(db, version, qpdb->origin_node);
+	}
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
+	serial = version->serial;
+	if (version->writer) {
+		if (commit) {
+			unsigned int cur_ref;
+			qpdb_version_t *cur_version = NULL;
+
+			INSIST(version->commit_ok);
+			INSIST(version == qpdb->future_version);
+			/*
+			 * The current version is going to be replaced.
+			 * Release the (likely last) reference to it from the
+			 * DB itself and unlink it from the open list.
+			 */
+			cur_version = CURRENT_VERSION(qpdb);
+			cur_ref = isc_refcount_decrement(
+				&cur_version->references);
+			if (cur_ref == 1) {
+				if (cur_version->serial == qpdb->least_serial)
+				{
+					INSIST(ISC_LIST_EMPTY(
+						cur_version->changed_list));
+				}
+				ISC_LIST_UNLINK(qpdb->open_versions,
+						cur_version, link);
+			}
+			if (ISC_LIST_EMPTY(qpdb->open_versions)) {
+				/*
+				 * We're going to become the least open
+				 * version.
+				 */
+				make_least_version(qpdb, version,
+						   &cleanup_list);
+			} else {
+				/*
+				 * Some other open version is the
+				 * least version.  We can't cleanup
+				 * records that were changed in this
+				 * version because the older versions
+				 * may still be in use by an open
+				 * version.
+				 *
+				 * We can, however, discard the
+				 * changed records for things that
+				 * we've added that didn't exist in
+				 * prior versions.
+				 */
+				cleanup_nondirty(version, &cleanup_list);
+			}
+			/*
+			 * If the (soon to be former) current version
+			 * isn't being used by anyone, we can clean
+			 * it up.
+			 */
+			if (cur_ref == 1) {
+				cleanup_version = cur_version;
+				ISC_LIST_APPENDLIST(
+					version->changed_list,
+					cleanup_version->changed_list, link);
+			}
+			/*
+			 * Become the current version.
+			 */
+			version->writer = false;
+			qpdb->current_serial = version->serial;
+			qpdb->future_version = NULL;
+
+			/*
+			 * Keep the current version in the open list, and
+			 * gain a reference for the DB itself (see the DB
+			 * creation function below).  This must be the only
+			 * case where we need to increment the counter from
+			 * zero and need to use isc_refcount_increment0().
+			 * The reference is taken before the version is
+			 * published to lock-free lookups.
+			 */
+			INSIST(isc_refcount_increment0(&version->references) ==
+			       0);
+			ISC_LIST_PREPEND(qpdb->open_versions, version, link);
+			atomic_store_release(&qpdb->current_version,
+					     (uintptr_t)version);
+		} else {
+			/*
+			 * We're rolling back this transaction.
+			 */
+			cleanup_list = version->changed_list;
+			ISC_LIST_INIT(version->changed_list);
+			rollback = true;
+			cleanup_version = version;
+			qpdb->future_version = NULL;
+		}
+	} else {
+		if (version != CURRENT_VERSION(qpdb)) {
+			/*
+			 * There are no external or internal references
+			 * to this version and it can be cleaned up.
+			 */
+			cleanup_version = version;
+
+			/*
+			 * Find the version with the least serial
+			 * number greater than ours.
+			 */
+			least_greater = ISC_LIST_PREV(version, link);
+			if (least_greater == NULL) {
+				least_greater = CURRENT_VERSION(qpdb);
+			}
+
+			INSIST(version->serial < least_greater->serial);
+			/*
+			 * Is this the least open version?
+			 */
+			if (version->serial == qpdb->least_serial) {
+				/*
+				 * Yes.  Install the new least open
+				 * version.
+				 */
+				make_least_version(qpdb, least_greater,
+						   &cleanup_list);
+			} else {
+				/*
+				 * Add any unexecuted cleanups to
+				 * those of the least greater version.
+				 */
+				ISC_LIST_APPENDLIST(least_greater->changed_list,
+						    version->changed_list,
+						    link);
+			}
+		} else if (version->serial == qpdb->least_serial) {
+			INSIST(ISC_LIST_EMPTY(version->changed_list));
+		}
+		ISC_LIST_UNLINK(qpdb->open_versions, version, link);
+	}
+
+	for (changed = ISC_LIST_HEAD(cleanup_list); changed != NULL;
+	     changed = next_changed)
+	{
+		next_changed = ISC_LIST_NEXT(changed, link);
+		if (rollback) {
+			rollback_node(changed->node, serial);
+		}
+		release_node(qpdb, changed->node);
+		isc_mem_put(qpdb->common.mctx, changed, sizeof(*changed));
+		released++;
+	}
+	if (cleanup_version != NULL) {
+		free_version(qpdb, cleanup_version);
+	}
+	write_unlock(qpdb);
+
+	/*
+	 * The caller still holds a reference to the database, so this
+	 * can't be the last one.
+	 */
+	while (released-- > 0) {
+		INSIST(isc_refcount_decrement(&qpdb->references) > 1);
+	}
+
+end:
+	*versionp = NULL;
+}
+
+static void
+add_wildcard_magic(dns_qpdb_t *qpdb, const dns_name_t *name) {
+	dns_name_t foundname;
+	dns_offsets_t offsets;
+	unsigned int n;
+	qpdb_node_t *node = NULL;
+
+	dns_name_init(&foundname, offsets);
+	n = dns_name_countlabels(name);
+	INSIST(n >= 2);
+	n--;
+	dns_name_getlabelsequence(name, 1, n, &foundname);
+	node = get_node(qpdb, qpdb->tree, &foundname);
+	atomic_store_relaxed(&node->wild, true);
+}
+
+/*
+ * The database must be write locked.
+ */
+static void
+add_empty_wildcards(dns_qpdb_t *qpdb, const dns_name_t *name) {
+	dns_name_t foundname;
+	dns_offsets_t offsets;
+	unsigned int n, l, i;
+
+	dns_name_init(&foundname, offsets);
+	n = dns_name_countlabels(name);
+	l = dns_name_countlabels(&qpdb->common.origin);
+	i = l + 1;
+	while (i < n) {
+		dns_name_getlabelsequence(name, n - i, i, &foundname);
+		if (dns_name_iswildcard(&foundname)) {
+			add_wildcard_magic(qpdb, &foundname);
+			(void)get_node(qpdb, qpdb->tree, &foundname);
+		}
+		i++;
+	}
+}
+
+static isc_result_t
+findnodeintree(dns_qpdb_t *qpdb, dns_qp_t *tree, const dns_name_t *name,
+	       bool create, dns_dbnode_t **nodep) {
+	qpdb_node_t *node = NULL;
+	dns_qpkey_t key;
+	size_t keylen;
+	isc_result_t result;
+
+	keylen = dns_qpkey_fromname(key, name);
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	result = dns_qp_getkey(tree, key, keylen, (void **)&node);
+	if (result == ISC_R_SUCCESS) {
+		new_reference(qpdb, node);
+	}
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	if (result == ISC_R_SUCCESS || !create) {
+		*nodep = (dns_dbnode_t *)node;
+		return (result);
+	}
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
+	node = get_node(qpdb, tree, name);
+	if (tree == qpdb->tree) {
+		add_empty_wildcards(qpdb, name);
+		if (dns_name_iswildcard(name)) {
+			add_wildcard_magic(qpdb, name);
+		}
+	}
+	new_reference(qpdb, node);
+	write_unlock(qpdb);
+
+	*nodep = (dns_dbnode_t *)node;
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+findnode(dns_db_t *db, const dns_name_t *name, bool create,
+	 dns_dbnode_t **nodep) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)db;
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	return (findnodeintree(qpdb, qpdb->tree, name, create, nodep));
+}
+
+static isc_result_t
+findnsec3node(dns_db_t *db, const dns_name_t *name, bool create,
+	      dns_dbnode_t **nodep) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)db;
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	return (findnodeintree(qpdb, qpdb->nsec3, name, create, nodep));
+}
+
+/*
+ * Searching
+ */
+
+/*
+ * Check whether the ancestor 'node' of the name being searched for is
+ * a zone cut or has wildcard children.  Returns DNS_R_PARTIALMATCH if
+ * the search should stop at 'node'.
+ */
+static isc_result_t
+check_zonecut(qpdb_search_t *search, qpdb_node_t *node) {
+	qpdb_header_t *top = NULL, *header = NULL;
+	qpdb_header_t *dname_header = NULL, *sigdname_header = NULL;
+	qpdb_header_t *ns_header = NULL;
+	qpdb_node_t *onode = search->qpdb->origin_node;
+
+	if (search->zonecut != NULL) {
+		return (ISC_R_SUCCESS);
+	}
+
+	for (top = node_data(node); top != NULL; top = header_next(top)) {
+		if (top->type != dns_rdatatype_ns &&
+		    top->type != dns_rdatatype_dname &&
+		    top->type != QPDB_RDATATYPE_SIGDNAME)
+		{
+			continue;
+		}
+		header = visible(top, search->serial);
+		if (header == NULL) {
+			continue;
+		}
+		if (header->type == dns_rdatatype_dname) {
+			dname_header = header;
+		} else if (header->type == QPDB_RDATATYPE_SIGDNAME) {
+			sigdname_header = header;
+		} else if (node != onode || IS_STUB(search->qpdb)) {
+			/*
+			 * We've found an NS rdataset that isn't at the
+			 * origin node.
+			 */
+			ns_header = header;
+		}
+	}
+
+	/*
+	 * Did we find anything?
+	 */
+	if (!IS_STUB(search->qpdb) && ns_header != NULL) {
+		/*
+		 * Note that NS has precedence over DNAME if both exist
+		 * in a zone.  Otherwise DNAME take precedence over NS.
+		 */
+		search->zonecut_header = ns_header;
+		search->zonecut_sigheader = NULL;
+	} else if (dname_header != NULL) {
+		search->zonecut_header = dname_header;
+		search->zonecut_sigheader = sigdname_header;
+	} else if (ns_header != NULL) {
+		search->zonecut_header = ns_header;
+		search->zonecut_sigheader = NULL;
+	}
+
+	if (search->zonecut_header != NULL) {
+		search->zonecut = node;
+		/*
+		 * Since we've found a zonecut, anything beneath it is
+		 * glue and is not subject to wildcard matching, so we
+		 * may clear search->wild.
+		 */
+		search->wild = false;
+		if ((search->options & DNS_DBFIND_GLUEOK) == 0) {
+			/*
+			 * If the caller does not want to find glue, then
+			 * this is the best answer and the search should
+			 * stop now.
+			 */
+			return (DNS_R_PARTIALMATCH);
+		}
+	} else if (WILD(node) && (search->options & DNS_DBFIND_NOWILD) == 0) {
+		/*
+		 * If we've been here before, or if the node has
+		 * wildcard children, remember it.
+		 */
+		search->wild = true;
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+setup_delegation(qpdb_search_t *search, dns_dbnode_t **nodep,
+		 dns_name_t *foundname, dns_rdataset_t *rdataset,
+		 dns_rdataset_t *sigrdataset) {
+	qpdb_node_t *node = search->zonecut;
+	dns_rdatatype_t type = search->zonecut_header->type;
+	dns_name_t name;
+
+	/*
+	 * The caller MUST NOT be holding any node locks.
+	 */
+
+	if (foundname != NULL) {
+		dns_name_init(&name, NULL);
+		nodename(node, &name);
+		dns_name_copy(&name, foundname);
+	}
+	if (nodep != NULL) {
+		new_reference(search->qpdb, node);
+		*nodep = node;
+	}
+	bind_rdataset(search->qpdb, node, search->zonecut_header, rdataset);
+	if (sigrdataset != NULL && search->zonecut_sigheader != NULL) {
+		bind_rdataset(search->qpdb, node, search->zonecut_sigheader,
+			      sigrdataset);
+	}
+
+	if (type == dns_rdatatype_dname) {
+		return (DNS_R_DNAME);
+	}
+	return (DNS_R_DELEGATION);
+}
+
+static bool
+valid_glue(qpdb_search_t *search, dns_name_t *name, qpdb_rdatatype_t type,
+	   qpdb_node_t *node) {
+	unsigned char *raw; /* RDATASLAB */
+	unsigned int count, size;
+	dns_name_t ns_name;
+	dns_offsets_t offsets;
+	isc_region_t region;
+	qpdb_header_t *header = NULL;
+
+	/*
+	 * Valid glue types are A, AAAA, A6.  NS is also a valid glue type
+	 * if it occurs at a zone cut, but is not valid below it.
+	 */
+	if (type == dns_rdatatype_ns) {
+		if (node != search->zonecut) {
+			return (false);
+		}
+	} else if (type != dns_rdatatype_a && type != dns_rdatatype_aaaa &&
+		   type != dns_rdatatype_a6)
+	{
+		return (false);
+	}
+
+	header = search->zonecut_header;
+	raw = (unsigned char *)header + sizeof(*header);
+	count = raw[0] * 256 + raw[1];
+	raw += DNS_RDATASET_COUNT + DNS_RDATASET_LENGTH;
+
+	while (count > 0) {
+		count--;
+		size = raw[0] * 256 + raw[1];
+		raw += DNS_RDATASET_ORDER + DNS_RDATASET_LENGTH;
+		region.base = raw;
+		region.length = size;
+		raw += size;
+		/*
+		 * XXX Until we have rdata structures, we have no choice but
+		 * to directly access the rdata format.
+		 */
+		dns_name_init(&ns_name, offsets);
+		dns_name_fromregion(&ns_name, &region);
+		if (dns_name_compare(&ns_name, name) == 0) {
+			return (true);
+		}
+	}
+
+	return (false);
+}
+
+/*
+ * Return the first node holding data after the position of 'iter',
+ * moving 'iter' to it.
+ */
+static qpdb_node_t *
+next_active(qpdb_search_t *search, dns_qpiter_t *iter) {
+	qpdb_node_t *node = NULL;
+
+	while (dns_qpiter_next(iter, (void **)&node) == ISC_R_SUCCESS) {
+		if (node_active(node, search->serial)) {
+			return (node);
+		}
+	}
+	return (NULL);
+}
+
+/*
+ * Return the last node holding data at or before the position of 'iter',
+ * moving 'iter' to it.
+ */
+static qpdb_node_t *
+prev_active(qpdb_search_t *search, dns_qpiter_t *iter) {
+	qpdb_node_t *node = NULL;
+	isc_result_t result;
+
+	result = dns_qpiter_current(iter, (void **)&node);
+	while (result == ISC_R_SUCCESS) {
+		if (node_active(node, search->serial)) {
+			return (node);
+		}
+		result = dns_qpiter_prev(iter, (void **)&node);
+	}
+	return (NULL);
+}
+
+static bool
+node_issubdomain(qpdb_node_t *node, const dns_name_t *name) {
+	dns_name_t nname;
+
+	dns_name_init(&nname, NULL);
+	nodename(node, &nname);
+	return (dns_name_issubdomain(&nname, name));
+}
+
+/*
+ * Is 'name' an empty non-terminal, that is, does the first node holding
+ * data after the position of 'iter' lie below it?
+ */
+static bool
+activeempty(qpdb_search_t *search, const dns_qpiter_t *iter,
+	    const dns_name_t *name) {
+	dns_qpiter_t next = *iter;
+	qpdb_node_t *node = next_active(search, &next);
+
+	return (node != NULL && node_issubdomain(node, name));
+}
+
+/*
+ * Check whether a name between 'qname' and the wildcard 'wname' exists
+ * as an empty non-terminal, in which case the wildcard does not apply.
+ */
+static bool
+activeemptynode(qpdb_search_t *search, const dns_name_t *qname,
+		dns_name_t *wname) {
+	dns_qpiter_t iter;
+	qpdb_node_t *prev = NULL, *next = NULL;
+	dns_name_t rname, tname;
+	unsigned int n;
+	bool check_next = true, check_prev = true;
+	bool answer = false;
+
+	iter = search->iter;
+	prev = prev_active(search, &iter);
+	iter = search->iter;
+	next = next_active(search, &iter);
+
+	dns_name_init(&rname, NULL);
+	dns_name_init(&tname, NULL);
+	n = dns_name_countlabels(wname);
+	dns_name_getlabelsequence(wname, 1, n - 1, &tname);
+	n = dns_name_countlabels(qname);
+	dns_name_getlabelsequence(qname, 0, n, &rname);
+
+	if (prev == NULL) {
+		check_prev = false;
+	}
+	if (next == NULL) {
+		check_next = false;
+	}
+
+	do {
+		if (check_prev && node_issubdomain(prev, &rname)) {
+			answer = true;
+			break;
+		}
+		if (check_next && node_issubdomain(next, &rname)) {
+			answer = true;
+			break;
+		}
+		n = dns_name_countlabels(&rname);
+		INSIST(n > 0);
+		dns_name_getlabelsequence(&rname, 1, n - 1, &rname);
+	} while (!dns_name_equal(&rname, &tname));
+
+	return (answer);
+}
+
+static isc_result_t
+find_wildcard(qpdb_search_t *search, qpdb_node_t **nodep,
+	      const dns_name_t *qname) {
+	qpdb_node_t *node = *nodep, *wnode = NULL;
+	dns_fixedname_t fwname;
+	dns_name_t *wname = NULL;
+	dns_name_t name;
+	dns_qpiter_t witer;
+	dns_qpkey_t key;
+	size_t keylen;
+	unsigned int i;
+	isc_result_t result;
+	bool active;
+
+	/*
+	 * Caller must be holding the database lock.
+	 */
+
+	/*
+	 * Examine each ancestor level.  If the level's wild bit
+	 * is set, then construct the corresponding wildcard name and
+	 * search for it.  If the wildcard node exists, and is active in
+	 * this version, we're done.  If not, then we next check to see
+	 * if the ancestor is active in this version.  If so, then there
+	 * can be no possible wildcard match and again we're done.  If not,
+	 * continue the search.
+	 */
+	i = search->chain.len;
+	if (i > 0 && search->chain.chain[i - 1] == node) {
+		i--;
+	}
+	wname = dns_fixedname_initname(&fwname);
+	dns_name_init(&name, NULL);
+
+	for (;;) {
+		active = node_active(node, search->serial);
+
+		if (WILD(node)) {
+			/*
+			 * Construct the wildcard name for this level.
+			 */
+			nodename(node, &name);
+			result = dns_name_concatenate(dns_wildcardname, &name,
+						      wname, NULL);
+			if (result != ISC_R_SUCCESS) {
+				return (result);
+			}
+
+			keylen = dns_qpkey_fromname(key, wname);
+			wnode = NULL;
+			result = dns_qp_lookup(search->qpdb->tree, key, keylen,
+					       &witer, NULL, (void **)&wnode);
+			if (result == ISC_R_SUCCESS) {
+				/*
+				 * We have found the wildcard node.  If it
+				 * is active in the search's version, we're
+				 * done.
+				 */
+				if (node_active(wnode, search->serial) ||
+				    activeempty(search, &witer, wname))
+				{
+					if (activeemptynode(search, qname,
+							    wname)) {
+						return (ISC_R_NOTFOUND);
+					}
+					/*
+					 * The wildcard node is active!
+					 *
+					 * Note: result is still ISC_R_SUCCESS
+					 * so we don't have to set it.
+					 */
+					*nodep = wnode;
+					return (ISC_R_SUCCESS);
+				}
+			}
+		}
+
+		if (active || i == 0) {
+			return (ISC_R_NOTFOUND);
+		}
+		node = search->chain.chain[--i];
+	}
+}
+
+static bool
+matchparams(qpdb_header_t *header, qpdb_search_t *search) {
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdata_nsec3_t nsec3;
+	unsigned char *raw; /* RDATASLAB */
+	unsigned int rdlen, count;
+	isc_region_t region;
+	isc_result_t result;
+
+	REQUIRE(header->type == dns_rdatatype_nsec3);
+
+	raw = (unsigned char *)header + sizeof(*header);
+	count = raw[0] * 256 + raw[1]; /* count */
+	raw += DNS_RDATASET_COUNT + DNS_RDATASET_LENGTH;
+
+	while (count-- > 0) {
+		rdlen = raw[0] * 256 + raw[1];
+		raw += DNS_RDATASET_ORDER + DNS_RDATASET_LENGTH;
+		region.base = raw;
+		region.length = rdlen;
+		dns_rdata_fromregion(&rdata, search->qpdb->common.rdclass,
+				     dns_rdatatype_nsec3, &region);
+		raw += rdlen;
+		result = dns_rdata_tostruct(&rdata, &nsec3, NULL);
+		INSIST(result == ISC_R_SUCCESS);
+		if (nsec3.hash == search->version->hash &&
+		    nsec3.iterations == search->version->iterations &&
+		    nsec3.salt_length == search->version->salt_length &&
+		    memcmp(nsec3.salt, search->version->salt,
+			   nsec3.salt_length) == 0)
+		{
+			return (true);
+		}
+		dns_rdata_reset(&rdata);
+	}
+	return (false);
+}
+
+/*
+ * Find the NSEC or NSEC3 record covering the name being searched for,
+ * starting at the predecessor the search was left at.
+ */
+static isc_result_t
+find_closest_nsec(qpdb_search_t *search, dns_dbnode_t **nodep,
+		  dns_name_t *foundname, dns_rdataset_t *rdataset,
+		  dns_rdataset_t *sigrdataset, bool nsec3, bool secure) {
+	qpdb_node_t *node = NULL;
+	qpdb_header_t *top = NULL, *header = NULL;
+	qpdb_header_t *found = NULL, *foundsig = NULL;
+	dns_qpiter_t iter = search->iter;
+	dns_rdatatype_t type = dns_rdatatype_nsec;
+	qpdb_rdatatype_t sigtype = QPDB_RDATATYPE_SIGNSEC;
+	dns_name_t name;
+	bool wraps = false;
+	bool empty_node;
+	isc_result_t result;
+
+	/*
+	 * Caller must be holding the database lock.
+	 */
+
+	if (nsec3) {
+		type = dns_rdatatype_nsec3;
+		sigtype = QPDB_RDATATYPE_SIGNSEC3;
+		wraps = true;
+	}
+
+	result = dns_qpiter_current(&iter, (void **)&node);
+	if (result != ISC_R_SUCCESS && wraps) {
+		result = dns_qpiter_prev(&iter, (void **)&node);
+		wraps = false;
+	}
+
+	while (result == ISC_R_SUCCESS) {
+		/*
+		 * Don't bother with the NSEC3 trie's origin node; it
+		 * never holds data.
+		 */
+		found = NULL;
+		foundsig = NULL;
+		empty_node = true;
+		for (top = node_data(node); top != NULL;
+		     top = header_next(top)) {
+			header = visible(top, search->serial);
+			if (header == NULL) {
+				continue;
+			}
+			/*
+			 * We now know that there is at least one active
+			 * non-stale rdataset at this node.
+			 */
+			empty_node = false;
+			if (header->type == type) {
+				found = header;
+				if (foundsig != NULL) {
+					break;
+				}
+			} else if (header->type == sigtype) {
+				foundsig = header;
+				if (found != NULL) {
+					break;
+				}
+			}
+		}
+		if (!empty_node) {
+			if (found != NULL && search->version->havensec3 &&
+			    found->type == dns_rdatatype_nsec3 &&
+			    !matchparams(found, search))
+			{
+				empty_node = true;
+			} else if (found != NULL &&
+				   (foundsig != NULL || !secure)) {
+				/*
+				 * We've found the right NSEC/NSEC3 record.
+				 *
+				 * Note: for this to really be the right
+				 * NSEC record, it's essential that the NSEC
+				 * records of any nodes obscured by a zone
+				 * cut have been removed; we assume this is
+				 * the case.
+				 */
+				if (foundname != NULL) {
+					dns_name_init(&name, NULL);
+					nodename(node, &name);
+					dns_name_copy(&name, foundname);
+				}
+				if (nodep != NULL) {
+					new_reference(search->qpdb, node);
+					*nodep = node;
+				}
+				bind_rdataset(search->qpdb, node, found,
+					      rdataset);
+				if (foundsig != NULL) {
+					bind_rdataset(search->qpdb, node,
+						      foundsig, sigrdataset);
+				}
+				return (ISC_R_SUCCESS);
+			} else if (found == NULL && foundsig == NULL) {
+				/*
+				 * This node isn't active.  We've got to keep
+				 * looking.
+				 */
+				empty_node = true;
+			} else {
+				/*
+				 * We found an active node, but either the
+				 * NSEC or the RRSIG NSEC is missing.  This
+				 * shouldn't happen.
+				 */
+				return (DNS_R_BADDB);
+			}
+		}
+		INSIST(empty_node);
+		result = dns_qpiter_prev(&iter, (void **)&node);
+		if (result == ISC_R_NOMORE && wraps) {
+			/*
+			 * The NSEC3 chain wraps around: the predecessor
+			 * of the first hash is the last one.
+			 */
+			result = dns_qpiter_prev(&iter, (void **)&node);
+			wraps = false;
+		}
+	}
+
+	/*
+	 * If the result is ISC_R_NOMORE, then we got to the beginning of
+	 * the database and didn't find a NSEC record.  This shouldn't
+	 * happen.
+	 */
+	return (DNS_R_BADDB);
+}
+
+static isc_result_t
+zone_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
+	  dns_rdatatype_t type, unsigned int options, isc_stdtime_t now,
+	  dns_dbnode_t **nodep, dns_name_t *foundname,
+	  dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)db;
+	qpdb_node_t *node = NULL;
+	isc_result_t result;
+	qpdb_search_t search;
+	bool cname_ok = true;
+	bool close_version = false;
+	bool maybe_zonecut = false;
+	bool wild = false;
+	bool empty_node;
+	qpdb_header_t *top = NULL, *header = NULL;
+	qpdb_header_t *found = NULL, *nsecheader = NULL;
+	qpdb_header_t *foundsig = NULL, *cnamesig = NULL, *nsecsig = NULL;
+	qpdb_rdatatype_t sigtype;
+	bool active;
+	dns_qp_t *tree = NULL;
+	dns_qpkey_t key;
+	size_t keylen;
+	dns_name_t nname;
+	bool lockless;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	INSIST(version == NULL || ((qpdb_version_t *)version)->qpdb == qpdb);
+
+	UNUSED(now);
+
+	/*
+	 * If the caller didn't supply a version, attach to the current
+	 * version.
+	 */
+	if (version == NULL) {
+		currentversion(db, &version);
+		close_version = true;
+	}
+
+	search.qpdb = qpdb;
+	search.version = version;
+	search.serial = search.version->serial;
+	search.options = options;
+	search.wild = false;
+	search.zonecut = NULL;
+	search.zonecut_header = NULL;
+	search.zonecut_sigheader = NULL;
+
+	tree = (options & DNS_DBFIND_FORCENSEC3) != 0 ? qpdb->nsec3
+						      : qpdb->tree;
+	keylen = dns_qpkey_fromname(key, name);
+	dns_name_init(&nname, NULL);
+
+	lockless = read_begin(qpdb);
+
+	/*
+	 * Search down from the root of the tree.  Each ancestor holding
+	 * a zone cut or wildcard children is checked on the way.
+	 */
+	result = dns_qp_lookup(tree, key, keylen, &search.iter, &search.chain,
+			       (void **)&node);
+	for (unsigned int i = 0; i < search.chain.len; i++) {
+		qpdb_node_t *ancestor = search.chain.chain[i];
+
+		if ((DELEGATING(ancestor) || WILD(ancestor)) &&
+		    check_zonecut(&search, ancestor) == DNS_R_PARTIALMATCH)
+		{
+			result = setup_delegation(&search, nodep, foundname,
+						  rdataset, sigrdataset);
+			goto tree_exit;
+		}
+	}
+	if (node != NULL) {
+		nodename(node, &nname);
+		dns_name_copy(&nname, foundname);
+	}
+
+	/*
+	 * Check the QP-trie search result.
+	 */
+	if (result == DNS_R_PARTIALMATCH) {
+	partial_match:
+		if (search.zonecut != NULL) {
+			result = setup_delegation(&search, nodep, foundname,
+						  rdataset, sigrdataset);
+			goto tree_exit;
+		}
+
+		if (search.wild) {
+			/*
+			 * At least one of the levels in the search chain
+			 * potentially has a wildcard.  For each such level,
+			 * we check to see if there's a matching wildcard
+			 * active in the current version.
+			 */
+			result = find_wildcard(&search, &node, name);
+			if (result == ISC_R_SUCCESS) {
+				dns_name_copy(name, foundname);
+				wild = true;
+				goto found;
+			} else if (result != ISC_R_NOTFOUND) {
+				goto tree_exit;
+			}
+		}
+
+		active = false;
+		if ((options & DNS_DBFIND_FORCENSEC3) == 0) {
+			/*
+			 * The search iterator is positioned at the
+			 * predecessor of the name; if the next node with
+			 * data is a subdomain of it, the name is an
+			 * empty non-terminal.
+			 */
+			active = activeempty(&search, &search.iter, name);
+		}
+
+		/*
+		 * If we're here, then the name does not exist, is not
+		 * beneath a zonecut, and there's no matching wildcard.
+		 */
+		if ((search.version->secure == dns_db_secure &&
+		     !search.version->havensec3) ||
+		    (options & DNS_DBFIND_FORCENSEC) != 0 ||
+		    (options & DNS_DBFIND_FORCENSEC3) != 0)
+		{
+			result = find_closest_nsec(
+				&search, nodep, foundname, rdataset,
+				sigrdataset, tree == qpdb->nsec3,
+				search.version->secure == dns_db_secure);
+			if (result == ISC_R_SUCCESS) {
+				result = active ? DNS_R_EMPTYNAME
+						: DNS_R_NXDOMAIN;
+			}
+		} else {
+			result = active ? DNS_R_EMPTYNAME : DNS_R_NXDOMAIN;
+		}
+		goto tree_exit;
+	} else if (result != ISC_R_SUCCESS) {
+		goto tree_exit;
+	}
+
+found:
+	/*
+	 * We have found a node whose name is the desired name, or we
+	 * have matched a wildcard.
+	 */
+
+	if (search.zonecut != NULL) {
+		/*
+		 * If we're beneath a zone cut, we don't want to look for
+		 * CNAMEs because they're not legitimate zone glue.
+		 */
+		cname_ok = false;
+	} else {
+		/*
+		 * The node may be a zone cut itself.  If it might be one,
+		 * make sure we check for it later.
+		 *
+		 * DS records live above the zone cut in ordinary zone so
+		 * we want to ignore any referral.
+		 *
+		 * Stub zones don't have anything "above" the delegation so
+		 * we always return a referral.
+		 */
+		if (DELEGATING(node) &&
+		    ((node != qpdb->origin_node &&
+		      !dns_rdatatype_atparent(type)) ||
+		     IS_STUB(qpdb)))
+		{
+			maybe_zonecut = true;
+		}
+	}
+
+	/*
+	 * Certain DNSSEC types are not subject to CNAME matching
+	 * (RFC4035, section 2.5 and RFC3007).
+	 *
+	 * We don't check for RRSIG, because we don't store RRSIG records
+	 * directly.
+	 */
+	if (type == dns_rdatatype_key || type == dns_rdatatype_nsec) {
+		cname_ok = false;
+	}
+
+	/*
+	 * We now go looking for rdata...
+	 */
+
+	sigtype = QPDB_RDATATYPE_VALUE(dns_rdatatype_rrsig, type);
+	empty_node = true;
+	for (top = node_data(node); top != NULL; top = header_next(top)) {
+		header = visible(top, search.serial);
+		if (header == NULL) {
+			continue;
+		}
+
+		/*
+		 * We now know that there is at least one active
+		 * rdataset at this node.
+		 */
+		empty_node = false;
+
+		/*
+		 * Do special zone cut handling, if requested.
+		 */
+		if (maybe_zonecut && header->type == dns_rdatatype_ns) {
+			search.zonecut = node;
+			search.zonecut_header = header;
+			search.zonecut_sigheader = NULL;
+			maybe_zonecut = false;
+			/*
+			 * It is not clear if KEY should still be
+			 * allowed at the parent side of the zone
+			 * cut or not.  It is needed for RFC3007
+			 * validated updates.
+			 */
+			if ((search.options & DNS_DBFIND_GLUEOK) == 0 &&
+			    type != dns_rdatatype_nsec &&
+			    type != dns_rdatatype_key)
+			{
+				/*
+				 * Glue is not OK, but any answer we
+				 * could return would be glue.  Return
+				 * the delegation.
+				 */
+				found = NULL;
+				break;
+			}
+			if (found != NULL && foundsig != NULL) {
+				break;
+			}
+		}
+
+		/*
+		 * If the NSEC3 record doesn't match the chain
+		 * we are using behave as if it isn't here.
+		 */
+		if (header->type == dns_rdatatype_nsec3 &&
+		    !matchparams(header, &search)) {
+			goto partial_match;
+		}
+		/*
+		 * If we found a type we were looking for,
+		 * remember it.
+		 */
+		if (header->type == type || type == dns_rdatatype_any ||
+		    (header->type == dns_rdatatype_cname && cname_ok))
+		{
+			/*
+			 * We've found the answer!
+			 */
+			found = header;
+			if (header->type == dns_rdatatype_cname && cname_ok) {
+				/*
+				 * We may be finding a CNAME instead
+				 * of the desired type.
+				 *
+				 * If we've already got the CNAME RRSIG,
+				 * use it, otherwise change sigtype
+				 * so that we find it.
+				 */
+				if (cnamesig != NULL) {
+					foundsig = cnamesig;
+				} else {
+					sigtype = QPDB_RDATATYPE_SIGCNAME;
+				}
+			}
+			/*
+			 * If we've got all we need, end the search.
+			 */
+			if (!maybe_zonecut && foundsig != NULL) {
+				break;
+			}
+		} else if (header->type == sigtype) {
+			/*
+			 * We've found the RRSIG rdataset for our
+			 * target type.  Remember it.
+			 */
+			foundsig = header;
+			/*
+			 * If we've got all we need, end the search.
+			 */
+			if (!maybe_zonecut && found != NULL) {
+				break;
+			}
+		} else if (header->type == dns_rdatatype_nsec &&
+			   !search.version->havensec3) {
+			/*
+			 * Remember a NSEC rdataset even if we're
+			 * not specifically looking for it, because
+			 * we might need it later.
+			 */
+			nsecheader = header;
+		} else if (header->type == QPDB_RDATATYPE_SIGNSEC &&
+			   !search.version->havensec3)
+		{
+			/*
+			 * If we need the NSEC rdataset, we'll also
+			 * need its signature.
+			 */
+			nsecsig = header;
+		} else if (cname_ok &&
+			   header->type == QPDB_RDATATYPE_SIGCNAME) {
+			/*
+			 * If we get a CNAME match, we'll also need
+			 * its signature.
+			 */
+			cnamesig = header;
+		}
+	}
+
+	if (empty_node) {
+		/*
+		 * We have an exact match for the name, but there are no
+		 * active rdatasets in the desired version.  That means that
+		 * this node doesn't exist in the desired version, and that
+		 * we really have a partial match.
+		 */
+		if (!wild) {
+			goto partial_match;
+		}
+	}
+
+	/*
+	 * If we didn't find what we were looking for...
+	 */
+	if (found == NULL) {
+		if (search.zonecut != NULL) {
+			/*
+			 * We were trying to find glue at a node beneath a
+			 * zone cut, but didn't.
+			 *
+			 * Return the delegation.
+			 */
+			result = setup_delegation(&search, nodep, foundname,
+						  rdataset, sigrdataset);
+			goto tree_exit;
+		}
+		/*
+		 * The desired type doesn't exist.
+		 */
+		result = DNS_R_NXRRSET;
+		if (search.version->secure == dns_db_secure &&
+		    !search.version->havensec3 &&
+		    (nsecheader == NULL || nsecsig == NULL))
+		{
+			/*
+			 * The zone is secure but there's no NSEC,
+			 * or the NSEC has no signature!
+			 */
+			if (!wild) {
+				result = DNS_R_BADDB;
+				goto tree_exit;
+			}
+
+			result = find_closest_nsec(&search, nodep, foundname,
+						   rdataset, sigrdataset, false,
+						   true);
+			if (result == ISC_R_SUCCESS) {
+				result = DNS_R_EMPTYWILD;
+			}
+			goto tree_exit;
+		}
+		if ((search.options & DNS_DBFIND_FORCENSEC) != 0 &&
+		    nsecheader == NULL) {
+			/*
+			 * There's no NSEC record, and we were told
+			 * to find one.
+			 */
+			result = DNS_R_BADDB;
+			goto tree_exit;
+		}
+		if (nodep != NULL) {
+			new_reference(qpdb, node);
+			*nodep = node;
+		}
+		if ((search.version->secure == dns_db_secure &&
+		     !search.version->havensec3) ||
+		    (search.options & DNS_DBFIND_FORCENSEC) != 0)
+		{
+			bind_rdataset(qpdb, node, nsecheader, rdataset);
+			if (nsecsig != NULL) {
+				bind_rdataset(qpdb, node, nsecsig,
+					      sigrdataset);
+			}
+		}
+		if (wild) {
+			foundname->attributes |= DNS_NAMEATTR_WILDCARD;
+		}
+		goto tree_exit;
+	}
+
+	/*
+	 * We found what we were looking for, or we found a CNAME.
+	 */
+
+	if (type != found->type && type != dns_rdatatype_any &&
+	    found->type == dns_rdatatype_cname)
+	{
+		/*
+		 * We weren't doing an ANY query and we found a CNAME
+		 * instead of the type we were looking for, so we need
+		 * to indicate that result to the caller.
+		 */
+		result = DNS_R_CNAME;
+	} else if (search.zonecut != NULL) {
+		/*
+		 * If we're beneath a zone cut, we must indicate that the
+		 * result is glue, unless we're actually at the zone cut
+		 * and the type is NSEC or KEY.
+		 */
+		if (search.zonecut == node) {
+			/*
+			 * It is not clear if KEY should still be
+			 * allowed at the parent side of the zone
+			 * cut or not.  It is needed for RFC3007
+			 * validated updates.
+			 */
+			if (type == dns_rdatatype_nsec ||
+			    type == dns_rdatatype_nsec3 ||
+			    type == dns_rdatatype_key)
+			{
+				result = ISC_R_SUCCESS;
+			} else if (type == dns_rdatatype_any) {
+				result = DNS_R_ZONECUT;
+			} else {
+				result = DNS_R_GLUE;
+			}
+		} else {
+			result = DNS_R_GLUE;
+		}
+		/*
+		 * We might have found data that isn't glue, but was occluded
+		 * by a dynamic update.  If the caller cares about this, they
+		 * will have told us to validate glue.
+		 *
+		 * XXX We should cache the glue validity state!
+		 */
+		if (result == DNS_R_GLUE &&
+		    (search.options & DNS_DBFIND_VALIDATEGLUE) != 0 &&
+		    !valid_glue(&search, foundname, type, node))
+		{
+			result = setup_delegation(&search, nodep, foundname,
+						  rdataset, sigrdataset);
+			goto tree_exit;
+		}
+	} else {
+		/*
+		 * An ordinary successful query!
+		 */
+		result = ISC_R_SUCCESS;
+	}
+
+	if (nodep != NULL) {
+		new_reference(qpdb, node);
+		*nodep = node;
+	}
+
+	if (type != dns_rdatatype_any) {
+		bind_rdataset(qpdb, node, found, rdataset);
+		if (foundsig != NULL) {
+			bind_rdataset(qpdb, node, foundsig, sigrdataset);
+		}
+	}
+
+	if (wild) {
+		foundname->attributes |= DNS_NAMEATTR_WILDCARD;
+	}
+
+tree_exit:
+	read_end(qpdb, lockless);
+
+	if (close_version) {
+		closeversion(db, &version, false);
+	}
+
+	return (result);
+}
+
+static isc_result_t
+zone_findzonecut(dns_db_t *db, const dns_name_t *name, unsigned int options,
+		 isc_stdtime_t now, dns_dbnode_t **nodep, dns_name_t *foundname,
+		 dns_name_t *dcname, dns_rdataset_t *rdataset,
+		 dns_rdataset_t *sigrdataset) {
+	UNUSED(db);
+	UNUSED(name);
+	UNUSED(options);
+	UNUSED(now);
+	UNUSED(nodep);
+	UNUSED(foundname);
+	UNUSED(dcname);
+	UNUSED(rdataset);
+	UNUSED(sigrdataset);
+
+	FATAL_ERROR(__FILE__, __LINE__, "zone_findzonecut() called!");
+
+	UNREACHABLE();
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+static void
+attachnode(dns_db_t *db, dns_dbnode_t *source, dns_dbnode_t **targetp) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)db;
+	qpdb_node_t *node = (qpdb_node_t *)source;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	REQUIRE(targetp != NULL && *targetp == NULL);
+
+	isc_refcount_increment(&node->references);
+	isc_refcount_increment(&qpdb->references);
+
+	*targetp = source;
+}
+
+static void
+detachnode(dns_db_t *db, dns_dbnode_t **targetp) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)db;
+	qpdb_node_t *node = NULL;
+	uint_fast32_t refs;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	REQUIRE(targetp != NULL && *targetp != NULL);
+
+	node = (qpdb_node_t *)(*targetp);
+	*targetp = NULL;
+
+	/*
+	 * Superseded rdatasets can only be freed once nobody refers to
+	 * the node, so the last reference to a dirty node is dropped
+	 * under the lock and the node cleaned.  The node can't be looked
+	 * at after dropping any other reference: if it has been taken out
+	 * of its trie, it may be freed at once.
+	 */
+	refs = isc_refcount_current(&node->references);
+	while (refs > 1 || !atomic_load_acquire(&node->dirty)) {
+		INSIST(refs > 0);
+		if (atomic_compare_exchange_weak_acq_rel(&node->references,
+							 &refs, refs - 1))
+		{
+			db_unref(qpdb);
+			return;
+		}
+	}
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
+	release_node(qpdb, node);
+	write_unlock(qpdb);
+
+	db_unref(qpdb);
+}
+
+static isc_result_t
+expirenode(dns_db_t *db, dns_dbnode_t *node, isc_stdtime_t now) {
+	UNUSED(db);
+	UNUSED(node);
+	UNUSED(now);
+
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+static void
+printnode(dns_db_t *db, dns_dbnode_t *node, FILE *out) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)db;
+	qpdb_node_t *qpnode = node;
+	qpdb_header_t *top = NULL, *header = NULL;
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	fprintf(out, "node %p, %" PRIuFAST32 " references\n", qpnode,
+		isc_refcount_current(&qpnode->references));
+	for (top = node_data(qpnode); top != NULL; top = header_next(top)) {
+		fprintf(out, "\ttype %u", top->type);
+		for (header = top; header != NULL;
+		     header = header_down(header)) {
+			fprintf(out, " serial %u%s%s", header->serial,
+				NONEXISTENT(header) ? " nonexistent" : "",
+				IGNORE(header) ? " ignore" : "");
+		}
+		fprintf(out, "\n");
+	}
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+}
+
+static isc_result_t
+createiterator(dns_db_t *db, unsigned int options,
+	       dns_dbiterator_t **iteratorp) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)db;
+	qpdb_dbiterator_t *qpdbiter = NULL;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	REQUIRE((options & (DNS_DB_NSEC3ONLY | DNS_DB_NONSEC3)) !=
+		(DNS_DB_NSEC3ONLY | DNS_DB_NONSEC3));
+
+	qpdbiter = isc_mem_get(qpdb->common.mctx, sizeof(*qpdbiter));
+
+	qpdbiter->common.methods = &dbiterator_methods;
+	qpdbiter->common.db = NULL;
+	dns_db_attach(db, &qpdbiter->common.db);
+	qpdbiter->common.relative_names = ((options & DNS_DB_RELATIVENAMES) !=
+					   0);
+	qpdbiter->common.magic = DNS_DBITERATOR_MAGIC;
+	qpdbiter->common.cleaning = false;
+	qpdbiter->result = ISC_R_NOMORE;
+	qpdbiter->new_origin = false;
+	qpdbiter->nsec3only = ((options & DNS_DB_NSEC3ONLY) != 0);
+	qpdbiter->nonsec3 = ((options & DNS_DB_NONSEC3) != 0);
+	qpdbiter->generation = 0;
+	qpdbiter->current = qpdbiter->nsec3only ? qpdb->nsec3 : qpdb->tree;
+	qpdbiter->node = NULL;
+	dns_qpiter_init(qpdbiter->current, &qpdbiter->iter);
+
+	*iteratorp = (dns_dbiterator_t *)qpdbiter;
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+zone_findrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+		  dns_rdatatype_t type, dns_rdatatype_t covers,
+		  isc_stdtime_t now, dns_rdataset_t *rdataset,
+		  dns_rdataset_t *sigrdataset) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)db;
+	qpdb_node_t *qpnode = (qpdb_node_t *)node;
+	qpdb_header_t *top = NULL, *header = NULL;
+	qpdb_header_t *found = NULL, *foundsig = NULL;
+	qpdb_serial_t serial;
+	qpdb_version_t *qpversion = version;
+	bool close_version = false;
+	qpdb_rdatatype_t matchtype, sigmatchtype;
+	bool lockless;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	REQUIRE(type != dns_rdatatype_any);
+	INSIST(qpversion == NULL || qpversion->qpdb == qpdb);
+
+	UNUSED(now);
+
+	if (qpversion == NULL) {
+		currentversion(db, (dns_dbversion_t **)&qpversion);
+		close_version = true;
+	}
+	serial = qpversion->serial;
+
+	matchtype = QPDB_RDATATYPE_VALUE(type, covers);
+	if (covers == 0) {
+		sigmatchtype = QPDB_RDATATYPE_VALUE(dns_rdatatype_rrsig, type);
+	} else {
+		sigmatchtype = 0;
+	}
+
+	lockless = read_begin(qpdb);
+	for (top = node_data(qpnode); top != NULL; top = header_next(top)) {
+		if (top->type != matchtype && top->type != sigmatchtype) {
+			continue;
+		}
+		header = visible(top, serial);
+		if (header == NULL) {
+			continue;
+		}
+		if (header->type == matchtype) {
+			found = header;
+			if (foundsig != NULL) {
+				break;
+			}
+		} else if (header->type == sigmatchtype) {
+			foundsig = header;
+			if (found != NULL) {
+				break;
+			}
+		}
+	}
+	if (found != NULL) {
+		bind_rdataset(qpdb, qpnode, found, rdataset);
+		if (foundsig != NULL) {
+			bind_rdataset(qpdb, qpnode, foundsig, sigrdataset);
+		}
+	}
+	read_end(qpdb, lockless);
+
+	if (close_version) {
+		closeversion(db, (dns_dbversion_t **)&qpversion, false);
+	}
+
+	if (found == NULL) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+allrdatasets(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+	     isc_stdtime_t now, dns_rdatasetiter_t **iteratorp) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)db;
+	qpdb_node_t *qpnode = (qpdb_node_t *)node;
+	qpdb_version_t *qpversion = version;
+	qpdb_rdatasetiter_t *iterator = NULL;
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	iterator = isc_mem_get(qpdb->common.mctx, sizeof(*iterator));
+
+	if (qpversion == NULL) {
+		currentversion(db, (dns_dbversion_t **)(&qpversion));
+	} else {
+		INSIST(qpversion->qpdb == qpdb);
+		isc_refcount_increment(&qpversion->references);
+	}
+
+	iterator->common.magic = DNS_RDATASETITER_MAGIC;
+	iterator->common.methods = &rdatasetiter_methods;
+	iterator->common.db = db;
+	iterator->common.node = node;
+	iterator->common.version = (dns_dbversion_t *)qpversion;
+	iterator->common.now = now;
+	iterator->top = NULL;
+	iterator->current = NULL;
+
+	isc_refcount_increment(&qpnode->references);
+	isc_refcount_increment(&qpdb->references);
+
+	*iteratorp = (dns_rdatasetiter_t *)iterator;
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+add32(dns_qpdb_t *qpdb, qpdb_node_t *node, qpdb_version_t *version,
+      qpdb_header_t *newheader, unsigned int options, bool loading,
+      dns_rdataset_t *addedrdataset) {
+	qpdb_changed_t *changed = NULL;
+	qpdb_header_t *topheader = NULL, *topheader_prev = NULL;
+	qpdb_header_t *header = NULL;
+	unsigned char *merged = NULL;
+	isc_result_t result;
+	bool header_nx;
+	bool newheader_nx;
+	bool merge;
+
+	/*
+	 * Add an rdataset header to a node.  The caller must be holding
+	 * the database write lock.
+	 */
+
+	merge = ((options & DNS_DBADD_MERGE) != 0);
+	if ((options & DNS_DBADD_FORCE) != 0) {
+		newheader->trust = dns_trust_ultimate;
+	}
+
+	if (!loading) {
+		/*
+		 * We always add a changed record, even if no changes end up
+		 * being made to this node, because it's harmless and
+		 * simplifies the code.
+		 */
+		changed = add_changed(qpdb, version, node);
+	}
+
+	newheader_nx = NONEXISTENT(newheader);
+	for (topheader = node_data(node); topheader != NULL;
+	     topheader = header_next(topheader)) {
+		if (topheader->type == newheader->type) {
+			break;
+		}
+		topheader_prev = topheader;
+	}
+
+	/*
+	 * If header isn't NULL, we've found the right type.  There may be
+	 * IGNORE rdatasets between the top of the chain and the first real
+	 * data.  We skip over them.
+	 */
+	header = topheader;
+	while (header != NULL && IGNORE(header)) {
+		header = header_down(header);
+	}
+	if (header != NULL) {
+		header_nx = NONEXISTENT(header);
+
+		/*
+		 * Deleting an already non-existent rdataset has no effect.
+		 */
+		if (header_nx && newheader_nx) {
+			free_header(qpdb, newheader);
+			return (DNS_R_UNCHANGED);
+		}
+
+		/*
+		 * Don't merge if a nonexistent rdataset is involved.
+		 */
+		if (merge && (header_nx || newheader_nx)) {
+			merge = false;
+		}
+
+		/*
+		 * If 'merge' is true, we'll try to create a new rdataset
+		 * that is the union of 'newheader' and 'header'.
+		 */
+		if (merge) {
+			unsigned int flags = 0;
+			INSIST(version->serial >= header->serial);
+			result = ISC_R_SUCCESS;
+
+			if ((options & DNS_DBADD_EXACT) != 0) {
+				flags |= DNS_RDATASLAB_EXACT;
+			}
+			if ((options & DNS_DBADD_EXACTTTL) != 0 &&
+			    newheader->ttl != header->ttl)
+			{
+				result = DNS_R_NOTEXACT;
+			} else if (newheader->ttl != header->ttl) {
+				flags |= DNS_RDATASLAB_FORCE;
+			}
+			if (result == ISC_R_SUCCESS) {
+				result = dns_rdataslab_merge(
+					(unsigned char *)header,
+					(unsigned char *)newheader,
+					(unsigned int)(sizeof(*newheader)),
+					qpdb->common.mctx,
+					qpdb->common.rdclass,
+					(dns_rdatatype_t)header->type, flags,
+					&merged);
+			}
+			if (result != ISC_R_SUCCESS) {
+				free_header(qpdb, newheader);
+				return (result);
+			}
+			/*
+			 * If 'header' has the same serial number as
+			 * we do, we could clean it up now if we knew
+			 * that our caller had no references to it.
+			 * We don't know this, however, so we leave it
+			 * alone.  It will get cleaned up when
+			 * clean_zone_node() runs.
+			 */
+			free_header(qpdb, newheader);
+			newheader = (qpdb_header_t *)merged;
+		}
+
+		INSIST(version->serial >= topheader->serial);
+		if (loading) {
+			/*
+			 * There are no other versions while loading, so
+			 * the old header is simply replaced.
+			 */
+			set_next(newheader, header_next(topheader));
+			if (topheader_prev != NULL) {
+				set_next(topheader_prev, newheader);
+			} else {
+				set_data(node, newheader);
+			}
+			if (!header_nx) {
+				update_recordsandxfrsize(false, version, header,
+							 node->namelen);
+			}
+			free_header(qpdb, header);
+		} else {
+			set_next(newheader, header_next(topheader));
+			set_down(newheader, topheader);
+			if (topheader_prev != NULL) {
+				set_next(topheader_prev, newheader);
+			} else {
+				set_data(node, newheader);
+			}
+			atomic_store_release(&node->dirty, true);
+			changed->dirty = true;
+			if (!header_nx) {
+				update_recordsandxfrsize(false, version, header,
+							 node->namelen);
+			}
+		}
+	} else {
+		/*
+		 * No non-IGNORED rdatasets of the given type exist at
+		 * this node.
+		 */
+
+		/*
+		 * If we're trying to delete the type, don't bother.
+		 */
+		if (newheader_nx) {
+			free_header(qpdb, newheader);
+			return (DNS_R_UNCHANGED);
+		}
+
+		if (topheader != NULL) {
+			/*
+			 * We have an list of rdatasets of the given type,
+			 * but they're all marked IGNORE.  We simply insert
+			 * the new rdataset at the head of the list.
+			 *
+			 * Ignored rdatasets cannot occur during loading, so
+			 * we INSIST on it.
+			 */
+			INSIST(!loading);
+			INSIST(version->serial >= topheader->serial);
+			set_next(newheader, header_next(topheader));
+			set_down(newheader, topheader);
+			if (topheader_prev != NULL) {
+				set_next(topheader_prev, newheader);
+			} else {
+				set_data(node, newheader);
+			}
+			atomic_store_release(&node->dirty, true);
+			changed->dirty = true;
+		} else {
+			/*
+			 * No rdatasets of the given type exist at the node.
+			 */
+			set_next(newheader, node_data(node));
+			set_data(node, newheader);
+		}
+	}
+
+	if (!newheader_nx) {
+		update_recordsandxfrsize(true, version, newheader,
+					 node->namelen);
+	}
+
+	/*
+	 * Check if the node now contains CNAME and other data.
+	 */
+	if (cname_and_other_data(node, version->serial)) {
+		return (DNS_R_CNAMEANDOTHER);
+	}
+
+	bind_rdataset(qpdb, node, newheader, addedrdataset);
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+	    isc_stdtime_t now, dns_rdataset_t *rdataset, unsigned int options,
+	    dns_rdataset_t *addedrdataset) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)db;
+	qpdb_node_t *qpnode = (qpdb_node_t *)node;
+	qpdb_version_t *qpversion = version;
+	qpdb_header_t *newheader = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	REQUIRE(qpversion != NULL && qpversion->qpdb == qpdb);
+
+	UNUSED(now);
+
+	/*
+	 * SOA records are only allowed at top of zone.
+	 */
+	if (rdataset->type == dns_rdatatype_soa &&
+	    qpnode != qpdb->origin_node) {
+		return (DNS_R_NOTZONETOP);
+	}
+	REQUIRE((qpnode->nsec3 && (rdataset->type == dns_rdatatype_nsec3 ||
+				   rdataset->covers == dns_rdatatype_nsec3)) ||
+		(!qpnode->nsec3 && rdataset->type != dns_rdatatype_nsec3 &&
+		 rdataset->covers != dns_rdatatype_nsec3));
+
+	newheader = new_header(qpdb, rdataset, qpversion->serial);
+	if (newheader == NULL) {
+		return (ISC_R_NOSPACE);
+	}
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
+	result = add32(qpdb, qpnode, qpversion, newheader, options, false,
+		       addedrdataset);
+	if (result == ISC_R_SUCCESS &&
+	    delegating_type(qpdb, qpnode, rdataset->type)) {
+		atomic_store_relaxed(&qpnode->delegating, true);
+	}
+	write_unlock(qpdb);
+
+	return (result);
+}
+
+static isc_result_t
+subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+		 dns_rdataset_t *rdataset, unsigned int options,
+		 dns_rdataset_t *newrdataset) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)db;
+	qpdb_node_t *qpnode = (qpdb_node_t *)node;
+	qpdb_version_t *qpversion = version;
+	qpdb_header_t *topheader = NULL, *topheader_prev = NULL;
+	qpdb_header_t *header = NULL, *newheader = NULL;
+	unsigned char *subresult = NULL;
+	isc_result_t result;
+	qpdb_changed_t *changed = NULL;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	REQUIRE(qpversion != NULL && qpversion->qpdb == qpdb);
+	REQUIRE((qpnode->nsec3 && (rdataset->type == dns_rdatatype_nsec3 ||
+				   rdataset->covers == dns_rdatatype_nsec3)) ||
+		(!qpnode->nsec3 && rdataset->type != dns_rdatatype_nsec3 &&
+		 rdataset->covers != dns_rdatatype_nsec3));
+
+	newheader = new_header(qpdb, rdataset, qpversion->serial);
+	if (newheader == NULL) {
+		return (ISC_R_NOSPACE);
+	}
+	newheader->trust = 0;
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
+
+	changed = add_changed(qpdb, qpversion, qpnode);
+
+	for (topheader = node_data(qpnode); topheader != NULL;
+	     topheader = header_next(topheader)) {
+		if (topheader->type == newheader->type) {
+			break;
+		}
+		topheader_prev = topheader;
+	}
+	/*
+	 * If header isn't NULL, we've found the right type.  There may be
+	 * IGNORE rdatasets between the top of the chain and the first real
+	 * data.  We skip over them.
+	 */
+	header = topheader;
+	while (header != NULL && IGNORE(header)) {
+		header = header_down(header);
+	}
+	if (header != NULL && EXISTS(header)) {
+		unsigned int flags = 0;
+		result = ISC_R_SUCCESS;
+		if ((options & DNS_DBSUB_EXACT) != 0) {
+			flags |= DNS_RDATASLAB_EXACT;
+			if (newheader->ttl != header->ttl) {
+				result = DNS_R_NOTEXACT;
+			}
+		}
+		if (result == ISC_R_SUCCESS) {
+			result = dns_rdataslab_subtract(
+				(unsigned char *)header,
+				(unsigned char *)newheader,
+				(unsigned int)(sizeof(*newheader)),
+				qpdb->common.mctx, qpdb->common.rdclass,
+				(dns_rdatatype_t)header->type, flags,
+				&subresult);
+		}
+		if (result == ISC_R_SUCCESS) {
+			free_header(qpdb, newheader);
+			newheader = (qpdb_header_t *)subresult;
+			/*
+			 * The subtracted slab carries the header of
+			 * 'header', apart from the serial number.
+			 */
+			newheader->serial = qpversion->serial;
+			atomic_init(&newheader->count,
+				    atomic_load_relaxed(&header->count));
+			update_recordsandxfrsize(true, qpversion, newheader,
+						 qpnode->namelen);
+		} else if (result == DNS_R_NXRRSET) {
+			/*
+			 * This subtraction would remove all of the rdata;
+			 * add a nonexistent header instead.
+			 */
+			free_header(qpdb, newheader);
+			newheader = new_nxheader(qpdb, topheader->type,
+						 qpversion->serial);
+		} else {
+			free_header(qpdb, newheader);
+			goto unlock;
+		}
+
+		/*
+		 * If we're here, we want to link newheader in front of
+		 * topheader.
+		 */
+		INSIST(qpversion->serial >= topheader->serial);
+		update_recordsandxfrsize(false, qpversion, header,
+					 qpnode->namelen);
+		set_next(newheader, header_next(topheader));
+		set_down(newheader, topheader);
+		if (topheader_prev != NULL) {
+			set_next(topheader_prev, newheader);
+		} else {
+			set_data(qpnode, newheader);
+		}
+		atomic_store_release(&qpnode->dirty, true);
+		changed->dirty = true;
+	} else {
+		/*
+		 * The rdataset doesn't exist, so we don't need to do
+		 * anything to satisfy the deletion request.
+		 */
+		free_header(qpdb, newheader);
+		if ((options & DNS_DBSUB_EXACT) != 0) {
+			result = DNS_R_NOTEXACT;
+		} else {
+			result = DNS_R_UNCHANGED;
+		}
+	}
+
+	if (result == ISC_R_SUCCESS && newrdataset != NULL) {
+		bind_rdataset(qpdb, qpnode, newheader, newrdataset);
+	}
+
+	if (result == DNS_R_NXRRSET && newrdataset != NULL &&
+	    (options & DNS_DBSUB_WANTOLD) != 0)
+	{
+		bind_rdataset(qpdb, qpnode, header, newrdataset);
+	}
+
+unlock:
+	write_unlock(qpdb);
+
+	return (result);
+}
+
+static isc_result_t
+deleterdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+	       dns_rdatatype_t type, dns_rdatatype_t covers) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)db;
+	qpdb_node_t *qpnode = (qpdb_node_t *)node;
+	qpdb_version_t *qpversion = version;
+	qpdb_header_t *newheader = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	REQUIRE(qpversion != NULL && qpversion->qpdb == qpdb);
+
+	if (type == dns_rdatatype_any) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+	if (type == dns_rdatatype_rrsig && covers == 0) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	newheader = new_nxheader(qpdb, QPDB_RDATATYPE_VALUE(type, covers),
+				 qpversion->serial);
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
+	result = add32(qpdb, qpnode, qpversion, newheader, DNS_DBADD_FORCE,
+		       false, NULL);
+	write_unlock(qpdb);
+
+	return (result);
+}
+
+static isc_result_t
+loading_addrdataset(void *arg, const dns_name_t *name,
+		    dns_rdataset_t *rdataset) {
+	qpdb_load_t *loadctx = arg;
+	dns_qpdb_t *qpdb = loadctx->qpdb;
+	qpdb_node_t *node = NULL;
+	qpdb_header_t *newheader = NULL;
+	isc_result_t result;
+	bool nsec3;
+
+	REQUIRE(rdataset->rdclass == qpdb->common.rdclass);
+
+	/*
+	 * SOA records are only allowed at top of zone.
+	 */
+	if (rdataset->type == dns_rdatatype_soa &&
+	    !dns_name_equal(name, &qpdb->common.origin))
+	{
+		return (DNS_R_NOTZONETOP);
+	}
+
+	nsec3 = (rdataset->type == dns_rdatatype_nsec3 ||
+		 rdataset->covers == dns_rdatatype_nsec3);
+
+	if (dns_name_iswildcard(name)) {
+		/*
+		 * NS record owners cannot legally be wild cards.
+		 */
+		if (rdataset->type == dns_rdatatype_ns) {
+			return (DNS_R_INVALIDNS);
+		}
+		/*
+		 * NSEC3 record owners cannot legally be wild cards.
+		 */
+		if (rdataset->type == dns_rdatatype_nsec3) {
+			return (DNS_R_INVALIDNSEC3);
+		}
+	}
+
+	newheader = new_header(qpdb, rdataset, 1);
+	if (newheader == NULL) {
+		return (ISC_R_NOSPACE);
+	}
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
+
+	if (!nsec3) {
+		add_empty_wildcards(qpdb, name);
+		if (dns_name_iswildcard(name)) {
+			add_wildcard_magic(qpdb, name);
+		}
+	}
+
+	node = get_node(qpdb, nsec3 ? qpdb->nsec3 : qpdb->tree, name);
+	result = add32(qpdb, node, CURRENT_VERSION(qpdb), newheader,
+		       DNS_DBADD_MERGE, true, NULL);
+	if (result == ISC_R_SUCCESS &&
+	    delegating_type(qpdb, node, rdataset->type)) {
+		atomic_store_relaxed(&node->delegating, true);
+	} else if (result == DNS_R_UNCHANGED) {
+		result = ISC_R_SUCCESS;
+	}
+
+	write_unlock(qpdb);
+
+	return (result);
+}
+
+static isc_result_t
+beginload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
+	qpdb_load_t *loadctx = NULL;
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)db;
+
+	REQUIRE(DNS_CALLBACK_VALID(callbacks));
+	REQUIRE(VALID_QPDB(qpdb));
+	REQUIRE(!atomic_load_acquire(&qpdb->lockless));
+
+	loadctx = isc_mem_get(qpdb->common.mctx, sizeof(*loadctx));
+	loadctx->qpdb = qpdb;
+
+	callbacks->add = loading_addrdataset;
+	callbacks->add_private = loadctx;
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+endload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
+	qpdb_load_t *loadctx = NULL;
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)db;
+	qpdb_version_t *version = NULL;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	REQUIRE(DNS_CALLBACK_VALID(callbacks));
+	loadctx = callbacks->add_private;
+	REQUIRE(loadctx != NULL);
+	REQUIRE(loadctx->qpdb == qpdb);
+
+	/*
+	 * From now on, lookups can run alongside updates; make the tries
+	 * copy-on-write.
+	 */
+	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
+	dns_qp_setretire(qpdb->tree, qpdb_retire);
+	dns_qp_setretire(qpdb->nsec3, qpdb_retire);
+	atomic_store_release(&qpdb->lockless, true);
+	version = CURRENT_VERSION(qpdb);
+	write_unlock(qpdb);
+
+	/*
+	 * If there's a KEY rdataset at the zone origin containing a
+	 * zone key, we consider the zone secure.
+	 */
+	iszonesecure(db, version, qpdb->origin_node);
+
+	callbacks->add = NULL;
+	callbacks->add_private = NULL;
+
+	isc_mem_put(qpdb->common.mctx, loadctx, sizeof(*loadctx));
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+dump(dns_db_t *db, dns_dbversion_t *version, const char *filename,
+     dns_masterformat_t masterformat) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)db;
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	return (dns_master_dump(qpdb->common.mctx, db, version,
+				&dns_master_style_default, filename,
+				masterformat, NULL));
+}
+
+static bool
+issecure(dns_db_t *db) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)db;
+	bool secure;
+	bool lockless;
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	lockless = read_begin(qpdb);
+	secure = (CURRENT_VERSION(qpdb)->secure == dns_db_secure);
+	read_end(qpdb, lockless);
+
+	return (secure);
+}
+
+static bool
+isdnssec(dns_db_t *db) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)db;
+	bool dnssec;
+	bool lockless;
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	lockless = read_begin(qpdb);
+	dnssec = (CURRENT_VERSION(qpdb)->secure != dns_db_insecure);
+	read_end(qpdb, lockless);
+
+	return (dnssec);
+}
+
+static unsigned int
+nodecount(dns_db_t *db, dns_dbtree_t tree) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)db;
+	unsigned int count;
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	switch (tree) {
+	case dns_dbtree_main:
+		count = dns_qp_count(qpdb->tree);
+		break;
+	case dns_dbtree_nsec3:
+		count = dns_qp_count(qpdb->nsec3);
+		break;
+	default:
+		/* There is no auxiliary NSEC tree. */
+		count = 0;
+	}
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	return (count);
+}
+
+static bool
+ispersistent(dns_db_t *db) {
+	UNUSED(db);
+	return (false);
+}
+
+static void
+overmem(dns_db_t *db, bool over) {
+	UNUSED(db);
+	UNUSED(over);
+}
+
+static void
+settask(dns_db_t *db, isc_task_t *task) {
+	UNUSED(db);
+	UNUSED(task);
+}
+
+static isc_result_t
+getoriginnode(dns_db_t *db, dns_dbnode_t **nodep) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)db;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	REQUIRE(nodep != NULL && *nodep == NULL);
+
+	new_reference(qpdb, qpdb->origin_node);
+	*nodep = qpdb->origin_node;
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+getnsec3parameters(dns_db_t *db, dns_dbversion_t *version, dns_hash_t *hash,
+		   uint8_t *flags, uint16_t *iterations, unsigned char *salt,
+		   size_t *salt_length) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)db;
+	isc_result_t result = ISC_R_NOTFOUND;
+	qpdb_version_t *qpversion = version;
+	bool lockless;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	INSIST(qpversion == NULL || qpversion->qpdb == qpdb);
+
+	lockless = read_begin(qpdb);
+	if (qpversion == NULL) {
+		qpversion = CURRENT_VERSION(qpdb);
+	}
+
+	if (qpversion->havensec3) {
+		if (hash != NULL) {
+			*hash = qpversion->hash;
+		}
+		if (salt != NULL && salt_length != NULL) {
+			REQUIRE(*salt_length >= qpversion->salt_length);
+			memmove(salt, qpversion->salt, qpversion->salt_length);
+		}
+		if (salt_length != NULL) {
+			*salt_length = qpversion->salt_length;
+		}
+		if (iterations != NULL) {
+			*iterations = qpversion->iterations;
+		}
+		if (flags != NULL) {
+			*flags = qpversion->flags;
+		}
+		result = ISC_R_SUCCESS;
+	}
+	read_end(qpdb, lockless);
+
+	return (result);
+}
+
+static isc_result_t
+getsize(dns_db_t *db, dns_dbversion_t *version, uint64_t *records,
+	uint64_t *bytes) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)db;
+	qpdb_version_t *qpversion = version;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	INSIST(qpversion == NULL || qpversion->qpdb == qpdb);
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	if (qpversion == NULL) {
+		qpversion = CURRENT_VERSION(qpdb);
+	}
+	if (records != NULL) {
+		*records = qpversion->records;
+	}
+	if (bytes != NULL) {
+		*bytes = qpversion->xfrsize;
+	}
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+nodefullname(dns_db_t *db, dns_dbnode_t *node, dns_name_t *name) {
+	qpdb_node_t *qpnode = (qpdb_node_t *)node;
+	dns_name_t nname;
+
+	REQUIRE(VALID_QPDB((dns_qpdb_t *)db));
+	REQUIRE(node != NULL);
+	REQUIRE(name != NULL);
+
+	/* The owner name of a node never changes; no lock is needed. */
+	dns_name_init(&nname, NULL);
+	nodename(qpnode, &nname);
+	dns_name_copy(&nname, name);
+
+	return (ISC_R_SUCCESS);
+}
+
+static dns_dbmethods_t zone_methods = { attach,
+					detach,
+					beginload,
+					endload,
+					dump,
+					currentversion,
+					newversion,
+					attachversion,
+					closeversion,
+					findnode,
+					zone_find,
+					zone_findzonecut,
+					attachnode,
+					detachnode,
+					expirenode,
+					printnode,
+					createiterator,
+					zone_findrdataset,
+					allrdatasets,
+					addrdataset,
+					subtractrdataset,
+					deleterdataset,
+					issecure,
+					nodecount,
+					ispersistent,
+					overmem,
+					settask,
+					getoriginnode,
+					NULL, /* transfernode */
+					getnsec3parameters,
+					findnsec3node,
+					NULL, /* setsigningtime */
+					NULL, /* getsigningtime */
+					NULL, /* resigned */
+					isdnssec,
+					NULL, /* getrrsetstats */
+					NULL, /* rpz_attach */
+					NULL, /* rpz_ready */
+					NULL, /* findnodeext */
+					NULL, /* findext */
+					NULL, /* setcachestats */
+					NULL, /* hashsize */
+					nodefullname,
+					getsize,
+					NULL, /* setservestalettl */
+					NULL, /* getservestalettl */
+					NULL, /* setservestalerefresh */
+					NULL, /* getservestalerefresh */
+					NULL, /* setgluecachestats */
+					NULL, /* setevictionpolicy */
+					NULL, /* getmemory */
+					NULL, /* expire */
+					NULL, /* setcoldtier */
+					NULL, /* flushtree */
+					NULL /* nsec3hashname */ };
+
+isc_result_t
+dns_qpdb_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
+		dns_rdataclass_t rdclass, unsigned int argc, char *argv[],
+		void *driverarg, dns_db_t **dbp) {
+	dns_qpdb_t *qpdb = NULL;
+	qpdb_version_t *version = NULL;
+
+	/* Keep the compiler happy. */
+	UNUSED(argc);
+	UNUSED(argv);
+	UNUSED(driverarg);
+
+	if (type == dns_dbtype_cache) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	qpdb = isc_mem_get(mctx, sizeof(*qpdb));
+	*qpdb = (dns_qpdb_t){ .common.methods = &zone_methods };
+
+	if (type == dns_dbtype_stub) {
+		qpdb->common.attributes |= DNS_DBATTR_STUB;
+	}
+	qpdb->common.rdclass = rdclass;
+	isc_mem_attach(mctx, &qpdb->common.mctx);
+
+	isc_rwlock_init(&qpdb->lock, 0, 0);
+	isc_refcount_init(&qpdb->references, 1);
+
+	/*
+	 * Make a copy of the origin name.
+	 */
+	dns_name_init(&qpdb->common.origin, NULL);
+	dns_name_dupwithoffsets(origin, mctx, &qpdb->common.origin);
+
+	dns_qp_create(mctx, qpdb_makekey, qpdb, &qpdb->tree);
+	dns_qp_create(mctx, qpdb_makekey, qpdb, &qpdb->nsec3);
+
+	/*
+	 * In order to set the node callback bit correctly in zone
+	 * databases, we need to know if the node has the origin name of
+	 * the zone.  In loading_addrdataset() we could simply compare
+	 * the new name to the origin name, but this is expensive.  Also,
+	 * we don't know the node name in addrdataset(), so we need another
+	 * way of knowing the zone's top.
+	 *
+	 * We now explicitly create nodes for the zone's origin in both
+	 * tries, and then remember the node addresses.
+	 */
+	qpdb->origin_node = get_node(qpdb, qpdb->tree, &qpdb->common.origin);
+	qpdb->nsec3_origin_node = get_node(qpdb, qpdb->nsec3,
+					   &qpdb->common.origin);
+
+	qpdb->current_serial = 1;
+	qpdb->least_serial = 1;
+	qpdb->next_serial = 2;
+	version = allocate_version(mctx, 1, 1, false);
+	version->qpdb = qpdb;
+	atomic_init(&qpdb->current_version, (uintptr_t)version);
+	ISC_LIST_INIT(qpdb->open_versions);
+	/*
+	 * Keep the current version in the open list so that list operation
+	 * won't happen in normal lookup operations.
+	 */
+	ISC_LIST_PREPEND(qpdb->open_versions, version, link);
+	ISC_LIST_INIT(qpdb->retired);
+
+	/*
+	 * Lookups take the lock until the database has been loaded.
+	 */
+	atomic_init(&qpdb->lockless, false);
+
+	qpdb->common.magic = DNS_DB_MAGIC;
+	qpdb->common.impmagic = QPDB_MAGIC;
+
+	*dbp = (dns_db_t *)qpdb;
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Slabbed Rdataset Methods
+ */
+
+static void
+rdataset_disassociate(dns_rdataset_t *rdataset) {
+	dns_db_t *db = rdataset->private1;
+	dns_dbnode_t *node = rdataset->private2;
+
+	detachnode(db, &node);
+}
+
+static isc_result_t
+rdataset_first(dns_rdataset_t *rdataset) {
+	unsigned char *raw = rdataset->private3; /* RDATASLAB */
+	unsigned int count;
+
+	count = raw[0] * 256 + raw[1];
+	if (count == 0) {
+		rdataset->private5 = NULL;
+		return (ISC_R_NOMORE);
+	}
+
+	if ((rdataset->attributes & DNS_RDATASETATTR_LOADORDER) == 0) {
+		raw += DNS_RDATASET_COUNT;
+	}
+
+	raw += DNS_RDATASET_LENGTH;
+
+	/*
+	 * The privateuint4 field is the number of rdata beyond the
+	 * cursor position, so we decrement the total count by one
+	 * before storing it.
+	 *
+	 * If DNS_RDATASETATTR_LOADORDER is not set 'raw' points to the
+	 * first record.  If DNS_RDATASETATTR_LOADORDER is set 'raw' points
+	 * to the first entry in the offset table.
+	 */
+	count--;
+	rdataset->privateuint4 = count;
+	rdataset->private5 = raw;
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+rdataset_next(dns_rdataset_t *rdataset) {
+	unsigned int count;
+	unsigned int length;
+	unsigned char *raw; /* RDATASLAB */
+
+	count = rdataset->privateuint4;
+	if (count == 0) {
+		return (ISC_R_NOMORE);
+	}
+	count--;
+	rdataset->privateuint4 = count;
+
+	/*
+	 * Skip forward one record (length + 4) or one offset (4).
+	 */
+	raw = rdataset->private5;
+#if DNS_RDATASET_FIXED
+	if ((rdataset->attributes & DNS_RDATASETATTR_LOADORDER) == 0)
+#endif /* DNS_RDATASET_FIXED */
+	{
+		length = raw[0] * 256 + raw[1];
+		raw += length;
+	}
+
+	rdataset->private5 = raw + DNS_RDATASET_ORDER + DNS_RDATASET_LENGTH;
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+rdataset_current(dns_rdataset_t *rdataset, dns_rdata_t *rdata) {
+	unsigned char *raw = rdataset->private5; /* RDATASLAB */
+	unsigned int length;
+	isc_region_t r;
+	unsigned int flags = 0;
+
+	REQUIRE(raw != NULL);
+
+	/*
+	 * Find the start of the record if not already in private5
+	 * then skip the length and order fields.
+	 */
+#if DNS_RDATASET_FIXED
+	if ((rdataset->attributes & DNS_RDATASETATTR_LOADORDER) != 0) {
+		unsigned int offset;
+		offset = ((unsigned int)raw[0] << 24) +
+			 ((unsigned int)raw[1] << 16) +
+			 ((unsigned int)raw[2] << 8) + (unsigned int)raw[3];
+		raw = rdataset->private3;
+		raw += offset;
+	}
+#endif /* if DNS_RDATASET_FIXED */
+
+	length = raw[0] * 256 + raw[1];
+
+	raw += DNS_RDATASET_ORDER + DNS_RDATASET_LENGTH;
+
+	if (rdataset->type == dns_rdatatype_rrsig) {
+		if (*raw & DNS_RDATASLAB_OFFLINE) {
+			flags |= DNS_RDATA_OFFLINE;
+		}
+		length--;
+		raw++;
+	}
+	r.length = length;
+	r.base = raw;
+	dns_rdata_fromregion(rdata, rdataset->rdclass, rdataset->type, &r);
+	rdata->flags |= flags;
+}
+
+static void
+rdataset_clone(dns_rdataset_t *source, dns_rdataset_t *target) {
+	dns_db_t *db = source->private1;
+	dns_dbnode_t *node = source->private2;
+	dns_dbnode_t *cloned_node = NULL;
+
+	attachnode(db, node, &cloned_node);
+	INSIST(!ISC_LINK_LINKED(target, link));
+	*target = *source;
+	ISC_LINK_INIT(target, link);
+
+	/*
+	 * Reset iterator state.
+	 */
+	target->privateuint4 = 0;
+	target->private5 = NULL;
+}
+
+static unsigned int
+rdataset_count(dns_rdataset_t *rdataset) {
+	unsigned char *raw = rdataset->private3; /* RDATASLAB */
+	unsigned int count;
+
+	count = raw[0] * 256 + raw[1];
+
+	return (count);
+}
+
+/*
+ * Rdataset Iterator Methods
+ */
+
+static void
+rdatasetiter_destroy(dns_rdatasetiter_t **iteratorp) {
+	qpdb_rdatasetiter_t *iterator = NULL;
+
+	iterator = (qpdb_rdatasetiter_t *)(*iteratorp);
+
+	closeversion(iterator->common.db, &iterator->common.version, false);
+	detachnode(iterator->common.db, &iterator->common.node);
+	isc_mem_put(iterator->common.db->mctx, iterator, sizeof(*iterator));
+
+	*iteratorp = NULL;
+}
+
+/*
+ * Move the iterator to the first type at or after 'top' that holds data
+ * in the iterator's version.  The database must be read locked.
+ */
+static isc_result_t
+rdatasetiter_seek(qpdb_rdatasetiter_t *iterator, qpdb_header_t *top) {
+	qpdb_version_t *version = iterator->common.version;
+	qpdb_header_t *header = NULL;
+
+	for (; top != NULL; top = header_next(top)) {
+		header = visible(top, version->serial);
+		if (header != NULL) {
+			break;
+		}
+	}
+
+	iterator->top = top;
+	iterator->current = header;
+
+	if (header == NULL) {
+		return (ISC_R_NOMORE);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+rdatasetiter_first(dns_rdatasetiter_t *it) {
+	qpdb_rdatasetiter_t *iterator = (qpdb_rdatasetiter_t *)it;
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)(iterator->common.db);
+	qpdb_node_t *qpnode = iterator->common.node;
+	isc_result_t result;
+	bool lockless;
+
+	lockless = read_begin(qpdb);
+	result = rdatasetiter_seek(iterator, node_data(qpnode));
+	read_end(qpdb, lockless);
+
+	return (result);
+}
+
+static isc_result_t
+rdatasetiter_next(dns_rdatasetiter_t *it) {
+	qpdb_rdatasetiter_t *iterator = (qpdb_rdatasetiter_t *)it;
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)(iterator->common.db);
+	isc_result_t result;
+	bool lockless;
+
+	if (iterator->top == NULL) {
+		return (ISC_R_NOMORE);
+	}
+
+	/*
+	 * The headers we have seen can't be freed while the iterator
+	 * holds its node reference, so the next link of 'top' is still
+	 * valid even if a newer header has since replaced 'top'.
+	 */
+	lockless = read_begin(qpdb);
+	result = rdatasetiter_seek(iterator, header_next(iterator->top));
+	read_end(qpdb, lockless);
+
+	return (result);
+}
+
+static void
+rdatasetiter_current(dns_rdatasetiter_t *it, dns_rdataset_t *rdataset) {
+	qpdb_rdatasetiter_t *iterator = (qpdb_rdatasetiter_t *)it;
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)(iterator->common.db);
+	qpdb_node_t *qpnode = iterator->common.node;
+	bool lockless;
+
+	REQUIRE(iterator->current != NULL);
+
+	lockless = read_begin(qpdb);
+	bind_rdataset(qpdb, qpnode, iterator->current, rdataset);
+	read_end(qpdb, lockless);
+}
+
+/*
+ * Database Iterator Methods
+ */
+
+static void
+dbiterator_destroy(dns_dbiterator_t **iteratorp) {
+	qpdb_dbiterator_t *qpdbiter = (qpdb_dbiterator_t *)(*iteratorp);
+	dns_db_t *db = NULL;
+
+	if (qpdbiter->node != NULL) {
+		detachnode(qpdbiter->common.db,
+			   (dns_dbnode_t **)&qpdbiter->node);
+	}
+
+	dns_db_attach(qpdbiter->common.db, &db);
+	dns_db_detach(&qpdbiter->common.db);
+	isc_mem_put(db->mctx, qpdbiter, sizeof(*qpdbiter));
+	dns_db_detach(&db);
+
+	*iteratorp = NULL;
+}
+
+/*
+ * Step the trie iterator forwards or backwards, passing from the main
+ * trie to the NSEC3 one and back as needed.  The database must be read
+ * locked.
+ */
+static isc_result_t
+dbiterator_step(qpdb_dbiterator_t *qpdbiter, bool forward,
+		qpdb_node_t **nodep) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)qpdbiter->common.db;
+	qpdb_node_t *node = NULL;
+	isc_result_t result;
+
+	for (;;) {
+		if (forward) {
+			result = dns_qpiter_next(&qpdbiter->iter,
+						 (void **)&node);
+		} else {
+			result = dns_qpiter_prev(&qpdbiter->iter,
+						 (void **)&node);
+		}
+		if (result == ISC_R_SUCCESS) {
+			/*
+			 * The origin of the NSEC3 trie only exists to
+			 * anchor it; don't show the origin name twice.
+			 */
+			if (node == qpdb->nsec3_origin_node) {
+				continue;
+			}
+			*nodep = node;
+			return (ISC_R_SUCCESS);
+		}
+
+		if (forward && qpdbiter->current == qpdb->tree &&
+		    !qpdbiter->nonsec3)
+		{
+			qpdbiter->current = qpdb->nsec3;
+		} else if (!forward && qpdbiter->current == qpdb->nsec3 &&
+			   !qpdbiter->nsec3only)
+		{
+			qpdbiter->current = qpdb->tree;
+		} else {
+			return (ISC_R_NOMORE);
+		}
+		dns_qpiter_init(qpdbiter->current, &qpdbiter->iter);
+	}
+}
+
+/*
+ * Find the position of the current node again if the trie has been
+ * modified since the iterator last looked at it.  The database must be
+ * read locked.
+ */
+static void
+dbiterator_resync(qpdb_dbiterator_t *qpdbiter) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)qpdbiter->common.db;
+	qpdb_node_t *node = NULL;
+	dns_qpkey_t key;
+	size_t keylen;
+	isc_result_t result;
+
+	if (qpdbiter->generation == qpdb->generation) {
+		return;
+	}
+
+	keylen = qpdb_makekey(key, NULL, qpdbiter->node);
+	result = dns_qp_lookup(qpdbiter->current, key, keylen, &qpdbiter->iter,
+			       NULL, (void **)&node);
+	INSIST(result == ISC_R_SUCCESS && node == qpdbiter->node);
+	qpdbiter->generation = qpdb->generation;
+}
+
+/*
+ * Make 'node' the current node of the iterator.  The reference to the
+ * previous node is dropped after the database has been unlocked.
+ */
+static isc_result_t
+dbiterator_finish(qpdb_dbiterator_t *qpdbiter, isc_result_t result,
+		  qpdb_node_t *node) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)qpdbiter->common.db;
+	qpdb_node_t *old = qpdbiter->node;
+
+	if (result == ISC_R_SUCCESS || result == DNS_R_PARTIALMATCH) {
+		new_reference(qpdb, node);
+		qpdbiter->node = node;
+	} else {
+		qpdbiter->node = NULL;
+	}
+	qpdbiter->generation = qpdb->generation;
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	if (old != NULL) {
+		detachnode(qpdbiter->common.db, (dns_dbnode_t **)&old);
+	}
+
+	qpdbiter->result = (result == DNS_R_PARTIALMATCH) ? ISC_R_SUCCESS
+							  : result;
+	return (result);
+}
+
+static isc_result_t
+dbiterator_first(dns_dbiterator_t *iterator) {
+	qpdb_dbiterator_t *qpdbiter = (qpdb_dbiterator_t *)iterator;
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)iterator->db;
+	qpdb_node_t *node = NULL;
+	isc_result_t result;
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	qpdbiter->current = qpdbiter->nsec3only ? qpdb->nsec3 : qpdb->tree;
+	dns_qpiter_init(qpdbiter->current, &qpdbiter->iter);
+	result = dbiterator_step(qpdbiter, true, &node);
+	qpdbiter->new_origin = (result == ISC_R_SUCCESS);
+
+	return (dbiterator_finish(qpdbiter, result, node));
+}
+
+static isc_result_t
+dbiterator_last(dns_dbiterator_t *iterator) {
+	qpdb_dbiterator_t *qpdbiter = (qpdb_dbiterator_t *)iterator;
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)iterator->db;
+	qpdb_node_t *node = NULL;
+	isc_result_t result;
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	qpdbiter->current = qpdbiter->nonsec3 ? qpdb->tree : qpdb->nsec3;
+	dns_qpiter_init(qpdbiter->current, &qpdbiter->iter);
+	result = dbiterator_step(qpdbiter, false, &node);
+	qpdbiter->new_origin = (result == ISC_R_SUCCESS);
+
+	return (dbiterator_finish(qpdbiter, result, node));
+}
+
+static isc_result_t
+dbiterator_seek(dns_dbiterator_t *iterator, const dns_name_t *name) {
+	qpdb_dbiterator_t *qpdbiter = (qpdb_dbiterator_t *)iterator;
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)iterator->db;
+	qpdb_node_t *node = NULL;
+	dns_qpiter_t iter;
+	dns_qpkey_t key;
+	size_t keylen;
+	isc_result_t result, result2;
+
+	keylen = dns_qpkey_fromname(key, name);
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	if (qpdbiter->nsec3only) {
+		qpdbiter->current = qpdb->nsec3;
+	} else {
+		qpdbiter->current = qpdb->tree;
+	}
+	result = dns_qp_lookup(qpdbiter->current, key, keylen, &qpdbiter->iter,
+			       NULL, (void **)&node);
+	if (!qpdbiter->nsec3only && !qpdbiter->nonsec3 &&
+	    result != ISC_R_SUCCESS)
+	{
+		/*
+		 * An exact match in the NSEC3 trie wins over a partial
+		 * one in the main trie.
+		 */
+		qpdb_node_t *node2 = NULL;
+
+		result2 = dns_qp_lookup(qpdb->nsec3, key, keylen, &iter, NULL,
+					(void **)&node2);
+		if (result2 == ISC_R_SUCCESS) {
+			qpdbiter->current = qpdb->nsec3;
+			qpdbiter->iter = iter;
+			node = node2;
+			result = result2;
+		}
+	}
+
+	if (result == DNS_R_PARTIALMATCH || result == ISC_R_NOTFOUND) {
+		/*
+		 * The name isn't there; leave the iterator on its
+		 * predecessor.
+		 */
+		if (dns_qpiter_current(&qpdbiter->iter, (void **)&node) !=
+			    ISC_R_SUCCESS ||
+		    node == qpdb->nsec3_origin_node)
+		{
+			if (dbiterator_step(qpdbiter, true, &node) !=
+			    ISC_R_SUCCESS) {
+				result = ISC_R_NOTFOUND;
+			}
+		}
+		if (result != ISC_R_NOTFOUND) {
+			result = DNS_R_PARTIALMATCH;
+		}
+	}
+	qpdbiter->new_origin = (result == ISC_R_SUCCESS ||
+				result == DNS_R_PARTIALMATCH);
+
+	return (dbiterator_finish(qpdbiter, result, node));
+}
+
+static isc_result_t
+dbiterator_move(dns_dbiterator_t *iterator, bool forward) {
+	qpdb_dbiterator_t *qpdbiter = (qpdb_dbiterator_t *)iterator;
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)iterator->db;
+	qpdb_node_t *node = NULL;
+	isc_result_t result;
+
+	REQUIRE(qpdbiter->node != NULL);
+
+	if (qpdbiter->result != ISC_R_SUCCESS) {
+		return (qpdbiter->result);
+	}
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	dbiterator_resync(qpdbiter);
+	result = dbiterator_step(qpdbiter, forward, &node);
+
+	return (dbiterator_finish(qpdbiter, result, node));
+}
+
+static isc_result_t
+dbiterator_prev(dns_dbiterator_t *iterator) {
+	return (dbiterator_move(iterator, false));
+}
+
+static isc_result_t
+dbiterator_next(dns_dbiterator_t *iterator) {
+	return (dbiterator_move(iterator, true));
+}
+
+static isc_result_t
+dbiterator_current(dns_dbiterator_t *iterator, dns_dbnode_t **nodep,
+		   dns_name_t *name) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)iterator->db;
+	qpdb_dbiterator_t *qpdbiter = (qpdb_dbiterator_t *)iterator;
+	qpdb_node_t *node = qpdbiter->node;
+	isc_result_t result = ISC_R_SUCCESS;
+	dns_name_t nname;
+
+	REQUIRE(qpdbiter->result == ISC_R_SUCCESS);
+	REQUIRE(qpdbiter->node != NULL);
+
+	if (name != NULL) {
+		dns_name_init(&nname, NULL);
+		nodename(node, &nname);
+		if (qpdbiter->common.relative_names) {
+			/*
+			 * All names are relative to the root.
+			 */
+			unsigned int nlabels = dns_name_countlabels(&nname);
+			dns_name_getlabelsequence(&nname, 0, nlabels - 1,
+						  &nname);
+		}
+		dns_name_copy(&nname, name);
+		if (qpdbiter->common.relative_names && qpdbiter->new_origin) {
+			result = DNS_R_NEWORIGIN;
+			qpdbiter->new_origin = false;
+		}
+	}
+
+	new_reference(qpdb, node);
+
+	*nodep = qpdbiter->node;
+
+	return (result);
+}
+
+static isc_result_t
+dbiterator_pause(dns_dbiterator_t *iterator) {
+	/*
+	 * No locks are held between calls.
+	 */
+	UNUSED(iterator);
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+dbiterator_origin(dns_dbiterator_t *iterator, dns_name_t *name) {
+	qpdb_dbiterator_t *qpdbiter = (qpdb_dbiterator_t *)iterator;
+
+	if (qpdbiter->result != ISC_R_SUCCESS) {
+		return (qpdbiter->result);
+	}
+
+	dns_name_copy(dns_rootname, name);
+
+	return (ISC_R_SUCCESS);
+}
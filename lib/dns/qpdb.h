@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+#include <isc/lang.h>
+
+#include <dns/types.h>
+
+/*****
+***** Module Info
+*****/
+
+/*! \file
+ * \brief
+ * DNS QP-Trie DB Implementation
+ */
+
+ISC_LANG_BEGINDECLS
+
+isc_result_t
+dns_qpdb_create(isc_mem_t *mctx, const dns_name_t *base, dns_dbtype_t type,
+		dns_rdataclass_t rdclass, unsigned int argc, char *argv[],
+		void *driverarg, dns_db_t **dbp);
+
+/*%<
+ * Create a new database of type "qp". Called via dns_db_create();
+ * see documentation for that function for more details.
+ *
+ * Only zone and stub databases are supported; creating a cache
+ * database fails with #ISC_R_NOTIMPLEMENTED.
+ *
+ * Requires:
+ *
+ * \li argc == 0.
+ */
+
+ISC_LANG_ENDDECLS
@@ -70,6 +70,7 @@ struct dns_rbt {
 	void (*data_deleter)(void *, void *);
 	void *deleter_arg;
 	unsigned int nodecount;
+	size_t inuse;
 	uint8_t hashbits[2];
 	dns_rbtnode_t **hashtable[2];
 	uint8_t hindex;
@@ -181,7 +182,7 @@ dns__rbtnode_getdistance(dns_rbtnode_t *node) {
  * Forward declarations.
  */
 static isc_result_t
-create_node(isc_mem_t *mctx, const dns_name_t *name, dns_rbtnode_t **nodep);
+create_node(dns_rbt_t *rbt, const dns_name_t *name, dns_rbtnode_t **nodep);
 
 static void
 hashtable_new(dns_rbt_t *rbt, uint8_t index, uint8_t bits);
@@ -270,6 +271,7 @@ dns_rbt_create(isc_mem_t *mctx, dns_rbtdeleter_t deleter, void *deleter_arg,
 	*rbt = (dns_rbt_t){
 		.data_deleter = deleter,
 		.deleter_arg = deleter_arg,
+		.inuse = sizeof(*rbt),
 	};
 
 	isc_mem_attach(mctx, &rbt->mctx);
@@ -328,6 +330,13 @@ dns_rbt_nodecount(dns_rbt_t *rbt) {
 	return (rbt->nodecount);
 }
 
+size_t
+dns_rbt_inuse(dns_rbt_t *rbt) {
+	REQUIRE(VALID_RBT(rbt));
+
+	return (rbt->inuse);
+}
+
 size_t
 dns_rbt_hashsize(dns_rbt_t *rbt) {
 	REQUIRE(VALID_RBT(rbt));
@@ -454,7 +463,7 @@ dns_rbt_addnode(dns_rbt_t *rbt, const dns_name_t *name, dns_rbtnode_t **nodep) {
 	dns_name_clone(name, add_name);
 
 	if (rbt->root == NULL) {
-		result = create_node(rbt->mctx, add_name, &new_current);
+		result = create_node(rbt, add_name, &new_current);
 		if (result == ISC_R_SUCCESS) {
 			rbt->nodecount++;
 			new_current->is_root = 1;
@@ -578,7 +587,7 @@ dns_rbt_addnode(dns_rbt_t *rbt, const dns_name_t *name, dns_rbtnode_t **nodep) {
 				 */
 				dns_name_split(&current_name, common_labels,
 					       prefix, suffix);
-				result = create_node(rbt->mctx, suffix,
+				result = create_node(rbt, suffix,
 						     &new_current);
 
 				if (result != ISC_R_SUCCESS) {
@@ -687,7 +696,7 @@ dns_rbt_addnode(dns_rbt_t *rbt, const dns_name_t *name, dns_rbtnode_t **nodep) {
 	} while (child != NULL);
 
 	if (result == ISC_R_SUCCESS) {
-		result = create_node(rbt->mctx, add_name, &new_current);
+		result = create_node(rbt, add_name, &new_current);
 	}
 
 	if (result == ISC_R_SUCCESS) {
@@ -1488,7 +1497,7 @@ dns_rbt_formatnodename(dns_rbtnode_t *node, char *printname,
 }
 
 static isc_result_t
-create_node(isc_mem_t *mctx, const dns_name_t *name, dns_rbtnode_t **nodep) {
+create_node(dns_rbt_t *rbt, const dns_name_t *name, dns_rbtnode_t **nodep) {
 	dns_rbtnode_t *node;
 	isc_region_t region;
 	unsigned int labels;
@@ -1504,8 +1513,9 @@ create_node(isc_mem_t *mctx, const dns_name_t *name, dns_rbtnode_t **nodep) {
 	 * Allocate space for the node structure, the name, and the offsets.
 	 */
 	nodelen = sizeof(dns_rbtnode_t) + region.length + labels + 1;
-	node = isc_mem_get(mctx, nodelen);
+	node = isc_mem_get(rbt->mctx, nodelen);
 	memset(node, 0, nodelen);
+	rbt->inuse += nodelen;
 
 	node->is_root = 0;
 	node->parent = NULL;
@@ -1522,6 +1532,7 @@ create_node(isc_mem_t *mctx, const dns_name_t *name, dns_rbtnode_t **nodep) {
 	node->locknum = 0;
 	node->wild = 0;
 	node->dirty = 0;
+	node->zonecut = 0;
 	isc_refcount_init(&node->references, 0);
 	node->find_callback = 0;
 	node->nsec = DNS_RBT_NSEC_NORMAL;
@@ -1591,6 +1602,7 @@ hashtable_new(dns_rbt_t *rbt, uint8_t index, uint8_t bits) {
 	size = ISC_HASHSIZE(rbt->hashbits[index]) * sizeof(dns_rbtnode_t *);
 	rbt->hashtable[index] = isc_mem_get(rbt->mctx, size);
 	memset(rbt->hashtable[index], 0, size);
+	rbt->inuse += size;
 }
 
 static void
@@ -1598,6 +1610,7 @@ hashtable_free(dns_rbt_t *rbt, uint8_t index) {
 	size_t size = ISC_HASHSIZE(rbt->hashbits[index]) *
 		      sizeof(dns_rbtnode_t *);
 	isc_mem_put(rbt->mctx, rbt->hashtable[index], size);
+	rbt->inuse -= size;
 
 	rbt->hashbits[index] = 0U;
 	rbt->hashtable[index] = NULL;
@@ -2177,6 +2190,7 @@ freenode(dns_rbt_t *rbt, dns_rbtnode_t **nodep) {
 	dns_rbtnode_t *node = *nodep;
 	*nodep = NULL;
 
+	rbt->inuse -= NODE_SIZE(node);
 	isc_mem_put(rbt->mctx, node, NODE_SIZE(node));
 
 	rbt->nodecount--;
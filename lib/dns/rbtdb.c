@@ -26,6 +26,7 @@
 #include <isc/hash.h>
 #include <isc/heap.h>
 #include <isc/hex.h>
+#include <isc/ht.h>
 #include <isc/mem.h>
 #include <isc/mutex.h>
 #include <isc/once.h>
@@ -42,6 +43,7 @@
 #include <isc/util.h>
 
 #include <dns/callbacks.h>
+#include <dns/coldcache.h>
 #include <dns/db.h>
 #include <dns/dbiterator.h>
 #include <dns/events.h>
@@ -50,6 +52,7 @@
 #include <dns/masterdump.h>
 #include <dns/nsec.h>
 #include <dns/nsec3.h>
+#include <dns/nsec3cache.h>
 #include <dns/rbt.h>
 #include <dns/rdata.h>
 #include <dns/rdataset.h>
@@ -152,6 +155,30 @@ typedef isc_rwlock_t nodelock_t;
 /*% Time after which we update LRU for all other records, 10 minutes */
 #define DNS_RBTDB_LRUUPDATE_REGULAR 600
 
+/*%
+ * Maximum number of entries the SIEVE hand moves past in one bucket
+ * each time the cache is purged.
+ */
+#ifndef DNS_RBTDB_SIEVE_MAXSCAN
+#define DNS_RBTDB_SIEVE_MAXSCAN 64
+#endif
+
+/*
+ * Maximum number of expired entries removed from one bucket's TTL wheel
+ * each time a new rdataset is added to the cache.
+ */
+#ifndef DNS_RBTDB_EXPIRE_SLICE
+#define DNS_RBTDB_EXPIRE_SLICE 8
+#endif
+
+/*
+ * Maximum number of entries removed from one bucket, with its lock held,
+ * by each call to cache_expire() (see dns_db_expire()).
+ */
+#ifndef DNS_RBTDB_CLEAN_SLICE
+#define DNS_RBTDB_CLEAN_SLICE 64
+#endif
+
 /*
  * Allow clients with a virtual time of up to 5 minutes in the past to see
  * records that would have otherwise have expired.
@@ -165,6 +192,13 @@ struct noqname {
 	dns_rdatatype_t type;
 };
 
+/*
+ * The header is at the front of each rdata slab, so there is one of
+ * these for every RRset in a database; in a cache, it is most of the
+ * memory used for a name with a small RRset.  The fields are grouped by
+ * size, so that there is no padding between them: keep it that way when
+ * adding fields.
+ */
 typedef struct rdatasetheader {
 	/*%
 	 * Locked by the owning node's lock.
@@ -174,15 +208,43 @@ typedef struct rdatasetheader {
 	rbtdb_rdatatype_t type;
 	atomic_uint_least16_t attributes;
 	dns_trust_t trust;
-	atomic_uint_fast32_t last_refresh_fail_ts;
-	struct noqname *noqname;
-	struct noqname *closest;
+	atomic_uint_least32_t last_refresh_fail_ts;
+
+	atomic_uint_least32_t count;
+	/*%<
+	 * Monotonously increased every time this rdataset is bound so that
+	 * it is used as the base of the starting point in DNS responses
+	 * when the "cyclic" rrset-order is required.
+	 */
+
+	isc_stdtime_t last_used;
+	unsigned int heap_index;
+	/*%<
+	 * In a zone DB, the position in the resigning heap.  In a cache,
+	 * the TTL wheel slot (plus one) the header is linked into through
+	 * 'ttl_link'.  Zero if the header is in neither.
+	 */
+	isc_stdtime_t resign;
+	/*%<
+	 * In a zone DB, when the RRset is to be resigned.  In a cache, the
+	 * generation of the last flush of a tree when the RRset was added,
+	 * or found not to be flushed (see rbtdb_flush_t).
+	 */
 	unsigned int resign_lsb : 1;
+	unsigned int sharedproof : 1;
 	/*%<
+	 * In a cache, set if the header is followed by a pointer to the
+	 * rbtdb_proof_t holding its records instead of by its slab.  Set
+	 * before the header is linked to a node and not changed after.
+	 */
+
+	struct noqname *noqname;
+	struct noqname *closest;
+
+	/*
 	 * We don't use the LIST macros, because the LIST structure has
 	 * both head and tail pointers, and is doubly linked.
 	 */
-
 	struct rdatasetheader *next;
 	/*%<
 	 * If this is the top header for an rdataset, 'next' points
@@ -197,23 +259,11 @@ typedef struct rdatasetheader {
 	 * this rdataset.
 	 */
 
-	atomic_uint_fast32_t count;
-	/*%<
-	 * Monotonously increased every time this rdataset is bound so that
-	 * it is used as the base of the starting point in DNS responses
-	 * when the "cyclic" rrset-order is required.
-	 */
-
 	dns_rbtnode_t *node;
-	isc_stdtime_t last_used;
 	ISC_LINK(struct rdatasetheader) link;
+	ISC_LINK(struct rdatasetheader) ttl_link;
 
-	unsigned int heap_index;
-	/*%<
-	 * Used for TTL-based cache cleaning.
-	 */
-	isc_stdtime_t resign;
-	/*%<
+	/*%
 	 * Case vector.  If the bit is set then the corresponding
 	 * character in the owner name needs to be AND'd with 0x20,
 	 * rendering that character upper case.
@@ -222,6 +272,48 @@ typedef struct rdatasetheader {
 } rdatasetheader_t;
 
 typedef ISC_LIST(rdatasetheader_t) rdatasetheaderlist_t;
+
+/*%
+ * The slab of a negative cache entry (see ncache.c), shared by all the
+ * headers caching the same records.  A flood of queries for names that
+ * don't exist caches the same SOA and proofs under every one of those
+ * names; each name then only costs a header.
+ */
+typedef struct rbtdb_proof {
+	struct rbtdb_proof *next;
+	uint32_t hashval;
+	unsigned int length;
+	unsigned int references; /* Locked by prooflock. */
+	/* The slab follows. */
+} rbtdb_proof_t;
+
+#define PROOF(header) (*(rbtdb_proof_t **)((header) + 1))
+#define PROOFHEADER_SIZE \
+	(sizeof(rdatasetheader_t) + sizeof(rbtdb_proof_t *))
+
+/*%
+ * A name flushed from a cache along with everything below it (see
+ * flushtree()).  Rather than finding and expiring the RRsets at and
+ * below the name when it is flushed, each flush gets a new generation,
+ * and the RRsets added before it, which have a lower generation, are
+ * treated as missing and expired when they are next looked at.  The
+ * flush is forgotten once all the RRsets added before it have expired.
+ */
+typedef struct rbtdb_flush {
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	uint32_t generation;
+	isc_stdtime_t expire;
+	ISC_LINK(struct rbtdb_flush) link;
+} rbtdb_flush_t;
+
+/*%
+ * Maximum number of flushes in effect at a time; flushtree() fails with
+ * ISC_R_QUOTA when there are more.
+ */
+#define RBTDB_MAXFLUSHES 64
+
+#define FLUSHED(header, generation) ((header)->resign < (generation))
 typedef ISC_LIST(dns_rbtnode_t) rbtnodelist_t;
 
 #define RDATASET_ATTR_NONEXISTENT 0x0001
@@ -241,6 +333,8 @@ typedef ISC_LIST(dns_rbtnode_t) rbtnodelist_t;
 /*%< Ancient - awaiting cleanup. */
 #define RDATASET_ATTR_ANCIENT	   0x2000
 #define RDATASET_ATTR_STALE_WINDOW 0x4000
+/*%< Used since the SIEVE hand last passed it. */
+#define RDATASET_ATTR_VISITED 0x8000
 
 /*
  * XXX
@@ -314,7 +408,7 @@ typedef ISC_LIST(dns_rbtnode_t) rbtnodelist_t;
 #define DEFAULT_NODE_LOCK_COUNT 7 /*%< Should be prime. */
 
 /*%
- * Number of buckets for cache DB entries (locks, LRU lists, TTL heaps).
+ * Number of buckets for cache DB entries (locks, LRU lists, TTL wheels).
  * There is a tradeoff issue about configuring this value: if this is too
  * small, it may cause heavier contention between threads; if this is too large,
  * LRU purge algorithm won't work well (entries tend to be purged prematurely).
@@ -333,6 +427,41 @@ typedef ISC_LIST(dns_rbtnode_t) rbtnodelist_t;
 #define DEFAULT_CACHE_NODE_LOCK_COUNT 17
 #endif /* DNS_RBTDB_CACHE_NODE_LOCK_COUNT */
 
+/*%
+ * TTL expiry index for one bucket of a cache DB: a hierarchical timing
+ * wheel with one-second resolution.  Level 0 has one slot per second for
+ * the next 256 seconds; each further level has 64 slots, each covering a
+ * whole turn of the level below.  When 'now' crosses a slot boundary of a
+ * higher level, the entries in that slot are spread over the lower levels
+ * ("cascaded"), so every entry is moved at most once per level.
+ *
+ * Entries are keyed on the time at which they stop being servable, stale
+ * or not; entries whose key has already passed are put in the current
+ * level 0 slot.
+ */
+#define TTLWHEEL_LEVELS	 5
+#define TTLWHEEL_L0BITS	 8
+#define TTLWHEEL_LNBITS	 6
+#define TTLWHEEL_L0SLOTS (1 << TTLWHEEL_L0BITS)
+#define TTLWHEEL_LNSLOTS (1 << TTLWHEEL_LNBITS)
+#define TTLWHEEL_SLOTS \
+	(TTLWHEEL_L0SLOTS + (TTLWHEEL_LEVELS - 1) * TTLWHEEL_LNSLOTS)
+#define TTLWHEEL_SHIFT(level) \
+	(TTLWHEEL_L0BITS + ((level)-1) * TTLWHEEL_LNBITS)
+
+/*%
+ * Maximum number of seconds (or, when the wheel is sparse, slot
+ * boundaries) the wheel is advanced by in one call to ttlwheel_expire().
+ */
+#define TTLWHEEL_MAXSTEPS 256
+
+typedef struct {
+	isc_stdtime_t now; /*%< Next second to be expired */
+	unsigned int count;
+	unsigned int levelcount[TTLWHEEL_LEVELS];
+	rdatasetheaderlist_t slots[TTLWHEEL_SLOTS];
+} rbtdb_ttlwheel_t;
+
 typedef struct {
 	nodelock_t lock;
 	/* Protected in the refcount routines. */
@@ -358,9 +487,17 @@ typedef enum { expire_lru, expire_ttl, expire_flush } expire_t;
 
 typedef struct rbtdb_glue rbtdb_glue_t;
 
+/*
+ * The glue for the delegation at 'node' in the versions from 'serial' up
+ * to, but not including, 'until'; 'until' is 0 while the glue has not
+ * been replaced.
+ */
 typedef struct rbtdb_glue_table_node {
 	struct rbtdb_glue_table_node *next;
 	dns_rbtnode_t *node;
+	rbtdb_serial_t serial;
+	rbtdb_serial_t until;
+	ISC_LINK(struct rbtdb_glue_table_node) link;
 	rbtdb_glue_t *glue_list;
 } rbtdb_glue_table_node_t;
 
@@ -401,11 +538,6 @@ typedef struct rbtdb_version {
 	isc_rwlock_t rwlock;
 	uint64_t records;
 	uint64_t xfrsize;
-
-	isc_rwlock_t glue_rwlock;
-	size_t glue_table_bits;
-	size_t glue_table_nodecount;
-	rbtdb_glue_table_node_t **glue_table;
 } rbtdb_version_t;
 
 typedef ISC_LIST(rbtdb_version_t) rbtdb_versionlist_t;
@@ -459,6 +591,58 @@ struct dns_rbtdb {
 	 */
 	rdatasetheaderlist_t *rdatasets;
 
+	/*
+	 * How entries are chosen for purging when the cache is overmem.
+	 * With the SIEVE policy the rdatasets lists are not reordered on
+	 * use, and lruhands[i] is the entry in rdatasets[i] at which the
+	 * next sweep resumes (NULL to start again from the tail).
+	 */
+	dns_evictionpolicy_t evictionpolicy;
+	rdatasetheader_t **lruhands;
+
+	/*%
+	 * Where purged entries are moved, if anywhere; set before the
+	 * cache is used and not changed after that.
+	 */
+	dns_coldcache_t *coldtier;
+
+	/*%
+	 * In a zone, the NSEC3 hashes of the names that were looked up to
+	 * prove that names do not exist; created the first time one is
+	 * needed, and not changed after that.  Locked by lock.
+	 */
+	dns_nsec3cache_t *nsec3cache;
+
+	/*%
+	 * In a cache, the slabs of the negative entries, shared by the
+	 * headers caching the same records (see share_proof()).  Locked
+	 * by prooflock.
+	 */
+	isc_mutex_t prooflock;
+	rbtdb_proof_t **proofs;
+	uint32_t proofbits;
+	size_t nproofs;
+
+	/*%
+	 * In a cache, the nodes that have held an NS RRset, by name, so
+	 * that the closest zone cut above a name is found by looking up
+	 * its suffixes (see find_indexed_zonecut()).  A node is removed
+	 * when it is deleted.  Locked by cutlock.
+	 */
+	isc_rwlock_t cutlock;
+	isc_ht_t *zonecuts;
+
+	/*%
+	 * In a cache, the flushes in effect (see rbtdb_flush_t), locked by
+	 * flushlock, and their number; the generation of the last flush;
+	 * and the latest expiry time given to an RRset.
+	 */
+	isc_rwlock_t flushlock;
+	ISC_LIST(rbtdb_flush_t) flushes;
+	atomic_uint_fast32_t nflushes;
+	atomic_uint_fast32_t flushgen;
+	atomic_uint_fast32_t maxexpiry;
+
 	/*%
 	 * Temporary storage for stale cache nodes and dynamically deleted
 	 * nodes that await being cleaned up.
@@ -466,19 +650,46 @@ struct dns_rbtdb {
 	rbtnodelist_t *deadnodes;
 
 	/*
-	 * Heaps.  These are used for TTL based expiry in a cache,
-	 * or for zone resigning in a zone DB.  hmctx is the memory
-	 * context to use for the heap (which differs from the main
-	 * database memory context in the case of a cache).
+	 * Heaps are used for zone resigning in a zone DB; TTL wheels
+	 * for TTL based expiry in a cache.  hmctx is the memory context
+	 * to use for either (which differs from the main database memory
+	 * context in the case of a cache).
 	 */
 	isc_mem_t *hmctx;
 	isc_heap_t **heaps;
+	rbtdb_ttlwheel_t *ttlwheels;
+
+	/* The bucket at which the next cache_expire() starts. */
+	atomic_uint_fast32_t cleanhand;
 
 	/* Locked by tree_lock. */
 	dns_rbt_t *tree;
 	dns_rbt_t *nsec;
 	dns_rbt_t *nsec3;
 
+	/*
+	 * The glue for the delegations in a zone DB, for all the open
+	 * versions (see rdataset_addglue()).  The entries that were
+	 * replaced are also on glue_replaced, in the order they were
+	 * replaced.  Locked by glue_rwlock.
+	 */
+	isc_rwlock_t glue_rwlock;
+	size_t glue_table_bits;
+	size_t glue_table_nodecount;
+	rbtdb_glue_table_node_t **glue_table;
+	ISC_LIST(rbtdb_glue_table_node_t) glue_replaced;
+
+	/* Only used by the loader and the writer. */
+	isc_ht_t *glue_targets;
+
+	/*
+	 * Bytes allocated for the rdataset headers and slabs, and for the
+	 * glue table, its entries and the glue targets.  The tree nodes
+	 * are counted by the trees (see getmemory()).
+	 */
+	atomic_size_t rdatamem;
+	atomic_size_t gluemem;
+
 	/* Unlocked */
 	unsigned int quantum;
 };
@@ -513,6 +724,15 @@ typedef struct {
 typedef struct {
 	dns_rbtdb_t *rbtdb;
 	isc_stdtime_t now;
+
+	/*
+	 * Loads and transfers add the RRsets of each owner name in a
+	 * row, so the node of the last one is kept to add the others
+	 * without looking the name up again.
+	 */
+	dns_rbtnode_t *lastnode;
+	dns_fixedname_t lastname;
+	bool lastnsec3; /*%< 'lastnode' is in the NSEC3 tree */
 } rbtdb_load_t;
 
 static void
@@ -536,15 +756,21 @@ static isc_result_t
 rdataset_getclosest(dns_rdataset_t *rdataset, dns_name_t *name,
 		    dns_rdataset_t *neg, dns_rdataset_t *negsig);
 static bool
-need_headerupdate(rdatasetheader_t *header, isc_stdtime_t now);
+need_headerupdate(dns_rbtdb_t *rbtdb, rdatasetheader_t *header,
+		  isc_stdtime_t now);
 static void
 update_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header, isc_stdtime_t now);
 static void
+lru_unlink(dns_rbtdb_t *rbtdb, unsigned int idx, rdatasetheader_t *header);
+static void
 expire_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header, bool tree_locked,
 	      expire_t reason);
 static void
 overmem_purge(dns_rbtdb_t *rbtdb, unsigned int locknum_start, isc_stdtime_t now,
 	      bool tree_locked);
+static int
+ttlwheel_expire(dns_rbtdb_t *rbtdb, unsigned int locknum, isc_stdtime_t now,
+		bool tree_locked, int budget);
 static void
 resign_insert(dns_rbtdb_t *rbtdb, int idx, rdatasetheader_t *newheader);
 static void
@@ -566,9 +792,23 @@ static isc_result_t
 rdataset_addglue(dns_rdataset_t *rdataset, dns_dbversion_t *version,
 		 dns_message_t *msg);
 static void
-free_gluetable(rbtdb_version_t *version);
+free_gluetable(dns_rbtdb_t *rbtdb);
+static void
+free_gluetargets(dns_rbtdb_t *rbtdb);
+static void
+glue_load(dns_rbtdb_t *rbtdb);
+static void
+glue_commit(dns_rbtdb_t *rbtdb, rbtdb_version_t *version);
+static void
+free_replaced_glue(dns_rbtdb_t *rbtdb, rbtdb_serial_t least_serial);
 static isc_result_t
 nodefullname(dns_db_t *db, dns_dbnode_t *node, dns_name_t *name);
+static isc_result_t
+addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+	    isc_stdtime_t now, dns_rdataset_t *rdataset, unsigned int options,
+	    dns_rdataset_t *addedrdataset);
+static void
+detachnode(dns_db_t *db, dns_dbnode_t **targetp);
 
 static dns_rdatasetmethods_t rdataset_methods = { rdataset_disassociate,
 						  rdataset_first,
@@ -587,6 +827,29 @@ static dns_rdatasetmethods_t rdataset_methods = { rdataset_disassociate,
 						  rdataset_getownercase,
 						  rdataset_addglue };
 
+/*
+ * The methods for an rdataset bound to a header with a shared slab,
+ * which keep the header in 'private7' (see bind_rdataset()).
+ */
+static dns_rdatasetmethods_t proof_methods = {
+	rdataset_disassociate,
+	rdataset_first,
+	rdataset_next,
+	rdataset_current,
+	rdataset_clone,
+	rdataset_count,
+	NULL, /* addnoqname */
+	NULL, /* getnoqname */
+	NULL, /* addclosest */
+	NULL, /* getclosest */
+	rdataset_settrust,
+	rdataset_expire,
+	rdataset_clearprefetch,
+	rdataset_setownercase,
+	rdataset_getownercase,
+	NULL /* addglue */
+};
+
 static dns_rdatasetmethods_t slab_methods = {
 	rdataset_disassociate,
 	rdataset_first,
@@ -623,6 +886,7 @@ static dns_rdatasetitermethods_t rdatasetiter_methods = {
 typedef struct rbtdb_rdatasetiter {
 	dns_rdatasetiter_t common;
 	rdatasetheader_t *current;
+	uint32_t flushgen; /*%< see node_flushgen() */
 } rbtdb_rdatasetiter_t;
 
 /*
@@ -653,11 +917,15 @@ static isc_result_t
 dbiterator_pause(dns_dbiterator_t *iterator);
 static isc_result_t
 dbiterator_origin(dns_dbiterator_t *iterator, dns_name_t *name);
+static isc_result_t
+dbiterator_currentbatch(dns_dbiterator_t *iterator,
+			dns_dbiteratorbatch_t *batch);
 
 static dns_dbiteratormethods_t dbiterator_methods = {
-	dbiterator_destroy, dbiterator_first, dbiterator_last,
-	dbiterator_seek,    dbiterator_prev,  dbiterator_next,
-	dbiterator_current, dbiterator_pause, dbiterator_origin
+	dbiterator_destroy,	 dbiterator_first, dbiterator_last,
+	dbiterator_seek,	 dbiterator_prev,  dbiterator_next,
+	dbiterator_current,	 dbiterator_pause, dbiterator_origin,
+	dbiterator_currentbatch
 };
 
 #define DELETION_BATCH_MAX 64
@@ -690,6 +958,9 @@ static void
 free_rbtdb(dns_rbtdb_t *rbtdb, bool log, isc_event_t *event);
 static void
 overmem(dns_db_t *db, bool over);
+static unsigned int
+cache_expire(dns_db_t *db, isc_stdtime_t now, bool overmem,
+	     unsigned int budget);
 static void
 setnsec3parameters(dns_db_t *db, rbtdb_version_t *version);
 static void
@@ -843,11 +1114,144 @@ update_rrsetstats(dns_rbtdb_t *rbtdb, const rbtdb_rdatatype_t htype,
 	}
 }
 
+static isc_stdtime_t
+ttlwheel_key(dns_rbtdb_t *rbtdb, rdatasetheader_t *header) {
+	return (header->rdh_ttl + STALE_TTL(header, rbtdb));
+}
+
+static unsigned int
+ttlwheel_level(unsigned int slot) {
+	if (slot < TTLWHEEL_L0SLOTS) {
+		return (0);
+	}
+	return (1 + (slot - TTLWHEEL_L0SLOTS) / TTLWHEEL_LNSLOTS);
+}
+
+/*
+ * Link 'header' into the slot of 'wheel' that 'key' falls into.
+ */
+static void
+ttlwheel_place(rbtdb_ttlwheel_t *wheel, rdatasetheader_t *header,
+	       isc_stdtime_t key) {
+	unsigned int slot, level;
+	isc_stdtime_t delta;
+
+	if (key <= wheel->now) {
+		slot = wheel->now % TTLWHEEL_L0SLOTS;
+		level = 0;
+	} else if ((delta = key - wheel->now) < TTLWHEEL_L0SLOTS) {
+		slot = key % TTLWHEEL_L0SLOTS;
+		level = 0;
+	} else {
+		for (level = 1; level < TTLWHEEL_LEVELS - 1; level++) {
+			if ((delta >> (TTLWHEEL_SHIFT(level) +
+				       TTLWHEEL_LNBITS)) == 0)
+			{
+				break;
+			}
+		}
+		slot = TTLWHEEL_L0SLOTS + (level - 1) * TTLWHEEL_LNSLOTS +
+		       ((key >> TTLWHEEL_SHIFT(level)) % TTLWHEEL_LNSLOTS);
+	}
+
+	ISC_LIST_APPEND(wheel->slots[slot], header, ttl_link);
+	wheel->levelcount[level]++;
+	header->heap_index = slot + 1;
+}
+
+/*
+ * Add 'header' to the TTL wheel of bucket 'idx'.
+ *
+ * The node write lock must be held.
+ */
+static void
+ttlwheel_insert(dns_rbtdb_t *rbtdb, int idx, rdatasetheader_t *header) {
+	rbtdb_ttlwheel_t *wheel = &rbtdb->ttlwheels[idx];
+
+	INSIST(IS_CACHE(rbtdb));
+	INSIST(header->heap_index == 0);
+
+	ttlwheel_place(wheel, header, ttlwheel_key(rbtdb, header));
+	wheel->count++;
+}
+
+/*
+ * Remove 'header' from the TTL wheel of bucket 'idx'.
+ *
+ * The node write lock must be held.
+ */
+static void
+ttlwheel_delete(dns_rbtdb_t *rbtdb, int idx, rdatasetheader_t *header) {
+	rbtdb_ttlwheel_t *wheel = &rbtdb->ttlwheels[idx];
+	unsigned int slot = header->heap_index - 1;
+
+	INSIST(header->heap_index != 0 && slot < TTLWHEEL_SLOTS);
+
+	ISC_LIST_UNLINK(wheel->slots[slot], header, ttl_link);
+	INSIST(wheel->count > 0);
+	wheel->levelcount[ttlwheel_level(slot)]--;
+	wheel->count--;
+	header->heap_index = 0;
+}
+
+/*
+ * Move 'wheel->now' to the next second, or if there is nothing to expire
+ * before then, to the next slot boundary of the lowest level that has any
+ * entries (but not beyond 'until'), and cascade the higher level slots
+ * that start there.
+ */
+static void
+ttlwheel_advance(dns_rbtdb_t *rbtdb, rbtdb_ttlwheel_t *wheel,
+		 isc_stdtime_t until) {
+	uint64_t next = (uint64_t)wheel->now + 1;
+
+	if (wheel->levelcount[0] == 0) {
+		unsigned int level, shift;
+
+		for (level = 1; level < TTLWHEEL_LEVELS - 1; level++) {
+			if (wheel->levelcount[level] != 0) {
+				break;
+			}
+		}
+		shift = TTLWHEEL_SHIFT(level);
+		next = (((uint64_t)wheel->now >> shift) + 1) << shift;
+		if (next > until) {
+			wheel->now = until;
+			return;
+		}
+	}
+
+	wheel->now = (isc_stdtime_t)next;
+
+	for (unsigned int level = TTLWHEEL_LEVELS - 1; level > 0; level--) {
+		unsigned int shift = TTLWHEEL_SHIFT(level);
+		rdatasetheaderlist_t cascade;
+		rdatasetheader_t *header;
+		unsigned int slot;
+
+		if ((wheel->now & ((1U << shift) - 1)) != 0) {
+			continue;
+		}
+
+		slot = TTLWHEEL_L0SLOTS + (level - 1) * TTLWHEEL_LNSLOTS +
+		       ((wheel->now >> shift) % TTLWHEEL_LNSLOTS);
+		cascade = wheel->slots[slot];
+		ISC_LIST_INIT(wheel->slots[slot]);
+
+		while ((header = ISC_LIST_HEAD(cascade)) != NULL) {
+			ISC_LIST_UNLINK(cascade, header, ttl_link);
+			wheel->levelcount[level]--;
+			ttlwheel_place(wheel, header,
+				       ttlwheel_key(rbtdb, header));
+		}
+	}
+}
+
 static void
 set_ttl(dns_rbtdb_t *rbtdb, rdatasetheader_t *header, dns_ttl_t newttl) {
 	int idx;
-	isc_heap_t *heap;
 	dns_ttl_t oldttl;
+	uint_fast32_t expiry;
 
 	if (!IS_CACHE(rbtdb)) {
 		header->rdh_ttl = newttl;
@@ -857,37 +1261,22 @@ set_ttl(dns_rbtdb_t *rbtdb, rdatasetheader_t *header, dns_ttl_t newttl) {
 	oldttl = header->rdh_ttl;
 	header->rdh_ttl = newttl;
 
+	expiry = atomic_load(&rbtdb->maxexpiry);
+	while (newttl > expiry &&
+	       !atomic_compare_exchange_weak(&rbtdb->maxexpiry, &expiry, newttl))
+	{
+	}
+
 	/*
-	 * It's possible the rbtdb is not a cache.  If this is the case,
-	 * we will not have a heap, and we move on.  If we do, though,
-	 * we might need to adjust things.
+	 * If the header is not on the TTL wheel yet, it will be put in
+	 * the right slot when it is added to the cache.
 	 */
 	if (header->heap_index == 0 || newttl == oldttl) {
 		return;
 	}
 	idx = header->node->locknum;
-	if (rbtdb->heaps == NULL || rbtdb->heaps[idx] == NULL) {
-		return;
-	}
-	heap = rbtdb->heaps[idx];
-
-	if (newttl < oldttl) {
-		isc_heap_increased(heap, header->heap_index);
-	} else {
-		isc_heap_decreased(heap, header->heap_index);
-	}
-}
-
-/*%
- * These functions allow the heap code to rank the priority of each
- * element.  It returns true if v1 happens "sooner" than v2.
- */
-static bool
-ttl_sooner(void *v1, void *v2) {
-	rdatasetheader_t *h1 = v1;
-	rdatasetheader_t *h2 = v2;
-
-	return (h1->rdh_ttl < h2->rdh_ttl);
+	ttlwheel_delete(rbtdb, idx, header);
+	ttlwheel_insert(rbtdb, idx, header);
 }
 
 /*%
@@ -989,13 +1378,18 @@ free_rbtdb(dns_rbtdb_t *rbtdb, bool log, isc_event_t *event) {
 	if (rbtdb->current_version != NULL) {
 		isc_refcount_decrementz(&rbtdb->current_version->references);
 		UNLINK(rbtdb->open_versions, rbtdb->current_version, link);
-		isc_rwlock_destroy(&rbtdb->current_version->glue_rwlock);
 		isc_refcount_destroy(&rbtdb->current_version->references);
 		isc_rwlock_destroy(&rbtdb->current_version->rwlock);
 		isc_mem_put(rbtdb->common.mctx, rbtdb->current_version,
 			    sizeof(rbtdb_version_t));
 	}
 
+	if (rbtdb->glue_targets != NULL) {
+		free_gluetable(rbtdb);
+		free_gluetargets(rbtdb);
+		isc_rwlock_destroy(&rbtdb->glue_rwlock);
+	}
+
 	/*
 	 * We assume the number of remaining dead nodes is reasonably small;
 	 * the overhead of unlinking all nodes here should be negligible.
@@ -1085,6 +1479,9 @@ free_rbtdb(dns_rbtdb_t *rbtdb, bool log, isc_event_t *event) {
 		isc_mem_put(rbtdb->common.mctx, rbtdb->rdatasets,
 			    rbtdb->node_lock_count *
 				    sizeof(rdatasetheaderlist_t));
+		isc_mem_put(rbtdb->common.mctx, rbtdb->lruhands,
+			    rbtdb->node_lock_count *
+				    sizeof(rdatasetheader_t *));
 	}
 	/*
 	 * Clean up dead node buckets.
@@ -1097,7 +1494,7 @@ free_rbtdb(dns_rbtdb_t *rbtdb, bool log, isc_event_t *event) {
 			    rbtdb->node_lock_count * sizeof(rbtnodelist_t));
 	}
 	/*
-	 * Clean up heap objects.
+	 * Clean up heap objects and TTL wheels.
 	 */
 	if (rbtdb->heaps != NULL) {
 		for (i = 0; i < rbtdb->node_lock_count; i++) {
@@ -1106,6 +1503,13 @@ free_rbtdb(dns_rbtdb_t *rbtdb, bool log, isc_event_t *event) {
 		isc_mem_put(rbtdb->hmctx, rbtdb->heaps,
 			    rbtdb->node_lock_count * sizeof(isc_heap_t *));
 	}
+	if (rbtdb->ttlwheels != NULL) {
+		for (i = 0; i < rbtdb->node_lock_count; i++) {
+			INSIST(rbtdb->ttlwheels[i].count == 0);
+		}
+		isc_mem_put(rbtdb->hmctx, rbtdb->ttlwheels,
+			    rbtdb->node_lock_count * sizeof(rbtdb_ttlwheel_t));
+	}
 
 	if (rbtdb->rrsetstats != NULL) {
 		dns_stats_detach(&rbtdb->rrsetstats);
@@ -1116,6 +1520,34 @@ free_rbtdb(dns_rbtdb_t *rbtdb, bool log, isc_event_t *event) {
 	if (rbtdb->gluecachestats != NULL) {
 		isc_stats_detach(&rbtdb->gluecachestats);
 	}
+	if (rbtdb->coldtier != NULL) {
+		dns_coldcache_detach(&rbtdb->coldtier);
+	}
+	if (rbtdb->nsec3cache != NULL) {
+		dns_nsec3cache_destroy(&rbtdb->nsec3cache);
+	}
+	if (rbtdb->proofs != NULL) {
+		INSIST(rbtdb->nproofs == 0);
+		isc_mem_put(rbtdb->common.mctx, rbtdb->proofs,
+			    ISC_HASHSIZE(rbtdb->proofbits) *
+				    sizeof(rbtdb->proofs[0]));
+		isc_mutex_destroy(&rbtdb->prooflock);
+	}
+	if (rbtdb->zonecuts != NULL) {
+		isc_ht_destroy(&rbtdb->zonecuts);
+		isc_rwlock_destroy(&rbtdb->cutlock);
+	}
+	if (IS_CACHE(rbtdb)) {
+		rbtdb_flush_t *flush = NULL, *next = NULL;
+
+		for (flush = ISC_LIST_HEAD(rbtdb->flushes); flush != NULL;
+		     flush = next)
+		{
+			next = ISC_LIST_NEXT(flush, link);
+			isc_mem_put(rbtdb->common.mctx, flush, sizeof(*flush));
+		}
+		isc_rwlock_destroy(&rbtdb->flushlock);
+	}
 
 	isc_mem_put(rbtdb->common.mctx, rbtdb->node_locks,
 		    rbtdb->node_lock_count * sizeof(rbtdb_nodelock_t));
@@ -1158,13 +1590,10 @@ maybe_free_rbtdb(dns_rbtdb_t *rbtdb) {
 	}
 
 	/*
-	 * The current version's glue table needs to be freed early
-	 * so the nodes are dereferenced before we check the active
-	 * node count below.
+	 * The glue table needs to be freed early so the rdatasets in it
+	 * are released before we check the active node count below.
 	 */
-	if (rbtdb->current_version != NULL) {
-		free_gluetable(rbtdb->current_version);
-	}
+	free_gluetable(rbtdb);
 
 	/*
 	 * Even though there are no external direct references, there still
@@ -1233,21 +1662,11 @@ static rbtdb_version_t *
 allocate_version(isc_mem_t *mctx, rbtdb_serial_t serial,
 		 unsigned int references, bool writer) {
 	rbtdb_version_t *version;
-	size_t size;
 
 	version = isc_mem_get(mctx, sizeof(*version));
 	version->serial = serial;
 
 	isc_refcount_init(&version->references, references);
-	isc_rwlock_init(&version->glue_rwlock, 0, 0);
-
-	version->glue_table_bits = ISC_HASH_MIN_BITS;
-	version->glue_table_nodecount = 0U;
-
-	size = ISC_HASHSIZE(version->glue_table_bits) *
-	       sizeof(version->glue_table[0]);
-	version->glue_table = isc_mem_get(mctx, size);
-	memset(version->glue_table, 0, size);
 
 	version->writer = writer;
 	version->commit_ok = false;
@@ -1366,9 +1785,11 @@ free_noqname(isc_mem_t *mctx, struct noqname **noqname) {
 static void
 init_rdataset(dns_rbtdb_t *rbtdb, rdatasetheader_t *h) {
 	ISC_LINK_INIT(h, link);
+	ISC_LINK_INIT(h, ttl_link);
 	h->heap_index = 0;
 	atomic_init(&h->attributes, 0);
 	atomic_init(&h->last_refresh_fail_ts, 0);
+	h->sharedproof = 0;
 
 	STATIC_ASSERT((sizeof(h->attributes) == 2),
 		      "The .attributes field of rdatasetheader_t needs to be "
@@ -1394,26 +1815,181 @@ update_newheader(rdatasetheader_t *newh, rdatasetheader_t *old) {
 	}
 }
 
-static rdatasetheader_t *
-new_rdataset(dns_rbtdb_t *rbtdb, isc_mem_t *mctx) {
-	rdatasetheader_t *h;
-
-	h = isc_mem_get(mctx, sizeof(*h));
+/*
+ * Count a header and slab built by dns_rdataslab_fromrdataset(),
+ * dns_rdataslab_merge() or dns_rdataslab_subtract(); free_rdataset()
+ * takes it off again.
+ */
+static void
+slab_allocated(dns_rbtdb_t *rbtdb, rdatasetheader_t *header) {
+	atomic_fetch_add_relaxed(
+		&rbtdb->rdatamem,
+		dns_rdataslab_size((unsigned char *)header, sizeof(*header)));
+}
 
-#if TRACE_HEADER
-	if (IS_CACHE(rbtdb) && rbtdb->common.rdclass == dns_rdataclass_in) {
-		fprintf(stderr, "allocated header: %p\n", h);
+/*
+ * Return the slab of 'header', whether it follows the header or is
+ * shared.
+ */
+static unsigned char *
+header_slab(rdatasetheader_t *header) {
+	if (header->sharedproof) {
+		return ((unsigned char *)(PROOF(header) + 1));
 	}
-#endif /* if TRACE_HEADER */
-	memset(h->upper, 0xeb, sizeof(h->upper));
-	init_rdataset(rbtdb, h);
-	h->rdh_ttl = 0;
-	return (h);
+	return ((unsigned char *)(header + 1));
 }
 
+/*%
+ * Caller must hold prooflock.
+ */
 static void
-free_rdataset(dns_rbtdb_t *rbtdb, isc_mem_t *mctx, rdatasetheader_t *rdataset) {
-	unsigned int size;
+rehash_proofs(dns_rbtdb_t *rbtdb) {
+	uint32_t oldbits = rbtdb->proofbits;
+	uint32_t newbits = oldbits + 1;
+	rbtdb_proof_t **oldtable = rbtdb->proofs;
+	size_t newsize = ISC_HASHSIZE(newbits) * sizeof(oldtable[0]);
+
+	rbtdb->proofs = isc_mem_get(rbtdb->common.mctx, newsize);
+	rbtdb->proofbits = newbits;
+	memset(rbtdb->proofs, 0, newsize);
+
+	for (size_t i = 0; i < ISC_HASHSIZE(oldbits); i++) {
+		rbtdb_proof_t *proof = NULL, *next = NULL;
+		for (proof = oldtable[i]; proof != NULL; proof = next) {
+			uint32_t idx = isc_hash_bits32(proof->hashval,
+						       newbits);
+			next = proof->next;
+			proof->next = rbtdb->proofs[idx];
+			rbtdb->proofs[idx] = proof;
+		}
+	}
+
+	isc_mem_put(rbtdb->common.mctx, oldtable,
+		    ISC_HASHSIZE(oldbits) * sizeof(oldtable[0]));
+}
+
+/*
+ * Replace the header and slab in 'region', made for a negative cache
+ * entry, by a header pointing to a shared copy of the slab, and return
+ * the new header, initialized.
+ */
+static rdatasetheader_t *
+share_proof(dns_rbtdb_t *rbtdb, isc_region_t *region) {
+	unsigned char *slab = region->base + sizeof(rdatasetheader_t);
+	unsigned int length = region->length - sizeof(rdatasetheader_t);
+	uint32_t hashval = isc_hash32(slab, length, true);
+	rbtdb_proof_t *proof = NULL;
+	rdatasetheader_t *header = NULL;
+	uint32_t idx;
+
+	LOCK(&rbtdb->prooflock);
+	idx = isc_hash_bits32(hashval, rbtdb->proofbits);
+	for (proof = rbtdb->proofs[idx]; proof != NULL; proof = proof->next) {
+		if (proof->hashval == hashval && proof->length == length &&
+		    memcmp(proof + 1, slab, length) == 0)
+		{
+			break;
+		}
+	}
+	if (proof == NULL) {
+		proof = isc_mem_get(rbtdb->common.mctx,
+				    sizeof(*proof) + length);
+		atomic_fetch_add_relaxed(&rbtdb->rdatamem,
+					 sizeof(*proof) + length);
+		*proof = (rbtdb_proof_t){
+			.next = rbtdb->proofs[idx],
+			.hashval = hashval,
+			.length = length,
+		};
+		memmove(proof + 1, slab, length);
+		rbtdb->proofs[idx] = proof;
+		rbtdb->nproofs++;
+		if (rbtdb->nproofs >= ISC_HASHSIZE(rbtdb->proofbits) *
+					      ISC_HASH_OVERCOMMIT &&
+		    rbtdb->proofbits < ISC_HASH_MAX_BITS)
+		{
+			rehash_proofs(rbtdb);
+		}
+	}
+	proof->references++;
+	UNLOCK(&rbtdb->prooflock);
+
+	isc_mem_put(rbtdb->common.mctx, region->base, region->length);
+
+	header = isc_mem_get(rbtdb->common.mctx, PROOFHEADER_SIZE);
+	atomic_fetch_add_relaxed(&rbtdb->rdatamem, PROOFHEADER_SIZE);
+	init_rdataset(rbtdb, header);
+	header->sharedproof = 1;
+	PROOF(header) = proof;
+
+	return (header);
+}
+
+/*
+ * Drop a header's reference to 'proof', freeing it with the last one.
+ */
+static void
+release_proof(dns_rbtdb_t *rbtdb, rbtdb_proof_t *proof) {
+	rbtdb_proof_t **prevp = NULL;
+
+	LOCK(&rbtdb->prooflock);
+	INSIST(proof->references > 0);
+	if (--proof->references > 0) {
+		UNLOCK(&rbtdb->prooflock);
+		return;
+	}
+
+	prevp = &rbtdb->proofs[isc_hash_bits32(proof->hashval,
+					       rbtdb->proofbits)];
+	while (*prevp != proof) {
+		INSIST(*prevp != NULL);
+		prevp = &(*prevp)->next;
+	}
+	*prevp = proof->next;
+	rbtdb->nproofs--;
+	UNLOCK(&rbtdb->prooflock);
+
+	atomic_fetch_sub_relaxed(&rbtdb->rdatamem,
+				 sizeof(*proof) + proof->length);
+	isc_mem_put(rbtdb->common.mctx, proof, sizeof(*proof) + proof->length);
+}
+
+/*
+ * Allocate and free memory for the glue, counting it in 'gluemem'.
+ */
+static void *
+glue_get(dns_rbtdb_t *rbtdb, size_t size) {
+	atomic_fetch_add_relaxed(&rbtdb->gluemem, size);
+	return (isc_mem_get(rbtdb->common.mctx, size));
+}
+
+static void
+glue_put(dns_rbtdb_t *rbtdb, void *ptr, size_t size) {
+	atomic_fetch_sub_relaxed(&rbtdb->gluemem, size);
+	isc_mem_put(rbtdb->common.mctx, ptr, size);
+}
+
+static rdatasetheader_t *
+new_rdataset(dns_rbtdb_t *rbtdb, isc_mem_t *mctx) {
+	rdatasetheader_t *h;
+
+	h = isc_mem_get(mctx, sizeof(*h));
+	atomic_fetch_add_relaxed(&rbtdb->rdatamem, sizeof(*h));
+
+#if TRACE_HEADER
+	if (IS_CACHE(rbtdb) && rbtdb->common.rdclass == dns_rdataclass_in) {
+		fprintf(stderr, "allocated header: %p\n", h);
+	}
+#endif /* if TRACE_HEADER */
+	memset(h->upper, 0xeb, sizeof(h->upper));
+	init_rdataset(rbtdb, h);
+	h->rdh_ttl = 0;
+	return (h);
+}
+
+static void
+free_rdataset(dns_rbtdb_t *rbtdb, isc_mem_t *mctx, rdatasetheader_t *rdataset) {
+	unsigned int size;
 	int idx;
 
 	update_rrsetstats(rbtdb, rdataset->type,
@@ -1422,11 +1998,16 @@ free_rdataset(dns_rbtdb_t *rbtdb, isc_mem_t *mctx, rdatasetheader_t *rdataset) {
 	idx = rdataset->node->locknum;
 	if (ISC_LINK_LINKED(rdataset, link)) {
 		INSIST(IS_CACHE(rbtdb));
-		ISC_LIST_UNLINK(rbtdb->rdatasets[idx], rdataset, link);
+		lru_unlink(rbtdb, idx, rdataset);
 	}
 
 	if (rdataset->heap_index != 0) {
-		isc_heap_delete(rbtdb->heaps[idx], rdataset->heap_index);
+		if (IS_CACHE(rbtdb)) {
+			ttlwheel_delete(rbtdb, idx, rdataset);
+		} else {
+			isc_heap_delete(rbtdb->heaps[idx],
+					rdataset->heap_index);
+		}
 	}
 	rdataset->heap_index = 0;
 
@@ -1437,13 +2018,17 @@ free_rdataset(dns_rbtdb_t *rbtdb, isc_mem_t *mctx, rdatasetheader_t *rdataset) {
 		free_noqname(mctx, &rdataset->closest);
 	}
 
-	if (NONEXISTENT(rdataset)) {
+	if (rdataset->sharedproof) {
+		release_proof(rbtdb, PROOF(rdataset));
+		size = PROOFHEADER_SIZE;
+	} else if (NONEXISTENT(rdataset)) {
 		size = sizeof(*rdataset);
 	} else {
 		size = dns_rdataslab_size((unsigned char *)rdataset,
 					  sizeof(*rdataset));
 	}
 
+	atomic_fetch_sub_relaxed(&rbtdb->rdatamem, size);
 	isc_mem_put(mctx, rdataset, size);
 }
 
@@ -1714,6 +2299,59 @@ clean_zone_node(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 	}
 }
 
+/*
+ * The zone cut index is keyed on names in lower case.
+ */
+static void
+zonecut_key(const dns_name_t *name, unsigned char *key) {
+	isc_ascii_lowercopy(key, name->ndata, name->length);
+}
+
+/*
+ * Add 'node', named 'name', to the zone cut index of a cache, as an NS
+ * RRset is being added to it.
+ *
+ * Caller must hold the node (write) lock.
+ */
+static void
+index_zonecut(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
+	      const dns_name_t *name) {
+	unsigned char key[DNS_NAME_MAXWIRE];
+	isc_result_t result;
+
+	zonecut_key(name, key);
+	RWLOCK(&rbtdb->cutlock, isc_rwlocktype_write);
+	result = isc_ht_add(rbtdb->zonecuts, key, name->length, node);
+	RWUNLOCK(&rbtdb->cutlock, isc_rwlocktype_write);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS || result == ISC_R_EXISTS);
+	if (result == ISC_R_SUCCESS) {
+		node->zonecut = 1;
+	}
+}
+
+/*
+ * Remove 'node', which is being deleted, from the zone cut index.
+ *
+ * Caller must hold the tree (write) lock and the node (write) lock.
+ */
+static void
+unindex_zonecut(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node) {
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	unsigned char key[DNS_NAME_MAXWIRE];
+	isc_result_t result;
+
+	result = dns_rbt_fullnamefromnode(node, name);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+	zonecut_key(name, key);
+	RWLOCK(&rbtdb->cutlock, isc_rwlocktype_write);
+	result = isc_ht_delete(rbtdb->zonecuts, key, name->length);
+	RWUNLOCK(&rbtdb->cutlock, isc_rwlocktype_write);
+	INSIST(result == ISC_R_SUCCESS);
+	node->zonecut = 0;
+}
+
 /*
  * tree_lock(write) must be held.
  */
@@ -1726,6 +2364,10 @@ delete_node(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node) {
 
 	INSIST(!ISC_LINK_LINKED(node, deadlink));
 
+	if (node->zonecut) {
+		unindex_zonecut(rbtdb, node);
+	}
+
 	if (isc_log_wouldlog(dns_lctx, ISC_LOG_DEBUG(1))) {
 		char printname[DNS_NAME_FORMATSIZE];
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_DATABASE,
@@ -2417,6 +3059,15 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp, bool commit) {
 		iszonesecure(db, version, rbtdb->origin_node);
 	}
 
+	/*
+	 * Recompute the glue for the delegations affected by the changes
+	 * in version, so that it is ready when it becomes current.
+	 */
+	if (version->writer && commit && !IS_CACHE(rbtdb) && !IS_STUB(rbtdb))
+	{
+		glue_commit(rbtdb, version);
+	}
+
 	RBTDB_LOCK(&rbtdb->lock, isc_rwlocktype_write);
 	serial = version->serial;
 	if (version->writer) {
@@ -2554,10 +3205,12 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp, bool commit) {
 	least_serial = rbtdb->least_serial;
 	RBTDB_UNLOCK(&rbtdb->lock, isc_rwlocktype_write);
 
+	if (!IS_CACHE(rbtdb)) {
+		free_replaced_glue(rbtdb, least_serial);
+	}
+
 	if (cleanup_version != NULL) {
 		INSIST(EMPTY(cleanup_version->changed_list));
-		free_gluetable(cleanup_version);
-		isc_rwlock_destroy(&cleanup_version->glue_rwlock);
 		isc_rwlock_destroy(&cleanup_version->rwlock);
 		isc_mem_put(rbtdb->common.mctx, cleanup_version,
 			    sizeof(*cleanup_version));
@@ -2963,7 +3616,6 @@ static void
 bind_rdataset(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node, rdatasetheader_t *header,
 	      isc_stdtime_t now, isc_rwlocktype_t locktype,
 	      dns_rdataset_t *rdataset) {
-	unsigned char *raw; /* RDATASLAB */
 	bool stale = STALE(header);
 	bool ancient = ANCIENT(header);
 
@@ -3046,8 +3698,7 @@ bind_rdataset(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node, rdatasetheader_t *header,
 
 	rdataset->private1 = rbtdb;
 	rdataset->private2 = node;
-	raw = (unsigned char *)header + sizeof(*header);
-	rdataset->private3 = raw;
+	rdataset->private3 = header_slab(header);
 	rdataset->count = atomic_fetch_add_relaxed(&header->count, 1);
 	if (rdataset->count == UINT32_MAX) {
 		rdataset->count = 0;
@@ -3071,6 +3722,17 @@ bind_rdataset(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node, rdatasetheader_t *header,
 		rdataset->attributes |= DNS_RDATASETATTR_CLOSEST;
 	}
 
+	/*
+	 * A shared slab doesn't lead back to the header, so keep it
+	 * where the closest encloser proof would be; a negative entry
+	 * has none.
+	 */
+	if (header->sharedproof) {
+		INSIST(header->closest == NULL);
+		rdataset->methods = &proof_methods;
+		rdataset->private7 = header;
+	}
+
 	/*
 	 * Copy out re-signing information.
 	 */
@@ -4433,10 +5095,114 @@ zone_findzonecut(dns_db_t *db, const dns_name_t *name, unsigned int options,
 	return (ISC_R_NOTIMPLEMENTED);
 }
 
+/*
+ * Return the generation of the last flush of 'name' or of a name above
+ * it in effect at 'now', or 0 if there is none: the RRsets of 'name'
+ * with a lower generation have been flushed.
+ */
+static uint32_t
+flushgen(dns_rbtdb_t *rbtdb, const dns_name_t *name, isc_stdtime_t now) {
+	uint32_t generation = 0;
+
+	if (atomic_load_acquire(&rbtdb->nflushes) == 0) {
+		return (0);
+	}
+
+	RWLOCK(&rbtdb->flushlock, isc_rwlocktype_read);
+	for (rbtdb_flush_t *flush = ISC_LIST_HEAD(rbtdb->flushes);
+	     flush != NULL; flush = ISC_LIST_NEXT(flush, link))
+	{
+		if (flush->expire > now && flush->generation > generation &&
+		    dns_name_issubdomain(name, flush->name))
+		{
+			generation = flush->generation;
+		}
+	}
+	RWUNLOCK(&rbtdb->flushlock, isc_rwlocktype_read);
+
+	return (generation);
+}
+
+/*
+ * flushgen() for the name of 'node'.  The caller must hold the tree lock
+ * if 'tree_locked' is true, and must not hold it otherwise.
+ */
+static uint32_t
+node_flushgen(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node, bool tree_locked,
+	      isc_stdtime_t now) {
+	dns_fixedname_t fixed;
+	dns_name_t *name = NULL;
+
+	if (atomic_load_acquire(&rbtdb->nflushes) == 0) {
+		return (0);
+	}
+
+	name = dns_fixedname_initname(&fixed);
+	if (tree_locked) {
+		dns_rbt_fullnamefromnode(node, name);
+	} else {
+		nodefullname((dns_db_t *)rbtdb, node, name);
+	}
+
+	return (flushgen(rbtdb, name, now));
+}
+
+/*
+ * Expire 'header', which has been flushed, if the node lock is or can be
+ * made a write lock; it is skipped by the lookups in the meantime.
+ */
+static void
+flush_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header,
+	     isc_rwlocktype_t *locktype, nodelock_t *lock) {
+	if (header->rdh_ttl != 0 && (*locktype == isc_rwlocktype_write ||
+				     NODE_TRYUPGRADE(lock) == ISC_R_SUCCESS))
+	{
+		*locktype = isc_rwlocktype_write;
+		set_ttl(rbtdb, header, 0);
+		mark_header_ancient(rbtdb, header);
+	}
+}
+
+/*
+ * Return true if 'header', at 'node', has been flushed.  A header found
+ * not to be is given the generation of the last flush, so that it isn't
+ * looked at again until the next one.  The caller must hold the tree
+ * lock.
+ */
+static bool
+check_flushed_header(dns_rbtnode_t *node, rdatasetheader_t *header,
+		     isc_rwlocktype_t *locktype, nodelock_t *lock,
+		     rbtdb_search_t *search) {
+	dns_rbtdb_t *rbtdb = search->rbtdb;
+	uint32_t last = atomic_load(&rbtdb->flushgen);
+
+	if (!FLUSHED(header, last) || ANCIENT(header)) {
+		return (false);
+	}
+
+	if (FLUSHED(header, node_flushgen(rbtdb, node, true, search->now))) {
+		flush_header(rbtdb, header, locktype, lock);
+		return (true);
+	}
+
+	if (*locktype == isc_rwlocktype_write ||
+	    NODE_TRYUPGRADE(lock) == ISC_R_SUCCESS)
+	{
+		*locktype = isc_rwlocktype_write;
+		header->resign = last;
+	}
+	return (false);
+}
+
 static bool
 check_stale_header(dns_rbtnode_t *node, rdatasetheader_t *header,
 		   isc_rwlocktype_t *locktype, nodelock_t *lock,
 		   rbtdb_search_t *search, rdatasetheader_t **header_prev) {
+	if (check_flushed_header(node, header, locktype, lock, search)) {
+		*header_prev = header;
+		return (true);
+	}
+
 	if (!ACTIVE(header, search->now)) {
 		dns_ttl_t stale = header->rdh_ttl +
 				  STALE_TTL(header, search->rbtdb);
@@ -4715,9 +5481,11 @@ find_deepest_zonecut(rbtdb_search_t *search, dns_rbtnode_t *node,
 					      search->now, locktype,
 					      sigrdataset);
 			}
-			if (need_headerupdate(found, search->now) ||
+			if (need_headerupdate(search->rbtdb, found,
+					      search->now) ||
 			    (foundsig != NULL &&
-			     need_headerupdate(foundsig, search->now)))
+			     need_headerupdate(search->rbtdb, foundsig,
+					       search->now)))
 			{
 				if (locktype != isc_rwlocktype_write) {
 					NODE_UNLOCK(lock, locktype);
@@ -4725,12 +5493,16 @@ find_deepest_zonecut(rbtdb_search_t *search, dns_rbtnode_t *node,
 					locktype = isc_rwlocktype_write;
 					POST(locktype);
 				}
-				if (need_headerupdate(found, search->now)) {
+				if (need_headerupdate(search->rbtdb, found,
+						      search->now))
+				{
 					update_header(search->rbtdb, found,
 						      search->now);
 				}
 				if (foundsig != NULL &&
-				    need_headerupdate(foundsig, search->now)) {
+				    need_headerupdate(search->rbtdb, foundsig,
+						      search->now))
+				{
 					update_header(search->rbtdb, foundsig,
 						      search->now);
 				}
@@ -4751,6 +5523,121 @@ find_deepest_zonecut(rbtdb_search_t *search, dns_rbtnode_t *node,
 	return (result);
 }
 
+/*
+ * Find the closest zone cut at or above 'name', or strictly above it if
+ * DNS_DBFIND_NOEXACT is set, by looking up its suffixes, longest first,
+ * in the zone cut index, until one names a node with a usable NS RRset.
+ *
+ * Caller must be holding the tree lock.
+ */
+static isc_result_t
+find_indexed_zonecut(rbtdb_search_t *search, const dns_name_t *name,
+		     dns_dbnode_t **nodep, dns_name_t *foundname,
+		     dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset) {
+	dns_rbtdb_t *rbtdb = search->rbtdb;
+	unsigned int labels = dns_name_countlabels(name);
+	unsigned char key[DNS_NAME_MAXWIRE];
+	unsigned int i = 0;
+
+	/*
+	 * The key of every suffix is the end of the key of 'name'.
+	 */
+	zonecut_key(name, key);
+
+	if ((search->options & DNS_DBFIND_NOEXACT) != 0) {
+		i = 1;
+	}
+
+	for (; i < labels; i++) {
+		dns_name_t suffix;
+		dns_rbtnode_t *node = NULL;
+		rdatasetheader_t *header = NULL, *header_prev = NULL;
+		rdatasetheader_t *header_next = NULL;
+		rdatasetheader_t *found = NULL, *foundsig = NULL;
+		isc_rwlocktype_t locktype = isc_rwlocktype_read;
+		nodelock_t *lock = NULL;
+		isc_result_t result;
+
+		dns_name_init(&suffix, NULL);
+		dns_name_getlabelsequence(name, i, labels - i, &suffix);
+
+		RWLOCK(&rbtdb->cutlock, isc_rwlocktype_read);
+		result = isc_ht_find(rbtdb->zonecuts,
+				     key + name->length - suffix.length,
+				     suffix.length, (void **)&node);
+		RWUNLOCK(&rbtdb->cutlock, isc_rwlocktype_read);
+		if (result != ISC_R_SUCCESS) {
+			continue;
+		}
+
+		lock = &rbtdb->node_locks[node->locknum].lock;
+		NODE_LOCK(lock, locktype);
+
+		for (header = node->data; header != NULL; header = header_next)
+		{
+			header_next = header->next;
+			if (check_stale_header(node, header, &locktype, lock,
+					       search, &header_prev)) {
+				/* Do nothing. */
+			} else if (EXISTS(header) && !ANCIENT(header)) {
+				if (header->type == dns_rdatatype_ns) {
+					found = header;
+				} else if (header->type ==
+					   RBTDB_RDATATYPE_SIGNS) {
+					foundsig = header;
+				}
+				header_prev = header;
+			} else {
+				header_prev = header;
+			}
+		}
+
+		if (found == NULL) {
+			NODE_UNLOCK(lock, locktype);
+			continue;
+		}
+
+		if (foundname != NULL) {
+			dns_name_copy(&suffix, foundname);
+		}
+		if (nodep != NULL) {
+			new_reference(rbtdb, node, locktype);
+			*nodep = node;
+		}
+		bind_rdataset(rbtdb, node, found, search->now, locktype,
+			      rdataset);
+		if (foundsig != NULL) {
+			bind_rdataset(rbtdb, node, foundsig, search->now,
+				      locktype, sigrdataset);
+		}
+
+		if (need_headerupdate(rbtdb, found, search->now) ||
+		    (foundsig != NULL &&
+		     need_headerupdate(rbtdb, foundsig, search->now)))
+		{
+			if (locktype != isc_rwlocktype_write) {
+				NODE_UNLOCK(lock, locktype);
+				NODE_LOCK(lock, isc_rwlocktype_write);
+				locktype = isc_rwlocktype_write;
+			}
+			if (need_headerupdate(rbtdb, found, search->now)) {
+				update_header(rbtdb, found, search->now);
+			}
+			if (foundsig != NULL &&
+			    need_headerupdate(rbtdb, foundsig, search->now))
+			{
+				update_header(rbtdb, foundsig, search->now);
+			}
+		}
+
+		NODE_UNLOCK(lock, locktype);
+
+		return (DNS_R_DELEGATION);
+	}
+
+	return (ISC_R_NOTFOUND);
+}
+
 /*
  * Look for a potentially covering NSEC in the cache where `name`
  * is known not to exist.  This uses the auxiliary NSEC tree to find
@@ -4869,10 +5756,10 @@ find_coveringnsec(rbtdb_search_t *search, const dns_name_t *name,
 }
 
 static isc_result_t
-cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
-	   dns_rdatatype_t type, unsigned int options, isc_stdtime_t now,
-	   dns_dbnode_t **nodep, dns_name_t *foundname,
-	   dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset) {
+cache_findhot(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
+	      dns_rdatatype_t type, unsigned int options, isc_stdtime_t now,
+	      dns_dbnode_t **nodep, dns_name_t *foundname,
+	      dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset) {
 	dns_rbtnode_t *node = NULL;
 	isc_result_t result;
 	rbtdb_search_t search;
@@ -5110,14 +5997,18 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 			}
 			bind_rdataset(search.rbtdb, node, nsecheader,
 				      search.now, locktype, rdataset);
-			if (need_headerupdate(nsecheader, search.now)) {
+			if (need_headerupdate(search.rbtdb, nsecheader,
+					      search.now))
+			{
 				update = nsecheader;
 			}
 			if (nsecsig != NULL) {
 				bind_rdataset(search.rbtdb, node, nsecsig,
 					      search.now, locktype,
 					      sigrdataset);
-				if (need_headerupdate(nsecsig, search.now)) {
+				if (need_headerupdate(search.rbtdb, nsecsig,
+						      search.now))
+				{
 					updatesig = nsecsig;
 				}
 			}
@@ -5152,14 +6043,18 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 			}
 			bind_rdataset(search.rbtdb, node, nsheader, search.now,
 				      locktype, rdataset);
-			if (need_headerupdate(nsheader, search.now)) {
+			if (need_headerupdate(search.rbtdb, nsheader,
+					      search.now))
+			{
 				update = nsheader;
 			}
 			if (nssig != NULL) {
 				bind_rdataset(search.rbtdb, node, nssig,
 					      search.now, locktype,
 					      sigrdataset);
-				if (need_headerupdate(nssig, search.now)) {
+				if (need_headerupdate(search.rbtdb, nssig,
+						      search.now))
+				{
 					updatesig = nssig;
 				}
 			}
@@ -5213,13 +6108,15 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	{
 		bind_rdataset(search.rbtdb, node, found, search.now, locktype,
 			      rdataset);
-		if (need_headerupdate(found, search.now)) {
+		if (need_headerupdate(search.rbtdb, found, search.now)) {
 			update = found;
 		}
 		if (!NEGATIVE(found) && foundsig != NULL) {
 			bind_rdataset(search.rbtdb, node, foundsig, search.now,
 				      locktype, sigrdataset);
-			if (need_headerupdate(foundsig, search.now)) {
+			if (need_headerupdate(search.rbtdb, foundsig,
+					      search.now))
+			{
 				updatesig = foundsig;
 			}
 		}
@@ -5233,10 +6130,14 @@ node_exit:
 		locktype = isc_rwlocktype_write;
 		POST(locktype);
 	}
-	if (update != NULL && need_headerupdate(update, search.now)) {
+	if (update != NULL &&
+	    need_headerupdate(search.rbtdb, update, search.now))
+	{
 		update_header(search.rbtdb, update, search.now);
 	}
-	if (updatesig != NULL && need_headerupdate(updatesig, search.now)) {
+	if (updatesig != NULL &&
+	    need_headerupdate(search.rbtdb, updatesig, search.now))
+	{
 		update_header(search.rbtdb, updatesig, search.now);
 	}
 
@@ -5262,23 +6163,141 @@ tree_exit:
 
 	dns_rbtnodechain_reset(&search.chain);
 
-	update_cachestats(search.rbtdb, result);
 	return (result);
 }
 
-static isc_result_t
-cache_findzonecut(dns_db_t *db, const dns_name_t *name, unsigned int options,
-		  isc_stdtime_t now, dns_dbnode_t **nodep,
-		  dns_name_t *foundname, dns_name_t *dcname,
-		  dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset) {
-	dns_rbtnode_t *node = NULL;
-	nodelock_t *lock;
-	isc_result_t result;
-	rbtdb_search_t search;
-	rdatasetheader_t *header, *header_prev, *header_next;
-	rdatasetheader_t *found, *foundsig;
-	unsigned int rbtoptions = DNS_RBTFIND_EMPTYDATA;
-	isc_rwlocktype_t locktype;
+/*%
+ * Move the 'name'/'type' RRset and its signatures back from the cold
+ * tier into the cache, and likewise a CNAME found there in its place.
+ * Returns true if anything was moved.
+ */
+static bool
+coldtier_promote(dns_rbtdb_t *rbtdb, const dns_name_t *name,
+		 dns_rdatatype_t type, isc_stdtime_t now) {
+	const dns_rdatatype_t types[] = { type, dns_rdatatype_cname };
+	dns_dbnode_t *node = NULL;
+	unsigned int promoted = 0;
+
+	for (size_t i = 0; i < ARRAY_SIZE(types); i++) {
+		if (i > 0 && types[i] == type) {
+			break;
+		}
+		for (size_t sig = 0; sig < 2; sig++) {
+			dns_rdatatype_t rtype = sig == 0 ? types[i]
+							 : dns_rdatatype_rrsig;
+			dns_rdatatype_t covers = sig == 0 ? 0 : types[i];
+			dns_rdataset_t rdataset;
+			isc_region_t slab;
+			dns_trust_t trust;
+			isc_stdtime_t expire;
+			isc_result_t result;
+
+			result = dns_coldcache_take(rbtdb->coldtier, name,
+						    rtype, covers, now,
+						    rbtdb->common.mctx, &slab,
+						    &trust, &expire);
+			if (result != ISC_R_SUCCESS) {
+				/*
+				 * Signatures are only looked for if the
+				 * RRset itself was found.
+				 */
+				break;
+			}
+
+			if (node == NULL) {
+				result = findnode((dns_db_t *)rbtdb, name, true,
+						  &node);
+			}
+			if (result == ISC_R_SUCCESS) {
+				dns_rdataset_init(&rdataset);
+				dns_rdataslab_tordataset(
+					slab.base, 0, rbtdb->common.rdclass,
+					rtype, covers, expire - now, &rdataset);
+				rdataset.trust = trust;
+				result = addrdataset((dns_db_t *)rbtdb, node,
+						     NULL, now, &rdataset, 0,
+						     NULL);
+				dns_rdataset_disassociate(&rdataset);
+			}
+			isc_mem_put(rbtdb->common.mctx, slab.base,
+				    slab.length);
+
+			if (result == ISC_R_SUCCESS ||
+			    result == DNS_R_UNCHANGED)
+			{
+				promoted++;
+			}
+		}
+	}
+
+	if (node != NULL) {
+		detachnode((dns_db_t *)rbtdb, &node);
+	}
+
+	if (promoted > 0 && rbtdb->cachestats != NULL) {
+		isc_stats_add(rbtdb->cachestats,
+			      dns_cachestatscounter_coldpromoted, promoted);
+	}
+
+	return (promoted > 0);
+}
+
+static isc_result_t
+cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
+	   dns_rdatatype_t type, unsigned int options, isc_stdtime_t now,
+	   dns_dbnode_t **nodep, dns_name_t *foundname,
+	   dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+	isc_result_t result;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+
+	if (now == 0) {
+		isc_stdtime_get(&now);
+	}
+
+	result = cache_findhot(db, name, version, type, options, now, nodep,
+			       foundname, rdataset, sigrdataset);
+
+	/*
+	 * Before reporting a miss, see whether the RRset was purged
+	 * to the cold tier, and if so, look it up again once it has been
+	 * moved back.
+	 */
+	if ((result == ISC_R_NOTFOUND || result == DNS_R_DELEGATION) &&
+	    rbtdb->coldtier != NULL && type != dns_rdatatype_any &&
+	    type != dns_rdatatype_rrsig &&
+	    coldtier_promote(rbtdb, name, type, now))
+	{
+		if (nodep != NULL && *nodep != NULL) {
+			detachnode(db, nodep);
+		}
+		if (rdataset != NULL && dns_rdataset_isassociated(rdataset)) {
+			dns_rdataset_disassociate(rdataset);
+		}
+		if (sigrdataset != NULL &&
+		    dns_rdataset_isassociated(sigrdataset))
+		{
+			dns_rdataset_disassociate(sigrdataset);
+		}
+		result = cache_findhot(db, name, version, type, options, now,
+				       nodep, foundname, rdataset,
+				       sigrdataset);
+	}
+
+	update_cachestats(rbtdb, result);
+	return (result);
+}
+
+static isc_result_t
+cache_findzonecut(dns_db_t *db, const dns_name_t *name, unsigned int options,
+		  isc_stdtime_t now, dns_dbnode_t **nodep,
+		  dns_name_t *foundname, dns_name_t *dcname,
+		  dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset) {
+	dns_rbtnode_t *node = NULL;
+	isc_result_t result;
+	rbtdb_search_t search;
+	unsigned int rbtoptions = DNS_RBTFIND_EMPTYDATA;
 	bool dcnull = (dcname == NULL);
 
 	search.rbtdb = (dns_rbtdb_t *)db;
@@ -5311,118 +6330,20 @@ cache_findzonecut(dns_db_t *db, const dns_name_t *name, unsigned int options,
 	RWLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
 
 	/*
-	 * Search down from the root of the tree.
-	 */
-	result = dns_rbt_findnode(search.rbtdb->tree, name, dcname, &node,
-				  &search.chain, rbtoptions, NULL, &search);
-
-	if (result == DNS_R_PARTIALMATCH) {
-		result = find_deepest_zonecut(&search, node, nodep, foundname,
-					      rdataset, sigrdataset);
-		goto tree_exit;
-	} else if (result != ISC_R_SUCCESS) {
-		goto tree_exit;
-	} else if (!dcnull) {
-		dns_name_copy(dcname, foundname);
-	}
-
-	/*
-	 * We now go looking for an NS rdataset at the node.
-	 */
-
-	lock = &(search.rbtdb->node_locks[node->locknum].lock);
-	locktype = isc_rwlocktype_read;
-	NODE_LOCK(lock, locktype);
-
-	found = NULL;
-	foundsig = NULL;
-	header_prev = NULL;
-	for (header = node->data; header != NULL; header = header_next) {
-		header_next = header->next;
-		if (check_stale_header(node, header, &locktype, lock, &search,
-				       &header_prev)) {
-			/*
-			 * The function dns_rbt_findnode found us the a matching
-			 * node for 'name' and stored the result in 'dcname'.
-			 * This is the deepest known zonecut in our database.
-			 * However, this node may be stale and if serve-stale
-			 * is not enabled (in other words 'stale-answer-enable'
-			 * is set to no), this node may not be used as a
-			 * zonecut we know about. If so, find the deepest
-			 * zonecut from this node up and return that instead.
-			 */
-			NODE_UNLOCK(lock, locktype);
-			result = find_deepest_zonecut(&search, node, nodep,
-						      foundname, rdataset,
-						      sigrdataset);
-			dns_name_copy(foundname, dcname);
+	 * The tree is only searched for 'dcname', the deepest name
+	 * known at or above 'name'; the zone cut is looked up in the
+	 * index.
+	 */
+	if (!dcnull) {
+		result = dns_rbt_findnode(search.rbtdb->tree, name, dcname,
+					  &node, NULL, rbtoptions, NULL, NULL);
+		if (result != ISC_R_SUCCESS && result != DNS_R_PARTIALMATCH) {
 			goto tree_exit;
-		} else if (EXISTS(header) && !ANCIENT(header)) {
-			/*
-			 * If we found a type we were looking for, remember
-			 * it.
-			 */
-			if (header->type == dns_rdatatype_ns) {
-				/*
-				 * Remember a NS rdataset even if we're
-				 * not specifically looking for it, because
-				 * we might need it later.
-				 */
-				found = header;
-			} else if (header->type == RBTDB_RDATATYPE_SIGNS) {
-				/*
-				 * If we need the NS rdataset, we'll also
-				 * need its signature.
-				 */
-				foundsig = header;
-			}
-			header_prev = header;
-		} else {
-			header_prev = header;
-		}
-	}
-
-	if (found == NULL) {
-		/*
-		 * No NS records here.
-		 */
-		NODE_UNLOCK(lock, locktype);
-		result = find_deepest_zonecut(&search, node, nodep, foundname,
-					      rdataset, sigrdataset);
-		goto tree_exit;
-	}
-
-	if (nodep != NULL) {
-		new_reference(search.rbtdb, node, locktype);
-		*nodep = node;
-	}
-
-	bind_rdataset(search.rbtdb, node, found, search.now, locktype,
-		      rdataset);
-	if (foundsig != NULL) {
-		bind_rdataset(search.rbtdb, node, foundsig, search.now,
-			      locktype, sigrdataset);
-	}
-
-	if (need_headerupdate(found, search.now) ||
-	    (foundsig != NULL && need_headerupdate(foundsig, search.now)))
-	{
-		if (locktype != isc_rwlocktype_write) {
-			NODE_UNLOCK(lock, locktype);
-			NODE_LOCK(lock, isc_rwlocktype_write);
-			locktype = isc_rwlocktype_write;
-			POST(locktype);
-		}
-		if (need_headerupdate(found, search.now)) {
-			update_header(search.rbtdb, found, search.now);
-		}
-		if (foundsig != NULL && need_headerupdate(foundsig, search.now))
-		{
-			update_header(search.rbtdb, foundsig, search.now);
 		}
 	}
 
-	NODE_UNLOCK(lock, locktype);
+	result = find_indexed_zonecut(&search, name, nodep, foundname,
+				      rdataset, sigrdataset);
 
 tree_exit:
 	RWUNLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
@@ -5509,6 +6430,7 @@ expirenode(dns_db_t *db, dns_dbnode_t *node, isc_stdtime_t now) {
 	dns_rbtnode_t *rbtnode = node;
 	rdatasetheader_t *header;
 	bool force_expire = false;
+	uint32_t generation;
 	/*
 	 * These are the category and module used by the cache cleaner.
 	 */
@@ -5552,6 +6474,8 @@ expirenode(dns_db_t *db, dns_dbnode_t *node, isc_stdtime_t now) {
 		}
 	}
 
+	generation = node_flushgen(rbtdb, rbtnode, true, now);
+
 	/*
 	 * We may not need write access, but this code path is not performance
 	 * sensitive, so it should be okay to always lock as a writer.
@@ -5560,8 +6484,12 @@ expirenode(dns_db_t *db, dns_dbnode_t *node, isc_stdtime_t now) {
 		  isc_rwlocktype_write);
 
 	for (header = rbtnode->data; header != NULL; header = header->next) {
-		if (header->rdh_ttl + STALE_TTL(header, rbtdb) <=
-		    now - RBTDB_VIRTUAL) {
+		if (FLUSHED(header, generation)) {
+			set_ttl(rbtdb, header, 0);
+			mark_header_ancient(rbtdb, header);
+		} else if (header->rdh_ttl + STALE_TTL(header, rbtdb) <=
+			   now - RBTDB_VIRTUAL)
+		{
 			/*
 			 * We don't check if refcurrent(rbtnode) == 0 and try
 			 * to free like we do in cache_find(), because
@@ -5803,6 +6731,7 @@ cache_findrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	isc_result_t result;
 	nodelock_t *lock;
 	isc_rwlocktype_t locktype;
+	uint32_t generation;
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 	REQUIRE(type != dns_rdatatype_any);
@@ -5815,6 +6744,8 @@ cache_findrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		isc_stdtime_get(&now);
 	}
 
+	generation = node_flushgen(rbtdb, rbtnode, false, now);
+
 	lock = &rbtdb->node_locks[rbtnode->locknum].lock;
 	locktype = isc_rwlocktype_read;
 	NODE_LOCK(lock, locktype);
@@ -5831,7 +6762,9 @@ cache_findrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 
 	for (header = rbtnode->data; header != NULL; header = header_next) {
 		header_next = header->next;
-		if (!ACTIVE(header, now)) {
+		if (FLUSHED(header, generation)) {
+			flush_header(rbtdb, header, &locktype, lock);
+		} else if (!ACTIVE(header, now)) {
 			if ((header->rdh_ttl + STALE_TTL(header, rbtdb) <
 			     now - RBTDB_VIRTUAL) &&
 			    (locktype == isc_rwlocktype_write ||
@@ -5904,6 +6837,7 @@ allrdatasets(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	REQUIRE(VALID_RBTDB(rbtdb));
 
 	iterator = isc_mem_get(rbtdb->common.mctx, sizeof(*iterator));
+	iterator->flushgen = 0;
 
 	if ((db->attributes & DNS_DBATTR_CACHE) == 0) {
 		now = 0;
@@ -5920,6 +6854,7 @@ allrdatasets(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 			isc_stdtime_get(&now);
 		}
 		rbtversion = NULL;
+		iterator->flushgen = node_flushgen(rbtdb, rbtnode, false, now);
 	}
 
 	iterator->common.magic = DNS_RDATASETITER_MAGIC;
@@ -6106,6 +7041,12 @@ add32(dns_rbtdb_t *rbtdb, dns_rbtnode_t *rbtnode, const dns_name_t *nodename,
 	 * Caller must be holding the node lock.
 	 */
 
+	if (IS_CACHE(rbtdb) && newheader->type == dns_rdatatype_ns &&
+	    !rbtnode->zonecut)
+	{
+		index_zonecut(rbtdb, rbtnode, nodename);
+	}
+
 	if ((options & DNS_DBADD_MERGE) != 0) {
 		REQUIRE(rbtversion != NULL);
 		merge = true;
@@ -6329,6 +7270,7 @@ find_header:
 				free_rdataset(rbtdb, rbtdb->common.mctx,
 					      newheader);
 				newheader = (rdatasetheader_t *)merged;
+				slab_allocated(rbtdb, newheader);
 				init_rdataset(rbtdb, newheader);
 				update_newheader(newheader, header);
 				if (loading && RESIGN(newheader) &&
@@ -6450,8 +7392,7 @@ find_header:
 					ISC_LIST_PREPEND(rbtdb->rdatasets[idx],
 							 newheader, link);
 				}
-				INSIST(rbtdb->heaps != NULL);
-				isc_heap_insert(rbtdb->heaps[idx], newheader);
+				ttlwheel_insert(rbtdb, idx, newheader);
 			} else if (RESIGN(newheader)) {
 				resign_insert(rbtdb, idx, newheader);
 				/*
@@ -6482,8 +7423,7 @@ find_header:
 		} else {
 			idx = newheader->node->locknum;
 			if (IS_CACHE(rbtdb)) {
-				INSIST(rbtdb->heaps != NULL);
-				isc_heap_insert(rbtdb->heaps[idx], newheader);
+				ttlwheel_insert(rbtdb, idx, newheader);
 				if (ZEROTTL(newheader)) {
 					ISC_LIST_APPEND(rbtdb->rdatasets[idx],
 							newheader, link);
@@ -6537,7 +7477,7 @@ find_header:
 
 		idx = newheader->node->locknum;
 		if (IS_CACHE(rbtdb)) {
-			isc_heap_insert(rbtdb->heaps[idx], newheader);
+			ttlwheel_insert(rbtdb, idx, newheader);
 			if (ZEROTTL(newheader)) {
 				ISC_LIST_APPEND(rbtdb->rdatasets[idx],
 						newheader, link);
@@ -6724,7 +7664,6 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	rbtdb_version_t *rbtversion = version;
 	isc_region_t region;
 	rdatasetheader_t *newheader;
-	rdatasetheader_t *header;
 	isc_result_t result;
 	bool delegating;
 	bool newnsec;
@@ -6732,6 +7671,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	bool cache_is_overmem = false;
 	dns_fixedname_t fixed;
 	dns_name_t *name;
+	uint32_t generation = 0;
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 	INSIST(rbtversion == NULL || rbtversion->rbtdb == rbtdb);
@@ -6772,8 +7712,21 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	nodefullname(db, node, name);
 	dns_rdataset_getownercase(rdataset, name);
 
-	newheader = (rdatasetheader_t *)region.base;
-	init_rdataset(rbtdb, newheader);
+	/*
+	 * The slab of a negative entry is most likely the same as that
+	 * of other names of the same zone.
+	 */
+	if (IS_CACHE(rbtdb) &&
+	    (rdataset->attributes &
+	     (DNS_RDATASETATTR_NEGATIVE | DNS_RDATASETATTR_NOQNAME |
+	      DNS_RDATASETATTR_CLOSEST)) == DNS_RDATASETATTR_NEGATIVE)
+	{
+		newheader = share_proof(rbtdb, &region);
+	} else {
+		newheader = (rdatasetheader_t *)region.base;
+		slab_allocated(rbtdb, newheader);
+		init_rdataset(rbtdb, newheader);
+	}
 	setownercase(newheader, name);
 	set_ttl(rbtdb, newheader, rdataset->ttl + now);
 	newheader->type = RBTDB_RDATATYPE_VALUE(rdataset->type,
@@ -6806,7 +7759,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		}
 	} else {
 		newheader->serial = 1;
-		newheader->resign = 0;
+		newheader->resign = atomic_load(&rbtdb->flushgen);
 		newheader->resign_lsb = 0;
 		if ((rdataset->attributes & DNS_RDATASETATTR_PREFETCH) != 0) {
 			RDATASET_ATTR_SET(newheader, RDATASET_ATTR_PREFETCH);
@@ -6838,6 +7791,10 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		}
 	}
 
+	if (IS_CACHE(rbtdb)) {
+		generation = flushgen(rbtdb, name, now);
+	}
+
 	/*
 	 * If we're adding a delegation type (e.g. NS or DNAME for a zone,
 	 * just DNAME for the cache), then we need to set the callback bit
@@ -6896,12 +7853,25 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 			cleanup_dead_nodes(rbtdb, rbtnode->locknum);
 		}
 
-		header = isc_heap_element(rbtdb->heaps[rbtnode->locknum], 1);
-		if (header != NULL &&
-		    header->rdh_ttl + STALE_TTL(header, rbtdb) <
-			    now - RBTDB_VIRTUAL)
-		{
-			expire_header(rbtdb, header, tree_locked, expire_ttl);
+		(void)ttlwheel_expire(rbtdb, rbtnode->locknum, now,
+				      tree_locked, DNS_RBTDB_EXPIRE_SLICE);
+
+		/*
+		 * Expire what has been flushed at this node, so that it
+		 * is replaced rather than merged with or kept over the
+		 * new data.
+		 */
+		if (generation != 0) {
+			isc_rwlocktype_t locktype = isc_rwlocktype_write;
+
+			for (rdatasetheader_t *header = rbtnode->data;
+			     header != NULL; header = header->next)
+			{
+				if (FLUSHED(header, generation)) {
+					flush_header(rbtdb, header, &locktype,
+						     NULL);
+				}
+			}
 		}
 
 		/*
@@ -6993,6 +7963,7 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		return (result);
 	}
 	newheader = (rdatasetheader_t *)region.base;
+	slab_allocated(rbtdb, newheader);
 	init_rdataset(rbtdb, newheader);
 	set_ttl(rbtdb, newheader, rdataset->ttl);
 	newheader->type = RBTDB_RDATATYPE_VALUE(rdataset->type,
@@ -7067,6 +8038,7 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		if (result == ISC_R_SUCCESS) {
 			free_rdataset(rbtdb, rbtdb->common.mctx, newheader);
 			newheader = (rdatasetheader_t *)subresult;
+			slab_allocated(rbtdb, newheader);
 			init_rdataset(rbtdb, newheader);
 			update_newheader(newheader, header);
 			if (RESIGN(header)) {
@@ -7329,13 +8301,30 @@ loading_addrdataset(void *arg, const dns_name_t *name,
 		    dns_rdataset_t *rdataset) {
 	rbtdb_load_t *loadctx = arg;
 	dns_rbtdb_t *rbtdb = loadctx->rbtdb;
-	dns_rbtnode_t *node;
+	dns_rbtnode_t *node = NULL;
 	isc_result_t result;
 	isc_region_t region;
 	rdatasetheader_t *newheader;
+	bool nsec3;
 
 	REQUIRE(rdataset->rdclass == rbtdb->common.rdclass);
 
+	nsec3 = rdataset->type == dns_rdatatype_nsec3 ||
+		rdataset->covers == dns_rdatatype_nsec3;
+
+	/*
+	 * Reuse the node of the previous RRset if it has the same owner,
+	 * unless this is the first NSEC and the node must be added to
+	 * the auxiliary NSEC tree.
+	 */
+	if (loadctx->lastnode != NULL && loadctx->lastnsec3 == nsec3 &&
+	    (rdataset->type != dns_rdatatype_nsec ||
+	     loadctx->lastnode->nsec == DNS_RBT_NSEC_HAS_NSEC) &&
+	    dns_name_equal(name, dns_fixedname_name(&loadctx->lastname)))
+	{
+		node = loadctx->lastnode;
+	}
+
 	/*
 	 * SOA records are only allowed at top of zone.
 	 */
@@ -7345,9 +8334,7 @@ loading_addrdataset(void *arg, const dns_name_t *name,
 		return (DNS_R_NOTZONETOP);
 	}
 
-	if (rdataset->type != dns_rdatatype_nsec3 &&
-	    rdataset->covers != dns_rdatatype_nsec3)
-	{
+	if (node == NULL && !nsec3) {
 		add_empty_wildcards(rbtdb, name);
 	}
 
@@ -7364,30 +8351,36 @@ loading_addrdataset(void *arg, const dns_name_t *name,
 		if (rdataset->type == dns_rdatatype_nsec3) {
 			return (DNS_R_INVALIDNSEC3);
 		}
-		result = add_wildcard_magic(rbtdb, name);
-		if (result != ISC_R_SUCCESS) {
-			return (result);
+		if (node == NULL) {
+			result = add_wildcard_magic(rbtdb, name);
+			if (result != ISC_R_SUCCESS) {
+				return (result);
+			}
 		}
 	}
 
-	node = NULL;
-	if (rdataset->type == dns_rdatatype_nsec3 ||
-	    rdataset->covers == dns_rdatatype_nsec3)
-	{
-		result = dns_rbt_addnode(rbtdb->nsec3, name, &node);
+	if (node == NULL) {
+		if (nsec3) {
+			result = dns_rbt_addnode(rbtdb->nsec3, name, &node);
+			if (result == ISC_R_SUCCESS) {
+				node->nsec = DNS_RBT_NSEC_NSEC3;
+			}
+		} else if (rdataset->type == dns_rdatatype_nsec) {
+			result = loadnode(rbtdb, name, &node, true);
+		} else {
+			result = loadnode(rbtdb, name, &node, false);
+		}
+		if (result != ISC_R_SUCCESS && result != ISC_R_EXISTS) {
+			return (result);
+		}
 		if (result == ISC_R_SUCCESS) {
-			node->nsec = DNS_RBT_NSEC_NSEC3;
+			node->locknum = node->hashval %
+					rbtdb->node_lock_count;
 		}
-	} else if (rdataset->type == dns_rdatatype_nsec) {
-		result = loadnode(rbtdb, name, &node, true);
-	} else {
-		result = loadnode(rbtdb, name, &node, false);
-	}
-	if (result != ISC_R_SUCCESS && result != ISC_R_EXISTS) {
-		return (result);
-	}
-	if (result == ISC_R_SUCCESS) {
-		node->locknum = node->hashval % rbtdb->node_lock_count;
+
+		loadctx->lastnode = node;
+		loadctx->lastnsec3 = nsec3;
+		dns_name_copy(name, dns_fixedname_name(&loadctx->lastname));
 	}
 
 	result = dns_rdataslab_fromrdataset(rdataset, rbtdb->common.mctx,
@@ -7396,6 +8389,7 @@ loading_addrdataset(void *arg, const dns_name_t *name,
 		return (result);
 	}
 	newheader = (rdatasetheader_t *)region.base;
+	slab_allocated(rbtdb, newheader);
 	init_rdataset(rbtdb, newheader);
 	set_ttl(rbtdb, newheader, rdataset->ttl + loadctx->now); /* XXX overflow
 								  * check */
@@ -7451,6 +8445,9 @@ beginload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
 	loadctx = isc_mem_get(rbtdb->common.mctx, sizeof(*loadctx));
 
 	loadctx->rbtdb = rbtdb;
+	loadctx->lastnode = NULL;
+	loadctx->lastnsec3 = false;
+	dns_fixedname_init(&loadctx->lastname);
 	if (IS_CACHE(rbtdb)) {
 		isc_stdtime_get(&loadctx->now);
 	} else {
@@ -7498,6 +8495,9 @@ endload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
 		dns_dbversion_t *version = rbtdb->current_version;
 		RBTDB_UNLOCK(&rbtdb->lock, isc_rwlocktype_write);
 		iszonesecure(db, version, rbtdb->origin_node);
+		if (!IS_STUB(rbtdb)) {
+			glue_load(rbtdb);
+		}
 	} else {
 		RBTDB_UNLOCK(&rbtdb->lock, isc_rwlocktype_write);
 	}
@@ -7739,6 +8739,24 @@ getsize(dns_db_t *db, dns_dbversion_t *version, uint64_t *records,
 	return (result);
 }
 
+static isc_result_t
+getmemory(dns_db_t *db, dns_dbmemory_t *memory) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+
+	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	memory->nodes = dns_rbt_inuse(rbtdb->tree) +
+			dns_rbt_inuse(rbtdb->nsec) +
+			dns_rbt_inuse(rbtdb->nsec3);
+	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+
+	memory->rdata = atomic_load_relaxed(&rbtdb->rdatamem);
+	memory->glue = atomic_load_relaxed(&rbtdb->gluemem);
+
+	return (ISC_R_SUCCESS);
+}
+
 static isc_result_t
 setsigningtime(dns_db_t *db, dns_rdataset_t *rdataset, isc_stdtime_t resign) {
 	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
@@ -7999,56 +9017,196 @@ getservestalerefresh(dns_db_t *db, uint32_t *interval) {
 	return (ISC_R_SUCCESS);
 }
 
-static dns_dbmethods_t zone_methods = { attach,
-					detach,
-					beginload,
-					endload,
-					dump,
-					currentversion,
-					newversion,
-					attachversion,
-					closeversion,
-					findnode,
-					zone_find,
-					zone_findzonecut,
-					attachnode,
-					detachnode,
-					expirenode,
-					printnode,
-					createiterator,
-					zone_findrdataset,
-					allrdatasets,
-					addrdataset,
-					subtractrdataset,
-					deleterdataset,
-					issecure,
-					nodecount,
-					ispersistent,
-					overmem,
-					settask,
-					getoriginnode,
-					NULL, /* transfernode */
-					getnsec3parameters,
-					findnsec3node,
-					setsigningtime,
-					getsigningtime,
-					resigned,
-					isdnssec,
-					NULL, /* getrrsetstats */
-					NULL, /* rpz_attach */
-					NULL, /* rpz_ready */
-					NULL, /* findnodeext */
-					NULL, /* findext */
-					NULL, /* setcachestats */
-					hashsize,
-					nodefullname,
-					getsize,
-					NULL, /* setservestalettl */
-					NULL, /* getservestalettl */
-					NULL, /* setservestalerefresh */
-					NULL, /* getservestalerefresh */
-					setgluecachestats };
-
+static isc_result_t
+setevictionpolicy(dns_db_t *db, dns_evictionpolicy_t policy) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(IS_CACHE(rbtdb));
+
+	switch (policy) {
+	case dns_evictionpolicy_lru:
+	case dns_evictionpolicy_sieve:
+		break;
+	default:
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	/*
+	 * Both policies keep every entry on the rdatasets lists and
+	 * cope with any order they find there, so this can be changed
+	 * while the cache is in use.
+	 */
+	rbtdb->evictionpolicy = policy;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Forget the flushes that no RRset added before them can have outlived.
+ */
+static void
+prune_flushes(dns_rbtdb_t *rbtdb, isc_stdtime_t now) {
+	rbtdb_flush_t *flush = NULL, *next = NULL;
+
+	if (atomic_load_acquire(&rbtdb->nflushes) == 0) {
+		return;
+	}
+
+	RWLOCK(&rbtdb->flushlock, isc_rwlocktype_write);
+	for (flush = ISC_LIST_HEAD(rbtdb->flushes); flush != NULL;
+	     flush = next)
+	{
+		next = ISC_LIST_NEXT(flush, link);
+		if (flush->expire <= now) {
+			ISC_LIST_UNLINK(rbtdb->flushes, flush, link);
+			atomic_fetch_sub_release(&rbtdb->nflushes, 1);
+			isc_mem_put(rbtdb->common.mctx, flush, sizeof(*flush));
+		}
+	}
+	RWUNLOCK(&rbtdb->flushlock, isc_rwlocktype_write);
+}
+
+static isc_result_t
+flushtree(dns_db_t *db, const dns_name_t *name) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+	rbtdb_flush_t *flush = NULL;
+	isc_stdtime_t now;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(IS_CACHE(rbtdb));
+
+	isc_stdtime_get(&now);
+	prune_flushes(rbtdb, now);
+
+	RWLOCK(&rbtdb->flushlock, isc_rwlocktype_write);
+	if (atomic_load_relaxed(&rbtdb->nflushes) >= RBTDB_MAXFLUSHES) {
+		RWUNLOCK(&rbtdb->flushlock, isc_rwlocktype_write);
+		return (ISC_R_QUOTA);
+	}
+
+	flush = isc_mem_get(rbtdb->common.mctx, sizeof(*flush));
+	*flush = (rbtdb_flush_t){
+		.generation = atomic_fetch_add(&rbtdb->flushgen, 1) + 1,
+	};
+	ISC_LINK_INIT(flush, link);
+
+	/*
+	 * An RRset added before the flush can't be served, even stale,
+	 * after the latest expiry time given so far.
+	 */
+	flush->expire = atomic_load(&rbtdb->maxexpiry) +
+			rbtdb->serve_stale_ttl + 1;
+	flush->name = dns_fixedname_initname(&flush->fixed);
+	dns_name_copy(name, flush->name);
+
+	ISC_LIST_APPEND(rbtdb->flushes, flush, link);
+	atomic_fetch_add_release(&rbtdb->nflushes, 1);
+	RWUNLOCK(&rbtdb->flushlock, isc_rwlocktype_write);
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+nsec3hashname(dns_db_t *db, dns_fixedname_t *result, const dns_name_t *name,
+	      dns_hash_t hashalg, unsigned int iterations,
+	      const unsigned char *salt, size_t saltlength) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+	dns_nsec3cache_t *cache = NULL;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(!IS_CACHE(rbtdb));
+
+	/*
+	 * Only the zones that are asked for names that don't exist pay
+	 * for a cache.
+	 */
+	RBTDB_LOCK(&rbtdb->lock, isc_rwlocktype_read);
+	cache = rbtdb->nsec3cache;
+	RBTDB_UNLOCK(&rbtdb->lock, isc_rwlocktype_read);
+	if (cache == NULL) {
+		RBTDB_LOCK(&rbtdb->lock, isc_rwlocktype_write);
+		if (rbtdb->nsec3cache == NULL) {
+			dns_nsec3cache_create(rbtdb->common.mctx,
+					      DNS_NSEC3CACHE_SIZE,
+					      &rbtdb->nsec3cache);
+		}
+		cache = rbtdb->nsec3cache;
+		RBTDB_UNLOCK(&rbtdb->lock, isc_rwlocktype_write);
+	}
+
+	return (dns_nsec3cache_hashname(cache, result, NULL, NULL, name,
+					&rbtdb->common.origin, hashalg,
+					iterations, salt, saltlength));
+}
+
+static isc_result_t
+setcoldtier(dns_db_t *db, dns_coldcache_t *coldtier) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(IS_CACHE(rbtdb));
+	REQUIRE(rbtdb->coldtier == NULL);
+
+	dns_coldcache_attach(coldtier, &rbtdb->coldtier);
+	return (ISC_R_SUCCESS);
+}
+
+static dns_dbmethods_t zone_methods = { attach,
+					detach,
+					beginload,
+					endload,
+					dump,
+					currentversion,
+					newversion,
+					attachversion,
+					closeversion,
+					findnode,
+					zone_find,
+					zone_findzonecut,
+					attachnode,
+					detachnode,
+					expirenode,
+					printnode,
+					createiterator,
+					zone_findrdataset,
+					allrdatasets,
+					addrdataset,
+					subtractrdataset,
+					deleterdataset,
+					issecure,
+					nodecount,
+					ispersistent,
+					overmem,
+					settask,
+					getoriginnode,
+					NULL, /* transfernode */
+					getnsec3parameters,
+					findnsec3node,
+					setsigningtime,
+					getsigningtime,
+					resigned,
+					isdnssec,
+					NULL, /* getrrsetstats */
+					NULL, /* rpz_attach */
+					NULL, /* rpz_ready */
+					NULL, /* findnodeext */
+					NULL, /* findext */
+					NULL, /* setcachestats */
+					hashsize,
+					nodefullname,
+					getsize,
+					NULL, /* setservestalettl */
+					NULL, /* getservestalettl */
+					NULL, /* setservestalerefresh */
+					NULL, /* getservestalerefresh */
+					setgluecachestats,
+					NULL, /* setevictionpolicy */
+					getmemory,
+					NULL, /* expire */
+					NULL, /* setcoldtier */
+					NULL, /* flushtree */
+					nsec3hashname };
+
 static dns_dbmethods_t cache_methods = { attach,
 					 detach,
 					 beginload,
@@ -8097,7 +9255,13 @@ static dns_dbmethods_t cache_methods = { attach,
 					 getservestalettl,
 					 setservestalerefresh,
 					 getservestalerefresh,
-					 NULL };
+					 NULL, /* setgluecachestats */
+					 setevictionpolicy,
+					 getmemory,
+					 cache_expire,
+					 setcoldtier,
+					 flushtree,
+					 NULL /* nsec3hashname */ };
 
 isc_result_t
 dns_rbtdb_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
@@ -8107,7 +9271,6 @@ dns_rbtdb_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
 	isc_result_t result;
 	int i;
 	dns_name_t name;
-	bool (*sooner)(void *, void *);
 	isc_mem_t *hmctx = mctx;
 
 	/* Keep the compiler happy. */
@@ -8123,6 +9286,9 @@ dns_rbtdb_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
 	}
 
 	memset(rbtdb, '\0', sizeof(*rbtdb));
+	atomic_init(&rbtdb->rdatamem, 0);
+	atomic_init(&rbtdb->gluemem, 0);
+	atomic_init(&rbtdb->cleanhand, 0);
 	dns_name_init(&rbtdb->common.origin, NULL);
 	rbtdb->common.attributes = 0;
 	if (type == dns_dbtype_cache) {
@@ -8175,24 +9341,56 @@ dns_rbtdb_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
 		rbtdb->rdatasets = isc_mem_get(
 			mctx,
 			rbtdb->node_lock_count * sizeof(rdatasetheaderlist_t));
+		rbtdb->lruhands = isc_mem_get(
+			mctx,
+			rbtdb->node_lock_count * sizeof(rdatasetheader_t *));
 		for (i = 0; i < (int)rbtdb->node_lock_count; i++) {
 			ISC_LIST_INIT(rbtdb->rdatasets[i]);
-		}
+			rbtdb->lruhands[i] = NULL;
+		}
+		isc_mutex_init(&rbtdb->prooflock);
+		rbtdb->proofbits = ISC_HASH_MIN_BITS;
+		rbtdb->proofs = isc_mem_get(
+			mctx, ISC_HASHSIZE(rbtdb->proofbits) *
+				      sizeof(rbtdb->proofs[0]));
+		memset(rbtdb->proofs, 0,
+		       ISC_HASHSIZE(rbtdb->proofbits) *
+			       sizeof(rbtdb->proofs[0]));
+		isc_rwlock_init(&rbtdb->cutlock, 0, 0);
+		isc_ht_init(&rbtdb->zonecuts, mctx, ISC_HASH_MIN_BITS,
+			    ISC_HT_CASE_SENSITIVE);
+		isc_rwlock_init(&rbtdb->flushlock, 0, 0);
+		ISC_LIST_INIT(rbtdb->flushes);
+		atomic_init(&rbtdb->nflushes, 0);
+		atomic_init(&rbtdb->flushgen, 0);
+		atomic_init(&rbtdb->maxexpiry, 0);
 	} else {
 		rbtdb->rdatasets = NULL;
+		rbtdb->lruhands = NULL;
 	}
 
 	/*
-	 * Create the heaps.
+	 * Create the TTL wheels or the heaps.
 	 */
-	rbtdb->heaps = isc_mem_get(hmctx, rbtdb->node_lock_count *
-						  sizeof(isc_heap_t *));
-	for (i = 0; i < (int)rbtdb->node_lock_count; i++) {
-		rbtdb->heaps[i] = NULL;
-	}
-	sooner = IS_CACHE(rbtdb) ? ttl_sooner : resign_sooner;
-	for (i = 0; i < (int)rbtdb->node_lock_count; i++) {
-		isc_heap_create(hmctx, sooner, set_index, 0, &rbtdb->heaps[i]);
+	if (IS_CACHE(rbtdb)) {
+		rbtdb->ttlwheels = isc_mem_get(
+			hmctx,
+			rbtdb->node_lock_count * sizeof(rbtdb_ttlwheel_t));
+		memset(rbtdb->ttlwheels, 0,
+		       rbtdb->node_lock_count * sizeof(rbtdb_ttlwheel_t));
+		for (i = 0; i < (int)rbtdb->node_lock_count; i++) {
+			for (int j = 0; j < TTLWHEEL_SLOTS; j++) {
+				ISC_LIST_INIT(rbtdb->ttlwheels[i].slots[j]);
+			}
+		}
+	} else {
+		rbtdb->heaps = isc_mem_get(hmctx, rbtdb->node_lock_count *
+							  sizeof(isc_heap_t *));
+		for (i = 0; i < (int)rbtdb->node_lock_count; i++) {
+			rbtdb->heaps[i] = NULL;
+			isc_heap_create(hmctx, resign_sooner, set_index, 0,
+					&rbtdb->heaps[i]);
+		}
 	}
 
 	/*
@@ -8312,6 +9510,22 @@ dns_rbtdb_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
 	rbtdb->attributes = 0;
 	rbtdb->task = NULL;
 	rbtdb->serve_stale_ttl = 0;
+	rbtdb->evictionpolicy = dns_evictionpolicy_lru;
+
+	if (!IS_CACHE(rbtdb)) {
+		size_t size;
+
+		isc_rwlock_init(&rbtdb->glue_rwlock, 0, 0);
+		rbtdb->glue_table_bits = ISC_HASH_MIN_BITS;
+		rbtdb->glue_table_nodecount = 0U;
+		size = ISC_HASHSIZE(rbtdb->glue_table_bits) *
+		       sizeof(rbtdb->glue_table[0]);
+		rbtdb->glue_table = glue_get(rbtdb, size);
+		memset(rbtdb->glue_table, 0, size);
+		ISC_LIST_INIT(rbtdb->glue_replaced);
+		isc_ht_init(&rbtdb->glue_targets, mctx, ISC_HASH_MIN_BITS,
+			    ISC_HT_CASE_INSENSITIVE);
+	}
 
 	/*
 	 * Version Initialization.
@@ -8592,13 +9806,27 @@ rdataset_getclosest(dns_rdataset_t *rdataset, dns_name_t *name,
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Return the header 'rdataset' is bound to.
+ */
+static rdatasetheader_t *
+rdataset_header(const dns_rdataset_t *rdataset) {
+	rdatasetheader_t *header = NULL;
+
+	if (rdataset->methods == &proof_methods) {
+		DE_CONST(rdataset->private7, header);
+		return (header);
+	}
+	header = rdataset->private3;
+	return (header - 1);
+}
+
 static void
 rdataset_settrust(dns_rdataset_t *rdataset, dns_trust_t trust) {
 	dns_rbtdb_t *rbtdb = rdataset->private1;
 	dns_rbtnode_t *rbtnode = rdataset->private2;
-	rdatasetheader_t *header = rdataset->private3;
+	rdatasetheader_t *header = rdataset_header(rdataset);
 
-	header--;
 	NODE_LOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
 		  isc_rwlocktype_write);
 	header->trust = rdataset->trust = trust;
@@ -8610,9 +9838,8 @@ static void
 rdataset_expire(dns_rdataset_t *rdataset) {
 	dns_rbtdb_t *rbtdb = rdataset->private1;
 	dns_rbtnode_t *rbtnode = rdataset->private2;
-	rdatasetheader_t *header = rdataset->private3;
+	rdatasetheader_t *header = rdataset_header(rdataset);
 
-	header--;
 	NODE_LOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
 		  isc_rwlocktype_write);
 	expire_header(rbtdb, header, false, expire_flush);
@@ -8624,9 +9851,8 @@ static void
 rdataset_clearprefetch(dns_rdataset_t *rdataset) {
 	dns_rbtdb_t *rbtdb = rdataset->private1;
 	dns_rbtnode_t *rbtnode = rdataset->private2;
-	rdatasetheader_t *header = rdataset->private3;
+	rdatasetheader_t *header = rdataset_header(rdataset);
 
-	header--;
 	NODE_LOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
 		  isc_rwlocktype_write);
 	RDATASET_ATTR_CLR(header, RDATASET_ATTR_PREFETCH);
@@ -8677,9 +9903,11 @@ rdatasetiter_first(dns_rdatasetiter_t *iterator) {
 			if (header->serial <= serial && !IGNORE(header)) {
 				/*
 				 * Is this a "this rdataset doesn't exist"
-				 * record?
+				 * record, or has it been flushed?
 				 */
-				if (NONEXISTENT(header)) {
+				if (NONEXISTENT(header) ||
+				    FLUSHED(header, rbtiterator->flushgen))
+				{
 					header = NULL;
 				}
 				break;
@@ -8746,9 +9974,13 @@ rdatasetiter_next(dns_rdatasetiter_t *iterator) {
 				{
 					/*
 					 * Is this a "this rdataset doesn't
-					 * exist" record?
+					 * exist" record, or has it been
+					 * flushed?
 					 */
-					if (NONEXISTENT(header)) {
+					if (NONEXISTENT(header) ||
+					    FLUSHED(header,
+						    rbtiterator->flushgen))
+					{
 						header = NULL;
 					}
 					break;
@@ -9163,22 +10395,15 @@ dbiterator_prev(dns_dbiterator_t *iterator) {
 	return (result);
 }
 
+/*
+ * Move the node chain of 'rbtdbiter' to the next node and return it in
+ * '*nodep', leaving the references held by the iterator unchanged.
+ */
 static isc_result_t
-dbiterator_next(dns_dbiterator_t *iterator) {
+next_iter_node(rbtdb_dbiterator_t *rbtdbiter, dns_rbtnode_t **nodep) {
 	isc_result_t result;
-	rbtdb_dbiterator_t *rbtdbiter = (rbtdb_dbiterator_t *)iterator;
 	dns_name_t *name, *origin;
-	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)iterator->db;
-
-	REQUIRE(rbtdbiter->node != NULL);
-
-	if (rbtdbiter->result != ISC_R_SUCCESS) {
-		return (rbtdbiter->result);
-	}
-
-	if (rbtdbiter->paused) {
-		resume_iteration(rbtdbiter);
-	}
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)rbtdbiter->common.db;
 
 	name = dns_fixedname_name(&rbtdbiter->name);
 	origin = dns_fixedname_name(&rbtdbiter->origin);
@@ -9195,14 +10420,37 @@ dbiterator_next(dns_dbiterator_t *iterator) {
 		}
 	}
 
-	dereference_iter_node(rbtdbiter);
-
 	if (result == DNS_R_NEWORIGIN || result == ISC_R_SUCCESS) {
 		rbtdbiter->new_origin = (result == DNS_R_NEWORIGIN);
 		result = dns_rbtnodechain_current(rbtdbiter->current, NULL,
-						  NULL, &rbtdbiter->node);
+						  NULL, nodep);
+	}
+
+	return (result);
+}
+
+static isc_result_t
+dbiterator_next(dns_dbiterator_t *iterator) {
+	isc_result_t result;
+	rbtdb_dbiterator_t *rbtdbiter = (rbtdb_dbiterator_t *)iterator;
+	dns_rbtnode_t *node = NULL;
+
+	REQUIRE(rbtdbiter->node != NULL);
+
+	if (rbtdbiter->result != ISC_R_SUCCESS) {
+		return (rbtdbiter->result);
+	}
+
+	if (rbtdbiter->paused) {
+		resume_iteration(rbtdbiter);
 	}
+
+	result = next_iter_node(rbtdbiter, &node);
+
+	dereference_iter_node(rbtdbiter);
+
 	if (result == ISC_R_SUCCESS) {
+		rbtdbiter->node = node;
 		reference_iter_node(rbtdbiter);
 	}
 
@@ -9316,6 +10564,71 @@ dbiterator_origin(dns_dbiterator_t *iterator, dns_name_t *name) {
 	return (ISC_R_SUCCESS);
 }
 
+static isc_result_t
+dbiterator_currentbatch(dns_dbiterator_t *iterator,
+			dns_dbiteratorbatch_t *batch) {
+	rbtdb_dbiterator_t *rbtdbiter = (rbtdb_dbiterator_t *)iterator;
+	dns_rbtnode_t *start = rbtdbiter->node;
+	dns_rbtnode_t *node = NULL;
+	isc_result_t result;
+
+	REQUIRE(rbtdbiter->result == ISC_R_SUCCESS);
+	REQUIRE(rbtdbiter->node != NULL);
+
+	if (rbtdbiter->paused) {
+		resume_iteration(rbtdbiter);
+	}
+
+	/*
+	 * The tree stays read-locked for the whole batch, and the nodes
+	 * returned hold their own references, so the cursor can be moved
+	 * along the chain without taking a reference to each node it
+	 * passes; only the node it ends up on needs one.
+	 */
+	batch->count = 0;
+	do {
+		unsigned int i = batch->count;
+		dns_name_t *name = dns_fixedname_initname(&batch->names[i]);
+
+		batch->nodes[i] = NULL;
+		batch->neworigin[i] = false;
+		result = dbiterator_current(iterator, &batch->nodes[i], name);
+		if (result != ISC_R_SUCCESS && result != DNS_R_NEWORIGIN) {
+			break;
+		}
+		batch->count++;
+		if (result == DNS_R_NEWORIGIN) {
+			dns_name_t *origin =
+				dns_fixedname_initname(&batch->origins[i]);
+
+			batch->neworigin[i] = true;
+			dns_name_copy(dns_fixedname_name(&rbtdbiter->origin),
+				      origin);
+		}
+		result = next_iter_node(rbtdbiter, &node);
+		if (result == ISC_R_SUCCESS) {
+			rbtdbiter->node = node;
+		}
+	} while (result == ISC_R_SUCCESS &&
+		 batch->count < DNS_DBITERATOR_BATCHSIZE);
+
+	if (result == ISC_R_SUCCESS) {
+		reference_iter_node(rbtdbiter);
+	}
+	node = rbtdbiter->node;
+	rbtdbiter->node = start;
+	dereference_iter_node(rbtdbiter);
+	if (result == ISC_R_SUCCESS) {
+		rbtdbiter->node = node;
+	}
+
+	rbtdbiter->result = result;
+
+	(void)dbiterator_pause(iterator);
+
+	return (result);
+}
+
 static void
 setownercase(rdatasetheader_t *header, const dns_name_t *name) {
 	unsigned int i;
@@ -9343,10 +10656,7 @@ static void
 rdataset_setownercase(dns_rdataset_t *rdataset, const dns_name_t *name) {
 	dns_rbtdb_t *rbtdb = rdataset->private1;
 	dns_rbtnode_t *rbtnode = rdataset->private2;
-	unsigned char *raw = rdataset->private3; /* RDATASLAB */
-	rdatasetheader_t *header;
-
-	header = (struct rdatasetheader *)(raw - sizeof(*header));
+	rdatasetheader_t *header = rdataset_header(rdataset);
 
 	NODE_LOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
 		  isc_rwlocktype_write);
@@ -9359,13 +10669,10 @@ static void
 rdataset_getownercase(const dns_rdataset_t *rdataset, dns_name_t *name) {
 	dns_rbtdb_t *rbtdb = rdataset->private1;
 	dns_rbtnode_t *rbtnode = rdataset->private2;
-	unsigned char *raw = rdataset->private3; /* RDATASLAB */
-	rdatasetheader_t *header = NULL;
+	rdatasetheader_t *header = rdataset_header(rdataset);
 	uint8_t mask = (1 << 7);
 	uint8_t bits = 0;
 
-	header = (struct rdatasetheader *)(raw - sizeof(*header));
-
 	NODE_LOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
 		  isc_rwlocktype_read);
 
@@ -9403,10 +10710,25 @@ struct rbtdb_glue {
 	dns_rdataset_t sigrdataset_aaaa;
 };
 
+/*
+ * The delegations whose NS rdatasets referred to an NS target inside
+ * the zone when their glue was computed, so that their glue can be
+ * recomputed when the target changes.  The table is only used by the
+ * loader and by the committer of a version.  The nodes are not
+ * referenced; a node is only used while it still has glue that has not
+ * been replaced, which means that it still has an NS rdataset.
+ */
+typedef struct rbtdb_glue_target {
+	unsigned int count;
+	unsigned int size;
+	dns_rbtnode_t **nodes;
+} rbtdb_glue_target_t;
+
 typedef struct {
 	rbtdb_glue_t *glue_list;
 	dns_rbtdb_t *rbtdb;
 	rbtdb_version_t *rbtversion;
+	dns_rbtnode_t *node;
 } rbtdb_glue_additionaldata_ctx_t;
 
 static void
@@ -9440,110 +10762,215 @@ free_gluelist(rbtdb_glue_t *glue_list, dns_rbtdb_t *rbtdb) {
 		dns_rdataset_invalidate(&cur->rdataset_aaaa);
 		dns_rdataset_invalidate(&cur->sigrdataset_aaaa);
 
-		isc_mem_put(rbtdb->common.mctx, cur, sizeof(*cur));
+		glue_put(rbtdb, cur, sizeof(*cur));
 		cur = cur_next;
 	}
 }
 
 static void
-free_gluetable(rbtdb_version_t *version) {
-	dns_rbtdb_t *rbtdb;
+free_gluetable(dns_rbtdb_t *rbtdb) {
 	size_t size, i;
 
-	RWLOCK(&version->glue_rwlock, isc_rwlocktype_write);
+	if (rbtdb->glue_table == NULL) {
+		return;
+	}
 
-	rbtdb = version->rbtdb;
+	RWLOCK(&rbtdb->glue_rwlock, isc_rwlocktype_write);
 
-	for (i = 0; i < ISC_HASHSIZE(version->glue_table_bits); i++) {
+	for (i = 0; i < ISC_HASHSIZE(rbtdb->glue_table_bits); i++) {
 		rbtdb_glue_table_node_t *cur, *cur_next;
 
-		cur = version->glue_table[i];
+		cur = rbtdb->glue_table[i];
 		while (cur != NULL) {
 			cur_next = cur->next;
-			/* isc_refcount_decrement(&cur->node->references); */
 			cur->node = NULL;
 			free_gluelist(cur->glue_list, rbtdb);
 			cur->glue_list = NULL;
-			isc_mem_put(rbtdb->common.mctx, cur, sizeof(*cur));
+			glue_put(rbtdb, cur, sizeof(*cur));
 			cur = cur_next;
 		}
-		version->glue_table[i] = NULL;
+		rbtdb->glue_table[i] = NULL;
 	}
 
-	size = ISC_HASHSIZE(version->glue_table_bits) *
-	       sizeof(*version->glue_table);
-	isc_mem_put(rbtdb->common.mctx, version->glue_table, size);
+	size = ISC_HASHSIZE(rbtdb->glue_table_bits) *
+	       sizeof(*rbtdb->glue_table);
+	glue_put(rbtdb, rbtdb->glue_table, size);
+	rbtdb->glue_table = NULL;
+	rbtdb->glue_table_nodecount = 0;
+	ISC_LIST_INIT(rbtdb->glue_replaced);
 
-	RWUNLOCK(&version->glue_rwlock, isc_rwlocktype_write);
+	RWUNLOCK(&rbtdb->glue_rwlock, isc_rwlocktype_write);
 }
 
-static uint32_t
-rehash_bits(rbtdb_version_t *version, size_t newcount) {
-	uint32_t oldbits = version->glue_table_bits;
-	uint32_t newbits = oldbits;
+static void
+free_gluetargets(dns_rbtdb_t *rbtdb) {
+	isc_result_t result;
+	isc_ht_iter_t *iter = NULL;
 
-	while (newcount >= ISC_HASHSIZE(newbits) &&
-	       newbits <= ISC_HASH_MAX_BITS) {
-		newbits += 1;
+	isc_ht_iter_create(rbtdb->glue_targets, &iter);
+	result = isc_ht_iter_first(iter);
+	while (result == ISC_R_SUCCESS) {
+		rbtdb_glue_target_t *target = NULL;
+
+		isc_ht_iter_current(iter, (void **)&target);
+		if (target->size > 0) {
+			glue_put(rbtdb, target->nodes,
+				 target->size * sizeof(target->nodes[0]));
+		}
+		glue_put(rbtdb, target, sizeof(*target));
+		result = isc_ht_iter_delcurrent_next(iter);
+	}
+	isc_ht_iter_destroy(&iter);
+	isc_ht_destroy(&rbtdb->glue_targets);
+}
+
+static uint32_t
+rehash_bits(dns_rbtdb_t *rbtdb, size_t newcount) {
+	uint32_t oldbits = rbtdb->glue_table_bits;
+	uint32_t newbits = oldbits;
+
+	while (newcount >= ISC_HASHSIZE(newbits) &&
+	       newbits <= ISC_HASH_MAX_BITS) {
+		newbits += 1;
 	}
 
 	return (newbits);
 }
 
+static uint32_t
+glue_hash(dns_rbtnode_t *node) {
+	return (isc_hash32(&node, sizeof(node), true));
+}
+
 /*%
- * Write lock (version->glue_rwlock) must be held.
+ * Write lock (rbtdb->glue_rwlock) must be held.
  */
 static void
-rehash_gluetable(rbtdb_version_t *version) {
+rehash_gluetable(dns_rbtdb_t *rbtdb) {
 	uint32_t oldbits, newbits;
 	size_t newsize, oldcount, i;
 	rbtdb_glue_table_node_t **oldtable;
 
-	oldbits = version->glue_table_bits;
+	oldbits = rbtdb->glue_table_bits;
 	oldcount = ISC_HASHSIZE(oldbits);
-	oldtable = version->glue_table;
+	oldtable = rbtdb->glue_table;
 
-	newbits = rehash_bits(version, version->glue_table_nodecount);
-	newsize = ISC_HASHSIZE(newbits) * sizeof(version->glue_table[0]);
+	newbits = rehash_bits(rbtdb, rbtdb->glue_table_nodecount);
+	newsize = ISC_HASHSIZE(newbits) * sizeof(rbtdb->glue_table[0]);
 
-	version->glue_table = isc_mem_get(version->rbtdb->common.mctx, newsize);
-	version->glue_table_bits = newbits;
-	memset(version->glue_table, 0, newsize);
+	rbtdb->glue_table = glue_get(rbtdb, newsize);
+	rbtdb->glue_table_bits = newbits;
+	memset(rbtdb->glue_table, 0, newsize);
 
 	for (i = 0; i < oldcount; i++) {
 		rbtdb_glue_table_node_t *gluenode;
 		rbtdb_glue_table_node_t *nextgluenode;
 		for (gluenode = oldtable[i]; gluenode != NULL;
 		     gluenode = nextgluenode) {
-			uint32_t hash = isc_hash32(
-				&gluenode->node, sizeof(gluenode->node), true);
+			uint32_t hash = glue_hash(gluenode->node);
 			uint32_t idx = isc_hash_bits32(hash, newbits);
 			nextgluenode = gluenode->next;
-			gluenode->next = version->glue_table[idx];
-			version->glue_table[idx] = gluenode;
+			gluenode->next = rbtdb->glue_table[idx];
+			rbtdb->glue_table[idx] = gluenode;
 		}
 	}
 
-	isc_mem_put(version->rbtdb->common.mctx, oldtable,
-		    oldcount * sizeof(*version->glue_table));
+	glue_put(rbtdb, oldtable, oldcount * sizeof(*rbtdb->glue_table));
 
 	isc_log_write(dns_lctx, DNS_LOGCATEGORY_DATABASE, DNS_LOGMODULE_ZONE,
 		      ISC_LOG_DEBUG(3),
 		      "rehash_gluetable(): "
 		      "resized glue table from %zu to "
 		      "%zu",
-		      oldcount, newsize / sizeof(version->glue_table[0]));
+		      oldcount, newsize / sizeof(rbtdb->glue_table[0]));
 }
 
 static void
-maybe_rehash_gluetable(rbtdb_version_t *version) {
-	size_t overcommit = ISC_HASHSIZE(version->glue_table_bits) *
+maybe_rehash_gluetable(dns_rbtdb_t *rbtdb) {
+	size_t overcommit = ISC_HASHSIZE(rbtdb->glue_table_bits) *
 			    ISC_HASH_OVERCOMMIT;
-	if (version->glue_table_nodecount < overcommit) {
+	if (rbtdb->glue_table_nodecount < overcommit) {
 		return;
 	}
 
-	rehash_gluetable(version);
+	rehash_gluetable(rbtdb);
+}
+
+/*%
+ * Find the glue for 'node' that applies to the version with serial
+ * number 'serial' or, if 'serial' is 0, the glue that has not been
+ * replaced yet.
+ *
+ * Read or write lock (rbtdb->glue_rwlock) must be held.
+ */
+static rbtdb_glue_table_node_t *
+glue_find(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node, rbtdb_serial_t serial) {
+	rbtdb_glue_table_node_t *cur = NULL;
+	uint32_t idx = isc_hash_bits32(glue_hash(node), rbtdb->glue_table_bits);
+
+	for (cur = rbtdb->glue_table[idx]; cur != NULL; cur = cur->next) {
+		if (cur->node != node) {
+			continue;
+		}
+		if (serial == 0) {
+			if (cur->until == 0) {
+				return (cur);
+			}
+		} else if (cur->serial <= serial &&
+			   (cur->until == 0 || serial < cur->until))
+		{
+			return (cur);
+		}
+	}
+
+	return (NULL);
+}
+
+/*%
+ * Remember that the delegation at 'node' refers to the NS target 'name'.
+ */
+static void
+glue_addtarget(dns_rbtdb_t *rbtdb, const dns_name_t *name,
+	       dns_rbtnode_t *node) {
+	isc_result_t result;
+	rbtdb_glue_target_t *target = NULL;
+	dns_rbtnode_t **nodes = NULL;
+	unsigned int size;
+
+	if (!dns_name_issubdomain(name, &rbtdb->common.origin)) {
+		return;
+	}
+
+	result = isc_ht_find(rbtdb->glue_targets, name->ndata, name->length,
+			     (void **)&target);
+	if (result != ISC_R_SUCCESS) {
+		target = glue_get(rbtdb, sizeof(*target));
+		*target = (rbtdb_glue_target_t){ .count = 0 };
+		result = isc_ht_add(rbtdb->glue_targets, name->ndata,
+				    name->length, target);
+		INSIST(result == ISC_R_SUCCESS);
+	}
+
+	for (unsigned int i = 0; i < target->count; i++) {
+		if (target->nodes[i] == node) {
+			return;
+		}
+	}
+
+	if (target->count == target->size) {
+		size = (target->size == 0) ? 2 : target->size * 2;
+		nodes = glue_get(rbtdb, size * sizeof(nodes[0]));
+		if (target->size > 0) {
+			memmove(nodes, target->nodes,
+				target->count * sizeof(nodes[0]));
+			glue_put(rbtdb, target->nodes,
+				 target->size * sizeof(nodes[0]));
+		}
+		target->nodes = nodes;
+		target->size = size;
+	}
+
+	target->nodes[target->count++] = node;
 }
 
 static isc_result_t
@@ -9571,6 +10998,10 @@ glue_nsdname_cb(void *arg, const dns_name_t *name, dns_rdatatype_t qtype,
 
 	ctx = (rbtdb_glue_additionaldata_ctx_t *)arg;
 
+	if (ctx->node != NULL) {
+		glue_addtarget(ctx->rbtdb, name, ctx->node);
+	}
+
 	name_a = dns_fixedname_initname(&fixedname_a);
 	dns_rdataset_init(&rdataset_a);
 	dns_rdataset_init(&sigrdataset_a);
@@ -9584,7 +11015,7 @@ glue_nsdname_cb(void *arg, const dns_name_t *name, dns_rdatatype_t qtype,
 			   (dns_dbnode_t **)&node_a, name_a, &rdataset_a,
 			   &sigrdataset_a);
 	if (result == DNS_R_GLUE) {
-		glue = isc_mem_get(ctx->rbtdb->common.mctx, sizeof(*glue));
+		glue = glue_get(ctx->rbtdb, sizeof(*glue));
 
 		gluename = dns_fixedname_initname(&glue->fixedname);
 		dns_name_copy(name_a, gluename);
@@ -9607,8 +11038,7 @@ glue_nsdname_cb(void *arg, const dns_name_t *name, dns_rdatatype_t qtype,
 			   &rdataset_aaaa, &sigrdataset_aaaa);
 	if (result == DNS_R_GLUE) {
 		if (glue == NULL) {
-			glue = isc_mem_get(ctx->rbtdb->common.mctx,
-					   sizeof(*glue));
+			glue = glue_get(ctx->rbtdb, sizeof(*glue));
 
 			gluename = dns_fixedname_initname(&glue->fixedname);
 			dns_name_copy(name_aaaa, gluename);
@@ -9660,82 +11090,317 @@ glue_nsdname_cb(void *arg, const dns_name_t *name, dns_rdatatype_t qtype,
 	return (result);
 }
 
-static isc_result_t
-rdataset_addglue(dns_rdataset_t *rdataset, dns_dbversion_t *version,
-		 dns_message_t *msg) {
-	dns_rbtdb_t *rbtdb = rdataset->private1;
-	dns_rbtnode_t *node = rdataset->private2;
-	rbtdb_version_t *rbtversion = version;
+/*%
+ * Compute the glue for the NS rdataset at 'node' in 'version', and make
+ * it the glue for 'node' from 'version' on.  The glue computed for an
+ * earlier version, if any, is kept for the versions that are still open
+ * until free_replaced_glue() frees it.
+ */
+static void
+glue_update(dns_rbtdb_t *rbtdb, rbtdb_version_t *version,
+	    dns_rbtnode_t *node) {
+	isc_result_t result;
+	rbtdb_glue_additionaldata_ctx_t ctx = {
+		.rbtdb = rbtdb,
+		.rbtversion = version,
+		.node = node,
+	};
+	rbtdb_glue_table_node_t *cur = NULL, *new = NULL;
+	dns_rdataset_t rdataset;
+	isc_statscounter_t counter;
 	uint32_t idx;
-	rbtdb_glue_table_node_t *cur;
-	bool found = false;
-	bool restarted = false;
-	rbtdb_glue_t *ge;
-	rbtdb_glue_additionaldata_ctx_t ctx;
-	uint64_t hash;
 
-	REQUIRE(rdataset->type == dns_rdatatype_ns);
-	REQUIRE(rbtdb == rbtversion->rbtdb);
-	REQUIRE(!IS_CACHE(rbtdb) && !IS_STUB(rbtdb));
+	dns_rdataset_init(&rdataset);
+	result = zone_findrdataset((dns_db_t *)rbtdb, node, version,
+				   dns_rdatatype_ns, 0, 0, &rdataset, NULL);
+	if (result == ISC_R_SUCCESS) {
+		(void)dns_rdataset_additionaldata(&rdataset, dns_rootname,
+						  glue_nsdname_cb, &ctx);
+		dns_rdataset_disassociate(&rdataset);
+
+		new = glue_get(rbtdb, sizeof(*new));
+		*new = (rbtdb_glue_table_node_t){
+			.node = node,
+			.serial = version->serial,
+			.glue_list = ctx.glue_list,
+		};
+		ISC_LINK_INIT(new, link);
+
+		if (ctx.glue_list == NULL) {
+			/*
+			 * No glue was found. Cache it so.
+			 */
+			new->glue_list = (void *)-1;
+			counter = dns_gluecachestatscounter_inserts_absent;
+		} else {
+			counter = dns_gluecachestatscounter_inserts_present;
+		}
+		if (rbtdb->gluecachestats != NULL) {
+			isc_stats_increment(rbtdb->gluecachestats, counter);
+		}
+	}
 
-	/*
-	 * The glue table cache that forms a part of the DB version
-	 * structure is not explicitly bounded and there's no cache
-	 * cleaning. The zone data size itself is an implicit bound.
-	 *
-	 * The key into the glue hashtable is the node pointer. This is
-	 * because the glue hashtable is a property of the DB version,
-	 * and the glue is keyed for the ownername/NS tuple. We don't
-	 * bother with using an expensive dns_name_t comparison here as
-	 * the node pointer is a fixed value that won't change for a DB
-	 * version and can be compared directly.
-	 */
-	hash = isc_hash_function(&node, sizeof(node), true);
+	RWLOCK(&rbtdb->glue_rwlock, isc_rwlocktype_write);
 
-restart:
-	/*
-	 * First, check if we have the additional entries already cached
-	 * in the glue table.
-	 */
-	RWLOCK(&rbtversion->glue_rwlock, isc_rwlocktype_read);
+	cur = glue_find(rbtdb, node, 0);
+	if (cur != NULL) {
+		cur->until = version->serial;
+		ISC_LIST_APPEND(rbtdb->glue_replaced, cur, link);
+	}
+
+	if (new != NULL) {
+		rbtdb->glue_table_nodecount++;
+		maybe_rehash_gluetable(rbtdb);
+		idx = isc_hash_bits32(glue_hash(node), rbtdb->glue_table_bits);
+		new->next = rbtdb->glue_table[idx];
+		rbtdb->glue_table[idx] = new;
+	}
+
+	RWUNLOCK(&rbtdb->glue_rwlock, isc_rwlocktype_write);
+}
+
+/*%
+ * Add the delegations that refer to the NS target 'name' to 'affected',
+ * and forget those that no longer have glue that has not been replaced.
+ */
+static void
+glue_affecttarget(dns_rbtdb_t *rbtdb, const dns_name_t *name,
+		  isc_ht_t *affected) {
+	isc_result_t result;
+	rbtdb_glue_target_t *target = NULL;
+	unsigned int count = 0;
+
+	result = isc_ht_find(rbtdb->glue_targets, name->ndata, name->length,
+			     (void **)&target);
+	if (result != ISC_R_SUCCESS) {
+		return;
+	}
+
+	RWLOCK(&rbtdb->glue_rwlock, isc_rwlocktype_read);
+	for (unsigned int i = 0; i < target->count; i++) {
+		dns_rbtnode_t *node = target->nodes[i];
 
-	idx = isc_hash_bits32(hash, rbtversion->glue_table_bits);
+		if (glue_find(rbtdb, node, 0) == NULL) {
+			continue;
+		}
+		target->nodes[count++] = node;
+		(void)isc_ht_add(affected, (unsigned char *)&node,
+				 sizeof(node), node);
+	}
+	RWUNLOCK(&rbtdb->glue_rwlock, isc_rwlocktype_read);
 
-	for (cur = rbtversion->glue_table[idx]; cur != NULL; cur = cur->next) {
-		if (cur->node == node) {
+	target->count = count;
+	if (count == 0) {
+		result = isc_ht_delete(rbtdb->glue_targets, name->ndata,
+				       name->length);
+		INSIST(result == ISC_R_SUCCESS);
+		glue_put(rbtdb, target->nodes,
+			 target->size * sizeof(target->nodes[0]));
+		glue_put(rbtdb, target, sizeof(*target));
+	}
+}
+
+/*%
+ * Add the delegations that refer to an NS target at or below 'top' to
+ * 'affected'.
+ */
+static void
+glue_affectsubtree(dns_rbtdb_t *rbtdb, const dns_name_t *top,
+		   isc_ht_t *affected) {
+	isc_result_t result;
+	dns_dbiterator_t *dbit = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+
+	result = createiterator((dns_db_t *)rbtdb, DNS_DB_NONSEC3, &dbit);
+	if (result != ISC_R_SUCCESS) {
+		return;
+	}
+
+	for (result = dbiterator_seek(dbit, top); result == ISC_R_SUCCESS;
+	     result = dbiterator_next(dbit))
+	{
+		dns_dbnode_t *node = NULL;
+
+		result = dbiterator_current(dbit, &node, name);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+		(void)dbiterator_pause(dbit);
+		detachnode((dns_db_t *)rbtdb, &node);
+		if (!dns_name_issubdomain(name, top)) {
 			break;
 		}
+		glue_affecttarget(rbtdb, name, affected);
 	}
 
-	if (cur == NULL) {
-		goto no_glue;
+	dbiterator_destroy(&dbit);
+}
+
+/*%
+ * Return true if 'node' has an NS rdataset in 'version', or glue for an
+ * NS rdataset that has not been replaced yet.
+ */
+static bool
+glue_isdelegation(dns_rbtdb_t *rbtdb, rbtdb_version_t *version,
+		  dns_rbtnode_t *node) {
+	isc_result_t result;
+	dns_rdataset_t rdataset;
+	bool found;
+
+	RWLOCK(&rbtdb->glue_rwlock, isc_rwlocktype_read);
+	found = (glue_find(rbtdb, node, 0) != NULL);
+	RWUNLOCK(&rbtdb->glue_rwlock, isc_rwlocktype_read);
+	if (found) {
+		return (true);
 	}
-	/*
-	 * We found a cached result. Add it to the message and
-	 * return.
-	 */
-	found = true;
-	ge = cur->glue_list;
 
-	/*
-	 * (void *) -1 is a special value that means no glue is
-	 * present in the zone.
-	 */
-	if (ge == (void *)-1) {
-		if (!restarted && (rbtdb->gluecachestats != NULL)) {
-			isc_stats_increment(
-				rbtdb->gluecachestats,
-				dns_gluecachestatscounter_hits_absent);
+	dns_rdataset_init(&rdataset);
+	result = zone_findrdataset((dns_db_t *)rbtdb, node, version,
+				   dns_rdatatype_ns, 0, 0, &rdataset, NULL);
+	if (result != ISC_R_SUCCESS) {
+		return (false);
+	}
+	dns_rdataset_disassociate(&rdataset);
+	return (true);
+}
+
+/*%
+ * Compute the glue for every delegation in the zone that was just loaded.
+ */
+static void
+glue_load(dns_rbtdb_t *rbtdb) {
+	isc_result_t result;
+	dns_dbiterator_t *dbit = NULL;
+
+	result = createiterator((dns_db_t *)rbtdb, DNS_DB_NONSEC3, &dbit);
+	if (result != ISC_R_SUCCESS) {
+		return;
+	}
+
+	for (result = dbiterator_first(dbit); result == ISC_R_SUCCESS;
+	     result = dbiterator_next(dbit))
+	{
+		dns_dbnode_t *node = NULL;
+
+		result = dbiterator_current(dbit, &node, NULL);
+		if (result != ISC_R_SUCCESS) {
+			break;
 		}
-		goto no_glue;
-	} else {
-		if (!restarted && (rbtdb->gluecachestats != NULL)) {
-			isc_stats_increment(
-				rbtdb->gluecachestats,
-				dns_gluecachestatscounter_hits_present);
+		(void)dbiterator_pause(dbit);
+		glue_update(rbtdb, rbtdb->current_version,
+			    (dns_rbtnode_t *)node);
+		detachnode((dns_db_t *)rbtdb, &node);
+	}
+
+	dbiterator_destroy(&dbit);
+}
+
+/*%
+ * Before 'version' becomes the current version, recompute the glue for
+ * the delegations that its changes may have affected: the delegations
+ * that were changed themselves, the delegations that refer to an NS
+ * target that was changed, and the delegations that refer to an NS
+ * target below a delegation that was added or removed, as that decides
+ * whether the target is glue.  The glue for all other delegations
+ * carries over from the previous version unchanged.
+ */
+static void
+glue_commit(dns_rbtdb_t *rbtdb, rbtdb_version_t *version) {
+	isc_result_t result;
+	isc_ht_t *affected = NULL;
+	isc_ht_iter_t *iter = NULL;
+	rbtdb_changed_t *changed = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+
+	isc_ht_init(&affected, rbtdb->common.mctx, 4, ISC_HT_CASE_SENSITIVE);
+
+	for (changed = HEAD(version->changed_list); changed != NULL;
+	     changed = NEXT(changed, link))
+	{
+		dns_rbtnode_t *node = changed->node;
+
+		if (node->nsec == DNS_RBT_NSEC_NSEC3) {
+			continue;
+		}
+
+		(void)isc_ht_add(affected, (unsigned char *)&node,
+				 sizeof(node), node);
+
+		RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+		result = dns_rbt_fullnamefromnode(node, name);
+		RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+		if (result != ISC_R_SUCCESS) {
+			continue;
+		}
+
+		glue_affecttarget(rbtdb, name, affected);
+
+		if (node != rbtdb->origin_node &&
+		    glue_isdelegation(rbtdb, version, node))
+		{
+			glue_affectsubtree(rbtdb, name, affected);
+		}
+	}
+
+	isc_ht_iter_create(affected, &iter);
+	for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_next(iter))
+	{
+		dns_rbtnode_t *node = NULL;
+
+		isc_ht_iter_current(iter, (void **)&node);
+		glue_update(rbtdb, version, node);
+	}
+	isc_ht_iter_destroy(&iter);
+	isc_ht_destroy(&affected);
+}
+
+/*%
+ * Free the glue that was replaced in a version no later than
+ * 'least_serial', the oldest version that is still open.
+ */
+static void
+free_replaced_glue(dns_rbtdb_t *rbtdb, rbtdb_serial_t least_serial) {
+	rbtdb_glue_table_node_t *cur = NULL;
+	ISC_LIST(rbtdb_glue_table_node_t) replaced;
+
+	ISC_LIST_INIT(replaced);
+
+	RWLOCK(&rbtdb->glue_rwlock, isc_rwlocktype_write);
+	for (cur = ISC_LIST_HEAD(rbtdb->glue_replaced);
+	     cur != NULL && cur->until <= least_serial;
+	     cur = ISC_LIST_HEAD(rbtdb->glue_replaced))
+	{
+		rbtdb_glue_table_node_t **curp = NULL;
+		uint32_t idx = isc_hash_bits32(glue_hash(cur->node),
+					       rbtdb->glue_table_bits);
+
+		for (curp = &rbtdb->glue_table[idx]; *curp != cur;
+		     curp = &(*curp)->next)
+		{
+			INSIST(*curp != NULL);
 		}
+		*curp = cur->next;
+		rbtdb->glue_table_nodecount--;
+
+		ISC_LIST_UNLINK(rbtdb->glue_replaced, cur, link);
+		ISC_LIST_APPEND(replaced, cur, link);
 	}
+	RWUNLOCK(&rbtdb->glue_rwlock, isc_rwlocktype_write);
 
+	for (cur = ISC_LIST_HEAD(replaced); cur != NULL;
+	     cur = ISC_LIST_HEAD(replaced))
+	{
+		ISC_LIST_UNLINK(replaced, cur, link);
+		free_gluelist(cur->glue_list, rbtdb);
+		glue_put(rbtdb, cur, sizeof(*cur));
+	}
+}
+
+static void
+addglue_tomessage(rbtdb_glue_t *ge, dns_message_t *msg) {
 	for (; ge != NULL; ge = ge->next) {
 		dns_name_t *name = NULL;
 		dns_rdataset_t *rdataset_a = NULL;
@@ -9786,78 +11451,74 @@ restart:
 
 		dns_message_addname(msg, name, DNS_SECTION_ADDITIONAL);
 	}
+}
 
-no_glue:
-	RWUNLOCK(&rbtversion->glue_rwlock, isc_rwlocktype_read);
-
-	if (found) {
-		return (ISC_R_SUCCESS);
-	}
-
-	if (restarted) {
-		return (ISC_R_FAILURE);
-	}
-
-	/*
-	 * No cached glue was found in the table. Cache it and restart
-	 * this function.
-	 *
-	 * Due to the gap between the read lock and the write lock, it's
-	 * possible that we may cache a duplicate glue table entry, but
-	 * we don't care.
-	 */
-
-	ctx.glue_list = NULL;
-	ctx.rbtdb = rbtdb;
-	ctx.rbtversion = rbtversion;
-
-	RWLOCK(&rbtversion->glue_rwlock, isc_rwlocktype_write);
-
-	maybe_rehash_gluetable(rbtversion);
-	idx = isc_hash_bits32(hash, rbtversion->glue_table_bits);
-
-	(void)dns_rdataset_additionaldata(rdataset, dns_rootname,
-					  glue_nsdname_cb, &ctx);
+static isc_result_t
+rdataset_addglue(dns_rdataset_t *rdataset, dns_dbversion_t *version,
+		 dns_message_t *msg) {
+	dns_rbtdb_t *rbtdb = rdataset->private1;
+	dns_rbtnode_t *node = rdataset->private2;
+	rbtdb_version_t *rbtversion = version;
+	rbtdb_glue_table_node_t *cur;
+	rbtdb_glue_additionaldata_ctx_t ctx;
 
-	cur = isc_mem_get(rbtdb->common.mctx, sizeof(*cur));
+	REQUIRE(rdataset->type == dns_rdatatype_ns);
+	REQUIRE(rbtdb == rbtversion->rbtdb);
+	REQUIRE(!IS_CACHE(rbtdb) && !IS_STUB(rbtdb));
 
 	/*
-	 * XXXMUKS: it looks like the dns_dbversion is not destroyed
-	 * when named is terminated by a keyboard break. This doesn't
-	 * cleanup the node reference and keeps the process dangling.
-	 */
-	/* isc_refcount_increment0(&node->references); */
-	cur->node = node;
+	 * The glue table is a property of the database: each entry is
+	 * keyed by the node pointer of the delegation and holds the glue
+	 * for the versions from the one it was computed for up to the
+	 * one that replaced it.  The glue for every delegation is
+	 * computed when the zone is loaded, and recomputed for the
+	 * affected delegations when a version is committed (see
+	 * glue_commit()), so looking it up only needs the read lock.
+	 */
+	if (!rbtversion->writer) {
+		RWLOCK(&rbtdb->glue_rwlock, isc_rwlocktype_read);
+		cur = glue_find(rbtdb, node, rbtversion->serial);
+		if (cur != NULL) {
+			isc_statscounter_t counter;
 
-	if (ctx.glue_list == NULL) {
-		/*
-		 * No glue was found. Cache it so.
-		 */
-		cur->glue_list = (void *)-1;
-		if (rbtdb->gluecachestats != NULL) {
-			isc_stats_increment(
-				rbtdb->gluecachestats,
-				dns_gluecachestatscounter_inserts_absent);
+			/*
+			 * (void *) -1 is a special value that means no
+			 * glue is present in the zone.
+			 */
+			if (cur->glue_list == (void *)-1) {
+				counter = dns_gluecachestatscounter_hits_absent;
+			} else {
+				counter =
+					dns_gluecachestatscounter_hits_present;
+				addglue_tomessage(cur->glue_list, msg);
+			}
+			if (rbtdb->gluecachestats != NULL) {
+				isc_stats_increment(rbtdb->gluecachestats,
+						    counter);
+			}
 		}
-	} else {
-		cur->glue_list = ctx.glue_list;
-		if (rbtdb->gluecachestats != NULL) {
-			isc_stats_increment(
-				rbtdb->gluecachestats,
-				dns_gluecachestatscounter_inserts_present);
+		RWUNLOCK(&rbtdb->glue_rwlock, isc_rwlocktype_read);
+
+		if (cur != NULL) {
+			return (ISC_R_SUCCESS);
 		}
 	}
 
-	cur->next = rbtversion->glue_table[idx];
-	rbtversion->glue_table[idx] = cur;
-	rbtversion->glue_table_nodecount++;
-
-	RWUNLOCK(&rbtversion->glue_rwlock, isc_rwlocktype_write);
-
-	restarted = true;
-	goto restart;
+	/*
+	 * The glue for a version that is still being written is only
+	 * computed when it is committed: look it up for this message
+	 * only.
+	 */
+	ctx = (rbtdb_glue_additionaldata_ctx_t){
+		.rbtdb = rbtdb,
+		.rbtversion = rbtversion,
+	};
+	(void)dns_rdataset_additionaldata(rdataset, dns_rootname,
+					  glue_nsdname_cb, &ctx);
+	addglue_tomessage(ctx.glue_list, msg);
+	free_gluelist(ctx.glue_list, rbtdb);
 
-	/* UNREACHABLE */
+	return (ISC_R_SUCCESS);
 }
 
 /*%
@@ -9878,10 +11539,14 @@ no_glue:
  * may cause external queries at a higher level zone, involving more
  * transactions).
  *
+ * With the SIEVE policy the entry only needs to be marked as visited,
+ * which is done here under the read lock, and this always returns false.
+ *
  * Caller must hold the node (read or write) lock.
  */
 static bool
-need_headerupdate(rdatasetheader_t *header, isc_stdtime_t now) {
+need_headerupdate(dns_rbtdb_t *rbtdb, rdatasetheader_t *header,
+		  isc_stdtime_t now) {
 	if (RDATASET_ATTR_GET(header, (RDATASET_ATTR_NONEXISTENT |
 				       RDATASET_ATTR_ANCIENT |
 				       RDATASET_ATTR_ZEROTTL)) != 0)
@@ -9889,6 +11554,20 @@ need_headerupdate(rdatasetheader_t *header, isc_stdtime_t now) {
 		return (false);
 	}
 
+	if (rbtdb->evictionpolicy == dns_evictionpolicy_sieve) {
+		/*
+		 * Test first, so that hits on an entry that is already
+		 * marked don't keep dirtying its cache line.
+		 */
+		if ((atomic_load_relaxed(&header->attributes) &
+		     RDATASET_ATTR_VISITED) == 0)
+		{
+			atomic_fetch_or_relaxed(&header->attributes,
+						RDATASET_ATTR_VISITED);
+		}
+		return (false);
+	}
+
 #if DNS_RBTDB_LIMITLRUUPDATE
 	if (header->type == dns_rdatatype_ns ||
 	    (header->trust == dns_trust_glue &&
@@ -9929,11 +11608,108 @@ update_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header, isc_stdtime_t now) {
 	/* To be checked: can we really assume this? XXXMLG */
 	INSIST(ISC_LINK_LINKED(header, link));
 
-	ISC_LIST_UNLINK(rbtdb->rdatasets[header->node->locknum], header, link);
+	lru_unlink(rbtdb, header->node->locknum, header);
 	header->last_used = now;
 	ISC_LIST_PREPEND(rbtdb->rdatasets[header->node->locknum], header, link);
 }
 
+/*%
+ * Remove 'header' from the LRU list of bucket 'idx', moving the SIEVE
+ * hand on if it pointed there.
+ *
+ * Caller must hold the node (write) lock.
+ */
+static void
+lru_unlink(dns_rbtdb_t *rbtdb, unsigned int idx, rdatasetheader_t *header) {
+	if (rbtdb->lruhands[idx] == header) {
+		rbtdb->lruhands[idx] = ISC_LIST_PREV(header, link);
+	}
+	ISC_LIST_UNLINK(rbtdb->rdatasets[idx], header, link);
+}
+
+/*%
+ * Purge up to 'purgecount' of the least recently used entries from bucket
+ * 'locknum'.  Returns the number of entries purged.
+ *
+ * Caller must hold the node (write) lock.
+ */
+static int
+lru_purge(dns_rbtdb_t *rbtdb, unsigned int locknum, int purgecount,
+	  bool tree_locked) {
+	rdatasetheader_t *header, *header_prev;
+	int purged = 0;
+
+	for (header = ISC_LIST_TAIL(rbtdb->rdatasets[locknum]);
+	     header != NULL && purged < purgecount; header = header_prev)
+	{
+		header_prev = ISC_LIST_PREV(header, link);
+		/*
+		 * Unlink the entry at this point to avoid checking it
+		 * again even if it's currently used someone else and
+		 * cannot be purged at this moment.  This entry won't be
+		 * referenced any more (so unlinking is safe) since the
+		 * TTL was reset to 0.
+		 */
+		lru_unlink(rbtdb, locknum, header);
+		expire_header(rbtdb, header, tree_locked, expire_lru);
+		purged++;
+	}
+
+	return (purged);
+}
+
+/*%
+ * Purge up to 'purgecount' entries from bucket 'locknum' with the SIEVE
+ * algorithm: the hand moves from the tail of the list towards the head,
+ * clearing the visited bit of each entry that has been used since the
+ * hand last passed it and purging the first one that has not.  To bound
+ * the time spent holding the node lock when the bucket is full of hot
+ * entries, at most DNS_RBTDB_SIEVE_MAXSCAN entries are looked at; the
+ * hand keeps its place for the next call.
+ *
+ * Returns the number of entries purged.
+ *
+ * Caller must hold the node (write) lock.
+ */
+static int
+sieve_purge(dns_rbtdb_t *rbtdb, unsigned int locknum, int purgecount,
+	    bool tree_locked) {
+	rdatasetheader_t **hand = &rbtdb->lruhands[locknum];
+	int purged = 0;
+
+	for (unsigned int scanned = 0;
+	     purged < purgecount && scanned < DNS_RBTDB_SIEVE_MAXSCAN;
+	     scanned++)
+	{
+		rdatasetheader_t *header = *hand;
+
+		if (header == NULL) {
+			header = ISC_LIST_TAIL(rbtdb->rdatasets[locknum]);
+			if (header == NULL) {
+				break;
+			}
+		}
+
+		*hand = ISC_LIST_PREV(header, link);
+		if (RDATASET_ATTR_GET(header, RDATASET_ATTR_VISITED) != 0) {
+			RDATASET_ATTR_CLR(header, RDATASET_ATTR_VISITED);
+			continue;
+		}
+
+		/*
+		 * As in lru_purge(), unlink the entry so that it
+		 * isn't looked at again even if it can't be freed yet.
+		 * Anything freed by expire_header() moves the hand on
+		 * through lru_unlink().
+		 */
+		ISC_LIST_UNLINK(rbtdb->rdatasets[locknum], header, link);
+		expire_header(rbtdb, header, tree_locked, expire_lru);
+		purged++;
+	}
+
+	return (purged);
+}
+
 /*%
  * Purge some expired and/or stale (i.e. unused for some period) cache entries
  * under an overmem condition.  To recover from this condition quickly, up to
@@ -9947,7 +11723,6 @@ update_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header, isc_stdtime_t now) {
 static void
 overmem_purge(dns_rbtdb_t *rbtdb, unsigned int locknum_start, isc_stdtime_t now,
 	      bool tree_locked) {
-	rdatasetheader_t *header, *header_prev;
 	unsigned int locknum;
 	int purgecount = 2;
 
@@ -9958,37 +11733,206 @@ overmem_purge(dns_rbtdb_t *rbtdb, unsigned int locknum_start, isc_stdtime_t now,
 		NODE_LOCK(&rbtdb->node_locks[locknum].lock,
 			  isc_rwlocktype_write);
 
-		header = isc_heap_element(rbtdb->heaps[locknum], 1);
-		if (header && header->rdh_ttl < now - RBTDB_VIRTUAL) {
-			expire_header(rbtdb, header, tree_locked, expire_ttl);
-			purgecount--;
+		purgecount -= ttlwheel_expire(rbtdb, locknum, now, tree_locked,
+					      1);
+
+		if (rbtdb->evictionpolicy == dns_evictionpolicy_sieve) {
+			purgecount -= sieve_purge(rbtdb, locknum, purgecount,
+						  tree_locked);
+		} else {
+			purgecount -= lru_purge(rbtdb, locknum, purgecount,
+						tree_locked);
 		}
 
-		for (header = ISC_LIST_TAIL(rbtdb->rdatasets[locknum]);
-		     header != NULL && purgecount > 0; header = header_prev)
-		{
-			header_prev = ISC_LIST_PREV(header, link);
+		NODE_UNLOCK(&rbtdb->node_locks[locknum].lock,
+			    isc_rwlocktype_write);
+	}
+}
+
+/*%
+ * Expire up to 'budget' entries of bucket 'locknum' that are no longer
+ * servable at 'now', moving the TTL wheel of the bucket forward as far
+ * as it gets.  Returns the number of entries expired.
+ *
+ * Expiry is spread out this way so that a batch of entries sharing a TTL
+ * (such as all the records learned from a popular zone at the same time)
+ * doesn't have to be cleaned up all at once when the TTL runs out.
+ *
+ * The node write lock must be held.
+ */
+static int
+ttlwheel_expire(dns_rbtdb_t *rbtdb, unsigned int locknum, isc_stdtime_t now,
+		bool tree_locked, int budget) {
+	rbtdb_ttlwheel_t *wheel = &rbtdb->ttlwheels[locknum];
+	isc_stdtime_t until = now - RBTDB_VIRTUAL;
+	int expired = 0, steps = 0;
+
+	if (wheel->count == 0) {
+		if (wheel->now < until) {
+			wheel->now = until;
+		}
+		return (0);
+	}
+
+	while (expired < budget && steps < TTLWHEEL_MAXSTEPS &&
+	       wheel->now < until)
+	{
+		rdatasetheaderlist_t *slot =
+			&wheel->slots[wheel->now % TTLWHEEL_L0SLOTS];
+		rdatasetheader_t *header = ISC_LIST_HEAD(*slot);
+
+		if (header == NULL) {
+			ttlwheel_advance(rbtdb, wheel, until);
+			steps++;
+			continue;
+		}
+
+		ttlwheel_delete(rbtdb, locknum, header);
+		if (ttlwheel_key(rbtdb, header) >= until) {
 			/*
-			 * Unlink the entry at this point to avoid checking it
-			 * again even if it's currently used someone else and
-			 * cannot be purged at this moment.  This entry won't be
-			 * referenced any more (so unlinking is safe) since the
-			 * TTL was reset to 0.
+			 * The header has become servable for longer since
+			 * it was put on the wheel (serve-stale was enabled).
 			 */
-			ISC_LIST_UNLINK(rbtdb->rdatasets[locknum], header,
-					link);
-			expire_header(rbtdb, header, tree_locked, expire_lru);
-			purgecount--;
+			ttlwheel_insert(rbtdb, locknum, header);
+			continue;
 		}
 
+		expire_header(rbtdb, header, tree_locked, expire_ttl);
+		expired++;
+	}
+
+	return (expired);
+}
+
+/*%
+ * Remove up to 'budget' entries from the cache, for the cache cleaner
+ * (see dns_db_expire()).  Expired entries are taken from the TTL wheels
+ * first; if the cache is 'overmem', the rest of the budget goes to the
+ * entries chosen by the eviction policy.  The buckets are visited in
+ * turn from where the previous call stopped, at most
+ * DNS_RBTDB_CLEAN_SLICE entries each, so that no node lock is held for
+ * long.  The tree lock is not taken: nodes left empty are cleaned up
+ * later, as dead nodes.
+ */
+static unsigned int
+cache_expire(dns_db_t *db, isc_stdtime_t now, bool overmem,
+	     unsigned int budget) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+	unsigned int locknum, removed = 0;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(IS_CACHE(rbtdb));
+
+	prune_flushes(rbtdb, now);
+
+	locknum = atomic_load_relaxed(&rbtdb->cleanhand) %
+		  rbtdb->node_lock_count;
+	for (unsigned int i = 0;
+	     i < rbtdb->node_lock_count && removed < budget; i++)
+	{
+		int slice = ISC_MIN(budget - removed, DNS_RBTDB_CLEAN_SLICE);
+		int purged;
+
+		NODE_LOCK(&rbtdb->node_locks[locknum].lock,
+			  isc_rwlocktype_write);
+		purged = ttlwheel_expire(rbtdb, locknum, now, false, slice);
+		if (overmem && purged < slice) {
+			if (rbtdb->evictionpolicy == dns_evictionpolicy_sieve)
+			{
+				purged += sieve_purge(rbtdb, locknum,
+						      slice - purged, false);
+			} else {
+				purged += lru_purge(rbtdb, locknum,
+						    slice - purged, false);
+			}
+		}
 		NODE_UNLOCK(&rbtdb->node_locks[locknum].lock,
 			    isc_rwlocktype_write);
+
+		removed += purged;
+		locknum = (locknum + 1) % rbtdb->node_lock_count;
+	}
+	atomic_store_relaxed(&rbtdb->cleanhand, locknum);
+
+	return (removed);
+}
+
+/*%
+ * Copy 'header', which is being purged to make room in the cache, to
+ * the cold tier, unless it has expired already or is more than a plain
+ * positive RRset.
+ *
+ * Caller must hold the node (write) lock.
+ */
+static void
+coldtier_demote(dns_rbtdb_t *rbtdb, rdatasetheader_t *header,
+		bool tree_locked) {
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	unsigned char *raw = (unsigned char *)header;
+	unsigned int length;
+	isc_stdtime_t now;
+	isc_result_t result;
+
+	if (!EXISTS(header) || NEGATIVE(header) || ANCIENT(header) ||
+	    header->noqname != NULL || header->closest != NULL)
+	{
+		return;
+	}
+
+	isc_stdtime_get(&now);
+	if (header->rdh_ttl <= now) {
+		return;
+	}
+
+	/*
+	 * The owner name can only be read with the tree locked; as the
+	 * node lock is held already, don't wait for it.
+	 */
+	if (!tree_locked) {
+		result = isc_rwlock_trylock(&rbtdb->tree_lock,
+					    isc_rwlocktype_read);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS ||
+			      result == ISC_R_LOCKBUSY);
+		if (result != ISC_R_SUCCESS) {
+			return;
+		}
+	}
+	result = dns_rbt_fullnamefromnode(header->node, name);
+	if (!tree_locked) {
+		RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	}
+	if (result != ISC_R_SUCCESS) {
+		return;
+	}
+
+	/*
+	 * A flushed RRset would come back when it is taken from the cold
+	 * tier.
+	 */
+	if (FLUSHED(header, flushgen(rbtdb, name, now))) {
+		return;
+	}
+
+	length = dns_rdataslab_size(raw, sizeof(*header)) - sizeof(*header);
+	if (dns_coldcache_put(rbtdb->coldtier, name,
+			      RBTDB_RDATATYPE_BASE(header->type),
+			      RBTDB_RDATATYPE_EXT(header->type), header->trust,
+			      header->rdh_ttl, raw + sizeof(*header), length) &&
+	    rbtdb->cachestats != NULL)
+	{
+		isc_stats_increment(rbtdb->cachestats,
+				    dns_cachestatscounter_colddemoted);
 	}
 }
 
 static void
 expire_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header, bool tree_locked,
 	      expire_t reason) {
+	if (reason == expire_lru && rbtdb->coldtier != NULL) {
+		coldtier_demote(rbtdb, header, tree_locked);
+	}
+
 	set_ttl(rbtdb, header, 0);
 	mark_header_ancient(rbtdb, header);
 
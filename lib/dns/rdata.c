@@ -639,6 +639,21 @@ check_private(isc_buffer_t *source, dns_secalg_t alg) {
 #define META	 0x0001
 #define RESERVED 0x0002
 
+/*
+ * The wire format properties of the types, folded to constants so that
+ * the common types skip the per-type functions.
+ */
+static inline unsigned int
+rdata_wireinfo(dns_rdataclass_t rdclass, dns_rdatatype_t type) {
+	RDATAWIRESWITCH
+	return (0);
+}
+
+static inline bool
+rdata_isplain(dns_rdataclass_t rdclass, dns_rdatatype_t type) {
+	return ((rdata_wireinfo(rdclass, type) & DNS_RDATAWIRE_PLAIN) != 0);
+}
+
 /***
  *** Initialization
  ***/
@@ -715,7 +730,11 @@ dns_rdata_compare(const dns_rdata_t *rdata1, const dns_rdata_t *rdata2) {
 		return (rdata1->type < rdata2->type ? -1 : 1);
 	}
 
-	COMPARESWITCH
+	if (rdata_isplain(rdata1->rdclass, rdata1->type)) {
+		use_default = true;
+	} else {
+		COMPARESWITCH
+	}
 
 	if (use_default) {
 		isc_region_t r1;
@@ -748,7 +767,11 @@ dns_rdata_casecompare(const dns_rdata_t *rdata1, const dns_rdata_t *rdata2) {
 		return (rdata1->type < rdata2->type ? -1 : 1);
 	}
 
-	CASECOMPARESWITCH
+	if (rdata_isplain(rdata1->rdclass, rdata1->type)) {
+		use_default = true;
+	} else {
+		CASECOMPARESWITCH
+	}
 
 	if (use_default) {
 		isc_region_t r1;
@@ -802,7 +825,7 @@ dns_rdata_fromwire(dns_rdata_t *rdata, dns_rdataclass_t rdclass,
 	isc_buffer_t st;
 	bool use_default = false;
 	uint32_t activelength;
-	unsigned int length;
+	unsigned int length, wire;
 
 	if (rdata != NULL) {
 		REQUIRE(DNS_RDATA_INITIALIZED(rdata));
@@ -821,7 +844,28 @@ dns_rdata_fromwire(dns_rdata_t *rdata, dns_rdataclass_t rdclass,
 	activelength = isc_buffer_activelength(source);
 	INSIST(activelength < 65536);
 
-	FROMWIRESWITCH
+	wire = rdata_wireinfo(rdclass, type);
+	if ((wire & DNS_RDATAWIRE_PLAIN) != 0 &&
+	    (wire & DNS_RDATAWIRE_LENGTH) != 0)
+	{
+		/*
+		 * Fixed length rdata with nothing to check or decompress,
+		 * such as IN A and IN AAAA.
+		 */
+		length = wire & DNS_RDATAWIRE_LENGTH;
+		if (activelength < length) {
+			result = ISC_R_UNEXPECTEDEND;
+		} else if (isc_buffer_availablelength(target) < length) {
+			result = ISC_R_NOSPACE;
+		} else {
+			isc_buffer_putmem(target, isc_buffer_current(source),
+					  length);
+			isc_buffer_forward(source, length);
+			result = ISC_R_SUCCESS;
+		}
+	} else {
+		FROMWIRESWITCH
+	}
 
 	if (use_default) {
 		if (activelength > isc_buffer_availablelength(target)) {
@@ -884,7 +928,11 @@ dns_rdata_towire(dns_rdata_t *rdata, dns_compress_t *cctx,
 
 	st = *target;
 
-	TOWIRESWITCH
+	if (rdata_isplain(rdata->rdclass, rdata->type)) {
+		use_default = true;
+	} else {
+		TOWIRESWITCH
+	}
 
 	if (use_default) {
 		isc_buffer_availableregion(target, &tr);
@@ -1365,6 +1413,11 @@ dns_rdata_checknames(dns_rdata_t *rdata, const dns_name_t *owner,
 	return (result);
 }
 
+unsigned int
+dns_rdata_wireinfo(dns_rdataclass_t rdclass, dns_rdatatype_t type) {
+	return (rdata_wireinfo(rdclass, type));
+}
+
 unsigned int
 dns_rdatatype_attributes(dns_rdatatype_t type) {
 	RDATATYPE_ATTRIBUTE_SW
@@ -16,6 +16,8 @@
 
 #define RRTYPE_CAA_ATTRIBUTES (0)
 
+#define RRTYPE_CAA_WIRE (DNS_RDATAWIRE_PLAIN)
+
 static unsigned char const alphanumeric[256] = {
 	/* 0x00-0x0f */ 0,
 	0,
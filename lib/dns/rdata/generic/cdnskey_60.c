@@ -20,6 +20,8 @@
 
 #define RRTYPE_CDNSKEY_ATTRIBUTES 0
 
+#define RRTYPE_CDNSKEY_WIRE (DNS_RDATAWIRE_PLAIN)
+
 static isc_result_t
 fromtext_cdnskey(ARGS_FROMTEXT) {
 	REQUIRE(type == dns_rdatatype_cdnskey);
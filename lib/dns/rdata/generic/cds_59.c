@@ -18,6 +18,8 @@
 
 #define RRTYPE_CDS_ATTRIBUTES 0
 
+#define RRTYPE_CDS_WIRE (DNS_RDATAWIRE_PLAIN)
+
 #include <dns/ds.h>
 
 static isc_result_t
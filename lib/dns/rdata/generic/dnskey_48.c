@@ -20,6 +20,8 @@
 
 #define RRTYPE_DNSKEY_ATTRIBUTES (DNS_RDATATYPEATTR_DNSSEC)
 
+#define RRTYPE_DNSKEY_WIRE (DNS_RDATAWIRE_PLAIN)
+
 static isc_result_t
 fromtext_dnskey(ARGS_FROMTEXT) {
 	REQUIRE(type == dns_rdatatype_dnskey);
@@ -20,6 +20,8 @@
 	(DNS_RDATATYPEATTR_DNSSEC | DNS_RDATATYPEATTR_ZONECUTAUTH | \
 	 DNS_RDATATYPEATTR_ATPARENT)
 
+#define RRTYPE_DS_WIRE (DNS_RDATAWIRE_PLAIN)
+
 #include <isc/md.h>
 
 #include <dns/ds.h>
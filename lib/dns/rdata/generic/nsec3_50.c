@@ -37,6 +37,8 @@
 
 #define RRTYPE_NSEC3_ATTRIBUTES DNS_RDATATYPEATTR_DNSSEC
 
+#define RRTYPE_NSEC3_WIRE (DNS_RDATAWIRE_PLAIN)
+
 static isc_result_t
 fromtext_nsec3(ARGS_FROMTEXT) {
 	isc_token_t token;
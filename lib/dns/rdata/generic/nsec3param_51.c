@@ -37,6 +37,8 @@
 
 #define RRTYPE_NSEC3PARAM_ATTRIBUTES (DNS_RDATATYPEATTR_DNSSEC)
 
+#define RRTYPE_NSEC3PARAM_WIRE (DNS_RDATAWIRE_PLAIN)
+
 static isc_result_t
 fromtext_nsec3param(ARGS_FROMTEXT) {
 	isc_token_t token;
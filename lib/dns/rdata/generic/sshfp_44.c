@@ -18,6 +18,8 @@
 
 #define RRTYPE_SSHFP_ATTRIBUTES (0)
 
+#define RRTYPE_SSHFP_WIRE (DNS_RDATAWIRE_PLAIN)
+
 static isc_result_t
 fromtext_sshfp(ARGS_FROMTEXT) {
 	isc_token_t token;
@@ -18,6 +18,8 @@
 
 #define RRTYPE_TLSA_ATTRIBUTES 0
 
+#define RRTYPE_TLSA_WIRE (DNS_RDATAWIRE_PLAIN)
+
 static isc_result_t
 generic_fromtext_tlsa(ARGS_FROMTEXT) {
 	isc_token_t token;
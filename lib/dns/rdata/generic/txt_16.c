@@ -16,6 +16,8 @@
 
 #define RRTYPE_TXT_ATTRIBUTES (0)
 
+#define RRTYPE_TXT_WIRE (DNS_RDATAWIRE_PLAIN)
+
 static isc_result_t
 generic_fromtext_txt(ARGS_FROMTEXT) {
 	isc_token_t token;
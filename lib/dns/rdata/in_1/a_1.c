@@ -20,6 +20,8 @@
 
 #define RRTYPE_A_ATTRIBUTES (0)
 
+#define RRTYPE_IN_A_WIRE (DNS_RDATAWIRE_PLAIN | 4)
+
 static isc_result_t
 fromtext_in_a(ARGS_FROMTEXT) {
 	isc_token_t token;
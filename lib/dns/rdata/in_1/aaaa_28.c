@@ -20,6 +20,8 @@
 
 #define RRTYPE_AAAA_ATTRIBUTES (0)
 
+#define RRTYPE_IN_AAAA_WIRE (DNS_RDATAWIRE_PLAIN | 16)
+
 static isc_result_t
 fromtext_in_aaaa(ARGS_FROMTEXT) {
 	isc_token_t token;
@@ -304,6 +304,17 @@ swap_rdata(dns_rdata_t *in, unsigned int a, unsigned int b) {
 	in[b] = rdata;
 }
 
+/*
+ * Can rdata of this type be rendered as it is stored?  True for the
+ * types that hold no domain names, so that dns_rdata_towire() would
+ * only copy them.
+ */
+static bool
+towire_plain(dns_rdataclass_t rdclass, dns_rdatatype_t type) {
+	return ((dns_rdata_wireinfo(rdclass, type) & DNS_RDATAWIRE_PLAIN) !=
+		0);
+}
+
 static isc_result_t
 towiresorted(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 	     dns_compress_t *cctx, isc_buffer_t *target,
@@ -314,9 +325,10 @@ towiresorted(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 	unsigned int i, count = 0, added;
 	isc_buffer_t savedbuffer, rdlen, rrbuffer;
 	unsigned int headlen;
-	bool question = false;
-	bool shuffle = false, sort = false;
+	bool question = false, plain = false;
+	bool shuffle = false, sort = false, rotate = false;
 	bool want_random, want_cyclic;
+	unsigned int start = 0;
 	dns_rdata_t in_fixed[MAX_SHUFFLE];
 	dns_rdata_t *in = in_fixed;
 	struct towire_sort out_fixed[MAX_SHUFFLE];
@@ -378,6 +390,19 @@ towiresorted(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 		}
 	}
 
+	/*
+	 * Cyclic order alone is a rotation of the stored order, which
+	 * is rendered by iterating from the starting record and wrapping
+	 * around, without taking a handle to each rdata first.
+	 */
+	if (shuffle && !sort && !want_random) {
+		shuffle = false;
+		if (rdataset->count != DNS_RDATASET_COUNT_UNDEFINED) {
+			start = rdataset->count % count;
+			rotate = (start != 0);
+		}
+	}
+
 	if ((shuffle || sort)) {
 		if (count > MAX_SHUFFLE) {
 			in = isc_mem_get(cctx->mctx, count * sizeof(*in));
@@ -436,6 +461,10 @@ towiresorted(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 		}
 	}
 
+	if (!question) {
+		plain = towire_plain(rdataset->rdclass, rdataset->type);
+	}
+
 	savedbuffer = *target;
 	i = 0;
 	added = 0;
@@ -447,6 +476,13 @@ towiresorted(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 
 	name->attributes |= owner_name->attributes & DNS_NAMEATTR_NOCOMPRESS;
 
+	for (unsigned int k = 0; rotate && k < start; k++) {
+		result = dns_rdataset_next(rdataset);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+	}
+
 	do {
 		/*
 		 * Copy out the name, type, class, ttl.
@@ -475,30 +511,48 @@ towiresorted(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 
 			isc_buffer_putuint32(target, rdataset->ttl);
 
-			/*
-			 * Save space for rdlen.
-			 */
-			rdlen = *target;
-			isc_buffer_add(target, 2);
-
-			/*
-			 * Copy out the rdata
-			 */
 			if (shuffle || sort) {
 				rdata = *(out[i].rdata);
 			} else {
 				dns_rdata_reset(&rdata);
 				dns_rdataset_current(rdataset, &rdata);
 			}
-			result = dns_rdata_towire(&rdata, cctx, target);
-			if (result != ISC_R_SUCCESS) {
-				goto rollback;
+
+			if (plain) {
+				/*
+				 * Nothing in the rdata can be compressed,
+				 * so the length is known up front and the
+				 * rdata is copied out as it is stored.
+				 */
+				isc_buffer_availableregion(target, &r);
+				if (r.length < 2 + rdata.length) {
+					result = ISC_R_NOSPACE;
+					goto rollback;
+				}
+				isc_buffer_putuint16(target, rdata.length);
+				isc_buffer_putmem(target, rdata.data,
+						  rdata.length);
+			} else {
+				/*
+				 * Save space for rdlen.
+				 */
+				rdlen = *target;
+				isc_buffer_add(target, 2);
+
+				/*
+				 * Copy out the rdata
+				 */
+				result = dns_rdata_towire(&rdata, cctx, target);
+				if (result != ISC_R_SUCCESS) {
+					goto rollback;
+				}
+				INSIST((target->used >= rdlen.used + 2) &&
+				       (target->used - rdlen.used - 2 < 65536));
+				isc_buffer_putuint16(
+					&rdlen,
+					(uint16_t)(target->used - rdlen.used -
+						   2));
 			}
-			INSIST((target->used >= rdlen.used + 2) &&
-			       (target->used - rdlen.used - 2 < 65536));
-			isc_buffer_putuint16(
-				&rdlen,
-				(uint16_t)(target->used - rdlen.used - 2));
 			added++;
 		}
 
@@ -511,6 +565,13 @@ towiresorted(dns_rdataset_t *rdataset, const dns_name_t *owner_name,
 			}
 		} else {
 			result = dns_rdataset_next(rdataset);
+			if (rotate) {
+				if (++i == count) {
+					result = ISC_R_NOMORE;
+				} else if (result == ISC_R_NOMORE) {
+					result = dns_rdataset_first(rdataset);
+				}
+			}
 		}
 	} while (result == ISC_R_SUCCESS);
 
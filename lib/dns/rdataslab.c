@@ -83,6 +83,8 @@ compare_rdata(const void *p1, const void *p2) {
 	return (dns_rdata_compare(&x1->rdata, &x2->rdata));
 }
 
+static dns_rdatasetmethods_t slab_methods;
+
 #if DNS_RDATASET_FIXED
 static void
 fillin_offsets(unsigned char *offsetbase, unsigned int *offsettable,
@@ -135,6 +137,22 @@ dns_rdataslab_fromrdataset(dns_rdataset_t *rdataset, isc_mem_t *mctx,
 	unsigned int *offsettable;
 #endif /* if DNS_RDATASET_FIXED */
 
+	/*
+	 * An rdataset that already refers to a slab, such as one read
+	 * from a raw zone file, is copied as it is.
+	 */
+	if (rdataset->methods == &slab_methods) {
+		unsigned char *slab = rdataset->private3;
+
+		buflen = reservelen + dns_rdataslab_size(slab, 0);
+		rawbuf = isc_mem_get(mctx, buflen);
+		region->base = rawbuf;
+		region->length = buflen;
+		memset(rawbuf, 0, reservelen);
+		memmove(rawbuf + reservelen, slab, buflen - reservelen);
+		return (ISC_R_SUCCESS);
+	}
+
 	buflen = reservelen + 2;
 
 	nitems = dns_rdataset_count(rdataset);
@@ -441,6 +459,137 @@ rdata_from_slab(unsigned char **current, dns_rdataclass_t rdclass,
 	*current = tcurrent;
 }
 
+/*
+ * For rdatasets made with dns_rdataslab_tordatasetref(), private1
+ * points to the methods of the owner of the slab and private2 to the
+ * owner.
+ */
+static void
+rdataset_disassociate(dns_rdataset_t *rdataset) {
+	const dns_rdataslabowner_t *methods = rdataset->private1;
+
+	if (methods != NULL) {
+		methods->detach(rdataset->private2);
+	}
+}
+
+static isc_result_t
+rdataset_first(dns_rdataset_t *rdataset) {
+	unsigned char *raw = rdataset->private3;
+	unsigned int count;
+
+	count = raw[0] * 256 + raw[1];
+	if (count == 0) {
+		rdataset->private5 = NULL;
+		return (ISC_R_NOMORE);
+	}
+	raw += 2;
+#if DNS_RDATASET_FIXED
+	raw += 4 * count;
+#endif /* if DNS_RDATASET_FIXED */
+
+	/*
+	 * The records are walked in DNSSEC order; privateuint4 counts
+	 * the records after the current one.
+	 */
+	rdataset->privateuint4 = count - 1;
+	rdataset->private5 = raw;
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+rdataset_next(dns_rdataset_t *rdataset) {
+	unsigned char *raw = rdataset->private5;
+	unsigned int length;
+
+	if (rdataset->privateuint4 == 0) {
+		rdataset->private5 = NULL;
+		return (ISC_R_NOMORE);
+	}
+	rdataset->privateuint4--;
+
+	length = raw[0] * 256 + raw[1];
+	raw += 2;
+#if DNS_RDATASET_FIXED
+	raw += 2;
+#endif /* if DNS_RDATASET_FIXED */
+	rdataset->private5 = raw + length;
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+rdataset_current(dns_rdataset_t *rdataset, dns_rdata_t *rdata) {
+	unsigned char *raw = rdataset->private5;
+
+	REQUIRE(raw != NULL);
+
+	rdata_from_slab(&raw, rdataset->rdclass, rdataset->type, rdata);
+}
+
+static void
+rdataset_clone(dns_rdataset_t *source, dns_rdataset_t *target) {
+	const dns_rdataslabowner_t *methods = source->private1;
+
+	if (methods != NULL) {
+		methods->attach(source->private2);
+	}
+
+	*target = *source;
+	ISC_LINK_INIT(target, link);
+}
+
+static unsigned int
+rdataset_count(dns_rdataset_t *rdataset) {
+	return (dns_rdataslab_count(rdataset->private3, 0));
+}
+
+static dns_rdatasetmethods_t slab_methods = {
+	.disassociate = rdataset_disassociate,
+	.first = rdataset_first,
+	.next = rdataset_next,
+	.current = rdataset_current,
+	.clone = rdataset_clone,
+	.count = rdataset_count,
+};
+
+void
+dns_rdataslab_tordataset(unsigned char *slab, unsigned int reservelen,
+			 dns_rdataclass_t rdclass, dns_rdatatype_t type,
+			 dns_rdatatype_t covers, dns_ttl_t ttl,
+			 dns_rdataset_t *rdataset) {
+	REQUIRE(slab != NULL);
+	REQUIRE(DNS_RDATASET_VALID(rdataset));
+	REQUIRE(!dns_rdataset_isassociated(rdataset));
+
+	rdataset->methods = &slab_methods;
+	rdataset->rdclass = rdclass;
+	rdataset->type = type;
+	rdataset->covers = covers;
+	rdataset->ttl = ttl;
+	rdataset->private3 = slab + reservelen;
+	rdataset->private5 = NULL;
+	rdataset->privateuint4 = 0;
+}
+
+void
+dns_rdataslab_tordatasetref(unsigned char *slab, unsigned int reservelen,
+			    dns_rdataclass_t rdclass, dns_rdatatype_t type,
+			    dns_rdatatype_t covers, dns_ttl_t ttl,
+			    const dns_rdataslabowner_t *methods, void *owner,
+			    dns_rdataset_t *rdataset) {
+	REQUIRE(methods != NULL);
+	REQUIRE(methods->attach != NULL && methods->detach != NULL);
+
+	dns_rdataslab_tordataset(slab, reservelen, rdclass, type, covers, ttl,
+				 rdataset);
+
+	methods->attach(owner);
+	DE_CONST(methods, rdataset->private1);
+	rdataset->private2 = owner;
+}
+
 /*
  * Return true iff 'slab' (slab data of type 'type' and class 'rdclass')
  * contains an rdata identical to 'rdata'.  This does case insensitive
@@ -16,13 +16,17 @@
 #include <ctype.h>
 #include <inttypes.h>
 #include <stdbool.h>
+#include <stdlib.h>
 
+#include <isc/ascii.h>
 #include <isc/atomic.h>
 #include <isc/counter.h>
 #include <isc/hash.h>
+#include <isc/hashmap.h>
 #include <isc/log.h>
 #include <isc/loop.h>
 #include <isc/print.h>
+#include <isc/probes.h>
 #include <isc/random.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
@@ -51,6 +55,7 @@
 #include <dns/ncache.h>
 #include <dns/nsec.h>
 #include <dns/nsec3.h>
+#include <dns/nsec3index.h>
 #include <dns/opcode.h>
 #include <dns/peer.h>
 #include <dns/rbt.h>
@@ -215,6 +220,18 @@
 #define NS_FAIL_LIMIT 4
 #define NS_RR_LIMIT   5
 
+/*
+ * The shortest time, in microseconds, to wait for an answer before
+ * sending a hedged query to another server.
+ */
+#define HEDGE_MIN_DELAY_US (50 * US_PER_MSEC)
+
+/*
+ * What a query to a forwarder that times out costs, in microseconds:
+ * forwarders are given at least a second to answer (see fctx_query()).
+ */
+#define FORWARDER_TIMEOUT_COST_US US_PER_SEC
+
 /* Hash table for zone counters */
 #ifndef RES_DOMAIN_HASH_BITS
 #define RES_DOMAIN_HASH_BITS 12
@@ -280,10 +297,12 @@ struct tried {
 #define VALID_QUERY(query) ISC_MAGIC_VALID(query, QUERY_MAGIC)
 
 #define RESQUERY_ATTR_CANCELED 0x02
+#define RESQUERY_ATTR_HEDGE    0x04
 
 #define RESQUERY_CONNECTING(q) ((q)->connects > 0)
 #define RESQUERY_CANCELED(q)   (((q)->attributes & RESQUERY_ATTR_CANCELED) != 0)
 #define RESQUERY_SENDING(q)    ((q)->sends > 0)
+#define RESQUERY_HEDGE(q)      (((q)->attributes & RESQUERY_ATTR_HEDGE) != 0)
 
 typedef enum {
 	fetchstate_init = 0, /*%< Start event has not run yet. */
@@ -298,10 +317,27 @@ typedef enum {
 	badns_forwarder,
 } badnstype_t;
 
-typedef struct fctxbucket {
-	isc_mutex_t lock;
-	ISC_LIST(fetchctx_t) fctxs;
-} fctxbucket_t;
+/*%
+ * Fetch contexts are indexed in res->fctxtable by a key made of the
+ * fetch type, options and downcased name, so a new fetch finds the
+ * context it can join with a single lookup.  A context that must not be
+ * shared, or that can no longer be joined, is given a unique key that
+ * also holds its address instead, so that every live context stays in
+ * the table and can be found when the resolver is shut down.
+ *
+ * The resolvers of views sharing a cache may also share the table, so
+ * that a fetch started in one view can be joined from the others.
+ */
+#define FCTX_KEY_SHARED	 0
+#define FCTX_KEY_UNIQUE	 1
+#define FCTX_KEY_MAXSIZE (1 + 2 + 4 + sizeof(void *) + DNS_NAME_MAXWIRE)
+
+typedef struct fctxtable {
+	isc_mem_t *mctx;
+	isc_refcount_t references;
+	isc_rwlock_t lock;
+	isc_hashmap_t *fctxs;
+} fctxtable_t;
 
 typedef struct fctxcount fctxcount_t;
 struct fctxcount {
@@ -327,7 +363,6 @@ struct fetchctx {
 	dns_name_t *name;
 	dns_rdatatype_t type;
 	unsigned int options;
-	fctxbucket_t *bucket;
 	zonebucket_t *zbucket;
 	char *info;
 	isc_mem_t *mctx;
@@ -339,7 +374,12 @@ struct fetchctx {
 	/* Atomic */
 	isc_refcount_t references;
 
-	/*% Locked by bucket lock. */
+	/*% Locked by res->fctxtable->lock. */
+	uint8_t key[FCTX_KEY_MAXSIZE];
+	uint32_t keysize;
+
+	/*% Locked by lock. */
+	isc_mutex_t lock;
 	fetchstate_t state;
 	atomic_bool want_shutdown;
 	bool cloned;
@@ -355,6 +395,8 @@ struct fetchctx {
 	atomic_uint_fast32_t attributes;
 	isc_loop_t *loop;
 	isc_timer_t *timer;
+	isc_timer_t *hedgetimer;
+	unsigned int hedges;
 	isc_time_t expires;
 	isc_time_t expires_try_stale;
 	isc_time_t next_timeout;
@@ -523,6 +565,22 @@ typedef struct alternate {
 	ISC_LINK(struct alternate) link;
 } alternate_t;
 
+/*%
+ * The cumulative time spent in the fetches started from one delegation.
+ * Only RES_SLOWZONES delegations are tracked; when a new one is seen,
+ * it replaces the delegation with the least cumulative time, so the
+ * table keeps the slowest delegations without growing.
+ */
+#define RES_SLOWZONES 64
+
+typedef struct slowzone {
+	dns_fixedname_t fname;
+	dns_name_t *name; /* NULL if unused */
+	uint64_t fetches;
+	uint64_t waited;
+	uint64_t maxwait;
+} slowzone_t;
+
 struct dns_resolver {
 	/* Unlocked. */
 	unsigned int magic;
@@ -541,8 +599,7 @@ struct dns_resolver {
 	dns_dispatchset_t *dispatches6;
 	isc_dscp_t querydscp4;
 	isc_dscp_t querydscp6;
-	isc_ht_t *buckets;
-	isc_rwlock_t hash_lock;
+	fctxtable_t *fctxtable;
 	isc_ht_t *zonebuckets;
 	isc_rwlock_t zonehash_lock;
 	unsigned int ntasks;
@@ -567,6 +624,8 @@ struct dns_resolver {
 	/* Additions for serve-stale feature. */
 	unsigned int retryinterval; /* in milliseconds */
 	unsigned int nonbackofftries;
+	unsigned int maxhedges;
+	unsigned int maxfwdqueries;
 
 	/* Atomic */
 	isc_refcount_t references;
@@ -584,6 +643,10 @@ struct dns_resolver {
 
 	/* Atomic. */
 	atomic_uint_fast32_t nfctx;
+
+	/* Locked by slowzoneslock. */
+	isc_mutex_t slowzoneslock;
+	slowzone_t *slowzones;
 };
 
 #define RES_MAGIC	    ISC_MAGIC('R', 'e', 's', '!')
@@ -648,6 +711,11 @@ static isc_result_t
 fctx_minimize_qname(fetchctx_t *fctx);
 static void
 fctx_destroy(fetchctx_t *fctx);
+static uint32_t
+fctx_makekey(uint8_t *key, const dns_name_t *name, dns_rdatatype_t type,
+	     unsigned int options, const fetchctx_t *unique);
+static bool
+fctx_tryref(fetchctx_t *fctx);
 static isc_result_t
 ncache_adderesult(dns_message_t *message, dns_db_t *cache, dns_dbnode_t *node,
 		  dns_rdatatype_t covers, isc_stdtime_t now, dns_ttl_t minttl,
@@ -1200,9 +1268,9 @@ resquery_destroy(resquery_t *query) {
 
 	isc_refcount_destroy(&query->references);
 
-	LOCK(&fctx->bucket->lock);
+	LOCK(&fctx->lock);
 	atomic_fetch_sub_release(&fctx->nqueries, 1);
-	UNLOCK(&fctx->bucket->lock);
+	UNLOCK(&fctx->lock);
 	fctx_detach(&query->fctx);
 
 	if (query->rmessage != NULL) {
@@ -1329,6 +1397,7 @@ fctx_cancelquery(resquery_t **queryp, isc_time_t *finish, bool no_response,
 			rtt = (unsigned int)isc_time_microdiff(finish,
 							       &query->start);
 			factor = DNS_ADB_RTTADJDEFAULT;
+			dns_adb_serverrtt(fctx->adb, query->addrinfo, rtt);
 
 			rttms = rtt / US_PER_MSEC;
 			if (rttms < DNS_RESOLVER_QRYRTTCLASS0) {
@@ -1354,6 +1423,8 @@ fctx_cancelquery(resquery_t **queryp, isc_time_t *finish, bool no_response,
 			uint32_t value;
 			uint32_t mask;
 
+			dns_adb_servercount(fctx->adb, query->addrinfo,
+					    dns_adbserver_timeouts);
 			update_edns_stats(query);
 
 			/*
@@ -1480,11 +1551,11 @@ fctx_cancelquery(resquery_t **queryp, isc_time_t *finish, bool no_response,
 		dns_dispatch_cancel(&query->dispentry);
 	}
 
-	LOCK(&fctx->bucket->lock);
+	LOCK(&fctx->lock);
 	if (ISC_LINK_LINKED(query, link)) {
 		ISC_LIST_UNLINK(fctx->queries, query, link);
 	}
-	UNLOCK(&fctx->bucket->lock);
+	UNLOCK(&fctx->lock);
 
 	resquery_detach(queryp);
 }
@@ -1538,13 +1609,17 @@ fctx_cancelqueries(fetchctx_t *fctx, bool no_response, bool age_untried) {
 
 	ISC_LIST_INIT(queries);
 
+	if (fctx->hedgetimer != NULL) {
+		isc_timer_stop(fctx->hedgetimer);
+	}
+
 	/*
 	 * Move the queries to a local list so we can cancel
 	 * them without holding the lock.
 	 */
-	LOCK(&fctx->bucket->lock);
+	LOCK(&fctx->lock);
 	ISC_LIST_MOVE(queries, fctx->queries);
-	UNLOCK(&fctx->bucket->lock);
+	UNLOCK(&fctx->lock);
 
 	for (query = ISC_LIST_HEAD(queries); query != NULL; query = next_query)
 	{
@@ -1717,6 +1792,49 @@ fcount_decr(fetchctx_t *fctx) {
 	UNLOCK(&zbucket->lock);
 }
 
+/*
+ * Add a fetch which took 'duration' microseconds to the cumulative time
+ * of the delegation 'domain'.
+ */
+static void
+slowzone_record(dns_resolver_t *res, const dns_name_t *domain,
+		uint64_t duration) {
+	slowzone_t *zone = NULL;
+
+	LOCK(&res->slowzoneslock);
+	for (size_t i = 0; i < RES_SLOWZONES; i++) {
+		slowzone_t *z = &res->slowzones[i];
+
+		/* The slots are filled in order, and never emptied */
+		if (z->name == NULL) {
+			zone = z;
+			break;
+		}
+		if (dns_name_equal(z->name, domain)) {
+			zone = z;
+			break;
+		}
+		if (zone == NULL || z->waited < zone->waited) {
+			zone = z;
+		}
+	}
+
+	if (zone->name == NULL || !dns_name_equal(zone->name, domain)) {
+		zone->name = dns_fixedname_initname(&zone->fname);
+		dns_name_copy(domain, zone->name);
+		zone->fetches = 0;
+		zone->waited = 0;
+		zone->maxwait = 0;
+	}
+
+	zone->fetches++;
+	zone->waited += duration;
+	if (duration > zone->maxwait) {
+		zone->maxwait = duration;
+	}
+	UNLOCK(&res->slowzoneslock);
+}
+
 static void
 fctx_sendevents(fetchctx_t *fctx, isc_result_t result, int line) {
 	dns_fetchevent_t *event, *next_event;
@@ -1730,7 +1848,7 @@ fctx_sendevents(fetchctx_t *fctx, isc_result_t result, int line) {
 				       * compiler warnings */
 
 	/*
-	 * Caller must be holding the appropriate bucket lock.
+	 * Caller must be holding the fctx lock.
 	 */
 	REQUIRE(fctx->state == fetchstate_done);
 
@@ -1743,6 +1861,9 @@ fctx_sendevents(fetchctx_t *fctx, isc_result_t result, int line) {
 	fctx->exitline = line;
 	TIME_NOW(&now);
 	fctx->duration = isc_time_microdiff(&now, &fctx->start);
+	if (dns_name_countlabels(fctx->domain) > 0) {
+		slowzone_record(fctx->res, fctx->domain, fctx->duration);
+	}
 
 	for (event = ISC_LIST_HEAD(fctx->events); event != NULL;
 	     event = next_event) {
@@ -1827,6 +1948,7 @@ fctx__done_detach(fetchctx_t **fctxp, isc_result_t result, const char *file,
 	fctx = *fctxp;
 
 	FCTXTRACE("done");
+	ISC_PROBE2(libdns, fctx_done, fctx, result);
 
 #ifdef FCTX_TRACE
 	fprintf(stderr, "%s:%s:%u:%s(%p, %p): %s\n", func, file, line, __func__,
@@ -1837,10 +1959,10 @@ fctx__done_detach(fetchctx_t **fctxp, isc_result_t result, const char *file,
 	UNUSED(func);
 #endif
 
-	LOCK(&fctx->bucket->lock);
+	LOCK(&fctx->lock);
 	INSIST(fctx->state != fetchstate_done);
 	fctx->state = fetchstate_done;
-	UNLOCK(&fctx->bucket->lock);
+	UNLOCK(&fctx->lock);
 
 	if (result == ISC_R_SUCCESS) {
 		if (fctx->qmin_warning != ISC_R_SUCCESS) {
@@ -1872,11 +1994,11 @@ fctx__done_detach(fetchctx_t **fctxp, isc_result_t result, const char *file,
 	fctx_cancelqueries(fctx, no_response, age_untried);
 	fctx_stoptimer(fctx);
 
-	LOCK(&fctx->bucket->lock);
+	LOCK(&fctx->lock);
 	FCTX_ATTR_CLR(fctx, FCTX_ATTR_ADDRWAIT);
 	fctx_sendevents(fctx, result, line);
 	fctx_shutdown(fctx);
-	UNLOCK(&fctx->bucket->lock);
+	UNLOCK(&fctx->lock);
 
 	fctx_detach(fctxp);
 }
@@ -2054,7 +2176,7 @@ resquery_timeout(resquery_t *query) {
 	/*
 	 * Send the TRYSTALE events.
 	 */
-	LOCK(&fctx->bucket->lock);
+	LOCK(&fctx->lock);
 	for (event = ISC_LIST_HEAD(fctx->events); event != NULL; event = next) {
 		isc_task_t *sender = NULL;
 
@@ -2069,7 +2191,7 @@ resquery_timeout(resquery_t *query) {
 		event->result = ISC_R_TIMEDOUT;
 		isc_task_sendanddetach(&sender, ISC_EVENT_PTR(&event));
 	}
-	UNLOCK(&fctx->bucket->lock);
+	UNLOCK(&fctx->lock);
 
 	/*
 	 * If the next timeout is more than 1ms in the future,
@@ -2084,9 +2206,43 @@ resquery_timeout(resquery_t *query) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * The expected time a query to a forwarder takes: its smoothed RTT, plus
+ * the cost of a timeout weighted by its recent failure rate, so that a
+ * forwarder which drops some of its queries ranks behind one which is
+ * a little slower but answers them all.
+ */
+static uint64_t
+forwarder_cost(dns_adbaddrinfo_t *addrinfo) {
+	return ((uint64_t)addrinfo->srtt +
+		(uint64_t)addrinfo->failrate * FORWARDER_TIMEOUT_COST_US /
+			DNS_ADB_FAILRATE_ONE);
+}
+
+/*
+ * Check whether 'addrinfo' can't be sent another query: it is over its
+ * fetches-per-server quota, or it is a forwarder that already has as
+ * many queries in flight as max-queries-per-forwarder allows.
+ */
+static bool
+fctx_overquota(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo) {
+	unsigned int maxfwdqueries = fctx->res->maxfwdqueries;
+
+	if (dns_adbentry_overquota(addrinfo->entry)) {
+		return (true);
+	}
+	if (maxfwdqueries != 0 && ISFORWARDER(addrinfo) &&
+	    dns_adbentry_inflight(addrinfo->entry) >= maxfwdqueries)
+	{
+		inc_stats(fctx->res, dns_resstatscounter_forwarderquota);
+		return (true);
+	}
+	return (false);
+}
+
 static isc_result_t
-fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
-	   unsigned int options) {
+fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo, unsigned int options,
+	   bool hedge) {
 	isc_result_t result;
 	dns_resolver_t *res = NULL;
 	resquery_t *query = NULL;
@@ -2202,9 +2358,18 @@ fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 			query->dscp = dscp;
 		}
 
-		result = dns_dispatch_createtcp(res->dispatchmgr, &addr,
-						&addrinfo->sockaddr,
-						query->dscp, &query->dispatch);
+		/*
+		 * Pipeline the query over an existing connection to the
+		 * server if there is one, e.g. one kept in the idle pool.
+		 */
+		result = dns_dispatch_gettcp(
+			res->dispatchmgr, &addrinfo->sockaddr, &addr,
+			&(bool){ false }, &query->dispatch);
+		if (result != ISC_R_SUCCESS) {
+			result = dns_dispatch_createtcp(
+				res->dispatchmgr, &addr, &addrinfo->sockaddr,
+				query->dscp, &query->dispatch);
+		}
 		if (result != ISC_R_SUCCESS) {
 			goto cleanup_query;
 		}
@@ -2264,9 +2429,12 @@ fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 	fctx_attach(fctx, &query->fctx);
 	ISC_LINK_INIT(query, link);
 	query->magic = QUERY_MAGIC;
+	if (hedge) {
+		query->attributes |= RESQUERY_ATTR_HEDGE;
+	}
 
 	if ((query->options & DNS_FETCHOPT_TCP) == 0) {
-		if (dns_adbentry_overquota(addrinfo->entry)) {
+		if (fctx_overquota(fctx, addrinfo)) {
 			result = ISC_R_QUOTA;
 			goto cleanup_dispatch;
 		}
@@ -2275,10 +2443,10 @@ fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 		dns_adb_beginudpfetch(fctx->adb, addrinfo);
 	}
 
-	LOCK(&fctx->bucket->lock);
+	LOCK(&fctx->lock);
 	ISC_LIST_APPEND(fctx->queries, query, link);
 	atomic_fetch_add_relaxed(&fctx->nqueries, 1);
-	UNLOCK(&fctx->bucket->lock);
+	UNLOCK(&fctx->lock);
 
 	/* Set up the dispatch and set the query ID */
 	result = dns_dispatch_add(
@@ -2423,7 +2591,8 @@ compute_cc(const resquery_t *query, uint8_t *cookie, const size_t len) {
 	size_t buflen = add_serveraddr(buf, sizeof(buf), query);
 
 	uint8_t digest[ISC_SIPHASH24_TAG_LENGTH] ISC_NONSTRING = { 0 };
-	isc_siphash24(query->fctx->res->view->secret, buf, buflen, digest);
+	isc_siphash24(query->fctx->res->view->secret, buf, buflen, true,
+		      digest);
 	memmove(cookie, digest, CLIENT_COOKIE_SIZE);
 }
 
@@ -2846,6 +3015,7 @@ resquery_send(resquery_t *query) {
 	isc_buffer_usedregion(&buffer, &r);
 
 	resquery_attach(query, &(resquery_t *){ NULL });
+	ISC_PROBE3(libdns, resquery_send, fctx, query, r.length);
 	dns_dispatch_send(query->dispentry, &r, query->dscp);
 
 	QTRACE("sent");
@@ -2945,6 +3115,8 @@ resquery_connected(isc_result_t eresult, isc_region_t *region, void *arg) {
 		}
 
 		fctx->querysent++;
+		dns_adb_servercount(fctx->adb, query->addrinfo,
+				    dns_adbserver_queries);
 
 		pf = isc_sockaddr_pf(&query->addrinfo->sockaddr);
 		if (pf == PF_INET) {
@@ -3014,7 +3186,7 @@ fctx_finddone(isc_task_t *task, isc_event_t *event) {
 
 	FCTXTRACE("finddone");
 
-	LOCK(&fctx->bucket->lock);
+	LOCK(&fctx->lock);
 	pending = atomic_fetch_sub_release(&fctx->pending, 1);
 	INSIST(pending > 0);
 
@@ -3041,7 +3213,7 @@ fctx_finddone(isc_task_t *task, isc_event_t *event) {
 	}
 
 	isc_event_free(&event);
-	UNLOCK(&fctx->bucket->lock);
+	UNLOCK(&fctx->lock);
 
 	dns_adb_destroyfind(&find);
 
@@ -3637,10 +3809,11 @@ fctx_getaddresses(fetchctx_t *fctx, bool badcache) {
 		result = dns_adb_findaddrinfo(fctx->adb, &fwd->addr, &ai, 0);
 		if (result == ISC_R_SUCCESS) {
 			dns_adbaddrinfo_t *cur;
+			uint64_t cost = forwarder_cost(ai);
 			ai->flags |= FCTX_ADDRINFO_FORWARDER;
 			ai->dscp = fwd->dscp;
 			cur = ISC_LIST_HEAD(fctx->forwaddrs);
-			while (cur != NULL && cur->srtt < ai->srtt) {
+			while (cur != NULL && forwarder_cost(cur) < cost) {
 				cur = ISC_LIST_NEXT(cur, publink);
 			}
 			if (cur != NULL) {
@@ -4068,6 +4241,94 @@ fctx_nextaddress(fetchctx_t *fctx) {
 	return (addrinfo);
 }
 
+/*
+ * Arm the hedge timer after a query to 'addrinfo' has been sent, unless
+ * the fetch has already sent as many hedged queries as it may.
+ */
+static void
+fctx_starthedge(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo) {
+	isc_interval_t interval;
+	uint64_t us;
+
+	if (fctx->hedgetimer == NULL || fctx->hedges >= fctx->res->maxhedges ||
+	    (fctx->options & DNS_FETCHOPT_TCP) != 0)
+	{
+		return;
+	}
+
+	/*
+	 * Give the server the time within which nearly all of its answers
+	 * arrive: its smoothed RTT plus four times their mean deviation,
+	 * as for a TCP retransmission timer, or until that deviation is
+	 * known, twice its smoothed RTT.  If the query would time out
+	 * first anyway, the retry logic will move on without our help.
+	 */
+	if (addrinfo->rttvar != 0) {
+		us = (uint64_t)addrinfo->srtt + 4 * (uint64_t)addrinfo->rttvar;
+	} else {
+		us = 2 * (uint64_t)addrinfo->srtt;
+	}
+	us = ISC_MAX(us, HEDGE_MIN_DELAY_US);
+	if (us / US_PER_MSEC >= isc_interval_ms(&fctx->interval)) {
+		return;
+	}
+
+	isc_interval_set(&interval, us / US_PER_SEC,
+			 (us % US_PER_SEC) * NS_PER_US);
+	isc_timer_start(fctx->hedgetimer, isc_timertype_once, &interval);
+}
+
+/*
+ * The server queried has not answered in the time it usually takes:
+ * query the next best server as well, keeping the first query in
+ * flight, and let whichever answers first win.
+ */
+static void
+fctx_hedge(void *arg) {
+	fetchctx_t *fctx = (fetchctx_t *)arg;
+	dns_adbaddrinfo_t *addrinfo = NULL;
+	isc_result_t result;
+	bool inflight;
+
+	REQUIRE(VALID_FCTX(fctx));
+
+	LOCK(&fctx->lock);
+	inflight = !ISC_LIST_EMPTY(fctx->queries);
+	UNLOCK(&fctx->lock);
+
+	if (!inflight || fctx->state != fetchstate_active ||
+	    atomic_load_acquire(&fctx->want_shutdown) || ADDRWAIT(fctx) ||
+	    (fctx->minimized && !fctx->forwarding) ||
+	    !ISC_LIST_EMPTY(fctx->validators))
+	{
+		return;
+	}
+
+	addrinfo = fctx_nextaddress(fctx);
+	while (addrinfo != NULL && fctx_overquota(fctx, addrinfo)) {
+		addrinfo = fctx_nextaddress(fctx);
+	}
+	if (addrinfo == NULL) {
+		FCTXTRACE("no server left to hedge");
+		return;
+	}
+
+	if (isc_counter_increment(fctx->qc) != ISC_R_SUCCESS) {
+		return;
+	}
+
+	result = fctx_query(fctx, addrinfo, fctx->options, true);
+	if (result != ISC_R_SUCCESS) {
+		FCTXTRACE3("hedged query failed", result);
+		return;
+	}
+
+	FCTXTRACE("hedged query sent");
+	fctx->hedges++;
+	inc_stats(fctx->res, dns_resstatscounter_hedgesent);
+	fctx_starthedge(fctx, addrinfo);
+}
+
 static void
 fctx_try(fetchctx_t *fctx, bool retrying, bool badcache) {
 	isc_result_t result;
@@ -4095,7 +4356,7 @@ fctx_try(fetchctx_t *fctx, bool retrying, bool badcache) {
 	addrinfo = fctx_nextaddress(fctx);
 
 	/* Try to find an address that isn't over quota */
-	while (addrinfo != NULL && dns_adbentry_overquota(addrinfo->entry)) {
+	while (addrinfo != NULL && fctx_overquota(fctx, addrinfo)) {
 		addrinfo = fctx_nextaddress(fctx);
 	}
 
@@ -4121,8 +4382,7 @@ fctx_try(fetchctx_t *fctx, bool retrying, bool badcache) {
 
 		addrinfo = fctx_nextaddress(fctx);
 
-		while (addrinfo != NULL &&
-		       dns_adbentry_overquota(addrinfo->entry)) {
+		while (addrinfo != NULL && fctx_overquota(fctx, addrinfo)) {
 			addrinfo = fctx_nextaddress(fctx);
 		}
 
@@ -4144,10 +4404,14 @@ fctx_try(fetchctx_t *fctx, bool retrying, bool badcache) {
 		/*
 		 * Also clear DNS_FETCHOPT_TRYSTALE_ONTIMEOUT here,
 		 * otherwise every query minimization step will activate
-		 * the try-stale timer again.
+		 * the try-stale timer again.  The options that don't
+		 * change the answer are cleared too, so that the same
+		 * step of concurrent fetches for names under the same
+		 * domain is shared.
 		 */
 		options &= ~(DNS_FETCHOPT_QMINIMIZE |
-			     DNS_FETCHOPT_TRYSTALE_ONTIMEOUT);
+			     DNS_FETCHOPT_TRYSTALE_ONTIMEOUT |
+			     DNS_FETCHOPT_PREFETCH | DNS_FETCHOPT_WANTNSID);
 
 		/*
 		 * Is another QNAME minimization fetch still running?
@@ -4207,12 +4471,15 @@ fctx_try(fetchctx_t *fctx, bool retrying, bool badcache) {
 		return;
 	}
 
-	result = fctx_query(fctx, addrinfo, fctx->options);
+	result = fctx_query(fctx, addrinfo, fctx->options, false);
 	if (result != ISC_R_SUCCESS) {
 		fctx_done_detach(&fctx, result);
-	} else if (retrying) {
+		return;
+	}
+	if (retrying) {
 		inc_stats(res, dns_resstatscounter_retry);
 	}
+	fctx_starthedge(fctx, addrinfo);
 }
 
 static void
@@ -4254,14 +4521,14 @@ resume_qmin(isc_task_t *task, isc_event_t *event) {
 
 	dns_resolver_destroyfetch(&fctx->qminfetch);
 
-	LOCK(&fctx->bucket->lock);
+	LOCK(&fctx->lock);
 	if (SHUTTINGDOWN(fctx)) {
 		maybe_cancel_validators(fctx);
-		UNLOCK(&fctx->bucket->lock);
+		UNLOCK(&fctx->lock);
 		fctx_detach(&fctx);
 		return;
 	}
-	UNLOCK(&fctx->bucket->lock);
+	UNLOCK(&fctx->lock);
 
 	if (result == ISC_R_CANCELED) {
 		goto cleanup;
@@ -4359,7 +4626,8 @@ fctx_destroy(fetchctx_t *fctx) {
 	dns_resolver_t *res = NULL;
 	isc_sockaddr_t *sa = NULL, *next_sa = NULL;
 	struct tried *tried = NULL;
-	fctxbucket_t *bucket = NULL;
+	fetchctx_t *found = NULL;
+	isc_result_t result;
 	uint_fast32_t nfctx;
 
 	REQUIRE(VALID_FCTX(fctx));
@@ -4375,18 +4643,30 @@ fctx_destroy(fetchctx_t *fctx) {
 	fctx->magic = 0;
 
 	res = fctx->res;
-	bucket = fctx->bucket;
 
 	dec_stats(res, dns_resstatscounter_nfetch);
 
-	LOCK(&bucket->lock);
 	REQUIRE(fctx->state != fetchstate_active);
-	ISC_LIST_UNLINK(bucket->fctxs, fctx, link);
+
+	/*
+	 * A context that lost the race to be added to the table must not
+	 * remove the one that won it.
+	 */
+	RWLOCK(&res->fctxtable->lock, isc_rwlocktype_write);
+	result = isc_hashmap_find(res->fctxtable->fctxs, fctx->key,
+				  fctx->keysize, (void **)&found);
+	if (result == ISC_R_SUCCESS && found == fctx) {
+		result = isc_hashmap_delete(res->fctxtable->fctxs, fctx->key,
+					    fctx->keysize);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+	RWUNLOCK(&res->fctxtable->lock, isc_rwlocktype_write);
+
 	nfctx = atomic_fetch_sub_release(&res->nfctx, 1);
 	INSIST(nfctx > 0);
-	UNLOCK(&bucket->lock);
 
 	isc_refcount_destroy(&fctx->references);
+	isc_mutex_destroy(&fctx->lock);
 
 	/*
 	 * Free bad.
@@ -4420,6 +4700,9 @@ fctx_destroy(fetchctx_t *fctx) {
 	dns_adb_detach(&fctx->adb);
 
 	isc_timer_destroy(&fctx->timer);
+	if (fctx->hedgetimer != NULL) {
+		isc_timer_destroy(&fctx->hedgetimer);
+	}
 
 	dns_resolver_detach(&fctx->res);
 
@@ -4475,7 +4758,7 @@ fctx_doshutdown(isc_task_t *task, isc_event_t *event) {
 
 	/*
 	 * Cancel all pending validators.  Note that this must be done
-	 * without the bucket lock held, since that could cause
+	 * without the fctx lock held, since that could cause
 	 * deadlock.
 	 */
 	validator = ISC_LIST_HEAD(fctx->validators);
@@ -4495,13 +4778,13 @@ fctx_doshutdown(isc_task_t *task, isc_event_t *event) {
 	/*
 	 * Shut down anything still running on behalf of this
 	 * fetch, and clean up finds and addresses.  To avoid deadlock
-	 * with the ADB, we must do this before we lock the bucket lock.
+	 * with the ADB, we must do this before we lock the fctx lock.
 	 * Increment the fctx references to avoid a race.
 	 */
 	fctx_cancelqueries(fctx, false, false);
 	fctx_cleanup(fctx);
 
-	LOCK(&fctx->bucket->lock);
+	LOCK(&fctx->lock);
 
 	FCTX_ATTR_SET(fctx, FCTX_ATTR_SHUTTINGDOWN);
 
@@ -4517,7 +4800,7 @@ fctx_doshutdown(isc_task_t *task, isc_event_t *event) {
 		fctx_unref(fctx);
 	}
 
-	UNLOCK(&fctx->bucket->lock);
+	UNLOCK(&fctx->lock);
 
 	fctx_detach(&fctx);
 }
@@ -4545,7 +4828,7 @@ fctx_start(isc_task_t *task, isc_event_t *event) {
 
 	FCTXTRACE("start");
 
-	LOCK(&fctx->bucket->lock);
+	LOCK(&fctx->lock);
 
 	/*
 	 * Create an inactive timer to enforce maximum query
@@ -4553,6 +4836,10 @@ fctx_start(isc_task_t *task, isc_event_t *event) {
 	 * started.
 	 */
 	isc_timer_create(fctx->loop, fctx_expired, fctx, &fctx->timer);
+	if (fctx->res->maxhedges > 0) {
+		isc_timer_create(fctx->loop, fctx_hedge, fctx,
+				 &fctx->hedgetimer);
+	}
 
 	INSIST(fctx->state == fetchstate_init);
 	if (atomic_load_acquire(&fctx->want_shutdown)) {
@@ -4565,7 +4852,7 @@ fctx_start(isc_task_t *task, isc_event_t *event) {
 		INSIST(atomic_load_acquire(&fctx->pending) == 0);
 		INSIST(atomic_load_acquire(&fctx->nqueries) == 0);
 		INSIST(ISC_LIST_EMPTY(fctx->validators));
-		UNLOCK(&fctx->bucket->lock);
+		UNLOCK(&fctx->lock);
 
 		FCTX_ATTR_SET(fctx, FCTX_ATTR_SHUTTINGDOWN);
 
@@ -4587,7 +4874,7 @@ fctx_start(isc_task_t *task, isc_event_t *event) {
 	ISC_EVENT_INIT(event, sizeof(*event), 0, DNS_EVENT_FETCHCONTROL,
 		       fctx_doshutdown, fctx, NULL, NULL, NULL);
 
-	UNLOCK(&fctx->bucket->lock);
+	UNLOCK(&fctx->lock);
 
 	/*
 	 * As a backstop, we also set a timer to stop the fetch
@@ -4676,8 +4963,7 @@ static isc_result_t
 fctx_create(dns_resolver_t *res, const dns_name_t *name, dns_rdatatype_t type,
 	    const dns_name_t *domain, dns_rdataset_t *nameservers,
 	    const isc_sockaddr_t *client, unsigned int options,
-	    fctxbucket_t *bucket, unsigned int depth, isc_counter_t *qc,
-	    fetchctx_t **fctxp) {
+	    unsigned int depth, isc_counter_t *qc, fetchctx_t **fctxp) {
 	fetchctx_t *fctx = NULL;
 	isc_result_t result;
 	isc_result_t iresult;
@@ -4688,9 +4974,6 @@ fctx_create(dns_resolver_t *res, const dns_name_t *name, dns_rdatatype_t type,
 	uint_fast32_t nfctx;
 	size_t p;
 
-	/*
-	 * Caller must be holding the lock for 'bucket'
-	 */
 	REQUIRE(fctxp != NULL && *fctxp == NULL);
 
 	fctx = isc_mem_get(res->mctx, sizeof(*fctx));
@@ -4698,7 +4981,6 @@ fctx_create(dns_resolver_t *res, const dns_name_t *name, dns_rdatatype_t type,
 		.type = type,
 		.qmintype = type,
 		.options = options,
-		.bucket = bucket,
 		.tid = tid,
 		.restask = res->tasks[tid],
 		.state = fetchstate_init,
@@ -4733,6 +5015,7 @@ fctx_create(dns_resolver_t *res, const dns_name_t *name, dns_rdatatype_t type,
 	fctx->info = isc_mem_strdup(res->mctx, buf);
 
 	FCTXTRACE("create");
+	ISC_PROBE3(libdns, fctx_create, fctx, fctx->info, type);
 
 	isc_refcount_init(&fctx->references, 1);
 
@@ -4938,7 +5221,10 @@ fctx_create(dns_resolver_t *res, const dns_name_t *name, dns_rdatatype_t type,
 		}
 	}
 
-	ISC_LIST_APPEND(bucket->fctxs, fctx, link);
+	isc_mutex_init(&fctx->lock);
+	fctx->keysize = fctx_makekey(
+		fctx->key, fctx->name, fctx->type, fctx->options,
+		(fctx->options & DNS_FETCHOPT_UNSHARED) != 0 ? fctx : NULL);
 
 	nfctx = atomic_fetch_add_relaxed(&res->nfctx, 1);
 	INSIST(nfctx < UINT32_MAX);
@@ -5216,7 +5502,7 @@ clone_results(fetchctx_t *fctx) {
 /*
  * Cancel validators associated with '*fctx' if it is ready to be
  * destroyed (i.e., no queries waiting for it and no pending ADB finds).
- * Caller must hold fctx bucket lock.
+ * Caller must hold the fctx lock.
  *
  * Requires:
  *      '*fctx' is shutting down.
@@ -5387,11 +5673,12 @@ validated(isc_task_t *task, isc_event_t *event) {
 
 	vevent = (dns_validatorevent_t *)event;
 	fctx->vresult = vevent->result;
+	ISC_PROBE2(libdns, validated, fctx, vevent->result);
 
-	LOCK(&fctx->bucket->lock);
+	LOCK(&fctx->lock);
 	ISC_LIST_UNLINK(fctx->validators, vevent->validator, link);
 	fctx->validator = NULL;
-	UNLOCK(&fctx->bucket->lock);
+	UNLOCK(&fctx->lock);
 
 	/*
 	 * Destroy the validator early so that we can
@@ -5407,7 +5694,7 @@ validated(isc_task_t *task, isc_event_t *event) {
 
 	negative = (vevent->rdataset == NULL);
 
-	LOCK(&fctx->bucket->lock);
+	LOCK(&fctx->lock);
 	sentresponse = ((fctx->options & DNS_FETCHOPT_NOVALIDATE) != 0);
 
 	/*
@@ -5416,7 +5703,7 @@ validated(isc_task_t *task, isc_event_t *event) {
 	 * events; if so, destroy the fctx.
 	 */
 	if (SHUTTINGDOWN(fctx) && !sentresponse) {
-		UNLOCK(&fctx->bucket->lock);
+		UNLOCK(&fctx->lock);
 		fctx_detach(&fctx);
 		goto cleanup_event;
 	}
@@ -5520,7 +5807,7 @@ validated(isc_task_t *task, isc_event_t *event) {
 		dns_message_detach(&message);
 		isc_event_free(&event);
 
-		UNLOCK(&fctx->bucket->lock);
+		UNLOCK(&fctx->lock);
 		INSIST(fctx->validator == NULL);
 
 		fctx->validator = ISC_LIST_HEAD(fctx->validators);
@@ -5530,7 +5817,7 @@ validated(isc_task_t *task, isc_event_t *event) {
 		} else if (sentresponse) {
 			/* Detach the extra ref that was set in valcreate() */
 			fctx_unref(fctx);
-			fctx_done_detach(&fctx, result); /* Locks bucket */
+			fctx_done_detach(&fctx, result); /* Locks fctx */
 		} else if (result == DNS_R_BROKENCHAIN) {
 			isc_result_t tresult;
 			isc_time_t expire;
@@ -5549,9 +5836,9 @@ validated(isc_task_t *task, isc_event_t *event) {
 
 			/* Detach the extra ref that was set in valcreate() */
 			fctx_unref(fctx);
-			fctx_done_detach(&fctx, result); /* Locks bucket */
+			fctx_done_detach(&fctx, result); /* Locks fctx */
 		} else {
-			fctx_try(fctx, true, true); /* Locks bucket */
+			fctx_try(fctx, true, true); /* Locks fctx */
 			fctx_detach(&fctx);
 		}
 		return;
@@ -5676,7 +5963,7 @@ validated(isc_task_t *task, isc_event_t *event) {
 		if (SHUTTINGDOWN(fctx)) {
 			maybe_cancel_validators(fctx);
 		}
-		UNLOCK(&fctx->bucket->lock);
+		UNLOCK(&fctx->lock);
 		fctx_detach(&fctx);
 		goto cleanup_event;
 	}
@@ -5692,7 +5979,7 @@ validated(isc_task_t *task, isc_event_t *event) {
 		 * be validated.
 		 */
 		dns_db_detachnode(fctx->cache, &node);
-		UNLOCK(&fctx->bucket->lock);
+		UNLOCK(&fctx->lock);
 		dns_validator_send(ISC_LIST_HEAD(fctx->validators));
 		fctx_detach(&fctx);
 		goto cleanup_event;
@@ -5701,7 +5988,8 @@ validated(isc_task_t *task, isc_event_t *event) {
 answer_response:
 
 	/*
-	 * Cache any SOA/NS/NSEC records that happened to be validated.
+	 * Cache any SOA/NS/NSEC records that happened to be validated,
+	 * and index the NSEC3 ones.
 	 */
 	result = dns_message_firstname(message, DNS_SECTION_AUTHORITY);
 	while (result == ISC_R_SUCCESS) {
@@ -5712,7 +6000,8 @@ answer_response:
 		{
 			if ((rdataset->type != dns_rdatatype_ns &&
 			     rdataset->type != dns_rdatatype_soa &&
-			     rdataset->type != dns_rdatatype_nsec) ||
+			     rdataset->type != dns_rdatatype_nsec &&
+			     rdataset->type != dns_rdatatype_nsec3) ||
 			    rdataset->trust != dns_trust_secure)
 			{
 				continue;
@@ -5733,6 +6022,21 @@ answer_response:
 				continue;
 			}
 
+			/*
+			 * NSEC3 records aren't looked up by name; their
+			 * ranges go to the view's index instead.
+			 */
+			if (rdataset->type == dns_rdatatype_nsec3) {
+				if (res->view->synthfromdnssec &&
+				    res->view->nsec3index != NULL)
+				{
+					(void)dns_nsec3index_add(
+						res->view->nsec3index, name,
+						rdataset, now);
+				}
+				continue;
+			}
+
 			/*
 			 * Don't cache NSEC if missing NSEC or RRSIG types.
 			 */
@@ -5850,10 +6154,10 @@ noanswer_response:
 		dns_db_detachnode(fctx->cache, &node);
 	}
 
-	UNLOCK(&fctx->bucket->lock);
+	UNLOCK(&fctx->lock);
 	/* Detach the extra reference that was set in valcreate() */
 	fctx_unref(fctx);
-	fctx_done_detach(&fctx, result); /* Locks bucket. */
+	fctx_done_detach(&fctx, result); /* Locks fctx. */
 
 cleanup_event:
 	INSIST(node == NULL);
@@ -6031,7 +6335,7 @@ cache_name(fetchctx_t *fctx, dns_name_t *name, dns_message_t *message,
 	FCTXTRACE("cache_name");
 
 	/*
-	 * The appropriate bucket lock must be held.
+	 * The fctx lock must be held.
 	 */
 
 	/*
@@ -6495,7 +6799,7 @@ cache_message(fetchctx_t *fctx, dns_message_t *message,
 
 	FCTX_ATTR_CLR(fctx, FCTX_ATTR_WANTCACHE);
 
-	LOCK(&fctx->bucket->lock);
+	LOCK(&fctx->lock);
 
 	for (section = DNS_SECTION_ANSWER; section <= DNS_SECTION_ADDITIONAL;
 	     section++) {
@@ -6520,7 +6824,7 @@ cache_message(fetchctx_t *fctx, dns_message_t *message,
 		result = ISC_R_SUCCESS;
 	}
 
-	UNLOCK(&fctx->bucket->lock);
+	UNLOCK(&fctx->lock);
 
 	return (result);
 }
@@ -6678,7 +6982,7 @@ ncache_message(fetchctx_t *fctx, dns_message_t *message,
 		return (result);
 	}
 
-	LOCK(&fctx->bucket->lock);
+	LOCK(&fctx->lock);
 
 	if (!HAVE_ANSWER(fctx)) {
 		event = ISC_LIST_HEAD(fctx->events);
@@ -6731,7 +7035,7 @@ ncache_message(fetchctx_t *fctx, dns_message_t *message,
 	}
 
 unlock:
-	UNLOCK(&fctx->bucket->lock);
+	UNLOCK(&fctx->lock);
 
 	if (node != NULL) {
 		dns_db_detachnode(fctx->cache, &node);
@@ -7277,10 +7581,10 @@ resume_dslookup(isc_task_t *task, isc_event_t *event) {
 	result = fevent->result;
 	isc_event_free(&event);
 
-	LOCK(&fctx->bucket->lock);
+	LOCK(&fctx->lock);
 	if (SHUTTINGDOWN(fctx)) {
 		maybe_cancel_validators(fctx);
-		UNLOCK(&fctx->bucket->lock);
+		UNLOCK(&fctx->lock);
 
 		if (dns_rdataset_isassociated(frdataset)) {
 			dns_rdataset_disassociate(frdataset);
@@ -7290,7 +7594,7 @@ resume_dslookup(isc_task_t *task, isc_event_t *event) {
 		fctx_detach(&fctx);
 		return;
 	}
-	UNLOCK(&fctx->bucket->lock);
+	UNLOCK(&fctx->lock);
 
 	/*
 	 * Detach the extra reference that was set in rctx_chaseds()
@@ -7545,6 +7849,7 @@ resquery_response(isc_result_t eresult, isc_region_t *region, void *arg) {
 	REQUIRE(VALID_FCTX(fctx));
 
 	QTRACE("response");
+	ISC_PROBE3(libdns, resquery_response, fctx, query, eresult);
 
 	if (eresult == ISC_R_TIMEDOUT) {
 		result = resquery_timeout(query);
@@ -7798,6 +8103,8 @@ resquery_response(isc_result_t eresult, isc_region_t *region, void *arg) {
 		} else {
 			rctx.retryopts |= DNS_FETCHOPT_TCP;
 			rctx.resend = true;
+			dns_adb_servercount(fctx->adb, query->addrinfo,
+					    dns_adbserver_tcpretries);
 		}
 		FCTXTRACE3("message truncated", result);
 		rctx_done(&rctx, result);
@@ -8172,6 +8479,8 @@ rctx_parse(respctx_t *rctx) {
 			rctx->resend = true;
 			add_bad_edns(fctx, &query->addrinfo->sockaddr);
 			inc_stats(fctx->res, dns_resstatscounter_edns0fail);
+			dns_adb_servercount(fctx->adb, query->addrinfo,
+					    dns_adbserver_ednsfallbacks);
 		} else {
 			rctx->broken_server = result;
 			rctx->next_server = true;
@@ -8190,6 +8499,8 @@ rctx_parse(respctx_t *rctx) {
 			rctx->resend = true;
 			add_bad_edns(fctx, &query->addrinfo->sockaddr);
 			inc_stats(fctx->res, dns_resstatscounter_edns0fail);
+			dns_adb_servercount(fctx->adb, query->addrinfo,
+					    dns_adbserver_ednsfallbacks);
 		} else {
 			rctx->broken_server = DNS_R_UNEXPECTEDRCODE;
 			rctx->next_server = true;
@@ -9704,7 +10015,8 @@ rctx_resend(respctx_t *rctx, dns_adbaddrinfo_t *addrinfo) {
 
 	FCTXTRACE("resend");
 	inc_stats(fctx->res, dns_resstatscounter_retry);
-	result = fctx_query(fctx, addrinfo, rctx->retryopts);
+	result = fctx_query(fctx, addrinfo, rctx->retryopts,
+			    RESQUERY_HEDGE(rctx->query));
 	if (result != ISC_R_SUCCESS) {
 		fctx_done_detach(&rctx->fctx, result);
 	}
@@ -9811,17 +10123,26 @@ rctx_done(respctx_t *rctx, isc_result_t result) {
 		}
 	}
 
+	/*
+	 * A hedged query whose answer is used has won the race.
+	 */
+	if (RESQUERY_HEDGE(query) && !rctx->no_response &&
+	    !rctx->next_server && !rctx->resend && !rctx->nextitem)
+	{
+		inc_stats(fctx->res, dns_resstatscounter_hedgewon);
+	}
+
 	/* Cancel the query */
 	fctx_cancelquery(&query, rctx->finish, rctx->no_response, false);
 
 	/*
 	 * If nobody's waiting for results, don't resend.
 	 */
-	LOCK(&fctx->bucket->lock);
+	LOCK(&fctx->lock);
 	if (ISC_LIST_EMPTY(fctx->events)) {
 		rctx->resend = false;
 	}
-	UNLOCK(&fctx->bucket->lock);
+	UNLOCK(&fctx->lock);
 
 	if (rctx->next_server) {
 		rctx_nextserver(rctx, message, addrinfo, result);
@@ -9936,6 +10257,8 @@ rctx_badserver(respctx_t *rctx, isc_result_t result) {
 		 */
 		add_bad_edns(fctx, &query->addrinfo->sockaddr);
 		inc_stats(fctx->res, dns_resstatscounter_edns0fail);
+		dns_adb_servercount(fctx->adb, query->addrinfo,
+				    dns_adbserver_ednsfallbacks);
 	} else if (rcode == dns_rcode_formerr) {
 		/*
 		 * The server (or forwarder) doesn't understand us,
@@ -10086,6 +10409,40 @@ rctx_delonly_zone(respctx_t *rctx) {
 /***
  *** Resolver Methods
  ***/
+static void
+fctxtable_create(isc_mem_t *mctx, fctxtable_t **tablep) {
+	fctxtable_t *table = isc_mem_get(mctx, sizeof(*table));
+
+	*table = (fctxtable_t){ 0 };
+	isc_mem_attach(mctx, &table->mctx);
+	isc_refcount_init(&table->references, 1);
+	isc_rwlock_init(&table->lock, 0, 0);
+	isc_hashmap_create(mctx, RES_DOMAIN_HASH_BITS,
+			   ISC_HASHMAP_CASE_SENSITIVE, &table->fctxs);
+
+	*tablep = table;
+}
+
+static void
+fctxtable_attach(fctxtable_t *source, fctxtable_t **targetp) {
+	isc_refcount_increment(&source->references);
+	*targetp = source;
+}
+
+static void
+fctxtable_detach(fctxtable_t **tablep) {
+	fctxtable_t *table = *tablep;
+
+	*tablep = NULL;
+	if (isc_refcount_decrement(&table->references) == 1) {
+		isc_refcount_destroy(&table->references);
+		INSIST(isc_hashmap_count(table->fctxs) == 0);
+		isc_hashmap_destroy(&table->fctxs);
+		isc_rwlock_destroy(&table->lock);
+		isc_mem_putanddetach(&table->mctx, table, sizeof(*table));
+	}
+}
+
 static void
 destroy(dns_resolver_t *res) {
 	isc_result_t result;
@@ -10114,30 +10471,18 @@ destroy(dns_resolver_t *res) {
 		isc_stats_detach(&res->stats);
 	}
 
+	isc_mutex_destroy(&res->slowzoneslock);
 	isc_mutex_destroy(&res->primelock);
 	isc_mutex_destroy(&res->lock);
+	isc_mem_put(res->mctx, res->slowzones,
+		    RES_SLOWZONES * sizeof(res->slowzones[0]));
 
 	for (size_t i = 0; i < res->ntasks; i++) {
 		isc_task_detach(&res->tasks[i]);
 	}
 	isc_mem_put(res->mctx, res->tasks, res->ntasks * sizeof(res->tasks[0]));
 
-	RWLOCK(&res->hash_lock, isc_rwlocktype_write);
-	isc_ht_iter_create(res->buckets, &it);
-	for (result = isc_ht_iter_first(it); result == ISC_R_SUCCESS;
-	     result = isc_ht_iter_delcurrent_next(it))
-	{
-		fctxbucket_t *bucket = NULL;
-		isc_ht_iter_current(it, (void **)&bucket);
-
-		INSIST(ISC_LIST_EMPTY(bucket->fctxs));
-		isc_mutex_destroy(&bucket->lock);
-		isc_mem_put(res->mctx, bucket, sizeof(*bucket));
-	}
-	isc_ht_iter_destroy(&it);
-	isc_ht_destroy(&res->buckets);
-	RWUNLOCK(&res->hash_lock, isc_rwlocktype_write);
-	isc_rwlock_destroy(&res->hash_lock);
+	fctxtable_detach(&res->fctxtable);
 
 	RWLOCK(&res->zonehash_lock, isc_rwlocktype_write);
 	isc_ht_iter_create(res->zonebuckets, &it);
@@ -10283,9 +10628,7 @@ dns_resolver_create(dns_view_t *view, isc_loopmgr_t *loopmgr,
 		isc_task_setname(res->tasks[i], name, res);
 	}
 
-	isc_ht_init(&res->buckets, view->mctx, RES_DOMAIN_HASH_BITS,
-		    ISC_HT_CASE_INSENSITIVE);
-	isc_rwlock_init(&res->hash_lock, 0, 0);
+	fctxtable_create(view->mctx, &res->fctxtable);
 
 	isc_ht_init(&res->zonebuckets, view->mctx, RES_DOMAIN_HASH_BITS,
 		    ISC_HT_CASE_INSENSITIVE);
@@ -10303,6 +10646,12 @@ dns_resolver_create(dns_view_t *view, isc_loopmgr_t *loopmgr,
 
 	isc_mutex_init(&res->lock);
 	isc_mutex_init(&res->primelock);
+	isc_mutex_init(&res->slowzoneslock);
+	res->slowzones = isc_mem_get(res->mctx,
+				     RES_SLOWZONES * sizeof(res->slowzones[0]));
+	for (size_t i = 0; i < RES_SLOWZONES; i++) {
+		res->slowzones[i] = (slowzone_t){ .name = NULL };
+	}
 
 	loop = isc_loop_main(res->loopmgr);
 
@@ -10440,6 +10789,19 @@ dns_resolver_freeze(dns_resolver_t *res) {
 	res->frozen = true;
 }
 
+void
+dns_resolver_sharefetches(dns_resolver_t *res, dns_resolver_t *source) {
+	REQUIRE(VALID_RESOLVER(res));
+	REQUIRE(VALID_RESOLVER(source));
+	REQUIRE(!res->frozen);
+	REQUIRE(res->rdclass == source->rdclass);
+
+	RTRACE("sharefetches");
+
+	fctxtable_detach(&res->fctxtable);
+	fctxtable_attach(source->fctxtable, &res->fctxtable);
+}
+
 void
 dns_resolver_attach(dns_resolver_t *source, dns_resolver_t **targetp) {
 	REQUIRE(VALID_RESOLVER(source));
@@ -10463,29 +10825,39 @@ dns_resolver_shutdown(dns_resolver_t *res) {
 	RTRACE("shutdown");
 
 	if (atomic_compare_exchange_strong(&res->exiting, &is_false, true)) {
-		isc_ht_iter_t *it = NULL;
+		isc_hashmap_iter_t *it = NULL;
+		ISC_LIST(fetchctx_t) fctxs;
+		fetchctx_t *fctx = NULL;
 
 		RTRACE("exiting");
 
-		RWLOCK(&res->hash_lock, isc_rwlocktype_read);
-		isc_ht_iter_create(res->buckets, &it);
-		for (result = isc_ht_iter_first(it); result == ISC_R_SUCCESS;
-		     result = isc_ht_iter_next(it))
+		/*
+		 * Collect the contexts first, so that no fctx lock is
+		 * taken while the hash lock is held.
+		 */
+		ISC_LIST_INIT(fctxs);
+		RWLOCK(&res->fctxtable->lock, isc_rwlocktype_read);
+		isc_hashmap_iter_create(res->fctxtable->fctxs, &it);
+		for (result = isc_hashmap_iter_first(it);
+		     result == ISC_R_SUCCESS;
+		     result = isc_hashmap_iter_next(it))
 		{
-			fctxbucket_t *bucket = NULL;
-			fetchctx_t *fctx = NULL;
-
-			isc_ht_iter_current(it, (void **)&bucket);
-			LOCK(&bucket->lock);
-			for (fctx = ISC_LIST_HEAD(bucket->fctxs); fctx != NULL;
-			     fctx = ISC_LIST_NEXT(fctx, link))
-			{
-				fctx_shutdown(fctx);
+			fctx = NULL;
+			isc_hashmap_iter_current(it, (void **)&fctx);
+			if (fctx->res == res && fctx_tryref(fctx)) {
+				ISC_LIST_APPEND(fctxs, fctx, link);
 			}
-			UNLOCK(&bucket->lock);
 		}
-		isc_ht_iter_destroy(&it);
-		RWUNLOCK(&res->hash_lock, isc_rwlocktype_read);
+		isc_hashmap_iter_destroy(&it);
+		RWUNLOCK(&res->fctxtable->lock, isc_rwlocktype_read);
+
+		while ((fctx = ISC_LIST_HEAD(fctxs)) != NULL) {
+			ISC_LIST_UNLINK(fctxs, fctx, link);
+			LOCK(&fctx->lock);
+			fctx_shutdown(fctx);
+			UNLOCK(&fctx->lock);
+			fctx_unref(fctx);
+		}
 
 		isc_timer_stop(res->spillattimer);
 	}
@@ -10508,22 +10880,58 @@ dns_resolver_detach(dns_resolver_t **resp) {
 	}
 }
 
+static uint32_t
+fctx_makekey(uint8_t *key, const dns_name_t *name, dns_rdatatype_t type,
+	     unsigned int options, const fetchctx_t *unique) {
+	uint16_t ktype = type;
+	uint32_t koptions = options;
+	uint32_t size = 0;
+
+	key[size++] = (unique != NULL) ? FCTX_KEY_UNIQUE : FCTX_KEY_SHARED;
+	memmove(key + size, &ktype, sizeof(ktype));
+	size += sizeof(ktype);
+	memmove(key + size, &koptions, sizeof(koptions));
+	size += sizeof(koptions);
+	if (unique != NULL) {
+		memmove(key + size, &unique, sizeof(unique));
+		size += sizeof(unique);
+	}
+	isc_ascii_lowercopy(key + size, name->ndata, name->length);
+	size += name->length;
+
+	INSIST(size <= FCTX_KEY_MAXSIZE);
+	return (size);
+}
+
+/*
+ * Take a reference to 'fctx' unless it is already being destroyed.
+ * The caller must hold the lock of the table holding 'fctx', which
+ * keeps a context that is being destroyed from being freed until the
+ * lock is released.
+ */
+static bool
+fctx_tryref(fetchctx_t *fctx) {
+	uint_fast32_t refs = isc_refcount_current(&fctx->references);
+
+	do {
+		if (refs == 0) {
+			return (false);
+		}
+	} while (!atomic_compare_exchange_weak_acq_rel(&fctx->references,
+						       &refs, refs + 1));
+
+	return (true);
+}
+
 static bool
-fctx_match(fetchctx_t *fctx, const dns_name_t *name, dns_rdatatype_t type,
-	   unsigned int options) {
+fctx_joinable(fetchctx_t *fctx) {
 	/*
-	 * Don't match fetch contexts that are shutting down.
+	 * Don't join fetch contexts that are shutting down, including
+	 * those of another view's resolver that is exiting.
 	 */
-	if (fctx->cloned || fctx->state == fetchstate_done ||
-	    ISC_LIST_EMPTY(fctx->events))
-	{
-		return (false);
-	}
-
-	if (fctx->type != type || fctx->options != options) {
-		return (false);
-	}
-	return (dns_name_equal(fctx->name, name));
+	return (!fctx->cloned && fctx->state != fetchstate_done &&
+		!ISC_LIST_EMPTY(fctx->events) &&
+		!atomic_load_acquire(&fctx->res->exiting));
 }
 
 static void
@@ -10548,6 +10956,38 @@ log_fetch(const dns_name_t *name, dns_rdatatype_t type) {
 		      typebuf);
 }
 
+/*
+ * Check whether the cache already holds the answer to the minimized
+ * query 'fctx' is about to send, showing that there is no zone cut at
+ * the minimized name: a NODATA answer to the NS query, or, in "_ A"
+ * mode, any negative answer.  A referral would have been cached as a
+ * delegation and found before minimizing.
+ */
+static bool
+qmin_cached(fetchctx_t *fctx) {
+	dns_fixedname_t fixed;
+	dns_name_t *fname = dns_fixedname_initname(&fixed);
+	dns_rdataset_t rdataset;
+	isc_result_t result;
+
+	dns_rdataset_init(&rdataset);
+	result = dns_db_find(fctx->cache, fctx->qminname, NULL,
+			     fctx->qmintype, 0, fctx->now, NULL, fname,
+			     &rdataset, NULL);
+	if (dns_rdataset_isassociated(&rdataset)) {
+		dns_rdataset_disassociate(&rdataset);
+	}
+
+	switch (result) {
+	case DNS_R_NCACHENXRRSET:
+		return (true);
+	case DNS_R_NCACHENXDOMAIN:
+		return ((fctx->options & DNS_FETCHOPT_QMIN_USE_A) != 0);
+	default:
+		return (false);
+	}
+}
+
 static isc_result_t
 fctx_minimize_qname(fetchctx_t *fctx) {
 	isc_result_t result = ISC_R_SUCCESS;
@@ -10555,6 +10995,7 @@ fctx_minimize_qname(fetchctx_t *fctx) {
 
 	REQUIRE(VALID_FCTX(fctx));
 
+again:
 	dlabels = dns_name_countlabels(fctx->qmindcname);
 	nlabels = dns_name_countlabels(fctx->name);
 
@@ -10618,6 +11059,15 @@ fctx_minimize_qname(fetchctx_t *fctx) {
 			fctx->qmintype = dns_rdatatype_ns;
 		}
 		fctx->minimized = true;
+
+		/*
+		 * Don't ask again what the cache already knows; move
+		 * on to the next label.
+		 */
+		if (result == ISC_R_SUCCESS && qmin_cached(fctx)) {
+			inc_stats(fctx->res, dns_resstatscounter_qmincached);
+			goto again;
+		}
 	} else {
 		/* Minimization is done, we'll ask for whole qname */
 		fctx->qmintype = fctx->type;
@@ -10636,42 +11086,113 @@ fctx_minimize_qname(fetchctx_t *fctx) {
 	return (result);
 }
 
-static fctxbucket_t *
-get_fctxbucket(dns_resolver_t *res, const dns_name_t *domain) {
+/*
+ * Move 'fctx', which can no longer be joined, to a unique key so that
+ * the next fetch for the same data creates a new context.
+ */
+static void
+fctx_unshare(fetchctx_t *fctx) {
+	fctxtable_t *table = fctx->res->fctxtable;
+	fetchctx_t *found = NULL;
 	isc_result_t result;
-	isc_rwlocktype_t ltype = isc_rwlocktype_read;
-	fctxbucket_t *bucket = NULL;
 
-	RWLOCK(&res->hash_lock, ltype);
-	result = isc_ht_find(res->buckets, domain->ndata, domain->length,
-			     (void **)&bucket);
-	if (result != ISC_R_SUCCESS) {
-		RWUNLOCK(&res->hash_lock, ltype);
-		bucket = isc_mem_get(res->mctx, sizeof(*bucket));
-		*bucket = (fctxbucket_t){
-			.fctxs = { 0 },
-		};
-		ISC_LIST_INIT(bucket->fctxs);
-		isc_mutex_init(&bucket->lock);
+	RWLOCK(&table->lock, isc_rwlocktype_write);
+	result = isc_hashmap_find(table->fctxs, fctx->key, fctx->keysize,
+				  (void **)&found);
+	if (result == ISC_R_SUCCESS && found == fctx &&
+	    fctx->key[0] == FCTX_KEY_SHARED)
+	{
+		/* The table refers to the key, so remove it before changing */
+		result = isc_hashmap_delete(table->fctxs, fctx->key,
+					    fctx->keysize);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		fctx->keysize = fctx_makekey(fctx->key, fctx->name, fctx->type,
+					     fctx->options, fctx);
+		result = isc_hashmap_add(table->fctxs, fctx->key,
+					 fctx->keysize, fctx);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+	RWUNLOCK(&table->lock, isc_rwlocktype_write);
+}
 
-		ltype = isc_rwlocktype_write;
-		RWLOCK(&res->hash_lock, ltype);
-		result = isc_ht_add(res->buckets, domain->ndata, domain->length,
-				    bucket);
-		if (result == ISC_R_SUCCESS) {
-			inc_stats(res, dns_resstatscounter_buckets);
-		} else {
-			/* Another thread must have created it */
-			isc_mutex_destroy(&bucket->lock);
-			isc_mem_put(res->mctx, bucket, sizeof(*bucket));
-			result = isc_ht_find(res->buckets, domain->ndata,
-					     domain->length, (void **)&bucket);
+/*
+ * Find the fetch context that a fetch for 'name'/'type' with 'options'
+ * should join, or create one if there is none.  The hash lock is held
+ * only for the lookup and the insertion, not while a new context is
+ * being set up.
+ *
+ * On success, '*fctxp' is locked and has an extra reference that the
+ * caller must release, and '*new_fctx' tells whether it was created
+ * (and so still has to be started).
+ */
+static isc_result_t
+get_attached_fctx(dns_resolver_t *res, const dns_name_t *name,
+		  dns_rdatatype_t type, const dns_name_t *domain,
+		  dns_rdataset_t *nameservers, const isc_sockaddr_t *client,
+		  unsigned int options, unsigned int depth, isc_counter_t *qc,
+		  fetchctx_t **fctxp, bool *new_fctx) {
+	fctxtable_t *table = res->fctxtable;
+	uint8_t key[FCTX_KEY_MAXSIZE];
+	uint32_t keysize;
+	fetchctx_t *fctx = NULL;
+	isc_result_t result;
+
+	keysize = fctx_makekey(key, name, type, options, NULL);
+
+again:
+	while ((options & DNS_FETCHOPT_UNSHARED) == 0) {
+		fctx = NULL;
+		RWLOCK(&table->lock, isc_rwlocktype_read);
+		result = isc_hashmap_find(table->fctxs, key, keysize,
+					  (void **)&fctx);
+		if (result == ISC_R_SUCCESS && !fctx_tryref(fctx)) {
+			fctx = NULL;
 		}
+		RWUNLOCK(&table->lock, isc_rwlocktype_read);
+
+		if (fctx == NULL) {
+			break;
+		}
+
+		LOCK(&fctx->lock);
+		if (fctx_joinable(fctx)) {
+			*fctxp = fctx;
+			return (ISC_R_SUCCESS);
+		}
+		UNLOCK(&fctx->lock);
+
+		fctx_unshare(fctx);
+		fctx_unref(fctx);
 	}
-	RUNTIME_CHECK(result == ISC_R_SUCCESS);
-	RWUNLOCK(&res->hash_lock, ltype);
 
-	return (bucket);
+	fctx = NULL;
+	result = fctx_create(res, name, type, domain, nameservers, client,
+			     options, depth, qc, &fctx);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	/*
+	 * Nobody else can see the new context yet, so locking it
+	 * before the hash lock cannot deadlock; once it is added, other
+	 * fetches wait for it to be joined by this one.
+	 */
+	LOCK(&fctx->lock);
+	RWLOCK(&table->lock, isc_rwlocktype_write);
+	result = isc_hashmap_add(table->fctxs, fctx->key, fctx->keysize, fctx);
+	RWUNLOCK(&table->lock, isc_rwlocktype_write);
+	if (result != ISC_R_SUCCESS) {
+		/* Another fetch must have created one in the meantime */
+		UNLOCK(&fctx->lock);
+		fctx_detach(&fctx);
+		goto again;
+	}
+
+	fctx_addref(fctx);
+	*fctxp = fctx;
+	*new_fctx = true;
+
+	return (ISC_R_SUCCESS);
 }
 
 isc_result_t
@@ -10693,8 +11214,6 @@ dns_resolver_createfetch(dns_resolver_t *res, const dns_name_t *name,
 	unsigned int count = 0;
 	unsigned int spillat;
 	unsigned int spillatmin;
-	bool dodestroy = false;
-	fctxbucket_t *bucket = NULL;
 
 	UNUSED(forwarders);
 
@@ -10729,23 +11248,16 @@ dns_resolver_createfetch(dns_resolver_t *res, const dns_name_t *name,
 	spillatmin = res->spillatmin;
 	UNLOCK(&res->lock);
 
-	bucket = get_fctxbucket(res, name);
-	LOCK(&bucket->lock);
-
-	if ((options & DNS_FETCHOPT_UNSHARED) == 0) {
-		for (fctx = ISC_LIST_HEAD(bucket->fctxs); fctx != NULL;
-		     fctx = ISC_LIST_NEXT(fctx, link))
-		{
-			if (fctx_match(fctx, name, type, options)) {
-				break;
-			}
-		}
+	result = get_attached_fctx(res, name, type, domain, nameservers, client,
+				   options, depth, qc, &fctx, &new_fctx);
+	if (result != ISC_R_SUCCESS) {
+		goto fail;
 	}
 
 	/*
 	 * Is this a duplicate?
 	 */
-	if (fctx != NULL && client != NULL) {
+	if (!new_fctx && client != NULL) {
 		dns_fetchevent_t *fevent;
 		for (fevent = ISC_LIST_HEAD(fctx->events); fevent != NULL;
 		     fevent = ISC_LIST_NEXT(fevent, ev_link))
@@ -10760,7 +11272,6 @@ dns_resolver_createfetch(dns_resolver_t *res, const dns_name_t *name,
 		}
 	}
 	if (count >= spillatmin && spillatmin != 0) {
-		INSIST(fctx != NULL);
 		if (count >= spillat) {
 			fctx->spilled = true;
 		}
@@ -10770,14 +11281,7 @@ dns_resolver_createfetch(dns_resolver_t *res, const dns_name_t *name,
 		}
 	}
 
-	if (fctx == NULL) {
-		result = fctx_create(res, name, type, domain, nameservers,
-				     client, options, bucket, depth, qc, &fctx);
-		if (result != ISC_R_SUCCESS) {
-			goto unlock;
-		}
-		new_fctx = true;
-	} else if (fctx->depth > depth) {
+	if (fctx->depth > depth) {
 		fctx->depth = depth;
 	}
 
@@ -10792,28 +11296,21 @@ dns_resolver_createfetch(dns_resolver_t *res, const dns_name_t *name,
 	}
 
 	if (new_fctx) {
-		if (result == ISC_R_SUCCESS) {
-			/*
-			 * Launch this fctx.
-			 */
-			event = &fctx->control_event;
-			fctx_addref(fctx);
-			ISC_EVENT_INIT(event, sizeof(*event), 0,
-				       DNS_EVENT_FETCHCONTROL, fctx_start, fctx,
-				       NULL, NULL, NULL);
-			isc_task_send(fctx->restask, &event);
-		} else {
-			dodestroy = true;
-		}
+		/*
+		 * Launch this fctx.
+		 */
+		event = &fctx->control_event;
+		fctx_addref(fctx);
+		ISC_EVENT_INIT(event, sizeof(*event), 0, DNS_EVENT_FETCHCONTROL,
+			       fctx_start, fctx, NULL, NULL, NULL);
+		isc_task_send(fctx->restask, &event);
 	}
 
 unlock:
-	UNLOCK(&bucket->lock);
-
-	if (dodestroy) {
-		fctx_destroy(fctx);
-	}
+	UNLOCK(&fctx->lock);
+	fctx_unref(fctx);
 
+fail:
 	if (result == ISC_R_SUCCESS) {
 		FTRACE("created");
 		*fetchp = fetch;
@@ -10836,7 +11333,7 @@ dns_resolver_cancelfetch(dns_fetch_t *fetch) {
 
 	FTRACE("cancelfetch");
 
-	LOCK(&fctx->bucket->lock);
+	LOCK(&fctx->lock);
 
 	/*
 	 * Find the completion event for this fetch (as opposed
@@ -10865,7 +11362,7 @@ dns_resolver_cancelfetch(dns_fetch_t *fetch) {
 	 * The fctx continues running even if no fetches remain;
 	 * the answer is still cached.
 	 */
-	UNLOCK(&fctx->bucket->lock);
+	UNLOCK(&fctx->lock);
 }
 
 void
@@ -10886,7 +11383,7 @@ dns_resolver_destroyfetch(dns_fetch_t **fetchp) {
 
 	fetch->magic = 0;
 
-	LOCK(&fctx->bucket->lock);
+	LOCK(&fctx->lock);
 
 	/*
 	 * Sanity check: the caller should have gotten its event before
@@ -10900,7 +11397,7 @@ dns_resolver_destroyfetch(dns_fetch_t **fetchp) {
 			RUNTIME_CHECK(event->fetch != fetch);
 		}
 	}
-	UNLOCK(&fctx->bucket->lock);
+	UNLOCK(&fctx->lock);
 
 	isc_mem_putanddetach(&fetch->mctx, fetch, sizeof(*fetch));
 
@@ -10919,7 +11416,7 @@ dns_resolver_logfetch(dns_fetch_t *fetch, isc_log_t *lctx,
 	fctx = fetch->private;
 	REQUIRE(VALID_FCTX(fctx));
 
-	LOCK(&fctx->bucket->lock);
+	LOCK(&fctx->lock);
 
 	INSIST(fctx->exitline >= 0);
 	if (!fctx->logged || duplicateok) {
@@ -10943,7 +11440,7 @@ dns_resolver_logfetch(dns_fetch_t *fetch, isc_log_t *lctx,
 		fctx->logged = true;
 	}
 
-	UNLOCK(&fctx->bucket->lock);
+	UNLOCK(&fctx->lock);
 }
 
 dns_dispatchmgr_t *
@@ -11621,6 +12118,35 @@ dns_resolver_setnonbackofftries(dns_resolver_t *resolver, unsigned int tries) {
 	resolver->nonbackofftries = tries;
 }
 
+unsigned int
+dns_resolver_getmaxhedges(dns_resolver_t *resolver) {
+	REQUIRE(VALID_RESOLVER(resolver));
+
+	return (resolver->maxhedges);
+}
+
+void
+dns_resolver_setmaxhedges(dns_resolver_t *resolver, unsigned int hedges) {
+	REQUIRE(VALID_RESOLVER(resolver));
+
+	resolver->maxhedges = hedges;
+}
+
+unsigned int
+dns_resolver_getmaxforwarderqueries(dns_resolver_t *resolver) {
+	REQUIRE(VALID_RESOLVER(resolver));
+
+	return (resolver->maxfwdqueries);
+}
+
+void
+dns_resolver_setmaxforwarderqueries(dns_resolver_t *resolver,
+				    unsigned int queries) {
+	REQUIRE(VALID_RESOLVER(resolver));
+
+	resolver->maxfwdqueries = queries;
+}
+
 void
 dns_resolver_setstats(dns_resolver_t *res, isc_stats_t *stats) {
 	REQUIRE(VALID_RESOLVER(res));
@@ -11666,3 +12192,55 @@ dns_resolver_getquerystats(dns_resolver_t *res, dns_stats_t **statsp) {
 		dns_stats_attach(res->querystats, statsp);
 	}
 }
+
+static int
+slowzone_compare(const void *a, const void *b) {
+	const dns_resslowzone_t *za = a, *zb = b;
+
+	if (za->waited != zb->waited) {
+		return (za->waited < zb->waited ? 1 : -1);
+	}
+	if (za->fetches != zb->fetches) {
+		return (za->fetches < zb->fetches ? 1 : -1);
+	}
+	return (0);
+}
+
+void
+dns_resolver_slowzones(dns_resolver_t *res, isc_mem_t *mctx,
+		       dns_resslowzone_t **zonesp, size_t *countp) {
+	dns_resslowzone_t *zones = NULL;
+	size_t count = 0;
+
+	REQUIRE(VALID_RESOLVER(res));
+	REQUIRE(zonesp != NULL && *zonesp == NULL);
+	REQUIRE(countp != NULL);
+
+	LOCK(&res->slowzoneslock);
+	while (count < RES_SLOWZONES && res->slowzones[count].name != NULL) {
+		count++;
+	}
+
+	if (count > 0) {
+		zones = isc_mem_get(mctx, count * sizeof(zones[0]));
+		for (size_t i = 0; i < count; i++) {
+			slowzone_t *z = &res->slowzones[i];
+
+			zones[i] = (dns_resslowzone_t){
+				.fetches = z->fetches,
+				.waited = z->waited,
+				.maxwait = z->maxwait,
+			};
+			dns_name_format(z->name, zones[i].name,
+					sizeof(zones[i].name));
+		}
+	}
+	UNLOCK(&res->slowzoneslock);
+
+	if (count > 1) {
+		qsort(zones, count, sizeof(zones[0]), slowzone_compare);
+	}
+
+	*zonesp = zones;
+	*countp = count;
+}
@@ -18,7 +18,9 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#include <isc/ascii.h>
 #include <isc/buffer.h>
+#include <isc/hash.h>
 #include <isc/loop.h>
 #include <isc/mem.h>
 #include <isc/net.h>
@@ -28,6 +30,7 @@
 #include <isc/rwlock.h>
 #include <isc/string.h>
 #include <isc/task.h>
+#include <isc/tid.h>
 #include <isc/util.h>
 #include <isc/work.h>
 
@@ -36,6 +39,7 @@
 #include <dns/dnsrps.h>
 #include <dns/events.h>
 #include <dns/fixedname.h>
+#include <dns/journal.h>
 #include <dns/log.h>
 #include <dns/rbt.h>
 #include <dns/rdata.h>
@@ -170,6 +174,43 @@ struct dns_rpz_nm_data {
 	dns_rpz_nm_zbits_t wild;
 };
 
+/*
+ * Per-thread caches of recent dns_rpz_find_name() and dns_rpz_find_ip()
+ * results.  query_checkrpz() asks about the same names and addresses
+ * over and over, and a direct-mapped slot is much cheaper to check than
+ * walking the summary RBT or the CIDR tree under the search lock.
+ *
+ * A name entry holds every QNAME or NSDNAME bit found for the name,
+ * before they are limited to the eligible zones, so one entry serves
+ * all callers.  An IP entry depends on the eligible zones, which are
+ * part of its key.  Entries with a stale generation are misses, so a
+ * policy zone update invalidates every cache at once.
+ */
+#define RPZ_CACHE_SIZE 256
+
+typedef struct rpz_name_slot {
+	uint32_t generation;
+	dns_rpz_type_t rpz_type;
+	dns_rpz_zbits_t found;
+	unsigned int length;
+	uint8_t ndata[DNS_NAME_MAXWIRE];
+} rpz_name_slot_t;
+
+typedef struct rpz_ip_slot {
+	uint32_t generation;
+	dns_rpz_type_t rpz_type;
+	dns_rpz_zbits_t zbits;
+	dns_rpz_cidr_key_t addr;
+	dns_rpz_num_t rpz_num;
+	dns_rpz_prefix_t prefix;
+	dns_rpz_cidr_key_t found;
+} rpz_ip_slot_t;
+
+struct dns_rpz_cache {
+	rpz_name_slot_t names[RPZ_CACHE_SIZE];
+	rpz_ip_slot_t ips[RPZ_CACHE_SIZE];
+};
+
 static isc_result_t
 rpz_shuttingdown(dns_rpz_zone_t *rpz);
 
@@ -1481,6 +1522,15 @@ dns_rpz_new_zones(dns_rpz_zones_t **rpzsp, char *rps_cstr, size_t rps_cstr_size,
 		.taskmgr = taskmgr,
 	};
 
+	atomic_init(&rpzs->generation, 1);
+	if (loopmgr != NULL) {
+		rpzs->ncaches = isc_loopmgr_nloops(loopmgr);
+		rpzs->caches = isc_mem_get(
+			mctx, rpzs->ncaches * sizeof(rpzs->caches[0]));
+		memset(rpzs->caches, 0,
+		       rpzs->ncaches * sizeof(rpzs->caches[0]));
+	}
+
 	isc_rwlock_init(&rpzs->search_lock, 0, 0);
 	isc_mutex_init(&rpzs->maint_lock);
 	isc_refcount_init(&rpzs->refs, 1);
@@ -1525,6 +1575,10 @@ cleanup_rbt:
 	isc_refcount_destroy(&rpzs->refs);
 	isc_mutex_destroy(&rpzs->maint_lock);
 	isc_rwlock_destroy(&rpzs->search_lock);
+	if (rpzs->caches != NULL) {
+		isc_mem_put(mctx, rpzs->caches,
+			    rpzs->ncaches * sizeof(rpzs->caches[0]));
+	}
 	isc_mem_put(mctx, rpzs, sizeof(*rpzs));
 
 	return (result);
@@ -1600,6 +1654,8 @@ dns_rpz_dbupdate_callback(dns_db_t *db, void *fn_arg) {
 		dns_db_updatenotify_unregister(rpz->db,
 					       dns_rpz_dbupdate_callback, rpz);
 		dns_db_detach(&rpz->db);
+		/* The journal does not lead from the old DB to the new one */
+		rpz->serialvalid = false;
 	}
 
 	if (rpz->db == NULL) {
@@ -1648,6 +1704,24 @@ dns_rpz_dbupdate_callback(dns_db_t *db, void *fn_arg) {
 	return (result);
 }
 
+/*
+ * Set the journal file that lets an update of the policy zone apply only
+ * the names that changed since the previous update.
+ */
+void
+dns_rpz_setjournal(dns_rpz_zone_t *rpz, const char *journal) {
+	REQUIRE(rpz != NULL);
+
+	LOCK(&rpz->rpzs->maint_lock);
+	if (rpz->journal != NULL) {
+		isc_mem_free(rpz->rpzs->mctx, rpz->journal);
+	}
+	if (journal != NULL) {
+		rpz->journal = isc_mem_strdup(rpz->rpzs->mctx, journal);
+	}
+	UNLOCK(&rpz->rpzs->maint_lock);
+}
+
 static void
 dns_rpz_update_taskaction(void *arg) {
 	isc_result_t result;
@@ -1700,6 +1774,18 @@ update_rpz_done_cb(void *data) {
 	isc_timer_start(rpz->updatetimer, isc_timertype_once, &interval);
 
 done:
+	/*
+	 * The next update can start from this version's journal entries,
+	 * unless a new DB has replaced the one we've just processed.
+	 */
+	rpz->serialvalid = (rpz->updateresult == ISC_R_SUCCESS &&
+			    rpz->updb == rpz->db &&
+			    dns_db_getsoaserial(rpz->updb, rpz->updbversion,
+						&rpz->serial) == ISC_R_SUCCESS);
+	if (rpz->updjournal != NULL) {
+		isc_mem_free(rpz->rpzs->mctx, rpz->updjournal);
+	}
+
 	dns_db_closeversion(rpz->updb, &rpz->updbversion, false);
 	dns_db_detach(&rpz->updb);
 
@@ -1898,6 +1984,183 @@ cleanup_nodes(dns_rpz_zone_t *rpz) {
 	return (result);
 }
 
+/*
+ * Bring the summary entry of one owner name in line with the version
+ * being updated to: add it if the name now has data, delete it if the
+ * name lost all of its data.
+ */
+static isc_result_t
+update_node(dns_rpz_zone_t *rpz, const char *domain, dns_name_t *name) {
+	isc_result_t result;
+	dns_dbnode_t *node = NULL;
+	dns_rdatasetiter_t *rdsiter = NULL;
+	char namebuf[DNS_NAME_FORMATSIZE];
+	bool exists = false, listed;
+
+	result = dns_db_findnode(rpz->updb, name, false, &node);
+	if (result == ISC_R_SUCCESS) {
+		result = dns_db_allrdatasets(rpz->updb, node, rpz->updbversion,
+					     0, &rdsiter);
+		if (result == ISC_R_SUCCESS) {
+			exists = (dns_rdatasetiter_first(rdsiter) ==
+				  ISC_R_SUCCESS);
+			dns_rdatasetiter_destroy(&rdsiter);
+		}
+		dns_db_detachnode(rpz->updb, &node);
+	}
+	if (result != ISC_R_SUCCESS && result != ISC_R_NOTFOUND) {
+		return (result);
+	}
+
+	listed = (isc_ht_find(rpz->nodes, name->ndata, name->length, NULL) ==
+		  ISC_R_SUCCESS);
+	if (exists == listed) {
+		return (ISC_R_SUCCESS);
+	}
+
+	dns_name_format(name, namebuf, sizeof(namebuf));
+	if (exists) {
+		result = isc_ht_add(rpz->nodes, name->ndata, name->length, rpz);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+		LOCK(&rpz->rpzs->maint_lock);
+		result = rpz_add(rpz, name);
+		UNLOCK(&rpz->rpzs->maint_lock);
+
+		if (result != ISC_R_SUCCESS) {
+			isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+				      DNS_LOGMODULE_MASTER, ISC_LOG_ERROR,
+				      "rpz: %s: adding node %s "
+				      "to RPZ error %s",
+				      domain, namebuf,
+				      isc_result_totext(result));
+		} else {
+			isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+				      DNS_LOGMODULE_MASTER, ISC_LOG_DEBUG(3),
+				      "rpz: %s: adding node %s", domain,
+				      namebuf);
+		}
+	} else {
+		isc_ht_delete(rpz->nodes, name->ndata, name->length);
+
+		LOCK(&rpz->rpzs->maint_lock);
+		rpz_del(rpz, name);
+		UNLOCK(&rpz->rpzs->maint_lock);
+
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+			      DNS_LOGMODULE_MASTER, ISC_LOG_DEBUG(3),
+			      "rpz: %s: deleting node %s", domain, namebuf);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Update the summary from the zone's journal instead of walking the
+ * whole zone: only the owner names of the RRs added or deleted between
+ * the serial the summary was built from and the serial of the version
+ * being updated to can have changed.
+ *
+ * Returns ISC_R_NOTFOUND or ISC_R_RANGE when the journal doesn't cover
+ * those serials (e.g. after a full zone transfer or a compaction), and
+ * the caller must walk the whole zone instead.
+ */
+static isc_result_t
+update_from_journal(dns_rpz_zone_t *rpz) {
+	isc_result_t result;
+	dns_journal_t *journal = NULL;
+	isc_ht_t *changed = NULL;
+	isc_ht_iter_t *iter = NULL;
+	dns_fixedname_t fixname;
+	dns_name_t *name = dns_fixedname_initname(&fixname);
+	char domain[DNS_NAME_FORMATSIZE];
+	uint32_t serial;
+
+	dns_name_format(&rpz->origin, domain, DNS_NAME_FORMATSIZE);
+
+	result = dns_db_getsoaserial(rpz->updb, rpz->updbversion, &serial);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	if (serial == rpz->serial) {
+		return (ISC_R_SUCCESS);
+	}
+
+	result = dns_journal_open(rpz->rpzs->mctx, rpz->updjournal,
+				  DNS_JOURNAL_READ, &journal);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	result = dns_journal_iter_init(journal, rpz->serial, serial, NULL);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	/*
+	 * Collect the changed owner names first: a transaction usually
+	 * deletes and adds RRs of the same name, and a name can change in
+	 * several transactions.
+	 */
+	isc_ht_init(&changed, rpz->rpzs->mctx, 1, ISC_HT_CASE_SENSITIVE);
+	for (result = dns_journal_first_rr(journal); result == ISC_R_SUCCESS;
+	     result = dns_journal_next_rr(journal))
+	{
+		dns_name_t *owner = NULL;
+		dns_rdata_t *rdata = NULL;
+		uint32_t ttl;
+
+		dns_journal_current_rr(journal, &owner, &ttl, &rdata);
+		dns_name_downcase(owner, name, NULL);
+		(void)isc_ht_add(changed, name->ndata, name->length, NULL);
+	}
+	if (result != ISC_R_NOMORE) {
+		goto cleanup;
+	}
+
+	isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_MASTER,
+		      ISC_LOG_INFO,
+		      "rpz: %s: applying %zu changed names from serial %u "
+		      "to %u",
+		      domain, isc_ht_count(changed), rpz->serial, serial);
+
+	isc_ht_iter_create(changed, &iter);
+	for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_next(iter))
+	{
+		isc_region_t region;
+		unsigned char *key = NULL;
+		size_t keysize;
+
+		result = rpz_shuttingdown(rpz);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+
+		isc_ht_iter_currentkey(iter, &key, &keysize);
+		region.base = key;
+		region.length = (unsigned int)keysize;
+		dns_name_fromregion(name, &region);
+
+		result = update_node(rpz, domain, name);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+	}
+	if (result == ISC_R_NOMORE) {
+		result = ISC_R_SUCCESS;
+	}
+	isc_ht_iter_destroy(&iter);
+
+cleanup:
+	if (changed != NULL) {
+		isc_ht_destroy(&changed);
+	}
+	dns_journal_destroy(&journal);
+
+	return (result);
+}
+
 static isc_result_t
 rpz_shuttingdown(dns_rpz_zone_t *rpz) {
 	bool shuttingdown = false;
@@ -1927,6 +2190,18 @@ update_rpz_cb(void *data) {
 		goto cleanup;
 	}
 
+	if (rpz->updjournal != NULL) {
+		result = update_from_journal(rpz);
+		switch (result) {
+		case ISC_R_SUCCESS:
+		case ISC_R_SHUTTINGDOWN:
+			goto cleanup;
+		default:
+			/* Fall back to walking the whole zone. */
+			break;
+		}
+	}
+
 	isc_ht_init(&newnodes, rpz->rpzs->mctx, 1, ISC_HT_CASE_SENSITIVE);
 
 	result = update_nodes(rpz, newnodes);
@@ -1943,7 +2218,9 @@ update_rpz_cb(void *data) {
 	ISC_SWAP(rpz->nodes, newnodes);
 
 cleanup:
-	isc_ht_destroy(&newnodes);
+	if (newnodes != NULL) {
+		isc_ht_destroy(&newnodes);
+	}
 
 	rpz->updateresult = result;
 }
@@ -1963,6 +2240,12 @@ update_from_db(dns_rpz_zone_t *rpz) {
 	rpz->updbversion = rpz->dbversion;
 	rpz->dbversion = NULL;
 
+	INSIST(rpz->updjournal == NULL);
+	if (rpz->serialvalid && rpz->journal != NULL) {
+		rpz->updjournal = isc_mem_strdup(rpz->rpzs->mctx,
+						 rpz->journal);
+	}
+
 	dns_name_format(&rpz->origin, domain, DNS_NAME_FORMATSIZE);
 	isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_MASTER,
 		      ISC_LOG_INFO, "rpz: %s: reload start", domain);
@@ -2062,6 +2345,10 @@ rpz_destroy(dns_rpz_zone_t *rpz) {
 
 	isc_ht_destroy(&rpz->nodes);
 
+	if (rpz->journal != NULL) {
+		isc_mem_free(rpzs->mctx, rpz->journal);
+	}
+
 	isc_mem_put(rpzs->mctx, rpz, sizeof(*rpz));
 	rpz_detach_rpzs(&rpzs);
 }
@@ -2141,6 +2428,16 @@ rpz_destroy_rpzs(dns_rpz_zones_t *rpzs) {
 	if (rpzs->rbt != NULL) {
 		dns_rbt_destroy(&rpzs->rbt);
 	}
+	for (uint32_t i = 0; i < rpzs->ncaches; i++) {
+		if (rpzs->caches[i] != NULL) {
+			isc_mem_put(rpzs->mctx, rpzs->caches[i],
+				    sizeof(*rpzs->caches[i]));
+		}
+	}
+	if (rpzs->caches != NULL) {
+		isc_mem_put(rpzs->mctx, rpzs->caches,
+			    rpzs->ncaches * sizeof(rpzs->caches[0]));
+	}
 	isc_task_detach(&rpzs->updater);
 	isc_mutex_destroy(&rpzs->maint_lock);
 	isc_rwlock_destroy(&rpzs->search_lock);
@@ -2193,6 +2490,7 @@ rpz_add(dns_rpz_zone_t *rpz, const dns_name_t *src_name) {
 	case DNS_RPZ_TYPE_BAD:
 		break;
 	}
+	atomic_fetch_add_release(&rpzs->generation, 1);
 	RWUNLOCK(&rpzs->search_lock, isc_rwlocktype_write);
 
 	return (result);
@@ -2409,10 +2707,45 @@ rpz_del(dns_rpz_zone_t *rpz, const dns_name_t *src_name) {
 	case DNS_RPZ_TYPE_BAD:
 		break;
 	}
+	atomic_fetch_add_release(&rpzs->generation, 1);
 
 	RWUNLOCK(&rpzs->search_lock, isc_rwlocktype_write);
 }
 
+/*
+ * Get the search result cache of the current loop thread, or NULL when
+ * not running on a loop thread.  Only the owning thread ever touches its
+ * cache, so it needs no locking.
+ */
+static struct dns_rpz_cache *
+get_cache(dns_rpz_zones_t *rpzs) {
+	struct dns_rpz_cache *cache = NULL;
+	uint32_t tid = isc_tid();
+
+	if (tid >= rpzs->ncaches) {
+		return (NULL);
+	}
+
+	cache = rpzs->caches[tid];
+	if (cache == NULL) {
+		cache = isc_mem_get(rpzs->mctx, sizeof(*cache));
+		memset(cache, 0, sizeof(*cache));
+		rpzs->caches[tid] = cache;
+	}
+
+	return (cache);
+}
+
+static rpz_ip_slot_t *
+get_ip_slot(struct dns_rpz_cache *cache, const dns_rpz_cidr_key_t *tgt_ip,
+	    dns_rpz_type_t rpz_type, dns_rpz_zbits_t zbits) {
+	uint32_t hash = isc_hash32(tgt_ip, sizeof(*tgt_ip), true);
+
+	hash ^= (uint32_t)(zbits ^ (zbits >> 32)) * 0x9e3779b1U;
+	hash += rpz_type;
+	return (&cache->ips[hash % RPZ_CACHE_SIZE]);
+}
+
 /*
  * Search the summary radix tree to get a relative owner name in a
  * policy zone relevant to a triggering IP address.
@@ -2428,8 +2761,13 @@ dns_rpz_find_ip(dns_rpz_zones_t *rpzs, dns_rpz_type_t rpz_type,
 	dns_rpz_cidr_key_t tgt_ip;
 	dns_rpz_addr_zbits_t tgt_set;
 	dns_rpz_cidr_node_t *found = NULL;
+	dns_rpz_cidr_key_t found_ip = { 0 };
+	dns_rpz_prefix_t found_prefix = 0;
+	struct dns_rpz_cache *cache = NULL;
+	rpz_ip_slot_t *slot = NULL;
+	uint32_t generation;
 	isc_result_t result;
-	dns_rpz_num_t rpz_num = 0;
+	dns_rpz_num_t rpz_num = DNS_RPZ_INVALID_NUM;
 	dns_rpz_have_t have;
 	int i;
 
@@ -2492,38 +2830,77 @@ dns_rpz_find_ip(dns_rpz_zones_t *rpzs, dns_rpz_type_t rpz_type,
 	if (zbits == 0) {
 		return (DNS_RPZ_INVALID_NUM);
 	}
+	cache = get_cache(rpzs);
+	if (cache != NULL) {
+		slot = get_ip_slot(cache, &tgt_ip, rpz_type, zbits);
+		if (slot->generation ==
+			    atomic_load_acquire(&rpzs->generation) &&
+		    slot->rpz_type == rpz_type && slot->zbits == zbits &&
+		    memcmp(&slot->addr, &tgt_ip, sizeof(tgt_ip)) == 0)
+		{
+			rpz_num = slot->rpz_num;
+			found_prefix = slot->prefix;
+			found_ip = slot->found;
+			goto trigger;
+		}
+	}
+
 	make_addr_set(&tgt_set, zbits, rpz_type);
 
 	RWLOCK(&rpzs->search_lock, isc_rwlocktype_read);
+	generation = atomic_load_relaxed(&rpzs->generation);
 	result = search(rpzs, &tgt_ip, 128, &tgt_set, false, &found);
-	if (result == ISC_R_NOTFOUND) {
+	if (result != ISC_R_NOTFOUND) {
+		/*
+		 * Remember the longest matching trigger in the first
+		 * eligible zone with a match.
+		 */
+		found_ip = found->ip;
+		found_prefix = found->prefix;
+		switch (rpz_type) {
+		case DNS_RPZ_TYPE_CLIENT_IP:
+			rpz_num = zbit_to_num(found->set.client_ip &
+					      tgt_set.client_ip);
+			break;
+		case DNS_RPZ_TYPE_IP:
+			rpz_num = zbit_to_num(found->set.ip & tgt_set.ip);
+			break;
+		case DNS_RPZ_TYPE_NSIP:
+			rpz_num = zbit_to_num(found->set.nsip & tgt_set.nsip);
+			break;
+		default:
+			UNREACHABLE();
+		}
+	}
+	RWUNLOCK(&rpzs->search_lock, isc_rwlocktype_read);
+
+	if (slot != NULL) {
+		*slot = (rpz_ip_slot_t){
+			.generation = generation,
+			.rpz_type = rpz_type,
+			.zbits = zbits,
+			.addr = tgt_ip,
+			.rpz_num = rpz_num,
+		};
+		if (rpz_num != DNS_RPZ_INVALID_NUM) {
+			slot->prefix = found_prefix;
+			slot->found = found_ip;
+		}
+	}
+
+trigger:
+	if (rpz_num == DNS_RPZ_INVALID_NUM) {
 		/*
 		 * There are no eligible zones for this IP address.
 		 */
-		RWUNLOCK(&rpzs->search_lock, isc_rwlocktype_read);
 		return (DNS_RPZ_INVALID_NUM);
 	}
 
 	/*
-	 * Construct the trigger name for the longest matching trigger
-	 * in the first eligible zone with a match.
+	 * Construct the trigger name for the longest matching trigger.
 	 */
-	*prefixp = found->prefix;
-	switch (rpz_type) {
-	case DNS_RPZ_TYPE_CLIENT_IP:
-		rpz_num = zbit_to_num(found->set.client_ip & tgt_set.client_ip);
-		break;
-	case DNS_RPZ_TYPE_IP:
-		rpz_num = zbit_to_num(found->set.ip & tgt_set.ip);
-		break;
-	case DNS_RPZ_TYPE_NSIP:
-		rpz_num = zbit_to_num(found->set.nsip & tgt_set.nsip);
-		break;
-	default:
-		UNREACHABLE();
-	}
-	result = ip2name(&found->ip, found->prefix, dns_rootname, ip_name);
-	RWUNLOCK(&rpzs->search_lock, isc_rwlocktype_read);
+	*prefixp = found_prefix;
+	result = ip2name(&found_ip, found_prefix, dns_rootname, ip_name);
 	if (result != ISC_R_SUCCESS) {
 		/*
 		 * bin/tests/system/rpz/tests.sh looks for "rpz.*failed".
@@ -2549,6 +2926,9 @@ dns_rpz_find_name(dns_rpz_zones_t *rpzs, dns_rpz_type_t rpz_type,
 	const dns_rpz_nm_data_t *nm_data = NULL;
 	dns_rpz_zbits_t found_zbits;
 	dns_rbtnodechain_t chain;
+	struct dns_rpz_cache *cache = NULL;
+	rpz_name_slot_t *slot = NULL;
+	uint32_t generation;
 	isc_result_t result;
 	int i;
 
@@ -2556,11 +2936,27 @@ dns_rpz_find_name(dns_rpz_zones_t *rpzs, dns_rpz_type_t rpz_type,
 		return (0);
 	}
 
+	cache = get_cache(rpzs);
+	if (cache != NULL) {
+		slot = &cache->names[dns_name_hash(trig_name, false) %
+				     RPZ_CACHE_SIZE];
+		if (slot->generation ==
+			    atomic_load_acquire(&rpzs->generation) &&
+		    slot->rpz_type == rpz_type &&
+		    slot->length == trig_name->length &&
+		    isc_ascii_lowerequal(slot->ndata, trig_name->ndata,
+					 trig_name->length))
+		{
+			return (zbits & slot->found);
+		}
+	}
+
 	found_zbits = 0;
 
 	dns_rbtnodechain_init(&chain);
 
 	RWLOCK(&rpzs->search_lock, isc_rwlocktype_read);
+	generation = atomic_load_relaxed(&rpzs->generation);
 
 	nmnode = NULL;
 	result = dns_rbt_findnode(rpzs->rbt, trig_name, NULL, &nmnode, &chain,
@@ -2653,6 +3049,17 @@ dns_rpz_find_name(dns_rpz_zones_t *rpzs, dns_rpz_type_t rpz_type,
 
 	dns_rbtnodechain_invalidate(&chain);
 
+	if (slot != NULL && (result == ISC_R_SUCCESS ||
+			     result == DNS_R_PARTIALMATCH ||
+			     result == ISC_R_NOTFOUND))
+	{
+		slot->generation = generation;
+		slot->rpz_type = rpz_type;
+		slot->found = found_zbits;
+		slot->length = trig_name->length;
+		memmove(slot->ndata, trig_name->ndata, trig_name->length);
+	}
+
 	return (zbits & found_zbits);
 }
 
@@ -25,6 +25,7 @@
 #include <isc/mem.h>
 #include <isc/net.h>
 #include <isc/netaddr.h>
+#include <isc/os.h>
 #include <isc/print.h>
 #include <isc/result.h>
 #include <isc/util.h>
@@ -39,7 +40,7 @@
 #include <dns/zone.h>
 
 static void
-log_end(dns_rrl_t *rrl, dns_rrl_entry_t *e, bool early, char *log_buf,
+log_end(dns_rrl_shard_t *shard, dns_rrl_entry_t *e, bool early, char *log_buf,
 	unsigned int log_buf_len);
 
 /*
@@ -160,21 +161,22 @@ delta_rrl_time(isc_stdtime_t ts, isc_stdtime_t now) {
 }
 
 static int
-get_age(const dns_rrl_t *rrl, const dns_rrl_entry_t *e, isc_stdtime_t now) {
+get_age(const dns_rrl_shard_t *shard, const dns_rrl_entry_t *e,
+	isc_stdtime_t now) {
 	if (!e->ts_valid) {
 		return (DNS_RRL_FOREVER);
 	}
-	return (delta_rrl_time(e->ts + rrl->ts_bases[e->ts_gen], now));
+	return (delta_rrl_time(e->ts + shard->ts_bases[e->ts_gen], now));
 }
 
 static void
-set_age(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_stdtime_t now) {
+set_age(dns_rrl_shard_t *shard, dns_rrl_entry_t *e, isc_stdtime_t now) {
 	dns_rrl_entry_t *e_old;
 	unsigned int ts_gen;
 	int i, ts;
 
-	ts_gen = rrl->ts_gen;
-	ts = now - rrl->ts_bases[ts_gen];
+	ts_gen = shard->ts_gen;
+	ts = now - shard->ts_bases[ts_gen];
 	if (ts < 0) {
 		if (ts < -DNS_RRL_MAX_TIME_TRAVEL) {
 			ts = DNS_RRL_FOREVER;
@@ -197,7 +199,7 @@ set_age(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_stdtime_t now) {
 	 */
 	if (ts >= DNS_RRL_MAX_TS) {
 		ts_gen = (ts_gen + 1) % DNS_RRL_TS_BASES;
-		for (e_old = ISC_LIST_TAIL(rrl->lru), i = 0;
+		for (e_old = ISC_LIST_TAIL(shard->lru), i = 0;
 		     e_old != NULL && (e_old->ts_gen == ts_gen ||
 				       !ISC_LINK_LINKED(e_old, hlink));
 		     e_old = ISC_LIST_PREV(e_old, lru), ++i)
@@ -210,13 +212,16 @@ set_age(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_stdtime_t now) {
 				DNS_LOGMODULE_REQUEST, DNS_RRL_LOG_DEBUG1,
 				"rrl new time base scanned %d entries"
 				" at %d for %d %d %d %d",
-				i, now, rrl->ts_bases[ts_gen],
-				rrl->ts_bases[(ts_gen + 1) % DNS_RRL_TS_BASES],
-				rrl->ts_bases[(ts_gen + 2) % DNS_RRL_TS_BASES],
-				rrl->ts_bases[(ts_gen + 3) % DNS_RRL_TS_BASES]);
+				i, now, shard->ts_bases[ts_gen],
+				shard->ts_bases[(ts_gen + 1) %
+						DNS_RRL_TS_BASES],
+				shard->ts_bases[(ts_gen + 2) %
+						DNS_RRL_TS_BASES],
+				shard->ts_bases[(ts_gen + 3) %
+						DNS_RRL_TS_BASES]);
 		}
-		rrl->ts_gen = ts_gen;
-		rrl->ts_bases[ts_gen] = now;
+		shard->ts_gen = ts_gen;
+		shard->ts_bases[ts_gen] = now;
 		ts = 0;
 	}
 
@@ -225,17 +230,29 @@ set_age(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_stdtime_t now) {
 	e->ts_valid = true;
 }
 
+/*
+ * The max-table-size is shared out evenly between the shards.
+ */
+static int
+shard_max_entries(const dns_rrl_t *rrl) {
+	if (rrl->max_entries == 0) {
+		return (0);
+	}
+	return ((rrl->max_entries + rrl->nshards - 1) / rrl->nshards);
+}
+
 static isc_result_t
-expand_entries(dns_rrl_t *rrl, int newsize) {
+expand_entries(dns_rrl_shard_t *shard, int newsize) {
+	dns_rrl_t *rrl = shard->rrl;
+	int max_entries = shard_max_entries(rrl);
 	unsigned int bsize;
 	dns_rrl_block_t *b;
 	dns_rrl_entry_t *e;
 	double rate;
 	int i;
 
-	if (rrl->num_entries + newsize >= rrl->max_entries &&
-	    rrl->max_entries != 0) {
-		newsize = rrl->max_entries - rrl->num_entries;
+	if (shard->num_entries + newsize >= max_entries && max_entries != 0) {
+		newsize = max_entries - shard->num_entries;
 		if (newsize <= 0) {
 			return (ISC_R_SUCCESS);
 		}
@@ -245,17 +262,18 @@ expand_entries(dns_rrl_t *rrl, int newsize) {
 	 * Log expansions so that the user can tune max-table-size
 	 * and min-table-size.
 	 */
-	if (isc_log_wouldlog(dns_lctx, DNS_RRL_LOG_DROP) && rrl->hash != NULL) {
-		rate = rrl->probes;
-		if (rrl->searches != 0) {
-			rate /= rrl->searches;
+	if (isc_log_wouldlog(dns_lctx, DNS_RRL_LOG_DROP) &&
+	    shard->hash != NULL) {
+		rate = shard->probes;
+		if (shard->searches != 0) {
+			rate /= shard->searches;
 		}
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
 			      DNS_LOGMODULE_REQUEST, DNS_RRL_LOG_DROP,
 			      "increase from %d to %d RRL entries with"
 			      " %d bins; average search length %.1f",
-			      rrl->num_entries, rrl->num_entries + newsize,
-			      rrl->hash->length, rate);
+			      shard->num_entries, shard->num_entries + newsize,
+			      shard->hash->length, rate);
 	}
 
 	bsize = sizeof(dns_rrl_block_t) +
@@ -267,10 +285,10 @@ expand_entries(dns_rrl_t *rrl, int newsize) {
 	e = b->entries;
 	for (i = 0; i < newsize; ++i, ++e) {
 		ISC_LINK_INIT(e, hlink);
-		ISC_LIST_INITANDAPPEND(rrl->lru, e, lru);
+		ISC_LIST_INITANDAPPEND(shard->lru, e, lru);
 	}
-	rrl->num_entries += newsize;
-	ISC_LIST_INITANDAPPEND(rrl->blocks, b, link);
+	shard->num_entries += newsize;
+	ISC_LIST_INITANDAPPEND(shard->blocks, b, link);
 
 	return (ISC_R_SUCCESS);
 }
@@ -282,12 +300,13 @@ get_bin(dns_rrl_hash_t *hash, unsigned int hval) {
 }
 
 static void
-free_old_hash(dns_rrl_t *rrl) {
+free_old_hash(dns_rrl_shard_t *shard) {
+	dns_rrl_t *rrl = shard->rrl;
 	dns_rrl_hash_t *old_hash;
 	dns_rrl_bin_t *old_bin;
 	dns_rrl_entry_t *e, *e_next;
 
-	old_hash = rrl->old_hash;
+	old_hash = shard->old_hash;
 	for (old_bin = &old_hash->bins[0];
 	     old_bin < &old_hash->bins[old_hash->length]; ++old_bin)
 	{
@@ -300,27 +319,28 @@ free_old_hash(dns_rrl_t *rrl) {
 	isc_mem_put(rrl->mctx, old_hash,
 		    sizeof(*old_hash) +
 			    (old_hash->length - 1) * sizeof(old_hash->bins[0]));
-	rrl->old_hash = NULL;
+	shard->old_hash = NULL;
 }
 
 static isc_result_t
-expand_rrl_hash(dns_rrl_t *rrl, isc_stdtime_t now) {
+expand_rrl_hash(dns_rrl_shard_t *shard, isc_stdtime_t now) {
+	dns_rrl_t *rrl = shard->rrl;
 	dns_rrl_hash_t *hash;
 	int old_bins, new_bins, hsize;
 	double rate;
 
-	if (rrl->old_hash != NULL) {
-		free_old_hash(rrl);
+	if (shard->old_hash != NULL) {
+		free_old_hash(shard);
 	}
 
 	/*
 	 * Most searches fail and so go to the end of the chain.
 	 * Use a small hash table load factor.
 	 */
-	old_bins = (rrl->hash == NULL) ? 0 : rrl->hash->length;
+	old_bins = (shard->hash == NULL) ? 0 : shard->hash->length;
 	new_bins = old_bins / 8 + old_bins;
-	if (new_bins < rrl->num_entries) {
-		new_bins = rrl->num_entries;
+	if (new_bins < shard->num_entries) {
+		new_bins = shard->num_entries;
 	}
 	new_bins = hash_divisor(new_bins);
 
@@ -328,41 +348,42 @@ expand_rrl_hash(dns_rrl_t *rrl, isc_stdtime_t now) {
 	hash = isc_mem_get(rrl->mctx, hsize);
 	memset(hash, 0, hsize);
 	hash->length = new_bins;
-	rrl->hash_gen ^= 1;
-	hash->gen = rrl->hash_gen;
+	shard->hash_gen ^= 1;
+	hash->gen = shard->hash_gen;
 
 	if (isc_log_wouldlog(dns_lctx, DNS_RRL_LOG_DROP) && old_bins != 0) {
-		rate = rrl->probes;
-		if (rrl->searches != 0) {
-			rate /= rrl->searches;
+		rate = shard->probes;
+		if (shard->searches != 0) {
+			rate /= shard->searches;
 		}
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
 			      DNS_LOGMODULE_REQUEST, DNS_RRL_LOG_DROP,
 			      "increase from %d to %d RRL bins for"
 			      " %d entries; average search length %.1f",
-			      old_bins, new_bins, rrl->num_entries, rate);
+			      old_bins, new_bins, shard->num_entries, rate);
 	}
 
-	rrl->old_hash = rrl->hash;
-	if (rrl->old_hash != NULL) {
-		rrl->old_hash->check_time = now;
+	shard->old_hash = shard->hash;
+	if (shard->old_hash != NULL) {
+		shard->old_hash->check_time = now;
 	}
-	rrl->hash = hash;
+	shard->hash = hash;
 
 	return (ISC_R_SUCCESS);
 }
 
 static void
-ref_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, int probes, isc_stdtime_t now) {
+ref_entry(dns_rrl_shard_t *shard, dns_rrl_entry_t *e, int probes,
+	  isc_stdtime_t now) {
 	/*
 	 * Make the entry most recently used.
 	 */
-	if (ISC_LIST_HEAD(rrl->lru) != e) {
-		if (e == rrl->last_logged) {
-			rrl->last_logged = ISC_LIST_PREV(e, lru);
+	if (ISC_LIST_HEAD(shard->lru) != e) {
+		if (e == shard->last_logged) {
+			shard->last_logged = ISC_LIST_PREV(e, lru);
 		}
-		ISC_LIST_UNLINK(rrl->lru, e, lru);
-		ISC_LIST_PREPEND(rrl->lru, e, lru);
+		ISC_LIST_UNLINK(shard->lru, e, lru);
+		ISC_LIST_PREPEND(shard->lru, e, lru);
 	}
 
 	/*
@@ -371,16 +392,16 @@ ref_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, int probes, isc_stdtime_t now) {
 	 * old hash table.  It will migrate to the new hash table the next
 	 * time it is used or be cut loose when the old hash table is destroyed.
 	 */
-	rrl->probes += probes;
-	++rrl->searches;
-	if (rrl->searches > 100 &&
-	    delta_rrl_time(rrl->hash->check_time, now) > 1) {
-		if (rrl->probes / rrl->searches > 2) {
-			expand_rrl_hash(rrl, now);
+	shard->probes += probes;
+	++shard->searches;
+	if (shard->searches > 100 &&
+	    delta_rrl_time(shard->hash->check_time, now) > 1) {
+		if (shard->probes / shard->searches > 2) {
+			expand_rrl_hash(shard, now);
 		}
-		rrl->hash->check_time = now;
-		rrl->probes = 0;
-		rrl->searches = 0;
+		shard->hash->check_time = now;
+		shard->probes = 0;
+		shard->searches = 0;
 	}
 }
 
@@ -502,7 +523,8 @@ get_rate(dns_rrl_t *rrl, dns_rrl_rtype_t rtype) {
 }
 
 static int
-response_balance(dns_rrl_t *rrl, const dns_rrl_entry_t *e, int age) {
+response_balance(dns_rrl_shard_t *shard, const dns_rrl_entry_t *e, int age) {
+	dns_rrl_t *rrl = shard->rrl;
 	dns_rrl_rate_t *ratep;
 	int balance, rate;
 
@@ -510,7 +532,7 @@ response_balance(dns_rrl_t *rrl, const dns_rrl_entry_t *e, int age) {
 		rate = 1;
 	} else {
 		ratep = get_rate(rrl, e->key.s.rtype);
-		rate = ratep->scaled;
+		rate = atomic_load_relaxed(&ratep->scaled);
 	}
 
 	balance = e->responses + age * rate;
@@ -524,10 +546,11 @@ response_balance(dns_rrl_t *rrl, const dns_rrl_entry_t *e, int age) {
  * Search for an entry for a response and optionally create it.
  */
 static dns_rrl_entry_t *
-get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr, dns_zone_t *zone,
-	  dns_rdataclass_t qclass, dns_rdatatype_t qtype,
+get_entry(dns_rrl_shard_t *shard, const isc_sockaddr_t *client_addr,
+	  dns_zone_t *zone, dns_rdataclass_t qclass, dns_rdatatype_t qtype,
 	  const dns_name_t *qname, dns_rrl_rtype_t rtype, isc_stdtime_t now,
 	  bool create, char *log_buf, unsigned int log_buf_len) {
+	dns_rrl_t *rrl = shard->rrl;
 	dns_rrl_key_t key;
 	uint32_t hval;
 	dns_rrl_entry_t *e;
@@ -541,12 +564,12 @@ get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr, dns_zone_t *zone,
 	/*
 	 * Look for the entry in the current hash table.
 	 */
-	new_bin = get_bin(rrl->hash, hval);
+	new_bin = get_bin(shard->hash, hval);
 	probes = 1;
 	e = ISC_LIST_HEAD(*new_bin);
 	while (e != NULL) {
 		if (key_cmp(&e->key, &key)) {
-			ref_entry(rrl, e, probes, now);
+			ref_entry(shard, e, probes, now);
 			return (e);
 		}
 		++probes;
@@ -556,15 +579,15 @@ get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr, dns_zone_t *zone,
 	/*
 	 * Look in the old hash table.
 	 */
-	if (rrl->old_hash != NULL) {
-		old_bin = get_bin(rrl->old_hash, hval);
+	if (shard->old_hash != NULL) {
+		old_bin = get_bin(shard->old_hash, hval);
 		e = ISC_LIST_HEAD(*old_bin);
 		while (e != NULL) {
 			if (key_cmp(&e->key, &key)) {
 				ISC_LIST_UNLINK(*old_bin, e, hlink);
 				ISC_LIST_PREPEND(*new_bin, e, hlink);
-				e->hash_gen = rrl->hash_gen;
-				ref_entry(rrl, e, probes, now);
+				e->hash_gen = shard->hash_gen;
+				ref_entry(shard, e, probes, now);
 				return (e);
 			}
 			e = ISC_LIST_NEXT(e, hlink);
@@ -573,9 +596,9 @@ get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr, dns_zone_t *zone,
 		/*
 		 * Discard previous hash table when all of its entries are old.
 		 */
-		age = delta_rrl_time(rrl->old_hash->check_time, now);
+		age = delta_rrl_time(shard->old_hash->check_time, now);
 		if (age > rrl->window) {
-			free_old_hash(rrl);
+			free_old_hash(shard);
 		}
 	}
 
@@ -589,41 +612,42 @@ get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr, dns_zone_t *zone,
 	 * Try to make more entries if none are idle.
 	 * Steal the oldest entry if we cannot create more.
 	 */
-	for (e = ISC_LIST_TAIL(rrl->lru); e != NULL; e = ISC_LIST_PREV(e, lru))
-	{
+	for (e = ISC_LIST_TAIL(shard->lru); e != NULL;
+	     e = ISC_LIST_PREV(e, lru)) {
 		if (!ISC_LINK_LINKED(e, hlink)) {
 			break;
 		}
-		age = get_age(rrl, e, now);
+		age = get_age(shard, e, now);
 		if (age <= 1) {
 			e = NULL;
 			break;
 		}
-		if (!e->logged && response_balance(rrl, e, age) > 0) {
+		if (!e->logged && response_balance(shard, e, age) > 0) {
 			break;
 		}
 	}
 	if (e == NULL) {
-		expand_entries(rrl, ISC_MIN((rrl->num_entries + 1) / 2, 1000));
-		e = ISC_LIST_TAIL(rrl->lru);
+		expand_entries(shard,
+			       ISC_MIN((shard->num_entries + 1) / 2, 1000));
+		e = ISC_LIST_TAIL(shard->lru);
 	}
 	if (e->logged) {
-		log_end(rrl, e, true, log_buf, log_buf_len);
+		log_end(shard, e, true, log_buf, log_buf_len);
 	}
 	if (ISC_LINK_LINKED(e, hlink)) {
-		if (e->hash_gen == rrl->hash_gen) {
-			hash = rrl->hash;
+		if (e->hash_gen == shard->hash_gen) {
+			hash = shard->hash;
 		} else {
-			hash = rrl->old_hash;
+			hash = shard->old_hash;
 		}
 		old_bin = get_bin(hash, hash_key(&e->key));
 		ISC_LIST_UNLINK(*old_bin, e, hlink);
 	}
 	ISC_LIST_PREPEND(*new_bin, e, hlink);
-	e->hash_gen = rrl->hash_gen;
+	e->hash_gen = shard->hash_gen;
 	e->key = key;
 	e->ts_valid = false;
-	ref_entry(rrl, e, probes, now);
+	ref_entry(shard, e, probes, now);
 	return (e);
 }
 
@@ -644,9 +668,10 @@ debit_log(const dns_rrl_entry_t *e, int age, const char *action) {
 }
 
 static dns_rrl_result_t
-debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
-		const isc_sockaddr_t *client_addr, isc_stdtime_t now,
-		char *log_buf, unsigned int log_buf_len) {
+debit_rrl_entry(dns_rrl_shard_t *shard, dns_rrl_entry_t *e, double qps,
+		double scale, const isc_sockaddr_t *client_addr,
+		isc_stdtime_t now, char *log_buf, unsigned int log_buf_len) {
+	dns_rrl_t *rrl = shard->rrl;
 	int rate, new_rate, slip, new_slip, age, log_secs, min;
 	dns_rrl_rate_t *ratep;
 	dns_rrl_entry_t const *credit_e;
@@ -665,11 +690,12 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 		/*
 		 * The limit for clients that have used TCP is not scaled.
 		 */
-		credit_e = get_entry(
-			rrl, client_addr, NULL, 0, dns_rdatatype_none, NULL,
-			DNS_RRL_RTYPE_TCP, now, false, log_buf, log_buf_len);
+		credit_e = get_entry(shard, client_addr, NULL, 0,
+				     dns_rdatatype_none, NULL,
+				     DNS_RRL_RTYPE_TCP, now, false, log_buf,
+				     log_buf_len);
 		if (credit_e != NULL) {
-			age = get_age(rrl, e, now);
+			age = get_age(shard, e, now);
 			if (age < rrl->window) {
 				scale = 1.0;
 			}
@@ -680,7 +706,7 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 		if (new_rate < 1) {
 			new_rate = 1;
 		}
-		if (ratep->scaled != new_rate) {
+		if (atomic_load_relaxed(&ratep->scaled) != new_rate) {
 			isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
 				      DNS_LOGMODULE_REQUEST, DNS_RRL_LOG_DEBUG1,
 				      "%d qps scaled %s by %.2f"
@@ -688,7 +714,7 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 				      (int)qps, ratep->str, scale, rate,
 				      new_rate);
 			rate = new_rate;
-			ratep->scaled = rate;
+			atomic_store_relaxed(&ratep->scaled, rate);
 		}
 	}
 
@@ -699,7 +725,7 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 	 * Treat entries older than the window as if they were just created
 	 * Credit other entries.
 	 */
-	age = get_age(rrl, e, now);
+	age = get_age(shard, e, now);
 	if (age > 0) {
 		/*
 		 * Credit tokens earned during elapsed time.
@@ -731,7 +757,7 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 			e->log_secs = log_secs;
 		}
 	}
-	set_age(rrl, e, now);
+	set_age(shard, e, now);
 
 	/*
 	 * Debit the entry for this response.
@@ -756,14 +782,14 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 		if (new_slip < 2) {
 			new_slip = 2;
 		}
-		if (rrl->slip.scaled != new_slip) {
+		if (atomic_load_relaxed(&rrl->slip.scaled) != new_slip) {
 			isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
 				      DNS_LOGMODULE_REQUEST, DNS_RRL_LOG_DEBUG1,
 				      "%d qps scaled slip"
 				      " by %.2f from %d to %d",
 				      (int)qps, scale, slip, new_slip);
 			slip = new_slip;
-			rrl->slip.scaled = slip;
+			atomic_store_relaxed(&rrl->slip.scaled, slip);
 		}
 	}
 	if (slip != 0 && e->key.s.rtype != DNS_RRL_RTYPE_ALL) {
@@ -787,10 +813,10 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 }
 
 static dns_rrl_qname_buf_t *
-get_qname(dns_rrl_t *rrl, const dns_rrl_entry_t *e) {
+get_qname(dns_rrl_shard_t *shard, const dns_rrl_entry_t *e) {
 	dns_rrl_qname_buf_t *qbuf;
 
-	qbuf = rrl->qnames[e->log_qname];
+	qbuf = shard->qnames[e->log_qname];
 	if (qbuf == NULL || qbuf->e != e) {
 		return (NULL);
 	}
@@ -798,13 +824,13 @@ get_qname(dns_rrl_t *rrl, const dns_rrl_entry_t *e) {
 }
 
 static void
-free_qname(dns_rrl_t *rrl, dns_rrl_entry_t *e) {
+free_qname(dns_rrl_shard_t *shard, dns_rrl_entry_t *e) {
 	dns_rrl_qname_buf_t *qbuf;
 
-	qbuf = get_qname(rrl, e);
+	qbuf = get_qname(shard, e);
 	if (qbuf != NULL) {
 		qbuf->e = NULL;
-		ISC_LIST_APPEND(rrl->qname_free, qbuf, link);
+		ISC_LIST_APPEND(shard->qname_free, qbuf, link);
 	}
 }
 
@@ -829,11 +855,12 @@ add_log_str(isc_buffer_t *lb, const char *str, unsigned int str_len) {
  * Build strings for the logs
  */
 static void
-make_log_buf(dns_rrl_t *rrl, dns_rrl_entry_t *e, const char *str1,
+make_log_buf(dns_rrl_shard_t *shard, dns_rrl_entry_t *e, const char *str1,
 	     const char *str2, bool plural, const dns_name_t *qname,
 	     bool save_qname, dns_rrl_result_t rrl_result,
 	     isc_result_t resp_result, char *log_buf,
 	     unsigned int log_buf_len) {
+	dns_rrl_t *rrl = shard->rrl;
 	isc_buffer_t lb;
 	dns_rrl_qname_buf_t *qbuf;
 	isc_netaddr_t cidr;
@@ -925,22 +952,23 @@ make_log_buf(dns_rrl_t *rrl, dns_rrl_entry_t *e, const char *str1,
 	    e->key.s.rtype == DNS_RRL_RTYPE_NODATA ||
 	    e->key.s.rtype == DNS_RRL_RTYPE_NXDOMAIN)
 	{
-		qbuf = get_qname(rrl, e);
+		qbuf = get_qname(shard, e);
 		if (save_qname && qbuf == NULL && qname != NULL &&
 		    dns_name_isabsolute(qname)) {
 			/*
 			 * Capture the qname for the "stop limiting" message.
 			 */
-			qbuf = ISC_LIST_TAIL(rrl->qname_free);
+			qbuf = ISC_LIST_TAIL(shard->qname_free);
 			if (qbuf != NULL) {
-				ISC_LIST_UNLINK(rrl->qname_free, qbuf, link);
-			} else if (rrl->num_qnames < DNS_RRL_QNAMES) {
+				ISC_LIST_UNLINK(shard->qname_free, qbuf, link);
+			} else if (shard->num_qnames < DNS_RRL_QNAMES) {
 				qbuf = isc_mem_get(rrl->mctx, sizeof(*qbuf));
 				{
 					memset(qbuf, 0, sizeof(*qbuf));
 					ISC_LINK_INIT(qbuf, link);
-					qbuf->index = rrl->num_qnames;
-					rrl->qnames[rrl->num_qnames++] = qbuf;
+					qbuf->index = shard->num_qnames;
+					shard->qnames[shard->num_qnames++] =
+						qbuf;
 				}
 			}
 			if (qbuf != NULL) {
@@ -980,10 +1008,11 @@ make_log_buf(dns_rrl_t *rrl, dns_rrl_entry_t *e, const char *str1,
 }
 
 static void
-log_end(dns_rrl_t *rrl, dns_rrl_entry_t *e, bool early, char *log_buf,
+log_end(dns_rrl_shard_t *shard, dns_rrl_entry_t *e, bool early, char *log_buf,
 	unsigned int log_buf_len) {
+	dns_rrl_t *rrl = shard->rrl;
 	if (e->logged) {
-		make_log_buf(rrl, e, early ? "*" : NULL,
+		make_log_buf(shard, e, early ? "*" : NULL,
 			     rrl->log_only ? "would stop limiting "
 					   : "stop limiting ",
 			     true, NULL, false, DNS_RRL_RESULT_OK,
@@ -991,9 +1020,9 @@ log_end(dns_rrl_t *rrl, dns_rrl_entry_t *e, bool early, char *log_buf,
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
 			      DNS_LOGMODULE_REQUEST, DNS_RRL_LOG_DROP, "%s",
 			      log_buf);
-		free_qname(rrl, e);
+		free_qname(shard, e);
 		e->logged = false;
-		--rrl->num_logged;
+		--shard->num_logged;
 	}
 }
 
@@ -1001,25 +1030,25 @@ log_end(dns_rrl_t *rrl, dns_rrl_entry_t *e, bool early, char *log_buf,
  * Log messages for streams that have stopped being rate limited.
  */
 static void
-log_stops(dns_rrl_t *rrl, isc_stdtime_t now, int limit, char *log_buf,
+log_stops(dns_rrl_shard_t *shard, isc_stdtime_t now, int limit, char *log_buf,
 	  unsigned int log_buf_len) {
 	dns_rrl_entry_t *e;
 	int age;
 
-	for (e = rrl->last_logged; e != NULL; e = ISC_LIST_PREV(e, lru)) {
+	for (e = shard->last_logged; e != NULL; e = ISC_LIST_PREV(e, lru)) {
 		if (!e->logged) {
 			continue;
 		}
 		if (now != 0) {
-			age = get_age(rrl, e, now);
+			age = get_age(shard, e, now);
 			if (age < DNS_RRL_STOP_LOG_SECS ||
-			    response_balance(rrl, e, age) < 0) {
+			    response_balance(shard, e, age) < 0) {
 				break;
 			}
 		}
 
-		log_end(rrl, e, now == 0, log_buf, log_buf_len);
-		if (rrl->num_logged <= 0) {
+		log_end(shard, e, now == 0, log_buf, log_buf_len);
+		if (shard->num_logged <= 0) {
 			break;
 		}
 
@@ -1027,15 +1056,78 @@ log_stops(dns_rrl_t *rrl, isc_stdtime_t now, int limit, char *log_buf,
 		 * Too many messages could stall real work.
 		 */
 		if (--limit < 0) {
-			rrl->last_logged = ISC_LIST_PREV(e, lru);
+			shard->last_logged = ISC_LIST_PREV(e, lru);
 			return;
 		}
 	}
 	if (e == NULL) {
-		INSIST(rrl->num_logged == 0);
-		rrl->log_stops_time = now;
+		INSIST(shard->num_logged == 0);
+		shard->log_stops_time = now;
 	}
-	rrl->last_logged = e;
+	shard->last_logged = e;
+}
+
+/*
+ * Estimate the total query per second rate of the view.  The estimate
+ * is shared by all the shards, so it has a lock of its own; it is only
+ * needed when the limits are scaled by qps.
+ */
+static double
+estimate_qps(dns_rrl_t *rrl, isc_stdtime_t now) {
+	double qps;
+	int secs;
+
+	LOCK(&rrl->lock);
+	++rrl->qps_responses;
+	secs = delta_rrl_time(rrl->qps_time, now);
+	if (secs <= 0) {
+		qps = rrl->qps;
+	} else {
+		qps = (1.0 * rrl->qps_responses) / secs;
+		if (secs >= rrl->window) {
+			if (isc_log_wouldlog(dns_lctx, DNS_RRL_LOG_DEBUG3)) {
+				isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
+					      DNS_LOGMODULE_REQUEST,
+					      DNS_RRL_LOG_DEBUG3,
+					      "%d responses/%d seconds"
+					      " = %d qps",
+					      rrl->qps_responses, secs,
+					      (int)qps);
+			}
+			rrl->qps = qps;
+			rrl->qps_responses = 0;
+			rrl->qps_time = now;
+		} else if (qps < rrl->qps) {
+			qps = rrl->qps;
+		}
+	}
+	UNLOCK(&rrl->lock);
+
+	return (qps);
+}
+
+/*
+ * Pick the shard for a client from its address, masked as in make_key().
+ */
+static dns_rrl_shard_t *
+get_shard(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr) {
+	uint32_t ip[DNS_RRL_MAX_PREFIX / 32];
+	uint32_t hval = 0;
+	int i;
+
+	switch (client_addr->type.sa.sa_family) {
+	case AF_INET:
+		hval = client_addr->type.sin.sin_addr.s_addr & rrl->ipv4_mask;
+		break;
+	case AF_INET6:
+		memmove(ip, &client_addr->type.sin6.sin6_addr, sizeof(ip));
+		for (i = 0; i < DNS_RRL_MAX_PREFIX / 32; ++i) {
+			hval = hval * 31 + (ip[i] & rrl->ipv6_mask[i]);
+		}
+		break;
+	}
+
+	return (&rrl->shards[((hval * 0x9e3779b1U) >> 16) % rrl->nshards]);
 }
 
 /*
@@ -1047,10 +1139,10 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 	const dns_name_t *qname, isc_result_t resp_result, isc_stdtime_t now,
 	bool wouldlog, char *log_buf, unsigned int log_buf_len) {
 	dns_rrl_t *rrl;
+	dns_rrl_shard_t *shard;
 	dns_rrl_rtype_t rtype;
 	dns_rrl_entry_t *e;
 	isc_netaddr_t netclient;
-	int secs;
 	double qps, scale;
 	int exempt_match;
 	isc_result_t result;
@@ -1068,8 +1160,6 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 		}
 	}
 
-	LOCK(&rrl->lock);
-
 	/*
 	 * Estimate total query per second rate when scaling by qps.
 	 */
@@ -1077,39 +1167,18 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 		qps = 0.0;
 		scale = 1.0;
 	} else {
-		++rrl->qps_responses;
-		secs = delta_rrl_time(rrl->qps_time, now);
-		if (secs <= 0) {
-			qps = rrl->qps;
-		} else {
-			qps = (1.0 * rrl->qps_responses) / secs;
-			if (secs >= rrl->window) {
-				if (isc_log_wouldlog(dns_lctx,
-						     DNS_RRL_LOG_DEBUG3)) {
-					isc_log_write(dns_lctx,
-						      DNS_LOGCATEGORY_RRL,
-						      DNS_LOGMODULE_REQUEST,
-						      DNS_RRL_LOG_DEBUG3,
-						      "%d responses/%d seconds"
-						      " = %d qps",
-						      rrl->qps_responses, secs,
-						      (int)qps);
-				}
-				rrl->qps = qps;
-				rrl->qps_responses = 0;
-				rrl->qps_time = now;
-			} else if (qps < rrl->qps) {
-				qps = rrl->qps;
-			}
-		}
+		qps = estimate_qps(rrl, now);
 		scale = rrl->qps_scale / qps;
 	}
 
+	shard = get_shard(rrl, client_addr);
+	LOCK(&shard->lock);
+
 	/*
 	 * Do maintenance once per second.
 	 */
-	if (rrl->num_logged > 0 && rrl->log_stops_time != now) {
-		log_stops(rrl, now, 8, log_buf, log_buf_len);
+	if (shard->num_logged > 0 && shard->log_stops_time != now) {
+		log_stops(shard, now, 8, log_buf, log_buf_len);
 	}
 
 	/*
@@ -1118,16 +1187,16 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 	 */
 	if (is_tcp) {
 		if (scale < 1.0) {
-			e = get_entry(rrl, client_addr, NULL, 0,
+			e = get_entry(shard, client_addr, NULL, 0,
 				      dns_rdatatype_none, NULL,
 				      DNS_RRL_RTYPE_TCP, now, true, log_buf,
 				      log_buf_len);
 			if (e != NULL) {
 				e->responses = -(rrl->window + 1);
-				set_age(rrl, e, now);
+				set_age(shard, e, now);
 			}
 		}
-		UNLOCK(&rrl->lock);
+		UNLOCK(&shard->lock);
 		return (DNS_RRL_RESULT_OK);
 	}
 
@@ -1152,10 +1221,10 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 		rtype = DNS_RRL_RTYPE_ERROR;
 		break;
 	}
-	e = get_entry(rrl, client_addr, zone, qclass, qtype, qname, rtype, now,
-		      true, log_buf, log_buf_len);
+	e = get_entry(shard, client_addr, zone, qclass, qtype, qname, rtype,
+		      now, true, log_buf, log_buf_len);
 	if (e == NULL) {
-		UNLOCK(&rrl->lock);
+		UNLOCK(&shard->lock);
 		return (DNS_RRL_RESULT_OK);
 	}
 
@@ -1164,7 +1233,7 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 		 * Do not worry about speed or releasing the lock.
 		 * This message appears before messages from debit_rrl_entry().
 		 */
-		make_log_buf(rrl, e, "consider limiting ", NULL, false, qname,
+		make_log_buf(shard, e, "consider limiting ", NULL, false, qname,
 			     false, DNS_RRL_RESULT_OK, resp_result, log_buf,
 			     log_buf_len);
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
@@ -1172,7 +1241,7 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 			      log_buf);
 	}
 
-	rrl_result = debit_rrl_entry(rrl, e, qps, scale, client_addr, now,
+	rrl_result = debit_rrl_entry(shard, e, qps, scale, client_addr, now,
 				     log_buf, log_buf_len);
 
 	if (rrl->all_per_second.r != 0) {
@@ -1187,21 +1256,21 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 		dns_rrl_entry_t *e_all;
 		dns_rrl_result_t rrl_all_result;
 
-		e_all = get_entry(rrl, client_addr, zone, 0, dns_rdatatype_none,
-				  NULL, DNS_RRL_RTYPE_ALL, now, true, log_buf,
-				  log_buf_len);
+		e_all = get_entry(shard, client_addr, zone, 0,
+				  dns_rdatatype_none, NULL, DNS_RRL_RTYPE_ALL,
+				  now, true, log_buf, log_buf_len);
 		if (e_all == NULL) {
-			UNLOCK(&rrl->lock);
+			UNLOCK(&shard->lock);
 			return (DNS_RRL_RESULT_OK);
 		}
-		rrl_all_result = debit_rrl_entry(rrl, e_all, qps, scale,
+		rrl_all_result = debit_rrl_entry(shard, e_all, qps, scale,
 						 client_addr, now, log_buf,
 						 log_buf_len);
 		if (rrl_all_result != DNS_RRL_RESULT_OK) {
 			e = e_all;
 			rrl_result = rrl_all_result;
 			if (isc_log_wouldlog(dns_lctx, DNS_RRL_LOG_DEBUG1)) {
-				make_log_buf(rrl, e,
+				make_log_buf(shard, e,
 					     "prefer all-per-second limiting ",
 					     NULL, true, qname, false,
 					     DNS_RRL_RESULT_OK, resp_result,
@@ -1215,7 +1284,7 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 	}
 
 	if (rrl_result == DNS_RRL_RESULT_OK) {
-		UNLOCK(&rrl->lock);
+		UNLOCK(&shard->lock);
 		return (DNS_RRL_RESULT_OK);
 	}
 
@@ -1225,14 +1294,14 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 	if ((!e->logged || e->log_secs >= DNS_RRL_MAX_LOG_SECS) &&
 	    isc_log_wouldlog(dns_lctx, DNS_RRL_LOG_DROP))
 	{
-		make_log_buf(rrl, e, rrl->log_only ? "would " : NULL,
+		make_log_buf(shard, e, rrl->log_only ? "would " : NULL,
 			     e->logged ? "continue limiting " : "limit ", true,
 			     qname, true, DNS_RRL_RESULT_OK, resp_result,
 			     log_buf, log_buf_len);
 		if (!e->logged) {
 			e->logged = true;
-			if (++rrl->num_logged <= 1) {
-				rrl->last_logged = e;
+			if (++shard->num_logged <= 1) {
+				shard->last_logged = e;
 			}
 		}
 		e->log_secs = 0;
@@ -1241,7 +1310,7 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 		 * Avoid holding the lock.
 		 */
 		if (!wouldlog) {
-			UNLOCK(&rrl->lock);
+			UNLOCK(&shard->lock);
 			e = NULL;
 		}
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
@@ -1253,7 +1322,7 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 	 * Make a log message for the caller.
 	 */
 	if (wouldlog) {
-		make_log_buf(rrl, e,
+		make_log_buf(shard, e,
 			     rrl->log_only ? "would rate limit "
 					   : "rate limit ",
 			     NULL, false, qname, false, rrl_result, resp_result,
@@ -1266,66 +1335,79 @@ dns_rrl(dns_view_t *view, dns_zone_t *zone, const isc_sockaddr_t *client_addr,
 		 * the ending log message.
 		 */
 		if (!e->logged) {
-			free_qname(rrl, e);
+			free_qname(shard, e);
 		}
-		UNLOCK(&rrl->lock);
+		UNLOCK(&shard->lock);
 	}
 
 	return (rrl_result);
 }
 
-void
-dns_rrl_view_destroy(dns_view_t *view) {
-	dns_rrl_t *rrl;
+static void
+destroy_shard(dns_rrl_t *rrl, dns_rrl_shard_t *shard) {
 	dns_rrl_block_t *b;
 	dns_rrl_hash_t *h;
 	char log_buf[DNS_RRL_LOG_BUF_LEN];
 	int i;
 
-	rrl = view->rrl;
-	if (rrl == NULL) {
-		return;
-	}
-	view->rrl = NULL;
-
-	/*
-	 * Assume the caller takes care of locking the view and anything else.
-	 */
-
-	if (rrl->num_logged > 0) {
-		log_stops(rrl, 0, INT32_MAX, log_buf, sizeof(log_buf));
+	if (shard->num_logged > 0) {
+		log_stops(shard, 0, INT32_MAX, log_buf, sizeof(log_buf));
 	}
 
 	for (i = 0; i < DNS_RRL_QNAMES; ++i) {
-		if (rrl->qnames[i] == NULL) {
+		if (shard->qnames[i] == NULL) {
 			break;
 		}
-		isc_mem_put(rrl->mctx, rrl->qnames[i], sizeof(*rrl->qnames[i]));
+		isc_mem_put(rrl->mctx, shard->qnames[i],
+			    sizeof(*shard->qnames[i]));
 	}
 
-	if (rrl->exempt != NULL) {
-		dns_acl_detach(&rrl->exempt);
-	}
+	isc_mutex_destroy(&shard->lock);
 
-	isc_mutex_destroy(&rrl->lock);
-
-	while (!ISC_LIST_EMPTY(rrl->blocks)) {
-		b = ISC_LIST_HEAD(rrl->blocks);
-		ISC_LIST_UNLINK(rrl->blocks, b, link);
+	while (!ISC_LIST_EMPTY(shard->blocks)) {
+		b = ISC_LIST_HEAD(shard->blocks);
+		ISC_LIST_UNLINK(shard->blocks, b, link);
 		isc_mem_put(rrl->mctx, b, b->size);
 	}
 
-	h = rrl->hash;
+	h = shard->hash;
 	if (h != NULL) {
 		isc_mem_put(rrl->mctx, h,
 			    sizeof(*h) + (h->length - 1) * sizeof(h->bins[0]));
 	}
 
-	h = rrl->old_hash;
+	h = shard->old_hash;
 	if (h != NULL) {
 		isc_mem_put(rrl->mctx, h,
 			    sizeof(*h) + (h->length - 1) * sizeof(h->bins[0]));
 	}
+}
+
+void
+dns_rrl_view_destroy(dns_view_t *view) {
+	dns_rrl_t *rrl;
+
+	rrl = view->rrl;
+	if (rrl == NULL) {
+		return;
+	}
+	view->rrl = NULL;
+
+	/*
+	 * Assume the caller takes care of locking the view and anything else.
+	 */
+
+	for (unsigned int i = 0; i < rrl->nshards; i++) {
+		destroy_shard(rrl, &rrl->shards[i]);
+	}
+	isc_mem_put(rrl->mctx, rrl->shards,
+		    rrl->nshards * sizeof(rrl->shards[0]));
+
+	if (rrl->exempt != NULL) {
+		dns_acl_detach(&rrl->exempt);
+	}
+
+	isc_mutex_destroy(&rrl->lock);
 
 	isc_mem_putanddetach(&rrl->mctx, rrl, sizeof(*rrl));
 }
@@ -1334,6 +1416,7 @@ isc_result_t
 dns_rrl_init(dns_rrl_t **rrlp, dns_view_t *view, int min_entries) {
 	dns_rrl_t *rrl;
 	isc_result_t result;
+	isc_stdtime_t now;
 
 	*rrlp = NULL;
 
@@ -1341,19 +1424,38 @@ dns_rrl_init(dns_rrl_t **rrlp, dns_view_t *view, int min_entries) {
 	memset(rrl, 0, sizeof(*rrl));
 	isc_mem_attach(view->mctx, &rrl->mctx);
 	isc_mutex_init(&rrl->lock);
-	isc_stdtime_get(&rrl->ts_bases[0]);
+	isc_stdtime_get(&now);
 
-	view->rrl = rrl;
+	/*
+	 * One shard per CPU keeps the worker threads from waiting for
+	 * each other, as long as they answer different clients.
+	 */
+	rrl->nshards = isc_os_ncpus();
+	rrl->shards = isc_mem_get(rrl->mctx,
+				  rrl->nshards * sizeof(rrl->shards[0]));
+	memset(rrl->shards, 0, rrl->nshards * sizeof(rrl->shards[0]));
+	for (unsigned int i = 0; i < rrl->nshards; i++) {
+		dns_rrl_shard_t *shard = &rrl->shards[i];
 
-	result = expand_entries(rrl, min_entries);
-	if (result != ISC_R_SUCCESS) {
-		dns_rrl_view_destroy(view);
-		return (result);
+		isc_mutex_init(&shard->lock);
+		shard->rrl = rrl;
+		shard->ts_bases[0] = now;
 	}
-	result = expand_rrl_hash(rrl, 0);
-	if (result != ISC_R_SUCCESS) {
-		dns_rrl_view_destroy(view);
-		return (result);
+
+	view->rrl = rrl;
+
+	min_entries = (min_entries + rrl->nshards - 1) / rrl->nshards;
+	for (unsigned int i = 0; i < rrl->nshards; i++) {
+		result = expand_entries(&rrl->shards[i], min_entries);
+		if (result != ISC_R_SUCCESS) {
+			dns_rrl_view_destroy(view);
+			return (result);
+		}
+		result = expand_rrl_hash(&rrl->shards[i], 0);
+		if (result != ISC_R_SUCCESS) {
+			dns_rrl_view_destroy(view);
+			return (result);
+		}
 	}
 
 	*rrlp = rrl;
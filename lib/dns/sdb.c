@@ -182,7 +182,8 @@ dbiterator_origin(dns_dbiterator_t *iterator, dns_name_t *name);
 static dns_dbiteratormethods_t dbiterator_methods = {
 	dbiterator_destroy, dbiterator_first, dbiterator_last,
 	dbiterator_seek,    dbiterator_prev,  dbiterator_next,
-	dbiterator_current, dbiterator_pause, dbiterator_origin
+	dbiterator_current, dbiterator_pause, dbiterator_origin,
+	NULL /* currentbatch */
 };
 
 static void
@@ -1299,6 +1300,12 @@ static dns_dbmethods_t sdb_methods = {
 	NULL, /* setservestalerefresh */
 	NULL, /* getservestalerefresh */
 	NULL, /* setgluecachestats */
+	NULL, /* setevictionpolicy */
+	NULL, /* getmemory */
+	NULL, /* expire */
+	NULL, /* setcoldtier */
+	NULL, /* flushtree */
+	NULL, /* nsec3hashname */
 };
 
 static isc_result_t
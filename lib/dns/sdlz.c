@@ -54,6 +54,8 @@
 
 #include <isc/ascii.h>
 #include <isc/buffer.h>
+#include <isc/condition.h>
+#include <isc/ht.h>
 #include <isc/lex.h>
 #include <isc/log.h>
 #include <isc/magic.h>
@@ -63,8 +65,10 @@
 #include <isc/region.h>
 #include <isc/result.h>
 #include <isc/rwlock.h>
+#include <isc/stdtime.h>
 #include <isc/string.h>
 #include <isc/util.h>
+#include <isc/work.h>
 
 #include <dns/callbacks.h>
 #include <dns/db.h>
@@ -96,10 +100,52 @@ struct dns_sdlzimplementation {
 	dns_dlzimplementation_t *dlz_imp;
 };
 
+/*
+ * The size of a cache key: a flag for DNS_DBFIND_NOWILD, the number of
+ * labels of the zone origin, and the lower-cased owner name.
+ */
+#define SDLZ_CACHE_KEYSIZE (2 + DNS_NAME_MAXWIRE)
+
+/*
+ * The number of names a lookup cache holds before it starts dropping
+ * the least recently used ones.
+ */
+#ifndef SDLZ_CACHE_MAXENTRIES
+#define SDLZ_CACHE_MAXENTRIES 10000
+#endif
+
+typedef struct sdlz_cacheent sdlz_cacheent_t;
+
+/*
+ * What the DLZ layer holds as the 'dbdata' of a database using an SDLZ
+ * driver: the driver's own 'dbdata', and the cache of its lookups if
+ * one was set up with dns_sdlz_setcache().
+ */
+typedef struct sdlz_instance {
+	/* Unlocked */
+	isc_mem_t *mctx;
+	void *dbdata;
+
+	/* Set before the first lookup */
+	dns_ttl_t maxttl;
+	dns_ttl_t maxncachettl;
+	isc_ht_t *cache;
+
+	/* Atomic */
+	isc_refcount_t references;
+
+	/* Locked by lock */
+	isc_mutex_t lock;
+	isc_condition_t cond;
+	ISC_LIST(sdlz_cacheent_t) lru;
+	unsigned int ncached;
+} sdlz_instance_t;
+
 struct dns_sdlz_db {
 	/* Unlocked */
 	dns_db_t common;
 	void *dbdata;
+	sdlz_instance_t *instance;
 	dns_sdlzimplementation_t *dlzimp;
 
 	/* Atomic */
@@ -126,11 +172,43 @@ struct dns_sdlzlookup {
 
 typedef struct dns_sdlzlookup dns_sdlznode_t;
 
+struct sdlz_cacheent {
+	dns_sdlznode_t *node; /* NULL if the name does not exist */
+	isc_stdtime_t expire;
+	bool pending; /* Being looked up; not on the LRU list */
+	unsigned int keylen;
+	unsigned char key[SDLZ_CACHE_KEYSIZE];
+	ISC_LINK(sdlz_cacheent_t) link;
+};
+
+/*
+ * The number of names asked of the all nodes from method of a driver at
+ * a time.
+ */
+#ifndef SDLZ_ALLNODES_CHUNK
+#define SDLZ_ALLNODES_CHUNK 256
+#endif
+
+/*
+ * An iterator over the nodes of a zone.  If the driver has an all nodes
+ * from method, 'nodelist' only holds the current chunk of the zone, in
+ * canonical order; otherwise it holds the whole zone, with the origin
+ * first.
+ */
 struct dns_sdlzallnodes {
 	dns_dbiterator_t common;
 	ISC_LIST(dns_sdlznode_t) nodelist;
 	dns_sdlznode_t *current;
 	dns_sdlznode_t *origin;
+
+	/* Only used when the zone is traversed in chunks */
+	bool chunked;
+	bool atstart;		  /* 'nodelist' is the first chunk */
+	bool lastchunk;		  /* 'nodelist' is the last chunk */
+	unsigned int nnames;	  /* names added to the current chunk */
+	bool haslast;		  /* 'last' is set */
+	dns_fixedname_t last;	  /* absolute name of the last node added */
+	char zonestr[DNS_NAME_MAXTEXT + 1];
 };
 
 typedef dns_sdlzallnodes_t sdlz_dbiterator_t;
@@ -197,6 +275,9 @@ list_tordataset(dns_rdatalist_t *rdatalist, dns_db_t *db, dns_dbnode_t *node,
 static void
 detachnode(dns_db_t *db, dns_dbnode_t **targetp);
 
+static void
+cache_flush(sdlz_instance_t *inst);
+
 static void
 dbiterator_destroy(dns_dbiterator_t **iteratorp);
 static isc_result_t
@@ -220,7 +301,8 @@ dbiterator_origin(dns_dbiterator_t *iterator, dns_name_t *name);
 static dns_dbiteratormethods_t dbiterator_methods = {
 	dbiterator_destroy, dbiterator_first, dbiterator_last,
 	dbiterator_seek,    dbiterator_prev,  dbiterator_next,
-	dbiterator_current, dbiterator_pause, dbiterator_origin
+	dbiterator_current, dbiterator_pause, dbiterator_origin,
+	NULL /* currentbatch */
 };
 
 /*
@@ -297,6 +379,31 @@ static dns_rdatasetitermethods_t rdatasetiter_methods = {
 	rdatasetiter_current
 };
 
+static void
+instance_attach(sdlz_instance_t *source, sdlz_instance_t **targetp) {
+	isc_refcount_increment(&source->references);
+
+	*targetp = source;
+}
+
+static void
+instance_detach(sdlz_instance_t **instp) {
+	sdlz_instance_t *inst = *instp;
+
+	*instp = NULL;
+
+	if (isc_refcount_decrement(&inst->references) == 1) {
+		isc_refcount_destroy(&inst->references);
+		INSIST(inst->ncached == 0);
+		if (inst->cache != NULL) {
+			isc_ht_destroy(&inst->cache);
+		}
+		isc_condition_destroy(&inst->cond);
+		isc_mutex_destroy(&inst->lock);
+		isc_mem_putanddetach(&inst->mctx, inst, sizeof(*inst));
+	}
+}
+
 /*
  * DB routines. These methods were "borrowed" from the SDB driver interface.
  * See the SDB driver interface documentation for more info.
@@ -319,6 +426,7 @@ destroy(dns_sdlz_db_t *sdlz) {
 	sdlz->common.impmagic = 0;
 
 	dns_name_free(&sdlz->common.origin, sdlz->common.mctx);
+	instance_detach(&sdlz->instance);
 
 	isc_refcount_destroy(&sdlz->references);
 	isc_mem_putanddetach(&sdlz->common.mctx, sdlz, sizeof(dns_sdlz_db_t));
@@ -435,6 +543,13 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp, bool commit) {
 			 origin);
 	}
 
+	/*
+	 * The names the update touched may be cached.
+	 */
+	if (commit) {
+		cache_flush(sdlz->instance);
+	}
+
 	sdlz->future_version = NULL;
 }
 
@@ -501,10 +616,170 @@ destroynode(dns_sdlznode_t *node) {
 	detach(&db);
 }
 
+static void
+releasenode(dns_sdlznode_t **nodep) {
+	dns_sdlznode_t *node = *nodep;
+
+	*nodep = NULL;
+
+	if (isc_refcount_decrement(&node->references) == 1) {
+		destroynode(node);
+	}
+}
+
+/*
+ * The lookup cache.
+ *
+ * Each entry holds a reference to the node a lookup returned, or
+ * records that the name does not exist, until the TTL of the node
+ * (capped to 'maxttl') or 'maxncachettl' has passed.  While a name is
+ * being looked up in the driver, its entry is marked pending and other
+ * lookups of the same name wait for it rather than asking the driver
+ * again.
+ */
+
+static void
+cache_remove(sdlz_instance_t *inst, sdlz_cacheent_t *ent) {
+	isc_result_t result;
+
+	result = isc_ht_delete(inst->cache, ent->key, ent->keylen);
+	INSIST(result == ISC_R_SUCCESS);
+	if (ent->node != NULL) {
+		releasenode(&ent->node);
+	}
+	isc_mem_put(inst->mctx, ent, sizeof(*ent));
+	inst->ncached--;
+}
+
+static void
+cache_flush(sdlz_instance_t *inst) {
+	sdlz_cacheent_t *ent = NULL;
+
+	if (inst->cache == NULL) {
+		return;
+	}
+
+	LOCK(&inst->lock);
+	while ((ent = ISC_LIST_HEAD(inst->lru)) != NULL) {
+		ISC_LIST_UNLINK(inst->lru, ent, link);
+		cache_remove(inst, ent);
+	}
+	UNLOCK(&inst->lock);
+}
+
+/*
+ * Look up 'key' in the cache of 'inst'.  If it has a live entry, return
+ * true with the result of the lookup in '*resultp' and, if the name
+ * exists, its node attached to '*nodep'.  Otherwise mark 'key' as being
+ * looked up and return false; the caller must then look it up and call
+ * cache_put().
+ */
+static bool
+cache_get(sdlz_instance_t *inst, const unsigned char *key,
+	  unsigned int keylen, isc_stdtime_t now, isc_result_t *resultp,
+	  dns_sdlznode_t **nodep) {
+	sdlz_cacheent_t *ent = NULL;
+	isc_result_t result;
+
+	LOCK(&inst->lock);
+	for (;;) {
+		ent = NULL;
+		result = isc_ht_find(inst->cache, key, keylen, (void **)&ent);
+		if (result != ISC_R_SUCCESS || !ent->pending) {
+			break;
+		}
+		WAIT(&inst->cond, &inst->lock);
+	}
+
+	if (ent != NULL) {
+		ISC_LIST_UNLINK(inst->lru, ent, link);
+		if (ent->expire > now) {
+			ISC_LIST_APPEND(inst->lru, ent, link);
+			if (ent->node != NULL) {
+				isc_refcount_increment(&ent->node->references);
+				*nodep = ent->node;
+				*resultp = ISC_R_SUCCESS;
+			} else {
+				*resultp = ISC_R_NOTFOUND;
+			}
+			UNLOCK(&inst->lock);
+			return (true);
+		}
+		if (ent->node != NULL) {
+			releasenode(&ent->node);
+		}
+	} else {
+		if (inst->ncached >= SDLZ_CACHE_MAXENTRIES &&
+		    !ISC_LIST_EMPTY(inst->lru))
+		{
+			ent = ISC_LIST_HEAD(inst->lru);
+			ISC_LIST_UNLINK(inst->lru, ent, link);
+			cache_remove(inst, ent);
+		}
+
+		ent = isc_mem_get(inst->mctx, sizeof(*ent));
+		*ent = (sdlz_cacheent_t){ .keylen = keylen };
+		memmove(ent->key, key, keylen);
+		ISC_LINK_INIT(ent, link);
+		result = isc_ht_add(inst->cache, ent->key, ent->keylen, ent);
+		INSIST(result == ISC_R_SUCCESS);
+		inst->ncached++;
+	}
+	ent->pending = true;
+	UNLOCK(&inst->lock);
+
+	return (false);
+}
+
+/*
+ * Record the result of the lookup of 'key' started by cache_get(), and
+ * wake up the lookups waiting for it.
+ */
+static void
+cache_put(sdlz_instance_t *inst, const unsigned char *key,
+	  unsigned int keylen, isc_stdtime_t now, isc_result_t lookup,
+	  dns_sdlznode_t *node) {
+	sdlz_cacheent_t *ent = NULL;
+	isc_result_t result;
+	dns_ttl_t ttl = 0;
+
+	if (lookup == ISC_R_SUCCESS) {
+		dns_rdatalist_t *list = NULL;
+
+		ttl = inst->maxttl;
+		for (list = ISC_LIST_HEAD(node->lists); list != NULL;
+		     list = ISC_LIST_NEXT(list, link))
+		{
+			ttl = ISC_MIN(ttl, list->ttl);
+		}
+	} else if (lookup == ISC_R_NOTFOUND) {
+		ttl = inst->maxncachettl;
+	}
+
+	LOCK(&inst->lock);
+	result = isc_ht_find(inst->cache, key, keylen, (void **)&ent);
+	INSIST(result == ISC_R_SUCCESS && ent->pending);
+
+	if (ttl == 0) {
+		cache_remove(inst, ent);
+	} else {
+		ent->pending = false;
+		ent->expire = now + ttl;
+		if (node != NULL) {
+			isc_refcount_increment(&node->references);
+			ent->node = node;
+		}
+		ISC_LIST_APPEND(inst->lru, ent, link);
+	}
+
+	BROADCAST(&inst->cond);
+	UNLOCK(&inst->lock);
+}
+
 static isc_result_t
-getnodedata(dns_db_t *db, const dns_name_t *name, bool create,
-	    unsigned int options, dns_clientinfomethods_t *methods,
-	    dns_clientinfo_t *clientinfo, dns_dbnode_t **nodep) {
+lookupnode(dns_db_t *db, const dns_name_t *name, bool create,
+	   unsigned int options, dns_clientinfomethods_t *methods,
+	   dns_clientinfo_t *clientinfo, dns_dbnode_t **nodep) {
 	dns_sdlz_db_t *sdlz = (dns_sdlz_db_t *)db;
 	dns_sdlznode_t *node = NULL;
 	isc_result_t result;
@@ -515,9 +790,6 @@ getnodedata(dns_db_t *db, const dns_name_t *name, bool create,
 	bool isorigin;
 	dns_sdlzauthorityfunc_t authority;
 
-	REQUIRE(VALID_SDLZDB(sdlz));
-	REQUIRE(nodep != NULL && *nodep == NULL);
-
 	if (sdlz->dlzimp->methods->newversion == NULL) {
 		REQUIRE(!create);
 	}
@@ -656,6 +928,61 @@ getnodedata(dns_db_t *db, const dns_name_t *name, bool create,
 	return (ISC_R_SUCCESS);
 }
 
+static unsigned int
+cache_key(dns_sdlz_db_t *sdlz, const dns_name_t *name, unsigned int options,
+	  unsigned char *key) {
+	INSIST(name->length <= DNS_NAME_MAXWIRE);
+
+	key[0] = ((options & DNS_DBFIND_NOWILD) != 0);
+	key[1] = dns_name_countlabels(&sdlz->common.origin);
+	isc_ascii_lowercopy(key + 2, name->ndata, name->length);
+
+	return (2 + name->length);
+}
+
+static isc_result_t
+getnodedata(dns_db_t *db, const dns_name_t *name, bool create,
+	    unsigned int options, dns_clientinfomethods_t *methods,
+	    dns_clientinfo_t *clientinfo, dns_dbnode_t **nodep) {
+	dns_sdlz_db_t *sdlz = (dns_sdlz_db_t *)db;
+	sdlz_instance_t *inst = NULL;
+	dns_sdlznode_t *node = NULL;
+	unsigned char key[SDLZ_CACHE_KEYSIZE];
+	unsigned int keylen;
+	isc_stdtime_t now;
+	isc_result_t result;
+
+	REQUIRE(VALID_SDLZDB(sdlz));
+	REQUIRE(nodep != NULL && *nodep == NULL);
+
+	/*
+	 * The client is not part of the cache key: the cache must only
+	 * be set up for drivers whose answers do not depend on it.
+	 */
+	inst = sdlz->instance;
+	if (create || inst->cache == NULL) {
+		return (lookupnode(db, name, create, options, methods,
+				   clientinfo, nodep));
+	}
+
+	keylen = cache_key(sdlz, name, options, key);
+
+	isc_stdtime_get(&now);
+	if (cache_get(inst, key, keylen, now, &result, &node)) {
+		*nodep = node;
+		return (result);
+	}
+
+	result = lookupnode(db, name, create, options, methods, clientinfo,
+			    (dns_dbnode_t **)&node);
+	cache_put(inst, key, keylen, now, result, node);
+	if (result == ISC_R_SUCCESS) {
+		*nodep = node;
+	}
+
+	return (result);
+}
+
 static isc_result_t
 findnodeext(dns_db_t *db, const dns_name_t *name, bool create,
 	    dns_clientinfomethods_t *methods, dns_clientinfo_t *clientinfo,
@@ -735,6 +1062,9 @@ printnode(dns_db_t *db, dns_dbnode_t *node, FILE *out) {
 	return;
 }
 
+static isc_result_t
+fetchchunk(sdlz_dbiterator_t *sdlziter, const dns_name_t *start);
+
 static isc_result_t
 createiterator(dns_db_t *db, unsigned int options,
 	       dns_dbiterator_t **iteratorp) {
@@ -746,7 +1076,9 @@ createiterator(dns_db_t *db, unsigned int options,
 
 	REQUIRE(VALID_SDLZDB(sdlz));
 
-	if (sdlz->dlzimp->methods->allnodes == NULL) {
+	if (sdlz->dlzimp->methods->allnodes == NULL &&
+	    sdlz->dlzimp->methods->allnodesfrom == NULL)
+	{
 		return (ISC_R_NOTIMPLEMENTED);
 	}
 
@@ -773,10 +1105,34 @@ createiterator(dns_db_t *db, unsigned int options,
 	ISC_LIST_INIT(sdlziter->nodelist);
 	sdlziter->current = NULL;
 	sdlziter->origin = NULL;
+	sdlziter->chunked = false;
+	sdlziter->atstart = false;
+	sdlziter->lastchunk = false;
+	sdlziter->nnames = 0;
+	sdlziter->haslast = false;
+	dns_fixedname_init(&sdlziter->last);
 
 	/* make sure strings are always lowercase */
 	isc_ascii_strtolower(zonestr);
 
+	if (sdlz->dlzimp->methods->allnodesfrom != NULL) {
+		strlcpy(sdlziter->zonestr, zonestr, sizeof(sdlziter->zonestr));
+		sdlziter->chunked = true;
+		result = fetchchunk(sdlziter, NULL);
+		if (result == ISC_R_SUCCESS) {
+			*iteratorp = (dns_dbiterator_t *)sdlziter;
+			return (ISC_R_SUCCESS);
+		}
+		sdlziter->chunked = false;
+		if (result != ISC_R_NOTIMPLEMENTED ||
+		    sdlz->dlzimp->methods->allnodes == NULL)
+		{
+			dns_dbiterator_t *iter = &sdlziter->common;
+			dbiterator_destroy(&iter);
+			return (result);
+		}
+	}
+
 	MAYBE_LOCK(sdlz->dlzimp);
 	result = sdlz->dlzimp->methods->allnodes(
 		zonestr, sdlz->dlzimp->driverarg, sdlz->dbdata, sdlziter);
@@ -1252,6 +1608,12 @@ static dns_dbmethods_t sdlzdb_methods = {
 	NULL,				      /* setservestalerefresh */
 	NULL,				      /* getservestalerefresh */
 	NULL,				      /* setgluecachestats */
+	NULL,				      /* setevictionpolicy */
+	NULL,				      /* getmemory */
+	NULL,				      /* expire */
+	NULL,				      /* setcoldtier */
+	NULL,				      /* flushtree */
+	NULL,				      /* nsec3hashname */
 };
 
 /*
@@ -1260,18 +1622,70 @@ static dns_dbmethods_t sdlzdb_methods = {
  */
 
 static void
-dbiterator_destroy(dns_dbiterator_t **iteratorp) {
-	sdlz_dbiterator_t *sdlziter = (sdlz_dbiterator_t *)(*iteratorp);
-	dns_sdlz_db_t *sdlz = (dns_sdlz_db_t *)sdlziter->common.db;
-
+clearnodes(sdlz_dbiterator_t *sdlziter) {
 	while (!ISC_LIST_EMPTY(sdlziter->nodelist)) {
 		dns_sdlznode_t *node;
 		node = ISC_LIST_HEAD(sdlziter->nodelist);
 		ISC_LIST_UNLINK(sdlziter->nodelist, node, link);
-		isc_refcount_decrementz(&node->references);
-		destroynode(node);
+		releasenode(&node);
+	}
+	sdlziter->current = NULL;
+	sdlziter->origin = NULL;
+}
+
+/*
+ * Replace the nodes of 'sdlziter' with the next chunk of the zone,
+ * from 'start' on, or from the apex if 'start' is NULL.  If
+ * 'sdlziter->haslast' is set, a node named 'start' is not added again,
+ * as it is the last node of the previous chunk; see
+ * dns_sdlz_putnamedrr().
+ */
+static isc_result_t
+fetchchunk(sdlz_dbiterator_t *sdlziter, const dns_name_t *start) {
+	dns_sdlz_db_t *sdlz = (dns_sdlz_db_t *)sdlziter->common.db;
+	char startstr[DNS_NAME_MAXTEXT + 1];
+	const char *startp = NULL;
+	isc_buffer_t b;
+	isc_result_t result;
+
+	if (start != NULL) {
+		isc_buffer_init(&b, startstr, sizeof(startstr));
+		result = dns_name_totext(start, true, &b);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+		isc_buffer_putuint8(&b, 0);
+		isc_ascii_strtolower(startstr);
+		startp = startstr;
 	}
 
+	clearnodes(sdlziter);
+	sdlziter->atstart = (start == NULL);
+	sdlziter->nnames = 0;
+
+	MAYBE_LOCK(sdlz->dlzimp);
+	result = sdlz->dlzimp->methods->allnodesfrom(
+		sdlziter->zonestr, startp, SDLZ_ALLNODES_CHUNK,
+		sdlz->dlzimp->driverarg, sdlz->dbdata, sdlziter);
+	MAYBE_UNLOCK(sdlz->dlzimp);
+	if (result != ISC_R_SUCCESS) {
+		clearnodes(sdlziter);
+		sdlziter->atstart = false;
+		return (result);
+	}
+
+	sdlziter->lastchunk = (sdlziter->nnames < SDLZ_ALLNODES_CHUNK);
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+dbiterator_destroy(dns_dbiterator_t **iteratorp) {
+	sdlz_dbiterator_t *sdlziter = (sdlz_dbiterator_t *)(*iteratorp);
+	dns_sdlz_db_t *sdlz = (dns_sdlz_db_t *)sdlziter->common.db;
+
+	clearnodes(sdlziter);
+
 	dns_db_detach(&sdlziter->common.db);
 	isc_mem_put(sdlz->common.mctx, sdlziter, sizeof(sdlz_dbiterator_t));
 
@@ -1282,6 +1696,16 @@ static isc_result_t
 dbiterator_first(dns_dbiterator_t *iterator) {
 	sdlz_dbiterator_t *sdlziter = (sdlz_dbiterator_t *)iterator;
 
+	if (sdlziter->chunked && !sdlziter->atstart) {
+		isc_result_t result;
+
+		sdlziter->haslast = false;
+		result = fetchchunk(sdlziter, NULL);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
+
 	sdlziter->current = ISC_LIST_HEAD(sdlziter->nodelist);
 	if (sdlziter->current == NULL) {
 		return (ISC_R_NOMORE);
@@ -1294,6 +1718,10 @@ static isc_result_t
 dbiterator_last(dns_dbiterator_t *iterator) {
 	sdlz_dbiterator_t *sdlziter = (sdlz_dbiterator_t *)iterator;
 
+	if (sdlziter->chunked) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
 	sdlziter->current = ISC_LIST_TAIL(sdlziter->nodelist);
 	if (sdlziter->current == NULL) {
 		return (ISC_R_NOMORE);
@@ -1306,6 +1734,35 @@ static isc_result_t
 dbiterator_seek(dns_dbiterator_t *iterator, const dns_name_t *name) {
 	sdlz_dbiterator_t *sdlziter = (sdlz_dbiterator_t *)iterator;
 
+	if (sdlziter->chunked) {
+		dns_fixedname_t fstart;
+		dns_name_t *start = dns_fixedname_initname(&fstart);
+		isc_result_t result;
+
+		if (dns_name_isabsolute(name)) {
+			dns_name_copy(name, start);
+		} else {
+			result = dns_name_concatenate(name, dns_rootname,
+						      start, NULL);
+			if (result != ISC_R_SUCCESS) {
+				return (result);
+			}
+		}
+
+		sdlziter->haslast = false;
+		result = fetchchunk(sdlziter, start);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+		sdlziter->current = ISC_LIST_HEAD(sdlziter->nodelist);
+		if (sdlziter->current == NULL ||
+		    !dns_name_equal(sdlziter->current->name, name))
+		{
+			return (ISC_R_NOTFOUND);
+		}
+		return (ISC_R_SUCCESS);
+	}
+
 	sdlziter->current = ISC_LIST_HEAD(sdlziter->nodelist);
 	while (sdlziter->current != NULL) {
 		if (dns_name_equal(sdlziter->current->name, name)) {
@@ -1320,6 +1777,10 @@ static isc_result_t
 dbiterator_prev(dns_dbiterator_t *iterator) {
 	sdlz_dbiterator_t *sdlziter = (sdlz_dbiterator_t *)iterator;
 
+	if (sdlziter->chunked) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
 	sdlziter->current = ISC_LIST_PREV(sdlziter->current, link);
 	if (sdlziter->current == NULL) {
 		return (ISC_R_NOMORE);
@@ -1333,6 +1794,21 @@ dbiterator_next(dns_dbiterator_t *iterator) {
 	sdlz_dbiterator_t *sdlziter = (sdlz_dbiterator_t *)iterator;
 
 	sdlziter->current = ISC_LIST_NEXT(sdlziter->current, link);
+	if (sdlziter->current == NULL && sdlziter->chunked &&
+	    !sdlziter->lastchunk)
+	{
+		dns_fixedname_t fstart;
+		dns_name_t *start = dns_fixedname_initname(&fstart);
+		isc_result_t result;
+
+		INSIST(sdlziter->haslast);
+		dns_name_copy(dns_fixedname_name(&sdlziter->last), start);
+		result = fetchchunk(sdlziter, start);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+		sdlziter->current = ISC_LIST_HEAD(sdlziter->nodelist);
+	}
 	if (sdlziter->current == NULL) {
 		return (ISC_R_NOMORE);
 	} else {
@@ -1446,12 +1922,14 @@ dns_sdlzcreateDBP(isc_mem_t *mctx, void *driverarg, void *dbdata,
 	isc_result_t result;
 	dns_sdlz_db_t *sdlzdb;
 	dns_sdlzimplementation_t *imp;
+	sdlz_instance_t *inst;
 
 	/* check that things are as we expect */
 	REQUIRE(dbp != NULL && *dbp == NULL);
 	REQUIRE(name != NULL);
 
 	imp = (dns_sdlzimplementation_t *)driverarg;
+	inst = (sdlz_instance_t *)dbdata;
 
 	/* allocate and zero memory for driver structure */
 	sdlzdb = isc_mem_get(mctx, sizeof(dns_sdlz_db_t));
@@ -1470,7 +1948,8 @@ dns_sdlzcreateDBP(isc_mem_t *mctx, void *driverarg, void *dbdata,
 	sdlzdb->common.attributes = 0;
 	sdlzdb->common.rdclass = rdclass;
 	sdlzdb->common.mctx = NULL;
-	sdlzdb->dbdata = dbdata;
+	sdlzdb->dbdata = inst->dbdata;
+	instance_attach(inst, &sdlzdb->instance);
 	isc_refcount_init(&sdlzdb->references, 1);
 
 	/* attach to the memory context */
@@ -1500,6 +1979,7 @@ dns_sdlzallowzonexfr(void *driverarg, void *dbdata, isc_mem_t *mctx,
 	isc_netaddr_t netaddr;
 	isc_result_t result;
 	dns_sdlzimplementation_t *imp;
+	sdlz_instance_t *inst;
 
 	/*
 	 * Perform checks to make sure data is as we expect it to be.
@@ -1510,6 +1990,7 @@ dns_sdlzallowzonexfr(void *driverarg, void *dbdata, isc_mem_t *mctx,
 	REQUIRE(dbp != NULL && *dbp == NULL);
 
 	imp = (dns_sdlzimplementation_t *)driverarg;
+	inst = (sdlz_instance_t *)dbdata;
 
 	/* Convert DNS name to ascii text */
 	isc_buffer_init(&b, namestr, sizeof(namestr));
@@ -1537,8 +2018,8 @@ dns_sdlzallowzonexfr(void *driverarg, void *dbdata, isc_mem_t *mctx,
 		isc_result_t rresult = ISC_R_SUCCESS;
 
 		MAYBE_LOCK(imp);
-		result = imp->methods->allowzonexfr(imp->driverarg, dbdata,
-						    namestr, clientstr);
+		result = imp->methods->allowzonexfr(
+			imp->driverarg, inst->dbdata, namestr, clientstr);
 		MAYBE_UNLOCK(imp);
 		/*
 		 * if zone is supported and transfers are (or might be)
@@ -1561,6 +2042,7 @@ static isc_result_t
 dns_sdlzcreate(isc_mem_t *mctx, const char *dlzname, unsigned int argc,
 	       char *argv[], void *driverarg, void **dbdata) {
 	dns_sdlzimplementation_t *imp;
+	sdlz_instance_t *inst;
 	isc_result_t result = ISC_R_NOTFOUND;
 
 	/* Write debugging message to log */
@@ -1572,23 +2054,32 @@ dns_sdlzcreate(isc_mem_t *mctx, const char *dlzname, unsigned int argc,
 	REQUIRE(driverarg != NULL);
 	REQUIRE(dlzname != NULL);
 	REQUIRE(dbdata != NULL);
-	UNUSED(mctx);
 
 	imp = driverarg;
 
+	inst = isc_mem_get(mctx, sizeof(*inst));
+	*inst = (sdlz_instance_t){ .dbdata = NULL };
+	isc_mem_attach(mctx, &inst->mctx);
+	isc_refcount_init(&inst->references, 1);
+	isc_mutex_init(&inst->lock);
+	isc_condition_init(&inst->cond);
+	ISC_LIST_INIT(inst->lru);
+
 	/* If the create method exists, call it. */
 	if (imp->methods->create != NULL) {
 		MAYBE_LOCK(imp);
 		result = imp->methods->create(dlzname, argc, argv,
-					      imp->driverarg, dbdata);
+					      imp->driverarg, &inst->dbdata);
 		MAYBE_UNLOCK(imp);
 	}
 
 	/* Write debugging message to log */
 	if (result == ISC_R_SUCCESS) {
 		sdlz_log(ISC_LOG_DEBUG(2), "SDLZ driver loaded successfully.");
+		*dbdata = inst;
 	} else {
 		sdlz_log(ISC_LOG_ERROR, "SDLZ driver failed to load.");
+		instance_detach(&inst);
 	}
 
 	return (result);
@@ -1597,18 +2088,28 @@ dns_sdlzcreate(isc_mem_t *mctx, const char *dlzname, unsigned int argc,
 static void
 dns_sdlzdestroy(void *driverdata, void **dbdata) {
 	dns_sdlzimplementation_t *imp;
+	sdlz_instance_t *inst;
 
 	/* Write debugging message to log */
 	sdlz_log(ISC_LOG_DEBUG(2), "Unloading SDLZ driver.");
 
 	imp = driverdata;
+	inst = (sdlz_instance_t *)dbdata;
+
+	/*
+	 * The cached nodes hold references to the databases they were
+	 * looked up in, which in turn hold references to 'inst'.
+	 */
+	cache_flush(inst);
 
 	/* If the destroy method exists, call it. */
 	if (imp->methods->destroy != NULL) {
 		MAYBE_LOCK(imp);
-		imp->methods->destroy(imp->driverarg, dbdata);
+		imp->methods->destroy(imp->driverarg, inst->dbdata);
 		MAYBE_UNLOCK(imp);
 	}
+
+	instance_detach(&inst);
 }
 
 static isc_result_t
@@ -1620,6 +2121,7 @@ dns_sdlzfindzone(void *driverarg, void *dbdata, isc_mem_t *mctx,
 	char namestr[DNS_NAME_MAXTEXT + 1];
 	isc_result_t result;
 	dns_sdlzimplementation_t *imp;
+	sdlz_instance_t *inst;
 
 	/*
 	 * Perform checks to make sure data is as we expect it to be.
@@ -1629,6 +2131,7 @@ dns_sdlzfindzone(void *driverarg, void *dbdata, isc_mem_t *mctx,
 	REQUIRE(dbp != NULL && *dbp == NULL);
 
 	imp = (dns_sdlzimplementation_t *)driverarg;
+	inst = (sdlz_instance_t *)dbdata;
 
 	/* Convert DNS name to ascii text */
 	isc_buffer_init(&b, namestr, sizeof(namestr));
@@ -1643,7 +2146,7 @@ dns_sdlzfindzone(void *driverarg, void *dbdata, isc_mem_t *mctx,
 
 	/* Call SDLZ driver's find zone method */
 	MAYBE_LOCK(imp);
-	result = imp->methods->findzone(imp->driverarg, dbdata, namestr,
+	result = imp->methods->findzone(imp->driverarg, inst->dbdata, namestr,
 					methods, clientinfo);
 	MAYBE_UNLOCK(imp);
 
@@ -1672,8 +2175,9 @@ dns_sdlzconfigure(void *driverarg, void *dbdata, dns_view_t *view,
 	/* Call SDLZ driver's configure method */
 	if (imp->methods->configure != NULL) {
 		MAYBE_LOCK(imp);
-		result = imp->methods->configure(view, dlzdb, imp->driverarg,
-						 dbdata);
+		result = imp->methods->configure(
+			view, dlzdb, imp->driverarg,
+			((sdlz_instance_t *)dbdata)->dbdata);
 		MAYBE_UNLOCK(imp);
 	} else {
 		result = ISC_R_SUCCESS;
@@ -1740,7 +2244,8 @@ dns_sdlzssumatch(const dns_name_t *signer, const dns_name_t *name,
 	ret = imp->methods->ssumatch(b_signer, b_name, b_addr, b_type, b_key,
 				     token_len,
 				     token_len != 0 ? token_region.base : NULL,
-				     imp->driverarg, dbdata);
+				     imp->driverarg,
+				     ((sdlz_instance_t *)dbdata)->dbdata);
 	MAYBE_UNLOCK(imp);
 	return (ret);
 }
@@ -1876,6 +2381,62 @@ failure:
 	return (result);
 }
 
+/*
+ * Add a record to a chunk of a zone, where the names must come in
+ * canonical order.  The records of the name a chunk starts with are
+ * dropped if they were already in the previous chunk.
+ */
+static isc_result_t
+putchunkrr(dns_sdlzallnodes_t *allnodes, dns_name_t *name, const char *type,
+	   dns_ttl_t ttl, const char *data) {
+	dns_sdlz_db_t *sdlz = (dns_sdlz_db_t *)allnodes->common.db;
+	dns_name_t *last = dns_fixedname_name(&allnodes->last);
+	dns_sdlznode_t *sdlznode = NULL;
+	isc_mem_t *mctx = sdlz->common.mctx;
+	isc_result_t result;
+	int order = 1;
+
+	if (allnodes->haslast) {
+		order = dns_name_compare(name, last);
+	}
+	if (order < 0) {
+		sdlz_log(ISC_LOG_ERROR,
+			 "dlz allnodes: names not in canonical order");
+		return (ISC_R_RANGE);
+	}
+	if (order > 0 || allnodes->nnames == 0) {
+		allnodes->nnames++;
+	}
+	if (order == 0) {
+		sdlznode = ISC_LIST_TAIL(allnodes->nodelist);
+		if (sdlznode == NULL) {
+			/* Returned with the previous chunk */
+			return (ISC_R_SUCCESS);
+		}
+		return (dns_sdlz_putrr(sdlznode, type, ttl, data));
+	}
+
+	dns_name_copy(name, last);
+	allnodes->haslast = true;
+
+	if (allnodes->common.relative_names) {
+		/* All names are relative to the root */
+		unsigned int nlabels = dns_name_countlabels(name);
+		dns_name_getlabelsequence(name, 0, nlabels - 1, name);
+	}
+
+	result = createnode(sdlz, &sdlznode);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	sdlznode->name = isc_mem_get(mctx, sizeof(dns_name_t));
+	dns_name_init(sdlznode->name, NULL);
+	dns_name_dup(name, mctx, sdlznode->name);
+	ISC_LIST_APPEND(allnodes->nodelist, sdlznode, link);
+
+	return (dns_sdlz_putrr(sdlznode, type, ttl, data));
+}
+
 isc_result_t
 dns_sdlz_putnamedrr(dns_sdlzallnodes_t *allnodes, const char *name,
 		    const char *type, dns_ttl_t ttl, const char *data) {
@@ -1903,6 +2464,10 @@ dns_sdlz_putnamedrr(dns_sdlzallnodes_t *allnodes, const char *name,
 		return (result);
 	}
 
+	if (allnodes->chunked) {
+		return (putchunkrr(allnodes, newname, type, ttl, data));
+	}
+
 	if (allnodes->common.relative_names) {
 		/* All names are relative to the root */
 		unsigned int nlabels = dns_name_countlabels(newname);
@@ -2063,3 +2628,130 @@ dns_sdlz_setdb(dns_dlzdb_t *dlzdatabase, dns_rdataclass_t rdclass,
 				   dlzdatabase->dbdata, name, rdclass, dbp);
 	return (result);
 }
+
+isc_result_t
+dns_sdlz_setcache(dns_dlzdb_t *dlzdatabase, dns_ttl_t maxttl,
+		  dns_ttl_t maxncachettl) {
+	sdlz_instance_t *inst;
+
+	REQUIRE(DNS_DLZ_VALID(dlzdatabase));
+
+	if (dlzdatabase->implementation->methods != &sdlzmethods) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	inst = (sdlz_instance_t *)dlzdatabase->dbdata;
+	REQUIRE(inst->cache == NULL);
+
+	if (maxttl == 0 && maxncachettl == 0) {
+		return (ISC_R_SUCCESS);
+	}
+
+	inst->maxttl = maxttl;
+	inst->maxncachettl = maxncachettl;
+	isc_ht_init(&inst->cache, inst->mctx, 10, ISC_HT_CASE_SENSITIVE);
+
+	return (ISC_R_SUCCESS);
+}
+
+bool
+dns_sdlz_wouldblock(dns_db_t *db, const dns_name_t *name,
+		    unsigned int options) {
+	dns_sdlz_db_t *sdlz = (dns_sdlz_db_t *)db;
+	sdlz_instance_t *inst = NULL;
+	sdlz_cacheent_t *ent = NULL;
+	unsigned char key[SDLZ_CACHE_KEYSIZE];
+	unsigned int keylen;
+	isc_stdtime_t now;
+	bool cached = false;
+
+	REQUIRE(DNS_DB_VALID(db));
+
+	if (!VALID_SDLZDB(sdlz) || sdlz->instance->cache == NULL ||
+	    !dns_name_issubdomain(name, &db->origin))
+	{
+		return (false);
+	}
+
+	inst = sdlz->instance;
+	keylen = cache_key(sdlz, name, options, key);
+	isc_stdtime_get(&now);
+
+	LOCK(&inst->lock);
+	if (isc_ht_find(inst->cache, key, keylen, (void **)&ent) ==
+	    ISC_R_SUCCESS)
+	{
+		cached = (!ent->pending && ent->expire > now);
+	}
+	UNLOCK(&inst->lock);
+
+	return (!cached);
+}
+
+typedef struct sdlz_prefetch {
+	isc_mem_t *mctx;
+	dns_db_t *db;
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	dns_rdatatype_t type;
+	unsigned int options;
+	isc_job_cb cb;
+	void *cbarg;
+} sdlz_prefetch_t;
+
+static void
+prefetch_work(void *arg) {
+	sdlz_prefetch_t *prefetch = arg;
+	dns_fixedname_t found;
+	dns_rdataset_t rdataset;
+	isc_stdtime_t now;
+
+	dns_fixedname_init(&found);
+	dns_rdataset_init(&rdataset);
+	isc_stdtime_get(&now);
+
+	/*
+	 * Only the lookups made on the way matter: they leave the nodes
+	 * in the cache, where the caller will find them.
+	 */
+	(void)findext(prefetch->db, prefetch->name, NULL, prefetch->type,
+		      prefetch->options, now, NULL, dns_fixedname_name(&found),
+		      NULL, NULL, &rdataset, NULL);
+	if (dns_rdataset_isassociated(&rdataset)) {
+		dns_rdataset_disassociate(&rdataset);
+	}
+}
+
+static void
+prefetch_done(void *arg) {
+	sdlz_prefetch_t *prefetch = arg;
+
+	(prefetch->cb)(prefetch->cbarg);
+
+	dns_db_detach(&prefetch->db);
+	isc_mem_putanddetach(&prefetch->mctx, prefetch, sizeof(*prefetch));
+}
+
+void
+dns_sdlz_prefetch(dns_db_t *db, const dns_name_t *name, dns_rdatatype_t type,
+		  unsigned int options, isc_loop_t *loop, isc_job_cb cb,
+		  void *cbarg) {
+	sdlz_prefetch_t *prefetch = NULL;
+
+	REQUIRE(VALID_SDLZDB((dns_sdlz_db_t *)db));
+	REQUIRE(cb != NULL);
+
+	prefetch = isc_mem_get(db->mctx, sizeof(*prefetch));
+	*prefetch = (sdlz_prefetch_t){
+		.type = type,
+		.options = options,
+		.cb = cb,
+		.cbarg = cbarg,
+	};
+	isc_mem_attach(db->mctx, &prefetch->mctx);
+	dns_db_attach(db, &prefetch->db);
+	prefetch->name = dns_fixedname_initname(&prefetch->fname);
+	dns_name_copy(name, prefetch->name);
+
+	isc_work_enqueue(loop, prefetch_work, prefetch_done, prefetch);
+}
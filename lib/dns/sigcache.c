@@ -0,0 +1,289 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <isc/buffer.h>
+#include <isc/md.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/serial.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdataset.h>
+#include <dns/sigcache.h>
+
+#define SIGCACHE_MAGIC	  ISC_MAGIC('S', 'i', 'g', 'C')
+#define VALID_SIGCACHE(c) ISC_MAGIC_VALID(c, SIGCACHE_MAGIC)
+
+/*
+ * Number of locks protecting the slots; slot 'i' is protected by
+ * lock 'i % SIGCACHE_NLOCKS'.
+ */
+#define SIGCACHE_NLOCKS 64
+
+#define CHECK(x)                             \
+	do {                                 \
+		result = (x);                \
+		if (result != ISC_R_SUCCESS) \
+			goto cleanup;        \
+	} while (0)
+
+typedef struct sigentry {
+	unsigned char digest[DNS_SIGCACHE_DIGESTLENGTH];
+	isc_stdtime_t expire;
+	uint32_t cost;
+	isc_result_t result;
+	bool used;
+} sigentry_t;
+
+struct dns_sigcache {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	unsigned int size;
+	isc_mutex_t locks[SIGCACHE_NLOCKS];
+	sigentry_t *entries;
+};
+
+void
+dns_sigcache_create(isc_mem_t *mctx, unsigned int size,
+		    dns_sigcache_t **cachep) {
+	dns_sigcache_t *cache = NULL;
+	unsigned int slots = SIGCACHE_NLOCKS;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(size > 0);
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	while (slots < size && slots < (1U << 30)) {
+		slots <<= 1;
+	}
+
+	cache = isc_mem_get(mctx, sizeof(*cache));
+	*cache = (dns_sigcache_t){ .size = slots };
+
+	isc_mem_attach(mctx, &cache->mctx);
+	for (size_t i = 0; i < SIGCACHE_NLOCKS; i++) {
+		isc_mutex_init(&cache->locks[i]);
+	}
+	cache->entries = isc_mem_get(mctx, slots * sizeof(cache->entries[0]));
+	memset(cache->entries, 0, slots * sizeof(cache->entries[0]));
+
+	cache->magic = SIGCACHE_MAGIC;
+
+	*cachep = cache;
+}
+
+void
+dns_sigcache_destroy(dns_sigcache_t **cachep) {
+	dns_sigcache_t *cache = NULL;
+
+	REQUIRE(cachep != NULL && VALID_SIGCACHE(*cachep));
+
+	cache = *cachep;
+	*cachep = NULL;
+
+	cache->magic = 0;
+	isc_mem_put(cache->mctx, cache->entries,
+		    cache->size * sizeof(cache->entries[0]));
+	for (size_t i = 0; i < SIGCACHE_NLOCKS; i++) {
+		isc_mutex_destroy(&cache->locks[i]);
+	}
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+void
+dns_sigcache_flush(dns_sigcache_t *cache) {
+	REQUIRE(VALID_SIGCACHE(cache));
+
+	for (size_t i = 0; i < cache->size; i++) {
+		isc_mutex_t *lock = &cache->locks[i % SIGCACHE_NLOCKS];
+
+		LOCK(lock);
+		cache->entries[i].used = false;
+		UNLOCK(lock);
+	}
+}
+
+static isc_result_t
+digest_callback(void *arg, isc_region_t *data) {
+	return (isc_md_update(arg, data->base, data->length));
+}
+
+static int
+rdata_compare(const void *a, const void *b) {
+	return (dns_rdata_compare(a, b));
+}
+
+isc_result_t
+dns_sigcache_digest(const dns_name_t *name, dns_rdataset_t *rdataset,
+		    dst_key_t *key, dns_rdata_t *sigrdata,
+		    unsigned int maxbits, isc_mem_t *mctx,
+		    unsigned char *digest) {
+	dns_fixedname_t fixed;
+	dns_name_t *lname = dns_fixedname_initname(&fixed);
+	unsigned char keydata[DST_KEY_MAXSIZE];
+	unsigned char header[8];
+	dns_rdata_t *rdatas = NULL;
+	unsigned int nrdatas, i = 0;
+	unsigned int digestlen;
+	isc_buffer_t b;
+	isc_region_t r;
+	isc_md_t *md = NULL;
+	isc_result_t result;
+
+	REQUIRE(DNS_RDATASET_VALID(rdataset));
+	REQUIRE(key != NULL);
+	REQUIRE(sigrdata != NULL && sigrdata->type == dns_rdatatype_rrsig);
+	REQUIRE(digest != NULL);
+
+	md = isc_md_new();
+	if (md == NULL) {
+		return (ISC_R_NOMEMORY);
+	}
+	CHECK(isc_md_init(md, ISC_MD_SHA256));
+
+	/*
+	 * The owner name, type and class of the RRset, and the limit on
+	 * the RSA exponent, which can make an otherwise good signature
+	 * fail.
+	 */
+	(void)dns_name_downcase(name, lname, NULL);
+	dns_name_toregion(lname, &r);
+	CHECK(isc_md_update(md, r.base, r.length));
+
+	isc_buffer_init(&b, header, sizeof(header));
+	isc_buffer_putuint16(&b, rdataset->type);
+	isc_buffer_putuint16(&b, rdataset->rdclass);
+	isc_buffer_putuint32(&b, maxbits);
+	CHECK(isc_md_update(md, header, sizeof(header)));
+
+	/*
+	 * The records, in canonical order, each preceded by its length.
+	 */
+	nrdatas = dns_rdataset_count(rdataset);
+	rdatas = isc_mem_get(mctx, nrdatas * sizeof(rdatas[0]));
+	for (result = dns_rdataset_first(rdataset);
+	     result == ISC_R_SUCCESS && i < nrdatas;
+	     result = dns_rdataset_next(rdataset))
+	{
+		dns_rdata_init(&rdatas[i]);
+		dns_rdataset_current(rdataset, &rdatas[i++]);
+	}
+	nrdatas = i;
+	qsort(rdatas, nrdatas, sizeof(rdatas[0]), rdata_compare);
+	for (i = 0; i < nrdatas; i++) {
+		isc_buffer_init(&b, header, sizeof(header));
+		isc_buffer_putuint16(&b, rdatas[i].length);
+		CHECK(isc_md_update(md, header, 2));
+		CHECK(dns_rdata_digest(&rdatas[i], digest_callback, md));
+	}
+
+	/*
+	 * The whole RRSIG, including the signature, and the DNSKEY.
+	 * RRSIG has no canonical form to digest, so its wire form is
+	 * used as is.
+	 */
+	dns_rdata_toregion(sigrdata, &r);
+	CHECK(isc_md_update(md, r.base, r.length));
+
+	isc_buffer_init(&b, keydata, sizeof(keydata));
+	CHECK(dst_key_todns(key, &b));
+	isc_buffer_usedregion(&b, &r);
+	CHECK(isc_md_update(md, r.base, r.length));
+
+	CHECK(isc_md_final(md, digest, &digestlen));
+	INSIST(digestlen == DNS_SIGCACHE_DIGESTLENGTH);
+
+cleanup:
+	if (rdatas != NULL) {
+		isc_mem_put(mctx, rdatas,
+			    dns_rdataset_count(rdataset) * sizeof(rdatas[0]));
+	}
+	isc_md_free(md);
+	return (result);
+}
+
+static unsigned int
+sigcache_slot(dns_sigcache_t *cache, const unsigned char *digest) {
+	uint32_t hash;
+
+	memmove(&hash, digest, sizeof(hash));
+	return (hash & (cache->size - 1));
+}
+
+isc_result_t
+dns_sigcache_find(dns_sigcache_t *cache, const unsigned char *digest,
+		  isc_stdtime_t now, isc_result_t *resultp, uint32_t *costp) {
+	unsigned int slot;
+	sigentry_t *entry = NULL;
+	isc_mutex_t *lock = NULL;
+	isc_result_t result = ISC_R_NOTFOUND;
+
+	REQUIRE(VALID_SIGCACHE(cache));
+	REQUIRE(digest != NULL);
+	REQUIRE(resultp != NULL);
+
+	slot = sigcache_slot(cache, digest);
+	entry = &cache->entries[slot];
+	lock = &cache->locks[slot % SIGCACHE_NLOCKS];
+
+	LOCK(lock);
+	if (entry->used &&
+	    memcmp(entry->digest, digest, DNS_SIGCACHE_DIGESTLENGTH) == 0)
+	{
+		if (isc_serial_le(now, entry->expire)) {
+			*resultp = entry->result;
+			if (costp != NULL) {
+				*costp = entry->cost;
+			}
+			result = ISC_R_SUCCESS;
+		} else {
+			entry->used = false;
+		}
+	}
+	UNLOCK(lock);
+
+	return (result);
+}
+
+void
+dns_sigcache_add(dns_sigcache_t *cache, const unsigned char *digest,
+		 isc_stdtime_t expire, isc_result_t result, uint32_t cost) {
+	unsigned int slot;
+	sigentry_t *entry = NULL;
+	isc_mutex_t *lock = NULL;
+
+	REQUIRE(VALID_SIGCACHE(cache));
+	REQUIRE(digest != NULL);
+
+	slot = sigcache_slot(cache, digest);
+	entry = &cache->entries[slot];
+	lock = &cache->locks[slot % SIGCACHE_NLOCKS];
+
+	LOCK(lock);
+	memmove(entry->digest, digest, DNS_SIGCACHE_DIGESTLENGTH);
+	entry->expire = expire;
+	entry->cost = cost;
+	entry->result = result;
+	entry->used = true;
+	UNLOCK(lock);
+}
@@ -15,6 +15,7 @@
 
 #include <stdbool.h>
 
+#include <isc/ht.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
 #include <isc/netaddr.h>
@@ -48,7 +49,22 @@ struct dns_ssurule {
 	dns_ssuruletype_t *types;     /*%< the data types.  Can include */
 				      /*   ANY. if NULL, defaults to all */
 				      /*   types except SIG, SOA, and NS */
+	unsigned int seq;	      /*%< position in the table */
 	ISC_LINK(dns_ssurule_t) link;
+	ISC_LINK(dns_ssurule_t) ilink; /*%< in a bucket or 'unindexed' */
+};
+
+/*%
+ * The rules that only apply to names at or below their 'name', indexed
+ * by that name: "name" rules in 'exact', and the ones applying to
+ * subdomains, with the wildcard label of "wildcard" rules removed, in
+ * 'below'.  Both lists are in table order.
+ */
+typedef struct ssubucket ssubucket_t;
+struct ssubucket {
+	ISC_LIST(dns_ssurule_t) exact;
+	ISC_LIST(dns_ssurule_t) below;
+	ISC_LINK(ssubucket_t) link;
 };
 
 struct dns_ssutable {
@@ -57,6 +73,10 @@ struct dns_ssutable {
 	isc_refcount_t references;
 	dns_dlzdb_t *dlzdatabase;
 	ISC_LIST(dns_ssurule_t) rules;
+	unsigned int nrules;
+	isc_ht_t *index;		    /*%< lower-cased name -> bucket */
+	ISC_LIST(ssubucket_t) buckets;
+	ISC_LIST(dns_ssurule_t) unindexed; /*%< all other rules, in order */
 };
 
 void
@@ -70,7 +90,12 @@ dns_ssutable_create(isc_mem_t *mctx, dns_ssutable_t **tablep) {
 	isc_refcount_init(&table->references, 1);
 	table->mctx = NULL;
 	isc_mem_attach(mctx, &table->mctx);
+	table->dlzdatabase = NULL;
 	ISC_LIST_INIT(table->rules);
+	table->nrules = 0;
+	table->index = NULL;
+	ISC_LIST_INIT(table->buckets);
+	ISC_LIST_INIT(table->unindexed);
 	table->magic = SSUTABLEMAGIC;
 	*tablep = table;
 }
@@ -101,6 +126,14 @@ destroy(dns_ssutable_t *table) {
 		rule->magic = 0;
 		isc_mem_put(mctx, rule, sizeof(dns_ssurule_t));
 	}
+	while (!ISC_LIST_EMPTY(table->buckets)) {
+		ssubucket_t *bucket = ISC_LIST_HEAD(table->buckets);
+		ISC_LIST_UNLINK(table->buckets, bucket, link);
+		isc_mem_put(mctx, bucket, sizeof(*bucket));
+	}
+	if (table->index != NULL) {
+		isc_ht_destroy(&table->index);
+	}
 	isc_refcount_destroy(&table->references);
 	table->magic = 0;
 	isc_mem_putanddetach(&table->mctx, table, sizeof(dns_ssutable_t));
@@ -130,6 +163,77 @@ dns_ssutable_detach(dns_ssutable_t **tablep) {
 	}
 }
 
+/*
+ * Append 'rule' to the table, and to the index if its match type allows.
+ */
+static void
+appendrule(dns_ssutable_t *table, dns_ssurule_t *rule) {
+	dns_fixedname_t fixed;
+	dns_name_t *lname = NULL;
+	dns_name_t key;
+	ssubucket_t *bucket = NULL;
+	bool exact = false;
+	isc_result_t result;
+
+	rule->seq = table->nrules++;
+	ISC_LINK_INIT(rule, ilink);
+	ISC_LIST_INITANDAPPEND(table->rules, rule, link);
+
+	switch (rule->matchtype) {
+	case dns_ssumatchtype_name:
+		exact = true;
+		break;
+	case dns_ssumatchtype_subdomain:
+	case dns_ssumatchtype_wildcard:
+	case dns_ssumatchtype_subdomainkrb5:
+	case dns_ssumatchtype_subdomainms:
+	case dns_ssumatchtype_subdomainselfkrb5rhs:
+	case dns_ssumatchtype_subdomainselfmsrhs:
+		break;
+	default:
+		/*
+		 * "local" rules are not indexed either, as they log a
+		 * warning when they fail.
+		 */
+		ISC_LIST_APPEND(table->unindexed, rule, ilink);
+		return;
+	}
+
+	/* The wildcard label of a "wildcard" rule is not part of the key */
+	lname = dns_fixedname_initname(&fixed);
+	dns_name_downcase(rule->name, lname, NULL);
+	dns_name_init(&key, NULL);
+	if (rule->matchtype == dns_ssumatchtype_wildcard) {
+		dns_name_getlabelsequence(lname, 1,
+					  dns_name_countlabels(lname) - 1, &key);
+	} else {
+		dns_name_clone(lname, &key);
+	}
+
+	if (table->index == NULL) {
+		isc_ht_init(&table->index, table->mctx, 8,
+			    ISC_HT_CASE_SENSITIVE);
+	}
+	result = isc_ht_find(table->index, key.ndata, key.length,
+			     (void **)&bucket);
+	if (result != ISC_R_SUCCESS) {
+		bucket = isc_mem_get(table->mctx, sizeof(*bucket));
+		ISC_LIST_INIT(bucket->exact);
+		ISC_LIST_INIT(bucket->below);
+		ISC_LINK_INIT(bucket, link);
+		ISC_LIST_APPEND(table->buckets, bucket, link);
+		result = isc_ht_add(table->index, key.ndata, key.length,
+				    bucket);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+
+	if (exact) {
+		ISC_LIST_APPEND(bucket->exact, rule, ilink);
+	} else {
+		ISC_LIST_APPEND(bucket->below, rule, ilink);
+	}
+}
+
 void
 dns_ssutable_addrule(dns_ssutable_t *table, bool grant,
 		     const dns_name_t *identity, dns_ssumatchtype_t matchtype,
@@ -177,7 +281,7 @@ dns_ssutable_addrule(dns_ssutable_t *table, bool grant,
 	}
 
 	rule->magic = SSURULEMAGIC;
-	ISC_LIST_INITANDAPPEND(table->rules, rule, link);
+	appendrule(table, rule);
 }
 
 static bool
@@ -276,290 +380,355 @@ stf_from_address(dns_name_t *stfself, const isc_netaddr_t *tcpaddr) {
 	RUNTIME_CHECK(result == ISC_R_SUCCESS);
 }
 
-bool
-dns_ssutable_checkrules(dns_ssutable_t *table, const dns_name_t *signer,
-			const dns_name_t *name, const isc_netaddr_t *addr,
-			bool tcp, dns_aclenv_t *env, dns_rdatatype_t type,
-			const dns_name_t *target, const dst_key_t *key,
-			const dns_ssurule_t **rulep) {
+/*
+ * Return true if 'rule' applies to the update of 'name'/'type' by
+ * 'signer' or 'addr', see dns_ssutable_checkrules().
+ */
+static bool
+rulematches(dns_ssutable_t *table, const dns_ssurule_t *rule,
+	    const dns_name_t *signer, const dns_name_t *name,
+	    const isc_netaddr_t *addr, bool tcp, dns_aclenv_t *env,
+	    dns_rdatatype_t type, const dns_name_t *target,
+	    const dst_key_t *key) {
 	dns_fixedname_t fixed;
 	dns_name_t *stfself;
 	dns_name_t *tcpself;
 	dns_name_t *wildcard;
-	dns_ssurule_t *rule;
 	const dns_name_t *tname;
 	int match;
 	isc_result_t result;
 	unsigned int i;
 
-	REQUIRE(VALID_SSUTABLE(table));
-	REQUIRE(signer == NULL || dns_name_isabsolute(signer));
-	REQUIRE(dns_name_isabsolute(name));
-	REQUIRE(addr == NULL || env != NULL);
-
-	if (signer == NULL && addr == NULL) {
-		return (false);
-	}
-
-	for (rule = ISC_LIST_HEAD(table->rules); rule != NULL;
-	     rule = ISC_LIST_NEXT(rule, link))
-	{
-		switch (rule->matchtype) {
-		case dns_ssumatchtype_local:
-		case dns_ssumatchtype_name:
-		case dns_ssumatchtype_self:
-		case dns_ssumatchtype_selfsub:
-		case dns_ssumatchtype_selfwild:
-		case dns_ssumatchtype_subdomain:
-		case dns_ssumatchtype_wildcard:
-			if (signer == NULL) {
-				continue;
+	switch (rule->matchtype) {
+	case dns_ssumatchtype_local:
+	case dns_ssumatchtype_name:
+	case dns_ssumatchtype_self:
+	case dns_ssumatchtype_selfsub:
+	case dns_ssumatchtype_selfwild:
+	case dns_ssumatchtype_subdomain:
+	case dns_ssumatchtype_wildcard:
+		if (signer == NULL) {
+			return (false);
+		}
+		if (dns_name_iswildcard(rule->identity)) {
+			if (!dns_name_matcheswildcard(signer, rule->identity)) {
+				return (false);
 			}
-			if (dns_name_iswildcard(rule->identity)) {
-				if (!dns_name_matcheswildcard(signer,
-							      rule->identity)) {
-					continue;
-				}
-			} else {
-				if (!dns_name_equal(signer, rule->identity)) {
-					continue;
-				}
+		} else {
+			if (!dns_name_equal(signer, rule->identity)) {
+				return (false);
 			}
+		}
+		break;
+	case dns_ssumatchtype_selfkrb5:
+	case dns_ssumatchtype_selfms:
+	case dns_ssumatchtype_selfsubkrb5:
+	case dns_ssumatchtype_selfsubms:
+	case dns_ssumatchtype_subdomainkrb5:
+	case dns_ssumatchtype_subdomainms:
+	case dns_ssumatchtype_subdomainselfkrb5rhs:
+	case dns_ssumatchtype_subdomainselfmsrhs:
+		if (signer == NULL) {
+			return (false);
+		}
+		break;
+	case dns_ssumatchtype_tcpself:
+	case dns_ssumatchtype_6to4self:
+		if (!tcp || addr == NULL) {
+			return (false);
+		}
+		break;
+	case dns_ssumatchtype_external:
+	case dns_ssumatchtype_dlz:
+		break;
+	}
+
+	switch (rule->matchtype) {
+	case dns_ssumatchtype_name:
+		if (!dns_name_equal(name, rule->name)) {
+			return (false);
+		}
+		break;
+	case dns_ssumatchtype_subdomain:
+		if (!dns_name_issubdomain(name, rule->name)) {
+			return (false);
+		}
+		break;
+	case dns_ssumatchtype_local:
+		if (addr == NULL) {
+			return (false);
+		}
+		if (!dns_name_issubdomain(name, rule->name)) {
+			return (false);
+		}
+		RWLOCK(&env->rwlock, isc_rwlocktype_read);
+		dns_acl_match(addr, NULL, env->localhost, NULL, &match, NULL);
+		RWUNLOCK(&env->rwlock, isc_rwlocktype_read);
+		if (match == 0) {
+			if (signer != NULL) {
+				isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+					      DNS_LOGMODULE_SSU, ISC_LOG_WARNING,
+					      "update-policy local: "
+					      "match on session "
+					      "key not from "
+					      "localhost");
+			}
+			return (false);
+		}
+		break;
+	case dns_ssumatchtype_wildcard:
+		if (!dns_name_matcheswildcard(name, rule->name)) {
+			return (false);
+		}
+		break;
+	case dns_ssumatchtype_self:
+		if (!dns_name_equal(signer, name)) {
+			return (false);
+		}
+		break;
+	case dns_ssumatchtype_selfsub:
+		if (!dns_name_issubdomain(name, signer)) {
+			return (false);
+		}
+		break;
+	case dns_ssumatchtype_selfwild:
+		wildcard = dns_fixedname_initname(&fixed);
+		result = dns_name_concatenate(dns_wildcardname, signer,
+					      wildcard, NULL);
+		if (result != ISC_R_SUCCESS) {
+			return (false);
+		}
+		if (!dns_name_matcheswildcard(name, wildcard)) {
+			return (false);
+		}
+		break;
+	case dns_ssumatchtype_selfkrb5:
+		if (dst_gssapi_identitymatchesrealmkrb5(
+			    signer, name, rule->identity, false)) {
 			break;
-		case dns_ssumatchtype_selfkrb5:
-		case dns_ssumatchtype_selfms:
-		case dns_ssumatchtype_selfsubkrb5:
-		case dns_ssumatchtype_selfsubms:
-		case dns_ssumatchtype_subdomainkrb5:
-		case dns_ssumatchtype_subdomainms:
-		case dns_ssumatchtype_subdomainselfkrb5rhs:
-		case dns_ssumatchtype_subdomainselfmsrhs:
-			if (signer == NULL) {
-				continue;
-			}
+		}
+		return (false);
+	case dns_ssumatchtype_selfms:
+		if (dst_gssapi_identitymatchesrealmms(
+			    signer, name, rule->identity, false)) {
 			break;
-		case dns_ssumatchtype_tcpself:
-		case dns_ssumatchtype_6to4self:
-			if (!tcp || addr == NULL) {
-				continue;
-			}
+		}
+		return (false);
+	case dns_ssumatchtype_selfsubkrb5:
+		if (dst_gssapi_identitymatchesrealmkrb5(
+			    signer, name, rule->identity, true)) {
 			break;
-		case dns_ssumatchtype_external:
-		case dns_ssumatchtype_dlz:
+		}
+		return (false);
+	case dns_ssumatchtype_selfsubms:
+		if (dst_gssapi_identitymatchesrealmms(
+			    signer, name, rule->identity, true)) {
 			break;
 		}
-
+		return (false);
+	case dns_ssumatchtype_subdomainkrb5:
+	case dns_ssumatchtype_subdomainselfkrb5rhs:
+		if (!dns_name_issubdomain(name, rule->name)) {
+			return (false);
+		}
+		tname = NULL;
 		switch (rule->matchtype) {
-		case dns_ssumatchtype_name:
-			if (!dns_name_equal(name, rule->name)) {
-				continue;
+		case dns_ssumatchtype_subdomainselfkrb5rhs:
+			if (type == dns_rdatatype_ptr) {
+				tname = target;
 			}
-			break;
-		case dns_ssumatchtype_subdomain:
-			if (!dns_name_issubdomain(name, rule->name)) {
-				continue;
+			if (type == dns_rdatatype_srv) {
+				tname = target;
 			}
 			break;
-		case dns_ssumatchtype_local:
-			if (addr == NULL) {
-				continue;
-			}
-			if (!dns_name_issubdomain(name, rule->name)) {
-				continue;
-			}
-			RWLOCK(&env->rwlock, isc_rwlocktype_read);
-			dns_acl_match(addr, NULL, env->localhost, NULL, &match,
-				      NULL);
-			RWUNLOCK(&env->rwlock, isc_rwlocktype_read);
-			if (match == 0) {
-				if (signer != NULL) {
-					isc_log_write(dns_lctx,
-						      DNS_LOGCATEGORY_GENERAL,
-						      DNS_LOGMODULE_SSU,
-						      ISC_LOG_WARNING,
-						      "update-policy local: "
-						      "match on session "
-						      "key not from "
-						      "localhost");
-				}
-				continue;
-			}
+		default:
 			break;
-		case dns_ssumatchtype_wildcard:
-			if (!dns_name_matcheswildcard(name, rule->name)) {
-				continue;
-			}
+		}
+		if (dst_gssapi_identitymatchesrealmkrb5(
+			    signer, tname, rule->identity, false)) {
 			break;
-		case dns_ssumatchtype_self:
-			if (!dns_name_equal(signer, name)) {
-				continue;
+		}
+		return (false);
+	case dns_ssumatchtype_subdomainms:
+	case dns_ssumatchtype_subdomainselfmsrhs:
+		if (!dns_name_issubdomain(name, rule->name)) {
+			return (false);
+		}
+		tname = NULL;
+		switch (rule->matchtype) {
+		case dns_ssumatchtype_subdomainselfmsrhs:
+			if (type == dns_rdatatype_ptr) {
+				tname = target;
 			}
-			break;
-		case dns_ssumatchtype_selfsub:
-			if (!dns_name_issubdomain(name, signer)) {
-				continue;
+			if (type == dns_rdatatype_srv) {
+				tname = target;
 			}
 			break;
-		case dns_ssumatchtype_selfwild:
-			wildcard = dns_fixedname_initname(&fixed);
-			result = dns_name_concatenate(dns_wildcardname, signer,
-						      wildcard, NULL);
-			if (result != ISC_R_SUCCESS) {
-				continue;
-			}
-			if (!dns_name_matcheswildcard(name, wildcard)) {
-				continue;
-			}
+		default:
 			break;
-		case dns_ssumatchtype_selfkrb5:
-			if (dst_gssapi_identitymatchesrealmkrb5(
-				    signer, name, rule->identity, false)) {
-				break;
-			}
-			continue;
-		case dns_ssumatchtype_selfms:
-			if (dst_gssapi_identitymatchesrealmms(
-				    signer, name, rule->identity, false)) {
-				break;
-			}
-			continue;
-		case dns_ssumatchtype_selfsubkrb5:
-			if (dst_gssapi_identitymatchesrealmkrb5(
-				    signer, name, rule->identity, true)) {
-				break;
-			}
-			continue;
-		case dns_ssumatchtype_selfsubms:
-			if (dst_gssapi_identitymatchesrealmms(
-				    signer, name, rule->identity, true)) {
-				break;
-			}
-			continue;
-		case dns_ssumatchtype_subdomainkrb5:
-		case dns_ssumatchtype_subdomainselfkrb5rhs:
-			if (!dns_name_issubdomain(name, rule->name)) {
-				continue;
-			}
-			tname = NULL;
-			switch (rule->matchtype) {
-			case dns_ssumatchtype_subdomainselfkrb5rhs:
-				if (type == dns_rdatatype_ptr) {
-					tname = target;
-				}
-				if (type == dns_rdatatype_srv) {
-					tname = target;
-				}
-				break;
-			default:
-				break;
-			}
-			if (dst_gssapi_identitymatchesrealmkrb5(
-				    signer, tname, rule->identity, false)) {
-				break;
-			}
-			continue;
-		case dns_ssumatchtype_subdomainms:
-		case dns_ssumatchtype_subdomainselfmsrhs:
-			if (!dns_name_issubdomain(name, rule->name)) {
-				continue;
-			}
-			tname = NULL;
-			switch (rule->matchtype) {
-			case dns_ssumatchtype_subdomainselfmsrhs:
-				if (type == dns_rdatatype_ptr) {
-					tname = target;
-				}
-				if (type == dns_rdatatype_srv) {
-					tname = target;
-				}
-				break;
-			default:
-				break;
-			}
-			if (dst_gssapi_identitymatchesrealmms(
-				    signer, tname, rule->identity, false)) {
-				break;
-			}
-			continue;
-		case dns_ssumatchtype_tcpself:
-			tcpself = dns_fixedname_initname(&fixed);
-			reverse_from_address(tcpself, addr);
-			if (dns_name_iswildcard(rule->identity)) {
-				if (!dns_name_matcheswildcard(tcpself,
-							      rule->identity)) {
-					continue;
-				}
-			} else {
-				if (!dns_name_equal(tcpself, rule->identity)) {
-					continue;
-				}
-			}
-			if (!dns_name_equal(tcpself, name)) {
-				continue;
-			}
+		}
+		if (dst_gssapi_identitymatchesrealmms(
+			    signer, tname, rule->identity, false)) {
 			break;
-		case dns_ssumatchtype_6to4self:
-			stfself = dns_fixedname_initname(&fixed);
-			stf_from_address(stfself, addr);
-			if (dns_name_iswildcard(rule->identity)) {
-				if (!dns_name_matcheswildcard(stfself,
-							      rule->identity)) {
-					continue;
-				}
-			} else {
-				if (!dns_name_equal(stfself, rule->identity)) {
-					continue;
-				}
+		}
+		return (false);
+	case dns_ssumatchtype_tcpself:
+		tcpself = dns_fixedname_initname(&fixed);
+		reverse_from_address(tcpself, addr);
+		if (dns_name_iswildcard(rule->identity)) {
+			if (!dns_name_matcheswildcard(tcpself, rule->identity))
+			{
+				return (false);
 			}
-			if (!dns_name_equal(stfself, name)) {
-				continue;
+		} else {
+			if (!dns_name_equal(tcpself, rule->identity)) {
+				return (false);
 			}
-			break;
-		case dns_ssumatchtype_external:
-			if (!dns_ssu_external_match(rule->identity, signer,
-						    name, addr, type, key,
-						    table->mctx))
+		}
+		if (!dns_name_equal(tcpself, name)) {
+			return (false);
+		}
+		break;
+	case dns_ssumatchtype_6to4self:
+		stfself = dns_fixedname_initname(&fixed);
+		stf_from_address(stfself, addr);
+		if (dns_name_iswildcard(rule->identity)) {
+			if (!dns_name_matcheswildcard(stfself, rule->identity))
 			{
-				continue;
+				return (false);
 			}
-			break;
-		case dns_ssumatchtype_dlz:
-			if (!dns_dlz_ssumatch(table->dlzdatabase, signer, name,
-					      addr, type, key)) {
-				continue;
+		} else {
+			if (!dns_name_equal(stfself, rule->identity)) {
+				return (false);
 			}
-			break;
 		}
+		if (!dns_name_equal(stfself, name)) {
+			return (false);
+		}
+		break;
+	case dns_ssumatchtype_external:
+		if (!dns_ssu_external_match(rule->identity, signer, name, addr,
+					    type, key, table->mctx))
+		{
+			return (false);
+		}
+		break;
+	case dns_ssumatchtype_dlz:
+		if (!dns_dlz_ssumatch(table->dlzdatabase, signer, name,
+				      addr, type, key)) {
+			return (false);
+		}
+		break;
+	}
 
-		if (rule->ntypes == 0) {
-			/*
-			 * If this is a DLZ rule, then the DLZ ssu
-			 * checks will have already checked the type.
-			 */
-			if (rule->matchtype != dns_ssumatchtype_dlz &&
-			    !isusertype(type)) {
-				continue;
-			}
-		} else {
-			for (i = 0; i < rule->ntypes; i++) {
-				if (rule->types[i].type == dns_rdatatype_any ||
-				    rule->types[i].type == type) {
-					break;
-				}
+	if (rule->ntypes == 0) {
+		/*
+		 * If this is a DLZ rule, then the DLZ ssu
+		 * checks will have already checked the type.
+		 */
+		if (rule->matchtype != dns_ssumatchtype_dlz &&
+		    !isusertype(type)) {
+			return (false);
+		}
+	} else {
+		for (i = 0; i < rule->ntypes; i++) {
+			if (rule->types[i].type == dns_rdatatype_any ||
+			    rule->types[i].type == type) {
+				break;
 			}
-			if (i == rule->ntypes) {
+		}
+		if (i == rule->ntypes) {
+			return (false);
+		}
+	}
+	return (true);
+}
+
+/*
+ * Find the first rule of 'list', following 'field', that comes before
+ * '*bestp' (if set) and matches; if there is one, make it '*bestp'.
+ */
+#define FIRSTMATCH(list, field, bestp)                                     \
+	do {                                                               \
+		dns_ssurule_t *_r = NULL;                                  \
+		for (_r = ISC_LIST_HEAD(list);                             \
+		     _r != NULL &&                                         \
+		     (*(bestp) == NULL || _r->seq < (*(bestp))->seq);      \
+		     _r = ISC_LIST_NEXT(_r, field))                        \
+		{                                                          \
+			if (rulematches(table, _r, signer, name, addr, tcp, \
+					env, type, target, key))           \
+			{                                                  \
+				*(bestp) = _r;                             \
+				break;                                     \
+			}                                                  \
+		}                                                          \
+	} while (0)
+
+bool
+dns_ssutable_checkrules(dns_ssutable_t *table, const dns_name_t *signer,
+			const dns_name_t *name, const isc_netaddr_t *addr,
+			bool tcp, dns_aclenv_t *env, dns_rdatatype_t type,
+			const dns_name_t *target, const dst_key_t *key,
+			const dns_ssurule_t **rulep) {
+	dns_ssurule_t *best = NULL;
+
+	REQUIRE(VALID_SSUTABLE(table));
+	REQUIRE(signer == NULL || dns_name_isabsolute(signer));
+	REQUIRE(dns_name_isabsolute(name));
+	REQUIRE(addr == NULL || env != NULL);
+
+	if (signer == NULL && addr == NULL) {
+		return (false);
+	}
+
+	/*
+	 * The rules indexed by name have no side effects, so they are
+	 * checked first, for the names that can match 'name': 'name'
+	 * itself for "name" rules, and 'name' and all its ancestors for
+	 * the rules that apply to a subdomain.  The other rules are then
+	 * checked in order, up to the first indexed rule that matched,
+	 * so that the first matching rule of the table wins as before.
+	 */
+	if (table->index != NULL) {
+		dns_fixedname_t fixed;
+		dns_name_t *lname = dns_fixedname_initname(&fixed);
+		dns_name_t suffix;
+		unsigned int labels = dns_name_countlabels(name);
+		isc_result_t result;
+
+		dns_name_downcase(name, lname, NULL);
+		dns_name_init(&suffix, NULL);
+		for (unsigned int i = 0; i < labels; i++) {
+			ssubucket_t *bucket = NULL;
+
+			dns_name_getlabelsequence(lname, i, labels - i,
+						  &suffix);
+			result = isc_ht_find(table->index, suffix.ndata,
+					     suffix.length, (void **)&bucket);
+			if (result != ISC_R_SUCCESS) {
 				continue;
 			}
+			if (i == 0) {
+				FIRSTMATCH(bucket->exact, ilink, &best);
+			}
+			FIRSTMATCH(bucket->below, ilink, &best);
 		}
-		if (rule->grant && rulep != NULL) {
-			*rulep = rule;
-		}
-		return (rule->grant);
 	}
 
-	return (false);
+	FIRSTMATCH(table->unindexed, ilink, &best);
+
+	if (best == NULL) {
+		return (false);
+	}
+	if (best->grant && rulep != NULL) {
+		*rulep = best;
+	}
+	return (best->grant);
 }
 
+#undef FIRSTMATCH
+
 bool
 dns_ssurule_isgrant(const dns_ssurule_t *rule) {
 	REQUIRE(VALID_SSURULE(rule));
@@ -651,7 +820,7 @@ dns_ssutable_createdlz(isc_mem_t *mctx, dns_ssutable_t **tablep,
 	rule->types = NULL;
 	rule->magic = SSURULEMAGIC;
 
-	ISC_LIST_INITANDAPPEND(table->rules, rule, link);
+	appendrule(table, rule);
 	*tablep = table;
 }
 
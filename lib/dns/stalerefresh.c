@@ -0,0 +1,469 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include <isc/atomic.h>
+#include <isc/ht.h>
+#include <isc/list.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/refcount.h>
+#include <isc/serial.h>
+#include <isc/timer.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdataset.h>
+#include <dns/resolver.h>
+#include <dns/stalerefresh.h>
+#include <dns/stats.h>
+#include <dns/view.h>
+
+#define STALEREFRESH_MAGIC    ISC_MAGIC('S', 't', 'R', 'f')
+#define VALID_STALEREFRESH(q) ISC_MAGIC_VALID(q, STALEREFRESH_MAGIC)
+
+/*%
+ * The queue is serviced STALEREFRESH_TICKS times a second.
+ */
+#define STALEREFRESH_TICKS 10
+
+/*%
+ * After a failed refresh, an RRset waits STALEREFRESH_MINBACKOFF
+ * seconds before it can be queued again, twice as long after each
+ * further failure, up to STALEREFRESH_MAXBACKOFF seconds.  An RRset no
+ * client has asked for within STALEREFRESH_MAXBACKOFF seconds of the
+ * end of its wait is forgotten.
+ */
+#define STALEREFRESH_MINBACKOFF 1
+#define STALEREFRESH_MAXBACKOFF 60
+
+/*%
+ * Key of the table of entries: the type, followed by the name in lower
+ * case, in wire format.
+ */
+#define STALEREFRESH_KEYSIZE (2 + DNS_NAME_MAXWIRE)
+
+/*
+ * Each entry of the table is queued, in the 'queued' list; being
+ * refreshed, with a fetch and in no list; or waiting after a failed
+ * refresh, in the 'waiting' list.
+ */
+typedef enum {
+	entry_queued,
+	entry_fetching,
+	entry_waiting,
+} entrystate_t;
+
+typedef struct entry entry_t;
+struct entry {
+	dns_stalerefresh_t *queue;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_rdatatype_t type;
+	unsigned char key[STALEREFRESH_KEYSIZE];
+	unsigned int keysize;
+	entrystate_t state;
+	isc_stdtime_t retry;
+	dns_ttl_t backoff;
+	dns_fetch_t *fetch;
+	dns_rdataset_t rdataset;
+	ISC_LINK(entry_t) link;
+};
+
+typedef ISC_LIST(entry_t) entrylist_t;
+
+struct dns_stalerefresh {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	isc_refcount_t references;
+	dns_view_t *view;
+	isc_task_t *task;
+	isc_timer_t *timer;
+	unsigned int rate;
+	atomic_bool shuttingdown;
+
+	/* Locked by lock. */
+	isc_mutex_t lock;
+	isc_ht_t *table;
+	unsigned int count;
+	unsigned int tokens;
+	isc_stdtime_t lastsweep;
+	entrylist_t queued;
+	entrylist_t waiting;
+};
+
+static void
+stalerefresh_tick(void *arg);
+
+void
+dns_stalerefresh_create(dns_view_t *view, isc_loopmgr_t *loopmgr,
+			isc_taskmgr_t *taskmgr, unsigned int rate,
+			dns_stalerefresh_t **queuep) {
+	dns_stalerefresh_t *queue = NULL;
+	isc_interval_t interval;
+	isc_result_t result;
+
+	REQUIRE(DNS_VIEW_VALID(view) && view->resolver != NULL);
+	REQUIRE(rate > 0);
+	REQUIRE(queuep != NULL && *queuep == NULL);
+
+	queue = isc_mem_get(view->mctx, sizeof(*queue));
+	*queue = (dns_stalerefresh_t){
+		.view = view,
+		.rate = rate,
+	};
+	ISC_LIST_INIT(queue->queued);
+	ISC_LIST_INIT(queue->waiting);
+
+	isc_mem_attach(view->mctx, &queue->mctx);
+	isc_refcount_init(&queue->references, 1);
+	isc_mutex_init(&queue->lock);
+	atomic_init(&queue->shuttingdown, false);
+	isc_ht_init(&queue->table, queue->mctx, 10, ISC_HT_CASE_SENSITIVE);
+
+	result = isc_task_create(taskmgr, &queue->task, 0);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	isc_task_setname(queue->task, "stalerefresh", queue);
+
+	isc_timer_create(isc_loop_main(loopmgr), stalerefresh_tick, queue,
+			 &queue->timer);
+	isc_interval_set(&interval, 0, 1000000000 / STALEREFRESH_TICKS);
+	isc_timer_start(queue->timer, isc_timertype_ticker, &interval);
+
+	queue->magic = STALEREFRESH_MAGIC;
+	*queuep = queue;
+}
+
+/*
+ * Remove 'entry' from the table and free it.  It must not be in a list.
+ */
+static void
+entry_free(dns_stalerefresh_t *queue, entry_t *entry) {
+	isc_result_t result;
+
+	INSIST(entry->fetch == NULL);
+	INSIST(!ISC_LINK_LINKED(entry, link));
+
+	result = isc_ht_delete(queue->table, entry->key, entry->keysize);
+	INSIST(result == ISC_R_SUCCESS);
+	queue->count--;
+
+	if (dns_rdataset_isassociated(&entry->rdataset)) {
+		dns_rdataset_disassociate(&entry->rdataset);
+	}
+	isc_mem_put(queue->mctx, entry, sizeof(*entry));
+}
+
+static void
+entrylist_free(dns_stalerefresh_t *queue, entrylist_t *list) {
+	entry_t *entry = NULL;
+
+	while ((entry = ISC_LIST_HEAD(*list)) != NULL) {
+		ISC_LIST_UNLINK(*list, entry, link);
+		entry_free(queue, entry);
+	}
+}
+
+static void
+stalerefresh_destroy(dns_stalerefresh_t *queue) {
+	queue->magic = 0;
+
+	INSIST(queue->timer == NULL);
+
+	entrylist_free(queue, &queue->queued);
+	entrylist_free(queue, &queue->waiting);
+	INSIST(queue->count == 0);
+
+	isc_ht_destroy(&queue->table);
+	isc_task_detach(&queue->task);
+	isc_mutex_destroy(&queue->lock);
+	isc_refcount_destroy(&queue->references);
+	isc_mem_putanddetach(&queue->mctx, queue, sizeof(*queue));
+}
+
+void
+dns_stalerefresh_detach(dns_stalerefresh_t **queuep) {
+	dns_stalerefresh_t *queue = NULL;
+
+	REQUIRE(queuep != NULL && VALID_STALEREFRESH(*queuep));
+
+	queue = *queuep;
+	*queuep = NULL;
+
+	if (isc_refcount_decrement(&queue->references) == 1) {
+		stalerefresh_destroy(queue);
+	}
+}
+
+void
+dns_stalerefresh_shutdown(dns_stalerefresh_t *queue) {
+	isc_ht_iter_t *it = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_STALEREFRESH(queue));
+
+	if (atomic_exchange(&queue->shuttingdown, true)) {
+		return;
+	}
+
+	LOCK(&queue->lock);
+	isc_ht_iter_create(queue->table, &it);
+	for (result = isc_ht_iter_first(it); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_next(it))
+	{
+		entry_t *entry = NULL;
+
+		isc_ht_iter_current(it, (void **)&entry);
+		if (entry->fetch != NULL) {
+			dns_resolver_cancelfetch(entry->fetch);
+		}
+	}
+	isc_ht_iter_destroy(&it);
+	UNLOCK(&queue->lock);
+
+	isc_timer_stop(queue->timer);
+	isc_timer_destroy(&queue->timer);
+}
+
+void
+dns_stalerefresh_add(dns_stalerefresh_t *queue, const dns_name_t *name,
+		     dns_rdatatype_t type, isc_stdtime_t now) {
+	dns_fixedname_t fixed;
+	dns_name_t *lower = NULL;
+	unsigned char key[STALEREFRESH_KEYSIZE];
+	unsigned int keysize;
+	entry_t *entry = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_STALEREFRESH(queue));
+	REQUIRE(dns_name_isabsolute(name));
+
+	if (atomic_load_relaxed(&queue->shuttingdown)) {
+		return;
+	}
+
+	lower = dns_fixedname_initname(&fixed);
+	result = dns_name_downcase(name, lower, NULL);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	key[0] = (type >> 8) & 0xff;
+	key[1] = type & 0xff;
+	memmove(key + 2, lower->ndata, lower->length);
+	keysize = 2 + lower->length;
+
+	LOCK(&queue->lock);
+	result = isc_ht_find(queue->table, key, keysize, (void **)&entry);
+	if (result == ISC_R_SUCCESS) {
+		/*
+		 * Already queued or being refreshed; or waiting after a
+		 * failure, in which case it is queued again once the wait
+		 * is over.
+		 */
+		if (entry->state == entry_waiting &&
+		    isc_serial_ge(now, entry->retry))
+		{
+			ISC_LIST_UNLINK(queue->waiting, entry, link);
+			ISC_LIST_APPEND(queue->queued, entry, link);
+			entry->state = entry_queued;
+		}
+		goto unlock;
+	}
+
+	if (queue->count >= DNS_STALEREFRESH_MAXENTRIES) {
+		goto unlock;
+	}
+
+	entry = isc_mem_get(queue->mctx, sizeof(*entry));
+	*entry = (entry_t){
+		.queue = queue,
+		.type = type,
+		.keysize = keysize,
+		.state = entry_queued,
+	};
+	ISC_LINK_INIT(entry, link);
+	entry->name = dns_fixedname_initname(&entry->fixed);
+	dns_name_copy(name, entry->name);
+	memmove(entry->key, key, keysize);
+	dns_rdataset_init(&entry->rdataset);
+
+	result = isc_ht_add(queue->table, entry->key, entry->keysize, entry);
+	INSIST(result == ISC_R_SUCCESS);
+	queue->count++;
+	ISC_LIST_APPEND(queue->queued, entry, link);
+
+unlock:
+	UNLOCK(&queue->lock);
+}
+
+/*
+ * Did the fetch leave an up to date answer in the cache?
+ */
+static bool
+refreshed(isc_result_t result) {
+	switch (result) {
+	case ISC_R_SUCCESS:
+	case DNS_R_CNAME:
+	case DNS_R_DNAME:
+	case DNS_R_NCACHENXDOMAIN:
+	case DNS_R_NCACHENXRRSET:
+		return (true);
+	default:
+		return (false);
+	}
+}
+
+/*
+ * Make 'entry' wait before it can be queued again, twice as long as
+ * the last time.  The lock must be held.
+ */
+static void
+entry_wait(dns_stalerefresh_t *queue, entry_t *entry, isc_stdtime_t now) {
+	entry->backoff = ISC_MIN(ISC_MAX(2 * entry->backoff,
+					 STALEREFRESH_MINBACKOFF),
+				 STALEREFRESH_MAXBACKOFF);
+	entry->retry = now + entry->backoff;
+	entry->state = entry_waiting;
+	ISC_LIST_APPEND(queue->waiting, entry, link);
+}
+
+static void
+fetch_done(isc_task_t *task, isc_event_t *event) {
+	dns_fetchevent_t *devent = (dns_fetchevent_t *)event;
+	entry_t *entry = devent->ev_arg;
+	dns_stalerefresh_t *queue = entry->queue;
+	dns_view_t *view = queue->view;
+	isc_stdtime_t now;
+
+	UNUSED(task);
+
+	isc_stdtime_get(&now);
+
+	LOCK(&queue->lock);
+	INSIST(entry->state == entry_fetching);
+	INSIST(entry->fetch == devent->fetch);
+	entry->fetch = NULL;
+	if (dns_rdataset_isassociated(&entry->rdataset)) {
+		dns_rdataset_disassociate(&entry->rdataset);
+	}
+	if (refreshed(devent->result) ||
+	    atomic_load_relaxed(&queue->shuttingdown))
+	{
+		entry_free(queue, entry);
+	} else {
+		entry_wait(queue, entry, now);
+		dns_resolver_incstats(view->resolver,
+				      dns_resstatscounter_stalerefreshfail);
+	}
+	UNLOCK(&queue->lock);
+
+	dns_resolver_destroyfetch(&devent->fetch);
+	if (devent->node != NULL) {
+		dns_db_detachnode(devent->db, &devent->node);
+	}
+	if (devent->db != NULL) {
+		dns_db_detach(&devent->db);
+	}
+	isc_event_free(&event);
+
+	dns_stalerefresh_detach(&queue);
+	dns_view_weakdetach(&view);
+}
+
+static isc_result_t
+entry_fetch(dns_stalerefresh_t *queue, entry_t *entry) {
+	dns_view_t *view = NULL;
+	isc_result_t result;
+
+	isc_refcount_increment(&queue->references);
+	dns_view_weakattach(queue->view, &view);
+
+	result = dns_resolver_createfetch(
+		view->resolver, entry->name, entry->type, NULL, NULL, NULL,
+		NULL, 0, 0, 0, NULL, queue->task, fetch_done, entry,
+		&entry->rdataset, NULL, &entry->fetch);
+	if (result != ISC_R_SUCCESS) {
+		dns_view_weakdetach(&view);
+		INSIST(isc_refcount_decrement(&queue->references) > 1);
+		return (result);
+	}
+
+	entry->state = entry_fetching;
+	dns_resolver_incstats(view->resolver, dns_resstatscounter_stalerefresh);
+	return (ISC_R_SUCCESS);
+}
+
+static void
+stalerefresh_tick(void *arg) {
+	dns_stalerefresh_t *queue = arg;
+	entry_t *entry = NULL, *next = NULL;
+	isc_stdtime_t now;
+
+	REQUIRE(VALID_STALEREFRESH(queue));
+
+	if (atomic_load_relaxed(&queue->shuttingdown)) {
+		return;
+	}
+
+	isc_stdtime_get(&now);
+
+	LOCK(&queue->lock);
+	if (atomic_load_relaxed(&queue->shuttingdown)) {
+		goto unlock;
+	}
+
+	/*
+	 * The budget is counted in tenths of a refresh, as for the
+	 * prefetch of popular names: it grows by 'rate' every tick and
+	 * can hold a single tick's worth.
+	 */
+	queue->tokens = ISC_MIN(queue->tokens + queue->rate,
+				queue->rate + STALEREFRESH_TICKS);
+
+	while (queue->tokens >= STALEREFRESH_TICKS &&
+	       (entry = ISC_LIST_HEAD(queue->queued)) != NULL)
+	{
+		ISC_LIST_UNLINK(queue->queued, entry, link);
+		if (entry_fetch(queue, entry) == ISC_R_SUCCESS) {
+			queue->tokens -= STALEREFRESH_TICKS;
+		} else {
+			entry_wait(queue, entry, now);
+		}
+	}
+
+	/*
+	 * Once a second, forget the RRsets nobody asked for again long
+	 * after their wait was over.
+	 */
+	if (now != queue->lastsweep) {
+		queue->lastsweep = now;
+		for (entry = ISC_LIST_HEAD(queue->waiting); entry != NULL;
+		     entry = next)
+		{
+			next = ISC_LIST_NEXT(entry, link);
+			if (isc_serial_ge(now, entry->retry +
+						       STALEREFRESH_MAXBACKOFF))
+			{
+				ISC_LIST_UNLINK(queue->waiting, entry, link);
+				entry_free(queue, entry);
+			}
+		}
+	}
+
+unlock:
+	UNLOCK(&queue->lock);
+}
@@ -29,6 +29,7 @@
 #include <isc/print.h>
 #include <isc/random.h>
 #include <isc/result.h>
+#include <isc/rwlock.h>
 #include <isc/string.h>
 #include <isc/util.h>
 
@@ -122,6 +123,9 @@ dns_tkeyctx_create(isc_mem_t *mctx, dns_tkeyctx_t **tctxp) {
 	tctx->domain = NULL;
 	tctx->gsscred = NULL;
 	tctx->gssapi_keytab = NULL;
+	isc_rwlock_init(&tctx->keytablock, 0, 0);
+	tctx->keytabcred = NULL;
+	tctx->keytabrefresh = 0;
 
 	*tctxp = tctx;
 	return (ISC_R_SUCCESS);
@@ -153,6 +157,10 @@ dns_tkeyctx_destroy(dns_tkeyctx_t **tctxp) {
 	if (tctx->gsscred != NULL) {
 		dst_gssapi_releasecred(&tctx->gsscred);
 	}
+	if (tctx->keytabcred != NULL) {
+		dst_gssapi_releasecred(&tctx->keytabcred);
+	}
+	isc_rwlock_destroy(&tctx->keytablock);
 	isc_mem_putanddetach(&mctx, tctx, sizeof(dns_tkeyctx_t));
 }
 
@@ -477,6 +485,96 @@ failure:
 	return (result);
 }
 
+/*
+ * Acquire the credentials of tkey-gssapi-keytab again if they are
+ * missing, about to expire, or were rejected.  The keytab lock must be
+ * held for writing.
+ */
+static void
+refresh_keytabcred(dns_tkeyctx_t *tctx, isc_stdtime_t now) {
+	isc_result_t result;
+	uint32_t lifetime = 0;
+
+	if (now < tctx->keytabrefresh) {
+		return;
+	}
+
+	if (tctx->keytabcred != NULL) {
+		dst_gssapi_releasecred(&tctx->keytabcred);
+	}
+
+	result = dst_gssapi_acquirekeytab(tctx->gssapi_keytab,
+					  &tctx->keytabcred, &lifetime);
+	if (result != ISC_R_SUCCESS) {
+		/*
+		 * Let dst_gssapi_acceptctx() acquire them for every
+		 * negotiation, as if there was no cache, and try again
+		 * later.
+		 */
+		tkey_log("process_gsstkey(): cannot acquire credentials "
+			 "from %s: %s",
+			 tctx->gssapi_keytab, isc_result_totext(result));
+		tctx->keytabcred = NULL;
+		tctx->keytabrefresh = now + 60;
+		return;
+	}
+
+	tctx->keytabrefresh = now + ISC_MIN(lifetime, DNS_TKEY_GSSCREDREFRESH);
+}
+
+/*
+ * Accept a GSS context with the configured credentials.  The credentials
+ * of tkey-gssapi-keytab are acquired once and shared by the negotiations
+ * until they are refreshed, rather than acquired from the keytab for
+ * every message.
+ */
+static isc_result_t
+gss_accept(dns_tkeyctx_t *tctx, isc_stdtime_t now, isc_region_t *intoken,
+	   isc_buffer_t **outtoken, dns_gss_ctx_id_t *gss_ctx,
+	   dns_name_t *principal) {
+	isc_result_t result;
+
+	if (tctx->gsscred != NULL || tctx->gssapi_keytab == NULL) {
+		return (dst_gssapi_acceptctx(tctx->gsscred, tctx->gssapi_keytab,
+					     intoken, outtoken, gss_ctx,
+					     principal, tctx->mctx));
+	}
+
+	RWLOCK(&tctx->keytablock, isc_rwlocktype_read);
+	if (now >= tctx->keytabrefresh) {
+		RWUNLOCK(&tctx->keytablock, isc_rwlocktype_read);
+		RWLOCK(&tctx->keytablock, isc_rwlocktype_write);
+		refresh_keytabcred(tctx, now);
+		isc_rwlock_downgrade(&tctx->keytablock);
+	}
+
+	if (tctx->keytabcred != NULL) {
+		result = dst_gssapi_acceptctx(tctx->keytabcred, NULL, intoken,
+					      outtoken, gss_ctx, principal,
+					      tctx->mctx);
+		if (result == DNS_R_INVALIDTKEY) {
+			/*
+			 * The keytab may have been replaced with new keys:
+			 * acquire the credentials again soon, but not for
+			 * every bad token.
+			 */
+			RWUNLOCK(&tctx->keytablock, isc_rwlocktype_read);
+			RWLOCK(&tctx->keytablock, isc_rwlocktype_write);
+			tctx->keytabrefresh = ISC_MIN(tctx->keytabrefresh,
+						      now + 60);
+			RWUNLOCK(&tctx->keytablock, isc_rwlocktype_write);
+			return (result);
+		}
+	} else {
+		result = dst_gssapi_acceptctx(NULL, tctx->gssapi_keytab,
+					      intoken, outtoken, gss_ctx,
+					      principal, tctx->mctx);
+	}
+	RWUNLOCK(&tctx->keytablock, isc_rwlocktype_read);
+
+	return (result);
+}
+
 static isc_result_t
 process_gsstkey(dns_message_t *msg, dns_name_t *name, dns_rdata_tkey_t *tkeyin,
 		dns_tkeyctx_t *tctx, dns_rdata_tkey_t *tkeyout,
@@ -527,12 +625,13 @@ process_gsstkey(dns_message_t *msg, dns_name_t *name, dns_rdata_tkey_t *tkeyin,
 
 	principal = dns_fixedname_initname(&fixed);
 
+	isc_stdtime_get(&now);
+
 	/*
 	 * Note that tctx->gsscred may be NULL if tctx->gssapi_keytab is set
 	 */
-	result = dst_gssapi_acceptctx(tctx->gsscred, tctx->gssapi_keytab,
-				      &intoken, &outtoken, &gss_ctx, principal,
-				      tctx->mctx);
+	result = gss_accept(tctx, now, &intoken, &outtoken, &gss_ctx,
+			    principal);
 	if (result == DNS_R_INVALIDTKEY) {
 		if (tsigkey != NULL) {
 			dns_tsigkey_detach(&tsigkey);
@@ -549,8 +648,6 @@ process_gsstkey(dns_message_t *msg, dns_name_t *name, dns_rdata_tkey_t *tkeyin,
 	 * XXXDCL Section 4.1.3: Limit GSS_S_CONTINUE_NEEDED to 10 times.
 	 */
 
-	isc_stdtime_get(&now);
-
 	if (dns_name_countlabels(principal) == 0U) {
 		if (tsigkey != NULL) {
 			dns_tsigkey_detach(&tsigkey);
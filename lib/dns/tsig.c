@@ -18,6 +18,8 @@
 #include <stdlib.h>
 
 #include <isc/buffer.h>
+#include <isc/heap.h>
+#include <isc/ht.h>
 #include <isc/mem.h>
 #include <isc/print.h>
 #include <isc/refcount.h>
@@ -31,7 +33,6 @@
 #include <dns/keyvalues.h>
 #include <dns/log.h>
 #include <dns/message.h>
-#include <dns/rbt.h>
 #include <dns/rdata.h>
 #include <dns/rdatalist.h>
 #include <dns/rdataset.h>
@@ -172,13 +173,47 @@ tsig_log(dns_tsigkey_t *key, int level, const char *fmt, ...) {
 	}
 }
 
+/*
+ * Order generated keys on the expiry heap so that the key that expires
+ * first is at the top.
+ */
+static bool
+expire_less(void *v1, void *v2) {
+	dns_tsigkey_t *k1 = v1;
+	dns_tsigkey_t *k2 = v2;
+
+	return (k1->expire < k2->expire);
+}
+
+static void
+expire_index(void *what, unsigned int index) {
+	dns_tsigkey_t *tkey = what;
+
+	tkey->heapindex = index;
+}
+
+/*
+ * Remove 'tkey' from its ring and drop the ring's reference to it.
+ * Removing a key that is no longer on the ring is a no-op.  The ring
+ * must be write locked.
+ */
 static void
 remove_fromring(dns_tsigkey_t *tkey) {
-	if (tkey->generated) {
-		ISC_LIST_UNLINK(tkey->ring->lru, tkey, link);
-		tkey->ring->generated--;
+	dns_tsig_keyring_t *ring = tkey->ring;
+	isc_result_t result;
+
+	if (tkey->generated && ISC_LINK_LINKED(tkey, link)) {
+		ISC_LIST_UNLINK(ring->lru, tkey, link);
+		ring->generated--;
+	}
+	if (tkey->heapindex != 0) {
+		isc_heap_delete(ring->expiring, tkey->heapindex);
+		tkey->heapindex = 0;
+	}
+	result = isc_ht_delete(ring->keys, tkey->name.ndata, tkey->name.length);
+	if (result == ISC_R_SUCCESS) {
+		dns_tsigkey_detach(&tkey);
 	}
-	(void)dns_rbt_deletename(tkey->ring->keys, &tkey->name, false);
 }
 
 static void
@@ -211,19 +246,22 @@ keyring_add(dns_tsig_keyring_t *ring, const dns_name_t *name,
 	isc_result_t result;
 
 	RWLOCK(&ring->lock, isc_rwlocktype_write);
-	ring->writecount++;
 
 	/*
-	 * Do on the fly cleaning.  Find some nodes we might not
-	 * want around any more.
+	 * Do on the fly cleaning of keys that have expired.
 	 */
-	if (ring->writecount > 10) {
-		cleanup_ring(ring);
-		ring->writecount = 0;
-	}
+	cleanup_ring(ring);
 
-	result = dns_rbt_addname(ring->keys, name, tkey);
+	result = isc_ht_add(ring->keys, name->ndata, name->length, tkey);
 	if (result == ISC_R_SUCCESS && tkey->generated) {
+		/*
+		 * Keys with a validity period are tracked by expiry time
+		 * so that cleanup_ring() never has to scan the ring.
+		 */
+		if (tkey->inception != tkey->expire) {
+			isc_heap_insert(ring->expiring, tkey);
+		}
+
 		/*
 		 * Add the new key to the LRU list and remove the least
 		 * recently used key if there are too many keys on the list.
@@ -315,6 +353,7 @@ dns_tsigkey_createfromkey(const dns_name_t *name, const dns_name_t *algorithm,
 	tkey->mctx = NULL;
 	isc_mem_attach(mctx, &tkey->mctx);
 	ISC_LINK_INIT(tkey, link);
+	tkey->heapindex = 0;
 
 	tkey->magic = TSIG_MAGIC;
 
@@ -374,63 +413,59 @@ cleanup_name:
 }
 
 /*
- * Find a few nodes to destroy if possible.
+ * Return the generated key that expires first if it has expired and
+ * nobody else holds a reference to it.  The ring must be locked.
+ */
+static dns_tsigkey_t *
+expired_key(dns_tsig_keyring_t *ring, isc_stdtime_t now) {
+	dns_tsigkey_t *tkey = isc_heap_element(ring->expiring, 1);
+
+	if (tkey != NULL && tkey->expire < now &&
+	    isc_refcount_current(&tkey->refs) == 1)
+	{
+		return (tkey);
+	}
+	return (NULL);
+}
+
+/*
+ * Destroy the expired generated keys.  The ring must be write locked.
  */
 static void
 cleanup_ring(dns_tsig_keyring_t *ring) {
-	isc_result_t result;
-	dns_rbtnodechain_t chain;
-	dns_name_t foundname;
-	dns_fixedname_t fixedorigin;
-	dns_name_t *origin;
 	isc_stdtime_t now;
-	dns_rbtnode_t *node;
 	dns_tsigkey_t *tkey;
 
-	/*
-	 * Start up a new iterator each time.
-	 */
 	isc_stdtime_get(&now);
-	dns_name_init(&foundname, NULL);
-	origin = dns_fixedname_initname(&fixedorigin);
-
-again:
-	dns_rbtnodechain_init(&chain);
-	result = dns_rbtnodechain_first(&chain, ring->keys, &foundname, origin);
-	if (result != ISC_R_SUCCESS && result != DNS_R_NEWORIGIN) {
-		dns_rbtnodechain_invalidate(&chain);
-		return;
-	}
-
-	for (;;) {
-		node = NULL;
-		dns_rbtnodechain_current(&chain, &foundname, origin, &node);
-		tkey = node->data;
-		if (tkey != NULL) {
-			if (tkey->generated &&
-			    isc_refcount_current(&tkey->refs) == 1 &&
-			    tkey->inception != tkey->expire &&
-			    tkey->expire < now)
-			{
-				tsig_log(tkey, 2, "tsig expire: deleting");
-				/* delete the key */
-				dns_rbtnodechain_invalidate(&chain);
-				remove_fromring(tkey);
-				goto again;
-			}
-		}
-		result = dns_rbtnodechain_next(&chain, &foundname, origin);
-		if (result != ISC_R_SUCCESS && result != DNS_R_NEWORIGIN) {
-			dns_rbtnodechain_invalidate(&chain);
-			return;
-		}
+	while ((tkey = expired_key(ring, now)) != NULL) {
+		tsig_log(tkey, 2, "tsig expire: deleting");
+		remove_fromring(tkey);
 	}
 }
 
 static void
 destroyring(dns_tsig_keyring_t *ring) {
+	isc_result_t result;
+	isc_ht_iter_t *it = NULL;
+
 	isc_refcount_destroy(&ring->references);
-	dns_rbt_destroy(&ring->keys);
+
+	isc_ht_iter_create(ring->keys, &it);
+	for (result = isc_ht_iter_first(it); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_delcurrent_next(it))
+	{
+		dns_tsigkey_t *tkey = NULL;
+
+		isc_ht_iter_current(it, (void **)&tkey);
+		if (tkey->generated && ISC_LINK_LINKED(tkey, link)) {
+			ISC_LIST_UNLINK(ring->lru, tkey, link);
+		}
+		tkey->heapindex = 0;
+		dns_tsigkey_detach(&tkey);
+	}
+	isc_ht_iter_destroy(&it);
+	isc_ht_destroy(&ring->keys);
+	isc_heap_destroy(&ring->expiring);
 	isc_rwlock_destroy(&ring->lock);
 	isc_mem_putanddetach(&ring->mctx, ring, sizeof(dns_tsig_keyring_t));
 }
@@ -591,13 +626,8 @@ dump_key(dns_tsigkey_t *tkey, FILE *fp) {
 isc_result_t
 dns_tsigkeyring_dumpanddetach(dns_tsig_keyring_t **ringp, FILE *fp) {
 	isc_result_t result;
-	dns_rbtnodechain_t chain;
-	dns_name_t foundname;
-	dns_fixedname_t fixedorigin;
-	dns_name_t *origin;
+	isc_ht_iter_t *it = NULL;
 	isc_stdtime_t now;
-	dns_rbtnode_t *node;
-	dns_tsigkey_t *tkey;
 	dns_tsig_keyring_t *ring;
 
 	REQUIRE(ringp != NULL && *ringp != NULL);
@@ -610,33 +640,22 @@ dns_tsigkeyring_dumpanddetach(dns_tsig_keyring_t **ringp, FILE *fp) {
 	}
 
 	isc_stdtime_get(&now);
-	dns_name_init(&foundname, NULL);
-	origin = dns_fixedname_initname(&fixedorigin);
-	dns_rbtnodechain_init(&chain);
-	result = dns_rbtnodechain_first(&chain, ring->keys, &foundname, origin);
-	if (result != ISC_R_SUCCESS && result != DNS_R_NEWORIGIN) {
-		dns_rbtnodechain_invalidate(&chain);
-		goto destroy;
-	}
-
-	for (;;) {
-		node = NULL;
-		dns_rbtnodechain_current(&chain, &foundname, origin, &node);
-		tkey = node->data;
-		if (tkey != NULL && tkey->generated && tkey->expire >= now) {
+	isc_ht_iter_create(ring->keys, &it);
+	for (result = isc_ht_iter_first(it); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_next(it))
+	{
+		dns_tsigkey_t *tkey = NULL;
+
+		isc_ht_iter_current(it, (void **)&tkey);
+		if (tkey->generated && tkey->expire >= now) {
 			dump_key(tkey, fp);
 		}
-		result = dns_rbtnodechain_next(&chain, &foundname, origin);
-		if (result != ISC_R_SUCCESS && result != DNS_R_NEWORIGIN) {
-			dns_rbtnodechain_invalidate(&chain);
-			if (result == ISC_R_NOMORE) {
-				result = ISC_R_SUCCESS;
-			}
-			goto destroy;
-		}
+	}
+	isc_ht_iter_destroy(&it);
+	if (result == ISC_R_NOMORE) {
+		result = ISC_R_SUCCESS;
 	}
 
-destroy:
 	destroyring(ring);
 	return (result);
 }
@@ -1720,15 +1739,25 @@ dns_tsigkey_find(dns_tsigkey_t **tsigkey, const dns_name_t *name,
 	REQUIRE(name != NULL);
 	REQUIRE(ring != NULL);
 
-	RWLOCK(&ring->lock, isc_rwlocktype_write);
-	cleanup_ring(ring);
-	RWUNLOCK(&ring->lock, isc_rwlocktype_write);
-
 	isc_stdtime_get(&now);
 	RWLOCK(&ring->lock, isc_rwlocktype_read);
+
+	/*
+	 * Only take the write lock to clean up the ring when there is
+	 * an expired key to remove; lookups otherwise share the lock.
+	 */
+	if (expired_key(ring, now) != NULL) {
+		RWUNLOCK(&ring->lock, isc_rwlocktype_read);
+		RWLOCK(&ring->lock, isc_rwlocktype_write);
+		cleanup_ring(ring);
+		RWUNLOCK(&ring->lock, isc_rwlocktype_write);
+		RWLOCK(&ring->lock, isc_rwlocktype_read);
+	}
+
 	key = NULL;
-	result = dns_rbt_findname(ring->keys, name, 0, NULL, (void *)&key);
-	if (result == DNS_R_PARTIALMATCH || result == ISC_R_NOTFOUND) {
+	result = isc_ht_find(ring->keys, name->ndata, name->length,
+			     (void **)&key);
+	if (result != ISC_R_SUCCESS) {
 		RWUNLOCK(&ring->lock, isc_rwlocktype_read);
 		return (ISC_R_NOTFOUND);
 	}
@@ -1764,26 +1793,8 @@ dns_tsigkey_find(dns_tsigkey_t **tsigkey, const dns_name_t *name,
 	return (ISC_R_SUCCESS);
 }
 
-static void
-free_tsignode(void *node, void *_unused) {
-	dns_tsigkey_t *key;
-
-	REQUIRE(node != NULL);
-
-	UNUSED(_unused);
-
-	key = node;
-	if (key->generated) {
-		if (ISC_LINK_LINKED(key, link)) {
-			ISC_LIST_UNLINK(key->ring->lru, key, link);
-		}
-	}
-	dns_tsigkey_detach(&key);
-}
-
 isc_result_t
 dns_tsigkeyring_create(isc_mem_t *mctx, dns_tsig_keyring_t **ringp) {
-	isc_result_t result;
 	dns_tsig_keyring_t *ring;
 
 	REQUIRE(mctx != NULL);
@@ -1794,14 +1805,10 @@ dns_tsigkeyring_create(isc_mem_t *mctx, dns_tsig_keyring_t **ringp) {
 
 	isc_rwlock_init(&ring->lock, 0, 0);
 	ring->keys = NULL;
-	result = dns_rbt_create(mctx, free_tsignode, NULL, &ring->keys);
-	if (result != ISC_R_SUCCESS) {
-		isc_rwlock_destroy(&ring->lock);
-		isc_mem_put(mctx, ring, sizeof(dns_tsig_keyring_t));
-		return (result);
-	}
+	isc_ht_init(&ring->keys, mctx, 8, ISC_HT_CASE_INSENSITIVE);
+	ring->expiring = NULL;
+	isc_heap_create(mctx, expire_less, expire_index, 0, &ring->expiring);
 
-	ring->writecount = 0;
 	ring->mctx = NULL;
 	ring->generated = 0;
 	ring->maxgenerated = DNS_TSIG_MAXGENERATEDKEYS;
@@ -57,6 +57,8 @@
 #include <dns/zone.h>
 #include <dns/zt.h>
 
+#include "zone_p.h"
+
 /**************************************************************************/
 
 #define STATE_MAGIC	       ISC_MAGIC('S', 'T', 'T', 'E')
@@ -1056,29 +1058,19 @@ failure:
 	return (result);
 }
 
+/*
+ * The zone keeps the keys loaded for the last update, and only reads
+ * the key files again when they may have changed.
+ */
 static isc_result_t
 find_zone_keys(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *ver,
-	       isc_mem_t *mctx, unsigned int maxkeys, dst_key_t **keys,
-	       unsigned int *nkeys) {
-	isc_result_t result;
+	       unsigned int maxkeys, dst_key_t **keys, unsigned int *nkeys) {
 	isc_stdtime_t now;
-	dns_dbnode_t *node = NULL;
-	const char *directory = dns_zone_getkeydirectory(zone);
 
-	CHECK(dns_db_findnode(db, dns_db_origin(db), false, &node));
 	isc_stdtime_get(&now);
 
-	dns_zone_lock_keyfiles(zone);
-	result = dns_dnssec_findzonekeys(db, ver, node, dns_db_origin(db),
-					 directory, now, mctx, maxkeys, keys,
-					 nkeys);
-	dns_zone_unlock_keyfiles(zone);
-
-failure:
-	if (node != NULL) {
-		dns_db_detachnode(db, &node);
-	}
-	return (result);
+	return (dns__zone_updatekeys(zone, db, ver, now, maxkeys, keys,
+				     nkeys));
 }
 
 /*%
@@ -1550,9 +1542,8 @@ dns_update_signaturesinc(dns_update_log_t *log, dns_zone_t *zone, dns_db_t *db,
 		state->nkeys = 0;
 		state->build_nsec3 = false;
 
-		result = find_zone_keys(zone, db, newver, diff->mctx,
-					DNS_MAXZONEKEYS, state->zone_keys,
-					&state->nkeys);
+		result = find_zone_keys(zone, db, newver, DNS_MAXZONEKEYS,
+					state->zone_keys, &state->nkeys);
 		if (result != ISC_R_SUCCESS) {
 			update_log(log, zone, ISC_LOG_ERROR,
 				   "could not get zone keys for secure "
@@ -15,19 +15,26 @@
 #include <stdbool.h>
 
 #include <isc/base32.h>
+#include <isc/loop.h>
 #include <isc/md.h>
 #include <isc/mem.h>
 #include <isc/print.h>
 #include <isc/result.h>
+#include <isc/stats.h>
+#include <isc/stdtime.h>
 #include <isc/string.h>
 #include <isc/task.h>
+#include <isc/time.h>
 #include <isc/util.h>
+#include <isc/work.h>
 
+#include <dns/cache.h>
 #include <dns/client.h>
 #include <dns/db.h>
 #include <dns/dnssec.h>
 #include <dns/ds.h>
 #include <dns/events.h>
+#include <dns/keycache.h>
 #include <dns/keytable.h>
 #include <dns/keyvalues.h>
 #include <dns/log.h>
@@ -39,6 +46,8 @@
 #include <dns/rdataset.h>
 #include <dns/rdatatype.h>
 #include <dns/resolver.h>
+#include <dns/sigcache.h>
+#include <dns/stats.h>
 #include <dns/validator.h>
 #include <dns/view.h>
 
@@ -70,7 +79,10 @@
 #define VALATTR_TRIEDVERIFY                                    \
 	0x0004			  /*%< We have found a key and \
 				   * have attempted a verify. */
-#define VALATTR_INSECURITY 0x0010 /*%< Attempting proveunsecure. */
+#define VALATTR_OFFLOADED     0x0008 /*%< Verifying in a worker thread. */
+#define VALATTR_INSECURITY    0x0010 /*%< Attempting proveunsecure. */
+#define VALATTR_VERIFIED      0x0020 /*%< Worker thread is done. */
+#define VALATTR_OFFLOADDNSKEY 0x0040 /*%< Worker verifies the DNSKEY set. */
 
 /*!
  * NSEC proofs to be looked for.
@@ -98,8 +110,11 @@
 #define FOUNDCLOSEST(val)    ((val->attributes & VALATTR_FOUNDCLOSEST) != 0)
 #define FOUNDOPTOUT(val)     ((val->attributes & VALATTR_FOUNDOPTOUT) != 0)
 
-#define SHUTDOWN(v) (((v)->attributes & VALATTR_SHUTDOWN) != 0)
-#define CANCELED(v) (((v)->attributes & VALATTR_CANCELED) != 0)
+#define SHUTDOWN(v)	 (((v)->attributes & VALATTR_SHUTDOWN) != 0)
+#define CANCELED(v)	 (((v)->attributes & VALATTR_CANCELED) != 0)
+#define OFFLOADED(v)	 (((v)->attributes & VALATTR_OFFLOADED) != 0)
+#define VERIFIED(v)	 (((v)->attributes & VALATTR_VERIFIED) != 0)
+#define OFFLOADDNSKEY(v) (((v)->attributes & VALATTR_OFFLOADDNSKEY) != 0)
 
 #define NEGATIVE(r) (((r)->attributes & DNS_RDATASETATTR_NEGATIVE) != 0)
 #define NXDOMAIN(r) (((r)->attributes & DNS_RDATASETATTR_NXDOMAIN) != 0)
@@ -243,7 +258,7 @@ exit_check(dns_validator_t *val) {
 
 	INSIST(val->event == NULL);
 
-	if (val->fetch != NULL || val->subvalidator != NULL) {
+	if (val->fetch != NULL || val->subvalidator != NULL || OFFLOADED(val)) {
 		return (false);
 	}
 
@@ -1095,6 +1110,38 @@ create_validator(dns_validator_t *val, dns_name_t *name, dns_rdatatype_t type,
 	return (result);
 }
 
+static dns_keytag_t
+compute_keytag(dns_rdata_t *rdata) {
+	isc_region_t r;
+
+	dns_rdata_toregion(rdata, &r);
+	return (dst_region_computeid(&r));
+}
+
+/*%
+ * Set '*keyp' to the key of the DNSKEY 'rdata' owned by 'name' and taken
+ * from 'rdataset'.  The key is shared through the key cache of the view,
+ * if there is one, until 'rdataset' expires.
+ */
+static isc_result_t
+key_fromrdata(dns_validator_t *val, const dns_name_t *name,
+	      dns_rdataset_t *rdataset, dns_rdata_t *rdata, dst_key_t **keyp) {
+	dns_keycache_t *keycache = NULL;
+	isc_stdtime_t now;
+
+	if (val->view->cache != NULL) {
+		keycache = dns_cache_getkeycache(val->view->cache);
+	}
+	if (keycache == NULL) {
+		return (dns_dnssec_keyfromrdata(name, rdata, val->view->mctx,
+						keyp));
+	}
+
+	isc_stdtime_get(&now);
+	return (dns_keycache_get(keycache, name, rdata, now,
+				 now + rdataset->ttl, keyp));
+}
+
 /*%
  * Try to find a key that could have signed val->siginfo among those in
  * 'rdataset'.  If found, build a dst_key_t for it and point val->key at
@@ -1104,6 +1151,9 @@ create_validator(dns_validator_t *val, dns_name_t *name, dns_rdatatype_t type,
  * search past it for the *next* key that could have signed 'siginfo', then
  * set val->key to that.
  *
+ * Records whose algorithm and key tag do not match 'siginfo' are skipped
+ * without being parsed.
+ *
  * Returns ISC_R_SUCCESS if a possible matching key has been found,
  * ISC_R_NOTFOUND if not. Any other value indicates error.
  */
@@ -1111,8 +1161,6 @@ static isc_result_t
 select_signing_key(dns_validator_t *val, dns_rdataset_t *rdataset) {
 	isc_result_t result;
 	dns_rdata_rrsig_t *siginfo = val->siginfo;
-	isc_buffer_t b;
-	dns_rdata_t rdata = DNS_RDATA_INIT;
 	dst_key_t *oldkey = val->key;
 	bool foundold;
 
@@ -1123,46 +1171,46 @@ select_signing_key(dns_validator_t *val, dns_rdataset_t *rdataset) {
 		val->key = NULL;
 	}
 
-	result = dns_rdataset_first(rdataset);
-	if (result != ISC_R_SUCCESS) {
-		goto failure;
-	}
-	do {
+	for (result = dns_rdataset_first(rdataset); result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(rdataset))
+	{
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+
 		dns_rdataset_current(rdataset, &rdata);
+		if (rdata.length < 4 || rdata.data[3] != siginfo->algorithm ||
+		    compute_keytag(&rdata) != siginfo->keyid)
+		{
+			continue;
+		}
 
-		isc_buffer_init(&b, rdata.data, rdata.length);
-		isc_buffer_add(&b, rdata.length);
 		INSIST(val->key == NULL);
-		result = dst_key_fromdns(&siginfo->signer, rdata.rdclass, &b,
-					 val->view->mctx, &val->key);
-		if (result == ISC_R_SUCCESS) {
-			if (siginfo->algorithm ==
-				    (dns_secalg_t)dst_key_alg(val->key) &&
-			    siginfo->keyid ==
-				    (dns_keytag_t)dst_key_id(val->key) &&
-			    dst_key_iszonekey(val->key))
-			{
-				if (foundold) {
-					/*
-					 * This is the key we're looking for.
-					 */
-					return (ISC_R_SUCCESS);
-				} else if (dst_key_compare(oldkey, val->key)) {
-					foundold = true;
-					dst_key_free(&oldkey);
-				}
+		result = key_fromrdata(val, &siginfo->signer, rdataset, &rdata,
+				       &val->key);
+		if (result != ISC_R_SUCCESS) {
+			continue;
+		}
+		if (siginfo->algorithm == (dns_secalg_t)dst_key_alg(val->key) &&
+		    siginfo->keyid == (dns_keytag_t)dst_key_id(val->key) &&
+		    dst_key_iszonekey(val->key))
+		{
+			if (foundold) {
+				/*
+				 * This is the key we're looking for.
+				 */
+				goto done;
+			} else if (dst_key_compare(oldkey, val->key)) {
+				foundold = true;
+				dst_key_free(&oldkey);
 			}
-			dst_key_free(&val->key);
 		}
-		dns_rdata_reset(&rdata);
-		result = dns_rdataset_next(rdataset);
-	} while (result == ISC_R_SUCCESS);
+		dst_key_free(&val->key);
+	}
 
 	if (result == ISC_R_NOMORE) {
 		result = ISC_R_NOTFOUND;
 	}
 
-failure:
+done:
 	if (oldkey != NULL) {
 		dst_key_free(&oldkey);
 	}
@@ -1335,14 +1383,6 @@ seek_dnskey(dns_validator_t *val) {
 /*
  * Compute the tag for a key represented in a DNSKEY rdata.
  */
-static dns_keytag_t
-compute_keytag(dns_rdata_t *rdata) {
-	isc_region_t r;
-
-	dns_rdata_toregion(rdata, &r);
-	return (dst_region_computeid(&r));
-}
-
 /*%
  * Is the DNSKEY rrset in val->event->rdataset self-signed?
  */
@@ -1353,71 +1393,208 @@ selfsigned_dnskey(dns_validator_t *val) {
 	dns_name_t *name = val->event->name;
 	isc_result_t result;
 	isc_mem_t *mctx = val->view->mctx;
+	dst_key_t **keys = NULL;
+	dns_rdata_t *keyrdatas = NULL;
+	dns_rdata_t *sigrdatas = NULL;
+	isc_result_t *results = NULL;
+	unsigned int count = 0, n = 0;
 	bool answer = false;
 
 	if (rdataset->type != dns_rdatatype_dnskey) {
 		return (false);
 	}
 
-	for (result = dns_rdataset_first(rdataset); result == ISC_R_SUCCESS;
-	     result = dns_rdataset_next(rdataset))
-	{
-		dns_rdata_t keyrdata = DNS_RDATA_INIT;
-		dns_rdata_t sigrdata = DNS_RDATA_INIT;
-		dns_rdata_dnskey_t key;
-		dns_rdata_rrsig_t sig;
-		dns_keytag_t keytag;
-
-		dns_rdata_reset(&keyrdata);
-		dns_rdataset_current(rdataset, &keyrdata);
-		result = dns_rdata_tostruct(&keyrdata, &key, NULL);
-		RUNTIME_CHECK(result == ISC_R_SUCCESS);
-		keytag = compute_keytag(&keyrdata);
-
-		for (result = dns_rdataset_first(sigrdataset);
+	/*
+	 * Every self-signature is verified, so they are all verified in
+	 * one batch.  Count the (key, signature) pairs first so that no
+	 * more is allocated than the RRsets call for.
+	 */
+	for (int pass = 0; pass < 2; pass++) {
+		for (result = dns_rdataset_first(rdataset);
 		     result == ISC_R_SUCCESS;
-		     result = dns_rdataset_next(sigrdataset))
+		     result = dns_rdataset_next(rdataset))
 		{
-			dst_key_t *dstkey = NULL;
+			dns_rdata_t keyrdata = DNS_RDATA_INIT;
+			dns_rdata_dnskey_t key;
+			dns_keytag_t keytag;
 
-			dns_rdata_reset(&sigrdata);
-			dns_rdataset_current(sigrdataset, &sigrdata);
-			result = dns_rdata_tostruct(&sigrdata, &sig, NULL);
+			dns_rdataset_current(rdataset, &keyrdata);
+			result = dns_rdata_tostruct(&keyrdata, &key, NULL);
 			RUNTIME_CHECK(result == ISC_R_SUCCESS);
+			keytag = compute_keytag(&keyrdata);
 
-			if (sig.algorithm != key.algorithm ||
-			    sig.keyid != keytag ||
-			    !dns_name_equal(name, &sig.signer))
+			for (result = dns_rdataset_first(sigrdataset);
+			     result == ISC_R_SUCCESS;
+			     result = dns_rdataset_next(sigrdataset))
 			{
-				continue;
-			}
+				dns_rdata_t sigrdata = DNS_RDATA_INIT;
+				dns_rdata_rrsig_t sig;
+				dst_key_t *dstkey = NULL;
+
+				dns_rdataset_current(sigrdataset, &sigrdata);
+				result = dns_rdata_tostruct(&sigrdata, &sig,
+							    NULL);
+				RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+				if (sig.algorithm != key.algorithm ||
+				    sig.keyid != keytag ||
+				    !dns_name_equal(name, &sig.signer))
+				{
+					continue;
+				}
 
-			result = dns_dnssec_keyfromrdata(name, &keyrdata, mctx,
-							 &dstkey);
-			if (result != ISC_R_SUCCESS) {
-				continue;
-			}
+				if (pass == 0) {
+					count++;
+					continue;
+				}
+				if (n == count) {
+					break;
+				}
 
-			result = dns_dnssec_verify(name, rdataset, dstkey, true,
-						   val->view->maxbits, mctx,
-						   &sigrdata, NULL);
-			dst_key_free(&dstkey);
-			if (result != ISC_R_SUCCESS) {
-				continue;
-			}
+				result = key_fromrdata(val, name, rdataset,
+						       &keyrdata, &dstkey);
+				if (result != ISC_R_SUCCESS) {
+					continue;
+				}
 
-			if ((key.flags & DNS_KEYFLAG_REVOKE) == 0) {
-				answer = true;
-				continue;
+				keys[n] = dstkey;
+				dns_rdata_init(&keyrdatas[n]);
+				dns_rdata_clone(&keyrdata, &keyrdatas[n]);
+				dns_rdata_init(&sigrdatas[n]);
+				dns_rdata_clone(&sigrdata, &sigrdatas[n]);
+				n++;
 			}
+		}
 
-			dns_view_untrust(val->view, name, &key);
+		if (count == 0) {
+			return (false);
+		}
+		if (pass == 0) {
+			keys = isc_mem_get(mctx, count * sizeof(keys[0]));
+			keyrdatas = isc_mem_get(mctx,
+						count * sizeof(keyrdatas[0]));
+			sigrdatas = isc_mem_get(mctx,
+						count * sizeof(sigrdatas[0]));
+			results = isc_mem_get(mctx, count * sizeof(results[0]));
 		}
 	}
 
+	dns_dnssec_verifybatch(name, rdataset, keys, sigrdatas, n, true,
+			       val->view->maxbits, mctx, results);
+
+	for (unsigned int i = 0; i < n; i++) {
+		dns_rdata_dnskey_t key;
+
+		dst_key_free(&keys[i]);
+		if (results[i] != ISC_R_SUCCESS) {
+			continue;
+		}
+
+		result = dns_rdata_tostruct(&keyrdatas[i], &key, NULL);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		if ((key.flags & DNS_KEYFLAG_REVOKE) == 0) {
+			answer = true;
+			continue;
+		}
+
+		dns_view_untrust(val->view, name, &key);
+	}
+
+	isc_mem_put(mctx, results, count * sizeof(results[0]));
+	isc_mem_put(mctx, sigrdatas, count * sizeof(sigrdatas[0]));
+	isc_mem_put(mctx, keyrdatas, count * sizeof(keyrdatas[0]));
+	isc_mem_put(mctx, keys, count * sizeof(keys[0]));
+
 	return (answer);
 }
 
+/*%
+ * Add 'amount' to the resolver statistics counter 'counter'.
+ */
+static void
+sigcache_stats(dns_validator_t *val, isc_statscounter_t counter,
+	       uint64_t amount) {
+	isc_stats_t *stats = NULL;
+
+	if (val->view->resolver == NULL) {
+		return;
+	}
+
+	dns_resolver_getstats(val->view->resolver, &stats);
+	if (stats != NULL) {
+		isc_stats_add(stats, counter, amount);
+		isc_stats_detach(&stats);
+	}
+}
+
+/*%
+ * Verify 'rdata' against the RRset being validated with 'key', looking
+ * the outcome up in the signature cache of the view's cache first and
+ * storing it there afterwards.
+ *
+ * Only definite outcomes that remain true until the signature expires
+ * are cached; wildcard answers are not, as the caller needs the source
+ * of synthesis returned in 'wild'.
+ */
+static isc_result_t
+verify_cached(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
+	      dns_name_t *wild) {
+	unsigned char digest[DNS_SIGCACHE_DIGESTLENGTH];
+	dns_sigcache_t *sigcache = NULL;
+	dns_rdata_rrsig_t sig;
+	isc_time_t start, end;
+	isc_stdtime_t now;
+	isc_result_t result, vresult;
+	uint32_t cost = 0;
+
+	if (val->view->cache != NULL) {
+		sigcache = dns_cache_getsigcache(val->view->cache);
+	}
+	if (sigcache != NULL) {
+		result = dns_sigcache_digest(
+			val->event->name, val->event->rdataset, key, rdata,
+			val->view->maxbits, val->view->mctx, digest);
+		if (result != ISC_R_SUCCESS) {
+			sigcache = NULL;
+		}
+	}
+
+	if (sigcache != NULL) {
+		isc_stdtime_get(&now);
+		result = dns_sigcache_find(sigcache, digest, now, &vresult,
+					   &cost);
+		if (result == ISC_R_SUCCESS) {
+			sigcache_stats(val, dns_resstatscounter_sigcachehit, 1);
+			sigcache_stats(val, dns_resstatscounter_sigcachesaved,
+				       cost);
+			return (vresult);
+		}
+		sigcache_stats(val, dns_resstatscounter_sigcachemiss, 1);
+		isc_time_now_hires(&start);
+	}
+
+	vresult = dns_dnssec_verify(val->event->name, val->event->rdataset,
+				    key, false, val->view->maxbits,
+				    val->view->mctx, rdata, wild);
+
+	if (sigcache != NULL &&
+	    (vresult == ISC_R_SUCCESS || vresult == DNS_R_SIGINVALID))
+	{
+		uint64_t usecs;
+
+		isc_time_now_hires(&end);
+		usecs = isc_time_microdiff(&end, &start);
+		cost = (usecs > UINT32_MAX) ? UINT32_MAX : (uint32_t)usecs;
+
+		result = dns_rdata_tostruct(rdata, &sig, NULL);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		dns_sigcache_add(sigcache, digest, sig.timeexpire, vresult,
+				 cost);
+	}
+
+	return (vresult);
+}
+
 /*%
  * Attempt to verify the rdataset using the given key and rdata (RRSIG).
  * The signature was good and from a wildcard record and the QNAME does
@@ -1437,15 +1614,15 @@ verify(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
 
 	val->attributes |= VALATTR_TRIEDVERIFY;
 	wild = dns_fixedname_initname(&fixed);
-again:
-	result = dns_dnssec_verify(val->event->name, val->event->rdataset, key,
-				   ignore, val->view->maxbits, val->view->mctx,
-				   rdata, wild);
+	result = verify_cached(val, key, rdata, wild);
 	if ((result == DNS_R_SIGEXPIRED || result == DNS_R_SIGFUTURE) &&
 	    val->view->acceptexpired)
 	{
 		ignore = true;
-		goto again;
+		result = dns_dnssec_verify(val->event->name,
+					   val->event->rdataset, key, ignore,
+					   val->view->maxbits, val->view->mctx,
+					   rdata, wild);
 	}
 
 	if (ignore && (result == ISC_R_SUCCESS || result == DNS_R_FROMWILDCARD))
@@ -1484,6 +1661,152 @@ again:
 	return (result);
 }
 
+/*%
+ * Try each key in val->keyset that may have generated val->siginfo,
+ * starting with val->key, until one of them verifies 'rdata'.
+ */
+static isc_result_t
+verify_keys(dns_validator_t *val, dns_rdata_t *rdata) {
+	isc_result_t result;
+
+	do {
+		result = verify(val, val->key, rdata, val->siginfo->keyid);
+		if (result == ISC_R_SUCCESS) {
+			break;
+		}
+	} while (select_signing_key(val, val->keyset) == ISC_R_SUCCESS);
+
+	return (result);
+}
+
+/*%
+ * Estimated cost, in microseconds, of verifying a signature made with
+ * 'alg' by a key of 'bits' bits (0 if not known).
+ */
+static unsigned int
+verify_cost(dns_secalg_t alg, unsigned int bits) {
+	switch (alg) {
+	case DST_ALG_RSASHA1:
+	case DST_ALG_NSEC3RSASHA1:
+	case DST_ALG_RSASHA256:
+	case DST_ALG_RSASHA512:
+		if (bits == 0) {
+			bits = 2048;
+		}
+		if (bits <= 1024) {
+			return (10);
+		} else if (bits <= 2048) {
+			return (25);
+		} else if (bits <= 3072) {
+			return (50);
+		}
+		return (90);
+	case DST_ALG_ECDSA256:
+		return (60);
+	case DST_ALG_ECDSA384:
+		return (400);
+	case DST_ALG_ED25519:
+		return (40);
+	case DST_ALG_ED448:
+		return (150);
+	default:
+		return (0);
+	}
+}
+
+static unsigned int
+keycost(dst_key_t *key) {
+	return (verify_cost(dst_key_alg(key), dst_key_size(key)));
+}
+
+/*%
+ * Whether a verification costing 'cost' should be done in a worker
+ * thread rather than on the loop.
+ */
+static bool
+want_offload(dns_validator_t *val, unsigned int cost) {
+	return (val->view->offloadthreshold != 0 &&
+		cost >= val->view->offloadthreshold);
+}
+
+static void
+verify_done(void *arg);
+
+/*%
+ * Hand the verification to 'work_cb' in a worker thread.  The
+ * validation resumes in verify_done() on the current loop, with the
+ * result of the verification in val->vresult.
+ */
+static isc_result_t
+offload_verify(dns_validator_t *val, isc_work_cb work_cb) {
+	isc_loop_t *loop = isc_loop_current(isc_task_getloopmgr(val->task));
+
+	validator_log(val, ISC_LOG_DEBUG(3), "offloading verification");
+
+	val->attributes |= VALATTR_OFFLOADED;
+	isc_work_enqueue(loop, work_cb, verify_done, val);
+
+	return (DNS_R_WAIT);
+}
+
+static void
+verify_done(void *arg) {
+	dns_validator_t *val = arg;
+	bool want_destroy;
+	isc_result_t result;
+	isc_result_t saved_result;
+	bool dnskey;
+
+	LOCK(&val->lock);
+	dnskey = OFFLOADDNSKEY(val);
+	val->attributes &= ~(VALATTR_OFFLOADED | VALATTR_OFFLOADDNSKEY);
+	if (CANCELED(val)) {
+		validator_done(val, ISC_R_CANCELED);
+	} else {
+		val->attributes |= VALATTR_VERIFIED;
+		if (dnskey) {
+			result = validate_dnskey(val);
+		} else {
+			result = validate_answer(val, true);
+		}
+		if (result == DNS_R_NOVALIDSIG &&
+		    (val->attributes & VALATTR_TRIEDVERIFY) == 0)
+		{
+			saved_result = result;
+			validator_log(val, ISC_LOG_DEBUG(3),
+				      "falling back to insecurity proof");
+			result = proveunsecure(val, false, false);
+			if (result == DNS_R_NOTINSECURE) {
+				result = saved_result;
+			}
+		}
+		if (result != DNS_R_WAIT) {
+			validator_done(val, result);
+		}
+	}
+	val->attributes &= ~VALATTR_VERIFIED;
+
+	want_destroy = exit_check(val);
+	UNLOCK(&val->lock);
+	if (want_destroy) {
+		destroy(val);
+	}
+}
+
+/*%
+ * Worker thread part of validate_answer().
+ */
+static void
+verify_answer_work(void *arg) {
+	dns_validator_t *val = arg;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+
+	LOCK(&val->lock);
+	dns_rdataset_current(val->event->sigrdataset, &rdata);
+	val->vresult = verify_keys(val, &rdata);
+	UNLOCK(&val->lock);
+}
+
 /*%
  * Attempts positive response validation of a normal RRset.
  *
@@ -1498,12 +1821,14 @@ validate_answer(dns_validator_t *val, bool resume) {
 	isc_result_t result, vresult = DNS_R_NOVALIDSIG;
 	dns_validatorevent_t *event;
 	dns_rdata_t rdata = DNS_RDATA_INIT;
+	bool verified = VERIFIED(val);
 
 	/*
 	 * Caller must be holding the validator lock.
 	 */
 
 	event = val->event;
+	val->attributes &= ~VALATTR_VERIFIED;
 
 	if (resume) {
 		/*
@@ -1550,28 +1875,24 @@ validate_answer(dns_validator_t *val, bool resume) {
 			}
 		}
 
-		/*
-		 * There isn't a secure DNSKEY for this signature so move
-		 * onto the next RRSIG.
-		 */
-		if (val->key == NULL) {
+		if (verified) {
+			/*
+			 * This signature was verified in a worker thread.
+			 */
+			verified = false;
+			vresult = val->vresult;
+		} else if (val->key == NULL) {
+			/*
+			 * There isn't a secure DNSKEY for this signature so
+			 * move onto the next RRSIG.
+			 */
 			resume = false;
 			continue;
+		} else if (want_offload(val, keycost(val->key))) {
+			return (offload_verify(val, verify_answer_work));
+		} else {
+			vresult = verify_keys(val, &rdata);
 		}
-
-		do {
-			isc_result_t tresult;
-			vresult = verify(val, val->key, &rdata,
-					 val->siginfo->keyid);
-			if (vresult == ISC_R_SUCCESS) {
-				break;
-			}
-
-			tresult = select_signing_key(val, val->keyset);
-			if (tresult != ISC_R_SUCCESS) {
-				break;
-			}
-		} while (1);
 		if (vresult != ISC_R_SUCCESS) {
 			validator_log(val, ISC_LOG_DEBUG(3),
 				      "failed to verify rdataset");
@@ -1648,9 +1969,9 @@ check_signer(dns_validator_t *val, dns_rdata_t *keyrdata, uint16_t keyid,
 			continue;
 		}
 		if (dstkey == NULL) {
-			result = dns_dnssec_keyfromrdata(
-				val->event->name, keyrdata, val->view->mctx,
-				&dstkey);
+			result = key_fromrdata(val, val->event->name,
+					       val->event->rdataset, keyrdata,
+					       &dstkey);
 			if (result != ISC_R_SUCCESS) {
 				/*
 				 * This really shouldn't happen, but...
@@ -1761,90 +2082,23 @@ get_dsset(dns_validator_t *val, dns_name_t *tname, isc_result_t *resp) {
 }
 
 /*%
- * Attempts positive response validation of an RRset containing zone keys
- * (i.e. a DNSKEY rrset).
- *
- * Caller must be holding the validator lock.
+ * Look through the DS RRset (val->dsset) for keys that may have signed
+ * the DNSKEY RRset, and check whether one of them did.
  *
  * Returns:
- * \li	ISC_R_SUCCESS	Validation completed successfully
- * \li	DNS_R_WAIT	Validation has started but is waiting
- *			for an event.
- * \li	Other return codes are possible and all indicate failure.
+ * \li	ISC_R_SUCCESS	a DNSKEY matching a DS signed the RRset.
+ * \li	ISC_R_NOTFOUND	no DS has a supported algorithm and digest.
+ * \li	DNS_R_NOVALIDSIG	otherwise.
  */
 static isc_result_t
-validate_dnskey(dns_validator_t *val) {
+check_dsset(dns_validator_t *val) {
 	isc_result_t result;
 	dns_rdata_t dsrdata = DNS_RDATA_INIT;
 	dns_rdata_t keyrdata = DNS_RDATA_INIT;
-	dns_keynode_t *keynode = NULL;
 	dns_rdata_ds_t ds;
 	bool supported_algorithm;
 	char digest_types[256];
 
-	/*
-	 * If we don't already have a DS RRset, check to see if there's
-	 * a DS style trust anchor configured for this key.
-	 */
-	if (val->dsset == NULL) {
-		result = dns_keytable_find(val->keytable, val->event->name,
-					   &keynode);
-		if (result == ISC_R_SUCCESS) {
-			if (dns_keynode_dsset(keynode, &val->fdsset)) {
-				val->dsset = &val->fdsset;
-			}
-			dns_keytable_detachkeynode(val->keytable, &keynode);
-		}
-	}
-
-	/*
-	 * No trust anchor for this name, so we look up the DS at the parent.
-	 */
-	if (val->dsset == NULL) {
-		isc_result_t tresult = ISC_R_SUCCESS;
-
-		/*
-		 * If this is the root name and there was no trust anchor,
-		 * we can give up now, since there's no DS at the root.
-		 */
-		if (dns_name_equal(val->event->name, dns_rootname)) {
-			if ((val->attributes & VALATTR_TRIEDVERIFY) != 0) {
-				validator_log(val, ISC_LOG_DEBUG(3),
-					      "root key failed to validate");
-			} else {
-				validator_log(val, ISC_LOG_DEBUG(3),
-					      "no trusted root key");
-			}
-			result = DNS_R_NOVALIDSIG;
-			goto cleanup;
-		}
-
-		/*
-		 * Look up the DS RRset for this name.
-		 */
-		result = get_dsset(val, val->event->name, &tresult);
-		if (result == ISC_R_COMPLETE) {
-			result = tresult;
-			goto cleanup;
-		}
-	}
-
-	/*
-	 * We have a DS set.
-	 */
-	INSIST(val->dsset != NULL);
-
-	if (val->dsset->trust < dns_trust_secure) {
-		result = markanswer(val, "validate_dnskey (2)", "insecure DS");
-		goto cleanup;
-	}
-
-	/*
-	 * Look through the DS record and find the keys that can sign the
-	 * key set and the matching signature.  For each such key, attempt
-	 * verification.
-	 */
-
 	supported_algorithm = false;
 
 	/*
@@ -1936,10 +2190,142 @@ validate_dnskey(dns_validator_t *val) {
 			      "no RRSIG matching DS key");
 	}
 
+	if (result == ISC_R_SUCCESS) {
+		return (ISC_R_SUCCESS);
+	} else if (result == ISC_R_NOMORE && !supported_algorithm) {
+		return (ISC_R_NOTFOUND);
+	}
+	return (DNS_R_NOVALIDSIG);
+}
+
+/*%
+ * Worker thread part of validate_dnskey().
+ */
+static void
+check_dsset_work(void *arg) {
+	dns_validator_t *val = arg;
+
+	LOCK(&val->lock);
+	val->vresult = check_dsset(val);
+	UNLOCK(&val->lock);
+}
+
+/*%
+ * Estimated cost of verifying the DNSKEY RRset: that of the most
+ * expensive algorithm it is signed with.
+ */
+static unsigned int
+dnskeycost(dns_validator_t *val) {
+	unsigned int cost = 0;
+	isc_result_t result;
+
+	for (result = dns_rdataset_first(val->event->sigrdataset);
+	     result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(val->event->sigrdataset))
+	{
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		dns_rdata_rrsig_t sig;
+
+		dns_rdataset_current(val->event->sigrdataset, &rdata);
+		result = dns_rdata_tostruct(&rdata, &sig, NULL);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		cost = ISC_MAX(cost, verify_cost(sig.algorithm, 0));
+	}
+
+	return (cost);
+}
+
+/*%
+ * Attempts positive response validation of an RRset containing zone keys
+ * (i.e. a DNSKEY rrset).
+ *
+ * Caller must be holding the validator lock.
+ *
+ * Returns:
+ * \li	ISC_R_SUCCESS	Validation completed successfully
+ * \li	DNS_R_WAIT	Validation has started but is waiting
+ *			for an event.
+ * \li	Other return codes are possible and all indicate failure.
+ */
+static isc_result_t
+validate_dnskey(dns_validator_t *val) {
+	isc_result_t result;
+	dns_keynode_t *keynode = NULL;
+
+	/*
+	 * If we don't already have a DS RRset, check to see if there's
+	 * a DS style trust anchor configured for this key.
+	 */
+	if (val->dsset == NULL) {
+		result = dns_keytable_find(val->keytable, val->event->name,
+					   &keynode);
+		if (result == ISC_R_SUCCESS) {
+			if (dns_keynode_dsset(keynode, &val->fdsset)) {
+				val->dsset = &val->fdsset;
+			}
+			dns_keytable_detachkeynode(val->keytable, &keynode);
+		}
+	}
+
+	/*
+	 * No trust anchor for this name, so we look up the DS at the parent.
+	 */
+	if (val->dsset == NULL) {
+		isc_result_t tresult = ISC_R_SUCCESS;
+
+		/*
+		 * If this is the root name and there was no trust anchor,
+		 * we can give up now, since there's no DS at the root.
+		 */
+		if (dns_name_equal(val->event->name, dns_rootname)) {
+			if ((val->attributes & VALATTR_TRIEDVERIFY) != 0) {
+				validator_log(val, ISC_LOG_DEBUG(3),
+					      "root key failed to validate");
+			} else {
+				validator_log(val, ISC_LOG_DEBUG(3),
+					      "no trusted root key");
+			}
+			result = DNS_R_NOVALIDSIG;
+			goto cleanup;
+		}
+
+		/*
+		 * Look up the DS RRset for this name.
+		 */
+		result = get_dsset(val, val->event->name, &tresult);
+		if (result == ISC_R_COMPLETE) {
+			result = tresult;
+			goto cleanup;
+		}
+	}
+
+	/*
+	 * We have a DS set.
+	 */
+	INSIST(val->dsset != NULL);
+
+	if (val->dsset->trust < dns_trust_secure) {
+		result = markanswer(val, "validate_dnskey (2)", "insecure DS");
+		goto cleanup;
+	}
+
+	if (VERIFIED(val)) {
+		/*
+		 * The DS RRset was checked in a worker thread.
+		 */
+		val->attributes &= ~VALATTR_VERIFIED;
+		result = val->vresult;
+	} else if (want_offload(val, dnskeycost(val))) {
+		val->attributes |= VALATTR_OFFLOADDNSKEY;
+		return (offload_verify(val, check_dsset_work));
+	} else {
+		result = check_dsset(val);
+	}
+
 	if (result == ISC_R_SUCCESS) {
 		marksecure(val->event);
 		validator_log(val, ISC_LOG_DEBUG(3), "marking as secure (DS)");
-	} else if (result == ISC_R_NOMORE && !supported_algorithm) {
+	} else if (result == ISC_R_NOTFOUND) {
 		validator_log(val, ISC_LOG_DEBUG(3),
 			      "no supported algorithm/digest (DS)");
 		result = markanswer(val, "validate_dnskey (3)",
@@ -25,6 +25,7 @@
 #include <isc/dir.h>
 #include <isc/file.h>
 #include <isc/hash.h>
+#include <isc/histo.h>
 #include <isc/lex.h>
 #include <isc/print.h>
 #include <isc/result.h>
@@ -48,15 +49,18 @@
 #include <dns/keyvalues.h>
 #include <dns/master.h>
 #include <dns/masterdump.h>
+#include <dns/nsec3index.h>
 #include <dns/nta.h>
 #include <dns/order.h>
 #include <dns/peer.h>
+#include <dns/prefetch.h>
 #include <dns/rbt.h>
 #include <dns/rdataset.h>
 #include <dns/request.h>
 #include <dns/resolver.h>
 #include <dns/rpz.h>
 #include <dns/rrl.h>
+#include <dns/stalerefresh.h>
 #include <dns/stats.h>
 #include <dns/time.h>
 #include <dns/transport.h>
@@ -80,7 +84,7 @@ dns_view_create(isc_mem_t *mctx, dns_rdataclass_t rdclass, const char *name,
 		dns_view_t **viewp) {
 	dns_view_t *view = NULL;
 	isc_result_t result;
-	char buffer[1024];
+	char buffer[1024], adbbuffer[1024];
 
 	REQUIRE(name != NULL);
 	REQUIRE(viewp != NULL && *viewp == NULL);
@@ -89,12 +93,18 @@ dns_view_create(isc_mem_t *mctx, dns_rdataclass_t rdclass, const char *name,
 	if (result != ISC_R_SUCCESS) {
 		return (result);
 	}
+	result = isc_file_sanitize(NULL, name, "adb", adbbuffer,
+				   sizeof(adbbuffer));
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
 
 	view = isc_mem_get(mctx, sizeof(*view));
 	*view = (dns_view_t){
 		.rdclass = rdclass,
 		.name = isc_mem_strdup(mctx, name),
 		.nta_file = isc_mem_strdup(mctx, buffer),
+		.adb_file = isc_mem_strdup(mctx, adbbuffer),
 		.recursion = true,
 		.enablevalidation = true,
 		.minimalresponses = dns_minimal_no,
@@ -159,6 +169,8 @@ dns_view_create(isc_mem_t *mctx, dns_rdataclass_t rdclass, const char *name,
 		goto cleanup_dynkeys;
 	}
 
+	dns_nsec3index_create(view->mctx, &view->nsec3index);
+
 	isc_mutex_init(&view->new_zone_lock);
 
 	result = dns_order_create(view->mctx, &view->order);
@@ -193,6 +205,7 @@ cleanup_order:
 
 cleanup_new_zone_lock:
 	isc_mutex_destroy(&view->new_zone_lock);
+	dns_nsec3index_destroy(&view->nsec3index);
 	dns_badcache_destroy(&view->failcache);
 
 cleanup_dynkeys:
@@ -223,6 +236,9 @@ cleanup_mutex:
 	if (view->nta_file != NULL) {
 		isc_mem_free(mctx, view->nta_file);
 	}
+	if (view->adb_file != NULL) {
+		isc_mem_free(mctx, view->adb_file);
+	}
 
 	isc_mem_free(mctx, view->name);
 	isc_mem_putanddetach(&view->mctx, view, sizeof(*view));
@@ -428,6 +444,12 @@ destroy(dns_view_t *view) {
 	if (view->ntatable_priv != NULL) {
 		dns_ntatable_detach(&view->ntatable_priv);
 	}
+	if (view->prefetch != NULL) {
+		dns_prefetch_detach(&view->prefetch);
+	}
+	if (view->stalerefresh != NULL) {
+		dns_stalerefresh_detach(&view->stalerefresh);
+	}
 	for (dns64 = ISC_LIST_HEAD(view->dns64); dns64 != NULL;
 	     dns64 = ISC_LIST_HEAD(view->dns64))
 	{
@@ -444,6 +466,9 @@ destroy(dns_view_t *view) {
 	if (view->dtenv != NULL) {
 		dns_dt_detach(&view->dtenv);
 	}
+	if (view->dtfilter != NULL) {
+		dns_dtfilter_destroy(&view->dtfilter);
+	}
 #endif /* HAVE_DNSTAP */
 	dns_view_setnewzones(view, false, NULL, NULL, 0ULL);
 	if (view->new_zone_file != NULL) {
@@ -469,12 +494,16 @@ destroy(dns_view_t *view) {
 	if (view->failcache != NULL) {
 		dns_badcache_destroy(&view->failcache);
 	}
+	if (view->nsec3index != NULL) {
+		dns_nsec3index_destroy(&view->nsec3index);
+	}
 	isc_mutex_destroy(&view->new_zone_lock);
 	isc_rwlock_destroy(&view->sfd_lock);
 	isc_mutex_destroy(&view->lock);
 	isc_refcount_destroy(&view->references);
 	isc_refcount_destroy(&view->weakrefs);
 	isc_mem_free(view->mctx, view->nta_file);
+	isc_mem_free(view->mctx, view->adb_file);
 	isc_mem_free(view->mctx, view->name);
 	if (view->hooktable != NULL && view->hooktable_free != NULL) {
 		view->hooktable_free(view->mctx, &view->hooktable);
@@ -482,6 +511,13 @@ destroy(dns_view_t *view) {
 	if (view->plugins != NULL && view->plugins_free != NULL) {
 		view->plugins_free(view->mctx, &view->plugins);
 	}
+	for (int t = 0; t < dns_latency_transport_max; t++) {
+		for (int s = 0; s < dns_latency_source_max; s++) {
+			if (view->latencystats[t][s] != NULL) {
+				isc_histo_detach(&view->latencystats[t][s]);
+			}
+		}
+	}
 	isc_mem_putanddetach(&view->mctx, view, sizeof(*view));
 }
 
@@ -510,6 +546,12 @@ dns_view_detach(dns_view_t **viewp) {
 
 		isc_refcount_destroy(&view->references);
 
+		if (view->prefetch != NULL) {
+			dns_prefetch_shutdown(view->prefetch);
+		}
+		if (view->stalerefresh != NULL) {
+			dns_stalerefresh_shutdown(view->stalerefresh);
+		}
 		if (view->resolver != NULL) {
 			dns_resolver_shutdown(view->resolver);
 			dns_resolver_detach(&view->resolver);
@@ -1495,6 +1537,9 @@ dns_view_flushcache(dns_view_t *view, bool fixuponly) {
 	if (view->failcache != NULL) {
 		dns_badcache_flush(view->failcache);
 	}
+	if (view->nsec3index != NULL) {
+		dns_nsec3index_flush(view->nsec3index);
+	}
 
 	dns_adb_flush(view->adb);
 	return (ISC_R_SUCCESS);
@@ -1521,6 +1566,9 @@ dns_view_flushnode(dns_view_t *view, const dns_name_t *name, bool tree) {
 		if (view->failcache != NULL) {
 			dns_badcache_flushtree(view->failcache, name);
 		}
+		if (view->nsec3index != NULL) {
+			dns_nsec3index_flushname(view->nsec3index, name, true);
+		}
 	} else {
 		if (view->adb != NULL) {
 			dns_adb_flushname(view->adb, name);
@@ -1531,6 +1579,10 @@ dns_view_flushnode(dns_view_t *view, const dns_name_t *name, bool tree) {
 		if (view->failcache != NULL) {
 			dns_badcache_flushname(view->failcache, name);
 		}
+		if (view->nsec3index != NULL) {
+			dns_nsec3index_flushname(view->nsec3index, name,
+						 false);
+		}
 	}
 
 	if (view->cache != NULL) {
@@ -2230,6 +2282,147 @@ cleanup:
 	return (result);
 }
 
+isc_result_t
+dns_view_saveadb(dns_view_t *view) {
+	isc_result_t result;
+	dns_adb_t *adb = NULL;
+	FILE *fp = NULL;
+
+	REQUIRE(DNS_VIEW_VALID(view));
+
+	if (view->adb == NULL) {
+		return (ISC_R_SUCCESS);
+	}
+	dns_adb_attach(view->adb, &adb);
+
+	CHECK(isc_stdio_open(view->adb_file, "w", &fp));
+
+	result = dns_adb_save(adb, fp);
+	if (result == ISC_R_SUCCESS) {
+		result = isc_stdio_close(fp);
+		fp = NULL;
+	}
+
+cleanup:
+	dns_adb_detach(&adb);
+
+	if (fp != NULL) {
+		(void)isc_stdio_close(fp);
+	}
+
+	/* Don't leave half-baked or empty files lying around. */
+	if (result != ISC_R_SUCCESS) {
+		(void)isc_file_remove(view->adb_file);
+	}
+	if (result == ISC_R_NOTFOUND) {
+		result = ISC_R_SUCCESS;
+	}
+
+	return (result);
+}
+
+static isc_result_t
+getnumber(isc_lex_t *lex, int base, uint32_t *valuep) {
+	isc_result_t result;
+	isc_token_t token;
+	unsigned long value;
+	char *end = NULL;
+
+	result = isc_lex_gettoken(lex, 0, &token);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	if (token.type != isc_tokentype_string) {
+		return (ISC_R_UNEXPECTEDTOKEN);
+	}
+	value = strtoul(TSTR(token), &end, base);
+	if (*end != '\0' || value > UINT32_MAX) {
+		return (ISC_R_BADNUMBER);
+	}
+	*valuep = (uint32_t)value;
+
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+dns_view_loadadb(dns_view_t *view) {
+	isc_result_t result;
+	dns_adb_t *adb = NULL;
+	isc_lex_t *lex = NULL;
+	isc_token_t token;
+
+	REQUIRE(DNS_VIEW_VALID(view));
+
+	if (view->adb == NULL) {
+		return (ISC_R_SUCCESS);
+	}
+	dns_adb_attach(view->adb, &adb);
+
+	CHECK(isc_lex_create(view->mctx, 1025, &lex));
+	CHECK(isc_lex_openfile(lex, view->adb_file));
+
+	for (;;) {
+		int options = (ISC_LEXOPT_EOL | ISC_LEXOPT_EOF);
+		struct in_addr in4;
+		struct in6_addr in6;
+		isc_sockaddr_t sa;
+		uint32_t port, srtt, flags, udpsize;
+		isc_stdtime_t t;
+		bool valid;
+
+		CHECK(isc_lex_gettoken(lex, options, &token));
+		if (token.type == isc_tokentype_eof) {
+			break;
+		} else if (token.type != isc_tokentype_string) {
+			CHECK(ISC_R_UNEXPECTEDTOKEN);
+		}
+
+		/* Addresses with a zone index are not restored. */
+		valid = true;
+		if (inet_pton(AF_INET, TSTR(token), &in4) == 1) {
+			isc_sockaddr_fromin(&sa, &in4, 0);
+		} else if (inet_pton(AF_INET6, TSTR(token), &in6) == 1) {
+			isc_sockaddr_fromin6(&sa, &in6, 0);
+		} else {
+			valid = false;
+		}
+
+		CHECK(getnumber(lex, 10, &port));
+		CHECK(getnumber(lex, 10, &srtt));
+		CHECK(getnumber(lex, 16, &flags));
+		CHECK(getnumber(lex, 10, &udpsize));
+
+		CHECK(isc_lex_gettoken(lex, options, &token));
+		if (token.type != isc_tokentype_string) {
+			CHECK(ISC_R_UNEXPECTEDTOKEN);
+		}
+		CHECK(dns_time32_fromtext(TSTR(token), &t));
+
+		CHECK(isc_lex_gettoken(lex, options, &token));
+		if (token.type != isc_tokentype_eol &&
+		    token.type != isc_tokentype_eof)
+		{
+			CHECK(ISC_R_UNEXPECTEDTOKEN);
+		}
+
+		if (!valid || port > UINT16_MAX || udpsize > UINT16_MAX) {
+			continue;
+		}
+		isc_sockaddr_setport(&sa, (in_port_t)port);
+		dns_adb_seed(adb, &sa, srtt, flags, udpsize, t);
+	}
+
+cleanup:
+	dns_adb_detach(&adb);
+
+	if (lex != NULL) {
+		isc_lex_close(lex);
+		isc_lex_destroy(&lex);
+	}
+
+	return (result);
+}
+
 void
 dns_view_setviewcommit(dns_view_t *view) {
 	dns_zone_t *redirect = NULL, *managed_keys = NULL;
@@ -16,13 +16,16 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/loop.h>
 #include <isc/mem.h>
 #include <isc/netmgr.h>
 #include <isc/print.h>
 #include <isc/random.h>
 #include <isc/result.h>
 #include <isc/string.h>
+#include <isc/task.h>
 #include <isc/util.h>
+#include <isc/work.h>
 
 #include <dns/callbacks.h>
 #include <dns/catz.h>
@@ -68,6 +71,15 @@
 			goto failure;        \
 	} while (0)
 
+/*%
+ * AXFR data is loaded into the new database in a worker thread, in batches
+ * of at least XFRIN_BATCH records, while the following messages are parsed.
+ * Reading stops while XFRIN_MAXPENDING records are waiting for the batch in
+ * progress to be loaded.
+ */
+#define XFRIN_BATCH	 1000
+#define XFRIN_MAXPENDING (16 * XFRIN_BATCH)
+
 /*%
  * The states of the *XFR state machine.  We handle both IXFR and AXFR
  * with a single integrated state machine because they cannot be distinguished
@@ -100,6 +112,7 @@ struct dns_xfrin_ctx {
 	isc_refcount_t references;
 
 	isc_nm_t *netmgr;
+	isc_loopmgr_t *loopmgr;
 
 	isc_refcount_t connects; /*%< Connect in progress */
 	isc_refcount_t sends;	 /*%< Send in progress */
@@ -145,6 +158,11 @@ struct dns_xfrin_ctx {
 	dns_diff_t diff; /*%< Pending database changes */
 	int difflen;	 /*%< Number of pending tuples */
 
+	dns_diff_t applydiff;	  /*%< AXFR batch being loaded */
+	isc_result_t applyresult; /*%< Result of loading it */
+	bool applying;		  /*%< A batch is being loaded */
+	bool paused;		  /*%< Reading waits for the batch */
+
 	xfrin_state_t state;
 	uint32_t end_serial;
 	bool is_ixfr;
@@ -212,7 +230,9 @@ static isc_result_t
 axfr_putdata(dns_xfrin_ctx_t *xfr, dns_diffop_t op, dns_name_t *name,
 	     dns_ttl_t ttl, dns_rdata_t *rdata);
 static isc_result_t
-axfr_apply(dns_xfrin_ctx_t *xfr);
+axfr_apply(dns_xfrin_ctx_t *xfr, dns_diff_t *diff);
+static void
+axfr_offload(dns_xfrin_ctx_t *xfr);
 static isc_result_t
 axfr_commit(dns_xfrin_ctx_t *xfr);
 static isc_result_t
@@ -245,6 +265,8 @@ static void
 xfrin_recv_done(isc_nmhandle_t *handle, isc_result_t result,
 		isc_region_t *region, void *cbarg);
 
+static void
+xfrin_end(dns_xfrin_ctx_t *xfr);
 static void
 xfrin_destroy(dns_xfrin_ctx_t *xfr);
 
@@ -291,12 +313,25 @@ failure:
 static isc_result_t
 axfr_makedb(dns_xfrin_ctx_t *xfr, dns_db_t **dbp) {
 	isc_result_t result;
+	char **argv = NULL;
+	unsigned int argc;
+
+	/*
+	 * Build the new database with the same implementation as the
+	 * zone's, so that "database" applies to transferred zones too.
+	 */
+	result = dns_zone_getdbtype(xfr->zone, &argv, xfr->mctx);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	for (argc = 0; argv[argc] != NULL; argc++) {
+	}
+	INSIST(argc >= 1);
 
-	result = dns_db_create(xfr->mctx, /* XXX */
-			       "rbt",	  /* XXX guess */
-			       &xfr->name, dns_dbtype_zone, xfr->rdclass, 0,
-			       NULL, /* XXX guess */
-			       dbp);
+	result = dns_db_create(xfr->mctx, argv[0], &xfr->name,
+			       dns_dbtype_zone, xfr->rdclass, argc - 1,
+			       argv + 1, dbp);
+	isc_mem_free(xfr->mctx, argv);
 	if (result == ISC_R_SUCCESS) {
 		dns_zone_rpz_enable_db(xfr->zone, *dbp);
 		dns_zone_catz_enable_db(xfr->zone, *dbp);
@@ -319,8 +354,8 @@ axfr_putdata(dns_xfrin_ctx_t *xfr, dns_diffop_t op, dns_name_t *name,
 	CHECK(dns_difftuple_create(xfr->diff.mctx, op, name, ttl, rdata,
 				   &tuple));
 	dns_diff_append(&xfr->diff, &tuple);
-	if (++xfr->difflen > 100) {
-		CHECK(axfr_apply(xfr));
+	if (++xfr->difflen >= XFRIN_BATCH && !xfr->applying) {
+		axfr_offload(xfr);
 	}
 	result = ISC_R_SUCCESS;
 failure:
@@ -331,13 +366,12 @@ failure:
  * Store a set of AXFR RRs in the database.
  */
 static isc_result_t
-axfr_apply(dns_xfrin_ctx_t *xfr) {
+axfr_apply(dns_xfrin_ctx_t *xfr, dns_diff_t *diff) {
 	isc_result_t result;
 	uint64_t records;
 
-	CHECK(dns_diff_load(&xfr->diff, xfr->axfr.add, xfr->axfr.add_private));
-	xfr->difflen = 0;
-	dns_diff_clear(&xfr->diff);
+	CHECK(dns_diff_load(diff, xfr->axfr.add, xfr->axfr.add_private));
+	dns_diff_clear(diff);
 	if (xfr->maxrecords != 0U) {
 		result = dns_db_getsize(xfr->db, xfr->ver, &records, NULL);
 		if (result == ISC_R_SUCCESS && records > xfr->maxrecords) {
@@ -350,11 +384,106 @@ failure:
 	return (result);
 }
 
+static void
+axfr_apply_cb(void *arg) {
+	dns_xfrin_ctx_t *xfr = (dns_xfrin_ctx_t *)arg;
+
+	xfr->applyresult = axfr_apply(xfr, &xfr->applydiff);
+	dns_diff_clear(&xfr->applydiff);
+}
+
+static void
+axfr_apply_done(void *arg);
+
+/*
+ * Hand the pending AXFR RRs to a worker thread, which stores them in the
+ * database while the network loop goes on parsing the following messages.
+ * Only one batch is loaded at a time, in the order they were received.
+ */
+static void
+axfr_offload(dns_xfrin_ctx_t *xfr) {
+	dns_xfrin_ctx_t *apply_xfr = NULL;
+
+	INSIST(!xfr->applying);
+
+	ISC_LIST_APPENDLIST(xfr->applydiff.tuples, xfr->diff.tuples, link);
+	xfr->difflen = 0;
+	xfr->applying = true;
+
+	dns_xfrin_attach(xfr, &apply_xfr);
+	isc_work_enqueue(isc_loop_current(xfr->loopmgr), axfr_apply_cb,
+			 axfr_apply_done, apply_xfr);
+}
+
+/*
+ * Called on the network loop when a batch has been loaded: pass the next
+ * one to the worker thread, and either read the next message or, at the
+ * end of the transfer, commit the new database.
+ */
+static void
+axfr_apply_done(void *arg) {
+	dns_xfrin_ctx_t *xfr = (dns_xfrin_ctx_t *)arg;
+	dns_xfrin_ctx_t *recv_xfr = NULL;
+	isc_result_t result = xfr->applyresult;
+
+	REQUIRE(VALID_XFRIN(xfr));
+
+	xfr->applying = false;
+
+	if (atomic_load(&xfr->shuttingdown)) {
+		result = ISC_R_SHUTTINGDOWN;
+	}
+
+	CHECK(result);
+
+	if (!xfr->paused) {
+		if (xfr->difflen >= XFRIN_BATCH) {
+			axfr_offload(xfr);
+		}
+	} else if (xfr->state == XFRST_AXFR_END) {
+		if (xfr->difflen > 0) {
+			axfr_offload(xfr);
+			goto detach;
+		}
+		CHECK(axfr_commit(xfr));
+		CHECK(axfr_finalize(xfr));
+		xfrin_end(xfr);
+	} else {
+		/*
+		 * Read the next message.
+		 */
+		/* The readhandle is still attached */
+		/* The recv_xfr is still attached */
+		xfr->paused = false;
+		if (xfr->difflen >= XFRIN_BATCH) {
+			axfr_offload(xfr);
+		}
+		isc_refcount_increment0(&xfr->recvs);
+		isc_nm_read(xfr->handle, xfrin_recv_done, xfr);
+	}
+
+failure:
+	if (result != ISC_R_SUCCESS) {
+		xfrin_fail(xfr, result, "failed while receiving responses");
+	}
+
+	if (xfr->paused) {
+		xfr->paused = false;
+		recv_xfr = xfr;
+		isc_nmhandle_detach(&xfr->readhandle);
+		dns_xfrin_detach(&recv_xfr);
+	}
+
+detach:
+	dns_xfrin_detach(&xfr); /* apply_xfr */
+}
+
 static isc_result_t
 axfr_commit(dns_xfrin_ctx_t *xfr) {
 	isc_result_t result;
 
-	CHECK(axfr_apply(xfr));
+	CHECK(axfr_apply(xfr, &xfr->diff));
+	xfr->difflen = 0;
 	CHECK(dns_db_endload(xfr->db, &xfr->axfr));
 	CHECK(dns_zone_verifydb(xfr->zone, xfr->db, NULL));
 
@@ -672,7 +801,10 @@ redo:
 					  "mismatch");
 				FAIL(DNS_R_FORMERR);
 			}
-			CHECK(axfr_commit(xfr));
+			/*
+			 * The database is committed once the whole
+			 * message has been checked, in xfrin_recv_done().
+			 */
 			xfr->state = XFRST_AXFR_END;
 			break;
 		}
@@ -864,6 +996,7 @@ xfrin_create(isc_mem_t *mctx, dns_zone_t *zone, dns_db_t *db, isc_nm_t *netmgr,
 	     dns_tsigkey_t *tsigkey, dns_transport_t *transport,
 	     isc_tlsctx_cache_t *tlsctx_cache, dns_xfrin_ctx_t **xfrp) {
 	dns_xfrin_ctx_t *xfr = NULL;
+	isc_task_t *task = NULL;
 
 	xfr = isc_mem_get(mctx, sizeof(*xfr));
 	*xfr = (dns_xfrin_ctx_t){ .netmgr = netmgr,
@@ -881,6 +1014,10 @@ xfrin_create(isc_mem_t *mctx, dns_zone_t *zone, dns_db_t *db, isc_nm_t *netmgr,
 	dns_zone_iattach(zone, &xfr->zone);
 	dns_name_init(&xfr->name, NULL);
 
+	dns_zone_gettask(zone, &task);
+	xfr->loopmgr = isc_task_getloopmgr(task);
+	isc_task_detach(&task);
+
 	isc_refcount_init(&xfr->connects, 0);
 	isc_refcount_init(&xfr->sends, 0);
 	isc_refcount_init(&xfr->recvs, 0);
@@ -892,6 +1029,7 @@ xfrin_create(isc_mem_t *mctx, dns_zone_t *zone, dns_db_t *db, isc_nm_t *netmgr,
 	}
 
 	dns_diff_init(xfr->mctx, &xfr->diff);
+	dns_diff_init(xfr->mctx, &xfr->applydiff);
 
 	if (reqtype == dns_rdatatype_soa) {
 		xfr->state = XFRST_SOAQUERY;
@@ -1502,7 +1640,8 @@ xfrin_recv_done(isc_nmhandle_t *handle, isc_result_t result,
 		}
 
 		if (xfr->reqtype == dns_rdatatype_axfr ||
-		    xfr->reqtype == dns_rdatatype_soa) {
+		    xfr->reqtype == dns_rdatatype_soa || xfr->applying)
+		{
 			goto failure;
 		}
 
@@ -1681,28 +1820,35 @@ xfrin_recv_done(isc_nmhandle_t *handle, isc_result_t result,
 		CHECK(xfrin_send_request(xfr));
 		break;
 	case XFRST_AXFR_END:
+		if (xfr->applying || xfr->difflen >= XFRIN_BATCH) {
+			/*
+			 * Commit when the batches have been loaded, in
+			 * axfr_apply_done().
+			 */
+			if (!xfr->applying) {
+				axfr_offload(xfr);
+			}
+			xfr->paused = true;
+			dns_message_detach(&msg);
+			return;
+		}
+		CHECK(axfr_commit(xfr));
 		CHECK(axfr_finalize(xfr));
 		FALLTHROUGH;
 	case XFRST_IXFR_END:
-		/*
-		 * Close the journal.
-		 */
-		if (xfr->ixfr.journal != NULL) {
-			dns_journal_destroy(&xfr->ixfr.journal);
-		}
-
-		/*
-		 * Inform the caller we succeeded.
-		 */
-		if (xfr->done != NULL) {
-			(xfr->done)(xfr->zone, ISC_R_SUCCESS);
-			xfr->done = NULL;
-		}
-
-		atomic_store(&xfr->shuttingdown, true);
-		xfr->shutdown_result = ISC_R_SUCCESS;
+		xfrin_end(xfr);
 		break;
 	default:
+		if (xfr->applying && xfr->difflen >= XFRIN_MAXPENDING) {
+			/*
+			 * Stop reading until the worker thread catches up;
+			 * axfr_apply_done() reads the next message.
+			 */
+			xfr->paused = true;
+			dns_message_detach(&msg);
+			return;
+		}
+
 		/*
 		 * Read the next message.
 		 */
@@ -1726,6 +1872,27 @@ failure:
 	dns_xfrin_detach(&xfr); /* recv_xfr */
 }
 
+static void
+xfrin_end(dns_xfrin_ctx_t *xfr) {
+	/*
+	 * Close the journal.
+	 */
+	if (xfr->ixfr.journal != NULL) {
+		dns_journal_destroy(&xfr->ixfr.journal);
+	}
+
+	/*
+	 * Inform the caller we succeeded.
+	 */
+	if (xfr->done != NULL) {
+		(xfr->done)(xfr->zone, ISC_R_SUCCESS);
+		xfr->done = NULL;
+	}
+
+	atomic_store(&xfr->shuttingdown, true);
+	xfr->shutdown_result = ISC_R_SUCCESS;
+}
+
 static void
 xfrin_destroy(dns_xfrin_ctx_t *xfr) {
 	uint64_t msecs;
@@ -1789,6 +1956,7 @@ xfrin_destroy(dns_xfrin_ctx_t *xfr) {
 	}
 
 	dns_diff_clear(&xfr->diff);
+	dns_diff_clear(&xfr->applydiff);
 
 	if (xfr->ixfr.journal != NULL) {
 		dns_journal_destroy(&xfr->ixfr.journal);
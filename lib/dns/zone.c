@@ -17,11 +17,13 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/ascii.h>
 #include <isc/async.h>
 #include <isc/atomic.h>
 #include <isc/file.h>
 #include <isc/hash.h>
 #include <isc/hex.h>
+#include <isc/ht.h>
 #include <isc/loop.h>
 #include <isc/md.h>
 #include <isc/mutex.h>
@@ -38,12 +40,15 @@
 #include <isc/string.h>
 #include <isc/task.h>
 #include <isc/thread.h>
+#include <isc/tid.h>
 #include <isc/timer.h>
 #include <isc/tls.h>
 #include <isc/util.h>
+#include <isc/work.h>
 
 #include <dns/acl.h>
 #include <dns/adb.h>
+#include <dns/anscache.h>
 #include <dns/callbacks.h>
 #include <dns/catz.h>
 #include <dns/db.h>
@@ -55,6 +60,7 @@
 #include <dns/kasp.h>
 #include <dns/keydata.h>
 #include <dns/keymgr.h>
+#include <dns/keypool.h>
 #include <dns/keytable.h>
 #include <dns/keyvalues.h>
 #include <dns/log.h>
@@ -164,6 +170,16 @@
 #define DNS_DUMP_DELAY 900 /*%< 15 minutes */
 #endif			   /* ifndef DNS_DUMP_DELAY */
 
+/*%
+ * Number of zone tasks (and of load tasks) on each loop.  The zones of a
+ * loop are spread over them, so that the events of a busy zone only hold
+ * up the events of the zones sharing its task, not of every zone on the
+ * loop.
+ */
+#ifndef DNS_ZONEMGR_TASKSHARDS
+#define DNS_ZONEMGR_TASKSHARDS 8
+#endif /* ifndef DNS_ZONEMGR_TASKSHARDS */
+
 typedef struct dns_notify dns_notify_t;
 typedef struct dns_checkds dns_checkds_t;
 typedef struct dns_stub dns_stub_t;
@@ -179,7 +195,15 @@ typedef struct dns_nsec3chain dns_nsec3chain_t;
 typedef ISC_LIST(dns_nsec3chain_t) dns_nsec3chainlist_t;
 typedef struct dns_keyfetch dns_keyfetch_t;
 typedef struct dns_asyncload dns_asyncload_t;
+typedef struct dns_zonepeer dns_zonepeer_t;
 typedef struct dns_include dns_include_t;
+typedef struct dns_keyfile dns_keyfile_t;
+typedef ISC_LIST(dns_keyfile_t) dns_keyfilelist_t;
+typedef struct dns_journalwait dns_journalwait_t;
+typedef struct dns_shareddb dns_shareddb_t;
+typedef struct dns_sharedload dns_sharedload_t;
+typedef struct dns_inplace dns_inplace_t;
+typedef struct dns_evicted dns_evicted_t;
 
 #define DNS_ZONE_CHECKLOCK
 #ifdef DNS_ZONE_CHECKLOCK
@@ -263,6 +287,8 @@ struct dns_zone {
 	isc_time_t refreshtime;
 	isc_time_t dumptime;
 	isc_time_t loadtime;
+	isc_time_t loadstart;
+	uint64_t loadusecs;
 	isc_time_t notifytime;
 	isc_time_t resigntime;
 	isc_time_t keywarntime;
@@ -270,6 +296,27 @@ struct dns_zone {
 	isc_time_t nsec3chaintime;
 	isc_time_t refreshkeytime;
 	uint32_t refreshkeyinterval;
+	/*%
+	 * Key files found by the last zone_rekey() with their
+	 * modification times, the modification time of the key
+	 * directory, the refresh time zone_rekey() then scheduled,
+	 * and the next key event (0 if none).  Used to skip periodic
+	 * key reloads when nothing has changed on disk.
+	 */
+	dns_keyfilelist_t keyfiles;
+	isc_time_t keydirtime;
+	isc_time_t keyfilesrefresh;
+	isc_stdtime_t keyfilesevent;
+	/*%
+	 * Signing keys last loaded by dns__zone_updatekeys(), the DNSKEY
+	 * RRset they were loaded for, rendered by dnskey_render(), and
+	 * the time until which they may be used.  Locked by the zone
+	 * lock.
+	 */
+	dst_key_t *updatekeys[DNS_MAXZONEKEYS];
+	unsigned int nupdatekeys;
+	isc_buffer_t *updatekeyset;
+	isc_stdtime_t updatekeysexpire;
 	uint32_t refreshkeycount;
 	uint32_t refresh;
 	uint32_t retry;
@@ -347,6 +394,7 @@ struct dns_zone {
 	dns_request_t *request;
 	dns_loadctx_t *lctx;
 	dns_io_t *readio;
+	dns_zonemgr_t *loadzmgr; /* load slot held in the zone manager */
 	dns_dumpctx_t *dctx;
 	dns_io_t *writeio;
 	uint32_t maxxfrin;
@@ -363,6 +411,7 @@ struct dns_zone {
 	dns_checkmxfunc_t checkmx;
 	dns_checksrvfunc_t checksrv;
 	dns_checknsfunc_t checkns;
+	unsigned int loadthreads;
 	/*%
 	 * Zones in certain states such as "waiting for zone transfer"
 	 * or "zone transfer in progress" are kept on per-state linked lists
@@ -372,6 +421,32 @@ struct dns_zone {
 	 */
 	ISC_LINK(dns_zone_t) statelink;
 	dns_zonelist_t *statelist;
+	ISC_LINK(dns_zone_t) refreshlink; /* Waiting to query a primary */
+	/*%
+	 * The database of a zone with "share-zone-data" set may be shared
+	 * with the identical zones of other views (see zone_getshared()).
+	 * 'shareddb' is the shared database this zone loads, if any, and
+	 * is locked by zmgr->sharelock; 'sharelink' links the zone to the
+	 * shared database it is waiting for.
+	 */
+	dns_shareddb_t *shareddb;
+	ISC_LINK(dns_zone_t) sharelink;
+	bool dbshared; /* The database is shared */
+	/*%
+	 * The reload in place whose version zone_postload() checks.
+	 */
+	dns_inplace_t *inplace;
+	/*%
+	 * The database of a secondary zone with "on-demand-idle-time" set
+	 * is evicted from memory once it has not been used for 'idletime'
+	 * seconds, and loaded back from the zone file when it is next
+	 * needed (see zone_materialize()).  'evicted' is locked by both
+	 * 'evictlock' and the dblock.
+	 */
+	uint32_t idletime;
+	atomic_uint_fast32_t lastused;
+	isc_mutex_t evictlock;
+	dns_evicted_t *evicted;
 	/*%
 	 * Statistics counters about zone management.
 	 */
@@ -412,6 +487,7 @@ struct dns_zone {
 	 */
 	uint32_t signatures;
 	uint32_t nodes;
+	uint32_t signingthreads;
 	dns_rdatatype_t privatetype;
 
 	/*%
@@ -424,6 +500,12 @@ struct dns_zone {
 	 */
 	bool added;
 
+	/*%
+	 * Fingerprint of the configuration the zone was last configured
+	 * with; 0 if unknown.
+	 */
+	uint64_t cfghash;
+
 	/*%
 	 * True if added by automatically by named.
 	 */
@@ -440,6 +522,27 @@ struct dns_zone {
 	 */
 	dns_catz_zones_t *catzs;
 
+	/*%
+	 * rendered answers for the current zone version
+	 */
+	dns_anscache_t *anscache;
+
+	/*%
+	 * UPDATE transactions committed to the journal but not yet on
+	 * stable storage, and the events waiting for them to be.
+	 */
+	isc_mutex_t jsynclock;
+	dns_journal_t *jsyncjournal;
+	ISC_LIST(dns_journalwait_t) jsyncwaits;
+	bool jsyncscheduled;
+
+	/*%
+	 * journal compaction running in the background
+	 */
+	dns_journalcompact_t *jcompact;
+	uint32_t jcompactserial;
+	isc_result_t jcompactresult;
+
 	/*%
 	 * parent catalog zone
 	 */
@@ -573,6 +676,38 @@ typedef enum {
 						* load. */
 } dns_zoneloadflag_t;
 
+/*
+ * Queues of the zone loads waiting for a slot in the zone manager, in
+ * the order they are started: first loads of primary zones, first loads
+ * of the other zones, and reloads of zones that are already serving.
+ */
+#define ZONELOAD_PRIMARY   0
+#define ZONELOAD_OTHER	   1
+#define ZONELOAD_RELOAD	   2
+#define ZONELOAD_PRIORITIES 3
+
+/*
+ * Queues of the zone dumps waiting for a slot in the zone manager, in
+ * the order they are started: dumps flushing zones to disk, dumps of
+ * primary and key zones, whose journals they compact, and the others.
+ */
+#define ZONEDUMP_FLUSH	    0
+#define ZONEDUMP_PRIMARY    1
+#define ZONEDUMP_OTHER	    2
+#define ZONEDUMP_PRIORITIES 3
+
+/*
+ * SOA queries sent in a row to the same primary, while other primaries
+ * have queries waiting.
+ */
+#define REFRESH_BATCH 10U
+
+/*
+ * NOTIFY messages awaiting a response from the same peer.  Further
+ * NOTIFY messages to the peer wait for one of them to complete.
+ */
+#define NOTIFY_PEERMAX 16U
+
 #define UNREACH_CACHE_SIZE 10U
 #define UNREACH_HOLD_TIME  600 /* 10 minutes */
 
@@ -599,6 +734,8 @@ struct dns_zonemgr {
 	isc_taskmgr_t *taskmgr;
 	isc_nm_t *netmgr;
 	uint32_t workers;
+	uint32_t ntasks;
+	atomic_uint_fast32_t nextshard;
 	isc_task_t **zonetasks;
 	isc_task_t **loadtasks;
 	isc_mem_t **mctxpool;
@@ -607,8 +744,13 @@ struct dns_zonemgr {
 	isc_ratelimiter_t *refreshrl;
 	isc_ratelimiter_t *startupnotifyrl;
 	isc_ratelimiter_t *startuprefreshrl;
+	dns_keypool_t *keypool;
 	isc_rwlock_t rwlock;
 	isc_mutex_t iolock;
+	isc_mutex_t dumplock;
+	isc_mutex_t loadlock;
+	isc_mutex_t peerlock;
+	isc_mutex_t sharelock;
 	isc_rwlock_t urlock;
 
 	/* Locked by rwlock. */
@@ -631,6 +773,33 @@ struct dns_zonemgr {
 	dns_iolist_t high;
 	dns_iolist_t low;
 
+	/* Locked by dumplock */
+	uint32_t dumplimit;
+	uint32_t dumpactive;
+	uint32_t dumpqueued;
+	dns_iolist_t dumpqueue[ZONEDUMP_PRIORITIES];
+	uint64_t dumpcompleted;
+	uint64_t dumpcoalesced;
+	uint64_t dumpbytes;
+
+	/* Locked by peerlock */
+	isc_ht_t *peers;
+	ISC_LIST(dns_zonepeer_t) refreshpeers;
+
+	/* Locked by sharelock */
+	isc_ht_t *shareddbs;
+
+	/* Locked by loadlock */
+	uint32_t loadlimit;
+	uint32_t loadactive;
+	uint32_t loadpending;
+	ISC_LIST(dns_asyncload_t) loadqueue[ZONELOAD_PRIORITIES];
+	uint64_t loadcompleted;
+	uint64_t loadbytes;
+	uint64_t loadrunbytes;
+	isc_time_t loadrunstart;
+	isc_time_t loadrunend;
+
 	/* Locked by urlock. */
 	/* LRU cache */
 	struct dns_unreachable unreachable[UNREACH_CACHE_SIZE];
@@ -640,6 +809,59 @@ struct dns_zonemgr {
 	isc_tlsctx_cache_t *tlsctx_cache;
 };
 
+/*%
+ * A primary server or NOTIFY target of the zones of a zone manager.
+ * The SOA queries of the zones waiting to refresh from the peer are
+ * queued on it, so that they are sent to the peer in batches (see
+ * zonemgr_refresh()), and so are the NOTIFY messages waiting for one
+ * of the peer's NOTIFY_PEERMAX slots (see zonemgr_notifyacquire()).
+ */
+struct dns_zonepeer {
+	isc_sockaddr_t addr;
+	dns_zonelist_t refreshes;	/* Waiting for a SOA query */
+	uint32_t queued;		/* Length of 'refreshes' */
+	uint32_t batch;			/* SOA queries sent this turn */
+	uint32_t notifying;		/* NOTIFY slots taken */
+	ISC_LIST(dns_notify_t) notifywait; /* Waiting for a NOTIFY slot */
+	uint64_t soaqueries;		/* SOA queries sent */
+	uint64_t notifies;		/* NOTIFY messages sent */
+	ISC_LINK(dns_zonepeer_t) link;	/* In zmgr->refreshpeers */
+};
+
+/*%
+ * A zone database loaded from a file, which the zones of the zone
+ * manager loading the same file with the same settings share.  'zone'
+ * is the zone that loads it, and is not attached: the entry goes away
+ * with it.  'db' is NULL while it is being loaded, and 'waiting' holds
+ * the zones waiting for it, each attached through its 'sharelink'.
+ */
+struct dns_shareddb {
+	char *key;
+	size_t keylen;
+	dns_zone_t *zone;
+	dns_db_t *db;
+	isc_time_t loadtime;
+	dns_zonelist_t waiting;
+};
+
+/*%
+ * A shared database handed to a zone that waited for it, or NULL if
+ * the zone has to load its own.
+ */
+struct dns_sharedload {
+	dns_zone_t *zone;
+	dns_db_t *db;
+	isc_time_t loadtime;
+};
+
+/*%
+ * A slot of the refresh rate limiter, holding the zone that queued it.
+ */
+struct refresh_event {
+	isc_event_t e;
+	dns_zonemgr_t *zmgr;
+};
+
 /*%
  * Hold notify state.
  */
@@ -657,6 +879,11 @@ struct dns_notify {
 	isc_dscp_t dscp;
 	ISC_LINK(dns_notify_t) link;
 	isc_event_t *event;
+	/* Locked by zmgr->peerlock. */
+	dns_zonemgr_t *zmgr;
+	dns_zonepeer_t *peer;
+	bool paced;			 /* Holds a slot of 'peer' */
+	ISC_LINK(dns_notify_t) peerlink; /* In peer->notifywait */
 };
 
 #define DNS_NOTIFY_NOSOA   0x0001U
@@ -704,6 +931,7 @@ struct dns_load {
 	dns_db_t *db;
 	isc_time_t loadtime;
 	dns_rdatacallbacks_t callbacks;
+	dns_inplace_t *inplace; /* Reloading in place */
 };
 
 /*%
@@ -730,6 +958,9 @@ struct dns_io {
 	unsigned int magic;
 	dns_zonemgr_t *zmgr;
 	bool high;
+	bool dump;		/* A zone dump (see zonemgr_getdump()) */
+	bool active;		/* The dump holds a slot */
+	unsigned int priority;	/* Of the dump */
 	isc_task_t *task;
 	ISC_LINK(dns_io_t) link;
 	isc_event_t *event;
@@ -824,9 +1055,12 @@ struct dns_keyfetch {
  */
 struct dns_asyncload {
 	dns_zone_t *zone;
+	dns_zonemgr_t *zmgr;
 	unsigned int flags;
+	unsigned int priority;
 	dns_zt_zoneloaded_t loaded;
 	void *loaded_arg;
+	ISC_LINK(dns_asyncload_t) link;
 };
 
 /*%
@@ -838,6 +1072,25 @@ struct dns_include {
 	ISC_LINK(dns_include_t) link;
 };
 
+/*%
+ * A key file read by zone_rekey(), and its modification time then
+ */
+struct dns_keyfile {
+	char *name;
+	isc_time_t filetime;
+	ISC_LINK(dns_keyfile_t) link;
+};
+
+/*%
+ * Event to be sent once the journal of a zone is on stable storage
+ */
+struct dns_journalwait {
+	isc_task_t *task;
+	isc_event_t *event;
+	isc_result_t *resultp;
+	ISC_LINK(dns_journalwait_t) link;
+};
+
 /*
  * These can be overridden by the -T mkeytimers option on the command
  * line, so that we can test with shorter periods than specified in
@@ -908,7 +1161,24 @@ zone_shutdown(void *arg);
 static void
 zone_loaddone(void *arg, isc_result_t result);
 static isc_result_t
-zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime);
+zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime,
+	       bool inplace);
+static bool
+zone_caninplace(dns_zone_t *zone);
+static void
+evicted_free(isc_mem_t *mctx, dns_evicted_t **evictedp);
+static isc_result_t
+zone_materialize(dns_zone_t *zone, dns_db_t **dbp);
+static bool
+zone_canevict(dns_zone_t *zone);
+static void
+zone_evict(dns_zone_t *zone);
+static isc_result_t
+zone_loadedserial(dns_zone_t *zone, uint32_t *serialp);
+static isc_result_t
+zone_load(dns_zone_t *zone, unsigned int flags, bool locked);
+static unsigned int
+get_primary_options(dns_zone_t *zone);
 static void
 zone_namerd_tostr(dns_zone_t *zone, char *buf, size_t length);
 static void
@@ -971,6 +1241,37 @@ static void
 zonemgr_putio(dns_io_t **iop);
 static void
 zonemgr_cancelio(dns_io_t *io);
+static isc_result_t
+zonemgr_getdump(dns_zonemgr_t *zmgr, unsigned int priority,
+		isc_task_t *task, isc_taskaction_t action, void *arg,
+		dns_io_t **iop);
+static void
+zonemgr_nextdumps(dns_zonemgr_t *zmgr, dns_iolist_t *send);
+static void
+zonemgr_senddumps(dns_iolist_t *send);
+static void
+zonemgr_putdump(dns_io_t *io);
+static void
+zonemgr_canceldump(dns_io_t *io);
+static void
+zonemgr_dumpdone(dns_zonemgr_t *zmgr, uint64_t bytes, bool coalesced);
+static void
+zonemgr_sendload(dns_asyncload_t *asl);
+static void
+zonemgr_countsent(dns_zonemgr_t *zmgr, const isc_sockaddr_t *addr,
+		  bool notify);
+static bool
+zonemgr_notifyacquire(dns_zonemgr_t *zmgr, dns_notify_t *notify);
+static bool
+zonemgr_notifyunpark(dns_notify_t *notify);
+static void
+zonemgr_notifyrelease(dns_notify_t *notify);
+static void
+notify_resume(dns_notify_t *notify, bool canceled);
+static void
+zonemgr_queueload(dns_zonemgr_t *zmgr, dns_asyncload_t *asl);
+static void
+zonemgr_putload(dns_zonemgr_t **zmgrp, uint64_t bytes);
 static void
 rss_post(dns_zone_t *, isc_event_t *);
 
@@ -1011,6 +1312,8 @@ zone_journal_compact(dns_zone_t *zone, dns_db_t *db, uint32_t serial);
 static isc_result_t
 zone_journal_rollforward(dns_zone_t *zone, dns_db_t *db, bool *needdump,
 			 bool *fixjournal);
+static void
+zone_journal_flush(dns_zone_t *zone);
 
 #define ENTER zone_debuglog(zone, __func__, 1, "enter")
 
@@ -1136,6 +1439,7 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx, unsigned int tid) {
 		.notifydelay = 5,
 		.signatures = 10,
 		.nodes = 100,
+		.signingthreads = 1,
 		.privatetype = (dns_rdatatype_t)0xffffU,
 		.rpz_num = DNS_RPZ_INVALID_NUM,
 		.requestixfr = true,
@@ -1155,6 +1459,8 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx, unsigned int tid) {
 	zone->mctx = NULL;
 	isc_mem_attach(mctx, &zone->mctx);
 	isc_mutex_init(&zone->lock);
+	isc_mutex_init(&zone->jsynclock);
+	isc_mutex_init(&zone->evictlock);
 	ZONEDB_INITLOCK(&zone->dblock);
 	/* XXX MPA check that all elements are initialised */
 #ifdef DNS_ZONE_CHECKLOCK
@@ -1172,15 +1478,19 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx, unsigned int tid) {
 	atomic_init(&zone->flags, 0);
 	atomic_init(&zone->options, 0);
 	atomic_init(&zone->keyopts, 0);
+	atomic_init(&zone->lastused, 0);
 	isc_time_settoepoch(&zone->expiretime);
 	isc_time_settoepoch(&zone->refreshtime);
 	isc_time_settoepoch(&zone->dumptime);
 	isc_time_settoepoch(&zone->loadtime);
+	isc_time_settoepoch(&zone->loadstart);
 	isc_time_settoepoch(&zone->resigntime);
 	isc_time_settoepoch(&zone->keywarntime);
 	isc_time_settoepoch(&zone->signingtime);
 	isc_time_settoepoch(&zone->nsec3chaintime);
 	isc_time_settoepoch(&zone->refreshkeytime);
+	ISC_LIST_INIT(zone->keyfiles);
+	isc_time_settoepoch(&zone->keyfilesrefresh);
 	ISC_LIST_INIT(zone->notifies);
 	ISC_LIST_INIT(zone->checkds_requests);
 	isc_sockaddr_any(&zone->notifysrc4);
@@ -1192,12 +1502,15 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx, unsigned int tid) {
 	isc_sockaddr_any(&zone->altxfrsource4);
 	isc_sockaddr_any6(&zone->altxfrsource6);
 	ISC_LINK_INIT(zone, statelink);
+	ISC_LINK_INIT(zone, refreshlink);
+	ISC_LINK_INIT(zone, sharelink);
 	ISC_LIST_INIT(zone->signing);
 	ISC_LIST_INIT(zone->nsec3chain);
 	ISC_LIST_INIT(zone->setnsec3param_queue);
 	ISC_LIST_INIT(zone->forwards);
 	ISC_LIST_INIT(zone->rss_events);
 	ISC_LIST_INIT(zone->rss_post);
+	ISC_LIST_INIT(zone->jsyncwaits);
 
 	result = isc_stats_create(mctx, &zone->gluecachestats,
 				  dns_gluecachestatscounter_max);
@@ -1218,11 +1531,146 @@ free_refs:
 	isc_refcount_destroy(&zone->erefs);
 	isc_refcount_destroy(&zone->irefs);
 	ZONEDB_DESTROYLOCK(&zone->dblock);
+	isc_mutex_destroy(&zone->evictlock);
+	isc_mutex_destroy(&zone->jsynclock);
 	isc_mutex_destroy(&zone->lock);
 	isc_mem_putanddetach(&zone->mctx, zone, sizeof(*zone));
 	return (result);
 }
 
+/*
+ * Forget the key files recorded by record_keyfiles().
+ */
+static void
+clear_keyfiles(dns_zone_t *zone) {
+	dns_keyfile_t *keyfile = NULL;
+
+	while ((keyfile = ISC_LIST_HEAD(zone->keyfiles)) != NULL) {
+		ISC_LIST_UNLINK(zone->keyfiles, keyfile, link);
+		isc_mem_free(zone->mctx, keyfile->name);
+		isc_mem_put(zone->mctx, keyfile, sizeof(*keyfile));
+	}
+	isc_time_settoepoch(&zone->keyfilesrefresh);
+}
+
+/*
+ * Record the modification times of the key directory and of the files
+ * of 'keys', so that the next periodic zone_rekey() can tell whether
+ * anything changed.  'nexttime' is the next key event, 0 if none.
+ * Called with the zone locked after 'zone->refreshkeytime' was set.
+ */
+static void
+record_keyfiles(dns_zone_t *zone, dns_dnsseckeylist_t *keys,
+		isc_stdtime_t nexttime) {
+	static const int types[] = { DST_TYPE_PUBLIC, DST_TYPE_PRIVATE,
+				     DST_TYPE_STATE };
+	const char *dir = dns_zone_getkeydirectory(zone);
+	isc_result_t result;
+
+	clear_keyfiles(zone);
+
+	result = isc_file_getmodtime(dir != NULL ? dir : ".",
+				     &zone->keydirtime);
+	if (result != ISC_R_SUCCESS) {
+		return;
+	}
+
+	for (dns_dnsseckey_t *key = ISC_LIST_HEAD(*keys); key != NULL;
+	     key = ISC_LIST_NEXT(key, link))
+	{
+		for (size_t i = 0; i < ARRAY_SIZE(types); i++) {
+			char filename[PATH_MAX];
+			dns_keyfile_t *keyfile = NULL;
+			isc_buffer_t b;
+
+			isc_buffer_init(&b, filename, sizeof(filename));
+			result = dst_key_buildfilename(key->key, types[i], dir,
+						       &b);
+			if (result != ISC_R_SUCCESS ||
+			    isc_buffer_availablelength(&b) == 0)
+			{
+				clear_keyfiles(zone);
+				return;
+			}
+			isc_buffer_putuint8(&b, 0);
+
+			keyfile = isc_mem_get(zone->mctx, sizeof(*keyfile));
+			*keyfile = (dns_keyfile_t){
+				.name = isc_mem_strdup(zone->mctx, filename),
+			};
+			ISC_LINK_INIT(keyfile, link);
+			if (isc_file_getmodtime(filename, &keyfile->filetime) !=
+			    ISC_R_SUCCESS)
+			{
+				isc_time_settoepoch(&keyfile->filetime);
+			}
+			ISC_LIST_APPEND(zone->keyfiles, keyfile, link);
+		}
+	}
+
+	zone->keyfilesrefresh = zone->refreshkeytime;
+	zone->keyfilesevent = nexttime;
+}
+
+/*
+ * Return true if the key refresh that is now due was scheduled by the
+ * last zone_rekey() only to look for changes on disk (no key event is
+ * due and nothing requested a rekey since), and neither the key
+ * directory nor any of the key files recorded then has changed.
+ * Called with the zone locked.
+ */
+static bool
+keyfiles_unchanged(dns_zone_t *zone, isc_stdtime_t now) {
+	const char *dir = dns_zone_getkeydirectory(zone);
+	isc_time_t filetime;
+
+	if (zone->kasp == NULL || isc_time_isepoch(&zone->keyfilesrefresh) ||
+	    isc_time_compare(&zone->refreshkeytime, &zone->keyfilesrefresh) !=
+		    0 ||
+	    (zone->keyfilesevent != 0 && zone->keyfilesevent <= now) ||
+	    DNS_ZONEKEY_OPTION(zone, DNS_ZONEKEY_FULLSIGN))
+	{
+		return (false);
+	}
+
+	if (isc_file_getmodtime(dir != NULL ? dir : ".", &filetime) !=
+		    ISC_R_SUCCESS ||
+	    isc_time_compare(&filetime, &zone->keydirtime) != 0)
+	{
+		return (false);
+	}
+
+	for (dns_keyfile_t *keyfile = ISC_LIST_HEAD(zone->keyfiles);
+	     keyfile != NULL; keyfile = ISC_LIST_NEXT(keyfile, link))
+	{
+		if (isc_file_getmodtime(keyfile->name, &filetime) !=
+		    ISC_R_SUCCESS)
+		{
+			isc_time_settoepoch(&filetime);
+		}
+		if (isc_time_compare(&filetime, &keyfile->filetime) != 0) {
+			return (false);
+		}
+	}
+
+	return (true);
+}
+
+/*
+ * Forget the keys kept by dns__zone_updatekeys(), so that the next call
+ * loads them again.  Called with the zone locked, or when it is freed.
+ */
+static void
+clear_updatekeys(dns_zone_t *zone) {
+	for (unsigned int i = 0; i < zone->nupdatekeys; i++) {
+		dst_key_free(&zone->updatekeys[i]);
+	}
+	zone->nupdatekeys = 0;
+	if (zone->updatekeyset != NULL) {
+		isc_buffer_free(&zone->updatekeyset);
+	}
+}
+
 static void
 clear_keylist(dns_dnsseckeylist_t *list, isc_mem_t *mctx) {
 	dns_dnsseckey_t *key;
@@ -1323,6 +1771,8 @@ zone_free(dns_zone_t *zone) {
 		isc_mem_free(zone->mctx, zone->keydirectory);
 	}
 	zone->keydirectory = NULL;
+	clear_keyfiles(zone);
+	clear_updatekeys(zone);
 	if (zone->kasp != NULL) {
 		dns_kasp_detach(&zone->kasp);
 	}
@@ -1358,6 +1808,13 @@ zone_free(dns_zone_t *zone) {
 	if (zone->catzs != NULL) {
 		dns_catz_catzs_detach(&zone->catzs);
 	}
+	if (zone->anscache != NULL) {
+		dns_anscache_destroy(&zone->anscache);
+	}
+	INSIST(zone->jsyncjournal == NULL);
+	INSIST(zone->jcompact == NULL);
+	INSIST(zone->loadzmgr == NULL);
+	INSIST(ISC_LIST_EMPTY(zone->jsyncwaits));
 	zone_freedbargs(zone);
 	dns_zone_setparentals(zone, NULL, NULL, NULL, 0);
 	dns_zone_setprimaries(zone, NULL, NULL, NULL, 0);
@@ -1402,9 +1859,14 @@ zone_free(dns_zone_t *zone) {
 	if (zone->gluecachestats != NULL) {
 		isc_stats_detach(&zone->gluecachestats);
 	}
+	if (zone->evicted != NULL) {
+		evicted_free(zone->mctx, &zone->evicted);
+	}
 
 	/* last stuff */
 	ZONEDB_DESTROYLOCK(&zone->dblock);
+	isc_mutex_destroy(&zone->evictlock);
+	isc_mutex_destroy(&zone->jsynclock);
 	isc_mutex_destroy(&zone->lock);
 	zone->magic = 0;
 	isc_mem_putanddetach(&zone->mctx, zone, sizeof(*zone));
@@ -1492,20 +1954,14 @@ dns_zone_setnotifytype(dns_zone_t *zone, dns_notifytype_t notifytype) {
 isc_result_t
 dns_zone_getserial(dns_zone_t *zone, uint32_t *serialp) {
 	isc_result_t result;
-	unsigned int soacount;
 
 	REQUIRE(DNS_ZONE_VALID(zone));
 	REQUIRE(serialp != NULL);
 
 	LOCK_ZONE(zone);
 	ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_read);
-	if (zone->db != NULL) {
-		result = zone_get_from_db(zone, zone->db, NULL, &soacount, NULL,
-					  serialp, NULL, NULL, NULL, NULL,
-					  NULL);
-		if (result == ISC_R_SUCCESS && soacount == 0) {
-			result = ISC_R_FAILURE;
-		}
+	if (zone->db != NULL || DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADED)) {
+		result = zone_loadedserial(zone, serialp);
 	} else {
 		result = DNS_R_NOTLOADED;
 	}
@@ -1858,6 +2314,8 @@ dns_zone_setjournal(dns_zone_t *zone, const char *myjournal) {
 
 	REQUIRE(DNS_ZONE_VALID(zone));
 
+	zone_journal_flush(zone);
+
 	LOCK_ZONE(zone);
 	result = dns_zone_setstring(zone, &zone->journal, myjournal);
 	UNLOCK_ZONE(zone);
@@ -1958,6 +2416,7 @@ dns_zone_rpz_enable_db(dns_zone_t *zone, dns_db_t *db) {
 		return;
 	}
 	REQUIRE(zone->rpzs != NULL);
+	dns_rpz_setjournal(zone->rpzs->zones[zone->rpz_num], zone->journal);
 	result = dns_db_updatenotify_register(db, dns_rpz_dbupdate_callback,
 					      zone->rpzs->zones[zone->rpz_num]);
 	REQUIRE(result == ISC_R_SUCCESS);
@@ -2092,88 +2551,430 @@ zone_touched(dns_zone_t *zone) {
 }
 
 /*
- * Note: when dealing with inline-signed zones, external callers will always
- * call zone_load() for the secure zone; zone_load() calls itself recursively
- * in order to load the raw zone.
+ * Whether 'zone' is a primary zone loaded from a file and never changed
+ * once loaded, so that the contents of its database are just those of
+ * the file.
  */
-static isc_result_t
-zone_load(dns_zone_t *zone, unsigned int flags, bool locked) {
-	isc_result_t result;
-	isc_time_t now;
-	isc_time_t loadtime;
-	dns_db_t *db = NULL;
-	bool rbt, hasraw, is_dynamic;
-
-	REQUIRE(DNS_ZONE_VALID(zone));
+static bool
+zone_isstatic(dns_zone_t *zone) {
+	if (zone->type != dns_zone_primary || zone->masterfile == NULL ||
+	    zone->stream != NULL || zone->db_argc != 1 || zone->raw != NULL ||
+	    zone->secure != NULL)
+	{
+		return (false);
+	}
 
-	if (!locked) {
-		LOCK_ZONE(zone);
+	if (strcmp(zone->db_argv[0], "rbt") != 0 &&
+	    strcmp(zone->db_argv[0], "qp") != 0)
+	{
+		return (false);
 	}
 
-	INSIST(zone != zone->raw);
-	hasraw = inline_secure(zone);
-	if (hasraw) {
-		/*
-		 * We are trying to load an inline-signed zone.  First call
-		 * self recursively to try loading the raw version of the zone.
-		 * Assuming the raw zone file is readable, there are two
-		 * possibilities:
-		 *
-		 *  a) the raw zone was not yet loaded and thus it will be
-		 *     loaded now, synchronously; if this succeeds, a
-		 *     subsequent attempt to load the signed zone file will
-		 *     take place and thus zone_postload() will be called
-		 *     twice: first for the raw zone and then for the secure
-		 *     zone; the latter call will take care of syncing the raw
-		 *     version with the secure version,
-		 *
-		 *  b) the raw zone was already loaded and we are trying to
-		 *     reload it, which will happen asynchronously; this means
-		 *     zone_postload() will only be called for the raw zone
-		 *     because "result" returned by the zone_load() call below
-		 *     will not be ISC_R_SUCCESS but rather DNS_R_CONTINUE;
-		 *     zone_postload() called for the raw zone will take care
-		 *     of syncing the raw version with the secure version.
-		 */
-		result = zone_load(zone->raw, flags, false);
-		if (result != ISC_R_SUCCESS) {
-			if (!locked) {
-				UNLOCK_ZONE(zone);
-			}
-			return (result);
-		}
-		LOCK_ZONE(zone->raw);
+	if (dns_zone_isdynamic(zone, true) || zone->kasp != NULL ||
+	    zone->rpzs != NULL || zone->catzs != NULL ||
+	    DNS_ZONEKEY_OPTION(zone, DNS_ZONEKEY_MAINTAIN) ||
+	    DNS_ZONE_OPTION(zone, DNS_ZONEOPT_IXFRFROMDIFFS))
+	{
+		return (false);
 	}
 
-	TIME_NOW(&now);
+	return (zone->journal == NULL || !isc_file_exists(zone->journal));
+}
 
-	INSIST(zone->type != dns_zone_none);
+/*
+ * Whether the database of 'zone' can be shared with the identical zones
+ * of other views.
+ */
+static bool
+zone_canshare(dns_zone_t *zone) {
+	return (DNS_ZONE_OPTION(zone, DNS_ZONEOPT_SHAREDATA) &&
+		zone->zmgr != NULL && zone_isstatic(zone));
+}
 
-	if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADING)) {
-		if ((flags & DNS_ZONELOADFLAG_THAW) != 0) {
-			DNS_ZONE_SETFLAG(zone, DNS_ZONEFLG_THAW);
-		}
-		result = DNS_R_CONTINUE;
-		goto cleanup;
+/*
+ * Write the key of the shared database of 'zone' to 'key': everything
+ * that the contents of the database loaded for the zone depend on.
+ * Returns its length, or 0 if it does not fit.
+ */
+static size_t
+zone_sharekey(dns_zone_t *zone, char *key, size_t size) {
+	char namebuf[DNS_NAME_FORMATSIZE];
+	int n;
+
+	dns_name_format(&zone->origin, namebuf, sizeof(namebuf));
+	n = snprintf(key, size, "%s/%u/%u/%x/%u/%s/%s", zone->db_argv[0],
+		     zone->rdclass, zone->masterformat,
+		     get_primary_options(zone), zone->maxttl, namebuf,
+		     zone->masterfile);
+	if (n < 0 || (size_t)n >= size) {
+		return (0);
 	}
+	return ((size_t)n);
+}
 
-	INSIST(zone->db_argc >= 1);
+/*
+ * Remove 'shared' from 'zmgr', moving the zones waiting for it to
+ * 'waiting'.
+ *
+ * Requires zmgr->sharelock to be held.
+ */
+static void
+zonemgr_deleteshared(dns_zonemgr_t *zmgr, dns_shareddb_t *shared,
+		     dns_zonelist_t *waiting) {
+	isc_result_t result;
 
-	rbt = strcmp(zone->db_argv[0], "rbt") == 0;
+	result = isc_ht_delete(zmgr->shareddbs, (unsigned char *)shared->key,
+			       shared->keylen);
+	INSIST(result == ISC_R_SUCCESS);
 
-	if (zone->db != NULL && zone->masterfile == NULL && rbt) {
-		/*
-		 * The zone has no master file configured.
-		 */
-		result = ISC_R_SUCCESS;
-		goto cleanup;
+	if (shared->zone != NULL) {
+		INSIST(shared->zone->shareddb == shared);
+		shared->zone->shareddb = NULL;
+	}
+	if (shared->db != NULL) {
+		dns_db_detach(&shared->db);
 	}
+	ISC_LIST_APPENDLIST(*waiting, shared->waiting, sharelink);
+	isc_mem_free(zmgr->mctx, shared->key);
+	isc_mem_put(zmgr->mctx, shared, sizeof(*shared));
+}
 
-	is_dynamic = dns_zone_isdynamic(zone, false);
-	if (zone->db != NULL && is_dynamic) {
-		/*
-		 * This is a secondary, stub, or dynamically updated zone
-		 * being reloaded.  Do nothing - the database we already
+static void
+zone_sharedload(void *arg);
+
+/*
+ * Hand 'db' (or NULL, if the zones have to load their own database)
+ * to the zones in 'waiting'.
+ */
+static void
+zone_wakeshared(dns_zonelist_t *waiting, dns_db_t *db, isc_time_t loadtime) {
+	dns_zone_t *zone = NULL;
+
+	while ((zone = ISC_LIST_HEAD(*waiting)) != NULL) {
+		dns_sharedload_t *sl = NULL;
+
+		ISC_LIST_UNLINK(*waiting, zone, sharelink);
+
+		sl = isc_mem_get(zone->mctx, sizeof(*sl));
+		*sl = (dns_sharedload_t){ .zone = zone, .loadtime = loadtime };
+		if (db != NULL) {
+			dns_db_attach(db, &sl->db);
+		}
+		isc_async_run(zone->loop, zone_sharedload, sl);
+	}
+}
+
+/*
+ * Look for a database for 'zone' among those of the identical zones of
+ * other views.  If one is found that is at least as recent as the zone
+ * file, it is attached to '*dbp', and '*loadtimep' is set to the time
+ * it was loaded.  If another zone is loading it, 'zone' waits for it:
+ * zone_sharedload() will finish the load of 'zone'.  Otherwise 'zone'
+ * has to load it, for itself and the zones that will share it.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS		'*dbp' is shared with other zones
+ *\li	#DNS_R_CONTINUE		'zone' waits for another zone
+ *\li	#ISC_R_NOTFOUND		'zone' has to load it itself
+ */
+static isc_result_t
+zone_getshared(dns_zone_t *zone, dns_db_t **dbp, isc_time_t *loadtimep) {
+	dns_zonemgr_t *zmgr = zone->zmgr;
+	dns_shareddb_t *shared = NULL;
+	dns_zone_t *waiter = NULL;
+	dns_zonelist_t waiting;
+	isc_time_t filetime;
+	isc_result_t result;
+	char key[PATH_MAX + DNS_NAME_FORMATSIZE + 64];
+	size_t keylen;
+
+	REQUIRE(LOCKED_ZONE(zone));
+	REQUIRE(dbp != NULL && *dbp == NULL);
+
+	ISC_LIST_INIT(waiting);
+
+	keylen = zone_sharekey(zone, key, sizeof(key));
+	if (keylen == 0 ||
+	    isc_file_getmodtime(zone->masterfile, &filetime) != ISC_R_SUCCESS)
+	{
+		return (ISC_R_NOTFOUND);
+	}
+
+	LOCK(&zmgr->sharelock);
+	result = isc_ht_find(zmgr->shareddbs, (unsigned char *)key, keylen,
+			     (void **)&shared);
+	if (zone->shareddb != NULL && zone->shareddb != shared) {
+		/*
+		 * The zone file or settings of the zone changed: it no
+		 * longer loads the database it used to.
+		 */
+		zonemgr_deleteshared(zmgr, zone->shareddb, &waiting);
+	}
+
+	if (result != ISC_R_SUCCESS) {
+		shared = isc_mem_get(zmgr->mctx, sizeof(*shared));
+		*shared = (dns_shareddb_t){
+			.key = isc_mem_strdup(zmgr->mctx, key),
+			.keylen = keylen,
+			.zone = zone,
+		};
+		ISC_LIST_INIT(shared->waiting);
+		result = isc_ht_add(zmgr->shareddbs, (unsigned char *)key,
+				    keylen, shared);
+		INSIST(result == ISC_R_SUCCESS);
+		zone->shareddb = shared;
+		result = ISC_R_NOTFOUND;
+	} else if (shared->db == NULL) {
+		INSIST(shared->zone != zone);
+		zone_iattach(zone, &waiter);
+		ISC_LIST_APPEND(shared->waiting, waiter, sharelink);
+		result = DNS_R_CONTINUE;
+	} else if (isc_time_compare(&shared->loadtime, &filetime) >= 0) {
+		dns_db_attach(shared->db, dbp);
+		*loadtimep = shared->loadtime;
+		result = ISC_R_SUCCESS;
+	} else {
+		/*
+		 * The zone file changed since it was loaded: load it
+		 * again, for the zones which will reload it as well.
+		 */
+		if (shared->zone != zone) {
+			shared->zone->shareddb = NULL;
+			shared->zone = zone;
+			zone->shareddb = shared;
+		}
+		dns_db_detach(&shared->db);
+		result = ISC_R_NOTFOUND;
+	}
+	UNLOCK(&zmgr->sharelock);
+
+	zone_wakeshared(&waiting, NULL, *loadtimep);
+
+	return (result);
+}
+
+/*
+ * 'zone' has loaded 'db', from the zone file if 'fromshared' is false:
+ * if it did so for the zones sharing it, hand it to the zones waiting
+ * for it, and record whether the database of the zone is shared.
+ */
+static void
+zone_sharedone(dns_zone_t *zone, dns_db_t *db, isc_time_t loadtime,
+	       bool fromshared) {
+	dns_zonemgr_t *zmgr = zone->zmgr;
+	dns_shareddb_t *shared = NULL;
+	dns_zonelist_t waiting;
+	bool loaded, registered = false;
+
+	REQUIRE(LOCKED_ZONE(zone));
+
+	ISC_LIST_INIT(waiting);
+
+	ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_read);
+	loaded = (db != NULL && zone->db == db);
+	ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_read);
+
+	if (zmgr != NULL) {
+		LOCK(&zmgr->sharelock);
+		shared = zone->shareddb;
+		if (shared != NULL && shared->db == NULL) {
+			/*
+			 * The modification time of the zone file does not
+			 * tell whether a zone with include files changed.
+			 */
+			if (loaded && ISC_LIST_EMPTY(zone->includes)) {
+				dns_db_attach(db, &shared->db);
+				shared->loadtime = loadtime;
+				ISC_LIST_APPENDLIST(waiting, shared->waiting,
+						    sharelink);
+				registered = true;
+			} else {
+				zonemgr_deleteshared(zmgr, shared, &waiting);
+			}
+		} else if (!fromshared && shared != NULL) {
+			zonemgr_deleteshared(zmgr, shared, &waiting);
+		}
+		UNLOCK(&zmgr->sharelock);
+	}
+
+	zone_wakeshared(&waiting, registered ? db : NULL, loadtime);
+
+	if (loaded) {
+		zone->dbshared = fromshared || registered;
+	}
+}
+
+/*
+ * Finish the load of a zone that waited for another zone to load the
+ * database it shares.
+ */
+static void
+zone_sharedload(void *arg) {
+	dns_sharedload_t *sl = arg;
+	dns_zone_t *zone = sl->zone;
+
+	LOCK_ZONE(zone);
+	INSIST(DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADING));
+	if (sl->db != NULL && zone->zmgr != NULL) {
+		dns_zone_logc(zone, DNS_LOGCATEGORY_ZONELOAD, ISC_LOG_DEBUG(1),
+			      "sharing the database of an identical zone");
+		(void)zone_postload(zone, sl->db, sl->loadtime, ISC_R_SUCCESS);
+		zone_sharedone(zone, sl->db, sl->loadtime, true);
+	}
+	if (zone->loadzmgr != NULL) {
+		zonemgr_putload(&zone->loadzmgr, 0);
+	}
+	DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_LOADING);
+	if (sl->db != NULL && DNS_ZONE_FLAG(zone, DNS_ZONEFLG_THAW)) {
+		zone->update_disabled = false;
+	}
+	DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_THAW);
+
+	/*
+	 * If the zone loading the database failed to, load it again.
+	 */
+	if (sl->db == NULL && zone->zmgr != NULL &&
+	    !DNS_ZONE_FLAG(zone, DNS_ZONEFLG_EXITING))
+	{
+		(void)zone_load(zone, 0, true);
+	}
+	UNLOCK_ZONE(zone);
+
+	if (sl->db != NULL) {
+		dns_db_detach(&sl->db);
+	}
+	isc_mem_put(zone->mctx, sl, sizeof(*sl));
+	dns_zone_idetach(&zone);
+}
+
+/*
+ * 'zone' shares its database but can no longer do so, having been
+ * made dynamic, for instance: drop the database, so that the zone
+ * loads one of its own.
+ */
+static void
+zone_unshare(dns_zone_t *zone) {
+	dns_zonelist_t waiting;
+	isc_time_t loadtime;
+
+	REQUIRE(LOCKED_ZONE(zone));
+
+	ISC_LIST_INIT(waiting);
+
+	if (zone->zmgr != NULL) {
+		LOCK(&zone->zmgr->sharelock);
+		if (zone->shareddb != NULL) {
+			zonemgr_deleteshared(zone->zmgr, zone->shareddb,
+					     &waiting);
+		}
+		UNLOCK(&zone->zmgr->sharelock);
+	}
+	isc_time_settoepoch(&loadtime);
+	zone_wakeshared(&waiting, NULL, loadtime);
+
+	dns_zone_logc(zone, DNS_LOGCATEGORY_ZONELOAD, ISC_LOG_INFO,
+		      "no longer sharing the zone database");
+
+	ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_write);
+	if (zone->db != NULL) {
+		zone_detachdb(zone);
+	}
+	ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_write);
+
+	zone->dbshared = false;
+	isc_time_settoepoch(&zone->loadtime);
+	DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_LOADED);
+}
+
+/*
+ * Note: when dealing with inline-signed zones, external callers will always
+ * call zone_load() for the secure zone; zone_load() calls itself recursively
+ * in order to load the raw zone.
+ */
+static isc_result_t
+zone_load(dns_zone_t *zone, unsigned int flags, bool locked) {
+	isc_result_t result;
+	isc_time_t now;
+	isc_time_t loadtime;
+	dns_db_t *db = NULL;
+	bool rbt, hasraw, is_dynamic, shared = false, sharing = false;
+	bool inplace = false;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	if (!locked) {
+		LOCK_ZONE(zone);
+	}
+
+	INSIST(zone != zone->raw);
+	hasraw = inline_secure(zone);
+	if (hasraw) {
+		/*
+		 * We are trying to load an inline-signed zone.  First call
+		 * self recursively to try loading the raw version of the zone.
+		 * Assuming the raw zone file is readable, there are two
+		 * possibilities:
+		 *
+		 *  a) the raw zone was not yet loaded and thus it will be
+		 *     loaded now, synchronously; if this succeeds, a
+		 *     subsequent attempt to load the signed zone file will
+		 *     take place and thus zone_postload() will be called
+		 *     twice: first for the raw zone and then for the secure
+		 *     zone; the latter call will take care of syncing the raw
+		 *     version with the secure version,
+		 *
+		 *  b) the raw zone was already loaded and we are trying to
+		 *     reload it, which will happen asynchronously; this means
+		 *     zone_postload() will only be called for the raw zone
+		 *     because "result" returned by the zone_load() call below
+		 *     will not be ISC_R_SUCCESS but rather DNS_R_CONTINUE;
+		 *     zone_postload() called for the raw zone will take care
+		 *     of syncing the raw version with the secure version.
+		 */
+		result = zone_load(zone->raw, flags, false);
+		if (result != ISC_R_SUCCESS) {
+			if (!locked) {
+				UNLOCK_ZONE(zone);
+			}
+			return (result);
+		}
+		LOCK_ZONE(zone->raw);
+	}
+
+	TIME_NOW(&now);
+
+	INSIST(zone->type != dns_zone_none);
+
+	if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADING)) {
+		if ((flags & DNS_ZONELOADFLAG_THAW) != 0) {
+			DNS_ZONE_SETFLAG(zone, DNS_ZONEFLG_THAW);
+		}
+		result = DNS_R_CONTINUE;
+		goto cleanup;
+	}
+
+	INSIST(zone->db_argc >= 1);
+
+	if (zone->dbshared && !zone_canshare(zone)) {
+		zone_unshare(zone);
+	}
+
+	rbt = strcmp(zone->db_argv[0], "rbt") == 0 ||
+	      strcmp(zone->db_argv[0], "qp") == 0;
+
+	if (zone->db != NULL && zone->masterfile == NULL && rbt) {
+		/*
+		 * The zone has no master file configured.
+		 */
+		result = ISC_R_SUCCESS;
+		goto cleanup;
+	}
+
+	is_dynamic = dns_zone_isdynamic(zone, false);
+	if (zone->db != NULL && is_dynamic) {
+		/*
+		 * This is a secondary, stub, or dynamically updated zone
+		 * being reloaded.  Do nothing - the database we already
 		 * have is guaranteed to be up-to-date.
 		 */
 		if (zone->type == dns_zone_primary && !hasraw) {
@@ -2191,6 +2992,7 @@ zone_load(dns_zone_t *zone, unsigned int flags, bool locked) {
 	 * the next time dns_zone_load is called.
 	 */
 	TIME_NOW(&loadtime);
+	zone->loadstart = loadtime;
 
 	/*
 	 * Don't do the load if the file that stores the zone is older
@@ -2329,9 +3131,41 @@ zone_load(dns_zone_t *zone, unsigned int flags, bool locked) {
 		}
 	}
 
+	if (zone_canshare(zone)) {
+		result = zone_getshared(zone, &db, &loadtime);
+		if (result == ISC_R_SUCCESS) {
+			dns_zone_logc(zone, DNS_LOGCATEGORY_ZONELOAD,
+				      ISC_LOG_DEBUG(1),
+				      "sharing the database of an identical "
+				      "zone");
+			shared = true;
+			goto loaded;
+		} else if (result == DNS_R_CONTINUE) {
+			goto loaded;
+		}
+		sharing = true;
+	}
+
 	dns_zone_logc(zone, DNS_LOGCATEGORY_ZONELOAD, ISC_LOG_DEBUG(1),
 		      "starting load");
 
+	/*
+	 * A database that is about to be shared must be built from
+	 * scratch; otherwise a reload may be applied to a new version
+	 * of the current database.
+	 */
+	if (!sharing && zone_caninplace(zone)) {
+		ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_read);
+		if (zone->db != NULL) {
+			dns_db_attach(zone->db, &db);
+			inplace = true;
+		}
+		ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_read);
+	}
+	if (inplace) {
+		goto startload;
+	}
+
 	result = dns_db_create(zone->mctx, zone->db_argv[0], &zone->origin,
 			       (zone->type == dns_zone_stub) ? dns_dbtype_stub
 							     : dns_dbtype_zone,
@@ -2358,9 +3192,10 @@ zone_load(dns_zone_t *zone, unsigned int flags, bool locked) {
 		}
 	}
 
+startload:
 	if (!dns_db_ispersistent(db)) {
 		if (zone->masterfile != NULL || zone->stream != NULL) {
-			result = zone_startload(db, zone, loadtime);
+			result = zone_startload(db, zone, loadtime, inplace);
 		} else {
 			result = DNS_R_NOMASTERFILE;
 			if (zone->type == dns_zone_primary ||
@@ -2380,6 +3215,7 @@ zone_load(dns_zone_t *zone, unsigned int flags, bool locked) {
 		}
 	}
 
+loaded:
 	if (result == DNS_R_CONTINUE) {
 		DNS_ZONE_SETFLAG(zone, DNS_ZONEFLG_LOADING);
 		if ((flags & DNS_ZONELOADFLAG_THAW) != 0) {
@@ -2389,8 +3225,17 @@ zone_load(dns_zone_t *zone, unsigned int flags, bool locked) {
 	}
 
 	result = zone_postload(zone, db, loadtime, result);
+	zone_sharedone(zone, db, loadtime, shared);
+	sharing = false;
 
 cleanup:
+	if (sharing && result != DNS_R_CONTINUE) {
+		/*
+		 * The load of the database the zone was to share with
+		 * other zones failed early.
+		 */
+		zone_sharedone(zone, NULL, loadtime, false);
+	}
 	if (hasraw) {
 		UNLOCK_ZONE(zone->raw);
 	}
@@ -2408,6 +3253,22 @@ dns_zone_load(dns_zone_t *zone, bool newonly) {
 	return (zone_load(zone, newonly ? DNS_ZONELOADFLAG_NOSTAT : 0, false));
 }
 
+/*
+ * Free the load slot '*zmgrp' held by 'zone', whose load ended with
+ * 'result', accounting for the size of the zone file if it was read.
+ */
+static void
+zone_putload(dns_zone_t *zone, dns_zonemgr_t **zmgrp, isc_result_t result) {
+	off_t size = 0;
+
+	if (zone->masterfile != NULL &&
+	    (result == ISC_R_SUCCESS || result == DNS_R_SEENINCLUDE))
+	{
+		(void)isc_file_getsize(zone->masterfile, &size);
+	}
+	zonemgr_putload(zmgrp, (uint64_t)size);
+}
+
 static void
 zone_asyncload(isc_task_t *task, isc_event_t *event) {
 	dns_asyncload_t *asl = event->ev_arg;
@@ -2425,6 +3286,30 @@ zone_asyncload(isc_task_t *task, isc_event_t *event) {
 	if (result != DNS_R_CONTINUE) {
 		DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_LOADPENDING);
 	}
+
+	/*
+	 * The load slot is held until the zone file has been read, by
+	 * the zone (or the raw zone of an inline-signed zone) that is
+	 * still loading.
+	 */
+	if (result == DNS_R_CONTINUE && zone->loadzmgr == NULL &&
+	    DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADING))
+	{
+		zone->loadzmgr = asl->zmgr;
+		asl->zmgr = NULL;
+	} else if (result == DNS_R_CONTINUE && inline_secure(zone)) {
+		LOCK_ZONE(zone->raw);
+		if (zone->raw->loadzmgr == NULL &&
+		    DNS_ZONE_FLAG(zone->raw, DNS_ZONEFLG_LOADING))
+		{
+			zone->raw->loadzmgr = asl->zmgr;
+			asl->zmgr = NULL;
+		}
+		UNLOCK_ZONE(zone->raw);
+	}
+	if (asl->zmgr != NULL) {
+		zone_putload(zone, &asl->zmgr, result);
+	}
 	UNLOCK_ZONE(zone);
 
 	/* Inform the zone table we've finished loading */
@@ -2439,7 +3324,6 @@ zone_asyncload(isc_task_t *task, isc_event_t *event) {
 isc_result_t
 dns_zone_asyncload(dns_zone_t *zone, bool newonly, dns_zt_zoneloaded_t done,
 		   void *arg) {
-	isc_event_t *e;
 	dns_asyncload_t *asl = NULL;
 
 	REQUIRE(DNS_ZONE_VALID(zone));
@@ -2456,18 +3340,24 @@ dns_zone_asyncload(dns_zone_t *zone, bool newonly, dns_zt_zoneloaded_t done,
 	}
 
 	asl = isc_mem_get(zone->mctx, sizeof(*asl));
+	*asl = (dns_asyncload_t){
+		.flags = newonly ? DNS_ZONELOADFLAG_NOSTAT : 0,
+		.priority = ZONELOAD_OTHER,
+		.loaded = done,
+		.loaded_arg = arg,
+	};
+	ISC_LINK_INIT(asl, link);
 
-	asl->zone = NULL;
-	asl->flags = newonly ? DNS_ZONELOADFLAG_NOSTAT : 0;
-	asl->loaded = done;
-	asl->loaded_arg = arg;
-
-	e = isc_event_allocate(zone->zmgr->mctx, zone->zmgr, DNS_EVENT_ZONELOAD,
-			       zone_asyncload, asl, sizeof(isc_event_t));
+	if (zone->db != NULL) {
+		asl->priority = ZONELOAD_RELOAD;
+	} else if (zone->type == dns_zone_primary) {
+		asl->priority = ZONELOAD_PRIMARY;
+	}
 
 	zone_iattach(zone, &asl->zone);
+	dns_zonemgr_attach(zone->zmgr, &asl->zmgr);
 	DNS_ZONE_SETFLAG(zone, DNS_ZONEFLG_LOADPENDING);
-	isc_task_send(zone->loadtask, &e);
+	zonemgr_queueload(zone->zmgr, asl);
 	UNLOCK_ZONE(zone);
 
 	return (ISC_R_SUCCESS);
@@ -2669,6 +3559,16 @@ zone_gotwritehandle(isc_task_t *task, isc_event_t *event) {
 
 	LOCK_ZONE(zone);
 	INSIST(zone != zone->raw);
+	if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_NEEDDUMP)) {
+		/*
+		 * The zone changed again while this dump was queued.
+		 * The dump is of the current version, so it covers
+		 * those changes too: don't schedule another one.
+		 */
+		DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_NEEDDUMP);
+		isc_time_settoepoch(&zone->dumptime);
+		zonemgr_dumpdone(zone->zmgr, 0, true);
+	}
 	ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_read);
 	if (zone->db != NULL) {
 		dns_db_attach(zone->db, &db);
@@ -2736,16 +3636,412 @@ dns_zone_setrawdata(dns_zone_t *zone, dns_masterrawheader_t *header) {
 	UNLOCK_ZONE(zone);
 }
 
-static isc_result_t
-zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime) {
-	dns_load_t *load;
-	isc_result_t result;
-	isc_result_t tresult;
-	unsigned int options;
-
-	ENTER;
-
-	dns_zone_rpz_enable_db(zone, db);
+/*
+ * Reloading a zone in place: rather than loading a complete new
+ * database next to the one in use, the zone file is loaded into a new
+ * version of the current database.  An RRset of the file equal to the
+ * one in the database is left alone, a different one replaces it, and
+ * the RRsets that are no longer in the file are deleted from the new
+ * version at the end.  The version is only committed once the zone
+ * passed its post-load checks (see zone_checkversion()); the data of
+ * the old version is then freed as its readers go away.
+ */
+struct dns_inplace {
+	isc_mem_t *mctx;
+	dns_db_t *db;
+	dns_dbversion_t *oldversion; /* Current when the load started */
+	dns_dbversion_t *version;    /* Being loaded */
+	isc_ht_t *seen;		     /* RRsets of the zone file */
+	uint32_t oldserial;
+	uint64_t unchanged;
+	uint64_t changed;
+	uint64_t deleted;
+};
+
+/*
+ * Whether a reload of 'zone' can load the zone file into a new version
+ * of its database (see "reload-in-place").
+ */
+static bool
+zone_caninplace(dns_zone_t *zone) {
+	bool loaded;
+
+	if (!DNS_ZONE_OPTION(zone, DNS_ZONEOPT_RELOADINPLACE) ||
+	    zone->zmgr == NULL || zone->loadtask == NULL || zone->dbshared ||
+	    !DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADED) || !zone_isstatic(zone))
+	{
+		return (false);
+	}
+
+	ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_read);
+	loaded = (zone->db != NULL);
+	ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_read);
+
+	return (loaded);
+}
+
+/*
+ * Write the key of the RRset 'type'/'covers' at 'name' in the table of
+ * the RRsets seen to 'key', and return its length.
+ */
+static size_t
+inplace_key(const dns_name_t *name, dns_rdatatype_t type,
+	    dns_rdatatype_t covers, unsigned char *key) {
+	size_t i;
+
+	for (i = 0; i < name->length; i++) {
+		key[i] = isc_ascii_tolower(name->ndata[i]);
+	}
+	key[i++] = type >> 8;
+	key[i++] = type & 0xff;
+	key[i++] = covers >> 8;
+	key[i++] = covers & 0xff;
+
+	return (i);
+}
+
+/*
+ * Whether the RRsets 'a' and 'b' have the same TTL and records.  The
+ * records are compared in order first, which finds the RRsets equal
+ * when the zone file was written from a database; small RRsets are
+ * then compared in any order.  A large RRset listed in another order
+ * is taken to be different, which only costs replacing it.
+ */
+static bool
+inplace_equal(dns_rdataset_t *a, dns_rdataset_t *b) {
+	isc_result_t result, tresult;
+	unsigned int count;
+
+	if (a->ttl != b->ttl) {
+		return (false);
+	}
+	count = dns_rdataset_count(a);
+	if (count != dns_rdataset_count(b)) {
+		return (false);
+	}
+
+	for (result = dns_rdataset_first(a), tresult = dns_rdataset_first(b);
+	     result == ISC_R_SUCCESS && tresult == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(a), tresult = dns_rdataset_next(b))
+	{
+		dns_rdata_t ra = DNS_RDATA_INIT, rb = DNS_RDATA_INIT;
+
+		dns_rdataset_current(a, &ra);
+		dns_rdataset_current(b, &rb);
+		if (dns_rdata_compare(&ra, &rb) != 0) {
+			break;
+		}
+	}
+	if (result == ISC_R_NOMORE) {
+		return (true);
+	}
+	if (count > 64) {
+		return (false);
+	}
+
+	for (result = dns_rdataset_first(b); result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(b))
+	{
+		dns_rdata_t rb = DNS_RDATA_INIT;
+		bool found = false;
+
+		dns_rdataset_current(b, &rb);
+		for (tresult = dns_rdataset_first(a);
+		     tresult == ISC_R_SUCCESS && !found;
+		     tresult = dns_rdataset_next(a))
+		{
+			dns_rdata_t ra = DNS_RDATA_INIT;
+
+			dns_rdataset_current(a, &ra);
+			found = (dns_rdata_compare(&ra, &rb) == 0);
+		}
+		if (!found) {
+			return (false);
+		}
+	}
+
+	return (true);
+}
+
+/*
+ * The dns_addrdatasetfunc_t of a reload in place.
+ */
+static isc_result_t
+inplace_addrdataset(void *arg, const dns_name_t *name,
+		    dns_rdataset_t *rdataset) {
+	dns_inplace_t *inplace = arg;
+	dns_db_t *db = inplace->db;
+	dns_dbnode_t *node = NULL;
+	unsigned char key[DNS_NAME_MAXWIRE + 4];
+	unsigned int options = 0;
+	size_t keylen;
+	isc_result_t result;
+
+	/*
+	 * The checks made by the database when loading a new one.
+	 */
+	if (rdataset->type == dns_rdatatype_soa &&
+	    !dns_name_equal(name, dns_db_origin(db)))
+	{
+		return (DNS_R_NOTZONETOP);
+	}
+	if (dns_name_iswildcard(name)) {
+		if (rdataset->type == dns_rdatatype_ns) {
+			return (DNS_R_INVALIDNS);
+		}
+		if (rdataset->type == dns_rdatatype_nsec3) {
+			return (DNS_R_INVALIDNSEC3);
+		}
+	}
+
+	if (rdataset->type == dns_rdatatype_nsec3 ||
+	    rdataset->covers == dns_rdatatype_nsec3)
+	{
+		result = dns_db_findnsec3node(db, name, true, &node);
+	} else {
+		result = dns_db_findnode(db, name, true, &node);
+	}
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	keylen = inplace_key(name, rdataset->type, rdataset->covers, key);
+	if (isc_ht_find(inplace->seen, key, keylen, NULL) == ISC_R_SUCCESS) {
+		/*
+		 * More records of an RRset met earlier in the file.
+		 */
+		options = DNS_DBADD_MERGE;
+	} else {
+		dns_rdataset_t old;
+		bool equal = false;
+
+		result = isc_ht_add(inplace->seen, key, keylen, NULL);
+		INSIST(result == ISC_R_SUCCESS);
+
+		dns_rdataset_init(&old);
+		result = dns_db_findrdataset(db, node, inplace->oldversion,
+					     rdataset->type, rdataset->covers,
+					     0, &old, NULL);
+		if (result == ISC_R_SUCCESS) {
+			equal = inplace_equal(&old, rdataset);
+			dns_rdataset_disassociate(&old);
+		}
+		if (equal) {
+			inplace->unchanged++;
+			result = ISC_R_SUCCESS;
+			goto done;
+		}
+		inplace->changed++;
+	}
+
+	result = dns_db_addrdataset(db, node, inplace->version, 0, rdataset,
+				    options, NULL);
+	if (result == DNS_R_UNCHANGED) {
+		result = ISC_R_SUCCESS;
+	}
+
+done:
+	dns_db_detachnode(db, &node);
+	return (result);
+}
+
+/*
+ * Free 'inplacep', rolling the version it loaded back unless it was
+ * committed.
+ */
+static void
+inplace_destroy(dns_inplace_t **inplacep) {
+	dns_inplace_t *inplace = NULL;
+
+	REQUIRE(inplacep != NULL && *inplacep != NULL);
+
+	inplace = *inplacep;
+	*inplacep = NULL;
+
+	if (inplace->version != NULL) {
+		dns_db_closeversion(inplace->db, &inplace->version, false);
+	}
+	dns_db_closeversion(inplace->db, &inplace->oldversion, false);
+	isc_ht_destroy(&inplace->seen);
+	dns_db_detach(&inplace->db);
+	isc_mem_putanddetach(&inplace->mctx, inplace, sizeof(*inplace));
+}
+
+/*
+ * Start loading the zone file of 'zone' into a new version of 'db',
+ * its database, and set up 'callbacks' for it.
+ */
+static isc_result_t
+inplace_begin(dns_zone_t *zone, dns_db_t *db, dns_rdatacallbacks_t *callbacks,
+	      dns_inplace_t **inplacep) {
+	dns_inplace_t *inplace = NULL;
+	isc_result_t result;
+
+	REQUIRE(inplacep != NULL && *inplacep == NULL);
+
+	inplace = isc_mem_get(zone->mctx, sizeof(*inplace));
+	*inplace = (dns_inplace_t){ .mctx = NULL };
+	isc_mem_attach(zone->mctx, &inplace->mctx);
+	dns_db_attach(db, &inplace->db);
+	isc_ht_init(&inplace->seen, inplace->mctx, 16, ISC_HT_CASE_SENSITIVE);
+	dns_db_currentversion(db, &inplace->oldversion);
+
+	result = dns_db_getsoaserial(db, inplace->oldversion,
+				     &inplace->oldserial);
+	if (result != ISC_R_SUCCESS) {
+		inplace_destroy(&inplace);
+		return (result);
+	}
+	result = dns_db_newversion(db, &inplace->version);
+	if (result != ISC_R_SUCCESS) {
+		inplace_destroy(&inplace);
+		return (result);
+	}
+
+	callbacks->add = inplace_addrdataset;
+	callbacks->add_private = inplace;
+
+	*inplacep = inplace;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * The zone file has been loaded into 'inplace': delete the RRsets
+ * that were not in it from the new version.
+ */
+static isc_result_t
+inplace_end(dns_zone_t *zone, dns_inplace_t *inplace) {
+	dns_db_t *db = inplace->db;
+	dns_dbiterator_t *dbiterator = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	isc_result_t result;
+
+	result = dns_db_createiterator(db, 0, &dbiterator);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	for (result = dns_dbiterator_first(dbiterator);
+	     result == ISC_R_SUCCESS; result = dns_dbiterator_next(dbiterator))
+	{
+		dns_dbnode_t *node = NULL;
+
+		result = dns_dbiterator_current(dbiterator, &node, name);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+		result = dns_dbiterator_pause(dbiterator);
+		if (result != ISC_R_SUCCESS) {
+			dns_db_detachnode(db, &node);
+			break;
+		}
+
+		/*
+		 * Delete the unseen RRsets one at a time, looking the
+		 * node over again after each.
+		 */
+		for (;;) {
+			dns_rdatasetiter_t *rdsiter = NULL;
+			dns_rdataset_t rdataset;
+			dns_rdatatype_t type = 0, covers = 0;
+			unsigned char key[DNS_NAME_MAXWIRE + 4];
+			bool found = false;
+
+			result = dns_db_allrdatasets(db, node, inplace->version,
+						     0, &rdsiter);
+			if (result != ISC_R_SUCCESS) {
+				break;
+			}
+			dns_rdataset_init(&rdataset);
+			for (result = dns_rdatasetiter_first(rdsiter);
+			     result == ISC_R_SUCCESS && !found;
+			     result = dns_rdatasetiter_next(rdsiter))
+			{
+				size_t keylen;
+
+				dns_rdatasetiter_current(rdsiter, &rdataset);
+				type = rdataset.type;
+				covers = rdataset.covers;
+				dns_rdataset_disassociate(&rdataset);
+				keylen = inplace_key(name, type, covers, key);
+				found = (isc_ht_find(inplace->seen, key,
+						     keylen,
+						     NULL) != ISC_R_SUCCESS);
+			}
+			dns_rdatasetiter_destroy(&rdsiter);
+			if (!found) {
+				result = ISC_R_SUCCESS;
+				break;
+			}
+
+			result = dns_db_deleterdataset(db, node,
+						       inplace->version, type,
+						       covers);
+			if (result == DNS_R_UNCHANGED) {
+				result = ISC_R_SUCCESS;
+			}
+			if (result != ISC_R_SUCCESS) {
+				break;
+			}
+			inplace->deleted++;
+		}
+		dns_db_detachnode(db, &node);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+	}
+	if (result == ISC_R_NOMORE) {
+		result = ISC_R_SUCCESS;
+	}
+	dns_dbiterator_destroy(&dbiterator);
+
+	if (result == ISC_R_SUCCESS) {
+		dns_zone_logc(zone, DNS_LOGCATEGORY_ZONELOAD, ISC_LOG_INFO,
+			      "reloading in place: %" PRIu64
+			      " RRsets changed, %" PRIu64
+			      " deleted, %" PRIu64 " unchanged",
+			      inplace->changed, inplace->deleted,
+			      inplace->unchanged);
+	}
+
+	return (result);
+}
+
+/*
+ * Make the version loaded by 'inplace' the current version of the
+ * database.
+ */
+static void
+inplace_commit(dns_inplace_t *inplace) {
+	dns_db_closeversion(inplace->db, &inplace->version, true);
+}
+
+/*
+ * Attach '*versionp' to the version of 'db' that the checks of a zone
+ * being loaded look at: the version loaded by a reload in place of the
+ * zone, which is not yet current, or else the current version.
+ */
+static void
+zone_checkversion(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t **versionp) {
+	if (zone->inplace != NULL && zone->inplace->db == db) {
+		dns_db_attachversion(db, zone->inplace->version, versionp);
+	} else {
+		dns_db_currentversion(db, versionp);
+	}
+}
+
+static isc_result_t
+zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime,
+	       bool inplace) {
+	dns_load_t *load;
+	isc_result_t result;
+	isc_result_t tresult;
+	unsigned int options;
+
+	ENTER;
+
+	dns_zone_rpz_enable_db(zone, db);
 	dns_zone_catz_enable_db(zone, db);
 
 	options = get_primary_options(zone);
@@ -2759,6 +4055,7 @@ zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime) {
 		load->mctx = NULL;
 		load->zone = NULL;
 		load->db = NULL;
+		load->inplace = NULL;
 		load->loadtime = loadtime;
 		load->magic = LOAD_MAGIC;
 
@@ -2768,7 +4065,12 @@ zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime) {
 		dns_rdatacallbacks_init(&load->callbacks);
 		load->callbacks.rawdata = zone_setrawdata;
 		zone_iattach(zone, &load->callbacks.zone);
-		result = dns_db_beginload(db, &load->callbacks);
+		if (inplace) {
+			result = inplace_begin(zone, db, &load->callbacks,
+					       &load->inplace);
+		} else {
+			result = dns_db_beginload(db, &load->callbacks);
+		}
 		if (result != ISC_R_SUCCESS) {
 			goto cleanup;
 		}
@@ -2779,7 +4081,10 @@ zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime) {
 			 * We can't report multiple errors so ignore
 			 * the result of dns_db_endload().
 			 */
-			(void)dns_db_endload(load->db, &load->callbacks);
+			if (load->inplace == NULL) {
+				(void)dns_db_endload(load->db,
+						     &load->callbacks);
+			}
 			goto cleanup;
 		} else {
 			result = DNS_R_CONTINUE;
@@ -2787,6 +4092,12 @@ zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime) {
 	} else {
 		dns_rdatacallbacks_t callbacks;
 
+		INSIST(!inplace);
+
+		if (zone->loadthreads > 1) {
+			options |= DNS_MASTER_PARALLEL;
+		}
+
 		dns_rdatacallbacks_init(&callbacks);
 		callbacks.rawdata = zone_setrawdata;
 		zone_iattach(zone, &callbacks.zone);
@@ -2810,23 +4121,226 @@ zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime) {
 				zone->masterformat, zone->maxttl);
 		}
 
-		tresult = dns_db_endload(db, &callbacks);
-		if (result == ISC_R_SUCCESS) {
-			result = tresult;
+		tresult = dns_db_endload(db, &callbacks);
+		if (result == ISC_R_SUCCESS) {
+			result = tresult;
+		}
+		zone_idetach(&callbacks.zone);
+	}
+
+	return (result);
+
+cleanup:
+	load->magic = 0;
+	if (load->inplace != NULL) {
+		inplace_destroy(&load->inplace);
+	}
+	dns_db_detach(&load->db);
+	zone_idetach(&load->zone);
+	zone_idetach(&load->callbacks.zone);
+	isc_mem_detach(&load->mctx);
+	isc_mem_put(zone->mctx, load, sizeof(*load));
+	return (result);
+}
+
+/*%
+ * While the checks of a zone's names run on worker threads (see
+ * dns_zone_setloadthreads()), what each of them logs is kept with the
+ * name being checked, and written out in zone order afterwards.
+ */
+typedef struct zone_logmsg zone_logmsg_t;
+struct zone_logmsg {
+	isc_logcategory_t *category;
+	int level;
+	char *text;
+	ISC_LINK(zone_logmsg_t) link;
+};
+typedef ISC_LIST(zone_logmsg_t) zone_loglist_t;
+
+static thread_local zone_loglist_t *zone_logcapture = NULL;
+
+static void
+zone_logcapture_add(dns_zone_t *zone, isc_logcategory_t *category, int level,
+		    const char *prefix, const char *zstr, const char *message) {
+	zone_logmsg_t *msg = isc_mem_get(zone->mctx, sizeof(*msg));
+	char text[8192];
+
+	snprintf(text, sizeof(text), "%s%s%s%s: %s",
+		 (prefix != NULL ? prefix : ""), (prefix != NULL ? ": " : ""),
+		 zstr, zone->strnamerd, message);
+
+	*msg = (zone_logmsg_t){
+		.category = category,
+		.level = level,
+		.text = isc_mem_strdup(zone->mctx, text),
+	};
+	ISC_LINK_INIT(msg, link);
+	ISC_LIST_APPEND(*zone_logcapture, msg, link);
+}
+
+static void
+zone_logcapture_flush(dns_zone_t *zone, zone_loglist_t *log) {
+	zone_logmsg_t *msg = NULL;
+
+	while ((msg = ISC_LIST_HEAD(*log)) != NULL) {
+		ISC_LIST_UNLINK(*log, msg, link);
+		isc_log_write(dns_lctx, msg->category, DNS_LOGMODULE_ZONE,
+			      msg->level, "%s", msg->text);
+		isc_mem_free(zone->mctx, msg->text);
+		isc_mem_put(zone->mctx, msg, sizeof(*msg));
+	}
+}
+
+/*%
+ * The per-name checks done after loading a zone are queued as the
+ * database is walked, and run in batches of up to ZONECHECK_BATCH
+ * names by up to 'zone->loadthreads' threads.  With a single thread,
+ * each name is checked as soon as it is queued.
+ */
+#define ZONECHECK_BATCH 4096
+
+typedef struct zonecheck_job {
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_dbnode_t *node;
+	dns_rdataset_t rdataset; /*%< optional, depends on the check */
+	bool ok;
+	zone_loglist_t log;
+} zonecheck_job_t;
+
+typedef bool (*zonecheck_func_t)(dns_zone_t *zone, dns_db_t *db,
+				 dns_dbversion_t *version,
+				 zonecheck_job_t *job);
+
+typedef struct zonecheck {
+	dns_zone_t *zone;
+	dns_db_t *db;
+	dns_dbversion_t *version;
+	zonecheck_func_t check;
+	unsigned int nthreads;
+	zonecheck_job_t *jobs;
+	size_t size;
+	size_t njobs;
+	atomic_size_t next;
+	bool ok;
+} zonecheck_t;
+
+static void
+zonecheck_init(zonecheck_t *zc, dns_zone_t *zone, dns_db_t *db,
+	       dns_dbversion_t *version, zonecheck_func_t check) {
+	*zc = (zonecheck_t){
+		.zone = zone,
+		.db = db,
+		.version = version,
+		.check = check,
+		.nthreads = ISC_MAX(zone->loadthreads, 1),
+		.size = 1,
+		.ok = true,
+	};
+	if (zc->nthreads > 1) {
+		zc->size = ZONECHECK_BATCH;
+	}
+	zc->jobs = isc_mem_get(zone->mctx, zc->size * sizeof(zc->jobs[0]));
+}
+
+static isc_threadresult_t
+zonecheck_worker(isc_threadarg_t arg) {
+	zonecheck_t *zc = arg;
+	size_t i;
+
+	while ((i = atomic_fetch_add_relaxed(&zc->next, 1)) < zc->njobs) {
+		zonecheck_job_t *job = &zc->jobs[i];
+
+		zone_logcapture = &job->log;
+		job->ok = (zc->check)(zc->zone, zc->db, zc->version, job);
+		zone_logcapture = NULL;
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+static void
+zonecheck_flush(zonecheck_t *zc) {
+	isc_thread_t *threads = NULL;
+	unsigned int nthreads;
+
+	if (zc->njobs == 0) {
+		return;
+	}
+
+	if (zc->nthreads <= 1) {
+		zonecheck_job_t *job = &zc->jobs[0];
+
+		INSIST(zc->njobs == 1);
+		job->ok = (zc->check)(zc->zone, zc->db, zc->version, job);
+	} else {
+		nthreads = ISC_MIN(zc->nthreads, zc->njobs);
+		atomic_init(&zc->next, 0);
+		if (nthreads > 1) {
+			threads = isc_mem_get(zc->zone->mctx,
+					      (nthreads - 1) *
+						      sizeof(threads[0]));
+			for (unsigned int i = 0; i < nthreads - 1; i++) {
+				isc_thread_create(zonecheck_worker, zc,
+						  &threads[i]);
+			}
+		}
+		(void)zonecheck_worker(zc);
+		if (threads != NULL) {
+			for (unsigned int i = 0; i < nthreads - 1; i++) {
+				isc_thread_join(threads[i], NULL);
+			}
+			isc_mem_put(zc->zone->mctx, threads,
+				    (nthreads - 1) * sizeof(threads[0]));
+		}
+	}
+
+	for (size_t i = 0; i < zc->njobs; i++) {
+		zonecheck_job_t *job = &zc->jobs[i];
+
+		zone_logcapture_flush(zc->zone, &job->log);
+		if (!job->ok) {
+			zc->ok = false;
 		}
-		zone_idetach(&callbacks.zone);
+		if (dns_rdataset_isassociated(&job->rdataset)) {
+			dns_rdataset_disassociate(&job->rdataset);
+		}
+		dns_db_detachnode(zc->db, &job->node);
 	}
+	zc->njobs = 0;
+}
 
-	return (result);
+/*%
+ * Queue the check of 'name' at 'node', passing it a clone of
+ * 'rdataset' if not NULL.  The caller's database iterator must be
+ * paused.
+ */
+static void
+zonecheck_add(zonecheck_t *zc, dns_dbnode_t *node, const dns_name_t *name,
+	      dns_rdataset_t *rdataset) {
+	zonecheck_job_t *job = &zc->jobs[zc->njobs++];
 
-cleanup:
-	load->magic = 0;
-	dns_db_detach(&load->db);
-	zone_idetach(&load->zone);
-	zone_idetach(&load->callbacks.zone);
-	isc_mem_detach(&load->mctx);
-	isc_mem_put(zone->mctx, load, sizeof(*load));
-	return (result);
+	job->name = dns_fixedname_initname(&job->fixed);
+	dns_name_copy(name, job->name);
+	job->node = NULL;
+	dns_db_attachnode(zc->db, node, &job->node);
+	dns_rdataset_init(&job->rdataset);
+	if (rdataset != NULL) {
+		dns_rdataset_clone(rdataset, &job->rdataset);
+	}
+	job->ok = true;
+	ISC_LIST_INIT(job->log);
+
+	if (zc->njobs == zc->size) {
+		zonecheck_flush(zc);
+	}
+}
+
+static bool
+zonecheck_finish(zonecheck_t *zc) {
+	zonecheck_flush(zc);
+	isc_mem_put(zc->zone->mctx, zc->jobs, zc->size * sizeof(zc->jobs[0]));
+	return (zc->ok);
 }
 
 static bool
@@ -3243,25 +4757,59 @@ zone_rrset_check_dup(dns_zone_t *zone, dns_name_t *owner,
 	return (answer);
 }
 
+/*%
+ * Check the RRsets at one name for zone_check_dup().
+ */
+static bool
+zone_check_dupname(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *version,
+		   zonecheck_job_t *job) {
+	dns_rdataset_t rdataset;
+	dns_rdatasetiter_t *rdsit = NULL;
+	bool ok = true;
+	isc_result_t result;
+
+	dns_rdataset_init(&rdataset);
+
+	result = dns_db_allrdatasets(db, job->node, version, 0, &rdsit);
+	if (result != ISC_R_SUCCESS) {
+		return (true);
+	}
+
+	for (result = dns_rdatasetiter_first(rdsit); result == ISC_R_SUCCESS;
+	     result = dns_rdatasetiter_next(rdsit))
+	{
+		dns_rdatasetiter_current(rdsit, &rdataset);
+		if (!zone_rrset_check_dup(zone, job->name, &rdataset)) {
+			ok = false;
+		}
+		dns_rdataset_disassociate(&rdataset);
+	}
+	dns_rdatasetiter_destroy(&rdsit);
+
+	return (ok);
+}
+
 static bool
 zone_check_dup(dns_zone_t *zone, dns_db_t *db) {
 	dns_dbiterator_t *dbiterator = NULL;
 	dns_dbnode_t *node = NULL;
+	dns_dbversion_t *version = NULL;
 	dns_fixedname_t fixed;
 	dns_name_t *name;
-	dns_rdataset_t rdataset;
-	dns_rdatasetiter_t *rdsit = NULL;
-	bool ok = true;
+	zonecheck_t zc;
 	isc_result_t result;
+	bool ok;
 
 	name = dns_fixedname_initname(&fixed);
-	dns_rdataset_init(&rdataset);
 
 	result = dns_db_createiterator(db, 0, &dbiterator);
 	if (result != ISC_R_SUCCESS) {
 		return (true);
 	}
 
+	zone_checkversion(zone, db, &version);
+	zonecheck_init(&zc, zone, db, version, zone_check_dupname);
+
 	for (result = dns_dbiterator_first(dbiterator); result == ISC_R_SUCCESS;
 	     result = dns_dbiterator_next(dbiterator))
 	{
@@ -3270,22 +4818,8 @@ zone_check_dup(dns_zone_t *zone, dns_db_t *db) {
 			continue;
 		}
 
-		result = dns_db_allrdatasets(db, node, NULL, 0, &rdsit);
-		if (result != ISC_R_SUCCESS) {
-			continue;
-		}
-
-		for (result = dns_rdatasetiter_first(rdsit);
-		     result == ISC_R_SUCCESS;
-		     result = dns_rdatasetiter_next(rdsit))
-		{
-			dns_rdatasetiter_current(rdsit, &rdataset);
-			if (!zone_rrset_check_dup(zone, name, &rdataset)) {
-				ok = false;
-			}
-			dns_rdataset_disassociate(&rdataset);
-		}
-		dns_rdatasetiter_destroy(&rdsit);
+		dns_dbiterator_pause(dbiterator);
+		zonecheck_add(&zc, node, name, NULL);
 		dns_db_detachnode(db, &node);
 	}
 
@@ -3294,6 +4828,9 @@ zone_check_dup(dns_zone_t *zone, dns_db_t *db) {
 	}
 	dns_dbiterator_destroy(&dbiterator);
 
+	ok = zonecheck_finish(&zc);
+	dns_db_closeversion(db, &version, false);
+
 	return (ok);
 }
 
@@ -3328,6 +4865,129 @@ isspf(const dns_rdata_t *rdata) {
 	return (false);
 }
 
+/*%
+ * Check the records at one name for integrity_checks(): the glue of a
+ * delegation, whose NS RRset is then passed in 'job->rdataset', or the
+ * targets of MX and SRV records and the presence of SPF TXT records.
+ */
+static bool
+integrity_check_name(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *version,
+		     zonecheck_job_t *job) {
+	dns_dbnode_t *node = job->node;
+	dns_name_t *name = job->name;
+	dns_rdataset_t rdataset;
+	dns_rdata_mx_t mx;
+	dns_rdata_ns_t ns;
+	dns_rdata_in_srv_t srv;
+	dns_rdata_t rdata;
+	isc_result_t result;
+	bool ok = true, have_spf, have_txt;
+
+	dns_rdataset_init(&rdataset);
+	dns_rdata_init(&rdata);
+
+	if (dns_rdataset_isassociated(&job->rdataset)) {
+		result = dns_rdataset_first(&job->rdataset);
+		while (result == ISC_R_SUCCESS) {
+			dns_rdataset_current(&job->rdataset, &rdata);
+			result = dns_rdata_tostruct(&rdata, &ns, NULL);
+			RUNTIME_CHECK(result == ISC_R_SUCCESS);
+			if (!zone_check_glue(zone, db, &ns.name, name)) {
+				ok = false;
+			}
+			dns_rdata_reset(&rdata);
+			result = dns_rdataset_next(&job->rdataset);
+		}
+		return (ok);
+	}
+
+	result = dns_db_findrdataset(db, node, version, dns_rdatatype_mx, 0, 0,
+				     &rdataset, NULL);
+	if (result != ISC_R_SUCCESS) {
+		goto checksrv;
+	}
+	result = dns_rdataset_first(&rdataset);
+	while (result == ISC_R_SUCCESS) {
+		dns_rdataset_current(&rdataset, &rdata);
+		result = dns_rdata_tostruct(&rdata, &mx, NULL);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		if (!zone_check_mx(zone, db, &mx.mx, name)) {
+			ok = false;
+		}
+		dns_rdata_reset(&rdata);
+		result = dns_rdataset_next(&rdataset);
+	}
+	dns_rdataset_disassociate(&rdataset);
+
+checksrv:
+	if (zone->rdclass != dns_rdataclass_in) {
+		return (ok);
+	}
+	result = dns_db_findrdataset(db, node, version, dns_rdatatype_srv, 0, 0,
+				     &rdataset, NULL);
+	if (result != ISC_R_SUCCESS) {
+		goto checkspf;
+	}
+	result = dns_rdataset_first(&rdataset);
+	while (result == ISC_R_SUCCESS) {
+		dns_rdataset_current(&rdataset, &rdata);
+		result = dns_rdata_tostruct(&rdata, &srv, NULL);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		if (!zone_check_srv(zone, db, &srv.target, name)) {
+			ok = false;
+		}
+		dns_rdata_reset(&rdata);
+		result = dns_rdataset_next(&rdataset);
+	}
+	dns_rdataset_disassociate(&rdataset);
+
+checkspf:
+	/*
+	 * Check if there is a type SPF record without an
+	 * SPF-formatted type TXT record also being present.
+	 */
+	if (!DNS_ZONE_OPTION(zone, DNS_ZONEOPT_CHECKSPF)) {
+		return (ok);
+	}
+	have_spf = have_txt = false;
+	result = dns_db_findrdataset(db, node, version, dns_rdatatype_spf, 0, 0,
+				     &rdataset, NULL);
+	if (result == ISC_R_SUCCESS) {
+		dns_rdataset_disassociate(&rdataset);
+		have_spf = true;
+	}
+	result = dns_db_findrdataset(db, node, version, dns_rdatatype_txt, 0, 0,
+				     &rdataset, NULL);
+	if (result != ISC_R_SUCCESS) {
+		goto notxt;
+	}
+	result = dns_rdataset_first(&rdataset);
+	while (result == ISC_R_SUCCESS) {
+		dns_rdataset_current(&rdataset, &rdata);
+		have_txt = isspf(&rdata);
+		dns_rdata_reset(&rdata);
+		if (have_txt) {
+			break;
+		}
+		result = dns_rdataset_next(&rdataset);
+	}
+	dns_rdataset_disassociate(&rdataset);
+
+notxt:
+	if (have_spf && !have_txt) {
+		char namebuf[DNS_NAME_FORMATSIZE];
+
+		dns_name_format(name, namebuf, sizeof(namebuf));
+		dns_zone_log(zone, ISC_LOG_WARNING,
+			     "'%s' found type "
+			     "SPF record but no SPF TXT record found, "
+			     "add matching type TXT record",
+			     namebuf);
+	}
+
+	return (ok);
+}
+
 static bool
 integrity_checks(dns_zone_t *zone, dns_db_t *db) {
 	dns_dbiterator_t *dbiterator = NULL;
@@ -3335,25 +4995,25 @@ integrity_checks(dns_zone_t *zone, dns_db_t *db) {
 	dns_rdataset_t rdataset;
 	dns_fixedname_t fixed;
 	dns_fixedname_t fixedbottom;
-	dns_rdata_mx_t mx;
-	dns_rdata_ns_t ns;
-	dns_rdata_in_srv_t srv;
-	dns_rdata_t rdata;
 	dns_name_t *name;
 	dns_name_t *bottom;
+	dns_dbversion_t *version = NULL;
+	zonecheck_t zc;
 	isc_result_t result;
-	bool ok = true, have_spf, have_txt;
+	bool ok;
 
 	name = dns_fixedname_initname(&fixed);
 	bottom = dns_fixedname_initname(&fixedbottom);
 	dns_rdataset_init(&rdataset);
-	dns_rdata_init(&rdata);
 
 	result = dns_db_createiterator(db, 0, &dbiterator);
 	if (result != ISC_R_SUCCESS) {
 		return (true);
 	}
 
+	zone_checkversion(zone, db, &version);
+	zonecheck_init(&zc, zone, db, version, integrity_check_name);
+
 	result = dns_dbiterator_first(dbiterator);
 	while (result == ISC_R_SUCCESS) {
 		result = dns_dbiterator_current(dbiterator, &node, name);
@@ -3380,8 +5040,9 @@ integrity_checks(dns_zone_t *zone, dns_db_t *db) {
 			goto checkfordname;
 		}
 
-		result = dns_db_findrdataset(db, node, NULL, dns_rdatatype_ns,
-					     0, 0, &rdataset, NULL);
+		result = dns_db_findrdataset(db, node, version,
+					     dns_rdatatype_ns, 0, 0, &rdataset,
+					     NULL);
 		if (result != ISC_R_SUCCESS) {
 			goto checkfordname;
 		}
@@ -3390,22 +5051,12 @@ integrity_checks(dns_zone_t *zone, dns_db_t *db) {
 		 */
 		dns_name_copy(name, bottom);
 
-		result = dns_rdataset_first(&rdataset);
-		while (result == ISC_R_SUCCESS) {
-			dns_rdataset_current(&rdataset, &rdata);
-			result = dns_rdata_tostruct(&rdata, &ns, NULL);
-			RUNTIME_CHECK(result == ISC_R_SUCCESS);
-			if (!zone_check_glue(zone, db, &ns.name, name)) {
-				ok = false;
-			}
-			dns_rdata_reset(&rdata);
-			result = dns_rdataset_next(&rdataset);
-		}
+		zonecheck_add(&zc, node, name, &rdataset);
 		dns_rdataset_disassociate(&rdataset);
 		goto next;
 
 	checkfordname:
-		result = dns_db_findrdataset(db, node, NULL,
+		result = dns_db_findrdataset(db, node, version,
 					     dns_rdatatype_dname, 0, 0,
 					     &rdataset, NULL);
 		if (result == ISC_R_SUCCESS) {
@@ -3416,92 +5067,7 @@ integrity_checks(dns_zone_t *zone, dns_db_t *db) {
 			dns_rdataset_disassociate(&rdataset);
 		}
 
-		result = dns_db_findrdataset(db, node, NULL, dns_rdatatype_mx,
-					     0, 0, &rdataset, NULL);
-		if (result != ISC_R_SUCCESS) {
-			goto checksrv;
-		}
-		result = dns_rdataset_first(&rdataset);
-		while (result == ISC_R_SUCCESS) {
-			dns_rdataset_current(&rdataset, &rdata);
-			result = dns_rdata_tostruct(&rdata, &mx, NULL);
-			RUNTIME_CHECK(result == ISC_R_SUCCESS);
-			if (!zone_check_mx(zone, db, &mx.mx, name)) {
-				ok = false;
-			}
-			dns_rdata_reset(&rdata);
-			result = dns_rdataset_next(&rdataset);
-		}
-		dns_rdataset_disassociate(&rdataset);
-
-	checksrv:
-		if (zone->rdclass != dns_rdataclass_in) {
-			goto next;
-		}
-		result = dns_db_findrdataset(db, node, NULL, dns_rdatatype_srv,
-					     0, 0, &rdataset, NULL);
-		if (result != ISC_R_SUCCESS) {
-			goto checkspf;
-		}
-		result = dns_rdataset_first(&rdataset);
-		while (result == ISC_R_SUCCESS) {
-			dns_rdataset_current(&rdataset, &rdata);
-			result = dns_rdata_tostruct(&rdata, &srv, NULL);
-			RUNTIME_CHECK(result == ISC_R_SUCCESS);
-			if (!zone_check_srv(zone, db, &srv.target, name)) {
-				ok = false;
-			}
-			dns_rdata_reset(&rdata);
-			result = dns_rdataset_next(&rdataset);
-		}
-		dns_rdataset_disassociate(&rdataset);
-
-	checkspf:
-		/*
-		 * Check if there is a type SPF record without an
-		 * SPF-formatted type TXT record also being present.
-		 */
-		if (!DNS_ZONE_OPTION(zone, DNS_ZONEOPT_CHECKSPF)) {
-			goto next;
-		}
-		if (zone->rdclass != dns_rdataclass_in) {
-			goto next;
-		}
-		have_spf = have_txt = false;
-		result = dns_db_findrdataset(db, node, NULL, dns_rdatatype_spf,
-					     0, 0, &rdataset, NULL);
-		if (result == ISC_R_SUCCESS) {
-			dns_rdataset_disassociate(&rdataset);
-			have_spf = true;
-		}
-		result = dns_db_findrdataset(db, node, NULL, dns_rdatatype_txt,
-					     0, 0, &rdataset, NULL);
-		if (result != ISC_R_SUCCESS) {
-			goto notxt;
-		}
-		result = dns_rdataset_first(&rdataset);
-		while (result == ISC_R_SUCCESS) {
-			dns_rdataset_current(&rdataset, &rdata);
-			have_txt = isspf(&rdata);
-			dns_rdata_reset(&rdata);
-			if (have_txt) {
-				break;
-			}
-			result = dns_rdataset_next(&rdataset);
-		}
-		dns_rdataset_disassociate(&rdataset);
-
-	notxt:
-		if (have_spf && !have_txt) {
-			char namebuf[DNS_NAME_FORMATSIZE];
-
-			dns_name_format(name, namebuf, sizeof(namebuf));
-			dns_zone_log(zone, ISC_LOG_WARNING,
-				     "'%s' found type "
-				     "SPF record but no SPF TXT record found, "
-				     "add matching type TXT record",
-				     namebuf);
-		}
+		zonecheck_add(&zc, node, name, NULL);
 
 	next:
 		dns_db_detachnode(db, &node);
@@ -3514,6 +5080,9 @@ cleanup:
 	}
 	dns_dbiterator_destroy(&dbiterator);
 
+	ok = zonecheck_finish(&zc);
+	dns_db_closeversion(db, &version, false);
+
 	return (ok);
 }
 
@@ -3536,7 +5105,7 @@ zone_check_dnskeys(dns_zone_t *zone, dns_db_t *db) {
 		goto cleanup;
 	}
 
-	dns_db_currentversion(db, &version);
+	zone_checkversion(zone, db, &version);
 	dns_rdataset_init(&rdataset);
 	result = dns_db_findrdataset(db, node, version, dns_rdatatype_dnskey,
 				     dns_rdatatype_none, 0, &rdataset, NULL);
@@ -4048,7 +5617,7 @@ check_nsec3param(dns_zone_t *zone, dns_db_t *db) {
 			     isc_result_totext(result));
 		return (result);
 	}
-	dns_db_currentversion(db, &version);
+	zone_checkversion(zone, db, &version);
 
 	result = dns_db_findrdataset(db, node, version,
 				     dns_rdatatype_nsec3param,
@@ -4502,14 +6071,76 @@ update_soa_serial(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *ver,
 	CHECK(do_one_tuple(&addtuple, db, ver, diff));
 	result = ISC_R_SUCCESS;
 
-failure:
-	if (addtuple != NULL) {
-		dns_difftuple_free(&addtuple);
-	}
-	if (deltuple != NULL) {
-		dns_difftuple_free(&deltuple);
-	}
-	return (result);
+failure:
+	if (addtuple != NULL) {
+		dns_difftuple_free(&addtuple);
+	}
+	if (deltuple != NULL) {
+		dns_difftuple_free(&deltuple);
+	}
+	return (result);
+}
+
+/*
+ * Commit the transactions written by dns_zone_writejournal() to stable
+ * storage and send the events waiting for them.  If that fails, the
+ * waiting events are told so.
+ *
+ * Requires 'zone->jsynclock' to be held.
+ */
+static void
+zone_journalsync(dns_zone_t *zone) {
+	isc_result_t result = ISC_R_SUCCESS;
+	dns_journalwait_t *wait = NULL;
+
+	if (zone->jsyncjournal != NULL) {
+		result = dns_journal_sync(zone->jsyncjournal);
+		if (result != ISC_R_SUCCESS) {
+			dns_zone_log(zone, ISC_LOG_ERROR,
+				     "journal sync failed: %s",
+				     isc_result_totext(result));
+		}
+		dns_journal_destroy(&zone->jsyncjournal);
+	}
+
+	while ((wait = ISC_LIST_HEAD(zone->jsyncwaits)) != NULL) {
+		ISC_LIST_UNLINK(zone->jsyncwaits, wait, link);
+		if (result != ISC_R_SUCCESS && *wait->resultp == ISC_R_SUCCESS)
+		{
+			*wait->resultp = result;
+		}
+		isc_task_sendanddetach(&wait->task, &wait->event);
+		isc_mem_put(zone->mctx, wait, sizeof(*wait));
+	}
+}
+
+/*
+ * Finish any group commit in progress before the journal file is
+ * accessed in any other way.
+ */
+static void
+zone_journal_flush(dns_zone_t *zone) {
+	LOCK(&zone->jsynclock);
+	zone_journalsync(zone);
+	UNLOCK(&zone->jsynclock);
+}
+
+static void
+zone_journalsync_action(isc_task_t *task, isc_event_t *event) {
+	dns_zone_t *zone = event->ev_arg;
+
+	UNUSED(task);
+
+	INSIST(DNS_ZONE_VALID(zone));
+
+	isc_event_free(&event);
+
+	LOCK(&zone->jsynclock);
+	zone->jsyncscheduled = false;
+	zone_journalsync(zone);
+	UNLOCK(&zone->jsynclock);
+
+	dns_zone_idetach(&zone);
 }
 
 /*
@@ -4526,6 +6157,8 @@ zone_journal(dns_zone_t *zone, dns_diff_t *diff, uint32_t *sourceserial,
 	ENTER;
 	journalfile = dns_zone_getjournal(zone);
 	if (journalfile != NULL) {
+		zone_journal_flush(zone);
+
 		result = dns_journal_open(zone->mctx, journalfile, mode,
 					  &journal);
 		if (result != ISC_R_SUCCESS) {
@@ -4551,6 +6184,120 @@ zone_journal(dns_zone_t *zone, dns_diff_t *diff, uint32_t *sourceserial,
 	return (result);
 }
 
+isc_result_t
+dns_zone_writejournal(dns_zone_t *zone, dns_diff_t *diff) {
+	isc_result_t result = ISC_R_SUCCESS;
+	unsigned int mode = DNS_JOURNAL_CREATE | DNS_JOURNAL_DEFERSYNC;
+	bool schedule = false;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	if (!DNS_ZONE_OPTION(zone, DNS_ZONEOPT_JOURNALGROUPCOMMIT)) {
+		return (zone_journal(zone, diff, NULL,
+				     "dns_zone_writejournal"));
+	}
+
+	if (zone->journal == NULL) {
+		return (ISC_R_SUCCESS);
+	}
+
+	LOCK(&zone->jsynclock);
+	if (zone->jsyncjournal == NULL) {
+		result = dns_journal_open(zone->mctx, zone->journal, mode,
+					  &zone->jsyncjournal);
+		if (result != ISC_R_SUCCESS) {
+			dns_zone_log(zone, ISC_LOG_ERROR,
+				     "dns_zone_writejournal:dns_journal_open "
+				     "-> %s",
+				     isc_result_totext(result));
+			goto unlock;
+		}
+	}
+
+	result = dns_journal_write_transaction(zone->jsyncjournal, diff);
+	if (result != ISC_R_SUCCESS) {
+		dns_zone_log(zone, ISC_LOG_ERROR,
+			     "dns_zone_writejournal:"
+			     "dns_journal_write_transaction -> %s",
+			     isc_result_totext(result));
+		/*
+		 * The journal cannot take another transaction now; keep
+		 * the ones already committed to it.
+		 */
+		zone_journalsync(zone);
+		goto unlock;
+	}
+
+	/*
+	 * Sync once the transactions of UPDATE requests already queued
+	 * for the zone have been written as well.
+	 */
+	schedule = !zone->jsyncscheduled;
+	zone->jsyncscheduled = true;
+
+unlock:
+	UNLOCK(&zone->jsynclock);
+
+	if (schedule) {
+		dns_zone_t *dummy = NULL;
+		isc_event_t *e = NULL;
+
+		dns_zone_iattach(zone, &dummy);
+		e = isc_event_allocate(zone->mctx, zone,
+				       DNS_EVENT_ZONEJOURNALSYNC,
+				       zone_journalsync_action, zone,
+				       sizeof(isc_event_t));
+		isc_task_send(zone->task, &e);
+	}
+
+	return (result);
+}
+
+void
+dns_zone_sendafterjournal(dns_zone_t *zone, isc_task_t *task,
+			  isc_event_t **eventp, isc_result_t *resultp) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(eventp != NULL && *eventp != NULL);
+	REQUIRE(resultp != NULL);
+
+	LOCK(&zone->jsynclock);
+	if (zone->jsyncjournal != NULL) {
+		dns_journalwait_t *wait = isc_mem_get(zone->mctx,
+						      sizeof(*wait));
+		*wait = (dns_journalwait_t){
+			.event = *eventp,
+			.resultp = resultp,
+		};
+		ISC_LINK_INIT(wait, link);
+		isc_task_attach(task, &wait->task);
+		ISC_LIST_APPEND(zone->jsyncwaits, wait, link);
+		*eventp = NULL;
+	}
+	UNLOCK(&zone->jsynclock);
+
+	if (*eventp != NULL) {
+		isc_task_send(task, eventp);
+	}
+}
+
+isc_result_t
+dns_zone_getcompactprogress(dns_zone_t *zone, uint64_t *copiedp,
+			    uint64_t *totalp) {
+	isc_result_t result = ISC_R_NOTFOUND;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(copiedp != NULL && totalp != NULL);
+
+	LOCK_ZONE(zone);
+	if (zone->jcompact != NULL) {
+		dns_journal_compact_progress(zone->jcompact, copiedp, totalp);
+		result = ISC_R_SUCCESS;
+	}
+	UNLOCK_ZONE(zone);
+
+	return (result);
+}
+
 /*
  * Create an SOA record for a newly-created zone
  */
@@ -5012,6 +6759,7 @@ zone_postload(dns_zone_t *zone, dns_db_t *db, isc_time_t loadtime,
 		dns_journal_t *journal = NULL;
 		bool empty = false;
 
+		zone_journal_flush(zone);
 		result = dns_journal_open(zone->mctx, zone->journal,
 					  DNS_JOURNAL_READ, &journal);
 		if (result == ISC_R_SUCCESS) {
@@ -5099,7 +6847,11 @@ zone_postload(dns_zone_t *zone, dns_db_t *db, isc_time_t loadtime,
 		}
 
 		if (zone->type == dns_zone_primary) {
-			result = dns_zone_cdscheck(zone, db, NULL);
+			dns_dbversion_t *version = NULL;
+
+			zone_checkversion(zone, db, &version);
+			result = dns_zone_cdscheck(zone, db, version);
+			dns_db_closeversion(db, &version, false);
 			if (result != ISC_R_SUCCESS) {
 				dns_zone_log(zone, ISC_LOG_ERROR,
 					     "CDS/CDNSKEY consistency checks "
@@ -5119,12 +6871,19 @@ zone_postload(dns_zone_t *zone, dns_db_t *db, isc_time_t loadtime,
 			/*
 			 * This is checked in zone_replacedb() for
 			 * secondary zones as they don't reload from disk.
+			 * The database of a zone reloaded in place
+			 * already reads as the new one.
 			 */
-			result = zone_get_from_db(
-				zone, zone->db, NULL, &oldsoacount, NULL,
-				&oldserial, NULL, NULL, NULL, NULL, NULL);
-			RUNTIME_CHECK(result == ISC_R_SUCCESS);
-			RUNTIME_CHECK(oldsoacount > 0U);
+			if (zone->inplace != NULL) {
+				oldserial = zone->inplace->oldserial;
+			} else {
+				result = zone_get_from_db(
+					zone, zone->db, NULL, &oldsoacount,
+					NULL, &oldserial, NULL, NULL, NULL,
+					NULL, NULL);
+				RUNTIME_CHECK(result == ISC_R_SUCCESS);
+				RUNTIME_CHECK(oldsoacount > 0U);
+			}
 			if (DNS_ZONE_OPTION(zone, DNS_ZONEOPT_IXFRFROMDIFFS) &&
 			    !isc_serial_gt(serial, oldserial))
 			{
@@ -5384,6 +7143,13 @@ zone_postload(dns_zone_t *zone, dns_db_t *db, isc_time_t loadtime,
 	}
 
 	zone->loadtime = loadtime;
+	if (!isc_time_isepoch(&zone->loadstart)) {
+		isc_time_t loaded;
+
+		TIME_NOW(&loaded);
+		zone->loadusecs = isc_time_microdiff(&loaded,
+						     &zone->loadstart);
+	}
 	goto done;
 
 cleanup:
@@ -5705,7 +7471,7 @@ zone_get_from_db(dns_zone_t *zone, dns_db_t *db, unsigned int *nscount,
 	REQUIRE(db != NULL);
 	REQUIRE(zone != NULL);
 
-	dns_db_currentversion(db, &version);
+	zone_checkversion(zone, db, &version);
 
 	SET_IF_NOT_NULL(nscount, 0);
 	SET_IF_NOT_NULL(soacount, 0);
@@ -6563,23 +8329,356 @@ dns_zone_setparentals(dns_zone_t *zone, const isc_sockaddr_t *parentals,
 	dns_zone_log(zone, ISC_LOG_NOTICE, "checkds: set %u parentals", count);
 
 unlock:
-	UNLOCK_ZONE(zone);
+	UNLOCK_ZONE(zone);
+}
+
+/*
+ * What it takes to load the database of an idle secondary zone back
+ * from its zone file once it has been evicted from memory.
+ */
+struct dns_evicted {
+	char *masterfile;
+	dns_masterformat_t masterformat;
+	char *dbtype;
+	unsigned int options;
+	dns_ttl_t maxttl;
+	uint32_t serial; /* Of the evicted database */
+	bool failed;	 /* The zone file could not be loaded back */
+};
+
+static void
+evicted_free(isc_mem_t *mctx, dns_evicted_t **evictedp) {
+	dns_evicted_t *evicted = *evictedp;
+
+	*evictedp = NULL;
+	isc_mem_free(mctx, evicted->masterfile);
+	isc_mem_free(mctx, evicted->dbtype);
+	isc_mem_put(mctx, evicted, sizeof(*evicted));
+}
+
+/*
+ * Whether the database of 'zone' could be evicted from memory once it
+ * is idle: it is a secondary zone whose zone file holds all of its
+ * loaded data, and nothing but queries and zone transfers look at it.
+ *
+ * Requires 'zone' to be locked.
+ */
+static bool
+zone_canevict(dns_zone_t *zone) {
+	bool loaded;
+
+	REQUIRE(LOCKED_ZONE(zone));
+
+	if (zone->type != dns_zone_secondary || zone->idletime == 0 ||
+	    zone->masterfile == NULL || zone->stream != NULL ||
+	    zone->db_argc != 1 || zone->raw != NULL || zone->secure != NULL ||
+	    zone->rpzs != NULL || zone->catzs != NULL || zone->xfr != NULL)
+	{
+		return (false);
+	}
+	if (strcmp(zone->db_argv[0], "rbt") != 0 &&
+	    strcmp(zone->db_argv[0], "qp") != 0)
+	{
+		return (false);
+	}
+	if (!DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADED) ||
+	    DNS_ZONE_FLAG(zone, DNS_ZONEFLG_REFRESH) ||
+	    DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADING) ||
+	    DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADPENDING) ||
+	    DNS_ZONE_FLAG(zone, DNS_ZONEFLG_NEEDDUMP) ||
+	    DNS_ZONE_FLAG(zone, DNS_ZONEFLG_DUMPING) ||
+	    DNS_ZONE_FLAG(zone, DNS_ZONEFLG_NEEDNOTIFY) ||
+	    DNS_ZONE_FLAG(zone, DNS_ZONEFLG_NEEDSTARTUPNOTIFY))
+	{
+		return (false);
+	}
+
+	ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_read);
+	loaded = (zone->db != NULL);
+	ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_read);
+
+	return (loaded);
+}
+
+/*
+ * Evict the database of 'zone' from memory if it has not been used for
+ * the idle time of the zone.  Its zone file is up to date, as it has
+ * no changes waiting to be dumped.
+ *
+ * Requires 'zone' to be locked.
+ */
+static void
+zone_evict(dns_zone_t *zone) {
+	dns_evicted_t *evicted = NULL;
+	isc_stdtime_t now, lastused;
+	uint32_t serial;
+	isc_result_t result = ISC_R_FAILURE;
+
+	REQUIRE(LOCKED_ZONE(zone));
+
+	if (!zone_canevict(zone)) {
+		return;
+	}
+
+	isc_stdtime_get(&now);
+	lastused = atomic_load_relaxed(&zone->lastused);
+	if (now < lastused || now - lastused < zone->idletime) {
+		return;
+	}
+
+	LOCK(&zone->evictlock);
+	ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_write);
+	if (zone->db != NULL) {
+		result = dns_db_getsoaserial(zone->db, NULL, &serial);
+	}
+	if (result == ISC_R_SUCCESS) {
+		evicted = isc_mem_get(zone->mctx, sizeof(*evicted));
+		*evicted = (dns_evicted_t){
+			.masterfile = isc_mem_strdup(zone->mctx,
+						     zone->masterfile),
+			.masterformat = zone->masterformat,
+			.dbtype = isc_mem_strdup(zone->mctx, zone->db_argv[0]),
+			.options = get_primary_options(zone),
+			.maxttl = zone->maxttl,
+			.serial = serial,
+		};
+		if (zone->evicted != NULL) {
+			evicted_free(zone->mctx, &zone->evicted);
+		}
+		zone->evicted = evicted;
+		zone_detachdb(zone);
+	}
+	ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_write);
+	UNLOCK(&zone->evictlock);
+
+	if (result == ISC_R_SUCCESS) {
+		dns_zone_log(zone, ISC_LOG_DEBUG(1),
+			     "evicted from memory after being idle for %u "
+			     "seconds",
+			     now - lastused);
+	}
+}
+
+/*
+ * Load the database of a zone evicted from memory back from the zone
+ * file described by 'evicted' into '*dbp'.
+ */
+static isc_result_t
+evicted_load(dns_zone_t *zone, dns_evicted_t *evicted, dns_db_t **dbp) {
+	dns_db_t *db = NULL;
+	dns_rdatacallbacks_t callbacks;
+	uint32_t serial;
+	isc_result_t result, tresult;
+
+	result = dns_db_create(zone->mctx, evicted->dbtype, &zone->origin,
+			       dns_dbtype_zone, zone->rdclass, 0, NULL, &db);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	dns_rdatacallbacks_init(&callbacks);
+	result = dns_db_beginload(db, &callbacks);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+	result = dns_master_loadfile(evicted->masterfile, &zone->origin,
+				     &zone->origin, zone->rdclass,
+				     evicted->options, 0, &callbacks, NULL,
+				     NULL, zone->mctx, evicted->masterformat,
+				     evicted->maxttl);
+	tresult = dns_db_endload(db, &callbacks);
+	if (result == DNS_R_SEENINCLUDE) {
+		result = ISC_R_SUCCESS;
+	}
+	if (result == ISC_R_SUCCESS) {
+		result = tresult;
+	}
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	/*
+	 * The zone file must be the one the database was evicted with.
+	 */
+	result = dns_db_getsoaserial(db, NULL, &serial);
+	if (result == ISC_R_SUCCESS && serial != evicted->serial) {
+		result = DNS_R_BADZONE;
+	}
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	dns_db_settask(db, zone->task);
+	(void)dns_db_setgluecachestats(db, zone->gluecachestats);
+
+	*dbp = db;
+	return (ISC_R_SUCCESS);
+
+cleanup:
+	dns_db_detach(&db);
+	return (result);
+}
+
+/*
+ * The database of 'zone' could not be loaded back after being evicted
+ * from memory: consider the zone not loaded, and transfer it again.
+ */
+static void
+zone_evictfailed(void *arg) {
+	dns_zone_t *zone = arg;
+	bool failed = false;
+
+	LOCK_ZONE(zone);
+	LOCK(&zone->evictlock);
+	ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_write);
+	if (zone->db == NULL && zone->evicted != NULL &&
+	    zone->evicted->failed)
+	{
+		evicted_free(zone->mctx, &zone->evicted);
+		failed = true;
+	}
+	ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_write);
+	UNLOCK(&zone->evictlock);
+
+	if (failed && !DNS_ZONE_FLAG(zone, DNS_ZONEFLG_EXITING)) {
+		isc_time_t now;
+
+		DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_LOADED);
+		TIME_NOW(&now);
+		zone->refreshtime = now;
+		if (zone->task != NULL) {
+			zone_settimer(zone, &now);
+		}
+	}
+	UNLOCK_ZONE(zone);
+
+	dns_zone_detach(&zone);
+}
+
+/*
+ * Attach '*dbp' to the database of 'zone', loading it back from the
+ * zone file if it was evicted from memory.  This is done by the first
+ * caller that needs it, in its own thread; other callers wait for it.
+ */
+static isc_result_t
+zone_materialize(dns_zone_t *zone, dns_db_t **dbp) {
+	dns_evicted_t *evicted = NULL;
+	dns_db_t *db = NULL;
+	isc_result_t result = DNS_R_NOTLOADED;
+
+	LOCK(&zone->evictlock);
+
+	ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_read);
+	if (zone->db != NULL) {
+		dns_db_attach(zone->db, dbp);
+		result = ISC_R_SUCCESS;
+	} else if (zone->evicted != NULL && !zone->evicted->failed &&
+		   DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADED))
+	{
+		evicted = zone->evicted;
+	}
+	ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_read);
+
+	if (evicted == NULL) {
+		goto unlock;
+	}
+
+	result = evicted_load(zone, evicted, &db);
+
+	ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_write);
+	if (zone->db == NULL && result == ISC_R_SUCCESS) {
+		zone_attachdb(zone, db);
+	}
+	if (zone->db != NULL) {
+		/*
+		 * Loaded back, or replaced by a zone transfer meanwhile.
+		 */
+		dns_db_attach(zone->db, dbp);
+		evicted_free(zone->mctx, &zone->evicted);
+		result = ISC_R_SUCCESS;
+	} else {
+		evicted->failed = true;
+	}
+	ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_write);
+
+	if (db != NULL) {
+		dns_db_detach(&db);
+	}
+
+	if (result == ISC_R_SUCCESS) {
+		dns_zone_log(zone, ISC_LOG_DEBUG(1),
+			     "loaded back into memory on demand");
+	} else {
+		dns_zone_t *ref = NULL;
+
+		dns_zone_log(zone, ISC_LOG_ERROR,
+			     "loading back from %s failed: %s",
+			     evicted->masterfile, isc_result_totext(result));
+		dns_zone_attach(zone, &ref);
+		isc_async_run(zone->loop, zone_evictfailed, ref);
+		result = DNS_R_NOTLOADED;
+	}
+
+unlock:
+	UNLOCK(&zone->evictlock);
+	return (result);
+}
+
+/*
+ * Get the serial of the loaded database of 'zone', which may have been
+ * evicted from memory.
+ *
+ * Requires the dblock to be held.
+ */
+static isc_result_t
+zone_loadedserial(dns_zone_t *zone, uint32_t *serialp) {
+	isc_result_t result;
+	unsigned int soacount;
+
+	if (zone->db == NULL) {
+		if (zone->evicted == NULL) {
+			return (DNS_R_NOTLOADED);
+		}
+		*serialp = zone->evicted->serial;
+		return (ISC_R_SUCCESS);
+	}
+
+	result = zone_get_from_db(zone, zone->db, NULL, &soacount, NULL,
+				  serialp, NULL, NULL, NULL, NULL, NULL);
+	if (result == ISC_R_SUCCESS && soacount == 0) {
+		result = ISC_R_FAILURE;
+	}
+	return (result);
 }
 
 isc_result_t
 dns_zone_getdb(dns_zone_t *zone, dns_db_t **dpb) {
 	isc_result_t result = ISC_R_SUCCESS;
+	bool evicted = false;
 
 	REQUIRE(DNS_ZONE_VALID(zone));
 
 	ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_read);
-	if (zone->db == NULL) {
-		result = DNS_R_NOTLOADED;
-	} else {
+	if (zone->db != NULL) {
 		dns_db_attach(zone->db, dpb);
+	} else if (zone->evicted != NULL) {
+		evicted = true;
+	} else {
+		result = DNS_R_NOTLOADED;
 	}
 	ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_read);
 
+	if (evicted) {
+		result = zone_materialize(zone, dpb);
+	}
+
+	if (result == ISC_R_SUCCESS && zone->idletime != 0) {
+		isc_stdtime_t now;
+
+		isc_stdtime_get(&now);
+		atomic_store_relaxed(&zone->lastused, now);
+	}
+
 	return (result);
 }
 
@@ -6649,6 +8748,143 @@ failure:
  * Find DNSSEC keys used for signing zone with dnssec-policy. Load these keys
  * into 'keys'. Requires KASP to be locked.
  */
+/*
+ * Render the TTL and records of the DNSKEY RRset at 'node' in version
+ * 'ver' of 'db' into a new buffer, for comparison with another version.
+ */
+static isc_result_t
+dnskey_render(dns_db_t *db, dns_dbversion_t *ver, dns_dbnode_t *node,
+	      isc_mem_t *mctx, isc_buffer_t **bufferp) {
+	isc_result_t result;
+	dns_rdataset_t rdataset;
+
+	dns_rdataset_init(&rdataset);
+	result = dns_db_findrdataset(db, node, ver, dns_rdatatype_dnskey, 0, 0,
+				     &rdataset, NULL);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	isc_buffer_allocate(mctx, bufferp, 1024);
+	isc_buffer_setautorealloc(*bufferp, true);
+	isc_buffer_putuint32(*bufferp, rdataset.ttl);
+	for (result = dns_rdataset_first(&rdataset); result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(&rdataset))
+	{
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+
+		dns_rdataset_current(&rdataset, &rdata);
+		isc_buffer_putuint16(*bufferp, rdata.length);
+		isc_buffer_putmem(*bufferp, rdata.data, rdata.length);
+	}
+	dns_rdataset_disassociate(&rdataset);
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Like dns__zone_findkeys(), but for dynamic updates, which may come
+ * in much faster than the keys change: the keys are kept in memory and
+ * only loaded from the key directory again when the DNSKEY RRset has
+ * changed, zone_rekey() has run, a timing event of one of the keys has
+ * come, or the key refresh interval has passed since they were loaded.
+ * The keys returned are shared with the zone and must not be modified.
+ * Unlike dns__zone_findkeys(), #ISC_R_NOTFOUND is returned if there is
+ * no DNSKEY RRset.
+ */
+isc_result_t
+dns__zone_updatekeys(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *ver,
+		     isc_stdtime_t now, unsigned int maxkeys, dst_key_t **keys,
+		     unsigned int *nkeys) {
+	static const int events[] = { DST_TIME_PUBLISH, DST_TIME_ACTIVATE,
+				      DST_TIME_REVOKE, DST_TIME_INACTIVE,
+				      DST_TIME_DELETE };
+	isc_result_t result;
+	dns_dbnode_t *node = NULL;
+	isc_buffer_t *keyset = NULL;
+	isc_stdtime_t expire;
+	bool found = false;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(maxkeys <= DNS_MAXZONEKEYS);
+
+	*nkeys = 0;
+	memset(keys, 0, sizeof(*keys) * maxkeys);
+
+	CHECK(dns_db_findnode(db, dns_db_origin(db), false, &node));
+	CHECK(dnskey_render(db, ver, node, zone->mctx, &keyset));
+
+	LOCK_ZONE(zone);
+	if (zone->updatekeyset != NULL && zone->nupdatekeys <= maxkeys &&
+	    isc_serial_lt(now, zone->updatekeysexpire) &&
+	    isc_buffer_usedlength(keyset) ==
+		    isc_buffer_usedlength(zone->updatekeyset) &&
+	    memcmp(isc_buffer_base(keyset), isc_buffer_base(zone->updatekeyset),
+		   isc_buffer_usedlength(keyset)) == 0)
+	{
+		for (unsigned int i = 0; i < zone->nupdatekeys; i++) {
+			dst_key_attach(zone->updatekeys[i], &keys[i]);
+		}
+		*nkeys = zone->nupdatekeys;
+		found = true;
+	}
+	UNLOCK_ZONE(zone);
+
+	if (found) {
+		goto failure;
+	}
+
+	dns_zone_lock_keyfiles(zone);
+	result = dns_dnssec_findzonekeys(db, ver, node, dns_db_origin(db),
+					 dns_zone_getkeydirectory(zone), now,
+					 zone->mctx, maxkeys, keys, nkeys);
+	dns_zone_unlock_keyfiles(zone);
+	if (result != ISC_R_SUCCESS) {
+		goto failure;
+	}
+
+	/*
+	 * Keep the keys until the first of their timing events to come,
+	 * since that may change which of them are active.
+	 */
+	expire = now + (zone->refreshkeyinterval != 0
+				? zone->refreshkeyinterval
+				: HOUR);
+	for (unsigned int i = 0; i < *nkeys; i++) {
+		for (size_t j = 0; j < ARRAY_SIZE(events); j++) {
+			isc_stdtime_t when;
+
+			if (dst_key_gettime(keys[i], events[j], &when) ==
+				    ISC_R_SUCCESS &&
+			    isc_serial_gt(when, now) &&
+			    isc_serial_lt(when, expire))
+			{
+				expire = when;
+			}
+		}
+	}
+
+	LOCK_ZONE(zone);
+	clear_updatekeys(zone);
+	for (unsigned int i = 0; i < *nkeys; i++) {
+		dst_key_attach(keys[i], &zone->updatekeys[i]);
+	}
+	zone->nupdatekeys = *nkeys;
+	zone->updatekeyset = keyset;
+	keyset = NULL;
+	zone->updatekeysexpire = expire;
+	UNLOCK_ZONE(zone);
+
+failure:
+	if (keyset != NULL) {
+		isc_buffer_free(&keyset);
+	}
+	if (node != NULL) {
+		dns_db_detachnode(db, &node);
+	}
+	return (result);
+}
+
 isc_result_t
 dns_zone_getdnsseckeys(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *ver,
 		       isc_stdtime_t now, dns_dnsseckeylist_t *keys) {
@@ -7065,18 +9301,327 @@ failure:
 	return (result);
 }
 
+/*%
+ * Signatures are generated in batches: the RRSIGs of the RRsets queued
+ * with signer_add() are calculated by signer_flush(), in parallel by up
+ * to zone->signingthreads threads, and then added to the database and
+ * diff in the order they were queued.  The calling thread works on the
+ * batch too, so it never waits for a worker that has not started.
+ */
+#define SIGNER_JOBS 16U /* Jobs per thread in a batch */
+
+typedef struct signjob {
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_rdataset_t rdataset;
+	dns_ttl_t ttl;
+	dst_key_t *key;
+	isc_stdtime_t inception;
+	isc_stdtime_t expire;
+	isc_result_t result;
+	dns_rdata_t rdata;
+	unsigned char data[1024]; /* XXX */
+} signjob_t;
+
+typedef struct signrun {
+	isc_mem_t *mctx;
+	isc_refcount_t references;
+	signjob_t *jobs;
+	unsigned int njobs;
+	atomic_uint_fast32_t next;
+	isc_mutex_t lock;
+	isc_condition_t cond;
+	unsigned int done; /* Locked by lock */
+} signrun_t;
+
+typedef struct zonesigner {
+	dns_zone_t *zone;
+	dns_db_t *db;
+	dns_dbversion_t *version;
+	dns_diff_t *diff;
+	isc_mem_t *mctx;
+	unsigned int threads;
+	signjob_t *jobs;
+	unsigned int njobs;
+	unsigned int maxjobs;
+} zonesigner_t;
+
+static void
+signer_init(zonesigner_t *signer, dns_zone_t *zone, dns_db_t *db,
+	    dns_dbversion_t *version, dns_diff_t *diff, isc_mem_t *mctx) {
+	*signer = (zonesigner_t){
+		.zone = zone,
+		.db = db,
+		.version = version,
+		.diff = diff,
+		.mctx = mctx,
+		.threads = zone->signingthreads,
+	};
+
+	/*
+	 * The workers are queued on the zone's loop, which can only be
+	 * done from its own thread.
+	 */
+	if (zone->loop == NULL || isc_tid() != zone->tid) {
+		signer->threads = 1;
+	}
+	if (signer->threads > 1) {
+		signer->maxjobs = signer->threads * SIGNER_JOBS;
+	}
+}
+
+static void
+signjob_sign(signjob_t *job, dns_rdataset_t *rdataset, isc_mem_t *mctx) {
+	isc_buffer_t buffer;
+
+	isc_buffer_init(&buffer, job->data, sizeof(job->data));
+	dns_rdata_init(&job->rdata);
+	job->result = dns_dnssec_sign(job->name, rdataset, job->key,
+				      &job->inception, &job->expire, mctx,
+				      &buffer, &job->rdata);
+}
+
+static void
+signjob_apply(zonesigner_t *signer, signjob_t *job, isc_result_t *resultp) {
+	dns_stats_t *dnssecsignstats;
+	isc_result_t result = job->result;
+
+	if (*resultp != ISC_R_SUCCESS) {
+		return;
+	}
+
+	/* Update the database and journal with the RRSIG. */
+	/* XXX inefficient - will cause dataset merging */
+	if (result == ISC_R_SUCCESS) {
+		result = update_one_rr(signer->db, signer->version,
+				       signer->diff, DNS_DIFFOP_ADDRESIGN,
+				       job->name, job->ttl,
+				       &job->rdata);
+	}
+	if (result != ISC_R_SUCCESS) {
+		*resultp = result;
+		return;
+	}
+
+	/* Update DNSSEC sign statistics. */
+	dnssecsignstats = dns_zone_getdnssecsignstats(signer->zone);
+	if (dnssecsignstats != NULL) {
+		/* Generated a new signature. */
+		dns_dnssecsignstats_increment(dnssecsignstats, ID(job->key),
+					      (uint8_t)ALG(job->key),
+					      dns_dnssecsignstats_sign);
+		/* This is a refresh. */
+		dns_dnssecsignstats_increment(dnssecsignstats, ID(job->key),
+					      (uint8_t)ALG(job->key),
+					      dns_dnssecsignstats_refresh);
+	}
+}
+
+static void
+signrun_detach(signrun_t **runp) {
+	signrun_t *run = *runp;
+
+	*runp = NULL;
+
+	if (isc_refcount_decrement(&run->references) == 1) {
+		isc_refcount_destroy(&run->references);
+		isc_condition_destroy(&run->cond);
+		isc_mutex_destroy(&run->lock);
+		isc_mem_put(run->mctx, run->jobs,
+			    run->njobs * sizeof(run->jobs[0]));
+		isc_mem_putanddetach(&run->mctx, run, sizeof(*run));
+	}
+}
+
+static void
+signrun_work(void *arg) {
+	signrun_t *run = arg;
+	unsigned int done = 0;
+	uint_fast32_t i;
+
+	while ((i = atomic_fetch_add_relaxed(&run->next, 1)) < run->njobs) {
+		signjob_sign(&run->jobs[i], &run->jobs[i].rdataset,
+			     run->mctx);
+		done++;
+	}
+
+	if (done > 0) {
+		LOCK(&run->lock);
+		run->done += done;
+		if (run->done == run->njobs) {
+			SIGNAL(&run->cond);
+		}
+		UNLOCK(&run->lock);
+	}
+}
+
+static void
+signrun_done(void *arg) {
+	signrun_t *run = arg;
+
+	signrun_detach(&run);
+}
+
+/*%
+ * Calculate the signatures queued in 'signer' and apply them.  The
+ * batch is emptied even if this fails.
+ */
+static isc_result_t
+signer_flush(zonesigner_t *signer) {
+	isc_result_t result = ISC_R_SUCCESS;
+	signrun_t *run = NULL;
+	unsigned int i;
+
+	if (signer->njobs == 0) {
+		return (ISC_R_SUCCESS);
+	}
+
+	run = isc_mem_get(signer->mctx, sizeof(*run));
+	*run = (signrun_t){
+		.jobs = signer->jobs,
+		.njobs = signer->njobs,
+	};
+	isc_mem_attach(signer->mctx, &run->mctx);
+	isc_refcount_init(&run->references, 1);
+	atomic_init(&run->next, 0);
+	isc_mutex_init(&run->lock);
+	isc_condition_init(&run->cond);
+
+	/*
+	 * The jobs array is sized for a full batch; trim it so that it
+	 * can be freed by whichever thread is done with the run last.
+	 */
+	if (run->njobs < signer->maxjobs) {
+		run->jobs = isc_mem_reget(
+			signer->mctx, signer->jobs,
+			signer->maxjobs * sizeof(run->jobs[0]),
+			run->njobs * sizeof(run->jobs[0]));
+	}
+	signer->jobs = NULL;
+	signer->njobs = 0;
+
+	for (i = 1; i < ISC_MIN(signer->threads, run->njobs); i++) {
+		isc_refcount_increment(&run->references);
+		isc_work_enqueue(signer->zone->loop, signrun_work,
+				 signrun_done, run);
+	}
+
+	signrun_work(run);
+
+	LOCK(&run->lock);
+	while (run->done < run->njobs) {
+		WAIT(&run->cond, &run->lock);
+	}
+	UNLOCK(&run->lock);
+
+	for (i = 0; i < run->njobs; i++) {
+		signjob_t *job = &run->jobs[i];
+
+		signjob_apply(signer, job, &result);
+		dns_rdataset_disassociate(&job->rdataset);
+		dst_key_free(&job->key);
+	}
+
+	signrun_detach(&run);
+
+	return (result);
+}
+
+/*%
+ * Generate a signature of 'rdataset' at 'name' with 'key', now or in
+ * the next batch.
+ */
 static isc_result_t
-add_sigs(dns_db_t *db, dns_dbversion_t *ver, dns_name_t *name, dns_zone_t *zone,
-	 dns_rdatatype_t type, dns_diff_t *diff, dst_key_t **keys,
-	 unsigned int nkeys, isc_mem_t *mctx, isc_stdtime_t inception,
-	 isc_stdtime_t expire, bool check_ksk, bool keyset_kskonly) {
+signer_add(zonesigner_t *signer, dns_name_t *name, dns_rdataset_t *rdataset,
+	   dst_key_t *key, isc_stdtime_t inception, isc_stdtime_t expire) {
+	signjob_t *job = NULL;
+
+	if (signer->maxjobs == 0) {
+		signjob_t onejob = {
+			.name = name,
+			.ttl = rdataset->ttl,
+			.key = key,
+			.inception = inception,
+			.expire = expire,
+		};
+		isc_result_t result = ISC_R_SUCCESS;
+
+		signjob_sign(&onejob, rdataset, signer->mctx);
+		signjob_apply(signer, &onejob, &result);
+		return (result);
+	}
+
+	if (signer->jobs == NULL) {
+		signer->jobs = isc_mem_get(signer->mctx,
+					   signer->maxjobs *
+						   sizeof(signer->jobs[0]));
+	}
+
+	job = &signer->jobs[signer->njobs++];
+	*job = (signjob_t){
+		.ttl = rdataset->ttl,
+		.inception = inception,
+		.expire = expire,
+	};
+	job->name = dns_fixedname_initname(&job->fixed);
+	dns_name_copy(name, job->name);
+	dns_rdataset_init(&job->rdataset);
+	dns_rdataset_clone(rdataset, &job->rdataset);
+	dst_key_attach(key, &job->key);
+
+	if (signer->njobs == signer->maxjobs) {
+		return (signer_flush(signer));
+	}
+	return (ISC_R_SUCCESS);
+}
+
+/*%
+ * Return true if a signature of the 'covers' RRset at 'name' is waiting
+ * in the batch.
+ */
+static bool
+signer_pending(zonesigner_t *signer, const dns_name_t *name,
+	       dns_rdatatype_t covers) {
+	for (unsigned int i = 0; i < signer->njobs; i++) {
+		if (signer->jobs[i].rdataset.type == covers &&
+		    dns_name_equal(signer->jobs[i].name, name))
+		{
+			return (true);
+		}
+	}
+	return (false);
+}
+
+/*%
+ * Discard the signatures still waiting in 'signer'.
+ */
+static void
+signer_invalidate(zonesigner_t *signer) {
+	for (unsigned int i = 0; i < signer->njobs; i++) {
+		dns_rdataset_disassociate(&signer->jobs[i].rdataset);
+		dst_key_free(&signer->jobs[i].key);
+	}
+	if (signer->jobs != NULL) {
+		isc_mem_put(signer->mctx, signer->jobs,
+			    signer->maxjobs * sizeof(signer->jobs[0]));
+		signer->jobs = NULL;
+	}
+	signer->njobs = 0;
+}
+
+/*%
+ * Queue the signatures of the 'type' RRset at 'name' in 'signer'.
+ */
+static isc_result_t
+queue_sigs(zonesigner_t *signer, dns_name_t *name, dns_rdatatype_t type,
+	   dst_key_t **keys, unsigned int nkeys, isc_stdtime_t inception,
+	   isc_stdtime_t expire, bool check_ksk, bool keyset_kskonly) {
 	isc_result_t result;
+	dns_db_t *db = signer->db;
+	dns_dbversion_t *ver = signer->version;
+	dns_zone_t *zone = signer->zone;
 	dns_dbnode_t *node = NULL;
-	dns_stats_t *dnssecsignstats;
 	dns_rdataset_t rdataset;
-	dns_rdata_t sig_rdata = DNS_RDATA_INIT;
-	unsigned char data[1024]; /* XXX */
-	isc_buffer_t buffer;
 	unsigned int i, j;
 	bool use_kasp = false;
 
@@ -7087,7 +9632,6 @@ add_sigs(dns_db_t *db, dns_dbversion_t *ver, dns_name_t *name, dns_zone_t *zone,
 	}
 
 	dns_rdataset_init(&rdataset);
-	isc_buffer_init(&buffer, data, sizeof(data));
 
 	if (type == dns_rdatatype_nsec3) {
 		result = dns_db_findnsec3node(db, name, false, &node);
@@ -7293,31 +9837,8 @@ add_sigs(dns_db_t *db, dns_dbversion_t *ver, dns_name_t *name, dns_zone_t *zone,
 		}
 
 		/* Calculate the signature, creating a RRSIG RDATA. */
-		isc_buffer_clear(&buffer);
-		CHECK(dns_dnssec_sign(name, &rdataset, keys[i], &inception,
-				      &expire, mctx, &buffer, &sig_rdata));
-
-		/* Update the database and journal with the RRSIG. */
-		/* XXX inefficient - will cause dataset merging */
-		CHECK(update_one_rr(db, ver, diff, DNS_DIFFOP_ADDRESIGN, name,
-				    rdataset.ttl, &sig_rdata));
-		dns_rdata_reset(&sig_rdata);
-		isc_buffer_init(&buffer, data, sizeof(data));
-
-		/* Update DNSSEC sign statistics. */
-		dnssecsignstats = dns_zone_getdnssecsignstats(zone);
-		if (dnssecsignstats != NULL) {
-			/* Generated a new signature. */
-			dns_dnssecsignstats_increment(dnssecsignstats,
-						      ID(keys[i]),
-						      (uint8_t)ALG(keys[i]),
-						      dns_dnssecsignstats_sign);
-			/* This is a refresh. */
-			dns_dnssecsignstats_increment(
-				dnssecsignstats, ID(keys[i]),
-				(uint8_t)ALG(keys[i]),
-				dns_dnssecsignstats_refresh);
-		}
+		CHECK(signer_add(signer, name, &rdataset, keys[i], inception,
+				 expire));
 	}
 
 failure:
@@ -7330,6 +9851,25 @@ failure:
 	return (result);
 }
 
+static isc_result_t
+add_sigs(dns_db_t *db, dns_dbversion_t *ver, dns_name_t *name, dns_zone_t *zone,
+	 dns_rdatatype_t type, dns_diff_t *diff, dst_key_t **keys,
+	 unsigned int nkeys, isc_mem_t *mctx, isc_stdtime_t inception,
+	 isc_stdtime_t expire, bool check_ksk, bool keyset_kskonly) {
+	isc_result_t result;
+	zonesigner_t signer;
+
+	signer_init(&signer, zone, db, ver, diff, mctx);
+	result = queue_sigs(&signer, name, type, keys, nkeys, inception,
+			    expire, check_ksk, keyset_kskonly);
+	if (result == ISC_R_SUCCESS) {
+		result = signer_flush(&signer);
+	}
+	signer_invalidate(&signer);
+
+	return (result);
+}
+
 static void
 zone_resigninc(dns_zone_t *zone) {
 	dns_db_t *db = NULL;
@@ -7341,6 +9881,7 @@ zone_resigninc(dns_zone_t *zone) {
 	dns_rdataset_t rdataset;
 	dns_rdatatype_t covers;
 	dst_key_t *zone_keys[DNS_MAXZONEKEYS];
+	zonesigner_t signer = { .jobs = NULL };
 	bool check_ksk, keyset_kskonly = false;
 	isc_result_t result;
 	isc_stdtime_t now, inception, soaexpire, expire, fullexpire, stop;
@@ -7377,6 +9918,8 @@ zone_resigninc(dns_zone_t *zone) {
 		goto failure;
 	}
 
+	signer_init(&signer, zone, db, version, zonediff.diff, zone->mctx);
+
 	isc_stdtime_get(&now);
 
 	result = dns__zone_findkeys(zone, db, version, now, zone->mctx,
@@ -7468,18 +10011,34 @@ zone_resigninc(dns_zone_t *zone) {
 		 * re-signing window, otherwise only add a small amount
 		 * of jitter.
 		 */
-		result = add_sigs(db, version, name, zone, covers,
-				  zonediff.diff, zone_keys, nkeys, zone->mctx,
-				  inception,
-				  resign > (now - 300) ? expire : fullexpire,
-				  check_ksk, keyset_kskonly);
+		result = queue_sigs(&signer, name, covers, zone_keys, nkeys,
+				    inception,
+				    resign > (now - 300) ? expire : fullexpire,
+				    check_ksk, keyset_kskonly);
 		if (result != ISC_R_SUCCESS) {
 			dns_zone_log(zone, ISC_LOG_ERROR,
 				     "zone_resigninc:add_sigs -> %s",
 				     isc_result_totext(result));
 			break;
 		}
-		result = dns_db_getsigningtime(db, &rdataset, name);
+		result = dns_db_getsigningtime(db, &rdataset, name);
+		if (result == ISC_R_SUCCESS &&
+		    signer_pending(&signer, name, rdataset.covers))
+		{
+			/*
+			 * The RRset is still due because its new
+			 * signatures have not been added yet.
+			 */
+			dns_rdataset_disassociate(&rdataset);
+			result = signer_flush(&signer);
+			if (result != ISC_R_SUCCESS) {
+				dns_zone_log(zone, ISC_LOG_ERROR,
+					     "zone_resigninc:add_sigs -> %s",
+					     isc_result_totext(result));
+				break;
+			}
+			result = dns_db_getsigningtime(db, &rdataset, name);
+		}
 		if (nkeys == 0 && result == ISC_R_NOTFOUND) {
 			result = ISC_R_SUCCESS;
 			break;
@@ -7496,6 +10055,14 @@ zone_resigninc(dns_zone_t *zone) {
 		goto failure;
 	}
 
+	result = signer_flush(&signer);
+	if (result != ISC_R_SUCCESS) {
+		dns_zone_log(zone, ISC_LOG_ERROR,
+			     "zone_resigninc:add_sigs -> %s",
+			     isc_result_totext(result));
+		goto failure;
+	}
+
 	result = del_sigs(zone, db, version, &zone->origin, dns_rdatatype_soa,
 			  &zonediff, zone_keys, nkeys, now, true);
 	if (result != ISC_R_SUCCESS) {
@@ -7549,6 +10116,7 @@ zone_resigninc(dns_zone_t *zone) {
 	dns_db_closeversion(db, &version, true);
 
 failure:
+	signer_invalidate(&signer);
 	dns_diff_clear(&_sig_diff);
 	for (i = 0; i < nkeys; i++) {
 		dst_key_free(&zone_keys[i]);
@@ -7771,15 +10339,10 @@ sign_a_node(dns_db_t *db, dns_zone_t *zone, dns_name_t *name,
 	    bool build_nsec, dst_key_t *key, isc_stdtime_t inception,
 	    isc_stdtime_t expire, dns_ttl_t nsecttl, bool is_ksk, bool is_zsk,
 	    bool keyset_kskonly, bool is_bottom_of_zone, dns_diff_t *diff,
-	    int32_t *signatures, isc_mem_t *mctx) {
+	    zonesigner_t *signer, int32_t *signatures) {
 	isc_result_t result;
 	dns_rdatasetiter_t *iterator = NULL;
 	dns_rdataset_t rdataset;
-	dns_rdata_t rdata = DNS_RDATA_INIT;
-	dns_stats_t *dnssecsignstats;
-
-	isc_buffer_t buffer;
-	unsigned char data[1024];
 	bool seen_soa, seen_ns, seen_rr, seen_nsec, seen_nsec3, seen_ds;
 
 	result = dns_db_allrdatasets(db, node, version, 0, &iterator);
@@ -7791,7 +10354,6 @@ sign_a_node(dns_db_t *db, dns_zone_t *zone, dns_name_t *name,
 	}
 
 	dns_rdataset_init(&rdataset);
-	isc_buffer_init(&buffer, data, sizeof(data));
 	seen_rr = seen_soa = seen_ns = seen_nsec = seen_nsec3 = seen_ds = false;
 	for (result = dns_rdatasetiter_first(iterator); result == ISC_R_SUCCESS;
 	     result = dns_rdatasetiter_next(iterator))
@@ -7884,27 +10446,8 @@ sign_a_node(dns_db_t *db, dns_zone_t *zone, dns_name_t *name,
 		}
 
 		/* Calculate the signature, creating a RRSIG RDATA. */
-		isc_buffer_clear(&buffer);
-		CHECK(dns_dnssec_sign(name, &rdataset, key, &inception, &expire,
-				      mctx, &buffer, &rdata));
-		/* Update the database and journal with the RRSIG. */
-		/* XXX inefficient - will cause dataset merging */
-		CHECK(update_one_rr(db, version, diff, DNS_DIFFOP_ADDRESIGN,
-				    name, rdataset.ttl, &rdata));
-		dns_rdata_reset(&rdata);
-
-		/* Update DNSSEC sign statistics. */
-		dnssecsignstats = dns_zone_getdnssecsignstats(zone);
-		if (dnssecsignstats != NULL) {
-			/* Generated a new signature. */
-			dns_dnssecsignstats_increment(dnssecsignstats, ID(key),
-						      ALG(key),
-						      dns_dnssecsignstats_sign);
-			/* This is a refresh. */
-			dns_dnssecsignstats_increment(
-				dnssecsignstats, ID(key), ALG(key),
-				dns_dnssecsignstats_refresh);
-		}
+		CHECK(signer_add(signer, name, &rdataset, key, inception,
+				 expire));
 
 		(*signatures)--;
 	next_rdataset:
@@ -8443,6 +10986,9 @@ dns__zone_updatesigs(dns_diff_t *diff, dns_db_t *db, dns_dbversion_t *version,
 		     dns__zonediff_t *zonediff) {
 	dns_difftuple_t *tuple;
 	isc_result_t result;
+	zonesigner_t signer;
+
+	signer_init(&signer, zone, db, version, zonediff->diff, zone->mctx);
 
 	while ((tuple = ISC_LIST_HEAD(diff->tuples)) != NULL) {
 		isc_stdtime_t exp = expire;
@@ -8462,17 +11008,16 @@ dns__zone_updatesigs(dns_diff_t *diff, dns_db_t *db, dns_dbversion_t *version,
 			dns_zone_log(zone, ISC_LOG_ERROR,
 				     "dns__zone_updatesigs:del_sigs -> %s",
 				     isc_result_totext(result));
-			return (result);
+			goto failure;
 		}
-		result = add_sigs(db, version, &tuple->name, zone,
-				  tuple->rdata.type, zonediff->diff, zone_keys,
-				  nkeys, zone->mctx, inception, exp, check_ksk,
-				  keyset_kskonly);
+		result = queue_sigs(&signer, &tuple->name, tuple->rdata.type,
+				    zone_keys, nkeys, inception, exp, check_ksk,
+				    keyset_kskonly);
 		if (result != ISC_R_SUCCESS) {
 			dns_zone_log(zone, ISC_LOG_ERROR,
 				     "dns__zone_updatesigs:add_sigs -> %s",
 				     isc_result_totext(result));
-			return (result);
+			goto failure;
 		}
 
 		/*
@@ -8484,7 +11029,21 @@ dns__zone_updatesigs(dns_diff_t *diff, dns_db_t *db, dns_dbversion_t *version,
 		 */
 		move_matching_tuples(tuple, diff, zonediff->diff);
 	}
-	return (ISC_R_SUCCESS);
+
+	/*
+	 * Each name and type is only visited once, so the signatures
+	 * can all be added at the end.
+	 */
+	result = signer_flush(&signer);
+	if (result != ISC_R_SUCCESS) {
+		dns_zone_log(zone, ISC_LOG_ERROR,
+			     "dns__zone_updatesigs:add_sigs -> %s",
+			     isc_result_totext(result));
+	}
+
+failure:
+	signer_invalidate(&signer);
+	return (result);
 }
 
 /*
@@ -9604,6 +12163,7 @@ zone_sign(dns_zone_t *zone) {
 	dns_signing_t *signing, *nextsigning;
 	dns_signinglist_t cleanup;
 	dst_key_t *zone_keys[DNS_MAXZONEKEYS];
+	zonesigner_t signer = { .jobs = NULL };
 	int32_t signatures;
 	bool check_ksk, keyset_kskonly, is_ksk, is_zsk;
 	bool with_ksk, with_zsk;
@@ -9656,6 +12216,8 @@ zone_sign(dns_zone_t *zone) {
 		goto cleanup;
 	}
 
+	signer_init(&signer, zone, db, version, zonediff.diff, zone->mctx);
+
 	isc_stdtime_get(&now);
 
 	result = dns__zone_findkeys(zone, db, version, now, zone->mctx,
@@ -9964,7 +12526,7 @@ zone_sign(dns_zone_t *zone) {
 				build_nsec, zone_keys[i], inception, expire,
 				zone_nsecttl(zone), is_ksk, is_zsk,
 				(both && keyset_kskonly), is_bottom_of_zone,
-				zonediff.diff, &signatures, zone->mctx));
+				zonediff.diff, &signer, &signatures));
 			/*
 			 * If we are adding we are done.  Look for other keys
 			 * of the same algorithm if deleting.
@@ -10049,6 +12611,17 @@ zone_sign(dns_zone_t *zone) {
 		first = true;
 	}
 
+	/*
+	 * The NSEC and private records changed below may be at the same
+	 * names as the signatures still being generated.
+	 */
+	result = signer_flush(&signer);
+	if (result != ISC_R_SUCCESS) {
+		dnssec_log(zone, ISC_LOG_ERROR, "zone_sign:sign_a_node -> %s",
+			   isc_result_totext(result));
+		goto cleanup;
+	}
+
 	if (ISC_LIST_HEAD(post_diff.tuples) != NULL) {
 		result = dns__zone_updatesigs(&post_diff, db, version,
 					      zone_keys, nkeys, zone, inception,
@@ -10179,6 +12752,7 @@ cleanup:
 		signing = ISC_LIST_HEAD(cleanup);
 	}
 
+	signer_invalidate(&signer);
 	dns_diff_clear(&_sig_diff);
 
 	for (i = 0; i < nkeys; i++) {
@@ -11587,6 +14161,16 @@ zone_maintenance(dns_zone_t *zone) {
 	default:
 		break;
 	}
+
+	/*
+	 * Evict the database of an idle secondary zone from memory?
+	 */
+	if (zone->type == dns_zone_secondary) {
+		LOCK_ZONE(zone);
+		zone_evict(zone);
+		UNLOCK_ZONE(zone);
+	}
+
 	LOCK_ZONE(zone);
 	zone_settimer(zone, &now);
 	UNLOCK_ZONE(zone);
@@ -11792,6 +14376,7 @@ zone_journal_rollforward(dns_zone_t *zone, dns_db_t *db, bool *needdump,
 		options = 0;
 	}
 
+	zone_journal_flush(zone);
 	result = dns_journal_open(zone->mctx, zone->journal, DNS_JOURNAL_READ,
 				  &journal);
 	if (result == ISC_R_NOTFOUND) {
@@ -11852,6 +14437,71 @@ zone_journal_rollforward(dns_zone_t *zone, dns_db_t *db, bool *needdump,
 	}
 }
 
+static void
+zone_journal_compact_log(dns_zone_t *zone, isc_result_t result) {
+	switch (result) {
+	case ISC_R_SUCCESS:
+	case ISC_R_NOSPACE:
+	case ISC_R_NOTFOUND:
+	case ISC_R_CANCELED:
+		dns_zone_log(zone, ISC_LOG_DEBUG(3), "dns_journal_compact: %s",
+			     isc_result_totext(result));
+		break;
+	default:
+		dns_zone_log(zone, ISC_LOG_ERROR,
+			     "dns_journal_compact failed: %s",
+			     isc_result_totext(result));
+		break;
+	}
+}
+
+/*
+ * Copy the part of the journal to keep, in a worker thread.
+ */
+static void
+zone_journal_compact_work(void *arg) {
+	dns_zone_t *zone = arg;
+
+	zone->jcompactresult = dns_journal_compact_copy(zone->jcompact);
+}
+
+/*
+ * Complete the journal compaction in the zone's loop, where nothing
+ * else writes to the journal meanwhile.
+ */
+static void
+zone_journal_compact_done(void *arg) {
+	dns_zone_t *zone = arg;
+	dns_journalcompact_t *compact = NULL;
+	isc_result_t result;
+
+	INSIST(DNS_ZONE_VALID(zone));
+
+	LOCK_ZONE(zone);
+	compact = zone->jcompact;
+	result = zone->jcompactresult;
+	if (result == ISC_R_SUCCESS && zone->xfr != NULL) {
+		/*
+		 * The incoming transfer may be appending to the journal;
+		 * compact it again once the transfer is done.
+		 */
+		if (!DNS_ZONE_FLAG(zone, DNS_ZONEFLG_NEEDCOMPACT)) {
+			DNS_ZONE_SETFLAG(zone, DNS_ZONEFLG_NEEDCOMPACT);
+			zone->compact_serial = zone->jcompactserial;
+		}
+		result = ISC_R_CANCELED;
+	} else if (result == ISC_R_SUCCESS) {
+		zone_journal_flush(zone);
+		result = dns_journal_compact_commit(compact);
+	}
+	zone_journal_compact_log(zone, result);
+	zone->jcompact = NULL;
+	UNLOCK_ZONE(zone);
+
+	dns_journal_compact_destroy(&compact);
+	dns_zone_idetach(&zone);
+}
+
 static void
 zone_journal_compact(dns_zone_t *zone, dns_db_t *db, uint32_t serial) {
 	isc_result_t result;
@@ -11881,6 +14531,14 @@ zone_journal_compact(dns_zone_t *zone, dns_db_t *db, uint32_t serial) {
 		}
 	}
 	if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_FIXJOURNAL)) {
+		if (zone->jcompact != NULL) {
+			/*
+			 * The next compaction will repair the journal.
+			 */
+			zone_debuglog(zone, __func__, 1,
+				      "journal compaction in progress");
+			return;
+		}
 		options |= DNS_JOURNAL_COMPACTALL;
 		DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_FIXJOURNAL);
 		zone_debuglog(zone, __func__, 1, "repair full journal");
@@ -11888,21 +14546,33 @@ zone_journal_compact(dns_zone_t *zone, dns_db_t *db, uint32_t serial) {
 		zone_debuglog(zone, __func__, 1, "target journal size %d",
 			      journalsize);
 	}
+
+	if (options == 0 && zone->loop != NULL) {
+		dns_zone_t *dummy = NULL;
+
+		if (zone->jcompact != NULL) {
+			zone_debuglog(zone, __func__, 1,
+				      "journal compaction in progress");
+			return;
+		}
+
+		/*
+		 * Copy the journal in the background, so that updates
+		 * don't have to wait for it.
+		 */
+		dns_journal_compact_create(zone->mctx, zone->journal, serial,
+					   journalsize, &zone->jcompact);
+		zone->jcompactserial = serial;
+		zone_iattach(zone, &dummy);
+		isc_work_enqueue(zone->loop, zone_journal_compact_work,
+				 zone_journal_compact_done, zone);
+		return;
+	}
+
+	zone_journal_flush(zone);
 	result = dns_journal_compact(zone->mctx, zone->journal, serial, options,
 				     journalsize);
-	switch (result) {
-	case ISC_R_SUCCESS:
-	case ISC_R_NOSPACE:
-	case ISC_R_NOTFOUND:
-		dns_zone_log(zone, ISC_LOG_DEBUG(3), "dns_journal_compact: %s",
-			     isc_result_totext(result));
-		break;
-	default:
-		dns_zone_log(zone, ISC_LOG_ERROR,
-			     "dns_journal_compact failed: %s",
-			     isc_result_totext(result));
-		break;
-	}
+	zone_journal_compact_log(zone, result);
 }
 
 isc_result_t
@@ -12097,6 +14767,16 @@ dump_done(void *arg, isc_result_t result) {
 	if (zone->dctx != NULL) {
 		dns_dumpctx_detach(&zone->dctx);
 	}
+	if (result == ISC_R_SUCCESS && zone->writeio != NULL &&
+	    zone->masterfile != NULL)
+	{
+		off_t size = 0;
+		if (isc_file_getsize(zone->masterfile, &size) ==
+		    ISC_R_SUCCESS)
+		{
+			zonemgr_dumpdone(zone->zmgr, (uint64_t)size, false);
+		}
+	}
 	zonemgr_putio(&zone->writeio);
 	UNLOCK_ZONE(zone);
 	if (again) {
@@ -12105,6 +14785,22 @@ dump_done(void *arg, isc_result_t result) {
 	dns_zone_idetach(&zone);
 }
 
+/*
+ * Where in the zone manager's dump queue a dump of 'zone' goes: flushes
+ * (the zone is going away) first, then the zones whose journal is
+ * compacted after the dump, then everything else.
+ */
+static unsigned int
+zone_dumppriority(dns_zone_t *zone) {
+	if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_FLUSH)) {
+		return (ZONEDUMP_FLUSH);
+	}
+	if (zone->type == dns_zone_primary || zone->type == dns_zone_key) {
+		return (ZONEDUMP_PRIMARY);
+	}
+	return (ZONEDUMP_OTHER);
+}
+
 static isc_result_t
 zone_dump(dns_zone_t *zone, bool compact) {
 	isc_result_t result;
@@ -12146,9 +14842,9 @@ redo:
 		dns_zone_t *dummy = NULL;
 		LOCK_ZONE(zone);
 		zone_iattach(zone, &dummy);
-		result = zonemgr_getio(zone->zmgr, false, zone->task,
-				       zone_gotwritehandle, zone,
-				       &zone->writeio);
+		result = zonemgr_getdump(zone->zmgr, zone_dumppriority(zone),
+					 zone->task, zone_gotwritehandle, zone,
+					 &zone->writeio);
 		if (result != ISC_R_SUCCESS) {
 			zone_idetach(&dummy);
 		} else {
@@ -12242,6 +14938,9 @@ dumptostream(dns_zone_t *zone, FILE *fd, const dns_master_style_t *style,
 		rawdata.flags = DNS_MASTERRAW_SOURCESERIALSET;
 		rawdata.sourceserial = zone->sourceserial;
 	}
+	if (rawversion == 1) {
+		rawdata.flags |= DNS_MASTERRAW_COMPAT1;
+	}
 	result = dns_master_dumptostream(zone->mctx, db, version, style, format,
 					 &rawdata, fd);
 	dns_db_closeversion(db, &version, false);
@@ -12284,6 +14983,9 @@ notify_cancel(dns_zone_t *zone) {
 		if (notify->request != NULL) {
 			dns_request_cancel(notify->request);
 		}
+		if (zonemgr_notifyunpark(notify)) {
+			notify_resume(notify, true);
+		}
 	}
 }
 
@@ -12403,6 +15105,20 @@ dns_zone_setmaxrecords(dns_zone_t *zone, uint32_t val) {
 	zone->maxrecords = val;
 }
 
+void
+dns_zone_setidletime(dns_zone_t *zone, uint32_t idletime) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	zone->idletime = idletime;
+}
+
+uint32_t
+dns_zone_getidletime(dns_zone_t *zone) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	return (zone->idletime);
+}
+
 static bool
 notify_isqueued(dns_zone_t *zone, unsigned int flags, dns_name_t *name,
 		isc_sockaddr_t *addr, dns_tsigkey_t *key,
@@ -12544,6 +15260,7 @@ notify_destroy(dns_notify_t *notify, bool locked) {
 	if (notify->transport != NULL) {
 		dns_transport_detach(&notify->transport);
 	}
+	zonemgr_notifyrelease(notify);
 	mctx = notify->mctx;
 	isc_mem_put(notify->mctx, notify, sizeof(*notify));
 	isc_mem_detach(&mctx);
@@ -12564,6 +15281,7 @@ notify_create(isc_mem_t *mctx, unsigned int flags, dns_notify_t **notifyp) {
 	isc_sockaddr_any(&notify->dst);
 	dns_name_init(&notify->ns, NULL);
 	ISC_LINK_INIT(notify, link);
+	ISC_LINK_INIT(notify, peerlink);
 	notify->magic = NOTIFY_MAGIC;
 	*notifyp = notify;
 	return (ISC_R_SUCCESS);
@@ -12709,6 +15427,16 @@ notify_send_toaddr(isc_task_t *task, isc_event_t *event) {
 		goto cleanup;
 	}
 
+	if (!zonemgr_notifyacquire(notify->zone->zmgr, notify)) {
+		isc_sockaddr_format(&notify->dst, addrbuf, sizeof(addrbuf));
+		notify_log(notify->zone, ISC_LOG_DEBUG(3),
+			   "notify: waiting for a slot to send to %s",
+			   addrbuf);
+		UNLOCK_ZONE(notify->zone);
+		isc_event_free(&event);
+		return;
+	}
+
 	result = notify_createmessage(notify->zone, notify->flags, &message);
 	if (result != ISC_R_SUCCESS) {
 		goto cleanup;
@@ -12800,6 +15528,7 @@ notify_send_toaddr(isc_task_t *task, isc_event_t *event) {
 			inc_stats(notify->zone,
 				  dns_zonestatscounter_notifyoutv6);
 		}
+		zonemgr_countsent(notify->zone->zmgr, &notify->dst, true);
 	}
 
 cleanup_key:
@@ -14339,12 +17068,10 @@ refresh_callback(isc_task_t *task, isc_event_t *event) {
 
 	serial = soa.serial;
 	if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADED)) {
-		unsigned int dbsoacount;
-		result = zone_get_from_db(zone, zone->db, NULL, &dbsoacount,
-					  NULL, &oldserial, NULL, NULL, NULL,
-					  NULL, NULL);
+		ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_read);
+		result = zone_loadedserial(zone, &oldserial);
+		ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_read);
 		RUNTIME_CHECK(result == ISC_R_SUCCESS);
-		RUNTIME_CHECK(dbsoacount > 0U);
 		zone_debuglog(zone, __func__, 1, "serial: new %u, old %u",
 			      serial, oldserial);
 	} else {
@@ -14457,60 +17184,278 @@ next_primary:
 				}
 			}
 		} else {
-			done = true;
-		}
-		if (!done) {
-			DNS_ZONE_SETFLAG(zone, DNS_ZONEFLG_USEALTXFRSRC);
-			zone->curprimary = 0;
-			/*
-			 * Find the next failed primary.
-			 */
-			while (zone->curprimary < zone->primariescnt &&
-			       zone->primariesok[zone->curprimary])
-			{
-				zone->curprimary++;
-			}
-			goto requeue;
-		}
-		DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_REFRESH);
-		if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_NEEDREFRESH)) {
-			DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_NEEDREFRESH);
-			zone->refreshtime = now;
+			done = true;
+		}
+		if (!done) {
+			DNS_ZONE_SETFLAG(zone, DNS_ZONEFLG_USEALTXFRSRC);
+			zone->curprimary = 0;
+			/*
+			 * Find the next failed primary.
+			 */
+			while (zone->curprimary < zone->primariescnt &&
+			       zone->primariesok[zone->curprimary])
+			{
+				zone->curprimary++;
+			}
+			goto requeue;
+		}
+		DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_REFRESH);
+		if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_NEEDREFRESH)) {
+			DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_NEEDREFRESH);
+			zone->refreshtime = now;
+		}
+		DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_USEALTXFRSRC);
+		zone_settimer(zone, &now);
+		goto detach;
+	}
+
+requeue:
+	queue_soa_query(zone);
+	goto detach;
+
+exiting:
+	isc_event_free(&event);
+	dns_request_destroy(&zone->request);
+	goto detach;
+
+same_primary:
+	if (msg != NULL) {
+		dns_message_detach(&msg);
+	}
+	isc_event_free(&event);
+	dns_request_destroy(&zone->request);
+	queue_soa_query(zone);
+
+detach:
+	UNLOCK_ZONE(zone);
+	if (do_queue_xfrin) {
+		queue_xfrin(zone);
+	}
+	dns_zone_idetach(&zone);
+	return;
+}
+
+/*
+ * Return the peer 'addr' of 'zmgr', creating it if needed.
+ *
+ * Requires zmgr->peerlock to be held.
+ */
+static dns_zonepeer_t *
+zonemgr_getpeer(dns_zonemgr_t *zmgr, const isc_sockaddr_t *addr) {
+	dns_zonepeer_t *peer = NULL;
+	isc_result_t result;
+
+	result = isc_ht_find(zmgr->peers, (const unsigned char *)&addr->type,
+			     addr->length, (void **)&peer);
+	if (result == ISC_R_SUCCESS) {
+		return (peer);
+	}
+
+	peer = isc_mem_get(zmgr->mctx, sizeof(*peer));
+	*peer = (dns_zonepeer_t){ .addr = *addr };
+	ISC_LIST_INIT(peer->refreshes);
+	ISC_LIST_INIT(peer->notifywait);
+	ISC_LINK_INIT(peer, link);
+
+	result = isc_ht_add(zmgr->peers,
+			    (const unsigned char *)&peer->addr.type,
+			    peer->addr.length, peer);
+	INSIST(result == ISC_R_SUCCESS);
+
+	return (peer);
+}
+
+static void
+zonemgr_countsent(dns_zonemgr_t *zmgr, const isc_sockaddr_t *addr,
+		  bool notify) {
+	dns_zonepeer_t *peer = NULL;
+
+	if (zmgr == NULL) {
+		return;
+	}
+
+	LOCK(&zmgr->peerlock);
+	peer = zonemgr_getpeer(zmgr, addr);
+	if (notify) {
+		peer->notifies++;
+	} else {
+		peer->soaqueries++;
+	}
+	UNLOCK(&zmgr->peerlock);
+}
+
+/*
+ * Take one of the NOTIFY_PEERMAX slots of the peer 'notify' is sent to,
+ * returning true if one was free or 'notify' already holds one.
+ * Otherwise 'notify' waits on the peer until zonemgr_notifyrelease()
+ * hands it the slot of another NOTIFY message and resumes it.  This
+ * keeps a primary from flooding one secondary with the NOTIFY messages
+ * of all its zones at once, while those to other peers go out at the
+ * notify rate.
+ *
+ * Requires the zone of 'notify' to be locked.
+ */
+static bool
+zonemgr_notifyacquire(dns_zonemgr_t *zmgr, dns_notify_t *notify) {
+	bool acquired = true;
+
+	if (zmgr == NULL) {
+		return (true);
+	}
+
+	LOCK(&zmgr->peerlock);
+	if (notify->paced) {
+		UNLOCK(&zmgr->peerlock);
+		return (true);
+	}
+	if (notify->zmgr == NULL) {
+		dns_zonemgr_attach(zmgr, &notify->zmgr);
+		notify->peer = zonemgr_getpeer(zmgr, &notify->dst);
+	}
+	if (notify->peer->notifying < NOTIFY_PEERMAX) {
+		notify->peer->notifying++;
+		notify->paced = true;
+	} else {
+		ISC_LIST_APPEND(notify->peer->notifywait, notify, peerlink);
+		acquired = false;
+	}
+	UNLOCK(&zmgr->peerlock);
+
+	return (acquired);
+}
+
+/*
+ * Stop 'notify' from waiting for a slot, returning true if it was
+ * waiting: the caller then has to resume it.
+ */
+static bool
+zonemgr_notifyunpark(dns_notify_t *notify) {
+	dns_zonemgr_t *zmgr = notify->zmgr;
+	bool parked = false;
+
+	if (zmgr == NULL) {
+		return (false);
+	}
+
+	LOCK(&zmgr->peerlock);
+	if (ISC_LINK_LINKED(notify, peerlink)) {
+		ISC_LIST_UNLINK(notify->peer->notifywait, notify, peerlink);
+		parked = true;
+	}
+	UNLOCK(&zmgr->peerlock);
+
+	return (parked);
+}
+
+/*
+ * 'notify' is done with: give its slot, if any, to the next NOTIFY
+ * message waiting on the peer.
+ */
+static void
+zonemgr_notifyrelease(dns_notify_t *notify) {
+	dns_zonemgr_t *zmgr = notify->zmgr;
+	dns_zonepeer_t *peer = notify->peer;
+	dns_notify_t *next = NULL;
+
+	if (zmgr == NULL) {
+		return;
+	}
+
+	LOCK(&zmgr->peerlock);
+	if (ISC_LINK_LINKED(notify, peerlink)) {
+		ISC_LIST_UNLINK(peer->notifywait, notify, peerlink);
+	} else if (notify->paced) {
+		notify->paced = false;
+		next = ISC_LIST_HEAD(peer->notifywait);
+		if (next != NULL) {
+			ISC_LIST_UNLINK(peer->notifywait, next, peerlink);
+			next->paced = true;
+		} else {
+			INSIST(peer->notifying > 0);
+			peer->notifying--;
 		}
-		DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_USEALTXFRSRC);
-		zone_settimer(zone, &now);
-		goto detach;
 	}
+	notify->peer = NULL;
+	UNLOCK(&zmgr->peerlock);
 
-requeue:
-	queue_soa_query(zone);
-	goto detach;
+	if (next != NULL) {
+		notify_resume(next, false);
+	}
+	dns_zonemgr_detach(&notify->zmgr);
+}
 
-exiting:
-	isc_event_free(&event);
-	dns_request_destroy(&zone->request);
-	goto detach;
+/*
+ * Send 'notify', which was waiting for a slot, again to its zone's task.
+ */
+static void
+notify_resume(dns_notify_t *notify, bool canceled) {
+	isc_event_t *e = NULL;
 
-same_primary:
-	if (msg != NULL) {
-		dns_message_detach(&msg);
+	e = isc_event_allocate(notify->mctx, NULL, DNS_EVENT_NOTIFYSENDTOADDR,
+			       notify_send_toaddr, notify, sizeof(isc_event_t));
+	if (canceled) {
+		e->ev_attributes |= ISC_EVENTATTR_CANCELED;
 	}
-	isc_event_free(&event);
-	dns_request_destroy(&zone->request);
-	queue_soa_query(zone);
+	isc_task_send(notify->zone->task, &e);
+}
 
-detach:
-	UNLOCK_ZONE(zone);
-	if (do_queue_xfrin) {
-		queue_xfrin(zone);
+/*
+ * A slot of the refresh rate limiter is free: send the SOA query of the
+ * next zone waiting for one.  The queries of a peer are sent in a row,
+ * up to REFRESH_BATCH of them, so that those sent over TCP share a
+ * connection rather than each opening its own; then the peer goes to
+ * the back of the queue.  The slot may be that of another zone, as
+ * every zone waiting holds one slot.
+ */
+static void
+zonemgr_refresh(isc_task_t *task, isc_event_t *event) {
+	struct refresh_event *rev = (struct refresh_event *)event;
+	dns_zonemgr_t *zmgr = rev->zmgr;
+	dns_zone_t *zone = event->ev_arg;
+	dns_zone_t *next = NULL;
+	dns_zonepeer_t *peer = NULL;
+	isc_event_t *e = NULL;
+
+	UNUSED(task);
+
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+
+	LOCK(&zmgr->peerlock);
+	peer = ISC_LIST_HEAD(zmgr->refreshpeers);
+	INSIST(peer != NULL);
+	next = ISC_LIST_HEAD(peer->refreshes);
+	INSIST(next != NULL);
+	ISC_LIST_UNLINK(peer->refreshes, next, refreshlink);
+	peer->queued--;
+	if (ISC_LIST_EMPTY(peer->refreshes)) {
+		ISC_LIST_UNLINK(zmgr->refreshpeers, peer, link);
+		peer->batch = 0;
+	} else if (++peer->batch >= REFRESH_BATCH) {
+		ISC_LIST_UNLINK(zmgr->refreshpeers, peer, link);
+		ISC_LIST_APPEND(zmgr->refreshpeers, peer, link);
+		peer->batch = 0;
 	}
+	UNLOCK(&zmgr->peerlock);
+
+	/*
+	 * The reference to 'next' held by the queue goes with the event.
+	 */
+	e = isc_event_allocate(next->mctx, NULL, DNS_EVENT_ZONE, soa_query,
+			       next, sizeof(isc_event_t));
+	e->ev_attributes |= (event->ev_attributes & ISC_EVENTATTR_CANCELED);
+	isc_task_send(next->task, &e);
+
+	isc_event_free(&event);
+	dns_zonemgr_detach(&zmgr);
 	dns_zone_idetach(&zone);
-	return;
 }
 
 static void
 queue_soa_query(dns_zone_t *zone) {
-	isc_event_t *e;
+	struct refresh_event *rev = NULL;
+	isc_event_t *e = NULL;
+	dns_zonemgr_t *zmgr = zone->zmgr;
+	dns_zonepeer_t *peer = NULL;
 	dns_zone_t *dummy = NULL;
 	isc_result_t result;
 
@@ -14525,19 +17470,41 @@ queue_soa_query(dns_zone_t *zone) {
 		return;
 	}
 
-	e = isc_event_allocate(zone->mctx, NULL, DNS_EVENT_ZONE, soa_query,
-			       zone, sizeof(isc_event_t));
+	/*
+	 * The zone is already waiting for its SOA query.
+	 */
+	if (ISC_LINK_LINKED(zone, refreshlink)) {
+		return;
+	}
+
+	e = isc_event_allocate(zone->mctx, NULL, DNS_EVENT_ZONE,
+			       zonemgr_refresh, zone, sizeof(*rev));
+	rev = (struct refresh_event *)e;
+	rev->zmgr = NULL;
 
 	/*
-	 * Attach so that we won't clean up
-	 * until the event is delivered.
+	 * Attach so that we won't clean up until the event is
+	 * delivered: once for the slot, and once for the queue.
 	 */
 	zone_iattach(zone, &dummy);
+	dns_zonemgr_attach(zmgr, &rev->zmgr);
+
+	LOCK(&zmgr->peerlock);
+	result = isc_ratelimiter_enqueue(zmgr->refreshrl, zone->task, &e);
+	if (result == ISC_R_SUCCESS) {
+		peer = zonemgr_getpeer(zmgr,
+				       &zone->primaries[zone->curprimary]);
+		ISC_LIST_APPEND(peer->refreshes, zone, refreshlink);
+		peer->queued++;
+		if (!ISC_LINK_LINKED(peer, link)) {
+			ISC_LIST_APPEND(zmgr->refreshpeers, peer, link);
+		}
+		zone_iattach(zone, &(dns_zone_t *){ NULL });
+	}
+	UNLOCK(&zmgr->peerlock);
 
-	e->ev_arg = zone;
-	e->ev_sender = NULL;
-	result = isc_ratelimiter_enqueue(zone->zmgr->refreshrl, zone->task, &e);
 	if (result != ISC_R_SUCCESS) {
+		dns_zonemgr_detach(&rev->zmgr);
 		zone_idetach(&dummy);
 		isc_event_free(&e);
 		cancel_refresh(zone);
@@ -14755,6 +17722,7 @@ again:
 		} else {
 			inc_stats(zone, dns_zonestatscounter_soaoutv6);
 		}
+		zonemgr_countsent(zone->zmgr, &zone->primaryaddr, false);
 	}
 	cancel = false;
 cleanup:
@@ -15316,6 +18284,18 @@ zone_settimer(dns_zone_t *zone, isc_time_t *now) {
 				next = zone->expiretime;
 			}
 		}
+		if (zone_canevict(zone)) {
+			isc_time_t evicttime;
+
+			isc_time_set(&evicttime,
+				     atomic_load_relaxed(&zone->lastused) +
+					     zone->idletime,
+				     0);
+			if (isc_time_isepoch(&next) ||
+			    isc_time_compare(&evicttime, &next) < 0) {
+				next = evicttime;
+			}
+		}
 		if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_NEEDDUMP) &&
 		    !DNS_ZONE_FLAG(zone, DNS_ZONEFLG_DUMPING))
 		{
@@ -15429,10 +18409,10 @@ notify_createmessage(dns_zone_t *zone, unsigned int flags,
 	dns_message_gettemprdataset(message, &temprdataset);
 	dns_message_gettemprdatalist(message, &temprdatalist);
 
-	ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_read);
-	INSIST(zone->db != NULL); /* XXXJT: is this assumption correct? */
-	dns_db_attach(zone->db, &zonedb);
-	ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_read);
+	result = dns_zone_getdb(zone, &zonedb);
+	if (result != ISC_R_SUCCESS) {
+		goto soa_cleanup;
+	}
 
 	dns_name_clone(&zone->origin, tempname);
 	dns_db_currentversion(zonedb, &version);
@@ -15646,7 +18626,6 @@ dns_zone_notifyreceive(dns_zone_t *zone, isc_sockaddr_t *from,
 		}
 		if (result == ISC_R_SUCCESS) {
 			uint32_t oldserial;
-			unsigned int soacount;
 
 			dns_rdataset_current(rdataset, &rdata);
 			result = dns_rdata_tostruct(&rdata, &soa, NULL);
@@ -15654,14 +18633,13 @@ dns_zone_notifyreceive(dns_zone_t *zone, isc_sockaddr_t *from,
 			serial = soa.serial;
 			have_serial = true;
 			/*
-			 * The following should safely be performed without DB
-			 * lock and succeed in this context.
+			 * The database may have been evicted from memory, in
+			 * which case its serial is known nonetheless.
 			 */
-			result = zone_get_from_db(zone, zone->db, NULL,
-						  &soacount, NULL, &oldserial,
-						  NULL, NULL, NULL, NULL, NULL);
+			ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_read);
+			result = zone_loadedserial(zone, &oldserial);
+			ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_read);
 			RUNTIME_CHECK(result == ISC_R_SUCCESS);
-			RUNTIME_CHECK(soacount > 0U);
 			if (isc_serial_le(serial, oldserial)) {
 				dns_zone_log(zone, ISC_LOG_INFO,
 					     "notify from %s: "
@@ -15916,6 +18894,35 @@ dns_zone_setzeronosoattl(dns_zone_t *zone, bool state) {
 	zone->zero_no_soa_ttl = state;
 }
 
+void
+dns_zone_setanswercache(dns_zone_t *zone, bool state) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	LOCK_ZONE(zone);
+	if (zone->anscache != NULL) {
+		/*
+		 * The configuration that shaped the cached answers may
+		 * have changed.
+		 */
+		dns_anscache_flush(zone->anscache);
+	} else if (state) {
+		dns_anscache_create(zone->mctx, &zone->anscache);
+	}
+	dns_zone_setoption(zone, DNS_ZONEOPT_ANSWERCACHE, state);
+	UNLOCK_ZONE(zone);
+}
+
+dns_anscache_t *
+dns_zone_getanswercache(dns_zone_t *zone) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	if (!DNS_ZONE_OPTION(zone, DNS_ZONEOPT_ANSWERCACHE)) {
+		return (NULL);
+	}
+
+	return (zone->anscache);
+}
+
 void
 dns_zone_setchecknames(dns_zone_t *zone, dns_severity_t severity) {
 	REQUIRE(DNS_ZONE_VALID(zone));
@@ -16096,6 +19103,12 @@ dns_zone_logv(dns_zone_t *zone, isc_logcategory_t *category, int level,
 		zstr = "zone ";
 	}
 
+	if (zone_logcapture != NULL) {
+		zone_logcapture_add(zone, category, level, prefix, zstr,
+				    message);
+		return;
+	}
+
 	isc_log_write(dns_lctx, category, DNS_LOGMODULE_ZONE, level,
 		      "%s%s%s%s: %s", (prefix != NULL ? prefix : ""),
 		      (prefix != NULL ? ": " : ""), zstr, zone->strnamerd,
@@ -16603,6 +19616,8 @@ nextevent:
 		 * If that fails, then we'll fall back to a direct comparison
 		 * between raw and secure zones.
 		 */
+		zone_journal_flush(zone->rss_raw);
+		zone_journal_flush(zone);
 		CHECK(dns_journal_open(zone->rss_raw->mctx,
 				       zone->rss_raw->journal,
 				       DNS_JOURNAL_WRITE, &rjournal));
@@ -16704,6 +19719,7 @@ nextevent:
 	}
 
 	if (rjournal == NULL) {
+		zone_journal_flush(zone->rss_raw);
 		CHECK(dns_journal_open(zone->rss_raw->mctx,
 				       zone->rss_raw->journal,
 				       DNS_JOURNAL_WRITE, &rjournal));
@@ -17389,6 +20405,21 @@ zone_replacedb(dns_zone_t *zone, dns_db_t *db, bool dump) {
 		return (result);
 	}
 
+	if (zone->inplace != NULL && zone->inplace->db == db) {
+		/*
+		 * The zone was reloaded into a new version of the
+		 * database in use: make it the current version.
+		 */
+		INSIST(zone->db == db);
+		inplace_commit(zone->inplace);
+		if (zone->anscache != NULL) {
+			dns_anscache_flush(zone->anscache);
+		}
+		DNS_ZONE_SETFLAG(zone, DNS_ZONEFLG_LOADED |
+					       DNS_ZONEFLG_NEEDNOTIFY);
+		return (ISC_R_SUCCESS);
+	}
+
 	ver = NULL;
 	dns_db_currentversion(db, &ver);
 
@@ -17496,6 +20527,7 @@ zone_replacedb(dns_zone_t *zone, dns_db_t *db, bool dump) {
 			isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
 				      DNS_LOGMODULE_ZONE, ISC_LOG_DEBUG(3),
 				      "removing journal file");
+			zone_journal_flush(zone);
 			if (remove(zone->journal) < 0 && errno != ENOENT) {
 				char strbuf[ISC_STRERRORSIZE];
 				strerror_r(errno, strbuf, sizeof(strbuf));
@@ -17533,9 +20565,14 @@ fail:
 /* The caller must hold the dblock as a writer. */
 static void
 zone_attachdb(dns_zone_t *zone, dns_db_t *db) {
+	isc_stdtime_t now;
+
 	REQUIRE(zone->db == NULL && db != NULL);
 
 	dns_db_attach(db, &zone->db);
+
+	isc_stdtime_get(&now);
+	atomic_store_relaxed(&zone->lastused, now);
 }
 
 /* The caller must hold the dblock as a writer. */
@@ -17543,6 +20580,9 @@ static void
 zone_detachdb(dns_zone_t *zone) {
 	REQUIRE(zone->db != NULL);
 
+	if (zone->anscache != NULL) {
+		dns_anscache_flush(zone->anscache);
+	}
 	dns_db_detach(&zone->db);
 }
 
@@ -17860,7 +20900,13 @@ zone_loaddone(void *arg, isc_result_t result) {
 		dns_zone_catz_disable_db(zone, load->db);
 	}
 
-	tresult = dns_db_endload(load->db, &load->callbacks);
+	if (load->inplace == NULL) {
+		tresult = dns_db_endload(load->db, &load->callbacks);
+	} else if (result == ISC_R_SUCCESS || result == DNS_R_SEENINCLUDE) {
+		tresult = inplace_end(zone, load->inplace);
+	} else {
+		tresult = ISC_R_SUCCESS;
+	}
 	if (tresult != ISC_R_SUCCESS &&
 	    (result == ISC_R_SUCCESS || result == DNS_R_SEENINCLUDE))
 	{
@@ -17885,8 +20931,20 @@ again:
 			goto again;
 		}
 	}
+	zone->inplace = load->inplace;
 	(void)zone_postload(zone, load->db, load->loadtime, result);
+	zone->inplace = NULL;
+	if (load->inplace != NULL) {
+		/*
+		 * Roll the new version back unless it was committed.
+		 */
+		inplace_destroy(&load->inplace);
+	}
+	zone_sharedone(zone, load->db, load->loadtime, false);
 	zonemgr_putio(&zone->readio);
+	if (zone->loadzmgr != NULL) {
+		zone_putload(zone, &zone->loadzmgr, result);
+	}
 	DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_LOADING);
 	zone_idetach(&load->callbacks.zone);
 	/*
@@ -18037,6 +21095,7 @@ got_transfer_quota(isc_task_t *task, isc_event_t *event) {
 	isc_time_t now;
 	const char *soa_before = "";
 	isc_dscp_t dscp = -1;
+	dns_db_t *db = NULL;
 	bool loaded;
 
 	UNUSED(task);
@@ -18068,11 +21127,13 @@ got_transfer_quota(isc_task_t *task, isc_event_t *event) {
 		soa_before = "SOA before ";
 	}
 	/*
-	 * Decide whether we should request IXFR or AXFR.
+	 * Decide whether we should request IXFR or AXFR.  A database
+	 * evicted from memory is loaded back for IXFR to apply to.
 	 */
-	ZONEDB_LOCK(&zone->dblock, isc_rwlocktype_read);
-	loaded = (zone->db != NULL);
-	ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_read);
+	loaded = (dns_zone_getdb(zone, &db) == ISC_R_SUCCESS);
+	if (db != NULL) {
+		dns_db_detach(&db);
+	}
 
 	if (!loaded) {
 		dns_zone_logc(zone, DNS_LOGCATEGORY_XFER_IN, ISC_LOG_DEBUG(1),
@@ -18807,12 +21868,14 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr,
 		.taskmgr = taskmgr,
 		.netmgr = netmgr,
 		.workers = isc_loopmgr_nloops(loopmgr),
+		.ntasks = isc_loopmgr_nloops(loopmgr) * DNS_ZONEMGR_TASKSHARDS,
 		.transfersin = 10,
 		.transfersperns = 2,
 	};
 
 	isc_refcount_init(&zmgr->refs, 1);
 	isc_mem_attach(mctx, &zmgr->mctx);
+	atomic_init(&zmgr->nextshard, 0);
 
 	ISC_LIST_INIT(zmgr->zones);
 	ISC_LIST_INIT(zmgr->waiting_for_xfrin);
@@ -18856,11 +21919,15 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr,
 		goto free_startupnotifyrl;
 	}
 
+	/*
+	 * Task 'i' runs on loop 'i / DNS_ZONEMGR_TASKSHARDS'.
+	 */
 	zmgr->zonetasks = isc_mem_get(
-		zmgr->mctx, zmgr->workers * sizeof(zmgr->zonetasks[0]));
-	memset(zmgr->zonetasks, 0, zmgr->workers * sizeof(zmgr->zonetasks[0]));
-	for (size_t i = 0; i < zmgr->workers; i++) {
-		result = isc_task_create(zmgr->taskmgr, &zmgr->zonetasks[i], i);
+		zmgr->mctx, zmgr->ntasks * sizeof(zmgr->zonetasks[0]));
+	memset(zmgr->zonetasks, 0, zmgr->ntasks * sizeof(zmgr->zonetasks[0]));
+	for (size_t i = 0; i < zmgr->ntasks; i++) {
+		result = isc_task_create(zmgr->taskmgr, &zmgr->zonetasks[i],
+					 i / DNS_ZONEMGR_TASKSHARDS);
 		INSIST(result == ISC_R_SUCCESS);
 		if (result != ISC_R_SUCCESS) {
 			INSIST(result == ISC_R_SUCCESS);
@@ -18870,10 +21937,11 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr,
 	}
 
 	zmgr->loadtasks = isc_mem_get(
-		zmgr->mctx, zmgr->workers * sizeof(zmgr->loadtasks[0]));
-	memset(zmgr->loadtasks, 0, zmgr->workers * sizeof(zmgr->loadtasks[0]));
-	for (size_t i = 0; i < zmgr->workers; i++) {
-		result = isc_task_create(zmgr->taskmgr, &zmgr->loadtasks[i], i);
+		zmgr->mctx, zmgr->ntasks * sizeof(zmgr->loadtasks[0]));
+	memset(zmgr->loadtasks, 0, zmgr->ntasks * sizeof(zmgr->loadtasks[0]));
+	for (size_t i = 0; i < zmgr->ntasks; i++) {
+		result = isc_task_create(zmgr->taskmgr, &zmgr->loadtasks[i],
+					 i / DNS_ZONEMGR_TASKSHARDS);
 		INSIST(result == ISC_R_SUCCESS);
 		if (result != ISC_R_SUCCESS) {
 			goto free_loadtasks;
@@ -18885,13 +21953,16 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr,
 				     zmgr->workers * sizeof(zmgr->mctxpool[0]));
 	memset(zmgr->mctxpool, 0, zmgr->workers * sizeof(zmgr->mctxpool[0]));
 	for (size_t i = 0; i < zmgr->workers; i++) {
-		isc_mem_create(&zmgr->mctxpool[i]);
+		isc_mem_create_arena(&zmgr->mctxpool[i]);
 		isc_mem_setname(zmgr->mctxpool[i], "zonemgr-mctxpool");
 	}
 
 	/* Key file I/O locks. */
 	zonemgr_keymgmt_init(zmgr);
 
+	/* Spare keys for rollovers; none are kept until it is configured. */
+	dns_keypool_create(zmgr->mctx, loopmgr, 0, &zmgr->keypool);
+
 	/* Default to 20 refresh queries / notifies / checkds per second. */
 	setrl(zmgr->checkdsrl, &zmgr->checkdsrate, 20);
 	setrl(zmgr->notifyrl, &zmgr->notifyrate, 20);
@@ -18908,6 +21979,28 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr,
 
 	isc_mutex_init(&zmgr->iolock);
 
+	zmgr->dumplimit = UINT32_MAX;
+	for (size_t i = 0; i < ZONEDUMP_PRIORITIES; i++) {
+		ISC_LIST_INIT(zmgr->dumpqueue[i]);
+	}
+	isc_mutex_init(&zmgr->dumplock);
+
+	zmgr->loadlimit = UINT32_MAX;
+	for (size_t i = 0; i < ZONELOAD_PRIORITIES; i++) {
+		ISC_LIST_INIT(zmgr->loadqueue[i]);
+	}
+	isc_time_settoepoch(&zmgr->loadrunstart);
+	isc_time_settoepoch(&zmgr->loadrunend);
+
+	isc_mutex_init(&zmgr->loadlock);
+
+	isc_ht_init(&zmgr->peers, zmgr->mctx, 4, ISC_HT_CASE_SENSITIVE);
+	ISC_LIST_INIT(zmgr->refreshpeers);
+	isc_mutex_init(&zmgr->peerlock);
+
+	isc_ht_init(&zmgr->shareddbs, zmgr->mctx, 4, ISC_HT_CASE_SENSITIVE);
+	isc_mutex_init(&zmgr->sharelock);
+
 	zmgr->tlsctx_cache = NULL;
 
 	zmgr->magic = ZONEMGR_MAGIC;
@@ -18920,22 +22013,22 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr,
 	isc_mutex_destroy(&zmgr->iolock);
 #endif /* if 0 */
 free_loadtasks:
-	for (size_t i = 0; i < zmgr->workers; i++) {
+	for (size_t i = 0; i < zmgr->ntasks; i++) {
 		if (zmgr->loadtasks[i] != NULL) {
 			isc_task_detach(&zmgr->loadtasks[i]);
 		}
 	}
 	isc_mem_put(zmgr->mctx, zmgr->loadtasks,
-		    zmgr->workers * sizeof(zmgr->loadtasks[0]));
+		    zmgr->ntasks * sizeof(zmgr->loadtasks[0]));
 
 free_zonetasks:
-	for (size_t i = 0; i < zmgr->workers; i++) {
+	for (size_t i = 0; i < zmgr->ntasks; i++) {
 		if (zmgr->zonetasks[i] != NULL) {
 			isc_task_detach(&zmgr->zonetasks[i]);
 		}
 	}
 	isc_mem_put(zmgr->mctx, zmgr->zonetasks,
-		    zmgr->workers * sizeof(zmgr->zonetasks[0]));
+		    zmgr->ntasks * sizeof(zmgr->zonetasks[0]));
 
 	isc_ratelimiter_shutdown(zmgr->startuprefreshrl);
 	isc_ratelimiter_destroy(&zmgr->startuprefreshrl);
@@ -18991,6 +22084,8 @@ dns_zonemgr_createzone(dns_zonemgr_t *zmgr, dns_zone_t **zonep) {
 
 isc_result_t
 dns_zonemgr_managezone(dns_zonemgr_t *zmgr, dns_zone_t *zone) {
+	uint32_t shard;
+
 	REQUIRE(DNS_ZONE_VALID(zone));
 	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
 
@@ -19004,8 +22099,18 @@ dns_zonemgr_managezone(dns_zonemgr_t *zmgr, dns_zone_t *zone) {
 	REQUIRE(zone->timer == NULL);
 	REQUIRE(zone->zmgr == NULL);
 
-	isc_task_attach(zmgr->zonetasks[zone->tid], &zone->task);
-	isc_task_attach(zmgr->loadtasks[zone->tid], &zone->loadtask);
+	/*
+	 * The zone stays on its loop, and is given the tasks of one of
+	 * the shards of the loop in turn.
+	 */
+	shard = atomic_fetch_add_relaxed(&zmgr->nextshard, 1) %
+		DNS_ZONEMGR_TASKSHARDS;
+	isc_task_attach(
+		zmgr->zonetasks[zone->tid * DNS_ZONEMGR_TASKSHARDS + shard],
+		&zone->task);
+	isc_task_attach(
+		zmgr->loadtasks[zone->tid * DNS_ZONEMGR_TASKSHARDS + shard],
+		&zone->loadtask);
 
 	/*
 	 * Set the task name.  The tag will arbitrarily point to one
@@ -19037,6 +22142,8 @@ dns_zonemgr_managezone(dns_zonemgr_t *zmgr, dns_zone_t *zone) {
 
 void
 dns_zonemgr_releasezone(dns_zonemgr_t *zmgr, dns_zone_t *zone) {
+	dns_zonelist_t waiting;
+	isc_time_t loadtime;
 	bool free_now = false;
 
 	REQUIRE(DNS_ZONE_VALID(zone));
@@ -19050,6 +22157,15 @@ dns_zonemgr_releasezone(dns_zonemgr_t *zmgr, dns_zone_t *zone) {
 
 	zonemgr_keymgmt_delete(zmgr, zone);
 
+	ISC_LIST_INIT(waiting);
+	LOCK(&zmgr->sharelock);
+	if (zone->shareddb != NULL) {
+		zonemgr_deleteshared(zmgr, zone->shareddb, &waiting);
+	}
+	UNLOCK(&zmgr->sharelock);
+	isc_time_settoepoch(&loadtime);
+	zone_wakeshared(&waiting, NULL, loadtime);
+
 	zone->zmgr = NULL;
 
 	if (isc_refcount_decrement(&zmgr->refs) == 1) {
@@ -19139,15 +22255,23 @@ dns_zonemgr_shutdown(dns_zonemgr_t *zmgr) {
 	isc_ratelimiter_shutdown(zmgr->startupnotifyrl);
 	isc_ratelimiter_shutdown(zmgr->startuprefreshrl);
 
+	dns_keypool_shutdown(zmgr->keypool);
+
+	/*
+	 * Start the queued loads, so that the zones waiting for them are
+	 * released, and don't queue any more.
+	 */
+	dns_zonemgr_setloadlimit(zmgr, UINT32_MAX);
+
 	for (size_t i = 0; i < zmgr->workers; i++) {
 		isc_mem_detach(&zmgr->mctxpool[i]);
 	}
 
-	for (size_t i = 0; i < zmgr->workers; i++) {
+	for (size_t i = 0; i < zmgr->ntasks; i++) {
 		isc_task_detach(&zmgr->loadtasks[i]);
 	}
 
-	for (size_t i = 0; i < zmgr->workers; i++) {
+	for (size_t i = 0; i < zmgr->ntasks; i++) {
 		isc_task_detach(&zmgr->zonetasks[i]);
 	}
 
@@ -19164,24 +22288,53 @@ dns_zonemgr_shutdown(dns_zonemgr_t *zmgr) {
 
 static void
 zonemgr_free(dns_zonemgr_t *zmgr) {
+	isc_ht_iter_t *it = NULL;
+	isc_result_t result;
+
 	REQUIRE(ISC_LIST_EMPTY(zmgr->zones));
+	REQUIRE(ISC_LIST_EMPTY(zmgr->refreshpeers));
 
 	zmgr->magic = 0;
 
+	isc_ht_iter_create(zmgr->peers, &it);
+	for (result = isc_ht_iter_first(it); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_delcurrent_next(it))
+	{
+		dns_zonepeer_t *peer = NULL;
+		isc_ht_iter_current(it, (void **)&peer);
+		INSIST(ISC_LIST_EMPTY(peer->refreshes));
+		INSIST(ISC_LIST_EMPTY(peer->notifywait));
+		isc_mem_put(zmgr->mctx, peer, sizeof(*peer));
+	}
+	RUNTIME_CHECK(result == ISC_R_NOMORE);
+	isc_ht_iter_destroy(&it);
+	isc_ht_destroy(&zmgr->peers);
+	isc_mutex_destroy(&zmgr->peerlock);
+
+	/*
+	 * A shared database goes away with the zone loading it.
+	 */
+	INSIST(isc_ht_count(zmgr->shareddbs) == 0);
+	isc_ht_destroy(&zmgr->shareddbs);
+	isc_mutex_destroy(&zmgr->sharelock);
+
 	isc_refcount_destroy(&zmgr->refs);
 	isc_mutex_destroy(&zmgr->iolock);
+	isc_mutex_destroy(&zmgr->dumplock);
+	isc_mutex_destroy(&zmgr->loadlock);
 	isc_ratelimiter_destroy(&zmgr->checkdsrl);
 	isc_ratelimiter_destroy(&zmgr->notifyrl);
 	isc_ratelimiter_destroy(&zmgr->refreshrl);
 	isc_ratelimiter_destroy(&zmgr->startupnotifyrl);
 	isc_ratelimiter_destroy(&zmgr->startuprefreshrl);
+	dns_keypool_detach(&zmgr->keypool);
 
 	isc_mem_put(zmgr->mctx, zmgr->mctxpool,
 		    zmgr->workers * sizeof(zmgr->mctxpool[0]));
 	isc_mem_put(zmgr->mctx, zmgr->loadtasks,
-		    zmgr->workers * sizeof(zmgr->loadtasks[0]));
+		    zmgr->ntasks * sizeof(zmgr->loadtasks[0]));
 	isc_mem_put(zmgr->mctx, zmgr->zonetasks,
-		    zmgr->workers * sizeof(zmgr->zonetasks[0]));
+		    zmgr->ntasks * sizeof(zmgr->zonetasks[0]));
 
 	isc_rwlock_destroy(&zmgr->urlock);
 	isc_rwlock_destroy(&zmgr->rwlock);
@@ -19339,56 +22492,209 @@ zmgr_start_xfrin_ifquota(dns_zonemgr_t *zmgr, dns_zone_t *zone) {
 		isc_netaddr_fromsockaddr(&xip, &x->primaryaddr);
 		UNLOCK_ZONE(x);
 
-		nxfrsin++;
-		if (isc_netaddr_equal(&xip, &primaryip)) {
-			nxfrsperns++;
-		}
-	}
+		nxfrsin++;
+		if (isc_netaddr_equal(&xip, &primaryip)) {
+			nxfrsperns++;
+		}
+	}
+
+	/* Enforce quota. */
+	if (nxfrsin >= maxtransfersin) {
+		return (ISC_R_QUOTA);
+	}
+
+	if (nxfrsperns >= maxtransfersperns) {
+		return (ISC_R_QUOTA);
+	}
+
+gotquota:
+	/*
+	 * We have sufficient quota.  Move the zone to the "xfrin_in_progress"
+	 * list and send it an event to let it start the actual transfer in the
+	 * context of its own task.
+	 */
+	e = isc_event_allocate(zmgr->mctx, zmgr, DNS_EVENT_ZONESTARTXFRIN,
+			       got_transfer_quota, zone, sizeof(isc_event_t));
+
+	LOCK_ZONE(zone);
+	INSIST(zone->statelist == &zmgr->waiting_for_xfrin);
+	ISC_LIST_UNLINK(zmgr->waiting_for_xfrin, zone, statelink);
+	ISC_LIST_APPEND(zmgr->xfrin_in_progress, zone, statelink);
+	zone->statelist = &zmgr->xfrin_in_progress;
+	isc_task_send(zone->task, &e);
+	dns_zone_logc(zone, DNS_LOGCATEGORY_XFER_IN, ISC_LOG_INFO,
+		      "Transfer started.");
+	UNLOCK_ZONE(zone);
+
+	return (ISC_R_SUCCESS);
+}
+
+void
+dns_zonemgr_setiolimit(dns_zonemgr_t *zmgr, uint32_t iolimit) {
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+	REQUIRE(iolimit > 0);
+
+	zmgr->iolimit = iolimit;
+}
+
+uint32_t
+dns_zonemgr_getiolimit(dns_zonemgr_t *zmgr) {
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+
+	return (zmgr->iolimit);
+}
+
+void
+dns_zonemgr_setloadlimit(dns_zonemgr_t *zmgr, uint32_t loadlimit) {
+	dns_asyncload_t *next = NULL;
+	ISC_LIST(dns_asyncload_t) send;
+
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+	REQUIRE(loadlimit > 0);
+
+	ISC_LIST_INIT(send);
+
+	LOCK(&zmgr->loadlock);
+	zmgr->loadlimit = loadlimit;
+	for (size_t i = 0; i < ZONELOAD_PRIORITIES; i++) {
+		while (zmgr->loadactive < zmgr->loadlimit &&
+		       (next = HEAD(zmgr->loadqueue[i])) != NULL)
+		{
+			ISC_LIST_UNLINK(zmgr->loadqueue[i], next, link);
+			ISC_LIST_APPEND(send, next, link);
+			zmgr->loadpending--;
+			zmgr->loadactive++;
+		}
+	}
+	UNLOCK(&zmgr->loadlock);
+
+	while ((next = HEAD(send)) != NULL) {
+		ISC_LIST_UNLINK(send, next, link);
+		zonemgr_sendload(next);
+	}
+}
+
+uint32_t
+dns_zonemgr_getloadlimit(dns_zonemgr_t *zmgr) {
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+
+	return (zmgr->loadlimit);
+}
+
+void
+dns_zonemgr_setdumplimit(dns_zonemgr_t *zmgr, uint32_t dumplimit) {
+	dns_iolist_t send;
+
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+	REQUIRE(dumplimit > 0);
+
+	ISC_LIST_INIT(send);
 
-	/* Enforce quota. */
-	if (nxfrsin >= maxtransfersin) {
-		return (ISC_R_QUOTA);
-	}
+	LOCK(&zmgr->dumplock);
+	zmgr->dumplimit = dumplimit;
+	zonemgr_nextdumps(zmgr, &send);
+	UNLOCK(&zmgr->dumplock);
 
-	if (nxfrsperns >= maxtransfersperns) {
-		return (ISC_R_QUOTA);
-	}
+	zonemgr_senddumps(&send);
+}
 
-gotquota:
-	/*
-	 * We have sufficient quota.  Move the zone to the "xfrin_in_progress"
-	 * list and send it an event to let it start the actual transfer in the
-	 * context of its own task.
-	 */
-	e = isc_event_allocate(zmgr->mctx, zmgr, DNS_EVENT_ZONESTARTXFRIN,
-			       got_transfer_quota, zone, sizeof(isc_event_t));
+uint32_t
+dns_zonemgr_getdumplimit(dns_zonemgr_t *zmgr) {
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
 
-	LOCK_ZONE(zone);
-	INSIST(zone->statelist == &zmgr->waiting_for_xfrin);
-	ISC_LIST_UNLINK(zmgr->waiting_for_xfrin, zone, statelink);
-	ISC_LIST_APPEND(zmgr->xfrin_in_progress, zone, statelink);
-	zone->statelist = &zmgr->xfrin_in_progress;
-	isc_task_send(zone->task, &e);
-	dns_zone_logc(zone, DNS_LOGCATEGORY_XFER_IN, ISC_LOG_INFO,
-		      "Transfer started.");
-	UNLOCK_ZONE(zone);
+	return (zmgr->dumplimit);
+}
 
-	return (ISC_R_SUCCESS);
+void
+dns_zonemgr_getdumpstats(dns_zonemgr_t *zmgr, dns_zonemgr_dumpstats_t *stats) {
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+	REQUIRE(stats != NULL);
+
+	LOCK(&zmgr->dumplock);
+	stats->active = zmgr->dumpactive;
+	stats->queued = zmgr->dumpqueued;
+	stats->completed = zmgr->dumpcompleted;
+	stats->coalesced = zmgr->dumpcoalesced;
+	stats->bytes = zmgr->dumpbytes;
+	UNLOCK(&zmgr->dumplock);
 }
 
 void
-dns_zonemgr_setiolimit(dns_zonemgr_t *zmgr, uint32_t iolimit) {
+dns_zonemgr_setkeypooldepth(dns_zonemgr_t *zmgr, uint32_t depth) {
 	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
-	REQUIRE(iolimit > 0);
 
-	zmgr->iolimit = iolimit;
+	dns_keypool_setdepth(zmgr->keypool, depth);
 }
 
 uint32_t
-dns_zonemgr_getiolimit(dns_zonemgr_t *zmgr) {
+dns_zonemgr_getkeypooldepth(dns_zonemgr_t *zmgr) {
 	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
 
-	return (zmgr->iolimit);
+	return (dns_keypool_getdepth(zmgr->keypool));
+}
+
+void
+dns_zonemgr_dumpkeypool(dns_zonemgr_t *zmgr, dns_keypool_dump_t dump,
+			void *arg) {
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+	REQUIRE(dump != NULL);
+
+	dns_keypool_dump(zmgr->keypool, dump, arg);
+}
+
+void
+dns_zonemgr_dumppeers(dns_zonemgr_t *zmgr, dns_zonemgr_peerdump_t dump,
+		      void *arg) {
+	isc_ht_iter_t *it = NULL;
+	isc_result_t result;
+
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+	REQUIRE(dump != NULL);
+
+	LOCK(&zmgr->peerlock);
+	isc_ht_iter_create(zmgr->peers, &it);
+	for (result = isc_ht_iter_first(it); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_next(it))
+	{
+		dns_zonepeer_t *peer = NULL;
+		dns_zonemgr_peerstats_t stats;
+
+		isc_ht_iter_current(it, (void **)&peer);
+		stats = (dns_zonemgr_peerstats_t){
+			.addr = peer->addr,
+			.queued = peer->queued,
+			.soaqueries = peer->soaqueries,
+			.notifies = peer->notifies,
+		};
+		dump(&stats, arg);
+	}
+	RUNTIME_CHECK(result == ISC_R_NOMORE);
+	isc_ht_iter_destroy(&it);
+	UNLOCK(&zmgr->peerlock);
+}
+
+void
+dns_zonemgr_getloadstats(dns_zonemgr_t *zmgr, dns_zonemgr_loadstats_t *stats) {
+	isc_time_t end;
+	uint64_t usecs;
+
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+	REQUIRE(stats != NULL);
+
+	LOCK(&zmgr->loadlock);
+	stats->active = zmgr->loadactive;
+	stats->pending = zmgr->loadpending;
+	stats->completed = zmgr->loadcompleted;
+	stats->bytes = zmgr->loadbytes;
+	if (zmgr->loadactive != 0 || zmgr->loadpending != 0) {
+		TIME_NOW(&end);
+	} else {
+		end = zmgr->loadrunend;
+	}
+	usecs = isc_time_microdiff(&end, &zmgr->loadrunstart);
+	stats->rate = (usecs == 0) ? 0
+				   : zmgr->loadrunbytes * 1000000 / usecs;
+	UNLOCK(&zmgr->loadlock);
 }
 
 /*
@@ -19417,6 +22723,9 @@ zonemgr_getio(dns_zonemgr_t *zmgr, bool high, isc_task_t *task,
 
 	io->zmgr = zmgr;
 	io->high = high;
+	io->dump = false;
+	io->active = false;
+	io->priority = 0;
 	io->task = NULL;
 	isc_task_attach(task, &io->task);
 	ISC_LINK_INIT(io, link);
@@ -19456,6 +22765,10 @@ zonemgr_putio(dns_io_t **iop) {
 	INSIST(io->event == NULL);
 
 	zmgr = io->zmgr;
+	if (io->dump) {
+		zonemgr_putdump(io);
+		return;
+	}
 	isc_task_detach(&io->task);
 	io->magic = 0;
 	isc_mem_put(zmgr->mctx, io, sizeof(*io));
@@ -19487,6 +22800,11 @@ zonemgr_cancelio(dns_io_t *io) {
 
 	REQUIRE(DNS_IO_VALID(io));
 
+	if (io->dump) {
+		zonemgr_canceldump(io);
+		return;
+	}
+
 	/*
 	 * If we are queued to be run then dequeue.
 	 */
@@ -19508,6 +22826,224 @@ zonemgr_cancelio(dns_io_t *io) {
 	}
 }
 
+/*
+ * Get permission to dump a zone to its file.  At most 'dumplimit' dumps
+ * are in progress at the same time; the others are queued by priority
+ * (see ZONEDUMP_*).  An event will be sent to action when the dump may
+ * start.
+ *
+ * zonemgr_putio() must be called after the event is delivered to
+ * 'action'.
+ */
+static isc_result_t
+zonemgr_getdump(dns_zonemgr_t *zmgr, unsigned int priority,
+		isc_task_t *task, isc_taskaction_t action, void *arg,
+		dns_io_t **iop) {
+	dns_io_t *io = NULL;
+
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+	REQUIRE(priority < ZONEDUMP_PRIORITIES);
+	REQUIRE(iop != NULL && *iop == NULL);
+
+	io = isc_mem_get(zmgr->mctx, sizeof(*io));
+	*io = (dns_io_t){
+		.zmgr = zmgr,
+		.dump = true,
+		.priority = priority,
+		.magic = IO_MAGIC,
+	};
+	ISC_LINK_INIT(io, link);
+	io->event = isc_event_allocate(zmgr->mctx, task, DNS_EVENT_IOREADY,
+				       action, arg, sizeof(*io->event));
+	isc_task_attach(task, &io->task);
+
+	LOCK(&zmgr->dumplock);
+	if (zmgr->dumpactive < zmgr->dumplimit) {
+		zmgr->dumpactive++;
+		io->active = true;
+	} else {
+		ISC_LIST_APPEND(zmgr->dumpqueue[priority], io, link);
+		zmgr->dumpqueued++;
+	}
+	UNLOCK(&zmgr->dumplock);
+	*iop = io;
+
+	if (io->active) {
+		isc_task_send(io->task, &io->event);
+	}
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Take the next queued dumps off the queues of 'zmgr', while fewer than
+ * 'dumplimit' are in progress, and append them to 'send'.
+ *
+ * Requires zmgr->dumplock to be held.
+ */
+static void
+zonemgr_nextdumps(dns_zonemgr_t *zmgr, dns_iolist_t *send) {
+	dns_io_t *next = NULL;
+
+	for (size_t i = 0; i < ZONEDUMP_PRIORITIES; i++) {
+		while (zmgr->dumpactive < zmgr->dumplimit &&
+		       (next = HEAD(zmgr->dumpqueue[i])) != NULL)
+		{
+			ISC_LIST_UNLINK(zmgr->dumpqueue[i], next, link);
+			INSIST(next->event != NULL);
+			zmgr->dumpqueued--;
+			zmgr->dumpactive++;
+			next->active = true;
+			ISC_LIST_APPEND(*send, next, link);
+		}
+	}
+}
+
+static void
+zonemgr_senddumps(dns_iolist_t *send) {
+	dns_io_t *next = NULL;
+
+	while ((next = HEAD(*send)) != NULL) {
+		ISC_LIST_UNLINK(*send, next, link);
+		isc_task_send(next->task, &next->event);
+	}
+}
+
+/*
+ * The dump 'io' is finished: free its slot for the next queued dump.
+ */
+static void
+zonemgr_putdump(dns_io_t *io) {
+	dns_zonemgr_t *zmgr = io->zmgr;
+	dns_iolist_t send;
+
+	ISC_LIST_INIT(send);
+
+	LOCK(&zmgr->dumplock);
+	if (io->active) {
+		INSIST(zmgr->dumpactive > 0);
+		zmgr->dumpactive--;
+		zmgr->dumpcompleted++;
+	}
+	zonemgr_nextdumps(zmgr, &send);
+	UNLOCK(&zmgr->dumplock);
+
+	isc_task_detach(&io->task);
+	io->magic = 0;
+	isc_mem_put(zmgr->mctx, io, sizeof(*io));
+
+	zonemgr_senddumps(&send);
+}
+
+/*
+ * Cancel the dump 'io' if it is still queued.
+ */
+static void
+zonemgr_canceldump(dns_io_t *io) {
+	dns_zonemgr_t *zmgr = io->zmgr;
+	bool send_event = false;
+
+	LOCK(&zmgr->dumplock);
+	if (ISC_LINK_LINKED(io, link)) {
+		ISC_LIST_UNLINK(zmgr->dumpqueue[io->priority], io, link);
+		zmgr->dumpqueued--;
+		send_event = true;
+		INSIST(io->event != NULL);
+	}
+	UNLOCK(&zmgr->dumplock);
+	if (send_event) {
+		io->event->ev_attributes |= ISC_EVENTATTR_CANCELED;
+		isc_task_send(io->task, &io->event);
+	}
+}
+
+/*
+ * Account for a dump that wrote 'bytes' to disk, or that was made
+ * unnecessary by another dump of the same zone ('bytes' is then 0).
+ */
+static void
+zonemgr_dumpdone(dns_zonemgr_t *zmgr, uint64_t bytes, bool coalesced) {
+	LOCK(&zmgr->dumplock);
+	zmgr->dumpbytes += bytes;
+	if (coalesced) {
+		zmgr->dumpcoalesced++;
+	}
+	UNLOCK(&zmgr->dumplock);
+}
+
+static void
+zonemgr_sendload(dns_asyncload_t *asl) {
+	isc_event_t *e = NULL;
+
+	e = isc_event_allocate(asl->zmgr->mctx, asl->zmgr, DNS_EVENT_ZONELOAD,
+			       zone_asyncload, asl, sizeof(isc_event_t));
+	isc_task_send(asl->zone->loadtask, &e);
+}
+
+/*
+ * Start the load 'asl' if fewer than 'loadlimit' loads are in progress,
+ * otherwise queue it until zonemgr_putload() frees a slot.
+ */
+static void
+zonemgr_queueload(dns_zonemgr_t *zmgr, dns_asyncload_t *asl) {
+	bool send = false;
+
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+
+	LOCK(&zmgr->loadlock);
+	if (zmgr->loadactive == 0 && zmgr->loadpending == 0) {
+		TIME_NOW(&zmgr->loadrunstart);
+		zmgr->loadrunbytes = 0;
+	}
+	if (zmgr->loadactive < zmgr->loadlimit) {
+		zmgr->loadactive++;
+		send = true;
+	} else {
+		ISC_LIST_APPEND(zmgr->loadqueue[asl->priority], asl, link);
+		zmgr->loadpending++;
+	}
+	UNLOCK(&zmgr->loadlock);
+
+	if (send) {
+		zonemgr_sendload(asl);
+	}
+}
+
+/*
+ * Free the load slot held through '*zmgrp', accounting for the 'bytes'
+ * of zone file read, and start the next queued load.
+ */
+static void
+zonemgr_putload(dns_zonemgr_t **zmgrp, uint64_t bytes) {
+	dns_zonemgr_t *zmgr = *zmgrp;
+	dns_asyncload_t *next = NULL;
+
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+
+	LOCK(&zmgr->loadlock);
+	INSIST(zmgr->loadactive > 0);
+	zmgr->loadactive--;
+	zmgr->loadcompleted++;
+	zmgr->loadbytes += bytes;
+	zmgr->loadrunbytes += bytes;
+	for (size_t i = 0; next == NULL && i < ZONELOAD_PRIORITIES; i++) {
+		next = HEAD(zmgr->loadqueue[i]);
+		if (next != NULL) {
+			ISC_LIST_UNLINK(zmgr->loadqueue[i], next, link);
+			zmgr->loadpending--;
+			zmgr->loadactive++;
+		}
+	}
+	if (zmgr->loadactive == 0) {
+		TIME_NOW(&zmgr->loadrunend);
+	}
+	UNLOCK(&zmgr->loadlock);
+
+	if (next != NULL) {
+		zonemgr_sendload(next);
+	}
+	dns_zonemgr_detach(zmgrp);
+}
+
 static void
 zone_saveunique(dns_zone_t *zone, const char *path, const char *templat) {
 	char *buf;
@@ -19919,6 +23455,7 @@ dns_zone_setkeydirectory(dns_zone_t *zone, const char *directory) {
 
 	LOCK_ZONE(zone);
 	result = dns_zone_setstring(zone, &zone->keydirectory, directory);
+	clear_updatekeys(zone);
 	UNLOCK_ZONE(zone);
 
 	return (result);
@@ -20104,6 +23641,12 @@ dns_zone_setcheckns(dns_zone_t *zone, dns_checknsfunc_t checkns) {
 	zone->checkns = checkns;
 }
 
+void
+dns_zone_setloadthreads(dns_zone_t *zone, unsigned int nthreads) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+	zone->loadthreads = nthreads;
+}
+
 void
 dns_zone_setisself(dns_zone_t *zone, dns_isselffunc_t isself, void *arg) {
 	REQUIRE(DNS_ZONE_VALID(zone));
@@ -20203,6 +23746,22 @@ dns_zone_getsignatures(dns_zone_t *zone) {
 	return (zone->signatures);
 }
 
+void
+dns_zone_setsigningthreads(dns_zone_t *zone, uint32_t threads) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	if (threads == 0) {
+		threads = 1;
+	}
+	zone->signingthreads = threads;
+}
+
+uint32_t
+dns_zone_getsigningthreads(dns_zone_t *zone) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+	return (zone->signingthreads);
+}
+
 void
 dns_zone_setprivatetype(dns_zone_t *zone, dns_rdatatype_t type) {
 	REQUIRE(DNS_ZONE_VALID(zone));
@@ -21441,13 +25000,38 @@ zone_rekey(dns_zone_t *zone) {
 	dns_diff_init(mctx, &_sig_diff);
 	zonediff_init(&zonediff, &_sig_diff);
 
+	TIME_NOW(&timenow);
+	now = isc_time_seconds(&timenow);
+
+	/*
+	 * A periodic refresh with no key event due only needs to look
+	 * for changes on disk; skip reading the keys if there are none.
+	 */
+	LOCK_ZONE(zone);
+	if (keyfiles_unchanged(zone, now)) {
+		DNS_ZONE_TIME_ADD(&timenow, zone->refreshkeyinterval,
+				  &zone->refreshkeytime);
+		if (zone->keyfilesevent != 0 &&
+		    zone->keyfilesevent - now < zone->refreshkeyinterval)
+		{
+			DNS_ZONE_TIME_ADD(&timenow, zone->keyfilesevent - now,
+					  &zone->refreshkeytime);
+		}
+		zone->keyfilesrefresh = zone->refreshkeytime;
+		zone_settimer(zone, &timenow);
+		UNLOCK_ZONE(zone);
+
+		isc_time_formattimestamp(&zone->refreshkeytime, timebuf, 80);
+		dnssec_log(zone, ISC_LOG_DEBUG(3),
+			   "key files unchanged, next key check: %s", timebuf);
+		return;
+	}
+	UNLOCK_ZONE(zone);
+
 	CHECK(dns_zone_getdb(zone, &db));
 	CHECK(dns_db_newversion(db, &ver));
 	CHECK(dns_db_getoriginnode(db, &node));
 
-	TIME_NOW(&timenow);
-	now = isc_time_seconds(&timenow);
-
 	kasp = dns_zone_getkasp(zone);
 
 	dnssec_log(zone, ISC_LOG_INFO, "reconfiguring zone keys");
@@ -21535,10 +25119,16 @@ zone_rekey(dns_zone_t *zone) {
 		}
 
 		if (result == ISC_R_SUCCESS || result == ISC_R_NOTFOUND) {
+			dns_keypool_t *keypool = NULL;
+
+			if (zone->zmgr != NULL) {
+				keypool = zone->zmgr->keypool;
+			}
+
 			dns_zone_lock_keyfiles(zone);
 			result = dns_keymgr_run(&zone->origin, zone->rdclass,
 						dir, mctx, &keys, &dnskeys,
-						kasp, now, &nexttime);
+						kasp, keypool, now, &nexttime);
 			dns_zone_unlock_keyfiles(zone);
 
 			if (result != ISC_R_SUCCESS) {
@@ -21759,6 +25349,11 @@ zone_rekey(dns_zone_t *zone) {
 
 	LOCK_ZONE(zone);
 
+	/*
+	 * The key files may have changed.
+	 */
+	clear_updatekeys(zone);
+
 	if (commit) {
 		dns_difftuple_t *tuple;
 		dns_stats_t *dnssecsignstats =
@@ -21904,6 +25499,7 @@ zone_rekey(dns_zone_t *zone) {
 	}
 
 	isc_time_settoepoch(&zone->refreshkeytime);
+	clear_keyfiles(zone);
 
 	/*
 	 * If keymgr provided a next time, use the calculated next rekey time.
@@ -21931,6 +25527,8 @@ zone_rekey(dns_zone_t *zone) {
 		dnssec_log(zone, ISC_LOG_DEBUG(3),
 			   "next key event in %u seconds", nexttime_seconds);
 		dnssec_log(zone, ISC_LOG_INFO, "next key event: %s", timebuf);
+
+		record_keyfiles(zone, &keys, nexttime);
 	}
 	/*
 	 * If we're doing key maintenance, set the key refresh timer to
@@ -22307,6 +25905,21 @@ dns_zone_getadded(dns_zone_t *zone) {
 	return (zone->added);
 }
 
+void
+dns_zone_setcfghash(dns_zone_t *zone, uint64_t cfghash) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	LOCK_ZONE(zone);
+	zone->cfghash = cfghash;
+	UNLOCK_ZONE(zone);
+}
+
+uint64_t
+dns_zone_getcfghash(dns_zone_t *zone) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+	return (zone->cfghash);
+}
+
 isc_result_t
 dns_zone_dlzpostload(dns_zone_t *zone, dns_db_t *db) {
 	isc_time_t loadtime;
@@ -23306,6 +26919,48 @@ dns_zone_getloadtime(dns_zone_t *zone, isc_time_t *loadtime) {
 	return (ISC_R_SUCCESS);
 }
 
+uint64_t
+dns_zone_getloadduration(dns_zone_t *zone) {
+	uint64_t usecs;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	LOCK_ZONE(zone);
+	usecs = zone->loadusecs;
+	UNLOCK_ZONE(zone);
+	return (usecs);
+}
+
+isc_result_t
+dns_zone_getmemory(dns_zone_t *zone, dns_dbmemory_t *memory,
+		   size_t *journalp) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(memory != NULL);
+	REQUIRE(journalp != NULL);
+
+	result = dns_zone_getdb(zone, &db);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	result = dns_db_getmemory(db, memory);
+	dns_db_detach(&db);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	*journalp = 0;
+	LOCK(&zone->jsynclock);
+	if (zone->jsyncjournal != NULL) {
+		*journalp = dns_journal_inuse(zone->jsyncjournal);
+	}
+	UNLOCK(&zone->jsynclock);
+
+	return (ISC_R_SUCCESS);
+}
+
 isc_result_t
 dns_zone_getexpiretime(dns_zone_t *zone, isc_time_t *expiretime) {
 	REQUIRE(DNS_ZONE_VALID(zone));
@@ -23576,7 +27231,7 @@ dns_zone_verifydb(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *ver) {
 
 	origin = dns_db_origin(db);
 	result = dns_zoneverify_dnssec(zone, db, version, origin, secroots,
-				       zone->mctx, true, false, dnssec_report);
+				       zone->mctx, true, false, 1, dnssec_report);
 
 done:
 	if (secroots != NULL) {
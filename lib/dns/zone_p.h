@@ -34,6 +34,11 @@ dns__zone_findkeys(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *ver,
 		   isc_stdtime_t now, isc_mem_t *mctx, unsigned int maxkeys,
 		   dst_key_t **keys, unsigned int *nkeys);
 
+isc_result_t
+dns__zone_updatekeys(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *ver,
+		     isc_stdtime_t now, unsigned int maxkeys, dst_key_t **keys,
+		     unsigned int *nkeys);
+
 isc_result_t
 dns__zone_updatesigs(dns_diff_t *diff, dns_db_t *db, dns_dbversion_t *version,
 		     dst_key_t *zone_keys[], unsigned int nkeys,
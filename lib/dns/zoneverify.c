@@ -15,6 +15,7 @@
 
 #include <inttypes.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
@@ -27,6 +28,7 @@
 #include <isc/mem.h>
 #include <isc/region.h>
 #include <isc/result.h>
+#include <isc/thread.h>
 #include <isc/types.h>
 #include <isc/util.h>
 
@@ -52,6 +54,28 @@
 
 #include <dst/dst.h>
 
+/*%
+ * Number of RRsets whose signatures are queued before the queue is
+ * verified by the worker threads.
+ */
+#define VERIFY_BATCH 1024
+
+/*%
+ * The signatures of one RRset, queued for verification.
+ */
+typedef struct vjob {
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	dns_rdataset_t rdataset;
+	dns_rdataset_t sigrdataset;
+	dst_key_t **keys;
+	dns_rdata_t *sigrdatas;
+	isc_result_t *results;
+	size_t count;
+	size_t n;
+	unsigned char set_algorithms[256];
+} vjob_t;
+
 typedef struct vctx {
 	isc_mem_t *mctx;
 	dns_zone_t *zone;
@@ -79,6 +103,10 @@ typedef struct vctx {
 	unsigned char act_algorithms[256];
 	isc_heap_t *expected_chains;
 	isc_heap_t *found_chains;
+	unsigned int nthreads;
+	vjob_t *jobs;
+	size_t njobs;
+	atomic_size_t nextjob;
 } vctx_t;
 
 struct nsec3_chain_fixed {
@@ -169,29 +197,264 @@ has_dname(const vctx_t *vctx, dns_dbnode_t *node) {
 	return ((result == ISC_R_SUCCESS));
 }
 
+/*
+ * Count the keys which may have made 'sig'.
+ */
+static size_t
+sigkeys(const vctx_t *vctx, dns_rdata_rrsig_t *sig, dst_key_t **dstkeys,
+	size_t nkeys) {
+	size_t count = 0;
+
+	if (!dns_name_equal(&sig->signer, vctx->origin)) {
+		return (0);
+	}
+	for (size_t key = 0; key < nkeys; key++) {
+		if (sig->algorithm == dst_key_alg(dstkeys[key]) &&
+		    sig->keyid == dst_key_id(dstkeys[key]))
+		{
+			count++;
+		}
+	}
+	return (count);
+}
+
+/*%
+ * Queue the signatures in 'sigrdataset' which were made by the keys in
+ * 'dstkeys' and which could have been made by them at once on 'job'.
+ * Returns false if there is nothing to verify.
+ */
 static bool
-goodsig(const vctx_t *vctx, dns_rdata_t *sigrdata, const dns_name_t *name,
-	dst_key_t **dstkeys, size_t nkeys, dns_rdataset_t *rdataset) {
-	dns_rdata_rrsig_t sig;
+goodsigs_prepare(vctx_t *vctx, dns_rdataset_t *sigrdataset,
+		 const dns_name_t *name, dst_key_t **dstkeys, size_t nkeys,
+		 dns_rdataset_t *rdataset, vjob_t *job) {
+	char namebuf[DNS_NAME_FORMATSIZE];
+	char typebuf[DNS_RDATATYPE_FORMATSIZE];
+	size_t count = 0, n = 0;
 	isc_result_t result;
 
-	result = dns_rdata_tostruct(sigrdata, &sig, NULL);
-	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	for (result = dns_rdataset_first(sigrdataset); result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(sigrdataset))
+	{
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		dns_rdata_rrsig_t sig;
 
-	for (size_t key = 0; key < nkeys; key++) {
-		if (sig.algorithm != dst_key_alg(dstkeys[key]) ||
-		    sig.keyid != dst_key_id(dstkeys[key]) ||
+		dns_rdataset_current(sigrdataset, &rdata);
+		result = dns_rdata_tostruct(&rdata, &sig, NULL);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		if (rdataset->ttl != sig.originalttl) {
+			dns_name_format(name, namebuf, sizeof(namebuf));
+			dns_rdatatype_format(rdataset->type, typebuf,
+					     sizeof(typebuf));
+			zoneverify_log_error(vctx,
+					     "TTL mismatch for "
+					     "%s %s keytag %u",
+					     namebuf, typebuf, sig.keyid);
+			continue;
+		}
+		if (vctx->act_algorithms[sig.algorithm] == 0) {
+			continue;
+		}
+		count += sigkeys(vctx, &sig, dstkeys, nkeys);
+	}
+	if (count == 0) {
+		return (false);
+	}
+
+	job->name = dns_fixedname_initname(&job->fname);
+	dns_name_copy(name, job->name);
+	dns_rdataset_init(&job->rdataset);
+	dns_rdataset_clone(rdataset, &job->rdataset);
+	dns_rdataset_init(&job->sigrdataset);
+	dns_rdataset_clone(sigrdataset, &job->sigrdataset);
+	memset(job->set_algorithms, 0, sizeof(job->set_algorithms));
+	job->count = count;
+	job->keys = isc_mem_get(vctx->mctx, count * sizeof(job->keys[0]));
+	job->sigrdatas = isc_mem_get(vctx->mctx,
+				     count * sizeof(job->sigrdatas[0]));
+	job->results = isc_mem_get(vctx->mctx,
+				   count * sizeof(job->results[0]));
+
+	for (result = dns_rdataset_first(&job->sigrdataset);
+	     result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(&job->sigrdataset))
+	{
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		dns_rdata_rrsig_t sig;
+
+		dns_rdataset_current(&job->sigrdataset, &rdata);
+		result = dns_rdata_tostruct(&rdata, &sig, NULL);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		if (rdataset->ttl != sig.originalttl ||
+		    vctx->act_algorithms[sig.algorithm] == 0 ||
 		    !dns_name_equal(&sig.signer, vctx->origin))
 		{
 			continue;
 		}
-		result = dns_dnssec_verify(name, rdataset, dstkeys[key], false,
-					   0, vctx->mctx, sigrdata, NULL);
-		if (result == ISC_R_SUCCESS || result == DNS_R_FROMWILDCARD) {
-			return (true);
+		for (size_t key = 0; key < nkeys && n < count; key++) {
+			if (sig.algorithm != dst_key_alg(dstkeys[key]) ||
+			    sig.keyid != dst_key_id(dstkeys[key]))
+			{
+				continue;
+			}
+			job->keys[n] = dstkeys[key];
+			dns_rdata_init(&job->sigrdatas[n]);
+			dns_rdata_clone(&rdata, &job->sigrdatas[n]);
+			n++;
+		}
+	}
+	job->n = n;
+
+	return (true);
+}
+
+/*%
+ * Verify the signatures queued on 'job', mark the RRset secure if any
+ * of them verifies, and record the algorithms of those found good.
+ * This may run in a worker thread; it only writes to 'job'.
+ */
+static void
+goodsigs_run(vctx_t *vctx, vjob_t *job) {
+	dns_dnssec_verifybatch(job->name, &job->rdataset, job->keys,
+			       job->sigrdatas, job->n, false, 0, vctx->mctx,
+			       job->results);
+
+	for (size_t i = 0; i < job->n; i++) {
+		if (job->results[i] == ISC_R_SUCCESS ||
+		    job->results[i] == DNS_R_FROMWILDCARD)
+		{
+			dns_rdataset_settrust(&job->rdataset, dns_trust_secure);
+			dns_rdataset_settrust(&job->sigrdataset,
+					      dns_trust_secure);
+			job->set_algorithms[dst_key_alg(job->keys[i])] = 1;
 		}
 	}
-	return (false);
+}
+
+/*%
+ * Report the active algorithms missing from 'set_algorithms' for the
+ * 'type' RRset at 'name'.
+ */
+static void
+missing_algorithms(vctx_t *vctx, const dns_name_t *name, dns_rdatatype_t type,
+		   const unsigned char *set_algorithms) {
+	char namebuf[DNS_NAME_FORMATSIZE];
+	char algbuf[DNS_SECALG_FORMATSIZE];
+	char typebuf[DNS_RDATATYPE_FORMATSIZE];
+
+	if (memcmp(set_algorithms, vctx->act_algorithms,
+		   sizeof(vctx->act_algorithms)) == 0)
+	{
+		return;
+	}
+
+	dns_name_format(name, namebuf, sizeof(namebuf));
+	dns_rdatatype_format(type, typebuf, sizeof(typebuf));
+	for (size_t i = 0; i < ARRAY_SIZE(vctx->act_algorithms); i++) {
+		if ((vctx->act_algorithms[i] != 0) && (set_algorithms[i] == 0))
+		{
+			dns_secalg_format(i, algbuf, sizeof(algbuf));
+			zoneverify_log_error(vctx,
+					     "No correct %s signature "
+					     "for %s %s",
+					     algbuf, namebuf, typebuf);
+			vctx->bad_algorithms[i] = 1;
+		}
+	}
+}
+
+/*%
+ * Report the results of 'job' and release it.
+ */
+static void
+goodsigs_done(vctx_t *vctx, vjob_t *job) {
+	missing_algorithms(vctx, job->name, job->rdataset.type,
+			   job->set_algorithms);
+
+	isc_mem_put(vctx->mctx, job->results,
+		    job->count * sizeof(job->results[0]));
+	isc_mem_put(vctx->mctx, job->sigrdatas,
+		    job->count * sizeof(job->sigrdatas[0]));
+	isc_mem_put(vctx->mctx, job->keys, job->count * sizeof(job->keys[0]));
+	dns_rdataset_disassociate(&job->rdataset);
+	dns_rdataset_disassociate(&job->sigrdataset);
+}
+
+static isc_threadresult_t
+verify_worker(isc_threadarg_t arg) {
+	vctx_t *vctx = arg;
+	size_t i;
+
+	while ((i = atomic_fetch_add_relaxed(&vctx->nextjob, 1)) <
+	       vctx->njobs)
+	{
+		goodsigs_run(vctx, &vctx->jobs[i]);
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+/*%
+ * Verify all the queued signatures, spreading them across up to
+ * 'vctx->nthreads' threads, then report the results in the order the
+ * RRsets were queued.  Only the cryptographic work is done in parallel;
+ * everything that touches the rest of 'vctx' stays in this thread.
+ */
+static void
+verify_flush(vctx_t *vctx) {
+	isc_thread_t *threads = NULL;
+	unsigned int nthreads;
+
+	if (vctx->njobs == 0) {
+		return;
+	}
+
+	nthreads = ISC_MIN(vctx->nthreads, vctx->njobs);
+	atomic_init(&vctx->nextjob, 0);
+	if (nthreads > 1) {
+		threads = isc_mem_get(vctx->mctx,
+				      (nthreads - 1) * sizeof(threads[0]));
+		for (unsigned int i = 0; i < nthreads - 1; i++) {
+			isc_thread_create(verify_worker, vctx, &threads[i]);
+		}
+	}
+	verify_worker(vctx);
+	if (threads != NULL) {
+		for (unsigned int i = 0; i < nthreads - 1; i++) {
+			isc_thread_join(threads[i], NULL);
+		}
+		isc_mem_put(vctx->mctx, threads,
+			    (nthreads - 1) * sizeof(threads[0]));
+	}
+
+	for (size_t i = 0; i < vctx->njobs; i++) {
+		goodsigs_done(vctx, &vctx->jobs[i]);
+	}
+	vctx->njobs = 0;
+}
+
+/*%
+ * Check which of the signatures in 'sigrdataset' over 'rdataset' at
+ * 'name' are good.  Without worker threads they are verified at once;
+ * otherwise they are queued and verified with the next batch.
+ */
+static void
+goodsigs(vctx_t *vctx, dns_rdataset_t *sigrdataset, const dns_name_t *name,
+	 dst_key_t **dstkeys, size_t nkeys, dns_rdataset_t *rdataset) {
+	vjob_t *job = &vctx->jobs[vctx->njobs];
+
+	if (!goodsigs_prepare(vctx, sigrdataset, name, dstkeys, nkeys,
+			      rdataset, job))
+	{
+		unsigned char none[256] = { 0 };
+
+		missing_algorithms(vctx, name, rdataset->type, none);
+		return;
+	}
+
+	vctx->njobs++;
+	if (vctx->nthreads <= 1 || vctx->njobs == VERIFY_BATCH) {
+		verify_flush(vctx);
+	}
 }
 
 static bool
@@ -807,9 +1070,7 @@ verifynsec3s(const vctx_t *vctx, const dns_name_t *name,
 static isc_result_t
 verifyset(vctx_t *vctx, dns_rdataset_t *rdataset, const dns_name_t *name,
 	  dns_dbnode_t *node, dst_key_t **dstkeys, size_t nkeys) {
-	unsigned char set_algorithms[256] = { 0 };
 	char namebuf[DNS_NAME_FORMATSIZE];
-	char algbuf[DNS_SECALG_FORMATSIZE];
 	char typebuf[DNS_RDATATYPE_FORMATSIZE];
 	dns_rdataset_t sigrdataset;
 	dns_rdatasetiter_t *rdsiter = NULL;
@@ -838,7 +1099,7 @@ verifyset(vctx_t *vctx, dns_rdataset_t *rdataset, const dns_name_t *name,
 		dns_rdatatype_format(rdataset->type, typebuf, sizeof(typebuf));
 		zoneverify_log_error(vctx, "No signatures for %s/%s", namebuf,
 				     typebuf);
-		for (size_t i = 0; i < ARRAY_SIZE(set_algorithms); i++) {
+		for (size_t i = 0; i < ARRAY_SIZE(vctx->act_algorithms); i++) {
 			if (vctx->act_algorithms[i] != 0) {
 				vctx->bad_algorithms[i] = 1;
 			}
@@ -847,55 +1108,9 @@ verifyset(vctx_t *vctx, dns_rdataset_t *rdataset, const dns_name_t *name,
 		goto done;
 	}
 
-	for (result = dns_rdataset_first(&sigrdataset); result == ISC_R_SUCCESS;
-	     result = dns_rdataset_next(&sigrdataset))
-	{
-		dns_rdata_t rdata = DNS_RDATA_INIT;
-		dns_rdata_rrsig_t sig;
-
-		dns_rdataset_current(&sigrdataset, &rdata);
-		result = dns_rdata_tostruct(&rdata, &sig, NULL);
-		RUNTIME_CHECK(result == ISC_R_SUCCESS);
-		if (rdataset->ttl != sig.originalttl) {
-			dns_name_format(name, namebuf, sizeof(namebuf));
-			dns_rdatatype_format(rdataset->type, typebuf,
-					     sizeof(typebuf));
-			zoneverify_log_error(vctx,
-					     "TTL mismatch for "
-					     "%s %s keytag %u",
-					     namebuf, typebuf, sig.keyid);
-			continue;
-		}
-		if ((set_algorithms[sig.algorithm] != 0) ||
-		    (vctx->act_algorithms[sig.algorithm] == 0))
-		{
-			continue;
-		}
-		if (goodsig(vctx, &rdata, name, dstkeys, nkeys, rdataset)) {
-			dns_rdataset_settrust(rdataset, dns_trust_secure);
-			dns_rdataset_settrust(&sigrdataset, dns_trust_secure);
-			set_algorithms[sig.algorithm] = 1;
-		}
-	}
+	goodsigs(vctx, &sigrdataset, name, dstkeys, nkeys, rdataset);
 	result = ISC_R_SUCCESS;
 
-	if (memcmp(set_algorithms, vctx->act_algorithms,
-		   sizeof(set_algorithms)) != 0) {
-		dns_name_format(name, namebuf, sizeof(namebuf));
-		dns_rdatatype_format(rdataset->type, typebuf, sizeof(typebuf));
-		for (size_t i = 0; i < ARRAY_SIZE(set_algorithms); i++) {
-			if ((vctx->act_algorithms[i] != 0) &&
-			    (set_algorithms[i] == 0)) {
-				dns_secalg_format(i, algbuf, sizeof(algbuf));
-				zoneverify_log_error(vctx,
-						     "No correct %s signature "
-						     "for %s %s",
-						     algbuf, namebuf, typebuf);
-				vctx->bad_algorithms[i] = 1;
-			}
-		}
-	}
-
 done:
 	if (dns_rdataset_isassociated(&sigrdataset)) {
 		dns_rdataset_disassociate(&sigrdataset);
@@ -1268,7 +1483,8 @@ verifyemptynodes(const vctx_t *vctx, const dns_name_t *name,
 
 static void
 vctx_init(vctx_t *vctx, isc_mem_t *mctx, dns_zone_t *zone, dns_db_t *db,
-	  dns_dbversion_t *ver, dns_name_t *origin, dns_keytable_t *secroots) {
+	  dns_dbversion_t *ver, dns_name_t *origin, dns_keytable_t *secroots,
+	  unsigned int nthreads) {
 	memset(vctx, 0, sizeof(*vctx));
 
 	vctx->mctx = mctx;
@@ -1295,6 +1511,11 @@ vctx_init(vctx_t *vctx, isc_mem_t *mctx, dns_zone_t *zone, dns_db_t *db,
 
 	vctx->found_chains = NULL;
 	isc_heap_create(mctx, chain_compare, NULL, 1024, &vctx->found_chains);
+
+	vctx->nthreads = ISC_MAX(nthreads, 1);
+	vctx->jobs = isc_mem_get(mctx, (vctx->nthreads > 1 ? VERIFY_BATCH : 1) *
+					       sizeof(vctx->jobs[0]));
+	vctx->njobs = 0;
 }
 
 static void
@@ -1327,6 +1548,10 @@ vctx_destroy(vctx_t *vctx) {
 	isc_heap_destroy(&vctx->expected_chains);
 	isc_heap_foreach(vctx->found_chains, free_element_heap, vctx->mctx);
 	isc_heap_destroy(&vctx->found_chains);
+	INSIST(vctx->njobs == 0);
+	isc_mem_put(vctx->mctx, vctx->jobs,
+		    (vctx->nthreads > 1 ? VERIFY_BATCH : 1) *
+			    sizeof(vctx->jobs[0]));
 }
 
 static isc_result_t
@@ -1858,7 +2083,7 @@ verify_nodes(vctx_t *vctx, isc_result_t *vresult) {
 	if (result != ISC_R_SUCCESS) {
 		zoneverify_log_error(vctx, "dns_db_createiterator(): %s",
 				     isc_result_totext(result));
-		return (result);
+		goto done;
 	}
 
 	for (result = dns_dbiterator_first(dbiter); result == ISC_R_SUCCESS;
@@ -1889,6 +2114,10 @@ verify_nodes(vctx_t *vctx, isc_result_t *vresult) {
 	result = ISC_R_SUCCESS;
 
 done:
+	/*
+	 * The queued signatures refer to 'dstkeys'.
+	 */
+	verify_flush(vctx);
 	while (nkeys-- > 0U) {
 		dst_key_free(&dstkeys[nkeys]);
 	}
@@ -1958,12 +2187,12 @@ isc_result_t
 dns_zoneverify_dnssec(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *ver,
 		      dns_name_t *origin, dns_keytable_t *secroots,
 		      isc_mem_t *mctx, bool ignore_kskflag, bool keyset_kskonly,
-		      void (*report)(const char *, ...)) {
+		      unsigned int nthreads, void (*report)(const char *, ...)) {
 	const char *keydesc = (secroots == NULL ? "self-signed" : "trusted");
 	isc_result_t result, vresult = ISC_R_UNSET;
 	vctx_t vctx;
 
-	vctx_init(&vctx, mctx, zone, db, ver, origin, secroots);
+	vctx_init(&vctx, mctx, zone, db, ver, origin, secroots, nthreads);
 
 	result = check_apex_rrsets(&vctx);
 	if (result != ISC_R_SUCCESS) {
@@ -18,13 +18,16 @@
 
 #include <isc/atomic.h>
 #include <isc/file.h>
+#include <isc/list.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/rcu.h>
 #include <isc/result.h>
 #include <isc/string.h>
 #include <isc/task.h>
 #include <isc/util.h>
 
+#include <dns/fixedname.h>
 #include <dns/log.h>
 #include <dns/name.h>
 #include <dns/rbt.h>
@@ -38,6 +41,68 @@ struct zt_load_params {
 	bool newonly;
 };
 
+/*
+ * Lookups
+ *
+ * Besides the rbt, which keeps the zones in order for dns_zt_apply(),
+ * the mounted zones are kept in a hash table of their origins.  A lookup
+ * on a loop thread hashes each suffix of the name, longest first, and
+ * stops at the first one that is the origin of a zone; it takes no lock
+ * but runs in an isc_rcu read-side critical section.  Mount and unmount
+ * change the hash table under the write lock by storing single pointers,
+ * and a resize builds a new table and swaps it in, retiring the old one.
+ * Unmount waits for the lookups that may have seen the zone to finish
+ * before the rbt drops its reference to it.  Other threads look up in
+ * the rbt under the read lock.
+ *
+ * Each loop thread also remembers its last few hits.  These are only
+ * trusted while the table's generation, which every mount and unmount
+ * changes, is the one they were found in.
+ */
+
+#define ZT_INDEX_MINSIZE 61
+#define ZT_CACHE_SIZE	 4
+
+typedef struct zt_entry zt_entry_t;
+
+struct zt_entry {
+	atomic_uintptr_t next;
+	dns_zone_t *zone;
+	unsigned int hashval;
+	dns_fixedname_t fname;
+	dns_name_t *name;
+};
+
+typedef struct zt_index zt_index_t;
+
+struct zt_index {
+	unsigned int size;
+	uint64_t tag;
+	ISC_LINK(zt_index_t) link;
+	atomic_uintptr_t buckets[];
+};
+
+#define INDEX_SIZE(n) (sizeof(zt_index_t) + (n) * sizeof(atomic_uintptr_t))
+
+typedef struct zt_cacheent {
+	const dns_zt_t *zt;
+	uint64_t generation;
+	unsigned int options;
+	unsigned int hashval;
+	zt_entry_t *entry;
+	dns_fixedname_t fname;
+} zt_cacheent_t;
+
+static thread_local zt_cacheent_t zt_cache[ZT_CACHE_SIZE];
+static thread_local unsigned int zt_cache_next = 0;
+
+/*
+ * Generations are drawn from one counter for all tables, so that a
+ * cached hit can't be mistaken for one in a later table that happens
+ * to reuse the memory of a destroyed one.
+ */
+static atomic_uint_fast64_t zt_generations = 0;
+
 struct dns_zt {
 	/* Unlocked. */
 	unsigned int magic;
@@ -55,6 +120,12 @@ struct dns_zt {
 
 	/* Locked by lock. */
 	dns_rbt_t *table;
+	unsigned int count;
+	ISC_LIST(zt_index_t) retired;
+
+	/* Changed under the write lock, read without it by lookups. */
+	atomic_uintptr_t index;
+	atomic_uint_fast64_t generation;
 };
 
 struct zt_freeze_params {
@@ -80,6 +151,295 @@ freezezones(dns_zone_t *zone, void *uap);
 static isc_result_t
 doneloading(dns_zt_t *zt, dns_zone_t *zone, isc_task_t *task);
 
+static zt_entry_t *
+entry_next(zt_entry_t *entry) {
+	return ((zt_entry_t *)atomic_load_acquire(&entry->next));
+}
+
+static zt_entry_t *
+entry_new(dns_zt_t *zt, dns_zone_t *zone, const dns_name_t *name,
+	  unsigned int hashval) {
+	zt_entry_t *entry = isc_mem_get(zt->mctx, sizeof(*entry));
+
+	*entry = (zt_entry_t){ .zone = zone, .hashval = hashval };
+	atomic_init(&entry->next, 0);
+	entry->name = dns_fixedname_initname(&entry->fname);
+	dns_name_copy(name, entry->name);
+
+	return (entry);
+}
+
+static zt_index_t *
+index_new(dns_zt_t *zt, unsigned int size) {
+	zt_index_t *index = isc_mem_get(zt->mctx, INDEX_SIZE(size));
+
+	*index = (zt_index_t){ .size = size };
+	ISC_LINK_INIT(index, link);
+	for (unsigned int i = 0; i < size; i++) {
+		atomic_init(&index->buckets[i], 0);
+	}
+
+	return (index);
+}
+
+/*
+ * Free 'index' and the entries it links to.
+ */
+static void
+index_free(dns_zt_t *zt, zt_index_t *index) {
+	for (unsigned int i = 0; i < index->size; i++) {
+		zt_entry_t *entry = NULL, *next = NULL;
+
+		entry = (zt_entry_t *)atomic_load_relaxed(&index->buckets[i]);
+		for (; entry != NULL; entry = next) {
+			next = entry_next(entry);
+			isc_mem_put(zt->mctx, entry, sizeof(*entry));
+		}
+	}
+	isc_mem_put(zt->mctx, index, INDEX_SIZE(index->size));
+}
+
+static zt_index_t *
+zt_index(dns_zt_t *zt) {
+	return ((zt_index_t *)atomic_load_acquire(&zt->index));
+}
+
+static atomic_uintptr_t *
+index_bucket(zt_index_t *index, unsigned int hashval) {
+	return (&index->buckets[hashval % index->size]);
+}
+
+static zt_entry_t *
+index_find(zt_index_t *index, const dns_name_t *name, unsigned int hashval) {
+	zt_entry_t *entry = NULL;
+
+	entry = (zt_entry_t *)atomic_load_acquire(index_bucket(index, hashval));
+	for (; entry != NULL; entry = entry_next(entry)) {
+		if (entry->hashval == hashval &&
+		    dns_name_equal(entry->name, name)) {
+			return (entry);
+		}
+	}
+
+	return (NULL);
+}
+
+/*
+ * Start a new generation of 'zt', invalidating the cached hits.  The
+ * write lock must be held.
+ */
+static void
+zt_newgeneration(dns_zt_t *zt) {
+	atomic_store_release(&zt->generation,
+			     atomic_fetch_add_relaxed(&zt_generations, 1) + 1);
+}
+
+/*
+ * Free the retired hash tables that no lookup can still see.  The write
+ * lock must be held.
+ */
+static void
+zt_reclaim(dns_zt_t *zt) {
+	zt_index_t *index = NULL;
+
+	while ((index = ISC_LIST_HEAD(zt->retired)) != NULL &&
+	       isc_rcu_expired(index->tag))
+	{
+		ISC_LIST_UNLINK(zt->retired, index, link);
+		index_free(zt, index);
+	}
+}
+
+/*
+ * Replace the hash table of 'zt' with one of 'size' buckets holding
+ * copies of its entries, and retire the old one.  The write lock must be
+ * held.
+ */
+static void
+zt_rehash(dns_zt_t *zt, unsigned int size) {
+	zt_index_t *old = zt_index(zt);
+	zt_index_t *index = index_new(zt, size);
+
+	for (unsigned int i = 0; i < old->size; i++) {
+		zt_entry_t *entry = NULL;
+
+		entry = (zt_entry_t *)atomic_load_relaxed(&old->buckets[i]);
+		for (; entry != NULL; entry = entry_next(entry)) {
+			zt_entry_t *copy = entry_new(zt, entry->zone,
+						     entry->name,
+						     entry->hashval);
+			atomic_uintptr_t *bucket = index_bucket(index,
+								entry->hashval);
+
+			atomic_init(&copy->next, atomic_load_relaxed(bucket));
+			atomic_init(bucket, (uintptr_t)copy);
+		}
+	}
+
+	atomic_store_release(&zt->index, (uintptr_t)index);
+	old->tag = isc_rcu_retire();
+	ISC_LIST_APPEND(zt->retired, old, link);
+}
+
+/*
+ * Add 'zone' to the hash table.  The write lock must be held.
+ */
+static void
+zt_index_add(dns_zt_t *zt, dns_zone_t *zone) {
+	dns_name_t *name = dns_zone_getorigin(zone);
+	unsigned int hashval = dns_name_fullhash(name, false);
+	zt_index_t *index = NULL;
+	zt_entry_t *entry = NULL;
+	atomic_uintptr_t *bucket = NULL;
+
+	zt_reclaim(zt);
+
+	if (zt->count + 1 > zt_index(zt)->size * 2) {
+		zt_rehash(zt, zt_index(zt)->size * 2 + 1);
+	}
+
+	index = zt_index(zt);
+	entry = entry_new(zt, zone, name, hashval);
+	bucket = index_bucket(index, hashval);
+	atomic_init(&entry->next, atomic_load_relaxed(bucket));
+	atomic_store_release(bucket, (uintptr_t)entry);
+	zt->count++;
+
+	zt_newgeneration(zt);
+}
+
+/*
+ * Remove the zone named 'name' from the hash table, and wait until no
+ * lookup can still be using it.  The write lock must be held.
+ */
+static void
+zt_index_delete(dns_zt_t *zt, const dns_name_t *name) {
+	unsigned int hashval = dns_name_fullhash(name, false);
+	zt_index_t *index = zt_index(zt);
+	atomic_uintptr_t *linkp = index_bucket(index, hashval);
+	zt_entry_t *entry = NULL;
+
+	while ((entry = (zt_entry_t *)atomic_load_relaxed(linkp)) != NULL) {
+		if (entry->hashval == hashval &&
+		    dns_name_equal(entry->name, name)) {
+			break;
+		}
+		linkp = &entry->next;
+	}
+	if (entry == NULL) {
+		return;
+	}
+
+	atomic_store_release(linkp, atomic_load_relaxed(&entry->next));
+	zt->count--;
+	zt_newgeneration(zt);
+
+	isc_rcu_synchronize();
+	isc_mem_put(zt->mctx, entry, sizeof(*entry));
+	zt_reclaim(zt);
+}
+
+/*
+ * Find the deepest zone at or above 'name', whose hash is 'hashval',
+ * in the hash table; an exact match is skipped if DNS_ZTFIND_NOEXACT is
+ * set in 'options'.  Must be called in an isc_rcu read-side critical
+ * section.
+ */
+static zt_entry_t *
+zt_index_lookup(dns_zt_t *zt, const dns_name_t *name, unsigned int options,
+		unsigned int hashval) {
+	zt_index_t *index = zt_index(zt);
+	unsigned int labels = dns_name_countlabels(name);
+	zt_entry_t *entry = NULL;
+
+	if ((options & DNS_ZTFIND_NOEXACT) == 0) {
+		entry = index_find(index, name, hashval);
+	}
+
+	for (unsigned int i = 1; entry == NULL && i < labels; i++) {
+		dns_name_t suffix;
+
+		dns_name_init(&suffix, NULL);
+		dns_name_getlabelsequence(name, i, labels - i, &suffix);
+		entry = index_find(index, &suffix,
+				   dns_name_fullhash(&suffix, false));
+	}
+
+	return (entry);
+}
+
+/*
+ * Look 'name' up in the hash table of 'zt', trying the hits cached by
+ * this thread first.  Must be called in an isc_rcu read-side critical
+ * section.
+ */
+static zt_entry_t *
+zt_lookup(dns_zt_t *zt, const dns_name_t *name, unsigned int options) {
+	uint64_t generation = atomic_load_acquire(&zt->generation);
+	unsigned int hashval = dns_name_fullhash(name, false);
+	zt_cacheent_t *ce = NULL;
+	zt_entry_t *entry = NULL;
+
+	options &= DNS_ZTFIND_NOEXACT;
+
+	for (size_t i = 0; i < ZT_CACHE_SIZE; i++) {
+		ce = &zt_cache[i];
+		if (ce->zt == zt && ce->generation == generation &&
+		    ce->options == options && ce->hashval == hashval &&
+		    dns_name_equal(dns_fixedname_name(&ce->fname), name))
+		{
+			return (ce->entry);
+		}
+	}
+
+	entry = zt_index_lookup(zt, name, options, hashval);
+	if (entry != NULL) {
+		ce = &zt_cache[zt_cache_next++ % ZT_CACHE_SIZE];
+		ce->zt = zt;
+		ce->generation = generation;
+		ce->options = options;
+		ce->hashval = hashval;
+		ce->entry = entry;
+		dns_name_copy(name, dns_fixedname_initname(&ce->fname));
+	}
+
+	return (entry);
+}
+
+/*
+ * Check the zone '*zonep' found for a name by a lookup that returned
+ * 'result', and detach it if DNS_ZTFIND_MIRROR says it's not to be used.
+ */
+static isc_result_t
+zt_found(isc_result_t result, unsigned int options, dns_zone_t **zonep) {
+	/*
+	 * If DNS_ZTFIND_MIRROR is set and the zone which was
+	 * determined to be the deepest match for the supplied name is
+	 * a mirror zone which is expired or not yet loaded, treat it
+	 * as non-existent.  This will trigger a fallback to recursion
+	 * instead of returning a SERVFAIL.
+	 *
+	 * Note that currently only the deepest match in the zone table
+	 * is checked.  Consider a server configured with two mirror
+	 * zones: "bar" and its child, "foo.bar".  If zone data is
+	 * available for "bar" but not for "foo.bar", a query with
+	 * QNAME equal to or below "foo.bar" will cause ISC_R_NOTFOUND
+	 * to be returned, not DNS_R_PARTIALMATCH, despite zone data
+	 * being available for "bar".  This is considered to be an edge
+	 * case, handling which more appropriately is possible, but
+	 * arguably not worth the added complexity.
+	 */
+	if ((options & DNS_ZTFIND_MIRROR) != 0 &&
+	    dns_zone_gettype(*zonep) == dns_zone_mirror &&
+	    !dns_zone_isloaded(*zonep))
+	{
+		dns_zone_detach(zonep);
+		return (ISC_R_NOTFOUND);
+	}
+
+	return (result);
+}
+
 isc_result_t
 dns_zt_create(isc_mem_t *mctx, dns_rdataclass_t rdclass, dns_zt_t **ztp) {
 	dns_zt_t *zt;
@@ -106,6 +466,11 @@ dns_zt_create(isc_mem_t *mctx, dns_rdataclass_t rdclass, dns_zt_t **ztp) {
 	zt->loaddone_arg = NULL;
 	zt->loadparams = NULL;
 	isc_refcount_init(&zt->loads_pending, 0);
+	zt->count = 0;
+	ISC_LIST_INIT(zt->retired);
+	atomic_init(&zt->index, (uintptr_t)index_new(zt, ZT_INDEX_MINSIZE));
+	atomic_init(&zt->generation, 0);
+	zt_newgeneration(zt);
 	*ztp = zt;
 
 	return (ISC_R_SUCCESS);
@@ -131,6 +496,7 @@ dns_zt_mount(dns_zt_t *zt, dns_zone_t *zone) {
 	result = dns_rbt_addname(zt->table, name, zone);
 	if (result == ISC_R_SUCCESS) {
 		dns_zone_attach(zone, &dummy);
+		zt_index_add(zt, zone);
 	}
 
 	RWUNLOCK(&zt->rwlock, isc_rwlocktype_write);
@@ -149,6 +515,11 @@ dns_zt_unmount(dns_zt_t *zt, dns_zone_t *zone) {
 
 	RWLOCK(&zt->rwlock, isc_rwlocktype_write);
 
+	/*
+	 * Take the zone out of the hash table first: once this returns,
+	 * no lockless lookup can find it, and the rbt may let it go.
+	 */
+	zt_index_delete(zt, name);
 	result = dns_rbt_deletename(zt->table, name, false);
 
 	RWUNLOCK(&zt->rwlock, isc_rwlocktype_write);
@@ -165,6 +536,30 @@ dns_zt_find(dns_zt_t *zt, const dns_name_t *name, unsigned int options,
 
 	REQUIRE(VALID_ZT(zt));
 
+	if (dns_name_isabsolute(name) && isc_rcu_available()) {
+		zt_entry_t *entry = NULL;
+
+		result = ISC_R_NOTFOUND;
+		isc_rcu_read_lock();
+		entry = zt_lookup(zt, name, options);
+		if (entry != NULL) {
+			if (foundname != NULL) {
+				dns_name_copy(entry->name, foundname);
+			}
+			result = (dns_name_countlabels(entry->name) ==
+				  dns_name_countlabels(name))
+					 ? ISC_R_SUCCESS
+					 : DNS_R_PARTIALMATCH;
+			dns_zone_attach(entry->zone, zonep);
+		}
+		isc_rcu_read_unlock();
+
+		if (entry != NULL) {
+			result = zt_found(result, options, zonep);
+		}
+		return (result);
+	}
+
 	if ((options & DNS_ZTFIND_NOEXACT) != 0) {
 		rbtoptions |= DNS_RBTFIND_NOEXACT;
 	}
@@ -174,35 +569,15 @@ dns_zt_find(dns_zt_t *zt, const dns_name_t *name, unsigned int options,
 	result = dns_rbt_findname(zt->table, name, rbtoptions, foundname,
 				  (void **)(void *)&dummy);
 	if (result == ISC_R_SUCCESS || result == DNS_R_PARTIALMATCH) {
-		/*
-		 * If DNS_ZTFIND_MIRROR is set and the zone which was
-		 * determined to be the deepest match for the supplied name is
-		 * a mirror zone which is expired or not yet loaded, treat it
-		 * as non-existent.  This will trigger a fallback to recursion
-		 * instead of returning a SERVFAIL.
-		 *
-		 * Note that currently only the deepest match in the zone table
-		 * is checked.  Consider a server configured with two mirror
-		 * zones: "bar" and its child, "foo.bar".  If zone data is
-		 * available for "bar" but not for "foo.bar", a query with
-		 * QNAME equal to or below "foo.bar" will cause ISC_R_NOTFOUND
-		 * to be returned, not DNS_R_PARTIALMATCH, despite zone data
-		 * being available for "bar".  This is considered to be an edge
-		 * case, handling which more appropriately is possible, but
-		 * arguably not worth the added complexity.
-		 */
-		if ((options & DNS_ZTFIND_MIRROR) != 0 &&
-		    dns_zone_gettype(dummy) == dns_zone_mirror &&
-		    !dns_zone_isloaded(dummy))
-		{
-			result = ISC_R_NOTFOUND;
-		} else {
-			dns_zone_attach(dummy, zonep);
-		}
+		dns_zone_attach(dummy, zonep);
 	}
 
 	RWUNLOCK(&zt->rwlock, isc_rwlocktype_read);
 
+	if (result == ISC_R_SUCCESS || result == DNS_R_PARTIALMATCH) {
+		result = zt_found(result, options, zonep);
+	}
+
 	return (result);
 }
 
@@ -232,6 +607,12 @@ zt_destroy(dns_zt_t *zt) {
 	}
 
 	dns_rbt_destroy(&zt->table);
+	index_free(zt, zt_index(zt));
+	while (!ISC_LIST_EMPTY(zt->retired)) {
+		zt_index_t *index = ISC_LIST_HEAD(zt->retired);
+		ISC_LIST_UNLINK(zt->retired, index, link);
+		index_free(zt, index);
+	}
 	isc_rwlock_destroy(&zt->rwlock);
 	zt->magic = 0;
 	isc_mem_putanddetach(&zt->mctx, zt, sizeof(*zt));
@@ -38,20 +38,40 @@
 #include "loop_p.h"
 
 void
-isc_async_run(isc_loop_t *loop, isc_job_cb cb, void *cbarg) {
-	int r;
+isc__async_run(isc_loop_t *loop, isc_job_cb cb, void *cbarg,
+	       const char *name) {
 	isc_job_t *job = NULL;
+	uintptr_t head;
 
 	REQUIRE(VALID_LOOP(loop));
 	REQUIRE(cb != NULL);
 
-	job = isc__job_new(loop, cb, cbarg);
+	job = isc__job_new(loop, cb, cbarg, name);
 
-	/* Now send the half initialized job to loop queue */
-	LOCK(&loop->queue_lock);
-	ISC_LIST_APPEND(loop->queue_jobs, job, link);
-	UNLOCK(&loop->queue_lock);
+	/*
+	 * Push the half initialized job onto the loop queue.  queue_cb()
+	 * takes the whole queue at once, so if the queue was not empty, the
+	 * loop has not run queue_cb() since the job that made it non-empty
+	 * was queued, and a wakeup is already pending.
+	 */
+	head = atomic_load_relaxed(&loop->queue_jobs);
+	do {
+		job->qnext = (isc_job_t *)head;
+	} while (!atomic_compare_exchange_weak_acq_rel(&loop->queue_jobs, &head,
+						       (uintptr_t)job));
 
-	r = uv_async_send(&loop->queue_trigger);
-	UV_RUNTIME_CHECK(uv_async_send, r);
+	if (head == (uintptr_t)NULL) {
+		int r = uv_async_send(&loop->queue_trigger);
+		UV_RUNTIME_CHECK(uv_async_send, r);
+	}
+}
+
+void
+isc_async_getstats(isc_loop_t *loop, uint64_t *wakeupsp, uint64_t *jobsp) {
+	REQUIRE(VALID_LOOP(loop));
+	REQUIRE(wakeupsp != NULL);
+	REQUIRE(jobsp != NULL);
+
+	*wakeupsp = atomic_load_relaxed(&loop->queue_wakeups);
+	*jobsp = atomic_load_relaxed(&loop->queue_runs);
 }
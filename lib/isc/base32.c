@@ -47,6 +47,56 @@ static const char base32[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567="
 static const char base32hex[] = "0123456789ABCDEFGHIJKLMNOPQRSTUV="
 				"0123456789abcdefghijklmnopqrstuv";
 
+/*%
+ * One more than the value of each base32[] character, ignoring case,
+ * or 0 if the character is not there, so that decoding does not have
+ * to search the alphabet.
+ */
+/* clang-format off */
+static const uint8_t base32val[256] = {
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0, 27, 28, 29, 30, 31, 32,  0,  0,  0,  0,  0, 33,  0,  0,
+	 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15,
+	16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26,  0,  0,  0,  0,  0,
+	 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15,
+	16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+};
+/* clang-format on */
+
+/*%
+ * The same for base32hex[].
+ */
+/* clang-format off */
+static const uint8_t base32hexval[256] = {
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 1,  2,  3,  4,  5,  6,  7,  8,  9, 10,  0,  0,  0, 33,  0,  0,
+	 0, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,
+	26, 27, 28, 29, 30, 31, 32,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,
+	26, 27, 28, 29, 30, 31, 32,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+};
+/* clang-format on */
+
 static isc_result_t
 base32_totext(isc_region_t *source, int wordlength, const char *wordbreak,
 	      isc_buffer_t *target, const char base[], char pad) {
@@ -96,7 +146,7 @@ base32_totext(isc_region_t *source, int wordlength, const char *wordbreak,
 		buf[6] = base[((source->base[3] << 3) & 0x18) | /* 2 = 8 */
 			      ((source->base[4] >> 5) & 0x07)]; /* 3 + */
 		buf[7] = base[source->base[4] & 0x1f];		/* 5 = 8 */
-		RETERR(str_totext(buf, target));
+		RETERR(mem_tobuffer(target, buf, 8));
 		isc_region_consume(source, 5);
 
 		loops++;
@@ -143,10 +193,10 @@ typedef struct {
 	int digits;	      /*%< Number of buffered base32 digits */
 	bool seen_end;	      /*%< True if "=" end marker seen */
 	int val[8];
-	const char *base; /*%< Which encoding we are using */
-	int seen_32;	  /*%< Number of significant bytes if non
-			   * zero */
-	bool pad;	  /*%< Expect padding */
+	const uint8_t *values; /*%< Which encoding we are using */
+	int seen_32;	       /*%< Number of significant bytes if non
+				* zero */
+	bool pad;	       /*%< Expect padding */
 } base32_decode_ctx_t;
 
 static void
@@ -157,29 +207,21 @@ base32_decode_init(base32_decode_ctx_t *ctx, int length, const char base[],
 	ctx->seen_32 = 0;
 	ctx->length = length;
 	ctx->target = target;
-	ctx->base = base;
+	ctx->values = (base == base32) ? base32val : base32hexval;
 	ctx->pad = pad;
 }
 
 static isc_result_t
 base32_decode_char(base32_decode_ctx_t *ctx, int c) {
-	const char *s;
 	unsigned int last;
 
 	if (ctx->seen_end) {
 		return (ISC_R_BADBASE32);
 	}
-	if ((s = strchr(ctx->base, c)) == NULL) {
+	if ((last = ctx->values[(uint8_t)c]) == 0) {
 		return (ISC_R_BADBASE32);
 	}
-	last = (unsigned int)(s - ctx->base);
-
-	/*
-	 * Handle lower case.
-	 */
-	if (last > 32) {
-		last -= 33;
-	}
+	last -= 1;
 
 	/*
 	 * Check that padding is contiguous.
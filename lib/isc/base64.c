@@ -43,6 +43,31 @@ static const char base64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvw"
 			     "xyz0123456789+/=";
 /*@}*/
 
+/*%
+ * One more than the index of each character in base64[], or 0 if the
+ * character is not there, so that decoding does not have to search it.
+ */
+/* clang-format off */
+static const uint8_t base64val[256] = {
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 63,  0,  0,  0, 64,
+	53, 54, 55, 56, 57, 58, 59, 60, 61, 62,  0,  0,  0, 65,  0,  0,
+	 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15,
+	16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26,  0,  0,  0,  0,  0,
+	 0, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41,
+	42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+};
+/* clang-format on */
+
 isc_result_t
 isc_base64_totext(isc_region_t *source, int wordlength, const char *wordbreak,
 		  isc_buffer_t *target) {
@@ -61,7 +86,7 @@ isc_base64_totext(isc_region_t *source, int wordlength, const char *wordbreak,
 		buf[2] = base64[((source->base[1] << 2) & 0x3c) |
 				((source->base[2] >> 6) & 0x03)];
 		buf[3] = base64[source->base[2] & 0x3f];
-		RETERR(str_totext(buf, target));
+		RETERR(mem_tobuffer(target, buf, 4));
 		isc_region_consume(source, 3);
 
 		loops++;
@@ -77,13 +102,13 @@ isc_base64_totext(isc_region_t *source, int wordlength, const char *wordbreak,
 				((source->base[1] >> 4) & 0x0f)];
 		buf[2] = base64[((source->base[1] << 2) & 0x3c)];
 		buf[3] = '=';
-		RETERR(str_totext(buf, target));
+		RETERR(mem_tobuffer(target, buf, 4));
 		isc_region_consume(source, 2);
 	} else if (source->length == 1) {
 		buf[0] = base64[(source->base[0] >> 2) & 0x3f];
 		buf[1] = base64[((source->base[0] << 4) & 0x30)];
 		buf[2] = buf[3] = '=';
-		RETERR(str_totext(buf, target));
+		RETERR(mem_tobuffer(target, buf, 4));
 		isc_region_consume(source, 1);
 	}
 	return (ISC_R_SUCCESS);
@@ -110,15 +135,15 @@ base64_decode_init(base64_decode_ctx_t *ctx, int length, isc_buffer_t *target) {
 
 static isc_result_t
 base64_decode_char(base64_decode_ctx_t *ctx, int c) {
-	const char *s;
+	int val;
 
 	if (ctx->seen_end) {
 		return (ISC_R_BADBASE64);
 	}
-	if ((s = strchr(base64, c)) == NULL) {
+	if ((val = base64val[(uint8_t)c]) == 0) {
 		return (ISC_R_BADBASE64);
 	}
-	ctx->val[ctx->digits++] = (int)(s - base64);
+	ctx->val[ctx->digits++] = val - 1;
 	if (ctx->digits == 4) {
 		int n;
 		unsigned char buf[3];
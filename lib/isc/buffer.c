@@ -569,8 +569,17 @@ isc_buffer_reserve(isc_buffer_t **dynbuffer, unsigned int size) {
 		return (ISC_R_NOSPACE);
 	}
 
-	/* Round to nearest buffer size increment */
+	/*
+	 * Grow the buffer at least twofold, so that a buffer filled a
+	 * little at a time is copied a logarithmic number of times rather
+	 * than once per increment.
+	 */
 	len = size + (*dynbuffer)->used;
+	if (len < (size_t)(*dynbuffer)->length * 2) {
+		len = (size_t)(*dynbuffer)->length * 2;
+	}
+
+	/* Round to nearest buffer size increment */
 	len = (len + ISC_BUFFER_INCR - 1 - ((len - 1) % ISC_BUFFER_INCR));
 
 	/* Cap at UINT_MAX */
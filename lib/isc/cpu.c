@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <strings.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#if defined(__aarch64__) && defined(HAVE_GETAUXVAL)
+#include <sys/auxv.h>
+#ifndef HWCAP_SHA1
+#define HWCAP_SHA1 (1 << 5)
+#endif
+#ifndef HWCAP_SHA2
+#define HWCAP_SHA2 (1 << 6)
+#endif
+#endif
+
+#include <isc/atomic.h>
+#include <isc/cpu.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include "cpu_p.h"
+
+/*
+ * The features of the CPU, without the disabled ones.
+ */
+static atomic_uint_fast32_t isc__cpu_features = 0;
+
+static const struct {
+	isc_cpu_feature_t feature;
+	const char *name;
+} featurenames[] = {
+	{ ISC_CPU_SSE42, "sse4.2" }, { ISC_CPU_AVX2, "avx2" },
+	{ ISC_CPU_AVX512, "avx512" }, { ISC_CPU_SHA, "sha" },
+	{ ISC_CPU_NEON, "neon" },
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+/*
+ * The wider registers can only be used if the operating system saves
+ * them on context switches, which XGETBV tells.
+ */
+static uint64_t
+xgetbv(void) {
+	uint32_t eax, edx;
+
+	__asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+
+	return (((uint64_t)edx << 32) | eax);
+}
+
+static uint32_t
+detect(void) {
+	unsigned int eax, ebx, ecx, edx;
+	uint32_t features = 0;
+	uint64_t xcr0 = 0;
+
+	if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0) {
+		return (0);
+	}
+
+	if ((ecx & bit_SSE4_2) != 0) {
+		features |= ISC_CPU_SSE42;
+	}
+	if ((ecx & bit_OSXSAVE) != 0) {
+		xcr0 = xgetbv();
+	}
+
+	if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) == 0) {
+		return (features);
+	}
+
+	/* XMM and YMM state */
+	if ((xcr0 & 0x06) == 0x06 && (ebx & bit_AVX2) != 0) {
+		features |= ISC_CPU_AVX2;
+	}
+	/* ... and opmask and ZMM state */
+	if ((xcr0 & 0xe6) == 0xe6 && (ebx & bit_AVX512F) != 0 &&
+	    (ebx & bit_AVX512BW) != 0)
+	{
+		features |= ISC_CPU_AVX512;
+	}
+	if ((ebx & bit_SHA) != 0) {
+		features |= ISC_CPU_SHA;
+	}
+
+	return (features);
+}
+#elif defined(__aarch64__)
+static uint32_t
+detect(void) {
+	/* Advanced SIMD is part of the ARMv8-A baseline. */
+	uint32_t features = ISC_CPU_NEON;
+
+#if defined(HAVE_GETAUXVAL)
+	unsigned long hwcap = getauxval(AT_HWCAP);
+	if ((hwcap & HWCAP_SHA1) != 0 && (hwcap & HWCAP_SHA2) != 0) {
+		features |= ISC_CPU_SHA;
+	}
+#endif
+
+	return (features);
+}
+#else
+static uint32_t
+detect(void) {
+#if defined(__ARM_NEON)
+	return (ISC_CPU_NEON);
+#else
+	return (0);
+#endif
+}
+#endif
+
+/*
+ * Return the features listed in 'list', separated by commas.
+ */
+static uint32_t
+parse(const char *list) {
+	char buf[256];
+	char *last = NULL;
+	uint32_t features = 0;
+
+	if (strcasecmp(list, "all") == 0) {
+		return (ISC_CPU_ALL);
+	}
+
+	strlcpy(buf, list, sizeof(buf));
+	for (char *name = strtok_r(buf, ", ", &last); name != NULL;
+	     name = strtok_r(NULL, ", ", &last))
+	{
+		for (size_t i = 0; i < ARRAY_SIZE(featurenames); i++) {
+			if (strcasecmp(name, featurenames[i].name) == 0) {
+				features |= featurenames[i].feature;
+			}
+		}
+	}
+
+	return (features);
+}
+
+void
+isc__cpu_initialize(void) {
+	const char *disable = getenv("ISC_CPU_DISABLE");
+	uint32_t features = detect();
+
+	if (disable != NULL) {
+		features &= ~parse(disable);
+	}
+
+	atomic_store_relaxed(&isc__cpu_features, features);
+}
+
+uint32_t
+isc_cpu_features(void) {
+	return (atomic_load_relaxed(&isc__cpu_features));
+}
+
+bool
+isc_cpu_has(isc_cpu_feature_t features) {
+	return ((isc_cpu_features() & features) == (uint32_t)features);
+}
+
+void
+isc_cpu_disable(uint32_t features) {
+	(void)atomic_fetch_and_relaxed(&isc__cpu_features, ~features);
+}
+
+const char *
+isc_cpu_featurename(isc_cpu_feature_t feature) {
+	for (size_t i = 0; i < ARRAY_SIZE(featurenames); i++) {
+		if (featurenames[i].feature == feature) {
+			return (featurenames[i].name);
+		}
+	}
+
+	return (NULL);
+}
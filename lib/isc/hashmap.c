@@ -0,0 +1,690 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * The table is an array of slots and a parallel array of one control
+ * byte per slot.  A control byte is either EMPTY, DELETED (a tombstone)
+ * or, for a used slot, the low 7 bits of the hash value of its key.  A
+ * lookup starts at the position given by the high bits of the hash
+ * value and compares a whole group of control bytes against the low
+ * bits at once, only looking at the slots whose control byte matched;
+ * it stops at the first group that has an EMPTY byte.  The first
+ * GROUP_SIZE control bytes are mirrored after the end of the array so
+ * that a group can be loaded from any position without wrapping.
+ *
+ * When the table has to grow, or to be rebuilt to get rid of the
+ * tombstones, a second table is allocated and the entries are moved to
+ * it REHASH_SLOTS slots at a time by each add and delete, like isc_ht
+ * does.  Lookups check both tables while that is in progress.
+ */
+
+#include <inttypes.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif /* if defined(__SSE2__) */
+
+#include <isc/ascii.h>
+#include <isc/endian.h>
+#include <isc/hash.h>
+#include <isc/hashmap.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/result.h>
+#include <isc/types.h>
+#include <isc/util.h>
+
+#define ISC_HASHMAP_MAGIC	   ISC_MAGIC('H', 'M', 'a', 'p')
+#define ISC_HASHMAP_VALID(hashmap) ISC_MAGIC_VALID(hashmap, ISC_HASHMAP_MAGIC)
+
+#define HASHMAP_NO_BITS	 0
+#define HASHMAP_MIN_BITS 4
+#define HASHMAP_MAX_BITS 32
+
+#define HASHMAP_NEXTTABLE(idx) ((idx == 0) ? 1 : 0)
+#define TRY_NEXTTABLE(idx, hashmap) \
+	(idx == hashmap->hindex && rehashing_in_progress(hashmap))
+
+#define GOLDEN_RATIO_32 0x61C88647
+
+#define HASHSIZE(bits) (UINT64_C(1) << (bits))
+
+/* Number of old slots moved to the new table by each add or delete */
+#define REHASH_SLOTS 64
+
+#define CTRL_EMPTY   ((int8_t)-128)
+#define CTRL_DELETED ((int8_t)-2)
+#define CTRL_ISFULL(c) ((c) >= 0)
+#define CTRL_HASH(h) ((int8_t)((h)&0x7f))
+
+#if defined(__SSE2__)
+
+#define GROUP_SIZE  16
+#define GROUP_SHIFT 0
+
+typedef __m128i	 group_t;
+typedef uint32_t bitmask_t;
+
+static group_t
+group_load(const int8_t *ctrl) {
+	return (_mm_loadu_si128((const __m128i *)ctrl));
+}
+
+static bitmask_t
+group_match(group_t group, int8_t hash) {
+	return ((bitmask_t)_mm_movemask_epi8(
+		_mm_cmpeq_epi8(group, _mm_set1_epi8(hash))));
+}
+
+static bitmask_t
+group_match_empty(group_t group) {
+	return (group_match(group, CTRL_EMPTY));
+}
+
+static bitmask_t
+group_match_free(group_t group) {
+	/* EMPTY and DELETED both have the high bit set */
+	return ((bitmask_t)_mm_movemask_epi8(group));
+}
+
+#else /* if defined(__SSE2__) */
+
+/*
+ * Without SSE2, compare 8 control bytes at a time in a 64-bit word;
+ * each matching byte has its high bit set in the bitmask.
+ */
+#define GROUP_SIZE  8
+#define GROUP_SHIFT 3
+
+#define GROUP_LSBS UINT64_C(0x0101010101010101)
+#define GROUP_MSBS UINT64_C(0x8080808080808080)
+
+typedef uint64_t group_t;
+typedef uint64_t bitmask_t;
+
+static group_t
+group_load(const int8_t *ctrl) {
+	uint64_t group;
+
+	memmove(&group, ctrl, sizeof(group));
+
+	return (le64toh(group));
+}
+
+static bitmask_t
+group_match(group_t group, int8_t hash) {
+	/*
+	 * This can report a false match for a byte that is preceded by a
+	 * real match, but only for used slots; the hash value and the
+	 * key are checked afterwards anyway.
+	 */
+	uint64_t x = group ^ (GROUP_LSBS * (uint8_t)hash);
+
+	return ((x - GROUP_LSBS) & ~x & GROUP_MSBS);
+}
+
+static bitmask_t
+group_match_empty(group_t group) {
+	/* EMPTY is the only value with the high bit set and bit 1 clear */
+	return (group & ~(group << 6) & GROUP_MSBS);
+}
+
+static bitmask_t
+group_match_free(group_t group) {
+	return (group & GROUP_MSBS);
+}
+
+#endif /* if defined(__SSE2__) */
+
+STATIC_ASSERT(HASHSIZE(HASHMAP_MIN_BITS) >= GROUP_SIZE,
+	      "the smallest table must hold at least one group");
+
+/*
+ * Return the offset of the first match in the group.
+ */
+static unsigned int
+bitmask_first(bitmask_t mask) {
+	INSIST(mask != 0);
+#if HAVE_BUILTIN_CTZLL
+	return (__builtin_ctzll(mask) >> GROUP_SHIFT);
+#else  /* if HAVE_BUILTIN_CTZLL */
+	unsigned int bit = 0;
+
+	while ((mask & 1) == 0) {
+		mask >>= 1;
+		bit++;
+	}
+
+	return (bit >> GROUP_SHIFT);
+#endif /* if HAVE_BUILTIN_CTZLL */
+}
+
+typedef struct hashmap_slot {
+	const uint8_t *key;
+	void *value;
+	uint32_t hashval;
+	uint32_t keysize;
+} hashmap_slot_t;
+
+typedef struct hashmap_table {
+	int8_t *ctrl;
+	hashmap_slot_t *slots;
+	size_t size;
+	size_t growth; /* EMPTY slots that can still be used */
+	uint8_t bits;
+} hashmap_table_t;
+
+struct isc_hashmap {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	size_t count;
+	bool case_sensitive;
+	uint8_t hindex;
+	size_t hiter; /* rehashing iterator */
+	hashmap_table_t tables[2];
+};
+
+struct isc_hashmap_iter {
+	isc_hashmap_t *hashmap;
+	size_t i;
+	uint8_t hindex;
+};
+
+static bool
+rehashing_in_progress(const isc_hashmap_t *hashmap) {
+	return (hashmap->tables[HASHMAP_NEXTTABLE(hashmap->hindex)].ctrl !=
+		NULL);
+}
+
+static uint32_t
+hash_32(uint32_t val, unsigned int bits) {
+	REQUIRE(bits <= HASHMAP_MAX_BITS);
+	/* High bits are more random. */
+	return (val * GOLDEN_RATIO_32 >> (32 - bits));
+}
+
+static bool
+hashmap_match(const isc_hashmap_t *hashmap, const hashmap_slot_t *slot,
+	      const uint32_t hashval, const uint8_t *key,
+	      const uint32_t keysize) {
+	if (slot->hashval != hashval || slot->keysize != keysize) {
+		return (false);
+	}
+	if (hashmap->case_sensitive) {
+		return (memcmp(slot->key, key, keysize) == 0);
+	}
+	return (isc_ascii_lowerequal(slot->key, key, keysize));
+}
+
+static void
+table_setctrl(hashmap_table_t *table, size_t idx, int8_t ctrl) {
+	table->ctrl[idx] = ctrl;
+	if (idx < GROUP_SIZE) {
+		table->ctrl[table->size + idx] = ctrl;
+	}
+}
+
+static void
+table_new(isc_hashmap_t *hashmap, hashmap_table_t *table, uint8_t bits) {
+	REQUIRE(table->ctrl == NULL);
+	REQUIRE(bits >= HASHMAP_MIN_BITS);
+	REQUIRE(bits <= HASHMAP_MAX_BITS);
+
+	table->bits = bits;
+	table->size = HASHSIZE(bits);
+	/* Keep at least 1/8 of the slots EMPTY so that probing ends */
+	table->growth = table->size - table->size / 8;
+
+	table->ctrl = isc_mem_get(hashmap->mctx, table->size + GROUP_SIZE);
+	memset(table->ctrl, CTRL_EMPTY, table->size + GROUP_SIZE);
+
+	table->slots = isc_mem_get(hashmap->mctx,
+				   table->size * sizeof(table->slots[0]));
+	memset(table->slots, 0, table->size * sizeof(table->slots[0]));
+}
+
+static void
+table_free(isc_hashmap_t *hashmap, hashmap_table_t *table) {
+	isc_mem_put(hashmap->mctx, table->ctrl, table->size + GROUP_SIZE);
+	isc_mem_put(hashmap->mctx, table->slots,
+		    table->size * sizeof(table->slots[0]));
+	*table = (hashmap_table_t){ .bits = HASHMAP_NO_BITS };
+}
+
+/*
+ * Return the index of the slot holding 'key', or table->size.
+ */
+static size_t
+table_find(const isc_hashmap_t *hashmap, const hashmap_table_t *table,
+	   const uint32_t hashval, const uint8_t *key,
+	   const uint32_t keysize) {
+	size_t mask = table->size - 1;
+	size_t pos = hash_32(hashval, table->bits);
+	size_t stride = 0;
+
+	for (;;) {
+		group_t group = group_load(&table->ctrl[pos]);
+
+		for (bitmask_t match = group_match(group, CTRL_HASH(hashval));
+		     match != 0; match &= match - 1)
+		{
+			size_t idx = (pos + bitmask_first(match)) & mask;
+			if (hashmap_match(hashmap, &table->slots[idx], hashval,
+					  key, keysize))
+			{
+				return (idx);
+			}
+		}
+
+		if (group_match_empty(group) != 0) {
+			return (table->size);
+		}
+
+		/* Triangular probing visits every group exactly once */
+		stride += GROUP_SIZE;
+		pos = (pos + stride) & mask;
+		INSIST(stride <= table->size);
+	}
+}
+
+static void
+table_insert(hashmap_table_t *table, const hashmap_slot_t *slot) {
+	size_t mask = table->size - 1;
+	size_t pos = hash_32(slot->hashval, table->bits);
+	size_t stride = 0;
+	bitmask_t avail;
+	size_t idx;
+
+	while ((avail = group_match_free(group_load(&table->ctrl[pos]))) == 0)
+	{
+		stride += GROUP_SIZE;
+		pos = (pos + stride) & mask;
+		INSIST(stride <= table->size);
+	}
+
+	idx = (pos + bitmask_first(avail)) & mask;
+	if (table->ctrl[idx] == CTRL_EMPTY) {
+		INSIST(table->growth > 0);
+		table->growth--;
+	}
+
+	table_setctrl(table, idx, CTRL_HASH(slot->hashval));
+	table->slots[idx] = *slot;
+}
+
+static void
+table_delete(hashmap_table_t *table, size_t idx) {
+	size_t mask = table->size - 1;
+	size_t run = 1;
+
+	/*
+	 * If no GROUP_SIZE window around the slot has ever been without
+	 * an EMPTY byte, no lookup can have probed past it, and it can be
+	 * made EMPTY again instead of leaving a tombstone.
+	 */
+	for (size_t i = 1; i < GROUP_SIZE; i++) {
+		if (table->ctrl[(idx + i) & mask] == CTRL_EMPTY) {
+			break;
+		}
+		run++;
+	}
+	for (size_t i = 1; i < GROUP_SIZE; i++) {
+		if (table->ctrl[(idx - i) & mask] == CTRL_EMPTY) {
+			break;
+		}
+		run++;
+	}
+
+	if (run < GROUP_SIZE) {
+		table_setctrl(table, idx, CTRL_EMPTY);
+		table->growth++;
+	} else {
+		table_setctrl(table, idx, CTRL_DELETED);
+	}
+	table->slots[idx] = (hashmap_slot_t){ 0 };
+}
+
+static void
+hashmap_rehash_one(isc_hashmap_t *hashmap) {
+	hashmap_table_t *newtable = &hashmap->tables[hashmap->hindex];
+	hashmap_table_t *oldtable =
+		&hashmap->tables[HASHMAP_NEXTTABLE(hashmap->hindex)];
+	size_t end = ISC_MIN(hashmap->hiter + REHASH_SLOTS, oldtable->size);
+
+	for (; hashmap->hiter < end; hashmap->hiter++) {
+		if (CTRL_ISFULL(oldtable->ctrl[hashmap->hiter])) {
+			table_insert(newtable,
+				     &oldtable->slots[hashmap->hiter]);
+			table_setctrl(oldtable, hashmap->hiter, CTRL_DELETED);
+		}
+	}
+
+	/* Rehashing complete */
+	if (hashmap->hiter == oldtable->size) {
+		table_free(hashmap, oldtable);
+		hashmap->hiter = 0;
+	}
+}
+
+/*
+ * Start moving the entries to a new table: a bigger one if the table is
+ * more than half full, otherwise one of the same size without the
+ * tombstones.  Either way, the new table has room for all the entries
+ * plus those added before the old table is drained, so a rehash is never
+ * requested while another one is in progress.
+ */
+static void
+hashmap_rehash_start(isc_hashmap_t *hashmap) {
+	uint8_t oldindex = hashmap->hindex;
+	uint8_t newindex = HASHMAP_NEXTTABLE(oldindex);
+	uint8_t bits = hashmap->tables[oldindex].bits;
+
+	REQUIRE(!rehashing_in_progress(hashmap));
+
+	if (hashmap->count > hashmap->tables[oldindex].size / 2) {
+		RUNTIME_CHECK(bits < HASHMAP_MAX_BITS);
+		bits++;
+	}
+
+	table_new(hashmap, &hashmap->tables[newindex], bits);
+	hashmap->hindex = newindex;
+	hashmap->hiter = 0;
+
+	hashmap_rehash_one(hashmap);
+}
+
+void
+isc_hashmap_create(isc_mem_t *mctx, uint8_t bits, unsigned int options,
+		   isc_hashmap_t **hashmapp) {
+	isc_hashmap_t *hashmap = NULL;
+	bool case_sensitive =
+		((options & ISC_HASHMAP_CASE_INSENSITIVE) == 0);
+
+	REQUIRE(hashmapp != NULL && *hashmapp == NULL);
+	REQUIRE(mctx != NULL);
+	REQUIRE(bits >= 1 && bits <= HASHMAP_MAX_BITS);
+
+	hashmap = isc_mem_get(mctx, sizeof(*hashmap));
+	*hashmap = (isc_hashmap_t){
+		.case_sensitive = case_sensitive,
+	};
+
+	isc_mem_attach(mctx, &hashmap->mctx);
+
+	table_new(hashmap, &hashmap->tables[0],
+		  ISC_MAX(bits, HASHMAP_MIN_BITS));
+
+	hashmap->magic = ISC_HASHMAP_MAGIC;
+
+	*hashmapp = hashmap;
+}
+
+void
+isc_hashmap_destroy(isc_hashmap_t **hashmapp) {
+	isc_hashmap_t *hashmap = NULL;
+
+	REQUIRE(hashmapp != NULL);
+	REQUIRE(ISC_HASHMAP_VALID(*hashmapp));
+
+	hashmap = *hashmapp;
+	*hashmapp = NULL;
+	hashmap->magic = 0;
+
+	for (size_t i = 0; i <= 1; i++) {
+		if (hashmap->tables[i].ctrl != NULL) {
+			table_free(hashmap, &hashmap->tables[i]);
+		}
+	}
+
+	isc_mem_putanddetach(&hashmap->mctx, hashmap, sizeof(*hashmap));
+}
+
+static hashmap_slot_t *
+hashmap_find(const isc_hashmap_t *hashmap, const uint32_t hashval,
+	     const uint8_t *key, const uint32_t keysize) {
+	uint8_t findex = hashmap->hindex;
+
+	for (;;) {
+		const hashmap_table_t *table = &hashmap->tables[findex];
+		size_t idx = table_find(hashmap, table, hashval, key, keysize);
+		if (idx != table->size) {
+			return (&table->slots[idx]);
+		}
+		if (!TRY_NEXTTABLE(findex, hashmap)) {
+			return (NULL);
+		}
+		/*
+		 * Rehashing in progress, check the other table
+		 */
+		findex = HASHMAP_NEXTTABLE(findex);
+	}
+}
+
+isc_result_t
+isc_hashmap_add(isc_hashmap_t *hashmap, const uint8_t *key,
+		const uint32_t keysize, void *value) {
+	uint32_t hashval;
+
+	REQUIRE(ISC_HASHMAP_VALID(hashmap));
+	REQUIRE(key != NULL && keysize > 0);
+
+	hashval = isc_hash32(key, keysize, hashmap->case_sensitive);
+
+	if (hashmap_find(hashmap, hashval, key, keysize) != NULL) {
+		return (ISC_R_EXISTS);
+	}
+
+	if (rehashing_in_progress(hashmap)) {
+		/* Rehash in progress */
+		hashmap_rehash_one(hashmap);
+	}
+
+	if (hashmap->tables[hashmap->hindex].growth == 0) {
+		/* Rehash requested */
+		hashmap_rehash_start(hashmap);
+	}
+
+	table_insert(&hashmap->tables[hashmap->hindex],
+		     &(hashmap_slot_t){
+			     .key = key,
+			     .value = value,
+			     .hashval = hashval,
+			     .keysize = keysize,
+		     });
+	hashmap->count++;
+
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+isc_hashmap_find(const isc_hashmap_t *hashmap, const uint8_t *key,
+		 const uint32_t keysize, void **valuep) {
+	uint32_t hashval;
+	hashmap_slot_t *slot = NULL;
+
+	REQUIRE(ISC_HASHMAP_VALID(hashmap));
+	REQUIRE(key != NULL && keysize > 0);
+	REQUIRE(valuep == NULL || *valuep == NULL);
+
+	hashval = isc_hash32(key, keysize, hashmap->case_sensitive);
+
+	slot = hashmap_find(hashmap, hashval, key, keysize);
+	if (slot == NULL) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	if (valuep != NULL) {
+		*valuep = slot->value;
+	}
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+isc_hashmap_delete(isc_hashmap_t *hashmap, const uint8_t *key,
+		   const uint32_t keysize) {
+	uint32_t hashval;
+	uint8_t hindex;
+
+	REQUIRE(ISC_HASHMAP_VALID(hashmap));
+	REQUIRE(key != NULL && keysize > 0);
+
+	if (rehashing_in_progress(hashmap)) {
+		/* Rehash in progress */
+		hashmap_rehash_one(hashmap);
+	}
+
+	hindex = hashmap->hindex;
+	hashval = isc_hash32(key, keysize, hashmap->case_sensitive);
+	for (;;) {
+		hashmap_table_t *table = &hashmap->tables[hindex];
+		size_t idx = table_find(hashmap, table, hashval, key, keysize);
+		if (idx != table->size) {
+			table_delete(table, idx);
+			hashmap->count--;
+			return (ISC_R_SUCCESS);
+		}
+		if (!TRY_NEXTTABLE(hindex, hashmap)) {
+			return (ISC_R_NOTFOUND);
+		}
+		/*
+		 * Rehashing in progress, check the other table
+		 */
+		hindex = HASHMAP_NEXTTABLE(hindex);
+	}
+}
+
+void
+isc_hashmap_iter_create(isc_hashmap_t *hashmap, isc_hashmap_iter_t **iterp) {
+	isc_hashmap_iter_t *iter = NULL;
+
+	REQUIRE(ISC_HASHMAP_VALID(hashmap));
+	REQUIRE(iterp != NULL && *iterp == NULL);
+
+	iter = isc_mem_get(hashmap->mctx, sizeof(*iter));
+	*iter = (isc_hashmap_iter_t){
+		.hashmap = hashmap,
+		.hindex = hashmap->hindex,
+	};
+
+	*iterp = iter;
+}
+
+void
+isc_hashmap_iter_destroy(isc_hashmap_iter_t **iterp) {
+	isc_hashmap_iter_t *iter = NULL;
+
+	REQUIRE(iterp != NULL && *iterp != NULL);
+
+	iter = *iterp;
+	*iterp = NULL;
+	isc_mem_put(iter->hashmap->mctx, iter, sizeof(*iter));
+}
+
+static isc_result_t
+hashmap_iter_next(isc_hashmap_iter_t *iter) {
+	isc_hashmap_t *hashmap = iter->hashmap;
+
+	for (;;) {
+		hashmap_table_t *table = &hashmap->tables[iter->hindex];
+
+		while (iter->i < table->size) {
+			if (CTRL_ISFULL(table->ctrl[iter->i])) {
+				return (ISC_R_SUCCESS);
+			}
+			iter->i++;
+		}
+
+		if (!TRY_NEXTTABLE(iter->hindex, hashmap)) {
+			return (ISC_R_NOMORE);
+		}
+
+		iter->hindex = HASHMAP_NEXTTABLE(iter->hindex);
+		iter->i = 0;
+	}
+}
+
+static hashmap_slot_t *
+hashmap_iter_slot(isc_hashmap_iter_t *iter) {
+	hashmap_table_t *table = &iter->hashmap->tables[iter->hindex];
+
+	REQUIRE(iter->i < table->size && CTRL_ISFULL(table->ctrl[iter->i]));
+
+	return (&table->slots[iter->i]);
+}
+
+isc_result_t
+isc_hashmap_iter_first(isc_hashmap_iter_t *iter) {
+	REQUIRE(iter != NULL);
+
+	iter->hindex = iter->hashmap->hindex;
+	iter->i = 0;
+
+	return (hashmap_iter_next(iter));
+}
+
+isc_result_t
+isc_hashmap_iter_next(isc_hashmap_iter_t *iter) {
+	REQUIRE(iter != NULL);
+
+	(void)hashmap_iter_slot(iter);
+	iter->i++;
+
+	return (hashmap_iter_next(iter));
+}
+
+isc_result_t
+isc_hashmap_iter_delcurrent_next(isc_hashmap_iter_t *iter) {
+	isc_hashmap_t *hashmap = NULL;
+
+	REQUIRE(iter != NULL);
+
+	hashmap = iter->hashmap;
+
+	/* Deleting does not move the other entries */
+	(void)hashmap_iter_slot(iter);
+	table_delete(&hashmap->tables[iter->hindex], iter->i);
+	hashmap->count--;
+	iter->i++;
+
+	return (hashmap_iter_next(iter));
+}
+
+void
+isc_hashmap_iter_current(isc_hashmap_iter_t *iter, void **valuep) {
+	REQUIRE(iter != NULL);
+	REQUIRE(valuep != NULL && *valuep == NULL);
+
+	*valuep = hashmap_iter_slot(iter)->value;
+}
+
+void
+isc_hashmap_iter_currentkey(isc_hashmap_iter_t *iter, const uint8_t **key,
+			    size_t *keysize) {
+	hashmap_slot_t *slot = NULL;
+
+	REQUIRE(iter != NULL);
+	REQUIRE(key != NULL && *key == NULL);
+	REQUIRE(keysize != NULL);
+
+	slot = hashmap_iter_slot(iter);
+	*key = slot->key;
+	*keysize = slot->keysize;
+}
+
+size_t
+isc_hashmap_count(const isc_hashmap_t *hashmap) {
+	REQUIRE(ISC_HASHMAP_VALID(hashmap));
+
+	return (hashmap->count);
+}
@@ -31,13 +31,17 @@
 
 /*@{*/
 /*%
- * Note: to make heap_parent and heap_left easy to compute, the first
- * element of the heap array is not used; i.e. heap subscripts are 1-based,
- * not 0-based.  The parent is index/2, and the left-child is index*2.
- * The right child is index*2+1.
+ * The heap is 4-ary: each element has up to four children, which are
+ * adjacent in the array, so the heap is half as deep as a binary one and
+ * the children compared when sinking an element share a cache line.
+ *
+ * Note: the first element of the heap array is not used; i.e. heap
+ * subscripts are 1-based, not 0-based.  The parent is (index+2)/4, and
+ * the children are index*4-2 to index*4+1.
  */
-#define heap_parent(i) ((i) >> 1)
-#define heap_left(i)   ((i) << 1)
+#define heap_parent(i) (((i) + 2) >> 2)
+#define heap_child(i)  (((i) << 2) - 2)
+#define HEAP_ARITY     4
 /*@}*/
 
 #define SIZE_INCREMENT 1024
@@ -122,13 +126,17 @@ isc_heap_destroy(isc_heap_t **heapp) {
 }
 
 static void
-resize(isc_heap_t *heap) {
+resize(isc_heap_t *heap, unsigned int needed) {
 	void **new_array;
 	unsigned int new_size;
 
 	REQUIRE(VALID_HEAP(heap));
 
 	new_size = heap->size + heap->size_increment;
+	if (new_size <= needed) {
+		new_size = needed + heap->size_increment;
+		RUNTIME_CHECK(new_size > needed); /* overflow check */
+	}
 	new_array = isc_mem_get(heap->mctx, new_size * sizeof(void *));
 	if (heap->array != NULL) {
 		memmove(new_array, heap->array, heap->size * sizeof(void *));
@@ -160,17 +168,24 @@ float_up(isc_heap_t *heap, unsigned int i, void *elt) {
 	heap_check(heap);
 }
 
-static void
+/*
+ * Sink 'elt' from index 'i' to its place below it, and return that
+ * place.  The heap condition holds there once the elements above it are
+ * in order, which is not yet the case while rebuilding the heap.
+ */
+static unsigned int
 sink_down(isc_heap_t *heap, unsigned int i, void *elt) {
-	unsigned int j, size, half_size;
+	unsigned int j, k, end, size, inner_size;
 	size = heap->last;
-	half_size = size / 2;
-	while (i <= half_size) {
-		/* Find the smallest of the (at most) two children. */
-		j = heap_left(i);
-		if (j < size &&
-		    heap->compare(heap->array[j + 1], heap->array[j])) {
-			j++;
+	inner_size = (size + 2) / HEAP_ARITY;
+	while (i <= inner_size) {
+		/* Find the smallest of the (at most) four children. */
+		j = heap_child(i);
+		end = ISC_MIN(j + HEAP_ARITY - 1, size);
+		for (k = j + 1; k <= end; k++) {
+			if (heap->compare(heap->array[k], heap->array[j])) {
+				j = k;
+			}
 		}
 		if (heap->compare(elt, heap->array[j])) {
 			break;
@@ -186,8 +201,7 @@ sink_down(isc_heap_t *heap, unsigned int i, void *elt) {
 		(heap->index)(heap->array[i], i);
 	}
 
-	INSIST(HEAPCONDITION(i));
-	heap_check(heap);
+	return (i);
 }
 
 void
@@ -200,13 +214,57 @@ isc_heap_insert(isc_heap_t *heap, void *elt) {
 	new_last = heap->last + 1;
 	RUNTIME_CHECK(new_last > 0); /* overflow check */
 	if (new_last >= heap->size) {
-		resize(heap);
+		resize(heap, new_last);
 	}
 	heap->last = new_last;
 
 	float_up(heap, new_last, elt);
 }
 
+void
+isc_heap_insert_many(isc_heap_t *heap, void **elts, unsigned int count) {
+	unsigned int first, new_last;
+
+	REQUIRE(VALID_HEAP(heap));
+	REQUIRE(elts != NULL || count == 0);
+
+	heap_check(heap);
+	if (count == 0) {
+		return;
+	}
+	new_last = heap->last + count;
+	RUNTIME_CHECK(new_last >= heap->last); /* overflow check */
+	if (new_last >= heap->size) {
+		resize(heap, new_last);
+	}
+
+	/*
+	 * Inserting the elements one by one costs O(count * log(last)),
+	 * and rebuilding the whole heap bottom-up costs O(last); rebuild
+	 * when the heap at least doubles.
+	 */
+	if (count < heap->last) {
+		for (unsigned int i = 0; i < count; i++) {
+			heap->last++;
+			float_up(heap, heap->last, elts[i]);
+		}
+		return;
+	}
+
+	first = heap->last + 1;
+	memmove(&heap->array[first], elts, count * sizeof(void *));
+	heap->last = new_last;
+	if (heap->index != NULL) {
+		for (unsigned int i = first; i <= new_last; i++) {
+			(heap->index)(heap->array[i], i);
+		}
+	}
+	for (unsigned int i = heap_parent(new_last); i >= 1; i--) {
+		(void)sink_down(heap, i, heap->array[i]);
+	}
+	heap_check(heap);
+}
+
 void
 isc_heap_delete(isc_heap_t *heap, unsigned int idx) {
 	void *elt;
@@ -233,7 +291,9 @@ isc_heap_delete(isc_heap_t *heap, unsigned int idx) {
 		if (less) {
 			float_up(heap, idx, heap->array[idx]);
 		} else {
-			sink_down(heap, idx, heap->array[idx]);
+			idx = sink_down(heap, idx, heap->array[idx]);
+			INSIST(HEAPCONDITION(idx));
+			heap_check(heap);
 		}
 	}
 }
@@ -251,7 +311,9 @@ isc_heap_decreased(isc_heap_t *heap, unsigned int idx) {
 	REQUIRE(VALID_HEAP(heap));
 	REQUIRE(idx >= 1 && idx <= heap->last);
 
-	sink_down(heap, idx, heap->array[idx]);
+	idx = sink_down(heap, idx, heap->array[idx]);
+	INSIST(HEAPCONDITION(idx));
+	heap_check(heap);
 }
 
 void *
@@ -70,7 +70,7 @@ isc_hex_totext(isc_region_t *source, int wordlength, const char *wordbreak,
 	while (source->length > 0) {
 		buf[0] = hex[(source->base[0] >> 4) & 0xf];
 		buf[1] = hex[(source->base[0]) & 0xf];
-		RETERR(str_totext(buf, target));
+		RETERR(mem_tobuffer(target, buf, 2));
 		isc_region_consume(source, 1);
 
 		loops++;
@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/atomic.h>
+#include <isc/histo.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/refcount.h>
+#include <isc/tid.h>
+#include <isc/util.h>
+
+#define HISTO_MAGIC    ISC_MAGIC('H', 's', 't', 'o')
+#define HISTO_VALID(p) ISC_MAGIC_VALID(p, HISTO_MAGIC)
+
+/*
+ * The buckets are grouped into chunks of 2^sigbits buckets.  Chunk 0
+ * counts the values below 2^sigbits, one value per bucket.  Chunk c > 0
+ * counts the values from 2^(sigbits + c - 1) to 2^(sigbits + c) - 1 in
+ * buckets 2^(c - 1) wide.  A 64-bit value has its most significant bit
+ * at most at bit 63, so there are 65 - sigbits chunks.
+ */
+#define CHUNKS(sigbits) (65 - (sigbits))
+
+typedef atomic_uint_fast64_t hg_bucket_t;
+typedef atomic_uintptr_t hg_chunk_t; /*%< hg_bucket_t *, or 0 */
+
+struct isc_histo {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	isc_refcount_t references;
+	unsigned int sigbits;
+	unsigned int nchunks;
+	unsigned int nshards;
+	hg_chunk_t *chunks; /*%< nshards * nchunks */
+};
+
+static unsigned int
+value_chunk(const isc_histo_t *hg, uint64_t value) {
+	unsigned int msb;
+
+	if (value < (UINT64_C(1) << hg->sigbits)) {
+		return (0);
+	}
+
+	msb = 63 - __builtin_clzll(value);
+	return (msb - hg->sigbits + 1);
+}
+
+static unsigned int
+value_bucket(const isc_histo_t *hg, unsigned int chunk, uint64_t value) {
+	if (chunk == 0) {
+		return ((unsigned int)value);
+	}
+
+	return ((unsigned int)(value >> (chunk - 1)) -
+		(1U << hg->sigbits));
+}
+
+static hg_chunk_t *
+shard_chunks(const isc_histo_t *hg) {
+	uint32_t tid = isc_tid();
+
+	if (tid == ISC_TID_UNKNOWN) {
+		tid = 0;
+	}
+
+	return (&hg->chunks[(tid % hg->nshards) * hg->nchunks]);
+}
+
+static hg_bucket_t *
+load_chunk(const hg_chunk_t *chunkp) {
+	return ((hg_bucket_t *)atomic_load_acquire(chunkp));
+}
+
+static hg_bucket_t *
+get_chunk(isc_histo_t *hg, hg_chunk_t *chunkp) {
+	hg_bucket_t *chunk = load_chunk(chunkp);
+	uintptr_t expected = 0;
+	unsigned int size = 1U << hg->sigbits;
+
+	if (chunk != NULL) {
+		return (chunk);
+	}
+
+	chunk = isc_mem_get(hg->mctx, size * sizeof(chunk[0]));
+	for (unsigned int i = 0; i < size; i++) {
+		atomic_init(&chunk[i], 0);
+	}
+
+	if (!atomic_compare_exchange_strong_acq_rel(chunkp, &expected,
+						    (uintptr_t)chunk))
+	{
+		/*
+		 * Another thread counting into this shard got there
+		 * first.
+		 */
+		isc_mem_put(hg->mctx, chunk, size * sizeof(chunk[0]));
+		chunk = (hg_bucket_t *)expected;
+	}
+
+	return (chunk);
+}
+
+void
+isc_histo_create(isc_mem_t *mctx, unsigned int sigbits, unsigned int nshards,
+		 isc_histo_t **hgp) {
+	isc_histo_t *hg = NULL;
+	size_t count;
+
+	REQUIRE(sigbits >= ISC_HISTO_MINBITS && sigbits <= ISC_HISTO_MAXBITS);
+	REQUIRE(nshards > 0);
+	REQUIRE(hgp != NULL && *hgp == NULL);
+
+	hg = isc_mem_get(mctx, sizeof(*hg));
+	*hg = (isc_histo_t){
+		.sigbits = sigbits,
+		.nchunks = CHUNKS(sigbits),
+		.nshards = nshards,
+	};
+	isc_mem_attach(mctx, &hg->mctx);
+	isc_refcount_init(&hg->references, 1);
+
+	count = (size_t)hg->nshards * hg->nchunks;
+	hg->chunks = isc_mem_get(mctx, count * sizeof(hg->chunks[0]));
+	for (size_t i = 0; i < count; i++) {
+		atomic_init(&hg->chunks[i], 0);
+	}
+
+	hg->magic = HISTO_MAGIC;
+	*hgp = hg;
+}
+
+void
+isc_histo_attach(isc_histo_t *source, isc_histo_t **targetp) {
+	REQUIRE(HISTO_VALID(source));
+	REQUIRE(targetp != NULL && *targetp == NULL);
+
+	isc_refcount_increment(&source->references);
+
+	*targetp = source;
+}
+
+static void
+destroy(isc_histo_t *hg) {
+	size_t count = (size_t)hg->nshards * hg->nchunks;
+	unsigned int size = 1U << hg->sigbits;
+
+	isc_refcount_destroy(&hg->references);
+	hg->magic = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		hg_bucket_t *chunk = load_chunk(&hg->chunks[i]);
+		if (chunk != NULL) {
+			isc_mem_put(hg->mctx, chunk, size * sizeof(chunk[0]));
+		}
+	}
+	isc_mem_put(hg->mctx, hg->chunks, count * sizeof(hg->chunks[0]));
+	isc_mem_putanddetach(&hg->mctx, hg, sizeof(*hg));
+}
+
+void
+isc_histo_detach(isc_histo_t **hgp) {
+	isc_histo_t *hg = NULL;
+
+	REQUIRE(hgp != NULL && HISTO_VALID(*hgp));
+
+	hg = *hgp;
+	*hgp = NULL;
+
+	if (isc_refcount_decrement(&hg->references) == 1) {
+		destroy(hg);
+	}
+}
+
+void
+isc_histo_add(isc_histo_t *hg, uint64_t value, uint64_t inc) {
+	unsigned int c;
+	hg_bucket_t *chunk = NULL;
+
+	REQUIRE(HISTO_VALID(hg));
+
+	c = value_chunk(hg, value);
+	chunk = get_chunk(hg, &shard_chunks(hg)[c]);
+	atomic_fetch_add_relaxed(&chunk[value_bucket(hg, c, value)], inc);
+}
+
+void
+isc_histo_inc(isc_histo_t *hg, uint64_t value) {
+	isc_histo_add(hg, value, 1);
+}
+
+isc_result_t
+isc_histo_get(isc_histo_t *hg, unsigned int key, uint64_t *minp,
+	      uint64_t *maxp, uint64_t *countp) {
+	unsigned int c, b;
+	uint64_t min, max, count = 0;
+
+	REQUIRE(HISTO_VALID(hg));
+
+	c = key >> hg->sigbits;
+	b = key & ((1U << hg->sigbits) - 1);
+	if (c >= hg->nchunks) {
+		return (ISC_R_RANGE);
+	}
+
+	if (c == 0) {
+		min = max = b;
+	} else {
+		min = (uint64_t)((1U << hg->sigbits) + b) << (c - 1);
+		max = min + ((UINT64_C(1) << (c - 1)) - 1);
+	}
+
+	if (countp != NULL) {
+		for (unsigned int s = 0; s < hg->nshards; s++) {
+			hg_bucket_t *chunk =
+				load_chunk(&hg->chunks[s * hg->nchunks + c]);
+			if (chunk != NULL) {
+				count += atomic_load_relaxed(&chunk[b]);
+			}
+		}
+		*countp = count;
+	}
+
+	if (minp != NULL) {
+		*minp = min;
+	}
+	if (maxp != NULL) {
+		*maxp = max;
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+void
+isc_histo_next(isc_histo_t *hg, unsigned int *keyp) {
+	unsigned int key;
+
+	REQUIRE(HISTO_VALID(hg));
+	REQUIRE(keyp != NULL);
+
+	key = *keyp + 1;
+	while ((key >> hg->sigbits) < hg->nchunks) {
+		unsigned int c = key >> hg->sigbits;
+		bool allocated = false;
+
+		for (unsigned int s = 0; s < hg->nshards && !allocated; s++) {
+			allocated = (load_chunk(&hg->chunks[s * hg->nchunks +
+							    c]) != NULL);
+		}
+		if (allocated) {
+			break;
+		}
+
+		/* Skip to the first bucket of the next chunk. */
+		key = (c + 1) << hg->sigbits;
+	}
+
+	*keyp = key;
+}
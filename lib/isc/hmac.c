@@ -67,6 +67,18 @@ isc_hmac_init(isc_hmac_t *hmac, const void *key, const size_t keylen,
 	return (ISC_R_SUCCESS);
 }
 
+isc_result_t
+isc_hmac_copy(isc_hmac_t *dst, const isc_hmac_t *src) {
+	REQUIRE(dst != NULL);
+	REQUIRE(src != NULL);
+
+	if (EVP_MD_CTX_copy_ex(dst, src) != 1) {
+		return (ISC_R_CRYPTOFAILURE);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
 isc_result_t
 isc_hmac_reset(isc_hmac_t *hmac) {
 	REQUIRE(hmac != NULL);
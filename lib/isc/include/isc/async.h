@@ -15,10 +15,11 @@
  * \brief The isc_async unit provides a way to schedule jobs on any isc
  * event loop (isc_loop unit)
  *
- * The unit is built around the uv_async_t primitive and locked list with
- * isc_job_cb.  Jobs are first scheduled onto the locked list, then the
- * uv_async_send() is called and the uv_async_t callback processes the enqueued
- * jobs are scheduled to be run on the isc event loop.
+ * The unit is built around the uv_async_t primitive and a lock-free queue
+ * of isc_job_cb jobs.  Jobs are first pushed onto the queue of the loop,
+ * then, if the queue was empty, uv_async_send() is called and the
+ * uv_async_t callback takes all the enqueued jobs at once and schedules
+ * them to be run on the isc event loop.
  */
 
 #pragma once
@@ -33,10 +34,13 @@
 
 ISC_LANG_BEGINDECLS
 
+#define isc_async_run(loop, cb, cbarg) \
+	isc__async_run(loop, cb, cbarg, #cb)
 void
-isc_async_run(isc_loop_t *loop, isc_job_cb cb, void *cbarg);
+isc__async_run(isc_loop_t *loop, isc_job_cb cb, void *cbarg, const char *name);
 /*%<
  * Schedule the job callback 'cb' to be run on the 'loop' event loop.
+ * 'name' is the name of 'cb' in the loop health statistics.
  *
  * Requires:
  *
@@ -45,4 +49,17 @@ isc_async_run(isc_loop_t *loop, isc_job_cb cb, void *cbarg);
  *\li	'cbarg' is passed to the 'cb' as the only argument, may be NULL
  */
 
+void
+isc_async_getstats(isc_loop_t *loop, uint64_t *wakeupsp, uint64_t *jobsp);
+/*%<
+ * Get the number of times the 'loop' woke up to run jobs scheduled with
+ * isc_async_run(), and the number of jobs it ran; the ratio of the two
+ * is the average number of jobs handled per wakeup.
+ *
+ * Requires:
+ *
+ *\li	'loop' is a valid isc event loop
+ *\li	'wakeupsp' and 'jobsp' are non-NULL
+ */
+
 ISC_LANG_ENDDECLS
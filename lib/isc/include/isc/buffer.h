@@ -127,8 +127,8 @@ ISC_LANG_BEGINDECLS
 
 /*!
  * Size granularity for dynamically resizable buffers; when reserving
- * space in a buffer, we round the allocated buffer length up to the
- * nearest * multiple of this value.
+ * space in a buffer, we at least double the allocated buffer length and
+ * round it up to the nearest multiple of this value.
  */
 #define ISC_BUFFER_INCR 2048
 
@@ -212,7 +212,9 @@ isc_result_t
 isc_buffer_reserve(isc_buffer_t **dynbuffer, unsigned int size);
 /*!<
  * \brief Make "size" bytes of space available in the buffer. The buffer
- * pointer may move when you call this function.
+ * pointer may move when you call this function.  A buffer that has to
+ * grow at least doubles in length, so that filling it piecemeal costs
+ * few reallocations.
  *
  * Requires:
  *\li	"dynbuffer" is not NULL.
@@ -47,6 +47,18 @@ typedef pthread_cond_t *isc_condition_t;
 		free(*cp);                   \
 	}
 
+#elif ISC_LOCK_PROFILE
+
+typedef pthread_cond_t isc_condition_t;
+
+#define isc_condition_init(cond)   isc__condition_init(cond)
+#define isc_condition_wait(cp, mp) isc__condition_wait(cp, &(mp)->mutex)
+#define isc_condition_waituntil(cp, mp, t) \
+	isc__condition_waituntil(cp, &(mp)->mutex, t)
+#define isc_condition_signal(cp)    isc__condition_signal(cp)
+#define isc_condition_broadcast(cp) isc__condition_broadcast(cp)
+#define isc_condition_destroy(cp)   isc__condition_destroy(cp)
+
 #else /* ISC_TRACK_PTHREADS_OBJECTS */
 
 typedef pthread_cond_t isc_condition_t;
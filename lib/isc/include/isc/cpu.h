@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file isc/cpu.h
+ * \brief
+ * Detection of the instruction set extensions of the CPU named runs on.
+ *
+ * BIND is built for the baseline of each architecture, so the kernels
+ * that use wider instructions are compiled with ISC_CPU_TARGET() and
+ * chosen at run time, once, by setting a function pointer:
+ *
+ *\code
+ *	ISC_CPU_TARGET("avx2") static void
+ *	lowercopy_avx2(uint8_t *dst, const uint8_t *src, unsigned len);
+ *
+ *	lowercopy = isc_cpu_has(ISC_CPU_AVX2) ? lowercopy_avx2
+ *					       : lowercopy_generic;
+ *\endcode
+ *
+ * The features are detected when libisc is initialized.  Those listed in
+ * the ISC_CPU_DISABLE environment variable, separated by commas, or all
+ * of them if it is set to "all", are never reported, so that the
+ * generic kernels can be tested and compared on any machine.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/lang.h>
+
+typedef enum {
+	ISC_CPU_SSE42 = 1 << 0,	 /*%< x86 SSE4.2 */
+	ISC_CPU_AVX2 = 1 << 1,	 /*%< x86 AVX2, with OS support */
+	ISC_CPU_AVX512 = 1 << 2, /*%< x86 AVX-512 F and BW, with OS support */
+	ISC_CPU_SHA = 1 << 3,	 /*%< x86 SHA-NI, or Arm SHA-1 and SHA-256 */
+	ISC_CPU_NEON = 1 << 4,	 /*%< Arm Advanced SIMD */
+	ISC_CPU_ALL = (1 << 5) - 1
+} isc_cpu_feature_t;
+
+/*%
+ * Allow the compiler to use the instructions of feature 't' (in the
+ * syntax of the GCC "target" attribute) in a function, without
+ * enabling them for the rest of the build.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && \
+	(defined(__GNUC__) || defined(__clang__))
+#define ISC_CPU_TARGET(t) __attribute__((target(t)))
+#else
+#define ISC_CPU_TARGET(t)
+#endif
+
+ISC_LANG_BEGINDECLS
+
+uint32_t
+isc_cpu_features(void);
+/*%<
+ * Return the set of isc_cpu_feature_t the CPU has and that are not
+ * disabled.
+ */
+
+bool
+isc_cpu_has(isc_cpu_feature_t features);
+/*%<
+ * Return true if the CPU has all of 'features' and none of them is
+ * disabled.
+ */
+
+void
+isc_cpu_disable(uint32_t features);
+/*%<
+ * Stop reporting 'features' from now on, as if they were listed in
+ * ISC_CPU_DISABLE.  Only the kernels chosen after the call are affected;
+ * this is meant for benchmarks and tests.
+ */
+
+const char *
+isc_cpu_featurename(isc_cpu_feature_t feature);
+/*%<
+ * Return the name of 'feature' used by ISC_CPU_DISABLE, or NULL if
+ * 'feature' is not a single feature.
+ */
+
+ISC_LANG_ENDDECLS
@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/* ! \file */
+
+#pragma once
+
+#include <inttypes.h>
+#include <string.h>
+
+#include <isc/result.h>
+#include <isc/types.h>
+
+/*
+ * An open-addressing hash table with a control byte per slot that is
+ * probed a group of slots at a time (SIMD where available).  Unlike
+ * isc_ht, the table does not copy the keys: it keeps a pointer to the
+ * key the caller passed to isc_hashmap_add(), which normally points into
+ * the value itself, so adding an entry does not allocate memory.  The
+ * key must stay unchanged until the entry is deleted.
+ *
+ * Growing the table moves the entries to the new table a few slots at a
+ * time on each isc_hashmap_add() and isc_hashmap_delete(), so no single
+ * insertion has to rehash the whole table.
+ */
+
+typedef struct isc_hashmap	isc_hashmap_t;
+typedef struct isc_hashmap_iter isc_hashmap_iter_t;
+
+enum {
+	ISC_HASHMAP_CASE_SENSITIVE = 0x00,
+	ISC_HASHMAP_CASE_INSENSITIVE = 0x01
+};
+
+/*%
+ * Create a hashmap at *hashmapp, using memory context and initial size
+ * of (1<<bits) slots.
+ *
+ * If 'options' contains ISC_HASHMAP_CASE_INSENSITIVE, then upper- and
+ * lower-case letters in key values will hash and compare equal; this
+ * can be used when the key for a hash table is a DNS name.
+ *
+ * Requires:
+ *\li	'hashmapp' is not NULL and '*hashmapp' is NULL.
+ *\li	'mctx' is a valid memory context.
+ *\li	'bits' >=1 and 'bits' <=32
+ */
+void
+isc_hashmap_create(isc_mem_t *mctx, uint8_t bits, unsigned int options,
+		   isc_hashmap_t **hashmapp);
+
+/*%
+ * Destroy hashmap, freeing the table but not the keys and the values.
+ *
+ * Requires:
+ * \li	'*hashmapp' is valid hashmap
+ */
+void
+isc_hashmap_destroy(isc_hashmap_t **hashmapp);
+
+/*%
+ * Add an entry to the hashmap, with binary key 'key' of size 'keysize'
+ * and value 'value'.  Only the pointer to 'key' is stored.
+ *
+ * Requires:
+ *\li	'hashmap' is a valid hashmap
+ *\li	'key' stays valid and unchanged until the entry is deleted
+ *\li   write-lock
+ *
+ * Returns:
+ *\li	#ISC_R_EXISTS		-- entry with the same key exists
+ *\li	#ISC_R_SUCCESS		-- all is well.
+ */
+isc_result_t
+isc_hashmap_add(isc_hashmap_t *hashmap, const uint8_t *key,
+		const uint32_t keysize, void *value);
+
+/*%
+ * Find an entry matching 'key'/'keysize' in hashmap 'hashmap';
+ * if found, set '*valuep' to its value. (If 'valuep' is NULL,
+ * then simply return SUCCESS or NOTFOUND to indicate whether the
+ * key exists in the hashmap.)
+ *
+ * Requires:
+ * \li	'hashmap' is a valid hashmap
+ * \li  read-lock
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS		-- success
+ * \li	#ISC_R_NOTFOUND		-- key not found
+ */
+isc_result_t
+isc_hashmap_find(const isc_hashmap_t *hashmap, const uint8_t *key,
+		 const uint32_t keysize, void **valuep);
+
+/*%
+ * Delete entry from hashmap
+ *
+ * Requires:
+ *\li	'hashmap' is a valid hashmap
+ *\li   write-lock
+ *
+ * Returns:
+ *\li	#ISC_R_NOTFOUND		-- key not found
+ *\li	#ISC_R_SUCCESS		-- all is well
+ */
+isc_result_t
+isc_hashmap_delete(isc_hashmap_t *hashmap, const uint8_t *key,
+		   const uint32_t keysize);
+
+/*%
+ * Create an iterator for the hashmap; point '*iterp' to it.
+ *
+ * Entries must not be added or deleted, other than with
+ * isc_hashmap_iter_delcurrent_next(), while the iterator is in use.
+ *
+ * Requires:
+ *\li	'hashmap' is a valid hashmap
+ *\li	'iterp' is non NULL and '*iterp' is NULL.
+ */
+void
+isc_hashmap_iter_create(isc_hashmap_t *hashmap, isc_hashmap_iter_t **iterp);
+
+/*%
+ * Destroy the iterator '*iterp', set it to NULL
+ *
+ * Requires:
+ *\li	'iterp' is non NULL and '*iterp' is non NULL.
+ */
+void
+isc_hashmap_iter_destroy(isc_hashmap_iter_t **iterp);
+
+/*%
+ * Set an iterator to the first entry.
+ *
+ * Requires:
+ *\li	'iter' is non NULL.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS	-- success
+ * \li	#ISC_R_NOMORE	-- no data in the hashmap
+ */
+isc_result_t
+isc_hashmap_iter_first(isc_hashmap_iter_t *iter);
+
+/*%
+ * Set an iterator to the next entry.
+ *
+ * Requires:
+ *\li	'iter' is non NULL.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS	-- success
+ * \li	#ISC_R_NOMORE	-- end of hashmap reached
+ */
+isc_result_t
+isc_hashmap_iter_next(isc_hashmap_iter_t *iter);
+
+/*%
+ * Delete current entry and set an iterator to the next entry.
+ *
+ * Requires:
+ *\li	'iter' is non NULL.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS	-- success
+ * \li	#ISC_R_NOMORE	-- end of hashmap reached
+ */
+isc_result_t
+isc_hashmap_iter_delcurrent_next(isc_hashmap_iter_t *iter);
+
+/*%
+ * Set 'value' to the current value under the iterator
+ *
+ * Requires:
+ *\li	'iter' is non NULL.
+ *\li   'valuep' is non NULL and '*valuep' is NULL.
+ */
+void
+isc_hashmap_iter_current(isc_hashmap_iter_t *iter, void **valuep);
+
+/*%
+ * Set 'key' and 'keysize' to the current key and keysize for the value
+ * under the iterator
+ *
+ * Requires:
+ *\li	'iter' is non NULL.
+ *\li   'key' is non NULL and '*key' is NULL.
+ *\li	'keysize' is non NULL.
+ */
+void
+isc_hashmap_iter_currentkey(isc_hashmap_iter_t *iter, const uint8_t **key,
+			    size_t *keysize);
+
+/*%
+ * Returns the number of items in the hashmap.
+ *
+ * Requires:
+ *\li	'hashmap' is a valid hashmap
+ */
+size_t
+isc_hashmap_count(const isc_hashmap_t *hashmap);
@@ -91,6 +91,18 @@ isc_heap_insert(isc_heap_t *heap, void *elt);
  *\li	"heapp" is not NULL and "*heap" points to a valid isc_heap_t.
  */
 
+void
+isc_heap_insert_many(isc_heap_t *heap, void **elts, unsigned int count);
+/*!<
+ * \brief Inserts the 'count' elements of the array 'elts' into a heap.
+ * When the heap at least doubles in size it is rebuilt bottom-up, which
+ * is cheaper than inserting the elements one by one.
+ *
+ * Requires:
+ *\li	"heapp" is not NULL and "*heap" points to a valid isc_heap_t.
+ *\li	"elts" is not NULL, unless "count" is 0.
+ */
+
 void
 isc_heap_delete(isc_heap_t *heap, unsigned int index);
 /*!<
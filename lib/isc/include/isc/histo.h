@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file isc/histo.h
+ *
+ * \brief A histogram of 64-bit values with log-linear buckets, in the
+ * style of HDR histograms.
+ *
+ * Values below 2^sigbits each have a bucket of their own.  Above that,
+ * every power of two is split into 2^sigbits buckets of equal width, so
+ * that the width of a bucket is never more than 1/2^sigbits of the
+ * values it counts.  For example, with 'sigbits' set to 3 the values
+ * from 1024 to 2047 are counted in eight buckets 128 wide.
+ *
+ * The buckets are allocated a power of two at a time, when a value in
+ * that range is first counted, so a histogram only takes memory for the
+ * range of values it has actually seen.
+ *
+ * Each histogram keeps a separate set of buckets for each of 'nshards'
+ * loop threads, picked by isc_tid(), so threads counting the same values
+ * do not contend for the same cache lines.  Reading a bucket sums the
+ * shards.
+ */
+
+#include <inttypes.h>
+
+#include <isc/lang.h>
+#include <isc/types.h>
+
+#define ISC_HISTO_MINBITS 1
+#define ISC_HISTO_MAXBITS 6
+
+ISC_LANG_BEGINDECLS
+
+void
+isc_histo_create(isc_mem_t *mctx, unsigned int sigbits, unsigned int nshards,
+		 isc_histo_t **hgp);
+/*%<
+ * Create a histogram with 'sigbits' significant bits of precision in its
+ * buckets, keeping a set of buckets for each of 'nshards' threads.
+ *
+ * Requires:
+ *\li	'mctx' is a valid memory context.
+ *\li	ISC_HISTO_MINBITS <= 'sigbits' <= ISC_HISTO_MAXBITS
+ *\li	'nshards' > 0
+ *\li	'hgp' != NULL && '*hgp' == NULL
+ */
+
+void
+isc_histo_attach(isc_histo_t *source, isc_histo_t **targetp);
+/*%<
+ * Attach to a histogram.
+ *
+ * Requires:
+ *\li	'source' is a valid histogram.
+ *\li	'targetp' != NULL && '*targetp' == NULL
+ */
+
+void
+isc_histo_detach(isc_histo_t **hgp);
+/*%<
+ * Detach from a histogram, and destroy it when this was the last
+ * reference.
+ *
+ * Requires:
+ *\li	'hgp' != NULL and '*hgp' is a valid histogram.
+ */
+
+void
+isc_histo_add(isc_histo_t *hg, uint64_t value, uint64_t inc);
+/*%<
+ * Add 'inc' to the bucket that counts 'value'.
+ *
+ * Requires:
+ *\li	'hg' is a valid histogram.
+ */
+
+void
+isc_histo_inc(isc_histo_t *hg, uint64_t value);
+/*%<
+ * Add 1 to the bucket that counts 'value'.
+ *
+ * Requires:
+ *\li	'hg' is a valid histogram.
+ */
+
+isc_result_t
+isc_histo_get(isc_histo_t *hg, unsigned int key, uint64_t *minp,
+	      uint64_t *maxp, uint64_t *countp);
+/*%<
+ * Get the smallest and largest values counted by the bucket numbered
+ * 'key' and the number of values counted by it.  The buckets are
+ * numbered from 0 in the order of the values they count.  Any of the
+ * result pointers can be NULL.
+ *
+ * Requires:
+ *\li	'hg' is a valid histogram.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS	-- the bucket exists
+ *\li	#ISC_R_RANGE	-- 'key' is larger than the last bucket
+ */
+
+void
+isc_histo_next(isc_histo_t *hg, unsigned int *keyp);
+/*%<
+ * Advance '*keyp' to the next bucket, skipping the buckets that have not
+ * been allocated because no values in their range have been counted.
+ * A loop over the buckets of a histogram looks like:
+ *
+ *\code
+ *	for (key = 0;
+ *	     isc_histo_get(hg, key, &min, &max, &count) == ISC_R_SUCCESS;
+ *	     isc_histo_next(hg, &key))
+ *	{
+ *		...
+ *	}
+ *\endcode
+ *
+ * Requires:
+ *\li	'hg' is a valid histogram.
+ *\li	'keyp' != NULL
+ */
+
+ISC_LANG_ENDDECLS
@@ -80,6 +80,18 @@ isc_result_t
 isc_hmac_init(isc_hmac_t *hmac, const void *key, const size_t keylen,
 	      const isc_md_type_t *type);
 
+/**
+ * isc_hmac_copy:
+ * @dst: HMAC context
+ * @src: HMAC context
+ *
+ * This function copies the state of @src, including its key, into @dst.
+ * Copying a keyed context that has not been updated yet is cheaper than
+ * initializing a new one with isc_hmac_init().
+ */
+isc_result_t
+isc_hmac_copy(isc_hmac_t *dst, const isc_hmac_t *src);
+
 /**
  * isc_hmac_reset:
  * @hmac: HMAC context
@@ -27,6 +27,12 @@
  */
 #define NSEC3_MAX_LABEL_HASH 35
 
+/*
+ * The number of hash chains isc_iterated_hash_many() computes in
+ * parallel.
+ */
+#define ISC_ITERATED_HASH_LANES 8
+
 ISC_LANG_BEGINDECLS
 
 int
@@ -35,4 +41,19 @@ isc_iterated_hash(unsigned char *out, const unsigned int hashalg,
 		  const int saltlength, const unsigned char *in,
 		  const int inlength);
 
+int
+isc_iterated_hash_many(unsigned char *const out[], const unsigned int hashalg,
+		       const int iterations, const unsigned char *salt,
+		       const int saltlength, const unsigned char *const in[],
+		       const int inlength[], const unsigned int count);
+/*%<
+ * Compute the iterated hashes of 'count' inputs in[i] of inlength[i]
+ * octets with the same algorithm, iterations and salt, storing the
+ * result for in[i] in out[i].  The result is identical to calling
+ * isc_iterated_hash() for each input, but up to ISC_ITERATED_HASH_LANES
+ * hash chains are computed in parallel.
+ *
+ * Returns the length of each hash, or 0 on failure.
+ */
+
 ISC_LANG_ENDDECLS
@@ -33,11 +33,15 @@ typedef void (*isc_job_cb)(void *);
 
 ISC_LANG_BEGINDECLS
 
+#define isc_job_run(loopmgr, cb, cbarg) \
+	isc__job_run_named(loopmgr, cb, cbarg, #cb)
 void
-isc_job_run(isc_loopmgr_t *loopmgr, isc_job_cb cb, void *cbarg);
+isc__job_run_named(isc_loopmgr_t *loopmgr, isc_job_cb cb, void *cbarg,
+		   const char *name);
 /*%<
  * Schedule the job callback 'cb' to be run on the currently
- * running event loop.
+ * running event loop.  'name' is the name of 'cb' in the loop health
+ * statistics.
  *
  * Requires:
  *
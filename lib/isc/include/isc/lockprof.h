@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file isc/lockprof.h
+ * \brief Lock contention profiling.
+ *
+ * When BIND is configured with --enable-lock-profile (ISC_LOCK_PROFILE),
+ * every isc_mutex_t and isc_rwlock_t remembers the source file and line
+ * of the isc_mutex_init() or isc_rwlock_init() call that initialized it.
+ * Each acquisition first tries to take the lock without blocking; if
+ * that fails, the acquisition is counted as contended and the time spent
+ * waiting is measured.  The counters are kept per initialization site,
+ * so all the locks of one kind (e.g. every ADB entry lock) are added
+ * together.
+ *
+ * Without ISC_LOCK_PROFILE the locks are unchanged, and the functions
+ * below report no sites.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/lang.h>
+#include <isc/types.h>
+
+ISC_LANG_BEGINDECLS
+
+typedef struct isc_lockstats isc_lockstats_t;
+
+/*%
+ * A snapshot of the counters of one lock initialization site.
+ */
+typedef struct isc_lockprof {
+	const char  *type; /*%< "mutex" or "rwlock" */
+	const char  *file;
+	unsigned int line;
+	uint64_t     locks;	/*%< acquisitions */
+	uint64_t     contended; /*%< acquisitions which had to wait */
+	uint64_t     waited;	/*%< total wait, in nanoseconds */
+	uint64_t     maxwait;	/*%< longest wait, in nanoseconds */
+} isc_lockprof_t;
+
+bool
+isc_lockprof_enabled(void);
+/*%<
+ * Return true if BIND was built with lock profiling.
+ */
+
+void
+isc_lockprof_sites(isc_mem_t *mctx, isc_lockprof_t **sitesp, size_t *countp);
+/*%<
+ * Take a snapshot of all the lock initialization sites that have been
+ * used, sorted by decreasing total wait time.  The array is allocated
+ * from 'mctx' and must be freed by the caller with
+ * isc_mem_put(mctx, *sitesp, *countp * sizeof(**sitesp)) when
+ * '*countp' is not zero.
+ *
+ * Requires:
+ *\li	'sitesp' is not NULL and '*sitesp' is NULL.
+ *\li	'countp' is not NULL.
+ */
+
+void
+isc_lockprof_reset(void);
+/*%<
+ * Reset the counters of all lock initialization sites.
+ */
+
+/* Private */
+
+isc_lockstats_t *
+isc__lockprof_site(const char *type, const char *file, unsigned int line);
+/*%<
+ * Return the counters of the initialization site 'file':'line', or NULL
+ * if the table of sites is full.
+ */
+
+uint64_t
+isc__lockprof_now(void);
+/*%<
+ * Return the monotonic time in nanoseconds, for measuring waits.
+ */
+
+void
+isc__lockprof_record(isc_lockstats_t *stats, bool contended, uint64_t waited);
+/*%<
+ * Count an acquisition of a lock from 'stats', which may be NULL.
+ */
+
+ISC_LANG_ENDDECLS
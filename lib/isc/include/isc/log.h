@@ -15,6 +15,7 @@
 
 /*! \file isc/log.h */
 
+#include <inttypes.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -788,6 +789,45 @@ isc_log_closefilelogs(isc_log_t *lctx);
  *	next needed.
  */
 
+void
+isc_log_setasync(isc_log_t *lctx, bool async);
+/*%<
+ * Turn asynchronous writing of #ISC_LOG_TOFILE and #ISC_LOG_TOFILEDESC
+ * channels on or off.
+ *
+ * Notes:
+ *\li	When enabled, a thread with a thread id (see isc_tid()) formats
+ *	its messages for file channels into a ring buffer of its own
+ *	instead of writing them under the log context lock, and a writer
+ *	thread started by this function writes the buffered messages to
+ *	the files in batches.  Messages written by threads without a
+ *	thread id, and messages for syslog channels, are still written
+ *	synchronously.
+ *
+ *\li	If a thread's ring buffer is full, the message is dropped and
+ *	counted; see isc_log_getdropped().
+ *
+ *\li	Asynchronous writing must be turned on after the program has
+ *	daemonized, as the writer thread does not survive a fork().
+ *
+ * Requires:
+ *\li	lctx is a valid context.
+ *
+ * Ensures:
+ *\li	When turned off, all the buffered messages have been written and
+ *	the writer thread has exited.
+ */
+
+uint64_t
+isc_log_getdropped(isc_log_t *lctx);
+/*%<
+ * Return the number of messages dropped so far because the ring buffer
+ * of the writing thread was full.
+ *
+ * Requires:
+ *\li	lctx is a valid context.
+ */
+
 isc_logcategory_t *
 isc_log_categorybyname(isc_log_t *lctx, const char *name);
 /*%<
@@ -22,6 +22,31 @@
 
 typedef void (*isc_job_cb)(void *);
 
+/*%
+ * Health statistics of a loop; see isc_loop_getstats().
+ */
+typedef struct isc_loopstats {
+	uint64_t iterations; /*%< loop iterations */
+	uint64_t jobs;	     /*%< job and timer callbacks run */
+	uint64_t maxjobs;    /*%< most callbacks run in one iteration */
+	uint64_t maxtime;    /*%< longest iteration, in microseconds */
+	uint64_t stalls;     /*%< iterations over the stall threshold */
+} isc_loopstats_t;
+
+/*%
+ * The job and timer callbacks of a loop which ran for a millisecond or
+ * more, by the name of the callback function; up to ISC_LOOP_CALLBACKS
+ * distinct names are counted for each loop.
+ */
+#define ISC_LOOP_CALLBACKS 64
+
+typedef struct isc_loopcallback {
+	const char *name;
+	uint64_t    count;   /*%< slow runs */
+	uint64_t    time;    /*%< total time of the slow runs, in us */
+	uint64_t    maxtime; /*%< longest run, in microseconds */
+} isc_loopcallback_t;
+
 ISC_LANG_BEGINDECLS
 
 void
@@ -94,6 +119,74 @@ isc_loopmgr_resume(isc_loopmgr_t *loopmgr);
 uint32_t
 isc_loopmgr_nloops(isc_loopmgr_t *loopmgr);
 
+void
+isc_loopmgr_setaffinity(isc_loopmgr_t *loopmgr, bool affinity);
+/*%<
+ * When 'affinity' is true, pin each loop thread to a CPU of its own when
+ * the loops are run: loop N goes to the N-th CPU the process is allowed
+ * to run on, wrapping around if there are more loops than CPUs.  Keeping
+ * a loop on one CPU (and so on one NUMA node) keeps the memory it
+ * allocates local, and lets the load-balanced listening sockets ask the
+ * kernel to deliver packets on that CPU.
+ *
+ * Threads created later by a loop thread inherit its affinity.
+ *
+ * Requires:
+ *\li	'loopmgr' is a valid loop manager.
+ *\li	'loopmgr' has not yet been started.
+ */
+
+void
+isc_loopmgr_setstallthreshold(isc_loopmgr_t *loopmgr, uint32_t threshold);
+/*%<
+ * Log a warning, naming the slowest callback, when an iteration of a
+ * loop keeps it busy for 'threshold' milliseconds or more; at most one
+ * warning per second is logged for each loop.  0, the default, disables
+ * the warnings; the stalls are then not counted either.
+ *
+ * Requires:
+ *\li	'loopmgr' is a valid loop manager.
+ */
+
+void
+isc_loop_getstats(isc_loop_t *loop, isc_loopstats_t *stats);
+/*%<
+ * Get the health statistics of 'loop'.
+ *
+ * The busy time of an iteration is the time it spends running callbacks
+ * rather than waiting for I/O.  When libuv is older than 1.39.0, it only
+ * includes the job and timer callbacks, not the I/O callbacks.
+ *
+ * Requires:
+ *\li	'loop' is a valid loop.
+ *\li	'stats' is not NULL.
+ */
+
+isc_histo_t *
+isc_loop_gethistogram(isc_loop_t *loop);
+/*%<
+ * Return the histogram of the busy time of the iterations of 'loop', in
+ * microseconds.  It is valid until the loop manager is destroyed.
+ *
+ * Requires:
+ *\li	'loop' is a valid loop.
+ */
+
+size_t
+isc_loop_getcallbacks(isc_loop_t *loop, isc_loopcallback_t *callbacks,
+		      size_t size);
+/*%<
+ * Fill 'callbacks' with up to 'size' of the callbacks of 'loop' which
+ * have run for a millisecond or more, sorted by decreasing total time,
+ * and return how many were filled.  The callbacks are named by the
+ * isc_async_run(), isc_job_run() and isc_timer_create() macros; the names
+ * are valid for the lifetime of the program.
+ *
+ * Requires:
+ *\li	'loop' is a valid loop.
+ *\li	'callbacks' is not NULL, unless 'size' is 0.
+ */
+
 isc_job_t *
 isc_loop_setup(isc_loop_t *loop, isc_job_cb cb, void *cbarg);
 isc_job_t *
@@ -80,6 +80,8 @@ extern unsigned int isc_mem_defaultflags;
 #define ISC_MEMFLAG_RESERVED2 0x00000002 /* reserved, obsoleted, don't use */
 #define ISC_MEMFLAG_FILL \
 	0x00000004 /* fill with pattern after alloc and frees */
+#define ISC_MEMFLAG_HUGEPAGES \
+	0x00000008 /* back isc_mem_create_arena() contexts with huge pages */
 
 /*%
  * Define ISC_MEM_DEFAULTFILL=1 to turn filling the memory with pattern
@@ -194,6 +196,24 @@ void ISCMEMFUNC(create)(isc_mem_t **_ISC_MEM_FLARG);
  * mctxp != NULL && *mctxp == NULL */
 /*@}*/
 
+/*@{*/
+#define isc_mem_create_arena(cp) \
+	ISCMEMFUNC(create_arena)((cp)_ISC_MEM_FILELINE)
+void ISCMEMFUNC(create_arena)(isc_mem_t **_ISC_MEM_FLARG);
+
+/*!<
+ * \brief Create a memory context for large, randomly accessed data,
+ * such as a cache or a zone database.
+ *
+ * If #ISC_MEMFLAG_HUGEPAGES is set in isc_mem_defaultflags and BIND is
+ * built with jemalloc, the context allocates from its own arena, whose
+ * memory is advised to be backed by transparent huge pages.  Otherwise
+ * this is the same as isc_mem_create().
+ *
+ * Requires:
+ * mctxp != NULL && *mctxp == NULL */
+/*@}*/
+
 /*@{*/
 void
 isc_mem_attach(isc_mem_t *, isc_mem_t **);
@@ -240,6 +260,13 @@ isc_mem_inuse(isc_mem_t *mctx);
  * allocated from the system but not yet used.
  */
 
+size_t
+isc_mem_totalinuse(void);
+/*%<
+ * Get an estimate of the amount of memory in use in all the memory
+ * contexts, in bytes; see isc_mem_inuse().
+ */
+
 size_t
 isc_mem_maxinuse(isc_mem_t *mctx);
 /*%<
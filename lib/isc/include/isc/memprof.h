@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file isc/memprof.h
+ * \brief Sampling heap profiler for the isc_mem allocations.
+ *
+ * While the profiler is running, each thread picks about one allocation
+ * per 'rate' bytes allocated through any memory context, at random so
+ * that the sampled allocations form a Poisson process over the allocated
+ * bytes.  The call stack and the size of a sampled allocation are
+ * recorded until it is freed, so the profile shows both where the memory
+ * in use was allocated and where memory has been allocated since the
+ * profiler was started.
+ *
+ * The profile is written in the text heap profile format of gperftools,
+ * which pprof reads and scales back up by the sampling rate:
+ *
+ *\code
+ *	pprof --text /usr/sbin/named named.memprof
+ *\endcode
+ *
+ * When the profiler is not running, each allocation and each free only
+ * check a global flag; freeing memory keeps checking a filter of the
+ * sampled addresses while sampled allocations are still live.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include <isc/lang.h>
+#include <isc/types.h>
+
+#define ISC_MEMPROF_RATE (512 * 1024)
+
+ISC_LANG_BEGINDECLS
+
+typedef struct isc_memprofstatus {
+	size_t	 rate;	      /*%< sampling rate in bytes, 0 when stopped */
+	uint64_t samples;     /*%< live sampled allocations */
+	uint64_t bytes;	      /*%< bytes in the live sampled allocations */
+	uint64_t allocations; /*%< allocations sampled since the last reset */
+} isc_memprofstatus_t;
+
+isc_result_t
+isc_memprof_start(size_t rate);
+/*%<
+ * Start sampling an allocation per 'rate' bytes on average, or per
+ * #ISC_MEMPROF_RATE bytes when 'rate' is 0.  If the profiler is already
+ * running, only the rate is changed.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTIMPLEMENTED	-- call stacks can't be collected on this
+ *				   platform
+ */
+
+void
+isc_memprof_stop(void);
+/*%<
+ * Stop sampling new allocations.  The sampled allocations which are
+ * still live stay in the profile, and are removed when they are freed.
+ */
+
+void
+isc_memprof_reset(void);
+/*%<
+ * Forget all the sampled allocations.
+ */
+
+void
+isc_memprof_status(isc_memprofstatus_t *status);
+/*%<
+ * Get the current state of the profiler.
+ *
+ * Requires:
+ *\li	'status' is not NULL.
+ */
+
+isc_result_t
+isc_memprof_dump(FILE *fp);
+/*%<
+ * Write the heap profile to 'fp': the sampled allocations which are
+ * live, and all the allocations sampled since the last reset, grouped by
+ * call stack, followed by the memory map of the process (on systems with
+ * /proc/self/maps) so that pprof can symbolize the addresses.
+ *
+ * Requires:
+ *\li	'fp' is a valid file.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ *\li	#ISC_R_FAILURE	-- writing to 'fp' failed
+ */
+
+ISC_LANG_ENDDECLS
@@ -20,6 +20,7 @@
 #include <stdlib.h>
 
 #include <isc/lang.h>
+#include <isc/lockprof.h>
 #include <isc/result.h> /* for ISC_R_ codes */
 #include <isc/util.h>
 
@@ -43,6 +44,28 @@ typedef pthread_mutex_t *isc_mutex_t;
 		free(*mp);               \
 	}
 
+#elif ISC_LOCK_PROFILE
+
+typedef struct {
+	pthread_mutex_t	 mutex;
+	isc_lockstats_t *stats;
+} isc_mutex_t;
+
+#define isc_mutex_init(mp)                                          \
+	{                                                           \
+		isc__mutex_init(&(mp)->mutex);                      \
+		(mp)->stats = isc__lockprof_site("mutex", __FILE__, \
+						 __LINE__);         \
+	}
+#define isc_mutex_lock(mp) \
+	isc__mutex_lock_profile(&(mp)->mutex, (mp)->stats)
+#define isc_mutex_unlock(mp)  isc__mutex_unlock(&(mp)->mutex)
+#define isc_mutex_trylock(mp) isc__mutex_trylock(&(mp)->mutex)
+#define isc_mutex_destroy(mp) isc__mutex_destroy(&(mp)->mutex)
+
+void
+isc__mutex_lock_profile(pthread_mutex_t *mp, isc_lockstats_t *stats);
+
 #else /* ISC_TRACK_PTHREADS_OBJECTS */
 
 typedef pthread_mutex_t isc_mutex_t;
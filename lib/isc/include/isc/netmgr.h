@@ -127,6 +127,23 @@ isc_nmsocket_set_tlsctx(isc_nmsocket_t *listener, isc_tlsctx_t *tlsctx);
  * \li	'tlsctx' is a valid pointer to a TLS context object.
  */
 
+void
+isc_nmsocket_set_proxy(isc_nmsocket_t *listener, bool enabled);
+/*%<
+ * Enable or disable the PROXYv2 protocol on the listener socket: every
+ * UDP datagram or TCP connection accepted by it must then start with a
+ * PROXYv2 header, and the peer address of its handles is taken from
+ * the header.  Datagrams and connections without a valid header are
+ * dropped.  For DoT and DoH listeners, the header is expected before
+ * the TLS handshake.
+ *
+ * Changing the setting only affects the connections accepted after
+ * the call.
+ *
+ * Requires:
+ * \li	'listener' is a valid network manager listener socket.
+ */
+
 void
 isc_nmsocket_set_max_streams(isc_nmsocket_t *listener,
 			     const uint32_t  max_streams);
@@ -227,7 +244,24 @@ isc_nmhandle_keepalive(isc_nmhandle_t *handle, bool value);
 isc_sockaddr_t
 isc_nmhandle_peeraddr(isc_nmhandle_t *handle);
 /*%<
- * Return the peer address for the given handle.
+ * Return the peer address for the given handle.  If the connection
+ * or the datagram came through a proxy that sent a PROXYv2 header,
+ * this is the address of the original client from the header.
+ */
+
+bool
+isc_nmhandle_isproxied(isc_nmhandle_t *handle);
+/*%<
+ * Return true if the peer address of the given handle was taken
+ * from a PROXYv2 header.
+ */
+
+isc_sockaddr_t
+isc_nmhandle_proxyaddr(isc_nmhandle_t *handle);
+/*%<
+ * Return the address of the proxy that sent the PROXYv2 header, i.e.
+ * the actual peer of the connection.  If the handle is not proxied,
+ * this is the same as isc_nmhandle_peeraddr().
  */
 isc_sockaddr_t
 isc_nmhandle_localaddr(isc_nmhandle_t *handle);
@@ -452,6 +486,86 @@ isc_nm_setloadbalancesockets(isc_nm_t *mgr, bool enabled);
  * \li	'mgr' is a valid netmgr.
  */
 
+bool
+isc_nm_getudpsendbatching(isc_nm_t *mgr);
+void
+isc_nm_setudpsendbatching(isc_nm_t *mgr, bool enabled);
+/*%<
+ * Get and set batching of outgoing UDP datagrams on unconnected
+ * (listening) sockets.  When enabled, the datagrams sent during a
+ * single loop iteration are queued on the worker and flushed together
+ * using sendmmsg(2), coalescing consecutive datagrams to the same
+ * destination with UDP_SEGMENT where the kernel supports it.  Setting
+ * the value has no effect on systems without sendmmsg(2).
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ */
+
+bool
+isc_nm_getiouring(isc_nm_t *mgr);
+void
+isc_nm_setiouring(isc_nm_t *mgr, bool enabled);
+/*%<
+ * Get and set the use of io_uring for receiving datagrams on UDP
+ * listener sockets.  When enabled, each worker submits a multishot
+ * recvmsg request per listener socket to its own io_uring instance
+ * using a ring of provided buffers; if the io_uring instance can not
+ * be created, the listeners fall back to libuv.  The value must be set
+ * before the listeners are started and has no effect on systems built
+ * without io_uring support.
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ */
+
+const char *
+isc_nm_getxdp(isc_nm_t *mgr);
+isc_result_t
+isc_nm_setxdp(isc_nm_t *mgr, const char *ifname);
+/*%<
+ * Get and set the network interface on which the UDP listeners receive
+ * and send datagrams through AF_XDP sockets.  Setting the interface
+ * attaches an XDP program to it that hands the datagrams addressed to
+ * the (non-wildcard) UDP listeners to the AF_XDP socket of the worker
+ * matching the receive queue, and passes all other traffic to the
+ * kernel.  The function must be called once, before the listeners are
+ * started and while the process still has the privileges needed to
+ * load the program.  Returns ISC_R_NOTIMPLEMENTED on systems built
+ * without AF_XDP support; on other failures the listeners keep using
+ * the regular sockets.
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ * \li	'ifname' is not NULL and isc_nm_setxdp() has not been called yet.
+ */
+
+bool
+isc_nm_getkerneltls(isc_nm_t *mgr);
+void
+isc_nm_setkerneltls(isc_nm_t *mgr, bool enabled);
+/*%<
+ * Get and set the use of the kernel TLS offload on DNS-over-TLS
+ * connections.  When enabled, the record protection of a connection
+ * negotiating TLS 1.3 is handed over to the kernel after the handshake,
+ * and the socket is then read and written like a plain TCP DNS socket.
+ * Connections which can't be offloaded keep using OpenSSL.  Setting the
+ * value has no effect on systems without kernel TLS support.
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ */
+
+uint32_t
+isc_nm_getnloops(isc_nm_t *mgr);
+/*%<
+ * Returns the number of loops, and thus of network workers, used by
+ * 'mgr'.
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ */
+
 void
 isc_nm_gettimeouts(isc_nm_t *mgr, uint32_t *initial, uint32_t *idle,
 		   uint32_t *keepalive, uint32_t *advertised);
@@ -640,6 +754,37 @@ isc_nm_http_set_endpoints(isc_nmsocket_t	  *listener,
  * \li	'eps' is a valid pointer to an HTTP endpoints set.
  */
 
+void
+isc_nm_http_set_response_cache(isc_nmsocket_t *listener, uint32_t size);
+/*%<
+ * Set the number of responses to DoH GET requests which are cached by
+ * each worker thread of the listener, or disable the cache if 'size'
+ * is zero.  Responses are cached for the time to live set with
+ * isc_nm_set_maxage() and answered without passing the request to the
+ * receive callback.  The function is safe to use during
+ * reconfiguration: the caches are flushed on the next request.
+ *
+ * Requires:
+ * \li	'listener' is a pointer to a valid HTTP listener socket.
+ */
+
+void
+isc_nm_http_set_settings(isc_nmsocket_t *listener,
+			 uint32_t initial_window_size, uint32_t max_frame_size,
+			 uint32_t header_table_size);
+/*%<
+ * Set the HTTP/2 settings announced to new client connections of the
+ * listener: the initial flow-control window of a stream, the largest
+ * frame the server accepts and the size of the header compression
+ * table.  Zero keeps the protocol default; other values are clamped to
+ * the ranges allowed by RFC 7540.  When the stream window is larger
+ * than the default, the connection window grows with the number of
+ * concurrent streams.  Existing connections keep their settings.
+ *
+ * Requires:
+ * \li	'listener' is a pointer to a valid HTTP listener socket.
+ */
+
 #endif /* HAVE_LIBNGHTTP2 */
 
 void
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file isc/probes.h
+ * \brief User-level statically defined tracing (USDT) probes.
+ *
+ * When BIND is built with <sys/sdt.h> (from SystemTap), each ISC_PROBE
+ * macro expands to a single no-op instruction plus a note in the ELF
+ * file describing the probe location and the arguments.  Tools such as
+ * bpftrace, perf and SystemTap can attach to the probes of a running
+ * process; when nothing is attached a probe costs the no-op and the
+ * evaluation of its arguments, which are only recorded as operand
+ * locations.  Without <sys/sdt.h> the macros expand to nothing.
+ *
+ * The probe providers are "libisc", "libdns" and "libns"; the probes are
+ * listed in contrib/tracing/README.md.  Arguments should be pointers or
+ * integers that are already at hand, so that adding a probe never
+ * requires extra work on the hot path.
+ */
+
+#if HAVE_SYS_SDT_H
+
+#include <sys/sdt.h>
+
+#define ISC_PROBE(provider, name) DTRACE_PROBE(provider, name)
+#define ISC_PROBE1(provider, name, a1) DTRACE_PROBE1(provider, name, a1)
+#define ISC_PROBE2(provider, name, a1, a2) \
+	DTRACE_PROBE2(provider, name, a1, a2)
+#define ISC_PROBE3(provider, name, a1, a2, a3) \
+	DTRACE_PROBE3(provider, name, a1, a2, a3)
+#define ISC_PROBE4(provider, name, a1, a2, a3, a4) \
+	DTRACE_PROBE4(provider, name, a1, a2, a3, a4)
+
+#else /* HAVE_SYS_SDT_H */
+
+#define ISC_PROBE(provider, name)
+#define ISC_PROBE1(provider, name, a1)
+#define ISC_PROBE2(provider, name, a1, a2)
+#define ISC_PROBE3(provider, name, a1, a2, a3)
+#define ISC_PROBE4(provider, name, a1, a2, a3, a4)
+
+#endif /* HAVE_SYS_SDT_H */
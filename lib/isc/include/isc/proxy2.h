@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/lang.h>
+#include <isc/region.h>
+#include <isc/sockaddr.h>
+#include <isc/types.h>
+
+/*! \file isc/proxy2.h
+ * \brief Parser for the PROXY protocol version 2 header, as sent by the
+ * load balancers in front of the server to pass on the address of the
+ * original client.
+ */
+
+/*%
+ * Size of the fixed part of the header.
+ */
+#define ISC_PROXY2_HEADER_SIZE 16
+
+typedef enum {
+	ISC_PROXY2_CMD_LOCAL = 0,
+	ISC_PROXY2_CMD_PROXY = 1,
+} isc_proxy2_command_t;
+
+typedef struct isc_proxy2 {
+	size_t		     length; /*%< Total length of the header */
+	isc_proxy2_command_t command;
+	bool		     addresses; /*%< The addresses below are set */
+	isc_sockaddr_t	     source;
+	isc_sockaddr_t	     destination;
+} isc_proxy2_t;
+
+ISC_LANG_BEGINDECLS
+
+isc_result_t
+isc_proxy2_parse(const isc_region_t *region, isc_proxy2_t *proxy);
+/*%<
+ * Parse the PROXYv2 header at the start of 'region'.  The header is not
+ * copied; 'region' may contain more data after the header, e.g. the DNS
+ * message that follows it.
+ *
+ * The addresses are only set for the PROXY command with the TCP or UDP
+ * over IPv4 or IPv6 address families; for the LOCAL command (used by
+ * the load balancers for health checks) and for the other address
+ * families, the receiver is expected to use the addresses of the
+ * connection.  The TLVs are skipped.
+ *
+ * Requires:
+ *\li	'region' and 'proxy' are not NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS		'proxy->length' bytes of header parsed
+ *\li	#ISC_R_NOMORE		Valid, but incomplete header
+ *\li	#ISC_R_UNEXPECTEDTOKEN	No PROXYv2 signature
+ *\li	#ISC_R_NOTIMPLEMENTED	Unknown version, command or family
+ *\li	#ISC_R_RANGE		Address block too short for the family
+ */
+
+ISC_LANG_ENDDECLS
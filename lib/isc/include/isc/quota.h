@@ -30,10 +30,12 @@
  *** Imports.
  ***/
 
+#include <isc/align.h>
 #include <isc/atomic.h>
 #include <isc/lang.h>
 #include <isc/magic.h>
 #include <isc/mutex.h>
+#include <isc/os.h>
 #include <isc/types.h>
 
 /*****
@@ -49,9 +51,21 @@ struct isc_quota_cb {
 	int		    magic;
 	isc_quota_cb_func_t cb_func;
 	void		   *data;
-	ISC_LINK(isc_quota_cb_t) link;
+	isc_quota_cb_t	   *next;
 };
 
+/*%
+ * Loop threads with a thread ID below ISC_QUOTA_THREADS keep a few
+ * spare units of quota for themselves while the quota is far from
+ * full, so that most attaches and detaches don't touch the shared
+ * counter.
+ */
+#define ISC_QUOTA_THREADS 64U
+
+typedef struct isc__quota_local {
+	alignas(ISC_OS_CACHELINE_SIZE) atomic_uint_fast32_t cached;
+} isc__quota_local_t;
+
 /*% isc_quota structure */
 struct isc_quota {
 	int		     magic;
@@ -59,9 +73,11 @@ struct isc_quota {
 	atomic_uint_fast32_t used;
 	atomic_uint_fast32_t soft;
 	atomic_uint_fast32_t waiting;
-	isc_mutex_t	     cblock;
-	ISC_LIST(isc_quota_cb_t) cbs;
+	atomic_uintptr_t     pending;  /*%< waiters, newest first */
+	atomic_bool	     draining; /*%< someone is dequeuing */
+	isc_quota_cb_t	    *cbs;      /*%< waiters, oldest first */
 	ISC_LINK(isc_quota_t) link;
+	isc__quota_local_t local[ISC_QUOTA_THREADS];
 };
 
 void
@@ -103,7 +119,8 @@ isc_quota_getsoft(isc_quota_t *quota);
 unsigned int
 isc_quota_getused(isc_quota_t *quota);
 /*%<
- * Get the current usage of quota.
+ * Get the current usage of quota, not counting the units that the loop
+ * threads keep in reserve.
  */
 
 isc_result_t
@@ -124,7 +141,9 @@ isc_quota_attach_cb(isc_quota_t *quota, isc_quota_t **p, isc_quota_cb_t *cb);
 /*%<
  *
  * Like isc_quota_attach(), but if there's no quota left then cb->cb_func will
- * be called when we are attached to quota.
+ * be called when we are attached to quota.  The callbacks are called in
+ * the order they were queued; queueing and dequeueing them doesn't take
+ * a lock.
  *
  * Note: It's the caller's responsibility to make sure that we don't end up
  * with a huge number of callbacks waiting, making it easy to create a
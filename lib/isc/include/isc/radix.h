@@ -191,6 +191,65 @@ isc_radix_process(isc_radix_tree_t *radix, isc_radix_processfunc_t func);
  * \li	'func' to point to a function.
  */
 
+/*
+ * A compiled radix tree is an immutable multibit trie (a "poptrie")
+ * built from the prefixes in a radix tree.  Each trie node covers
+ * six bits of the address and holds two 64-bit vectors: one marks
+ * the slots that continue in a child node, the other marks where a
+ * new run of identical results starts.  Children and results are
+ * kept in two flat arrays and are found by counting the bits set
+ * below the slot, so a host address is matched with one memory
+ * access per six bits instead of a walk of a binary tree.
+ *
+ * The result stored in each slot is the radix node that the "first
+ * match" search above would return for every address under it, so
+ * isc_radix_compiled_search() returns exactly what isc_radix_search()
+ * returns for the same host address.  The compiled form does not
+ * follow changes made to the radix tree afterwards; it has to be
+ * destroyed and compiled again.
+ */
+typedef struct isc_radix_compiled isc_radix_compiled_t;
+
+void
+isc_radix_compile(isc_radix_tree_t *radix, isc_radix_compiled_t **target);
+/*%<
+ * Compile the prefixes in 'radix' into an immutable trie.  The trie
+ * refers to the nodes of 'radix', which must not be changed or
+ * destroyed while the compiled form is in use.
+ *
+ * Requires:
+ * \li	'radix' to be valid.
+ * \li	'target' is not NULL and "*target" is NULL.
+ */
+
+isc_result_t
+isc_radix_compiled_search(const isc_radix_compiled_t *compiled,
+			  isc_radix_node_t	   **target,
+			  const isc_prefix_t	    *prefix);
+/*%<
+ * Search 'compiled' for the first match to the host address 'prefix'.
+ * Return the node found in '*target'.
+ *
+ * Requires:
+ * \li	'compiled' to be valid.
+ * \li	'target' is not NULL and "*target" is NULL.
+ * \li	'prefix' to be an AF_INET prefix of 32 bits or an AF_INET6
+ *	prefix of 128 bits.
+ *
+ * Returns:
+ * \li	ISC_R_NOTFOUND
+ * \li	ISC_R_SUCCESS
+ */
+
+void
+isc_radix_compiled_destroy(isc_radix_compiled_t **compiledp);
+/*%<
+ * Destroy the compiled trie '*compiledp' and set it to NULL.
+ *
+ * Requires:
+ * \li	'compiledp' is not NULL and '*compiledp' is valid.
+ */
+
 #define RADIX_MAXBITS  128
 #define RADIX_NBIT(x)  (0x80 >> ((x)&0x7f))
 #define RADIX_NBYTE(x) ((x) >> 3)
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file isc/rcu.h
+ * \brief
+ * Epoch-based deferred reclamation for data read without locks.
+ *
+ * A reader brackets its accesses to shared data with isc_rcu_read_lock()
+ * and isc_rcu_read_unlock(); this only writes to a slot private to the
+ * calling loop thread.  A writer that has unlinked some memory calls
+ * isc_rcu_retire() to get a tag for it, and may free the memory once
+ * isc_rcu_expired() returns true for that tag, that is once every reader
+ * that was inside a read-side critical section when the memory was
+ * unlinked has left it.
+ *
+ * Only loop threads with a known isc_tid() have a slot; other threads
+ * must check isc_rcu_available() and use some other form of locking.
+ * Critical sections may nest, but must not block or run across loop
+ * callbacks.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/lang.h>
+
+/*%
+ * The number of loop threads that can take part.
+ */
+#define ISC_RCU_MAXTHREADS 512
+
+ISC_LANG_BEGINDECLS
+
+bool
+isc_rcu_available(void);
+/*%<
+ * Return true if the calling thread can use isc_rcu_read_lock().
+ */
+
+void
+isc_rcu_read_lock(void);
+void
+isc_rcu_read_unlock(void);
+/*%<
+ * Enter or leave a read-side critical section.
+ *
+ * Requires:
+ *\li	isc_rcu_available() is true.
+ */
+
+uint64_t
+isc_rcu_retire(void);
+/*%<
+ * Start a new epoch and return a tag for memory that was unlinked
+ * before the call.
+ */
+
+bool
+isc_rcu_expired(uint64_t tag);
+/*%<
+ * Return true if no reader can still be using memory tagged 'tag'.
+ */
+
+void
+isc_rcu_synchronize(void);
+/*%<
+ * Wait until every reader that was inside a read-side critical section
+ * when this was called has left it, so that memory unlinked before the
+ * call can be freed at once.
+ *
+ * Requires:
+ *\li	The calling thread is not inside a read-side critical section.
+ */
+
+ISC_LANG_ENDDECLS
@@ -21,6 +21,7 @@
 #include <isc/atomic.h>
 #include <isc/condition.h>
 #include <isc/lang.h>
+#include <isc/lockprof.h>
 #include <isc/types.h>
 #include <isc/util.h>
 
@@ -38,6 +39,9 @@ typedef enum {
 struct isc_rwlock {
 	pthread_rwlock_t rwlock;
 	atomic_bool	 downgrade;
+#if ISC_LOCK_PROFILE
+	isc_lockstats_t *stats;
+#endif /* ISC_LOCK_PROFILE */
 };
 
 #if ISC_TRACK_PTHREADS_OBJECTS
@@ -112,6 +116,20 @@ struct isc_rwlock {
 
 	/* Unlocked. */
 	unsigned int write_quota;
+
+#if USE_RWLOCK_READER_BIAS
+	/*
+	 * While 'reader_bias' is set, readers announce themselves in
+	 * per-thread slots instead of updating 'cnt_and_flag'; writers
+	 * clear it and wait for the slots to drain.
+	 */
+	atomic_bool	     reader_bias;
+	atomic_uint_fast64_t inhibit_until;
+#endif /* USE_RWLOCK_READER_BIAS */
+
+#if ISC_LOCK_PROFILE
+	isc_lockstats_t *stats;
+#endif /* ISC_LOCK_PROFILE */
 };
 
 typedef struct isc_rwlock isc_rwlock_t;
@@ -127,6 +145,27 @@ typedef struct isc_rwlock isc__rwlock_t;
 
 #endif /* USE_PTHREAD_RWLOCK */
 
+#if ISC_LOCK_PROFILE
+
+#define isc__rwlock_init(rwl, rq, wq)                                \
+	{                                                            \
+		int _ret = isc___rwlock_init(rwl, rq, wq);           \
+		PTHREADS_RUNTIME_CHECK(isc___rwlock_init, _ret);     \
+		(rwl)->stats = isc__lockprof_site("rwlock", __FILE__, \
+						  __LINE__);         \
+	}
+
+#define isc__rwlock_lock(rwl, type)                                      \
+	{                                                                \
+		int _ret = isc___rwlock_lock_profile(rwl, type);         \
+		PTHREADS_RUNTIME_CHECK(isc___rwlock_lock_profile, _ret); \
+	}
+
+int
+isc___rwlock_lock_profile(isc__rwlock_t *rwl, isc_rwlocktype_t type);
+
+#else /* ISC_LOCK_PROFILE */
+
 #define isc__rwlock_init(rwl, rq, wq)                            \
 	{                                                        \
 		int _ret = isc___rwlock_init(rwl, rq, wq);       \
@@ -139,6 +178,8 @@ typedef struct isc_rwlock isc__rwlock_t;
 		PTHREADS_RUNTIME_CHECK(isc___rwlock_lock, _ret); \
 	}
 
+#endif /* ISC_LOCK_PROFILE */
+
 #define isc__rwlock_unlock(rwl, type)                              \
 	{                                                          \
 		int _ret = isc___rwlock_unlock(rwl, type);         \
@@ -28,9 +28,14 @@ ISC_LANG_BEGINDECLS
 
 void
 isc_siphash24(const uint8_t *key, const uint8_t *in, const size_t inlen,
-	      uint8_t *out);
+	      bool case_sensitive, uint8_t *out);
 void
 isc_halfsiphash24(const uint8_t *key, const uint8_t *in, const size_t inlen,
-		  uint8_t *out);
+		  bool case_sensitive, uint8_t *out);
+/*%<
+ * Compute the SipHash-2-4 or HalfSipHash-2-4 of the 'inlen' bytes at
+ * 'in' with 'key', and store it in 'out'.  If 'case_sensitive' is false,
+ * ASCII upper case letters in the input are hashed as lower case.
+ */
 
 ISC_LANG_ENDDECLS
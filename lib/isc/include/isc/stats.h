@@ -100,7 +100,24 @@ enum {
 	isc_sockstatscounter_rawrecvfail = 60,
 	isc_sockstatscounter_rawactive = 61,
 
-	isc_sockstatscounter_max = 62
+	isc_sockstatscounter_udpsendbatch = 62,
+	isc_sockstatscounter_udpsendbatched = 63,
+	isc_sockstatscounter_udpsendgso = 64,
+	isc_sockstatscounter_udpsendbatchmax = 65,
+
+	isc_sockstatscounter_httpcachehit = 66,
+	isc_sockstatscounter_httpcachemiss = 67,
+
+	isc_sockstatscounter_tlshandshake = 68,
+	isc_sockstatscounter_tlsresumed = 69,
+
+	isc_sockstatscounter_httpstreamsmax = 70,
+	isc_sockstatscounter_httpflowstall = 71,
+
+	isc_sockstatscounter_tcpdnsbufbytes = 72,
+	isc_sockstatscounter_tlsdnsbufbytes = 73,
+
+	isc_sockstatscounter_max = 74
 };
 
 ISC_LANG_BEGINDECLS
@@ -132,6 +149,32 @@ isc_stats_create(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters);
  *\li	anything else	-- failure
  */
 
+isc_result_t
+isc_stats_createsharded(isc_mem_t *mctx, isc_stats_t **statsp,
+			int ncounters);
+/*%<
+ * Like isc_stats_create(), but keep a separate, cache line aligned copy
+ * of the counters for each loop thread, so that threads updating the
+ * same counter do not contend for it.  Reading a counter sums the
+ * copies, which makes isc_stats_get_counter() and isc_stats_dump()
+ * more expensive, and the set uses considerably more memory.  It is
+ * meant for the few server-wide sets updated for every query.
+ *
+ * isc_stats_update_if_greater() only looks at one of the copies, so a
+ * high-water mark counter must not also be incremented, decremented or
+ * added to.
+ *
+ * Requires:
+ *\li	'mctx' must be a valid memory context.
+ *
+ *\li	'statsp' != NULL && '*statsp' == NULL.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS	-- all ok
+ *
+ *\li	anything else	-- failure
+ */
+
 void
 isc_stats_attach(isc_stats_t *stats, isc_stats_t **statsp);
 /*%<
@@ -183,6 +226,15 @@ isc_stats_decrement(isc_stats_t *stats, isc_statscounter_t counter);
  *\li	'stats' is a valid isc_stats_t.
  */
 
+void
+isc_stats_add(isc_stats_t *stats, isc_statscounter_t counter, uint64_t val);
+/*%<
+ * Add 'val' to the counter-th counter of stats.
+ *
+ * Requires:
+ *\li	'stats' is a valid isc_stats_t.
+ */
+
 void
 isc_stats_dump(isc_stats_t *stats, isc_stats_dumper_t dump_fn, void *arg,
 	       unsigned int options);
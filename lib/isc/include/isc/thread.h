@@ -48,6 +48,25 @@ isc_thread_yield(void);
 void
 isc_thread_setname(isc_thread_t thread, const char *name);
 
+int
+isc_thread_cpu(unsigned int n);
+/*%<
+ * Return the 'n'-th CPU the calling thread is allowed to run on, wrapping
+ * around when there are fewer.  Where the affinity can't be queried,
+ * all the online CPUs are assumed to be allowed.
+ */
+
+isc_result_t
+isc_thread_setaffinity(int cpu);
+/*%<
+ * Bind the calling thread to 'cpu'.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_FAILURE		the CPU could not be set
+ *\li	#ISC_R_NOTIMPLEMENTED	not supported on this platform
+ */
+
 #define isc_thread_self (uintptr_t) pthread_self
 
 ISC_LANG_ENDDECLS
@@ -80,14 +80,17 @@ typedef enum {
  *** those functions which return an isc_result_t.
  ***/
 
+#define isc_timer_create(loop, cb, cbarg, timerp) \
+	isc__timer_create(loop, cb, cbarg, timerp, #cb)
 void
-isc_timer_create(isc_loop_t *loop, isc_job_cb cb, void *cbarg,
-		 isc_timer_t **timerp);
+isc__timer_create(isc_loop_t *loop, isc_job_cb cb, void *cbarg,
+		  isc_timer_t **timerp, const char *name);
 /*%<
  * Create a new 'type' timer managed by 'loop'.  The timers parameters are
  * specified by 'expires' and 'interval'.  Events will be posted on the isc
  * event loop and when dispatched 'cb' will be called with 'cbarg' as the arg
- * value.  The new timer is returned in 'timerp'.
+ * value.  The new timer is returned in 'timerp'.  'name' is the name of
+ * 'cb' in the loop health statistics.
  *
  * Requires:
  *
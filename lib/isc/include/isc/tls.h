@@ -160,6 +160,31 @@ isc_tlsctx_session_tickets(isc_tlsctx_t *ctx, const bool use);
  * \li	'ctx' != NULL.
  */
 
+isc_result_t
+isc_tlsctx_load_ticket_keys(isc_tlsctx_t *ctx, const char *keyfile);
+/*%<
+ * Load the session ticket encryption keys of the server TLS context
+ * 'ctx' from 'keyfile', instead of using random keys generated for
+ * each context.  Sharing the file lets session tickets be resumed
+ * across restarts, reconfigurations and servers.
+ *
+ * The file holds up to 8 keys of 80 bytes each: a 16 byte key name,
+ * a 32 byte HMAC-SHA256 secret and a 32 byte AES-256 key.  The first
+ * key is used to issue new tickets; tickets issued with the other keys
+ * are accepted and renewed.  This is the format used by nginx, so such
+ * files can be generated with "openssl rand 80".
+ *
+ * Requires:
+ * \li	'ctx' != NULL;
+ * \li	'keyfile' is a valid, non-empty string.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_FILENOTFOUND	the file could not be opened
+ * \li	#ISC_R_INVALIDFILE	the file does not hold 1 to 8 keys
+ * \li	#ISC_R_FAILURE		the keys could not be set
+ */
+
 isc_tls_t *
 isc_tls_create(isc_tlsctx_t *ctx);
 /*%<
@@ -188,6 +213,60 @@ isc_tls_verify_peer_result_string(isc_tls_t *tls);
  *\li	'tls' != NULL.
  */
 
+bool
+isc_tls_ktls_supported(void);
+/*%<
+ * Return 'true' if the library has been built with support for the
+ * kernel TLS offload.
+ */
+
+isc_result_t
+isc_tls_ktls_prepare(isc_tls_t *tls);
+/*%<
+ * Prepare 'tls' for handing the record protection over to the kernel
+ * after the handshake.  This must be called before the handshake starts.
+ *
+ * Requires:
+ *\li	'tls' != NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTIMPLEMENTED	kernel TLS offload is not supported
+ *\li	#ISC_R_NOMEMORY
+ */
+
+isc_result_t
+isc_tls_ktls_start_tx(isc_tls_t *tls, int fd);
+isc_result_t
+isc_tls_ktls_start_rx(isc_tls_t *tls, int fd);
+/*%<
+ * Make the kernel encrypt the records sent on (decrypt the records
+ * received from) the TCP socket 'fd' carrying the TLS connection 'tls'.
+ * On success, plaintext must be written to (is read from) 'fd' directly,
+ * and 'tls' must not be used for that direction anymore.
+ *
+ * Only TLS 1.3 with AES-GCM or ChaCha20-Poly1305 is supported.
+ *
+ * Requires:
+ *\li	'tls' != NULL and prepared with isc_tls_ktls_prepare();
+ *\li	the handshake has finished.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_WOULDBLOCK	the connection is not at a record boundary
+ *				yet; try again later
+ *\li	#ISC_R_NOTIMPLEMENTED	the offload can't be used on this
+ *				connection
+ *\li	#ISC_R_TLSERROR
+ */
+
+isc_result_t
+isc_tls_ktls_close_notify(int fd);
+/*%<
+ * Send a close_notify alert on the TCP socket 'fd' which has been
+ * switched to the kernel TLS offload with isc_tls_ktls_start_tx().
+ */
+
 #if HAVE_LIBNGHTTP2
 void
 isc_tlsctx_enable_http2client_alpn(isc_tlsctx_t *ctx);
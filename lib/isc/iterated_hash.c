@@ -12,6 +12,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include <isc/iterated_hash.h>
 #include <isc/md.h>
@@ -73,4 +74,187 @@ md_fail:
 	isc_md_free(md);
 	return (0);
 }
+
+#if defined(__GNUC__)
+/*
+ * Lane-parallel SHA-1 for isc_iterated_hash_many().  Every iteration
+ * after the first hashes a SHA-1 digest followed by the same salt, so
+ * the padded message blocks of all the chains only differ in their
+ * first five words, which are the state words of the previous digest.
+ * The chains are kept in vector lanes; the compiler generates SSE,
+ * AVX2 or AVX-512 code for the vector operations depending on the
+ * target, and splits them into narrower operations where needed.
+ */
+#define LANES ISC_ITERATED_HASH_LANES
+
+typedef uint32_t lane_t __attribute__((vector_size(LANES * sizeof(uint32_t))));
+
+#define SHA1_LENGTH 20
+
+#define ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+/* 20 bytes of digest, 255 bytes of salt, 9 bytes of padding */
+#define MAXBLOCKS ((SHA1_LENGTH + 255 + 9 + 63) / 64)
+
+static const uint32_t sha1_iv[5] = { 0x67452301, 0xefcdab89, 0x98badcfe,
+				     0x10325476, 0xc3d2e1f0 };
+
+static void
+sha1_lanes(lane_t h[5], const lane_t block[16]) {
+	lane_t w[16];
+	lane_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+	lane_t f, t;
+	uint32_t k;
+
+	memmove(w, block, sizeof(w));
+
+	for (unsigned int i = 0; i < 80; i++) {
+		if (i >= 16) {
+			t = w[(i + 13) & 15] ^ w[(i + 8) & 15] ^
+			    w[(i + 2) & 15] ^ w[i & 15];
+			w[i & 15] = ROL(t, 1);
+		}
+		if (i < 20) {
+			f = (b & c) | (~b & d);
+			k = 0x5a827999;
+		} else if (i < 40) {
+			f = b ^ c ^ d;
+			k = 0x6ed9eba1;
+		} else if (i < 60) {
+			f = (b & c) | (b & d) | (c & d);
+			k = 0x8f1bbcdc;
+		} else {
+			f = b ^ c ^ d;
+			k = 0xca62c1d6;
+		}
+		t = ROL(a, 5) + f + e + k + w[i & 15];
+		e = d;
+		d = c;
+		c = ROL(b, 30);
+		b = a;
+		a = t;
+	}
+
+	h[0] += a;
+	h[1] += b;
+	h[2] += c;
+	h[3] += d;
+	h[4] += e;
+}
+
+static void
+iterated_hash_lanes(unsigned char *const out[], const unsigned int count,
+		    const int iterations, const unsigned char *salt,
+		    const int saltlength) {
+	unsigned char msg[MAXBLOCKS * 64] = { 0 };
+	lane_t blocks[MAXBLOCKS][16];
+	lane_t h[5];
+	size_t len = SHA1_LENGTH + saltlength;
+	unsigned int nblocks = (len + 9 + 63) / 64;
+	uint64_t bits = (uint64_t)len * 8;
+
+	INSIST(count <= LANES);
+	INSIST(nblocks <= MAXBLOCKS);
+
+	/*
+	 * Build the padded message once; the digest words of the first
+	 * block are replaced by the lanes' state before each iteration.
+	 */
+	memmove(msg + SHA1_LENGTH, salt, saltlength);
+	msg[len] = 0x80;
+	for (unsigned int i = 0; i < 8; i++) {
+		msg[nblocks * 64 - 1 - i] = (bits >> (i * 8)) & 0xff;
+	}
+	for (unsigned int i = 0; i < nblocks * 16; i++) {
+		const unsigned char *p = msg + i * 4;
+		uint32_t word = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+				((uint32_t)p[2] << 8) | (uint32_t)p[3];
+
+		blocks[i / 16][i % 16] = (lane_t){ 0 } + word;
+	}
+
+	/*
+	 * Load the digests of the first iteration.
+	 */
+	for (unsigned int j = 0; j < 5; j++) {
+		h[j] = (lane_t){ 0 };
+		for (unsigned int l = 0; l < count; l++) {
+			const unsigned char *p = out[l] + j * 4;
+			h[j][l] = ((uint32_t)p[0] << 24) |
+				  ((uint32_t)p[1] << 16) |
+				  ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+		}
+	}
+
+	for (int n = 0; n < iterations; n++) {
+		memmove(blocks[0], h, sizeof(h));
+		for (unsigned int j = 0; j < 5; j++) {
+			h[j] = (lane_t){ 0 } + sha1_iv[j];
+		}
+		for (unsigned int i = 0; i < nblocks; i++) {
+			sha1_lanes(h, blocks[i]);
+		}
+	}
+
+	for (unsigned int l = 0; l < count; l++) {
+		for (unsigned int j = 0; j < 5; j++) {
+			unsigned char *p = out[l] + j * 4;
+			p[0] = (h[j][l] >> 24) & 0xff;
+			p[1] = (h[j][l] >> 16) & 0xff;
+			p[2] = (h[j][l] >> 8) & 0xff;
+			p[3] = h[j][l] & 0xff;
+		}
+	}
+}
+#endif /* defined(__GNUC__) */
+
+int
+isc_iterated_hash_many(unsigned char *const out[], const unsigned int hashalg,
+		       const int iterations, const unsigned char *salt,
+		       const int saltlength, const unsigned char *const in[],
+		       const int inlength[], const unsigned int count) {
+	int outlength = 0;
+
+	REQUIRE(out != NULL);
+	REQUIRE(in != NULL && inlength != NULL);
+	REQUIRE(saltlength >= 0 && saltlength <= 255);
+
+	if (hashalg != 1) {
+		return (0);
+	}
+
+#if defined(__GNUC__)
+	for (unsigned int i = 0; i < count; i += LANES) {
+		unsigned int n = ISC_MIN(count - i, LANES);
+
+		/*
+		 * The first iteration hashes inputs of different lengths,
+		 * so it is done for each chain on its own.
+		 */
+		for (unsigned int l = 0; l < n; l++) {
+			outlength = isc_iterated_hash(out[i + l], hashalg, 0,
+						      salt, saltlength,
+						      in[i + l],
+						      inlength[i + l]);
+			if (outlength == 0) {
+				return (0);
+			}
+		}
+		if (iterations > 0) {
+			iterated_hash_lanes(out + i, n, iterations, salt,
+					    saltlength);
+		}
+	}
+#else  /* defined(__GNUC__) */
+	for (unsigned int i = 0; i < count; i++) {
+		outlength = isc_iterated_hash(out[i], hashalg, iterations, salt,
+					      saltlength, in[i], inlength[i]);
+		if (outlength == 0) {
+			return (0);
+		}
+	}
+#endif /* defined(__GNUC__) */
+
+	return (outlength);
+}
 #undef RETERR
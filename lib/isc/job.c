@@ -68,12 +68,15 @@ isc__job_destroy(isc_job_t *job) {
 static void
 isc__job_cb(uv_idle_t *idle) {
 	isc_job_t *job = uv_handle_get_data(idle);
+	uint64_t start = uv_hrtime();
 	int r;
 
 	REQUIRE(job->loop == isc_loop_current(job->loop->loopmgr));
 
 	job->cb(job->cbarg);
 
+	isc__loop_callback_done(job->loop, job->name, start);
+
 	r = uv_idle_stop(idle);
 	UV_RUNTIME_CHECK(uv_idle_stop, r);
 
@@ -85,9 +88,10 @@ isc__job_cb(uv_idle_t *idle) {
  */
 
 void
-isc_job_run(isc_loopmgr_t *loopmgr, isc_job_cb cb, void *cbarg) {
+isc__job_run_named(isc_loopmgr_t *loopmgr, isc_job_cb cb, void *cbarg,
+		   const char *name) {
 	isc_loop_t *loop = isc_loop_current(loopmgr);
-	isc_job_t *job = isc__job_new(loop, cb, cbarg);
+	isc_job_t *job = isc__job_new(loop, cb, cbarg, name);
 	isc__job_init(loop, job);
 	isc__job_run(job);
 }
@@ -97,7 +101,7 @@ isc_job_run(isc_loopmgr_t *loopmgr, isc_job_cb cb, void *cbarg) {
  */
 
 isc_job_t *
-isc__job_new(isc_loop_t *loop, isc_job_cb cb, void *cbarg) {
+isc__job_new(isc_loop_t *loop, isc_job_cb cb, void *cbarg, const char *name) {
 	isc_job_t *job = NULL;
 
 	REQUIRE(VALID_LOOP(loop));
@@ -108,6 +112,7 @@ isc__job_new(isc_loop_t *loop, isc_job_cb cb, void *cbarg) {
 		.magic = JOB_MAGIC,
 		.cb = cb,
 		.cbarg = cbarg,
+		.name = name,
 	};
 
 	isc_loop_attach(loop, &job->loop);
@@ -17,7 +17,7 @@
 #include <isc/loop.h>
 
 isc_job_t *
-isc__job_new(isc_loop_t *loop, isc_job_cb cb, void *cbarg);
+isc__job_new(isc_loop_t *loop, isc_job_cb cb, void *cbarg, const char *name);
 
 void
 isc__job_init(isc_loop_t *loop, isc_job_t *job);
@@ -318,27 +318,165 @@ pushback(inputsource *source, int c) {
 	}
 }
 
+static void
+growpushback(isc_lex_t *lex, inputsource *source) {
+	isc_buffer_t *tbuf = NULL;
+	unsigned int oldlen;
+	isc_region_t used;
+	isc_result_t result;
+
+	oldlen = isc_buffer_length(source->pushback);
+	isc_buffer_allocate(lex->mctx, &tbuf, oldlen * 2);
+	isc_buffer_usedregion(source->pushback, &used);
+	result = isc_buffer_copyregion(tbuf, &used);
+	INSIST(result == ISC_R_SUCCESS);
+	tbuf->current = source->pushback->current;
+	isc_buffer_free(&source->pushback);
+	source->pushback = tbuf;
+}
+
 static isc_result_t
 pushandgrow(isc_lex_t *lex, inputsource *source, int c) {
 	if (isc_buffer_availablelength(source->pushback) == 0) {
-		isc_buffer_t *tbuf = NULL;
-		unsigned int oldlen;
-		isc_region_t used;
-		isc_result_t result;
-
-		oldlen = isc_buffer_length(source->pushback);
-		isc_buffer_allocate(lex->mctx, &tbuf, oldlen * 2);
-		isc_buffer_usedregion(source->pushback, &used);
-		result = isc_buffer_copyregion(tbuf, &used);
-		INSIST(result == ISC_R_SUCCESS);
-		tbuf->current = source->pushback->current;
-		isc_buffer_free(&source->pushback);
-		source->pushback = tbuf;
+		growpushback(lex, source);
 	}
 	isc_buffer_putuint8(source->pushback, (uint8_t)c);
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Return the next character of 'source' without going through the
+ * pushback buffer, or EOF.  End of input and read errors are left for
+ * the main loop of isc_lex_gettoken() to detect on its next read.
+ */
+static int
+readchar(inputsource *source) {
+	if (source->is_file) {
+#if defined(HAVE_FLOCKFILE) && defined(HAVE_GETC_UNLOCKED)
+		return (getc_unlocked((FILE *)source->input));
+#else  /* if defined(HAVE_FLOCKFILE) && defined(HAVE_GETC_UNLOCKED) */
+		return (getc((FILE *)source->input));
+#endif /* if defined(HAVE_FLOCKFILE) && defined(HAVE_GETC_UNLOCKED) */
+	} else {
+		isc_buffer_t *buffer = source->input;
+
+		if (buffer->current == buffer->used) {
+			return (EOF);
+		}
+		return (*((unsigned char *)buffer->base + buffer->current++));
+	}
+}
+
+/*
+ * Consume the rest of a comment up to, but not including, the next
+ * newline.  The comment text is still recorded in the pushback buffer,
+ * as if it had been read one character at a time.
+ */
+static isc_result_t
+skipcomment(isc_lex_t *lex, inputsource *source) {
+	isc_result_t result;
+	int c;
+
+	if (!source->is_file) {
+		isc_buffer_t *buffer = source->input;
+		unsigned char *base = isc_buffer_current(buffer);
+		unsigned int length = isc_buffer_remaininglength(buffer);
+		unsigned char *nl = memchr(base, '\n', length);
+
+		if (nl != NULL) {
+			length = (unsigned int)(nl - base);
+		}
+		while (isc_buffer_availablelength(source->pushback) < length) {
+			growpushback(lex, source);
+		}
+		isc_buffer_putmem(source->pushback, base, length);
+		isc_buffer_forward(source->pushback, length);
+		isc_buffer_forward(buffer, length);
+		return (ISC_R_SUCCESS);
+	}
+
+	for (;;) {
+		c = readchar(source);
+		if (c == EOF) {
+			return (ISC_R_SUCCESS);
+		}
+		result = pushandgrow(lex, source, c);
+		if (result != ISC_R_SUCCESS || c == '\n') {
+			return (result);
+		}
+		isc_buffer_forward(source->pushback, 1);
+	}
+}
+
+/*
+ * Return true if 'c' continues an unquoted string token without
+ * needing any of the special handling in isc_lex_gettoken().
+ */
+static bool
+plainchar(isc_lex_t *lex, unsigned int options, int c) {
+	switch (c) {
+	case EOF:
+	case ' ':
+	case '\t':
+	case '\r':
+	case '\n':
+	case '\\':
+		return (false);
+	case ';':
+		return ((lex->comments & ISC_LEXCOMMENT_DNSMASTERFILE) == 0);
+	case '/':
+		return ((lex->comments &
+			 (ISC_LEXCOMMENT_C | ISC_LEXCOMMENT_CPLUSPLUS)) == 0);
+	case '#':
+		return ((lex->comments & ISC_LEXCOMMENT_SHELL) == 0);
+	case '=':
+		return ((options & ISC_LEXOPT_VPAIR) == 0);
+	default:
+		return (!lex->specials[c]);
+	}
+}
+
+/*
+ * Append a run of plain characters to the string token being built,
+ * reading them straight from the source instead of one at a time
+ * through the state machine.  They are still recorded in the pushback
+ * buffer so that the token can be ungotten.  The first character that
+ * is not plain is pushed back unconsumed for the state machine.
+ */
+static isc_result_t
+scanstring(isc_lex_t *lex, inputsource *source, unsigned int options,
+	   size_t *remainingp, char **currp, char **prevp) {
+	isc_result_t result;
+	int c;
+
+	if (isc_buffer_remaininglength(source->pushback) != 0) {
+		return (ISC_R_SUCCESS);
+	}
+
+	for (;;) {
+		c = readchar(source);
+		if (c == EOF) {
+			return (ISC_R_SUCCESS);
+		}
+		result = pushandgrow(lex, source, c);
+		if (result != ISC_R_SUCCESS || !plainchar(lex, options, c)) {
+			return (result);
+		}
+		isc_buffer_forward(source->pushback, 1);
+
+		if (*remainingp == 0U) {
+			result = grow_data(lex, remainingp, currp, prevp);
+			if (result != ISC_R_SUCCESS) {
+				return (result);
+			}
+		}
+		INSIST(*remainingp > 0U);
+		*(*currp)++ = c;
+		**currp = '\0';
+		(*remainingp)--;
+	}
+}
+
 isc_result_t
 isc_lex_gettoken(isc_lex_t *lex, unsigned int options, isc_token_t *tokenp) {
 	inputsource *source;
@@ -743,6 +881,15 @@ isc_lex_gettoken(isc_lex_t *lex, unsigned int options, isc_token_t *tokenp) {
 			*curr++ = c;
 			*curr = '\0';
 			remaining--;
+			if (state == lexstate_string && !escaped) {
+				source->result = scanstring(lex, source,
+							    options, &remaining,
+							    &curr, &prev);
+				if (source->result != ISC_R_SUCCESS) {
+					result = source->result;
+					goto done;
+				}
+			}
 			break;
 		case lexstate_maybecomment:
 			if (c == '*' && (lex->comments & ISC_LEXCOMMENT_C) != 0)
@@ -795,6 +942,13 @@ isc_lex_gettoken(isc_lex_t *lex, unsigned int options, isc_token_t *tokenp) {
 				state = saved_state;
 				goto no_read;
 			}
+			if (isc_buffer_remaininglength(source->pushback) == 0) {
+				source->result = skipcomment(lex, source);
+				if (source->result != ISC_R_SUCCESS) {
+					result = source->result;
+					goto done;
+				}
+			}
 			break;
 		case lexstate_qstring:
 		case lexstate_qvpair:
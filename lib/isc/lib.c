@@ -20,6 +20,7 @@
 #include <isc/util.h>
 
 #include "config.h"
+#include "cpu_p.h"
 #include "mem_p.h"
 #include "mutex_p.h"
 #include "os_p.h"
@@ -42,6 +43,7 @@ isc__shutdown(void) ISC_DESTRUCTOR;
 void
 isc__initialize(void) {
 	isc__os_initialize();
+	isc__cpu_initialize();
 	isc__mutex_initialize();
 	isc__mem_initialize();
 	isc__tls_initialize();
@@ -53,6 +55,7 @@ void
 isc__shutdown(void) {
 	isc__trampoline_shutdown();
 	isc__tls_shutdown();
+	isc__memprof_shutdown();
 	isc__mem_shutdown();
 	isc__mutex_shutdown();
 	isc__os_shutdown();
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <isc/atomic.h>
+#include <isc/lockprof.h>
+#include <isc/mem.h>
+#include <isc/util.h>
+
+#if ISC_LOCK_PROFILE
+
+/*
+ * The number of distinct lock initialization sites that can be
+ * profiled; BIND has a few hundred.  Must be a power of two.
+ */
+#define LOCKPROF_SITES 4096
+
+struct isc_lockstats {
+	const char *type;
+	const char *file;
+	unsigned int line;
+	atomic_uint_fast64_t locks;
+	atomic_uint_fast64_t contended;
+	atomic_uint_fast64_t waited;
+	atomic_uint_fast64_t maxwait;
+};
+
+/*
+ * The table of sites is only modified when a lock is initialized, under
+ * 'siteslock'.  This is a plain pthread mutex, so that it is not
+ * profiled itself.
+ */
+static isc_lockstats_t sites[LOCKPROF_SITES];
+static pthread_mutex_t siteslock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint32_t
+site_hash(const char *file, unsigned int line) {
+	uint32_t hash = 2166136261U;
+
+	for (const char *p = file; *p != '\0'; p++) {
+		hash = (hash ^ (unsigned char)*p) * 16777619U;
+	}
+
+	return ((hash ^ line) * 16777619U);
+}
+
+isc_lockstats_t *
+isc__lockprof_site(const char *type, const char *file, unsigned int line) {
+	isc_lockstats_t *stats = NULL;
+	uint32_t slot = site_hash(file, line);
+
+	RUNTIME_CHECK(pthread_mutex_lock(&siteslock) == 0);
+	for (size_t i = 0; i < LOCKPROF_SITES; i++, slot++) {
+		isc_lockstats_t *s = &sites[slot & (LOCKPROF_SITES - 1)];
+
+		if (s->file == NULL) {
+			s->type = type;
+			s->file = file;
+			s->line = line;
+			stats = s;
+			break;
+		}
+		if (s->line == line && strcmp(s->file, file) == 0) {
+			stats = s;
+			break;
+		}
+	}
+	RUNTIME_CHECK(pthread_mutex_unlock(&siteslock) == 0);
+
+	return (stats);
+}
+
+uint64_t
+isc__lockprof_now(void) {
+	struct timespec ts;
+
+	RUNTIME_CHECK(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+void
+isc__lockprof_record(isc_lockstats_t *stats, bool contended, uint64_t waited) {
+	uint_fast64_t maxwait;
+
+	if (stats == NULL) {
+		return;
+	}
+
+	atomic_fetch_add_relaxed(&stats->locks, 1);
+	if (!contended) {
+		return;
+	}
+
+	atomic_fetch_add_relaxed(&stats->contended, 1);
+	atomic_fetch_add_relaxed(&stats->waited, waited);
+
+	maxwait = atomic_load_relaxed(&stats->maxwait);
+	while (waited > maxwait &&
+	       !atomic_compare_exchange_weak_relaxed(&stats->maxwait,
+						     &maxwait, waited))
+	{
+		/* retry */;
+	}
+}
+
+bool
+isc_lockprof_enabled(void) {
+	return (true);
+}
+
+static int
+lockprof_compare(const void *a, const void *b) {
+	const isc_lockprof_t *sa = a, *sb = b;
+
+	if (sa->waited != sb->waited) {
+		return (sa->waited < sb->waited ? 1 : -1);
+	}
+	if (sa->contended != sb->contended) {
+		return (sa->contended < sb->contended ? 1 : -1);
+	}
+	return (sa->locks < sb->locks ? 1 : (sa->locks > sb->locks ? -1 : 0));
+}
+
+void
+isc_lockprof_sites(isc_mem_t *mctx, isc_lockprof_t **sitesp, size_t *countp) {
+	isc_lockprof_t *snapshot = NULL;
+	size_t count = 0;
+
+	REQUIRE(sitesp != NULL && *sitesp == NULL);
+	REQUIRE(countp != NULL);
+
+	RUNTIME_CHECK(pthread_mutex_lock(&siteslock) == 0);
+	for (size_t i = 0; i < LOCKPROF_SITES; i++) {
+		if (sites[i].file != NULL) {
+			count++;
+		}
+	}
+
+	if (count > 0) {
+		size_t n = 0;
+
+		snapshot = isc_mem_get(mctx, count * sizeof(snapshot[0]));
+		for (size_t i = 0; i < LOCKPROF_SITES; i++) {
+			isc_lockstats_t *s = &sites[i];
+
+			if (s->file == NULL) {
+				continue;
+			}
+			snapshot[n++] = (isc_lockprof_t){
+				.type = s->type,
+				.file = s->file,
+				.line = s->line,
+				.locks = atomic_load_relaxed(&s->locks),
+				.contended = atomic_load_relaxed(&s->contended),
+				.waited = atomic_load_relaxed(&s->waited),
+				.maxwait = atomic_load_relaxed(&s->maxwait),
+			};
+		}
+		INSIST(n == count);
+	}
+	RUNTIME_CHECK(pthread_mutex_unlock(&siteslock) == 0);
+
+	if (count > 1) {
+		qsort(snapshot, count, sizeof(snapshot[0]), lockprof_compare);
+	}
+
+	*sitesp = snapshot;
+	*countp = count;
+}
+
+void
+isc_lockprof_reset(void) {
+	RUNTIME_CHECK(pthread_mutex_lock(&siteslock) == 0);
+	for (size_t i = 0; i < LOCKPROF_SITES; i++) {
+		atomic_store_relaxed(&sites[i].locks, 0);
+		atomic_store_relaxed(&sites[i].contended, 0);
+		atomic_store_relaxed(&sites[i].waited, 0);
+		atomic_store_relaxed(&sites[i].maxwait, 0);
+	}
+	RUNTIME_CHECK(pthread_mutex_unlock(&siteslock) == 0);
+}
+
+#else /* ISC_LOCK_PROFILE */
+
+isc_lockstats_t *
+isc__lockprof_site(const char *type, const char *file, unsigned int line) {
+	UNUSED(type);
+	UNUSED(file);
+	UNUSED(line);
+
+	return (NULL);
+}
+
+uint64_t
+isc__lockprof_now(void) {
+	return (0);
+}
+
+void
+isc__lockprof_record(isc_lockstats_t *stats, bool contended, uint64_t waited) {
+	UNUSED(stats);
+	UNUSED(contended);
+	UNUSED(waited);
+}
+
+bool
+isc_lockprof_enabled(void) {
+	return (false);
+}
+
+void
+isc_lockprof_sites(isc_mem_t *mctx, isc_lockprof_t **sitesp, size_t *countp) {
+	UNUSED(mctx);
+
+	REQUIRE(sitesp != NULL && *sitesp == NULL);
+	REQUIRE(countp != NULL);
+
+	*countp = 0;
+}
+
+void
+isc_lockprof_reset(void) {
+	/* nothing to reset */;
+}
+
+#endif /* ISC_LOCK_PROFILE */
@@ -19,20 +19,25 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <sys/types.h> /* dev_t FreeBSD 2.1 */
+#include <sys/uio.h>
 #include <time.h>
+#include <unistd.h>
 
 #include <isc/atomic.h>
+#include <isc/condition.h>
 #include <isc/dir.h>
 #include <isc/file.h>
 #include <isc/log.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/os.h>
 #include <isc/print.h>
 #include <isc/rwlock.h>
 #include <isc/stat.h>
 #include <isc/stdio.h>
 #include <isc/string.h>
 #include <isc/thread.h>
+#include <isc/tid.h>
 #include <isc/time.h>
 #include <isc/util.h>
 
@@ -49,6 +54,26 @@ static thread_local bool forcelog = false;
  */
 #define LOG_BUFFER_SIZE (8 * 1024)
 
+/*
+ * Asynchronous logging: every thread with a thread id below
+ * LOG_ASYNC_THREADS gets a ring of LOG_ASYNC_RINGSIZE bytes for the
+ * messages it writes to the file channels, and the writer thread
+ * empties the rings every LOG_ASYNC_INTERVAL milliseconds, or sooner
+ * when a ring is half full.
+ */
+#define LOG_ASYNC_THREADS  128U
+#define LOG_ASYNC_RINGSIZE (256 * 1024)
+#define LOG_ASYNC_ALIGN	   16
+#define LOG_ASYNC_INTERVAL 10
+#define LOG_ASYNC_IOV	   64
+
+/*
+ * Per-thread buffers used to format the messages when logging
+ * asynchronously, in place of the shared, locked lctx->buffer.
+ */
+static thread_local char log_buffer[LOG_BUFFER_SIZE];
+static thread_local char log_line[LOG_BUFFER_SIZE + 256];
+
 /*!
  * This is the structure that holds each named channel.  A simple linked
  * list chains all of the channels together, so an individual channel is
@@ -85,6 +110,32 @@ struct isc_logchannellist {
 	ISC_LINK(isc_logchannellist_t) link;
 };
 
+/*!
+ * A message in an asynchronous logging ring: the header is followed by
+ * 'length' bytes of the formatted line, and the whole record is padded
+ * to 'size' bytes.  A record that would not fit before the end of the
+ * ring is preceded by a padding record with no channel that fills the
+ * rest of the ring, so every record is contiguous.
+ */
+typedef struct isc_logrecord {
+	isc_logchannel_t *channel;
+	uint32_t size;
+	uint32_t length;
+} isc_logrecord_t;
+
+/*!
+ * A single-producer, single-consumer ring.  'head' is only advanced by
+ * the thread that owns the ring, 'tail' only by whoever drains it while
+ * holding the log context lock.  Both are offsets that are never wrapped.
+ */
+typedef struct isc_logring {
+	atomic_size_t head;
+	uint8_t __padding0[ISC_OS_CACHELINE_SIZE - sizeof(atomic_size_t)];
+	atomic_size_t tail;
+	uint8_t __padding1[ISC_OS_CACHELINE_SIZE - sizeof(atomic_size_t)];
+	char data[LOG_ASYNC_RINGSIZE];
+} isc_logring_t;
+
 /*!
  * This structure is used to remember messages for pruning via
  * isc_log_[v]write1().
@@ -151,6 +202,15 @@ struct isc_log {
 	ISC_LIST(isc_logmessage_t) messages;
 	atomic_bool dynamic;
 	atomic_int_fast32_t highest_level;
+	/* Changed under the lcfg_rwl write lock */
+	atomic_bool async;
+	isc_thread_t writer;
+	/* Locked by isc_log lock. */
+	isc_condition_t wcond;
+	bool wshutdown;
+	/* Rings of the asynchronous logging, indexed by thread id */
+	atomic_uintptr_t rings[LOG_ASYNC_THREADS];
+	atomic_uint_fast64_t dropped;
 };
 
 /*!
@@ -217,6 +277,9 @@ sync_highest_level(isc_log_t *lctx, isc_logconfig_t *lcfg);
 static isc_result_t
 greatest_version(isc_logfile_t *file, int versions, int *greatest);
 
+static void
+log_async_drain(isc_log_t *lctx);
+
 static void
 isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 	     isc_logmodule_t *module, int level, bool write_once,
@@ -266,6 +329,14 @@ isc_log_create(isc_mem_t *mctx, isc_log_t **lctxp, isc_logconfig_t **lcfgp) {
 	isc_mutex_init(&lctx->lock);
 	isc_rwlock_init(&lctx->lcfg_rwl, 0, 0);
 
+	atomic_init(&lctx->async, false);
+	isc_condition_init(&lctx->wcond);
+	lctx->wshutdown = false;
+	for (size_t i = 0; i < LOG_ASYNC_THREADS; i++) {
+		atomic_init(&lctx->rings[i], (uintptr_t)NULL);
+	}
+	atomic_init(&lctx->dropped, 0);
+
 	/*
 	 * Normally setting the magic number is the last step done
 	 * in a creation function, but a valid log context is needed
@@ -366,6 +437,13 @@ isc_logconfig_use(isc_log_t *lctx, isc_logconfig_t *lcfg) {
 	sync_channellist(lcfg);
 
 	WRLOCK(&lctx->lcfg_rwl);
+	/*
+	 * The buffered messages refer to the channels of the old
+	 * configuration, so write them out before it goes away.
+	 */
+	LOCK(&lctx->lock);
+	log_async_drain(lctx);
+	UNLOCK(&lctx->lock);
 	old_cfg = lctx->logconfig;
 	lctx->logconfig = lcfg;
 	sync_highest_level(lctx, lcfg);
@@ -392,6 +470,8 @@ isc_log_destroy(isc_log_t **lctxp) {
 	atomic_store_release(&lctx->highest_level, 0);
 	atomic_store_release(&lctx->dynamic, false);
 
+	isc_log_setasync(lctx, false);
+
 	WRLOCK(&lctx->lcfg_rwl);
 	lcfg = lctx->logconfig;
 	lctx->logconfig = NULL;
@@ -401,6 +481,15 @@ isc_log_destroy(isc_log_t **lctxp) {
 		isc_logconfig_destroy(&lcfg);
 	}
 
+	for (size_t i = 0; i < LOG_ASYNC_THREADS; i++) {
+		isc_logring_t *ring =
+			(isc_logring_t *)atomic_load_relaxed(&lctx->rings[i]);
+		if (ring != NULL) {
+			isc_mem_put(mctx, ring, sizeof(*ring));
+		}
+	}
+
+	isc_condition_destroy(&lctx->wcond);
 	isc_rwlock_destroy(&lctx->lcfg_rwl);
 	isc_mutex_destroy(&lctx->lock);
 
@@ -923,6 +1012,42 @@ isc_log_closefilelogs(isc_log_t *lctx) {
 	RDUNLOCK(&lctx->lcfg_rwl);
 }
 
+static isc_threadresult_t
+log_writer(isc_threadarg_t arg);
+
+void
+isc_log_setasync(isc_log_t *lctx, bool async) {
+	REQUIRE(VALID_CONTEXT(lctx));
+
+	/*
+	 * Holding the write lock keeps isc_log_doit() out, so no thread
+	 * is in the middle of adding to a ring while the writer thread
+	 * starts or stops.
+	 */
+	WRLOCK(&lctx->lcfg_rwl);
+	if (async && !atomic_load_relaxed(&lctx->async)) {
+		lctx->wshutdown = false;
+		isc_thread_create(log_writer, lctx, &lctx->writer);
+		isc_thread_setname(lctx->writer, "isc-log");
+		atomic_store_release(&lctx->async, true);
+	} else if (!async && atomic_load_relaxed(&lctx->async)) {
+		atomic_store_release(&lctx->async, false);
+		LOCK(&lctx->lock);
+		lctx->wshutdown = true;
+		SIGNAL(&lctx->wcond);
+		UNLOCK(&lctx->lock);
+		isc_thread_join(lctx->writer, NULL);
+	}
+	WRUNLOCK(&lctx->lcfg_rwl);
+}
+
+uint64_t
+isc_log_getdropped(isc_log_t *lctx) {
+	REQUIRE(VALID_CONTEXT(lctx));
+
+	return (atomic_load_relaxed(&lctx->dropped));
+}
+
 /****
 **** Internal functions
 ****/
@@ -1434,6 +1559,228 @@ isc_log_open(isc_logchannel_t *channel) {
 	return (result);
 }
 
+/*
+ * Prepare the stream of an ISC_LOG_TOFILE channel for writing, closing
+ * and reopening the file if it had reached its maximum size.  Returns
+ * false if the message should not be written.
+ */
+static bool
+log_openfile(isc_logchannel_t *channel) {
+	struct stat statbuf;
+	isc_result_t result;
+
+	if (FILE_MAXREACHED(channel)) {
+		/*
+		 * If the file can be rolled, OR
+		 * If the file no longer exists, OR
+		 * If the file is less than the maximum size,
+		 * (such as if it had been renamed and
+		 * a new one touched, or it was truncated
+		 * in place)
+		 * ... then close it to trigger reopening.
+		 */
+		if (FILE_VERSIONS(channel) != ISC_LOG_ROLLNEVER ||
+		    (stat(FILE_NAME(channel), &statbuf) != 0 &&
+		     errno == ENOENT) ||
+		    statbuf.st_size < FILE_MAXSIZE(channel))
+		{
+			(void)fclose(FILE_STREAM(channel));
+			FILE_STREAM(channel) = NULL;
+			FILE_MAXREACHED(channel) = false;
+		} else {
+			/*
+			 * Eh, skip it.
+			 */
+			return (false);
+		}
+	}
+
+	if (FILE_STREAM(channel) == NULL) {
+		result = isc_log_open(channel);
+		if (result != ISC_R_SUCCESS && result != ISC_R_MAXSIZE &&
+		    (channel->flags & ISC_LOG_OPENERR) == 0)
+		{
+			syslog(LOG_ERR, "isc_log_open '%s' failed: %s",
+			       FILE_NAME(channel), isc_result_totext(result));
+			channel->flags |= ISC_LOG_OPENERR;
+		}
+		if (result != ISC_R_SUCCESS) {
+			return (false);
+		}
+		channel->flags &= ~ISC_LOG_OPENERR;
+	}
+
+	return (true);
+}
+
+/*
+ * If the file now exceeds its maximum size threshold, note it so that
+ * it will not be logged to any more.
+ */
+static void
+log_checksize(isc_logchannel_t *channel) {
+	struct stat statbuf;
+
+	if (FILE_MAXSIZE(channel) > 0) {
+		INSIST(channel->type == ISC_LOG_TOFILE);
+
+		/* XXXDCL NT fstat/fileno */
+		/* XXXDCL complain if fstat fails? */
+		if (fstat(fileno(FILE_STREAM(channel)), &statbuf) >= 0 &&
+		    statbuf.st_size > FILE_MAXSIZE(channel))
+		{
+			FILE_MAXREACHED(channel) = true;
+		}
+	}
+}
+
+/*
+ * Add a formatted line for 'channel' to the ring of the current thread,
+ * or count it as dropped if the ring is full.
+ */
+static void
+log_async_put(isc_log_t *lctx, isc_logchannel_t *channel, const char *line,
+	      size_t length) {
+	uint32_t tid = isc_tid();
+	isc_logring_t *ring = NULL;
+	isc_logrecord_t *record = NULL;
+	size_t size, head, tail, offset, pad = 0;
+
+	INSIST(tid < LOG_ASYNC_THREADS);
+
+	ring = (isc_logring_t *)atomic_load_relaxed(&lctx->rings[tid]);
+	if (ring == NULL) {
+		ring = isc_mem_get(lctx->mctx, sizeof(*ring));
+		atomic_init(&ring->head, 0);
+		atomic_init(&ring->tail, 0);
+		atomic_store_release(&lctx->rings[tid], (uintptr_t)ring);
+	}
+
+	size = ISC_ALIGN(sizeof(*record) + length, LOG_ASYNC_ALIGN);
+	head = atomic_load_relaxed(&ring->head);
+	tail = atomic_load_acquire(&ring->tail);
+	offset = head % LOG_ASYNC_RINGSIZE;
+	if (LOG_ASYNC_RINGSIZE - offset < size) {
+		pad = LOG_ASYNC_RINGSIZE - offset;
+	}
+
+	if (head - tail + pad + size > LOG_ASYNC_RINGSIZE) {
+		atomic_fetch_add_relaxed(&lctx->dropped, 1);
+		return;
+	}
+
+	if (pad > 0) {
+		record = (isc_logrecord_t *)&ring->data[offset];
+		*record = (isc_logrecord_t){ .size = pad };
+		head += pad;
+		offset = 0;
+	}
+
+	record = (isc_logrecord_t *)&ring->data[offset];
+	*record = (isc_logrecord_t){
+		.channel = channel,
+		.size = size,
+		.length = length,
+	};
+	memmove(record + 1, line, length);
+	atomic_store_release(&ring->head, head + size);
+
+	if (head + size - tail > LOG_ASYNC_RINGSIZE / 2) {
+		SIGNAL(&lctx->wcond);
+	}
+}
+
+/*
+ * Write a batch of lines to 'channel' with a single writev().
+ */
+static void
+log_async_write(isc_logchannel_t *channel, struct iovec *iov, int iovcnt) {
+	if (channel->type == ISC_LOG_TOFILE && !log_openfile(channel)) {
+		return;
+	}
+
+	/*
+	 * Anything written synchronously to the same stream goes first.
+	 */
+	(void)fflush(FILE_STREAM(channel));
+	(void)writev(fileno(FILE_STREAM(channel)), iov, iovcnt);
+
+	log_checksize(channel);
+}
+
+/*
+ * Write out everything in the rings.  Called with the log context lock
+ * held, which makes the caller the only consumer of the rings.
+ */
+static void
+log_async_drain(isc_log_t *lctx) {
+	for (size_t i = 0; i < LOG_ASYNC_THREADS; i++) {
+		isc_logring_t *ring =
+			(isc_logring_t *)atomic_load_acquire(&lctx->rings[i]);
+		size_t head, tail;
+
+		if (ring == NULL) {
+			continue;
+		}
+
+		tail = atomic_load_relaxed(&ring->tail);
+		head = atomic_load_acquire(&ring->head);
+		while (tail != head) {
+			struct iovec iov[LOG_ASYNC_IOV];
+			isc_logchannel_t *channel = NULL;
+			int iovcnt = 0;
+
+			/*
+			 * Gather consecutive lines for the same channel.
+			 */
+			while (tail != head && iovcnt < LOG_ASYNC_IOV) {
+				isc_logrecord_t *record =
+					(isc_logrecord_t *)&ring->data
+						[tail % LOG_ASYNC_RINGSIZE];
+
+				if (record->channel != NULL) {
+					if (channel != NULL &&
+					    channel != record->channel) {
+						break;
+					}
+					channel = record->channel;
+					iov[iovcnt++] = (struct iovec){
+						.iov_base = record + 1,
+						.iov_len = record->length,
+					};
+				}
+				tail += record->size;
+			}
+
+			if (channel != NULL) {
+				log_async_write(channel, iov, iovcnt);
+			}
+			atomic_store_release(&ring->tail, tail);
+		}
+	}
+}
+
+static isc_threadresult_t
+log_writer(isc_threadarg_t arg) {
+	isc_log_t *lctx = (isc_log_t *)arg;
+	isc_interval_t interval;
+	isc_time_t when;
+
+	isc_interval_set(&interval, 0, LOG_ASYNC_INTERVAL * 1000000);
+
+	LOCK(&lctx->lock);
+	while (!lctx->wshutdown) {
+		log_async_drain(lctx);
+
+		(void)isc_time_nowplusinterval(&when, &interval);
+		(void)WAITUNTIL(&lctx->wcond, &lctx->lock, &when);
+	}
+	log_async_drain(lctx);
+	UNLOCK(&lctx->lock);
+
+	return ((isc_threadresult_t)0);
+}
+
 ISC_NO_SANITIZE_THREAD bool
 isc_log_wouldlog(isc_log_t *lctx, int level) {
 	/*
@@ -1477,14 +1824,15 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 	char iso8601z_string[64];
 	char iso8601l_string[64];
 	char level_string[24] = { 0 };
-	struct stat statbuf;
 	bool matched = false;
 	bool printtime, iso8601, utc, printtag, printcolon;
 	bool printcategory, printmodule, printlevel, buffered;
 	isc_logchannel_t *channel;
 	isc_logchannellist_t *category_channels;
 	int_fast32_t dlevel;
-	isc_result_t result;
+	bool async, locked;
+	char *buffer = NULL;
+	size_t bufsize;
 
 	REQUIRE(lctx == NULL || VALID_CONTEXT(lctx));
 	REQUIRE(category != NULL);
@@ -1513,9 +1861,27 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 	iso8601z_string[0] = '\0';
 
 	RDLOCK(&lctx->lcfg_rwl);
-	LOCK(&lctx->lock);
 
-	lctx->buffer[0] = '\0';
+	/*
+	 * When logging asynchronously, the message is formatted in a
+	 * buffer of this thread and the lock is only needed to check for
+	 * duplicates and to write to syslog.
+	 */
+	async = (isc_tid() < LOG_ASYNC_THREADS &&
+		 atomic_load_acquire(&lctx->async));
+	locked = (!async || write_once);
+	if (locked) {
+		LOCK(&lctx->lock);
+	}
+	if (async) {
+		buffer = log_buffer;
+		bufsize = sizeof(log_buffer);
+	} else {
+		buffer = lctx->buffer;
+		bufsize = sizeof(lctx->buffer);
+	}
+
+	buffer[0] = '\0';
 
 	isc_logconfig_t *lcfg = lctx->logconfig;
 
@@ -1614,9 +1980,8 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 		/*
 		 * Only format the message once.
 		 */
-		if (lctx->buffer[0] == '\0') {
-			(void)vsnprintf(lctx->buffer, sizeof(lctx->buffer),
-					format, args);
+		if (buffer[0] == '\0') {
+			(void)vsnprintf(buffer, bufsize, format, args);
 
 			/*
 			 * Check for duplicates.
@@ -1687,8 +2052,8 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 					 * duplicate filtering interval
 					 * ...
 					 */
-					if (strcmp(lctx->buffer,
-						   message->text) == 0) {
+					if (strcmp(buffer, message->text) ==
+					    0) {
 						/*
 						 * ... and it is a
 						 * duplicate. Unlock the
@@ -1706,11 +2071,11 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 				 * so add it to the message list.
 				 */
 				size = sizeof(isc_logmessage_t) +
-				       strlen(lctx->buffer) + 1;
+				       strlen(buffer) + 1;
 				message = isc_mem_get(lctx->mctx, size);
 				message->text = (char *)(message + 1);
 				size -= sizeof(isc_logmessage_t);
-				strlcpy(message->text, lctx->buffer, size);
+				strlcpy(message->text, buffer, size);
 				TIME_NOW(&message->time);
 				ISC_LINK_INIT(message, link);
 				ISC_LIST_APPEND(lctx->messages, message, link);
@@ -1744,53 +2109,38 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 			time_string = "";
 		}
 
-		switch (channel->type) {
-		case ISC_LOG_TOFILE:
-			if (FILE_MAXREACHED(channel)) {
-				/*
-				 * If the file can be rolled, OR
-				 * If the file no longer exists, OR
-				 * If the file is less than the maximum
-				 * size, (such as if it had been renamed
-				 * and a new one touched, or it was
-				 * truncated in place)
-				 * ... then close it to trigger
-				 * reopening.
-				 */
-				if (FILE_VERSIONS(channel) !=
-					    ISC_LOG_ROLLNEVER ||
-				    (stat(FILE_NAME(channel), &statbuf) != 0 &&
-				     errno == ENOENT) ||
-				    statbuf.st_size < FILE_MAXSIZE(channel))
-				{
-					(void)fclose(FILE_STREAM(channel));
-					FILE_STREAM(channel) = NULL;
-					FILE_MAXREACHED(channel) = false;
-				} else {
-					/*
-					 * Eh, skip it.
-					 */
-					break;
-				}
+		if (async && (channel->type == ISC_LOG_TOFILE ||
+			      channel->type == ISC_LOG_TOFILEDESC))
+		{
+			int length = snprintf(
+				log_line, sizeof(log_line),
+				"%s%s%s%s%s%s%s%s%s%s\n",
+				printtime ? time_string : "",
+				printtime ? " " : "", printtag ? lcfg->tag : "",
+				printcolon ? ": " : "",
+				printcategory ? category->name : "",
+				printcategory ? ": " : "",
+				printmodule ? (module != NULL ? module->name
+							      : "no_module")
+					    : "",
+				printmodule ? ": " : "",
+				printlevel ? level_string : "", buffer);
+			if (length < 0) {
+				continue;
 			}
+			if ((size_t)length >= sizeof(log_line)) {
+				/* Truncated; keep the newline */
+				length = sizeof(log_line) - 1;
+				log_line[length - 1] = '\n';
+			}
+			log_async_put(lctx, channel, log_line, length);
+			continue;
+		}
 
-			if (FILE_STREAM(channel) == NULL) {
-				result = isc_log_open(channel);
-				if (result != ISC_R_SUCCESS &&
-				    result != ISC_R_MAXSIZE &&
-				    (channel->flags & ISC_LOG_OPENERR) == 0)
-				{
-					syslog(LOG_ERR,
-					       "isc_log_open '%s' "
-					       "failed: %s",
-					       FILE_NAME(channel),
-					       isc_result_totext(result));
-					channel->flags |= ISC_LOG_OPENERR;
-				}
-				if (result != ISC_R_SUCCESS) {
-					break;
-				}
-				channel->flags &= ~ISC_LOG_OPENERR;
+		switch (channel->type) {
+		case ISC_LOG_TOFILE:
+			if (!log_openfile(channel)) {
+				break;
 			}
 			FALLTHROUGH;
 
@@ -1805,30 +2155,13 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 							      : "no_module")
 					    : "",
 				printmodule ? ": " : "",
-				printlevel ? level_string : "", lctx->buffer);
+				printlevel ? level_string : "", buffer);
 
 			if (!buffered) {
 				fflush(FILE_STREAM(channel));
 			}
 
-			/*
-			 * If the file now exceeds its maximum size
-			 * threshold, note it so that it will not be
-			 * logged to any more.
-			 */
-			if (FILE_MAXSIZE(channel) > 0) {
-				INSIST(channel->type == ISC_LOG_TOFILE);
-
-				/* XXXDCL NT fstat/fileno */
-				/* XXXDCL complain if fstat fails? */
-				if (fstat(fileno(FILE_STREAM(channel)),
-					  &statbuf) >= 0 &&
-				    statbuf.st_size > FILE_MAXSIZE(channel))
-				{
-					FILE_MAXREACHED(channel) = true;
-				}
-			}
-
+			log_checksize(channel);
 			break;
 
 		case ISC_LOG_TOSYSLOG:
@@ -1840,6 +2173,9 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 				syslog_level = syslog_map[-level];
 			}
 
+			if (!locked) {
+				LOCK(&lctx->lock);
+			}
 			(void)syslog(
 				FACILITY(channel) | syslog_level,
 				"%s%s%s%s%s%s%s%s%s%s",
@@ -1852,7 +2188,10 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 							      : "no_module")
 					    : "",
 				printmodule ? ": " : "",
-				printlevel ? level_string : "", lctx->buffer);
+				printlevel ? level_string : "", buffer);
+			if (!locked) {
+				UNLOCK(&lctx->lock);
+			}
 			break;
 
 		case ISC_LOG_TONULL:
@@ -1861,7 +2200,9 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 	} while (1);
 
 unlock:
-	UNLOCK(&lctx->lock);
+	if (locked) {
+		UNLOCK(&lctx->lock);
+	}
 	RDUNLOCK(&lctx->lcfg_rwl);
 }
 
@@ -12,6 +12,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -20,7 +21,9 @@
 #include <isc/barrier.h>
 #include <isc/condition.h>
 #include <isc/job.h>
+#include <isc/histo.h>
 #include <isc/list.h>
+#include <isc/log.h>
 #include <isc/loop.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
@@ -39,6 +42,18 @@
 #include "job_p.h"
 #include "loop_p.h"
 
+/*
+ * The time spent polling for I/O can only be told apart from the time
+ * spent in the I/O callbacks with libuv >= 1.39.0; without it, the busy
+ * time of an iteration starts after polling, and doesn't include the I/O
+ * callbacks.
+ */
+#if UV_VERSION_HEX >= UV_VERSION(1, 39, 0)
+#define LOOP_IDLE_TIME 1
+#endif
+
+#define LOOP_HISTO_SIGBITS 2
+
 /**
  * Private
  */
@@ -105,12 +120,148 @@ resume_loop(isc_loop_t *loop) {
 	loop->paused = false;
 }
 
+static uint64_t
+loop_idle_time(isc_loop_t *loop) {
+#if LOOP_IDLE_TIME
+	return (uv_metrics_idle_time(&loop->loop));
+#else
+	UNUSED(loop);
+	return (0);
+#endif
+}
+
+/*
+ * Start timing a new iteration of 'loop' now.
+ */
+static void
+health_restart(isc_loop_t *loop) {
+	isc_loophealth_t *health = &loop->health;
+
+	health->start = uv_hrtime();
+	health->idle = loop_idle_time(loop);
+	health->njobs = 0;
+	health->slowest = NULL;
+	health->slowtime = 0;
+}
+
+static void
+health_site(isc_loophealth_t *health, const char *name, uint64_t elapsed) {
+	uint32_t hash = 2166136261U;
+
+	for (const char *p = name; *p != '\0'; p++) {
+		hash = (hash ^ (unsigned char)*p) * 16777619U;
+	}
+
+	/* Only the loop thread adds to the table, readers just load */
+	for (size_t i = 0; i < LOOP_CALLBACKS; i++, hash++) {
+		isc_loopsite_t *site = &health->sites[hash % LOOP_CALLBACKS];
+		const char *sname =
+			(const char *)atomic_load_acquire(&site->name);
+
+		if (sname == NULL) {
+			atomic_store_release(&site->name, (uintptr_t)name);
+		} else if (strcmp(sname, name) != 0) {
+			continue;
+		}
+
+		atomic_fetch_add_relaxed(&site->count, 1);
+		atomic_fetch_add_relaxed(&site->time, elapsed);
+		if (elapsed > atomic_load_relaxed(&site->maxtime)) {
+			atomic_store_relaxed(&site->maxtime, elapsed);
+		}
+		return;
+	}
+}
+
+void
+isc__loop_callback_done(isc_loop_t *loop, const char *name, uint64_t start) {
+	isc_loophealth_t *health = &loop->health;
+	uint64_t elapsed;
+
+	if (name == NULL) {
+		name = "unknown";
+	}
+
+	/* Don't count the time the callback spent with the loops paused */
+	if (start < health->start) {
+		start = health->start;
+	}
+	elapsed = uv_hrtime() - start;
+
+	health->njobs++;
+	if (elapsed >= health->slowtime) {
+		health->slowest = name;
+		health->slowtime = elapsed;
+	}
+	if (elapsed >= LOOP_SLOW_CALLBACK) {
+		health_site(health, name, elapsed);
+	}
+}
+
+#if !LOOP_IDLE_TIME
+static void
+health_check_cb(uv_check_t *handle) {
+	isc_loop_t *loop = uv_handle_get_data(handle);
+
+	/* The iteration starts when polling for I/O is finished */
+	health_restart(loop);
+}
+#endif /* !LOOP_IDLE_TIME */
+
+static void
+health_prepare_cb(uv_prepare_t *handle) {
+	isc_loop_t *loop = uv_handle_get_data(handle);
+	isc_loophealth_t *health = &loop->health;
+	uint32_t threshold =
+		atomic_load_relaxed(&loop->loopmgr->stallthreshold);
+	uint64_t now = uv_hrtime();
+	uint64_t busy = now - health->start;
+	uint64_t idle = loop_idle_time(loop) - health->idle;
+
+	busy = (idle < busy) ? busy - idle : 0;
+
+	atomic_fetch_add_relaxed(&health->iterations, 1);
+	atomic_fetch_add_relaxed(&health->jobs, health->njobs);
+	if (health->njobs > atomic_load_relaxed(&health->maxjobs)) {
+		atomic_store_relaxed(&health->maxjobs, health->njobs);
+	}
+	if (busy > atomic_load_relaxed(&health->maxtime)) {
+		atomic_store_relaxed(&health->maxtime, busy);
+	}
+	isc_histo_inc(health->histo, busy / 1000);
+
+	if (threshold > 0 && busy >= (uint64_t)threshold * 1000000) {
+		atomic_fetch_add_relaxed(&health->stalls, 1);
+
+		/* Log at most one stall per second */
+		if (now - health->lastlog >= 1000000000) {
+			health->lastlog = now;
+			isc_log_write(isc_lctx, ISC_LOGCATEGORY_GENERAL,
+				      ISC_LOGMODULE_OTHER, ISC_LOG_WARNING,
+				      "loop %" PRIu32 " stalled for %" PRIu64
+				      " ms; slowest callback: %s (%" PRIu64
+				      " ms)",
+				      loop->tid, busy / 1000000,
+				      health->slowest != NULL
+					      ? health->slowest
+					      : "I/O callbacks",
+				      health->slowtime / 1000000);
+		}
+	}
+
+#if LOOP_IDLE_TIME
+	health_restart(loop);
+#endif
+}
+
 static void
 pauseresume_cb(uv_async_t *handle) {
 	isc_loop_t *loop = uv_handle_get_data(handle);
 
 	pause_loop(loop);
 	resume_loop(loop);
+
+	health_restart(loop);
 }
 
 #define XX(uc, lc)                                                         \
@@ -147,6 +298,9 @@ destroy_cb(uv_async_t *handle) {
 	uv_close(&loop->destroy_trigger, NULL);
 	uv_close(&loop->queue_trigger, NULL);
 	uv_close(&loop->pause_trigger, NULL);
+	uv_close(&loop->health.prepare, NULL);
+	uv_close(&loop->health.check, NULL);
+	isc__timerwheel_close(loop);
 
 	uv_walk(&loop->loop, loop_walk_cb, (char *)"destroy_cb");
 }
@@ -186,14 +340,30 @@ queue_cb(uv_async_t *handle) {
 	isc_loop_t *loop = uv_handle_get_data(handle);
 	isc_job_t *job = NULL;
 	ISC_LIST(isc_job_t) list;
+	uint_fast64_t count = 0;
 
 	REQUIRE(VALID_LOOP(loop));
 
 	ISC_LIST_INIT(list);
 
-	LOCK(&loop->queue_lock);
-	ISC_LIST_MOVE(list, loop->queue_jobs);
-	UNLOCK(&loop->queue_lock);
+	/*
+	 * Take all the queued jobs at once; the stack is newest first,
+	 * so reverse it to start the jobs in the order they were queued.
+	 */
+	job = (isc_job_t *)atomic_exchange_acq_rel(&loop->queue_jobs,
+						    (uintptr_t)NULL);
+	if (job == NULL) {
+		return;
+	}
+	while (job != NULL) {
+		isc_job_t *next = job->qnext;
+		ISC_LIST_PREPEND(list, job, link);
+		job = next;
+		count++;
+	}
+
+	atomic_fetch_add_relaxed(&loop->queue_wakeups, 1);
+	atomic_fetch_add_relaxed(&loop->queue_runs, count);
 
 	job = ISC_LIST_HEAD(list);
 	while (job != NULL) {
@@ -211,12 +381,18 @@ static void
 loop_init(isc_loop_t *loop, isc_loopmgr_t *loopmgr, size_t tid) {
 	*loop = (isc_loop_t){
 		.tid = tid,
+		.cpu = -1,
 		.loopmgr = loopmgr,
 	};
 
 	int r = uv_loop_init(&loop->loop);
 	UV_RUNTIME_CHECK(uv_loop_init, r);
 
+#if LOOP_IDLE_TIME
+	r = uv_loop_configure(&loop->loop, UV_METRICS_IDLE_TIME);
+	UV_RUNTIME_CHECK(uv_loop_configure, r);
+#endif
+
 	r = uv_async_init(&loop->loop, &loop->pause_trigger, pauseresume_cb);
 	UV_RUNTIME_CHECK(uv_async_init, r);
 	uv_handle_set_data(&loop->pause_trigger, loop);
@@ -233,11 +409,49 @@ loop_init(isc_loop_t *loop, isc_loopmgr_t *loopmgr, size_t tid) {
 	UV_RUNTIME_CHECK(uv_async_init, r);
 	uv_handle_set_data(&loop->destroy_trigger, loop);
 
+	isc__timerwheel_init(loop);
+
+	/*
+	 * The health handles must not keep the loop running by themselves.
+	 */
+	r = uv_prepare_init(&loop->loop, &loop->health.prepare);
+	UV_RUNTIME_CHECK(uv_prepare_init, r);
+	uv_handle_set_data(&loop->health.prepare, loop);
+	r = uv_prepare_start(&loop->health.prepare, health_prepare_cb);
+	UV_RUNTIME_CHECK(uv_prepare_start, r);
+	uv_unref((uv_handle_t *)&loop->health.prepare);
+
+	r = uv_check_init(&loop->loop, &loop->health.check);
+	UV_RUNTIME_CHECK(uv_check_init, r);
+	uv_handle_set_data(&loop->health.check, loop);
+#if !LOOP_IDLE_TIME
+	r = uv_check_start(&loop->health.check, health_check_cb);
+	UV_RUNTIME_CHECK(uv_check_start, r);
+#endif
+	uv_unref((uv_handle_t *)&loop->health.check);
+
 	isc_mem_create(&loop->mctx);
 
-	isc_mutex_init(&loop->queue_lock);
+	isc_histo_create(loopmgr->mctx, LOOP_HISTO_SIGBITS, 1,
+			 &loop->health.histo);
+	atomic_init(&loop->health.iterations, 0);
+	atomic_init(&loop->health.jobs, 0);
+	atomic_init(&loop->health.maxjobs, 0);
+	atomic_init(&loop->health.maxtime, 0);
+	atomic_init(&loop->health.stalls, 0);
+	for (size_t i = 0; i < LOOP_CALLBACKS; i++) {
+		isc_loopsite_t *site = &loop->health.sites[i];
+
+		atomic_init(&site->name, (uintptr_t)NULL);
+		atomic_init(&site->count, 0);
+		atomic_init(&site->time, 0);
+		atomic_init(&site->maxtime, 0);
+	}
+
+	atomic_init(&loop->queue_jobs, (uintptr_t)NULL);
+	atomic_init(&loop->queue_wakeups, 0);
+	atomic_init(&loop->queue_runs, 0);
 
-	ISC_LIST_INIT(loop->queue_jobs);
 	ISC_LIST_INIT(loop->setup_jobs);
 	ISC_LIST_INIT(loop->teardown_jobs);
 
@@ -263,6 +477,8 @@ loop_run(isc_loop_t *loop) {
 
 	isc_barrier_wait(&loop->loopmgr->starting);
 
+	health_restart(loop);
+
 	r = uv_run(&loop->loop, UV_RUN_DEFAULT);
 	UV_RUNTIME_CHECK(uv_run, r);
 
@@ -274,11 +490,11 @@ loop_close(isc_loop_t *loop) {
 	int r = uv_loop_close(&loop->loop);
 	UV_RUNTIME_CHECK(uv_loop_close, r);
 
-	isc_mutex_destroy(&loop->queue_lock);
-	INSIST(ISC_LIST_EMPTY(loop->queue_jobs));
+	INSIST(atomic_load_acquire(&loop->queue_jobs) == (uintptr_t)NULL);
 
 	loop->magic = 0;
 
+	isc_histo_detach(&loop->health.histo);
 	isc_mem_detach(&loop->mctx);
 }
 
@@ -290,6 +506,11 @@ loop_thread(isc_threadarg_t arg) {
 
 	isc__tid_init(loop->tid);
 
+	if (loop->cpu >= 0 &&
+	    isc_thread_setaffinity(loop->cpu) != ISC_R_SUCCESS) {
+		loop->cpu = -1;
+	}
+
 	loop_run(loop);
 
 	return ((isc_threadresult_t)0);
@@ -344,6 +565,8 @@ isc_loopmgr_create(isc_mem_t *mctx, uint32_t nloops, isc_loopmgr_t **loopmgrp) {
 
 	isc_mem_attach(mctx, &loopmgr->mctx);
 
+	atomic_init(&loopmgr->stallthreshold, 0);
+
 	isc_barrier_init(&loopmgr->pausing, loopmgr->nloops);
 	isc_barrier_init(&loopmgr->resuming, loopmgr->nloops);
 	isc_barrier_init(&loopmgr->starting, loopmgr->nloops);
@@ -382,7 +605,7 @@ isc_loop_setup(isc_loop_t *loop, isc_job_cb cb, void *cbarg) {
 	REQUIRE(loop->tid == isc_tid() || !atomic_load(&loopmgr->running) ||
 		atomic_load(&loopmgr->paused));
 
-	job = isc__job_new(loop, cb, cbarg);
+	job = isc__job_new(loop, cb, cbarg, NULL);
 	isc__job_init(loop, job);
 
 	/*
@@ -408,7 +631,7 @@ isc_loop_teardown(isc_loop_t *loop, isc_job_cb cb, void *cbarg) {
 	REQUIRE(loop->tid == isc_tid() || !atomic_load(&loopmgr->running) ||
 		atomic_load(&loopmgr->paused));
 
-	job = isc__job_new(loop, cb, cbarg);
+	job = isc__job_new(loop, cb, cbarg, NULL);
 	isc__job_init(loop, job);
 
 	/*
@@ -446,6 +669,11 @@ isc_loopmgr_teardown(isc_loopmgr_t *loopmgr, isc_job_cb cb, void *cbarg) {
 	}
 }
 
+static void
+warmup_cb(uv_work_t *req) {
+	UNUSED(req);
+}
+
 void
 isc_loopmgr_run(isc_loopmgr_t *loopmgr) {
 	REQUIRE(VALID_LOOPMGR(loopmgr));
@@ -457,6 +685,21 @@ isc_loopmgr_run(isc_loopmgr_t *loopmgr) {
 	 */
 	ignore_signal(SIGPIPE, SIG_IGN);
 
+	if (loopmgr->affinity) {
+		/*
+		 * The offload threads are started on first use by whichever
+		 * thread uses them first, and inherit its affinity; start
+		 * them now, while this thread can still run anywhere.
+		 */
+		int r = uv_queue_work(&loopmgr->loops[0].loop,
+				      &loopmgr->warmup, warmup_cb, NULL);
+		UV_RUNTIME_CHECK(uv_queue_work, r);
+
+		for (size_t i = 0; i < loopmgr->nloops; i++) {
+			loopmgr->loops[i].cpu = isc_thread_cpu(i);
+		}
+	}
+
 	/*
 	 * The thread 0 is this one.
 	 */
@@ -501,6 +744,8 @@ isc_loopmgr_resume(isc_loopmgr_t *loopmgr) {
 	RUNTIME_CHECK(atomic_compare_exchange_strong(&loopmgr->paused,
 						     &(bool){ true }, false));
 	resume_loop(CURRENT_LOOP(loopmgr));
+
+	health_restart(CURRENT_LOOP(loopmgr));
 }
 
 void
@@ -546,6 +791,88 @@ isc_loopmgr_nloops(isc_loopmgr_t *loopmgr) {
 	return (loopmgr->nloops);
 }
 
+void
+isc_loopmgr_setaffinity(isc_loopmgr_t *loopmgr, bool affinity) {
+	REQUIRE(VALID_LOOPMGR(loopmgr));
+	REQUIRE(!atomic_load(&loopmgr->running));
+
+	loopmgr->affinity = affinity;
+}
+
+void
+isc_loopmgr_setstallthreshold(isc_loopmgr_t *loopmgr, uint32_t threshold) {
+	REQUIRE(VALID_LOOPMGR(loopmgr));
+
+	atomic_store_relaxed(&loopmgr->stallthreshold, threshold);
+}
+
+void
+isc_loop_getstats(isc_loop_t *loop, isc_loopstats_t *stats) {
+	isc_loophealth_t *health = NULL;
+
+	REQUIRE(VALID_LOOP(loop));
+	REQUIRE(stats != NULL);
+
+	health = &loop->health;
+	*stats = (isc_loopstats_t){
+		.iterations = atomic_load_relaxed(&health->iterations),
+		.jobs = atomic_load_relaxed(&health->jobs),
+		.maxjobs = atomic_load_relaxed(&health->maxjobs),
+		.maxtime = atomic_load_relaxed(&health->maxtime) / 1000,
+		.stalls = atomic_load_relaxed(&health->stalls),
+	};
+}
+
+isc_histo_t *
+isc_loop_gethistogram(isc_loop_t *loop) {
+	REQUIRE(VALID_LOOP(loop));
+
+	return (loop->health.histo);
+}
+
+static int
+loopcallback_compare(const void *a, const void *b) {
+	const isc_loopcallback_t *ca = a, *cb = b;
+
+	if (ca->time != cb->time) {
+		return (ca->time < cb->time ? 1 : -1);
+	}
+	return (strcmp(ca->name, cb->name));
+}
+
+size_t
+isc_loop_getcallbacks(isc_loop_t *loop, isc_loopcallback_t *callbacks,
+		      size_t size) {
+	size_t count = 0;
+
+	REQUIRE(VALID_LOOP(loop));
+	REQUIRE(callbacks != NULL || size == 0);
+
+	for (size_t i = 0; i < LOOP_CALLBACKS && count < size; i++) {
+		isc_loopsite_t *site = &loop->health.sites[i];
+		const char *name =
+			(const char *)atomic_load_acquire(&site->name);
+
+		if (name == NULL) {
+			continue;
+		}
+
+		callbacks[count++] = (isc_loopcallback_t){
+			.name = name,
+			.count = atomic_load_relaxed(&site->count),
+			.time = atomic_load_relaxed(&site->time) / 1000,
+			.maxtime = atomic_load_relaxed(&site->maxtime) / 1000,
+		};
+	}
+
+	if (count > 1) {
+		qsort(callbacks, count, sizeof(callbacks[0]),
+		      loopcallback_compare);
+	}
+
+	return (count);
+}
+
 isc_mem_t *
 isc_loop_getmctx(isc_loop_t *loop) {
 	REQUIRE(VALID_LOOP(loop));
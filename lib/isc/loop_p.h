@@ -16,6 +16,7 @@
 #include <inttypes.h>
 
 #include <isc/barrier.h>
+#include <isc/histo.h>
 #include <isc/lang.h>
 #include <isc/loop.h>
 #include <isc/magic.h>
@@ -28,6 +29,30 @@
 #include <isc/uv.h>
 #include <isc/work.h>
 
+/*
+ * Hierarchical timing wheel multiplexing all the isc_timer_t timers of a
+ * loop onto a single uv_timer_t.  Level 0 has a slot for each millisecond
+ * of the next TIMERWHEEL_SLOTS milliseconds, and each following level
+ * has a slot per full rotation of the level below it; the timers in a
+ * higher level slot are moved to the lower levels when the wheel reaches
+ * the start of the slot.
+ */
+#define TIMERWHEEL_BITS	  6
+#define TIMERWHEEL_SLOTS  (1 << TIMERWHEEL_BITS)
+#define TIMERWHEEL_MASK	  (TIMERWHEEL_SLOTS - 1)
+#define TIMERWHEEL_LEVELS 4
+
+typedef ISC_LIST(isc_timer_t) isc_timerlist_t;
+
+typedef struct isc_timerwheel {
+	uv_timer_t timer;
+	uint64_t now;	   /*%< last tick processed, in loop time (ms) */
+	uint64_t deadline; /*%< when 'timer' fires, or UINT64_MAX */
+	size_t count;
+	uint64_t occupied[TIMERWHEEL_LEVELS]; /*%< bitmap of nonempty slots */
+	isc_timerlist_t slots[TIMERWHEEL_LEVELS][TIMERWHEEL_SLOTS];
+} isc_timerwheel_t;
+
 /*
  * Per-thread loop
  */
@@ -36,6 +61,43 @@
 
 typedef ISC_LIST(isc_job_t) isc_joblist_t;
 
+/*
+ * Loop health: the callbacks which run for at least LOOP_SLOW_CALLBACK
+ * nanoseconds are counted in a small open addressed table, keyed by the
+ * name of the callback function.  The table is only written by the loop
+ * thread, and read by anyone.
+ */
+#define LOOP_SLOW_CALLBACK (1000 * 1000)
+#define LOOP_CALLBACKS	   ISC_LOOP_CALLBACKS
+
+typedef struct isc_loopsite {
+	atomic_uintptr_t name; /*%< const char *, or NULL when unused */
+	atomic_uint_fast64_t count;
+	atomic_uint_fast64_t time;
+	atomic_uint_fast64_t maxtime;
+} isc_loopsite_t;
+
+typedef struct isc_loophealth {
+	uv_prepare_t prepare;
+	uv_check_t check;
+
+	/* Owned by the loop */
+	uint64_t start;	     /*%< start of this iteration, in ns */
+	uint64_t idle;	     /*%< time spent polling before 'start' */
+	uint64_t njobs;	     /*%< callbacks run in this iteration */
+	const char *slowest; /*%< slowest callback of this iteration */
+	uint64_t slowtime;
+	uint64_t lastlog; /*%< when a stall was last logged */
+
+	atomic_uint_fast64_t iterations;
+	atomic_uint_fast64_t jobs;
+	atomic_uint_fast64_t maxjobs;
+	atomic_uint_fast64_t maxtime;
+	atomic_uint_fast64_t stalls;
+	isc_histo_t *histo; /*%< busy time per iteration, in us */
+	isc_loopsite_t sites[LOOP_CALLBACKS];
+} isc_loophealth_t;
+
 struct isc_loop {
 	int magic;
 	isc_refcount_t references;
@@ -45,6 +107,7 @@ struct isc_loop {
 
 	uv_loop_t loop;
 	uint32_t tid;
+	int cpu; /*%< the CPU the loop is pinned to, or -1 */
 
 	isc_mem_t *mctx;
 
@@ -55,8 +118,9 @@ struct isc_loop {
 
 	/* Async queue */
 	uv_async_t queue_trigger;
-	isc_mutex_t queue_lock;
-	isc_joblist_t queue_jobs;
+	atomic_uintptr_t queue_jobs; /*%< lock-free stack, newest job first */
+	atomic_uint_fast64_t queue_wakeups;
+	atomic_uint_fast64_t queue_runs;
 
 	/* Pause */
 	uv_async_t pause_trigger;
@@ -68,6 +132,12 @@ struct isc_loop {
 
 	/* Destroy */
 	uv_async_t destroy_trigger;
+
+	/* Timers */
+	isc_timerwheel_t wheel;
+
+	/* Health */
+	isc_loophealth_t health;
 };
 
 /*
@@ -86,6 +156,13 @@ struct isc_loopmgr {
 	atomic_bool running;
 	atomic_bool paused;
 
+	/* CPU affinity */
+	bool affinity;
+
+	/* iterations longer than this are logged, in ms; 0 disables */
+	atomic_uint_fast32_t stallthreshold;
+	uv_work_t warmup;
+
 	/* signal handling */
 	isc_signal_t *sigint;
 	isc_signal_t *sigterm;
@@ -127,7 +204,9 @@ struct isc_job {
 	isc_loop_t *loop;
 	isc_job_cb cb;
 	void *cbarg;
+	const char *name; /*%< the name of 'cb', for the loop health */
 	LINK(isc_job_t) link;
+	isc_job_t *qnext; /*%< next job in the loop's async queue */
 };
 
 /*
@@ -147,3 +226,23 @@ struct isc_work {
 #define ON_LOOP(loop)	      ((loop) == CURRENT_LOOP((loop)->loopmgr))
 
 ISC_REFCOUNT_DECL(isc_loop);
+
+void
+isc__timerwheel_init(isc_loop_t *loop);
+/*%<
+ * Initialize the timing wheel of 'loop'; implemented in timer.c.
+ */
+
+void
+isc__timerwheel_close(isc_loop_t *loop);
+/*%<
+ * Close the uv_timer_t of the timing wheel of 'loop', which must not
+ * have any timers running.
+ */
+
+void
+isc__loop_callback_done(isc_loop_t *loop, const char *name, uint64_t start);
+/*%<
+ * Account the callback 'name', which was started at 'start' (as returned
+ * by uv_hrtime()), to the health statistics of 'loop'.
+ */
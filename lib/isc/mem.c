@@ -20,6 +20,7 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
 
 #include <isc/align.h>
 #include <isc/bind9.h>
@@ -33,6 +34,7 @@
 #include <isc/refcount.h>
 #include <isc/strerr.h>
 #include <isc/string.h>
+#include <isc/tid.h>
 #include <isc/types.h>
 #include <isc/util.h>
 
@@ -60,6 +62,11 @@
 
 #include "mem_p.h"
 
+#if defined(HAVE_JEMALLOC) && JEMALLOC_VERSION_MAJOR >= 5 && \
+	defined(MADV_HUGEPAGE)
+#define HAVE_HUGEPAGE_ARENAS 1
+#endif
+
 #define MCTXLOCK(m)   LOCK(&m->lock)
 #define MCTXUNLOCK(m) UNLOCK(&m->lock)
 
@@ -79,6 +86,8 @@ unsigned int isc_mem_defaultflags = ISC_MEMFLAG_DEFAULT;
 #define DEBUG_TABLE_COUNT    512U
 #define STATS_BUCKETS	     512U
 #define STATS_BUCKET_SIZE    32U
+#define STATS_THREADS	     64U
+#define STATS_CREDIT	     16384U
 
 /*
  * Types.
@@ -112,6 +121,18 @@ struct stats {
 	atomic_size_t totalgets;
 };
 
+/*%
+ * Loop threads don't update the shared 'inuse' and 'malloced' counters on
+ * every allocation.  Each of them charges the context for STATS_CREDIT
+ * bytes in advance and draws on that credit, returning it once more than
+ * twice that much has been freed, so the shared counters never fall
+ * below the real usage.  Only the owning thread writes its entry.
+ */
+struct threadstats {
+	alignas(ISC_OS_CACHELINE_SIZE) atomic_size_t credit;
+	atomic_size_t total;
+};
+
 #define MEM_MAGIC	 ISC_MAGIC('M', 'e', 'm', 'C')
 #define VALID_CONTEXT(c) ISC_MAGIC_VALID(c, MEM_MAGIC)
 
@@ -135,6 +156,7 @@ struct isc_mem {
 	isc_mutex_t lock;
 	bool checkfree;
 	struct stats stats[STATS_BUCKETS + 1];
+	struct threadstats threadstats[STATS_THREADS];
 	isc_refcount_t references;
 	char name[16];
 	atomic_size_t total;
@@ -150,6 +172,8 @@ struct isc_mem {
 	atomic_size_t lo_water;
 	ISC_LIST(isc_mempool_t) pools;
 	unsigned int poolcnt;
+	int jemalloc_flags;
+	unsigned int jemalloc_arena;
 
 #if ISC_MEM_TRACKLINES
 	debuglist_t *debuglist;
@@ -332,6 +356,19 @@ unlock:
 
 #define MEM_ALIGN(a) ((a) ? MALLOCX_ALIGN(a) : 0)
 
+/*
+ * Hooks for the sampling heap profiler (memprof.c).
+ */
+#define MEMPROF_ALLOC(ptr, size)                                \
+	if (atomic_load_relaxed(&isc__memprof_rate) != 0) {     \
+		isc__memprof_alloc(ptr, size);                  \
+	}
+
+#define MEMPROF_FREE(ptr)                                   \
+	if (atomic_load_acquire(&isc__memprof_live)) {      \
+		isc__memprof_free(ptr);                     \
+	}
+
 /*!
  * Perform a malloc, doing memory filling and overrun detection as necessary.
  */
@@ -341,9 +378,11 @@ mem_get(isc_mem_t *ctx, size_t size, int flags) {
 
 	ADJUST_ZERO_ALLOCATION_SIZE(size);
 
-	ret = mallocx(size, flags);
+	ret = mallocx(size, flags | ctx->jemalloc_flags);
 	INSIST(ret != NULL);
 
+	MEMPROF_ALLOC(ret, size);
+
 	if ((ctx->flags & ISC_MEMFLAG_FILL) != 0) {
 		memset(ret, 0xbe, size); /* Mnemonic for "beef". */
 	}
@@ -362,7 +401,10 @@ mem_put(isc_mem_t *ctx, void *mem, size_t size, int flags) {
 	if ((ctx->flags & ISC_MEMFLAG_FILL) != 0) {
 		memset(mem, 0xde, size); /* Mnemonic for "dead". */
 	}
-	sdallocx(mem, size, flags);
+
+	MEMPROF_FREE(mem);
+
+	sdallocx(mem, size, flags | ctx->jemalloc_flags);
 }
 
 static void *
@@ -372,9 +414,13 @@ mem_realloc(isc_mem_t *ctx, void *old_ptr, size_t old_size, size_t new_size,
 
 	ADJUST_ZERO_ALLOCATION_SIZE(new_size);
 
-	new_ptr = rallocx(old_ptr, new_size, flags);
+	MEMPROF_FREE(old_ptr);
+
+	new_ptr = rallocx(old_ptr, new_size, flags | ctx->jemalloc_flags);
 	INSIST(new_ptr != NULL);
 
+	MEMPROF_ALLOC(new_ptr, new_size);
+
 	if ((ctx->flags & ISC_MEMFLAG_FILL) != 0) {
 		ssize_t diff_size = new_size - old_size;
 		void *diff_ptr = (uint8_t *)new_ptr + old_size;
@@ -392,20 +438,80 @@ mem_realloc(isc_mem_t *ctx, void *old_ptr, size_t old_size, size_t new_size,
 		 ? &ctx->stats[STATS_BUCKETS]        \
 		 : &ctx->stats[size / STATS_BUCKET_SIZE])
 
+static struct threadstats *
+threadstats(isc_mem_t *ctx) {
+	uint32_t tid = isc_tid();
+
+	if (tid >= STATS_THREADS) {
+		return (NULL);
+	}
+
+	return (&ctx->threadstats[tid]);
+}
+
+/*!
+ * Charge 'size' bytes to the context.
+ */
+static void
+mem_charge(isc_mem_t *ctx, size_t size) {
+	atomic_fetch_add_release(&ctx->inuse, size);
+	increment_malloced(ctx, size);
+}
+
+/*!
+ * Refund 'size' bytes to the context.
+ */
+static void
+mem_refund(isc_mem_t *ctx, size_t size) {
+	atomic_size_t s;
+
+	s = atomic_fetch_sub_release(&ctx->inuse, size);
+	INSIST(s >= size);
+
+	decrement_malloced(ctx, size);
+}
+
+/*!
+ * Sum of the credit held by the loop threads.
+ */
+static size_t
+mem_credit(isc_mem_t *ctx) {
+	size_t credit = 0;
+
+	for (size_t i = 0; i < STATS_THREADS; i++) {
+		credit += atomic_load_relaxed(&ctx->threadstats[i].credit);
+	}
+
+	return (credit);
+}
+
 /*!
  * Update internal counters after a memory get.
  */
 static void
 mem_getstats(isc_mem_t *ctx, size_t size) {
 	struct stats *stats = stats_bucket(ctx, size);
-
-	atomic_fetch_add_relaxed(&ctx->total, size);
-	atomic_fetch_add_release(&ctx->inuse, size);
+	struct threadstats *ts = threadstats(ctx);
+
+	if (ts != NULL) {
+		size_t credit = atomic_load_relaxed(&ts->credit);
+
+		atomic_store_relaxed(&ts->total,
+				     atomic_load_relaxed(&ts->total) + size);
+		if (credit < size) {
+			mem_charge(ctx, size - credit + STATS_CREDIT);
+			credit = STATS_CREDIT;
+		} else {
+			credit -= size;
+		}
+		atomic_store_relaxed(&ts->credit, credit);
+	} else {
+		atomic_fetch_add_relaxed(&ctx->total, size);
+		mem_charge(ctx, size);
+	}
 
 	atomic_fetch_add_relaxed(&stats->gets, 1);
 	atomic_fetch_add_relaxed(&stats->totalgets, 1);
-
-	increment_malloced(ctx, size);
 }
 
 /*!
@@ -414,17 +520,25 @@ mem_getstats(isc_mem_t *ctx, size_t size) {
 static void
 mem_putstats(isc_mem_t *ctx, void *ptr, size_t size) {
 	struct stats *stats = stats_bucket(ctx, size);
-	atomic_size_t s, g;
+	struct threadstats *ts = threadstats(ctx);
+	atomic_size_t g;
 
 	UNUSED(ptr);
 
-	s = atomic_fetch_sub_release(&ctx->inuse, size);
-	INSIST(s >= size);
+	if (ts != NULL) {
+		size_t credit = atomic_load_relaxed(&ts->credit) + size;
+
+		if (credit > 2 * STATS_CREDIT) {
+			mem_refund(ctx, credit - STATS_CREDIT);
+			credit = STATS_CREDIT;
+		}
+		atomic_store_relaxed(&ts->credit, credit);
+	} else {
+		mem_refund(ctx, size);
+	}
 
 	g = atomic_fetch_sub_release(&stats->gets, 1);
 	INSIST(g >= 1);
-
-	decrement_malloced(ctx, size);
 }
 
 /*
@@ -455,6 +569,92 @@ isc__mem_shutdown(void) {
 	RUNTIME_CHECK(isc_once_do(&shut_once, mem_shutdown) == ISC_R_SUCCESS);
 }
 
+#if HAVE_HUGEPAGE_ARENAS
+/*
+ * Arenas for contexts created with isc_mem_create_arena() when huge
+ * pages are enabled: the memory jemalloc maps for them is advised to be
+ * backed by transparent huge pages, so that large, randomly accessed
+ * data such as a cache causes fewer TLB misses.  If the kernel doesn't
+ * support it, the advice is ignored and the arena is an ordinary one.
+ */
+static extent_hooks_t *default_hooks = NULL;
+static extent_hooks_t hugepage_hooks;
+static isc_once_t hugepage_once = ISC_ONCE_INIT;
+
+static void *
+hugepage_alloc(extent_hooks_t *hooks, void *new_addr, size_t size,
+	       size_t alignment, bool *zero, bool *commit,
+	       unsigned int arena_ind) {
+	void *ret = NULL;
+
+	UNUSED(hooks);
+
+	ret = default_hooks->alloc(default_hooks, new_addr, size, alignment,
+				   zero, commit, arena_ind);
+	if (ret != NULL) {
+		(void)madvise(ret, size, MADV_HUGEPAGE);
+	}
+	return (ret);
+}
+
+static void
+hugepage_initialize(void) {
+	size_t len = sizeof(default_hooks);
+
+	if (mallctl("arena.0.extent_hooks", &default_hooks, &len, NULL, 0) !=
+	    0)
+	{
+		default_hooks = NULL;
+		return;
+	}
+	hugepage_hooks = *default_hooks;
+	hugepage_hooks.alloc = hugepage_alloc;
+}
+
+static void
+mem_hugepage_arena(isc_mem_t *ctx) {
+	extent_hooks_t *hooks = &hugepage_hooks;
+	unsigned int arena;
+	size_t len = sizeof(arena);
+
+	RUNTIME_CHECK(isc_once_do(&hugepage_once, hugepage_initialize) ==
+		      ISC_R_SUCCESS);
+	if (default_hooks == NULL ||
+	    mallctl("arenas.create", &arena, &len, &hooks, sizeof(hooks)) != 0)
+	{
+		return;
+	}
+
+	/*
+	 * The thread caches are bound to the automatic arenas, so they
+	 * are bypassed for this one.
+	 */
+	ctx->jemalloc_arena = arena;
+	ctx->jemalloc_flags = MALLOCX_ARENA(arena) | MALLOCX_TCACHE_NONE;
+}
+
+static void
+mem_hugepage_destroy(isc_mem_t *ctx) {
+	char name[64];
+
+	if (ctx->jemalloc_flags == 0) {
+		return;
+	}
+	snprintf(name, sizeof(name), "arena.%u.destroy", ctx->jemalloc_arena);
+	(void)mallctl(name, NULL, NULL, NULL, 0);
+}
+#else /* HAVE_HUGEPAGE_ARENAS */
+static void
+mem_hugepage_arena(isc_mem_t *ctx) {
+	UNUSED(ctx);
+}
+
+static void
+mem_hugepage_destroy(isc_mem_t *ctx) {
+	UNUSED(ctx);
+}
+#endif /* HAVE_HUGEPAGE_ARENAS */
+
 static void
 mem_create(isc_mem_t **ctxp, unsigned int flags) {
 	isc_mem_t *ctx = NULL;
@@ -487,6 +687,10 @@ mem_create(isc_mem_t **ctxp, unsigned int flags) {
 		atomic_init(&ctx->stats[i].gets, 0);
 		atomic_init(&ctx->stats[i].totalgets, 0);
 	}
+	for (size_t i = 0; i < STATS_THREADS; i++) {
+		atomic_init(&ctx->threadstats[i].credit, 0);
+		atomic_init(&ctx->threadstats[i].total, 0);
+	}
 	ISC_LIST_INIT(ctx->pools);
 
 #if ISC_MEM_TRACKLINES
@@ -530,6 +734,9 @@ destroy(isc_mem_t *ctx) {
 
 	INSIST(ISC_LIST_EMPTY(ctx->pools));
 
+	/* Return the unused credit, nobody else can use the context now */
+	mem_refund(ctx, mem_credit(ctx));
+
 #if ISC_MEM_TRACKLINES
 	if (ctx->debuglist != NULL) {
 		debuglink_t *dl;
@@ -575,6 +782,14 @@ destroy(isc_mem_t *ctx) {
 
 	isc_mutex_destroy(&ctx->lock);
 
+	/*
+	 * The arena can only be destroyed when everything in it has been
+	 * freed, which has just been checked.
+	 */
+	if (ctx->checkfree) {
+		mem_hugepage_destroy(ctx);
+	}
+
 	malloced = decrement_malloced(ctx, sizeof(*ctx));
 
 	if (ctx->checkfree) {
@@ -1043,11 +1258,36 @@ isc_mem_setdestroycheck(isc_mem_t *ctx, bool flag) {
 	MCTXUNLOCK(ctx);
 }
 
+/*
+ * The credit and the shared counters are not read together, so the
+ * difference may briefly be off while another thread is taking or
+ * returning credit.
+ */
+static size_t
+uncharged(size_t charged, size_t credit) {
+	return (charged > credit ? charged - credit : 0);
+}
+
 size_t
 isc_mem_inuse(isc_mem_t *ctx) {
 	REQUIRE(VALID_CONTEXT(ctx));
 
-	return (atomic_load_acquire(&ctx->inuse));
+	return (uncharged(atomic_load_acquire(&ctx->inuse), mem_credit(ctx)));
+}
+
+size_t
+isc_mem_totalinuse(void) {
+	size_t inuse = 0;
+
+	LOCK(&contextslock);
+	for (isc_mem_t *ctx = ISC_LIST_HEAD(contexts); ctx != NULL;
+	     ctx = ISC_LIST_NEXT(ctx, link))
+	{
+		inuse += isc_mem_inuse(ctx);
+	}
+	UNLOCK(&contextslock);
+
+	return (inuse);
 }
 
 size_t
@@ -1059,16 +1299,24 @@ isc_mem_maxinuse(isc_mem_t *ctx) {
 
 size_t
 isc_mem_total(isc_mem_t *ctx) {
+	size_t total;
+
 	REQUIRE(VALID_CONTEXT(ctx));
 
-	return (atomic_load_acquire(&ctx->total));
+	total = atomic_load_acquire(&ctx->total);
+	for (size_t i = 0; i < STATS_THREADS; i++) {
+		total += atomic_load_relaxed(&ctx->threadstats[i].total);
+	}
+
+	return (total);
 }
 
 size_t
 isc_mem_malloced(isc_mem_t *ctx) {
 	REQUIRE(VALID_CONTEXT(ctx));
 
-	return (atomic_load_acquire(&ctx->malloced));
+	return (uncharged(atomic_load_acquire(&ctx->malloced),
+			  mem_credit(ctx)));
 }
 
 size_t
@@ -1747,7 +1995,21 @@ error:
 
 void
 isc__mem_create(isc_mem_t **mctxp FLARG) {
+	mem_create(mctxp, isc_mem_defaultflags & ~ISC_MEMFLAG_HUGEPAGES);
+#if ISC_MEM_TRACKLINES
+	if ((isc_mem_debugging & ISC_MEM_DEBUGTRACE) != 0) {
+		fprintf(stderr, "create mctx %p file %s line %u\n", *mctxp,
+			file, line);
+	}
+#endif /* ISC_MEM_TRACKLINES */
+}
+
+void
+isc__mem_create_arena(isc_mem_t **mctxp FLARG) {
 	mem_create(mctxp, isc_mem_defaultflags);
+	if (((*mctxp)->flags & ISC_MEMFLAG_HUGEPAGES) != 0) {
+		mem_hugepage_arena(*mctxp);
+	}
 #if ISC_MEM_TRACKLINES
 	if ((isc_mem_debugging & ISC_MEM_DEBUGTRACE) != 0) {
 		fprintf(stderr, "create mctx %p file %s line %u\n", *mctxp,
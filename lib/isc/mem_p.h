@@ -15,6 +15,7 @@
 
 #include <stdio.h>
 
+#include <isc/atomic.h>
 #include <isc/mem.h>
 
 /*! \file */
@@ -34,3 +35,23 @@ isc__mem_initialize(void);
 
 void
 isc__mem_shutdown(void);
+
+extern atomic_size_t isc__memprof_rate;
+extern atomic_bool   isc__memprof_live;
+
+void
+isc__memprof_alloc(void *ptr, size_t size);
+/*%<
+ * Count 'size' bytes allocated at 'ptr' towards the next sample of the
+ * heap profiler; only called while isc__memprof_rate is not zero.
+ */
+
+void
+isc__memprof_free(const void *ptr);
+/*%<
+ * Forget the allocation at 'ptr' if it was sampled; only called while
+ * isc__memprof_live is true.
+ */
+
+void
+isc__memprof_shutdown(void);
@@ -0,0 +1,443 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <isc/atomic.h>
+#include <isc/backtrace.h>
+#include <isc/memprof.h>
+#include <isc/random.h>
+#include <isc/result.h>
+#include <isc/thread.h>
+#include <isc/util.h>
+
+#include "mem_p.h"
+
+/*
+ * Frames recorded for each sampled allocation; the innermost frames are
+ * the allocator itself.
+ */
+#define MEMPROF_FRAMES 32
+
+/*
+ * Freeing memory looks the address up in a filter of counters before
+ * taking the lock, so the filter must be much larger than the number of
+ * live samples (one per 512kB of memory in use, by default).  A counter
+ * that reaches UINT8_MAX is never decremented again.
+ */
+#define MEMPROF_FILTER_BITS  20
+#define MEMPROF_SAMPLES_BITS 16
+#define MEMPROF_STACKS_BITS  12
+
+typedef struct memprof_stack memprof_stack_t;
+struct memprof_stack {
+	memprof_stack_t *next;
+	uint32_t hash;
+	uint64_t inuse_objs;
+	uint64_t inuse_bytes;
+	uint64_t alloc_objs;
+	uint64_t alloc_bytes;
+	int nframes;
+	void *frames[MEMPROF_FRAMES];
+};
+
+typedef struct memprof_sample memprof_sample_t;
+struct memprof_sample {
+	memprof_sample_t *next;
+	const void *ptr;
+	size_t size;
+	memprof_stack_t *stack;
+};
+
+atomic_size_t isc__memprof_rate = 0;
+atomic_bool isc__memprof_live = false;
+
+/*
+ * The samples and the call stacks are allocated with malloc(), so that
+ * the profiler doesn't sample itself, and are protected by 'lock'; as
+ * with the lock profiler, this is a plain pthread mutex.
+ */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static atomic_uint_least8_t filter[1 << MEMPROF_FILTER_BITS];
+static memprof_sample_t *samples[1 << MEMPROF_SAMPLES_BITS];
+static memprof_stack_t *stacks[1 << MEMPROF_STACKS_BITS];
+static size_t samplerate = ISC_MEMPROF_RATE;
+static uint64_t nsamples;
+static uint64_t nbytes;
+static uint64_t nallocs;
+
+/*
+ * Bytes left to allocate before the next sample on this thread.
+ */
+static thread_local int64_t countdown = 0;
+
+static uint64_t
+ptr_hash(const void *ptr) {
+	return (((uintptr_t)ptr >> 4) * 0x9E3779B97F4A7C15ULL);
+}
+
+#define FILTER_SLOT(h)	((h) >> (64 - MEMPROF_FILTER_BITS))
+#define SAMPLES_SLOT(h) ((h) >> (64 - MEMPROF_SAMPLES_BITS))
+
+static uint32_t
+stack_hash(void *const *frames, int nframes) {
+	uint32_t hash = 2166136261U;
+
+	for (int i = 0; i < nframes; i++) {
+		uintptr_t addr = (uintptr_t)frames[i];
+
+		for (size_t j = 0; j < sizeof(addr); j++) {
+			hash = (hash ^ (addr & 0xff)) * 16777619U;
+			addr >>= 8;
+		}
+	}
+
+	return (hash);
+}
+
+/*
+ * Exponentially distributed intervals with a mean of 'rate' bytes, so
+ * that the sampled allocations form the Poisson process pprof assumes
+ * when scaling the samples back up.  -ln(u) is computed from the binary
+ * logarithm of 'u', with the mantissa interpolated linearly, which is
+ * close enough for sampling and doesn't need libm.
+ */
+static int64_t
+next_interval(size_t rate) {
+	uint32_t r = isc_random32() | 1;
+	int msb = 31 - __builtin_clz(r);
+	double mantissa = (double)r / (double)((uint64_t)1 << msb) - 1.0;
+	double log2u = (double)msb + mantissa - 32.0;
+
+	return ((int64_t)(-log2u * 0.6931471805599453 * (double)rate) + 1);
+}
+
+static memprof_stack_t *
+stack_get(void *const *frames, int nframes) {
+	uint32_t hash = stack_hash(frames, nframes);
+	memprof_stack_t **bucket = &stacks[hash >> (32 - MEMPROF_STACKS_BITS)];
+	memprof_stack_t *stack = NULL;
+	size_t size = nframes * sizeof(frames[0]);
+
+	for (stack = *bucket; stack != NULL; stack = stack->next) {
+		if (stack->hash == hash && stack->nframes == nframes &&
+		    memcmp(stack->frames, frames, size) == 0)
+		{
+			return (stack);
+		}
+	}
+
+	stack = malloc(sizeof(*stack));
+	if (stack == NULL) {
+		return (NULL);
+	}
+	*stack = (memprof_stack_t){
+		.next = *bucket,
+		.hash = hash,
+		.nframes = nframes,
+	};
+	memmove(stack->frames, frames, size);
+	*bucket = stack;
+
+	return (stack);
+}
+
+void
+isc__memprof_alloc(void *ptr, size_t size) {
+	size_t rate = atomic_load_relaxed(&isc__memprof_rate);
+	void *frames[MEMPROF_FRAMES + 1];
+	memprof_sample_t *sample = NULL;
+	memprof_stack_t *stack = NULL;
+	uint64_t hash;
+	int nframes;
+
+	countdown -= size;
+	if (countdown > 0 || rate == 0) {
+		return;
+	}
+	countdown = next_interval(rate);
+
+	/* Leave this function out of the stack */
+	nframes = isc_backtrace(frames, ARRAY_SIZE(frames));
+	if (nframes < 2) {
+		return;
+	}
+
+	sample = malloc(sizeof(*sample));
+	if (sample == NULL) {
+		return;
+	}
+
+	hash = ptr_hash(ptr);
+
+	RUNTIME_CHECK(pthread_mutex_lock(&lock) == 0);
+	stack = stack_get(frames + 1, nframes - 1);
+	if (stack == NULL) {
+		RUNTIME_CHECK(pthread_mutex_unlock(&lock) == 0);
+		free(sample);
+		return;
+	}
+
+	*sample = (memprof_sample_t){
+		.next = samples[SAMPLES_SLOT(hash)],
+		.ptr = ptr,
+		.size = size,
+		.stack = stack,
+	};
+	samples[SAMPLES_SLOT(hash)] = sample;
+
+	stack->inuse_objs++;
+	stack->inuse_bytes += size;
+	stack->alloc_objs++;
+	stack->alloc_bytes += size;
+	nsamples++;
+	nbytes += size;
+	nallocs++;
+
+	if (atomic_load_relaxed(&filter[FILTER_SLOT(hash)]) < UINT8_MAX) {
+		atomic_fetch_add_relaxed(&filter[FILTER_SLOT(hash)], 1);
+	}
+	atomic_store_release(&isc__memprof_live, true);
+	RUNTIME_CHECK(pthread_mutex_unlock(&lock) == 0);
+}
+
+void
+isc__memprof_free(const void *ptr) {
+	uint64_t hash = ptr_hash(ptr);
+	memprof_sample_t **samplep = NULL;
+	memprof_sample_t *sample = NULL;
+	uint_least8_t count;
+
+	count = atomic_load_relaxed(&filter[FILTER_SLOT(hash)]);
+	if (count == 0) {
+		return;
+	}
+
+	RUNTIME_CHECK(pthread_mutex_lock(&lock) == 0);
+	for (samplep = &samples[SAMPLES_SLOT(hash)]; *samplep != NULL;
+	     samplep = &(*samplep)->next)
+	{
+		if ((*samplep)->ptr == ptr) {
+			sample = *samplep;
+			*samplep = sample->next;
+			break;
+		}
+	}
+
+	if (sample != NULL) {
+		sample->stack->inuse_objs--;
+		sample->stack->inuse_bytes -= sample->size;
+		nsamples--;
+		nbytes -= sample->size;
+
+		count = atomic_load_relaxed(&filter[FILTER_SLOT(hash)]);
+		if (count < UINT8_MAX) {
+			INSIST(count > 0);
+			atomic_fetch_sub_relaxed(&filter[FILTER_SLOT(hash)], 1);
+		}
+		if (nsamples == 0) {
+			atomic_store_release(&isc__memprof_live, false);
+		}
+	}
+	RUNTIME_CHECK(pthread_mutex_unlock(&lock) == 0);
+
+	free(sample);
+}
+
+isc_result_t
+isc_memprof_start(size_t rate) {
+	void *frames[2];
+
+	if (isc_backtrace(frames, ARRAY_SIZE(frames)) < 0) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	if (rate == 0) {
+		rate = ISC_MEMPROF_RATE;
+	}
+
+	/* pprof scales all the samples of a profile by a single rate */
+	RUNTIME_CHECK(pthread_mutex_lock(&lock) == 0);
+	samplerate = rate;
+	atomic_store_relaxed(&isc__memprof_rate, rate);
+	RUNTIME_CHECK(pthread_mutex_unlock(&lock) == 0);
+
+	return (ISC_R_SUCCESS);
+}
+
+void
+isc_memprof_stop(void) {
+	atomic_store_relaxed(&isc__memprof_rate, 0);
+}
+
+/*
+ * Free all the samples and the call stacks; 'lock' must be held.
+ */
+static void
+memprof_clear(void) {
+	for (size_t i = 0; i < ARRAY_SIZE(samples); i++) {
+		while (samples[i] != NULL) {
+			memprof_sample_t *sample = samples[i];
+			samples[i] = sample->next;
+			free(sample);
+		}
+	}
+	for (size_t i = 0; i < ARRAY_SIZE(stacks); i++) {
+		while (stacks[i] != NULL) {
+			memprof_stack_t *stack = stacks[i];
+			stacks[i] = stack->next;
+			free(stack);
+		}
+	}
+	for (size_t i = 0; i < ARRAY_SIZE(filter); i++) {
+		atomic_store_relaxed(&filter[i], 0);
+	}
+
+	nsamples = 0;
+	nbytes = 0;
+	nallocs = 0;
+	atomic_store_release(&isc__memprof_live, false);
+}
+
+void
+isc_memprof_reset(void) {
+	RUNTIME_CHECK(pthread_mutex_lock(&lock) == 0);
+	memprof_clear();
+	RUNTIME_CHECK(pthread_mutex_unlock(&lock) == 0);
+}
+
+void
+isc_memprof_status(isc_memprofstatus_t *status) {
+	REQUIRE(status != NULL);
+
+	RUNTIME_CHECK(pthread_mutex_lock(&lock) == 0);
+	*status = (isc_memprofstatus_t){
+		.rate = atomic_load_relaxed(&isc__memprof_rate),
+		.samples = nsamples,
+		.bytes = nbytes,
+		.allocations = nallocs,
+	};
+	RUNTIME_CHECK(pthread_mutex_unlock(&lock) == 0);
+}
+
+/*
+ * Copy the /proc/self/maps of the process, which pprof needs to map the
+ * addresses to the binary and the shared libraries.
+ */
+static isc_result_t
+dump_maps(FILE *fp) {
+	FILE *maps = fopen("/proc/self/maps", "r");
+	char buf[4096];
+	size_t n;
+
+	if (maps == NULL) {
+		return (ISC_R_SUCCESS);
+	}
+
+	fputs("\nMAPPED_LIBRARIES:\n", fp);
+	while ((n = fread(buf, 1, sizeof(buf), maps)) > 0) {
+		if (fwrite(buf, 1, n, fp) != n) {
+			break;
+		}
+	}
+	(void)fclose(maps);
+
+	return (ferror(fp) ? ISC_R_FAILURE : ISC_R_SUCCESS);
+}
+
+isc_result_t
+isc_memprof_dump(FILE *fp) {
+	memprof_stack_t *snapshot = NULL;
+	size_t count = 0, n = 0;
+	size_t rate;
+	uint64_t inuse_objs = 0, inuse_bytes = 0;
+	uint64_t alloc_objs = 0, alloc_bytes = 0;
+
+	REQUIRE(fp != NULL);
+
+	/*
+	 * Copy the call stacks, so that the file is written without
+	 * holding the lock.
+	 */
+	RUNTIME_CHECK(pthread_mutex_lock(&lock) == 0);
+	for (size_t i = 0; i < ARRAY_SIZE(stacks); i++) {
+		for (memprof_stack_t *s = stacks[i]; s != NULL; s = s->next) {
+			count++;
+		}
+	}
+	if (count > 0) {
+		snapshot = malloc(count * sizeof(snapshot[0]));
+		if (snapshot == NULL) {
+			RUNTIME_CHECK(pthread_mutex_unlock(&lock) == 0);
+			return (ISC_R_NOMEMORY);
+		}
+	}
+	for (size_t i = 0; i < ARRAY_SIZE(stacks); i++) {
+		for (memprof_stack_t *s = stacks[i]; s != NULL; s = s->next) {
+			snapshot[n++] = *s;
+		}
+	}
+	rate = samplerate;
+	RUNTIME_CHECK(pthread_mutex_unlock(&lock) == 0);
+
+	INSIST(n == count);
+
+	for (size_t i = 0; i < count; i++) {
+		inuse_objs += snapshot[i].inuse_objs;
+		inuse_bytes += snapshot[i].inuse_bytes;
+		alloc_objs += snapshot[i].alloc_objs;
+		alloc_bytes += snapshot[i].alloc_bytes;
+	}
+
+	fprintf(fp,
+		"heap profile: %6" PRIu64 ": %8" PRIu64 " [%6" PRIu64
+		": %8" PRIu64 "] @ heap_v2/%zu\n",
+		inuse_objs, inuse_bytes, alloc_objs, alloc_bytes, rate);
+
+	for (size_t i = 0; i < count; i++) {
+		memprof_stack_t *s = &snapshot[i];
+
+		fprintf(fp,
+			"%6" PRIu64 ": %8" PRIu64 " [%6" PRIu64 ": %8" PRIu64
+			"] @",
+			s->inuse_objs, s->inuse_bytes, s->alloc_objs,
+			s->alloc_bytes);
+		for (int j = 0; j < s->nframes; j++) {
+			fprintf(fp, " %p", s->frames[j]);
+		}
+		fputc('\n', fp);
+	}
+
+	free(snapshot);
+
+	if (ferror(fp)) {
+		return (ISC_R_FAILURE);
+	}
+
+	return (dump_maps(fp));
+}
+
+void
+isc__memprof_shutdown(void) {
+	atomic_store_relaxed(&isc__memprof_rate, 0);
+
+	RUNTIME_CHECK(pthread_mutex_lock(&lock) == 0);
+	memprof_clear();
+	RUNTIME_CHECK(pthread_mutex_unlock(&lock) == 0);
+}
@@ -47,6 +47,28 @@ isc__mutex_initialize(void) {
 		      ISC_R_SUCCESS);
 }
 
+#if ISC_LOCK_PROFILE
+void
+isc__mutex_lock_profile(pthread_mutex_t *mp, isc_lockstats_t *stats) {
+	uint64_t start;
+	int ret;
+
+	ret = pthread_mutex_trylock(mp);
+	if (ret == 0) {
+		isc__lockprof_record(stats, false, 0);
+		return;
+	}
+	if (ret != EBUSY) {
+		PTHREADS_RUNTIME_CHECK(pthread_mutex_trylock, ret);
+	}
+
+	start = isc__lockprof_now();
+	ret = pthread_mutex_lock(mp);
+	PTHREADS_RUNTIME_CHECK(pthread_mutex_lock, ret);
+	isc__lockprof_record(stats, true, isc__lockprof_now() - start);
+}
+#endif /* ISC_LOCK_PROFILE */
+
 void
 isc__mutex_shutdown(void) {
 	/* noop */;
@@ -19,10 +19,13 @@
 #include <string.h>
 
 #include <isc/base64.h>
+#include <isc/hash.h>
 #include <isc/log.h>
 #include <isc/netmgr.h>
 #include <isc/print.h>
 #include <isc/sockaddr.h>
+#include <isc/stats.h>
+#include <isc/stdtime.h>
 #include <isc/tls.h>
 #include <isc/url.h>
 #include <isc/util.h>
@@ -75,6 +78,10 @@
  * "tinygrams" problem. */
 #define FLUSH_HTTP_WRITE_BUFFER_AFTER (1536)
 
+/* The range of SETTINGS_MAX_FRAME_SIZE values allowed by RFC 7540 */
+#define MIN_HTTP2_FRAME_SIZE (1 << 14)
+#define MAX_HTTP2_FRAME_SIZE ((1 << 24) - 1)
+
 /* This switch is here mostly to test the code interoperability with
  * buggy implementations */
 #define ENABLE_HTTP_WRITE_BUFFERING 1
@@ -153,6 +160,12 @@ struct isc_nm_http_session {
 	isc_tlsctx_t *tlsctx;
 	uint32_t max_concurrent_streams;
 
+	/* HTTP/2 settings of server sessions; 0 means the default */
+	uint32_t initial_window_size;
+	uint32_t max_frame_size;
+	uint32_t header_table_size;
+	int32_t connection_window_size;
+
 	isc__nm_http_pending_callbacks_t pending_write_callbacks;
 	isc_buffer_t *pending_write_data;
 };
@@ -216,6 +229,12 @@ finish_http_session(isc_nm_http_session_t *session);
 static void
 http_transpost_tcp_nodelay(isc_nmhandle_t *transphandle);
 
+static void
+server_adapt_window(isc_nm_http_session_t *session);
+
+static void
+http_incstats(isc_nmsocket_t *socket, isc_statscounter_t counter);
+
 static void
 call_pending_callbacks(isc__nm_http_pending_callbacks_t pending_callbacks,
 		       isc_result_t result);
@@ -1071,11 +1090,22 @@ move_pending_send_callbacks(isc_nm_http_session_t *session,
 	ISC_LIST_INIT(session->pending_write_callbacks);
 }
 
+static void
+http_put_pending(isc_nm_http_session_t *session, const void *data,
+		 size_t length) {
+	if (session->pending_write_data == NULL) {
+		isc_buffer_allocate(session->mctx, &session->pending_write_data,
+				    INITIAL_DNS_MESSAGE_BUFFER_SIZE);
+		isc_buffer_setautorealloc(session->pending_write_data, true);
+	}
+	isc_buffer_putmem(session->pending_write_data, data, length);
+}
+
 static bool
 http_send_outgoing(isc_nm_http_session_t *session, isc_nmhandle_t *httphandle,
 		   isc_nm_cb_t cb, void *cbarg) {
 	isc_http_send_req_t *send = NULL;
-	size_t total = 0;
+	size_t total = 0, before = 0;
 	isc_region_t send_data = { 0 };
 	isc_nmhandle_t *transphandle = NULL;
 #ifdef ENABLE_HTTP_WRITE_BUFFERING
@@ -1099,11 +1129,14 @@ http_send_outgoing(isc_nm_http_session_t *session, isc_nmhandle_t *httphandle,
 	 */
 	isc_nmhandle_attach(session->handle, &transphandle);
 
+	if (session->pending_write_data != NULL) {
+		before = isc_buffer_usedlength(session->pending_write_data);
+	}
+
 	while (nghttp2_session_want_write(session->ngsession)) {
 		const uint8_t *data = NULL;
 		const size_t pending =
 			nghttp2_session_mem_send(session->ngsession, &data);
-		const size_t new_total = total + pending;
 
 		/*
 		 * Sometimes nghttp2_session_mem_send() does not return any
@@ -1114,16 +1147,18 @@ http_send_outgoing(isc_nm_http_session_t *session, isc_nmhandle_t *httphandle,
 			break;
 		}
 
-		/* reallocate buffer if required */
-		if (session->pending_write_data == NULL) {
-			isc_buffer_allocate(session->mctx,
-					    &session->pending_write_data,
-					    INITIAL_DNS_MESSAGE_BUFFER_SIZE);
-			isc_buffer_setautorealloc(session->pending_write_data,
-						  true);
-		}
-		isc_buffer_putmem(session->pending_write_data, data, pending);
-		total = new_total;
+		http_put_pending(session, data, pending);
+	}
+
+	/*
+	 * DATA frames of server responses are not returned by
+	 * nghttp2_session_mem_send(), but appended to the pending
+	 * writes buffer directly by server_send_data_callback(), so
+	 * count what has been added to the buffer.
+	 */
+	if (session->pending_write_data != NULL) {
+		total = isc_buffer_usedlength(session->pending_write_data) -
+			before;
 	}
 
 #ifdef ENABLE_HTTP_WRITE_BUFFERING
@@ -1664,6 +1699,8 @@ server_on_begin_headers_callback(nghttp2_session *ngsession,
 	isc__nmsocket_init(socket, worker, isc_nm_httpsocket,
 			   (isc_sockaddr_t *)&session->handle->sock->iface);
 	socket->peer = session->handle->sock->peer;
+	socket->proxied = session->handle->proxied;
+	socket->proxysource = session->handle->proxysource;
 	socket->h2 = (isc_nmsocket_h2_t){
 		.psock = socket,
 		.stream_id = frame->hd.stream_id,
@@ -1674,6 +1711,12 @@ server_on_begin_headers_callback(nghttp2_session *ngsession,
 	isc_buffer_initnull(&socket->h2.rbuf);
 	isc_buffer_initnull(&socket->h2.wbuf);
 	session->nsstreams++;
+	server_adapt_window(session);
+	if (worker->netmgr->stats != NULL) {
+		isc_stats_update_if_greater(worker->netmgr->stats,
+					    isc_sockstatscounter_httpstreamsmax,
+					    session->nsstreams);
+	}
 	isc__nm_httpsession_attach(session, &socket->h2.session);
 	ISC_LINK_INIT(&socket->h2, link);
 	ISC_LIST_APPEND(session->sstreams, &socket->h2, link);
@@ -1919,24 +1962,97 @@ server_read_callback(nghttp2_session *ngsession, int32_t stream_id,
 	UNUSED(ngsession);
 	UNUSED(session);
 
+	UNUSED(buf);
+
 	buflen = isc_buffer_remaininglength(&socket->h2.wbuf);
 	if (buflen > length) {
 		buflen = length;
 	}
 
-	if (buflen > 0) {
-		(void)memmove(buf, isc_buffer_current(&socket->h2.wbuf),
-			      buflen);
-		isc_buffer_forward(&socket->h2.wbuf, buflen);
+	if (buflen == isc_buffer_remaininglength(&socket->h2.wbuf)) {
+		*data_flags |= NGHTTP2_DATA_FLAG_EOF;
 	}
 
-	if (isc_buffer_remaininglength(&socket->h2.wbuf) == 0) {
-		*data_flags |= NGHTTP2_DATA_FLAG_EOF;
+	/*
+	 * Do not copy the response into the nghttp2 frame buffer; it is
+	 * written straight from the send request by
+	 * server_send_data_callback() instead.
+	 */
+	if (buflen > 0) {
+		*data_flags |= NGHTTP2_DATA_FLAG_NO_COPY;
 	}
 
 	return (buflen);
 }
 
+/*
+ * Let DATA frames be as large as the client and the flow-control
+ * windows allow, rather than nghttp2's default of 16 KiB, and count
+ * the frames which the windows made shorter than the rest of the
+ * response.
+ */
+static ssize_t
+server_read_length_callback(nghttp2_session *ngsession, uint8_t frame_type,
+			    int32_t stream_id,
+			    int32_t session_remote_window_size,
+			    int32_t stream_remote_window_size,
+			    uint32_t remote_max_frame_size, void *user_data) {
+	isc_nmsocket_t *socket = NULL;
+	int32_t window;
+
+	UNUSED(frame_type);
+	UNUSED(user_data);
+
+	window = ISC_MIN(session_remote_window_size,
+			 stream_remote_window_size);
+
+	socket = nghttp2_session_get_stream_user_data(ngsession, stream_id);
+	if (socket != NULL && window >= 0 &&
+	    (size_t)window < isc_buffer_remaininglength(&socket->h2.wbuf))
+	{
+		http_incstats(socket, isc_sockstatscounter_httpflowstall);
+	}
+
+	return (ISC_MIN((ssize_t)window, (ssize_t)remote_max_frame_size));
+}
+
+static int
+server_send_data_callback(nghttp2_session *ngsession, nghttp2_frame *frame,
+			  const uint8_t *framehd, size_t length,
+			  nghttp2_data_source *source, void *user_data) {
+	isc_nm_http_session_t *session = (isc_nm_http_session_t *)user_data;
+	isc_nmsocket_t *socket = (isc_nmsocket_t *)source->ptr;
+	size_t padlen = frame->data.padlen;
+
+	UNUSED(ngsession);
+
+	REQUIRE(VALID_HTTP2_SESSION(session));
+	REQUIRE(socket->h2.stream_id == frame->hd.stream_id);
+	REQUIRE(isc_buffer_remaininglength(&socket->h2.wbuf) >= length);
+
+	/*
+	 * The frame is appended to the pending writes buffer together
+	 * with the frames of the other streams, so that they all go out
+	 * in a single write.
+	 */
+	http_put_pending(session, framehd, 9);
+	if (padlen > 0) {
+		uint8_t padbyte = (uint8_t)(padlen - 1);
+
+		http_put_pending(session, &padbyte, 1);
+	}
+	http_put_pending(session, isc_buffer_current(&socket->h2.wbuf),
+			 length);
+	isc_buffer_forward(&socket->h2.wbuf, length);
+	if (padlen > 1) {
+		static const uint8_t zeros[256] = { 0 };
+
+		http_put_pending(session, zeros, padlen - 1);
+	}
+
+	return (0);
+}
+
 static isc_result_t
 server_send_response(nghttp2_session *ngsession, int32_t stream_id,
 		     const nghttp2_nv *nva, size_t nvlen,
@@ -2056,7 +2172,7 @@ server_call_cb(isc_nmsocket_t *socket, isc_nm_http_session_t *session,
 	REQUIRE(VALID_HTTP2_SESSION(session));
 	REQUIRE(socket->h2.cb != NULL);
 
-	addr = isc_nmhandle_peeraddr(session->handle);
+	addr = isc_nmhandle_proxyaddr(session->handle);
 	handle = isc__nmhandle_get(socket, &addr, NULL);
 	socket->h2.cb(handle, result, data, socket->h2.cbarg);
 	isc_nmhandle_detach(&handle);
@@ -2077,6 +2193,375 @@ isc__nm_http_bad_request(isc_nmhandle_t *handle) {
 					 sock->h2.session->ngsession, sock);
 }
 
+/*
+ * DoH GET response cache.
+ *
+ * Clients using GET requests are encouraged to set the DNS ID to zero
+ * (RFC 8484, section 4.1), so identical questions produce identical
+ * requests.  When enabled on a listener, rendered responses to GET
+ * requests are kept for the time to live hinted by the server (see
+ * isc_nm_set_maxage()), keyed by the request path and the DNS message
+ * with its ID zeroed.  A hit is answered directly from the HTTP layer
+ * without handing the request to the DNS server: the stored response
+ * is sent unchanged apart from its ID, with the original "max-age" and
+ * an "Age" header telling the client how long it has been cached (RFC
+ * 8484, section 5.1).
+ *
+ * There is one cache per listener and worker thread, so that no locking
+ * is needed; each is only touched from its own thread, and created
+ * lazily on first use.
+ */
+#define RCACHE_MAX_RESPONSE (4 * 1024)
+
+typedef struct http_rcache_entry http_rcache_entry_t;
+struct http_rcache_entry {
+	uint32_t hashval;
+	isc_stdtime_t stored;
+	uint32_t ttl;
+	isc_stdtime_t expire;
+	unsigned char *key;
+	size_t keylen;
+	unsigned char *response;
+	size_t responselen;
+	http_rcache_entry_t *next; /* hash chain */
+	ISC_LINK(http_rcache_entry_t) link; /* LRU order */
+};
+
+struct isc__nm_http_rcache {
+	isc_mem_t *mctx;
+	uint32_t size;
+	uint32_t count;
+	uint32_t nbuckets;
+	http_rcache_entry_t **table;
+	ISC_LIST(http_rcache_entry_t) lru;
+};
+
+static void
+rcache_entry_free(isc__nm_http_rcache_t *cache, http_rcache_entry_t *entry) {
+	isc_mem_put(cache->mctx, entry->key, entry->keylen);
+	isc_mem_put(cache->mctx, entry->response, entry->responselen);
+	isc_mem_put(cache->mctx, entry, sizeof(*entry));
+}
+
+static void
+rcache_unlink(isc__nm_http_rcache_t *cache, http_rcache_entry_t *entry) {
+	http_rcache_entry_t **prevp =
+		&cache->table[entry->hashval % cache->nbuckets];
+
+	while (*prevp != entry) {
+		prevp = &(*prevp)->next;
+	}
+	*prevp = entry->next;
+	ISC_LIST_UNLINK(cache->lru, entry, link);
+	cache->count--;
+}
+
+static void
+rcache_destroy(isc__nm_http_rcache_t **cachep) {
+	isc__nm_http_rcache_t *cache = *cachep;
+	http_rcache_entry_t *entry = NULL;
+
+	*cachep = NULL;
+
+	while ((entry = ISC_LIST_HEAD(cache->lru)) != NULL) {
+		ISC_LIST_UNLINK(cache->lru, entry, link);
+		rcache_entry_free(cache, entry);
+	}
+	isc_mem_put(cache->mctx, cache->table,
+		    cache->nbuckets * sizeof(cache->table[0]));
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+static isc__nm_http_rcache_t *
+rcache_create(isc_mem_t *mctx, uint32_t size) {
+	isc__nm_http_rcache_t *cache = isc_mem_get(mctx, sizeof(*cache));
+
+	*cache = (isc__nm_http_rcache_t){
+		.size = size,
+		.nbuckets = size,
+	};
+	isc_mem_attach(mctx, &cache->mctx);
+	cache->table = isc_mem_get(cache->mctx,
+				   cache->nbuckets * sizeof(cache->table[0]));
+	memset(cache->table, 0, cache->nbuckets * sizeof(cache->table[0]));
+	ISC_LIST_INIT(cache->lru);
+
+	return (cache);
+}
+
+/*
+ * Return the cache of the current thread for 'listener', (re)creating
+ * it if the configured size has changed, or NULL if caching is off.
+ */
+static isc__nm_http_rcache_t *
+rcache_get(isc_nmsocket_t *listener) {
+	uint32_t size = atomic_load_relaxed(&listener->h2.response_cache_size);
+	isc__nm_http_rcache_t **cachep = NULL;
+	int tid = isc_tid();
+
+	if (listener->h2.response_caches == NULL ||
+	    (size_t)tid >= listener->h2.n_listener_endpoints)
+	{
+		return (NULL);
+	}
+
+	cachep = &listener->h2.response_caches[tid];
+	if (*cachep != NULL && (*cachep)->size != size) {
+		rcache_destroy(cachep);
+	}
+	if (size == 0 || *cachep != NULL) {
+		return (*cachep);
+	}
+
+	*cachep = rcache_create(listener->worker->mctx, size);
+	return (*cachep);
+}
+
+static http_rcache_entry_t *
+rcache_find(isc__nm_http_rcache_t *cache, const unsigned char *key,
+	    size_t keylen, uint32_t hashval) {
+	http_rcache_entry_t *entry = cache->table[hashval % cache->nbuckets];
+
+	for (; entry != NULL; entry = entry->next) {
+		if (entry->hashval == hashval && entry->keylen == keylen &&
+		    memcmp(entry->key, key, keylen) == 0)
+		{
+			return (entry);
+		}
+	}
+
+	return (NULL);
+}
+
+/*
+ * Find the unexpired entry for 'key' and make it the most recently
+ * used one; expired entries are dropped.
+ */
+static http_rcache_entry_t *
+rcache_lookup(isc__nm_http_rcache_t *cache, const unsigned char *key,
+	      size_t keylen, isc_stdtime_t now) {
+	uint32_t hashval = isc_hash32(key, keylen, true);
+	http_rcache_entry_t *entry = rcache_find(cache, key, keylen, hashval);
+
+	if (entry == NULL) {
+		return (NULL);
+	}
+
+	if (entry->expire <= now) {
+		rcache_unlink(cache, entry);
+		rcache_entry_free(cache, entry);
+		return (NULL);
+	}
+
+	ISC_LIST_UNLINK(cache->lru, entry, link);
+	ISC_LIST_PREPEND(cache->lru, entry, link);
+
+	return (entry);
+}
+
+/*
+ * Copy the response of 'entry' to 'target', giving it the ID of
+ * 'request'.
+ */
+static void
+rcache_copyresponse(const http_rcache_entry_t *entry,
+		    const isc_region_t *request, unsigned char *target) {
+	memmove(target, entry->response, entry->responselen);
+	target[0] = request->base[0];
+	target[1] = request->base[1];
+}
+
+static void
+rcache_add(isc__nm_http_rcache_t *cache, const unsigned char *key,
+	   size_t keylen, const unsigned char *response, size_t responselen,
+	   isc_stdtime_t now, uint32_t ttl) {
+	uint32_t hashval = isc_hash32(key, keylen, true);
+	http_rcache_entry_t *entry = rcache_find(cache, key, keylen, hashval);
+
+	if (entry != NULL) {
+		rcache_unlink(cache, entry);
+		rcache_entry_free(cache, entry);
+	}
+
+	/* Evict the least recently used entry */
+	if (cache->count >= cache->size) {
+		entry = ISC_LIST_TAIL(cache->lru);
+		INSIST(entry != NULL);
+		rcache_unlink(cache, entry);
+		rcache_entry_free(cache, entry);
+	}
+
+	entry = isc_mem_get(cache->mctx, sizeof(*entry));
+	*entry = (http_rcache_entry_t){
+		.hashval = hashval,
+		.stored = now,
+		.ttl = ttl,
+		.expire = now + ttl,
+		.keylen = keylen,
+		.responselen = responselen,
+	};
+	ISC_LINK_INIT(entry, link);
+	entry->key = isc_mem_get(cache->mctx, keylen);
+	memmove(entry->key, key, keylen);
+	entry->response = isc_mem_get(cache->mctx, responselen);
+	memmove(entry->response, response, responselen);
+	/* Clear the ID */
+	entry->response[0] = entry->response[1] = 0;
+
+	entry->next = cache->table[hashval % cache->nbuckets];
+	cache->table[hashval % cache->nbuckets] = entry;
+	ISC_LIST_PREPEND(cache->lru, entry, link);
+	cache->count++;
+}
+
+static void
+http_incstats(isc_nmsocket_t *socket, isc_statscounter_t counter) {
+	isc_stats_t *stats = socket->worker->netmgr->stats;
+
+	if (stats != NULL) {
+		isc_stats_increment(stats, counter);
+	}
+}
+
+/*
+ * Submit the DNS response in 'base'.  'agep' is NULL for a fresh
+ * response, or points to the time a cached one has been stored for.
+ */
+static isc_result_t
+server_submit_dns_response(isc_nmsocket_t *sock, unsigned char *base,
+			   size_t length, const uint32_t *agep) {
+	size_t content_len_buf_len, cache_control_buf_len, age_buf_len = 0;
+
+	isc_buffer_init(&sock->h2.wbuf, base, length);
+	isc_buffer_add(&sock->h2.wbuf, length);
+
+	content_len_buf_len = snprintf(sock->h2.clenbuf,
+				       sizeof(sock->h2.clenbuf), "%lu",
+				       (unsigned long)length);
+	if (sock->h2.min_ttl == 0) {
+		cache_control_buf_len =
+			snprintf(sock->h2.cache_control_buf,
+				 sizeof(sock->h2.cache_control_buf), "%s",
+				 DEFAULT_CACHE_CONTROL);
+	} else {
+		cache_control_buf_len =
+			snprintf(sock->h2.cache_control_buf,
+				 sizeof(sock->h2.cache_control_buf),
+				 "max-age=%" PRIu32, sock->h2.min_ttl);
+	}
+	if (agep != NULL) {
+		age_buf_len = snprintf(sock->h2.agebuf, sizeof(sock->h2.agebuf),
+				       "%" PRIu32, *agep);
+	}
+	const nghttp2_nv hdrs[] = { MAKE_NV2(":status", "200"),
+				    MAKE_NV2("Content-Type", DNS_MEDIA_TYPE),
+				    MAKE_NV("Content-Length", sock->h2.clenbuf,
+					    content_len_buf_len),
+				    MAKE_NV("Cache-Control",
+					    sock->h2.cache_control_buf,
+					    cache_control_buf_len),
+				    MAKE_NV("Age", sock->h2.agebuf,
+					    age_buf_len) };
+	size_t nhdrs = sizeof(hdrs) / sizeof(nghttp2_nv);
+
+	/* The "Age" header is only sent with cached responses */
+	if (agep == NULL) {
+		nhdrs--;
+	}
+
+	return (server_send_response(sock->h2.session->ngsession,
+				     sock->h2.stream_id, hdrs, nhdrs, sock));
+}
+
+/*
+ * Look up a decoded GET request in the response cache of the listener.
+ * On a hit, the response is submitted and true is returned.  On a miss,
+ * the cache key is kept in the stream socket, so that the response can
+ * be added to the cache by server_httpsend().
+ */
+static bool
+server_send_cached_response(isc_nm_http_session_t *session,
+			    isc_nmsocket_t *socket, const isc_region_t *data) {
+	isc__nm_http_rcache_t *cache = NULL;
+	http_rcache_entry_t *entry = NULL;
+	size_t pathlen, keylen;
+	unsigned char *key = NULL;
+	isc_stdtime_t now;
+	uint32_t age;
+
+	if (session->serversocket == NULL || data->length < 12) {
+		return (false);
+	}
+
+	cache = rcache_get(session->serversocket);
+	if (cache == NULL) {
+		return (false);
+	}
+
+	/* The key is the path, a NUL and the message with its ID zeroed */
+	pathlen = strlen(socket->h2.request_path);
+	keylen = pathlen + 1 + data->length;
+	key = isc_mem_get(socket->worker->mctx, keylen);
+	memmove(key, socket->h2.request_path, pathlen + 1);
+	memmove(key + pathlen + 1, data->base, data->length);
+	key[pathlen + 1] = key[pathlen + 2] = 0;
+
+	isc_stdtime_get(&now);
+	entry = rcache_lookup(cache, key, keylen, now);
+	if (entry == NULL) {
+		http_incstats(socket, isc_sockstatscounter_httpcachemiss);
+		socket->h2.cache_key = key;
+		socket->h2.cache_keylen = keylen;
+		return (false);
+	}
+
+	isc_mem_put(socket->worker->mctx, key, keylen);
+
+	socket->h2.cached_response = isc_mem_get(socket->worker->mctx,
+						 entry->responselen);
+	socket->h2.cached_responselen = entry->responselen;
+	rcache_copyresponse(entry, data, socket->h2.cached_response);
+	socket->h2.min_ttl = entry->ttl;
+	age = now - entry->stored;
+
+	if (server_submit_dns_response(socket, socket->h2.cached_response,
+				       socket->h2.cached_responselen,
+				       &age) != ISC_R_SUCCESS)
+	{
+		return (false);
+	}
+
+	http_incstats(socket, isc_sockstatscounter_httpcachehit);
+	return (true);
+}
+
+/*
+ * Add the response about to be sent on a stream to the response cache,
+ * if the request was a cacheable GET request.
+ */
+static void
+server_cache_response(isc_nmsocket_t *sock, const isc_region_t *response) {
+	isc__nm_http_rcache_t *cache = NULL;
+	isc_nm_http_session_t *session = sock->h2.session;
+	isc_stdtime_t now;
+
+	if (sock->h2.cache_key == NULL || sock->h2.min_ttl == 0 ||
+	    response->length < 12 || response->length > RCACHE_MAX_RESPONSE ||
+	    session->serversocket == NULL)
+	{
+		return;
+	}
+
+	cache = rcache_get(session->serversocket);
+	if (cache == NULL) {
+		return;
+	}
+
+	isc_stdtime_get(&now);
+	rcache_add(cache, sock->h2.cache_key, sock->h2.cache_keylen,
+		   response->base, response->length, now, sock->h2.min_ttl);
+}
+
 static int
 server_on_request_recv(nghttp2_session *ngsession,
 		       isc_nm_http_session_t *session, isc_nmsocket_t *socket) {
@@ -2143,6 +2628,9 @@ server_on_request_recv(nghttp2_session *ngsession,
 			goto error;
 		}
 		isc_buffer_usedregion(&decoded_buf, &data);
+		if (server_send_cached_response(session, socket, &data)) {
+			return (0);
+		}
 	} else if (socket->h2.request_type == ISC_HTTP_REQ_POST) {
 		INSIST(socket->h2.content_length > 0);
 		isc_buffer_usedregion(&socket->h2.rbuf, &data);
@@ -2223,7 +2711,6 @@ client_httpsend(isc_nmhandle_t *handle, isc_nmsocket_t *sock,
 static void
 server_httpsend(isc_nmhandle_t *handle, isc_nmsocket_t *sock,
 		isc__nm_uvreq_t *req) {
-	size_t content_len_buf_len, cache_control_buf_len;
 	isc_result_t result = ISC_R_SUCCESS;
 	isc_nm_cb_t cb = req->cb.send;
 	void *cbarg = req->cbarg;
@@ -2237,36 +2724,15 @@ server_httpsend(isc_nmhandle_t *handle, isc_nmsocket_t *sock,
 	INSIST(VALID_NMHANDLE(handle->httpsession->handle));
 	INSIST(VALID_NMSOCK(handle->httpsession->handle->sock));
 
-	isc_buffer_init(&sock->h2.wbuf, req->uvbuf.base, req->uvbuf.len);
-	isc_buffer_add(&sock->h2.wbuf, req->uvbuf.len);
-
-	content_len_buf_len = snprintf(sock->h2.clenbuf,
-				       sizeof(sock->h2.clenbuf), "%lu",
-				       (unsigned long)req->uvbuf.len);
-	if (sock->h2.min_ttl == 0) {
-		cache_control_buf_len =
-			snprintf(sock->h2.cache_control_buf,
-				 sizeof(sock->h2.cache_control_buf), "%s",
-				 DEFAULT_CACHE_CONTROL);
-	} else {
-		cache_control_buf_len =
-			snprintf(sock->h2.cache_control_buf,
-				 sizeof(sock->h2.cache_control_buf),
-				 "max-age=%" PRIu32, sock->h2.min_ttl);
-	}
-	const nghttp2_nv hdrs[] = { MAKE_NV2(":status", "200"),
-				    MAKE_NV2("Content-Type", DNS_MEDIA_TYPE),
-				    MAKE_NV("Content-Length", sock->h2.clenbuf,
-					    content_len_buf_len),
-				    MAKE_NV("Cache-Control",
-					    sock->h2.cache_control_buf,
-					    cache_control_buf_len) };
-
-	result = server_send_response(handle->httpsession->ngsession,
-				      sock->h2.stream_id, hdrs,
-				      sizeof(hdrs) / sizeof(nghttp2_nv), sock);
+	result = server_submit_dns_response(sock,
+					    (unsigned char *)req->uvbuf.base,
+					    req->uvbuf.len, NULL);
 
 	if (result == ISC_R_SUCCESS) {
+		server_cache_response(
+			sock, &(isc_region_t){ .base = (unsigned char *)
+							       req->uvbuf.base,
+					       .length = req->uvbuf.len });
 		http_do_bio(handle->httpsession, handle, cb, cbarg);
 	} else {
 		cb(handle, result, cbarg);
@@ -2393,6 +2859,12 @@ initialize_nghttp2_server_session(isc_nm_http_session_t *session) {
 	nghttp2_session_callbacks_set_on_frame_recv_callback(
 		callbacks, server_on_frame_recv_callback);
 
+	nghttp2_session_callbacks_set_send_data_callback(
+		callbacks, server_send_data_callback);
+
+	nghttp2_session_callbacks_set_data_source_read_length_callback(
+		callbacks, server_read_length_callback);
+
 	RUNTIME_CHECK(nghttp2_session_server_new3(&session->ngsession,
 						  callbacks, session, NULL,
 						  &mem) == 0);
@@ -2402,20 +2874,71 @@ initialize_nghttp2_server_session(isc_nm_http_session_t *session) {
 
 static int
 server_send_connection_header(isc_nm_http_session_t *session) {
-	nghttp2_settings_entry iv[1] = {
+	nghttp2_settings_entry iv[4] = {
 		{ NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS,
 		  session->max_concurrent_streams }
 	};
+	size_t niv = 1;
 	int rv;
 
+	if (session->initial_window_size != 0) {
+		iv[niv++] = (nghttp2_settings_entry){
+			NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE,
+			session->initial_window_size
+		};
+	}
+	if (session->max_frame_size != 0) {
+		iv[niv++] = (nghttp2_settings_entry){
+			NGHTTP2_SETTINGS_MAX_FRAME_SIZE, session->max_frame_size
+		};
+	}
+	if (session->header_table_size != 0) {
+		iv[niv++] = (nghttp2_settings_entry){
+			NGHTTP2_SETTINGS_HEADER_TABLE_SIZE,
+			session->header_table_size
+		};
+	}
+
 	rv = nghttp2_submit_settings(session->ngsession, NGHTTP2_FLAG_NONE, iv,
-				     1);
+				     niv);
 	if (rv != 0) {
 		return (-1);
 	}
 	return (0);
 }
 
+/*
+ * The connection-level flow-control window is shared by all the
+ * streams of a session and is not changed by SETTINGS.  When a larger
+ * stream window is configured, grow the connection window with the
+ * number of concurrent streams, so that one client multiplexing many
+ * queries is not held back to a single stream window.
+ */
+static void
+server_adapt_window(isc_nm_http_session_t *session) {
+	int64_t size;
+
+	if (session->initial_window_size == 0) {
+		return;
+	}
+
+	size = (int64_t)session->initial_window_size * session->nsstreams;
+	if (size > NGHTTP2_MAX_WINDOW_SIZE) {
+		size = NGHTTP2_MAX_WINDOW_SIZE;
+	}
+
+	if (size <= session->connection_window_size) {
+		return;
+	}
+
+	if (nghttp2_session_set_local_window_size(session->ngsession,
+						  NGHTTP2_FLAG_NONE, 0,
+						  (int32_t)size) == 0)
+	{
+		session->connection_window_size = (int32_t)size;
+	}
+}
+
 /*
  * It is advisable to disable Nagle's algorithm for HTTP/2
  * connections because multiple HTTP/2 streams could be multiplexed
@@ -2487,6 +3010,14 @@ httplisten_acceptcb(isc_nmhandle_t *handle, isc_result_t result, void *cbarg) {
 	new_session(handle->sock->worker->mctx, NULL, &session);
 	session->max_concurrent_streams =
 		atomic_load(&httplistensock->h2.max_concurrent_streams);
+	session->initial_window_size =
+		atomic_load_relaxed(&httplistensock->h2.initial_window_size);
+	session->max_frame_size =
+		atomic_load_relaxed(&httplistensock->h2.max_frame_size);
+	session->header_table_size =
+		atomic_load_relaxed(&httplistensock->h2.header_table_size);
+	session->connection_window_size =
+		NGHTTP2_INITIAL_CONNECTION_WINDOW_SIZE;
 	initialize_nghttp2_server_session(session);
 	handle->sock->h2.session = session;
 
@@ -2517,6 +3048,10 @@ isc_nm_listenhttp(isc_nm_t *mgr, uint32_t workers, isc_sockaddr_t *iface,
 	isc__nmsocket_init(sock, worker, isc_nm_httplistener, iface);
 	atomic_init(&sock->h2.max_concurrent_streams,
 		    NGHTTP2_INITIAL_MAX_CONCURRENT_STREAMS);
+	atomic_init(&sock->h2.response_cache_size, 0);
+	atomic_init(&sock->h2.initial_window_size, 0);
+	atomic_init(&sock->h2.max_frame_size, 0);
+	atomic_init(&sock->h2.header_table_size, 0);
 
 	isc_nmsocket_set_max_streams(sock, max_concurrent_streams);
 
@@ -2986,6 +3521,38 @@ isc__nm_http_set_max_streams(isc_nmsocket_t *listener,
 	atomic_store(&listener->h2.max_concurrent_streams, max_streams);
 }
 
+void
+isc_nm_http_set_response_cache(isc_nmsocket_t *listener, uint32_t size) {
+	REQUIRE(VALID_NMSOCK(listener));
+	REQUIRE(listener->type == isc_nm_httplistener);
+
+	atomic_store_relaxed(&listener->h2.response_cache_size, size);
+}
+
+void
+isc_nm_http_set_settings(isc_nmsocket_t *listener,
+			 uint32_t initial_window_size, uint32_t max_frame_size,
+			 uint32_t header_table_size) {
+	REQUIRE(VALID_NMSOCK(listener));
+	REQUIRE(listener->type == isc_nm_httplistener);
+
+	if (initial_window_size > (uint32_t)NGHTTP2_MAX_WINDOW_SIZE) {
+		initial_window_size = NGHTTP2_MAX_WINDOW_SIZE;
+	}
+	if (max_frame_size != 0) {
+		max_frame_size = ISC_MAX(max_frame_size,
+					 MIN_HTTP2_FRAME_SIZE);
+		max_frame_size = ISC_MIN(max_frame_size,
+					 MAX_HTTP2_FRAME_SIZE);
+	}
+
+	atomic_store_relaxed(&listener->h2.initial_window_size,
+			     initial_window_size);
+	atomic_store_relaxed(&listener->h2.max_frame_size, max_frame_size);
+	atomic_store_relaxed(&listener->h2.header_table_size,
+			     header_table_size);
+}
+
 void
 isc_nm_http_set_endpoints(isc_nmsocket_t *listener,
 			  isc_nm_http_endpoints_t *eps) {
@@ -3040,11 +3607,15 @@ http_init_listener_endpoints(isc_nmsocket_t *listener,
 	listener->h2.listener_endpoints =
 		isc_mem_get(listener->worker->mctx,
 			    sizeof(isc_nm_http_endpoints_t *) * nworkers);
+	listener->h2.response_caches =
+		isc_mem_get(listener->worker->mctx,
+			    sizeof(isc__nm_http_rcache_t *) * nworkers);
 	listener->h2.n_listener_endpoints = nworkers;
 	for (size_t i = 0; i < nworkers; i++) {
 		listener->h2.listener_endpoints[i] = NULL;
 		isc_nm_http_endpoints_attach(
 			epset, &listener->h2.listener_endpoints[i]);
+		listener->h2.response_caches[i] = NULL;
 	}
 }
 
@@ -3059,10 +3630,17 @@ http_cleanup_listener_endpoints(isc_nmsocket_t *listener) {
 	for (size_t i = 0; i < listener->h2.n_listener_endpoints; i++) {
 		isc_nm_http_endpoints_detach(
 			&listener->h2.listener_endpoints[i]);
+		if (listener->h2.response_caches[i] != NULL) {
+			rcache_destroy(&listener->h2.response_caches[i]);
+		}
 	}
 	isc_mem_put(listener->worker->mctx, listener->h2.listener_endpoints,
 		    sizeof(isc_nm_http_endpoints_t *) *
 			    listener->h2.n_listener_endpoints);
+	isc_mem_put(listener->worker->mctx, listener->h2.response_caches,
+		    sizeof(isc__nm_http_rcache_t *) *
+			    listener->h2.n_listener_endpoints);
+	listener->h2.response_caches = NULL;
 	listener->h2.n_listener_endpoints = 0;
 }
 
@@ -3244,6 +3822,19 @@ isc__nm_http_cleanup_data(isc_nmsocket_t *sock) {
 			sock->h2.query_data = NULL;
 		}
 
+		if (sock->h2.cache_key != NULL) {
+			isc_mem_put(sock->worker->mctx, sock->h2.cache_key,
+				    sock->h2.cache_keylen);
+			sock->h2.cache_key = NULL;
+		}
+
+		if (sock->h2.cached_response != NULL) {
+			isc_mem_put(sock->worker->mctx,
+				    sock->h2.cached_response,
+				    sock->h2.cached_responselen);
+			sock->h2.cached_response = NULL;
+		}
+
 		INSIST(sock->h2.connect.cstream == NULL);
 
 		if (isc_buffer_base(&sock->h2.rbuf) != NULL) {
@@ -88,6 +88,12 @@ STATIC_ASSERT(ISC_NETMGR_TCP_RECVBUF_SIZE <= ISC_NETMGR_RECVBUF_SIZE,
 	      "TCP receive buffer size must be smaller or equal than worker "
 	      "receive buffer size");
 
+/*%
+ * The largest PROXYv2 header (including its TLVs) that is accepted
+ * at the start of a TCP, DoT or DoH connection.
+ */
+#define ISC_NETMGR_PROXY2_MAXSIZE 4096
+
 /*%
  * Regular TCP buffer size.
  */
@@ -101,6 +107,12 @@ STATIC_ASSERT(ISC_NETMGR_TCP_RECVBUF_SIZE <= ISC_NETMGR_RECVBUF_SIZE,
  */
 #define NM_BIG_BUF ISC_NETMGR_TCP_RECVBUF_SIZE * 2
 
+/*%
+ * Number of regular buffers released by idle connections that a worker
+ * keeps for the next connections to receive data.
+ */
+#define NM_DNSBUF_POOLSIZE 64
+
 /*%
  * Maximum segment size (MSS) of TCP socket on which the server responds to
  * queries. Value lower than common MSS on Ethernet (1220, that is 1280 (IPv6
@@ -193,6 +205,13 @@ isc__nm_dump_active(isc_nm_t *nm);
 
 typedef struct isc__nm_uvreq isc__nm_uvreq_t;
 typedef struct isc__netievent isc__netievent_t;
+#if HAVE_IO_URING
+typedef struct isc__nm_uring isc__nm_uring_t;
+#endif /* HAVE_IO_URING */
+#if HAVE_AF_XDP
+typedef struct isc__nm_xdp isc__nm_xdp_t;
+typedef struct isc__nm_xsk isc__nm_xsk_t;
+#endif /* HAVE_AF_XDP */
 
 /*
  * Single network event loop worker.
@@ -207,6 +226,32 @@ typedef struct isc__networker {
 	char *recvbuf;
 	char *sendbuf;
 	bool recvbuf_inuse;
+
+	/*
+	 * Regular TCPDNS buffers released by the connections of this
+	 * worker when they had no data left to process.
+	 */
+	unsigned char *dnsbufs[NM_DNSBUF_POOLSIZE];
+	unsigned int ndnsbufs;
+
+	/*
+	 * Outgoing UDP datagrams queued for a batched sendmmsg(2)
+	 * flush; see isc_nm_setudpsendbatching().
+	 */
+	ISC_LIST(isc__nm_uvreq_t) udpsendq;
+	size_t udpsendq_len;
+	uv_check_t udpsend_check;
+	uv_prepare_t udpsend_prepare;
+	bool udpsend_init;
+	bool udpsend_nogso;
+
+#if HAVE_IO_URING
+	isc__nm_uring_t *uring;
+	bool uring_failed;
+#endif /* HAVE_IO_URING */
+#if HAVE_AF_XDP
+	isc__nm_xsk_t *xsk;
+#endif /* HAVE_AF_XDP */
 } isc__networker_t;
 
 ISC_REFCOUNT_DECL(isc__networker);
@@ -241,6 +286,12 @@ struct isc_nmhandle {
 
 	isc_sockaddr_t peer;
 	isc_sockaddr_t local;
+	/*
+	 * If 'proxied' is set, 'peer' is a proxy that sent a PROXYv2
+	 * header with the address of the original client, 'proxysource'.
+	 */
+	bool proxied;
+	isc_sockaddr_t proxysource;
 	isc_nm_opaquecb_t doreset; /* reset extra callback, external */
 	isc_nm_opaquecb_t dofree;  /* free extra callback, external */
 #ifdef NETMGR_TRACE
@@ -698,6 +749,13 @@ struct isc_nm {
 	atomic_uint_fast32_t maxudp;
 
 	bool load_balance_sockets;
+	bool udp_send_batching;
+	bool io_uring;
+	bool kernel_tls;
+	char *xdp_interface;
+#if HAVE_AF_XDP
+	isc__nm_xdp_t *xdp;
+#endif /* HAVE_AF_XDP */
 
 	/*
 	 * Active connections are being closed and new connections are
@@ -756,12 +814,12 @@ typedef enum {
 } isc__nm_statid_t;
 
 #if HAVE_LIBNGHTTP2
+typedef ISC_LIST(isc__nm_uvreq_t) isc__nm_uvreq_list_t;
+
 typedef struct isc_nmsocket_tls_send_req {
 	isc_nmsocket_t *tlssock;
 	isc_region_t data;
-	isc_nm_cb_t cb;
-	void *cbarg;
-	isc_nmhandle_t *handle;
+	isc__nm_uvreq_list_t reqs; /*%< sends completed by this write */
 	bool finish;
 	uint8_t smallbuf[512];
 } isc_nmsocket_tls_send_req_t;
@@ -802,6 +860,8 @@ struct isc_nm_http_endpoints {
 	atomic_bool in_use;
 };
 
+typedef struct isc__nm_http_rcache isc__nm_http_rcache_t;
+
 typedef struct isc_nmsocket_h2 {
 	isc_nmsocket_t *psock; /* owner of the structure */
 	char *request_path;
@@ -820,6 +880,10 @@ typedef struct isc_nmsocket_h2 {
 
 	/* maximum concurrent streams (server-side) */
 	atomic_uint_fast32_t max_concurrent_streams;
+	/* HTTP/2 settings announced to clients; 0 means the default */
+	atomic_uint_fast32_t initial_window_size;
+	atomic_uint_fast32_t max_frame_size;
+	atomic_uint_fast32_t header_table_size;
 
 	uint32_t min_ttl; /* used to set "max-age" in responses */
 
@@ -830,6 +894,7 @@ typedef struct isc_nmsocket_h2 {
 	char clenbuf[128];
 
 	char cache_control_buf[128];
+	char agebuf[16];
 
 	int headers_error_code;
 	size_t headers_data_processed;
@@ -841,6 +906,14 @@ typedef struct isc_nmsocket_h2 {
 	isc_nm_http_endpoints_t **listener_endpoints;
 	size_t n_listener_endpoints;
 
+	/* DoH GET response cache: per worker on listeners */
+	atomic_uint_fast32_t response_cache_size;
+	isc__nm_http_rcache_t **response_caches;
+	unsigned char *cache_key;
+	size_t cache_keylen;
+	unsigned char *cached_response;
+	size_t cached_responselen;
+
 	bool response_submitted;
 	struct {
 		char *uri;
@@ -900,6 +973,10 @@ struct isc_nmsocket {
 		/* List of active send requests. */
 		isc__nm_uvreq_t *pending_req;
 		bool alpn_negotiated;
+		/* Kernel TLS offload: still trying, enabled directions */
+		bool ktls;
+		bool ktls_tx;
+		bool ktls_rx;
 	} tls;
 
 #if HAVE_LIBNGHTTP2
@@ -926,6 +1003,9 @@ struct isc_nmsocket {
 		} state; /*%< The order of these is significant */
 		size_t nsending;
 		bool reading;
+		/*%< Sends waiting to be encrypted together */
+		isc__nm_uvreq_list_t sendq;
+		bool sendq_scheduled;
 	} tlsstream;
 
 	isc_nmsocket_h2_t h2;
@@ -1026,12 +1106,43 @@ struct isc_nmsocket {
 	 */
 	atomic_bool readpaused;
 
+#if HAVE_IO_URING
+	/*%
+	 * A UDP listener socket is receiving through the io_uring engine
+	 * instead of uv_udp_recv_start().
+	 */
+	bool uring_reading;
+#endif /* HAVE_IO_URING */
+
+#if HAVE_AF_XDP
+	/*%
+	 * A UDP listener socket is also receiving through the AF_XDP
+	 * socket of its worker.
+	 */
+	bool xdp_reading;
+#endif /* HAVE_AF_XDP */
+
 	/*%
 	 * A TCP or TCPDNS socket has been set to use the keepalive
 	 * timeout instead of the default idle timeout.
 	 */
 	atomic_bool keepalive;
 
+	/*%
+	 * PROXYv2: a listener with 'proxy' set expects every datagram
+	 * or connection to start with a PROXYv2 header.  An accepted
+	 * connection waits for the header while 'proxy2_pending' is
+	 * set, keeping a partial header in 'proxy2_buf'; once it has
+	 * been received, 'proxied' is set if it carried the address of
+	 * the original client, which is then kept in 'proxysource'.
+	 * 'peer' remains the address of the proxy itself.
+	 */
+	atomic_bool proxy;
+	bool proxy2_pending;
+	bool proxied;
+	isc_sockaddr_t proxysource;
+	isc_buffer_t *proxy2_buf;
+
 	/*%
 	 * 'spare' handles for that can be reused to avoid allocations,
 	 * for UDP.
@@ -1049,8 +1160,13 @@ struct isc_nmsocket {
 	 */
 	atomic_int_fast32_t ah;
 
-	/*% Buffer for TCPDNS processing */
+	/*%
+	 * Buffer for TCPDNS processing; 'buf_len' bytes of unprocessed
+	 * data start at offset 'buf_pos'.  The buffer is only held while
+	 * there is unprocessed data, so idle connections don't keep one.
+	 */
 	size_t buf_size;
+	size_t buf_pos;
 	size_t buf_len;
 	unsigned char *buf;
 
@@ -1270,6 +1386,115 @@ isc__nm_udp_send(isc_nmhandle_t *handle, const isc_region_t *region,
  * Back-end implementation of isc_nm_send() for UDP handles.
  */
 
+void
+isc__nm_udp_sendq_flush(isc__networker_t *worker);
+/*%<
+ * Send all UDP datagrams queued on 'worker' by isc__nm_udp_send() when
+ * UDP send batching is enabled, using as few sendmmsg(2) calls as
+ * possible.  Callbacks for the queued sends are called before this
+ * function returns, except for datagrams that had to be handed over to
+ * libuv because the socket send buffer was full.
+ */
+
+void
+isc__nm_udp_sendq_shutdown(isc__networker_t *worker);
+/*%<
+ * Flush the UDP send queue of 'worker' for the last time and close the
+ * libuv handles used to schedule the batched sends.
+ */
+
+void
+isc__nm_udp_recv(isc_nmsocket_t *sock, isc_result_t result, uint8_t *base,
+		 size_t len, const struct sockaddr *addr);
+/*%<
+ * Process a datagram of 'len' bytes at 'base' received from 'addr' on
+ * the UDP socket 'sock', or a receive error if 'result' is not
+ * ISC_R_SUCCESS.  This is shared by the libuv receive callback and the
+ * io_uring engine.
+ */
+
+#if HAVE_IO_URING
+void
+isc__nm_udp_uring_fallback(isc_nmsocket_t *sock);
+/*%<
+ * Restart reading on the UDP listener socket 'sock' with
+ * uv_udp_recv_start() after the io_uring engine stopped receiving on it
+ * for a reason other than isc__nm_uring_udp_recv_stop().
+ */
+
+isc_result_t
+isc__nm_uring_udp_recv_start(isc_nmsocket_t *sock);
+/*%<
+ * Start receiving datagrams on the UDP listener socket 'sock' using a
+ * multishot recvmsg request on the io_uring instance of its worker,
+ * creating the instance if needed.  Returns ISC_R_NOTIMPLEMENTED if
+ * io_uring can not be used on this worker; the caller is then expected
+ * to fall back to uv_udp_recv_start().
+ */
+
+void
+isc__nm_uring_udp_recv_stop(isc_nmsocket_t *sock);
+/*%<
+ * Cancel the io_uring receive request on 'sock'.
+ */
+
+void
+isc__nm_uring_shutdown(isc__networker_t *worker);
+/*%<
+ * Tear down the io_uring instance of 'worker' once all outstanding
+ * requests have completed.
+ */
+#endif /* HAVE_IO_URING */
+
+#if HAVE_AF_XDP
+isc_result_t
+isc__nm_xdp_attach(isc_nm_t *mgr, const char *ifname);
+/*%<
+ * Attach the XDP program redirecting the queries for the UDP listeners
+ * to the interface 'ifname', and create an AF_XDP socket for each
+ * worker, bound to the receive queue with the same number.  This must
+ * be called before the server drops its privileges.
+ */
+
+void
+isc__nm_xdp_detach(isc_nm_t *mgr);
+/*%<
+ * Detach the XDP program from the interface and release the maps.
+ */
+
+isc_result_t
+isc__nm_xdp_udp_recv_start(isc_nmsocket_t *sock);
+/*%<
+ * Start receiving the datagrams for the UDP listener socket 'sock' from
+ * the AF_XDP socket of its worker.  The socket keeps receiving through
+ * libuv as well.  Returns ISC_R_NOTIMPLEMENTED if there is no AF_XDP
+ * socket on this worker or if 'sock' is bound to a wildcard address.
+ */
+
+void
+isc__nm_xdp_udp_recv_stop(isc_nmsocket_t *sock);
+/*%<
+ * Stop receiving datagrams for 'sock' from the AF_XDP socket.
+ */
+
+isc_result_t
+isc__nm_xdp_udp_send(isc_nmsocket_t *sock, const isc_sockaddr_t *peer,
+		     const isc_region_t *region);
+/*%<
+ * Copy 'region' into a UMEM frame and queue it for sending to 'peer'
+ * on the AF_XDP socket of the worker of 'sock'.  Returns ISC_R_NOTFOUND
+ * if no query has been received from 'peer' on this worker, and
+ * ISC_R_NORESOURCES if there is no free frame; the caller is expected
+ * to send the datagram through the regular socket then.
+ */
+
+void
+isc__nm_xdp_shutdown(isc__networker_t *worker);
+/*%<
+ * Close the AF_XDP socket of 'worker' once no listener uses it.
+ */
+#endif /* HAVE_AF_XDP */
+
 void
 isc__nm_udp_read(isc_nmhandle_t *handle, isc_nm_recv_cb_t cb, void *cbarg);
 /*
@@ -1769,9 +1994,12 @@ isc__nm_socket_reuse_lb(uv_os_sock_t fd);
  */
 
 isc_result_t
-isc__nm_socket_incoming_cpu(uv_os_sock_t fd);
+isc__nm_socket_incoming_cpu(uv_os_sock_t fd, int cpu);
 /*%<
- * Set the SO_INCOMING_CPU socket option on the fd if available
+ * Set the SO_INCOMING_CPU socket option on the fd to 'cpu' if available,
+ * so that the kernel prefers this socket of a load-balanced group for
+ * packets processed on that CPU.  Nothing is done if 'cpu' is negative,
+ * i.e. the loop using the socket is not pinned to a CPU.
  */
 
 isc_result_t
@@ -1800,6 +2028,15 @@ isc__nm_socket_tcp_nodelay(uv_os_sock_t fd);
  * Disables Nagle's algorithm on a TCP socket (sets TCP_NODELAY).
  */
 
+isc_result_t
+isc__nm_socket_tcp_fastopen_connect(uv_os_sock_t fd);
+/*%<
+ * Enable TCP Fast Open on an outgoing TCP socket (sets
+ * TCP_FASTOPEN_CONNECT), so that the first write after connecting is
+ * sent with the SYN when the kernel holds a cookie for the server.
+ * This is a no-op unless TCP Fast Open was enabled at configure time.
+ */
+
 isc_result_t
 isc__nm_socket_tcp_maxseg(uv_os_sock_t fd, int size);
 /*%<
@@ -1984,6 +2221,47 @@ isc__nm_closing(isc__networker_t *worker);
 void
 isc__nm_alloc_dnsbuf(isc_nmsocket_t *sock, size_t len);
 
+void
+isc__nm_free_dnsbuf(isc_nmsocket_t *sock);
+/*%<
+ * Release the TCPDNS buffer of 'sock', which must not hold unprocessed
+ * data, to the pool of the worker if it has the regular size and the
+ * pool has room, or else to the memory context.
+ */
+
+unsigned char *
+isc__nm_reserve_dnsbuf(isc_nmsocket_t *sock, size_t len);
+/*%<
+ * Make room for 'len' more bytes after the unprocessed data in the
+ * TCPDNS buffer, moving the data to the start of the buffer or
+ * growing it as needed, and return a pointer to where they go.
+ */
+
+void
+isc__nm_consume_dnsbuf(isc_nmsocket_t *sock, size_t len);
+/*%<
+ * Mark 'len' bytes at the start of the unprocessed data in the
+ * TCPDNS buffer as processed, releasing the buffer when no unprocessed
+ * data is left.
+ */
+
+isc_result_t
+isc__nm_proxy2_read(isc_nmsocket_t *sock, isc_region_t *region);
+/*%<
+ * Read the PROXYv2 header of the connection 'sock' from the start of
+ * the received data in 'region'.  On success, 'region' is advanced
+ * past the end of the header (the rest of it is the data that followed
+ * the header, if any) and the source address of the header is set on
+ * 'sock' and its static handle.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS	The header is complete
+ *\li	#ISC_R_NOMORE	All of 'region' has been buffered as a part of
+ *			the header; wait for more data
+ *\li	other		The connection does not start with a valid
+ *			PROXYv2 header and should be closed
+ */
+
 void
 isc__nm_failed_send_cb(isc_nmsocket_t *sock, isc__nm_uvreq_t *req,
 		       isc_result_t eresult);
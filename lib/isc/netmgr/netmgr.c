@@ -29,6 +29,8 @@
 #include <isc/mem.h>
 #include <isc/netmgr.h>
 #include <isc/print.h>
+#include <isc/probes.h>
+#include <isc/proxy2.h>
 #include <isc/quota.h>
 #include <isc/random.h>
 #include <isc/refcount.h>
@@ -134,6 +136,8 @@ static void
 nmsocket_maybe_destroy(isc_nmsocket_t *sock FLARG);
 static void
 nmhandle_free(isc_nmsocket_t *sock, isc_nmhandle_t *handle);
+static void
+dnsbuf_account(isc_nmsocket_t *sock, size_t size, bool add);
 
 static void
 process_netievent(void *arg);
@@ -165,6 +169,14 @@ networker_teardown(void *arg) {
 
 	uv_walk(&loop->loop, shutdown_walk_cb, NULL);
 
+	isc__nm_udp_sendq_shutdown(worker);
+#if HAVE_IO_URING
+	isc__nm_uring_shutdown(worker);
+#endif /* HAVE_IO_URING */
+#if HAVE_AF_XDP
+	isc__nm_xdp_shutdown(worker);
+#endif /* HAVE_AF_XDP */
+
 	isc__networker_detach(&worker);
 }
 
@@ -287,6 +299,13 @@ nm_destroy(isc_nm_t **mgr0) {
 		isc_stats_detach(&mgr->stats);
 	}
 
+#if HAVE_AF_XDP
+	isc__nm_xdp_detach(mgr);
+#endif /* HAVE_AF_XDP */
+	if (mgr->xdp_interface != NULL) {
+		isc_mem_free(mgr->mctx, mgr->xdp_interface);
+	}
+
 	isc_mutex_destroy(&mgr->lock);
 
 	isc_mem_put(mgr->mctx, mgr->workers,
@@ -403,6 +422,87 @@ isc_nm_setloadbalancesockets(isc_nm_t *mgr, bool enabled) {
 #endif
 }
 
+bool
+isc_nm_getudpsendbatching(isc_nm_t *mgr) {
+	REQUIRE(VALID_NM(mgr));
+
+	return (mgr->udp_send_batching);
+}
+
+void
+isc_nm_setudpsendbatching(isc_nm_t *mgr, bool enabled) {
+	REQUIRE(VALID_NM(mgr));
+
+#if HAVE_SENDMMSG
+	mgr->udp_send_batching = enabled;
+#else
+	UNUSED(enabled);
+#endif
+}
+
+bool
+isc_nm_getiouring(isc_nm_t *mgr) {
+	REQUIRE(VALID_NM(mgr));
+
+	return (mgr->io_uring);
+}
+
+void
+isc_nm_setiouring(isc_nm_t *mgr, bool enabled) {
+	REQUIRE(VALID_NM(mgr));
+
+#if HAVE_IO_URING
+	mgr->io_uring = enabled;
+#else
+	UNUSED(enabled);
+#endif
+}
+
+const char *
+isc_nm_getxdp(isc_nm_t *mgr) {
+	REQUIRE(VALID_NM(mgr));
+
+	return (mgr->xdp_interface);
+}
+
+isc_result_t
+isc_nm_setxdp(isc_nm_t *mgr, const char *ifname) {
+	REQUIRE(VALID_NM(mgr));
+	REQUIRE(ifname != NULL);
+	REQUIRE(mgr->xdp_interface == NULL);
+
+	mgr->xdp_interface = isc_mem_strdup(mgr->mctx, ifname);
+
+#if HAVE_AF_XDP
+	return (isc__nm_xdp_attach(mgr, ifname));
+#else
+	return (ISC_R_NOTIMPLEMENTED);
+#endif
+}
+
+bool
+isc_nm_getkerneltls(isc_nm_t *mgr) {
+	REQUIRE(VALID_NM(mgr));
+
+	return (mgr->kernel_tls);
+}
+
+void
+isc_nm_setkerneltls(isc_nm_t *mgr, bool enabled) {
+	REQUIRE(VALID_NM(mgr));
+
+	if (isc_tls_ktls_supported()) {
+		mgr->kernel_tls = enabled;
+	}
+}
+
+uint32_t
+isc_nm_getnloops(isc_nm_t *mgr) {
+	REQUIRE(VALID_NM(mgr));
+
+	return (mgr->nloops);
+}
+
 void
 isc_nm_gettimeouts(isc_nm_t *mgr, uint32_t *initial, uint32_t *idle,
 		   uint32_t *keepalive, uint32_t *advertised) {
@@ -707,9 +807,14 @@ nmsocket_cleanup(isc_nmsocket_t *sock, bool dofree FLARG) {
 	}
 
 	if (sock->buf != NULL) {
+		dnsbuf_account(sock, sock->buf_size, false);
 		isc_mem_put(sock->worker->mctx, sock->buf, sock->buf_size);
 	}
 
+	if (sock->proxy2_buf != NULL) {
+		isc_buffer_free(&sock->proxy2_buf);
+	}
+
 	if (sock->quota != NULL) {
 		isc_quota_detach(&sock->quota);
 	}
@@ -1010,6 +1115,7 @@ isc___nmsocket_init(isc_nmsocket_t *sock, isc__networker_t *worker,
 	atomic_init(&sock->client, 0);
 	atomic_init(&sock->connecting, false);
 	atomic_init(&sock->keepalive, false);
+	atomic_init(&sock->proxy, false);
 	atomic_init(&sock->connected, false);
 	atomic_init(&sock->timedout, false);
 
@@ -1098,6 +1204,11 @@ isc___nmhandle_get(isc_nmsocket_t *sock, isc_sockaddr_t *peer,
 		handle->local = sock->iface;
 	}
 
+	handle->proxied = sock->proxied;
+	if (sock->proxied) {
+		handle->proxysource = sock->proxysource;
+	}
+
 	(void)atomic_fetch_add(&sock->ah, 1);
 
 #ifdef NETMGR_TRACE
@@ -1306,23 +1417,206 @@ isc_nmhandle_setdata(isc_nmhandle_t *handle, void *arg,
 	handle->dofree = dofree;
 }
 
+/*
+ * Count the memory held by the TCPDNS buffers of DNS over TCP and DNS
+ * over TLS connections.
+ */
+static void
+dnsbuf_account(isc_nmsocket_t *sock, size_t size, bool add) {
+	isc_stats_t *stats = sock->worker->netmgr->stats;
+	isc_statscounter_t counter;
+
+	switch (sock->type) {
+	case isc_nm_tcpdnssocket:
+		counter = isc_sockstatscounter_tcpdnsbufbytes;
+		break;
+	case isc_nm_tlsdnssocket:
+		counter = isc_sockstatscounter_tlsdnsbufbytes;
+		break;
+	default:
+		return;
+	}
+
+	if (stats != NULL) {
+		isc_stats_add(stats, counter, add ? size : -(uint64_t)size);
+	}
+}
+
 void
 isc__nm_alloc_dnsbuf(isc_nmsocket_t *sock, size_t len) {
+	isc__networker_t *worker = sock->worker;
+
 	REQUIRE(len <= NM_BIG_BUF);
 
 	if (sock->buf == NULL) {
 		/* We don't have the buffer at all */
 		size_t alloc_len = len < NM_REG_BUF ? NM_REG_BUF : NM_BIG_BUF;
-		sock->buf = isc_mem_get(sock->worker->mctx, alloc_len);
+		if (alloc_len == NM_REG_BUF && worker->ndnsbufs > 0) {
+			sock->buf = worker->dnsbufs[--worker->ndnsbufs];
+		} else {
+			sock->buf = isc_mem_get(worker->mctx, alloc_len);
+		}
 		sock->buf_size = alloc_len;
+		dnsbuf_account(sock, alloc_len, true);
 	} else {
 		/* We have the buffer but it's too small */
-		sock->buf = isc_mem_reget(sock->worker->mctx, sock->buf,
+		dnsbuf_account(sock, NM_BIG_BUF - sock->buf_size, true);
+		sock->buf = isc_mem_reget(worker->mctx, sock->buf,
 					  sock->buf_size, NM_BIG_BUF);
 		sock->buf_size = NM_BIG_BUF;
 	}
 }
 
+void
+isc__nm_free_dnsbuf(isc_nmsocket_t *sock) {
+	isc__networker_t *worker = sock->worker;
+
+	REQUIRE(sock->tid == isc_tid());
+	REQUIRE(sock->buf_len == 0);
+
+	if (sock->buf == NULL) {
+		return;
+	}
+
+	dnsbuf_account(sock, sock->buf_size, false);
+	if (sock->buf_size == NM_REG_BUF &&
+	    worker->ndnsbufs < NM_DNSBUF_POOLSIZE)
+	{
+		worker->dnsbufs[worker->ndnsbufs++] = sock->buf;
+	} else {
+		isc_mem_put(worker->mctx, sock->buf, sock->buf_size);
+	}
+	sock->buf = NULL;
+	sock->buf_size = 0;
+	sock->buf_pos = 0;
+}
+
+unsigned char *
+isc__nm_reserve_dnsbuf(isc_nmsocket_t *sock, size_t len) {
+	if (sock->buf_pos + sock->buf_len + len > sock->buf_size) {
+		/*
+		 * Pipelined messages are consumed in place, so the
+		 * leftover data is only moved when the tail of the
+		 * buffer runs out.
+		 */
+		if (sock->buf_pos > 0 && sock->buf_len > 0) {
+			memmove(sock->buf, sock->buf + sock->buf_pos,
+				sock->buf_len);
+		}
+		sock->buf_pos = 0;
+
+		if (sock->buf_len + len > sock->buf_size) {
+			isc__nm_alloc_dnsbuf(sock, sock->buf_len + len);
+		}
+	}
+
+	return (sock->buf + sock->buf_pos + sock->buf_len);
+}
+
+void
+isc__nm_consume_dnsbuf(isc_nmsocket_t *sock, size_t len) {
+	REQUIRE(len <= sock->buf_len);
+
+	sock->buf_len -= len;
+	if (sock->buf_len == 0) {
+		isc__nm_free_dnsbuf(sock);
+	} else {
+		sock->buf_pos += len;
+	}
+}
+
+static void
+proxy2_log_failure(isc_nmsocket_t *sock, isc_result_t result) {
+	const int log_level = ISC_LOG_DEBUG(1);
+	char peer_sabuf[ISC_SOCKADDR_FORMATSIZE];
+
+	if (!isc_log_wouldlog(isc_lctx, log_level)) {
+		return;
+	}
+
+	isc_sockaddr_format(&sock->peer, peer_sabuf, sizeof(peer_sabuf));
+	isc_log_write(isc_lctx, ISC_LOGCATEGORY_GENERAL, ISC_LOGMODULE_NETMGR,
+		      log_level, "invalid PROXYv2 header from %s: %s",
+		      peer_sabuf, isc_result_totext(result));
+}
+
+static void
+proxy2_apply(isc_nmsocket_t *sock, const isc_proxy2_t *proxy) {
+	sock->proxy2_pending = false;
+
+	if (!proxy->addresses) {
+		/* LOCAL command: the connection is from the proxy itself */
+		return;
+	}
+
+	sock->proxied = true;
+	sock->proxysource = proxy->source;
+
+	if (sock->statichandle != NULL) {
+		sock->statichandle->proxied = true;
+		sock->statichandle->proxysource = proxy->source;
+	}
+}
+
+isc_result_t
+isc__nm_proxy2_read(isc_nmsocket_t *sock, isc_region_t *region) {
+	isc_result_t result;
+	isc_proxy2_t proxy;
+	isc_region_t header;
+	size_t buffered = 0;
+
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(sock->tid == isc_tid());
+	REQUIRE(sock->proxy2_pending);
+	REQUIRE(region != NULL);
+
+	if (sock->proxy2_buf == NULL) {
+		/* The whole header usually arrives in the first segment */
+		result = isc_proxy2_parse(region, &proxy);
+		if (result == ISC_R_SUCCESS) {
+			isc_region_consume(region, proxy.length);
+			proxy2_apply(sock, &proxy);
+			return (ISC_R_SUCCESS);
+		}
+		if (result != ISC_R_NOMORE) {
+			goto fail;
+		}
+
+		isc_buffer_allocate(sock->worker->mctx, &sock->proxy2_buf,
+				    ISC_NETMGR_PROXY2_MAXSIZE);
+	}
+
+	buffered = isc_buffer_usedlength(sock->proxy2_buf);
+	isc_buffer_putmem(
+		sock->proxy2_buf, region->base,
+		ISC_MIN(region->length,
+			isc_buffer_availablelength(sock->proxy2_buf)));
+
+	isc_buffer_usedregion(sock->proxy2_buf, &header);
+	result = isc_proxy2_parse(&header, &proxy);
+	switch (result) {
+	case ISC_R_SUCCESS:
+		isc_region_consume(region, proxy.length - buffered);
+		isc_buffer_free(&sock->proxy2_buf);
+		proxy2_apply(sock, &proxy);
+		return (ISC_R_SUCCESS);
+	case ISC_R_NOMORE:
+		if (isc_buffer_availablelength(sock->proxy2_buf) == 0) {
+			result = ISC_R_RANGE;
+			break;
+		}
+		isc_region_consume(region, region->length);
+		return (ISC_R_NOMORE);
+	default:
+		break;
+	}
+
+fail:
+	isc__nm_incstats(sock, STATID_RECVFAIL);
+	proxy2_log_failure(sock, result);
+	return (result);
+}
+
 void
 isc__nm_failed_send_cb(isc_nmsocket_t *sock, isc__nm_uvreq_t *req,
 		       isc_result_t eresult) {
@@ -1775,7 +2069,9 @@ isc__nm_process_sock_buffer(isc_nmsocket_t *sock) {
 			}
 			break;
 		default:
-			UNREACHABLE();
+			/* The connection didn't start with a PROXYv2 header */
+			isc__nmsocket_timer_stop(sock);
+			return (result);
 		}
 	}
 done:
@@ -1889,6 +2185,24 @@ isc_sockaddr_t
 isc_nmhandle_peeraddr(isc_nmhandle_t *handle) {
 	REQUIRE(VALID_NMHANDLE(handle));
 
+	if (handle->proxied) {
+		return (handle->proxysource);
+	}
+
+	return (handle->peer);
+}
+
+bool
+isc_nmhandle_isproxied(isc_nmhandle_t *handle) {
+	REQUIRE(VALID_NMHANDLE(handle));
+
+	return (handle->proxied);
+}
+
+isc_sockaddr_t
+isc_nmhandle_proxyaddr(isc_nmhandle_t *handle) {
+	REQUIRE(VALID_NMHANDLE(handle));
+
 	return (handle->peer);
 }
 
@@ -1979,6 +2293,8 @@ isc_nm_send(isc_nmhandle_t *handle, isc_region_t *region, isc_nm_cb_t cb,
 	    void *cbarg) {
 	REQUIRE(VALID_NMHANDLE(handle));
 
+	ISC_PROBE2(libisc, send, handle->sock, region->length);
+
 	switch (handle->sock->type) {
 	case isc_nm_udpsocket:
 	case isc_nm_udplistener:
@@ -2214,6 +2530,7 @@ isc__nm_async_readcb(isc__networker_t *worker, isc__netievent_t *ev0) {
 	region.base = (unsigned char *)uvreq->uvbuf.base;
 	region.length = uvreq->uvbuf.len;
 
+	ISC_PROBE3(libisc, recv, sock, region.length, eresult);
 	uvreq->cb.recv(uvreq->handle, eresult, &region, uvreq->cbarg);
 
 	isc__nm_uvreq_put(&uvreq, sock);
@@ -2253,6 +2570,7 @@ isc__nm_async_sendcb(isc__networker_t *worker, isc__netievent_t *ev0) {
 	REQUIRE(VALID_NMHANDLE(uvreq->handle));
 	REQUIRE(sock->tid == isc_tid());
 
+	ISC_PROBE2(libisc, send_done, sock, eresult);
 	uvreq->cb.send(uvreq->handle, eresult, uvreq->cbarg);
 
 	isc__nm_uvreq_put(&uvreq, sock);
@@ -2719,6 +3037,36 @@ isc_nmsocket_set_tlsctx(isc_nmsocket_t *listener, isc_tlsctx_t *tlsctx) {
 	};
 }
 
+void
+isc_nmsocket_set_proxy(isc_nmsocket_t *listener, bool enabled) {
+	REQUIRE(VALID_NMSOCK(listener));
+
+	switch (listener->type) {
+#if HAVE_LIBNGHTTP2
+	case isc_nm_httplistener:
+	case isc_nm_tlslistener:
+		/*
+		 * The PROXYv2 header precedes the TLS handshake and the
+		 * HTTP/2 session, so it's read by the underlying socket.
+		 */
+		isc_nmsocket_set_proxy(listener->outer, enabled);
+		return;
+#endif /* HAVE_LIBNGHTTP2 */
+	case isc_nm_udplistener:
+	case isc_nm_tcplistener:
+	case isc_nm_tcpdnslistener:
+	case isc_nm_tlsdnslistener:
+		break;
+	default:
+		UNREACHABLE();
+	}
+
+	atomic_store(&listener->proxy, enabled);
+	for (size_t i = 0; i < listener->nchildren; i++) {
+		atomic_store(&listener->children[i].proxy, enabled);
+	}
+}
+
 void
 isc_nmsocket_set_max_streams(isc_nmsocket_t *listener,
 			     const uint32_t max_streams) {
@@ -2769,6 +3117,10 @@ isc__networker_destroy(isc__networker_t *worker) {
 
 	isc_loop_detach(&worker->loop);
 
+	while (worker->ndnsbufs > 0) {
+		isc_mem_put(worker->mctx, worker->dnsbufs[--worker->ndnsbufs],
+			    NM_REG_BUF);
+	}
 	isc_mem_put(worker->mctx, worker->sendbuf, ISC_NETMGR_SENDBUF_SIZE);
 	isc_mem_putanddetach(&worker->mctx, worker->recvbuf,
 			     ISC_NETMGR_RECVBUF_SIZE);
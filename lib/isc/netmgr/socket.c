@@ -222,15 +222,21 @@ isc__nm_socket_reuse_lb(uv_os_sock_t fd) {
 }
 
 isc_result_t
-isc__nm_socket_incoming_cpu(uv_os_sock_t fd) {
+isc__nm_socket_incoming_cpu(uv_os_sock_t fd, int cpu) {
 #ifdef SO_INCOMING_CPU
-	if (setsockopt_on(fd, SOL_SOCKET, SO_INCOMING_CPU) == -1) {
+	if (cpu < 0) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+	if (setsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)) ==
+	    -1)
+	{
 		return (ISC_R_FAILURE);
 	} else {
 		return (ISC_R_SUCCESS);
 	}
 #else
 	UNUSED(fd);
+	UNUSED(cpu);
 #endif
 	return (ISC_R_NOTIMPLEMENTED);
 }
@@ -340,6 +346,20 @@ isc__nm_socket_tcp_nodelay(uv_os_sock_t fd) {
 #endif
 }
 
+isc_result_t
+isc__nm_socket_tcp_fastopen_connect(uv_os_sock_t fd) {
+#if defined(ENABLE_TCP_FASTOPEN) && defined(TCP_FASTOPEN_CONNECT)
+	if (setsockopt_on(fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT) == -1) {
+		return (ISC_R_FAILURE);
+	} else {
+		return (ISC_R_SUCCESS);
+	}
+#else
+	UNUSED(fd);
+	return (ISC_R_SUCCESS);
+#endif
+}
+
 isc_result_t
 isc__nm_socket_tcp_maxseg(uv_os_sock_t fd, int size) {
 #ifdef TCP_MAXSEG
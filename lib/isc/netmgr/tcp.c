@@ -332,6 +332,7 @@ isc_nm_tcpconnect(isc_nm_t *mgr, isc_sockaddr_t *local, isc_sockaddr_t *peer,
 
 	(void)isc__nm_socket_min_mtu(sock->fd, sa_family);
 	(void)isc__nm_socket_tcp_maxseg(sock->fd, NM_MAXSEG);
+	(void)isc__nm_socket_tcp_fastopen_connect(sock->fd);
 
 	ievent = isc__nm_get_netievent_tcpconnect(worker, sock, req);
 
@@ -351,7 +352,6 @@ isc__nm_tcp_lb_socket(isc_nm_t *mgr, sa_family_t sa_family) {
 	result = isc__nm_socket(sa_family, SOCK_STREAM, 0, &sock);
 	RUNTIME_CHECK(result == ISC_R_SUCCESS);
 
-	(void)isc__nm_socket_incoming_cpu(sock);
 	(void)isc__nm_socket_v6only(sock, sa_family);
 
 	/* FIXME: set mss */
@@ -391,6 +391,8 @@ start_tcp_child(isc_nm_t *mgr, isc_sockaddr_t *iface, isc_nmsocket_t *sock,
 		UNUSED(fd);
 		csock->fd = isc__nm_tcp_lb_socket(mgr,
 						  iface->type.sa.sa_family);
+		(void)isc__nm_socket_incoming_cpu(csock->fd,
+						    worker->loop->cpu);
 	} else {
 		csock->fd = dup(fd);
 	}
@@ -855,6 +857,7 @@ isc__nm_tcp_read_cb(uv_stream_t *stream, ssize_t nread, const uv_buf_t *buf) {
 	isc_nmsocket_t *sock = uv_handle_get_data((uv_handle_t *)stream);
 	isc__nm_uvreq_t *req = NULL;
 	isc_nm_t *netmgr = NULL;
+	isc_region_t region;
 
 	REQUIRE(VALID_NMSOCK(sock));
 	REQUIRE(sock->tid == isc_tid());
@@ -878,6 +881,21 @@ isc__nm_tcp_read_cb(uv_stream_t *stream, ssize_t nread, const uv_buf_t *buf) {
 		goto free;
 	}
 
+	region = (isc_region_t){ .base = (unsigned char *)buf->base,
+				 .length = nread };
+
+	if (sock->proxy2_pending) {
+		isc_result_t result = isc__nm_proxy2_read(sock, &region);
+		if (result != ISC_R_SUCCESS && result != ISC_R_NOMORE) {
+			isc__nm_tcp_failed_read_cb(sock, result);
+			goto free;
+		}
+		if (region.length == 0) {
+			/* Nothing but (a part of) the PROXYv2 header */
+			goto free;
+		}
+	}
+
 	req = isc__nm_get_read_req(sock, NULL);
 
 	/*
@@ -885,8 +903,8 @@ isc__nm_tcp_read_cb(uv_stream_t *stream, ssize_t nread, const uv_buf_t *buf) {
 	 * result is ISC_R_SUCCESS, so we don't need to retain
 	 * the buffer
 	 */
-	req->uvbuf.base = buf->base;
-	req->uvbuf.len = nread;
+	req->uvbuf.base = (char *)region.base;
+	req->uvbuf.len = region.length;
 
 	if (!atomic_load(&sock->client)) {
 		sock->read_timeout = (atomic_load(&sock->keepalive)
@@ -976,6 +994,7 @@ accept_connection(isc_nmsocket_t *ssock, isc_quota_t *quota) {
 	csock->recv_cb = ssock->recv_cb;
 	csock->recv_cbarg = ssock->recv_cbarg;
 	csock->quota = quota;
+	csock->proxy2_pending = atomic_load(&ssock->proxy);
 	atomic_init(&csock->accepting, true);
 
 	worker = csock->worker;
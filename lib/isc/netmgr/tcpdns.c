@@ -287,6 +287,7 @@ isc_nm_tcpdnsconnect(isc_nm_t *mgr, isc_sockaddr_t *local, isc_sockaddr_t *peer,
 
 	(void)isc__nm_socket_min_mtu(sock->fd, sa_family);
 	(void)isc__nm_socket_tcp_maxseg(sock->fd, NM_MAXSEG);
+	(void)isc__nm_socket_tcp_fastopen_connect(sock->fd);
 
 	/* 2 minute timeout */
 	result = isc__nm_socket_connectiontimeout(sock->fd, 120 * 1000);
@@ -309,7 +310,6 @@ isc__nm_tcpdns_lb_socket(isc_nm_t *mgr, sa_family_t sa_family) {
 	result = isc__nm_socket(sa_family, SOCK_STREAM, 0, &sock);
 	RUNTIME_CHECK(result == ISC_R_SUCCESS);
 
-	(void)isc__nm_socket_incoming_cpu(sock);
 	(void)isc__nm_socket_v6only(sock, sa_family);
 
 	/* FIXME: set mss */
@@ -350,6 +350,8 @@ start_tcpdns_child(isc_nm_t *mgr, isc_sockaddr_t *iface, isc_nmsocket_t *sock,
 		REQUIRE(fd == -1);
 		csock->fd = isc__nm_tcpdns_lb_socket(mgr,
 						     iface->type.sa.sa_family);
+		(void)isc__nm_socket_incoming_cpu(csock->fd,
+						    worker->loop->cpu);
 	} else {
 		csock->fd = dup(fd);
 	}
@@ -765,6 +767,20 @@ isc__nm_tcpdns_processbuffer(isc_nmsocket_t *sock) {
 		return (ISC_R_CANCELED);
 	}
 
+	/*
+	 * The connection starts with the PROXYv2 header.
+	 */
+	if (sock->proxy2_pending && sock->buf_len > 0) {
+		isc_region_t region = { .base = sock->buf + sock->buf_pos,
+					.length = sock->buf_len };
+		isc_result_t result = isc__nm_proxy2_read(sock, &region);
+
+		isc__nm_consume_dnsbuf(sock, sock->buf_len - region.length);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
+
 	/*
 	 * If we don't even have the length yet, we can't do
 	 * anything.
@@ -777,7 +793,7 @@ isc__nm_tcpdns_processbuffer(isc_nmsocket_t *sock) {
 	 * Process the first packet from the buffer, leaving
 	 * the rest (if any) for later.
 	 */
-	len = ntohs(*(uint16_t *)sock->buf);
+	len = (sock->buf[sock->buf_pos] << 8) | sock->buf[sock->buf_pos + 1];
 	if (len > sock->buf_len - 2) {
 		return (ISC_R_NOMORE);
 	}
@@ -813,7 +829,7 @@ isc__nm_tcpdns_processbuffer(isc_nmsocket_t *sock) {
 	 * result is ISC_R_SUCCESS, so we don't need to have
 	 * the buffer on the heap
 	 */
-	req->uvbuf.base = (char *)sock->buf + 2;
+	req->uvbuf.base = (char *)sock->buf + sock->buf_pos + 2;
 	req->uvbuf.len = len;
 
 	/*
@@ -833,11 +849,7 @@ isc__nm_tcpdns_processbuffer(isc_nmsocket_t *sock) {
 	isc__nm_readcb(sock, req, ISC_R_SUCCESS);
 	sock->processing = false;
 
-	len += 2;
-	sock->buf_len -= len;
-	if (sock->buf_len > 0) {
-		memmove(sock->buf, sock->buf + len, sock->buf_len);
-	}
+	isc__nm_consume_dnsbuf(sock, len + 2);
 
 	isc_nmhandle_detach(&handle);
 
@@ -882,11 +894,7 @@ isc__nm_tcpdns_read_cb(uv_stream_t *stream, ssize_t nread,
 	 * the position where previous read has ended in the sock->buf, that way
 	 * the data could be read directly into sock->buf.
 	 */
-
-	if (sock->buf_len + len > sock->buf_size) {
-		isc__nm_alloc_dnsbuf(sock, sock->buf_len + len);
-	}
-	memmove(sock->buf + sock->buf_len, base, len);
+	memmove(isc__nm_reserve_dnsbuf(sock, len), base, len);
 	sock->buf_len += len;
 
 	if (!atomic_load(&sock->client)) {
@@ -973,6 +981,7 @@ accept_connection(isc_nmsocket_t *ssock, isc_quota_t *quota) {
 	csock->recv_cb = ssock->recv_cb;
 	csock->recv_cbarg = ssock->recv_cbarg;
 	csock->quota = quota;
+	csock->proxy2_pending = atomic_load(&ssock->proxy);
 	atomic_init(&csock->accepting, true);
 
 	worker = csock->worker;
@@ -77,6 +77,18 @@ call_pending_send_callbacks(isc_nmsocket_t *sock, const isc_result_t result);
 static void
 tlsdns_keep_client_tls_session(isc_nmsocket_t *sock);
 
+static void
+tlsdns_ktls_prepare(isc_nmsocket_t *sock);
+
+static void
+tlsdns_ktls_start(isc_nmsocket_t *sock);
+
+static void
+tlsdns_ktls_shutdown(isc_nmsocket_t *sock);
+
+static isc_result_t
+tlsdns_ktls_send(isc_nmsocket_t *sock, isc__nm_uvreq_t *req);
+
 static void
 tlsdns_set_tls_shutdown(isc_tls_t *tls) {
 	(void)SSL_set_shutdown(tls, SSL_SENT_SHUTDOWN);
@@ -276,6 +288,7 @@ tlsdns_connect_cb(uv_connect_t *uvreq, int status) {
 	sock->tls.state = TLS_STATE_NONE;
 	sock->tls.tls = isc_tls_create(sock->tls.ctx);
 	RUNTIME_CHECK(sock->tls.tls != NULL);
+	tlsdns_ktls_prepare(sock);
 
 	/*
 	 *
@@ -419,7 +432,6 @@ isc__nm_tlsdns_lb_socket(isc_nm_t *mgr, sa_family_t sa_family) {
 	result = isc__nm_socket(sa_family, SOCK_STREAM, 0, &sock);
 	RUNTIME_CHECK(result == ISC_R_SUCCESS);
 
-	(void)isc__nm_socket_incoming_cpu(sock);
 	(void)isc__nm_socket_v6only(sock, sa_family);
 
 	/* FIXME: set mss */
@@ -462,6 +474,8 @@ start_tlsdns_child(isc_nm_t *mgr, isc_sockaddr_t *iface, isc_nmsocket_t *sock,
 		UNUSED(fd);
 		csock->fd = isc__nm_tlsdns_lb_socket(mgr,
 						     iface->type.sa.sa_family);
+		(void)isc__nm_socket_incoming_cpu(csock->fd,
+						    worker->loop->cpu);
 	} else {
 		csock->fd = dup(fd);
 	}
@@ -795,6 +809,11 @@ isc__nm_async_tlsdnsshutdown(isc__networker_t *worker, isc__netievent_t *ev0) {
 		return;
 	}
 
+	if (sock->tls.ktls_tx || sock->tls.ktls_rx) {
+		tlsdns_ktls_shutdown(sock);
+		return;
+	}
+
 	rv = SSL_shutdown(sock->tls.tls);
 
 	if (rv == 1) {
@@ -978,7 +997,7 @@ isc__nm_tlsdns_processbuffer(isc_nmsocket_t *sock) {
 	 * Process the first packet from the buffer, leaving
 	 * the rest (if any) for later.
 	 */
-	len = ntohs(*(uint16_t *)sock->buf);
+	len = (sock->buf[sock->buf_pos] << 8) | sock->buf[sock->buf_pos + 1];
 	if (len > sock->buf_len - 2) {
 		return (ISC_R_NOMORE);
 	}
@@ -1015,7 +1034,7 @@ isc__nm_tlsdns_processbuffer(isc_nmsocket_t *sock) {
 	 * result is ISC_R_SUCCESS, so we don't need to have
 	 * the buffer on the heap
 	 */
-	req->uvbuf.base = (char *)sock->buf + 2;
+	req->uvbuf.base = (char *)sock->buf + sock->buf_pos + 2;
 	req->uvbuf.len = len;
 
 	/*
@@ -1035,11 +1054,7 @@ isc__nm_tlsdns_processbuffer(isc_nmsocket_t *sock) {
 	isc__nm_readcb(sock, req, ISC_R_SUCCESS);
 	sock->processing = false;
 
-	len += 2;
-	sock->buf_len -= len;
-	if (sock->buf_len > 0) {
-		memmove(sock->buf, sock->buf + len, sock->buf_len);
-	}
+	isc__nm_consume_dnsbuf(sock, len + 2);
 
 	isc_nmhandle_detach(&handle);
 
@@ -1057,6 +1072,11 @@ tls_cycle_input(isc_nmsocket_t *sock) {
 	int err = 0;
 	int rv = 1;
 
+	if (sock->tls.ktls_rx) {
+		/* The kernel has decrypted the data already */
+		return (isc__nm_process_sock_buffer(sock));
+	}
+
 	if (sock->tls.state == TLS_STATE_IO) {
 		size_t len;
 
@@ -1069,17 +1089,11 @@ tls_cycle_input(isc_nmsocket_t *sock) {
 			}
 
 			if (pending != 0) {
-				if ((sock->buf_len + pending) > sock->buf_size)
-				{
-					isc__nm_alloc_dnsbuf(
-						sock, sock->buf_len + pending);
-				}
-
 				len = 0;
-				rv = SSL_read_ex(sock->tls.tls,
-						 sock->buf + sock->buf_len,
-						 sock->buf_size - sock->buf_len,
-						 &len);
+				rv = SSL_read_ex(
+					sock->tls.tls,
+					isc__nm_reserve_dnsbuf(sock, pending),
+					pending, &len);
 				if (rv != 1) {
 					/*
 					 * Process what's in the buffer so far
@@ -1281,6 +1295,17 @@ tls_cycle_output(isc_nmsocket_t *sock) {
 	isc_result_t result = ISC_R_SUCCESS;
 	int pending;
 
+	if (sock->tls.ktls_tx) {
+		/*
+		 * The kernel is encrypting the outgoing records now, so
+		 * OpenSSL must not produce any on its own (e.g. a KeyUpdate).
+		 */
+		if (BIO_pending(sock->tls.app_rbio) > 0) {
+			return (ISC_R_TLSERROR);
+		}
+		return (ISC_R_SUCCESS);
+	}
+
 	while ((pending = BIO_pending(sock->tls.app_rbio)) > 0) {
 		isc__nm_uvreq_t *req = NULL;
 		size_t bytes;
@@ -1401,6 +1426,8 @@ tls_cycle(isc_nmsocket_t *sock) {
 	if (result != ISC_R_SUCCESS) {
 		goto done;
 	}
+
+	tlsdns_ktls_start(sock);
 done:
 	sock->tls.cycle = false;
 
@@ -1446,6 +1473,7 @@ void
 isc__nm_tlsdns_read_cb(uv_stream_t *stream, ssize_t nread,
 		       const uv_buf_t *buf) {
 	isc_nmsocket_t *sock = uv_handle_get_data((uv_handle_t *)stream);
+	isc_region_t region;
 	size_t len;
 	isc_result_t result;
 	int rv;
@@ -1461,11 +1489,19 @@ isc__nm_tlsdns_read_cb(uv_stream_t *stream, ssize_t nread,
 	}
 
 	if (nread < 0) {
-		if (nread != UV_EOF) {
+		result = isc_uverr2result(nread);
+		if (nread == UV_EIO && sock->tls.ktls_rx) {
+			/*
+			 * The kernel doesn't pass the records other than
+			 * application data (e.g. the close_notify alert)
+			 * to read(2).
+			 */
+			result = ISC_R_EOF;
+		} else if (nread != UV_EOF) {
 			isc__nm_incstats(sock, STATID_RECVFAIL);
 		}
 
-		isc__nm_failed_read_cb(sock, isc_uverr2result(nread), true);
+		isc__nm_failed_read_cb(sock, result, true);
 
 		goto free;
 	}
@@ -1474,14 +1510,42 @@ isc__nm_tlsdns_read_cb(uv_stream_t *stream, ssize_t nread,
 		sock->read_timeout = atomic_load(&sock->worker->netmgr->idle);
 	}
 
+	region = (isc_region_t){ .base = (unsigned char *)buf->base,
+				 .length = nread };
+
 	/*
-	 * The input has to be fed into BIO
+	 * The PROXYv2 header precedes the TLS handshake.
 	 */
-	rv = BIO_write_ex(sock->tls.app_wbio, buf->base, (size_t)nread, &len);
+	if (sock->proxy2_pending) {
+		result = isc__nm_proxy2_read(sock, &region);
+		if (result != ISC_R_SUCCESS && result != ISC_R_NOMORE) {
+			isc__nm_failed_read_cb(sock, result, true);
+			goto free;
+		}
+		if (region.length == 0) {
+			goto free;
+		}
+	}
 
-	if (rv <= 0 || (size_t)nread != len) {
-		isc__nm_failed_read_cb(sock, ISC_R_TLSERROR, true);
-		goto free;
+	if (sock->tls.ktls_rx) {
+		/*
+		 * The input is plaintext already, handle it the way
+		 * isc__nm_tcpdns_read_cb() does.
+		 */
+		memmove(isc__nm_reserve_dnsbuf(sock, region.length),
+			region.base, region.length);
+		sock->buf_len += region.length;
+	} else {
+		/*
+		 * The input has to be fed into BIO
+		 */
+		rv = BIO_write_ex(sock->tls.app_wbio, region.base,
+				  region.length, &len);
+
+		if (rv <= 0 || region.length != len) {
+			isc__nm_failed_read_cb(sock, ISC_R_TLSERROR, true);
+			goto free;
+		}
 	}
 
 	result = tls_cycle(sock);
@@ -1568,6 +1632,7 @@ accept_connection(isc_nmsocket_t *ssock, isc_quota_t *quota) {
 	csock->recv_cb = ssock->recv_cb;
 	csock->recv_cbarg = ssock->recv_cbarg;
 	csock->quota = quota;
+	csock->proxy2_pending = atomic_load(&ssock->proxy);
 	atomic_init(&csock->accepting, true);
 
 	worker = csock->worker;
@@ -1618,6 +1683,7 @@ accept_connection(isc_nmsocket_t *ssock, isc_quota_t *quota) {
 
 	csock->tls.tls = isc_tls_create(ssock->tls.ctx);
 	RUNTIME_CHECK(csock->tls.tls != NULL);
+	tlsdns_ktls_prepare(csock);
 
 	r = BIO_new_bio_pair(&csock->tls.ssl_wbio, ISC_NETMGR_TCP_RECVBUF_SIZE,
 			     &csock->tls.app_rbio, ISC_NETMGR_TCP_RECVBUF_SIZE);
@@ -1643,8 +1709,6 @@ accept_connection(isc_nmsocket_t *ssock, isc_quota_t *quota) {
 
 	SSL_set_accept_state(csock->tls.tls);
 
-	/* FIXME: Set SSL_MODE_RELEASE_BUFFERS */
-
 	atomic_store(&csock->accepting, false);
 
 	isc__nm_incstats(csock, STATID_ACCEPT);
@@ -1790,6 +1854,10 @@ tlsdns_send_direct(isc_nmsocket_t *sock, isc__nm_uvreq_t *req) {
 		goto requeue;
 	}
 
+	if (sock->tls.ktls_tx) {
+		return (tlsdns_ktls_send(sock, req));
+	}
+
 	/*
 	 * There's no SSL_writev(), so we need to use a local buffer to
 	 * assemble the whole message
@@ -1832,6 +1900,160 @@ requeue:
 	return (result);
 }
 
+/*
+ * Kernel TLS offload.  After the handshake, each direction is handed
+ * over to the kernel as soon as OpenSSL has no more data buffered for
+ * it; from then on, that direction of the socket carries plaintext and
+ * is handled like a TCP DNS socket.
+ */
+static void
+tlsdns_ktls_prepare(isc_nmsocket_t *sock) {
+	sock->tls.ktls_tx = false;
+	sock->tls.ktls_rx = false;
+	sock->tls.ktls = sock->worker->netmgr->kernel_tls &&
+			 isc_tls_ktls_prepare(sock->tls.tls) == ISC_R_SUCCESS;
+}
+
+static void
+tlsdns_ktls_start(isc_nmsocket_t *sock) {
+	isc_result_t result;
+	uv_os_fd_t fd;
+
+	if (!sock->tls.ktls || sock->tls.state != TLS_STATE_IO) {
+		return;
+	}
+
+	if (uv_fileno(&sock->uv_handle.handle, &fd) != 0) {
+		sock->tls.ktls = false;
+		return;
+	}
+
+	/* Wait until all the encrypted data has been written */
+	if (!sock->tls.ktls_tx && sock->tls.senddata.base == NULL) {
+		result = isc_tls_ktls_start_tx(sock->tls.tls, fd);
+		if (result == ISC_R_SUCCESS) {
+			sock->tls.ktls_tx = true;
+		} else if (result != ISC_R_WOULDBLOCK) {
+			sock->tls.ktls = false;
+			return;
+		}
+	}
+
+	if (!sock->tls.ktls_rx) {
+		result = isc_tls_ktls_start_rx(sock->tls.tls, fd);
+		if (result == ISC_R_SUCCESS) {
+			sock->tls.ktls_rx = true;
+		} else if (result != ISC_R_WOULDBLOCK) {
+			sock->tls.ktls = false;
+			return;
+		}
+	}
+
+	if (sock->tls.ktls_tx && sock->tls.ktls_rx) {
+		/* Nothing more to do */
+		sock->tls.ktls = false;
+	}
+}
+
+static void
+tlsdns_ktls_shutdown(isc_nmsocket_t *sock) {
+	isc_result_t result;
+	uv_os_fd_t fd;
+
+	/*
+	 * The peer's close_notify can't be waited for when the kernel is
+	 * decrypting the input, so only send ours.
+	 */
+	if (!sock->tls.ktls_tx) {
+		(void)SSL_shutdown(sock->tls.tls);
+		sock->tls.state = TLS_STATE_NONE;
+
+		result = tls_cycle(sock);
+		if (result != ISC_R_SUCCESS) {
+			tls_error(sock, result);
+		}
+		return;
+	}
+
+	/* Don't let the alert overtake the queued responses */
+	if (uv_stream_get_write_queue_size(&sock->uv_handle.stream) == 0 &&
+	    uv_fileno(&sock->uv_handle.handle, &fd) == 0)
+	{
+		(void)isc_tls_ktls_close_notify(fd);
+	}
+
+	tlsdns_set_tls_shutdown(sock->tls.tls);
+	sock->tls.state = TLS_STATE_NONE;
+}
+
+static void
+tlsdns_ktls_send_cb(uv_write_t *req, int status) {
+	isc__nm_uvreq_t *uvreq = (isc__nm_uvreq_t *)req->data;
+	isc_nmsocket_t *sock = NULL;
+
+	REQUIRE(VALID_UVREQ(uvreq));
+	REQUIRE(VALID_NMSOCK(uvreq->sock));
+
+	sock = uvreq->sock;
+
+	isc_nm_timer_stop(uvreq->timer);
+	isc_nm_timer_detach(&uvreq->timer);
+
+	if (status < 0) {
+		isc__nm_incstats(sock, STATID_SENDFAIL);
+		isc__nm_failed_send_cb(sock, uvreq, isc_uverr2result(status));
+		return;
+	}
+
+	isc__nm_sendcb(sock, uvreq, ISC_R_SUCCESS, false);
+}
+
+static isc_result_t
+tlsdns_ktls_send(isc_nmsocket_t *sock, isc__nm_uvreq_t *req) {
+	uv_buf_t bufs[2] = { { .base = req->tcplen, .len = 2 },
+			     { .base = req->uvbuf.base,
+			       .len = req->uvbuf.len } };
+	int r, nbufs = 2;
+
+	r = uv_try_write(&sock->uv_handle.stream, bufs, nbufs);
+
+	if (r == (int)(bufs[0].len + bufs[1].len)) {
+		/* Wrote everything */
+		isc__nm_sendcb(sock, req, ISC_R_SUCCESS, true);
+		return (ISC_R_SUCCESS);
+	}
+
+	if (r == 1) {
+		/* Partial write of DNSMSG length */
+		bufs[0].base = req->tcplen + 1;
+		bufs[0].len = 1;
+	} else if (r > 0) {
+		/* Partial write of DNSMSG */
+		nbufs = 1;
+		bufs[0].base = req->uvbuf.base + (r - 2);
+		bufs[0].len = req->uvbuf.len - (r - 2);
+	} else if (r == UV_ENOSYS || r == UV_EAGAIN) {
+		/* uv_try_write not supported, send asynchronously */
+	} else {
+		/* error sending data */
+		return (isc_uverr2result(r));
+	}
+
+	r = uv_write(&req->uv_req.write, &sock->uv_handle.stream, bufs, nbufs,
+		     tlsdns_ktls_send_cb);
+	if (r < 0) {
+		return (isc_uverr2result(r));
+	}
+
+	isc_nm_timer_create(req->handle, isc__nmsocket_writetimeout_cb, req,
+			    &req->timer);
+	if (sock->write_timeout > 0) {
+		isc_nm_timer_start(req->timer, sock->write_timeout);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
 static void
 tlsdns_stop_cb(uv_handle_t *handle) {
 	isc_nmsocket_t *sock = uv_handle_get_data(handle);
@@ -32,6 +32,7 @@
 #include <isc/region.h>
 #include <isc/result.h>
 #include <isc/sockaddr.h>
+#include <isc/stats.h>
 #include <isc/stdtime.h>
 #include <isc/thread.h>
 #include <isc/util.h>
@@ -42,6 +43,12 @@
 
 #define TLS_BUF_SIZE (UINT16_MAX)
 
+/*
+ * The maximum TLS record payload; sends queued during one loop
+ * iteration are encrypted together up to this size.
+ */
+#define TLS_RECORD_SIZE (16384)
+
 static isc_result_t
 tls_error_to_result(const int tls_err, const int tls_state, isc_tls_t *tls) {
 	switch (tls_err) {
@@ -64,7 +71,7 @@ tls_failed_read_cb(isc_nmsocket_t *sock, const isc_result_t result);
 
 static void
 tls_do_bio(isc_nmsocket_t *sock, isc_region_t *received_data,
-	   isc__nm_uvreq_t *send_data, bool finish);
+	   isc__nm_uvreq_list_t *send_data, bool finish);
 
 static void
 tls_readcb(isc_nmhandle_t *handle, isc_result_t result, isc_region_t *region,
@@ -119,6 +126,18 @@ tls_call_connect_cb(isc_nmsocket_t *sock, isc_nmhandle_t *handle,
 	}
 }
 
+static void
+tls_complete_sends(isc_nmsocket_t *sock, isc__nm_uvreq_list_t *reqs,
+		   isc_result_t result) {
+	isc__nm_uvreq_t *req = NULL;
+
+	while ((req = ISC_LIST_HEAD(*reqs)) != NULL) {
+		ISC_LIST_UNLINK(*reqs, req, link);
+		req->cb.send(req->handle, result, req->cbarg);
+		isc__nm_uvreq_put(&req, sock);
+	}
+}
+
 static void
 tls_senddone(isc_nmhandle_t *handle, isc_result_t eresult, void *cbarg) {
 	isc_nmsocket_tls_send_req_t *send_req =
@@ -137,10 +156,9 @@ tls_senddone(isc_nmhandle_t *handle, isc_result_t eresult, void *cbarg) {
 		tls_try_shutdown(tlssock->tlsstream.tls, true);
 	}
 
-	if (send_req->cb != NULL) {
+	if (!ISC_LIST_EMPTY(send_req->reqs)) {
 		INSIST(VALID_NMHANDLE(tlssock->statichandle));
-		send_req->cb(send_req->handle, eresult, send_req->cbarg);
-		isc_nmhandle_detach(&send_req->handle);
+		tls_complete_sends(tlssock, &send_req->reqs, eresult);
 		/* The last handle has been just detached: close the underlying
 		 * socket. */
 		if (tlssock->statichandle == NULL) {
@@ -234,17 +252,16 @@ async_tls_do_bio(isc_nmsocket_t *sock) {
 }
 
 static int
-tls_send_outgoing(isc_nmsocket_t *sock, bool finish, isc_nmhandle_t *tlshandle,
-		  isc_nm_cb_t cb, void *cbarg) {
+tls_send_outgoing(isc_nmsocket_t *sock, bool finish,
+		  isc__nm_uvreq_list_t *reqs) {
 	isc_nmsocket_tls_send_req_t *send_req = NULL;
 	int pending;
 	int rv;
 	size_t len = 0;
 
 	if (inactive(sock)) {
-		if (cb != NULL) {
-			INSIST(VALID_NMHANDLE(tlshandle));
-			cb(tlshandle, ISC_R_CANCELED, cbarg);
+		if (reqs != NULL) {
+			tls_complete_sends(sock, reqs, ISC_R_CANCELED);
 		}
 		return (0);
 	}
@@ -256,6 +273,10 @@ tls_send_outgoing(isc_nmsocket_t *sock, bool finish, isc_nmhandle_t *tlshandle,
 
 	pending = BIO_pending(sock->tlsstream.bio_out);
 	if (pending <= 0) {
+		if (reqs != NULL) {
+			/* Nothing to put on the wire, e.g. empty sends */
+			tls_complete_sends(sock, reqs, ISC_R_SUCCESS);
+		}
 		return (pending);
 	}
 
@@ -276,10 +297,9 @@ tls_send_outgoing(isc_nmsocket_t *sock, bool finish, isc_nmhandle_t *tlshandle,
 	}
 
 	isc__nmsocket_attach(sock, &send_req->tlssock);
-	if (cb != NULL) {
-		send_req->cb = cb;
-		send_req->cbarg = cbarg;
-		isc_nmhandle_attach(tlshandle, &send_req->handle);
+	ISC_LIST_INIT(send_req->reqs);
+	if (reqs != NULL) {
+		ISC_LIST_MOVE(send_req->reqs, *reqs);
 	}
 
 	rv = BIO_read_ex(sock->tlsstream.bio_out, send_req->data.base, pending,
@@ -297,8 +317,7 @@ tls_send_outgoing(isc_nmsocket_t *sock, bool finish, isc_nmhandle_t *tlshandle,
 
 static int
 tls_process_outgoing(isc_nmsocket_t *sock, bool finish,
-		     isc__nm_uvreq_t *send_data) {
-	int pending;
+		     isc__nm_uvreq_list_t *send_data) {
 
 	bool received_shutdown = ((SSL_get_shutdown(sock->tlsstream.tls) &
 				   SSL_RECEIVED_SHUTDOWN) != 0);
@@ -310,15 +329,87 @@ tls_process_outgoing(isc_nmsocket_t *sock, bool finish,
 	}
 
 	/* Data from TLS to network */
-	if (send_data != NULL) {
-		pending = tls_send_outgoing(sock, finish, send_data->handle,
-					    send_data->cb.send,
-					    send_data->cbarg);
-	} else {
-		pending = tls_send_outgoing(sock, finish, NULL, NULL, NULL);
+	return (tls_send_outgoing(sock, finish, send_data));
+}
+
+/*
+ * Encrypt a batch of queued sends.  Several small sends are copied
+ * together first, so that they end up in a single TLS record.
+ */
+static int
+tls_write_sends(isc_nmsocket_t *sock, isc__nm_uvreq_list_t *reqs) {
+	isc__nm_uvreq_t *req = ISC_LIST_HEAD(*reqs);
+	uint8_t buf[TLS_RECORD_SIZE];
+	size_t buflen = 0, len = 0;
+	int rv;
+
+	INSIST(req != NULL);
+
+	if (ISC_LIST_NEXT(req, link) == NULL) {
+		rv = SSL_write_ex(sock->tlsstream.tls, req->uvbuf.base,
+				  req->uvbuf.len, &len);
+		return (rv == 1 && len == req->uvbuf.len ? 1 : 0);
 	}
 
-	return (pending);
+	for (; req != NULL; req = ISC_LIST_NEXT(req, link)) {
+		INSIST(buflen + req->uvbuf.len <= sizeof(buf));
+		memmove(buf + buflen, req->uvbuf.base, req->uvbuf.len);
+		buflen += req->uvbuf.len;
+	}
+
+	rv = SSL_write_ex(sock->tlsstream.tls, buf, buflen, &len);
+	return (rv == 1 && len == buflen ? 1 : 0);
+}
+
+/*
+ * Encrypt and send the sends queued on the socket since the last
+ * flush, in batches of up to one TLS record, so that responses
+ * produced in one loop iteration do not each end up in a record and
+ * a TCP segment of their own.
+ */
+static void
+tls_flush_sends(isc_nmsocket_t *sock) {
+	sock->tlsstream.sendq_scheduled = false;
+
+	while (!ISC_LIST_EMPTY(sock->tlsstream.sendq)) {
+		isc__nm_uvreq_list_t batch;
+		isc__nm_uvreq_t *req = NULL;
+		size_t len = 0;
+
+		ISC_LIST_INIT(batch);
+		while ((req = ISC_LIST_HEAD(sock->tlsstream.sendq)) != NULL) {
+			if (!ISC_LIST_EMPTY(batch) &&
+			    len + req->uvbuf.len > TLS_RECORD_SIZE)
+			{
+				break;
+			}
+			ISC_LIST_UNLINK(sock->tlsstream.sendq, req, link);
+			ISC_LIST_APPEND(batch, req, link);
+			len += req->uvbuf.len;
+		}
+
+		if (inactive(sock)) {
+			tls_complete_sends(sock, &batch, ISC_R_CANCELED);
+			continue;
+		}
+
+		tls_do_bio(sock, NULL, &batch, false);
+		INSIST(ISC_LIST_EMPTY(batch));
+	}
+}
+
+static void
+tls_handshake_incstats(isc_nmsocket_t *sock) {
+	isc_stats_t *stats = sock->worker->netmgr->stats;
+
+	if (stats == NULL) {
+		return;
+	}
+
+	isc_stats_increment(stats, isc_sockstatscounter_tlshandshake);
+	if (SSL_session_reused(sock->tlsstream.tls) == 1) {
+		isc_stats_increment(stats, isc_sockstatscounter_tlsresumed);
+	}
 }
 
 static int
@@ -338,8 +429,17 @@ tls_try_handshake(isc_nmsocket_t *sock, isc_result_t *presult) {
 		INSIST(SSL_is_init_finished(sock->tlsstream.tls) == 1);
 		INSIST(sock->statichandle == NULL);
 		isc__nmsocket_log_tls_session_reuse(sock, sock->tlsstream.tls);
+		if (sock->tlsstream.server && sock->outerhandle->proxied) {
+			/*
+			 * The PROXYv2 header preceding the handshake has
+			 * been read by the TCP socket.
+			 */
+			sock->proxied = true;
+			sock->proxysource = sock->outerhandle->proxysource;
+		}
 		tlshandle = isc__nmhandle_get(sock, &sock->peer, &sock->iface);
 		if (sock->tlsstream.server) {
+			tls_handshake_incstats(sock);
 			if (sock->listener->accept_cb == NULL) {
 				result = ISC_R_CANCELED;
 			} else {
@@ -380,7 +480,7 @@ tls_try_to_close_unused_socket(isc_nmsocket_t *sock) {
 
 static void
 tls_do_bio(isc_nmsocket_t *sock, isc_region_t *received_data,
-	   isc__nm_uvreq_t *send_data, bool finish) {
+	   isc__nm_uvreq_list_t *send_data, bool finish) {
 	isc_result_t result = ISC_R_SUCCESS;
 	int pending, tls_status = SSL_ERROR_NONE;
 	int rv = 0;
@@ -407,6 +507,9 @@ tls_do_bio(isc_nmsocket_t *sock, isc_region_t *received_data,
 		rv = tls_try_handshake(sock, NULL);
 		INSIST(SSL_is_init_finished(sock->tlsstream.tls) == 0);
 	} else if (sock->tlsstream.state == TLS_CLOSED) {
+		if (send_data != NULL) {
+			tls_complete_sends(sock, send_data, ISC_R_CANCELED);
+		}
 		return;
 	} else { /* initialised and doing I/O */
 		if (received_data != NULL) {
@@ -452,16 +555,12 @@ tls_do_bio(isc_nmsocket_t *sock, isc_region_t *received_data,
 			bool sent_shutdown =
 				((SSL_get_shutdown(sock->tlsstream.tls) &
 				  SSL_SENT_SHUTDOWN) != 0);
-			rv = SSL_write_ex(sock->tlsstream.tls,
-					  send_data->uvbuf.base,
-					  send_data->uvbuf.len, &len);
-			if (rv != 1 || len != send_data->uvbuf.len) {
+			rv = tls_write_sends(sock, send_data);
+			if (rv != 1) {
 				result = received_shutdown || sent_shutdown
 						 ? ISC_R_CANCELED
 						 : ISC_R_TLSERROR;
-				send_data->cb.send(send_data->handle, result,
-						   send_data->cbarg);
-				send_data = NULL;
+				tls_complete_sends(sock, send_data, result);
 				return;
 			}
 		}
@@ -633,6 +732,8 @@ initialize_tls(isc_nmsocket_t *sock, bool server) {
 		    sock->tlsstream.bio_out);
 	sock->tlsstream.server = server;
 	sock->tlsstream.nsending = 0;
+	ISC_LIST_INIT(sock->tlsstream.sendq);
+	sock->tlsstream.sendq_scheduled = false;
 	sock->tlsstream.state = TLS_INIT;
 	return (ISC_R_SUCCESS);
 error:
@@ -769,13 +870,19 @@ isc__nm_async_tlssend(isc__networker_t *worker, isc__netievent_t *ev0) {
 
 	if (inactive(sock)) {
 		req->cb.send(req->handle, ISC_R_CANCELED, req->cbarg);
-		goto done;
+		isc__nm_uvreq_put(&req, sock);
+		return;
 	}
 
-	tls_do_bio(sock, NULL, req, false);
-done:
-	isc__nm_uvreq_put(&req, sock);
-	return;
+	/*
+	 * Queue the send; the queue is flushed by a tlsdobio event, which
+	 * runs after the other events already queued on this loop.
+	 */
+	ISC_LIST_APPEND(sock->tlsstream.sendq, req, link);
+	if (!sock->tlsstream.sendq_scheduled) {
+		sock->tlsstream.sendq_scheduled = true;
+		async_tls_do_bio(sock);
+	}
 }
 
 void
@@ -1101,7 +1208,11 @@ isc__nm_async_tlsdobio(isc__networker_t *worker, isc__netievent_t *ev0) {
 
 	UNUSED(worker);
 
-	tls_do_bio(ievent->sock, NULL, NULL, false);
+	if (!ISC_LIST_EMPTY(ievent->sock->tlsstream.sendq)) {
+		tls_flush_sends(ievent->sock);
+	} else {
+		tls_do_bio(ievent->sock, NULL, NULL, false);
+	}
 }
 
 void
@@ -13,6 +13,11 @@
 
 #include <unistd.h>
 
+#if HAVE_SENDMMSG
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#endif /* HAVE_SENDMMSG */
+
 #include <isc/atomic.h>
 #include <isc/barrier.h>
 #include <isc/buffer.h>
@@ -21,6 +26,7 @@
 #include <isc/magic.h>
 #include <isc/mem.h>
 #include <isc/netmgr.h>
+#include <isc/proxy2.h>
 #include <isc/random.h>
 #include <isc/refcount.h>
 #include <isc/region.h>
@@ -80,7 +86,6 @@ isc__nm_udp_lb_socket(isc_nm_t *mgr, sa_family_t sa_family) {
 	result = isc__nm_socket(sa_family, SOCK_DGRAM, 0, &sock);
 	RUNTIME_CHECK(result == ISC_R_SUCCESS);
 
-	(void)isc__nm_socket_incoming_cpu(sock);
 	(void)isc__nm_socket_disable_pmtud(sock, sa_family);
 	(void)isc__nm_socket_v6only(sock, sa_family);
 
@@ -115,6 +120,8 @@ start_udp_child(isc_nm_t *mgr, isc_sockaddr_t *iface, isc_nmsocket_t *sock,
 		UNUSED(fd);
 		csock->fd = isc__nm_udp_lb_socket(mgr,
 						  iface->type.sa.sa_family);
+		(void)isc__nm_socket_incoming_cpu(csock->fd,
+						    worker->loop->cpu);
 	} else {
 		csock->fd = dup(fd);
 	}
@@ -412,6 +419,21 @@ isc__nm_async_udplisten(isc__networker_t *worker, isc__netievent_t *ev0) {
 
 	isc__nm_set_network_buffers(mgr, &sock->uv_handle.handle);
 
+#if HAVE_AF_XDP
+	if (mgr->xdp != NULL) {
+		(void)isc__nm_xdp_udp_recv_start(sock);
+	}
+#endif /* HAVE_AF_XDP */
+
+#if HAVE_IO_URING
+	if (mgr->io_uring &&
+	    isc__nm_uring_udp_recv_start(sock) == ISC_R_SUCCESS)
+	{
+		atomic_store(&sock->listening, true);
+		goto done;
+	}
+#endif /* HAVE_IO_URING */
+
 	r = uv_udp_recv_start(&sock->uv_handle.udp, isc__nm_alloc_cb,
 			      udp_recv_cb);
 	if (r != 0) {
@@ -506,38 +528,17 @@ isc__nm_async_udpstop(isc__networker_t *worker, isc__netievent_t *ev0) {
 	isc_barrier_wait(&sock->parent->barrier);
 }
 
-/*
- * udp_recv_cb handles incoming UDP packet from uv.  The buffer here is
- * reused for a series of packets, so we need to allocate a new one.
- * This new one can be reused to send the response then.
- */
-static void
-udp_recv_cb(uv_udp_t *handle, ssize_t nrecv, const uv_buf_t *buf,
-	    const struct sockaddr *addr, unsigned flags) {
-	isc_nmsocket_t *sock = uv_handle_get_data((uv_handle_t *)handle);
+void
+isc__nm_udp_recv(isc_nmsocket_t *sock, isc_result_t result, uint8_t *base,
+		 size_t len, const struct sockaddr *addr) {
 	isc__nm_uvreq_t *req = NULL;
 	uint32_t maxudp;
-	isc_result_t result;
 	isc_sockaddr_t sockaddr, *sa = NULL;
+	isc_proxy2_t proxy = { .addresses = false };
 
 	REQUIRE(VALID_NMSOCK(sock));
 	REQUIRE(sock->tid == isc_tid());
 
-	/*
-	 * When using recvmmsg(2), if no errors occur, there will be a final
-	 * callback with nrecv set to 0, addr set to NULL and the buffer
-	 * pointing at the initially allocated data with the UV_UDP_MMSG_CHUNK
-	 * flag cleared and the UV_UDP_MMSG_FREE flag set.
-	 */
-#if HAVE_DECL_UV_UDP_MMSG_FREE
-	if ((flags & UV_UDP_MMSG_FREE) == UV_UDP_MMSG_FREE) {
-		INSIST(nrecv == 0);
-		INSIST(addr == NULL);
-		goto free;
-	}
-#else
-	UNUSED(flags);
-#endif
 	/*
 	 * Possible reasons to return now without processing:
 	 *
@@ -545,21 +546,21 @@ udp_recv_cb(uv_udp_t *handle, ssize_t nrecv, const uv_buf_t *buf,
 	 *   bigger than 'maxudp' bytes for testing purposes.
 	 */
 	maxudp = atomic_load(&sock->worker->netmgr->maxudp);
-	if ((maxudp != 0 && (uint32_t)nrecv > maxudp)) {
+	if (result == ISC_R_SUCCESS && maxudp != 0 && len > maxudp) {
 		/*
 		 * We need to keep the read_cb intact in case, so the
 		 * readtimeout_cb can trigger and not crash because of
 		 * missing read_req.
 		 */
-		goto free;
+		return;
 	}
 
 	/*
 	 * - If there was a networking error.
 	 */
-	if (nrecv < 0) {
-		isc__nm_failed_read_cb(sock, isc_uverr2result(nrecv), false);
-		goto free;
+	if (result != ISC_R_SUCCESS) {
+		isc__nm_failed_read_cb(sock, result, false);
+		return;
 	}
 
 	/*
@@ -568,7 +569,7 @@ udp_recv_cb(uv_udp_t *handle, ssize_t nrecv, const uv_buf_t *buf,
 	 */
 	if (addr == NULL) {
 		isc__nm_failed_read_cb(sock, ISC_R_EOF, false);
-		goto free;
+		return;
 	}
 
 	/*
@@ -576,7 +577,7 @@ udp_recv_cb(uv_udp_t *handle, ssize_t nrecv, const uv_buf_t *buf,
 	 */
 	if (isc__nm_closing(sock->worker)) {
 		isc__nm_failed_read_cb(sock, ISC_R_SHUTTINGDOWN, false);
-		goto free;
+		return;
 	}
 
 	/*
@@ -584,7 +585,7 @@ udp_recv_cb(uv_udp_t *handle, ssize_t nrecv, const uv_buf_t *buf,
 	 */
 	if (!isc__nmsocket_active(sock)) {
 		isc__nm_failed_read_cb(sock, ISC_R_CANCELED, false);
-		goto free;
+		return;
 	}
 
 	if (!sock->route_sock) {
@@ -593,14 +594,38 @@ udp_recv_cb(uv_udp_t *handle, ssize_t nrecv, const uv_buf_t *buf,
 		sa = &sockaddr;
 	}
 
+	/*
+	 * - If every datagram must start with a PROXYv2 header and this
+	 *   one doesn't, or there's nothing after the header.
+	 */
+	if (atomic_load(&sock->proxy)) {
+		isc_region_t region = { .base = base, .length = len };
+
+		result = isc_proxy2_parse(&region, &proxy);
+		if (result != ISC_R_SUCCESS || proxy.length == len) {
+			isc__nm_incstats(sock, STATID_RECVFAIL);
+			return;
+		}
+
+		base += proxy.length;
+		len -= proxy.length;
+	}
+
 	req = isc__nm_get_read_req(sock, sa);
+	if (proxy.addresses) {
+		/*
+		 * The response still goes to the proxy, i.e. 'peer'.
+		 */
+		req->handle->proxied = true;
+		req->handle->proxysource = proxy.source;
+	}
 
 	/*
 	 * The callback will be called synchronously, because result is
 	 * ISC_R_SUCCESS, so we are ok of passing the buf directly.
 	 */
-	req->uvbuf.base = buf->base;
-	req->uvbuf.len = nrecv;
+	req->uvbuf.base = (char *)base;
+	req->uvbuf.len = len;
 
 	sock->recv_read = false;
 
@@ -608,6 +633,64 @@ udp_recv_cb(uv_udp_t *handle, ssize_t nrecv, const uv_buf_t *buf,
 	sock->processing = true;
 	isc__nm_readcb(sock, req, ISC_R_SUCCESS);
 	sock->processing = false;
+}
+
+#if HAVE_IO_URING
+void
+isc__nm_udp_uring_fallback(isc_nmsocket_t *sock) {
+	int r;
+
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(sock->type == isc_nm_udpsocket);
+	REQUIRE(sock->tid == isc_tid());
+	REQUIRE(!sock->uring_reading);
+
+	if (isc__nmsocket_closing(sock)) {
+		return;
+	}
+
+	r = uv_udp_recv_start(&sock->uv_handle.udp, isc__nm_alloc_cb,
+			      udp_recv_cb);
+	if (r != 0) {
+		isc__nm_incstats(sock, STATID_RECVFAIL);
+	}
+}
+#endif /* HAVE_IO_URING */
+
+/*
+ * udp_recv_cb handles incoming UDP packet from uv.  The buffer here is
+ * reused for a series of packets, so we need to allocate a new one.
+ * This new one can be reused to send the response then.
+ */
+static void
+udp_recv_cb(uv_udp_t *handle, ssize_t nrecv, const uv_buf_t *buf,
+	    const struct sockaddr *addr, unsigned flags) {
+	isc_nmsocket_t *sock = uv_handle_get_data((uv_handle_t *)handle);
+
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(sock->tid == isc_tid());
+
+	/*
+	 * When using recvmmsg(2), if no errors occur, there will be a final
+	 * callback with nrecv set to 0, addr set to NULL and the buffer
+	 * pointing at the initially allocated data with the UV_UDP_MMSG_CHUNK
+	 * flag cleared and the UV_UDP_MMSG_FREE flag set.
+	 */
+#if HAVE_DECL_UV_UDP_MMSG_FREE
+	if ((flags & UV_UDP_MMSG_FREE) == UV_UDP_MMSG_FREE) {
+		INSIST(nrecv == 0);
+		INSIST(addr == NULL);
+		goto free;
+	}
+#else
+	UNUSED(flags);
+#endif
+	if (nrecv < 0) {
+		isc__nm_udp_recv(sock, isc_uverr2result(nrecv), NULL, 0, NULL);
+	} else {
+		isc__nm_udp_recv(sock, ISC_R_SUCCESS, (uint8_t *)buf->base,
+				 nrecv, addr);
+	}
 
 free:
 #if HAVE_DECL_UV_UDP_MMSG_CHUNK
@@ -659,6 +742,384 @@ udp_send_cb(uv_udp_send_t *req, int status) {
 	isc__nm_sendcb(sock, uvreq, result, false);
 }
 
+static void
+udp_send_uv(isc_nmsocket_t *sock, isc__nm_uvreq_t *uvreq) {
+	const struct sockaddr *sa = &uvreq->handle->peer.type.sa;
+	int r;
+
+#if UV_VERSION_HEX >= UV_VERSION(1, 27, 0)
+	/*
+	 * If we used uv_udp_connect() (and not the shim version for
+	 * older versions of libuv), then the peer address has to be
+	 * set to NULL or else uv_udp_send() could fail or assert,
+	 * depending on the libuv version.
+	 */
+	if (atomic_load(&sock->connected)) {
+		sa = NULL;
+	}
+#endif
+
+	r = uv_udp_send(&uvreq->uv_req.udp_send, &sock->uv_handle.udp,
+			&uvreq->uvbuf, 1, sa, udp_send_cb);
+	if (r < 0) {
+		isc__nm_incstats(sock, STATID_SENDFAIL);
+		isc__nm_failed_send_cb(sock, uvreq, isc_uverr2result(r));
+	}
+}
+
+#if HAVE_SENDMMSG
+/*
+ * Maximum number of datagrams passed to a single sendmmsg(2) call.
+ */
+#define UDP_SENDBATCH_MAX 64
+
+/*
+ * Maximum number of segments coalesced into a single UDP_SEGMENT
+ * datagram; this is the UDP_MAX_SEGMENTS limit of the Linux kernel.
+ */
+#define UDP_SENDGSO_MAXSEGS 64
+
+/*
+ * Maximum size of the UDP payload of a UDP_SEGMENT datagram.
+ */
+#define UDP_SENDGSO_MAXSIZE (UINT16_MAX - 8 - 40)
+
+static void
+udp_sendq_cb(uv_handle_t *handle) {
+	isc__networker_t *worker = uv_handle_get_data(handle);
+
+	isc__nm_udp_sendq_flush(worker);
+}
+
+static void
+udp_sendq_check_cb(uv_check_t *handle) {
+	udp_sendq_cb((uv_handle_t *)handle);
+}
+
+static void
+udp_sendq_prepare_cb(uv_prepare_t *handle) {
+	udp_sendq_cb((uv_handle_t *)handle);
+}
+
+static void
+udp_sendq_close_cb(uv_handle_t *handle) {
+	isc__networker_t *worker = uv_handle_get_data(handle);
+
+	isc__networker_detach(&worker);
+}
+
+static void
+udp_sendq_enqueue(isc__networker_t *worker, isc__nm_uvreq_t *uvreq) {
+	int r;
+
+	if (!worker->udpsend_init) {
+		r = uv_check_init(&worker->loop->loop, &worker->udpsend_check);
+		UV_RUNTIME_CHECK(uv_check_init, r);
+		uv_handle_set_data((uv_handle_t *)&worker->udpsend_check,
+				   worker);
+
+		r = uv_prepare_init(&worker->loop->loop,
+				    &worker->udpsend_prepare);
+		UV_RUNTIME_CHECK(uv_prepare_init, r);
+		uv_handle_set_data((uv_handle_t *)&worker->udpsend_prepare,
+				   worker);
+
+		worker->udpsend_init = true;
+	}
+
+	/*
+	 * The check handle flushes the datagrams produced by the I/O
+	 * callbacks right after the poll phase, and the prepare handle
+	 * makes sure that the datagrams produced by the timer, check and
+	 * close callbacks are flushed before the loop blocks in the
+	 * next poll.
+	 */
+	if (ISC_LIST_EMPTY(worker->udpsendq)) {
+		r = uv_check_start(&worker->udpsend_check, udp_sendq_check_cb);
+		UV_RUNTIME_CHECK(uv_check_start, r);
+		r = uv_prepare_start(&worker->udpsend_prepare,
+				     udp_sendq_prepare_cb);
+		UV_RUNTIME_CHECK(uv_prepare_start, r);
+	}
+
+	ISC_LIST_APPEND(worker->udpsendq, uvreq, link);
+	worker->udpsendq_len++;
+
+	if (worker->udpsendq_len >= UDP_SENDBATCH_MAX) {
+		isc__nm_udp_sendq_flush(worker);
+	}
+}
+
+static void
+udp_sendq_stats(isc__networker_t *worker, size_t ndgrams, size_t ngso) {
+	isc_stats_t *stats = worker->netmgr->stats;
+
+	if (stats == NULL) {
+		return;
+	}
+
+	isc_stats_increment(stats, isc_sockstatscounter_udpsendbatch);
+	for (size_t i = 0; i < ndgrams; i++) {
+		isc_stats_increment(stats, isc_sockstatscounter_udpsendbatched);
+	}
+	for (size_t i = 0; i < ngso; i++) {
+		isc_stats_increment(stats, isc_sockstatscounter_udpsendgso);
+	}
+	isc_stats_update_if_greater(stats, isc_sockstatscounter_udpsendbatchmax,
+				    ndgrams);
+}
+
+/*
+ * Build a sendmmsg(2) vector for 'nreqs' datagrams queued on 'sock'
+ * and send it.  The callbacks are called only after all datagrams have
+ * been handed over to the kernel or to libuv, because they might close
+ * the socket.
+ */
+static void
+udp_send_batch(isc__networker_t *worker, isc_nmsocket_t *sock,
+	       isc__nm_uvreq_t **reqs, size_t nreqs) {
+	struct mmsghdr msgs[UDP_SENDBATCH_MAX];
+	struct iovec iovs[UDP_SENDBATCH_MAX];
+#ifdef UDP_SEGMENT
+	union {
+		char buf[CMSG_SPACE(sizeof(uint16_t))];
+		struct cmsghdr align;
+	} cmsgs[UDP_SENDBATCH_MAX];
+#endif /* ifdef UDP_SEGMENT */
+	size_t first[UDP_SENDBATCH_MAX + 1];
+	isc_result_t results[UDP_SENDBATCH_MAX];
+	bool handedover[UDP_SENDBATCH_MAX] = { false };
+	size_t nmsgs = 0, sent = 0;
+	uv_os_fd_t fd;
+
+	REQUIRE(nreqs > 0 && nreqs <= UDP_SENDBATCH_MAX);
+
+	if (isc__nmsocket_closing(sock) ||
+	    uv_fileno(&sock->uv_handle.handle, &fd) != 0)
+	{
+		for (size_t i = 0; i < nreqs; i++) {
+			isc__nm_sendcb(sock, reqs[i], ISC_R_CANCELED, false);
+		}
+		return;
+	}
+
+	for (size_t i = 0; i < nreqs; nmsgs++) {
+		isc__nm_uvreq_t *req = reqs[i];
+		isc_sockaddr_t *peer = &req->handle->peer;
+		size_t nsegs = 1;
+
+		iovs[i] = (struct iovec){ .iov_base = req->uvbuf.base,
+					  .iov_len = req->uvbuf.len };
+
+#ifdef UDP_SEGMENT
+		/*
+		 * Consecutive datagrams of the same size for the same
+		 * destination can be sent as a single UDP_SEGMENT
+		 * datagram; only the last segment may be shorter.
+		 */
+		size_t total = req->uvbuf.len;
+		while (!worker->udpsend_nogso && i + nsegs < nreqs &&
+		       nsegs < UDP_SENDGSO_MAXSEGS && req->uvbuf.len > 0)
+		{
+			isc__nm_uvreq_t *next = reqs[i + nsegs];
+
+			if (next->uvbuf.len == 0 ||
+			    next->uvbuf.len > req->uvbuf.len ||
+			    total + next->uvbuf.len > UDP_SENDGSO_MAXSIZE ||
+			    !isc_sockaddr_equal(&next->handle->peer, peer))
+			{
+				break;
+			}
+
+			iovs[i + nsegs] = (struct iovec){
+				.iov_base = next->uvbuf.base,
+				.iov_len = next->uvbuf.len,
+			};
+			total += next->uvbuf.len;
+			nsegs++;
+
+			if (next->uvbuf.len < req->uvbuf.len) {
+				break;
+			}
+		}
+#endif /* ifdef UDP_SEGMENT */
+
+		msgs[nmsgs] = (struct mmsghdr){
+			.msg_hdr = {
+				.msg_name = &peer->type.sa,
+				.msg_namelen = peer->length,
+				.msg_iov = &iovs[i],
+				.msg_iovlen = nsegs,
+			},
+		};
+
+#ifdef UDP_SEGMENT
+		if (nsegs > 1) {
+			struct msghdr *mh = &msgs[nmsgs].msg_hdr;
+			struct cmsghdr *cmsg = NULL;
+			uint16_t gso_size = req->uvbuf.len;
+
+			memset(&cmsgs[nmsgs], 0, sizeof(cmsgs[nmsgs]));
+			mh->msg_control = cmsgs[nmsgs].buf;
+			mh->msg_controllen = sizeof(cmsgs[nmsgs].buf);
+
+			cmsg = CMSG_FIRSTHDR(mh);
+			cmsg->cmsg_level = SOL_UDP;
+			cmsg->cmsg_type = UDP_SEGMENT;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(gso_size));
+			memmove(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+		}
+#endif /* ifdef UDP_SEGMENT */
+
+		first[nmsgs] = i;
+		i += nsegs;
+	}
+	first[nmsgs] = nreqs;
+
+	while (sent < nmsgs) {
+		int r = sendmmsg(fd, &msgs[sent], nmsgs - sent, 0);
+		if (r > 0) {
+			size_t ndgrams = first[sent + r] - first[sent];
+			size_t ngso = 0;
+
+			for (size_t m = sent; m < sent + r; m++) {
+				if (msgs[m].msg_hdr.msg_iovlen > 1) {
+					ngso += msgs[m].msg_hdr.msg_iovlen;
+				}
+			}
+			for (size_t i = first[sent]; i < first[sent + r]; i++) {
+				results[i] = ISC_R_SUCCESS;
+			}
+
+			udp_sendq_stats(worker, ndgrams, ngso);
+			sent += r;
+			continue;
+		}
+
+		switch (errno) {
+		case EINTR:
+			continue;
+		case EAGAIN:
+#if defined(EWOULDBLOCK) && EWOULDBLOCK != EAGAIN
+		case EWOULDBLOCK:
+#endif /* if defined(EWOULDBLOCK) && EWOULDBLOCK != EAGAIN */
+		case ENOBUFS:
+			/*
+			 * The socket send buffer is full; let libuv do the
+			 * queueing and wait for the socket to become
+			 * writable again.
+			 */
+			for (size_t i = first[sent]; i < nreqs; i++) {
+				handedover[i] = true;
+			}
+			sent = nmsgs;
+			continue;
+		default:
+			break;
+		}
+
+		if (msgs[sent].msg_hdr.msg_iovlen > 1) {
+			/*
+			 * UDP_SEGMENT is not supported by the kernel or by
+			 * the egress device; stop using it on this worker
+			 * and send the datagrams one by one through libuv.
+			 */
+			worker->udpsend_nogso = true;
+			for (size_t i = first[sent]; i < first[sent + 1]; i++) {
+				handedover[i] = true;
+			}
+		} else {
+			results[first[sent]] = isc_errno_toresult(errno);
+			isc__nm_incstats(sock, STATID_SENDFAIL);
+		}
+		sent++;
+	}
+
+	for (size_t i = 0; i < nreqs; i++) {
+		if (handedover[i]) {
+			udp_send_uv(sock, reqs[i]);
+		}
+	}
+
+	for (size_t i = 0; i < nreqs; i++) {
+		if (!handedover[i]) {
+			isc__nm_sendcb(sock, reqs[i], results[i], false);
+		}
+	}
+}
+
+void
+isc__nm_udp_sendq_flush(isc__networker_t *worker) {
+	ISC_LIST(isc__nm_uvreq_t) sendq;
+
+	if (ISC_LIST_EMPTY(worker->udpsendq)) {
+		return;
+	}
+
+	ISC_LIST_INIT(sendq);
+
+	/*
+	 * Detach the queue from the worker first, the callbacks might
+	 * queue more datagrams.
+	 */
+	ISC_LIST_MOVE(sendq, worker->udpsendq);
+	worker->udpsendq_len = 0;
+
+	uv_check_stop(&worker->udpsend_check);
+	uv_prepare_stop(&worker->udpsend_prepare);
+
+	while (!ISC_LIST_EMPTY(sendq)) {
+		isc__nm_uvreq_t *reqs[UDP_SENDBATCH_MAX];
+		isc__nm_uvreq_t *req = NULL, *next = NULL;
+		isc_nmsocket_t *sock = ISC_LIST_HEAD(sendq)->sock;
+		size_t nreqs = 0;
+
+		/*
+		 * Gather the datagrams queued on the same socket,
+		 * preserving their order.
+		 */
+		for (req = ISC_LIST_HEAD(sendq);
+		     req != NULL && nreqs < UDP_SENDBATCH_MAX; req = next)
+		{
+			next = ISC_LIST_NEXT(req, link);
+			if (req->sock != sock) {
+				continue;
+			}
+			ISC_LIST_UNLINK(sendq, req, link);
+			reqs[nreqs++] = req;
+		}
+
+		udp_send_batch(worker, sock, reqs, nreqs);
+	}
+}
+
+void
+isc__nm_udp_sendq_shutdown(isc__networker_t *worker) {
+	if (!worker->udpsend_init) {
+		return;
+	}
+
+	isc__nm_udp_sendq_flush(worker);
+
+	worker->udpsend_init = false;
+
+	isc__networker_ref(worker);
+	uv_close((uv_handle_t *)&worker->udpsend_check, udp_sendq_close_cb);
+	isc__networker_ref(worker);
+	uv_close((uv_handle_t *)&worker->udpsend_prepare, udp_sendq_close_cb);
+}
+#else  /* HAVE_SENDMMSG */
+void
+isc__nm_udp_sendq_flush(isc__networker_t *worker) {
+	UNUSED(worker);
+}
+
+void
+isc__nm_udp_sendq_shutdown(isc__networker_t *worker) {
+	UNUSED(worker);
+}
+#endif /* HAVE_SENDMMSG */
+
 /*
  * Send the data in 'region' to a peer via a UDP socket. We try to find
  * a proper sibling/child socket so that we won't have to jump to
@@ -668,12 +1129,9 @@ void
 isc__nm_udp_send(isc_nmhandle_t *handle, const isc_region_t *region,
 		 isc_nm_cb_t cb, void *cbarg) {
 	isc_nmsocket_t *sock = handle->sock;
-	const isc_sockaddr_t *peer = &handle->peer;
-	const struct sockaddr *sa = &peer->type.sa;
 	isc__nm_uvreq_t *uvreq = NULL;
 	isc__networker_t *worker = NULL;
 	uint32_t maxudp;
-	int r;
 
 	REQUIRE(VALID_NMSOCK(sock));
 	REQUIRE(sock->type == isc_nm_udpsocket);
@@ -714,24 +1172,24 @@ isc__nm_udp_send(isc_nmhandle_t *handle, const isc_region_t *region,
 	uvreq->cb.send = cb;
 	uvreq->cbarg = cbarg;
 
-#if UV_VERSION_HEX >= UV_VERSION(1, 27, 0)
-	/*
-	 * If we used uv_udp_connect() (and not the shim version for
-	 * older versions of libuv), then the peer address has to be
-	 * set to NULL or else uv_udp_send() could fail or assert,
-	 * depending on the libuv version.
-	 */
-	if (atomic_load(&sock->connected)) {
-		sa = NULL;
+#if HAVE_AF_XDP
+	if (sock->xdp_reading &&
+	    isc__nm_xdp_udp_send(sock, &handle->peer, region) == ISC_R_SUCCESS)
+	{
+		isc__nm_sendcb(sock, uvreq, ISC_R_SUCCESS, true);
+		return;
 	}
-#endif
+#endif /* HAVE_AF_XDP */
 
-	r = uv_udp_send(&uvreq->uv_req.udp_send, &sock->uv_handle.udp,
-			&uvreq->uvbuf, 1, sa, udp_send_cb);
-	if (r < 0) {
-		isc__nm_incstats(sock, STATID_SENDFAIL);
-		isc__nm_failed_send_cb(sock, uvreq, isc_uverr2result(r));
+#if HAVE_SENDMMSG
+	if (worker->netmgr->udp_send_batching &&
+	    !atomic_load(&sock->connected)) {
+		udp_sendq_enqueue(worker, uvreq);
+		return;
 	}
+#endif /* HAVE_SENDMMSG */
+
+	udp_send_uv(sock, uvreq);
 }
 
 static isc_result_t
@@ -838,7 +1296,7 @@ isc_nm_udpconnect(isc_nm_t *mgr, isc_sockaddr_t *local, isc_sockaddr_t *peer,
 	RUNTIME_CHECK(result == ISC_R_SUCCESS ||
 		      result == ISC_R_NOTIMPLEMENTED);
 
-	(void)isc__nm_socket_incoming_cpu(sock->fd);
+	(void)isc__nm_socket_incoming_cpu(sock->fd, worker->loop->cpu);
 
 	(void)isc__nm_socket_disable_pmtud(sock->fd, sa_family);
 
@@ -1063,6 +1521,12 @@ isc__nm_udp_close(isc_nmsocket_t *sock) {
 	isc__nmsocket_clearcb(sock);
 	isc__nmsocket_timer_stop(sock);
 	isc__nm_stop_reading(sock);
+#if HAVE_IO_URING
+	isc__nm_uring_udp_recv_stop(sock);
+#endif /* HAVE_IO_URING */
+#if HAVE_AF_XDP
+	isc__nm_xdp_udp_recv_stop(sock);
+#endif /* HAVE_AF_XDP */
 
 	uv_close((uv_handle_t *)&sock->read_timer, read_timer_close_cb);
 }
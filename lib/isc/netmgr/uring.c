@@ -0,0 +1,649 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * io_uring engine for the UDP listeners.
+ *
+ * Every network worker that has a UDP listener started while the io_uring
+ * engine is enabled gets its own ring.  Each listening socket has a single
+ * multishot IORING_OP_RECVMSG request armed on the ring, and the kernel
+ * picks the receive buffers from a provided buffer ring registered with
+ * the ring, so there is no per-datagram system call and no per-datagram
+ * buffer allocation.  The ring file descriptor is watched by the libuv
+ * loop using a uv_poll_t handle, and the completions are dispatched from
+ * the poll callback, in the same loop phase where libuv would have called
+ * the regular UDP receive callback.
+ *
+ * The sending side and the connected (client) UDP sockets keep using
+ * libuv.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <linux/io_uring.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <isc/atomic.h>
+#include <isc/errno.h>
+#include <isc/log.h>
+#include <isc/mem.h>
+#include <isc/netmgr.h>
+#include <isc/result.h>
+#include <isc/util.h>
+#include <isc/uv.h>
+
+#include "../loop_p.h"
+#include "netmgr-int.h"
+
+/*
+ * Number of submission queue entries; the submissions are rare (arming
+ * and cancelling the multishot requests), the completion queue is sized
+ * separately.
+ */
+#define URING_SQ_ENTRIES 64
+#define URING_CQ_ENTRIES 4096
+
+/*
+ * Number and size of the buffers in the provided buffer ring; each buffer
+ * holds the struct io_uring_recvmsg_out header, the peer address and the
+ * datagram itself, which can be as large as any UDP payload, like on the
+ * libuv receive path.  The buffers are anonymous memory, so only the
+ * pages the kernel has written to are backed by memory.
+ */
+#define URING_NBUFS   256
+#define URING_BUFSIZE (UINT16_MAX + sizeof(struct io_uring_recvmsg_out) + \
+		       sizeof(struct sockaddr_storage))
+#define URING_BGID    0
+
+STATIC_ASSERT((URING_NBUFS & (URING_NBUFS - 1)) == 0,
+	      "the number of ring buffers must be a power of 2");
+
+/*
+ * The user_data of the cancel requests has the lowest bit set, the
+ * user_data of the receive requests is the socket pointer.
+ */
+#define URING_CANCEL_TAG ((uint64_t)1)
+
+struct isc__nm_uring {
+	isc__networker_t *worker;
+	int fd;
+	uv_poll_t poll;
+	bool shuttingdown;
+	size_t inflight;
+
+	/* Submission queue */
+	void *sq_ptr;
+	size_t sq_size;
+	unsigned int *sq_khead;
+	unsigned int *sq_ktail;
+	unsigned int *sq_kflags;
+	unsigned int sq_mask;
+	unsigned int *sq_array;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+
+	/* Completion queue */
+	void *cq_ptr;
+	size_t cq_size;
+	unsigned int *cq_khead;
+	unsigned int *cq_ktail;
+	unsigned int cq_mask;
+	struct io_uring_cqe *cqes;
+
+	/* Provided buffers */
+	struct io_uring_buf_ring *br;
+	size_t br_size;
+	uint8_t *bufs;
+	size_t bufs_size;
+
+	/* Template for the multishot recvmsg */
+	struct msghdr msg;
+};
+
+#define uring_load_acquire(p) \
+	atomic_load_explicit((_Atomic(unsigned int) *)(p), memory_order_acquire)
+#define uring_store_release(p, v)                                          \
+	atomic_store_explicit((_Atomic(unsigned int) *)(p), (v),           \
+			      memory_order_release)
+#define uring_store_release16(p, v)                                        \
+	atomic_store_explicit((_Atomic(uint16_t) *)(p), (v),               \
+			      memory_order_release)
+
+static int
+uring_setup(unsigned int entries, struct io_uring_params *p) {
+	return (syscall(__NR_io_uring_setup, entries, p));
+}
+
+static int
+uring_enter(int fd, unsigned int to_submit, unsigned int min_complete,
+	    unsigned int flags) {
+	return (syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+			flags, NULL, 0));
+}
+
+static int
+uring_register(int fd, unsigned int opcode, void *arg,
+	       unsigned int nr_args) {
+	return (syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+static void
+uring_unmap(isc__nm_uring_t *ring) {
+	if (ring->bufs != NULL) {
+		munmap(ring->bufs, ring->bufs_size);
+	}
+	if (ring->br != NULL) {
+		munmap(ring->br, ring->br_size);
+	}
+	if (ring->sqes != NULL) {
+		munmap(ring->sqes, ring->sqes_size);
+	}
+	if (ring->cq_ptr != NULL && ring->cq_ptr != ring->sq_ptr) {
+		munmap(ring->cq_ptr, ring->cq_size);
+	}
+	if (ring->sq_ptr != NULL) {
+		munmap(ring->sq_ptr, ring->sq_size);
+	}
+}
+
+static void *
+uring_mmap(int fd, size_t size, off_t offset) {
+	void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_POPULATE, fd, offset);
+	return (ptr == MAP_FAILED ? NULL : ptr);
+}
+
+static void
+uring_putbuf(isc__nm_uring_t *ring, uint16_t bid) {
+	uint16_t tail = ring->br->tail;
+	struct io_uring_buf *buf = &ring->br->bufs[tail & (URING_NBUFS - 1)];
+
+	buf->addr = (uint64_t)(uintptr_t)(ring->bufs + bid * URING_BUFSIZE);
+	buf->len = URING_BUFSIZE;
+	buf->bid = bid;
+
+	uring_store_release16(&ring->br->tail, tail + 1);
+}
+
+static isc_result_t
+uring_map(isc__nm_uring_t *ring, struct io_uring_params *p) {
+	struct io_uring_buf_reg reg;
+	int r;
+
+	ring->sq_size = p->sq_off.array + p->sq_entries * sizeof(unsigned int);
+	ring->cq_size = p->cq_off.cqes +
+			p->cq_entries * sizeof(struct io_uring_cqe);
+	if ((p->features & IORING_FEAT_SINGLE_MMAP) != 0) {
+		ring->sq_size = ISC_MAX(ring->sq_size, ring->cq_size);
+		ring->cq_size = ring->sq_size;
+	}
+
+	ring->sq_ptr = uring_mmap(ring->fd, ring->sq_size, IORING_OFF_SQ_RING);
+	if (ring->sq_ptr == NULL) {
+		return (ISC_R_FAILURE);
+	}
+
+	if ((p->features & IORING_FEAT_SINGLE_MMAP) != 0) {
+		ring->cq_ptr = ring->sq_ptr;
+	} else {
+		ring->cq_ptr = uring_mmap(ring->fd, ring->cq_size,
+					  IORING_OFF_CQ_RING);
+		if (ring->cq_ptr == NULL) {
+			return (ISC_R_FAILURE);
+		}
+	}
+
+	ring->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = uring_mmap(ring->fd, ring->sqes_size, IORING_OFF_SQES);
+	if (ring->sqes == NULL) {
+		return (ISC_R_FAILURE);
+	}
+
+	ring->sq_khead = (unsigned int *)((char *)ring->sq_ptr +
+					  p->sq_off.head);
+	ring->sq_ktail = (unsigned int *)((char *)ring->sq_ptr +
+					  p->sq_off.tail);
+	ring->sq_kflags = (unsigned int *)((char *)ring->sq_ptr +
+					   p->sq_off.flags);
+	ring->sq_mask = *(unsigned int *)((char *)ring->sq_ptr +
+					  p->sq_off.ring_mask);
+	ring->sq_array = (unsigned int *)((char *)ring->sq_ptr +
+					  p->sq_off.array);
+
+	ring->cq_khead = (unsigned int *)((char *)ring->cq_ptr +
+					  p->cq_off.head);
+	ring->cq_ktail = (unsigned int *)((char *)ring->cq_ptr +
+					  p->cq_off.tail);
+	ring->cq_mask = *(unsigned int *)((char *)ring->cq_ptr +
+					  p->cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)((char *)ring->cq_ptr +
+					     p->cq_off.cqes);
+
+	/*
+	 * The buffer ring must be page aligned, so it (and the buffers) are
+	 * allocated with mmap(2) and not with isc_mem_get().
+	 */
+	ring->br_size = URING_NBUFS * sizeof(struct io_uring_buf);
+	ring->br = mmap(NULL, ring->br_size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ring->br == MAP_FAILED) {
+		ring->br = NULL;
+		return (ISC_R_NOMEMORY);
+	}
+
+	ring->bufs_size = URING_NBUFS * URING_BUFSIZE;
+	ring->bufs = mmap(NULL, ring->bufs_size, PROT_READ | PROT_WRITE,
+			  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ring->bufs == MAP_FAILED) {
+		ring->bufs = NULL;
+		return (ISC_R_NOMEMORY);
+	}
+
+	reg = (struct io_uring_buf_reg){
+		.ring_addr = (uint64_t)(uintptr_t)ring->br,
+		.ring_entries = URING_NBUFS,
+		.bgid = URING_BGID,
+	};
+	r = uring_register(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1);
+	if (r < 0) {
+		return (isc_errno_toresult(errno));
+	}
+
+	ring->br->tail = 0;
+	for (uint16_t bid = 0; bid < URING_NBUFS; bid++) {
+		uring_putbuf(ring, bid);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static struct io_uring_sqe *
+uring_get_sqe(isc__nm_uring_t *ring) {
+	unsigned int head = uring_load_acquire(ring->sq_khead);
+	unsigned int tail = *ring->sq_ktail;
+	struct io_uring_sqe *sqe = NULL;
+
+	if (tail - head > ring->sq_mask) {
+		return (NULL);
+	}
+
+	sqe = &ring->sqes[tail & ring->sq_mask];
+	memset(sqe, 0, sizeof(*sqe));
+	ring->sq_array[tail & ring->sq_mask] = tail & ring->sq_mask;
+
+	return (sqe);
+}
+
+static isc_result_t
+uring_submit(isc__nm_uring_t *ring) {
+	int r;
+
+	uring_store_release(ring->sq_ktail, *ring->sq_ktail + 1);
+
+	do {
+		r = uring_enter(ring->fd, 1, 0, 0);
+	} while (r < 0 && errno == EINTR);
+
+	if (r < 0) {
+		return (isc_errno_toresult(errno));
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+uring_destroy(isc__nm_uring_t **ringp) {
+	isc__nm_uring_t *ring = *ringp;
+	isc__networker_t *worker = ring->worker;
+
+	*ringp = NULL;
+
+	uring_unmap(ring);
+	if (ring->fd >= 0) {
+		close(ring->fd);
+	}
+	isc_mem_put(worker->mctx, ring, sizeof(*ring));
+}
+
+static void
+uring_close_cb(uv_handle_t *handle) {
+	isc__nm_uring_t *ring = uv_handle_get_data(handle);
+	isc__networker_t *worker = ring->worker;
+
+	INSIST(worker->uring == ring);
+	worker->uring = NULL;
+
+	uring_destroy(&ring);
+	isc__networker_detach(&worker);
+}
+
+static void
+uring_maybe_close(isc__nm_uring_t *ring) {
+	if (!ring->shuttingdown || ring->inflight > 0 ||
+	    uv_is_closing((uv_handle_t *)&ring->poll))
+	{
+		return;
+	}
+
+	uv_close((uv_handle_t *)&ring->poll, uring_close_cb);
+}
+
+static isc_result_t
+uring_recvmsg(isc__nm_uring_t *ring, isc_nmsocket_t *sock) {
+	struct io_uring_sqe *sqe = uring_get_sqe(ring);
+	isc_result_t result;
+
+	if (sqe == NULL) {
+		return (ISC_R_NORESOURCES);
+	}
+
+	sqe->opcode = IORING_OP_RECVMSG;
+	sqe->fd = sock->fd;
+	sqe->addr = (uint64_t)(uintptr_t)&ring->msg;
+	sqe->len = 1;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = URING_BGID;
+	sqe->user_data = (uint64_t)(uintptr_t)sock;
+
+	result = uring_submit(ring);
+	if (result == ISC_R_SUCCESS) {
+		ring->inflight++;
+	}
+	return (result);
+}
+
+static void
+uring_recv_done(isc__nm_uring_t *ring, isc_nmsocket_t *sock, int res) {
+	ring->inflight--;
+
+	/*
+	 * The multishot request was terminated by the kernel, re-arm it if
+	 * we are still reading from the socket and the reason was that the
+	 * provided buffers ran out; on any other error, hand the socket
+	 * over to libuv.
+	 */
+	if (sock->uring_reading && !isc__nmsocket_closing(sock) &&
+	    !ring->shuttingdown)
+	{
+		if ((res >= 0 || res == -ENOBUFS) &&
+		    uring_recvmsg(ring, sock) == ISC_R_SUCCESS)
+		{
+			return;
+		}
+
+		sock->uring_reading = false;
+		isc__nm_udp_uring_fallback(sock);
+	}
+
+	sock->uring_reading = false;
+	isc__nmsocket_detach(&sock);
+
+	uring_maybe_close(ring);
+}
+
+static void
+uring_recv_cqe(isc__nm_uring_t *ring, isc_nmsocket_t *sock,
+	       const struct io_uring_cqe *cqe) {
+	struct io_uring_recvmsg_out *out = NULL;
+	uint16_t bid;
+	uint8_t *buf = NULL;
+	size_t payloadoff;
+
+	REQUIRE(VALID_NMSOCK(sock));
+
+	if (cqe->res < 0) {
+		switch (-cqe->res) {
+		case ECANCELED:
+		case ENOBUFS:
+			break;
+		default:
+			if (sock->uring_reading) {
+				isc__nm_udp_recv(sock,
+						 isc_errno_toresult(-cqe->res),
+						 NULL, 0, NULL);
+			}
+		}
+		return;
+	}
+
+	if ((cqe->flags & IORING_CQE_F_BUFFER) == 0) {
+		return;
+	}
+
+	bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+	INSIST(bid < URING_NBUFS);
+	buf = ring->bufs + bid * URING_BUFSIZE;
+
+	out = (struct io_uring_recvmsg_out *)buf;
+	payloadoff = sizeof(*out) + ring->msg.msg_namelen +
+		     ring->msg.msg_controllen;
+
+	if ((out->flags & MSG_TRUNC) != 0) {
+		/* Cannot happen, the buffers fit any UDP payload */
+		isc__nm_incstats(sock, STATID_RECVFAIL);
+	} else if (sock->uring_reading) {
+		INSIST(payloadoff + out->payloadlen <= (size_t)cqe->res);
+		isc__nm_udp_recv(
+			sock, ISC_R_SUCCESS, buf + payloadoff, out->payloadlen,
+			(const struct sockaddr *)(buf + sizeof(*out)));
+	}
+
+	uring_putbuf(ring, bid);
+}
+
+static void
+uring_poll_cb(uv_poll_t *handle, int status, int events) {
+	isc__nm_uring_t *ring = uv_handle_get_data((uv_handle_t *)handle);
+	unsigned int head, tail;
+
+	UNUSED(status);
+	UNUSED(events);
+
+	REQUIRE(ring->worker->loop->tid == isc_tid());
+
+	/*
+	 * Move the completions that overflowed the CQ ring back to it.
+	 */
+	if ((uring_load_acquire(ring->sq_kflags) & IORING_SQ_CQ_OVERFLOW) != 0)
+	{
+		(void)uring_enter(ring->fd, 0, 0, IORING_ENTER_GETEVENTS);
+	}
+
+	head = *ring->cq_khead;
+	tail = uring_load_acquire(ring->cq_ktail);
+
+	while (head != tail) {
+		struct io_uring_cqe cqe = ring->cqes[head & ring->cq_mask];
+
+		/*
+		 * Release the CQE before dispatching it; the callbacks might
+		 * submit new requests.
+		 */
+		head++;
+		uring_store_release(ring->cq_khead, head);
+
+		if ((cqe.user_data & URING_CANCEL_TAG) != 0) {
+			ring->inflight--;
+			uring_maybe_close(ring);
+		} else {
+			isc_nmsocket_t *sock =
+				(isc_nmsocket_t *)(uintptr_t)cqe.user_data;
+
+			uring_recv_cqe(ring, sock, &cqe);
+
+			if ((cqe.flags & IORING_CQE_F_MORE) == 0) {
+				uring_recv_done(ring, sock, cqe.res);
+			}
+		}
+
+		if (head == tail) {
+			tail = uring_load_acquire(ring->cq_ktail);
+		}
+	}
+}
+
+static isc_result_t
+uring_create(isc__networker_t *worker, isc__nm_uring_t **ringp) {
+	isc__nm_uring_t *ring = NULL;
+	struct io_uring_params params = {
+		.flags = IORING_SETUP_CQSIZE,
+		.cq_entries = URING_CQ_ENTRIES,
+	};
+	isc_result_t result;
+	int r;
+
+	ring = isc_mem_get(worker->mctx, sizeof(*ring));
+	*ring = (isc__nm_uring_t){
+		.worker = worker,
+		.msg = {
+			.msg_namelen = sizeof(struct sockaddr_storage),
+		},
+	};
+
+	ring->fd = uring_setup(URING_SQ_ENTRIES, &params);
+	if (ring->fd < 0) {
+		result = isc_errno_toresult(errno);
+		goto fail;
+	}
+
+	if ((params.features & IORING_FEAT_NODROP) == 0) {
+		result = ISC_R_NOTIMPLEMENTED;
+		goto fail;
+	}
+
+	result = uring_map(ring, &params);
+	if (result != ISC_R_SUCCESS) {
+		goto fail;
+	}
+
+	r = uv_poll_init(&worker->loop->loop, &ring->poll, ring->fd);
+	if (r != 0) {
+		result = isc_uverr2result(r);
+		goto fail;
+	}
+	uv_handle_set_data((uv_handle_t *)&ring->poll, ring);
+
+	r = uv_poll_start(&ring->poll, UV_READABLE, uring_poll_cb);
+	UV_RUNTIME_CHECK(uv_poll_start, r);
+
+	/* The uv_poll_t handle holds a reference to the worker */
+	isc__networker_ref(worker);
+
+	*ringp = ring;
+	return (ISC_R_SUCCESS);
+
+fail:
+	uring_destroy(&ring);
+	return (result);
+}
+
+isc_result_t
+isc__nm_uring_udp_recv_start(isc_nmsocket_t *sock) {
+	isc__networker_t *worker = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(sock->type == isc_nm_udpsocket);
+	REQUIRE(sock->tid == isc_tid());
+	REQUIRE(!sock->uring_reading);
+
+	worker = sock->worker;
+
+	if (isc__nm_closing(worker) ||
+	    (worker->uring != NULL && worker->uring->shuttingdown))
+	{
+		return (ISC_R_SHUTTINGDOWN);
+	}
+
+	if (worker->uring == NULL) {
+		if (worker->uring_failed) {
+			return (ISC_R_NOTIMPLEMENTED);
+		}
+
+		result = uring_create(worker, &worker->uring);
+		if (result != ISC_R_SUCCESS) {
+			/* Don't retry on every listener */
+			worker->uring_failed = true;
+			isc_log_write(isc_lctx, ISC_LOGCATEGORY_GENERAL,
+				      ISC_LOGMODULE_NETMGR, ISC_LOG_WARNING,
+				      "io_uring engine not available on loop "
+				      "%" PRIu32 ", using libuv: %s",
+				      worker->loop->tid,
+				      isc_result_totext(result));
+			return (result);
+		}
+	}
+
+	result = uring_recvmsg(worker->uring, sock);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	/* The in-flight multishot request holds a reference to the socket */
+	isc__nmsocket_attach(sock, &(isc_nmsocket_t *){ NULL });
+	sock->uring_reading = true;
+
+	return (ISC_R_SUCCESS);
+}
+
+void
+isc__nm_uring_udp_recv_stop(isc_nmsocket_t *sock) {
+	isc__nm_uring_t *ring = NULL;
+	struct io_uring_sqe *sqe = NULL;
+
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(sock->tid == isc_tid());
+
+	if (!sock->uring_reading) {
+		return;
+	}
+
+	/*
+	 * The socket reference is released when the final completion for
+	 * the multishot request arrives.
+	 */
+	sock->uring_reading = false;
+
+	ring = sock->worker->uring;
+	INSIST(ring != NULL);
+
+	sqe = uring_get_sqe(ring);
+	RUNTIME_CHECK(sqe != NULL);
+
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = (uint64_t)(uintptr_t)sock;
+	sqe->user_data = (uint64_t)(uintptr_t)sock | URING_CANCEL_TAG;
+
+	RUNTIME_CHECK(uring_submit(ring) == ISC_R_SUCCESS);
+	ring->inflight++;
+}
+
+void
+isc__nm_uring_shutdown(isc__networker_t *worker) {
+	isc__nm_uring_t *ring = worker->uring;
+
+	if (ring == NULL) {
+		return;
+	}
+
+	ring->shuttingdown = true;
+
+	uring_maybe_close(ring);
+}
@@ -0,0 +1,1216 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * AF_XDP fast path for the UDP listeners.
+ *
+ * When an interface is configured with isc_nm_setxdp(), a small XDP
+ * program is attached to it.  The program looks up the destination
+ * address and port of every untagged, unfragmented IPv4 or IPv6 UDP
+ * packet in a hash map of the addresses the UDP listeners are bound to,
+ * and redirects the matching packets to the AF_XDP socket registered
+ * for the receive queue the packet arrived on.  Everything else is
+ * passed to the kernel network stack.
+ *
+ * Receive queue N is served by the AF_XDP socket of network worker N,
+ * so the NIC's receive side scaling spreads the queries over the loops
+ * the same way SO_REUSEPORT does for the regular sockets.  Each AF_XDP
+ * socket has its own UMEM; half of the frames are used for receiving
+ * and half for sending.  The received datagrams are handed to
+ * isc__nm_udp_recv() directly from the UMEM frame, and the frame is
+ * returned to the fill ring as soon as the (synchronous) read callback
+ * returns.  The responses are written into a free UMEM frame with the
+ * Ethernet, IP and UDP headers built from the headers of the query.
+ *
+ * The AF_XDP sockets are an accelerator for the regular UDP sockets,
+ * not a replacement: the listener sockets keep receiving through libuv
+ * (the queries passed to the kernel, e.g. on queues without an AF_XDP
+ * socket, still arrive there), and the responses that can't be sent
+ * through AF_XDP are sent through the regular socket.
+ *
+ * All the setup requiring privileges is done from isc_nm_setxdp(),
+ * before the server drops its capabilities; the per-loop parts are
+ * started lazily when the first UDP listener starts on the loop.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/if_xdp.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <isc/atomic.h>
+#include <isc/errno.h>
+#include <isc/log.h>
+#include <isc/mem.h>
+#include <isc/netaddr.h>
+#include <isc/netmgr.h>
+#include <isc/result.h>
+#include <isc/sockaddr.h>
+#include <isc/util.h>
+#include <isc/uv.h>
+
+#include "../loop_p.h"
+#include "netmgr-int.h"
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif /* ifndef AF_XDP */
+
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif /* ifndef SOL_XDP */
+
+/*
+ * UMEM layout: XDP_NFRAMES frames of XDP_FRAME_SIZE bytes; the first
+ * XDP_RING_SIZE frames are owned by the fill and receive rings, the
+ * rest by the transmit and completion rings.
+ */
+#define XDP_FRAME_SIZE 2048
+#define XDP_RING_SIZE  2048
+#define XDP_NFRAMES    (2 * XDP_RING_SIZE)
+
+STATIC_ASSERT((XDP_RING_SIZE & (XDP_RING_SIZE - 1)) == 0,
+	      "the AF_XDP ring size must be a power of 2");
+
+/*
+ * Maximum number of distinct listener addresses on the interface.
+ */
+#define XDP_MAXADDRS 1024
+
+/*
+ * Size of the per-loop cache of the Ethernet addresses of the clients
+ * seen in the received queries, used for sending the responses.
+ */
+#define XDP_NEIGH_SIZE 4096
+
+STATIC_ASSERT((XDP_NEIGH_SIZE & (XDP_NEIGH_SIZE - 1)) == 0,
+	      "the AF_XDP neighbour cache size must be a power of 2");
+
+/*
+ * Header offsets in the frames; IPv4 headers with options are passed to
+ * the kernel by the XDP program.
+ */
+#define XDP_ETH_HLEN  14
+#define XDP_IP4_HLEN  20
+#define XDP_IP6_HLEN  40
+#define XDP_UDP_HLEN  8
+#define XDP_IP4_UDPOFF (XDP_ETH_HLEN + XDP_IP4_HLEN)
+#define XDP_IP6_UDPOFF (XDP_ETH_HLEN + XDP_IP6_HLEN)
+
+/*
+ * The key of the listener address map; the port is in network byte
+ * order, the family is AF_INET or AF_INET6.
+ */
+typedef struct xdp_key {
+	uint8_t addr[16];
+	uint16_t port;
+	uint16_t family;
+} xdp_key_t;
+
+STATIC_ASSERT(sizeof(xdp_key_t) == 20, "unexpected padding in xdp_key_t");
+
+typedef struct xdp_ring {
+	uint32_t *producer;
+	uint32_t *consumer;
+	uint32_t *flags;
+	void *descs;
+	void *map;
+	size_t mapsize;
+} xdp_ring_t;
+
+typedef struct xdp_neigh {
+	isc_netaddr_t addr;
+	uint8_t local[ETH_ALEN];
+	uint8_t remote[ETH_ALEN];
+	bool valid;
+} xdp_neigh_t;
+
+struct isc__nm_xdp {
+	unsigned int ifindex;
+	int addrs_fd;
+	int xsks_fd;
+	int prog_fd;
+	int link_fd;
+};
+
+struct isc__nm_xsk {
+	isc__networker_t *worker;
+	int fd;
+	int addrs_fd;
+	uv_poll_t poll;
+	bool polling;
+	bool shuttingdown;
+	bool inpoll;
+	bool txkick;
+
+	uint8_t *umem;
+	xdp_ring_t fill;
+	xdp_ring_t comp;
+	xdp_ring_t rx;
+	xdp_ring_t tx;
+
+	uint64_t txfree[XDP_RING_SIZE];
+	size_t ntxfree;
+
+	isc_nmsocket_t **socks;
+	size_t nsocks;
+
+	xdp_neigh_t neigh[XDP_NEIGH_SIZE];
+};
+
+#define xdp_load_acquire(p) \
+	atomic_load_explicit((_Atomic(uint32_t) *)(p), memory_order_acquire)
+#define xdp_store_release(p, v)                                  \
+	atomic_store_explicit((_Atomic(uint32_t) *)(p), (v), \
+			      memory_order_release)
+
+/*
+ * eBPF
+ */
+
+static int
+xdp_bpf(int cmd, union bpf_attr *attr) {
+	return (syscall(__NR_bpf, cmd, attr, sizeof(*attr)));
+}
+
+static int
+xdp_map_create(enum bpf_map_type type, uint32_t keysize, uint32_t valuesize,
+	       uint32_t maxentries) {
+	union bpf_attr attr = {
+		.map_type = type,
+		.key_size = keysize,
+		.value_size = valuesize,
+		.max_entries = maxentries,
+	};
+
+	return (xdp_bpf(BPF_MAP_CREATE, &attr));
+}
+
+static int
+xdp_map_update(int fd, const void *key, const void *value) {
+	union bpf_attr attr = {
+		.map_fd = fd,
+		.key = (uint64_t)(uintptr_t)key,
+		.value = (uint64_t)(uintptr_t)value,
+		.flags = BPF_ANY,
+	};
+
+	return (xdp_bpf(BPF_MAP_UPDATE_ELEM, &attr));
+}
+
+static int
+xdp_map_delete(int fd, const void *key) {
+	union bpf_attr attr = {
+		.map_fd = fd,
+		.key = (uint64_t)(uintptr_t)key,
+	};
+
+	return (xdp_bpf(BPF_MAP_DELETE_ELEM, &attr));
+}
+
+#define BPF_INSN(c, d, s, o, i)                                            \
+	((struct bpf_insn){ .code = (c),                                   \
+			    .dst_reg = (d),                                \
+			    .src_reg = (s),                                \
+			    .off = (o),                                    \
+			    .imm = (i) })
+#define BPF_MOV64_REG(d, s) BPF_INSN(BPF_ALU64 | BPF_MOV | BPF_X, d, s, 0, 0)
+#define BPF_MOV64_IMM(d, i) BPF_INSN(BPF_ALU64 | BPF_MOV | BPF_K, d, 0, 0, i)
+#define BPF_ALU64_IMM(op, d, i) BPF_INSN(BPF_ALU64 | (op) | BPF_K, d, 0, 0, i)
+#define BPF_LDX_MEM(sz, d, s, o) \
+	BPF_INSN(BPF_LDX | BPF_MEM | (sz), d, s, o, 0)
+#define BPF_STX_MEM(sz, d, s, o) \
+	BPF_INSN(BPF_STX | BPF_MEM | (sz), d, s, o, 0)
+#define BPF_ST_MEM(sz, d, o, i) BPF_INSN(BPF_ST | BPF_MEM | (sz), d, 0, o, i)
+#define BPF_CALL_FUNC(f)	BPF_INSN(BPF_JMP | BPF_CALL, 0, 0, 0, f)
+#define BPF_EXIT_INSN()		BPF_INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0)
+
+/*
+ * Registers of the eBPF virtual machine.
+ */
+enum { R0, R1, R2, R3, R4, R5, R6, R7, R8, R9, R10 };
+
+/*
+ * Jump targets of the XDP program.
+ */
+enum { L_IPV6, L_LOOKUP, L_PASS, L_MAX };
+
+#define XDP_PROG_MAXINSNS 64
+#define XDP_PROG_MAXJUMPS 16
+
+typedef struct xdp_prog {
+	struct bpf_insn insns[XDP_PROG_MAXINSNS];
+	size_t ninsns;
+	struct {
+		size_t insn;
+		int label;
+	} jumps[XDP_PROG_MAXJUMPS];
+	size_t njumps;
+	size_t labels[L_MAX];
+} xdp_prog_t;
+
+static void
+emit(xdp_prog_t *prog, struct bpf_insn insn) {
+	INSIST(prog->ninsns < XDP_PROG_MAXINSNS);
+	prog->insns[prog->ninsns++] = insn;
+}
+
+static void
+emit_jump(xdp_prog_t *prog, struct bpf_insn insn, int label) {
+	INSIST(prog->njumps < XDP_PROG_MAXJUMPS);
+	prog->jumps[prog->njumps].insn = prog->ninsns;
+	prog->jumps[prog->njumps].label = label;
+	prog->njumps++;
+	emit(prog, insn);
+}
+
+#define EMIT(insn) emit(&prog, insn)
+#define JMP_IMM(op, d, i, l) \
+	emit_jump(&prog, BPF_INSN(BPF_JMP | (op) | BPF_K, d, 0, 0, i), l)
+#define JMP_REG(op, d, s, l) \
+	emit_jump(&prog, BPF_INSN(BPF_JMP | (op) | BPF_X, d, s, 0, 0), l)
+#define LABEL(l) prog.labels[l] = prog.ninsns
+#define LD_MAP_FD(d, fd)                                                 \
+	EMIT(BPF_INSN(BPF_LD | BPF_DW | BPF_IMM, d, BPF_PSEUDO_MAP_FD, 0, \
+		      fd));                                              \
+	EMIT(BPF_INSN(0, 0, 0, 0, 0))
+
+static int
+xdp_prog_load(int addrs_fd, int xsks_fd) {
+	xdp_prog_t prog = { .ninsns = 0 };
+	union bpf_attr attr;
+
+	/* r6 = ctx, r2 = packet start, r3 = packet end */
+	EMIT(BPF_MOV64_REG(R6, R1));
+	EMIT(BPF_LDX_MEM(BPF_W, R2, R1, offsetof(struct xdp_md, data)));
+	EMIT(BPF_LDX_MEM(BPF_W, R3, R1, offsetof(struct xdp_md, data_end)));
+
+	/* The xdp_key_t is at fp - 24 */
+	EMIT(BPF_ST_MEM(BPF_DW, R10, -24, 0));
+	EMIT(BPF_ST_MEM(BPF_DW, R10, -16, 0));
+	EMIT(BPF_ST_MEM(BPF_DW, R10, -8, 0));
+
+	/* Ethernet, IPv4 and UDP headers */
+	EMIT(BPF_MOV64_REG(R4, R2));
+	EMIT(BPF_ALU64_IMM(BPF_ADD, R4, XDP_IP4_UDPOFF + XDP_UDP_HLEN));
+	JMP_REG(BPF_JGT, R4, R3, L_PASS);
+	EMIT(BPF_LDX_MEM(BPF_H, R4, R2, 12));
+	JMP_IMM(BPF_JNE, R4, htons(ETH_P_IP), L_IPV6);
+
+	/* IPv4 without options, not fragmented, carrying UDP */
+	EMIT(BPF_LDX_MEM(BPF_B, R4, R2, XDP_ETH_HLEN));
+	JMP_IMM(BPF_JNE, R4, 0x45, L_PASS);
+	EMIT(BPF_LDX_MEM(BPF_B, R4, R2, XDP_ETH_HLEN + 9));
+	JMP_IMM(BPF_JNE, R4, IPPROTO_UDP, L_PASS);
+	EMIT(BPF_LDX_MEM(BPF_H, R4, R2, XDP_ETH_HLEN + 6));
+	EMIT(BPF_ALU64_IMM(BPF_AND, R4, htons(0x3fff)));
+	JMP_IMM(BPF_JNE, R4, 0, L_PASS);
+	EMIT(BPF_LDX_MEM(BPF_W, R4, R2, XDP_ETH_HLEN + 16));
+	EMIT(BPF_STX_MEM(BPF_W, R10, R4, -24));
+	EMIT(BPF_LDX_MEM(BPF_H, R4, R2, XDP_IP4_UDPOFF + 2));
+	EMIT(BPF_STX_MEM(BPF_H, R10, R4, -8));
+	EMIT(BPF_ST_MEM(BPF_H, R10, -6, AF_INET));
+	emit_jump(&prog, BPF_INSN(BPF_JMP | BPF_JA, 0, 0, 0, 0), L_LOOKUP);
+
+	/* IPv6 without extension headers, carrying UDP */
+	LABEL(L_IPV6);
+	JMP_IMM(BPF_JNE, R4, htons(ETH_P_IPV6), L_PASS);
+	EMIT(BPF_MOV64_REG(R4, R2));
+	EMIT(BPF_ALU64_IMM(BPF_ADD, R4, XDP_IP6_UDPOFF + XDP_UDP_HLEN));
+	JMP_REG(BPF_JGT, R4, R3, L_PASS);
+	EMIT(BPF_LDX_MEM(BPF_B, R4, R2, XDP_ETH_HLEN + 6));
+	JMP_IMM(BPF_JNE, R4, IPPROTO_UDP, L_PASS);
+	for (int i = 0; i < 4; i++) {
+		EMIT(BPF_LDX_MEM(BPF_W, R4, R2, XDP_ETH_HLEN + 24 + 4 * i));
+		EMIT(BPF_STX_MEM(BPF_W, R10, R4, -24 + 4 * i));
+	}
+	EMIT(BPF_LDX_MEM(BPF_H, R4, R2, XDP_IP6_UDPOFF + 2));
+	EMIT(BPF_STX_MEM(BPF_H, R10, R4, -8));
+	EMIT(BPF_ST_MEM(BPF_H, R10, -6, AF_INET6));
+
+	/* Redirect to the AF_XDP socket of the queue if it is ours */
+	LABEL(L_LOOKUP);
+	LD_MAP_FD(R1, addrs_fd);
+	EMIT(BPF_MOV64_REG(R2, R10));
+	EMIT(BPF_ALU64_IMM(BPF_ADD, R2, -24));
+	EMIT(BPF_CALL_FUNC(BPF_FUNC_map_lookup_elem));
+	JMP_IMM(BPF_JEQ, R0, 0, L_PASS);
+	EMIT(BPF_LDX_MEM(BPF_W, R2, R6,
+			 offsetof(struct xdp_md, rx_queue_index)));
+	LD_MAP_FD(R1, xsks_fd);
+	EMIT(BPF_MOV64_IMM(R3, XDP_PASS));
+	EMIT(BPF_CALL_FUNC(BPF_FUNC_redirect_map));
+	EMIT(BPF_EXIT_INSN());
+
+	LABEL(L_PASS);
+	EMIT(BPF_MOV64_IMM(R0, XDP_PASS));
+	EMIT(BPF_EXIT_INSN());
+
+	for (size_t i = 0; i < prog.njumps; i++) {
+		size_t insn = prog.jumps[i].insn;
+		prog.insns[insn].off = prog.labels[prog.jumps[i].label] -
+				       insn - 1;
+	}
+
+	attr = (union bpf_attr){
+		.prog_type = BPF_PROG_TYPE_XDP,
+		.insns = (uint64_t)(uintptr_t)prog.insns,
+		.insn_cnt = prog.ninsns,
+		.license = (uint64_t)(uintptr_t) "MPL-2.0",
+		.expected_attach_type = BPF_XDP,
+	};
+
+	return (xdp_bpf(BPF_PROG_LOAD, &attr));
+}
+
+#undef EMIT
+#undef JMP_IMM
+#undef JMP_REG
+#undef LABEL
+#undef LD_MAP_FD
+
+static void
+xdp_key_fromsockaddr(xdp_key_t *key, const isc_sockaddr_t *sa) {
+	*key = (xdp_key_t){ .family = sa->type.sa.sa_family };
+
+	switch (sa->type.sa.sa_family) {
+	case AF_INET:
+		memmove(key->addr, &sa->type.sin.sin_addr, 4);
+		key->port = sa->type.sin.sin_port;
+		break;
+	case AF_INET6:
+		memmove(key->addr, &sa->type.sin6.sin6_addr, 16);
+		key->port = sa->type.sin6.sin6_port;
+		break;
+	default:
+		UNREACHABLE();
+	}
+}
+
+/*
+ * AF_XDP sockets
+ */
+
+static void
+xdp_ring_unmap(xdp_ring_t *ring) {
+	if (ring->map != NULL) {
+		munmap(ring->map, ring->mapsize);
+		ring->map = NULL;
+	}
+}
+
+static isc_result_t
+xdp_ring_map(int fd, xdp_ring_t *ring, const struct xdp_ring_offset *off,
+	     size_t descsize, off_t pgoff) {
+	void *map = NULL;
+
+	ring->mapsize = off->desc + XDP_RING_SIZE * descsize;
+	map = mmap(NULL, ring->mapsize, PROT_READ | PROT_WRITE,
+		   MAP_SHARED | MAP_POPULATE, fd, pgoff);
+	if (map == MAP_FAILED) {
+		return (isc_errno_toresult(errno));
+	}
+
+	ring->map = map;
+	ring->producer = (uint32_t *)((char *)map + off->producer);
+	ring->consumer = (uint32_t *)((char *)map + off->consumer);
+	ring->flags = (uint32_t *)((char *)map + off->flags);
+	ring->descs = (char *)map + off->desc;
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+xsk_destroy(isc__nm_xsk_t **xskp) {
+	isc__nm_xsk_t *xsk = *xskp;
+	isc__networker_t *worker = xsk->worker;
+
+	*xskp = NULL;
+
+	INSIST(xsk->nsocks == 0);
+
+	xdp_ring_unmap(&xsk->fill);
+	xdp_ring_unmap(&xsk->comp);
+	xdp_ring_unmap(&xsk->rx);
+	xdp_ring_unmap(&xsk->tx);
+	if (xsk->fd >= 0) {
+		close(xsk->fd);
+	}
+	if (xsk->umem != NULL) {
+		munmap(xsk->umem, XDP_NFRAMES * XDP_FRAME_SIZE);
+	}
+	isc_mem_put(worker->mctx, xsk, sizeof(*xsk));
+}
+
+static isc_result_t
+xsk_bind(isc__nm_xsk_t *xsk, isc__nm_xdp_t *xdp, uint32_t queue) {
+	struct sockaddr_xdp sxdp = {
+		.sxdp_family = AF_XDP,
+		.sxdp_ifindex = xdp->ifindex,
+		.sxdp_queue_id = queue,
+		.sxdp_flags = XDP_USE_NEED_WAKEUP | XDP_ZEROCOPY,
+	};
+
+	if (bind(xsk->fd, (struct sockaddr *)&sxdp, sizeof(sxdp)) == 0) {
+		return (ISC_R_SUCCESS);
+	}
+
+	/* The driver does not support zero copy mode */
+	sxdp.sxdp_flags = XDP_USE_NEED_WAKEUP | XDP_COPY;
+	if (bind(xsk->fd, (struct sockaddr *)&sxdp, sizeof(sxdp)) == 0) {
+		return (ISC_R_SUCCESS);
+	}
+
+	return (isc_errno_toresult(errno));
+}
+
+static isc_result_t
+xsk_create(isc__networker_t *worker, isc__nm_xdp_t *xdp, uint32_t queue,
+	   isc__nm_xsk_t **xskp) {
+	isc__nm_xsk_t *xsk = NULL;
+	struct xdp_umem_reg reg;
+	struct xdp_mmap_offsets off;
+	socklen_t offlen = sizeof(off);
+	unsigned int ringsize = XDP_RING_SIZE;
+	uint32_t fd;
+	isc_result_t result;
+	void *umem = NULL;
+
+	xsk = isc_mem_get(worker->mctx, sizeof(*xsk));
+	*xsk = (isc__nm_xsk_t){
+		.worker = worker,
+		.fd = -1,
+		.addrs_fd = xdp->addrs_fd,
+	};
+
+	umem = mmap(NULL, XDP_NFRAMES * XDP_FRAME_SIZE, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (umem == MAP_FAILED) {
+		result = ISC_R_NOMEMORY;
+		goto fail;
+	}
+	xsk->umem = umem;
+
+	xsk->fd = socket(AF_XDP, SOCK_RAW | SOCK_CLOEXEC, 0);
+	if (xsk->fd < 0) {
+		result = isc_errno_toresult(errno);
+		goto fail;
+	}
+
+	reg = (struct xdp_umem_reg){
+		.addr = (uint64_t)(uintptr_t)xsk->umem,
+		.len = XDP_NFRAMES * XDP_FRAME_SIZE,
+		.chunk_size = XDP_FRAME_SIZE,
+	};
+	if (setsockopt(xsk->fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) <
+		    0 ||
+	    setsockopt(xsk->fd, SOL_XDP, XDP_UMEM_FILL_RING, &ringsize,
+		       sizeof(ringsize)) < 0 ||
+	    setsockopt(xsk->fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &ringsize,
+		       sizeof(ringsize)) < 0 ||
+	    setsockopt(xsk->fd, SOL_XDP, XDP_RX_RING, &ringsize,
+		       sizeof(ringsize)) < 0 ||
+	    setsockopt(xsk->fd, SOL_XDP, XDP_TX_RING, &ringsize,
+		       sizeof(ringsize)) < 0 ||
+	    getsockopt(xsk->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &offlen) < 0)
+	{
+		result = isc_errno_toresult(errno);
+		goto fail;
+	}
+
+	result = xdp_ring_map(xsk->fd, &xsk->fill, &off.fr, sizeof(uint64_t),
+			      XDP_UMEM_PGOFF_FILL_RING);
+	if (result != ISC_R_SUCCESS) {
+		goto fail;
+	}
+	result = xdp_ring_map(xsk->fd, &xsk->comp, &off.cr, sizeof(uint64_t),
+			      XDP_UMEM_PGOFF_COMPLETION_RING);
+	if (result != ISC_R_SUCCESS) {
+		goto fail;
+	}
+	result = xdp_ring_map(xsk->fd, &xsk->rx, &off.rx,
+			      sizeof(struct xdp_desc), XDP_PGOFF_RX_RING);
+	if (result != ISC_R_SUCCESS) {
+		goto fail;
+	}
+	result = xdp_ring_map(xsk->fd, &xsk->tx, &off.tx,
+			      sizeof(struct xdp_desc), XDP_PGOFF_TX_RING);
+	if (result != ISC_R_SUCCESS) {
+		goto fail;
+	}
+
+	/* Hand the receive frames to the kernel */
+	for (uint32_t i = 0; i < XDP_RING_SIZE; i++) {
+		((uint64_t *)xsk->fill.descs)[i] = (uint64_t)i * XDP_FRAME_SIZE;
+	}
+	xdp_store_release(xsk->fill.producer, XDP_RING_SIZE);
+
+	for (uint32_t i = 0; i < XDP_RING_SIZE; i++) {
+		xsk->txfree[i] = (uint64_t)(XDP_RING_SIZE + i) * XDP_FRAME_SIZE;
+	}
+	xsk->ntxfree = XDP_RING_SIZE;
+
+	result = xsk_bind(xsk, xdp, queue);
+	if (result != ISC_R_SUCCESS) {
+		goto fail;
+	}
+
+	fd = xsk->fd;
+	if (xdp_map_update(xdp->xsks_fd, &queue, &fd) < 0) {
+		result = isc_errno_toresult(errno);
+		goto fail;
+	}
+
+	*xskp = xsk;
+	return (ISC_R_SUCCESS);
+
+fail:
+	xsk_destroy(&xsk);
+	return (result);
+}
+
+/*
+ * Packets
+ */
+
+static uint32_t
+xdp_csum_add(uint32_t sum, const uint8_t *data, size_t len) {
+	for (; len > 1; data += 2, len -= 2) {
+		sum += (data[0] << 8) | data[1];
+	}
+	if (len > 0) {
+		sum += data[0] << 8;
+	}
+	return (sum);
+}
+
+static uint16_t
+xdp_csum_fold(uint32_t sum) {
+	while ((sum >> 16) != 0) {
+		sum = (sum & 0xffff) + (sum >> 16);
+	}
+	return (~sum & 0xffff);
+}
+
+static void
+xdp_put16(uint8_t *p, uint16_t v) {
+	p[0] = v >> 8;
+	p[1] = v & 0xff;
+}
+
+static uint16_t
+xdp_get16(const uint8_t *p) {
+	return ((p[0] << 8) | p[1]);
+}
+
+static xdp_neigh_t *
+xdp_neigh(isc__nm_xsk_t *xsk, const isc_sockaddr_t *peer) {
+	return (&xsk->neigh[isc_sockaddr_hash(peer, true) &
+			    (XDP_NEIGH_SIZE - 1)]);
+}
+
+static void
+xdp_neigh_learn(isc__nm_xsk_t *xsk, const isc_sockaddr_t *peer,
+		const uint8_t *frame) {
+	xdp_neigh_t *neigh = xdp_neigh(xsk, peer);
+
+	isc_netaddr_fromsockaddr(&neigh->addr, peer);
+	memmove(neigh->local, frame, ETH_ALEN);
+	memmove(neigh->remote, frame + ETH_ALEN, ETH_ALEN);
+	neigh->valid = true;
+}
+
+static isc_nmsocket_t *
+xdp_findsock(isc__nm_xsk_t *xsk, const xdp_key_t *key) {
+	for (size_t i = 0; i < xsk->nsocks; i++) {
+		xdp_key_t skey;
+
+		xdp_key_fromsockaddr(&skey, &xsk->socks[i]->iface);
+		if (memcmp(&skey, key, sizeof(skey)) == 0) {
+			return (xsk->socks[i]);
+		}
+	}
+	return (NULL);
+}
+
+/*
+ * Parse the headers of a received frame that the XDP program redirected
+ * to us and dispatch the datagram.
+ */
+static void
+xdp_recv_frame(isc__nm_xsk_t *xsk, uint8_t *frame, uint32_t len) {
+	isc_nmsocket_t *sock = NULL;
+	isc_sockaddr_t peer;
+	xdp_key_t key = { .family = 0 };
+	struct sockaddr_storage ss = { .ss_family = 0 };
+	uint8_t *udp = NULL;
+	uint16_t udplen;
+	isc_result_t result;
+
+	switch (xdp_get16(frame + 12)) {
+	case ETH_P_IP: {
+		struct sockaddr_in *sin = (struct sockaddr_in *)&ss;
+
+		if (len < XDP_IP4_UDPOFF + XDP_UDP_HLEN) {
+			return;
+		}
+		udp = frame + XDP_IP4_UDPOFF;
+
+		key.family = AF_INET;
+		memmove(key.addr, frame + XDP_ETH_HLEN + 16, 4);
+
+		sin->sin_family = AF_INET;
+		memmove(&sin->sin_addr, frame + XDP_ETH_HLEN + 12, 4);
+		memmove(&sin->sin_port, udp, 2);
+		break;
+	}
+	case ETH_P_IPV6: {
+		struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)&ss;
+
+		if (len < XDP_IP6_UDPOFF + XDP_UDP_HLEN) {
+			return;
+		}
+		udp = frame + XDP_IP6_UDPOFF;
+
+		key.family = AF_INET6;
+		memmove(key.addr, frame + XDP_ETH_HLEN + 24, 16);
+
+		sin6->sin6_family = AF_INET6;
+		memmove(&sin6->sin6_addr, frame + XDP_ETH_HLEN + 8, 16);
+		memmove(&sin6->sin6_port, udp, 2);
+		break;
+	}
+	default:
+		return;
+	}
+
+	memmove(&key.port, udp + 2, sizeof(key.port));
+	udplen = xdp_get16(udp + 4);
+	if (udplen < XDP_UDP_HLEN || udp + udplen > frame + len) {
+		return;
+	}
+
+	sock = xdp_findsock(xsk, &key);
+	if (sock == NULL) {
+		return;
+	}
+
+	result = isc_sockaddr_fromsockaddr(&peer, (struct sockaddr *)&ss);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	xdp_neigh_learn(xsk, &peer, frame);
+
+	isc__nm_udp_recv(sock, ISC_R_SUCCESS, udp + XDP_UDP_HLEN,
+			 udplen - XDP_UDP_HLEN, (struct sockaddr *)&ss);
+}
+
+static void
+xdp_reap_completions(isc__nm_xsk_t *xsk) {
+	uint32_t cons = *xsk->comp.consumer;
+	uint32_t prod = xdp_load_acquire(xsk->comp.producer);
+	uint64_t *addrs = xsk->comp.descs;
+
+	for (; cons != prod; cons++) {
+		INSIST(xsk->ntxfree < XDP_RING_SIZE);
+		xsk->txfree[xsk->ntxfree++] = addrs[cons & (XDP_RING_SIZE - 1)];
+	}
+
+	xdp_store_release(xsk->comp.consumer, cons);
+}
+
+static void
+xdp_kick(isc__nm_xsk_t *xsk) {
+	xsk->txkick = false;
+
+	if ((xdp_load_acquire(xsk->tx.flags) & XDP_RING_NEED_WAKEUP) != 0) {
+		(void)sendto(xsk->fd, NULL, 0, MSG_DONTWAIT, NULL, 0);
+	}
+}
+
+static void
+xdp_poll_cb(uv_poll_t *handle, int status, int events) {
+	isc__nm_xsk_t *xsk = uv_handle_get_data((uv_handle_t *)handle);
+	struct xdp_desc *descs = xsk->rx.descs;
+	uint64_t *fill = xsk->fill.descs;
+	uint32_t cons, prod, fillprod;
+
+	UNUSED(status);
+	UNUSED(events);
+
+	REQUIRE(xsk->worker->loop->tid == isc_tid());
+
+	xsk->inpoll = true;
+
+	xdp_reap_completions(xsk);
+
+	cons = *xsk->rx.consumer;
+	prod = xdp_load_acquire(xsk->rx.producer);
+	fillprod = *xsk->fill.producer;
+
+	while (cons != prod) {
+		struct xdp_desc desc = descs[cons & (XDP_RING_SIZE - 1)];
+
+		xdp_recv_frame(xsk, xsk->umem + desc.addr, desc.len);
+
+		/* Recycle the frame */
+		fill[fillprod & (XDP_RING_SIZE - 1)] =
+			desc.addr & ~((uint64_t)XDP_FRAME_SIZE - 1);
+		cons++;
+		fillprod++;
+
+		if (cons == prod) {
+			xdp_store_release(xsk->rx.consumer, cons);
+			xdp_store_release(xsk->fill.producer, fillprod);
+			prod = xdp_load_acquire(xsk->rx.producer);
+		}
+	}
+
+	if ((xdp_load_acquire(xsk->fill.flags) & XDP_RING_NEED_WAKEUP) != 0) {
+		(void)recvfrom(xsk->fd, NULL, 0, MSG_DONTWAIT, NULL, NULL);
+	}
+
+	xsk->inpoll = false;
+
+	if (xsk->txkick) {
+		xdp_kick(xsk);
+	}
+}
+
+static void
+xdp_close_cb(uv_handle_t *handle) {
+	isc__nm_xsk_t *xsk = uv_handle_get_data(handle);
+	isc__networker_t *worker = xsk->worker;
+
+	INSIST(worker->xsk == xsk);
+	worker->xsk = NULL;
+
+	xsk_destroy(&xsk);
+	isc__networker_detach(&worker);
+}
+
+static void
+xdp_maybe_close(isc__nm_xsk_t *xsk) {
+	isc__networker_t *worker = xsk->worker;
+
+	if (!xsk->shuttingdown || xsk->nsocks > 0) {
+		return;
+	}
+
+	if (!xsk->polling) {
+		worker->xsk = NULL;
+		xsk_destroy(&xsk);
+		return;
+	}
+
+	if (!uv_is_closing((uv_handle_t *)&xsk->poll)) {
+		uv_close((uv_handle_t *)&xsk->poll, xdp_close_cb);
+	}
+}
+
+/*
+ * Internal API
+ */
+
+void
+isc__nm_xdp_detach(isc_nm_t *mgr) {
+	isc__nm_xdp_t *xdp = mgr->xdp;
+
+	if (xdp == NULL) {
+		return;
+	}
+
+	mgr->xdp = NULL;
+
+	/* Closing the link detaches the program from the interface */
+	if (xdp->link_fd >= 0) {
+		close(xdp->link_fd);
+	}
+	if (xdp->prog_fd >= 0) {
+		close(xdp->prog_fd);
+	}
+	if (xdp->xsks_fd >= 0) {
+		close(xdp->xsks_fd);
+	}
+	if (xdp->addrs_fd >= 0) {
+		close(xdp->addrs_fd);
+	}
+	isc_mem_put(mgr->mctx, xdp, sizeof(*xdp));
+}
+
+isc_result_t
+isc__nm_xdp_attach(isc_nm_t *mgr, const char *ifname) {
+	isc__nm_xdp_t *xdp = NULL;
+	union bpf_attr attr;
+	uint32_t nxsks = 0;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	REQUIRE(VALID_NM(mgr));
+	REQUIRE(mgr->xdp == NULL);
+
+	xdp = isc_mem_get(mgr->mctx, sizeof(*xdp));
+	*xdp = (isc__nm_xdp_t){
+		.ifindex = if_nametoindex(ifname),
+		.addrs_fd = -1,
+		.xsks_fd = -1,
+		.prog_fd = -1,
+		.link_fd = -1,
+	};
+	mgr->xdp = xdp;
+
+	if (xdp->ifindex == 0) {
+		result = isc_errno_toresult(errno);
+		goto fail;
+	}
+
+	xdp->addrs_fd = xdp_map_create(BPF_MAP_TYPE_HASH, sizeof(xdp_key_t),
+				       sizeof(uint32_t), XDP_MAXADDRS);
+	if (xdp->addrs_fd < 0) {
+		result = isc_errno_toresult(errno);
+		goto fail;
+	}
+
+	xdp->xsks_fd = xdp_map_create(BPF_MAP_TYPE_XSKMAP, sizeof(uint32_t),
+				      sizeof(uint32_t), mgr->nloops);
+	if (xdp->xsks_fd < 0) {
+		result = isc_errno_toresult(errno);
+		goto fail;
+	}
+
+	xdp->prog_fd = xdp_prog_load(xdp->addrs_fd, xdp->xsks_fd);
+	if (xdp->prog_fd < 0) {
+		result = isc_errno_toresult(errno);
+		goto fail;
+	}
+
+	attr = (union bpf_attr){
+		.link_create = {
+			.prog_fd = xdp->prog_fd,
+			.target_ifindex = xdp->ifindex,
+			.attach_type = BPF_XDP,
+		},
+	};
+	xdp->link_fd = xdp_bpf(BPF_LINK_CREATE, &attr);
+	if (xdp->link_fd < 0) {
+		result = isc_errno_toresult(errno);
+		goto fail;
+	}
+
+	/*
+	 * Receive queue N is served by loop N; the queues the interface
+	 * does not have are left to the regular sockets.
+	 */
+	for (uint32_t i = 0; i < mgr->nloops; i++) {
+		isc__networker_t *worker = &mgr->workers[i];
+
+		result = xsk_create(worker, xdp, i, &worker->xsk);
+		if (result != ISC_R_SUCCESS) {
+			isc_log_write(isc_lctx, ISC_LOGCATEGORY_GENERAL,
+				      ISC_LOGMODULE_NETMGR, ISC_LOG_DEBUG(1),
+				      "AF_XDP socket for queue %" PRIu32
+				      " of %s not available: %s",
+				      i, ifname, isc_result_totext(result));
+			continue;
+		}
+		nxsks++;
+	}
+
+	if (nxsks == 0) {
+		goto fail;
+	}
+
+	isc_log_write(isc_lctx, ISC_LOGCATEGORY_GENERAL, ISC_LOGMODULE_NETMGR,
+		      ISC_LOG_INFO,
+		      "AF_XDP enabled on %s for %" PRIu32 " of %" PRIu32
+		      " loops",
+		      ifname, nxsks, mgr->nloops);
+
+	return (ISC_R_SUCCESS);
+
+fail:
+	isc__nm_xdp_detach(mgr);
+	return (result);
+}
+
+isc_result_t
+isc__nm_xdp_udp_recv_start(isc_nmsocket_t *sock) {
+	isc__networker_t *worker = NULL;
+	isc__nm_xsk_t *xsk = NULL;
+	xdp_key_t key;
+	uint32_t value = 1;
+	size_t nsocks;
+	int r;
+
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(sock->type == isc_nm_udpsocket);
+	REQUIRE(sock->tid == isc_tid());
+	REQUIRE(!sock->xdp_reading);
+
+	worker = sock->worker;
+	xsk = worker->xsk;
+
+	if (xsk == NULL) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	if (isc__nm_closing(worker) || xsk->shuttingdown) {
+		return (ISC_R_SHUTTINGDOWN);
+	}
+
+	/*
+	 * The responses are sent from the address the query was sent to,
+	 * so the wildcard listeners are left to the regular sockets.
+	 */
+	switch (sock->iface.type.sa.sa_family) {
+	case AF_INET:
+		if (sock->iface.type.sin.sin_addr.s_addr == INADDR_ANY) {
+			return (ISC_R_NOTIMPLEMENTED);
+		}
+		break;
+	case AF_INET6:
+		if (IN6_IS_ADDR_UNSPECIFIED(&sock->iface.type.sin6.sin6_addr))
+		{
+			return (ISC_R_NOTIMPLEMENTED);
+		}
+		break;
+	default:
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	xdp_key_fromsockaddr(&key, &sock->iface);
+	if (xdp_map_update(xsk->addrs_fd, &key, &value) < 0) {
+		return (isc_errno_toresult(errno));
+	}
+
+	if (!xsk->polling) {
+		r = uv_poll_init(&worker->loop->loop, &xsk->poll, xsk->fd);
+		if (r != 0) {
+			return (isc_uverr2result(r));
+		}
+		uv_handle_set_data((uv_handle_t *)&xsk->poll, xsk);
+
+		r = uv_poll_start(&xsk->poll, UV_READABLE, xdp_poll_cb);
+		UV_RUNTIME_CHECK(uv_poll_start, r);
+
+		/* The uv_poll_t handle holds a reference to the worker */
+		isc__networker_ref(worker);
+		xsk->polling = true;
+	}
+
+	nsocks = xsk->nsocks;
+	xsk->socks = isc_mem_reget(worker->mctx, xsk->socks,
+				   nsocks * sizeof(xsk->socks[0]),
+				   (nsocks + 1) * sizeof(xsk->socks[0]));
+	xsk->socks[nsocks] = NULL;
+	isc__nmsocket_attach(sock, &xsk->socks[nsocks]);
+	xsk->nsocks++;
+
+	sock->xdp_reading = true;
+
+	return (ISC_R_SUCCESS);
+}
+
+void
+isc__nm_xdp_udp_recv_stop(isc_nmsocket_t *sock) {
+	isc__nm_xsk_t *xsk = NULL;
+	xdp_key_t key;
+	size_t nsocks;
+
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(sock->tid == isc_tid());
+
+	if (!sock->xdp_reading) {
+		return;
+	}
+
+	sock->xdp_reading = false;
+
+	xsk = sock->worker->xsk;
+	INSIST(xsk != NULL);
+
+	/*
+	 * From now on, the queries for this address are passed to the
+	 * regular sockets on all the loops; the listener sockets on the
+	 * other loops are being closed too, or the address is going to be
+	 * added back by a new listener.
+	 */
+	xdp_key_fromsockaddr(&key, &sock->iface);
+	(void)xdp_map_delete(xsk->addrs_fd, &key);
+
+	nsocks = xsk->nsocks;
+	for (size_t i = 0; i < nsocks; i++) {
+		if (xsk->socks[i] == sock) {
+			xsk->socks[i] = xsk->socks[nsocks - 1];
+			xsk->socks[nsocks - 1] = NULL;
+			break;
+		}
+	}
+	INSIST(xsk->socks[nsocks - 1] == NULL);
+
+	xsk->socks = isc_mem_reget(sock->worker->mctx, xsk->socks,
+				   nsocks * sizeof(xsk->socks[0]),
+				   (nsocks - 1) * sizeof(xsk->socks[0]));
+	xsk->nsocks--;
+
+	isc__nmsocket_detach(&sock);
+
+	xdp_maybe_close(xsk);
+}
+
+isc_result_t
+isc__nm_xdp_udp_send(isc_nmsocket_t *sock, const isc_sockaddr_t *peer,
+		     const isc_region_t *region) {
+	isc__nm_xsk_t *xsk = NULL;
+	xdp_neigh_t *neigh = NULL;
+	isc_netaddr_t netaddr;
+	struct xdp_desc *desc = NULL;
+	uint8_t *frame = NULL, *udp = NULL;
+	uint32_t prod, len, udplen;
+	uint32_t sum;
+
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(sock->tid == isc_tid());
+	REQUIRE(sock->xdp_reading);
+
+	xsk = sock->worker->xsk;
+
+	if (peer->type.sa.sa_family != sock->iface.type.sa.sa_family) {
+		return (ISC_R_FAMILYMISMATCH);
+	}
+
+	/* We only know how to reach the clients we have heard from */
+	neigh = xdp_neigh(xsk, peer);
+	isc_netaddr_fromsockaddr(&netaddr, peer);
+	if (!neigh->valid || !isc_netaddr_equal(&neigh->addr, &netaddr)) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	udplen = XDP_UDP_HLEN + region->length;
+	len = udplen + (peer->type.sa.sa_family == AF_INET ? XDP_IP4_UDPOFF
+							    : XDP_IP6_UDPOFF);
+	if (len > XDP_FRAME_SIZE) {
+		return (ISC_R_RANGE);
+	}
+
+	if (xsk->ntxfree == 0) {
+		xdp_reap_completions(xsk);
+		if (xsk->ntxfree == 0) {
+			return (ISC_R_NORESOURCES);
+		}
+	}
+
+	/*
+	 * The TX ring can't overflow, there are only XDP_RING_SIZE
+	 * transmit frames.
+	 */
+	prod = *xsk->tx.producer;
+	desc = &((struct xdp_desc *)xsk->tx.descs)[prod & (XDP_RING_SIZE - 1)];
+	desc->addr = xsk->txfree[--xsk->ntxfree];
+	desc->len = len;
+	desc->options = 0;
+
+	frame = xsk->umem + desc->addr;
+	memmove(frame, neigh->remote, ETH_ALEN);
+	memmove(frame + ETH_ALEN, neigh->local, ETH_ALEN);
+
+	switch (peer->type.sa.sa_family) {
+	case AF_INET: {
+		uint8_t *ip = frame + XDP_ETH_HLEN;
+
+		xdp_put16(frame + 12, ETH_P_IP);
+		ip[0] = 0x45;
+		ip[1] = 0;
+		xdp_put16(ip + 2, XDP_IP4_HLEN + udplen);
+		xdp_put16(ip + 4, 0);
+		xdp_put16(ip + 6, 0x4000); /* Don't fragment */
+		ip[8] = 64;
+		ip[9] = IPPROTO_UDP;
+		xdp_put16(ip + 10, 0);
+		memmove(ip + 12, &sock->iface.type.sin.sin_addr, 4);
+		memmove(ip + 16, &peer->type.sin.sin_addr, 4);
+		xdp_put16(ip + 10,
+			  xdp_csum_fold(xdp_csum_add(0, ip, XDP_IP4_HLEN)));
+
+		udp = frame + XDP_IP4_UDPOFF;
+		memmove(udp, &sock->iface.type.sin.sin_port, 2);
+		memmove(udp + 2, &peer->type.sin.sin_port, 2);
+		xdp_put16(udp + 4, udplen);
+		/* The UDP checksum is optional with IPv4 */
+		xdp_put16(udp + 6, 0);
+		memmove(udp + XDP_UDP_HLEN, region->base, region->length);
+		break;
+	}
+	case AF_INET6: {
+		uint8_t *ip = frame + XDP_ETH_HLEN;
+		uint16_t csum;
+
+		xdp_put16(frame + 12, ETH_P_IPV6);
+		memset(ip, 0, 4);
+		ip[0] = 0x60;
+		xdp_put16(ip + 4, udplen);
+		ip[6] = IPPROTO_UDP;
+		ip[7] = 64;
+		memmove(ip + 8, &sock->iface.type.sin6.sin6_addr, 16);
+		memmove(ip + 24, &peer->type.sin6.sin6_addr, 16);
+
+		udp = frame + XDP_IP6_UDPOFF;
+		memmove(udp, &sock->iface.type.sin6.sin6_port, 2);
+		memmove(udp + 2, &peer->type.sin6.sin6_port, 2);
+		xdp_put16(udp + 4, udplen);
+		xdp_put16(udp + 6, 0);
+		memmove(udp + XDP_UDP_HLEN, region->base, region->length);
+
+		/* Pseudo-header, UDP header and payload */
+		sum = xdp_csum_add(0, ip + 8, 32);
+		sum += udplen + IPPROTO_UDP;
+		sum = xdp_csum_add(sum, udp, udplen);
+		csum = xdp_csum_fold(sum);
+		xdp_put16(udp + 6, csum == 0 ? 0xffff : csum);
+		break;
+	}
+	default:
+		UNREACHABLE();
+	}
+
+	xdp_store_release(xsk->tx.producer, prod + 1);
+
+	/* The sends from the read callbacks are kicked off together */
+	xsk->txkick = true;
+	if (!xsk->inpoll) {
+		xdp_kick(xsk);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+void
+isc__nm_xdp_shutdown(isc__networker_t *worker) {
+	isc__nm_xsk_t *xsk = worker->xsk;
+
+	if (xsk == NULL) {
+		return;
+	}
+
+	xsk->shuttingdown = true;
+
+	xdp_maybe_close(xsk);
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <isc/net.h>
+#include <isc/proxy2.h>
+#include <isc/region.h>
+#include <isc/sockaddr.h>
+#include <isc/util.h>
+
+static const uint8_t proxy2_signature[12] = { 0x0D, 0x0A, 0x0D, 0x0A,
+					      0x00, 0x0D, 0x0A, 0x51,
+					      0x55, 0x49, 0x54, 0x0A };
+
+/*
+ * The address families and transport protocols in the fourteenth byte.
+ */
+#define PROXY2_AF_UNSPEC 0x0
+#define PROXY2_AF_INET	 0x1
+#define PROXY2_AF_INET6	 0x2
+#define PROXY2_AF_UNIX	 0x3
+
+#define PROXY2_PROTO_UNSPEC 0x0
+#define PROXY2_PROTO_STREAM 0x1
+#define PROXY2_PROTO_DGRAM  0x2
+
+static uint16_t
+proxy2_get16(const uint8_t *p) {
+	return ((p[0] << 8) | p[1]);
+}
+
+isc_result_t
+isc_proxy2_parse(const isc_region_t *region, isc_proxy2_t *proxy) {
+	const uint8_t *p = NULL;
+	unsigned int version, command, family, protocol;
+	size_t alen;
+
+	REQUIRE(region != NULL);
+	REQUIRE(proxy != NULL);
+
+	p = region->base;
+
+	if (memcmp(p, proxy2_signature,
+		   ISC_MIN(region->length, sizeof(proxy2_signature))) != 0)
+	{
+		return (ISC_R_UNEXPECTEDTOKEN);
+	}
+
+	if (region->length < ISC_PROXY2_HEADER_SIZE) {
+		return (ISC_R_NOMORE);
+	}
+
+	version = p[12] >> 4;
+	command = p[12] & 0x0f;
+	family = p[13] >> 4;
+	protocol = p[13] & 0x0f;
+	alen = proxy2_get16(p + 14);
+
+	if (version != 2) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	if (command != ISC_PROXY2_CMD_LOCAL && command != ISC_PROXY2_CMD_PROXY)
+	{
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	if (family > PROXY2_AF_UNIX || protocol > PROXY2_PROTO_DGRAM) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	if (region->length < ISC_PROXY2_HEADER_SIZE + alen) {
+		return (ISC_R_NOMORE);
+	}
+
+	*proxy = (isc_proxy2_t){
+		.length = ISC_PROXY2_HEADER_SIZE + alen,
+		.command = command,
+	};
+
+	if (command == ISC_PROXY2_CMD_LOCAL || protocol == PROXY2_PROTO_UNSPEC)
+	{
+		return (ISC_R_SUCCESS);
+	}
+
+	p += ISC_PROXY2_HEADER_SIZE;
+
+	switch (family) {
+	case PROXY2_AF_INET: {
+		struct in_addr src, dst;
+
+		if (alen < 12) {
+			return (ISC_R_RANGE);
+		}
+
+		memmove(&src, p, 4);
+		memmove(&dst, p + 4, 4);
+		isc_sockaddr_fromin(&proxy->source, &src, proxy2_get16(p + 8));
+		isc_sockaddr_fromin(&proxy->destination, &dst,
+				    proxy2_get16(p + 10));
+		proxy->addresses = true;
+		break;
+	}
+	case PROXY2_AF_INET6: {
+		struct in6_addr src, dst;
+
+		if (alen < 36) {
+			return (ISC_R_RANGE);
+		}
+
+		memmove(&src, p, 16);
+		memmove(&dst, p + 16, 16);
+		isc_sockaddr_fromin6(&proxy->source, &src,
+				     proxy2_get16(p + 32));
+		isc_sockaddr_fromin6(&proxy->destination, &dst,
+				     proxy2_get16(p + 34));
+		proxy->addresses = true;
+		break;
+	}
+	default:
+		/* Use the addresses of the connection */
+		break;
+	}
+
+	return (ISC_R_SUCCESS);
+}
@@ -13,10 +13,12 @@
 
 /*! \file */
 
+#include <stdbool.h>
 #include <stddef.h>
 
 #include <isc/atomic.h>
 #include <isc/quota.h>
+#include <isc/tid.h>
 #include <isc/util.h>
 
 #define QUOTA_MAGIC    ISC_MAGIC('Q', 'U', 'O', 'T')
@@ -25,14 +27,33 @@
 #define QUOTA_CB_MAGIC	  ISC_MAGIC('Q', 'T', 'C', 'B')
 #define VALID_QUOTA_CB(p) ISC_MAGIC_VALID(p, QUOTA_CB_MAGIC)
 
+/*
+ * A loop thread takes QUOTA_BATCH units from the shared counter at a
+ * time and hands back QUOTA_BATCH units once it has more than twice
+ * that many to spare.  The spare units still count as used in
+ * quota->used, so the hard quota is never exceeded; when an attach
+ * fails, or would report the soft quota, the spare units of all the
+ * threads are reclaimed first.  Units are only kept in reserve while
+ * less than half of the soft (or hard) quota is in use, so small
+ * quotas are always accounted for exactly.
+ */
+#define QUOTA_BATCH 8U
+
+static uint_fast32_t
+quota_reclaim(isc_quota_t *quota);
+
 void
 isc_quota_init(isc_quota_t *quota, unsigned int max) {
 	atomic_init(&quota->max, max);
 	atomic_init(&quota->used, 0);
 	atomic_init(&quota->soft, 0);
 	atomic_init(&quota->waiting, 0);
-	ISC_LIST_INIT(quota->cbs);
-	isc_mutex_init(&quota->cblock);
+	atomic_init(&quota->pending, 0);
+	atomic_init(&quota->draining, false);
+	quota->cbs = NULL;
+	for (size_t i = 0; i < ISC_QUOTA_THREADS; i++) {
+		atomic_init(&quota->local[i].cached, 0);
+	}
 	ISC_LINK_INIT(quota, link);
 	quota->magic = QUOTA_MAGIC;
 }
@@ -42,13 +63,15 @@ isc_quota_destroy(isc_quota_t *quota) {
 	REQUIRE(VALID_QUOTA(quota));
 	quota->magic = 0;
 
+	(void)quota_reclaim(quota);
+
 	INSIST(atomic_load(&quota->used) == 0);
 	INSIST(atomic_load(&quota->waiting) == 0);
-	INSIST(ISC_LIST_EMPTY(quota->cbs));
+	INSIST(atomic_load(&quota->pending) == 0);
+	INSIST(quota->cbs == NULL);
 	atomic_store_release(&quota->max, 0);
 	atomic_store_release(&quota->used, 0);
 	atomic_store_release(&quota->soft, 0);
-	isc_mutex_destroy(&quota->cblock);
 }
 
 void
@@ -77,18 +100,55 @@ isc_quota_getsoft(isc_quota_t *quota) {
 
 unsigned int
 isc_quota_getused(isc_quota_t *quota) {
+	uint_fast32_t used, cached = 0;
+
 	REQUIRE(VALID_QUOTA(quota));
-	return (atomic_load_relaxed(&quota->used));
+
+	used = atomic_load_relaxed(&quota->used);
+	for (size_t i = 0; i < ISC_QUOTA_THREADS; i++) {
+		cached += atomic_load_relaxed(&quota->local[i].cached);
+	}
+
+	return (used > cached ? used - cached : 0);
+}
+
+static isc__quota_local_t *
+quota_local(isc_quota_t *quota) {
+	uint32_t tid = isc_tid();
+
+	if (tid >= ISC_QUOTA_THREADS) {
+		return (NULL);
+	}
+
+	return (&quota->local[tid]);
+}
+
+/*
+ * Whether the quota is far enough from full for the loop threads to
+ * keep units in reserve.
+ */
+static bool
+quota_plenty(isc_quota_t *quota) {
+	uint_fast32_t max = atomic_load_relaxed(&quota->max);
+	uint_fast32_t soft = atomic_load_relaxed(&quota->soft);
+	uint_fast32_t used = atomic_load_relaxed(&quota->used);
+	uint_fast32_t limit = max;
+
+	if (soft != 0 && (max == 0 || soft < max)) {
+		limit = soft;
+	}
+
+	return (limit == 0 || used + QUOTA_BATCH <= limit / 2);
 }
 
 static isc_result_t
-quota_reserve(isc_quota_t *quota) {
+quota_reserve(isc_quota_t *quota, uint_fast32_t count) {
 	isc_result_t result;
 	uint_fast32_t max = atomic_load_acquire(&quota->max);
 	uint_fast32_t soft = atomic_load_acquire(&quota->soft);
 	uint_fast32_t used = atomic_load_acquire(&quota->used);
 	do {
-		if (max != 0 && used >= max) {
+		if (max != 0 && used + count > max) {
 			return (ISC_R_QUOTA);
 		}
 		if (soft != 0 && used >= soft) {
@@ -97,50 +157,192 @@ quota_reserve(isc_quota_t *quota) {
 			result = ISC_R_SUCCESS;
 		}
 	} while (!atomic_compare_exchange_weak_acq_rel(&quota->used, &used,
-						       used + 1));
+						       used + count));
+	return (result);
+}
+
+/*
+ * Return the units kept in reserve by all the loop threads to the
+ * shared counter.
+ */
+static uint_fast32_t
+quota_reclaim(isc_quota_t *quota) {
+	uint_fast32_t total = 0;
+
+	for (size_t i = 0; i < ISC_QUOTA_THREADS; i++) {
+		isc__quota_local_t *local = &quota->local[i];
+
+		if (atomic_load_relaxed(&local->cached) > 0) {
+			total += atomic_exchange_acq_rel(&local->cached, 0);
+		}
+	}
+
+	if (total > 0) {
+		uint_fast32_t used = atomic_fetch_sub_release(&quota->used,
+							      total);
+		INSIST(used >= total);
+	}
+
+	return (total);
+}
+
+/*
+ * Return ISC_R_SOFTQUOTA if the units in use, besides the one the
+ * caller has just taken, reach the soft quota.  The units kept in
+ * reserve are not in use, so they are reclaimed before saying so.
+ */
+static isc_result_t
+quota_softresult(isc_quota_t *quota) {
+	uint_fast32_t soft = atomic_load_relaxed(&quota->soft);
+
+	if (soft == 0 || atomic_load_acquire(&quota->used) <= soft) {
+		return (ISC_R_SUCCESS);
+	}
+
+	if (quota_reclaim(quota) > 0 &&
+	    atomic_load_acquire(&quota->used) <= soft)
+	{
+		return (ISC_R_SUCCESS);
+	}
+
+	return (ISC_R_SOFTQUOTA);
+}
+
+static isc_result_t
+quota_take(isc_quota_t *quota) {
+	isc__quota_local_t *local = quota_local(quota);
+	isc_result_t result;
+
+	if (local != NULL) {
+		uint_fast32_t cached = atomic_load_relaxed(&local->cached);
+
+		/* Only quota_reclaim() can take our units away. */
+		while (cached > 0) {
+			if (atomic_compare_exchange_weak_acq_rel(
+				    &local->cached, &cached, cached - 1))
+			{
+				return (quota_softresult(quota));
+			}
+		}
+
+		if (quota_plenty(quota)) {
+			result = quota_reserve(quota, QUOTA_BATCH);
+			if (result != ISC_R_QUOTA) {
+				atomic_fetch_add_relaxed(&local->cached,
+							 QUOTA_BATCH - 1);
+				return (quota_softresult(quota));
+			}
+		}
+	}
+
+	result = quota_reserve(quota, 1);
+	if (result == ISC_R_QUOTA && quota_reclaim(quota) > 0) {
+		result = quota_reserve(quota, 1);
+	}
+	if (result == ISC_R_SOFTQUOTA) {
+		result = quota_softresult(quota);
+	}
+
 	return (result);
 }
 
-/* Must be quota->cbslock locked */
+/*
+ * The waiters are pushed onto the 'pending' stack without a lock.  The
+ * thread that wins the 'draining' flag moves them, oldest first, to
+ * the 'cbs' list that only it may touch, and takes the first one off.
+ */
 static void
 enqueue(isc_quota_t *quota, isc_quota_cb_t *cb) {
+	uintptr_t head = atomic_load_relaxed(&quota->pending);
+
 	REQUIRE(cb != NULL);
-	ISC_LIST_ENQUEUE(quota->cbs, cb, link);
+
+	do {
+		cb->next = (isc_quota_cb_t *)head;
+	} while (!atomic_compare_exchange_weak_acq_rel(&quota->pending, &head,
+						       (uintptr_t)cb));
 	atomic_fetch_add_release(&quota->waiting, 1);
 }
 
-/* Must be quota->cbslock locked */
 static isc_quota_cb_t *
 dequeue(isc_quota_t *quota) {
-	isc_quota_cb_t *cb = ISC_LIST_HEAD(quota->cbs);
-	INSIST(cb != NULL);
-	ISC_LIST_DEQUEUE(quota->cbs, cb, link);
-	atomic_fetch_sub_relaxed(&quota->waiting, 1);
+	isc_quota_cb_t *cb = NULL;
+	bool draining = false;
+
+	if (!atomic_compare_exchange_strong_acq_rel(&quota->draining,
+						    &draining, true))
+	{
+		return (NULL);
+	}
+
+	if (quota->cbs == NULL) {
+		cb = (isc_quota_cb_t *)atomic_exchange_acq_rel(&quota->pending,
+							       0);
+		while (cb != NULL) {
+			isc_quota_cb_t *next = cb->next;
+			cb->next = quota->cbs;
+			quota->cbs = cb;
+			cb = next;
+		}
+	}
+
+	cb = quota->cbs;
+	if (cb != NULL) {
+		quota->cbs = cb->next;
+		cb->next = NULL;
+		atomic_fetch_sub_relaxed(&quota->waiting, 1);
+	}
+
+	atomic_store_release(&quota->draining, false);
+
 	return (cb);
 }
 
+/*
+ * Keep a released unit in reserve for this thread, handing a batch back
+ * to the shared counter once there are too many.
+ */
+static void
+quota_keep(isc_quota_t *quota, isc__quota_local_t *local) {
+	uint_fast32_t cached = atomic_fetch_add_relaxed(&local->cached, 1);
+
+	cached++;
+	while (cached > 2 * QUOTA_BATCH) {
+		if (atomic_compare_exchange_weak_acq_rel(
+			    &local->cached, &cached, cached - QUOTA_BATCH))
+		{
+			uint_fast32_t used = atomic_fetch_sub_release(
+				&quota->used, QUOTA_BATCH);
+			INSIST(used >= QUOTA_BATCH);
+			return;
+		}
+	}
+}
+
 static void
 quota_release(isc_quota_t *quota) {
+	isc__quota_local_t *local = NULL;
 	uint_fast32_t used;
 
 	/*
 	 * This is opportunistic - we might race with a failing quota_attach_cb
-	 * and not detect that something is waiting, but eventually someone will
-	 * be releasing quota and will detect it, so we don't need to worry -
-	 * and we're saving a lot by not locking cblock every time.
+	 * and not detect that something is waiting, or with another thread
+	 * dequeueing a waiter, but eventually someone will be releasing quota
+	 * and will detect it, so we don't need to worry.
 	 */
 
 	if (atomic_load_acquire(&quota->waiting) > 0) {
-		isc_quota_cb_t *cb = NULL;
-		LOCK(&quota->cblock);
-		if (atomic_load_relaxed(&quota->waiting) > 0) {
-			cb = dequeue(quota);
-		}
-		UNLOCK(&quota->cblock);
+		isc_quota_cb_t *cb = dequeue(quota);
 		if (cb != NULL) {
 			cb->cb_func(quota, cb->data);
 			return;
 		}
+	} else {
+		local = quota_local(quota);
+		if (local != NULL && quota_plenty(quota)) {
+			quota_keep(quota, local);
+			return;
+		}
 	}
 
 	used = atomic_fetch_sub_release(&quota->used, 1);
@@ -152,7 +354,7 @@ doattach(isc_quota_t *quota, isc_quota_t **p) {
 	isc_result_t result;
 	REQUIRE(p != NULL && *p == NULL);
 
-	result = quota_reserve(quota);
+	result = quota_take(quota);
 	if (result == ISC_R_SUCCESS || result == ISC_R_SOFTQUOTA) {
 		*p = quota;
 	}
@@ -177,16 +379,14 @@ isc_quota_attach_cb(isc_quota_t *quota, isc_quota_t **quotap,
 
 	isc_result_t result = doattach(quota, quotap);
 	if (result == ISC_R_QUOTA && cb != NULL) {
-		LOCK(&quota->cblock);
 		enqueue(quota, cb);
-		UNLOCK(&quota->cblock);
 	}
 	return (result);
 }
 
 void
 isc_quota_cb_init(isc_quota_cb_t *cb, isc_quota_cb_func_t cb_func, void *data) {
-	ISC_LINK_INIT(cb, link);
+	cb->next = NULL;
 	cb->cb_func = cb_func;
 	cb->data = data;
 	cb->magic = QUOTA_CB_MAGIC;
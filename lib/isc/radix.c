@@ -18,7 +18,10 @@
  */
 
 #include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include <isc/magic.h>
 #include <isc/mem.h>
 #include <isc/radix.h>
 #include <isc/types.h>
@@ -702,3 +705,372 @@ isc_radix_remove(isc_radix_tree_t *radix, isc_radix_node_t *node) {
 		parent->l = child;
 	}
 }
+
+/*
+ * Compiled radix trees.
+ */
+
+#define TRIE_STRIDE 6
+#define TRIE_SLOTS  (1U << TRIE_STRIDE)
+#define TRIE_BIT(s) ((uint64_t)1 << (s))
+
+#define RADIX_COMPILED_MAGIC	ISC_MAGIC('R', 'd', 'x', 'C')
+#define RADIX_COMPILED_VALID(a) ISC_MAGIC_VALID(a, RADIX_COMPILED_MAGIC)
+
+typedef struct trie_node {
+	uint64_t vector;  /* slots that continue in a child node */
+	uint64_t leafvec; /* slots that start a new run of leaves */
+	uint32_t base0;	  /* index of the first leaf */
+	uint32_t base1;	  /* index of the first child node */
+} trie_node_t;
+
+typedef struct trie {
+	trie_node_t	  *nodes;
+	isc_radix_node_t **leaves;
+	uint32_t	   nnodes, nodesize;
+	uint32_t	   nleaves, leafsize;
+} trie_t;
+
+struct isc_radix_compiled {
+	unsigned int magic;
+	isc_mem_t   *mctx;
+	trie_t	     tries[RADIX_FAMILIES];
+};
+
+typedef struct trie_entry {
+	uint8_t		  addr[16]; /* masked to 'bitlen' */
+	uint32_t	  bitlen;
+	int		  node_num;
+	isc_radix_node_t *node;
+} trie_entry_t;
+
+static unsigned int
+trie_popcount(uint64_t v) {
+#if HAVE_BUILTIN_POPCOUNTLL
+	return (__builtin_popcountll(v));
+#else  /* if HAVE_BUILTIN_POPCOUNTLL */
+	v = v - ((v >> 1) & 0x5555555555555555ULL);
+	v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+	v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	return ((v * 0x0101010101010101ULL) >> 56);
+#endif /* if HAVE_BUILTIN_POPCOUNTLL */
+}
+
+/*
+ * The TRIE_STRIDE bits of the 16-byte address 'addr' starting at
+ * bit 'pos', counting from the most significant bit.
+ */
+static unsigned int
+trie_slot(const uint8_t *addr, unsigned int pos) {
+	unsigned int byte = pos >> 3;
+	unsigned int window = addr[byte] << 8;
+
+	if (byte < 15) {
+		window |= addr[byte + 1];
+	}
+
+	return ((window >> (16 - TRIE_STRIDE - (pos & 7))) & (TRIE_SLOTS - 1));
+}
+
+/*
+ * Pick the first match between 'best' and 'entry', preferring the
+ * longer prefix when they were added together (as isc_radix_search()
+ * does).
+ */
+static isc_radix_node_t *
+trie_better(isc_radix_node_t *best, const trie_entry_t *entry, int fam) {
+	if (best == NULL || entry->node_num < best->node_num[fam] ||
+	    (entry->node_num == best->node_num[fam] &&
+	     entry->bitlen > best->prefix->bitlen))
+	{
+		return (entry->node);
+	}
+
+	return (best);
+}
+
+static int
+trie_entry_cmp(const void *a, const void *b) {
+	const trie_entry_t *ea = a, *eb = b;
+	int r = memcmp(ea->addr, eb->addr, sizeof(ea->addr));
+
+	if (r != 0) {
+		return (r);
+	}
+
+	return ((ea->bitlen > eb->bitlen) - (ea->bitlen < eb->bitlen));
+}
+
+static uint32_t
+trie_addnodes(isc_mem_t *mctx, trie_t *trie, uint32_t count) {
+	uint32_t base = trie->nnodes;
+
+	if (trie->nnodes + count > trie->nodesize) {
+		uint32_t size = ISC_MAX(trie->nodesize * 2,
+					trie->nnodes + count);
+		trie->nodes = isc_mem_reget(
+			mctx, trie->nodes, trie->nodesize * sizeof(trie_node_t),
+			size * sizeof(trie_node_t));
+		trie->nodesize = size;
+	}
+	trie->nnodes += count;
+
+	return (base);
+}
+
+static uint32_t
+trie_addleaves(isc_mem_t *mctx, trie_t *trie, isc_radix_node_t **leaves,
+	       uint32_t count) {
+	uint32_t base = trie->nleaves;
+
+	if (trie->nleaves + count > trie->leafsize) {
+		uint32_t size = ISC_MAX(trie->leafsize * 2,
+					trie->nleaves + count);
+		trie->leaves = isc_mem_reget(
+			mctx, trie->leaves,
+			trie->leafsize * sizeof(isc_radix_node_t *),
+			size * sizeof(isc_radix_node_t *));
+		trie->leafsize = size;
+	}
+	memmove(&trie->leaves[base], leaves, count * sizeof(leaves[0]));
+	trie->nleaves += count;
+
+	return (base);
+}
+
+/*
+ * Fill in trie node 'idx', which covers the bits from 'pos' on of the
+ * addresses in 'entries'.  The entries share their first 'pos' bits
+ * and are longer than 'pos' bits unless 'pos' is zero; 'inherited' is
+ * the first match among the shorter prefixes above this node.
+ */
+static void
+trie_build(isc_mem_t *mctx, trie_t *trie, int fam, uint32_t idx,
+	   unsigned int pos, isc_radix_node_t *inherited,
+	   const trie_entry_t *entries, uint32_t count) {
+	isc_radix_node_t *leaves[TRIE_SLOTS];
+	isc_radix_node_t *runs[TRIE_SLOTS];
+	uint32_t first[TRIE_SLOTS], last[TRIE_SLOTS];
+	unsigned int limit = pos + TRIE_STRIDE;
+	uint64_t vector = 0, leafvec = 0;
+	uint32_t nruns = 0, base0, base1, child;
+
+	for (unsigned int s = 0; s < TRIE_SLOTS; s++) {
+		leaves[s] = inherited;
+	}
+
+	/*
+	 * Prefixes ending within this node are expanded into the slots
+	 * they cover; longer ones are handed down to the child node of
+	 * their slot.  The entries are sorted, so those are contiguous.
+	 */
+	for (uint32_t i = 0; i < count; i++) {
+		const trie_entry_t *entry = &entries[i];
+		unsigned int slot = trie_slot(entry->addr, pos);
+		unsigned int span;
+
+		if (entry->bitlen > limit) {
+			if ((vector & TRIE_BIT(slot)) == 0) {
+				vector |= TRIE_BIT(slot);
+				first[slot] = i;
+			}
+			last[slot] = i + 1;
+			continue;
+		}
+
+		span = 1U << (limit - entry->bitlen);
+		slot &= ~(span - 1);
+		for (unsigned int s = slot; s < slot + span; s++) {
+			leaves[s] = trie_better(leaves[s], entry, fam);
+		}
+	}
+
+	/*
+	 * The leaves of slots with a child node are never looked at, so
+	 * they just extend the run before them.
+	 */
+	for (unsigned int s = 0; s < TRIE_SLOTS; s++) {
+		if (s > 0 && ((vector & TRIE_BIT(s)) != 0 ||
+			      leaves[s] == runs[nruns - 1]))
+		{
+			continue;
+		}
+		leafvec |= TRIE_BIT(s);
+		runs[nruns++] = leaves[s];
+	}
+
+	base0 = trie_addleaves(mctx, trie, runs, nruns);
+	base1 = trie_addnodes(mctx, trie, trie_popcount(vector));
+	trie->nodes[idx] = (trie_node_t){
+		.vector = vector,
+		.leafvec = leafvec,
+		.base0 = base0,
+		.base1 = base1,
+	};
+
+	child = base1;
+	for (unsigned int s = 0; s < TRIE_SLOTS; s++) {
+		if ((vector & TRIE_BIT(s)) == 0) {
+			continue;
+		}
+		trie_build(mctx, trie, fam, child++, limit, leaves[s],
+			   &entries[first[s]], last[s] - first[s]);
+	}
+}
+
+static void
+trie_compile(isc_mem_t *mctx, isc_radix_tree_t *radix, int fam,
+	     trie_t *trie) {
+	isc_radix_node_t *node = NULL;
+	trie_entry_t *entries = NULL;
+	uint32_t maxbits = (fam == RADIX_V6) ? 128 : 32;
+	uint32_t count = 0, n = 0;
+
+	RADIX_WALK(radix->head, node) {
+		if (node->node_num[fam] != -1 &&
+		    node->prefix->bitlen <= maxbits) {
+			count++;
+		}
+	}
+	RADIX_WALK_END;
+
+	if (count == 0) {
+		return;
+	}
+
+	entries = isc_mem_get(mctx, count * sizeof(entries[0]));
+
+	RADIX_WALK(radix->head, node) {
+		if (node->node_num[fam] != -1 &&
+		    node->prefix->bitlen <= maxbits) {
+			trie_entry_t *entry = &entries[n++];
+			uint32_t bitlen = node->prefix->bitlen;
+
+			*entry = (trie_entry_t){
+				.bitlen = bitlen,
+				.node_num = node->node_num[fam],
+				.node = node,
+			};
+			memmove(entry->addr, isc_prefix_touchar(node->prefix),
+				(bitlen + 7) / 8);
+			if ((bitlen & 7) != 0) {
+				entry->addr[bitlen >> 3] &= 0xff00 >>
+							    (bitlen & 7);
+			}
+		}
+	}
+	RADIX_WALK_END;
+
+	INSIST(n == count);
+	qsort(entries, count, sizeof(entries[0]), trie_entry_cmp);
+
+	(void)trie_addnodes(mctx, trie, 1);
+	trie_build(mctx, trie, fam, 0, 0, NULL, entries, count);
+
+	isc_mem_put(mctx, entries, count * sizeof(entries[0]));
+
+	/* The trie doesn't change any more; give back the slack. */
+	trie->nodes = isc_mem_reget(mctx, trie->nodes,
+				    trie->nodesize * sizeof(trie_node_t),
+				    trie->nnodes * sizeof(trie_node_t));
+	trie->nodesize = trie->nnodes;
+	trie->leaves = isc_mem_reget(
+		mctx, trie->leaves, trie->leafsize * sizeof(isc_radix_node_t *),
+		trie->nleaves * sizeof(isc_radix_node_t *));
+	trie->leafsize = trie->nleaves;
+}
+
+void
+isc_radix_compile(isc_radix_tree_t *radix, isc_radix_compiled_t **target) {
+	isc_radix_compiled_t *compiled = NULL;
+
+	REQUIRE(radix != NULL);
+	REQUIRE(target != NULL && *target == NULL);
+
+	compiled = isc_mem_get(radix->mctx, sizeof(*compiled));
+	*compiled = (isc_radix_compiled_t){
+		.magic = RADIX_COMPILED_MAGIC,
+	};
+	isc_mem_attach(radix->mctx, &compiled->mctx);
+
+	for (int fam = 0; fam < RADIX_FAMILIES; fam++) {
+		trie_compile(compiled->mctx, radix, fam,
+			     &compiled->tries[fam]);
+	}
+
+	*target = compiled;
+}
+
+isc_result_t
+isc_radix_compiled_search(const isc_radix_compiled_t *compiled,
+			  isc_radix_node_t **target,
+			  const isc_prefix_t *prefix) {
+	const trie_t *trie = NULL;
+	const trie_node_t *node = NULL;
+	uint8_t addr[16] = { 0 };
+	unsigned int pos = 0;
+	uint64_t below;
+	int fam;
+
+	REQUIRE(RADIX_COMPILED_VALID(compiled));
+	REQUIRE(target != NULL && *target == NULL);
+	REQUIRE(prefix != NULL);
+	REQUIRE((prefix->family == AF_INET && prefix->bitlen == 32) ||
+		(prefix->family == AF_INET6 && prefix->bitlen == 128));
+
+	fam = ISC_RADIX_FAMILY(prefix);
+	trie = &compiled->tries[fam];
+	if (trie->nnodes == 0) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	memmove(addr, isc_prefix_touchar(prefix), prefix->bitlen / 8);
+
+	node = &trie->nodes[0];
+	for (;;) {
+		uint64_t bit = TRIE_BIT(trie_slot(addr, pos));
+
+		below = bit | (bit - 1);
+		if ((node->vector & bit) == 0) {
+			break;
+		}
+		node = &trie->nodes[node->base1 +
+				    trie_popcount(node->vector & below) - 1];
+		pos += TRIE_STRIDE;
+	}
+
+	*target = trie->leaves[node->base0 +
+			       trie_popcount(node->leafvec & below) - 1];
+	if (*target == NULL) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+void
+isc_radix_compiled_destroy(isc_radix_compiled_t **compiledp) {
+	isc_radix_compiled_t *compiled = NULL;
+
+	REQUIRE(compiledp != NULL && RADIX_COMPILED_VALID(*compiledp));
+
+	compiled = *compiledp;
+	*compiledp = NULL;
+
+	for (int fam = 0; fam < RADIX_FAMILIES; fam++) {
+		trie_t *trie = &compiled->tries[fam];
+
+		if (trie->nodes != NULL) {
+			isc_mem_put(compiled->mctx, trie->nodes,
+				    trie->nodesize * sizeof(trie_node_t));
+		}
+		if (trie->leaves != NULL) {
+			isc_mem_put(compiled->mctx, trie->leaves,
+				    trie->leafsize *
+					    sizeof(isc_radix_node_t *));
+		}
+	}
+
+	compiled->magic = 0;
+	isc_mem_putanddetach(&compiled->mctx, compiled, sizeof(*compiled));
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/atomic.h>
+#include <isc/os.h>
+#include <isc/rcu.h>
+#include <isc/thread.h>
+#include <isc/tid.h>
+#include <isc/util.h>
+
+/*
+ * Each loop thread has a slot of its own, holding zero when it is not
+ * in a critical section and otherwise the epoch in which it entered.
+ * Slots are padded to a cache line so that readers never share one.
+ */
+typedef struct rcu_slot {
+	atomic_uint_fast64_t epoch;
+	uint8_t __padding[ISC_OS_CACHELINE_SIZE - sizeof(atomic_uint_fast64_t)];
+} rcu_slot_t;
+
+static rcu_slot_t slots[ISC_RCU_MAXTHREADS];
+static atomic_uint_fast64_t epoch = 1;
+static atomic_uint_fast32_t nslots = 0;
+
+static thread_local unsigned int depth = 0;
+
+bool
+isc_rcu_available(void) {
+	return (isc_tid() < ISC_RCU_MAXTHREADS);
+}
+
+void
+isc_rcu_read_lock(void) {
+	uint32_t tid = isc_tid();
+	uint_fast32_t n;
+
+	REQUIRE(tid < ISC_RCU_MAXTHREADS);
+
+	if (depth++ > 0) {
+		return;
+	}
+
+	n = atomic_load_relaxed(&nslots);
+	while (n <= tid) {
+		if (atomic_compare_exchange_weak(&nslots, &n, tid + 1)) {
+			break;
+		}
+	}
+
+	/*
+	 * The fence orders the announcement before any of the reads that
+	 * it protects, pairing with the one in isc_rcu_expired().
+	 */
+	atomic_store_relaxed(&slots[tid].epoch, atomic_load_acquire(&epoch));
+	atomic_thread_fence(memory_order_seq_cst);
+}
+
+void
+isc_rcu_read_unlock(void) {
+	uint32_t tid = isc_tid();
+
+	REQUIRE(tid < ISC_RCU_MAXTHREADS);
+	INSIST(depth > 0);
+
+	if (--depth > 0) {
+		return;
+	}
+
+	atomic_store_release(&slots[tid].epoch, 0);
+}
+
+uint64_t
+isc_rcu_retire(void) {
+	return (atomic_fetch_add(&epoch, 1) + 1);
+}
+
+bool
+isc_rcu_expired(uint64_t tag) {
+	uint_fast32_t n;
+
+	atomic_thread_fence(memory_order_seq_cst);
+
+	n = atomic_load_acquire(&nslots);
+	for (uint_fast32_t i = 0; i < n; i++) {
+		uint_fast64_t e = atomic_load_acquire(&slots[i].epoch);
+		if (e != 0 && e < tag) {
+			return (false);
+		}
+	}
+	return (true);
+}
+
+void
+isc_rcu_synchronize(void) {
+	uint64_t tag;
+
+	INSIST(depth == 0);
+
+	tag = isc_rcu_retire();
+	while (!isc_rcu_expired(tag)) {
+		isc_thread_yield();
+	}
+}
@@ -16,15 +16,19 @@
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <time.h>
 
 #if defined(sun) && (defined(__sparc) || defined(__sparc__))
 #include <synch.h> /* for smt_pause(3c) */
 #endif /* if defined(sun) && (defined(__sparc) || defined(__sparc__)) */
 
+#include <isc/align.h>
 #include <isc/atomic.h>
 #include <isc/magic.h>
+#include <isc/os.h>
 #include <isc/print.h>
 #include <isc/rwlock.h>
+#include <isc/tid.h>
 #include <isc/util.h>
 
 #if USE_PTHREAD_RWLOCK
@@ -231,6 +235,10 @@ isc___rwlock_init(isc__rwlock_t *rwl, unsigned int read_quota,
 		write_quota = RWLOCK_DEFAULT_WRITE_QUOTA;
 	}
 	rwl->write_quota = write_quota;
+#if USE_RWLOCK_READER_BIAS
+	atomic_init(&rwl->reader_bias, false);
+	atomic_init(&rwl->inhibit_until, 0);
+#endif /* USE_RWLOCK_READER_BIAS */
 
 	isc_mutex_init(&rwl->lock);
 
@@ -324,6 +332,186 @@ isc___rwlock_destroy(isc__rwlock_t *rwl) {
 #define WRITER_ACTIVE 0x1
 #define READER_INCR   0x2
 
+#if USE_RWLOCK_READER_BIAS
+/*
+ * Reader bias, after "BRAVO - Biased Locking for Reader-Writer Locks"
+ * by Dice and Kogan: while rwl->reader_bias is set, a reader running on
+ * a loop thread stores the address of the lock in one of the slots owned
+ * by its thread and proceeds without touching cnt_and_flag, so readers
+ * on different threads do not contend for the same cache line.  Threads
+ * without a thread ID, or with all their slots busy, use the lock as
+ * before.
+ *
+ * A writer first acquires the lock as usual, which also keeps readers
+ * from setting the bias again, then clears the bias and waits until no
+ * slot refers to the lock any more.  As that revocation is expensive,
+ * the bias is only restored by a reader taking the regular path after
+ * RWLOCK_BIAS_INHIBIT times as long as the revocation took.
+ */
+
+#ifndef RWLOCK_BIAS_THREADS
+#define RWLOCK_BIAS_THREADS 128
+#endif /* ifndef RWLOCK_BIAS_THREADS */
+
+#ifndef RWLOCK_BIAS_INHIBIT
+#define RWLOCK_BIAS_INHIBIT 9
+#endif /* ifndef RWLOCK_BIAS_INHIBIT */
+
+#define RWLOCK_BIAS_SLOTS (ISC_OS_CACHELINE_SIZE / sizeof(atomic_uintptr_t))
+
+typedef struct reader_slots {
+	alignas(ISC_OS_CACHELINE_SIZE) atomic_uintptr_t slot[RWLOCK_BIAS_SLOTS];
+} reader_slots_t;
+
+static reader_slots_t reader_slots[RWLOCK_BIAS_THREADS];
+
+/* One more than the highest thread ID that has used its slots */
+static atomic_uint_fast32_t reader_threads = 0;
+
+static uint64_t
+bias_now(void) {
+	struct timespec ts;
+
+	RUNTIME_CHECK(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+
+	return ((uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec);
+}
+
+static bool
+bias_tryread(isc__rwlock_t *rwl) {
+	uint32_t tid = isc_tid();
+	uint_fast32_t nthreads;
+
+	if (!atomic_load_relaxed(&rwl->reader_bias) ||
+	    tid >= RWLOCK_BIAS_THREADS)
+	{
+		return (false);
+	}
+
+	/*
+	 * The writer must scan our slots if it can see our lock, so
+	 * make them visible before publishing the first one.
+	 */
+	nthreads = atomic_load_relaxed(&reader_threads);
+	while (tid >= nthreads) {
+		if (atomic_compare_exchange_weak(&reader_threads, &nthreads,
+						 tid + 1))
+		{
+			break;
+		}
+	}
+
+	for (size_t i = 0; i < RWLOCK_BIAS_SLOTS; i++) {
+		atomic_uintptr_t *slot = &reader_slots[tid].slot[i];
+
+		if (atomic_load_relaxed(slot) != 0) {
+			continue;
+		}
+
+		/*
+		 * Sequentially consistent store and load, pairing with the
+		 * store and the slot scan in bias_revoke(): either the
+		 * writer sees our slot, or we see the bias cleared.
+		 */
+		atomic_store(slot, (uintptr_t)rwl);
+		if (atomic_load(&rwl->reader_bias)) {
+			return (true);
+		}
+		atomic_store_release(slot, 0);
+		return (false);
+	}
+
+	return (false);
+}
+
+static bool
+bias_unlock(isc__rwlock_t *rwl) {
+	uint32_t tid = isc_tid();
+
+	if (tid >= RWLOCK_BIAS_THREADS) {
+		return (false);
+	}
+
+	for (size_t i = 0; i < RWLOCK_BIAS_SLOTS; i++) {
+		atomic_uintptr_t *slot = &reader_slots[tid].slot[i];
+
+		if (atomic_load_relaxed(slot) == (uintptr_t)rwl) {
+			atomic_store_release(slot, 0);
+			return (true);
+		}
+	}
+
+	return (false);
+}
+
+/*
+ * Called by a reader holding the lock through cnt_and_flag, so no
+ * writer can be revoking the bias at the same time.
+ */
+static void
+bias_enable(isc__rwlock_t *rwl) {
+	if (!atomic_load_relaxed(&rwl->reader_bias) &&
+	    bias_now() >= atomic_load_relaxed(&rwl->inhibit_until))
+	{
+		atomic_store_release(&rwl->reader_bias, true);
+	}
+}
+
+static bool
+bias_readers(isc__rwlock_t *rwl, bool wait) {
+	uint_fast32_t nthreads = atomic_load(&reader_threads);
+
+	for (uint_fast32_t t = 0; t < nthreads; t++) {
+		for (size_t i = 0; i < RWLOCK_BIAS_SLOTS; i++) {
+			atomic_uintptr_t *slot = &reader_slots[t].slot[i];
+
+			while (atomic_load_acquire(slot) == (uintptr_t)rwl) {
+				if (!wait) {
+					return (true);
+				}
+				isc_rwlock_pause();
+			}
+		}
+	}
+
+	return (false);
+}
+
+/*
+ * Called by a writer holding the lock through cnt_and_flag.
+ */
+static void
+bias_revoke(isc__rwlock_t *rwl) {
+	uint64_t start, now;
+
+	if (!atomic_load_relaxed(&rwl->reader_bias)) {
+		return;
+	}
+
+	start = bias_now();
+	atomic_store(&rwl->reader_bias, false);
+	(void)bias_readers(rwl, true);
+	now = bias_now();
+
+	atomic_store_relaxed(&rwl->inhibit_until,
+			     now + (now - start) * RWLOCK_BIAS_INHIBIT);
+}
+
+/*
+ * Like bias_revoke(), but fail instead of waiting for readers; the bias
+ * stays cleared, so they will use the regular path from now on.
+ */
+static bool
+bias_tryrevoke(isc__rwlock_t *rwl) {
+	if (!atomic_load_relaxed(&rwl->reader_bias)) {
+		return (true);
+	}
+
+	atomic_store(&rwl->reader_bias, false);
+	return (!bias_readers(rwl, false));
+}
+#endif /* USE_RWLOCK_READER_BIAS */
+
 static void
 rwlock_lock(isc__rwlock_t *rwl, isc_rwlocktype_t type) {
 	int32_t cntflag;
@@ -441,11 +629,25 @@ rwlock_lock(isc__rwlock_t *rwl, isc_rwlocktype_t type) {
 #endif /* ifdef ISC_RWLOCK_TRACE */
 }
 
+static isc_result_t
+rwlock_trylock(isc__rwlock_t *rwl, isc_rwlocktype_t type);
+
 int
 isc___rwlock_lock(isc__rwlock_t *rwl, isc_rwlocktype_t type) {
 	int32_t cnt = 0;
-	int32_t spins = atomic_load_acquire(&rwl->spins) * 2 + 10;
-	int32_t max_cnt = ISC_MAX(spins, RWLOCK_MAX_ADAPTIVE_COUNT);
+	int32_t spins;
+	int32_t max_cnt;
+
+#if USE_RWLOCK_READER_BIAS
+	REQUIRE(VALID_RWLOCK(rwl));
+
+	if (type == isc_rwlocktype_read && bias_tryread(rwl)) {
+		return (0);
+	}
+#endif /* USE_RWLOCK_READER_BIAS */
+
+	spins = atomic_load_acquire(&rwl->spins) * 2 + 10;
+	max_cnt = ISC_MAX(spins, RWLOCK_MAX_ADAPTIVE_COUNT);
 
 	do {
 		if (cnt++ >= max_cnt) {
@@ -453,15 +655,48 @@ isc___rwlock_lock(isc__rwlock_t *rwl, isc_rwlocktype_t type) {
 			break;
 		}
 		isc_rwlock_pause();
-	} while (isc_rwlock_trylock(rwl, type) != ISC_R_SUCCESS);
+	} while (rwlock_trylock(rwl, type) != ISC_R_SUCCESS);
 
 	atomic_fetch_add_release(&rwl->spins, (cnt - spins) / 8);
 
+#if USE_RWLOCK_READER_BIAS
+	if (type == isc_rwlocktype_read) {
+		bias_enable(rwl);
+	} else {
+		bias_revoke(rwl);
+	}
+#endif /* USE_RWLOCK_READER_BIAS */
+
 	return (0);
 }
 
 isc_result_t
 isc___rwlock_trylock(isc__rwlock_t *rwl, isc_rwlocktype_t type) {
+#if USE_RWLOCK_READER_BIAS
+	isc_result_t result;
+
+	REQUIRE(VALID_RWLOCK(rwl));
+
+	if (type == isc_rwlocktype_read && bias_tryread(rwl)) {
+		return (ISC_R_SUCCESS);
+	}
+
+	result = rwlock_trylock(rwl, type);
+	if (result == ISC_R_SUCCESS && type == isc_rwlocktype_write &&
+	    !bias_tryrevoke(rwl))
+	{
+		RUNTIME_CHECK(isc___rwlock_unlock(rwl, type) == 0);
+		result = ISC_R_LOCKBUSY;
+	}
+
+	return (result);
+#else  /* USE_RWLOCK_READER_BIAS */
+	return (rwlock_trylock(rwl, type));
+#endif /* USE_RWLOCK_READER_BIAS */
+}
+
+static isc_result_t
+rwlock_trylock(isc__rwlock_t *rwl, isc_rwlocktype_t type) {
 	int32_t cntflag;
 
 	REQUIRE(VALID_RWLOCK(rwl));
@@ -533,6 +768,23 @@ isc___rwlock_tryupgrade(isc__rwlock_t *rwl) {
 
 	int_fast32_t reader_incr = READER_INCR;
 
+#if USE_RWLOCK_READER_BIAS
+	/*
+	 * A reader that holds the lock through its slot is not counted
+	 * in cnt_and_flag, so it cannot be upgraded.
+	 */
+	uint32_t tid = isc_tid();
+	if (tid < RWLOCK_BIAS_THREADS) {
+		for (size_t i = 0; i < RWLOCK_BIAS_SLOTS; i++) {
+			if (atomic_load_relaxed(&reader_slots[tid].slot[i]) ==
+			    (uintptr_t)rwl)
+			{
+				return (ISC_R_LOCKBUSY);
+			}
+		}
+	}
+#endif /* USE_RWLOCK_READER_BIAS */
+
 	/* Try to acquire write access. */
 	atomic_compare_exchange_strong_acq_rel(&rwl->cnt_and_flag, &reader_incr,
 					       WRITER_ACTIVE);
@@ -553,6 +805,10 @@ isc___rwlock_tryupgrade(isc__rwlock_t *rwl) {
 		return (ISC_R_LOCKBUSY);
 	}
 
+#if USE_RWLOCK_READER_BIAS
+	bias_revoke(rwl);
+#endif /* USE_RWLOCK_READER_BIAS */
+
 	return (ISC_R_SUCCESS);
 }
 
@@ -592,6 +848,12 @@ isc___rwlock_unlock(isc__rwlock_t *rwl, isc_rwlocktype_t type) {
 	print_lock("preunlock", rwl, type);
 #endif /* ifdef ISC_RWLOCK_TRACE */
 
+#if USE_RWLOCK_READER_BIAS
+	if (type == isc_rwlocktype_read && bias_unlock(rwl)) {
+		return (0);
+	}
+#endif /* USE_RWLOCK_READER_BIAS */
+
 	if (type == isc_rwlocktype_read) {
 		prev_cnt = atomic_fetch_sub_release(&rwl->cnt_and_flag,
 						    READER_INCR);
@@ -658,3 +920,25 @@ isc___rwlock_unlock(isc__rwlock_t *rwl, isc_rwlocktype_t type) {
 }
 
 #endif /* USE_PTHREAD_RWLOCK */
+
+#if ISC_LOCK_PROFILE
+int
+isc___rwlock_lock_profile(isc__rwlock_t *rwl, isc_rwlocktype_t type) {
+	uint64_t start;
+	int ret;
+
+	if (isc___rwlock_trylock(rwl, type) == ISC_R_SUCCESS) {
+		isc__lockprof_record(rwl->stats, false, 0);
+		return (0);
+	}
+
+	start = isc__lockprof_now();
+	ret = isc___rwlock_lock(rwl, type);
+	if (ret == 0) {
+		isc__lockprof_record(rwl->stats, true,
+				     isc__lockprof_now() - start);
+	}
+
+	return (ret);
+}
+#endif /* ISC_LOCK_PROFILE */
@@ -15,6 +15,7 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <isc/ascii.h>
 #include <isc/endian.h>
 #include <isc/siphash.h>
 #include <isc/util.h>
@@ -86,9 +87,25 @@
 	 ((uint64_t)((p)[4]) << 32) | ((uint64_t)((p)[5]) << 40) | \
 	 ((uint64_t)((p)[6]) << 48) | ((uint64_t)((p)[7]) << 56))
 
+/*
+ * Case-insensitive hashes fold ASCII upper case into lower case as the
+ * input is loaded, a word at a time, rather than in a copy of the input.
+ */
+#define U8TO64_CASE(p, case_sensitive)       \
+	((case_sensitive) ? U8TO64_LE(p)     \
+			  : isc__ascii_tolower8(U8TO64_LE(p)))
+
+#define U8TO32_CASE(p, case_sensitive)                     \
+	((case_sensitive) ? U8TO32_LE(p)                   \
+			  : (uint32_t)isc__ascii_tolower8( \
+				    (uint64_t)U8TO32_LE(p)))
+
+#define U8_CASE(c, case_sensitive) \
+	((case_sensitive) ? (c) : isc__ascii_tolower1(c))
+
 void
 isc_siphash24(const uint8_t *k, const uint8_t *in, const size_t inlen,
-	      uint8_t *out) {
+	      bool case_sensitive, uint8_t *out) {
 	REQUIRE(k != NULL);
 	REQUIRE(out != NULL);
 
@@ -106,7 +123,7 @@ isc_siphash24(const uint8_t *k, const uint8_t *in, const size_t inlen,
 	const size_t left = inlen & 7;
 
 	for (; in != end; in += 8) {
-		uint64_t m = U8TO64_LE(in);
+		uint64_t m = U8TO64_CASE(in, case_sensitive);
 
 		v3 ^= m;
 
@@ -119,25 +136,25 @@ isc_siphash24(const uint8_t *k, const uint8_t *in, const size_t inlen,
 
 	switch (left) {
 	case 7:
-		b |= ((uint64_t)in[6]) << 48;
+		b |= ((uint64_t)U8_CASE(in[6], case_sensitive)) << 48;
 		FALLTHROUGH;
 	case 6:
-		b |= ((uint64_t)in[5]) << 40;
+		b |= ((uint64_t)U8_CASE(in[5], case_sensitive)) << 40;
 		FALLTHROUGH;
 	case 5:
-		b |= ((uint64_t)in[4]) << 32;
+		b |= ((uint64_t)U8_CASE(in[4], case_sensitive)) << 32;
 		FALLTHROUGH;
 	case 4:
-		b |= ((uint64_t)in[3]) << 24;
+		b |= ((uint64_t)U8_CASE(in[3], case_sensitive)) << 24;
 		FALLTHROUGH;
 	case 3:
-		b |= ((uint64_t)in[2]) << 16;
+		b |= ((uint64_t)U8_CASE(in[2], case_sensitive)) << 16;
 		FALLTHROUGH;
 	case 2:
-		b |= ((uint64_t)in[1]) << 8;
+		b |= ((uint64_t)U8_CASE(in[1], case_sensitive)) << 8;
 		FALLTHROUGH;
 	case 1:
-		b |= ((uint64_t)in[0]);
+		b |= ((uint64_t)U8_CASE(in[0], case_sensitive));
 		FALLTHROUGH;
 	case 0:
 		break;
@@ -166,7 +183,7 @@ isc_siphash24(const uint8_t *k, const uint8_t *in, const size_t inlen,
 
 void
 isc_halfsiphash24(const uint8_t *k, const uint8_t *in, const size_t inlen,
-		  uint8_t *out) {
+		  bool case_sensitive, uint8_t *out) {
 	REQUIRE(k != NULL);
 	REQUIRE(out != NULL);
 
@@ -184,7 +201,7 @@ isc_halfsiphash24(const uint8_t *k, const uint8_t *in, const size_t inlen,
 	const int left = inlen & 3;
 
 	for (; in != end; in += 4) {
-		uint32_t m = U8TO32_LE(in);
+		uint32_t m = U8TO32_CASE(in, case_sensitive);
 		v3 ^= m;
 
 		for (size_t i = 0; i < cROUNDS; ++i) {
@@ -196,13 +213,13 @@ isc_halfsiphash24(const uint8_t *k, const uint8_t *in, const size_t inlen,
 
 	switch (left) {
 	case 3:
-		b |= ((uint32_t)in[2]) << 16;
+		b |= ((uint32_t)U8_CASE(in[2], case_sensitive)) << 16;
 		FALLTHROUGH;
 	case 2:
-		b |= ((uint32_t)in[1]) << 8;
+		b |= ((uint32_t)U8_CASE(in[1], case_sensitive)) << 8;
 		FALLTHROUGH;
 	case 1:
-		b |= ((uint32_t)in[0]);
+		b |= ((uint32_t)U8_CASE(in[0], case_sensitive));
 		FALLTHROUGH;
 	case 0:
 		break;
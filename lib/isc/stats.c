@@ -20,9 +20,11 @@
 #include <isc/buffer.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/os.h>
 #include <isc/print.h>
 #include <isc/refcount.h>
 #include <isc/stats.h>
+#include <isc/tid.h>
 #include <isc/util.h>
 
 #define ISC_STATS_MAGIC	   ISC_MAGIC('S', 't', 'a', 't')
@@ -30,28 +32,116 @@
 
 typedef atomic_int_fast64_t isc__atomic_statcounter_t;
 
+/*
+ * Number of counter shards in a sharded statistics set.  Loop threads
+ * pick a shard by their thread ID; threads that are not running a loop
+ * share the last one.
+ */
+#define STATS_SHARDS 32
+
+/*
+ * Counters per cache line, to which the shards are padded.
+ */
+#define STATS_PERLINE \
+	(ISC_OS_CACHELINE_SIZE / sizeof(isc__atomic_statcounter_t))
+
 struct isc_stats {
 	unsigned int magic;
 	isc_mem_t *mctx;
 	isc_refcount_t references;
 	int ncounters;
+	int nshards;
+	int stride; /*%< Distance between shards, in counters */
 	isc__atomic_statcounter_t *counters;
 };
 
+static isc__atomic_statcounter_t *
+alloc_counters(isc_mem_t *mctx, int nshards, int stride) {
+	isc__atomic_statcounter_t *counters;
+	size_t size = sizeof(counters[0]) * nshards * stride;
+
+	if (nshards == 1) {
+		counters = isc_mem_get(mctx, size);
+	} else {
+		counters = isc_mem_get_aligned(mctx, size,
+					       ISC_OS_CACHELINE_SIZE);
+	}
+	for (int i = 0; i < nshards * stride; i++) {
+		atomic_init(&counters[i], 0);
+	}
+
+	return (counters);
+}
+
+static void
+free_counters(isc_stats_t *stats) {
+	size_t size = sizeof(stats->counters[0]) * stats->nshards *
+		      stats->stride;
+
+	if (stats->nshards == 1) {
+		isc_mem_put(stats->mctx, stats->counters, size);
+	} else {
+		isc_mem_put_aligned(stats->mctx, stats->counters, size,
+				    ISC_OS_CACHELINE_SIZE);
+	}
+}
+
+static int
+shard_stride(int nshards, int ncounters) {
+	if (nshards == 1) {
+		return (ncounters);
+	}
+	return (ISC_ALIGN(ncounters, STATS_PERLINE));
+}
+
+/*
+ * The calling thread's copy of 'counter'.
+ */
+static isc__atomic_statcounter_t *
+local_counter(isc_stats_t *stats, isc_statscounter_t counter) {
+	uint32_t shard;
+
+	if (stats->nshards == 1) {
+		return (&stats->counters[counter]);
+	}
+
+	shard = isc_tid();
+	if (shard == ISC_TID_UNKNOWN) {
+		shard = STATS_SHARDS - 1;
+	} else {
+		shard %= STATS_SHARDS - 1;
+	}
+
+	return (&stats->counters[shard * stats->stride + counter]);
+}
+
+/*
+ * The sum of 'counter' over all shards.
+ */
+static isc_statscounter_t
+sum_counter(isc_stats_t *stats, isc_statscounter_t counter) {
+	isc_statscounter_t value = 0;
+
+	for (int i = 0; i < stats->nshards; i++) {
+		value += atomic_load_acquire(
+			&stats->counters[i * stats->stride + counter]);
+	}
+
+	return (value);
+}
+
 static isc_result_t
-create_stats(isc_mem_t *mctx, int ncounters, isc_stats_t **statsp) {
+create_stats(isc_mem_t *mctx, int ncounters, int nshards,
+	     isc_stats_t **statsp) {
 	isc_stats_t *stats;
-	size_t counters_alloc_size;
 
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
 	stats = isc_mem_get(mctx, sizeof(*stats));
-	counters_alloc_size = sizeof(isc__atomic_statcounter_t) * ncounters;
-	stats->counters = isc_mem_get(mctx, counters_alloc_size);
+	stats->nshards = nshards;
+	stats->stride = shard_stride(nshards, ncounters);
+	stats->counters = alloc_counters(mctx, nshards, stats->stride);
 	isc_refcount_init(&stats->references, 1);
-	for (int i = 0; i < ncounters; i++) {
-		atomic_init(&stats->counters[i], 0);
-	}
 	stats->mctx = NULL;
 	isc_mem_attach(mctx, &stats->mctx);
 	stats->ncounters = ncounters;
@@ -81,9 +171,7 @@ isc_stats_detach(isc_stats_t **statsp) {
 
 	if (isc_refcount_decrement(&stats->references) == 1) {
 		isc_refcount_destroy(&stats->references);
-		isc_mem_put(stats->mctx, stats->counters,
-			    sizeof(isc__atomic_statcounter_t) *
-				    stats->ncounters);
+		free_counters(stats);
 		isc_mem_putanddetach(&stats->mctx, stats, sizeof(*stats));
 	}
 }
@@ -99,7 +187,15 @@ isc_result_t
 isc_stats_create(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters) {
 	REQUIRE(statsp != NULL && *statsp == NULL);
 
-	return (create_stats(mctx, ncounters, statsp));
+	return (create_stats(mctx, ncounters, 1, statsp));
+}
+
+isc_result_t
+isc_stats_createsharded(isc_mem_t *mctx, isc_stats_t **statsp,
+			int ncounters) {
+	REQUIRE(statsp != NULL && *statsp == NULL);
+
+	return (create_stats(mctx, ncounters, STATS_SHARDS, statsp));
 }
 
 void
@@ -107,7 +203,7 @@ isc_stats_increment(isc_stats_t *stats, isc_statscounter_t counter) {
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 
-	atomic_fetch_add_relaxed(&stats->counters[counter], 1);
+	atomic_fetch_add_relaxed(local_counter(stats, counter), 1);
 }
 
 void
@@ -115,12 +211,26 @@ isc_stats_decrement(isc_stats_t *stats, isc_statscounter_t counter) {
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 #if ISC_STATS_CHECKUNDERFLOW
-	REQUIRE(atomic_fetch_sub_release(&stats->counters[counter], 1) > 0);
+	/*
+	 * A shard on its own can drop below zero when the matching
+	 * increment was counted by another thread.
+	 */
+	REQUIRE(atomic_fetch_sub_release(local_counter(stats, counter), 1) >
+			0 ||
+		stats->nshards > 1);
 #else
-	atomic_fetch_sub_release(&stats->counters[counter], 1);
+	atomic_fetch_sub_release(local_counter(stats, counter), 1);
 #endif
 }
 
+void
+isc_stats_add(isc_stats_t *stats, isc_statscounter_t counter, uint64_t val) {
+	REQUIRE(ISC_STATS_VALID(stats));
+	REQUIRE(counter < stats->ncounters);
+
+	atomic_fetch_add_relaxed(local_counter(stats, counter), val);
+}
+
 void
 isc_stats_dump(isc_stats_t *stats, isc_stats_dumper_t dump_fn, void *arg,
 	       unsigned int options) {
@@ -129,7 +239,7 @@ isc_stats_dump(isc_stats_t *stats, isc_stats_dumper_t dump_fn, void *arg,
 	REQUIRE(ISC_STATS_VALID(stats));
 
 	for (i = 0; i < stats->ncounters; i++) {
-		uint32_t counter = atomic_load_acquire(&stats->counters[i]);
+		uint32_t counter = sum_counter(stats, i);
 		if ((options & ISC_STATSDUMP_VERBOSE) == 0 && counter == 0) {
 			continue;
 		}
@@ -142,6 +252,10 @@ isc_stats_set(isc_stats_t *stats, uint64_t val, isc_statscounter_t counter) {
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 
+	for (int i = 1; i < stats->nshards; i++) {
+		atomic_store_release(
+			&stats->counters[i * stats->stride + counter], 0);
+	}
 	atomic_store_release(&stats->counters[counter], val);
 }
 
@@ -166,14 +280,14 @@ isc_stats_get_counter(isc_stats_t *stats, isc_statscounter_t counter) {
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 
-	return (atomic_load_acquire(&stats->counters[counter]));
+	return (sum_counter(stats, counter));
 }
 
 void
 isc_stats_resize(isc_stats_t **statsp, int ncounters) {
 	isc_stats_t *stats;
-	size_t counters_alloc_size;
 	isc__atomic_statcounter_t *newcounters;
+	int newstride;
 
 	REQUIRE(statsp != NULL && *statsp != NULL);
 	REQUIRE(ISC_STATS_VALID(*statsp));
@@ -186,17 +300,18 @@ isc_stats_resize(isc_stats_t **statsp, int ncounters) {
 	}
 
 	/* Grow number of counters. */
-	counters_alloc_size = sizeof(isc__atomic_statcounter_t) * ncounters;
-	newcounters = isc_mem_get(stats->mctx, counters_alloc_size);
-	for (int i = 0; i < ncounters; i++) {
-		atomic_init(&newcounters[i], 0);
-	}
-	for (int i = 0; i < stats->ncounters; i++) {
-		uint32_t counter = atomic_load_acquire(&stats->counters[i]);
-		atomic_store_release(&newcounters[i], counter);
+	newstride = shard_stride(stats->nshards, ncounters);
+	newcounters = alloc_counters(stats->mctx, stats->nshards, newstride);
+	for (int shard = 0; shard < stats->nshards; shard++) {
+		for (int i = 0; i < stats->ncounters; i++) {
+			isc_statscounter_t counter = atomic_load_acquire(
+				&stats->counters[shard * stats->stride + i]);
+			atomic_store_release(
+				&newcounters[shard * newstride + i], counter);
+		}
 	}
-	isc_mem_put(stats->mctx, stats->counters,
-		    sizeof(isc__atomic_statcounter_t) * stats->ncounters);
+	free_counters(stats);
 	stats->counters = newcounters;
+	stats->stride = newstride;
 	stats->ncounters = ncounters;
 }
@@ -17,10 +17,10 @@
 #include <sched.h>
 #endif /* if defined(HAVE_SCHED_H) */
 
-#if defined(HAVE_CPUSET_H)
-#include <sys/cpuset.h>
+#if defined(HAVE_SYS_CPUSET_H)
 #include <sys/param.h>
-#endif /* if defined(HAVE_CPUSET_H) */
+#include <sys/cpuset.h>
+#endif /* if defined(HAVE_SYS_CPUSET_H) */
 
 #if defined(HAVE_SYS_PROCSET_H)
 #include <sys/processor.h>
@@ -28,6 +28,7 @@
 #include <sys/types.h>
 #endif /* if defined(HAVE_SYS_PROCSET_H) */
 
+#include <isc/os.h>
 #include <isc/strerr.h>
 #include <isc/thread.h>
 #include <isc/util.h>
@@ -113,3 +114,58 @@ isc_thread_yield(void) {
 	pthread_yield_np();
 #endif /* if defined(HAVE_SCHED_YIELD) */
 }
+
+int
+isc_thread_cpu(unsigned int n) {
+#if defined(HAVE_SCHED_GETAFFINITY) && defined(CPU_COUNT)
+	cpu_set_t cpuset;
+
+	CPU_ZERO(&cpuset);
+	if (sched_getaffinity(0, sizeof(cpuset), &cpuset) == 0 &&
+	    CPU_COUNT(&cpuset) > 0)
+	{
+		n %= CPU_COUNT(&cpuset);
+		for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+			if (CPU_ISSET(cpu, &cpuset) && n-- == 0) {
+				return (cpu);
+			}
+		}
+	}
+#endif /* if defined(HAVE_SCHED_GETAFFINITY) && defined(CPU_COUNT) */
+
+	return (n % isc_os_ncpus());
+}
+
+isc_result_t
+isc_thread_setaffinity(int cpu) {
+#if defined(HAVE_CPUSET_SETAFFINITY)
+	cpuset_t cpuset;
+
+	CPU_ZERO(&cpuset);
+	CPU_SET(cpu, &cpuset);
+	if (cpuset_setaffinity(CPU_LEVEL_WHICH, CPU_WHICH_TID, -1,
+			       sizeof(cpuset), &cpuset) != 0)
+	{
+		return (ISC_R_FAILURE);
+	}
+#elif defined(HAVE_PTHREAD_SETAFFINITY_NP)
+	cpu_set_t cpuset;
+
+	CPU_ZERO(&cpuset);
+	CPU_SET(cpu, &cpuset);
+	if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) !=
+	    0)
+	{
+		return (ISC_R_FAILURE);
+	}
+#elif defined(HAVE_PROCESSOR_BIND)
+	if (processor_bind(P_LWPID, P_MYID, cpu, NULL) != 0) {
+		return (ISC_R_FAILURE);
+	}
+#else  /* if defined(HAVE_CPUSET_SETAFFINITY) */
+	UNUSED(cpu);
+	return (ISC_R_NOTIMPLEMENTED);
+#endif /* if defined(HAVE_CPUSET_SETAFFINITY) */
+
+	return (ISC_R_SUCCESS);
+}
@@ -41,9 +41,9 @@ struct isc_timer {
 	unsigned int magic;
 	isc_refcount_t references;
 	isc_loop_t *loop;
-	uv_timer_t timer;
 	isc_job_cb cb;
 	void *cbarg;
+	const char *name;
 
 	/*
 	 * We are locking the values here for now, but this needs to go away
@@ -52,15 +52,262 @@ struct isc_timer {
 	isc_mutex_t lock;
 	uint64_t timeout;
 	uint64_t repeat;
+
+	/* Owned by the loop */
+	uint64_t expires;
+	unsigned int level;
+	unsigned int slot;
+	ISC_LINK(isc_timer_t) link;
 };
 
 static void
 isc__timer_detach(isc_timer_t **timerp);
 
+/*
+ * Timing wheel
+ */
+
+/* The number of ticks covered by a slot of 'level' */
+#define WHEEL_SPAN(level) (UINT64_C(1) << (TIMERWHEEL_BITS * (level)))
+
+static unsigned int
+wheel_firstbit(uint64_t bits) {
+	INSIST(bits != 0);
+#if HAVE_BUILTIN_CTZLL
+	return (__builtin_ctzll(bits));
+#else  /* if HAVE_BUILTIN_CTZLL */
+	unsigned int n = 0;
+	while ((bits & 1) == 0) {
+		bits >>= 1;
+		n++;
+	}
+	return (n);
+#endif /* if HAVE_BUILTIN_CTZLL */
+}
+
+/*
+ * The next tick that needs processing: the next nonempty slot of the
+ * first level in its current rotation, or the start of the next rotation,
+ * when the slots of the higher levels are moved down.
+ */
+static uint64_t
+wheel_next(isc_timerwheel_t *wheel) {
+	uint64_t next = wheel->now + 1;
+	uint64_t bits;
+
+	if ((next & TIMERWHEEL_MASK) == 0) {
+		return (next);
+	}
+
+	bits = wheel->occupied[0] & (UINT64_MAX << (next & TIMERWHEEL_MASK));
+	if (bits == 0) {
+		return ((next | TIMERWHEEL_MASK) + 1);
+	}
+
+	return ((next & ~(uint64_t)TIMERWHEEL_MASK) + wheel_firstbit(bits));
+}
+
+static void
+wheel_cb(uv_timer_t *handle);
+
+static void
+wheel_arm(isc_loop_t *loop) {
+	isc_timerwheel_t *wheel = &loop->wheel;
+	uint64_t next, now;
+	int r;
+
+	if (wheel->count == 0) {
+		r = uv_timer_stop(&wheel->timer);
+		UV_RUNTIME_CHECK(uv_timer_stop, r);
+		wheel->deadline = UINT64_MAX;
+		return;
+	}
+
+	next = wheel_next(wheel);
+	if (next == wheel->deadline) {
+		return;
+	}
+
+	now = uv_now(&loop->loop);
+	r = uv_timer_start(&wheel->timer, wheel_cb,
+			   next > now ? next - now : 0, 0);
+	UV_RUNTIME_CHECK(uv_timer_start, r);
+	wheel->deadline = next;
+}
+
+/*
+ * Put the timer into the slot for timer->expires, or for 'earliest' if
+ * the timer has already expired.
+ */
+static void
+wheel_insert(isc_timerwheel_t *wheel, isc_timer_t *timer, uint64_t earliest) {
+	uint64_t expires = ISC_MAX(timer->expires, earliest);
+	uint64_t delta = expires - wheel->now;
+	unsigned int level = 0;
+
+	while (level < TIMERWHEEL_LEVELS - 1 &&
+	       delta >= WHEEL_SPAN(level + 1)) {
+		level++;
+	}
+
+	if (delta >= WHEEL_SPAN(TIMERWHEEL_LEVELS)) {
+		/*
+		 * Beyond the last level: park the timer in the last slot
+		 * to be reached, and it will be inserted again from there.
+		 */
+		expires = wheel->now + WHEEL_SPAN(TIMERWHEEL_LEVELS) - 1;
+	}
+
+	timer->level = level;
+	timer->slot = (expires >> (TIMERWHEEL_BITS * level)) & TIMERWHEEL_MASK;
+	ISC_LIST_APPEND(wheel->slots[level][timer->slot], timer, link);
+	wheel->occupied[level] |= (uint64_t)1 << timer->slot;
+	wheel->count++;
+}
+
+static void
+wheel_remove(isc_timerwheel_t *wheel, isc_timer_t *timer) {
+	isc_timerlist_t *list = &wheel->slots[timer->level][timer->slot];
+
+	ISC_LIST_UNLINK(*list, timer, link);
+	if (ISC_LIST_EMPTY(*list)) {
+		wheel->occupied[timer->level] &= ~((uint64_t)1 << timer->slot);
+	}
+	INSIST(wheel->count > 0);
+	wheel->count--;
+}
+
+/*
+ * Move the timers from a slot of a higher level to the lower levels.
+ */
+static void
+wheel_cascade(isc_timerwheel_t *wheel, unsigned int level, unsigned int slot) {
+	isc_timerlist_t *list = &wheel->slots[level][slot];
+	isc_timer_t *timer = NULL;
+
+	while ((timer = ISC_LIST_HEAD(*list)) != NULL) {
+		wheel_remove(wheel, timer);
+		wheel_insert(wheel, timer, wheel->now);
+	}
+}
+
+static void
+wheel_fire(isc_timerwheel_t *wheel, unsigned int slot) {
+	isc_timerlist_t *list = &wheel->slots[0][slot];
+	isc_timer_t *timer = NULL;
+
+	/*
+	 * The callbacks can start, stop and destroy any timer, but none
+	 * can be added to this slot, as the earliest tick for a new timer
+	 * is the next one.
+	 */
+	while ((timer = ISC_LIST_HEAD(*list)) != NULL) {
+		/* The callback may destroy the timer */
+		isc_loop_t *loop = timer->loop;
+		const char *name = timer->name;
+		uint64_t repeat, start;
+
+		REQUIRE(VALID_TIMER(timer));
+
+		wheel_remove(wheel, timer);
+
+		LOCK(&timer->lock);
+		repeat = timer->repeat;
+		UNLOCK(&timer->lock);
+
+		if (repeat > 0) {
+			timer->expires = wheel->now + repeat;
+			wheel_insert(wheel, timer, wheel->now + 1);
+		}
+
+		start = uv_hrtime();
+		timer->cb(timer->cbarg);
+		isc__loop_callback_done(loop, name, start);
+	}
+}
+
+/*
+ * Run the timers that expire up to the tick 'to'.
+ */
+static void
+wheel_advance(isc_timerwheel_t *wheel, uint64_t to) {
+	while (wheel->now < to && wheel->count > 0) {
+		uint64_t tick = wheel_next(wheel);
+		unsigned int level = 0;
+
+		if (tick > to) {
+			break;
+		}
+		wheel->now = tick;
+
+		/*
+		 * At the start of a rotation, move the timers down from the
+		 * slots that are starting, beginning with the highest level.
+		 */
+		while (level < TIMERWHEEL_LEVELS - 1 &&
+		       (tick & (WHEEL_SPAN(level + 1) - 1)) == 0)
+		{
+			level++;
+		}
+		for (; level > 0; level--) {
+			wheel_cascade(wheel, level,
+				      (tick >> (TIMERWHEEL_BITS * level)) &
+					      TIMERWHEEL_MASK);
+		}
+
+		wheel_fire(wheel, tick & TIMERWHEEL_MASK);
+	}
+
+	/* Nothing is due before 'to' */
+	if (wheel->now < to) {
+		wheel->now = to;
+	}
+}
+
+static void
+wheel_cb(uv_timer_t *handle) {
+	isc_loop_t *loop = uv_handle_get_data(handle);
+
+	loop->wheel.deadline = UINT64_MAX;
+	wheel_advance(&loop->wheel, uv_now(&loop->loop));
+	wheel_arm(loop);
+}
+
 void
-isc_timer_create(isc_loop_t *loop, isc_job_cb cb, void *cbarg,
-		 isc_timer_t **timerp) {
+isc__timerwheel_init(isc_loop_t *loop) {
+	isc_timerwheel_t *wheel = &loop->wheel;
 	int r;
+
+	*wheel = (isc_timerwheel_t){
+		.now = uv_now(&loop->loop),
+		.deadline = UINT64_MAX,
+	};
+
+	for (size_t i = 0; i < TIMERWHEEL_LEVELS; i++) {
+		for (size_t j = 0; j < TIMERWHEEL_SLOTS; j++) {
+			ISC_LIST_INIT(wheel->slots[i][j]);
+		}
+	}
+
+	r = uv_timer_init(&loop->loop, &wheel->timer);
+	UV_RUNTIME_CHECK(uv_timer_init, r);
+	uv_handle_set_data(&wheel->timer, loop);
+}
+
+void
+isc__timerwheel_close(isc_loop_t *loop) {
+	INSIST(loop->wheel.count == 0);
+
+	uv_close(&loop->wheel.timer, NULL);
+}
+
+/*
+ * Timers
+ */
+
+void
+isc__timer_create(isc_loop_t *loop, isc_job_cb cb, void *cbarg,
+		  isc_timer_t **timerp, const char *name) {
 	isc_timer_t *timer;
 	isc_loopmgr_t *loopmgr = NULL;
 
@@ -81,6 +328,7 @@ isc_timer_create(isc_loop_t *loop, isc_job_cb cb, void *cbarg,
 	*timer = (isc_timer_t){
 		.cb = cb,
 		.cbarg = cbarg,
+		.name = name,
 	};
 
 	isc_loop_attach(loop, &timer->loop);
@@ -89,19 +337,24 @@ isc_timer_create(isc_loop_t *loop, isc_job_cb cb, void *cbarg,
 
 	isc_mutex_init(&timer->lock);
 
-	timer->magic = TIMER_MAGIC;
+	ISC_LINK_INIT(timer, link);
 
-	r = uv_timer_init(&timer->loop->loop, &timer->timer);
-	UV_RUNTIME_CHECK(uv_timer_init, r);
-	uv_handle_set_data(&timer->timer, timer);
+	timer->magic = TIMER_MAGIC;
 
 	*timerp = timer;
 }
 
+static void
+timer_stop(isc_timer_t *timer) {
+	if (ISC_LINK_LINKED(timer, link)) {
+		wheel_remove(&timer->loop->wheel, timer);
+	}
+}
+
 static void
 isc__timer_stop(void *arg) {
 	isc_timer_t *timer = (isc_timer_t *)arg;
-	uv_timer_stop(&timer->timer);
+	timer_stop(timer);
 	isc__timer_detach(&timer);
 }
 
@@ -117,25 +370,32 @@ isc_timer_stop(isc_timer_t *timer) {
 	}
 }
 
-static void
-timer_cb(uv_timer_t *handle) {
-	isc_timer_t *timer = uv_handle_get_data(handle);
-
-	REQUIRE(VALID_TIMER(timer));
-
-	timer->cb(timer->cbarg);
-}
-
 static void
 isc__timer_start(void *arg) {
 	isc_timer_t *timer = (isc_timer_t *)arg;
+	isc_loop_t *loop = timer->loop;
+	isc_timerwheel_t *wheel = &loop->wheel;
+	uint64_t now = uv_now(&loop->loop);
+	uint64_t timeout;
+
+	timer_stop(timer);
+
+	/* The wheel can't be behind when it is empty */
+	if (wheel->count == 0 && wheel->now < now) {
+		wheel->now = now;
+	}
 
 	LOCK(&timer->lock);
-	int r = uv_timer_start(&timer->timer, timer_cb, timer->timeout,
-			       timer->repeat);
-	UV_RUNTIME_CHECK(uv_timer_start, r);
+	timeout = timer->timeout;
 	UNLOCK(&timer->lock);
 
+	timer->expires = now + timeout;
+
+	wheel_insert(wheel, timer, wheel->now + 1);
+	if (wheel_next(wheel) < wheel->deadline) {
+		wheel_arm(loop);
+	}
+
 	isc__timer_detach(&timer);
 }
 
@@ -179,14 +439,13 @@ isc_timer_start(isc_timer_t *timer, isc_timertype_t type,
 }
 
 static void
-timer_destroy(uv_handle_t *handle) {
-	isc_timer_t *timer = uv_handle_get_data(handle);
-	isc_loop_t *loop;
-
-	REQUIRE(VALID_TIMER(timer));
+isc__timer_destroy(void *arg) {
+	isc_timer_t *timer = (isc_timer_t *)arg;
+	isc_loop_t *loop = timer->loop;
 
-	loop = timer->loop;
+	timer_stop(timer);
 
+	timer->magic = 0;
 	isc_refcount_destroy(&timer->references);
 	isc_mutex_destroy(&timer->lock);
 
@@ -195,14 +454,6 @@ timer_destroy(uv_handle_t *handle) {
 	isc_loop_detach(&loop);
 }
 
-static void
-isc__timer_destroy(void *arg) {
-	isc_timer_t *timer = (isc_timer_t *)arg;
-
-	uv_timer_stop(&timer->timer);
-	uv_close(&timer->timer, timer_destroy);
-}
-
 static void
 isc__timer_detach(isc_timer_t **timerp) {
 	isc_timer_t *timer = NULL;
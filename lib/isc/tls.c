@@ -11,6 +11,8 @@
  * information regarding copyright ownership.
  */
 
+#include <ctype.h>
+#include <errno.h>
 #include <inttypes.h>
 #include <netinet/in.h>
 #include <stdlib.h>
@@ -27,11 +29,16 @@
 #include <openssl/dh.h>
 #include <openssl/err.h>
 #include <openssl/evp.h>
+#include <openssl/hmac.h>
 #include <openssl/opensslv.h>
 #include <openssl/rand.h>
 #include <openssl/rsa.h>
 #include <openssl/x509_vfy.h>
 #include <openssl/x509v3.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
 
 #include <isc/atomic.h>
 #include <isc/ht.h>
@@ -51,14 +58,69 @@
 #include "openssl_shim.h"
 #include "tls_p.h"
 
+/*
+ * Kernel TLS offload (Linux) is only used with TLS 1.3, where the traffic
+ * secrets are exported through the keylog callback.
+ */
+#if HAVE_LINUX_TLS_H && HAVE_SSL_CTX_SET_KEYLOG_CALLBACK && \
+	HAVE_SSL_HAS_PENDING && defined(TLS1_3_VERSION) &&   \
+	!defined(LIBRESSL_VERSION_NUMBER)
+#define HAVE_KTLS 1
+#include <linux/tls.h>
+#include <netinet/tcp.h>
+
+#include <openssl/kdf.h>
+#endif /* HAVE_LINUX_TLS_H && ... */
+
 #define COMMON_SSL_OPTIONS \
 	(SSL_OP_NO_COMPRESSION | SSL_OP_NO_SESSION_RESUMPTION_ON_RENEGOTIATION)
 
+/*
+ * Free the read and write buffers of a connection (about 34KB) while
+ * it has no data in flight, as most connections from stub resolvers
+ * are idle most of the time.
+ */
+#define COMMON_SSL_MODES SSL_MODE_RELEASE_BUFFERS
+
 static isc_once_t init_once = ISC_ONCE_INIT;
 static isc_once_t shut_once = ISC_ONCE_INIT;
 static atomic_bool init_done = false;
 static atomic_bool shut_done = false;
 
+#if HAVE_KTLS
+static int ktls_index = -1;
+static atomic_bool ktls_warned = false;
+
+static void
+ktls_free(void *parent, void *ptr, CRYPTO_EX_DATA *ad, int idx, long argl,
+	  void *argp);
+#endif /* HAVE_KTLS */
+
+/*
+ * Session ticket encryption keys loaded from a file, see
+ * isc_tlsctx_load_ticket_keys().
+ */
+#define TICKET_KEY_NAMELEN   16
+#define TICKET_KEY_SECRETLEN 32
+#define TICKET_KEYS_MAX	     8
+
+typedef struct tls_ticket_key {
+	unsigned char name[TICKET_KEY_NAMELEN];
+	unsigned char hmac[TICKET_KEY_SECRETLEN];
+	unsigned char aes[TICKET_KEY_SECRETLEN];
+} tls_ticket_key_t;
+
+typedef struct tls_ticket_keys {
+	size_t count;
+	tls_ticket_key_t keys[TICKET_KEYS_MAX];
+} tls_ticket_keys_t;
+
+static int ticket_keys_index = -1;
+
+static void
+ticket_keys_free(void *parent, void *ptr, CRYPTO_EX_DATA *ad, int idx,
+		 long argl, void *argp);
+
 #if OPENSSL_VERSION_NUMBER < 0x10100000L
 static isc_mutex_t *locks = NULL;
 static int nlocks;
@@ -120,6 +182,15 @@ tls_initialize(void) {
 				       CONF_MFLAGS_IGNORE_MISSING_FILE);
 #endif
 
+#if HAVE_KTLS
+	ktls_index = SSL_get_ex_new_index(0, NULL, NULL, NULL, ktls_free);
+	RUNTIME_CHECK(ktls_index >= 0);
+#endif /* HAVE_KTLS */
+
+	ticket_keys_index = SSL_CTX_get_ex_new_index(0, NULL, NULL, NULL,
+						     ticket_keys_free);
+	RUNTIME_CHECK(ticket_keys_index >= 0);
+
 	/* Protect ourselves against unseeded PRNG */
 	if (RAND_status() != 1) {
 		FATAL_ERROR(__FILE__, __LINE__,
@@ -197,6 +268,136 @@ isc_tlsctx_attach(isc_tlsctx_t *src, isc_tlsctx_t **ptarget) {
 	*ptarget = src;
 }
 
+#if HAVE_KTLS
+/*
+ * Per-connection state needed to hand the record protection over to the
+ * kernel: the TLS 1.3 application traffic secrets and the number of
+ * records protected with them so far, for both directions.
+ */
+enum { KTLS_RX = 0, KTLS_TX = 1 };
+
+typedef struct tls_ktls {
+	uint8_t	 secret[2][EVP_MAX_MD_SIZE];
+	size_t	 secretlen[2];
+	uint64_t seq[2];
+	bool	 keys[2];
+	bool	 started[2];
+	bool	 ulp;
+	bool	 appdata;
+	bool	 failed;
+} tls_ktls_t;
+
+static void
+ktls_free(void *parent, void *ptr, CRYPTO_EX_DATA *ad, int idx, long argl,
+	  void *argp) {
+	UNUSED(parent);
+	UNUSED(ad);
+	UNUSED(idx);
+	UNUSED(argl);
+	UNUSED(argp);
+
+	if (ptr != NULL) {
+		OPENSSL_clear_free(ptr, sizeof(tls_ktls_t));
+	}
+}
+
+static int
+ktls_hexval(char c) {
+	if (c >= '0' && c <= '9') {
+		return (c - '0');
+	}
+	return (tolower((unsigned char)c) - 'a' + 10);
+}
+
+/*
+ * Capture the application traffic secrets from the keylog lines.  The
+ * keylog callback is invoked at the moment the keys are installed, so
+ * the record counters are restarted here.
+ */
+static void
+ktls_keylog(const SSL *ssl, const char *line) {
+	static const char client_label[] = "CLIENT_TRAFFIC_SECRET_0 ";
+	static const char server_label[] = "SERVER_TRAFFIC_SECRET_0 ";
+	tls_ktls_t *ktls = SSL_get_ex_data(ssl, ktls_index);
+	const char *p = NULL;
+	size_t len = 0;
+	int dir;
+
+	if (ktls == NULL) {
+		return;
+	}
+
+	if (strncmp(line, client_label, sizeof(client_label) - 1) == 0) {
+		dir = SSL_is_server(ssl) ? KTLS_RX : KTLS_TX;
+	} else if (strncmp(line, server_label, sizeof(server_label) - 1) ==
+		   0)
+	{
+		dir = SSL_is_server(ssl) ? KTLS_TX : KTLS_RX;
+	} else {
+		return;
+	}
+
+	/* Skip the label and the client random */
+	p = strchr(line + sizeof(client_label) - 1, ' ');
+	if (p == NULL) {
+		ktls->failed = true;
+		return;
+	}
+	p++;
+
+	while (isxdigit((unsigned char)p[0]) && isxdigit((unsigned char)p[1]))
+	{
+		if (len == sizeof(ktls->secret[dir])) {
+			ktls->failed = true;
+			return;
+		}
+		ktls->secret[dir][len++] = (ktls_hexval(p[0]) << 4) |
+					   ktls_hexval(p[1]);
+		p += 2;
+	}
+
+	ktls->secretlen[dir] = len;
+	ktls->seq[dir] = 0;
+	ktls->keys[dir] = (len > 0);
+}
+
+/*
+ * Count the records protected with the application traffic keys, and
+ * watch for the messages the kernel can't deal with.
+ */
+static void
+ktls_msg_cb(int write_p, int version, int content_type, const void *buf,
+	    size_t len, SSL *ssl, void *arg) {
+	tls_ktls_t *ktls = arg;
+	const uint8_t *p = buf;
+	int dir = write_p ? KTLS_TX : KTLS_RX;
+
+	UNUSED(version);
+	UNUSED(ssl);
+
+	switch (content_type) {
+	case SSL3_RT_HEADER:
+		if (ktls->keys[dir]) {
+			ktls->seq[dir]++;
+		}
+		break;
+	case SSL3_RT_INNER_CONTENT_TYPE:
+		if (!write_p && len == 1 && p[0] == SSL3_RT_APPLICATION_DATA) {
+			ktls->appdata = true;
+		}
+		break;
+	case SSL3_RT_HANDSHAKE:
+		/* We don't follow the key updates */
+		if (len > 0 && p[0] == SSL3_MT_KEY_UPDATE) {
+			ktls->failed = true;
+		}
+		break;
+	default:
+		break;
+	}
+}
+#endif /* HAVE_KTLS */
+
 #if HAVE_SSL_CTX_SET_KEYLOG_CALLBACK
 /*
  * Callback invoked by the SSL library whenever a new TLS pre-master secret
@@ -204,7 +405,11 @@ isc_tlsctx_attach(isc_tlsctx_t *src, isc_tlsctx_t **ptarget) {
  */
 static void
 sslkeylogfile_append(const SSL *ssl, const char *line) {
+#if HAVE_KTLS
+	ktls_keylog(ssl, line);
+#else
 	UNUSED(ssl);
+#endif /* HAVE_KTLS */
 
 	isc_log_write(isc_lctx, ISC_LOGCATEGORY_SSLKEYLOG, ISC_LOGMODULE_NETMGR,
 		      ISC_LOG_INFO, "%s", line);
@@ -213,12 +418,17 @@ sslkeylogfile_append(const SSL *ssl, const char *line) {
 /*
  * Enable TLS pre-master secret logging if the SSLKEYLOGFILE environment
  * variable is set.  This needs to be done on a per-context basis as that is
- * how SSL_CTX_set_keylog_callback() works.
+ * how SSL_CTX_set_keylog_callback() works.  The secrets are also needed
+ * if the kernel TLS offload gets enabled on any connection using 'ctx'.
  */
 static void
 sslkeylogfile_init(isc_tlsctx_t *ctx) {
 	if (getenv("SSLKEYLOGFILE") != NULL) {
 		SSL_CTX_set_keylog_callback(ctx, sslkeylogfile_append);
+	} else {
+#if HAVE_KTLS
+		SSL_CTX_set_keylog_callback(ctx, ktls_keylog);
+#endif /* HAVE_KTLS */
 	}
 }
 #else /* HAVE_SSL_CTX_SET_KEYLOG_CALLBACK */
@@ -244,6 +454,7 @@ isc_tlsctx_createclient(isc_tlsctx_t **ctxp) {
 	}
 
 	SSL_CTX_set_options(ctx, COMMON_SSL_OPTIONS);
+	SSL_CTX_set_mode(ctx, COMMON_SSL_MODES);
 
 #if HAVE_SSL_CTX_SET_MIN_PROTO_VERSION
 	SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
@@ -320,6 +531,7 @@ isc_tlsctx_createserver(const char *keyfile, const char *certfile,
 	RUNTIME_CHECK(ctx != NULL);
 
 	SSL_CTX_set_options(ctx, COMMON_SSL_OPTIONS);
+	SSL_CTX_set_mode(ctx, COMMON_SSL_MODES);
 
 #if HAVE_SSL_CTX_SET_MIN_PROTO_VERSION
 	SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
@@ -742,6 +954,181 @@ isc_tlsctx_session_tickets(isc_tlsctx_t *ctx, const bool use) {
 	}
 }
 
+static void
+ticket_keys_free(void *parent, void *ptr, CRYPTO_EX_DATA *ad, int idx,
+		 long argl, void *argp) {
+	UNUSED(parent);
+	UNUSED(ad);
+	UNUSED(idx);
+	UNUSED(argl);
+	UNUSED(argp);
+
+	if (ptr != NULL) {
+		OPENSSL_clear_free(ptr, sizeof(tls_ticket_keys_t));
+	}
+}
+
+/*
+ * Find the ticket key to use: the first one for new tickets, the one
+ * whose name matches the ticket otherwise.  Returns the index of the
+ * key, or -1 if there is none.
+ */
+static int
+ticket_key_find(SSL *ssl, unsigned char *key_name, int enc,
+		tls_ticket_keys_t **keysp) {
+	tls_ticket_keys_t *keys = SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl),
+						      ticket_keys_index);
+
+	*keysp = keys;
+	if (keys == NULL || keys->count == 0) {
+		return (-1);
+	}
+
+	if (enc) {
+		memmove(key_name, keys->keys[0].name, TICKET_KEY_NAMELEN);
+		return (0);
+	}
+
+	for (size_t i = 0; i < keys->count; i++) {
+		if (memcmp(key_name, keys->keys[i].name, TICKET_KEY_NAMELEN) ==
+		    0)
+		{
+			return ((int)i);
+		}
+	}
+
+	return (-1);
+}
+
+/*
+ * The return values follow the OpenSSL ticket key callback conventions:
+ * -1 on error, 0 when the ticket cannot be decrypted (a full handshake
+ * follows), 1 on success and 2 when the ticket was decrypted with an
+ * older key and should be renewed.
+ */
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+static int
+ticket_key_cb(SSL *ssl, unsigned char *key_name, unsigned char *iv,
+	      EVP_CIPHER_CTX *ectx, EVP_MAC_CTX *hctx, int enc) {
+	tls_ticket_keys_t *keys = NULL;
+	tls_ticket_key_t *key = NULL;
+	OSSL_PARAM params[3];
+	int i = ticket_key_find(ssl, key_name, enc, &keys);
+
+	if (i < 0) {
+		return (enc ? -1 : 0);
+	}
+	key = &keys->keys[i];
+
+	params[0] = OSSL_PARAM_construct_octet_string(
+		OSSL_MAC_PARAM_KEY, key->hmac, sizeof(key->hmac));
+	params[1] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+						     (char *)"sha256", 0);
+	params[2] = OSSL_PARAM_construct_end();
+
+	if (enc) {
+		if (RAND_bytes(iv, EVP_MAX_IV_LENGTH) != 1 ||
+		    EVP_EncryptInit_ex(ectx, EVP_aes_256_cbc(), NULL, key->aes,
+				       iv) != 1 ||
+		    EVP_MAC_CTX_set_params(hctx, params) != 1)
+		{
+			return (-1);
+		}
+		return (1);
+	}
+
+	if (EVP_MAC_CTX_set_params(hctx, params) != 1 ||
+	    EVP_DecryptInit_ex(ectx, EVP_aes_256_cbc(), NULL, key->aes, iv) !=
+		    1)
+	{
+		return (-1);
+	}
+	return (i == 0 ? 1 : 2);
+}
+#else  /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
+static int
+ticket_key_cb(SSL *ssl, unsigned char *key_name, unsigned char *iv,
+	      EVP_CIPHER_CTX *ectx, HMAC_CTX *hctx, int enc) {
+	tls_ticket_keys_t *keys = NULL;
+	tls_ticket_key_t *key = NULL;
+	int i = ticket_key_find(ssl, key_name, enc, &keys);
+
+	if (i < 0) {
+		return (enc ? -1 : 0);
+	}
+	key = &keys->keys[i];
+
+	if (enc) {
+		if (RAND_bytes(iv, EVP_MAX_IV_LENGTH) != 1 ||
+		    EVP_EncryptInit_ex(ectx, EVP_aes_256_cbc(), NULL, key->aes,
+				       iv) != 1 ||
+		    HMAC_Init_ex(hctx, key->hmac, sizeof(key->hmac),
+				 EVP_sha256(), NULL) != 1)
+		{
+			return (-1);
+		}
+		return (1);
+	}
+
+	if (HMAC_Init_ex(hctx, key->hmac, sizeof(key->hmac), EVP_sha256(),
+			 NULL) != 1 ||
+	    EVP_DecryptInit_ex(ectx, EVP_aes_256_cbc(), NULL, key->aes, iv) !=
+		    1)
+	{
+		return (-1);
+	}
+	return (i == 0 ? 1 : 2);
+}
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
+
+isc_result_t
+isc_tlsctx_load_ticket_keys(isc_tlsctx_t *ctx, const char *keyfile) {
+	tls_ticket_keys_t *keys = NULL, *old = NULL;
+	unsigned char buf[sizeof(tls_ticket_key_t) * TICKET_KEYS_MAX + 1];
+	size_t len;
+	FILE *fp = NULL;
+
+	REQUIRE(ctx != NULL);
+	REQUIRE(keyfile != NULL && *keyfile != '\0');
+
+	fp = fopen(keyfile, "rb");
+	if (fp == NULL) {
+		return (ISC_R_FILENOTFOUND);
+	}
+	len = fread(buf, 1, sizeof(buf), fp);
+	fclose(fp);
+
+	if (len == 0 || len % sizeof(tls_ticket_key_t) != 0 ||
+	    len > sizeof(tls_ticket_key_t) * TICKET_KEYS_MAX)
+	{
+		OPENSSL_cleanse(buf, sizeof(buf));
+		return (ISC_R_INVALIDFILE);
+	}
+
+	keys = OPENSSL_zalloc(sizeof(*keys));
+	RUNTIME_CHECK(keys != NULL);
+	keys->count = len / sizeof(tls_ticket_key_t);
+	memmove(keys->keys, buf, len);
+	OPENSSL_cleanse(buf, sizeof(buf));
+
+	old = SSL_CTX_get_ex_data(ctx, ticket_keys_index);
+	if (SSL_CTX_set_ex_data(ctx, ticket_keys_index, keys) != 1) {
+		OPENSSL_clear_free(keys, sizeof(*keys));
+		return (ISC_R_FAILURE);
+	}
+	if (old != NULL) {
+		OPENSSL_clear_free(old, sizeof(*old));
+	}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	(void)SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, ticket_key_cb);
+#else  /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
+	(void)SSL_CTX_set_tlsext_ticket_key_cb(ctx, ticket_key_cb);
+#endif /* OPENSSL_VERSION_NUMBER >= 0x30000000L */
+
+	return (ISC_R_SUCCESS);
+}
+
 isc_tls_t *
 isc_tls_create(isc_tlsctx_t *ctx) {
 	isc_tls_t *newctx = NULL;
@@ -776,6 +1163,330 @@ isc_tls_verify_peer_result_string(isc_tls_t *tls) {
 	return (X509_verify_cert_error_string(SSL_get_verify_result(tls)));
 }
 
+#if HAVE_KTLS
+/*
+ * HKDF-Expand-Label() from RFC 8446, Section 7.1, with an empty context.
+ */
+static bool
+ktls_expand_label(const EVP_MD *md, const uint8_t *secret, size_t secretlen,
+		  const char *label, uint8_t *out, size_t outlen) {
+	static const char prefix[] = "tls13 ";
+	uint8_t info[2 + 1 + sizeof(prefix) + 16 + 1];
+	size_t labellen = sizeof(prefix) - 1 + strlen(label);
+	size_t infolen = 0;
+	EVP_PKEY_CTX *pctx = NULL;
+	bool ok;
+
+	INSIST(labellen <= sizeof(info) - 4);
+
+	info[infolen++] = (outlen >> 8) & 0xff;
+	info[infolen++] = outlen & 0xff;
+	info[infolen++] = labellen;
+	memmove(info + infolen, prefix, sizeof(prefix) - 1);
+	infolen += sizeof(prefix) - 1;
+	memmove(info + infolen, label, strlen(label));
+	infolen += strlen(label);
+	info[infolen++] = 0;
+
+	pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, NULL);
+	if (pctx == NULL) {
+		return (false);
+	}
+
+	ok = EVP_PKEY_derive_init(pctx) == 1 &&
+	     EVP_PKEY_CTX_hkdf_mode(pctx, EVP_PKEY_HKDEF_MODE_EXPAND_ONLY) ==
+		     1 &&
+	     EVP_PKEY_CTX_set_hkdf_md(pctx, md) == 1 &&
+	     EVP_PKEY_CTX_set1_hkdf_key(pctx, secret, secretlen) == 1 &&
+	     EVP_PKEY_CTX_add1_hkdf_info(pctx, info, infolen) == 1 &&
+	     EVP_PKEY_derive(pctx, out, &outlen) == 1;
+
+	EVP_PKEY_CTX_free(pctx);
+
+	return (ok);
+}
+
+static void
+ktls_warn(const char *what, int err) {
+	char strbuf[ISC_STRERRORSIZE];
+
+	if (!atomic_compare_exchange_strong(&ktls_warned, &(bool){ false },
+					    true))
+	{
+		return;
+	}
+
+	strerror_r(err, strbuf, sizeof(strbuf));
+	isc_log_write(isc_lctx, ISC_LOGCATEGORY_GENERAL, ISC_LOGMODULE_NETMGR,
+		      ISC_LOG_WARNING, "kernel TLS offload unavailable: %s: %s",
+		      what, strbuf);
+}
+
+static isc_result_t
+ktls_start(isc_tls_t *tls, tls_ktls_t *ktls, int fd, int dir) {
+	const SSL_CIPHER *cipher = NULL;
+	const EVP_MD *md = NULL;
+	uint8_t key[32], iv[12];
+	size_t keylen;
+	union {
+		struct tls_crypto_info info;
+		struct tls12_crypto_info_aes_gcm_128 aes128;
+		struct tls12_crypto_info_aes_gcm_256 aes256;
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+		struct tls12_crypto_info_chacha20_poly1305 chacha;
+#endif /* TLS_CIPHER_CHACHA20_POLY1305 */
+	} ci;
+	socklen_t cilen;
+	unsigned char *rec_seq = NULL;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	if (ktls->failed || SSL_version(tls) != TLS1_3_VERSION ||
+	    !ktls->keys[dir])
+	{
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	cipher = SSL_get_current_cipher(tls);
+	if (cipher == NULL) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	memset(&ci, 0, sizeof(ci));
+	ci.info.version = TLS_1_3_VERSION;
+
+	switch (SSL_CIPHER_get_protocol_id(cipher)) {
+	case 0x1301: /* TLS_AES_128_GCM_SHA256 */
+		ci.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+		cilen = sizeof(ci.aes128);
+		keylen = TLS_CIPHER_AES_GCM_128_KEY_SIZE;
+		break;
+	case 0x1302: /* TLS_AES_256_GCM_SHA384 */
+		ci.info.cipher_type = TLS_CIPHER_AES_GCM_256;
+		cilen = sizeof(ci.aes256);
+		keylen = TLS_CIPHER_AES_GCM_256_KEY_SIZE;
+		break;
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+	case 0x1303: /* TLS_CHACHA20_POLY1305_SHA256 */
+		ci.info.cipher_type = TLS_CIPHER_CHACHA20_POLY1305;
+		cilen = sizeof(ci.chacha);
+		keylen = TLS_CIPHER_CHACHA20_POLY1305_KEY_SIZE;
+		break;
+#endif /* TLS_CIPHER_CHACHA20_POLY1305 */
+	default:
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	md = SSL_CIPHER_get_handshake_digest(cipher);
+	if (md == NULL ||
+	    !ktls_expand_label(md, ktls->secret[dir], ktls->secretlen[dir],
+			       "key", key, keylen) ||
+	    !ktls_expand_label(md, ktls->secret[dir], ktls->secretlen[dir],
+			       "iv", iv, sizeof(iv)))
+	{
+		result = ISC_R_TLSERROR;
+		goto cleanup;
+	}
+
+	/*
+	 * The kernel splits the 12 octet TLS 1.3 nonce into the salt and
+	 * the IV for AES-GCM, and takes it whole for ChaCha20-Poly1305.
+	 */
+	switch (ci.info.cipher_type) {
+	case TLS_CIPHER_AES_GCM_128:
+		memmove(ci.aes128.salt, iv, sizeof(ci.aes128.salt));
+		memmove(ci.aes128.iv, iv + sizeof(ci.aes128.salt),
+			sizeof(ci.aes128.iv));
+		memmove(ci.aes128.key, key, keylen);
+		rec_seq = ci.aes128.rec_seq;
+		break;
+	case TLS_CIPHER_AES_GCM_256:
+		memmove(ci.aes256.salt, iv, sizeof(ci.aes256.salt));
+		memmove(ci.aes256.iv, iv + sizeof(ci.aes256.salt),
+			sizeof(ci.aes256.iv));
+		memmove(ci.aes256.key, key, keylen);
+		rec_seq = ci.aes256.rec_seq;
+		break;
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+	case TLS_CIPHER_CHACHA20_POLY1305:
+		memmove(ci.chacha.iv, iv, sizeof(ci.chacha.iv));
+		memmove(ci.chacha.key, key, keylen);
+		rec_seq = ci.chacha.rec_seq;
+		break;
+#endif /* TLS_CIPHER_CHACHA20_POLY1305 */
+	default:
+		UNREACHABLE();
+	}
+
+	for (size_t i = 0; i < 8; i++) {
+		rec_seq[i] = (ktls->seq[dir] >> (56 - 8 * i)) & 0xff;
+	}
+
+	if (!ktls->ulp) {
+		if (setsockopt(fd, IPPROTO_TCP, TCP_ULP, "tls",
+			       sizeof("tls")) != 0)
+		{
+			ktls_warn("setsockopt(TCP_ULP)", errno);
+			result = ISC_R_NOTIMPLEMENTED;
+			goto cleanup;
+		}
+		ktls->ulp = true;
+	}
+
+	if (setsockopt(fd, SOL_TLS, (dir == KTLS_TX) ? TLS_TX : TLS_RX, &ci,
+		       cilen) != 0)
+	{
+		ktls_warn((dir == KTLS_TX) ? "setsockopt(TLS_TX)"
+					   : "setsockopt(TLS_RX)",
+			  errno);
+		result = ISC_R_NOTIMPLEMENTED;
+		goto cleanup;
+	}
+
+	ktls->started[dir] = true;
+
+cleanup:
+	OPENSSL_cleanse(&ci, sizeof(ci));
+	OPENSSL_cleanse(key, sizeof(key));
+	OPENSSL_cleanse(iv, sizeof(iv));
+
+	/* The secret is not needed anymore, whatever the outcome */
+	OPENSSL_cleanse(ktls->secret[dir], sizeof(ktls->secret[dir]));
+	ktls->keys[dir] = false;
+
+	return (result);
+}
+#endif /* HAVE_KTLS */
+
+bool
+isc_tls_ktls_supported(void) {
+#if HAVE_KTLS
+	return (true);
+#else
+	return (false);
+#endif /* HAVE_KTLS */
+}
+
+isc_result_t
+isc_tls_ktls_prepare(isc_tls_t *tls) {
+	REQUIRE(tls != NULL);
+
+#if HAVE_KTLS
+	tls_ktls_t *ktls = SSL_get_ex_data(tls, ktls_index);
+
+	REQUIRE(ktls == NULL);
+
+	ktls = OPENSSL_zalloc(sizeof(*ktls));
+	if (ktls == NULL) {
+		return (ISC_R_NOMEMORY);
+	}
+
+	if (SSL_set_ex_data(tls, ktls_index, ktls) != 1) {
+		OPENSSL_free(ktls);
+		return (ISC_R_FAILURE);
+	}
+
+	SSL_set_msg_callback(tls, ktls_msg_cb);
+	SSL_set_msg_callback_arg(tls, ktls);
+
+	return (ISC_R_SUCCESS);
+#else
+	return (ISC_R_NOTIMPLEMENTED);
+#endif /* HAVE_KTLS */
+}
+
+isc_result_t
+isc_tls_ktls_start_tx(isc_tls_t *tls, int fd) {
+	REQUIRE(tls != NULL);
+	REQUIRE(SSL_is_init_finished(tls));
+
+#if HAVE_KTLS
+	tls_ktls_t *ktls = SSL_get_ex_data(tls, ktls_index);
+
+	REQUIRE(ktls != NULL);
+	REQUIRE(!ktls->started[KTLS_TX]);
+
+	/* Everything encrypted so far must have been sent */
+	if (BIO_ctrl_wpending(SSL_get_wbio(tls)) != 0) {
+		return (ISC_R_WOULDBLOCK);
+	}
+
+	return (ktls_start(tls, ktls, fd, KTLS_TX));
+#else
+	UNUSED(fd);
+
+	return (ISC_R_NOTIMPLEMENTED);
+#endif /* HAVE_KTLS */
+}
+
+isc_result_t
+isc_tls_ktls_start_rx(isc_tls_t *tls, int fd) {
+	REQUIRE(tls != NULL);
+	REQUIRE(SSL_is_init_finished(tls));
+
+#if HAVE_KTLS
+	tls_ktls_t *ktls = SSL_get_ex_data(tls, ktls_index);
+
+	REQUIRE(ktls != NULL);
+	REQUIRE(!ktls->started[KTLS_RX]);
+
+	/*
+	 * Everything received so far must have been decrypted, so the
+	 * kernel starts at a record boundary.
+	 */
+	if (BIO_ctrl_pending(SSL_get_rbio(tls)) != 0 || SSL_has_pending(tls))
+	{
+		return (ISC_R_WOULDBLOCK);
+	}
+
+	/*
+	 * A client must process the NewSessionTicket messages which the
+	 * server sends ahead of the first response.
+	 */
+	if (!SSL_is_server(tls) && !ktls->appdata && !ktls->failed) {
+		return (ISC_R_WOULDBLOCK);
+	}
+
+	return (ktls_start(tls, ktls, fd, KTLS_RX));
+#else
+	UNUSED(fd);
+
+	return (ISC_R_NOTIMPLEMENTED);
+#endif /* HAVE_KTLS */
+}
+
+isc_result_t
+isc_tls_ktls_close_notify(int fd) {
+#if HAVE_KTLS
+	unsigned char alert[2] = { SSL3_AL_WARNING, SSL_AD_CLOSE_NOTIFY };
+	char cbuf[CMSG_SPACE(sizeof(unsigned char))] = { 0 };
+	struct iovec iov = { .iov_base = alert, .iov_len = sizeof(alert) };
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = cbuf,
+		.msg_controllen = sizeof(cbuf),
+	};
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+
+	cmsg->cmsg_level = SOL_TLS;
+	cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(unsigned char));
+	*CMSG_DATA(cmsg) = SSL3_RT_ALERT;
+
+	if (sendmsg(fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) !=
+	    (ssize_t)sizeof(alert))
+	{
+		return (ISC_R_FAILURE);
+	}
+
+	return (ISC_R_SUCCESS);
+#else
+	UNUSED(fd);
+
+	return (ISC_R_NOTIMPLEMENTED);
+#endif /* HAVE_KTLS */
+}
+
 #if HAVE_LIBNGHTTP2
 #ifndef OPENSSL_NO_NEXTPROTONEG
 /*
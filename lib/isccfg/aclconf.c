@@ -987,6 +987,13 @@ cfg_acl_fromconfig2(const cfg_obj_t *acl_data, const cfg_obj_t *cctx,
 		INSIST(dacl->length <= dacl->alloc);
 	}
 
+	/*
+	 * The ACL is complete; compile its prefixes for matching.  A
+	 * nested ACL that is absorbed into its parent gets compiled
+	 * again with the parent.
+	 */
+	dns_iptable_compile(dacl->iptable);
+
 	dns_acl_attach(dacl, target);
 	result = ISC_R_SUCCESS;
 
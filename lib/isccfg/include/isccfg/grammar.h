@@ -18,6 +18,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/hashmap.h>
 #include <isc/lex.h>
 #include <isc/netaddr.h>
 #include <isc/region.h>
@@ -253,6 +254,12 @@ struct cfg_parser {
 	/*%< Reference counter */
 	isc_refcount_t references;
 
+	/*%
+	 * The string values parsed so far, interned so that
+	 * identical strings share a single copy.
+	 */
+	isc_hashmap_t *strings;
+
 	cfg_parsecallback_t callback;
 	void		   *callbackarg;
 };
@@ -338,6 +345,14 @@ cfg_ungettoken(cfg_parser_t *pctx);
 isc_result_t
 cfg_create_obj(cfg_parser_t *pctx, const cfg_type_t *type, cfg_obj_t **objp);
 
+isc_result_t
+cfg_create_string(cfg_parser_t *pctx, const char *contents,
+		  const cfg_type_t *type, cfg_obj_t **objp);
+/*%<
+ * Create a string object of type 'type' holding the null-terminated
+ * string 'contents'.
+ */
+
 void
 cfg_print_rawuint(cfg_printer_t *pctx, unsigned int u);
 
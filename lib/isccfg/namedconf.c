@@ -168,6 +168,7 @@ static cfg_tuplefielddef_t listenon_tuple_fields[] = {
 #else
 	{ "http", &cfg_type_astring, CFG_CLAUSEFLAG_NOTCONFIGURED },
 #endif
+	{ "proxy", &cfg_type_boolean, 0 },
 	{ NULL, NULL, 0 }
 };
 static cfg_type_t cfg_type_listen_tuple = {
@@ -414,15 +415,8 @@ parse_updatepolicy(cfg_parser_t *pctx, const cfg_type_t *type,
 	if (pctx->token.type == isc_tokentype_string &&
 	    strcasecmp(TOKEN_STRING(pctx), "local") == 0)
 	{
-		cfg_obj_t *obj = NULL;
-		CHECK(cfg_create_obj(pctx, &cfg_type_ustring, &obj));
-		obj->value.string.length = strlen("local");
-		obj->value.string.base =
-			isc_mem_get(pctx->mctx, obj->value.string.length + 1);
-		memmove(obj->value.string.base, "local", 5);
-		obj->value.string.base[5] = '\0';
-		*ret = obj;
-		return (ISC_R_SUCCESS);
+		return (cfg_create_string(pctx, "local", &cfg_type_ustring,
+					  ret));
 	}
 
 	cfg_ungettoken(pctx);
@@ -1210,18 +1204,24 @@ static cfg_type_t cfg_type_fstrm_model = {
  * Clauses that can be found within the 'options' statement.
  */
 static cfg_clausedef_t options_clauses[] = {
+	{ "adb-save-interval", &cfg_type_duration, 0 },
+	{ "af-xdp-interface", &cfg_type_astring, 0 },
+	{ "allow-proxy", &cfg_type_bracketed_aml, 0 },
 	{ "answer-cookie", &cfg_type_boolean, 0 },
 	{ "automatic-interface-scan", &cfg_type_boolean, 0 },
 	{ "avoid-v4-udp-ports", &cfg_type_bracketed_portlist, 0 },
 	{ "avoid-v6-udp-ports", &cfg_type_bracketed_portlist, 0 },
 	{ "bindkeys-file", &cfg_type_qstring, 0 },
 	{ "blackhole", &cfg_type_bracketed_aml, 0 },
+	{ "concurrent-zone-dumps", &cfg_type_uint32, 0 },
+	{ "concurrent-zone-loads", &cfg_type_uint32, 0 },
 	{ "cookie-algorithm", &cfg_type_cookiealg, 0 },
 	{ "cookie-secret", &cfg_type_sstring, CFG_CLAUSEFLAG_MULTI },
 	{ "coresize", &cfg_type_size, 0 },
 	{ "datasize", &cfg_type_size, 0 },
 	{ "deallocate-on-exit", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "directory", &cfg_type_qstring, CFG_CLAUSEFLAG_CALLBACK },
+	{ "dnssec-key-pool-depth", &cfg_type_uint32, 0 },
 #ifdef HAVE_DNSTAP
 	{ "dnstap-output", &cfg_type_dnstapoutput, 0 },
 	{ "dnstap-identity", &cfg_type_serverid, 0 },
@@ -1275,19 +1275,25 @@ static cfg_clausedef_t options_clauses[] = {
 	{ "host-statistics-max", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "hostname", &cfg_type_qstringornone, 0 },
 	{ "interface-interval", &cfg_type_duration, 0 },
+	{ "io-uring", &cfg_type_boolean, 0 },
 	{ "keep-response-order", &cfg_type_bracketed_aml,
 	  CFG_CLAUSEFLAG_OBSOLETE },
+	{ "kernel-tls", &cfg_type_boolean, 0 },
 	{ "listen-on", &cfg_type_listenon, CFG_CLAUSEFLAG_MULTI },
 	{ "listen-on-v6", &cfg_type_listenon, CFG_CLAUSEFLAG_MULTI },
 	{ "lock-file", &cfg_type_qstringornone, 0 },
+	{ "loop-stall-threshold", &cfg_type_uint32, 0 },
 	{ "managed-keys-directory", &cfg_type_qstring, 0 },
 	{ "match-mapped-addresses", &cfg_type_boolean, 0 },
 	{ "max-rsa-exponent-size", &cfg_type_uint32, 0 },
 	{ "memstatistics", &cfg_type_boolean, 0 },
+	{ "memprof-file", &cfg_type_qstring, 0 },
 	{ "memstatistics-file", &cfg_type_qstring, 0 },
 	{ "multiple-cnames", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "named-xfer", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "notify-rate", &cfg_type_uint32, 0 },
+	{ "outgoing-tcp-idle-timeout", &cfg_type_uint32, 0 },
+	{ "outgoing-tcp-pool-size", &cfg_type_uint32, 0 },
 	{ "pid-file", &cfg_type_qstringornone, 0 },
 	{ "port", &cfg_type_uint32, 0 },
 	{ "tls-port", &cfg_type_uint32, 0 },
@@ -1334,12 +1340,14 @@ static cfg_clausedef_t options_clauses[] = {
 	{ "tkey-domain", &cfg_type_qstring, 0 },
 	{ "tkey-gssapi-credential", &cfg_type_qstring, 0 },
 	{ "tkey-gssapi-keytab", &cfg_type_qstring, 0 },
+	{ "transfer-cache-size", &cfg_type_sizeval, 0 },
 	{ "transfer-message-size", &cfg_type_uint32, 0 },
 	{ "transfers-in", &cfg_type_uint32, 0 },
 	{ "transfers-out", &cfg_type_uint32, 0 },
 	{ "transfers-per-ns", &cfg_type_uint32, 0 },
 	{ "treat-cr-as-space", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "udp-receive-buffer", &cfg_type_uint32, 0 },
+	{ "udp-send-batching", &cfg_type_boolean, 0 },
 	{ "udp-send-buffer", &cfg_type_uint32, 0 },
 	{ "use-id-pool", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "use-ixfr", NULL, CFG_CLAUSEFLAG_ANCIENT },
@@ -1439,6 +1447,12 @@ static cfg_type_t cfg_type_mustbesecure = {
 	cfg_doc_tuple,	&cfg_rep_tuple,	 mustbesecure_fields
 };
 
+static const char *cacheeviction_enums[] = { "lru", "sieve", NULL };
+static cfg_type_t cfg_type_cacheeviction = {
+	"cacheeviction", cfg_parse_enum,  cfg_print_ustring,
+	cfg_doc_enum,	 &cfg_rep_string, &cacheeviction_enums
+};
+
 static const char *masterformat_enums[] = { "raw", "text", NULL };
 static cfg_type_t cfg_type_masterformat = {
 	"masterformat", cfg_parse_enum,	 cfg_print_ustring,
@@ -2034,7 +2048,11 @@ static cfg_clausedef_t view_clauses[] = {
 	{ "allow-v6-synthesis", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "attach-cache", &cfg_type_astring, 0 },
 	{ "auth-nxdomain", &cfg_type_boolean, 0 },
+	{ "cache-cold-tier-file", &cfg_type_qstring, 0 },
+	{ "cache-cold-tier-size", &cfg_type_sizeval, 0 },
+	{ "cache-eviction-policy", &cfg_type_cacheeviction, 0 },
 	{ "cache-file", &cfg_type_qstring, CFG_CLAUSEFLAG_ANCIENT },
+	{ "cache-snapshot-file", &cfg_type_qstring, 0 },
 	{ "catalog-zones", &cfg_type_catz, 0 },
 	{ "check-names", &cfg_type_checknames, CFG_CLAUSEFLAG_MULTI },
 	{ "cleaning-interval", NULL, CFG_CLAUSEFLAG_ANCIENT },
@@ -2063,11 +2081,29 @@ static cfg_clausedef_t view_clauses[] = {
 	  CFG_CLAUSEFLAG_MULTI | CFG_CLAUSEFLAG_ANCIENT },
 	{ "dnssec-must-be-secure", &cfg_type_mustbesecure,
 	  CFG_CLAUSEFLAG_MULTI },
+	{ "dnssec-offload-threshold", &cfg_type_uint32, 0 },
 	{ "dnssec-validation", &cfg_type_boolorauto, 0 },
 #ifdef HAVE_DNSTAP
 	{ "dnstap", &cfg_type_dnstap, 0 },
+	{ "dnstap-filter-clients", &cfg_type_bracketed_aml, 0 },
+	{ "dnstap-filter-names", &cfg_type_namelist, 0 },
+	{ "dnstap-filter-rcodes", &cfg_type_namelist, 0 },
+	{ "dnstap-filter-types", &cfg_type_namelist, 0 },
+	{ "dnstap-sample", &cfg_type_uint32, 0 },
+	{ "dnstap-sample-by-client", &cfg_type_boolean, 0 },
 #else  /* ifdef HAVE_DNSTAP */
 	{ "dnstap", &cfg_type_dnstap, CFG_CLAUSEFLAG_NOTCONFIGURED },
+	{ "dnstap-filter-clients", &cfg_type_bracketed_aml,
+	  CFG_CLAUSEFLAG_NOTCONFIGURED },
+	{ "dnstap-filter-names", &cfg_type_namelist,
+	  CFG_CLAUSEFLAG_NOTCONFIGURED },
+	{ "dnstap-filter-rcodes", &cfg_type_namelist,
+	  CFG_CLAUSEFLAG_NOTCONFIGURED },
+	{ "dnstap-filter-types", &cfg_type_namelist,
+	  CFG_CLAUSEFLAG_NOTCONFIGURED },
+	{ "dnstap-sample", &cfg_type_uint32, CFG_CLAUSEFLAG_NOTCONFIGURED },
+	{ "dnstap-sample-by-client", &cfg_type_boolean,
+	  CFG_CLAUSEFLAG_NOTCONFIGURED },
 #endif /* HAVE_DNSTAP */
 	{ "dual-stack-servers", &cfg_type_nameportiplist, 0 },
 	{ "edns-udp-size", &cfg_type_uint32, 0 },
@@ -2097,6 +2133,7 @@ static cfg_clausedef_t view_clauses[] = {
 	{ "max-cache-ttl", &cfg_type_duration, 0 },
 	{ "max-clients-per-query", &cfg_type_uint32, 0 },
 	{ "max-ncache-ttl", &cfg_type_duration, 0 },
+	{ "max-queries-per-forwarder", &cfg_type_uint32, 0 },
 	{ "max-recursion-depth", &cfg_type_uint32, 0 },
 	{ "max-recursion-queries", &cfg_type_uint32, 0 },
 	{ "max-stale-ttl", &cfg_type_duration, 0 },
@@ -2116,6 +2153,8 @@ static cfg_clausedef_t view_clauses[] = {
 	{ "nxdomain-redirect", &cfg_type_astring, 0 },
 	{ "preferred-glue", &cfg_type_astring, 0 },
 	{ "prefetch", &cfg_type_prefetch, 0 },
+	{ "prefetch-popular", &cfg_type_uint32, 0 },
+	{ "prefetch-popular-rate", &cfg_type_uint32, 0 },
 	{ "provide-ixfr", &cfg_type_boolean, 0 },
 	{ "qname-minimization", &cfg_type_qminmethod, 0 },
 	/*
@@ -2131,6 +2170,7 @@ static cfg_clausedef_t view_clauses[] = {
 	{ "request-nsid", &cfg_type_boolean, 0 },
 	{ "request-sit", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "require-server-cookie", &cfg_type_boolean, 0 },
+	{ "resolver-hedge-queries", &cfg_type_uint32, 0 },
 	{ "resolver-nonbackoff-tries", &cfg_type_uint32, 0 },
 	{ "resolver-query-timeout", &cfg_type_uint32, 0 },
 	{ "resolver-retry-interval", &cfg_type_uint32, 0 },
@@ -2142,12 +2182,14 @@ static cfg_clausedef_t view_clauses[] = {
 	{ "rrset-order", &cfg_type_rrsetorder, 0 },
 	{ "send-cookie", &cfg_type_boolean, 0 },
 	{ "servfail-ttl", &cfg_type_duration, 0 },
+	{ "share-fetches", &cfg_type_boolean, 0 },
 	{ "sortlist", &cfg_type_bracketed_aml, 0 },
 	{ "stale-answer-enable", &cfg_type_boolean, 0 },
 	{ "stale-answer-client-timeout", &cfg_type_staleanswerclienttimeout,
 	  0 },
 	{ "stale-answer-ttl", &cfg_type_duration, 0 },
 	{ "stale-cache-enable", &cfg_type_boolean, 0 },
+	{ "stale-refresh-rate", &cfg_type_uint32, 0 },
 	{ "stale-refresh-time", &cfg_type_duration, 0 },
 	{ "suppress-initial-notify", &cfg_type_boolean,
 	  CFG_CLAUSEFLAG_OBSOLETE },
@@ -2244,6 +2286,8 @@ static cfg_clausedef_t zone_clauses[] = {
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY | CFG_ZONE_MIRROR },
 	{ "alt-transfer-source-v6", &cfg_type_sockaddr6wild,
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY | CFG_ZONE_MIRROR },
+	{ "answer-cache", &cfg_type_boolean,
+	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY },
 	{ "auto-dnssec", &cfg_type_autodnssec,
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY },
 	{ "check-dup-records", &cfg_type_checkmode, CFG_ZONE_PRIMARY },
@@ -2271,6 +2315,7 @@ static cfg_clausedef_t zone_clauses[] = {
 	{ "forwarders", &cfg_type_portiplist,
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY | CFG_ZONE_STUB |
 		  CFG_ZONE_STATICSTUB | CFG_ZONE_FORWARD },
+	{ "journal-group-commit", &cfg_type_boolean, CFG_ZONE_PRIMARY },
 	{ "key-directory", &cfg_type_qstring,
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY },
 	{ "maintain-ixfr-base", NULL, CFG_CLAUSEFLAG_ANCIENT },
@@ -2320,19 +2365,24 @@ static cfg_clausedef_t zone_clauses[] = {
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY },
 	{ "nsec3-test-zone", &cfg_type_boolean,
 	  CFG_CLAUSEFLAG_TESTONLY | CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY },
+	{ "on-demand-idle-time", &cfg_type_duration, CFG_ZONE_SECONDARY },
 	{ "parental-source", &cfg_type_sockaddr4wild,
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY },
 	{ "parental-source-v6", &cfg_type_sockaddr6wild,
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY },
+	{ "reload-in-place", &cfg_type_boolean, CFG_ZONE_PRIMARY },
 	{ "request-expire", &cfg_type_boolean,
 	  CFG_ZONE_SECONDARY | CFG_ZONE_MIRROR },
 	{ "request-ixfr", &cfg_type_boolean,
 	  CFG_ZONE_SECONDARY | CFG_ZONE_MIRROR },
 	{ "serial-update-method", &cfg_type_updatemethod, CFG_ZONE_PRIMARY },
+	{ "share-zone-data", &cfg_type_boolean, CFG_ZONE_PRIMARY },
 	{ "sig-signing-nodes", &cfg_type_uint32,
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY },
 	{ "sig-signing-signatures", &cfg_type_uint32,
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY },
+	{ "sig-signing-threads", &cfg_type_uint32,
+	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY },
 	{ "sig-signing-type", &cfg_type_uint32,
 	  CFG_ZONE_PRIMARY | CFG_ZONE_SECONDARY },
 	{ "sig-validity-interval", &cfg_type_validityinterval,
@@ -2461,9 +2511,13 @@ cfg_type_t cfg_type_dnssecpolicyopts = {
 
 /*% The "dynamically loadable zones" statement syntax. */
 
-static cfg_clausedef_t dlz_clauses[] = { { "database", &cfg_type_astring, 0 },
-					 { "search", &cfg_type_boolean, 0 },
-					 { NULL, NULL, 0 } };
+static cfg_clausedef_t dlz_clauses[] = {
+	{ "database", &cfg_type_astring, 0 },
+	{ "max-lookup-ttl", &cfg_type_duration, 0 },
+	{ "max-negative-lookup-ttl", &cfg_type_duration, 0 },
+	{ "search", &cfg_type_boolean, 0 },
+	{ NULL, NULL, 0 }
+};
 static cfg_clausedef_t *dlz_clausesets[] = { dlz_clauses, NULL };
 static cfg_type_t cfg_type_dlz = { "dlz",	  cfg_parse_named_map,
 				   cfg_print_map, cfg_doc_map,
@@ -3946,6 +4000,7 @@ static cfg_clausedef_t tls_clauses[] = {
 	{ "ciphers", &cfg_type_astring, 0 },
 	{ "prefer-server-ciphers", &cfg_type_boolean, 0 },
 	{ "session-tickets", &cfg_type_boolean, 0 },
+	{ "ticket-key-file", &cfg_type_qstring, 0 },
 	{ NULL, NULL, 0 }
 };
 
@@ -3975,6 +4030,10 @@ static cfg_clausedef_t cfg_http_description_clauses[] = {
 	{ "endpoints", &cfg_type_bracketed_http_endpoint_list, 0 },
 	{ "listener-clients", &cfg_type_uint32, 0 },
 	{ "streams-per-connection", &cfg_type_uint32, 0 },
+	{ "response-cache-size", &cfg_type_uint32, 0 },
+	{ "initial-window-size", &cfg_type_uint32, 0 },
+	{ "max-frame-size", &cfg_type_uint32, 0 },
+	{ "header-table-size", &cfg_type_uint32, 0 },
 	{ NULL, NULL, 0 }
 };
 
@@ -119,6 +119,9 @@ create_string(cfg_parser_t *pctx, const char *contents, const cfg_type_t *type,
 static void
 free_string(cfg_parser_t *pctx, cfg_obj_t *obj);
 
+static char *
+intern_string(cfg_parser_t *pctx, const char *contents, size_t len);
+
 static isc_result_t
 create_map(cfg_parser_t *pctx, const cfg_type_t *type, cfg_obj_t **objp);
 
@@ -521,6 +524,10 @@ cfg_parser_create(isc_mem_t *mctx, isc_log_t *lctx, cfg_parser_t **ret) {
 	pctx->token.type = isc_tokentype_unknown;
 	pctx->flags = 0;
 	pctx->buf_name = NULL;
+	pctx->strings = NULL;
+
+	isc_hashmap_create(pctx->mctx, 8, ISC_HASHMAP_CASE_SENSITIVE,
+			   &pctx->strings);
 
 	memset(specials, 0, sizeof(specials));
 	specials['{'] = 1;
@@ -549,6 +556,7 @@ cleanup:
 	}
 	CLEANUP_OBJ(pctx->open_files);
 	CLEANUP_OBJ(pctx->closed_files);
+	isc_hashmap_destroy(&pctx->strings);
 	isc_mem_putanddetach(&pctx->mctx, pctx, sizeof(*pctx));
 	return (result);
 }
@@ -727,6 +735,12 @@ cfg_parser_destroy(cfg_parser_t **pctxp) {
 		 */
 		CLEANUP_OBJ(pctx->open_files);
 		CLEANUP_OBJ(pctx->closed_files);
+		/*
+		 * The configuration objects, and so the strings they
+		 * reference, don't outlive the parser that created them.
+		 */
+		INSIST(isc_hashmap_count(pctx->strings) == 0);
+		isc_hashmap_destroy(&pctx->strings);
 		isc_mem_putanddetach(&pctx->mctx, pctx, sizeof(*pctx));
 	}
 }
@@ -1258,30 +1272,104 @@ cfg_type_t cfg_type_duration_or_unlimited = { "duration_or_unlimited",
  * (any string), sstring (secret string)
  */
 
+/*
+ * String values are interned: the identical strings parsed with the
+ * same parser share a single reference-counted copy.  In the large
+ * configurations, most of the strings are repeated in every zone
+ * statement (the zone types, the ACL and primaries names, the key
+ * names, the directories).
+ */
+typedef struct cfg_strentry {
+	unsigned int references;
+	unsigned int length;
+	char	     base[];
+} cfg_strentry_t;
+
+#define STRENTRY(b) ((cfg_strentry_t *)((b) - offsetof(cfg_strentry_t, base)))
+
+static char *
+intern_string(cfg_parser_t *pctx, const char *contents, size_t len) {
+	cfg_strentry_t *entry = NULL;
+	isc_result_t result;
+
+	if (len > 0) {
+		result = isc_hashmap_find(pctx->strings,
+					  (const uint8_t *)contents, len,
+					  (void **)&entry);
+		if (result == ISC_R_SUCCESS) {
+			INSIST(entry->references > 0);
+			entry->references++;
+			return (entry->base);
+		}
+	}
+
+	entry = isc_mem_get(pctx->mctx, sizeof(*entry) + len + 1);
+	*entry = (cfg_strentry_t){ .references = 1, .length = len };
+	memmove(entry->base, contents, len);
+	entry->base[len] = '\0';
+
+	if (len > 0) {
+		result = isc_hashmap_add(pctx->strings,
+					 (const uint8_t *)entry->base, len,
+					 entry);
+		INSIST(result == ISC_R_SUCCESS);
+	}
+
+	return (entry->base);
+}
+
+static void
+release_string(cfg_parser_t *pctx, char *base) {
+	cfg_strentry_t *entry = STRENTRY(base);
+	void *found = NULL;
+
+	INSIST(entry->references > 0);
+	if (--entry->references > 0) {
+		return;
+	}
+
+	if (entry->length > 0) {
+		isc_result_t result = isc_hashmap_find(
+			pctx->strings, (const uint8_t *)entry->base,
+			entry->length, &found);
+		INSIST(result == ISC_R_SUCCESS && found == entry);
+		(void)isc_hashmap_delete(pctx->strings,
+					 (const uint8_t *)entry->base,
+					 entry->length);
+	}
+
+	isc_mem_put(pctx->mctx, entry, sizeof(*entry) + entry->length + 1);
+}
+
 /* Create a string object from a null-terminated C string. */
 static isc_result_t
 create_string(cfg_parser_t *pctx, const char *contents, const cfg_type_t *type,
 	      cfg_obj_t **ret) {
 	isc_result_t result;
 	cfg_obj_t *obj = NULL;
-	int len;
+	size_t len;
 
 	CHECK(cfg_create_obj(pctx, type, &obj));
 	len = strlen(contents);
 	obj->value.string.length = len;
-	obj->value.string.base = isc_mem_get(pctx->mctx, len + 1);
-	if (obj->value.string.base == 0) {
-		isc_mem_put(pctx->mctx, obj, sizeof(*obj));
-		return (ISC_R_NOMEMORY);
-	}
-	memmove(obj->value.string.base, contents, len);
-	obj->value.string.base[len] = '\0';
+	obj->value.string.base = intern_string(pctx, contents, len);
 
 	*ret = obj;
 cleanup:
 	return (result);
 }
 
+isc_result_t
+cfg_create_string(cfg_parser_t *pctx, const char *contents,
+		  const cfg_type_t *type, cfg_obj_t **objp) {
+	REQUIRE(pctx != NULL);
+	REQUIRE(contents != NULL);
+	REQUIRE(type != NULL && type->rep == &cfg_rep_string);
+	REQUIRE(objp != NULL && *objp == NULL);
+
+	return (create_string(pctx, contents, type, objp));
+}
+
 isc_result_t
 cfg_parse_qstring(cfg_parser_t *pctx, const cfg_type_t *type, cfg_obj_t **ret) {
 	isc_result_t result;
@@ -1538,8 +1626,13 @@ print_sstring(cfg_printer_t *pctx, const cfg_obj_t *obj) {
 
 static void
 free_string(cfg_parser_t *pctx, cfg_obj_t *obj) {
-	isc_mem_put(pctx->mctx, obj->value.string.base,
-		    obj->value.string.length + 1);
+	UNUSED(pctx);
+
+	/*
+	 * The string is interned by the parser that created the object,
+	 * which is not necessarily the one destroying it.
+	 */
+	release_string(obj->pctx, obj->value.string.base);
 }
 
 bool
@@ -2767,10 +2860,9 @@ parse_token(cfg_parser_t *pctx, const cfg_type_t *type, cfg_obj_t **ret) {
 
 	isc_lex_getlasttokentext(pctx->lexer, &pctx->token, &r);
 
-	obj->value.string.base = isc_mem_get(pctx->mctx, r.length + 1);
+	obj->value.string.base = intern_string(pctx, (const char *)r.base,
+						 r.length);
 	obj->value.string.length = r.length;
-	memmove(obj->value.string.base, r.base, r.length);
-	obj->value.string.base[r.length] = '\0';
 	*ret = obj;
 	return (result);
 
@@ -20,12 +20,14 @@
 #include <isc/atomic.h>
 #include <isc/formatcheck.h>
 #include <isc/fuzz.h>
+#include <isc/histo.h>
 #include <isc/hmac.h>
 #include <isc/log.h>
 #include <isc/mutex.h>
 #include <isc/nonce.h>
 #include <isc/once.h>
 #include <isc/print.h>
+#include <isc/probes.h>
 #include <isc/random.h>
 #include <isc/safe.h>
 #include <isc/serial.h>
@@ -40,6 +42,7 @@
 #include <isc/util.h>
 
 #include <dns/adb.h>
+#include <dns/anscache.h>
 #include <dns/badcache.h>
 #include <dns/cache.h>
 #include <dns/db.h>
@@ -335,39 +338,139 @@ client_senddone(isc_nmhandle_t *handle, isc_result_t result, void *cbarg) {
 	isc_nmhandle_detach(&handle);
 }
 
+/*
+ * Check that the order of the records in each rendered RRset does not
+ * change from one response to the next.
+ */
+static bool
+client_fixedorder(dns_message_t *message) {
+	dns_section_t section;
+	dns_name_t *name = NULL;
+	dns_rdataset_t *rdataset = NULL;
+
+	for (section = DNS_SECTION_ANSWER; section <= DNS_SECTION_ADDITIONAL;
+	     section++)
+	{
+		for (name = ISC_LIST_HEAD(message->sections[section]);
+		     name != NULL; name = ISC_LIST_NEXT(name, link))
+		{
+			for (rdataset = ISC_LIST_HEAD(name->list);
+			     rdataset != NULL;
+			     rdataset = ISC_LIST_NEXT(rdataset, link))
+			{
+				if ((rdataset->attributes &
+				     (DNS_RDATASETATTR_RANDOMIZE |
+				      DNS_RDATASETATTR_CYCLIC)) != 0 &&
+				    dns_rdataset_count(rdataset) > 1)
+				{
+					return (false);
+				}
+			}
+		}
+	}
+
+	return (true);
+}
+
+/*
+ * Store the response rendered into 'buffer' in the zone's answer cache,
+ * if it is complete and depends only on the zone version it was built
+ * from.  Called after the last section has been rendered, before the
+ * OPT and TSIG records are added.
+ */
+static void
+client_addanswer(ns_client_t *client, isc_buffer_t *buffer) {
+	dns_message_t *message = client->message;
+	ns_dbversion_t *dbversion = NULL;
+	isc_region_t key, wire;
+
+	if (client->query.anscache.entry != NULL ||
+	    client->query.anscache.keylen == 0 || client->ede != NULL ||
+	    (message->flags & DNS_MESSAGEFLAG_TC) != 0 ||
+	    (message->rcode != dns_rcode_noerror &&
+	     message->rcode != dns_rcode_nxdomain))
+	{
+		return;
+	}
+
+	/*
+	 * The answer must have been built from a single version of the
+	 * zone the query was started against.
+	 */
+	dbversion = ISC_LIST_HEAD(client->query.activeversions);
+	if (dbversion == NULL || ISC_LIST_NEXT(dbversion, link) != NULL ||
+	    dbversion->db != client->query.authdb)
+	{
+		return;
+	}
+
+	if (!client_fixedorder(message)) {
+		return;
+	}
+
+	key.base = client->query.anscache.key;
+	key.length = client->query.anscache.keylen;
+	isc_buffer_usedregion(buffer, &wire);
+	isc_region_consume(&wire, DNS_MESSAGE_HEADERLEN);
+
+	dns_anscache_add(client->query.anscache.cache, dbversion->db,
+			 dbversion->version, &key,
+			 message->flags &
+				 (DNS_MESSAGEFLAG_AA | DNS_MESSAGEFLAG_AD),
+			 message->rcode, client->query.isreferral,
+			 message->counts, &wire);
+}
+
+unsigned int
+ns_client_sendbufsize(ns_client_t *client) {
+	unsigned int bufsize;
+
+	REQUIRE(NS_CLIENT_VALID(client));
+
+	if (TCP_CLIENT(client)) {
+		return (NS_CLIENT_TCP_BUFFER_SIZE);
+	}
+
+	if ((client->attributes & NS_CLIENTATTR_HAVECOOKIE) == 0) {
+		if (client->view != NULL) {
+			bufsize = client->view->nocookieudp;
+		} else {
+			bufsize = 512;
+		}
+	} else {
+		bufsize = client->udpsize;
+	}
+	if (bufsize > client->udpsize) {
+		bufsize = client->udpsize;
+	}
+	if (bufsize > NS_CLIENT_SEND_BUFFER_SIZE) {
+		bufsize = NS_CLIENT_SEND_BUFFER_SIZE;
+	}
+
+	return (bufsize);
+}
+
 static void
 client_allocsendbuf(ns_client_t *client, isc_buffer_t *buffer,
 		    unsigned char **datap) {
 	unsigned char *data;
-	uint32_t bufsize;
 
 	REQUIRE(datap != NULL);
 
 	if (TCP_CLIENT(client)) {
-		INSIST(client->tcpbuf == NULL);
-		client->tcpbuf = isc_mem_get(client->manager->mctx,
-					     NS_CLIENT_TCP_BUFFER_SIZE);
+		/*
+		 * The TCP buffer is kept until the client is freed, so it
+		 * is only allocated for the first TCP response.
+		 */
+		if (client->tcpbuf == NULL) {
+			client->tcpbuf = isc_mem_get(client->manager->mctx,
+						     NS_CLIENT_TCP_BUFFER_SIZE);
+		}
 		data = client->tcpbuf;
-		isc_buffer_init(buffer, data, NS_CLIENT_TCP_BUFFER_SIZE);
 	} else {
 		data = client->sendbuf;
-		if ((client->attributes & NS_CLIENTATTR_HAVECOOKIE) == 0) {
-			if (client->view != NULL) {
-				bufsize = client->view->nocookieudp;
-			} else {
-				bufsize = 512;
-			}
-		} else {
-			bufsize = client->udpsize;
-		}
-		if (bufsize > client->udpsize) {
-			bufsize = client->udpsize;
-		}
-		if (bufsize > NS_CLIENT_SEND_BUFFER_SIZE) {
-			bufsize = NS_CLIENT_SEND_BUFFER_SIZE;
-		}
-		isc_buffer_init(buffer, data, bufsize);
 	}
+	isc_buffer_init(buffer, data, ns_client_sendbufsize(client));
 	*datap = data;
 }
 
@@ -388,6 +491,8 @@ client_sendpkg(ns_client_t *client, isc_buffer_t *buffer) {
 			isc_nm_set_maxage(client->handle, min_ttl);
 		}
 	}
+
+	ISC_PROBE2(libns, send, client, r.length);
 	isc_nm_send(client->handle, &r, client_senddone, client);
 }
 
@@ -448,13 +553,49 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *message) {
 
 	return;
 done:
-	if (client->tcpbuf != NULL) {
-		isc_mem_put(client->manager->mctx, client->tcpbuf,
-			    NS_CLIENT_TCP_BUFFER_SIZE);
-		client->tcpbuf = NULL;
+	ns_client_drop(client, result);
+}
+
+/*%
+ * Record the time taken to answer a query in the latency histogram of
+ * the view for the transport it was received over and the source of the
+ * answer.
+ */
+static void
+client_latency(ns_client_t *client) {
+	isc_time_t now;
+	int transport, source;
+
+	if (client->view == NULL || client->message->opcode != dns_opcode_query)
+	{
+		return;
 	}
 
-	ns_client_drop(client, result);
+	if (isc_nm_is_http_handle(client->handle)) {
+		transport = dns_latency_https;
+	} else if (!TCP_CLIENT(client)) {
+		transport = dns_latency_udp;
+	} else if (isc_nm_has_encryption(client->handle)) {
+		transport = dns_latency_tls;
+	} else {
+		transport = dns_latency_tcp;
+	}
+
+	if ((client->attributes & NS_CLIENTATTR_RECURSED) != 0) {
+		source = dns_latency_recursion;
+	} else if (client->query.authdb != NULL) {
+		source = dns_latency_auth;
+	} else {
+		source = dns_latency_cache;
+	}
+
+	if (client->view->latencystats[transport][source] == NULL) {
+		return;
+	}
+
+	TIME_NOW_HIRES(&now);
+	isc_histo_inc(client->view->latencystats[transport][source],
+		      isc_time_microdiff(&now, &client->starttime));
 }
 
 void
@@ -571,6 +712,19 @@ ns_client_send(ns_client_t *client) {
 			goto cleanup;
 		}
 	}
+	if (client->query.anscache.entry != NULL) {
+		dns_anscacheentry_t *entry = client->query.anscache.entry;
+
+		result = dns_message_renderwire(client->message, &entry->wire,
+						entry->counts);
+		if (result == ISC_R_SUCCESS) {
+			goto renderend;
+		}
+		if (result != ISC_R_NOSPACE) {
+			goto cleanup;
+		}
+		client->message->flags |= DNS_MESSAGEFLAG_TC;
+	}
 	result = dns_message_rendersection(client->message,
 					   DNS_SECTION_QUESTION, 0);
 	if (result == ISC_R_NOSPACE) {
@@ -612,6 +766,9 @@ ns_client_send(ns_client_t *client) {
 	if (result != ISC_R_SUCCESS && result != ISC_R_NOSPACE) {
 		goto cleanup;
 	}
+	if (result == ISC_R_SUCCESS && client->query.anscache.cache != NULL) {
+		client_addanswer(client, &buffer);
+	}
 renderend:
 	result = dns_message_renderend(client->message);
 	if (result != ISC_R_SUCCESS) {
@@ -648,6 +805,12 @@ renderend:
 		dns_compress_invalidate(&cctx);
 	}
 
+	/*
+	 * Before client_sendpkg(), which may leave client->view set to
+	 * NULL.
+	 */
+	client_latency(client);
+
 	if (client->sendcb != NULL) {
 		client->sendcb(&buffer);
 	} else if (TCP_CLIENT(client)) {
@@ -735,12 +898,6 @@ renderend:
 	return;
 
 cleanup:
-	if (client->tcpbuf != NULL) {
-		isc_mem_put(client->manager->mctx, client->tcpbuf,
-			    NS_CLIENT_TCP_BUFFER_SIZE);
-		client->tcpbuf = NULL;
-	}
-
 	if (cleanup_cctx) {
 		dns_compress_invalidate(&cctx);
 	}
@@ -1196,7 +1353,7 @@ compute_cookie(ns_client_t *client, uint32_t when, uint32_t nonce,
 			UNREACHABLE();
 		}
 
-		isc_siphash24(secret, input, inputlen, digest);
+		isc_siphash24(secret, input, inputlen, true, digest);
 		isc_buffer_putmem(buf, digest, 8);
 		break;
 	}
@@ -1630,10 +1787,6 @@ ns__client_reset_cb(void *client0) {
 	}
 
 	ns_client_endrequest(client);
-	if (client->tcpbuf != NULL) {
-		isc_mem_put(client->manager->mctx, client->tcpbuf,
-			    NS_CLIENT_TCP_BUFFER_SIZE);
-	}
 
 	if (client->keytag != NULL) {
 		isc_mem_put(client->manager->mctx, client->keytag,
@@ -1648,14 +1801,9 @@ ns__client_reset_cb(void *client0) {
 #endif /* WANT_SINGLETRACE */
 }
 
-void
-ns__client_put_cb(void *client0) {
-	ns_client_t *client = client0;
-	ns_clientmgr_t *manager = NULL;
-
-	REQUIRE(NS_CLIENT_VALID(client));
-
-	manager = client->manager;
+static void
+client_free(ns_client_t *client) {
+	ns_clientmgr_t *manager = client->manager;
 
 	ns_client_log(client, DNS_LOGCATEGORY_SECURITY, NS_LOGMODULE_CLIENT,
 		      ISC_LOG_DEBUG(3), "freeing client");
@@ -1669,6 +1817,10 @@ ns__client_put_cb(void *client0) {
 	client->magic = 0;
 
 	isc_mem_put(manager->mctx, client->sendbuf, NS_CLIENT_SEND_BUFFER_SIZE);
+	if (client->tcpbuf != NULL) {
+		isc_mem_put(manager->mctx, client->tcpbuf,
+			    NS_CLIENT_TCP_BUFFER_SIZE);
+	}
 	if (client->opt != NULL) {
 		INSIST(dns_rdataset_isassociated(client->opt));
 		dns_rdataset_disassociate(client->opt);
@@ -1683,11 +1835,184 @@ ns__client_put_cb(void *client0) {
 	 */
 	isc_mutex_destroy(&client->query.fetchlock);
 
+	ns_stats_decrement(manager->sctx->nsstats, ns_statscounter_clients);
+
 	isc_mem_put(manager->mctx, client, sizeof(*client));
+}
+
+void
+ns__client_put_cb(void *client0) {
+	ns_client_t *client = client0;
+	ns_clientmgr_t *manager = NULL;
+
+	REQUIRE(NS_CLIENT_VALID(client));
+
+	manager = client->manager;
+
+	/*
+	 * Keep the client, with its message, buffers and query state,
+	 * on the free list of its manager.  Pooled clients don't hold
+	 * a manager reference; whatever is left on the list when the
+	 * manager goes away is freed by clientmgr_destroy_cb().
+	 */
+	if (manager->tid == isc_tid() &&
+	    manager->nfreeclients < NS_CLIENT_POOL_SIZE)
+	{
+		ns_client_log(client, DNS_LOGCATEGORY_SECURITY,
+			      NS_LOGMODULE_CLIENT, ISC_LOG_DEBUG(3),
+			      "recycling client");
+
+		ISC_LIST_APPEND(manager->freeclients, client, flink);
+		manager->nfreeclients++;
+		ns_stats_increment(manager->sctx->nsstats,
+				   ns_statscounter_freeclients);
+
+		clientmgr_detach(&manager);
+		return;
+	}
+
+	client_free(client);
 
 	clientmgr_detach(&manager);
 }
 
+/*
+ * Get a client from the free list of 'mgr', or allocate a new one.
+ */
+static isc_result_t
+clientmgr_getclient(ns_clientmgr_t *mgr, ns_client_t **clientp) {
+	isc_result_t result;
+	ns_client_t *client = ISC_LIST_HEAD(mgr->freeclients);
+
+	if (client != NULL) {
+		ISC_LIST_UNLINK(mgr->freeclients, client, flink);
+		mgr->nfreeclients--;
+		ns_stats_decrement(mgr->sctx->nsstats,
+				   ns_statscounter_freeclients);
+
+		client->manager = NULL;
+		clientmgr_attach(mgr, &client->manager);
+
+		result = ns__client_setup(client, NULL, false);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+
+		ns_client_log(client, DNS_LOGCATEGORY_SECURITY,
+			      NS_LOGMODULE_CLIENT, ISC_LOG_DEBUG(3),
+			      "reuse pooled client");
+	} else {
+		client = isc_mem_get(mgr->mctx, sizeof(*client));
+
+		result = ns__client_setup(client, mgr, true);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+
+		ns_client_log(client, DNS_LOGCATEGORY_SECURITY,
+			      NS_LOGMODULE_CLIENT, ISC_LOG_DEBUG(3),
+			      "allocate new client");
+	}
+
+	*clientp = client;
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Drop the requests that would be dropped anyway before a client is
+ * set up for them: only the peer address and the fixed header of the
+ * message are looked at, in place.  Returns true if the request was
+ * dropped.
+ */
+static bool
+client_earlydrop(ns_clientmgr_t *mgr, isc_nmhandle_t *handle,
+		 isc_region_t *region) {
+	isc_sockaddr_t peeraddr = isc_nmhandle_peeraddr(handle);
+	isc_netaddr_t netaddr;
+	isc_buffer_t buffer;
+	dns_messageid_t id;
+	unsigned int flags;
+	const char *reason = NULL;
+	int match;
+
+	isc_netaddr_fromsockaddr(&netaddr, &peeraddr);
+
+#if NS_CLIENT_DROPPORT
+	if (ns_client_dropport(isc_sockaddr_getport(&peeraddr)) ==
+	    DROPPORT_REQUEST)
+	{
+		reason = "suspicious port";
+		goto drop;
+	}
+#endif /* if NS_CLIENT_DROPPORT */
+
+	if (mgr->sctx->blackholeacl != NULL &&
+	    (dns_acl_match(&netaddr, NULL, mgr->sctx->blackholeacl,
+			   mgr->aclenv, &match, NULL) == ISC_R_SUCCESS) &&
+	    match > 0)
+	{
+		reason = "blackholed peer";
+		goto drop;
+	}
+
+	if (isc_nmhandle_isproxied(handle)) {
+		isc_sockaddr_t proxyaddr = isc_nmhandle_proxyaddr(handle);
+		isc_netaddr_t proxynetaddr;
+
+		isc_netaddr_fromsockaddr(&proxynetaddr, &proxyaddr);
+		if (mgr->sctx->proxyacl == NULL ||
+		    dns_acl_match(&proxynetaddr, NULL, mgr->sctx->proxyacl,
+				  mgr->aclenv, &match,
+				  NULL) != ISC_R_SUCCESS ||
+		    match <= 0)
+		{
+			reason = "proxy not allowed";
+			goto drop;
+		}
+	}
+
+	isc_buffer_init(&buffer, region->base, region->length);
+	isc_buffer_add(&buffer, region->length);
+	if (dns_message_peekheader(&buffer, &id, &flags) != ISC_R_SUCCESS) {
+		/*
+		 * There isn't enough header to determine whether
+		 * this was a request or a response.
+		 */
+		reason = "invalid message header";
+		goto drop;
+	}
+
+#ifdef WANT_SINGLETRACE
+	if (id == 0) {
+		isc_log_setforcelog(true);
+	}
+#endif /* WANT_SINGLETRACE */
+
+	/*
+	 * The client object handles requests, not responses.
+	 */
+	if ((flags & DNS_MESSAGEFLAG_QR) != 0) {
+		reason = "unexpected response";
+		goto drop;
+	}
+
+	return (false);
+
+drop:
+	if (isc_log_wouldlog(ns_lctx, ISC_LOG_DEBUG(10))) {
+		char peerbuf[ISC_SOCKADDR_FORMATSIZE];
+
+		isc_sockaddr_format(&peeraddr, peerbuf, sizeof(peerbuf));
+		isc_log_write(ns_lctx, DNS_LOGCATEGORY_SECURITY,
+			      NS_LOGMODULE_CLIENT, ISC_LOG_DEBUG(10),
+			      "client %s: dropped request: %s", peerbuf,
+			      reason);
+	}
+	isc_nm_bad_request(handle);
+	return (true);
+}
+
 /*
  * Handle an incoming request event from the socket (UDP case)
  * or tcpmsg (TCP case).
@@ -1695,6 +2020,8 @@ ns__client_put_cb(void *client0) {
 void
 ns__client_request(isc_nmhandle_t *handle, isc_result_t eresult,
 		   isc_region_t *region, void *arg) {
+	ns_interface_t *ifp = (ns_interface_t *)arg;
+	ns_clientmgr_t *clientmgr = NULL;
 	ns_client_t *client = NULL;
 	isc_result_t result;
 	isc_result_t sigresult = ISC_R_SUCCESS;
@@ -1704,9 +2031,6 @@ ns__client_request(isc_nmhandle_t *handle, isc_result_t eresult,
 	const dns_name_t *signame = NULL;
 	bool ra; /* Recursion available. */
 	isc_netaddr_t netaddr;
-	int match;
-	dns_messageid_t id;
-	unsigned int flags;
 	bool notimp;
 	size_t reqsize;
 	dns_aclenv_t *env = NULL;
@@ -1718,25 +2042,23 @@ ns__client_request(isc_nmhandle_t *handle, isc_result_t eresult,
 		return;
 	}
 
-	client = isc_nmhandle_getdata(handle);
-	if (client == NULL) {
-		ns_interface_t *ifp = (ns_interface_t *)arg;
-		ns_clientmgr_t *clientmgr =
-			ns_interfacemgr_getclientmgr(ifp->mgr);
-
-		INSIST(VALID_MANAGER(clientmgr));
-		INSIST(clientmgr->tid == isc_tid());
+	clientmgr = ns_interfacemgr_getclientmgr(ifp->mgr);
+	INSIST(VALID_MANAGER(clientmgr));
+	INSIST(clientmgr->tid == isc_tid());
 
-		client = isc_mem_get(clientmgr->mctx, sizeof(*client));
+	/*
+	 * Drop what can be dropped before setting up a client.
+	 */
+	if (client_earlydrop(clientmgr, handle, region)) {
+		return;
+	}
 
-		result = ns__client_setup(client, clientmgr, true);
+	client = isc_nmhandle_getdata(handle);
+	if (client == NULL) {
+		result = clientmgr_getclient(clientmgr, &client);
 		if (result != ISC_R_SUCCESS) {
 			return;
 		}
-
-		ns_client_log(client, DNS_LOGCATEGORY_SECURITY,
-			      NS_LOGMODULE_CLIENT, ISC_LOG_DEBUG(3),
-			      "allocate new client");
 	} else {
 		result = ns__client_setup(client, NULL, false);
 		if (result != ISC_R_SUCCESS) {
@@ -1762,6 +2084,8 @@ ns__client_request(isc_nmhandle_t *handle, isc_result_t eresult,
 
 	INSIST(client->state == NS_CLIENTSTATE_READY);
 
+	ISC_PROBE2(libns, request, client, region->length);
+
 	(void)atomic_fetch_add_relaxed(&ns_client_requests, 1);
 
 	isc_buffer_init(&tbuffer, region->base, region->length);
@@ -1776,72 +2100,17 @@ ns__client_request(isc_nmhandle_t *handle, isc_result_t eresult,
 	client->state = NS_CLIENTSTATE_WORKING;
 
 	TIME_NOW(&client->requesttime);
+	TIME_NOW_HIRES(&client->starttime);
 	client->tnow = client->requesttime;
 	client->now = isc_time_seconds(&client->tnow);
 
 	isc_netaddr_fromsockaddr(&netaddr, &client->peeraddr);
-
-#if NS_CLIENT_DROPPORT
-	if (ns_client_dropport(isc_sockaddr_getport(&client->peeraddr)) ==
-	    DROPPORT_REQUEST)
-	{
-		ns_client_log(client, DNS_LOGCATEGORY_SECURITY,
-			      NS_LOGMODULE_CLIENT, ISC_LOG_DEBUG(10),
-			      "dropped request: suspicious port");
-		isc_nm_bad_request(handle);
-		return;
-	}
-#endif /* if NS_CLIENT_DROPPORT */
-
 	env = client->manager->aclenv;
-	if (client->manager->sctx->blackholeacl != NULL &&
-	    (dns_acl_match(&netaddr, NULL, client->manager->sctx->blackholeacl,
-			   env, &match, NULL) == ISC_R_SUCCESS) &&
-	    match > 0)
-	{
-		ns_client_log(client, DNS_LOGCATEGORY_SECURITY,
-			      NS_LOGMODULE_CLIENT, ISC_LOG_DEBUG(10),
-			      "dropped request: blackholed peer");
-		isc_nm_bad_request(handle);
-		return;
-	}
 
 	ns_client_log(client, NS_LOGCATEGORY_CLIENT, NS_LOGMODULE_CLIENT,
 		      ISC_LOG_DEBUG(3), "%s request",
 		      TCP_CLIENT(client) ? "TCP" : "UDP");
 
-	result = dns_message_peekheader(buffer, &id, &flags);
-	if (result != ISC_R_SUCCESS) {
-		/*
-		 * There isn't enough header to determine whether
-		 * this was a request or a response.  Drop it.
-		 */
-		ns_client_log(client, DNS_LOGCATEGORY_SECURITY,
-			      NS_LOGMODULE_CLIENT, ISC_LOG_DEBUG(10),
-			      "dropped request: invalid message header");
-		isc_nm_bad_request(handle);
-		return;
-	}
-
-#ifdef WANT_SINGLETRACE
-	if (id == 0) {
-		isc_log_setforcelog(true);
-	}
-#endif /* WANT_SINGLETRACE */
-
-	/*
-	 * The client object handles requests, not responses.
-	 * If this is a UDP response, forward it to the dispatcher.
-	 * If it's a TCP response, discard it here.
-	 */
-	if ((flags & DNS_MESSAGEFLAG_QR) != 0) {
-		ns_client_log(client, DNS_LOGCATEGORY_SECURITY,
-			      NS_LOGMODULE_CLIENT, ISC_LOG_DEBUG(10),
-			      "dropped request: unexpected response");
-		isc_nm_bad_request(handle);
-		return;
-	}
-
 	/*
 	 * Update some statistics counters.  Don't count responses.
 	 */
@@ -1883,9 +2152,13 @@ ns__client_request(isc_nmhandle_t *handle, isc_result_t eresult,
 	}
 
 	/*
-	 * It's a request.  Parse it.
+	 * It's a request.  Parse it.  The answer and authority sections
+	 * of a query are only looked at for IXFR, so leave them until
+	 * they are needed; the request buffer stays valid until the
+	 * query has been turned into a reply.
 	 */
-	result = dns_message_parse(client->message, buffer, 0);
+	result = dns_message_parse(client->message, buffer,
+				   DNS_MESSAGEPARSE_LAZY);
 	if (result != ISC_R_SUCCESS) {
 		/*
 		 * Parsing the request failed.  Send a response
@@ -2045,6 +2318,7 @@ ns__client_request(isc_nmhandle_t *handle, isc_result_t eresult,
 
 	ns_client_log(client, NS_LOGCATEGORY_CLIENT, NS_LOGMODULE_CLIENT,
 		      ISC_LOG_DEBUG(5), "using view '%s'", client->view->name);
+	ISC_PROBE2(libns, view, client, client->view->name);
 
 	/*
 	 * Check for a signature.  We log bad signatures regardless of
@@ -2305,6 +2579,9 @@ ns__client_setup(ns_client_t *client, ns_clientmgr_t *mgr, bool new) {
 		if (result != ISC_R_SUCCESS) {
 			goto cleanup;
 		}
+
+		ns_stats_increment(client->manager->sctx->nsstats,
+				   ns_statscounter_clients);
 	} else {
 		REQUIRE(NS_CLIENT_VALID(client));
 		REQUIRE(client->manager->tid == isc_tid());
@@ -2317,6 +2594,7 @@ ns__client_setup(ns_client_t *client, ns_clientmgr_t *mgr, bool new) {
 			.magic = 0,
 			.manager = client->manager,
 			.sendbuf = client->sendbuf,
+			.tcpbuf = client->tcpbuf,
 			.message = client->message,
 			.query = client->query,
 		};
@@ -2332,6 +2610,7 @@ ns__client_setup(ns_client_t *client, ns_clientmgr_t *mgr, bool new) {
 	client->formerrcache.time = 0;
 	client->formerrcache.id = 0;
 	ISC_LINK_INIT(client, rlink);
+	ISC_LINK_INIT(client, flink);
 	client->rcode_override = -1; /* not set */
 
 	client->magic = NS_CLIENT_MAGIC;
@@ -2379,9 +2658,20 @@ clientmgr_attach(ns_clientmgr_t *source, ns_clientmgr_t **targetp) {
 static void
 clientmgr_destroy_cb(void *arg) {
 	ns_clientmgr_t *manager = (ns_clientmgr_t *)arg;
+	ns_client_t *client = NULL;
 	MTRACE("clientmgr_destroy");
 
 	isc_refcount_destroy(&manager->references);
+
+	while ((client = ISC_LIST_HEAD(manager->freeclients)) != NULL) {
+		ISC_LIST_UNLINK(manager->freeclients, client, flink);
+		manager->nfreeclients--;
+		ns_stats_decrement(manager->sctx->nsstats,
+				   ns_statscounter_freeclients);
+		client_free(client);
+	}
+	INSIST(manager->nfreeclients == 0);
+
 	manager->magic = 0;
 
 	dns_aclenv_detach(&manager->aclenv);
@@ -2444,6 +2734,7 @@ ns_clientmgr_create(ns_server_t *sctx, isc_taskmgr_t *taskmgr,
 	ns_server_attach(sctx, &manager->sctx);
 
 	ISC_LIST_INIT(manager->recursing);
+	ISC_LIST_INIT(manager->freeclients);
 
 	manager->magic = MANAGER_MAGIC;
 
@@ -17,6 +17,7 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <isc/atomic.h>
 #include <isc/errno.h>
 #include <isc/list.h>
 #include <isc/log.h>
@@ -56,6 +57,12 @@ struct ns_plugin {
 static ns_hooklist_t default_hooktable[NS_HOOKPOINTS_COUNT];
 ns_hooktable_t *ns__hook_table = &default_hooktable;
 
+/*
+ * Bit N is set when 'hookslots[N]' of client queries is reserved.
+ */
+static atomic_uint_fast32_t hookslots = 0;
+STATIC_ASSERT(NS_HOOK_MAXSLOTS <= 32, "too many hook slots");
+
 isc_result_t
 ns_plugin_expandpath(const char *src, char *dst, size_t dstsize) {
 	int result;
@@ -329,6 +336,40 @@ ns_hook_add(ns_hooktable_t *hooktable, isc_mem_t *mctx,
 	ISC_LIST_APPEND((*hooktable)[hookpoint], copy, link);
 }
 
+isc_result_t
+ns_hook_allocslot(unsigned int *slotp) {
+	uint_fast32_t used = atomic_load_acquire(&hookslots);
+
+	REQUIRE(slotp != NULL);
+
+	for (;;) {
+		unsigned int slot;
+
+		for (slot = 0; slot < NS_HOOK_MAXSLOTS; slot++) {
+			if ((used & (1U << slot)) == 0) {
+				break;
+			}
+		}
+		if (slot == NS_HOOK_MAXSLOTS) {
+			return (ISC_R_NOSPACE);
+		}
+		if (atomic_compare_exchange_weak_acq_rel(
+			    &hookslots, &used, used | (1U << slot)))
+		{
+			*slotp = slot;
+			return (ISC_R_SUCCESS);
+		}
+	}
+}
+
+void
+ns_hook_freeslot(unsigned int slot) {
+	REQUIRE(slot < NS_HOOK_MAXSLOTS);
+
+	INSIST((atomic_fetch_and_release(&hookslots, ~(1U << slot)) &
+		(1U << slot)) != 0);
+}
+
 void
 ns_plugins_create(isc_mem_t *mctx, ns_plugins_t **listp) {
 	ns_plugins_t *plugins = NULL;
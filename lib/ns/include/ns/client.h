@@ -82,6 +82,7 @@
 
 #define NS_CLIENT_TCP_BUFFER_SIZE  65535
 #define NS_CLIENT_SEND_BUFFER_SIZE 4096
+#define NS_CLIENT_POOL_SIZE	   64
 
 /*!
  * Client object states.  Ordering is significant: higher-numbered
@@ -158,6 +159,10 @@ struct ns_clientmgr {
 	/* Lock covers the recursing list */
 	isc_mutex_t   reclock;
 	client_list_t recursing; /*%< Recursing clients */
+
+	/* Only used from 'tid', so it needs no lock */
+	client_list_t freeclients; /*%< Idle clients kept for reuse */
+	unsigned int  nfreeclients;
 };
 
 /*% nameserver client structure */
@@ -187,6 +192,7 @@ struct ns_client {
 	void (*cleanup)(ns_client_t *);
 	ns_query_t    query;
 	isc_time_t    requesttime;
+	isc_time_t    starttime; /*%< high resolution requesttime */
 	isc_stdtime_t now;
 	isc_time_t    tnow;
 	dns_name_t    signername; /*%< [T]SIG key name */
@@ -215,6 +221,7 @@ struct ns_client {
 	void (*sendcb)(isc_buffer_t *buf);
 
 	ISC_LINK(ns_client_t) rlink;
+	ISC_LINK(ns_client_t) flink;
 	unsigned char  cookie[8];
 	uint32_t       expire;
 	unsigned char *keytag;
@@ -250,7 +257,8 @@ struct ns_client {
 #define NS_CLIENTATTR_WANTPAD	   0x08000 /*%< pad reply */
 #define NS_CLIENTATTR_USEKEEPALIVE 0x10000 /*%< use TCP keepalive */
 
-#define NS_CLIENTATTR_NOSETFC 0x20000 /*%< don't set servfail cache */
+#define NS_CLIENTATTR_NOSETFC   0x20000 /*%< don't set servfail cache */
+#define NS_CLIENTATTR_RECURSED 0x40000 /*%< recursion was needed */
 
 /*
  * Flag to use with the SERVFAIL cache to indicate
@@ -286,6 +294,13 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *msg);
  * send msg as a response using client->message->id for the id.
  */
 
+unsigned int
+ns_client_sendbufsize(ns_client_t *client);
+/*%<
+ * Return the size of the buffer a response to 'client' will be
+ * rendered into.
+ */
+
 void
 ns_client_error(ns_client_t *client, isc_result_t result);
 /*%<
@@ -548,6 +563,9 @@ ns__client_reset_cb(void *client0);
 void
 ns__client_put_cb(void *client0);
 /*%<
- * Free all resources allocated to this client object, so that
- * it can be freed.
+ * Release a client object that is no longer attached to a handle.
+ * Up to #NS_CLIENT_POOL_SIZE clients are kept on the manager's free
+ * list, with their message, send buffers and query state intact, for
+ * reuse by ns__client_request(); others have all their resources
+ * freed.
  */
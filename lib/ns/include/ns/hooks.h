@@ -348,7 +348,9 @@
 /*!
  * Currently-defined hook points. So long as these are unique, the order in
  * which they are declared is unimportant, but it currently matches the
- * order in which they are referenced in query.c.
+ * order in which they are referenced in query.c.  The numeric values
+ * are passed to the "libns:hook" USDT probe, and are referred to by
+ * the scripts in contrib/tracing.
  */
 typedef enum {
 	/* hookpoints from query.c */
@@ -599,6 +601,31 @@ ns_hook_add(ns_hooktable_t *hooktable, isc_mem_t *mctx,
  *\li 'hook' is not NULL
  */
 
+isc_result_t
+ns_hook_allocslot(unsigned int *slotp);
+/*%<
+ * Reserve an index into the 'hookslots' array of client queries, for a
+ * module instance to keep its per-client state in:
+ * 'client->query.hookslots[*slotp]' is NULL until the instance sets it,
+ * and the instance must set it back to NULL when it frees that state.
+ * This is cheaper than looking the state up in a table of the instance.
+ *
+ * Requires:
+ *\li 'slotp' is not NULL
+ *
+ * Returns:
+ *\li #ISC_R_SUCCESS
+ *\li #ISC_R_NOSPACE	all NS_HOOK_MAXSLOTS slots are in use; the
+ *			instance must keep its state elsewhere.
+ */
+
+void
+ns_hook_freeslot(unsigned int slot);
+/*%<
+ * Release a slot reserved with ns_hook_allocslot(), once the module
+ * instance is no longer called from any hook.
+ */
+
 void
 ns_hooktable_init(ns_hooktable_t *hooktable);
 /*%<
@@ -40,18 +40,30 @@
 typedef struct ns_listenelt  ns_listenelt_t;
 typedef struct ns_listenlist ns_listenlist_t;
 
+/*%
+ * HTTP/2 settings announced to DoH clients; 0 means the default.
+ */
+typedef struct ns_listen_http2_settings {
+	uint32_t initial_window_size;
+	uint32_t max_frame_size;
+	uint32_t header_table_size;
+} ns_listen_http2_settings_t;
+
 struct ns_listenelt {
-	isc_mem_t	   *mctx;
-	in_port_t	    port;
-	bool		    is_http;
-	isc_dscp_t	    dscp; /* -1 = not set, 0..63 */
-	dns_acl_t	   *acl;
-	isc_tlsctx_t	   *sslctx;
-	isc_tlsctx_cache_t *sslctx_cache;
-	char		  **http_endpoints;
-	size_t		    http_endpoints_number;
-	uint32_t	    http_max_clients;
-	uint32_t	    max_concurrent_streams;
+	isc_mem_t		  *mctx;
+	in_port_t		   port;
+	bool			   is_http;
+	bool			   proxy; /* expect the PROXYv2 header */
+	isc_dscp_t		   dscp; /* -1 = not set, 0..63 */
+	dns_acl_t		  *acl;
+	isc_tlsctx_t		  *sslctx;
+	isc_tlsctx_cache_t	  *sslctx_cache;
+	char			 **http_endpoints;
+	size_t			   http_endpoints_number;
+	uint32_t		   http_max_clients;
+	uint32_t		   max_concurrent_streams;
+	uint32_t		   http_cache_size;
+	ns_listen_http2_settings_t http2_settings;
 	ISC_LINK(ns_listenelt_t) link;
 };
 
@@ -73,6 +85,7 @@ typedef struct ns_listen_tls_params {
 	bool	    prefer_server_ciphers_set;
 	bool	    session_tickets;
 	bool	    session_tickets_set;
+	const char *ticket_key_file;
 } ns_listen_tls_params_t;
 
 /***
@@ -99,9 +112,14 @@ ns_listenelt_create_http(isc_mem_t *mctx, in_port_t http_port, isc_dscp_t dscp,
 			 const ns_listen_tls_params_t *tls_params,
 			 isc_tlsctx_cache_t *tlsctx_cache, char **endpoints,
 			 size_t nendpoints, const uint32_t max_clients,
-			 const uint32_t max_streams, ns_listenelt_t **target);
+			 const uint32_t max_streams, const uint32_t cache_size,
+			 const ns_listen_http2_settings_t *http2_settings,
+			 ns_listenelt_t **target);
 /*%<
- * Create a listen-on list element for HTTP(S).
+ * Create a listen-on list element for HTTP(S).  'cache_size' is the
+ * number of DoH GET responses cached per worker thread (0 disables
+ * the cache).  'http2_settings' may be NULL to use the HTTP/2
+ * defaults.
  */
 
 void
@@ -101,6 +101,21 @@ typedef struct ns_query_recparam {
 	dns_fixedname_t fqdomain;
 } ns_query_recparam_t;
 
+/*%
+ * Size of a rendered answer cache key: the view, query type and class,
+ * request flags, buffer size class, the query name and the ECS family,
+ * scope and address.
+ */
+#define NS_QUERY_ANSKEYSIZE (sizeof(void *) + 7 + DNS_NAME_MAXWIRE + 18)
+
+/*%
+ * Number of pointers a client keeps for the state of hook modules; see
+ * ns_hook_allocslot().
+ */
+#ifndef NS_HOOK_MAXSLOTS
+#define NS_HOOK_MAXSLOTS 8
+#endif
+
 /*% nameserver query structure */
 struct ns_query {
 	unsigned int	 attributes;
@@ -118,6 +133,7 @@ struct ns_query {
 	bool		 isreferral;
 	isc_mutex_t	 fetchlock;
 	ns_hookasync_t	*hookactx;
+	void		*hookslots[NS_HOOK_MAXSLOTS]; /* module state */
 	dns_rpz_st_t	*rpz_st;
 	isc_bufferlist_t namebufs;
 	ISC_LIST(ns_dbversion_t) activeversions;
@@ -154,6 +170,13 @@ struct ns_query {
 	dns_keytag_t root_key_sentinel_keyid;
 	bool	     root_key_sentinel_is_ta;
 	bool	     root_key_sentinel_not_ta;
+
+	struct {
+		dns_anscache_t	    *cache; /*%< Where to store the answer */
+		dns_anscacheentry_t *entry; /*%< Cached answer to send */
+		unsigned int	     keylen;
+		unsigned char	     key[NS_QUERY_ANSKEYSIZE];
+	} anscache;
 };
 
 #define NS_QUERYATTR_RECURSIONOK     0x000001
@@ -201,12 +224,15 @@ struct query_ctx {
 	bool resuming; /* resumed from recursion? */
 	bool dns64, dns64_exclude, rpz;
 	bool authoritative;		    /* authoritative query? */
+	bool authonly;			    /* no response rewriting
+					     * features apply */
 	bool want_restart;		    /* CNAME chain or other
 					     * restart needed */
 	bool		need_wildcardproof; /* wildcard proof needed */
 	bool		nxrewrite;	    /* negative answer from RPZ */
 	bool		findcoveringnsec;   /* lookup covering NSEC */
 	bool		answer_has_ns;	    /* NS is in answer */
+	bool		dlzprefetched;	    /* DLZ name fetched ahead */
 	dns_fixedname_t wildcardname;	    /* name needing wcard proof */
 	dns_fixedname_t dsname;		    /* name needing DS */
 
@@ -323,3 +349,16 @@ ns__query_start(query_ctx_t *qctx);
 /*%<
  * (Must not be used outside this module and its associated unit tests.)
  */
+
+void
+ns__query_anscachekey(isc_buffer_t *b, const dns_view_t *view,
+		      const dns_name_t *qname, dns_rdatatype_t qtype,
+		      dns_rdataclass_t qclass, uint8_t flags,
+		      uint16_t bufsize);
+/*%<
+ * Append the answer cache key of a query to 'b'.  The key includes
+ * 'view', as a zone, and so its answer cache, may be shared by
+ * several views.
+ *
+ * (Must not be used outside this module and its associated unit tests.)
+ */
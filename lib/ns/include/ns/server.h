@@ -19,6 +19,7 @@
 #include <stdbool.h>
 
 #include <isc/fuzz.h>
+#include <isc/ht.h>
 #include <isc/log.h>
 #include <isc/magic.h>
 #include <isc/quota.h>
@@ -46,6 +47,7 @@
 #define NS_SERVER_EDNSFORMERR  0x00001000U /*%< -T ednsformerr (STD13) */
 #define NS_SERVER_EDNSNOTIMP   0x00002000U /*%< -T ednsnotimp */
 #define NS_SERVER_EDNSREFUSED  0x00004000U /*%< -T ednsrefused */
+#define NS_SERVER_NOHTTPCACHE  0x00008000U /*%< answers depend on client */
 
 /*%
  * Type for callback function to get hostname.
@@ -91,11 +93,19 @@ struct ns_server {
 	uint32_t options;
 
 	dns_acl_t     *blackholeacl;
+	dns_acl_t     *proxyacl;
 	uint16_t       udpsize;
 	uint16_t       transfer_tcp_message_size;
 	bool	       interface_auto;
 	dns_tkeyctx_t *tkeyctx;
 
+	/*% Rendered AXFR streams */
+	ns_xfrcache_t *xfrcache;
+
+	/*% UPDATE requests waiting to be processed, by zone */
+	isc_mutex_t updatelock;
+	isc_ht_t   *updatequeues;
+
 	/*% Server id for NSID */
 	char	       *server_id;
 	ns_hostnamecb_t gethostname;
@@ -107,7 +107,13 @@ enum {
 
 	ns_statscounter_reclimitdropped = 66,
 
-	ns_statscounter_max = 67,
+	ns_statscounter_clients = 67,
+	ns_statscounter_freeclients = 68,
+
+	ns_statscounter_anscachehit = 69,
+	ns_statscounter_anscachemiss = 70,
+
+	ns_statscounter_max = 71,
 };
 
 void
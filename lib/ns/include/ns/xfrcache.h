@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*****
+***** Module Info
+*****/
+
+/*! \file ns/xfrcache.h
+ * \brief
+ * Defines ns_xfrcache_t, the cache of rendered outgoing AXFR and IXFR
+ * streams.
+ *
+ * Notes:
+ *\li	A stream holds the messages of an AXFR of one version of a
+ *	zone database, or of an IXFR to that version from one serial,
+ *	as they were rendered for the first such transfer: the wire
+ *	format of the answer section of every
+ *	message after the first, which carries the question and is
+ *	always rendered per transfer.  The header, OPT and TSIG are not
+ *	stored; they are added to each message by the transfer replaying
+ *	it, so the stream can be shared by any transfer of the version.
+ *
+ *\li	A stream is published while it is being produced, so transfers
+ *	may replay the messages already stored while the first one is
+ *	still in progress.
+ *
+ *\li	The wire format held by all the streams is limited by the size
+ *	set with ns_xfrcache_setmaxsize().  The oldest streams are
+ *	discarded to make room for new messages; a stream that does not
+ *	fit on its own is abandoned.  The streams of a zone are all for
+ *	the same version: starting one for another version discards the
+ *	others.
+ *
+ * MP:
+ *\li	All functions are thread-safe.  Streams are reference counted,
+ *	and stored messages are immutable until the last reference is
+ *	gone.
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/lang.h>
+#include <isc/region.h>
+
+#include <dns/types.h>
+
+#include <ns/types.h>
+
+/*% Message stored in a stream */
+typedef struct ns_xfrmsg {
+	isc_region_t wire; /*%< Answer section, after a 12 byte header */
+	unsigned int nrrs; /*%< Number of records in 'wire' */
+	bool	     last; /*%< Last message of the transfer */
+} ns_xfrmsg_t;
+
+ISC_LANG_BEGINDECLS
+
+/***
+ ***	Functions
+ ***/
+
+void
+ns_xfrcache_create(isc_mem_t *mctx, ns_xfrcache_t **cachep);
+/*%<
+ * Allocate an empty, disabled transfer cache and store it in '*cachep'.
+ *
+ * Requires:
+ * \li	'mctx' is a valid memory context.
+ * \li	'cachep' != NULL && '*cachep' == NULL.
+ */
+
+void
+ns_xfrcache_destroy(ns_xfrcache_t **cachep);
+/*%<
+ * Flush and free the transfer cache in '*cachep'.  '*cachep' is set to
+ * NULL on return.
+ */
+
+void
+ns_xfrcache_setmaxsize(ns_xfrcache_t *cache, size_t maxsize);
+/*%<
+ * Discard all the streams and limit the messages stored from now on
+ * to 'maxsize' bytes.  A 'maxsize' of zero disables the cache.
+ *
+ * Requires:
+ * \li	'cache' is a valid transfer cache.
+ */
+
+isc_result_t
+ns_xfrcache_find(ns_xfrcache_t *cache, dns_zone_t *zone, dns_db_t *db,
+		 dns_dbversion_t *version, dns_rdatatype_t type,
+		 uint32_t begin_serial, ns_xfrstream_t **streamp);
+/*%<
+ * Look up the stream of 'version' of the database 'db' of 'zone' for
+ * transfers of 'type': an AXFR, or an IXFR from 'begin_serial', which
+ * is ignored for AXFR.
+ *
+ * Requires:
+ * \li	'cache' is a valid transfer cache.
+ * \li	'zone', 'db' and 'version' are valid.
+ * \li	'type' is dns_rdatatype_axfr or dns_rdatatype_ixfr.
+ * \li	'streamp' != NULL && '*streamp' == NULL.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS	'*streamp' is attached to the stream, which
+ *			may still be in production.
+ * \li	#ISC_R_NOTFOUND	no such stream is cached.
+ */
+
+isc_result_t
+ns_xfrcache_start(ns_xfrcache_t *cache, dns_zone_t *zone, dns_db_t *db,
+		  dns_dbversion_t *version, dns_rdatatype_t type,
+		  uint32_t begin_serial, unsigned int firstrrs,
+		  ns_xfrstream_t **streamp);
+/*%<
+ * Publish a new, empty stream for 'version' of the database 'db' of
+ * 'zone' and transfers of 'type' (see ns_xfrcache_find()), whose first
+ * message holds 'firstrrs' records.  The streams of 'zone' for other
+ * versions are discarded.
+ *
+ * Requires:
+ * \li	'cache' is a valid transfer cache.
+ * \li	'zone', 'db' and 'version' are valid.
+ * \li	'type' is dns_rdatatype_axfr or dns_rdatatype_ixfr.
+ * \li	'streamp' != NULL && '*streamp' == NULL.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS	'*streamp' is attached to the new stream; the
+ *			caller must add every message to it.
+ * \li	#ISC_R_DISABLED	the cache is disabled.
+ * \li	#ISC_R_EXISTS	another transfer is producing the stream.
+ */
+
+isc_result_t
+ns_xfrstream_add(ns_xfrstream_t *stream, const isc_region_t *wire,
+		 unsigned int nrrs, bool last);
+/*%<
+ * Store a copy of the answer section 'wire' of the next message of
+ * 'stream', holding 'nrrs' records.  'last' is true for the last
+ * message of the transfer, which completes the stream.
+ *
+ * Requires:
+ * \li	'stream' is a valid stream returned by ns_xfrcache_start().
+ * \li	'wire' is a valid region.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS	the message was stored.
+ * \li	#ISC_R_NOSPACE	the message did not fit in the cache, and the
+ *			stream has been abandoned.
+ * \li	#ISC_R_CANCELED	the stream had already been discarded.
+ */
+
+void
+ns_xfrstream_abandon(ns_xfrstream_t *stream);
+/*%<
+ * Discard an unfinished 'stream' when the transfer producing it has
+ * failed.  Transfers replaying it stop at the messages already stored.
+ *
+ * Requires:
+ * \li	'stream' is a valid stream returned by ns_xfrcache_start().
+ */
+
+unsigned int
+ns_xfrstream_firstrrs(ns_xfrstream_t *stream);
+/*%<
+ * Return the number of records in the first message of the transfer
+ * that produced 'stream'.
+ *
+ * Requires:
+ * \li	'stream' is a valid stream.
+ */
+
+isc_result_t
+ns_xfrstream_get(ns_xfrstream_t *stream, unsigned int index,
+		 const ns_xfrmsg_t **msgp);
+/*%<
+ * Point '*msgp' at message 'index' of 'stream', counting from the
+ * second message of the transfer.  The message stays valid until
+ * 'stream' is detached.
+ *
+ * Requires:
+ * \li	'stream' is a valid stream.
+ * \li	'msgp' != NULL && '*msgp' == NULL.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS	the message is stored.
+ * \li	#ISC_R_NOTFOUND	the message has not been produced (yet).
+ */
+
+void
+ns_xfrstream_detach(ns_xfrstream_t **streamp);
+/*%<
+ * Detach from a stream returned by ns_xfrcache_find() or
+ * ns_xfrcache_start().
+ */
+
+ISC_LANG_ENDDECLS
@@ -15,6 +15,7 @@
 
 #include <stdbool.h>
 
+#include <isc/ht.h>
 #include <isc/interfaceiter.h>
 #include <isc/loop.h>
 #include <isc/netmgr.h>
@@ -45,6 +46,7 @@
 
 #if defined(HAVE_LINUX_NETLINK_H) && defined(HAVE_LINUX_RTNETLINK_H)
 #define LINUX_NETLINK_AVAILABLE
+#include <net/if.h>
 #include <linux/netlink.h>
 #include <linux/rtnetlink.h>
 #if defined(RTM_NEWADDR) && defined(RTM_DELADDR)
@@ -56,6 +58,8 @@
 
 #define LISTENING(ifp) (((ifp)->flags & NS_INTERFACEFLAG_LISTENING) != 0)
 
+typedef ISC_LIST(ns_interface_t) interfacelist_t;
+
 #ifdef TUNE_LARGE
 #define UDPBUFFERS 32768
 #else /* ifdef TUNE_LARGE */
@@ -85,6 +89,7 @@ struct ns_interfacemgr {
 	ns_listenlist_t *listenon4;
 	ns_listenlist_t *listenon6;
 	dns_aclenv_t *aclenv;		     /*%< Localhost/localnets ACLs */
+	isc_ht_t *locals;		     /*%< Addresses in the above */
 	ISC_LIST(ns_interface_t) interfaces; /*%< List of interfaces */
 	ISC_LIST(isc_sockaddr_t) listenon;
 	int backlog;		     /*%< Listen queue size */
@@ -99,109 +104,19 @@ purge_old_interfaces(ns_interfacemgr_t *mgr);
 static void
 clearlistenon(ns_interfacemgr_t *mgr);
 
-static bool
-need_rescan(ns_interfacemgr_t *mgr, struct MSGHDR *rtm, size_t len) {
-	if (rtm->MSGTYPE != RTM_NEWADDR && rtm->MSGTYPE != RTM_DELADDR) {
-		return (false);
-	}
+static void
+clearlocals(ns_interfacemgr_t *mgr);
 
-#ifndef LINUX_NETLINK_AVAILABLE
-	UNUSED(mgr);
-	UNUSED(len);
-	/* On most systems, any NEWADDR or DELADDR means we rescan */
-	return (true);
+#ifdef LINUX_NETLINK_AVAILABLE
+static void
+route_update(ns_interfacemgr_t *mgr, struct MSGHDR *rtm, size_t len);
 #else  /* LINUX_NETLINK_AVAILABLE */
-	/* ...but on linux we need to check the messages more carefully */
-	for (struct MSGHDR *nlh = rtm;
-	     NLMSG_OK(nlh, len) && nlh->nlmsg_type != NLMSG_DONE;
-	     nlh = NLMSG_NEXT(nlh, len))
-	{
-		struct ifaddrmsg *ifa = (struct ifaddrmsg *)NLMSG_DATA(nlh);
-		struct rtattr *rth = IFA_RTA(ifa);
-		size_t rtl = IFA_PAYLOAD(nlh);
-
-		while (rtl > 0 && RTA_OK(rth, rtl)) {
-			/*
-			 * Look for IFA_ADDRESS to detect IPv6 interface
-			 * state changes.
-			 */
-			if (rth->rta_type == IFA_ADDRESS &&
-			    ifa->ifa_family == AF_INET6) {
-				bool existed = false;
-				bool was_listening = false;
-				isc_netaddr_t addr = { 0 };
-				ns_interface_t *ifp = NULL;
-
-				isc_netaddr_fromin6(&addr, RTA_DATA(rth));
-				INSIST(isc_netaddr_getzone(&addr) == 0);
-
-				/*
-				 * Check whether we were listening on the
-				 * address. We need to do this as the
-				 * Linux kernel seems to issue messages
-				 * containing IFA_ADDRESS far more often
-				 * than the actual state changes (on
-				 * router advertisements?)
-				 */
-				LOCK(&mgr->lock);
-				for (ifp = ISC_LIST_HEAD(mgr->interfaces);
-				     ifp != NULL;
-				     ifp = ISC_LIST_NEXT(ifp, link))
-				{
-					isc_netaddr_t tmp = { 0 };
-					isc_netaddr_fromsockaddr(&tmp,
-								 &ifp->addr);
-					if (tmp.family != AF_INET6) {
-						continue;
-					}
-
-					/*
-					 * We have to nullify the zone (IPv6
-					 * scope ID) because we haven't got one
-					 * from the kernel. Otherwise match
-					 * could fail even for an existing
-					 * address.
-					 */
-					isc_netaddr_setzone(&tmp, 0);
-					if (isc_netaddr_equal(&tmp, &addr)) {
-						was_listening = LISTENING(ifp);
-						existed = true;
-						break;
-					}
-				}
-				UNLOCK(&mgr->lock);
-
-				/*
-				 * Do rescan if the state of the interface
-				 * has changed.
-				 */
-				if ((!existed && rtm->MSGTYPE == RTM_NEWADDR) ||
-				    (existed && was_listening &&
-				     rtm->MSGTYPE == RTM_DELADDR))
-				{
-					return (true);
-				}
-			} else if (rth->rta_type == IFA_ADDRESS &&
-				   ifa->ifa_family == AF_INET) {
-				/*
-				 * It seems that the IPv4 P2P link state
-				 * has changed.
-				 */
-				return (true);
-			} else if (rth->rta_type == IFA_LOCAL) {
-				/*
-				 * Local address state has changed - do
-				 * rescan.
-				 */
-				return (true);
-			}
-			rth = RTA_NEXT(rth, rtl);
-		}
-	}
-#endif /* LINUX_NETLINK_AVAILABLE */
-
-	return (false);
+static bool
+need_rescan(struct MSGHDR *rtm) {
+	/* On most systems, any NEWADDR or DELADDR means we rescan */
+	return (rtm->MSGTYPE == RTM_NEWADDR || rtm->MSGTYPE == RTM_DELADDR);
 }
+#endif /* LINUX_NETLINK_AVAILABLE */
 
 static void
 route_recv(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
@@ -248,8 +163,15 @@ route_recv(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
 
 	REQUIRE(mgr->route != NULL);
 
-	if (need_rescan(mgr, rtm, rtmlen) && mgr->sctx->interface_auto) {
-		ns_interfacemgr_scan(mgr, false, false);
+	if (mgr->sctx->interface_auto) {
+#ifdef LINUX_NETLINK_AVAILABLE
+		route_update(mgr, rtm, rtmlen);
+#else  /* LINUX_NETLINK_AVAILABLE */
+		UNUSED(rtmlen);
+		if (need_rescan(rtm)) {
+			ns_interfacemgr_scan(mgr, false, false);
+		}
+#endif /* LINUX_NETLINK_AVAILABLE */
 	}
 
 	isc_nm_read(handle, route_recv, mgr);
@@ -333,6 +255,8 @@ ns_interfacemgr_create(isc_mem_t *mctx, ns_server_t *sctx,
 	UNUSED(geoip);
 #endif /* if defined(HAVE_GEOIP2) */
 
+	isc_ht_init(&mgr->locals, mctx, 4, ISC_HT_CASE_SENSITIVE);
+
 	isc_refcount_init(&mgr->references, 1);
 	mgr->magic = IFMGR_MAGIC;
 	*mgrp = mgr;
@@ -384,6 +308,8 @@ ns_interfacemgr_destroy(ns_interfacemgr_t *mgr) {
 	ns_listenlist_detach(&mgr->listenon4);
 	ns_listenlist_detach(&mgr->listenon6);
 	clearlistenon(mgr);
+	clearlocals(mgr);
+	isc_ht_destroy(&mgr->locals);
 	isc_mutex_destroy(&mgr->lock);
 	for (size_t i = 0; i < mgr->ncpus; i++) {
 		ns_clientmgr_destroy(&mgr->clientmgrs[i]);
@@ -586,12 +512,33 @@ load_http_endpoints(isc_nm_http_endpoints_t *epset, ns_interface_t *ifp,
 
 	return (result);
 }
+
+/*
+ * Cached DoH responses are sent back without passing the request to
+ * the server, so the cache is not used when the server says that the
+ * answers depend on the client.
+ */
+static uint32_t
+http_cache_size(ns_interface_t *ifp, uint32_t size) {
+	if (size != 0 &&
+	    ns_server_getoption(ifp->mgr->sctx, NS_SERVER_NOHTTPCACHE))
+	{
+		isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_WARNING,
+			      "not caching DoH responses on %s: the answers "
+			      "depend on the client",
+			      ifp->name);
+		return (0);
+	}
+
+	return (size);
+}
 #endif /* HAVE_LIBNGHTTP2 */
 
 static isc_result_t
 ns_interface_listenhttp(ns_interface_t *ifp, isc_tlsctx_t *sslctx, char **eps,
 			size_t neps, uint32_t max_clients,
-			uint32_t max_concurrent_streams) {
+			uint32_t max_concurrent_streams, uint32_t cache_size,
+			const ns_listen_http2_settings_t *http2_settings) {
 #if HAVE_LIBNGHTTP2
 	isc_result_t result = ISC_R_FAILURE;
 	isc_nmsocket_t *sock = NULL;
@@ -631,6 +578,11 @@ ns_interface_listenhttp(ns_interface_t *ifp, isc_tlsctx_t *sslctx, char **eps,
 		return (result);
 	}
 
+	isc_nm_http_set_response_cache(sock, http_cache_size(ifp, cache_size));
+	isc_nm_http_set_settings(sock, http2_settings->initial_window_size,
+				 http2_settings->max_frame_size,
+				 http2_settings->header_table_size);
+
 	if (sslctx) {
 		ifp->http_secure_listensocket = sock;
 	} else {
@@ -657,10 +609,32 @@ ns_interface_listenhttp(ns_interface_t *ifp, isc_tlsctx_t *sslctx, char **eps,
 	UNUSED(neps);
 	UNUSED(max_clients);
 	UNUSED(max_concurrent_streams);
+	UNUSED(cache_size);
+	UNUSED(http2_settings);
 	return (ISC_R_NOTIMPLEMENTED);
 #endif
 }
 
+/*%
+ * Expect (or stop expecting) the PROXYv2 header on all the listeners of
+ * the interface.
+ */
+static void
+set_listener_proxy(ns_interface_t *ifp, bool proxy) {
+	if (ifp->udplistensocket != NULL) {
+		isc_nmsocket_set_proxy(ifp->udplistensocket, proxy);
+	}
+	if (ifp->tcplistensocket != NULL) {
+		isc_nmsocket_set_proxy(ifp->tcplistensocket, proxy);
+	}
+	if (ifp->http_listensocket != NULL) {
+		isc_nmsocket_set_proxy(ifp->http_listensocket, proxy);
+	}
+	if (ifp->http_secure_listensocket != NULL) {
+		isc_nmsocket_set_proxy(ifp->http_secure_listensocket, proxy);
+	}
+}
+
 static isc_result_t
 interface_setup(ns_interfacemgr_t *mgr, isc_sockaddr_t *addr, const char *name,
 		ns_interface_t **ifpret, ns_listenelt_t *elt,
@@ -686,10 +660,12 @@ interface_setup(ns_interfacemgr_t *mgr, isc_sockaddr_t *addr, const char *name,
 		result = ns_interface_listenhttp(
 			ifp, elt->sslctx, elt->http_endpoints,
 			elt->http_endpoints_number, elt->http_max_clients,
-			elt->max_concurrent_streams);
+			elt->max_concurrent_streams, elt->http_cache_size,
+			&elt->http2_settings);
 		if (result != ISC_R_SUCCESS) {
 			goto cleanup_interface;
 		}
+		set_listener_proxy(ifp, elt->proxy);
 		*ifpret = ifp;
 		return (result);
 	}
@@ -699,6 +675,7 @@ interface_setup(ns_interfacemgr_t *mgr, isc_sockaddr_t *addr, const char *name,
 		if (result != ISC_R_SUCCESS) {
 			goto cleanup_interface;
 		}
+		set_listener_proxy(ifp, elt->proxy);
 		*ifpret = ifp;
 		return (result);
 	}
@@ -728,6 +705,7 @@ interface_setup(ns_interfacemgr_t *mgr, isc_sockaddr_t *addr, const char *name,
 			result = ISC_R_SUCCESS;
 		}
 	}
+	set_listener_proxy(ifp, elt->proxy);
 	*ifpret = ifp;
 	return (result);
 
@@ -803,13 +781,35 @@ find_matching_interface(ns_interfacemgr_t *mgr, isc_sockaddr_t *addr) {
 	return (ifp);
 }
 
+/*%
+ * Shut down and destroy 'interfaces', which have already been unlinked
+ * from the interface list.
+ */
+static void
+destroy_interfaces(interfacelist_t *interfaces) {
+	ns_interface_t *ifp = NULL, *next = NULL;
+
+	for (ifp = ISC_LIST_HEAD(*interfaces); ifp != NULL; ifp = next) {
+		next = ISC_LIST_NEXT(ifp, link);
+		if (LISTENING(ifp)) {
+			char sabuf[256];
+			isc_sockaddr_format(&ifp->addr, sabuf, sizeof(sabuf));
+			isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_INFO,
+				      "no longer listening on %s", sabuf);
+			ns_interface_shutdown(ifp);
+		}
+		ISC_LIST_UNLINK(*interfaces, ifp, link);
+		interface_destroy(&ifp);
+	}
+}
+
 /*%
  * Remove any interfaces whose generation number is not the current one.
  */
 static void
 purge_old_interfaces(ns_interfacemgr_t *mgr) {
 	ns_interface_t *ifp = NULL, *next = NULL;
-	ISC_LIST(ns_interface_t) interfaces;
+	interfacelist_t interfaces;
 
 	ISC_LIST_INIT(interfaces);
 
@@ -824,19 +824,46 @@ purge_old_interfaces(ns_interfacemgr_t *mgr) {
 	}
 	UNLOCK(&mgr->lock);
 
-	for (ifp = ISC_LIST_HEAD(interfaces); ifp != NULL; ifp = next) {
+	destroy_interfaces(&interfaces);
+}
+
+#ifdef LINUX_NETLINK_AVAILABLE
+/*%
+ * Remove the interfaces and the listen-on addresses for 'address', on
+ * any port, once it has been deleted from the system.
+ */
+static void
+purge_address(ns_interfacemgr_t *mgr, const isc_netaddr_t *address) {
+	ns_interface_t *ifp = NULL, *next = NULL;
+	isc_sockaddr_t *old = NULL, *nextold = NULL;
+	interfacelist_t interfaces;
+	isc_netaddr_t netaddr;
+
+	ISC_LIST_INIT(interfaces);
+
+	LOCK(&mgr->lock);
+	for (ifp = ISC_LIST_HEAD(mgr->interfaces); ifp != NULL; ifp = next) {
+		INSIST(NS_INTERFACE_VALID(ifp));
 		next = ISC_LIST_NEXT(ifp, link);
-		if (LISTENING(ifp)) {
-			char sabuf[256];
-			isc_sockaddr_format(&ifp->addr, sabuf, sizeof(sabuf));
-			isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_INFO,
-				      "no longer listening on %s", sabuf);
-			ns_interface_shutdown(ifp);
+		isc_netaddr_fromsockaddr(&netaddr, &ifp->addr);
+		if (isc_netaddr_equal(&netaddr, address)) {
+			ISC_LIST_UNLINK(mgr->interfaces, ifp, link);
+			ISC_LIST_APPEND(interfaces, ifp, link);
+		}
+	}
+	for (old = ISC_LIST_HEAD(mgr->listenon); old != NULL; old = nextold) {
+		nextold = ISC_LIST_NEXT(old, link);
+		isc_netaddr_fromsockaddr(&netaddr, old);
+		if (isc_netaddr_equal(&netaddr, address)) {
+			ISC_LIST_UNLINK(mgr->listenon, old, link);
+			isc_mem_put(mgr->mctx, old, sizeof(*old));
 		}
-		ISC_LIST_UNLINK(interfaces, ifp, link);
-		interface_destroy(&ifp);
 	}
+	UNLOCK(&mgr->lock);
+
+	destroy_interfaces(&interfaces);
 }
+#endif /* LINUX_NETLINK_AVAILABLE */
 
 static bool
 listenon_is_ip6_any(ns_listenelt_t *elt) {
@@ -895,6 +922,149 @@ setup_locals(isc_interface_t *interface, dns_acl_t *localhost,
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * The interfaces that make up the localhost and localnets ACLs are kept
+ * in 'mgr->locals', so that the ACLs can be rebuilt when an address is
+ * added or deleted without enumerating all the interfaces again.  The
+ * table is keyed by the address and its scope zone.
+ */
+typedef struct localkey {
+	uint32_t zone;
+	unsigned char address[16];
+} localkey_t;
+
+static uint32_t
+localkey(const isc_netaddr_t *netaddr, localkey_t *key) {
+	*key = (localkey_t){ .zone = netaddr->zone };
+
+	if (netaddr->family == AF_INET) {
+		memmove(key->address, &netaddr->type.in, 4);
+		return (offsetof(localkey_t, address) + 4);
+	}
+
+	memmove(key->address, &netaddr->type.in6, 16);
+	return (sizeof(*key));
+}
+
+/*%
+ * Record 'interface' as a local address.  Returns true if the address
+ * or its netmask was not known before.
+ */
+static bool
+addlocal(ns_interfacemgr_t *mgr, const isc_interface_t *interface) {
+	isc_result_t result;
+	isc_interface_t *local = NULL;
+	localkey_t key;
+	uint32_t keysize = localkey(&interface->address, &key);
+
+	result = isc_ht_find(mgr->locals, (unsigned char *)&key, keysize,
+			     (void **)&local);
+	if (result == ISC_R_SUCCESS) {
+		if (isc_netaddr_equal(&local->netmask, &interface->netmask)) {
+			return (false);
+		}
+		*local = *interface;
+		return (true);
+	}
+
+	local = isc_mem_get(mgr->mctx, sizeof(*local));
+	*local = *interface;
+	result = isc_ht_add(mgr->locals, (unsigned char *)&key, keysize,
+			    local);
+	INSIST(result == ISC_R_SUCCESS);
+
+	return (true);
+}
+
+#ifdef LINUX_NETLINK_AVAILABLE
+/*%
+ * Forget local address 'address'.  Returns true if it was known.
+ */
+static bool
+dellocal(ns_interfacemgr_t *mgr, const isc_netaddr_t *address) {
+	isc_result_t result;
+	isc_interface_t *local = NULL;
+	localkey_t key;
+	uint32_t keysize = localkey(address, &key);
+
+	result = isc_ht_find(mgr->locals, (unsigned char *)&key, keysize,
+			     (void **)&local);
+	if (result != ISC_R_SUCCESS) {
+		return (false);
+	}
+
+	result = isc_ht_delete(mgr->locals, (unsigned char *)&key, keysize);
+	INSIST(result == ISC_R_SUCCESS);
+	isc_mem_put(mgr->mctx, local, sizeof(*local));
+
+	return (true);
+}
+#endif /* LINUX_NETLINK_AVAILABLE */
+
+static void
+clearlocals(ns_interfacemgr_t *mgr) {
+	isc_result_t result;
+	isc_ht_iter_t *iter = NULL;
+
+	isc_ht_iter_create(mgr->locals, &iter);
+	result = isc_ht_iter_first(iter);
+	while (result == ISC_R_SUCCESS) {
+		isc_interface_t *local = NULL;
+
+		isc_ht_iter_current(iter, (void **)&local);
+		isc_mem_put(mgr->mctx, local, sizeof(*local));
+		result = isc_ht_iter_delcurrent_next(iter);
+	}
+	isc_ht_iter_destroy(&iter);
+}
+
+#ifdef LINUX_NETLINK_AVAILABLE
+/*%
+ * Rebuild the localhost and localnets ACLs from 'mgr->locals'.
+ */
+static isc_result_t
+setlocals(ns_interfacemgr_t *mgr) {
+	isc_result_t result;
+	isc_ht_iter_t *iter = NULL;
+	dns_acl_t *localhost = NULL;
+	dns_acl_t *localnets = NULL;
+
+	result = dns_acl_create(mgr->mctx, 0, &localhost);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	result = dns_acl_create(mgr->mctx, 0, &localnets);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup_localhost;
+	}
+
+	isc_ht_iter_create(mgr->locals, &iter);
+	for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
+	     result = isc_ht_iter_next(iter))
+	{
+		isc_interface_t *local = NULL;
+
+		isc_ht_iter_current(iter, (void **)&local);
+		result = setup_locals(local, localhost, localnets);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+	}
+	isc_ht_iter_destroy(&iter);
+
+	if (result == ISC_R_NOMORE) {
+		dns_aclenv_set(mgr->aclenv, localhost, localnets);
+		result = ISC_R_SUCCESS;
+	}
+
+	dns_acl_detach(&localnets);
+
+cleanup_localhost:
+	dns_acl_detach(&localhost);
+	return (result);
+}
+#endif /* LINUX_NETLINK_AVAILABLE */
+
 static void
 setup_listenon(ns_interfacemgr_t *mgr, isc_interface_t *interface,
 	       in_port_t port) {
@@ -975,6 +1145,12 @@ update_http_settings(ns_interface_t *ifp, ns_listenelt_t *le) {
 	}
 
 	isc_nmsocket_set_max_streams(listener, le->max_concurrent_streams);
+	isc_nm_http_set_response_cache(
+		listener, http_cache_size(ifp, le->http_cache_size));
+	isc_nm_http_set_settings(listener,
+				 le->http2_settings.initial_window_size,
+				 le->http2_settings.max_frame_size,
+				 le->http2_settings.header_table_size);
 
 	epset = isc_nm_http_endpoints_new(ifp->mgr->mctx);
 
@@ -1017,9 +1193,131 @@ update_listener_configuration(ns_interfacemgr_t *mgr, ns_interface_t *ifp,
 	}
 #endif /* HAVE_LIBNGHTTP2 */
 
+	set_listener_proxy(ifp, le->proxy);
+
 	UNLOCK(&mgr->lock);
 }
 
+/*%
+ * Listen on 'interface' for each listen-on element that matches its
+ * address, reusing the listeners that already exist.  An address that
+ * does not match is still recorded in the interface list, so that it is
+ * known to have been seen.
+ */
+static void
+listenon_interface(ns_interfacemgr_t *mgr, isc_interface_t *interface,
+		   bool verbose, bool config, bool wildcard6,
+		   bool *log_explicit, bool *tried_listening,
+		   bool *all_addresses_in_use) {
+	isc_result_t result;
+	unsigned int family = interface->address.family;
+	ns_listenlist_t *ll = NULL;
+	ns_listenelt_t *le = NULL;
+	ns_interface_t *ifp = NULL;
+	bool dolistenon = true;
+	char sabuf[ISC_SOCKADDR_FORMATSIZE];
+
+	ll = (family == AF_INET) ? mgr->listenon4 : mgr->listenon6;
+	for (le = ISC_LIST_HEAD(ll->elts); le != NULL;
+	     le = ISC_LIST_NEXT(le, link)) {
+		int match;
+		bool addr_in_use = false;
+		bool ipv6_wildcard = false;
+		isc_sockaddr_t listen_sockaddr;
+
+		isc_sockaddr_fromnetaddr(&listen_sockaddr, &interface->address,
+					 le->port);
+
+		/*
+		 * See if the address matches the listen-on statement;
+		 * if not, ignore the interface, but store it in
+		 * the interface table so we know we've seen it
+		 * before.
+		 */
+		(void)dns_acl_match(&interface->address, NULL, le->acl,
+				    mgr->aclenv, &match, NULL);
+		if (match <= 0) {
+			ns_interface_t *new = NULL;
+			interface_create(mgr, &listen_sockaddr, interface->name,
+					 &new);
+			continue;
+		}
+
+		if (dolistenon) {
+			setup_listenon(mgr, interface, le->port);
+			dolistenon = false;
+		}
+
+		/*
+		 * The case of "any" IPv6 address will require
+		 * special considerations later, so remember it.
+		 */
+		if (family == AF_INET6 && wildcard6 && listenon_is_ip6_any(le))
+		{
+			ipv6_wildcard = true;
+		}
+
+		ifp = find_matching_interface(mgr, &listen_sockaddr);
+		if (ifp != NULL) {
+			ifp->generation = mgr->generation;
+			if (le->dscp != -1 && ifp->dscp == -1) {
+				ifp->dscp = le->dscp;
+			} else if (le->dscp != ifp->dscp) {
+				isc_sockaddr_format(&listen_sockaddr, sabuf,
+						    sizeof(sabuf));
+				isc_log_write(IFMGR_COMMON_LOGARGS,
+					      ISC_LOG_WARNING,
+					      "%s: conflicting DSCP "
+					      "values, using %d",
+					      sabuf, ifp->dscp);
+			}
+			if (LISTENING(ifp)) {
+				if (config) {
+					update_listener_configuration(
+						mgr, ifp, le);
+				}
+				continue;
+			}
+		}
+
+		if (ipv6_wildcard) {
+			continue;
+		}
+
+		if (*log_explicit && family == AF_INET6 &&
+		    listenon_is_ip6_any(le)) {
+			isc_log_write(IFMGR_COMMON_LOGARGS,
+				      verbose ? ISC_LOG_INFO : ISC_LOG_DEBUG(1),
+				      "IPv6 socket API is incomplete; "
+				      "explicitly binding to each IPv6 "
+				      "address separately");
+			*log_explicit = false;
+		}
+		isc_sockaddr_format(&listen_sockaddr, sabuf, sizeof(sabuf));
+		isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_INFO,
+			      "listening on %s interface %s, %s",
+			      (family == AF_INET) ? "IPv4" : "IPv6",
+			      interface->name, sabuf);
+
+		result = interface_setup(mgr, &listen_sockaddr, interface->name,
+					 &ifp, le, &addr_in_use);
+
+		*tried_listening = true;
+		if (!addr_in_use) {
+			*all_addresses_in_use = false;
+		}
+
+		if (result != ISC_R_SUCCESS) {
+			isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_ERROR,
+				      "creating %s interface %s failed; "
+				      "interface ignored",
+				      (family == AF_INET) ? "IPv4" : "IPv6",
+				      interface->name);
+		}
+		/* Continue. */
+	}
+}
+
 static isc_result_t
 do_scan(ns_interfacemgr_t *mgr, bool verbose, bool config) {
 	isc_interfaceiter_t *iter = NULL;
@@ -1033,7 +1331,6 @@ do_scan(ns_interfacemgr_t *mgr, bool verbose, bool config) {
 	isc_sockaddr_t listen_addr;
 	ns_interface_t *ifp = NULL;
 	bool log_explicit = false;
-	bool dolistenon;
 	char sabuf[ISC_SOCKADDR_FORMATSIZE];
 	bool tried_listening;
 	bool all_addresses_in_use;
@@ -1144,6 +1441,7 @@ do_scan(ns_interfacemgr_t *mgr, bool verbose, bool config) {
 	}
 
 	clearlistenon(mgr);
+	clearlocals(mgr);
 
 	tried_listening = false;
 	all_addresses_in_use = true;
@@ -1151,7 +1449,6 @@ do_scan(ns_interfacemgr_t *mgr, bool verbose, bool config) {
 	     result = isc_interfaceiter_next(iter))
 	{
 		isc_interface_t interface;
-		ns_listenlist_t *ll = NULL;
 		unsigned int family;
 
 		result = isc_interfaceiter_current(iter, &interface);
@@ -1200,115 +1497,12 @@ do_scan(ns_interfacemgr_t *mgr, bool verbose, bool config) {
 		if (result != ISC_R_SUCCESS) {
 			goto ignore_interface;
 		}
+		(void)addlocal(mgr, &interface);
 
 	listenon:
-		ll = (family == AF_INET) ? mgr->listenon4 : mgr->listenon6;
-		dolistenon = true;
-		for (le = ISC_LIST_HEAD(ll->elts); le != NULL;
-		     le = ISC_LIST_NEXT(le, link)) {
-			int match;
-			bool addr_in_use = false;
-			bool ipv6_wildcard = false;
-			isc_sockaddr_t listen_sockaddr;
-
-			isc_sockaddr_fromnetaddr(&listen_sockaddr,
-						 &interface.address, le->port);
-
-			/*
-			 * See if the address matches the listen-on statement;
-			 * if not, ignore the interface, but store it in
-			 * the interface table so we know we've seen it
-			 * before.
-			 */
-			(void)dns_acl_match(&interface.address, NULL, le->acl,
-					    mgr->aclenv, &match, NULL);
-			if (match <= 0) {
-				ns_interface_t *new = NULL;
-				interface_create(mgr, &listen_sockaddr,
-						 interface.name, &new);
-				continue;
-			}
-
-			if (dolistenon) {
-				setup_listenon(mgr, &interface, le->port);
-				dolistenon = false;
-			}
-
-			/*
-			 * The case of "any" IPv6 address will require
-			 * special considerations later, so remember it.
-			 */
-			if (family == AF_INET6 && ipv6only && ipv6pktinfo &&
-			    listenon_is_ip6_any(le)) {
-				ipv6_wildcard = true;
-			}
-
-			ifp = find_matching_interface(mgr, &listen_sockaddr);
-			if (ifp != NULL) {
-				ifp->generation = mgr->generation;
-				if (le->dscp != -1 && ifp->dscp == -1) {
-					ifp->dscp = le->dscp;
-				} else if (le->dscp != ifp->dscp) {
-					isc_sockaddr_format(&listen_sockaddr,
-							    sabuf,
-							    sizeof(sabuf));
-					isc_log_write(IFMGR_COMMON_LOGARGS,
-						      ISC_LOG_WARNING,
-						      "%s: conflicting DSCP "
-						      "values, using %d",
-						      sabuf, ifp->dscp);
-				}
-				if (LISTENING(ifp)) {
-					if (config) {
-						update_listener_configuration(
-							mgr, ifp, le);
-					}
-					continue;
-				}
-			}
-
-			if (ipv6_wildcard) {
-				continue;
-			}
-
-			if (log_explicit && family == AF_INET6 &&
-			    listenon_is_ip6_any(le)) {
-				isc_log_write(IFMGR_COMMON_LOGARGS,
-					      verbose ? ISC_LOG_INFO
-						      : ISC_LOG_DEBUG(1),
-					      "IPv6 socket API is "
-					      "incomplete; explicitly "
-					      "binding to each IPv6 "
-					      "address separately");
-				log_explicit = false;
-			}
-			isc_sockaddr_format(&listen_sockaddr, sabuf,
-					    sizeof(sabuf));
-			isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_INFO,
-				      "listening on %s interface "
-				      "%s, %s",
-				      (family == AF_INET) ? "IPv4" : "IPv6",
-				      interface.name, sabuf);
-
-			result = interface_setup(mgr, &listen_sockaddr,
-						 interface.name, &ifp, le,
-						 &addr_in_use);
-
-			tried_listening = true;
-			if (!addr_in_use) {
-				all_addresses_in_use = false;
-			}
-
-			if (result != ISC_R_SUCCESS) {
-				isc_log_write(
-					IFMGR_COMMON_LOGARGS, ISC_LOG_ERROR,
-					"creating %s interface "
-					"%s failed; interface ignored",
-					(family == AF_INET) ? "IPv4" : "IPv6",
-					interface.name);
-			}
-			/* Continue. */
-		}
+		listenon_interface(mgr, &interface, verbose, config,
+				   ipv6only && ipv6pktinfo, &log_explicit,
+				   &tried_listening, &all_addresses_in_use);
 		continue;
 
 	ignore_interface:
@@ -1377,6 +1571,189 @@ ns_interfacemgr_scan(ns_interfacemgr_t *mgr, bool verbose, bool config) {
 	return (result);
 }
 
+#ifdef LINUX_NETLINK_AVAILABLE
+/*%
+ * Fill in 'interface' from the RTM_NEWADDR or RTM_DELADDR message 'nlh'.
+ * Returns false if the message does not describe an address we would
+ * listen on, including IPv6 addresses that are still tentative; the
+ * kernel sends another RTM_NEWADDR once duplicate address detection
+ * has finished.
+ */
+static bool
+route_getinterface(struct nlmsghdr *nlh, isc_interface_t *interface) {
+	struct ifaddrmsg *ifa = NULL;
+	struct rtattr *rth = NULL;
+	size_t rtl;
+	size_t addrlen;
+	void *address = NULL;
+	void *local = NULL;
+	unsigned char *mask = NULL;
+	isc_netaddr_t zero_address;
+	char name[IF_NAMESIZE];
+
+	if ((nlh->nlmsg_type != RTM_NEWADDR &&
+	     nlh->nlmsg_type != RTM_DELADDR) ||
+	    nlh->nlmsg_len < NLMSG_LENGTH(sizeof(*ifa)))
+	{
+		return (false);
+	}
+
+	ifa = (struct ifaddrmsg *)NLMSG_DATA(nlh);
+	switch (ifa->ifa_family) {
+	case AF_INET:
+		if (isc_net_probeipv4() != ISC_R_SUCCESS) {
+			return (false);
+		}
+		addrlen = sizeof(struct in_addr);
+		isc_netaddr_any(&zero_address);
+		break;
+	case AF_INET6:
+		if (isc_net_probeipv6() != ISC_R_SUCCESS) {
+			return (false);
+		}
+		addrlen = sizeof(struct in6_addr);
+		isc_netaddr_any6(&zero_address);
+		break;
+	default:
+		return (false);
+	}
+
+	if (nlh->nlmsg_type == RTM_NEWADDR &&
+	    (ifa->ifa_flags & (IFA_F_TENTATIVE | IFA_F_DADFAILED)) != 0)
+	{
+		return (false);
+	}
+	if (ifa->ifa_prefixlen > addrlen * 8) {
+		return (false);
+	}
+
+	for (rth = IFA_RTA(ifa), rtl = IFA_PAYLOAD(nlh); RTA_OK(rth, rtl);
+	     rth = RTA_NEXT(rth, rtl))
+	{
+		if (RTA_PAYLOAD(rth) < addrlen) {
+			continue;
+		}
+		if (rth->rta_type == IFA_ADDRESS) {
+			address = RTA_DATA(rth);
+		} else if (rth->rta_type == IFA_LOCAL) {
+			local = RTA_DATA(rth);
+		}
+	}
+
+	/*
+	 * On point-to-point links IFA_ADDRESS is the address of the
+	 * peer and IFA_LOCAL is ours; otherwise they are the same.
+	 */
+	if (local != NULL) {
+		address = local;
+	}
+	if (address == NULL) {
+		return (false);
+	}
+
+	*interface = (isc_interface_t){ .af = ifa->ifa_family };
+	if (ifa->ifa_family == AF_INET) {
+		isc_netaddr_fromin(&interface->address, address);
+	} else {
+		isc_netaddr_fromin6(&interface->address, address);
+		if (isc_netaddr_islinklocal(&interface->address)) {
+			isc_netaddr_setzone(&interface->address,
+					    ifa->ifa_index);
+		}
+	}
+	if (isc_netaddr_equal(&interface->address, &zero_address)) {
+		return (false);
+	}
+
+	interface->netmask.family = ifa->ifa_family;
+	mask = (unsigned char *)&interface->netmask.type;
+	for (unsigned int i = 0; i < ifa->ifa_prefixlen; i++) {
+		mask[i / 8] |= 0x80 >> (i % 8);
+	}
+
+	if (if_indextoname(ifa->ifa_index, name) != NULL) {
+		strlcpy(interface->name, name, sizeof(interface->name));
+	} else {
+		snprintf(interface->name, sizeof(interface->name), "#%u",
+			 ifa->ifa_index);
+	}
+
+	return (true);
+}
+
+/*
+ * Apply the address changes in the netlink messages 'rtm' one address
+ * at a time: only the listeners for the addresses that were added or
+ * deleted are created or shut down, instead of enumerating all the
+ * interfaces and reconciling every listener as ns_interfacemgr_scan()
+ * does.
+ */
+static void
+route_update(ns_interfacemgr_t *mgr, struct MSGHDR *rtm, size_t len) {
+	isc_result_t result;
+	struct nlmsghdr *nlh = NULL;
+	size_t rest;
+	isc_interface_t interface;
+	bool changed = false;
+	bool wildcard6;
+	bool log_explicit = false;
+	bool tried_listening = false;
+	bool all_addresses_in_use = true;
+
+	/*
+	 * Update the localhost and localnets ACLs first, as the
+	 * listen-on statements may refer to them.
+	 */
+	for (nlh = rtm, rest = len;
+	     NLMSG_OK(nlh, rest) && nlh->nlmsg_type != NLMSG_DONE;
+	     nlh = NLMSG_NEXT(nlh, rest))
+	{
+		if (!route_getinterface(nlh, &interface)) {
+			continue;
+		}
+		if (nlh->nlmsg_type == RTM_DELADDR) {
+			changed |= dellocal(mgr, &interface.address);
+		} else if ((mgr->sctx->options & NS_SERVER_FIXEDLOCAL) == 0 ||
+			   isc_netaddr_isloopback(&interface.address))
+		{
+			changed |= addlocal(mgr, &interface);
+		}
+	}
+
+	if (changed) {
+		result = setlocals(mgr);
+		if (result != ISC_R_SUCCESS) {
+			isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_ERROR,
+				      "updating local address ACLs failed: "
+				      "%s; rescanning interfaces",
+				      isc_result_totext(result));
+			ns_interfacemgr_scan(mgr, false, false);
+			return;
+		}
+	}
+
+	wildcard6 = (isc_net_probe_ipv6only() == ISC_R_SUCCESS &&
+		     isc_net_probe_ipv6pktinfo() == ISC_R_SUCCESS);
+
+	for (nlh = rtm, rest = len;
+	     NLMSG_OK(nlh, rest) && nlh->nlmsg_type != NLMSG_DONE;
+	     nlh = NLMSG_NEXT(nlh, rest))
+	{
+		if (!route_getinterface(nlh, &interface)) {
+			continue;
+		}
+		if (nlh->nlmsg_type == RTM_DELADDR) {
+			purge_address(mgr, &interface.address);
+		} else {
+			listenon_interface(mgr, &interface, false, false,
+					   wildcard6, &log_explicit,
+					   &tried_listening,
+					   &all_addresses_in_use);
+		}
+	}
+}
+#endif /* LINUX_NETLINK_AVAILABLE */
+
 bool
 ns_interfacemgr_islistening(ns_interfacemgr_t *mgr) {
 	REQUIRE(NS_INTERFACEMGR_VALID(mgr));
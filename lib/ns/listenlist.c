@@ -125,6 +125,14 @@ listenelt_create(isc_mem_t *mctx, in_port_t port, isc_dscp_t dscp,
 					sslctx, tls_params->session_tickets);
 			}
 
+			if (tls_params->ticket_key_file != NULL) {
+				result = isc_tlsctx_load_ticket_keys(
+					sslctx, tls_params->ticket_key_file);
+				if (result != ISC_R_SUCCESS) {
+					goto tls_error;
+				}
+			}
+
 #ifdef HAVE_LIBNGHTTP2
 			if (is_http) {
 				isc_tlsctx_enable_http2server_alpn(sslctx);
@@ -162,6 +170,7 @@ listenelt_create(isc_mem_t *mctx, in_port_t port, isc_dscp_t dscp,
 	ISC_LINK_INIT(elt, link);
 	elt->port = port;
 	elt->is_http = false;
+	elt->proxy = false;
 	elt->dscp = dscp;
 	elt->acl = acl;
 	elt->sslctx = sslctx;
@@ -173,6 +182,8 @@ listenelt_create(isc_mem_t *mctx, in_port_t port, isc_dscp_t dscp,
 	elt->http_endpoints_number = 0;
 	elt->http_max_clients = 0;
 	elt->max_concurrent_streams = 0;
+	elt->http_cache_size = 0;
+	elt->http2_settings = (ns_listen_http2_settings_t){ 0 };
 
 	*target = elt;
 	return (ISC_R_SUCCESS);
@@ -202,7 +213,9 @@ ns_listenelt_create_http(isc_mem_t *mctx, in_port_t http_port, isc_dscp_t dscp,
 			 const ns_listen_tls_params_t *tls_params,
 			 isc_tlsctx_cache_t *tlsctx_cache, char **endpoints,
 			 size_t nendpoints, const uint32_t max_clients,
-			 const uint32_t max_streams, ns_listenelt_t **target) {
+			 const uint32_t max_streams, const uint32_t cache_size,
+			 const ns_listen_http2_settings_t *http2_settings,
+			 ns_listenelt_t **target) {
 	isc_result_t result;
 
 	REQUIRE(target != NULL && *target == NULL);
@@ -224,6 +237,10 @@ ns_listenelt_create_http(isc_mem_t *mctx, in_port_t http_port, isc_dscp_t dscp,
 		(*target)->http_max_clients = max_clients == 0 ? UINT32_MAX
 							       : max_clients;
 		(*target)->max_concurrent_streams = max_streams;
+		(*target)->http_cache_size = cache_size;
+		if (http2_settings != NULL) {
+			(*target)->http2_settings = *http2_settings;
+		}
 	} else {
 		size_t i;
 		for (i = 0; i < nendpoints; i++) {
@@ -23,6 +23,7 @@
 #include <isc/mem.h>
 #include <isc/once.h>
 #include <isc/print.h>
+#include <isc/probes.h>
 #include <isc/random.h>
 #include <isc/result.h>
 #include <isc/rwlock.h>
@@ -33,6 +34,7 @@
 #include <isc/util.h>
 
 #include <dns/adb.h>
+#include <dns/anscache.h>
 #include <dns/badcache.h>
 #include <dns/byaddr.h>
 #include <dns/cache.h>
@@ -47,7 +49,9 @@
 #include <dns/ncache.h>
 #include <dns/nsec.h>
 #include <dns/nsec3.h>
+#include <dns/nsec3index.h>
 #include <dns/order.h>
+#include <dns/prefetch.h>
 #include <dns/rbt.h>
 #include <dns/rdata.h>
 #include <dns/rdataclass.h>
@@ -58,6 +62,8 @@
 #include <dns/rdatatype.h>
 #include <dns/resolver.h>
 #include <dns/result.h>
+#include <dns/sdlz.h>
+#include <dns/stalerefresh.h>
 #include <dns/stats.h>
 #include <dns/tkey.h>
 #include <dns/types.h>
@@ -282,6 +288,7 @@ get_hooktab(query_ctx_t *qctx) {
 		isc_result_t _res = result;                         \
 		ns_hooktable_t *_tab = get_hooktab(_qctx);          \
 		ns_hook_t *_hook;                                   \
+		ISC_PROBE2(libns, hook, (_qctx)->client, _id);      \
 		_hook = ISC_LIST_HEAD((*_tab)[_id]);                \
 		while (_hook != NULL) {                             \
 			ns_hook_action_t _func = _hook->action;     \
@@ -314,6 +321,7 @@ get_hooktab(query_ctx_t *qctx) {
 		isc_result_t _res;                              \
 		ns_hooktable_t *_tab = get_hooktab(_qctx);      \
 		ns_hook_t *_hook;                               \
+		ISC_PROBE2(libns, hook, (_qctx)->client, _id);  \
 		_hook = ISC_LIST_HEAD((*_tab)[_id]);            \
 		while (_hook != NULL) {                         \
 			ns_hook_action_t _func = _hook->action; \
@@ -404,6 +412,9 @@ query_setup(ns_client_t *client, dns_rdatatype_t qtype);
 static isc_result_t
 query_lookup(query_ctx_t *qctx);
 
+static isc_result_t
+query_lookupauth(query_ctx_t *qctx);
+
 static void
 fetch_callback(isc_task_t *task, isc_event_t *event);
 
@@ -453,6 +464,9 @@ query_delegation(query_ctx_t *qctx);
 static isc_result_t
 query_delegation_recurse(query_ctx_t *qctx);
 
+static isc_result_t
+query_nsec3nxdomain(query_ctx_t *qctx);
+
 static void
 query_addds(query_ctx_t *qctx);
 
@@ -563,9 +577,19 @@ query_send(ns_client_t *client) {
 	}
 
 	if (client->message->rcode == dns_rcode_noerror) {
+		dns_anscacheentry_t *entry = client->query.anscache.entry;
 		dns_section_t answer = DNS_SECTION_ANSWER;
-		if (ISC_LIST_EMPTY(client->message->sections[answer])) {
-			if (client->query.isreferral) {
+		bool empty, referral;
+
+		if (entry != NULL) {
+			empty = (entry->counts[answer] == 0);
+			referral = entry->referral;
+		} else {
+			empty = ISC_LIST_EMPTY(client->message->sections[answer]);
+			referral = client->query.isreferral;
+		}
+		if (empty) {
+			if (referral) {
 				counter = ns_statscounter_referral;
 			} else {
 				counter = ns_statscounter_nxrrset;
@@ -783,6 +807,11 @@ query_reset(ns_client_t *client, bool everything) {
 	client->query.root_key_sentinel_keyid = 0;
 	client->query.root_key_sentinel_is_ta = false;
 	client->query.root_key_sentinel_not_ta = false;
+	if (client->query.anscache.entry != NULL) {
+		dns_anscacheentry_detach(&client->query.anscache.entry);
+	}
+	client->query.anscache.cache = NULL;
+	client->query.anscache.keylen = 0;
 }
 
 static void
@@ -2619,6 +2648,11 @@ query_prefetch(ns_client_t *client, dns_name_t *qname,
 	       dns_rdataset_t *rdataset) {
 	CTRACE(ISC_LOG_DEBUG(3), "query_prefetch");
 
+	if (client->view->prefetch != NULL) {
+		dns_prefetch_record(client->view->prefetch, qname,
+				    rdataset->type, rdataset->ttl, client->now);
+	}
+
 	if (FETCH_RECTYPE_PREFETCH(client) != NULL ||
 	    client->view->prefetch_trigger == 0U ||
 	    rdataset->ttl > client->view->prefetch_trigger ||
@@ -4672,10 +4706,8 @@ query_findclosestnsec3(dns_name_t *qname, dns_db_t *db,
 	}
 
 again:
-	dns_fixedname_init(&fixed);
-	result = dns_nsec3_hashname(&fixed, NULL, NULL, &name,
-				    dns_db_origin(db), hash, iterations, salt,
-				    salt_length);
+	result = dns_db_nsec3hashname(db, &fixed, &name, hash, iterations,
+				      salt, salt_length);
 	if (result != ISC_R_SUCCESS) {
 		return;
 	}
@@ -5459,6 +5491,210 @@ root_key_sentinel_detect(query_ctx_t *qctx) {
 	}
 }
 
+/*%
+ * Check whether the current query is answered from an authoritative
+ * zone with none of the view or client features that rewrite responses
+ * or add per-query processing: recursion, RRL, RPZ, DNS64, sortlist,
+ * query hooks or root key sentinel labels.
+ */
+static bool
+query_authonly(query_ctx_t *qctx) {
+	ns_client_t *client = qctx->client;
+	dns_view_t *view = qctx->view;
+	ns_hooktable_t *tab = NULL;
+	dns_zonetype_t type;
+
+	if (qctx->zone == NULL || qctx->version == NULL ||
+	    !qctx->authoritative || qctx->is_staticstub_zone ||
+	    qctx->event != NULL)
+	{
+		return (false);
+	}
+
+	type = dns_zone_gettype(qctx->zone);
+	if (type != dns_zone_primary && type != dns_zone_secondary) {
+		return (false);
+	}
+
+	if (view->recursion || view->rrl != NULL || view->sortlist != NULL ||
+	    view->nocasecompress != NULL || view->dns64cnt != 0 ||
+	    (view->rpzs != NULL && view->rpzs->p.num_zones != 0))
+	{
+		return (false);
+	}
+
+	tab = get_hooktab(qctx);
+	for (int i = 0; i < NS_HOOKPOINTS_COUNT; i++) {
+		if (!ISC_LIST_EMPTY((*tab)[i])) {
+			return (false);
+		}
+	}
+
+	if (client->query.root_key_sentinel_is_ta ||
+	    client->query.root_key_sentinel_not_ta)
+	{
+		return (false);
+	}
+
+	return (true);
+}
+
+/*%
+ * Check whether the response to the current query may be taken from,
+ * or stored in, the answer cache of the zone it is answered from.  The
+ * cached response must not depend on anything other than the zone
+ * version and the request properties that make up the cache key, so
+ * any view or client feature that alters the response on a per-query
+ * basis rules it out.
+ */
+static dns_anscache_t *
+query_getanswercache(query_ctx_t *qctx) {
+	ns_client_t *client = qctx->client;
+	dns_anscache_t *cache = NULL;
+
+	if (!qctx->authonly || client->query.restarts > 0) {
+		return (NULL);
+	}
+
+	cache = dns_zone_getanswercache(qctx->zone);
+	if (cache == NULL) {
+		return (NULL);
+	}
+
+	if (client->message->tsigkey != NULL ||
+	    client->message->sig0key != NULL) {
+		return (NULL);
+	}
+
+	if (dns_rdatatype_ismeta(qctx->qtype) ||
+	    qctx->qtype == dns_rdatatype_rrsig ||
+	    qctx->qtype == dns_rdatatype_sig)
+	{
+		return (NULL);
+	}
+
+	return (cache);
+}
+
+/*%
+ * Add the ECS tag of the current query to an answer cache key.  The
+ * cached sections don't include the OPT record, so the client's own
+ * ECS option is echoed back whichever client the answer was rendered
+ * for.  An answer with a non-zero scope prefix only applies to clients
+ * in that subnet, so the client address masked to the scope becomes
+ * part of the key; answers with scope zero are shared by all clients,
+ * with or without ECS.
+ */
+static void
+query_putecskey(ns_client_t *client, isc_buffer_t *b) {
+	const dns_ecs_t *ecs = &client->ecs;
+	unsigned char addr[16] = { 0 };
+	unsigned int bits, bytes;
+
+	if (!HAVEECS(client) || ecs->scope == 0) {
+		isc_buffer_putuint8(b, 0);
+		return;
+	}
+
+	/*
+	 * A scope longer than the source prefix is only known to hold
+	 * for the source prefix (RFC 7871 section 7.3.1).
+	 */
+	bits = ISC_MIN(ecs->scope, ecs->source);
+	bytes = (bits + 7) / 8;
+	memmove(addr, &ecs->addr.type, bytes);
+	if ((bits % 8) != 0) {
+		addr[bytes - 1] &= 0xff << (8 - (bits % 8));
+	}
+
+	isc_buffer_putuint8(b, ecs->addr.family == AF_INET ? 4 : 6);
+	isc_buffer_putuint8(b, bits);
+	isc_buffer_putmem(b, addr, bytes);
+}
+
+void
+ns__query_anscachekey(isc_buffer_t *b, const dns_view_t *view,
+		      const dns_name_t *qname, dns_rdatatype_t qtype,
+		      dns_rdataclass_t qclass, uint8_t flags,
+		      uint16_t bufsize) {
+	isc_region_t r;
+
+	isc_buffer_putmem(b, (const unsigned char *)&view, sizeof(view));
+	isc_buffer_putuint16(b, qtype);
+	isc_buffer_putuint16(b, qclass);
+	isc_buffer_putuint8(b, flags);
+	isc_buffer_putuint16(b, bufsize);
+	dns_name_toregion(qname, &r);
+	isc_buffer_putmem(b, r.base, r.length);
+}
+
+/*%
+ * Look up a rendered response to the current query in the zone's
+ * answer cache.  On a miss, remember the cache and the key so that the
+ * response can be stored once it has been rendered.
+ */
+static isc_result_t
+query_findanswer(query_ctx_t *qctx) {
+	ns_client_t *client = qctx->client;
+	dns_anscache_t *cache = NULL;
+	dns_anscacheentry_t *entry = NULL;
+	isc_buffer_t b;
+	isc_region_t r;
+	uint8_t flags = 0;
+	isc_result_t result;
+
+	cache = query_getanswercache(qctx);
+	if (cache == NULL) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	if (WANTDNSSEC(client)) {
+		flags |= 0x01;
+	}
+	if (WANTAD(client)) {
+		flags |= 0x02;
+	}
+	if ((client->message->flags & DNS_MESSAGEFLAG_CD) != 0) {
+		flags |= 0x04;
+	}
+	if ((client->message->flags & DNS_MESSAGEFLAG_RD) != 0) {
+		flags |= 0x08;
+	}
+	if (NOAUTHORITY(client)) {
+		flags |= 0x10;
+	}
+	if (NOADDITIONAL(client)) {
+		flags |= 0x20;
+	}
+	if (isc_sockaddr_pf(&client->peeraddr) == AF_INET6) {
+		flags |= 0x40;
+	}
+
+	isc_buffer_init(&b, client->query.anscache.key,
+			sizeof(client->query.anscache.key));
+	ns__query_anscachekey(&b, client->view, client->query.qname,
+			      qctx->qtype, client->message->rdclass, flags,
+			      ns_client_sendbufsize(client));
+	query_putecskey(client, &b);
+	isc_buffer_usedregion(&b, &r);
+
+	result = dns_anscache_find(cache, qctx->db, qctx->version, &r, &entry);
+	if (result != ISC_R_SUCCESS) {
+		inc_stats(client, ns_statscounter_anscachemiss);
+		client->query.anscache.cache = cache;
+		client->query.anscache.keylen = r.length;
+		return (result);
+	}
+
+	inc_stats(client, ns_statscounter_anscachehit);
+	client->query.anscache.entry = entry;
+	client->message->flags &= ~(DNS_MESSAGEFLAG_AA | DNS_MESSAGEFLAG_AD);
+	client->message->flags |= entry->flags;
+	client->message->rcode = entry->rcode;
+
+	return (ISC_R_SUCCESS);
+}
+
 /*%
  * Starting point for a client query or a chaining query.
  *
@@ -5472,6 +5708,7 @@ ns__query_start(query_ctx_t *qctx) {
 	CCTRACE(ISC_LOG_DEBUG(3), "ns__query_start");
 	qctx->want_restart = false;
 	qctx->authoritative = false;
+	qctx->authonly = false;
 	qctx->version = NULL;
 	qctx->zversion = NULL;
 	qctx->need_wildcardproof = false;
@@ -5676,6 +5913,16 @@ ns__query_start(query_ctx_t *qctx) {
 		qctx->options |= DNS_GETDB_STALEFIRST;
 	}
 
+	qctx->authonly = query_authonly(qctx);
+
+	/*
+	 * Send the response straight from the zone's answer cache, if
+	 * there is one.
+	 */
+	if (query_findanswer(qctx) == ISC_R_SUCCESS) {
+		return (ns_query_done(qctx));
+	}
+
 	result = query_lookup(qctx);
 
 	/*
@@ -5762,6 +6009,109 @@ query_refresh_rrset(query_ctx_t *orig_qctx) {
 	qctx_destroy(&qctx);
 }
 
+/*
+ * When the answer of a DLZ database with a lookup cache is not cached
+ * yet, the lookup is first made in a worker thread, so that a slow DLZ
+ * driver does not hold up the loop of the client.  The query is
+ * suspended like for an asynchronous hook, and query_lookup() is called
+ * again when the lookup is done, to find the answer in the cache.
+ */
+static void
+dlzprefetch_cancel(ns_hookasync_t *hctx) {
+	/*
+	 * The lookup cannot be interrupted; query_hookresume() notices
+	 * the cancellation when it completes.
+	 */
+	UNUSED(hctx);
+}
+
+static void
+dlzprefetch_destroy(ns_hookasync_t **ctxp) {
+	ns_hookasync_t *ctx = *ctxp;
+
+	*ctxp = NULL;
+	isc_mem_putanddetach(&ctx->mctx, ctx, sizeof(*ctx));
+}
+
+static void
+dlzprefetch_done(void *arg) {
+	ns_hook_resevent_t *rev = arg;
+	isc_task_t *task = rev->ev_sender;
+
+	isc_task_send(task, (isc_event_t **)&rev);
+}
+
+static isc_result_t
+dlzprefetch_start(query_ctx_t *qctx, isc_mem_t *mctx, void *arg,
+		  isc_task_t *task, isc_taskaction_t action, void *evarg,
+		  ns_hookasync_t **ctxp) {
+	dns_name_t *name = arg;
+	ns_client_t *client = qctx->client;
+	ns_hook_resevent_t *rev = NULL;
+	ns_hookasync_t *ctx = NULL;
+
+	rev = (ns_hook_resevent_t *)isc_event_allocate(
+		mctx, task, NS_EVENT_HOOKASYNCDONE, action, evarg,
+		sizeof(*rev));
+	ctx = isc_mem_get(mctx, sizeof(*ctx));
+	*ctx = (ns_hookasync_t){
+		.cancel = dlzprefetch_cancel,
+		.destroy = dlzprefetch_destroy,
+	};
+	isc_mem_attach(mctx, &ctx->mctx);
+
+	rev->hookpoint = NS_QUERY_LOOKUP_BEGIN;
+	rev->origresult = ISC_R_SUCCESS;
+	rev->saved_qctx = qctx;
+	rev->ctx = ctx;
+
+	dns_sdlz_prefetch(qctx->db, name, qctx->type,
+			  client->query.dboptions,
+			  isc_loop_current(client->manager->loopmgr),
+			  dlzprefetch_done, rev);
+
+	*ctxp = ctx;
+	return (ISC_R_SUCCESS);
+}
+
+/*%
+ * Return true if the lookup of query_lookup() has been handed to a
+ * worker thread, see dlzprefetch_start().
+ */
+static bool
+query_dlzprefetch(query_ctx_t *qctx) {
+	dns_name_t *name = qctx->client->query.qname;
+
+	if (qctx->dlzprefetched) {
+		qctx->dlzprefetched = false;
+		return (false);
+	}
+
+	if (!qctx->is_zone || qctx->db == NULL) {
+		return (false);
+	}
+
+	if (qctx->dns64 && qctx->rpz) {
+		name = qctx->client->query.rpz_st->p_name;
+	}
+
+	if (!dns_sdlz_wouldblock(qctx->db, name,
+				 qctx->client->query.dboptions))
+	{
+		return (false);
+	}
+
+	/*
+	 * The flag is copied into the saved context that query_lookup()
+	 * is resumed with, so that the lookup is not handed off again if
+	 * its answers could not be cached.
+	 */
+	qctx->dlzprefetched = true;
+	(void)ns_query_hookasync(qctx, dlzprefetch_start, name);
+
+	return (true);
+}
+
 /*%
  * Perform a local database lookup, in either an authoritative or
  * cache database. If unable to answer, call ns_query_done(); otherwise
@@ -5786,6 +6136,16 @@ query_lookup(query_ctx_t *qctx) {
 
 	CCTRACE(ISC_LOG_DEBUG(3), "query_lookup");
 
+	if (query_dlzprefetch(qctx)) {
+		return (ISC_R_COMPLETE);
+	}
+
+	if (qctx->authonly && qctx->is_zone && qctx->authoritative &&
+	    !qctx->dns64)
+	{
+		return (query_lookupauth(qctx));
+	}
+
 	CALL_HOOK(NS_QUERY_LOOKUP_BEGIN, qctx);
 
 	dns_clientinfomethods_init(&cm, ns_client_sourceip);
@@ -5980,7 +6340,20 @@ query_lookup(query_ctx_t *qctx) {
 					"%s stale answer used, an attempt to "
 					"refresh the RRset will still be made",
 					namebuf);
-				refresh_rrset = STALE(qctx->rdataset);
+				if (qctx->view->stalerefresh != NULL) {
+					/*
+					 * Leave the refresh to the view's
+					 * queue, so the client can go.
+					 */
+					dns_stalerefresh_add(
+						qctx->view->stalerefresh,
+						qctx->client->query.qname,
+						qctx->dns64 ? dns_rdatatype_a
+							    : qctx->qtype,
+						qctx->client->now);
+				} else {
+					refresh_rrset = STALE(qctx->rdataset);
+				}
 				qctx->client->nodetach = refresh_rrset;
 				ns_client_extendederror(
 					qctx->client, ede,
@@ -6040,6 +6413,58 @@ cleanup:
 	return (result);
 }
 
+/*%
+ * Streamlined version of query_lookup() and query_gotanswer() for
+ * queries answered from an authoritative zone when query_authonly()
+ * holds.  None of the serve-stale, RRL, RPZ, DNS64 or root key
+ * sentinel processing can apply, so the result of the database lookup
+ * is passed straight to the function that builds the response for it:
+ * positive answers, referrals, NODATA and NXDOMAIN.  Everything else
+ * (CNAME and DNAME chasing, glue, errors) takes the query_gotanswer()
+ * path.
+ */
+static isc_result_t
+query_lookupauth(query_ctx_t *qctx) {
+	isc_buffer_t buffer;
+	isc_result_t result;
+	dns_clientinfomethods_t cm;
+	dns_clientinfo_t ci;
+
+	CCTRACE(ISC_LOG_DEBUG(3), "query_lookupauth");
+
+	dns_clientinfomethods_init(&cm, ns_client_sourceip);
+	dns_clientinfo_init(&ci, qctx->client,
+			    HAVEECS(qctx->client) ? &qctx->client->ecs : NULL,
+			    NULL);
+
+	result = qctx_prepare_buffers(qctx, &buffer);
+	if (result != ISC_R_SUCCESS) {
+		QUERY_ERROR(qctx, result);
+		return (ns_query_done(qctx));
+	}
+
+	result = dns_db_findext(qctx->db, qctx->client->query.qname,
+				qctx->version, qctx->type,
+				qctx->client->query.dboptions,
+				qctx->client->now, &qctx->node, qctx->fname,
+				&cm, &ci, qctx->rdataset, qctx->sigrdataset);
+
+	switch (result) {
+	case ISC_R_SUCCESS:
+		return (query_prepresponse(qctx));
+	case DNS_R_DELEGATION:
+		return (query_delegation(qctx));
+	case DNS_R_EMPTYNAME:
+	case DNS_R_NXRRSET:
+		return (query_nodata(qctx, result));
+	case DNS_R_EMPTYWILD:
+	case DNS_R_NXDOMAIN:
+		return (query_nxdomain(qctx, result));
+	default:
+		return (query_gotanswer(qctx, result));
+	}
+}
+
 /*
  * Clear all rdatasets from the message that are in the given section and
  * that have the 'attr' attribute set.
@@ -6068,16 +6493,13 @@ message_clearrdataset(dns_message_t *msg, unsigned int attr) {
 				ISC_LIST_UNLINK(name->list, rds, link);
 				INSIST(dns_rdataset_isassociated(rds));
 				dns_rdataset_disassociate(rds);
-				isc_mempool_put(msg->rdspool, rds);
+				dns_message_puttemprdataset(msg, &rds);
 				rds = next_rds;
 			}
 
 			if (ISC_LIST_EMPTY(name->list)) {
 				ISC_LIST_UNLINK(msg->sections[i], name, link);
-				if (dns_name_dynamic(name)) {
-					dns_name_free(name, msg->mctx);
-				}
-				isc_mempool_put(msg->namepool, name);
+				dns_message_puttempname(msg, &name);
 			}
 
 			name = next_name;
@@ -6149,6 +6571,8 @@ fetch_callback(isc_task_t *task, isc_event_t *event) {
 
 	CTRACE(ISC_LOG_DEBUG(3), "fetch_callback");
 
+	ISC_PROBE2(libns, recurse_done, client, devent->result);
+
 	if (event->ev_type == DNS_EVENT_TRYSTALE) {
 		query_lookup_stale(client);
 		isc_event_free(ISC_EVENT_PTR(&event));
@@ -6378,6 +6802,8 @@ ns_query_recurse(ns_client_t *client, dns_rdatatype_t qtype, dns_name_t *qname,
 
 	CTRACE(ISC_LOG_DEBUG(3), "ns_query_recurse");
 
+	ISC_PROBE3(libns, recurse_start, client, qname, qtype);
+
 	/*
 	 * Check recursion parameters from the previous query to see if they
 	 * match.  If not, update recursion parameters and proceed.
@@ -6393,6 +6819,7 @@ ns_query_recurse(ns_client_t *client, dns_rdatatype_t qtype, dns_name_t *qname,
 	if (!resuming) {
 		inc_stats(client, ns_statscounter_recursion);
 	}
+	client->attributes |= NS_CLIENTATTR_RECURSED;
 
 	result = check_recursionquota(client, RECTYPE_NORMAL);
 	if (result != ISC_R_SUCCESS) {
@@ -7100,8 +7527,10 @@ query_checkrpz(query_ctx_t *qctx, isc_result_t result) {
 
 	CCTRACE(ISC_LOG_DEBUG(3), "query_checkrpz");
 
+	ISC_PROBE1(libns, rpz_start, qctx->client);
 	rresult = rpz_rewrite(qctx->client, qctx->qtype, result, qctx->resuming,
 			      qctx->rdataset, qctx->sigrdataset);
+	ISC_PROBE2(libns, rpz_done, qctx->client, rresult);
 	qctx->rpz_st = qctx->client->query.rpz_st;
 	switch (rresult) {
 	case ISC_R_SUCCESS:
@@ -8176,6 +8605,8 @@ query_dns64(query_ctx_t *qctx) {
 	isc_netaddr_t netaddr;
 	dns_dns64_t *dns64;
 	unsigned int flags = 0;
+	unsigned int i, napply = 0;
+	bool *apply = NULL;
 	const dns_section_t section = DNS_SECTION_ANSWER;
 
 	/*%
@@ -8237,22 +8668,6 @@ query_dns64(query_ctx_t *qctx) {
 
 	isc_netaddr_fromsockaddr(&netaddr, &client->peeraddr);
 
-	isc_buffer_allocate(client->manager->mctx, &buffer,
-			    view->dns64cnt * 16 *
-				    dns_rdataset_count(qctx->rdataset));
-	dns_message_gettemprdataset(client->message, &dns64_rdataset);
-	dns_message_gettemprdatalist(client->message, &dns64_rdatalist);
-
-	dns_rdatalist_init(dns64_rdatalist);
-	dns64_rdatalist->rdclass = dns_rdataclass_in;
-	dns64_rdatalist->type = dns_rdatatype_aaaa;
-	if (client->query.dns64_ttl != UINT32_MAX) {
-		dns64_rdatalist->ttl = ISC_MIN(qctx->rdataset->ttl,
-					       client->query.dns64_ttl);
-	} else {
-		dns64_rdatalist->ttl = ISC_MIN(qctx->rdataset->ttl, 600);
-	}
-
 	if (RECURSIONOK(client)) {
 		flags |= DNS_DNS64_RECURSIVE;
 	}
@@ -8267,19 +8682,56 @@ query_dns64(query_ctx_t *qctx) {
 		flags |= DNS_DNS64_DNSSEC;
 	}
 
+	/*
+	 * Which prefixes apply to this client does not depend on the A
+	 * records, so it is only worked out once.
+	 */
+	apply = isc_mem_get(client->manager->mctx,
+			    view->dns64cnt * sizeof(apply[0]));
+	for (dns64 = ISC_LIST_HEAD(view->dns64), i = 0; dns64 != NULL;
+	     dns64 = dns_dns64_next(dns64), i++)
+	{
+		apply[i] = dns_dns64_clientok(dns64, &netaddr, client->signer,
+					      env, flags);
+		if (apply[i]) {
+			napply++;
+		}
+	}
+	if (napply == 0) {
+		result = ISC_R_NOMORE;
+		goto cleanup;
+	}
+
+	isc_buffer_allocate(client->manager->mctx, &buffer,
+			    napply * 16 * dns_rdataset_count(qctx->rdataset));
+	dns_message_gettemprdataset(client->message, &dns64_rdataset);
+	dns_message_gettemprdatalist(client->message, &dns64_rdatalist);
+
+	dns_rdatalist_init(dns64_rdatalist);
+	dns64_rdatalist->rdclass = dns_rdataclass_in;
+	dns64_rdatalist->type = dns_rdatatype_aaaa;
+	if (client->query.dns64_ttl != UINT32_MAX) {
+		dns64_rdatalist->ttl = ISC_MIN(qctx->rdataset->ttl,
+					       client->query.dns64_ttl);
+	} else {
+		dns64_rdatalist->ttl = ISC_MIN(qctx->rdataset->ttl, 600);
+	}
+
 	for (result = dns_rdataset_first(qctx->rdataset);
 	     result == ISC_R_SUCCESS;
 	     result = dns_rdataset_next(qctx->rdataset))
 	{
-		for (dns64 = ISC_LIST_HEAD(client->view->dns64); dns64 != NULL;
-		     dns64 = dns_dns64_next(dns64))
+		for (dns64 = ISC_LIST_HEAD(view->dns64), i = 0; dns64 != NULL;
+		     dns64 = dns_dns64_next(dns64), i++)
 		{
+			if (!apply[i]) {
+				continue;
+			}
 			dns_rdataset_current(qctx->rdataset, &rdata);
 			isc_buffer_availableregion(buffer, &r);
 			INSIST(r.length >= 16);
-			result = dns_dns64_aaaafroma(dns64, &netaddr,
-						     client->signer, env, flags,
-						     rdata.data, r.base);
+			result = dns_dns64_synthesize(dns64, env, rdata.data,
+						      r.base);
 			if (result != ISC_R_SUCCESS) {
 				dns_rdata_reset(&rdata);
 				continue;
@@ -8320,6 +8772,11 @@ query_dns64(query_ctx_t *qctx) {
 	result = ISC_R_SUCCESS;
 
 cleanup:
+	if (apply != NULL) {
+		isc_mem_put(client->manager->mctx, apply,
+			    view->dns64cnt * sizeof(apply[0]));
+	}
+
 	if (buffer != NULL) {
 		isc_buffer_free(&buffer);
 	}
@@ -8819,6 +9276,15 @@ query_delegation_recurse(query_ctx_t *qctx) {
 
 	CALL_HOOK(NS_QUERY_DELEGATION_RECURSE_BEGIN, qctx);
 
+	/*
+	 * If validated NSEC3 records already prove that the name doesn't
+	 * exist, answer without asking the servers of the zone.
+	 */
+	result = query_nsec3nxdomain(qctx);
+	if (result != ISC_R_COMPLETE) {
+		return (result);
+	}
+
 	/*
 	 * We have a delegation and recursion is allowed,
 	 * so we call ns_query_recurse() to follow it.
@@ -9800,6 +10266,108 @@ query_synthnxdomainnodata(query_ctx_t *qctx, bool nodata, dns_name_t *nowild,
 	return (ISC_R_SUCCESS);
 }
 
+/*%
+ * Synthesize an NXDOMAIN response from the view's index of validated
+ * NSEC3 ranges, and the validated SOA of the zone in cache.  The ranges
+ * are all that is kept of the NSEC3 records, so this is only done for
+ * clients that don't want the proofs.
+ *
+ * Returns ISC_R_COMPLETE if the response can't be synthesized.
+ */
+static isc_result_t
+query_nsec3nxdomain(query_ctx_t *qctx) {
+	dns_clientinfo_t ci;
+	dns_clientinfomethods_t cm;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t fnamespace, fzone, ffound;
+	dns_name_t *namespace = NULL, *zone = NULL, *found = NULL;
+	dns_name_t *name = NULL;
+	dns_name_t *qname = qctx->client->query.qname;
+	dns_rdataset_t *soardataset = NULL, *sigsoardataset = NULL;
+	isc_buffer_t *dbuf, b;
+	isc_result_t result;
+
+	CCTRACE(ISC_LOG_DEBUG(3), "query_nsec3nxdomain");
+
+	if (!qctx->view->synthfromdnssec || qctx->view->nsec3index == NULL ||
+	    qctx->view->cachedb == NULL || WANTDNSSEC(qctx->client) ||
+	    dns_rdatatype_atparent(qctx->qtype) || qctx->dns64 ||
+	    qctx->view->redirect != NULL || qctx->view->redirectzone != NULL)
+	{
+		return (ISC_R_COMPLETE);
+	}
+
+	zone = dns_fixedname_initname(&fzone);
+	result = dns_nsec3index_nxdomain(qctx->view->nsec3index, qname,
+					 qctx->client->now, zone);
+	if (result != ISC_R_SUCCESS) {
+		return (ISC_R_COMPLETE);
+	}
+
+	/*
+	 * The zone must be within the namespace synth-from-dnssec
+	 * applies to.
+	 */
+	namespace = dns_fixedname_initname(&fnamespace);
+	dns_view_sfd_find(qctx->view, qname, namespace);
+	if (!dns_name_issubdomain(zone, namespace)) {
+		return (ISC_R_COMPLETE);
+	}
+
+	dns_clientinfomethods_init(&cm, ns_client_sourceip);
+	dns_clientinfo_init(&ci, qctx->client, NULL, NULL);
+
+	soardataset = ns_client_newrdataset(qctx->client);
+	sigsoardataset = ns_client_newrdataset(qctx->client);
+	found = dns_fixedname_initname(&ffound);
+	result = dns_db_findext(qctx->view->cachedb, zone, NULL,
+				dns_rdatatype_soa,
+				qctx->client->query.dboptions,
+				qctx->client->now, &node, found, &cm, &ci,
+				soardataset, sigsoardataset);
+	if (node != NULL) {
+		dns_db_detachnode(qctx->view->cachedb, &node);
+	}
+	if (result != ISC_R_SUCCESS ||
+	    !dns_rdataset_isassociated(sigsoardataset) ||
+	    soardataset->trust != dns_trust_secure ||
+	    sigsoardataset->trust != dns_trust_secure)
+	{
+		result = ISC_R_COMPLETE;
+		goto cleanup;
+	}
+
+	soardataset->ttl = query_synthttl(soardataset, sigsoardataset,
+					  soardataset, sigsoardataset, NULL,
+					  NULL);
+
+	/*
+	 * The delegation found in the lookup is of no use now.
+	 */
+	ns_client_releasename(qctx->client, &qctx->fname);
+	qctx_clean(qctx);
+
+	dbuf = ns_client_getnamebuf(qctx->client);
+	name = ns_client_newname(qctx->client, dbuf, &b);
+	dns_name_copy(zone, name);
+	query_addrrset(qctx, &name, &soardataset, NULL, dbuf,
+		       DNS_SECTION_AUTHORITY);
+	if (name != NULL) {
+		ns_client_releasename(qctx->client, &name);
+	}
+	ns_client_putrdataset(qctx->client, &sigsoardataset);
+
+	qctx->client->message->rcode = dns_rcode_nxdomain;
+	inc_stats(qctx->client, ns_statscounter_nxdomainsynth);
+
+	return (ns_query_done(qctx));
+
+cleanup:
+	ns_client_putrdataset(qctx->client, &soardataset);
+	ns_client_putrdataset(qctx->client, &sigsoardataset);
+	return (result);
+}
+
 /*
  * Check that all signer names in sigrdataset match the expected signer.
  */
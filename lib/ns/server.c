@@ -15,6 +15,7 @@
 
 #include <stdbool.h>
 
+#include <isc/ht.h>
 #include <isc/mem.h>
 #include <isc/stats.h>
 #include <isc/util.h>
@@ -25,6 +26,7 @@
 #include <ns/query.h>
 #include <ns/server.h>
 #include <ns/stats.h>
+#include <ns/xfrcache.h>
 
 #define SCTX_MAGIC    ISC_MAGIC('S', 'c', 't', 'x')
 #define SCTX_VALID(s) ISC_MAGIC_VALID(s, SCTX_MAGIC)
@@ -59,6 +61,11 @@ ns_server_create(isc_mem_t *mctx, ns_matchview_t matchingview,
 
 	CHECKFATAL(dns_tkeyctx_create(mctx, &sctx->tkeyctx));
 
+	ns_xfrcache_create(mctx, &sctx->xfrcache);
+
+	isc_mutex_init(&sctx->updatelock);
+	isc_ht_init(&sctx->updatequeues, mctx, 4, ISC_HT_CASE_SENSITIVE);
+
 	CHECKFATAL(ns_stats_create(mctx, ns_statscounter_max, &sctx->nsstats));
 
 	CHECKFATAL(dns_rdatatypestats_create(mctx, &sctx->rcvquerystats));
@@ -67,29 +74,29 @@ ns_server_create(isc_mem_t *mctx, ns_matchview_t matchingview,
 
 	CHECKFATAL(dns_rcodestats_create(mctx, &sctx->rcodestats));
 
-	CHECKFATAL(isc_stats_create(mctx, &sctx->udpinstats4,
-				    dns_sizecounter_in_max));
+	CHECKFATAL(isc_stats_createsharded(mctx, &sctx->udpinstats4,
+					   dns_sizecounter_in_max));
 
-	CHECKFATAL(isc_stats_create(mctx, &sctx->udpoutstats4,
-				    dns_sizecounter_out_max));
+	CHECKFATAL(isc_stats_createsharded(mctx, &sctx->udpoutstats4,
+					   dns_sizecounter_out_max));
 
-	CHECKFATAL(isc_stats_create(mctx, &sctx->udpinstats6,
-				    dns_sizecounter_in_max));
+	CHECKFATAL(isc_stats_createsharded(mctx, &sctx->udpinstats6,
+					   dns_sizecounter_in_max));
 
-	CHECKFATAL(isc_stats_create(mctx, &sctx->udpoutstats6,
-				    dns_sizecounter_out_max));
+	CHECKFATAL(isc_stats_createsharded(mctx, &sctx->udpoutstats6,
+					   dns_sizecounter_out_max));
 
-	CHECKFATAL(isc_stats_create(mctx, &sctx->tcpinstats4,
-				    dns_sizecounter_in_max));
+	CHECKFATAL(isc_stats_createsharded(mctx, &sctx->tcpinstats4,
+					   dns_sizecounter_in_max));
 
-	CHECKFATAL(isc_stats_create(mctx, &sctx->tcpoutstats4,
-				    dns_sizecounter_out_max));
+	CHECKFATAL(isc_stats_createsharded(mctx, &sctx->tcpoutstats4,
+					   dns_sizecounter_out_max));
 
-	CHECKFATAL(isc_stats_create(mctx, &sctx->tcpinstats6,
-				    dns_sizecounter_in_max));
+	CHECKFATAL(isc_stats_createsharded(mctx, &sctx->tcpinstats6,
+					   dns_sizecounter_in_max));
 
-	CHECKFATAL(isc_stats_create(mctx, &sctx->tcpoutstats6,
-				    dns_sizecounter_out_max));
+	CHECKFATAL(isc_stats_createsharded(mctx, &sctx->tcpoutstats6,
+					   dns_sizecounter_out_max));
 
 	sctx->udpsize = 1232;
 	sctx->transfer_tcp_message_size = 20480;
@@ -160,9 +167,19 @@ ns_server_detach(ns_server_t **sctxp) {
 		if (sctx->blackholeacl != NULL) {
 			dns_acl_detach(&sctx->blackholeacl);
 		}
+		if (sctx->proxyacl != NULL) {
+			dns_acl_detach(&sctx->proxyacl);
+		}
 		if (sctx->tkeyctx != NULL) {
 			dns_tkeyctx_destroy(&sctx->tkeyctx);
 		}
+		if (sctx->xfrcache != NULL) {
+			ns_xfrcache_destroy(&sctx->xfrcache);
+		}
+
+		INSIST(isc_ht_count(sctx->updatequeues) == 0);
+		isc_ht_destroy(&sctx->updatequeues);
+		isc_mutex_destroy(&sctx->updatelock);
 
 		if (sctx->nsstats != NULL) {
 			ns_stats_detach(&sctx->nsstats);
@@ -70,7 +70,7 @@ ns_stats_create(isc_mem_t *mctx, int ncounters, ns_stats_t **statsp) {
 
 	isc_refcount_init(&stats->references, 1);
 
-	result = isc_stats_create(mctx, &stats->counters, ncounters);
+	result = isc_stats_createsharded(mctx, &stats->counters, ncounters);
 	if (result != ISC_R_SUCCESS) {
 		goto clean_mem;
 	}
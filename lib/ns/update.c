@@ -14,6 +14,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/ht.h>
 #include <isc/netaddr.h>
 #include <isc/print.h>
 #include <isc/serial.h>
@@ -232,6 +233,22 @@ struct update_event {
 	dns_message_t *answer;
 };
 
+typedef ISC_LIST(update_event_t) update_eventlist_t;
+
+/*%
+ * The UPDATE requests waiting to be processed for a zone, indexed by
+ * zone in sctx->updatequeues.  The first request queued schedules
+ * update_action() on the zone task, which processes the requests queued
+ * by then in batches of at most UPDATE_BATCH_MAX.
+ */
+typedef struct update_queue {
+	ns_server_t *sctx;
+	dns_zone_t *zone;
+	update_eventlist_t events;
+} update_queue_t;
+
+#define UPDATE_BATCH_MAX 64
+
 /*%
  * Prepare an RR for the addition of the new RR 'ctx->update_rr',
  * with TTL 'ctx->update_rr_ttl', to its rdataset, by deleting
@@ -470,7 +487,8 @@ do_one_tuple(dns_difftuple_t **tuple, dns_db_t *db, dns_dbversion_t *ver,
 
 /*%
  * Perform the updates in 'updates' in version 'ver' of 'db' and log the
- * update in 'diff'.
+ * update in 'diff'.  On failure, 'diff' still logs the updates that
+ * were performed.
  *
  * Ensures:
  * \li	'updates' is empty.
@@ -487,7 +505,7 @@ do_diff(dns_diff_t *updates, dns_db_t *db, dns_dbversion_t *ver,
 	return (ISC_R_SUCCESS);
 
 failure:
-	dns_diff_clear(diff);
+	dns_diff_clear(updates);
 	return (result);
 }
 
@@ -1636,13 +1654,14 @@ check_soa_increment(dns_db_t *db, dns_dbversion_t *ver,
 
 static isc_result_t
 send_update_event(ns_client_t *client, dns_zone_t *zone) {
-	isc_result_t result = ISC_R_SUCCESS;
+	ns_server_t *sctx = client->manager->sctx;
 	update_event_t *event = NULL;
-	isc_task_t *zonetask = NULL;
+	update_queue_t *queue = NULL;
+	isc_result_t result;
 
 	event = (update_event_t *)isc_event_allocate(
-		client->manager->mctx, client, DNS_EVENT_UPDATE, update_action,
-		NULL, sizeof(*event));
+		client->manager->mctx, client, DNS_EVENT_UPDATE,
+		updatedone_action, NULL, sizeof(*event));
 	event->zone = zone;
 	event->result = ISC_R_SUCCESS;
 
@@ -1651,10 +1670,34 @@ send_update_event(ns_client_t *client, dns_zone_t *zone) {
 	event->ev_arg = client;
 
 	isc_nmhandle_attach(client->handle, &client->updatehandle);
-	dns_zone_gettask(zone, &zonetask);
-	isc_task_send(zonetask, ISC_EVENT_PTR(&event));
 
-	return (result);
+	LOCK(&sctx->updatelock);
+	result = isc_ht_find(sctx->updatequeues, (const uint8_t *)&zone,
+			     sizeof(zone), (void **)&queue);
+	if (result != ISC_R_SUCCESS) {
+		isc_task_t *zonetask = NULL;
+		isc_event_t *drain = NULL;
+
+		queue = isc_mem_get(sctx->mctx, sizeof(*queue));
+		*queue = (update_queue_t){ .zone = NULL };
+		ns_server_attach(sctx, &queue->sctx);
+		dns_zone_attach(zone, &queue->zone);
+		ISC_LIST_INIT(queue->events);
+		result = isc_ht_add(sctx->updatequeues,
+				    (const uint8_t *)&queue->zone,
+				    sizeof(queue->zone), queue);
+		INSIST(result == ISC_R_SUCCESS);
+
+		drain = isc_event_allocate(sctx->mctx, sctx, DNS_EVENT_UPDATE,
+					   update_action, queue,
+					   sizeof(isc_event_t));
+		dns_zone_gettask(zone, &zonetask);
+		isc_task_send(zonetask, &drain);
+	}
+	ISC_LIST_APPEND(queue->events, event, ev_link);
+	UNLOCK(&sctx->updatelock);
+
+	return (ISC_R_SUCCESS);
 }
 
 static void
@@ -2606,48 +2649,74 @@ isdnssec(dns_db_t *db, dns_dbversion_t *ver, dns_rdatatype_t privatetype) {
 	return (build_nsec || build_nsec3);
 }
 
-static void
-update_action(isc_task_t *task, isc_event_t *event) {
-	update_event_t *uev = (update_event_t *)event;
-	dns_zone_t *zone = uev->zone;
-	ns_client_t *client = (ns_client_t *)event->ev_arg;
+#define ALLOW_SECURE_TO_INSECURE(zone) \
+	((dns_zone_getoptions(zone) & DNS_ZONEOPT_SECURETOINSECURE) != 0)
+
+/*%
+ * Fail with DNS_R_TOOMANYRECORDS if version 'ver' of the zone has more
+ * records than its max-records setting allows.
+ */
+static isc_result_t
+check_maxrecords(ns_client_t *client, dns_zone_t *zone, dns_db_t *db,
+		 dns_dbversion_t *ver) {
+	isc_result_t result;
+	uint32_t maxrecords = dns_zone_getmaxrecords(zone);
+	uint64_t records;
+
+	if (maxrecords == 0U) {
+		return (ISC_R_SUCCESS);
+	}
+
+	result = dns_db_getsize(db, ver, &records, NULL);
+	if (result == ISC_R_SUCCESS && records > maxrecords) {
+		update_log(client, zone, ISC_LOG_ERROR,
+			   "records in zone (%" PRIu64 ") "
+			   "exceeds"
+			   " max-"
+			   "records"
+			   " (%u)",
+			   records, maxrecords);
+		return (DNS_R_TOOMANYRECORDS);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+/*%
+ * Check the prerequisites of the UPDATE request of 'client' against
+ * version 'ver' of the zone database 'db', then apply its update section
+ * to 'ver', recording the changes in 'diff'.  '*soa_serial_changedp' is
+ * set if the request changed the SOA serial itself.
+ *
+ * On failure, 'diff' holds the changes that have been made to 'ver' so
+ * far, so that the caller can back them out.
+ */
+static isc_result_t
+update_apply(ns_client_t *client, dns_zone_t *zone, dns_db_t *db,
+	     dns_dbversion_t *ver, dns_ssutable_t *ssutable, dns_diff_t *diff,
+	     bool *soa_serial_changedp) {
 	isc_result_t result;
-	dns_db_t *db = NULL;
-	dns_dbversion_t *oldver = NULL;
-	dns_dbversion_t *ver = NULL;
-	dns_diff_t diff; /* Pending updates. */
 	dns_diff_t temp; /* Pending RR existence assertions. */
-	bool soa_serial_changed = false;
 	isc_mem_t *mctx = client->manager->mctx;
 	dns_rdatatype_t covers;
 	dns_message_t *request = client->message;
 	dns_rdataclass_t zoneclass;
 	dns_name_t *zonename;
-	dns_ssutable_t *ssutable = NULL;
 	dns_fixedname_t tmpnamefixed;
 	dns_name_t *tmpname = NULL;
 	dns_zoneopt_t options;
-	dns_difftuple_t *tuple;
-	dns_rdata_dnskey_t dnskey;
-	bool had_dnskey;
+	bool had_dnskey, has_dnskey;
 	dns_rdatatype_t privatetype = dns_zone_getprivatetype(zone);
 	dns_ttl_t maxttl = 0;
-	uint32_t maxrecords;
-	uint64_t records;
 	dns_aclenv_t *env = client->manager->aclenv;
 	size_t ruleslen = 0;
 	size_t rule;
 	const dns_ssurule_t **rules = NULL;
 
-	INSIST(event->ev_type == DNS_EVENT_UPDATE);
-
-	dns_diff_init(mctx, &diff);
 	dns_diff_init(mctx, &temp);
 
-	CHECK(dns_zone_getdb(zone, &db));
 	zonename = dns_db_origin(db);
 	zoneclass = dns_db_class(db);
-	dns_zone_getssutable(zone, &ssutable);
 
 	/*
 	 * Update message processing can leak record existence information
@@ -2657,11 +2726,8 @@ update_action(isc_task_t *task, isc_event_t *event) {
 	CHECK(checkqueryacl(client, dns_zone_getqueryacl(zone), zonename,
 			    dns_zone_getupdateacl(zone), ssutable));
 
-	/*
-	 * Get old and new versions now that queryacl has been checked.
-	 */
-	dns_db_currentversion(db, &oldver);
-	CHECK(dns_db_newversion(db, &ver));
+	CHECK(rrset_exists(db, ver, zonename, dns_rdatatype_dnskey, 0,
+			   &had_dnskey));
 
 	/*
 	 * Check prerequisites.
@@ -3081,7 +3147,7 @@ update_action(isc_task_t *task, isc_event_t *event) {
 						   "ignoring it");
 					continue;
 				}
-				soa_serial_changed = true;
+				*soa_serial_changedp = true;
 			}
 
 			if (dns_rdatatype_atparent(rdata.type) &&
@@ -3199,7 +3265,7 @@ update_action(isc_task_t *task, isc_event_t *event) {
 				add_rr_prepare_ctx_t ctx;
 				ctx.db = db;
 				ctx.ver = ver;
-				ctx.diff = &diff;
+				ctx.diff = diff;
 				ctx.name = name;
 				ctx.oldname = name;
 				ctx.update_rr = &rdata;
@@ -3216,18 +3282,18 @@ update_action(isc_task_t *task, isc_event_t *event) {
 					dns_diff_clear(&ctx.add_diff);
 				} else {
 					result = do_diff(&ctx.del_diff, db, ver,
-							 &diff);
+							 diff);
 					if (result == ISC_R_SUCCESS) {
 						result = do_diff(&ctx.add_diff,
 								 db, ver,
-								 &diff);
+								 diff);
 					}
 					if (result != ISC_R_SUCCESS) {
 						dns_diff_clear(&ctx.del_diff);
 						dns_diff_clear(&ctx.add_diff);
 						goto failure;
 					}
-					CHECK(update_one_rr(db, ver, &diff,
+					CHECK(update_one_rr(db, ver, diff,
 							    DNS_DIFFOP_ADD,
 							    name, ttl, &rdata));
 				}
@@ -3249,12 +3315,12 @@ update_action(isc_task_t *task, isc_event_t *event) {
 					CHECK(delete_if(type_not_soa_nor_ns_p,
 							db, ver, name,
 							dns_rdatatype_any, 0,
-							&rdata, &diff));
+							&rdata, diff));
 				} else {
 					CHECK(delete_if(type_not_dnssec, db,
 							ver, name,
 							dns_rdatatype_any, 0,
-							&rdata, &diff));
+							&rdata, diff));
 				}
 			} else if (dns_name_equal(name, zonename) &&
 				   (rdata.type == dns_rdatatype_soa ||
@@ -3281,7 +3347,7 @@ update_action(isc_task_t *task, isc_event_t *event) {
 				}
 				CHECK(delete_if(true_p, db, ver, name,
 						rdata.type, covers, &rdata,
-						&diff));
+						diff));
 			}
 		} else if (update_class == dns_rdataclass_none) {
 			char namestr[DNS_NAME_FORMATSIZE];
@@ -3320,7 +3386,7 @@ update_action(isc_task_t *task, isc_event_t *event) {
 			update_log(client, zone, LOGLEVEL_PROTOCOL,
 				   "deleting an RR at %s %s", namestr, typestr);
 			CHECK(delete_if(rr_equal_p, db, ver, name, rdata.type,
-					covers, &rdata, &diff));
+					covers, &rdata, diff));
 		}
 	}
 	if (result != ISC_R_NOMORE) {
@@ -3332,11 +3398,11 @@ update_action(isc_task_t *task, isc_event_t *event) {
 	 * If they don't then back out all changes to DNSKEY/NSEC3PARAM
 	 * records.
 	 */
-	if (!ISC_LIST_EMPTY(diff.tuples)) {
-		CHECK(check_dnssec(client, zone, db, ver, &diff));
+	if (!ISC_LIST_EMPTY(diff->tuples)) {
+		CHECK(check_dnssec(client, zone, db, ver, diff));
 	}
 
-	if (!ISC_LIST_EMPTY(diff.tuples)) {
+	if (!ISC_LIST_EMPTY(diff->tuples)) {
 		unsigned int errors = 0;
 		CHECK(dns_zone_nscheck(zone, db, ver, &errors));
 		if (errors != 0) {
@@ -3347,7 +3413,7 @@ update_action(isc_task_t *task, isc_event_t *event) {
 			goto failure;
 		}
 	}
-	if (!ISC_LIST_EMPTY(diff.tuples)) {
+	if (!ISC_LIST_EMPTY(diff->tuples)) {
 		result = dns_zone_cdscheck(zone, db, ver);
 		if (result == DNS_R_BADCDS || result == DNS_R_BADCDNSKEY) {
 			update_log(client, zone, LOGLEVEL_PROTOCOL,
@@ -3361,262 +3427,462 @@ update_action(isc_task_t *task, isc_event_t *event) {
 		}
 	}
 
+	if (!ISC_LIST_EMPTY(diff->tuples)) {
+		CHECK(check_mx(client, zone, db, ver, diff));
+
+		CHECK(remove_orphaned_ds(db, ver, diff));
+
+		CHECK(rrset_exists(db, ver, zonename, dns_rdatatype_dnskey, 0,
+				   &has_dnskey));
+
+		if (!ALLOW_SECURE_TO_INSECURE(zone) && had_dnskey &&
+		    !has_dnskey) {
+			update_log(client, zone, LOGLEVEL_PROTOCOL,
+				   "update rejected: all DNSKEY "
+				   "records removed and "
+				   "'dnssec-secure-to-insecure' "
+				   "not set");
+			FAIL(DNS_R_REFUSED);
+		}
+
+		CHECK(check_maxrecords(client, zone, db, ver));
+	}
+
+	result = ISC_R_SUCCESS;
+
+failure:
+	dns_diff_clear(&temp);
+
+	if (rules != NULL) {
+		isc_mem_put(mctx, rules, sizeof(*rules) * ruleslen);
+	}
+
+	return (result);
+}
+
+/*%
+ * Commit 'diff', the changes made to '*verp' by one or more UPDATE
+ * requests: increment the SOA serial unless one of them changed it,
+ * update the DNSSEC records, write the changes to the journal as one
+ * transaction and close '*verp'.  'oldver' is the version of the zone
+ * that '*verp' was opened from.  'client' is used for logging only.
+ */
+static isc_result_t
+update_commit(ns_client_t *client, dns_zone_t *zone, dns_db_t *db,
+	      dns_dbversion_t *oldver, dns_dbversion_t **verp,
+	      dns_diff_t *diff, bool soa_serial_changed) {
+	isc_result_t result;
+	isc_mem_t *mctx = diff->mctx;
+	dns_dbversion_t *ver = *verp;
+	dns_name_t *zonename = dns_db_origin(db);
+	dns_rdatatype_t privatetype = dns_zone_getprivatetype(zone);
+	dns_difftuple_t *tuple;
+	dns_rdata_dnskey_t dnskey;
+	bool had_dnskey, has_dnskey;
+	char *journalfile;
+
+	if (ISC_LIST_EMPTY(diff->tuples)) {
+		update_log(client, zone, LOGLEVEL_DEBUG, "redundant request");
+		dns_db_closeversion(db, verp, true);
+		return (ISC_R_SUCCESS);
+	}
+
 	/*
-	 * If any changes were made, increment the SOA serial number,
-	 * update RRSIGs and NSECs (if zone is secure), and write the update
-	 * to the journal.
+	 * Increment the SOA serial, but only if it was not
+	 * changed as a result of an update operation.
 	 */
-	if (!ISC_LIST_EMPTY(diff.tuples)) {
-		char *journalfile;
-		dns_journal_t *journal;
-		bool has_dnskey;
+	if (!soa_serial_changed) {
+		CHECK(update_soa_serial(db, ver, diff, mctx,
+					dns_zone_getserialupdatemethod(zone)));
+	}
+
+	CHECK(rrset_exists(db, ver, zonename, dns_rdatatype_dnskey, 0,
+			   &has_dnskey));
+	CHECK(rrset_exists(db, oldver, zonename, dns_rdatatype_dnskey, 0,
+			   &had_dnskey));
+
+	CHECK(rollback_private(db, privatetype, ver, diff));
+
+	CHECK(add_signing_records(db, privatetype, ver, diff));
 
+	CHECK(add_nsec3param_records(client, zone, db, ver, diff));
+
+	if (had_dnskey && !has_dnskey) {
 		/*
-		 * Increment the SOA serial, but only if it was not
-		 * changed as a result of an update operation.
+		 * We are transitioning from secure to insecure.
+		 * Cause all NSEC3 chains to be deleted.  When the
+		 * the last signature for the DNSKEY records are
+		 * remove any NSEC chain present will also be removed.
 		 */
-		if (!soa_serial_changed) {
-			CHECK(update_soa_serial(
-				db, ver, &diff, mctx,
-				dns_zone_getserialupdatemethod(zone)));
+		CHECK(dns_nsec3param_deletechains(db, ver, zone, true,
+						  diff));
+	} else if (has_dnskey && isdnssec(db, ver, privatetype)) {
+		dns_update_log_t log;
+		uint32_t interval =
+			dns_zone_getsigvalidityinterval(zone);
+
+		log.func = update_log_cb;
+		log.arg = client;
+		result = dns_update_signatures(&log, zone, db, oldver,
+					       ver, diff, interval);
+
+		if (result != ISC_R_SUCCESS) {
+			update_log(client, zone, ISC_LOG_ERROR,
+				   "RRSIG/NSEC/NSEC3 update failed: %s",
+				   isc_result_totext(result));
+			goto failure;
 		}
+	}
 
-		CHECK(check_mx(client, zone, db, ver, &diff));
+	CHECK(check_maxrecords(client, zone, db, ver));
 
-		CHECK(remove_orphaned_ds(db, ver, &diff));
+	journalfile = dns_zone_getjournal(zone);
+	if (journalfile != NULL) {
+		update_log(client, zone, LOGLEVEL_DEBUG,
+			   "writing journal %s", journalfile);
 
-		CHECK(rrset_exists(db, ver, zonename, dns_rdatatype_dnskey, 0,
-				   &has_dnskey));
+		result = dns_zone_writejournal(zone, diff);
+		if (result != ISC_R_SUCCESS) {
+			FAILS(result, "journal write failed");
+		}
+	}
 
-#define ALLOW_SECURE_TO_INSECURE(zone) \
-	((dns_zone_getoptions(zone) & DNS_ZONEOPT_SECURETOINSECURE) != 0)
+	/*
+	 * XXXRTH  Just a note that this committing code will have
+	 *	   to change to handle databases that need two-phase
+	 *	   commit, but this isn't a priority.
+	 */
+	update_log(client, zone, LOGLEVEL_DEBUG,
+		   "committing update transaction");
 
-		CHECK(rrset_exists(db, oldver, zonename, dns_rdatatype_dnskey,
-				   0, &had_dnskey));
-		if (!ALLOW_SECURE_TO_INSECURE(zone)) {
-			if (had_dnskey && !has_dnskey) {
-				update_log(client, zone, LOGLEVEL_PROTOCOL,
-					   "update rejected: all DNSKEY "
-					   "records removed and "
-					   "'dnssec-secure-to-insecure' "
-					   "not set");
-				result = DNS_R_REFUSED;
-				goto failure;
-			}
+	dns_db_closeversion(db, verp, true);
+
+	/*
+	 * Mark the zone as dirty so that it will be written to disk.
+	 */
+	dns_zone_markdirty(zone);
+
+	/*
+	 * Notify secondaries of the change we just made.
+	 */
+	dns_zone_notify(zone);
+
+	/*
+	 * Cause the zone to be signed with the key that we
+	 * have just added or have the corresponding signatures
+	 * deleted.
+	 *
+	 * Note: we are already committed to this course of action.
+	 */
+	for (tuple = ISC_LIST_HEAD(diff->tuples); tuple != NULL;
+	     tuple = ISC_LIST_NEXT(tuple, link))
+	{
+		isc_region_t r;
+		dns_secalg_t algorithm;
+		uint16_t keyid;
+
+		if (tuple->rdata.type != dns_rdatatype_dnskey) {
+			continue;
 		}
 
-		CHECK(rollback_private(db, privatetype, ver, &diff));
+		dns_rdata_tostruct(&tuple->rdata, &dnskey, NULL);
+		if ((dnskey.flags &
+		     (DNS_KEYFLAG_OWNERMASK | DNS_KEYTYPE_NOAUTH)) !=
+		    DNS_KEYOWNER_ZONE)
+		{
+			continue;
+		}
 
-		CHECK(add_signing_records(db, privatetype, ver, &diff));
+		dns_rdata_toregion(&tuple->rdata, &r);
+		algorithm = dnskey.algorithm;
+		keyid = dst_region_computeid(&r);
 
-		CHECK(add_nsec3param_records(client, zone, db, ver, &diff));
+		result = dns_zone_signwithkey(
+			zone, algorithm, keyid,
+			(tuple->op == DNS_DIFFOP_DEL));
+		if (result != ISC_R_SUCCESS) {
+			update_log(client, zone, ISC_LOG_ERROR,
+				   "dns_zone_signwithkey failed: %s",
+				   isc_result_totext(result));
+		}
+	}
 
-		if (had_dnskey && !has_dnskey) {
-			/*
-			 * We are transitioning from secure to insecure.
-			 * Cause all NSEC3 chains to be deleted.  When the
-			 * the last signature for the DNSKEY records are
-			 * remove any NSEC chain present will also be removed.
-			 */
-			CHECK(dns_nsec3param_deletechains(db, ver, zone, true,
-							  &diff));
-		} else if (has_dnskey && isdnssec(db, ver, privatetype)) {
-			dns_update_log_t log;
-			uint32_t interval =
-				dns_zone_getsigvalidityinterval(zone);
-
-			log.func = update_log_cb;
-			log.arg = client;
-			result = dns_update_signatures(&log, zone, db, oldver,
-						       ver, &diff, interval);
+	/*
+	 * Cause the zone to add/delete NSEC3 chains for the
+	 * deferred NSEC3PARAM changes.
+	 *
+	 * Note: we are already committed to this course of action.
+	 */
+	for (tuple = ISC_LIST_HEAD(diff->tuples); tuple != NULL;
+	     tuple = ISC_LIST_NEXT(tuple, link))
+	{
+		unsigned char buf[DNS_NSEC3PARAM_BUFFERSIZE];
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		dns_rdata_nsec3param_t nsec3param;
 
-			if (result != ISC_R_SUCCESS) {
-				update_log(client, zone, ISC_LOG_ERROR,
-					   "RRSIG/NSEC/NSEC3 update failed: %s",
-					   isc_result_totext(result));
-				goto failure;
-			}
+		if (tuple->rdata.type != privatetype ||
+		    tuple->op != DNS_DIFFOP_ADD) {
+			continue;
 		}
 
-		maxrecords = dns_zone_getmaxrecords(zone);
-		if (maxrecords != 0U) {
-			result = dns_db_getsize(db, ver, &records, NULL);
-			if (result == ISC_R_SUCCESS && records > maxrecords) {
-				update_log(client, zone, ISC_LOG_ERROR,
-					   "records in zone (%" PRIu64 ") "
-					   "exceeds"
-					   " max-"
-					   "records"
-					   " (%u)",
-					   records, maxrecords);
-				result = DNS_R_TOOMANYRECORDS;
-				goto failure;
-			}
+		if (!dns_nsec3param_fromprivate(&tuple->rdata, &rdata,
+						buf, sizeof(buf))) {
+			continue;
+		}
+		dns_rdata_tostruct(&rdata, &nsec3param, NULL);
+		if (nsec3param.flags == 0) {
+			continue;
+		}
+
+		result = dns_zone_addnsec3chain(zone, &nsec3param);
+		if (result != ISC_R_SUCCESS) {
+			update_log(client, zone, ISC_LOG_ERROR,
+				   "dns_zone_addnsec3chain failed: %s",
+				   isc_result_totext(result));
 		}
+	}
 
-		journalfile = dns_zone_getjournal(zone);
-		if (journalfile != NULL) {
-			update_log(client, zone, LOGLEVEL_DEBUG,
-				   "writing journal %s", journalfile);
+	return (ISC_R_SUCCESS);
 
-			journal = NULL;
-			result = dns_journal_open(mctx, journalfile,
-						  DNS_JOURNAL_CREATE, &journal);
-			if (result != ISC_R_SUCCESS) {
-				FAILS(result, "journal open failed");
-			}
+failure:
+	/*
+	 * The reason for failure should have been logged at this point.
+	 */
+	update_log(client, zone, LOGLEVEL_DEBUG, "rolling back");
+	dns_db_closeversion(db, verp, false);
+	return (result);
+}
 
-			result = dns_journal_write_transaction(journal, &diff);
-			if (result != ISC_R_SUCCESS) {
-				dns_journal_destroy(&journal);
-				FAILS(result, "journal write failed");
-			}
+/*%
+ * Report the result of the UPDATE request in 'uev' to its client, once
+ * the journal transaction it is part of has reached stable storage.
+ */
+static void
+update_done(dns_zone_t *zone, update_event_t *uev, isc_result_t result) {
+	ns_client_t *client = (ns_client_t *)uev->ev_arg;
+	isc_event_t *event = (isc_event_t *)uev;
+
+	uev->result = result;
+	uev->ev_type = DNS_EVENT_UPDATEDONE;
+	uev->ev_action = updatedone_action;
+
+	/*
+	 * Don't respond before the journal has reached stable storage.
+	 */
+	dns_zone_sendafterjournal(zone, client->manager->task, &event,
+				  &uev->result);
+	INSIST(event == NULL);
+}
+
+/*%
+ * Back out the changes in 'diff' from version 'ver' of 'db'.
+ */
+static isc_result_t
+update_undo(dns_diff_t *diff, dns_db_t *db, dns_dbversion_t *ver) {
+	isc_result_t result;
+	dns_diff_t undo;
+
+	dns_diff_init(diff->mctx, &undo);
+	for (dns_difftuple_t *tuple = ISC_LIST_TAIL(diff->tuples);
+	     tuple != NULL; tuple = ISC_LIST_PREV(tuple, link))
+	{
+		dns_difftuple_t *inverse = NULL;
+
+		dns_difftuple_create(diff->mctx,
+				     tuple->op == DNS_DIFFOP_ADD
+					     ? DNS_DIFFOP_DEL
+					     : DNS_DIFFOP_ADD,
+				     &tuple->name, tuple->ttl, &tuple->rdata,
+				     &inverse);
+		dns_diff_append(&undo, &inverse);
+	}
+
+	result = dns_diff_apply(&undo, db, ver);
+	dns_diff_clear(&undo);
+
+	return (result);
+}
+
+/*%
+ * Process the UPDATE requests in 'events', in order.  Requests are
+ * applied to one new version of the zone database, each one seeing the
+ * changes made by the requests before it, and the version is committed
+ * with a single journal transaction once all of them have been applied.
+ * A request that fails has its own changes backed out of the version
+ * and does not affect the others.
+ *
+ * Signed zones need their signatures updated for every transaction, so
+ * a batch ends after each request that finds the zone signed.
+ */
+static void
+update_batch(isc_mem_t *mctx, dns_zone_t *zone, update_eventlist_t *events) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_ssutable_t *ssutable = NULL;
+	dns_name_t *zonename = NULL;
+	update_event_t *uev = NULL;
 
-			dns_journal_destroy(&journal);
+	result = dns_zone_getdb(zone, &db);
+	if (result != ISC_R_SUCCESS) {
+		while ((uev = ISC_LIST_HEAD(*events)) != NULL) {
+			ISC_LIST_UNLINK(*events, uev, ev_link);
+			update_done(zone, uev, result);
 		}
+		return;
+	}
 
-		/*
-		 * XXXRTH  Just a note that this committing code will have
-		 *	   to change to handle databases that need two-phase
-		 *	   commit, but this isn't a priority.
-		 */
-		update_log(client, zone, LOGLEVEL_DEBUG,
-			   "committing update transaction");
+	zonename = dns_db_origin(db);
+	dns_zone_getssutable(zone, &ssutable);
 
-		dns_db_closeversion(db, &ver, true);
+	while (!ISC_LIST_EMPTY(*events)) {
+		update_eventlist_t applied;
+		update_event_t *tail = NULL;
+		dns_dbversion_t *oldver = NULL;
+		dns_dbversion_t *ver = NULL;
+		dns_diff_t diff; /* Pending updates. */
+		bool soa_serial_changed = false;
+		bool secure = false;
 
-		/*
-		 * Mark the zone as dirty so that it will be written to disk.
-		 */
-		dns_zone_markdirty(zone);
+		ISC_LIST_INIT(applied);
+		dns_diff_init(mctx, &diff);
 
-		/*
-		 * Notify secondaries of the change we just made.
-		 */
-		dns_zone_notify(zone);
+		dns_db_currentversion(db, &oldver);
+		result = dns_db_newversion(db, &ver);
 
-		/*
-		 * Cause the zone to be signed with the key that we
-		 * have just added or have the corresponding signatures
-		 * deleted.
-		 *
-		 * Note: we are already committed to this course of action.
-		 */
-		for (tuple = ISC_LIST_HEAD(diff.tuples); tuple != NULL;
-		     tuple = ISC_LIST_NEXT(tuple, link))
+		while (result == ISC_R_SUCCESS && !secure &&
+		       (uev = ISC_LIST_HEAD(*events)) != NULL)
 		{
-			isc_region_t r;
-			dns_secalg_t algorithm;
-			uint16_t keyid;
-
-			if (tuple->rdata.type != dns_rdatatype_dnskey) {
-				continue;
+			ns_client_t *client = (ns_client_t *)uev->ev_arg;
+			isc_result_t uresult;
+			dns_diff_t udiff;
+			bool changed = false;
+
+			ISC_LIST_UNLINK(*events, uev, ev_link);
+			dns_diff_init(mctx, &udiff);
+
+			uresult = update_apply(client, zone, db, ver, ssutable,
+					       &udiff, &changed);
+			if (uresult != ISC_R_SUCCESS &&
+			    !ISC_LIST_EMPTY(udiff.tuples)) {
+				update_log(client, zone, LOGLEVEL_DEBUG,
+					   "rolling back");
+				result = update_undo(&udiff, db, ver);
 			}
 
-			dns_rdata_tostruct(&tuple->rdata, &dnskey, NULL);
-			if ((dnskey.flags &
-			     (DNS_KEYFLAG_OWNERMASK | DNS_KEYTYPE_NOAUTH)) !=
-			    DNS_KEYOWNER_ZONE)
-			{
-				continue;
-			}
+			if (uresult == ISC_R_SUCCESS) {
+				dns_difftuple_t *tuple = NULL;
 
-			dns_rdata_toregion(&tuple->rdata, &r);
-			algorithm = dnskey.algorithm;
-			keyid = dst_region_computeid(&r);
+				while ((tuple = ISC_LIST_HEAD(udiff.tuples)) !=
+				       NULL) {
+					ISC_LIST_UNLINK(udiff.tuples, tuple,
+							link);
+					dns_diff_appendminimal(&diff, &tuple);
+				}
+				soa_serial_changed |= changed;
+				ISC_LIST_APPEND(applied, uev, ev_link);
+			} else {
+				update_done(zone, uev, uresult);
+			}
+			dns_diff_clear(&udiff);
 
-			result = dns_zone_signwithkey(
-				zone, algorithm, keyid,
-				(tuple->op == DNS_DIFFOP_DEL));
-			if (result != ISC_R_SUCCESS) {
-				update_log(client, zone, ISC_LOG_ERROR,
-					   "dns_zone_signwithkey failed: %s",
-					   isc_result_totext(result));
+			if (result == ISC_R_SUCCESS) {
+				result = rrset_exists(db, ver, zonename,
+						      dns_rdatatype_dnskey, 0,
+						      &secure);
 			}
 		}
 
 		/*
-		 * Cause the zone to add/delete NSEC3 chains for the
-		 * deferred NSEC3PARAM changes.
-		 *
-		 * Note: we are already committed to this course of action.
+		 * Failed requests may already have been answered, so only
+		 * the clients of the applied ones can be logged against.
 		 */
-		for (tuple = ISC_LIST_HEAD(diff.tuples); tuple != NULL;
-		     tuple = ISC_LIST_NEXT(tuple, link))
-		{
-			unsigned char buf[DNS_NSEC3PARAM_BUFFERSIZE];
-			dns_rdata_t rdata = DNS_RDATA_INIT;
-			dns_rdata_nsec3param_t nsec3param;
-
-			if (tuple->rdata.type != privatetype ||
-			    tuple->op != DNS_DIFFOP_ADD) {
-				continue;
+		tail = ISC_LIST_TAIL(applied);
+		if (ver != NULL) {
+			if (result == ISC_R_SUCCESS) {
+				result = update_commit(
+					tail != NULL ? tail->ev_arg : NULL,
+					zone, db, oldver, &ver, &diff,
+					soa_serial_changed);
+			} else {
+				dns_db_closeversion(db, &ver, false);
 			}
+		}
+		INSIST(ver == NULL);
 
-			if (!dns_nsec3param_fromprivate(&tuple->rdata, &rdata,
-							buf, sizeof(buf))) {
-				continue;
-			}
-			dns_rdata_tostruct(&rdata, &nsec3param, NULL);
-			if (nsec3param.flags == 0) {
-				continue;
+		/*
+		 * Without a version to apply it to, the next request
+		 * fails on its own.
+		 */
+		if (ISC_LIST_EMPTY(applied) && result != ISC_R_SUCCESS) {
+			uev = ISC_LIST_HEAD(*events);
+			if (uev != NULL) {
+				ISC_LIST_UNLINK(*events, uev, ev_link);
+				ISC_LIST_APPEND(applied, uev, ev_link);
 			}
+		}
 
-			result = dns_zone_addnsec3chain(zone, &nsec3param);
-			if (result != ISC_R_SUCCESS) {
-				update_log(client, zone, ISC_LOG_ERROR,
-					   "dns_zone_addnsec3chain failed: %s",
-					   isc_result_totext(result));
-			}
+		while ((uev = ISC_LIST_HEAD(applied)) != NULL) {
+			ISC_LIST_UNLINK(applied, uev, ev_link);
+			update_done(zone, uev, result);
 		}
-	} else {
-		update_log(client, zone, LOGLEVEL_DEBUG, "redundant request");
-		dns_db_closeversion(db, &ver, true);
+
+		dns_diff_clear(&diff);
+		dns_db_closeversion(db, &oldver, false);
 	}
-	result = ISC_R_SUCCESS;
-	goto common;
 
-failure:
-	/*
-	 * The reason for failure should have been logged at this point.
-	 */
-	if (ver != NULL) {
-		update_log(client, zone, LOGLEVEL_DEBUG, "rolling back");
-		dns_db_closeversion(db, &ver, false);
+	if (ssutable != NULL) {
+		dns_ssutable_detach(&ssutable);
 	}
+	dns_db_detach(&db);
+}
 
-common:
-	dns_diff_clear(&temp);
-	dns_diff_clear(&diff);
+/*%
+ * Drain the queue of UPDATE requests for a zone, at most
+ * UPDATE_BATCH_MAX requests at a time.  Other zone events get to run
+ * between batches.
+ */
+static void
+update_action(isc_task_t *task, isc_event_t *event) {
+	update_queue_t *queue = (update_queue_t *)event->ev_arg;
+	ns_server_t *sctx = queue->sctx;
+	update_eventlist_t batch;
+	isc_result_t result;
+	bool last;
 
-	if (oldver != NULL) {
-		dns_db_closeversion(db, &oldver, false);
-	}
+	INSIST(event->ev_type == DNS_EVENT_UPDATE);
 
-	if (db != NULL) {
-		dns_db_detach(&db);
-	}
+	ISC_LIST_INIT(batch);
 
-	if (rules != NULL) {
-		isc_mem_put(mctx, rules, sizeof(*rules) * ruleslen);
+	LOCK(&sctx->updatelock);
+	for (size_t i = 0; i < UPDATE_BATCH_MAX; i++) {
+		update_event_t *uev = ISC_LIST_HEAD(queue->events);
+		if (uev == NULL) {
+			break;
+		}
+		ISC_LIST_UNLINK(queue->events, uev, ev_link);
+		ISC_LIST_APPEND(batch, uev, ev_link);
 	}
-
-	if (ssutable != NULL) {
-		dns_ssutable_detach(&ssutable);
+	last = ISC_LIST_EMPTY(queue->events);
+	if (last) {
+		result = isc_ht_delete(sctx->updatequeues,
+				       (const uint8_t *)&queue->zone,
+				       sizeof(queue->zone));
+		INSIST(result == ISC_R_SUCCESS);
 	}
+	UNLOCK(&sctx->updatelock);
 
-	isc_task_detach(&task);
-	uev->result = result;
-	if (zone != NULL) {
-		INSIST(uev->zone == zone); /* we use this later */
-	}
-	uev->ev_type = DNS_EVENT_UPDATEDONE;
-	uev->ev_action = updatedone_action;
+	update_batch(sctx->mctx, queue->zone, &batch);
 
-	isc_task_send(client->manager->task, &event);
+	if (!last) {
+		isc_task_send(task, &event);
+		return;
+	}
 
-	INSIST(ver == NULL);
-	INSIST(event == NULL);
+	dns_zone_detach(&queue->zone);
+	isc_mem_put(sctx->mctx, queue, sizeof(*queue));
+	ns_server_detach(&sctx);
+	isc_event_free(&event);
+	isc_task_detach(&task);
 }
 
 static void
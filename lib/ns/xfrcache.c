@@ -0,0 +1,412 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/list.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/refcount.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+
+#include <ns/xfrcache.h>
+
+struct ns_xfrstream {
+	unsigned int magic;
+	isc_refcount_t references;
+	isc_mem_t *mctx;
+	ns_xfrcache_t *cache;
+	ISC_LINK(ns_xfrstream_t) link;
+
+	dns_zone_t *zone; /*%< Only compared, not attached */
+	dns_db_t *db;
+	dns_dbversion_t *version;
+	dns_rdatatype_t type;
+	uint32_t begin_serial; /*%< IXFR only */
+	unsigned int firstrrs;
+
+	/* Locked by cache->lock. */
+	bool linked;
+	bool complete;
+	ns_xfrmsg_t **msgs;
+	unsigned int nmsgs;
+	unsigned int allocated;
+	size_t size;
+};
+
+struct ns_xfrcache {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	isc_mutex_t lock;
+
+	/* Locked by 'lock'. */
+	size_t maxsize;
+	size_t size;
+	ISC_LIST(ns_xfrstream_t) streams; /*%< Least recently used first */
+};
+
+#define XFRCACHE_MAGIC	  ISC_MAGIC('X', 'f', 'r', 'C')
+#define VALID_XFRCACHE(c) ISC_MAGIC_VALID(c, XFRCACHE_MAGIC)
+
+#define XFRSTREAM_MAGIC	   ISC_MAGIC('X', 'f', 'r', 'S')
+#define VALID_XFRSTREAM(s) ISC_MAGIC_VALID(s, XFRSTREAM_MAGIC)
+
+typedef ISC_LIST(ns_xfrstream_t) xfrstreamlist_t;
+
+static bool
+xfrstream_match(ns_xfrstream_t *stream, dns_rdatatype_t type,
+		uint32_t begin_serial) {
+	return (stream->type == type && (type == dns_rdatatype_axfr ||
+					 stream->begin_serial == begin_serial));
+}
+
+void
+ns_xfrcache_create(isc_mem_t *mctx, ns_xfrcache_t **cachep) {
+	ns_xfrcache_t *cache = NULL;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	cache = isc_mem_get(mctx, sizeof(*cache));
+	*cache = (ns_xfrcache_t){ .magic = 0 };
+
+	isc_mem_attach(mctx, &cache->mctx);
+	isc_mutex_init(&cache->lock);
+	ISC_LIST_INIT(cache->streams);
+
+	cache->magic = XFRCACHE_MAGIC;
+
+	*cachep = cache;
+}
+
+/*
+ * Take 'stream' out of the cache and move the cache's reference to
+ * 'unlinked', to be detached once the lock is released.  Must be
+ * called with the cache locked.
+ */
+static void
+xfrcache_unlink(ns_xfrcache_t *cache, ns_xfrstream_t *stream,
+		xfrstreamlist_t *unlinked) {
+	INSIST(stream->linked);
+
+	ISC_LIST_UNLINK(cache->streams, stream, link);
+	stream->linked = false;
+	INSIST(cache->size >= stream->size);
+	cache->size -= stream->size;
+	ISC_LIST_APPEND(*unlinked, stream, link);
+}
+
+static void
+xfrcache_release(xfrstreamlist_t *unlinked) {
+	ns_xfrstream_t *stream = NULL;
+
+	while ((stream = ISC_LIST_HEAD(*unlinked)) != NULL) {
+		ISC_LIST_UNLINK(*unlinked, stream, link);
+		ns_xfrstream_detach(&stream);
+	}
+}
+
+void
+ns_xfrcache_destroy(ns_xfrcache_t **cachep) {
+	ns_xfrcache_t *cache = NULL;
+
+	REQUIRE(cachep != NULL && VALID_XFRCACHE(*cachep));
+
+	cache = *cachep;
+	*cachep = NULL;
+
+	ns_xfrcache_setmaxsize(cache, 0);
+	INSIST(cache->size == 0);
+
+	cache->magic = 0;
+	isc_mutex_destroy(&cache->lock);
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+void
+ns_xfrcache_setmaxsize(ns_xfrcache_t *cache, size_t maxsize) {
+	xfrstreamlist_t unlinked;
+	ns_xfrstream_t *stream = NULL;
+
+	REQUIRE(VALID_XFRCACHE(cache));
+
+	ISC_LIST_INIT(unlinked);
+
+	LOCK(&cache->lock);
+	cache->maxsize = maxsize;
+	while ((stream = ISC_LIST_HEAD(cache->streams)) != NULL) {
+		xfrcache_unlink(cache, stream, &unlinked);
+	}
+	UNLOCK(&cache->lock);
+
+	xfrcache_release(&unlinked);
+}
+
+isc_result_t
+ns_xfrcache_find(ns_xfrcache_t *cache, dns_zone_t *zone, dns_db_t *db,
+		 dns_dbversion_t *version, dns_rdatatype_t type,
+		 uint32_t begin_serial, ns_xfrstream_t **streamp) {
+	ns_xfrstream_t *stream = NULL;
+
+	REQUIRE(VALID_XFRCACHE(cache));
+	REQUIRE(zone != NULL && db != NULL && version != NULL);
+	REQUIRE(type == dns_rdatatype_axfr || type == dns_rdatatype_ixfr);
+	REQUIRE(streamp != NULL && *streamp == NULL);
+
+	LOCK(&cache->lock);
+	for (stream = ISC_LIST_HEAD(cache->streams); stream != NULL;
+	     stream = ISC_LIST_NEXT(stream, link))
+	{
+		if (stream->zone == zone && stream->db == db &&
+		    stream->version == version &&
+		    xfrstream_match(stream, type, begin_serial))
+		{
+			ISC_LIST_UNLINK(cache->streams, stream, link);
+			ISC_LIST_APPEND(cache->streams, stream, link);
+			isc_refcount_increment(&stream->references);
+			*streamp = stream;
+			break;
+		}
+	}
+	UNLOCK(&cache->lock);
+
+	return (stream != NULL ? ISC_R_SUCCESS : ISC_R_NOTFOUND);
+}
+
+isc_result_t
+ns_xfrcache_start(ns_xfrcache_t *cache, dns_zone_t *zone, dns_db_t *db,
+		  dns_dbversion_t *version, dns_rdatatype_t type,
+		  uint32_t begin_serial, unsigned int firstrrs,
+		  ns_xfrstream_t **streamp) {
+	xfrstreamlist_t unlinked;
+	ns_xfrstream_t *stream = NULL, *next = NULL;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	REQUIRE(VALID_XFRCACHE(cache));
+	REQUIRE(zone != NULL && db != NULL && version != NULL);
+	REQUIRE(type == dns_rdatatype_axfr || type == dns_rdatatype_ixfr);
+	REQUIRE(streamp != NULL && *streamp == NULL);
+
+	ISC_LIST_INIT(unlinked);
+
+	LOCK(&cache->lock);
+	if (cache->maxsize == 0) {
+		result = ISC_R_DISABLED;
+		goto unlock;
+	}
+
+	/*
+	 * Keep the streams of one version per zone, so that older
+	 * versions of the zone are not held by the cache.  There may be
+	 * several for that version: one AXFR, and one IXFR per serial
+	 * the secondaries are at.
+	 */
+	for (stream = ISC_LIST_HEAD(cache->streams); stream != NULL;
+	     stream = next)
+	{
+		next = ISC_LIST_NEXT(stream, link);
+		if (stream->zone != zone) {
+			continue;
+		}
+		if (stream->db == db && stream->version == version) {
+			if (xfrstream_match(stream, type, begin_serial)) {
+				result = ISC_R_EXISTS;
+				goto unlock;
+			}
+			continue;
+		}
+		xfrcache_unlink(cache, stream, &unlinked);
+	}
+
+	stream = isc_mem_get(cache->mctx, sizeof(*stream));
+	*stream = (ns_xfrstream_t){
+		.cache = cache,
+		.zone = zone,
+		.type = type,
+		.begin_serial = begin_serial,
+		.firstrrs = firstrrs,
+		.linked = true,
+	};
+	ISC_LINK_INIT(stream, link);
+	isc_mem_attach(cache->mctx, &stream->mctx);
+	dns_db_attach(db, &stream->db);
+	dns_db_attachversion(db, version, &stream->version);
+	isc_refcount_init(&stream->references, 2);
+	stream->magic = XFRSTREAM_MAGIC;
+
+	ISC_LIST_APPEND(cache->streams, stream, link);
+	*streamp = stream;
+
+unlock:
+	UNLOCK(&cache->lock);
+
+	xfrcache_release(&unlinked);
+
+	return (result);
+}
+
+isc_result_t
+ns_xfrstream_add(ns_xfrstream_t *stream, const isc_region_t *wire,
+		 unsigned int nrrs, bool last) {
+	ns_xfrcache_t *cache = NULL;
+	xfrstreamlist_t unlinked;
+	ns_xfrstream_t *victim = NULL, *next = NULL;
+	ns_xfrmsg_t *msg = NULL;
+	size_t size;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	REQUIRE(VALID_XFRSTREAM(stream));
+	REQUIRE(wire != NULL);
+
+	cache = stream->cache;
+	size = sizeof(*msg) + wire->length;
+
+	ISC_LIST_INIT(unlinked);
+
+	LOCK(&cache->lock);
+	if (!stream->linked) {
+		result = ISC_R_CANCELED;
+		goto unlock;
+	}
+	INSIST(!stream->complete);
+
+	/*
+	 * Make room by discarding the least recently used streams; if
+	 * that is not enough, this one is too large to be cached.
+	 */
+	for (victim = ISC_LIST_HEAD(cache->streams);
+	     victim != NULL && cache->size + size > cache->maxsize;
+	     victim = next)
+	{
+		next = ISC_LIST_NEXT(victim, link);
+		if (victim != stream) {
+			xfrcache_unlink(cache, victim, &unlinked);
+		}
+	}
+	if (cache->size + size > cache->maxsize) {
+		xfrcache_unlink(cache, stream, &unlinked);
+		result = ISC_R_NOSPACE;
+		goto unlock;
+	}
+
+	msg = isc_mem_get(stream->mctx, size);
+	*msg = (ns_xfrmsg_t){
+		.wire.base = (unsigned char *)(msg + 1),
+		.wire.length = wire->length,
+		.nrrs = nrrs,
+		.last = last,
+	};
+	memmove(msg->wire.base, wire->base, wire->length);
+
+	if (stream->nmsgs == stream->allocated) {
+		unsigned int allocated = ISC_MAX(16, stream->allocated * 2);
+
+		stream->msgs = isc_mem_reget(
+			stream->mctx, stream->msgs,
+			stream->allocated * sizeof(stream->msgs[0]),
+			allocated * sizeof(stream->msgs[0]));
+		stream->allocated = allocated;
+	}
+	stream->msgs[stream->nmsgs++] = msg;
+	stream->size += size;
+	cache->size += size;
+	stream->complete = last;
+
+unlock:
+	UNLOCK(&cache->lock);
+
+	xfrcache_release(&unlinked);
+
+	return (result);
+}
+
+void
+ns_xfrstream_abandon(ns_xfrstream_t *stream) {
+	ns_xfrcache_t *cache = NULL;
+	xfrstreamlist_t unlinked;
+
+	REQUIRE(VALID_XFRSTREAM(stream));
+
+	cache = stream->cache;
+
+	ISC_LIST_INIT(unlinked);
+
+	LOCK(&cache->lock);
+	if (stream->linked && !stream->complete) {
+		xfrcache_unlink(cache, stream, &unlinked);
+	}
+	UNLOCK(&cache->lock);
+
+	xfrcache_release(&unlinked);
+}
+
+unsigned int
+ns_xfrstream_firstrrs(ns_xfrstream_t *stream) {
+	REQUIRE(VALID_XFRSTREAM(stream));
+
+	return (stream->firstrrs);
+}
+
+isc_result_t
+ns_xfrstream_get(ns_xfrstream_t *stream, unsigned int index,
+		 const ns_xfrmsg_t **msgp) {
+	isc_result_t result = ISC_R_NOTFOUND;
+
+	REQUIRE(VALID_XFRSTREAM(stream));
+	REQUIRE(msgp != NULL && *msgp == NULL);
+
+	LOCK(&stream->cache->lock);
+	if (index < stream->nmsgs) {
+		*msgp = stream->msgs[index];
+		result = ISC_R_SUCCESS;
+	}
+	UNLOCK(&stream->cache->lock);
+
+	return (result);
+}
+
+void
+ns_xfrstream_detach(ns_xfrstream_t **streamp) {
+	ns_xfrstream_t *stream = NULL;
+
+	REQUIRE(streamp != NULL && VALID_XFRSTREAM(*streamp));
+
+	stream = *streamp;
+	*streamp = NULL;
+
+	if (isc_refcount_decrement(&stream->references) == 1) {
+		INSIST(!stream->linked);
+		isc_refcount_destroy(&stream->references);
+		stream->magic = 0;
+
+		for (unsigned int i = 0; i < stream->nmsgs; i++) {
+			isc_mem_put(stream->mctx, stream->msgs[i],
+				    sizeof(*stream->msgs[i]) +
+					    stream->msgs[i]->wire.length);
+		}
+		if (stream->msgs != NULL) {
+			isc_mem_put(stream->mctx, stream->msgs,
+				    stream->allocated *
+					    sizeof(stream->msgs[0]));
+		}
+		dns_db_closeversion(stream->db, &stream->version, false);
+		dns_db_detach(&stream->db);
+		isc_mem_putanddetach(&stream->mctx, stream, sizeof(*stream));
+	}
+}
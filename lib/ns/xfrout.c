@@ -45,6 +45,7 @@
 #include <ns/log.h>
 #include <ns/server.h>
 #include <ns/stats.h>
+#include <ns/xfrcache.h>
 #include <ns/xfrout.h>
 
 /*! \file
@@ -675,6 +676,15 @@ typedef struct {
 	isc_nm_timer_t *maxtime_timer;
 
 	uint64_t idletime; /*%< XFR idle timeout (in ms) */
+
+	/* Rendered AXFR and IXFR streams */
+	dns_rdatatype_t cachetype; /*%< Transfer the stream is for */
+	uint32_t begin_serial;	   /*%< IXFR: serial of the client */
+	bool cacheable;		   /*%< May produce a stream */
+	ns_xfrstream_t *producing; /*%< Stream being stored */
+	ns_xfrstream_t *cached;	   /*%< Stream being replayed */
+	unsigned int cachemsg;	   /*%< Next message to replay */
+	unsigned int skiprrs;	   /*%< Records replayed so far */
 } xfrout_ctx_t;
 
 static void
@@ -1108,6 +1118,32 @@ have_stream:
 
 	CHECK(xfr->stream->methods->first(xfr->stream));
 
+	/*
+	 * Transfers of a zone version over TCP can replay the messages
+	 * rendered by an earlier transfer of the same version, or store
+	 * their own for later ones: full transfers (including AXFR-style
+	 * IXFR) share one stream, and incremental transfers one stream
+	 * per serial they start from, so that the secondaries catching
+	 * up after a change don't each read and render the journal.
+	 */
+	if (!is_poll && !is_dlz &&
+	    (client->attributes & NS_CLIENTATTR_TCP) != 0 &&
+	    xfr->many_answers)
+	{
+		xfr->cachetype = is_ixfr ? dns_rdatatype_ixfr
+					 : dns_rdatatype_axfr;
+		xfr->begin_serial = is_ixfr ? begin_serial : 0;
+		xfr->cacheable =
+			(ns_xfrcache_find(client->manager->sctx->xfrcache,
+					  zone, db, ver, xfr->cachetype,
+					  xfr->begin_serial,
+					  &xfr->cached) != ISC_R_SUCCESS);
+		if (xfr->cached != NULL) {
+			xfrout_log(xfr, ISC_LOG_DEBUG(1),
+				   "replaying rendered messages");
+		}
+	}
+
 	if (xfr->tsigkey != NULL) {
 		dns_name_format(&xfr->tsigkey->name, keyname, sizeof(keyname));
 	} else {
@@ -1287,6 +1323,59 @@ xfrout_ctx_create(isc_mem_t *mctx, ns_client_t *client, unsigned int id,
 	*xfrp = xfr;
 }
 
+/*
+ * Store the message just rendered into 'msg', up to the end of its
+ * answer section, in the stream of rendered messages of the zone
+ * version.  The stream is started after the first message, which
+ * carries the question, and is given up on when it does not fit.
+ *
+ * For a transfer replaying a stream, check that its own first
+ * message matches the one stored, and give up on replaying
+ * otherwise.
+ */
+static void
+xfrout_cache(xfrout_ctx_t *xfr, dns_message_t *msg) {
+	ns_server_t *sctx = xfr->client->manager->sctx;
+	unsigned int nrrs = msg->counts[DNS_SECTION_ANSWER];
+	isc_region_t r;
+
+	/*
+	 * Releasing a stream may close the database version it was
+	 * produced from, which cannot be done while our iterator holds
+	 * the database locks.
+	 */
+	xfr->stream->methods->pause(xfr->stream);
+
+	if (!msg->tcp_continuation) {
+		if (xfr->cached != NULL) {
+			if (xfr->end_of_stream ||
+			    nrrs != ns_xfrstream_firstrrs(xfr->cached))
+			{
+				ns_xfrstream_detach(&xfr->cached);
+			}
+		} else if (xfr->cacheable && !xfr->end_of_stream) {
+			(void)ns_xfrcache_start(sctx->xfrcache, xfr->zone,
+						xfr->db, xfr->ver,
+						xfr->cachetype,
+						xfr->begin_serial, nrrs,
+						&xfr->producing);
+		}
+		return;
+	}
+
+	if (xfr->producing == NULL) {
+		return;
+	}
+
+	isc_buffer_usedregion(&xfr->txbuf, &r);
+	isc_region_consume(&r, DNS_MESSAGE_HEADERLEN);
+	if (ns_xfrstream_add(xfr->producing, &r, nrrs, xfr->end_of_stream) !=
+	    ISC_R_SUCCESS)
+	{
+		ns_xfrstream_detach(&xfr->producing);
+	}
+}
+
 /*
  * Arrange to send as much as we can of "stream" without blocking.
  *
@@ -1306,6 +1395,7 @@ sendstream(xfrout_ctx_t *xfr) {
 	dns_rdatalist_t *msgrdl = NULL;
 	dns_rdataset_t *msgrds = NULL;
 	dns_compress_t cctx;
+	const ns_xfrmsg_t *cmsg = NULL;
 	bool cleanup_cctx = false;
 	bool is_tcp;
 	int n_rrs;
@@ -1412,6 +1502,30 @@ sendstream(xfrout_ctx_t *xfr) {
 		}
 	}
 
+	/*
+	 * Replay the next message of a cached stream if it has been
+	 * stored.  Otherwise, skip the records replayed so far in our
+	 * own stream and render the rest of the transfer.
+	 */
+	if (xfr->cached != NULL && msg->tcp_continuation) {
+		result = ns_xfrstream_get(xfr->cached, xfr->cachemsg, &cmsg);
+		if (result == ISC_R_SUCCESS) {
+			goto render;
+		}
+
+		xfrout_log(xfr, ISC_LOG_DEBUG(3),
+			   "cached stream ends after %u records", xfr->skiprrs);
+		xfr->stream->methods->pause(xfr->stream);
+		ns_xfrstream_detach(&xfr->cached);
+		for (; xfr->skiprrs > 0; xfr->skiprrs--) {
+			result = xfr->stream->methods->next(xfr->stream);
+			if (result == ISC_R_NOMORE) {
+				result = ISC_R_UNEXPECTED;
+			}
+			CHECK(result);
+		}
+	}
+
 	/*
 	 * Try to fit in as many RRs as possible, unless "one-answer"
 	 * format has been requested.
@@ -1510,6 +1624,16 @@ sendstream(xfrout_ctx_t *xfr) {
 		if (!xfr->many_answers) {
 			break;
 		}
+		/*
+		 * Stop where the first message of a cached stream did,
+		 * so that its other messages follow this one.
+		 */
+		if (xfr->cached != NULL &&
+		    (unsigned int)n_rrs + 1 >=
+			    ns_xfrstream_firstrrs(xfr->cached))
+		{
+			break;
+		}
 		/*
 		 * At this stage, at least 1 RR has been rendered into
 		 * the message. Check if we want to clamp this message
@@ -1523,14 +1647,30 @@ sendstream(xfrout_ctx_t *xfr) {
 		}
 	}
 
+render:
 	if (is_tcp) {
 		isc_region_t used;
 		CHECK(dns_compress_init(&cctx, xfr->mctx));
 		dns_compress_setsensitive(&cctx, true);
 		cleanup_cctx = true;
 		CHECK(dns_message_renderbegin(msg, &cctx, &xfr->txbuf));
-		CHECK(dns_message_rendersection(msg, DNS_SECTION_QUESTION, 0));
-		CHECK(dns_message_rendersection(msg, DNS_SECTION_ANSWER, 0));
+		if (cmsg != NULL) {
+			unsigned int counts[DNS_SECTION_MAX] = {
+				[DNS_SECTION_ANSWER] = cmsg->nrrs,
+			};
+
+			CHECK(dns_message_renderwire(msg, &cmsg->wire, counts));
+			xfr->cachemsg++;
+			xfr->skiprrs += cmsg->nrrs;
+			xfr->stats.nrecs += cmsg->nrrs;
+			xfr->end_of_stream = cmsg->last;
+		} else {
+			CHECK(dns_message_rendersection(
+				msg, DNS_SECTION_QUESTION, 0));
+			CHECK(dns_message_rendersection(msg, DNS_SECTION_ANSWER,
+							0));
+			xfrout_cache(xfr, msg);
+		}
 		CHECK(dns_message_renderend(msg));
 		dns_compress_invalidate(&cctx);
 		cleanup_cctx = false;
@@ -1600,6 +1740,15 @@ xfrout_ctx_destroy(xfrout_ctx_t **xfrp) {
 	if (xfr->stream != NULL) {
 		xfr->stream->methods->destroy(&xfr->stream);
 	}
+	if (xfr->producing != NULL) {
+		if (!xfr->end_of_stream) {
+			ns_xfrstream_abandon(xfr->producing);
+		}
+		ns_xfrstream_detach(&xfr->producing);
+	}
+	if (xfr->cached != NULL) {
+		ns_xfrstream_detach(&xfr->cached);
+	}
 	if (xfr->buf.base != NULL) {
 		isc_mem_put(xfr->mctx, xfr->buf.base, xfr->buf.length);
 	}
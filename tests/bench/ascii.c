@@ -17,6 +17,7 @@
 #include <string.h>
 
 #include <isc/ascii.h>
+#include <isc/cpu.h>
 #include <isc/random.h>
 #include <isc/time.h>
 
@@ -188,6 +189,17 @@ int
 main(void) {
 	static uint8_t bytes[SIZE];
 
+	/* ISC_CPU_DISABLE=all runs the generic kernels */
+	printf("cpu features:");
+	for (uint32_t feature = 1; (feature & ISC_CPU_ALL) != 0;
+	     feature <<= 1)
+	{
+		if (isc_cpu_has(feature)) {
+			printf(" %s", isc_cpu_featurename(feature));
+		}
+	}
+	printf("\n");
+
 	isc_random_buf(bytes, SIZE);
 
 	static uint8_t raw_dest[SIZE];
@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Replay a stream of query names against a size-limited cache database
+ * once with each eviction policy and compare the hit rates.
+ *
+ * The names are read one per line from a file, such as the output of
+ * "dnstap-read" or "tshark" cut down to the query name ('#' starts a
+ * comment and anything after the first field is ignored).  Without a
+ * file, a synthetic stream is used: a Zipf-distributed set of popular
+ * names mixed with never-repeated random subdomains, as in a random
+ * subdomain attack.
+ *
+ * Every miss is filled with an A record whose TTL outlasts the run, so
+ * that only the eviction policy decides what is lost.
+ */
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <isc/buffer.h>
+#include <isc/mem.h>
+#include <isc/random.h>
+#include <isc/result.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+#include <dns/types.h>
+
+#define DEFAULT_CACHESIZE (8 * 1024 * 1024)
+#define DEFAULT_QUERIES	  1000000
+#define DEFAULT_POPULAR	  100000
+#define DEFAULT_ATTACK	  50
+#define DEFAULT_RATE	  1000
+
+static char **names = NULL;
+static size_t nnames = 0, names_size = 0;
+
+static void
+add_name(const char *text) {
+	if (nnames == names_size) {
+		names_size = names_size == 0 ? 1024 : names_size * 2;
+		names = realloc(names, names_size * sizeof(names[0]));
+		RUNTIME_CHECK(names != NULL);
+	}
+	names[nnames] = strdup(text);
+	RUNTIME_CHECK(names[nnames] != NULL);
+	nnames++;
+}
+
+static void
+read_names(const char *filename) {
+	char line[1024];
+	FILE *fp = fopen(filename, "r");
+
+	if (fp == NULL) {
+		perror(filename);
+		exit(1);
+	}
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		char *name = strtok(line, " \t\r\n");
+		if (name != NULL && name[0] != '#') {
+			add_name(name);
+		}
+	}
+
+	fclose(fp);
+}
+
+static double
+uniform(void) {
+	return ((double)isc_random32() / ((double)UINT32_MAX + 1.0));
+}
+
+static void
+make_names(size_t queries, size_t popular, unsigned int attack) {
+	double *cdf = malloc(popular * sizeof(cdf[0]));
+	double sum = 0.0;
+	char text[DNS_NAME_FORMATSIZE];
+
+	RUNTIME_CHECK(cdf != NULL);
+
+	/* Zipf with an exponent of 0.9, typical of resolver traffic */
+	for (size_t i = 0; i < popular; i++) {
+		sum += 1.0 / pow((double)(i + 1), 0.9);
+		cdf[i] = sum;
+	}
+
+	for (size_t q = 0; q < queries; q++) {
+		if (isc_random_uniform(100) < attack) {
+			snprintf(text, sizeof(text), "%08" PRIx32 "%08" PRIx32
+				 ".victim.example.",
+				 isc_random32(), isc_random32());
+		} else {
+			double u = uniform() * sum;
+			size_t lo = 0, hi = popular - 1;
+
+			while (lo < hi) {
+				size_t mid = (lo + hi) / 2;
+				if (cdf[mid] < u) {
+					lo = mid + 1;
+				} else {
+					hi = mid;
+				}
+			}
+			snprintf(text, sizeof(text), "host%zu.example%zu.com.",
+				 lo % 16, lo / 16);
+		}
+		add_name(text);
+	}
+
+	free(cdf);
+}
+
+static void
+water(void *arg, int mark) {
+	isc_mem_t *mctx = arg;
+
+	isc_mem_waterack(mctx, mark);
+}
+
+static void
+add_address(dns_db_t *db, const dns_name_t *name, isc_stdtime_t now) {
+	static unsigned char address[4] = { 192, 0, 2, 1 };
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_dbnode_t *node = NULL;
+	isc_result_t result;
+
+	rdata.data = address;
+	rdata.length = sizeof(address);
+	rdata.rdclass = dns_rdataclass_in;
+	rdata.type = dns_rdatatype_a;
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.ttl = 86400 * 30;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+
+	dns_rdataset_init(&rdataset);
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	rdataset.trust = dns_trust_answer;
+
+	result = dns_db_findnode(db, name, true, &node);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	result = dns_db_addrdataset(db, node, NULL, now, &rdataset, 0, NULL);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS || result == DNS_R_UNCHANGED);
+	dns_db_detachnode(db, &node);
+	dns_rdataset_disassociate(&rdataset);
+}
+
+static void
+replay(dns_evictionpolicy_t policy, const char *policyname, size_t cachesize,
+       unsigned int rate) {
+	isc_mem_t *mctx = NULL, *hmctx = NULL;
+	dns_db_t *db = NULL;
+	char *argv[1];
+	isc_stdtime_t now = 1000000000;
+	size_t hits = 0;
+	isc_time_t start, finish;
+	isc_result_t result;
+
+	isc_mem_create(&mctx);
+	isc_mem_create(&hmctx);
+	isc_mem_setwater(mctx, water, mctx, cachesize - (cachesize >> 3),
+			 cachesize - (cachesize >> 2));
+
+	argv[0] = (char *)hmctx;
+	result = dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 1, argv, &db);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	result = dns_db_setevictionpolicy(db, policy);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+	isc_time_now_hires(&start);
+
+	for (size_t i = 0; i < nnames; i++) {
+		dns_fixedname_t fixed, ffound;
+		dns_name_t *name = dns_fixedname_initname(&fixed);
+		dns_name_t *found = dns_fixedname_initname(&ffound);
+		dns_rdataset_t rdataset;
+
+		if (rate > 0 && i > 0 && i % rate == 0) {
+			now++;
+		}
+
+		if (dns_name_fromstring(name, names[i], 0, NULL) !=
+		    ISC_R_SUCCESS)
+		{
+			continue;
+		}
+
+		dns_rdataset_init(&rdataset);
+		result = dns_db_find(db, name, NULL, dns_rdatatype_a, 0, now,
+				     NULL, found, &rdataset, NULL);
+		if (dns_rdataset_isassociated(&rdataset)) {
+			dns_rdataset_disassociate(&rdataset);
+		}
+		if (result == ISC_R_SUCCESS) {
+			hits++;
+		} else {
+			add_address(db, name, now);
+		}
+	}
+
+	isc_time_now_hires(&finish);
+
+	printf("%-6s %10zu queries %10zu hits %6.2f%% hit rate %8.3f s\n",
+	       policyname, nnames, hits, 100.0 * hits / ISC_MAX(nnames, 1),
+	       isc_time_microdiff(&finish, &start) / 1000000.0);
+
+	dns_db_detach(&db);
+	isc_mem_clearwater(mctx);
+	isc_mem_detach(&hmctx);
+	isc_mem_detach(&mctx);
+}
+
+static void
+usage(void) {
+	fprintf(stderr,
+		"usage: cacheevict [-a attack%%] [-n queries] [-p popular] "
+		"[-r qps] [-s cachesize] [file]\n");
+	exit(1);
+}
+
+int
+main(int argc, char **argv) {
+	size_t cachesize = DEFAULT_CACHESIZE;
+	size_t queries = DEFAULT_QUERIES;
+	size_t popular = DEFAULT_POPULAR;
+	unsigned int attack = DEFAULT_ATTACK;
+	unsigned int rate = DEFAULT_RATE;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "a:n:p:r:s:")) != -1) {
+		switch (ch) {
+		case 'a':
+			attack = ISC_MIN(atoi(optarg), 100);
+			break;
+		case 'n':
+			queries = strtoul(optarg, NULL, 10);
+			break;
+		case 'p':
+			popular = ISC_MAX(strtoul(optarg, NULL, 10), 1);
+			break;
+		case 'r':
+			rate = strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			cachesize = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	if (argc > 1 || cachesize < 1024 * 1024) {
+		usage();
+	} else if (argc == 1) {
+		read_names(argv[0]);
+	} else {
+		make_names(queries, popular, attack);
+	}
+
+	/* The simulated clock ticks once per 'rate' queries */
+	replay(dns_evictionpolicy_lru, "lru", cachesize, rate);
+	replay(dns_evictionpolicy_sieve, "sieve", cachesize, rate);
+
+	for (size_t i = 0; i < nnames; i++) {
+		free(names[i]);
+	}
+	free(names);
+
+	return (0);
+}
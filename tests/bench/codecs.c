@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Measure the throughput of the base64, base32hex and hex encoders and
+ * decoders on chunks the size of typical DNSKEY and RRSIG rdata.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <isc/base32.h>
+#include <isc/base64.h>
+#include <isc/buffer.h>
+#include <isc/hex.h>
+#include <isc/random.h>
+#include <isc/region.h>
+#include <isc/result.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#define SIZE  (1024 * 1024)
+#define CHUNK 256
+
+typedef isc_result_t
+totext_fn(isc_region_t *source, int wordlength, const char *wordbreak,
+	  isc_buffer_t *target);
+
+typedef isc_result_t
+decode_fn(const char *cstr, isc_buffer_t *target);
+
+static uint8_t bytes[SIZE];
+static char text[SIZE / CHUNK][CHUNK * 2 + 1];
+static uint8_t decoded[CHUNK];
+
+static void
+report(const char *name, isc_time_t *start) {
+	isc_time_t finish;
+	uint64_t microseconds;
+
+	isc_time_now_hires(&finish);
+	microseconds = isc_time_microdiff(&finish, start);
+	printf("%f for %s\n", (double)microseconds / 1000000.0, name);
+}
+
+static void
+time_codec(totext_fn *totext, decode_fn *decode, const char *name) {
+	char label[64];
+	isc_time_t start;
+
+	isc_time_now_hires(&start);
+	for (size_t i = 0; i < SIZE / CHUNK; i++) {
+		isc_region_t source = { .base = bytes + i * CHUNK,
+					.length = CHUNK };
+		isc_buffer_t target;
+		isc_result_t result;
+
+		isc_buffer_init(&target, text[i], sizeof(text[i]) - 1);
+		result = totext(&source, 0, "", &target);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		text[i][isc_buffer_usedlength(&target)] = '\0';
+	}
+	snprintf(label, sizeof(label), "%s encode", name);
+	report(label, &start);
+
+	isc_time_now_hires(&start);
+	for (size_t i = 0; i < SIZE / CHUNK; i++) {
+		isc_buffer_t target;
+		isc_result_t result;
+
+		isc_buffer_init(&target, decoded, sizeof(decoded));
+		result = decode(text[i], &target);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		RUNTIME_CHECK(memcmp(decoded, bytes + i * CHUNK, CHUNK) == 0);
+	}
+	snprintf(label, sizeof(label), "%s decode", name);
+	report(label, &start);
+}
+
+int
+main(void) {
+	isc_random_buf(bytes, SIZE);
+
+	time_codec(isc_base64_totext, isc_base64_decodestring, "base64");
+	time_codec(isc_base32hex_totext, isc_base32hex_decodestring,
+		   "base32hex");
+	time_codec(isc_hex_totext, isc_hex_decodestring, "hex");
+
+	return (0);
+}
@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Measure how fast RRsets are added to a new zone database: through the
+ * loading callbacks, as zone files and transfers are, with the RRsets
+ * of each name in a row or with the names interleaved, and one at a
+ * time with dns_db_addrdataset() in a new version.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <isc/mem.h>
+#include <isc/result.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/callbacks.h>
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+#include <dns/types.h>
+
+#define DEFAULT_NAMES 200000
+#define NTYPES	      3
+
+typedef struct rrset {
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_rdatalist_t rdatalist;
+	dns_rdata_t rdata;
+	unsigned char data[16];
+} rrset_t;
+
+static rrset_t *rrsets = NULL;
+static size_t nrrsets = 0;
+
+static void
+make_rrsets(size_t names) {
+	nrrsets = names * NTYPES;
+	rrsets = calloc(nrrsets, sizeof(rrsets[0]));
+	RUNTIME_CHECK(rrsets != NULL);
+
+	for (size_t i = 0; i < nrrsets; i++) {
+		rrset_t *rrset = &rrsets[i];
+		size_t n = i / NTYPES;
+		char text[DNS_NAME_FORMATSIZE];
+		isc_result_t result;
+
+		snprintf(text, sizeof(text), "host%zu.sub%zu.example.",
+			 n % 64, n / 64);
+		rrset->name = dns_fixedname_initname(&rrset->fixed);
+		result = dns_name_fromstring(rrset->name, text, 0, NULL);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+		dns_rdatalist_init(&rrset->rdatalist);
+		rrset->rdatalist.rdclass = dns_rdataclass_in;
+		rrset->rdatalist.ttl = 3600;
+
+		dns_rdata_init(&rrset->rdata);
+		memmove(rrset->data, &n, sizeof(n));
+		switch (i % NTYPES) {
+		case 0:
+			rrset->rdatalist.type = dns_rdatatype_a;
+			rrset->rdata.length = 4;
+			break;
+		case 1:
+			rrset->rdatalist.type = dns_rdatatype_aaaa;
+			rrset->rdata.length = 16;
+			break;
+		default:
+			rrset->rdatalist.type = dns_rdatatype_txt;
+			rrset->data[0] = 8;
+			rrset->rdata.length = 9;
+			break;
+		}
+		rrset->rdata.data = rrset->data;
+		rrset->rdata.rdclass = dns_rdataclass_in;
+		rrset->rdata.type = rrset->rdatalist.type;
+		ISC_LIST_APPEND(rrset->rdatalist.rdata, &rrset->rdata, link);
+	}
+}
+
+/*
+ * Return the index of the i'th RRset to add: in a row for each name,
+ * or all the RRsets of the first type, then of the second and so on.
+ */
+static size_t
+order(size_t i, bool interleaved) {
+	size_t names = nrrsets / NTYPES;
+
+	if (!interleaved) {
+		return (i);
+	}
+	return ((i % names) * NTYPES + i / names);
+}
+
+static dns_db_t *
+create_db(isc_mem_t *mctx) {
+	dns_fixedname_t fixed;
+	dns_name_t *origin = dns_fixedname_initname(&fixed);
+	dns_db_t *db = NULL;
+	isc_result_t result;
+
+	result = dns_name_fromstring(origin, "example.", 0, NULL);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	result = dns_db_create(mctx, "rbt", origin, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+	return (db);
+}
+
+static void
+report(const char *what, isc_time_t *start) {
+	isc_time_t finish;
+	uint64_t usecs;
+
+	isc_time_now_hires(&finish);
+	usecs = ISC_MAX(isc_time_microdiff(&finish, start), 1);
+	printf("%-12s %10zu RRsets %8.3f s %10.0f RRsets/s\n", what, nrrsets,
+	       usecs / 1000000.0, nrrsets * 1000000.0 / usecs);
+}
+
+static void
+load(isc_mem_t *mctx, bool interleaved) {
+	dns_rdatacallbacks_t callbacks;
+	dns_db_t *db = create_db(mctx);
+	isc_time_t start;
+	isc_result_t result;
+
+	isc_time_now_hires(&start);
+
+	dns_rdatacallbacks_init(&callbacks);
+	result = dns_db_beginload(db, &callbacks);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	for (size_t i = 0; i < nrrsets; i++) {
+		rrset_t *rrset = &rrsets[order(i, interleaved)];
+		dns_rdataset_t rdataset;
+
+		dns_rdataset_init(&rdataset);
+		dns_rdatalist_tordataset(&rrset->rdatalist, &rdataset);
+		result = callbacks.add(callbacks.add_private, rrset->name,
+				       &rdataset);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		dns_rdataset_disassociate(&rdataset);
+	}
+	result = dns_db_endload(db, &callbacks);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+	report(interleaved ? "interleaved" : "grouped", &start);
+
+	dns_db_detach(&db);
+}
+
+static void
+addrdataset(isc_mem_t *mctx) {
+	dns_db_t *db = create_db(mctx);
+	dns_dbversion_t *version = NULL;
+	isc_time_t start;
+	isc_result_t result;
+
+	isc_time_now_hires(&start);
+
+	result = dns_db_newversion(db, &version);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	for (size_t i = 0; i < nrrsets; i++) {
+		rrset_t *rrset = &rrsets[i];
+		dns_rdataset_t rdataset;
+		dns_dbnode_t *node = NULL;
+
+		dns_rdataset_init(&rdataset);
+		dns_rdatalist_tordataset(&rrset->rdatalist, &rdataset);
+		result = dns_db_findnode(db, rrset->name, true, &node);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		result = dns_db_addrdataset(db, node, version, 0, &rdataset, 0,
+					    NULL);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		dns_db_detachnode(db, &node);
+		dns_rdataset_disassociate(&rdataset);
+	}
+	dns_db_closeversion(db, &version, true);
+
+	report("addrdataset", &start);
+
+	dns_db_detach(&db);
+}
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: dbload [-n names]\n");
+	exit(1);
+}
+
+int
+main(int argc, char **argv) {
+	size_t names = DEFAULT_NAMES;
+	isc_mem_t *mctx = NULL;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "n:")) != -1) {
+		switch (ch) {
+		case 'n':
+			names = ISC_MAX(strtoul(optarg, NULL, 10), 1);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc) {
+		usage();
+	}
+
+	isc_mem_create(&mctx);
+	make_rrsets(names);
+
+	load(mctx, false);
+	load(mctx, true);
+	addrdataset(mctx);
+
+	free(rrsets);
+	isc_mem_detach(&mctx);
+
+	return (0);
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Compare the chained isc_ht with the open-addressing isc_hashmap when
+ * adding, finding, missing and deleting keys the size of a fetch context
+ * key, starting from a small table so that both have to grow.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <isc/hashmap.h>
+#include <isc/ht.h>
+#include <isc/mem.h>
+#include <isc/random.h>
+#include <isc/result.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#define KEYSIZE 32
+
+typedef struct item {
+	uint8_t key[KEYSIZE];
+} item_t;
+
+static isc_mem_t *mctx = NULL;
+
+static void
+report(const char *impl, const char *name, size_t count, isc_time_t *start) {
+	isc_time_t finish;
+	uint64_t microseconds;
+
+	isc_time_now_hires(&finish);
+	microseconds = ISC_MAX(isc_time_microdiff(&finish, start), 1);
+	printf("%-8s %-8s %8zu %10.3f ms %8.1f ns/op\n", impl, name, count,
+	       microseconds / 1000.0, microseconds * 1000.0 / count);
+	*start = finish;
+}
+
+static void
+time_ht(item_t *items, item_t *missing, size_t count) {
+	isc_ht_t *ht = NULL;
+	isc_result_t result;
+	isc_time_t start;
+
+	isc_ht_init(&ht, mctx, 1, ISC_HT_CASE_SENSITIVE);
+
+	isc_time_now_hires(&start);
+	for (size_t i = 0; i < count; i++) {
+		result = isc_ht_add(ht, items[i].key, KEYSIZE, &items[i]);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+	report("ht", "add", count, &start);
+
+	for (size_t i = 0; i < count; i++) {
+		void *value = NULL;
+		result = isc_ht_find(ht, items[i].key, KEYSIZE, &value);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS && value == &items[i]);
+	}
+	report("ht", "find", count, &start);
+
+	for (size_t i = 0; i < count; i++) {
+		result = isc_ht_find(ht, missing[i].key, KEYSIZE, NULL);
+		RUNTIME_CHECK(result == ISC_R_NOTFOUND);
+	}
+	report("ht", "miss", count, &start);
+
+	for (size_t i = 0; i < count; i++) {
+		result = isc_ht_delete(ht, items[i].key, KEYSIZE);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+	report("ht", "delete", count, &start);
+
+	isc_ht_destroy(&ht);
+}
+
+static void
+time_hashmap(item_t *items, item_t *missing, size_t count) {
+	isc_hashmap_t *hashmap = NULL;
+	isc_result_t result;
+	isc_time_t start;
+
+	isc_hashmap_create(mctx, 1, ISC_HASHMAP_CASE_SENSITIVE, &hashmap);
+
+	isc_time_now_hires(&start);
+	for (size_t i = 0; i < count; i++) {
+		result = isc_hashmap_add(hashmap, items[i].key, KEYSIZE,
+					 &items[i]);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+	report("hashmap", "add", count, &start);
+
+	for (size_t i = 0; i < count; i++) {
+		void *value = NULL;
+		result = isc_hashmap_find(hashmap, items[i].key, KEYSIZE,
+					  &value);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS && value == &items[i]);
+	}
+	report("hashmap", "find", count, &start);
+
+	for (size_t i = 0; i < count; i++) {
+		result = isc_hashmap_find(hashmap, missing[i].key, KEYSIZE,
+					  NULL);
+		RUNTIME_CHECK(result == ISC_R_NOTFOUND);
+	}
+	report("hashmap", "miss", count, &start);
+
+	for (size_t i = 0; i < count; i++) {
+		result = isc_hashmap_delete(hashmap, items[i].key, KEYSIZE);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+	report("hashmap", "delete", count, &start);
+
+	isc_hashmap_destroy(&hashmap);
+}
+
+int
+main(void) {
+	isc_mem_create(&mctx);
+
+	for (size_t count = 1000; count <= 1000000; count *= 10) {
+		item_t *items = calloc(count, sizeof(items[0]));
+		item_t *missing = calloc(count, sizeof(missing[0]));
+
+		RUNTIME_CHECK(items != NULL && missing != NULL);
+
+		isc_random_buf(items, count * sizeof(items[0]));
+		isc_random_buf(missing, count * sizeof(missing[0]));
+
+		time_ht(items, missing, count);
+		time_hashmap(items, missing, count);
+
+		free(items);
+		free(missing);
+	}
+
+	isc_mem_destroy(&mctx);
+
+	return (0);
+}
@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Measure how fast names are read from wire format, with and without
+ * compression pointers and downcasing, and how fast they are compared
+ * case-insensitively.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <isc/buffer.h>
+#include <isc/result.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/compress.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+
+#define DEFAULT_NAMES 1000000
+#define WIRESIZE      16384 /* compression pointers are 14 bits */
+
+static dns_fixedname_t *lower = NULL;
+static dns_fixedname_t *upper = NULL;
+static size_t nnames = 0;
+
+/*
+ * The wire buffer holds each name uncompressed, followed by a name that
+ * shares its last two labels through a compression pointer.
+ */
+static unsigned char wire[WIRESIZE];
+static unsigned int wirelen = 0;
+static unsigned int wirenames = 0;
+
+static void
+make_names(size_t names) {
+	nnames = names;
+	lower = calloc(nnames, sizeof(lower[0]));
+	upper = calloc(nnames, sizeof(upper[0]));
+	RUNTIME_CHECK(lower != NULL && upper != NULL);
+
+	for (size_t i = 0; i < nnames; i++) {
+		char text[DNS_NAME_FORMATSIZE];
+		isc_result_t result;
+
+		snprintf(text, sizeof(text), "www%zu.host%zu.example.com.",
+			 i % 16, i);
+		dns_fixedname_initname(&lower[i]);
+		result = dns_name_fromstring(dns_fixedname_name(&lower[i]),
+					     text, 0, NULL);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+		snprintf(text, sizeof(text), "WWW%zu.Host%zu.EXAMPLE.com.",
+			 i % 16, i);
+		dns_fixedname_initname(&upper[i]);
+		result = dns_name_fromstring(dns_fixedname_name(&upper[i]),
+					     text, 0, NULL);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+
+	while (wirelen + 2 * DNS_NAME_MAXWIRE < sizeof(wire)) {
+		dns_name_t *name =
+			dns_fixedname_name(&upper[(wirenames / 2) % nnames]);
+		unsigned int start = wirelen;
+		unsigned int suffix;
+
+		memmove(wire + wirelen, name->ndata, name->length);
+		wirelen += name->length;
+		suffix = start + 1 + name->ndata[0];
+		suffix += 1 + name->ndata[suffix - start];
+		wire[wirelen++] = 4;
+		memmove(wire + wirelen, "mail", 4);
+		wirelen += 4;
+		wire[wirelen++] = 0xc0 | (suffix >> 8);
+		wire[wirelen++] = suffix & 0xff;
+		wirenames += 2;
+	}
+}
+
+static void
+report(const char *what, size_t count, isc_time_t *start) {
+	isc_time_t finish;
+	uint64_t usecs;
+
+	isc_time_now_hires(&finish);
+	usecs = ISC_MAX(isc_time_microdiff(&finish, start), 1);
+	printf("%-12s %10zu names %8.3f s %10.0f names/s\n", what, count,
+	       usecs / 1000000.0, count * 1000000.0 / usecs);
+}
+
+static void
+fromwire(const char *what, unsigned int options) {
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	isc_time_t start;
+	size_t count = 0;
+
+	isc_time_now_hires(&start);
+
+	while (count < nnames) {
+		isc_buffer_t source;
+
+		isc_buffer_init(&source, wire, wirelen);
+		isc_buffer_add(&source, wirelen);
+		for (unsigned int i = 0; i < wirenames; i++) {
+			isc_result_t result;
+
+			result = dns_name_fromwire(name, &source,
+						   DNS_DECOMPRESS_ALWAYS,
+						   options, NULL);
+			RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		}
+		count += wirenames;
+	}
+
+	report(what, count, &start);
+}
+
+static void
+equal(void) {
+	isc_time_t start;
+	size_t same = 0;
+
+	isc_time_now_hires(&start);
+
+	for (size_t i = 0; i < nnames; i++) {
+		if (dns_name_equal(dns_fixedname_name(&lower[i]),
+				   dns_fixedname_name(&upper[i])))
+		{
+			same++;
+		}
+	}
+
+	report("equal", nnames, &start);
+	RUNTIME_CHECK(same == nnames);
+}
+
+static void
+compare(void) {
+	isc_time_t start;
+	size_t ordered = 0;
+
+	isc_time_now_hires(&start);
+
+	for (size_t i = 1; i < nnames; i++) {
+		if (dns_name_compare(dns_fixedname_name(&upper[i - 1]),
+				     dns_fixedname_name(&lower[i])) != 0)
+		{
+			ordered++;
+		}
+	}
+
+	report("compare", nnames - 1, &start);
+	RUNTIME_CHECK(ordered == nnames - 1);
+}
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: names [-n names]\n");
+	exit(1);
+}
+
+int
+main(int argc, char **argv) {
+	size_t names = DEFAULT_NAMES;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "n:")) != -1) {
+		switch (ch) {
+		case 'n':
+			names = ISC_MAX(strtoul(optarg, NULL, 10), 2);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc) {
+		usage();
+	}
+
+	make_names(names);
+
+	fromwire("fromwire", 0);
+	fromwire("downcase", DNS_NAME_DOWNCASE);
+	equal();
+	compare();
+
+	free(lower);
+	free(upper);
+
+	return (0);
+}
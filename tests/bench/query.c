@@ -0,0 +1,875 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Measure the query path of libns without the network: pre-rendered
+ * queries are handed to ns__client_request() on every loop, exactly as
+ * the network manager would after reading them from a UDP socket, and
+ * the responses are counted and thrown away.
+ *
+ * The network manager handle functions are replaced by the ones below,
+ * in the same way as in tests/ns/netmgr_wrap.c, so that nothing but
+ * the query processing itself shows up in a profile; run with a large
+ * -n under "perf record -g" to get a flame graph of the query path.
+ *
+ * The workloads are answers from an authoritative zone, NXDOMAIN
+ * answers from the same zone, answers from the cache, and optionally
+ * the queries in a file in the "name type" format used by dnsperf,
+ * which are answered from whatever the zone or the cache holds.
+ *
+ * The results are printed as a JSON document, one object per workload.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <isc/barrier.h>
+#include <isc/buffer.h>
+#include <isc/loop.h>
+#include <isc/managers.h>
+#include <isc/mem.h>
+#include <isc/net.h>
+#include <isc/netmgr.h>
+#include <isc/os.h>
+#include <isc/random.h>
+#include <isc/result.h>
+#include <isc/sockaddr.h>
+#include <isc/stdtime.h>
+#include <isc/tid.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/cache.h>
+#include <dns/callbacks.h>
+#include <dns/compress.h>
+#include <dns/db.h>
+#include <dns/dispatch.h>
+#include <dns/fixedname.h>
+#include <dns/master.h>
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+#include <dns/rdatatype.h>
+#include <dns/view.h>
+#include <dns/zone.h>
+
+#include <ns/client.h>
+#include <ns/interfacemgr.h>
+#include <ns/server.h>
+
+#define DEFAULT_SIZE	100000
+#define DEFAULT_QUERIES 1000000 /* per loop */
+#define MAX_WORKLOADS	4
+#define AUTH_ORIGIN	"bench.example."
+#define CACHE_SUFFIX	"cache.example."
+
+#ifdef NETMGR_TRACE
+#define FLARG                                              \
+	, const char *file __attribute__((unused)),        \
+		unsigned int line __attribute__((unused)), \
+		const char *func __attribute__((unused))
+#else
+#define FLARG
+#endif
+
+/*
+ * A stand-in for a UDP handle of the network manager.  Each loop has
+ * one, which is reused for every query; a response is "sent" by
+ * remembering the send callback, which is run once ns__client_request()
+ * has returned, as it would be after the datagram had been written.
+ */
+struct isc_nmhandle {
+	unsigned int references;
+	void *opaque;
+	isc_nm_opaquecb_t doreset;
+	isc_nm_opaquecb_t dofree;
+	isc_sockaddr_t peer;
+	isc_sockaddr_t local;
+	isc_nm_cb_t sendcb;
+	void *sendcbarg;
+};
+
+/*
+ * A set of queries in wire format, packed one after the other.
+ */
+typedef struct queries {
+	const char *name;
+	unsigned char *wires;
+	size_t *offsets;
+	size_t count;
+	size_t alloc;
+	size_t used;
+	size_t size;
+} queries_t;
+
+typedef struct worker {
+	struct isc_nmhandle handle;
+	uint64_t responses;
+	uint64_t bytes;
+	uint64_t noerror;
+	uint64_t nxdomain;
+	uint64_t cpu_ns;
+	uint64_t cycles;
+} worker_t;
+
+static isc_mem_t *mctx = NULL;
+static isc_loopmgr_t *loopmgr = NULL;
+static isc_nm_t *netmgr = NULL;
+static isc_taskmgr_t *taskmgr = NULL;
+static dns_dispatchmgr_t *dispatchmgr = NULL;
+static ns_interfacemgr_t *interfacemgr = NULL;
+static ns_server_t *sctx = NULL;
+static dns_view_t *view = NULL;
+static dns_zone_t *zone = NULL;
+static ns_interface_t interface;
+
+static const char *filter = NULL;
+static queries_t workloads[MAX_WORKLOADS];
+static size_t nworkloads = 0;
+static size_t nqueries = DEFAULT_QUERIES;
+static uint32_t nloops = 0;
+static worker_t *workers = NULL;
+static isc_barrier_t barrier;
+static isc_time_t start;
+
+/*
+ * Network manager replacements.
+ */
+
+void
+isc__nmhandle_attach(isc_nmhandle_t *handle, isc_nmhandle_t **dest FLARG) {
+	REQUIRE(dest != NULL && *dest == NULL);
+
+	handle->references++;
+	*dest = handle;
+}
+
+void
+isc__nmhandle_detach(isc_nmhandle_t **handlep FLARG) {
+	isc_nmhandle_t *handle = *handlep;
+
+	*handlep = NULL;
+
+	INSIST(handle->references > 0);
+	if (--handle->references > 0) {
+		return;
+	}
+
+	if (handle->doreset != NULL) {
+		handle->doreset(handle->opaque);
+	}
+	if (handle->dofree != NULL) {
+		handle->dofree(handle->opaque);
+	}
+	handle->opaque = NULL;
+	handle->doreset = NULL;
+	handle->dofree = NULL;
+}
+
+void *
+isc_nmhandle_getdata(isc_nmhandle_t *handle) {
+	return (handle->opaque);
+}
+
+void
+isc_nmhandle_setdata(isc_nmhandle_t *handle, void *arg,
+		     isc_nm_opaquecb_t doreset, isc_nm_opaquecb_t dofree) {
+	handle->opaque = arg;
+	handle->doreset = doreset;
+	handle->dofree = dofree;
+}
+
+bool
+isc_nmhandle_is_stream(isc_nmhandle_t *handle) {
+	UNUSED(handle);
+
+	return (false);
+}
+
+isc_sockaddr_t
+isc_nmhandle_peeraddr(isc_nmhandle_t *handle) {
+	return (handle->peer);
+}
+
+isc_sockaddr_t
+isc_nmhandle_localaddr(isc_nmhandle_t *handle) {
+	return (handle->local);
+}
+
+isc_nm_t *
+isc_nmhandle_netmgr(isc_nmhandle_t *handle) {
+	UNUSED(handle);
+
+	return (netmgr);
+}
+
+void
+isc_nmhandle_keepalive(isc_nmhandle_t *handle, bool value) {
+	UNUSED(handle);
+	UNUSED(value);
+}
+
+void
+isc_nm_send(isc_nmhandle_t *handle, isc_region_t *region, isc_nm_cb_t cb,
+	    void *cbarg) {
+	worker_t *worker = &workers[isc_tid()];
+
+	INSIST(handle->sendcb == NULL);
+
+	worker->responses++;
+	worker->bytes += region->length;
+	if (region->length >= 4) {
+		switch (region->base[3] & 0x0f) {
+		case dns_rcode_noerror:
+			worker->noerror++;
+			break;
+		case dns_rcode_nxdomain:
+			worker->nxdomain++;
+			break;
+		}
+	}
+
+	handle->sendcb = cb;
+	handle->sendcbarg = cbarg;
+}
+
+void
+isc_nm_bad_request(isc_nmhandle_t *handle) {
+	UNUSED(handle);
+}
+
+bool
+isc_nm_is_http_handle(isc_nmhandle_t *handle) {
+	UNUSED(handle);
+
+	return (false);
+}
+
+void
+isc_nm_set_maxage(isc_nmhandle_t *handle, const uint32_t ttl) {
+	UNUSED(handle);
+	UNUSED(ttl);
+}
+
+bool
+isc_nm_has_encryption(const isc_nmhandle_t *handle) {
+	UNUSED(handle);
+
+	return (false);
+}
+
+isc_nmsocket_type
+isc_nm_socket_type(const isc_nmhandle_t *handle) {
+	UNUSED(handle);
+
+	return (isc_nm_udpsocket);
+}
+
+bool
+isc_nm_xfr_allowed(isc_nmhandle_t *handle) {
+	UNUSED(handle);
+
+	return (false);
+}
+
+/*
+ * Building the queries, the zone and the cache.
+ */
+
+static bool
+wanted(const char *name) {
+	return (filter == NULL || strstr(name, filter) != NULL);
+}
+
+static queries_t *
+new_workload(const char *name) {
+	queries_t *set = NULL;
+
+	INSIST(nworkloads < MAX_WORKLOADS);
+
+	set = &workloads[nworkloads++];
+	*set = (queries_t){ .name = name };
+
+	return (set);
+}
+
+static void
+append_wire(queries_t *set, const unsigned char *wire, size_t length) {
+	if (set->count + 1 >= set->alloc) {
+		set->alloc = ISC_MAX(set->alloc * 2, 1024);
+		set->offsets = realloc(set->offsets,
+				       set->alloc * sizeof(set->offsets[0]));
+		RUNTIME_CHECK(set->offsets != NULL);
+	}
+	while (set->used + length > set->size) {
+		set->size = ISC_MAX(set->size * 2, 65536);
+		set->wires = realloc(set->wires, set->size);
+		RUNTIME_CHECK(set->wires != NULL);
+	}
+
+	memmove(set->wires + set->used, wire, length);
+	set->offsets[set->count++] = set->used;
+	set->used += length;
+	set->offsets[set->count] = set->used;
+}
+
+/*
+ * Render a query for 'text'/'type' with an EDNS OPT record, as most
+ * resolvers send them, and add it to 'set'.
+ */
+static isc_result_t
+add_query(queries_t *set, const char *text, dns_rdatatype_t type, bool rd) {
+	dns_message_t *message = NULL;
+	dns_name_t *qname = NULL;
+	dns_rdataset_t *question = NULL;
+	dns_rdataset_t *opt = NULL;
+	unsigned char wire[512];
+	isc_buffer_t target;
+	dns_compress_t cctx;
+	isc_result_t result;
+
+	dns_message_create(mctx, DNS_MESSAGE_INTENTRENDER, &message);
+	message->opcode = dns_opcode_query;
+	message->rdclass = dns_rdataclass_in;
+	message->id = isc_random16();
+	message->flags = rd ? DNS_MESSAGEFLAG_RD : 0;
+
+	dns_message_gettempname(message, &qname);
+	result = dns_name_fromstring(qname, text, 0, mctx);
+	if (result != ISC_R_SUCCESS) {
+		dns_message_puttempname(message, &qname);
+		dns_message_detach(&message);
+		return (result);
+	}
+
+	dns_message_gettemprdataset(message, &question);
+	dns_rdataset_makequestion(question, dns_rdataclass_in, type);
+	ISC_LIST_APPEND(qname->list, question, link);
+	dns_message_addname(message, qname, DNS_SECTION_QUESTION);
+
+	result = dns_message_buildopt(message, &opt, 0, 1232, 0, NULL, 0);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	result = dns_message_setopt(message, opt);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+	dns_compress_init(&cctx, mctx);
+	isc_buffer_init(&target, wire, sizeof(wire));
+	result = dns_message_renderbegin(message, &cctx, &target);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	result = dns_message_rendersection(message, DNS_SECTION_QUESTION, 0);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	result = dns_message_renderend(message);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	dns_compress_invalidate(&cctx);
+
+	append_wire(set, wire, isc_buffer_usedlength(&target));
+
+	dns_message_detach(&message);
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+shuffle(queries_t *set) {
+	size_t *offsets = calloc(set->count + 1, sizeof(offsets[0]));
+	unsigned char *wires = malloc(ISC_MAX(set->used, 1));
+	size_t used = 0;
+
+	RUNTIME_CHECK(offsets != NULL && wires != NULL);
+
+	for (size_t i = 0; i < set->count; i++) {
+		offsets[i] = i;
+	}
+	for (size_t i = set->count; i > 1; i--) {
+		size_t j = isc_random_uniform(i);
+		size_t t = offsets[i - 1];
+
+		offsets[i - 1] = offsets[j];
+		offsets[j] = t;
+	}
+
+	/*
+	 * 'offsets' now holds a permutation of the query indices; copy
+	 * the queries in that order.
+	 */
+	for (size_t i = 0; i < set->count; i++) {
+		size_t q = offsets[i];
+		size_t length = set->offsets[q + 1] - set->offsets[q];
+
+		memmove(wires + used, set->wires + set->offsets[q], length);
+		offsets[i] = used;
+		used += length;
+	}
+	offsets[set->count] = used;
+
+	free(set->wires);
+	free(set->offsets);
+	set->wires = wires;
+	set->offsets = offsets;
+	set->alloc = set->count + 1;
+	set->size = ISC_MAX(used, 1);
+}
+
+static void
+make_zone(size_t size) {
+	dns_fixedname_t fixed;
+	dns_name_t *origin = dns_fixedname_initname(&fixed);
+	dns_rdatacallbacks_t callbacks;
+	isc_buffer_t *text = NULL;
+	dns_db_t *db = NULL;
+	isc_result_t result;
+
+	result = dns_name_fromstring(origin, AUTH_ORIGIN, 0, NULL);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+	isc_buffer_allocate(mctx, &text, 65536);
+	isc_buffer_setautorealloc(text, true);
+	result = isc_buffer_printf(text,
+				   "$TTL 3600\n"
+				   "@ SOA ns hostmaster 1 3600 900 604800 300\n"
+				   "@ NS ns\n"
+				   "ns A 192.0.2.53\n");
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	for (size_t i = 0; i < size; i++) {
+		result = isc_buffer_printf(text, "host%zu A 10.%zu.%zu.%zu\n",
+					   i, (i >> 16) & 0xff, (i >> 8) & 0xff,
+					   i & 0xff);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+
+	result = dns_db_create(mctx, "rbt", origin, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+	dns_rdatacallbacks_init(&callbacks);
+	result = dns_db_beginload(db, &callbacks);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	result = dns_master_loadbuffer(text, origin, origin, dns_rdataclass_in,
+				       0, &callbacks, mctx);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	result = dns_db_endload(db, &callbacks);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	isc_buffer_free(&text);
+
+	result = dns_zone_create(&zone, mctx, 0);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	dns_zone_settype(zone, dns_zone_primary);
+	result = dns_zone_setorigin(zone, origin);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	dns_zone_setclass(zone, dns_rdataclass_in);
+	dns_zone_setview(zone, view);
+	result = dns_view_addzone(view, zone);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	result = dns_zone_replacedb(zone, db, false);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+	dns_db_detach(&db);
+}
+
+static void
+fill_cache(size_t size) {
+	isc_stdtime_t now;
+
+	isc_stdtime_get(&now);
+
+	for (size_t i = 0; i < size; i++) {
+		char text[DNS_NAME_FORMATSIZE];
+		unsigned char address[4] = { 10, (i >> 16) & 0xff,
+					     (i >> 8) & 0xff, i & 0xff };
+		dns_fixedname_t fixed;
+		dns_name_t *name = dns_fixedname_initname(&fixed);
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		dns_rdatalist_t rdatalist;
+		dns_rdataset_t rdataset;
+		dns_dbnode_t *node = NULL;
+		isc_result_t result;
+
+		snprintf(text, sizeof(text), "host%zu." CACHE_SUFFIX, i);
+		result = dns_name_fromstring(name, text, 0, NULL);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+		dns_rdata_init(&rdata);
+		rdata.data = address;
+		rdata.length = sizeof(address);
+		rdata.rdclass = dns_rdataclass_in;
+		rdata.type = dns_rdatatype_a;
+
+		dns_rdatalist_init(&rdatalist);
+		rdatalist.rdclass = dns_rdataclass_in;
+		rdatalist.type = dns_rdatatype_a;
+		rdatalist.ttl = 86400;
+		ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+
+		dns_rdataset_init(&rdataset);
+		dns_rdatalist_tordataset(&rdatalist, &rdataset);
+		rdataset.trust = dns_trust_answer;
+
+		result = dns_db_findnode(view->cachedb, name, true, &node);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		result = dns_db_addrdataset(view->cachedb, node, NULL, now,
+					    &rdataset, 0, NULL);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		dns_db_detachnode(view->cachedb, &node);
+		dns_rdataset_disassociate(&rdataset);
+	}
+}
+
+static void
+make_view(size_t size) {
+	dns_cache_t *cache = NULL;
+	isc_result_t result;
+
+	result = dns_view_create(mctx, dns_rdataclass_in, "bench", &view);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+	result = dns_cache_create(mctx, mctx, taskmgr, dns_rdataclass_in, "",
+				  "rbt", 0, NULL, &cache);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	dns_view_setcache(view, cache, false);
+	dns_cache_detach(&cache);
+
+	/*
+	 * There is no resolver, so recursion is never available, but the
+	 * cache is only consulted when recursion is configured.
+	 */
+	view->recursion = true;
+
+	make_zone(size);
+	fill_cache(size);
+
+	dns_view_freeze(view);
+}
+
+static isc_result_t
+matchview(isc_netaddr_t *srcaddr, isc_netaddr_t *destaddr,
+	  dns_message_t *message, dns_aclenv_t *env, isc_result_t *sigresultp,
+	  dns_view_t **viewp) {
+	UNUSED(srcaddr);
+	UNUSED(destaddr);
+	UNUSED(message);
+	UNUSED(env);
+
+	*sigresultp = ISC_R_SUCCESS;
+	dns_view_attach(view, viewp);
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+make_workloads(size_t size, const char *file) {
+	queries_t *set = NULL;
+	char text[DNS_NAME_FORMATSIZE];
+
+	if (wanted("auth_noerror")) {
+		set = new_workload("auth_noerror");
+		for (size_t i = 0; i < size; i++) {
+			snprintf(text, sizeof(text), "host%zu." AUTH_ORIGIN, i);
+			RUNTIME_CHECK(add_query(set, text, dns_rdatatype_a,
+						false) == ISC_R_SUCCESS);
+		}
+	}
+
+	if (wanted("auth_nxdomain")) {
+		set = new_workload("auth_nxdomain");
+		for (size_t i = 0; i < size; i++) {
+			snprintf(text, sizeof(text), "missing%zu." AUTH_ORIGIN,
+				 i);
+			RUNTIME_CHECK(add_query(set, text, dns_rdatatype_a,
+						false) == ISC_R_SUCCESS);
+		}
+	}
+
+	if (wanted("cache_hit")) {
+		set = new_workload("cache_hit");
+		for (size_t i = 0; i < size; i++) {
+			snprintf(text, sizeof(text), "host%zu." CACHE_SUFFIX,
+				 i);
+			RUNTIME_CHECK(add_query(set, text, dns_rdatatype_a,
+						true) == ISC_R_SUCCESS);
+		}
+	}
+
+	if (file != NULL) {
+		char line[1024];
+		FILE *fp = fopen(file, "r");
+		size_t lineno = 0;
+
+		if (fp == NULL) {
+			perror(file);
+			exit(1);
+		}
+
+		set = new_workload("file");
+		while (fgets(line, sizeof(line), fp) != NULL) {
+			char name[1024], type[64];
+			isc_textregion_t r;
+			dns_rdatatype_t rdtype;
+
+			lineno++;
+			if (line[0] == '#' || line[0] == ';' ||
+			    sscanf(line, "%1023s %63s", name, type) != 2)
+			{
+				continue;
+			}
+
+			r.base = type;
+			r.length = strlen(type);
+			if (dns_rdatatype_fromtext(&rdtype, &r) !=
+				    ISC_R_SUCCESS ||
+			    add_query(set, name, rdtype, true) != ISC_R_SUCCESS)
+			{
+				fprintf(stderr, "%s:%zu: bad query\n", file,
+					lineno);
+			}
+		}
+		fclose(fp);
+
+		if (set->count == 0) {
+			fprintf(stderr, "%s: no queries\n", file);
+			exit(1);
+		}
+	}
+
+	for (size_t i = 0; i < nworkloads; i++) {
+		shuffle(&workloads[i]);
+	}
+}
+
+/*
+ * Running the queries.
+ */
+
+static uint64_t
+cputime(void) {
+	struct timespec ts;
+
+	RUNTIME_CHECK(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0);
+
+	return ((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+static uint64_t
+cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	return (__builtin_ia32_rdtsc());
+#else
+	return (0);
+#endif
+}
+
+static void
+run_queries(worker_t *worker, queries_t *set) {
+	isc_nmhandle_t *handle = &worker->handle;
+	size_t q = (set->count / nloops) * isc_tid();
+	uint64_t cpu0 = cputime(), cycles0 = cycles();
+
+	for (size_t i = 0; i < nqueries; i++, q++) {
+		isc_region_t region;
+		isc_nm_cb_t cb = NULL;
+
+		if (q >= set->count) {
+			q = 0;
+		}
+		region.base = set->wires + set->offsets[q];
+		region.length = set->offsets[q + 1] - set->offsets[q];
+
+		handle->references = 1;
+		ns__client_request(handle, ISC_R_SUCCESS, &region, &interface);
+
+		cb = handle->sendcb;
+		if (cb != NULL) {
+			handle->sendcb = NULL;
+			cb(handle, ISC_R_SUCCESS, handle->sendcbarg);
+		}
+		isc_nmhandle_detach(&handle);
+		handle = &worker->handle;
+	}
+
+	worker->cpu_ns = cputime() - cpu0;
+	worker->cycles = cycles() - cycles0;
+}
+
+static void
+report(queries_t *set) {
+	uint64_t responses = 0, bytes = 0, noerror = 0, nxdomain = 0;
+	uint64_t cpu_ns = 0, ncycles = 0, usecs;
+	uint64_t total = (uint64_t)nqueries * nloops;
+	isc_time_t finish;
+
+	isc_time_now_hires(&finish);
+	usecs = ISC_MAX(isc_time_microdiff(&finish, &start), 1);
+
+	for (uint32_t i = 0; i < nloops; i++) {
+		responses += workers[i].responses;
+		bytes += workers[i].bytes;
+		noerror += workers[i].noerror;
+		nxdomain += workers[i].nxdomain;
+		cpu_ns += workers[i].cpu_ns;
+		ncycles += workers[i].cycles;
+	}
+
+	printf("%s\n    { \"name\": \"%s\", \"size\": %zu, \"threads\": %u, "
+	       "\"queries\": %" PRIu64 ", \"responses\": %" PRIu64 ", "
+	       "\"noerror\": %" PRIu64 ", \"nxdomain\": %" PRIu64 ", "
+	       "\"response_bytes\": %.1f, \"seconds\": %.6f, "
+	       "\"qps\": %.0f, \"qps_per_thread\": %.0f, "
+	       "\"cpu_ns_per_query\": %.1f, \"cycles_per_query\": %.1f }",
+	       set == &workloads[0] ? "" : ",", set->name, set->count, nloops,
+	       total, responses, noerror, nxdomain,
+	       (double)bytes / ISC_MAX(responses, 1), usecs / 1000000.0,
+	       total * 1000000.0 / usecs, total * 1000000.0 / usecs / nloops,
+	       (double)cpu_ns / total, (double)ncycles / total);
+	fflush(stdout);
+}
+
+static void
+shutdown_server(void) {
+	ns_interfacemgr_shutdown(interfacemgr);
+	ns_interfacemgr_detach(&interfacemgr);
+	dns_dispatchmgr_detach(&dispatchmgr);
+	ns_server_detach(&sctx);
+
+	dns_zone_detach(&zone);
+	dns_view_detach(&view);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/*
+ * Runs on every loop: all the loops go through the workloads together,
+ * so that every workload is measured with all of them busy.
+ */
+static void
+run_loop(void *arg) {
+	worker_t *worker = &workers[isc_tid()];
+
+	UNUSED(arg);
+
+	isc_sockaddr_fromin(&worker->handle.peer,
+			    &(struct in_addr){ htonl(0xc0000200 + isc_tid()) },
+			    10053);
+	isc_sockaddr_fromin(&worker->handle.local,
+			    &(struct in_addr){ htonl(0x7f000001) }, 53);
+
+	for (size_t i = 0; i < nworkloads; i++) {
+		worker->responses = worker->bytes = 0;
+		worker->noerror = worker->nxdomain = 0;
+
+		isc_barrier_wait(&barrier);
+		if (isc_tid() == 0) {
+			isc_time_now_hires(&start);
+		}
+		isc_barrier_wait(&barrier);
+
+		run_queries(worker, &workloads[i]);
+
+		isc_barrier_wait(&barrier);
+		if (isc_tid() == 0) {
+			report(&workloads[i]);
+		}
+	}
+
+	isc_barrier_wait(&barrier);
+	if (isc_tid() == 0) {
+		printf("\n  ]\n}\n");
+		shutdown_server();
+	}
+}
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: query [-b workload] [-f queryfile] "
+			"[-n queries] [-s size] [-t threads]\n");
+	exit(1);
+}
+
+int
+main(int argc, char **argv) {
+	const char *file = NULL;
+	size_t size = DEFAULT_SIZE;
+	isc_result_t result;
+	int ch;
+
+	nloops = isc_os_ncpus();
+
+	while ((ch = getopt(argc, argv, "b:f:n:s:t:")) != -1) {
+		switch (ch) {
+		case 'b':
+			filter = optarg;
+			break;
+		case 'f':
+			file = optarg;
+			break;
+		case 'n':
+			nqueries = strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			size = ISC_MAX(strtoul(optarg, NULL, 10), 1);
+			break;
+		case 't':
+			nloops = ISC_MAX(strtoul(optarg, NULL, 10), 1);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc || nqueries == 0) {
+		usage();
+	}
+
+	isc_managers_create(&mctx, nloops, &loopmgr, &netmgr, &taskmgr);
+
+	result = ns_server_create(mctx, matchview, &sctx);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	result = dns_dispatchmgr_create(mctx, netmgr, &dispatchmgr);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	result = ns_interfacemgr_create(mctx, sctx, loopmgr, taskmgr, netmgr,
+					dispatchmgr, NULL, NULL, false,
+					&interfacemgr);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	interface = (ns_interface_t){ .mgr = interfacemgr };
+
+	make_view(size);
+	make_workloads(size, file);
+
+	workers = calloc(nloops, sizeof(workers[0]));
+	RUNTIME_CHECK(workers != NULL);
+	isc_barrier_init(&barrier, nloops);
+
+	printf("{\n  \"version\": \"%s\",\n  \"cpus\": %u,\n"
+	       "  \"benchmarks\": [",
+	       PACKAGE_VERSION, isc_os_ncpus());
+	fflush(stdout);
+
+	isc_loopmgr_setup(loopmgr, run_loop, NULL);
+	isc_loopmgr_run(loopmgr);
+
+	isc_barrier_destroy(&barrier);
+	free(workers);
+	for (size_t i = 0; i < nworkloads; i++) {
+		free(workloads[i].wires);
+		free(workloads[i].offsets);
+	}
+
+	isc_managers_destroy(&mctx, &loopmgr, &netmgr, &taskmgr);
+
+	return (0);
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Measure rwlock throughput with an increasing number of threads, each
+ * taking the same lock for reading most of the time and occasionally for
+ * writing, the way the database and view locks are used.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <isc/atomic.h>
+#include <isc/os.h>
+#include <isc/random.h>
+#include <isc/rwlock.h>
+#include <isc/thread.h>
+#include <isc/tid.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#define DEFAULT_OPS	   1000000
+#define DEFAULT_PERMILLE 1
+
+static isc_rwlock_t lock;
+static uint64_t shared[8];
+
+static size_t ops = DEFAULT_OPS;
+static unsigned int permille = DEFAULT_PERMILLE;
+static atomic_uint_fast32_t tids = 0;
+
+static isc_threadresult_t
+worker(isc_threadarg_t arg) {
+	uint64_t sum = 0;
+
+	UNUSED(arg);
+
+	isc__tid_init(atomic_fetch_add(&tids, 1));
+
+	for (size_t i = 0; i < ops; i++) {
+		if (isc_random_uniform(1000) < permille) {
+			isc_rwlock_lock(&lock, isc_rwlocktype_write);
+			for (size_t j = 0; j < ARRAY_SIZE(shared); j++) {
+				shared[j]++;
+			}
+			isc_rwlock_unlock(&lock, isc_rwlocktype_write);
+		} else {
+			isc_rwlock_lock(&lock, isc_rwlocktype_read);
+			for (size_t j = 0; j < ARRAY_SIZE(shared); j++) {
+				sum += shared[j];
+			}
+			isc_rwlock_unlock(&lock, isc_rwlocktype_read);
+		}
+	}
+
+	return ((isc_threadresult_t)(uintptr_t)sum);
+}
+
+static void
+run(size_t nthreads) {
+	isc_thread_t *threads = calloc(nthreads, sizeof(threads[0]));
+	isc_time_t start, finish;
+	uint64_t usecs;
+
+	RUNTIME_CHECK(threads != NULL);
+
+	atomic_store(&tids, 0);
+	isc_time_now_hires(&start);
+
+	for (size_t i = 0; i < nthreads; i++) {
+		isc_thread_create(worker, NULL, &threads[i]);
+	}
+	for (size_t i = 0; i < nthreads; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+
+	isc_time_now_hires(&finish);
+	usecs = ISC_MAX(isc_time_microdiff(&finish, &start), 1);
+	printf("%3zu threads %8.3f s %12.0f ops/s\n", nthreads,
+	       usecs / 1000000.0, nthreads * ops * 1000000.0 / usecs);
+
+	free(threads);
+}
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: rwlock [-n ops] [-t threads] [-w permille]\n");
+	exit(1);
+}
+
+int
+main(int argc, char **argv) {
+	size_t maxthreads = isc_os_ncpus();
+	int ch;
+
+	while ((ch = getopt(argc, argv, "n:t:w:")) != -1) {
+		switch (ch) {
+		case 'n':
+			ops = strtoul(optarg, NULL, 10);
+			break;
+		case 't':
+			maxthreads = ISC_MAX(strtoul(optarg, NULL, 10), 1);
+			break;
+		case 'w':
+			permille = ISC_MIN(strtoul(optarg, NULL, 10), 1000);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc) {
+		usage();
+	}
+
+	printf("%u/1000 writes\n", permille);
+
+	isc_rwlock_init(&lock, 0, 0);
+
+	for (size_t n = 1; n < maxthreads; n *= 2) {
+		run(n);
+	}
+	run(maxthreads);
+
+	isc_rwlock_destroy(&lock);
+
+	return (0);
+}
@@ -0,0 +1,766 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Measure the core data structures: the red-black tree on its own and
+ * behind the database API, name decoding, comparison and hashing, name
+ * compression, message parsing and rendering, isc_ht, isc_heap, ACL
+ * matching with isc_radix, and isc_stats counters shared by a growing
+ * number of threads.
+ *
+ * The results are printed as a JSON document, one object per benchmark
+ * and table size, so that they can be compared between releases.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <isc/atomic.h>
+#include <isc/buffer.h>
+#include <isc/heap.h>
+#include <isc/ht.h>
+#include <isc/mem.h>
+#include <isc/netaddr.h>
+#include <isc/os.h>
+#include <isc/random.h>
+#include <isc/result.h>
+#include <isc/stats.h>
+#include <isc/thread.h>
+#include <isc/tid.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/acl.h>
+#include <dns/compress.h>
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/iptable.h>
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/rbt.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+
+#define DEFAULT_SIZES "1000,1000000"
+#define MAX_SIZES     8
+#define MAX_MESSAGES  1000000 /* message operations per size */
+#define ZONES	      1000    /* names share this many parent zones */
+#define STATS_OPS     1000000 /* increments per thread */
+#define NCOUNTERS     64
+
+static isc_mem_t *mctx = NULL;
+static const char *filter = NULL;
+static bool first = true;
+
+/*
+ * The names are kept in wire format, packed one after the other, to
+ * fit ten million of them in memory; 'order' is a random permutation
+ * used for lookups.
+ */
+static unsigned char *wires = NULL;
+static size_t *offsets = NULL;
+static uint32_t *order = NULL;
+static size_t nnames = 0;
+
+static void
+make_names(size_t count) {
+	size_t size = count * 32, used = 0;
+
+	nnames = count;
+	wires = malloc(size);
+	offsets = calloc(count + 1, sizeof(offsets[0]));
+	order = calloc(count, sizeof(order[0]));
+	RUNTIME_CHECK(wires != NULL && offsets != NULL && order != NULL);
+
+	for (size_t i = 0; i < count; i++) {
+		char text[DNS_NAME_FORMATSIZE];
+		dns_fixedname_t fixed;
+		dns_name_t *name = dns_fixedname_initname(&fixed);
+		isc_result_t result;
+
+		snprintf(text, sizeof(text), "host%zu.zone%zu.example.", i,
+			 i % ZONES);
+		result = dns_name_fromstring(name, text, 0, NULL);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+		while (used + name->length > size) {
+			size *= 2;
+			wires = realloc(wires, size);
+			RUNTIME_CHECK(wires != NULL);
+		}
+		memmove(wires + used, name->ndata, name->length);
+		offsets[i] = used;
+		used += name->length;
+	}
+	offsets[count] = used;
+
+	for (size_t i = 0; i < count; i++) {
+		size_t j = isc_random_uniform(i + 1);
+
+		order[i] = order[j];
+		order[j] = i;
+	}
+}
+
+static void
+free_names(void) {
+	free(wires);
+	free(offsets);
+	free(order);
+	wires = NULL;
+	offsets = NULL;
+	order = NULL;
+	nnames = 0;
+}
+
+/*
+ * Make 'name' refer to the i-th name, without copying it.
+ */
+static void
+get_name(size_t i, dns_name_t *name) {
+	isc_region_t r = {
+		.base = wires + offsets[i],
+		.length = offsets[i + 1] - offsets[i],
+	};
+
+	dns_name_init(name, NULL);
+	dns_name_fromregion(name, &r);
+}
+
+static bool
+wanted(const char *name) {
+	return (filter == NULL || strstr(name, filter) != NULL);
+}
+
+static void
+report(const char *name, size_t size, size_t threads, size_t ops,
+       isc_time_t *start) {
+	isc_time_t finish;
+	uint64_t usecs;
+
+	isc_time_now_hires(&finish);
+	usecs = ISC_MAX(isc_time_microdiff(&finish, start), 1);
+
+	printf("%s\n    { \"name\": \"%s\", \"size\": %zu, \"threads\": %zu, "
+	       "\"ops\": %zu, \"seconds\": %.6f, \"ns_per_op\": %.1f }",
+	       first ? "" : ",", name, size, threads, ops, usecs / 1000000.0,
+	       usecs * 1000.0 / ISC_MAX(ops, 1));
+	fflush(stdout);
+	first = false;
+
+	*start = finish;
+}
+
+static void
+bench_rbt(void) {
+	dns_rbt_t *rbt = NULL;
+	isc_result_t result;
+	isc_time_t start;
+
+	if (!wanted("rbt_")) {
+		return;
+	}
+
+	result = dns_rbt_create(mctx, NULL, NULL, &rbt);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+	isc_time_now_hires(&start);
+	for (size_t i = 0; i < nnames; i++) {
+		dns_name_t name;
+
+		get_name(i, &name);
+		result = dns_rbt_addname(rbt, &name, wires + offsets[i]);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+	report("rbt_insert", nnames, 1, nnames, &start);
+
+	for (size_t i = 0; i < nnames; i++) {
+		dns_name_t name;
+		void *data = NULL;
+
+		get_name(order[i], &name);
+		result = dns_rbt_findname(rbt, &name, 0, NULL, &data);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+	report("rbt_lookup", nnames, 1, nnames, &start);
+
+	dns_rbt_destroy(&rbt);
+}
+
+static void
+bench_rbtdb(void) {
+	dns_fixedname_t fixed;
+	dns_name_t *origin = dns_fixedname_initname(&fixed);
+	dns_db_t *db = NULL;
+	isc_result_t result;
+	isc_time_t start;
+
+	if (!wanted("rbtdb_")) {
+		return;
+	}
+
+	result = dns_name_fromstring(origin, "example.", 0, NULL);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	result = dns_db_create(mctx, "rbt", origin, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+	isc_time_now_hires(&start);
+	for (size_t i = 0; i < nnames; i++) {
+		dns_dbnode_t *node = NULL;
+		dns_name_t name;
+
+		get_name(i, &name);
+		result = dns_db_findnode(db, &name, true, &node);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		dns_db_detachnode(db, &node);
+	}
+	report("rbtdb_insert", nnames, 1, nnames, &start);
+
+	for (size_t i = 0; i < nnames; i++) {
+		dns_dbnode_t *node = NULL;
+		dns_name_t name;
+
+		get_name(order[i], &name);
+		result = dns_db_findnode(db, &name, false, &node);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		dns_db_detachnode(db, &node);
+	}
+	report("rbtdb_lookup", nnames, 1, nnames, &start);
+
+	dns_db_detach(&db);
+}
+
+static void
+bench_names(void) {
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	isc_buffer_t source;
+	isc_time_t start;
+	unsigned int hash = 0;
+	size_t ordered = 0;
+
+	if (wanted("name_fromwire")) {
+		isc_buffer_init(&source, wires, offsets[nnames]);
+		isc_buffer_add(&source, offsets[nnames]);
+
+		isc_time_now_hires(&start);
+		for (size_t i = 0; i < nnames; i++) {
+			isc_result_t result;
+
+			result = dns_name_fromwire(name, &source,
+						   DNS_DECOMPRESS_ALWAYS, 0,
+						   NULL);
+			RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		}
+		report("name_fromwire", nnames, 1, nnames, &start);
+	}
+
+	if (wanted("name_fullcompare")) {
+		isc_time_now_hires(&start);
+		for (size_t i = 1; i < nnames; i++) {
+			dns_name_t a, b;
+			unsigned int nlabels;
+			int cmp;
+
+			get_name(i - 1, &a);
+			get_name(i, &b);
+			if (dns_name_fullcompare(&a, &b, &cmp, &nlabels) !=
+			    dns_namereln_equal)
+			{
+				ordered++;
+			}
+		}
+		report("name_fullcompare", nnames, 1, nnames - 1, &start);
+		RUNTIME_CHECK(ordered == nnames - 1);
+	}
+
+	if (wanted("name_hash")) {
+		isc_time_now_hires(&start);
+		for (size_t i = 0; i < nnames; i++) {
+			dns_name_t n;
+
+			get_name(i, &n);
+			hash ^= dns_name_hash(&n, false);
+		}
+		report("name_hash", nnames, 1, nnames, &start);
+	}
+
+	/* Keep the hashes from being optimized away */
+	if (hash == 0) {
+		fprintf(stderr, "all the name hashes cancelled out\n");
+	}
+}
+
+/*
+ * Write the names into 64k buffers, the size of the largest response,
+ * with compression; the names share their parent zones, as the names in
+ * a large response mostly do.
+ */
+static void
+bench_compress(void) {
+	static unsigned char buf[65535];
+	isc_buffer_t target;
+	dns_compress_t cctx;
+	isc_time_t start;
+
+	if (!wanted("compress")) {
+		return;
+	}
+
+	isc_buffer_init(&target, buf, sizeof(buf));
+	dns_compress_init(&cctx, mctx);
+
+	isc_time_now_hires(&start);
+	for (size_t i = 0; i < nnames; i++) {
+		isc_result_t result;
+		dns_name_t name;
+
+		if (isc_buffer_availablelength(&target) < DNS_NAME_MAXWIRE) {
+			dns_compress_invalidate(&cctx);
+			isc_buffer_clear(&target);
+			dns_compress_init(&cctx, mctx);
+		}
+
+		get_name(i, &name);
+		result = dns_name_towire(&name, &cctx, &target);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+	report("compress", nnames, 1, nnames, &start);
+
+	dns_compress_invalidate(&cctx);
+}
+
+/*
+ * Add an RRset of 'count' rdatas of 'len' bytes from 'data' to 'msg'.
+ */
+static void
+add_rrset(dns_message_t *msg, const char *owner, dns_section_t section,
+	  dns_rdatatype_t type, unsigned char *data, unsigned int len,
+	  unsigned int count) {
+	dns_name_t *name = NULL;
+	dns_rdataset_t *rdataset = NULL;
+	dns_rdatalist_t *rdatalist = NULL;
+	isc_result_t result;
+
+	dns_message_gettempname(msg, &name);
+	result = dns_name_fromstring(name, owner, 0, NULL);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+	dns_message_gettemprdatalist(msg, &rdatalist);
+	rdatalist->type = type;
+	rdatalist->rdclass = dns_rdataclass_in;
+	rdatalist->ttl = 300;
+
+	for (unsigned int i = 0; i < count; i++) {
+		dns_rdata_t *rdata = NULL;
+		isc_region_t r = { .base = data + i * len, .length = len };
+
+		dns_message_gettemprdata(msg, &rdata);
+		dns_rdata_fromregion(rdata, dns_rdataclass_in, type, &r);
+		ISC_LIST_APPEND(rdatalist->rdata, rdata, link);
+	}
+
+	dns_message_gettemprdataset(msg, &rdataset);
+	dns_rdatalist_tordataset(rdatalist, rdataset);
+	if (section == DNS_SECTION_QUESTION) {
+		rdataset->attributes |= DNS_RDATASETATTR_QUESTION;
+	}
+	ISC_LIST_APPEND(name->list, rdataset, link);
+	dns_message_addname(msg, name, section);
+}
+
+/*
+ * A query, and a response with four addresses, two name servers and
+ * their addresses.
+ */
+static dns_message_t *
+make_message(bool response) {
+	static unsigned char addrs[] = { 192, 0, 2, 1, 192, 0, 2, 2,
+					 192, 0, 2, 3, 192, 0, 2, 4 };
+	static unsigned char ns1[] = "\003ns1\007example\003com";
+	static unsigned char ns2[] = "\003ns2\007example\003com";
+	dns_message_t *msg = NULL;
+
+	dns_message_create(mctx, DNS_MESSAGE_INTENTRENDER, &msg);
+	msg->id = 0x1234;
+	msg->opcode = dns_opcode_query;
+	msg->rdclass = dns_rdataclass_in;
+
+	add_rrset(msg, "www.example.com.", DNS_SECTION_QUESTION,
+		  dns_rdatatype_a, NULL, 0, 0);
+	if (!response) {
+		msg->flags = DNS_MESSAGEFLAG_RD;
+		return (msg);
+	}
+
+	msg->flags = DNS_MESSAGEFLAG_QR | DNS_MESSAGEFLAG_AA |
+		     DNS_MESSAGEFLAG_RD;
+	add_rrset(msg, "www.example.com.", DNS_SECTION_ANSWER,
+		  dns_rdatatype_a, addrs, 4, 4);
+	add_rrset(msg, "example.com.", DNS_SECTION_AUTHORITY,
+		  dns_rdatatype_ns, ns1, sizeof(ns1), 1);
+	add_rrset(msg, "example.com.", DNS_SECTION_AUTHORITY,
+		  dns_rdatatype_ns, ns2, sizeof(ns2), 1);
+	add_rrset(msg, "ns1.example.com.", DNS_SECTION_ADDITIONAL,
+		  dns_rdatatype_a, addrs, 4, 1);
+	add_rrset(msg, "ns2.example.com.", DNS_SECTION_ADDITIONAL,
+		  dns_rdatatype_a, addrs + 4, 4, 1);
+
+	return (msg);
+}
+
+static void
+render(dns_message_t *msg, isc_buffer_t *target) {
+	dns_compress_t cctx;
+	isc_result_t result;
+
+	dns_compress_init(&cctx, mctx);
+	result = dns_message_renderbegin(msg, &cctx, target);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	for (dns_section_t s = DNS_SECTION_QUESTION; s < DNS_SECTION_MAX; s++)
+	{
+		result = dns_message_rendersection(msg, s, 0);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+	result = dns_message_renderend(msg);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	dns_compress_invalidate(&cctx);
+	dns_message_renderreset(msg);
+}
+
+static void
+bench_message(bool response) {
+	const char *kind = response ? "response" : "query";
+	size_t ops = ISC_MIN(nnames, MAX_MESSAGES);
+	unsigned char buf[512];
+	char what[64];
+	dns_message_t *msg = make_message(response);
+	dns_message_t *parsed = NULL;
+	isc_buffer_t target;
+	isc_time_t start;
+
+	isc_buffer_init(&target, buf, sizeof(buf));
+
+	snprintf(what, sizeof(what), "message_render_%s", kind);
+	if (wanted(what)) {
+		isc_time_now_hires(&start);
+		for (size_t i = 0; i < ops; i++) {
+			render(msg, &target);
+		}
+		report(what, nnames, 1, ops, &start);
+	}
+
+	snprintf(what, sizeof(what), "message_parse_%s", kind);
+	if (wanted(what)) {
+		render(msg, &target);
+		dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE, &parsed);
+
+		isc_time_now_hires(&start);
+		for (size_t i = 0; i < ops; i++) {
+			isc_buffer_t source;
+			isc_result_t result;
+
+			isc_buffer_init(&source, buf,
+					isc_buffer_usedlength(&target));
+			isc_buffer_add(&source, isc_buffer_usedlength(&target));
+			result = dns_message_parse(parsed, &source, 0);
+			RUNTIME_CHECK(result == ISC_R_SUCCESS);
+			dns_message_reset(parsed, DNS_MESSAGE_INTENTPARSE);
+		}
+		report(what, nnames, 1, ops, &start);
+
+		dns_message_detach(&parsed);
+	}
+
+	dns_message_detach(&msg);
+}
+
+static void
+bench_ht(void) {
+	isc_ht_t *ht = NULL;
+	isc_result_t result;
+	isc_time_t start;
+
+	if (!wanted("ht_")) {
+		return;
+	}
+
+	isc_ht_init(&ht, mctx, 1, ISC_HT_CASE_SENSITIVE);
+
+	isc_time_now_hires(&start);
+	for (size_t i = 0; i < nnames; i++) {
+		result = isc_ht_add(ht, wires + offsets[i],
+				    offsets[i + 1] - offsets[i],
+				    wires + offsets[i]);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+	report("ht_add", nnames, 1, nnames, &start);
+
+	for (size_t i = 0; i < nnames; i++) {
+		size_t j = order[i];
+		void *value = NULL;
+
+		result = isc_ht_find(ht, wires + offsets[j],
+				     offsets[j + 1] - offsets[j], &value);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+	report("ht_find", nnames, 1, nnames, &start);
+
+	isc_ht_destroy(&ht);
+}
+
+static bool
+heap_less(void *a, void *b) {
+	return (*(uint32_t *)a < *(uint32_t *)b);
+}
+
+/*
+ * Insert random keys, then take them out in order, as the timer and
+ * the cache expiry heaps do.
+ */
+static void
+bench_heap(void) {
+	isc_heap_t *heap = NULL;
+	isc_time_t start;
+	uint32_t *keys = NULL;
+	uint32_t last = 0;
+
+	if (!wanted("heap_")) {
+		return;
+	}
+
+	keys = calloc(nnames, sizeof(keys[0]));
+	RUNTIME_CHECK(keys != NULL);
+	for (size_t i = 0; i < nnames; i++) {
+		keys[i] = isc_random32();
+	}
+
+	isc_heap_create(mctx, heap_less, NULL, 0, &heap);
+
+	isc_time_now_hires(&start);
+	for (size_t i = 0; i < nnames; i++) {
+		isc_heap_insert(heap, &keys[i]);
+	}
+	report("heap_insert", nnames, 1, nnames, &start);
+
+	for (size_t i = 0; i < nnames; i++) {
+		uint32_t *key = isc_heap_element(heap, 1);
+
+		RUNTIME_CHECK(*key >= last);
+		last = *key;
+		isc_heap_delete(heap, 1);
+	}
+	report("heap_pop", nnames, 1, nnames, &start);
+
+	isc_heap_destroy(&heap);
+	free(keys);
+}
+
+/*
+ * An ACL made of random IPv4 /24 prefixes, matched against random
+ * addresses.
+ */
+static void
+bench_acl(void) {
+	dns_acl_t *acl = NULL;
+	isc_result_t result;
+	isc_time_t start;
+	size_t matched = 0;
+
+	if (!wanted("acl_")) {
+		return;
+	}
+
+	result = dns_acl_create(mctx, 0, &acl);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+	isc_time_now_hires(&start);
+	for (size_t i = 0; i < nnames; i++) {
+		struct in_addr ina;
+		isc_netaddr_t netaddr;
+
+		ina.s_addr = isc_random32() & htonl(0xffffff00);
+		isc_netaddr_fromin(&netaddr, &ina);
+		result = dns_iptable_addprefix(acl->iptable, &netaddr, 24,
+					       true);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+	report("acl_insert", nnames, 1, nnames, &start);
+
+	for (size_t i = 0; i < nnames; i++) {
+		struct in_addr ina = { .s_addr = isc_random32() };
+		isc_netaddr_t netaddr;
+		int match;
+
+		isc_netaddr_fromin(&netaddr, &ina);
+		result = dns_acl_match(&netaddr, NULL, acl, NULL, &match,
+				       NULL);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		if (match > 0) {
+			matched++;
+		}
+	}
+	report("acl_match", nnames, 1, nnames, &start);
+
+	dns_acl_detach(&acl);
+
+	/* Keep the matches from being optimized away */
+	if (matched > nnames) {
+		fprintf(stderr, "more matches than lookups\n");
+	}
+}
+
+static isc_stats_t *stats = NULL;
+static atomic_uint_fast32_t tids = 0;
+
+static isc_threadresult_t
+stats_worker(isc_threadarg_t arg) {
+	UNUSED(arg);
+
+	isc__tid_init(atomic_fetch_add(&tids, 1));
+
+	for (size_t i = 0; i < STATS_OPS; i++) {
+		isc_stats_increment(stats, i % NCOUNTERS);
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+static void
+stats_run(const char *what, bool sharded, size_t nthreads) {
+	isc_thread_t *threads = calloc(nthreads, sizeof(threads[0]));
+	isc_result_t result;
+	isc_time_t start;
+
+	RUNTIME_CHECK(threads != NULL);
+
+	if (sharded) {
+		result = isc_stats_createsharded(mctx, &stats, NCOUNTERS);
+	} else {
+		result = isc_stats_create(mctx, &stats, NCOUNTERS);
+	}
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+	atomic_store(&tids, 0);
+	isc_time_now_hires(&start);
+	for (size_t i = 0; i < nthreads; i++) {
+		isc_thread_create(stats_worker, NULL, &threads[i]);
+	}
+	for (size_t i = 0; i < nthreads; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+	report(what, NCOUNTERS, nthreads, nthreads * STATS_OPS, &start);
+
+	isc_stats_detach(&stats);
+	free(threads);
+}
+
+static void
+bench_stats(const char *what, bool sharded, size_t maxthreads) {
+	if (!wanted(what)) {
+		return;
+	}
+
+	for (size_t n = 1; n < maxthreads; n *= 2) {
+		stats_run(what, sharded, n);
+	}
+	stats_run(what, sharded, maxthreads);
+}
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: structs [-b benchmark] [-s sizes] "
+			"[-t threads]\n");
+	exit(1);
+}
+
+int
+main(int argc, char **argv) {
+	const char *sizearg = DEFAULT_SIZES;
+	size_t sizes[MAX_SIZES];
+	size_t nsizes = 0;
+	size_t maxthreads = isc_os_ncpus();
+	char *end = NULL;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "b:s:t:")) != -1) {
+		switch (ch) {
+		case 'b':
+			filter = optarg;
+			break;
+		case 's':
+			sizearg = optarg;
+			break;
+		case 't':
+			maxthreads = ISC_MAX(strtoul(optarg, NULL, 10), 1);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc) {
+		usage();
+	}
+
+	for (const char *p = sizearg; *p != '\0'; p = end) {
+		if (nsizes == MAX_SIZES) {
+			usage();
+		}
+		sizes[nsizes] = strtoul(p, &end, 10);
+		if (end == p || sizes[nsizes] < 2) {
+			usage();
+		}
+		nsizes++;
+		if (*end == ',') {
+			end++;
+		}
+	}
+
+	isc_mem_create(&mctx);
+
+	printf("{\n  \"version\": \"%s\",\n  \"cpus\": %u,\n"
+	       "  \"benchmarks\": [",
+	       PACKAGE_VERSION, isc_os_ncpus());
+
+	for (size_t i = 0; i < nsizes; i++) {
+		make_names(sizes[i]);
+
+		bench_rbt();
+		bench_rbtdb();
+		bench_names();
+		bench_compress();
+		bench_message(false);
+		bench_message(true);
+		bench_ht();
+		bench_heap();
+		bench_acl();
+
+		free_names();
+	}
+
+	bench_stats("stats_increment", false, maxthreads);
+	bench_stats("stats_sharded_increment", true, maxthreads);
+
+	printf("\n  ]\n}\n");
+
+	isc_mem_destroy(&mctx);
+
+	return (0);
+}
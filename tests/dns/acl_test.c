@@ -24,10 +24,12 @@
 #include <cmocka.h>
 
 #include <isc/print.h>
+#include <isc/random.h>
 #include <isc/string.h>
 #include <isc/util.h>
 
 #include <dns/acl.h>
+#include <dns/name.h>
 
 #include <tests/dns.h>
 
@@ -111,8 +113,114 @@ ISC_RUN_TEST_IMPL(dns_acl_isinsecure) {
 #endif /* HAVE_GEOIP2 */
 }
 
+static void
+addprefix(dns_acl_t *acl, const char *str, unsigned int bitlen, bool pos) {
+	isc_netaddr_t addr;
+	struct in_addr in;
+	struct in6_addr in6;
+	isc_result_t result;
+
+	if (inet_pton(AF_INET6, str, &in6) == 1) {
+		isc_netaddr_fromin6(&addr, &in6);
+	} else {
+		assert_int_equal(inet_pton(AF_INET, str, &in), 1);
+		isc_netaddr_fromin(&addr, &in);
+	}
+	result = dns_iptable_addprefix(acl->iptable, &addr, bitlen, pos);
+	assert_int_equal(result, ISC_R_SUCCESS);
+}
+
+/* test that dns_aclindex_match agrees with dns_acl_allowed */
+ISC_RUN_TEST_IMPL(dns_aclindex) {
+	static const char *probes[] = {
+		"10.0.0.0",	   "10.1.0.0",	      "10.1.2.0",
+		"10.1.3.0",	   "10.255.255.255",  "11.0.0.0",
+		"0.0.0.0",	   "255.255.255.255", "2001:db8::",
+		"2001:db9::",	   "2001:db8:1::",    "::",
+		"ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff",
+	};
+	dns_acl_t *acls[6] = { NULL };
+	dns_aclindex_t *index = NULL;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	/* { !10.1/16; 10/8; 2001:db8::/32; } */
+	result = dns_acl_create(mctx, 0, &acls[0]);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	addprefix(acls[0], "10.1.0.0", 16, false);
+	addprefix(acls[0], "10.0.0.0", 8, true);
+	addprefix(acls[0], "2001:db8::", 32, true);
+
+	/* { 10.1.2/24; !2001:db8:1::/48; ::/0; } */
+	result = dns_acl_create(mctx, 0, &acls[1]);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	addprefix(acls[1], "10.1.2.0", 24, true);
+	addprefix(acls[1], "2001:db8:1::", 48, false);
+	addprefix(acls[1], "::", 0, true);
+
+	result = dns_acl_any(mctx, &acls[2]);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* acls[3] is NULL, which allows everything */
+
+	result = dns_acl_none(mctx, &acls[4]);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* A key element can't be indexed */
+	result = dns_acl_create(mctx, 1, &acls[5]);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	acls[5]->elements[0].type = dns_aclelementtype_keyname;
+	dns_name_init(&acls[5]->elements[0].keyname, NULL);
+	dns_name_dup(dns_rootname, mctx, &acls[5]->elements[0].keyname);
+	acls[5]->length = 1;
+
+	dns_aclindex_create(mctx, acls, ARRAY_SIZE(acls), &index);
+	assert_int_equal(dns_aclindex_indexed(index), 0x1f);
+
+	for (size_t i = 0; i < ARRAY_SIZE(probes) * 64; i++) {
+		const char *str = probes[i % ARRAY_SIZE(probes)];
+		isc_netaddr_t addr;
+		struct in_addr in;
+		struct in6_addr in6;
+		uint64_t expect = 0;
+
+		/* Probe the boundaries and random addresses around them */
+		if (inet_pton(AF_INET6, str, &in6) == 1) {
+			if (i >= ARRAY_SIZE(probes)) {
+				in6.s6_addr[5 + i % 11] ^= isc_random8();
+			}
+			isc_netaddr_fromin6(&addr, &in6);
+		} else {
+			assert_int_equal(inet_pton(AF_INET, str, &in), 1);
+			if (i >= ARRAY_SIZE(probes)) {
+				in.s_addr ^= htonl(isc_random32() >> (i % 32));
+			}
+			isc_netaddr_fromin(&addr, &in);
+		}
+
+		for (size_t j = 0; j < 5; j++) {
+			if (dns_acl_allowed(&addr, NULL, acls[j], NULL)) {
+				expect |= (uint64_t)1 << j;
+			}
+		}
+		assert_int_equal(dns_aclindex_match(index, &addr, NULL),
+				 expect);
+	}
+
+	dns_aclindex_destroy(&index);
+	assert_null(index);
+
+	for (size_t j = 0; j < ARRAY_SIZE(acls); j++) {
+		if (acls[j] != NULL) {
+			dns_acl_detach(&acls[j]);
+		}
+	}
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(dns_acl_isinsecure)
+ISC_TEST_ENTRY(dns_aclindex)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/buffer.h>
+#include <isc/util.h>
+
+#include <dns/anscache.h>
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+
+#include <tests/dns.h>
+
+static dns_db_t *db = NULL;
+static dns_anscache_t *cache = NULL;
+
+static int
+setup_test(void **state) {
+	isc_result_t result;
+	dns_fixedname_t fname;
+	dns_name_t *origin = NULL;
+
+	UNUSED(state);
+
+	dns_test_namefromstring("example.", &fname);
+	origin = dns_fixedname_name(&fname);
+
+	result = dns_db_create(mctx, "rbt", origin, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_anscache_create(mctx, &cache);
+
+	return (0);
+}
+
+static int
+teardown_test(void **state) {
+	UNUSED(state);
+
+	dns_anscache_destroy(&cache);
+	dns_db_detach(&db);
+
+	return (0);
+}
+
+/*
+ * Commit a new version of the zone adding an A record at 'owner'.
+ */
+static void
+commit_change(const char *owner, const char *address) {
+	dns_dbversion_t *version = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t fname;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	unsigned char buf[16];
+	isc_result_t result;
+
+	dns_test_namefromstring(owner, &fname);
+	result = dns_test_rdatafromstring(&rdata, dns_rdataclass_in,
+					  dns_rdatatype_a, buf, sizeof(buf),
+					  address, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.ttl = 300;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+	dns_rdataset_init(&rdataset);
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+
+	dns_db_newversion(db, &version);
+	result = dns_db_findnode(db, dns_fixedname_name(&fname), true, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_addrdataset(db, node, version, 0, &rdataset, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_detachnode(db, &node);
+	dns_db_closeversion(db, &version, true);
+
+	dns_rdataset_disassociate(&rdataset);
+}
+
+static void
+add_answer(dns_dbversion_t *version, const char *key, const char *wire) {
+	unsigned int counts[DNS_SECTION_MAX] = { 1, 1, 0, 0 };
+	isc_region_t k, w;
+
+	DE_CONST(key, k.base);
+	k.length = strlen(key);
+	DE_CONST(wire, w.base);
+	w.length = strlen(wire);
+
+	dns_anscache_add(cache, db, version, &k, DNS_MESSAGEFLAG_AA,
+			 dns_rcode_noerror, false, counts, &w);
+}
+
+/*
+ * Look up 'key' and check that the answer is 'wire', or that there
+ * is none if 'wire' is NULL.
+ */
+static void
+check_answer(dns_dbversion_t *version, const char *key, const char *wire) {
+	dns_anscacheentry_t *entry = NULL;
+	isc_result_t result;
+	isc_region_t k;
+
+	DE_CONST(key, k.base);
+	k.length = strlen(key);
+
+	result = dns_anscache_find(cache, db, version, &k, &entry);
+	if (wire == NULL) {
+		assert_int_equal(result, ISC_R_NOTFOUND);
+		assert_null(entry);
+		return;
+	}
+
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(entry->wire.length, strlen(wire));
+	assert_memory_equal(entry->wire.base, wire, strlen(wire));
+	dns_anscacheentry_detach(&entry);
+}
+
+/* answers are found under their key and version only */
+ISC_RUN_TEST_IMPL(anscache_find) {
+	dns_anscacheentry_t *entry = NULL;
+	dns_dbversion_t *version = NULL;
+	isc_region_t k;
+
+	dns_db_currentversion(db, &version);
+
+	check_answer(version, "www/A", NULL);
+	add_answer(version, "www/A", "answer 1");
+	check_answer(version, "www/A", "answer 1");
+	check_answer(version, "www/AAAA", NULL);
+
+	/* Answers already in the cache are not replaced */
+	add_answer(version, "www/A", "answer 2");
+	check_answer(version, "www/A", "answer 1");
+
+	/* The header bits and the section counts are kept */
+	k.base = (unsigned char *)"www/A";
+	k.length = 5;
+	assert_int_equal(dns_anscache_find(cache, db, version, &k, &entry),
+			 ISC_R_SUCCESS);
+	assert_int_equal(entry->flags, DNS_MESSAGEFLAG_AA);
+	assert_int_equal(entry->rcode, dns_rcode_noerror);
+	assert_false(entry->referral);
+	assert_int_equal(entry->counts[DNS_SECTION_QUESTION], 1);
+	assert_int_equal(entry->counts[DNS_SECTION_ANSWER], 1);
+
+	/* Entries stay usable after the cache has been flushed */
+	dns_anscache_flush(cache);
+	check_answer(version, "www/A", NULL);
+	assert_memory_equal(entry->wire.base, "answer 1", 8);
+	dns_anscacheentry_detach(&entry);
+
+	dns_db_closeversion(db, &version, false);
+}
+
+/* a new zone version invalidates the answers for the previous one */
+ISC_RUN_TEST_IMPL(anscache_newversion) {
+	dns_dbversion_t *v1 = NULL, *v2 = NULL;
+
+	dns_db_currentversion(db, &v1);
+	add_answer(v1, "www/A", "old answer");
+
+	commit_change("www.example.", "192.0.2.1");
+	dns_db_currentversion(db, &v2);
+	assert_ptr_not_equal(v1, v2);
+
+	/* Queries using the new version miss */
+	check_answer(v2, "www/A", NULL);
+
+	/* The first answer for the new version discards the old ones */
+	add_answer(v2, "www/A", "new answer");
+	check_answer(v2, "www/A", "new answer");
+	check_answer(v1, "www/A", NULL);
+
+	dns_db_closeversion(db, &v1, false);
+	dns_db_closeversion(db, &v2, false);
+}
+
+/*
+ * a query still using an older version of the zone (one of the active
+ * versions of its client) neither sees nor evicts the answers for the
+ * current version
+ */
+ISC_RUN_TEST_IMPL(anscache_activeversion) {
+	dns_dbversion_t *v1 = NULL, *v2 = NULL;
+
+	dns_db_currentversion(db, &v1);
+
+	commit_change("www.example.", "192.0.2.1");
+	dns_db_currentversion(db, &v2);
+	add_answer(v2, "www/A", "new answer");
+
+	check_answer(v1, "www/A", NULL);
+	add_answer(v1, "www/A", "old answer");
+	add_answer(v1, "ftp/A", "old answer");
+	check_answer(v1, "ftp/A", NULL);
+	check_answer(v2, "www/A", "new answer");
+
+	dns_db_closeversion(db, &v1, false);
+	dns_db_closeversion(db, &v2, false);
+}
+
+/* answers for another database of the zone are never returned */
+ISC_RUN_TEST_IMPL(anscache_newdb) {
+	dns_dbversion_t *version = NULL, *v2 = NULL;
+	dns_db_t *db2 = NULL;
+	isc_result_t result;
+	isc_region_t k;
+	dns_anscacheentry_t *entry = NULL;
+
+	dns_db_currentversion(db, &version);
+	add_answer(version, "www/A", "answer");
+
+	result = dns_db_create(mctx, "rbt", dns_db_origin(db), dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db2);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_currentversion(db2, &v2);
+
+	k.base = (unsigned char *)"www/A";
+	k.length = 5;
+	result = dns_anscache_find(cache, db2, v2, &k, &entry);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	dns_db_closeversion(db2, &v2, false);
+	dns_db_detach(&db2);
+	dns_db_closeversion(db, &version, false);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY_CUSTOM(anscache_find, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(anscache_newversion, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(anscache_activeversion, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(anscache_newdb, setup_test, teardown_test)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
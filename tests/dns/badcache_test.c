@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/print.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/badcache.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+
+#include <tests/dns.h>
+
+static dns_name_t *
+mkname(dns_fixedname_t *fixed, const char *text) {
+	dns_name_t *name = dns_fixedname_initname(fixed);
+	isc_result_t result;
+
+	result = dns_name_fromstring(name, text, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	return (name);
+}
+
+static void
+later(isc_time_t *now, unsigned int seconds, isc_time_t *t) {
+	isc_interval_t interval;
+	isc_result_t result;
+
+	isc_interval_set(&interval, seconds, 0);
+	result = isc_time_add(now, &interval, t);
+	assert_int_equal(result, ISC_R_SUCCESS);
+}
+
+/* entries are found by name and type until they expire */
+ISC_RUN_TEST_IMPL(badcache_find) {
+	dns_badcache_t *bc = NULL;
+	dns_fixedname_t f1, f2;
+	dns_name_t *n1 = mkname(&f1, "example.com.");
+	dns_name_t *n2 = mkname(&f2, "example.net.");
+	isc_time_t now, expire, after, longer;
+	uint32_t flags = 0;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	result = dns_badcache_init(mctx, 64, &bc);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	TIME_NOW(&now);
+	later(&now, 60, &expire);
+	later(&now, 61, &after);
+	later(&now, 120, &longer);
+
+	assert_false(dns_badcache_find(bc, n1, dns_rdatatype_a, NULL, &now));
+
+	dns_badcache_add(bc, n1, dns_rdatatype_a, false, 1, &expire);
+	assert_true(dns_badcache_find(bc, n1, dns_rdatatype_a, &flags, &now));
+	assert_int_equal(flags, 1);
+	assert_false(dns_badcache_find(bc, n1, dns_rdatatype_aaaa, NULL, &now));
+	assert_false(dns_badcache_find(bc, n2, dns_rdatatype_a, NULL, &now));
+
+	/* the flags are only replaced when asked to */
+	dns_badcache_add(bc, n1, dns_rdatatype_a, false, 2, &expire);
+	assert_true(dns_badcache_find(bc, n1, dns_rdatatype_a, &flags, &now));
+	assert_int_equal(flags, 1);
+	dns_badcache_add(bc, n1, dns_rdatatype_a, true, 2, &expire);
+	assert_true(dns_badcache_find(bc, n1, dns_rdatatype_a, &flags, &now));
+	assert_int_equal(flags, 2);
+
+	/* and so is the expiry */
+	dns_badcache_add(bc, n1, dns_rdatatype_aaaa, false, 0, &expire);
+	dns_badcache_add(bc, n1, dns_rdatatype_aaaa, false, 0, &longer);
+	assert_false(
+		dns_badcache_find(bc, n1, dns_rdatatype_aaaa, NULL, &after));
+	dns_badcache_add(bc, n2, dns_rdatatype_a, false, 0, &expire);
+	dns_badcache_add(bc, n2, dns_rdatatype_a, true, 0, &longer);
+	assert_true(dns_badcache_find(bc, n2, dns_rdatatype_a, NULL, &after));
+
+	assert_false(dns_badcache_find(bc, n1, dns_rdatatype_a, NULL, &after));
+	assert_false(dns_badcache_find(bc, n1, dns_rdatatype_a, NULL, &now));
+
+	dns_badcache_destroy(&bc);
+	assert_null(bc);
+}
+
+/* names, subtrees or everything can be flushed */
+ISC_RUN_TEST_IMPL(badcache_flush) {
+	dns_badcache_t *bc = NULL;
+	dns_fixedname_t f1, f2, f3, f4;
+	dns_name_t *n1 = mkname(&f1, "example.com.");
+	dns_name_t *n2 = mkname(&f2, "www.example.com.");
+	dns_name_t *n3 = mkname(&f3, "example.net.");
+	dns_name_t *n4 = mkname(&f4, "com.");
+	isc_time_t now, expire;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	result = dns_badcache_init(mctx, 64, &bc);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	TIME_NOW(&now);
+	later(&now, 60, &expire);
+
+	dns_badcache_add(bc, n1, dns_rdatatype_a, false, 0, &expire);
+	dns_badcache_add(bc, n1, dns_rdatatype_aaaa, false, 0, &expire);
+	dns_badcache_add(bc, n2, dns_rdatatype_a, false, 0, &expire);
+	dns_badcache_add(bc, n3, dns_rdatatype_a, false, 0, &expire);
+
+	dns_badcache_flushname(bc, n1);
+	assert_false(dns_badcache_find(bc, n1, dns_rdatatype_a, NULL, &now));
+	assert_false(dns_badcache_find(bc, n1, dns_rdatatype_aaaa, NULL, &now));
+	assert_true(dns_badcache_find(bc, n2, dns_rdatatype_a, NULL, &now));
+
+	dns_badcache_add(bc, n1, dns_rdatatype_a, false, 0, &expire);
+	dns_badcache_flushtree(bc, n4);
+	assert_false(dns_badcache_find(bc, n1, dns_rdatatype_a, NULL, &now));
+	assert_false(dns_badcache_find(bc, n2, dns_rdatatype_a, NULL, &now));
+	assert_true(dns_badcache_find(bc, n3, dns_rdatatype_a, NULL, &now));
+
+	dns_badcache_flush(bc);
+	assert_false(dns_badcache_find(bc, n3, dns_rdatatype_a, NULL, &now));
+
+	dns_badcache_destroy(&bc);
+}
+
+/* entries survive the tables growing and shrinking again */
+ISC_RUN_TEST_IMPL(badcache_resize) {
+	dns_badcache_t *bc = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *name = NULL;
+	isc_time_t now, expire;
+	isc_result_t result;
+	char text[64];
+	FILE *fp = NULL;
+
+	UNUSED(state);
+
+	result = dns_badcache_init(mctx, 16, &bc);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	TIME_NOW(&now);
+	later(&now, 60, &expire);
+
+	for (unsigned int i = 0; i < 2000; i++) {
+		snprintf(text, sizeof(text), "n%u.example.", i);
+		name = mkname(&fixed, text);
+		dns_badcache_add(bc, name, dns_rdatatype_a, false, i, &expire);
+	}
+	for (unsigned int i = 0; i < 2000; i++) {
+		uint32_t flags = 0;
+
+		snprintf(text, sizeof(text), "n%u.example.", i);
+		name = mkname(&fixed, text);
+		assert_true(dns_badcache_find(bc, name, dns_rdatatype_a,
+					      &flags, &now));
+		assert_int_equal(flags, i);
+	}
+
+	for (unsigned int i = 0; i < 1990; i++) {
+		snprintf(text, sizeof(text), "n%u.example.", i);
+		name = mkname(&fixed, text);
+		dns_badcache_flushname(bc, name);
+	}
+	for (unsigned int i = 1990; i < 2000; i++) {
+		snprintf(text, sizeof(text), "n%u.example.", i);
+		name = mkname(&fixed, text);
+		dns_badcache_add(bc, name, dns_rdatatype_a, false, i, &expire);
+		assert_true(dns_badcache_find(bc, name, dns_rdatatype_a, NULL,
+					      &now));
+	}
+
+	fp = tmpfile();
+	assert_non_null(fp);
+	dns_badcache_print(bc, "Bad cache", fp);
+	assert_int_equal(ftell(fp) > 0, true);
+	fclose(fp);
+
+	dns_badcache_destroy(&bc);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY(badcache_find)
+ISC_TEST_ENTRY(badcache_flush)
+ISC_TEST_ENTRY(badcache_resize)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
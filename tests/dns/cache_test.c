@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/file.h>
+#include <isc/loop.h>
+#include <isc/stdtime.h>
+#include <isc/util.h>
+
+#include <dns/cache.h>
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+
+#include <tests/dns.h>
+
+#define SNAPSHOT "cache_test.snapshot"
+
+static dns_cache_t *cache = NULL;
+static isc_stdtime_t now;
+
+static void
+add_address(const char *owner, dns_ttl_t ttl, dns_trust_t trust,
+	    unsigned char last) {
+	unsigned char address[4] = { 192, 0, 2, last };
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_dbnode_t *node = NULL;
+	dns_db_t *db = NULL;
+	isc_result_t result;
+
+	result = dns_name_fromstring(name, owner, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	rdata.data = address;
+	rdata.length = sizeof(address);
+	rdata.rdclass = dns_rdataclass_in;
+	rdata.type = dns_rdatatype_a;
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.ttl = ttl;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+
+	dns_rdataset_init(&rdataset);
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	rdataset.trust = trust;
+
+	dns_cache_attachdb(cache, &db);
+	result = dns_db_findnode(db, name, true, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_addrdataset(db, node, NULL, now, &rdataset, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_detachnode(db, &node);
+	dns_rdataset_disassociate(&rdataset);
+	dns_db_detach(&db);
+}
+
+static isc_result_t
+find_address(const char *owner, dns_rdataset_t *rdataset,
+	     unsigned char *last) {
+	dns_fixedname_t fixed, ffound;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	dns_name_t *found = dns_fixedname_initname(&ffound);
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_db_t *db = NULL;
+	isc_result_t result;
+
+	result = dns_name_fromstring(name, owner, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_cache_attachdb(cache, &db);
+	result = dns_db_find(db, name, NULL, dns_rdatatype_a, 0, now, NULL,
+			     found, rdataset, NULL);
+	dns_db_detach(&db);
+	if (result != ISC_R_SUCCESS) {
+		if (dns_rdataset_isassociated(rdataset)) {
+			dns_rdataset_disassociate(rdataset);
+		}
+		return (result);
+	}
+
+	assert_int_equal(dns_rdataset_first(rdataset), ISC_R_SUCCESS);
+	dns_rdataset_current(rdataset, &rdata);
+	assert_int_equal(rdata.length, 4);
+	*last = rdata.data[3];
+
+	return (ISC_R_SUCCESS);
+}
+
+/* Move the dump time of the snapshot back by 'age' seconds */
+static void
+age_snapshot(uint32_t age) {
+	unsigned char buf[4];
+	uint32_t dumptime;
+	FILE *fp = fopen(SNAPSHOT, "r+b");
+
+	assert_non_null(fp);
+	assert_int_equal(fseek(fp, 8, SEEK_SET), 0);
+	assert_int_equal(fread(buf, 1, sizeof(buf), fp), sizeof(buf));
+	dumptime = (uint32_t)buf[0] << 24 | (uint32_t)buf[1] << 16 |
+		   (uint32_t)buf[2] << 8 | buf[3];
+	dumptime -= age;
+	buf[0] = dumptime >> 24;
+	buf[1] = dumptime >> 16;
+	buf[2] = dumptime >> 8;
+	buf[3] = dumptime;
+	assert_int_equal(fseek(fp, 8, SEEK_SET), 0);
+	assert_int_equal(fwrite(buf, 1, sizeof(buf), fp), sizeof(buf));
+	fclose(fp);
+}
+
+static void
+snapshot_done(void *arg, isc_result_t result, unsigned int count) {
+	dns_rdataset_t rdataset;
+	unsigned char last = 0;
+
+	UNUSED(arg);
+
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* Only "fresh" was added; "short" expired and "glue" was worse */
+	assert_int_equal(count, 1);
+
+	dns_rdataset_init(&rdataset);
+	assert_int_equal(find_address("fresh.example", &rdataset, &last),
+			 ISC_R_SUCCESS);
+	assert_int_equal(last, 1);
+	assert_int_equal(rdataset.trust, dns_trust_answer);
+	assert_in_range(rdataset.ttl, 3400, 3500);
+	dns_rdataset_disassociate(&rdataset);
+
+	assert_int_not_equal(find_address("short.example", &rdataset, &last),
+			     ISC_R_SUCCESS);
+
+	assert_int_equal(find_address("glue.example", &rdataset, &last),
+			 ISC_R_SUCCESS);
+	assert_int_equal(last, 4);
+	assert_int_equal(rdataset.trust, dns_trust_answer);
+	dns_rdataset_disassociate(&rdataset);
+
+	(void)isc_file_remove(SNAPSHOT);
+	dns_cache_detach(&cache);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* dump a cache and load it back after it has aged */
+ISC_LOOP_TEST_IMPL(snapshot) {
+	isc_result_t result;
+
+	result = dns_cache_create(mctx, mctx, NULL, dns_rdataclass_in, "test",
+				  "rbt", 0, NULL, &cache);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_stdtime_get(&now);
+	add_address("fresh.example", 3600, dns_trust_answer, 1);
+	add_address("short.example", 50, dns_trust_answer, 2);
+	add_address("glue.example", 3600, dns_trust_glue, 3);
+
+	(void)isc_file_remove(SNAPSHOT);
+	dns_cache_setsnapshotfile(cache, SNAPSHOT);
+	assert_string_equal(dns_cache_getsnapshotfile(cache), SNAPSHOT);
+	result = dns_cache_dumpsnapshot(cache);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	age_snapshot(100);
+
+	/* Data learned since the restart must not be overwritten */
+	result = dns_cache_flush(cache);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	add_address("glue.example", 3600, dns_trust_answer, 4);
+
+	dns_cache_loadsnapshot(cache, mainloop, snapshot_done, NULL);
+}
+
+static void
+missing_done(void *arg, isc_result_t result, unsigned int count) {
+	UNUSED(arg);
+
+	assert_int_equal(result, ISC_R_FILENOTFOUND);
+	assert_int_equal(count, 0);
+
+	dns_cache_detach(&cache);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* a missing snapshot is reported, not fatal */
+ISC_LOOP_TEST_IMPL(snapshot_missing) {
+	isc_result_t result;
+
+	result = dns_cache_create(mctx, mctx, NULL, dns_rdataclass_in, "test",
+				  "rbt", 0, NULL, &cache);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	(void)isc_file_remove(SNAPSHOT);
+	dns_cache_setsnapshotfile(cache, SNAPSHOT);
+	dns_cache_loadsnapshot(cache, mainloop, missing_done, NULL);
+}
+
+/* flushing a tree hides what was cached below it, and only that */
+ISC_LOOP_TEST_IMPL(flushtree) {
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	dns_rdataset_t rdataset;
+	unsigned char last = 0;
+	isc_result_t result;
+
+	result = dns_cache_create(mctx, mctx, NULL, dns_rdataclass_in, "test",
+				  "rbt", 0, NULL, &cache);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_stdtime_get(&now);
+	add_address("example", 3600, dns_trust_answer, 1);
+	add_address("a.example", 3600, dns_trust_answer, 2);
+	add_address("b.a.example", 3600, dns_trust_answer, 3);
+	add_address("other", 3600, dns_trust_answer, 4);
+
+	result = dns_name_fromstring(name, "a.example", 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_cache_flushnode(cache, name, true);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdataset_init(&rdataset);
+	assert_int_not_equal(find_address("a.example", &rdataset, &last),
+			     ISC_R_SUCCESS);
+	assert_int_not_equal(find_address("b.a.example", &rdataset, &last),
+			     ISC_R_SUCCESS);
+
+	assert_int_equal(find_address("example", &rdataset, &last),
+			 ISC_R_SUCCESS);
+	assert_int_equal(last, 1);
+	dns_rdataset_disassociate(&rdataset);
+
+	assert_int_equal(find_address("other", &rdataset, &last),
+			 ISC_R_SUCCESS);
+	assert_int_equal(last, 4);
+	dns_rdataset_disassociate(&rdataset);
+
+	/* What is cached after the flush is found again */
+	add_address("b.a.example", 3600, dns_trust_answer, 5);
+	assert_int_equal(find_address("b.a.example", &rdataset, &last),
+			 ISC_R_SUCCESS);
+	assert_int_equal(last, 5);
+	dns_rdataset_disassociate(&rdataset);
+
+	dns_cache_detach(&cache);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY_CUSTOM(snapshot, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(snapshot_missing, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(flushtree, setup_managers, teardown_managers)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
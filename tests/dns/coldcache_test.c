@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/file.h>
+#include <isc/util.h>
+
+#include <dns/coldcache.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+
+#include <tests/dns.h>
+
+#define COLDFILE "coldcache_test.data"
+
+#define BUCKETSIZE (DNS_COLDCACHE_SLOTSIZE * DNS_COLDCACHE_WAYS)
+
+static dns_coldcache_t *cold = NULL;
+
+static int
+setup_test(void **state) {
+	isc_result_t result;
+
+	UNUSED(state);
+
+	/* A single bucket, so that every RRset competes for its slots */
+	result = dns_coldcache_create(mctx, COLDFILE, BUCKETSIZE, &cold);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	return (0);
+}
+
+static int
+teardown_test(void **state) {
+	UNUSED(state);
+
+	dns_coldcache_detach(&cold);
+
+	return (0);
+}
+
+static bool
+put(const char *owner, dns_rdatatype_t type, isc_stdtime_t expire,
+    const char *slab) {
+	dns_fixedname_t fname;
+
+	dns_test_namefromstring(owner, &fname);
+
+	return (dns_coldcache_put(cold, dns_fixedname_name(&fname), type, 0,
+				  dns_trust_answer, expire,
+				  (const unsigned char *)slab, strlen(slab)));
+}
+
+/*
+ * Take the RRset from the cold tier and check that it is 'slab', or
+ * that it is not there if 'slab' is NULL.
+ */
+static void
+take(const char *owner, dns_rdatatype_t type, isc_stdtime_t now,
+     const char *slab) {
+	dns_fixedname_t fname;
+	isc_region_t region = { .base = NULL };
+	dns_trust_t trust = dns_trust_none;
+	isc_stdtime_t expire = 0;
+	isc_result_t result;
+
+	dns_test_namefromstring(owner, &fname);
+
+	result = dns_coldcache_take(cold, dns_fixedname_name(&fname), type, 0,
+				    now, mctx, &region, &trust, &expire);
+	if (slab == NULL) {
+		assert_int_equal(result, ISC_R_NOTFOUND);
+		return;
+	}
+
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(region.length, strlen(slab));
+	assert_memory_equal(region.base, slab, region.length);
+	assert_int_equal(trust, dns_trust_answer);
+	assert_true(expire > now);
+	isc_mem_put(mctx, region.base, region.length);
+}
+
+/* the file is sized as requested and removed once mapped */
+ISC_RUN_TEST_IMPL(coldcache_create) {
+	dns_coldcache_t *c = NULL;
+	isc_result_t result;
+
+	result = dns_coldcache_create(mctx, COLDFILE, BUCKETSIZE - 1, &c);
+	assert_int_equal(result, ISC_R_RANGE);
+	assert_null(c);
+
+	result = dns_coldcache_create(mctx, COLDFILE, 3 * BUCKETSIZE + 1, &c);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_string_equal(dns_coldcache_getfilename(c), COLDFILE);
+	assert_int_equal(dns_coldcache_getsize(c), 3 * BUCKETSIZE + 1);
+	assert_false(isc_file_exists(COLDFILE));
+
+	dns_coldcache_detach(&c);
+}
+
+/* RRsets are taken out once, by name (in any case) and type */
+ISC_RUN_TEST_IMPL(coldcache_take) {
+	isc_stdtime_t now = 1000;
+
+	assert_true(put("www.example.", dns_rdatatype_a, now + 60, "a"));
+	assert_true(put("www.example.", dns_rdatatype_aaaa, now + 60, "aaaa"));
+
+	take("www.example.", dns_rdatatype_txt, now, NULL);
+	take("example.", dns_rdatatype_a, now, NULL);
+	take("WWW.Example.", dns_rdatatype_a, now, "a");
+	take("www.example.", dns_rdatatype_a, now, NULL);
+	take("www.example.", dns_rdatatype_aaaa, now, "aaaa");
+
+	/* A new copy replaces the previous one */
+	assert_true(put("www.example.", dns_rdatatype_a, now + 60, "old"));
+	assert_true(put("www.example.", dns_rdatatype_a, now + 60, "new"));
+	take("www.example.", dns_rdatatype_a, now, "new");
+	take("www.example.", dns_rdatatype_a, now, NULL);
+}
+
+/* expired RRsets are dropped, and RRsets too large are not stored */
+ISC_RUN_TEST_IMPL(coldcache_expire) {
+	char big[DNS_COLDCACHE_SLOTSIZE];
+	isc_stdtime_t now = 1000;
+
+	assert_true(put("www.example.", dns_rdatatype_a, now + 60, "a"));
+	take("www.example.", dns_rdatatype_a, now + 60, NULL);
+
+	/* The expired copy is gone */
+	take("www.example.", dns_rdatatype_a, now, NULL);
+
+	memset(big, 'x', sizeof(big) - 1);
+	big[sizeof(big) - 1] = '\0';
+	assert_false(put("www.example.", dns_rdatatype_txt, now + 60, big));
+	take("www.example.", dns_rdatatype_txt, now, NULL);
+}
+
+/* a full bucket gives up the RRset that expires first */
+ISC_RUN_TEST_IMPL(coldcache_evict) {
+	char owner[32];
+	isc_stdtime_t now = 1000;
+
+	for (unsigned int i = 0; i < DNS_COLDCACHE_WAYS; i++) {
+		snprintf(owner, sizeof(owner), "host%u.example.", i);
+		/* host1 expires first */
+		assert_true(put(owner, dns_rdatatype_a,
+				now + (i == 1 ? 10 : 100 + i), "a"));
+	}
+	assert_true(put("new.example.", dns_rdatatype_a, now + 60, "new"));
+
+	take("new.example.", dns_rdatatype_a, now, "new");
+	for (unsigned int i = 0; i < DNS_COLDCACHE_WAYS; i++) {
+		snprintf(owner, sizeof(owner), "host%u.example.", i);
+		take(owner, dns_rdatatype_a, now, i == 1 ? NULL : "a");
+	}
+}
+
+/* flushing empties the cold tier, which stays usable */
+ISC_RUN_TEST_IMPL(coldcache_flush) {
+	dns_coldcache_t *c = NULL;
+	isc_stdtime_t now = 1000;
+
+	assert_true(put("www.example.", dns_rdatatype_a, now + 60, "a"));
+	assert_true(put("ftp.example.", dns_rdatatype_a, now + 60, "a"));
+
+	dns_coldcache_flush(cold);
+	take("www.example.", dns_rdatatype_a, now, NULL);
+	take("ftp.example.", dns_rdatatype_a, now, NULL);
+
+	/* Another reference keeps the mapping */
+	dns_coldcache_attach(cold, &c);
+	dns_coldcache_detach(&cold);
+	cold = c;
+
+	assert_true(put("www.example.", dns_rdatatype_a, now + 60, "b"));
+	take("www.example.", dns_rdatatype_a, now, "b");
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY(coldcache_create)
+ISC_TEST_ENTRY_CUSTOM(coldcache_take, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(coldcache_expire, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(coldcache_evict, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(coldcache_flush, setup_test, teardown_test)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -24,6 +24,7 @@
 #include <dns/db.h>
 #include <dns/dbiterator.h>
 #include <dns/journal.h>
+#include <dns/message.h>
 #include <dns/name.h>
 #include <dns/rdatalist.h>
 
@@ -241,6 +242,106 @@ ISC_RUN_TEST_IMPL(dns_dbfind_staleok) {
 	dns_db_detach(&db);
 }
 
+static void
+water(void *arg, int mark) {
+	isc_mem_waterack(arg, mark);
+}
+
+static void
+add_address(dns_db_t *db, const char *text) {
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	dns_dbnode_t *node = NULL;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	isc_result_t result;
+	unsigned char data[] = { 0x0a, 0x00, 0x00, 0x01 };
+
+	result = dns_name_fromstring(name, text, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	rdata.data = data;
+	rdata.length = sizeof(data);
+	rdata.rdclass = dns_rdataclass_in;
+	rdata.type = dns_rdatatype_a;
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.ttl = 86400;
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.rdclass = dns_rdataclass_in;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+
+	dns_rdataset_init(&rdataset);
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+
+	result = dns_db_findnode(db, name, true, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_addrdataset(db, node, NULL, 0, &rdataset, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_db_detachnode(db, &node);
+	dns_rdataset_disassociate(&rdataset);
+}
+
+static isc_result_t
+find_address(dns_db_t *db, const char *text) {
+	dns_fixedname_t fixed, ffound;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	dns_name_t *found = dns_fixedname_initname(&ffound);
+	dns_rdataset_t rdataset;
+	isc_result_t result;
+
+	result = dns_name_fromstring(name, text, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdataset_init(&rdataset);
+	result = dns_db_find(db, name, NULL, dns_rdatatype_a, 0, 0, NULL,
+			     found, &rdataset, NULL);
+	if (dns_rdataset_isassociated(&rdataset)) {
+		dns_rdataset_disassociate(&rdataset);
+	}
+	return (result);
+}
+
+/* an entry in use survives SIEVE eviction however old it is */
+ISC_RUN_TEST_IMPL(sieve_eviction) {
+	isc_mem_t *cmctx = NULL;
+	dns_db_t *db = NULL;
+	isc_result_t result;
+	char text[64];
+
+	UNUSED(state);
+
+	isc_mem_create(&cmctx);
+	isc_mem_setwater(cmctx, water, cmctx, 1024 * 1024, 768 * 1024);
+
+	result = dns_db_create(cmctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_db_setevictionpolicy(db, dns_evictionpolicy_sieve);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	add_address(db, "hot.example");
+	for (int i = 0; i < 20000; i++) {
+		snprintf(text, sizeof(text), "cold%d.example", i);
+		add_address(db, text);
+		assert_int_equal(find_address(db, "hot.example"),
+				 ISC_R_SUCCESS);
+	}
+
+	/* The oldest unused entries have gone to make room */
+	assert_int_not_equal(find_address(db, "cold0.example"),
+			     ISC_R_SUCCESS);
+	assert_int_equal(find_address(db, "cold19999.example"),
+			 ISC_R_SUCCESS);
+
+	dns_db_detach(&db);
+	isc_mem_clearwater(cmctx);
+	isc_mem_detach(&cmctx);
+}
+
 /* database class */
 ISC_RUN_TEST_IMPL(class) {
 	isc_result_t result;
@@ -358,13 +459,147 @@ ISC_RUN_TEST_IMPL(version) {
 	dns_db_detach(&db);
 }
 
+static unsigned int
+count_glue(dns_db_t *db, dns_dbversion_t *ver) {
+	isc_result_t result;
+	dns_fixedname_t fname, ffound;
+	dns_name_t *foundname = dns_fixedname_initname(&ffound);
+	dns_dbnode_t *node = NULL;
+	dns_rdataset_t rdataset;
+	dns_message_t *msg = NULL;
+	unsigned int count = 0;
+
+	dns_test_namefromstring("sub.test.test", &fname);
+	dns_rdataset_init(&rdataset);
+	result = dns_db_find(db, dns_fixedname_name(&fname), ver,
+			     dns_rdatatype_ns, 0, 0, &node, foundname,
+			     &rdataset, NULL);
+	assert_int_equal(result, DNS_R_DELEGATION);
+
+	dns_message_create(mctx, DNS_MESSAGE_INTENTRENDER, &msg);
+	result = dns_rdataset_addglue(&rdataset, ver, msg);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	for (result = dns_message_firstname(msg, DNS_SECTION_ADDITIONAL);
+	     result == ISC_R_SUCCESS;
+	     result = dns_message_nextname(msg, DNS_SECTION_ADDITIONAL))
+	{
+		count++;
+	}
+
+	dns_message_detach(&msg);
+	dns_rdataset_disassociate(&rdataset);
+	dns_db_detachnode(db, &node);
+
+	return (count);
+}
+
+/* glue is kept per version */
+ISC_RUN_TEST_IMPL(glue) {
+	isc_result_t result;
+	dns_fixedname_t fname;
+	dns_db_t *db = NULL;
+	dns_dbversion_t *ver = NULL, *new = NULL;
+	dns_dbnode_t *node = NULL;
+
+	UNUSED(state);
+
+	result = dns_test_loaddb(&db, dns_dbtype_zone, "test.test",
+				 TESTS_DIR "/testdata/db/glue.db");
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* Only the in-zone NS target below the delegation is glue */
+	dns_db_currentversion(db, &ver);
+	assert_int_equal(count_glue(db, ver), 1);
+
+	/* Remove the glue addresses in a new version */
+	result = dns_db_newversion(db, &new);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_test_namefromstring("ns.sub.test.test", &fname);
+	result = dns_db_findnode(db, dns_fixedname_name(&fname), false,
+				 &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_deleterdataset(db, node, new, dns_rdatatype_a, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_deleterdataset(db, node, new, dns_rdatatype_aaaa, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_detachnode(db, &node);
+
+	/* The version being written sees its own changes */
+	assert_int_equal(count_glue(db, new), 0);
+
+	dns_db_closeversion(db, &new, true);
+
+	/* The old version still has its glue, the new one has none */
+	assert_int_equal(count_glue(db, ver), 1);
+	dns_db_closeversion(db, &ver, false);
+
+	dns_db_currentversion(db, &ver);
+	assert_int_equal(count_glue(db, ver), 0);
+	dns_db_closeversion(db, &ver, false);
+
+	dns_db_detach(&db);
+}
+
+/* the database counts the memory it allocates */
+ISC_RUN_TEST_IMPL(memory) {
+	isc_result_t result;
+	dns_fixedname_t fname;
+	dns_db_t *db = NULL;
+	dns_dbversion_t *new = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_dbmemory_t loaded, changed, rolledback;
+
+	UNUSED(state);
+
+	result = dns_test_loaddb(&db, dns_dbtype_zone, "test.test",
+				 TESTS_DIR "/testdata/db/glue.db");
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_db_getmemory(db, &loaded);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(loaded.nodes > 0);
+	assert_true(loaded.rdata > 0);
+	assert_true(loaded.glue > 0);
+
+	/* Deleting an rdataset adds a nonexistent header */
+	result = dns_db_newversion(db, &new);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_test_namefromstring("ns.sub.test.test", &fname);
+	result = dns_db_findnode(db, dns_fixedname_name(&fname), false,
+				 &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_deleterdataset(db, node, new, dns_rdatatype_a, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_detachnode(db, &node);
+
+	result = dns_db_getmemory(db, &changed);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(changed.rdata > loaded.rdata);
+
+	/* Rolling the version back frees it again */
+	dns_db_closeversion(db, &new, false);
+
+	result = dns_db_getmemory(db, &rolledback);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(rolledback.nodes, loaded.nodes);
+	assert_int_equal(rolledback.rdata, loaded.rdata);
+
+	dns_db_detach(&db);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(getoriginnode)
 ISC_TEST_ENTRY(getsetservestalettl)
 ISC_TEST_ENTRY(dns_dbfind_staleok)
+ISC_TEST_ENTRY(sieve_eviction)
 ISC_TEST_ENTRY(class)
 ISC_TEST_ENTRY(dbtype)
 ISC_TEST_ENTRY(version)
+ISC_TEST_ENTRY(glue)
+ISC_TEST_ENTRY(memory)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -499,6 +499,69 @@ ISC_LOOP_TEST_IMPL(dispatch_tcp_response) {
 	dns_dispatch_connect(dispentry);
 }
 
+static void
+response_pool(isc_result_t eresult, isc_region_t *region, void *arg) {
+	isc_result_t result;
+	dns_dispatch_t *disp = NULL;
+	bool tcpconnected = false;
+
+	UNUSED(region);
+	UNUSED(arg);
+
+	assert_int_equal(eresult, ISC_R_SUCCESS);
+
+	dns_dispatch_done(&dispentry);
+
+	/* The now idle connection is kept and handed out again */
+	result = dns_dispatch_gettcp(dispatchmgr, &tcp_server_addr,
+				     &tcp_connect_addr, &tcpconnected, &disp);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(tcpconnected);
+	assert_ptr_equal(disp, dispatch);
+
+	dns_dispatch_detach(&disp);
+	dns_dispatch_detach(&dispatch);
+	dns_dispatchmgr_setidle(dispatchmgr, 0, 0);
+	dns_dispatchmgr_detach(&dispatchmgr);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+ISC_LOOP_TEST_IMPL(dispatch_tcp_pool) {
+	isc_result_t result;
+	uint16_t id;
+
+	/* Server */
+	result = isc_nm_listentcpdns(netmgr, ISC_NM_LISTEN_ONE,
+				     &tcp_server_addr, nameserver, NULL,
+				     accept_cb, NULL, 0, NULL, &sock);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_loop_teardown(isc_loop_main(loopmgr), stop_listening, sock);
+
+	/* Client */
+	testdata.region.base = testdata.message;
+	testdata.region.length = sizeof(testdata.message);
+
+	result = dns_dispatchmgr_create(mctx, connect_nm, &dispatchmgr);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_dispatchmgr_setidle(dispatchmgr, 1, T_CLIENT_IDLE);
+
+	result = dns_dispatch_createtcp(dispatchmgr, &tcp_connect_addr,
+					&tcp_server_addr, -1, &dispatch);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_dispatch_add(dispatch, 0, T_CLIENT_CONNECT,
+				  &tcp_server_addr, connected, client_senddone,
+				  response_pool, &testdata.region, &id,
+				  &dispentry);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	testdata.message[0] = (id >> 8) & 0xff;
+	testdata.message[1] = id & 0xff;
+
+	dns_dispatch_connect(dispentry);
+}
+
 ISC_LOOP_TEST_IMPL(dispatch_timeout_udp_response) {
 	isc_result_t result;
 	uint16_t id;
@@ -574,6 +637,7 @@ ISC_TEST_ENTRY_CUSTOM(dispatchset_get, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(dispatch_timeout_tcp_response, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(dispatch_timeout_tcp_connect, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(dispatch_tcp_response, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(dispatch_tcp_pool, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(dispatch_getnext, setup_test, teardown_test)
 ISC_TEST_LIST_END
 
@@ -29,6 +29,10 @@
 #include <isc/string.h>
 #include <isc/util.h>
 
+#include <dns/fixedname.h>
+#include <dns/keyvalues.h>
+#include <dns/name.h>
+
 #include <dst/dst.h>
 
 #include "dst_internal.h"
@@ -471,9 +475,118 @@ ISC_RUN_TEST_IMPL(cmp_test) {
 	}
 }
 
+#define NBATCH 48
+
+static void
+load_key(const char *keyname, dns_keytag_t id, dns_secalg_t alg,
+	 dst_key_t **keyp) {
+	dns_fixedname_t fname;
+	dns_name_t *name = dns_fixedname_initname(&fname);
+	isc_result_t result;
+
+	result = dns_name_fromstring(name, keyname, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dst_key_fromfile(name, id, alg,
+				  DST_TYPE_PRIVATE | DST_TYPE_PUBLIC,
+				  TESTS_DIR "/testdata/dst", mctx, keyp);
+	assert_int_equal(result, ISC_R_SUCCESS);
+}
+
+/* batches give the same results as verifying one signature at a time */
+ISC_RUN_TEST_IMPL(batch_test) {
+	dst_key_t *keys[3] = { NULL };
+	unsigned int nkeys = 0;
+	dst_batchverify_t *batch = NULL;
+	dns_fixedname_t fname;
+	dns_name_t *name = dns_fixedname_initname(&fname);
+	isc_result_t result;
+
+	UNUSED(state);
+
+	if (dst_algorithm_supported(DST_ALG_ECDSA256)) {
+		load_key("test.", 49130, DST_ALG_ECDSA256, &keys[nkeys++]);
+	}
+	if (dst_algorithm_supported(DST_ALG_RSASHA256)) {
+		load_key("test.", 11349, DST_ALG_RSASHA256, &keys[nkeys++]);
+	}
+	if (dst_algorithm_supported(DST_ALG_ED25519)) {
+		result = dns_name_fromstring(name, "test.", 0, NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		result = dst_key_generate(
+			name, DST_ALG_ED25519, 256, 0, DNS_KEYOWNER_ZONE,
+			DNS_KEYPROTO_DNSSEC, dns_rdataclass_in, mctx,
+			&keys[nkeys++], NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+	if (nkeys == 0) {
+		skip();
+	}
+
+	dst_batchverify_create(mctx, NBATCH, 0, &batch);
+
+	/*
+	 * Sign different data with each key in turn, breaking every
+	 * third signature.
+	 */
+	for (unsigned int i = 0; i < NBATCH; i++) {
+		dst_key_t *key = keys[i % nkeys];
+		unsigned char data[32];
+		unsigned char sig[512];
+		isc_region_t datareg = { data, sizeof(data) };
+		isc_region_t sigreg;
+		isc_buffer_t sigbuf;
+		dst_context_t *ctx = NULL;
+
+		memset(data, i, sizeof(data));
+		isc_buffer_init(&sigbuf, sig, sizeof(sig));
+
+		result = dst_context_create(key, mctx, DNS_LOGCATEGORY_GENERAL,
+					    true, 0, &ctx);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		result = dst_context_adddata(ctx, &datareg);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		result = dst_context_sign(ctx, &sigbuf);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		dst_context_destroy(&ctx);
+
+		isc_buffer_usedregion(&sigbuf, &sigreg);
+		if (i % 3 == 2) {
+			sigreg.base[sigreg.length / 2] ^= 0x01;
+		}
+
+		result = dst_context_create(key, mctx, DNS_LOGCATEGORY_GENERAL,
+					    false, 0, &ctx);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		result = dst_context_adddata(ctx, &datareg);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		dst_batchverify_add(batch, &ctx, &sigreg);
+		assert_null(ctx);
+	}
+
+	assert_int_equal(dst_batchverify_count(batch), NBATCH);
+	dst_batchverify_run(batch);
+
+	for (unsigned int i = 0; i < NBATCH; i++) {
+		result = dst_batchverify_result(batch, i);
+		if (i % 3 == 2) {
+			assert_int_not_equal(result, ISC_R_SUCCESS);
+		} else {
+			assert_int_equal(result, ISC_R_SUCCESS);
+		}
+	}
+
+	dst_batchverify_destroy(&batch);
+	assert_null(batch);
+
+	for (unsigned int i = 0; i < nkeys; i++) {
+		dst_key_free(&keys[i]);
+	}
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(sig_test, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(cmp_test, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(batch_test, setup_test, teardown_test)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/buffer.h>
+#include <isc/stdtime.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/keycache.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+
+#include <dst/dst.h>
+
+#include <tests/dns.h>
+
+static int
+setup_test(void **state) {
+	UNUSED(state);
+
+	if (dst_lib_init(mctx, NULL) != ISC_R_SUCCESS) {
+		return (1);
+	}
+
+	return (0);
+}
+
+static int
+teardown_test(void **state) {
+	UNUSED(state);
+
+	dst_lib_destroy();
+
+	return (0);
+}
+
+/* keys are shared until they expire or the cache is flushed */
+ISC_RUN_TEST_IMPL(keycache_get) {
+	unsigned char keydata[DST_KEY_MAXSIZE];
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_fixedname_t fixed, fupper;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	dns_name_t *upper = dns_fixedname_initname(&fupper);
+	dns_keycache_t *cache = NULL;
+	dst_key_t *key = NULL, *k1 = NULL, *k2 = NULL;
+	isc_stdtime_t now;
+	isc_buffer_t b;
+	isc_region_t r;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	result = dns_name_fromstring(name, "rsa.", 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_name_fromstring(upper, "RSA.", 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dst_key_fromfile(name, 29238, DST_ALG_RSASHA256,
+				  DST_TYPE_PUBLIC, TESTS_DIR, mctx, &key);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_buffer_init(&b, keydata, sizeof(keydata));
+	result = dst_key_todns(key, &b);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	isc_buffer_usedregion(&b, &r);
+	dns_rdata_fromregion(&rdata, dns_rdataclass_in, dns_rdatatype_dnskey,
+			     &r);
+
+	isc_stdtime_get(&now);
+	dns_keycache_create(mctx, 128, &cache);
+
+	result = dns_keycache_get(cache, name, &rdata, now, now + 60, &k1);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(dst_key_compare(key, k1));
+
+	result = dns_keycache_get(cache, upper, &rdata, now, now + 60, &k2);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_ptr_equal(k1, k2);
+	dst_key_free(&k2);
+
+	result = dns_keycache_get(cache, name, &rdata, now + 61, now + 120,
+				  &k2);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_ptr_not_equal(k1, k2);
+	assert_true(dst_key_compare(k1, k2));
+	dst_key_free(&k1);
+
+	dns_keycache_flush(cache);
+	result = dns_keycache_get(cache, name, &rdata, now, now + 60, &k1);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_ptr_not_equal(k1, k2);
+	dst_key_free(&k1);
+	dst_key_free(&k2);
+
+	dns_keycache_destroy(&cache);
+	assert_null(cache);
+	dst_key_free(&key);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY_CUSTOM(keycache_get, setup_test, teardown_test)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
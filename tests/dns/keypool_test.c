@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/loop.h>
+#include <isc/timer.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/keypool.h>
+#include <dns/keyvalues.h>
+#include <dns/name.h>
+#include <dns/rdataclass.h>
+
+#include <dst/dst.h>
+
+#include <tests/dns.h>
+
+static dns_keypool_t *pool = NULL;
+static isc_timer_t *timer = NULL;
+
+static int
+setup_test(void **state) {
+	setup_loopmgr(state);
+
+	if (dst_lib_init(mctx, NULL) != ISC_R_SUCCESS) {
+		return (1);
+	}
+
+	return (0);
+}
+
+static int
+teardown_test(void **state) {
+	dst_lib_destroy();
+
+	teardown_loopmgr(state);
+
+	return (0);
+}
+
+static void
+getstats(const dns_keypool_stats_t *stats, void *arg) {
+	dns_keypool_stats_t *statsp = arg;
+
+	*statsp = *stats;
+}
+
+/* a pool of depth zero keeps no keys */
+ISC_LOOP_TEST_IMPL(keypool_empty) {
+	dst_key_t *key = NULL;
+	isc_result_t result;
+
+	UNUSED(arg);
+
+	dns_keypool_create(mctx, loopmgr, 0, &pool);
+
+	result = dns_keypool_get(pool, dns_rootname, DST_ALG_ECDSA256, 256,
+				 DNS_KEYOWNER_ZONE, dns_rdataclass_in, &key);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+	assert_null(key);
+
+	dns_keypool_shutdown(pool);
+	dns_keypool_detach(&pool);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static void
+refill_tick(void *arg) {
+	dns_keypool_stats_t stats = { 0 };
+	dns_fixedname_t fname;
+	dns_name_t *name = dns_fixedname_initname(&fname);
+	dst_key_t *key = NULL;
+	isc_result_t result;
+
+	UNUSED(arg);
+
+	dns_keypool_dump(pool, getstats, &stats);
+	if (stats.available < 2) {
+		return;
+	}
+
+	assert_int_equal(stats.algorithm, DST_ALG_ECDSA256);
+	assert_int_equal(stats.size, 256);
+	assert_int_equal(stats.depth, 2);
+	assert_int_equal(stats.missed, 1);
+	assert_true(stats.generated >= 2);
+
+	/* the key is given the name and flags it is taken for */
+	result = dns_name_fromstring(name, "example.", 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_keypool_get(pool, name, DST_ALG_ECDSA256, 256,
+				 DNS_KEYOWNER_ZONE | DNS_KEYFLAG_KSK,
+				 dns_rdataclass_in, &key);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(dns_name_equal(dst_key_name(key), name));
+	assert_int_equal(dst_key_flags(key),
+			 DNS_KEYOWNER_ZONE | DNS_KEYFLAG_KSK);
+	assert_int_equal(dst_key_alg(key), DST_ALG_ECDSA256);
+	assert_true(dst_key_isprivate(key));
+	dst_key_free(&key);
+
+	dns_keypool_dump(pool, getstats, &stats);
+	assert_int_equal(stats.taken, 1);
+
+	isc_timer_stop(timer);
+	isc_timer_destroy(&timer);
+
+	dns_keypool_shutdown(pool);
+	dns_keypool_detach(&pool);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* asking for a key fills the pool of its algorithm and size */
+ISC_LOOP_TEST_IMPL(keypool_refill) {
+	dst_key_t *key = NULL;
+	isc_interval_t interval;
+	isc_result_t result;
+
+	UNUSED(arg);
+
+	dns_keypool_create(mctx, loopmgr, 2, &pool);
+
+	result = dns_keypool_get(pool, dns_rootname, DST_ALG_ECDSA256, 256,
+				 DNS_KEYOWNER_ZONE, dns_rdataclass_in, &key);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+	assert_null(key);
+
+	isc_interval_set(&interval, 0, 10000000);
+	isc_timer_create(mainloop, refill_tick, NULL, &timer);
+	isc_timer_start(timer, isc_timertype_ticker, &interval);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY_CUSTOM(keypool_empty, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(keypool_refill, setup_test, teardown_test)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -27,6 +27,7 @@
 #include <isc/base64.h>
 #include <isc/buffer.h>
 #include <isc/md.h>
+#include <isc/rcu.h>
 #include <isc/util.h>
 
 #include <dns/fixedname.h>
@@ -576,6 +577,128 @@ ISC_LOOP_TEST_IMPL(issecuredomain) {
 	isc_loopmgr_shutdown(loopmgr);
 }
 
+/* check the lock-free lookups of trust anchors from loop threads */
+ISC_LOOP_TEST_IMPL(snapshot) {
+	dns_fixedname_t fn, ffound;
+	dns_name_t *keyname = dns_fixedname_name(&fn);
+	dns_name_t *found = dns_fixedname_initname(&ffound);
+	unsigned char digest[ISC_MAX_MD_SIZE];
+	dns_rdata_ds_t ds;
+	bool issecure;
+
+	UNUSED(arg);
+
+	create_tables();
+	assert_true(isc_rcu_available());
+
+	dns_test_namefromstring("sub.example.com", &fn);
+	create_dsstruct(keyname, 257, 3, 5, keystr1, digest, &ds);
+	assert_int_equal(dns_keytable_add(keytable, false, false, keyname, &ds,
+					  NULL, NULL),
+			 ISC_R_SUCCESS);
+
+	/* The deepest trust anchor is found */
+	assert_int_equal(dns_keytable_finddeepestmatch(
+				 keytable, str2name("a.b.sub.example.com"),
+				 found),
+			 ISC_R_SUCCESS);
+	assert_true(dns_name_equal(found, keyname));
+	assert_int_equal(dns_keytable_finddeepestmatch(
+				 keytable, str2name("a.example.com"), found),
+			 ISC_R_SUCCESS);
+	assert_true(dns_name_equal(found, str2name("example.com")));
+	assert_int_equal(dns_keytable_finddeepestmatch(
+				 keytable, str2name("com"), found),
+			 ISC_R_NOTFOUND);
+
+	/* Names are matched without regard to case */
+	assert_int_equal(dns_keytable_issecuredomain(
+				 keytable, str2name("A.SUB.Example.COM"), found,
+				 &issecure),
+			 ISC_R_SUCCESS);
+	assert_true(issecure);
+	assert_true(dns_name_equal(found, keyname));
+
+	/* Changes to the table are seen at once */
+	assert_int_equal(dns_keytable_delete(keytable, keyname, NULL, NULL),
+			 ISC_R_SUCCESS);
+	assert_int_equal(dns_keytable_finddeepestmatch(
+				 keytable, str2name("a.sub.example.com"), found),
+			 ISC_R_SUCCESS);
+	assert_true(dns_name_equal(found, str2name("example.com")));
+	assert_int_equal(dns_keytable_delete(keytable, str2name("example.com"),
+					     NULL, NULL),
+			 ISC_R_SUCCESS);
+	assert_int_equal(dns_keytable_issecuredomain(
+				 keytable, str2name("a.sub.example.com"), NULL,
+				 &issecure),
+			 ISC_R_SUCCESS);
+	assert_false(issecure);
+
+	destroy_tables();
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* check the lock-free lookups of NTAs from loop threads */
+ISC_LOOP_TEST_IMPL(nta_snapshot) {
+	dns_fixedname_t fanchor, fsub;
+	dns_name_t *anchor = dns_fixedname_name(&fanchor);
+	dns_name_t *sub = dns_fixedname_name(&fsub);
+	isc_stdtime_t now;
+
+	UNUSED(arg);
+
+	create_tables();
+	assert_true(isc_rcu_available());
+
+	isc_stdtime_get(&now);
+	dns_test_namefromstring("example", &fanchor);
+	dns_test_namefromstring("x.insecure.example", &fsub);
+
+	/* NTAs at or below the trust anchor cover the names below them */
+	assert_true(dns_ntatable_covered(ntatable, now,
+					 str2name("a.x.insecure.example"),
+					 anchor));
+	assert_true(dns_ntatable_covered(
+		ntatable, now, str2name("insecure.example"), anchor));
+	assert_false(dns_ntatable_covered(ntatable, now,
+					  str2name("secure.example"), anchor));
+
+	/* Names are matched without regard to case */
+	assert_true(dns_ntatable_covered(
+		ntatable, now, str2name("A.INSECURE.Example"), anchor));
+
+	/* An NTA above the trust anchor only covers its own name */
+	assert_false(dns_ntatable_covered(
+		ntatable, now, str2name("a.x.insecure.example"), sub));
+
+	/*
+	 * An expired NTA is deleted by the lookup, which then goes on
+	 * with the NTA above it.
+	 */
+	assert_int_equal(dns_ntatable_add(ntatable, sub, false, now, 1),
+			 ISC_R_SUCCESS);
+	assert_true(dns_ntatable_covered(ntatable, now,
+					 str2name("a.x.insecure.example"), sub));
+	assert_true(dns_ntatable_covered(ntatable, now + 2,
+					 str2name("a.x.insecure.example"),
+					 anchor));
+	assert_false(dns_ntatable_covered(
+		ntatable, now, str2name("a.x.insecure.example"), sub));
+
+	/* Once the last NTA has expired, nothing is covered */
+	assert_false(dns_ntatable_covered(ntatable, now + 7200,
+					  str2name("a.x.insecure.example"),
+					  anchor));
+	assert_false(dns_ntatable_covered(
+		ntatable, now, str2name("a.x.insecure.example"), anchor));
+
+	destroy_tables();
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
 /* check dns_keytable_dump() */
 ISC_LOOP_TEST_IMPL(dump) {
 	FILE *f = fopen("/dev/null", "w");
@@ -708,6 +831,8 @@ ISC_TEST_ENTRY_CUSTOM(delete, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(deletekey, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(find, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(issecuredomain, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(snapshot, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(nta_snapshot, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(dump, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(nta, setup_test, teardown_test)
 ISC_TEST_LIST_END
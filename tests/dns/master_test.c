@@ -24,8 +24,11 @@
 #include <cmocka.h>
 
 #include <isc/dir.h>
+#include <isc/loop.h>
+#include <isc/os.h>
 #include <isc/print.h>
 #include <isc/string.h>
+#include <isc/task.h>
 #include <isc/util.h>
 
 #include <dns/cache.h>
@@ -412,6 +415,69 @@ ISC_RUN_TEST_IMPL(totext) {
 	 */
 }
 
+static void
+address_totext(dns_rdatatype_t type, unsigned char *data,
+	       unsigned int length, dns_masterstyle_flags_t flags,
+	       const char *expected) {
+	isc_result_t result;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdataset_t rdataset;
+	dns_rdatalist_t rdatalist;
+	dns_master_style_t *style = NULL;
+	isc_buffer_t target;
+	char buf[BIGBUFLEN];
+
+	dns_rdata_fromregion(&rdata, dns_rdataclass_in, type,
+			     &(isc_region_t){ data, length });
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = type;
+	rdatalist.ttl = 300;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+
+	dns_rdataset_init(&rdataset);
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+
+	result = dns_master_stylecreate(&style, flags, 24, 32, 40, 48, 80, 8,
+					0, mctx);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_buffer_init(&target, buf, sizeof(buf) - 1);
+	result = dns_master_rdatasettotext(dns_rootname, &rdataset, style,
+					   NULL, &target);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	buf[isc_buffer_usedlength(&target)] = '\0';
+
+	/* the address is the last thing on the line */
+	assert_non_null(strstr(buf, expected));
+	assert_int_equal(strcspn(strstr(buf, expected), "\n"),
+			 strlen(expected));
+
+	dns_master_styledestroy(&style, mctx);
+	dns_rdataset_disassociate(&rdataset);
+}
+
+/*
+ * Address totext test:
+ * A and AAAA records are written as the rdata type code would write them
+ */
+ISC_RUN_TEST_IMPL(totext_address) {
+	unsigned char a[4] = { 192, 0, 2, 1 };
+	unsigned char aaaa[16] = { 0x20, 0x01, 0x0d, 0xb8 };
+
+	UNUSED(state);
+
+	address_totext(dns_rdatatype_a, a, sizeof(a), 0, "192.0.2.1");
+	address_totext(dns_rdatatype_aaaa, aaaa, sizeof(aaaa), 0,
+		       "2001:db8::");
+	address_totext(dns_rdatatype_aaaa, aaaa, sizeof(aaaa),
+		       DNS_STYLEFLAG_EXPANDAAAA,
+		       "2001:0db8:0000:0000:0000:0000:0000:0000");
+	address_totext(dns_rdatatype_aaaa, aaaa, sizeof(aaaa),
+		       DNS_STYLEFLAG_YAML, "2001:db8::0");
+}
+
 /*
  * Raw load test:
  * dns_master_loadfile() loads a valid raw file and returns success
@@ -495,7 +561,9 @@ ISC_RUN_TEST_IMPL(dumpraw) {
 			     nullmsg);
 	assert_string_equal(isc_result_totext(result), "success");
 	assert_true(headerset);
-	assert_int_equal(header.flags, 0);
+	assert_int_equal(header.flags & ~(DNS_MASTERRAW_SLABFIXED |
+					  DNS_MASTERRAW_SIGTIMES),
+			 0);
 
 	dns_master_initrawheader(&header);
 	header.sourceserial = 12345;
@@ -518,6 +586,240 @@ ISC_RUN_TEST_IMPL(dumpraw) {
 	dns_db_detach(&db);
 }
 
+/* Load 'file' into a new zone database and dump it as text to 'text' */
+static void
+dumptext(const char *file, dns_masterformat_t format, const char *text) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_dbversion_t *version = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+
+	result = dns_name_fromstring(name, TEST_ORIGIN, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_create(mctx, "rbt", name, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_load(db, file, format, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_db_currentversion(db, &version);
+	result = dns_master_dump(mctx, db, version, &dns_master_style_default,
+				 text, dns_masterformat_text, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_db_closeversion(db, &version, false);
+	dns_db_detach(&db);
+}
+
+/* Return the format version in the header of the raw file 'file' */
+static uint32_t
+rawversion(const char *file) {
+	unsigned char data[8];
+	FILE *fp = fopen(file, "r");
+
+	assert_non_null(fp);
+	assert_int_equal(fread(data, 1, sizeof(data), fp), sizeof(data));
+	fclose(fp);
+
+	return ((uint32_t)data[4] << 24 | data[5] << 16 | data[6] << 8 |
+		data[7]);
+}
+
+static void
+compare_files(const char *file1, const char *file2) {
+	char buf1[BIGBUFLEN], buf2[BIGBUFLEN];
+	size_t len1, len2;
+	FILE *fp;
+
+	fp = fopen(file1, "r");
+	assert_non_null(fp);
+	len1 = fread(buf1, 1, sizeof(buf1), fp);
+	fclose(fp);
+
+	fp = fopen(file2, "r");
+	assert_non_null(fp);
+	len2 = fread(buf2, 1, sizeof(buf2), fp);
+	fclose(fp);
+
+	assert_true(len1 > 0);
+	assert_int_equal(len1, len2);
+	assert_memory_equal(buf1, buf2, len1);
+}
+
+/*
+ * Raw dump test, version 2:
+ * a zone dumped as slabs loads back as it was, like version 1
+ */
+ISC_RUN_TEST_IMPL(dumprawslab) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_dbversion_t *version = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	FILE *fp = NULL;
+
+	UNUSED(state);
+
+	result = isc_dir_chdir(BUILDDIR);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	fp = fopen("test.slab", "w");
+	assert_non_null(fp);
+	fprintf(fp, "$TTL 300\n"
+		    "@ SOA ns hostmaster 1 3600 1800 604800 300\n"
+		    "@ NS ns\n"
+		    "ns A 10.0.0.3\n"
+		    "ns A 10.0.0.1\n"
+		    "ns A 10.0.0.2\n"
+		    "ns A 10.0.0.1\n"
+		    "@ TXT \"two\" \"strings\"\n"
+		    "@ TXT \"\"\n"
+		    "@ RRSIG SOA 8 1 300 20300101000000 20200101000000 "
+		    "29238 test. AAAA\n"
+		    "@ RRSIG NS 8 1 300 20300101000000 20200101000000 "
+		    "29238 test. AAAB\n"
+		    "@ RRSIG NS 8 1 300 20300101000000 20200101000000 "
+		    "12345 test. AAAC\n"
+		    "sub NS ns.sub\n"
+		    "ns.sub AAAA 2001:db8::1\n");
+	fclose(fp);
+
+	result = dns_name_fromstring(name, TEST_ORIGIN, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_create(mctx, "rbt", name, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_load(db, "test.slab", dns_masterformat_text, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_currentversion(db, &version);
+
+	result = dns_master_dump(mctx, db, version, &dns_master_style_default,
+				 "test.text", dns_masterformat_text, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_master_dump(mctx, db, version, &dns_master_style_default,
+				 "test.raw2", dns_masterformat_raw, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(rawversion("test.raw2"), 2);
+
+	dns_master_initrawheader(&header);
+	header.flags = DNS_MASTERRAW_COMPAT1;
+	result = dns_master_dump(mctx, db, version, &dns_master_style_default,
+				 "test.raw1", dns_masterformat_raw, &header);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(rawversion("test.raw1"), 1);
+
+	dns_db_closeversion(db, &version, false);
+	dns_db_detach(&db);
+
+	dumptext("test.raw2", dns_masterformat_raw, "test.text2");
+	compare_files("test.text", "test.text2");
+
+	dumptext("test.raw1", dns_masterformat_raw, "test.text1");
+	compare_files("test.text", "test.text1");
+
+	unlink("test.slab");
+	unlink("test.text");
+	unlink("test.raw1");
+	unlink("test.raw2");
+	unlink("test.text1");
+	unlink("test.text2");
+}
+
+/* Load 'file' with re-signing times and return the earliest one */
+static isc_stdtime_t
+signingtime(const char *file, dns_masterformat_t format) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_rdataset_t rdataset;
+	dns_fixedname_t fixed, ffound;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	dns_name_t *found = dns_fixedname_initname(&ffound);
+	isc_stdtime_t when;
+
+	result = dns_name_fromstring(name, TEST_ORIGIN, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_create(mctx, "rbt", name, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_load(db, file, format, DNS_MASTER_RESIGN);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdataset_init(&rdataset);
+	result = dns_db_getsigningtime(db, &rdataset, found);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(rdataset.covers, dns_rdatatype_ns);
+	when = rdataset.resign;
+	dns_rdataset_disassociate(&rdataset);
+	dns_db_detach(&db);
+
+	return (when);
+}
+
+/*
+ * Raw dump test, signature times:
+ * the re-signing times of RRSIG sets loaded from a version 2 raw file
+ * are those computed from the signatures themselves
+ */
+ISC_RUN_TEST_IMPL(dumprawsigtimes) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_dbversion_t *version = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	unsigned char data[16];
+	isc_stdtime_t when;
+	FILE *fp = NULL;
+
+	UNUSED(state);
+
+	result = isc_dir_chdir(BUILDDIR);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	fp = fopen("test.sigs", "w");
+	assert_non_null(fp);
+	fprintf(fp, "$TTL 300\n"
+		    "@ SOA ns hostmaster 1 3600 1800 604800 300\n"
+		    "@ NS ns\n"
+		    "ns A 10.0.0.1\n"
+		    "@ RRSIG SOA 8 1 300 20300101000000 20200101000000 "
+		    "29238 test. AAAA\n"
+		    "@ RRSIG NS 8 1 300 20300101000000 20200101000000 "
+		    "29238 test. AAAB\n"
+		    "@ RRSIG NS 8 1 300 20290101000000 20200101000000 "
+		    "12345 test. AAAC\n");
+	fclose(fp);
+
+	when = signingtime("test.sigs", dns_masterformat_text);
+
+	result = dns_name_fromstring(name, TEST_ORIGIN, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_create(mctx, "rbt", name, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_load(db, "test.sigs", dns_masterformat_text, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_currentversion(db, &version);
+	result = dns_master_dump(mctx, db, version, &dns_master_style_default,
+				 "test.sigs.raw", dns_masterformat_raw, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_closeversion(db, &version, false);
+	dns_db_detach(&db);
+
+	fp = fopen("test.sigs.raw", "r");
+	assert_non_null(fp);
+	assert_int_equal(fread(data, 1, sizeof(data), fp), sizeof(data));
+	fclose(fp);
+	assert_true((data[15] & DNS_MASTERRAW_SIGTIMES) != 0);
+
+	assert_int_equal(signingtime("test.sigs.raw", dns_masterformat_raw),
+			 when);
+
+	unlink("test.sigs");
+	unlink("test.sigs.raw");
+}
+
 static const char *warn_expect_value;
 static bool warn_expect_result;
 
@@ -556,6 +858,177 @@ ISC_RUN_TEST_IMPL(neworigin) {
 	assert_true(warn_expect_result);
 }
 
+/*
+ * Parallel load test:
+ * dns_master_loadfileinc() makes the same calls as dns_master_loadfile()
+ * when it splits a large file into chunks
+ */
+#define PARALLEL_FILE "test.parallel"
+
+static dns_fixedname_t parallel_fixed;
+static dns_name_t *parallel_origin = NULL;
+static isc_buffer_t *serial_log = NULL;
+static isc_buffer_t *parallel_log = NULL;
+static dns_rdatacallbacks_t parallel_callbacks;
+static dns_loadctx_t *parallel_lctx = NULL;
+static isc_task_t *parallel_task = NULL;
+
+static isc_result_t
+record_add(void *arg, const dns_name_t *owner, dns_rdataset_t *dataset) {
+	isc_buffer_t *log = arg;
+	char buf[BIGBUFLEN];
+	isc_buffer_t target;
+	isc_result_t result;
+
+	isc_buffer_init(&target, buf, sizeof(buf));
+	result = dns_rdataset_totext(dataset, owner, false, false, &target);
+	if (result == ISC_R_SUCCESS) {
+		isc_buffer_putmem(log, (unsigned char *)buf,
+				  isc_buffer_usedlength(&target));
+	}
+	return (result);
+}
+
+static void
+record_msg(dns_rdatacallbacks_t *cb, const char *fmt, ...) {
+	isc_buffer_t *log = cb->warn_private;
+	char buf[4096];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+
+	isc_buffer_putstr(log, buf);
+	isc_buffer_putstr(log, "\n");
+}
+
+static void
+record_init(dns_rdatacallbacks_t *cb, isc_buffer_t **logp) {
+	isc_buffer_allocate(mctx, logp, BIGBUFLEN);
+	isc_buffer_setautorealloc(*logp, true);
+
+	dns_rdatacallbacks_init(cb);
+	cb->add = record_add;
+	cb->warn = record_msg;
+	cb->error = record_msg;
+	cb->add_private = *logp;
+	cb->warn_private = *logp;
+	cb->error_private = *logp;
+}
+
+/*
+ * Write a zone of several MB, with origin and TTL changes, delegations
+ * with glue, multi-line records and records giving warnings.
+ */
+static void
+write_parallel(void) {
+	FILE *f = fopen(PARALLEL_FILE, "w");
+
+	assert_non_null(f);
+	fprintf(f, "$ORIGIN test.\n$TTL 3600\n"
+		   "@ SOA ns1 hostmaster ( 1 3600 900 604800 300 )\n"
+		   "  NS ns1\nns1 A 192.0.2.1\n");
+	for (unsigned int i = 0; i < 30000; i++) {
+		if (i % 1000 == 0) {
+			fprintf(f, "$ORIGIN o%u.test.\n", i / 1000);
+		}
+		if (i % 997 == 0) {
+			fprintf(f, "$TTL %u ; default\n", 600 + i);
+		}
+		fprintf(f,
+			"name%u A 192.0.2.%u\n"
+			"\tAAAA 2001:db8::%x\n"
+			"name%u 300 TXT \"semi;colon (paren\" \"x\\\"y\"\n"
+			"name%u MX ( 10 ; comment (\n"
+			"mx%u )\n",
+			i, i % 256, i, i, i, i);
+		if (i % 17 == 0) {
+			fprintf(f, "name%u.o%u.test. TXT absolute\n", i,
+				i / 1000);
+		}
+		if (i % 3 == 0) {
+			fprintf(f, "deleg%u NS ns1.deleg%u\n", i, i);
+			for (unsigned int j = 2; j <= 6; j++) {
+				fprintf(f, "\tNS ns%u.deleg%u\n", j, i);
+			}
+			for (unsigned int j = 1; j <= 6; j++) {
+				fprintf(f, "ns%u.deleg%u A 192.0.2.%u\n", j, i,
+					j);
+			}
+		}
+		if (i % 11 == 0) {
+			fprintf(f, "multi%u 60 A 192.0.2.1\n\tA 192.0.2.2\n",
+				i);
+		}
+		if (i % 13 == 0 && i > 0) {
+			fprintf(f, "name%u TXT again\n", i - 1);
+		}
+	}
+	assert_int_equal(fclose(f), 0);
+}
+
+static void
+parallel_done(void *arg, isc_result_t result) {
+	UNUSED(arg);
+
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(isc_buffer_usedlength(parallel_log),
+			 isc_buffer_usedlength(serial_log));
+	assert_memory_equal(isc_buffer_base(parallel_log),
+			    isc_buffer_base(serial_log),
+			    isc_buffer_usedlength(serial_log));
+
+	isc_buffer_free(&serial_log);
+	isc_buffer_free(&parallel_log);
+	dns_loadctx_detach(&parallel_lctx);
+	isc_task_detach(&parallel_task);
+	unlink(PARALLEL_FILE);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+ISC_LOOP_TEST_IMPL(parallel) {
+	dns_rdatacallbacks_t serial_callbacks;
+	isc_result_t result;
+
+	UNUSED(arg);
+
+	if (isc_os_ncpus() < 2) {
+		/*
+		 * The file is loaded serially, which commits the pending
+		 * RRsets at the end of each quantum.
+		 */
+		isc_loopmgr_shutdown(loopmgr);
+		return;
+	}
+
+	result = isc_dir_chdir(BUILDDIR);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	write_parallel();
+
+	parallel_origin = dns_fixedname_initname(&parallel_fixed);
+	result = dns_name_fromstring(parallel_origin, TEST_ORIGIN, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	record_init(&serial_callbacks, &serial_log);
+	result = dns_master_loadfile(PARALLEL_FILE, parallel_origin,
+				     parallel_origin, dns_rdataclass_in, 0, 0,
+				     &serial_callbacks, NULL, NULL, mctx,
+				     dns_masterformat_text, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	record_init(&parallel_callbacks, &parallel_log);
+	result = isc_task_create(taskmgr, &parallel_task, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_master_loadfileinc(
+		PARALLEL_FILE, parallel_origin, parallel_origin,
+		dns_rdataclass_in, 0, 0, &parallel_callbacks, parallel_task,
+		parallel_done, NULL, &parallel_lctx, NULL, NULL, mctx,
+		dns_masterformat_text, 0);
+	assert_int_equal(result, DNS_R_CONTINUE);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(load)
 ISC_TEST_ENTRY(unexpected)
@@ -570,11 +1043,15 @@ ISC_TEST_ENTRY(includefail)
 ISC_TEST_ENTRY(blanklines)
 ISC_TEST_ENTRY(leadingzero)
 ISC_TEST_ENTRY(totext)
+ISC_TEST_ENTRY(totext_address)
 ISC_TEST_ENTRY(loadraw)
 ISC_TEST_ENTRY(dumpraw)
+ISC_TEST_ENTRY(dumprawslab)
+ISC_TEST_ENTRY(dumprawsigtimes)
 ISC_TEST_ENTRY(toobig)
 ISC_TEST_ENTRY(maxrdata)
 ISC_TEST_ENTRY(neworigin)
+ISC_TEST_ENTRY_CUSTOM(parallel, setup_managers, teardown_managers)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
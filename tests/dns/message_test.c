@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/buffer.h>
+#include <isc/util.h>
+
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/rdataset.h>
+
+#include <tests/dns.h>
+
+/*
+ * An IXFR query for "example." carrying a SOA record in the
+ * authority section.
+ */
+static unsigned char ixfrquery[] = {
+	0x12, 0x34, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x00,
+	0x00, 0x07, 'e',  'x',	'a',  'm',  'p',  'l',	'e',  0x00, 0x00,
+	0xfb, 0x00, 0x01, 0xc0, 0x0c, 0x00, 0x06, 0x00, 0x01, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x18, 0xc0, 0x0c, 0xc0, 0x0c, 0x00, 0x00, 0x00,
+	0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+static isc_result_t
+parse(dns_message_t *msg, unsigned char *data, size_t length,
+      unsigned int options) {
+	isc_buffer_t source;
+
+	isc_buffer_init(&source, data, length);
+	isc_buffer_add(&source, length);
+
+	return (dns_message_parse(msg, &source, options));
+}
+
+/* deferred sections are parsed on first access */
+ISC_RUN_TEST_IMPL(dns_message_parse_lazy) {
+	dns_message_t *msg = NULL;
+	dns_name_t *name = NULL;
+	dns_rdataset_t *rdataset = NULL;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE, &msg);
+
+	result = parse(msg, ixfrquery, sizeof(ixfrquery),
+		       DNS_MESSAGEPARSE_LAZY);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(msg->counts[DNS_SECTION_AUTHORITY], 1);
+	assert_true(ISC_LIST_EMPTY(msg->sections[DNS_SECTION_AUTHORITY]));
+
+	result = dns_message_firstname(msg, DNS_SECTION_QUESTION);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_message_firstname(msg, DNS_SECTION_AUTHORITY);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_message_currentname(msg, DNS_SECTION_AUTHORITY, &name);
+	rdataset = ISC_LIST_HEAD(name->list);
+	assert_non_null(rdataset);
+	assert_int_equal(rdataset->type, dns_rdatatype_soa);
+	assert_int_equal(dns_rdataset_count(rdataset), 1);
+
+	result = dns_message_firstname(msg, DNS_SECTION_ANSWER);
+	assert_int_equal(result, ISC_R_NOMORE);
+
+	dns_message_detach(&msg);
+}
+
+/* malformed deferred sections are still rejected by the parser */
+ISC_RUN_TEST_IMPL(dns_message_parse_lazy_truncated) {
+	dns_message_t *msg = NULL;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE, &msg);
+
+	result = parse(msg, ixfrquery, sizeof(ixfrquery) - 4,
+		       DNS_MESSAGEPARSE_LAZY);
+	assert_int_equal(result, ISC_R_UNEXPECTEDEND);
+
+	dns_message_detach(&msg);
+}
+
+/* temporary objects are recycled within the message */
+ISC_RUN_TEST_IMPL(dns_message_tempobjects) {
+	dns_message_t *msg = NULL;
+	dns_name_t *name = NULL, *name2 = NULL;
+	dns_rdataset_t *rdataset = NULL, *rdataset2 = NULL;
+	dns_name_t *saved = NULL;
+	dns_rdataset_t *savedrds = NULL;
+
+	UNUSED(state);
+
+	dns_message_create(mctx, DNS_MESSAGE_INTENTRENDER, &msg);
+
+	dns_message_gettempname(msg, &name);
+	dns_message_gettemprdataset(msg, &rdataset);
+	saved = name;
+	savedrds = rdataset;
+	dns_message_puttempname(msg, &name);
+	dns_message_puttemprdataset(msg, &rdataset);
+	assert_null(name);
+	assert_null(rdataset);
+
+	dns_message_gettempname(msg, &name);
+	dns_message_gettemprdataset(msg, &rdataset);
+	assert_ptr_equal(name, saved);
+	assert_ptr_equal(rdataset, savedrds);
+	assert_false(dns_rdataset_isassociated(rdataset));
+
+	dns_message_gettempname(msg, &name2);
+	dns_message_gettemprdataset(msg, &rdataset2);
+	assert_ptr_not_equal(name, name2);
+	assert_ptr_not_equal(rdataset, rdataset2);
+
+	dns_message_puttempname(msg, &name);
+	dns_message_puttempname(msg, &name2);
+	dns_message_puttemprdataset(msg, &rdataset);
+	dns_message_puttemprdataset(msg, &rdataset2);
+
+	dns_message_reset(msg, DNS_MESSAGE_INTENTRENDER);
+	dns_message_detach(&msg);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY(dns_message_parse_lazy)
+ISC_TEST_ENTRY(dns_message_parse_lazy_truncated)
+ISC_TEST_ENTRY(dns_message_tempobjects)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
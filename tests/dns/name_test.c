@@ -200,11 +200,11 @@ ISC_RUN_TEST_IMPL(compression) {
 	unsigned char plain[] = "\003yyy\003foo\0\003bar\003yyy\003foo\0\003"
 				"bar\003yyy\003foo\0\003xxx\003bar\003foo";
 	/*
-	 * Note: foo in xxx.bar.foo is not compressed because dns_compress_find
-	 * only looks for the name and name less the leading label.
+	 * Note: bar.foo in xxx.bar.foo is not compressed, as it was only
+	 * rendered as part of bar.yyy.foo, but foo is.
 	 */
 	unsigned char compressed[] = "\003yyy\003foo\0\003bar\xc0\x00\xc0\x09"
-				     "\003xxx\003bar\003foo";
+				     "\003xxx\003bar\xc0\x04";
 	/*
 	 * Only the second owner name is compressed.
 	 */
@@ -213,6 +213,8 @@ ISC_RUN_TEST_IMPL(compression) {
 		"\xc0\x09\003xxx\003bar\003foo";
 	unsigned char root_plain[] = "\003yyy\003foo\0\0\0"
 				     "\003xxx\003bar\003foo";
+	unsigned char root_compressed[] = "\003yyy\003foo\0\0\0"
+					  "\003xxx\003bar\xc0\x04";
 
 	UNUSED(state);
 
@@ -249,8 +251,9 @@ ISC_RUN_TEST_IMPL(compression) {
 	dns_compress_setpermitted(&cctx, permitted);
 	dctx = dns_decompress_setpermitted(DNS_DECOMPRESS_DEFAULT, permitted);
 
-	compress_test(&name1, &name2, &name3, compressed, sizeof(compressed),
-		      plain, sizeof(plain), &cctx, dctx, true);
+	compress_test(&name1, &name2, &name3, compressed,
+		      sizeof(compressed) - 1, plain, sizeof(plain), &cctx, dctx,
+		      true);
 
 	dns_compress_rollback(&cctx, 0);
 	dns_compress_invalidate(&cctx);
@@ -287,9 +290,9 @@ ISC_RUN_TEST_IMPL(compression) {
 	dns_compress_setpermitted(&cctx, permitted);
 	dctx = dns_decompress_setpermitted(DNS_DECOMPRESS_DEFAULT, permitted);
 
-	compress_test(&name1, dns_rootname, &name3, root_plain,
-		      sizeof(root_plain), root_plain, sizeof(root_plain), &cctx,
-		      dctx, true);
+	compress_test(&name1, dns_rootname, &name3, root_compressed,
+		      sizeof(root_compressed) - 1, root_plain,
+		      sizeof(root_plain), &cctx, dctx, true);
 
 	dns_compress_rollback(&cctx, 0);
 	dns_compress_invalidate(&cctx);
@@ -312,8 +315,9 @@ ISC_RUN_TEST_IMPL(compression) {
 	dns_compress_setpermitted(&cctx, permitted);
 	dctx = dns_decompress_setpermitted(DNS_DECOMPRESS_DEFAULT, permitted);
 
-	compress_test(&name1, &name2, &name3, compressed, sizeof(compressed),
-		      plain, sizeof(plain), &cctx, dctx, false);
+	compress_test(&name1, &name2, &name3, compressed,
+		      sizeof(compressed) - 1, plain, sizeof(plain), &cctx, dctx,
+		      false);
 
 	dns_compress_rollback(&cctx, 0);
 	dns_compress_invalidate(&cctx);
@@ -351,9 +355,9 @@ ISC_RUN_TEST_IMPL(compression) {
 	dns_compress_setpermitted(&cctx, permitted);
 	dctx = dns_decompress_setpermitted(DNS_DECOMPRESS_DEFAULT, permitted);
 
-	compress_test(&name1, dns_rootname, &name3, root_plain,
-		      sizeof(root_plain), root_plain, sizeof(root_plain), &cctx,
-		      dctx, false);
+	compress_test(&name1, dns_rootname, &name3, root_compressed,
+		      sizeof(root_compressed) - 1, root_plain,
+		      sizeof(root_plain), &cctx, dctx, false);
 
 	dns_compress_rollback(&cctx, 0);
 	dns_compress_invalidate(&cctx);
@@ -549,6 +553,46 @@ ISC_RUN_TEST_IMPL(hash) {
 	}
 }
 
+/* hashes cached with DNS_NAME_CACHEHASH */
+ISC_RUN_TEST_IMPL(cachehash) {
+	isc_result_t result;
+	dns_fixedname_t f1, f2, f3;
+	dns_name_t *n1, *n2, *n3;
+	dns_name_t suffix;
+
+	UNUSED(state);
+
+	n1 = dns_fixedname_initname(&f1);
+	n2 = dns_fixedname_initname(&f2);
+	n3 = dns_fixedname_initname(&f3);
+	dns_name_init(&suffix, NULL);
+
+	result = dns_name_fromstring(n1, "WWW.Example.COM.", 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_name_fromstring(n2, "www.example.com.", DNS_NAME_CACHEHASH,
+				     NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_false((n1->attributes & DNS_NAMEATTR_HASHED) != 0);
+	assert_true((n2->attributes & DNS_NAMEATTR_HASHED) != 0);
+	assert_int_equal(dns_name_fullhash(n1, false),
+			 dns_name_fullhash(n2, false));
+
+	/* the hash goes along with copies of the whole name */
+	dns_name_copy(n2, n3);
+	assert_true((n3->attributes & DNS_NAMEATTR_HASHED) != 0);
+	assert_int_equal(n3->hashval, n2->hashval);
+
+	dns_name_getlabelsequence(n2, 0, dns_name_countlabels(n2), &suffix);
+	assert_true((suffix.attributes & DNS_NAMEATTR_HASHED) != 0);
+
+	/* but not with parts of it */
+	dns_name_getlabelsequence(n2, 1, 2, &suffix);
+	assert_false((suffix.attributes & DNS_NAMEATTR_HASHED) != 0);
+
+	dns_name_reset(n3);
+	assert_false((n3->attributes & DNS_NAMEATTR_HASHED) != 0);
+}
+
 /* dns_nane_issubdomain */
 ISC_RUN_TEST_IMPL(issubdomain) {
 	struct {
@@ -807,6 +851,7 @@ ISC_TEST_ENTRY(invalidate)
 ISC_TEST_ENTRY(buffer)
 ISC_TEST_ENTRY(isabsolute)
 ISC_TEST_ENTRY(hash)
+ISC_TEST_ENTRY(cachehash)
 ISC_TEST_ENTRY(issubdomain)
 ISC_TEST_ENTRY(countlabels)
 ISC_TEST_ENTRY(getlabel)
@@ -27,6 +27,7 @@
 
 #include <dns/db.h>
 #include <dns/nsec3.h>
+#include <dns/nsec3cache.h>
 
 #include <tests/dns.h>
 
@@ -146,9 +147,77 @@ ISC_RUN_TEST_IMPL(nsec3param_salttotext) {
 	}
 }
 
+/*
+ * Check that the hash of a name is found in the cache, whatever the
+ * case of the name, and is the one dns_nsec3_hashname() makes.
+ */
+static void
+hashname_test(dns_nsec3cache_t *cache, const char *namestr,
+	      const unsigned char *salt, size_t saltlength, bool hit) {
+	dns_fixedname_t fname, fexpected, fhashed;
+	dns_name_t *name = NULL;
+	uint64_t hits, misses, hits2, misses2;
+	isc_result_t result;
+
+	dns_test_namefromstring(namestr, &fname);
+	name = dns_fixedname_name(&fname);
+	result = dns_nsec3_hashname(&fexpected, NULL, NULL, name, dns_rootname,
+				    dns_hash_sha1, 1, salt, saltlength);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_nsec3cache_getstats(cache, &hits, &misses);
+	result = dns_nsec3cache_hashname(cache, &fhashed, NULL, NULL, name,
+					 dns_rootname, dns_hash_sha1, 1, salt,
+					 saltlength);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_nsec3cache_getstats(cache, &hits2, &misses2);
+
+	assert_int_equal(hits2, hits + (hit ? 1 : 0));
+	assert_int_equal(misses2, misses + (hit ? 0 : 1));
+	assert_true(dns_name_equal(dns_fixedname_name(&fhashed),
+				   dns_fixedname_name(&fexpected)));
+}
+
+/* check the NSEC3 hash cache */
+ISC_RUN_TEST_IMPL(nsec3cache) {
+	dns_nsec3cache_t *cache = NULL;
+	const unsigned char salt[] = { 0x01, 0x23 };
+
+	UNUSED(state);
+
+	/* A single bucket. */
+	dns_nsec3cache_create(mctx, DNS_NSEC3CACHE_WAYS, &cache);
+
+	hashname_test(cache, "example.", salt, sizeof(salt), false);
+	hashname_test(cache, "example.", salt, sizeof(salt), true);
+	hashname_test(cache, "EXAMPLE.", salt, sizeof(salt), true);
+
+	/* Other parameters make other hashes. */
+	hashname_test(cache, "example.", salt, 1, false);
+	hashname_test(cache, "example.", salt, 1, true);
+	hashname_test(cache, "example.", NULL, 0, false);
+
+	/*
+	 * A name that was looked up again is not the first one pushed out
+	 * by names looked up once.
+	 */
+	hashname_test(cache, "example.", NULL, 0, true);
+	for (unsigned int i = 0; i < DNS_NSEC3CACHE_WAYS; i++) {
+		char namestr[DNS_NAME_FORMATSIZE];
+
+		snprintf(namestr, sizeof(namestr), "random%u.example.", i);
+		hashname_test(cache, namestr, NULL, 0, false);
+	}
+	hashname_test(cache, "example.", NULL, 0, true);
+
+	dns_nsec3cache_destroy(&cache);
+	assert_null(cache);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(max_iterations)
 ISC_TEST_ENTRY(nsec3param_salttotext)
+ISC_TEST_ENTRY(nsec3cache)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
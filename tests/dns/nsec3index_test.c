@@ -0,0 +1,392 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/base32.h>
+#include <isc/buffer.h>
+#include <isc/stdtime.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/nsec3.h>
+#include <dns/nsec3index.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+
+#include <tests/dns.h>
+
+#define HASHLEN 20
+#define NOW	1000000
+#define TTL	300
+
+/* A name in the zone and the types at it */
+typedef struct {
+	const char *name;
+	const char *types;
+} node_t;
+
+/* The hashes of the last chain added, in chain order */
+static unsigned char chain[8][HASHLEN];
+static size_t chainlen;
+
+static void
+hashname(const char *namestr, const char *zonestr, unsigned int iterations,
+	 unsigned char *hash, dns_fixedname_t *fowner) {
+	dns_fixedname_t fname, fzone, fhashed;
+	size_t hashlen = 0;
+	isc_result_t result;
+
+	dns_test_namefromstring(namestr, &fname);
+	dns_test_namefromstring(zonestr, &fzone);
+
+	result = dns_nsec3_hashname(fowner != NULL ? fowner : &fhashed, hash,
+				    &hashlen, dns_fixedname_name(&fname),
+				    dns_fixedname_name(&fzone), 1, iterations,
+				    NULL, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(hashlen, HASHLEN);
+}
+
+static isc_result_t
+add_range(dns_nsec3index_t *index, const dns_name_t *owner,
+	  const unsigned char *next, unsigned int flags,
+	  unsigned int iterations, const char *types, dns_ttl_t ttl) {
+	unsigned char buf[1024];
+	char nexttext[64], text[256];
+	isc_region_t region = { .length = HASHLEN };
+	isc_buffer_t buffer;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	isc_result_t result;
+
+	DE_CONST(next, region.base);
+	isc_buffer_init(&buffer, nexttext, sizeof(nexttext) - 1);
+	result = isc_base32hexnp_totext(&region, 0, "", &buffer);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	nexttext[isc_buffer_usedlength(&buffer)] = '\0';
+
+	snprintf(text, sizeof(text), "1 %u %u - %s %s", flags, iterations,
+		 nexttext, types);
+	result = dns_test_rdatafromstring(&rdata, dns_rdataclass_in,
+					  dns_rdatatype_nsec3, buf, sizeof(buf),
+					  text, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = dns_rdatatype_nsec3;
+	rdatalist.ttl = ttl;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+	dns_rdataset_init(&rdataset);
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+
+	result = dns_nsec3index_add(index, owner, &rdataset, NOW);
+
+	dns_rdataset_disassociate(&rdataset);
+
+	return (result);
+}
+
+/*
+ * Add the whole NSEC3 chain of the zone 'zonestr' made of 'nodes'.
+ */
+static void
+add_chain(dns_nsec3index_t *index, const char *zonestr, const node_t *nodes,
+	  size_t count, unsigned int flags, unsigned int iterations) {
+	dns_fixedname_t owners[ARRAY_SIZE(chain)];
+	size_t order[ARRAY_SIZE(chain)];
+
+	assert_true(count <= ARRAY_SIZE(chain));
+
+	for (size_t i = 0; i < count; i++) {
+		hashname(nodes[i].name, zonestr, iterations, chain[i],
+			 &owners[i]);
+		order[i] = i;
+	}
+
+	/* Sort the nodes by hash */
+	for (size_t i = 1; i < count; i++) {
+		for (size_t j = i; j > 0 && memcmp(chain[order[j - 1]],
+						   chain[order[j]],
+						   HASHLEN) > 0;
+		     j--)
+		{
+			size_t tmp = order[j];
+			order[j] = order[j - 1];
+			order[j - 1] = tmp;
+		}
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		size_t cur = order[i], next = order[(i + 1) % count];
+		isc_result_t result = add_range(
+			index, dns_fixedname_name(&owners[cur]), chain[next],
+			flags, iterations, nodes[cur].types, TTL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+
+	/* Keep the hashes in chain order */
+	{
+		unsigned char sorted[ARRAY_SIZE(chain)][HASHLEN];
+
+		for (size_t i = 0; i < count; i++) {
+			memmove(sorted[i], chain[order[i]], HASHLEN);
+		}
+		memmove(chain, sorted, count * HASHLEN);
+		chainlen = count;
+	}
+}
+
+static isc_result_t
+nxdomain(dns_nsec3index_t *index, const char *namestr, isc_stdtime_t now) {
+	dns_fixedname_t fname, fzone;
+	dns_name_t *zone = dns_fixedname_initname(&fzone);
+	isc_result_t result;
+
+	dns_test_namefromstring(namestr, &fname);
+	result = dns_nsec3index_nxdomain(index, dns_fixedname_name(&fname),
+					 now, zone);
+	if (result == ISC_R_SUCCESS) {
+		char zonestr[DNS_NAME_FORMATSIZE];
+
+		dns_name_format(zone, zonestr, sizeof(zonestr));
+		assert_string_equal(zonestr, "example");
+	}
+
+	return (result);
+}
+
+static const node_t example[] = {
+	{ "example.", "NS SOA RRSIG DNSKEY NSEC3PARAM" },
+	{ "www.example.", "A RRSIG" },
+	{ "sub.example.", "NS DS RRSIG" },
+	{ "dname.example.", "DNAME RRSIG" },
+};
+
+/* names that are covered, in and across the end of the chain */
+ISC_RUN_TEST_IMPL(nsec3index_covering) {
+	dns_nsec3index_t *index = NULL;
+	unsigned char hash[HASHLEN];
+	char namestr[DNS_NAME_FORMATSIZE];
+	bool inside = false, wrapped = false;
+
+	dns_nsec3index_create(mctx, &index);
+
+	add_chain(index, "example.", example, ARRAY_SIZE(example), 0, 0);
+	assert_int_equal(dns_nsec3index_count(index), ARRAY_SIZE(example));
+
+	/* names that exist are not proven not to */
+	assert_int_equal(nxdomain(index, "example.", NOW), ISC_R_NOTFOUND);
+	assert_int_equal(nxdomain(index, "www.example.", NOW), ISC_R_NOTFOUND);
+
+	/* the closest encloser can be any name in the zone */
+	assert_int_equal(nxdomain(index, "a.www.example.", NOW),
+			 ISC_R_SUCCESS);
+	assert_int_equal(nxdomain(index, "a.b.c.example.", NOW),
+			 ISC_R_SUCCESS);
+
+	/* names other zones are not known */
+	assert_int_equal(nxdomain(index, "nx.example.org.", NOW),
+			 ISC_R_NOTFOUND);
+
+	/*
+	 * Find names covered by a range inside the chain and by the last
+	 * range, which wraps around to the start of the chain.
+	 */
+	for (unsigned int i = 0; i < 1000 && !(inside && wrapped); i++) {
+		isc_result_t result;
+		bool wraps;
+
+		snprintf(namestr, sizeof(namestr), "nx%u.example.", i);
+		hashname(namestr, "example.", 0, hash, NULL);
+		wraps = memcmp(hash, chain[0], HASHLEN) < 0 ||
+			memcmp(hash, chain[chainlen - 1], HASHLEN) > 0;
+		if ((wraps && wrapped) || (!wraps && inside)) {
+			continue;
+		}
+
+		result = nxdomain(index, namestr, NOW);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		if (wraps) {
+			wrapped = true;
+		} else {
+			inside = true;
+		}
+	}
+	assert_true(inside);
+	assert_true(wrapped);
+
+	dns_nsec3index_destroy(&index);
+	assert_null(index);
+}
+
+/* a wildcard at the closest encloser could match the name */
+ISC_RUN_TEST_IMPL(nsec3index_wildcard) {
+	static const node_t nodes[] = {
+		{ "example.", "NS SOA RRSIG DNSKEY NSEC3PARAM" },
+		{ "*.example.", "A RRSIG" },
+	};
+	dns_nsec3index_t *index = NULL;
+
+	dns_nsec3index_create(mctx, &index);
+
+	add_chain(index, "example.", nodes, ARRAY_SIZE(nodes), 0, 0);
+	assert_int_equal(nxdomain(index, "nx.example.", NOW), ISC_R_NOTFOUND);
+
+	dns_nsec3index_destroy(&index);
+}
+
+/* names below a delegation or a DNAME are not in the zone */
+ISC_RUN_TEST_IMPL(nsec3index_delegation) {
+	static const node_t nodes[] = {
+		{ "example.", "NS SOA RRSIG DNSKEY NSEC3PARAM" },
+		{ "insecure.example.", "NS" },
+	};
+	dns_nsec3index_t *index = NULL;
+
+	dns_nsec3index_create(mctx, &index);
+
+	add_chain(index, "example.", example, ARRAY_SIZE(example), 0, 0);
+	assert_int_equal(nxdomain(index, "host.sub.example.", NOW),
+			 ISC_R_NOTFOUND);
+	assert_int_equal(nxdomain(index, "a.b.sub.example.", NOW),
+			 ISC_R_NOTFOUND);
+	assert_int_equal(nxdomain(index, "host.dname.example.", NOW),
+			 ISC_R_NOTFOUND);
+
+	/* the delegations themselves exist */
+	assert_int_equal(nxdomain(index, "sub.example.", NOW),
+			 ISC_R_NOTFOUND);
+
+	/* a delegation without DS is not an encloser either */
+	dns_nsec3index_flush(index);
+	add_chain(index, "example.", nodes, ARRAY_SIZE(nodes), 0, 0);
+	assert_int_equal(nxdomain(index, "host.insecure.example.", NOW),
+			 ISC_R_NOTFOUND);
+	assert_int_equal(nxdomain(index, "nx.example.", NOW), ISC_R_SUCCESS);
+
+	dns_nsec3index_destroy(&index);
+}
+
+/* opt-out ranges do not prove that there is no insecure delegation */
+ISC_RUN_TEST_IMPL(nsec3index_optout) {
+	dns_nsec3index_t *index = NULL;
+
+	dns_nsec3index_create(mctx, &index);
+
+	add_chain(index, "example.", example, ARRAY_SIZE(example),
+		  DNS_NSEC3FLAG_OPTOUT, 0);
+	assert_int_equal(nxdomain(index, "nx.example.", NOW), ISC_R_NOTFOUND);
+	assert_int_equal(nxdomain(index, "a.www.example.", NOW),
+			 ISC_R_NOTFOUND);
+
+	dns_nsec3index_destroy(&index);
+}
+
+/* ranges are used until their TTL runs out */
+ISC_RUN_TEST_IMPL(nsec3index_expire) {
+	dns_nsec3index_t *index = NULL;
+
+	dns_nsec3index_create(mctx, &index);
+
+	add_chain(index, "example.", example, ARRAY_SIZE(example), 0, 0);
+	assert_int_equal(nxdomain(index, "nx.example.", NOW + TTL - 1),
+			 ISC_R_SUCCESS);
+	assert_int_equal(nxdomain(index, "nx.example.", NOW + TTL),
+			 ISC_R_NOTFOUND);
+
+	dns_nsec3index_destroy(&index);
+}
+
+/* a record from a new chain replaces the ranges of the old one */
+ISC_RUN_TEST_IMPL(nsec3index_newchain) {
+	dns_nsec3index_t *index = NULL;
+	dns_fixedname_t fowner;
+	unsigned char hash[HASHLEN];
+	isc_result_t result;
+
+	dns_nsec3index_create(mctx, &index);
+
+	add_chain(index, "example.", example, ARRAY_SIZE(example), 0, 0);
+	assert_int_equal(nxdomain(index, "nx.example.", NOW), ISC_R_SUCCESS);
+
+	/* one record made with other parameters */
+	hashname("www.example.", "example.", 1, hash, &fowner);
+	result = add_range(index, dns_fixedname_name(&fowner), hash, 0, 1,
+			   "A RRSIG", TTL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(dns_nsec3index_count(index), 1);
+	assert_int_equal(nxdomain(index, "nx.example.", NOW), ISC_R_NOTFOUND);
+
+	/* and the new chain is used once it is all known */
+	add_chain(index, "example.", example, ARRAY_SIZE(example), 0, 1);
+	assert_int_equal(dns_nsec3index_count(index), ARRAY_SIZE(example));
+	assert_int_equal(nxdomain(index, "nx.example.", NOW), ISC_R_SUCCESS);
+
+	/* records with too many iterations are not used */
+	hashname("example.", "example.", 0, hash, &fowner);
+	result = add_range(index, dns_fixedname_name(&fowner), hash, 0,
+			   dns_nsec3_maxiterations() + 1, "NS SOA", TTL);
+	assert_int_equal(result, ISC_R_IGNORE);
+	assert_int_equal(dns_nsec3index_count(index), ARRAY_SIZE(example));
+
+	dns_nsec3index_destroy(&index);
+}
+
+/* flushing a name drops the zones that could say anything about it */
+ISC_RUN_TEST_IMPL(nsec3index_flushname) {
+	dns_nsec3index_t *index = NULL;
+	dns_fixedname_t fname;
+
+	dns_nsec3index_create(mctx, &index);
+
+	add_chain(index, "example.", example, ARRAY_SIZE(example), 0, 0);
+
+	dns_test_namefromstring("other.", &fname);
+	dns_nsec3index_flushname(index, dns_fixedname_name(&fname), true);
+	assert_int_equal(nxdomain(index, "nx.example.", NOW), ISC_R_SUCCESS);
+
+	dns_test_namefromstring("www.example.", &fname);
+	dns_nsec3index_flushname(index, dns_fixedname_name(&fname), false);
+	assert_int_equal(dns_nsec3index_count(index), 0);
+	assert_int_equal(nxdomain(index, "nx.example.", NOW), ISC_R_NOTFOUND);
+
+	dns_nsec3index_destroy(&index);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY(nsec3index_covering)
+ISC_TEST_ENTRY(nsec3index_wildcard)
+ISC_TEST_ENTRY(nsec3index_delegation)
+ISC_TEST_ENTRY(nsec3index_optout)
+ISC_TEST_ENTRY(nsec3index_expire)
+ISC_TEST_ENTRY(nsec3index_newchain)
+ISC_TEST_ENTRY(nsec3index_flushname)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -0,0 +1,401 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/dbiterator.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/qp.h>
+#include <dns/rdataset.h>
+
+#include <tests/dns.h>
+
+#define TEST_ORIGIN "test"
+
+/*
+ * Names in DNSSEC canonical order.
+ */
+static const char *sorted[] = {
+	"example.",	   "a.example.",       "yljkjljk.a.example.",
+	"Z.a.example.",	   "zABC.a.EXAMPLE.",  "z.example.",
+	"\\001.z.example.", "*.z.example.",     "\\200.z.example.",
+};
+
+static size_t
+name_makekey(dns_qpkey_t key, void *uctx, void *pval) {
+	UNUSED(uctx);
+
+	return (dns_qpkey_fromname(key, (dns_name_t *)pval));
+}
+
+static dns_fixedname_t fixed[ARRAY_SIZE(sorted)];
+
+static void
+make_names(void) {
+	for (size_t i = 0; i < ARRAY_SIZE(sorted); i++) {
+		dns_name_t *name = dns_fixedname_initname(&fixed[i]);
+		isc_result_t result = dns_name_fromstring(name, sorted[i], 0,
+							  NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+}
+
+static dns_qp_t *
+make_trie(void) {
+	dns_qp_t *qp = NULL;
+
+	make_names();
+	dns_qp_create(mctx, name_makekey, NULL, &qp);
+
+	/* Insert in an order unrelated to the canonical one. */
+	for (size_t i = 0; i < ARRAY_SIZE(sorted); i++) {
+		size_t j = (i * 4) % ARRAY_SIZE(sorted);
+		isc_result_t result;
+
+		result = dns_qp_insert(qp, dns_fixedname_name(&fixed[j]));
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+	assert_int_equal(dns_qp_count(qp), ARRAY_SIZE(sorted));
+
+	return (qp);
+}
+
+/* keys sort in DNSSEC canonical order */
+ISC_RUN_TEST_IMPL(qpkey_order) {
+	dns_qpkey_t key1, key2;
+	size_t len1, len2;
+
+	UNUSED(state);
+
+	make_names();
+
+	for (size_t i = 0; i + 1 < ARRAY_SIZE(sorted); i++) {
+		len1 = dns_qpkey_fromname(key1,
+					  dns_fixedname_name(&fixed[i]));
+		len2 = dns_qpkey_fromname(key2,
+					  dns_fixedname_name(&fixed[i + 1]));
+		assert_true(memcmp(key1, key2, ISC_MIN(len1, len2)) < 0 ||
+			    (memcmp(key1, key2, ISC_MIN(len1, len2)) == 0 &&
+			     len1 < len2));
+	}
+
+	/* The root name has an empty key. */
+	assert_int_equal(dns_qpkey_fromname(key1, dns_rootname), 0);
+}
+
+/* insert, find and delete values */
+ISC_RUN_TEST_IMPL(qp_getkey) {
+	dns_qp_t *qp = NULL;
+	dns_qpkey_t key;
+	size_t len;
+	void *pval = NULL;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	qp = make_trie();
+
+	for (size_t i = 0; i < ARRAY_SIZE(sorted); i++) {
+		dns_name_t *name = dns_fixedname_name(&fixed[i]);
+
+		len = dns_qpkey_fromname(key, name);
+		result = dns_qp_getkey(qp, key, len, &pval);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_ptr_equal(pval, name);
+
+		result = dns_qp_insert(qp, name);
+		assert_int_equal(result, ISC_R_EXISTS);
+	}
+
+	len = dns_qpkey_fromname(key, dns_fixedname_name(&fixed[2]));
+	result = dns_qp_deletekey(qp, key, len);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_qp_deletekey(qp, key, len);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+	result = dns_qp_getkey(qp, key, len, &pval);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+	assert_int_equal(dns_qp_count(qp), ARRAY_SIZE(sorted) - 1);
+
+	dns_qp_destroy(&qp);
+}
+
+/* walk the trie forwards and backwards */
+ISC_RUN_TEST_IMPL(qp_iter) {
+	dns_qp_t *qp = NULL;
+	dns_qpiter_t iter;
+	void *pval = NULL;
+	size_t i;
+
+	UNUSED(state);
+
+	qp = make_trie();
+
+	dns_qpiter_init(qp, &iter);
+	for (i = 0; dns_qpiter_next(&iter, &pval) == ISC_R_SUCCESS; i++) {
+		assert_ptr_equal(pval, dns_fixedname_name(&fixed[i]));
+	}
+	assert_int_equal(i, ARRAY_SIZE(sorted));
+	assert_int_equal(dns_qpiter_current(&iter, &pval), ISC_R_NOMORE);
+
+	for (i = ARRAY_SIZE(sorted);
+	     dns_qpiter_prev(&iter, &pval) == ISC_R_SUCCESS;)
+	{
+		assert_ptr_equal(pval, dns_fixedname_name(&fixed[--i]));
+	}
+	assert_int_equal(i, 0);
+
+	dns_qp_destroy(&qp);
+}
+
+/* exact, partial, and failed lookups */
+static struct {
+	void *ptr;
+	size_t size;
+} retired[256];
+static size_t nretired = 0;
+
+static void
+record_retired(void *uctx, void *ptr, size_t size) {
+	UNUSED(uctx);
+
+	assert_true(nretired < ARRAY_SIZE(retired));
+	retired[nretired].ptr = ptr;
+	retired[nretired].size = size;
+	nretired++;
+}
+
+/* copy-on-write changes leave the old trie intact for readers */
+ISC_RUN_TEST_IMPL(qp_retire) {
+	dns_qp_t *qp = NULL;
+	dns_qpiter_t iter;
+	void *pval = NULL;
+	size_t i;
+
+	UNUSED(state);
+
+	qp = make_trie();
+	dns_qp_setretire(qp, record_retired);
+
+	dns_qpiter_init(qp, &iter);
+	assert_int_equal(dns_qpiter_next(&iter, &pval), ISC_R_SUCCESS);
+	assert_ptr_equal(pval, dns_fixedname_name(&fixed[0]));
+
+	for (i = 0; i < ARRAY_SIZE(sorted); i++) {
+		dns_qpkey_t key;
+		size_t keylen;
+
+		keylen = dns_qpkey_fromname(key, dns_fixedname_name(&fixed[i]));
+		assert_int_equal(dns_qp_deletekey(qp, key, keylen),
+				 ISC_R_SUCCESS);
+		assert_int_equal(dns_qp_getkey(qp, key, keylen, &pval),
+				 ISC_R_NOTFOUND);
+	}
+	assert_int_equal(dns_qp_count(qp), 0);
+	assert_true(nretired > 0);
+
+	/* The iterator still walks the trie as it was */
+	for (i = 1; dns_qpiter_next(&iter, &pval) == ISC_R_SUCCESS; i++) {
+		assert_ptr_equal(pval, dns_fixedname_name(&fixed[i]));
+	}
+	assert_int_equal(i, ARRAY_SIZE(sorted));
+
+	while (nretired > 0) {
+		nretired--;
+		isc_mem_put(mctx, retired[nretired].ptr,
+			    retired[nretired].size);
+	}
+
+	dns_qp_destroy(&qp);
+}
+
+ISC_RUN_TEST_IMPL(qp_lookup) {
+	dns_qp_t *qp = NULL;
+	dns_qpiter_t iter;
+	dns_qpchain_t chain;
+	dns_qpkey_t key;
+	dns_fixedname_t fn;
+	dns_name_t *name = dns_fixedname_initname(&fn);
+	size_t len;
+	void *pval = NULL;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	qp = make_trie();
+
+	/* Exact match, with the ancestors in the chain. */
+	len = dns_qpkey_fromname(key, dns_fixedname_name(&fixed[2]));
+	result = dns_qp_lookup(qp, key, len, &iter, &chain, &pval);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_ptr_equal(pval, dns_fixedname_name(&fixed[2]));
+	assert_int_equal(chain.len, 2);
+	assert_ptr_equal(chain.chain[0], dns_fixedname_name(&fixed[0]));
+	assert_ptr_equal(chain.chain[1], dns_fixedname_name(&fixed[1]));
+
+	/* Partial match; the iterator is left on the predecessor. */
+	result = dns_name_fromstring(name, "b.Z.a.example.", 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	len = dns_qpkey_fromname(key, name);
+	result = dns_qp_lookup(qp, key, len, &iter, &chain, &pval);
+	assert_int_equal(result, DNS_R_PARTIALMATCH);
+	assert_ptr_equal(pval, dns_fixedname_name(&fixed[3]));
+	assert_int_equal(chain.len, 3);
+	assert_ptr_equal(chain.chain[2], pval);
+	result = dns_qpiter_current(&iter, &pval);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_ptr_equal(pval, dns_fixedname_name(&fixed[3]));
+	result = dns_qpiter_next(&iter, &pval);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_ptr_equal(pval, dns_fixedname_name(&fixed[4]));
+
+	/* A name sorting between two siblings. */
+	result = dns_name_fromstring(name, "b.example.", 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	len = dns_qpkey_fromname(key, name);
+	result = dns_qp_lookup(qp, key, len, &iter, NULL, &pval);
+	assert_int_equal(result, DNS_R_PARTIALMATCH);
+	assert_ptr_equal(pval, dns_fixedname_name(&fixed[0]));
+	result = dns_qpiter_current(&iter, &pval);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_ptr_equal(pval, dns_fixedname_name(&fixed[4]));
+
+	/* Outside of everything in the trie. */
+	result = dns_name_fromstring(name, "example.net.", 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	len = dns_qpkey_fromname(key, name);
+	result = dns_qp_lookup(qp, key, len, &iter, &chain, &pval);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+	assert_int_equal(chain.len, 0);
+
+	dns_qp_destroy(&qp);
+}
+
+/* walk a "qp" zone database */
+ISC_RUN_TEST_IMPL(qpdb_walk) {
+	dns_db_t *db = NULL;
+	dns_dbiterator_t *iter = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t fname, forigin;
+	dns_name_t *name = dns_fixedname_initname(&fname);
+	dns_name_t *origin = dns_fixedname_initname(&forigin);
+	isc_result_t result;
+	int i = 0;
+
+	UNUSED(state);
+
+	result = dns_name_fromstring(origin, TEST_ORIGIN, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_create(mctx, "qp", origin, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_load(db, TESTS_DIR "/testdata/dbiterator/zone1.data",
+			     dns_masterformat_text, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_db_createiterator(db, 0, &iter);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	for (result = dns_dbiterator_first(iter); result == ISC_R_SUCCESS;
+	     result = dns_dbiterator_next(iter))
+	{
+		result = dns_dbiterator_current(iter, &node, name);
+		if (result == DNS_R_NEWORIGIN) {
+			result = ISC_R_SUCCESS;
+		}
+		assert_int_equal(result, ISC_R_SUCCESS);
+		dns_db_detachnode(db, &node);
+		i++;
+	}
+	assert_int_equal(result, ISC_R_NOMORE);
+	assert_int_equal(i, 12);
+
+	dns_dbiterator_destroy(&iter);
+	dns_db_detach(&db);
+}
+
+/* lookups in a "qp" zone database */
+ISC_RUN_TEST_IMPL(qpdb_find) {
+	dns_db_t *db = NULL;
+	dns_fixedname_t fname, ffound;
+	dns_name_t *name = dns_fixedname_initname(&fname);
+	dns_name_t *found = dns_fixedname_initname(&ffound);
+	dns_rdataset_t rdataset;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	result = dns_name_fromstring(name, TEST_ORIGIN, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_create(mctx, "qp", name, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_load(db, TESTS_DIR "/testdata/dbiterator/zone1.data",
+			     dns_masterformat_text, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdataset_init(&rdataset);
+	result = dns_name_fromstring(name, "f.g.i.test.", 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_find(db, name, NULL, dns_rdatatype_txt, 0, 0, NULL,
+			     found, &rdataset, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(dns_name_equal(name, found));
+	assert_int_equal(dns_rdataset_count(&rdataset), 1);
+	dns_rdataset_disassociate(&rdataset);
+
+	result = dns_db_find(db, name, NULL, dns_rdatatype_a, 0, 0, NULL,
+			     found, &rdataset, NULL);
+	assert_int_equal(result, DNS_R_NXRRSET);
+
+	/* "g.i.test" is an empty non-terminal. */
+	result = dns_name_fromstring(name, "g.i.test.", 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_find(db, name, NULL, dns_rdatatype_txt, 0, 0, NULL,
+			     found, &rdataset, NULL);
+	assert_int_equal(result, DNS_R_EMPTYNAME);
+
+	result = dns_name_fromstring(name, "x.g.i.test.", 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_find(db, name, NULL, dns_rdatatype_txt, 0, 0, NULL,
+			     found, &rdataset, NULL);
+	assert_int_equal(result, DNS_R_NXDOMAIN);
+
+	dns_db_detach(&db);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY(qpkey_order)
+ISC_TEST_ENTRY(qp_getkey)
+ISC_TEST_ENTRY(qp_iter)
+ISC_TEST_ENTRY(qp_retire)
+ISC_TEST_ENTRY(qp_lookup)
+ISC_TEST_ENTRY(qpdb_walk)
+ISC_TEST_ENTRY(qpdb_find)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
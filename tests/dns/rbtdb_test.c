@@ -22,6 +22,7 @@
 #define UNIT_TESTING
 #include <cmocka.h>
 
+#include <isc/random.h>
 #include <isc/util.h>
 
 #include <dns/rbt.h>
@@ -203,9 +204,74 @@ ISC_RUN_TEST_IMPL(setownercase) {
 	assert_true(dns_name_caseequal(name1, name2));
 }
 
+/* every entry leaves the TTL wheel in the second its key is reached */
+ISC_RUN_TEST_IMPL(ttlwheel) {
+	rbtdb_ttlwheel_t wheel[1];
+	dns_rbtdb_t rbtdb = {
+		.common.attributes = DNS_DBATTR_CACHE,
+		.ttlwheels = wheel,
+	};
+	dns_rbtnode_t rbtnode = { .locknum = 0 };
+	rdatasetheader_t headers[1000];
+	isc_stdtime_t start = 1000000000, until;
+	size_t expired = 0;
+
+	UNUSED(state);
+
+	memset(wheel, 0, sizeof(wheel));
+	for (size_t n = 0; n < TTLWHEEL_SLOTS; n++) {
+		ISC_LIST_INIT(wheel[0].slots[n]);
+	}
+	wheel[0].now = start;
+
+	for (size_t n = 0; n < ARRAY_SIZE(headers); n++) {
+		headers[n] = (rdatasetheader_t){ .node = &rbtnode };
+		ISC_LINK_INIT(&headers[n], ttl_link);
+
+		/* a spread of TTLs up to about two years, some in the past */
+		headers[n].rdh_ttl = start - 10 + isc_random_uniform(1 << 10);
+		if (n % 2 == 0) {
+			headers[n].rdh_ttl += isc_random_uniform(1 << 26);
+		}
+		ttlwheel_insert(&rbtdb, 0, &headers[n]);
+	}
+	assert_int_equal(wheel[0].count, ARRAY_SIZE(headers));
+
+	/* change the TTL of some of the entries in flight */
+	for (size_t n = 0; n < ARRAY_SIZE(headers); n += 7) {
+		set_ttl(&rbtdb, &headers[n],
+			start + isc_random_uniform(100000));
+	}
+
+	until = start + (1 << 27);
+	while (wheel[0].now < until) {
+		rdatasetheaderlist_t *slot =
+			&wheel[0].slots[wheel[0].now % TTLWHEEL_L0SLOTS];
+		rdatasetheader_t *header = NULL;
+
+		while ((header = ISC_LIST_HEAD(*slot)) != NULL) {
+			if (header->rdh_ttl < start) {
+				assert_int_equal(wheel[0].now, start);
+			} else {
+				assert_int_equal(header->rdh_ttl, wheel[0].now);
+			}
+			ttlwheel_delete(&rbtdb, 0, header);
+			expired++;
+		}
+		ttlwheel_advance(&rbtdb, &wheel[0], until);
+	}
+
+	assert_int_equal(expired, ARRAY_SIZE(headers));
+	assert_int_equal(wheel[0].count, 0);
+	for (size_t n = 0; n < TTLWHEEL_LEVELS; n++) {
+		assert_int_equal(wheel[0].levelcount[n], 0);
+	}
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(ownercase)
 ISC_TEST_ENTRY(setownercase)
+ISC_TEST_ENTRY(ttlwheel)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -3093,6 +3093,71 @@ ISC_RUN_TEST_IMPL(iszonecutauth) {
 #undef UNR
 }
 
+/* wire format properties and the fast paths using them */
+ISC_RUN_TEST_IMPL(wireinfo) {
+	unsigned char wire[16] = { 10, 53, 0, 1 };
+	unsigned char buf[16];
+	isc_buffer_t source, target;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdata_t rdata2 = DNS_RDATA_INIT;
+	isc_result_t result;
+
+	assert_int_equal(dns_rdata_wireinfo(dns_rdataclass_in,
+					    dns_rdatatype_a),
+			 DNS_RDATAWIRE_PLAIN | 4);
+	assert_int_equal(dns_rdata_wireinfo(dns_rdataclass_in,
+					    dns_rdatatype_aaaa),
+			 DNS_RDATAWIRE_PLAIN | 16);
+	assert_int_equal(dns_rdata_wireinfo(dns_rdataclass_in,
+					    dns_rdatatype_txt),
+			 DNS_RDATAWIRE_PLAIN);
+	/* CH A holds a domain name */
+	assert_int_equal(dns_rdata_wireinfo(dns_rdataclass_ch,
+					    dns_rdatatype_a),
+			 0);
+	assert_int_equal(dns_rdata_wireinfo(dns_rdataclass_in,
+					    dns_rdatatype_ns),
+			 0);
+	assert_int_equal(dns_rdata_wireinfo(dns_rdataclass_in, 65280), 0);
+
+	/* too short */
+	isc_buffer_init(&source, wire, 3);
+	isc_buffer_add(&source, 3);
+	isc_buffer_setactive(&source, 3);
+	isc_buffer_init(&target, buf, sizeof(buf));
+	result = dns_rdata_fromwire(&rdata, dns_rdataclass_in,
+				    dns_rdatatype_a, &source,
+				    DNS_DECOMPRESS_NEVER, 0, &target);
+	assert_int_equal(result, ISC_R_UNEXPECTEDEND);
+
+	/* too long */
+	isc_buffer_init(&source, wire, 5);
+	isc_buffer_add(&source, 5);
+	isc_buffer_setactive(&source, 5);
+	isc_buffer_init(&target, buf, sizeof(buf));
+	result = dns_rdata_fromwire(&rdata, dns_rdataclass_in,
+				    dns_rdatatype_a, &source,
+				    DNS_DECOMPRESS_NEVER, 0, &target);
+	assert_int_equal(result, DNS_R_EXTRADATA);
+
+	isc_buffer_init(&source, wire, 4);
+	isc_buffer_add(&source, 4);
+	isc_buffer_setactive(&source, 4);
+	isc_buffer_init(&target, buf, sizeof(buf));
+	result = dns_rdata_fromwire(&rdata, dns_rdataclass_in,
+				    dns_rdatatype_a, &source,
+				    DNS_DECOMPRESS_NEVER, 0, &target);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(rdata.length, 4);
+	assert_memory_equal(rdata.data, wire, 4);
+
+	dns_rdata_fromregion(&rdata2, dns_rdataclass_in, dns_rdatatype_a,
+			     &(isc_region_t){ .base = wire + 4, .length = 4 });
+	assert_true(dns_rdata_compare(&rdata, &rdata2) > 0);
+	assert_true(dns_rdata_casecompare(&rdata2, &rdata) < 0);
+	assert_int_equal(dns_rdata_compare(&rdata, &rdata), 0);
+}
+
 ISC_TEST_LIST_START
 
 /* types */
@@ -3124,6 +3189,7 @@ ISC_TEST_ENTRY(edns_client_subnet)
 ISC_TEST_ENTRY(atcname)
 ISC_TEST_ENTRY(atparent)
 ISC_TEST_ENTRY(iszonecutauth)
+ISC_TEST_ENTRY(wireinfo)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
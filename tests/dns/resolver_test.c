@@ -24,10 +24,12 @@
 #include <isc/buffer.h>
 #include <isc/net.h>
 #include <isc/print.h>
+#include <isc/stdtime.h>
 #include <isc/task.h>
 #include <isc/timer.h>
 #include <isc/util.h>
 
+#include <dns/adb.h>
 #include <dns/dispatch.h>
 #include <dns/name.h>
 #include <dns/resolver.h>
@@ -175,6 +177,107 @@ ISC_LOOP_TEST_IMPL(settimeout_overmax) {
 	isc_loopmgr_shutdown(loopmgr);
 }
 
+/* dns_resolver_setmaxhedges */
+ISC_LOOP_TEST_IMPL(setmaxhedges) {
+	dns_resolver_t *resolver = NULL;
+
+	mkres(&resolver);
+
+	assert_int_equal(dns_resolver_getmaxhedges(resolver), 0);
+	dns_resolver_setmaxhedges(resolver, 2);
+	assert_int_equal(dns_resolver_getmaxhedges(resolver), 2);
+
+	destroy_resolver(&resolver);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* dns_resolver_sharefetches */
+ISC_LOOP_TEST_IMPL(sharefetches) {
+	dns_resolver_t *resolver = NULL, *other = NULL;
+
+	mkres(&resolver);
+	mkres(&other);
+
+	dns_resolver_sharefetches(other, resolver);
+
+	destroy_resolver(&resolver);
+	destroy_resolver(&other);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* dns_resolver_slowzones */
+ISC_LOOP_TEST_IMPL(slowzones) {
+	dns_resolver_t *resolver = NULL;
+	dns_resslowzone_t *zones = NULL;
+	size_t count = 1;
+
+	mkres(&resolver);
+
+	/* nothing has been fetched yet */
+	dns_resolver_slowzones(resolver, mctx, &zones, &count);
+	assert_int_equal(count, 0);
+	assert_null(zones);
+
+	destroy_resolver(&resolver);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* dns_adb_serverstats */
+ISC_LOOP_TEST_IMPL(adb_serverstats) {
+	isc_result_t result;
+	dns_adb_t *adb = NULL;
+	dns_adbaddrinfo_t *addrs[3] = { NULL };
+	dns_adbserverstats_t *stats = NULL;
+	size_t count = 0;
+	isc_stdtime_t now;
+
+	result = dns_adb_create(mctx, view, taskmgr, &adb);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_stdtime_get(&now);
+	for (size_t i = 0; i < ARRAY_SIZE(addrs); i++) {
+		struct in_addr ina = { .s_addr = htonl(INADDR_LOOPBACK + i) };
+		isc_sockaddr_t sa;
+
+		isc_sockaddr_fromin(&sa, &ina, 53);
+		result = dns_adb_findaddrinfo(adb, &sa, &addrs[i], now);
+		assert_int_equal(result, ISC_R_SUCCESS);
+
+		/* The n-th server is sent n queries */
+		for (size_t j = 0; j <= i; j++) {
+			dns_adb_servercount(adb, addrs[i],
+					    dns_adbserver_queries);
+		}
+	}
+	dns_adb_serverrtt(adb, addrs[2], 5000);
+	dns_adb_serverrtt(adb, addrs[2], 2000000);
+	dns_adb_servercount(adb, addrs[0], dns_adbserver_timeouts);
+
+	/* Only the two busiest servers are returned */
+	dns_adb_serverstats(adb, mctx, 2, &stats, &count);
+	assert_int_equal(count, 2);
+	assert_int_equal(stats[0].counters[dns_adbserver_queries], 3);
+	assert_int_equal(stats[0].counters[dns_adbserver_responses], 2);
+	assert_int_equal(stats[0].rtt[0], 1);
+	assert_int_equal(stats[0].rtt[DNS_ADB_RTTBUCKETS - 1], 1);
+	assert_int_equal(stats[1].counters[dns_adbserver_queries], 2);
+	isc_mem_put(mctx, stats, count * sizeof(stats[0]));
+	stats = NULL;
+
+	dns_adb_serverstats(adb, mctx, 10, &stats, &count);
+	assert_int_equal(count, 3);
+	assert_int_equal(stats[2].counters[dns_adbserver_queries], 1);
+	assert_int_equal(stats[2].counters[dns_adbserver_timeouts], 1);
+	isc_mem_put(mctx, stats, count * sizeof(stats[0]));
+
+	for (size_t i = 0; i < ARRAY_SIZE(addrs); i++) {
+		dns_adb_freeaddrinfo(adb, &addrs[i]);
+	}
+	dns_adb_shutdown(adb);
+	dns_adb_detach(&adb);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(create, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(gettimeout, setup_test, teardown_test)
@@ -182,6 +285,10 @@ ISC_TEST_ENTRY_CUSTOM(settimeout, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(settimeout_default, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(settimeout_belowmin, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(settimeout_overmax, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(setmaxhedges, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(sharefetches, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(slowzones, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(adb_serverstats, setup_test, teardown_test)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
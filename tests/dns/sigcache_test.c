@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/stdtime.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+#include <dns/sigcache.h>
+
+#include <dst/dst.h>
+
+#include <tests/dns.h>
+
+static int
+setup_test(void **state) {
+	UNUSED(state);
+
+	if (dst_lib_init(mctx, NULL) != ISC_R_SUCCESS) {
+		return (1);
+	}
+
+	return (0);
+}
+
+static int
+teardown_test(void **state) {
+	UNUSED(state);
+
+	dst_lib_destroy();
+
+	return (0);
+}
+
+/* Compute the digest of an RRSIG over two A records, in either order */
+static void
+digest(dst_key_t *key, const char *owner, bool reverse, const char *sigtext,
+       unsigned char *out) {
+	unsigned char a1[4] = { 192, 0, 2, 1 };
+	unsigned char a2[4] = { 192, 0, 2, 2 };
+	unsigned char sigbuf[512];
+	dns_rdata_t rdata1 = DNS_RDATA_INIT, rdata2 = DNS_RDATA_INIT;
+	dns_rdata_t sigrdata = DNS_RDATA_INIT;
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	isc_result_t result;
+
+	result = dns_name_fromstring(name, owner, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdata_fromregion(&rdata1, dns_rdataclass_in, dns_rdatatype_a,
+			     &(isc_region_t){ a1, sizeof(a1) });
+	dns_rdata_fromregion(&rdata2, dns_rdataclass_in, dns_rdatatype_a,
+			     &(isc_region_t){ a2, sizeof(a2) });
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.ttl = 300;
+	if (reverse) {
+		ISC_LIST_APPEND(rdatalist.rdata, &rdata2, link);
+		ISC_LIST_APPEND(rdatalist.rdata, &rdata1, link);
+	} else {
+		ISC_LIST_APPEND(rdatalist.rdata, &rdata1, link);
+		ISC_LIST_APPEND(rdatalist.rdata, &rdata2, link);
+	}
+	dns_rdataset_init(&rdataset);
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+
+	result = dns_test_rdatafromstring(&sigrdata, dns_rdataclass_in,
+					  dns_rdatatype_rrsig, sigbuf,
+					  sizeof(sigbuf), sigtext, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_sigcache_digest(name, &rdataset, key, &sigrdata, 0, mctx,
+				     out);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdataset_disassociate(&rdataset);
+}
+
+#define SIG1 "A 8 2 300 20300101000000 20200101000000 29238 rsa. AAAA"
+#define SIG2 "A 8 2 300 20300101000000 20200101000000 29238 rsa. AAAB"
+
+/* the digest depends on the signature but not on order or case */
+ISC_RUN_TEST_IMPL(sigcache_digest) {
+	unsigned char d1[DNS_SIGCACHE_DIGESTLENGTH];
+	unsigned char d2[DNS_SIGCACHE_DIGESTLENGTH];
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	dst_key_t *key = NULL;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	result = dns_name_fromstring(name, "rsa.", 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dst_key_fromfile(name, 29238, DST_ALG_RSASHA256,
+				  DST_TYPE_PUBLIC, TESTS_DIR, mctx, &key);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	digest(key, "www.example.", false, SIG1, d1);
+	digest(key, "WWW.Example.", true, SIG1, d2);
+	assert_memory_equal(d1, d2, sizeof(d1));
+
+	digest(key, "www.example.", false, SIG2, d2);
+	assert_memory_not_equal(d1, d2, sizeof(d1));
+
+	digest(key, "ftp.example.", false, SIG1, d2);
+	assert_memory_not_equal(d1, d2, sizeof(d1));
+
+	dst_key_free(&key);
+}
+
+/* entries are found until they expire or the cache is flushed */
+ISC_RUN_TEST_IMPL(sigcache_find) {
+	unsigned char d1[DNS_SIGCACHE_DIGESTLENGTH] = { 1 };
+	unsigned char d2[DNS_SIGCACHE_DIGESTLENGTH] = { 2 };
+	dns_sigcache_t *cache = NULL;
+	isc_result_t result, vresult;
+	uint32_t cost = 0;
+	isc_stdtime_t now;
+
+	UNUSED(state);
+
+	isc_stdtime_get(&now);
+	dns_sigcache_create(mctx, 128, &cache);
+
+	result = dns_sigcache_find(cache, d1, now, &vresult, &cost);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	dns_sigcache_add(cache, d1, now + 60, ISC_R_SUCCESS, 150);
+	dns_sigcache_add(cache, d2, now + 60, DNS_R_SIGINVALID, 90);
+
+	result = dns_sigcache_find(cache, d1, now, &vresult, &cost);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(vresult, ISC_R_SUCCESS);
+	assert_int_equal(cost, 150);
+
+	result = dns_sigcache_find(cache, d2, now, &vresult, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(vresult, DNS_R_SIGINVALID);
+
+	result = dns_sigcache_find(cache, d1, now + 61, &vresult, &cost);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+	result = dns_sigcache_find(cache, d1, now, &vresult, &cost);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	dns_sigcache_flush(cache);
+	result = dns_sigcache_find(cache, d2, now, &vresult, &cost);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	dns_sigcache_destroy(&cache);
+	assert_null(cache);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY_CUSTOM(sigcache_digest, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(sigcache_find, setup_test, teardown_test)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/ssu.h>
+
+#include <tests/dns.h>
+
+static dns_ssutable_t *table = NULL;
+
+static int
+setup_test(void **state) {
+	UNUSED(state);
+
+	dns_ssutable_create(mctx, &table);
+
+	return (0);
+}
+
+static int
+teardown_test(void **state) {
+	UNUSED(state);
+
+	dns_ssutable_detach(&table);
+
+	return (0);
+}
+
+/*
+ * Add a rule for 'identity' and 'name'.  If 'type' is not zero, the rule
+ * only applies to that type, otherwise to the default set of types.
+ */
+static void
+addrule(bool grant, const char *identity, dns_ssumatchtype_t matchtype,
+	const char *name, dns_rdatatype_t type) {
+	dns_fixedname_t fidentity, fname;
+	dns_ssuruletype_t types[1] = { { .type = type } };
+
+	dns_test_namefromstring(identity, &fidentity);
+	dns_test_namefromstring(name, &fname);
+
+	dns_ssutable_addrule(table, grant, dns_fixedname_name(&fidentity),
+			     matchtype, dns_fixedname_name(&fname),
+			     type != 0 ? 1 : 0, type != 0 ? types : NULL);
+}
+
+/*
+ * Check an update of 'name'/'type' signed by 'signer'.  On success, the
+ * granting rule is returned in '*rulep' if 'rulep' is not NULL.
+ */
+static bool
+check(const char *signer, const char *name, dns_rdatatype_t type,
+      const dns_ssurule_t **rulep) {
+	dns_fixedname_t fsigner, fname;
+	const dns_ssurule_t *rule = NULL;
+	bool result;
+
+	dns_test_namefromstring(signer, &fsigner);
+	dns_test_namefromstring(name, &fname);
+
+	result = dns_ssutable_checkrules(table, dns_fixedname_name(&fsigner),
+					 dns_fixedname_name(&fname), NULL,
+					 false, NULL, type, NULL, NULL, &rule);
+	if (rulep != NULL) {
+		*rulep = rule;
+	}
+
+	return (result);
+}
+
+/* "name" and "subdomain" rules: the first matching one decides */
+ISC_RUN_TEST_IMPL(ssu_name) {
+	const dns_ssurule_t *rule = NULL;
+
+	addrule(false, "*", dns_ssumatchtype_name, "www.example.", 0);
+	addrule(true, "*", dns_ssumatchtype_subdomain, "example.", 0);
+	addrule(false, "*", dns_ssumatchtype_name, "ftp.example.", 0);
+
+	assert_false(check("key.", "www.example.", dns_rdatatype_a, NULL));
+	assert_true(check("key.", "ftp.example.", dns_rdatatype_a, &rule));
+	assert_int_equal(dns_ssurule_matchtype(rule),
+			 dns_ssumatchtype_subdomain);
+	assert_true(check("key.", "example.", dns_rdatatype_a, NULL));
+	assert_true(check("key.", "a.b.example.", dns_rdatatype_a, NULL));
+	assert_false(check("key.", "example.com.", dns_rdatatype_a, NULL));
+
+	/* Names are compared without regard to case */
+	assert_false(check("key.", "WWW.Example.", dns_rdatatype_a, NULL));
+
+	/* The identity is checked for each candidate rule */
+	addrule(true, "other.", dns_ssumatchtype_name, "example.com.", 0);
+	assert_false(check("key.", "example.com.", dns_rdatatype_a, NULL));
+	assert_true(check("other.", "example.com.", dns_rdatatype_a, NULL));
+}
+
+/* rules restricted to some types only match those types */
+ISC_RUN_TEST_IMPL(ssu_types) {
+	addrule(false, "*", dns_ssumatchtype_name, "www.example.",
+		dns_rdatatype_txt);
+	addrule(true, "*", dns_ssumatchtype_subdomain, "example.", 0);
+
+	assert_true(check("key.", "www.example.", dns_rdatatype_a, NULL));
+	assert_false(check("key.", "www.example.", dns_rdatatype_txt, NULL));
+
+	/* SOA, NS and the like are not in the default set */
+	assert_false(check("key.", "www.example.", dns_rdatatype_soa, NULL));
+}
+
+/* "wildcard" rules are indexed under their parent name */
+ISC_RUN_TEST_IMPL(ssu_wildcard) {
+	const dns_ssurule_t *rule = NULL;
+
+	addrule(false, "*", dns_ssumatchtype_wildcard, "*.a.example.", 0);
+	addrule(true, "*", dns_ssumatchtype_subdomain, "a.example.", 0);
+
+	/* The wildcard does not match its parent */
+	assert_true(check("key.", "a.example.", dns_rdatatype_a, NULL));
+	assert_false(check("key.", "x.a.example.", dns_rdatatype_a, NULL));
+	assert_false(check("key.", "x.y.a.example.", dns_rdatatype_a, NULL));
+
+	/* A grant listed before the wildcard wins */
+	addrule(true, "*", dns_ssumatchtype_wildcard, "*.b.example.", 0);
+	addrule(false, "*", dns_ssumatchtype_name, "x.b.example.", 0);
+	assert_true(check("key.", "x.b.example.", dns_rdatatype_a, &rule));
+	assert_int_equal(dns_ssurule_matchtype(rule),
+			 dns_ssumatchtype_wildcard);
+}
+
+/*
+ * the unindexed "self" rules are only used when they come before the
+ * first matching indexed rule
+ */
+ISC_RUN_TEST_IMPL(ssu_self) {
+	const dns_ssurule_t *rule = NULL;
+
+	addrule(true, "*", dns_ssumatchtype_name, "a.example.", 0);
+	addrule(false, "*", dns_ssumatchtype_self, ".", 0);
+	addrule(true, "*", dns_ssumatchtype_subdomain, "example.", 0);
+	addrule(true, "*", dns_ssumatchtype_selfwild, ".", 0);
+
+	/* The "name" rule comes before the "self" deny */
+	assert_true(check("a.example.", "a.example.", dns_rdatatype_a, &rule));
+	assert_int_equal(dns_ssurule_matchtype(rule), dns_ssumatchtype_name);
+
+	/* The "self" deny comes before the "subdomain" grant */
+	assert_false(check("b.example.", "b.example.", dns_rdatatype_a, NULL));
+
+	/* The "self" rule does not match */
+	assert_true(
+		check("b.example.", "x.b.example.", dns_rdatatype_a, &rule));
+	assert_int_equal(dns_ssurule_matchtype(rule),
+			 dns_ssumatchtype_subdomain);
+	assert_true(check("b.example.", "c.example.", dns_rdatatype_a, NULL));
+
+	/* Only the last rule matches */
+	assert_true(check("c.test.", "x.c.test.", dns_rdatatype_a, &rule));
+	assert_int_equal(dns_ssurule_matchtype(rule),
+			 dns_ssumatchtype_selfwild);
+	assert_false(check("c.test.", "c.test.", dns_rdatatype_a, NULL));
+}
+
+/* "self" rules before and after an indexed deny */
+ISC_RUN_TEST_IMPL(ssu_selfdeny) {
+	const dns_ssurule_t *rule = NULL;
+
+	addrule(true, "*", dns_ssumatchtype_self, ".", 0);
+	addrule(false, "*", dns_ssumatchtype_subdomain, "example.", 0);
+	addrule(true, "*", dns_ssumatchtype_selfsub, ".", 0);
+
+	assert_true(check("a.example.", "a.example.", dns_rdatatype_a, &rule));
+	assert_int_equal(dns_ssurule_matchtype(rule), dns_ssumatchtype_self);
+	assert_false(
+		check("a.example.", "x.a.example.", dns_rdatatype_a, NULL));
+	assert_true(check("a.test.", "x.a.test.", dns_rdatatype_a, &rule));
+	assert_int_equal(dns_ssurule_matchtype(rule), dns_ssumatchtype_selfsub);
+}
+
+/* Kerberos and Windows subdomain rules keep their place in the table */
+ISC_RUN_TEST_IMPL(ssu_krb5) {
+	const dns_ssurule_t *rule = NULL;
+
+	addrule(false, "EXAMPLE.COM.", dns_ssumatchtype_subdomainkrb5,
+		"krb5.example.", 0);
+	addrule(false, "EXAMPLE.COM.", dns_ssumatchtype_subdomainms,
+		"ms.example.", 0);
+	addrule(true, "*", dns_ssumatchtype_subdomain, "example.", 0);
+
+	/* Other signers fall through to the "subdomain" rule */
+	assert_true(check("key.", "x.krb5.example.", dns_rdatatype_a, &rule));
+	assert_int_equal(dns_ssurule_matchtype(rule),
+			 dns_ssumatchtype_subdomain);
+	assert_true(check("key.", "x.ms.example.", dns_rdatatype_a, NULL));
+
+#if HAVE_GSSAPI
+	assert_false(check("host/h.krb5.example@EXAMPLE.COM.",
+			   "x.krb5.example.", dns_rdatatype_a, NULL));
+	assert_false(check("h$@EXAMPLE.COM.", "x.ms.example.", dns_rdatatype_a,
+			   NULL));
+#else  /* HAVE_GSSAPI */
+	/* Without GSSAPI the Kerberos rules never match */
+	assert_true(check("host/h.krb5.example@EXAMPLE.COM.",
+			  "x.krb5.example.", dns_rdatatype_a, NULL));
+	assert_true(check("h$@EXAMPLE.COM.", "x.ms.example.", dns_rdatatype_a,
+			  NULL));
+#endif /* HAVE_GSSAPI */
+
+	/* The Kerberos rules only apply below their name */
+	assert_true(check("host/h.krb5.example@EXAMPLE.COM.", "www.example.",
+			  dns_rdatatype_a, NULL));
+}
+
+/* a deny anywhere before a matching grant wins, however many rules */
+ISC_RUN_TEST_IMPL(ssu_denyfirst) {
+	char name[64];
+
+	for (int i = 0; i < 100; i++) {
+		snprintf(name, sizeof(name), "host%d.example.", i);
+		addrule(i != 50, "*", dns_ssumatchtype_name, name, 0);
+		if (i == 60) {
+			addrule(false, "*", dns_ssumatchtype_self, ".", 0);
+		}
+	}
+	addrule(true, "*", dns_ssumatchtype_subdomain, ".", 0);
+
+	assert_true(check("key.", "host0.example.", dns_rdatatype_a, NULL));
+	assert_false(check("key.", "host50.example.", dns_rdatatype_a, NULL));
+	assert_true(check("key.", "host99.example.", dns_rdatatype_a, NULL));
+	assert_true(check("key.", "other.example.", dns_rdatatype_a, NULL));
+
+	/* The "self" deny is after host60, but before host61 */
+	assert_true(check("host60.example.", "host60.example.",
+			  dns_rdatatype_a, NULL));
+	assert_false(check("host61.example.", "host61.example.",
+			   dns_rdatatype_a, NULL));
+	assert_false(check("other.example.", "other.example.",
+			   dns_rdatatype_a, NULL));
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY_CUSTOM(ssu_name, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(ssu_types, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(ssu_wildcard, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(ssu_self, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(ssu_selfdeny, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(ssu_krb5, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(ssu_denyfirst, setup_test, teardown_test)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -476,6 +476,59 @@ ISC_RUN_TEST_IMPL(tsig_tcp) {
 	}
 }
 
+/*
+ * Check that generated keys can be looked up regardless of case and
+ * that expired keys are removed from the ring.
+ */
+ISC_RUN_TEST_IMPL(keyring_expire) {
+	dns_fixedname_t fname;
+	dns_name_t *name = dns_fixedname_initname(&fname);
+	dns_tsig_keyring_t *ring = NULL;
+	dns_tsigkey_t *key = NULL;
+	unsigned char secret[16] = { 0 };
+	isc_stdtime_t now;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	isc_stdtime_get(&now);
+
+	result = dns_tsigkeyring_create(mctx, &ring);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_name_fromstring(name, "current", 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_tsigkey_create(name, dns_tsig_hmacsha256_name, secret,
+				    sizeof(secret), true, NULL, now - 10,
+				    now + 3600, mctx, ring, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_name_fromstring(name, "expired", 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_tsigkey_create(name, dns_tsig_hmacsha256_name, secret,
+				    sizeof(secret), true, NULL, now - 20,
+				    now - 10, mctx, ring, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(ring->generated, 2);
+
+	result = dns_tsigkey_find(&key, name, NULL, ring);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+	assert_null(key);
+	assert_int_equal(ring->generated, 1);
+
+	result = dns_name_fromstring(name, "CURRENT", 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_tsigkey_find(&key, name, dns_tsig_hmacsha256_name, ring);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_non_null(key);
+	dns_tsigkey_detach(&key);
+
+	result = dns_tsigkey_find(&key, name, dns_tsig_hmacsha1_name, ring);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	dns_tsigkeyring_detach(&ring);
+}
+
 /* Tests the dns__tsig_algvalid function */
 ISC_RUN_TEST_IMPL(algvalid) {
 	UNUSED(state);
@@ -572,6 +625,7 @@ ISC_RUN_TEST_IMPL(algallocated) {
 
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(tsig_tcp, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(keyring_expire, setup_test, teardown_test)
 ISC_TEST_ENTRY(algvalid)
 ISC_TEST_ENTRY(algfromname)
 ISC_TEST_ENTRY_CUSTOM(algnamefromname, setup_test, teardown_test)
@@ -32,6 +32,7 @@
 #include <isc/util.h>
 
 #include <dns/db.h>
+#include <dns/fixedname.h>
 #include <dns/name.h>
 #include <dns/view.h>
 #include <dns/zone.h>
@@ -274,10 +275,106 @@ ISC_LOOP_TEST_IMPL(asyncload_zt) {
 	dns_zt_asyncload(zt, false, all_done, NULL);
 }
 
+static void
+check_find(dns_zt_t *zt, const char *namestr, unsigned int options,
+	   isc_result_t expect, const char *zonestr) {
+	isc_result_t result;
+	dns_fixedname_t fname, ffound, fzone;
+	dns_name_t *name = dns_fixedname_initname(&fname);
+	dns_name_t *found = dns_fixedname_initname(&ffound);
+	dns_name_t *zname = dns_fixedname_initname(&fzone);
+	dns_zone_t *zone = NULL;
+
+	result = dns_name_fromstring(name, namestr, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_zt_find(zt, name, options, found, &zone);
+	assert_int_equal(result, expect);
+	if (zonestr == NULL) {
+		assert_null(zone);
+		return;
+	}
+
+	result = dns_name_fromstring(zname, zonestr, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(dns_name_equal(found, zname));
+	assert_true(dns_name_equal(dns_zone_getorigin(zone), zname));
+	dns_zone_detach(&zone);
+}
+
+/* find the deepest zone for a name, across mounts and unmounts */
+ISC_LOOP_TEST_IMPL(find) {
+	isc_result_t result;
+	dns_zt_t *zt = NULL;
+	dns_zone_t *example = NULL, *sub = NULL;
+	dns_zone_t *zones[200] = { NULL };
+	char buf[64];
+
+	result = dns_zt_create(mctx, dns_rdataclass_in, &zt);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_test_makezone("example", &example, NULL, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_test_makezone("sub.example", &sub, NULL, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	check_find(zt, "www.example", 0, ISC_R_NOTFOUND, NULL);
+
+	assert_int_equal(dns_zt_mount(zt, example), ISC_R_SUCCESS);
+	assert_int_equal(dns_zt_mount(zt, sub), ISC_R_SUCCESS);
+	assert_int_equal(dns_zt_mount(zt, sub), ISC_R_EXISTS);
+
+	check_find(zt, "example", 0, ISC_R_SUCCESS, "example");
+	check_find(zt, "sub.example", 0, ISC_R_SUCCESS, "sub.example");
+	check_find(zt, "SUB.Example", 0, ISC_R_SUCCESS, "sub.example");
+	check_find(zt, "sub.example", DNS_ZTFIND_NOEXACT, DNS_R_PARTIALMATCH,
+		   "example");
+	check_find(zt, "example", DNS_ZTFIND_NOEXACT, ISC_R_NOTFOUND, NULL);
+	check_find(zt, "a.b.sub.example", 0, DNS_R_PARTIALMATCH,
+		   "sub.example");
+	check_find(zt, "www.example", 0, DNS_R_PARTIALMATCH, "example");
+	/* The second lookup of a name is answered by the cache */
+	check_find(zt, "www.example", 0, DNS_R_PARTIALMATCH, "example");
+	check_find(zt, "www.example.org", 0, ISC_R_NOTFOUND, NULL);
+
+	/* The cached result must not survive the zone being unmounted */
+	check_find(zt, "www.sub.example", 0, DNS_R_PARTIALMATCH,
+		   "sub.example");
+	assert_int_equal(dns_zt_unmount(zt, sub), ISC_R_SUCCESS);
+	check_find(zt, "www.sub.example", 0, DNS_R_PARTIALMATCH, "example");
+	assert_int_equal(dns_zt_unmount(zt, sub), ISC_R_NOTFOUND);
+
+	/* Enough zones to make the table grow */
+	for (size_t i = 0; i < ARRAY_SIZE(zones); i++) {
+		snprintf(buf, sizeof(buf), "z%zu.example", i);
+		result = dns_test_makezone(buf, &zones[i], NULL, false);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_int_equal(dns_zt_mount(zt, zones[i]), ISC_R_SUCCESS);
+	}
+	for (size_t i = 0; i < ARRAY_SIZE(zones); i++) {
+		char zbuf[64];
+
+		snprintf(buf, sizeof(buf), "www.z%zu.example", i);
+		snprintf(zbuf, sizeof(zbuf), "z%zu.example", i);
+		check_find(zt, buf, 0, DNS_R_PARTIALMATCH, zbuf);
+	}
+	check_find(zt, "www.example", 0, DNS_R_PARTIALMATCH, "example");
+
+	dns_zt_detach(&zt);
+	for (size_t i = 0; i < ARRAY_SIZE(zones); i++) {
+		dns_zone_detach(&zones[i]);
+	}
+	dns_zone_detach(&sub);
+	dns_zone_detach(&example);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(apply, setup_managers, teardown_managers)
 ISC_TEST_ENTRY_CUSTOM(asyncload_zone, setup_managers, teardown_managers)
 ISC_TEST_ENTRY_CUSTOM(asyncload_zt, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(find, setup_managers, teardown_managers)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
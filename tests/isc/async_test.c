@@ -68,8 +68,47 @@ ISC_RUN_TEST_IMPL(isc_async_run) {
 	assert_int_equal(atomic_load(&scheduled), loopmgr->nloops);
 }
 
+#define ASYNC_JOBS 1024
+
+static atomic_uint ran = 0;
+
+static void
+count_cb(void *arg) {
+	UNUSED(arg);
+
+	if (atomic_fetch_add(&ran, 1) + 1 == ASYNC_JOBS) {
+		isc_loop_t *loop = isc_loop_current(loopmgr);
+		uint64_t wakeups, jobs;
+
+		isc_async_getstats(loop, &wakeups, &jobs);
+		assert_int_equal(jobs, ASYNC_JOBS);
+		assert_in_range(wakeups, 1, ASYNC_JOBS);
+
+		isc_loopmgr_shutdown(loopmgr);
+	}
+}
+
+static void
+count_setup_cb(void *arg) {
+	uint32_t tid = isc_loopmgr_nloops(loopmgr) - 1;
+	isc_loop_t *loop = isc_loop_get(loopmgr, tid);
+
+	UNUSED(arg);
+
+	for (size_t i = 0; i < ASYNC_JOBS; i++) {
+		isc_async_run(loop, count_cb, NULL);
+	}
+}
+
+ISC_RUN_TEST_IMPL(isc_async_stats) {
+	isc_loop_setup(isc_loop_main(loopmgr), count_setup_cb, loopmgr);
+	isc_loopmgr_run(loopmgr);
+	assert_int_equal(atomic_load(&ran), ASYNC_JOBS);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(isc_async_run, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(isc_async_stats, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -85,8 +85,18 @@ ISC_RUN_TEST_IMPL(isc_buffer_reserve) {
 	assert_non_null(b);
 	assert_int_equal(b->length, 4096);
 
+	/*
+	 * This call should double it to 8192 bytes, although 6144 bytes
+	 * would be enough.
+	 */
+	result = isc_buffer_reserve(&b, 4097);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(ISC_BUFFER_VALID(b));
+	assert_non_null(b);
+	assert_int_equal(b->length, 8192);
+
 	/* Consume some of the buffer so we can run the next test. */
-	isc_buffer_add(b, 4096);
+	isc_buffer_add(b, 8192);
 
 	/*
 	 * This call should fail and leave buffer untouched.
@@ -95,7 +105,7 @@ ISC_RUN_TEST_IMPL(isc_buffer_reserve) {
 	assert_int_equal(result, ISC_R_NOMEMORY);
 	assert_true(ISC_BUFFER_VALID(b));
 	assert_non_null(b);
-	assert_int_equal(b->length, 4096);
+	assert_int_equal(b->length, 8192);
 
 	isc_buffer_free(&b);
 }
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/cpu.h>
+#include <isc/util.h>
+
+#include <tests/isc.h>
+
+/* every feature has a name */
+ISC_RUN_TEST_IMPL(isc_cpu_featurename) {
+	for (uint32_t feature = 1; (feature & ISC_CPU_ALL) != 0;
+	     feature <<= 1)
+	{
+		assert_non_null(isc_cpu_featurename(feature));
+	}
+	assert_null(isc_cpu_featurename(ISC_CPU_AVX2 | ISC_CPU_SSE42));
+	assert_null(isc_cpu_featurename(ISC_CPU_ALL + 1));
+}
+
+/* the features are consistent with the architecture */
+ISC_RUN_TEST_IMPL(isc_cpu_features) {
+	uint32_t features = isc_cpu_features();
+
+	assert_int_equal(features & ~(uint32_t)ISC_CPU_ALL, 0);
+	assert_true(isc_cpu_has(0));
+#if defined(__x86_64__) || defined(__i386__)
+	assert_false(isc_cpu_has(ISC_CPU_NEON));
+#elif defined(__aarch64__)
+	assert_false(isc_cpu_has(ISC_CPU_AVX2));
+	if (getenv("ISC_CPU_DISABLE") == NULL) {
+		assert_true(isc_cpu_has(ISC_CPU_NEON));
+	}
+#endif
+	if (isc_cpu_has(ISC_CPU_AVX512)) {
+		assert_true(isc_cpu_has(ISC_CPU_AVX2));
+	}
+}
+
+/* disabled features are no longer reported */
+ISC_RUN_TEST_IMPL(isc_cpu_disable) {
+	uint32_t features = isc_cpu_features();
+
+	isc_cpu_disable(ISC_CPU_AVX2);
+	assert_false(isc_cpu_has(ISC_CPU_AVX2));
+	assert_false(isc_cpu_has(ISC_CPU_AVX2 | ISC_CPU_SSE42));
+	assert_int_equal(isc_cpu_features(), features & ~ISC_CPU_AVX2);
+
+	isc_cpu_disable(ISC_CPU_ALL);
+	assert_int_equal(isc_cpu_features(), 0);
+	assert_true(isc_cpu_has(0));
+}
+
+ISC_TEST_LIST_START
+
+ISC_TEST_ENTRY(isc_cpu_featurename)
+ISC_TEST_ENTRY(isc_cpu_features)
+ISC_TEST_ENTRY(isc_cpu_disable)
+
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -1773,6 +1773,57 @@ ISC_RUN_TEST_IMPL(doh_connect_makeuri) {
 	assert_true(strcmp("https://[::1]:44343/dns-query", uri) == 0);
 }
 
+ISC_RUN_TEST_IMPL(doh_response_cache) {
+	isc__nm_http_rcache_t *cache = rcache_create(mctx, 2);
+	http_rcache_entry_t *entry = NULL;
+	unsigned char response[12] = { 0x12, 0x34, 0x81, 0x80 };
+	unsigned char request[12] = { 0xab, 0xcd, 0x01, 0x00 };
+	isc_region_t region = { request, sizeof(request) };
+	unsigned char target[sizeof(response)];
+	const unsigned char *a = (const unsigned char *)"a";
+	const unsigned char *b = (const unsigned char *)"b";
+	const unsigned char *c = (const unsigned char *)"c";
+	isc_stdtime_t now = 1000;
+
+	/* Miss, then a hit once the response has been added */
+	assert_null(rcache_lookup(cache, a, 1, now));
+	rcache_add(cache, a, 1, response, sizeof(response), now, 300);
+	assert_int_equal(cache->count, 1);
+	entry = rcache_lookup(cache, a, 1, now + 10);
+	assert_non_null(entry);
+	assert_int_equal(entry->ttl, 300);
+	assert_int_equal(entry->stored, now);
+
+	/* The stored ID is cleared and the one of the request restored */
+	assert_int_equal(entry->response[0], 0);
+	assert_int_equal(entry->response[1], 0);
+	rcache_copyresponse(entry, &region, target);
+	assert_int_equal(target[0], 0xab);
+	assert_int_equal(target[1], 0xcd);
+	assert_memory_equal(target + 2, response + 2, sizeof(response) - 2);
+
+	/* Entries expire after their TTL */
+	assert_non_null(rcache_lookup(cache, a, 1, now + 299));
+	assert_null(rcache_lookup(cache, a, 1, now + 300));
+	assert_int_equal(cache->count, 0);
+
+	/* The least recently used entry is evicted */
+	rcache_add(cache, a, 1, response, sizeof(response), now, 300);
+	rcache_add(cache, b, 1, response, sizeof(response), now, 300);
+	assert_non_null(rcache_lookup(cache, a, 1, now));
+	rcache_add(cache, c, 1, response, sizeof(response), now, 300);
+	assert_int_equal(cache->count, 2);
+	assert_non_null(rcache_lookup(cache, a, 1, now));
+	assert_null(rcache_lookup(cache, b, 1, now));
+	assert_non_null(rcache_lookup(cache, c, 1, now));
+
+	/* Keys differing only in length do not match */
+	assert_null(rcache_lookup(cache, c, 2, now));
+
+	rcache_destroy(&cache);
+	assert_null(cache);
+}
+
 ISC_TEST_LIST_START
 
 /* Mock tests are unreliable on OpenBSD */
@@ -1785,6 +1836,7 @@ ISC_TEST_ENTRY(doh_base64url_to_base64)
 ISC_TEST_ENTRY(doh_base64_to_base64url)
 ISC_TEST_ENTRY(doh_path_validation)
 ISC_TEST_ENTRY(doh_connect_makeuri)
+ISC_TEST_ENTRY(doh_response_cache)
 ISC_TEST_ENTRY_CUSTOM(doh_noop_POST, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(doh_noop_GET, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(doh_noresponse_POST, setup_test, teardown_test)
@@ -0,0 +1,315 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/hash.h>
+#include <isc/hashmap.h>
+#include <isc/mem.h>
+#include <isc/print.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <tests/isc.h>
+
+/* INCLUDE LAST */
+
+#define mctx __mctx
+#include "hashmap.c"
+#undef mctx
+
+typedef struct test_node {
+	uintptr_t value;
+	char key[32];
+} test_node_t;
+
+/*
+ * The hashmap only keeps pointers to the keys, so they are kept in
+ * 'nodes' for the duration of a test.
+ */
+static test_node_t *
+test_nodes(size_t count, const char *suffix) {
+	test_node_t *nodes = isc_mem_get(mctx, count * sizeof(nodes[0]));
+
+	for (size_t i = 0; i < count; i++) {
+		nodes[i].value = i + 1;
+		snprintf(nodes[i].key, sizeof(nodes[i].key), "%zu%s", i,
+			 suffix);
+	}
+
+	return (nodes);
+}
+
+static void
+test_hashmap_full(uint8_t init_bits, uint8_t finish_bits, size_t count) {
+	isc_hashmap_t *hashmap = NULL;
+	test_node_t *lower = test_nodes(count, " key of a map");
+	test_node_t *upper = test_nodes(count, " KEY OF A MAP");
+	isc_result_t result;
+
+	isc_hashmap_create(mctx, init_bits, ISC_HASHMAP_CASE_SENSITIVE,
+			   &hashmap);
+	assert_non_null(hashmap);
+
+	for (size_t i = 0; i < count; i++) {
+		result = isc_hashmap_add(hashmap, (uint8_t *)lower[i].key,
+					 strlen(lower[i].key), &lower[i]);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+	assert_int_equal(isc_hashmap_count(hashmap), count);
+
+	for (size_t i = 0; i < count; i++) {
+		void *f = NULL;
+		result = isc_hashmap_find(hashmap, (uint8_t *)lower[i].key,
+					  strlen(lower[i].key), &f);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_ptr_equal(f, &lower[i]);
+
+		result = isc_hashmap_add(hashmap, (uint8_t *)lower[i].key,
+					 strlen(lower[i].key), &lower[i]);
+		assert_int_equal(result, ISC_R_EXISTS);
+
+		/* Shorter key with the same prefix */
+		result = isc_hashmap_find(hashmap, (uint8_t *)lower[i].key,
+					  strlen(lower[i].key) - 1, NULL);
+		assert_int_equal(result, ISC_R_NOTFOUND);
+
+		/* Keys are case sensitive */
+		result = isc_hashmap_find(hashmap, (uint8_t *)upper[i].key,
+					  strlen(upper[i].key), NULL);
+		assert_int_equal(result, ISC_R_NOTFOUND);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		result = isc_hashmap_add(hashmap, (uint8_t *)upper[i].key,
+					 strlen(upper[i].key), &upper[i]);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		void *f = NULL;
+		result = isc_hashmap_delete(hashmap, (uint8_t *)lower[i].key,
+					    strlen(lower[i].key));
+		assert_int_equal(result, ISC_R_SUCCESS);
+		result = isc_hashmap_find(hashmap, (uint8_t *)lower[i].key,
+					  strlen(lower[i].key), &f);
+		assert_int_equal(result, ISC_R_NOTFOUND);
+		assert_null(f);
+		result = isc_hashmap_delete(hashmap, (uint8_t *)lower[i].key,
+					    strlen(lower[i].key));
+		assert_int_equal(result, ISC_R_NOTFOUND);
+	}
+	assert_int_equal(isc_hashmap_count(hashmap), count);
+
+	for (size_t i = 0; i < count; i++) {
+		void *f = NULL;
+		result = isc_hashmap_find(hashmap, (uint8_t *)upper[i].key,
+					  strlen(upper[i].key), &f);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_ptr_equal(f, &upper[i]);
+	}
+
+	assert_int_equal(hashmap->tables[hashmap->hindex].bits, finish_bits);
+
+	isc_hashmap_destroy(&hashmap);
+	assert_null(hashmap);
+
+	isc_mem_put(mctx, lower, count * sizeof(lower[0]));
+	isc_mem_put(mctx, upper, count * sizeof(upper[0]));
+}
+
+static void
+test_hashmap_iterator(void) {
+	isc_hashmap_t *hashmap = NULL;
+	isc_result_t result;
+	isc_hashmap_iter_t *iter = NULL;
+	size_t count = 7200;
+	test_node_t *nodes = test_nodes(count, " key of a map");
+	size_t walked;
+
+	isc_hashmap_create(mctx, HASHMAP_MIN_BITS, ISC_HASHMAP_CASE_SENSITIVE,
+			   &hashmap);
+	assert_non_null(hashmap);
+
+	for (size_t i = 0; i < count; i++) {
+		result = isc_hashmap_add(hashmap, (uint8_t *)nodes[i].key,
+					 strlen(nodes[i].key), &nodes[i]);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+
+	/* We want to iterate while rehashing is in progress */
+	assert_true(rehashing_in_progress(hashmap));
+
+	walked = 0;
+	isc_hashmap_iter_create(hashmap, &iter);
+
+	for (result = isc_hashmap_iter_first(iter); result == ISC_R_SUCCESS;
+	     result = isc_hashmap_iter_next(iter))
+	{
+		test_node_t *node = NULL;
+		const uint8_t *tkey = NULL;
+		size_t tksize;
+
+		isc_hashmap_iter_current(iter, (void **)&node);
+		isc_hashmap_iter_currentkey(iter, &tkey, &tksize);
+		assert_ptr_equal(tkey, node->key);
+		assert_int_equal(tksize, strlen(node->key));
+		walked++;
+	}
+	assert_int_equal(walked, count);
+	assert_int_equal(result, ISC_R_NOMORE);
+
+	/* erase odd */
+	walked = 0;
+	result = isc_hashmap_iter_first(iter);
+	while (result == ISC_R_SUCCESS) {
+		test_node_t *node = NULL;
+
+		isc_hashmap_iter_current(iter, (void **)&node);
+		if (node->value % 2 == 1) {
+			result = isc_hashmap_iter_delcurrent_next(iter);
+		} else {
+			result = isc_hashmap_iter_next(iter);
+		}
+		walked++;
+	}
+	assert_int_equal(result, ISC_R_NOMORE);
+	assert_int_equal(walked, count);
+	assert_int_equal(isc_hashmap_count(hashmap), count / 2);
+
+	/* erase even */
+	walked = 0;
+	result = isc_hashmap_iter_first(iter);
+	while (result == ISC_R_SUCCESS) {
+		test_node_t *node = NULL;
+
+		isc_hashmap_iter_current(iter, (void **)&node);
+		assert_int_equal(node->value % 2, 0);
+		result = isc_hashmap_iter_delcurrent_next(iter);
+		walked++;
+	}
+	assert_int_equal(result, ISC_R_NOMORE);
+	assert_int_equal(walked, count / 2);
+	assert_int_equal(isc_hashmap_count(hashmap), 0);
+
+	result = isc_hashmap_iter_first(iter);
+	assert_int_equal(result, ISC_R_NOMORE);
+
+	/* Iterator doesn't progress rehashing */
+	assert_true(rehashing_in_progress(hashmap));
+
+	isc_hashmap_iter_destroy(&iter);
+	assert_null(iter);
+
+	isc_hashmap_destroy(&hashmap);
+	assert_null(hashmap);
+
+	isc_mem_put(mctx, nodes, count * sizeof(nodes[0]));
+}
+
+/* 20 bit, 200K elements test, no rehashing */
+ISC_RUN_TEST_IMPL(isc_hashmap_20) {
+	UNUSED(state);
+	test_hashmap_full(20, 20, 200000);
+}
+
+/* 1 bit, 48K elements test, full rehashing */
+ISC_RUN_TEST_IMPL(isc_hashmap_1) {
+	UNUSED(state);
+	test_hashmap_full(1, 17, 48000);
+}
+
+/* test hashmap iterator */
+ISC_RUN_TEST_IMPL(isc_hashmap_iterator) {
+	UNUSED(state);
+	test_hashmap_iterator();
+}
+
+/* case insensitive keys */
+ISC_RUN_TEST_IMPL(isc_hashmap_case) {
+	isc_hashmap_t *hashmap = NULL;
+	test_node_t lower = { .key = "example.com" };
+	test_node_t upper = { .key = "EXAMPLE.com" };
+	isc_result_t result;
+	void *f = NULL;
+
+	UNUSED(state);
+
+	isc_hashmap_create(mctx, 4, ISC_HASHMAP_CASE_INSENSITIVE, &hashmap);
+
+	result = isc_hashmap_add(hashmap, (uint8_t *)lower.key,
+				 strlen(lower.key), &lower);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = isc_hashmap_add(hashmap, (uint8_t *)upper.key,
+				 strlen(upper.key), &upper);
+	assert_int_equal(result, ISC_R_EXISTS);
+	result = isc_hashmap_find(hashmap, (uint8_t *)upper.key,
+				  strlen(upper.key), &f);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_ptr_equal(f, &lower);
+	result = isc_hashmap_delete(hashmap, (uint8_t *)upper.key,
+				    strlen(upper.key));
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(isc_hashmap_count(hashmap), 0);
+
+	isc_hashmap_destroy(&hashmap);
+}
+
+/* adding and deleting does not make the table grow */
+ISC_RUN_TEST_IMPL(isc_hashmap_churn) {
+	isc_hashmap_t *hashmap = NULL;
+	size_t count = 100000;
+	test_node_t *nodes = test_nodes(count, " churn");
+	isc_result_t result;
+
+	UNUSED(state);
+
+	isc_hashmap_create(mctx, 8, ISC_HASHMAP_CASE_SENSITIVE, &hashmap);
+
+	for (size_t i = 0; i < count; i++) {
+		result = isc_hashmap_add(hashmap, (uint8_t *)nodes[i].key,
+					 strlen(nodes[i].key), &nodes[i]);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		if (i >= 64) {
+			result = isc_hashmap_delete(
+				hashmap, (uint8_t *)nodes[i - 64].key,
+				strlen(nodes[i - 64].key));
+			assert_int_equal(result, ISC_R_SUCCESS);
+		}
+	}
+	assert_int_equal(isc_hashmap_count(hashmap), 64);
+	assert_int_equal(hashmap->tables[hashmap->hindex].bits, 8);
+
+	isc_hashmap_destroy(&hashmap);
+	isc_mem_put(mctx, nodes, count * sizeof(nodes[0]));
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY(isc_hashmap_20)
+ISC_TEST_ENTRY(isc_hashmap_1)
+ISC_TEST_ENTRY(isc_hashmap_iterator)
+ISC_TEST_ENTRY(isc_hashmap_case)
+ISC_TEST_ENTRY(isc_hashmap_churn)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -69,9 +69,55 @@ ISC_RUN_TEST_IMPL(isc_heap_delete) {
 	assert_null(heap);
 }
 
+/* test isc_heap_insert_many() */
+ISC_RUN_TEST_IMPL(isc_heap_insert_many) {
+	isc_heap_t *heap = NULL;
+	struct e elts[100];
+	void *ptrs[100];
+	struct e *e = NULL;
+	unsigned int last = 0;
+
+	UNUSED(state);
+
+	isc_heap_create(mctx, compare, idx, 0, &heap);
+	assert_non_null(heap);
+
+	for (size_t i = 0; i < ARRAY_SIZE(elts); i++) {
+		elts[i].value = (i * 37) % ARRAY_SIZE(elts);
+		elts[i].index = 0;
+		ptrs[i] = &elts[i];
+	}
+
+	/*
+	 * The first batch rebuilds the heap; the second, smaller than
+	 * the heap, is inserted element by element.
+	 */
+	isc_heap_insert_many(heap, ptrs, 60);
+	isc_heap_insert_many(heap, ptrs + 60, ARRAY_SIZE(ptrs) - 60);
+
+	for (size_t i = 0; i < ARRAY_SIZE(elts); i++) {
+		assert_ptr_equal(isc_heap_element(heap, elts[i].index),
+				 &elts[i]);
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(elts); i++) {
+		e = isc_heap_element(heap, 1);
+		assert_non_null(e);
+		assert_true(e->value >= last);
+		last = e->value;
+		isc_heap_delete(heap, 1);
+		assert_int_equal(e->index, 0);
+	}
+	assert_null(isc_heap_element(heap, 1));
+
+	isc_heap_destroy(&heap);
+	assert_null(heap);
+}
+
 ISC_TEST_LIST_START
 
 ISC_TEST_ENTRY(isc_heap_delete)
+ISC_TEST_ENTRY(isc_heap_insert_many)
 
 ISC_TEST_LIST_END
 
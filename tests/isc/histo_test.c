@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/histo.h>
+#include <isc/result.h>
+#include <isc/util.h>
+
+#include <tests/isc.h>
+
+/* the buckets cover all values without gaps, within the precision */
+ISC_RUN_TEST_IMPL(isc_histo_buckets) {
+	UNUSED(state);
+
+	for (unsigned int bits = ISC_HISTO_MINBITS; bits <= ISC_HISTO_MAXBITS;
+	     bits++)
+	{
+		isc_histo_t *hg = NULL;
+		uint64_t min, max, prev = 0;
+		unsigned int key;
+
+		isc_histo_create(mctx, bits, 1, &hg);
+
+		for (key = 0; isc_histo_get(hg, key, &min, &max, NULL) ==
+			      ISC_R_SUCCESS;
+		     key++)
+		{
+			if (key == 0) {
+				assert_int_equal(min, 0);
+			} else {
+				assert_int_equal(min, prev + 1);
+			}
+			assert_true(max >= min);
+			/* The width is at most min / 2^bits */
+			assert_true(max - min <= (min >> bits));
+			prev = max;
+		}
+		assert_int_equal(max, UINT64_MAX);
+		assert_int_equal(key, (65 - bits) << bits);
+
+		isc_histo_detach(&hg);
+		assert_null(hg);
+	}
+}
+
+/* values are counted in the bucket that covers them */
+ISC_RUN_TEST_IMPL(isc_histo_count) {
+	isc_histo_t *hg = NULL;
+	uint64_t values[] = { 0, 1, 7, 8, 9, 1000, 1023, 1024, 1151, 1152,
+			      123456789, UINT64_MAX };
+	uint64_t min, max, count, total = 0;
+	unsigned int key, nonempty = 0;
+
+	UNUSED(state);
+
+	isc_histo_create(mctx, 3, 4, &hg);
+
+	for (size_t i = 0; i < ARRAY_SIZE(values); i++) {
+		isc_histo_inc(hg, values[i]);
+	}
+	isc_histo_add(hg, 1000, 9);
+
+	for (key = 0;
+	     isc_histo_get(hg, key, &min, &max, &count) == ISC_R_SUCCESS;
+	     isc_histo_next(hg, &key))
+	{
+		if (count == 0) {
+			continue;
+		}
+		nonempty++;
+		total += count;
+
+		for (size_t i = 0; i < ARRAY_SIZE(values); i++) {
+			if (values[i] >= min && values[i] <= max) {
+				count--;
+			}
+		}
+		if (min <= 1000 && 1000 <= max) {
+			assert_int_equal(count, 9);
+		} else {
+			assert_int_equal(count, 0);
+		}
+	}
+
+	assert_int_equal(total, ARRAY_SIZE(values) + 9);
+	/* 1000 and 1023 share a bucket, and so do 1024 and 1151 */
+	assert_int_equal(nonempty, ARRAY_SIZE(values) - 2);
+
+	isc_histo_detach(&hg);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY(isc_histo_buckets)
+ISC_TEST_ENTRY(isc_histo_count)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -151,6 +151,36 @@ ISC_RUN_TEST_IMPL(isc_hmac_init) {
 	assert_int_equal(isc_hmac_reset(hmac), ISC_R_SUCCESS);
 }
 
+ISC_RUN_TEST_IMPL(isc_hmac_copy) {
+	isc_hmac_t *hmac = *state;
+	isc_hmac_t *copy = isc_hmac_new();
+	unsigned char digest1[ISC_MAX_MD_SIZE], digest2[ISC_MAX_MD_SIZE];
+	unsigned int digestlen1 = sizeof(digest1);
+	unsigned int digestlen2 = sizeof(digest2);
+
+	assert_non_null(hmac);
+	assert_int_equal(isc_hmac_init(hmac, "too many secrets", 16,
+				       ISC_MD_SHA256),
+			 ISC_R_SUCCESS);
+
+	/* A copy of a keyed context computes the same HMAC. */
+	assert_int_equal(isc_hmac_copy(copy, hmac), ISC_R_SUCCESS);
+	assert_int_equal(isc_hmac_update(hmac, (const unsigned char *)
+					 TEST_INPUT("data")),
+			 ISC_R_SUCCESS);
+	assert_int_equal(isc_hmac_update(copy, (const unsigned char *)
+					 TEST_INPUT("data")),
+			 ISC_R_SUCCESS);
+	assert_int_equal(isc_hmac_final(hmac, digest1, &digestlen1),
+			 ISC_R_SUCCESS);
+	assert_int_equal(isc_hmac_final(copy, digest2, &digestlen2),
+			 ISC_R_SUCCESS);
+	assert_int_equal(digestlen1, digestlen2);
+	assert_memory_equal(digest1, digest2, digestlen1);
+
+	isc_hmac_free(copy);
+}
+
 ISC_RUN_TEST_IMPL(isc_hmac_update) {
 	isc_hmac_t *hmac = *state;
 	assert_non_null(hmac);
@@ -900,6 +930,7 @@ ISC_TEST_ENTRY(isc_hmac_new)
 ISC_TEST_ENTRY_CUSTOM(isc_hmac_init, _reset, _reset)
 
 ISC_TEST_ENTRY_CUSTOM(isc_hmac_reset, _reset, _reset)
+ISC_TEST_ENTRY_CUSTOM(isc_hmac_copy, _reset, _reset)
 
 ISC_TEST_ENTRY(isc_hmac_md5)
 ISC_TEST_ENTRY(isc_hmac_sha1)
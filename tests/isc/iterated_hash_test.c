@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/* ! \file */
+
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/iterated_hash.h>
+#include <isc/util.h>
+
+#include <tests/isc.h>
+
+#define NINPUTS 21
+
+static const unsigned char salt[] = { 0xaa, 0xbb, 0xcc, 0xdd };
+
+/* RFC 5155 Appendix A: example, a.example and ns1.example */
+static const unsigned char example[] = "\007example";
+static const unsigned char a_example[] = "\001a\007example";
+static const unsigned char ns1_example[] = "\003ns1\007example";
+
+static const unsigned char example_hash[] = {
+	0x06, 0x53, 0x68, 0xab, 0xee, 0xd7, 0xec, 0x6e, 0x9f, 0xeb,
+	0xa9, 0x6b, 0x8c, 0x8b, 0xc3, 0xe8, 0xb7, 0x91, 0xf7, 0x16
+};
+static const unsigned char a_example_hash[] = {
+	0x19, 0x6d, 0xd8, 0xc3, 0x30, 0x67, 0x83, 0xa8, 0x19, 0x0f,
+	0x52, 0xc2, 0x62, 0xd2, 0xb7, 0xe5, 0xe8, 0x36, 0xe7, 0xf5
+};
+static const unsigned char ns1_example_hash[] = {
+	0x17, 0x4e, 0xb2, 0x40, 0x9f, 0xe2, 0x8b, 0xcb, 0x48, 0x87,
+	0xa1, 0x83, 0x6f, 0x95, 0x7f, 0x0a, 0x84, 0x25, 0xe2, 0x7b
+};
+
+/* isc_iterated_hash() computes the RFC 5155 test vectors */
+ISC_RUN_TEST_IMPL(isc_iterated_hash) {
+	unsigned char out[NSEC3_MAX_HASH_LENGTH];
+	int len;
+
+	len = isc_iterated_hash(out, 1, 12, salt, sizeof(salt), example,
+				sizeof(example));
+	assert_int_equal(len, sizeof(example_hash));
+	assert_memory_equal(out, example_hash, len);
+
+	len = isc_iterated_hash(out, 1, 12, salt, sizeof(salt), a_example,
+				sizeof(a_example));
+	assert_int_equal(len, sizeof(a_example_hash));
+	assert_memory_equal(out, a_example_hash, len);
+
+	/* unknown algorithm */
+	len = isc_iterated_hash(out, 2, 12, salt, sizeof(salt), example,
+				sizeof(example));
+	assert_int_equal(len, 0);
+}
+
+/* isc_iterated_hash_many() computes the RFC 5155 test vectors */
+ISC_RUN_TEST_IMPL(isc_iterated_hash_many) {
+	unsigned char buf[3][NSEC3_MAX_HASH_LENGTH];
+	unsigned char *out[3] = { buf[0], buf[1], buf[2] };
+	const unsigned char *in[3] = { example, a_example, ns1_example };
+	int inlength[3] = { sizeof(example), sizeof(a_example),
+			    sizeof(ns1_example) };
+	int len;
+
+	len = isc_iterated_hash_many(out, 1, 12, salt, sizeof(salt), in,
+				     inlength, 3);
+	assert_int_equal(len, 20);
+	assert_memory_equal(out[0], example_hash, len);
+	assert_memory_equal(out[1], a_example_hash, len);
+	assert_memory_equal(out[2], ns1_example_hash, len);
+
+	/* unknown algorithm */
+	len = isc_iterated_hash_many(out, 2, 12, salt, sizeof(salt), in,
+				     inlength, 3);
+	assert_int_equal(len, 0);
+}
+
+/*
+ * isc_iterated_hash_many() gives the same results as isc_iterated_hash()
+ * for partial and several batches, with salts that make the hashed
+ * message span one to five blocks.
+ */
+ISC_RUN_TEST_IMPL(isc_iterated_hash_many_equal) {
+	unsigned char longsalt[255];
+	unsigned char inbuf[NINPUTS][64];
+	unsigned char outbuf[NINPUTS][NSEC3_MAX_HASH_LENGTH];
+	unsigned char *out[NINPUTS];
+	const unsigned char *in[NINPUTS];
+	int inlength[NINPUTS];
+	const int saltlengths[] = { 0, 8, 35, 36, 44, 100, 255 };
+	const int iterations[] = { 0, 1, 10, 150 };
+
+	for (size_t i = 0; i < sizeof(longsalt); i++) {
+		longsalt[i] = (unsigned char)(i * 7 + 3);
+	}
+	for (size_t i = 0; i < NINPUTS; i++) {
+		inlength[i] = (int)(1 + i * 3);
+		for (int j = 0; j < inlength[i]; j++) {
+			inbuf[i][j] = (unsigned char)(i + j * 13);
+		}
+		in[i] = inbuf[i];
+		out[i] = outbuf[i];
+	}
+
+	for (size_t s = 0; s < ARRAY_SIZE(saltlengths); s++) {
+		for (size_t it = 0; it < ARRAY_SIZE(iterations); it++) {
+			int len = isc_iterated_hash_many(
+				out, 1, iterations[it], longsalt,
+				saltlengths[s], in, inlength, NINPUTS);
+			assert_int_equal(len, 20);
+
+			for (size_t i = 0; i < NINPUTS; i++) {
+				unsigned char expected[NSEC3_MAX_HASH_LENGTH];
+
+				len = isc_iterated_hash(
+					expected, 1, iterations[it], longsalt,
+					saltlengths[s], in[i], inlength[i]);
+				assert_int_equal(len, 20);
+				assert_memory_equal(out[i], expected, len);
+			}
+		}
+	}
+}
+
+ISC_TEST_LIST_START
+
+ISC_TEST_ENTRY(isc_iterated_hash)
+ISC_TEST_ENTRY(isc_iterated_hash_many)
+ISC_TEST_ENTRY(isc_iterated_hash_many_equal)
+
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -342,9 +342,79 @@ ISC_RUN_TEST_IMPL(lex_keypair) {
 	}
 }
 
+/*%
+ * master file comments and tokens longer than the initial token size
+ */
+ISC_RUN_TEST_IMPL(lex_master) {
+	const char text[] = "; leading comment\n"
+			    "www.example.com. ( 3600 ; inside parentheses\n"
+			    "\tIN ) A 192.0.2.1;trailing\n"
+			    "long\\;name;comment";
+	const char *expect[] = { "www.example.com.", "3600", "IN", "A",
+				 "192.0.2.1", NULL, "long\\;name" };
+	unsigned long lines[] = { 2, 2, 3, 3, 3, 4, 4 };
+	isc_buffer_t buf;
+	isc_lex_t *lex = NULL;
+	isc_lexspecials_t specials;
+	isc_result_t result;
+	isc_token_t token;
+	size_t i;
+
+	UNUSED(state);
+
+	result = isc_lex_create(mctx, 4, &lex);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	memset(specials, 0, sizeof(specials));
+	specials['('] = 1;
+	specials[')'] = 1;
+	specials['"'] = 1;
+	isc_lex_setspecials(lex, specials);
+	isc_lex_setcomments(lex, ISC_LEXCOMMENT_DNSMASTERFILE);
+
+	isc_buffer_constinit(&buf, text, strlen(text));
+	isc_buffer_add(&buf, strlen(text));
+
+	result = isc_lex_openbuffer(lex, &buf);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = isc_lex_getmastertoken(lex, &token, isc_tokentype_string,
+					true);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(token.type, isc_tokentype_eol);
+
+	for (i = 0; i < ARRAY_SIZE(expect); i++) {
+		result = isc_lex_getmastertoken(lex, &token,
+						isc_tokentype_string, true);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		if (expect[i] == NULL) {
+			assert_int_equal(token.type, isc_tokentype_eol);
+		} else {
+			assert_int_equal(token.type, isc_tokentype_string);
+			assert_string_equal(AS_STR(token), expect[i]);
+
+			/* the token must read back the same after ungetting */
+			isc_lex_ungettoken(lex, &token);
+			result = isc_lex_getmastertoken(
+				lex, &token, isc_tokentype_string, true);
+			assert_int_equal(result, ISC_R_SUCCESS);
+			assert_string_equal(AS_STR(token), expect[i]);
+		}
+		assert_int_equal(isc_lex_getsourceline(lex), lines[i]);
+	}
+
+	result = isc_lex_getmastertoken(lex, &token, isc_tokentype_string,
+					true);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(token.type, isc_tokentype_eof);
+
+	isc_lex_destroy(&lex);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(lex_0xff)
 ISC_TEST_ENTRY(lex_keypair)
+ISC_TEST_ENTRY(lex_master)
 ISC_TEST_ENTRY(lex_setline)
 ISC_TEST_ENTRY(lex_string)
 ISC_TEST_ENTRY(lex_qstring)
@@ -24,6 +24,7 @@
 #include <cmocka.h>
 
 #include <isc/atomic.h>
+#include <isc/histo.h>
 #include <isc/loop.h>
 #include <isc/os.h>
 #include <isc/result.h>
@@ -130,12 +131,100 @@ ISC_RUN_TEST_IMPL(isc_loopmgr_sigterm) {
 	isc_loopmgr_run(loopmgr);
 }
 
+static void
+slow_job(void *arg) {
+	UNUSED(arg);
+
+	usleep(20000);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static void
+start_slow_job(void *arg) {
+	UNUSED(arg);
+
+	isc_job_run(loopmgr, slow_job, loopmgr);
+}
+
+ISC_RUN_TEST_IMPL(isc_loopmgr_health) {
+	isc_loopcallback_t callbacks[ISC_LOOP_CALLBACKS];
+	isc_loopstats_t stats;
+	size_t ncallbacks;
+	uint64_t min, max, count, total = 0;
+	isc_histo_t *hg = NULL;
+
+	isc_loopmgr_setstallthreshold(loopmgr, 10);
+	isc_loop_setup(mainloop, start_slow_job, loopmgr);
+
+	isc_loopmgr_run(loopmgr);
+
+	isc_loop_getstats(mainloop, &stats);
+	assert_true(stats.iterations > 0);
+	assert_true(stats.jobs >= 2);
+	assert_true(stats.maxjobs >= 1);
+	assert_true(stats.maxtime >= 20000);
+	assert_true(stats.stalls >= 1);
+
+	/* Every iteration is counted in the histogram */
+	hg = isc_loop_gethistogram(mainloop);
+	for (unsigned int key = 0;
+	     isc_histo_get(hg, key, &min, &max, &count) == ISC_R_SUCCESS;
+	     isc_histo_next(hg, &key))
+	{
+		total += count;
+	}
+	assert_int_equal(total, stats.iterations);
+
+	/* The slow job ran for a millisecond or more, and is the slowest */
+	ncallbacks = isc_loop_getcallbacks(mainloop, callbacks,
+					   ARRAY_SIZE(callbacks));
+	assert_true(ncallbacks >= 1);
+	assert_string_equal(callbacks[0].name, "slow_job");
+	assert_int_equal(callbacks[0].count, 1);
+	assert_true(callbacks[0].maxtime >= 20000);
+	assert_int_equal(callbacks[0].time, callbacks[0].maxtime);
+}
+
+static void
+check_affinity(void *arg) {
+	isc_loop_t *loop = isc_loop_current(loopmgr);
+
+	UNUSED(arg);
+
+	/* A pinned thread is only allowed to run on its own CPU */
+	if (loop->cpu >= 0) {
+		assert_int_equal(isc_thread_cpu(0), loop->cpu);
+		assert_int_equal(isc_thread_cpu(1), loop->cpu);
+	}
+
+	atomic_fetch_add(&scheduled, 1);
+}
+
+/*
+ * This leaves the main thread pinned to a single CPU, so it should stay
+ * the last test.
+ */
+ISC_RUN_TEST_IMPL(isc_loopmgr_affinity) {
+	atomic_store(&scheduled, 0);
+
+	isc_loopmgr_setaffinity(loopmgr, true);
+	isc_loopmgr_setup(loopmgr, check_affinity, loopmgr);
+	isc_loop_setup(mainloop, shutdown_loopmgr, loopmgr);
+
+	isc_loopmgr_run(loopmgr);
+
+	assert_int_equal(atomic_load(&scheduled), loopmgr->nloops);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(isc_loopmgr, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(isc_loopmgr_pause, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(isc_loopmgr_runjob, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(isc_loopmgr_sigint, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(isc_loopmgr_sigterm, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(isc_loopmgr_health, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(isc_loopmgr_affinity, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
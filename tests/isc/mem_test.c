@@ -17,7 +17,9 @@
 #include <setjmp.h>
 #include <stdarg.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #define UNIT_TESTING
@@ -26,12 +28,14 @@
 #include <isc/atomic.h>
 #include <isc/file.h>
 #include <isc/mem.h>
+#include <isc/memprof.h>
 #include <isc/mutex.h>
 #include <isc/os.h>
 #include <isc/print.h>
 #include <isc/result.h>
 #include <isc/stdio.h>
 #include <isc/thread.h>
+#include <isc/tid.h>
 #include <isc/time.h>
 #include <isc/util.h>
 
@@ -235,6 +239,66 @@ ISC_RUN_TEST_IMPL(isc_mem_inuse) {
 	isc_mem_destroy(&mctx2);
 }
 
+#define STATS_ITEMS 1000
+#define STATS_SIZE  100
+
+static atomic_uint_fast32_t stats_tid = 0;
+
+static isc_threadresult_t
+stats_thread(isc_threadarg_t arg) {
+	void **items = arg;
+	isc_mem_t *mctx2 = items[0];
+
+	isc__tid_init(atomic_fetch_add(&stats_tid, 1));
+
+	for (size_t i = 0; i < STATS_ITEMS; i++) {
+		void *ptr = isc_mem_get(mctx2, STATS_SIZE);
+		isc_mem_put(mctx2, ptr, STATS_SIZE);
+		items[i] = isc_mem_get(mctx2, STATS_SIZE);
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+/* test that loop threads' counters add up */
+ISC_RUN_TEST_IMPL(isc_mem_threadstats) {
+	isc_mem_t *mctx2 = NULL;
+	isc_thread_t threads[4];
+	void *items[4][STATS_ITEMS];
+	size_t before, after;
+
+	UNUSED(state);
+
+	isc_mem_create(&mctx2);
+
+	before = isc_mem_inuse(mctx2);
+
+	for (size_t i = 0; i < ARRAY_SIZE(threads); i++) {
+		items[i][0] = mctx2;
+		isc_thread_create(stats_thread, items[i], &threads[i]);
+	}
+	for (size_t i = 0; i < ARRAY_SIZE(threads); i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+
+	assert_int_equal(isc_mem_inuse(mctx2) - before,
+			 ARRAY_SIZE(threads) * STATS_ITEMS * STATS_SIZE);
+	assert_int_equal(isc_mem_total(mctx2),
+			 ARRAY_SIZE(threads) * STATS_ITEMS * STATS_SIZE * 2);
+
+	/* Free the memory on a different thread than it was allocated */
+	for (size_t i = 0; i < ARRAY_SIZE(threads); i++) {
+		for (size_t j = 0; j < STATS_ITEMS; j++) {
+			isc_mem_put(mctx2, items[i][j], STATS_SIZE);
+		}
+	}
+
+	after = isc_mem_inuse(mctx2);
+	assert_int_equal(after, before);
+
+	isc_mem_destroy(&mctx2);
+}
+
 ISC_RUN_TEST_IMPL(isc_mem_zeroget) {
 	uint8_t *data = NULL;
 	UNUSED(state);
@@ -290,6 +354,64 @@ ISC_RUN_TEST_IMPL(isc_mem_reget) {
 	isc_mem_put(mctx, data, REGET_SHRINK_SIZE);
 }
 
+#define MEMPROF_ITEMS 10
+#define MEMPROF_SIZE  1024
+
+/* test the sampling heap profiler */
+ISC_RUN_TEST_IMPL(isc_mem_memprof) {
+	void *items[MEMPROF_ITEMS];
+	isc_memprofstatus_t status;
+	isc_result_t result;
+	char *buf = NULL;
+	size_t len = 0;
+	FILE *fp = NULL;
+
+	UNUSED(state);
+
+	/* sample every allocation */
+	result = isc_memprof_start(1);
+	if (result == ISC_R_NOTIMPLEMENTED) {
+		skip();
+		return;
+	}
+	assert_int_equal(result, ISC_R_SUCCESS);
+	isc_memprof_reset();
+
+	for (size_t i = 0; i < MEMPROF_ITEMS; i++) {
+		items[i] = isc_mem_get(mctx, MEMPROF_SIZE);
+	}
+	isc_memprof_stop();
+
+	isc_memprof_status(&status);
+	assert_int_equal(status.rate, 0);
+	assert_int_equal(status.samples, MEMPROF_ITEMS);
+	assert_int_equal(status.bytes, MEMPROF_ITEMS * MEMPROF_SIZE);
+	assert_int_equal(status.allocations, MEMPROF_ITEMS);
+
+	fp = open_memstream(&buf, &len);
+	assert_non_null(fp);
+	result = isc_memprof_dump(fp);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	fclose(fp);
+	assert_non_null(buf);
+	assert_memory_equal(buf, "heap profile:", strlen("heap profile:"));
+	assert_non_null(strstr(buf, "@ heap_v2/1\n"));
+	assert_non_null(strstr(buf, "MAPPED_LIBRARIES:"));
+	free(buf);
+
+	/* frees are tracked even when sampling is stopped */
+	for (size_t i = 0; i < MEMPROF_ITEMS; i++) {
+		isc_mem_put(mctx, items[i], MEMPROF_SIZE);
+	}
+
+	isc_memprof_status(&status);
+	assert_int_equal(status.samples, 0);
+	assert_int_equal(status.bytes, 0);
+	assert_int_equal(status.allocations, MEMPROF_ITEMS);
+
+	isc_memprof_reset();
+}
+
 #if ISC_MEM_TRACKLINES
 
 /* test mem with no flags */
@@ -499,8 +621,10 @@ ISC_TEST_ENTRY(isc_mem_aligned)
 #endif /* defined(HAVE_MALLOC_NP_H) || defined(HAVE_JEMALLOC) */
 ISC_TEST_ENTRY(isc_mem_total)
 ISC_TEST_ENTRY(isc_mem_inuse)
+ISC_TEST_ENTRY(isc_mem_threadstats)
 ISC_TEST_ENTRY(isc_mem_zeroget)
 ISC_TEST_ENTRY(isc_mem_reget)
+ISC_TEST_ENTRY(isc_mem_memprof)
 
 #if !defined(__SANITIZE_THREAD__)
 ISC_TEST_ENTRY(isc_mem_benchmark)
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/proxy2.h>
+#include <isc/sockaddr.h>
+#include <isc/util.h>
+
+#include <tests/isc.h>
+
+#define SIGNATURE                                                      \
+	0x0D, 0x0A, 0x0D, 0x0A, 0x00, 0x0D, 0x0A, 0x51, 0x55, 0x49, 0x54, \
+		0x0A
+
+/* PROXY UDP over IPv4 from 192.0.2.1#53000 to 198.51.100.1#53 */
+static uint8_t proxy_v4[] = {
+	SIGNATURE, 0x21, 0x12, 0x00, 0x0c,	      /* header */
+	192, 0, 2, 1, 198, 51, 100, 1, 0xcf, 0x08, 0x00, 0x35, /* addresses */
+	0xde, 0xad,					      /* payload */
+};
+
+/* PROXY TCP over IPv6 from 2001:db8::1#1234 to 2001:db8::2#53, one TLV */
+static uint8_t proxy_v6[] = {
+	SIGNATURE, 0x21, 0x21, 0x00, 0x28, /* header */
+	0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1,
+	0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2,
+	0x04, 0xd2, 0x00, 0x35, /* ports */
+	0x04, 0x00, 0x01, 0x00, /* TLV */
+};
+
+/* LOCAL, as sent by the load balancer health checks */
+static uint8_t local[] = { SIGNATURE, 0x20, 0x00, 0x00, 0x00 };
+
+ISC_RUN_TEST_IMPL(proxy2_parse_v4) {
+	isc_result_t result;
+	isc_proxy2_t proxy;
+	isc_region_t region = { proxy_v4, sizeof(proxy_v4) };
+	isc_sockaddr_t expected;
+	struct in_addr in;
+
+	result = isc_proxy2_parse(&region, &proxy);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(proxy.length, sizeof(proxy_v4) - 2);
+	assert_int_equal(proxy.command, ISC_PROXY2_CMD_PROXY);
+	assert_true(proxy.addresses);
+
+	in.s_addr = htonl(0xc0000201);
+	isc_sockaddr_fromin(&expected, &in, 53000);
+	assert_true(isc_sockaddr_equal(&proxy.source, &expected));
+
+	in.s_addr = htonl(0xc6336401);
+	isc_sockaddr_fromin(&expected, &in, 53);
+	assert_true(isc_sockaddr_equal(&proxy.destination, &expected));
+}
+
+ISC_RUN_TEST_IMPL(proxy2_parse_v6) {
+	isc_result_t result;
+	isc_proxy2_t proxy;
+	isc_region_t region = { proxy_v6, sizeof(proxy_v6) };
+	isc_sockaddr_t expected;
+	struct in6_addr in6;
+
+	result = isc_proxy2_parse(&region, &proxy);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(proxy.length, sizeof(proxy_v6));
+	assert_true(proxy.addresses);
+
+	memmove(&in6, proxy_v6 + ISC_PROXY2_HEADER_SIZE, sizeof(in6));
+	isc_sockaddr_fromin6(&expected, &in6, 1234);
+	assert_true(isc_sockaddr_equal(&proxy.source, &expected));
+}
+
+ISC_RUN_TEST_IMPL(proxy2_parse_local) {
+	isc_result_t result;
+	isc_proxy2_t proxy;
+	isc_region_t region = { local, sizeof(local) };
+
+	result = isc_proxy2_parse(&region, &proxy);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(proxy.length, ISC_PROXY2_HEADER_SIZE);
+	assert_int_equal(proxy.command, ISC_PROXY2_CMD_LOCAL);
+	assert_false(proxy.addresses);
+}
+
+ISC_RUN_TEST_IMPL(proxy2_parse_partial) {
+	isc_result_t result;
+	isc_proxy2_t proxy;
+	isc_region_t region;
+
+	/* Every proper prefix of the header needs more data */
+	for (size_t i = 0; i < sizeof(proxy_v6); i++) {
+		region = (isc_region_t){ proxy_v6, i };
+		result = isc_proxy2_parse(&region, &proxy);
+		assert_int_equal(result, ISC_R_NOMORE);
+	}
+}
+
+ISC_RUN_TEST_IMPL(proxy2_parse_invalid) {
+	isc_result_t result;
+	isc_proxy2_t proxy;
+	uint8_t buf[sizeof(proxy_v4)];
+	isc_region_t region = { buf, sizeof(buf) };
+
+	/* Not a PROXYv2 header, e.g. a plain DNS message */
+	memmove(buf, proxy_v4, sizeof(buf));
+	buf[3] = 0x00;
+	result = isc_proxy2_parse(&region, &proxy);
+	assert_int_equal(result, ISC_R_UNEXPECTEDTOKEN);
+
+	/* Version 1 */
+	memmove(buf, proxy_v4, sizeof(buf));
+	buf[12] = 0x11;
+	result = isc_proxy2_parse(&region, &proxy);
+	assert_int_equal(result, ISC_R_NOTIMPLEMENTED);
+
+	/* Unknown command */
+	memmove(buf, proxy_v4, sizeof(buf));
+	buf[12] = 0x2f;
+	result = isc_proxy2_parse(&region, &proxy);
+	assert_int_equal(result, ISC_R_NOTIMPLEMENTED);
+
+	/* Unknown address family */
+	memmove(buf, proxy_v4, sizeof(buf));
+	buf[13] = 0x42;
+	result = isc_proxy2_parse(&region, &proxy);
+	assert_int_equal(result, ISC_R_NOTIMPLEMENTED);
+
+	/* IPv6 addresses in an IPv4 sized block */
+	memmove(buf, proxy_v4, sizeof(buf));
+	buf[13] = 0x22;
+	result = isc_proxy2_parse(&region, &proxy);
+	assert_int_equal(result, ISC_R_RANGE);
+}
+
+ISC_TEST_LIST_START
+
+ISC_TEST_ENTRY(proxy2_parse_v4)
+ISC_TEST_ENTRY(proxy2_parse_v6)
+ISC_TEST_ENTRY(proxy2_parse_local)
+ISC_TEST_ENTRY(proxy2_parse_partial)
+ISC_TEST_ENTRY(proxy2_parse_invalid)
+
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
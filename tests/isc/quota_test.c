@@ -26,6 +26,7 @@
 #include <isc/quota.h>
 #include <isc/result.h>
 #include <isc/thread.h>
+#include <isc/tid.h>
 #include <isc/util.h>
 #include <isc/uv.h>
 
@@ -326,6 +327,166 @@ ISC_RUN_TEST_IMPL(isc_quota_callback_mt) {
 	isc_quota_destroy(&quota);
 }
 
+/*
+ * Loop threads keep units in reserve, but the hard quota still holds
+ * exactly: the reserve of the other threads is reclaimed before an
+ * attach fails.
+ */
+typedef struct qlocalinfo {
+	uint32_t tid;
+	isc_quota_t *quota;
+	bool attach;
+	size_t count;
+	size_t limit;
+	size_t soft;
+	isc_quota_t *quotas[1000];
+} qlocalinfo_t;
+
+static isc_threadresult_t
+quota_local_thread(void *arg) {
+	qlocalinfo_t *qli = arg;
+
+	isc__tid_init(qli->tid);
+
+	if (qli->attach) {
+		while (qli->count < ARRAY_SIZE(qli->quotas)) {
+			isc_quota_t **quotap = &qli->quotas[qli->count];
+			isc_result_t result = isc_quota_attach(qli->quota,
+							       quotap);
+			if (result == ISC_R_QUOTA) {
+				break;
+			}
+			assert_int_equal(result, ISC_R_SUCCESS);
+			if (++qli->count == 300 && qli->tid == 0) {
+				break;
+			}
+		}
+	} else {
+		while (qli->count > 0) {
+			isc_quota_detach(&qli->quotas[--qli->count]);
+		}
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+static void
+quota_local_run(qlocalinfo_t *qli, bool attach) {
+	isc_thread_t thread;
+
+	qli->attach = attach;
+	isc_thread_create(quota_local_thread, qli, &thread);
+	isc_thread_join(thread, NULL);
+}
+
+ISC_RUN_TEST_IMPL(isc_quota_local) {
+	isc_quota_t quota;
+	static qlocalinfo_t qlis[2];
+
+	UNUSED(state);
+
+	isc_quota_init(&quota, 1000);
+	for (size_t i = 0; i < ARRAY_SIZE(qlis); i++) {
+		qlis[i] = (qlocalinfo_t){ .tid = i, .quota = &quota };
+	}
+
+	quota_local_run(&qlis[0], true);
+	assert_int_equal(qlis[0].count, 300);
+	assert_int_equal(isc_quota_getused(&quota), 300);
+	/* The first thread took a batch */
+	assert_true(atomic_load(&quota.used) > 300);
+
+	quota_local_run(&qlis[1], true);
+	assert_int_equal(qlis[1].count, 700);
+	assert_int_equal(isc_quota_getused(&quota), 1000);
+
+	quota_local_run(&qlis[0], false);
+	assert_int_equal(isc_quota_getused(&quota), 700);
+
+	quota_local_run(&qlis[1], false);
+	assert_int_equal(isc_quota_getused(&quota), 0);
+
+	isc_quota_destroy(&quota);
+}
+
+/*
+ * The units kept in reserve are not in use, so they do not make the
+ * soft quota be reported early.
+ */
+static isc_threadresult_t
+quota_softlocal_thread(void *arg) {
+	qlocalinfo_t *qli = arg;
+
+	isc__tid_init(qli->tid);
+
+	if (qli->attach) {
+		while (qli->count < qli->limit) {
+			isc_quota_t **quotap = &qli->quotas[qli->count];
+			isc_result_t result = isc_quota_attach(qli->quota,
+							       quotap);
+			assert_int_not_equal(result, ISC_R_QUOTA);
+			qli->count++;
+			if (result == ISC_R_SOFTQUOTA && qli->soft == 0) {
+				qli->soft = qli->count;
+			}
+		}
+	} else {
+		while (qli->count > 0) {
+			isc_quota_detach(&qli->quotas[--qli->count]);
+		}
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+static void
+quota_softlocal_run(qlocalinfo_t *qli, bool attach) {
+	isc_thread_t thread;
+
+	qli->attach = attach;
+	isc_thread_create(quota_softlocal_thread, qli, &thread);
+	isc_thread_join(thread, NULL);
+}
+
+ISC_RUN_TEST_IMPL(isc_quota_softlocal) {
+	isc_quota_t quota;
+	static qlocalinfo_t qlis[9];
+
+	UNUSED(state);
+
+	isc_quota_init(&quota, 1000);
+	isc_quota_soft(&quota, 500);
+
+	/* Leave units in reserve on most threads */
+	for (size_t i = 0; i < ARRAY_SIZE(qlis) - 1; i++) {
+		qlis[i] = (qlocalinfo_t){
+			.tid = i,
+			.quota = &quota,
+			.limit = 100,
+		};
+		quota_softlocal_run(&qlis[i], true);
+		assert_int_equal(qlis[i].soft, 0);
+		quota_softlocal_run(&qlis[i], false);
+	}
+	assert_int_equal(isc_quota_getused(&quota), 0);
+	assert_true(atomic_load(&quota.used) > 0);
+
+	/* The soft quota is reached after exactly 500 units */
+	qlis[8] = (qlocalinfo_t){
+		.tid = 8,
+		.quota = &quota,
+		.limit = 600,
+	};
+	quota_softlocal_run(&qlis[8], true);
+	assert_int_equal(qlis[8].soft, 501);
+	assert_int_equal(isc_quota_getused(&quota), 600);
+
+	quota_softlocal_run(&qlis[8], false);
+	assert_int_equal(isc_quota_getused(&quota), 0);
+
+	isc_quota_destroy(&quota);
+}
+
 ISC_TEST_LIST_START
 
 ISC_TEST_ENTRY(isc_quota_get_set)
@@ -333,6 +494,8 @@ ISC_TEST_ENTRY(isc_quota_hard)
 ISC_TEST_ENTRY(isc_quota_soft)
 ISC_TEST_ENTRY(isc_quota_callback)
 ISC_TEST_ENTRY(isc_quota_callback_mt)
+ISC_TEST_ENTRY(isc_quota_local)
+ISC_TEST_ENTRY(isc_quota_softlocal)
 
 ISC_TEST_LIST_END
 
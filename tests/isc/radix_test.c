@@ -24,6 +24,7 @@
 #include <isc/mem.h>
 #include <isc/netaddr.h>
 #include <isc/radix.h>
+#include <isc/random.h>
 #include <isc/result.h>
 #include <isc/util.h>
 
@@ -77,9 +78,126 @@ ISC_RUN_TEST_IMPL(isc_radix_search) {
 	isc_radix_destroy(radix, NULL);
 }
 
+/*
+ * Insert a random prefix of 'family' into 'radix', or "any" for
+ * AF_UNSPEC, and return a host address inside it in 'host'.
+ */
+static void
+insert_random(isc_radix_tree_t *radix, int family, isc_netaddr_t *host) {
+	isc_radix_node_t *node = NULL;
+	isc_netaddr_t netaddr;
+	isc_prefix_t prefix;
+	isc_result_t result;
+	unsigned int bitlen;
+
+	if (family == AF_INET) {
+		struct in_addr in_addr = { .s_addr = isc_random32() };
+		/* Mostly short prefixes, so that they overlap */
+		bitlen = isc_random_uniform(4) == 0 ? isc_random_uniform(33)
+						    : isc_random_uniform(17);
+		isc_netaddr_fromin(&netaddr, &in_addr);
+	} else if (family == AF_INET6) {
+		struct in6_addr in6_addr;
+		isc_random_buf(&in6_addr, sizeof(in6_addr));
+		/* Keep the first bits fixed, so that the prefixes overlap */
+		in6_addr.s6_addr[0] = 0x20;
+		bitlen = isc_random_uniform(4) == 0 ? isc_random_uniform(129)
+						    : isc_random_uniform(25);
+		isc_netaddr_fromin6(&netaddr, &in6_addr);
+	} else {
+		bitlen = 0;
+	}
+
+	if (family == AF_UNSPEC) {
+		NETADDR_TO_PREFIX_T((isc_netaddr_t *)NULL, prefix, 0);
+	} else {
+		*host = netaddr;
+		NETADDR_TO_PREFIX_T(&netaddr, prefix, bitlen);
+	}
+
+	result = isc_radix_insert(radix, &node, NULL, &prefix);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	isc_refcount_destroy(&prefix.refcount);
+}
+
+static void
+check_compiled(isc_radix_tree_t *radix, isc_radix_compiled_t *compiled,
+	       const isc_netaddr_t *netaddr) {
+	isc_radix_node_t *expected = NULL, *found = NULL;
+	isc_result_t result;
+	isc_prefix_t prefix;
+
+	NETADDR_TO_PREFIX_T(netaddr, prefix,
+			    netaddr->family == AF_INET6 ? 128 : 32);
+
+	result = isc_radix_search(radix, &expected, &prefix);
+	assert_int_equal(isc_radix_compiled_search(compiled, &found, &prefix),
+			 result);
+	assert_ptr_equal(found, expected);
+
+	isc_refcount_destroy(&prefix.refcount);
+}
+
+/* compiled radix trees return the same first match as the radix tree */
+ISC_RUN_TEST_IMPL(isc_radix_compiled) {
+	isc_radix_tree_t *radix = NULL;
+	isc_radix_compiled_t *compiled = NULL;
+	isc_netaddr_t *hosts = NULL;
+	size_t count = 4096;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	result = isc_radix_create(mctx, &radix, RADIX_MAXBITS);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* An empty tree doesn't match anything */
+	isc_radix_compile(radix, &compiled);
+	check_compiled(radix, compiled,
+		       &(isc_netaddr_t){ .family = AF_INET6 });
+	isc_radix_compiled_destroy(&compiled);
+	assert_null(compiled);
+
+	hosts = isc_mem_get(mctx, count * sizeof(hosts[0]));
+	for (size_t i = 0; i < count; i++) {
+		int family = (i % 2 == 0) ? AF_INET : AF_INET6;
+
+		/*
+		 * "any" is stored as IPv4, but matches IPv6 addresses too;
+		 * add it halfway, so that it shadows the later prefixes.
+		 */
+		if (i == count / 2) {
+			insert_random(radix, AF_UNSPEC, NULL);
+		}
+		insert_random(radix, family, &hosts[i]);
+	}
+
+	isc_radix_compile(radix, &compiled);
+
+	for (size_t i = 0; i < count; i++) {
+		isc_netaddr_t netaddr = hosts[i];
+
+		check_compiled(radix, compiled, &netaddr);
+
+		/* Flip a random bit of the address */
+		if (netaddr.family == AF_INET) {
+			netaddr.type.in.s_addr ^= 1U << isc_random_uniform(32);
+		} else {
+			netaddr.type.in6.s6_addr[isc_random_uniform(16)] ^=
+				1U << isc_random_uniform(8);
+		}
+		check_compiled(radix, compiled, &netaddr);
+	}
+
+	isc_radix_compiled_destroy(&compiled);
+	isc_mem_put(mctx, hosts, count * sizeof(hosts[0]));
+	isc_radix_destroy(radix, NULL);
+}
+
 ISC_TEST_LIST_START
 
 ISC_TEST_ENTRY(isc_radix_search)
+ISC_TEST_ENTRY(isc_radix_compiled)
 
 ISC_TEST_LIST_END
 ISC_TEST_MAIN
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/atomic.h>
+#include <isc/loop.h>
+#include <isc/rcu.h>
+#include <isc/tid.h>
+#include <isc/util.h>
+
+#include <tests/isc.h>
+
+static atomic_bool checked;
+
+static void
+rcu_cb(void *arg) {
+	uint64_t tag, inner;
+
+	UNUSED(arg);
+
+	if (isc_tid() != 0) {
+		return;
+	}
+
+	assert_true(isc_rcu_available());
+
+	/* Memory retired outside any critical section is free at once */
+	tag = isc_rcu_retire();
+	assert_true(isc_rcu_expired(tag));
+
+	/* ...but not while a reader that may have seen it is running */
+	isc_rcu_read_lock();
+	tag = isc_rcu_retire();
+	assert_false(isc_rcu_expired(tag));
+
+	/* Nesting doesn't end the critical section early */
+	isc_rcu_read_lock();
+	inner = isc_rcu_retire();
+	isc_rcu_read_unlock();
+	assert_false(isc_rcu_expired(tag));
+	assert_false(isc_rcu_expired(inner));
+	isc_rcu_read_unlock();
+
+	assert_true(isc_rcu_expired(tag));
+	assert_true(isc_rcu_expired(inner));
+
+	/* A reader that starts after the memory was retired doesn't count */
+	tag = isc_rcu_retire();
+	isc_rcu_read_lock();
+	assert_true(isc_rcu_expired(tag));
+	isc_rcu_read_unlock();
+
+	/* Waiting for the readers returns once they are all gone */
+	tag = isc_rcu_retire();
+	isc_rcu_synchronize();
+	assert_true(isc_rcu_expired(tag));
+
+	atomic_store(&checked, true);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+ISC_RUN_TEST_IMPL(isc_rcu_expired) {
+	atomic_init(&checked, false);
+
+	/* Threads outside the loops have to use locks instead */
+	assert_false(isc_rcu_available());
+
+	isc_loopmgr_setup(loopmgr, rcu_cb, NULL);
+	isc_loopmgr_run(loopmgr);
+
+	assert_true(atomic_load(&checked));
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY_CUSTOM(isc_rcu_expired, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -139,7 +139,7 @@ ISC_RUN_TEST_IMPL(isc_siphash24) {
 
 	for (size_t i = 0; i < ARRAY_SIZE(in); i++) {
 		in[i] = i;
-		isc_siphash24(key, in, i, out);
+		isc_siphash24(key, in, i, true, out);
 		assert_memory_equal(out, vectors_sip64[i], 8);
 	}
 }
@@ -154,15 +154,39 @@ ISC_RUN_TEST_IMPL(isc_halfsiphash24) {
 
 	for (size_t i = 0; i < ARRAY_SIZE(in); i++) {
 		in[i] = i;
-		isc_halfsiphash24(key, in, i, out);
+		isc_halfsiphash24(key, in, i, true, out);
 		assert_memory_equal(out, vectors_hsip32[i], 4);
 	}
 }
 
+/* case-insensitive hashes match the hashes of the input in lower case */
+ISC_RUN_TEST_IMPL(isc_siphash24_nocase) {
+	UNUSED(state);
+
+	uint8_t in[64], lower[64], key[16];
+	uint8_t out[8], lowerout[8];
+	uint8_t hout[4], hlowerout[4];
+	for (size_t i = 0; i < ARRAY_SIZE(key); i++) {
+		key[i] = i;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(in); i++) {
+		in[i] = "Mixed-Case_Input.ZZ"[i % 19];
+		lower[i] = isc_ascii_tolower(in[i]);
+		isc_siphash24(key, in, i, false, out);
+		isc_siphash24(key, lower, i, true, lowerout);
+		assert_memory_equal(out, lowerout, 8);
+		isc_halfsiphash24(key, in, i, false, hout);
+		isc_halfsiphash24(key, lower, i, true, hlowerout);
+		assert_memory_equal(hout, hlowerout, 4);
+	}
+}
+
 ISC_TEST_LIST_START
 
 ISC_TEST_ENTRY(isc_siphash24)
 ISC_TEST_ENTRY(isc_halfsiphash24)
+ISC_TEST_ENTRY(isc_siphash24_nocase)
 
 ISC_TEST_LIST_END
 
@@ -24,6 +24,8 @@
 #include <isc/mem.h>
 #include <isc/result.h>
 #include <isc/stats.h>
+#include <isc/thread.h>
+#include <isc/tid.h>
 #include <isc/util.h>
 
 #include <tests/isc.h>
@@ -94,9 +96,85 @@ ISC_RUN_TEST_IMPL(isc_stats_basic) {
 	isc_stats_detach(&stats);
 }
 
+#define SHARDED_THREADS 4
+
+static isc_threadresult_t
+sharded_thread(isc_threadarg_t arg) {
+	isc_stats_t *stats = arg;
+	static atomic_uint_fast32_t tids = 0;
+
+	isc__tid_init(atomic_fetch_add(&tids, 1));
+
+	for (int i = 0; i < 1000; i++) {
+		isc_stats_increment(stats, 0);
+		isc_stats_add(stats, 1, 2);
+		isc_stats_increment(stats, 2);
+		isc_stats_decrement(stats, 2);
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+static void
+sharded_dump(isc_statscounter_t counter, uint64_t value, void *arg) {
+	uint64_t *values = arg;
+
+	values[counter] = value;
+}
+
+/* test stats with a copy of the counters per thread */
+ISC_RUN_TEST_IMPL(isc_stats_sharded) {
+	isc_thread_t threads[SHARDED_THREADS];
+	isc_stats_t *stats = NULL;
+	isc_result_t result;
+	uint64_t values[4] = { 0 };
+
+	UNUSED(state);
+
+	result = isc_stats_createsharded(mctx, &stats, 3);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(isc_stats_ncounters(stats), 3);
+
+	for (int i = 0; i < SHARDED_THREADS; i++) {
+		isc_thread_create(sharded_thread, stats, &threads[i]);
+	}
+	for (int i = 0; i < SHARDED_THREADS; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+
+	/* This thread is not running a loop, and has a copy of its own */
+	isc_stats_decrement(stats, 0);
+
+	assert_int_equal(isc_stats_get_counter(stats, 0),
+			 SHARDED_THREADS * 1000 - 1);
+	assert_int_equal(isc_stats_get_counter(stats, 1),
+			 SHARDED_THREADS * 2000);
+	assert_int_equal(isc_stats_get_counter(stats, 2), 0);
+
+	isc_stats_dump(stats, sharded_dump, values, 0);
+	assert_int_equal(values[0], SHARDED_THREADS * 1000 - 1);
+	assert_int_equal(values[1], SHARDED_THREADS * 2000);
+	assert_int_equal(values[2], 0);
+
+	/* Setting a counter discards the other copies */
+	isc_stats_set(stats, 5, 0);
+	assert_int_equal(isc_stats_get_counter(stats, 0), 5);
+
+	/* Existing counters are retained */
+	isc_stats_resize(&stats, 4);
+	assert_int_equal(isc_stats_ncounters(stats), 4);
+	assert_int_equal(isc_stats_get_counter(stats, 0), 5);
+	assert_int_equal(isc_stats_get_counter(stats, 1),
+			 SHARDED_THREADS * 2000);
+	assert_int_equal(isc_stats_get_counter(stats, 3), 0);
+
+	isc_stats_detach(&stats);
+}
+
 ISC_TEST_LIST_START
 
 ISC_TEST_ENTRY(isc_stats_basic)
+ISC_TEST_ENTRY(isc_stats_sharded)
 
 ISC_TEST_LIST_END
 
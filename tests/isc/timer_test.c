@@ -411,12 +411,64 @@ ISC_LOOP_TEST_SETUP_TEARDOWN_IMPL(purge) {
 	isc_timer_start(oncetimer, isc_timertype_once, &interval);
 }
 
+static void
+wheel_event(void *arg) {
+	isc_timer_t *timer = (isc_timer_t *)arg;
+
+	/* Fired on the tick it expires on */
+	assert_int_equal(timer->expires, mainloop->wheel.now);
+	atomic_fetch_add(&eventcnt, 1);
+}
+
+/* timers on every level of the timing wheel, driven by a virtual clock */
+ISC_LOOP_TEST_IMPL(wheel) {
+	static const uint64_t timeouts[] = { 1,	       2,	 63,
+					     64,       65,	 127,
+					     4095,     4096,	 4097,
+					     262143,   262144,	 300000,
+					     16777215, 16777216, 16777217,
+					     40000000, 100000000 };
+	isc_timerwheel_t *wheel = &mainloop->wheel;
+	isc_timer_t *timers[ARRAY_SIZE(timeouts)];
+	uint64_t start = wheel->now + 1000;
+
+	UNUSED(arg);
+
+	atomic_init(&eventcnt, 0);
+
+	/* Let the wheel start in the middle of a rotation */
+	wheel_advance(wheel, start);
+
+	for (size_t i = 0; i < ARRAY_SIZE(timeouts); i++) {
+		timers[i] = NULL;
+		isc_timer_create(mainloop, wheel_event, NULL, &timers[i]);
+		timers[i]->cbarg = timers[i];
+		timers[i]->expires = start + timeouts[i];
+		wheel_insert(wheel, timers[i], wheel->now + 1);
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(timeouts); i++) {
+		wheel_advance(wheel, start + timeouts[i] - 1);
+		assert_int_equal(atomic_load(&eventcnt), i);
+		wheel_advance(wheel, start + timeouts[i]);
+		assert_int_equal(atomic_load(&eventcnt), i + 1);
+	}
+	assert_int_equal(wheel->count, 0);
+
+	for (size_t i = 0; i < ARRAY_SIZE(timeouts); i++) {
+		isc_timer_destroy(&timers[i]);
+	}
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
 ISC_TEST_LIST_START
 
 ISC_TEST_ENTRY_CUSTOM(ticker, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(once_idle, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(reset, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(purge, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(wheel, setup_loopmgr, teardown_loopmgr)
 
 ISC_TEST_LIST_END
 
@@ -130,6 +130,29 @@ ISC_LOOP_TEST_IMPL(tlsdns_recv_send) {
 	}
 }
 
+static int
+tlsdns_recv_send_ktls_setup(void **state) {
+	int r = stream_recv_send_setup(state);
+
+	/*
+	 * Where kernel TLS is unavailable this is a no-op and the test
+	 * exercises the userspace fallback.
+	 */
+	isc_nm_setkerneltls(listen_nm, true);
+	isc_nm_setkerneltls(connect_nm, true);
+
+	return (r);
+}
+
+ISC_LOOP_TEST_IMPL(tlsdns_recv_send_ktls) {
+	start_listening(ISC_NM_LISTEN_ALL, listen_accept_cb, listen_read_cb);
+
+	for (size_t i = 0; i < workers; i++) {
+		isc_async_run(isc_loop_get(loopmgr, i),
+			      stream_recv_send_connect, tlsdns_connect);
+	}
+}
+
 ISC_TEST_LIST_START
 
 ISC_TEST_ENTRY_CUSTOM(tlsdns_noop, stream_noop_setup, stream_noop_teardown)
@@ -143,6 +166,8 @@ ISC_TEST_ENTRY_CUSTOM(tlsdns_recv_two, stream_recv_two_setup,
 		      stream_recv_two_teardown)
 ISC_TEST_ENTRY_CUSTOM(tlsdns_recv_send, stream_recv_send_setup,
 		      stream_recv_send_teardown)
+ISC_TEST_ENTRY_CUSTOM(tlsdns_recv_send_ktls, tlsdns_recv_send_ktls_setup,
+		      stream_recv_send_teardown)
 
 /* FIXME: Re-add the noalpn tests */
 
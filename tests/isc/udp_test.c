@@ -931,6 +931,115 @@ ISC_LOOP_TEST_IMPL(udp_recv_send) {
 	}
 }
 
+ISC_SETUP_TEST_IMPL(udp_recv_send_batched) {
+	setup_test_udp_recv_send(state);
+
+	isc_nm_setudpsendbatching(netmgr, true);
+
+	return (0);
+}
+
+ISC_TEARDOWN_TEST_IMPL(udp_recv_send_batched) {
+	return (teardown_test_udp_recv_send(state));
+}
+
+ISC_LOOP_TEST_IMPL(udp_recv_send_batched) {
+	loop_test_udp_recv_send(arg);
+}
+
+ISC_SETUP_TEST_IMPL(udp_recv_send_uring) {
+	setup_test_udp_recv_send(state);
+
+	isc_nm_setiouring(netmgr, true);
+
+	return (0);
+}
+
+ISC_TEARDOWN_TEST_IMPL(udp_recv_send_uring) {
+	return (teardown_test_udp_recv_send(state));
+}
+
+ISC_LOOP_TEST_IMPL(udp_recv_send_uring) {
+	loop_test_udp_recv_send(arg);
+}
+
+/* Larger than the page the io_uring buffers used to be limited to */
+static uint8_t udp_big_msg[3 * 4096];
+
+static void
+udp_recv_big_recv_cb(isc_nmhandle_t *handle, isc_result_t eresult,
+		     isc_region_t *region, void *cbarg) {
+	UNUSED(handle);
+	UNUSED(cbarg);
+
+	if (eresult != ISC_R_SUCCESS) {
+		return;
+	}
+
+	assert_int_equal(region->length, sizeof(udp_big_msg));
+	assert_memory_equal(region->base, udp_big_msg, sizeof(udp_big_msg));
+
+	atomic_fetch_add(&sreads, 1);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static void
+udp_recv_big_send_cb(isc_nmhandle_t *handle, isc_result_t eresult,
+		     void *cbarg) {
+	isc_nmhandle_t *sendhandle = handle;
+
+	UNUSED(cbarg);
+
+	assert_int_equal(eresult, ISC_R_SUCCESS);
+	atomic_fetch_add(&csends, 1);
+
+	isc_nmhandle_detach(&sendhandle);
+	isc_refcount_decrement(&active_csends);
+}
+
+static void
+udp_recv_big_connect_cb(isc_nmhandle_t *handle, isc_result_t eresult,
+			void *cbarg) {
+	isc_nmhandle_t *sendhandle = NULL;
+	isc_region_t region = { .base = udp_big_msg,
+				.length = sizeof(udp_big_msg) };
+
+	isc_refcount_decrement(&active_cconnects);
+	assert_int_equal(eresult, ISC_R_SUCCESS);
+	atomic_fetch_add(&cconnects, 1);
+
+	isc_refcount_increment0(&active_csends);
+	isc_nmhandle_attach(handle, &sendhandle);
+	isc_nm_send(sendhandle, &region, udp_recv_big_send_cb, cbarg);
+}
+
+ISC_SETUP_TEST_IMPL(udp_recv_big_uring) {
+	setup_test(state);
+
+	isc_nm_setiouring(netmgr, true);
+	isc_nonce_buf(udp_big_msg, sizeof(udp_big_msg));
+
+	return (0);
+}
+
+ISC_TEARDOWN_TEST_IMPL(udp_recv_big_uring) {
+	atomic_assert_int_eq(cconnects, 1);
+	atomic_assert_int_eq(csends, 1);
+	atomic_assert_int_eq(sreads, 1);
+
+	teardown_test(state);
+
+	return (0);
+}
+
+ISC_LOOP_TEST_IMPL(udp_recv_big_uring) {
+	start_listening(ISC_NM_LISTEN_ONE, udp_recv_big_recv_cb);
+
+	isc_refcount_increment0(&active_cconnects);
+	isc_nm_udpconnect(netmgr, &udp_connect_addr, &udp_listen_addr,
+			  udp_recv_big_connect_cb, NULL, T_CONNECT);
+}
+
 ISC_TEST_LIST_START
 
 /* Mock tests are unreliable on OpenBSD */
@@ -959,6 +1068,14 @@ ISC_TEST_ENTRY_SETUP_TEARDOWN(udp_timeout_recovery)
 ISC_TEST_ENTRY_SETUP_TEARDOWN(udp_recv_one)
 ISC_TEST_ENTRY_SETUP_TEARDOWN(udp_recv_two)
 ISC_TEST_ENTRY_SETUP_TEARDOWN(udp_recv_send)
+#if HAVE_SENDMMSG
+ISC_TEST_ENTRY_SETUP_TEARDOWN(udp_recv_send_batched)
+#endif /* HAVE_SENDMMSG */
+
+#if HAVE_IO_URING
+ISC_TEST_ENTRY_SETUP_TEARDOWN(udp_recv_send_uring)
+ISC_TEST_ENTRY_SETUP_TEARDOWN(udp_recv_big_uring)
+#endif /* HAVE_IO_URING */
 
 ISC_TEST_LIST_END
 
@@ -0,0 +1,382 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/mem.h>
+#include <isc/netaddr.h>
+#include <isc/result.h>
+#include <isc/sockaddr.h>
+#include <isc/util.h>
+
+#include <tests/isc.h>
+
+/* Include the main file */
+
+#include "netmgr/xdp.c"
+
+/*
+ * A fake AF_XDP socket with a single transmit frame, and a UDP listener
+ * using it; nothing is attached to a real interface.
+ */
+static isc__networker_t worker;
+static isc_nmsocket_t sock;
+static isc__nm_xsk_t *xsk = NULL;
+static uint8_t *umem = NULL;
+static struct xdp_desc *txdescs = NULL;
+static uint64_t compdescs[XDP_RING_SIZE];
+static uint32_t txprod, txcons, txflags, compprod, compcons;
+
+static const uint8_t local_mac[ETH_ALEN] = { 2, 0, 0, 0, 0, 1 };
+static const uint8_t remote_mac[ETH_ALEN] = { 2, 0, 0, 0, 0, 2 };
+
+static void
+setsock(const char *address, in_port_t port) {
+	struct in_addr in4;
+	struct in6_addr in6;
+
+	if (inet_pton(AF_INET, address, &in4) == 1) {
+		isc_sockaddr_fromin(&sock.iface, &in4, port);
+	} else {
+		RUNTIME_CHECK(inet_pton(AF_INET6, address, &in6) == 1);
+		isc_sockaddr_fromin6(&sock.iface, &in6, port);
+	}
+}
+
+static void
+setpeer(isc_sockaddr_t *peer, const char *address, in_port_t port) {
+	struct in_addr in4;
+	struct in6_addr in6;
+
+	if (inet_pton(AF_INET, address, &in4) == 1) {
+		isc_sockaddr_fromin(peer, &in4, port);
+	} else {
+		RUNTIME_CHECK(inet_pton(AF_INET6, address, &in6) == 1);
+		isc_sockaddr_fromin6(peer, &in6, port);
+	}
+}
+
+static int
+setup_test(void **state) {
+	static isc_nmsocket_t *socks[1];
+
+	UNUSED(state);
+
+	xsk = isc_mem_get(mctx, sizeof(*xsk));
+	memset(xsk, 0, sizeof(*xsk));
+	umem = isc_mem_get(mctx, XDP_FRAME_SIZE);
+	memset(umem, 0, XDP_FRAME_SIZE);
+	txdescs = isc_mem_get(mctx, XDP_RING_SIZE * sizeof(txdescs[0]));
+
+	txprod = txcons = txflags = compprod = compcons = 0;
+	xsk->umem = umem;
+	xsk->tx = (xdp_ring_t){ .producer = &txprod,
+				.consumer = &txcons,
+				.flags = &txflags,
+				.descs = txdescs };
+	xsk->comp = (xdp_ring_t){ .producer = &compprod,
+				  .consumer = &compcons,
+				  .descs = compdescs };
+	xsk->txfree[0] = 0;
+	xsk->ntxfree = 1;
+	xsk->fd = -1;
+
+	worker = (isc__networker_t){ .xsk = xsk };
+	sock = (isc_nmsocket_t){ .magic = NMSOCK_MAGIC,
+				 .tid = isc_tid(),
+				 .worker = &worker,
+				 .xdp_reading = true };
+	setsock("192.0.2.1", 53);
+
+	socks[0] = &sock;
+	xsk->socks = socks;
+	xsk->nsocks = 1;
+
+	return (0);
+}
+
+static int
+teardown_test(void **state) {
+	UNUSED(state);
+
+	isc_mem_put(mctx, txdescs, XDP_RING_SIZE * sizeof(txdescs[0]));
+	isc_mem_put(mctx, umem, XDP_FRAME_SIZE);
+	isc_mem_put(mctx, xsk, sizeof(*xsk));
+
+	return (0);
+}
+
+/*
+ * Build the headers of a query from 'peer' to 'sock.iface' with 'dlen'
+ * bytes of payload in 'frame', and return the length of the frame.
+ */
+static uint32_t
+make_query(uint8_t *frame, const isc_sockaddr_t *peer, uint16_t dlen) {
+	uint8_t *udp = NULL;
+
+	memmove(frame, local_mac, ETH_ALEN);
+	memmove(frame + ETH_ALEN, remote_mac, ETH_ALEN);
+
+	if (peer->type.sa.sa_family == AF_INET) {
+		uint8_t *ip = frame + XDP_ETH_HLEN;
+
+		xdp_put16(frame + 12, ETH_P_IP);
+		ip[0] = 0x45;
+		xdp_put16(ip + 2, XDP_IP4_HLEN + XDP_UDP_HLEN + dlen);
+		ip[9] = IPPROTO_UDP;
+		memmove(ip + 12, &peer->type.sin.sin_addr, 4);
+		memmove(ip + 16, &sock.iface.type.sin.sin_addr, 4);
+		udp = frame + XDP_IP4_UDPOFF;
+		memmove(udp, &peer->type.sin.sin_port, 2);
+		memmove(udp + 2, &sock.iface.type.sin.sin_port, 2);
+	} else {
+		uint8_t *ip = frame + XDP_ETH_HLEN;
+
+		xdp_put16(frame + 12, ETH_P_IPV6);
+		ip[0] = 0x60;
+		xdp_put16(ip + 4, XDP_UDP_HLEN + dlen);
+		ip[6] = IPPROTO_UDP;
+		memmove(ip + 8, &peer->type.sin6.sin6_addr, 16);
+		memmove(ip + 24, &sock.iface.type.sin6.sin6_addr, 16);
+		udp = frame + XDP_IP6_UDPOFF;
+		memmove(udp, &peer->type.sin6.sin6_port, 2);
+		memmove(udp + 2, &sock.iface.type.sin6.sin6_port, 2);
+	}
+
+	xdp_put16(udp + 4, XDP_UDP_HLEN + dlen);
+	memset(udp + XDP_UDP_HLEN, 0, dlen);
+
+	return (udp + XDP_UDP_HLEN + dlen - frame);
+}
+
+/* the Internet checksum */
+ISC_RUN_TEST_IMPL(xdp_csum) {
+	uint8_t hdr[XDP_IP4_HLEN] = { 0x45, 0x00, 0x00, 0x73, 0x00, 0x00, 0x40,
+				      0x00, 0x40, 0x11, 0x00, 0x00, 0xc0, 0xa8,
+				      0x00, 0x01, 0xc0, 0xa8, 0x00, 0xc7 };
+	uint8_t odd[3] = { 0x12, 0x34, 0x56 };
+
+	assert_int_equal(xdp_csum_fold(xdp_csum_add(0, hdr, sizeof(hdr))),
+			 0xb861);
+
+	/* A header with its checksum in place sums to zero */
+	xdp_put16(hdr + 10, 0xb861);
+	assert_int_equal(xdp_csum_fold(xdp_csum_add(0, hdr, sizeof(hdr))), 0);
+
+	/* The odd byte is padded with zero */
+	assert_int_equal(xdp_csum_fold(xdp_csum_add(0, odd, sizeof(odd))),
+			 (uint16_t)~(0x1234 + 0x5600));
+}
+
+/* listener map keys */
+ISC_RUN_TEST_IMPL(xdp_key) {
+	isc_sockaddr_t sa;
+	xdp_key_t key;
+	const uint8_t v6[16] = { 0x20, 0x01, 0x0d, 0xb8, [15] = 1 };
+
+	setpeer(&sa, "192.0.2.1", 53);
+	xdp_key_fromsockaddr(&key, &sa);
+	assert_int_equal(key.family, AF_INET);
+	assert_int_equal(key.port, htons(53));
+	assert_memory_equal(key.addr, "\xc0\x00\x02\x01", 4);
+	assert_memory_equal(key.addr + 4, "\0\0\0\0\0\0\0\0\0\0\0\0", 12);
+
+	setpeer(&sa, "2001:db8::1", 5353);
+	xdp_key_fromsockaddr(&key, &sa);
+	assert_int_equal(key.family, AF_INET6);
+	assert_int_equal(key.port, htons(5353));
+	assert_memory_equal(key.addr, v6, 16);
+}
+
+/*
+ * the frames that are not UDP datagrams for one of the listeners are
+ * dropped before anything is learned from them
+ */
+ISC_RUN_TEST_IMPL(xdp_recv_drop) {
+	uint8_t frame[XDP_FRAME_SIZE];
+	isc_sockaddr_t peer;
+	uint32_t len;
+
+	setpeer(&peer, "198.51.100.1", 1234);
+
+	/* Not IP */
+	len = make_query(frame, &peer, 12);
+	xdp_put16(frame + 12, ETH_P_ARP);
+	xdp_recv_frame(xsk, frame, len);
+	assert_false(xdp_neigh(xsk, &peer)->valid);
+
+	/* Truncated headers */
+	len = make_query(frame, &peer, 12);
+	xdp_recv_frame(xsk, frame, XDP_IP4_UDPOFF + XDP_UDP_HLEN - 1);
+	assert_false(xdp_neigh(xsk, &peer)->valid);
+
+	/* UDP length beyond the end of the frame, or too short */
+	len = make_query(frame, &peer, 12);
+	xdp_recv_frame(xsk, frame, len - 1);
+	assert_false(xdp_neigh(xsk, &peer)->valid);
+	xdp_put16(frame + XDP_IP4_UDPOFF + 4, XDP_UDP_HLEN - 1);
+	xdp_recv_frame(xsk, frame, len);
+	assert_false(xdp_neigh(xsk, &peer)->valid);
+
+	/* Another port or address than the listener's */
+	len = make_query(frame, &peer, 12);
+	xdp_put16(frame + XDP_IP4_UDPOFF + 2, 54);
+	xdp_recv_frame(xsk, frame, len);
+	assert_false(xdp_neigh(xsk, &peer)->valid);
+	len = make_query(frame, &peer, 12);
+	frame[XDP_ETH_HLEN + 19] = 2;
+	xdp_recv_frame(xsk, frame, len);
+	assert_false(xdp_neigh(xsk, &peer)->valid);
+}
+
+/* IPv4 responses are built from the addresses learned from the query */
+ISC_RUN_TEST_IMPL(xdp_send_ipv4) {
+	uint8_t query[XDP_FRAME_SIZE];
+	uint8_t big[XDP_FRAME_SIZE];
+	isc_sockaddr_t peer, other;
+	isc_region_t region = { .base = (unsigned char *)"response",
+				.length = 8 };
+	struct xdp_desc *desc = &txdescs[0];
+	uint8_t *ip = umem + XDP_ETH_HLEN;
+	uint8_t *udp = umem + XDP_IP4_UDPOFF;
+
+	setpeer(&peer, "198.51.100.1", 1234);
+
+	/* Unknown clients are left to the regular socket */
+	assert_int_equal(isc__nm_xdp_udp_send(&sock, &peer, &region),
+			 ISC_R_NOTFOUND);
+
+	(void)make_query(query, &peer, 12);
+	xdp_neigh_learn(xsk, &peer, query);
+
+	/* The neighbour entry is for that address only */
+	setpeer(&other, "198.51.100.2", 1234);
+	if (xdp_neigh(xsk, &other) == xdp_neigh(xsk, &peer)) {
+		assert_int_equal(isc__nm_xdp_udp_send(&sock, &other, &region),
+				 ISC_R_NOTFOUND);
+	}
+
+	/* Other families and oversized responses */
+	setpeer(&other, "2001:db8::2", 1234);
+	assert_int_equal(isc__nm_xdp_udp_send(&sock, &other, &region),
+			 ISC_R_FAMILYMISMATCH);
+	region.base = big;
+	region.length = sizeof(big);
+	assert_int_equal(isc__nm_xdp_udp_send(&sock, &peer, &region),
+			 ISC_R_RANGE);
+	assert_int_equal(txprod, 0);
+
+	region.base = (unsigned char *)"response";
+	region.length = 8;
+	assert_int_equal(isc__nm_xdp_udp_send(&sock, &peer, &region),
+			 ISC_R_SUCCESS);
+	assert_int_equal(txprod, 1);
+	assert_int_equal(desc->addr, 0);
+	assert_int_equal(desc->len, XDP_IP4_UDPOFF + XDP_UDP_HLEN + 8);
+	assert_false(xsk->txkick);
+
+	/* The Ethernet addresses are swapped */
+	assert_memory_equal(umem, remote_mac, ETH_ALEN);
+	assert_memory_equal(umem + ETH_ALEN, local_mac, ETH_ALEN);
+	assert_int_equal(xdp_get16(umem + 12), ETH_P_IP);
+
+	assert_int_equal(ip[0], 0x45);
+	assert_int_equal(xdp_get16(ip + 2), XDP_IP4_HLEN + XDP_UDP_HLEN + 8);
+	assert_int_equal(ip[9], IPPROTO_UDP);
+	assert_memory_equal(ip + 12, &sock.iface.type.sin.sin_addr, 4);
+	assert_memory_equal(ip + 16, &peer.type.sin.sin_addr, 4);
+	assert_int_equal(xdp_csum_fold(xdp_csum_add(0, ip, XDP_IP4_HLEN)), 0);
+
+	assert_int_equal(xdp_get16(udp), 53);
+	assert_int_equal(xdp_get16(udp + 2), 1234);
+	assert_int_equal(xdp_get16(udp + 4), XDP_UDP_HLEN + 8);
+	assert_memory_equal(udp + XDP_UDP_HLEN, "response", 8);
+
+	/* There was a single transmit frame, and it is not back yet */
+	assert_int_equal(isc__nm_xdp_udp_send(&sock, &peer, &region),
+			 ISC_R_NORESOURCES);
+
+	/* Once it has completed, it is used again */
+	compdescs[0] = 0;
+	compprod = 1;
+	assert_int_equal(isc__nm_xdp_udp_send(&sock, &peer, &region),
+			 ISC_R_SUCCESS);
+	assert_int_equal(compcons, 1);
+	assert_int_equal(txprod, 2);
+}
+
+/* IPv6 responses carry a valid UDP checksum */
+ISC_RUN_TEST_IMPL(xdp_send_ipv6) {
+	uint8_t query[XDP_FRAME_SIZE];
+	isc_sockaddr_t peer;
+	isc_region_t region = { .base = (unsigned char *)"odd response",
+				.length = 11 };
+	uint8_t *ip = umem + XDP_ETH_HLEN;
+	uint8_t *udp = umem + XDP_IP6_UDPOFF;
+	uint16_t udplen = XDP_UDP_HLEN + 11;
+	uint32_t sum;
+
+	setsock("2001:db8::1", 53);
+	setpeer(&peer, "2001:db8::2", 1234);
+
+	(void)make_query(query, &peer, 12);
+	xdp_neigh_learn(xsk, &peer, query);
+
+	assert_int_equal(isc__nm_xdp_udp_send(&sock, &peer, &region),
+			 ISC_R_SUCCESS);
+	assert_int_equal(txdescs[0].len, XDP_IP6_UDPOFF + udplen);
+
+	assert_memory_equal(umem, remote_mac, ETH_ALEN);
+	assert_memory_equal(umem + ETH_ALEN, local_mac, ETH_ALEN);
+	assert_int_equal(xdp_get16(umem + 12), ETH_P_IPV6);
+
+	assert_int_equal(ip[0], 0x60);
+	assert_int_equal(xdp_get16(ip + 4), udplen);
+	assert_int_equal(ip[6], IPPROTO_UDP);
+	assert_memory_equal(ip + 8, &sock.iface.type.sin6.sin6_addr, 16);
+	assert_memory_equal(ip + 24, &peer.type.sin6.sin6_addr, 16);
+
+	assert_int_equal(xdp_get16(udp), 53);
+	assert_int_equal(xdp_get16(udp + 2), 1234);
+	assert_int_equal(xdp_get16(udp + 4), udplen);
+	assert_memory_equal(udp + XDP_UDP_HLEN, "odd respons", 11);
+
+	/* Pseudo-header, UDP header and payload sum to zero */
+	assert_int_not_equal(xdp_get16(udp + 6), 0);
+	sum = xdp_csum_add(0, ip + 8, 32);
+	sum += udplen + IPPROTO_UDP;
+	sum = xdp_csum_add(sum, udp, udplen);
+	assert_int_equal(xdp_csum_fold(sum), 0);
+}
+
+ISC_TEST_LIST_START
+
+ISC_TEST_ENTRY(xdp_csum)
+ISC_TEST_ENTRY(xdp_key)
+ISC_TEST_ENTRY_CUSTOM(xdp_recv_drop, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(xdp_send_ipv4, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(xdp_send_ipv6, setup_test, teardown_test)
+
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -182,6 +182,52 @@ ISC_RUN_TEST_IMPL(parse_buffer) {
 	cfg_parser_destroy(&p2);
 }
 
+/* test that identical strings are shared */
+ISC_RUN_TEST_IMPL(intern_strings) {
+	isc_result_t result;
+	unsigned char text[] = "zone one { type primary; file \"db\"; };\n"
+			       "zone two { type primary; file \"db\"; };\n";
+	isc_buffer_t buf;
+	cfg_parser_t *p = NULL;
+	cfg_obj_t *c = NULL;
+	const cfg_obj_t *zones = NULL, *file1 = NULL, *file2 = NULL;
+	const cfg_listelt_t *elt = NULL;
+	const cfg_obj_t *zone1 = NULL, *zone2 = NULL;
+
+	isc_buffer_init(&buf, &text[0], sizeof(text) - 1);
+	isc_buffer_add(&buf, sizeof(text) - 1);
+
+	result = cfg_parser_create(mctx, lctx, &p);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = cfg_parse_buffer(p, &buf, "text", 0, &cfg_type_namedconf, 0,
+				  &c);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = cfg_map_get(c, "zone", &zones);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	elt = cfg_list_first(zones);
+	assert_non_null(elt);
+	zone1 = cfg_listelt_value(elt);
+	elt = cfg_list_next(elt);
+	assert_non_null(elt);
+	zone2 = cfg_listelt_value(elt);
+
+	result = cfg_map_get(cfg_tuple_get(zone1, "options"), "file", &file1);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = cfg_map_get(cfg_tuple_get(zone2, "options"), "file", &file2);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	assert_string_equal(cfg_obj_asstring(file1), "db");
+	assert_ptr_equal(cfg_obj_asstring(file1), cfg_obj_asstring(file2));
+	assert_ptr_not_equal(cfg_obj_asstring(cfg_tuple_get(zone1, "name")),
+			     cfg_obj_asstring(cfg_tuple_get(zone2, "name")));
+
+	cfg_obj_destroy(p, &c);
+	cfg_parser_destroy(&p);
+}
+
 /* test cfg_map_firstclause() */
 ISC_RUN_TEST_IMPL(cfg_map_firstclause) {
 	const char *name = NULL;
@@ -220,6 +266,7 @@ ISC_TEST_LIST_START
 
 ISC_TEST_ENTRY(addzoneconf)
 ISC_TEST_ENTRY(parse_buffer)
+ISC_TEST_ENTRY(intern_strings)
 ISC_TEST_ENTRY(cfg_map_firstclause)
 ISC_TEST_ENTRY(cfg_map_nextclause)
 
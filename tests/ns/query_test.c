@@ -27,7 +27,9 @@
 
 #include <isc/quota.h>
 
+#include <dns/anscache.h>
 #include <dns/badcache.h>
+#include <dns/db.h>
 #include <dns/view.h>
 #include <dns/zone.h>
 
@@ -1476,11 +1478,98 @@ ISC_LOOP_TEST_IMPL(ns__query_hookasync_e2e) {
 	isc_loopmgr_shutdown(loopmgr);
 }
 
+/*****
+ ***** ns__query_anscachekey() tests
+ *****/
+
+static unsigned int
+anscachekey(dns_view_t *view, const char *qname, dns_rdatatype_t qtype,
+	    uint8_t flags, unsigned char *key) {
+	dns_fixedname_t fname;
+	isc_buffer_t b;
+
+	dns_test_namefromstring(qname, &fname);
+	isc_buffer_init(&b, key, NS_QUERY_ANSKEYSIZE);
+	ns__query_anscachekey(&b, view, dns_fixedname_name(&fname), qtype,
+			      dns_rdataclass_in, flags, 1232);
+
+	return (isc_buffer_usedlength(&b));
+}
+
+/* test that answers cached for one view are not sent to another */
+ISC_RUN_TEST_IMPL(ns__query_anscachekey) {
+	unsigned char key1[NS_QUERY_ANSKEYSIZE], key2[NS_QUERY_ANSKEYSIZE];
+	unsigned int counts[DNS_SECTION_MAX] = { 1, 1, 0, 0 };
+	unsigned char wire[] = "answer";
+	isc_region_t r1, r2, w = { wire, sizeof(wire) };
+	dns_view_t *view1 = NULL, *view2 = NULL;
+	dns_anscacheentry_t *entry = NULL;
+	dns_anscache_t *cache = NULL;
+	dns_dbversion_t *version = NULL;
+	dns_db_t *db = NULL;
+	isc_result_t result;
+
+	result = dns_test_makeview("view1", false, &view1);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_test_makeview("view2", false, &view2);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* The same query to the same view gives the same key */
+	r1 = (isc_region_t){ key1, anscachekey(view1, "www.example.",
+					       dns_rdatatype_a, 0, key1) };
+	r2 = (isc_region_t){ key2, anscachekey(view1, "www.example.",
+					       dns_rdatatype_a, 0, key2) };
+	assert_int_equal(isc_region_compare(&r1, &r2), 0);
+
+	/*
+	 * Other names (even in case only, as the question is part of
+	 * the cached response), types, flags and views do not
+	 */
+	r2.length = anscachekey(view1, "WWW.example.", dns_rdatatype_a, 0,
+				key2);
+	assert_true(isc_region_compare(&r1, &r2) != 0);
+	r2.length = anscachekey(view1, "www.example.", dns_rdatatype_aaaa, 0,
+				key2);
+	assert_true(isc_region_compare(&r1, &r2) != 0);
+	r2.length = anscachekey(view1, "www.example.", dns_rdatatype_a, 0x01,
+				key2);
+	assert_true(isc_region_compare(&r1, &r2) != 0);
+	r2.length = anscachekey(view2, "www.example.", dns_rdatatype_a, 0,
+				key2);
+	assert_int_equal(r1.length, r2.length);
+	assert_true(isc_region_compare(&r1, &r2) != 0);
+
+	/*
+	 * A zone shared by both views has a single answer cache; an
+	 * answer rendered for the first view is not found by the second.
+	 */
+	result = dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_currentversion(db, &version);
+	dns_anscache_create(mctx, &cache);
+
+	dns_anscache_add(cache, db, version, &r1, DNS_MESSAGEFLAG_AA,
+			 dns_rcode_noerror, false, counts, &w);
+	result = dns_anscache_find(cache, db, version, &r2, &entry);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+	result = dns_anscache_find(cache, db, version, &r1, &entry);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_anscacheentry_detach(&entry);
+
+	dns_anscache_destroy(&cache);
+	dns_db_closeversion(db, &version, false);
+	dns_db_detach(&db);
+	dns_view_detach(&view1);
+	dns_view_detach(&view2);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(ns__query_sfcache, setup_server, teardown_server)
 ISC_TEST_ENTRY_CUSTOM(ns__query_start, setup_server, teardown_server)
 ISC_TEST_ENTRY_CUSTOM(ns__query_hookasync, setup_server, teardown_server)
 ISC_TEST_ENTRY_CUSTOM(ns__query_hookasync_e2e, setup_server, teardown_server)
+ISC_TEST_ENTRY(ns__query_anscachekey)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN